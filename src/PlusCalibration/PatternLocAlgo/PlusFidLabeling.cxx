@@ -33,6 +33,8 @@ PlusFidLabeling::PlusFidLabeling()
   , m_AngleToleranceRad(-1.0)
   , m_InclinedLineAngleRad(-1.0)
   , m_PatternIntensity(-1.0)
+  , m_NumberOfTestedLineCombinations(0)
+  , m_NumberOfTestedLinePairs(0)
 {
   m_FrameSize[0] = 0;
   m_FrameSize[1] = 0;
@@ -446,6 +448,72 @@ void PlusFidLabeling::UpdateCirsResults(const PlusFidLine& resultLine1, const Pl
   m_DotsFound = true;
 }
 
+//-----------------------------------------------------------------------------
+bool PlusFidLabeling::IsLinePairCompatible(PlusFidLine& currentLine1, PlusFidLine& currentLine2)
+{
+  double angleBetweenLinesRad = PlusFidLine::ComputeAngleRad(currentLine1, currentLine2);
+  if (angleBetweenLinesRad < m_AngleToleranceRad)   //The angle between 2 lines is close to 0
+  {
+    // Parallel lines
+
+    // Check the distance between the lines
+    double distance = ComputeDistancePointLine(m_DotsVector[currentLine1.GetStartPointIndex()], currentLine2);
+    int maxLinePairDistPx = floor(m_MaxLinePairDistMm / m_ApproximateSpacingMmPerPixel + 0.5);
+    int minLinePairDistPx = floor(m_MinLinePairDistMm / m_ApproximateSpacingMmPerPixel + 0.5);
+    if ((distance > maxLinePairDistPx) || (distance < minLinePairDistPx))
+    {
+      // The distance between the lines is smaller or larger than the allowed range
+      return false;
+    }
+
+    // Check the shift (along the direction of the lines)
+    double shift = ComputeShift(currentLine1, currentLine2);
+    int maxLineShiftDistPx = floor(m_MaxLineShiftMm / m_ApproximateSpacingMmPerPixel + 0.5);
+    //maxLineShiftDistPx = 35;
+    if (fabs(shift) > maxLineShiftDistPx)
+    {
+      // The shift between the is larger than the allowed value
+      return false;
+    }
+  }
+  else
+  {
+    // Non-parallel lines
+    double minAngle = m_MinLinePairAngleRad - m_AngleToleranceRad;
+    double maxAngle = m_MaxLinePairAngleRad + m_AngleToleranceRad;
+    if ((angleBetweenLinesRad > maxAngle) || (angleBetweenLinesRad < minAngle))
+    {
+      // The angle between the patterns are not in the valid range
+      return false;
+    }
+
+    // If there are common endpoints between the lines then we check if the angle between the lines is correct
+    // (Needed e.g., for the CIRS phantom model 45)
+    int commonPointIndex = -1; // <0 if there are no common points between the lines, >=0 if there is a common endpoint
+    if ((currentLine1.GetStartPointIndex() == currentLine2.GetStartPointIndex()) || (currentLine1.GetStartPointIndex() == currentLine2.GetEndPointIndex()))
+    {
+      commonPointIndex = currentLine1.GetStartPointIndex();
+    }
+    else if ((currentLine1.GetEndPointIndex() == currentLine2.GetStartPointIndex()) || (currentLine1.GetEndPointIndex() == currentLine2.GetEndPointIndex()))
+    {
+      commonPointIndex = currentLine1.GetEndPointIndex();
+    }
+    if (commonPointIndex != -1)
+    {
+      // there is a common point
+      double minAngle = m_InclinedLineAngleRad - m_AngleToleranceRad;
+      double maxAngle = m_InclinedLineAngleRad + m_AngleToleranceRad;
+      if ((angleBetweenLinesRad > maxAngle) || (angleBetweenLinesRad < minAngle))
+      {
+        // The angle between the patterns are not in the valid range
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
 //-----------------------------------------------------------------------------
 void PlusFidLabeling::FindPattern()
 {
@@ -458,120 +526,65 @@ void PlusFidLabeling::FindPattern()
   std::vector<PlusLabelingResults> results;
 
   m_DotsFound = false;
+  m_NumberOfTestedLineCombinations = 0;
+  m_NumberOfTestedLinePairs = 0;
 
-  //permutation generator
-  for (unsigned int i = 0 ; i < lineIndices.size() ; i++)
+  if (numberOfLines < 1 || numberOfCandidateLines < numberOfLines)
   {
-    lineIndices[i] = lineIndices.size() - 1 - i;
+    return;
   }
-  lineIndices[0]--;
 
+  // Depth-first search of the combinations of candidate lines, in lexicographic order of the (increasing) line indices.
+  // A line is added to a partial combination only if the distance and angle between the line and each line of the combination
+  // are within the allowed range, so all the combinations that contain an invalid line pair are rejected at once.
+  // The result is the same as testing the complete combinations one by one in the same order: the first combination
+  // whose line pairs are all valid. Line pair test results are stored, as the same pairs occur in many combinations.
+  m_LinePairCompatibility.assign(numberOfCandidateLines * numberOfCandidateLines, LINE_PAIR_NOT_TESTED);
+  std::vector<int> combination;
+  int nextCandidateLineIndex = 0;
   bool foundPattern = false;
-  do
+  while (!foundPattern)
   {
-    for (int i = 0; i < numberOfLines; i++)
+    if (nextCandidateLineIndex > numberOfCandidateLines - (numberOfLines - static_cast<int>(combination.size())))
     {
-      lineIndices[i]++;
-
-      if (lineIndices[i] < numberOfCandidateLines - i)
+      // not enough candidate lines are left to complete the combination
+      if (combination.empty())
       {
-        // no need to carry over more
-        // the i-th index is correct, so just adjust all the ones before that
-        int nextIndex = lineIndices[i] + 1;
-        for (int j = i - 1; j >= 0; j--)
-        {
-          lineIndices[j] = nextIndex;
-          nextIndex++;
-        }
-        break; //valid permutation
-      }
-
-      // need to carry over
-      if (i == numberOfLines - 1)
-      {
-        // we are already at the last index, cannot carry over more
-        return;
+        break;
       }
+      nextCandidateLineIndex = combination.back() + 1;
+      combination.pop_back();
+      continue;
     }
 
-    // We have a new permutation in lineIndices.
-    // Check if the distance and angle between each possible line pairs within the permutation are within the allowed range.
-    // This is a quick filtering to keep only those line combinations for further processing that may form a valid pattern.
-    foundPattern = true; // assume that we've found a valid pattern (then set the flag to false if it turns out that one of the values are not within the allowed range)
-    for (int i = 0 ; i < numberOfLines - 1 && foundPattern; i++)
+    m_NumberOfTestedLineCombinations++;
+    bool compatible = true;
+    for (std::vector<int>::iterator lineIndexIt = combination.begin(); lineIndexIt != combination.end() && compatible; ++lineIndexIt)
     {
-      PlusFidLine currentLine1 = maxPointsLines[lineIndices[i]];
-      for (int j = i + 1 ; j < numberOfLines && foundPattern; j++)
+      char& pairCompatibility = m_LinePairCompatibility[nextCandidateLineIndex * numberOfCandidateLines + (*lineIndexIt)];
+      if (pairCompatibility == LINE_PAIR_NOT_TESTED)
       {
-        PlusFidLine currentLine2 = maxPointsLines[lineIndices[j]];
-
-        double angleBetweenLinesRad = PlusFidLine::ComputeAngleRad(currentLine1, currentLine2);
-        if (angleBetweenLinesRad < m_AngleToleranceRad)   //The angle between 2 lines is close to 0
-        {
-          // Parallel lines
-
-          // Check the distance between the lines
-          double distance = ComputeDistancePointLine(m_DotsVector[currentLine1.GetStartPointIndex()], currentLine2);
-          int maxLinePairDistPx = floor(m_MaxLinePairDistMm / m_ApproximateSpacingMmPerPixel + 0.5);
-          int minLinePairDistPx = floor(m_MinLinePairDistMm / m_ApproximateSpacingMmPerPixel + 0.5);
-          if ((distance > maxLinePairDistPx) || (distance < minLinePairDistPx))
-          {
-            // The distance between the lines is smaller or larger than the allowed range
-            foundPattern = false;
-            break;
-          }
-
-          // Check the shift (along the direction of the lines)
-          double shift = ComputeShift(currentLine1, currentLine2);
-          int maxLineShiftDistPx = floor(m_MaxLineShiftMm / m_ApproximateSpacingMmPerPixel + 0.5);
-          //maxLineShiftDistPx = 35;
-          if (fabs(shift) > maxLineShiftDistPx)
-          {
-            // The shift between the is larger than the allowed value
-            foundPattern = false;
-            break;
-          }
-        }
-        else
-        {
-          // Non-parallel lines
-          double minAngle = m_MinLinePairAngleRad - m_AngleToleranceRad;
-          double maxAngle = m_MaxLinePairAngleRad + m_AngleToleranceRad;
-          if ((angleBetweenLinesRad > maxAngle) || (angleBetweenLinesRad < minAngle))
-          {
-            // The angle between the patterns are not in the valid range
-            foundPattern = false;
-            break;
-          }
-
-          // If there are common endpoints between the lines then we check if the angle between the lines is correct
-          // (Needed e.g., for the CIRS phantom model 45)
-          int commonPointIndex = -1; // <0 if there are no common points between the lines, >=0 if there is a common endpoint
-          if ((currentLine1.GetStartPointIndex() == currentLine2.GetStartPointIndex()) || (currentLine1.GetStartPointIndex() == currentLine2.GetEndPointIndex()))
-          {
-            commonPointIndex = currentLine1.GetStartPointIndex();
-          }
-          else if ((currentLine1.GetEndPointIndex() == currentLine2.GetStartPointIndex()) || (currentLine1.GetEndPointIndex() == currentLine2.GetEndPointIndex()))
-          {
-            commonPointIndex = currentLine1.GetEndPointIndex();
-          }
-          if (commonPointIndex != -1)
-          {
-            // there is a common point
-            double minAngle = m_InclinedLineAngleRad - m_AngleToleranceRad;
-            double maxAngle = m_InclinedLineAngleRad + m_AngleToleranceRad;
-            if ((angleBetweenLinesRad > maxAngle) || (angleBetweenLinesRad < minAngle))
-            {
-              // The angle between the patterns are not in the valid range
-              foundPattern = false;
-              break;
-            }
-          }
-        }
+        m_NumberOfTestedLinePairs++;
+        pairCompatibility = IsLinePairCompatible(maxPointsLines[nextCandidateLineIndex], maxPointsLines[*lineIndexIt]) ? LINE_PAIR_COMPATIBLE : LINE_PAIR_INCOMPATIBLE;
       }
+      compatible = (pairCompatibility == LINE_PAIR_COMPATIBLE);
     }
+    if (compatible)
+    {
+      combination.push_back(nextCandidateLineIndex);
+      foundPattern = (static_cast<int>(combination.size()) == numberOfLines);
+    }
+    nextCandidateLineIndex++;
+  }
+
+  LOG_TRACE("FidLabeling::FindPattern tested " << m_NumberOfTestedLineCombinations << " line combinations and " << m_NumberOfTestedLinePairs
+            << " line pairs of " << numberOfCandidateLines << " candidate lines");
+
+  if (foundPattern)
+  {
+    // the line indices are stored in decreasing order
+    std::copy(combination.rbegin(), combination.rend(), lineIndices.begin());
   }
-  while ((lineIndices[numberOfLines - 1] != numberOfCandidateLines - numberOfLines + 2) && (!foundPattern));
 
   if (foundPattern)   //We have the right permutation of lines in lineIndices
   {
@@ -60,9 +60,19 @@ public:
   /*! Compute the slope of the line relative to the x-axis */
   double ComputeSlope(PlusFidLine& line);
 
-  /*! Find the patterns defined by the configuration file */
+  /*! Return true if the distance and the angle between the lines allow them to be in the same pattern, false otherwise */
+  bool IsLinePairCompatible(PlusFidLine& line1, PlusFidLine& line2);
+
+  /*! Find the patterns defined by the configuration file. Combinations of candidate lines are searched depth-first,
+  partial combinations that contain an invalid line pair are not extended. */
   void FindPattern();
 
+  /*! Get the number of (partial) line combinations that were tested by the last FindPattern call */
+  unsigned int GetNumberOfTestedLineCombinations() const { return m_NumberOfTestedLineCombinations; };
+
+  /*! Get the number of line pairs that were tested by the last FindPattern call (each pair is tested once) */
+  unsigned int GetNumberOfTestedLinePairs() const { return m_NumberOfTestedLinePairs; };
+
   /*! Update the CIRS phantom model 45 results once the pattern has been found, the order of the lines is:
   resultLine1: left-most, resultLine2: diagonal, resultLine3: right-most*/
   void UpdateCirsResults(const PlusFidLine& resultLine1, const PlusFidLine& resultLine2, const PlusFidLine& resultLine3);
@@ -144,6 +154,13 @@ public:
   void SetInclinedLineAngleDegrees(double inclinedLineAngleDegrees);
 
 protected:
+  enum LinePairCompatibility
+  {
+    LINE_PAIR_NOT_TESTED,
+    LINE_PAIR_COMPATIBLE,
+    LINE_PAIR_INCOMPATIBLE
+  };
+
   std::array<unsigned int, 3> m_FrameSize;
 
   double m_ApproximateSpacingMmPerPixel;
@@ -169,6 +186,11 @@ protected:
   std::vector<PlusLabelingResults> m_Results;
   std::vector< std::vector<PlusFidLine> > m_LinesVector;
   std::vector< std::vector<double> > m_FoundDotsCoordinateValue;
+
+  /*! Line pair test results of the candidate lines of the current frame, indexed by [line1 * numberOfCandidateLines + line2] */
+  std::vector<char> m_LinePairCompatibility;
+  unsigned int m_NumberOfTestedLineCombinations;
+  unsigned int m_NumberOfTestedLinePairs;
 };
 
 #endif // _FIDUCIAL_LABELLING_H
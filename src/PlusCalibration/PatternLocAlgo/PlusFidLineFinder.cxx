@@ -42,6 +42,12 @@ PlusFidLineFinder::PlusFidLineFinder()
 
   m_MinThetaRad = -1.0;
   m_MaxThetaRad = -1.0;
+
+  m_DotGridCellSizePx = 1.0;
+  m_DotGridOrigin[0] = 0.0;
+  m_DotGridOrigin[1] = 0.0;
+  m_DotGridDimensions[0] = 0;
+  m_DotGridDimensions[1] = 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -430,6 +436,114 @@ double PlusFidLineFinder::ComputeDistancePointLine(const PlusFidDot& dot, const
 
 //-----------------------------------------------------------------------------
 
+void PlusFidLineFinder::BuildDotGrid(double cellSizePx)
+{
+  m_DotGridCellStart.clear();
+  m_DotGridDotIndices.clear();
+  m_DotGridDimensions[0] = 0;
+  m_DotGridDimensions[1] = 0;
+  if (m_DotsVector.empty())
+  {
+    return;
+  }
+
+  double maxPosition[2] = { m_DotsVector[0].GetX(), m_DotsVector[0].GetY() };
+  m_DotGridOrigin[0] = maxPosition[0];
+  m_DotGridOrigin[1] = maxPosition[1];
+  for (unsigned int dotIndex = 1; dotIndex < m_DotsVector.size(); dotIndex++)
+  {
+    m_DotGridOrigin[0] = std::min(m_DotGridOrigin[0], m_DotsVector[dotIndex].GetX());
+    m_DotGridOrigin[1] = std::min(m_DotGridOrigin[1], m_DotsVector[dotIndex].GetY());
+    maxPosition[0] = std::max(maxPosition[0], m_DotsVector[dotIndex].GetX());
+    maxPosition[1] = std::max(maxPosition[1], m_DotsVector[dotIndex].GetY());
+  }
+
+  // Limit the number of cells to the order of the number of dots, so that building the grid is never slower than testing all dots
+  const double maxNumberOfCells = 4.0 * m_DotsVector.size() + 16.0;
+  m_DotGridCellSizePx = (cellSizePx > 1.0 ? cellSizePx : 1.0);
+  while ((floor((maxPosition[0] - m_DotGridOrigin[0]) / m_DotGridCellSizePx) + 1) * (floor((maxPosition[1] - m_DotGridOrigin[1]) / m_DotGridCellSizePx) + 1) > maxNumberOfCells)
+  {
+    m_DotGridCellSizePx *= 2.0;
+  }
+  m_DotGridDimensions[0] = static_cast<int>(floor((maxPosition[0] - m_DotGridOrigin[0]) / m_DotGridCellSizePx)) + 1;
+  m_DotGridDimensions[1] = static_cast<int>(floor((maxPosition[1] - m_DotGridOrigin[1]) / m_DotGridCellSizePx)) + 1;
+
+  // Counting sort of the dots by cell, the dots of a cell are in increasing index order
+  std::vector<unsigned int> dotCells(m_DotsVector.size());
+  m_DotGridCellStart.assign(m_DotGridDimensions[0] * m_DotGridDimensions[1] + 1, 0);
+  for (unsigned int dotIndex = 0; dotIndex < m_DotsVector.size(); dotIndex++)
+  {
+    int cellX = std::min(static_cast<int>((m_DotsVector[dotIndex].GetX() - m_DotGridOrigin[0]) / m_DotGridCellSizePx), m_DotGridDimensions[0] - 1);
+    int cellY = std::min(static_cast<int>((m_DotsVector[dotIndex].GetY() - m_DotGridOrigin[1]) / m_DotGridCellSizePx), m_DotGridDimensions[1] - 1);
+    dotCells[dotIndex] = cellY * m_DotGridDimensions[0] + cellX;
+    m_DotGridCellStart[dotCells[dotIndex] + 1]++;
+  }
+  for (unsigned int cell = 1; cell < m_DotGridCellStart.size(); cell++)
+  {
+    m_DotGridCellStart[cell] += m_DotGridCellStart[cell - 1];
+  }
+  std::vector<unsigned int> cellFill(m_DotGridCellStart.begin(), m_DotGridCellStart.end() - 1);
+  m_DotGridDotIndices.resize(m_DotsVector.size());
+  for (unsigned int dotIndex = 0; dotIndex < m_DotsVector.size(); dotIndex++)
+  {
+    m_DotGridDotIndices[cellFill[dotCells[dotIndex]]++] = dotIndex;
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+void PlusFidLineFinder::GetDotsInDistanceRange(const PlusFidDot& center, double minDistancePx, double maxDistancePx, std::vector<unsigned int>& dotIndices) const
+{
+  dotIndices.clear();
+  if (m_DotGridDimensions[0] <= 0 || m_DotGridDimensions[1] <= 0 || maxDistancePx < 0 || maxDistancePx < minDistancePx)
+  {
+    return;
+  }
+
+  const double centerX = center.GetX() - m_DotGridOrigin[0];
+  const double centerY = center.GetY() - m_DotGridOrigin[1];
+  const int firstCellX = std::max(static_cast<int>(floor((centerX - maxDistancePx) / m_DotGridCellSizePx)), 0);
+  const int lastCellX = std::min(static_cast<int>(floor((centerX + maxDistancePx) / m_DotGridCellSizePx)), m_DotGridDimensions[0] - 1);
+  const int firstCellY = std::max(static_cast<int>(floor((centerY - maxDistancePx) / m_DotGridCellSizePx)), 0);
+  const int lastCellY = std::min(static_cast<int>(floor((centerY + maxDistancePx) / m_DotGridCellSizePx)), m_DotGridDimensions[1] - 1);
+
+  for (int cellY = firstCellY; cellY <= lastCellY; cellY++)
+  {
+    // Distance range between the center and the points of the cell, in y direction
+    const double cellMinY = cellY * m_DotGridCellSizePx - centerY;
+    const double cellMaxY = cellMinY + m_DotGridCellSizePx;
+    const double nearY = (cellMinY > 0 ? cellMinY : (cellMaxY < 0 ? -cellMaxY : 0));
+    const double farY = std::max(fabs(cellMinY), fabs(cellMaxY));
+    for (int cellX = firstCellX; cellX <= lastCellX; cellX++)
+    {
+      const double cellMinX = cellX * m_DotGridCellSizePx - centerX;
+      const double cellMaxX = cellMinX + m_DotGridCellSizePx;
+      const double nearX = (cellMinX > 0 ? cellMinX : (cellMaxX < 0 ? -cellMaxX : 0));
+      const double farX = std::max(fabs(cellMinX), fabs(cellMaxX));
+      // Skip the cells that are entirely outside the ring
+      if (nearX * nearX + nearY * nearY > maxDistancePx * maxDistancePx || (minDistancePx > 0 && farX * farX + farY * farY < minDistancePx * minDistancePx))
+      {
+        continue;
+      }
+      const int cell = cellY * m_DotGridDimensions[0] + cellX;
+      for (unsigned int i = m_DotGridCellStart[cell]; i < m_DotGridCellStart[cell + 1]; i++)
+      {
+        const unsigned int dotIndex = m_DotGridDotIndices[i];
+        const double distance = SegmentLength(center, m_DotsVector[dotIndex]);
+        if (distance >= minDistancePx && distance <= maxDistancePx)
+        {
+          dotIndices.push_back(dotIndex);
+        }
+      }
+    }
+  }
+
+  // Return the dots in the same order as they are in the dot vector, so that the found lines do not depend on the grid
+  std::sort(dotIndices.begin(), dotIndices.end());
+}
+
+//-----------------------------------------------------------------------------
+
 void PlusFidLineFinder::FindLines2Points()
 {
   LOG_TRACE("FidLineFinder::FindLines2Points");
@@ -440,18 +554,24 @@ void PlusFidLineFinder::FindLines2Points()
   }
 
   std::vector<PlusFidLine> twoPointsLinesVector;
+  std::vector<unsigned int> candidateDotIndices;
 
   for (unsigned int i = 0 ; i < m_Patterns.size() ; i++)
   {
     //the expected length of the line
     int lineLenPx = floor(m_Patterns[i]->GetDistanceToOriginMm()[m_Patterns[i]->GetWires().size() - 1] / m_ApproximateSpacingMmPerPixel + 0.5);
+    double lineLenTolerancePx = floor(m_Patterns[i]->GetDistanceToOriginToleranceMm()[m_Patterns[i]->GetWires().size() - 1] / m_ApproximateSpacingMmPerPixel + 0.5);
 
     for (unsigned int dot1Index = 0; dot1Index < m_DotsVector.size() - 1; dot1Index++)
     {
-      for (unsigned int dot2Index = dot1Index + 1; dot2Index < m_DotsVector.size(); dot2Index++)
+      // Only the dots at about the line length can be the other end of the line (1 pixel margin, as the length is computed in single precision)
+      GetDotsInDistanceRange(m_DotsVector[dot1Index], lineLenPx - lineLenTolerancePx - 1.0, lineLenPx + lineLenTolerancePx + 1.0, candidateDotIndices);
+
+      for (std::vector<unsigned int>::iterator candidateIt = std::upper_bound(candidateDotIndices.begin(), candidateDotIndices.end(), dot1Index); candidateIt != candidateDotIndices.end(); ++candidateIt)
       {
+        unsigned int dot2Index = *candidateIt;
         double length = SegmentLength(m_DotsVector[dot1Index], m_DotsVector[dot2Index]);
-        bool acceptLength = fabs(length - lineLenPx) < floor(m_Patterns[i]->GetDistanceToOriginToleranceMm()[m_Patterns[i]->GetWires().size() - 1] / m_ApproximateSpacingMmPerPixel + 0.5);
+        bool acceptLength = fabs(length - lineLenPx) < lineLenTolerancePx;
 
         if (acceptLength)  //to only add valid two point lines
         {
@@ -464,15 +584,16 @@ void PlusFidLineFinder::FindLines2Points()
             twoPointsLine.AddPoint(dot1Index);
             twoPointsLine.AddPoint(dot2Index);
 
-            bool duplicate = std::binary_search(twoPointsLinesVector.begin(), twoPointsLinesVector.end(), twoPointsLine, PlusFidLine::compareLines);
+            //the lines are kept sorted that way for the binary search to be performed
+            std::vector<PlusFidLine>::iterator insertPosition = std::lower_bound(twoPointsLinesVector.begin(), twoPointsLinesVector.end(), twoPointsLine, PlusFidLine::compareLines);
+            bool duplicate = (insertPosition != twoPointsLinesVector.end() && !PlusFidLine::compareLines(twoPointsLine, *insertPosition));
 
             if (!duplicate)
             {
               twoPointsLine.SetStartPointIndex(dot1Index);
               ComputeLine(twoPointsLine);
 
-              twoPointsLinesVector.push_back(twoPointsLine);
-              std::sort(twoPointsLinesVector.begin(), twoPointsLinesVector.end(), PlusFidLine::compareLines);   //the lines need to be sorted that way each time for the binary search to be performed
+              twoPointsLinesVector.insert(insertPosition, twoPointsLine);
             }
           }
         }
@@ -497,6 +618,7 @@ void PlusFidLineFinder::FindLinesNPoints()
 
   double dist = m_CollinearPointsMaxDistanceFromLineMm / m_ApproximateSpacingMmPerPixel;
   unsigned int maxNumberOfPointsPerLine(0);
+  std::vector<unsigned int> candidateDotIndices;
 
   for (unsigned int i = 0 ; i < m_Patterns.size() ; i++)
   {
@@ -520,8 +642,15 @@ void PlusFidLineFinder::FindLinesNPoints()
         PlusFidLine currentShorterPointsLine;
         currentShorterPointsLine = m_LinesVector[linesVectorIndex - 1][l]; //the current max point line we want to expand
 
-        for (unsigned int b3 = 0; b3 < m_DotsVector.size(); b3++)
+        int lineLenPx = floor(m_Patterns[i]->GetDistanceToOriginMm()[linesVectorIndex - 2] / m_ApproximateSpacingMmPerPixel + 0.5);
+        double lineLenTolerancePx = floor(m_Patterns[i]->GetDistanceToOriginToleranceMm()[linesVectorIndex - 2] / m_ApproximateSpacingMmPerPixel + 0.5);
+
+        // Only the dots at about the expected distance from the line origin can be the new point (1 pixel margin, as the length is computed in single precision)
+        GetDotsInDistanceRange(m_DotsVector[currentShorterPointsLine.GetStartPointIndex()], lineLenPx - lineLenTolerancePx - 1.0, lineLenPx + lineLenTolerancePx + 1.0, candidateDotIndices);
+
+        for (std::vector<unsigned int>::iterator candidateIt = candidateDotIndices.begin(); candidateIt != candidateDotIndices.end(); ++candidateIt)
         {
+          unsigned int b3 = *candidateIt;
           std::vector<int> candidatesIndex;
           bool checkDuplicateFlag = false;//assume there is no duplicate
 
@@ -558,8 +687,7 @@ void PlusFidLineFinder::FindLinesNPoints()
 
             double length = SegmentLength(m_DotsVector[currentShorterPointsLine.GetStartPointIndex()], m_DotsVector[b3]);   //distance between the origin and the point we try to add
 
-            int lineLenPx = floor(m_Patterns[i]->GetDistanceToOriginMm()[linesVectorIndex - 2] / m_ApproximateSpacingMmPerPixel + 0.5);
-            bool acceptLength = fabs(length - lineLenPx) < floor(m_Patterns[i]->GetDistanceToOriginToleranceMm()[linesVectorIndex - 2] / m_ApproximateSpacingMmPerPixel + 0.5);
+            bool acceptLength = fabs(length - lineLenPx) < lineLenTolerancePx;
 
             if (!acceptLength)
             {
@@ -591,14 +719,14 @@ void PlusFidLineFinder::FindLinesNPoints()
               m_LinesVector.push_back(emptyLine);
             }
 
-            if (!std::binary_search(m_LinesVector[linesVectorIndex].begin(), m_LinesVector[linesVectorIndex].end(), line, PlusFidLine::compareLines))
+            // keep the lines sorted so that lines that are already in the list can be quickly found by a binary search
+            std::vector<PlusFidLine>::iterator insertPosition = std::lower_bound(m_LinesVector[linesVectorIndex].begin(), m_LinesVector[linesVectorIndex].end(), line, PlusFidLine::compareLines);
+            if (insertPosition == m_LinesVector[linesVectorIndex].end() || PlusFidLine::compareLines(line, *insertPosition))
             {
               ComputeLine(line);
               if (AcceptLine(line))
               {
-                m_LinesVector[linesVectorIndex].push_back(line);
-                // sort the lines so that lines that are already in the list can be quickly found by a binary search
-                std::sort(m_LinesVector[linesVectorIndex].begin(), m_LinesVector[linesVectorIndex].end(), PlusFidLine::compareLines);
+                m_LinesVector[linesVectorIndex].insert(insertPosition, line);
               }
             }
           }
@@ -676,6 +804,14 @@ void PlusFidLineFinder::FindLines()
 {
   LOG_TRACE("FidLineFinder::FindLines");
 
+  // The cell size is chosen so that the dots around a line origin are found in a few cells
+  double maxLineLenPx = 0;
+  for (unsigned int i = 0 ; i < m_Patterns.size() ; i++)
+  {
+    maxLineLenPx = std::max(maxLineLenPx, m_Patterns[i]->GetDistanceToOriginMm()[m_Patterns[i]->GetWires().size() - 1] / m_ApproximateSpacingMmPerPixel);
+  }
+  BuildDotGrid(maxLineLenPx / 4.0);
+
   // Make pairs of dots into 2-point lines.
   FindLines2Points();
 
@@ -17,6 +17,8 @@ class vtkXMLDataElement;
 \brief This class is used to find the n-points lines from a list of dots. The lines have fixed length and tolerance
 and their direction vector restricted according to the configuration file. It first finds 2-points lines and
 then computes n-points lines from these 2-points lines.
+The dots are sorted into a grid of square cells, so that only the dots that are at about the expected distance
+from a line start point are tested as line points, which keeps the processing time low for frames with many candidate dots.
 \ingroup PlusLibPatternRecognition
 */
 
@@ -87,6 +89,12 @@ protected:
   /*! Find 2-points lines from a list of Dots */
   void FindLines2Points();
 
+  /*! Sort the dots into a grid of square cells, so that the dots in a neighborhood can be found without testing all dots */
+  void BuildDotGrid(double cellSizePx);
+
+  /*! Get the indices of the dots whose distance from the center is in [minDistancePx, maxDistancePx], in increasing order */
+  void GetDotsInDistanceRange(const PlusFidDot& center, double minDistancePx, double maxDistancePx, std::vector<unsigned int>& dotIndices) const;
+
   /*! Compute the length of the segment between 2 dots */
   static double SegmentLength(const PlusFidDot& dot1, const PlusFidDot& dot2);
 
@@ -134,6 +142,13 @@ protected:
   std::vector< std::vector<PlusFidLine> > m_LinesVector;
 
   std::vector<PlusFidPattern*> m_Patterns;
+
+  /*! Grid of the dots, the dots of cell c are m_DotGridDotIndices[m_DotGridCellStart[c]] ... m_DotGridDotIndices[m_DotGridCellStart[c+1]-1] */
+  double m_DotGridCellSizePx;
+  double m_DotGridOrigin[2];
+  int m_DotGridDimensions[2];
+  std::vector<unsigned int> m_DotGridCellStart;
+  std::vector<unsigned int> m_DotGridDotIndices;
 };
 
 #endif // _FIDUCIAL_LINE_FINDER_H
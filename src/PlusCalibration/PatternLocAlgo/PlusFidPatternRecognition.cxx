@@ -13,12 +13,17 @@ See License.txt for details.
 #include "vtkIGSIOTrackedFrameList.h"
 #include "igsioTrackedFrame.h"
 
+#include <atomic>
+#include <functional>
+#include <thread>
+
 static const double DOT_STEPS  = 4.0;
 static const double DOT_RADIUS = 6.0;
 
 //-----------------------------------------------------------------------------
 
 PlusFidPatternRecognition::PlusFidPatternRecognition()
+  : m_NumberOfThreads(0)
 {
 
 }
@@ -46,6 +51,16 @@ PlusStatus PlusFidPatternRecognition::ReadConfiguration(vtkXMLDataElement* rootC
   m_FidLineFinder.ReadConfiguration(rootConfigElement);
   m_FidLabeling.ReadConfiguration(rootConfigElement, m_FidLineFinder.GetMinThetaRad(), m_FidLineFinder.GetMaxThetaRad());
 
+  vtkXMLDataElement* segmentationParameters = rootConfigElement->FindNestedElementWithName("Segmentation");
+  if (segmentationParameters != NULL)
+  {
+    int numberOfThreads = 0;
+    if (segmentationParameters->GetScalarAttribute("NumberOfThreads", numberOfThreads))
+    {
+      SetNumberOfThreads(numberOfThreads);
+    }
+  }
+
   return PLUS_SUCCESS;
 }
 
@@ -178,17 +193,67 @@ PlusStatus PlusFidPatternRecognition::RecognizePattern(vtkIGSIOTrackedFrameList*
     *numberOfSuccessfullySegmentedImages = 0;
   }
 
+  // segment only non segmented frames
+  std::vector<unsigned int> frameIndices;
   for (unsigned int currentFrameIndex = 0; currentFrameIndex < trackedFrameList->GetNumberOfTrackedFrames(); currentFrameIndex++)
   {
-    igsioTrackedFrame* trackedFrame = trackedFrameList->GetTrackedFrame(currentFrameIndex);
+    if (trackedFrameList->GetTrackedFrame(currentFrameIndex)->GetFiducialPointsCoordinatePx() == NULL)
+    {
+      frameIndices.push_back(currentFrameIndex);
+    }
+  }
+
+  int numberOfThreads = m_NumberOfThreads;
+  if (numberOfThreads <= 0)
+  {
+    numberOfThreads = std::max<int>(std::thread::hardware_concurrency(), 1);
+  }
+  numberOfThreads = static_cast<int>(std::min<size_t>(numberOfThreads, frameIndices.size()));
+  if (m_FidSegmentation.GetDebugOutput())
+  {
+    numberOfThreads = 1;
+  }
 
-    // segment only non segmented frames
-    if (trackedFrame->GetFiducialPointsCoordinatePx() != NULL)
+  std::vector<PlusStatus> frameStatuses(frameIndices.size(), PLUS_SUCCESS);
+  std::vector<PatternRecognitionError> frameErrors(frameIndices.size(), PATTERN_RECOGNITION_ERROR_NO_ERROR);
+  if (numberOfThreads > 1)
+  {
+    // Frames are independent, each thread takes the next frame and runs the recognition with its own copy of the algorithm
+    std::atomic<size_t> nextFrame(0);
+    std::function<void()> recognizeFrames = [&]()
+    {
+      PlusFidPatternRecognition patternRecognition(*this);
+      for (size_t i = nextFrame++; i < frameIndices.size(); i = nextFrame++)
+      {
+        frameStatuses[i] = patternRecognition.RecognizePattern(trackedFrameList->GetTrackedFrame(frameIndices[i]), frameErrors[i], frameIndices[i]);
+      }
+    };
+    std::vector<std::thread> threads;
+    for (int threadIndex = 0; threadIndex < numberOfThreads; threadIndex++)
     {
-      continue;
+      threads.push_back(std::thread(std::ref(recognizeFrames)));
     }
+    for (std::vector<std::thread>::iterator threadIt = threads.begin(); threadIt != threads.end(); ++threadIt)
+    {
+      threadIt->join();
+    }
+  }
+  else
+  {
+    for (size_t i = 0; i < frameIndices.size(); i++)
+    {
+      frameStatuses[i] = RecognizePattern(trackedFrameList->GetTrackedFrame(frameIndices[i]), frameErrors[i], frameIndices[i]);
+    }
+  }
+
+  // Collect the results in frame order
+  for (size_t i = 0; i < frameIndices.size(); i++)
+  {
+    unsigned int currentFrameIndex = frameIndices[i];
+    igsioTrackedFrame* trackedFrame = trackedFrameList->GetTrackedFrame(currentFrameIndex);
+    patternRecognitionError = frameErrors[i];
 
-    if (RecognizePattern(trackedFrame, patternRecognitionError, currentFrameIndex) != PLUS_SUCCESS)
+    if (frameStatuses[i] != PLUS_SUCCESS)
     {
       if (patternRecognitionError != PATTERN_RECOGNITION_ERROR_TOO_MANY_CANDIDATES)
       {
@@ -14,6 +14,8 @@ See License.txt for details.
 
 #include "vtkXMLDataElement.h"
 
+#include <algorithm>
+
 //class igsioTrackedFrame; 
 //class vtkIGSIOTrackedFrameList;
 
@@ -44,7 +46,9 @@ public:
 
   /*!
   Run pattern recognition on a tracked frame list.
-  It only segments the tracked frames which were not already segmented
+  It only segments the tracked frames which were not already segmented. Frames are processed on NumberOfThreads threads,
+  each thread with its own copy of the segmentation, line finder and labeling, and the results are collected in frame order,
+  so they are the same as with sequential processing.
   \param trackedFrameList Tracked frame list to segment
   \param numberOfSuccessfullySegmentedImages Out parameter holding the number of segmented images in this call (it is only equals the number of all segmented images in the tracked frame if it was not segmented at all)
   \param segmentedFramesIndices Indices of the frames that were properly segmented
@@ -92,6 +96,13 @@ public:
   /*! Set the maximum number of candidates to consider */
   void SetNumberOfMaximumFiducialPointCandidates(int aMax);
 
+  /*!
+  Number of threads that run pattern recognition on a tracked frame list. If 0 then the number of processors is used.
+  Frames are always processed sequentially if debug output is enabled, as the debug images of the frames have the same file names.
+  */
+  void SetNumberOfThreads(int numberOfThreads) { m_NumberOfThreads = std::max(numberOfThreads, 0); };
+  int GetNumberOfThreads() const { return m_NumberOfThreads; };
+
   /*! Reads the phantom definition and computes the NWires intersection if needed */
   PlusStatus ReadPhantomDefinition(vtkXMLDataElement* rootConfigElement);
 
@@ -103,6 +114,7 @@ protected:
   std::vector<PlusFidPattern*>  m_Patterns;
 
   double                        m_MaxLineLengthToleranceMm;
+  int                           m_NumberOfThreads;
 };
 
 //-----------------------------------------------------------------------------
@@ -12,6 +12,18 @@
 #include <limits.h>
 #include <iostream>
 #include <algorithm>
+#include <cstdlib>
+#include <map>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  // SSE2 is available on all 64-bit x86 processors
+  #define PLUS_FIDSEGMENTATION_SSE2
+  #include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+  // NEON is always available on 64-bit ARM
+  #define PLUS_FIDSEGMENTATION_NEON
+  #include <arm_neon.h>
+#endif
 
 #include "itkRGBPixel.h"
 #include "itkImage.h"
@@ -23,6 +35,84 @@ static const short BLACK            = 0;
 static const short MIN_WINDOW_DIST  = 8;
 static const short MAX_CLUSTER_VALS = 16384;
 
+namespace
+{
+  typedef PlusFidSegmentation::PixelType PixelType;
+
+  /*! Minimum of pixels, for erosion */
+  struct ErodeOperator
+  {
+    static PixelType Apply(PixelType a, PixelType b) { return a < b ? a : b; }
+#if defined(PLUS_FIDSEGMENTATION_SSE2)
+    static __m128i Apply(__m128i a, __m128i b) { return _mm_min_epu8(a, b); }
+#elif defined(PLUS_FIDSEGMENTATION_NEON)
+    static uint8x16_t Apply(uint8x16_t a, uint8x16_t b) { return vminq_u8(a, b); }
+#endif
+  };
+
+  /*! Maximum of pixels, for dilation */
+  struct DilateOperator
+  {
+    static PixelType Apply(PixelType a, PixelType b) { return a > b ? a : b; }
+#if defined(PLUS_FIDSEGMENTATION_SSE2)
+    static __m128i Apply(__m128i a, __m128i b) { return _mm_max_epu8(a, b); }
+#elif defined(PLUS_FIDSEGMENTATION_NEON)
+    static uint8x16_t Apply(uint8x16_t a, uint8x16_t b) { return vmaxq_u8(a, b); }
+#endif
+  };
+
+  //-----------------------------------------------------------------------------
+  /*! dest[i] = Operator(a[i], b[i]), 16 pixels at a time. dest may be the same as a or b. */
+  template<class Operator>
+  void CombineRows(PixelType* dest, const PixelType* a, const PixelType* b, unsigned int count)
+  {
+    unsigned int i = 0;
+#if defined(PLUS_FIDSEGMENTATION_SSE2)
+    for (; i + 16 <= count; i += 16)
+    {
+      __m128i aValues = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+      __m128i bValues = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), Operator::Apply(aValues, bValues));
+    }
+#elif defined(PLUS_FIDSEGMENTATION_NEON)
+    for (; i + 16 <= count; i += 16)
+    {
+      vst1q_u8(dest + i, Operator::Apply(vld1q_u8(a + i), vld1q_u8(b + i)));
+    }
+#endif
+    for (; i < count; i++)
+    {
+      dest[i] = Operator::Apply(a[i], b[i]);
+    }
+  }
+
+  //-----------------------------------------------------------------------------
+  /*!
+    Minimum or maximum of a horizontal bar of 2*halfLength+1 pixels for count pixels of a row (van Herk/Gil-Werman algorithm):
+    dest[i] = Operator(samples[i], ..., samples[i + 2*halfLength]). The forward and backward buffers hold count+2*halfLength pixels.
+  */
+  template<class Operator>
+  void RowMorphology(PixelType* dest, const PixelType* samples, unsigned int count, unsigned int halfLength, PixelType* forward, PixelType* backward)
+  {
+    const unsigned int lineLength = 2 * halfLength + 1;
+    const unsigned int numberOfSamples = count + 2 * halfLength;
+
+    // Running extremum from the start of each block of lineLength pixels, and from the end of each block backward
+    for (unsigned int i = 0, positionInBlock = 0; i < numberOfSamples; i++, positionInBlock = (positionInBlock + 1 == lineLength) ? 0 : positionInBlock + 1)
+    {
+      forward[i] = (positionInBlock == 0) ? samples[i] : Operator::Apply(forward[i - 1], samples[i]);
+    }
+    backward[numberOfSamples - 1] = samples[numberOfSamples - 1];
+    for (unsigned int i = numberOfSamples - 1; i-- > 0;)
+    {
+      backward[i] = (i % lineLength == lineLength - 1) ? samples[i] : Operator::Apply(backward[i + 1], samples[i]);
+    }
+
+    // The bar spans at most two blocks
+    CombineRows<Operator>(dest, backward, forward + 2 * halfLength, count);
+  }
+}
+
 const double PlusFidSegmentation::DEFAULT_APPROXIMATE_SPACING_MM_PER_PIXEL = 0.078;
 const double PlusFidSegmentation::DEFAULT_MORPHOLOGICAL_OPENING_CIRCLE_RADIUS_MM = 0.27;
 const double PlusFidSegmentation::DEFAULT_MORPHOLOGICAL_OPENING_BAR_SIZE_MM = 2.0;
@@ -52,10 +142,10 @@ PlusFidSegmentation::PlusFidSegmentation()
   , m_ApproximateSpacingMmPerPixel(-1)
   , m_DotsFound(false)
   , m_NumDots(-1.0)
-  , m_Working(new PlusFidSegmentation::PixelType[1])
-  , m_Dilated(new PlusFidSegmentation::PixelType[1])
-  , m_Eroded(new PlusFidSegmentation::PixelType[1])
-  , m_UnalteredImage(new PlusFidSegmentation::PixelType[1])
+  , m_Working(1)
+  , m_Dilated(1)
+  , m_Eroded(1)
+  , m_UnalteredImage(1)
   , m_DebugOutput(false)
 {
   //Initialization of member variables
@@ -93,10 +183,6 @@ PlusFidSegmentation::PlusFidSegmentation()
 
 PlusFidSegmentation::~PlusFidSegmentation()
 {
-  delete[] m_Dilated;
-  delete[] m_Eroded;
-  delete[] m_Working;
-  delete[] m_UnalteredImage;
 }
 
 //-----------------------------------------------------------------------------
@@ -223,24 +309,16 @@ void PlusFidSegmentation::SetFrameSize(const FrameSizeType& frameSize)
     return;
   }
 
-  if ((m_FrameSize[0] != 0) && (m_FrameSize[1] != 0))
-  {
-    delete[] m_Dilated;
-    delete[] m_Eroded;
-    delete[] m_Working;
-    delete[] m_UnalteredImage;
-  }
-
   m_FrameSize[0] = frameSize[0];
   m_FrameSize[1] = frameSize[1];
   m_FrameSize[2] = 1;
 
-  // Create working images (after deleting them in case they were already created)
-  long size = m_FrameSize[0] * m_FrameSize[1];
-  m_Dilated = new PlusFidSegmentation::PixelType[size];
-  m_Eroded = new PlusFidSegmentation::PixelType[size];
-  m_Working = new PlusFidSegmentation::PixelType[size];
-  m_UnalteredImage = new PlusFidSegmentation::PixelType[size];
+  // Create working images
+  size_t size = static_cast<size_t>(m_FrameSize[0]) * m_FrameSize[1];
+  m_Dilated.resize(size);
+  m_Eroded.resize(size);
+  m_Working.resize(size);
+  m_UnalteredImage.resize(size);
 
   // Set ROI to the largest possible if not already set
   if ((m_RegionOfInterest[0] == 0) || (m_RegionOfInterest[1] == 0) || (m_RegionOfInterest[2] == 0) || (m_RegionOfInterest[3] == 0))
@@ -299,222 +377,132 @@ unsigned int PlusFidSegmentation::GetMorphologicalOpeningBarSizePx()
 
 //-----------------------------------------------------------------------------
 
-inline PlusFidSegmentation::PixelType PlusFidSegmentation::ErodePoint0(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic)
+void PlusFidSegmentation::ReserveMorphologyBuffers(size_t size)
 {
-  //LOG_TRACE("FidSegmentation::ErodePoint0");
-
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-  PlusFidSegmentation::PixelType dval = UCHAR_MAX;
-  unsigned int p = ir * m_FrameSize[0] + ic - barSize; // current pixel - bar size (position of the start of the bar)
-  unsigned int p_max = ir * m_FrameSize[0] + ic + barSize; // current pixel +  bar size (position of the end  of the bar)
-
-  //find lowest intensity in bar shaped area in image
-  for (; p <= p_max; p++)
+  if (m_MorphologyForward.size() < size)
   {
-    if (image[p] < dval)
-    {
-      dval = image[p];
-    }
-    if (image[p] == 0)
-    {
-      break;
-    }
+    m_MorphologyForward.resize(size);
+    m_MorphologyBackward.resize(size);
   }
-
-  return dval;
 }
 
 //-----------------------------------------------------------------------------
 
-void PlusFidSegmentation::Erode0(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
+template<class Operator>
+void PlusFidSegmentation::LineMorphology(PlusFidSegmentation::PixelType* dest, const PlusFidSegmentation::PixelType* image, int columnStep)
 {
-  //LOG_TRACE("FidSegmentation::Erode0");
-
-  memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
-
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-
-  for (unsigned int ir = m_RegionOfInterest[1]; ir < m_RegionOfInterest[3]; ir++)
+  if (m_RegionOfInterest[0] >= m_RegionOfInterest[2] || m_RegionOfInterest[1] >= m_RegionOfInterest[3])
   {
-    unsigned int ic = m_RegionOfInterest[0];
-    unsigned int p_base = ir * m_FrameSize[0];
-
-    PlusFidSegmentation::PixelType dval = ErodePoint0(image, ir, ic);   // find lowest pixel intensity in surrounding region ( positions +/- 8 of current pixel position)
-    dest[p_base + ic] = dval; // p_base+ic = current pixel
-
-    for (ic++; ic < m_RegionOfInterest[2]; ic++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[p_base + ic + barSize];
-      PlusFidSegmentation::PixelType del_val = image[p_base + ic - 1 - barSize];
-
-      dval = new_val <= dval ? new_val  : // dval = new val if new val is less than or equal to dval
-             del_val > dval ? std::min(dval, new_val) :   // if del val is greater than dval, dval= min of dval and new val
-             ErodePoint0(image, ir, ic);   //else dval = result of erode function
-
-      dest[ir * m_FrameSize[0] + ic] = dval; // update new "eroded" picture
-    }
+    return;
   }
-}
-
-//-----------------------------------------------------------------------------
-
-inline PlusFidSegmentation::PixelType PlusFidSegmentation::ErodePoint45(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic)
-{
-  //LOG_TRACE("FidSegmentation::ErodePoint45");
 
+  // The bar is a line of lineLength pixels, going one row down and columnStep columns right in each step. The van Herk/Gil-Werman
+  // scans run down (forward) and up (backward) along the bar direction, row by row, so that each step combines two image rows
+  // and the rows are aligned to blocks of lineLength rows.
   const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-
-  PlusFidSegmentation::PixelType dval = UCHAR_MAX;
-  unsigned int p = (ir + barSize) * m_FrameSize[0] + ic - barSize;
-  unsigned int p_max = (ir - barSize) * m_FrameSize[0] + ic + barSize;
-
-  for (; p >= p_max; p = p - m_FrameSize[0] + 1)
-  {
-    if (image[p] < dval)
+  const unsigned int lineLength = 2 * barSize + 1;
+  const unsigned int columnMargin = (columnStep != 0) ? barSize : 0;
+  const unsigned int firstRow = m_RegionOfInterest[1] - barSize;
+  const unsigned int numberOfRows = m_RegionOfInterest[3] - m_RegionOfInterest[1] + 2 * barSize;
+  const unsigned int firstColumn = m_RegionOfInterest[0] - columnMargin;
+  const unsigned int numberOfColumns = m_RegionOfInterest[2] - m_RegionOfInterest[0] + 2 * columnMargin;
+  ReserveMorphologyBuffers(static_cast<size_t>(numberOfRows) * numberOfColumns);
+  PlusFidSegmentation::PixelType* forward = &m_MorphologyForward[0];
+  PlusFidSegmentation::PixelType* backward = &m_MorphologyBackward[0];
+
+  // Pixels at the row ends that have no previous pixel along the bar inside the buffer are only copied. Their values are not used
+  // for the result: within a block the bar of a pixel in the region of interest never leaves the columns of the buffer.
+  const int forwardFirstColumn = (columnStep > 0) ? 1 : 0;
+  const int forwardEndColumn = (columnStep < 0) ? numberOfColumns - 1 : numberOfColumns;
+  for (unsigned int rowIndex = 0, positionInBlock = 0; rowIndex < numberOfRows; rowIndex++, positionInBlock = (positionInBlock + 1 == lineLength) ? 0 : positionInBlock + 1)
+  {
+    const PlusFidSegmentation::PixelType* samples = image + (firstRow + rowIndex) * m_FrameSize[0] + firstColumn;
+    PlusFidSegmentation::PixelType* current = forward + rowIndex * numberOfColumns;
+    if (positionInBlock == 0)
     {
-      dval = image[p];
-    }
-    if (image[p] == 0)
-    {
-      break;
+      memcpy(current, samples, numberOfColumns * sizeof(PlusFidSegmentation::PixelType));
+      continue;
     }
+    current[0] = samples[0];
+    current[numberOfColumns - 1] = samples[numberOfColumns - 1];
+    const PlusFidSegmentation::PixelType* previous = current - numberOfColumns - columnStep;
+    CombineRows<Operator>(current + forwardFirstColumn, previous + forwardFirstColumn, samples + forwardFirstColumn, forwardEndColumn - forwardFirstColumn);
   }
-  return dval;
-}
-
-//-----------------------------------------------------------------------------
 
-void PlusFidSegmentation::Erode45(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
-{
-  //LOG_TRACE("FidSegmentation::Erode45");
-
-  memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-
-  /* Down the left side. */
-  for (unsigned int sr = m_RegionOfInterest[1]; sr < m_RegionOfInterest[3]; sr++)
+  const int backwardFirstColumn = (columnStep < 0) ? 1 : 0;
+  const int backwardEndColumn = (columnStep > 0) ? numberOfColumns - 1 : numberOfColumns;
+  for (unsigned int rowIndex = numberOfRows; rowIndex-- > 0;)
   {
-    unsigned int ir = sr;
-    unsigned int ic = m_RegionOfInterest[0];
-
-    PlusFidSegmentation::PixelType dval = ErodePoint45(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval;
-
-    for (ir--, ic++; ir >= m_RegionOfInterest[1] && ic < m_RegionOfInterest[2]; ir--, ic++)
+    const PlusFidSegmentation::PixelType* samples = image + (firstRow + rowIndex) * m_FrameSize[0] + firstColumn;
+    PlusFidSegmentation::PixelType* current = backward + rowIndex * numberOfColumns;
+    if (rowIndex + 1 == numberOfRows || rowIndex % lineLength == lineLength - 1)
     {
-      PlusFidSegmentation::PixelType new_val = image[(ir - barSize) * m_FrameSize[0] + (ic + barSize)];
-      PlusFidSegmentation::PixelType del_val = image[(ir + 1 + barSize) * m_FrameSize[0] + (ic - 1 - barSize)];
-
-      dval = new_val <= dval ? new_val :
-             del_val > dval ? std::min(dval, new_val) :
-             ErodePoint45(image, ir, ic);
-
-      dest[ir * m_FrameSize[0] + ic] = dval;
+      memcpy(current, samples, numberOfColumns * sizeof(PlusFidSegmentation::PixelType));
+      continue;
     }
+    current[0] = samples[0];
+    current[numberOfColumns - 1] = samples[numberOfColumns - 1];
+    const PlusFidSegmentation::PixelType* next = current + numberOfColumns + columnStep;
+    CombineRows<Operator>(current + backwardFirstColumn, next + backwardFirstColumn, samples + backwardFirstColumn, backwardEndColumn - backwardFirstColumn);
   }
 
-  /* Across the bottom */
-  for (unsigned int sc = m_RegionOfInterest[0]; sc < m_RegionOfInterest[2]; sc++)
+  // The bar of a pixel spans at most two blocks: the backward scan from its top end and the forward scan from its bottom end
+  const int topColumnOffset = static_cast<int>(columnMargin) - columnStep * static_cast<int>(barSize);
+  const int bottomColumnOffset = static_cast<int>(columnMargin) + columnStep * static_cast<int>(barSize);
+  const unsigned int numberOfRoiColumns = m_RegionOfInterest[2] - m_RegionOfInterest[0];
+  for (unsigned int ir = m_RegionOfInterest[1]; ir < m_RegionOfInterest[3]; ir++)
   {
-    unsigned int ic = sc;
-    unsigned int ir = m_RegionOfInterest[3] - 1;
-
-    PlusFidSegmentation::PixelType dval = ErodePoint45(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval;
-
-    for (ir--, ic++; ir >= m_RegionOfInterest[1] && ic < m_RegionOfInterest[2]; ir--, ic++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[(ir - barSize) * m_FrameSize[0] + (ic + barSize)];
-      PlusFidSegmentation::PixelType del_val = image[(ir + 1 + barSize) * m_FrameSize[0] + (ic - 1 - barSize)];
-
-      dval = new_val <= dval ? new_val :
-             del_val > dval ? std::min(dval, new_val) :
-             ErodePoint45(image, ir, ic);
-
-      dest[ir * m_FrameSize[0] + ic] = dval;
-    }
+    const unsigned int rowIndex = ir - firstRow;
+    CombineRows<Operator>(dest + ir * m_FrameSize[0] + m_RegionOfInterest[0],
+                          backward + (rowIndex - barSize) * numberOfColumns + topColumnOffset,
+                          forward + (rowIndex + barSize) * numberOfColumns + bottomColumnOffset, numberOfRoiColumns);
   }
 }
 
 //-----------------------------------------------------------------------------
 
-inline PlusFidSegmentation::PixelType PlusFidSegmentation::ErodePoint90(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic)
+void PlusFidSegmentation::Erode0(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
-  //LOG_TRACE("FidSegmentation::ErodePoint90");
+  //LOG_TRACE("FidSegmentation::Erode0");
+
+  memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
+  if (m_RegionOfInterest[0] >= m_RegionOfInterest[2] || m_RegionOfInterest[1] >= m_RegionOfInterest[3])
+  {
+    return;
+  }
 
   const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-  PlusFidSegmentation::PixelType dval = UCHAR_MAX;
-  unsigned int p = (ir - barSize) * m_FrameSize[0] + ic;
-  unsigned int p_max = (ir + barSize) * m_FrameSize[0] + ic;
+  const unsigned int numberOfColumns = m_RegionOfInterest[2] - m_RegionOfInterest[0];
+  ReserveMorphologyBuffers(numberOfColumns + 2 * barSize);
 
-  for (; p <= p_max; p += m_FrameSize[0])
+  for (unsigned int ir = m_RegionOfInterest[1]; ir < m_RegionOfInterest[3]; ir++)
   {
-    if (image[p] < dval)
-    {
-      dval = image[p];
-    }
-    if (image[p] == 0)
-    {
-      break;
-    }
+    // lowest pixel intensity of the bar (positions +/- bar size of the current pixel position)
+    unsigned int p_base = ir * m_FrameSize[0];
+    RowMorphology<ErodeOperator>(dest + p_base + m_RegionOfInterest[0], image + p_base + m_RegionOfInterest[0] - barSize,
+                                 numberOfColumns, barSize, &m_MorphologyForward[0], &m_MorphologyBackward[0]);
   }
-  return dval;
 }
 
 //-----------------------------------------------------------------------------
 
-void PlusFidSegmentation::Erode90(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
+void PlusFidSegmentation::Erode45(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
-  //LOG_TRACE("FidSegmentation::Erode90");
+  //LOG_TRACE("FidSegmentation::Erode45");
 
   memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
-
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-
-  for (unsigned int ic = m_RegionOfInterest[0]; ic < m_RegionOfInterest[2]; ic++)
-  {
-    unsigned int ir = m_RegionOfInterest[1];
-
-    PlusFidSegmentation::PixelType dval = ErodePoint90(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval;
-
-    for (ir++; ir < m_RegionOfInterest[3]; ir++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[(ir + barSize) * m_FrameSize[0] + ic];
-      PlusFidSegmentation::PixelType del_val = image[(ir - 1 - barSize) * m_FrameSize[0] + ic];
-
-      dval = new_val <= dval ? new_val :
-             del_val > dval ? std::min(dval, new_val) :
-             ErodePoint90(image, ir, ic);
-
-      dest[ir * m_FrameSize[0] + ic] = dval;
-    }
-  }
+  // one row down along the bar is one column to the left
+  LineMorphology<ErodeOperator>(dest, image, -1);
 }
 
 //-----------------------------------------------------------------------------
 
-inline PlusFidSegmentation::PixelType PlusFidSegmentation::ErodePoint135(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic)
+void PlusFidSegmentation::Erode90(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
-  //LOG_TRACE("FidSegmentation::ErodePoint135");
-
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-  PlusFidSegmentation::PixelType dval = UCHAR_MAX;
-  unsigned int p = (ir - barSize) * m_FrameSize[0] + ic - barSize;
-  unsigned int p_max = (ir + barSize) * m_FrameSize[0] + ic + barSize;
+  //LOG_TRACE("FidSegmentation::Erode90");
 
-  for (; p <= p_max; p = p + m_FrameSize[0] + 1)
-  {
-    if (image[p] < dval)
-    {
-      dval = image[p];
-    }
-    if (image[p] == 0)
-    {
-      break;
-    }
-  }
-  return dval;
+  memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
+  LineMorphology<ErodeOperator>(dest, image, 0);
 }
 
 //-----------------------------------------------------------------------------
@@ -524,52 +512,8 @@ void PlusFidSegmentation::Erode135(PlusFidSegmentation::PixelType* dest, PlusFid
   //LOG_TRACE("FidSegmentation::Erode135");
 
   memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
-
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-
-  /* Up the left side. */
-  for (unsigned int sr = m_RegionOfInterest[3] - 1; sr >= m_RegionOfInterest[1]; sr--)
-  {
-    unsigned int ir = sr;
-    unsigned int ic = m_RegionOfInterest[0];
-
-    PlusFidSegmentation::PixelType dval = ErodePoint135(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval;
-
-    for (ir++, ic++; ir < m_RegionOfInterest[3] && ic < m_RegionOfInterest[2]; ir++, ic++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[(ir + barSize) * m_FrameSize[0] + (ic + barSize)];
-      PlusFidSegmentation::PixelType del_val = image[(ir - 1 - barSize) * m_FrameSize[0] + (ic - 1 - barSize)];
-
-      dval = new_val <= dval ? new_val :
-             del_val > dval ? std::min(dval, new_val) :
-             ErodePoint135(image, ir, ic);
-
-      dest[ir * m_FrameSize[0] + ic] = dval;
-    }
-  }
-
-  /* Across the top. */
-  for (unsigned int sc = m_RegionOfInterest[0]; sc < m_RegionOfInterest[2]; sc++)
-  {
-    unsigned int ic = sc;
-    unsigned int ir = m_RegionOfInterest[1];
-
-    PlusFidSegmentation::PixelType dval = ErodePoint135(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval;
-
-    for (ir++, ic++; ir < m_RegionOfInterest[3] && ic < m_RegionOfInterest[2]; ir++, ic++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[(ir + barSize) * m_FrameSize[0] + (ic + barSize)];
-      PlusFidSegmentation::PixelType del_val = image[(ir - 1 - barSize) * m_FrameSize[0] + (ic - 1 - barSize)];
-
-      dval = new_val <= dval ? new_val :
-             del_val > dval ? std::min(dval, new_val) :
-             ErodePoint135(image, ir, ic);
-
-      dest[ir * m_FrameSize[0] + ic] = dval;
-    }
-  }
+  // one row down along the bar is one column to the right
+  LineMorphology<ErodeOperator>(dest, image, 1);
 }
 
 //-----------------------------------------------------------------------------
@@ -578,240 +522,147 @@ void PlusFidSegmentation::ErodeCircle(PlusFidSegmentation::PixelType* dest, Plus
 {
   //LOG_TRACE("FidSegmentation::ErodeCircle");
 
-  unsigned int slen = m_MorphologicalCircle.size();
-
   memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
+  if (m_RegionOfInterest[0] >= m_RegionOfInterest[2] || m_RegionOfInterest[1] >= m_RegionOfInterest[3])
+  {
+    return;
+  }
+
+  // The circle is the union of horizontal runs that are symmetric to the center, one for each row offset
+  // (X is the row offset, Y is the column offset). Row offsets are grouped by the half width of their run.
+  std::map<int, int> runHalfWidths;
+  for (unsigned int sp = 0; sp < m_MorphologicalCircle.size(); sp++)
+  {
+    int& halfWidth = runHalfWidths.insert(std::make_pair(m_MorphologicalCircle[sp].X, 0)).first->second;
+    halfWidth = std::max(halfWidth, std::abs(m_MorphologicalCircle[sp].Y));
+  }
+  std::map<int, std::vector<int> > rowOffsetsOfHalfWidth;
+  int maxHalfWidth = 0;
+  for (std::map<int, int>::iterator runIt = runHalfWidths.begin(); runIt != runHalfWidths.end(); ++runIt)
+  {
+    rowOffsetsOfHalfWidth[runIt->second].push_back(runIt->first);
+    maxHalfWidth = std::max(maxHalfWidth, runIt->second);
+  }
+
+  const unsigned int numberOfColumns = m_RegionOfInterest[2] - m_RegionOfInterest[0];
+  ReserveMorphologyBuffers(numberOfColumns + 2 * maxHalfWidth);
+  std::vector<PlusFidSegmentation::PixelType> runMinimum(numberOfColumns);
 
   for (unsigned int ir = m_RegionOfInterest[1]; ir < m_RegionOfInterest[3]; ir++)
   {
-    for (unsigned int ic = m_RegionOfInterest[0]; ic < m_RegionOfInterest[2]; ic++)
+    memset(dest + ir * m_FrameSize[0] + m_RegionOfInterest[0], UCHAR_MAX, numberOfColumns * sizeof(PlusFidSegmentation::PixelType));
+  }
+
+  // Erode each image row once for each run width, then combine the result into all the rows that use a run of that width
+  for (std::map<int, std::vector<int> >::iterator widthIt = rowOffsetsOfHalfWidth.begin(); widthIt != rowOffsetsOfHalfWidth.end(); ++widthIt)
+  {
+    const unsigned int halfWidth = static_cast<unsigned int>(widthIt->first);
+    const std::vector<int>& rowOffsets = widthIt->second;
+    const int firstSourceRow = static_cast<int>(m_RegionOfInterest[1]) + rowOffsets.front();
+    const int endSourceRow = static_cast<int>(m_RegionOfInterest[3]) + rowOffsets.back();
+    for (int sr = firstSourceRow; sr < endSourceRow; sr++)
     {
-      PlusFidSegmentation::PixelType dval = UCHAR_MAX;
-      for (unsigned int sp = 0; sp < slen; sp++)
+      RowMorphology<ErodeOperator>(&runMinimum[0], image + sr * m_FrameSize[0] + m_RegionOfInterest[0] - halfWidth,
+                                   numberOfColumns, halfWidth, &m_MorphologyForward[0], &m_MorphologyBackward[0]);
+      for (unsigned int offsetIndex = 0; offsetIndex < rowOffsets.size(); offsetIndex++)
       {
-        int sr = ir + m_MorphologicalCircle[sp].X;
-        int sc = ic + m_MorphologicalCircle[sp].Y;
-        PlusFidSegmentation::PixelType pixSrc = image[sr * m_FrameSize[0] + sc];
-
-        if (pixSrc < dval)
-        {
-          dval = pixSrc;
-        }
-
-        if (pixSrc == 0)
+        int ir = sr - rowOffsets[offsetIndex];
+        if (ir >= static_cast<int>(m_RegionOfInterest[1]) && ir < static_cast<int>(m_RegionOfInterest[3]))
         {
-          break;
+          PlusFidSegmentation::PixelType* destRow = dest + ir * m_FrameSize[0] + m_RegionOfInterest[0];
+          CombineRows<ErodeOperator>(destRow, destRow, &runMinimum[0], numberOfColumns);
         }
       }
-
-      dest[ir * m_FrameSize[0] + ic] = dval;
     }
   }
-}
-
-//-----------------------------------------------------------------------------
-
-inline PlusFidSegmentation::PixelType PlusFidSegmentation::DilatePoint0(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic)
-{
-  //LOG_TRACE("FidSegmentation::DilatePoint0");
-
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-  PlusFidSegmentation::PixelType dval = 0;
-  unsigned int p = ir * m_FrameSize[0] + ic - barSize;
-  unsigned int p_max = ir * m_FrameSize[0] + ic + barSize;
 
-  for (; p <= p_max; p++)
+  // Only the pixels inside the valid pixel mask are processed
+  std::vector< std::pair<unsigned int, unsigned int> > columnRanges;
+  for (unsigned int ir = m_RegionOfInterest[1]; ir < m_RegionOfInterest[3]; ir++)
   {
-    if (image[p] > dval)
+    GetProcessedColumnRanges(ir, columnRanges);
+    unsigned int ic = m_RegionOfInterest[0];
+    for (unsigned int rangeIndex = 0; rangeIndex < columnRanges.size(); rangeIndex++)
     {
-      dval = image[p];
+      memset(dest + ir * m_FrameSize[0] + ic, 0, (columnRanges[rangeIndex].first - ic) * sizeof(PlusFidSegmentation::PixelType));
+      ic = columnRanges[rangeIndex].second;
     }
+    memset(dest + ir * m_FrameSize[0] + ic, 0, (m_RegionOfInterest[2] - ic) * sizeof(PlusFidSegmentation::PixelType));
   }
-
-  return dval;
 }
 
 //-----------------------------------------------------------------------------
 
-void PlusFidSegmentation::Dilate0(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
+void PlusFidSegmentation::GetProcessedColumnRanges(unsigned int row, std::vector< std::pair<unsigned int, unsigned int> >& columnRanges)
 {
-  //LOG_TRACE("FidSegmentation::Dilate0");
-
-  memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
+  columnRanges.clear();
 
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-
-  for (unsigned int ir = m_RegionOfInterest[1]; ir < m_RegionOfInterest[3]; ir++)
+  if (m_ValidPixelMask.IsEmpty()
+      || m_ValidPixelMask.GetWidth() != static_cast<int>(m_FrameSize[0])
+      || m_ValidPixelMask.GetHeight() != static_cast<int>(m_FrameSize[1]))
   {
-    unsigned int ic = m_RegionOfInterest[0];
-    unsigned int p_base = ir * m_FrameSize[0];
-
-    PlusFidSegmentation::PixelType dval = DilatePoint0(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval;
-
-    for (ic++; ic < m_RegionOfInterest[2]; ic++)
+    if (m_RegionOfInterest[0] < m_RegionOfInterest[2])
     {
-      PlusFidSegmentation::PixelType new_val = image[p_base + ic + barSize];
-      PlusFidSegmentation::PixelType del_val = image[p_base + ic - 1 - barSize];
-
-      dval = new_val >= dval ? new_val :
-             (del_val < dval ? std::max(dval, new_val) :
-              DilatePoint0(image, ir, ic));
-      dest[ir * m_FrameSize[0] + ic] = dval;
+      columnRanges.push_back(std::make_pair(m_RegionOfInterest[0], m_RegionOfInterest[2]));
     }
+    return;
   }
-}
-
-//-----------------------------------------------------------------------------
-
-inline PlusFidSegmentation::PixelType PlusFidSegmentation::DilatePoint45(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic)
-{
-  //LOG_TRACE("FidSegmentation::DilatePoint45");
 
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-  PlusFidSegmentation::PixelType dval = 0;
-  unsigned int p = (ir + barSize) * m_FrameSize[0] + ic - barSize;
-  unsigned int p_max = (ir - barSize) * m_FrameSize[0] + ic + barSize;
-
-  while (p >= p_max)
+  int numberOfSpans = 0;
+  const PlusValidPixelMask::Span* spans = m_ValidPixelMask.GetRowSpans(row, numberOfSpans);
+  for (int spanIndex = 0; spanIndex < numberOfSpans; spanIndex++)
   {
-    if (image[p] > dval)
+    unsigned int firstColumn = std::max<unsigned int>(spans[spanIndex].FirstColumn, m_RegionOfInterest[0]);
+    unsigned int endColumn = std::min<unsigned int>(spans[spanIndex].LastColumn + 1, m_RegionOfInterest[2]);
+    if (firstColumn < endColumn)
     {
-      dval = image[p];
-    }
-    if (p - m_FrameSize[0] + 1 > p)
-    {
-      // unsigned int underflow, adjust
-      p = 0;
-    }
-    else
-    {
-      p = p - m_FrameSize[0] + 1;
+      columnRanges.push_back(std::make_pair(firstColumn, endColumn));
     }
   }
-
-  return dval;
 }
 
 //-----------------------------------------------------------------------------
 
-void PlusFidSegmentation::Dilate45(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
+void PlusFidSegmentation::Dilate0(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
-  //LOG_TRACE("FidSegmentation::Dilate45");
+  //LOG_TRACE("FidSegmentation::Dilate0");
 
   memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-
-  /* Down the left side. */
-  for (unsigned int sr = m_RegionOfInterest[1]; sr < m_RegionOfInterest[3]; sr++)
+  if (m_RegionOfInterest[0] >= m_RegionOfInterest[2] || m_RegionOfInterest[1] >= m_RegionOfInterest[3])
   {
-    unsigned int ir = sr;
-    unsigned int ic = m_RegionOfInterest[0];
-
-    PlusFidSegmentation::PixelType dval = DilatePoint45(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval ;
-    for (ir--, ic++; ir >= m_RegionOfInterest[1] && ic < m_RegionOfInterest[2]; ir--, ic++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[(ir - barSize) * m_FrameSize[0] + (ic + barSize)];
-      PlusFidSegmentation::PixelType del_val = image[(ir + 1 + barSize) * m_FrameSize[0] + (ic - 1 - barSize)];
-
-      dval = new_val >= dval ? new_val :
-             (del_val < dval ? std::max(dval, new_val) :
-              DilatePoint45(image, ir, ic));
-      dest[ir * m_FrameSize[0] + ic] = dval ;
-    }
-  }
-
-  /* Across the bottom */
-  for (unsigned int sc = m_RegionOfInterest[0]; sc < m_RegionOfInterest[2]; sc++)
-  {
-    unsigned int ic = sc;
-    unsigned int ir = m_RegionOfInterest[3] - 1;
-
-    PlusFidSegmentation::PixelType dval = DilatePoint45(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval ;
-    for (ir--, ic++; ir >= m_RegionOfInterest[1] && ic < m_RegionOfInterest[2]; ir--, ic++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[(ir - barSize) * m_FrameSize[0] + (ic + barSize)];
-      PlusFidSegmentation::PixelType del_val = image[(ir + 1 + barSize) * m_FrameSize[0] + (ic - 1 - barSize)];
-
-      dval = new_val >= dval ? new_val :
-             (del_val < dval ? std::max(dval, new_val) :
-              DilatePoint45(image, ir, ic));
-      dest[ir * m_FrameSize[0] + ic] = dval ;
-    }
+    return;
   }
-}
-
-//-----------------------------------------------------------------------------
-
-inline PlusFidSegmentation::PixelType PlusFidSegmentation::DilatePoint90(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic)
-{
-  //LOG_TRACE("FidSegmentation::DilatePoint90");
 
   const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-  PlusFidSegmentation::PixelType dval = 0;
-  unsigned int p = (ir - barSize) * m_FrameSize[0] + ic;
-  unsigned int p_max = (ir + barSize) * m_FrameSize[0] + ic;
+  const unsigned int numberOfColumns = m_RegionOfInterest[2] - m_RegionOfInterest[0];
+  ReserveMorphologyBuffers(numberOfColumns + 2 * barSize);
 
-  for (; p <= p_max; p += m_FrameSize[0])
+  for (unsigned int ir = m_RegionOfInterest[1]; ir < m_RegionOfInterest[3]; ir++)
   {
-    if (image[p] > dval)
-    {
-      dval = image[p];
-    }
+    unsigned int p_base = ir * m_FrameSize[0];
+    RowMorphology<DilateOperator>(dest + p_base + m_RegionOfInterest[0], image + p_base + m_RegionOfInterest[0] - barSize,
+                                  numberOfColumns, barSize, &m_MorphologyForward[0], &m_MorphologyBackward[0]);
   }
-  return dval;
 }
 
 //-----------------------------------------------------------------------------
 
-void PlusFidSegmentation::Dilate90(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
+void PlusFidSegmentation::Dilate45(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
-  //LOG_TRACE("FidSegmentation::Dilate90");
+  //LOG_TRACE("FidSegmentation::Dilate45");
 
   memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-
-  for (unsigned int ic = m_RegionOfInterest[0]; ic < m_RegionOfInterest[2]; ic++)
-  {
-    unsigned int ir = m_RegionOfInterest[1];
-
-    PlusFidSegmentation::PixelType dval = DilatePoint90(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval ;
-    for (ir++; ir < m_RegionOfInterest[3]; ir++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[(ir + barSize) * m_FrameSize[0] + ic];
-      PlusFidSegmentation::PixelType del_val = image[(ir - 1 - barSize) * m_FrameSize[0] + ic];
-
-      dval = new_val >= dval ? new_val :
-             (del_val < dval ? std::max(dval, new_val) :
-              DilatePoint90(image, ir, ic));
-
-      dest[ir * m_FrameSize[0] + ic] = dval ;
-    }
-  }
+  LineMorphology<DilateOperator>(dest, image, -1);
 }
 
 //-----------------------------------------------------------------------------
 
-inline PlusFidSegmentation::PixelType PlusFidSegmentation::DilatePoint135(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic)
+void PlusFidSegmentation::Dilate90(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
-  //LOG_TRACE("FidSegmentation::DilatePoint135");
-
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-  PlusFidSegmentation::PixelType dval = 0;
-  unsigned int p = (ir - barSize) * m_FrameSize[0] + ic - barSize;
-  unsigned int p_max = (ir + barSize) * m_FrameSize[0] + ic + barSize;
+  //LOG_TRACE("FidSegmentation::Dilate90");
 
-  for (; p <= p_max; p = p + m_FrameSize[0] + 1)
-  {
-    if (image[p] > dval)
-    {
-      dval = image[p];
-    }
-  }
-  return dval;
+  memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
+  LineMorphology<DilateOperator>(dest, image, 0);
 }
 
 //-----------------------------------------------------------------------------
@@ -821,47 +672,7 @@ void PlusFidSegmentation::Dilate135(PlusFidSegmentation::PixelType* dest, PlusFi
   //LOG_TRACE("FidSegmentation::Dilate135");
 
   memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-
-  /* Up the left side. */
-  for (unsigned int sr = m_RegionOfInterest[3] - 1; sr >= m_RegionOfInterest[1]; sr--)
-  {
-    unsigned int ir = sr;
-    unsigned int ic = m_RegionOfInterest[0];
-
-    PlusFidSegmentation::PixelType dval = DilatePoint135(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval ;
-    for (ir++, ic++; ir < m_RegionOfInterest[3] && ic < m_RegionOfInterest[2]; ir++, ic++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[(ir + barSize) * m_FrameSize[0] + (ic + barSize)];
-      PlusFidSegmentation::PixelType del_val = image[(ir - 1 - barSize) * m_FrameSize[0] + (ic - 1 - barSize)];
-
-      dval = new_val >= dval ? new_val :
-             (del_val < dval ? std::max(dval, new_val) :
-              DilatePoint135(image, ir, ic));
-      dest[ir * m_FrameSize[0] + ic] = dval;
-    }
-  }
-
-  /* Across the top. */
-  for (unsigned int sc = m_RegionOfInterest[0]; sc < m_RegionOfInterest[2]; sc++)
-  {
-    unsigned int ic = sc;
-    unsigned int ir = m_RegionOfInterest[1];
-
-    PlusFidSegmentation::PixelType dval = DilatePoint135(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval;
-    for (ir++, ic++; ir < m_RegionOfInterest[3] && ic < m_RegionOfInterest[2]; ir++, ic++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[(ir + barSize) * m_FrameSize[0] + (ic + barSize)];
-      PlusFidSegmentation::PixelType del_val = image[(ir - 1 - barSize) * m_FrameSize[0] + (ic - 1 - barSize)];
-
-      dval = new_val >= dval ? new_val :
-             (del_val < dval ? std::max(dval, new_val) :
-              DilatePoint135(image, ir, ic));
-      dest[ir * m_FrameSize[0] + ic] = dval;
-    }
-  }
+  LineMorphology<DilateOperator>(dest, image, 1);
 }
 
 //-----------------------------------------------------------------------------
@@ -937,34 +748,40 @@ void PlusFidSegmentation::DilateCircle(PlusFidSegmentation::PixelType* dest, Plu
   delete [] sr_exist;
 
   memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
+  std::vector< std::pair<unsigned int, unsigned int> > columnRanges;
   for (unsigned int ir = m_RegionOfInterest[1]; ir < m_RegionOfInterest[3]; ir++)
   {
-    unsigned int ic = m_RegionOfInterest[0];
-
-    PlusFidSegmentation::PixelType dval = DilatePoint(image, ir, ic, shape, slen);
-    PlusFidSegmentation::PixelType last = dest[ir * m_FrameSize[0] + ic] = dval;
-
-    for (ic++; ic < m_RegionOfInterest[2]; ic++)
+    GetProcessedColumnRanges(ir, columnRanges);
+    for (unsigned int rangeIndex = 0; rangeIndex < columnRanges.size(); rangeIndex++)
     {
-      PlusFidSegmentation::PixelType dval = DilatePoint(image, ir, ic, newDots, nNewDots);
+      // The first pixel of each range is computed from the whole shape, the next ones incrementally
+      unsigned int ic = columnRanges[rangeIndex].first;
 
-      if (dval < last)
+      PlusFidSegmentation::PixelType dval = DilatePoint(image, ir, ic, shape, slen);
+      PlusFidSegmentation::PixelType last = dest[ir * m_FrameSize[0] + ic] = dval;
+
+      for (ic++; ic < columnRanges[rangeIndex].second; ic++)
       {
-        for (int sp = 0; sp < nOldDots; sp++)
+        PlusFidSegmentation::PixelType dval = DilatePoint(image, ir, ic, newDots, nNewDots);
+
+        if (dval < last)
         {
-          unsigned int sr = ir + oldDots[sp].Y;
-          unsigned int sc = ic + oldDots[sp].X;
-          if (image[sr * m_FrameSize[0] + sc] > dval)
-          {
-            dval = image[sr * m_FrameSize[0] + sc];
-          }
-          if (image[sr * m_FrameSize[0] + sc] == last)
+          for (int sp = 0; sp < nOldDots; sp++)
           {
-            break;
+            unsigned int sr = ir + oldDots[sp].Y;
+            unsigned int sc = ic + oldDots[sp].X;
+            if (image[sr * m_FrameSize[0] + sc] > dval)
+            {
+              dval = image[sr * m_FrameSize[0] + sc];
+            }
+            if (image[sr * m_FrameSize[0] + sc] == last)
+            {
+              break;
+            }
           }
         }
+        last = dest[ir * m_FrameSize[0] + ic] = dval ;
       }
-      last = dest[ir * m_FrameSize[0] + ic] = dval ;
     }
   }
   delete [] newDots;
@@ -1326,16 +1143,16 @@ bool PlusFidSegmentation::Cluster(bool& tooManyCandidates)
           PlusFidDot dot = testPosition.back();
           testPosition.pop_back();
 
-          ClusteringAddNeighbors(m_Working, dot.GetY() - 1, dot.GetX() - 1, testPosition, setPosition, valuesOfPosition);
-          ClusteringAddNeighbors(m_Working, dot.GetY() - 1, dot.GetX(), testPosition, setPosition, valuesOfPosition);
-          ClusteringAddNeighbors(m_Working, dot.GetY() - 1, dot.GetX() + 1, testPosition, setPosition, valuesOfPosition);
+          ClusteringAddNeighbors(&m_Working[0], dot.GetY() - 1, dot.GetX() - 1, testPosition, setPosition, valuesOfPosition);
+          ClusteringAddNeighbors(&m_Working[0], dot.GetY() - 1, dot.GetX(), testPosition, setPosition, valuesOfPosition);
+          ClusteringAddNeighbors(&m_Working[0], dot.GetY() - 1, dot.GetX() + 1, testPosition, setPosition, valuesOfPosition);
 
-          ClusteringAddNeighbors(m_Working, dot.GetY(), dot.GetX() - 1, testPosition, setPosition, valuesOfPosition);
-          ClusteringAddNeighbors(m_Working, dot.GetY(), dot.GetX() + 1, testPosition, setPosition, valuesOfPosition);
+          ClusteringAddNeighbors(&m_Working[0], dot.GetY(), dot.GetX() - 1, testPosition, setPosition, valuesOfPosition);
+          ClusteringAddNeighbors(&m_Working[0], dot.GetY(), dot.GetX() + 1, testPosition, setPosition, valuesOfPosition);
 
-          ClusteringAddNeighbors(m_Working, dot.GetY() + 1, dot.GetX() - 1, testPosition, setPosition, valuesOfPosition);
-          ClusteringAddNeighbors(m_Working, dot.GetY() + 1, dot.GetX(), testPosition, setPosition, valuesOfPosition);
-          ClusteringAddNeighbors(m_Working, dot.GetY() + 1, dot.GetX() + 1, testPosition, setPosition, valuesOfPosition);
+          ClusteringAddNeighbors(&m_Working[0], dot.GetY() + 1, dot.GetX() - 1, testPosition, setPosition, valuesOfPosition);
+          ClusteringAddNeighbors(&m_Working[0], dot.GetY() + 1, dot.GetX(), testPosition, setPosition, valuesOfPosition);
+          ClusteringAddNeighbors(&m_Working[0], dot.GetY() + 1, dot.GetX() + 1, testPosition, setPosition, valuesOfPosition);
         }
 
         double dest_r = 0, dest_c = 0, total = 0;
@@ -1409,92 +1226,92 @@ void PlusFidSegmentation::MorphologicalOperations()
   // Morphological operations with a stick-like structuring element
   if (m_DebugOutput)
   {
-    WritePng(m_Working, "seg01-initial.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Working[0], "seg01-initial.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Erode0(m_Eroded, m_Working);
+  Erode0(&m_Eroded[0], &m_Working[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Eroded, "seg02-morph-bar-deg0-erode.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Eroded[0], "seg02-morph-bar-deg0-erode.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Dilate0(m_Dilated, m_Eroded);
+  Dilate0(&m_Dilated[0], &m_Eroded[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Dilated, "seg03-morph-bar-deg0-dilated.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Dilated[0], "seg03-morph-bar-deg0-dilated.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Subtract(m_Working, m_Dilated);
+  Subtract(&m_Working[0], &m_Dilated[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Working, "seg04-morph-bar-deg0-final.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Working[0], "seg04-morph-bar-deg0-final.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Erode45(m_Eroded, m_Working);
+  Erode45(&m_Eroded[0], &m_Working[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Eroded, "seg05-morph-bar-deg45-erode.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Eroded[0], "seg05-morph-bar-deg45-erode.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Dilate45(m_Dilated, m_Eroded);
+  Dilate45(&m_Dilated[0], &m_Eroded[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Dilated, "seg06-morph-bar-deg45-dilated.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Dilated[0], "seg06-morph-bar-deg45-dilated.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Subtract(m_Working, m_Dilated);
+  Subtract(&m_Working[0], &m_Dilated[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Working, "seg07-morph-bar-deg45-final.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Working[0], "seg07-morph-bar-deg45-final.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Erode90(m_Eroded, m_Working);
+  Erode90(&m_Eroded[0], &m_Working[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Eroded, "seg08-morph-bar-deg90-erode.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Eroded[0], "seg08-morph-bar-deg90-erode.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Dilate90(m_Dilated, m_Eroded);
+  Dilate90(&m_Dilated[0], &m_Eroded[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Dilated, "seg09-morph-bar-deg90-dilated.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Dilated[0], "seg09-morph-bar-deg90-dilated.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Subtract(m_Working, m_Dilated);
+  Subtract(&m_Working[0], &m_Dilated[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Working, "seg10-morph-bar-deg90-final.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Working[0], "seg10-morph-bar-deg90-final.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Erode135(m_Eroded, m_Working);
+  Erode135(&m_Eroded[0], &m_Working[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Eroded, "seg11-morph-bar-deg135-erode.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Eroded[0], "seg11-morph-bar-deg135-erode.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Dilate135(m_Dilated, m_Eroded);
+  Dilate135(&m_Dilated[0], &m_Eroded[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Dilated, "seg12-morph-bar-deg135-dilated.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Dilated[0], "seg12-morph-bar-deg135-dilated.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Subtract(m_Working, m_Dilated);
+  Subtract(&m_Working[0], &m_Dilated[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Working, "seg13-morph-bar-deg135-final.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Working[0], "seg13-morph-bar-deg135-final.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
   /* Circle operation. */
-  ErodeCircle(m_Eroded, m_Working);
+  ErodeCircle(&m_Eroded[0], &m_Working[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Eroded, "seg14-morph-circle-erode.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Eroded[0], "seg14-morph-circle-erode.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  DilateCircle(m_Working, m_Eroded);
+  DilateCircle(&m_Working[0], &m_Eroded[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Working, "seg15-morph-circle-final.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Working[0], "seg15-morph-circle-final.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
 }
@@ -9,6 +9,7 @@
 
 #include "PlusFidPatternRecognitionCommon.h"
 #include "PlusConfigure.h"
+#include "PlusValidPixelMask.h"
 #include "vtkXMLDataElement.h"
 #include <string.h>
 
@@ -86,28 +87,40 @@ public:
   /*! Check and modify if necessary the region of interest */
   void ValidateRegionOfInterest();
 
-  /*! Morphological operations performed by the algorithm */
-  inline PlusFidSegmentation::PixelType ErodePoint0(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic);
+  /*!
+    Morphological operations performed by the algorithm. The bar shaped structuring elements and the circle (as a union of
+    horizontal bars) are computed by the van Herk/Gil-Werman algorithm, which needs three minimum/maximum operations per pixel
+    regardless of the bar size, and processes whole rows at a time with SIMD instructions.
+  */
   void Erode0(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
-  inline PlusFidSegmentation::PixelType ErodePoint45(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic);
   void Erode45(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
-  inline PlusFidSegmentation::PixelType ErodePoint90(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic);
   void Erode90(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
-  inline PlusFidSegmentation::PixelType ErodePoint135(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic);
   void Erode135(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
   void ErodeCircle(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
-  inline PlusFidSegmentation::PixelType DilatePoint0(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic);
   void Dilate0(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
-  inline PlusFidSegmentation::PixelType DilatePoint45(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic);
   void Dilate45(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
-  inline PlusFidSegmentation::PixelType DilatePoint90(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic);
   void Dilate90(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
-  inline PlusFidSegmentation::PixelType DilatePoint135(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic);
   void Dilate135(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
   inline PlusFidSegmentation::PixelType DilatePoint(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic, PlusCoordinate2D* shape, int slen);
   void DilateCircle(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
   void Subtract(PlusFidSegmentation::PixelType* image, PlusFidSegmentation::PixelType* vals);
 
+  /*!
+    Erosion or dilation (depending on Operator) of the region of interest with a bar that goes one row down and columnStep columns
+    right in each step (0: vertical, 1: 135 degrees, -1: 45 degrees)
+  */
+  template<class Operator>
+  void LineMorphology(PlusFidSegmentation::PixelType* dest, const PlusFidSegmentation::PixelType* image, int columnStep);
+
+  /*! Make sure that the buffers of the morphological operations have at least the requested number of pixels */
+  void ReserveMorphologyBuffers(size_t size);
+
+  /*!
+    Get the column ranges [first, last) of a row that are inside the region of interest and the valid pixel mask.
+    The morphological operations only process these pixels.
+  */
+  void GetProcessedColumnRanges(unsigned int row, std::vector< std::pair<unsigned int, unsigned int> >& columnRanges);
+
   /*!
     Write image with the selected points on it to an image file (possibleFiducialsNNN.bmp)
     \param fiducials position of fiducial points
@@ -190,10 +203,10 @@ public:
   FiducialGeometryType  GetFiducialGeometry() { return m_FiducialGeometry; };
 
   /*! Get the working copy of the image */
-  PlusFidSegmentation::PixelType* GetWorking() {return m_Working; };
+  PlusFidSegmentation::PixelType* GetWorking() {return &m_Working[0]; };
 
   /*! Get the unaltered copy of the image */
-  PlusFidSegmentation::PixelType* GetUnalteredImage() {return m_UnalteredImage; };
+  PlusFidSegmentation::PixelType* GetUnalteredImage() {return &m_UnalteredImage[0]; };
 
   /*! Set the Approximate spacing, this is in Mm per pixel */
   void  SetApproximateSpacingMmPerPixel(double value) { m_ApproximateSpacingMmPerPixel = value; };
@@ -210,6 +223,13 @@ public:
   /*! Validates the region of interest that was set for the image and returns it */
   void  GetRegionOfInterest(unsigned int& xMin, unsigned int& yMin, unsigned int& xMax, unsigned int& yMax);
 
+  /*!
+    Set the mask of the valid image pixels (e.g., the fan of a curvilinear probe, see vtkPlusUsScanConvert::ComputeOutputImageValidPixelMask).
+    Morphological operations skip the pixels outside the mask, their result is 0. The mask is ignored if it is empty
+    or its size does not match the frame size.
+  */
+  void  SetValidPixelMask(const PlusValidPixelMask& mask) { m_ValidPixelMask = mask; };
+
   /*! Set the threshold of the image, this is a percent value */
   void  SetThresholdImagePercent(double value) { m_ThresholdImagePercent = value; };
 
@@ -219,6 +239,7 @@ public:
 protected:
   FrameSizeType m_FrameSize;
   std::array<unsigned int, 4> m_RegionOfInterest; // xmin, ymin; xmax, ymax
+  PlusValidPixelMask m_ValidPixelMask;
   bool m_UseOriginalImageIntensityForDotIntensityScore;
 
   unsigned int m_NumberOfMaximumFiducialPointCandidates;
@@ -253,10 +274,14 @@ protected:
   /*! Pointer to the fiducial candidates coordinates */
   std::vector<PlusFidDot> m_CandidateFidValues;
 
-  PlusFidSegmentation::PixelType* m_Working;
-  PlusFidSegmentation::PixelType* m_Dilated;
-  PlusFidSegmentation::PixelType* m_Eroded;
-  PlusFidSegmentation::PixelType* m_UnalteredImage;
+  std::vector<PlusFidSegmentation::PixelType> m_Working;
+  std::vector<PlusFidSegmentation::PixelType> m_Dilated;
+  std::vector<PlusFidSegmentation::PixelType> m_Eroded;
+  std::vector<PlusFidSegmentation::PixelType> m_UnalteredImage;
+
+  /*! Running minimum/maximum images of the morphological operations, forward and backward along the structuring element */
+  std::vector<PlusFidSegmentation::PixelType> m_MorphologyForward;
+  std::vector<PlusFidSegmentation::PixelType> m_MorphologyBackward;
 
   std::vector<PlusFidDot> m_DotsVector;
 
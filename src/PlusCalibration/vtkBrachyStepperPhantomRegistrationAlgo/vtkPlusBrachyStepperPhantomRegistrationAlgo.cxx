@@ -23,8 +23,6 @@
 
 #include "vtksys/SystemTools.hxx"
 
-#include "vnl/vnl_cross.h"
-
 //----------------------------------------------------------------------------
 
 vtkStandardNewMacro(vtkPlusBrachyStepperPhantomRegistrationAlgo);
@@ -141,93 +139,65 @@ PlusStatus vtkPlusBrachyStepperPhantomRegistrationAlgo::Update()
   //    FORMULA: D_O2AB = norm( cross(OA,OB) ) / norm(A-B)
   // ==================================================================================
 
-  std::vector<vtkSmartPointer<vtkPoints> > vectorOfWirePoints;
+  // All points are in the image plane, therefore the cross product has only a z component.
+  // The distances are accumulated directly from the segmented points, without copying them for each frame.
+  const double rotationCenterInMm[2] = { this->CenterOfRotationPx[0] * this->Spacing[0], this->CenterOfRotationPx[1] * this->Spacing[1] };
+  double sumOfPhantomToProbeVerticalDistanceInMm = 0.0;
+  double sumOfPhantomToProbeHorizontalDistanceInMm = 0.0;
+  int totalNumberOfImages2ComputePtLnDist = 0;   // Total number images used for this computation
   for (unsigned int index = 0; index < this->TrackedFrameList->GetNumberOfTrackedFrames(); ++index)
   {
     // Get tracked frame from list
     igsioTrackedFrame* trackedFrame = this->TrackedFrameList->GetTrackedFrame(index);
 
-    if (trackedFrame->GetFiducialPointsCoordinatePx() == NULL)
+    vtkPoints* fiducialPointsCoordinatePx = trackedFrame->GetFiducialPointsCoordinatePx();
+    if (fiducialPointsCoordinatePx == NULL)
     {
       LOG_ERROR("Unable to get segmented fiducial points from tracked frame - FiducialPointsCoordinatePx is NULL, frame is not yet segmented (position in the list: " << index << ")!");
       continue;
     }
 
-    if (trackedFrame->GetFiducialPointsCoordinatePx()->GetNumberOfPoints() == 0)
+    if (fiducialPointsCoordinatePx->GetNumberOfPoints() == 0)
     {
       LOG_DEBUG("Unable to get segmented fiducial points from tracked frame - couldn't segment image (position in the list: " << index << ")!");
       continue;
     }
 
-    // Add wire #4 (point A) wire #6 (point B) and wire #3 (point C) pixel coordinates to phantom to probe distance point set
-    vtkSmartPointer<vtkPoints> pointset = vtkSmartPointer<vtkPoints>::New();
-    pointset->SetDataTypeToDouble();
-    pointset->InsertNextPoint(trackedFrame->GetFiducialPointsCoordinatePx()->GetPoint(3));
-    pointset->InsertNextPoint(trackedFrame->GetFiducialPointsCoordinatePx()->GetPoint(5));
-    pointset->InsertNextPoint(trackedFrame->GetFiducialPointsCoordinatePx()->GetPoint(2));
-    vectorOfWirePoints.push_back(pointset);
-  }
-
-
-  vnl_vector<double> rotationCenter3x1InMm(3, 0);
-  rotationCenter3x1InMm.put(0, this->CenterOfRotationPx[0] * this->Spacing[0]);
-  rotationCenter3x1InMm.put(1, this->CenterOfRotationPx[1] * this->Spacing[1]);
-  rotationCenter3x1InMm.put(2, 0);
-
-  // Total number images used for this computation
-  const int totalNumberOfImages2ComputePtLnDist = vectorOfWirePoints.size();
-
-  if (totalNumberOfImages2ComputePtLnDist == 0)
-  {
-    LOG_ERROR("Failed to register phantom to reference. Probe distance calculation data is empty!");
-    return PLUS_FAIL;
-  }
-
-  // This will keep a trace on all the calculated distance
-  vnl_vector<double> listOfPhantomToProbeVerticalDistanceInMm(totalNumberOfImages2ComputePtLnDist, 0);
-  vnl_vector<double> listOfPhantomToProbeHorizontalDistanceInMm(totalNumberOfImages2ComputePtLnDist, 0);
-
-  for (int i = 0; i < totalNumberOfImages2ComputePtLnDist; i++)
-  {
-    // Extract point A
-    vnl_vector<double> pointAInMm(3, 0);
-    pointAInMm.put(0, vectorOfWirePoints[i]->GetPoint(0)[0] * this->Spacing[0]);
-    pointAInMm.put(1, vectorOfWirePoints[i]->GetPoint(0)[1] * this->Spacing[1]);
-    pointAInMm.put(2, 0);
-
-    // Extract point B
-    vnl_vector<double> pointBInMm(3, 0);
-    pointBInMm.put(0, vectorOfWirePoints[i]->GetPoint(1)[0] * this->Spacing[0]);
-    pointBInMm.put(1, vectorOfWirePoints[i]->GetPoint(1)[1] * this->Spacing[1]);
-    pointBInMm.put(2, 0);
-
-    // Extract point C
-    vnl_vector<double> pointCInMm(3, 0);
-    pointCInMm.put(0, vectorOfWirePoints[i]->GetPoint(2)[0] * this->Spacing[0]);
-    pointCInMm.put(1, vectorOfWirePoints[i]->GetPoint(2)[1] * this->Spacing[1]);
-    pointCInMm.put(2, 0);
+    // Wire #4 (point A) wire #6 (point B) and wire #3 (point C) coordinates
+    double pointAPx[3] = {0, 0, 0};
+    double pointBPx[3] = {0, 0, 0};
+    double pointCPx[3] = {0, 0, 0};
+    fiducialPointsCoordinatePx->GetPoint(3, pointAPx);
+    fiducialPointsCoordinatePx->GetPoint(5, pointBPx);
+    fiducialPointsCoordinatePx->GetPoint(2, pointCPx);
 
     // Construct vectors among rotation center, point A, and point B.
-    const vnl_vector<double> vectorRotationCenterToPointAInMm = pointAInMm - rotationCenter3x1InMm;
-    const vnl_vector<double> vectorRotationCenterToPointBInMm = pointBInMm - rotationCenter3x1InMm;
-    const vnl_vector<double> vectorRotationCenterToPointCInMm = pointCInMm - rotationCenter3x1InMm;
-    const vnl_vector<double> vectorPointAToPointBInMm = pointBInMm - pointAInMm;
-    const vnl_vector<double> vectorPointBToPointCInMm = pointCInMm - pointBInMm;
+    const double vectorRotationCenterToPointAInMm[2] = { pointAPx[0] * this->Spacing[0] - rotationCenterInMm[0], pointAPx[1] * this->Spacing[1] - rotationCenterInMm[1] };
+    const double vectorRotationCenterToPointBInMm[2] = { pointBPx[0] * this->Spacing[0] - rotationCenterInMm[0], pointBPx[1] * this->Spacing[1] - rotationCenterInMm[1] };
+    const double vectorRotationCenterToPointCInMm[2] = { pointCPx[0] * this->Spacing[0] - rotationCenterInMm[0], pointCPx[1] * this->Spacing[1] - rotationCenterInMm[1] };
+    const double vectorPointAToPointBInMm[2] = { vectorRotationCenterToPointBInMm[0] - vectorRotationCenterToPointAInMm[0], vectorRotationCenterToPointBInMm[1] - vectorRotationCenterToPointAInMm[1] };
+    const double vectorPointBToPointCInMm[2] = { vectorRotationCenterToPointCInMm[0] - vectorRotationCenterToPointBInMm[0], vectorRotationCenterToPointCInMm[1] - vectorRotationCenterToPointBInMm[1] };
 
     // Compute the point-line distance from probe to the line passing through A and B points, based on the
     // standard vector theory. FORMULA: D_O2AB = norm( cross(OA,OB) ) / norm(A-B)
-    const double thisPhantomToProbeVerticalDistanceInMm = vnl_cross_3d(vectorRotationCenterToPointAInMm, vectorRotationCenterToPointBInMm).magnitude() / vectorPointAToPointBInMm.magnitude();
+    sumOfPhantomToProbeVerticalDistanceInMm += fabs(vectorRotationCenterToPointAInMm[0] * vectorRotationCenterToPointBInMm[1] - vectorRotationCenterToPointAInMm[1] * vectorRotationCenterToPointBInMm[0])
+        / sqrt(vectorPointAToPointBInMm[0] * vectorPointAToPointBInMm[0] + vectorPointAToPointBInMm[1] * vectorPointAToPointBInMm[1]);
 
     // Compute the point-line distance from probe to the line passing through B and C points, based on the
     // standard vector theory. FORMULA: D_O2AB = norm( cross(OA,OB) ) / norm(A-B)
-    const double thisPhantomToProbeHorizontalDistanceInMm = vnl_cross_3d(vectorRotationCenterToPointBInMm, vectorRotationCenterToPointCInMm).magnitude() / vectorPointBToPointCInMm.magnitude();
+    sumOfPhantomToProbeHorizontalDistanceInMm += fabs(vectorRotationCenterToPointBInMm[0] * vectorRotationCenterToPointCInMm[1] - vectorRotationCenterToPointBInMm[1] * vectorRotationCenterToPointCInMm[0])
+        / sqrt(vectorPointBToPointCInMm[0] * vectorPointBToPointCInMm[0] + vectorPointBToPointCInMm[1] * vectorPointBToPointCInMm[1]);
+
+    totalNumberOfImages2ComputePtLnDist++;
+  }
 
-    // Populate the data container
-    listOfPhantomToProbeVerticalDistanceInMm.put(i, thisPhantomToProbeVerticalDistanceInMm);
-    listOfPhantomToProbeHorizontalDistanceInMm.put(i, thisPhantomToProbeHorizontalDistanceInMm);
+  if (totalNumberOfImages2ComputePtLnDist == 0)
+  {
+    LOG_ERROR("Failed to register phantom to reference. Probe distance calculation data is empty!");
+    return PLUS_FAIL;
   }
 
-  double wire6ToProbeDistanceInMm[2] = { listOfPhantomToProbeHorizontalDistanceInMm.mean(), listOfPhantomToProbeVerticalDistanceInMm.mean() };
+  double wire6ToProbeDistanceInMm[2] = { sumOfPhantomToProbeHorizontalDistanceInMm / totalNumberOfImages2ComputePtLnDist, sumOfPhantomToProbeVerticalDistanceInMm / totalNumberOfImages2ComputePtLnDist };
   double phantomToReferenceDistanceInMm[3] = { this->NWires[1].GetWires()[2].EndPointFront[0] + wire6ToProbeDistanceInMm[0], this->NWires[1].GetWires()[2].EndPointFront[1] + wire6ToProbeDistanceInMm[1], 0 };
 
   LOG_INFO("Phantom to probe distance (mm): " << phantomToReferenceDistanceInMm[0] << "   " << phantomToReferenceDistanceInMm[1]);
@@ -20,6 +20,10 @@
 #include "vtkDoubleArray.h"
 #include "vtkVariantArray.h"
 
+#include <atomic>
+#include <functional>
+#include <thread>
+
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkPlusCenterOfRotationCalibAlgo);
 
@@ -32,6 +36,7 @@ vtkPlusCenterOfRotationCalibAlgo::vtkPlusCenterOfRotationCalibAlgo()
   this->ReportTable = NULL;
   this->ErrorMean = 0.0;
   this->ErrorStdev = 0.0;
+  this->NumberOfThreads = 0;
 }
 
 //----------------------------------------------------------------------------
@@ -50,6 +55,7 @@ void vtkPlusCenterOfRotationCalibAlgo::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "Spacing: " << this->Spacing[0] << "  " << this->Spacing[1] << std::endl;
   os << indent << "Center of rotation (px): " << this->CenterOfRotationPx[0] << "  " << this->CenterOfRotationPx[1] << std::endl;
   os << indent << "Calibration error: mean=" << this->ErrorMean << "  stdev=" << this->ErrorStdev << std::endl;
+  os << indent << "Number of threads: " << this->NumberOfThreads << std::endl;
 
   if (this->TrackedFrameList != NULL)
   {
@@ -126,8 +132,8 @@ PlusStatus vtkPlusCenterOfRotationCalibAlgo::Update()
     return PLUS_FAIL;
   }
 
-  // Data containers
-  std::vector<vnl_vector<double> > aMatrix;
+  // Data containers, aMatrix stores the two coefficients of each equation
+  std::vector<double> aMatrix;
   std::vector<double> bVector;
 
   if (this->ConstructLinearEquationForCalibration(aMatrix, bVector) != PLUS_SUCCESS)
@@ -144,9 +150,9 @@ PlusStatus vtkPlusCenterOfRotationCalibAlgo::Update()
 
   // The rotation center in original image frame in px
   vnl_vector<double> centerOfRotationInPx(2, 0);
-  if (PlusMath::LSQRMinimize(aMatrix, bVector, centerOfRotationInPx, &this->ErrorMean, &this->ErrorStdev) != PLUS_SUCCESS)
+  if (PlusMath::LSQRMinimizeDense(aMatrix, bVector, centerOfRotationInPx, &this->ErrorMean, &this->ErrorStdev, this->NumberOfThreads) != PLUS_SUCCESS)
   {
-    LOG_WARNING("Failed to run LSQRMinimize!");
+    LOG_WARNING("Failed to run LSQRMinimizeDense!");
     return PLUS_FAIL;
   }
 
@@ -225,7 +231,7 @@ int vtkPlusCenterOfRotationCalibAlgo::GetNumberOfNWirePatterns()
 }
 
 //----------------------------------------------------------------------------
-PlusStatus vtkPlusCenterOfRotationCalibAlgo::ConstructLinearEquationForCalibration(std::vector<vnl_vector<double> >& aMatrix, std::vector<double>& bVector)
+PlusStatus vtkPlusCenterOfRotationCalibAlgo::ConstructLinearEquationForCalibration(std::vector<double>& aMatrix, std::vector<double>& bVector)
 {
   LOG_TRACE("vtkPlusCenterOfRotationCalibAlgo::ConstructLinearEquationForCalibration");
   aMatrix.clear();
@@ -270,8 +276,8 @@ PlusStatus vtkPlusCenterOfRotationCalibAlgo::ConstructLinearEquationForCalibrati
     return PLUS_FAIL;
   }
 
-  // Reserve memory for wire points
-  std::vector<vtkSmartPointer<vtkPoints> > vectorOfWirePoints;
+  // Coordinates (in mm) of the non-moving points of the N fiducials of each frame: x0, y0, x1, y1, ...
+  std::vector<std::vector<double> > vectorOfWirePoints;
   vectorOfWirePoints.reserve(numberOfFrames);
 
   for (unsigned int i = 0; i < this->TrackedFrameListIndices.size(); ++i)
@@ -282,63 +288,108 @@ PlusStatus vtkPlusCenterOfRotationCalibAlgo::ConstructLinearEquationForCalibrati
     // Get tracked frame from list
     igsioTrackedFrame* trackedFrame = this->TrackedFrameList->GetTrackedFrame(frameNumber);
 
-    if (trackedFrame->GetFiducialPointsCoordinatePx() == NULL)
+    vtkPoints* fiducialPointsCoordinatePx = trackedFrame->GetFiducialPointsCoordinatePx();
+    if (fiducialPointsCoordinatePx == NULL)
     {
       LOG_ERROR("Unable to get segmented fiducial points from tracked frame - FiducialPointsCoordinatePx is NULL, frame is not yet segmented (position in the list: " << frameNumber << ")!");
       continue;
     }
 
-    if (trackedFrame->GetFiducialPointsCoordinatePx()->GetNumberOfPoints() == 0)
+    if (fiducialPointsCoordinatePx->GetNumberOfPoints() == 0)
     {
       continue;
     }
 
-    vtkSmartPointer<vtkPoints> point = vtkSmartPointer<vtkPoints>::New();
-    point->SetDataTypeToDouble();
-    point->SetNumberOfPoints(numberOfNFiduacials * 2);   // Use only the two non-moving points of the N fiducial
-
-    int vectorID(0);   // ID used for point position in vtkPoints for faster execution
-    for (int p = 0; p < trackedFrame->GetFiducialPointsCoordinatePx()->GetNumberOfPoints(); ++p)
+    std::vector<double> points;
+    points.reserve(numberOfNFiduacials * 2 * 2);   // Use only the two non-moving points of the N fiducial
+    for (int p = 0; p < fiducialPointsCoordinatePx->GetNumberOfPoints(); ++p)
     {
       if (((p + 1) % 3) != 2)       // wire #1,#3,#4,#6... => use only non moving points of the N-wire
       {
-        double* wireCoordinatePx = trackedFrame->GetFiducialPointsCoordinatePx()->GetPoint(p);
-        point->SetPoint(vectorID++, wireCoordinatePx[0], wireCoordinatePx[1], wireCoordinatePx[2]);
+        double wireCoordinatePx[3] = {0, 0, 0};
+        fiducialPointsCoordinatePx->GetPoint(p, wireCoordinatePx);
+        points.push_back(wireCoordinatePx[0] * this->Spacing[0]);
+        points.push_back(wireCoordinatePx[1] * this->Spacing[1]);
       }
     }
 
-    vectorOfWirePoints.push_back(point);
+    vectorOfWirePoints.push_back(points);
   }
 
-  for (unsigned int i = 0; i <= vectorOfWirePoints.size() - 2; i++)
+  if (vectorOfWirePoints.size() < 2)
   {
-    for (unsigned int j = i + 1; j <= vectorOfWirePoints.size() - 1; j = j + 2)
+    LOG_WARNING("Center of rotation calculation failed - there is not enough segmented frames!");
+    return PLUS_FAIL;
+  }
+
+  // Each pair of frames gives one equation per point. The position of the equations of the pairs of each i-th frame
+  // is computed in advance, so that the equations can be filled in on multiple threads in the same order as serially.
+  const size_t numberOfWirePointFrames = vectorOfWirePoints.size();
+  std::vector<size_t> firstEquationIndex(numberOfWirePointFrames, 0);
+  size_t numberOfEquations = 0;
+  for (size_t i = 0; i + 1 < numberOfWirePointFrames; i++)
+  {
+    firstEquationIndex[i] = numberOfEquations;
+    for (size_t j = i + 1; j < numberOfWirePointFrames; j = j + 2)
     {
-      if (vectorOfWirePoints[i]->GetNumberOfPoints() != vectorOfWirePoints[j]->GetNumberOfPoints())
+      if (vectorOfWirePoints[i].size() == vectorOfWirePoints[j].size())
       {
-        continue;
+        numberOfEquations += vectorOfWirePoints[i].size() / 2;
       }
+    }
+  }
+  aMatrix.resize(numberOfEquations * 2);
+  bVector.resize(numberOfEquations);
 
-      for (int point = 0; point < vectorOfWirePoints[i]->GetNumberOfPoints(); point++)
+  std::atomic<size_t> nextFrame(0);
+  std::function<void()> fillEquations = [&]()
+  {
+    for (size_t i = nextFrame++; i + 1 < numberOfWirePointFrames; i = nextFrame++)
+    {
+      size_t equation = firstEquationIndex[i];
+      const std::vector<double>& pointsI = vectorOfWirePoints[i];
+      for (size_t j = i + 1; j < numberOfWirePointFrames; j = j + 2)
       {
-        // coordiates of the i-th element
-        double Xi = vectorOfWirePoints[i]->GetPoint(point)[0] * this->Spacing[0];
-        double Yi = vectorOfWirePoints[i]->GetPoint(point)[1] * this->Spacing[1];
-
-        // coordiates of the j-th element
-        double Xj = vectorOfWirePoints[j]->GetPoint(point)[0] * this->Spacing[0];
-        double Yj = vectorOfWirePoints[j]->GetPoint(point)[1] * this->Spacing[1];
-
-        // Populate the list of distance
-        vnl_vector<double> rowOfDistance(2, 0);
-        rowOfDistance.put(0, Xi - Xj);
-        rowOfDistance.put(1, Yi - Yj);
-        aMatrix.push_back(rowOfDistance);
-
-        // Populate the squared distance vector
-        bVector.push_back(0.5 * (Xi * Xi + Yi * Yi - Xj * Xj - Yj * Yj));
+        const std::vector<double>& pointsJ = vectorOfWirePoints[j];
+        if (pointsI.size() != pointsJ.size())
+        {
+          continue;
+        }
+
+        for (size_t point = 0; point < pointsI.size(); point += 2, equation++)
+        {
+          // coordiates of the i-th element
+          const double Xi = pointsI[point];
+          const double Yi = pointsI[point + 1];
+
+          // coordiates of the j-th element
+          const double Xj = pointsJ[point];
+          const double Yj = pointsJ[point + 1];
+
+          // Populate the list of distance
+          aMatrix[equation * 2] = Xi - Xj;
+          aMatrix[equation * 2 + 1] = Yi - Yj;
+
+          // Populate the squared distance vector
+          bVector[equation] = 0.5 * (Xi * Xi + Yi * Yi - Xj * Xj - Yj * Yj);
+        }
       }
     }
+  };
+
+  int numberOfThreads = this->NumberOfThreads;
+  if (numberOfThreads <= 0)
+  {
+    numberOfThreads = std::max<int>(std::thread::hardware_concurrency(), 1);
+  }
+  std::vector<std::thread> threads;
+  for (int threadIndex = 0; threadIndex < numberOfThreads; threadIndex++)
+  {
+    threads.push_back(std::thread(std::ref(fillEquations)));
+  }
+  for (std::vector<std::thread>::iterator threadIt = threads.begin(); threadIt != threads.end(); ++threadIt)
+  {
+    threadIt->join();
   }
 
   return PLUS_SUCCESS;
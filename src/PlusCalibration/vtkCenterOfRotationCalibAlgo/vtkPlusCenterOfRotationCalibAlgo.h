@@ -73,6 +73,10 @@ public:
   /*! Get the report table that is used for storing algorithm results */
   vtkGetObjectMacro(ReportTable, vtkTable);
 
+  /*! Number of threads used for constructing and solving the linear equations. If 0 then the number of processors is used. */
+  vtkSetMacro(NumberOfThreads, int);
+  vtkGetMacro(NumberOfThreads, int);
+
   /*! Add generated html report from center of rotation calibration to the existing html report */
   virtual PlusStatus GenerateReport(vtkPlusHTMLGenerator* htmlReport);
 
@@ -108,8 +112,12 @@ protected:
   /*! Bring this algorithm's outputs up-to-date. */
   virtual PlusStatus Update();
 
-  /*! Construct linear equation for center of rotation calibration */
-  virtual PlusStatus ConstructLinearEquationForCalibration(std::vector<vnl_vector<double> >& aMatrix, std::vector<double>& bVector);
+  /*!
+    Construct linear equation for center of rotation calibration
+    \param aMatrix Coefficients of the equations, two values per equation
+    \param bVector Right side of the equations
+  */
+  virtual PlusStatus ConstructLinearEquationForCalibration(std::vector<double>& aMatrix, std::vector<double>& bVector);
 
   /*! Add new column to the report table */
   PlusStatus AddNewColumnToReportTable(const char* columnName);
@@ -144,6 +152,9 @@ protected:
   /*! Calibration error standard deviation */
   double ErrorStdev;
 
+  /*! Number of threads used for constructing and solving the linear equations */
+  int NumberOfThreads;
+
   /*! When the results were computed. The result is recomputed only if the inputs changed more recently than UpdateTime. */
   vtkTimeStamp UpdateTime;
 };
@@ -41,6 +41,12 @@ See License.txt for details.
 #include <vtkRenderer.h>
 #include <vtkTable.h>
 
+// STL includes
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+
 static const double INTESNITY_THRESHOLD_PERCENTAGE_OF_PEAK = 0.5; // threshold (as the percentage of the peak intensity along a scanline) for COG
 static const double MAX_CONSECUTIVE_INVALID_VIDEO_FRAMES = 10; // the maximum number of consecutive invalid frames before warning message issued
 static const double MAX_PERCENTAGE_OF_INVALID_VIDEO_FRAMES = 0.1; // the maximum percentage of the invalid frames before warning message issued
@@ -71,6 +77,7 @@ vtkPlusLineSegmentationAlgo::vtkPlusLineSegmentationAlgo()
   , m_SaveIntermediateImages(false)
   , IntermediateFilesOutputDirectory("")
   , PlotIntensityProfile(false)
+  , NumberOfThreads(0)
   , m_SignalTimeRangeMin(0.0)
   , m_SignalTimeRangeMax(-1.0)
 {
@@ -193,206 +200,263 @@ PlusStatus vtkPlusLineSegmentationAlgo::ComputeVideoPositionMetric()
   nonDetectedLineParams.lineOriginPoint_Image[1] = 0;
   nonDetectedLineParams.lineDirectionVector_Image[0] = 0;
   nonDetectedLineParams.lineDirectionVector_Image[1] = 1;
-  m_LineParameters.assign(m_TrackedFrameList->GetNumberOfTrackedFrames(), nonDetectedLineParams);
+  const unsigned int numberOfFrames = m_TrackedFrameList->GetNumberOfTrackedFrames();
+  m_LineParameters.assign(numberOfFrames, nonDetectedLineParams);
 
   //  For each video frame, detect line and extract mindpoint and slope parameters
-  int numberOfSuccessfulLineSegmentations = 0;
-  bool signalTimeRangeDefined = (m_SignalTimeRangeMin <= m_SignalTimeRangeMax);
-  for (unsigned int frameNumber = 0; frameNumber < m_TrackedFrameList->GetNumberOfTrackedFrames(); ++frameNumber)
+  // Frames are independent, so they are processed on multiple threads and the results are collected in frame order afterwards.
+  // Saved intermediate images and intensity profile plots are only produced in frame order if a single thread is used.
+  std::vector<char> lineDetected(numberOfFrames, 0);
+  std::vector<double> signalValues(numberOfFrames, 0.0);
+  int numberOfThreads = this->NumberOfThreads;
+  if (numberOfThreads <= 0)
   {
-    LOG_TRACE("Calculating video position metric for frame " << frameNumber);
-    igsioTrackedFrame* trackedFrame = m_TrackedFrameList->GetTrackedFrame(frameNumber);
-    if (signalTimeRangeDefined && (trackedFrame->GetTimestamp() < m_SignalTimeRangeMin || trackedFrame->GetTimestamp() > m_SignalTimeRangeMax))
+    numberOfThreads = std::max<int>(std::thread::hardware_concurrency(), 1);
+  }
+  numberOfThreads = static_cast<int>(std::min<unsigned int>(numberOfThreads, numberOfFrames));
+  if (m_SaveIntermediateImages || this->PlotIntensityProfile)
+  {
+    numberOfThreads = 1;
+  }
+  std::atomic<unsigned int> nextFrameNumber(0);
+  std::function<void()> segmentFrames = [&]()
+  {
+    for (unsigned int frameNumber = nextFrameNumber++; frameNumber < numberOfFrames; frameNumber = nextFrameNumber++)
     {
-      // frame is out of the specified signal range
-      LOG_TRACE("Skip frame, it is out of the valid signal range");
-      continue;
+      LineParameters params;
+      if (SegmentFrame(frameNumber, params, signalValues[frameNumber]) == PLUS_SUCCESS)
+      {
+        lineDetected[frameNumber] = 1;
+        m_LineParameters[frameNumber] = params;
+      }
     }
-
-    // Get current image
-    if (trackedFrame->GetImageData()->GetVTKScalarPixelType() != VTK_UNSIGNED_CHAR)
+  };
+  if (numberOfThreads > 1)
+  {
+    std::vector<std::thread> threads;
+    for (int threadIndex = 0; threadIndex < numberOfThreads; ++threadIndex)
     {
-      LOG_ERROR("vtkPlusLineSegmentationAlgo::ComputeVideoPositionMetric only supports 8-bit images");
-      continue;
+      threads.push_back(std::thread(std::ref(segmentFrames)));
     }
-    CharImageType::Pointer localImage = CharImageType::New();
-    PlusCommon::DeepCopyVtkVolumeToItkImage<CharPixelType>(trackedFrame->GetImageData()->GetImage(), localImage);
-    if (localImage.IsNull())
+    for (std::vector<std::thread>::iterator threadIt = threads.begin(); threadIt != threads.end(); ++threadIt)
     {
-      // Dropped frame
-      LOG_ERROR("vtkPlusLineSegmentationAlgo::ComputeVideoPositionMetric failed to retrieve image data from frame");
-      continue;
+      threadIt->join();
     }
+  }
+  else
+  {
+    segmentFrames();
+  }
 
-    // Create an image duplicator to copy the original image
-    typedef itk::ImageDuplicator<CharImageType> DuplicatorType;
-    DuplicatorType::Pointer duplicator = DuplicatorType::New();
-    CharImageType::Pointer scanlineImage;
-    if (m_SaveIntermediateImages == true)
+  int numberOfSuccessfulLineSegmentations = 0;
+  for (unsigned int frameNumber = 0; frameNumber < numberOfFrames; ++frameNumber)
+  {
+    if (!lineDetected[frameNumber])
     {
-      duplicator->SetInputImage(localImage);
-      duplicator->Update();
-
-      // Create an image copy to draw the scanlines on
-      scanlineImage = duplicator->GetOutput();
+      continue;
     }
+    ++numberOfSuccessfulLineSegmentations;
+    m_SignalValues.push_back(signalValues[frameNumber]);
 
-    std::vector<itk::Point<double, 2> > intensityPeakPositions;
-    CharImageType::RegionType region = localImage->GetLargestPossibleRegion();
-    LimitToClipRegion(region);
-
-    int numOfValidScanlines = 0;
-
-    for (int currScanlineNum = 0; currScanlineNum < NUMBER_OF_SCANLINES; ++currScanlineNum)
-    {
-      // Set the scanline start pixel
-      CharImageType::IndexType startPixel;
-      double scanlineSpacingPix = static_cast<double>(region.GetSize()[0] - 1) / (NUMBER_OF_SCANLINES - 1);
-      startPixel[0] = region.GetIndex()[0] + scanlineSpacingPix * (currScanlineNum);
-      startPixel[1] = region.GetIndex()[1];
-
-      // Set the scanline end pixel
-      CharImageType::IndexType endPixel;
-      endPixel[0] = startPixel[0];
-      endPixel[1] = startPixel[1] + region.GetSize()[1] - 1;
-
-      std::deque<int> intensityProfile; // Holds intensity profile of the line
-      itk::LineIterator<CharImageType> it(localImage, startPixel, endPixel);
-      it.GoToBegin();
-
-      itk::LineIterator<CharImageType>* itScanlineImage = NULL;
-      if (m_SaveIntermediateImages == true)
-      {
-        // Iterator for the scanline image copy
-        // it's time-consuming to instantiate this iterator, so only do it if intermediate image saving is requested
-        itScanlineImage = new itk::LineIterator<CharImageType>(scanlineImage, startPixel, endPixel);
-        itScanlineImage->GoToBegin();
-      }
-
-      while (!it.IsAtEnd())
-      {
-        intensityProfile.push_back((int)it.Get());
-        if (m_SaveIntermediateImages == true)
-        {
-          // Set the pixels on the scanline image copy to white
-          itScanlineImage->Set(255);
-          ++(*itScanlineImage);
-        }
-        ++it;
-      }
+    //  Store timestamp for image frame
+    m_SignalTimestamps.push_back(m_TrackedFrameList->GetTrackedFrame(frameNumber)->GetTimestamp());
+  }
 
-      // Delete the iterator declared with new()
-      if (itScanlineImage != NULL)
-      {
-        delete itScanlineImage;
-        itScanlineImage = NULL;
-      }
+  double segmentationSuccessRate = double(numberOfSuccessfulLineSegmentations) / m_TrackedFrameList->GetNumberOfTrackedFrames();
+  if (segmentationSuccessRate < EXPECTED_LINE_SEGMENTATION_SUCCESS_RATE)
+  {
+    LOG_WARNING("Line segmentation success rate is very low (" << segmentationSuccessRate * 100 << "%): a line could only be detected on " << numberOfSuccessfulLineSegmentations << " frames out of " << m_TrackedFrameList->GetNumberOfTrackedFrames());
+  }
 
-      if (this->PlotIntensityProfile)
-      {
-        // Plot the intensity profile
-        PlotIntArray(intensityProfile);
-      }
+  bool plotVideoMetric = vtkPlusLogger::Instance()->GetLogLevel() >= vtkPlusLogger::LOG_LEVEL_TRACE;
+  if (plotVideoMetric)
+  {
+    PlotDoubleArray(m_SignalValues);
+  }
 
-      // Find the max intensity value from the peak with the largest area
-      int maxFromLargestArea = -1;
-      int maxFromLargestAreaIndex = -1;
-      int startOfMaxArea = -1;
-      if (FindLargestPeak(intensityProfile, maxFromLargestArea, maxFromLargestAreaIndex, startOfMaxArea) == PLUS_SUCCESS)
-      {
-        double currPeakPos_y = -1;
-        switch (PEAK_POS_METRIC)
-        {
-          case PEAK_POS_COG:
-            {
-              /* Use center-of-gravity (COG) as peak-position metric*/
-              if (ComputeCenterOfGravity(intensityProfile, startOfMaxArea, currPeakPos_y) != PLUS_SUCCESS)
-              {
-                // unable to compute center-of-gravity; this scanline is invalid
-                continue;
-              }
-              break;
-            }
-          case PEAK_POS_START:
-            {
-              /* Use peak start as peak-position metric*/
-              if (FindPeakStart(intensityProfile, maxFromLargestArea, startOfMaxArea, currPeakPos_y) != PLUS_SUCCESS)
-              {
-                // unable to compute peak start; this scanline is invalid
-                continue;
-              }
-              break;
-            }
-        }
+  return PLUS_SUCCESS;
 
-        itk::Point<double, 2> currPeakPos;
-        currPeakPos[0] = static_cast<double>(startPixel[0]);
-        currPeakPos[1] = startPixel[1] + currPeakPos_y;
-        intensityPeakPositions.push_back(currPeakPos);
-        ++numOfValidScanlines;
+} //  End LineDetection
 
-      } // end if() found intensity peak
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusLineSegmentationAlgo::SegmentFrame(unsigned int frameNumber, LineParameters& params, double& signalValue)
+{
+  LOG_TRACE("Calculating video position metric for frame " << frameNumber);
+  igsioTrackedFrame* trackedFrame = m_TrackedFrameList->GetTrackedFrame(frameNumber);
+  bool signalTimeRangeDefined = (m_SignalTimeRangeMin <= m_SignalTimeRangeMax);
+  if (signalTimeRangeDefined && (trackedFrame->GetTimestamp() < m_SignalTimeRangeMin || trackedFrame->GetTimestamp() > m_SignalTimeRangeMax))
+  {
+    // frame is out of the specified signal range
+    LOG_TRACE("Skip frame, it is out of the valid signal range");
+    return PLUS_FAIL;
+  }
 
-    } // end currScanlineNum loop
+  // Get current image
+  if (trackedFrame->GetImageData()->GetVTKScalarPixelType() != VTK_UNSIGNED_CHAR)
+  {
+    LOG_ERROR("vtkPlusLineSegmentationAlgo::ComputeVideoPositionMetric only supports 8-bit images");
+    return PLUS_FAIL;
+  }
+  vtkImageData* image = trackedFrame->GetImageData()->GetImage();
+  if (image == NULL || image->GetScalarPointer() == NULL)
+  {
+    // Dropped frame
+    LOG_ERROR("vtkPlusLineSegmentationAlgo::ComputeVideoPositionMetric failed to retrieve image data from frame");
+    return PLUS_FAIL;
+  }
+  if (image->GetNumberOfScalarComponents() != 1)
+  {
+    LOG_ERROR("vtkPlusLineSegmentationAlgo::ComputeVideoPositionMetric only supports single component images");
+    return PLUS_FAIL;
+  }
 
-    if (numOfValidScanlines < MINIMUM_NUMBER_OF_VALID_SCANLINES)
+  // The pixels are read directly from the frame, the image is only copied if the scanlines are drawn on it
+  int extent[6] = {0, 0, 0, 0, 0, 0};
+  image->GetExtent(extent);
+  CharImageType::SizeType imageSize;
+  imageSize[0] = extent[1] - extent[0] + 1;
+  imageSize[1] = extent[3] - extent[2] + 1;
+  CharImageType::IndexType imageOrigin;
+  imageOrigin[0] = 0;
+  imageOrigin[1] = 0;
+  CharImageType::RegionType region(imageOrigin, imageSize);
+  LimitToClipRegion(region);
+  const CharPixelType* pixels = static_cast<const CharPixelType*>(image->GetScalarPointer());
+
+  CharImageType::Pointer scanlineImage;
+  if (m_SaveIntermediateImages == true)
+  {
+    // Create an image copy to draw the scanlines on
+    scanlineImage = CharImageType::New();
+    if (PlusCommon::DeepCopyVtkVolumeToItkImage<CharPixelType>(image, scanlineImage) != PLUS_SUCCESS)
     {
-      //TODO: drop the frame from the analysis
-      LOG_DEBUG("Only " << numOfValidScanlines << " valid scanlines; this is less than the required " << MINIMUM_NUMBER_OF_VALID_SCANLINES << ". Skipping frame" << frameNumber);
+      LOG_ERROR("vtkPlusLineSegmentationAlgo::ComputeVideoPositionMetric failed to retrieve image data from frame");
+      return PLUS_FAIL;
     }
+  }
 
-    LineParameters params;
-    ComputeLineParameters(intensityPeakPositions, params);
-    if (!params.lineDetected)
+  // Extract the intensity profiles of all the (vertical) scanlines in one pass over the image rows,
+  // so that each row is read from memory only once
+  const double scanlineSpacingPix = static_cast<double>(region.GetSize()[0] - 1) / (NUMBER_OF_SCANLINES - 1);
+  const unsigned int profileLength = region.GetSize()[1];
+  std::vector<CharImageType::IndexValueType> scanlinePositions(NUMBER_OF_SCANLINES);
+  for (int currScanlineNum = 0; currScanlineNum < NUMBER_OF_SCANLINES; ++currScanlineNum)
+  {
+    scanlinePositions[currScanlineNum] = region.GetIndex()[0] + scanlineSpacingPix * (currScanlineNum);
+  }
+  std::vector<std::vector<int> > intensityProfiles(NUMBER_OF_SCANLINES, std::vector<int>(profileLength)); // Holds intensity profile of the lines
+  for (unsigned int y = 0; y < profileLength; ++y)
+  {
+    const CharPixelType* row = pixels + (region.GetIndex()[1] + y) * imageSize[0];
+    for (int currScanlineNum = 0; currScanlineNum < NUMBER_OF_SCANLINES; ++currScanlineNum)
     {
-      LOG_DEBUG("Unable to compute line parameters for frame " << frameNumber);
-      continue;
+      intensityProfiles[currScanlineNum][y] = row[scanlinePositions[currScanlineNum]];
     }
-    if (params.lineDirectionVector_Image[0] < MIN_X_SLOPE_COMPONENT_FOR_DETECTED_LINE)
+  }
+  if (m_SaveIntermediateImages == true)
+  {
+    // Set the pixels on the scanline image copy to white
+    CharPixelType* scanlinePixels = scanlineImage->GetBufferPointer();
+    for (unsigned int y = 0; y < profileLength; ++y)
     {
-      // Line is close to vertical, skip frame because intersection of
-      // line with image's horizontal half point is unstable
-      LOG_TRACE("Line on frame " << frameNumber << " is too close to vertical, skip the frame");
-      continue;
+      CharPixelType* row = scanlinePixels + (region.GetIndex()[1] + y) * imageSize[0];
+      for (int currScanlineNum = 0; currScanlineNum < NUMBER_OF_SCANLINES; ++currScanlineNum)
+      {
+        row[scanlinePositions[currScanlineNum]] = 255;
+      }
     }
+  }
 
-    ++numberOfSuccessfulLineSegmentations;
-    m_LineParameters[frameNumber] = params;
-
-    // Store the y-value of the line, when the line's x-value is half of the image's width
-    double t = (region.GetIndex()[0] + 0.5 * region.GetSize()[0] - params.lineOriginPoint_Image[0]) / params.lineDirectionVector_Image[0];
-    m_SignalValues.push_back(std::abs(params.lineOriginPoint_Image[1] + t * params.lineDirectionVector_Image[1]));
+  std::vector<itk::Point<double, 2> > intensityPeakPositions;
+  int numOfValidScanlines = 0;
 
-    //  Store timestamp for image frame
-    m_SignalTimestamps.push_back(m_TrackedFrameList->GetTrackedFrame(frameNumber)->GetTimestamp());
+  for (int currScanlineNum = 0; currScanlineNum < NUMBER_OF_SCANLINES; ++currScanlineNum)
+  {
+    std::vector<int>& intensityProfile = intensityProfiles[currScanlineNum];
 
-    if (m_SaveIntermediateImages == true)
+    if (this->PlotIntensityProfile)
     {
-      SaveIntermediateImage(frameNumber, scanlineImage,
-                            params.lineOriginPoint_Image[0], params.lineOriginPoint_Image[1], params.lineDirectionVector_Image[0], params.lineDirectionVector_Image[1],
-                            numOfValidScanlines, intensityPeakPositions);
+      // Plot the intensity profile
+      PlotIntArray(intensityProfile);
     }
 
-  } // end frameNum loop
+    // Find the max intensity value from the peak with the largest area
+    int maxFromLargestArea = -1;
+    int maxFromLargestAreaIndex = -1;
+    int startOfMaxArea = -1;
+    if (FindLargestPeak(intensityProfile, maxFromLargestArea, maxFromLargestAreaIndex, startOfMaxArea) == PLUS_SUCCESS)
+    {
+      double currPeakPos_y = -1;
+      switch (PEAK_POS_METRIC)
+      {
+        case PEAK_POS_COG:
+          {
+            /* Use center-of-gravity (COG) as peak-position metric*/
+            if (ComputeCenterOfGravity(intensityProfile, startOfMaxArea, currPeakPos_y) != PLUS_SUCCESS)
+            {
+              // unable to compute center-of-gravity; this scanline is invalid
+              continue;
+            }
+            break;
+          }
+        case PEAK_POS_START:
+          {
+            /* Use peak start as peak-position metric*/
+            if (FindPeakStart(intensityProfile, maxFromLargestArea, startOfMaxArea, currPeakPos_y) != PLUS_SUCCESS)
+            {
+              // unable to compute peak start; this scanline is invalid
+              continue;
+            }
+            break;
+          }
+      }
+
+      itk::Point<double, 2> currPeakPos;
+      currPeakPos[0] = static_cast<double>(scanlinePositions[currScanlineNum]);
+      currPeakPos[1] = region.GetIndex()[1] + currPeakPos_y;
+      intensityPeakPositions.push_back(currPeakPos);
+      ++numOfValidScanlines;
 
-  double segmentationSuccessRate = double(numberOfSuccessfulLineSegmentations) / m_TrackedFrameList->GetNumberOfTrackedFrames();
-  if (segmentationSuccessRate < EXPECTED_LINE_SEGMENTATION_SUCCESS_RATE)
+    } // end if() found intensity peak
+
+  } // end currScanlineNum loop
+
+  if (numOfValidScanlines < MINIMUM_NUMBER_OF_VALID_SCANLINES)
   {
-    LOG_WARNING("Line segmentation success rate is very low (" << segmentationSuccessRate * 100 << "%): a line could only be detected on " << numberOfSuccessfulLineSegmentations << " frames out of " << m_TrackedFrameList->GetNumberOfTrackedFrames());
+    //TODO: drop the frame from the analysis
+    LOG_DEBUG("Only " << numOfValidScanlines << " valid scanlines; this is less than the required " << MINIMUM_NUMBER_OF_VALID_SCANLINES << ". Skipping frame" << frameNumber);
   }
 
-  bool plotVideoMetric = vtkPlusLogger::Instance()->GetLogLevel() >= vtkPlusLogger::LOG_LEVEL_TRACE;
-  if (plotVideoMetric)
+  ComputeLineParameters(intensityPeakPositions, params);
+  if (!params.lineDetected)
   {
-    PlotDoubleArray(m_SignalValues);
+    LOG_DEBUG("Unable to compute line parameters for frame " << frameNumber);
+    return PLUS_FAIL;
+  }
+  if (params.lineDirectionVector_Image[0] < MIN_X_SLOPE_COMPONENT_FOR_DETECTED_LINE)
+  {
+    // Line is close to vertical, skip frame because intersection of
+    // line with image's horizontal half point is unstable
+    LOG_TRACE("Line on frame " << frameNumber << " is too close to vertical, skip the frame");
+    return PLUS_FAIL;
   }
 
-  return PLUS_SUCCESS;
+  // Store the y-value of the line, when the line's x-value is half of the image's width
+  double t = (region.GetIndex()[0] + 0.5 * region.GetSize()[0] - params.lineOriginPoint_Image[0]) / params.lineDirectionVector_Image[0];
+  signalValue = std::abs(params.lineOriginPoint_Image[1] + t * params.lineDirectionVector_Image[1]);
 
-} //  End LineDetection
+  if (m_SaveIntermediateImages == true)
+  {
+    SaveIntermediateImage(frameNumber, scanlineImage,
+                          params.lineOriginPoint_Image[0], params.lineOriginPoint_Image[1], params.lineDirectionVector_Image[0], params.lineDirectionVector_Image[1],
+                          numOfValidScanlines, intensityPeakPositions);
+  }
+
+  return PLUS_SUCCESS;
+}
 
 //-----------------------------------------------------------------------------
-PlusStatus vtkPlusLineSegmentationAlgo::FindPeakStart(std::deque<int>& intensityProfile, int maxFromLargestArea, int startOfMaxArea, double& startOfPeak)
+PlusStatus vtkPlusLineSegmentationAlgo::FindPeakStart(std::vector<int>& intensityProfile, int maxFromLargestArea, int startOfMaxArea, double& startOfPeak)
 {
   // Start of peak is defined as the location at which it reaches 50% of its maximum value.
   double startPeakValue = maxFromLargestArea * 0.5;
@@ -410,7 +474,7 @@ PlusStatus vtkPlusLineSegmentationAlgo::FindPeakStart(std::deque<int>& intensity
 }
 
 //-----------------------------------------------------------------------------
-PlusStatus vtkPlusLineSegmentationAlgo::FindLargestPeak(std::deque<int>& intensityProfile, int& maxFromLargestArea, int& maxFromLargestAreaIndex, int& startOfMaxArea)
+PlusStatus vtkPlusLineSegmentationAlgo::FindLargestPeak(std::vector<int>& intensityProfile, int& maxFromLargestArea, int& maxFromLargestAreaIndex, int& startOfMaxArea)
 {
   int currentLargestArea = 0;
   int currentArea = 0;
@@ -428,14 +492,7 @@ PlusStatus vtkPlusLineSegmentationAlgo::FindLargestPeak(std::deque<int>& intensi
     return PLUS_FAIL;
   }
 
-  double intensityMax = intensityProfile.at(0);
-  for (unsigned int pixelLoc = 1; pixelLoc < intensityProfile.size(); ++pixelLoc)
-  {
-    if (intensityProfile.at(pixelLoc) > intensityMax)
-    {
-      intensityMax = intensityProfile.at(pixelLoc);
-    }
-  }
+  double intensityMax = *std::max_element(intensityProfile.begin(), intensityProfile.end());
 
   double peakIntensityThreshold = intensityMax * INTESNITY_THRESHOLD_PERCENTAGE_OF_PEAK;
 
@@ -489,21 +546,14 @@ PlusStatus vtkPlusLineSegmentationAlgo::FindLargestPeak(std::deque<int>& intensi
 }
 //-----------------------------------------------------------------------------
 
-PlusStatus vtkPlusLineSegmentationAlgo::ComputeCenterOfGravity(std::deque<int>& intensityProfile, int startOfMaxArea, double& centerOfGravity)
+PlusStatus vtkPlusLineSegmentationAlgo::ComputeCenterOfGravity(std::vector<int>& intensityProfile, int startOfMaxArea, double& centerOfGravity)
 {
   if (intensityProfile.size() == 0)
   {
     return PLUS_FAIL;
   }
 
-  double intensityMax = intensityProfile.at(0);
-  for (unsigned int pixelLoc = 1; pixelLoc < intensityProfile.size(); ++pixelLoc)
-  {
-    if (intensityProfile.at(pixelLoc) > intensityMax)
-    {
-      intensityMax = intensityProfile.at(pixelLoc);
-    }
-  }
+  double intensityMax = *std::max_element(intensityProfile.begin(), intensityProfile.end());
 
   double peakIntensityThreshold = intensityMax * INTESNITY_THRESHOLD_PERCENTAGE_OF_PEAK;
 
@@ -731,7 +781,7 @@ PlusStatus vtkPlusLineSegmentationAlgo::Update()
 }
 
 //-----------------------------------------------------------------------------
-void vtkPlusLineSegmentationAlgo::PlotIntArray(const std::deque<int>& intensityValues)
+void vtkPlusLineSegmentationAlgo::PlotIntArray(const std::vector<int>& intensityValues)
 {
 #ifdef PLUS_RENDERING_ENABLED
   //  Create table
@@ -926,6 +976,7 @@ PlusStatus vtkPlusLineSegmentationAlgo::ReadConfiguration(vtkXMLDataElement* aCo
 
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(SaveIntermediateImages, lineSegmentationElement);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(PlotIntensityProfile, lineSegmentationElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfThreads, lineSegmentationElement);
 
   this->IntermediateFilesOutputDirectory = vtkPlusConfig::GetInstance()->GetOutputDirectory();
   XML_READ_CSTRING_ATTRIBUTE_OPTIONAL(IntermediateFilesOutputDirectory, lineSegmentationElement);
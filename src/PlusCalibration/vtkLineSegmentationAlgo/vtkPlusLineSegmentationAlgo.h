@@ -11,6 +11,7 @@
 #include "vtkPlusCalibrationExport.h"
 #include "vtkObject.h"
 #include <deque>
+#include <vector>
 
 //class igsioTrackedFrame; 
 //class vtkIGSIOTrackedFrameList;
@@ -81,6 +82,13 @@ public:
   vtkGetMacro(PlotIntensityProfile, bool);
   vtkSetMacro(PlotIntensityProfile, bool);
 
+  /*!
+    Number of threads that process the frames. If 0 then the number of processors is used.
+    Frames are processed on a single thread if intermediate images are saved or intensity profiles are plotted.
+  */
+  vtkGetMacro(NumberOfThreads, int);
+  vtkSetMacro(NumberOfThreads, int);
+
 protected:
   vtkPlusLineSegmentationAlgo();
   virtual ~vtkPlusLineSegmentationAlgo();
@@ -89,15 +97,21 @@ protected:
 
   PlusStatus ComputeVideoPositionMetric();
 
-  PlusStatus FindPeakStart(std::deque<int>& intensityProfile, int maxFromLargestArea, int startOfMaxArea, double& startOfPeak);
+  /*!
+    Detect the line on a frame and compute the position metric (the line position at the middle of the image).
+    Returns PLUS_FAIL if the frame is out of the signal time range or a suitable line is not found. Multiple frames can be processed concurrently.
+  */
+  PlusStatus SegmentFrame(unsigned int frameNumber, LineParameters& params, double& signalValue);
+
+  PlusStatus FindPeakStart(std::vector<int>& intensityProfile, int maxFromLargestArea, int startOfMaxArea, double& startOfPeak);
 
-  PlusStatus FindLargestPeak(std::deque<int>& intensityProfile, int& maxFromLargestArea, int& maxFromLargestAreaIndex, int& startOfMaxArea);
+  PlusStatus FindLargestPeak(std::vector<int>& intensityProfile, int& maxFromLargestArea, int& maxFromLargestAreaIndex, int& startOfMaxArea);
 
-  PlusStatus ComputeCenterOfGravity(std::deque<int>& intensityProfile, int startOfMaxArea, double& centerOfGravity);
+  PlusStatus ComputeCenterOfGravity(std::vector<int>& intensityProfile, int startOfMaxArea, double& centerOfGravity);
 
   void ComputeLineParameters(std::vector<itk::Point<double, 2> >& data, LineParameters& outputParameters);
 
-  void PlotIntArray(const std::deque<int>& intensityValues);
+  void PlotIntArray(const std::vector<int>& intensityValues);
 
   void PlotDoubleArray(const std::deque<double>& intensityValues);
 
@@ -122,6 +136,9 @@ protected:
   /*! Plot intensity profile for each scanline. Enable for debugging. */
   bool PlotIntensityProfile;
 
+  /*! Number of threads that process the frames, 0 means the number of processors */
+  int NumberOfThreads;
+
   double m_SignalTimeRangeMin;
   double m_SignalTimeRangeMax;
 
@@ -9,6 +9,153 @@ See License.txt for details.
 #include "LinearObjectBuffer.h"
 #include "igsioCommon.h"
 
+#include <algorithm>
+#include <limits>
+
+//-----------------------------------------------------------------------------
+
+namespace
+{
+  // k-d tree over the signatures of linear objects, to find the object with the closest signature without comparing to every object
+  class SignatureKdTree
+  {
+  public:
+    SignatureKdTree( LinearObjectBuffer* objects )
+      : Objects( objects )
+    {
+      std::vector<int> indices( objects->Size() );
+      for ( int i = 0; i < objects->Size(); i++ )
+      {
+        indices.at(i) = i;
+      }
+      this->Root = this->Build( indices, 0, objects->Size() );
+    }
+
+    // Returns the index of the object with the closest signature (the lowest index if more objects are at the same distance)
+    int FindClosest( const std::vector<double>& signature, double& closestDistance ) const
+    {
+      int closestIndex = -1;
+      double closestDistanceSquared = std::numeric_limits<double>::max();
+      this->Search( this->Root, signature, closestIndex, closestDistanceSquared );
+      closestDistance = sqrt( closestDistanceSquared );
+      return closestIndex;
+    }
+
+  private:
+    struct Node
+    {
+      int ObjectIndex;
+      int SplitDimension;
+      int Left;
+      int Right;
+    };
+
+    const std::vector<double>& GetSignature( int objectIndex ) const
+    {
+      return this->Objects->GetLinearObject( objectIndex )->Signature;
+    }
+
+    // Split the objects at the median along the dimension where the signatures have the largest extent
+    int Build( std::vector<int>& indices, int begin, int end )
+    {
+      if ( begin >= end )
+      {
+        return -1;
+      }
+
+      const int numberOfDimensions = this->GetSignature( indices.at( begin ) ).size();
+      int splitDimension = 0;
+      double largestExtent = -1;
+      for ( int d = 0; d < numberOfDimensions; d++ )
+      {
+        double minimum = std::numeric_limits<double>::max();
+        double maximum = -std::numeric_limits<double>::max();
+        for ( int i = begin; i < end; i++ )
+        {
+          minimum = std::min( minimum, this->GetSignature( indices.at(i) ).at(d) );
+          maximum = std::max( maximum, this->GetSignature( indices.at(i) ).at(d) );
+        }
+        if ( maximum - minimum > largestExtent )
+        {
+          largestExtent = maximum - minimum;
+          splitDimension = d;
+        }
+      }
+
+      int median = ( begin + end ) / 2;
+      if ( numberOfDimensions > 0 )
+      {
+        std::nth_element( indices.begin() + begin, indices.begin() + median, indices.begin() + end, SignatureComparator( this, splitDimension ) );
+      }
+
+      Node node;
+      node.ObjectIndex = indices.at( median );
+      node.SplitDimension = splitDimension;
+      int nodeIndex = this->Nodes.size();
+      this->Nodes.push_back( node );
+      int left = this->Build( indices, begin, median );
+      int right = this->Build( indices, median + 1, end );
+      this->Nodes.at( nodeIndex ).Left = left;
+      this->Nodes.at( nodeIndex ).Right = right;
+      return nodeIndex;
+    }
+
+    void Search( int nodeIndex, const std::vector<double>& signature, int& closestIndex, double& closestDistanceSquared ) const
+    {
+      if ( nodeIndex < 0 )
+      {
+        return;
+      }
+      const Node& node = this->Nodes.at( nodeIndex );
+      const std::vector<double>& nodeSignature = this->GetSignature( node.ObjectIndex );
+
+      double distanceSquared = 0;
+      for ( unsigned int d = 0; d < nodeSignature.size(); d++ )
+      {
+        distanceSquared += ( signature.at(d) - nodeSignature.at(d) ) * ( signature.at(d) - nodeSignature.at(d) );
+      }
+      if ( distanceSquared < closestDistanceSquared || ( distanceSquared == closestDistanceSquared && node.ObjectIndex < closestIndex ) )
+      {
+        closestDistanceSquared = distanceSquared;
+        closestIndex = node.ObjectIndex;
+      }
+      if ( nodeSignature.empty() )
+      {
+        this->Search( node.Left, signature, closestIndex, closestDistanceSquared );
+        this->Search( node.Right, signature, closestIndex, closestDistanceSquared );
+        return;
+      }
+
+      // Search the side of the query first, the other side only if it may contain a closer (or equally close) object
+      double difference = signature.at( node.SplitDimension ) - nodeSignature.at( node.SplitDimension );
+      int nearChild = ( difference < 0 ) ? node.Left : node.Right;
+      int farChild = ( difference < 0 ) ? node.Right : node.Left;
+      this->Search( nearChild, signature, closestIndex, closestDistanceSquared );
+      if ( difference * difference <= closestDistanceSquared )
+      {
+        this->Search( farChild, signature, closestIndex, closestDistanceSquared );
+      }
+    }
+
+    class SignatureComparator
+    {
+    public:
+      SignatureComparator( const SignatureKdTree* tree, int dimension ) : Tree( tree ), Dimension( dimension ) {}
+      bool operator()( int index1, int index2 ) const
+      {
+        return this->Tree->GetSignature( index1 ).at( this->Dimension ) < this->Tree->GetSignature( index2 ).at( this->Dimension );
+      }
+    private:
+      const SignatureKdTree* Tree;
+      int Dimension;
+    };
+
+    LinearObjectBuffer* Objects;
+    std::vector<Node> Nodes;
+    int Root;
+  };
+}
+
 //-----------------------------------------------------------------------------
 
 LinearObjectBuffer::LinearObjectBuffer()
@@ -112,18 +259,38 @@ LinearObjectBuffer* LinearObjectBuffer::GetMatches( LinearObjectBuffer* candidat
     return matchedCandidates;
   }
 
+  // The candidates are indexed by a k-d tree if all the signatures have the same size (signatures computed from the same references)
+  bool sameSignatureSize = true;
+  for ( int j = 0; j < candidates->Size(); j++ )
+  {
+    sameSignatureSize = sameSignatureSize && candidates->GetLinearObject(j)->Signature.size() == candidates->GetLinearObject(0)->Signature.size();
+  }
+  for ( int i = 0; i < this->Size(); i++ )
+  {
+    sameSignatureSize = sameSignatureSize && this->GetLinearObject(i)->Signature.size() == candidates->GetLinearObject(0)->Signature.size();
+  }
+  SignatureKdTree* candidateTree = sameSignatureSize ? new SignatureKdTree( candidates ) : NULL;
+
   for ( int i = 0; i < this->Size(); i++ )
   {
 
     LinearObject* closestObject = candidates->GetLinearObject(0);
-    double closestDistance = LinearObject::Norm( LinearObject::Subtract( this->GetLinearObject(i)->Signature, closestObject->Signature ) );
+    double closestDistance = 0;
 
-    for ( int j = 0; j < candidates->Size(); j++ )
+    if ( candidateTree != NULL )
+    {
+      closestObject = candidates->GetLinearObject( candidateTree->FindClosest( this->GetLinearObject(i)->Signature, closestDistance ) );
+    }
+    else
     {
-      if ( LinearObject::Norm( LinearObject::Subtract( this->GetLinearObject(i)->Signature, candidates->GetLinearObject(j)->Signature ) ) < closestDistance )
+      closestDistance = LinearObject::Norm( LinearObject::Subtract( this->GetLinearObject(i)->Signature, closestObject->Signature ) );
+      for ( int j = 0; j < candidates->Size(); j++ )
       {
-        closestObject = candidates->GetLinearObject(j);
-        closestDistance = LinearObject::Norm( LinearObject::Subtract( this->GetLinearObject(i)->Signature, candidates->GetLinearObject(j)->Signature ) );
+        if ( LinearObject::Norm( LinearObject::Subtract( this->GetLinearObject(i)->Signature, candidates->GetLinearObject(j)->Signature ) ) < closestDistance )
+        {
+          closestObject = candidates->GetLinearObject(j);
+          closestDistance = LinearObject::Norm( LinearObject::Subtract( this->GetLinearObject(i)->Signature, candidates->GetLinearObject(j)->Signature ) );
+        }
       }
     }
 
@@ -136,6 +303,7 @@ LinearObjectBuffer* LinearObjectBuffer::GetMatches( LinearObjectBuffer* candidat
 
   }
 
+  delete candidateTree;
   this->objects = matchedObjects;
 
   return matchedCandidates;
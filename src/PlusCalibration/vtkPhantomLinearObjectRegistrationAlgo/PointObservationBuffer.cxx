@@ -9,6 +9,12 @@ See License.txt for details.
 #include "PointObservationBuffer.h"
 #include "igsioCommon.h"
 
+#include <algorithm>
+#include <thread>
+
+// Distances are computed on multiple threads only if each thread gets at least this many observations
+static const unsigned int MINIMUM_NUMBER_OF_OBSERVATIONS_PER_THREAD = 4096;
+
 PointObservationBuffer::PointObservationBuffer()
 {
 }
@@ -175,9 +181,9 @@ void PointObservationBuffer::Filter( LinearObject* object, int filterWidth )
     double stdev = 0;
 
     // Calculate the distance of each point to the linear object
+    this->CalculateDistances( object, distances );
     for ( unsigned int i = 0; i < this->Size(); i++ )
     {
-      distances.at( i ) = object->DistanceToVector( this->GetObservation( i )->Observation );
       meanDistance = meanDistance + distances.at( i );
       stdev = stdev + distances.at( i ) * distances.at( i );
     }
@@ -286,6 +292,78 @@ vnl_matrix<double>* PointObservationBuffer::CovarianceMatrix( std::vector<double
 
 //-----------------------------------------------------------------------------
 
+void PointObservationBuffer::CalculateCovarianceMatrix( unsigned int startIndex, unsigned int numberOfObservations, vnl_matrix<double>& cov ) const
+{
+  // Same operations in the same order as CalculateCentroid and CovarianceMatrix
+  double centroid[ PointObservation::SIZE ] = { 0 };
+  for ( unsigned int i = startIndex; i < startIndex + numberOfObservations; i++ )
+  {
+    for ( int d = 0; d < PointObservation::SIZE; d++ )
+    {
+      centroid[ d ] = centroid[ d ] + this->GetObservation( i )->Observation.at( d );
+    }
+  }
+  for ( int d = 0; d < PointObservation::SIZE; d++ )
+  {
+    centroid[ d ] = centroid[ d ] / numberOfObservations;
+  }
+
+  cov.set_size( PointObservation::SIZE, PointObservation::SIZE );
+  cov.fill( 0.0 );
+  for ( int d1 = 0; d1 < PointObservation::SIZE; d1++ )
+  {
+    for ( int d2 = 0; d2 < PointObservation::SIZE; d2++ )
+    {
+      for ( unsigned int i = startIndex; i < startIndex + numberOfObservations; i++ )
+      {
+        const std::vector<double>& observation = this->GetObservation( i )->Observation;
+        cov( d1, d2 ) = cov( d1, d2 ) + ( observation.at( d1 ) - centroid[ d1 ] ) * ( observation.at( d2 ) - centroid[ d2 ] );
+      }
+      cov( d1, d2 ) = cov( d1, d2 ) / numberOfObservations;
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+void PointObservationBuffer::CalculateDistances( LinearObject* object, std::vector<double>& distances ) const
+{
+  distances.resize( this->Size() );
+
+  unsigned int numberOfThreads = std::max( std::thread::hardware_concurrency(), 1u );
+  numberOfThreads = std::max( 1u, std::min<unsigned int>( numberOfThreads, this->Size() / MINIMUM_NUMBER_OF_OBSERVATIONS_PER_THREAD ) );
+
+  // Each thread computes the distances of a contiguous range of observations
+  std::vector<std::thread> threads;
+  const unsigned int observationsPerThread = ( this->Size() + numberOfThreads - 1 ) / numberOfThreads;
+  for ( unsigned int threadIndex = 0; threadIndex < numberOfThreads; threadIndex++ )
+  {
+    const unsigned int startIndex = threadIndex * observationsPerThread;
+    const unsigned int endIndex = std::min<unsigned int>( startIndex + observationsPerThread, this->Size() );
+    auto calculateRange = [this, object, &distances, startIndex, endIndex]()
+    {
+      for ( unsigned int i = startIndex; i < endIndex; i++ )
+      {
+        distances.at( i ) = object->DistanceToVector( this->GetObservation( i )->Observation );
+      }
+    };
+    if ( threadIndex + 1 < numberOfThreads )
+    {
+      threads.push_back( std::thread( calculateRange ) );
+    }
+    else
+    {
+      calculateRange();
+    }
+  }
+  for ( unsigned int threadIndex = 0; threadIndex < threads.size(); threadIndex++ )
+  {
+    threads.at( threadIndex ).join();
+  }
+}
+
+//-----------------------------------------------------------------------------
+
 std::vector<double> PointObservationBuffer::CalculateCentroid()
 {
   // Calculate the centroid
@@ -317,25 +395,23 @@ std::vector<PointObservationBuffer*> PointObservationBuffer::ExtractLinearObject
   bool collecting = false;
 
   std::vector<PointObservationBuffer*> linearObjects;
+  if ( this->Size() <= TEST_INTERVAL )
+  {
+    delete eigenBuffer;
+    return linearObjects;
+  }
 
   // Note: i is the start of the interval over which we will exam for linearity
+  vnl_matrix<double> cov( PointObservation::SIZE, PointObservation::SIZE, 0.0 );
   for ( unsigned int i = 0; i < this->Size() - TEST_INTERVAL; i++ )
   {
-    // Create a smaller point observation buffer to work with at each iteration with the points of interest
-    PointObservationBuffer* tempBuffer = new PointObservationBuffer();
-    for ( unsigned int j = i; j < i + TEST_INTERVAL; j++ )
-    {
-      tempBuffer->AddObservation( this->GetObservation( j ) );
-    }
-
-    // Find the eigenvalues of covariance matrix
-    std::vector<double> centroid = tempBuffer->CalculateCentroid();
-    vnl_matrix<double>* cov = tempBuffer->CovarianceMatrix( centroid );
+    // Find the eigenvalues of covariance matrix of the points of interest (computed in place, the points are not copied to a temporary buffer)
+    this->CalculateCovarianceMatrix( i, TEST_INTERVAL, cov );
 
     //Calculate the eigenvectors of the covariance matrix
     vnl_matrix<double> eigenvectors( PointObservation::SIZE, PointObservation::SIZE, 0.0 );
     vnl_vector<double> eigenvalues( PointObservation::SIZE, 0.0 );
-    vnl_symmetric_eigensystem_compute( *cov, eigenvectors, eigenvalues );
+    vnl_symmetric_eigensystem_compute( cov, eigenvectors, eigenvalues );
     // Note: eigenvectors are ordered in increasing eigenvalue ( 0 = smallest, end = biggest )
 
     std::vector<double> eigen( 3, 0.0 );
@@ -58,6 +58,12 @@ private:
   std::vector<double> CalculateCentroid();
   vnl_matrix<double>* CovarianceMatrix( std::vector<double> centroid );
 
+  // Same as CovarianceMatrix( CalculateCentroid() ) for a range of observations, without copying the observations
+  void CalculateCovarianceMatrix( unsigned int startIndex, unsigned int numberOfObservations, vnl_matrix<double>& cov ) const;
+
+  // Distance of each observation from the linear object, large buffers are processed on multiple threads
+  void CalculateDistances( LinearObject* object, std::vector<double>& distances ) const;
+
 };
 
 #endif
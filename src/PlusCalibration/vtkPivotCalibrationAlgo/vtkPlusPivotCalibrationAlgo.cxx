@@ -16,6 +16,10 @@
 #include "vtkMath.h"
 #include "vtksys/SystemTools.hxx"
 
+#include <vnl/algo/vnl_svd.h>
+
+#include <algorithm>
+
 vtkStandardNewMacro(vtkPlusPivotCalibrationAlgo);
 
 //-----------------------------------------------------------------------------
@@ -31,6 +35,12 @@ vtkPlusPivotCalibrationAlgo::vtkPlusPivotCalibrationAlgo()
   this->PivotPointPosition_Reference[1] = 0.0;
   this->PivotPointPosition_Reference[2] = 0.0;
   this->PivotPointPosition_Reference[3] = 1.0;
+
+  this->CalibrationPointSubsamplingFactor = 1;
+  this->NumberOfCalibrationPoints = 0;
+  this->NormalMatrix.fill(0);
+  this->NormalRightSide.fill(0);
+  this->SumOfSquaredRightSide = 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -49,14 +59,84 @@ void vtkPlusPivotCalibrationAlgo::RemoveAllCalibrationPoints()
   }
   this->MarkerToReferenceTransformMatrixArray.clear();
   this->OutlierIndices.clear();
+
+  this->NumberOfCalibrationPoints = 0;
+  this->NormalMatrix.fill(0);
+  this->NormalRightSide.fill(0);
+  this->SumOfSquaredRightSide = 0;
 }
 
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusPivotCalibrationAlgo::InsertNextCalibrationPoint(vtkMatrix4x4* aMarkerToReferenceTransformMatrix)
 {
-  vtkMatrix4x4* markerToReferenceTransformMatrixCopy = vtkMatrix4x4::New();
-  markerToReferenceTransformMatrixCopy->DeepCopy(aMarkerToReferenceTransformMatrix);
-  this->MarkerToReferenceTransformMatrixArray.push_back(markerToReferenceTransformMatrixCopy);
+  // All the points are used for the live estimate, but only every CalibrationPointSubsamplingFactor-th point is stored for DoPivotCalibration
+  AccumulateCalibrationPoint(aMarkerToReferenceTransformMatrix);
+  if (this->NumberOfCalibrationPoints++ % this->CalibrationPointSubsamplingFactor == 0)
+  {
+    vtkMatrix4x4* markerToReferenceTransformMatrixCopy = vtkMatrix4x4::New();
+    markerToReferenceTransformMatrixCopy->DeepCopy(aMarkerToReferenceTransformMatrix);
+    this->MarkerToReferenceTransformMatrixArray.push_back(markerToReferenceTransformMatrixCopy);
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusPivotCalibrationAlgo::AccumulateCalibrationPoint(vtkMatrix4x4* markerToReferenceTransformMatrix)
+{
+  // Add the 3 equations of the sample (see GetPivotPointPosition) to the normal equations: N += Ai^T * Ai, r += Ai^T * bi
+  for (int i = 0; i < 3; i++)
+  {
+    double aMatrixRow[6] = { markerToReferenceTransformMatrix->Element[i][0], markerToReferenceTransformMatrix->Element[i][1], markerToReferenceTransformMatrix->Element[i][2], 0, 0, 0 };
+    aMatrixRow[3 + i] = -1;
+    double b = -markerToReferenceTransformMatrix->Element[i][3];
+    for (int row = 0; row < 6; row++)
+    {
+      for (int column = 0; column < 6; column++)
+      {
+        this->NormalMatrix(row, column) += aMatrixRow[row] * aMatrixRow[column];
+      }
+      this->NormalRightSide(row) += aMatrixRow[row] * b;
+    }
+    this->SumOfSquaredRightSide += b * b;
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusPivotCalibrationAlgo::GetLivePivotPointPosition(double* pivotPoint_Marker, double* pivotPoint_Reference, double* rmsError/*=NULL*/)
+{
+  if (this->NumberOfCalibrationPoints < 2)
+  {
+    LOG_DEBUG("Not enough points are available for live pivot calibration estimate");
+    return PLUS_FAIL;
+  }
+
+  vnl_matrix<double> normalMatrix(this->NormalMatrix.data_block(), 6, 6);
+  vnl_svd<double> normalMatrixSvd(normalMatrix);
+  normalMatrixSvd.zero_out_relative();
+  if (normalMatrixSvd.rank() < 6)
+  {
+    // The stylus has not been rotated enough around the pivot point yet
+    LOG_DEBUG("Pivot point position cannot be estimated yet: the stylus has not been rotated around at least two axes");
+    return PLUS_FAIL;
+  }
+  vnl_vector<double> normalRightSide(this->NormalRightSide.data_block(), 6);
+  vnl_vector<double> xVector = normalMatrixSvd.solve(normalRightSide);
+
+  pivotPoint_Marker[0] = xVector[0];
+  pivotPoint_Marker[1] = xVector[1];
+  pivotPoint_Marker[2] = xVector[2];
+
+  pivotPoint_Reference[0] = xVector[3];
+  pivotPoint_Reference[1] = xVector[4];
+  pivotPoint_Reference[2] = xVector[5];
+
+  if (rmsError != NULL)
+  {
+    // Sum of squared residuals |Ax-b|^2 = x^T*N*x - 2*x^T*r + b^T*b, which is the sum of squared pivot point position errors of the samples
+    double sumOfSquaredResiduals = dot_product(xVector, normalMatrix * xVector) - 2 * dot_product(xVector, normalRightSide) + this->SumOfSquaredRightSide;
+    *rmsError = sqrt(std::max(sumOfSquaredResiduals, 0.0) / this->NumberOfCalibrationPoints);
+  }
+
   return PLUS_SUCCESS;
 }
 
@@ -282,6 +362,7 @@ PlusStatus vtkPlusPivotCalibrationAlgo::ReadConfiguration(vtkXMLDataElement* aCo
   XML_READ_CSTRING_ATTRIBUTE_REQUIRED(ObjectMarkerCoordinateFrame, pivotCalibrationElement);
   XML_READ_CSTRING_ATTRIBUTE_REQUIRED(ReferenceCoordinateFrame, pivotCalibrationElement);
   XML_READ_CSTRING_ATTRIBUTE_REQUIRED(ObjectPivotPointCoordinateFrame, pivotCalibrationElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, CalibrationPointSubsamplingFactor, pivotCalibrationElement);
   return PLUS_SUCCESS;
 }
 
@@ -15,6 +15,10 @@ See License.txt for details.
 #include <vtkObject.h>
 #include <vtkMatrix4x4.h>
 
+// VNL includes
+#include <vnl/vnl_matrix_fixed.h>
+#include <vnl/vnl_vector_fixed.h>
+
 // STL includes
 #include <list>
 #include <set>
@@ -40,6 +44,10 @@ class vtkXMLDataElement;
   The method detects outlier points (points that have larger than 3x error than the standard deviation) and ignores them when computing the pivot point
   coordinates and the calibration error.
 
+  While the points are inserted, the normal equations of the least squares problem are updated in constant time per point, so a live estimate
+  of the pivot point (without outlier rejection) is available any time by GetLivePivotPointPosition. Only every CalibrationPointSubsamplingFactor-th
+  point is stored for the robust computation in DoPivotCalibration.
+
   \ingroup PlusLibCalibrationAlgorithm
 */
 class vtkPlusCalibrationExport vtkPlusPivotCalibrationAlgo : public vtkObject
@@ -67,6 +75,16 @@ public:
   */
   PlusStatus InsertNextCalibrationPoint(vtkMatrix4x4* aMarkerToReferenceTransformMatrix);
 
+  /*!
+    Compute the pivot point position from all the inserted calibration points, without outlier rejection.
+    It is fast (does not depend on the number of points), so it can be called after each inserted point to display the current estimate.
+    Returns with failure if the points are not sufficient for the computation yet (the marker has not been rotated around the pivot point enough).
+    \param pivotPoint_Marker Estimated pivot point position in the marker coordinate system (3 elements)
+    \param pivotPoint_Reference Estimated pivot point position in the reference coordinate system (3 elements)
+    \param rmsError Root mean square of the pivot point position errors of all the inserted points (in mm), optional
+  */
+  PlusStatus GetLivePivotPointPosition(double* pivotPoint_Marker, double* pivotPoint_Reference, double* rmsError = NULL);
+
   /*!
     Calibrate (call the minimizer and set the result)
     \param aTransformRepository Transform repository to save the results into
@@ -88,6 +106,11 @@ public:
 
 public:
   vtkGetMacro(CalibrationError, double);
+  /*! Number of all the inserted calibration points (including the ones that are not stored for the robust calibration) */
+  vtkGetMacro(NumberOfCalibrationPoints, int);
+  /*! Only every N-th inserted calibration point is stored and used by DoPivotCalibration. Default: 1 (all points are stored). */
+  vtkGetMacro(CalibrationPointSubsamplingFactor, int);
+  vtkSetClampMacro(CalibrationPointSubsamplingFactor, int, 1, VTK_INT_MAX);
   vtkGetObjectMacro(PivotPointToMarkerTransformMatrix, vtkMatrix4x4);
   vtkGetVector3Macro(PivotPointPosition_Reference, double);
   vtkGetStringMacro(ObjectMarkerCoordinateFrame);
@@ -110,6 +133,9 @@ protected:
 
   PlusStatus GetPivotPointPosition(double* pivotPoint_Marker, double* pivotPoint_Reference);
 
+  /*! Add the equations of a calibration point to the normal equations of the live estimate */
+  void AccumulateCalibrationPoint(vtkMatrix4x4* markerToReferenceTransformMatrix);
+
 protected:
   /*! Pivot point to marker transform (eg. stylus tip to stylus) - the result of the calibration */
   vtkMatrix4x4*             PivotPointToMarkerTransformMatrix;
@@ -134,6 +160,17 @@ protected:
 
   /*! List of outlier sample indices */
   std::set<unsigned int>    OutlierIndices;
+
+  /*! Only every N-th inserted point is stored in MarkerToReferenceTransformMatrixArray */
+  int                       CalibrationPointSubsamplingFactor;
+
+  /*! Number of all the inserted calibration points */
+  int                       NumberOfCalibrationPoints;
+
+  /*! Normal equations of all the inserted calibration points (A^T*A, A^T*b, b^T*b), for the live estimate */
+  vnl_matrix_fixed<double, 6, 6> NormalMatrix;
+  vnl_vector_fixed<double, 6> NormalRightSide;
+  double                    SumOfSquaredRightSide;
 };
 
 #endif
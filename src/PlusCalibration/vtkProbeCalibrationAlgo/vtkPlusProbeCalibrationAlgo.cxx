@@ -8,6 +8,7 @@ See License.txt for details.
 #include "vtkPlusProbeCalibrationAlgo.h"
 
 #include "float.h"
+#include <vnl/vnl_det.h>
 #include <vnl/vnl_inverse.h>
 
 #include "vtkIGSIOTrackedFrameList.h"
@@ -32,6 +33,7 @@ See License.txt for details.
 
 static const int MIN_NUMBER_OF_VALID_CALIBRATION_FRAMES = 10; // minimum number of successfully calibrated frames required for calibration
 static const double DEFAULT_ERROR_CONFIDENCE_INTERVAL = 0.95; // this fraction of the data is taken into account when computing mean and standard deviation in the final calibration error report
+static const int MINIMUM_NUMBER_OF_INCREMENTAL_CALIBRATION_EQUATIONS = 8; // same as the minimum number of equations of PlusMath::LSQRMinimize
 
 vtkStandardNewMacro(vtkPlusProbeCalibrationAlgo);
 
@@ -179,25 +181,7 @@ PlusStatus vtkPlusProbeCalibrationAlgo::ComputeImageToProbeTransformByLinearLeas
     imageToProbeTransformMatrix.set_row(row, resultVector);
   }
 
-  // Force the last row to be exactly (0,0,0,1) - sometimes it contains numbers of 1e-18 magnitude
-  imageToProbeTransformMatrix(3, 0) = 0;
-  imageToProbeTransformMatrix(3, 1) = 0;
-  imageToProbeTransformMatrix(3, 2) = 0;
-  imageToProbeTransformMatrix(3, 3) = 1;
-
-  // Complete the transformation matrix from a projection matrix to a 3D-3D transformation matrix (so that it can be inverted or can be used to transform 3D widgets to the image plane)
-  // Make the z vector have about the same length as x an y, so that when a 3D widget is transformed using this transform, the aspect ratio is maintained
-
-  double xVector[3] = {imageToProbeTransformMatrix(0, 0), imageToProbeTransformMatrix(1, 0), imageToProbeTransformMatrix(2, 0)};
-  double yVector[3] = {imageToProbeTransformMatrix(0, 1), imageToProbeTransformMatrix(1, 1), imageToProbeTransformMatrix(2, 1)};
-  double zVector[3] = {0, 0, 0};
-  vtkMath::Cross(xVector, yVector, zVector);
-  vtkMath::Normalize(zVector);
-  double normZ = (vtkMath::Norm(xVector) + vtkMath::Norm(yVector)) / 2;
-  vtkMath::MultiplyScalar(zVector, normZ);
-  imageToProbeTransformMatrix(0, 2) = zVector[0];
-  imageToProbeTransformMatrix(1, 2) = zVector[1];
-  imageToProbeTransformMatrix(2, 2) = zVector[2];
+  CompleteImageToProbeTransformMatrix(imageToProbeTransformMatrix);
 
   LOG_DEBUG(outliers.size() << " outliers points were found");
 
@@ -365,6 +349,210 @@ PlusStatus vtkPlusProbeCalibrationAlgo::Calibrate(vtkIGSIOTrackedFrameList* vali
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusProbeCalibrationAlgo::CompleteImageToProbeTransformMatrix(vnl_matrix_fixed<double, 4, 4>& imageToProbeTransformMatrix)
+{
+  // Force the last row to be exactly (0,0,0,1) - sometimes it contains numbers of 1e-18 magnitude
+  imageToProbeTransformMatrix(3, 0) = 0;
+  imageToProbeTransformMatrix(3, 1) = 0;
+  imageToProbeTransformMatrix(3, 2) = 0;
+  imageToProbeTransformMatrix(3, 3) = 1;
+
+  // Complete the transformation matrix from a projection matrix to a 3D-3D transformation matrix (so that it can be inverted or can be used to transform 3D widgets to the image plane)
+  // Make the z vector have about the same length as x an y, so that when a 3D widget is transformed using this transform, the aspect ratio is maintained
+
+  double xVector[3] = {imageToProbeTransformMatrix(0, 0), imageToProbeTransformMatrix(1, 0), imageToProbeTransformMatrix(2, 0)};
+  double yVector[3] = {imageToProbeTransformMatrix(0, 1), imageToProbeTransformMatrix(1, 1), imageToProbeTransformMatrix(2, 1)};
+  double zVector[3] = {0, 0, 0};
+  vtkMath::Cross(xVector, yVector, zVector);
+  vtkMath::Normalize(zVector);
+  double normZ = (vtkMath::Norm(xVector) + vtkMath::Norm(yVector)) / 2;
+  vtkMath::MultiplyScalar(zVector, normZ);
+  imageToProbeTransformMatrix(0, 2) = zVector[0];
+  imageToProbeTransformMatrix(1, 2) = zVector[1];
+  imageToProbeTransformMatrix(2, 2) = zVector[2];
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusProbeCalibrationAlgo::ResetIncrementalCalibration(const std::vector<PlusNWire>& nWires)
+{
+  LOG_TRACE("vtkPlusProbeCalibrationAlgo::ResetIncrementalCalibration");
+
+  this->NWires = nWires;
+
+  this->PreProcessedWirePositions[CALIBRATION_ALL].Clear();
+  this->PreProcessedWirePositions[VALIDATION_ALL].Clear();
+  this->PreProcessedWirePositions[CALIBRATION_NOT_OUTLIER].Clear();
+
+  for (int row = 0; row < NUMBER_OF_INCREMENTAL_CALIBRATION_ROWS; ++row)
+  {
+    this->IncrementalCalibrationEquations[row].Clear();
+  }
+  this->IncrementalCalibrationOutliers.clear();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusProbeCalibrationAlgo::AddIncrementalCalibrationFrame(igsioTrackedFrame* trackedFrame, vtkIGSIOTransformRepository* transformRepository)
+{
+  LOG_TRACE("vtkPlusProbeCalibrationAlgo::AddIncrementalCalibrationFrame");
+
+  if (this->NWires.empty())
+  {
+    LOG_ERROR("Unable to add frame to incremental calibration - no N-wires are defined, call ResetIncrementalCalibration first");
+    return PLUS_FAIL;
+  }
+
+  const unsigned int numberOfFramesBefore = this->PreProcessedWirePositions[CALIBRATION_ALL].FramePositions.size();
+  if (AddPositionsPerImage(trackedFrame, transformRepository, CALIBRATION_ALL) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Add incremental calibration position failed");
+    return PLUS_FAIL;
+  }
+  if (this->PreProcessedWirePositions[CALIBRATION_ALL].FramePositions.size() == numberOfFramesBefore)
+  {
+    // Segmentation failed on this frame, there are no new points
+    return PLUS_SUCCESS;
+  }
+
+  // Add the middle wire intersection points of the new frame to the normal equations
+  const unsigned int numberOfNWiresOnEachFrame = this->NWires.size();
+  for (unsigned int nWireIndex = 0; nWireIndex < numberOfNWiresOnEachFrame; ++nWireIndex)
+  {
+    const unsigned int pointIndex = numberOfFramesBefore * numberOfNWiresOnEachFrame + nWireIndex;
+    for (int row = 0; row < NUMBER_OF_INCREMENTAL_CALIBRATION_ROWS; ++row)
+    {
+      AccumulateIncrementalCalibrationPoint(pointIndex, row, 1.0);
+    }
+    this->IncrementalCalibrationOutliers.push_back(0);
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusProbeCalibrationAlgo::AccumulateIncrementalCalibrationPoint(unsigned int pointIndex, int row, double weight)
+{
+  const unsigned int numberOfNWiresOnEachFrame = this->NWires.size();
+  const NWirePositionType& framePosition = this->PreProcessedWirePositions[CALIBRATION_ALL].FramePositions[pointIndex / numberOfNWiresOnEachFrame];
+  const unsigned int nWireIndex = pointIndex % numberOfNWiresOnEachFrame;
+  const vnl_vector_fixed<double, 4>& middleWireIntersectionPointPos_Image = framePosition.AllWiresIntersectionPointsPos_Image[nWireIndex * 3 + 1];
+
+  // The segmented points are in the image plane (z=0), so only the x, y and homogeneous coordinates are unknowns
+  vnl_vector_fixed<double, 3> equationCoefficients(middleWireIntersectionPointPos_Image[0], middleWireIntersectionPointPos_Image[1], middleWireIntersectionPointPos_Image[3]);
+  const double rightSide = framePosition.MiddleWireIntersectionPointsPos_Probe[nWireIndex][row];
+
+  NormalEquationsType& equations = this->IncrementalCalibrationEquations[row];
+  equations.NormalMatrix += weight * outer_product(equationCoefficients, equationCoefficients);
+  equations.NormalRightSide += (weight * rightSide) * equationCoefficients;
+  equations.SumOfRightSide += weight * rightSide;
+  equations.SumOfSquaredRightSide += weight * rightSide * rightSide;
+  equations.NumberOfEquations += (weight > 0 ? 1 : -1);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusProbeCalibrationAlgo::UpdateIncrementalCalibration(vtkIGSIOTransformRepository* transformRepository, bool optimize /*=false*/)
+{
+  LOG_TRACE("vtkPlusProbeCalibrationAlgo::UpdateIncrementalCalibration");
+
+  const unsigned int numberOfNWiresOnEachFrame = this->NWires.size();
+  const unsigned int numberOfFrames = this->PreProcessedWirePositions[CALIBRATION_ALL].FramePositions.size();
+  if (numberOfFrames < MIN_NUMBER_OF_VALID_CALIBRATION_FRAMES)
+  {
+    LOG_ERROR("Unable to perform calibration - there are " << numberOfFrames << " frames with segmented points and minimum " << MIN_NUMBER_OF_VALID_CALIBRATION_FRAMES << " frames are needed");
+    return PLUS_FAIL;
+  }
+
+  vnl_matrix_fixed<double, 4, 4> imageToProbeTransformMatrix;
+  imageToProbeTransformMatrix.fill(0);
+  std::set<int> outliers;
+  const unsigned int numberOfPoints = this->IncrementalCalibrationOutliers.size();
+  for (int row = 0; row < NUMBER_OF_INCREMENTAL_CALIBRATION_ROWS; ++row)
+  {
+    NormalEquationsType& equations = this->IncrementalCalibrationEquations[row];
+    const unsigned char outlierRowFlag = static_cast<unsigned char>(1 << row);
+    vnl_vector_fixed<double, 3> resultVector;
+
+    // Same outlier rejection as in the batch solution (see PlusMath::LSQRMinimize): remove the equations that are further than 3 stdev
+    // from the mean residual and solve again until no outlier is found. Solving and the residual statistics only need the normal equations,
+    // and removed equations are subtracted from them, so only the residuals of the points are computed again on each iteration.
+    // Points that have been removed stay outliers for the rest of the incremental calibration.
+    bool outlierFound = true;
+    while (outlierFound)
+    {
+      if (equations.NumberOfEquations <= MINIMUM_NUMBER_OF_INCREMENTAL_CALIBRATION_EQUATIONS)
+      {
+        LOG_ERROR("It was not possible calibrate! Not enough equations!");
+        return PLUS_FAIL;
+      }
+      if (std::abs(vnl_det(equations.NormalMatrix)) <= 1e-12 * std::abs(equations.NormalMatrix(0, 0) * equations.NormalMatrix(1, 1) * equations.NormalMatrix(2, 2)))
+      {
+        LOG_ERROR("Unable to perform calibration - the linear equations are ill-conditioned");
+        return PLUS_FAIL;
+      }
+      resultVector = vnl_inverse(equations.NormalMatrix) * equations.NormalRightSide;
+
+      // Mean and standard deviation of the residuals (Ax - b) from the normal equations
+      const double sumOfDifferences = dot_product(equations.NormalMatrix.get_column(2), resultVector) - equations.SumOfRightSide;
+      const double sumOfSquaredDifferences = dot_product(resultVector, equations.NormalMatrix * resultVector)
+                                             - 2.0 * dot_product(resultVector, equations.NormalRightSide) + equations.SumOfSquaredRightSide;
+      const double meanDifference = sumOfDifferences / equations.NumberOfEquations;
+      const double variance = sumOfSquaredDifferences / equations.NumberOfEquations - meanDifference * meanDifference;
+      const double stdevDifference = sqrt(std::max(variance, 0.0));
+      const double thresholdMultiplier = 3.0;
+
+      outlierFound = false;
+      for (unsigned int pointIndex = 0; pointIndex < numberOfPoints; ++pointIndex)
+      {
+        if (this->IncrementalCalibrationOutliers[pointIndex] & outlierRowFlag)
+        {
+          continue;
+        }
+        const NWirePositionType& framePosition = this->PreProcessedWirePositions[CALIBRATION_ALL].FramePositions[pointIndex / numberOfNWiresOnEachFrame];
+        const unsigned int nWireIndex = pointIndex % numberOfNWiresOnEachFrame;
+        const vnl_vector_fixed<double, 4>& middleWireIntersectionPointPos_Image = framePosition.AllWiresIntersectionPointsPos_Image[nWireIndex * 3 + 1];
+        const double difference = resultVector[0] * middleWireIntersectionPointPos_Image[0] + resultVector[1] * middleWireIntersectionPointPos_Image[1]
+                                  + resultVector[2] * middleWireIntersectionPointPos_Image[3] - framePosition.MiddleWireIntersectionPointsPos_Probe[nWireIndex][row];
+        if (fabs(difference - meanDifference) >= thresholdMultiplier * stdevDifference)
+        {
+          LOG_DEBUG("Outlier: " << std::fixed << difference << "(mean: " << meanDifference << "  stdev: " << stdevDifference << "  outlierTreshold: " << thresholdMultiplier * stdevDifference << ")");
+          AccumulateIncrementalCalibrationPoint(pointIndex, row, -1.0);
+          this->IncrementalCalibrationOutliers[pointIndex] |= outlierRowFlag;
+          outlierFound = true;
+        }
+      }
+    }
+
+    imageToProbeTransformMatrix(row, 0) = resultVector[0];
+    imageToProbeTransformMatrix(row, 1) = resultVector[1];
+    imageToProbeTransformMatrix(row, 3) = resultVector[2];
+  }
+
+  for (unsigned int pointIndex = 0; pointIndex < numberOfPoints; ++pointIndex)
+  {
+    if (this->IncrementalCalibrationOutliers[pointIndex])
+    {
+      outliers.insert(pointIndex);
+    }
+  }
+  LOG_DEBUG(outliers.size() << " outliers points were found");
+
+  CompleteImageToProbeTransformMatrix(imageToProbeTransformMatrix);
+  SetAndValidateImageToProbeTransform(imageToProbeTransformMatrix, transformRepository);
+
+  if (optimize && this->Optimizer->Enabled())
+  {
+    LOG_INFO("Additional calibration optimization is requested");
+    this->PreProcessedWirePositions[CALIBRATION_NOT_OUTLIER].Clear();
+    UpdateNonOutlierData(outliers);
+    this->Optimizer->SetImageToProbeSeedTransform(imageToProbeTransformMatrix);
+    this->Optimizer->Update();
+    imageToProbeTransformMatrix = this->Optimizer->GetOptimizedImageToProbeTransformMatrix();
+    SetAndValidateImageToProbeTransform(imageToProbeTransformMatrix, transformRepository);
+  }
+
+  return PLUS_SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusProbeCalibrationAlgo::AddPositionsPerImage(igsioTrackedFrame* trackedFrame, vtkIGSIOTransformRepository* transformRepository, PreProcessedWirePositionIdType datasetType)
 {
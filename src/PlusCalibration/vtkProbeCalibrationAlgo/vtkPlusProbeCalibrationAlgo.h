@@ -114,6 +114,30 @@ public:
   PlusStatus GetXMLCalibrationResultAndErrorReport( vtkIGSIOTrackedFrameList* validationTrackedFrameList, int validationStartFrame,
       int validationEndFrame, vtkIGSIOTrackedFrameList* calibrationTrackedFrameList, int calibrationStartFrame, int calibrationEndFrame, vtkXMLDataElement* probeCalibrationResult );
 
+  /*!
+    Start an incremental calibration: calibration frames are added one by one by AddIncrementalCalibrationFrame (e.g., as they are acquired)
+    and the calibration result can be updated any time by UpdateIncrementalCalibration. Removes all previously added calibration data.
+    \param nWires NWire structure that contains the computed imaginary intersections. It used to determine the computed position
+  */
+  void ResetIncrementalCalibration( const std::vector<PlusNWire>& nWires );
+
+  /*!
+    Add a segmented frame to the incremental calibration. The middle wire intersection points of the frame are added to the
+    normal equations of the linear least squares problem, so the cost does not depend on the number of frames added before.
+    Frames that could not be segmented are ignored.
+    \param trackedFrame Tracked frame with segmentation results
+    \param transformRepository Transform repository object to be able to get the default transform
+  */
+  PlusStatus AddIncrementalCalibrationFrame( igsioTrackedFrame* trackedFrame, vtkIGSIOTransformRepository* transformRepository );
+
+  /*!
+    Compute the calibration result from the frames added to the incremental calibration. The linear solution and the outlier removal
+    use only the accumulated normal equations, which is cheap enough to be called after each frame. Outliers are removed permanently.
+    \param transformRepository Transform repository object to store the ImageToProbe transform in
+    \param optimize If true and the optimizer is enabled, then the result of the linear solution is refined by the (more expensive) optimizer
+  */
+  PlusStatus UpdateIncrementalCalibration( vtkIGSIOTransformRepository* transformRepository, bool optimize = false );
+
   vtkPlusProbeCalibrationOptimizerAlgo* GetOptimizer()
   {
     return this->Optimizer;
@@ -187,6 +211,15 @@ protected:
   */
   void UpdateNonOutlierData( const std::set<int>& outliers );
 
+  /*! Set the last row of the linear least squares solution to (0,0,0,1) and compute the z axis from the x and y axes */
+  static void CompleteImageToProbeTransformMatrix( vnl_matrix_fixed<double, 4, 4>& imageToProbeTransformMatrix );
+
+  /*!
+    Add (weight=1) or remove (weight=-1) the equation of a calibration point to/from the normal equations of a row of the ImageToProbe matrix
+    \param pointIndex Index of the point in the calibration data (frame index * number of N-wires + N-wire index)
+  */
+  void AccumulateIncrementalCalibrationPoint( unsigned int pointIndex, int row, double weight );
+
   static double PointToWireDistance( const vnl_double_3& aPoint, const vnl_double_3& aLineEndPoint1, const vnl_double_3& aLineEndPoint2 );
 
 protected:
@@ -316,6 +349,43 @@ protected:
 
   vtkPlusProbeCalibrationOptimizerAlgo* Optimizer;
 
+  /*! Number of ImageToProbe matrix rows that are computed by the incremental calibration (the last row is always (0,0,0,1)) */
+  static const int NUMBER_OF_INCREMENTAL_CALIBRATION_ROWS = 3;
+
+  /*!
+    Normal equations of the linear least squares problem of a row of the ImageToProbe matrix. The unknowns are the coefficients
+    of the x, y and homogeneous coordinates (the image z coordinate of the segmented points is always 0).
+  */
+  struct NormalEquationsType
+  {
+    /*! Sum of a*a^T for all equations a*x=b */
+    vnl_matrix_fixed<double, 3, 3> NormalMatrix;
+    /*! Sum of a*b for all equations a*x=b */
+    vnl_vector_fixed<double, 3> NormalRightSide;
+    double SumOfRightSide;
+    double SumOfSquaredRightSide;
+    int NumberOfEquations;
+
+    NormalEquationsType()
+    {
+      Clear();
+    }
+
+    void Clear()
+    {
+      NormalMatrix.fill(0);
+      NormalRightSide.fill(0);
+      SumOfRightSide = 0;
+      SumOfSquaredRightSide = 0;
+      NumberOfEquations = 0;
+    }
+  };
+
+  NormalEquationsType IncrementalCalibrationEquations[NUMBER_OF_INCREMENTAL_CALIBRATION_ROWS];
+
+  /*! Outlier flags of the incremental calibration points, bit i is set if the point is an outlier in row i */
+  std::vector<unsigned char> IncrementalCalibrationOutliers;
+
 private:
   vtkPlusProbeCalibrationAlgo( const vtkPlusProbeCalibrationAlgo& );
   void operator=( const vtkPlusProbeCalibrationAlgo& );
@@ -33,6 +33,7 @@ vtkPlusSpacingCalibAlgo::vtkPlusSpacingCalibAlgo()
   this->ReportTable = NULL;
   this->ErrorMean = 0.0;
   this->ErrorStdev = 0.0;
+  this->NumberOfThreads = 0;
 }
 
 //----------------------------------------------------------------------------
@@ -50,6 +51,7 @@ void vtkPlusSpacingCalibAlgo::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "Update time: " << UpdateTime.GetMTime() << std::endl;
   os << indent << "Spacing: " << this->Spacing[0] << "  " << this->Spacing[1] << std::endl;
   os << indent << "Calibration error: mean=" << this->ErrorMean << "  stdev=" << this->ErrorStdev << std::endl;
+  os << indent << "Number of threads: " << this->NumberOfThreads << std::endl;
 
   if (this->TrackedFrameList != NULL)
   {
@@ -120,8 +122,8 @@ PlusStatus vtkPlusSpacingCalibAlgo::Update()
   }
 
   // Construct linear equations Ax = b, where A is a matrix with m rows and
-  // n columns, b is an m-vector.
-  std::vector<vnl_vector<double> > aMatrix;
+  // n columns (stored row by row), b is an m-vector.
+  std::vector<double> aMatrix;
   std::vector<double> bVector;
 
   // Construct linear equation for spacing calibration
@@ -138,9 +140,9 @@ PlusStatus vtkPlusSpacingCalibAlgo::Update()
   }
 
   vnl_vector<double> scalingCalibResult(2, 0);   // [sx, sy]
-  if (PlusMath::LSQRMinimize(aMatrix, bVector, scalingCalibResult, &this->ErrorMean, &this->ErrorStdev) != PLUS_SUCCESS)
+  if (PlusMath::LSQRMinimizeDense(aMatrix, bVector, scalingCalibResult, &this->ErrorMean, &this->ErrorStdev, this->NumberOfThreads) != PLUS_SUCCESS)
   {
-    LOG_WARNING("Failed to run LSQRMinimize!");
+    LOG_WARNING("Failed to run LSQRMinimizeDense!");
     return PLUS_FAIL;
   }
 
@@ -164,7 +166,7 @@ PlusStatus vtkPlusSpacingCalibAlgo::Update()
 
 
 //----------------------------------------------------------------------------
-PlusStatus vtkPlusSpacingCalibAlgo::ConstructLinearEquationForCalibration(std::vector<vnl_vector<double> >& aMatrix, std::vector<double>& bVector)
+PlusStatus vtkPlusSpacingCalibAlgo::ConstructLinearEquationForCalibration(std::vector<double>& aMatrix, std::vector<double>& bVector)
 {
   LOG_TRACE("vtkPlusSpacingCalibAlgo::ConstructLinearEquationForCalibration");
   aMatrix.clear();
@@ -196,6 +198,10 @@ PlusStatus vtkPlusSpacingCalibAlgo::ConstructLinearEquationForCalibration(std::v
     verticalDistanceMm.push_back(vd);
   }
 
+  // Each frame gives two equations per neighboring N wire pairs, with two coefficients per equation
+  aMatrix.reserve(this->TrackedFrameList->GetNumberOfTrackedFrames() * (this->NWires.size() - 1) * 2 * 2);
+  bVector.reserve(this->TrackedFrameList->GetNumberOfTrackedFrames() * (this->NWires.size() - 1) * 2);
+
   for (unsigned int frame = 0; frame < this->TrackedFrameList->GetNumberOfTrackedFrames(); ++frame)
   {
     igsioTrackedFrame* trackedFrame = this->TrackedFrameList->GetTrackedFrame(frame);
@@ -236,11 +242,9 @@ PlusStatus vtkPlusSpacingCalibAlgo::ConstructLinearEquationForCalibration(std::v
       double xHorizontalDistance = fabs(wRightPx[0] - wLeftPx[0]);
       double yHorizontalDistance = fabs(wRightPx[1] - wLeftPx[1]);
 
-      // Populate the sparse matrix with squared distances in pixel
-      vnl_vector<double> scaleFactorHorizontal(2, 0);
-      scaleFactorHorizontal.put(0, pow(xHorizontalDistance, 2));
-      scaleFactorHorizontal.put(1, pow(yHorizontalDistance, 2));
-      aMatrix.push_back(scaleFactorHorizontal);
+      // Populate the matrix with squared distances in pixel
+      aMatrix.push_back(xHorizontalDistance * xHorizontalDistance);
+      aMatrix.push_back(yHorizontalDistance * yHorizontalDistance);
 
       // Add the squared distance in mm
       bVector.push_back(pow(horizontalDistanceMm[w], 2));
@@ -249,11 +253,9 @@ PlusStatus vtkPlusSpacingCalibAlgo::ConstructLinearEquationForCalibration(std::v
       double xVerticalDistance = fabs(wBottomPx[0] - wTopPx[0]);
       double yVerticalDistance = fabs(wBottomPx[1] - wTopPx[1]);
 
-      // Populate the sparse matrix with squared distances in pixel
-      vnl_vector<double> scaleFactorVertical(2, 0);
-      scaleFactorVertical.put(0, pow(xVerticalDistance, 2));
-      scaleFactorVertical.put(1, pow(yVerticalDistance, 2));
-      aMatrix.push_back(scaleFactorVertical);
+      // Populate the matrix with squared distances in pixel
+      aMatrix.push_back(xVerticalDistance * xVerticalDistance);
+      aMatrix.push_back(yVerticalDistance * yVerticalDistance);
 
       // Add the squared distance in mm
       bVector.push_back(pow(verticalDistanceMm[w], 2));
@@ -265,7 +267,7 @@ PlusStatus vtkPlusSpacingCalibAlgo::ConstructLinearEquationForCalibration(std::v
 }
 
 //----------------------------------------------------------------------------
-PlusStatus vtkPlusSpacingCalibAlgo::UpdateReportTable(const std::vector<vnl_vector<double> >& aMatrix,
+PlusStatus vtkPlusSpacingCalibAlgo::UpdateReportTable(const std::vector<double>& aMatrix,
     const std::vector<double>& bVector,
     const vnl_vector<double>& resultVector)
 {
@@ -291,9 +293,9 @@ PlusStatus vtkPlusSpacingCalibAlgo::UpdateReportTable(const std::vector<vnl_vect
   {
     vtkSmartPointer<vtkVariantArray> tableRow = vtkSmartPointer<vtkVariantArray>::New();
 
-    tableRow->InsertNextValue(sqrt(aMatrix[row].get(0) * sX + aMatrix[row].get(1) * sY) - sqrt(bVector[row]));           // Computed-Measured Distance - X (mm)
+    tableRow->InsertNextValue(sqrt(aMatrix[row * 2] * sX + aMatrix[row * 2 + 1] * sY) - sqrt(bVector[row]));           // Computed-Measured Distance - X (mm)
     tableRow->InsertNextValue(sqrt(bVector[row]));     // Measured Distance - X (mm)
-    tableRow->InsertNextValue(sqrt(aMatrix[row + 1].get(0) * sX + aMatrix[row + 1].get(1) * sY) - sqrt(bVector[row + 1]));           // Computed-Measured Distance - Y (mm)
+    tableRow->InsertNextValue(sqrt(aMatrix[(row + 1) * 2] * sX + aMatrix[(row + 1) * 2 + 1] * sY) - sqrt(bVector[row + 1]));           // Computed-Measured Distance - Y (mm)
     tableRow->InsertNextValue(sqrt(bVector[row + 1]));     // Measured Distance - Y (mm)
 
     if (tableRow->GetNumberOfTuples() == this->ReportTable->GetNumberOfColumns())
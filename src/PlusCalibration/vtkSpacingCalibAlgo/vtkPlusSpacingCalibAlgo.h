@@ -52,6 +52,10 @@ public:
   /*! Get the spacing calibration error */
   virtual PlusStatus GetError(double& mean, double& stdev);
 
+  /*! Number of threads used for solving the linear equations. If 0 then the number of processors is used. */
+  vtkSetMacro(NumberOfThreads, int);
+  vtkGetMacro(NumberOfThreads, int);
+
 protected:
   vtkPlusSpacingCalibAlgo();
   virtual ~vtkPlusSpacingCalibAlgo();
@@ -59,15 +63,19 @@ protected:
   /*! Bring this algorithm's outputs up-to-date. */
   virtual PlusStatus Update();
 
-  /*! Construct linear equation for spacing calibration */
-  virtual PlusStatus ConstructLinearEquationForCalibration(std::vector<vnl_vector<double> >& aMatrix, std::vector<double>& bVector);
+  /*!
+    Construct linear equation for spacing calibration
+    \param aMatrix Coefficients of the equations, two values per equation
+    \param bVector Right side of the equations
+  */
+  virtual PlusStatus ConstructLinearEquationForCalibration(std::vector<double>& aMatrix, std::vector<double>& bVector);
 
   /*! Add new column to the report table */
   PlusStatus AddNewColumnToReportTable(const char* columnName);
 
   /*! Update spacing calibration error report table */
   virtual PlusStatus UpdateReportTable(
-    const std::vector<vnl_vector<double> >& aMatrix,
+    const std::vector<double>& aMatrix,
     const std::vector<double>& bVector,
     const vnl_vector<double>& resultVector);
 
@@ -100,6 +108,9 @@ protected:
   /*! Calibration error standard deviation */
   double ErrorStdev;
 
+  /*! Number of threads used for solving the linear equations */
+  int NumberOfThreads;
+
   /*! When the results were computed. The result is recomputed only if the inputs changed more recently than UpdateTime. */
   vtkTimeStamp UpdateTime;
 
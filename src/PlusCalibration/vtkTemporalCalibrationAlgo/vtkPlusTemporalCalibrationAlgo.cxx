@@ -15,7 +15,10 @@
 #include "vtkTable.h"
 #include "vtkPlusTemporalCalibrationAlgo.h"
 #include "vtkIGSIOTrackedFrameList.h"
+#include <vnl/vnl_vector.h>
+#include <vnl/algo/vnl_fft_1d.h>
 #include <algorithm>
+#include <complex>
 #include <fstream>
 #include <iostream>
 
@@ -37,6 +40,12 @@ namespace
   const double MINIMUM_SAMPLING_RESOLUTION_SEC = 0.00001;
   const double DEFAULT_SAMPLING_RESOLUTION_SEC = 0.001;
   const double DEFAULT_MAX_MOVING_LAG_SEC = 0.5;
+  // The signals are resampled at this fraction of the image frame period for the FFT cross-correlation
+  const double FFT_STEPS_PER_FRAME_PERIOD = 4.0;
+  // Limits the memory used by the FFT cross-correlation for very long recordings
+  const int MAXIMUM_FFT_CROSS_CORRELATION_SIZE = 1 << 22;
+  // Number of lag steps in each direction in each step of the refinement of the lag
+  const double REFINEMENT_STEPS_PER_SEARCH_RANGE = 16.0;
 
   enum SignalAlignmentMetricType
   {
@@ -68,6 +77,7 @@ vtkPlusTemporalCalibrationAlgo::vtkPlusTemporalCalibrationAlgo()
   , SaveIntermediateImages(false)
   , IntermediateFilesOutputDirectory(vtkPlusConfig::GetInstance()->GetOutputDirectory())
   , SamplingResolutionSec(DEFAULT_SAMPLING_RESOLUTION_SEC)
+  , UseFftLagSearch(true)
   , BestCorrelationValue(0.0)
   , BestCorrelationLagIndex(-1)
   , BestCorrelationTimeOffset(0.0)
@@ -509,6 +519,174 @@ void vtkPlusTemporalCalibrationAlgo::ComputeCorrelationBetweenFixedAndMovingSign
   LOG_DEBUG("numberOfSamples=" << corrValues.size());
 }
 
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusTemporalCalibrationAlgo::ComputeCrossCorrelationUsingFft(double maxLagSec, double stepSizeSec, double& bestLagSec, double& bestLagInvertedSec, std::deque<double>& corrTimeOffsets, std::deque<double>& corrValues, std::deque<double>& corrValuesInverted)
+{
+  corrTimeOffsets.clear();
+  corrValues.clear();
+  corrValuesInverted.clear();
+  if (stepSizeSec < TIMESTAMP_EPSILON_SEC)
+  {
+    LOG_ERROR("Sampling resolution is too small: " << stepSizeSec << " sec");
+    return PLUS_FAIL;
+  }
+  if (this->MovingSignal.signalTimestamps.size() < 2 || this->FixedSignal.signalTimestamps.size() < 2)
+  {
+    LOG_ERROR("Cannot compute cross-correlation, not enough signal values");
+    return PLUS_FAIL;
+  }
+
+  // The moving signal is resampled in its time range, the fixed signal in the same range extended by the maximum lag on both sides
+  const double movingStartTime = this->MovingSignal.signalTimestamps.front();
+  const int maxLagSteps = static_cast<int>(floor(maxLagSec / stepSizeSec));
+  const int numberOfMovingSamples = static_cast<int>(floor((this->MovingSignal.signalTimestamps.back() - movingStartTime) / stepSizeSec)) + 1;
+  const int numberOfFixedSamples = numberOfMovingSamples + 2 * maxLagSteps;
+  if (numberOfMovingSamples < 2 || numberOfFixedSamples > MAXIMUM_FFT_CROSS_CORRELATION_SIZE)
+  {
+    LOG_ERROR("Cannot compute cross-correlation of " << numberOfFixedSamples << " samples");
+    return PLUS_FAIL;
+  }
+
+  vtkSmartPointer<vtkPiecewiseFunction> movingPiecewiseSignal = vtkSmartPointer<vtkPiecewiseFunction>::New();
+  for (unsigned int i = 0; i < this->MovingSignal.signalTimestamps.size(); ++i)
+  {
+    movingPiecewiseSignal->AddPoint(this->MovingSignal.signalTimestamps.at(i), this->MovingSignal.signalValues.at(i), 0.5, 0);
+  }
+  vtkSmartPointer<vtkPiecewiseFunction> fixedPiecewiseSignal = vtkSmartPointer<vtkPiecewiseFunction>::New();
+  for (unsigned int i = 0; i < this->FixedSignal.signalTimestamps.size(); ++i)
+  {
+    fixedPiecewiseSignal->AddPoint(this->FixedSignal.signalTimestamps.at(i), this->FixedSignal.signalValues.at(i), 0.5, 0);
+  }
+  std::deque<double> movingTimestamps(numberOfMovingSamples);
+  for (int i = 0; i < numberOfMovingSamples; ++i)
+  {
+    movingTimestamps[i] = movingStartTime + i * stepSizeSec;
+  }
+  std::deque<double> fixedTimestamps(numberOfFixedSamples);
+  for (int i = 0; i < numberOfFixedSamples; ++i)
+  {
+    fixedTimestamps[i] = movingStartTime + (i - maxLagSteps) * stepSizeSec;
+  }
+  std::deque<double> movingValues;
+  ResampleSignalLinearly(movingTimestamps, movingPiecewiseSignal, movingValues);
+  std::deque<double> fixedValues;
+  ResampleSignalLinearly(fixedTimestamps, fixedPiecewiseSignal, fixedValues);
+
+  // The moving signal overlaps the fixed signal in all its length at all lags, so it is normalized once
+  double movingMean = 0;
+  for (int i = 0; i < numberOfMovingSamples; ++i)
+  {
+    movingMean += movingValues[i];
+  }
+  movingMean /= numberOfMovingSamples;
+  double movingNorm = 0;
+  for (int i = 0; i < numberOfMovingSamples; ++i)
+  {
+    movingValues[i] -= movingMean;
+    movingNorm += movingValues[i] * movingValues[i];
+  }
+  movingNorm = std::sqrt(movingNorm);
+  if (movingNorm < 1e-10)
+  {
+    LOG_ERROR("Cannot compute cross-correlation, the moving signal is constant");
+    return PLUS_FAIL;
+  }
+
+  // Circular cross-correlation, the FFT size is at least the fixed signal size so the correlation at the used lags does not wrap around
+  unsigned int fftSize = 1;
+  while (fftSize < static_cast<unsigned int>(numberOfFixedSamples))
+  {
+    fftSize *= 2;
+  }
+  vnl_vector<std::complex<double>> fixedSpectrum(fftSize, std::complex<double>(0, 0));
+  vnl_vector<std::complex<double>> movingSpectrum(fftSize, std::complex<double>(0, 0));
+  for (int i = 0; i < numberOfFixedSamples; ++i)
+  {
+    fixedSpectrum[i] = fixedValues[i];
+  }
+  for (int i = 0; i < numberOfMovingSamples; ++i)
+  {
+    movingSpectrum[i] = movingValues[i];
+  }
+  vnl_fft_1d<double> fft(fftSize);
+  fft.fwd_transform(fixedSpectrum);
+  fft.fwd_transform(movingSpectrum);
+  for (unsigned int i = 0; i < fftSize; ++i)
+  {
+    fixedSpectrum[i] *= std::conj(movingSpectrum[i]);
+  }
+  fft.bwd_transform(fixedSpectrum);
+
+  // Sums of the fixed signal values for computing the mean and the deviation in the window that the moving signal overlaps
+  std::vector<double> fixedSums(numberOfFixedSamples + 1, 0);
+  std::vector<double> fixedSquareSums(numberOfFixedSamples + 1, 0);
+  for (int i = 0; i < numberOfFixedSamples; ++i)
+  {
+    fixedSums[i + 1] = fixedSums[i] + fixedValues[i];
+    fixedSquareSums[i + 1] = fixedSquareSums[i] + fixedValues[i] * fixedValues[i];
+  }
+
+  // SSD of normalized signals (with unit standard deviation) is -2*(n-1)*(1-correlation)
+  const double ssdScale = 2.0 * (this->FixedSignal.signalValues.size() - 1);
+  double bestCorrelation = 0;
+  double worstCorrelation = 0;
+  for (int lagStep = -maxLagSteps; lagStep <= maxLagSteps; ++lagStep)
+  {
+    // the moving signal at time t is compared to the fixed signal at time t-lag
+    const int fixedStartIndex = maxLagSteps - lagStep;
+    const double fixedSum = fixedSums[fixedStartIndex + numberOfMovingSamples] - fixedSums[fixedStartIndex];
+    const double fixedSquareSum = fixedSquareSums[fixedStartIndex + numberOfMovingSamples] - fixedSquareSums[fixedStartIndex];
+    const double fixedDeviation = std::sqrt(std::max(fixedSquareSum - fixedSum * fixedSum / numberOfMovingSamples, 0.0));
+    // the moving signal has zero mean, so the mean of the fixed signal does not change the cross-correlation
+    double correlation = 0;
+    if (fixedDeviation > 1e-10)
+    {
+      correlation = fixedSpectrum[fixedStartIndex].real() / fftSize / (movingNorm * fixedDeviation);
+    }
+
+    const double lagSec = lagStep * stepSizeSec;
+    corrTimeOffsets.push_back(lagSec);
+    corrValues.push_back(-ssdScale * (1.0 - correlation));
+    corrValuesInverted.push_back(-ssdScale * (1.0 + correlation));
+    if (lagStep == -maxLagSteps || correlation > bestCorrelation)
+    {
+      bestCorrelation = correlation;
+      bestLagSec = lagSec;
+    }
+    if (lagStep == -maxLagSteps || correlation < worstCorrelation)
+    {
+      worstCorrelation = correlation;
+      bestLagInvertedSec = lagSec;
+    }
+  }
+
+  LOG_DEBUG("FFT cross-correlation: best lag = " << bestLagSec << " sec (correlation=" << bestCorrelation << "), best lag with inverted moving signal = "
+            << bestLagInvertedSec << " sec (correlation=" << -worstCorrelation << "), numberOfSamples=" << corrValues.size());
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusTemporalCalibrationAlgo::RefineLagUsingAlignmentMetric(double initialLagSec, double searchRangeSec, double& bestCorrelationValue, double& bestCorrelationTimeOffset, double& bestCorrelationNormalizationFactor, std::deque<double>& corrTimeOffsets, std::deque<double>& corrValues)
+{
+  double stepSizeSec = std::max(searchRangeSec / REFINEMENT_STEPS_PER_SEARCH_RANGE, this->SamplingResolutionSec);
+  ComputeCorrelationBetweenFixedAndMovingSignal(initialLagSec - searchRangeSec, initialLagSec + searchRangeSec, stepSizeSec, bestCorrelationValue, bestCorrelationTimeOffset, bestCorrelationNormalizationFactor, corrTimeOffsets, corrValues);
+  while (stepSizeSec > this->SamplingResolutionSec && !corrValues.empty())
+  {
+    // search between the neighbors of the best lag of the previous step
+    searchRangeSec = stepSizeSec;
+    stepSizeSec = std::max(stepSizeSec / REFINEMENT_STEPS_PER_SEARCH_RANGE, this->SamplingResolutionSec);
+    double lagSec = bestCorrelationTimeOffset;
+    std::deque<double> refinedTimeOffsets;
+    std::deque<double> refinedValues;
+    ComputeCorrelationBetweenFixedAndMovingSignal(lagSec - searchRangeSec, lagSec + searchRangeSec, stepSizeSec, bestCorrelationValue, bestCorrelationTimeOffset, bestCorrelationNormalizationFactor, refinedTimeOffsets, refinedValues);
+    if (refinedValues.empty())
+    {
+      break;
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
 double vtkPlusTemporalCalibrationAlgo::ComputeAlignmentMetric(const std::deque<double>& signalA, const std::deque<double>& signalB)
 {
   if (signalA.size() != signalB.size())
@@ -699,17 +877,46 @@ PlusStatus vtkPlusTemporalCalibrationAlgo::ComputeMovingSignalLagSec(TEMPORAL_CA
 
   double searchRangeFineStep = imageFramePeriodSec * 3;
 
+  // Estimate the lag for both sign conventions at once by FFT cross-correlation, then only the neighborhood of the estimated lags
+  // has to be searched using the alignment metric
+  bool fftLagSearch = false;
+  double fftLagSec = 0;
+  double fftLagInvertedTrackerSec = 0;
+  std::deque<double> corrTimeOffsets;
+  std::deque<double> corrValues;
+  std::deque<double> corrTimeOffsetsInvertedTracker;
+  std::deque<double> corrValuesInvertedTracker;
+  if (this->UseFftLagSearch)
+  {
+    double fftStepSec = std::max(imageFramePeriodSec / FFT_STEPS_PER_FRAME_PERIOD, this->SamplingResolutionSec);
+    if (ComputeCrossCorrelationUsingFft(this->MaxMovingLagSec, fftStepSec, fftLagSec, fftLagInvertedTrackerSec, corrTimeOffsets, corrValues, corrValuesInvertedTracker) == PLUS_SUCCESS)
+    {
+      corrTimeOffsetsInvertedTracker = corrTimeOffsets;
+      searchRangeFineStep = imageFramePeriodSec;
+      fftLagSearch = true;
+    }
+    else
+    {
+      LOG_WARNING("Failed to estimate the lag by FFT cross-correlation, the alignment metric is computed at all lags instead");
+    }
+  }
+
   //  Compute cross correlation with sign convention #1
   LOG_DEBUG("ComputeCorrelationBetweenFixedAndMovingSignal(sign convention #1)");
   double bestCorrelationValue = 0;
   double bestCorrelationTimeOffset = 0;
   double bestCorrelationNormalizationFactor = 1.0;
-  std::deque<double> corrTimeOffsets;
-  std::deque<double> corrValues;
-  ComputeCorrelationBetweenFixedAndMovingSignal(-this->MaxMovingLagSec, this->MaxMovingLagSec, imageFramePeriodSec, bestCorrelationValue, bestCorrelationTimeOffset, bestCorrelationNormalizationFactor, corrTimeOffsets, corrValues);
   std::deque<double> corrTimeOffsetsFine;
   std::deque<double> corrValuesFine;
-  ComputeCorrelationBetweenFixedAndMovingSignal(bestCorrelationTimeOffset - searchRangeFineStep, bestCorrelationTimeOffset + searchRangeFineStep, this->SamplingResolutionSec, bestCorrelationValue, bestCorrelationTimeOffset, bestCorrelationNormalizationFactor, corrTimeOffsetsFine, corrValuesFine);
+  if (fftLagSearch)
+  {
+    RefineLagUsingAlignmentMetric(fftLagSec, searchRangeFineStep, bestCorrelationValue, bestCorrelationTimeOffset, bestCorrelationNormalizationFactor, corrTimeOffsetsFine, corrValuesFine);
+  }
+  else
+  {
+    ComputeCorrelationBetweenFixedAndMovingSignal(-this->MaxMovingLagSec, this->MaxMovingLagSec, imageFramePeriodSec, bestCorrelationValue, bestCorrelationTimeOffset, bestCorrelationNormalizationFactor, corrTimeOffsets, corrValues);
+    ComputeCorrelationBetweenFixedAndMovingSignal(bestCorrelationTimeOffset - searchRangeFineStep, bestCorrelationTimeOffset + searchRangeFineStep, this->SamplingResolutionSec, bestCorrelationValue, bestCorrelationTimeOffset, bestCorrelationNormalizationFactor, corrTimeOffsetsFine, corrValuesFine);
+  }
   LOG_DEBUG("Time offset with sign convention #1: " << bestCorrelationTimeOffset);
 
   //  Compute cross correlation with sign convention #2
@@ -722,29 +929,42 @@ PlusStatus vtkPlusTemporalCalibrationAlgo::ComputeMovingSignalLagSec(TEMPORAL_CA
   double bestCorrelationValueInvertedTracker(0);
   double bestCorrelationTimeOffsetInvertedTracker(0);
   double bestCorrelationNormalizationFactorInvertedTracker(1.0);
-  std::deque<double> corrTimeOffsetsInvertedTracker;
-  std::deque<double> corrValuesInvertedTracker;
-  ComputeCorrelationBetweenFixedAndMovingSignal(
-    -this->MaxMovingLagSec,
-    this->MaxMovingLagSec,
-    imageFramePeriodSec,
-    bestCorrelationValueInvertedTracker,
-    bestCorrelationTimeOffsetInvertedTracker,
-    bestCorrelationNormalizationFactorInvertedTracker,
-    corrTimeOffsetsInvertedTracker,
-    corrValuesInvertedTracker
-  );
   std::deque<double> corrTimeOffsetsInvertedTrackerFine;
   std::deque<double> corrValuesInvertedTrackerFine;
-  ComputeCorrelationBetweenFixedAndMovingSignal(
-    bestCorrelationTimeOffsetInvertedTracker - searchRangeFineStep,
-    bestCorrelationTimeOffsetInvertedTracker + searchRangeFineStep,
-    this->SamplingResolutionSec, bestCorrelationValueInvertedTracker,
-    bestCorrelationTimeOffsetInvertedTracker,
-    bestCorrelationNormalizationFactorInvertedTracker,
-    corrTimeOffsetsInvertedTrackerFine,
-    corrValuesInvertedTrackerFine
-  );
+  if (fftLagSearch)
+  {
+    RefineLagUsingAlignmentMetric(
+      fftLagInvertedTrackerSec,
+      searchRangeFineStep,
+      bestCorrelationValueInvertedTracker,
+      bestCorrelationTimeOffsetInvertedTracker,
+      bestCorrelationNormalizationFactorInvertedTracker,
+      corrTimeOffsetsInvertedTrackerFine,
+      corrValuesInvertedTrackerFine
+    );
+  }
+  else
+  {
+    ComputeCorrelationBetweenFixedAndMovingSignal(
+      -this->MaxMovingLagSec,
+      this->MaxMovingLagSec,
+      imageFramePeriodSec,
+      bestCorrelationValueInvertedTracker,
+      bestCorrelationTimeOffsetInvertedTracker,
+      bestCorrelationNormalizationFactorInvertedTracker,
+      corrTimeOffsetsInvertedTracker,
+      corrValuesInvertedTracker
+    );
+    ComputeCorrelationBetweenFixedAndMovingSignal(
+      bestCorrelationTimeOffsetInvertedTracker - searchRangeFineStep,
+      bestCorrelationTimeOffsetInvertedTracker + searchRangeFineStep,
+      this->SamplingResolutionSec, bestCorrelationValueInvertedTracker,
+      bestCorrelationTimeOffsetInvertedTracker,
+      bestCorrelationNormalizationFactorInvertedTracker,
+      corrTimeOffsetsInvertedTrackerFine,
+      corrValuesInvertedTrackerFine
+    );
+  }
   LOG_DEBUG("Time offset with sign convention #2: " << bestCorrelationTimeOffsetInvertedTracker);
 
   // Adopt the smallest tracker lag
@@ -893,6 +1113,7 @@ PlusStatus vtkPlusTemporalCalibrationAlgo::ReadConfiguration(vtkXMLDataElement*
     return PLUS_SUCCESS;
   }
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(SaveIntermediateImages, calibrationParameters);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(UseFftLagSearch, calibrationParameters);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, MaximumMovingLagSec, calibrationParameters);
 
   if (calibrationParameters != NULL)
@@ -108,6 +108,15 @@ public:
   /*! Enable/disable saving of intermediate images for debugging. Need to call before SetVideoFrames. */
   void SetSaveIntermediateImages(bool saveIntermediateImages);
 
+  /*!
+    Enable/disable the fast lag search. If enabled (default) then the lag is first estimated from the normalized cross-correlation
+    of the uniformly resampled signals, computed by FFT for all lags in the maximum lag range, and then the alignment metric is only
+    computed around the estimated lag, with gradually decreasing step size. If disabled then the alignment metric is computed
+    at each image frame period in the maximum lag range, then with SamplingResolutionSec step around the best lag.
+  */
+  void SetUseFftLagSearch(bool useFftLagSearch) { this->UseFftLagSearch = useFftLagSearch; }
+  bool GetUseFftLagSearch() const { return this->UseFftLagSearch; }
+
   void SetIntermediateFilesOutputDirectory(const std::string& outputDirectory);
 
   void SetVideoClipRectangle(int* clipRectOriginIntVec, int* clipRectSizeIntVec);
@@ -151,6 +160,20 @@ protected:
   PlusStatus NormalizeMetricValues(std::deque<double>& signal, double& normalizationFactor, double startTime, double stopTime, const std::deque<double>& timestamps);
   void ComputeCorrelationBetweenFixedAndMovingSignal(double minTrackerLagSec, double maxTrackerLagSec, double stepSizeSec, double& bestCorrelationValue, double& bestCorrelationTimeOffset, double& bestCorrelationNormalizationFactor, std::deque<double>& corrTimeOffsets, std::deque<double>& corrValues);
 
+  /*!
+    Compute the normalized cross-correlation of the fixed and moving signals for all lags in [-maxLagSec, maxLagSec] with stepSizeSec resolution,
+    using FFT. Returns the lag with the highest correlation and the lag with the lowest correlation (the highest correlation with the inverted moving signal).
+    The correlation values are converted to the scale of the SSD alignment metric of normalized signals, for both signs of the moving signal.
+  */
+  PlusStatus ComputeCrossCorrelationUsingFft(double maxLagSec, double stepSizeSec, double& bestLagSec, double& bestLagInvertedSec, std::deque<double>& corrTimeOffsets, std::deque<double>& corrValues, std::deque<double>& corrValuesInverted);
+
+  /*!
+    Find the lag with the best alignment metric within searchRangeSec around initialLagSec, with SamplingResolutionSec resolution.
+    The metric is computed in the whole range with a coarse step first, then around the best lag with gradually decreasing steps,
+    so the number of metric computations hardly depends on the resolution. corrTimeOffsets and corrValues are the values of the first step.
+  */
+  void RefineLagUsingAlignmentMetric(double initialLagSec, double searchRangeSec, double& bestCorrelationValue, double& bestCorrelationTimeOffset, double& bestCorrelationNormalizationFactor, std::deque<double>& corrTimeOffsets, std::deque<double>& corrValues);
+
   double ComputeAlignmentMetric(const std::deque<double>& signalA, const std::deque<double>& signalB);
 
   PlusStatus ConstructTableSignal(std::deque<double>& x, std::deque<double>& y, vtkTable* table, double timeCorrection);
@@ -174,6 +197,9 @@ protected:
   /*! Resolution used for re-sampling [s]*/
   double SamplingResolutionSec;
 
+  /*! If true then the lag is estimated by FFT cross-correlation before refining it with the alignment metric */
+  bool UseFftLagSearch;
+
   /*! The computed signal correlation values (corresponding to the better sign convention) */
   std::deque<double> CorrelationValues;
   /*! The time-offsets used to compute the correlations */
@@ -0,0 +1,1128 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PixelCodec.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+  #define PIXELCODEC_X86
+  #include <immintrin.h>
+  #if defined(_MSC_VER)
+    #include <intrin.h>
+    // MSVC allows using intrinsics of any instruction set without compiler flags
+    #define PIXELCODEC_TARGET_SSE41
+    #define PIXELCODEC_TARGET_AVX2
+  #else
+    // Only the functions that are selected by runtime CPU detection are compiled with the extended instruction sets
+    #define PIXELCODEC_TARGET_SSE41 __attribute__((target("sse4.1")))
+    #define PIXELCODEC_TARGET_AVX2 __attribute__((target("avx2")))
+  #endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+  // NEON is always available on 64-bit ARM
+  #define PIXELCODEC_NEON
+  #include <arm_neon.h>
+#endif
+
+namespace
+{
+  // Division by 3 of a 16-bit sum of three 8-bit values: (x * 21846) >> 16 == x / 3 for all x in [0, 765]
+  const unsigned short DIVIDE_BY_3_MULTIPLIER = 21846;
+
+  // Fixed-point coefficients of the YUY2 conversion, same as in the GET_*_FROM_YUV macros
+  const int YUV_Y_COEFF = FIX(1.0, FIXNUM);
+  const int YUV_RV_COEFF = FIX(1.402, FIXNUM);
+  const int YUV_GU_COEFF = FIX(-0.344, FIXNUM);
+  const int YUV_GV_COEFF = FIX(-0.714, FIXNUM);
+  const int YUV_BU_COEFF = FIX(1.772, FIXNUM);
+  const int YUV_ROUNDING = 1 << (FIXNUM - 1);
+
+  //----------------------------------------------------------------------------
+  PixelCodec::SimdInstructionSet DetectSimdInstructionSet()
+  {
+#if defined(PIXELCODEC_X86)
+  #if defined(_MSC_VER)
+    int cpuInfo[4] = { 0 };
+    __cpuid(cpuInfo, 0);
+    int maxFunctionId = cpuInfo[0];
+    if (maxFunctionId < 1)
+    {
+      return PixelCodec::SimdInstructionSet_None;
+    }
+    __cpuid(cpuInfo, 1);
+    bool sse41 = (cpuInfo[2] & (1 << 19)) != 0;
+    bool osXsave = (cpuInfo[2] & (1 << 27)) != 0;
+    bool avx = (cpuInfo[2] & (1 << 28)) != 0;
+    bool avx2 = false;
+    if (maxFunctionId >= 7 && osXsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+    {
+      __cpuidex(cpuInfo, 7, 0);
+      avx2 = (cpuInfo[1] & (1 << 5)) != 0;
+    }
+  #else
+    __builtin_cpu_init();
+    bool sse41 = __builtin_cpu_supports("sse4.1") != 0;
+    bool avx2 = __builtin_cpu_supports("avx2") != 0;
+  #endif
+    if (avx2)
+    {
+      return PixelCodec::SimdInstructionSet_AVX2;
+    }
+    if (sse41)
+    {
+      return PixelCodec::SimdInstructionSet_SSE41;
+    }
+    return PixelCodec::SimdInstructionSet_None;
+#elif defined(PIXELCODEC_NEON)
+    return PixelCodec::SimdInstructionSet_NEON;
+#else
+    return PixelCodec::SimdInstructionSet_None;
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  std::atomic<int>& ActiveSimdInstructionSet()
+  {
+    static std::atomic<int> instructionSet(PixelCodec::GetSupportedSimdInstructionSet());
+    return instructionSet;
+  }
+
+#if defined(PIXELCODEC_X86)
+
+  //----------------------------------------------------------------------------
+  // Compute (r+g+b)/3 for 16 pixels, from 16-bit sums
+  PIXELCODEC_TARGET_SSE41 inline __m128i DivideBy3Sse41(__m128i sumLo, __m128i sumHi)
+  {
+    const __m128i multiplier = _mm_set1_epi16(DIVIDE_BY_3_MULTIPLIER);
+    return _mm_packus_epi16(_mm_mulhi_epu16(sumLo, multiplier), _mm_mulhi_epu16(sumHi, multiplier));
+  }
+
+  //----------------------------------------------------------------------------
+  PIXELCODEC_TARGET_SSE41 int Rgb24ToGraySse41(int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    // Shuffle masks that collect the R, G, B components of 16 pixels from three 16-byte blocks
+    const __m128i r0 = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i r1 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1);
+    const __m128i r2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13);
+    const __m128i g0 = _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i g1 = _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1);
+    const __m128i g2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14);
+    const __m128i b0 = _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i b1 = _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1);
+    const __m128i b2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15);
+    const __m128i zero = _mm_setzero_si128();
+
+    int i = 0;
+    for (; i + 16 <= numberOfPixels; i += 16)
+    {
+      __m128i in0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i * 3));
+      __m128i in1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i * 3 + 16));
+      __m128i in2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i * 3 + 32));
+      __m128i r = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(in0, r0), _mm_shuffle_epi8(in1, r1)), _mm_shuffle_epi8(in2, r2));
+      __m128i g = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(in0, g0), _mm_shuffle_epi8(in1, g1)), _mm_shuffle_epi8(in2, g2));
+      __m128i b = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(in0, b0), _mm_shuffle_epi8(in1, b1)), _mm_shuffle_epi8(in2, b2));
+      __m128i sumLo = _mm_add_epi16(_mm_add_epi16(_mm_cvtepu8_epi16(r), _mm_cvtepu8_epi16(g)), _mm_cvtepu8_epi16(b));
+      __m128i sumHi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(r, zero), _mm_unpackhi_epi8(g, zero)), _mm_unpackhi_epi8(b, zero));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(d + i), DivideBy3Sse41(sumLo, sumHi));
+    }
+    return i;
+  }
+
+  //----------------------------------------------------------------------------
+  PIXELCODEC_TARGET_SSE41 int Rgba32ToGraySse41(int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    // R+G and B+0 for each pixel, then a horizontal add gives R+G+B
+    const __m128i weights = _mm_setr_epi8(1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0);
+
+    int i = 0;
+    for (; i + 16 <= numberOfPixels; i += 16)
+    {
+      const __m128i* in = reinterpret_cast<const __m128i*>(s + i * 4);
+      __m128i m0 = _mm_maddubs_epi16(_mm_loadu_si128(in), weights);
+      __m128i m1 = _mm_maddubs_epi16(_mm_loadu_si128(in + 1), weights);
+      __m128i m2 = _mm_maddubs_epi16(_mm_loadu_si128(in + 2), weights);
+      __m128i m3 = _mm_maddubs_epi16(_mm_loadu_si128(in + 3), weights);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(d + i), DivideBy3Sse41(_mm_hadd_epi16(m0, m1), _mm_hadd_epi16(m2, m3)));
+    }
+    return i;
+  }
+
+  //----------------------------------------------------------------------------
+  PIXELCODEC_TARGET_AVX2 int Rgba32ToGrayAvx2(int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    const __m256i weights = _mm256_setr_epi8(1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0);
+    const __m256i multiplier = _mm256_set1_epi16(DIVIDE_BY_3_MULTIPLIER);
+    // hadd and packus work within 128-bit lanes, this restores the pixel order (4-pixel groups)
+    const __m256i pixelOrder = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    int i = 0;
+    for (; i + 32 <= numberOfPixels; i += 32)
+    {
+      const __m256i* in = reinterpret_cast<const __m256i*>(s + i * 4);
+      __m256i m0 = _mm256_maddubs_epi16(_mm256_loadu_si256(in), weights);
+      __m256i m1 = _mm256_maddubs_epi16(_mm256_loadu_si256(in + 1), weights);
+      __m256i m2 = _mm256_maddubs_epi16(_mm256_loadu_si256(in + 2), weights);
+      __m256i m3 = _mm256_maddubs_epi16(_mm256_loadu_si256(in + 3), weights);
+      __m256i gray01 = _mm256_mulhi_epu16(_mm256_hadd_epi16(m0, m1), multiplier);
+      __m256i gray23 = _mm256_mulhi_epu16(_mm256_hadd_epi16(m2, m3), multiplier);
+      __m256i gray = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(gray01, gray23), pixelOrder);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(d + i), gray);
+    }
+    return i;
+  }
+
+  //----------------------------------------------------------------------------
+  // Y, U, V components of 8 YUY2 pixels (16 bytes), U and V duplicated for each pixel of a pair
+  PIXELCODEC_TARGET_SSE41 inline void SplitYuy2Sse41(const unsigned char* s, __m128i& y, __m128i& u, __m128i& v)
+  {
+    __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+    y = _mm_shuffle_epi8(in, _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, -1, -1, -1, -1, -1, -1, -1, -1));
+    u = _mm_shuffle_epi8(in, _mm_setr_epi8(1, 1, 5, 5, 9, 9, 13, 13, -1, -1, -1, -1, -1, -1, -1, -1));
+    v = _mm_shuffle_epi8(in, _mm_setr_epi8(3, 3, 7, 7, 11, 11, 15, 15, -1, -1, -1, -1, -1, -1, -1, -1));
+  }
+
+  //----------------------------------------------------------------------------
+  // Integer division of the scaled value by a constant, rounded towards zero (same as ICCIRY and ICCIRUV).
+  // The float quotient is exact enough: the fractional part of a non-integer quotient is at least 1/224,
+  // much larger than the float rounding error, so truncation gives the same result as integer division.
+  PIXELCODEC_TARGET_SSE41 inline __m128i ScaleYuvComponentSse41(__m128i component32, int offset, float divisor)
+  {
+    __m128i scaled = _mm_slli_epi32(_mm_sub_epi32(component32, _mm_set1_epi32(offset)), 8);
+    return _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(scaled), _mm_set1_ps(divisor)));
+  }
+
+  //----------------------------------------------------------------------------
+  // Convert 4 pixels from scaled Y, U, V to unclipped R, G, B (same as GET_*_FROM_YUV)
+  PIXELCODEC_TARGET_SSE41 inline void YuvToRgbSse41(__m128i y, __m128i u, __m128i v, __m128i& r, __m128i& g, __m128i& b)
+  {
+    __m128i yTerm = _mm_add_epi32(_mm_mullo_epi32(y, _mm_set1_epi32(YUV_Y_COEFF)), _mm_set1_epi32(YUV_ROUNDING));
+    r = _mm_srai_epi32(_mm_add_epi32(yTerm, _mm_mullo_epi32(v, _mm_set1_epi32(YUV_RV_COEFF))), FIXNUM);
+    g = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(yTerm, _mm_mullo_epi32(u, _mm_set1_epi32(YUV_GU_COEFF))), _mm_mullo_epi32(v, _mm_set1_epi32(YUV_GV_COEFF))), FIXNUM);
+    b = _mm_srai_epi32(_mm_add_epi32(yTerm, _mm_mullo_epi32(u, _mm_set1_epi32(YUV_BU_COEFF))), FIXNUM);
+  }
+
+  //----------------------------------------------------------------------------
+  // Clip two groups of 4 components to [0, 255] (same as CLIP) and store them in the lower 8 bytes
+  PIXELCODEC_TARGET_SSE41 inline __m128i ClipToUnsignedCharSse41(__m128i lo, __m128i hi)
+  {
+    return _mm_packus_epi16(_mm_packs_epi32(lo, hi), _mm_setzero_si128());
+  }
+
+  //----------------------------------------------------------------------------
+  // Write 8 pixels as 24 interleaved bytes. c0, c1, c2 contain the first, second, third components in the lower 8 bytes.
+  PIXELCODEC_TARGET_SSE41 inline void StoreInterleaved8Sse41(__m128i c0, __m128i c1, __m128i c2, unsigned char* d)
+  {
+    __m128i c01 = _mm_unpacklo_epi8(c0, c1);
+    __m128i out0 = _mm_or_si128(_mm_shuffle_epi8(c01, _mm_setr_epi8(0, 1, -1, 2, 3, -1, 4, 5, -1, 6, 7, -1, 8, 9, -1, 10)),
+                                _mm_shuffle_epi8(c2, _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1)));
+    __m128i out1 = _mm_or_si128(_mm_shuffle_epi8(c01, _mm_setr_epi8(11, -1, 12, 13, -1, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+                                _mm_shuffle_epi8(c2, _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, -1, -1, -1, -1, -1, -1)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(d), out0);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(d + 16), out1);
+  }
+
+  //----------------------------------------------------------------------------
+  // Convert 8 YUY2 pixels to clipped R, G, B components (lower 8 bytes of r, g, b)
+  PIXELCODEC_TARGET_SSE41 inline void Yuy2ToRgb8Sse41(const unsigned char* s, __m128i& r, __m128i& g, __m128i& b)
+  {
+    __m128i y8, u8, v8;
+    SplitYuy2Sse41(s, y8, u8, v8);
+    __m128i rgb[2][3];
+    for (int half = 0; half < 2; ++half)
+    {
+      __m128i y = ScaleYuvComponentSse41(_mm_cvtepu8_epi32(y8), 16, 219.0f);
+      __m128i u = ScaleYuvComponentSse41(_mm_cvtepu8_epi32(u8), 128, 224.0f);
+      __m128i v = ScaleYuvComponentSse41(_mm_cvtepu8_epi32(v8), 128, 224.0f);
+      YuvToRgbSse41(y, u, v, rgb[half][0], rgb[half][1], rgb[half][2]);
+      y8 = _mm_srli_si128(y8, 4);
+      u8 = _mm_srli_si128(u8, 4);
+      v8 = _mm_srli_si128(v8, 4);
+    }
+    r = ClipToUnsignedCharSse41(rgb[0][0], rgb[1][0]);
+    g = ClipToUnsignedCharSse41(rgb[0][1], rgb[1][1]);
+    b = ClipToUnsignedCharSse41(rgb[0][2], rgb[1][2]);
+  }
+
+  //----------------------------------------------------------------------------
+  // Returns the number of processed macropixels (pixel pairs)
+  PIXELCODEC_TARGET_SSE41 int Yuv422pToBmp24Sse41(PixelCodec::ComponentOrdering outputOrdering, int numberOfMacropixels, const unsigned char* s, unsigned char* d)
+  {
+    int i = 0;
+    for (; i + 4 <= numberOfMacropixels; i += 4)
+    {
+      __m128i r, g, b;
+      Yuy2ToRgb8Sse41(s + i * 4, r, g, b);
+      if (outputOrdering == PixelCodec::ComponentOrder_BGR)
+      {
+        StoreInterleaved8Sse41(b, g, r, d + i * 6);
+      }
+      else
+      {
+        StoreInterleaved8Sse41(r, g, b, d + i * 6);
+      }
+    }
+    return i;
+  }
+
+  //----------------------------------------------------------------------------
+  PIXELCODEC_TARGET_SSE41 int Yuv422pToGraySse41(int numberOfMacropixels, const unsigned char* s, unsigned char* d)
+  {
+    const __m128i multiplier = _mm_set1_epi16(DIVIDE_BY_3_MULTIPLIER);
+    int i = 0;
+    for (; i + 4 <= numberOfMacropixels; i += 4)
+    {
+      __m128i r, g, b;
+      Yuy2ToRgb8Sse41(s + i * 4, r, g, b);
+      __m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_cvtepu8_epi16(r), _mm_cvtepu8_epi16(g)), _mm_cvtepu8_epi16(b));
+      __m128i gray = _mm_packus_epi16(_mm_mulhi_epu16(sum, multiplier), _mm_setzero_si128());
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(d + i * 2), gray);
+    }
+    return i;
+  }
+
+  //----------------------------------------------------------------------------
+  PIXELCODEC_TARGET_AVX2 inline __m256i ScaleYuvComponentAvx2(__m128i component8, int offset, float divisor)
+  {
+    __m256i scaled = _mm256_slli_epi32(_mm256_sub_epi32(_mm256_cvtepu8_epi32(component8), _mm256_set1_epi32(offset)), 8);
+    return _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(scaled), _mm256_set1_ps(divisor)));
+  }
+
+  //----------------------------------------------------------------------------
+  // Clip 8 components to [0, 255] and store them in the lower 8 bytes
+  PIXELCODEC_TARGET_AVX2 inline __m128i ClipToUnsignedCharAvx2(__m256i c)
+  {
+    return _mm_packus_epi16(_mm_packs_epi32(_mm256_castsi256_si128(c), _mm256_extracti128_si256(c, 1)), _mm_setzero_si128());
+  }
+
+  //----------------------------------------------------------------------------
+  // Convert 8 YUY2 pixels to clipped R, G, B components (lower 8 bytes of r, g, b), computing all 8 pixels at once
+  PIXELCODEC_TARGET_AVX2 inline void Yuy2ToRgb8Avx2(const unsigned char* s, __m128i& r, __m128i& g, __m128i& b)
+  {
+    __m128i y8, u8, v8;
+    SplitYuy2Sse41(s, y8, u8, v8);
+    __m256i y = ScaleYuvComponentAvx2(y8, 16, 219.0f);
+    __m256i u = ScaleYuvComponentAvx2(u8, 128, 224.0f);
+    __m256i v = ScaleYuvComponentAvx2(v8, 128, 224.0f);
+    __m256i yTerm = _mm256_add_epi32(_mm256_mullo_epi32(y, _mm256_set1_epi32(YUV_Y_COEFF)), _mm256_set1_epi32(YUV_ROUNDING));
+    __m256i r32 = _mm256_srai_epi32(_mm256_add_epi32(yTerm, _mm256_mullo_epi32(v, _mm256_set1_epi32(YUV_RV_COEFF))), FIXNUM);
+    __m256i g32 = _mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(yTerm, _mm256_mullo_epi32(u, _mm256_set1_epi32(YUV_GU_COEFF))), _mm256_mullo_epi32(v, _mm256_set1_epi32(YUV_GV_COEFF))), FIXNUM);
+    __m256i b32 = _mm256_srai_epi32(_mm256_add_epi32(yTerm, _mm256_mullo_epi32(u, _mm256_set1_epi32(YUV_BU_COEFF))), FIXNUM);
+    r = ClipToUnsignedCharAvx2(r32);
+    g = ClipToUnsignedCharAvx2(g32);
+    b = ClipToUnsignedCharAvx2(b32);
+  }
+
+  //----------------------------------------------------------------------------
+  PIXELCODEC_TARGET_AVX2 int Yuv422pToBmp24Avx2(PixelCodec::ComponentOrdering outputOrdering, int numberOfMacropixels, const unsigned char* s, unsigned char* d)
+  {
+    int i = 0;
+    for (; i + 4 <= numberOfMacropixels; i += 4)
+    {
+      __m128i r, g, b;
+      Yuy2ToRgb8Avx2(s + i * 4, r, g, b);
+      if (outputOrdering == PixelCodec::ComponentOrder_BGR)
+      {
+        StoreInterleaved8Sse41(b, g, r, d + i * 6);
+      }
+      else
+      {
+        StoreInterleaved8Sse41(r, g, b, d + i * 6);
+      }
+    }
+    return i;
+  }
+
+  //----------------------------------------------------------------------------
+  PIXELCODEC_TARGET_AVX2 int Yuv422pToGrayAvx2(int numberOfMacropixels, const unsigned char* s, unsigned char* d)
+  {
+    const __m128i multiplier = _mm_set1_epi16(DIVIDE_BY_3_MULTIPLIER);
+    int i = 0;
+    for (; i + 4 <= numberOfMacropixels; i += 4)
+    {
+      __m128i r, g, b;
+      Yuy2ToRgb8Avx2(s + i * 4, r, g, b);
+      __m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_cvtepu8_epi16(r), _mm_cvtepu8_epi16(g)), _mm_cvtepu8_epi16(b));
+      __m128i gray = _mm_packus_epi16(_mm_mulhi_epu16(sum, multiplier), _mm_setzero_si128());
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(d + i * 2), gray);
+    }
+    return i;
+  }
+
+#elif defined(PIXELCODEC_NEON)
+
+  //----------------------------------------------------------------------------
+  // Compute (c0+c1+c2)/3 for 8 pixels
+  inline uint8x8_t AverageOf3Neon(uint8x8_t c0, uint8x8_t c1, uint8x8_t c2)
+  {
+    uint16x8_t sum = vaddw_u8(vaddl_u8(c0, c1), c2);
+    const uint16x4_t multiplier = vdup_n_u16(DIVIDE_BY_3_MULTIPLIER);
+    uint16x4_t lo = vshrn_n_u32(vmull_u16(vget_low_u16(sum), multiplier), 16);
+    uint16x4_t hi = vshrn_n_u32(vmull_u16(vget_high_u16(sum), multiplier), 16);
+    return vmovn_u16(vcombine_u16(lo, hi));
+  }
+
+  //----------------------------------------------------------------------------
+  int Rgb24ToGrayNeon(int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    int i = 0;
+    for (; i + 16 <= numberOfPixels; i += 16)
+    {
+      uint8x16x3_t rgb = vld3q_u8(s + i * 3);
+      uint8x8_t lo = AverageOf3Neon(vget_low_u8(rgb.val[0]), vget_low_u8(rgb.val[1]), vget_low_u8(rgb.val[2]));
+      uint8x8_t hi = AverageOf3Neon(vget_high_u8(rgb.val[0]), vget_high_u8(rgb.val[1]), vget_high_u8(rgb.val[2]));
+      vst1q_u8(d + i, vcombine_u8(lo, hi));
+    }
+    return i;
+  }
+
+  //----------------------------------------------------------------------------
+  int Rgba32ToGrayNeon(int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    int i = 0;
+    for (; i + 16 <= numberOfPixels; i += 16)
+    {
+      uint8x16x4_t rgba = vld4q_u8(s + i * 4);
+      uint8x8_t lo = AverageOf3Neon(vget_low_u8(rgba.val[0]), vget_low_u8(rgba.val[1]), vget_low_u8(rgba.val[2]));
+      uint8x8_t hi = AverageOf3Neon(vget_high_u8(rgba.val[0]), vget_high_u8(rgba.val[1]), vget_high_u8(rgba.val[2]));
+      vst1q_u8(d + i, vcombine_u8(lo, hi));
+    }
+    return i;
+  }
+
+  //----------------------------------------------------------------------------
+  // Integer division of the scaled value, rounded towards zero (see ScaleYuvComponentSse41)
+  inline int32x4_t ScaleYuvComponentNeon(uint16x4_t component, int offset, float divisor)
+  {
+    int32x4_t scaled = vshlq_n_s32(vsubq_s32(vreinterpretq_s32_u32(vmovl_u16(component)), vdupq_n_s32(offset)), 8);
+    return vcvtq_s32_f32(vdivq_f32(vcvtq_f32_s32(scaled), vdupq_n_f32(divisor)));
+  }
+
+  //----------------------------------------------------------------------------
+  // Convert 8 pixels from Y, U, V to clipped R, G, B
+  inline void YuvToRgb8Neon(uint8x8_t y8, uint8x8_t u8, uint8x8_t v8, uint8x8_t& r, uint8x8_t& g, uint8x8_t& b)
+  {
+    uint16x8_t y16 = vmovl_u8(y8);
+    uint16x8_t u16 = vmovl_u8(u8);
+    uint16x8_t v16 = vmovl_u8(v8);
+    int32x4_t rgb[2][3];
+    for (int half = 0; half < 2; ++half)
+    {
+      int32x4_t y = ScaleYuvComponentNeon(half == 0 ? vget_low_u16(y16) : vget_high_u16(y16), 16, 219.0f);
+      int32x4_t u = ScaleYuvComponentNeon(half == 0 ? vget_low_u16(u16) : vget_high_u16(u16), 128, 224.0f);
+      int32x4_t v = ScaleYuvComponentNeon(half == 0 ? vget_low_u16(v16) : vget_high_u16(v16), 128, 224.0f);
+      int32x4_t yTerm = vmlaq_n_s32(vdupq_n_s32(YUV_ROUNDING), y, YUV_Y_COEFF);
+      rgb[half][0] = vshrq_n_s32(vmlaq_n_s32(yTerm, v, YUV_RV_COEFF), FIXNUM);
+      rgb[half][1] = vshrq_n_s32(vmlaq_n_s32(vmlaq_n_s32(yTerm, u, YUV_GU_COEFF), v, YUV_GV_COEFF), FIXNUM);
+      rgb[half][2] = vshrq_n_s32(vmlaq_n_s32(yTerm, u, YUV_BU_COEFF), FIXNUM);
+    }
+    r = vqmovun_s16(vcombine_s16(vqmovn_s32(rgb[0][0]), vqmovn_s32(rgb[1][0])));
+    g = vqmovun_s16(vcombine_s16(vqmovn_s32(rgb[0][1]), vqmovn_s32(rgb[1][1])));
+    b = vqmovun_s16(vcombine_s16(vqmovn_s32(rgb[0][2]), vqmovn_s32(rgb[1][2])));
+  }
+
+  //----------------------------------------------------------------------------
+  // Convert 8 macropixels (16 pixels) to R, G, B components in pixel order
+  inline void Yuy2ToRgb16Neon(const unsigned char* s, uint8x16_t& r, uint8x16_t& g, uint8x16_t& b)
+  {
+    // val[0]: Y of even pixels, val[1]: U, val[2]: Y of odd pixels, val[3]: V
+    uint8x8x4_t yuyv = vld4_u8(s);
+    uint8x8_t rEven, gEven, bEven, rOdd, gOdd, bOdd;
+    YuvToRgb8Neon(yuyv.val[0], yuyv.val[1], yuyv.val[3], rEven, gEven, bEven);
+    YuvToRgb8Neon(yuyv.val[2], yuyv.val[1], yuyv.val[3], rOdd, gOdd, bOdd);
+    uint8x8x2_t rZip = vzip_u8(rEven, rOdd);
+    uint8x8x2_t gZip = vzip_u8(gEven, gOdd);
+    uint8x8x2_t bZip = vzip_u8(bEven, bOdd);
+    r = vcombine_u8(rZip.val[0], rZip.val[1]);
+    g = vcombine_u8(gZip.val[0], gZip.val[1]);
+    b = vcombine_u8(bZip.val[0], bZip.val[1]);
+  }
+
+  //----------------------------------------------------------------------------
+  int Yuv422pToBmp24Neon(PixelCodec::ComponentOrdering outputOrdering, int numberOfMacropixels, const unsigned char* s, unsigned char* d)
+  {
+    int i = 0;
+    for (; i + 8 <= numberOfMacropixels; i += 8)
+    {
+      uint8x16_t r, g, b;
+      Yuy2ToRgb16Neon(s + i * 4, r, g, b);
+      uint8x16x3_t out;
+      out.val[0] = (outputOrdering == PixelCodec::ComponentOrder_BGR ? b : r);
+      out.val[1] = g;
+      out.val[2] = (outputOrdering == PixelCodec::ComponentOrder_BGR ? r : b);
+      vst3q_u8(d + i * 6, out);
+    }
+    return i;
+  }
+
+  //----------------------------------------------------------------------------
+  int Yuv422pToGrayNeon(int numberOfMacropixels, const unsigned char* s, unsigned char* d)
+  {
+    int i = 0;
+    for (; i + 8 <= numberOfMacropixels; i += 8)
+    {
+      uint8x16_t r, g, b;
+      Yuy2ToRgb16Neon(s + i * 4, r, g, b);
+      uint8x8_t lo = AverageOf3Neon(vget_low_u8(r), vget_low_u8(g), vget_low_u8(b));
+      uint8x8_t hi = AverageOf3Neon(vget_high_u8(r), vget_high_u8(g), vget_high_u8(b));
+      vst1q_u8(d + i * 2, vcombine_u8(lo, hi));
+    }
+    return i;
+  }
+
+#endif
+
+  // Output images of at least this size are written with streaming stores, smaller images may stay in the cache
+  const size_t STREAMING_STORE_MINIMUM_IMAGE_SIZE_BYTES = 4 * 1024 * 1024;
+
+  //----------------------------------------------------------------------------
+  // Copy pixels [firstPixel, numberOfPixels) of the reversed row: d[i] = s[numberOfPixels - 1 - i]
+  template<int BytesPerPixel>
+  inline void ReverseRowScalar(int firstPixel, int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    for (int i = firstPixel; i < numberOfPixels; ++i)
+    {
+      memcpy(d + i * BytesPerPixel, s + (numberOfPixels - 1 - i) * BytesPerPixel, BytesPerPixel);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  inline void ReverseRowScalar(int bytesPerPixel, int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    for (int i = 0; i < numberOfPixels; ++i)
+    {
+      memcpy(d + i * bytesPerPixel, s + (numberOfPixels - 1 - i) * bytesPerPixel, bytesPerPixel);
+    }
+  }
+
+#if defined(PIXELCODEC_X86)
+
+  //----------------------------------------------------------------------------
+  // Reverse the row in 16-byte blocks, returns the number of processed pixels. Streaming requires 16-byte aligned d.
+  template<int BytesPerPixel, bool Streaming>
+  PIXELCODEC_TARGET_SSE41 int ReverseRowSse41(int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    const int pixelsPerBlock = 16 / BytesPerPixel;
+    const __m128i reverseBytes = (BytesPerPixel == 1
+                                  ? _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+                                  : _mm_setr_epi8(14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1));
+    int i = 0;
+    for (; i + pixelsPerBlock <= numberOfPixels; i += pixelsPerBlock)
+    {
+      __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + (numberOfPixels - i - pixelsPerBlock) * BytesPerPixel));
+      if (BytesPerPixel == 8)
+      {
+        block = _mm_shuffle_epi32(block, _MM_SHUFFLE(1, 0, 3, 2));
+      }
+      else if (BytesPerPixel == 4)
+      {
+        block = _mm_shuffle_epi32(block, _MM_SHUFFLE(0, 1, 2, 3));
+      }
+      else
+      {
+        block = _mm_shuffle_epi8(block, reverseBytes);
+      }
+      if (Streaming)
+      {
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d + i * BytesPerPixel), block);
+      }
+      else
+      {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + i * BytesPerPixel), block);
+      }
+    }
+    return i;
+  }
+
+#elif defined(PIXELCODEC_NEON)
+
+  //----------------------------------------------------------------------------
+  // Reverse the row in 16-byte blocks, returns the number of processed pixels
+  template<int BytesPerPixel>
+  int ReverseRowNeon(int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    const int pixelsPerBlock = 16 / BytesPerPixel;
+    int i = 0;
+    for (; i + pixelsPerBlock <= numberOfPixels; i += pixelsPerBlock)
+    {
+      uint8x16_t block = vld1q_u8(s + (numberOfPixels - i - pixelsPerBlock) * BytesPerPixel);
+      // reverse the pixels in each 8-byte half, then swap the halves
+      if (BytesPerPixel == 1)
+      {
+        block = vrev64q_u8(block);
+      }
+      else if (BytesPerPixel == 2)
+      {
+        block = vreinterpretq_u8_u16(vrev64q_u16(vreinterpretq_u16_u8(block)));
+      }
+      else if (BytesPerPixel == 4)
+      {
+        block = vreinterpretq_u8_u32(vrev64q_u32(vreinterpretq_u32_u8(block)));
+      }
+      vst1q_u8(d + i * BytesPerPixel, vextq_u8(block, block, 8));
+    }
+    return i;
+  }
+
+#endif
+
+  //----------------------------------------------------------------------------
+  // Reverse a row of 1, 2, 4, or 8 byte pixels, using SIMD instructions if available
+  template<int BytesPerPixel>
+  void ReverseRow(PixelCodec::SimdInstructionSet instructionSet, bool streaming, int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    int processedPixels = 0;
+    switch (instructionSet)
+    {
+#if defined(PIXELCODEC_X86)
+      case PixelCodec::SimdInstructionSet_AVX2:
+      case PixelCodec::SimdInstructionSet_SSE41:
+        // copying is limited by the memory bandwidth, 256-bit registers would not make it faster
+        if (streaming && (reinterpret_cast<size_t>(d) & 15) == 0)
+        {
+          processedPixels = ReverseRowSse41<BytesPerPixel, true>(numberOfPixels, s, d);
+        }
+        else
+        {
+          processedPixels = ReverseRowSse41<BytesPerPixel, false>(numberOfPixels, s, d);
+        }
+        break;
+#elif defined(PIXELCODEC_NEON)
+      case PixelCodec::SimdInstructionSet_NEON:
+        processedPixels = ReverseRowNeon<BytesPerPixel>(numberOfPixels, s, d);
+        break;
+#endif
+      default:
+        break;
+    }
+    ReverseRowScalar<BytesPerPixel>(processedPixels, numberOfPixels, s, d);
+  }
+
+  //----------------------------------------------------------------------------
+  // Resampling weights of one image axis: output pixel i is the weighted sum of the input pixels FirstIndex[i] ... FirstIndex[i] + NumberOfTaps - 1,
+  // the weights Weights[i * NumberOfTaps + k] sum to 1 << weightBits
+  struct ResizeTaps
+  {
+    int NumberOfTaps;
+    std::vector<int> FirstIndex;
+    std::vector<unsigned int> Weights;
+  };
+
+  // The column pass sums 8-bit values into 16-bit values, the row pass sums the 16-bit values into 32-bit values
+  const int RESIZE_COLUMN_WEIGHT_BITS = 8;
+  const int RESIZE_ROW_WEIGHT_BITS = 14;
+
+  //----------------------------------------------------------------------------
+  void ComputeResizeTaps(int inputLength, int outputLength, PixelCodec::ResizeFilter filter, int weightBits, ResizeTaps& taps)
+  {
+    const double scale = static_cast<double>(inputLength) / outputLength;
+    int numberOfTaps = 1;
+    switch (filter)
+    {
+      case PixelCodec::ResizeFilter_Box:
+        numberOfTaps = std::max(1, static_cast<int>(scale));
+        break;
+      case PixelCodec::ResizeFilter_Bilinear:
+        numberOfTaps = 2;
+        break;
+      case PixelCodec::ResizeFilter_Area:
+        numberOfTaps = static_cast<int>(std::ceil(scale)) + 1;
+        break;
+    }
+    numberOfTaps = std::min(numberOfTaps, inputLength);
+    taps.NumberOfTaps = numberOfTaps;
+    taps.FirstIndex.resize(outputLength);
+    taps.Weights.resize(static_cast<size_t>(outputLength) * numberOfTaps);
+
+    const int weightSum = 1 << weightBits;
+    std::vector<double> weights(numberOfTaps);
+    for (int i = 0; i < outputLength; ++i)
+    {
+      // The first input pixel is chosen so that all the taps are inside the image, unused taps have zero weight
+      int first = 0;
+      std::fill(weights.begin(), weights.end(), 0.0);
+      switch (filter)
+      {
+        case PixelCodec::ResizeFilter_Box:
+          first = std::min(std::max(static_cast<int>(std::floor((i + 0.5) * scale - 0.5 * numberOfTaps + 0.5)), 0), inputLength - numberOfTaps);
+          std::fill(weights.begin(), weights.end(), 1.0 / numberOfTaps);
+          break;
+        case PixelCodec::ResizeFilter_Bilinear:
+        {
+          const double position = std::min(std::max((i + 0.5) * scale - 0.5, 0.0), inputLength - 1.0);
+          first = std::min(static_cast<int>(position), inputLength - numberOfTaps);
+          weights[0] = 1.0;
+          if (numberOfTaps > 1)
+          {
+            weights[1] = position - first;
+            weights[0] = 1.0 - weights[1];
+          }
+          break;
+        }
+        case PixelCodec::ResizeFilter_Area:
+        {
+          const double start = i * scale;
+          const double end = (i + 1) * scale;
+          first = std::min(static_cast<int>(start), inputLength - numberOfTaps);
+          for (int k = 0; k < numberOfTaps; ++k)
+          {
+            weights[k] = std::max(0.0, std::min(end, first + k + 1.0) - std::max(start, static_cast<double>(first + k))) / scale;
+          }
+          break;
+        }
+      }
+
+      // Rounding errors are added to the largest weight, so the weights sum to exactly weightSum
+      taps.FirstIndex[i] = first;
+      unsigned int* quantizedWeights = &taps.Weights[static_cast<size_t>(i) * numberOfTaps];
+      int total = 0;
+      int largest = 0;
+      for (int k = 0; k < numberOfTaps; ++k)
+      {
+        quantizedWeights[k] = static_cast<unsigned int>(weights[k] * weightSum + 0.5);
+        total += quantizedWeights[k];
+        if (quantizedWeights[k] > quantizedWeights[largest])
+        {
+          largest = k;
+        }
+      }
+      quantizedWeights[largest] += weightSum - total;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Weighted sum of the input rows for values [firstValue, numberOfValues): d[j] = sum(weights[k] * rows[k][j])
+  inline void ResizeColumnsScalar(int firstValue, int numberOfValues, const unsigned char* const* rows, const unsigned int* weights, int numberOfTaps, unsigned short* d)
+  {
+    for (int j = firstValue; j < numberOfValues; ++j)
+    {
+      unsigned int sum = 0;
+      for (int k = 0; k < numberOfTaps; ++k)
+      {
+        sum += weights[k] * rows[k][j];
+      }
+      d[j] = static_cast<unsigned short>(sum);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Resample a row of column pass values along the row, with rounding
+  void ResizeRow(const unsigned short* s, int numberOfComponents, const ResizeTaps& taps, int outputWidth, unsigned char* d)
+  {
+    const int shift = RESIZE_COLUMN_WEIGHT_BITS + RESIZE_ROW_WEIGHT_BITS;
+    const unsigned int rounding = 1u << (shift - 1);
+    for (int x = 0; x < outputWidth; ++x)
+    {
+      const unsigned short* firstPixel = s + static_cast<size_t>(taps.FirstIndex[x]) * numberOfComponents;
+      const unsigned int* weights = &taps.Weights[static_cast<size_t>(x) * taps.NumberOfTaps];
+      for (int component = 0; component < numberOfComponents; ++component)
+      {
+        unsigned int sum = rounding;
+        for (int k = 0; k < taps.NumberOfTaps; ++k)
+        {
+          sum += weights[k] * firstPixel[k * numberOfComponents + component];
+        }
+        *(d++) = static_cast<unsigned char>(sum >> shift);
+      }
+    }
+  }
+
+#if defined(PIXELCODEC_X86)
+
+  //----------------------------------------------------------------------------
+  // Weighted sum of the input rows in 16-value blocks, returns the number of processed values.
+  // The 16-bit products and sums do not overflow, as the weights sum to 1 << RESIZE_COLUMN_WEIGHT_BITS.
+  PIXELCODEC_TARGET_SSE41 int ResizeColumnsSse41(int numberOfValues, const unsigned char* const* rows, const unsigned int* weights, int numberOfTaps, unsigned short* d)
+  {
+    const __m128i zero = _mm_setzero_si128();
+    int j = 0;
+    for (; j + 16 <= numberOfValues; j += 16)
+    {
+      __m128i sumLo = zero;
+      __m128i sumHi = zero;
+      for (int k = 0; k < numberOfTaps; ++k)
+      {
+        const __m128i weight = _mm_set1_epi16(static_cast<short>(weights[k]));
+        const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k] + j));
+        sumLo = _mm_add_epi16(sumLo, _mm_mullo_epi16(_mm_unpacklo_epi8(values, zero), weight));
+        sumHi = _mm_add_epi16(sumHi, _mm_mullo_epi16(_mm_unpackhi_epi8(values, zero), weight));
+      }
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(d + j), sumLo);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(d + j + 8), sumHi);
+    }
+    return j;
+  }
+
+  //----------------------------------------------------------------------------
+  PIXELCODEC_TARGET_AVX2 int ResizeColumnsAvx2(int numberOfValues, const unsigned char* const* rows, const unsigned int* weights, int numberOfTaps, unsigned short* d)
+  {
+    int j = 0;
+    for (; j + 32 <= numberOfValues; j += 32)
+    {
+      __m256i sumLo = _mm256_setzero_si256();
+      __m256i sumHi = _mm256_setzero_si256();
+      for (int k = 0; k < numberOfTaps; ++k)
+      {
+        const __m256i weight = _mm256_set1_epi16(static_cast<short>(weights[k]));
+        sumLo = _mm256_add_epi16(sumLo, _mm256_mullo_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k] + j))), weight));
+        sumHi = _mm256_add_epi16(sumHi, _mm256_mullo_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k] + j + 16))), weight));
+      }
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(d + j), sumLo);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(d + j + 16), sumHi);
+    }
+    return j;
+  }
+
+#elif defined(PIXELCODEC_NEON)
+
+  //----------------------------------------------------------------------------
+  // Weighted sum of the input rows in 16-value blocks, returns the number of processed values
+  int ResizeColumnsNeon(int numberOfValues, const unsigned char* const* rows, const unsigned int* weights, int numberOfTaps, unsigned short* d)
+  {
+    int j = 0;
+    for (; j + 16 <= numberOfValues; j += 16)
+    {
+      uint16x8_t sumLo = vdupq_n_u16(0);
+      uint16x8_t sumHi = vdupq_n_u16(0);
+      for (int k = 0; k < numberOfTaps; ++k)
+      {
+        const uint16_t weight = static_cast<uint16_t>(weights[k]);
+        const uint8x16_t values = vld1q_u8(rows[k] + j);
+        sumLo = vmlaq_n_u16(sumLo, vmovl_u8(vget_low_u8(values)), weight);
+        sumHi = vmlaq_n_u16(sumHi, vmovl_u8(vget_high_u8(values)), weight);
+      }
+      vst1q_u16(d + j, sumLo);
+      vst1q_u16(d + j + 8, sumHi);
+    }
+    return j;
+  }
+
+#endif
+}
+
+//----------------------------------------------------------------------------
+PixelCodec::SimdInstructionSet PixelCodec::GetSupportedSimdInstructionSet()
+{
+  static const SimdInstructionSet supportedInstructionSet = DetectSimdInstructionSet();
+  return supportedInstructionSet;
+}
+
+//----------------------------------------------------------------------------
+PixelCodec::SimdInstructionSet PixelCodec::GetSimdInstructionSet()
+{
+  return static_cast<SimdInstructionSet>(ActiveSimdInstructionSet().load());
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PixelCodec::SetSimdInstructionSet(SimdInstructionSet instructionSet)
+{
+  SimdInstructionSet supported = GetSupportedSimdInstructionSet();
+  bool isSupported = (instructionSet == SimdInstructionSet_None || instructionSet == supported
+                      || (instructionSet == SimdInstructionSet_SSE41 && supported == SimdInstructionSet_AVX2));
+  if (!isSupported)
+  {
+    LOG_ERROR("Instruction set " << GetSimdInstructionSetAsString(instructionSet) << " is not supported. Supported instruction set: " << GetSimdInstructionSetAsString(supported));
+    return PLUS_FAIL;
+  }
+  ActiveSimdInstructionSet() = instructionSet;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+std::string PixelCodec::GetSimdInstructionSetAsString(SimdInstructionSet instructionSet)
+{
+  switch (instructionSet)
+  {
+    case SimdInstructionSet_None:
+      return "None";
+    case SimdInstructionSet_SSE41:
+      return "SSE4.1";
+    case SimdInstructionSet_AVX2:
+      return "AVX2";
+    case SimdInstructionSet_NEON:
+      return "NEON";
+    default:
+      return "Unknown";
+  }
+}
+
+//----------------------------------------------------------------------------
+std::string PixelCodec::GetResizeFilterAsString(ResizeFilter filter)
+{
+  switch (filter)
+  {
+    case ResizeFilter_Box:
+      return "BOX";
+    case ResizeFilter_Bilinear:
+      return "BILINEAR";
+    case ResizeFilter_Area:
+      return "AREA";
+    default:
+      return "Unknown";
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PixelCodec::GetResizeFilterFromString(const std::string& filterName, ResizeFilter& filter)
+{
+  const ResizeFilter filters[] = { ResizeFilter_Box, ResizeFilter_Bilinear, ResizeFilter_Area };
+  for (size_t i = 0; i < sizeof(filters) / sizeof(filters[0]); ++i)
+  {
+    if (igsioCommon::IsEqualInsensitive(filterName, GetResizeFilterAsString(filters[i])))
+    {
+      filter = filters[i];
+      return PLUS_SUCCESS;
+    }
+  }
+  LOG_ERROR("Unknown resize filter: " << filterName << ". Valid filters: BOX, BILINEAR, AREA.");
+  return PLUS_FAIL;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PixelCodec::ResizeImage(const unsigned char* s, const int inputSize[2], int numberOfComponents, const int outputSize[2], ResizeFilter filter, unsigned char* d)
+{
+  return ResizeImage(GetSimdInstructionSet(), s, inputSize, numberOfComponents, outputSize, filter, d);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PixelCodec::ResizeImageScalar(const unsigned char* s, const int inputSize[2], int numberOfComponents, const int outputSize[2], ResizeFilter filter, unsigned char* d)
+{
+  return ResizeImage(SimdInstructionSet_None, s, inputSize, numberOfComponents, outputSize, filter, d);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PixelCodec::ResizeImage(SimdInstructionSet instructionSet, const unsigned char* s, const int inputSize[2], int numberOfComponents, const int outputSize[2],
+                                   ResizeFilter filter, unsigned char* d)
+{
+  if (s == NULL || d == NULL || inputSize[0] < 1 || inputSize[1] < 1 || outputSize[0] < 1 || outputSize[1] < 1 || numberOfComponents < 1)
+  {
+    LOG_ERROR("PixelCodec::ResizeImage: invalid image or image size");
+    return PLUS_FAIL;
+  }
+
+  ResizeTaps columnTaps;
+  ComputeResizeTaps(inputSize[1], outputSize[1], filter, RESIZE_COLUMN_WEIGHT_BITS, columnTaps);
+  ResizeTaps rowTaps;
+  ComputeResizeTaps(inputSize[0], outputSize[0], filter, RESIZE_ROW_WEIGHT_BITS, rowTaps);
+
+  // Each output row is computed from a full-width, column resampled input row, which stays in the cache
+  const int valuesPerInputRow = inputSize[0] * numberOfComponents;
+  const size_t valuesPerOutputRow = static_cast<size_t>(outputSize[0]) * numberOfComponents;
+  std::vector<unsigned short> resampledRow(valuesPerInputRow);
+  std::vector<const unsigned char*> inputRows(columnTaps.NumberOfTaps);
+  for (int y = 0; y < outputSize[1]; ++y)
+  {
+    for (int k = 0; k < columnTaps.NumberOfTaps; ++k)
+    {
+      inputRows[k] = s + static_cast<size_t>(columnTaps.FirstIndex[y] + k) * valuesPerInputRow;
+    }
+    const unsigned int* weights = &columnTaps.Weights[static_cast<size_t>(y) * columnTaps.NumberOfTaps];
+
+    int processedValues = 0;
+    switch (instructionSet)
+    {
+#if defined(PIXELCODEC_X86)
+      case SimdInstructionSet_AVX2:
+        processedValues = ResizeColumnsAvx2(valuesPerInputRow, &inputRows[0], weights, columnTaps.NumberOfTaps, &resampledRow[0]);
+        break;
+      case SimdInstructionSet_SSE41:
+        processedValues = ResizeColumnsSse41(valuesPerInputRow, &inputRows[0], weights, columnTaps.NumberOfTaps, &resampledRow[0]);
+        break;
+#elif defined(PIXELCODEC_NEON)
+      case SimdInstructionSet_NEON:
+        processedValues = ResizeColumnsNeon(valuesPerInputRow, &inputRows[0], weights, columnTaps.NumberOfTaps, &resampledRow[0]);
+        break;
+#endif
+      default:
+        break;
+    }
+    ResizeColumnsScalar(processedValues, valuesPerInputRow, &inputRows[0], weights, columnTaps.NumberOfTaps, &resampledRow[0]);
+
+    ResizeRow(&resampledRow[0], numberOfComponents, rowTaps, outputSize[0], d + y * valuesPerOutputRow);
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void PixelCodec::Rgb24ToGray(int width, int height, unsigned char* s, unsigned char* d)
+{
+  int numberOfPixels = width * height;
+  int processedPixels = 0;
+  switch (GetSimdInstructionSet())
+  {
+#if defined(PIXELCODEC_X86)
+    case SimdInstructionSet_AVX2:
+    case SimdInstructionSet_SSE41:
+      // the 3-byte pixel stride does not benefit from 256-bit registers, the SSE4.1 implementation is used for AVX2, too
+      processedPixels = Rgb24ToGraySse41(numberOfPixels, s, d);
+      break;
+#elif defined(PIXELCODEC_NEON)
+    case SimdInstructionSet_NEON:
+      processedPixels = Rgb24ToGrayNeon(numberOfPixels, s, d);
+      break;
+#endif
+    default:
+      break;
+  }
+  Rgb24ToGrayScalar(numberOfPixels - processedPixels, 1, s + processedPixels * 3, d + processedPixels);
+}
+
+//----------------------------------------------------------------------------
+void PixelCodec::Rgba32ToGray(int width, int height, unsigned char* s, unsigned char* d)
+{
+  int numberOfPixels = width * height;
+  int processedPixels = 0;
+  switch (GetSimdInstructionSet())
+  {
+#if defined(PIXELCODEC_X86)
+    case SimdInstructionSet_AVX2:
+      processedPixels = Rgba32ToGrayAvx2(numberOfPixels, s, d);
+      break;
+    case SimdInstructionSet_SSE41:
+      processedPixels = Rgba32ToGraySse41(numberOfPixels, s, d);
+      break;
+#elif defined(PIXELCODEC_NEON)
+    case SimdInstructionSet_NEON:
+      processedPixels = Rgba32ToGrayNeon(numberOfPixels, s, d);
+      break;
+#endif
+    default:
+      break;
+  }
+  Rgba32ToGrayScalar(numberOfPixels - processedPixels, 1, s + processedPixels * 4, d + processedPixels);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PixelCodec::Yuv422pToBmp24(ComponentOrdering outputOrdering, int width, int height, unsigned char* s, unsigned char* d)
+{
+  int numberOfMacropixels = height * (width / 2);
+  int processedMacropixels = 0;
+  switch (GetSimdInstructionSet())
+  {
+#if defined(PIXELCODEC_X86)
+    case SimdInstructionSet_AVX2:
+      processedMacropixels = Yuv422pToBmp24Avx2(outputOrdering, numberOfMacropixels, s, d);
+      break;
+    case SimdInstructionSet_SSE41:
+      processedMacropixels = Yuv422pToBmp24Sse41(outputOrdering, numberOfMacropixels, s, d);
+      break;
+#elif defined(PIXELCODEC_NEON)
+    case SimdInstructionSet_NEON:
+      processedMacropixels = Yuv422pToBmp24Neon(outputOrdering, numberOfMacropixels, s, d);
+      break;
+#endif
+    default:
+      break;
+  }
+  return Yuv422pToBmp24Scalar(outputOrdering, (numberOfMacropixels - processedMacropixels) * 2, 1, s + processedMacropixels * 4, d + processedMacropixels * 6);
+}
+
+//----------------------------------------------------------------------------
+void PixelCodec::Yuv422pToGray(int width, int height, unsigned char* s, unsigned char* d)
+{
+  int numberOfMacropixels = height * (width / 2);
+  int processedMacropixels = 0;
+  switch (GetSimdInstructionSet())
+  {
+#if defined(PIXELCODEC_X86)
+    case SimdInstructionSet_AVX2:
+      processedMacropixels = Yuv422pToGrayAvx2(numberOfMacropixels, s, d);
+      break;
+    case SimdInstructionSet_SSE41:
+      processedMacropixels = Yuv422pToGraySse41(numberOfMacropixels, s, d);
+      break;
+#elif defined(PIXELCODEC_NEON)
+    case SimdInstructionSet_NEON:
+      processedMacropixels = Yuv422pToGrayNeon(numberOfMacropixels, s, d);
+      break;
+#endif
+    default:
+      break;
+  }
+  Yuv422pToGrayScalar((numberOfMacropixels - processedMacropixels) * 2, 1, s + processedMacropixels * 4, d + processedMacropixels * 2);
+}
+
+//----------------------------------------------------------------------------
+void PixelCodec::FlipClipImage(const unsigned char* s, const int inputSize[3], int bytesPerPixel, const int clipOrigin[3], const int clipSize[3],
+                               bool flipColumns, bool flipRows, bool flipSlices, unsigned char* d)
+{
+  const size_t inputRowSizeBytes = static_cast<size_t>(inputSize[0]) * bytesPerPixel;
+  const size_t inputSliceSizeBytes = inputRowSizeBytes * inputSize[1];
+  const size_t outputRowSizeBytes = static_cast<size_t>(clipSize[0]) * bytesPerPixel;
+  const bool streaming = outputRowSizeBytes * clipSize[1] * clipSize[2] >= STREAMING_STORE_MINIMUM_IMAGE_SIZE_BYTES;
+  const SimdInstructionSet instructionSet = GetSimdInstructionSet();
+
+  for (int z = 0; z < clipSize[2]; ++z)
+  {
+    const int inputZ = clipOrigin[2] + (flipSlices ? clipSize[2] - 1 - z : z);
+    for (int y = 0; y < clipSize[1]; ++y)
+    {
+      const int inputY = clipOrigin[1] + (flipRows ? clipSize[1] - 1 - y : y);
+      const unsigned char* inputRow = s + inputZ * inputSliceSizeBytes + inputY * inputRowSizeBytes + static_cast<size_t>(clipOrigin[0]) * bytesPerPixel;
+      unsigned char* outputRow = d + (static_cast<size_t>(z) * clipSize[1] + y) * outputRowSizeBytes;
+      if (!flipColumns)
+      {
+        // memcpy runs at the memory bandwidth (and uses streaming stores for large sizes)
+        memcpy(outputRow, inputRow, outputRowSizeBytes);
+        continue;
+      }
+      switch (bytesPerPixel)
+      {
+        case 1:
+          ReverseRow<1>(instructionSet, streaming, clipSize[0], inputRow, outputRow);
+          break;
+        case 2:
+          ReverseRow<2>(instructionSet, streaming, clipSize[0], inputRow, outputRow);
+          break;
+        case 3:
+          ReverseRowScalar<3>(0, clipSize[0], inputRow, outputRow);
+          break;
+        case 4:
+          ReverseRow<4>(instructionSet, streaming, clipSize[0], inputRow, outputRow);
+          break;
+        case 8:
+          ReverseRow<8>(instructionSet, streaming, clipSize[0], inputRow, outputRow);
+          break;
+        default:
+          ReverseRowScalar(bytesPerPixel, clipSize[0], inputRow, outputRow);
+          break;
+      }
+    }
+  }
+
+#if defined(PIXELCODEC_X86)
+  if (streaming && flipColumns && instructionSet != SimdInstructionSet_None)
+  {
+    // make the streaming stores visible to the other threads before the frame is published
+    _mm_sfence();
+  }
+#endif
+}
+
+//----------------------------------------------------------------------------
+void PixelCodec::FlipClipImageScalar(const unsigned char* s, const int inputSize[3], int bytesPerPixel, const int clipOrigin[3], const int clipSize[3],
+                                     bool flipColumns, bool flipRows, bool flipSlices, unsigned char* d)
+{
+  for (int z = 0; z < clipSize[2]; ++z)
+  {
+    for (int y = 0; y < clipSize[1]; ++y)
+    {
+      for (int x = 0; x < clipSize[0]; ++x)
+      {
+        const size_t inputX = clipOrigin[0] + (flipColumns ? clipSize[0] - 1 - x : x);
+        const size_t inputY = clipOrigin[1] + (flipRows ? clipSize[1] - 1 - y : y);
+        const size_t inputZ = clipOrigin[2] + (flipSlices ? clipSize[2] - 1 - z : z);
+        memcpy(d, s + ((inputZ * inputSize[1] + inputY) * inputSize[0] + inputX) * bytesPerPixel, bytesPerPixel);
+        d += bytesPerPixel;
+      }
+    }
+  }
+}
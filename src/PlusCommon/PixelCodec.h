@@ -41,9 +41,13 @@ static const long VTK_BI_YUY2 = 0x32595559;
 /*!
 \class PixelCodec
 \brief A utility class that contains static functions for converting between various pixel encodings
+
+The grayscale and YUY2 conversions and the image resizing that run on every frame have SIMD implementations (SSE4.1, AVX2, NEON),
+which are selected at runtime based on the CPU capabilities. The SIMD implementations give exactly the same
+results as the scalar implementations (the ...Scalar methods).
 \ingroup PlusLibCommon
 */
-class PixelCodec
+class vtkPlusCommonExport PixelCodec
 {
 public:
   enum ComponentOrdering
@@ -63,6 +67,38 @@ public:
     PixelEncoding_MJPG
   };
 
+  enum ResizeFilter
+  {
+    ResizeFilter_Box,      /*!< Average of the block of floor(input size / output size) pixels around each output pixel */
+    ResizeFilter_Bilinear, /*!< Bilinear interpolation at the output pixel centers */
+    ResizeFilter_Area      /*!< Average of the input pixels covered by each output pixel, weighted by the covered area */
+  };
+
+  enum SimdInstructionSet
+  {
+    SimdInstructionSet_None,
+    SimdInstructionSet_SSE41,
+    SimdInstructionSet_AVX2,
+    SimdInstructionSet_NEON
+  };
+
+  /*! Get the most capable instruction set that is supported by the CPU and the build */
+  static SimdInstructionSet GetSupportedSimdInstructionSet();
+
+  /*! Get the instruction set that is used by the conversions. By default the most capable supported instruction set is used. */
+  static SimdInstructionSet GetSimdInstructionSet();
+
+  /*!
+    Set the instruction set that is used by the conversions (for testing and benchmarking).
+    SimdInstructionSet_None selects the scalar implementation. Fails if the instruction set is not supported.
+  */
+  static PlusStatus SetSimdInstructionSet(SimdInstructionSet instructionSet);
+
+  static std::string GetSimdInstructionSetAsString(SimdInstructionSet instructionSet);
+
+  static std::string GetResizeFilterAsString(ResizeFilter filter);
+  static PlusStatus GetResizeFilterFromString(const std::string& filterName, ResizeFilter& filter);
+
   //----------------------------------------------------------------------------
   static bool IsConvertToGraySupported(int inputCompression)
   {
@@ -289,7 +325,8 @@ public:
   Note that this method computes the intensity (simple averaging of the RGB components).
   This is not equivalent with the perceived luminance of color images (e.g., 0.21R + 0.72G + 0.07B or 0.30R + 0.59G + 0.11B)
   */
-  static inline void Rgb24ToGray(int width, int height, unsigned char* s, unsigned char* d)
+  static void Rgb24ToGray(int width, int height, unsigned char* s, unsigned char* d);
+  static inline void Rgb24ToGrayScalar(int width, int height, unsigned char* s, unsigned char* d)
   {
     int totalLen = width * height;
     for (int i = 0; i < totalLen; i++)
@@ -306,7 +343,8 @@ public:
   Note that this method computes the intensity (simple averaging of the RGB components).
   This is not equivalent with the perceived luminance of color images (e.g., 0.21R + 0.72G + 0.07B or 0.30R + 0.59G + 0.11B)
   */
-  static inline void Rgba32ToGray(int width, int height, unsigned char* s, unsigned char* d)
+  static void Rgba32ToGray(int width, int height, unsigned char* s, unsigned char* d);
+  static inline void Rgba32ToGrayScalar(int width, int height, unsigned char* s, unsigned char* d)
   {
     int totalLen = width * height;
     for (int i = 0; i < totalLen; i++)
@@ -319,6 +357,7 @@ public:
 
   //----------------------------------------------------------------------------
   /*! Conversion from YUV to RGB space
+  Converts a single pixel, therefore it has no SIMD implementation. Use Yuv422pToBmp24 for converting images.
   Uses integer math, which is faster but more complex to read
   Equivalent with the following floating point math (simpler but slower)
   int Y = yuv[0] - 16;
@@ -377,7 +416,8 @@ public:
   YUY2 coding is typically used for webcams
   source: http://sundararajana.blogspot.ca/2007/12/yuy2-to-rgb24-conversion.html
   */
-  static PlusStatus Yuv422pToBmp24(ComponentOrdering outputOrdering, int width, int height, unsigned char* s, unsigned char* d)
+  static PlusStatus Yuv422pToBmp24(ComponentOrdering outputOrdering, int width, int height, unsigned char* s, unsigned char* d);
+  static PlusStatus Yuv422pToBmp24Scalar(ComponentOrdering outputOrdering, int width, int height, unsigned char* s, unsigned char* d)
   {
     unsigned char* p_dest;
     unsigned char y1, u, y2, v;
@@ -472,7 +512,8 @@ public:
   YUY2 coding is typically used for webcams
   source: http://sundararajana.blogspot.ca/2007/12/yuy2-to-rgb24-conversion.html
   */
-  static void Yuv422pToGray(int width, int height, unsigned char* s, unsigned char* d)
+  static void Yuv422pToGray(int width, int height, unsigned char* s, unsigned char* d);
+  static void Yuv422pToGrayScalar(int width, int height, unsigned char* s, unsigned char* d)
   {
     int i;
     unsigned char* p_dest;
@@ -516,8 +557,44 @@ public:
     }
   }
 
+  //----------------------------------------------------------------------------
+  /*!
+  Copy a box of an image into an output image, optionally reversing the order of the columns, rows, and slices in the box.
+  This performs the flips of an image orientation change together with clipping (transposing is not supported).
+  Rows are copied by memcpy, or reversed by SIMD instructions for 1, 2, 4, and 8 byte pixels. Large output images are
+  written with streaming (non-temporal) stores, as they are not read right after the copy.
+  \param s Input image, without padding between the rows
+  \param inputSize Size of the input image in pixels (columns, rows, slices)
+  \param bytesPerPixel Size of a pixel, including all scalar components
+  \param clipOrigin First column, row, and slice of the copied box, the box must be inside the input image
+  \param clipSize Size of the copied box, which is the size of the output image
+  \param d Output image, without padding between the rows
+  */
+  static void FlipClipImage(const unsigned char* s, const int inputSize[3], int bytesPerPixel, const int clipOrigin[3], const int clipSize[3],
+                            bool flipColumns, bool flipRows, bool flipSlices, unsigned char* d);
+  static void FlipClipImageScalar(const unsigned char* s, const int inputSize[3], int bytesPerPixel, const int clipOrigin[3], const int clipSize[3],
+                                  bool flipColumns, bool flipRows, bool flipSlices, unsigned char* d);
+
+  //----------------------------------------------------------------------------
+  /*!
+  Resize an image of 8-bit pixels with interleaved components.
+  The image is resampled along the columns first (by SIMD instructions, this pass reads all the input pixels),
+  then along the rows of the output. Both passes use fixed-point weights, so the SIMD and the scalar
+  implementation give exactly the same result.
+  \param s Input image, without padding between the rows
+  \param inputSize Size of the input image in pixels (columns, rows)
+  \param numberOfComponents Number of scalar components of a pixel
+  \param outputSize Size of the output image in pixels (columns, rows)
+  \param d Output image, without padding between the rows
+  */
+  static PlusStatus ResizeImage(const unsigned char* s, const int inputSize[2], int numberOfComponents, const int outputSize[2], ResizeFilter filter, unsigned char* d);
+  static PlusStatus ResizeImageScalar(const unsigned char* s, const int inputSize[2], int numberOfComponents, const int outputSize[2], ResizeFilter filter, unsigned char* d);
+
 private:
   PixelCodec(); // prevent instantiation
+
+  static PlusStatus ResizeImage(SimdInstructionSet instructionSet, const unsigned char* s, const int inputSize[2], int numberOfComponents, const int outputSize[2],
+                                ResizeFilter filter, unsigned char* d);
 };
 
 
@@ -0,0 +1,325 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusAsyncLogBackend.h"
+
+#include <vtkIGSIOAccurateTimer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+
+namespace
+{
+  const int CALL_SITE_COUNT_BITS = 24;
+  const unsigned long long CALL_SITE_COUNT_MASK = (1ULL << CALL_SITE_COUNT_BITS) - 1;
+
+  std::atomic<unsigned long long> NextInstanceId(1);
+
+  //----------------------------------------------------------------------------
+  bool IsEarlier(const PlusAsyncLogBackend::Record& a, const PlusAsyncLogBackend::Record& b)
+  {
+    return a.Timestamp < b.Timestamp;
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusAsyncLogBackend::ThreadRing::ThreadRing(size_t capacity, unsigned int threadIndex)
+  : Records(capacity)
+  , Head(0)
+  , Tail(0)
+  , ThreadExited(false)
+  , ThreadIndex(threadIndex)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusAsyncLogBackend::PlusAsyncLogBackend(const Writer& writer)
+  : RecordWriter(writer)
+  , InstanceId(NextInstanceId++)
+  , RingCapacity(8192)
+  , MaximumMessagesPerSecondPerCallSite(0)
+  , NumberOfRegisteredThreads(0)
+  , NumberOfReportedDroppedRecords(0)
+  , NumberOfDroppedRecords(0)
+  , NumberOfSuppressedRecords(0)
+  , StopRequested(false)
+  , FlushPeriodSec(0.02)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusAsyncLogBackend::~PlusAsyncLogBackend()
+{
+  this->Stop();
+}
+
+//----------------------------------------------------------------------------
+void PlusAsyncLogBackend::SetRingCapacity(size_t ringCapacity)
+{
+  std::lock_guard<std::mutex> lock(this->RingsMutex);
+  this->RingCapacity = std::max<size_t>(ringCapacity, 2);
+}
+
+//----------------------------------------------------------------------------
+void PlusAsyncLogBackend::SetFlushPeriodSec(double flushPeriodSec)
+{
+  std::lock_guard<std::mutex> lock(this->FlusherMutex);
+  this->FlushPeriodSec = std::max(flushPeriodSec, 0.001);
+}
+
+//----------------------------------------------------------------------------
+double PlusAsyncLogBackend::GetFlushPeriodSec() const
+{
+  std::lock_guard<std::mutex> lock(const_cast<PlusAsyncLogBackend*>(this)->FlusherMutex);
+  return this->FlushPeriodSec;
+}
+
+//----------------------------------------------------------------------------
+void PlusAsyncLogBackend::SetMaximumMessagesPerSecondPerCallSite(unsigned int maximumMessagesPerSecond)
+{
+  this->MaximumMessagesPerSecondPerCallSite = static_cast<unsigned int>(std::min<unsigned long long>(maximumMessagesPerSecond, CALL_SITE_COUNT_MASK));
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusAsyncLogBackend::Start()
+{
+  if (this->IsRunning())
+  {
+    return PLUS_SUCCESS;
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->FlusherMutex);
+    this->StopRequested = false;
+  }
+  this->FlusherThread = std::thread(&PlusAsyncLogBackend::FlushRecords, this);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void PlusAsyncLogBackend::Stop()
+{
+  if (this->IsRunning())
+  {
+    {
+      std::lock_guard<std::mutex> lock(this->FlusherMutex);
+      this->StopRequested = true;
+    }
+    this->FlushRequested.notify_all();
+    this->FlusherThread.join();
+  }
+  this->Flush();
+}
+
+//----------------------------------------------------------------------------
+PlusAsyncLogBackend::ThreadRing* PlusAsyncLogBackend::GetThreadRing()
+{
+  // The ring of the thread is cached, so the registry of rings is only locked for the first message of a thread
+  struct ThreadRingCache
+  {
+    ThreadRingCache() : InstanceId(0) {}
+    ~ThreadRingCache()
+    {
+      if (this->Ring)
+      {
+        this->Ring->ThreadExited = true;
+      }
+    }
+    unsigned long long InstanceId;
+    std::shared_ptr<ThreadRing> Ring;
+  };
+  static thread_local ThreadRingCache cache;
+
+  if (cache.InstanceId == this->InstanceId)
+  {
+    return cache.Ring.get();
+  }
+
+  // The thread logs to another backend now, its ring of the previous backend is not used anymore
+  if (cache.Ring)
+  {
+    cache.Ring->ThreadExited = true;
+  }
+  std::lock_guard<std::mutex> lock(this->RingsMutex);
+  cache.Ring = std::make_shared<ThreadRing>(this->RingCapacity, this->NumberOfRegisteredThreads++);
+  cache.InstanceId = this->InstanceId;
+  this->Rings.push_back(cache.Ring);
+  return cache.Ring.get();
+}
+
+//----------------------------------------------------------------------------
+bool PlusAsyncLogBackend::AcceptCallSiteMessage(const char* fileName, int lineNumber, unsigned int& numberOfSuppressedMessages)
+{
+  numberOfSuppressedMessages = 0;
+  unsigned long long maximumMessagesPerSecond = this->MaximumMessagesPerSecondPerCallSite.load(std::memory_order_relaxed);
+  if (maximumMessagesPerSecond == 0)
+  {
+    return true;
+  }
+
+  // File names of call sites are string literals, so the call site is identified by the address of the file name and the line number
+  size_t hash = reinterpret_cast<size_t>(fileName) ^ (static_cast<size_t>(lineNumber) * 2654435761u);
+  CallSite& callSite = this->CallSites[(hash ^ (hash >> 16)) % NUMBER_OF_CALL_SITE_SLOTS];
+
+  unsigned long long second = static_cast<unsigned long long>(
+    std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+  unsigned long long state = callSite.State.load(std::memory_order_relaxed);
+  while (true)
+  {
+    bool newSecond = ((state >> CALL_SITE_COUNT_BITS) != second);
+    unsigned long long newState = 0;
+    if (newSecond)
+    {
+      newState = (second << CALL_SITE_COUNT_BITS) | 1;
+    }
+    else if ((state & CALL_SITE_COUNT_MASK) < maximumMessagesPerSecond)
+    {
+      newState = state + 1;
+    }
+    else
+    {
+      callSite.NumberOfSuppressedMessages++;
+      this->NumberOfSuppressedRecords++;
+      return false;
+    }
+    if (callSite.State.compare_exchange_weak(state, newState, std::memory_order_relaxed))
+    {
+      if (newSecond)
+      {
+        numberOfSuppressedMessages = callSite.NumberOfSuppressedMessages.exchange(0);
+      }
+      return true;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusAsyncLogBackend::AddRecordResult PlusAsyncLogBackend::AddRecord(int level, const char* message, const char* fileName, int lineNumber, bool droppable)
+{
+  unsigned int numberOfSuppressedMessages = 0;
+  if (!this->AcceptCallSiteMessage(fileName, lineNumber, numberOfSuppressedMessages))
+  {
+    return RECORD_SUPPRESSED;
+  }
+
+  ThreadRing* ring = this->GetThreadRing();
+  size_t head = ring->Head.load(std::memory_order_relaxed);
+  size_t tail = ring->Tail.load(std::memory_order_acquire);
+  size_t capacity = ring->Records.size();
+  if (head - tail >= capacity)
+  {
+    if (droppable)
+    {
+      this->NumberOfDroppedRecords++;
+      return RECORD_DROPPED;
+    }
+    return RECORD_REJECTED;
+  }
+
+  Record& record = ring->Records[head % capacity];
+  record.Level = level;
+  record.Timestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+  record.FileName = (fileName != NULL ? fileName : "");
+  record.LineNumber = lineNumber;
+  record.ThreadIndex = ring->ThreadIndex;
+  record.Message = (message != NULL ? message : "");
+  if (numberOfSuppressedMessages > 0)
+  {
+    std::ostringstream note;
+    note << " (" << numberOfSuppressedMessages << " messages from this call site were suppressed by the rate limit)";
+    record.Message += note.str();
+  }
+  ring->Head.store(head + 1, std::memory_order_release);
+
+  // Do not wait for the period if the ring is getting full
+  if (head + 1 - tail == capacity / 2)
+  {
+    this->FlushRequested.notify_one();
+  }
+  return RECORD_QUEUED;
+}
+
+//----------------------------------------------------------------------------
+void PlusAsyncLogBackend::Flush()
+{
+  std::lock_guard<std::recursive_mutex> flushLock(this->FlushMutex);
+
+  std::vector< std::shared_ptr<ThreadRing> > rings;
+  {
+    std::lock_guard<std::mutex> lock(this->RingsMutex);
+    rings = this->Rings;
+  }
+
+  this->FlushedRecords.clear();
+  std::vector< std::shared_ptr<ThreadRing> > exitedEmptyRings;
+  for (std::vector< std::shared_ptr<ThreadRing> >::iterator ringIt = rings.begin(); ringIt != rings.end(); ++ringIt)
+  {
+    ThreadRing& ring = **ringIt;
+    // Read before taking the records, so that no records are added after the ring is found empty and exited
+    bool threadExited = ring.ThreadExited.load(std::memory_order_acquire);
+    size_t tail = ring.Tail.load(std::memory_order_relaxed);
+    size_t head = ring.Head.load(std::memory_order_acquire);
+    for (size_t i = tail; i < head; i++)
+    {
+      // Copied instead of moved, so that the strings of the ring keep their storage for the next records
+      this->FlushedRecords.push_back(ring.Records[i % ring.Records.size()]);
+    }
+    ring.Tail.store(head, std::memory_order_release);
+    if (threadExited)
+    {
+      exitedEmptyRings.push_back(*ringIt);
+    }
+  }
+
+  unsigned long long numberOfDroppedRecords = this->GetNumberOfDroppedRecords();
+  if (numberOfDroppedRecords != this->NumberOfReportedDroppedRecords)
+  {
+    std::ostringstream message;
+    message << (numberOfDroppedRecords - this->NumberOfReportedDroppedRecords) << " log messages were dropped, because the log queue of the logging thread was full";
+    Record record;
+    record.Level = vtkIGSIOLogger::LOG_LEVEL_WARNING;
+    record.Timestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+    record.FileName = __FILE__;
+    record.LineNumber = __LINE__;
+    record.Message = message.str();
+    this->FlushedRecords.push_back(record);
+    this->NumberOfReportedDroppedRecords = numberOfDroppedRecords;
+  }
+
+  // Records of different threads are merged in timestamp order
+  std::stable_sort(this->FlushedRecords.begin(), this->FlushedRecords.end(), IsEarlier);
+  for (std::vector<Record>::iterator recordIt = this->FlushedRecords.begin(); recordIt != this->FlushedRecords.end(); ++recordIt)
+  {
+    this->RecordWriter(*recordIt);
+  }
+  this->FlushedRecords.clear();
+
+  if (!exitedEmptyRings.empty())
+  {
+    std::lock_guard<std::mutex> lock(this->RingsMutex);
+    for (std::vector< std::shared_ptr<ThreadRing> >::iterator ringIt = exitedEmptyRings.begin(); ringIt != exitedEmptyRings.end(); ++ringIt)
+    {
+      this->Rings.erase(std::remove(this->Rings.begin(), this->Rings.end(), *ringIt), this->Rings.end());
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void PlusAsyncLogBackend::FlushRecords()
+{
+  std::unique_lock<std::mutex> lock(this->FlusherMutex);
+  while (!this->StopRequested)
+  {
+    this->FlushRequested.wait_for(lock, std::chrono::duration<double>(this->FlushPeriodSec));
+    if (this->StopRequested)
+    {
+      break;
+    }
+    lock.unlock();
+    this->Flush();
+    lock.lock();
+  }
+}
@@ -0,0 +1,182 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusAsyncLogBackend_h
+#define __PlusAsyncLogBackend_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusCommonExport.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*!
+  \class PlusAsyncLogBackend
+  \brief Queues log messages in per-thread lock-free rings and writes them on a background thread
+
+  The logging thread only copies the formatted message and its timestamp into the ring of the thread (a single producer,
+  single consumer ring without locks), so logging at DEBUG or TRACE level does not block device threads on file and console
+  output. The flusher thread periodically takes the records of all rings and passes them to the writer, merged in timestamp
+  order (records of different threads that are logged at almost the same time may be written in different flushes).
+
+  If the ring of a thread is full then droppable records (e.g., debug messages) are dropped and counted, other records
+  are rejected, so that the caller can write them immediately. The number of dropped records is reported in the log.
+
+  The number of messages of each call site (source file and line) can be limited per second, so that a message
+  logged in a fast loop cannot flood the log. The number of suppressed messages of a call site is appended to its next
+  message that is not suppressed.
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport PlusAsyncLogBackend
+{
+public:
+  struct Record
+  {
+    Record() : Level(0), Timestamp(0), LineNumber(0), ThreadIndex(0) {}
+    int Level;
+    /*! Time when the message was logged, see vtkIGSIOAccurateTimer::GetSystemTime */
+    double Timestamp;
+    /*! File name of the call site */
+    std::string FileName;
+    int LineNumber;
+    /*! Sequence number of the logging thread, in the order the threads first logged a message */
+    unsigned int ThreadIndex;
+    std::string Message;
+  };
+
+  enum AddRecordResult
+  {
+    RECORD_QUEUED,
+    /*! The call site exceeded its message rate limit */
+    RECORD_SUPPRESSED,
+    /*! The ring of the thread was full and the record was droppable */
+    RECORD_DROPPED,
+    /*! The ring of the thread was full and the record was not droppable, the caller has to write it */
+    RECORD_REJECTED
+  };
+
+  /*! Writes a record. Called by one thread at a time. */
+  typedef std::function<void(const Record&)> Writer;
+
+  PlusAsyncLogBackend(const Writer& writer);
+  /*! Stops the flusher thread and writes all queued records */
+  virtual ~PlusAsyncLogBackend();
+
+  /*! Number of records in the ring of each thread. Takes effect for the threads that log their first message afterwards. */
+  void SetRingCapacity(size_t ringCapacity);
+  size_t GetRingCapacity() const { return this->RingCapacity; }
+
+  /*! Period of writing the queued records */
+  void SetFlushPeriodSec(double flushPeriodSec);
+  double GetFlushPeriodSec() const;
+
+  /*! Maximum number of messages from a call site in a second. 0 means no limit. */
+  void SetMaximumMessagesPerSecondPerCallSite(unsigned int maximumMessagesPerSecond);
+  unsigned int GetMaximumMessagesPerSecondPerCallSite() const { return this->MaximumMessagesPerSecondPerCallSite.load(std::memory_order_relaxed); }
+
+  /*! Start the flusher thread */
+  PlusStatus Start();
+
+  /*! Stop the flusher thread and write all queued records */
+  void Stop();
+
+  bool IsRunning() const { return this->FlusherThread.joinable(); }
+
+  /*!
+    Queue a message of the calling thread. Lock-free, except when a thread logs its first message.
+    The strings are copied into the storage of a ring record, which is reused, so the steady state does not allocate memory.
+    The rate limit identifies call sites by the address of the file name, which is a string literal for the LOG_* macros.
+    \param droppable If false then the record is rejected instead of dropped when the ring of the thread is full
+  */
+  AddRecordResult AddRecord(int level, const char* message, const char* fileName, int lineNumber, bool droppable);
+
+  /*! Write all queued records now. Can be called from any thread, e.g., before the process exits. */
+  void Flush();
+
+  /*! Number of records that were dropped because the ring of the logging thread was full */
+  unsigned long long GetNumberOfDroppedRecords() const { return this->NumberOfDroppedRecords.load(std::memory_order_relaxed); }
+  /*! Number of records that were suppressed by the rate limit of their call site */
+  unsigned long long GetNumberOfSuppressedRecords() const { return this->NumberOfSuppressedRecords.load(std::memory_order_relaxed); }
+
+  /*! Number of call sites whose message rates are counted separately (call sites with the same hash share the limit) */
+  static const unsigned int NUMBER_OF_CALL_SITE_SLOTS = 1024;
+
+protected:
+  /*! Single producer (the logging thread), single consumer (Flush) ring of records */
+  struct ThreadRing
+  {
+    ThreadRing(size_t capacity, unsigned int threadIndex);
+    std::vector<Record> Records;
+    /*! Number of records written by the producer */
+    std::atomic<size_t> Head;
+    /*! Number of records taken by the consumer */
+    std::atomic<size_t> Tail;
+    /*! Set when the thread will not add records to the ring anymore, so it is removed when it is empty */
+    std::atomic<bool> ThreadExited;
+    unsigned int ThreadIndex;
+  };
+
+  /*! Message rate of a call site in the current second: the second in the upper bits, the number of messages in the lower 24 bits */
+  struct CallSite
+  {
+    CallSite() : State(0), NumberOfSuppressedMessages(0) {}
+    std::atomic<unsigned long long> State;
+    std::atomic<unsigned int> NumberOfSuppressedMessages;
+  };
+
+  /*! Get the ring of the calling thread, registers a new ring when the thread logs its first message */
+  ThreadRing* GetThreadRing();
+
+  /*!
+    Returns false if the call site has exceeded its message rate limit.
+    numberOfSuppressedMessages is the number of messages of the call site that were suppressed since the previous accepted message.
+  */
+  bool AcceptCallSiteMessage(const char* fileName, int lineNumber, unsigned int& numberOfSuppressedMessages);
+
+  /*! Flush periodically until Stop is called */
+  void FlushRecords();
+
+  Writer RecordWriter;
+  /*! Identifies the backend in the thread local ring cache of the threads (addresses may be reused) */
+  unsigned long long InstanceId;
+
+  size_t RingCapacity;
+  std::atomic<unsigned int> MaximumMessagesPerSecondPerCallSite;
+  CallSite CallSites[NUMBER_OF_CALL_SITE_SLOTS];
+
+  /*! Protects the list of rings */
+  std::mutex RingsMutex;
+  std::vector< std::shared_ptr<ThreadRing> > Rings;
+  unsigned int NumberOfRegisteredThreads;
+
+  /*! Held while the records are taken from the rings and written, so that records are written by one thread at a time */
+  std::recursive_mutex FlushMutex;
+  std::vector<Record> FlushedRecords;
+  unsigned long long NumberOfReportedDroppedRecords;
+
+  std::atomic<unsigned long long> NumberOfDroppedRecords;
+  std::atomic<unsigned long long> NumberOfSuppressedRecords;
+
+  std::thread FlusherThread;
+  /*! Protects the stop request and the flush period */
+  std::mutex FlusherMutex;
+  std::condition_variable FlushRequested;
+  bool StopRequested;
+  double FlushPeriodSec;
+
+private:
+  PlusAsyncLogBackend(const PlusAsyncLogBackend&);
+  void operator=(const PlusAsyncLogBackend&);
+};
+
+#endif
@@ -10,7 +10,10 @@ See License.txt for details.
 #include "PlusRevision.h"
 
 // VTK includes
+#include <vtkDataArray.h>
 #include <vtkMatrix4x4.h>
+#include <vtkPointData.h>
+#include <vtkSmartPointer.h>
 #include <vtkXMLDataElement.h>
 #include <vtksys/SystemTools.hxx>
 
@@ -46,6 +49,27 @@ std::string PlusCommon::GetPlusLibVersionString()
 }
 
 
+//----------------------------------------------------------------------------
+void PlusCommon::DetachFrameImage(igsioVideoFrame& frame)
+{
+  if (frame.GetImage() == NULL)
+  {
+    return;
+  }
+  vtkDataArray* scalars = frame.GetImage()->GetPointData()->GetScalars();
+  if (scalars == NULL || scalars->GetReferenceCount() <= 1)
+  {
+    // the pixels are only used by this frame
+    return;
+  }
+
+  vtkSmartPointer<vtkDataArray> ownScalars = vtkSmartPointer<vtkDataArray>::Take(scalars->NewInstance());
+  ownScalars->SetNumberOfComponents(scalars->GetNumberOfComponents());
+  ownScalars->SetNumberOfTuples(scalars->GetNumberOfTuples());
+  ownScalars->SetName(scalars->GetName());
+  frame.GetImage()->GetPointData()->SetScalars(ownScalars);
+}
+
 //----------------------------------------------------------------------------
 PlusStatus PlusCommon::WriteToFile(igsioTrackedFrame* frame, const std::string& filename, vtkMatrix4x4* imageToTracker)
 {
@@ -59,6 +59,13 @@ namespace PlusCommon
 
   vtkPlusCommonExport PlusStatus WriteToFile(igsioTrackedFrame* frame, const std::string& filename, vtkMatrix4x4* imageToTracker);
 
+  /*!
+    If the image pixels of the frame are shared with other frames (e.g., frames returned by vtkPlusChannel::GetTrackedFrame)
+    then allocate new pixels for the frame (the pixel values are not copied). Code that writes into the pixels of a frame
+    that it did not allocate itself has to call this first, so that the other frames are not modified.
+  */
+  vtkPlusCommonExport void DetachFrameImage(igsioVideoFrame& frame);
+
 #ifdef PLUS_USE_OpenIGTLink
   /*! Convert between ITK and IGTL scalar pixel types */
   vtkPlusCommonExport IGTLScalarPixelType GetIGTLScalarPixelTypeFromVTK(igsioCommon::VTKScalarPixelType vtkScalarPixelType);
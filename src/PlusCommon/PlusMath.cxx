@@ -11,13 +11,58 @@
 #include "vnl/vnl_sparse_matrix.h"
 #include "vnl/vnl_sparse_matrix_linear_system.h"
 #include "vnl/algo/vnl_lsqr.h"
+#include "vnl/algo/vnl_svd.h"
 #include "vnl/vnl_cross.h"
 
 #include "vtkMath.h"
 #include "vtkTransform.h"
 
+#include <atomic>
+#include <functional>
+#include <thread>
+
 #define MINIMUM_NUMBER_OF_CALIBRATION_EQUATIONS 8
 
+namespace
+{
+  // Equations are processed in this many chunks regardless of the number of threads, so the partial sums are always added in the same order
+  const size_t NUMBER_OF_EQUATION_CHUNKS = 64;
+
+  //----------------------------------------------------------------------------
+  void ProcessEquationChunks(size_t numberOfEquations, int numberOfThreads, const std::function<void(size_t, size_t, size_t)>& processChunk)
+  {
+    const size_t numberOfChunks = std::min(NUMBER_OF_EQUATION_CHUNKS, numberOfEquations);
+    std::atomic<size_t> nextChunk(0);
+    std::function<void()> processChunks = [&]()
+    {
+      for (size_t chunk = nextChunk++; chunk < numberOfChunks; chunk = nextChunk++)
+      {
+        processChunk(chunk, numberOfEquations * chunk / numberOfChunks, numberOfEquations * (chunk + 1) / numberOfChunks);
+      }
+    };
+
+    if (numberOfThreads <= 0)
+    {
+      numberOfThreads = std::max<int>(std::thread::hardware_concurrency(), 1);
+    }
+    numberOfThreads = static_cast<int>(std::min<size_t>(numberOfThreads, numberOfChunks));
+    if (numberOfThreads <= 1)
+    {
+      processChunks();
+      return;
+    }
+    std::vector<std::thread> threads;
+    for (int threadIndex = 0; threadIndex < numberOfThreads; threadIndex++)
+    {
+      threads.push_back(std::thread(std::ref(processChunks)));
+    }
+    for (std::vector<std::thread>::iterator threadIt = threads.begin(); threadIt != threads.end(); ++threadIt)
+    {
+      threadIt->join();
+    }
+  }
+}
+
 //----------------------------------------------------------------------------
 PlusMath::PlusMath()
 {
@@ -192,6 +237,156 @@ PlusStatus PlusMath::LSQRMinimize(const vnl_sparse_matrix<double>& sparseMatrixL
   return returnStatus;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus PlusMath::LSQRMinimizeDense(const std::vector<double>& aMatrix, const std::vector<double>& bVector, vnl_vector<double>& resultVector, double* mean/*=NULL*/, double* stdev/*=NULL*/, int numberOfThreads/*=0*/)
+{
+  LOG_TRACE("PlusMath::LSQRMinimizeDense");
+
+  const size_t numberOfEquations = bVector.size();
+  if (numberOfEquations == 0)
+  {
+    LOG_ERROR("LSQRMinimizeDense: b vector is empty");
+    resultVector.clear();
+    return PLUS_FAIL;
+  }
+  if (aMatrix.empty() || aMatrix.size() % numberOfEquations != 0)
+  {
+    LOG_ERROR("LSQRMinimizeDense: size of the A matrix (" << aMatrix.size() << ") is not a multiple of the number of equations (" << numberOfEquations << ")");
+    resultVector.clear();
+    return PLUS_FAIL;
+  }
+  const unsigned int numberOfUnknowns = aMatrix.size() / numberOfEquations;
+  resultVector.set_size(numberOfUnknowns);
+  resultVector.fill(0);
+
+  // char instead of bool, so that the flags of different chunks can be written concurrently
+  std::vector<char> isOutlier(numberOfEquations, 0);
+  std::vector<double> differences(numberOfEquations, 0.0);
+  size_t numberOfInliers = numberOfEquations;
+  const double thresholdMultiplier = 3.0;
+
+  bool outlierFound = true;
+  while (outlierFound)
+  {
+    if (numberOfInliers <= MINIMUM_NUMBER_OF_CALIBRATION_EQUATIONS)
+    {
+      LOG_ERROR("It was not possible calibrate! Not enough equations!");
+      return PLUS_FAIL;
+    }
+
+    // Accumulate the normal equations (A^T*A x = A^T*b) of the inliers
+    std::vector<vnl_matrix<double> > chunkNormalMatrices(NUMBER_OF_EQUATION_CHUNKS, vnl_matrix<double>(numberOfUnknowns, numberOfUnknowns, 0.0));
+    std::vector<vnl_vector<double> > chunkNormalRightSides(NUMBER_OF_EQUATION_CHUNKS, vnl_vector<double>(numberOfUnknowns, 0.0));
+    ProcessEquationChunks(numberOfEquations, numberOfThreads, [&](size_t chunk, size_t firstEquation, size_t endEquation)
+    {
+      double* normalMatrix = chunkNormalMatrices[chunk].data_block();
+      double* normalRightSide = chunkNormalRightSides[chunk].data_block();
+      for (size_t row = firstEquation; row < endEquation; ++row)
+      {
+        if (isOutlier[row])
+        {
+          continue;
+        }
+        const double* coefficients = &aMatrix[row * numberOfUnknowns];
+        for (unsigned int i = 0; i < numberOfUnknowns; ++i)
+        {
+          // contiguous inner loop, vectorized by the compiler
+          for (unsigned int j = 0; j < numberOfUnknowns; ++j)
+          {
+            normalMatrix[i * numberOfUnknowns + j] += coefficients[i] * coefficients[j];
+          }
+          normalRightSide[i] += coefficients[i] * bVector[row];
+        }
+      }
+    });
+    vnl_matrix<double> normalMatrix(numberOfUnknowns, numberOfUnknowns, 0.0);
+    vnl_vector<double> normalRightSide(numberOfUnknowns, 0.0);
+    for (size_t chunk = 0; chunk < NUMBER_OF_EQUATION_CHUNKS; ++chunk)
+    {
+      normalMatrix += chunkNormalMatrices[chunk];
+      normalRightSide += chunkNormalRightSides[chunk];
+    }
+
+    vnl_svd<double> svd(normalMatrix);
+    if (svd.sigma_min() <= 1e-12 * svd.sigma_max())
+    {
+      LOG_ERROR("LSQRMinimizeDense: the linear equations are ill-conditioned");
+      return PLUS_FAIL;
+    }
+    resultVector = svd.solve(normalRightSide);
+
+    // Residuals (Ax - b) of the inliers, their mean and standard deviation
+    std::vector<double> chunkSums(NUMBER_OF_EQUATION_CHUNKS, 0.0);
+    ProcessEquationChunks(numberOfEquations, numberOfThreads, [&](size_t chunk, size_t firstEquation, size_t endEquation)
+    {
+      for (size_t row = firstEquation; row < endEquation; ++row)
+      {
+        if (isOutlier[row])
+        {
+          continue;
+        }
+        const double* coefficients = &aMatrix[row * numberOfUnknowns];
+        double difference = -bVector[row];
+        for (unsigned int i = 0; i < numberOfUnknowns; ++i)
+        {
+          difference += coefficients[i] * resultVector[i];
+        }
+        differences[row] = difference;
+        chunkSums[chunk] += difference;
+      }
+    });
+    double sumOfDifferences = 0.0;
+    for (size_t chunk = 0; chunk < NUMBER_OF_EQUATION_CHUNKS; ++chunk)
+    {
+      sumOfDifferences += chunkSums[chunk];
+    }
+    const double meanDifference = sumOfDifferences / numberOfInliers;
+
+    std::vector<double> chunkSquaredSums(NUMBER_OF_EQUATION_CHUNKS, 0.0);
+    ProcessEquationChunks(numberOfEquations, numberOfThreads, [&](size_t chunk, size_t firstEquation, size_t endEquation)
+    {
+      for (size_t row = firstEquation; row < endEquation; ++row)
+      {
+        if (!isOutlier[row])
+        {
+          chunkSquaredSums[chunk] += (differences[row] - meanDifference) * (differences[row] - meanDifference);
+        }
+      }
+    });
+    double sumOfSquaredDifferencesFromMean = 0.0;
+    for (size_t chunk = 0; chunk < NUMBER_OF_EQUATION_CHUNKS; ++chunk)
+    {
+      sumOfSquaredDifferencesFromMean += chunkSquaredSums[chunk];
+    }
+    const double stdevDifference = sqrt(sumOfSquaredDifferencesFromMean / numberOfInliers);
+
+    LOG_DEBUG("Mean = " << std::fixed << meanDifference << "   Stdev = " << stdevDifference);
+    if (mean != NULL)
+    {
+      *mean = meanDifference;
+    }
+    if (stdev != NULL)
+    {
+      *stdev = stdevDifference;
+    }
+
+    // Remove the equations that are further than thresholdMultiplier * stdev from the mean
+    outlierFound = false;
+    for (size_t row = 0; row < numberOfEquations; ++row)
+    {
+      if (!isOutlier[row] && fabs(differences[row] - meanDifference) >= thresholdMultiplier * stdevDifference)
+      {
+        LOG_DEBUG("Outlier: " << std::fixed << differences[row] << "(mean: " << meanDifference << "  stdev: " << stdevDifference << "  outlierTreshold: " << thresholdMultiplier * stdevDifference << ")");
+        isOutlier[row] = 1;
+        --numberOfInliers;
+        outlierFound = true;
+      }
+    }
+  }
+
+  return PLUS_SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus PlusMath::RemoveOutliersFromLSQR(vnl_sparse_matrix<double>& sparseMatrixLeftSide,
     vnl_vector<double>& vectorRightSide,
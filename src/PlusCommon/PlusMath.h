@@ -67,6 +67,18 @@ public:
     \param resultVector to store the results
   */
   static PlusStatus LSQRMinimize(const vnl_sparse_matrix<double> &sparseMatrixLeftSide, const vnl_vector<double> &vectorRightSide, vnl_vector<double> &resultVector, double* mean = NULL, double* stdev = NULL, vnl_vector<unsigned int>* notOutliersIndices=NULL); 
+  /*!
+    Solve Ax = b dense linear equations with few unknowns with the same outlier removal as LSQRMinimize, using the normal equations.
+    The normal equations and the residuals are accumulated on multiple threads in a fixed number of chunks of equations,
+    so the result does not depend on the number of threads. Much faster than LSQRMinimize for many equations.
+    \param aMatrix The coefficient matrix of size m-by-n, stored row by row.
+    \param bVector Column vector of length m.
+    \param resultVector to store the results
+    \param mean Pointer to get the resulting mean of the fit error
+    \param stdev Pointer to get the resulting standard deviation of the fit error
+    \param numberOfThreads Number of threads, if 0 then the number of processors is used
+  */
+  static PlusStatus LSQRMinimizeDense(const std::vector<double> &aMatrix, const std::vector<double> &bVector, vnl_vector<double> &resultVector, double* mean = NULL, double* stdev = NULL, int numberOfThreads = 0);
 
   /*! Convert matrix between VTK and VNL */
   static void ConvertVnlMatrixToVtkMatrix(const vnl_matrix_fixed<double,4,4>& inVnlMatrix, vtkMatrix4x4* outVtkMatrix); 
@@ -0,0 +1,234 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusOpenCL.h"
+
+#include <algorithm>
+
+//----------------------------------------------------------------------------
+PlusOpenCL::PlusOpenCL(const std::string& purpose)
+  : Purpose(purpose)
+  , Device(NULL)
+  , Context(NULL)
+  , Queue(NULL)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusOpenCL::~PlusOpenCL()
+{
+  this->ReleaseCommandQueue();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusOpenCL::CheckError(cl_int error, const char* operation) const
+{
+  if (error != CL_SUCCESS)
+  {
+    LOG_ERROR("OpenCL " << this->Purpose << " failed: " << operation << " returned error code " << error);
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusOpenCL::ReserveBuffer(Buffer& buffer, size_t size, cl_mem_flags flags)
+{
+  if (buffer.Handle != NULL && buffer.Size >= size)
+  {
+    return PLUS_SUCCESS;
+  }
+  ReleaseBuffer(buffer);
+  cl_int error = CL_SUCCESS;
+  buffer.Handle = clCreateBuffer(this->Context, flags, std::max<size_t>(size, 1), NULL, &error);
+  if (this->CheckError(error, "clCreateBuffer") != PLUS_SUCCESS)
+  {
+    buffer.Handle = NULL;
+    return PLUS_FAIL;
+  }
+  buffer.Size = size;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void PlusOpenCL::ReleaseBuffer(Buffer& buffer)
+{
+  if (buffer.Handle != NULL)
+  {
+    clReleaseMemObject(buffer.Handle);
+  }
+  buffer.Handle = NULL;
+  buffer.Size = 0;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusOpenCL::UploadBuffer(Buffer& buffer, const void* data, size_t size, cl_bool blocking)
+{
+  if (this->ReserveBuffer(buffer, size, CL_MEM_READ_ONLY) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  if (size == 0)
+  {
+    return PLUS_SUCCESS;
+  }
+  return this->CheckError(clEnqueueWriteBuffer(this->Queue, buffer.Handle, blocking, 0, size, data, 0, NULL, NULL), "clEnqueueWriteBuffer");
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusOpenCL::ClearBuffer(Buffer& buffer)
+{
+  if (buffer.Size == 0)
+  {
+    return PLUS_SUCCESS;
+  }
+  const cl_uint zero = 0;
+  return this->CheckError(clEnqueueFillBuffer(this->Queue, buffer.Handle, &zero, sizeof(zero), 0, buffer.Size, 0, NULL, NULL), "clEnqueueFillBuffer");
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusOpenCL::RunKernel(cl_kernel kernel, cl_uint dimensions, const size_t* globalWorkSize, const char* kernelName)
+{
+  for (cl_uint i = 0; i < dimensions; i++)
+  {
+    if (globalWorkSize[i] == 0)
+    {
+      // nothing to compute
+      return PLUS_SUCCESS;
+    }
+  }
+  return this->CheckError(clEnqueueNDRangeKernel(this->Queue, kernel, dimensions, NULL, globalWorkSize, NULL, 0, NULL, NULL), kernelName);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusOpenCL::BuildProgram(const char* source, const std::string& options, const char* const* kernelNames, size_t numberOfKernels, Program& program)
+{
+  ReleaseProgram(program);
+  cl_int error = CL_SUCCESS;
+  program.Handle = clCreateProgramWithSource(this->Context, 1, &source, NULL, &error);
+  if (this->CheckError(error, "clCreateProgramWithSource") != PLUS_SUCCESS)
+  {
+    program.Handle = NULL;
+    return PLUS_FAIL;
+  }
+  if (clBuildProgram(program.Handle, 1, &this->Device, options.c_str(), NULL, NULL) != CL_SUCCESS)
+  {
+    size_t logSize = 0;
+    clGetProgramBuildInfo(program.Handle, this->Device, CL_PROGRAM_BUILD_LOG, 0, NULL, &logSize);
+    std::vector<char> buildLog(logSize + 1, 0);
+    clGetProgramBuildInfo(program.Handle, this->Device, CL_PROGRAM_BUILD_LOG, logSize, &buildLog[0], NULL);
+    LOG_ERROR("OpenCL " << this->Purpose << " failed: kernels cannot be built: " << &buildLog[0]);
+    ReleaseProgram(program);
+    return PLUS_FAIL;
+  }
+  for (size_t i = 0; i < numberOfKernels; i++)
+  {
+    cl_kernel kernel = clCreateKernel(program.Handle, kernelNames[i], &error);
+    if (this->CheckError(error, kernelNames[i]) != PLUS_SUCCESS)
+    {
+      ReleaseProgram(program);
+      return PLUS_FAIL;
+    }
+    program.Kernels.push_back(kernel);
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void PlusOpenCL::ReleaseProgram(Program& program)
+{
+  for (std::vector<cl_kernel>::iterator it = program.Kernels.begin(); it != program.Kernels.end(); ++it)
+  {
+    if (*it != NULL)
+    {
+      clReleaseKernel(*it);
+    }
+  }
+  program.Kernels.clear();
+  if (program.Handle != NULL)
+  {
+    clReleaseProgram(program.Handle);
+  }
+  program.Handle = NULL;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusOpenCL::CreateCommandQueue()
+{
+  this->ReleaseCommandQueue();
+
+  cl_uint numberOfPlatforms = 0;
+  if (clGetPlatformIDs(0, NULL, &numberOfPlatforms) != CL_SUCCESS || numberOfPlatforms == 0)
+  {
+    LOG_ERROR("OpenCL " << this->Purpose << " is not available: no OpenCL platform is found");
+    return PLUS_FAIL;
+  }
+  std::vector<cl_platform_id> platforms(numberOfPlatforms);
+  clGetPlatformIDs(numberOfPlatforms, &platforms[0], NULL);
+
+  // Prefer GPU devices, but accept any device (e.g., a CPU OpenCL implementation)
+  cl_device_id selectedDevice = NULL;
+  const cl_device_type deviceTypes[2] = { CL_DEVICE_TYPE_GPU, CL_DEVICE_TYPE_ALL };
+  for (int typeIndex = 0; typeIndex < 2 && selectedDevice == NULL; typeIndex++)
+  {
+    for (cl_uint i = 0; i < numberOfPlatforms && selectedDevice == NULL; i++)
+    {
+      cl_uint numberOfDevices = 0;
+      if (clGetDeviceIDs(platforms[i], deviceTypes[typeIndex], 1, &selectedDevice, &numberOfDevices) != CL_SUCCESS || numberOfDevices == 0)
+      {
+        selectedDevice = NULL;
+      }
+    }
+  }
+  if (selectedDevice == NULL)
+  {
+    LOG_ERROR("OpenCL " << this->Purpose << " is not available: no OpenCL device is found");
+    return PLUS_FAIL;
+  }
+
+  cl_int error = CL_SUCCESS;
+  cl_context createdContext = clCreateContext(NULL, 1, &selectedDevice, NULL, NULL, &error);
+  if (error != CL_SUCCESS)
+  {
+    LOG_ERROR("OpenCL " << this->Purpose << " failed: clCreateContext returned error code " << error);
+    return PLUS_FAIL;
+  }
+  cl_command_queue createdQueue = clCreateCommandQueue(createdContext, selectedDevice, 0, &error);
+  if (error != CL_SUCCESS)
+  {
+    LOG_ERROR("OpenCL " << this->Purpose << " failed: clCreateCommandQueue returned error code " << error);
+    clReleaseContext(createdContext);
+    return PLUS_FAIL;
+  }
+
+  char name[256] = { 0 };
+  clGetDeviceInfo(selectedDevice, CL_DEVICE_NAME, sizeof(name) - 1, name, NULL);
+  LOG_INFO("OpenCL " << this->Purpose << " device: " << name);
+
+  this->Device = selectedDevice;
+  this->Context = createdContext;
+  this->Queue = createdQueue;
+  this->DeviceName = name;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void PlusOpenCL::ReleaseCommandQueue()
+{
+  if (this->Queue != NULL)
+  {
+    clReleaseCommandQueue(this->Queue);
+    this->Queue = NULL;
+  }
+  if (this->Context != NULL)
+  {
+    clReleaseContext(this->Context);
+    this->Context = NULL;
+  }
+  this->Device = NULL;
+  this->DeviceName.clear();
+}
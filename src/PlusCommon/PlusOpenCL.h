@@ -0,0 +1,130 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusOpenCL_h
+#define __PlusOpenCL_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusCommonExport.h"
+
+#define CL_TARGET_OPENCL_VERSION 120
+#if defined(__APPLE__)
+  #include <OpenCL/cl.h>
+#else
+  #include <CL/cl.h>
+#endif
+
+#include <string>
+#include <vector>
+
+/*!
+  \class PlusOpenCL
+  \brief Device, command queue, buffer and program handling shared by the OpenCL backends (RF processing, volume reconstruction, ultrasound simulation)
+
+  The internal class of each backend is derived from this class. Errors of OpenCL calls are logged with the purpose of the
+  backend (e.g., "OpenCL RF processing failed: clCreateBuffer returned error code -4").
+  Only available if Plus is built with PLUS_USE_OPENCL.
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport PlusOpenCL
+{
+public:
+  /*! Device buffer that is only reallocated if a larger size is needed */
+  struct Buffer
+  {
+    cl_mem Handle;
+    size_t Size;
+
+    Buffer()
+      : Handle(NULL), Size(0)
+    {
+    }
+  };
+
+  /*! Program and its kernels, in the order of the kernel names that the program is built with */
+  struct Program
+  {
+    cl_program Handle;
+    std::vector<cl_kernel> Kernels;
+
+    Program()
+      : Handle(NULL)
+    {
+    }
+  };
+
+  /*!
+    \param purpose Name of the computation that the device is used for, e.g., "RF processing", only used in log messages
+  */
+  explicit PlusOpenCL(const std::string& purpose);
+
+  /*! Releases the command queue and the context. Buffers and programs must be released by the derived class. */
+  virtual ~PlusOpenCL();
+
+  /*!
+    Select an OpenCL device (a GPU is preferred, but any device is accepted, e.g., a CPU OpenCL implementation)
+    and create a context and an in-order command queue on it.
+    If the setup fails then nothing is left allocated.
+  */
+  PlusStatus CreateCommandQueue();
+
+  /*! Release the command queue and the context, after that the device has to be set up again by CreateCommandQueue */
+  void ReleaseCommandQueue();
+
+  /*! True if the command queue is created */
+  bool IsInitialized() const { return this->Queue != NULL; }
+
+  cl_context GetContext() const { return this->Context; }
+  cl_command_queue GetQueue() const { return this->Queue; }
+  const std::string& GetDeviceName() const { return this->DeviceName; }
+
+  /*! Log an error if an OpenCL call is not successful */
+  PlusStatus CheckError(cl_int error, const char* operation) const;
+
+  /*! Allocate the buffer if it is not allocated yet or smaller than the requested size */
+  PlusStatus ReserveBuffer(Buffer& buffer, size_t size, cl_mem_flags flags);
+
+  /*! Release the buffer (if it is allocated) */
+  static void ReleaseBuffer(Buffer& buffer);
+
+  /*! Reserve a read-only buffer and enqueue the upload of the data. If not blocking then the data must not be modified until the queue is finished. */
+  PlusStatus UploadBuffer(Buffer& buffer, const void* data, size_t size, cl_bool blocking);
+
+  /*! Enqueue filling the whole buffer with zeros */
+  PlusStatus ClearBuffer(Buffer& buffer);
+
+  /*! Enqueue the kernel. Nothing is enqueued if the work size is 0 in any dimension. */
+  PlusStatus RunKernel(cl_kernel kernel, cl_uint dimensions, const size_t* globalWorkSize, const char* kernelName);
+
+  /*!
+    Build the program from source and create its kernels. The build log is logged if the build fails.
+    If any step fails then nothing is left allocated.
+  */
+  PlusStatus BuildProgram(const char* source, const std::string& options, const char* const* kernelNames, size_t numberOfKernels, Program& program);
+
+  /*! Release the kernels and the program (also the ones that are created by a failed BuildProgram) */
+  static void ReleaseProgram(Program& program);
+
+  /*! Helper for setting kernel arguments of any type */
+  template<typename ArgumentType>
+  static cl_int SetKernelArg(cl_kernel kernel, cl_uint index, const ArgumentType& value)
+  {
+    return clSetKernelArg(kernel, index, sizeof(ArgumentType), &value);
+  }
+
+protected:
+  std::string Purpose;
+  cl_device_id Device;
+  cl_context Context;
+  cl_command_queue Queue;
+  std::string DeviceName;
+
+private:
+  PlusOpenCL(const PlusOpenCL&);
+  void operator=(const PlusOpenCL&);
+};
+
+#endif
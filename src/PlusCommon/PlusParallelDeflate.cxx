@@ -0,0 +1,339 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusParallelDeflate.h"
+
+#include <vtk_zlib.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  /*!
+    Compress a chunk, which consists of a sequence of segment pieces, into a raw deflate stream that ends with a sync flush
+    (byte-aligned, not final block), so the compressed chunks can be concatenated into a single deflate stream.
+    The checksum of the uncompressed chunk is computed, too.
+  */
+  bool CompressChunk(const std::vector<PlusParallelDeflate::DataSegment>& pieces, int compressionLevel, bool gzipFormat,
+                     std::vector<unsigned char>& output, uLong& checksum)
+  {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, compressionLevel, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+      return false;
+    }
+    size_t numberOfBytes = 0;
+    for (std::vector<PlusParallelDeflate::DataSegment>::const_iterator pieceIt = pieces.begin(); pieceIt != pieces.end(); ++pieceIt)
+    {
+      numberOfBytes += pieceIt->NumberOfBytes;
+    }
+    output.resize(deflateBound(&stream, static_cast<uLong>(numberOfBytes)) + 16);
+    stream.next_out = &output[0];
+    stream.avail_out = static_cast<uInt>(output.size());
+    checksum = (gzipFormat ? crc32(0L, Z_NULL, 0) : adler32(0L, Z_NULL, 0));
+
+    bool success = true;
+    for (size_t pieceIndex = 0; pieceIndex < pieces.size() && success; ++pieceIndex)
+    {
+      const PlusParallelDeflate::DataSegment& piece = pieces[pieceIndex];
+      checksum = (gzipFormat ? crc32(checksum, piece.Data, static_cast<uInt>(piece.NumberOfBytes))
+                  : adler32(checksum, piece.Data, static_cast<uInt>(piece.NumberOfBytes)));
+      stream.next_in = const_cast<Bytef*>(piece.Data);
+      stream.avail_in = static_cast<uInt>(piece.NumberOfBytes);
+      const bool lastPiece = (pieceIndex == pieces.size() - 1);
+      const int flush = (lastPiece ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+      for (;;)
+      {
+        int result = deflate(&stream, flush);
+        if (result == Z_STREAM_ERROR)
+        {
+          success = false;
+          break;
+        }
+        // All input is consumed and, after a flush, all output is written when there is space left in the output buffer
+        if (stream.avail_in == 0 && stream.avail_out != 0)
+        {
+          break;
+        }
+        // Output buffer is full
+        size_t usedBytes = output.size() - stream.avail_out;
+        output.resize(output.size() * 2);
+        stream.next_out = &output[usedBytes];
+        stream.avail_out = static_cast<uInt>(output.size() - usedBytes);
+      }
+    }
+    output.resize(stream.total_out);
+    deflateEnd(&stream);
+    return success;
+  }
+
+  //----------------------------------------------------------------------------
+  struct CompressedChunk
+  {
+    CompressedChunk() : Checksum(0), NumberOfBytes(0), Ready(false), Success(false) {}
+    std::vector<unsigned char> Data;
+    uLong Checksum;
+    size_t NumberOfBytes;
+    bool Ready;
+    bool Success;
+  };
+
+  //----------------------------------------------------------------------------
+  void WriteBigEndian32(std::ostream& output, uLong value)
+  {
+    unsigned char bytes[4] = { static_cast<unsigned char>(value >> 24), static_cast<unsigned char>(value >> 16), static_cast<unsigned char>(value >> 8), static_cast<unsigned char>(value) };
+    output.write(reinterpret_cast<char*>(bytes), 4);
+  }
+
+  //----------------------------------------------------------------------------
+  void WriteLittleEndian32(std::ostream& output, uLong value)
+  {
+    unsigned char bytes[4] = { static_cast<unsigned char>(value), static_cast<unsigned char>(value >> 8), static_cast<unsigned char>(value >> 16), static_cast<unsigned char>(value >> 24) };
+    output.write(reinterpret_cast<char*>(bytes), 4);
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusParallelDeflate::PlusParallelDeflate()
+  : CompressionLevel(-1)
+  , NumberOfThreads(0)
+  , ChunkSizeBytes(1024 * 1024)
+  , Output(NULL)
+  , Format(FORMAT_ZLIB)
+  , Checksum(0)
+  , CompressedSizeBytes(0)
+  , UncompressedSizeBytes(0)
+{
+}
+
+//----------------------------------------------------------------------------
+void PlusParallelDeflate::SetCompressionLevel(int compressionLevel)
+{
+  this->CompressionLevel = std::min(std::max(compressionLevel, -1), 9);
+}
+
+//----------------------------------------------------------------------------
+void PlusParallelDeflate::SetNumberOfThreads(int numberOfThreads)
+{
+  this->NumberOfThreads = std::max(numberOfThreads, 0);
+}
+
+//----------------------------------------------------------------------------
+void PlusParallelDeflate::SetChunkSizeBytes(size_t chunkSizeBytes)
+{
+  // Small chunks would make the compression ratio worse because each chunk starts with an empty history
+  this->ChunkSizeBytes = std::max<size_t>(chunkSizeBytes, 65536);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusParallelDeflate::Start(std::ostream& output, StreamFormat format)
+{
+  this->Output = &output;
+  this->Format = format;
+  if (format == FORMAT_GZIP)
+  {
+    // Gzip member header: deflate method, no flags, no modification time, unknown OS
+    const unsigned char gzipHeader[10] = { 0x1f, 0x8b, 0x08, 0, 0, 0, 0, 0, 0, 0xff };
+    output.write(reinterpret_cast<const char*>(gzipHeader), sizeof(gzipHeader));
+    this->CompressedSizeBytes = sizeof(gzipHeader);
+    this->Checksum = crc32(0L, Z_NULL, 0);
+  }
+  else
+  {
+    // Zlib header: deflate method with 32KB window, default compression level
+    const unsigned char zlibHeader[2] = { 0x78, 0x9c };
+    output.write(reinterpret_cast<const char*>(zlibHeader), sizeof(zlibHeader));
+    this->CompressedSizeBytes = sizeof(zlibHeader);
+    this->Checksum = adler32(0L, Z_NULL, 0);
+  }
+  this->UncompressedSizeBytes = 0;
+  return output.good() ? PLUS_SUCCESS : PLUS_FAIL;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusParallelDeflate::Write(const unsigned char* data, size_t numberOfBytes)
+{
+  std::vector<DataSegment> segments(1);
+  segments[0].Data = data;
+  segments[0].NumberOfBytes = numberOfBytes;
+  return this->Write(segments);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusParallelDeflate::Write(const std::vector<DataSegment>& segments)
+{
+  if (this->Output == NULL)
+  {
+    LOG_ERROR("PlusParallelDeflate::Write: the stream is not started");
+    return PLUS_FAIL;
+  }
+
+  // Split the segments into chunks of ChunkSizeBytes, a chunk may contain pieces of multiple segments
+  std::vector< std::vector<DataSegment> > chunkPieces;
+  size_t chunkBytes = 0;
+  for (std::vector<DataSegment>::const_iterator segmentIt = segments.begin(); segmentIt != segments.end(); ++segmentIt)
+  {
+    size_t segmentOffset = 0;
+    while (segmentOffset < segmentIt->NumberOfBytes)
+    {
+      if (chunkPieces.empty() || chunkBytes >= this->ChunkSizeBytes)
+      {
+        chunkPieces.push_back(std::vector<DataSegment>());
+        chunkBytes = 0;
+      }
+      DataSegment piece;
+      piece.Data = segmentIt->Data + segmentOffset;
+      piece.NumberOfBytes = std::min(segmentIt->NumberOfBytes - segmentOffset, this->ChunkSizeBytes - chunkBytes);
+      chunkPieces.back().push_back(piece);
+      chunkBytes += piece.NumberOfBytes;
+      segmentOffset += piece.NumberOfBytes;
+    }
+  }
+  const size_t numberOfChunks = chunkPieces.size();
+  if (numberOfChunks == 0)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  int numberOfThreads = this->NumberOfThreads;
+  if (numberOfThreads <= 0)
+  {
+    numberOfThreads = std::max<int>(std::thread::hardware_concurrency(), 1);
+  }
+  numberOfThreads = static_cast<int>(std::min<size_t>(numberOfThreads, numberOfChunks));
+  const size_t maxNumberOfChunksInMemory = 2 * numberOfThreads;
+  const bool gzipFormat = (this->Format == FORMAT_GZIP);
+  const int compressionLevel = this->CompressionLevel;
+  std::vector<CompressedChunk> chunks(numberOfChunks);
+  std::mutex chunkMutex;
+  std::condition_variable chunkCondition;
+  size_t nextChunkToCompress = 0;
+  size_t nextChunkToWrite = 0;
+  bool aborted = false;
+
+  std::function<void()> compressChunks = [&]()
+  {
+    for (;;)
+    {
+      size_t chunkIndex = 0;
+      {
+        std::unique_lock<std::mutex> lock(chunkMutex);
+        chunkCondition.wait(lock, [&]() { return aborted || nextChunkToCompress >= numberOfChunks || nextChunkToCompress < nextChunkToWrite + maxNumberOfChunksInMemory; });
+        if (aborted || nextChunkToCompress >= numberOfChunks)
+        {
+          return;
+        }
+        chunkIndex = nextChunkToCompress++;
+      }
+      CompressedChunk chunk;
+      chunk.Success = CompressChunk(chunkPieces[chunkIndex], compressionLevel, gzipFormat, chunk.Data, chunk.Checksum);
+      for (std::vector<DataSegment>::const_iterator pieceIt = chunkPieces[chunkIndex].begin(); pieceIt != chunkPieces[chunkIndex].end(); ++pieceIt)
+      {
+        chunk.NumberOfBytes += pieceIt->NumberOfBytes;
+      }
+      chunk.Ready = true;
+      {
+        std::lock_guard<std::mutex> lock(chunkMutex);
+        std::swap(chunks[chunkIndex], chunk);
+      }
+      chunkCondition.notify_all();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int threadIndex = 0; threadIndex < numberOfThreads; threadIndex++)
+  {
+    threads.push_back(std::thread(std::ref(compressChunks)));
+  }
+
+  // Compressed chunks are written in order by the calling thread
+  PlusStatus status = PLUS_SUCCESS;
+  for (size_t chunkIndex = 0; chunkIndex < numberOfChunks; ++chunkIndex)
+  {
+    CompressedChunk chunk;
+    {
+      std::unique_lock<std::mutex> lock(chunkMutex);
+      chunkCondition.wait(lock, [&]() { return chunks[chunkIndex].Ready; });
+      std::swap(chunks[chunkIndex], chunk);
+    }
+    if (!chunk.Success)
+    {
+      LOG_ERROR("PlusParallelDeflate::Write: failed to compress data");
+      status = PLUS_FAIL;
+    }
+    else
+    {
+      this->Checksum = (gzipFormat ? crc32_combine(this->Checksum, chunk.Checksum, chunk.NumberOfBytes)
+                        : adler32_combine(this->Checksum, chunk.Checksum, chunk.NumberOfBytes));
+      if (!chunk.Data.empty())
+      {
+        this->Output->write(reinterpret_cast<const char*>(&chunk.Data[0]), chunk.Data.size());
+      }
+      this->CompressedSizeBytes += chunk.Data.size();
+      this->UncompressedSizeBytes += chunk.NumberOfBytes;
+      if (!this->Output->good())
+      {
+        LOG_ERROR("PlusParallelDeflate::Write: failed to write compressed data");
+        status = PLUS_FAIL;
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock(chunkMutex);
+      nextChunkToWrite = chunkIndex + 1;
+      if (status != PLUS_SUCCESS)
+      {
+        aborted = true;
+      }
+    }
+    chunkCondition.notify_all();
+    if (status != PLUS_SUCCESS)
+    {
+      break;
+    }
+  }
+
+  for (std::vector<std::thread>::iterator threadIt = threads.begin(); threadIt != threads.end(); ++threadIt)
+  {
+    threadIt->join();
+  }
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusParallelDeflate::Finish()
+{
+  if (this->Output == NULL)
+  {
+    LOG_ERROR("PlusParallelDeflate::Finish: the stream is not started");
+    return PLUS_FAIL;
+  }
+
+  // Empty final block with fixed Huffman codes terminates the deflate stream
+  const unsigned char finalBlock[2] = { 0x03, 0x00 };
+  this->Output->write(reinterpret_cast<const char*>(finalBlock), sizeof(finalBlock));
+  this->CompressedSizeBytes += sizeof(finalBlock);
+  if (this->Format == FORMAT_GZIP)
+  {
+    WriteLittleEndian32(*this->Output, this->Checksum);
+    WriteLittleEndian32(*this->Output, static_cast<uLong>(this->UncompressedSizeBytes & 0xffffffff));
+    this->CompressedSizeBytes += 8;
+  }
+  else
+  {
+    WriteBigEndian32(*this->Output, this->Checksum);
+    this->CompressedSizeBytes += 4;
+  }
+  bool success = this->Output->good();
+  this->Output = NULL;
+  return success ? PLUS_SUCCESS : PLUS_FAIL;
+}
@@ -0,0 +1,87 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PLUSPARALLELDEFLATE_H
+#define __PLUSPARALLELDEFLATE_H
+
+#include "PlusConfigure.h"
+#include "vtkPlusCommonExport.h"
+
+#include <ostream>
+#include <vector>
+
+/*!
+  \class PlusParallelDeflate
+  \brief Compresses data into a zlib or gzip stream on multiple threads
+
+  The data is split into chunks that are deflate-compressed in parallel. Each chunk is terminated by a sync flush
+  (byte-aligned, not final block), so the compressed chunks are concatenated into a single standard deflate stream
+  that Finish terminates by an empty final block and the combined checksum. Any zlib or gzip decoder can read it.
+
+  Data can be written by multiple Write calls (for example frame by frame), the compressed chunks of each call are written
+  to the output in order before Write returns. At most 2 chunks per thread are kept in memory.
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport PlusParallelDeflate
+{
+public:
+  enum StreamFormat
+  {
+    FORMAT_ZLIB,
+    FORMAT_GZIP
+  };
+
+  /*! Contiguous piece of the data to compress. Chunks may span multiple segments. */
+  struct DataSegment
+  {
+    const unsigned char* Data;
+    size_t NumberOfBytes;
+  };
+
+  PlusParallelDeflate();
+
+  /*! zlib compression level (1 = fastest, 9 = smallest), -1 means the zlib default */
+  void SetCompressionLevel(int compressionLevel);
+  int GetCompressionLevel() const { return this->CompressionLevel; }
+
+  /*! Number of threads that compress the chunks. If 0 then the number of processors is used. */
+  void SetNumberOfThreads(int numberOfThreads);
+  int GetNumberOfThreads() const { return this->NumberOfThreads; }
+
+  /*! Size of the uncompressed chunks, in bytes */
+  void SetChunkSizeBytes(size_t chunkSizeBytes);
+  size_t GetChunkSizeBytes() const { return this->ChunkSizeBytes; }
+
+  /*! Write the stream header to the output. The output must remain valid until Finish is called. */
+  PlusStatus Start(std::ostream& output, StreamFormat format);
+
+  /*! Compress the data and write it to the output */
+  PlusStatus Write(const unsigned char* data, size_t numberOfBytes);
+  PlusStatus Write(const std::vector<DataSegment>& segments);
+
+  /*! Terminate the deflate stream and write the checksum */
+  PlusStatus Finish();
+
+  /*! Number of bytes written to the output since Start, including the stream header and trailer */
+  unsigned long long GetCompressedSizeBytes() const { return this->CompressedSizeBytes; }
+
+  /*! Number of bytes compressed since Start */
+  unsigned long long GetUncompressedSizeBytes() const { return this->UncompressedSizeBytes; }
+
+protected:
+  int CompressionLevel;
+  int NumberOfThreads;
+  size_t ChunkSizeBytes;
+
+  std::ostream* Output;
+  StreamFormat Format;
+  unsigned long Checksum;
+  unsigned long long CompressedSizeBytes;
+  unsigned long long UncompressedSizeBytes;
+};
+
+#endif
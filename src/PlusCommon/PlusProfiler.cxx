@@ -0,0 +1,224 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusProfiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  std::string EscapeJsonString(const std::string& str)
+  {
+    std::string escaped;
+    for (std::string::const_iterator it = str.begin(); it != str.end(); ++it)
+    {
+      if (*it == '"' || *it == '\\')
+      {
+        escaped += '\\';
+      }
+      if (static_cast<unsigned char>(*it) < 0x20)
+      {
+        // control characters are not expected in names
+        escaped += ' ';
+        continue;
+      }
+      escaped += *it;
+    }
+    return escaped;
+  }
+
+  const std::chrono::steady_clock::time_point PROFILER_START_TIME = std::chrono::steady_clock::now();
+}
+
+std::atomic<bool> PlusProfiler::Enabled(false);
+
+//----------------------------------------------------------------------------
+void PlusProfiler::Zone::Begin(const char* name, const std::string* detail)
+{
+  this->Name = name;
+  if (detail != NULL)
+  {
+    this->Detail = *detail;
+  }
+  this->StartTimeUs = PlusProfiler::GetInstance().GetTimeUs();
+}
+
+//----------------------------------------------------------------------------
+void PlusProfiler::Zone::End()
+{
+  PlusProfiler& profiler = PlusProfiler::GetInstance();
+  double endTimeUs = profiler.GetTimeUs();
+  ThreadBuffer& buffer = profiler.GetCurrentThreadBuffer();
+
+  ZoneRecord record;
+  record.Name = this->Name;
+  record.Detail.swap(this->Detail);
+  record.StartTimeUs = this->StartTimeUs;
+  record.DurationUs = endTimeUs - this->StartTimeUs;
+
+  std::lock_guard<std::mutex> lock(buffer.Mutex);
+  buffer.Zones.push_back(record);
+  if (buffer.Zones.size() > MAX_NUMBER_OF_ZONES_PER_THREAD)
+  {
+    buffer.Zones.pop_front();
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusProfiler& PlusProfiler::GetInstance()
+{
+  static PlusProfiler instance;
+  return instance;
+}
+
+//----------------------------------------------------------------------------
+PlusProfiler::PlusProfiler()
+{
+}
+
+//----------------------------------------------------------------------------
+PlusProfiler::~PlusProfiler()
+{
+  // Write the trace of a recording that was not stopped (e.g., the application exited while profiling)
+  if (IsEnabled())
+  {
+    this->Stop();
+  }
+}
+
+//----------------------------------------------------------------------------
+double PlusProfiler::GetTimeUs() const
+{
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - PROFILER_START_TIME).count();
+}
+
+//----------------------------------------------------------------------------
+PlusProfiler::ThreadBuffer& PlusProfiler::GetCurrentThreadBuffer()
+{
+  // The buffers are owned by the profiler, so the zones of exited threads are kept until the trace is written
+  thread_local ThreadBuffer* currentThreadBuffer = NULL;
+  if (currentThreadBuffer == NULL)
+  {
+    std::shared_ptr<ThreadBuffer> buffer = std::make_shared<ThreadBuffer>();
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    buffer->ThreadIndex = static_cast<unsigned int>(this->ThreadBuffers.size());
+    this->ThreadBuffers.push_back(buffer);
+    currentThreadBuffer = buffer.get();
+  }
+  return *currentThreadBuffer;
+}
+
+//----------------------------------------------------------------------------
+void PlusProfiler::SetCurrentThreadName(const std::string& name)
+{
+  ThreadBuffer& buffer = this->GetCurrentThreadBuffer();
+  std::lock_guard<std::mutex> lock(buffer.Mutex);
+  buffer.Name = name;
+}
+
+//----------------------------------------------------------------------------
+void PlusProfiler::Start(const std::string& traceFilename /*= ""*/)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  for (std::vector<std::shared_ptr<ThreadBuffer> >::iterator bufferIt = this->ThreadBuffers.begin(); bufferIt != this->ThreadBuffers.end(); ++bufferIt)
+  {
+    std::lock_guard<std::mutex> bufferLock((*bufferIt)->Mutex);
+    (*bufferIt)->Zones.clear();
+  }
+  this->TraceFilename = traceFilename;
+  Enabled.store(true);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusProfiler::Stop()
+{
+  Enabled.store(false);
+  std::string traceFilename;
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    traceFilename = this->TraceFilename;
+  }
+  if (traceFilename.empty())
+  {
+    return PLUS_SUCCESS;
+  }
+  return this->WriteChromeTrace(traceFilename);
+}
+
+//----------------------------------------------------------------------------
+size_t PlusProfiler::GetNumberOfRecordedZones()
+{
+  size_t numberOfZones = 0;
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  for (std::vector<std::shared_ptr<ThreadBuffer> >::iterator bufferIt = this->ThreadBuffers.begin(); bufferIt != this->ThreadBuffers.end(); ++bufferIt)
+  {
+    std::lock_guard<std::mutex> bufferLock((*bufferIt)->Mutex);
+    numberOfZones += (*bufferIt)->Zones.size();
+  }
+  return numberOfZones;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusProfiler::WriteChromeTrace(const std::string& filename)
+{
+  std::ofstream traceFile(filename.c_str(), std::ios::out | std::ios::trunc);
+  if (!traceFile.is_open())
+  {
+    return PLUS_FAIL;
+  }
+
+  traceFile << "{\"traceEvents\":[" << std::endl;
+  bool firstEvent = true;
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  for (std::vector<std::shared_ptr<ThreadBuffer> >::iterator bufferIt = this->ThreadBuffers.begin(); bufferIt != this->ThreadBuffers.end(); ++bufferIt)
+  {
+    // Copy the zones, so the thread is not blocked while the file is written
+    std::deque<ZoneRecord> zones;
+    std::string threadName;
+    {
+      std::lock_guard<std::mutex> bufferLock((*bufferIt)->Mutex);
+      zones = (*bufferIt)->Zones;
+      threadName = (*bufferIt)->Name;
+    }
+    if (zones.empty())
+    {
+      continue;
+    }
+    unsigned int threadIndex = (*bufferIt)->ThreadIndex;
+    if (threadName.empty())
+    {
+      std::ostringstream defaultName;
+      defaultName << "Thread " << threadIndex;
+      threadName = defaultName.str();
+    }
+
+    traceFile << (firstEvent ? "" : ",\n")
+              << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << threadIndex
+              << ",\"args\":{\"name\":\"" << EscapeJsonString(threadName) << "\"}}";
+    firstEvent = false;
+
+    traceFile << std::fixed << std::setprecision(3);
+    for (std::deque<ZoneRecord>::const_iterator zoneIt = zones.begin(); zoneIt != zones.end(); ++zoneIt)
+    {
+      traceFile << ",\n{\"name\":\"" << EscapeJsonString(zoneIt->Name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << threadIndex
+                << ",\"ts\":" << zoneIt->StartTimeUs << ",\"dur\":" << zoneIt->DurationUs;
+      if (!zoneIt->Detail.empty())
+      {
+        traceFile << ",\"args\":{\"detail\":\"" << EscapeJsonString(zoneIt->Detail) << "\"}";
+      }
+      traceFile << "}";
+    }
+    traceFile.unsetf(std::ios_base::floatfield);
+  }
+  traceFile << std::endl << "]}" << std::endl;
+
+  return traceFile.good() ? PLUS_SUCCESS : PLUS_FAIL;
+}
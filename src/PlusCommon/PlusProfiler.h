@@ -0,0 +1,181 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusProfiler_h
+#define __PlusProfiler_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusCommonExport.h"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef PLUS_USE_TRACY
+#include <tracy/Tracy.hpp>
+#endif
+
+/*!
+  \class PlusProfiler
+  \brief Records profiling zones of the hot functions of all Plus modules and saves them in Chrome trace event format
+
+  Zones are added by the PLUS_PROFILE_SCOPE and PLUS_PROFILE_SCOPE_DETAIL macros. Each thread records its zones into its
+  own buffer, so threads do not block each other while profiling. The threads are named by PLUS_PROFILE_THREAD_NAME
+  (acquisition threads are named after the device ID), the names are shown as track names in the trace, which can be
+  opened in chrome://tracing or https://ui.perfetto.dev.
+
+  Recording is disabled by default and it is enabled at run time by the ProfilingTraceFile attribute of the application
+  configuration file (or by calling Start), so a live setup can be profiled without a custom build. When recording is
+  disabled, each zone only checks an atomic flag. The macros are compiled only if PLUS_USE_PROFILING is enabled.
+
+  If PLUS_USE_TRACY is enabled then the macros emit Tracy zones and thread names as well, which are streamed to a
+  connected Tracy profiler independently of the Chrome trace recording.
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport PlusProfiler
+{
+public:
+  /*! Records a zone from its construction until its destruction */
+  class vtkPlusCommonExport Zone
+  {
+  public:
+    /*! \param name Name of the zone, it must be a string literal (or otherwise not freed before the trace is written) */
+    Zone(const char* name)
+      : Name(NULL)
+    {
+      if (PlusProfiler::IsEnabled())
+      {
+        this->Begin(name, NULL);
+      }
+    }
+    /*! \param detail Text that is shown in the arguments of the zone (e.g., device ID), copied only if recording is enabled */
+    Zone(const char* name, const std::string& detail)
+      : Name(NULL)
+    {
+      if (PlusProfiler::IsEnabled())
+      {
+        this->Begin(name, &detail);
+      }
+    }
+    ~Zone()
+    {
+      if (this->Name != NULL)
+      {
+        this->End();
+      }
+    }
+
+  protected:
+    void Begin(const char* name, const std::string* detail);
+    void End();
+
+    const char* Name;
+    std::string Detail;
+    double StartTimeUs;
+
+  private:
+    Zone(const Zone&);
+    void operator=(const Zone&);
+  };
+
+  static PlusProfiler& GetInstance();
+
+  /*! Fast check whether zones have to be recorded */
+  static bool IsEnabled() { return Enabled.load(std::memory_order_relaxed); }
+
+  /*!
+    Remove all recorded zones and start recording.
+    \param traceFilename If not empty then the trace is written to this file when recording is stopped (also at exit)
+  */
+  void Start(const std::string& traceFilename = "");
+
+  /*! Stop recording and write the trace file that was specified in Start. Recorded zones are kept. */
+  PlusStatus Stop();
+
+  /*! Save the recorded zones in Chrome trace event JSON format */
+  PlusStatus WriteChromeTrace(const std::string& filename);
+
+  /*! Set the name of the calling thread, shown as the track name in the trace */
+  void SetCurrentThreadName(const std::string& name);
+
+  /*! Number of zones that are currently recorded (in all threads) */
+  size_t GetNumberOfRecordedZones();
+
+  /*! Maximum number of zones kept per thread, older zones are discarded */
+  static const size_t MAX_NUMBER_OF_ZONES_PER_THREAD = 200000;
+
+protected:
+  PlusProfiler();
+  virtual ~PlusProfiler();
+
+  struct ZoneRecord
+  {
+    const char* Name;
+    std::string Detail;
+    double StartTimeUs;
+    double DurationUs;
+  };
+
+  /*! Zones of a thread. The thread adds zones and the writer reads them, so the mutex is rarely contended. */
+  struct ThreadBuffer
+  {
+    ThreadBuffer() : ThreadIndex(0) {}
+    std::mutex Mutex;
+    unsigned int ThreadIndex;
+    std::string Name;
+    std::deque<ZoneRecord> Zones;
+  };
+
+  /*! Get the buffer of the calling thread, created at the first call */
+  ThreadBuffer& GetCurrentThreadBuffer();
+
+  /*! Time since the profiler was created, in microseconds */
+  double GetTimeUs() const;
+
+  static std::atomic<bool> Enabled;
+
+  /*! Protects ThreadBuffers and TraceFilename */
+  std::mutex Mutex;
+  std::vector<std::shared_ptr<ThreadBuffer> > ThreadBuffers;
+  std::string TraceFilename;
+
+private:
+  PlusProfiler(const PlusProfiler&);
+  void operator=(const PlusProfiler&);
+};
+
+#ifdef PLUS_USE_PROFILING
+#ifdef PLUS_USE_TRACY
+#define PLUS_PROFILE_SCOPE(name) \
+  ZoneScopedN(name); \
+  PlusProfiler::Zone plusProfilerZone(name)
+#define PLUS_PROFILE_SCOPE_DETAIL(name, detail) \
+  ZoneScopedN(name); \
+  const std::string& plusProfilerZoneDetail = (detail); \
+  if (ZoneIsActive) { ZoneText(plusProfilerZoneDetail.c_str(), plusProfilerZoneDetail.size()); } \
+  PlusProfiler::Zone plusProfilerZone(name, plusProfilerZoneDetail)
+#define PLUS_PROFILE_THREAD_NAME(name) \
+  { \
+    const std::string plusProfilerThreadName(name); \
+    tracy::SetThreadName(plusProfilerThreadName.c_str()); \
+    PlusProfiler::GetInstance().SetCurrentThreadName(plusProfilerThreadName); \
+  }
+#else
+#define PLUS_PROFILE_SCOPE(name) PlusProfiler::Zone plusProfilerZone(name)
+#define PLUS_PROFILE_SCOPE_DETAIL(name, detail) PlusProfiler::Zone plusProfilerZone(name, detail)
+#define PLUS_PROFILE_THREAD_NAME(name) PlusProfiler::GetInstance().SetCurrentThreadName(name)
+#endif
+#else
+#define PLUS_PROFILE_SCOPE(name)
+#define PLUS_PROFILE_SCOPE_DETAIL(name, detail)
+#define PLUS_PROFILE_THREAD_NAME(name)
+#endif
+
+#endif
@@ -0,0 +1,294 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PLUSRIGIDTRANSFORM_H
+#define __PLUSRIGIDTRANSFORM_H
+
+#include "vtkMatrix4x4.h"
+
+#include <algorithm>
+#include <cmath>
+
+/*!
+  \class PlusRigidTransform
+  \brief Rigid transform (rotation and translation) value type for pose computations
+
+  The transform is stored as a row-major 3x3 rotation matrix and a translation vector in a fixed-size array,
+  so it can be copied, composed, inverted and interpolated without allocating objects (unlike vtkMatrix4x4,
+  which is reference counted and allocated on the heap). The loops have fixed trip counts and no branches,
+  so the compiler unrolls and vectorizes them. Use vtkMatrix4x4 only where a VTK or device API requires it.
+
+  Quaternions are (w, x, y, z) unit quaternions, as in vtkMath.
+
+  \ingroup PlusLibCommon
+*/
+class PlusRigidTransform
+{
+public:
+  PlusRigidTransform()
+  {
+    this->SetIdentity();
+  }
+
+  /*! Create from a 4x4 row-major matrix, only the rotation and translation parts are used */
+  explicit PlusRigidTransform(const double matrix[16])
+  {
+    this->SetMatrixElements(matrix);
+  }
+
+  void SetIdentity()
+  {
+    for (int i = 0; i < 12; ++i)
+    {
+      this->Elements[i] = (i % 5 == 0 ? 1.0 : 0.0);
+    }
+  }
+
+  /*! Set from a 4x4 row-major matrix, only the rotation and translation parts are used */
+  void SetMatrixElements(const double matrix[16])
+  {
+    for (int i = 0; i < 12; ++i)
+    {
+      this->Elements[i] = matrix[i];
+    }
+  }
+
+  /*! Get as a 4x4 row-major matrix */
+  void GetMatrixElements(double matrix[16]) const
+  {
+    for (int i = 0; i < 12; ++i)
+    {
+      matrix[i] = this->Elements[i];
+    }
+    matrix[12] = 0.0;
+    matrix[13] = 0.0;
+    matrix[14] = 0.0;
+    matrix[15] = 1.0;
+  }
+
+  void SetVtkMatrix(const vtkMatrix4x4* matrix)
+  {
+    this->SetMatrixElements(&matrix->Element[0][0]);
+  }
+
+  void GetVtkMatrix(vtkMatrix4x4* matrix) const
+  {
+    double elements[16];
+    this->GetMatrixElements(elements);
+    matrix->DeepCopy(elements);
+  }
+
+  /*! Rotation element (row, column), row and column are 0..2 */
+  double GetRotation(int row, int column) const
+  {
+    return this->Elements[row * 4 + column];
+  }
+
+  void GetTranslation(double translation[3]) const
+  {
+    translation[0] = this->Elements[3];
+    translation[1] = this->Elements[7];
+    translation[2] = this->Elements[11];
+  }
+
+  void SetTranslation(const double translation[3])
+  {
+    this->Elements[3] = translation[0];
+    this->Elements[7] = translation[1];
+    this->Elements[11] = translation[2];
+  }
+
+  /*! Composition: (a * b) transforms a point first by b then by a, as the product of the matrices */
+  PlusRigidTransform operator*(const PlusRigidTransform& b) const
+  {
+    PlusRigidTransform result;
+    for (int row = 0; row < 3; ++row)
+    {
+      const double* aRow = this->Elements + row * 4;
+      double* resultRow = result.Elements + row * 4;
+      for (int column = 0; column < 4; ++column)
+      {
+        resultRow[column] = aRow[0] * b.Elements[column] + aRow[1] * b.Elements[4 + column] + aRow[2] * b.Elements[8 + column];
+      }
+      resultRow[3] += aRow[3];
+    }
+    return result;
+  }
+
+  /*! Inverse of the rigid transform: transposed rotation and rotated, negated translation */
+  PlusRigidTransform GetInverse() const
+  {
+    PlusRigidTransform result;
+    for (int row = 0; row < 3; ++row)
+    {
+      for (int column = 0; column < 3; ++column)
+      {
+        result.Elements[row * 4 + column] = this->Elements[column * 4 + row];
+      }
+    }
+    for (int row = 0; row < 3; ++row)
+    {
+      result.Elements[row * 4 + 3] = -(result.Elements[row * 4] * this->Elements[3] + result.Elements[row * 4 + 1] * this->Elements[7] + result.Elements[row * 4 + 2] * this->Elements[11]);
+    }
+    return result;
+  }
+
+  void TransformPoint(const double point[3], double transformedPoint[3]) const
+  {
+    double result[3];
+    for (int row = 0; row < 3; ++row)
+    {
+      const double* transformRow = this->Elements + row * 4;
+      result[row] = transformRow[0] * point[0] + transformRow[1] * point[1] + transformRow[2] * point[2] + transformRow[3];
+    }
+    transformedPoint[0] = result[0];
+    transformedPoint[1] = result[1];
+    transformedPoint[2] = result[2];
+  }
+
+  /*! Get the rotation as a unit quaternion (w, x, y, z) */
+  void GetQuaternion(double quaternion[4]) const
+  {
+    const double m00 = this->Elements[0], m01 = this->Elements[1], m02 = this->Elements[2];
+    const double m10 = this->Elements[4], m11 = this->Elements[5], m12 = this->Elements[6];
+    const double m20 = this->Elements[8], m21 = this->Elements[9], m22 = this->Elements[10];
+
+    // Use the largest diagonal element for numerical stability
+    const double trace = m00 + m11 + m22;
+    if (trace > 0)
+    {
+      double s = 2.0 * std::sqrt(trace + 1.0);
+      quaternion[0] = 0.25 * s;
+      quaternion[1] = (m21 - m12) / s;
+      quaternion[2] = (m02 - m20) / s;
+      quaternion[3] = (m10 - m01) / s;
+    }
+    else if (m00 > m11 && m00 > m22)
+    {
+      double s = 2.0 * std::sqrt(1.0 + m00 - m11 - m22);
+      quaternion[0] = (m21 - m12) / s;
+      quaternion[1] = 0.25 * s;
+      quaternion[2] = (m01 + m10) / s;
+      quaternion[3] = (m02 + m20) / s;
+    }
+    else if (m11 > m22)
+    {
+      double s = 2.0 * std::sqrt(1.0 + m11 - m00 - m22);
+      quaternion[0] = (m02 - m20) / s;
+      quaternion[1] = (m01 + m10) / s;
+      quaternion[2] = 0.25 * s;
+      quaternion[3] = (m12 + m21) / s;
+    }
+    else
+    {
+      double s = 2.0 * std::sqrt(1.0 + m22 - m00 - m11);
+      quaternion[0] = (m10 - m01) / s;
+      quaternion[1] = (m02 + m20) / s;
+      quaternion[2] = (m12 + m21) / s;
+      quaternion[3] = 0.25 * s;
+    }
+
+    double norm = std::sqrt(quaternion[0] * quaternion[0] + quaternion[1] * quaternion[1] + quaternion[2] * quaternion[2] + quaternion[3] * quaternion[3]);
+    if (norm > 0)
+    {
+      for (int i = 0; i < 4; ++i)
+      {
+        quaternion[i] /= norm;
+      }
+    }
+  }
+
+  /*! Set the rotation from a unit quaternion (w, x, y, z), the translation is not changed */
+  void SetQuaternion(const double quaternion[4])
+  {
+    const double w = quaternion[0];
+    const double x = quaternion[1];
+    const double y = quaternion[2];
+    const double z = quaternion[3];
+    this->Elements[0] = w * w + x * x - y * y - z * z;
+    this->Elements[1] = 2.0 * (x * y - w * z);
+    this->Elements[2] = 2.0 * (x * z + w * y);
+    this->Elements[4] = 2.0 * (x * y + w * z);
+    this->Elements[5] = w * w - x * x + y * y - z * z;
+    this->Elements[6] = 2.0 * (y * z - w * x);
+    this->Elements[8] = 2.0 * (x * z - w * y);
+    this->Elements[9] = 2.0 * (y * z + w * x);
+    this->Elements[10] = w * w - x * x - y * y + z * z;
+  }
+
+  /*!
+    Spherical linear interpolation of unit quaternions (w, x, y, z), the result is normalized.
+    Linear interpolation is used if the quaternions are very close (same as igsioMath::Slerp).
+    \param weightB Weight of quaternion B (0 = result is A, 1 = result is B)
+  */
+  static void Slerp(const double quaternionA[4], const double quaternionB[4], double weightB, double result[4])
+  {
+    const double SLERP_EPSILON = 1e-6;
+    double cosom = quaternionA[0] * quaternionB[0] + quaternionA[1] * quaternionB[1] + quaternionA[2] * quaternionB[2] + quaternionA[3] * quaternionB[3];
+    double sign = (cosom < 0.0 ? -1.0 : 1.0);
+    cosom = std::min(cosom * sign, 1.0);
+    bool linear = (1.0 - cosom) <= SLERP_EPSILON;
+    double omega = std::acos(cosom);
+    double sinom = (linear ? 1.0 : std::sin(omega));
+    double scale0 = (linear ? 1.0 - weightB : std::sin((1.0 - weightB) * omega) / sinom);
+    double scale1 = (linear ? weightB : std::sin(weightB * omega) / sinom) * sign;
+    double squaredNorm = 0.0;
+    for (int i = 0; i < 4; ++i)
+    {
+      result[i] = scale0 * quaternionA[i] + scale1 * quaternionB[i];
+      squaredNorm += result[i] * result[i];
+    }
+    double inverseNorm = 1.0 / std::sqrt(squaredNorm);
+    for (int i = 0; i < 4; ++i)
+    {
+      result[i] *= inverseNorm;
+    }
+  }
+
+  /*!
+    Interpolate between two rigid transforms: the rotation with SLERP and the translation linearly
+    (as vtkPlusBuffer interpolates the poses of the tools).
+    \param weightB Weight of transform B (0 = result is A, 1 = result is B)
+  */
+  static PlusRigidTransform Interpolate(const PlusRigidTransform& a, const PlusRigidTransform& b, double weightB)
+  {
+    double quaternionA[4];
+    double quaternionB[4];
+    a.GetQuaternion(quaternionA);
+    b.GetQuaternion(quaternionB);
+    double interpolatedQuaternion[4];
+    Slerp(quaternionA, quaternionB, weightB, interpolatedQuaternion);
+    PlusRigidTransform result;
+    result.SetQuaternion(interpolatedQuaternion);
+    for (int row = 0; row < 3; ++row)
+    {
+      result.Elements[row * 4 + 3] = a.Elements[row * 4 + 3] * (1.0 - weightB) + b.Elements[row * 4 + 3] * weightB;
+    }
+    return result;
+  }
+
+  /*! Angle of the rotation between the orientations of two transforms, in degrees (0..180) */
+  static double GetOrientationDifferenceDeg(const PlusRigidTransform& a, const PlusRigidTransform& b)
+  {
+    // The trace of Ra^T * Rb is the sum of the products of the corresponding rotation elements
+    double trace = 0.0;
+    for (int row = 0; row < 3; ++row)
+    {
+      for (int column = 0; column < 3; ++column)
+      {
+        trace += a.Elements[row * 4 + column] * b.Elements[row * 4 + column];
+      }
+    }
+    double cosAngle = std::max(-1.0, std::min(1.0, (trace - 1.0) / 2.0));
+    return std::acos(cosAngle) * 57.29577951308232;
+  }
+
+protected:
+  /*! First three rows of the 4x4 row-major matrix: rotation in columns 0..2, translation in column 3 */
+  double Elements[12];
+};
+
+#endif
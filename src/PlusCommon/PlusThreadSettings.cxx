@@ -0,0 +1,396 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusThreadSettings.h"
+
+#include <vtkXMLDataElement.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
+#include <sstream>
+
+#if defined(_WIN32)
+  #include <windows.h>
+  #include <avrt.h>
+#else
+  #include <pthread.h>
+  #include <sched.h>
+  #include <sys/mman.h>
+  #include <sys/resource.h>
+  #if defined(__linux__)
+    #include <sys/syscall.h>
+    #include <unistd.h>
+  #endif
+#endif
+
+namespace
+{
+  /*! Nice value of threads with high (but not real-time) priority on Linux */
+  const int HIGH_PRIORITY_NICE_VALUE = -10;
+
+#if defined(_WIN32)
+  /*! Minimum working set that is kept resident when the memory of the process is locked */
+  const SIZE_T LOCKED_MINIMUM_WORKING_SET_SIZE = 512 * 1024 * 1024;
+#endif
+
+  std::mutex LockMemoryMutex;
+  bool LockMemoryAttempted = false;
+  PlusStatus LockMemoryStatus = PLUS_FAIL;
+
+#if defined(_WIN32)
+  /*! MMCSS task of the calling thread, empty if the thread is not registered */
+  thread_local std::string CurrentThreadMmcssTask;
+#endif
+
+  //----------------------------------------------------------------------------
+  std::string GetCpuListAsString(unsigned long long mask)
+  {
+    std::ostringstream cpuList;
+    for (int cpuIndex = 0; cpuIndex < 64; ++cpuIndex)
+    {
+      if (mask & (1ULL << cpuIndex))
+      {
+        cpuList << (cpuList.tellp() > 0 ? "," : "") << cpuIndex;
+      }
+    }
+    return cpuList.str();
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusThreadSettings::PlusThreadSettings()
+  : Priority(PRIORITY_DEFAULT)
+  , CpuAffinityMask(0)
+  , LockMemory(false)
+{
+}
+
+//----------------------------------------------------------------------------
+bool PlusThreadSettings::IsDefault() const
+{
+  return this->Priority == PRIORITY_DEFAULT && this->MmcssTask.empty() && this->CpuAffinityMask == 0 && !this->LockMemory;
+}
+
+//----------------------------------------------------------------------------
+bool PlusThreadSettings::operator==(const PlusThreadSettings& other) const
+{
+  return this->Priority == other.Priority && this->MmcssTask == other.MmcssTask
+         && this->CpuAffinityMask == other.CpuAffinityMask && this->LockMemory == other.LockMemory;
+}
+
+//----------------------------------------------------------------------------
+const char* PlusThreadSettings::GetPriorityClassAsString(PriorityClass priority)
+{
+  switch (priority)
+  {
+    case PRIORITY_HIGH:
+      return "High";
+    case PRIORITY_REALTIME:
+      return "RealTime";
+    default:
+      return "Default";
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusThreadSettings::GetPriorityClassFromString(const std::string& priorityString, PriorityClass& priority)
+{
+  const PriorityClass priorities[] = { PRIORITY_DEFAULT, PRIORITY_HIGH, PRIORITY_REALTIME };
+  for (int i = 0; i < 3; ++i)
+  {
+    if (STRCASECMP(priorityString.c_str(), GetPriorityClassAsString(priorities[i])) == 0)
+    {
+      priority = priorities[i];
+      return PLUS_SUCCESS;
+    }
+  }
+  return PLUS_FAIL;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusThreadSettings::ReadConfiguration(vtkXMLDataElement* element, const std::string& attributePrefix)
+{
+  if (element == NULL)
+  {
+    LOG_ERROR("Unable to read thread settings: XML data element is invalid");
+    return PLUS_FAIL;
+  }
+
+  std::string attributeName = attributePrefix + "Priority";
+  const char* priority = element->GetAttribute(attributeName.c_str());
+  if (priority != NULL && GetPriorityClassFromString(priority, this->Priority) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Invalid " << attributeName << " attribute value: " << priority << " (expected Default, High or RealTime)");
+    return PLUS_FAIL;
+  }
+
+  attributeName = attributePrefix + "MmcssTask";
+  const char* mmcssTask = element->GetAttribute(attributeName.c_str());
+  if (mmcssTask != NULL)
+  {
+    this->MmcssTask = mmcssTask;
+  }
+
+  attributeName = attributePrefix + "CpuAffinityMask";
+  const char* cpuAffinityMask = element->GetAttribute(attributeName.c_str());
+  if (cpuAffinityMask != NULL)
+  {
+    char* end = NULL;
+    unsigned long long mask = strtoull(cpuAffinityMask, &end, 0);
+    if (end == cpuAffinityMask || *end != '\0')
+    {
+      LOG_ERROR("Invalid " << attributeName << " attribute value: " << cpuAffinityMask << " (expected a bit mask, e.g., 0x0C for CPU 2 and 3)");
+      return PLUS_FAIL;
+    }
+    this->CpuAffinityMask = mask;
+  }
+
+  attributeName = attributePrefix + "LockMemory";
+  const char* lockMemory = element->GetAttribute(attributeName.c_str());
+  if (lockMemory != NULL)
+  {
+    if (STRCASECMP(lockMemory, "TRUE") == 0)
+    {
+      this->LockMemory = true;
+    }
+    else if (STRCASECMP(lockMemory, "FALSE") == 0)
+    {
+      this->LockMemory = false;
+    }
+    else
+    {
+      LOG_ERROR("Invalid " << attributeName << " attribute value: " << lockMemory << " (expected TRUE or FALSE)");
+      return PLUS_FAIL;
+    }
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void PlusThreadSettings::WriteConfiguration(vtkXMLDataElement* element, const std::string& attributePrefix) const
+{
+  if (element == NULL)
+  {
+    return;
+  }
+  if (this->Priority != PRIORITY_DEFAULT)
+  {
+    element->SetAttribute((attributePrefix + "Priority").c_str(), GetPriorityClassAsString(this->Priority));
+  }
+  if (!this->MmcssTask.empty())
+  {
+    element->SetAttribute((attributePrefix + "MmcssTask").c_str(), this->MmcssTask.c_str());
+  }
+  if (this->CpuAffinityMask != 0)
+  {
+    std::ostringstream mask;
+    mask << "0x" << std::hex << std::uppercase << this->CpuAffinityMask;
+    element->SetAttribute((attributePrefix + "CpuAffinityMask").c_str(), mask.str().c_str());
+  }
+  if (this->LockMemory)
+  {
+    element->SetAttribute((attributePrefix + "LockMemory").c_str(), "TRUE");
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusThreadSettings::ApplyToCurrentThread(const std::string& threadName) const
+{
+  PlusStatus status = PLUS_SUCCESS;
+
+  if (this->LockMemory && LockProcessMemory() != PLUS_SUCCESS)
+  {
+    status = PLUS_FAIL;
+  }
+
+#if defined(_WIN32)
+  if (this->CpuAffinityMask != 0 && SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(this->CpuAffinityMask)) == 0)
+  {
+    LOG_WARNING("Failed to set the CPU affinity of thread " << threadName << " to CPU " << GetCpuListAsString(this->CpuAffinityMask));
+    status = PLUS_FAIL;
+  }
+  if (!this->MmcssTask.empty())
+  {
+    DWORD taskIndex = 0;
+    HANDLE mmcssHandle = AvSetMmThreadCharacteristicsA(this->MmcssTask.c_str(), &taskIndex);
+    // The registration is reverted by the operating system when the thread exits
+    if (mmcssHandle == NULL || !AvSetMmThreadPriority(mmcssHandle, AVRT_PRIORITY_CRITICAL))
+    {
+      LOG_WARNING("Failed to register thread " << threadName << " to MMCSS task " << this->MmcssTask << " (error " << GetLastError() << ")");
+      status = PLUS_FAIL;
+    }
+    else
+    {
+      CurrentThreadMmcssTask = this->MmcssTask;
+    }
+  }
+  else if (this->Priority != PRIORITY_DEFAULT)
+  {
+    int priority = (this->Priority == PRIORITY_REALTIME ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_HIGHEST);
+    if (!SetThreadPriority(GetCurrentThread(), priority))
+    {
+      LOG_WARNING("Failed to set " << GetPriorityClassAsString(this->Priority) << " priority for thread " << threadName);
+      status = PLUS_FAIL;
+    }
+  }
+#else
+  if (this->CpuAffinityMask != 0)
+  {
+#if defined(__linux__)
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (int cpuIndex = 0; cpuIndex < 64; ++cpuIndex)
+    {
+      if (this->CpuAffinityMask & (1ULL << cpuIndex))
+      {
+        CPU_SET(cpuIndex, &cpuSet);
+      }
+    }
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) != 0)
+    {
+      LOG_WARNING("Failed to set the CPU affinity of thread " << threadName << " to CPU " << GetCpuListAsString(this->CpuAffinityMask));
+      status = PLUS_FAIL;
+    }
+#else
+    LOG_WARNING("Setting the CPU affinity of threads is not supported on this platform, thread " << threadName << " is not pinned");
+#endif
+  }
+  // MMCSS is specific to Windows, the corresponding real-time scheduling is used instead
+  PriorityClass priority = (this->MmcssTask.empty() ? this->Priority : PRIORITY_REALTIME);
+  if (priority == PRIORITY_REALTIME)
+  {
+    sched_param schedulingParameters;
+    schedulingParameters.sched_priority = (sched_get_priority_min(SCHED_FIFO) + sched_get_priority_max(SCHED_FIFO)) / 2;
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &schedulingParameters) != 0)
+    {
+      LOG_WARNING("Failed to set real-time priority for thread " << threadName << " (requires CAP_SYS_NICE capability or root privileges)");
+      status = PLUS_FAIL;
+    }
+  }
+  else if (priority == PRIORITY_HIGH)
+  {
+#if defined(__linux__)
+    // On Linux the nice value is a per-thread attribute
+    if (setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), HIGH_PRIORITY_NICE_VALUE) != 0)
+#else
+    sched_param schedulingParameters;
+    schedulingParameters.sched_priority = sched_get_priority_max(SCHED_OTHER);
+    if (pthread_setschedparam(pthread_self(), SCHED_OTHER, &schedulingParameters) != 0)
+#endif
+    {
+      LOG_WARNING("Failed to set high priority for thread " << threadName << " (requires CAP_SYS_NICE capability or root privileges)");
+      status = PLUS_FAIL;
+    }
+  }
+#endif
+
+  if (this->IsDefault())
+  {
+    LOG_DEBUG("Thread " << threadName << ": " << GetCurrentThreadDescription());
+  }
+  else
+  {
+    LOG_INFO("Thread " << threadName << ": " << GetCurrentThreadDescription());
+  }
+  return status;
+}
+
+//----------------------------------------------------------------------------
+std::string PlusThreadSettings::GetCurrentThreadDescription()
+{
+  std::ostringstream description;
+#if defined(_WIN32)
+  if (!CurrentThreadMmcssTask.empty())
+  {
+    description << "MMCSS task " << CurrentThreadMmcssTask << ", ";
+  }
+  description << "priority " << GetThreadPriority(GetCurrentThread());
+  // The affinity of a thread can only be queried by setting it, so it is set to the process affinity and restored
+  DWORD_PTR processMask = 0;
+  DWORD_PTR systemMask = 0;
+  if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+  {
+    DWORD_PTR threadMask = SetThreadAffinityMask(GetCurrentThread(), processMask);
+    if (threadMask != 0)
+    {
+      SetThreadAffinityMask(GetCurrentThread(), threadMask);
+      description << ", CPU " << GetCpuListAsString(threadMask);
+    }
+  }
+#else
+  int policy = SCHED_OTHER;
+  sched_param schedulingParameters;
+  if (pthread_getschedparam(pthread_self(), &policy, &schedulingParameters) == 0)
+  {
+    description << (policy == SCHED_FIFO ? "SCHED_FIFO" : (policy == SCHED_RR ? "SCHED_RR" : "SCHED_OTHER"))
+                << " priority " << schedulingParameters.sched_priority;
+  }
+#if defined(__linux__)
+  description << ", nice " << getpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)));
+  cpu_set_t cpuSet;
+  CPU_ZERO(&cpuSet);
+  if (pthread_getaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0)
+  {
+    unsigned long long mask = 0;
+    for (int cpuIndex = 0; cpuIndex < 64; ++cpuIndex)
+    {
+      if (CPU_ISSET(cpuIndex, &cpuSet))
+      {
+        mask |= (1ULL << cpuIndex);
+      }
+    }
+    description << ", CPU " << GetCpuListAsString(mask);
+  }
+#endif
+#endif
+  description << ", memory " << (IsProcessMemoryLocked() ? "locked" : "not locked");
+  return description.str();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusThreadSettings::LockProcessMemory()
+{
+  std::lock_guard<std::mutex> lock(LockMemoryMutex);
+  if (LockMemoryAttempted)
+  {
+    return LockMemoryStatus;
+  }
+  LockMemoryAttempted = true;
+
+#if defined(_WIN32)
+  SIZE_T minimumWorkingSetSize = 0;
+  SIZE_T maximumWorkingSetSize = 0;
+  HANDLE process = GetCurrentProcess();
+  if (!GetProcessWorkingSetSize(process, &minimumWorkingSetSize, &maximumWorkingSetSize)
+      || !SetProcessWorkingSetSizeEx(process, (std::max)(minimumWorkingSetSize, LOCKED_MINIMUM_WORKING_SET_SIZE),
+                                     (std::max)(maximumWorkingSetSize, 2 * LOCKED_MINIMUM_WORKING_SET_SIZE),
+                                     QUOTA_LIMITS_HARDWS_MIN_ENABLE | QUOTA_LIMITS_HARDWS_MAX_DISABLE))
+  {
+    LOG_WARNING("Failed to lock the memory of the process (error " << GetLastError() << ")");
+    LockMemoryStatus = PLUS_FAIL;
+    return LockMemoryStatus;
+  }
+#else
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+  {
+    LOG_WARNING("Failed to lock the memory of the process (requires CAP_IPC_LOCK capability, root privileges or a sufficient memlock limit)");
+    LockMemoryStatus = PLUS_FAIL;
+    return LockMemoryStatus;
+  }
+#endif
+  LOG_INFO("Memory of the process is locked into RAM");
+  LockMemoryStatus = PLUS_SUCCESS;
+  return LockMemoryStatus;
+}
+
+//----------------------------------------------------------------------------
+bool PlusThreadSettings::IsProcessMemoryLocked()
+{
+  std::lock_guard<std::mutex> lock(LockMemoryMutex);
+  return LockMemoryAttempted && LockMemoryStatus == PLUS_SUCCESS;
+}
@@ -0,0 +1,95 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusThreadSettings_h
+#define __PlusThreadSettings_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusCommonExport.h"
+
+#include <string>
+
+class vtkXMLDataElement;
+
+/*!
+  \class PlusThreadSettings
+  \brief Scheduling priority, CPU affinity and memory locking settings of a time-critical thread
+
+  The settings are read from attributes of a configuration element, with a prefix that identifies the thread
+  (e.g., AcquisitionThreadPriority of a device, or ThreadPriority of the OpenIGTLink server):
+  - <prefix>Priority: Default (operating system default), High (above normal: nice -10 on Linux, THREAD_PRIORITY_HIGHEST
+    on Windows) or RealTime (SCHED_FIFO on Linux and macOS, THREAD_PRIORITY_TIME_CRITICAL on Windows)
+  - <prefix>MmcssTask: on Windows the thread is registered to this Multimedia Class Scheduler Service task (e.g., "Pro Audio")
+    instead of setting its priority directly, which lets a non-administrator process run threads at real-time priority.
+    Implies RealTime priority. Ignored on other platforms.
+  - <prefix>CpuAffinityMask: CPUs that the thread may run on, as a bit mask in decimal or hexadecimal (0x...) notation.
+    0 means all CPUs (the thread is not pinned).
+  - <prefix>LockMemory: lock all current and future memory pages of the process into RAM (mlockall on Linux and macOS,
+    minimum working set increase on Windows), so that time-critical threads do not wait for page faults.
+    It applies to the whole process, so it is performed once, by the first thread that requests it.
+
+  Settings that cannot be applied (typically because of missing privileges, e.g., CAP_SYS_NICE and CAP_IPC_LOCK on Linux)
+  are reported as warnings and the thread runs with the remaining settings. When the settings are applied, the effective
+  settings of the thread are logged, so that the setup of a time-critical system can be verified from the log.
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport PlusThreadSettings
+{
+public:
+  enum PriorityClass
+  {
+    PRIORITY_DEFAULT,
+    PRIORITY_HIGH,
+    PRIORITY_REALTIME
+  };
+
+  PlusThreadSettings();
+
+  /*! True if all settings are the operating system defaults, so nothing has to be applied */
+  bool IsDefault() const;
+
+  bool operator==(const PlusThreadSettings& other) const;
+  bool operator!=(const PlusThreadSettings& other) const { return !(*this == other); }
+
+  /*!
+    Read the settings from the attributes of an element (see class description). Attributes that are not present
+    keep their current value.
+    \param attributePrefix Prefix of the attribute names, e.g., "AcquisitionThread"
+  */
+  PlusStatus ReadConfiguration(vtkXMLDataElement* element, const std::string& attributePrefix);
+
+  /*! Write the settings that differ from the defaults to the attributes of an element */
+  void WriteConfiguration(vtkXMLDataElement* element, const std::string& attributePrefix) const;
+
+  /*!
+    Apply the settings to the calling thread and log its effective settings (at info level if any setting
+    was requested, at debug level otherwise). Returns PLUS_FAIL if any of the settings could not be applied.
+    \param threadName Name of the thread, used in log messages
+  */
+  PlusStatus ApplyToCurrentThread(const std::string& threadName) const;
+
+  /*! Get a description of the effective scheduling policy, priority and CPU affinity of the calling thread */
+  static std::string GetCurrentThreadDescription();
+
+  /*! Lock the memory pages of the process into RAM. Performed only once, subsequent calls return the first result. */
+  static PlusStatus LockProcessMemory();
+
+  /*! True if the memory of the process has been locked by LockProcessMemory */
+  static bool IsProcessMemoryLocked();
+
+  static const char* GetPriorityClassAsString(PriorityClass priority);
+  static PlusStatus GetPriorityClassFromString(const std::string& priorityString, PriorityClass& priority);
+
+  PriorityClass Priority;
+  /*! Windows MMCSS task name, empty if the thread is not registered to MMCSS */
+  std::string MmcssTask;
+  /*! Bit mask of the CPUs that the thread may run on, 0 if the thread is not pinned */
+  unsigned long long CpuAffinityMask;
+  bool LockMemory;
+};
+
+#endif
@@ -0,0 +1,172 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusValidPixelMask.h"
+
+#include <algorithm>
+#include <cmath>
+
+//----------------------------------------------------------------------------
+PlusValidPixelMask::PlusValidPixelMask()
+  : Width(0)
+  , Height(0)
+{
+  this->RowSpanStart.push_back(0);
+}
+
+//----------------------------------------------------------------------------
+void PlusValidPixelMask::Clear()
+{
+  this->Width = 0;
+  this->Height = 0;
+  this->Spans.clear();
+  this->RowSpanStart.assign(1, 0);
+}
+
+//----------------------------------------------------------------------------
+void PlusValidPixelMask::SetToFullImage(int width, int height)
+{
+  const int origin[2] = { 0, 0 };
+  const int size[2] = { width, height };
+  this->SetToRectangle(width, height, origin, size);
+}
+
+//----------------------------------------------------------------------------
+void PlusValidPixelMask::SetToRectangle(int width, int height, const int origin[2], const int size[2])
+{
+  this->Width = std::max(width, 0);
+  this->Height = std::max(height, 0);
+  std::vector< std::vector<Span> > rowSpans(this->Height);
+  Span span = { origin[0], origin[0] + size[0] - 1 };
+  for (int row = std::max(origin[1], 0); row < std::min(origin[1] + size[1], this->Height); ++row)
+  {
+    rowSpans[row].push_back(span);
+  }
+  this->SetRowSpans(rowSpans);
+}
+
+//----------------------------------------------------------------------------
+void PlusValidPixelMask::SetToPolygon(int width, int height, const std::vector<double>& columns, const std::vector<double>& rows, int marginPixels/*=0*/)
+{
+  this->Width = std::max(width, 0);
+  this->Height = std::max(height, 0);
+  marginPixels = std::max(marginPixels, 0);
+  std::vector< std::vector<Span> > rowSpans(this->Height);
+  const size_t numberOfVertices = std::min(columns.size(), rows.size());
+  if (numberOfVertices < 3)
+  {
+    LOG_ERROR("Valid pixel mask polygon must have at least 3 vertices");
+    this->SetRowSpans(rowSpans);
+    return;
+  }
+
+  // Find the spans of each row by intersecting the row centerline with the polygon edges (even-odd rule)
+  std::vector<double> crossings;
+  for (int row = 0; row < this->Height; ++row)
+  {
+    crossings.clear();
+    for (size_t i = 0, j = numberOfVertices - 1; i < numberOfVertices; j = i++)
+    {
+      if ((rows[i] <= row) != (rows[j] <= row))
+      {
+        crossings.push_back(columns[i] + (row - rows[i]) * (columns[j] - columns[i]) / (rows[j] - rows[i]));
+      }
+    }
+    std::sort(crossings.begin(), crossings.end());
+    for (size_t i = 0; i + 1 < crossings.size(); i += 2)
+    {
+      Span span = { static_cast<int>(std::ceil(crossings[i])) - marginPixels, static_cast<int>(std::floor(crossings[i + 1])) + marginPixels };
+      if (span.FirstColumn > span.LastColumn)
+      {
+        continue;
+      }
+      // The margin extends the spans to the neighbor rows, too
+      for (int marginRow = std::max(row - marginPixels, 0); marginRow <= std::min(row + marginPixels, this->Height - 1); ++marginRow)
+      {
+        rowSpans[marginRow].push_back(span);
+      }
+    }
+  }
+  this->SetRowSpans(rowSpans);
+}
+
+//----------------------------------------------------------------------------
+void PlusValidPixelMask::ClipToRectangle(int firstColumn, int firstRow, int lastColumn, int lastRow)
+{
+  std::vector< std::vector<Span> > rowSpans(this->Height);
+  for (int row = std::max(firstRow, 0); row <= std::min(lastRow, this->Height - 1); ++row)
+  {
+    for (int spanIndex = this->RowSpanStart[row]; spanIndex < this->RowSpanStart[row + 1]; ++spanIndex)
+    {
+      Span span = { std::max(this->Spans[spanIndex].FirstColumn, firstColumn), std::min(this->Spans[spanIndex].LastColumn, lastColumn) };
+      rowSpans[row].push_back(span);
+    }
+  }
+  this->SetRowSpans(rowSpans);
+}
+
+//----------------------------------------------------------------------------
+bool PlusValidPixelMask::IsValid(int column, int row) const
+{
+  if (row < 0 || row >= this->Height)
+  {
+    return false;
+  }
+  for (int spanIndex = this->RowSpanStart[row]; spanIndex < this->RowSpanStart[row + 1]; ++spanIndex)
+  {
+    if (column < this->Spans[spanIndex].FirstColumn)
+    {
+      return false;
+    }
+    if (column <= this->Spans[spanIndex].LastColumn)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+unsigned long PlusValidPixelMask::GetNumberOfValidPixels() const
+{
+  unsigned long numberOfValidPixels = 0;
+  for (std::vector<Span>::const_iterator span = this->Spans.begin(); span != this->Spans.end(); ++span)
+  {
+    numberOfValidPixels += span->LastColumn - span->FirstColumn + 1;
+  }
+  return numberOfValidPixels;
+}
+
+//----------------------------------------------------------------------------
+void PlusValidPixelMask::SetRowSpans(std::vector< std::vector<Span> >& rowSpans)
+{
+  this->Spans.clear();
+  this->RowSpanStart.assign(this->Height + 1, 0);
+  for (int row = 0; row < this->Height; ++row)
+  {
+    this->RowSpanStart[row] = static_cast<int>(this->Spans.size());
+    std::vector<Span>& spans = rowSpans[row];
+    std::sort(spans.begin(), spans.end(), [](const Span& a, const Span& b) { return a.FirstColumn < b.FirstColumn; });
+    for (std::vector<Span>::iterator span = spans.begin(); span != spans.end(); ++span)
+    {
+      Span clippedSpan = { std::max(span->FirstColumn, 0), std::min(span->LastColumn, this->Width - 1) };
+      if (clippedSpan.FirstColumn > clippedSpan.LastColumn)
+      {
+        continue;
+      }
+      // Merge overlapping and adjacent spans
+      if (this->Spans.size() > static_cast<size_t>(this->RowSpanStart[row]) && clippedSpan.FirstColumn <= this->Spans.back().LastColumn + 1)
+      {
+        this->Spans.back().LastColumn = std::max(this->Spans.back().LastColumn, clippedSpan.LastColumn);
+      }
+      else
+      {
+        this->Spans.push_back(clippedSpan);
+      }
+    }
+  }
+  this->RowSpanStart[this->Height] = static_cast<int>(this->Spans.size());
+}
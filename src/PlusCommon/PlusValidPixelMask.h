@@ -0,0 +1,107 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PLUSVALIDPIXELMASK_H
+#define __PLUSVALIDPIXELMASK_H
+
+#include "PlusConfigure.h"
+#include "vtkPlusCommonExport.h"
+
+#include <algorithm>
+#include <vector>
+
+/*!
+  \class PlusValidPixelMask
+  \brief Run-length encoded mask of the valid pixels of an image
+
+  The valid pixels of each row are stored as a list of spans (continuous ranges of columns), so image processing
+  algorithms can iterate over the valid pixels only. It is typically used for skipping the pixels outside of the fan
+  of a curvilinear probe image (see vtkPlusUsScanConvert::ComputeOutputImageValidPixelMask) or outside of a clip rectangle.
+
+  An empty mask (that has zero width or height) means that no mask is defined.
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport PlusValidPixelMask
+{
+public:
+  /*! Continuous range of valid pixels in a row. First and last columns are inclusive. */
+  struct Span
+  {
+    int FirstColumn;
+    int LastColumn;
+  };
+
+  PlusValidPixelMask();
+
+  /*! Remove the mask (set image size to zero) */
+  void Clear();
+
+  /*! Set all pixels of the image valid */
+  void SetToFullImage(int width, int height);
+
+  /*! Set the pixels inside the rectangle valid. The rectangle is clipped to the image. */
+  void SetToRectangle(int width, int height, const int origin[2], const int size[2]);
+
+  /*!
+    Set the pixels valid that are inside the polygon or closer to its boundary than marginPixels (measured along rows and columns)
+    \param columns Column (x) coordinates of the polygon vertices, in pixels
+    \param rows Row (y) coordinates of the polygon vertices, in pixels
+  */
+  void SetToPolygon(int width, int height, const std::vector<double>& columns, const std::vector<double>& rows, int marginPixels = 0);
+
+  /*! Set the pixels outside of the rectangle invalid. Last column and row are inclusive. */
+  void ClipToRectangle(int firstColumn, int firstRow, int lastColumn, int lastRow);
+
+  int GetWidth() const { return this->Width; }
+  int GetHeight() const { return this->Height; }
+
+  /*! Returns true if no mask is defined */
+  bool IsEmpty() const { return this->Width <= 0 || this->Height <= 0; }
+
+  /*! Get the spans of a row, ordered by column. Returns NULL if there are no valid pixels in the row. */
+  const Span* GetRowSpans(int row, int& numberOfSpans) const
+  {
+    numberOfSpans = this->RowSpanStart[row + 1] - this->RowSpanStart[row];
+    return numberOfSpans > 0 ? &this->Spans[this->RowSpanStart[row]] : NULL;
+  }
+
+  /*! Returns true if the pixel is valid */
+  bool IsValid(int column, int row) const;
+
+  /*! Get the number of valid pixels */
+  unsigned long GetNumberOfValidPixels() const;
+
+  /*! Set all invalid pixels of an image (of the same size as the mask, single component, without padding) to the specified value */
+  template<typename PixelType>
+  void FillInvalidPixels(PixelType* image, PixelType value) const
+  {
+    for (int row = 0; row < this->Height; ++row)
+    {
+      PixelType* rowPixels = image + static_cast<size_t>(row) * this->Width;
+      int column = 0;
+      for (int spanIndex = this->RowSpanStart[row]; spanIndex < this->RowSpanStart[row + 1]; ++spanIndex)
+      {
+        std::fill(rowPixels + column, rowPixels + this->Spans[spanIndex].FirstColumn, value);
+        column = this->Spans[spanIndex].LastColumn + 1;
+      }
+      std::fill(rowPixels + column, rowPixels + this->Width, value);
+    }
+  }
+
+protected:
+  /*! Replace the spans by the specified spans of each row (they may overlap and they are clipped to the image) */
+  void SetRowSpans(std::vector< std::vector<Span> >& rowSpans);
+
+  int Width;
+  int Height;
+  /*! Spans of all rows, ordered by row, then column */
+  std::vector<Span> Spans;
+  /*! Index of the first span of each row in Spans, the last element is the total number of spans */
+  std::vector<int> RowSpanStart;
+};
+
+#endif
@@ -0,0 +1,175 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file AsyncLogBackendTest.cxx
+  \brief Tests the asynchronous logging backend.
+
+  Several threads log messages concurrently: every message must be written exactly once and the messages
+  of a thread must stay in the order they were logged. Then the dropping
+  of droppable records and the per-call-site rate limit are verified.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusAsyncLogBackend.h"
+
+#include <vtksys/CommandLineArguments.hxx>
+
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  int TestConcurrentLogging(int numberOfThreads, int numberOfMessagesPerThread)
+  {
+    std::vector<PlusAsyncLogBackend::Record> writtenRecords;
+    PlusAsyncLogBackend backend([&writtenRecords](const PlusAsyncLogBackend::Record & record) { writtenRecords.push_back(record); });
+    backend.SetRingCapacity(numberOfMessagesPerThread + 1);
+    backend.Start();
+
+    std::vector<std::thread> threads;
+    for (int threadIndex = 0; threadIndex < numberOfThreads; ++threadIndex)
+    {
+      threads.push_back(std::thread([&backend, threadIndex, numberOfMessagesPerThread]()
+      {
+        for (int i = 0; i < numberOfMessagesPerThread; ++i)
+        {
+          std::ostringstream message;
+          message << threadIndex << " " << i;
+          backend.AddRecord(vtkPlusLogger::LOG_LEVEL_DEBUG, message.str().c_str(), __FILE__, __LINE__, false);
+        }
+      }));
+    }
+    for (std::vector<std::thread>::iterator threadIt = threads.begin(); threadIt != threads.end(); ++threadIt)
+    {
+      threadIt->join();
+    }
+    backend.Stop();
+
+    int numberOfErrors = 0;
+    if (writtenRecords.size() != static_cast<size_t>(numberOfThreads * numberOfMessagesPerThread))
+    {
+      LOG_ERROR("Number of written records is " << writtenRecords.size() << ", expected " << numberOfThreads * numberOfMessagesPerThread);
+      numberOfErrors++;
+    }
+    std::map<int, int> nextMessageIndexOfThreads;
+    for (size_t recordIndex = 0; recordIndex < writtenRecords.size(); ++recordIndex)
+    {
+      std::istringstream message(writtenRecords[recordIndex].Message);
+      int threadIndex = -1;
+      int messageIndex = -1;
+      message >> threadIndex >> messageIndex;
+      if (messageIndex != nextMessageIndexOfThreads[threadIndex]++)
+      {
+        LOG_ERROR("Message '" << writtenRecords[recordIndex].Message << "' is out of order");
+        numberOfErrors++;
+      }
+    }
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestDroppingAndRateLimit()
+  {
+    int numberOfErrors = 0;
+    std::vector<PlusAsyncLogBackend::Record> writtenRecords;
+    PlusAsyncLogBackend backend([&writtenRecords](const PlusAsyncLogBackend::Record & record) { writtenRecords.push_back(record); });
+    // The flusher thread is not started, so the ring is only emptied by Flush
+    backend.SetRingCapacity(10);
+
+    int numberOfRejectedRecords = 0;
+    for (int i = 0; i < 15; ++i)
+    {
+      if (backend.AddRecord(vtkPlusLogger::LOG_LEVEL_DEBUG, "Droppable", __FILE__, __LINE__, true) != PlusAsyncLogBackend::RECORD_QUEUED)
+      {
+        numberOfRejectedRecords++;
+      }
+    }
+    if (backend.AddRecord(vtkPlusLogger::LOG_LEVEL_ERROR, "Not droppable", __FILE__, __LINE__, false) != PlusAsyncLogBackend::RECORD_REJECTED)
+    {
+      LOG_ERROR("A record that is not droppable is not rejected when the ring is full");
+      numberOfErrors++;
+    }
+    if (numberOfRejectedRecords != 5 || backend.GetNumberOfDroppedRecords() != 5)
+    {
+      LOG_ERROR("Number of dropped records is " << backend.GetNumberOfDroppedRecords() << ", expected 5");
+      numberOfErrors++;
+    }
+    backend.Flush();
+    // The 10 queued records and the report of the dropped records
+    if (writtenRecords.size() != 11 || writtenRecords.back().Level != vtkPlusLogger::LOG_LEVEL_WARNING)
+    {
+      LOG_ERROR("Number of written records is " << writtenRecords.size() << ", expected 10 records and a warning about the dropped records");
+      numberOfErrors++;
+    }
+
+    writtenRecords.clear();
+    backend.SetMaximumMessagesPerSecondPerCallSite(3);
+    int numberOfSuppressedRecords = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+      if (backend.AddRecord(vtkPlusLogger::LOG_LEVEL_INFO, "Rate limited", __FILE__, __LINE__, true) == PlusAsyncLogBackend::RECORD_SUPPRESSED)
+      {
+        numberOfSuppressedRecords++;
+      }
+    }
+    backend.Flush();
+    // 5 records are suppressed, or at least 2 if the second changes during the loop
+    if (numberOfSuppressedRecords < 2 || numberOfSuppressedRecords + writtenRecords.size() != 8)
+    {
+      LOG_ERROR("Number of suppressed records is " << numberOfSuppressedRecords << ", number of written records is " << writtenRecords.size() << ", expected 5 and 3");
+      numberOfErrors++;
+    }
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int numberOfThreads(8);
+  int numberOfMessagesPerThread(5000);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--threads", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfThreads, "Number of logging threads (Default: 8).");
+  args.AddArgument("--messages-per-thread", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfMessagesPerThread, "Number of messages logged by each thread (Default: 5000).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors = TestConcurrentLogging(numberOfThreads, numberOfMessagesPerThread);
+  numberOfErrors += TestDroppingAndRateLimit();
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,262 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PixelCodecBenchmark.cxx
+  \brief Verifies and benchmarks the SIMD color conversions and image resizing of PixelCodec.
+
+  For each instruction set that is supported by the CPU the output of the dispatched conversions and resizing
+  is compared to the scalar implementation (it must be bit-exact), then the conversion speed is measured
+  in megapixels per second for 640x480, 1920x1080 and 3840x2160 images.
+*/
+
+#include "PlusConfigure.h"
+#include "PixelCodec.h"
+
+#include <vtksys/CommandLineArguments.hxx>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+  enum ConversionType
+  {
+    Conversion_Rgb24ToGray,
+    Conversion_Rgba32ToGray,
+    Conversion_Yuv422pToRgb24,
+    Conversion_Yuv422pToBgr24,
+    Conversion_Yuv422pToGray,
+    Conversion_Count
+  };
+
+  const char* CONVERSION_NAMES[Conversion_Count] = { "RGB24 to gray", "RGBA32 to gray", "YUY2 to RGB24", "YUY2 to BGR24", "YUY2 to gray" };
+
+  //----------------------------------------------------------------------------
+  void Convert(ConversionType conversion, bool scalar, int width, int height, unsigned char* s, unsigned char* d)
+  {
+    switch (conversion)
+    {
+      case Conversion_Rgb24ToGray:
+        scalar ? PixelCodec::Rgb24ToGrayScalar(width, height, s, d) : PixelCodec::Rgb24ToGray(width, height, s, d);
+        break;
+      case Conversion_Rgba32ToGray:
+        scalar ? PixelCodec::Rgba32ToGrayScalar(width, height, s, d) : PixelCodec::Rgba32ToGray(width, height, s, d);
+        break;
+      case Conversion_Yuv422pToRgb24:
+        scalar ? PixelCodec::Yuv422pToBmp24Scalar(PixelCodec::ComponentOrder_RGB, width, height, s, d) : PixelCodec::Yuv422pToBmp24(PixelCodec::ComponentOrder_RGB, width, height, s, d);
+        break;
+      case Conversion_Yuv422pToBgr24:
+        scalar ? PixelCodec::Yuv422pToBmp24Scalar(PixelCodec::ComponentOrder_BGR, width, height, s, d) : PixelCodec::Yuv422pToBmp24(PixelCodec::ComponentOrder_BGR, width, height, s, d);
+        break;
+      case Conversion_Yuv422pToGray:
+        scalar ? PixelCodec::Yuv422pToGrayScalar(width, height, s, d) : PixelCodec::Yuv422pToGray(width, height, s, d);
+        break;
+      default:
+        break;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  int VerifyConversions(PixelCodec::SimdInstructionSet instructionSet)
+  {
+    int numberOfErrors = 0;
+    // Odd and small sizes test the handling of the pixels that do not fill a complete SIMD register
+    const int widths[] = { 1, 2, 7, 16, 33, 64, 641 };
+    const int height = 3;
+    for (int w = 0; w < 7; ++w)
+    {
+      int width = widths[w];
+      std::vector<unsigned char> input(width * height * 4);
+      std::vector<unsigned char> output(width * height * 3);
+      std::vector<unsigned char> referenceOutput(width * height * 3);
+      for (int repeat = 0; repeat < 20; ++repeat)
+      {
+        for (size_t i = 0; i < input.size(); ++i)
+        {
+          input[i] = static_cast<unsigned char>(rand());
+        }
+        for (int conversion = 0; conversion < Conversion_Count; ++conversion)
+        {
+          std::fill(output.begin(), output.end(), 0);
+          std::fill(referenceOutput.begin(), referenceOutput.end(), 0);
+          Convert(static_cast<ConversionType>(conversion), false, width, height, &input[0], &output[0]);
+          Convert(static_cast<ConversionType>(conversion), true, width, height, &input[0], &referenceOutput[0]);
+          if (output != referenceOutput)
+          {
+            LOG_ERROR(CONVERSION_NAMES[conversion] << " conversion using " << PixelCodec::GetSimdInstructionSetAsString(instructionSet)
+                      << " does not match the scalar implementation (image width: " << width << ")");
+            numberOfErrors++;
+          }
+        }
+      }
+    }
+
+    // All Y, U, V combinations
+    std::vector<unsigned char> input(256 * 256 * 4);
+    std::vector<unsigned char> output(256 * 256 * 6);
+    std::vector<unsigned char> referenceOutput(256 * 256 * 6);
+    for (int y = 0; y < 256; ++y)
+    {
+      for (int i = 0; i < 256 * 256; ++i)
+      {
+        input[i * 4] = y;
+        input[i * 4 + 1] = i & 0xFF;
+        input[i * 4 + 2] = 255 - y;
+        input[i * 4 + 3] = i >> 8;
+      }
+      for (int conversion = Conversion_Yuv422pToRgb24; conversion <= Conversion_Yuv422pToGray; ++conversion)
+      {
+        Convert(static_cast<ConversionType>(conversion), false, 512, 128, &input[0], &output[0]);
+        Convert(static_cast<ConversionType>(conversion), true, 512, 128, &input[0], &referenceOutput[0]);
+        if (output != referenceOutput)
+        {
+          LOG_ERROR(CONVERSION_NAMES[conversion] << " conversion using " << PixelCodec::GetSimdInstructionSetAsString(instructionSet)
+                    << " does not match the scalar implementation (Y=" << y << ")");
+          numberOfErrors++;
+        }
+      }
+    }
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int VerifyResize(PixelCodec::SimdInstructionSet instructionSet)
+  {
+    int numberOfErrors = 0;
+    const int imageSizes[][4] = { { 640, 480, 256, 256 }, { 1920, 1080, 512, 512 }, { 101, 37, 17, 9 }, { 5, 5, 12, 12 }, { 33, 7, 33, 7 }, { 800, 600, 1, 1 } };
+    const PixelCodec::ResizeFilter filters[] = { PixelCodec::ResizeFilter_Box, PixelCodec::ResizeFilter_Bilinear, PixelCodec::ResizeFilter_Area };
+    for (size_t size = 0; size < sizeof(imageSizes) / sizeof(imageSizes[0]); ++size)
+    {
+      const int inputSize[2] = { imageSizes[size][0], imageSizes[size][1] };
+      const int outputSize[2] = { imageSizes[size][2], imageSizes[size][3] };
+      for (int numberOfComponents = 1; numberOfComponents <= 4; ++numberOfComponents)
+      {
+        std::vector<unsigned char> input(inputSize[0] * inputSize[1] * numberOfComponents);
+        for (size_t i = 0; i < input.size(); ++i)
+        {
+          input[i] = static_cast<unsigned char>(rand());
+        }
+        std::vector<unsigned char> output(outputSize[0] * outputSize[1] * numberOfComponents);
+        std::vector<unsigned char> referenceOutput(output.size());
+        for (size_t filter = 0; filter < sizeof(filters) / sizeof(filters[0]); ++filter)
+        {
+          if (PixelCodec::ResizeImage(&input[0], inputSize, numberOfComponents, outputSize, filters[filter], &output[0]) != PLUS_SUCCESS
+              || PixelCodec::ResizeImageScalar(&input[0], inputSize, numberOfComponents, outputSize, filters[filter], &referenceOutput[0]) != PLUS_SUCCESS
+              || output != referenceOutput)
+          {
+            LOG_ERROR(PixelCodec::GetResizeFilterAsString(filters[filter]) << " resize using " << PixelCodec::GetSimdInstructionSetAsString(instructionSet)
+                      << " does not match the scalar implementation (" << inputSize[0] << "x" << inputSize[1] << " to " << outputSize[0] << "x" << outputSize[1]
+                      << ", " << numberOfComponents << " components)");
+            numberOfErrors++;
+          }
+        }
+      }
+    }
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  void MeasureConversions(const std::string& instructionSetName, int width, int height, int numberOfIterations)
+  {
+    typedef std::chrono::high_resolution_clock Clock;
+    std::vector<unsigned char> input(width * height * 4);
+    std::vector<unsigned char> output(width * height * 3);
+    for (size_t i = 0; i < input.size(); ++i)
+    {
+      input[i] = static_cast<unsigned char>(rand());
+    }
+
+    for (int conversion = 0; conversion < Conversion_Count; ++conversion)
+    {
+      bool scalar = (instructionSetName == "Scalar");
+      Clock::time_point start = Clock::now();
+      for (int i = 0; i < numberOfIterations; ++i)
+      {
+        Convert(static_cast<ConversionType>(conversion), scalar, width, height, &input[0], &output[0]);
+      }
+      double elapsedSec = std::chrono::duration<double>(Clock::now() - start).count();
+      double megapixelsPerSec = (elapsedSec > 0 ? static_cast<double>(width) * height * numberOfIterations / elapsedSec / 1e6 : 0);
+      LOG_INFO(instructionSetName << " " << CONVERSION_NAMES[conversion] << " " << width << "x" << height << ": " << std::fixed << std::setprecision(1) << megapixelsPerSec << " MP/s");
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int numberOfIterations(20);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--iterations", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfIterations, "Number of conversions of each image for each measurement (Default: 20).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  PixelCodec::SimdInstructionSet supportedInstructionSet = PixelCodec::GetSupportedSimdInstructionSet();
+  LOG_INFO("Supported instruction set: " << PixelCodec::GetSimdInstructionSetAsString(supportedInstructionSet));
+
+  std::vector<PixelCodec::SimdInstructionSet> instructionSets;
+  if (supportedInstructionSet == PixelCodec::SimdInstructionSet_AVX2)
+  {
+    instructionSets.push_back(PixelCodec::SimdInstructionSet_SSE41);
+  }
+  if (supportedInstructionSet != PixelCodec::SimdInstructionSet_None)
+  {
+    instructionSets.push_back(supportedInstructionSet);
+  }
+
+  const int imageSizes[3][2] = { { 640, 480 }, { 1920, 1080 }, { 3840, 2160 } };
+  int numberOfErrors = 0;
+  for (int size = 0; size < 3; ++size)
+  {
+    MeasureConversions("Scalar", imageSizes[size][0], imageSizes[size][1], numberOfIterations);
+  }
+  for (std::vector<PixelCodec::SimdInstructionSet>::iterator it = instructionSets.begin(); it != instructionSets.end(); ++it)
+  {
+    if (PixelCodec::SetSimdInstructionSet(*it) != PLUS_SUCCESS)
+    {
+      numberOfErrors++;
+      continue;
+    }
+    numberOfErrors += VerifyConversions(*it);
+    numberOfErrors += VerifyResize(*it);
+    for (int size = 0; size < 3; ++size)
+    {
+      MeasureConversions(PixelCodec::GetSimdInstructionSetAsString(*it), imageSizes[size][0], imageSizes[size][1], numberOfIterations);
+    }
+  }
+  PixelCodec::SetSimdInstructionSet(supportedInstructionSet);
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("PixelCodecBenchmark failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("PixelCodecBenchmark completed successfully");
+  return EXIT_SUCCESS;
+}
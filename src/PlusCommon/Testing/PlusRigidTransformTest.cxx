@@ -0,0 +1,148 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusRigidTransformTest.cxx
+  \brief Compares the results of PlusRigidTransform with the same computations done with vtkMatrix4x4 and vtkMath.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusRigidTransform.h"
+
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkSmartPointer.h>
+#include <vtkTransform.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+#include <cmath>
+#include <cstdlib>
+
+namespace
+{
+  const double TOLERANCE = 1e-9;
+
+  //----------------------------------------------------------------------------
+  vtkSmartPointer<vtkMatrix4x4> CreateRandomPose()
+  {
+    vtkSmartPointer<vtkTransform> transform = vtkSmartPointer<vtkTransform>::New();
+    transform->Translate(vtkMath::Random(-200, 200), vtkMath::Random(-200, 200), vtkMath::Random(-200, 200));
+    transform->RotateWXYZ(vtkMath::Random(-180, 180), vtkMath::Random(-1, 1), vtkMath::Random(-1, 1), vtkMath::Random(-1, 1));
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    matrix->DeepCopy(transform->GetMatrix());
+    return matrix;
+  }
+
+  //----------------------------------------------------------------------------
+  int CompareMatrices(const PlusRigidTransform& transform, vtkMatrix4x4* expectedMatrix, const std::string& operationName)
+  {
+    double elements[16];
+    transform.GetMatrixElements(elements);
+    for (int i = 0; i < 16; ++i)
+    {
+      if (std::fabs(elements[i] - expectedMatrix->Element[i / 4][i % 4]) > TOLERANCE)
+      {
+        LOG_ERROR(operationName << " result mismatch at element " << i << ": " << elements[i] << " (expected " << expectedMatrix->Element[i / 4][i % 4] << ")");
+        return 1;
+      }
+    }
+    return 0;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int numberOfPoses(1000);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--poses", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfPoses, "Number of random poses to test (Default: 1000).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+  vtkMath::RandomSeed(1234);
+
+  int numberOfErrors = 0;
+  for (int poseIndex = 0; poseIndex < numberOfPoses && numberOfErrors < 10; ++poseIndex)
+  {
+    vtkSmartPointer<vtkMatrix4x4> matrixA = CreateRandomPose();
+    vtkSmartPointer<vtkMatrix4x4> matrixB = CreateRandomPose();
+    PlusRigidTransform transformA;
+    transformA.SetVtkMatrix(matrixA);
+    PlusRigidTransform transformB;
+    transformB.SetVtkMatrix(matrixB);
+
+    // Composition
+    vtkSmartPointer<vtkMatrix4x4> expectedProduct = vtkSmartPointer<vtkMatrix4x4>::New();
+    vtkMatrix4x4::Multiply4x4(matrixA, matrixB, expectedProduct);
+    numberOfErrors += CompareMatrices(transformA * transformB, expectedProduct, "Multiply");
+
+    // Inverse
+    vtkSmartPointer<vtkMatrix4x4> expectedInverse = vtkSmartPointer<vtkMatrix4x4>::New();
+    vtkMatrix4x4::Invert(matrixA, expectedInverse);
+    numberOfErrors += CompareMatrices(transformA.GetInverse(), expectedInverse, "Invert");
+
+    // Quaternion round trip
+    double quaternion[4] = {0, 0, 0, 0};
+    transformA.GetQuaternion(quaternion);
+    PlusRigidTransform rotatedTransform = transformA;
+    rotatedTransform.SetQuaternion(quaternion);
+    numberOfErrors += CompareMatrices(rotatedTransform, matrixA, "Quaternion conversion");
+
+    // Interpolation: the interpolated rotation is on the shortest arc between the rotations, so the angles to
+    // the two rotations add up to the angle between them, in proportion to the weights
+    const double weightB = vtkMath::Random(0, 1);
+    PlusRigidTransform interpolatedTransform = PlusRigidTransform::Interpolate(transformA, transformB, weightB);
+    double angleAB = PlusRigidTransform::GetOrientationDifferenceDeg(transformA, transformB);
+    double angleA = PlusRigidTransform::GetOrientationDifferenceDeg(interpolatedTransform, transformA);
+    double angleB = PlusRigidTransform::GetOrientationDifferenceDeg(interpolatedTransform, transformB);
+    if (std::fabs(angleA - weightB * angleAB) > 1e-4 || std::fabs(angleB - (1 - weightB) * angleAB) > 1e-4)
+    {
+      LOG_ERROR("Interpolated rotation mismatch: angles to A and B are " << angleA << " and " << angleB << " deg, angle between A and B is " << angleAB << " deg, weight of B is " << weightB);
+      numberOfErrors++;
+    }
+    double translationA[3];
+    double translationB[3];
+    double interpolatedTranslation[3];
+    transformA.GetTranslation(translationA);
+    transformB.GetTranslation(translationB);
+    interpolatedTransform.GetTranslation(interpolatedTranslation);
+    for (int i = 0; i < 3; ++i)
+    {
+      if (std::fabs(interpolatedTranslation[i] - (translationA[i] * (1 - weightB) + translationB[i] * weightB)) > TOLERANCE)
+      {
+        LOG_ERROR("Interpolated translation mismatch in component " << i);
+        numberOfErrors++;
+      }
+    }
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
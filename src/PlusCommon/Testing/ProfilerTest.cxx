@@ -0,0 +1,142 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file ProfilerTest.cxx
+  \brief Tests recording of profiling zones by PlusProfiler.
+
+  Several named threads record nested zones: no zone may be recorded while recording is disabled, all zones
+  must be recorded while it is enabled, and the written Chrome trace must contain the thread names and zone details.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusProfiler.h"
+
+#include <vtksys/CommandLineArguments.hxx>
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  void RecordZones(int threadIndex, int numberOfZones)
+  {
+    std::ostringstream threadName;
+    threadName << "ProfilerTestThread" << threadIndex;
+    PlusProfiler::GetInstance().SetCurrentThreadName(threadName.str());
+    for (int i = 0; i < numberOfZones; ++i)
+    {
+      PlusProfiler::Zone outerZone("ProfilerTest::Outer", threadName.str());
+      PlusProfiler::Zone innerZone("ProfilerTest::Inner");
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void RunThreads(int numberOfThreads, int numberOfZonesPerThread)
+  {
+    std::vector<std::thread> threads;
+    for (int threadIndex = 0; threadIndex < numberOfThreads; ++threadIndex)
+    {
+      threads.push_back(std::thread(RecordZones, threadIndex, numberOfZonesPerThread));
+    }
+    for (std::vector<std::thread>::iterator threadIt = threads.begin(); threadIt != threads.end(); ++threadIt)
+    {
+      threadIt->join();
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp = false;
+  int numberOfThreads = 4;
+  int numberOfZonesPerThread = 1000;
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--threads", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfThreads, "Number of recording threads (Default: 4).");
+  args.AddArgument("--zones-per-thread", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfZonesPerThread, "Number of outer zones recorded by each thread (Default: 1000).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors = 0;
+  PlusProfiler& profiler = PlusProfiler::GetInstance();
+
+  // Recording is disabled by default
+  RunThreads(numberOfThreads, numberOfZonesPerThread);
+  if (profiler.GetNumberOfRecordedZones() != 0)
+  {
+    LOG_ERROR("Zones were recorded while recording was disabled: " << profiler.GetNumberOfRecordedZones());
+    numberOfErrors++;
+  }
+
+  std::string outputFilename("ProfilerTest.json");
+  profiler.Start(outputFilename);
+  RunThreads(numberOfThreads, numberOfZonesPerThread);
+  size_t expectedNumberOfZones = static_cast<size_t>(numberOfThreads) * numberOfZonesPerThread * 2;
+  if (profiler.GetNumberOfRecordedZones() != expectedNumberOfZones)
+  {
+    LOG_ERROR("Number of recorded zones is " << profiler.GetNumberOfRecordedZones() << ", expected " << expectedNumberOfZones);
+    numberOfErrors++;
+  }
+  if (profiler.Stop() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to write profiling trace to " << outputFilename);
+    return EXIT_FAILURE;
+  }
+
+  std::ifstream traceFile(outputFilename.c_str());
+  std::string trace((std::istreambuf_iterator<char>(traceFile)), std::istreambuf_iterator<char>());
+  for (int threadIndex = 0; threadIndex < numberOfThreads; ++threadIndex)
+  {
+    std::ostringstream threadName;
+    threadName << "ProfilerTestThread" << threadIndex;
+    if (trace.find("\"args\":{\"name\":\"" + threadName.str() + "\"}") == std::string::npos)
+    {
+      LOG_ERROR("Thread name " << threadName.str() << " is not found in the trace");
+      numberOfErrors++;
+    }
+    if (trace.find("\"args\":{\"detail\":\"" + threadName.str() + "\"}") == std::string::npos)
+    {
+      LOG_ERROR("Zone detail " << threadName.str() << " is not found in the trace");
+      numberOfErrors++;
+    }
+  }
+  if (trace.find("\"name\":\"ProfilerTest::Inner\",\"ph\":\"X\"") == std::string::npos)
+  {
+    LOG_ERROR("Inner zones are not found in the trace");
+    numberOfErrors++;
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
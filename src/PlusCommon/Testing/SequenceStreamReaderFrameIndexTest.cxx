@@ -0,0 +1,305 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file SequenceStreamReaderFrameIndexTest.cxx
+  \brief Tests seeking in compressed sequence files with vtkPlusSequenceStreamReader and its frame index file.
+
+  A compressed sequence is written that is large enough to have multiple access points. The frames are read
+  sequentially, then in an order that seeks backward and forward across the access points, each frame must match
+  the sequential read. Reading into a frame must not modify the pixels of other frames that share them. The frame index file that is written by the first backward seek must be reused when the
+  sequence is opened again, and must be rejected after the size or the modification time of the sequence file changes.
+*/
+
+#include "PlusConfigure.h"
+#include "vtkPlusConfig.h"
+#include "vtkPlusSequenceIO.h"
+#include "vtkPlusSequenceStreamReader.h"
+
+// IGSIO includes
+#include <igsioTrackedFrame.h>
+#include <igsioVideoFrame.h>
+#include <vtkIGSIOAccurateTimer.h>
+#include <vtkIGSIOTrackedFrameList.h>
+
+// VTK includes
+#include <vtkSmartPointer.h>
+#include <vtksys/CommandLineArguments.hxx>
+#include <vtksys/SystemTools.hxx>
+
+// STL includes
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+  /*! 30MB of pixel data, so that there are access points in the middle of the sequence (they are about 8MB apart) */
+  const unsigned int FRAME_WIDTH = 512;
+  const unsigned int FRAME_HEIGHT = 512;
+  const int NUMBER_OF_FRAMES = 120;
+
+  //----------------------------------------------------------------------------
+  /*! Open a sequence and provide access to the frame index file operations */
+  class vtkPlusSequenceStreamReaderTester : public vtkPlusSequenceStreamReader
+  {
+  public:
+    static vtkPlusSequenceStreamReaderTester* New()
+    {
+      return new vtkPlusSequenceStreamReaderTester;
+    }
+
+    PlusStatus LoadFrameIndexFile()
+    {
+      return this->ReadFrameIndexFile();
+    }
+
+    std::string GetIndexFilePath() const
+    {
+      return this->GetFrameIndexFilePath();
+    }
+  };
+
+  //----------------------------------------------------------------------------
+  /*! Compressible pixel data that is different in each frame */
+  void FillFrame(int frameIndex, unsigned char* pixel)
+  {
+    unsigned int state = 12345 + frameIndex;
+    for (unsigned int y = 0; y < FRAME_HEIGHT; ++y)
+    {
+      for (unsigned int x = 0; x < FRAME_WIDTH; ++x)
+      {
+        state = state * 1103515245u + 12345u;
+        *(pixel++) = static_cast<unsigned char>(x / 4 + y / 2 + frameIndex * 7 + ((state >> 16) & 0x0f));
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus WriteSequence(const std::string& filePath)
+  {
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> frameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    FrameSizeType frameSize = { FRAME_WIDTH, FRAME_HEIGHT, 1 };
+    for (int frameIndex = 0; frameIndex < NUMBER_OF_FRAMES; ++frameIndex)
+    {
+      igsioTrackedFrame frame;
+      frame.GetImageData()->AllocateFrame(frameSize, VTK_UNSIGNED_CHAR, 1);
+      frame.GetImageData()->SetImageOrientation(US_IMG_ORIENT_MF);
+      frame.GetImageData()->SetImageType(US_IMG_BRIGHTNESS);
+      frame.SetTimestamp(frameIndex * 0.1);
+      FillFrame(frameIndex, static_cast<unsigned char*>(frame.GetImageData()->GetScalarPointer()));
+      frameList->AddTrackedFrame(&frame);
+    }
+    return vtkPlusSequenceIO::Write(filePath, frameList, US_IMG_ORIENT_MF, true) == IGSIO_SUCCESS ? PLUS_SUCCESS : PLUS_FAIL;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Open the sequence with a new reader, so that nothing is reused from the previous reader */
+  PlusStatus OpenSequence(const std::string& filePath, vtkSmartPointer<vtkPlusSequenceStreamReaderTester>& reader)
+  {
+    reader = vtkSmartPointer<vtkPlusSequenceStreamReaderTester>::New();
+    // Frames are not cached, so that every read seeks in the pixel data
+    reader->SetFrameCacheSize(0);
+    reader->UseFrameIndexFileOn();
+    if (reader->Open(filePath) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to open sequence file: " << filePath);
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Read the frames in the specified order and compare them to the sequentially read frames */
+  int ReadFramesInOrder(vtkPlusSequenceStreamReader* reader, const std::vector<int>& frameIndices, const std::vector< std::vector<unsigned char> >& sequentialFrames)
+  {
+    int numberOfErrors = 0;
+    igsioTrackedFrame frame;
+    for (std::vector<int>::const_iterator frameIndexIt = frameIndices.begin(); frameIndexIt != frameIndices.end(); ++frameIndexIt)
+    {
+      if (reader->ReadFrame(*frameIndexIt, frame) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to read frame " << *frameIndexIt);
+        numberOfErrors++;
+        continue;
+      }
+      const std::vector<unsigned char>& expectedPixels = sequentialFrames[*frameIndexIt];
+      if (memcmp(frame.GetImageData()->GetScalarPointer(), &expectedPixels[0], expectedPixels.size()) != 0)
+      {
+        LOG_ERROR("Frame " << *frameIndexIt << " does not match the sequentially read frame");
+        numberOfErrors++;
+      }
+    }
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  const std::string filePath = vtkPlusConfig::GetInstance()->GetOutputPath("SequenceStreamReaderFrameIndexTest.mha");
+  if (WriteSequence(filePath) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to write sequence file: " << filePath);
+    return EXIT_FAILURE;
+  }
+
+  vtkSmartPointer<vtkPlusSequenceStreamReaderTester> reader;
+  if (OpenSequence(filePath, reader) != PLUS_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+  const std::string indexFilePath = reader->GetIndexFilePath();
+  vtksys::SystemTools::RemoveFile(indexFilePath);
+  if (!reader->GetCompressedData() || reader->GetNumberOfFrames() != NUMBER_OF_FRAMES)
+  {
+    LOG_ERROR("The sequence is expected to be compressed and contain " << NUMBER_OF_FRAMES << " frames");
+    return EXIT_FAILURE;
+  }
+
+  int numberOfErrors = 0;
+
+  // Sequential read, which does not need access points
+  std::vector< std::vector<unsigned char> > sequentialFrames(NUMBER_OF_FRAMES);
+  std::vector<unsigned char> expectedPixels(FRAME_WIDTH * FRAME_HEIGHT);
+  igsioTrackedFrame frame;
+  for (int frameIndex = 0; frameIndex < NUMBER_OF_FRAMES; ++frameIndex)
+  {
+    if (reader->ReadNextFrame(frame) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to read frame " << frameIndex << " sequentially");
+      return EXIT_FAILURE;
+    }
+    const unsigned char* pixels = static_cast<const unsigned char*>(frame.GetImageData()->GetScalarPointer());
+    sequentialFrames[frameIndex].assign(pixels, pixels + expectedPixels.size());
+    FillFrame(frameIndex, &expectedPixels[0]);
+    if (sequentialFrames[frameIndex] != expectedPixels)
+    {
+      LOG_ERROR("Sequentially read frame " << frameIndex << " does not match the written frame");
+      numberOfErrors++;
+    }
+  }
+  if (reader->GetNumberOfAccessPoints() != 0)
+  {
+    LOG_ERROR("Access points are built for sequential reading");
+    numberOfErrors++;
+  }
+
+  // Reading into a frame that shares its pixels with another frame does not modify the other frame
+  igsioVideoFrame sharingFrame;
+  sharingFrame.DeepCopyFrom(frame.GetImageData()->GetImage());
+  sharingFrame.GetImage()->ShallowCopy(frame.GetImageData()->GetImage());
+  if (reader->ReadFrame(0, frame) != PLUS_SUCCESS
+      || memcmp(sharingFrame.GetScalarPointer(), &sequentialFrames[NUMBER_OF_FRAMES - 1][0], sequentialFrames[NUMBER_OF_FRAMES - 1].size()) != 0)
+  {
+    LOG_ERROR("Reading a frame modified the pixels of a frame that shared them");
+    numberOfErrors++;
+  }
+
+  // Seek backward and forward across the access points
+  const int readOrder[] = { NUMBER_OF_FRAMES - 1, 0, NUMBER_OF_FRAMES / 2, 5, NUMBER_OF_FRAMES - 2, NUMBER_OF_FRAMES / 3, NUMBER_OF_FRAMES / 3 + 1,
+                            1, 2 * NUMBER_OF_FRAMES / 3, NUMBER_OF_FRAMES / 4, NUMBER_OF_FRAMES - 1, NUMBER_OF_FRAMES / 2 - 1
+                          };
+  std::vector<int> frameIndices(readOrder, readOrder + sizeof(readOrder) / sizeof(readOrder[0]));
+  numberOfErrors += ReadFramesInOrder(reader, frameIndices, sequentialFrames);
+  const int numberOfAccessPoints = reader->GetNumberOfAccessPoints();
+  if (numberOfAccessPoints < 3)
+  {
+    LOG_ERROR("The seeks did not cross access points, number of access points: " << numberOfAccessPoints);
+    numberOfErrors++;
+  }
+  if (!vtksys::SystemTools::FileExists(indexFilePath, true))
+  {
+    LOG_ERROR("Frame index file is not written: " << indexFilePath);
+    return EXIT_FAILURE;
+  }
+  reader->Close();
+
+  // The frame index file is reused when the sequence is opened again
+  if (OpenSequence(filePath, reader) != PLUS_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+  if (reader->LoadFrameIndexFile() != PLUS_SUCCESS || reader->GetNumberOfAccessPoints() != numberOfAccessPoints)
+  {
+    LOG_ERROR("Frame index file is not reused: " << indexFilePath);
+    numberOfErrors++;
+  }
+  std::reverse(frameIndices.begin(), frameIndices.end());
+  numberOfErrors += ReadFramesInOrder(reader, frameIndices, sequentialFrames);
+  reader->Close();
+
+  // The frame index file is rejected if the size of the sequence file changes (data after the pixel data is ignored)
+  {
+    std::ofstream sequenceFile(filePath.c_str(), std::ios::out | std::ios::binary | std::ios::app);
+    sequenceFile.put('\n');
+  }
+  if (OpenSequence(filePath, reader) != PLUS_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+  if (reader->LoadFrameIndexFile() == PLUS_SUCCESS)
+  {
+    LOG_ERROR("Frame index file is not rejected after the size of the sequence file changed");
+    numberOfErrors++;
+  }
+  // the index is built and written again
+  if (OpenSequence(filePath, reader) != PLUS_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+  numberOfErrors += ReadFramesInOrder(reader, frameIndices, sequentialFrames);
+  reader->Close();
+  if (OpenSequence(filePath, reader) != PLUS_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+  if (reader->LoadFrameIndexFile() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Frame index file is not written again after it was rejected: " << indexFilePath);
+    numberOfErrors++;
+  }
+  reader->Close();
+
+  // The frame index file is rejected if the modification time of the sequence file changes (the file system may store it in seconds)
+  vtkIGSIOAccurateTimer::Delay(2.1);
+  vtksys::SystemTools::Touch(filePath, false);
+  if (OpenSequence(filePath, reader) != PLUS_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+  if (reader->LoadFrameIndexFile() == PLUS_SUCCESS)
+  {
+    LOG_ERROR("Frame index file is not rejected after the modification time of the sequence file changed");
+    numberOfErrors++;
+  }
+  reader->Close();
+
+  vtksys::SystemTools::RemoveFile(indexFilePath);
+  vtksys::SystemTools::RemoveFile(filePath);
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("SequenceStreamReaderFrameIndexTest failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+  LOG_INFO("SequenceStreamReaderFrameIndexTest completed successfully");
+  return EXIT_SUCCESS;
+}
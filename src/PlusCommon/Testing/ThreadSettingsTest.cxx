@@ -0,0 +1,117 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file ThreadSettingsTest.cxx
+  \brief Tests reading, writing and applying PlusThreadSettings.
+
+  Settings are read from prefixed attributes, written back and read again, they must be unchanged. Then a thread
+  is pinned to the first CPU, which does not require elevated privileges, and its effective affinity is checked.
+  Priority and memory locking are not applied, as they may not be permitted on the test machine.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusThreadSettings.h"
+
+#include <vtkSmartPointer.h>
+#include <vtkXMLDataElement.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+#include <thread>
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp = false;
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors = 0;
+
+  vtkSmartPointer<vtkXMLDataElement> element = vtkSmartPointer<vtkXMLDataElement>::New();
+  element->SetName("Device");
+  element->SetAttribute("AcquisitionThreadPriority", "realtime");
+  element->SetAttribute("AcquisitionThreadMmcssTask", "Pro Audio");
+  element->SetAttribute("AcquisitionThreadCpuAffinityMask", "0x0C");
+  element->SetAttribute("AcquisitionThreadLockMemory", "TRUE");
+
+  PlusThreadSettings settings;
+  if (!settings.IsDefault())
+  {
+    LOG_ERROR("Settings are not the defaults after construction");
+    numberOfErrors++;
+  }
+  if (settings.ReadConfiguration(element, "AcquisitionThread") != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to read thread settings");
+    return EXIT_FAILURE;
+  }
+  if (settings.Priority != PlusThreadSettings::PRIORITY_REALTIME || settings.MmcssTask != "Pro Audio"
+      || settings.CpuAffinityMask != 0x0C || !settings.LockMemory)
+  {
+    LOG_ERROR("Thread settings are not read correctly: " << PlusThreadSettings::GetPriorityClassAsString(settings.Priority) << ", "
+              << settings.MmcssTask << ", " << settings.CpuAffinityMask << ", " << settings.LockMemory);
+    numberOfErrors++;
+  }
+
+  vtkSmartPointer<vtkXMLDataElement> writtenElement = vtkSmartPointer<vtkXMLDataElement>::New();
+  writtenElement->SetName("PlusOpenIGTLinkServer");
+  settings.WriteConfiguration(writtenElement, "Thread");
+  PlusThreadSettings readBackSettings;
+  if (readBackSettings.ReadConfiguration(writtenElement, "Thread") != PLUS_SUCCESS || readBackSettings != settings)
+  {
+    LOG_ERROR("Thread settings are changed by writing and reading them");
+    numberOfErrors++;
+  }
+
+  PlusThreadSettings pinnedSettings;
+  pinnedSettings.CpuAffinityMask = 0x01;
+  std::string threadDescription;
+  std::thread pinnedThread([&pinnedSettings, &threadDescription, &numberOfErrors]()
+  {
+    if (pinnedSettings.ApplyToCurrentThread("ThreadSettingsTest") != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to pin the thread to CPU 0");
+      numberOfErrors++;
+    }
+    threadDescription = PlusThreadSettings::GetCurrentThreadDescription();
+  });
+  pinnedThread.join();
+#if defined(__linux__) || defined(_WIN32)
+  if (threadDescription.find("CPU 0,") == std::string::npos)
+  {
+    LOG_ERROR("Effective CPU affinity is not CPU 0: " << threadDescription);
+    numberOfErrors++;
+  }
+#endif
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
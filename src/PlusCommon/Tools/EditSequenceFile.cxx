@@ -8,7 +8,10 @@ See License.txt for details.
 #include "PlusConfigure.h"
 #include "PlusMath.h"
 #include "igsioTrackedFrame.h"
+#include "vtkPlusConfig.h"
+#include "vtkPlusSequenceFileWriter.h"
 #include "vtkPlusSequenceIO.h"
+#include "vtkPlusSequenceStreamReader.h"
 #include "vtkIGSIOTrackedFrameList.h"
 #include "vtkIGSIOTransformRepository.h"
 
@@ -21,6 +24,10 @@ See License.txt for details.
 #include <vtkXMLUtilities.h>
 #include <vtksys/CommandLineArguments.hxx>
 #include <vtksys/RegularExpression.hxx>
+#include <vtksys/SystemTools.hxx>
+
+// STL includes
+#include <algorithm>
 
 enum OperationType
 {
@@ -52,6 +59,8 @@ public:
     FrameScalarDecimalDigits = 5;
     FrameTransformStart = NULL;
     FrameTransformIncrement = NULL;
+    NextFrameValuesInitialized = false;
+    NextFrameScalar = 0;
   }
 
   std::string               FieldName;
@@ -64,6 +73,48 @@ public:
   vtkMatrix4x4*             FrameTransformStart;
   vtkMatrix4x4*             FrameTransformIncrement;
   std::string               FrameTransformIndexFieldName;
+
+  // Scalar and transform values of the next updated frame, they continue from one frame list to the next
+  bool                          NextFrameValuesInitialized;
+  double                        NextFrameScalar;
+  vtkSmartPointer<vtkTransform> NextFrameTransform;
+};
+
+// Parameters of the operation, set once from the command-line arguments
+struct EditParameters
+{
+  EditParameters()
+  {
+    Operation = NO_OPERATION;
+    FirstFrameIndex = 0;
+    LastFrameIndex = 0;
+    DecimationFactor = 2;
+    IncrementTimestamps = false;
+    UseCompression = false;
+    FillGrayLevel = 0;
+    UpdateReferenceTransform = false;
+  }
+
+  OperationType                       Operation;
+  std::string                         FieldName;
+  std::string                         UpdatedFieldName;
+  std::string                         UpdatedFieldValue;
+  FrameFieldUpdate                    FieldUpdate;
+  int                                 FirstFrameIndex;
+  int                                 LastFrameIndex;
+  int                                 DecimationFactor;
+  bool                                IncrementTimestamps;
+  bool                                UseCompression;
+  std::vector<std::string>            TransformNamesToAdd;
+  vtkSmartPointer<vtkXMLDataElement>  DeviceSetConfiguration;
+  std::vector<unsigned int>           FillRectOrigin;
+  std::vector<unsigned int>           FillRectSize;
+  int                                 FillGrayLevel;
+  std::vector<int>                    CropRectOrigin;
+  std::vector<int>                    CropRectSize;
+  igsioVideoFrame::FlipInfoType       FlipInfo;
+  bool                                UpdateReferenceTransform;
+  igsioTransformName                  ReferenceTransformName;
 };
 
 PlusStatus TrimSequenceFile(vtkIGSIOTrackedFrameList* trackedFrameList, unsigned int firstFrameIndex, unsigned int lastFrameIndex);
@@ -71,7 +122,8 @@ PlusStatus DecimateSequenceFile(vtkIGSIOTrackedFrameList* trackedFrameList, unsi
 PlusStatus UpdateFrameFieldValue(FrameFieldUpdate& fieldUpdate);
 PlusStatus DeleteFrameField(vtkIGSIOTrackedFrameList* trackedFrameList, std::string fieldName);
 PlusStatus ConvertStringToMatrix(std::string& strMatrix, vtkMatrix4x4* matrix);
-PlusStatus AddTransform(vtkIGSIOTrackedFrameList* trackedFrameList, std::vector<std::string> transformNamesToAdd, std::string deviceSetConfigurationFileName);
+PlusStatus AddTransform(vtkIGSIOTrackedFrameList* trackedFrameList, const std::vector<std::string>& transformNamesToAdd, vtkXMLDataElement* deviceSetConfiguration);
+PlusStatus UpdateReferenceTransform(vtkIGSIOTrackedFrameList* trackedFrameList, const igsioTransformName& referenceTransformName);
 PlusStatus FillRectangle(vtkIGSIOTrackedFrameList* trackedFrameList, const std::vector<unsigned int>& fillRectOrigin, const std::vector<unsigned int>& fillRectSize, int fillGrayLevel);
 PlusStatus CropRectangle(vtkIGSIOTrackedFrameList* trackedFrameList, igsioVideoFrame::FlipInfoType& flipInfo, const std::vector<int>& cropRectOrigin, const std::vector<int>& cropRectSize);
 
@@ -79,6 +131,9 @@ namespace
 {
   const std::string FIELD_VALUE_FRAME_SCALAR = "{frame-scalar}";
   const std::string FIELD_VALUE_FRAME_TRANSFORM = "{frame-transform}";
+
+  // Maximum size of the pixel data of the frames that are edited together when the sequence is streamed
+  const size_t MAX_STREAMED_BATCH_SIZE_BYTES = 64 * 1024 * 1024;
 }
 
 // Fuse all fields in sequence files into the first sequence
@@ -159,41 +214,534 @@ PlusStatus MixTrackedFrameLists(vtkIGSIOTrackedFrameList* trackedFrameList, std:
       }
     }
   }
-  return PLUS_SUCCESS;
-}
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+// Append tracked frame list (one after the other)
+PlusStatus AppendTrackedFrameLists(vtkIGSIOTrackedFrameList* trackedFrameList, std::vector<std::string> inputFileNames, bool incrementTimestamps)
+{
+  double lastTimestamp = 0;
+  for (unsigned int i = 0; i < inputFileNames.size(); i++)
+  {
+    LOG_INFO("Read input sequence file: " << inputFileNames[i]);
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> timestampFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    if (vtkPlusSequenceIO::Read(inputFileNames[i], timestampFrameList) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Couldn't read sequence file: " << inputFileNames[0]);
+      return PLUS_FAIL;
+    }
+
+    if (incrementTimestamps)
+    {
+      vtkIGSIOTrackedFrameList* tfList = timestampFrameList;
+      for (unsigned int f = 0; f < tfList->GetNumberOfTrackedFrames(); ++f)
+      {
+        igsioTrackedFrame* tf = tfList->GetTrackedFrame(f);
+        tf->SetTimestamp(lastTimestamp + tf->GetTimestamp());
+      }
+
+      lastTimestamp = tfList->GetTrackedFrame(tfList->GetNumberOfTrackedFrames() - 1)->GetTimestamp();
+    }
+
+    if (trackedFrameList->AddTrackedFrameList(timestampFrameList) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to append tracked frame list!");
+      return PLUS_FAIL;
+    }
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+// Read only the frames that the operation keeps, without decoding the pixel data of the removed frames.
+// Returns PLUS_FAIL if the file cannot be read frame by frame, then the whole file has to be read.
+PlusStatus ReadSelectedFrames(vtkIGSIOTrackedFrameList* trackedFrameList, const std::string& inputFileName, OperationType operation,
+                              int firstFrameIndex, int lastFrameIndex, int decimationFactor, bool& invalidParameters)
+{
+  invalidParameters = false;
+  if (!vtkPlusSequenceStreamReader::CanReadFile(inputFileName))
+  {
+    return PLUS_FAIL;
+  }
+  vtkSmartPointer<vtkPlusSequenceStreamReader> reader = vtkSmartPointer<vtkPlusSequenceStreamReader>::New();
+  if (reader->Open(inputFileName) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  std::vector<int> frameIndices;
+  if (operation == TRIM)
+  {
+    LOG_INFO("Trim sequence file from frame #: " << firstFrameIndex << " to frame #" << lastFrameIndex);
+    if (lastFrameIndex >= reader->GetNumberOfFrames() || firstFrameIndex > lastFrameIndex)
+    {
+      LOG_ERROR("Invalid input range: (" << firstFrameIndex << ", " << lastFrameIndex << ")" << " Permitted range within (0, " << reader->GetNumberOfFrames() - 1 << ")");
+      invalidParameters = true;
+      return PLUS_FAIL;
+    }
+    for (int frameIndex = firstFrameIndex; frameIndex <= lastFrameIndex; frameIndex++)
+    {
+      frameIndices.push_back(frameIndex);
+    }
+  }
+  else if (operation == DECIMATE)
+  {
+    LOG_INFO("Decimate sequence file: keep 1 frame out of every " << decimationFactor << " frames");
+    if (decimationFactor < 2)
+    {
+      LOG_ERROR("Invalid decimation factor: " << decimationFactor << ". It must be an integer larger or equal than 2.");
+      invalidParameters = true;
+      return PLUS_FAIL;
+    }
+    for (int frameIndex = 0; frameIndex < reader->GetNumberOfFrames(); frameIndex += decimationFactor)
+    {
+      frameIndices.push_back(frameIndex);
+    }
+  }
+  else
+  {
+    for (int frameIndex = 0; frameIndex < reader->GetNumberOfFrames(); frameIndex++)
+    {
+      frameIndices.push_back(frameIndex);
+    }
+  }
+
+  // Frames are read in increasing order, so compressed pixel data is decompressed only once
+  return reader->ReadFrames(trackedFrameList, frameIndices, operation != REMOVE_IMAGE_DATA);
+}
+
+//----------------------------------------------------------------------------
+// Apply the operations that edit each frame independently of the other frames. It is called either with all frames
+// or batch by batch when the sequence is streamed, frame field values continue from the previous batch.
+PlusStatus EditFrames(vtkIGSIOTrackedFrameList* trackedFrameList, EditParameters& params)
+{
+  switch (params.Operation)
+  {
+    case NO_OPERATION:
+    case APPEND:
+    case MIX:
+    case TRIM:
+    case DECIMATE:
+    case REMOVE_IMAGE_DATA:
+      {
+        // Frames are selected or merged when they are read, image data is removed when writing the output
+      }
+      break;
+    case UPDATE_FRAME_FIELD_NAME:
+      {
+        params.FieldUpdate.TrackedFrameList = trackedFrameList;
+        if (UpdateFrameFieldValue(params.FieldUpdate) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to update frame field name '" << params.FieldName << "' to '" << params.UpdatedFieldName << "'");
+          return PLUS_FAIL;
+        }
+      }
+      break;
+    case UPDATE_FRAME_FIELD_VALUE:
+      {
+        params.FieldUpdate.TrackedFrameList = trackedFrameList;
+        if (UpdateFrameFieldValue(params.FieldUpdate) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to update frame field value");
+          return PLUS_FAIL;
+        }
+      }
+      break;
+    case DELETE_FRAME_FIELD:
+      {
+        if (DeleteFrameField(trackedFrameList, params.FieldName) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to delete frame field");
+          return PLUS_FAIL;
+        }
+      }
+      break;
+    case DELETE_FIELD:
+      {
+        if (trackedFrameList->SetCustomString(params.FieldName.c_str(), NULL) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to delete field: " << params.FieldName);
+          return PLUS_FAIL;
+        }
+      }
+      break;
+    case UPDATE_FIELD_NAME:
+      {
+        const char* fieldValue = trackedFrameList->GetCustomString(params.FieldName.c_str());
+        if (fieldValue != NULL)
+        {
+          std::string copyOfFieldValue(fieldValue);
+          // Delete field
+          if (trackedFrameList->SetCustomString(params.FieldName.c_str(), NULL) != PLUS_SUCCESS)
+          {
+            LOG_ERROR("Failed to delete field: " << params.FieldName);
+            return PLUS_FAIL;
+          }
+
+          // Add new field
+          if (trackedFrameList->SetCustomString(params.UpdatedFieldName.c_str(), copyOfFieldValue.c_str()) != PLUS_SUCCESS)
+          {
+            LOG_ERROR("Failed to update field '" << params.UpdatedFieldName << "' with value '" << copyOfFieldValue << "'");
+            return PLUS_FAIL;
+          }
+        }
+      }
+      break;
+    case UPDATE_FIELD_VALUE:
+      {
+        if (trackedFrameList->SetCustomString(params.FieldName.c_str(), params.UpdatedFieldValue.c_str()) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to update field '" << params.FieldName << "' with value '" << params.UpdatedFieldValue << "'");
+          return PLUS_FAIL;
+        }
+      }
+      break;
+    case ADD_TRANSFORM:
+      {
+        if (AddTransform(trackedFrameList, params.TransformNamesToAdd, params.DeviceSetConfiguration) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to add transforms");
+          return PLUS_FAIL;
+        }
+      }
+      break;
+    case FILL_IMAGE_RECTANGLE:
+      {
+        // Fill a rectangular region in the image with a solid color
+        if (FillRectangle(trackedFrameList, params.FillRectOrigin, params.FillRectSize, params.FillGrayLevel) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to fill rectangle");
+          return PLUS_FAIL;
+        }
+      }
+      break;
+    case CROP:
+      {
+        // Crop a rectangular region from the image
+        if (CropRectangle(trackedFrameList, params.FlipInfo, params.CropRectOrigin, params.CropRectSize) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to crop rectangle");
+          return PLUS_FAIL;
+        }
+      }
+      break;
+    default:
+      {
+        LOG_ERROR("Unknown operation is specified");
+        return PLUS_FAIL;
+      }
+  }
+
+  // Convert files to the new file format
+  if (params.UpdateReferenceTransform && UpdateReferenceTransform(trackedFrameList, params.ReferenceTransformName) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+// Returns true if the operation changes only the fields of the sequence, so the pixel data can be copied unchanged
+bool IsFieldOnlyOperation(OperationType operation)
+{
+  switch (operation)
+  {
+    case NO_OPERATION:
+    case APPEND:
+    case UPDATE_FRAME_FIELD_NAME:
+    case UPDATE_FRAME_FIELD_VALUE:
+    case DELETE_FRAME_FIELD:
+    case UPDATE_FIELD_NAME:
+    case UPDATE_FIELD_VALUE:
+    case DELETE_FIELD:
+    case ADD_TRANSFORM:
+      return true;
+    default:
+      return false;
+  }
+}
+
+//----------------------------------------------------------------------------
+// Returns true if the frame of the concatenated input sequences is kept by the operation
+bool IsFrameSelected(const EditParameters& params, int frameIndex)
+{
+  if (params.Operation == TRIM)
+  {
+    return frameIndex >= params.FirstFrameIndex && frameIndex <= params.LastFrameIndex;
+  }
+  if (params.Operation == DECIMATE)
+  {
+    return frameIndex % params.DecimationFactor == 0;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Returns the path of the file without extension, the external pixel data file of .mhd sequences is named after it
+std::string GetSequenceFileBasePath(const std::string& fileName)
+{
+  std::string filePath = vtksys::SystemTools::CollapseFullPath(fileName);
+  return vtksys::SystemTools::GetFilenamePath(filePath) + "/" + vtksys::SystemTools::GetFilenameWithoutLastExtension(filePath);
+}
+
+//----------------------------------------------------------------------------
+// Sequence whose frame fields are mixed into the frames of the first sequence (by the MIX operation)
+struct MixedSequence
+{
+  vtkPlusSequenceStreamReader*  Reader;
+  std::vector<double>           Timestamps;
+  int                           FrameIndex;
+};
+
+//----------------------------------------------------------------------------
+// Copy the fields of the frames with the closest timestamp. Frames are processed in increasing timestamp order,
+// so the search continues from the frame found for the previous frame.
+PlusStatus MixFrameFields(vtkIGSIOTrackedFrameList* trackedFrameList, std::vector<MixedSequence>& mixedSequences)
+{
+  for (unsigned int f = 0; f < trackedFrameList->GetNumberOfTrackedFrames(); ++f)
+  {
+    igsioTrackedFrame* masterTrackedFrame = trackedFrameList->GetTrackedFrame(f);
+    for (std::vector<MixedSequence>::iterator sequenceIt = mixedSequences.begin(); sequenceIt != mixedSequences.end(); ++sequenceIt)
+    {
+      if (sequenceIt->Timestamps.empty())
+      {
+        continue;
+      }
+
+      // Determine which additional frame belongs to this master frame: use the next frame if it is closer in time
+      while (sequenceIt->FrameIndex + 1 < static_cast<int>(sequenceIt->Timestamps.size())
+             && masterTrackedFrame->GetTimestamp() > (sequenceIt->Timestamps[sequenceIt->FrameIndex] + sequenceIt->Timestamps[sequenceIt->FrameIndex + 1]) / 2.0)
+      {
+        sequenceIt->FrameIndex++;
+      }
+
+      // Copy frame fields
+      igsioTrackedFrame additionalFrame;
+      if (sequenceIt->Reader->GetFrameFields(sequenceIt->FrameIndex, additionalFrame) != PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+      auto customFrameFields = additionalFrame.GetCustomFields();
+      for (auto fieldIter = customFrameFields.begin(); fieldIter != customFrameFields.end(); ++fieldIter)
+      {
+        if (!fieldIter->first.compare("FrameNumber") ||
+            !fieldIter->first.compare("Timestamp") ||
+            !fieldIter->first.compare("UnfilteredTimestamp") ||
+            !fieldIter->first.compare("ImageStatus"))
+        {
+          // Timing and image information is taken from the first sequence
+          continue;
+        }
+        masterTrackedFrame->SetFrameField(fieldIter->first, fieldIter->second.second, fieldIter->second.first);
+      }
+    }
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+// Read, edit and write the frames batch by batch, the pixel data of a batch is at most MAX_STREAMED_BATCH_SIZE_BYTES
+PlusStatus StreamFrames(const std::vector< vtkSmartPointer<vtkPlusSequenceStreamReader> >& readers, const std::vector<std::string>& inputFileNames,
+                        vtkPlusSequenceFileWriter* writer, EditParameters& params)
+{
+  // The MIX operation writes the frames of the first sequence only, with fields from all sequences
+  std::vector<MixedSequence> mixedSequences;
+  size_t numberOfWrittenSequences = readers.size();
+  if (params.Operation == MIX)
+  {
+    numberOfWrittenSequences = 1;
+    for (size_t readerIndex = 1; readerIndex < readers.size(); ++readerIndex)
+    {
+      MixedSequence mixedSequence;
+      mixedSequence.Reader = readers[readerIndex];
+      mixedSequence.FrameIndex = 0;
+      for (int frameIndex = 0; frameIndex < readers[readerIndex]->GetNumberOfFrames(); ++frameIndex)
+      {
+        igsioTrackedFrame frame;
+        if (readers[readerIndex]->GetFrameFields(frameIndex, frame) != PLUS_SUCCESS)
+        {
+          return PLUS_FAIL;
+        }
+        mixedSequence.Timestamps.push_back(frame.GetTimestamp());
+      }
+      mixedSequences.push_back(mixedSequence);
+    }
+  }
+
+  int inputFrameIndex = 0; // index of the frame in the concatenated input sequences
+  double timestampOffset = 0.0;
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  for (size_t readerIndex = 0; readerIndex < numberOfWrittenSequences; ++readerIndex)
+  {
+    vtkPlusSequenceStreamReader* reader = readers[readerIndex];
+    LOG_INFO("Read input sequence file: " << inputFileNames[readerIndex]);
+
+    FrameSizeType frameSize = { 0, 0, 0 };
+    reader->GetFrameSize(frameSize);
+    const size_t frameSizeBytes = std::max<size_t>(1, static_cast<size_t>(frameSize[0]) * frameSize[1] * frameSize[2]
+                                  * reader->GetNumberOfScalarComponents() * igsioVideoFrame::GetNumberOfBytesPerScalar(reader->GetPixelType()));
+    const size_t maxFramesPerBatch = std::max<size_t>(1, MAX_STREAMED_BATCH_SIZE_BYTES / frameSizeBytes);
+
+    std::vector<int> frameIndices;
+    for (int frameIndex = 0; frameIndex < reader->GetNumberOfFrames(); ++frameIndex, ++inputFrameIndex)
+    {
+      if (IsFrameSelected(params, inputFrameIndex))
+      {
+        frameIndices.push_back(frameIndex);
+      }
+      if (frameIndices.empty() || (frameIndices.size() < maxFramesPerBatch && frameIndex + 1 < reader->GetNumberOfFrames()))
+      {
+        continue;
+      }
+
+      trackedFrameList->Clear();
+      if (reader->ReadFrames(trackedFrameList, frameIndices, true) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Couldn't read sequence file: " << inputFileNames[readerIndex]);
+        return PLUS_FAIL;
+      }
+      frameIndices.clear();
+
+      if (timestampOffset != 0.0)
+      {
+        for (unsigned int f = 0; f < trackedFrameList->GetNumberOfTrackedFrames(); ++f)
+        {
+          igsioTrackedFrame* tf = trackedFrameList->GetTrackedFrame(f);
+          tf->SetTimestamp(timestampOffset + tf->GetTimestamp());
+        }
+      }
+      if (!mixedSequences.empty() && MixFrameFields(trackedFrameList, mixedSequences) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to mix frame fields");
+        return PLUS_FAIL;
+      }
+      if (EditFrames(trackedFrameList, params) != PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+      if (writer->AppendFrames(trackedFrameList) != PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+    }
+
+    if (params.IncrementTimestamps && reader->GetNumberOfFrames() > 0)
+    {
+      igsioTrackedFrame lastFrame;
+      if (reader->GetFrameFields(reader->GetNumberOfFrames() - 1, lastFrame) != PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+      timestampOffset += lastFrame.GetTimestamp();
+    }
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+// Edit the sequence without loading it into memory: frames are read, edited and written batch by batch. If only the fields
+// of a single sequence are changed then the pixel data is copied without decompressing it. streamable is set to false
+// (and nothing is written) if the input files cannot be read frame by frame, then the sequence has to be edited in memory.
+PlusStatus StreamEditSequenceFiles(const std::vector<std::string>& inputFileNames, const std::string& outputFileName, EditParameters& params, bool& streamable)
+{
+  streamable = false;
+  std::string outputFilePath = outputFileName;
+  if (!vtksys::SystemTools::FileIsFullPath(outputFileName) && !vtkPlusConfig::GetInstance()->GetOutputDirectory().empty())
+  {
+    outputFilePath = vtkPlusConfig::GetInstance()->GetOutputDirectory() + "/" + outputFileName;
+  }
+
+  const std::string outputFileBasePath = GetSequenceFileBasePath(outputFilePath);
+  std::vector< vtkSmartPointer<vtkPlusSequenceStreamReader> > readers;
+  int numberOfInputFrames = 0;
+  for (std::vector<std::string>::const_iterator inputFileNameIt = inputFileNames.begin(); inputFileNameIt != inputFileNames.end(); ++inputFileNameIt)
+  {
+    // The output would overwrite the input while it is read
+    if (!vtkPlusSequenceStreamReader::CanReadFile(*inputFileNameIt) || GetSequenceFileBasePath(*inputFileNameIt) == outputFileBasePath)
+    {
+      return PLUS_FAIL;
+    }
+    vtkSmartPointer<vtkPlusSequenceStreamReader> reader = vtkSmartPointer<vtkPlusSequenceStreamReader>::New();
+    if (reader->Open(*inputFileNameIt) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    readers.push_back(reader);
+    numberOfInputFrames += reader->GetNumberOfFrames();
+  }
+  streamable = true;
+
+  if (params.Operation == MIX && readers[0]->GetNumberOfFrames() == 0)
+  {
+    LOG_ERROR("No frames in sequence file: " << inputFileNames[0]);
+    return PLUS_FAIL;
+  }
+  if (params.Operation == TRIM)
+  {
+    LOG_INFO("Trim sequence file from frame #: " << params.FirstFrameIndex << " to frame #" << params.LastFrameIndex);
+    if (params.LastFrameIndex >= numberOfInputFrames || params.FirstFrameIndex > params.LastFrameIndex)
+    {
+      LOG_ERROR("Invalid input range: (" << params.FirstFrameIndex << ", " << params.LastFrameIndex << ")" << " Permitted range within (0, " << numberOfInputFrames - 1 << ")");
+      return PLUS_FAIL;
+    }
+  }
+  else if (params.Operation == DECIMATE)
+  {
+    LOG_INFO("Decimate sequence file: keep 1 frame out of every " << params.DecimationFactor << " frames");
+    if (params.DecimationFactor < 2)
+    {
+      LOG_ERROR("Invalid decimation factor: " << params.DecimationFactor << ". It must be an integer larger or equal than 2.");
+      return PLUS_FAIL;
+    }
+  }
 
-//----------------------------------------------------------------------------
-// Append tracked frame list (one after the other)
-PlusStatus AppendTrackedFrameLists(vtkIGSIOTrackedFrameList* trackedFrameList, std::vector<std::string> inputFileNames, bool incrementTimestamps)
-{
-  double lastTimestamp = 0;
-  for (unsigned int i = 0; i < inputFileNames.size(); i++)
+  vtkSmartPointer<vtkPlusSequenceFileWriter> writer = vtkSmartPointer<vtkPlusSequenceFileWriter>::New();
+  writer->SetUseCompression(params.UseCompression);
+
+  if (readers.size() == 1 && IsFieldOnlyOperation(params.Operation) && readers[0]->GetCompressedData() == params.UseCompression)
   {
-    LOG_INFO("Read input sequence file: " << inputFileNames[i]);
-    vtkSmartPointer<vtkIGSIOTrackedFrameList> timestampFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
-    if (vtkPlusSequenceIO::Read(inputFileNames[i], timestampFrameList) != PLUS_SUCCESS)
+    // Only the fields are edited, the pixel data is copied as it is stored in the input file
+    LOG_INFO("Read input sequence file: " << inputFileNames[0]);
+    std::vector<int> frameIndices;
+    for (int frameIndex = 0; frameIndex < readers[0]->GetNumberOfFrames(); frameIndex++)
+    {
+      frameIndices.push_back(frameIndex);
+    }
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    if (readers[0]->ReadFrames(trackedFrameList, frameIndices, false) != PLUS_SUCCESS)
     {
       LOG_ERROR("Couldn't read sequence file: " << inputFileNames[0]);
       return PLUS_FAIL;
     }
-
-    if (incrementTimestamps)
+    if (EditFrames(trackedFrameList, params) != PLUS_SUCCESS)
     {
-      vtkIGSIOTrackedFrameList* tfList = timestampFrameList;
-      for (unsigned int f = 0; f < tfList->GetNumberOfTrackedFrames(); ++f)
-      {
-        igsioTrackedFrame* tf = tfList->GetTrackedFrame(f);
-        tf->SetTimestamp(lastTimestamp + tf->GetTimestamp());
-      }
-
-      lastTimestamp = tfList->GetTrackedFrame(tfList->GetNumberOfTrackedFrames() - 1)->GetTimestamp();
+      return PLUS_FAIL;
     }
-
-    if (trackedFrameList->AddTrackedFrameList(timestampFrameList) != PLUS_SUCCESS)
+    LOG_INFO("Save output sequence file to: " << outputFilePath);
+    if (writer->Open(outputFilePath, readers[0]->GetImageOrientationInFile()) != PLUS_SUCCESS
+        || writer->CopyFrames(readers[0], trackedFrameList) != PLUS_SUCCESS
+        || writer->Close() != PLUS_SUCCESS)
     {
-      LOG_ERROR("Failed to append tracked frame list!");
+      writer->Discard();
+      LOG_ERROR("Couldn't write sequence file: " << outputFilePath);
       return PLUS_FAIL;
     }
+    return PLUS_SUCCESS;
+  }
+
+  LOG_INFO("Save output sequence file to: " << outputFilePath);
+  if (writer->Open(outputFilePath) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Couldn't write sequence file: " << outputFilePath);
+    return PLUS_FAIL;
+  }
+  if (StreamFrames(readers, inputFileNames, writer, params) != PLUS_SUCCESS || writer->Close() != PLUS_SUCCESS)
+  {
+    writer->Discard();
+    LOG_ERROR("Couldn't write sequence file: " << outputFilePath);
+    return PLUS_FAIL;
   }
   return PLUS_SUCCESS;
 }
@@ -452,9 +1000,7 @@ int main(int argc, char** argv)
   }
 
   ///////////////////////////////////////////////////////////////////
-  // Read input files
-
-  vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  // Set up the operation
 
   if (!inputFileName.empty())
   {
@@ -462,159 +1008,94 @@ int main(int argc, char** argv)
     inputFileNames.insert(inputFileNames.begin(), inputFileName);
   }
 
-  // Multiple input files are appended unless sequences are mixed
-  PlusStatus status = PLUS_SUCCESS;
-  if (operation == MIX)
-  {
-    status = MixTrackedFrameLists(trackedFrameList, inputFileNames);
-  }
-  else
+  if (firstFrameIndex < 0)
   {
-    status = AppendTrackedFrameLists(trackedFrameList, inputFileNames, incrementTimestamps);
+    firstFrameIndex = 0;
   }
-  if (status == PLUS_FAIL)
+  if (lastFrameIndex < 0)
   {
-    return EXIT_FAILURE;
+    lastFrameIndex = 0;
   }
 
-  ///////////////////////////////////////////////////////////////////
-  // Make the operation
+  EditParameters params;
+  params.Operation = operation;
+  params.FieldName = fieldName;
+  params.UpdatedFieldName = updatedFieldName;
+  params.UpdatedFieldValue = updatedFieldValue;
+  params.FirstFrameIndex = firstFrameIndex;
+  params.LastFrameIndex = lastFrameIndex;
+  params.DecimationFactor = decimationFactor;
+  params.IncrementTimestamps = incrementTimestamps;
+  params.UseCompression = useCompression;
+  params.CropRectOrigin = rectOriginPix;
+  params.CropRectSize = rectSizePix;
+  params.FlipInfo.hFlip = flipX;
+  params.FlipInfo.vFlip = flipY;
+  params.FlipInfo.eFlip = flipZ;
+  params.FillGrayLevel = fillGrayLevel;
 
   switch (operation)
   {
-    case NO_OPERATION:
-    case APPEND:
-    case MIX:
-      {
-        // No need to do anything just save into output file
-      }
-      break;
-    case TRIM:
-      {
-        if (firstFrameIndex < 0)
-        {
-          firstFrameIndex = 0;
-        }
-        if (lastFrameIndex < 0)
-        {
-          lastFrameIndex = 0;
-        }
-        unsigned int firstFrameIndexUint = static_cast<unsigned int>(firstFrameIndex);
-        unsigned int lastFrameIndexUint = static_cast<unsigned int>(lastFrameIndex);
-        if (TrimSequenceFile(trackedFrameList, firstFrameIndexUint, lastFrameIndexUint) != PLUS_SUCCESS)
-        {
-          LOG_ERROR("Failed to trim sequence file");
-          return EXIT_FAILURE;
-        }
-      }
-      break;
-    case DECIMATE:
-      {
-        if (DecimateSequenceFile(trackedFrameList, decimationFactor) != PLUS_SUCCESS)
-        {
-          LOG_ERROR("Failed to decimate sequence file");
-          return EXIT_FAILURE;
-        }
-      }
-      break;
     case UPDATE_FRAME_FIELD_NAME:
       {
-        FrameFieldUpdate fieldUpdate;
-        fieldUpdate.TrackedFrameList = trackedFrameList;
-        fieldUpdate.FieldName = fieldName;
-        fieldUpdate.UpdatedFieldName = updatedFieldName;
-
-        if (UpdateFrameFieldValue(fieldUpdate) != PLUS_SUCCESS)
-        {
-          LOG_ERROR("Failed to update frame field name '" << fieldName << "' to '" << updatedFieldName << "'");
-          return EXIT_FAILURE;
-        }
+        LOG_INFO("Update frame field name '" << fieldName << "' to '" << updatedFieldName << "'");
+        params.FieldUpdate.FieldName = fieldName;
+        params.FieldUpdate.UpdatedFieldName = updatedFieldName;
       }
       break;
     case UPDATE_FRAME_FIELD_VALUE:
       {
-        FrameFieldUpdate fieldUpdate;
-        fieldUpdate.TrackedFrameList = trackedFrameList;
-        fieldUpdate.FieldName = fieldName;
-        fieldUpdate.UpdatedFieldName = updatedFieldName;
-        fieldUpdate.UpdatedFieldValue = updatedFieldValue;
-        fieldUpdate.FrameScalarDecimalDigits = frameScalarDecimalDigits;
-        fieldUpdate.FrameScalarIncrement = frameScalarIncrement;
-        fieldUpdate.FrameScalarStart = frameScalarStart;
-        fieldUpdate.FrameTransformStart = frameTransformStart;
-        fieldUpdate.FrameTransformIncrement = frameTransformIncrement;
-        fieldUpdate.FrameTransformIndexFieldName = strFrameTransformIndexFieldName;
-
-        if (UpdateFrameFieldValue(fieldUpdate) != PLUS_SUCCESS)
-        {
-          LOG_ERROR("Failed to update frame field value");
-          return EXIT_FAILURE;
-        }
+        LOG_INFO("Update frame field");
+        params.FieldUpdate.FieldName = fieldName;
+        params.FieldUpdate.UpdatedFieldName = updatedFieldName;
+        params.FieldUpdate.UpdatedFieldValue = updatedFieldValue;
+        params.FieldUpdate.FrameScalarDecimalDigits = frameScalarDecimalDigits;
+        params.FieldUpdate.FrameScalarIncrement = frameScalarIncrement;
+        params.FieldUpdate.FrameScalarStart = frameScalarStart;
+        params.FieldUpdate.FrameTransformStart = frameTransformStart;
+        params.FieldUpdate.FrameTransformIncrement = frameTransformIncrement;
+        params.FieldUpdate.FrameTransformIndexFieldName = strFrameTransformIndexFieldName;
       }
       break;
     case DELETE_FRAME_FIELD:
       {
-        if (DeleteFrameField(trackedFrameList, fieldName) != PLUS_SUCCESS)
-        {
-          LOG_ERROR("Failed to delete frame field");
-          return EXIT_FAILURE;
-        }
+        LOG_INFO("Delete frame field: " << fieldName);
       }
       break;
     case DELETE_FIELD:
       {
-        // Delete field
         LOG_INFO("Delete field: " << fieldName);
-        if (trackedFrameList->SetCustomString(fieldName.c_str(), NULL) != PLUS_SUCCESS)
-        {
-          LOG_ERROR("Failed to delete field: " << fieldName);
-          return EXIT_FAILURE;
-        }
       }
       break;
     case UPDATE_FIELD_NAME:
       {
-        // Update field name
         LOG_INFO("Update field name '" << fieldName << "' to  '" << updatedFieldName << "'");
-        const char* fieldValue = trackedFrameList->GetCustomString(fieldName.c_str());
-        if (fieldValue != NULL)
-        {
-          // Delete field
-          if (trackedFrameList->SetCustomString(fieldName.c_str(), NULL) != PLUS_SUCCESS)
-          {
-            LOG_ERROR("Failed to delete field: " << fieldName);
-            return EXIT_FAILURE;
-          }
-
-          // Add new field
-          if (trackedFrameList->SetCustomString(updatedFieldName.c_str(), fieldValue) != PLUS_SUCCESS)
-          {
-            LOG_ERROR("Failed to update field '" << updatedFieldName << "' with value '" << fieldValue << "'");
-            return EXIT_FAILURE;
-          }
-        }
       }
       break;
     case UPDATE_FIELD_VALUE:
       {
-        // Update field value
         LOG_INFO("Update field '" << fieldName << "' with value '" << updatedFieldValue << "'");
-        if (trackedFrameList->SetCustomString(fieldName.c_str(), updatedFieldValue.c_str()) != PLUS_SUCCESS)
-        {
-          LOG_ERROR("Failed to update field '" << fieldName << "' with value '" << updatedFieldValue << "'");
-          return EXIT_FAILURE;
-        }
       }
       break;
     case ADD_TRANSFORM:
       {
-        // Add transform
         LOG_INFO("Add transform '" << transformNamesToAdd << "' using device set configuration file '" << deviceSetConfigurationFileName << "'");
-        std::vector<std::string> transformNamesList;
-        igsioCommon::SplitStringIntoTokens(transformNamesToAdd, ',', transformNamesList);
-        if (AddTransform(trackedFrameList, transformNamesList, deviceSetConfigurationFileName) != PLUS_SUCCESS)
+        igsioCommon::SplitStringIntoTokens(transformNamesToAdd, ',', params.TransformNamesToAdd);
+        if (params.TransformNamesToAdd.empty())
+        {
+          LOG_ERROR("No transform names are specified to be added");
+          return EXIT_FAILURE;
+        }
+        if (deviceSetConfigurationFileName.empty())
+        {
+          LOG_ERROR("Used device set configuration file name is empty");
+          return EXIT_FAILURE;
+        }
+        // Read configuration
+        params.DeviceSetConfiguration = vtkSmartPointer<vtkXMLDataElement>::New();
+        if (PlusXmlUtils::ReadDeviceSetConfigurationFromFile(params.DeviceSetConfiguration, deviceSetConfigurationFileName.c_str()) == PLUS_FAIL)
         {
-          LOG_ERROR("Failed to add transform '" << transformNamesToAdd << "' using device set configuration file '" << deviceSetConfigurationFileName << "'");
+          LOG_ERROR("Unable to read configuration from file " << deviceSetConfigurationFileName.c_str());
           return EXIT_FAILURE;
         }
       }
@@ -624,143 +1105,120 @@ int main(int argc, char** argv)
         if (rectOriginPix.size() != 2 || rectSizePix.size() != 2)
         {
           LOG_ERROR("Incorrect size of vector for rectangle origin or size. Aborting.");
-          return PLUS_FAIL;
+          return EXIT_FAILURE;
         }
         if (rectOriginPix[0] < 0 || rectOriginPix[1] < 0 || rectSizePix[0] < 0 || rectSizePix[1] < 0)
         {
           LOG_ERROR("Negative value for rectangle origin or size entered. Aborting.");
-          return PLUS_FAIL;
-        }
-        std::vector<unsigned int> rectOriginPixUint(rectOriginPix.begin(), rectOriginPix.end());
-        std::vector<unsigned int> rectSizePixUint(rectSizePix.begin(), rectSizePix.end());
-        // Fill a rectangular region in the image with a solid color
-        if (FillRectangle(trackedFrameList, rectOriginPixUint, rectSizePixUint, fillGrayLevel) != PLUS_SUCCESS)
-        {
-          LOG_ERROR("Failed to fill rectangle");
-          return EXIT_FAILURE;
-        }
-      }
-      break;
-    case CROP:
-      {
-        // Crop a rectangular region from the image
-        igsioVideoFrame::FlipInfoType flipInfo;
-        flipInfo.hFlip = flipX;
-        flipInfo.vFlip = flipY;
-        flipInfo.eFlip = flipZ;
-        if (CropRectangle(trackedFrameList, flipInfo, rectOriginPix, rectSizePix) != PLUS_SUCCESS)
-        {
-          LOG_ERROR("Failed to fill rectangle");
           return EXIT_FAILURE;
         }
+        params.FillRectOrigin.assign(rectOriginPix.begin(), rectOriginPix.end());
+        params.FillRectSize.assign(rectSizePix.begin(), rectSizePix.end());
       }
       break;
-    case REMOVE_IMAGE_DATA:
-      // No processing is needed, image data is removed when writing the output
-      break;
     default:
-      {
-        LOG_WARNING("Unknown operation is specified: " << strOperation);
-        return EXIT_FAILURE;
-      }
+      break;
   }
 
-
-  //////////////////////////////////////////////////////////////////
-  // Convert files to the new file format
-
   if (!strUpdatedReferenceTransformName.empty())
   {
-    igsioTransformName referenceTransformName;
-    if (referenceTransformName.SetTransformName(strUpdatedReferenceTransformName.c_str()) != PLUS_SUCCESS)
+    if (params.ReferenceTransformName.SetTransformName(strUpdatedReferenceTransformName.c_str()) != PLUS_SUCCESS)
     {
       LOG_ERROR("Reference transform name is invalid: " << strUpdatedReferenceTransformName);
       return EXIT_FAILURE;
     }
+    params.UpdateReferenceTransform = true;
+  }
 
-    for (unsigned int i = 0; i < trackedFrameList->GetNumberOfTrackedFrames(); ++i)
-    {
-      igsioTrackedFrame* trackedFrame = trackedFrameList->GetTrackedFrame(i);
+  ///////////////////////////////////////////////////////////////////
+  // Edit the sequence frame by frame, without loading it into memory
 
-      vtkSmartPointer<vtkMatrix4x4> referenceToTrackerMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-      if (trackedFrame->GetFrameTransform(referenceTransformName, referenceToTrackerMatrix) != PLUS_SUCCESS)
+  if (operation != REMOVE_IMAGE_DATA && vtkPlusSequenceFileWriter::CanWriteFile(outputFileName))
+  {
+    bool streamable = false;
+    PlusStatus status = StreamEditSequenceFiles(inputFileNames, outputFileName, params, streamable);
+    if (streamable)
+    {
+      if (status != PLUS_SUCCESS)
       {
-        LOG_WARNING("Couldn't get reference transform with name: " << strUpdatedReferenceTransformName);
-        continue;
+        LOG_ERROR("Failed to edit sequence file");
+        return EXIT_FAILURE;
       }
+      LOG_INFO("Sequence file editing was successful!");
+      return EXIT_SUCCESS;
+    }
+    LOG_DEBUG("Input sequence files cannot be read frame by frame, they are loaded into memory");
+  }
 
-      std::vector<igsioTransformName> transformNameList;
-      trackedFrame->GetFrameTransformNameList(transformNameList);
-
-      vtkSmartPointer<vtkTransform> toolToTrackerTransform = vtkSmartPointer<vtkTransform>::New();
-      vtkSmartPointer<vtkMatrix4x4> toolToReferenceMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-      for (unsigned int n = 0; n < transformNameList.size(); ++n)
-      {
-        // No need to change the reference transform
-        if (transformNameList[n] == referenceTransformName)
-        {
-          continue;
-        }
-
-        ToolStatus status = TOOL_INVALID;
-        if (trackedFrame->GetFrameTransform(transformNameList[n], toolToReferenceMatrix) != PLUS_SUCCESS)
-        {
-          std::string strTransformName;
-          transformNameList[i].GetTransformName(strTransformName);
-          LOG_ERROR("Failed to get frame transform: " << strTransformName);
-          continue;
-        }
-
-        if (trackedFrame->GetFrameTransformStatus(transformNameList[n], status) != PLUS_SUCCESS)
-        {
-          std::string strTransformName;
-          transformNameList[i].GetTransformName(strTransformName);
-          LOG_ERROR("Failed to get frame transform status: " << strTransformName);
-          continue;
-        }
+  ///////////////////////////////////////////////////////////////////
+  // Read input files
 
-        // Compute ToolToTracker transform from ToolToReference
-        toolToTrackerTransform->Identity();
-        toolToTrackerTransform->Concatenate(referenceToTrackerMatrix);
-        toolToTrackerTransform->Concatenate(toolToReferenceMatrix);
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
 
-        // Update the name to ToolToTracker
-        igsioTransformName toolToTracker(transformNameList[n].From().c_str(), "Tracker");
-        // Set the new custom transform
-        if (trackedFrame->SetFrameTransform(toolToTracker, toolToTrackerTransform->GetMatrix()) != PLUS_SUCCESS)
-        {
-          std::string strTransformName;
-          transformNameList[i].GetTransformName(strTransformName);
-          LOG_ERROR("Failed to set frame transform: " << strTransformName);
-          continue;
-        }
+  // Operations on a single file that only keep some frames or only the frame fields read just the data that they need
+  bool framesSelectedOnRead = false;
+  if (inputFileNames.size() == 1 && (operation == TRIM || operation == DECIMATE || operation == REMOVE_IMAGE_DATA))
+  {
+    LOG_INFO("Read input sequence file: " << inputFileNames[0]);
+    bool invalidParameters = false;
+    framesSelectedOnRead = (ReadSelectedFrames(trackedFrameList, inputFileNames[0], operation, firstFrameIndex, lastFrameIndex, decimationFactor, invalidParameters) == PLUS_SUCCESS);
+    if (invalidParameters)
+    {
+      LOG_ERROR("Failed to " << (operation == TRIM ? "trim" : "decimate") << " sequence file");
+      return EXIT_FAILURE;
+    }
+    if (!framesSelectedOnRead)
+    {
+      // for example the pixel data is split into multiple files, read everything
+      trackedFrameList->Clear();
+    }
+  }
 
-        // Use the same status as it was before
-        if (trackedFrame->SetFrameTransformStatus(toolToTracker, status) != PLUS_SUCCESS)
-        {
-          std::string strTransformName;
-          transformNameList[i].GetTransformName(strTransformName);
-          LOG_ERROR("Failed to set frame transform status: " << strTransformName);
-          continue;
-        }
+  // Multiple input files are appended unless sequences are mixed
+  PlusStatus status = PLUS_SUCCESS;
+  if (framesSelectedOnRead)
+  {
+    // Frames are already read
+  }
+  else if (operation == MIX)
+  {
+    status = MixTrackedFrameLists(trackedFrameList, inputFileNames);
+  }
+  else
+  {
+    status = AppendTrackedFrameLists(trackedFrameList, inputFileNames, incrementTimestamps);
+  }
+  if (status == PLUS_FAIL)
+  {
+    return EXIT_FAILURE;
+  }
 
-        // Delete old transform and status fields
-        std::string oldTransformName, oldTransformStatus;
-        transformNameList[n].GetTransformName(oldTransformName);
-        // Append Transform to the end of the transform name
-        vtksys::RegularExpression isTransform("Transform$");
-        if (!isTransform.find(oldTransformName))
-        {
-          oldTransformName.append("Transform");
-        }
-        oldTransformStatus = oldTransformName;
-        oldTransformStatus.append("Status");
-        trackedFrame->DeleteFrameField(oldTransformName.c_str());
-        trackedFrame->DeleteFrameField(oldTransformStatus.c_str());
+  ///////////////////////////////////////////////////////////////////
+  // Make the operation
 
-      }
+  if (operation == TRIM && !framesSelectedOnRead)
+  {
+    unsigned int firstFrameIndexUint = static_cast<unsigned int>(firstFrameIndex);
+    unsigned int lastFrameIndexUint = static_cast<unsigned int>(lastFrameIndex);
+    if (TrimSequenceFile(trackedFrameList, firstFrameIndexUint, lastFrameIndexUint) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to trim sequence file");
+      return EXIT_FAILURE;
     }
   }
+  else if (operation == DECIMATE && !framesSelectedOnRead)
+  {
+    if (DecimateSequenceFile(trackedFrameList, decimationFactor) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to decimate sequence file");
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (EditFrames(trackedFrameList, params) != PLUS_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
 
   ///////////////////////////////////////////////////////////////////
   // Save output file to file
@@ -840,7 +1298,6 @@ PlusStatus DeleteFrameField(vtkIGSIOTrackedFrameList* trackedFrameList, std::str
     return PLUS_FAIL;
   }
 
-  LOG_INFO("Delete frame field: " << fieldName);
   int numberOfErrors(0);
   for (unsigned int i = 0; i < trackedFrameList->GetNumberOfTrackedFrames(); ++i)
   {
@@ -863,18 +1320,20 @@ PlusStatus DeleteFrameField(vtkIGSIOTrackedFrameList* trackedFrameList, std::str
 //-------------------------------------------------------
 PlusStatus UpdateFrameFieldValue(FrameFieldUpdate& fieldUpdate)
 {
-  LOG_INFO("Update frame field");
   int numberOfErrors(0);
 
-  // Set the start scalar value
-  double scalarVariable = fieldUpdate.FrameScalarStart;
-
-  // Set the start transform matrix
-  vtkSmartPointer<vtkTransform> frameTransform = vtkSmartPointer<vtkTransform>::New();
-  if (fieldUpdate.FrameTransformStart != NULL)
+  // Set the start scalar value and transform matrix for the first frame, later frame lists continue from the last frame
+  if (!fieldUpdate.NextFrameValuesInitialized)
   {
-    frameTransform->SetMatrix(fieldUpdate.FrameTransformStart);
+    fieldUpdate.NextFrameScalar = fieldUpdate.FrameScalarStart;
+    fieldUpdate.NextFrameTransform = vtkSmartPointer<vtkTransform>::New();
+    if (fieldUpdate.FrameTransformStart != NULL)
+    {
+      fieldUpdate.NextFrameTransform->SetMatrix(fieldUpdate.FrameTransformStart);
+    }
+    fieldUpdate.NextFrameValuesInitialized = true;
   }
+  vtkTransform* frameTransform = fieldUpdate.NextFrameTransform;
 
   for (unsigned int i = 0; i < fieldUpdate.TrackedFrameList->GetNumberOfTrackedFrames(); ++i)
   {
@@ -908,10 +1367,10 @@ PlusStatus UpdateFrameFieldValue(FrameFieldUpdate& fieldUpdate)
         // Update it as a scalar variable
 
         std::ostringstream fieldValue;
-        fieldValue << std::fixed << std::setprecision(fieldUpdate.FrameScalarDecimalDigits) << scalarVariable;
+        fieldValue << std::fixed << std::setprecision(fieldUpdate.FrameScalarDecimalDigits) << fieldUpdate.NextFrameScalar;
 
         trackedFrame->SetFrameField(fieldName.c_str(), fieldValue.str().c_str());
-        scalarVariable += fieldUpdate.FrameScalarIncrement;
+        fieldUpdate.NextFrameScalar += fieldUpdate.FrameScalarIncrement;
 
       }
       else if (igsioCommon::IsEqualInsensitive(fieldUpdate.UpdatedFieldValue, FIELD_VALUE_FRAME_TRANSFORM))
@@ -966,6 +1425,95 @@ PlusStatus UpdateFrameFieldValue(FrameFieldUpdate& fieldUpdate)
   return (numberOfErrors == 0 ? PLUS_SUCCESS : PLUS_FAIL);
 }
 
+//-------------------------------------------------------
+PlusStatus UpdateReferenceTransform(vtkIGSIOTrackedFrameList* trackedFrameList, const igsioTransformName& referenceTransformName)
+{
+  std::string strReferenceTransformName;
+  referenceTransformName.GetTransformName(strReferenceTransformName);
+  for (unsigned int i = 0; i < trackedFrameList->GetNumberOfTrackedFrames(); ++i)
+  {
+    igsioTrackedFrame* trackedFrame = trackedFrameList->GetTrackedFrame(i);
+
+    vtkSmartPointer<vtkMatrix4x4> referenceToTrackerMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    if (trackedFrame->GetFrameTransform(referenceTransformName, referenceToTrackerMatrix) != PLUS_SUCCESS)
+    {
+      LOG_WARNING("Couldn't get reference transform with name: " << strReferenceTransformName);
+      continue;
+    }
+
+    std::vector<igsioTransformName> transformNameList;
+    trackedFrame->GetFrameTransformNameList(transformNameList);
+
+    vtkSmartPointer<vtkTransform> toolToTrackerTransform = vtkSmartPointer<vtkTransform>::New();
+    vtkSmartPointer<vtkMatrix4x4> toolToReferenceMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    for (unsigned int n = 0; n < transformNameList.size(); ++n)
+    {
+      // No need to change the reference transform
+      if (transformNameList[n] == referenceTransformName)
+      {
+        continue;
+      }
+
+      ToolStatus status = TOOL_INVALID;
+      if (trackedFrame->GetFrameTransform(transformNameList[n], toolToReferenceMatrix) != PLUS_SUCCESS)
+      {
+        std::string strTransformName;
+        transformNameList[n].GetTransformName(strTransformName);
+        LOG_ERROR("Failed to get frame transform: " << strTransformName);
+        continue;
+      }
+
+      if (trackedFrame->GetFrameTransformStatus(transformNameList[n], status) != PLUS_SUCCESS)
+      {
+        std::string strTransformName;
+        transformNameList[n].GetTransformName(strTransformName);
+        LOG_ERROR("Failed to get frame transform status: " << strTransformName);
+        continue;
+      }
+
+      // Compute ToolToTracker transform from ToolToReference
+      toolToTrackerTransform->Identity();
+      toolToTrackerTransform->Concatenate(referenceToTrackerMatrix);
+      toolToTrackerTransform->Concatenate(toolToReferenceMatrix);
+
+      // Update the name to ToolToTracker
+      igsioTransformName toolToTracker(transformNameList[n].From().c_str(), "Tracker");
+      // Set the new custom transform
+      if (trackedFrame->SetFrameTransform(toolToTracker, toolToTrackerTransform->GetMatrix()) != PLUS_SUCCESS)
+      {
+        std::string strTransformName;
+        transformNameList[n].GetTransformName(strTransformName);
+        LOG_ERROR("Failed to set frame transform: " << strTransformName);
+        continue;
+      }
+
+      // Use the same status as it was before
+      if (trackedFrame->SetFrameTransformStatus(toolToTracker, status) != PLUS_SUCCESS)
+      {
+        std::string strTransformName;
+        transformNameList[n].GetTransformName(strTransformName);
+        LOG_ERROR("Failed to set frame transform status: " << strTransformName);
+        continue;
+      }
+
+      // Delete old transform and status fields
+      std::string oldTransformName, oldTransformStatus;
+      transformNameList[n].GetTransformName(oldTransformName);
+      // Append Transform to the end of the transform name
+      vtksys::RegularExpression isTransform("Transform$");
+      if (!isTransform.find(oldTransformName))
+      {
+        oldTransformName.append("Transform");
+      }
+      oldTransformStatus = oldTransformName;
+      oldTransformStatus.append("Status");
+      trackedFrame->DeleteFrameField(oldTransformName.c_str());
+      trackedFrame->DeleteFrameField(oldTransformStatus.c_str());
+    }
+  }
+  return PLUS_SUCCESS;
+}
+
 //-------------------------------------------------------
 PlusStatus ConvertStringToMatrix(std::string& strMatrix, vtkMatrix4x4* matrix)
 {
@@ -992,7 +1540,7 @@ PlusStatus ConvertStringToMatrix(std::string& strMatrix, vtkMatrix4x4* matrix)
 }
 
 //-------------------------------------------------------
-PlusStatus AddTransform(vtkIGSIOTrackedFrameList* trackedFrameList, std::vector<std::string> transformNamesToAdd, std::string deviceSetConfigurationFileName)
+PlusStatus AddTransform(vtkIGSIOTrackedFrameList* trackedFrameList, const std::vector<std::string>& transformNamesToAdd, vtkXMLDataElement* deviceSetConfiguration)
 {
   if (trackedFrameList == NULL)
   {
@@ -1006,17 +1554,9 @@ PlusStatus AddTransform(vtkIGSIOTrackedFrameList* trackedFrameList, std::vector<
     return PLUS_FAIL;
   }
 
-  if (deviceSetConfigurationFileName.empty())
-  {
-    LOG_ERROR("Used device set configuration file name is empty");
-    return PLUS_FAIL;
-  }
-
-  // Read configuration
-  vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::New();
-  if (PlusXmlUtils::ReadDeviceSetConfigurationFromFile(configRootElement, deviceSetConfigurationFileName.c_str()) == PLUS_FAIL)
+  if (deviceSetConfiguration == NULL)
   {
-    LOG_ERROR("Unable to read configuration from file " << deviceSetConfigurationFileName.c_str());
+    LOG_ERROR("Device set configuration is invalid");
     return PLUS_FAIL;
   }
 
@@ -1026,7 +1566,7 @@ PlusStatus AddTransform(vtkIGSIOTrackedFrameList* trackedFrameList, std::vector<
 
     // Set up transform repository
     vtkSmartPointer<vtkIGSIOTransformRepository> transformRepository = vtkSmartPointer<vtkIGSIOTransformRepository>::New();
-    if (transformRepository->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+    if (transformRepository->ReadConfiguration(deviceSetConfiguration) != PLUS_SUCCESS)
     {
       LOG_ERROR("Unable to set device set configuration to transform repository!");
       return PLUS_FAIL;
@@ -1037,7 +1577,7 @@ PlusStatus AddTransform(vtkIGSIOTrackedFrameList* trackedFrameList, std::vector<
       return PLUS_FAIL;
     }
 
-    for (std::vector<std::string>::iterator transformNameToAddIt = transformNamesToAdd.begin(); transformNameToAddIt != transformNamesToAdd.end(); ++transformNameToAddIt)
+    for (std::vector<std::string>::const_iterator transformNameToAddIt = transformNamesToAdd.begin(); transformNameToAddIt != transformNamesToAdd.end(); ++transformNameToAddIt)
     {
       // Create transform name
       igsioTransformName transformName;
@@ -5,12 +5,18 @@
 =========================================================Plus=header=end*/
 
 #include "PlusConfigure.h"
+#include "PlusProfiler.h"
 #include "vtkDirectory.h"
 #include "vtkMatrix4x4.h"
 #include "vtkIGSIORecursiveCriticalSection.h"
 #include "vtkXMLUtilities.h"
 #include "vtksys/SystemTools.hxx"
 
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+
 // Needed for proper singleton initialization
 // The vtkDebugLeaks singleton must be initialized before and
 // destroyed after the vtkPlusConfig singleton.
@@ -29,6 +35,38 @@
 
 static const char APPLICATION_CONFIGURATION_FILE_NAME[] = "PlusConfig.xml";
 
+namespace
+{
+  /*! Parsed device set configuration file, reused while the contents of the file do not change */
+  struct ParsedDeviceSetConfiguration
+  {
+    ParsedDeviceSetConfiguration() : ContentHash(0) {}
+    std::string Contents;
+    unsigned long long ContentHash;
+    vtkSmartPointer<vtkXMLDataElement> RootElement;
+  };
+
+  /*!
+    Parsed device set configuration files by absolute path. Applications reconnect (and the tests start data collection)
+    with the same configuration file many times, so the file is only parsed again after it has been changed.
+  */
+  std::map<std::string, ParsedDeviceSetConfiguration> ParsedDeviceSetConfigurations;
+  std::mutex ParsedDeviceSetConfigurationsMutex;
+
+  //-----------------------------------------------------------------------------
+  // FNV-1a hash, only used for quickly rejecting changed files before the contents are compared
+  unsigned long long ComputeContentHash(const std::string& contents)
+  {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (std::string::const_iterator it = contents.begin(); it != contents.end(); ++it)
+    {
+      hash ^= static_cast<unsigned char>(*it);
+      hash *= 1099511628211ULL;
+    }
+    return hash;
+  }
+}
+
 
 vtkPlusConfig* vtkPlusConfig::Instance = NULL;
 
@@ -238,18 +276,55 @@ vtkXMLDataElement* vtkPlusConfig::CreateDeviceSetConfigurationFromFile(const std
       return NULL;
     }
   }
-  vtkXMLDataElement* configRootElement = vtkXMLUtilities::ReadElementFromFile(configFilePath.c_str());
-  if (configRootElement == NULL)
+
+  std::ifstream configFile(configFilePath.c_str(), std::ios::in | std::ios::binary);
+  if (!configFile)
   {
-    LOG_ERROR("Reading device set configuration file failed: syntax error in " << aConfigFile);
+    LOG_ERROR("Reading device set configuration file failed: cannot open " << configFilePath);
     return NULL;
   }
+  std::string contents((std::istreambuf_iterator<char>(configFile)), std::istreambuf_iterator<char>());
+  unsigned long long contentHash = ComputeContentHash(contents);
+
+  // The file is parsed only if it has been changed since it was parsed last time, otherwise a copy of the
+  // parsed elements is returned, as the caller owns and may modify the returned configuration
+  std::string absoluteConfigFilePath = vtksys::SystemTools::CollapseFullPath(configFilePath);
+  vtkXMLDataElement* configRootElement = NULL;
+  {
+    std::lock_guard<std::mutex> lock(ParsedDeviceSetConfigurationsMutex);
+    std::map<std::string, ParsedDeviceSetConfiguration>::iterator parsedIt = ParsedDeviceSetConfigurations.find(absoluteConfigFilePath);
+    if (parsedIt != ParsedDeviceSetConfigurations.end() && parsedIt->second.ContentHash == contentHash && parsedIt->second.Contents == contents)
+    {
+      configRootElement = vtkXMLDataElement::New();
+      configRootElement->DeepCopy(parsedIt->second.RootElement);
+      LOG_DEBUG("Device set configuration file " << aConfigFile << " has not changed, the already parsed configuration is used");
+    }
+  }
+  if (configRootElement == NULL)
+  {
+    configRootElement = vtkXMLUtilities::ReadElementFromString(contents.c_str());
+    if (configRootElement == NULL)
+    {
+      LOG_ERROR("Reading device set configuration file failed: syntax error in " << aConfigFile);
+      return NULL;
+    }
+    ParsedDeviceSetConfiguration parsedConfiguration;
+    parsedConfiguration.Contents = contents;
+    parsedConfiguration.ContentHash = contentHash;
+    parsedConfiguration.RootElement = vtkSmartPointer<vtkXMLDataElement>::New();
+    parsedConfiguration.RootElement->DeepCopy(configRootElement);
+    std::lock_guard<std::mutex> lock(ParsedDeviceSetConfigurationsMutex);
+    ParsedDeviceSetConfigurations[absoluteConfigFilePath] = parsedConfiguration;
+  }
 
-  // Print configuration file contents for debugging purposes
   LOG_DEBUG("Device set configuration is read from file: " << aConfigFile);
-  std::ostringstream xmlFileContents;
-  igsioCommon::XML::PrintXML(xmlFileContents, vtkIndent(1), configRootElement);
-  LOG_DEBUG("Device set configuration file contents: " << std::endl << xmlFileContents.str());
+  // Printing the whole configuration is slow for large files, so it is only done if it is logged
+  if (vtkPlusLogger::Instance()->GetLogLevel() >= vtkPlusLogger::LOG_LEVEL_DEBUG)
+  {
+    std::ostringstream xmlFileContents;
+    igsioCommon::XML::PrintXML(xmlFileContents, vtkIndent(1), configRootElement);
+    LOG_DEBUG("Device set configuration file contents: " << std::endl << xmlFileContents.str());
+  }
 
   return configRootElement;
 }
@@ -304,6 +379,29 @@ PlusStatus vtkPlusConfig::LoadApplicationConfiguration()
     saveNeeded = true;
   }
 
+  // Read asynchronous logging (optional)
+  bool asyncLogging = false;
+  XML_READ_BOOL_ATTRIBUTE_NONMEMBER_OPTIONAL(AsyncLogging, asyncLogging, applicationConfigurationRoot);
+  if (asyncLogging)
+  {
+    unsigned int logRateLimitPerCallSite = 0;
+    XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(unsigned int, LogRateLimitPerCallSite, logRateLimitPerCallSite, applicationConfigurationRoot);
+    vtkPlusLogger::EnableAsyncLogging(logRateLimitPerCallSite);
+  }
+
+  // Read profiling trace file (optional)
+  const char* profilingTraceFile = applicationConfigurationRoot->GetAttribute("ProfilingTraceFile");
+  if (profilingTraceFile != NULL && STRCASECMP(profilingTraceFile, "") != 0)
+  {
+#ifdef PLUS_USE_PROFILING
+    std::string profilingTraceFilePath = this->GetOutputPath(profilingTraceFile);
+    LOG_INFO("Profiling is enabled, the trace is written to " << profilingTraceFilePath << " at exit");
+    PlusProfiler::GetInstance().Start(profilingTraceFilePath);
+#else
+    LOG_WARNING("ProfilingTraceFile is ignored, because Plus was built without PLUS_USE_PROFILING");
+#endif
+  }
+
   // Read last device set config file
   const char* lastDeviceSetConfigFile = applicationConfigurationRoot->GetAttribute("LastDeviceSetConfigurationFileName");
   if ((lastDeviceSetConfigFile != NULL) && (STRCASECMP(lastDeviceSetConfigFile, "") != 0))
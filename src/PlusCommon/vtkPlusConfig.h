@@ -213,6 +213,9 @@ public:
   /*! Get application start timestamp */
   vtkGetStdStringMacro(ApplicationStartTimestamp);
 
+  /*! Get the absolute path of the directory of the executable */
+  vtkGetStdStringMacro(ProgramDirectory);
+
   /*!
     Gets the full path of a Plus executable file.
     executableName should not contain file extension (.exe is added automatically on Windows platforms)
@@ -7,15 +7,69 @@
 #include "PlusConfigure.h"
 #include "PlusCommon.h"
 #include "vtkPlusLogger.h"
+#include "PlusAsyncLogBackend.h"
+
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
 
 //-----------------------------------------------------------------------------
 namespace
 {
   vtkIGSIOSimpleRecursiveCriticalSection LoggerCreationCriticalSection;
+
+  /*! Checked for each message, so that the backend does not have to be locked */
+  std::atomic<bool> AsyncLoggingEnabled(false);
+
+  typedef void (*SignalHandlerType)(int);
+  const int CRASH_SIGNALS[] =
+  {
+    SIGSEGV, SIGABRT, SIGFPE, SIGILL,
+#ifdef SIGBUS
+    SIGBUS,
+#endif
+  };
+  const int NUMBER_OF_CRASH_SIGNALS = sizeof(CRASH_SIGNALS) / sizeof(CRASH_SIGNALS[0]);
+  SignalHandlerType PreviousCrashSignalHandlers[NUMBER_OF_CRASH_SIGNALS] = { 0 };
+
+  //-----------------------------------------------------------------------------
+  void FlushAsyncLogOnCrash(int signalNumber)
+  {
+    // Restore the previous handler first, so that a crash while flushing does not recurse
+    for (int i = 0; i < NUMBER_OF_CRASH_SIGNALS; ++i)
+    {
+      if (CRASH_SIGNALS[i] == signalNumber)
+      {
+        signal(signalNumber, PreviousCrashSignalHandlers[i] != SIG_ERR ? PreviousCrashSignalHandlers[i] : SIG_DFL);
+      }
+    }
+    // Best effort: the messages that explain the crash are the most important ones to see
+    vtkPlusLogger::FlushAsyncLog();
+    raise(signalNumber);
+  }
+
+  //-----------------------------------------------------------------------------
+  void InstallCrashSignalHandlers()
+  {
+    for (int i = 0; i < NUMBER_OF_CRASH_SIGNALS; ++i)
+    {
+      PreviousCrashSignalHandlers[i] = signal(CRASH_SIGNALS[i], FlushAsyncLogOnCrash);
+    }
+  }
+
+  //-----------------------------------------------------------------------------
+  void StopAsyncLoggingAtExit()
+  {
+    // The flusher thread must not run while the static objects are destroyed
+    vtkPlusLogger::DisableAsyncLogging();
+  }
 }
 
 //-------------------------------------------------------
 vtkPlusLogger::vtkPlusLogger()
+  : AsyncBackend(NULL)
 {
 }
 
@@ -54,3 +108,95 @@ vtkIGSIOLogger* vtkPlusLogger::Instance()
 
   return m_pInstance;
 }
+
+//-------------------------------------------------------
+void vtkPlusLogger::LogMessage(LogLevelType level, const char* msg, const char* fileName, int lineNumber, const char* optionalPrefix)
+{
+  // Messages with a prefix come from other processes (e.g., the log of a remote server), they are written immediately
+  if (!AsyncLoggingEnabled.load(std::memory_order_acquire) || optionalPrefix != NULL)
+  {
+    vtkIGSIOLogger::LogMessage(level, msg, fileName, lineNumber, optionalPrefix);
+    return;
+  }
+  if (level > this->GetLogLevel())
+  {
+    return;
+  }
+
+  // Errors and warnings are never dropped: if the ring of the thread is full then they are written immediately
+  bool droppable = (level > LOG_LEVEL_WARNING);
+  if (this->AsyncBackend->AddRecord(level, msg, fileName, lineNumber, droppable) == PlusAsyncLogBackend::RECORD_REJECTED)
+  {
+    vtkIGSIOLogger::LogMessage(level, msg, fileName, lineNumber, optionalPrefix);
+  }
+}
+
+//-------------------------------------------------------
+void vtkPlusLogger::WriteQueuedRecord(int level, const std::string& message, const std::string& fileName, int lineNumber, unsigned int threadIndex, double timestamp)
+{
+  // The log line is time stamped when it is written, so the time when the message was logged is in the prefix
+  std::ostringstream prefix;
+  prefix << "T" << threadIndex << " " << std::fixed << std::setprecision(6) << timestamp;
+  vtkIGSIOLogger::LogMessage(static_cast<LogLevelType>(level), message.c_str(), fileName.c_str(), lineNumber, prefix.str().c_str());
+}
+
+//-------------------------------------------------------
+void vtkPlusLogger::EnableAsyncLogging(unsigned int maximumMessagesPerSecondPerCallSite /*=0*/)
+{
+  vtkPlusLogger* logger = dynamic_cast<vtkPlusLogger*>(Instance());
+  if (logger == NULL)
+  {
+    LOG_WARNING("Asynchronous logging is not available, because the logger is not a vtkPlusLogger");
+    return;
+  }
+
+  igsioLockGuard<vtkIGSIOSimpleRecursiveCriticalSection> loggerCreationGuard(&LoggerCreationCriticalSection);
+  if (logger->AsyncBackend == NULL)
+  {
+    logger->AsyncBackend = new PlusAsyncLogBackend([logger](const PlusAsyncLogBackend::Record & record)
+    {
+      logger->WriteQueuedRecord(record.Level, record.Message, record.FileName, record.LineNumber, record.ThreadIndex, record.Timestamp);
+    });
+    std::atexit(StopAsyncLoggingAtExit);
+    InstallCrashSignalHandlers();
+  }
+  logger->AsyncBackend->SetMaximumMessagesPerSecondPerCallSite(maximumMessagesPerSecondPerCallSite);
+  if (logger->AsyncBackend->Start() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to start the asynchronous logging thread, messages are written immediately");
+    return;
+  }
+  AsyncLoggingEnabled.store(true, std::memory_order_release);
+}
+
+//-------------------------------------------------------
+void vtkPlusLogger::DisableAsyncLogging()
+{
+  vtkPlusLogger* logger = dynamic_cast<vtkPlusLogger*>(m_pInstance);
+  if (logger == NULL)
+  {
+    return;
+  }
+  igsioLockGuard<vtkIGSIOSimpleRecursiveCriticalSection> loggerCreationGuard(&LoggerCreationCriticalSection);
+  AsyncLoggingEnabled.store(false, std::memory_order_release);
+  if (logger->AsyncBackend != NULL)
+  {
+    logger->AsyncBackend->Stop();
+  }
+}
+
+//-------------------------------------------------------
+bool vtkPlusLogger::IsAsyncLoggingEnabled()
+{
+  return AsyncLoggingEnabled.load(std::memory_order_acquire);
+}
+
+//-------------------------------------------------------
+void vtkPlusLogger::FlushAsyncLog()
+{
+  vtkPlusLogger* logger = dynamic_cast<vtkPlusLogger*>(m_pInstance);
+  if (logger != NULL && logger->AsyncBackend != NULL)
+  {
+    logger->AsyncBackend->Flush();
+  }
+}
@@ -13,9 +13,17 @@
 // PlusCommon includes
 #include "vtkPlusCommonExport.h"
 
+class PlusAsyncLogBackend;
+
 /*!
   \class vtkPlusLogger
   \brief Class to abstract away specific sequence file read/write details
+
+  If asynchronous logging is enabled then messages are queued by the logging thread and written to the console and the
+  log file by a background thread (see PlusAsyncLogBackend), so that logging does not block acquisition threads.
+  Error and warning messages are never dropped: if the queue of the thread is full then they are written immediately.
+  Queued messages are written at exit and, on a best effort basis, when the process crashes.
+
   \ingroup PlusLibCommon
 */
 class vtkPlusCommonExport vtkPlusLogger : public vtkIGSIOLogger
@@ -23,9 +31,33 @@ class vtkPlusCommonExport vtkPlusLogger : public vtkIGSIOLogger
 public:
   static vtkIGSIOLogger* Instance();
 
+  using vtkIGSIOLogger::LogMessage;
+  /*! Queue the message if asynchronous logging is enabled, write it immediately otherwise */
+  virtual void LogMessage(LogLevelType level, const char* msg, const char* fileName, int lineNumber, const char* optionalPrefix = NULL);
+
+  /*!
+    Write the log messages on a background thread.
+    \param maximumMessagesPerSecondPerCallSite Messages of a call site (source file and line) above this rate are suppressed, 0 means no limit
+  */
+  static void EnableAsyncLogging(unsigned int maximumMessagesPerSecondPerCallSite = 0);
+
+  /*! Write all queued messages and write the log messages immediately from now on */
+  static void DisableAsyncLogging();
+
+  static bool IsAsyncLoggingEnabled();
+
+  /*! Write all queued messages now */
+  static void FlushAsyncLog();
+
 private:
   vtkPlusLogger();
   ~vtkPlusLogger();
+
+  /*! Write a record of the asynchronous backend, called on the flusher thread */
+  void WriteQueuedRecord(int level, const std::string& message, const std::string& fileName, int lineNumber, unsigned int threadIndex, double timestamp);
+
+  /*! Created when asynchronous logging is first enabled and never deleted, because messages may be logged until the process exits */
+  PlusAsyncLogBackend* AsyncBackend;
 };
 
 #endif // __vtkPlusLogger_h 
@@ -0,0 +1,178 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "vtkPlusMemoryMappedFile.h"
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkInformation.h>
+#include <vtkInformationObjectBaseKey.h>
+#include <vtkObjectFactory.h>
+
+#if defined(_WIN32)
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+vtkStandardNewMacro(vtkPlusMemoryMappedFile);
+vtkInformationKeyMacro(vtkPlusMemoryMappedFile, MAPPED_FILE, ObjectBase);
+
+//----------------------------------------------------------------------------
+class vtkPlusMemoryMappedFile::vtkInternal
+{
+public:
+#if defined(_WIN32)
+  vtkInternal()
+    : FileHandle(INVALID_HANDLE_VALUE)
+    , MappingHandle(NULL)
+  {
+  }
+
+  HANDLE FileHandle;
+  HANDLE MappingHandle;
+#endif
+};
+
+//----------------------------------------------------------------------------
+vtkPlusMemoryMappedFile::vtkPlusMemoryMappedFile()
+  : Pointer(NULL)
+  , Size(0)
+  , Internal(new vtkInternal)
+{
+}
+
+//----------------------------------------------------------------------------
+vtkPlusMemoryMappedFile::~vtkPlusMemoryMappedFile()
+{
+  this->Close();
+  delete this->Internal;
+  this->Internal = NULL;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusMemoryMappedFile::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "FilePath: " << this->FilePath << std::endl;
+  os << indent << "Size: " << this->Size << std::endl;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusMemoryMappedFile::Open(const std::string& filePath)
+{
+  this->Close();
+
+#if defined(_WIN32)
+  HANDLE fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (fileHandle == INVALID_HANDLE_VALUE)
+  {
+    LOG_ERROR("Failed to open file for memory mapping: " << filePath << " (error code: " << GetLastError() << ")");
+    return PLUS_FAIL;
+  }
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+  {
+    LOG_ERROR("Failed to get the size of file or the file is empty: " << filePath);
+    CloseHandle(fileHandle);
+    return PLUS_FAIL;
+  }
+  // Pages of a PAGE_WRITECOPY mapping are copied when they are modified, the file is not changed
+  HANDLE mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+  void* pointer = (mappingHandle != NULL ? MapViewOfFile(mappingHandle, FILE_MAP_COPY, 0, 0, 0) : NULL);
+  if (pointer == NULL)
+  {
+    LOG_ERROR("Failed to map file into memory: " << filePath << " (error code: " << GetLastError() << ")");
+    if (mappingHandle != NULL)
+    {
+      CloseHandle(mappingHandle);
+    }
+    CloseHandle(fileHandle);
+    return PLUS_FAIL;
+  }
+  this->Internal->FileHandle = fileHandle;
+  this->Internal->MappingHandle = mappingHandle;
+  this->Size = static_cast<size_t>(fileSize.QuadPart);
+#else
+  int fileDescriptor = open(filePath.c_str(), O_RDONLY);
+  if (fileDescriptor < 0)
+  {
+    LOG_ERROR("Failed to open file for memory mapping: " << filePath);
+    return PLUS_FAIL;
+  }
+  struct stat fileStatus;
+  if (fstat(fileDescriptor, &fileStatus) != 0 || fileStatus.st_size == 0)
+  {
+    LOG_ERROR("Failed to get the size of file or the file is empty: " << filePath);
+    close(fileDescriptor);
+    return PLUS_FAIL;
+  }
+  // Private mapping: modified pages are copied, the file is not changed
+  void* pointer = mmap(NULL, static_cast<size_t>(fileStatus.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fileDescriptor, 0);
+  // The mapping remains valid after the file is closed
+  close(fileDescriptor);
+  if (pointer == MAP_FAILED)
+  {
+    LOG_ERROR("Failed to map file into memory: " << filePath);
+    return PLUS_FAIL;
+  }
+  this->Size = static_cast<size_t>(fileStatus.st_size);
+#endif
+
+  this->Pointer = static_cast<unsigned char*>(pointer);
+  this->FilePath = filePath;
+  LOG_DEBUG("Mapped " << this->Size << " bytes of file " << filePath << " into memory");
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusMemoryMappedFile::Close()
+{
+  if (this->Pointer == NULL)
+  {
+    return;
+  }
+#if defined(_WIN32)
+  UnmapViewOfFile(this->Pointer);
+  CloseHandle(this->Internal->MappingHandle);
+  CloseHandle(this->Internal->FileHandle);
+  this->Internal->MappingHandle = NULL;
+  this->Internal->FileHandle = INVALID_HANDLE_VALUE;
+#else
+  munmap(this->Pointer, this->Size);
+#endif
+  this->Pointer = NULL;
+  this->Size = 0;
+  this->FilePath.clear();
+}
+
+//----------------------------------------------------------------------------
+vtkDataArray* vtkPlusMemoryMappedFile::CreateDataArray(size_t offsetInBytes, int scalarType, int numberOfComponents, vtkIdType numberOfTuples)
+{
+  vtkDataArray* dataArray = vtkDataArray::CreateDataArray(scalarType);
+  if (dataArray == NULL)
+  {
+    LOG_ERROR("vtkPlusMemoryMappedFile::CreateDataArray: unsupported scalar type " << scalarType);
+    return NULL;
+  }
+  vtkIdType numberOfValues = numberOfTuples * numberOfComponents;
+  size_t sizeInBytes = static_cast<size_t>(numberOfValues) * dataArray->GetDataTypeSize();
+  if (this->Pointer == NULL || offsetInBytes > this->Size || sizeInBytes > this->Size - offsetInBytes)
+  {
+    LOG_ERROR("vtkPlusMemoryMappedFile::CreateDataArray: " << sizeInBytes << " bytes at offset " << offsetInBytes << " are not inside the mapped file " << this->FilePath);
+    dataArray->Delete();
+    return NULL;
+  }
+  dataArray->SetNumberOfComponents(numberOfComponents);
+  dataArray->SetVoidArray(this->Pointer + offsetInBytes, numberOfValues, 1 /* do not delete the memory */);
+  // The array keeps the mapping alive, shallow copies of images share the array
+  dataArray->GetInformation()->Set(vtkPlusMemoryMappedFile::MAPPED_FILE(), this);
+  return dataArray;
+}
@@ -0,0 +1,77 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusMemoryMappedFile_h
+#define __vtkPlusMemoryMappedFile_h
+
+#include "vtkPlusCommonExport.h"
+#include "vtkObject.h"
+
+#include <string>
+
+class vtkDataArray;
+class vtkInformationObjectBaseKey;
+
+/*!
+  \class vtkPlusMemoryMappedFile
+  \brief Maps a file into memory, so that its contents are only read from disk when they are accessed
+
+  The file is mapped copy-on-write: the mapped memory can be modified, but the changes are private to the process
+  and are not written to the file.
+
+  Data arrays that are created by CreateDataArray are views into the mapping and keep a reference to this object,
+  so the file remains mapped until all the arrays are deleted.
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport vtkPlusMemoryMappedFile : public vtkObject
+{
+public:
+  static vtkPlusMemoryMappedFile* New();
+  vtkTypeMacro(vtkPlusMemoryMappedFile, vtkObject);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  /*! Map the whole file into memory. The previously mapped file is unmapped. */
+  PlusStatus Open(const std::string& filePath);
+
+  /*! Unmap the file. Arrays created by CreateDataArray must not be used after this. */
+  void Close();
+
+  /*! Pointer to the beginning of the mapped file, NULL if no file is mapped */
+  unsigned char* GetPointer() const { return this->Pointer; }
+
+  /*! Size of the mapped file, in bytes */
+  size_t GetSize() const { return this->Size; }
+
+  vtkGetStdStringMacro(FilePath);
+
+  /*!
+    Create a data array that uses the mapped memory at the specified offset, without copying it.
+    The array keeps a reference to this object. Returns NULL if the requested range is not inside the file.
+    The caller is responsible for deleting the returned array.
+  */
+  vtkDataArray* CreateDataArray(size_t offsetInBytes, int scalarType, int numberOfComponents, vtkIdType numberOfTuples);
+
+  /*! Information key of data arrays created by CreateDataArray, which stores the mapped file */
+  static vtkInformationObjectBaseKey* MAPPED_FILE();
+
+protected:
+  vtkPlusMemoryMappedFile();
+  virtual ~vtkPlusMemoryMappedFile();
+
+  std::string FilePath;
+  unsigned char* Pointer;
+  size_t Size;
+
+  class vtkInternal;
+  vtkInternal* Internal;
+
+private:
+  vtkPlusMemoryMappedFile(const vtkPlusMemoryMappedFile&);  // Not implemented.
+  void operator=(const vtkPlusMemoryMappedFile&);  // Not implemented.
+};
+
+#endif
@@ -0,0 +1,725 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusParallelDeflate.h"
+#include "vtkPlusSequenceFileWriter.h"
+#include "vtkPlusSequenceStreamReader.h"
+
+// IGSIO includes
+#include <igsioTrackedFrame.h>
+#include <igsioVideoFrame.h>
+#include <vtkIGSIOTrackedFrameList.h>
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkObjectFactory.h>
+#include <vtkSmartPointer.h>
+#include <vtksys/SystemTools.hxx>
+
+// STL includes
+#include <array>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+vtkStandardNewMacro(vtkPlusSequenceFileWriter);
+
+namespace
+{
+  /*! Size of the blocks that the pixel data of .mha files is copied in */
+  const size_t COPY_BLOCK_SIZE_BYTES = 1 << 20;
+
+  const std::string SEQUENCE_FIELD_FRAME_PREFIX = "Seq_Frame";
+
+  /*! Header fields that are written by the writer, custom fields of the frame list with these names are ignored */
+  const char* RESERVED_FIELD_NAMES[] =
+  {
+    "ObjectType", "NDims", "AnatomicalOrientation", "BinaryData", "BinaryDataByteOrderMSB", "CenterOfRotation",
+    "CompressedData", "CompressedDataSize", "DimSize", "ElementNumberOfChannels", "ElementSpacing", "ElementType",
+    "ElementDataFile", "Kinds", "Offset", "TransformMatrix", "UltrasoundImageOrientation", "UltrasoundImageType"
+  };
+
+  //----------------------------------------------------------------------------
+  bool IsReservedFieldName(const std::string& fieldName)
+  {
+    for (size_t i = 0; i < sizeof(RESERVED_FIELD_NAMES) / sizeof(RESERVED_FIELD_NAMES[0]); i++)
+    {
+      if (fieldName == RESERVED_FIELD_NAMES[i])
+      {
+        return true;
+      }
+    }
+    return fieldName.compare(0, SEQUENCE_FIELD_FRAME_PREFIX.size(), SEQUENCE_FIELD_FRAME_PREFIX) == 0;
+  }
+
+  //----------------------------------------------------------------------------
+  bool GetMetaElementType(igsioCommon::VTKScalarPixelType pixelType, std::string& elementType)
+  {
+    switch (pixelType)
+    {
+      case VTK_CHAR:
+      case VTK_SIGNED_CHAR:
+        elementType = "MET_CHAR";
+        return true;
+      case VTK_UNSIGNED_CHAR:
+        elementType = "MET_UCHAR";
+        return true;
+      case VTK_SHORT:
+        elementType = "MET_SHORT";
+        return true;
+      case VTK_UNSIGNED_SHORT:
+        elementType = "MET_USHORT";
+        return true;
+      case VTK_INT:
+        elementType = "MET_INT";
+        return true;
+      case VTK_UNSIGNED_INT:
+        elementType = "MET_UINT";
+        return true;
+      case VTK_FLOAT:
+        elementType = "MET_FLOAT";
+        return true;
+      case VTK_DOUBLE:
+        elementType = "MET_DOUBLE";
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Path of the pixel data file of .mhd files (.raw or .zraw file next to the header file) */
+  std::string GetExternalPixelDataFilePath(const std::string& filename, bool useCompression)
+  {
+    std::string dataFilename = vtksys::SystemTools::GetFilenameWithoutLastExtension(filename) + (useCompression ? ".zraw" : ".raw");
+    std::string dataFileDirectory = vtksys::SystemTools::GetFilenamePath(filename);
+    return (dataFileDirectory.empty() ? dataFilename : dataFileDirectory + "/" + dataFilename);
+  }
+
+  //----------------------------------------------------------------------------
+  bool IsPixelDataLocal(const std::string& filename)
+  {
+    return vtksys::SystemTools::LowerCase(vtksys::SystemTools::GetFilenameLastExtension(filename)) == ".mha";
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Write the same value for each dimension, separated by spaces */
+  void WriteDimensionValues(std::ostream& file, int numberOfDimensions, double value)
+  {
+    for (int i = 0; i < numberOfDimensions; i++)
+    {
+      file << (i > 0 ? " " : "") << value;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkPlusSequenceFileWriter::vtkPlusSequenceFileWriter()
+  : UseCompression(true)
+  , CompressionLevel(-1)
+  , NumberOfThreads(0)
+  , ImageOrientationInFile(US_IMG_ORIENT_MF)
+  , NumberOfFrames(0)
+  , ImagePropertiesKnown(false)
+  , PixelType(VTK_UNSIGNED_CHAR)
+  , NumberOfScalarComponents(1)
+  , ImageType(US_IMG_BRIGHTNESS)
+  , NumberOfPendingBlankFrames(0)
+  , Deflate(new PlusParallelDeflate)
+  , DeflateStarted(false)
+  , PixelDataCopied(false)
+  , CompressedDataSizeBytes(0)
+{
+  this->FrameSize[0] = this->FrameSize[1] = this->FrameSize[2] = 0;
+  this->FrameSizeInFile[0] = this->FrameSizeInFile[1] = this->FrameSizeInFile[2] = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusSequenceFileWriter::~vtkPlusSequenceFileWriter()
+{
+  if (this->IsOpen())
+  {
+    LOG_WARNING("Sequence file is not closed, frames are discarded: " << this->FileName);
+    this->Discard();
+  }
+  delete this->Deflate;
+  this->Deflate = NULL;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusSequenceFileWriter::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "FileName: " << this->FileName << "\n";
+  os << indent << "NumberOfFrames: " << this->NumberOfFrames << "\n";
+  os << indent << "UseCompression: " << (this->UseCompression ? "TRUE" : "FALSE") << "\n";
+  os << indent << "CompressionLevel: " << this->CompressionLevel << "\n";
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << "\n";
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusSequenceFileWriter::CanWriteFile(const std::string& filename)
+{
+  std::string extension = vtksys::SystemTools::LowerCase(vtksys::SystemTools::GetFilenameLastExtension(filename));
+  return extension == ".mha" || extension == ".mhd";
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceFileWriter::Write(const std::string& filename, vtkIGSIOTrackedFrameList* frameList, US_IMAGE_ORIENTATION orientationInFile/*=US_IMG_ORIENT_MF*/,
+    bool useCompression/*=true*/, int numberOfThreads/*=0*/)
+{
+  vtkSmartPointer<vtkPlusSequenceFileWriter> writer = vtkSmartPointer<vtkPlusSequenceFileWriter>::New();
+  writer->SetUseCompression(useCompression);
+  writer->SetNumberOfThreads(numberOfThreads);
+  if (writer->Open(filename, orientationInFile) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  if (writer->AppendFrames(frameList) != PLUS_SUCCESS)
+  {
+    writer->Discard();
+    return PLUS_FAIL;
+  }
+  return writer->Close();
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusSequenceFileWriter::IsOpen() const
+{
+  return !this->FileName.empty();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceFileWriter::Open(const std::string& filename, US_IMAGE_ORIENTATION orientationInFile/*=US_IMG_ORIENT_MF*/)
+{
+  if (this->IsOpen())
+  {
+    LOG_ERROR("vtkPlusSequenceFileWriter::Open: a sequence is already open: " << this->FileName);
+    return PLUS_FAIL;
+  }
+  if (!CanWriteFile(filename))
+  {
+    LOG_ERROR("vtkPlusSequenceFileWriter::Open: unsupported file format: " << filename);
+    return PLUS_FAIL;
+  }
+  if (orientationInFile == US_IMG_ORIENT_XX)
+  {
+    LOG_ERROR("vtkPlusSequenceFileWriter::Open: invalid image orientation for file: " << filename);
+    return PLUS_FAIL;
+  }
+
+  this->PixelDataFilePath = (IsPixelDataLocal(filename) ? filename + ".pixeldata.tmp" : GetExternalPixelDataFilePath(filename, this->UseCompression));
+  this->FrameFieldsFilePath = filename + ".framefields.tmp";
+
+  this->PixelDataFile.open(this->PixelDataFilePath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!this->PixelDataFile.is_open())
+  {
+    LOG_ERROR("vtkPlusSequenceFileWriter::Open: failed to open file for writing: " << this->PixelDataFilePath);
+    this->ResetFiles();
+    return PLUS_FAIL;
+  }
+  this->FrameFieldsFile.open(this->FrameFieldsFilePath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!this->FrameFieldsFile.is_open())
+  {
+    LOG_ERROR("vtkPlusSequenceFileWriter::Open: failed to open file for writing: " << this->FrameFieldsFilePath);
+    this->ResetFiles();
+    return PLUS_FAIL;
+  }
+
+  this->FileName = filename;
+  this->ImageOrientationInFile = orientationInFile;
+  this->NumberOfFrames = 0;
+  this->ImagePropertiesKnown = false;
+  this->NumberOfPendingBlankFrames = 0;
+  this->CustomFields.clear();
+  this->DeflateStarted = false;
+  this->PixelDataCopied = false;
+  this->CompressedDataSizeBytes = 0;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceFileWriter::AppendFrames(vtkIGSIOTrackedFrameList* frameList)
+{
+  if (!this->IsOpen())
+  {
+    LOG_ERROR("vtkPlusSequenceFileWriter::AppendFrames: the sequence is not open");
+    return PLUS_FAIL;
+  }
+  if (frameList == NULL)
+  {
+    LOG_ERROR("vtkPlusSequenceFileWriter::AppendFrames: invalid frame list");
+    return PLUS_FAIL;
+  }
+  if (this->PixelDataCopied)
+  {
+    LOG_ERROR("vtkPlusSequenceFileWriter::AppendFrames: frames cannot be appended to copied frames");
+    return PLUS_FAIL;
+  }
+
+  this->AddCustomFields(frameList);
+
+  igsioVideoFrame::FlipInfoType flipInfo;
+  const bool convertOrientation = (this->ImageOrientationInFile != US_IMG_ORIENT_MF);
+  if (convertOrientation && this->ImagePropertiesKnown)
+  {
+    igsioVideoFrame::GetFlipAxes(US_IMG_ORIENT_MF, this->ImageType, this->ImageOrientationInFile, flipInfo);
+  }
+  // Pixel data of the frames (in file orientation), NULL for frames with an invalid image
+  std::vector<unsigned char*> framePixelData;
+  // Images converted to the file orientation
+  std::vector<igsioVideoFrame> convertedImages(convertOrientation ? frameList->GetNumberOfTrackedFrames() : 0);
+
+  for (unsigned int frameIndex = 0; frameIndex < frameList->GetNumberOfTrackedFrames(); ++frameIndex)
+  {
+    igsioTrackedFrame* frame = frameList->GetTrackedFrame(frameIndex);
+    std::ostringstream fieldPrefix;
+    fieldPrefix << SEQUENCE_FIELD_FRAME_PREFIX << std::setfill('0') << std::setw(4) << this->NumberOfFrames << "_";
+    igsioFieldMapType frameFields = frame->GetCustomFields();
+    for (igsioFieldMapType::iterator fieldIt = frameFields.begin(); fieldIt != frameFields.end(); ++fieldIt)
+    {
+      if (fieldIt->first != "ImageStatus")
+      {
+        this->FrameFieldsFile << fieldPrefix.str() << fieldIt->first << " = " << fieldIt->second.second << "\n";
+      }
+    }
+
+    vtkImageData* image = frame->GetImageData()->IsImageValid() ? frame->GetImageData()->GetImage() : NULL;
+    this->FrameFieldsFile << fieldPrefix.str() << "ImageStatus = " << (image != NULL ? "OK" : "INVALID") << "\n";
+    this->NumberOfFrames++;
+    if (image == NULL)
+    {
+      framePixelData.push_back(NULL);
+      continue;
+    }
+
+    int dimensions[3] = { 0, 0, 0 };
+    image->GetDimensions(dimensions);
+    if (!this->ImagePropertiesKnown)
+    {
+      this->FrameSize[0] = dimensions[0];
+      this->FrameSize[1] = dimensions[1];
+      this->FrameSize[2] = dimensions[2];
+      this->PixelType = image->GetScalarType();
+      this->NumberOfScalarComponents = image->GetNumberOfScalarComponents();
+      this->ImageType = frame->GetImageData()->GetImageType();
+      this->FrameSizeInFile = this->FrameSize;
+      if (convertOrientation)
+      {
+        if (igsioVideoFrame::GetFlipAxes(US_IMG_ORIENT_MF, this->ImageType, this->ImageOrientationInFile, flipInfo) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to convert image data from MF orientation to " << igsioCommon::GetStringFromUsImageOrientation(this->ImageOrientationInFile));
+          return PLUS_FAIL;
+        }
+        if (flipInfo.tranpose == igsioVideoFrame::TRANSPOSE_IJKtoKIJ)
+        {
+          this->FrameSizeInFile[0] = this->FrameSize[2];
+          this->FrameSizeInFile[1] = this->FrameSize[0];
+          this->FrameSizeInFile[2] = this->FrameSize[1];
+        }
+      }
+      std::string elementType;
+      if (!GetMetaElementType(this->PixelType, elementType))
+      {
+        LOG_ERROR("vtkPlusSequenceFileWriter::AppendFrames: unsupported pixel type: " << image->GetScalarTypeAsString());
+        return PLUS_FAIL;
+      }
+      this->ImagePropertiesKnown = true;
+    }
+    else if (static_cast<unsigned int>(dimensions[0]) != this->FrameSize[0] || static_cast<unsigned int>(dimensions[1]) != this->FrameSize[1]
+             || static_cast<unsigned int>(dimensions[2]) != this->FrameSize[2] || image->GetScalarType() != this->PixelType
+             || static_cast<unsigned int>(image->GetNumberOfScalarComponents()) != this->NumberOfScalarComponents)
+    {
+      LOG_ERROR("vtkPlusSequenceFileWriter::AppendFrames: size or pixel type of frame #" << this->NumberOfFrames - 1 << " (" << dimensions[0] << "x" << dimensions[1]
+                << "x" << dimensions[2] << ") does not match the previous frames (" << this->FrameSize[0] << "x" << this->FrameSize[1] << "x" << this->FrameSize[2] << ")");
+      return PLUS_FAIL;
+    }
+
+    unsigned char* pixelData = static_cast<unsigned char*>(image->GetScalarPointer());
+    if (convertOrientation)
+    {
+      igsioVideoFrame& convertedImage = convertedImages[frameIndex];
+      std::array<int, 3> clipRectangleOrigin = { igsioCommon::NO_CLIP, igsioCommon::NO_CLIP, igsioCommon::NO_CLIP };
+      std::array<int, 3> clipRectangleSize = { igsioCommon::NO_CLIP, igsioCommon::NO_CLIP, igsioCommon::NO_CLIP };
+      if (convertedImage.AllocateFrame(this->FrameSizeInFile, this->PixelType, this->NumberOfScalarComponents) != PLUS_SUCCESS
+          || igsioVideoFrame::GetOrientedClippedImage(pixelData, flipInfo, this->ImageType, this->PixelType, this->NumberOfScalarComponents,
+              this->FrameSize, convertedImage, clipRectangleOrigin, clipRectangleSize) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to convert image of frame #" << this->NumberOfFrames - 1 << " to " << igsioCommon::GetStringFromUsImageOrientation(this->ImageOrientationInFile) << " orientation");
+        return PLUS_FAIL;
+      }
+      pixelData = static_cast<unsigned char*>(convertedImage.GetScalarPointer());
+    }
+    framePixelData.push_back(pixelData);
+  }
+
+  if (!this->FrameFieldsFile.good())
+  {
+    LOG_ERROR("vtkPlusSequenceFileWriter::AppendFrames: failed to write to file: " << this->FrameFieldsFilePath);
+    return PLUS_FAIL;
+  }
+  if (!this->ImagePropertiesKnown)
+  {
+    // None of the frames has an image yet, blank images are written when the frame size is known
+    this->NumberOfPendingBlankFrames += static_cast<int>(framePixelData.size());
+    return PLUS_SUCCESS;
+  }
+  if (this->NumberOfPendingBlankFrames > 0)
+  {
+    framePixelData.insert(framePixelData.begin(), this->NumberOfPendingBlankFrames, NULL);
+    this->NumberOfPendingBlankFrames = 0;
+  }
+  return this->WritePixelData(framePixelData);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceFileWriter::WritePixelData(const std::vector<unsigned char*>& framePixelData)
+{
+  const size_t frameSizeInBytes = static_cast<size_t>(this->FrameSizeInFile[0]) * this->FrameSizeInFile[1] * this->FrameSizeInFile[2]
+                                  * this->NumberOfScalarComponents * igsioVideoFrame::GetNumberOfBytesPerScalar(this->PixelType);
+  std::vector<unsigned char> blankFrame;
+  std::vector<PlusParallelDeflate::DataSegment> segments;
+  for (std::vector<unsigned char*>::const_iterator pixelDataIt = framePixelData.begin(); pixelDataIt != framePixelData.end(); ++pixelDataIt)
+  {
+    PlusParallelDeflate::DataSegment segment;
+    segment.NumberOfBytes = frameSizeInBytes;
+    segment.Data = *pixelDataIt;
+    if (segment.Data == NULL)
+    {
+      blankFrame.resize(frameSizeInBytes, 0);
+      segment.Data = &blankFrame[0];
+    }
+    segments.push_back(segment);
+  }
+
+  if (this->UseCompression)
+  {
+    if (!this->DeflateStarted)
+    {
+      this->Deflate->SetCompressionLevel(this->CompressionLevel);
+      this->Deflate->SetNumberOfThreads(this->NumberOfThreads);
+      if (this->Deflate->Start(this->PixelDataFile, PlusParallelDeflate::FORMAT_ZLIB) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("vtkPlusSequenceFileWriter::AppendFrames: failed to write to file: " << this->PixelDataFilePath);
+        return PLUS_FAIL;
+      }
+      this->DeflateStarted = true;
+    }
+    if (this->Deflate->Write(segments) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("vtkPlusSequenceFileWriter::AppendFrames: failed to write compressed pixel data to file: " << this->PixelDataFilePath);
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+  for (std::vector<PlusParallelDeflate::DataSegment>::iterator segmentIt = segments.begin(); segmentIt != segments.end(); ++segmentIt)
+  {
+    this->PixelDataFile.write(reinterpret_cast<const char*>(segmentIt->Data), segmentIt->NumberOfBytes);
+  }
+  if (!this->PixelDataFile.good())
+  {
+    LOG_ERROR("vtkPlusSequenceFileWriter::AppendFrames: failed to write pixel data to file: " << this->PixelDataFilePath);
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceFileWriter::Close(const std::string& filename/*=""*/)
+{
+  if (!this->IsOpen())
+  {
+    LOG_ERROR("vtkPlusSequenceFileWriter::Close: the sequence is not open");
+    return PLUS_FAIL;
+  }
+  if (!filename.empty())
+  {
+    if (!CanWriteFile(filename))
+    {
+      LOG_ERROR("vtkPlusSequenceFileWriter::Close: unsupported file format: " << filename);
+      this->Discard();
+      return PLUS_FAIL;
+    }
+    this->FileName = filename;
+  }
+  if (!this->ImagePropertiesKnown)
+  {
+    LOG_ERROR("vtkPlusSequenceFileWriter::Close: none of the frames has a valid image, the sequence is not written: " << this->FileName);
+    this->Discard();
+    return PLUS_FAIL;
+  }
+  if (this->UseCompression && !this->PixelDataCopied)
+  {
+    if ((!this->DeflateStarted && this->Deflate->Start(this->PixelDataFile, PlusParallelDeflate::FORMAT_ZLIB) != PLUS_SUCCESS)
+        || this->Deflate->Finish() != PLUS_SUCCESS)
+    {
+      LOG_ERROR("vtkPlusSequenceFileWriter::Close: failed to write compressed pixel data to file: " << this->PixelDataFilePath);
+      this->Discard();
+      return PLUS_FAIL;
+    }
+    this->DeflateStarted = false;
+    this->CompressedDataSizeBytes = this->Deflate->GetCompressedSizeBytes();
+  }
+  this->PixelDataFile.close();
+  this->FrameFieldsFile.close();
+
+  // Pixel data of .mha files is copied from the temporary file after the header
+  const bool localPixelData = IsPixelDataLocal(this->FileName);
+  if (!localPixelData)
+  {
+    // The file name may have changed since Open
+    std::string dataFilePath = GetExternalPixelDataFilePath(this->FileName, this->UseCompression);
+    if (dataFilePath != this->PixelDataFilePath)
+    {
+      vtksys::SystemTools::RemoveFile(dataFilePath.c_str());
+      if (std::rename(this->PixelDataFilePath.c_str(), dataFilePath.c_str()) != 0)
+      {
+        LOG_ERROR("vtkPlusSequenceFileWriter::Close: failed to rename pixel data file " << this->PixelDataFilePath << " to " << dataFilePath);
+        this->Discard();
+        return PLUS_FAIL;
+      }
+      this->PixelDataFilePath = dataFilePath;
+    }
+  }
+  std::ofstream file(this->FileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file.is_open())
+  {
+    LOG_ERROR("vtkPlusSequenceFileWriter::Close: failed to open file for writing: " << this->FileName);
+    this->Discard();
+    return PLUS_FAIL;
+  }
+  if (this->WriteHeader(file, localPixelData ? "LOCAL" : vtksys::SystemTools::GetFilenameName(this->PixelDataFilePath)) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("vtkPlusSequenceFileWriter::Close: failed to write header to file: " << this->FileName);
+    file.close();
+    this->Discard();
+    return PLUS_FAIL;
+  }
+
+  if (localPixelData)
+  {
+    std::ifstream pixelDataFile(this->PixelDataFilePath.c_str(), std::ios::in | std::ios::binary);
+    std::vector<char> block(COPY_BLOCK_SIZE_BYTES);
+    while (pixelDataFile.good())
+    {
+      pixelDataFile.read(&block[0], block.size());
+      file.write(&block[0], pixelDataFile.gcount());
+    }
+    if (!pixelDataFile.eof() || !file.good())
+    {
+      LOG_ERROR("vtkPlusSequenceFileWriter::Close: failed to copy pixel data to file: " << this->FileName);
+      file.close();
+      this->Discard();
+      return PLUS_FAIL;
+    }
+    pixelDataFile.close();
+    vtksys::SystemTools::RemoveFile(this->PixelDataFilePath.c_str());
+  }
+  file.close();
+
+  LOG_DEBUG("Sequence file written: " << this->FileName << " (" << this->NumberOfFrames << " frames)");
+  // The pixel data file of .mhd files is part of the sequence, it is kept
+  this->PixelDataFilePath.clear();
+  this->ResetFiles();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceFileWriter::WriteHeader(std::ostream& file, const std::string& elementDataFile)
+{
+#ifdef VTK_WORDS_BIGENDIAN
+  const bool bigEndian = true;
+#else
+  const bool bigEndian = false;
+#endif
+  std::string elementType;
+  GetMetaElementType(this->PixelType, elementType);
+  // 2D frames are stored in a 3D image, 3D frames in a 4D image, the last dimension is the frame index
+  const int numberOfDimensions = (this->FrameSizeInFile[2] > 1 ? 4 : 3);
+
+  file << "ObjectType = Image\n";
+  file << "NDims = " << numberOfDimensions << "\n";
+  file << "AnatomicalOrientation = " << (numberOfDimensions == 4 ? "RAIS" : "RAI") << "\n";
+  file << "BinaryData = True\n";
+  file << "BinaryDataByteOrderMSB = " << (bigEndian ? "True" : "False") << "\n";
+  file << "CenterOfRotation = ";
+  WriteDimensionValues(file, numberOfDimensions, 0);
+  file << "\n";
+  file << "CompressedData = " << (this->UseCompression ? "True" : "False") << "\n";
+  if (this->UseCompression)
+  {
+    file << "CompressedDataSize = " << this->CompressedDataSizeBytes << "\n";
+  }
+  file << "DimSize = " << this->FrameSizeInFile[0] << " " << this->FrameSizeInFile[1] << " ";
+  if (numberOfDimensions == 4)
+  {
+    file << this->FrameSizeInFile[2] << " ";
+  }
+  file << this->NumberOfFrames << "\n";
+  if (this->NumberOfScalarComponents > 1)
+  {
+    file << "ElementNumberOfChannels = " << this->NumberOfScalarComponents << "\n";
+  }
+  file << "ElementSpacing = ";
+  WriteDimensionValues(file, numberOfDimensions, 1);
+  file << "\n";
+  file << "Offset = ";
+  WriteDimensionValues(file, numberOfDimensions, 0);
+  file << "\n";
+  file << "TransformMatrix =";
+  for (int row = 0; row < numberOfDimensions; row++)
+  {
+    for (int column = 0; column < numberOfDimensions; column++)
+    {
+      file << " " << (row == column ? 1 : 0);
+    }
+  }
+  file << "\n";
+  file << "ElementType = " << elementType << "\n";
+  file << "Kinds = domain domain " << (numberOfDimensions == 4 ? "domain " : "") << "list\n";
+  file << "UltrasoundImageOrientation = " << igsioCommon::GetStringFromUsImageOrientation(this->ImageOrientationInFile) << "\n";
+  file << "UltrasoundImageType = " << igsioCommon::GetStringFromUsImageType(this->ImageType) << "\n";
+  for (std::map<std::string, std::string>::iterator fieldIt = this->CustomFields.begin(); fieldIt != this->CustomFields.end(); ++fieldIt)
+  {
+    file << fieldIt->first << " = " << fieldIt->second << "\n";
+  }
+
+  std::ifstream frameFieldsFile(this->FrameFieldsFilePath.c_str(), std::ios::in | std::ios::binary);
+  if (!frameFieldsFile.is_open())
+  {
+    LOG_ERROR("Failed to open file of frame fields: " << this->FrameFieldsFilePath);
+    return PLUS_FAIL;
+  }
+  if (frameFieldsFile.peek() != std::ifstream::traits_type::eof())
+  {
+    file << frameFieldsFile.rdbuf();
+  }
+  file << "ElementDataFile = " << elementDataFile << "\n";
+  return file.good() ? PLUS_SUCCESS : PLUS_FAIL;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusSequenceFileWriter::Discard()
+{
+  this->ResetFiles();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusSequenceFileWriter::ResetFiles()
+{
+  if (this->PixelDataFile.is_open())
+  {
+    this->PixelDataFile.close();
+  }
+  if (this->FrameFieldsFile.is_open())
+  {
+    this->FrameFieldsFile.close();
+  }
+  if (!this->PixelDataFilePath.empty())
+  {
+    vtksys::SystemTools::RemoveFile(this->PixelDataFilePath.c_str());
+  }
+  if (!this->FrameFieldsFilePath.empty())
+  {
+    vtksys::SystemTools::RemoveFile(this->FrameFieldsFilePath.c_str());
+  }
+  this->PixelDataFilePath.clear();
+  this->FrameFieldsFilePath.clear();
+  this->FileName.clear();
+  this->CustomFields.clear();
+  this->NumberOfFrames = 0;
+  this->ImagePropertiesKnown = false;
+  this->NumberOfPendingBlankFrames = 0;
+  this->DeflateStarted = false;
+  this->PixelDataCopied = false;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusSequenceFileWriter::AddCustomFields(vtkIGSIOTrackedFrameList* frameList)
+{
+  std::vector<std::string> customFieldNames;
+  frameList->GetCustomFieldNameList(customFieldNames);
+  for (std::vector<std::string>::iterator fieldNameIt = customFieldNames.begin(); fieldNameIt != customFieldNames.end(); ++fieldNameIt)
+  {
+    const char* fieldValue = frameList->GetCustomString(fieldNameIt->c_str());
+    if (fieldValue != NULL && !IsReservedFieldName(*fieldNameIt))
+    {
+      this->CustomFields[*fieldNameIt] = fieldValue;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceFileWriter::CopyFrames(vtkPlusSequenceStreamReader* reader, vtkIGSIOTrackedFrameList* frameFieldList)
+{
+  if (!this->IsOpen())
+  {
+    LOG_ERROR("vtkPlusSequenceFileWriter::CopyFrames: the sequence is not open");
+    return PLUS_FAIL;
+  }
+  if (reader == NULL || frameFieldList == NULL)
+  {
+    LOG_ERROR("vtkPlusSequenceFileWriter::CopyFrames: invalid input");
+    return PLUS_FAIL;
+  }
+  if (this->NumberOfFrames > 0 || this->PixelDataCopied)
+  {
+    LOG_ERROR("vtkPlusSequenceFileWriter::CopyFrames: frames cannot be copied after other frames");
+    return PLUS_FAIL;
+  }
+  if (static_cast<int>(frameFieldList->GetNumberOfTrackedFrames()) != reader->GetNumberOfFrames())
+  {
+    LOG_ERROR("vtkPlusSequenceFileWriter::CopyFrames: the frame list contains " << frameFieldList->GetNumberOfTrackedFrames()
+              << " frames, but the sequence contains " << reader->GetNumberOfFrames() << " frames");
+    return PLUS_FAIL;
+  }
+  if (reader->GetCompressedData() != this->UseCompression || reader->GetImageOrientationInFile() != this->ImageOrientationInFile)
+  {
+    LOG_ERROR("vtkPlusSequenceFileWriter::CopyFrames: compression or image orientation of the sequence does not match the input file");
+    return PLUS_FAIL;
+  }
+
+  this->AddCustomFields(frameFieldList);
+  for (unsigned int frameIndex = 0; frameIndex < frameFieldList->GetNumberOfTrackedFrames(); ++frameIndex)
+  {
+    std::ostringstream fieldPrefix;
+    fieldPrefix << SEQUENCE_FIELD_FRAME_PREFIX << std::setfill('0') << std::setw(4) << frameIndex << "_";
+    igsioFieldMapType frameFields = frameFieldList->GetTrackedFrame(frameIndex)->GetCustomFields();
+    for (igsioFieldMapType::iterator fieldIt = frameFields.begin(); fieldIt != frameFields.end(); ++fieldIt)
+    {
+      this->FrameFieldsFile << fieldPrefix.str() << fieldIt->first << " = " << fieldIt->second.second << "\n";
+    }
+    if (frameFields.find("ImageStatus") == frameFields.end())
+    {
+      this->FrameFieldsFile << fieldPrefix.str() << "ImageStatus = OK\n";
+    }
+  }
+  if (!this->FrameFieldsFile.good())
+  {
+    LOG_ERROR("vtkPlusSequenceFileWriter::CopyFrames: failed to write to file: " << this->FrameFieldsFilePath);
+    return PLUS_FAIL;
+  }
+
+  reader->GetFrameSize(this->FrameSize);
+  reader->GetFrameSizeInFile(this->FrameSizeInFile);
+  this->PixelType = reader->GetPixelType();
+  this->NumberOfScalarComponents = reader->GetNumberOfScalarComponents();
+  this->ImageType = reader->GetImageType();
+  this->ImagePropertiesKnown = true;
+  this->NumberOfFrames = reader->GetNumberOfFrames();
+  this->PixelDataCopied = true;
+
+  vtkTypeUInt64 numberOfBytesCopied = 0;
+  if (reader->CopyPixelData(this->PixelDataFile, numberOfBytesCopied) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("vtkPlusSequenceFileWriter::CopyFrames: failed to copy pixel data to file: " << this->PixelDataFilePath);
+    return PLUS_FAIL;
+  }
+  this->CompressedDataSizeBytes = numberOfBytesCopied;
+  return PLUS_SUCCESS;
+}
@@ -0,0 +1,161 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusSequenceFileWriter_h
+#define __vtkPlusSequenceFileWriter_h
+
+#include "vtkPlusCommonExport.h"
+#include "vtkObject.h"
+
+#include <igsioCommon.h>
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+class PlusParallelDeflate;
+class vtkIGSIOTrackedFrameList;
+class vtkPlusSequenceStreamReader;
+
+/*!
+  \class vtkPlusSequenceFileWriter
+  \brief Writes tracked frames to a sequence metafile, compressing the pixel data on multiple threads
+
+  Frames are appended to the file list by list, so a sequence can be recorded without keeping all frames in memory.
+  The pixel data of all frames forms a single zlib stream, which is compressed in chunks on multiple threads by
+  PlusParallelDeflate. Any MetaImage reader (including vtkPlusSequenceIO::Read and vtkPlusSequenceStreamReader) can read the files.
+
+  The frame fields and the pixel data are written to temporary files while frames are appended, the header is written
+  by Close, when the number of frames and the compressed data size are known. Pixel data of .mhd files is written directly
+  to the .raw or .zraw data file, pixel data of .mha files is copied after the header by Close.
+
+  Frames with an invalid image are written as blank images with ImageStatus = INVALID. All valid images must have the same
+  size and pixel type.
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport vtkPlusSequenceFileWriter : public vtkObject
+{
+public:
+  static vtkPlusSequenceFileWriter* New();
+  vtkTypeMacro(vtkPlusSequenceFileWriter, vtkObject);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  /*! Returns true if the format of the file (determined from the file extension) can be written */
+  static bool CanWriteFile(const std::string& filename);
+
+  /*! Write all frames of the frame list to file */
+  static PlusStatus Write(const std::string& filename, vtkIGSIOTrackedFrameList* frameList, US_IMAGE_ORIENTATION orientationInFile = US_IMG_ORIENT_MF,
+                          bool useCompression = true, int numberOfThreads = 0);
+
+  /*! Create the temporary files of a sequence. Images are converted from MF to orientationInFile when they are written. */
+  PlusStatus Open(const std::string& filename, US_IMAGE_ORIENTATION orientationInFile = US_IMG_ORIENT_MF);
+
+  /*! Append the frames of the list to the sequence. Custom fields of the frame list are added to the header. */
+  PlusStatus AppendFrames(vtkIGSIOTrackedFrameList* frameList);
+
+  /*!
+    Write the frame fields of the frame list and copy the pixel data of the sequence of the reader unchanged, without
+    decompressing and recompressing it (for editing only the fields of a sequence). The frame list must contain the fields
+    of all frames of the reader, the frames need no image. It can only be called instead of AppendFrames and the sequence
+    must be opened with the image orientation and compression of the file of the reader.
+  */
+  PlusStatus CopyFrames(vtkPlusSequenceStreamReader* reader, vtkIGSIOTrackedFrameList* frameFieldList);
+
+  /*!
+    Write the header, complete the file and delete the temporary files.
+    If filename is not empty then the sequence is written to that file instead of the file specified in Open.
+  */
+  PlusStatus Close(const std::string& filename = "");
+
+  /*! Delete the temporary files without writing the sequence */
+  void Discard();
+
+  /*! Returns true if a sequence is open for appending frames */
+  bool IsOpen() const;
+
+  /*! Number of frames appended since Open */
+  vtkGetMacro(NumberOfFrames, int);
+
+  /*! If enabled then the pixel data is compressed. Can only be changed before Open. */
+  vtkSetMacro(UseCompression, bool);
+  vtkGetMacro(UseCompression, bool);
+  vtkBooleanMacro(UseCompression, bool);
+
+  /*! zlib compression level (1 = fastest, 9 = smallest), -1 means the zlib default */
+  vtkSetClampMacro(CompressionLevel, int, -1, 9);
+  vtkGetMacro(CompressionLevel, int);
+
+  /*! Number of threads that compress the pixel data. If 0 then the number of processors is used. */
+  vtkSetClampMacro(NumberOfThreads, int, 0, VTK_MAX_THREADS);
+  vtkGetMacro(NumberOfThreads, int);
+
+protected:
+  vtkPlusSequenceFileWriter();
+  virtual ~vtkPlusSequenceFileWriter();
+
+  /*!
+    Write the pixel data of frames (in file orientation) to the pixel data file, compressed if UseCompression is enabled.
+    Blank images are written for NULL pointers.
+  */
+  PlusStatus WritePixelData(const std::vector<unsigned char*>& framePixelData);
+
+  /*! Write the header, including the frame fields, into the sequence file */
+  PlusStatus WriteHeader(std::ostream& file, const std::string& elementDataFile);
+
+  /*! Delete the temporary files and reset the state */
+  void ResetFiles();
+
+  /*! Add the custom fields of the frame list to the header fields */
+  void AddCustomFields(vtkIGSIOTrackedFrameList* frameList);
+
+  bool UseCompression;
+  int CompressionLevel;
+  int NumberOfThreads;
+
+  std::string FileName;
+  US_IMAGE_ORIENTATION ImageOrientationInFile;
+  int NumberOfFrames;
+
+  /*! Image properties, set from the first frame with a valid image */
+  bool ImagePropertiesKnown;
+  FrameSizeType FrameSize;
+  FrameSizeType FrameSizeInFile;
+  igsioCommon::VTKScalarPixelType PixelType;
+  unsigned int NumberOfScalarComponents;
+  US_IMAGE_TYPE ImageType;
+
+  /*! Frames with an invalid image before the first valid image, their pixel data is written when the frame size is known */
+  int NumberOfPendingBlankFrames;
+
+  /*! Header fields that are not frame fields, collected from the custom fields of the appended frame lists */
+  std::map<std::string, std::string> CustomFields;
+
+  /*! Pixel data file (the .raw/.zraw file of .mhd files, a temporary file for .mha files) */
+  std::string PixelDataFilePath;
+  std::ofstream PixelDataFile;
+
+  /*! Temporary file that contains the frame field lines of the header */
+  std::string FrameFieldsFilePath;
+  std::ofstream FrameFieldsFile;
+
+  PlusParallelDeflate* Deflate;
+  /*! Set when the zlib stream is started, by the first pixel data written */
+  bool DeflateStarted;
+
+  /*! Set if the pixel data is copied from another file by CopyFrames */
+  bool PixelDataCopied;
+
+  /*! Size of the pixel data in the file, for the CompressedDataSize field */
+  unsigned long long CompressedDataSizeBytes;
+
+private:
+  vtkPlusSequenceFileWriter(const vtkPlusSequenceFileWriter&);  // Not implemented.
+  void operator=(const vtkPlusSequenceFileWriter&);  // Not implemented.
+};
+
+#endif
@@ -5,12 +5,17 @@
 =========================================================Plus=header=end*/
 
 #include "PlusConfigure.h"
+#include "vtkPlusSequenceFileWriter.h"
 #include "vtkPlusSequenceIO.h"
+#include "vtkPlusSequenceStreamReader.h"
+#include "vtkPlusTrackingSequenceFile.h"
 
 #include <vtkIGSIOSequenceIO.h>
+#include <vtkIGSIOTrackedFrameList.h>
 
 /// VTK includes
 #include <vtkNew.h>
+#include <vtkSmartPointer.h>
 
 //----------------------------------------------------------------------------
 igsioStatus vtkPlusSequenceIO::Write(const std::string& filename, vtkIGSIOTrackedFrameList* frameList, US_IMAGE_ORIENTATION orientationInFile/*=US_IMG_ORIENT_MF*/, bool useCompression/*=true*/, bool enableImageDataWrite/*=true*/)
@@ -20,6 +25,17 @@ igsioStatus vtkPlusSequenceIO::Write(const std::string& filename, vtkIGSIOTracke
   {
     outputDirectory = vtkPlusConfig::GetInstance()->GetOutputDirectory();
   }
+  if (vtkPlusTrackingSequenceFile::CanWriteFile(filename))
+  {
+    std::string filePath = (outputDirectory.empty() ? filename : outputDirectory + "/" + filename);
+    return vtkPlusTrackingSequenceFile::Write(filePath, frameList);
+  }
+  if (useCompression && enableImageDataWrite && vtkPlusSequenceFileWriter::CanWriteFile(filename))
+  {
+    // Pixel data is compressed on multiple threads
+    std::string filePath = (outputDirectory.empty() ? filename : outputDirectory + "/" + filename);
+    return vtkPlusSequenceFileWriter::Write(filePath, frameList, orientationInFile, useCompression);
+  }
   return vtkIGSIOSequenceIO::Write(filename, outputDirectory, frameList, orientationInFile, useCompression, enableImageDataWrite);
 }
 
@@ -31,11 +47,18 @@ igsioStatus vtkPlusSequenceIO::Write(const std::string& filename, igsioTrackedFr
   {
     outputDirectory = vtkPlusConfig::GetInstance()->GetOutputDirectory();
   }
+  if (vtkPlusTrackingSequenceFile::CanWriteFile(filename))
+  {
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> frameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    frameList->AddTrackedFrame(frame);
+    std::string filePath = (outputDirectory.empty() ? filename : outputDirectory + "/" + filename);
+    return vtkPlusTrackingSequenceFile::Write(filePath, frameList);
+  }
   return vtkIGSIOSequenceIO::Write(filename, outputDirectory, frame, orientationInFile, useCompression, enableImageDataWrite);
 }
 
 //----------------------------------------------------------------------------
-igsioStatus vtkPlusSequenceIO::Read(const std::string& trackedSequenceDataFileName, vtkIGSIOTrackedFrameList* frameList)
+igsioStatus vtkPlusSequenceIO::Read(const std::string& trackedSequenceDataFileName, vtkIGSIOTrackedFrameList* frameList, bool useMemoryMapping/*=false*/)
 {
   std::string trackedSequenceDataFilePath = trackedSequenceDataFileName;
 
@@ -48,5 +71,23 @@ igsioStatus vtkPlusSequenceIO::Read(const std::string& trackedSequenceDataFileNa
       return PLUS_FAIL;
     }
   }
+
+  if (vtkPlusTrackingSequenceFile::CanReadFile(trackedSequenceDataFilePath))
+  {
+    return vtkPlusTrackingSequenceFile::Read(trackedSequenceDataFilePath, frameList);
+  }
+
+  if (useMemoryMapping)
+  {
+    if (vtkPlusSequenceStreamReader::CanReadFile(trackedSequenceDataFilePath))
+    {
+      vtkSmartPointer<vtkPlusSequenceStreamReader> reader = vtkSmartPointer<vtkPlusSequenceStreamReader>::New();
+      if (reader->Open(trackedSequenceDataFilePath) == PLUS_SUCCESS && reader->CanReadAllFramesMemoryMapped())
+      {
+        return reader->ReadAllFramesMemoryMapped(frameList);
+      }
+    }
+    LOG_INFO("Sequence file cannot be memory mapped (only uncompressed MetaImage files in MF orientation can be), reading it into memory: " << trackedSequenceDataFilePath);
+  }
   return vtkIGSIOSequenceIO::Read(trackedSequenceDataFilePath, frameList);
 }
@@ -20,11 +20,21 @@ public:
   /*! Write object contents into file */
   static igsioStatus Write(const std::string& filename, igsioTrackedFrame* frame, US_IMAGE_ORIENTATION orientationInFile = US_IMG_ORIENT_MF, bool useCompression = true, bool EnableImageDataWrite = true);
 
-  /*! Write object contents into file */
+  /*!
+    Write object contents into file.
+    Compressed MetaImage files (.mha, .mhd) are written by vtkPlusSequenceFileWriter, which compresses the pixel data on multiple threads.
+    Tracking sequence files (.ptrk) are written by vtkPlusTrackingSequenceFile, without the image data.
+  */
   static igsioStatus Write(const std::string& filename, vtkIGSIOTrackedFrameList* frameList, US_IMAGE_ORIENTATION orientationInFile = US_IMG_ORIENT_MF, bool useCompression = true, bool EnableImageDataWrite = true);
 
-  /*! Read file contents into the object */
-  static igsioStatus Read(const std::string& filename, vtkIGSIOTrackedFrameList* frameList);
+  /*!
+    Read file contents into the object.
+    If useMemoryMapping is enabled and the file is an uncompressed MetaImage sequence in MF orientation then the frame images
+    are views into a memory mapping of the file (see vtkPlusSequenceStreamReader::ReadAllFramesMemoryMapped), and pixels are only
+    read from the disk when they are accessed. Other files are read into memory.
+    Tracking sequence files (.ptrk) are read by vtkPlusTrackingSequenceFile, the frames have no image.
+  */
+  static igsioStatus Read(const std::string& filename, vtkIGSIOTrackedFrameList* frameList, bool useMemoryMapping = false);
 
 protected:
   vtkPlusSequenceIO();
@@ -0,0 +1,1230 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "vtkPlusSequenceStreamReader.h"
+#include "vtkPlusMemoryMappedFile.h"
+
+// IGSIO includes
+#include <igsioTrackedFrame.h>
+#include <igsioVideoFrame.h>
+#include <vtkIGSIOTrackedFrameList.h>
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkSmartPointer.h>
+#include <vtk_zlib.h>
+#include <vtksys/SystemTools.hxx>
+
+// STL includes
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <list>
+#include <sstream>
+
+vtkStandardNewMacro(vtkPlusSequenceStreamReader);
+
+namespace
+{
+  /*! Size of the blocks that compressed pixel data is read in */
+  const size_t COMPRESSED_READ_BLOCK_SIZE_BYTES = 1 << 20;
+
+  /*! Size of the deflate history window, which is stored at each access point */
+  const size_t DEFLATE_WINDOW_SIZE_BYTES = 1 << 15;
+
+  /*! Minimum distance between access points, in bytes of uncompressed pixel data */
+  const vtkTypeUInt64 ACCESS_POINT_SPAN_BYTES = 8 << 20;
+
+  const char FRAME_INDEX_FILE_SIGNATURE[8] = { 'P', 'L', 'U', 'S', 'F', 'I', 'D', 'X' };
+  const vtkTypeUInt32 FRAME_INDEX_FILE_VERSION = 1;
+  const std::string FRAME_INDEX_FILE_EXTENSION = ".frameindex";
+
+  const std::string SEQUENCE_FIELD_FRAME_PREFIX = "Seq_Frame";
+
+  //----------------------------------------------------------------------------
+  template<class T> void WriteBinaryValue(std::ostream& stream, T value)
+  {
+    stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  //----------------------------------------------------------------------------
+  template<class T> bool ReadBinaryValue(std::istream& stream, T& value)
+  {
+    stream.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return stream.gcount() == static_cast<std::streamsize>(sizeof(T));
+  }
+
+  //----------------------------------------------------------------------------
+  vtkTypeUInt64 GetFileSize(const std::string& filePath)
+  {
+    std::ifstream file(filePath.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+    {
+      return 0;
+    }
+    return static_cast<vtkTypeUInt64>(file.tellg());
+  }
+
+  //----------------------------------------------------------------------------
+  std::string TrimWhitespace(const std::string& str)
+  {
+    const std::string whitespace = " \t\r\n";
+    size_t first = str.find_first_not_of(whitespace);
+    if (first == std::string::npos)
+    {
+      return "";
+    }
+    size_t last = str.find_last_not_of(whitespace);
+    return str.substr(first, last - first + 1);
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus GetPixelTypeFromMetaElementType(const std::string& elementType, igsioCommon::VTKScalarPixelType& pixelType)
+  {
+    const struct
+    {
+      const char* MetaElementType;
+      igsioCommon::VTKScalarPixelType PixelType;
+    } elementTypes[] =
+    {
+      { "MET_CHAR", VTK_CHAR },
+      { "MET_UCHAR", VTK_UNSIGNED_CHAR },
+      { "MET_SHORT", VTK_SHORT },
+      { "MET_USHORT", VTK_UNSIGNED_SHORT },
+      { "MET_INT", VTK_INT },
+      { "MET_UINT", VTK_UNSIGNED_INT },
+      { "MET_LONG", VTK_INT },
+      { "MET_ULONG", VTK_UNSIGNED_INT },
+      { "MET_FLOAT", VTK_FLOAT },
+      { "MET_DOUBLE", VTK_DOUBLE }
+    };
+    for (size_t i = 0; i < sizeof(elementTypes) / sizeof(elementTypes[0]); i++)
+    {
+      if (elementType == elementTypes[i].MetaElementType)
+      {
+        pixelType = elementTypes[i].PixelType;
+        return PLUS_SUCCESS;
+      }
+    }
+    return PLUS_FAIL;
+  }
+}
+
+//----------------------------------------------------------------------------
+class vtkPlusSequenceStreamReader::vtkInternal
+{
+public:
+  /*! State of the decompressor at the beginning of a deflate block */
+  struct AccessPoint
+  {
+    /*! Position in the uncompressed pixel data */
+    vtkTypeUInt64 UncompressedOffset;
+    /*! Position in the compressed pixel data of the first byte that is not fully decompressed */
+    vtkTypeUInt64 CompressedOffset;
+    /*! Number of bits of the previous byte that belong to the block */
+    int Bits;
+    /*! Last DEFLATE_WINDOW_SIZE_BYTES bytes of uncompressed data before the block */
+    std::vector<unsigned char> Window;
+  };
+
+  typedef std::list< std::pair< int, std::vector<unsigned char> > > FrameCacheType;
+
+  vtkInternal()
+    : ZStreamInitialized(false)
+    , PixelDataPosition(0)
+    , FrameIndexFileChecked(false)
+    , FrameIndexBuildFailed(false)
+  {
+  }
+
+  ~vtkInternal()
+  {
+    this->Close();
+  }
+
+  void Close()
+  {
+    if (this->ZStreamInitialized)
+    {
+      inflateEnd(&this->ZStream);
+      this->ZStreamInitialized = false;
+    }
+    if (this->DataFile.is_open())
+    {
+      this->DataFile.close();
+    }
+    this->CompressedBuffer.clear();
+    this->PixelDataPosition = 0;
+    this->AccessPoints.clear();
+    this->FrameIndexFileChecked = false;
+    this->FrameIndexBuildFailed = false;
+    this->FrameCache.clear();
+    this->FrameCacheIterators.clear();
+  }
+
+  /*! Initialize decompression, windowBits is MAX_WBITS for the zlib stream and -MAX_WBITS for raw deflate data */
+  PlusStatus ResetZStream(int windowBits)
+  {
+    if (this->ZStreamInitialized)
+    {
+      inflateEnd(&this->ZStream);
+      this->ZStreamInitialized = false;
+    }
+    memset(&this->ZStream, 0, sizeof(this->ZStream));
+    if (inflateInit2(&this->ZStream, windowBits) != Z_OK)
+    {
+      return PLUS_FAIL;
+    }
+    this->ZStreamInitialized = true;
+    return PLUS_SUCCESS;
+  }
+
+  /*!
+    Start decompression at an access point, or at the beginning of the pixel data if accessPoint is NULL.
+    Access points are inside the deflate stream, so only the beginning of the pixel data has a zlib header.
+  */
+  PlusStatus StartDecompression(std::streamoff dataOffset, const AccessPoint* accessPoint)
+  {
+    if (this->ResetZStream(accessPoint != NULL ? -MAX_WBITS : MAX_WBITS) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to initialize decompression of pixel data");
+      return PLUS_FAIL;
+    }
+    std::streamoff compressedOffset = dataOffset;
+    if (accessPoint != NULL)
+    {
+      compressedOffset += static_cast<std::streamoff>(accessPoint->CompressedOffset) - (accessPoint->Bits > 0 ? 1 : 0);
+    }
+    this->DataFile.clear();
+    this->DataFile.seekg(compressedOffset);
+    if (!this->DataFile.good())
+    {
+      LOG_ERROR("Failed to seek to the compressed pixel data at position " << compressedOffset);
+      return PLUS_FAIL;
+    }
+    if (accessPoint != NULL)
+    {
+      if (accessPoint->Bits > 0)
+      {
+        int partialByte = this->DataFile.get();
+        if (partialByte == std::char_traits<char>::eof()
+            || inflatePrime(&this->ZStream, accessPoint->Bits, partialByte >> (8 - accessPoint->Bits)) != Z_OK)
+        {
+          LOG_ERROR("Failed to restore decompression state at position " << compressedOffset);
+          return PLUS_FAIL;
+        }
+      }
+      if (inflateSetDictionary(&this->ZStream, &accessPoint->Window[0], static_cast<uInt>(accessPoint->Window.size())) != Z_OK)
+      {
+        LOG_ERROR("Failed to restore decompression window at position " << compressedOffset);
+        return PLUS_FAIL;
+      }
+    }
+    this->PixelDataPosition = (accessPoint != NULL ? accessPoint->UncompressedOffset : 0);
+    return PLUS_SUCCESS;
+  }
+
+  /*! Returns the last access point before the position or NULL if there is none */
+  const AccessPoint* FindAccessPoint(vtkTypeUInt64 position) const
+  {
+    const AccessPoint* found = NULL;
+    for (std::vector<AccessPoint>::const_iterator it = this->AccessPoints.begin(); it != this->AccessPoints.end() && it->UncompressedOffset <= position; ++it)
+    {
+      found = &(*it);
+    }
+    return found;
+  }
+
+  std::ifstream DataFile;
+  z_stream ZStream;
+  bool ZStreamInitialized;
+  std::vector<unsigned char> CompressedBuffer;
+
+  /*! Position of the next ReadPixelData call in the uncompressed pixel data */
+  vtkTypeUInt64 PixelDataPosition;
+
+  /*! Access points of compressed pixel data, ordered by position */
+  std::vector<AccessPoint> AccessPoints;
+  bool FrameIndexFileChecked;
+  bool FrameIndexBuildFailed;
+
+  /*! Pixel data of the cached frames, the most recently used first */
+  FrameCacheType FrameCache;
+  std::map<int, FrameCacheType::iterator> FrameCacheIterators;
+};
+
+//----------------------------------------------------------------------------
+vtkPlusSequenceStreamReader::vtkPlusSequenceStreamReader()
+  : NextFrameIndex(0)
+  , FrameCacheSize(4)
+  , UseFrameIndexFile(true)
+  , PixelType(VTK_UNSIGNED_CHAR)
+  , NumberOfScalarComponents(1)
+  , ImageType(US_IMG_BRIGHTNESS)
+  , ImageOrientationInFile(US_IMG_ORIENT_MF)
+  , CompressedData(false)
+  , DataOffset(0)
+  , Internal(new vtkInternal)
+{
+  this->FrameSizeInFile[0] = 0;
+  this->FrameSizeInFile[1] = 0;
+  this->FrameSizeInFile[2] = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusSequenceStreamReader::~vtkPlusSequenceStreamReader()
+{
+  delete this->Internal;
+  this->Internal = NULL;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusSequenceStreamReader::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfFrames: " << this->GetNumberOfFrames() << std::endl;
+  os << indent << "NextFrameIndex: " << this->NextFrameIndex << std::endl;
+  os << indent << "FrameCacheSize: " << this->FrameCacheSize << std::endl;
+  os << indent << "UseFrameIndexFile: " << (this->UseFrameIndexFile ? "TRUE" : "FALSE") << std::endl;
+  os << indent << "FrameSizeInFile: " << this->FrameSizeInFile[0] << " " << this->FrameSizeInFile[1] << " " << this->FrameSizeInFile[2] << std::endl;
+  os << indent << "PixelType: " << vtkImageScalarTypeNameMacro(this->PixelType) << std::endl;
+  os << indent << "NumberOfScalarComponents: " << this->NumberOfScalarComponents << std::endl;
+  os << indent << "ImageType: " << igsioCommon::GetStringFromUsImageType(this->ImageType) << std::endl;
+  os << indent << "ImageOrientationInFile: " << igsioCommon::GetStringFromUsImageOrientation(this->ImageOrientationInFile) << std::endl;
+  os << indent << "CompressedData: " << (this->CompressedData ? "TRUE" : "FALSE") << std::endl;
+  os << indent << "DataFilePath: " << this->DataFilePath << std::endl;
+  os << indent << "DataOffset: " << this->DataOffset << std::endl;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusSequenceStreamReader::CanReadFile(const std::string& filename)
+{
+  std::string extension = vtksys::SystemTools::LowerCase(vtksys::SystemTools::GetFilenameLastExtension(filename));
+  return extension == ".mha" || extension == ".mhd";
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceStreamReader::Open(const std::string& filename)
+{
+  this->Close();
+
+  std::string filePath = filename;
+  // If file is not found in the current directory then try to find it in the image directory, too
+  if (!vtksys::SystemTools::FileExists(filePath.c_str(), true))
+  {
+    if (vtkPlusConfig::GetInstance()->FindImagePath(filename, filePath) == PLUS_FAIL)
+    {
+      LOG_ERROR("Cannot find sequence metafile: " << filename);
+      return PLUS_FAIL;
+    }
+  }
+
+  if (this->ReadHeader(filePath) != PLUS_SUCCESS)
+  {
+    this->Close();
+    return PLUS_FAIL;
+  }
+
+  if (this->CompressedData)
+  {
+    if (this->Internal->ResetZStream(MAX_WBITS) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to initialize decompression of sequence metafile: " << filePath);
+      this->Close();
+      return PLUS_FAIL;
+    }
+    this->Internal->CompressedBuffer.resize(COMPRESSED_READ_BLOCK_SIZE_BYTES);
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusSequenceStreamReader::Close()
+{
+  this->Internal->Close();
+  this->FrameFields.clear();
+  this->CustomFields.clear();
+  this->DataFilePath.clear();
+  this->DataOffset = 0;
+  this->NextFrameIndex = 0;
+  this->FramePixelBuffer.clear();
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusSequenceStreamReader::GetNumberOfFrames() const
+{
+  return static_cast<int>(this->FrameFields.size());
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusSequenceStreamReader::GetNumberOfAccessPoints() const
+{
+  return static_cast<int>(this->Internal->AccessPoints.size());
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusSequenceStreamReader::GetFrameSize(FrameSizeType& frameSize) const
+{
+  frameSize = this->FrameSizeInFile;
+  igsioVideoFrame::FlipInfoType flipInfo;
+  if (igsioVideoFrame::GetFlipAxes(this->ImageOrientationInFile, this->ImageType, US_IMG_ORIENT_MF, flipInfo) == PLUS_SUCCESS
+      && flipInfo.tranpose == igsioVideoFrame::TRANSPOSE_IJKtoKIJ)
+  {
+    frameSize[0] = this->FrameSizeInFile[2];
+    frameSize[1] = this->FrameSizeInFile[0];
+    frameSize[2] = this->FrameSizeInFile[1];
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceStreamReader::ReadHeader(const std::string& filePath)
+{
+  std::ifstream headerFile(filePath.c_str(), std::ios::in | std::ios::binary);
+  if (!headerFile.is_open())
+  {
+    LOG_ERROR("Failed to open sequence metafile: " << filePath);
+    return PLUS_FAIL;
+  }
+
+  int numberOfDimensions = 3;
+  std::vector<unsigned int> dimSize;
+  std::string elementDataFile;
+  std::streamoff dataOffset = 0;
+  bool byteOrderMsb = false;
+  this->PixelType = VTK_UNSIGNED_CHAR;
+  this->NumberOfScalarComponents = 1;
+  this->ImageType = US_IMG_BRIGHTNESS;
+  this->ImageOrientationInFile = US_IMG_ORIENT_MF;
+  this->CompressedData = false;
+
+  std::string line;
+  while (std::getline(headerFile, line))
+  {
+    size_t equalSignPos = line.find('=');
+    if (equalSignPos == std::string::npos)
+    {
+      continue;
+    }
+    std::string name = TrimWhitespace(line.substr(0, equalSignPos));
+    std::string value = TrimWhitespace(line.substr(equalSignPos + 1));
+
+    bool frameField = (name.compare(0, SEQUENCE_FIELD_FRAME_PREFIX.size(), SEQUENCE_FIELD_FRAME_PREFIX) == 0);
+    if (!frameField && name != "ElementDataFile")
+    {
+      // Provided as custom fields of the frame list by ReadAllFramesMemoryMapped
+      this->CustomFields[name] = value;
+    }
+
+    if (frameField)
+    {
+      // Seq_Frame0000_FieldName = value
+      size_t separatorPos = name.find('_', SEQUENCE_FIELD_FRAME_PREFIX.size());
+      if (separatorPos == std::string::npos)
+      {
+        LOG_WARNING("Invalid frame field name in sequence metafile: " << name);
+        continue;
+      }
+      int frameIndex = atoi(name.substr(SEQUENCE_FIELD_FRAME_PREFIX.size(), separatorPos - SEQUENCE_FIELD_FRAME_PREFIX.size()).c_str());
+      if (frameIndex < 0)
+      {
+        LOG_WARNING("Invalid frame index in sequence metafile field name: " << name);
+        continue;
+      }
+      if (frameIndex >= static_cast<int>(this->FrameFields.size()))
+      {
+        this->FrameFields.resize(frameIndex + 1);
+      }
+      this->FrameFields[frameIndex][name.substr(separatorPos + 1)] = value;
+    }
+    else if (name == "NDims")
+    {
+      numberOfDimensions = atoi(value.c_str());
+    }
+    else if (name == "DimSize")
+    {
+      std::istringstream dimSizeStream(value);
+      unsigned int size = 0;
+      while (dimSizeStream >> size)
+      {
+        dimSize.push_back(size);
+      }
+    }
+    else if (name == "ElementType")
+    {
+      if (GetPixelTypeFromMetaElementType(value, this->PixelType) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Unsupported element type in sequence metafile: " << value);
+        return PLUS_FAIL;
+      }
+    }
+    else if (name == "ElementNumberOfChannels")
+    {
+      this->NumberOfScalarComponents = std::max(atoi(value.c_str()), 1);
+    }
+    else if (name == "CompressedData")
+    {
+      this->CompressedData = STRCASECMP(value.c_str(), "TRUE") == 0;
+    }
+    else if (name == "BinaryDataByteOrderMSB")
+    {
+      byteOrderMsb = STRCASECMP(value.c_str(), "TRUE") == 0;
+    }
+    else if (name == "UltrasoundImageOrientation")
+    {
+      this->ImageOrientationInFile = igsioCommon::GetUsImageOrientationFromString(value.c_str());
+    }
+    else if (name == "UltrasoundImageType")
+    {
+      this->ImageType = igsioCommon::GetUsImageTypeFromString(value.c_str());
+    }
+    else if (name == "ElementDataFile")
+    {
+      // Pixel data starts after the last field of the header
+      elementDataFile = value;
+      dataOffset = headerFile.tellg();
+      break;
+    }
+  }
+  headerFile.close();
+
+  if (elementDataFile.empty())
+  {
+    LOG_ERROR("ElementDataFile field is not found in sequence metafile: " << filePath);
+    return PLUS_FAIL;
+  }
+  if (numberOfDimensions != 3 && numberOfDimensions != 4)
+  {
+    LOG_ERROR("Unsupported number of dimensions in sequence metafile: " << numberOfDimensions);
+    return PLUS_FAIL;
+  }
+  if (static_cast<int>(dimSize.size()) != numberOfDimensions)
+  {
+    LOG_ERROR("DimSize does not match NDims in sequence metafile: " << filePath);
+    return PLUS_FAIL;
+  }
+  if (byteOrderMsb && igsioVideoFrame::GetNumberOfBytesPerScalar(this->PixelType) > 1)
+  {
+    LOG_ERROR("Big endian pixel data is not supported by the sequence stream reader: " << filePath);
+    return PLUS_FAIL;
+  }
+  if (this->ImageOrientationInFile == US_IMG_ORIENT_XX)
+  {
+    LOG_ERROR("Unknown ultrasound image orientation in sequence metafile: " << filePath);
+    return PLUS_FAIL;
+  }
+
+  this->FrameSizeInFile[0] = dimSize[0];
+  this->FrameSizeInFile[1] = dimSize[1];
+  this->FrameSizeInFile[2] = (numberOfDimensions == 4 ? dimSize[2] : 1);
+  int numberOfFrames = static_cast<int>(dimSize[numberOfDimensions - 1]);
+  if (static_cast<int>(this->FrameFields.size()) > numberOfFrames)
+  {
+    LOG_WARNING("Sequence metafile contains fields of " << this->FrameFields.size() << " frames, but image data of only " << numberOfFrames << " frames: " << filePath);
+  }
+  this->FrameFields.resize(numberOfFrames);
+
+  // Local or a single external pixel data file
+  std::string dataFilePath = filePath;
+  if (elementDataFile != "LOCAL")
+  {
+    if (elementDataFile.compare(0, 4, "LIST") == 0 || elementDataFile.find('%') != std::string::npos)
+    {
+      LOG_ERROR("Pixel data split into multiple files is not supported by the sequence stream reader: " << filePath);
+      return PLUS_FAIL;
+    }
+    dataFilePath = elementDataFile;
+    if (!vtksys::SystemTools::FileIsFullPath(dataFilePath))
+    {
+      dataFilePath = vtksys::SystemTools::GetFilenamePath(filePath) + "/" + elementDataFile;
+    }
+    dataOffset = 0;
+  }
+  this->DataFilePath = dataFilePath;
+  this->DataOffset = dataOffset;
+  this->Internal->DataFile.open(dataFilePath.c_str(), std::ios::in | std::ios::binary);
+  if (!this->Internal->DataFile.is_open())
+  {
+    LOG_ERROR("Failed to open pixel data file of sequence metafile: " << dataFilePath);
+    return PLUS_FAIL;
+  }
+  this->Internal->DataFile.seekg(dataOffset);
+  if (!this->Internal->DataFile.good())
+  {
+    LOG_ERROR("Failed to seek to the pixel data in file: " << dataFilePath);
+    return PLUS_FAIL;
+  }
+
+  LOG_DEBUG("Sequence metafile opened for streaming: " << filePath << " (" << numberOfFrames << " frames of "
+            << this->FrameSizeInFile[0] << "x" << this->FrameSizeInFile[1] << "x" << this->FrameSizeInFile[2] << " pixels)");
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceStreamReader::ReadPixelData(unsigned char* buffer, size_t numberOfBytes)
+{
+  std::ifstream& dataFile = this->Internal->DataFile;
+  if (!this->CompressedData)
+  {
+    dataFile.read(reinterpret_cast<char*>(buffer), numberOfBytes);
+    if (static_cast<size_t>(dataFile.gcount()) != numberOfBytes)
+    {
+      LOG_ERROR("Unexpected end of pixel data in sequence metafile");
+      return PLUS_FAIL;
+    }
+    this->Internal->PixelDataPosition += numberOfBytes;
+    return PLUS_SUCCESS;
+  }
+
+  // Pixel data of all frames is compressed into one stream, which is decompressed frame by frame
+  z_stream& zStream = this->Internal->ZStream;
+  zStream.next_out = buffer;
+  zStream.avail_out = static_cast<uInt>(numberOfBytes);
+  while (zStream.avail_out > 0)
+  {
+    if (zStream.avail_in == 0)
+    {
+      std::vector<unsigned char>& compressedBuffer = this->Internal->CompressedBuffer;
+      dataFile.read(reinterpret_cast<char*>(&compressedBuffer[0]), compressedBuffer.size());
+      if (dataFile.gcount() <= 0)
+      {
+        LOG_ERROR("Unexpected end of compressed pixel data in sequence metafile");
+        return PLUS_FAIL;
+      }
+      zStream.next_in = &compressedBuffer[0];
+      zStream.avail_in = static_cast<uInt>(dataFile.gcount());
+    }
+    int result = inflate(&zStream, Z_NO_FLUSH);
+    if (result == Z_STREAM_END && zStream.avail_out > 0)
+    {
+      LOG_ERROR("Compressed pixel data in sequence metafile ended before the last frame");
+      return PLUS_FAIL;
+    }
+    if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+    {
+      LOG_ERROR("Failed to decompress pixel data in sequence metafile (zlib error " << result << ")");
+      return PLUS_FAIL;
+    }
+  }
+  this->Internal->PixelDataPosition += numberOfBytes;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceStreamReader::GetFrameFields(int frameIndex, igsioTrackedFrame& frame) const
+{
+  if (frameIndex < 0 || frameIndex >= this->GetNumberOfFrames())
+  {
+    LOG_ERROR("vtkPlusSequenceStreamReader::GetFrameFields: invalid frame index " << frameIndex);
+    return PLUS_FAIL;
+  }
+  const std::map<std::string, std::string>& fields = this->FrameFields[frameIndex];
+  for (std::map<std::string, std::string>::const_iterator fieldIt = fields.begin(); fieldIt != fields.end(); ++fieldIt)
+  {
+    frame.SetFrameField(fieldIt->first, fieldIt->second);
+    if (fieldIt->first == "Timestamp")
+    {
+      frame.SetTimestamp(atof(fieldIt->second.c_str()));
+    }
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+size_t vtkPlusSequenceStreamReader::GetFrameSizeInBytes() const
+{
+  return static_cast<size_t>(this->FrameSizeInFile[0]) * this->FrameSizeInFile[1] * this->FrameSizeInFile[2]
+         * this->NumberOfScalarComponents * igsioVideoFrame::GetNumberOfBytesPerScalar(this->PixelType);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceStreamReader::SeekPixelData(vtkTypeUInt64 position)
+{
+  vtkInternal* internal = this->Internal;
+  if (position == internal->PixelDataPosition)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  if (!this->CompressedData)
+  {
+    internal->DataFile.clear();
+    internal->DataFile.seekg(this->DataOffset + static_cast<std::streamoff>(position));
+    if (!internal->DataFile.good())
+    {
+      LOG_ERROR("Failed to seek to position " << position << " of the pixel data in file: " << this->DataFilePath);
+      return PLUS_FAIL;
+    }
+    internal->PixelDataPosition = position;
+    return PLUS_SUCCESS;
+  }
+
+  // Compressed data can only be decompressed forward, from the beginning or from an access point
+  if (!internal->FrameIndexFileChecked)
+  {
+    internal->FrameIndexFileChecked = true;
+    if (this->UseFrameIndexFile)
+    {
+      this->ReadFrameIndexFile();
+    }
+  }
+  const bool seekBackward = (position < internal->PixelDataPosition);
+  if (seekBackward && internal->AccessPoints.empty() && !internal->FrameIndexBuildFailed)
+  {
+    if (this->BuildFrameIndex() == PLUS_SUCCESS)
+    {
+      if (this->UseFrameIndexFile)
+      {
+        // the index is only a cache, the frames can be read without it
+        this->WriteFrameIndexFile();
+      }
+    }
+    else
+    {
+      internal->FrameIndexBuildFailed = true;
+    }
+  }
+
+  const vtkInternal::AccessPoint* accessPoint = internal->FindAccessPoint(position);
+  if (accessPoint != NULL && (seekBackward || accessPoint->UncompressedOffset > internal->PixelDataPosition))
+  {
+    if (internal->StartDecompression(this->DataOffset, accessPoint) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+  }
+  else if (seekBackward)
+  {
+    if (internal->StartDecompression(this->DataOffset, NULL) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+  }
+
+  // Decompress and discard the pixel data until the requested position
+  std::vector<unsigned char> skippedData(static_cast<size_t>(std::min<vtkTypeUInt64>(position - internal->PixelDataPosition, COMPRESSED_READ_BLOCK_SIZE_BYTES)));
+  while (internal->PixelDataPosition < position)
+  {
+    size_t numberOfBytes = static_cast<size_t>(std::min<vtkTypeUInt64>(position - internal->PixelDataPosition, skippedData.size()));
+    if (this->ReadPixelData(&skippedData[0], numberOfBytes) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceStreamReader::BuildFrameIndex()
+{
+  LOG_DEBUG("Building frame index of compressed pixel data: " << this->DataFilePath);
+  std::ifstream dataFile(this->DataFilePath.c_str(), std::ios::in | std::ios::binary);
+  dataFile.seekg(this->DataOffset);
+  if (!dataFile.good())
+  {
+    LOG_ERROR("Failed to open the pixel data for building the frame index: " << this->DataFilePath);
+    return PLUS_FAIL;
+  }
+
+  z_stream zStream;
+  memset(&zStream, 0, sizeof(zStream));
+  if (inflateInit(&zStream) != Z_OK)
+  {
+    LOG_ERROR("Failed to initialize decompression for building the frame index: " << this->DataFilePath);
+    return PLUS_FAIL;
+  }
+
+  const vtkTypeUInt64 pixelDataSize = static_cast<vtkTypeUInt64>(this->GetFrameSizeInBytes()) * this->GetNumberOfFrames();
+  std::vector<unsigned char> compressedBuffer(COMPRESSED_READ_BLOCK_SIZE_BYTES);
+  // Uncompressed data is written into the window circularly, so it always contains the history that an access point needs
+  std::vector<unsigned char> window(DEFLATE_WINDOW_SIZE_BYTES);
+  std::vector<vtkInternal::AccessPoint> accessPoints;
+  vtkTypeUInt64 totalIn = 0;
+  vtkTypeUInt64 totalOut = 0;
+  vtkTypeUInt64 lastAccessPointOut = 0;
+  int result = Z_OK;
+  zStream.avail_out = 0;
+  while (result != Z_STREAM_END && totalOut < pixelDataSize)
+  {
+    dataFile.read(reinterpret_cast<char*>(&compressedBuffer[0]), compressedBuffer.size());
+    if (dataFile.gcount() <= 0)
+    {
+      LOG_ERROR("Unexpected end of compressed pixel data while building the frame index: " << this->DataFilePath);
+      inflateEnd(&zStream);
+      return PLUS_FAIL;
+    }
+    zStream.next_in = &compressedBuffer[0];
+    zStream.avail_in = static_cast<uInt>(dataFile.gcount());
+    do
+    {
+      if (zStream.avail_out == 0)
+      {
+        zStream.next_out = &window[0];
+        zStream.avail_out = static_cast<uInt>(window.size());
+      }
+      totalIn += zStream.avail_in;
+      totalOut += zStream.avail_out;
+      // Stop at the end of each deflate block
+      result = inflate(&zStream, Z_BLOCK);
+      totalIn -= zStream.avail_in;
+      totalOut -= zStream.avail_out;
+      if (result == Z_NEED_DICT || result == Z_DATA_ERROR || result == Z_MEM_ERROR)
+      {
+        LOG_ERROR("Failed to decompress pixel data while building the frame index (zlib error " << result << "): " << this->DataFilePath);
+        inflateEnd(&zStream);
+        return PLUS_FAIL;
+      }
+      if (result == Z_STREAM_END)
+      {
+        break;
+      }
+      // data_type bit 128 is set at the end of a block, bit 64 if it was the last block
+      if ((zStream.data_type & 128) && !(zStream.data_type & 64) && (totalOut == 0 || totalOut - lastAccessPointOut > ACCESS_POINT_SPAN_BYTES))
+      {
+        accessPoints.push_back(vtkInternal::AccessPoint());
+        vtkInternal::AccessPoint& accessPoint = accessPoints.back();
+        accessPoint.UncompressedOffset = totalOut;
+        accessPoint.CompressedOffset = totalIn;
+        accessPoint.Bits = zStream.data_type & 7;
+        accessPoint.Window.resize(DEFLATE_WINDOW_SIZE_BYTES);
+        // the oldest data is after the current output position
+        size_t oldestDataSize = zStream.avail_out;
+        if (oldestDataSize > 0)
+        {
+          memcpy(&accessPoint.Window[0], &window[window.size() - oldestDataSize], oldestDataSize);
+        }
+        if (oldestDataSize < window.size())
+        {
+          memcpy(&accessPoint.Window[oldestDataSize], &window[0], window.size() - oldestDataSize);
+        }
+        lastAccessPointOut = totalOut;
+      }
+    }
+    while (zStream.avail_in != 0);
+  }
+  inflateEnd(&zStream);
+
+  if (accessPoints.empty())
+  {
+    LOG_ERROR("No access points were found in the compressed pixel data: " << this->DataFilePath);
+    return PLUS_FAIL;
+  }
+  this->Internal->AccessPoints.swap(accessPoints);
+  LOG_DEBUG("Frame index of " << this->Internal->AccessPoints.size() << " access points is built for: " << this->DataFilePath);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusSequenceStreamReader::GetFrameIndexFilePath() const
+{
+  return this->DataFilePath + FRAME_INDEX_FILE_EXTENSION;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceStreamReader::ReadFrameIndexFile()
+{
+  std::string indexFilePath = this->GetFrameIndexFilePath();
+  std::ifstream indexFile(indexFilePath.c_str(), std::ios::in | std::ios::binary);
+  if (!indexFile.is_open())
+  {
+    return PLUS_FAIL;
+  }
+
+  // The index is only valid for the same pixel data file, which is identified by its size and modification time
+  char signature[sizeof(FRAME_INDEX_FILE_SIGNATURE)] = { 0 };
+  indexFile.read(signature, sizeof(signature));
+  vtkTypeUInt32 version = 0;
+  vtkTypeUInt64 dataFileSize = 0;
+  vtkTypeInt64 dataFileModifiedTime = 0;
+  vtkTypeInt64 dataOffset = 0;
+  vtkTypeUInt64 numberOfAccessPoints = 0;
+  if (memcmp(signature, FRAME_INDEX_FILE_SIGNATURE, sizeof(signature)) != 0
+      || !ReadBinaryValue(indexFile, version) || version != FRAME_INDEX_FILE_VERSION
+      || !ReadBinaryValue(indexFile, dataFileSize) || dataFileSize != GetFileSize(this->DataFilePath)
+      || !ReadBinaryValue(indexFile, dataFileModifiedTime) || dataFileModifiedTime != static_cast<vtkTypeInt64>(vtksys::SystemTools::ModifiedTime(this->DataFilePath))
+      || !ReadBinaryValue(indexFile, dataOffset) || dataOffset != static_cast<vtkTypeInt64>(this->DataOffset)
+      || !ReadBinaryValue(indexFile, numberOfAccessPoints) || numberOfAccessPoints == 0 || numberOfAccessPoints > dataFileSize)
+  {
+    LOG_DEBUG("Frame index file is ignored, it does not match the pixel data: " << indexFilePath);
+    return PLUS_FAIL;
+  }
+
+  std::vector<vtkInternal::AccessPoint> accessPoints(static_cast<size_t>(numberOfAccessPoints));
+  for (std::vector<vtkInternal::AccessPoint>::iterator accessPointIt = accessPoints.begin(); accessPointIt != accessPoints.end(); ++accessPointIt)
+  {
+    vtkTypeInt32 bits = 0;
+    accessPointIt->Window.resize(DEFLATE_WINDOW_SIZE_BYTES);
+    if (!ReadBinaryValue(indexFile, accessPointIt->UncompressedOffset) || !ReadBinaryValue(indexFile, accessPointIt->CompressedOffset)
+        || !ReadBinaryValue(indexFile, bits) || bits < 0 || bits > 7)
+    {
+      LOG_DEBUG("Frame index file is ignored, it is truncated: " << indexFilePath);
+      return PLUS_FAIL;
+    }
+    accessPointIt->Bits = bits;
+    indexFile.read(reinterpret_cast<char*>(&accessPointIt->Window[0]), accessPointIt->Window.size());
+    if (indexFile.gcount() != static_cast<std::streamsize>(accessPointIt->Window.size()))
+    {
+      LOG_DEBUG("Frame index file is ignored, it is truncated: " << indexFilePath);
+      return PLUS_FAIL;
+    }
+  }
+
+  this->Internal->AccessPoints.swap(accessPoints);
+  LOG_DEBUG("Frame index of " << this->Internal->AccessPoints.size() << " access points is loaded from: " << indexFilePath);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceStreamReader::WriteFrameIndexFile()
+{
+  std::string indexFilePath = this->GetFrameIndexFilePath();
+  std::ofstream indexFile(indexFilePath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!indexFile.is_open())
+  {
+    // the directory may be read-only, the index is built again next time
+    LOG_DEBUG("Failed to write frame index file: " << indexFilePath);
+    return PLUS_FAIL;
+  }
+
+  const std::vector<vtkInternal::AccessPoint>& accessPoints = this->Internal->AccessPoints;
+  indexFile.write(FRAME_INDEX_FILE_SIGNATURE, sizeof(FRAME_INDEX_FILE_SIGNATURE));
+  WriteBinaryValue(indexFile, FRAME_INDEX_FILE_VERSION);
+  WriteBinaryValue(indexFile, GetFileSize(this->DataFilePath));
+  WriteBinaryValue(indexFile, static_cast<vtkTypeInt64>(vtksys::SystemTools::ModifiedTime(this->DataFilePath)));
+  WriteBinaryValue(indexFile, static_cast<vtkTypeInt64>(this->DataOffset));
+  WriteBinaryValue(indexFile, static_cast<vtkTypeUInt64>(accessPoints.size()));
+  for (std::vector<vtkInternal::AccessPoint>::const_iterator accessPointIt = accessPoints.begin(); accessPointIt != accessPoints.end(); ++accessPointIt)
+  {
+    WriteBinaryValue(indexFile, accessPointIt->UncompressedOffset);
+    WriteBinaryValue(indexFile, accessPointIt->CompressedOffset);
+    WriteBinaryValue(indexFile, static_cast<vtkTypeInt32>(accessPointIt->Bits));
+    indexFile.write(reinterpret_cast<const char*>(&accessPointIt->Window[0]), accessPointIt->Window.size());
+  }
+  indexFile.close();
+  if (indexFile.fail())
+  {
+    LOG_DEBUG("Failed to write frame index file: " << indexFilePath);
+    vtksys::SystemTools::RemoveFile(indexFilePath);
+    return PLUS_FAIL;
+  }
+  LOG_DEBUG("Frame index file is written: " << indexFilePath);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceStreamReader::ReadNextFrame(igsioTrackedFrame& frame)
+{
+  if (this->NextFrameIndex >= this->GetNumberOfFrames())
+  {
+    LOG_ERROR("vtkPlusSequenceStreamReader::ReadNextFrame: all the " << this->GetNumberOfFrames() << " frames have been read");
+    return PLUS_FAIL;
+  }
+  return this->ReadFrame(this->NextFrameIndex, frame);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceStreamReader::ReadFrame(int frameIndex, igsioTrackedFrame& frame)
+{
+  if (!this->Internal->DataFile.is_open())
+  {
+    LOG_ERROR("vtkPlusSequenceStreamReader::ReadFrame: file is not open");
+    return PLUS_FAIL;
+  }
+  if (frameIndex < 0 || frameIndex >= this->GetNumberOfFrames())
+  {
+    LOG_ERROR("vtkPlusSequenceStreamReader::ReadFrame: invalid frame index " << frameIndex);
+    return PLUS_FAIL;
+  }
+  const size_t frameSizeInBytes = this->GetFrameSizeInBytes();
+  if (frameSizeInBytes == 0)
+  {
+    LOG_ERROR("vtkPlusSequenceStreamReader::ReadFrame: frames of the sequence are empty");
+    return PLUS_FAIL;
+  }
+
+  vtkInternal::FrameCacheType& frameCache = this->Internal->FrameCache;
+  std::map<int, vtkInternal::FrameCacheType::iterator>& frameCacheIterators = this->Internal->FrameCacheIterators;
+  const unsigned char* pixelData = NULL;
+  std::map<int, vtkInternal::FrameCacheType::iterator>::iterator cachedFrameIt = frameCacheIterators.find(frameIndex);
+  if (cachedFrameIt != frameCacheIterators.end())
+  {
+    // Most recently used frame is moved to the front
+    frameCache.splice(frameCache.begin(), frameCache, cachedFrameIt->second);
+    pixelData = &frameCache.front().second[0];
+  }
+  else
+  {
+    std::vector<unsigned char>* pixelBuffer = &this->FramePixelBuffer;
+    if (this->FrameCacheSize > 0)
+    {
+      // Reuse the buffer of the least recently used frame
+      std::vector<unsigned char> buffer;
+      while (static_cast<int>(frameCache.size()) >= this->FrameCacheSize)
+      {
+        buffer.swap(frameCache.back().second);
+        frameCacheIterators.erase(frameCache.back().first);
+        frameCache.pop_back();
+      }
+      frameCache.push_front(std::make_pair(frameIndex, std::vector<unsigned char>()));
+      frameCache.front().second.swap(buffer);
+      pixelBuffer = &frameCache.front().second;
+    }
+    pixelBuffer->resize(frameSizeInBytes);
+    if (this->SeekPixelData(static_cast<vtkTypeUInt64>(frameIndex) * frameSizeInBytes) != PLUS_SUCCESS
+        || this->ReadPixelData(&(*pixelBuffer)[0], frameSizeInBytes) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to read pixel data of frame #" << frameIndex);
+      if (this->FrameCacheSize > 0)
+      {
+        frameCache.pop_front();
+      }
+      return PLUS_FAIL;
+    }
+    if (this->FrameCacheSize > 0)
+    {
+      frameCacheIterators[frameIndex] = frameCache.begin();
+    }
+    pixelData = &(*pixelBuffer)[0];
+  }
+  this->NextFrameIndex = frameIndex + 1;
+
+  if (this->GetFrameFields(frameIndex, frame) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  return this->SetFrameImage(frameIndex, pixelData, frame);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceStreamReader::SetFrameImage(int frameIndex, const unsigned char* pixelData, igsioTrackedFrame& frame)
+{
+  igsioVideoFrame::FlipInfoType flipInfo;
+  if (igsioVideoFrame::GetFlipAxes(this->ImageOrientationInFile, this->ImageType, US_IMG_ORIENT_MF, flipInfo) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to convert image data to MF orientation from " << igsioCommon::GetStringFromUsImageOrientation(this->ImageOrientationInFile));
+    return PLUS_FAIL;
+  }
+  FrameSizeType frameSize = { 0, 0, 0 };
+  this->GetFrameSize(frameSize);
+  igsioVideoFrame* videoFrame = frame.GetImageData();
+  // AllocateFrame keeps the pixels if the size does not change, they may be shared with frames of other consumers
+  PlusCommon::DetachFrameImage(*videoFrame);
+  if (videoFrame->AllocateFrame(frameSize, this->PixelType, this->NumberOfScalarComponents) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to allocate image of frame #" << frameIndex);
+    return PLUS_FAIL;
+  }
+  std::array<int, 3> clipRectangleOrigin = { igsioCommon::NO_CLIP, igsioCommon::NO_CLIP, igsioCommon::NO_CLIP };
+  std::array<int, 3> clipRectangleSize = { igsioCommon::NO_CLIP, igsioCommon::NO_CLIP, igsioCommon::NO_CLIP };
+  if (igsioVideoFrame::GetOrientedClippedImage(const_cast<unsigned char*>(pixelData), flipInfo, this->ImageType, this->PixelType, this->NumberOfScalarComponents,
+      this->FrameSizeInFile, *videoFrame, clipRectangleOrigin, clipRectangleSize) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to convert image of frame #" << frameIndex << " to MF orientation");
+    return PLUS_FAIL;
+  }
+  videoFrame->SetImageOrientation(US_IMG_ORIENT_MF);
+  videoFrame->SetImageType(this->ImageType);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusSequenceStreamReader::IsFrameImageValid(int frameIndex) const
+{
+  const std::map<std::string, std::string>& fields = this->FrameFields[frameIndex];
+  std::map<std::string, std::string>::const_iterator imageStatusIt = fields.find("ImageStatus");
+  return imageStatusIt == fields.end() || imageStatusIt->second == "OK";
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusSequenceStreamReader::SetCustomFields(vtkIGSIOTrackedFrameList* frameList) const
+{
+  for (std::map<std::string, std::string>::const_iterator fieldIt = this->CustomFields.begin(); fieldIt != this->CustomFields.end(); ++fieldIt)
+  {
+    frameList->SetCustomString(fieldIt->first.c_str(), fieldIt->second.c_str());
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceStreamReader::ReadFrames(vtkIGSIOTrackedFrameList* frameList, const std::vector<int>& frameIndices, bool readImageData)
+{
+  if (frameList == NULL)
+  {
+    LOG_ERROR("vtkPlusSequenceStreamReader::ReadFrames: invalid frame list");
+    return PLUS_FAIL;
+  }
+
+  this->SetCustomFields(frameList);
+  for (std::vector<int>::const_iterator frameIndexIt = frameIndices.begin(); frameIndexIt != frameIndices.end(); ++frameIndexIt)
+  {
+    igsioTrackedFrame trackedFrame;
+    if (this->GetFrameFields(*frameIndexIt, trackedFrame) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    // the frame is added without an image, so it is not copied, the image is read into the added frame
+    frameList->AddTrackedFrame(&trackedFrame);
+    igsioTrackedFrame* addedFrame = frameList->GetTrackedFrame(frameList->GetNumberOfTrackedFrames() - 1);
+    if (!readImageData || !this->IsFrameImageValid(*frameIndexIt))
+    {
+      addedFrame->GetImageData()->SetImageOrientation(US_IMG_ORIENT_MF);
+      addedFrame->GetImageData()->SetImageType(this->ImageType);
+      continue;
+    }
+    if (this->ReadFrame(*frameIndexIt, *addedFrame) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusSequenceStreamReader::CanReadAllFramesMemoryMapped() const
+{
+  if (this->DataFilePath.empty() || this->CompressedData)
+  {
+    return false;
+  }
+  igsioVideoFrame::FlipInfoType flipInfo;
+  if (igsioVideoFrame::GetFlipAxes(this->ImageOrientationInFile, this->ImageType, US_IMG_ORIENT_MF, flipInfo) != PLUS_SUCCESS
+      || flipInfo.hFlip || flipInfo.vFlip || flipInfo.eFlip || flipInfo.tranpose != igsioVideoFrame::TRANSPOSE_NONE)
+  {
+    // the images would have to be reoriented, which requires a copy
+    return false;
+  }
+  // the mapping starts at a page boundary, so the pixels are aligned if their offset in the file is a multiple of the scalar size
+  return this->DataOffset % igsioVideoFrame::GetNumberOfBytesPerScalar(this->PixelType) == 0;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceStreamReader::ReadAllFramesMemoryMapped(vtkIGSIOTrackedFrameList* frameList)
+{
+  if (frameList == NULL)
+  {
+    LOG_ERROR("vtkPlusSequenceStreamReader::ReadAllFramesMemoryMapped: invalid frame list");
+    return PLUS_FAIL;
+  }
+  if (!this->CanReadAllFramesMemoryMapped())
+  {
+    LOG_ERROR("vtkPlusSequenceStreamReader::ReadAllFramesMemoryMapped: frames of the sequence cannot be memory mapped (compressed or not in MF orientation): " << this->DataFilePath);
+    return PLUS_FAIL;
+  }
+
+  vtkSmartPointer<vtkPlusMemoryMappedFile> mappedFile = vtkSmartPointer<vtkPlusMemoryMappedFile>::New();
+  if (mappedFile->Open(this->DataFilePath) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  const vtkIdType numberOfPixels = static_cast<vtkIdType>(this->FrameSizeInFile[0]) * this->FrameSizeInFile[1] * this->FrameSizeInFile[2];
+  const size_t frameSizeInBytes = static_cast<size_t>(numberOfPixels) * this->NumberOfScalarComponents * igsioVideoFrame::GetNumberOfBytesPerScalar(this->PixelType);
+  const size_t dataOffset = static_cast<size_t>(this->DataOffset);
+  if (frameSizeInBytes == 0 || mappedFile->GetSize() < dataOffset + frameSizeInBytes * this->GetNumberOfFrames())
+  {
+    LOG_ERROR("Pixel data of the " << this->GetNumberOfFrames() << " frames is missing from the sequence metafile: " << this->DataFilePath);
+    return PLUS_FAIL;
+  }
+
+  this->SetCustomFields(frameList);
+
+  const FrameSizeType minimalFrameSize = { 1, 1, 1 };
+  for (int frameIndex = 0; frameIndex < this->GetNumberOfFrames(); frameIndex++)
+  {
+    igsioTrackedFrame trackedFrame;
+    if (this->GetFrameFields(frameIndex, trackedFrame) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    // the frame is added without an image, so it is not copied
+    frameList->AddTrackedFrame(&trackedFrame);
+    if (!this->IsFrameImageValid(frameIndex))
+    {
+      continue;
+    }
+
+    igsioVideoFrame* videoFrame = frameList->GetTrackedFrame(frameList->GetNumberOfTrackedFrames() - 1)->GetImageData();
+    // Allocate a minimal image, its pixels are replaced by the mapped pixels
+    if (videoFrame->AllocateFrame(minimalFrameSize, this->PixelType, this->NumberOfScalarComponents) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to allocate image of frame #" << frameIndex);
+      return PLUS_FAIL;
+    }
+    vtkSmartPointer<vtkDataArray> scalars = vtkSmartPointer<vtkDataArray>::Take(
+        mappedFile->CreateDataArray(dataOffset + frameIndex * frameSizeInBytes, this->PixelType, this->NumberOfScalarComponents, numberOfPixels));
+    if (scalars == NULL)
+    {
+      LOG_ERROR("Failed to map pixel data of frame #" << frameIndex);
+      return PLUS_FAIL;
+    }
+    vtkImageData* image = videoFrame->GetImage();
+    image->SetExtent(0, this->FrameSizeInFile[0] - 1, 0, this->FrameSizeInFile[1] - 1, 0, this->FrameSizeInFile[2] - 1);
+    image->GetPointData()->SetScalars(scalars);
+    videoFrame->SetImageOrientation(US_IMG_ORIENT_MF);
+    videoFrame->SetImageType(this->ImageType);
+  }
+
+  LOG_DEBUG("Memory mapped " << this->GetNumberOfFrames() << " frames of sequence metafile: " << this->DataFilePath);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceStreamReader::CopyPixelData(std::ostream& output, vtkTypeUInt64& numberOfBytesCopied) const
+{
+  numberOfBytesCopied = 0;
+  if (this->DataFilePath.empty())
+  {
+    LOG_ERROR("vtkPlusSequenceStreamReader::CopyPixelData: the sequence is not open");
+    return PLUS_FAIL;
+  }
+
+  // Uncompressed pixel data has a known size, compressed pixel data extends to the end of the file if its size is not specified
+  vtkTypeUInt64 numberOfBytesToCopy = static_cast<vtkTypeUInt64>(this->GetFrameSizeInBytes()) * this->GetNumberOfFrames();
+  if (this->CompressedData)
+  {
+    numberOfBytesToCopy = GetFileSize(this->DataFilePath) - std::min<vtkTypeUInt64>(this->DataOffset, GetFileSize(this->DataFilePath));
+    std::map<std::string, std::string>::const_iterator compressedSizeIt = this->CustomFields.find("CompressedDataSize");
+    if (compressedSizeIt != this->CustomFields.end())
+    {
+      vtkTypeUInt64 compressedDataSize = 0;
+      std::istringstream compressedSizeStream(compressedSizeIt->second);
+      if (compressedSizeStream >> compressedDataSize && compressedDataSize > 0)
+      {
+        numberOfBytesToCopy = std::min(numberOfBytesToCopy, compressedDataSize);
+      }
+    }
+  }
+
+  std::ifstream dataFile(this->DataFilePath.c_str(), std::ios::in | std::ios::binary);
+  if (!dataFile.is_open())
+  {
+    LOG_ERROR("Failed to open pixel data file of sequence metafile: " << this->DataFilePath);
+    return PLUS_FAIL;
+  }
+  dataFile.seekg(this->DataOffset);
+  std::vector<char> block(COMPRESSED_READ_BLOCK_SIZE_BYTES);
+  while (numberOfBytesCopied < numberOfBytesToCopy)
+  {
+    std::streamsize blockSize = static_cast<std::streamsize>(std::min<vtkTypeUInt64>(block.size(), numberOfBytesToCopy - numberOfBytesCopied));
+    dataFile.read(&block[0], blockSize);
+    if (dataFile.gcount() != blockSize)
+    {
+      LOG_ERROR("Pixel data in sequence metafile ended before the last frame: " << this->DataFilePath);
+      return PLUS_FAIL;
+    }
+    output.write(&block[0], blockSize);
+    if (!output.good())
+    {
+      LOG_ERROR("vtkPlusSequenceStreamReader::CopyPixelData: failed to write pixel data");
+      return PLUS_FAIL;
+    }
+    numberOfBytesCopied += blockSize;
+  }
+  return PLUS_SUCCESS;
+}
@@ -0,0 +1,199 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusSequenceStreamReader_h
+#define __vtkPlusSequenceStreamReader_h
+
+#include "vtkPlusCommonExport.h"
+#include "vtkObject.h"
+
+#include <igsioCommon.h>
+
+#include <ios>
+#include <map>
+#include <string>
+#include <vector>
+
+class igsioTrackedFrame;
+class vtkIGSIOTrackedFrameList;
+
+/*!
+  \class vtkPlusSequenceStreamReader
+  \brief Reads the frames of a sequence metafile one by one, without loading the whole sequence into memory
+
+  vtkPlusSequenceIO::Read loads all frames of a sequence into a tracked frame list. This class only stores the frame fields
+  of the header (which are needed for computing the volume extent, for example), and reads the pixel data of a frame
+  only when it is requested. Opening the file and getting the frame fields never reads pixel data.
+
+  Frames can be read in any order. Uncompressed pixel data is read directly from the position of the frame. Compressed
+  pixel data of all frames forms a single deflate stream, which is decompressed forward from the nearest access point.
+  Access points (the decompressor state at deflate block boundaries, about every 8MB of pixel data) are only computed
+  when a frame before the current position is requested. They are saved to a frame index file next to the pixel data
+  file (<data file>.frameindex) and loaded from it when the sequence is opened again, if the pixel data file has not changed.
+  The pixel data of the most recently read frames is kept in a cache, so reading the same frames again is fast.
+
+  Supported files are MetaImage sequences (.mha, .mhd) with LOCAL or a single external data file, compressed or uncompressed.
+  Images are converted to MF orientation, as by vtkPlusSequenceIO::Read.
+
+  Uncompressed sequences can also be read into a tracked frame list with memory mapped frame images (see ReadAllFramesMemoryMapped).
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport vtkPlusSequenceStreamReader : public vtkObject
+{
+public:
+  static vtkPlusSequenceStreamReader* New();
+  vtkTypeMacro(vtkPlusSequenceStreamReader, vtkObject);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  /*! Returns true if the file format can be read frame by frame */
+  static bool CanReadFile(const std::string& filename);
+
+  /*!
+    Open the file and read the header, without reading pixel data. If the file is not found in the current directory then
+    it is searched in the image directory, too. The first frame is read by the next ReadNextFrame call.
+  */
+  PlusStatus Open(const std::string& filename);
+
+  /*! Close the file */
+  void Close();
+
+  /*! Number of frames in the sequence */
+  int GetNumberOfFrames() const;
+
+  /*! Index of the frame that the next ReadNextFrame call returns (the frame after the last read frame) */
+  vtkGetMacro(NextFrameIndex, int);
+
+  /*! Number of frames whose pixel data is kept in memory for reading them again. If 0 then no frames are cached. */
+  vtkSetClampMacro(FrameCacheSize, int, 0, VTK_INT_MAX);
+  vtkGetMacro(FrameCacheSize, int);
+
+  /*! If enabled then the access points of compressed pixel data are loaded from and saved to a frame index file */
+  vtkSetMacro(UseFrameIndexFile, bool);
+  vtkGetMacro(UseFrameIndexFile, bool);
+  vtkBooleanMacro(UseFrameIndexFile, bool);
+
+  /*! Number of access points of the compressed pixel data, 0 if they have not been built or loaded from the frame index file */
+  int GetNumberOfAccessPoints() const;
+
+  /*! Size of each frame, in pixels (after conversion to MF orientation) */
+  void GetFrameSize(FrameSizeType& frameSize) const;
+
+  vtkGetMacro(PixelType, igsioCommon::VTKScalarPixelType);
+  vtkGetMacro(NumberOfScalarComponents, unsigned int);
+  vtkGetMacro(ImageType, US_IMAGE_TYPE);
+
+  /*! Orientation, size and compression of the pixel data in the file */
+  vtkGetMacro(ImageOrientationInFile, US_IMAGE_ORIENTATION);
+  void GetFrameSizeInFile(FrameSizeType& frameSize) const { frameSize = this->FrameSizeInFile; }
+  vtkGetMacro(CompressedData, bool);
+
+  /*!
+    Set the frame fields and the timestamp of a frame, without reading pixel data. The image of the frame is not changed.
+    It can be called for any frame, in any order, after the file is opened.
+  */
+  PlusStatus GetFrameFields(int frameIndex, igsioTrackedFrame& frame) const;
+
+  /*! Read the frame fields and the image of the next frame. The image is allocated if its size or type does not match. */
+  PlusStatus ReadNextFrame(igsioTrackedFrame& frame);
+
+  /*! Read the frame fields and the image of any frame. The image is allocated if its size or type does not match. */
+  PlusStatus ReadFrame(int frameIndex, igsioTrackedFrame& frame);
+
+  /*!
+    Add the listed frames of the sequence to the frame list, in the order of the indices. Header fields that are not frame
+    fields are stored as custom fields of the frame list. If readImageData is false then only the frame fields are read
+    and the frames have no image. Frames with an ImageStatus other than OK have no image, as with vtkPlusSequenceIO::Read.
+  */
+  PlusStatus ReadFrames(vtkIGSIOTrackedFrameList* frameList, const std::vector<int>& frameIndices, bool readImageData);
+
+  /*!
+    Returns true if the frames can be memory mapped: the pixel data is not compressed, it is already in MF orientation
+    and the pixels are aligned in the file.
+  */
+  bool CanReadAllFramesMemoryMapped() const;
+
+  /*!
+    Add all the frames of the sequence to the frame list. The frame images are views into a memory mapping of the pixel data
+    (see vtkPlusMemoryMappedFile), so the pixels are only read from the disk when they are accessed. The mapping remains valid
+    while any of the images exist. Header fields that are not frame fields are stored as custom fields of the frame list.
+    Frames with an ImageStatus other than OK have no image, as with vtkPlusSequenceIO::Read.
+  */
+  PlusStatus ReadAllFramesMemoryMapped(vtkIGSIOTrackedFrameList* frameList);
+
+  /*!
+    Copy the pixel data of all frames to the output as it is stored in the file (compressed pixel data is not decompressed),
+    for writing it into another sequence file with the same image properties. Does not change the position of ReadNextFrame.
+  */
+  PlusStatus CopyPixelData(std::ostream& output, vtkTypeUInt64& numberOfBytesCopied) const;
+
+protected:
+  vtkPlusSequenceStreamReader();
+  virtual ~vtkPlusSequenceStreamReader();
+
+  /*! Parse the MetaImage header, store the frame fields and the position of the pixel data */
+  PlusStatus ReadHeader(const std::string& filePath);
+
+  /*! Read the next numberOfBytes bytes of pixel data */
+  PlusStatus ReadPixelData(unsigned char* buffer, size_t numberOfBytes);
+
+  /*! Set the position of the next ReadPixelData call, in bytes of uncompressed pixel data from the first frame */
+  PlusStatus SeekPixelData(vtkTypeUInt64 position);
+
+  /*! Decompress all the pixel data and store access points for seeking in the compressed stream */
+  PlusStatus BuildFrameIndex();
+
+  /*! Load the access points from the frame index file, fails if it does not exist or the pixel data file was modified */
+  PlusStatus ReadFrameIndexFile();
+  PlusStatus WriteFrameIndexFile();
+  std::string GetFrameIndexFilePath() const;
+
+  /*! Convert the pixel data of a frame (in file orientation) into the image of the frame */
+  PlusStatus SetFrameImage(int frameIndex, const unsigned char* pixelData, igsioTrackedFrame& frame);
+
+  /*! Returns false if the ImageStatus field of the frame is not OK (the frame has no valid image) */
+  bool IsFrameImageValid(int frameIndex) const;
+
+  /*! Store the header fields that are not frame fields as custom fields of the frame list */
+  void SetCustomFields(vtkIGSIOTrackedFrameList* frameList) const;
+
+  /*! Size of the pixel data of a frame in the file, in bytes */
+  size_t GetFrameSizeInBytes() const;
+
+  /*! Frame fields, indexed by frame index */
+  std::vector< std::map<std::string, std::string> > FrameFields;
+
+  /*! Header fields that are not frame fields */
+  std::map<std::string, std::string> CustomFields;
+
+  /*! File that contains the pixel data and the position of the pixel data of the first frame in it */
+  std::string DataFilePath;
+  std::streamoff DataOffset;
+
+  int NextFrameIndex;
+  int FrameCacheSize;
+  bool UseFrameIndexFile;
+
+  /*! Frame size in the file (before conversion to MF orientation) */
+  FrameSizeType FrameSizeInFile;
+  igsioCommon::VTKScalarPixelType PixelType;
+  unsigned int NumberOfScalarComponents;
+  US_IMAGE_TYPE ImageType;
+  US_IMAGE_ORIENTATION ImageOrientationInFile;
+  bool CompressedData;
+
+  /*! Pixel data of the last read frame, in file orientation, if frames are not cached */
+  std::vector<unsigned char> FramePixelBuffer;
+
+  class vtkInternal;
+  vtkInternal* Internal;
+
+private:
+  vtkPlusSequenceStreamReader(const vtkPlusSequenceStreamReader&);  // Not implemented.
+  void operator=(const vtkPlusSequenceStreamReader&);  // Not implemented.
+};
+
+#endif
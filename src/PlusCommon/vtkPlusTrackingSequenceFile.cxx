@@ -0,0 +1,676 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "vtkPlusTrackingSequenceFile.h"
+
+// IGSIO includes
+#include <igsioTrackedFrame.h>
+#include <vtkIGSIOTrackedFrameList.h>
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+#include <vtkSmartPointer.h>
+#include <vtksys/SystemTools.hxx>
+
+// STL includes
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+vtkStandardNewMacro(vtkPlusTrackingSequenceFile);
+
+namespace
+{
+  const char FILE_SIGNATURE[8] = { 'P', 'L', 'U', 'S', 'T', 'R', 'K', '\0' };
+  const vtkTypeUInt32 FILE_FORMAT_VERSION = 1;
+  /*! Written in the byte order of the writer, files written on a computer with a different byte order are rejected */
+  const vtkTypeUInt32 BYTE_ORDER_MARK = 0x01020304;
+  const std::string FILE_EXTENSION = ".ptrk";
+
+  /*! Names and custom string values longer than this are considered as a sign of a corrupted file */
+  const vtkTypeUInt32 MAX_STRING_LENGTH = 1 << 24;
+
+  const int MATRIX_ELEMENT_COUNT = 16;
+
+  /*! Fixed size part of the file header */
+  struct FileHeader
+  {
+    char Signature[8];
+    vtkTypeUInt32 FormatVersion;
+    vtkTypeUInt32 ByteOrderMark;
+    vtkTypeUInt64 NumberOfFrames;
+    vtkTypeUInt32 NumberOfTransforms;
+    vtkTypeUInt32 NumberOfFields;
+    vtkTypeUInt32 NumberOfCustomStrings;
+    vtkTypeUInt32 Reserved;
+  };
+
+  //----------------------------------------------------------------------------
+  /*! Columns start at 8-byte aligned file offsets, so that they can be mapped into memory as arrays */
+  vtkTypeUInt64 GetPaddingBytes(vtkTypeUInt64 position)
+  {
+    return (8 - position % 8) % 8;
+  }
+
+  //----------------------------------------------------------------------------
+  size_t GetBitsetBytes(size_t numberOfFrames)
+  {
+    return (numberOfFrames + 7) / 8;
+  }
+
+  //----------------------------------------------------------------------------
+  bool GetBit(const std::vector<unsigned char>& bits, int index)
+  {
+    return (bits[index / 8] & (1 << (index % 8))) != 0;
+  }
+
+  //----------------------------------------------------------------------------
+  void SetBit(std::vector<unsigned char>& bits, int index, bool value)
+  {
+    if (value)
+    {
+      bits[index / 8] |= static_cast<unsigned char>(1 << (index % 8));
+    }
+    else
+    {
+      bits[index / 8] &= static_cast<unsigned char>(~(1 << (index % 8)));
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void WriteString(std::ostream& file, const std::string& str)
+  {
+    vtkTypeUInt32 length = static_cast<vtkTypeUInt32>(str.size());
+    file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    file.write(str.data(), length);
+  }
+
+  //----------------------------------------------------------------------------
+  bool ReadString(std::istream& file, std::string& str)
+  {
+    vtkTypeUInt32 length = 0;
+    if (!file.read(reinterpret_cast<char*>(&length), sizeof(length)) || length > MAX_STRING_LENGTH)
+    {
+      return false;
+    }
+    str.resize(length);
+    return length == 0 || file.read(&str[0], length);
+  }
+
+  //----------------------------------------------------------------------------
+  void WritePadding(std::ostream& file)
+  {
+    const char zeros[8] = { 0 };
+    file.write(zeros, static_cast<std::streamsize>(GetPaddingBytes(static_cast<vtkTypeUInt64>(file.tellp()))));
+  }
+
+  //----------------------------------------------------------------------------
+  bool SkipPadding(std::istream& file)
+  {
+    return file.ignore(static_cast<std::streamsize>(GetPaddingBytes(static_cast<vtkTypeUInt64>(file.tellg())))).good();
+  }
+
+  //----------------------------------------------------------------------------
+  template<class T>
+  void WriteArray(std::ostream& file, const std::vector<T>& values)
+  {
+    if (!values.empty())
+    {
+      file.write(reinterpret_cast<const char*>(&values[0]), values.size() * sizeof(T));
+    }
+    WritePadding(file);
+  }
+
+  //----------------------------------------------------------------------------
+  template<class T>
+  bool ReadArray(std::istream& file, std::vector<T>& values, size_t numberOfValues)
+  {
+    values.resize(numberOfValues);
+    if (numberOfValues > 0 && !file.read(reinterpret_cast<char*>(&values[0]), numberOfValues * sizeof(T)))
+    {
+      return false;
+    }
+    return SkipPadding(file);
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkPlusTrackingSequenceFile::vtkPlusTrackingSequenceFile()
+{
+}
+
+//----------------------------------------------------------------------------
+vtkPlusTrackingSequenceFile::~vtkPlusTrackingSequenceFile()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTrackingSequenceFile::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfFrames: " << this->GetNumberOfFrames() << std::endl;
+  os << indent << "Transforms:";
+  for (std::vector<TransformColumn>::const_iterator transformIt = this->Transforms.begin(); transformIt != this->Transforms.end(); ++transformIt)
+  {
+    os << " " << transformIt->Name;
+  }
+  os << std::endl;
+  os << indent << "FrameFields:";
+  for (std::vector<FieldColumn>::const_iterator fieldIt = this->Fields.begin(); fieldIt != this->Fields.end(); ++fieldIt)
+  {
+    os << " " << fieldIt->Name;
+  }
+  os << std::endl;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusTrackingSequenceFile::CanReadFile(const std::string& filename)
+{
+  return vtksys::SystemTools::LowerCase(vtksys::SystemTools::GetFilenameLastExtension(filename)) == FILE_EXTENSION;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusTrackingSequenceFile::CanWriteFile(const std::string& filename)
+{
+  return CanReadFile(filename);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTrackingSequenceFile::Write(const std::string& filename, vtkIGSIOTrackedFrameList* frameList)
+{
+  vtkSmartPointer<vtkPlusTrackingSequenceFile> trackingFile = vtkSmartPointer<vtkPlusTrackingSequenceFile>::New();
+  if (trackingFile->AddFrames(frameList) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  return trackingFile->WriteFile(filename);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTrackingSequenceFile::Read(const std::string& filename, vtkIGSIOTrackedFrameList* frameList)
+{
+  vtkSmartPointer<vtkPlusTrackingSequenceFile> trackingFile = vtkSmartPointer<vtkPlusTrackingSequenceFile>::New();
+  if (trackingFile->ReadFile(filename) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  return trackingFile->GetFrames(frameList);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTrackingSequenceFile::Clear()
+{
+  this->Timestamps.clear();
+  this->Transforms.clear();
+  this->Fields.clear();
+  this->CustomStrings.clear();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTrackingSequenceFile::ReadFile(const std::string& filename)
+{
+  this->Clear();
+
+  std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+  if (!file.is_open())
+  {
+    LOG_ERROR("Unable to open tracking sequence file for reading: " << filename);
+    return PLUS_FAIL;
+  }
+  const vtkTypeUInt64 fileSizeBytes = vtksys::SystemTools::FileLength(filename);
+
+  FileHeader header;
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || memcmp(header.Signature, FILE_SIGNATURE, sizeof(FILE_SIGNATURE)) != 0)
+  {
+    LOG_ERROR("File is not a tracking sequence file: " << filename);
+    return PLUS_FAIL;
+  }
+  if (header.ByteOrderMark != BYTE_ORDER_MARK)
+  {
+    LOG_ERROR("Tracking sequence file was written on a computer with a different byte order, it cannot be read: " << filename);
+    return PLUS_FAIL;
+  }
+  if (header.FormatVersion > FILE_FORMAT_VERSION)
+  {
+    LOG_ERROR("Tracking sequence file format version " << header.FormatVersion << " is not supported (latest supported version: "
+              << FILE_FORMAT_VERSION << "): " << filename);
+    return PLUS_FAIL;
+  }
+
+  const size_t numberOfFrames = static_cast<size_t>(header.NumberOfFrames);
+  std::vector<std::string> transformNames(header.NumberOfTransforms);
+  std::vector<std::string> fieldNames(header.NumberOfFields);
+  bool namesValid = true;
+  for (std::vector<std::string>::iterator nameIt = transformNames.begin(); nameIt != transformNames.end() && namesValid; ++nameIt)
+  {
+    namesValid = ReadString(file, *nameIt);
+  }
+  for (std::vector<std::string>::iterator nameIt = fieldNames.begin(); nameIt != fieldNames.end() && namesValid; ++nameIt)
+  {
+    namesValid = ReadString(file, *nameIt);
+  }
+  for (vtkTypeUInt32 i = 0; i < header.NumberOfCustomStrings && namesValid; i++)
+  {
+    std::string name;
+    std::string value;
+    namesValid = ReadString(file, name) && ReadString(file, value);
+    this->CustomStrings[name] = value;
+  }
+  if (!namesValid || !SkipPadding(file))
+  {
+    LOG_ERROR("Failed to read the header of tracking sequence file: " << filename);
+    this->Clear();
+    return PLUS_FAIL;
+  }
+
+  // Check the size of the columns before allocating memory for them, to fail gracefully on truncated or corrupted files
+  const vtkTypeUInt64 bitsetSizeInFile = GetBitsetBytes(numberOfFrames) + GetPaddingBytes(GetBitsetBytes(numberOfFrames));
+  const vtkTypeUInt64 columnsSizeBytes = numberOfFrames * sizeof(double)
+                                         + header.NumberOfTransforms * (numberOfFrames * MATRIX_ELEMENT_COUNT * sizeof(double) + 2 * bitsetSizeInFile)
+                                         + header.NumberOfFields * numberOfFrames * sizeof(vtkTypeUInt64);
+  if (static_cast<vtkTypeUInt64>(file.tellg()) + columnsSizeBytes > fileSizeBytes)
+  {
+    LOG_ERROR("Tracking sequence file is truncated, it should contain " << numberOfFrames << " frames: " << filename);
+    this->Clear();
+    return PLUS_FAIL;
+  }
+
+  bool columnsValid = ReadArray(file, this->Timestamps, numberOfFrames);
+  this->Transforms.resize(transformNames.size());
+  for (size_t transformIndex = 0; transformIndex < transformNames.size() && columnsValid; transformIndex++)
+  {
+    TransformColumn& column = this->Transforms[transformIndex];
+    column.Name = transformNames[transformIndex];
+    columnsValid = ReadArray(file, column.Matrices, numberOfFrames * MATRIX_ELEMENT_COUNT)
+                   && ReadArray(file, column.DefinedBits, GetBitsetBytes(numberOfFrames))
+                   && ReadArray(file, column.ValidBits, GetBitsetBytes(numberOfFrames));
+  }
+  this->Fields.resize(fieldNames.size());
+  for (size_t fieldIndex = 0; fieldIndex < fieldNames.size() && columnsValid; fieldIndex++)
+  {
+    FieldColumn& column = this->Fields[fieldIndex];
+    column.Name = fieldNames[fieldIndex];
+    columnsValid = ReadArray(file, column.ValueEnds, numberOfFrames);
+    if (!columnsValid)
+    {
+      break;
+    }
+    // Value ends must be increasing, the last end is the size of the values
+    vtkTypeUInt64 valuesSizeBytes = 0;
+    for (std::vector<vtkTypeUInt64>::const_iterator endIt = column.ValueEnds.begin(); endIt != column.ValueEnds.end() && columnsValid; ++endIt)
+    {
+      columnsValid = (*endIt >= valuesSizeBytes);
+      valuesSizeBytes = *endIt;
+    }
+    columnsValid = columnsValid && static_cast<vtkTypeUInt64>(file.tellg()) + valuesSizeBytes <= fileSizeBytes;
+    if (columnsValid)
+    {
+      column.Values.resize(static_cast<size_t>(valuesSizeBytes));
+      columnsValid = (valuesSizeBytes == 0 || file.read(&column.Values[0], column.Values.size())) && SkipPadding(file);
+    }
+  }
+  if (!columnsValid)
+  {
+    LOG_ERROR("Failed to read the frames of tracking sequence file: " << filename);
+    this->Clear();
+    return PLUS_FAIL;
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTrackingSequenceFile::WriteFile(const std::string& filename) const
+{
+  std::ofstream file(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file.is_open())
+  {
+    LOG_ERROR("Unable to open tracking sequence file for writing: " << filename);
+    return PLUS_FAIL;
+  }
+
+  FileHeader header;
+  memcpy(header.Signature, FILE_SIGNATURE, sizeof(FILE_SIGNATURE));
+  header.FormatVersion = FILE_FORMAT_VERSION;
+  header.ByteOrderMark = BYTE_ORDER_MARK;
+  header.NumberOfFrames = this->Timestamps.size();
+  header.NumberOfTransforms = static_cast<vtkTypeUInt32>(this->Transforms.size());
+  header.NumberOfFields = static_cast<vtkTypeUInt32>(this->Fields.size());
+  header.NumberOfCustomStrings = static_cast<vtkTypeUInt32>(this->CustomStrings.size());
+  header.Reserved = 0;
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  for (std::vector<TransformColumn>::const_iterator transformIt = this->Transforms.begin(); transformIt != this->Transforms.end(); ++transformIt)
+  {
+    WriteString(file, transformIt->Name);
+  }
+  for (std::vector<FieldColumn>::const_iterator fieldIt = this->Fields.begin(); fieldIt != this->Fields.end(); ++fieldIt)
+  {
+    WriteString(file, fieldIt->Name);
+  }
+  for (std::map<std::string, std::string>::const_iterator customStringIt = this->CustomStrings.begin(); customStringIt != this->CustomStrings.end(); ++customStringIt)
+  {
+    WriteString(file, customStringIt->first);
+    WriteString(file, customStringIt->second);
+  }
+  WritePadding(file);
+
+  WriteArray(file, this->Timestamps);
+  for (std::vector<TransformColumn>::const_iterator transformIt = this->Transforms.begin(); transformIt != this->Transforms.end(); ++transformIt)
+  {
+    WriteArray(file, transformIt->Matrices);
+    WriteArray(file, transformIt->DefinedBits);
+    WriteArray(file, transformIt->ValidBits);
+  }
+  for (std::vector<FieldColumn>::const_iterator fieldIt = this->Fields.begin(); fieldIt != this->Fields.end(); ++fieldIt)
+  {
+    WriteArray(file, fieldIt->ValueEnds);
+    file.write(fieldIt->Values.data(), fieldIt->Values.size());
+    WritePadding(file);
+  }
+
+  file.close();
+  if (file.fail())
+  {
+    LOG_ERROR("Failed to write tracking sequence file: " << filename);
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTrackingSequenceFile::AddFrames(vtkIGSIOTrackedFrameList* frameList)
+{
+  if (frameList == NULL)
+  {
+    LOG_ERROR("vtkPlusTrackingSequenceFile::AddFrames: invalid frame list");
+    return PLUS_FAIL;
+  }
+
+  std::vector<std::string> customStringNames;
+  frameList->GetCustomFieldNameList(customStringNames);
+  for (std::vector<std::string>::iterator nameIt = customStringNames.begin(); nameIt != customStringNames.end(); ++nameIt)
+  {
+    const char* value = frameList->GetCustomString(nameIt->c_str());
+    if (value != NULL)
+    {
+      this->SetCustomString(*nameIt, value);
+    }
+  }
+
+  PlusStatus status = PLUS_SUCCESS;
+  int numberOfFramesWithImage = 0;
+  vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  for (unsigned int i = 0; i < frameList->GetNumberOfTrackedFrames(); ++i)
+  {
+    igsioTrackedFrame* frame = frameList->GetTrackedFrame(i);
+    int frameIndex = this->AddFrame(frame->GetTimestamp());
+    if (frame->GetImageData()->IsImageValid())
+    {
+      numberOfFramesWithImage++;
+    }
+
+    std::vector<igsioTransformName> transformNames;
+    frame->GetFrameTransformNameList(transformNames);
+    for (std::vector<igsioTransformName>::iterator nameIt = transformNames.begin(); nameIt != transformNames.end(); ++nameIt)
+    {
+      ToolStatus transformStatus = TOOL_INVALID;
+      if (frame->GetFrameTransform(*nameIt, matrix) != PLUS_SUCCESS || frame->GetFrameTransformStatus(*nameIt, transformStatus) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to get transform " << nameIt->GetTransformName() << " of frame " << i);
+        status = PLUS_FAIL;
+        continue;
+      }
+      this->SetFrameTransform(frameIndex, nameIt->GetTransformName(), matrix, transformStatus);
+    }
+
+    const igsioFieldMapType& frameFields = frame->GetCustomFields();
+    for (igsioFieldMapType::const_iterator fieldIt = frameFields.begin(); fieldIt != frameFields.end(); ++fieldIt)
+    {
+      // The timestamp and the transforms have their own columns, images are not stored
+      if (fieldIt->first == "Timestamp" || fieldIt->first == "ImageStatus"
+          || igsioTrackedFrame::IsTransform(fieldIt->first) || igsioTrackedFrame::IsTransformStatus(fieldIt->first))
+      {
+        continue;
+      }
+      this->SetFrameField(frameIndex, fieldIt->first, fieldIt->second.second);
+    }
+  }
+
+  if (numberOfFramesWithImage > 0)
+  {
+    LOG_WARNING("Tracking sequence files do not store images, the images of " << numberOfFramesWithImage << " frames are not written");
+  }
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTrackingSequenceFile::GetFrames(vtkIGSIOTrackedFrameList* frameList) const
+{
+  if (frameList == NULL)
+  {
+    LOG_ERROR("vtkPlusTrackingSequenceFile::GetFrames: invalid frame list");
+    return PLUS_FAIL;
+  }
+
+  for (std::map<std::string, std::string>::const_iterator customStringIt = this->CustomStrings.begin(); customStringIt != this->CustomStrings.end(); ++customStringIt)
+  {
+    frameList->SetCustomString(customStringIt->first.c_str(), customStringIt->second.c_str());
+  }
+
+  std::vector<igsioTransformName> transformNames;
+  for (std::vector<TransformColumn>::const_iterator transformIt = this->Transforms.begin(); transformIt != this->Transforms.end(); ++transformIt)
+  {
+    transformNames.push_back(igsioTransformName(transformIt->Name));
+  }
+
+  vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  for (int frameIndex = 0; frameIndex < this->GetNumberOfFrames(); frameIndex++)
+  {
+    igsioTrackedFrame* frame = new igsioTrackedFrame;
+    frame->SetTimestamp(this->Timestamps[frameIndex]);
+    for (size_t transformIndex = 0; transformIndex < this->Transforms.size(); transformIndex++)
+    {
+      const TransformColumn& column = this->Transforms[transformIndex];
+      if (!GetBit(column.DefinedBits, frameIndex))
+      {
+        continue;
+      }
+      matrix->DeepCopy(&column.Matrices[frameIndex * MATRIX_ELEMENT_COUNT]);
+      frame->SetFrameTransform(transformNames[transformIndex], matrix);
+      frame->SetFrameTransformStatus(transformNames[transformIndex], GetBit(column.ValidBits, frameIndex) ? TOOL_OK : TOOL_INVALID);
+    }
+    for (size_t fieldIndex = 0; fieldIndex < this->Fields.size(); fieldIndex++)
+    {
+      std::string value = this->GetFrameFieldValue(static_cast<int>(fieldIndex), frameIndex);
+      if (!value.empty())
+      {
+        frame->SetFrameField(this->Fields[fieldIndex].Name, value);
+      }
+    }
+    frameList->TakeTrackedFrame(frame);
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusTrackingSequenceFile::AddFrame(double timestamp)
+{
+  const size_t numberOfFrames = this->Timestamps.size();
+  this->Timestamps.push_back(timestamp);
+  for (std::vector<TransformColumn>::iterator transformIt = this->Transforms.begin(); transformIt != this->Transforms.end(); ++transformIt)
+  {
+    transformIt->Matrices.resize((numberOfFrames + 1) * MATRIX_ELEMENT_COUNT, 0.0);
+    transformIt->DefinedBits.resize(GetBitsetBytes(numberOfFrames + 1), 0);
+    transformIt->ValidBits.resize(GetBitsetBytes(numberOfFrames + 1), 0);
+  }
+  for (std::vector<FieldColumn>::iterator fieldIt = this->Fields.begin(); fieldIt != this->Fields.end(); ++fieldIt)
+  {
+    fieldIt->ValueEnds.push_back(fieldIt->Values.size());
+  }
+  return static_cast<int>(numberOfFrames);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTrackingSequenceFile::SetFrameTransform(int frameIndex, const std::string& transformName, const vtkMatrix4x4* matrix, ToolStatus status)
+{
+  if (matrix == NULL)
+  {
+    LOG_ERROR("vtkPlusTrackingSequenceFile::SetFrameTransform: invalid matrix for transform " << transformName);
+    return PLUS_FAIL;
+  }
+  double matrixElements[MATRIX_ELEMENT_COUNT];
+  vtkMatrix4x4::DeepCopy(matrixElements, matrix);
+  return this->SetFrameTransform(frameIndex, transformName, matrixElements, status);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTrackingSequenceFile::SetFrameTransform(int frameIndex, const std::string& transformName, const double matrixElements[16], ToolStatus status)
+{
+  if (frameIndex < 0 || frameIndex >= this->GetNumberOfFrames())
+  {
+    LOG_ERROR("vtkPlusTrackingSequenceFile::SetFrameTransform: invalid frame index " << frameIndex);
+    return PLUS_FAIL;
+  }
+  TransformColumn& column = this->GetTransformColumn(transformName);
+  std::copy(matrixElements, matrixElements + MATRIX_ELEMENT_COUNT, column.Matrices.begin() + frameIndex * MATRIX_ELEMENT_COUNT);
+  SetBit(column.DefinedBits, frameIndex, true);
+  SetBit(column.ValidBits, frameIndex, status == TOOL_OK);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTrackingSequenceFile::SetFrameField(int frameIndex, const std::string& fieldName, const std::string& fieldValue)
+{
+  if (frameIndex < 0 || frameIndex != this->GetNumberOfFrames() - 1)
+  {
+    LOG_ERROR("vtkPlusTrackingSequenceFile::SetFrameField: fields can only be set for the last frame, invalid frame index " << frameIndex);
+    return PLUS_FAIL;
+  }
+  FieldColumn& column = this->GetFieldColumn(fieldName);
+  // Replace the value of the last frame
+  vtkTypeUInt64 valueStart = (frameIndex > 0 ? column.ValueEnds[frameIndex - 1] : 0);
+  column.Values.resize(static_cast<size_t>(valueStart));
+  column.Values.append(fieldValue);
+  column.ValueEnds[frameIndex] = column.Values.size();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTrackingSequenceFile::SetCustomString(const std::string& name, const std::string& value)
+{
+  this->CustomStrings[name] = value;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusTrackingSequenceFile::GetTransformName(int transformIndex) const
+{
+  if (transformIndex < 0 || transformIndex >= this->GetNumberOfTransforms())
+  {
+    LOG_ERROR("vtkPlusTrackingSequenceFile::GetTransformName: invalid transform index " << transformIndex);
+    return "";
+  }
+  return this->Transforms[transformIndex].Name;
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusTrackingSequenceFile::GetTransformIndex(const std::string& transformName) const
+{
+  for (size_t transformIndex = 0; transformIndex < this->Transforms.size(); transformIndex++)
+  {
+    if (this->Transforms[transformIndex].Name == transformName)
+    {
+      return static_cast<int>(transformIndex);
+    }
+  }
+  return -1;
+}
+
+//----------------------------------------------------------------------------
+const double* vtkPlusTrackingSequenceFile::GetTransformMatrices(int transformIndex) const
+{
+  if (transformIndex < 0 || transformIndex >= this->GetNumberOfTransforms())
+  {
+    LOG_ERROR("vtkPlusTrackingSequenceFile::GetTransformMatrices: invalid transform index " << transformIndex);
+    return NULL;
+  }
+  const std::vector<double>& matrices = this->Transforms[transformIndex].Matrices;
+  return matrices.empty() ? NULL : &matrices[0];
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusTrackingSequenceFile::IsTransformDefined(int transformIndex, int frameIndex) const
+{
+  if (transformIndex < 0 || transformIndex >= this->GetNumberOfTransforms() || frameIndex < 0 || frameIndex >= this->GetNumberOfFrames())
+  {
+    return false;
+  }
+  return GetBit(this->Transforms[transformIndex].DefinedBits, frameIndex);
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusTrackingSequenceFile::IsTransformValid(int transformIndex, int frameIndex) const
+{
+  return this->IsTransformDefined(transformIndex, frameIndex) && GetBit(this->Transforms[transformIndex].ValidBits, frameIndex);
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusTrackingSequenceFile::GetFrameFieldName(int fieldIndex) const
+{
+  if (fieldIndex < 0 || fieldIndex >= this->GetNumberOfFrameFields())
+  {
+    LOG_ERROR("vtkPlusTrackingSequenceFile::GetFrameFieldName: invalid field index " << fieldIndex);
+    return "";
+  }
+  return this->Fields[fieldIndex].Name;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusTrackingSequenceFile::GetFrameFieldValue(int fieldIndex, int frameIndex) const
+{
+  if (fieldIndex < 0 || fieldIndex >= this->GetNumberOfFrameFields() || frameIndex < 0 || frameIndex >= this->GetNumberOfFrames())
+  {
+    return "";
+  }
+  const FieldColumn& column = this->Fields[fieldIndex];
+  vtkTypeUInt64 valueStart = (frameIndex > 0 ? column.ValueEnds[frameIndex - 1] : 0);
+  return column.Values.substr(static_cast<size_t>(valueStart), static_cast<size_t>(column.ValueEnds[frameIndex] - valueStart));
+}
+
+//----------------------------------------------------------------------------
+vtkPlusTrackingSequenceFile::TransformColumn& vtkPlusTrackingSequenceFile::GetTransformColumn(const std::string& transformName)
+{
+  int transformIndex = this->GetTransformIndex(transformName);
+  if (transformIndex >= 0)
+  {
+    return this->Transforms[transformIndex];
+  }
+  this->Transforms.push_back(TransformColumn());
+  TransformColumn& column = this->Transforms.back();
+  column.Name = transformName;
+  column.Matrices.resize(this->Timestamps.size() * MATRIX_ELEMENT_COUNT, 0.0);
+  column.DefinedBits.resize(GetBitsetBytes(this->Timestamps.size()), 0);
+  column.ValidBits.resize(GetBitsetBytes(this->Timestamps.size()), 0);
+  return column;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusTrackingSequenceFile::FieldColumn& vtkPlusTrackingSequenceFile::GetFieldColumn(const std::string& fieldName)
+{
+  for (std::vector<FieldColumn>::iterator fieldIt = this->Fields.begin(); fieldIt != this->Fields.end(); ++fieldIt)
+  {
+    if (fieldIt->Name == fieldName)
+    {
+      return *fieldIt;
+    }
+  }
+  this->Fields.push_back(FieldColumn());
+  FieldColumn& column = this->Fields.back();
+  column.Name = fieldName;
+  column.ValueEnds.resize(this->Timestamps.size(), 0);
+  return column;
+}
@@ -0,0 +1,146 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusTrackingSequenceFile_h
+#define __vtkPlusTrackingSequenceFile_h
+
+#include "vtkPlusCommonExport.h"
+#include "vtkObject.h"
+
+#include <igsioCommon.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+class vtkIGSIOTrackedFrameList;
+class vtkMatrix4x4;
+
+/*!
+  \class vtkPlusTrackingSequenceFile
+  \brief Stores tracking-only sequences (timestamps, transforms and frame fields, no images) in a compact columnar binary file
+
+  The frames are stored column by column: the timestamps of all frames form one array, each transform is stored as an array of
+  row-major 4x4 matrices (16 doubles per frame) and two bitsets (transform is defined in the frame, transform status is OK), and
+  each other frame field is stored as an array of value end offsets followed by the concatenated values. Reading a file is a few
+  large reads directly into the columns, which can be accessed without creating tracked frames.
+
+  Files have the .ptrk extension. Image data is not stored, frames read from the file have no image.
+  See the \ref FileSequenceFile page of the user manual for the file layout.
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport vtkPlusTrackingSequenceFile : public vtkObject
+{
+public:
+  static vtkPlusTrackingSequenceFile* New();
+  vtkTypeMacro(vtkPlusTrackingSequenceFile, vtkObject);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  /*! Returns true if the file (determined from the file extension) is a tracking sequence file */
+  static bool CanReadFile(const std::string& filename);
+  static bool CanWriteFile(const std::string& filename);
+
+  /*! Write the timestamps, transforms and frame fields of all frames of the frame list to file */
+  static PlusStatus Write(const std::string& filename, vtkIGSIOTrackedFrameList* frameList);
+
+  /*! Read all frames of the file and append them to the frame list */
+  static PlusStatus Read(const std::string& filename, vtkIGSIOTrackedFrameList* frameList);
+
+  /*! Remove all frames, transforms, fields and custom strings */
+  void Clear();
+
+  /*! Read the columns from file, replacing the current contents */
+  PlusStatus ReadFile(const std::string& filename);
+
+  /*! Write the columns to file */
+  PlusStatus WriteFile(const std::string& filename) const;
+
+  /*! Append the timestamps, transforms and frame fields of the frames of the list, and the custom strings of the list */
+  PlusStatus AddFrames(vtkIGSIOTrackedFrameList* frameList);
+
+  /*! Append the frames to the list (the transforms and fields are converted to frame fields), and set the custom strings of the list */
+  PlusStatus GetFrames(vtkIGSIOTrackedFrameList* frameList) const;
+
+  /*! Append a frame without transforms and fields, returns the index of the frame */
+  int AddFrame(double timestamp);
+
+  /*! Set a transform of a frame. Frames that the transform is not set for have no such transform. */
+  PlusStatus SetFrameTransform(int frameIndex, const std::string& transformName, const vtkMatrix4x4* matrix, ToolStatus status);
+  PlusStatus SetFrameTransform(int frameIndex, const std::string& transformName, const double matrixElements[16], ToolStatus status);
+
+  /*! Set a frame field of a frame. Fields can only be set for the last frame. Frames that the field is not set for have no such field. */
+  PlusStatus SetFrameField(int frameIndex, const std::string& fieldName, const std::string& fieldValue);
+
+  /*! Custom strings of the sequence (fields that do not belong to a single frame) */
+  void SetCustomString(const std::string& name, const std::string& value);
+  const std::map<std::string, std::string>& GetCustomStrings() const { return this->CustomStrings; }
+
+  int GetNumberOfFrames() const { return static_cast<int>(this->Timestamps.size()); }
+
+  /*! Timestamps of all frames */
+  const double* GetTimestamps() const { return this->Timestamps.empty() ? NULL : &this->Timestamps[0]; }
+
+  int GetNumberOfTransforms() const { return static_cast<int>(this->Transforms.size()); }
+  std::string GetTransformName(int transformIndex) const;
+  /*! Returns -1 if the sequence has no transform with that name */
+  int GetTransformIndex(const std::string& transformName) const;
+
+  /*! Row-major 4x4 matrices of the transform in all frames (16 elements per frame) */
+  const double* GetTransformMatrices(int transformIndex) const;
+
+  /*! Returns true if the transform is set in the frame */
+  bool IsTransformDefined(int transformIndex, int frameIndex) const;
+
+  /*! Returns true if the transform is set in the frame and its status is OK */
+  bool IsTransformValid(int transformIndex, int frameIndex) const;
+
+  int GetNumberOfFrameFields() const { return static_cast<int>(this->Fields.size()); }
+  std::string GetFrameFieldName(int fieldIndex) const;
+  /*! Value of a frame field in a frame, empty if the field is not set in the frame */
+  std::string GetFrameFieldValue(int fieldIndex, int frameIndex) const;
+
+protected:
+  vtkPlusTrackingSequenceFile();
+  virtual ~vtkPlusTrackingSequenceFile();
+
+  /*! Values of a transform in all frames */
+  struct TransformColumn
+  {
+    std::string Name;
+    std::vector<double> Matrices;
+    /*! One bit per frame, set if the transform is defined in the frame */
+    std::vector<unsigned char> DefinedBits;
+    /*! One bit per frame, set if the transform status is OK in the frame */
+    std::vector<unsigned char> ValidBits;
+  };
+
+  /*! Values of a frame field in all frames */
+  struct FieldColumn
+  {
+    std::string Name;
+    /*! End offset of the value of each frame in Values, the value of a frame starts at the end of the previous value */
+    std::vector<vtkTypeUInt64> ValueEnds;
+    std::string Values;
+  };
+
+  /*! Returns the column of the transform, adds a new column (undefined in all frames) if there is none */
+  TransformColumn& GetTransformColumn(const std::string& transformName);
+
+  /*! Returns the column of the field, adds a new column (empty in all frames) if there is none */
+  FieldColumn& GetFieldColumn(const std::string& fieldName);
+
+  std::vector<double> Timestamps;
+  std::vector<TransformColumn> Transforms;
+  std::vector<FieldColumn> Fields;
+  std::map<std::string, std::string> CustomStrings;
+
+private:
+  vtkPlusTrackingSequenceFile(const vtkPlusTrackingSequenceFile&);  // Not implemented.
+  void operator=(const vtkPlusTrackingSequenceFile&);  // Not implemented.
+};
+
+#endif
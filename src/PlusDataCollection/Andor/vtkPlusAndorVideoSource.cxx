@@ -218,13 +218,14 @@ PlusStatus vtkPlusAndorVideoSource::InitializeAndorCamera()
     return PLUS_FAIL;
   }
 
-  int x, y;
-  checkStatus(GetDetector(&x, &y), "GetDetector");
-  frameSize[0] = static_cast<unsigned>(x);
-  frameSize[1] = static_cast<unsigned>(y);
+  checkStatus(GetDetector(&this->DetectorSize[0], &this->DetectorSize[1]), "GetDetector");
+  this->ReadoutRegion[0] = 1;
+  this->ReadoutRegion[1] = this->DetectorSize[0];
+  this->ReadoutRegion[2] = 1;
+  this->ReadoutRegion[3] = this->DetectorSize[1];
 
-  // init to binning of 1 (meaning no binning), and full sensor size
-  checkStatus(SetImage(this->HorizontalBins, this->VerticalBins, 1, x, 1, y), "SetImage");
+  // init to the configured binning and full sensor size
+  this->SetImageReadout(this->HorizontalBins, this->VerticalBins);
 
   checkStatus(PrepareAcquisition(), "PrepareAcquisition");
 
@@ -246,6 +247,79 @@ void vtkPlusAndorVideoSource::InitializePort(DataSourceArray& port)
   }
 }
 
+// ----------------------------------------------------------------------------
+PlusStatus vtkPlusAndorVideoSource::SetImageReadout(int hbin, int vbin)
+{
+  if(hbin <= 0 || vbin <= 0)
+  {
+    LOG_ERROR("Invalid binning: " << hbin << "x" << vbin);
+    return PLUS_FAIL;
+  }
+  // the read out region has to be a multiple of the binning
+  int width = (this->ReadoutRegion[1] - this->ReadoutRegion[0] + 1) / hbin;
+  int height = (this->ReadoutRegion[3] - this->ReadoutRegion[2] + 1) / vbin;
+  if(width <= 0 || height <= 0)
+  {
+    LOG_ERROR("Readout region is smaller than the binning " << hbin << "x" << vbin);
+    return PLUS_FAIL;
+  }
+  unsigned status = checkStatus(::SetImage(hbin, vbin,
+                                this->ReadoutRegion[0], this->ReadoutRegion[0] + width * hbin - 1,
+                                this->ReadoutRegion[2], this->ReadoutRegion[2] + height * vbin - 1), "SetImage");
+  if(status != DRV_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  frameSize[0] = static_cast<unsigned>(width);
+  frameSize[1] = static_cast<unsigned>(height);
+  return PLUS_SUCCESS;
+}
+
+// ----------------------------------------------------------------------------
+void vtkPlusAndorVideoSource::ApplyClipRectangleInHardware()
+{
+  std::array<int, 3> clipOrigin;
+  std::array<int, 3> clipSize;
+  if(m_ReadMode != ReadMode::Image || this->GetCommonClipRectangleOfVideoSources(clipOrigin, clipSize) != PLUS_SUCCESS)
+  {
+    return;
+  }
+
+  // the clip rectangle is in binned pixels
+  int hstart = clipOrigin[0] * this->HorizontalBins + 1;
+  int hend = hstart + clipSize[0] * this->HorizontalBins - 1;
+  int vstart = clipOrigin[1] * this->VerticalBins + 1;
+  int vend = vstart + clipSize[1] * this->VerticalBins - 1;
+  if(clipOrigin[0] < 0 || clipOrigin[1] < 0 || hend > this->DetectorSize[0] || vend > this->DetectorSize[1])
+  {
+    LOG_WARNING("Clip rectangle of the video sources does not fit into the sensor, it is not applied in the camera");
+    return;
+  }
+
+  this->ReadoutRegion[0] = hstart;
+  this->ReadoutRegion[1] = hend;
+  this->ReadoutRegion[2] = vstart;
+  this->ReadoutRegion[3] = vend;
+  if(this->SetImageReadout(this->HorizontalBins, this->VerticalBins) != PLUS_SUCCESS)
+  {
+    LOG_WARNING("Failed to read out the clip rectangle of the video sources, the full sensor is read out");
+    this->ReadoutRegion[0] = 1;
+    this->ReadoutRegion[1] = this->DetectorSize[0];
+    this->ReadoutRegion[2] = 1;
+    this->ReadoutRegion[3] = this->DetectorSize[1];
+    this->SetImageReadout(this->HorizontalBins, this->VerticalBins);
+    return;
+  }
+
+  LOG_INFO("Andor sensor region read out: horizontal " << hstart << "-" << hend << ", vertical " << vstart << "-" << vend);
+  this->ClipRectangleAppliedInHardware = true;
+  std::vector<vtkPlusDataSource*> videoSources = this->GetVideoSources();
+  for(unsigned i = 0; i < videoSources.size(); i++)
+  {
+    videoSources[i]->SetClipRectangleAppliedByDevice(true);
+  }
+}
+
 // ----------------------------------------------------------------------------
 PlusStatus vtkPlusAndorVideoSource::InternalConnect()
 {
@@ -272,6 +346,8 @@ PlusStatus vtkPlusAndorVideoSource::InternalConnect()
     BLIRaw.push_back(aSource); // this is the default port
   }
 
+  this->ApplyClipRectangleInHardware();
+
   this->InitializePort(BLIRaw);
   this->InitializePort(BLICorrected);
   this->InitializePort(GrayRaw);
@@ -300,6 +376,17 @@ PlusStatus vtkPlusAndorVideoSource::InternalDisconnect()
 
   checkStatus(FreeInternalMemory(), "FreeInternalMemory");
 
+  if(this->ClipRectangleAppliedInHardware)
+  {
+    // the clip rectangle of the video sources may change before the next connection
+    this->ClipRectangleAppliedInHardware = false;
+    std::vector<vtkPlusDataSource*> videoSources = this->GetVideoSources();
+    for(unsigned i = 0; i < videoSources.size(); i++)
+    {
+      videoSources[i]->SetClipRectangleAppliedByDevice(false);
+    }
+  }
+
   unsigned result = checkStatus(ShutDown(), "ShutDown");
   if(result == DRV_SUCCESS)
   {
@@ -376,15 +463,18 @@ void vtkPlusAndorVideoSource::WaitForWarmup()
 // ----------------------------------------------------------------------------
 PlusStatus vtkPlusAndorVideoSource::AcquireFrame(float exposure, ShutterMode shutterMode, int binning, int vsSpeed, int hsSpeed)
 {
-  unsigned rawFrameSize = frameSize[0] * frameSize[1];
-  rawFrame.resize(rawFrameSize, 0);
-
   checkStatus(::SetExposureTime(exposure), "SetExposureTime");
   checkStatus(::SetShutter(1, shutterMode, 0, 0), "SetShutter");
 
   int hbin = binning > 0 ? binning : this->HorizontalBins;
   int vbin = binning > 0 ? binning : this->VerticalBins;
-  checkStatus(::SetImage(hbin, vbin, 1, 1024, 1, 1024), "Binning");
+  if(this->SetImageReadout(hbin, vbin) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to set binning " << hbin << "x" << vbin);
+    return PLUS_FAIL;
+  }
+  unsigned rawFrameSize = frameSize[0] * frameSize[1];
+  rawFrame.resize(rawFrameSize, 0);
 
   int vsInd = vsSpeed >= 0 ? vsSpeed : this->VSSpeed;
   checkStatus(::SetVSSpeed(vsInd), "SetVSSpeed");
@@ -414,6 +504,11 @@ void vtkPlusAndorVideoSource::AddFrameToDataSource(DataSourceArray& ds)
 {
   for(unsigned i = 0; i < ds.size(); i++)
   {
+    if(ds[i]->GetInputFrameSize() != frameSize)
+    {
+      // binning of the acquisition is different from the previous one
+      ds[i]->SetInputFrameSize(frameSize);
+    }
     if(ds[i]->AddItem(&rawFrame[0],
                       US_IMG_ORIENT_MF,
                       frameSize, VTK_UNSIGNED_SHORT,
@@ -436,7 +531,12 @@ void vtkPlusAndorVideoSource::AddFrameToDataSource(DataSourceArray& ds)
 // ----------------------------------------------------------------------------
 void vtkPlusAndorVideoSource::ApplyFrameCorrections()
 {
-  cv::Mat cvIMG(frameSize[0], frameSize[1], CV_16UC1, &rawFrame[0]); // uses rawFrame as buffer
+  cv::Mat cvIMG(frameSize[1], frameSize[0], CV_16UC1, &rawFrame[0]); // uses rawFrame as buffer
+  if(cvBiasDarkCorrection.size() != cvIMG.size() || cvFlatCorrection.size() != cvIMG.size())
+  {
+    LOG_WARNING("Size of the correction images does not match the size of the frame (" << frameSize[0] << "x" << frameSize[1] << "), corrections are not applied");
+    return;
+  }
   cv::Mat floatImage;
   cvIMG.convertTo(floatImage, CV_32FC1);
   cv::Mat result;
@@ -493,7 +593,7 @@ PlusStatus vtkPlusAndorVideoSource::AcquireCorrectionFrame(const std::string cor
 {
   AcquireFrame(exposureTime, shutter, binning, vsSpeed, hsSpeed);
   ++this->FrameNumber;
-  cv::Mat saveImage(frameSize[0], frameSize[1], CV_16UC1, &rawFrame[0]);
+  cv::Mat saveImage(frameSize[1], frameSize[0], CV_16UC1, &rawFrame[0]);
   cv::imwrite(correctionFilePath, saveImage);
   return PLUS_SUCCESS;
 }
@@ -577,10 +677,7 @@ float vtkPlusAndorVideoSource::GetExposureTime()
 // ----------------------------------------------------------------------------
 PlusStatus vtkPlusAndorVideoSource::SetHorizontalBins(int bins)
 {
-  int x, y;
-  checkStatus(GetDetector(&x, &y), "GetDetector");  // full sensor size
-  unsigned status = checkStatus(::SetImage(bins, this->VerticalBins, 1, x, 1, y), "SetImage");
-  if(status != DRV_SUCCESS)
+  if(this->SetImageReadout(bins, this->VerticalBins) != PLUS_SUCCESS)
   {
     LOG_ERROR("SetImage failed while changing horizontal bins.");
     return PLUS_FAIL;
@@ -592,10 +689,7 @@ PlusStatus vtkPlusAndorVideoSource::SetHorizontalBins(int bins)
 // ----------------------------------------------------------------------------
 PlusStatus vtkPlusAndorVideoSource::SetVerticalBins(int bins)
 {
-  int x, y;
-  checkStatus(GetDetector(&x, &y), "GetDetector");  // full sensor size
-  unsigned status = checkStatus(::SetImage(this->HorizontalBins, bins, 1, x, 1, y), "SetImage");
-  if(status != DRV_SUCCESS)
+  if(this->SetImageReadout(this->HorizontalBins, bins) != PLUS_SUCCESS)
   {
     LOG_ERROR("SetImage failed while changing vertical bins.");
     return PLUS_FAIL;
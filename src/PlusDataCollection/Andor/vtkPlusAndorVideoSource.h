@@ -17,6 +17,10 @@
  Requires PLUS_USE_ANDOR_CAMERA option in CMake.
  Requires the Andor SDK (SDK provided by Andor).
 
+ In image read mode, if all video sources have the same clip rectangle then only that region of the sensor is read out
+ (the clip rectangle is specified in pixels of the binned image). Reading out a smaller region shortens the readout time
+ and the transfer; binning is the hardware downsampling of the camera.
+
  \ingroup PlusLibDataCollection.
 */
 class vtkPlusDataCollectionExport vtkPlusAndorVideoSource: public vtkPlusDevice
@@ -204,6 +208,12 @@ protected:
   /*! Initialize all data sources of the provided port */
   void InitializePort(DataSourceArray& port);
 
+  /*! Set the binning and the ReadoutRegion of the sensor in the camera, and update the frameSize accordingly */
+  PlusStatus SetImageReadout(int hbin, int vbin);
+
+  /*! Read out only the common clip rectangle of the video sources, if they have one and the read mode is image */
+  void ApplyClipRectangleInHardware();
+
   /*! Acquire a single frame using current parameters. Data is put in the frameBuffer ivar. */
   PlusStatus AcquireFrame(float exposure, ShutterMode shutterMode, int binning, int vsSpeed, int hsSpeed);
 
@@ -266,6 +276,10 @@ protected:
   float CurrentTemperature = 0.123456789; // easy to spot as uninitialized
 
   FrameSizeType frameSize = {1024, 1024, 1};
+  int DetectorSize[2] = { 1024, 1024 };
+  /*! Region of the sensor that is read out: horizontal start, end, vertical start, end (1-based, inclusive, unbinned pixels) */
+  int ReadoutRegion[4] = { 1, 1024, 1, 1024 };
+  bool ClipRectangleAppliedInHardware = false;
   std::vector<uint16_t> rawFrame;
   double currentTime = UNDEFINED_TIMESTAMP;
 
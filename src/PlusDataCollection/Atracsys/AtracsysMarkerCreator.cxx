@@ -118,6 +118,13 @@ int main(int argc, char** argv)
     LOG_WARNING(Tracker.ResultToString(result));
   }
 
+  // the marker geometry is computed from the fiducials, which are not retrieved by default
+  if ((result = Tracker.SetFrameOptions(true, 16)) != ATR_SUCCESS)
+  {
+    LOG_ERROR(Tracker.ResultToString(result));
+    return PLUS_FAIL;
+  }
+
   // get device type
   Tracker.GetDeviceType(DeviceType);
 
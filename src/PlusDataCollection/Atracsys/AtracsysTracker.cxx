@@ -60,6 +60,7 @@ public:
     ResultToStringMap[ERROR_CANNOT_GET_MARKER_INFO] = "Cannot get info about paired wireless markers.";
     ResultToStringMap[ERROR_FAILED_TO_SET_STK_PROCESSING_TYPE] = "Failed to set spryTrack image processing type.";
     ResultToStringMap[ERROR_FAILED_TO_SET_MAX_MISSING_FIDS] = "Failed to set maximum number of missing fiducials.";
+    ResultToStringMap[ERROR_FIDUCIALS_NOT_RETRIEVED] = "Fiducials are not retrieved from the tracker, enable them in the frame options.";
   }
 
   virtual ~AtracsysInternal()
@@ -77,6 +78,10 @@ public:
   // ftk frame data
   ftkFrameQuery* Frame = nullptr;
 
+  // frame options, what the tracker sends in each frame
+  bool RetrieveFiducials = false;
+  unsigned int MaxNumberOfMarkers = 16;
+
   // mapping error code to user readable result string
   std::map<AtracsysTracker::ATRACSYS_RESULT, std::string> ResultToStringMap;
 
@@ -86,6 +91,9 @@ public:
   // helper function to load ftkGeometry from string
   ATRACSYS_RESULT LoadFtkGeometryFromString(const std::string& geomString, ftkGeometry& geom);
 
+  // helper function to reserve the frame data that is retrieved from the tracker
+  ftkError ApplyFrameOptions();
+
   // Code from ATRACSYS
   class IniFile
   {
@@ -481,6 +489,15 @@ AtracsysTracker::ATRACSYS_RESULT AtracsysTracker::AtracsysInternal::LoadFtkGeome
   return ERROR_FAILURE_TO_LOAD_INI;
 }
 
+//----------------------------------------------------------------------------
+ftkError AtracsysTracker::AtracsysInternal::ApplyFrameOptions()
+{
+  // raw data and 3D fiducials are copied into every frame, so they are only reserved if they are used
+  const uint32 rawDataSize = this->RetrieveFiducials ? 128u : 0u;
+  const uint32 threeDFiducialsSize = this->RetrieveFiducials ? 4u * FTK_MAX_FIDUCIALS : 0u;
+  return ftkSetFrameOptions(false, false, rawDataSize, rawDataSize, threeDFiducialsSize, this->MaxNumberOfMarkers, this->Frame);
+}
+
 //----------------------------------------------------------------------------
 AtracsysTracker::ATRACSYS_RESULT AtracsysTracker::SetSpryTrackOnlyOption(int option, int value, AtracsysTracker::ATRACSYS_RESULT errorResult)
 {
@@ -587,7 +604,7 @@ AtracsysTracker::ATRACSYS_RESULT AtracsysTracker::Connect()
     return ERROR_CANNOT_CREATE_FRAME_INSTANCE;
   }
 
-  if (ftkSetFrameOptions(false, false, 128u, 128u, 4u * FTK_MAX_FIDUCIALS, 4u, this->Internal->Frame) != ftkError::FTK_OK)
+  if (this->Internal->ApplyFrameOptions() != ftkError::FTK_OK)
   {
     ftkDeleteFrame(this->Internal->Frame);
     this->Internal->Frame = nullptr;
@@ -624,6 +641,18 @@ AtracsysTracker::ATRACSYS_RESULT AtracsysTracker::GetDeviceType(DEVICE_TYPE& dev
   return SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+AtracsysTracker::ATRACSYS_RESULT AtracsysTracker::SetFrameOptions(bool retrieveFiducials, int maxNumberOfMarkers)
+{
+  this->Internal->RetrieveFiducials = retrieveFiducials;
+  this->Internal->MaxNumberOfMarkers = static_cast<unsigned int>(std::max(maxNumberOfMarkers, 1));
+  if (this->Internal->Frame != nullptr && this->Internal->ApplyFrameOptions() != ftkError::FTK_OK)
+  {
+    return ERROR_CANNOT_INITIALIZE_FRAME;
+  }
+  return SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 AtracsysTracker::ATRACSYS_RESULT AtracsysTracker::LoadMarkerGeometryFromFile(std::string filePath, int& geometryId)
 {
@@ -688,6 +717,11 @@ std::string AtracsysTracker::ResultToString(AtracsysTracker::ATRACSYS_RESULT res
 //----------------------------------------------------------------------------
 AtracsysTracker::ATRACSYS_RESULT AtracsysTracker::GetFiducialsInFrame(std::vector<Fiducial3D>& fiducials)
 {
+  if (!this->Internal->RetrieveFiducials)
+  {
+    return ERROR_FIDUCIALS_NOT_RETRIEVED;
+  }
+
   ftkError err = ftkGetLastFrame(this->Internal->FtkLib, this->Internal->TrackerSN, this->Internal->Frame, 20);
   if (err != ftkError::FTK_OK)
   {
@@ -732,6 +766,12 @@ AtracsysTracker::ATRACSYS_RESULT AtracsysTracker::GetMarkersInFrame(std::vector<
     return ERROR_NO_FRAME_AVAILABLE;
   }
 
+  // overflow has to be checked first, otherwise it is reported as an invalid frame
+  if (this->Internal->Frame->markersStat == ftkQueryStatus::QS_ERR_OVERFLOW)
+  {
+    return ERROR_TOO_MANY_MARKERS;
+  }
+
   switch (this->Internal->Frame->markersStat)
   {
   case ftkQueryStatus::QS_WAR_SKIPPED:
@@ -744,30 +784,28 @@ AtracsysTracker::ATRACSYS_RESULT AtracsysTracker::GetMarkersInFrame(std::vector<
     return ERROR_INVALID_FRAME;
   }
 
-  if (this->Internal->Frame->markersStat == ftkQueryStatus::QS_ERR_OVERFLOW)
-  {
-    return ERROR_TOO_MANY_MARKERS;
-  }
-
-  // make sure markers vector is empty before populating
-  markers.clear();
+  // reuse the existing markers, new markers are only created if there are more markers than in previous frames
+  markers.resize(this->Internal->Frame->markersCount);
 
   for (size_t m = 0; m < this->Internal->Frame->markersCount; m++)
   {
-    ftkMarker& marker = this->Internal->Frame->markers[m];
-    vtkNew<vtkMatrix4x4> toolToTracker;
-
+    const ftkMarker& marker = this->Internal->Frame->markers[m];
+    Marker& atracsysMarker = markers[m];
+    atracsysMarker.GeometryId = (int)marker.geometryId;
+    atracsysMarker.GeometryPresenceMask = marker.geometryPresenceMask;
+    atracsysMarker.RegistrationErrorMM = marker.registrationErrorMM;
+
+    // fill all elements at once, SetElement would call Modified for each element
+    double toolToTrackerElements[16] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 };
     for (int row = 0; row < 3; row++)
     {
-      toolToTracker->SetElement(row, 3, marker.translationMM[row]);
+      toolToTrackerElements[row * 4 + 3] = marker.translationMM[row];
       for (int column = 0; column < 3; column++)
       {
-        toolToTracker->SetElement(row, column, marker.rotation[row][column]);
+        toolToTrackerElements[row * 4 + column] = marker.rotation[row][column];
       }
     }
-
-    Marker atracsysMarker((int)marker.geometryId, toolToTracker.GetPointer(), marker.geometryPresenceMask, marker.registrationErrorMM);
-    markers.push_back(atracsysMarker);
+    atracsysMarker.ToolToTracker->DeepCopy(toolToTrackerElements);
   }
   return SUCCESS;
 }
@@ -50,7 +50,8 @@ public:
     ERROR_DISCONNECT_ATTEMPT_WHEN_NOT_CONNECTED,
     ERROR_CANNOT_GET_MARKER_INFO,
     ERROR_FAILED_TO_SET_STK_PROCESSING_TYPE,
-    ERROR_FAILED_TO_SET_MAX_MISSING_FIDS
+    ERROR_FAILED_TO_SET_MAX_MISSING_FIDS,
+    ERROR_FIDUCIALS_NOT_RETRIEVED
   };
 
   enum DEVICE_TYPE
@@ -85,6 +86,8 @@ public:
   // Class to hold position and metadata of a marker in the camera's field of view
   class Marker
   {
+    // GetMarkersInFrame updates the markers in place
+    friend class AtracsysTracker;
   public:
     Marker();
     /*! toolToTracker is deep copied */
@@ -109,6 +112,13 @@ public:
   /*! */
   ATRACSYS_RESULT GetDeviceType(DEVICE_TYPE& deviceType);
 
+  /*!
+    Set what the tracker sends in each frame: raw data and 3D fiducials are only retrieved if retrieveFiducials is set
+    (required by GetFiducialsInFrame), and space is reserved for maxNumberOfMarkers markers.
+    Can be called before or after Connect. By default fiducials are not retrieved and up to 16 markers are reported.
+  */
+  ATRACSYS_RESULT SetFrameOptions(bool retrieveFiducials, int maxNumberOfMarkers);
+
   /*! */
   ATRACSYS_RESULT LoadMarkerGeometryFromFile(std::string filePath, int& geometryId);
 
@@ -124,7 +134,10 @@ public:
   /*! */
   ATRACSYS_RESULT GetFiducialsInFrame(std::vector<Fiducial3D>& fiducials);
 
-  /*! */
+  /*!
+    Get the markers of the last frame. The existing elements of the vector are updated in place, so the
+    markers (and their matrices) are not reallocated in every frame if the same vector is passed each time.
+  */
   ATRACSYS_RESULT GetMarkersInFrame(std::vector<Marker>& markers);
 
   /*! */
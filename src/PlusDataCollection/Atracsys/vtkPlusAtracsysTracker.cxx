@@ -19,6 +19,8 @@ See License.txt for details.
 #include <vtkSmartPointer.h>
 
 // System includes
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <iostream>
 #include <map>
@@ -36,6 +38,9 @@ See License.txt for details.
 #define ATR_SUCCESS AtracsysTracker::ATRACSYS_RESULT::SUCCESS
 typedef AtracsysTracker::ATRACSYS_RESULT ATRACSYS_RESULT;
 
+// space is reserved in each frame for at least this many markers
+static const int MINIMUM_NUMBER_OF_MARKERS_IN_FRAME = 16;
+
 vtkStandardNewMacro(vtkPlusAtracsysTracker);
 
 //----------------------------------------------------------------------------
@@ -79,6 +84,44 @@ public:
 
   // type of tracker connected
   AtracsysTracker::DEVICE_TYPE DeviceType = AtracsysTracker::UNKNOWN_DEVICE;
+
+  // markers of the last frame, reused in every frame
+  std::vector<AtracsysTracker::Marker> Markers;
+
+  // one item for each tool, reused in every frame, all tools are added to the buffers in one batch
+  ToolTimeStampedItemList ToolItems;
+  std::vector<bool> ToolItemEnabled;
+  std::map<int, size_t> GeometryIdToToolItemIndex;
+  vtkNew<vtkMatrix4x4> EmptyTransform;
+
+  // set when tools are added, enabled or disabled, the tool items are rebuilt in the next update
+  std::atomic<bool> ToolItemsModified{ true };
+
+  //----------------------------------------------------------------------------
+  void UpdateToolItems()
+  {
+    this->ToolItemsModified = false;
+    this->ToolItems.clear();
+    this->ToolItemEnabled.clear();
+    this->GeometryIdToToolItemIndex.clear();
+    std::map<int, std::string>::iterator it;
+    for (it = this->FtkGeometryIdMappedToToolId.begin(); it != this->FtkGeometryIdMappedToToolId.end(); it++)
+    {
+      igsioTransformName toolTransformName(it->second, this->External->GetToolReferenceFrameName());
+      this->GeometryIdToToolItemIndex[it->first] = this->ToolItems.size();
+      this->ToolItems.push_back(ToolTimeStampedItem(toolTransformName.GetTransformName(), this->EmptyTransform.GetPointer(), TOOL_OUT_OF_VIEW, 0));
+      this->ToolItemEnabled.push_back(
+        std::find(this->External->DisabledToolIds.begin(), this->External->DisabledToolIds.end(), it->second) == this->External->DisabledToolIds.end());
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  ATRACSYS_RESULT SetFrameOptions()
+  {
+    // fiducials are not used by the device, only the markers are retrieved
+    const int numberOfMarkers = std::max(MINIMUM_NUMBER_OF_MARKERS_IN_FRAME, static_cast<int>(this->FtkGeometryIdMappedToToolId.size()));
+    return this->Tracker.SetFrameOptions(false, numberOfMarkers);
+  }
 };
 
 //----------------------------------------------------------------------------
@@ -271,6 +314,13 @@ PlusStatus vtkPlusAtracsysTracker::InternalConnect()
     std::pair<int, std::string> newTool(geometryId, it->first);
     this->Internal->FtkGeometryIdMappedToToolId.insert(newTool);
   }
+  this->Internal->ToolItemsModified = true;
+
+  if ((result = this->Internal->SetFrameOptions()) != ATR_SUCCESS)
+  {
+    LOG_ERROR(this->Internal->Tracker.ResultToString(result));
+    return PLUS_FAIL;
+  }
 
   if ((result = this->Internal->Tracker.SetMaxMissingFiducials(this->Internal->MaxMissingFiducials)) != ATR_SUCCESS)
   {
@@ -346,9 +396,7 @@ PlusStatus vtkPlusAtracsysTracker::InternalUpdate()
   LOG_TRACE("vtkPlusAtracsysTracker::InternalUpdate");
   const double unfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
 
-  std::vector<AtracsysTracker::Marker> markers;
-
-  ATRACSYS_RESULT result = result = this->Internal->Tracker.GetMarkersInFrame(markers);
+  ATRACSYS_RESULT result = this->Internal->Tracker.GetMarkersInFrame(this->Internal->Markers);
   if (result == AtracsysTracker::ATRACSYS_RESULT::ERROR_NO_FRAME_AVAILABLE)
   {
     // waiting for frame
@@ -360,50 +408,48 @@ PlusStatus vtkPlusAtracsysTracker::InternalUpdate()
     return PLUS_FAIL;
   }
 
-  std::map<int, std::string>::iterator it;
-  for (it = this->Internal->FtkGeometryIdMappedToToolId.begin(); it != this->Internal->FtkGeometryIdMappedToToolId.end(); it++)
+  if (this->Internal->ToolItemsModified)
   {
-    if (std::find(this->DisabledToolIds.begin(), this->DisabledToolIds.end(), it->second) != this->DisabledToolIds.end())
+    this->Internal->UpdateToolItems();
+  }
+
+  // all tools are measured in the same frame, so they are added to the buffers in one batch,
+  // tools that are disabled or not seen in this frame are out of view
+  ToolTimeStampedItemList& toolItems = this->Internal->ToolItems;
+  for (ToolTimeStampedItemList::iterator itemIt = toolItems.begin(); itemIt != toolItems.end(); ++itemIt)
+  {
+    itemIt->Matrix = this->Internal->EmptyTransform.GetPointer();
+    itemIt->Status = TOOL_OUT_OF_VIEW;
+    itemIt->FrameNumber = this->FrameNumber;
+  }
+
+  std::vector<AtracsysTracker::Marker>::iterator mit;
+  for (mit = this->Internal->Markers.begin(); mit != this->Internal->Markers.end(); mit++)
+  {
+    std::map<int, size_t>::const_iterator toolIt = this->Internal->GeometryIdToToolItemIndex.find(mit->GetGeometryID());
+    if (toolIt == this->Internal->GeometryIdToToolItemIndex.end() || !this->Internal->ToolItemEnabled[toolIt->second])
     {
-      // tracking of this tool has been disabled
-      vtkNew<vtkMatrix4x4> emptyTransform;
-      igsioTransformName toolTransformName(it->second, this->GetToolReferenceFrameName());
-      std::string toolSourceId = toolTransformName.GetTransformName();
-      ToolTimeStampedUpdate(toolSourceId, emptyTransform.GetPointer(), TOOL_OUT_OF_VIEW, this->FrameNumber, unfilteredTimestamp);
+      // unknown marker or tracking of this tool has been disabled
       continue;
     }
-    bool toolUpdated = false;
-
-    std::vector<AtracsysTracker::Marker>::iterator mit;
-    for (mit = markers.begin(); mit != markers.end(); mit++)
+    ToolTimeStampedItem& toolItem = toolItems[toolIt->second];
+    if (toolItem.Status == TOOL_OK)
     {
-      if (it->first != mit->GetGeometryID())
-      {
-        continue;
-      }
-      // check if tool marker registration falls above maximum
-      if (mit->GetFiducialRegistrationErrorMm() > this->Internal->MaxMeanRegistrationErrorMm)
-      {
-        LOG_WARNING("Maximum mean marker fiducial registration error exceeded for tool: " << it->second);
-        continue;
-      }
-
-      // tool is seen with acceptable registration error
-      toolUpdated = true;
-      igsioTransformName toolTransformName(it->second, this->GetToolReferenceFrameName());
-      std::string toolSourceId = toolTransformName.GetTransformName();
-      ToolTimeStampedUpdate(toolSourceId, mit->GetTransformToTracker(), TOOL_OK, this->FrameNumber, unfilteredTimestamp);
+      // tool is already seen in this frame
+      continue;
     }
-
-    if (!toolUpdated)
+    // check if tool marker registration falls above maximum
+    if (mit->GetFiducialRegistrationErrorMm() > this->Internal->MaxMeanRegistrationErrorMm)
     {
-      // tool is not seen in this frame
-      vtkNew<vtkMatrix4x4> emptyTransform;
-      igsioTransformName toolTransformName(it->second, this->GetToolReferenceFrameName());
-      std::string toolSourceId = toolTransformName.GetTransformName();
-      ToolTimeStampedUpdate(toolSourceId, emptyTransform.GetPointer(), TOOL_OUT_OF_VIEW, this->FrameNumber, unfilteredTimestamp);
+      LOG_WARNING("Maximum mean marker fiducial registration error exceeded for tool: " << this->Internal->FtkGeometryIdMappedToToolId[mit->GetGeometryID()]);
+      continue;
     }
+
+    // tool is seen with acceptable registration error
+    toolItem.Matrix = mit->GetTransformToTracker();
+    toolItem.Status = TOOL_OK;
   }
+  this->AddTimeStampedItems(toolItems, unfilteredTimestamp);
 
   this->FrameNumber++;
  
@@ -441,6 +487,7 @@ PlusStatus vtkPlusAtracsysTracker::SetToolEnabled(std::string toolId, bool enabl
   {
     // remove any occurances of ToolId in DisabledToolIds
     this->DisabledToolIds.erase(std::remove(this->DisabledToolIds.begin(), this->DisabledToolIds.end(), toolId), this->DisabledToolIds.end());
+    this->Internal->ToolItemsModified = true;
     return PLUS_SUCCESS;
   }
 
@@ -463,6 +510,7 @@ PlusStatus vtkPlusAtracsysTracker::SetToolEnabled(std::string toolId, bool enabl
   }
   
   this->DisabledToolIds.push_back(toolId);
+  this->Internal->ToolItemsModified = true;
   return PLUS_SUCCESS;
 }
 
@@ -517,6 +565,12 @@ PlusStatus vtkPlusAtracsysTracker::AddToolGeometry(std::string toolId, std::stri
   // register this tool internally
   std::pair<int, std::string> newTool(geometryId, toolId);
   this->Internal->FtkGeometryIdMappedToToolId.insert(newTool);
+  this->Internal->ToolItemsModified = true;
+
+  if ((result = this->Internal->SetFrameOptions()) != ATR_SUCCESS)
+  {
+    LOG_WARNING(this->Internal->Tracker.ResultToString(result));
+  }
 
   return PLUS_SUCCESS;
 }
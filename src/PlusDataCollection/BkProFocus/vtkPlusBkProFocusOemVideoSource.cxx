@@ -28,9 +28,13 @@ See License.txt for details.
 #include <vtkPNGPrivate.h>
 
 // STL includes
+#include <algorithm>
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
 #include <ostream>
 #include <string>
+#include <thread>
 
 // System includes
 #include <stdint.h>
@@ -45,6 +49,25 @@ const char* vtkPlusBkProFocusOemVideoSource::KEY_GAIN = "Gain";
 
 vtkStandardNewMacro(vtkPlusBkProFocusOemVideoSource);
 
+struct vtkPlusBkProFocusOemVideoSource::ReceivedImage
+{
+  ReceivedImage()
+    : SpacingX(1.0)
+    , SpacingY(1.0)
+    , ReceiveTime(UNDEFINED_TIMESTAMP)
+  {
+    this->UltrasoundWindowSize[0] = 0;
+    this->UltrasoundWindowSize[1] = 0;
+  }
+
+  std::vector<char> OemMessage;
+  igsioFieldMapType FrameFields;
+  std::array<unsigned int, 2> UltrasoundWindowSize;
+  double SpacingX;
+  double SpacingY;
+  double ReceiveTime;
+};
+
 class vtkPlusBkProFocusOemVideoSource::vtkInternal
 {
 public:
@@ -61,11 +84,32 @@ public:
   std::vector<unsigned char> DecodingBuffer;
   // Data buffer to hold temporary data during decoding (pointers to image lines), it's a member variable to avoid memory allocation at each frame receiving
   std::vector<png_bytep> DecodingLineBuffer;
-
+  // Raw message read from the socket, it's a member variable to avoid memory allocation at each message receiving
+  std::vector<char> RawMessage;
+
+  // Image that is decoded in the device thread if the decoding thread is not used
+  ReceivedImage SynchronousImage;
+
+  // Ring of received images waiting for decoding. The first NumberOfQueuedImages slots from FirstQueuedImageIndex are in use,
+  // including the one that is being decoded.
+  std::vector<ReceivedImage> QueuedImages;
+  unsigned int FirstQueuedImageIndex;
+  unsigned int NumberOfQueuedImages;
+  unsigned int NumberOfDroppedImages;
+  bool DecodingThreadRunning;
+  bool DecodingThreadStopRequested;
+  std::mutex QueuedImagesMutex;
+  std::condition_variable QueuedImagesCondition;
+  std::thread DecodingThread;
 
   vtkInternal(vtkPlusBkProFocusOemVideoSource* external)
     : External(external)
     , Channel(NULL)
+    , FirstQueuedImageIndex(0)
+    , NumberOfQueuedImages(0)
+    , NumberOfDroppedImages(0)
+    , DecodingThreadRunning(false)
+    , DecodingThreadStopRequested(false)
   {
     this->DecodedImageFrame = vtkImageData::New();
   }
@@ -95,6 +139,8 @@ vtkPlusBkProFocusOemVideoSource::vtkPlusBkProFocusOemVideoSource()
   this->ColorEnabled = false;
   this->OfflineTesting = false;
   this->OfflineTestingFilePath = NULL;
+  this->DecodingThreadEnabled = false;
+  this->DecodingQueueSize = 4;
   this->StartLineX_m = 0;
   this->StartLineY_m = 0;
   this->StartLineAngle_rad = 0;
@@ -132,6 +178,7 @@ vtkPlusBkProFocusOemVideoSource::~vtkPlusBkProFocusOemVideoSource()
   {
     this->Disconnect();
   }
+  this->StopDecodingThread();
 
   delete this->Internal;
   this->Internal = NULL;
@@ -143,7 +190,13 @@ vtkPlusBkProFocusOemVideoSource::~vtkPlusBkProFocusOemVideoSource()
 void vtkPlusBkProFocusOemVideoSource::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
-
+  os << indent << "DecodingThreadEnabled: " << (this->DecodingThreadEnabled ? "TRUE" : "FALSE") << std::endl;
+  if (this->DecodingThreadEnabled)
+  {
+    std::lock_guard<std::mutex> lock(this->Internal->QueuedImagesMutex);
+    os << indent << "DecodingQueueSize: " << this->DecodingQueueSize << std::endl;
+    os << indent << "NumberOfDroppedImages: " << this->Internal->NumberOfDroppedImages << std::endl;
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -283,15 +336,132 @@ PlusStatus vtkPlusBkProFocusOemVideoSource::InternalDisconnect()
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusBkProFocusOemVideoSource::InternalStartRecording()
 {
+  if (this->DecodingThreadEnabled && !this->OfflineTesting)
+  {
+    return this->StartDecodingThread();
+  }
   return PLUS_SUCCESS;
 }
 
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusBkProFocusOemVideoSource::InternalStopRecording()
 {
+  this->StopDecodingThread();
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBkProFocusOemVideoSource::StartDecodingThread()
+{
+  this->StopDecodingThread();
+
+  std::lock_guard<std::mutex> lock(this->Internal->QueuedImagesMutex);
+  this->Internal->QueuedImages.resize(std::max(this->DecodingQueueSize, 1));
+  this->Internal->FirstQueuedImageIndex = 0;
+  this->Internal->NumberOfQueuedImages = 0;
+  this->Internal->NumberOfDroppedImages = 0;
+  this->Internal->DecodingThreadStopRequested = false;
+  this->Internal->DecodingThreadRunning = true;
+  this->Internal->DecodingThread = std::thread(&vtkPlusBkProFocusOemVideoSource::DecodeQueuedImages, this);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBkProFocusOemVideoSource::StopDecodingThread()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->Internal->QueuedImagesMutex);
+    if (!this->Internal->DecodingThreadRunning)
+    {
+      return;
+    }
+    this->Internal->DecodingThreadStopRequested = true;
+  }
+  this->Internal->QueuedImagesCondition.notify_all();
+  this->Internal->DecodingThread.join();
+
+  std::lock_guard<std::mutex> lock(this->Internal->QueuedImagesMutex);
+  this->Internal->DecodingThreadRunning = false;
+  if (this->Internal->NumberOfDroppedImages > 0)
+  {
+    LOG_WARNING(this->Internal->NumberOfDroppedImages << " received images were dropped because the decoding could not keep up with receiving in device " << this->GetDeviceId());
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBkProFocusOemVideoSource::DecodeQueuedImages()
+{
+  while (true)
+  {
+    ReceivedImage* image = NULL;
+    {
+      std::unique_lock<std::mutex> lock(this->Internal->QueuedImagesMutex);
+      while (!this->Internal->DecodingThreadStopRequested && this->Internal->NumberOfQueuedImages == 0)
+      {
+        this->Internal->QueuedImagesCondition.wait(lock);
+      }
+      if (this->Internal->NumberOfQueuedImages == 0)
+      {
+        // Stop is requested and all queued images are decoded
+        return;
+      }
+      image = &this->Internal->QueuedImages[this->Internal->FirstQueuedImageIndex];
+    }
+
+    // The slot is not reused by the reader until it is released below
+    this->DecodeAndAddImage(*image);
+
+    std::lock_guard<std::mutex> lock(this->Internal->QueuedImagesMutex);
+    this->Internal->FirstQueuedImageIndex = (this->Internal->FirstQueuedImageIndex + 1) % this->Internal->QueuedImages.size();
+    this->Internal->NumberOfQueuedImages--;
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBkProFocusOemVideoSource::TakeReceivedImage(ReceivedImage& image)
+{
+  // Swapping passes the received message to the slot and keeps the previous buffer of the slot for receiving the next message
+  std::swap(image.OemMessage, this->Internal->OemMessage);
+  image.FrameFields = this->FrameFields;
+  image.UltrasoundWindowSize = this->UltrasoundWindowSize;
+  image.SpacingX = this->GetSpacingX();
+  image.SpacingY = this->GetSpacingY();
+  image.ReceiveTime = vtkIGSIOAccurateTimer::GetSystemTime();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBkProFocusOemVideoSource::QueueReceivedImage()
+{
+  bool queued(false);
+  {
+    std::lock_guard<std::mutex> lock(this->Internal->QueuedImagesMutex);
+    if (this->Internal->DecodingThreadRunning)
+    {
+      if (this->Internal->NumberOfQueuedImages >= this->Internal->QueuedImages.size())
+      {
+        this->Internal->NumberOfDroppedImages++;
+        LOG_DEBUG("Decoding queue is full, received image is dropped in device " << this->GetDeviceId());
+        return PLUS_SUCCESS;
+      }
+      unsigned int index = (this->Internal->FirstQueuedImageIndex + this->Internal->NumberOfQueuedImages) % this->Internal->QueuedImages.size();
+      this->TakeReceivedImage(this->Internal->QueuedImages[index]);
+      this->Internal->NumberOfQueuedImages++;
+      queued = true;
+    }
+    else
+    {
+      this->TakeReceivedImage(this->Internal->SynchronousImage);
+    }
+  }
+
+  if (queued)
+  {
+    this->Internal->QueuedImagesCondition.notify_one();
+    return PLUS_SUCCESS;
+  }
+  return this->DecodeAndAddImage(this->Internal->SynchronousImage);
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusBkProFocusOemVideoSource::InternalUpdate()
 {
@@ -301,9 +471,6 @@ PlusStatus vtkPlusBkProFocusOemVideoSource::InternalUpdate()
     return PLUS_SUCCESS;
   }
 
-  unsigned char* uncompressedPixelBuffer = 0;
-  unsigned int uncompressedPixelBufferSize = 0;
-  int numBytesProcessed = 0;
   if (!this->OfflineTesting)
   {
     if (!this->ContinuousStreamingEnabled)
@@ -320,14 +487,36 @@ PlusStatus vtkPlusBkProFocusOemVideoSource::InternalUpdate()
     {
       return PLUS_FAIL;
     }
-    size_t numBytesReceived = this->Internal->OemMessage.size();
+  }
+
+  // The parameters are stored with the image, as the messages received after the image may change them before it is decoded
+  this->AddParametersToFrameFields();
+
+  return this->QueueReceivedImage();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBkProFocusOemVideoSource::DecodeAndAddImage(ReceivedImage& image)
+{
+  unsigned char* uncompressedPixelBuffer = 0;
+  unsigned int uncompressedPixelBufferSize = 0;
+  int numBytesProcessed = 0;
+  std::vector<char>& oemMessage = image.OemMessage;
+  if (!this->OfflineTesting)
+  {
+    size_t numBytesReceived = oemMessage.size();
 
     // First detect the #
-    for (numBytesProcessed = 0; this->Internal->OemMessage[numBytesProcessed] != '#' && numBytesProcessed < numBytesReceived; numBytesProcessed++)
+    for (numBytesProcessed = 0; numBytesProcessed < numBytesReceived && oemMessage[numBytesProcessed] != '#'; numBytesProcessed++)
       ;
     numBytesProcessed++;
+    if (numBytesProcessed >= numBytesReceived)
+    {
+      LOG_ERROR("Failed to read image from BK OEM interface");
+      return PLUS_FAIL;
+    }
 
-    int numChars = (int)this->Internal->OemMessage[numBytesProcessed] - (int)('0');
+    int numChars = (int)oemMessage[numBytesProcessed] - (int)('0');
     numBytesProcessed++;
     LOG_TRACE("Number of bytes in the image size: " << numChars); // 7 or 6
     if (numChars == 0)
@@ -338,11 +527,11 @@ PlusStatus vtkPlusBkProFocusOemVideoSource::InternalUpdate()
 
     for (int k = 0; k < numChars; k++, numBytesProcessed++)
     {
-      uncompressedPixelBufferSize = uncompressedPixelBufferSize * 10 + ((int)this->Internal->OemMessage[numBytesProcessed] - '0');
+      uncompressedPixelBufferSize = uncompressedPixelBufferSize * 10 + ((int)oemMessage[numBytesProcessed] - '0');
     }
     LOG_TRACE("uncompressedPixelBufferSize = " << uncompressedPixelBufferSize);
 
-    uncompressedPixelBuffer = (unsigned char*) & (this->Internal->OemMessage[numBytesProcessed]);
+    uncompressedPixelBuffer = (unsigned char*) & (oemMessage[numBytesProcessed]);
 
     if (this->ContinuousStreamingEnabled)
     {
@@ -350,7 +539,7 @@ PlusStatus vtkPlusBkProFocusOemVideoSource::InternalUpdate()
       char timeStamp[TIMESTAMP_SIZE];
       for (int k = 0; k < TIMESTAMP_SIZE; k++, numBytesProcessed++)
       {
-        timeStamp[k] = this->Internal->OemMessage[numBytesProcessed];
+        timeStamp[k] = oemMessage[numBytesProcessed];
       }
       // Seems this is NOT correct, but the format is NOT described in the manual
       unsigned int _timestamp = *(int*)timeStamp;
@@ -360,21 +549,21 @@ PlusStatus vtkPlusBkProFocusOemVideoSource::InternalUpdate()
 
   if (!this->OfflineTesting && this->ContinuousStreamingEnabled)
   {
-    this->Internal->DecodedImageFrame->SetExtent(0, this->UltrasoundWindowSize[0] - 1, 0, this->UltrasoundWindowSize[1] - 1, 0, 0);
+    this->Internal->DecodedImageFrame->SetExtent(0, image.UltrasoundWindowSize[0] - 1, 0, image.UltrasoundWindowSize[1] - 1, 0, 0);
 
-    if (uncompressedPixelBufferSize > (this->UltrasoundWindowSize[0] * this->UltrasoundWindowSize[1] + TIMESTAMP_SIZE))
+    if (uncompressedPixelBufferSize > (image.UltrasoundWindowSize[0] * image.UltrasoundWindowSize[1] + TIMESTAMP_SIZE))
     {
       // we received color image
       this->Internal->DecodedImageFrame->AllocateScalars(VTK_UNSIGNED_CHAR, 3);
-      PlusStatus status = PixelCodec::ConvertToBmp24(PixelCodec::ComponentOrder_RGB, PixelCodec::PixelEncoding_BGR24, this->UltrasoundWindowSize[0], this->UltrasoundWindowSize[1],
-        (unsigned char*) & (this->Internal->OemMessage[numBytesProcessed]),
+      PlusStatus status = PixelCodec::ConvertToBmp24(PixelCodec::ComponentOrder_RGB, PixelCodec::PixelEncoding_BGR24, image.UltrasoundWindowSize[0], image.UltrasoundWindowSize[1],
+        (unsigned char*) & (oemMessage[numBytesProcessed]),
         (unsigned char*)this->Internal->DecodedImageFrame->GetScalarPointer());
     }
     else
     {
       this->Internal->DecodedImageFrame->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
       std::memcpy(this->Internal->DecodedImageFrame->GetScalarPointer(),
-        (void*) & (this->Internal->OemMessage[numBytesProcessed]),
+        (void*) & (oemMessage[numBytesProcessed]),
         uncompressedPixelBufferSize);
       LOG_TRACE(uncompressedPixelBufferSize << " bytes copied, start at " << numBytesProcessed); // 29
     }
@@ -395,6 +584,7 @@ PlusStatus vtkPlusBkProFocusOemVideoSource::InternalUpdate()
     LOG_ERROR("Unable to retrieve the video source in the BKProFocusOem device on channel " << this->Internal->Channel->GetChannelId());
     return PLUS_FAIL;
   }
+
   // If the buffer is empty, set the pixel type and frame size to the first received properties
   if (aSource->GetNumberOfItems() == 0)
   {
@@ -426,10 +616,10 @@ PlusStatus vtkPlusBkProFocusOemVideoSource::InternalUpdate()
 
   double spacingZ_mm = 1.0;
   //TODO: Send spacing with image
-  this->Internal->DecodedImageFrame->SetSpacing(GetSpacingX(), GetSpacingY(), spacingZ_mm);//Spacing is not being sent to IGTLink?
+  this->Internal->DecodedImageFrame->SetSpacing(image.SpacingX, image.SpacingY, spacingZ_mm);//Spacing is not being sent to IGTLink?
 
-  this->AddParametersToFrameFields();
-  if (aSource->AddItem(this->Internal->DecodedImageFrame, aSource->GetInputImageOrientation(), aSource->GetImageType(), this->FrameNumber, UNDEFINED_TIMESTAMP, UNDEFINED_TIMESTAMP, &this->FrameFields) != PLUS_SUCCESS)
+  // The receive time is used as timestamp, so that the decoding delay does not add to it
+  if (aSource->AddItem(this->Internal->DecodedImageFrame, aSource->GetInputImageOrientation(), aSource->GetImageType(), this->FrameNumber, image.ReceiveTime, UNDEFINED_TIMESTAMP, &image.FrameFields) != PLUS_SUCCESS)
   {
     LOG_ERROR("Error adding item to video source " << aSource->GetSourceId() << " on channel " << this->Internal->Channel->GetChannelId());
     return PLUS_FAIL;
@@ -451,10 +641,16 @@ PlusStatus vtkPlusBkProFocusOemVideoSource::ProcessMessagesAndReadNextImage()
       return PLUS_FAIL;
     }
 
+    // Image messages are detected from the message name, without copying the image data into a string
+    std::vector<char>::const_iterator messageNameEnd = std::find(this->Internal->OemMessage.begin(), this->Internal->OemMessage.end(), ' ');
+    std::string messageString(this->Internal->OemMessage.begin(), messageNameEnd);
+    if (messageString.compare("DATA:CAPTURE_IMAGE") == 0 || messageString.compare("DATA:GRAB_FRAME") == 0)
+    {
+      return PLUS_SUCCESS;
+    }
+
     std::string fullMessage = this->ReadBufferIntoString();
     std::istringstream replyStream(fullMessage);
-
-    std::string messageString;
     std::getline(replyStream, messageString, ' ');
 
     std::istringstream messageStream(messageString);
@@ -467,16 +663,8 @@ PlusStatus vtkPlusBkProFocusOemVideoSource::ProcessMessagesAndReadNextImage()
 
     LOG_DEBUG("Process message from BK: " << fullMessage);
 
-    if (messageString.compare("DATA:CAPTURE_IMAGE") == 0)
-    {
-      return PLUS_SUCCESS;
-    }
-    else if (messageString.compare("DATA:GRAB_FRAME") == 0)
-    {
-      return PLUS_SUCCESS;
-    }
     //Handle both replies to queries (DATA) and subscribed data (SDATA)
-    else if ((messageType.compare("DATA") == 0) || (messageType.compare("SDATA") == 0))
+    if ((messageType.compare("DATA") == 0) || (messageType.compare("SDATA") == 0))
     {
       if (messageName.compare("US_WIN_SIZE") == 0)
       {
@@ -548,7 +736,9 @@ std::string vtkPlusBkProFocusOemVideoSource::ReadBufferIntoString()
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusBkProFocusOemVideoSource::ReadNextMessage()
 {
-  std::vector<char> rawMessage;
+  // The raw message buffer keeps its memory between messages, so large images do not require allocation
+  std::vector<char>& rawMessage = this->Internal->RawMessage;
+  rawMessage.clear();
   char character(0);
   unsigned totalBytes = 0;
   int receivedBytes = 1;
@@ -613,7 +803,7 @@ PlusStatus vtkPlusBkProFocusOemVideoSource::ReadNextMessage()
       }
     }//if
   }//while
-  this->Internal->OemMessage = removeSpecialCharacters(rawMessage);
+  this->RemoveSpecialCharacters(rawMessage, this->Internal->OemMessage);
 
   if (receivedBytes < 1)
   {
@@ -645,23 +835,22 @@ int vtkPlusBkProFocusOemVideoSource::addAdditionalBinaryDataToImageUntilEOTReach
 }
 
 //-----------------------------------------------------------------------------
-std::vector<char> vtkPlusBkProFocusOemVideoSource::removeSpecialCharacters(std::vector<char> inMessage)
+void vtkPlusBkProFocusOemVideoSource::RemoveSpecialCharacters(const std::vector<char>& inMessage, std::vector<char>& outMessage)
 {
-  std::vector<char> retval;
+  outMessage.clear();
   unsigned int inPos = 1;//Skip starting character SOH
-  while (inPos < inMessage.size() - 1)//Skip ending character EOT
+  while (inPos + 1 < inMessage.size())//Skip ending character EOT
   {
     if ((inMessage[inPos]) != ESC)
     {
-      retval.push_back(inMessage[inPos++]);
+      outMessage.push_back(inMessage[inPos++]);
     }
     else
     {
       inPos++;
-      retval.push_back(~inMessage[inPos++]);//Character after ESC is inverted
+      outMessage.push_back(~inMessage[inPos++]);//Character after ESC is inverted
     }
   }
-  return retval;
 }
 
 //-----------------------------------------------------------------------------
@@ -1041,6 +1230,13 @@ PlusStatus vtkPlusBkProFocusOemVideoSource::ReadConfiguration(vtkXMLDataElement*
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(ColorEnabled, deviceConfig);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(OfflineTesting, deviceConfig);
   XML_READ_CSTRING_ATTRIBUTE_REQUIRED(OfflineTestingFilePath, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(DecodingThreadEnabled, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, DecodingQueueSize, deviceConfig);
+  if (this->DecodingQueueSize < 1)
+  {
+    LOG_ERROR("DecodingQueueSize must be at least 1, it is " << this->DecodingQueueSize);
+    return PLUS_FAIL;
+  }
   return PLUS_SUCCESS;
 }
 
@@ -1056,6 +1252,8 @@ PlusStatus vtkPlusBkProFocusOemVideoSource::WriteConfiguration(vtkXMLDataElement
   XML_WRITE_BOOL_ATTRIBUTE(ColorEnabled, deviceConfig);
   XML_WRITE_BOOL_ATTRIBUTE(OfflineTesting, deviceConfig);
   XML_WRITE_CSTRING_ATTRIBUTE_IF_NOT_NULL(OfflineTestingFilePath, deviceConfig);
+  XML_WRITE_BOOL_ATTRIBUTE(DecodingThreadEnabled, deviceConfig);
+  deviceConfig->SetIntAttribute("DecodingQueueSize", this->DecodingQueueSize);
   return PLUS_SUCCESS;
 }
 
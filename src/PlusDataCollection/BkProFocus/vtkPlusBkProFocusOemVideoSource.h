@@ -18,6 +18,12 @@
 
   Requires the PLUS_USE_BKPROFOCUS_VIDEO option in CMake.
 
+  If DecodingThreadEnabled is set then the device thread only reads the messages from the OEM interface and
+  puts the received images into a ring of DecodingQueueSize slots, and a separate decoding thread decodes them
+  and adds them to the buffer. So the network read of the next image overlaps with decoding the previous one.
+  The receive buffers of the slots are reused, no memory is allocated for the received images. If all slots are
+  waiting to be decoded then the received image is dropped.
+
   \ingroup PlusLibDataCollection
 */
 class vtkPlusDataCollectionExport vtkPlusBkProFocusOemVideoSource : public vtkPlusUsDevice
@@ -89,6 +95,18 @@ public:
   /*! Path to image file used for offline testing */
   vtkGetStringMacro(OfflineTestingFilePath);
 
+  /*! Enable/disable decoding the received images in a separate thread */
+  vtkSetMacro(DecodingThreadEnabled, bool);
+  /*! Enable/disable decoding the received images in a separate thread */
+  vtkGetMacro(DecodingThreadEnabled, bool);
+  /*! Enable/disable decoding the received images in a separate thread */
+  vtkBooleanMacro(DecodingThreadEnabled, bool);
+
+  /*! Number of received images that can wait for decoding */
+  vtkSetMacro(DecodingQueueSize, int);
+  /*! Number of received images that can wait for decoding */
+  vtkGetMacro(DecodingQueueSize, int);
+
 protected:
 
   static const char* KEY_DEPTH;
@@ -142,8 +160,30 @@ protected:
   /*! Read Next received message from BK. */
   PlusStatus ReadNextMessage();
 
-  /*! Remove special characters from the BK message (SOH, EOT and ESC). Also restore inverted characters.*/
-  std::vector<char> removeSpecialCharacters(std::vector<char> inMessage);
+  /*! An image message that is received and waits for decoding, with the parameters that were valid when it was received */
+  struct ReceivedImage;
+
+  /*! Move the last received image message and the current parameters into an image slot. The receive buffer of the slot is reused. */
+  void TakeReceivedImage(ReceivedImage& image);
+
+  /*! Put the last received image message into the decoding queue, or decode it if the decoding thread is not running */
+  PlusStatus QueueReceivedImage();
+
+  /*! Decode an image message and add the image to the buffer */
+  PlusStatus DecodeAndAddImage(ReceivedImage& image);
+
+  /*! Start/stop the thread that decodes the queued images. Stopping decodes the images that are already queued. */
+  PlusStatus StartDecodingThread();
+  void StopDecodingThread();
+
+  /*! Decode the queued images until stop is requested. Runs in the decoding thread. */
+  void DecodeQueuedImages();
+
+  /*!
+    Remove special characters from the BK message (SOH, EOT and ESC). Also restore inverted characters.
+    The result is written into outMessage to reuse its memory.
+  */
+  void RemoveSpecialCharacters(const std::vector<char>& inMessage, std::vector<char>& outMessage);
 
   /*! Add additional binary data to the image.
    * Tested on a BK5000 scanner:
@@ -287,6 +327,12 @@ protected:
   /*! Path to test image sent when OfflineTesting is turned on. */
   char* OfflineTestingFilePath;
 
+  /*! Decode the received images in a separate thread */
+  bool DecodingThreadEnabled;
+
+  /*! Number of received images that can wait for decoding */
+  int DecodingQueueSize;
+
   // For internal storage of additional variables (to minimize the number of included headers)
   class vtkInternal;
   vtkInternal* Internal;
@@ -9,17 +9,19 @@ See License.txt for details.
 // Local includes
 #include "PlusOutputVideoFrame.h"
 #include "vtkIGSIOAccurateTimer.h"
+#include "vtkPlusBuffer.h"
 #include "vtkPlusDataSource.h"
 #include "vtkPlusDeckLinkVideoSource.h"
 
 // VTK includes
-#include <vtkImageAppendComponents.h>
-#include <vtkImageExtractComponents.h>
-#include <vtkImageImport.h>
 #include <vtkObject.h>
 
 // System includes
+#include <condition_variable>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 // DeckLink SDK includes
 #include "DeckLinkAPIWrapper.h"
@@ -57,14 +59,29 @@ public:
 
   PlusOutputVideoFrame*     OutputFrame = nullptr;
 
-  vtkSmartPointer<vtkImageImport> ImageImport;
-  vtkSmartPointer<vtkImageExtractComponents> BlueComponent;
-  vtkSmartPointer<vtkImageExtractComponents> GreenComponent;
-  vtkSmartPointer<vtkImageExtractComponents> RedComponent;
-  vtkSmartPointer<vtkImageAppendComponents> AppendComponent;
+  // RGB frame, used if the frame cannot be written directly into the buffer
+  std::vector<unsigned char> RgbFrame;
 
   std::atomic_bool          COMInitialized = false;
 
+  // Ring of captured frames waiting for conversion, a reference is held to each queued frame.
+  // The first NumberOfQueuedFrames slots from FirstQueuedFrameIndex are in use, including the one that is being converted.
+  struct QueuedFrame
+  {
+    IDeckLinkVideoInputFrame* Frame = nullptr;
+    double                    ArrivalTime = 0.0;
+  };
+  unsigned int              FrameQueueSize = 4;
+  std::vector<QueuedFrame>  QueuedFrames;
+  unsigned int              FirstQueuedFrameIndex = 0;
+  unsigned int              NumberOfQueuedFrames = 0;
+  unsigned int              NumberOfDroppedFrames = 0;
+  bool                      ConversionThreadRunning = false;
+  bool                      ConversionThreadStopRequested = false;
+  std::mutex                QueuedFramesMutex;
+  std::condition_variable   QueuedFramesCondition;
+  std::thread               ConversionThread;
+
 private:
   static vtkPlusDeckLinkVideoSource::vtkInternal* New();
   vtkInternal() : External(nullptr) {}
@@ -97,6 +114,18 @@ namespace
     return true;
   }
 
+  //----------------------------------------------------------------------------
+  // Convert BGRA pixels to RGB in a single pass. The loop has no dependencies between pixels, so it is vectorized by the compiler.
+  void ConvertBgraToRgb(const unsigned char* bgra, unsigned char* rgb, size_t numberOfPixels)
+  {
+    for (size_t i = 0; i < numberOfPixels; ++i, bgra += 4, rgb += 3)
+    {
+      rgb[0] = bgra[2];
+      rgb[1] = bgra[1];
+      rgb[2] = bgra[0];
+    }
+  }
+
   //----------------------------------------------------------------------------
   void ShutdownCOM(std::atomic_bool& comInit)
   {
@@ -120,11 +149,6 @@ vtkPlusDeckLinkVideoSource::vtkPlusDeckLinkVideoSource::vtkInternal* vtkPlusDeck
   vtkPlusDeckLinkVideoSource::vtkInternal* result = new vtkPlusDeckLinkVideoSource::vtkInternal();
   result->InitializeObjectBase();
   result->External = _arg;
-  result->ImageImport = vtkSmartPointer<vtkImageImport>::New();
-  result->BlueComponent = vtkSmartPointer<vtkImageExtractComponents>::New();
-  result->GreenComponent = vtkSmartPointer<vtkImageExtractComponents>::New();
-  result->RedComponent = vtkSmartPointer<vtkImageExtractComponents>::New();
-  result->AppendComponent = vtkSmartPointer<vtkImageAppendComponents>::New();
   return result;
 }
 
@@ -145,6 +169,8 @@ vtkPlusDeckLinkVideoSource::~vtkPlusDeckLinkVideoSource()
 {
   LOG_TRACE("vtkPlusDeckLinkVideoSource::~vtkPlusDeckLinkVideoSource()");
 
+  this->StopConversionThread();
+
   if (this->Internal->DeckLinkDisplayMode != nullptr)
   {
     this->Internal->DeckLinkDisplayMode->Release();
@@ -221,6 +247,10 @@ void vtkPlusDeckLinkVideoSource::PrintSelf(ostream& os, vtkIndent indent)
 {
   LOG_TRACE("vtkPlusDeckLinkVideoSource::PrintSelf(ostream& os, vtkIndent indent)");
   Superclass::PrintSelf(os, indent);
+
+  std::lock_guard<std::mutex> lock(this->Internal->QueuedFramesMutex);
+  os << indent << "FrameQueueSize: " << this->Internal->FrameQueueSize << std::endl;
+  os << indent << "NumberOfDroppedFrames: " << this->Internal->NumberOfDroppedFrames << std::endl;
 }
 
 //----------------------------------------------------------------------------
@@ -291,6 +321,18 @@ PlusStatus vtkPlusDeckLinkVideoSource::ReadConfiguration(vtkXMLDataElement* root
     }
   }
 
+  int frameQueueSize(-1);
+  XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, FrameQueueSize, frameQueueSize, deviceConfig);
+  if (frameQueueSize != -1)
+  {
+    if (frameQueueSize < 1)
+    {
+      LOG_ERROR("FrameQueueSize must be at least 1, it is " << frameQueueSize);
+      return PLUS_FAIL;
+    }
+    this->Internal->FrameQueueSize = static_cast<unsigned int>(frameQueueSize);
+  }
+
   std::string displayMode("");
   XML_READ_STRING_ATTRIBUTE_NONMEMBER_OPTIONAL(DisplayMode, displayMode, deviceConfig);
   if (!displayMode.empty())
@@ -430,26 +472,6 @@ out:
     source->SetPixelType(VTK_UNSIGNED_CHAR);
     source->SetNumberOfScalarComponents(3);
 
-    this->Internal->ImageImport->SetDataSpacing(1, 1, 1);
-    this->Internal->ImageImport->SetDataOrigin(0, 0, 0);
-    this->Internal->ImageImport->SetWholeExtent(0, this->Internal->RequestedFrameSize[0] - 1, 0, this->Internal->RequestedFrameSize[1] - 1, 0, 0);
-    this->Internal->ImageImport->SetDataExtentToWholeExtent();
-    this->Internal->ImageImport->SetDataScalarTypeToUnsignedChar();
-    this->Internal->ImageImport->SetNumberOfScalarComponents(4);
-
-    this->Internal->BlueComponent->SetInputConnection(this->Internal->ImageImport->GetOutputPort());
-    this->Internal->BlueComponent->SetComponents(0);
-
-    this->Internal->GreenComponent->SetInputConnection(this->Internal->ImageImport->GetOutputPort());
-    this->Internal->GreenComponent->SetComponents(1);
-
-    this->Internal->RedComponent->SetInputConnection(this->Internal->ImageImport->GetOutputPort());
-    this->Internal->RedComponent->SetComponents(2);
-
-    this->Internal->AppendComponent->SetInputConnection(0, this->Internal->RedComponent->GetOutputPort());
-    this->Internal->AppendComponent->AddInputConnection(0, this->Internal->GreenComponent->GetOutputPort());
-    this->Internal->AppendComponent->AddInputConnection(0, this->Internal->BlueComponent->GetOutputPort());
-
     this->Internal->DeckLinkInput->SetCallback(this);
     this->Internal->DeckLinkInput->SetScreenPreviewCallback(nullptr);
     this->Internal->DeckLinkInput->DisableAudioInput();
@@ -522,8 +544,10 @@ PlusStatus vtkPlusDeckLinkVideoSource::InternalStartRecording()
 
   if (this->Internal->DeckLinkInput != nullptr)
   {
+    this->StartConversionThread();
     if (this->Internal->DeckLinkInput->StartStreams() != S_OK)
     {
+      this->StopConversionThread();
       return PLUS_FAIL;
     }
   }
@@ -542,7 +566,10 @@ PlusStatus vtkPlusDeckLinkVideoSource::InternalStopRecording()
 
   if (this->Internal->DeckLinkInput != nullptr)
   {
-    if (this->Internal->DeckLinkInput->StopStreams() != S_OK)
+    HRESULT result = this->Internal->DeckLinkInput->StopStreams();
+    // No more frames are queued after the streams are stopped
+    this->StopConversionThread();
+    if (result != S_OK)
     {
       return PLUS_FAIL;
     }
@@ -624,8 +651,6 @@ HRESULT STDMETHODCALLTYPE vtkPlusDeckLinkVideoSource::VideoInputFrameArrived(IDe
 
   if (videoFrame)
   {
-    this->Internal->OutputFrame->SetFlags(videoFrame->GetFlags());
-
     bool inputFrameValid = ((videoFrame->GetFlags() & bmdFrameHasNoInputSource) == 0);
 
     if (inputFrameValid && !this->Internal->PreviousFrameValid)
@@ -635,44 +660,180 @@ HRESULT STDMETHODCALLTYPE vtkPlusDeckLinkVideoSource::VideoInputFrameArrived(IDe
       this->Internal->DeckLinkInput->StartStreams();
     }
 
-    if (inputFrameValid)
+    if (inputFrameValid && this->Internal->PreviousFrameValid)
     {
-      HRESULT res = this->Internal->DeckLinkVideoConversion->ConvertFrame(videoFrame, this->Internal->OutputFrame);
-      if (res != S_OK)
+      // Only keep a reference to the frame here, it is converted in the conversion thread
+      double arrivalTime = vtkIGSIOAccurateTimer::GetSystemTime();
       {
-        LPTSTR errorMsgPtr = 0;
-        FormatMessage(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM, NULL, res, 0, (LPTSTR)&errorMsgPtr, 0, NULL);
-        LOG_ERROR("Unable to convert video frame: " << errorMsgPtr);
-        LocalFree(errorMsgPtr);
+        std::lock_guard<std::mutex> lock(this->Internal->QueuedFramesMutex);
+        if (!this->Internal->ConversionThreadRunning || this->Internal->NumberOfQueuedFrames >= this->Internal->QueuedFrames.size())
+        {
+          this->Internal->NumberOfDroppedFrames++;
+        }
+        else
+        {
+          unsigned int slotIndex = (this->Internal->FirstQueuedFrameIndex + this->Internal->NumberOfQueuedFrames) % this->Internal->QueuedFrames.size();
+          videoFrame->AddRef();
+          this->Internal->QueuedFrames[slotIndex].Frame = videoFrame;
+          this->Internal->QueuedFrames[slotIndex].ArrivalTime = arrivalTime;
+          this->Internal->NumberOfQueuedFrames++;
+        }
       }
+      this->Internal->QueuedFramesCondition.notify_one();
+    }
+
+    this->Internal->PreviousFrameValid = inputFrameValid;
+  }
+  return S_OK;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusDeckLinkVideoSource::StartConversionThread()
+{
+  std::lock_guard<std::mutex> lock(this->Internal->QueuedFramesMutex);
+  if (this->Internal->ConversionThreadRunning)
+  {
+    return;
+  }
+  this->Internal->QueuedFrames.assign(this->Internal->FrameQueueSize, vtkInternal::QueuedFrame());
+  this->Internal->FirstQueuedFrameIndex = 0;
+  this->Internal->NumberOfQueuedFrames = 0;
+  this->Internal->NumberOfDroppedFrames = 0;
+  this->Internal->ConversionThreadStopRequested = false;
+  this->Internal->ConversionThreadRunning = true;
+  this->Internal->ConversionThread = std::thread(&vtkPlusDeckLinkVideoSource::ConvertQueuedFrames, this);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusDeckLinkVideoSource::StopConversionThread()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->Internal->QueuedFramesMutex);
+    if (!this->Internal->ConversionThreadRunning)
+    {
+      return;
+    }
+    this->Internal->ConversionThreadStopRequested = true;
+  }
+  this->Internal->QueuedFramesCondition.notify_all();
+  this->Internal->ConversionThread.join();
+
+  std::lock_guard<std::mutex> lock(this->Internal->QueuedFramesMutex);
+  this->Internal->ConversionThreadRunning = false;
+  if (this->Internal->NumberOfDroppedFrames > 0)
+  {
+    LOG_WARNING(this->Internal->NumberOfDroppedFrames << " frames were dropped because the conversion could not keep up with the acquisition. Consider increasing FrameQueueSize.");
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusDeckLinkVideoSource::ConvertQueuedFrames()
+{
+  std::atomic_bool comInit(false);
+  if (!InitCOM(comInit))
+  {
+    LOG_ERROR("Unable to initialize COM in the conversion thread, captured frames are not converted.");
+  }
 
-      if (this->Internal->PreviousFrameValid && res == S_OK)
+  while (true)
+  {
+    vtkInternal::QueuedFrame queuedFrame;
+    {
+      std::unique_lock<std::mutex> lock(this->Internal->QueuedFramesMutex);
+      this->Internal->QueuedFramesCondition.wait(lock, [this]
       {
-        void* buffer;
-        if (this->Internal->OutputFrame->GetBytes(&buffer) == S_OK)
-        {
-          vtkPlusDataSource* source;
-          this->GetFirstVideoSource(source);
+        return this->Internal->ConversionThreadStopRequested || this->Internal->NumberOfQueuedFrames > 0;
+      });
+      if (this->Internal->NumberOfQueuedFrames == 0)
+      {
+        // Stop is requested and all queued frames are converted
+        break;
+      }
+      // The slot stays in use until the frame is converted and released
+      queuedFrame = this->Internal->QueuedFrames[this->Internal->FirstQueuedFrameIndex];
+    }
 
-          // Flip BGRA to RGB
-          this->Internal->ImageImport->SetImportVoidPointer(buffer);
-          this->Internal->ImageImport->Modified();
+    if (comInit)
+    {
+      this->ConvertAndAddFrame(queuedFrame.Frame, queuedFrame.ArrivalTime);
+    }
+    queuedFrame.Frame->Release();
 
-          this->Internal->AppendComponent->Update();
+    std::lock_guard<std::mutex> lock(this->Internal->QueuedFramesMutex);
+    this->Internal->QueuedFrames[this->Internal->FirstQueuedFrameIndex].Frame = nullptr;
+    this->Internal->FirstQueuedFrameIndex = (this->Internal->FirstQueuedFrameIndex + 1) % this->Internal->QueuedFrames.size();
+    this->Internal->NumberOfQueuedFrames--;
+  }
 
-          vtkImageData* image = vtkImageData::SafeDownCast(this->Internal->AppendComponent->GetOutputDataObject(0));
+  ShutdownCOM(comInit);
+}
 
-          if (source->AddItem(image->GetScalarPointer(), source->GetInputImageOrientation(), this->Internal->RequestedFrameSize, VTK_UNSIGNED_CHAR, 3, US_IMG_RGB_COLOR, 0, this->FrameNumber) != PLUS_SUCCESS)
-          {
-            LOG_ERROR("Unable to add video item to buffer.");
-            return PLUS_FAIL;
-          }
-          this->FrameNumber++;
-        }
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusDeckLinkVideoSource::ConvertAndAddFrame(IDeckLinkVideoInputFrame* videoFrame, double arrivalTime)
+{
+  this->Internal->OutputFrame->SetFlags(videoFrame->GetFlags());
+  HRESULT res = this->Internal->DeckLinkVideoConversion->ConvertFrame(videoFrame, this->Internal->OutputFrame);
+  if (res != S_OK)
+  {
+    LPTSTR errorMsgPtr = 0;
+    FormatMessage(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM, NULL, res, 0, (LPTSTR)&errorMsgPtr, 0, NULL);
+    LOG_ERROR("Unable to convert video frame: " << errorMsgPtr);
+    LocalFree(errorMsgPtr);
+    return PLUS_FAIL;
+  }
+
+  void* buffer;
+  if (this->Internal->OutputFrame->GetBytes(&buffer) != S_OK)
+  {
+    LOG_ERROR("Unable to access converted video frame.");
+    return PLUS_FAIL;
+  }
+
+  vtkPlusDataSource* source;
+  this->GetFirstVideoSource(source);
+
+  const unsigned char* bgraFrame = static_cast<const unsigned char*>(buffer);
+  const long bgraRowBytes = this->Internal->OutputFrame->GetRowBytes();
+  const unsigned int width = this->Internal->RequestedFrameSize[0];
+  const unsigned int height = this->Internal->RequestedFrameSize[1];
+  const unsigned int rgbFrameSizeInBytes = width * height * 3;
+
+  // Flip BGRA to RGB, directly into the buffer if it stores the frame as it is
+  void* frameDataPtr(nullptr);
+  unsigned int frameSizeInBytes(0);
+  if (!igsioCommon::IsClippingRequested(source->GetClipRectangleOrigin(), source->GetClipRectangleSize())
+      && source->GetInputImageOrientation() == source->GetBuffer()->GetImageOrientation()
+      && source->ReserveNewItem(frameDataPtr, frameSizeInBytes) == PLUS_SUCCESS)
+  {
+    if (frameSizeInBytes == rgbFrameSizeInBytes)
+    {
+      unsigned char* rgbFrame = static_cast<unsigned char*>(frameDataPtr);
+      for (unsigned int row = 0; row < height; ++row)
+      {
+        ConvertBgraToRgb(bgraFrame + row * bgraRowBytes, rgbFrame + row * width * 3, width);
       }
+      if (source->CommitReservedItem(this->FrameNumber, arrivalTime) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Unable to add video item to buffer.");
+        return PLUS_FAIL;
+      }
+      this->FrameNumber++;
+      return PLUS_SUCCESS;
     }
+    source->CancelReservedItem();
+  }
 
-    this->Internal->PreviousFrameValid = inputFrameValid;
+  this->Internal->RgbFrame.resize(rgbFrameSizeInBytes);
+  for (unsigned int row = 0; row < height; ++row)
+  {
+    ConvertBgraToRgb(bgraFrame + row * bgraRowBytes, &this->Internal->RgbFrame[row * width * 3], width);
   }
-  return S_OK;
+  if (source->AddItem(&this->Internal->RgbFrame[0], source->GetInputImageOrientation(), this->Internal->RequestedFrameSize, VTK_UNSIGNED_CHAR, 3, US_IMG_RGB_COLOR, 0,
+                      this->FrameNumber, arrivalTime) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to add video item to buffer.");
+    return PLUS_FAIL;
+  }
+  this->FrameNumber++;
+  return PLUS_SUCCESS;
 }
@@ -23,6 +23,13 @@ See License.txt for details.
 /*!
 \class vtkPlusDeckLinkVideoSource
 \brief Interface to a BlackMagic DeckLink capture card
+
+The frame callback of the DeckLink SDK only takes a reference to the captured frame and puts it into a
+preallocated ring of FrameQueueSize slots. A conversion thread converts the frames to RGB and adds them
+to the buffer, so the conversion of large (e.g., 4K) frames does not delay the callback. The frames are
+converted to BGRA by the SDK and then to RGB in a single pass, written directly into the buffer frame if possible.
+If all slots are in use then the captured frame is dropped.
+
 \ingroup PlusLibDataCollection
 */
 class vtkPlusDataCollectionExport vtkPlusDeckLinkVideoSource : public vtkPlusDevice, public IDeckLinkInputCallback
@@ -59,6 +66,16 @@ protected:
   virtual ULONG STDMETHODCALLTYPE AddRef();
   virtual ULONG STDMETHODCALLTYPE Release();
 
+  /*! Start/stop the thread that converts the queued frames. Stopping converts the frames that are already queued. */
+  void StartConversionThread();
+  void StopConversionThread();
+
+  /*! Convert the queued frames until stop is requested. Runs in the conversion thread. */
+  void ConvertQueuedFrames();
+
+  /*! Convert a captured frame to RGB and add it to the buffer */
+  PlusStatus ConvertAndAddFrame(IDeckLinkVideoInputFrame* videoFrame, double arrivalTime);
+
 protected:
   std::atomic<ULONG> ReferenceCount;
 
@@ -671,15 +671,6 @@ void vtkPlusClarius::ProcessedImageCallback(const void* newImage, const ClariusP
   int frameSizeInBytes = nfo->width * nfo->height * frameBufferBytesPerPixel;
   bModeSource->SetNumberOfScalarComponents(frameBufferBytesPerPixel);
 
-  // need to copy newImage to new char vector vtkDataSource::AddItem() do not accept const char array
-  std::vector<char> _image;
-  size_t img_sz = nfo->width * nfo->height * (nfo->bitsPerPixel / 8);
-  if (_image.size() < img_sz)
-  {
-    _image.resize(img_sz);
-  }
-  memcpy(_image.data(), newImage, img_sz);
-
   // the clarius timestamp is in nanoseconds
   device->ClariusLastTimestamp = static_cast<double>((double)nfo->tm / (double)1000000000);
   // Get system time (elapsed time since last reboot), return Internal system time in seconds
@@ -700,9 +691,8 @@ void vtkPlusClarius::ProcessedImageCallback(const void* newImage, const ClariusP
 
   if (device->WriteImagesToDisk)
   {
-    // create cvimg to write to disk
-    cv::Mat cvimg = cv::Mat(nfo->width, nfo->height, CV_8UC4);
-    cvimg.data = cvimg.data = (unsigned char*)_image.data();
+    // create cvimg to write to disk, it only wraps the image of the callback
+    cv::Mat cvimg = cv::Mat(nfo->width, nfo->height, CV_8UC4, const_cast<void*>(newImage));
     if (cv::imwrite("Clarius_Image" + std::to_string(device->ClariusLastTimestamp) + ".bmp", cvimg) == false)
     {
       LOG_ERROR("ERROR writing clarius image" + std::to_string(device->ClariusLastTimestamp) + " to disk");
@@ -710,7 +700,7 @@ void vtkPlusClarius::ProcessedImageCallback(const void* newImage, const ClariusP
   }
 
   bModeSource->AddItem(
-    _image.data(), // pointer to char array
+    newImage, // pointer to char array, copied into the buffer
     bModeSource->GetInputImageOrientation(), // refer to this url: http://perk-software.cs.queensu.ca/plus/doc/nightly/dev/UltrasoundImageOrientation.html for reference;
                                          // Set to UN to keep the orientation of the image the same as on tablet
     bModeSource->GetInputFrameSize(),
@@ -923,8 +913,6 @@ void vtkPlusClarius::RawImageCallback(const void* newImage, const ClariusRawImag
   rfModeSource->SetImageType(US_IMG_RF_REAL);
   rfModeSource->SetOutputImageOrientation(US_IMG_ORIENT_MF);
 
-  int frameSizeInBytes = nfo->lines * nfo->samples * frameBufferBytesPerSample;
-
   // the clarius timestamp is in nanoseconds
   device->ClariusLastTimestamp = static_cast<double>((double)nfo->tm / (double)1000000000);
   // Get system time (elapsed time since last reboot), return Internal system time in seconds
@@ -935,17 +923,9 @@ void vtkPlusClarius::RawImageCallback(const void* newImage, const ClariusRawImag
     device->ClariusStartTimestamp = device->ClariusLastTimestamp;
   }
 
-  // Need to copy newImage to new char vector vtkDataSource::AddItem() do not accept const char array
-  std::vector<char> imageData;
-  if (imageData.size() < static_cast<size_t>(frameSizeInBytes))
-  {
-    imageData.resize(static_cast<size_t>(frameSizeInBytes));
-  }
-  memcpy(imageData.data(), newImage, static_cast<size_t>(frameSizeInBytes));
-
   double convertedTimestamp = device->SystemStartTimestamp + (device->ClariusLastTimestamp - device->ClariusStartTimestamp);
   rfModeSource->AddItem(
-    (void*)newImage, // pointer to char array
+    newImage, // pointer to char array, copied into the buffer
     rfModeSource->GetInputImageOrientation(), // refer to this url: http://perk-software.cs.queensu.ca/plus/doc/nightly/dev/UltrasoundImageOrientation.html for reference;
                                               // Set to UN to keep the orientation of the image the same as on tablet
     rfModeSource->GetInputFrameSize(),
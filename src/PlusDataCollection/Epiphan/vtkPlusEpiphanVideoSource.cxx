@@ -31,6 +31,7 @@ vtkPlusEpiphanVideoSource::vtkPlusEpiphanVideoSource()
   , RotationMode("")
   , Rotation(V2URotationNone)
   , Scale(V2UScaleNone)
+  , CropRectangleFromVideoSources(false)
 {
   this->ClipRectangleOrigin[0] = igsioCommon::NO_CLIP;
   this->ClipRectangleOrigin[1] = igsioCommon::NO_CLIP;
@@ -155,6 +156,29 @@ PlusStatus vtkPlusEpiphanVideoSource::InternalConnect()
     this->FrameSize[0] = static_cast<unsigned int>(this->ClipRectangleSize[0]);
     this->FrameSize[1] = static_cast<unsigned int>(this->ClipRectangleSize[1]);
   }
+  else if (this->Rotation == V2URotationNone && this->Scale == V2UScaleNone)
+  {
+    // No device clip rectangle: if all video sources request the same region then let the grabber transfer only that region
+    std::array<int, 3> sourceClipOrigin;
+    std::array<int, 3> sourceClipSize;
+    if (this->GetCommonClipRectangleOfVideoSources(sourceClipOrigin, sourceClipSize) == PLUS_SUCCESS
+        && sourceClipSize[0] % 4 == 0
+        && sourceClipOrigin[0] >= 0 && sourceClipOrigin[1] >= 0
+        && sourceClipOrigin[0] + sourceClipSize[0] <= vm.width && sourceClipOrigin[1] + sourceClipSize[1] <= vm.height)
+    {
+      LOG_DEBUG("Clip rectangle of the video sources is applied by the frame grabber. Origin: (" << sourceClipOrigin[0] << "," << sourceClipOrigin[1]
+                << "), size: " << sourceClipSize[0] << "x" << sourceClipSize[1]);
+      delete this->CropRectangle;
+      this->CropRectangle = new V2URect;
+      this->CropRectangle->x = sourceClipOrigin[0];
+      this->CropRectangle->y = sourceClipOrigin[1];
+      this->CropRectangle->width = sourceClipSize[0];
+      this->CropRectangle->height = sourceClipSize[1];
+      this->CropRectangleFromVideoSources = true;
+      this->FrameSize[0] = static_cast<unsigned int>(sourceClipSize[0]);
+      this->FrameSize[1] = static_cast<unsigned int>(sourceClipSize[1]);
+    }
+  }
 
   if (this->GetNumberOfVideoSources() == 1)
   {
@@ -169,6 +193,7 @@ PlusStatus vtkPlusEpiphanVideoSource::InternalConnect()
       US_IMAGE_TYPE imageType = aSource->GetImageType();
       aSource->SetPixelType(VTK_UNSIGNED_CHAR);
       aSource->SetNumberOfScalarComponents(imageType == US_IMG_RGB_COLOR ? 3 : 1);
+      aSource->SetClipRectangleAppliedByDevice(this->CropRectangleFromVideoSources);
       aSource->SetInputFrameSize(this->FrameSize);
     }
   }
@@ -187,6 +212,7 @@ PlusStatus vtkPlusEpiphanVideoSource::InternalConnect()
       US_IMAGE_TYPE imageType = aSource->GetImageType();
       aSource->SetPixelType(VTK_UNSIGNED_CHAR);
       aSource->SetNumberOfScalarComponents(imageType == US_IMG_RGB_COLOR ? 3 : 1);
+      aSource->SetClipRectangleAppliedByDevice(this->CropRectangleFromVideoSources);
       aSource->SetInputFrameSize(this->FrameSize);
     }
   }
@@ -213,6 +239,19 @@ PlusStatus vtkPlusEpiphanVideoSource::InternalDisconnect()
   }
   this->FrameGrabber = NULL;
 
+  if (this->CropRectangleFromVideoSources)
+  {
+    // The clip rectangle of the video sources may change before the next connection
+    delete this->CropRectangle;
+    this->CropRectangle = nullptr;
+    this->CropRectangleFromVideoSources = false;
+    std::vector<vtkPlusDataSource*> videoSources = this->GetVideoSources();
+    for (std::vector<vtkPlusDataSource*>::iterator it = videoSources.begin(); it != videoSources.end(); ++it)
+    {
+      (*it)->SetClipRectangleAppliedByDevice(false);
+    }
+  }
+
   return PLUS_SUCCESS;
 }
 
@@ -18,6 +18,9 @@
 /*!
   \class vtkPlusEpiphanVideoSource
   \brief Class for providing video input interfaces between VTK and Epiphan frame grabber device
+
+  If no clip rectangle is set for the device but all video sources have the same clip rectangle (and no rotation or scaling is requested)
+  then the grabber transfers only that region, so the full frames are not transferred and clipped in software.
   \ingroup PlusLibDataCollection
 */
 class vtkPlusDataCollectionExport vtkPlusEpiphanVideoSource : public vtkPlusDevice
@@ -111,6 +114,7 @@ protected:
   V2URotationMode Rotation;                 // Rotation of the acquired image
   std::string ScaleMode;
   V2UScaleMode Scale;                       // Scaling of the acquired image
+  bool CropRectangleFromVideoSources;       // CropRectangle is the common clip rectangle of the video sources (no device clip rectangle is set)
 
 private:
   vtkPlusEpiphanVideoSource(const vtkPlusEpiphanVideoSource&);  // Not implemented.
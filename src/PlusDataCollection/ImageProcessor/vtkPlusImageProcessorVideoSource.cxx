@@ -17,14 +17,55 @@ See License.txt for details.
 #include "vtkIGSIOTransformRepository.h"
 #include "vtksys/SystemTools.hxx"
 
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
 //----------------------------------------------------------------------------
 
 vtkStandardNewMacro(vtkPlusImageProcessorVideoSource);
 
+//----------------------------------------------------------------------------
+struct vtkPlusImageProcessorVideoSource::ProcessingWorker
+{
+  /*! Copy of the processor algorithm, as processors are not thread-safe */
+  vtkSmartPointer<vtkPlusTrackedFrameProcessor> Processor;
+  vtkSmartPointer<vtkIGSIOTransformRepository> TransformRepository;
+  std::thread Thread;
+};
+
+//----------------------------------------------------------------------------
+class vtkPlusImageProcessorVideoSource::ProcessingPipeline
+{
+public:
+  ProcessingPipeline() : StopRequested(false), HasPendingFrame(false) {}
+
+  std::vector< std::unique_ptr<ProcessingWorker> > Workers;
+
+  /*! Protects StopRequested, HasPendingFrame and PendingFrame */
+  std::mutex QueueMutex;
+  /*! Notified when a frame is waiting for processing or stop is requested */
+  std::condition_variable FrameWaiting;
+  /*! Notified when a worker took the waiting frame */
+  std::condition_variable FrameTaken;
+  bool StopRequested;
+  bool HasPendingFrame;
+  igsioTrackedFrame PendingFrame;
+
+  /*! Serializes adding processed frames to the output channel */
+  std::mutex OutputMutex;
+};
+
 //----------------------------------------------------------------------------
 vtkPlusImageProcessorVideoSource::vtkPlusImageProcessorVideoSource()
   : vtkPlusDevice()
   , LastProcessedInputDataTimestamp(0)
+  , LastSubmittedInputTimestamp(0)
+  , LastSubmittedInputUid(0)
+  , NumberOfProcessingThreads(0)
+  , ProcessLatestFrameOnly(true)
+  , Pipeline(new ProcessingPipeline)
   , EnableProcessing(true)
   , ProcessingAlgorithmAccessMutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
   , GracePeriodLogLevel(vtkPlusLogger::LOG_LEVEL_DEBUG)
@@ -42,6 +83,9 @@ vtkPlusImageProcessorVideoSource::vtkPlusImageProcessorVideoSource()
 //----------------------------------------------------------------------------
 vtkPlusImageProcessorVideoSource::~vtkPlusImageProcessorVideoSource()
 {
+  this->StopProcessingWorkers();
+  delete this->Pipeline;
+  this->Pipeline = NULL;
   if (this->TransformRepository)
   {
     this->TransformRepository->Delete();
@@ -58,6 +102,8 @@ vtkPlusImageProcessorVideoSource::~vtkPlusImageProcessorVideoSource()
 void vtkPlusImageProcessorVideoSource::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfProcessingThreads: " << this->NumberOfProcessingThreads << std::endl;
+  os << indent << "ProcessLatestFrameOnly: " << (this->ProcessLatestFrameOnly ? "true" : "false") << std::endl;
 }
 
 //----------------------------------------------------------------------------
@@ -65,6 +111,8 @@ PlusStatus vtkPlusImageProcessorVideoSource::ReadConfiguration(vtkXMLDataElement
 {
   XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_READING(deviceConfig, rootConfigElement);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(EnableProcessing, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfProcessingThreads, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(ProcessLatestFrameOnly, deviceConfig);
 
   // Read transform repository configuration
   if (this->TransformRepository->ReadConfiguration(rootConfigElement) != PLUS_SUCCESS)
@@ -96,48 +144,59 @@ PlusStatus vtkPlusImageProcessorVideoSource::ReadConfiguration(vtkXMLDataElement
       break;
     }
 
-    // Verify type
-    const char* processorType = processorElement->GetAttribute("Type");
-    if (processorType == NULL)
-    {
-      LOG_ERROR("Type attribute of Processor element is missing");
-      return PLUS_FAIL;
-    }
-
-    // Instantiate processor corresponding to the specified type
-    vtkSmartPointer<vtkPlusBoneEnhancer> boneEnhancer = vtkSmartPointer<vtkPlusBoneEnhancer>::New();
-    vtkSmartPointer<vtkPlusTransverseProcessEnhancer> TransverseProcessEnhancer = vtkSmartPointer<vtkPlusTransverseProcessEnhancer>::New();
-    if (!(STRCASECMP(boneEnhancer->GetProcessorTypeName(), processorType)))
-    {
-      boneEnhancer->SetTransformRepository(this->TransformRepository);
-      boneEnhancer->ReadConfiguration(processorElement);
-      this->ProcessorAlgorithm = boneEnhancer;
-      this->ProcessorAlgorithm->Register(this);
-      break;                  // If only one processor is allowed per ImageProcessor class, we can break out when we find it.
-    }
-    else if (!(STRCASECMP(TransverseProcessEnhancer->GetProcessorTypeName(), processorType)))
+    this->ProcessorAlgorithm = CreateProcessor(processorElement, this->TransformRepository);
+    if (this->ProcessorAlgorithm == NULL)
     {
-      TransverseProcessEnhancer->SetTransformRepository(this->TransformRepository);
-      TransverseProcessEnhancer->ReadConfiguration(processorElement);
-      this->ProcessorAlgorithm = TransverseProcessEnhancer;
-      this->ProcessorAlgorithm->Register(this);
-      break;
-    }
-    else
-    {
-      LOG_ERROR("Unknown processor type: " << processorType);
       return PLUS_FAIL;
     }
+    break;                  // If only one processor is allowed per ImageProcessor class, we can break out when we find it.
   }
 
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+vtkPlusTrackedFrameProcessor* vtkPlusImageProcessorVideoSource::CreateProcessor(vtkXMLDataElement* processorElement, vtkIGSIOTransformRepository* transformRepository)
+{
+  // Verify type
+  const char* processorType = processorElement->GetAttribute("Type");
+  if (processorType == NULL)
+  {
+    LOG_ERROR("Type attribute of Processor element is missing");
+    return NULL;
+  }
+
+  // Instantiate processor corresponding to the specified type
+  vtkPlusTrackedFrameProcessor* processor = NULL;
+  vtkSmartPointer<vtkPlusBoneEnhancer> boneEnhancer = vtkSmartPointer<vtkPlusBoneEnhancer>::New();
+  vtkSmartPointer<vtkPlusTransverseProcessEnhancer> TransverseProcessEnhancer = vtkSmartPointer<vtkPlusTransverseProcessEnhancer>::New();
+  if (!(STRCASECMP(boneEnhancer->GetProcessorTypeName(), processorType)))
+  {
+    processor = boneEnhancer;
+  }
+  else if (!(STRCASECMP(TransverseProcessEnhancer->GetProcessorTypeName(), processorType)))
+  {
+    processor = TransverseProcessEnhancer;
+  }
+  else
+  {
+    LOG_ERROR("Unknown processor type: " << processorType);
+    return NULL;
+  }
+
+  processor->SetTransformRepository(transformRepository);
+  processor->ReadConfiguration(processorElement);
+  processor->Register(NULL);
+  return processor;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusImageProcessorVideoSource::WriteConfiguration(vtkXMLDataElement* rootConfig)
 {
   XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_WRITING(deviceElement, rootConfig);
   deviceElement->SetAttribute("EnableCapturing", this->EnableProcessing ? "TRUE" : "FALSE");
+  deviceElement->SetIntAttribute("NumberOfProcessingThreads", this->NumberOfProcessingThreads);
+  XML_WRITE_BOOL_ATTRIBUTE(ProcessLatestFrameOnly, deviceElement);
 
   // Write processor elements
   if (this->ProcessorAlgorithm != NULL)
@@ -187,8 +246,10 @@ PlusStatus vtkPlusImageProcessorVideoSource::InternalConnect()
   }
 
   this->LastProcessedInputDataTimestamp = 0;
+  this->LastSubmittedInputTimestamp = 0;
+  this->LastSubmittedInputUid = 0;
 
-  return PLUS_SUCCESS;
+  return this->StartProcessingWorkers();
 }
 
 //----------------------------------------------------------------------------
@@ -196,6 +257,7 @@ PlusStatus vtkPlusImageProcessorVideoSource::InternalDisconnect()
 {
   igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->ProcessingAlgorithmAccessMutex);
   this->EnableProcessing = false;
+  this->StopProcessingWorkers();
   return PLUS_SUCCESS;
 }
 
@@ -255,20 +317,85 @@ PlusStatus vtkPlusImageProcessorVideoSource::InternalUpdate()
   outputChannel->GetMostRecentTimestamp(latestFrameAlreadyAddedTimestamp);
 
   double frameTimestamp = trackedFrame.GetTimestamp();
-  if (latestFrameAlreadyAddedTimestamp >= frameTimestamp)
+  if (latestFrameAlreadyAddedTimestamp >= frameTimestamp || this->LastSubmittedInputTimestamp >= frameTimestamp)
+  {
+    // processed data has been already generated (or is being generated) for this timestamp
+    return PLUS_SUCCESS;
+  }
+  this->LastSubmittedInputTimestamp = frameTimestamp;
+
+  // Input frames that were acquired since the previously processed frame are skipped
+  vtkPlusDataSource* inputSource(NULL);
+  BufferItemUidType inputUid(0);
+  if (this->InputChannels[0]->GetVideoSource(inputSource) == PLUS_SUCCESS && inputSource->GetItemUidFromTime(frameTimestamp, inputUid) == ITEM_OK)
   {
-    // processed data has been already generated for this timestamp
+    if (this->LastSubmittedInputUid != 0 && inputUid > this->LastSubmittedInputUid + 1)
+    {
+      outputChannel->AddSkippedFrameStatistics(static_cast<unsigned long>(inputUid - this->LastSubmittedInputUid - 1));
+    }
+    this->LastSubmittedInputUid = inputUid;
+  }
+
+  if (!this->Pipeline->Workers.empty())
+  {
+    // Pass the frame to the worker threads
+    {
+      std::unique_lock<std::mutex> queueLock(this->Pipeline->QueueMutex);
+      if (this->Pipeline->HasPendingFrame)
+      {
+        if (this->ProcessLatestFrameOnly)
+        {
+          // the waiting frame is replaced by this newer frame
+          outputChannel->AddSkippedFrameStatistics(1);
+        }
+        else
+        {
+          this->Pipeline->FrameTaken.wait(queueLock, [this] { return !this->Pipeline->HasPendingFrame || this->Pipeline->StopRequested; });
+          if (this->Pipeline->StopRequested)
+          {
+            return PLUS_SUCCESS;
+          }
+        }
+      }
+      this->Pipeline->PendingFrame = trackedFrame;
+      this->Pipeline->HasPendingFrame = true;
+    }
+    this->Pipeline->FrameWaiting.notify_one();
     return PLUS_SUCCESS;
   }
 
   vtkSmartPointer<vtkIGSIOTrackedFrameList> trackingFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
   trackingFrames->AddTrackedFrame(&trackedFrame);
-  this->ProcessorAlgorithm->SetInputFrames(trackingFrames);
-  if (this->ProcessorAlgorithm->Update() != PLUS_SUCCESS)
+  return this->ProcessInputFrames(this->ProcessorAlgorithm, trackingFrames);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusImageProcessorVideoSource::ProcessInputFrames(vtkPlusTrackedFrameProcessor* processor, vtkIGSIOTrackedFrameList* inputFrames)
+{
+  double processingStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  processor->SetInputFrames(inputFrames);
+  if (processor->Update() != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  double processingTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - processingStartTime;
+
+  vtkIGSIOTrackedFrameList* processedFrames = processor->GetOutputFrames();
+  if (processedFrames == NULL || processedFrames->GetNumberOfTrackedFrames() < 1)
   {
+    LOG_ERROR("Failed to retrieve processed frame");
     return PLUS_FAIL;
   }
 
+  return this->AddProcessedFrame(processedFrames->GetTrackedFrame(0), processingTimeSec);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusImageProcessorVideoSource::AddProcessedFrame(igsioTrackedFrame* processedTrackedFrame, double processingTimeSec)
+{
+  std::lock_guard<std::mutex> outputLock(this->Pipeline->OutputMutex);
+
+  vtkPlusChannel* outputChannel = this->OutputChannels[0];
   vtkPlusDataSource* aSource(NULL);
   if (outputChannel->GetVideoSource(aSource) != PLUS_SUCCESS)
   {
@@ -276,16 +403,19 @@ PlusStatus vtkPlusImageProcessorVideoSource::InternalUpdate()
     return PLUS_FAIL;
   }
 
-  PlusStatus status = PLUS_SUCCESS;
-
-  vtkIGSIOTrackedFrameList* processedFrames = this->ProcessorAlgorithm->GetOutputFrames();
-  if (processedFrames == NULL || processedFrames->GetNumberOfTrackedFrames() < 1)
+  // A worker may complete the processing of a frame after a newer frame has been already added
+  double frameTimestamp = processedTrackedFrame->GetTimestamp();
+  double latestFrameAlreadyAddedTimestamp = 0;
+  outputChannel->GetMostRecentTimestamp(latestFrameAlreadyAddedTimestamp);
+  if (latestFrameAlreadyAddedTimestamp >= frameTimestamp)
   {
-    LOG_ERROR("Failed to retrieve processed frame");
-    return PLUS_FAIL;
+    LOG_TRACE("Processed image is dropped, as a newer image has been already added: timestamp=" << frameTimestamp);
+    outputChannel->AddSkippedFrameStatistics(1);
+    return PLUS_SUCCESS;
   }
 
-  igsioTrackedFrame* processedTrackedFrame = processedFrames->GetTrackedFrame(0);
+  PlusStatus status = PLUS_SUCCESS;
+
   // Generate unique frame number (not used for filtering, so the actual increment value does not matter)
   this->FrameNumber++;
 
@@ -315,11 +445,105 @@ PlusStatus vtkPlusImageProcessorVideoSource::InternalUpdate()
   {
     status = PLUS_FAIL;
   }
+  else
+  {
+    outputChannel->AddProcessedFrameStatistics(processingTimeSec);
+  }
 
   this->Modified();
   return status;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusImageProcessorVideoSource::StartProcessingWorkers()
+{
+  this->StopProcessingWorkers();
+  if (this->NumberOfProcessingThreads < 1 || this->ProcessorAlgorithm == NULL)
+  {
+    return PLUS_SUCCESS;
+  }
+  if (!this->ProcessorAlgorithm->IsFrameParallelProcessingSupported())
+  {
+    LOG_WARNING("The " << this->ProcessorAlgorithm->GetProcessorTypeName() << " processor cannot process frames in parallel with the current settings, frames are processed in the update thread. Device ID: " << this->GetDeviceId());
+    return PLUS_SUCCESS;
+  }
+
+  for (int workerIndex = 0; workerIndex < this->NumberOfProcessingThreads; workerIndex++)
+  {
+    std::unique_ptr<ProcessingWorker> worker(new ProcessingWorker);
+    worker->Processor = vtkSmartPointer<vtkPlusTrackedFrameProcessor>::Take(this->ProcessorAlgorithm->CreateWorkerProcessor());
+    if (worker->Processor == NULL)
+    {
+      LOG_WARNING("Failed to create processing worker threads, frames are processed in the update thread. Device ID: " << this->GetDeviceId());
+      this->Pipeline->Workers.clear();
+      return PLUS_SUCCESS;
+    }
+    worker->TransformRepository = vtkSmartPointer<vtkIGSIOTransformRepository>::New();
+    worker->TransformRepository->DeepCopy(this->TransformRepository);
+    worker->Processor->SetTransformRepository(worker->TransformRepository);
+    this->Pipeline->Workers.push_back(std::move(worker));
+  }
+
+  this->Pipeline->StopRequested = false;
+  this->Pipeline->HasPendingFrame = false;
+  for (auto it = this->Pipeline->Workers.begin(); it != this->Pipeline->Workers.end(); ++it)
+  {
+    (*it)->Thread = std::thread(&vtkPlusImageProcessorVideoSource::RunProcessingWorker, this, it->get());
+  }
+  LOG_INFO("Image processing started in " << this->Pipeline->Workers.size() << " worker threads. Device ID: " << this->GetDeviceId());
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusImageProcessorVideoSource::StopProcessingWorkers()
+{
+  if (this->Pipeline->Workers.empty())
+  {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> queueLock(this->Pipeline->QueueMutex);
+    this->Pipeline->StopRequested = true;
+    this->Pipeline->HasPendingFrame = false;
+  }
+  this->Pipeline->FrameWaiting.notify_all();
+  this->Pipeline->FrameTaken.notify_all();
+  for (auto it = this->Pipeline->Workers.begin(); it != this->Pipeline->Workers.end(); ++it)
+  {
+    if ((*it)->Thread.joinable())
+    {
+      (*it)->Thread.join();
+    }
+  }
+  this->Pipeline->Workers.clear();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusImageProcessorVideoSource::RunProcessingWorker(ProcessingWorker* worker)
+{
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> inputFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> queueLock(this->Pipeline->QueueMutex);
+      this->Pipeline->FrameWaiting.wait(queueLock, [this] { return this->Pipeline->HasPendingFrame || this->Pipeline->StopRequested; });
+      if (this->Pipeline->StopRequested)
+      {
+        return;
+      }
+      inputFrames->Clear();
+      inputFrames->AddTrackedFrame(&this->Pipeline->PendingFrame);
+      this->Pipeline->HasPendingFrame = false;
+    }
+    this->Pipeline->FrameTaken.notify_one();
+
+    if (this->ProcessInputFrames(worker->Processor, inputFrames) != PLUS_SUCCESS)
+    {
+      LOG_DYNAMIC("Failed to process frame in worker thread. Device ID: " << this->GetDeviceId(), this->GracePeriodLogLevel);
+    }
+  }
+}
+
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusImageProcessorVideoSource::NotifyConfigured()
 {
@@ -352,7 +576,20 @@ void vtkPlusImageProcessorVideoSource::SetEnableProcessing(bool aValue)
 
   if (processingStartsNow)
   {
-    this->LastProcessedInputDataTimestamp = 0.0;
-    this->RecordingStartTime = vtkIGSIOAccurateTimer::GetSystemTime(); // reset the starting time for the grace period
+    this->RestartProcessingFromLatestInput();
   }
 }
+
+//-----------------------------------------------------------------------------
+void vtkPlusImageProcessorVideoSource::InternalResumeFromIdle()
+{
+  this->RestartProcessingFromLatestInput();
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusImageProcessorVideoSource::RestartProcessingFromLatestInput()
+{
+  this->LastProcessedInputDataTimestamp = 0.0;
+  this->LastSubmittedInputUid = 0; // frames acquired while processing was paused are not counted as skipped
+  this->RecordingStartTime = vtkIGSIOAccurateTimer::GetSystemTime(); // reset the starting time for the grace period
+}
@@ -19,6 +19,14 @@ class vtkPlusTrackedFrameProcessor;
 \class vtkPlusImageProcessorVideoSource 
 \brief Virtual device that performs real-time image processing on the input channel
 
+By default the latest input frame is processed in the internal update thread. If NumberOfProcessingThreads is set
+then frames are processed in worker threads, each with its own copy of the processor, so frames are acquired
+while processing is in progress and up to NumberOfProcessingThreads frames are processed at the same time.
+If all workers are busy then the next frame waits for a free worker. If ProcessLatestFrameOnly is enabled (default)
+then a waiting frame is replaced by a newer frame, so that processing always starts with the most recent frame.
+Processing times and the number of skipped input frames are recorded in the frame processing statistics
+of the output channel.
+
 \ingroup PlusLibDataCollection
 */
 class vtkPlusDataCollectionExport vtkPlusImageProcessorVideoSource : public vtkPlusDevice
@@ -42,18 +50,62 @@ public:
   vtkGetMacro(EnableProcessing, bool);
   void SetEnableProcessing(bool aValue);
 
+  /*! Number of worker threads that process frames. 0 (default) means that frames are processed in the internal update thread. Applied when the device is connected. */
+  vtkSetClampMacro(NumberOfProcessingThreads, int, 0, 16);
+  vtkGetMacro(NumberOfProcessingThreads, int);
+
+  /*! If enabled then a frame that waits for a free worker thread is replaced by a newer frame, instead of waiting for its processing */
+  vtkSetMacro(ProcessLatestFrameOnly, bool);
+  vtkGetMacro(ProcessLatestFrameOnly, bool);
+  vtkBooleanMacro(ProcessLatestFrameOnly, bool);
+
   virtual bool IsTracker() const { return false; }
   virtual bool IsVirtual() const { return true; }
 
+  /*!
+    Create the processor that is described by a Processor element (its Type attribute selects the algorithm).
+    The caller owns the returned object, NULL is returned in case of an error.
+  */
+  static vtkPlusTrackedFrameProcessor* CreateProcessor(vtkXMLDataElement* processorElement, vtkIGSIOTransformRepository* transformRepository);
+
 protected:
   virtual PlusStatus InternalConnect();
   virtual PlusStatus InternalDisconnect();
 
+  /*! Frames that arrived while the device was idle are not processed */
+  virtual void InternalResumeFromIdle();
+
+  /*! Continue processing with the latest input, without counting the frames that arrived meanwhile as skipped */
+  void RestartProcessingFromLatestInput();
+
   vtkPlusImageProcessorVideoSource();
   virtual ~vtkPlusImageProcessorVideoSource();
 
+  /*! Process the frames with the processor and add the result to the output channel */
+  PlusStatus ProcessInputFrames(vtkPlusTrackedFrameProcessor* processor, vtkIGSIOTrackedFrameList* inputFrames);
+
+  /*! Add a processed frame to the output channel. Frames that are not newer than the latest output frame are skipped. */
+  PlusStatus AddProcessedFrame(igsioTrackedFrame* processedTrackedFrame, double processingTimeSec);
+
+  /*! Start the worker threads if NumberOfProcessingThreads is set. Frames are processed in the update thread if workers cannot be started. */
+  PlusStatus StartProcessingWorkers();
+  void StopProcessingWorkers();
+
+  /*! Worker threads, queue and output synchronization of frame processing in worker threads */
+  class ProcessingPipeline;
+  struct ProcessingWorker;
+  void RunProcessingWorker(ProcessingWorker* worker);
+
   double LastProcessedInputDataTimestamp;
 
+  /*! Timestamp and buffer UID of the latest input frame that was processed or passed to the worker threads */
+  double LastSubmittedInputTimestamp;
+  BufferItemUidType LastSubmittedInputUid;
+
+  int NumberOfProcessingThreads;
+  bool ProcessLatestFrameOnly;
+  ProcessingPipeline* Pipeline;
+
   bool EnableProcessing;
 
   /*!
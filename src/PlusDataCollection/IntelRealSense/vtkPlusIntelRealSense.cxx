@@ -8,15 +8,40 @@ See License.txt for details.
 #include "vtkPlusIntelRealSense.h"
 
 // Local includes
+#include "vtkPlusBuffer.h"
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataSource.h"
 
 // IntelRealSense includes
 #include <rs.hpp>
+#include <rsutil.h>
+
+// IGSIO includes
+#include <vtkIGSIOAccurateTimer.h>
 
 // stl includes
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  // SSE2 is available on all 64-bit x86 processors
+  #define PLUS_INTELREALSENSE_SSE2
+  #include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+  // NEON is always available on 64-bit ARM
+  #define PLUS_INTELREALSENSE_NEON
+  #include <arm_neon.h>
+#endif
+
 // VTK includes
 #include <vtkImageData.h>
 #include <vtkObjectFactory.h>
@@ -28,6 +53,267 @@ vtkStandardNewMacro(vtkPlusIntelRealSense);
 #define REALSENSE_DEFAULT_FRAME_HEIGHT 480
 #define REALSENSE_DEFAULT_FRAME_RATE 30
 
+namespace
+{
+  /*! Framesets waiting for alignment and colorization. Queued frames hold frames of the librealsense frame pools, so keep it short. */
+  const size_t MAXIMUM_NUMBER_OF_QUEUED_FRAMESETS = 2;
+
+  //----------------------------------------------------------------------------
+  /*!
+    Converts depth frames to point clouds (in mm, in the coordinate system of the depth camera).
+    The viewing rays of the pixels are computed only when the camera intrinsics change, so a point is the
+    depth multiplied by the ray of its pixel, which is computed with SIMD instructions where available.
+    The points can be downsampled to the centroids of the occupied voxels of a grid. All working memory is
+    allocated for the first frame and reused for the following frames.
+  */
+  class PointCloudGenerator
+  {
+  public:
+    PointCloudGenerator(float voxelSizeMm, float minimumDepthMm, float maximumDepthMm)
+      : VoxelSizeMm(voxelSizeMm)
+      , MinimumDepthMm(minimumDepthMm)
+      , MaximumDepthMm(maximumDepthMm > 0 ? maximumDepthMm : std::numeric_limits<float>::max())
+      , RaysValid(false)
+      , VoxelStamp(0)
+    {
+      memset(&this->RayIntrinsics, 0, sizeof(this->RayIntrinsics));
+    }
+
+    /*!
+      Write the points of a depth frame to outputPoints (x0, y0, z0, x1, ...) and fill the rest of the output with NaN.
+      Points beyond maximumNumberOfPoints are dropped. Returns the number of points.
+      \param depth Raw depth values, rows are depthStride values apart
+      \param depthUnitToMm Size of a depth unit in mm
+    */
+    unsigned int Generate(const uint16_t* depth, int depthStride, const rs2_intrinsics& intrinsics, float depthUnitToMm,
+                          float* outputPoints, unsigned int maximumNumberOfPoints)
+    {
+      this->UpdateRays(intrinsics);
+      const size_t numberOfPixels = static_cast<size_t>(intrinsics.width) * intrinsics.height;
+      this->PointX.resize(numberOfPixels);
+      this->PointY.resize(numberOfPixels);
+      this->PointZ.resize(numberOfPixels);
+      for (int row = 0; row < intrinsics.height; ++row)
+      {
+        this->Deproject(depth + static_cast<size_t>(row) * depthStride, static_cast<size_t>(row) * intrinsics.width, intrinsics.width, depthUnitToMm);
+      }
+
+      unsigned int numberOfPoints = (this->VoxelSizeMm > 0 ? this->DownsampleToVoxels(outputPoints, maximumNumberOfPoints)
+                                     : this->CopyValidPoints(outputPoints, maximumNumberOfPoints));
+      std::fill(outputPoints + static_cast<size_t>(numberOfPoints) * 3, outputPoints + static_cast<size_t>(maximumNumberOfPoints) * 3,
+                std::numeric_limits<float>::quiet_NaN());
+      return numberOfPoints;
+    }
+
+  protected:
+    //----------------------------------------------------------------------------
+    void UpdateRays(const rs2_intrinsics& intrinsics)
+    {
+      if (this->RaysValid && memcmp(&intrinsics, &this->RayIntrinsics, sizeof(intrinsics)) == 0)
+      {
+        return;
+      }
+      const size_t numberOfPixels = static_cast<size_t>(intrinsics.width) * intrinsics.height;
+      this->RayX.resize(numberOfPixels);
+      this->RayY.resize(numberOfPixels);
+      for (int v = 0; v < intrinsics.height; ++v)
+      {
+        for (int u = 0; u < intrinsics.width; ++u)
+        {
+          // deprojection is linear in depth, so the point at unit depth is the ray of the pixel (including the lens distortion)
+          const float pixel[2] = { static_cast<float>(u), static_cast<float>(v) };
+          float ray[3] = { 0, 0, 0 };
+          rs2_deproject_pixel_to_point(ray, &intrinsics, pixel, 1.0f);
+          this->RayX[static_cast<size_t>(v) * intrinsics.width + u] = ray[0];
+          this->RayY[static_cast<size_t>(v) * intrinsics.width + u] = ray[1];
+        }
+      }
+      this->RayIntrinsics = intrinsics;
+      this->RaysValid = true;
+    }
+
+    //----------------------------------------------------------------------------
+    /*! Compute the points of a row of pixels. The z coordinate of pixels without valid depth is NaN. */
+    void Deproject(const uint16_t* depth, size_t firstPixel, int numberOfPixels, float depthUnitToMm)
+    {
+      const float* rayX = &this->RayX[firstPixel];
+      const float* rayY = &this->RayY[firstPixel];
+      float* pointX = &this->PointX[firstPixel];
+      float* pointY = &this->PointY[firstPixel];
+      float* pointZ = &this->PointZ[firstPixel];
+      const float minimumValidDepth = std::max(this->MinimumDepthMm, std::numeric_limits<float>::min());
+      int pixel = 0;
+#if defined(PLUS_INTELREALSENSE_SSE2)
+      const __m128 scale = _mm_set1_ps(depthUnitToMm);
+      const __m128 minimumDepth = _mm_set1_ps(minimumValidDepth);
+      const __m128 maximumDepth = _mm_set1_ps(this->MaximumDepthMm);
+      const __m128 invalid = _mm_set1_ps(std::numeric_limits<float>::quiet_NaN());
+      const __m128i zero = _mm_setzero_si128();
+      for (; pixel + 8 <= numberOfPixels; pixel += 8)
+      {
+        __m128i depth16 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(depth + pixel));
+        __m128 z[2] = { _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(depth16, zero)), scale),
+                        _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(depth16, zero)), scale) };
+        for (int half = 0; half < 2; ++half)
+        {
+          const int offset = pixel + 4 * half;
+          __m128 valid = _mm_and_ps(_mm_cmpge_ps(z[half], minimumDepth), _mm_cmple_ps(z[half], maximumDepth));
+          _mm_storeu_ps(pointX + offset, _mm_mul_ps(z[half], _mm_loadu_ps(rayX + offset)));
+          _mm_storeu_ps(pointY + offset, _mm_mul_ps(z[half], _mm_loadu_ps(rayY + offset)));
+          _mm_storeu_ps(pointZ + offset, _mm_or_ps(_mm_and_ps(valid, z[half]), _mm_andnot_ps(valid, invalid)));
+        }
+      }
+#elif defined(PLUS_INTELREALSENSE_NEON)
+      const float32x4_t scale = vdupq_n_f32(depthUnitToMm);
+      const float32x4_t minimumDepth = vdupq_n_f32(minimumValidDepth);
+      const float32x4_t maximumDepth = vdupq_n_f32(this->MaximumDepthMm);
+      const float32x4_t invalid = vdupq_n_f32(std::numeric_limits<float>::quiet_NaN());
+      for (; pixel + 8 <= numberOfPixels; pixel += 8)
+      {
+        uint16x8_t depth16 = vld1q_u16(depth + pixel);
+        float32x4_t z[2] = { vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(depth16))), scale),
+                             vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(depth16))), scale) };
+        for (int half = 0; half < 2; ++half)
+        {
+          const int offset = pixel + 4 * half;
+          uint32x4_t valid = vandq_u32(vcgeq_f32(z[half], minimumDepth), vcleq_f32(z[half], maximumDepth));
+          vst1q_f32(pointX + offset, vmulq_f32(z[half], vld1q_f32(rayX + offset)));
+          vst1q_f32(pointY + offset, vmulq_f32(z[half], vld1q_f32(rayY + offset)));
+          vst1q_f32(pointZ + offset, vbslq_f32(valid, z[half], invalid));
+        }
+      }
+#endif
+      for (; pixel < numberOfPixels; ++pixel)
+      {
+        const float z = depth[pixel] * depthUnitToMm;
+        pointX[pixel] = z * rayX[pixel];
+        pointY[pixel] = z * rayY[pixel];
+        pointZ[pixel] = (z >= minimumValidDepth && z <= this->MaximumDepthMm ? z : std::numeric_limits<float>::quiet_NaN());
+      }
+    }
+
+    //----------------------------------------------------------------------------
+    unsigned int CopyValidPoints(float* outputPoints, unsigned int maximumNumberOfPoints)
+    {
+      unsigned int numberOfPoints = 0;
+      for (size_t pixel = 0; pixel < this->PointZ.size() && numberOfPoints < maximumNumberOfPoints; ++pixel)
+      {
+        if (std::isnan(this->PointZ[pixel]))
+        {
+          continue;
+        }
+        outputPoints[0] = this->PointX[pixel];
+        outputPoints[1] = this->PointY[pixel];
+        outputPoints[2] = this->PointZ[pixel];
+        outputPoints += 3;
+        ++numberOfPoints;
+      }
+      return numberOfPoints;
+    }
+
+    //----------------------------------------------------------------------------
+    /*! Replace the points of each occupied voxel by their centroid. The voxels are found in a hash table that is cleared by incrementing a stamp. */
+    unsigned int DownsampleToVoxels(float* outputPoints, unsigned int maximumNumberOfPoints)
+    {
+      size_t tableSize = 1;
+      while (tableSize < 2 * this->PointZ.size())
+      {
+        tableSize *= 2;
+      }
+      if (this->VoxelKeys.size() != tableSize)
+      {
+        this->VoxelKeys.assign(tableSize, 0);
+        this->VoxelStamps.assign(tableSize, 0);
+        this->VoxelSums.assign(tableSize * 4, 0.0f);
+        this->VoxelStamp = 0;
+      }
+      this->OccupiedVoxels.clear();
+      this->OccupiedVoxels.reserve(this->PointZ.size());
+      if (++this->VoxelStamp == 0)
+      {
+        // stamp wrapped around, the old stamps have to be cleared
+        std::fill(this->VoxelStamps.begin(), this->VoxelStamps.end(), 0);
+        this->VoxelStamp = 1;
+      }
+
+      const float inverseVoxelSize = 1.0f / this->VoxelSizeMm;
+      const size_t tableMask = tableSize - 1;
+      for (size_t pixel = 0; pixel < this->PointZ.size(); ++pixel)
+      {
+        if (std::isnan(this->PointZ[pixel]))
+        {
+          continue;
+        }
+        // 21 bits per voxel index, which covers +/-1048576 voxels
+        const uint64_t key = (static_cast<uint64_t>(static_cast<int64_t>(std::floor(this->PointX[pixel] * inverseVoxelSize)) + (1 << 20)) & 0x1FFFFF)
+                             | ((static_cast<uint64_t>(static_cast<int64_t>(std::floor(this->PointY[pixel] * inverseVoxelSize)) + (1 << 20)) & 0x1FFFFF) << 21)
+                             | ((static_cast<uint64_t>(static_cast<int64_t>(std::floor(this->PointZ[pixel] * inverseVoxelSize)) + (1 << 20)) & 0x1FFFFF) << 42);
+        size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> 32) & tableMask;
+        while (this->VoxelStamps[slot] == this->VoxelStamp && this->VoxelKeys[slot] != key)
+        {
+          slot = (slot + 1) & tableMask;
+        }
+        float* sums = &this->VoxelSums[slot * 4];
+        if (this->VoxelStamps[slot] != this->VoxelStamp)
+        {
+          this->VoxelStamps[slot] = this->VoxelStamp;
+          this->VoxelKeys[slot] = key;
+          sums[0] = sums[1] = sums[2] = sums[3] = 0.0f;
+          this->OccupiedVoxels.push_back(static_cast<uint32_t>(slot));
+        }
+        sums[0] += this->PointX[pixel];
+        sums[1] += this->PointY[pixel];
+        sums[2] += this->PointZ[pixel];
+        sums[3] += 1.0f;
+      }
+
+      unsigned int numberOfPoints = 0;
+      for (std::vector<uint32_t>::const_iterator voxelIt = this->OccupiedVoxels.begin(); voxelIt != this->OccupiedVoxels.end() && numberOfPoints < maximumNumberOfPoints; ++voxelIt)
+      {
+        const float* sums = &this->VoxelSums[static_cast<size_t>(*voxelIt) * 4];
+        outputPoints[0] = sums[0] / sums[3];
+        outputPoints[1] = sums[1] / sums[3];
+        outputPoints[2] = sums[2] / sums[3];
+        outputPoints += 3;
+        ++numberOfPoints;
+      }
+      return numberOfPoints;
+    }
+
+    float VoxelSizeMm;
+    float MinimumDepthMm;
+    float MaximumDepthMm;
+
+    /*! Intrinsics that the rays are computed for */
+    rs2_intrinsics RayIntrinsics;
+    bool RaysValid;
+    /*! Ray of each pixel (x/z and y/z) */
+    std::vector<float> RayX;
+    std::vector<float> RayY;
+    /*! Deprojected points of the current frame */
+    std::vector<float> PointX;
+    std::vector<float> PointY;
+    std::vector<float> PointZ;
+
+    /*! Voxel hash table: a slot is occupied in the current frame if its stamp equals VoxelStamp */
+    std::vector<uint64_t> VoxelKeys;
+    std::vector<uint32_t> VoxelStamps;
+    /*! Sum of the x, y, z coordinates and the number of points of each slot */
+    std::vector<float> VoxelSums;
+    /*! Occupied slots in the order of their first point */
+    std::vector<uint32_t> OccupiedVoxels;
+    uint32_t VoxelStamp;
+  };
+
+  //----------------------------------------------------------------------------
+  // The frames of the buffer can be written directly if they are stored as they are received
+  bool CanReserveItem(vtkPlusDataSource* source)
+  {
+    return !igsioCommon::IsClippingRequested(source->GetClipRectangleOrigin(), source->GetClipRectangleSize())
+           && source->GetInputImageOrientation() == source->GetBuffer()->GetImageOrientation();
+  }
+}
+
 //----------------------------------------------------------------------------
 class vtkPlusIntelRealSense::vtkInternal
 {
@@ -37,6 +323,8 @@ public:
   vtkInternal(vtkPlusIntelRealSense* external)
     : External(external)
     , Align(nullptr)
+    , StopProcessingRequested(false)
+    , NumberOfDroppedFramesets(0)
   {
   }
 
@@ -57,14 +345,28 @@ public:
     rs2_stream StreamType;
     std::string SourceName;
     vtkPlusDataSource* Source;
+    /*! True if the data source is in an output channel of the device */
+    bool Used;
     unsigned int Height;
     unsigned int Width;
     unsigned int FrameRate;
+    /*! If not NULL then the depth frames are stored as point clouds in the data source */
+    std::shared_ptr<PointCloudGenerator> PointCloud;
+    /*! Number of points in each point cloud frame */
+    unsigned int MaximumNumberOfPoints = 0;
+  };
+
+  struct QueuedFrameset
+  {
+    rs2::frameset Frames;
+    unsigned long FrameNumber;
+    double Timestamp;
   };
 
   // Configuration parameters
   bool UseRealSenseColorizer = false;
   bool AlignDepthStream = false;
+  bool SkipUnusedStreams = false;
 
   // Frame setup for RGB & depth
   std::vector<RSFrameConfig> VideoSources;
@@ -80,6 +382,34 @@ public:
   PlusStatus SetStreamToAlign(const std::vector<rs2::stream_profile>& streams);
   rs2_stream AlignTo;
   rs2::align* Align; // rs2::align doesn't have a default constructor, so we must use a pointer
+
+  // Colorization, the colorizer is kept for the whole recording so its output frames are reused from its pool
+  rs2::colorizer Colorizer;
+
+  /*! Returns true if any depth data source is in an output channel (or unused streams are processed) */
+  bool IsDepthStreamUsed() const;
+
+  /*! Start the processing thread, which aligns, colorizes and adds the queued framesets to the data sources */
+  void StartProcessing();
+  /*! Add the queued framesets to the data sources and stop the processing thread */
+  void StopProcessing();
+  /*! Queue a frameset for processing. If the processing thread cannot keep up then the oldest queued frameset is dropped. */
+  void QueueFrameset(const rs2::frameset& frames, unsigned long frameNumber, double timestamp);
+  void ProcessFramesets();
+  /*! Align and colorize the frames as configured, and add them to the data sources */
+  PlusStatus AddFrameset(QueuedFrameset& frameset);
+  /*! Convert the depth frame to a point cloud and add it to the data source */
+  PlusStatus AddPointCloud(RSFrameConfig& source, rs2::frameset& frames, const QueuedFrameset& frameset);
+
+  std::thread ProcessingThread;
+  std::mutex QueueMutex;
+  std::condition_variable QueueCondition;
+  std::deque<QueuedFrameset> Queue;
+  bool StopProcessingRequested;
+  unsigned long NumberOfDroppedFramesets;
+
+  /*! Point cloud of a frame if it cannot be written directly into the buffer */
+  std::vector<float> PointCloudFrame;
 };
 
 //----------------------------------------------------------------------------
@@ -142,6 +472,271 @@ PlusStatus vtkPlusIntelRealSense::vtkInternal::SetStreamToAlign(const std::vecto
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+bool vtkPlusIntelRealSense::vtkInternal::IsDepthStreamUsed() const
+{
+  for (std::vector<RSFrameConfig>::const_iterator it = this->VideoSources.begin(); it != this->VideoSources.end(); ++it)
+  {
+    if (it->StreamType == RS2_STREAM_DEPTH && (it->Used || !this->SkipUnusedStreams))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusIntelRealSense::vtkInternal::StartProcessing()
+{
+  this->StopProcessing();
+  {
+    std::lock_guard<std::mutex> lock(this->QueueMutex);
+    this->StopProcessingRequested = false;
+    this->NumberOfDroppedFramesets = 0;
+  }
+  this->ProcessingThread = std::thread(&vtkInternal::ProcessFramesets, this);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusIntelRealSense::vtkInternal::StopProcessing()
+{
+  if (!this->ProcessingThread.joinable())
+  {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->QueueMutex);
+    this->StopProcessingRequested = true;
+  }
+  this->QueueCondition.notify_all();
+  this->ProcessingThread.join();
+  if (this->NumberOfDroppedFramesets > 0)
+  {
+    LOG_WARNING("Intel RealSense frame processing could not keep up with the acquisition, " << this->NumberOfDroppedFramesets << " framesets were dropped");
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusIntelRealSense::vtkInternal::QueueFrameset(const rs2::frameset& frames, unsigned long frameNumber, double timestamp)
+{
+  {
+    std::lock_guard<std::mutex> lock(this->QueueMutex);
+    if (this->Queue.size() >= MAXIMUM_NUMBER_OF_QUEUED_FRAMESETS)
+    {
+      if (this->NumberOfDroppedFramesets == 0)
+      {
+        LOG_WARNING("Intel RealSense frame processing cannot keep up with the acquisition, framesets are dropped");
+      }
+      ++this->NumberOfDroppedFramesets;
+      this->Queue.pop_front();
+    }
+    QueuedFrameset frameset;
+    frameset.Frames = frames;
+    frameset.FrameNumber = frameNumber;
+    frameset.Timestamp = timestamp;
+    this->Queue.push_back(frameset);
+  }
+  this->QueueCondition.notify_one();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusIntelRealSense::vtkInternal::ProcessFramesets()
+{
+  while (true)
+  {
+    QueuedFrameset frameset;
+    {
+      std::unique_lock<std::mutex> lock(this->QueueMutex);
+      while (!this->StopProcessingRequested && this->Queue.empty())
+      {
+        this->QueueCondition.wait(lock);
+      }
+      if (this->Queue.empty())
+      {
+        // stop is requested and all the queued framesets are processed
+        break;
+      }
+      frameset = this->Queue.front();
+      this->Queue.pop_front();
+    }
+
+    try
+    {
+      this->AddFrameset(frameset);
+    }
+    catch (rs2::error e)
+    {
+      LOG_ERROR("Failed to process IntelRealSense frames. RealSense API gave the error: '" << e.what() << "'");
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIntelRealSense::vtkInternal::AddFrameset(QueuedFrameset& frameset)
+{
+  rs2::frameset& frames = frameset.Frames;
+
+  // if requested, align depth to color (the depth frame is not needed if it is not used)
+  if (this->Align != nullptr)
+  {
+    frames = this->Align->process(frames);
+  }
+
+  // forward video data to PlusDataSource
+  std::vector<RSFrameConfig>::iterator it;
+  for (it = begin(this->VideoSources); it != end(this->VideoSources); it++)
+  {
+    // if source is null, return an error
+    if (it->Source == nullptr)
+    {
+      LOG_WARNING("vtkPlusIntelRealSense::InternalUpdate Unable to grab video source '" << it->SourceName << "'. Skipping frame.");
+      return PLUS_FAIL;
+    }
+
+    if (this->SkipUnusedStreams && !it->Used)
+    {
+      // no output channel uses this source, do not convert or store its frames
+      continue;
+    }
+
+    if (it->PointCloud)
+    {
+      if (this->AddPointCloud(*it, frames, frameset) != PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+      continue;
+    }
+
+    // if this is the first frame, initialize the buffer
+    if (it->Source->GetNumberOfItems() == 0 && it->StreamType == RS2_STREAM_COLOR)
+    {
+      LOG_INFO("setting up color frame");
+      it->Source->SetImageType(US_IMG_RGB_COLOR);
+      it->Source->SetPixelType(VTK_UNSIGNED_CHAR);
+      it->Source->SetNumberOfScalarComponents(3);
+      it->Source->SetInputFrameSize(it->Width, it->Height, 1);
+    }
+    else if (it->Source->GetNumberOfItems() == 0 && it->StreamType == RS2_STREAM_DEPTH)
+    {
+      if (this->UseRealSenseColorizer)
+      {
+        // depth output is RGB from rs2::colorizer
+        it->Source->SetImageType(US_IMG_RGB_COLOR);
+        it->Source->SetPixelType(VTK_UNSIGNED_CHAR);
+        it->Source->SetNumberOfScalarComponents(3);
+        it->Source->SetInputFrameSize(it->Width, it->Height, 1);
+      }
+      else
+      {
+        // depth output is raw depth data
+        LOG_INFO("setting up depth frame");
+        it->Source->SetImageType(US_IMG_BRIGHTNESS);
+        it->Source->SetPixelType(VTK_TYPE_UINT16);
+        it->Source->SetNumberOfScalarComponents(1);
+        it->Source->SetInputFrameSize(it->Width, it->Height, 1);
+      }
+    }
+
+    // get frame data
+    rs2::frame frame = frames.first(it->StreamType);
+    if (!frame)
+    {
+      LOG_ERROR("Failed to get IntelRealSense frame");
+      return PLUS_FAIL;
+    }
+
+    // add frame to PLUS buffer
+    if (it->StreamType == RS2_STREAM_COLOR)
+    {
+      FrameSizeType frameSizeColor = { it->Width, it->Height, 1 };
+      if (it->Source->AddItem((void *)frame.get_data(), it->Source->GetInputImageOrientation(), frameSizeColor, VTK_UNSIGNED_CHAR, 3, US_IMG_RGB_COLOR, 0, frameset.FrameNumber, frameset.Timestamp) == PLUS_FAIL)
+      {
+        LOG_ERROR("vtkPlusIntelRealSense::InternalUpdate Unable to send RGB image. Skipping frame.");
+        return PLUS_FAIL;
+      }
+    }
+    else if (it->StreamType == RS2_STREAM_DEPTH)
+    {
+      FrameSizeType frameSizeDepth = { it->Width, it->Height, 1 };
+      if (this->UseRealSenseColorizer)
+      {
+        rs2::video_frame vfr = this->Colorizer.colorize(frame);
+        if (it->Source->AddItem((void *)vfr.get_data(), it->Source->GetInputImageOrientation(), frameSizeDepth, VTK_UNSIGNED_CHAR, 3, US_IMG_RGB_COLOR, 0, frameset.FrameNumber, frameset.Timestamp) == PLUS_FAIL)
+        {
+          LOG_ERROR("vtkPlusIntelRealSense::InternalUpdate Unable to send RGB image. Skipping frame.");
+          return PLUS_FAIL;
+        }
+      }
+      else
+      {
+        if (it->Source->AddItem((void *)frame.get_data(), it->Source->GetInputImageOrientation(), frameSizeDepth, VTK_TYPE_UINT16, 1, US_IMG_BRIGHTNESS, 0, frameset.FrameNumber, frameset.Timestamp) == PLUS_FAIL)
+        {
+          LOG_ERROR("vtkPlusIntelRealSense::InternalUpdate Unable to send DEPTH image. Skipping frame.");
+          return PLUS_FAIL;
+        }
+      }
+    }
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIntelRealSense::vtkInternal::AddPointCloud(RSFrameConfig& source, rs2::frameset& frames, const QueuedFrameset& frameset)
+{
+  if (source.Source->GetNumberOfItems() == 0)
+  {
+    LOG_INFO("setting up point cloud frame");
+    source.Source->SetImageType(US_IMG_BRIGHTNESS);
+    source.Source->SetPixelType(VTK_FLOAT);
+    source.Source->SetNumberOfScalarComponents(3);
+    source.Source->SetInputFrameSize(source.MaximumNumberOfPoints, 1, 1);
+  }
+
+  // the depth frame may be aligned to another stream, its own size and intrinsics are used
+  rs2::video_frame depthFrame = frames.first(RS2_STREAM_DEPTH).as<rs2::video_frame>();
+  if (!depthFrame)
+  {
+    LOG_ERROR("Failed to get IntelRealSense depth frame for point cloud");
+    return PLUS_FAIL;
+  }
+  rs2_intrinsics intrinsics = depthFrame.get_profile().as<rs2::video_stream_profile>().get_intrinsics();
+  const uint16_t* depth = static_cast<const uint16_t*>(depthFrame.get_data());
+  const int depthStride = depthFrame.get_stride_in_bytes() / static_cast<int>(sizeof(uint16_t));
+  // the depth scale of the sensor is in meters
+  const float depthUnitToMm = this->DepthScaleToMm * 1000.0f;
+  const size_t frameSizeInBytes = static_cast<size_t>(source.MaximumNumberOfPoints) * 3 * sizeof(float);
+  FrameSizeType frameSize = { source.MaximumNumberOfPoints, 1, 1 };
+
+  // the points are written directly into the buffer if possible
+  void* frameDataPtr(nullptr);
+  unsigned int reservedFrameSizeInBytes(0);
+  if (CanReserveItem(source.Source) && source.Source->ReserveNewItem(frameDataPtr, reservedFrameSizeInBytes) == PLUS_SUCCESS)
+  {
+    if (reservedFrameSizeInBytes == frameSizeInBytes)
+    {
+      source.PointCloud->Generate(depth, depthStride, intrinsics, depthUnitToMm, static_cast<float*>(frameDataPtr), source.MaximumNumberOfPoints);
+      if (source.Source->CommitReservedItem(frameset.FrameNumber, frameset.Timestamp) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("vtkPlusIntelRealSense::InternalUpdate Unable to send point cloud. Skipping frame.");
+        return PLUS_FAIL;
+      }
+      return PLUS_SUCCESS;
+    }
+    source.Source->CancelReservedItem();
+  }
+
+  this->PointCloudFrame.resize(static_cast<size_t>(source.MaximumNumberOfPoints) * 3);
+  source.PointCloud->Generate(depth, depthStride, intrinsics, depthUnitToMm, this->PointCloudFrame.data(), source.MaximumNumberOfPoints);
+  if (source.Source->AddItem(this->PointCloudFrame.data(), source.Source->GetInputImageOrientation(), frameSize, VTK_FLOAT, 3, US_IMG_BRIGHTNESS, 0, frameset.FrameNumber, frameset.Timestamp) == PLUS_FAIL)
+  {
+    LOG_ERROR("vtkPlusIntelRealSense::InternalUpdate Unable to send point cloud. Skipping frame.");
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 vtkPlusIntelRealSense::vtkPlusIntelRealSense()
   : Internal(new vtkInternal(this))
@@ -155,6 +750,7 @@ vtkPlusIntelRealSense::vtkPlusIntelRealSense()
 //----------------------------------------------------------------------------
 vtkPlusIntelRealSense::~vtkPlusIntelRealSense()
 {
+  this->Internal->StopProcessing();
   delete Internal;
   Internal = nullptr;
 }
@@ -175,6 +771,7 @@ PlusStatus vtkPlusIntelRealSense::ReadConfiguration(vtkXMLDataElement* rootConfi
   XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_READING(deviceConfig, rootConfigElement);
   XML_READ_BOOL_ATTRIBUTE_NONMEMBER_OPTIONAL(UseRealSenseColorizer, this->Internal->UseRealSenseColorizer, deviceConfig);
   XML_READ_BOOL_ATTRIBUTE_NONMEMBER_OPTIONAL(AlignDepthStream, this->Internal->AlignDepthStream, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_NONMEMBER_OPTIONAL(SkipUnusedStreams, this->Internal->SkipUnusedStreams, deviceConfig);
 
   XML_FIND_NESTED_ELEMENT_REQUIRED(dataSourcesElement, deviceConfig, "DataSources");
   for (int nestedElementIndex = 0; nestedElementIndex < dataSourcesElement->GetNumberOfNestedElements(); nestedElementIndex++)
@@ -198,14 +795,41 @@ PlusStatus vtkPlusIntelRealSense::ReadConfiguration(vtkXMLDataElement* rootConfi
         continue;
       }
 
-      // get Intel RealSense video parameters for this source
+      // get Intel RealSense video parameters for this source, point clouds are computed from the depth stream
+      const char* frameType = dataElement->GetAttribute("FrameType");
+      bool pointCloud = (frameType != NULL && STRCASECMP(frameType, "POINTCLOUD") == 0);
       rs2_stream sourceType;
-      XML_READ_ENUM2_ATTRIBUTE_NONMEMBER_REQUIRED(FrameType, sourceType, dataElement, "RGB", RS2_STREAM_COLOR, "DEPTH", RS2_STREAM_DEPTH);
+      if (pointCloud)
+      {
+        sourceType = RS2_STREAM_DEPTH;
+      }
+      else
+      {
+        XML_READ_ENUM2_ATTRIBUTE_NONMEMBER_REQUIRED(FrameType, sourceType, dataElement, "RGB", RS2_STREAM_COLOR, "DEPTH", RS2_STREAM_DEPTH);
+      }
       int frameSize[2] = { REALSENSE_DEFAULT_FRAME_WIDTH, REALSENSE_DEFAULT_FRAME_HEIGHT };
       XML_READ_VECTOR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, 2, FrameSize, frameSize, dataElement);
       int frameRate = REALSENSE_DEFAULT_FRAME_RATE;
       XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, FrameRate, frameRate, dataElement);
       vtkInternal::RSFrameConfig source(sourceType, toolId, frameSize[0], frameSize[1], frameRate);
+      if (pointCloud)
+      {
+        float voxelSize = 0;
+        XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(float, VoxelSize, voxelSize, dataElement);
+        float minimumDepth = 0;
+        XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(float, MinimumDepth, minimumDepth, dataElement);
+        float maximumDepth = 0;
+        XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(float, MaximumDepth, maximumDepth, dataElement);
+        int maximumNumberOfPoints = frameSize[0] * frameSize[1];
+        XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, MaximumNumberOfPoints, maximumNumberOfPoints, dataElement);
+        if (maximumNumberOfPoints <= 0)
+        {
+          LOG_ERROR("MaximumNumberOfPoints of IntelRealSense point cloud data source " << toolId << " must be positive");
+          return PLUS_FAIL;
+        }
+        source.PointCloud = std::make_shared<PointCloudGenerator>(voxelSize, minimumDepth, maximumDepth);
+        source.MaximumNumberOfPoints = static_cast<unsigned int>(maximumNumberOfPoints);
+      }
       this->Internal->VideoSources.push_back(source);
     }
     else
@@ -242,6 +866,16 @@ PlusStatus vtkPlusIntelRealSense::WriteConfiguration(vtkXMLDataElement* rootConf
     deviceConfig->SetAttribute("AlignDepthStream", "FALSE");
   }
 
+  // write bool SkipUnusedStreams
+  if (this->Internal->SkipUnusedStreams)
+  {
+    deviceConfig->SetAttribute("SkipUnusedStreams", "TRUE");
+  }
+  else
+  {
+    XML_REMOVE_ATTRIBUTE("SkipUnusedStreams", deviceConfig);
+  }
+
   return PLUS_SUCCESS;
 }
 
@@ -266,6 +900,15 @@ PlusStatus vtkPlusIntelRealSense::InternalConnect()
 
     // get Plus data source for this stream
     GetVideoSource(it->SourceName.c_str(), it->Source);
+    it->Used = false;
+    for (ChannelContainerConstIterator channelIt = this->GetOutputChannelsStart(); channelIt != this->GetOutputChannelsEnd(); ++channelIt)
+    {
+      vtkPlusDataSource* channelSource(nullptr);
+      if ((*channelIt)->GetVideoSource(channelSource) == PLUS_SUCCESS && channelSource == it->Source)
+      {
+        it->Used = true;
+      }
+    }
 
     // enable stream on RealSense
     this->Internal->Config.enable_stream(
@@ -335,16 +978,26 @@ PlusStatus vtkPlusIntelRealSense::InternalStartRecording()
     return PLUS_FAIL;
   }
 
-  if (this->Internal->AlignDepthStream)
+  if (this->Internal->AlignDepthStream && this->Internal->IsDepthStreamUsed())
   {
     // setup to align depth frame to color
     if (this->Internal->SetStreamToAlign(this->Internal->Profile.get_streams()) == PLUS_FAIL)
     {
       return PLUS_FAIL;
     }
+    delete this->Internal->Align;
     this->Internal->Align = new rs2::align(this->Internal->AlignTo);
   }
 
+  if (this->Internal->UseRealSenseColorizer)
+  {
+    this->Internal->Colorizer.set_option(RS2_OPTION_HISTOGRAM_EQUALIZATION_ENABLED, 1);
+    this->Internal->Colorizer.set_option(RS2_OPTION_MIN_DISTANCE, 0.6);
+    this->Internal->Colorizer.set_option(RS2_OPTION_MAX_DISTANCE, 1.0);
+  }
+
+  this->Internal->StartProcessing();
+
   return PLUS_SUCCESS;
 }
 
@@ -352,6 +1005,8 @@ PlusStatus vtkPlusIntelRealSense::InternalStartRecording()
 PlusStatus vtkPlusIntelRealSense::InternalStopRecording()
 {
   this->Internal->Pipe.stop();
+  // add the framesets that are still queued
+  this->Internal->StopProcessing();
   return PLUS_SUCCESS;
 }
 
@@ -367,99 +1022,11 @@ PlusStatus vtkPlusIntelRealSense::InternalUpdate()
 {
   // wait for frame
   rs2::frameset frames = this->Internal->Pipe.wait_for_frames();
+  double timestamp = vtkIGSIOAccurateTimer::GetSystemTime();
 
-  // if requested, align depth to color
-  if (this->Internal->AlignDepthStream)
-  {
-    frames = this->Internal->Align->process(frames);
-  }
-  
-  // forward video data to PlusDataSource
-  std::vector<vtkInternal::RSFrameConfig>::iterator it;
-  for (it = begin(this->Internal->VideoSources); it != end(this->Internal->VideoSources); it++)
-  {
-    // if source is null, return an error
-    if (it->Source == nullptr)
-    {
-      LOG_WARNING("vtkPlusIntelRealSense::InternalUpdate Unable to grab video source '" << it->SourceName << "'. Skipping frame.");
-      return PLUS_FAIL;
-    }
-
-    // if this is the first frame, initialize the buffer
-    if (it->Source->GetNumberOfItems() == 0 && it->StreamType == RS2_STREAM_COLOR)
-    {
-      LOG_INFO("setting up color frame");
-      it->Source->SetImageType(US_IMG_RGB_COLOR);
-      it->Source->SetPixelType(VTK_UNSIGNED_CHAR);
-      it->Source->SetNumberOfScalarComponents(3);
-      it->Source->SetInputFrameSize(it->Width, it->Height, 1);
-    }
-    else if (it->Source->GetNumberOfItems() == 0 && it->StreamType == RS2_STREAM_DEPTH)
-    {
-      if (this->Internal->UseRealSenseColorizer)
-      {
-        // depth output is RGB from rs2::colorizer
-        it->Source->SetImageType(US_IMG_RGB_COLOR);
-        it->Source->SetPixelType(VTK_UNSIGNED_CHAR);
-        it->Source->SetNumberOfScalarComponents(3);
-        it->Source->SetInputFrameSize(it->Width, it->Height, 1);
-      }
-      else
-      {
-        // depth output is raw depth data
-        LOG_INFO("setting up depth frame");
-        it->Source->SetImageType(US_IMG_BRIGHTNESS);
-        it->Source->SetPixelType(VTK_TYPE_UINT16);
-        it->Source->SetNumberOfScalarComponents(1);
-        it->Source->SetInputFrameSize(it->Width, it->Height, 1);
-      }
-    }
-
-    // get frame data
-    rs2::frame frame = frames.first(it->StreamType);
-    if (!frame)
-    {
-      LOG_ERROR("Failed to get IntelRealSense frame");
-      return PLUS_FAIL;
-    }
-
-    // add frame to PLUS buffer
-    if (it->StreamType == RS2_STREAM_COLOR)
-    {
-      FrameSizeType frameSizeColor = { it->Width, it->Height, 1 };
-      if (it->Source->AddItem((void *)frame.get_data(), it->Source->GetInputImageOrientation(), frameSizeColor, VTK_UNSIGNED_CHAR, 3, US_IMG_RGB_COLOR, 0, this->FrameNumber) == PLUS_FAIL)
-      {
-        LOG_ERROR("vtkPlusIntelRealSense::InternalUpdate Unable to send RGB image. Skipping frame.");
-        return PLUS_FAIL;
-      }
-    }
-    else if (it->StreamType == RS2_STREAM_DEPTH)
-    {
-      FrameSizeType frameSizeDepth = { it->Width, it->Height, 1 };
-      if (this->Internal->UseRealSenseColorizer)
-      {
-        rs2::colorizer color;
-        color.set_option(RS2_OPTION_HISTOGRAM_EQUALIZATION_ENABLED, 1);
-        color.set_option(RS2_OPTION_MIN_DISTANCE, 0.6);
-        color.set_option(RS2_OPTION_MAX_DISTANCE, 1.0);
-        rs2::video_frame vfr = color.colorize(frame);
-        if (it->Source->AddItem((void *)vfr.get_data(), it->Source->GetInputImageOrientation(), frameSizeDepth, VTK_UNSIGNED_CHAR, 3, US_IMG_RGB_COLOR, 0, this->FrameNumber) == PLUS_FAIL)
-        {
-          LOG_ERROR("vtkPlusIntelRealSense::InternalUpdate Unable to send RGB image. Skipping frame.");
-          return PLUS_FAIL;
-        }
-      }
-      else
-      {
-        if (it->Source->AddItem((void *)frame.get_data(), it->Source->GetInputImageOrientation(), frameSizeDepth, VTK_TYPE_UINT16, 1, US_IMG_BRIGHTNESS, 0, this->FrameNumber) == PLUS_FAIL)
-        {
-          LOG_ERROR("vtkPlusIntelRealSense::InternalUpdate Unable to send DEPTH image. Skipping frame.");
-          return PLUS_FAIL;
-        }
-      }
-    }
-  }
+  // alignment, colorization and copying to the buffers run on the processing thread
+  this->Internal->QueueFrameset(frames, this->FrameNumber, timestamp);
 
-  this->FrameNumber++; 
+  this->FrameNumber++;
   return PLUS_SUCCESS;
-}
\ No newline at end of file
+}
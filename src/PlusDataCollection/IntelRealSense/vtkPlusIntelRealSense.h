@@ -7,7 +7,7 @@
 #ifndef __vtkPlusIntelRealSense_h
 #define __vtkPlusIntelRealSense_h
 
-#include "vtkPlusDataCollectionExport.h"
+#include "PlusDevicePlugin.h"
 #include "vtkPlusDevice.h"
 
 /*!
@@ -15,7 +15,7 @@
   \brief Interface class to Intel RealSense cameras
   \ingroup PlusLibDataCollection
 */
-class vtkPlusDataCollectionExport vtkPlusIntelRealSense : public vtkPlusDevice
+class vtkPlusDeviceExport vtkPlusIntelRealSense : public vtkPlusDevice
 {
 public:
 
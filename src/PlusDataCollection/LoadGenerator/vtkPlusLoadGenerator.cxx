@@ -0,0 +1,319 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+
+#include "vtkPlusLoadGenerator.h"
+
+#include "vtkIGSIOAccurateTimer.h"
+#include "vtkMath.h"
+#include "vtkMatrix4x4.h"
+#include "vtkObjectFactory.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataSource.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+vtkStandardNewMacro(vtkPlusLoadGenerator);
+
+namespace
+{
+  // The video pattern repeats after this many frames
+  const unsigned int VIDEO_PATTERN_PERIOD = 256;
+  // Size of the sequence counter that is embedded in the video frames
+  const unsigned int SEQUENCE_COUNTER_SIZE_BYTES = 8;
+  // Rotation of the tools between consecutive items
+  const double TOOL_ROTATION_STEP_DEG = 0.1;
+  // Distance between the positions of consecutive tools along the X axis
+  const double TOOL_SPACING_MM = 10.0;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusLoadGenerator::vtkPlusLoadGenerator()
+  : NumberOfScalarComponents(1)
+  , NumberOfGeneratedTools(0)
+  , GeneratedToolBufferSize(150)
+  , VideoSource(NULL)
+  , FirstItemTimestamp(-1.0)
+  , LastItemIndex(0)
+  , NumberOfGeneratedItems(0)
+  , NumberOfSkippedItems(0)
+{
+  this->FrameSize[0] = 640;
+  this->FrameSize[1] = 480;
+  this->FrameSize[2] = 1;
+
+  this->RequirePortNameInDeviceSetConfiguration = false;
+
+  // No callback function provided by the device, so the data capture thread will be used to generate the items
+  this->StartThreadForInternalUpdates = true;
+  this->AcquisitionRate = 30;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusLoadGenerator::~vtkPlusLoadGenerator()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusLoadGenerator::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "FrameSize: " << this->FrameSize[0] << " " << this->FrameSize[1] << " " << this->FrameSize[2] << std::endl;
+  os << indent << "NumberOfScalarComponents: " << this->NumberOfScalarComponents << std::endl;
+  os << indent << "NumberOfGeneratedTools: " << this->NumberOfGeneratedTools << std::endl;
+  os << indent << "GeneratedToolBufferSize: " << this->GeneratedToolBufferSize << std::endl;
+  os << indent << "NumberOfGeneratedItems: " << this->NumberOfGeneratedItems << std::endl;
+  os << indent << "NumberOfSkippedItems: " << this->NumberOfSkippedItems << std::endl;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusLoadGenerator::SetFrameSize(const FrameSizeType& frameSize)
+{
+  this->FrameSize = frameSize;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+FrameSizeType vtkPlusLoadGenerator::GetFrameSize() const
+{
+  return this->FrameSize;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusLoadGenerator::ReadConfiguration(vtkXMLDataElement* rootConfigElement)
+{
+  LOG_TRACE("vtkPlusLoadGenerator::ReadConfiguration");
+  XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_READING(deviceConfig, rootConfigElement);
+
+  XML_READ_STD_ARRAY_ATTRIBUTE_OPTIONAL(int, 3, FrameSize, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfScalarComponents, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfGeneratedTools, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, GeneratedToolBufferSize, deviceConfig);
+
+  if (this->NumberOfScalarComponents != 1 && this->NumberOfScalarComponents != 3 && this->NumberOfScalarComponents != 4)
+  {
+    LOG_ERROR("Invalid NumberOfScalarComponents: " << this->NumberOfScalarComponents << ". Valid values are 1, 3 and 4.");
+    return PLUS_FAIL;
+  }
+
+  return this->CreateGeneratedTools();
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusLoadGenerator::WriteConfiguration(vtkXMLDataElement* rootConfigElement)
+{
+  XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_WRITING(deviceConfig, rootConfigElement);
+
+  int frameSize[3] = { static_cast<int>(this->FrameSize[0]), static_cast<int>(this->FrameSize[1]), static_cast<int>(this->FrameSize[2]) };
+  deviceConfig->SetVectorAttribute("FrameSize", 3, frameSize);
+  deviceConfig->SetIntAttribute("NumberOfScalarComponents", this->NumberOfScalarComponents);
+  deviceConfig->SetIntAttribute("NumberOfGeneratedTools", this->NumberOfGeneratedTools);
+  deviceConfig->SetIntAttribute("GeneratedToolBufferSize", this->GeneratedToolBufferSize);
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusLoadGenerator::CreateGeneratedTools()
+{
+  PlusStatus status = PLUS_SUCCESS;
+  for (int toolIndex = 0; toolIndex < this->NumberOfGeneratedTools; toolIndex++)
+  {
+    std::ostringstream toolName;
+    toolName << "Tool" << std::setw(4) << std::setfill('0') << toolIndex;
+    igsioTransformName toolToReferenceName(toolName.str(), this->GetToolReferenceFrameName());
+
+    vtkSmartPointer<vtkPlusDataSource> tool = vtkSmartPointer<vtkPlusDataSource>::New();
+    tool->SetType(DATA_SOURCE_TYPE_TOOL);
+    tool->SetReferenceCoordinateFrameName(this->GetToolReferenceFrameName());
+    tool->SetId(toolToReferenceName.GetTransformName());
+    tool->SetBufferSize(this->GeneratedToolBufferSize);
+    if (this->AddTool(tool) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to add generated tool " << tool->GetId() << " to device " << this->GetDeviceId());
+      status = PLUS_FAIL;
+      continue;
+    }
+    for (ChannelContainerIterator it = this->OutputChannels.begin(); it != this->OutputChannels.end(); ++it)
+    {
+      (*it)->AddTool(tool);
+    }
+  }
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusLoadGenerator::InternalConnect()
+{
+  LOG_TRACE("vtkPlusLoadGenerator::InternalConnect");
+
+  this->VideoSource = NULL;
+  this->VideoPattern.clear();
+  if (this->GetFirstVideoSource(this->VideoSource) == PLUS_SUCCESS && this->VideoSource != NULL)
+  {
+    this->VideoSource->SetPixelType(VTK_UNSIGNED_CHAR);
+    this->VideoSource->SetNumberOfScalarComponents(this->NumberOfScalarComponents);
+    this->VideoSource->SetImageType(this->NumberOfScalarComponents == 1 ? US_IMG_BRIGHTNESS : US_IMG_RGB_COLOR);
+    this->VideoSource->SetInputFrameSize(this->FrameSize);
+
+    // Frame k is the part of the pattern that starts at row (k modulo VIDEO_PATTERN_PERIOD),
+    // so pixel (byte, row) of frame k is (byte + row + k) modulo 256
+    size_t rowSizeInBytes = static_cast<size_t>(this->FrameSize[0]) * this->NumberOfScalarComponents;
+    size_t numberOfRows = static_cast<size_t>(this->FrameSize[1]) * this->FrameSize[2] + VIDEO_PATTERN_PERIOD;
+    this->VideoPattern.resize(rowSizeInBytes * numberOfRows);
+    for (size_t row = 0; row < numberOfRows; row++)
+    {
+      unsigned char* rowPtr = &this->VideoPattern[0] + row * rowSizeInBytes;
+      for (size_t byteIndex = 0; byteIndex < rowSizeInBytes; byteIndex++)
+      {
+        rowPtr[byteIndex] = static_cast<unsigned char>((byteIndex + row) & 0xFF);
+      }
+    }
+  }
+
+  // Tool i is the i-th tool in the order of the tool IDs
+  this->ToolMatrices.clear();
+  this->ToolItems.clear();
+  for (DataSourceContainerConstIterator it = this->GetToolIteratorBegin(); it != this->GetToolIteratorEnd(); ++it)
+  {
+    vtkSmartPointer<vtkMatrix4x4> toolMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    this->ToolMatrices.push_back(toolMatrix);
+    this->ToolItems.push_back(ToolTimeStampedItem(it->second->GetId(), toolMatrix, TOOL_OK, 0));
+  }
+
+  if (this->VideoSource == NULL && this->ToolItems.empty())
+  {
+    LOG_ERROR("vtkPlusLoadGenerator device " << this->GetDeviceId() << " has no video source and no tools, there is nothing to generate");
+    return PLUS_FAIL;
+  }
+
+  if (this->VideoSource != NULL)
+  {
+    LOG_INFO("Load generator " << this->GetDeviceId() << " generates " << this->FrameSize[0] << "x" << this->FrameSize[1] << "x" << this->FrameSize[2]
+             << " video frames with " << this->NumberOfScalarComponents << " components at " << this->GetAcquisitionRate() << "Hz");
+  }
+  if (!this->ToolItems.empty())
+  {
+    LOG_INFO("Load generator " << this->GetDeviceId() << " generates the poses of " << this->ToolItems.size() << " tools at " << this->GetAcquisitionRate() << "Hz");
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusLoadGenerator::InternalDisconnect()
+{
+  this->VideoSource = NULL;
+  this->VideoPattern.clear();
+  this->ToolItems.clear();
+  this->ToolMatrices.clear();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusLoadGenerator::InternalStartRecording()
+{
+  this->FirstItemTimestamp = -1.0;
+  this->LastItemIndex = 0;
+  this->NumberOfGeneratedItems = 0;
+  this->NumberOfSkippedItems = 0;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusLoadGenerator::InternalStopRecording()
+{
+  LOG_INFO("Load generator " << this->GetDeviceId() << " generated " << this->NumberOfGeneratedItems << " items, skipped " << this->NumberOfSkippedItems << " items");
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusLoadGenerator::InternalUpdate()
+{
+  double currentTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  double acquisitionRate = this->GetAcquisitionRate();
+
+  unsigned long itemIndex = 0;
+  if (this->FirstItemTimestamp < 0)
+  {
+    this->FirstItemTimestamp = currentTime;
+  }
+  else
+  {
+    // The scheduler runs the updates at absolute deadlines, so the index of the scheduled time is found by rounding
+    // (which tolerates the wake-up jitter). If deadlines were missed then the corresponding items are skipped.
+    double scheduledItemIndex = floor((currentTime - this->FirstItemTimestamp) * acquisitionRate + 0.5);
+    itemIndex = std::max(this->LastItemIndex + 1, static_cast<unsigned long>(std::max(scheduledItemIndex, 0.0)));
+    if (itemIndex > this->LastItemIndex + 1)
+    {
+      this->NumberOfSkippedItems += itemIndex - this->LastItemIndex - 1;
+      LOG_DEBUG("Load generator " << this->GetDeviceId() << " skipped " << itemIndex - this->LastItemIndex - 1 << " items at item " << itemIndex);
+    }
+  }
+  this->LastItemIndex = itemIndex;
+  double timestamp = this->FirstItemTimestamp + itemIndex / acquisitionRate;
+
+  PlusStatus status = PLUS_SUCCESS;
+  if (this->VideoSource != NULL && this->AddVideoFrame(itemIndex, timestamp) != PLUS_SUCCESS)
+  {
+    status = PLUS_FAIL;
+  }
+  if (!this->ToolItems.empty() && this->AddToolPoses(itemIndex, timestamp) != PLUS_SUCCESS)
+  {
+    status = PLUS_FAIL;
+  }
+  this->NumberOfGeneratedItems++;
+
+  this->Modified();
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusLoadGenerator::AddVideoFrame(unsigned long itemIndex, double timestamp)
+{
+  size_t rowSizeInBytes = static_cast<size_t>(this->FrameSize[0]) * this->NumberOfScalarComponents;
+  unsigned char* framePtr = &this->VideoPattern[0] + (itemIndex % VIDEO_PATTERN_PERIOD) * rowSizeInBytes;
+
+  // The counter is written into the pattern temporarily, so that the frame is copied only once (into the buffer)
+  size_t frameSizeInBytes = rowSizeInBytes * this->FrameSize[1] * this->FrameSize[2];
+  unsigned int counterSizeInBytes = static_cast<unsigned int>(std::min<size_t>(SEQUENCE_COUNTER_SIZE_BYTES, frameSizeInBytes));
+  unsigned char patternBytes[SEQUENCE_COUNTER_SIZE_BYTES] = {0};
+  std::copy(framePtr, framePtr + counterSizeInBytes, patternBytes);
+  unsigned long long counter = itemIndex;
+  for (unsigned int i = 0; i < counterSizeInBytes; i++)
+  {
+    framePtr[i] = static_cast<unsigned char>((counter >> (8 * i)) & 0xFF);
+  }
+
+  PlusStatus status = this->VideoSource->AddItem(framePtr, this->VideoSource->GetInputImageOrientation(), this->FrameSize, VTK_UNSIGNED_CHAR,
+                      this->NumberOfScalarComponents, this->VideoSource->GetImageType(), 0, itemIndex, timestamp, timestamp);
+
+  std::copy(patternBytes, patternBytes + counterSizeInBytes, framePtr);
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusLoadGenerator::AddToolPoses(unsigned long itemIndex, double timestamp)
+{
+  // All tools have the same rotation, only the translation is different
+  double angleRad = vtkMath::RadiansFromDegrees(fmod(itemIndex * TOOL_ROTATION_STEP_DEG, 360.0));
+  double cosAngle = cos(angleRad);
+  double sinAngle = sin(angleRad);
+  for (size_t toolIndex = 0; toolIndex < this->ToolItems.size(); toolIndex++)
+  {
+    vtkMatrix4x4* toolMatrix = this->ToolMatrices[toolIndex];
+    toolMatrix->SetElement(0, 0, cosAngle);
+    toolMatrix->SetElement(0, 1, -sinAngle);
+    toolMatrix->SetElement(1, 0, sinAngle);
+    toolMatrix->SetElement(1, 1, cosAngle);
+    toolMatrix->SetElement(0, 3, TOOL_SPACING_MM * toolIndex);
+    this->ToolItems[toolIndex].FrameNumber = itemIndex;
+  }
+  return this->AddTimeStampedItems(this->ToolItems, timestamp, timestamp);
+}
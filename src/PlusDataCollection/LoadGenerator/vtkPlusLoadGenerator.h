@@ -0,0 +1,123 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusLoadGenerator_h
+#define __vtkPlusLoadGenerator_h
+
+#include "vtkPlusDataCollectionExport.h"
+
+#include "vtkPlusDevice.h"
+
+#include <vector>
+
+class vtkMatrix4x4;
+
+/*!
+\class vtkPlusLoadGenerator
+\brief Synthetic device that generates video frames and tool poses at a high rate, for benchmarking Plus pipelines
+
+Frames and poses are generated at AcquisitionRate with deterministic content, so that the consumers can verify that
+no item has been dropped or modified:
+- The sequence counter of the item with index k (counted from the start of the recording) is k. It is the frame number
+  of the item and it is also embedded in the first 8 bytes of each video frame (unsigned 64-bit, little endian).
+- The timestamp of item k is the scheduled time of the item: start time + k / AcquisitionRate.
+- All other bytes of a video frame are (byte index in the row + row index + k) modulo 256, which is generated without
+  computation (the frame is copied from a larger precomputed pattern, starting at row k modulo 256).
+- Tool i (in the order of the tool IDs) is rotated around the Z axis by k * 0.1 degrees (modulo 360) and translated by 10 * i mm along the X axis.
+
+If the generation cannot keep up with the acquisition rate then items are skipped (the counter still corresponds to the
+scheduled time), the number of skipped items is reported when the recording is stopped.
+
+In addition to the tools defined in DataSource elements, NumberOfGeneratedTools tools are created (with IDs Tool0000, Tool0001, ...)
+and added to all output channels, so that a large number of tools does not have to be listed in the configuration file.
+
+\ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport vtkPlusLoadGenerator : public vtkPlusDevice
+{
+public:
+  static vtkPlusLoadGenerator* New();
+  vtkTypeMacro(vtkPlusLoadGenerator, vtkPlusDevice);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  /*! Read configuration from xml data */
+  virtual PlusStatus ReadConfiguration(vtkXMLDataElement* config);
+
+  /*! Write configuration to xml data */
+  virtual PlusStatus WriteConfiguration(vtkXMLDataElement* config);
+
+  virtual bool IsTracker() const { return this->GetNumberOfTools() > 0; }
+
+  /*! Size of the generated video frames in pixels */
+  virtual PlusStatus SetFrameSize(const FrameSizeType& frameSize);
+  virtual FrameSizeType GetFrameSize() const;
+
+  /*! Number of bytes per pixel of the generated video frames: 1 (grayscale, BRIGHTNESS image type), 3 (RGB) or 4 (RGBA) */
+  vtkSetMacro(NumberOfScalarComponents, unsigned int);
+  vtkGetMacro(NumberOfScalarComponents, unsigned int);
+
+  /*! Number of tools that are created in addition to the tools that are defined in the configuration file */
+  vtkSetMacro(NumberOfGeneratedTools, int);
+  vtkGetMacro(NumberOfGeneratedTools, int);
+
+  /*! Buffer size of the generated tools */
+  vtkSetMacro(GeneratedToolBufferSize, int);
+  vtkGetMacro(GeneratedToolBufferSize, int);
+
+  /*! Number of items that have been generated since the start of the recording */
+  vtkGetMacro(NumberOfGeneratedItems, unsigned long);
+
+  /*! Number of items that were skipped since the start of the recording, because the generation could not keep up with the acquisition rate */
+  vtkGetMacro(NumberOfSkippedItems, unsigned long);
+
+protected:
+  vtkPlusLoadGenerator();
+  virtual ~vtkPlusLoadGenerator();
+
+  /*! Create the generated tools */
+  PlusStatus CreateGeneratedTools();
+
+  virtual PlusStatus InternalConnect();
+  virtual PlusStatus InternalDisconnect();
+  virtual PlusStatus InternalStartRecording();
+  virtual PlusStatus InternalStopRecording();
+
+  /*! Generate the items of the next scheduled time */
+  virtual PlusStatus InternalUpdate();
+
+  /*! Add the video frame of item k */
+  PlusStatus AddVideoFrame(unsigned long itemIndex, double timestamp);
+
+  /*! Add the tool poses of item k */
+  PlusStatus AddToolPoses(unsigned long itemIndex, double timestamp);
+
+  FrameSizeType FrameSize;
+  unsigned int NumberOfScalarComponents;
+  int NumberOfGeneratedTools;
+  int GeneratedToolBufferSize;
+
+  /*! Video source that the frames are added to, NULL if the device has no video source */
+  vtkPlusDataSource* VideoSource;
+
+  /*! Video frame pattern, 256 rows higher than a frame */
+  std::vector<unsigned char> VideoPattern;
+
+  /*! Poses of all the tools, reused for each update */
+  std::vector< vtkSmartPointer<vtkMatrix4x4> > ToolMatrices;
+  ToolTimeStampedItemList ToolItems;
+
+  /*! System time of item 0, negative if no item has been generated since the start of the recording */
+  double FirstItemTimestamp;
+  unsigned long LastItemIndex;
+  unsigned long NumberOfGeneratedItems;
+  unsigned long NumberOfSkippedItems;
+
+private:
+  vtkPlusLoadGenerator(const vtkPlusLoadGenerator&);  // Not implemented.
+  void operator=(const vtkPlusLoadGenerator&);  // Not implemented.
+};
+
+#endif
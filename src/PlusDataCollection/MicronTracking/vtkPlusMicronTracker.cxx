@@ -27,6 +27,7 @@ See License.txt for details.
 
 // STL includes
 #include <fstream>
+#include <future>
 #include <iostream>
 #include <set>
 
@@ -47,8 +48,7 @@ vtkPlusMicronTracker::vtkPlusMicronTracker()
   , TrackerTimeToSystemTimeComputed(false)
 #endif
   , IniFile("MicronTracker.ini")
-  , FrameLeft(vtkSmartPointer<vtkImageData>::New())
-  , FrameRight(vtkSmartPointer<vtkImageData>::New())
+  , AcquireImagesOnlyWhenConsumed(false)
 {
   MicronTrackerLogger::Instance()->SetLogMessageCallback(LogMessageCallback, this);
 
@@ -59,8 +59,6 @@ vtkPlusMicronTracker::vtkPlusMicronTracker()
   this->StartThreadForInternalUpdates = true;
   this->AcquisitionRate = 20;
 
-  this->FrameLeft = vtkSmartPointer<vtkImageData>::New();
-  this->FrameRight = vtkSmartPointer<vtkImageData>::New();
   this->FrameSize[0] = 0;
   this->FrameSize[1] = 0;
   this->FrameSize[2] = 1;
@@ -165,6 +163,28 @@ PlusStatus vtkPlusMicronTracker::InternalUpdate()
     return PLUS_FAIL;
   }
 
+  // Generate a frame number, as the tool does not provide a frame number.
+  // FrameNumber will be used in ToolTimeStampedUpdate for timestamp filtering
+  ++this->FrameNumber;
+
+  // The image arrays remain valid until the next frame is grabbed, so the images are copied
+  // on a worker thread while the markers are processed
+  std::future<PlusStatus> imagesAdded;
+  if (this->AreImagesRequested())
+  {
+    unsigned char** leftImageArray = 0;
+    unsigned char** rightImageArray = 0;
+    if (this->MicronTracker->mtGetLeftRightImageArray(leftImageArray, rightImageArray) != 0) // mtOK
+    {
+      LOG_ERROR("Error getting images from MicronTracker");
+    }
+    else
+    {
+      imagesAdded = std::async(std::launch::async, &vtkPlusMicronTracker::AddImagesToVideoSources, this,
+                               (unsigned char*)leftImageArray, (unsigned char*)rightImageArray, this->FrameNumber, unfilteredTimestamp);
+    }
+  }
+
 #ifdef USE_MicronTracker_TIMESTAMPS
   if (!this->TrackerTimeToSystemTimeComputed)
   {
@@ -180,15 +200,15 @@ PlusStatus vtkPlusMicronTracker::InternalUpdate()
   if (this->MicronTracker->mtProcessFrame() != 0) // mtOK
   {
     LOG_ERROR("Error in processing a frame! (" << this->MicronTracker->GetLastErrorString() << ")");
+    if (imagesAdded.valid())
+    {
+      imagesAdded.get();
+    }
     return PLUS_FAIL;
   }
 
   this->MicronTracker->mtFindIdentifiedMarkers();
 
-  // Generate a frame number, as the tool does not provide a frame number.
-  // FrameNumber will be used in ToolTimeStampedUpdate for timestamp filtering
-  ++this->FrameNumber;
-
   int numOfIdentifiedMarkers = this->MicronTracker->mtGetIdentifiedMarkersCount();
   LOG_TRACE("Number of identified markers: " << numOfIdentifiedMarkers);
 
@@ -233,31 +253,57 @@ PlusStatus vtkPlusMicronTracker::InternalUpdate()
 #endif
   }
 
-  if (this->GetNumberOfVideoSources() > 0)
+  if (imagesAdded.valid())
   {
-    this->GetImage(this->FrameLeft, this->FrameRight);
-    vtkPlusDataSource* aSource(NULL);
-    for (int i = 0; i < this->GetNumberOfVideoSources(); ++i)
+    // The next frame must not be grabbed until the images are copied
+    if (imagesAdded.get() != PLUS_SUCCESS)
     {
-      if (this->GetVideoSourceByIndex(i, aSource) != PLUS_SUCCESS)
-      {
-        LOG_ERROR("Failed to retrieve MicronTracker video source");
-        return PLUS_FAIL;
-      }
-      aSource->SetInputImageOrientation(US_IMG_ORIENT_MN);
-      aSource->SetInputFrameSize(this->FrameSize);
-      if (aSource->AddItem((i == 0) ? this->FrameLeft : this->FrameRight, US_IMG_ORIENT_MN, US_IMG_BRIGHTNESS, this->FrameNumber, unfilteredTimestamp) != PLUS_SUCCESS)
-      {
-        LOG_ERROR("Failed to add item " << i << " to MicronTracker video source");
-        return PLUS_FAIL;
-      }
-      this->Modified();
+      return PLUS_FAIL;
     }
+    this->Modified();
   }
 
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+bool vtkPlusMicronTracker::AreImagesRequested() const
+{
+  if (this->GetNumberOfVideoSources() == 0)
+  {
+    return false;
+  }
+  if (!this->AcquireImagesOnlyWhenConsumed)
+  {
+    return true;
+  }
+  for (ChannelContainerConstIterator it = this->OutputChannels.begin(); it != this->OutputChannels.end(); ++it)
+  {
+    if ((*it)->HasVideoSource() && (*it)->GetNumberOfConsumers() > 0)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusMicronTracker::AddImagesToVideoSources(unsigned char* leftImage, unsigned char* rightImage, long frameNumber, double unfilteredTimestamp)
+{
+  std::vector<vtkPlusDataSource*> videoSources = this->GetVideoSources();
+  for (unsigned int i = 0; i < videoSources.size(); ++i)
+  {
+    // The first video source receives the left image, the second one the right image
+    if (videoSources[i]->AddItem((i == 0) ? leftImage : rightImage, US_IMG_ORIENT_MN, this->FrameSize, VTK_UNSIGNED_CHAR, 1, US_IMG_BRIGHTNESS, 0,
+                                 frameNumber, unfilteredTimestamp) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to add item " << i << " to MicronTracker video source");
+      return PLUS_FAIL;
+    }
+  }
+  return PLUS_SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusMicronTracker::RefreshMarkerTemplates()
 {
@@ -357,6 +403,7 @@ PlusStatus vtkPlusMicronTracker::ReadConfiguration(vtkXMLDataElement* rootConfig
 
   XML_READ_STRING_ATTRIBUTE_OPTIONAL(TemplateDirectory, deviceConfig);
   XML_READ_STRING_ATTRIBUTE_OPTIONAL(IniFile, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(AcquireImagesOnlyWhenConsumed, deviceConfig);
 
   return PLUS_SUCCESS;
 }
@@ -368,6 +415,7 @@ PlusStatus vtkPlusMicronTracker::WriteConfiguration(vtkXMLDataElement* rootConfi
 
   XML_WRITE_STRING_ATTRIBUTE_IF_NOT_EMPTY(TemplateDirectory, trackerConfig);
   XML_WRITE_STRING_ATTRIBUTE_IF_NOT_EMPTY(IniFile, trackerConfig);
+  XML_WRITE_BOOL_ATTRIBUTE(AcquireImagesOnlyWhenConsumed, trackerConfig);
 
   return PLUS_SUCCESS;
 }
@@ -446,6 +494,15 @@ PlusStatus vtkPlusMicronTracker::InternalConnect()
   this->FrameSize[0] = static_cast<unsigned int>(imageWidth);
   this->FrameSize[1] = static_cast<unsigned int>(imageHeight);
 
+  std::vector<vtkPlusDataSource*> videoSources = this->GetVideoSources();
+  for (std::vector<vtkPlusDataSource*>::iterator it = videoSources.begin(); it != videoSources.end(); ++it)
+  {
+    (*it)->SetInputImageOrientation(US_IMG_ORIENT_MN);
+    (*it)->SetPixelType(VTK_UNSIGNED_CHAR);
+    (*it)->SetNumberOfScalarComponents(1);
+    (*it)->SetInputFrameSize(this->FrameSize);
+  }
+
   this->IsMicronTrackingInitialized = true;
 
   return PLUS_SUCCESS;
@@ -17,6 +17,11 @@ class vtkMatrix4x4;
 /*!
   \class vtkPlusMicronTracker
   \brief Interface class to Claron MicronTracker optical trackers
+
+  The camera images of the grabbed frame are added to the video sources on a worker thread,
+  while the markers are identified and the tool poses are computed on the acquisition thread.
+  If AcquireImagesOnlyWhenConsumed is enabled then the images are not copied while none of the
+  channels of the video sources has a consumer (see vtkPlusChannel::AddConsumer).
   \ingroup PlusLibDataCollection
 */
 class vtkPlusDataCollectionExport vtkPlusMicronTracker : public vtkPlusDevice
@@ -53,6 +58,11 @@ public:
   vtkSetMacro(IniFile, std::string);
   vtkGetMacro(IniFile, std::string);
 
+  /*! If enabled then the camera images are only added to the video sources while their channels have consumers */
+  vtkSetMacro(AcquireImagesOnlyWhenConsumed, bool);
+  vtkGetMacro(AcquireImagesOnlyWhenConsumed, bool);
+  vtkBooleanMacro(AcquireImagesOnlyWhenConsumed, bool);
+
 protected:
   vtkPlusMicronTracker();
   ~vtkPlusMicronTracker();
@@ -69,19 +79,27 @@ protected:
   /*! Returns the transformation matrix of the index_th marker */
   void GetTransformMatrix(int markerIndex, vtkMatrix4x4* transformMatrix);
 
+  /*! Returns true if the camera images have to be added to the video sources */
+  bool AreImagesRequested() const;
+
+  /*!
+    Add the left and right camera images of the grabbed frame to the video sources.
+    Does not call the MicronTracker SDK, so it can run concurrently with the marker processing.
+  */
+  PlusStatus AddImagesToVideoSources(unsigned char* leftImage, unsigned char* rightImage, long frameNumber, double unfilteredTimestamp);
+
 protected:
   MicronTrackerInterface*   MicronTracker;
   bool                      IsMicronTrackingInitialized;
   std::string               TemplateDirectory;
   std::string               IniFile;
+  bool                      AcquireImagesOnlyWhenConsumed;
 
 #ifdef USE_MicronTracker_TIMESTAMPS
   double                    TrackerTimeToSystemTimeSec; // time_System = time_Tracker + TrackerTimeToSystemTimeSec
   bool                      TrackerTimeToSystemTimeComputed; // the time offset is always computed when the first frame is received after start tracking
 #endif
 
-  vtkSmartPointer<vtkImageData> FrameLeft;
-  vtkSmartPointer<vtkImageData> FrameRight;
   FrameSizeType                 FrameSize;
 
 private:
@@ -421,6 +421,9 @@ PlusStatus vtkPlusMmfVideoSource::InternalStopRecording()
 
   this->MmfSourceReader->CaptureSourceReader->Flush(this->ActiveVideoFormat.StreamIndex);
   SafeRelease(&this->MmfSourceReader->CaptureSourceReader);
+
+  // Add the frames that are still being decoded
+  this->MjpegDecoder.Stop();
   return PLUS_SUCCESS;
 }
 
@@ -506,6 +509,12 @@ PlusStatus vtkPlusMmfVideoSource::ReadConfiguration(vtkXMLDataElement* rootConfi
     this->RequestedVideoFormat.PixelFormatName = std::wstring(attr.begin(), attr.end());
   }
 
+  int numberOfDecoderThreads = 0;
+  if (deviceConfig->GetScalarAttribute("NumberOfDecoderThreads", numberOfDecoderThreads))
+  {
+    this->SetNumberOfDecoderThreads(numberOfDecoderThreads);
+  }
+
   return PLUS_SUCCESS;
 }
 
@@ -527,6 +536,14 @@ PlusStatus vtkPlusMmfVideoSource::WriteConfiguration(vtkXMLDataElement* rootConf
   deviceConfig->SetVectorAttribute("FrameSize", 2, frameSize);
   auto attr = std::string(this->RequestedVideoFormat.PixelFormatName.begin(), this->RequestedVideoFormat.PixelFormatName.end());
   deviceConfig->SetAttribute("VideoFormat", attr.c_str());
+  if (this->GetNumberOfDecoderThreads() != 0)
+  {
+    deviceConfig->SetIntAttribute("NumberOfDecoderThreads", this->GetNumberOfDecoderThreads());
+  }
+  else
+  {
+    XML_REMOVE_ATTRIBUTE("NumberOfDecoderThreads", deviceConfig);
+  }
 
   return PLUS_SUCCESS;
 }
@@ -646,7 +663,11 @@ PlusStatus vtkPlusMmfVideoSource::AddFrame(unsigned char* bufferData, DWORD buff
     return PLUS_FAIL;
   }
 
-  if (videoSource->GetImageType() == US_IMG_RGB_COLOR)
+  if (encoding == PixelCodec::PixelEncoding_MJPG)
+  {
+    // decoded by the MJPEG decoder threads after the frame rate check
+  }
+  else if (videoSource->GetImageType() == US_IMG_RGB_COLOR)
   {
     decodingStatus = PixelCodec::ConvertToBmp24(PixelCodec::ComponentOrder_RGB, encoding, frameSize[0], frameSize[1], bufferData, (unsigned char*)this->UncompressedVideoFrame.GetScalarPointer());
   }
@@ -690,7 +711,20 @@ PlusStatus vtkPlusMmfVideoSource::AddFrame(unsigned char* bufferData, DWORD buff
       return PLUS_SUCCESS;
     }
   }
-  PlusStatus status = aSource->AddItem(&this->UncompressedVideoFrame, this->FrameIndex, currentTime);
+
+  PlusStatus status(PLUS_SUCCESS);
+  if (encoding == PixelCodec::PixelEncoding_MJPG)
+  {
+    if (!this->MjpegDecoder.IsRunning() && this->MjpegDecoder.Start(aSource, frameSize) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    status = this->MjpegDecoder.AddFrame(bufferData, bufferSize, this->FrameIndex, currentTime);
+  }
+  else
+  {
+    status = aSource->AddItem(&this->UncompressedVideoFrame, this->FrameIndex, currentTime);
+  }
 
   this->Modified();
   return status;
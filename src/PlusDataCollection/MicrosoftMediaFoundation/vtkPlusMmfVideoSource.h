@@ -20,6 +20,7 @@ Authors include: Danielle Pace
 #include "vtkPlusDataCollectionExport.h"
 #include "vtkPlusDevice.h"
 #include "vtkIGSIORecursiveCriticalSection.h"
+#include "PlusMjpegDecoderPool.h"
 
 // VTK includes
 #include <vtkSmartPointer.h>
@@ -32,6 +33,8 @@ class MmfVideoSourceReader;
 
   Media foundation require Microsoft Windows SDK 7.1 or later. Download <a href="http://www.microsoft.com/en-us/download/details.aspx?id=8279">here</a>
 
+  MJPG frames are decoded on NumberOfDecoderThreads threads (0 means the number of processors), not on the capture thread.
+
   \sa vtkPlusDevice
   \ingroup PlusLibDataCollection
 */
@@ -72,6 +75,10 @@ public:
 
   virtual bool IsTracker() const { return false; }
 
+  /*! Number of threads that decode MJPG frames. If 0 then the number of processors is used. */
+  void SetNumberOfDecoderThreads(int numberOfThreads) { this->MjpegDecoder.SetNumberOfThreads(numberOfThreads); }
+  int GetNumberOfDecoderThreads() const { return this->MjpegDecoder.GetNumberOfThreads(); }
+
 protected:
   /*! Constructor */
   vtkPlusMmfVideoSource();
@@ -103,6 +110,9 @@ protected:
   VideoFormat RequestedVideoFormat;
   VideoFormat ActiveVideoFormat;
 
+  /*! Decodes MJPG frames and adds them to the video source, started when the first MJPG frame arrives */
+  MjpegDecoderPool MjpegDecoder;
+
   MmfVideoSourceReader* MmfSourceReader;
 private:
   vtkPlusMmfVideoSource(const vtkPlusMmfVideoSource&);  // Not implemented.
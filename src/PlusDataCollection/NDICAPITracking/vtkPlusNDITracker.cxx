@@ -92,6 +92,11 @@ vtkPlusNDITracker::vtkPlusNDITracker()
   , NetworkHostname("")
   , NetworkPort(8765)
   , CommandMutex(vtkIGSIORecursiveCriticalSection::New())
+  , ContinuousPolling(false)
+  , StopPollingRequested(false)
+  , LastPolledTrackerFrameNumber(0)
+  , LastPolledItemTimestamp(UNDEFINED_TIMESTAMP)
+  , TrackerFrameRate(60.0)
 {
   memset(this->CommandReply, 0, VTK_NDI_REPLY_LEN);
 
@@ -135,6 +140,8 @@ void vtkPlusNDITracker::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "LastFrameNumber: " << this->LastFrameNumber << std::endl;
   os << indent << "LeaveDeviceOpenAfterProbe: " << this->LeaveDeviceOpenAfterProbe << std::endl;
   os << indent << "CheckDSR: " << this->CheckDSR << std::endl;
+  os << indent << "ContinuousPolling: " << this->ContinuousPolling << std::endl;
+  os << indent << "TrackerFrameRate: " << this->TrackerFrameRate << std::endl;
   for (auto iter = this->NdiToolDescriptors.begin(); iter != this->NdiToolDescriptors.end(); ++iter)
   {
     os << indent << iter->first << ": " << std::endl;
@@ -437,28 +444,40 @@ PlusStatus vtkPlusNDITracker::InternalDisconnect()
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusNDITracker::InternalStartRecording()
 {
-  if (this->IsDeviceTracking)
+  if (!this->IsDeviceTracking)
   {
-    return PLUS_SUCCESS;
+    this->Command("TSTART:");
+    int errnum = ndiGetError(this->Device);
+    if (errnum)
+    {
+      LOG_ERROR("Failed TSTART: " << ndiErrorString(errnum));
+      CloseDevice(this->Device);
+      return PLUS_FAIL;
+    }
+
+    this->IsDeviceTracking = 1;
   }
 
-  this->Command("TSTART:");
-  int errnum = ndiGetError(this->Device);
-  if (errnum)
+  if (this->ContinuousPolling && !this->PollingThread.joinable())
   {
-    LOG_ERROR("Failed TSTART: " << ndiErrorString(errnum));
-    CloseDevice(this->Device);
-    return PLUS_FAIL;
+    this->StopPollingRequested = false;
+    this->LastPolledTrackerFrameNumber = 0;
+    this->LastPolledItemTimestamp = UNDEFINED_TIMESTAMP;
+    this->PollingThread = std::thread(&vtkPlusNDITracker::PollingThreadFunction, this);
   }
 
-  this->IsDeviceTracking = 1;
-
   return PLUS_SUCCESS;
 }
 
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusNDITracker::InternalStopRecording()
 {
+  if (this->PollingThread.joinable())
+  {
+    this->StopPollingRequested = true;
+    this->PollingThread.join();
+  }
+
   if (this->Device == 0)
   {
     return PLUS_FAIL;
@@ -484,6 +503,37 @@ PlusStatus vtkPlusNDITracker::InternalUpdate()
     return PLUS_FAIL;
   }
 
+  bool itemsAdded = false;
+  return this->UpdateToolsFromTracker(false, itemsAdded);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusNDITracker::PollingThreadFunction()
+{
+  while (!this->StopPollingRequested)
+  {
+    bool itemsAdded = false;
+    if (this->UpdateToolsFromTracker(true, itemsAdded) != PLUS_SUCCESS)
+    {
+      // do not flood the log and the communication line if the tracker does not respond
+      vtkIGSIOAccurateTimer::Delay(0.01);
+    }
+    else if (!itemsAdded)
+    {
+      // the tracker has not acquired a new frame yet, network connections reply much faster than the tracker frame rate
+      vtkIGSIOAccurateTimer::Delay(0.001);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusNDITracker::UpdateToolsFromTracker(bool skipRepeatedFrames, bool& itemsAdded)
+{
+  itemsAdded = false;
+
+  // the reply is parsed from the device after the command, so no other command may be sent in between
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> lock(this->CommandMutex);
+
   int errnum = 0;
   // get the transforms for all tools from the NDI
   this->Command("BX:0801");
@@ -502,14 +552,21 @@ PlusStatus vtkPlusNDITracker::InternalUpdate()
   }
 
   // default to incrementing frame count by one (in case a frame index cannot be retrieved from the tracker for a specific tool)
-  this->LastFrameNumber++;
-  int defaultToolFrameNumber = this->LastFrameNumber;
+  unsigned long lastFrameNumber = this->LastFrameNumber + 1;
+  const unsigned long defaultToolFrameNumber = lastFrameNumber;
+  unsigned long latestTrackerFrameNumber = 0;
   const double toolTimestamp = vtkIGSIOAccurateTimer::GetSystemTime(); // unfiltered timestamp
-  vtkSmartPointer<vtkMatrix4x4> toolToTrackerTransform = vtkSmartPointer<vtkMatrix4x4>::New();
+
+  // all tools are measured in the same sample, so they are added to the buffers in one batch
+  ToolTimeStampedItemList toolItems;
+  toolItems.reserve(this->GetNumberOfTools());
+  std::vector<vtkSmartPointer<vtkMatrix4x4> > toolToTrackerTransforms;
+  toolToTrackerTransforms.reserve(this->GetNumberOfTools());
   for (DataSourceContainerConstIterator it = this->GetToolIteratorBegin(); it != this->GetToolIteratorEnd(); ++it)
   {
     ToolStatus toolFlags = TOOL_OK;
-    toolToTrackerTransform->Identity();
+    vtkSmartPointer<vtkMatrix4x4> toolToTrackerTransform = vtkSmartPointer<vtkMatrix4x4>::New();
+    toolToTrackerTransforms.push_back(toolToTrackerTransform);
     unsigned long toolFrameNumber = defaultToolFrameNumber;
     vtkPlusDataSource* trackerTool = it->second;
     std::string toolSourceId = trackerTool->GetId();
@@ -517,14 +574,14 @@ PlusStatus vtkPlusNDITracker::InternalUpdate()
     if (ndiToolDescriptorIt == this->NdiToolDescriptors.end())
     {
       LOG_ERROR("Tool descriptor is not found for tool " << toolSourceId);
-      this->ToolTimeStampedUpdate(trackerTool->GetId(), toolToTrackerTransform, toolFlags, toolFrameNumber, toolTimestamp);
+      toolItems.push_back(ToolTimeStampedItem(toolSourceId, toolToTrackerTransform, toolFlags, toolFrameNumber));
       continue;
     }
     int portHandle = ndiToolDescriptorIt->second.PortHandle;
     if (portHandle <= 0)
     {
       LOG_ERROR("Port handle is invalid for tool " << toolSourceId);
-      this->ToolTimeStampedUpdate(toolSourceId.c_str(), toolToTrackerTransform, toolFlags, toolFrameNumber, toolTimestamp);
+      toolItems.push_back(ToolTimeStampedItem(toolSourceId, toolToTrackerTransform, toolFlags, toolFrameNumber));
       continue;
     }
 
@@ -564,14 +621,50 @@ PlusStatus vtkPlusNDITracker::InternalUpdate()
     {
       // this will create a timestamp from the frame number
       toolFrameNumber = ndiFrameIndex;
-      if (ndiFrameIndex > this->LastFrameNumber)
+      if (ndiFrameIndex > lastFrameNumber)
+      {
+        lastFrameNumber = ndiFrameIndex;
+      }
+      if (ndiFrameIndex > latestTrackerFrameNumber)
       {
-        this->LastFrameNumber = ndiFrameIndex;
+        latestTrackerFrameNumber = ndiFrameIndex;
       }
     }
 
-    // send the matrix and status to the tool's vtkPlusDataBuffer
-    this->ToolTimeStampedUpdate(toolSourceId.c_str(), toolToTrackerTransform, toolFlags, toolFrameNumber, toolTimestamp);
+    toolItems.push_back(ToolTimeStampedItem(toolSourceId, toolToTrackerTransform, toolFlags, toolFrameNumber));
+  }
+
+  bool addItems = true;
+  if (skipRepeatedFrames)
+  {
+    if (latestTrackerFrameNumber != 0)
+    {
+      // the tracker returns its latest frame for each request, so the same frame is received until a new one is acquired
+      addItems = (latestTrackerFrameNumber != this->LastPolledTrackerFrameNumber);
+    }
+    else
+    {
+      // no visible tool provides a tracker frame number, add the tool states at the acquisition rate
+      addItems = (this->LastPolledItemTimestamp == UNDEFINED_TIMESTAMP || this->AcquisitionRate <= 0
+                  || toolTimestamp - this->LastPolledItemTimestamp >= 1.0 / this->AcquisitionRate);
+    }
+  }
+
+  if (addItems)
+  {
+    this->LastFrameNumber = lastFrameNumber;
+    this->LastPolledTrackerFrameNumber = latestTrackerFrameNumber;
+    this->LastPolledItemTimestamp = toolTimestamp;
+    // the tracker frame number is the hardware clock of the tracker: timestamps derived from it are free of the
+    // serial communication and polling jitter
+    double filteredTimestamp = UNDEFINED_TIMESTAMP;
+    if (this->IsHardwareClockEnabled() && latestTrackerFrameNumber != 0)
+    {
+      filteredTimestamp = this->GetSystemTimeFromHardwareTimestamp(latestTrackerFrameNumber / this->TrackerFrameRate, toolTimestamp);
+    }
+    // send the matrices and statuses to the tools' vtkPlusDataBuffer
+    this->AddTimeStampedItems(toolItems, toolTimestamp, filteredTimestamp);
+    itemsAdded = true;
   }
 
   // Update tool connections if a wired tool is plugged in
@@ -1045,6 +1138,15 @@ PlusStatus vtkPlusNDITracker::ReadConfiguration(vtkXMLDataElement* rootConfigEle
   XML_READ_STRING_ATTRIBUTE_OPTIONAL(NetworkHostname, deviceConfig);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NetworkPort, deviceConfig);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(CheckDSR, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(ContinuousPolling, deviceConfig);
+  // in continuous polling mode the polling thread acquires the data, periodic updates are not needed
+  this->StartThreadForInternalUpdates = !this->ContinuousPolling;
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, TrackerFrameRate, deviceConfig);
+  if (this->TrackerFrameRate <= 0)
+  {
+    LOG_ERROR("Invalid TrackerFrameRate: " << this->TrackerFrameRate << ". It must be positive.");
+    return PLUS_FAIL;
+  }
 
   XML_FIND_NESTED_ELEMENT_REQUIRED(dataSourcesElement, deviceConfig, "DataSources");
 
@@ -1135,6 +1237,8 @@ PlusStatus vtkPlusNDITracker::WriteConfiguration(vtkXMLDataElement* rootConfig)
     trackerConfig->SetIntAttribute("MeasurementVolumeNumber", this->MeasurementVolumeNumber);
   }
   trackerConfig->SetAttribute("CheckDSR", this->CheckDSR ? "true" : "false");
+  XML_WRITE_BOOL_ATTRIBUTE(ContinuousPolling, trackerConfig);
+  trackerConfig->SetDoubleAttribute("TrackerFrameRate", this->TrackerFrameRate);
 
   return PLUS_SUCCESS;
 }
@@ -46,6 +46,10 @@ POSSIBILITY OF SUCH DAMAGES.
 
 #include "vtkPlusDevice.h"
 
+// STL includes
+#include <atomic>
+#include <thread>
+
 class vtkSocketCommunicator;
 struct ndicapi;
 
@@ -191,6 +195,22 @@ public:
   vtkSetMacro(CheckDSR, bool);
   vtkGetMacro(CheckDSR, bool);
 
+  /*!
+    If enabled then a polling thread requests the transforms (BX) back-to-back while recording, instead of once per
+    acquisition period: the next request is sent as soon as the previous reply is parsed, and all tools of a reply are
+    added in one batch. Replies that do not contain a new tracker frame are skipped. Must be set before recording starts.
+  */
+  vtkSetMacro(ContinuousPolling, bool);
+  vtkGetMacro(ContinuousPolling, bool);
+
+  /*!
+    Measurement rate of the tracker (frames per second, e.g., 60 for Polaris, 40 for Aurora). The tracker frame numbers
+    are converted to hardware timestamps by this rate if HardwareClock="Device" is set. The rate is only a starting value,
+    the actual rate of the tracker clock is estimated by the hardware clock.
+  */
+  vtkSetMacro(TrackerFrameRate, double);
+  vtkGetMacro(TrackerFrameRate, double);
+
 protected:
   vtkPlusNDITracker();
   ~vtkPlusNDITracker();
@@ -217,6 +237,16 @@ protected:
   */
   PlusStatus InternalStopRecording();
 
+  /*!
+    Request the transforms of all tools from the tracker and add them to the tool buffers in one batch.
+    If skipRepeatedFrames is set then nothing is added if the reply does not contain a new tracker frame.
+    itemsAdded is set to true if the tool items were added.
+  */
+  PlusStatus UpdateToolsFromTracker(bool skipRepeatedFrames, bool& itemsAdded);
+
+  /*! Poll the tracker until StopPollingRequested is set, runs on PollingThread in ContinuousPolling mode */
+  void PollingThreadFunction();
+
   /*! Cause the device to beep the specified number of times */
   PlusStatus Beep(int n);
 
@@ -299,6 +329,13 @@ protected:
   std::string                       NetworkHostname;
   int                               NetworkPort;
 
+  bool                              ContinuousPolling;
+  std::thread                       PollingThread;
+  std::atomic<bool>                 StopPollingRequested;
+  unsigned long                     LastPolledTrackerFrameNumber; // Most recent tracker frame number added by the polling thread
+  double                            LastPolledItemTimestamp; // Time when the polling thread last added tool items
+  double                            TrackerFrameRate;
+
 private:
   vtkPlusNDITracker(const vtkPlusNDITracker&);
   void operator=(const vtkPlusNDITracker&);
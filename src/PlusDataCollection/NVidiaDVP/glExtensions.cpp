@@ -103,6 +103,9 @@ PFNGLUNMAPBUFFERPROC                                    glUnmapBuffer = NULL;
 PFNGLMAPBUFFERRANGEPROC                                 glMapBufferRange = NULL;
 PFNGLGETBUFFERSUBDATAPROC                               glGetBufferSubData = NULL;
 
+// GL_ARB_copy_buffer
+PFNGLCOPYBUFFERSUBDATAPROC                              glCopyBufferSubData = NULL;
+
 //NV_present_video
 PFNWGLENUMERATEVIDEODEVICESNVPROC                       wglEnumerateVideoDevicesNV = NULL;
 PFNWGLBINDVIDEODEVICENVPROC                             wglBindVideoDeviceNV = NULL;
@@ -373,6 +376,15 @@ bool loadShaderObjectsExtension( void )
   return loadOK;
 }
 
+//---------------------------------------------------------------------------
+bool loadCopyBufferExtension()
+{
+  glCopyBufferSubData = ( PFNGLCOPYBUFFERSUBDATAPROC ) wglGetProcAddress( "glCopyBufferSubData" );
+
+  bool loadOK = ( glCopyBufferSubData != NULL );
+  return loadOK;
+}
+
 //---------------------------------------------------------------------------
 bool loadSyncExtension()
 {
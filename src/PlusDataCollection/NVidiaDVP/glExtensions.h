@@ -57,6 +57,7 @@ extern bool loadCaptureVideoExtension();
 extern bool loadShaderObjectsExtension( void );
 extern bool loadCopyImageExtension();
 extern bool loadSyncExtension();
+extern bool loadCopyBufferExtension();
 
 // WGL_NV_Copy_image
 extern PFNWGLCOPYIMAGESUBDATANVPROC                       wglCopyImageSubDataNV;
@@ -121,6 +122,9 @@ extern PFNGLUNMAPBUFFERPROC                               glUnmapBuffer;
 extern PFNGLMAPBUFFERRANGEPROC                            glMapBufferRange;
 extern PFNGLGETBUFFERSUBDATAPROC                          glGetBufferSubData;
 
+/// GL_ARB_copy_buffer
+extern PFNGLCOPYBUFFERSUBDATAPROC                         glCopyBufferSubData;
+
 //NV_present_video
 extern PFNWGLENUMERATEVIDEODEVICESNVPROC                  wglEnumerateVideoDevicesNV;
 extern PFNWGLBINDVIDEODEVICENVPROC                        wglBindVideoDeviceNV;
@@ -29,6 +29,10 @@ vtkStandardNewMacro(vtkPlusNvidiaDVPVideoSource);
 vtkPlusNvidiaDVPVideoSource::vtkPlusNvidiaDVPVideoSource()
   : FrameNumber(0)
   , EnableGPUCPUCopy(false)
+  , EnableGPUDirect(false)
+  , NumberOfGPUFrames(4)
+  , NextGPUFrameIndex(0)
+  , NumberOfCPUConsumers(0)
   , VideoSize( { 0, 0, 1 })
 {
   // No callback function provided by the device, so the data capture thread will be used to poll the hardware and add new items to the buffer
@@ -49,6 +53,10 @@ vtkPlusNvidiaDVPVideoSource::~vtkPlusNvidiaDVPVideoSource()
 void vtkPlusNvidiaDVPVideoSource::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "EnableGPUCPUCopy: " << (this->EnableGPUCPUCopy ? "TRUE" : "FALSE") << std::endl;
+  os << indent << "EnableGPUDirect: " << (this->EnableGPUDirect ? "TRUE" : "FALSE") << std::endl;
+  os << indent << "NumberOfGPUFrames: " << this->NumberOfGPUFrames << std::endl;
+  os << indent << "NumberOfCPUConsumers: " << this->NumberOfCPUConsumers << std::endl;
 }
 
 //----------------------------------------------------------------------------
@@ -98,28 +106,133 @@ PlusStatus vtkPlusNvidiaDVPVideoSource::InternalDisconnect()
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusNvidiaDVPVideoSource::InternalUpdate()
 {
-  CaptureVideo();
-
-  if (EnableGPUCPUCopy)
-  {
-    CopyGPUToCPU();
-    if (OutputDataSource->AddItem((void*)CPUFrame,
-                                  OutputDataSource->GetInputImageOrientation(),
-                                  OutputDataSource->GetInputFrameSize(),
-                                  VTK_UNSIGNED_CHAR, // TODO : scalar type from nvidia video format
-                                  1, // TODO : num components from nvidia video format
-                                  US_IMG_BRIGHTNESS, // TODO : img type from nvidia video format
-                                  0,
-                                  this->FrameNumber) != PLUS_SUCCESS)
+  GLenum captureResult = CaptureVideo();
+  if (captureResult != GL_SUCCESS_NV && captureResult != GL_PARTIAL_SUCCESS_NV)
+  {
+    // Nothing new is captured, the error is already logged
+    return PLUS_SUCCESS;
+  }
+  this->FrameNumber++;
+
+  if (!this->EnableGPUDirect)
+  {
+    if (EnableGPUCPUCopy)
+    {
+      CopyGPUToCPU(VideoBufferObject[0]);
+      if (OutputDataSource->AddItem((void*)CPUFrame,
+                                    OutputDataSource->GetInputImageOrientation(),
+                                    OutputDataSource->GetInputFrameSize(),
+                                    VTK_UNSIGNED_CHAR, // TODO : scalar type from nvidia video format
+                                    1, // TODO : num components from nvidia video format
+                                    US_IMG_BRIGHTNESS, // TODO : img type from nvidia video format
+                                    0,
+                                    this->FrameNumber) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Unable to capture frame from SDI capture.");
+        return PLUS_FAIL;
+      }
+    }
+    return PLUS_SUCCESS;
+  }
+
+  // The frame stays on the GPU, only its buffer object is published in the buffer
+  GLuint gpuFrameBufferObject = CopyToGPUFrame();
+  if (gpuFrameBufferObject == 0)
+  {
+    LOG_ERROR("Unable to copy the captured frame to a GPU frame buffer object.");
+    return PLUS_FAIL;
+  }
+  int pitch = NvSDIin.GetBufferObjectPitch(0);
+  igsioFieldMapType customFields;
+  customFields["GPUBufferObject"].first = FRAMEFIELD_NONE;
+  customFields["GPUBufferObject"].second = igsioCommon::ToString<GLuint>(gpuFrameBufferObject);
+  customFields["GPUBufferPitch"].first = FRAMEFIELD_NONE;
+  customFields["GPUBufferPitch"].second = igsioCommon::ToString<int>(pitch);
+  customFields["GPUBufferSize"].first = FRAMEFIELD_NONE;
+  customFields["GPUBufferSize"].second = igsioCommon::ToString<unsigned int>(VideoSize[0]) + " " + igsioCommon::ToString<unsigned int>(VideoSize[1]);
+
+  if (!IsCPUCopyRequired())
+  {
+    if (OutputDataSource->AddItem(customFields, this->FrameNumber) != PLUS_SUCCESS)
     {
-      LOG_ERROR("Unable to capture frame from SDI capture.");
+      LOG_ERROR("Unable to add GPU frame from SDI capture.");
       return PLUS_FAIL;
     }
+    return PLUS_SUCCESS;
+  }
+
+  CopyGPUToCPU(gpuFrameBufferObject);
+  if (OutputDataSource->AddItem((void*)CPUFrame,
+                                OutputDataSource->GetInputImageOrientation(),
+                                OutputDataSource->GetInputFrameSize(),
+                                VTK_UNSIGNED_CHAR, // TODO : scalar type from nvidia video format
+                                1, // TODO : num components from nvidia video format
+                                US_IMG_BRIGHTNESS, // TODO : img type from nvidia video format
+                                0,
+                                this->FrameNumber,
+                                UNDEFINED_TIMESTAMP,
+                                UNDEFINED_TIMESTAMP,
+                                &customFields) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to capture frame from SDI capture.");
+    return PLUS_FAIL;
   }
 
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusNvidiaDVPVideoSource::RegisterCPUConsumer()
+{
+  this->NumberOfCPUConsumers++;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusNvidiaDVPVideoSource::UnregisterCPUConsumer()
+{
+  if (--this->NumberOfCPUConsumers < 0)
+  {
+    LOG_WARNING("vtkPlusNvidiaDVPVideoSource: CPU consumer is unregistered more times than registered.");
+    this->NumberOfCPUConsumers = 0;
+  }
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusNvidiaDVPVideoSource::IsCPUCopyRequired() const
+{
+  return this->EnableGPUCPUCopy || this->NumberOfCPUConsumers > 0;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusNvidiaDVPVideoSource::ShareGLContext(HGLRC consumerContext)
+{
+  if (!this->Connected || HandleGLRC == NULL)
+  {
+    LOG_ERROR("Unable to share the capture GL context, the device is not connected.");
+    return PLUS_FAIL;
+  }
+  if (!wglShareLists(HandleGLRC, consumerContext))
+  {
+    LOG_ERROR("Unable to share the capture GL context (error " << GetLastError() << "). The consumer context must not have any objects yet.");
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+GLsync vtkPlusNvidiaDVPVideoSource::GetGPUFrameFence(GLuint bufferObject)
+{
+  std::lock_guard<std::mutex> lock(this->GPUFrameMutex);
+  for (size_t i = 0; i < this->GPUFrameBufferObjects.size(); ++i)
+  {
+    if (this->GPUFrameBufferObjects[i] == bufferObject)
+    {
+      return this->GPUFrameFences[i];
+    }
+  }
+  return NULL;
+}
+
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusNvidiaDVPVideoSource::ReadConfiguration(vtkXMLDataElement* rootConfigElement)
 {
@@ -127,6 +240,13 @@ PlusStatus vtkPlusNvidiaDVPVideoSource::ReadConfiguration(vtkXMLDataElement* roo
   XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_READING(deviceConfig, rootConfigElement);
 
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(EnableGPUCPUCopy, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(EnableGPUDirect, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfGPUFrames, deviceConfig);
+  if (this->NumberOfGPUFrames < 2)
+  {
+    LOG_WARNING("NumberOfGPUFrames must be at least 2, using 2.");
+    this->NumberOfGPUFrames = 2;
+  }
 
   int numGPUs;
   // Note, this function enumerates GPUs which are both CUDA & GLAffinity capable (i.e. newer Quadros)
@@ -797,6 +917,8 @@ PlusStatus vtkPlusNvidiaDVPVideoSource::WriteConfiguration(vtkXMLDataElement* ro
   XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_WRITING(deviceConfig, rootConfig);
 
   XML_WRITE_BOOL_ATTRIBUTE(EnableGPUCPUCopy, deviceConfig);
+  XML_WRITE_BOOL_ATTRIBUTE(EnableGPUDirect, deviceConfig);
+  deviceConfig->SetIntAttribute("NumberOfGPUFrames", this->NumberOfGPUFrames);
 
   return PLUS_SUCCESS;
 }
@@ -804,16 +926,16 @@ PlusStatus vtkPlusNvidiaDVPVideoSource::WriteConfiguration(vtkXMLDataElement* ro
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusNvidiaDVPVideoSource::NotifyConfigured()
 {
-  if (this->OutputChannels.size() != 1 && this->EnableGPUCPUCopy)
+  if (this->OutputChannels.size() != 1 && (this->EnableGPUCPUCopy || this->EnableGPUDirect))
   {
-    LOG_ERROR("Incorrect configuration. GPU/CPU copy and OutputChannel configuration are incompatible.");
+    LOG_ERROR("Incorrect configuration. GPU/CPU copy or GPU direct and OutputChannel configuration are incompatible.");
     this->SetCorrectlyConfigured(false);
     return PLUS_FAIL;
   }
 
-  if (this->EnableGPUCPUCopy && this->GetFirstVideoSource(OutputDataSource) != PLUS_SUCCESS)
+  if ((this->EnableGPUCPUCopy || this->EnableGPUDirect) && this->GetFirstVideoSource(OutputDataSource) != PLUS_SUCCESS)
   {
-    LOG_ERROR("Unable to find video source. Device needs a video buffer to put new frames into when copying frames from the GPU.");
+    LOG_ERROR("Unable to find video source. Device needs a video buffer to put new frames into when copying or publishing frames from the GPU.");
     this->SetCorrectlyConfigured(false);
     return PLUS_FAIL;
   }
@@ -899,6 +1021,35 @@ HRESULT vtkPlusNvidiaDVPVideoSource::SetupSDIinGL()
     assert(glGetError() == GL_NO_ERROR);
   }
 
+  if (EnableGPUDirect)
+  {
+    return SetupGPUFramesGL();
+  }
+
+  return S_OK;
+}
+
+//-----------------------------------------------------------------------------
+HRESULT vtkPlusNvidiaDVPVideoSource::SetupGPUFramesGL()
+{
+  std::lock_guard<std::mutex> lock(this->GPUFrameMutex);
+  this->GPUFrameBufferObjects.assign(this->NumberOfGPUFrames, 0);
+  this->GPUFrameFences.assign(this->NumberOfGPUFrames, NULL);
+  this->NextGPUFrameIndex = 0;
+
+  glGenBuffers(this->NumberOfGPUFrames, &this->GPUFrameBufferObjects[0]);
+  for (int i = 0; i < this->NumberOfGPUFrames; i++)
+  {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, this->GPUFrameBufferObjects[i]);
+    glBufferData(GL_COPY_WRITE_BUFFER, NvSDIin.GetBufferObjectPitch(0) * VideoSize[1], NULL, GL_STREAM_COPY);
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  if (glGetError() != GL_NO_ERROR)
+  {
+    LOG_ERROR("Unable to allocate the GPU frame buffer objects.");
+    return E_FAIL;
+  }
+
   return S_OK;
 }
 
@@ -952,6 +1103,11 @@ GLboolean vtkPlusNvidiaDVPVideoSource::SetupGL()
     LOG_ERROR("Could not load the required OpenGL extensions.");
     return false;
   }
+  if (EnableGPUDirect && (!loadCopyBufferExtension() || !loadSyncExtension()))
+  {
+    LOG_ERROR("Could not load the OpenGL extensions required for GPU direct capture.");
+    return false;
+  }
 
   glClearColor(0.0, 0.0, 0.0, 0.0);
   glClearDepth(1.0);
@@ -1039,6 +1195,27 @@ HRESULT vtkPlusNvidiaDVPVideoSource::CleanupSDIinGL()
   }
   NvSDIin.UnbindDevice();
   glDeleteBuffers(NvSDIin.GetNumStreams(), VideoBufferObject);
+  CleanupGPUFramesGL();
+  return S_OK;
+}
+
+//-----------------------------------------------------------------------------
+HRESULT vtkPlusNvidiaDVPVideoSource::CleanupGPUFramesGL()
+{
+  std::lock_guard<std::mutex> lock(this->GPUFrameMutex);
+  for (size_t i = 0; i < this->GPUFrameFences.size(); i++)
+  {
+    if (this->GPUFrameFences[i] != NULL)
+    {
+      glDeleteSync(this->GPUFrameFences[i]);
+    }
+  }
+  if (!this->GPUFrameBufferObjects.empty())
+  {
+    glDeleteBuffers(static_cast<GLsizei>(this->GPUFrameBufferObjects.size()), &this->GPUFrameBufferObjects[0]);
+  }
+  this->GPUFrameBufferObjects.clear();
+  this->GPUFrameFences.clear();
   return S_OK;
 }
 
@@ -1068,12 +1245,45 @@ void vtkPlusNvidiaDVPVideoSource::Shutdown()
 }
 
 //-----------------------------------------------------------------------------
-HRESULT vtkPlusNvidiaDVPVideoSource::CopyGPUToCPU()
+HRESULT vtkPlusNvidiaDVPVideoSource::CopyGPUToCPU(GLuint bufferObject)
 {
-  glBindBuffer(GL_VIDEO_BUFFER_NV, VideoBufferObject[0]);
+  glBindBuffer(GL_VIDEO_BUFFER_NV, bufferObject);
 
   // Transfer contents of video buffer(s) to system memory
   glGetBufferSubData(GL_VIDEO_BUFFER_NV, 0, NvSDIin.GetBufferObjectPitch(0) * VideoSize[1], CPUFrame);
 
   return S_OK;
+}
+
+//-----------------------------------------------------------------------------
+GLuint vtkPlusNvidiaDVPVideoSource::CopyToGPUFrame()
+{
+  std::lock_guard<std::mutex> lock(this->GPUFrameMutex);
+  if (this->GPUFrameBufferObjects.empty())
+  {
+    return 0;
+  }
+  int index = this->NextGPUFrameIndex;
+  this->NextGPUFrameIndex = (this->NextGPUFrameIndex + 1) % static_cast<int>(this->GPUFrameBufferObjects.size());
+
+  // Copy within the GPU memory, the capture buffer object is overwritten by the next capture
+  glBindBuffer(GL_COPY_READ_BUFFER, VideoBufferObject[0]);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, this->GPUFrameBufferObjects[index]);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, NvSDIin.GetBufferObjectPitch(0) * VideoSize[1]);
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  if (this->GPUFrameFences[index] != NULL)
+  {
+    glDeleteSync(this->GPUFrameFences[index]);
+  }
+  this->GPUFrameFences[index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  // Make sure that the copy and the fence are submitted, so that consumers in other contexts can wait for them
+  glFlush();
+
+  if (glGetError() != GL_NO_ERROR)
+  {
+    return 0;
+  }
+  return this->GPUFrameBufferObjects[index];
 }
\ No newline at end of file
@@ -14,11 +14,25 @@ See License.txt for details.
 #include "nvSDIin.h"
 #include "nvConfigure.h"
 
+#include <atomic>
+#include <mutex>
+#include <vector>
+
 class CNvGpu;
 
 /*!
 \class vtkPlusNvidiaDVPVideoSource
 \brief Class for providing VTK video input interface from an NVidia digital video platform interface
+
+If EnableGPUDirect is set then each captured frame is copied (on the GPU) into one of NumberOfGPUFrames
+GL buffer objects and the frame is published in the buffer of the output video source as GPU-resident handle:
+the GPUBufferObject, GPUBufferPitch and GPUBufferSize frame fields identify the buffer object that holds the
+frame, which GPU consumers (scan conversion, encoding, rendering) use directly in a GL context shared with the
+capture context (see ShareGLContext), after waiting for the fence of the buffer object (see GetGPUFrameFence).
+The frames are only read back to the CPU while a CPU consumer is registered (see RegisterCPUConsumer) or
+EnableGPUCPUCopy is set, otherwise the items in the buffer contain only the frame fields, not valid image data.
+A published buffer object is overwritten NumberOfGPUFrames frames later, consumers must finish using it before that.
+
 \ingroup PlusLibDataCollection
 */
 class vtkPlusDataCollectionExport vtkPlusNvidiaDVPVideoSource : public vtkPlusDevice
@@ -42,9 +56,43 @@ public:
   /// Get the field that determines if the frames are copied from the GPU to the CPU to be used downstream
   vtkGetMacro(EnableGPUCPUCopy, bool);
 
+  /// Get the field that determines if the frames are published in the buffer as GPU-resident buffer objects
+  vtkGetMacro(EnableGPUDirect, bool);
+
+  /// Get the number of GPU buffer objects that the published frames rotate through
+  vtkGetMacro(NumberOfGPUFrames, int);
+
+  /*!
+    Register a consumer that uses the image data of the frames on the CPU. With EnableGPUDirect the frames
+    are read back from the GPU only while at least one CPU consumer is registered. Safe to call from any thread.
+  */
+  void RegisterCPUConsumer();
+  /*! Unregister a consumer that was registered by RegisterCPUConsumer */
+  void UnregisterCPUConsumer();
+  /*! Returns true if the frames are currently read back to the CPU */
+  bool IsCPUCopyRequired() const;
+
+  /*!
+    Share the buffer objects of the capture GL context with a consumer GL context (wglShareLists),
+    so that the buffer objects published in the GPUBufferObject frame field can be used in it.
+    Must be called after connecting, before the consumer context creates any objects.
+    The capture context is recreated when the capture is restarted after failures, the consumer has to share again then.
+  */
+  PlusStatus ShareGLContext(HGLRC consumerContext);
+
+  /*!
+    Get the fence that is signaled when the copy of the last frame into a published buffer object is completed.
+    The consumer waits for it (glWaitSync or glClientWaitSync) before reading the buffer object. Returns NULL if
+    the buffer object is unknown.
+  */
+  GLsync GetGPUFrameFence(GLuint bufferObject);
+
 protected:
   /// Set the field that determines if the frames are copied from the GPU to the CPU to be used downstream
   vtkSetMacro(EnableGPUCPUCopy, bool);
+  /// Set the field that determines if the frames are published in the buffer as GPU-resident buffer objects
+  vtkSetMacro(EnableGPUDirect, bool);
+  vtkSetMacro(NumberOfGPUFrames, int);
 
   vtkPlusNvidiaDVPVideoSource();
   virtual ~vtkPlusNvidiaDVPVideoSource();
@@ -60,13 +108,18 @@ protected:
   HRESULT StartSDIPipeline();
   HRESULT StopSDIPipeline();
   GLenum CaptureVideo();
-  HRESULT CopyGPUToCPU();
+  HRESULT CopyGPUToCPU(GLuint bufferObject);
   void Shutdown();
 
+  /*! Copy the captured frame into the next GPU frame buffer object and return that buffer object */
+  GLuint CopyToGPUFrame();
+
 protected:
   HRESULT SetupSDIinGL();
   HRESULT SetupSDIinDevices();
   HRESULT CleanupSDIinGL();
+  HRESULT SetupGPUFramesGL();
+  HRESULT CleanupGPUFramesGL();
 
 protected:
   CNvGpu* NvGPU;
@@ -98,7 +151,24 @@ protected:
   /// Enable copying of frame data from GPU to CPU for broadcasting
   bool EnableGPUCPUCopy;
 
-  /// Data source for CPU output (if enabled)
+  /// Publish the captured frames in the buffer as GPU-resident buffer objects
+  bool EnableGPUDirect;
+
+  /// Number of GPU buffer objects that the published frames rotate through
+  int NumberOfGPUFrames;
+
+  /// GPU buffer objects of the published frames and the fences of their last copy
+  std::vector<GLuint> GPUFrameBufferObjects;
+  std::vector<GLsync> GPUFrameFences;
+  int NextGPUFrameIndex;
+
+  /// Protects the GPU frame fences, which consumers query from other threads
+  std::mutex GPUFrameMutex;
+
+  /// Number of registered consumers that need the frames on the CPU
+  std::atomic<int> NumberOfCPUConsumers;
+
+  /// Data source for output (if enabled)
   vtkPlusDataSource* OutputDataSource;
 
 private:
@@ -10,6 +10,9 @@ See License.txt for details.
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataSource.h"
 
+// IGSIO includes
+#include <vtkIGSIOAccurateTimer.h>
+
 // VTK includes
 #include <vtkImageData.h>
 #include <vtkObjectFactory.h>
@@ -34,6 +37,11 @@ vtkPlusOpenCVCaptureVideoSource::vtkPlusOpenCVCaptureVideoSource()
   , Capture(nullptr)
   , Frame(nullptr)
   , UndistortedFrame(nullptr)
+  , GrabbedFrame(nullptr)
+  , LatestFrame(nullptr)
+  , LatestFrameTimestamp(UNDEFINED_TIMESTAMP)
+  , LatestFrameAvailable(false)
+  , StopGrabThreadRequested(false)
   , CameraMatrix(nullptr)
   , DistortionCoefficients(nullptr)
   , AutofocusEnabled(false)
@@ -47,6 +55,7 @@ vtkPlusOpenCVCaptureVideoSource::vtkPlusOpenCVCaptureVideoSource()
 //----------------------------------------------------------------------------
 vtkPlusOpenCVCaptureVideoSource::~vtkPlusOpenCVCaptureVideoSource()
 {
+  this->InternalStopRecording();
 }
 
 //----------------------------------------------------------------------------
@@ -236,6 +245,8 @@ PlusStatus vtkPlusOpenCVCaptureVideoSource::InternalConnect()
   this->AcquisitionRate = cvRound(this->Capture->get(cv::CAP_PROP_FPS));
 
   this->Frame = std::make_shared<cv::Mat>(this->FrameSize[1], this->FrameSize[0], CV_8UC3);
+  this->GrabbedFrame = std::make_shared<cv::Mat>(this->FrameSize[1], this->FrameSize[0], CV_8UC3);
+  this->LatestFrame = std::make_shared<cv::Mat>(this->FrameSize[1], this->FrameSize[0], CV_8UC3);
 
   if (this->CameraMatrix != nullptr && this->DistortionCoefficients != nullptr)
   {
@@ -268,26 +279,109 @@ PlusStatus vtkPlusOpenCVCaptureVideoSource::InternalDisconnect()
   this->Capture = nullptr; // automatically closes resources/connections
   this->Frame = nullptr;
   this->UndistortedFrame = nullptr;
+  this->GrabbedFrame = nullptr;
+  this->LatestFrame = nullptr;
+
+  return PLUS_SUCCESS;
+}
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenCVCaptureVideoSource::InternalStartRecording()
+{
+  if (this->Capture == nullptr || !this->Capture->isOpened())
+  {
+    LOG_ERROR("Unable to start recording, the OpenCV video device is not open.");
+    return PLUS_FAIL;
+  }
+  if (this->GrabThread.joinable())
+  {
+    return PLUS_SUCCESS;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->GrabMutex);
+    this->StopGrabThreadRequested = false;
+    this->LatestFrameAvailable = false;
+  }
+  this->GrabThread = std::thread(&vtkPlusOpenCVCaptureVideoSource::GrabThreadFunction, this);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenCVCaptureVideoSource::InternalStopRecording()
+{
+  if (this->GrabThread.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(this->GrabMutex);
+      this->StopGrabThreadRequested = true;
+    }
+    this->GrabThread.join();
+  }
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusOpenCVCaptureVideoSource::GrabThreadFunction()
+{
+  while (true)
+  {
+    {
+      std::lock_guard<std::mutex> lock(this->GrabMutex);
+      if (this->StopGrabThreadRequested)
+      {
+        break;
+      }
+    }
+
+    if (!this->Capture->grab())
+    {
+      LOG_ERROR("Unable to receive frame");
+      // Do not retry at full speed if the device or stream is not available
+      vtkIGSIOAccurateTimer::Delay(0.1);
+      continue;
+    }
+    // The frame is timestamped when it is grabbed, decoding may take a significant time
+    double timestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+    if (!this->Capture->retrieve(*this->GrabbedFrame))
+    {
+      LOG_ERROR("Unable to decode frame");
+      continue;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(this->GrabMutex);
+      cv::swap(*this->GrabbedFrame, *this->LatestFrame);
+      this->LatestFrameTimestamp = timestamp;
+      this->LatestFrameAvailable = true;
+    }
+    this->LatestFrameCondition.notify_one();
+  }
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusOpenCVCaptureVideoSource::InternalUpdate()
 {
   LOG_TRACE("vtkPlusOpenCVCaptureVideoSource::InternalUpdate");
 
-  if (!this->Capture->isOpened())
+  if (!this->Capture->isOpened() || !this->GrabThread.joinable())
   {
     // No need to update if we're not able to read data
     return PLUS_SUCCESS;
   }
 
-  // Capture one frame from the OpenCV capture device
-  if (!this->Capture->read(*this->Frame))
+  // Wait for a new frame from the grab thread, at most for one frame period
+  double frameTimestamp = UNDEFINED_TIMESTAMP;
   {
-    LOG_ERROR("Unable to receive frame");
-    return PLUS_FAIL;
+    const double maximumWaitTimeSec = (this->AcquisitionRate > 0 ? 1.0 / this->AcquisitionRate : 0.1);
+    std::unique_lock<std::mutex> lock(this->GrabMutex);
+    if (!this->LatestFrameCondition.wait_for(lock, std::chrono::duration<double>(maximumWaitTimeSec), [this] { return this->LatestFrameAvailable; }))
+    {
+      return PLUS_SUCCESS;
+    }
+    cv::swap(*this->LatestFrame, *this->Frame);
+    frameTimestamp = this->LatestFrameTimestamp;
+    this->LatestFrameAvailable = false;
   }
 
   if (this->CameraMatrix != nullptr && this->DistortionCoefficients != nullptr)
@@ -316,7 +410,7 @@ PlusStatus vtkPlusOpenCVCaptureVideoSource::InternalUpdate()
 
   // Add the frame to the stream buffer
   FrameSizeType frameSize = { static_cast<unsigned int>(this->UndistortedFrame->cols), static_cast<unsigned int>(this->UndistortedFrame->rows), 1 };
-  if (aSource->AddItem(this->UndistortedFrame->data, aSource->GetInputImageOrientation(), frameSize, VTK_UNSIGNED_CHAR, 3, US_IMG_RGB_COLOR, 0, this->FrameNumber) == PLUS_FAIL)
+  if (aSource->AddItem(this->UndistortedFrame->data, aSource->GetInputImageOrientation(), frameSize, VTK_UNSIGNED_CHAR, 3, US_IMG_RGB_COLOR, 0, this->FrameNumber, frameTimestamp) == PLUS_FAIL)
   {
     return PLUS_FAIL;
   }
@@ -13,6 +13,11 @@ See License.txt for details.
 // OpenCV includes
 #include <opencv2/videoio.hpp>
 
+// STL includes
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 /*!
 \class vtkPlusOpenCVCaptureVideoSource
 \brief Class for interfacing an OpenCVC capture device and recording frames into a Plus buffer
@@ -20,6 +25,10 @@ See License.txt for details.
 Requires the PLUS_USE_OpenCVCapture_VIDEO option in CMake.
 Requires OpenCV with FFMPEG built (for RTSP support)
 
+While recording, a grab thread grabs and retrieves (decodes) the frames and timestamps them when the grab returns,
+so the timestamps do not include the decoding and conversion time. InternalUpdate converts the most recent grabbed
+frame and adds it to the buffer. If the frames are grabbed faster than they are added then the older frames are skipped.
+
 \ingroup PlusLibDataCollection
 */
 
@@ -78,12 +87,31 @@ protected:
   virtual PlusStatus InternalConnect();
   virtual PlusStatus InternalDisconnect();
 
+  /*! Start the grab thread */
+  virtual PlusStatus InternalStartRecording();
+  /*! Stop the grab thread */
+  virtual PlusStatus InternalStopRecording();
+
+  /*! Grab and retrieve frames into LatestFrame until StopGrabThreadRequested is set */
+  void GrabThreadFunction();
+
 protected:
   std::string                       VideoURL;
   int                               DeviceIndex;
   std::shared_ptr<cv::VideoCapture> Capture;
   std::shared_ptr<cv::Mat>          Frame;
   std::shared_ptr<cv::Mat>          UndistortedFrame;
+  /*! Frame that the grab thread retrieves into, swapped with LatestFrame, so the frame images are not reallocated */
+  std::shared_ptr<cv::Mat>          GrabbedFrame;
+  /*! Most recent grabbed frame, swapped with Frame by InternalUpdate. Protected by GrabMutex. */
+  std::shared_ptr<cv::Mat>          LatestFrame;
+  double                            LatestFrameTimestamp;
+  /*! True if LatestFrame has not been added to the buffer yet. Protected by GrabMutex. */
+  bool                              LatestFrameAvailable;
+  bool                              StopGrabThreadRequested;
+  std::mutex                        GrabMutex;
+  std::condition_variable           LatestFrameCondition;
+  std::thread                       GrabThread;
   cv::VideoCaptureAPIs              RequestedCaptureAPI;
   bool                              AutofocusEnabled;
   bool                              AutoexposureEnabled;
@@ -27,10 +27,24 @@ See License.txt for details.
 
 vtkStandardNewMacro(vtkPlusOpenHapticsDevice);
 
+namespace
+{
+  // The servo loop runs at 1 kHz, the ring holds the samples of 2 seconds
+  const size_t SERVO_SAMPLE_RING_SIZE = 2048;
+}
+
 //----------------------------------------------------------------------------
 vtkPlusOpenHapticsDevice::vtkPlusOpenHapticsDevice()
   : FrameNumber(-1)
   , DeviceHandle(-1)
+  , ServoLoopHandle(0)
+  , ServoLoopScheduled(false)
+  , ServoSamples(SERVO_SAMPLE_RING_SIZE)
+  , NumberOfWrittenServoSamples(0)
+  , NumberOfReadServoSamples(0)
+  , NumberOfDroppedServoSamples(0)
+  , NumberOfReportedDroppedServoSamples(0)
+  , ServoLoopErrorOccurred(false)
   , DeviceName("Default Device")
   , toolTransform(vtkSmartPointer<vtkTransform>::New())
   , rotation(vtkSmartPointer<vtkTransform>::New())
@@ -41,6 +55,10 @@ vtkPlusOpenHapticsDevice::vtkPlusOpenHapticsDevice()
   this->RequirePortNameInDeviceSetConfiguration = true;
   this->StartThreadForInternalUpdates = true;
   this->AcquisitionRate = 20;
+  for (int i = 0; i < 3; ++i)
+  {
+    this->CommandedForce[i] = 0.0;
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -79,13 +97,72 @@ PlusStatus vtkPlusOpenHapticsDevice::Probe()
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusOpenHapticsDevice::InternalUpdate()
 {
-  //schedule the internal callback - must be done each time device is polled
-  //the scheduler is intended to manage multiple clients requesting data from the same device
-  hdScheduleSynchronous(positionCallback, this, HD_MAX_SCHEDULER_PRIORITY);
+  this->UpdateCommandedForce();
+
+  // Add all the samples that the servo loop acquired since the last update
+  const unsigned long long numberOfWrittenSamples = this->NumberOfWrittenServoSamples.load(std::memory_order_acquire);
+  unsigned long long numberOfReadSamples = this->NumberOfReadServoSamples.load(std::memory_order_relaxed);
+  for (; numberOfReadSamples < numberOfWrittenSamples; ++numberOfReadSamples)
+  {
+    this->AddServoSampleToTools(this->ServoSamples[numberOfReadSamples % this->ServoSamples.size()]);
+  }
+  this->NumberOfReadServoSamples.store(numberOfReadSamples, std::memory_order_release);
+
+  const unsigned long long numberOfDroppedSamples = this->NumberOfDroppedServoSamples.load();
+  if (numberOfDroppedSamples != this->NumberOfReportedDroppedServoSamples)
+  {
+    LOG_WARNING("OpenHaptics servo loop samples are dropped, as they are not processed fast enough (" << numberOfDroppedSamples << " in total)");
+    this->NumberOfReportedDroppedServoSamples = numberOfDroppedSamples;
+  }
+  if (this->ServoLoopErrorOccurred.exchange(false))
+  {
+    LOG_ERROR("OpenHaptics device error occurred in the servo loop of " << this->DeviceName);
+  }
 
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusOpenHapticsDevice::UpdateCommandedForce()
+{
+  double force[3] = { 0, 0, 0 };
+
+  //assemble force data
+  vtkPlusDataSource* forceInput;
+  if(!this->InputChannels.empty() && (this->InputChannels[0]->GetToolByPortName(forceInput, "Force") == PLUS_SUCCESS))
+  {
+    StreamBufferItem item;
+    if(forceInput->GetLatestStreamBufferItem(&item) == ITEM_OK)
+    {
+      if(item.GetStatus() == TOOL_OK)
+      {
+        vtkSmartPointer<vtkMatrix4x4> forceMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+        item.GetMatrix(forceMatrix);
+        force[0] = forceMatrix->GetElement(0, 3);
+        force[1] = forceMatrix->GetElement(1, 3);
+        force[2] = forceMatrix->GetElement(2, 3);
+      }
+      else
+      {
+        LOG_ERROR("OpenHaptics Force data tool is not valid")
+      }
+    }
+    else
+    {
+      LOG_ERROR("OpenHaptics Force data tool info not recevied")
+    }
+  }
+  else
+  {
+    LOG_TRACE("No force data tool has been provided");
+  }
+
+  for (int i = 0; i < 3; ++i)
+  {
+    this->CommandedForce[i].store(force[i], std::memory_order_relaxed);
+  }
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusOpenHapticsDevice::InternalConnect()
 {
@@ -109,6 +186,24 @@ PlusStatus vtkPlusOpenHapticsDevice::InternalConnect()
 
   LOG_DEBUG("Phantom initialized: " << this->DeviceName)
 
+  // Samples of a previous connection are discarded
+  this->NumberOfReadServoSamples = this->NumberOfWrittenServoSamples.load();
+  for (int i = 0; i < 3; ++i)
+  {
+    this->CommandedForce[i] = 0.0;
+  }
+
+  // The servo loop callback runs in every scheduler tick until it is unscheduled
+  this->ServoLoopHandle = hdScheduleAsynchronous(servoLoopCallback, this, HD_DEFAULT_SCHEDULER_PRIORITY);
+  if(HD_DEVICE_ERROR(error = hdGetError()))
+  {
+    LOG_ERROR("Failed to schedule the servo loop callback of Phantom Omni " << this->DeviceName);
+    hdDisableDevice(this->DeviceHandle);
+    this->DeviceHandle = -1;
+    return PLUS_FAIL;
+  }
+  this->ServoLoopScheduled = true;
+
   hdStartScheduler();
 
   return PLUS_SUCCESS;
@@ -117,8 +212,13 @@ PlusStatus vtkPlusOpenHapticsDevice::InternalConnect()
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusOpenHapticsDevice::InternalDisconnect()
 {
-  hdDisableDevice(DeviceHandle);
   hdStopScheduler();
+  if (this->ServoLoopScheduled)
+  {
+    hdUnschedule(this->ServoLoopHandle);
+    this->ServoLoopScheduled = false;
+  }
+  hdDisableDevice(DeviceHandle);
   return PLUS_SUCCESS;
 }
 
@@ -162,114 +262,104 @@ PlusStatus vtkPlusOpenHapticsDevice::NotifyConfigured()
 
 //----------------------------------------------------------------------------
 HDCallbackCode HDCALLBACK
-vtkPlusOpenHapticsDevice::positionCallback(void* pData)
+vtkPlusOpenHapticsDevice::servoLoopCallback(void* pData)
 {
-
+  // Runs in the servo loop thread at 1 kHz: only the device state is read here, without locking or logging
   vtkPlusOpenHapticsDevice* client = reinterpret_cast<vtkPlusOpenHapticsDevice*>(pData);
   HHD handle = client->DeviceHandle;
 
-  const double unfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
-  ++client->FrameNumber;
+  const unsigned long long numberOfWrittenSamples = client->NumberOfWrittenServoSamples.load(std::memory_order_relaxed);
+  const bool ringFull = (numberOfWrittenSamples - client->NumberOfReadServoSamples.load(std::memory_order_acquire) >= client->ServoSamples.size());
+  ServoSample discardedSample;
+  ServoSample& sample = ringFull ? discardedSample : client->ServoSamples[numberOfWrittenSamples % client->ServoSamples.size()];
 
   HDdouble force[3];
-  force[0] = 0;
-  force[1] = 0;
-  force[2] = 0;
-
-
-  //assemble force data
-  vtkPlusDataSource* forceInput;
-  if(!client->InputChannels.empty() && (client->InputChannels[0]->GetToolByPortName(forceInput, "Force") == PLUS_SUCCESS))
+  for (int i = 0; i < 3; ++i)
   {
-    StreamBufferItem item;
-    if(forceInput->GetLatestStreamBufferItem(&item) == ITEM_OK)
-    {
-      if(item.GetStatus() == TOOL_OK)
-      {
-        vtkSmartPointer<vtkMatrix4x4> forceMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-        item.GetMatrix(forceMatrix);
-        force[0] = forceMatrix->GetElement(0, 3);
-        force[1] = forceMatrix->GetElement(1, 3);
-        force[2] = forceMatrix->GetElement(2, 3);
-      }
-      else
-      {
-        LOG_ERROR("OpenHaptics Force data tool is not valid")
-      }
-    }
-    else
-    {
-      LOG_ERROR("OpenHaptics Force data tool info not recevied")
-    }
-  }
-  else
-  {
-    LOG_TRACE("No force data tool has been provided");
+    force[i] = client->CommandedForce[i].load(std::memory_order_relaxed);
   }
 
   //Current position data is pulled here
-  HDdouble tfm[16];
-  HDdouble pos[3];
-  HDdouble vel[3];
-  HDint buttonVals = 0;
-  HDboolean inkwell = 0;
+  sample.Timestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+  sample.Buttons = 0;
+  sample.Inkwell = 0;
   hdBeginFrame(handle);
   hdMakeCurrentDevice(handle);
-  hdGetDoublev(HD_CURRENT_TRANSFORM, tfm);
-  hdGetDoublev(HD_CURRENT_POSITION, pos);
-  hdGetDoublev(HD_CURRENT_VELOCITY, vel);
+  hdGetDoublev(HD_CURRENT_TRANSFORM, sample.Transform);
+  hdGetDoublev(HD_CURRENT_POSITION, sample.Position);
+  hdGetDoublev(HD_CURRENT_VELOCITY, sample.Velocity);
   hdSetDoublev(HD_CURRENT_FORCE, force);
-  hdGetIntegerv(HD_CURRENT_BUTTONS, &buttonVals);
-  hdGetBooleanv(HD_CURRENT_INKWELL_SWITCH, &inkwell);
-  vtkPlusDataSource* stylus = NULL;
-  vtkPlusDataSource* velocity = NULL;
-  vtkPlusDataSource* buttons = NULL;
+  hdGetIntegerv(HD_CURRENT_BUTTONS, &sample.Buttons);
+  hdGetBooleanv(HD_CURRENT_INKWELL_SWITCH, &sample.Inkwell);
   hdEndFrame(handle);
 
+  HDErrorInfo error;
+  if(HD_DEVICE_ERROR(error = hdGetError()))
+  {
+    client->ServoLoopErrorOccurred = true;
+    return HD_CALLBACK_CONTINUE;
+  }
+
+  if (ringFull)
+  {
+    ++client->NumberOfDroppedServoSamples;
+  }
+  else
+  {
+    client->NumberOfWrittenServoSamples.store(numberOfWrittenSamples + 1, std::memory_order_release);
+  }
+  return HD_CALLBACK_CONTINUE;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusOpenHapticsDevice::AddServoSampleToTools(const ServoSample& sample)
+{
+  ++this->FrameNumber;
+
   double orient[3];
 
   //Arrange transformations in correct order
-  client->toolTransform->Identity();
-  client->toolTransform->Translate(pos);
-  client->rotation->SetMatrix(tfm);
-  client->rotation->GetOrientation(orient);
-  client->toolTransform->RotateX(-1 * orient[0] + 180);
-  client->toolTransform->RotateY(orient[1]);
-  client->toolTransform->RotateZ(orient[2]);
-  client->velMatrix->SetElement(0, 3, vel[0]);
-  client->velMatrix->SetElement(1, 3, vel[1]);
-  client->velMatrix->SetElement(2, 3, vel[2]);
+  this->toolTransform->Identity();
+  this->toolTransform->Translate(sample.Position);
+  this->rotation->SetMatrix(sample.Transform);
+  this->rotation->GetOrientation(orient);
+  this->toolTransform->RotateX(-1 * orient[0] + 180);
+  this->toolTransform->RotateY(orient[1]);
+  this->toolTransform->RotateZ(orient[2]);
+  this->velMatrix->SetElement(0, 3, sample.Velocity[0]);
+  this->velMatrix->SetElement(1, 3, sample.Velocity[1]);
+  this->velMatrix->SetElement(2, 3, sample.Velocity[2]);
 
-  client->toolMatrix = client->toolTransform->GetMatrix();
+  this->toolMatrix = this->toolTransform->GetMatrix();
 
 
   //Setting the button values in the matrix
   //The four button occupy the 1st column
   //The inkwell switch is at the top of the second column.
-  client->buttonMatrix->SetElement(0, 0, 0);
-  client->buttonMatrix->SetElement(1, 1, 0);
-  client->buttonMatrix->SetElement(2, 2, 0);
-  client->buttonMatrix->SetElement(0, 0, (bool)(buttonVals & HD_DEVICE_BUTTON_1));
-  client->buttonMatrix->SetElement(1, 0, (bool)(buttonVals & HD_DEVICE_BUTTON_2));
-  client->buttonMatrix->SetElement(2, 0, (bool)(buttonVals & HD_DEVICE_BUTTON_3));
-  client->buttonMatrix->SetElement(3, 0, (bool)(buttonVals & HD_DEVICE_BUTTON_4));
-  client->buttonMatrix->SetElement(0, 1, (int)inkwell);
-
-  if(client->GetToolByPortName("Stylus", stylus) == PLUS_SUCCESS)
+  this->buttonMatrix->SetElement(0, 0, 0);
+  this->buttonMatrix->SetElement(1, 1, 0);
+  this->buttonMatrix->SetElement(2, 2, 0);
+  this->buttonMatrix->SetElement(0, 0, (bool)(sample.Buttons & HD_DEVICE_BUTTON_1));
+  this->buttonMatrix->SetElement(1, 0, (bool)(sample.Buttons & HD_DEVICE_BUTTON_2));
+  this->buttonMatrix->SetElement(2, 0, (bool)(sample.Buttons & HD_DEVICE_BUTTON_3));
+  this->buttonMatrix->SetElement(3, 0, (bool)(sample.Buttons & HD_DEVICE_BUTTON_4));
+  this->buttonMatrix->SetElement(0, 1, (int)sample.Inkwell);
+
+  vtkPlusDataSource* stylus = NULL;
+  vtkPlusDataSource* velocity = NULL;
+  vtkPlusDataSource* buttons = NULL;
+  if(this->GetToolByPortName("Stylus", stylus) == PLUS_SUCCESS)
   {
-    client->ToolTimeStampedUpdate(stylus->GetId(), client->toolMatrix, TOOL_OK, client->FrameNumber, unfilteredTimestamp);
+    this->ToolTimeStampedUpdate(stylus->GetId(), this->toolMatrix, TOOL_OK, this->FrameNumber, sample.Timestamp);
   }
 
-  if(client->GetToolByPortName("StylusVelocity", velocity) == PLUS_SUCCESS)
+  if(this->GetToolByPortName("StylusVelocity", velocity) == PLUS_SUCCESS)
   {
-    client->ToolTimeStampedUpdate(velocity->GetId(), client->velMatrix, TOOL_OK, client->FrameNumber, unfilteredTimestamp);
+    this->ToolTimeStampedUpdate(velocity->GetId(), this->velMatrix, TOOL_OK, this->FrameNumber, sample.Timestamp);
   }
 
-  if(client->GetToolByPortName("Buttons", buttons) == PLUS_SUCCESS)
+  if(this->GetToolByPortName("Buttons", buttons) == PLUS_SUCCESS)
   {
-    client->ToolTimeStampedUpdate(buttons->GetId(), client->buttonMatrix, TOOL_OK, client->FrameNumber, unfilteredTimestamp);
+    this->ToolTimeStampedUpdate(buttons->GetId(), this->buttonMatrix, TOOL_OK, this->FrameNumber, sample.Timestamp);
   }
-
-  return HD_CALLBACK_DONE;
 }
-
@@ -12,6 +12,9 @@
 #include "vtkPlusDevice.h"
 #include <HD/hd.h>
 
+#include <atomic>
+#include <vector>
+
 class vtkMatrix4x4;
 class vtkTransform;
 
@@ -19,6 +22,12 @@ class vtkTransform;
 /*!
   \class vtkPlusOpenHapticsDevice
   \brief Device interface for Open Haptics devices
+
+  The device state is sampled by an asynchronous callback in the OpenHaptics servo loop (1 kHz), which also applies
+  the force of the Force input tool. The samples are stored in a lock-free ring and added to the tool buffers in batches
+  by InternalUpdate, each with the timestamp of its servo tick. So the tool buffers receive 1000 items per second,
+  their BufferSize has to be set accordingly.
+
   \ingroup PlusLibDataCollection
 */
 class vtkPlusDataCollectionExport vtkPlusOpenHapticsDevice : public vtkPlusDevice
@@ -77,9 +86,43 @@ protected:
 private:
   vtkPlusOpenHapticsDevice(const vtkPlusOpenHapticsDevice&);
   void operator=(const vtkPlusOpenHapticsDevice&);
-  static HDCallbackCode HDCALLBACK positionCallback(void* pData);
+
+  /*! Device state read in one servo loop tick */
+  struct ServoSample
+  {
+    double Timestamp;
+    HDdouble Transform[16];
+    HDdouble Position[3];
+    HDdouble Velocity[3];
+    HDint Buttons;
+    HDboolean Inkwell;
+  };
+
+  /*! Called by the servo loop in every tick, reads the device state into the ring and applies the commanded force */
+  static HDCallbackCode HDCALLBACK servoLoopCallback(void* pData);
+
+  /*! Get the force from the Force input tool, it is applied by the servo loop */
+  void UpdateCommandedForce();
+
+  /*! Push the tool transforms of a servo sample to the tools */
+  void AddServoSampleToTools(const ServoSample& sample);
 
   HHD DeviceHandle;     ///< device handle
+  HDSchedulerHandle ServoLoopHandle;
+  bool ServoLoopScheduled;
+
+  /*! Single producer (servo loop), single consumer (InternalUpdate) ring of the servo samples */
+  std::vector<ServoSample> ServoSamples;
+  std::atomic<unsigned long long> NumberOfWrittenServoSamples;
+  std::atomic<unsigned long long> NumberOfReadServoSamples;
+  /*! Samples dropped by the servo loop because the ring was full */
+  std::atomic<unsigned long long> NumberOfDroppedServoSamples;
+  unsigned long long NumberOfReportedDroppedServoSamples;
+  std::atomic<bool> ServoLoopErrorOccurred;
+
+  /*! Force applied by the servo loop, set from the Plus thread */
+  std::atomic<double> CommandedForce[3];
+
   vtkSmartPointer<vtkTransform> toolTransform;
   vtkSmartPointer<vtkTransform> rotation;
   vtkSmartPointer<vtkMatrix4x4> velMatrix;
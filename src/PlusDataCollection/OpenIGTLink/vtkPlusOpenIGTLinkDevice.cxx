@@ -6,11 +6,20 @@ See License.txt for details.
 
 // Local includes
 #include "PlusConfigure.h"
+#include "PlusIgtlCrc64.h"
 #include "igtlPlusClientInfoMessage.h"
 #include "vtkPlusDataSource.h"
 #include "vtkPlusIgtlMessageFactory.h"
 #include "vtkPlusOpenIGTLinkDevice.h"
 
+// OpenIGTLink includes
+#include <igtlTimeStamp.h>
+#include <igtl_header.h>
+
+// STL includes
+#include <algorithm>
+#include <cstring>
+
 // OS includes
 #ifdef _WIN32
   #include <Winsock2.h>
@@ -29,6 +38,8 @@ vtkPlusOpenIGTLinkDevice::vtkPlusOpenIGTLinkDevice()
   , ClientSocket(igtl::ClientSocket::New())
   , ReconnectOnReceiveTimeout(true)
   , UseReceivedTimestamps(true)
+  , RelayReceivedMessages(false)
+  , MaximumNumberOfRelayedMessages(30)
 {
   // No callback function provided by the device, so the data capture thread will be used to poll the hardware and add new items to the buffer
   this->StartThreadForInternalUpdates = true;
@@ -63,6 +74,11 @@ void vtkPlusOpenIGTLinkDevice::PrintSelf(ostream& os, vtkIndent indent)
   {
     os << indent << "Image stream: " << this->ImageMessageEmbeddedTransformName.GetTransformName() << "\n";
   }
+  os << indent << "Relay received messages: " << (this->RelayReceivedMessages ? "true" : "false") << "\n";
+  if (!this->RelayDeviceName.empty())
+  {
+    os << indent << "Relay device name: " << this->RelayDeviceName << "\n";
+  }
 }
 //----------------------------------------------------------------------------
 std::string vtkPlusOpenIGTLinkDevice::GetSdkVersion()
@@ -79,6 +95,10 @@ PlusStatus vtkPlusOpenIGTLinkDevice::InternalConnect()
 
   // Clear buffers on connect
   this->ClearAllBuffers();
+  {
+    std::lock_guard<std::mutex> relayGuard(this->RelayedMessagesMutex);
+    this->RelayedMessages.clear();
+  }
 
   igsioLockGuard<vtkIGSIORecursiveCriticalSection> socketGuard(this->SocketMutex);
   if (this->ClientSocket->GetConnected())
@@ -197,6 +217,11 @@ PlusStatus vtkPlusOpenIGTLinkDevice::SendRequestedMessageTypes()
 
   // Pack client info message
   igtl::PlusClientInfoMessage::Pointer clientInfoMsg = igtl::PlusClientInfoMessage::New();
+  if (igsioCommon::IsEqualInsensitive(this->MessageType, "TRACKEDFRAME"))
+  {
+    // The server sends the frame fields of TRACKEDFRAME messages in binary encoding (instead of XML) to clients with header version 2
+    clientInfoMsg->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+  }
   clientInfoMsg->SetClientInfo(clientInfo);
   clientInfoMsg->Pack();
 
@@ -313,6 +338,102 @@ PlusStatus vtkPlusOpenIGTLinkDevice::ReceiveMessageHeader(igtl::MessageHeader::P
   return socketError ? PLUS_FAIL : PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkDevice::ReceiveMessageForRelay(igtl::MessageHeader::Pointer headerMsg, igtl::MessageBase::Pointer& relayMsg)
+{
+  const igtl_uint64 expectedCrc = IgtlCrc64::GetHeaderCrc(headerMsg.GetPointer());
+  relayMsg = igtl::MessageBase::New();
+  relayMsg->SetMessageHeader(headerMsg);
+  relayMsg->AllocateBuffer();
+
+  int bodySize = static_cast<int>(relayMsg->GetBufferBodySize());
+  if (bodySize > 0)
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> socketGuard(this->SocketMutex);
+    if (this->ClientSocket->Receive(relayMsg->GetBufferBodyPointer(), bodySize) != bodySize)
+    {
+      LOG_ERROR("Failed to receive the body of " << headerMsg->GetMessageType() << " message in device " << this->GetDeviceId());
+      relayMsg = NULL;
+      return PLUS_FAIL;
+    }
+  }
+
+  // The CRC is checked with IgtlCrc64, the relayed message is forwarded with the received CRC
+  if (this->IgtlMessageCrcCheckEnabled && IgtlCrc64::CheckBody(relayMsg, expectedCrc) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("CRC check of " << headerMsg->GetMessageType() << " message failed in device " << this->GetDeviceId());
+    relayMsg = NULL;
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkDevice::UnpackRelayedMessage(igtl::MessageHeader::Pointer headerMsg, igtl::MessageBase* relayMsg, igtl::MessageBase::Pointer bodyMsg)
+{
+  // Unpacking converts the byte order of the body in place, so a copy is unpacked
+  bodyMsg->SetMessageHeader(headerMsg);
+  bodyMsg->AllocateBuffer();
+  if (bodyMsg->GetBufferBodySize() != relayMsg->GetBufferBodySize())
+  {
+    LOG_ERROR("Unable to unpack " << headerMsg->GetMessageType() << " message in device " << this->GetDeviceId() << " - body size mismatch");
+    return PLUS_FAIL;
+  }
+  memcpy(bodyMsg->GetBufferBodyPointer(), relayMsg->GetBufferBodyPointer(), relayMsg->GetBufferBodySize());
+  int c = bodyMsg->Unpack(0);
+  if (!(c & igtl::MessageHeader::UNPACK_BODY))
+  {
+    LOG_ERROR("Failed to unpack " << headerMsg->GetMessageType() << " message in device " << this->GetDeviceId());
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkDevice::AddRelayedMessage(igtl::MessageHeader::Pointer headerMsg, igtl::MessageBase::Pointer relayMsg, double timestamp)
+{
+  std::string deviceName = (this->RelayDeviceName.empty() ? std::string(headerMsg->GetDeviceName()) : this->RelayDeviceName);
+  igtl::TimeStamp::Pointer timestampUtc = igtl::TimeStamp::New();
+  timestampUtc->SetTime(vtkIGSIOAccurateTimer::GetUniversalTimeFromSystemTime(timestamp));
+
+  // Only the header is rewritten, the CRC of the body does not change
+  igtl_header header;
+  memset(&header, 0, sizeof(header));
+  header.header_version = static_cast<igtl_uint16>(headerMsg->GetHeaderVersion());
+  strncpy(header.name, headerMsg->GetMessageType(), IGTL_HEADER_TYPE_SIZE);
+  strncpy(header.device_name, deviceName.c_str(), IGTL_HEADER_NAME_SIZE);
+  header.timestamp = timestampUtc->GetTimeStampUint64();
+  header.body_size = relayMsg->GetBufferBodySize();
+  header.crc = IgtlCrc64::GetHeaderCrc(headerMsg.GetPointer());
+  igtl_header_convert_byte_order(&header);
+  memcpy(relayMsg->GetBufferPointer(), &header, IGTL_HEADER_SIZE);
+
+  // The server compares the device names of the queued messages, so the unpacked fields are kept consistent with the header
+  relayMsg->SetDeviceName(deviceName.c_str());
+  relayMsg->SetTimeStamp(timestampUtc);
+
+  std::lock_guard<std::mutex> relayGuard(this->RelayedMessagesMutex);
+  this->RelayedMessages.push_back(std::make_pair(timestamp, relayMsg));
+  while (this->RelayedMessages.size() > static_cast<size_t>(std::max(this->MaximumNumberOfRelayedMessages, 1)))
+  {
+    this->RelayedMessages.pop_front();
+  }
+}
+
+//----------------------------------------------------------------------------
+igtl::MessageBase::Pointer vtkPlusOpenIGTLinkDevice::GetRelayedMessage(double timestamp)
+{
+  std::lock_guard<std::mutex> relayGuard(this->RelayedMessagesMutex);
+  for (std::deque<std::pair<double, igtl::MessageBase::Pointer> >::reverse_iterator it = this->RelayedMessages.rbegin(); it != this->RelayedMessages.rend(); ++it)
+  {
+    if (it->first == timestamp)
+    {
+      return it->second;
+    }
+  }
+  return NULL;
+}
+
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusOpenIGTLinkDevice::ReadConfiguration(vtkXMLDataElement* rootConfigElement)
 {
@@ -325,6 +446,9 @@ PlusStatus vtkPlusOpenIGTLinkDevice::ReadConfiguration(vtkXMLDataElement* rootCo
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(IgtlMessageCrcCheckEnabled, deviceConfig);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(UseReceivedTimestamps, deviceConfig);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(ReconnectOnReceiveTimeout, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(RelayReceivedMessages, deviceConfig);
+  XML_READ_STRING_ATTRIBUTE_OPTIONAL(RelayDeviceName, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, MaximumNumberOfRelayedMessages, deviceConfig);
   return PLUS_SUCCESS;
 }
 
@@ -340,6 +464,12 @@ PlusStatus vtkPlusOpenIGTLinkDevice::WriteConfiguration(vtkXMLDataElement* rootC
   deviceConfig->SetAttribute("IgtlMessageCrcCheckEnabled", this->IgtlMessageCrcCheckEnabled ? "true" : "false");
   deviceConfig->SetAttribute("UseReceivedTimestamps", this->UseReceivedTimestamps ? "true" : "false");
   deviceConfig->SetAttribute("ReconnectOnReceiveTimeout", this->ReconnectOnReceiveTimeout ? "true" : "false");
+  if (this->RelayReceivedMessages)
+  {
+    deviceConfig->SetAttribute("RelayReceivedMessages", "true");
+    XML_WRITE_STRING_ATTRIBUTE_IF_NOT_EMPTY(RelayDeviceName, deviceConfig);
+    deviceConfig->SetIntAttribute("MaximumNumberOfRelayedMessages", this->MaximumNumberOfRelayedMessages);
+  }
   return PLUS_SUCCESS;
 }
 
@@ -15,12 +15,22 @@
 #include <igtlClientSocket.h>
 #include <igtlMessageBase.h>
 
+// STL includes
+#include <deque>
+#include <mutex>
+
 class vtkPlusIgtlMessageFactory;
 
 /*!
   \class vtkPlusOpenIGTLinkDevice
   \brief Common base class for OpenIGTLink-based tracking and video devices
 
+  In relay mode (RelayReceivedMessages="TRUE") the received image messages are kept in their serialized form in addition
+  to unpacking them into the buffer. A server that publishes the output channel of the device forwards these messages to
+  its clients without packing them again: only the message header is rewritten (device name and timestamp), the body and
+  its CRC are sent as they were received. This allows chaining servers (e.g., an acquisition node, a relay node and
+  display nodes) without decoding and re-encoding the images on each hop.
+
   \ingroup PlusLibDataCollection
 */
 class vtkPlusDataCollectionExport vtkPlusOpenIGTLinkDevice : public vtkPlusDevice
@@ -90,6 +100,21 @@ public:
   /*! Get the ReconnectOnNoData flag */
   vtkGetMacro(ReconnectOnReceiveTimeout, bool);
 
+  /*! If enabled then the received image messages are kept for relaying them to the clients of a server */
+  vtkSetMacro(RelayReceivedMessages, bool);
+  vtkGetMacro(RelayReceivedMessages, bool);
+  vtkBooleanMacro(RelayReceivedMessages, bool);
+
+  /*! Device name written into the header of the relayed messages. If empty then the received device name is kept. */
+  vtkSetStdStringMacro(RelayDeviceName);
+  vtkGetStdStringMacro(RelayDeviceName);
+
+  /*!
+    Get the relayed message of the frame that was added to the buffer with the specified timestamp (system time).
+    Returns NULL if no message is kept for that frame. The returned message must not be modified.
+  */
+  igtl::MessageBase::Pointer GetRelayedMessage(double timestamp);
+
 protected:
   vtkPlusOpenIGTLinkDevice();
   virtual ~vtkPlusOpenIGTLinkDevice();
@@ -118,6 +143,21 @@ protected:
   */
   virtual PlusStatus ReceiveMessageHeader(igtl::MessageHeader::Pointer& headerMsg);
 
+  /*!
+    Receive the whole body of a message into relayMsg and verify its CRC, if CRC check is enabled.
+    The body is kept in its serialized form, it can be unpacked with UnpackRelayedMessage.
+  */
+  PlusStatus ReceiveMessageForRelay(igtl::MessageHeader::Pointer headerMsg, igtl::MessageBase::Pointer& relayMsg);
+
+  /*! Unpack a copy of the body of a message received by ReceiveMessageForRelay into bodyMsg, relayMsg is not modified */
+  PlusStatus UnpackRelayedMessage(igtl::MessageHeader::Pointer headerMsg, igtl::MessageBase* relayMsg, igtl::MessageBase::Pointer bodyMsg);
+
+  /*!
+    Rewrite the header of a message received by ReceiveMessageForRelay (device name and the timestamp of the frame in UTC)
+    and keep the message for relaying. The oldest messages are removed if there are more than MaximumNumberOfRelayedMessages.
+  */
+  void AddRelayedMessage(igtl::MessageHeader::Pointer headerMsg, igtl::MessageBase::Pointer relayMsg, double timestamp);
+
   /*! Set the ReconnectOnReceiveTimeout flag */
   vtkSetMacro(ReconnectOnReceiveTimeout, bool);
 
@@ -166,6 +206,19 @@ protected:
   */
   bool UseReceivedTimestamps;
 
+  /*! Keep the received image messages for relaying */
+  bool RelayReceivedMessages;
+
+  /*! Device name in the header of the relayed messages, the received device name is kept if empty */
+  std::string RelayDeviceName;
+
+  /*! Number of the most recent relayed messages that are kept */
+  int MaximumNumberOfRelayedMessages;
+
+  /*! Relayed messages with the timestamp (system time) of their frame in the buffer, the oldest first */
+  std::deque<std::pair<double, igtl::MessageBase::Pointer> > RelayedMessages;
+  std::mutex RelayedMessagesMutex;
+
 private:
   vtkPlusOpenIGTLinkDevice(const vtkPlusOpenIGTLinkDevice&);   // Not implemented.
   void operator=(const vtkPlusOpenIGTLinkDevice&);   // Not implemented.
@@ -22,6 +22,8 @@ vtkStandardNewMacro(vtkPlusOpenIGTLinkTracker);
 //----------------------------------------------------------------------------
 vtkPlusOpenIGTLinkTracker::vtkPlusOpenIGTLinkTracker()
   : UseLastTransformsOnReceiveTimeout(false)
+  , UdpReceivePort(0)
+  , NumberOfReportedLostDatagrams(0)
 {
   SetToolReferenceFrameName("Reference");
 }
@@ -35,14 +37,44 @@ vtkPlusOpenIGTLinkTracker::~vtkPlusOpenIGTLinkTracker()
 void vtkPlusOpenIGTLinkTracker::PrintSelf(ostream& os, vtkIndent indent)
 {
   os << indent << "UseLastTransformsOnReceiveTimeout: " << this->UseLastTransformsOnReceiveTimeout;
+  os << indent << "UdpReceivePort: " << this->UdpReceivePort;
+  os << indent << "UdpMulticastAddress: " << this->UdpMulticastAddress;
 
   Superclass::PrintSelf(os, indent);
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkTracker::InternalConnect()
+{
+  if (this->UdpReceivePort <= 0)
+  {
+    return Superclass::InternalConnect();
+  }
+
+  // Datagrams are sent by the server without a connection
+  if (this->UdpSocket.OpenForReceiving(this->UdpReceivePort, this->UdpMulticastAddress) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to open UDP socket on port " << this->UdpReceivePort << " in device " << this->GetDeviceId());
+    return PLUS_FAIL;
+  }
+  this->NumberOfReportedLostDatagrams = 0;
+  LOG_INFO("Receiving tracking data in UDP datagrams on port " << this->UdpReceivePort
+           << (this->UdpMulticastAddress.empty() ? std::string("") : " from multicast group " + this->UdpMulticastAddress));
+  return PLUS_SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusOpenIGTLinkTracker::InternalDisconnect()
 {
   LOG_TRACE("vtkPlusOpenIGTLinkTracker::Disconnect");
+  if (this->UdpSocket.IsOpen())
+  {
+    LOG_INFO("UDP datagrams received: " << this->UdpSocket.GetNumberOfDatagrams() << ", lost: " << this->UdpSocket.GetNumberOfLostDatagrams()
+             << ", arrived out of order: " << this->UdpSocket.GetNumberOfStaleDatagrams());
+    this->UdpSocket.Close();
+    return PLUS_SUCCESS;
+  }
+
   if (this->IsTDataMessageType())
   {
     // If we need TDATA, request server to stop streaming.
@@ -79,7 +111,11 @@ PlusStatus vtkPlusOpenIGTLinkTracker::InternalUpdate()
     return PLUS_FAIL;
   }
 
-  if (this->IsTDataMessageType())
+  if (this->UdpReceivePort > 0)
+  {
+    return this->InternalUpdateUdp();
+  }
+  else if (this->IsTDataMessageType())
   {
     return this->InternalUpdateTData();
   }
@@ -89,6 +125,87 @@ PlusStatus vtkPlusOpenIGTLinkTracker::InternalUpdate()
   }
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkTracker::InternalUpdateUdp()
+{
+  LOG_TRACE("vtkPlusOpenIGTLinkTracker::InternalUpdateUdp");
+
+  double unfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+
+  double maxAllocatedProcessingTime = 2.0;
+  // set maxAllocatedProcessingTime to 2 acquisition periods to allow reading all transforms even when there are slight delays
+  if (this->GetAcquisitionRate() > 2.0 / maxAllocatedProcessingTime)
+  {
+    maxAllocatedProcessingTime = 2.0 / this->GetAcquisitionRate();
+  }
+
+  // Wait for the first datagram, then process all the datagrams that have already arrived
+  double timeoutSec = this->ReceiveTimeoutSec;
+  while (vtkIGSIOAccurateTimer::GetSystemTime() - unfilteredTimestamp < maxAllocatedProcessingTime)
+  {
+    unsigned long numberOfDatagrams = this->UdpSocket.GetNumberOfDatagrams() + this->UdpSocket.GetNumberOfStaleDatagrams();
+    std::vector<igtl::MessageBase::Pointer> messages;
+    if (this->UdpSocket.ReceiveMessages(timeoutSec, this->MessageFactory, this->IgtlMessageCrcCheckEnabled, messages) != PLUS_SUCCESS)
+    {
+      StoreInvalidTransforms(vtkIGSIOAccurateTimer::GetSystemTime());
+      return PLUS_FAIL;
+    }
+    if (this->UdpSocket.GetNumberOfDatagrams() + this->UdpSocket.GetNumberOfStaleDatagrams() == numberOfDatagrams)
+    {
+      // no more datagrams
+      break;
+    }
+    timeoutSec = 0;
+
+    for (std::vector<igtl::MessageBase::Pointer>::iterator messageIt = messages.begin(); messageIt != messages.end(); ++messageIt)
+    {
+      double unfilteredTimestampUtc = 0;
+      vtkSmartPointer<vtkMatrix4x4> toolMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+      std::string igtlTransformName;
+      ToolStatus toolStatus(TOOL_UNKNOWN);
+      if (typeid(**messageIt) == typeid(igtl::TransformMessage))
+      {
+        if (vtkPlusIgtlMessageCommon::UnpackTransformMessage(dynamic_cast<igtl::TransformMessage*>(messageIt->GetPointer()), toolMatrix, toolStatus, igtlTransformName, unfilteredTimestampUtc) == PLUS_SUCCESS)
+        {
+          ProcessReceivedTransform(igtlTransformName, toolMatrix, toolStatus, unfilteredTimestampUtc);
+        }
+      }
+      else if (typeid(**messageIt) == typeid(igtl::PositionMessage))
+      {
+        if (vtkPlusIgtlMessageCommon::UnpackPositionMessage(dynamic_cast<igtl::PositionMessage*>(messageIt->GetPointer()), toolMatrix, igtlTransformName, toolStatus, unfilteredTimestampUtc) == PLUS_SUCCESS)
+        {
+          ProcessReceivedTransform(igtlTransformName, toolMatrix, toolStatus, unfilteredTimestampUtc);
+        }
+      }
+      else if (typeid(**messageIt) == typeid(igtl::TrackingDataMessage))
+      {
+        ProcessTrackingDataMessage(dynamic_cast<igtl::TrackingDataMessage*>(messageIt->GetPointer()));
+      }
+      // other message types are ignored
+    }
+  }
+
+  if (this->UdpSocket.GetNumberOfLostDatagrams() > this->NumberOfReportedLostDatagrams)
+  {
+    LOG_DEBUG("Lost " << this->UdpSocket.GetNumberOfLostDatagrams() - this->NumberOfReportedLostDatagrams << " UDP datagrams in device " << this->GetDeviceId());
+    this->NumberOfReportedLostDatagrams = this->UdpSocket.GetNumberOfLostDatagrams();
+  }
+
+  if (this->UseLastTransformsOnReceiveTimeout)
+  {
+    // Store all the other transforms with the last known value
+    // that has not been updated in this update iteration
+    StoreMostRecentTransformValues(unfilteredTimestamp);
+  }
+  else
+  {
+    // Set all those transforms to invalid that contains stale transform values
+    StoreInvalidTransforms(unfilteredTimestamp);
+  }
+
+  return PLUS_SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusOpenIGTLinkTracker::InternalUpdateTData()
 {
@@ -158,6 +275,12 @@ PlusStatus vtkPlusOpenIGTLinkTracker::InternalUpdateTData()
     return PLUS_FAIL;
   }
 
+  return ProcessTrackingDataMessage(tdataMsg);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkTracker::ProcessTrackingDataMessage(igtl::TrackingDataMessage* tdataMsg)
+{
   // for now just use system time, all coordinates will be sequential.
   double unfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
   double filteredTimestamp = unfilteredTimestamp; // No need to filter already filtered timestamped items received over OpenIGTLink
@@ -330,6 +453,12 @@ PlusStatus vtkPlusOpenIGTLinkTracker::ProcessTransformMessageGeneral(bool& moreM
     return PLUS_SUCCESS;
   }
 
+  return ProcessReceivedTransform(igtlTransformName, toolMatrix, toolStatus, unfilteredTimestampUtc);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkTracker::ProcessReceivedTransform(const std::string& igtlTransformName, vtkMatrix4x4* toolMatrix, ToolStatus toolStatus, double unfilteredTimestampUtc)
+{
   // Set transform name
   igsioTransformName transformName;
   if (transformName.SetTransformName(igtlTransformName.c_str()) != PLUS_SUCCESS)
@@ -339,7 +468,12 @@ PlusStatus vtkPlusOpenIGTLinkTracker::ProcessTransformMessageGeneral(bool& moreM
   }
 
   double unfilteredTimestamp = 0;
-  if (this->UseReceivedTimestamps)
+  if (this->UseReceivedTimestamps && this->IsHardwareClockEnabled())
+  {
+    // The sender clock is synchronized to this computer (e.g., by PTP), the hardware clock converts with the current UTC offset
+    unfilteredTimestamp = this->GetSystemTimeFromHardwareTimestamp(unfilteredTimestampUtc, vtkIGSIOAccurateTimer::GetSystemTime());
+  }
+  else if (this->UseReceivedTimestamps)
   {
     // Use the timestamp in the OpenIGTLink message
     // The received timestamp is in UTC and timestamps in the buffer are in system time, so conversion is needed
@@ -503,6 +637,8 @@ PlusStatus vtkPlusOpenIGTLinkTracker::ReadConfiguration(vtkXMLDataElement* rootC
 {
   XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_READING(deviceConfig, rootConfigElement);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(UseLastTransformsOnReceiveTimeout, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, UdpReceivePort, deviceConfig);
+  XML_READ_STRING_ATTRIBUTE_OPTIONAL(UdpMulticastAddress, deviceConfig);
   return PLUS_SUCCESS;
 }
 
@@ -511,6 +647,11 @@ PlusStatus vtkPlusOpenIGTLinkTracker::WriteConfiguration(vtkXMLDataElement* root
 {
   XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_WRITING(deviceConfig, rootConfigElement);
   deviceConfig->SetAttribute("UseLastTransformsOnReceiveTimeout", this->UseLastTransformsOnReceiveTimeout ? "true" : "false");
+  if (this->UdpReceivePort > 0)
+  {
+    deviceConfig->SetIntAttribute("UdpReceivePort", this->UdpReceivePort);
+  }
+  XML_WRITE_STRING_ATTRIBUTE_REMOVE_IF_EMPTY(UdpMulticastAddress, deviceConfig);
   return PLUS_SUCCESS;
 }
 
@@ -11,11 +11,19 @@
 #include "vtkPlusDataCollectionExport.h"
 #include "vtkPlusOpenIGTLinkDevice.h"
 #include "vtkPlusIgtlMessageFactory.h"
+#include "PlusIgtlUdpSocket.h"
+
+#include <igtlTrackingDataMessage.h>
 
 /*!
 \class vtkPlusOpenIGTLinkTracker
 \brief OpenIGTLink tracker client
 
+If UdpReceivePort is set then the tracker does not connect to the server, but receives TRANSFORM, POSITION and TDATA
+messages in UDP datagrams on that port (sent by the UdpOutput of a Plus server, see IgtlUdpSocket). If UdpMulticastAddress
+is set then the multicast group is joined. Datagrams are not retransmitted: lost datagrams are counted and datagrams that
+arrive after a newer one are ignored.
+
 \ingroup PlusLibDataCollection
 */
 class vtkPlusDataCollectionExport vtkPlusOpenIGTLinkTracker : public vtkPlusOpenIGTLinkDevice
@@ -25,6 +33,9 @@ public:
   vtkTypeMacro(vtkPlusOpenIGTLinkTracker, vtkPlusOpenIGTLinkDevice);
   virtual void PrintSelf(ostream& os, vtkIndent indent);
 
+  /*! Connect to device (or open the UDP socket if UdpReceivePort is set) */
+  virtual PlusStatus InternalConnect();
+
   /*! Disconnect from device */
   virtual PlusStatus InternalDisconnect();
 
@@ -42,6 +53,14 @@ public:
     return true;
   }
 
+  /*! Port for receiving UDP datagrams (0: messages are received from the TCP connection to the server) */
+  vtkSetMacro(UdpReceivePort, int);
+  vtkGetMacro(UdpReceivePort, int);
+
+  /*! Multicast group address that is joined for receiving UDP datagrams (empty: unicast) */
+  vtkSetStdStringMacro(UdpMulticastAddress);
+  vtkGetStdStringMacro(UdpMulticastAddress);
+
 protected:
   vtkPlusOpenIGTLinkTracker();
   virtual ~vtkPlusOpenIGTLinkTracker();
@@ -59,6 +78,15 @@ protected:
   /*! Process a TDATA message (add all the received transforms to the buffers) */
   PlusStatus InternalUpdateTData();
 
+  /*! Add the transforms of an unpacked TDATA message to the buffers */
+  PlusStatus ProcessTrackingDataMessage(igtl::TrackingDataMessage* tdataMsg);
+
+  /*! Add a transform received in a TRANSFORM or POSITION message to the buffer */
+  PlusStatus ProcessReceivedTransform(const std::string& igtlTransformName, vtkMatrix4x4* toolMatrix, ToolStatus toolStatus, double unfilteredTimestampUtc);
+
+  /*! Process the TRANSFORM, POSITION and TDATA messages received in UDP datagrams */
+  PlusStatus InternalUpdateUdp();
+
   /*!
     Store the latest transforms again in the buffers with the provided timestamp.
     If no transforms are defined then identity transform will be stored.
@@ -78,6 +106,12 @@ protected:
   /*! Use the last known transform value if not received a new value. Useful for servers that only notify about changes in the transforms. */
   bool UseLastTransformsOnReceiveTimeout;
 
+  int UdpReceivePort;
+  std::string UdpMulticastAddress;
+  IgtlUdpSocket UdpSocket;
+  /*! Number of lost datagrams that has been already logged */
+  unsigned long NumberOfReportedLostDatagrams;
+
 private:
   vtkPlusOpenIGTLinkTracker(const vtkPlusOpenIGTLinkTracker&);
   void operator=(const vtkPlusOpenIGTLinkTracker&);
@@ -6,6 +6,7 @@ See License.txt for details.
 
 // Plus includes
 #include "PlusConfigure.h"
+#include "PlusIgtlMessageBodyReceiver.h"
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataSource.h"
 #include "vtkPlusIgtlMessageCommon.h"
@@ -13,11 +14,16 @@ See License.txt for details.
 
 // OpenIGTLink includes
 #include <igtlImageMessage.h>
+#include <igtl_header.h>
+#include <igtl_image.h>
 
 // VTK includes
 #include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
 #include <vtkObjectFactory.h>
 
+
 vtkStandardNewMacro(vtkPlusOpenIGTLinkVideoSource);
 
 //----------------------------------------------------------------------------
@@ -74,23 +80,82 @@ PlusStatus vtkPlusOpenIGTLinkVideoSource::InternalUpdate()
   igsioTrackedFrame trackedFrame;
   igtl::MessageBase::Pointer bodyMsg = this->MessageFactory->CreateReceiveMessage(headerMsg);
 
-  if (typeid(*bodyMsg) == typeid(igtl::ImageMessage))
+  // In relay mode the whole message is received into memory and kept in its serialized form, a copy of it is unpacked
+  igtl::MessageBase::Pointer relayMsg;
+
+  if (typeid(*bodyMsg) == typeid(igtl::ImageMessage) && this->RelayReceivedMessages)
+  {
+    igtl::ImageMessage::Pointer imgMsg = dynamic_cast<igtl::ImageMessage*>(bodyMsg.GetPointer());
+    if (this->ReceiveMessageForRelay(headerMsg, relayMsg) != PLUS_SUCCESS
+        || this->UnpackRelayedMessage(headerMsg, relayMsg, bodyMsg) != PLUS_SUCCESS
+        || vtkPlusIgtlMessageCommon::UnpackImageMessage(imgMsg, trackedFrame, this->ImageMessageEmbeddedTransformName) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Couldn't get image from OpenIGTLink server!");
+      return PLUS_FAIL;
+    }
+  }
+  else if (typeid(*bodyMsg) == typeid(igtl::ImageMessage))
   {
-    if (vtkPlusIgtlMessageCommon::UnpackImageMessage(bodyMsg, this->ClientSocket, trackedFrame, this->ImageMessageEmbeddedTransformName, this->IgtlMessageCrcCheckEnabled) != PLUS_SUCCESS)
+    bool frameAdded = false;
+    if (this->ReceiveImageMessage(headerMsg, unfilteredTimestamp, trackedFrame, frameAdded) != PLUS_SUCCESS)
     {
       LOG_ERROR("Couldn't get image from OpenIGTLink server!");
       return PLUS_FAIL;
     }
+    if (frameAdded)
+    {
+      return PLUS_SUCCESS;
+    }
+  }
+  else if (typeid(*bodyMsg) == typeid(igtl::PlusCompressedImageMessage) && this->RelayReceivedMessages)
+  {
+    igtl::PlusCompressedImageMessage::Pointer compressedImgMsg = dynamic_cast<igtl::PlusCompressedImageMessage*>(bodyMsg.GetPointer());
+    igtl::ImageMessage::Pointer imgMsg = igtl::ImageMessage::New();
+    if (this->ReceiveMessageForRelay(headerMsg, relayMsg) != PLUS_SUCCESS
+        || this->UnpackRelayedMessage(headerMsg, relayMsg, bodyMsg) != PLUS_SUCCESS
+        || compressedImgMsg->GetImageMessage(imgMsg) != PLUS_SUCCESS
+        || vtkPlusIgtlMessageCommon::UnpackImageMessage(imgMsg, trackedFrame, this->ImageMessageEmbeddedTransformName) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Couldn't get compressed image from OpenIGTLink server!");
+      return PLUS_FAIL;
+    }
+  }
+  else if (typeid(*bodyMsg) == typeid(igtl::PlusCompressedImageMessage))
+  {
+    if (vtkPlusIgtlMessageCommon::UnpackCompressedImageMessage(bodyMsg, this->ClientSocket, trackedFrame, this->ImageMessageEmbeddedTransformName, this->IgtlMessageCrcCheckEnabled) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Couldn't get compressed image from OpenIGTLink server!");
+      return PLUS_FAIL;
+    }
   }
   else if (typeid(*bodyMsg) == typeid(igtl::PlusTrackedFrameMessage))
   {
-    if (vtkPlusIgtlMessageCommon::UnpackTrackedFrameMessage(bodyMsg, this->ClientSocket, trackedFrame, this->ImageMessageEmbeddedTransformName, this->IgtlMessageCrcCheckEnabled) != PLUS_SUCCESS)
+    if (this->RelayReceivedMessages)
+    {
+      igtl::PlusTrackedFrameMessage::Pointer trackedFrameMsg = dynamic_cast<igtl::PlusTrackedFrameMessage*>(bodyMsg.GetPointer());
+      if (this->ReceiveMessageForRelay(headerMsg, relayMsg) != PLUS_SUCCESS || this->UnpackRelayedMessage(headerMsg, relayMsg, bodyMsg) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Couldn't get tracked frame from OpenIGTLink server!");
+        return PLUS_FAIL;
+      }
+      trackedFrame = trackedFrameMsg->GetTrackedFrame();
+      if (this->ImageMessageEmbeddedTransformName.IsValid())
+      {
+        trackedFrame.SetFrameTransform(this->ImageMessageEmbeddedTransformName, trackedFrameMsg->GetEmbeddedImageTransform());
+      }
+    }
+    else if (vtkPlusIgtlMessageCommon::UnpackTrackedFrameMessage(bodyMsg, this->ClientSocket, trackedFrame, this->ImageMessageEmbeddedTransformName, this->IgtlMessageCrcCheckEnabled) != PLUS_SUCCESS)
     {
       LOG_ERROR("Couldn't get tracked frame from OpenIGTLink server!");
       return PLUS_FAIL;
     }
     double unfilteredTimestampUtc = trackedFrame.GetTimestamp();
-    if (this->UseReceivedTimestamps)
+    if (this->UseReceivedTimestamps && this->IsHardwareClockEnabled())
+    {
+      // The sender clock is synchronized to this computer (e.g., by PTP), the hardware clock converts with the current UTC offset
+      unfilteredTimestamp = this->GetSystemTimeFromHardwareTimestamp(unfilteredTimestampUtc, unfilteredTimestamp);
+    }
+    else if (this->UseReceivedTimestamps)
     {
       // Use the timestamp in the OpenIGTLink message
       // The received timestamp is in UTC and timestamps in the buffer are in system time, so conversion is needed
@@ -142,11 +207,92 @@ PlusStatus vtkPlusOpenIGTLinkVideoSource::InternalUpdate()
   }
   igsioFieldMapType customFields = trackedFrame.GetCustomFields();
   PlusStatus status = aSource->AddItem(trackedFrame.GetImageData(), this->FrameNumber, unfilteredTimestamp, filteredTimestamp, &customFields);
+  if (status == PLUS_SUCCESS && relayMsg.IsNotNull())
+  {
+    this->AddRelayedMessage(headerMsg, relayMsg, filteredTimestamp);
+  }
   this->Modified();
 
   return status;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkVideoSource::ReceiveImageMessage(igtl::MessageHeader::Pointer headerMsg, double unfilteredTimestamp, igsioTrackedFrame& trackedFrame, bool& frameAdded)
+{
+  frameAdded = false;
+
+  // The image can only be received into the buffer if the buffer format is already set (by the first frame) and the
+  // frame does not have to be clipped or reoriented
+  vtkPlusDataSource* aSource = NULL;
+  bool bufferFormatMatches = this->GetFirstActiveOutputVideoSource(aSource) == PLUS_SUCCESS
+                             && aSource->GetNumberOfItems() > 0
+                             && !igsioCommon::IsClippingRequested(aSource->GetClipRectangleOrigin(), aSource->GetClipRectangleSize())
+                             && aSource->GetInputImageOrientation() == aSource->GetOutputImageOrientation();
+
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> socketGuard(this->SocketMutex);
+
+  // Receive the message body up to the image data: the extended header (from header version 2) and the image header
+  IgtlMessageBodyReceiver receiver(this->ClientSocket, headerMsg.GetPointer(), this->IgtlMessageCrcCheckEnabled != 0);
+  igtl_image_header imageHeader;
+  if (receiver.ReceiveExtendedHeader() != PLUS_SUCCESS || receiver.ReceiveImageHeader(imageHeader) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to receive image header of image message in device " << this->GetDeviceId());
+    receiver.Finish();
+    return PLUS_FAIL;
+  }
+
+  FrameSizeType frameSize = { imageHeader.size[0], imageHeader.size[1], imageHeader.size[2] };
+  bool wholeImage = imageHeader.subvol_offset[0] == 0 && imageHeader.subvol_offset[1] == 0 && imageHeader.subvol_offset[2] == 0
+                    && imageHeader.subvol_size[0] == imageHeader.size[0] && imageHeader.subvol_size[1] == imageHeader.size[1] && imageHeader.subvol_size[2] == imageHeader.size[2];
+
+  void* frameDataPtr = NULL;
+  unsigned int frameSizeInBytes = 0;
+  if (bufferFormatMatches
+      && wholeImage
+      && frameSize == aSource->GetInputFrameSize()
+      && PlusCommon::GetVTKScalarPixelTypeFromIGTL(imageHeader.scalar_type) == aSource->GetPixelType()
+      && imageHeader.num_components == aSource->GetNumberOfScalarComponents()
+      && aSource->ReserveNewItem(frameDataPtr, frameSizeInBytes) == PLUS_SUCCESS)
+  {
+    if (frameSizeInBytes == igtl_image_get_data_size(&imageHeader))
+    {
+      // Finish receives the meta data (from header version 2, not used for image messages) and verifies the CRC,
+      // the reserved item is only committed if the whole message is valid
+      if (receiver.Receive(frameDataPtr, frameSizeInBytes) != PLUS_SUCCESS || receiver.Finish() != PLUS_SUCCESS)
+      {
+        aSource->CancelReservedItem();
+        receiver.Finish();
+        LOG_ERROR("Failed to receive image data of image message in device " << this->GetDeviceId());
+        return PLUS_FAIL;
+      }
+
+      igsioFieldMapType customFields;
+      if (this->ImageMessageEmbeddedTransformName.IsValid())
+      {
+        vtkNew<vtkMatrix4x4> ijkToRasMatrix;
+        if (vtkPlusIgtlMessageCommon::UnpackImageHeaderTransform(imageHeader, ijkToRasMatrix.GetPointer()) != PLUS_SUCCESS)
+        {
+          aSource->CancelReservedItem();
+          return PLUS_FAIL;
+        }
+        trackedFrame.SetFrameTransform(this->ImageMessageEmbeddedTransformName, ijkToRasMatrix.GetPointer());
+        customFields = trackedFrame.GetCustomFields();
+      }
+
+      // The timestamps are not filtered and frame number is increased by 1, as for unpacked images
+      this->FrameNumber++;
+      frameAdded = true;
+      PlusStatus status = aSource->CommitReservedItem(this->FrameNumber, unfilteredTimestamp, unfilteredTimestamp, &customFields);
+      this->Modified();
+      return status;
+    }
+    aSource->CancelReservedItem();
+  }
+
+  // The image format is different from the buffer format, receive the image into the tracked frame
+  return vtkPlusIgtlMessageCommon::ReceiveImageData(receiver, headerMsg.GetPointer(), imageHeader, trackedFrame, this->ImageMessageEmbeddedTransformName);
+}
+
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusOpenIGTLinkVideoSource::ReadConfiguration(vtkXMLDataElement* rootConfigElement)
 {
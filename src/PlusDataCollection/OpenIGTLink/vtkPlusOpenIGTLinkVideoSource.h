@@ -48,6 +48,14 @@ protected:
   vtkPlusOpenIGTLinkVideoSource();
   virtual ~vtkPlusOpenIGTLinkVideoSource();
 
+  /*!
+    Receive the body of an IMAGE message.
+    If the image has the same format as the frames in the video buffer then the image data is received from the socket
+    directly into the next frame of the buffer and frameAdded is set to true. Otherwise the image is received into trackedFrame.
+    The frame is only added to the buffer if the CRC check (if enabled) succeeds.
+  */
+  PlusStatus ReceiveImageMessage(igtl::MessageHeader::Pointer headerMsg, double unfilteredTimestamp, igsioTrackedFrame& trackedFrame, bool& frameAdded);
+
 private:
   vtkPlusOpenIGTLinkVideoSource(const vtkPlusOpenIGTLinkVideoSource&);   // Not implemented.
   void operator=(const vtkPlusOpenIGTLinkVideoSource&);   // Not implemented.
@@ -374,16 +374,24 @@ void vtkPlusOptiTrack::vtkInternal::InternalCallback(sFrameOfMocapData* data, vo
   sRigidBodyData* rigidBodies = data->RigidBodies;
 
   // identity transform for tools out of view
-  vtkSmartPointer<vtkMatrix4x4> rigidBodyToTrackerMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  vtkSmartPointer<vtkMatrix4x4> identityMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+
+  // all rigid bodies are measured in the same frame, so they are added to the buffers in one batch
+  ToolTimeStampedItemList toolItems;
+  toolItems.reserve(numberOfRigidBodies);
+  std::vector<vtkSmartPointer<vtkMatrix4x4> > rigidBodyToTrackerMatrices;
+  rigidBodyToTrackerMatrices.reserve(numberOfRigidBodies);
 
   for (int rigidBodyId = 0; rigidBodyId < numberOfRigidBodies; ++rigidBodyId)
   {
-    // TOOL IN VIEW
-    rigidBodyToTrackerMatrix->Identity();
     sRigidBodyData currentRigidBody = rigidBodies[rigidBodyId];
 
     if (currentRigidBody.MeanError != 0)
     {
+      // TOOL IN VIEW
+      vtkSmartPointer<vtkMatrix4x4> rigidBodyToTrackerMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+      rigidBodyToTrackerMatrices.push_back(rigidBodyToTrackerMatrix);
+
       // convert translation to mm
       double translation[3] = { currentRigidBody.x * self->Internal->UnitsToMm, currentRigidBody.y * self->Internal->UnitsToMm, currentRigidBody.z * self->Internal->UnitsToMm };
 
@@ -407,16 +415,17 @@ void vtkPlusOptiTrack::vtkInternal::InternalCallback(sFrameOfMocapData* data, vo
 
       // make sure the tool was specified in the Config file
       igsioTransformName toolToTracker = self->Internal->MapRBNameToTransform[currentRigidBody.ID];
-      self->ToolTimeStampedUpdate(toolToTracker.GetTransformName(), rigidBodyToTrackerMatrix, (bTrackingValid ? TOOL_OK : TOOL_INVALID), self->FrameNumber, unfilteredTimestamp);
+      toolItems.push_back(ToolTimeStampedItem(toolToTracker.GetTransformName(), rigidBodyToTrackerMatrix, (bTrackingValid ? TOOL_OK : TOOL_INVALID), self->FrameNumber));
     }
     else
     {
       // TOOL OUT OF VIEW
       igsioTransformName toolToTracker = self->Internal->MapRBNameToTransform[currentRigidBody.ID];
-      self->ToolTimeStampedUpdate(toolToTracker.GetTransformName(), rigidBodyToTrackerMatrix, TOOL_OUT_OF_VIEW, self->FrameNumber, unfilteredTimestamp);
+      toolItems.push_back(ToolTimeStampedItem(toolToTracker.GetTransformName(), identityMatrix, TOOL_OUT_OF_VIEW, self->FrameNumber));
     }
 
   }
+  self->AddTimeStampedItems(toolItems, unfilteredTimestamp);
 
   self->FrameNumber++;
 }
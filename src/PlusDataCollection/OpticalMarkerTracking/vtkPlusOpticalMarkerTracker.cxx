@@ -21,9 +21,11 @@ See License.txt for details.
 #include <vtkObjectFactory.h>
 
 // OS includes
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <set>
+#include <thread>
 
 // aruco includes
 #include <markerdetector.h>
@@ -35,6 +37,7 @@ See License.txt for details.
 #include <opencv2/highgui.hpp>
 #include <opencv2/calib3d.hpp>
 #include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
 
 //----------------------------------------------------------------------------
 
@@ -74,6 +77,23 @@ namespace
     std::string ToolName;
     aruco::MarkerPoseTracker MarkerPoseTracker;
     vtkSmartPointer<vtkMatrix4x4> transformMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+
+    // ROI tracking state
+
+    /*! Detector used for the ROI of this tool, so that the ROIs can be processed in parallel */
+    std::shared_ptr<aruco::MarkerDetector> RoiMarkerDetector;
+    /*! Region where the marker is searched in the next frame */
+    cv::Rect Roi;
+    bool RoiValid = false;
+    /*! Marker center in the last frame and its motion since the frame before, for predicting the next position */
+    cv::Point2f LastMarkerCenter;
+    cv::Point2f MarkerVelocity;
+
+    // Detection results of the current frame
+
+    aruco::Marker Marker;
+    bool MarkerDetected = false;
+    bool PoseEstimated = false;
   };
 }
 //----------------------------------------------------------------------------
@@ -87,6 +107,12 @@ public:
     , MarkerDetector(std::make_shared<aruco::MarkerDetector>())
     , CameraParameters(std::make_shared<aruco::CameraParameters>())
     , MarkerFound(false)
+    , DetectionMode(DETECTION_FULL_FRAME)
+    , FullFrameDetectionIntervalFrames(30)
+    , FullFrameDetectionScale(0.5)
+    , RoiMarginFactor(0.5)
+    , FramesSinceFullFrameDetection(0)
+    , FullFrameDetectionRequested(true)
   {
   }
 
@@ -98,6 +124,18 @@ public:
 
   PlusStatus BuildTransformMatrix(vtkSmartPointer<vtkMatrix4x4> transformMatrix, const cv::Mat& Rvec, const cv::Mat& Tvec);
 
+  /*! Detect markers in the full frame, downscaled by the given factor. Marker corners are returned in full frame coordinates. */
+  void DetectMarkersInFullFrame(cv::Mat& image, double scale, std::vector<aruco::Marker>& markers);
+
+  /*! Search the marker of the tool in its ROI and estimate its pose. Only accesses the tool, so tools can be processed in parallel. */
+  void TrackToolInRoi(TrackedTool& tool, const cv::Mat& image);
+
+  /*! Estimate the pose of the detected marker of the tool */
+  void EstimateToolPose(TrackedTool& tool);
+
+  /*! Set the ROI of the tool for the next frame from the detected marker and its predicted motion */
+  void UpdateToolRoi(TrackedTool& tool, const cv::Size& imageSize, bool resetMotion);
+
   std::string               CameraCalibrationFile;
   TRACKING_METHOD           TrackingMethod;
   std::string               MarkerDictionary;
@@ -109,6 +147,14 @@ public:
   std::shared_ptr<aruco::MarkerDetector>    MarkerDetector;
   std::shared_ptr<aruco::CameraParameters>  CameraParameters;
   std::vector<aruco::Marker>                Markers;
+
+  DETECTION_MODE            DetectionMode;
+  int                       FullFrameDetectionIntervalFrames;
+  double                    FullFrameDetectionScale;
+  double                    RoiMarginFactor;
+  int                       FramesSinceFullFrameDetection;
+  /*! Set when a marker is lost in ROI tracking, so that it is searched in the full frame */
+  bool                      FullFrameDetectionRequested;
 };
 
 //----------------------------------------------------------------------------
@@ -143,6 +189,15 @@ PlusStatus vtkPlusOpticalMarkerTracker::ReadConfiguration(vtkXMLDataElement* roo
   XML_READ_STRING_ATTRIBUTE_NONMEMBER_REQUIRED(CameraCalibrationFile, this->Internal->CameraCalibrationFile, deviceConfig);
   XML_READ_ENUM2_ATTRIBUTE_NONMEMBER_OPTIONAL(TrackingMethod, this->Internal->TrackingMethod, deviceConfig, "OPTICAL", TRACKING_OPTICAL, "OPTICAL_AND_DEPTH", TRACKING_OPTICAL_AND_DEPTH);
   XML_READ_STRING_ATTRIBUTE_NONMEMBER_REQUIRED(MarkerDictionary, this->Internal->MarkerDictionary, deviceConfig);
+  XML_READ_ENUM2_ATTRIBUTE_NONMEMBER_OPTIONAL(DetectionMode, this->Internal->DetectionMode, deviceConfig, "FULL_FRAME", DETECTION_FULL_FRAME, "ROI_TRACKING", DETECTION_ROI_TRACKING);
+  XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, FullFrameDetectionIntervalFrames, this->Internal->FullFrameDetectionIntervalFrames, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(double, FullFrameDetectionScale, this->Internal->FullFrameDetectionScale, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(double, RoiMarginFactor, this->Internal->RoiMarginFactor, deviceConfig);
+  if (this->Internal->FullFrameDetectionScale <= 0.0 || this->Internal->FullFrameDetectionScale > 1.0)
+  {
+    LOG_WARNING("FullFrameDetectionScale must be in the (0, 1] range, full resolution is used instead of " << this->Internal->FullFrameDetectionScale);
+    this->Internal->FullFrameDetectionScale = 1.0;
+  }
 
   XML_FIND_NESTED_ELEMENT_REQUIRED(dataSourcesElement, deviceConfig, "DataSources");
   for (int nestedElementIndex = 0; nestedElementIndex < dataSourcesElement->GetNumberOfNestedElements(); nestedElementIndex++)
@@ -219,6 +274,10 @@ PlusStatus vtkPlusOpticalMarkerTracker::WriteConfiguration(vtkXMLDataElement* ro
       LOG_ERROR("Unknown tracking method passed to vtkPlusOpticalMarkerTracker::WriteConfiguration");
       return PLUS_FAIL;
   }
+  deviceConfig->SetAttribute("DetectionMode", this->Internal->DetectionMode == DETECTION_ROI_TRACKING ? "ROI_TRACKING" : "FULL_FRAME");
+  deviceConfig->SetIntAttribute("FullFrameDetectionIntervalFrames", this->Internal->FullFrameDetectionIntervalFrames);
+  deviceConfig->SetDoubleAttribute("FullFrameDetectionScale", this->Internal->FullFrameDetectionScale);
+  deviceConfig->SetDoubleAttribute("RoiMarginFactor", this->Internal->RoiMarginFactor);
 
   //TODO: Write data for custom attributes
 
@@ -256,6 +315,16 @@ PlusStatus vtkPlusOpticalMarkerTracker::InternalConnect()
   params._thresParam1_range = 2;
   this->Internal->MarkerDetector->setParams(params);
 
+  // aruco detectors are not thread-safe, each tool gets its own for detection in its ROI
+  for (std::vector<TrackedTool>::iterator toolIt = begin(this->Internal->Tools); toolIt != end(this->Internal->Tools); ++toolIt)
+  {
+    toolIt->RoiMarkerDetector = std::make_shared<aruco::MarkerDetector>();
+    toolIt->RoiMarkerDetector->setDictionary(this->Internal->MarkerDictionary);
+    toolIt->RoiMarkerDetector->setParams(params);
+    toolIt->RoiValid = false;
+  }
+  this->Internal->FullFrameDetectionRequested = true;
+
   bool lowestRateKnown = false;
   double lowestRate = 30; // just a usual value (FPS)
   for (ChannelContainerConstIterator it = begin(this->InputChannels); it != end(this->InputChannels); ++it)
@@ -280,6 +349,16 @@ PlusStatus vtkPlusOpticalMarkerTracker::InternalConnect()
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusOpticalMarkerTracker::InternalResumeFromIdle()
+{
+  for (std::vector<TrackedTool>::iterator toolIt = begin(this->Internal->Tools); toolIt != end(this->Internal->Tools); ++toolIt)
+  {
+    toolIt->RoiValid = false;
+  }
+  this->Internal->FullFrameDetectionRequested = true;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusOpticalMarkerTracker::NotifyConfigured()
 {
@@ -318,6 +397,106 @@ PlusStatus vtkPlusOpticalMarkerTracker::vtkInternal::BuildTransformMatrix(vtkSma
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusOpticalMarkerTracker::vtkInternal::DetectMarkersInFullFrame(cv::Mat& image, double scale, std::vector<aruco::Marker>& markers)
+{
+  if (scale < 1.0)
+  {
+    cv::Mat scaledImage;
+    cv::resize(image, scaledImage, cv::Size(), scale, scale, cv::INTER_AREA);
+    this->MarkerDetector->detect(scaledImage, markers);
+    const float inverseScale = static_cast<float>(1.0 / scale);
+    for (std::vector<aruco::Marker>::iterator markerIt = begin(markers); markerIt != end(markers); ++markerIt)
+    {
+      for (std::vector<cv::Point2f>::iterator cornerIt = markerIt->begin(); cornerIt != markerIt->end(); ++cornerIt)
+      {
+        *cornerIt *= inverseScale;
+      }
+    }
+  }
+  else
+  {
+    this->MarkerDetector->detect(image, markers);
+  }
+
+  if (!this->MarkerFound &&  markers.size() > 0)
+  {
+    this->MarkerFound = true;
+  }
+
+  if (!this->MarkerFound)
+  {
+    // Try flipping the incoming image horizontally and trying again
+    // This is a very common obstacle
+    cv::flip(image, image, 1); // 0 flip vert, > 0 flip horz, < 0 flip both (eewwwwwww)
+    this->MarkerDetector->detect(image, markers);
+    if (markers.size() > 0)
+    {
+      // We have a flip problem!
+      vtkPlusDataSource* source(nullptr);
+      this->External->InputChannels[0]->GetVideoSource(source);
+      source->SetInputImageOrientation(igsioCommon::HorizontalFlip(source->GetInputImageOrientation()));
+      LOG_WARNING("Autodetected horizontal image flip problem. It has been corrected for this session. " \
+                  "Be sure to save your config file or update your existing file to the new orientation: " \
+                  << igsioCommon::GetStringFromUsImageOrientation(source->GetInputImageOrientation()));
+      this->MarkerFound = true;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusOpticalMarkerTracker::vtkInternal::TrackToolInRoi(TrackedTool& tool, const cv::Mat& image)
+{
+  tool.MarkerDetected = false;
+  tool.PoseEstimated = false;
+
+  std::vector<aruco::Marker> markers;
+  tool.RoiMarkerDetector->detect(image(tool.Roi), markers);
+  for (std::vector<aruco::Marker>::iterator markerIt = begin(markers); markerIt != end(markers); ++markerIt)
+  {
+    if (markerIt->id != tool.MarkerId)
+    {
+      continue;
+    }
+    tool.Marker = *markerIt;
+    const cv::Point2f roiOrigin(static_cast<float>(tool.Roi.x), static_cast<float>(tool.Roi.y));
+    for (std::vector<cv::Point2f>::iterator cornerIt = tool.Marker.begin(); cornerIt != tool.Marker.end(); ++cornerIt)
+    {
+      *cornerIt += roiOrigin;
+    }
+    tool.MarkerDetected = true;
+    this->EstimateToolPose(tool);
+    break;
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusOpticalMarkerTracker::vtkInternal::EstimateToolPose(TrackedTool& tool)
+{
+  tool.PoseEstimated = false;
+  if (tool.MarkerPoseTracker.estimatePose(tool.Marker, *this->CameraParameters, tool.MarkerSizeMm / MM_PER_M, 4))
+  {
+    // pose successfully estimated, update transform
+    tool.PoseEstimated = (this->BuildTransformMatrix(tool.transformMatrix, tool.MarkerPoseTracker.getRvec(), tool.MarkerPoseTracker.getTvec()) == PLUS_SUCCESS);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusOpticalMarkerTracker::vtkInternal::UpdateToolRoi(TrackedTool& tool, const cv::Size& imageSize, bool resetMotion)
+{
+  const cv::Rect bounds = cv::boundingRect(static_cast<const std::vector<cv::Point2f>&>(tool.Marker));
+  const cv::Point2f center(bounds.x + bounds.width * 0.5f, bounds.y + bounds.height * 0.5f);
+  tool.MarkerVelocity = resetMotion ? cv::Point2f(0.0f, 0.0f) : center - tool.LastMarkerCenter;
+  tool.LastMarkerCenter = center;
+
+  // constant velocity prediction, the margin covers the marker size change and the prediction error
+  const double margin = std::max(bounds.width, bounds.height) * this->RoiMarginFactor + cv::norm(tool.MarkerVelocity);
+  const cv::Rect predictedRoi(cvFloor(bounds.x + tool.MarkerVelocity.x - margin), cvFloor(bounds.y + tool.MarkerVelocity.y - margin),
+                              cvCeil(bounds.width + 2 * margin), cvCeil(bounds.height + 2 * margin));
+  tool.Roi = predictedRoi & cv::Rect(0, 0, imageSize.width, imageSize.height);
+  tool.RoiValid = (tool.Roi.area() > 0);
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusOpticalMarkerTracker::InternalUpdate()
 {
@@ -360,67 +539,102 @@ PlusStatus vtkPlusOpticalMarkerTracker::InternalUpdate()
   //PixelCodec::RgbBgrSwap(dim[0], dim[1], (unsigned char*)frame->GetScalarPointer(), image.data);
   image.data = (unsigned char*)frame->GetScalarPointer();
 
-  // detect markers in frame
-  this->Internal->MarkerDetector->detect(image, this->Internal->Markers);
+  const double unfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+  const bool roiTracking = (this->Internal->DetectionMode == DETECTION_ROI_TRACKING);
 
-  if (!this->Internal->MarkerFound &&  this->Internal->Markers.size() > 0)
+  // in ROI tracking mode the full frame is only searched periodically and after a marker is lost
+  const bool fullFrameDetection = !roiTracking
+                                  || this->Internal->FullFrameDetectionRequested
+                                  || this->Internal->FramesSinceFullFrameDetection >= this->Internal->FullFrameDetectionIntervalFrames;
+  if (fullFrameDetection)
   {
-    this->Internal->MarkerFound = true;
+    this->Internal->DetectMarkersInFullFrame(image, roiTracking ? this->Internal->FullFrameDetectionScale : 1.0, this->Internal->Markers);
+    this->Internal->FramesSinceFullFrameDetection = 0;
+    this->Internal->FullFrameDetectionRequested = false;
   }
-
-  if (!this->Internal->MarkerFound)
+  else
   {
-    // Try flipping the incoming image horizontally and trying again
-    // This is a very common obstacle
-    cv::flip(image, image, 1); // 0 flip vert, > 0 flip horz, < 0 flip both (eewwwwwww)
-    this->Internal->MarkerDetector->detect(image, this->Internal->Markers);
-    if (this->Internal->Markers.size() > 0)
-    {
-      // We have a flip problem!
-      vtkPlusDataSource* source(nullptr);
-      this->InputChannels[0]->GetVideoSource(source);
-      source->SetInputImageOrientation(igsioCommon::HorizontalFlip(source->GetInputImageOrientation()));
-      LOG_WARNING("Autodetected horizontal image flip problem. It has been corrected for this session. " \
-                  "Be sure to save your config file or update your existing file to the new orientation: " \
-                  << igsioCommon::GetStringFromUsImageOrientation(source->GetInputImageOrientation()));
-      this->Internal->MarkerFound = true;
-    }
+    this->Internal->FramesSinceFullFrameDetection++;
   }
 
-  // iterate through tools updating tracking
+  std::vector<TrackedTool*> roiTools;
   for (std::vector<TrackedTool>::iterator toolIt = begin(this->Internal->Tools); toolIt != end(this->Internal->Tools); ++toolIt)
   {
-    bool toolInFrame = false;
-    const double unfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
-    for (std::vector<aruco::Marker>::iterator markerIt = begin(this->Internal->Markers); markerIt != end(this->Internal->Markers); ++markerIt)
+    toolIt->MarkerDetected = false;
+    toolIt->PoseEstimated = false;
+    if (fullFrameDetection)
     {
-      if (toolIt->MarkerId == markerIt->id)
+      for (std::vector<aruco::Marker>::iterator markerIt = begin(this->Internal->Markers); markerIt != end(this->Internal->Markers); ++markerIt)
       {
-        //marker is in frame
-        toolInFrame = true;
-
-        if (toolIt->MarkerPoseTracker.estimatePose(*markerIt, *this->Internal->CameraParameters, toolIt->MarkerSizeMm / MM_PER_M, 4))
+        if (toolIt->MarkerId != markerIt->id)
+        {
+          continue;
+        }
+        toolIt->Marker = *markerIt;
+        if (roiTracking)
         {
-          // pose successfully estimated, update transform
-          cv::Mat Rvec = toolIt->MarkerPoseTracker.getRvec();
-          cv::Mat Tvec = toolIt->MarkerPoseTracker.getTvec();
-          this->Internal->BuildTransformMatrix(toolIt->transformMatrix, Rvec, Tvec);
-          ToolTimeStampedUpdate(toolIt->ToolSourceId, toolIt->transformMatrix, TOOL_OK, this->FrameNumber, unfilteredTimestamp);
+          // the marker is localized accurately in its full resolution ROI below
+          this->Internal->UpdateToolRoi(*toolIt, image.size(), true);
         }
         else
         {
-          // pose estimation failed
-          // TODO: add frame num, marker id, etc. Make this error more helpful.  Is there a way to handle it?
-          LOG_ERROR("Pose estimation failed. Tool " << toolIt->ToolSourceId << " with marker " << toolIt->MarkerId << ".");
+          toolIt->MarkerDetected = true;
+          this->Internal->EstimateToolPose(*toolIt);
         }
         break;
       }
     }
-    if (!toolInFrame)
+    if (roiTracking && toolIt->RoiValid)
+    {
+      roiTools.push_back(&(*toolIt));
+    }
+  }
+
+  // the ROIs are independent, they are processed in parallel (the first one in this thread)
+  std::vector<std::thread> roiThreads;
+  for (size_t roiIndex = 1; roiIndex < roiTools.size(); ++roiIndex)
+  {
+    roiThreads.push_back(std::thread(&vtkInternal::TrackToolInRoi, this->Internal, std::ref(*roiTools[roiIndex]), std::cref(image)));
+  }
+  if (!roiTools.empty())
+  {
+    this->Internal->TrackToolInRoi(*roiTools[0], image);
+  }
+  for (std::vector<std::thread>::iterator threadIt = begin(roiThreads); threadIt != end(roiThreads); ++threadIt)
+  {
+    threadIt->join();
+  }
+  for (std::vector<TrackedTool*>::iterator toolIt = begin(roiTools); toolIt != end(roiTools); ++toolIt)
+  {
+    if ((*toolIt)->MarkerDetected)
+    {
+      this->Internal->UpdateToolRoi(**toolIt, image.size(), false);
+    }
+    else
+    {
+      (*toolIt)->RoiValid = false;
+      this->Internal->FullFrameDetectionRequested = true;
+    }
+  }
+
+  // iterate through tools updating tracking
+  for (std::vector<TrackedTool>::iterator toolIt = begin(this->Internal->Tools); toolIt != end(this->Internal->Tools); ++toolIt)
+  {
+    if (!toolIt->MarkerDetected)
     {
       // tool not in frame
       ToolTimeStampedUpdate(toolIt->ToolSourceId, toolIt->transformMatrix, TOOL_OUT_OF_VIEW, this->FrameNumber, unfilteredTimestamp);
     }
+    else if (toolIt->PoseEstimated)
+    {
+      ToolTimeStampedUpdate(toolIt->ToolSourceId, toolIt->transformMatrix, TOOL_OK, this->FrameNumber, unfilteredTimestamp);
+    }
+    else
+    {
+      // pose estimation failed
+      // TODO: add frame num, marker id, etc. Make this error more helpful.  Is there a way to handle it?
+      LOG_ERROR("Pose estimation failed. Tool " << toolIt->ToolSourceId << " with marker " << toolIt->MarkerId << ".");
+    }
   }
 
   this->FrameNumber++;
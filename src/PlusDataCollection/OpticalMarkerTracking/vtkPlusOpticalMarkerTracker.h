@@ -14,6 +14,13 @@ See License.txt for details.
 /*!
   \class vtkPlusOpticalMarkerTracker
   \brief Virtual device that tracks fiducial markers on the input channel in real time.
+
+  With DetectionMode="FULL_FRAME" (default) the markers are detected in the full camera frame in every update.
+  With DetectionMode="ROI_TRACKING" each tool marker is searched only in a region of interest around its position
+  predicted from the previous frames, and the regions are processed in parallel. A downscaled (FullFrameDetectionScale)
+  full-frame detection is done only every FullFrameDetectionIntervalFrames frames, and in the frame after a marker is lost,
+  to find new and lost markers. RoiMarginFactor is the margin around the predicted marker bounding box, relative to its size.
+
   \ingroup PlusLibDataCollection
 */
 class vtkPlusDataCollectionExport vtkPlusOpticalMarkerTracker : public vtkPlusDevice
@@ -26,6 +33,13 @@ public:
     TRACKING_OPTICAL_AND_DEPTH
   };
 
+  /*! Defines where the markers are searched in the camera frames. */
+  enum DETECTION_MODE
+  {
+    DETECTION_FULL_FRAME,
+    DETECTION_ROI_TRACKING
+  };
+
   static vtkPlusOpticalMarkerTracker* New();
   vtkTypeMacro(vtkPlusOpticalMarkerTracker, vtkPlusDevice);
   virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
@@ -53,6 +67,9 @@ protected:
   vtkPlusOpticalMarkerTracker();
   ~vtkPlusOpticalMarkerTracker();
 
+  /*! Marker positions from before the idle period are not used for predicting the ROIs */
+  virtual void InternalResumeFromIdle();
+
   class vtkInternal;
   vtkInternal* Internal;
 
@@ -18,7 +18,7 @@ See License.txt for details.
 // OpenCV includes
 #include <opencv2/imgproc.hpp>
 #include <opencv2/core/mat.hpp>
-#if defined(PLUS_USE_OPENCL)
+#if defined(PLUS_USE_OvrvisionPro_OPENCL)
   #include <opencv2/core/ocl.hpp>
 
   // OpenCL includes
@@ -74,7 +74,7 @@ PlusStatus vtkPlusOvrvisionProVideoSource::InternalConnect()
 {
   LOG_TRACE("vtkPlusOvrvisionProVideoSource::InternalConnect");
 
-#if defined(PLUS_USE_OPENCL)
+#if defined(PLUS_USE_OvrvisionPro_OPENCL)
   cv::ocl::setUseOpenCL(true);
 #endif
 
@@ -113,7 +113,7 @@ PlusStatus vtkPlusOvrvisionProVideoSource::InternalConnect()
   this->OvrvisionProHandle.SetCameraSyncMode(CameraSync);
   this->OvrvisionProHandle.SetCameraExposure(Exposure);
 
-#if defined(PLUS_USE_OPENCL)
+#if defined(PLUS_USE_OvrvisionPro_OPENCL)
   cl_platform_id id = this->OvrvisionProHandle.GetPlatformId();
   cv::ocl::PlatformInfo info(&id);
 
@@ -153,7 +153,7 @@ PlusStatus vtkPlusOvrvisionProVideoSource::InternalUpdate()
   // Query the SDK for the latest frames
   if (this->IsCapturingRGB)
   {
-#if defined(PLUS_USE_OPENCL)
+#if defined(PLUS_USE_OvrvisionPro_OPENCL)
     OvrvisionProHandle.Capture(this->ProcessingMode); // Capture does not copy it to CPU
 
     cv::ocl::convertFromImage(OvrvisionProHandle.GetLeftCLImage(), this->LeftImageCL);
@@ -101,7 +101,7 @@ protected:
   vtkPlusDataSource* LeftEyeDataSource;
   vtkPlusDataSource* RightEyeDataSource;
 
-#if defined(PLUS_USE_OPENCL)
+#if defined(PLUS_USE_OvrvisionPro_OPENCL)
   cv::UMat LeftImageCL;
   cv::UMat RightImageCL;
 #endif
@@ -20,6 +20,7 @@ Authors include:
 #include "vtkPlusDataSource.h"
 
 // STL includes
+#include <algorithm>
 #include <future>
 
 // Philips API includes
@@ -42,12 +43,78 @@ vtkPlusPhilips3DProbeVideoSource* vtkPlusPhilips3DProbeVideoSource::ActiveDevice
 
 namespace
 {
-  vtkImageData* streamedImageData = NULL;
   static double LastValidTimestamp(0);
   static double LastRetryTime(0);
 
   const double TIMEOUT = 1.0; // 1 seconds;
   const double RETRY_TIMER = 0.5; // 1/2 second
+
+  //----------------------------------------------------------------------------
+  // Copy the volume and get its maximum pixel value in the same pass
+  unsigned char CopyVolumeAndGetMaximum(const unsigned char* source, unsigned char* destination, size_t numberOfVoxels)
+  {
+    unsigned char maxPixelValue(0);
+    for (size_t i = 0; i < numberOfVoxels; ++i)
+    {
+      unsigned char value = source[i];
+      destination[i] = value;
+      if (value > maxPixelValue)
+      {
+        maxPixelValue = value;
+      }
+    }
+    return maxPixelValue;
+  }
+
+  //----------------------------------------------------------------------------
+  FrameSizeType GetDownsampledSize(const FrameSizeType& size, int factor)
+  {
+    FrameSizeType downsampledSize = { (size[0] + factor - 1) / factor, (size[1] + factor - 1) / factor, (size[2] + factor - 1) / factor };
+    return downsampledSize;
+  }
+
+  //----------------------------------------------------------------------------
+  // Average each block of factor^3 voxels, the blocks at the end of the axes may be smaller
+  void DownsampleVolume(const unsigned char* source, const FrameSizeType& size, int factor, unsigned char* destination)
+  {
+    FrameSizeType downsampledSize = GetDownsampledSize(size, factor);
+    const size_t sliceSize = static_cast<size_t>(size[0]) * size[1];
+    for (unsigned int z = 0; z < downsampledSize[2]; ++z)
+    {
+      unsigned int zEnd = std::min<unsigned int>((z + 1) * factor, size[2]);
+      for (unsigned int y = 0; y < downsampledSize[1]; ++y)
+      {
+        unsigned int yEnd = std::min<unsigned int>((y + 1) * factor, size[1]);
+        for (unsigned int x = 0; x < downsampledSize[0]; ++x)
+        {
+          unsigned int xEnd = std::min<unsigned int>((x + 1) * factor, size[0]);
+          unsigned int sum(0);
+          unsigned int count(0);
+          for (unsigned int sz = z * factor; sz < zEnd; ++sz)
+          {
+            for (unsigned int sy = y * factor; sy < yEnd; ++sy)
+            {
+              const unsigned char* row = source + sz * sliceSize + static_cast<size_t>(sy) * size[0];
+              for (unsigned int sx = x * factor; sx < xEnd; ++sx)
+              {
+                sum += row[sx];
+              }
+              count += xEnd - x * factor;
+            }
+          }
+          *(destination++) = static_cast<unsigned char>((sum + count / 2) / count);
+        }
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // The frames of the buffer can be written directly if they are stored as they are received
+  bool CanReserveItem(vtkPlusDataSource* source)
+  {
+    return !igsioCommon::IsClippingRequested(source->GetClipRectangleOrigin(), source->GetClipRectangleSize())
+           && source->GetInputImageOrientation() == source->GetBuffer()->GetImageOrientation();
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -59,62 +126,24 @@ bool vtkPlusPhilips3DProbeVideoSource::StreamCallback(_int64 id, SClient3DArray*
     return false;
   }
 
-  int dimensions[3] = {ed->width_padded, ed->height_padded, ed->depth_padded};
-
   /*
   * This is way smaller than what Qlab reports. Perhaps the streaming volume
   * is way smaller than the recorded one:
   *
   * 112 x 48 x 112
   */
-  if (streamedImageData == NULL)
-  {
-    // let the calibration matrix handle the spacing and orientation of the volume in 3-space
-    double spacing[3] = {1.0, 1.0, 1.0};
-    double origin[3] = {0.0, 0.0, 0.0};
-
-    streamedImageData = vtkImageData::New();
-    streamedImageData->SetSpacing(spacing);
-    streamedImageData->SetExtent(0, dimensions[0] - 1, 0, dimensions[1] - 1, 0, dimensions[2] - 1);
-    streamedImageData->SetOrigin(origin);
-#if VTK_MAJOR_VERSION > 5
-    streamedImageData->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
-#else
-    streamedImageData->SetScalarTypeToUnsignedChar();
-    streamedImageData->SetNumberOfScalarComponents(1);
-    streamedImageData->AllocateScalars();
-#endif
-
-    vtkPlusDataSource* videoSource(NULL);
-    vtkPlusPhilips3DProbeVideoSource::ActiveDevice->GetFirstVideoSource(videoSource);
-    if (dimensions[0] < 0 || dimensions[1] < 0 || dimensions[2] < 0)
-    {
-      LOG_ERROR("Negative dimensions received from Philips ultrasound device.");
-      return false;
-    }
-    videoSource->SetInputFrameSize(static_cast<unsigned int>(dimensions[0]), static_cast<unsigned int>(dimensions[1]), static_cast<unsigned int>(dimensions[2]));
-    videoSource->SetPixelType(VTK_UNSIGNED_CHAR);
-    videoSource->SetNumberOfScalarComponents(1);
-  }
-  else
+  if (ed->width_padded < 0 || ed->height_padded < 0 || ed->depth_padded < 0)
   {
-    int streamedDimensions[3] = {0, 0, 0};
-    streamedImageData->GetDimensions(streamedDimensions);
-
-    if (dimensions[0] != streamedDimensions[0] || dimensions[1] != streamedDimensions[1] || dimensions[2] != streamedDimensions[2])
-    {
-      LOG_ERROR("Dimensions of new frame do not match dimensions of previous frames. Cannot add frame to buffer.");
-      return false;
-    }
+    LOG_ERROR("Negative dimensions received from Philips ultrasound device.");
+    return false;
   }
+  FrameSizeType volumeSize = { static_cast<unsigned int>(ed->width_padded), static_cast<unsigned int>(ed->height_padded), static_cast<unsigned int>(ed->depth_padded) };
 
-  size_t size = dimensions[0] * dimensions[1] * dimensions[2];
-  unsigned char* src = ed->pData;
-  unsigned char* dst = (unsigned char*)streamedImageData->GetScalarPointer();
-
-  memcpy((void*)dst, (void*)src, size);
-
-  vtkPlusPhilips3DProbeVideoSource::ActiveDevice->CallbackAddFrame(streamedImageData);
+  // The volume is added to the buffer directly from the memory of the stream manager
+  if (vtkPlusPhilips3DProbeVideoSource::ActiveDevice->CallbackAddFrame(ed->pData, volumeSize) != PLUS_SUCCESS)
+  {
+    return false;
+  }
 
   LastValidTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
 
@@ -139,6 +168,10 @@ vtkPlusPhilips3DProbeVideoSource::vtkPlusPhilips3DProbeVideoSource()
   , ZDecimation(2)
   , Set4PtFIR(true)
   , LatAndElevSmoothingIndex(4)
+  , DownsamplingFactor(2)
+  , VideoSource(NULL)
+  , DownsampledVideoSource(NULL)
+  , StreamedVolumeSize({ 0, 0, 0 })
 {
   this->StartThreadForInternalUpdates = true;
   this->AcquisitionRate = 10;
@@ -179,6 +212,11 @@ void vtkPlusPhilips3DProbeVideoSource::PrintSelf(ostream& os, vtkIndent indent)
   {
     this->Listener->PrintSelf(os, indent);
   }
+  if (!this->DownsampledVideoDataSourceId.empty())
+  {
+    os << indent << "DownsampledVideoDataSourceId: " << this->DownsampledVideoDataSourceId << std::endl;
+    os << indent << "DownsamplingFactor: " << this->DownsamplingFactor << std::endl;
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -205,11 +243,8 @@ PlusStatus vtkPlusPhilips3DProbeVideoSource::InternalDisconnect()
 
   this->Listener->Disconnect();
 
-  if (streamedImageData != NULL)
-  {
-    streamedImageData->Delete();
-    streamedImageData = NULL;
-  }
+  // The volume size is set again from the first volume received after connecting
+  this->StreamedVolumeSize = { 0, 0, 0 };
 
   return PLUS_SUCCESS;
 }
@@ -274,6 +309,14 @@ PlusStatus vtkPlusPhilips3DProbeVideoSource::ReadConfiguration(vtkXMLDataElement
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(Set4PtFIR, deviceConfig);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, LatAndElevSmoothingIndex, deviceConfig);
 
+  XML_READ_STRING_ATTRIBUTE_OPTIONAL(DownsampledVideoDataSourceId, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, DownsamplingFactor, deviceConfig);
+  if (this->DownsamplingFactor < 1)
+  {
+    LOG_ERROR("DownsamplingFactor must be at least 1, it is " << this->DownsamplingFactor);
+    return PLUS_FAIL;
+  }
+
   return PLUS_SUCCESS;
 }
 
@@ -294,15 +337,22 @@ PlusStatus vtkPlusPhilips3DProbeVideoSource::WriteConfiguration(vtkXMLDataElemen
   XML_WRITE_BOOL_ATTRIBUTE(Isotropic, deviceConfig);
   XML_WRITE_BOOL_ATTRIBUTE(QuantizeDim, deviceConfig);
   XML_WRITE_BOOL_ATTRIBUTE(Set4PtFIR, deviceConfig);
+  if (!this->DownsampledVideoDataSourceId.empty())
+  {
+    XML_WRITE_STRING_ATTRIBUTE_IF_NOT_EMPTY(DownsampledVideoDataSourceId, deviceConfig);
+    deviceConfig->SetIntAttribute("DownsamplingFactor", this->DownsamplingFactor);
+  }
   return PLUS_SUCCESS;
 }
 
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusPhilips3DProbeVideoSource::NotifyConfigured()
 {
-  if (this->OutputChannels.size() > 1)
+  // The downsampled volumes are provided on a separate output channel
+  unsigned int expectedNumberOfChannels = this->DownsampledVideoDataSourceId.empty() ? 1 : 2;
+  if (this->OutputChannels.size() > expectedNumberOfChannels)
   {
-    LOG_WARNING("vtkPlusPhilips3DProbeVideoSource is expecting one output channel and there are " << this->OutputChannels.size() << " channels. First output channel will be used.");
+    LOG_WARNING("vtkPlusPhilips3DProbeVideoSource is expecting " << expectedNumberOfChannels << " output channel(s) and there are " << this->OutputChannels.size() << " channels.");
     this->SetCorrectlyConfigured(false);
     return PLUS_FAIL;
   }
@@ -314,8 +364,25 @@ PlusStatus vtkPlusPhilips3DProbeVideoSource::NotifyConfigured()
     return PLUS_FAIL;
   }
 
-  vtkPlusDataSource* videoSource(NULL);
-  if (this->GetFirstVideoSource(videoSource) != PLUS_SUCCESS)
+  this->DownsampledVideoSource = NULL;
+  if (!this->DownsampledVideoDataSourceId.empty()
+      && this->GetVideoSource(this->DownsampledVideoDataSourceId.c_str(), this->DownsampledVideoSource) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to find downsampled video source " << this->DownsampledVideoDataSourceId << ".");
+    this->SetCorrectlyConfigured(false);
+    return PLUS_FAIL;
+  }
+
+  this->VideoSource = NULL;
+  for (DataSourceContainerConstIterator it = this->VideoSources.begin(); it != this->VideoSources.end(); ++it)
+  {
+    if (it->second != this->DownsampledVideoSource)
+    {
+      this->VideoSource = it->second;
+      break;
+    }
+  }
+  if (this->VideoSource == NULL)
   {
     LOG_ERROR("Unable to find video source. Device needs a video buffer to put new frames into.");
     this->SetCorrectlyConfigured(false);
@@ -338,55 +405,110 @@ bool vtkPlusPhilips3DProbeVideoSource::IsTracker() const
 }
 
 //----------------------------------------------------------------------------
-void vtkPlusPhilips3DProbeVideoSource::CallbackAddFrame(vtkImageData* imageData)
+PlusStatus vtkPlusPhilips3DProbeVideoSource::CallbackAddFrame(const unsigned char* volumeData, const FrameSizeType& volumeSize)
 {
-  vtkPlusDataSource* videoSource(NULL);
-  if (this->GetFirstVideoSource(videoSource) != PLUS_SUCCESS)
+  if (this->VideoSource == NULL)
   {
     LOG_ERROR("Unable to find video source. Cannot add new frame.");
-    return;
+    return PLUS_FAIL;
   }
 
-  std::future<void> addTask = std::async(std::launch::async, [ = ]()
+  if (this->StreamedVolumeSize[0] == 0 && this->StreamedVolumeSize[1] == 0 && this->StreamedVolumeSize[2] == 0)
   {
-    if (videoSource->AddItem(imageData, videoSource->GetInputImageOrientation(), US_IMG_BRIGHTNESS, this->FrameNumber) != PLUS_SUCCESS)
+    // First volume after connecting, the buffers are allocated for its size
+    this->VideoSource->SetInputFrameSize(volumeSize[0], volumeSize[1], volumeSize[2]);
+    this->VideoSource->SetPixelType(VTK_UNSIGNED_CHAR);
+    this->VideoSource->SetNumberOfScalarComponents(1);
+    if (this->DownsampledVideoSource != NULL)
     {
-      LOG_ERROR("Unable to add item to buffer.");
-      return;
+      FrameSizeType downsampledSize = GetDownsampledSize(volumeSize, this->DownsamplingFactor);
+      this->DownsampledVideoSource->SetInputFrameSize(downsampledSize[0], downsampledSize[1], downsampledSize[2]);
+      this->DownsampledVideoSource->SetPixelType(VTK_UNSIGNED_CHAR);
+      this->DownsampledVideoSource->SetNumberOfScalarComponents(1);
     }
-  });
-  std::future<uint8_t> maxPixelTask = std::async(std::launch::async, [ = ]()
+    this->StreamedVolumeSize = volumeSize;
+  }
+  else if (volumeSize != this->StreamedVolumeSize)
   {
-    int extent[6];
-    imageData->GetExtent(extent);
-    uint8_t* pixelPtr = (uint8_t*)imageData->GetScalarPointer();
-    auto numComponents = imageData->GetNumberOfScalarComponents();
+    LOG_ERROR("Dimensions of new frame do not match dimensions of previous frames. Cannot add frame to buffer.");
+    return PLUS_FAIL;
+  }
 
-    uint8_t maxPixelValue(0);
-    for (int z = 0; z < extent[5] - extent[4]; ++z)
+  // The downsampled volume is computed in parallel with copying the full resolution volume
+  std::future<PlusStatus> downsampleTask;
+  if (this->DownsampledVideoSource != NULL)
+  {
+    downsampleTask = std::async(std::launch::async, [ = ]()
     {
-      for (int y = 0; y < extent[3] - extent[2]; ++y)
-      {
-        for (int x = 0; x < extent[1] - extent[0]; ++x)
-        {
-          if (*pixelPtr > maxPixelValue)
-          {
-            maxPixelValue = *pixelPtr;
-          }
-          pixelPtr += numComponents;
-        }
-      }
-    }
+      return this->AddDownsampledVolume(volumeData, volumeSize);
+    });
+  }
 
-    return maxPixelValue;
-  });
+  const size_t numberOfVoxels = static_cast<size_t>(volumeSize[0]) * volumeSize[1] * volumeSize[2];
+  igsioFieldMapType customFields;
+  customFields["MaximumPixelValue"].first = FRAMEFIELD_NONE;
+  PlusStatus status(PLUS_FAIL);
+  bool added(false);
 
-  addTask.wait();
-  unsigned int maxPixelValue = static_cast<unsigned int>(maxPixelTask.get());
+  void* frameDataPtr(NULL);
+  unsigned int frameSizeInBytes(0);
+  if (CanReserveItem(this->VideoSource) && this->VideoSource->ReserveNewItem(frameDataPtr, frameSizeInBytes) == PLUS_SUCCESS)
+  {
+    if (frameSizeInBytes == numberOfVoxels)
+    {
+      unsigned char maxPixelValue = CopyVolumeAndGetMaximum(volumeData, static_cast<unsigned char*>(frameDataPtr), numberOfVoxels);
+      customFields["MaximumPixelValue"].second = igsioCommon::ToString<unsigned int>(maxPixelValue);
+      status = this->VideoSource->CommitReservedItem(this->FrameNumber, UNDEFINED_TIMESTAMP, UNDEFINED_TIMESTAMP, &customFields);
+      added = true;
+    }
+    else
+    {
+      this->VideoSource->CancelReservedItem();
+    }
+  }
+  if (!added)
+  {
+    // The buffer stores the volume differently (e.g., clipped or reoriented), add it with a single copy
+    unsigned char maxPixelValue = *std::max_element(volumeData, volumeData + numberOfVoxels);
+    customFields["MaximumPixelValue"].second = igsioCommon::ToString<unsigned int>(maxPixelValue);
+    status = this->VideoSource->AddItem(volumeData, this->VideoSource->GetInputImageOrientation(), volumeSize, VTK_UNSIGNED_CHAR, 1, US_IMG_BRIGHTNESS, 0,
+                                        this->FrameNumber, UNDEFINED_TIMESTAMP, UNDEFINED_TIMESTAMP, &customFields);
+  }
+  if (status != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to add item to buffer.");
+  }
 
-  std::stringstream ss;
-  ss << maxPixelValue;
-  videoSource->ModifyBufferItemFrameField(videoSource->GetLatestItemUidInBuffer(), "MaximumPixelValue", ss.str());
+  if (downsampleTask.valid() && downsampleTask.get() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to add downsampled item to buffer.");
+    status = PLUS_FAIL;
+  }
 
   this->FrameNumber++;
-}
\ No newline at end of file
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusPhilips3DProbeVideoSource::AddDownsampledVolume(const unsigned char* volumeData, const FrameSizeType& volumeSize)
+{
+  FrameSizeType downsampledSize = GetDownsampledSize(volumeSize, this->DownsamplingFactor);
+  const size_t numberOfVoxels = static_cast<size_t>(downsampledSize[0]) * downsampledSize[1] * downsampledSize[2];
+
+  void* frameDataPtr(NULL);
+  unsigned int frameSizeInBytes(0);
+  if (CanReserveItem(this->DownsampledVideoSource) && this->DownsampledVideoSource->ReserveNewItem(frameDataPtr, frameSizeInBytes) == PLUS_SUCCESS)
+  {
+    if (frameSizeInBytes == numberOfVoxels)
+    {
+      DownsampleVolume(volumeData, volumeSize, this->DownsamplingFactor, static_cast<unsigned char*>(frameDataPtr));
+      return this->DownsampledVideoSource->CommitReservedItem(this->FrameNumber);
+    }
+    this->DownsampledVideoSource->CancelReservedItem();
+  }
+
+  this->DownsampledVolume.resize(numberOfVoxels);
+  DownsampleVolume(volumeData, volumeSize, this->DownsamplingFactor, &this->DownsampledVolume[0]);
+  return this->DownsampledVideoSource->AddItem(&this->DownsampledVolume[0], this->DownsampledVideoSource->GetInputImageOrientation(), downsampledSize,
+         VTK_UNSIGNED_CHAR, 1, US_IMG_BRIGHTNESS, 0, this->FrameNumber);
+}
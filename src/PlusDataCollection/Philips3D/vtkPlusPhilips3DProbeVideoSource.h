@@ -12,11 +12,23 @@ See License.txt for details.
 #include "vtkPlusDevice.h"
 #include "StreamMgr.h"
 
+#include <vector>
+
 class vtkPlusIEEListener;
 
 /*!
 \class vtkPlusPhilips3DProbeVideoSource
 \brief Class for providing VTK video input interface from Philips ie33 3D ultrasound probe
+
+The streamed volumes are written directly into the preallocated frames of the video buffer if the buffer
+frames can be written in place (no clipping, same input and buffer image orientation), otherwise they are
+added with a single copy. The maximum pixel value of each volume is computed while copying it.
+
+If DownsampledVideoDataSourceId is set then each volume is also downsampled by averaging blocks of
+DownsamplingFactor^3 voxels, in parallel with the full resolution copy, and added to that video source.
+Clients that only need a reduced resolution subscribe to the output channel of that source, which
+requires much less bandwidth (a factor of 2 reduces the volume size by 8).
+
 \ingroup PlusLibDataCollection
 */
 class vtkPlusDataCollectionExport vtkPlusPhilips3DProbeVideoSource : public vtkPlusDevice
@@ -67,14 +79,25 @@ public:
   vtkSetMacro(LatAndElevSmoothingIndex, int);
   vtkGetMacro(LatAndElevSmoothingIndex, int);
 
+  /*! Id of the video source that receives the downsampled volumes. Empty if no downsampled volumes are needed. */
+  void SetDownsampledVideoDataSourceId(const std::string& sourceId) { this->DownsampledVideoDataSourceId = sourceId; }
+  std::string GetDownsampledVideoDataSourceId() const { return this->DownsampledVideoDataSourceId; }
+
+  /*! Number of voxels along each axis that are averaged into one voxel of the downsampled volumes */
+  vtkSetMacro(DownsamplingFactor, int);
+  vtkGetMacro(DownsamplingFactor, int);
+
 protected:
   /*! Constructor */
   vtkPlusPhilips3DProbeVideoSource();
   /*! Destructor */
   virtual ~vtkPlusPhilips3DProbeVideoSource();
 
-  /*! Callback function when a new frame is ready to be added */
-  void CallbackAddFrame(vtkImageData* imageData);
+  /*! Callback function when a new volume is ready to be added. The volume data is only valid during the call. */
+  PlusStatus CallbackAddFrame(const unsigned char* volumeData, const FrameSizeType& volumeSize);
+
+  /*! Downsample a volume and add it to the downsampled video source */
+  PlusStatus AddDownsampledVolume(const unsigned char* volumeData, const FrameSizeType& volumeSize);
 
   /*! Connect to device */
   virtual PlusStatus InternalConnect();
@@ -120,6 +143,20 @@ protected:
   /*! Parameter to pass to the Philips stream manager */
   int LatAndElevSmoothingIndex;
 
+  /*! Id of the video source that receives the downsampled volumes */
+  std::string DownsampledVideoDataSourceId;
+  /*! Number of voxels along each axis that are averaged into one voxel of the downsampled volumes */
+  int DownsamplingFactor;
+
+  /*! Video source of the full resolution volumes */
+  vtkPlusDataSource* VideoSource;
+  /*! Video source of the downsampled volumes, NULL if not used */
+  vtkPlusDataSource* DownsampledVideoSource;
+  /*! Size of the streamed volumes, all zero until the first volume is received after connecting */
+  FrameSizeType StreamedVolumeSize;
+  /*! Downsampled volume, used only if it cannot be written directly into the buffer */
+  std::vector<unsigned char> DownsampledVolume;
+
 private:
   vtkPlusPhilips3DProbeVideoSource(const vtkPlusPhilips3DProbeVideoSource&);  // Not implemented.
   void operator=(const vtkPlusPhilips3DProbeVideoSource&);  // Not implemented.
@@ -0,0 +1,515 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusAcquisitionScheduler.h"
+#include "PlusMetricsRegistry.h"
+#include "PlusProfiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <list>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+  #include <windows.h>
+  #ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+    #define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+  #endif
+#else
+  #include <errno.h>
+  #include <time.h>
+#endif
+
+const int AcquisitionScheduler::NUMBER_OF_PERIOD_ERROR_SAMPLES = 1000;
+
+namespace
+{
+  // Maximum time the scheduler thread sleeps before checking for new tasks and stop requests
+  const double MAXIMUM_SLEEP_TIME_SEC = 0.1;
+
+  //----------------------------------------------------------------------------
+  double GetMonotonicTimeSec()
+  {
+#if defined(__linux__)
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+#else
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+  }
+}
+
+//----------------------------------------------------------------------------
+class AcquisitionScheduler::SchedulerThread : public std::enable_shared_from_this<AcquisitionScheduler::SchedulerThread>
+{
+public:
+  //----------------------------------------------------------------------------
+  SchedulerThread(const std::string& name)
+    : Name(name)
+    , OptionsChanged(false)
+    , Stop(false)
+  {
+  }
+
+  //----------------------------------------------------------------------------
+  void Start()
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->Thread = std::thread(&SchedulerThread::Run, this->shared_from_this());
+    this->ThreadId = this->Thread.get_id();
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Request the thread to stop if there are no more tasks. Returns true if the thread has to be joined. */
+  bool StopIfEmpty()
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    if (this->Stop)
+    {
+      return false;
+    }
+    for (std::list<Task>::iterator taskIt = this->Tasks.begin(); taskIt != this->Tasks.end(); ++taskIt)
+    {
+      if (!taskIt->Removed)
+      {
+        return false;
+      }
+    }
+    this->Stop = true;
+    this->Condition.notify_all();
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  void RequestStop()
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->Stop = true;
+    this->Condition.notify_all();
+  }
+
+  //----------------------------------------------------------------------------
+  void Join()
+  {
+    if (!this->Thread.joinable())
+    {
+      return;
+    }
+    if (this->Thread.get_id() == std::this_thread::get_id())
+    {
+      // stopped from a task function, the thread exits when the function returns
+      this->Thread.detach();
+    }
+    else
+    {
+      this->Thread.join();
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void AddTask(const void* taskId, double periodSec, const TaskFunction& function, const ThreadOptions& options)
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    if (!options.IsDefault())
+    {
+      if (this->Options.IsDefault())
+      {
+        this->Options = options;
+        this->OptionsChanged = true;
+      }
+      else if (this->Options != options)
+      {
+        LOG_WARNING("Acquisition thread " << this->Name << " is already configured with different CPU affinity and priority settings, the requested settings are ignored");
+      }
+    }
+
+    Task task;
+    task.Id = taskId;
+    task.PeriodSec = periodSec;
+    task.Function = function;
+    task.DeadlineSec = GetMonotonicTimeSec();
+    task.PeriodErrors.reserve(NUMBER_OF_PERIOD_ERROR_SAMPLES);
+    this->Tasks.push_back(task);
+    this->Condition.notify_all();
+  }
+
+  //----------------------------------------------------------------------------
+  void RemoveTask(const void* taskId)
+  {
+    std::unique_lock<std::mutex> lock(this->Mutex);
+    while (true)
+    {
+      std::list<Task>::iterator taskIt = this->FindTask(taskId);
+      if (taskIt == this->Tasks.end())
+      {
+        return;
+      }
+      if (!taskIt->Running)
+      {
+        this->Tasks.erase(taskIt);
+        this->Condition.notify_all();
+        return;
+      }
+      if (std::this_thread::get_id() == this->ThreadId)
+      {
+        // called from the task function, the task is removed when the function returns
+        taskIt->Removed = true;
+        return;
+      }
+      this->Condition.wait(lock);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus GetTaskStatistics(const void* taskId, TaskStatistics& statistics)
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    std::list<Task>::iterator taskIt = this->FindTask(taskId);
+    if (taskIt == this->Tasks.end())
+    {
+      return PLUS_FAIL;
+    }
+    statistics.NumberOfUpdates = taskIt->NumberOfUpdates;
+    statistics.NumberOfMissedDeadlines = taskIt->NumberOfMissedDeadlines;
+    statistics.PeriodErrorMedianSec = 0;
+    statistics.PeriodErrorPercentile99Sec = 0;
+    if (!taskIt->PeriodErrors.empty())
+    {
+      std::vector<double> periodErrors(taskIt->PeriodErrors);
+      std::vector<double>::iterator median = periodErrors.begin() + periodErrors.size() / 2;
+      std::nth_element(periodErrors.begin(), median, periodErrors.end());
+      statistics.PeriodErrorMedianSec = *median;
+      std::vector<double>::iterator percentile99 = periodErrors.begin() + (periodErrors.size() - 1) * 99 / 100;
+      std::nth_element(periodErrors.begin(), percentile99, periodErrors.end());
+      statistics.PeriodErrorPercentile99Sec = *percentile99;
+    }
+    return PLUS_SUCCESS;
+  }
+
+protected:
+  struct Task
+  {
+    Task() : Id(NULL), PeriodSec(0), DeadlineSec(0), LastStartSec(0), Running(false), Removed(false), NumberOfUpdates(0), NumberOfMissedDeadlines(0), NextPeriodErrorIndex(0) {}
+    const void* Id;
+    double PeriodSec;
+    TaskFunction Function;
+    /*! Absolute time of the next update (monotonic clock) */
+    double DeadlineSec;
+    double LastStartSec;
+    bool Running;
+    bool Removed;
+    unsigned long NumberOfUpdates;
+    unsigned long NumberOfMissedDeadlines;
+    /*! Circular buffer of the absolute differences between the actual and requested update periods */
+    std::vector<double> PeriodErrors;
+    size_t NextPeriodErrorIndex;
+  };
+
+  //----------------------------------------------------------------------------
+  std::list<Task>::iterator FindTask(const void* taskId)
+  {
+    for (std::list<Task>::iterator taskIt = this->Tasks.begin(); taskIt != this->Tasks.end(); ++taskIt)
+    {
+      if (taskIt->Id == taskId)
+      {
+        return taskIt;
+      }
+    }
+    return this->Tasks.end();
+  }
+
+  //----------------------------------------------------------------------------
+  void Run()
+  {
+#if defined(_WIN32)
+    HANDLE timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (timer == NULL)
+    {
+      // high-resolution timers are available since Windows 10 version 1803
+      timer = CreateWaitableTimer(NULL, TRUE, NULL);
+    }
+#endif
+
+    std::shared_ptr<MetricsRegistry::Metric> cpuTimeMetric = MetricsRegistry::GetInstance().GetThreadCpuTimeMetric(this->Name);
+    PLUS_PROFILE_THREAD_NAME(this->Name);
+
+    std::unique_lock<std::mutex> lock(this->Mutex);
+    while (!this->Stop)
+    {
+      if (this->OptionsChanged)
+      {
+        this->OptionsChanged = false;
+        ThreadOptions options = this->Options;
+        lock.unlock();
+        options.ApplyToCurrentThread("acquisition " + this->Name);
+        lock.lock();
+        continue;
+      }
+
+      if (this->Tasks.empty())
+      {
+        this->Condition.wait(lock);
+        continue;
+      }
+
+      std::list<Task>::iterator nextTask = this->Tasks.begin();
+      for (std::list<Task>::iterator taskIt = this->Tasks.begin(); taskIt != this->Tasks.end(); ++taskIt)
+      {
+        if (taskIt->DeadlineSec < nextTask->DeadlineSec)
+        {
+          nextTask = taskIt;
+        }
+      }
+
+      double now = GetMonotonicTimeSec();
+      if (nextTask->DeadlineSec > now)
+      {
+        double wakeUpTimeSec = std::min(nextTask->DeadlineSec, now + MAXIMUM_SLEEP_TIME_SEC);
+        lock.unlock();
+#if defined(_WIN32)
+        SleepUntil(wakeUpTimeSec, timer);
+#else
+        SleepUntil(wakeUpTimeSec);
+#endif
+        lock.lock();
+        continue;
+      }
+
+      // The task is not removed while it is running, so the iterator remains valid
+      nextTask->Running = true;
+      lock.unlock();
+      double startTimeSec = GetMonotonicTimeSec();
+      bool continueTask = nextTask->Function();
+      cpuTimeMetric->Set(MetricsRegistry::GetCurrentThreadCpuTimeSec());
+      lock.lock();
+      nextTask->Running = false;
+
+      this->UpdateTaskTiming(*nextTask, startTimeSec);
+      if (!continueTask || nextTask->Removed)
+      {
+        this->Tasks.erase(nextTask);
+      }
+      this->Condition.notify_all();
+    }
+    lock.unlock();
+    MetricsRegistry::GetInstance().RemoveMetrics("thread", this->Name);
+
+#if defined(_WIN32)
+    if (timer != NULL)
+    {
+      CloseHandle(timer);
+    }
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  void UpdateTaskTiming(Task& task, double startTimeSec)
+  {
+    if (task.NumberOfUpdates > 0)
+    {
+      double periodErrorSec = std::fabs(startTimeSec - task.LastStartSec - task.PeriodSec);
+      if (task.PeriodErrors.size() < static_cast<size_t>(NUMBER_OF_PERIOD_ERROR_SAMPLES))
+      {
+        task.PeriodErrors.push_back(periodErrorSec);
+      }
+      else
+      {
+        task.PeriodErrors[task.NextPeriodErrorIndex] = periodErrorSec;
+      }
+      task.NextPeriodErrorIndex = (task.NextPeriodErrorIndex + 1) % NUMBER_OF_PERIOD_ERROR_SAMPLES;
+    }
+    task.LastStartSec = startTimeSec;
+    task.NumberOfUpdates++;
+
+    // Next deadline is computed from the previous deadline, not from the current time, to avoid drifting
+    task.DeadlineSec += task.PeriodSec;
+    double now = GetMonotonicTimeSec();
+    if (task.DeadlineSec < now)
+    {
+      // Skip the missed deadlines
+      unsigned long missedDeadlines = static_cast<unsigned long>((now - task.DeadlineSec) / task.PeriodSec) + 1;
+      task.DeadlineSec += missedDeadlines * task.PeriodSec;
+      task.NumberOfMissedDeadlines += missedDeadlines;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+#if defined(_WIN32)
+  static void SleepUntil(double wakeUpTimeSec, HANDLE timer)
+  {
+    double sleepTimeSec = wakeUpTimeSec - GetMonotonicTimeSec();
+    if (sleepTimeSec <= 0)
+    {
+      return;
+    }
+    // Waitable timers use 100ns units, negative value means relative time
+    LARGE_INTEGER dueTime;
+    dueTime.QuadPart = -static_cast<LONGLONG>(sleepTimeSec * 1e7);
+    if (timer != NULL && SetWaitableTimer(timer, &dueTime, 0, NULL, NULL, FALSE))
+    {
+      WaitForSingleObject(timer, INFINITE);
+    }
+    else
+    {
+      std::this_thread::sleep_for(std::chrono::duration<double>(sleepTimeSec));
+    }
+  }
+#else
+  static void SleepUntil(double wakeUpTimeSec)
+  {
+#if defined(__linux__)
+    timespec wakeUpTime;
+    wakeUpTime.tv_sec = static_cast<time_t>(std::floor(wakeUpTimeSec));
+    wakeUpTime.tv_nsec = static_cast<long>((wakeUpTimeSec - std::floor(wakeUpTimeSec)) * 1e9);
+    if (wakeUpTime.tv_nsec >= 1000000000L)
+    {
+      wakeUpTime.tv_sec++;
+      wakeUpTime.tv_nsec -= 1000000000L;
+    }
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeUpTime, NULL) == EINTR)
+    {
+      // interrupted by a signal, continue sleeping
+    }
+#else
+    double sleepTimeSec = wakeUpTimeSec - GetMonotonicTimeSec();
+    if (sleepTimeSec > 0)
+    {
+      std::this_thread::sleep_for(std::chrono::duration<double>(sleepTimeSec));
+    }
+#endif
+  }
+#endif
+
+  std::string Name;
+  std::thread Thread;
+  std::thread::id ThreadId;
+
+  /*! Protects all the members below. Notified when tasks are added, removed, or completed an update. */
+  std::mutex Mutex;
+  std::condition_variable Condition;
+  std::list<Task> Tasks;
+  ThreadOptions Options;
+  bool OptionsChanged;
+  bool Stop;
+};
+
+//----------------------------------------------------------------------------
+AcquisitionScheduler& AcquisitionScheduler::GetInstance()
+{
+  static AcquisitionScheduler instance;
+  return instance;
+}
+
+//----------------------------------------------------------------------------
+AcquisitionScheduler::AcquisitionScheduler()
+{
+}
+
+//----------------------------------------------------------------------------
+AcquisitionScheduler::~AcquisitionScheduler()
+{
+  std::map<std::string, std::shared_ptr<SchedulerThread> > threads;
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    threads.swap(this->Threads);
+    this->TaskThreads.clear();
+  }
+  for (std::map<std::string, std::shared_ptr<SchedulerThread> >::iterator threadIt = threads.begin(); threadIt != threads.end(); ++threadIt)
+  {
+    threadIt->second->RequestStop();
+    threadIt->second->Join();
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus AcquisitionScheduler::AddTask(const void* taskId, const std::string& threadName, double periodSec, const TaskFunction& function, const ThreadOptions& options /*= ThreadOptions()*/)
+{
+  if (periodSec <= 0 || !function)
+  {
+    LOG_ERROR("Invalid acquisition task for thread " << threadName << " (period: " << periodSec << " sec)");
+    return PLUS_FAIL;
+  }
+
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  if (this->TaskThreads.find(taskId) != this->TaskThreads.end())
+  {
+    // Not an error by itself, the caller reports the failure
+    LOG_DEBUG("Acquisition task is already scheduled");
+    return PLUS_FAIL;
+  }
+
+  std::shared_ptr<SchedulerThread>& thread = this->Threads[threadName];
+  if (!thread)
+  {
+    LOG_DEBUG("Start acquisition thread " << threadName);
+    thread = std::make_shared<SchedulerThread>(threadName);
+    thread->Start();
+  }
+  thread->AddTask(taskId, periodSec, function, options);
+  this->TaskThreads[taskId] = thread;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void AcquisitionScheduler::RemoveTask(const void* taskId)
+{
+  std::shared_ptr<SchedulerThread> thread;
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    std::map<const void*, std::shared_ptr<SchedulerThread> >::iterator taskThreadIt = this->TaskThreads.find(taskId);
+    if (taskThreadIt == this->TaskThreads.end())
+    {
+      return;
+    }
+    thread = taskThreadIt->second;
+    this->TaskThreads.erase(taskThreadIt);
+  }
+
+  // The scheduler mutex is not locked while waiting for the completion of the update, so the task function may use the scheduler
+  thread->RemoveTask(taskId);
+
+  bool joinThread = false;
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    if (thread->StopIfEmpty())
+    {
+      joinThread = true;
+      for (std::map<std::string, std::shared_ptr<SchedulerThread> >::iterator threadIt = this->Threads.begin(); threadIt != this->Threads.end(); ++threadIt)
+      {
+        if (threadIt->second == thread)
+        {
+          this->Threads.erase(threadIt);
+          break;
+        }
+      }
+    }
+  }
+  if (joinThread)
+  {
+    thread->Join();
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus AcquisitionScheduler::GetTaskStatistics(const void* taskId, TaskStatistics& statistics)
+{
+  std::shared_ptr<SchedulerThread> thread;
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    std::map<const void*, std::shared_ptr<SchedulerThread> >::iterator taskThreadIt = this->TaskThreads.find(taskId);
+    if (taskThreadIt == this->TaskThreads.end())
+    {
+      return PLUS_FAIL;
+    }
+    thread = taskThreadIt->second;
+  }
+  return thread->GetTaskStatistics(taskId, statistics);
+}
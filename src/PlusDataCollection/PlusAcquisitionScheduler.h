@@ -0,0 +1,98 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __AcquisitionScheduler_h
+#define __AcquisitionScheduler_h
+
+#include "vtkPlusDataCollectionExport.h"
+
+#include "PlusConfigure.h"
+#include "PlusThreadSettings.h"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/*!
+  \class AcquisitionScheduler
+  \brief Runs periodic acquisition tasks (internal updates of devices) on shared scheduler threads.
+
+  Deadlines are absolute (start time + k * period), so the update times do not drift and the time spent
+  in the update does not delay the next update. Threads sleep until the next deadline using absolute
+  timers (clock_nanosleep with TIMER_ABSTIME on Linux, high-resolution waitable timer on Windows).
+  If an update takes longer than the period then the missed deadlines are skipped instead of running
+  the update repeatedly to catch up.
+
+  Tasks that are added with the same thread name are run by the same thread, so one thread can serve
+  multiple devices. The thread can be pinned to CPUs and can run with high or real-time priority (see PlusThreadSettings).
+
+  For each task the absolute difference between the actual and the requested update period is recorded
+  (for the last NUMBER_OF_PERIOD_ERROR_SAMPLES updates), its median and 99th percentile can be queried.
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport AcquisitionScheduler
+{
+public:
+  /*! Task function. Return false to stop running the task. */
+  typedef std::function<bool()> TaskFunction;
+
+  /*! Priority, CPU affinity and memory locking settings of a scheduler thread */
+  typedef PlusThreadSettings ThreadOptions;
+
+  /*! Timing statistics of a task */
+  struct TaskStatistics
+  {
+    TaskStatistics() : NumberOfUpdates(0), NumberOfMissedDeadlines(0), PeriodErrorMedianSec(0), PeriodErrorPercentile99Sec(0) {}
+    unsigned long NumberOfUpdates;
+    unsigned long NumberOfMissedDeadlines;
+    double PeriodErrorMedianSec;
+    double PeriodErrorPercentile99Sec;
+  };
+
+  /*! Number of the most recent updates that are used for computing the period error statistics */
+  static const int NUMBER_OF_PERIOD_ERROR_SAMPLES;
+
+  static AcquisitionScheduler& GetInstance();
+
+  /*!
+    Start running a task periodically. The first update is run immediately.
+    \param taskId Unique identifier of the task (typically the pointer of the device)
+    \param threadName Tasks with the same thread name are run by the same thread
+    \param periodSec Time between updates
+    \param options Options of the thread. Ignored (with a warning) if the thread is already running with different options.
+    Returns PLUS_FAIL without logging an error if the task is already scheduled, the caller reports the failure.
+  */
+  PlusStatus AddTask(const void* taskId, const std::string& threadName, double periodSec, const TaskFunction& function, const ThreadOptions& options = ThreadOptions());
+
+  /*!
+    Stop running a task. If the task is being updated then it waits until the update is completed
+    (except if it is called from the task function). When the last task of a thread is removed then the thread is stopped.
+  */
+  void RemoveTask(const void* taskId);
+
+  /*! Get timing statistics of a task. Returns PLUS_FAIL if the task is not found. */
+  PlusStatus GetTaskStatistics(const void* taskId, TaskStatistics& statistics);
+
+protected:
+  AcquisitionScheduler();
+  virtual ~AcquisitionScheduler();
+
+  class SchedulerThread;
+
+  /*! Protects Threads and TaskThreads. Lock it before the mutex of a scheduler thread. */
+  std::mutex Mutex;
+  std::map<std::string, std::shared_ptr<SchedulerThread> > Threads;
+  std::map<const void*, std::shared_ptr<SchedulerThread> > TaskThreads;
+
+private:
+  AcquisitionScheduler(const AcquisitionScheduler&);
+  void operator=(const AcquisitionScheduler&);
+};
+
+#endif
@@ -0,0 +1,181 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusCompressedFrameRing.h"
+#include "PlusParallelDeflate.h"
+
+// IGSIO includes
+#include <igsioTrackedFrame.h>
+#include <igsioVideoFrame.h>
+#include <vtkIGSIOTrackedFrameList.h>
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtk_zlib.h>
+
+// STL includes
+#include <sstream>
+
+namespace
+{
+  /*! Images are kept in memory only briefly, so compression speed matters more than the compression ratio */
+  const int RING_COMPRESSION_LEVEL = 1;
+
+  /*! Estimated memory use of a frame in addition to the compressed pixels (fields, bookkeeping) */
+  const size_t FRAME_OVERHEAD_BYTES = 256;
+}
+
+//----------------------------------------------------------------------------
+CompressedFrameRing::CompressedFrameRing()
+  : DurationSec(0.0)
+  , MaximumSizeBytes(512 * 1024 * 1024)
+  , NumberOfThreads(0)
+  , SizeBytes(0)
+  , SizeLimitReached(false)
+{
+}
+
+//----------------------------------------------------------------------------
+CompressedFrameRing::~CompressedFrameRing()
+{
+}
+
+//----------------------------------------------------------------------------
+PlusStatus CompressedFrameRing::AddFrame(igsioTrackedFrame& frame)
+{
+  CompressedFrame compressedFrame;
+  compressedFrame.Timestamp = frame.GetTimestamp();
+  compressedFrame.Fields = frame.GetCustomFields();
+  compressedFrame.SizeBytes = FRAME_OVERHEAD_BYTES;
+  for (igsioFieldMapType::const_iterator fieldIt = compressedFrame.Fields.begin(); fieldIt != compressedFrame.Fields.end(); ++fieldIt)
+  {
+    compressedFrame.SizeBytes += fieldIt->first.size() + fieldIt->second.second.size();
+  }
+
+  igsioVideoFrame* videoFrame = frame.GetImageData();
+  compressedFrame.ImageValid = videoFrame->IsImageValid();
+  compressedFrame.PixelDataSizeBytes = 0;
+  if (compressedFrame.ImageValid)
+  {
+    vtkImageData* image = videoFrame->GetImage();
+    compressedFrame.FrameSize = videoFrame->GetFrameSize();
+    compressedFrame.PixelType = image->GetScalarType();
+    compressedFrame.NumberOfScalarComponents = static_cast<unsigned int>(image->GetNumberOfScalarComponents());
+    compressedFrame.ImageType = videoFrame->GetImageType();
+    compressedFrame.ImageOrientation = videoFrame->GetImageOrientation();
+    compressedFrame.PixelDataSizeBytes = videoFrame->GetFrameSizeInBytes();
+
+    std::ostringstream compressedPixels;
+    PlusParallelDeflate deflate;
+    deflate.SetCompressionLevel(RING_COMPRESSION_LEVEL);
+    deflate.SetNumberOfThreads(this->NumberOfThreads);
+    if (deflate.Start(compressedPixels, PlusParallelDeflate::FORMAT_ZLIB) != PLUS_SUCCESS
+        || deflate.Write(static_cast<const unsigned char*>(videoFrame->GetScalarPointer()), compressedFrame.PixelDataSizeBytes) != PLUS_SUCCESS
+        || deflate.Finish() != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to compress frame image for the frame ring, frame timestamp: " << std::fixed << compressedFrame.Timestamp);
+      return PLUS_FAIL;
+    }
+    compressedFrame.CompressedPixels = compressedPixels.str();
+    compressedFrame.SizeBytes += compressedFrame.CompressedPixels.size();
+  }
+
+  this->SizeBytes += compressedFrame.SizeBytes;
+  this->Frames.push_back(compressedFrame);
+  this->RemoveOldFrames();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void CompressedFrameRing::RemoveOldFrames()
+{
+  const double latestTimestamp = this->Frames.empty() ? 0.0 : this->Frames.back().Timestamp;
+  while (this->Frames.size() > 1 && latestTimestamp - this->Frames.front().Timestamp > this->DurationSec)
+  {
+    this->SizeBytes -= this->Frames.front().SizeBytes;
+    this->Frames.pop_front();
+  }
+  while (this->Frames.size() > 1 && this->SizeBytes > this->MaximumSizeBytes)
+  {
+    if (!this->SizeLimitReached)
+    {
+      LOG_WARNING("Frame ring reached its memory limit (" << this->MaximumSizeBytes / (1024 * 1024) << " MB), it keeps only "
+                  << latestTimestamp - this->Frames.front().Timestamp << " seconds of frames instead of " << this->DurationSec);
+      this->SizeLimitReached = true;
+    }
+    this->SizeBytes -= this->Frames.front().SizeBytes;
+    this->Frames.pop_front();
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus CompressedFrameRing::MoveFrames(vtkIGSIOTrackedFrameList* frameList)
+{
+  if (frameList == NULL)
+  {
+    LOG_ERROR("CompressedFrameRing::MoveFrames: invalid frame list");
+    return PLUS_FAIL;
+  }
+
+  PlusStatus status = PLUS_SUCCESS;
+  for (std::deque<CompressedFrame>::iterator frameIt = this->Frames.begin(); frameIt != this->Frames.end(); ++frameIt)
+  {
+    igsioTrackedFrame* frame = new igsioTrackedFrame;
+    for (igsioFieldMapType::const_iterator fieldIt = frameIt->Fields.begin(); fieldIt != frameIt->Fields.end(); ++fieldIt)
+    {
+      frame->SetFrameField(fieldIt->first, fieldIt->second.second, fieldIt->second.first);
+    }
+    frame->SetTimestamp(frameIt->Timestamp);
+
+    if (frameIt->ImageValid)
+    {
+      igsioVideoFrame* videoFrame = frame->GetImageData();
+      uLongf uncompressedSize = static_cast<uLongf>(frameIt->PixelDataSizeBytes);
+      if (videoFrame->AllocateFrame(frameIt->FrameSize, frameIt->PixelType, frameIt->NumberOfScalarComponents) != PLUS_SUCCESS
+          || uncompress(static_cast<Bytef*>(videoFrame->GetScalarPointer()), &uncompressedSize,
+                        reinterpret_cast<const Bytef*>(frameIt->CompressedPixels.data()), static_cast<uLong>(frameIt->CompressedPixels.size())) != Z_OK
+          || uncompressedSize != frameIt->PixelDataSizeBytes)
+      {
+        LOG_ERROR("Failed to decompress frame image from the frame ring, frame timestamp: " << std::fixed << frameIt->Timestamp);
+        delete frame;
+        status = PLUS_FAIL;
+        continue;
+      }
+      videoFrame->SetImageType(frameIt->ImageType);
+      videoFrame->SetImageOrientation(frameIt->ImageOrientation);
+    }
+
+    if (frameList->TakeTrackedFrame(frame, vtkIGSIOTrackedFrameList::SKIP_INVALID_FRAME) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("CompressedFrameRing::MoveFrames: unable to add frame to the list, frame timestamp: " << std::fixed << frameIt->Timestamp);
+      status = PLUS_FAIL;
+    }
+  }
+
+  this->Clear();
+  return status;
+}
+
+//----------------------------------------------------------------------------
+void CompressedFrameRing::Clear()
+{
+  this->Frames.clear();
+  this->SizeBytes = 0;
+  this->SizeLimitReached = false;
+}
+
+//----------------------------------------------------------------------------
+double CompressedFrameRing::GetOldestTimestamp() const
+{
+  return this->Frames.empty() ? UNDEFINED_TIMESTAMP : this->Frames.front().Timestamp;
+}
+
+//----------------------------------------------------------------------------
+double CompressedFrameRing::GetLatestTimestamp() const
+{
+  return this->Frames.empty() ? UNDEFINED_TIMESTAMP : this->Frames.back().Timestamp;
+}
@@ -0,0 +1,104 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusCompressedFrameRing_h
+#define __PlusCompressedFrameRing_h
+
+#include "vtkPlusDataCollectionExport.h"
+
+// IGSIO includes
+#include <igsioCommon.h>
+
+#include <deque>
+#include <string>
+
+class igsioTrackedFrame;
+class vtkIGSIOTrackedFrameList;
+
+/*!
+  \class CompressedFrameRing
+  \brief Keeps the most recent tracked frames in memory, with zlib compressed images.
+
+  Frames are added as they are acquired and the oldest frames are dropped when the time span of the stored frames
+  exceeds DurationSec or their total (compressed) size exceeds MaximumSizeBytes, so the memory use is bounded.
+  Images are compressed by the fastest zlib level on multiple threads (see PlusParallelDeflate), frame fields
+  (including transforms) are stored as they are. MoveFrames decompresses all the stored frames into a frame list.
+
+  The ring is not thread safe, the owner has to synchronize the access.
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport CompressedFrameRing
+{
+public:
+  CompressedFrameRing();
+  virtual ~CompressedFrameRing();
+
+  /*! Maximum time span of the stored frames, in seconds */
+  void SetDurationSec(double durationSec) { this->DurationSec = durationSec; }
+  double GetDurationSec() const { return this->DurationSec; }
+
+  /*! Maximum total size of the stored frames, in bytes */
+  void SetMaximumSizeBytes(size_t maximumSizeBytes) { this->MaximumSizeBytes = maximumSizeBytes; }
+  size_t GetMaximumSizeBytes() const { return this->MaximumSizeBytes; }
+
+  /*! Number of threads that compress the images. If 0 then the number of processors is used. */
+  void SetNumberOfThreads(int numberOfThreads) { this->NumberOfThreads = numberOfThreads; }
+  int GetNumberOfThreads() const { return this->NumberOfThreads; }
+
+  /*! Compress and store the frame, then drop the oldest frames that do not fit in the ring */
+  PlusStatus AddFrame(igsioTrackedFrame& frame);
+
+  /*! Decompress all the stored frames, append them to the frame list (oldest first), and remove them from the ring */
+  PlusStatus MoveFrames(vtkIGSIOTrackedFrameList* frameList);
+
+  /*! Remove all the stored frames */
+  void Clear();
+
+  int GetNumberOfFrames() const { return static_cast<int>(this->Frames.size()); }
+
+  /*! Total size of the stored frames, in bytes */
+  size_t GetSizeBytes() const { return this->SizeBytes; }
+
+  /*! Timestamp of the oldest and the most recent stored frame, UNDEFINED_TIMESTAMP if the ring is empty */
+  double GetOldestTimestamp() const;
+  double GetLatestTimestamp() const;
+
+protected:
+  struct CompressedFrame
+  {
+    double Timestamp;
+    igsioFieldMapType Fields;
+    bool ImageValid;
+    FrameSizeType FrameSize;
+    igsioCommon::VTKScalarPixelType PixelType;
+    unsigned int NumberOfScalarComponents;
+    US_IMAGE_TYPE ImageType;
+    US_IMAGE_ORIENTATION ImageOrientation;
+    /*! zlib stream of the pixel data */
+    std::string CompressedPixels;
+    size_t PixelDataSizeBytes;
+    size_t SizeBytes;
+  };
+
+  /*! Drop the oldest frames until the stored frames fit in the duration and the size limit */
+  void RemoveOldFrames();
+
+  double DurationSec;
+  size_t MaximumSizeBytes;
+  int NumberOfThreads;
+
+  std::deque<CompressedFrame> Frames;
+  size_t SizeBytes;
+  /*! Set when the size limit made frames drop, to log it only once until the ring is cleared */
+  bool SizeLimitReached;
+
+private:
+  CompressedFrameRing(const CompressedFrameRing&);
+  void operator=(const CompressedFrameRing&);
+};
+
+#endif
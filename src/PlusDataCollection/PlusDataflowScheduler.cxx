@@ -0,0 +1,296 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusDataflowScheduler.h"
+#include "PlusProfiler.h"
+
+#include <algorithm>
+
+namespace
+{
+  const unsigned int MINIMUM_NUMBER_OF_WORKERS = 2;
+  const unsigned int MAXIMUM_NUMBER_OF_WORKERS = 8;
+
+  //----------------------------------------------------------------------------
+  void JoinWorkers(std::vector<std::thread>& workers)
+  {
+    for (std::vector<std::thread>::iterator workerIt = workers.begin(); workerIt != workers.end(); ++workerIt)
+    {
+      if (!workerIt->joinable())
+      {
+        continue;
+      }
+      if (workerIt->get_id() == std::this_thread::get_id())
+      {
+        // stopped from a task function, the thread exits when the function returns
+        workerIt->detach();
+      }
+      else
+      {
+        workerIt->join();
+      }
+    }
+    workers.clear();
+  }
+}
+
+//----------------------------------------------------------------------------
+DataflowScheduler& DataflowScheduler::GetInstance()
+{
+  static DataflowScheduler instance;
+  return instance;
+}
+
+//----------------------------------------------------------------------------
+DataflowScheduler::DataflowScheduler()
+  : TriggerTasks(std::make_shared<TriggerTaskMap>())
+  , StopWorkersFlag(std::make_shared<bool>(false))
+  , NumberOfTasks(0)
+{
+}
+
+//----------------------------------------------------------------------------
+DataflowScheduler::~DataflowScheduler()
+{
+  std::vector<std::thread> workers;
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    workers = this->StopWorkers();
+    this->Tasks.clear();
+    std::atomic_store(&this->TriggerTasks, std::shared_ptr<const TriggerTaskMap>(std::make_shared<TriggerTaskMap>()));
+    this->Queue.clear();
+    this->NumberOfTasks = 0;
+  }
+  JoinWorkers(workers);
+}
+
+//----------------------------------------------------------------------------
+int DataflowScheduler::GetNumberOfWorkers() const
+{
+  unsigned int numberOfCores = std::thread::hardware_concurrency();
+  return static_cast<int>(std::max(MINIMUM_NUMBER_OF_WORKERS, std::min(MAXIMUM_NUMBER_OF_WORKERS, numberOfCores)));
+}
+
+//----------------------------------------------------------------------------
+PlusStatus DataflowScheduler::AddTask(const void* taskId, const std::vector<const void*>& triggerIds, const TaskFunction& function)
+{
+  if (!function || triggerIds.empty())
+  {
+    LOG_ERROR("Invalid dataflow task (number of trigger sources: " << triggerIds.size() << ")");
+    return PLUS_FAIL;
+  }
+
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  if (this->Tasks.find(taskId) != this->Tasks.end())
+  {
+    LOG_ERROR("Dataflow task is already scheduled");
+    return PLUS_FAIL;
+  }
+
+  std::shared_ptr<Task> task = std::make_shared<Task>();
+  task->Id = taskId;
+  task->Function = function;
+  task->TriggerIds = triggerIds;
+  std::sort(task->TriggerIds.begin(), task->TriggerIds.end());
+  task->TriggerIds.erase(std::unique(task->TriggerIds.begin(), task->TriggerIds.end()), task->TriggerIds.end());
+  std::shared_ptr<TriggerTaskMap> triggerTasks = std::make_shared<TriggerTaskMap>(*this->TriggerTasks);
+  for (std::vector<const void*>::iterator triggerIt = task->TriggerIds.begin(); triggerIt != task->TriggerIds.end(); ++triggerIt)
+  {
+    triggerTasks->insert(std::make_pair(*triggerIt, task));
+  }
+  std::atomic_store(&this->TriggerTasks, std::shared_ptr<const TriggerTaskMap>(triggerTasks));
+  this->Tasks[taskId] = task;
+  this->NumberOfTasks = static_cast<int>(this->Tasks.size());
+
+  if (this->Workers.empty())
+  {
+    int numberOfWorkers = this->GetNumberOfWorkers();
+    LOG_DEBUG("Start " << numberOfWorkers << " dataflow worker threads");
+    for (int i = 0; i < numberOfWorkers; ++i)
+    {
+      this->Workers.push_back(std::thread(&DataflowScheduler::RunWorker, this, this->StopWorkersFlag));
+    }
+  }
+
+  // Process the data that is already available
+  task->Queued = true;
+  this->Queue.push_back(task);
+  this->Condition.notify_all();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void DataflowScheduler::RemoveTask(const void* taskId)
+{
+  std::vector<std::thread> workers;
+  {
+    std::unique_lock<std::mutex> lock(this->Mutex);
+    std::map<const void*, std::shared_ptr<Task> >::iterator taskIt = this->Tasks.find(taskId);
+    if (taskIt == this->Tasks.end())
+    {
+      return;
+    }
+    std::shared_ptr<Task> task = taskIt->second;
+    this->EraseTask(task);
+
+    // Queued entries of removed tasks are skipped by the workers
+    while (task->Running && task->RunningThreadId != std::this_thread::get_id())
+    {
+      this->Condition.wait(lock);
+    }
+
+    if (this->Tasks.empty())
+    {
+      workers = this->StopWorkers();
+    }
+  }
+  JoinWorkers(workers);
+}
+
+//----------------------------------------------------------------------------
+void DataflowScheduler::NotifyNewData(const void* triggerId)
+{
+  if (this->NumberOfTasks == 0)
+  {
+    return;
+  }
+
+  // The map is looked up without locking, the mutex is only locked if the source triggers tasks
+  std::shared_ptr<const TriggerTaskMap> triggerTasks = std::atomic_load(&this->TriggerTasks);
+  std::pair<TriggerTaskMap::const_iterator, TriggerTaskMap::const_iterator> triggeredTasks = triggerTasks->equal_range(triggerId);
+  if (triggeredTasks.first == triggeredTasks.second)
+  {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  bool taskQueued = false;
+  for (TriggerTaskMap::const_iterator taskIt = triggeredTasks.first; taskIt != triggeredTasks.second; ++taskIt)
+  {
+    Task& task = *taskIt->second;
+    if (task.Removed)
+    {
+      // removed since the map was loaded
+      continue;
+    }
+    task.NumberOfNotifications++;
+    if (task.Running)
+    {
+      // queued again when the current update is completed
+      task.Pending = true;
+    }
+    else if (!task.Queued)
+    {
+      task.Queued = true;
+      this->Queue.push_back(taskIt->second);
+      taskQueued = true;
+    }
+  }
+  if (taskQueued)
+  {
+    this->Condition.notify_all();
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus DataflowScheduler::GetTaskStatistics(const void* taskId, TaskStatistics& statistics)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  std::map<const void*, std::shared_ptr<Task> >::iterator taskIt = this->Tasks.find(taskId);
+  if (taskIt == this->Tasks.end())
+  {
+    return PLUS_FAIL;
+  }
+  statistics.NumberOfUpdates = taskIt->second->NumberOfUpdates;
+  statistics.NumberOfNotifications = taskIt->second->NumberOfNotifications;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void DataflowScheduler::RunWorker(std::shared_ptr<bool> stop)
+{
+  PLUS_PROFILE_THREAD_NAME("DataflowWorker");
+  std::unique_lock<std::mutex> lock(this->Mutex);
+  while (!*stop)
+  {
+    if (this->Queue.empty())
+    {
+      this->Condition.wait(lock);
+      continue;
+    }
+
+    std::shared_ptr<Task> task = this->Queue.front();
+    this->Queue.pop_front();
+    task->Queued = false;
+    if (task->Removed)
+    {
+      continue;
+    }
+
+    task->Running = true;
+    task->Pending = false;
+    task->RunningThreadId = std::this_thread::get_id();
+    lock.unlock();
+    bool continueTask = task->Function();
+    lock.lock();
+    task->Running = false;
+    task->RunningThreadId = std::thread::id();
+    task->NumberOfUpdates++;
+
+    if (!continueTask && !task->Removed)
+    {
+      this->EraseTask(task);
+      if (this->Tasks.empty())
+      {
+        std::vector<std::thread> workers = this->StopWorkers();
+        lock.unlock();
+        JoinWorkers(workers);
+        lock.lock();
+      }
+    }
+    else if (task->Pending && !task->Removed)
+    {
+      task->Queued = true;
+      this->Queue.push_back(task);
+    }
+    this->Condition.notify_all();
+  }
+}
+
+//----------------------------------------------------------------------------
+void DataflowScheduler::EraseTask(const std::shared_ptr<Task>& task)
+{
+  task->Removed = true;
+  std::shared_ptr<TriggerTaskMap> triggerTasks = std::make_shared<TriggerTaskMap>(*this->TriggerTasks);
+  for (std::vector<const void*>::iterator triggerIt = task->TriggerIds.begin(); triggerIt != task->TriggerIds.end(); ++triggerIt)
+  {
+    std::pair<TriggerTaskMap::iterator, TriggerTaskMap::iterator> triggeredTasks = triggerTasks->equal_range(*triggerIt);
+    for (TriggerTaskMap::iterator taskIt = triggeredTasks.first; taskIt != triggeredTasks.second; ++taskIt)
+    {
+      if (taskIt->second == task)
+      {
+        triggerTasks->erase(taskIt);
+        break;
+      }
+    }
+  }
+  std::atomic_store(&this->TriggerTasks, std::shared_ptr<const TriggerTaskMap>(triggerTasks));
+  this->Tasks.erase(task->Id);
+  this->NumberOfTasks = static_cast<int>(this->Tasks.size());
+}
+
+//----------------------------------------------------------------------------
+std::vector<std::thread> DataflowScheduler::StopWorkers()
+{
+  *this->StopWorkersFlag = true;
+  this->StopWorkersFlag = std::make_shared<bool>(false);
+  std::vector<std::thread> workers;
+  workers.swap(this->Workers);
+  this->Queue.clear();
+  this->Condition.notify_all();
+  return workers;
+}
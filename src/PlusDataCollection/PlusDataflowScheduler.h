@@ -0,0 +1,133 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __DataflowScheduler_h
+#define __DataflowScheduler_h
+
+#include "vtkPlusDataCollectionExport.h"
+
+#include "PlusConfigure.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*!
+  \class DataflowScheduler
+  \brief Runs acquisition tasks (internal updates of virtual devices) on a shared worker pool when new input data arrives.
+
+  Instead of polling the inputs at a fixed rate, a task is run each time a new item is added to one of its
+  trigger sources (the data sources of the input channels of the device). Therefore the latency through a chain
+  of virtual devices is determined by the processing time and not by the sum of the polling periods.
+
+  A task is never run by multiple workers at the same time. Notifications that arrive while the task is queued
+  are merged, notifications that arrive while the task is running make the task run once more when it is completed.
+
+  The worker threads are started when the first task is added and stopped when the last task is removed.
+
+  Sources look up their triggered tasks in an immutable map that is replaced when tasks are added or removed, so
+  attaching a consumer at runtime (e.g., a capture device added by a command) does not make the sources of other
+  channels lock the scheduler, and sources without triggered tasks never lock it.
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport DataflowScheduler
+{
+public:
+  /*! Task function. Return false to stop running the task. */
+  typedef std::function<bool()> TaskFunction;
+
+  /*! Statistics of a task */
+  struct TaskStatistics
+  {
+    TaskStatistics() : NumberOfUpdates(0), NumberOfNotifications(0) {}
+    unsigned long NumberOfUpdates;
+    unsigned long NumberOfNotifications;
+  };
+
+  static DataflowScheduler& GetInstance();
+
+  /*!
+    Start running a task each time new data is available in any of the trigger sources. The first update is run immediately.
+    \param taskId Unique identifier of the task (typically the pointer of the device)
+    \param triggerIds Identifiers of the sources that trigger the task (typically pointers of data sources)
+  */
+  PlusStatus AddTask(const void* taskId, const std::vector<const void*>& triggerIds, const TaskFunction& function);
+
+  /*!
+    Stop running a task. If the task is being updated then it waits until the update is completed
+    (except if it is called from the task function).
+  */
+  void RemoveTask(const void* taskId);
+
+  /*! Schedule the tasks that are triggered by the source. Does not lock anything if there are no tasks. */
+  void NotifyNewData(const void* triggerId);
+
+  /*! Get statistics of a task. Returns PLUS_FAIL if the task is not found. */
+  PlusStatus GetTaskStatistics(const void* taskId, TaskStatistics& statistics);
+
+  /*! Get the number of worker threads that are used when tasks are scheduled */
+  int GetNumberOfWorkers() const;
+
+protected:
+  DataflowScheduler();
+  virtual ~DataflowScheduler();
+
+  struct Task
+  {
+    Task() : Id(NULL), Queued(false), Running(false), Pending(false), Removed(false), NumberOfUpdates(0), NumberOfNotifications(0) {}
+    const void* Id;
+    TaskFunction Function;
+    std::vector<const void*> TriggerIds;
+    /*! The task is in the queue */
+    bool Queued;
+    /*! The task function is being executed */
+    bool Running;
+    /*! New data arrived while the task was running */
+    bool Pending;
+    bool Removed;
+    std::thread::id RunningThreadId;
+    unsigned long NumberOfUpdates;
+    unsigned long NumberOfNotifications;
+  };
+
+  /*! Worker thread function. Exits when the stop flag of its pool is set. */
+  void RunWorker(std::shared_ptr<bool> stop);
+
+  /*! Remove the task from the containers. Mutex must be locked. */
+  void EraseTask(const std::shared_ptr<Task>& task);
+
+  /*! Request the workers to stop. Mutex must be locked. The returned threads have to be joined after unlocking the mutex. */
+  std::vector<std::thread> StopWorkers();
+
+  typedef std::multimap<const void*, std::shared_ptr<Task> > TriggerTaskMap;
+
+  /*! Protects all the members below (TriggerTasks is only replaced with the mutex locked). Notified when tasks are queued or completed an update. */
+  std::mutex Mutex;
+  std::condition_variable Condition;
+  std::map<const void*, std::shared_ptr<Task> > Tasks;
+  /*! Tasks by trigger source. The map is never modified, only replaced, it must be accessed by std::atomic_load and std::atomic_store. */
+  std::shared_ptr<const TriggerTaskMap> TriggerTasks;
+  std::deque<std::shared_ptr<Task> > Queue;
+  std::vector<std::thread> Workers;
+  /*! Stop flag of the current worker pool */
+  std::shared_ptr<bool> StopWorkersFlag;
+
+  /*! Number of tasks, allows checking notifications without locking the mutex */
+  std::atomic<int> NumberOfTasks;
+
+private:
+  DataflowScheduler(const DataflowScheduler&);
+  void operator=(const DataflowScheduler&);
+};
+
+#endif
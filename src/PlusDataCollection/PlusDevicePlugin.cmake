@@ -0,0 +1,101 @@
+# --------------------------------------------------------------------------
+# Device plugins
+#
+# A device backend that is built as a plugin is compiled into its own module instead of vtkPlusDataCollection.
+# The module is only loaded by vtkPlusDeviceFactory when a device of the plugin is created, so applications
+# do not load the vendor SDKs of the devices that the device set does not use (see PlusDevicePlugin.h).
+#
+# PLUS_ADD_DEVICE_PLUGIN(<Name>
+#   SOURCES <source files>
+#   [INCLUDE_DIRS <include directories>]
+#   [LIBRARIES <libraries>]
+#   DEVICES <device type> <class name> <header file> [<device type> <class name> <header file> ...]
+#   )
+#
+# Declares the plugin module PlusDevicePlugin<Name>. The modules are created by PLUS_CREATE_DEVICE_PLUGINS
+# after the data collection library, because they link to it. The data collection library is compiled with
+# PLUS_DEVICE_PLUGIN_<NAME> defined, so that the device factory does not register the devices itself.
+
+INCLUDE(CMakeParseArguments)
+
+SET(PlusDevicePlugin_SOURCE_DIR ${CMAKE_CURRENT_LIST_DIR})
+
+FUNCTION(PLUS_ADD_DEVICE_PLUGIN _name)
+  CMAKE_PARSE_ARGUMENTS(_plugin "" "" "SOURCES;INCLUDE_DIRS;LIBRARIES;DEVICES" ${ARGN})
+
+  LIST(LENGTH _plugin_DEVICES _number_of_device_items)
+  MATH(EXPR _remainder "${_number_of_device_items} % 3")
+  IF(_number_of_device_items EQUAL 0 OR NOT _remainder EQUAL 0)
+    MESSAGE(FATAL_ERROR "PLUS_ADD_DEVICE_PLUGIN(${_name}): DEVICES must list device type, class name and header file triplets")
+  ENDIF()
+
+  SET(_sources)
+  FOREACH(_source ${_plugin_SOURCES})
+    GET_FILENAME_COMPONENT(_source ${_source} ABSOLUTE)
+    LIST(APPEND _sources ${_source})
+  ENDFOREACH()
+
+  SET_PROPERTY(GLOBAL APPEND PROPERTY PLUS_DEVICE_PLUGINS ${_name})
+  SET_PROPERTY(GLOBAL PROPERTY PLUS_DEVICE_PLUGIN_${_name}_SOURCES ${_sources})
+  SET_PROPERTY(GLOBAL PROPERTY PLUS_DEVICE_PLUGIN_${_name}_INCLUDE_DIRS ${_plugin_INCLUDE_DIRS})
+  SET_PROPERTY(GLOBAL PROPERTY PLUS_DEVICE_PLUGIN_${_name}_LIBRARIES ${_plugin_LIBRARIES})
+  SET_PROPERTY(GLOBAL PROPERTY PLUS_DEVICE_PLUGIN_${_name}_DEVICES ${_plugin_DEVICES})
+ENDFUNCTION()
+
+# PLUS_CREATE_DEVICE_PLUGINS(<data collection library target>)
+FUNCTION(PLUS_CREATE_DEVICE_PLUGINS _library)
+  GET_PROPERTY(_plugins GLOBAL PROPERTY PLUS_DEVICE_PLUGINS)
+  FOREACH(_name ${_plugins})
+    GET_PROPERTY(_sources GLOBAL PROPERTY PLUS_DEVICE_PLUGIN_${_name}_SOURCES)
+    GET_PROPERTY(_include_dirs GLOBAL PROPERTY PLUS_DEVICE_PLUGIN_${_name}_INCLUDE_DIRS)
+    GET_PROPERTY(_libraries GLOBAL PROPERTY PLUS_DEVICE_PLUGIN_${_name}_LIBRARIES)
+    GET_PROPERTY(_devices GLOBAL PROPERTY PLUS_DEVICE_PLUGIN_${_name}_DEVICES)
+    SET(_target PlusDevicePlugin${_name})
+
+    # Registration function and manifest
+    SET(PLUGIN_INCLUDES "")
+    SET(PLUGIN_REGISTRATIONS "")
+    SET(_manifest "Module ${_target}${CMAKE_SHARED_MODULE_SUFFIX}\n")
+    LIST(LENGTH _devices _number_of_device_items)
+    WHILE(_number_of_device_items GREATER 0)
+      LIST(GET _devices 0 _device_type)
+      LIST(GET _devices 1 _class_name)
+      LIST(GET _devices 2 _header)
+      LIST(REMOVE_AT _devices 0 1 2)
+      LIST(LENGTH _devices _number_of_device_items)
+      SET(PLUGIN_INCLUDES "${PLUGIN_INCLUDES}#include \"${_header}\"\n")
+      SET(PLUGIN_REGISTRATIONS "${PLUGIN_REGISTRATIONS}  factory->RegisterDevice(\"${_device_type}\", \"${_class_name}\", (vtkPlusDeviceFactory::PointerToDevice)&${_class_name}::New);\n")
+      SET(_manifest "${_manifest}Device ${_device_type} ${_class_name}\n")
+    ENDWHILE()
+    CONFIGURE_FILE(${PlusDevicePlugin_SOURCE_DIR}/PlusDevicePlugin.cxx.in ${CMAKE_CURRENT_BINARY_DIR}/${_target}.cxx @ONLY)
+    FILE(WRITE ${CMAKE_CURRENT_BINARY_DIR}/${_target}.devices ${_manifest})
+
+    ADD_LIBRARY(${_target} MODULE ${_sources} ${CMAKE_CURRENT_BINARY_DIR}/${_target}.cxx)
+    target_compile_definitions(${_target} PRIVATE PLUS_DEVICE_PLUGIN_BUILD)
+    target_include_directories(${_target} PRIVATE ${_include_dirs})
+    TARGET_LINK_LIBRARIES(${_target} PRIVATE ${_library} ${_libraries})
+    # Plugins are found in the directory of the executables
+    SET_TARGET_PROPERTIES(${_target} PROPERTIES
+      FOLDER DevicePlugins
+      PREFIX ""
+      LIBRARY_OUTPUT_DIRECTORY ${PLUS_EXECUTABLE_OUTPUT_PATH}
+      RUNTIME_OUTPUT_DIRECTORY ${PLUS_EXECUTABLE_OUTPUT_PATH}
+      )
+    ADD_CUSTOM_COMMAND(TARGET ${_target} POST_BUILD
+      COMMAND ${CMAKE_COMMAND} -E copy_if_different
+      ${CMAKE_CURRENT_BINARY_DIR}/${_target}.devices
+      $<TARGET_FILE_DIR:${_target}>/${_target}.devices
+      )
+
+    STRING(TOUPPER ${_name} _upper_name)
+    target_compile_definitions(${_library} PRIVATE PLUS_DEVICE_PLUGIN_${_upper_name})
+
+    INSTALL(TARGETS ${_target}
+      RUNTIME DESTINATION "${PLUSLIB_BINARY_INSTALL}" CONFIGURATIONS Release COMPONENT RuntimeLibraries
+      LIBRARY DESTINATION "${PLUSLIB_BINARY_INSTALL}" CONFIGURATIONS Release COMPONENT RuntimeLibraries
+      )
+    INSTALL(FILES ${CMAKE_CURRENT_BINARY_DIR}/${_target}.devices
+      DESTINATION "${PLUSLIB_BINARY_INSTALL}" COMPONENT RuntimeLibraries
+      )
+  ENDFOREACH()
+ENDFUNCTION()
@@ -0,0 +1,58 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusDevicePlugin_h
+#define __PlusDevicePlugin_h
+
+#include "vtkPlusDataCollectionExport.h"
+
+/*!
+  \file PlusDevicePlugin.h
+  \brief Definitions for device plugin modules
+
+  A device plugin is a module (shared library that is loaded at run time) that contains device classes and their
+  vendor SDK dependencies. The module exports a PlusRegisterDevicePlugin function that registers its devices
+  in the device factory. Next to the module there is a manifest file (<module name>.devices) that lists the device
+  types of the module, so that vtkPlusDeviceFactory can find the module of a device type without loading it:
+
+  \code
+  Module PlusDevicePluginIntelRealSense.dll
+  Device IntelRealSense vtkPlusIntelRealSense
+  \endcode
+
+  Plugins and their manifests are generated by PLUS_ADD_DEVICE_PLUGIN in PlusDevicePlugin.cmake.
+
+  \ingroup PlusLibDataCollection
+*/
+
+class vtkPlusDeviceFactory;
+
+/*! Name of the function that a device plugin module exports */
+#define PLUS_DEVICE_PLUGIN_REGISTER_FUNCTION_NAME "PlusRegisterDevicePlugin"
+
+/*! File name extension of the device plugin manifest files */
+#define PLUS_DEVICE_PLUGIN_MANIFEST_EXTENSION ".devices"
+
+/*! Registers the devices of a plugin in the factory */
+typedef void (*PlusRegisterDevicePluginFunction)(vtkPlusDeviceFactory* factory);
+
+#if defined(_WIN32)
+  #define PLUS_DEVICE_PLUGIN_ENTRY_POINT extern "C" __declspec(dllexport)
+#else
+  #define PLUS_DEVICE_PLUGIN_ENTRY_POINT extern "C" __attribute__((visibility("default")))
+#endif
+
+/*!
+  Export directive of device classes that may be built into a plugin module. The classes of a plugin are only used
+  through the registered New() functions, so they are not exported from the module.
+*/
+#ifdef PLUS_DEVICE_PLUGIN_BUILD
+  #define vtkPlusDeviceExport
+#else
+  #define vtkPlusDeviceExport vtkPlusDataCollectionExport
+#endif
+
+#endif
@@ -0,0 +1,366 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusFrameFieldStore.h"
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace
+{
+  typedef FrameFieldStore::KeyType KeyType;
+
+  //----------------------------------------------------------------------------
+  // Open addressing hash index of the interned names. A slot contains key+1, 0 means empty.
+  // Slots are only filled, never cleared, so readers can probe it without locking.
+  struct KeyIndex
+  {
+    explicit KeyIndex(unsigned int capacity)
+      : Capacity(capacity)
+      , Slots(new std::atomic<KeyType>[capacity])
+    {
+      for (unsigned int i = 0; i < capacity; ++i)
+      {
+        this->Slots[i].store(0, std::memory_order_relaxed);
+      }
+    }
+    unsigned int Capacity; // power of two
+    std::unique_ptr<std::atomic<KeyType>[]> Slots;
+  };
+
+  //----------------------------------------------------------------------------
+  // Process-wide table of interned field names. The table is append-only: names are stored in chunks
+  // that are never moved or freed, so the names can be read without locking. Each insertion fills the name,
+  // then publishes it with a release store (NumberOfNames and the index slot), readers load with acquire.
+  // The mutex only serializes the insertions.
+  struct KeyTable
+  {
+    // Chunk i holds FIRST_CHUNK_SIZE*2^i names, this is enough for all KeyType values
+    static const unsigned int FIRST_CHUNK_SIZE = 64;
+    static const unsigned int MAX_NUMBER_OF_CHUNKS = 32;
+
+    KeyTable()
+      : NumberOfNames(0)
+      , Index(NULL)
+    {
+      for (unsigned int i = 0; i < MAX_NUMBER_OF_CHUNKS; ++i)
+      {
+        this->NameChunks[i].store(NULL, std::memory_order_relaxed);
+      }
+      this->Indices.emplace_back(new KeyIndex(2 * FIRST_CHUNK_SIZE));
+      this->Index.store(this->Indices.back().get(), std::memory_order_release);
+    }
+
+    ~KeyTable()
+    {
+      for (unsigned int i = 0; i < MAX_NUMBER_OF_CHUNKS; ++i)
+      {
+        delete[] this->NameChunks[i].load(std::memory_order_relaxed);
+      }
+    }
+
+    // Get the location of a key in the name chunks
+    static void GetNamePosition(KeyType key, unsigned int& chunkIndex, KeyType& indexInChunk)
+    {
+      chunkIndex = 0;
+      KeyType chunkStart = 0;
+      KeyType chunkSize = FIRST_CHUNK_SIZE;
+      while (key - chunkStart >= chunkSize)
+      {
+        chunkStart += chunkSize;
+        chunkSize *= 2;
+        ++chunkIndex;
+      }
+      indexInChunk = key - chunkStart;
+    }
+
+    // The key must be published already (smaller than an acquire load of NumberOfNames or found in the index)
+    const std::string& GetName(KeyType key) const
+    {
+      unsigned int chunkIndex = 0;
+      KeyType indexInChunk = 0;
+      GetNamePosition(key, chunkIndex, indexInChunk);
+      return this->NameChunks[chunkIndex].load(std::memory_order_acquire)[indexInChunk];
+    }
+
+    // Lock-free lookup, returns false if the name is not published yet
+    bool Find(const std::string& fieldName, size_t hash, KeyType& key) const
+    {
+      const KeyIndex* index = this->Index.load(std::memory_order_acquire);
+      for (unsigned int slot = static_cast<unsigned int>(hash & (index->Capacity - 1));; slot = (slot + 1) & (index->Capacity - 1))
+      {
+        KeyType slotValue = index->Slots[slot].load(std::memory_order_acquire);
+        if (slotValue == 0)
+        {
+          return false;
+        }
+        if (this->GetName(slotValue - 1) == fieldName)
+        {
+          key = slotValue - 1;
+          return true;
+        }
+      }
+    }
+
+    // Add the key to the index, the caller must hold the mutex
+    static void AddToIndex(KeyIndex& index, size_t hash, KeyType key)
+    {
+      unsigned int slot = static_cast<unsigned int>(hash & (index.Capacity - 1));
+      while (index.Slots[slot].load(std::memory_order_relaxed) != 0)
+      {
+        slot = (slot + 1) & (index.Capacity - 1);
+      }
+      index.Slots[slot].store(key + 1, std::memory_order_release);
+    }
+
+    std::mutex InsertMutex;
+    std::atomic<KeyType> NumberOfNames;
+    std::atomic<std::string*> NameChunks[MAX_NUMBER_OF_CHUNKS];
+    std::atomic<KeyIndex*> Index;
+    // All the indices that were ever published, readers may still use a replaced index
+    std::vector<std::unique_ptr<KeyIndex> > Indices;
+  };
+
+  //----------------------------------------------------------------------------
+  KeyTable& GetKeyTable()
+  {
+    static KeyTable keyTable;
+    return keyTable;
+  }
+}
+
+std::atomic<unsigned long long> FrameFieldStore::NumberOfAllocations(0);
+
+//----------------------------------------------------------------------------
+FrameFieldStore::FrameFieldStore()
+  : NumberOfFields(0)
+{
+}
+
+//----------------------------------------------------------------------------
+FrameFieldStore::~FrameFieldStore()
+{
+}
+
+//----------------------------------------------------------------------------
+FrameFieldStore::FrameFieldStore(const FrameFieldStore& store)
+  : NumberOfFields(0)
+{
+  *this = store;
+}
+
+//----------------------------------------------------------------------------
+FrameFieldStore& FrameFieldStore::operator=(const FrameFieldStore& store)
+{
+  // Handle self-assignment
+  if (this == &store)
+  {
+    return *this;
+  }
+
+  // Overwrite the existing entries instead of replacing the array, so that the memory is reused
+  this->NumberOfFields = 0;
+  for (unsigned int i = 0; i < store.NumberOfFields; ++i)
+  {
+    FieldEntry& entry = this->AppendField(store.Fields[i].Key);
+    entry.Flags = store.Fields[i].Flags;
+    AssignValue(entry.Value, store.Fields[i].Value);
+  }
+
+  return *this;
+}
+
+//----------------------------------------------------------------------------
+FrameFieldStore::KeyType FrameFieldStore::InternKey(const std::string& fieldName)
+{
+  KeyTable& keyTable = GetKeyTable();
+  const size_t hash = std::hash<std::string>()(fieldName);
+  KeyType key = 0;
+  if (keyTable.Find(fieldName, hash, key))
+  {
+    return key;
+  }
+
+  std::lock_guard<std::mutex> keyTableLock(keyTable.InsertMutex);
+  // Another thread may have added the name since the lock-free lookup
+  if (keyTable.Find(fieldName, hash, key))
+  {
+    return key;
+  }
+
+  key = keyTable.NumberOfNames.load(std::memory_order_relaxed);
+  unsigned int chunkIndex = 0;
+  KeyType indexInChunk = 0;
+  KeyTable::GetNamePosition(key, chunkIndex, indexInChunk);
+  std::string* chunk = keyTable.NameChunks[chunkIndex].load(std::memory_order_relaxed);
+  if (chunk == NULL)
+  {
+    chunk = new std::string[static_cast<size_t>(KeyTable::FIRST_CHUNK_SIZE) << chunkIndex];
+    keyTable.NameChunks[chunkIndex].store(chunk, std::memory_order_release);
+  }
+  chunk[indexInChunk] = fieldName;
+
+  // Keep the index at most half full, a grown index is published only after all the keys are added to it
+  KeyIndex* index = keyTable.Index.load(std::memory_order_relaxed);
+  if (2 * (key + 1) > index->Capacity)
+  {
+    keyTable.Indices.emplace_back(new KeyIndex(2 * index->Capacity));
+    KeyIndex* grownIndex = keyTable.Indices.back().get();
+    for (KeyType existingKey = 0; existingKey < key; ++existingKey)
+    {
+      KeyTable::AddToIndex(*grownIndex, std::hash<std::string>()(keyTable.GetName(existingKey)), existingKey);
+    }
+    keyTable.Index.store(grownIndex, std::memory_order_release);
+    index = grownIndex;
+  }
+
+  keyTable.NumberOfNames.store(key + 1, std::memory_order_release);
+  KeyTable::AddToIndex(*index, hash, key);
+  NumberOfAllocations++;
+  return key;
+}
+
+//----------------------------------------------------------------------------
+bool FrameFieldStore::FindKey(const std::string& fieldName, KeyType& key)
+{
+  return GetKeyTable().Find(fieldName, std::hash<std::string>()(fieldName), key);
+}
+
+//----------------------------------------------------------------------------
+const std::string& FrameFieldStore::GetKeyName(KeyType key)
+{
+  static const std::string emptyName;
+  const KeyTable& keyTable = GetKeyTable();
+  if (key >= keyTable.NumberOfNames.load(std::memory_order_acquire))
+  {
+    LOG_ERROR("Unknown frame field key: " << key);
+    return emptyName;
+  }
+  return keyTable.GetName(key);
+}
+
+//----------------------------------------------------------------------------
+unsigned long long FrameFieldStore::GetNumberOfAllocations()
+{
+  return NumberOfAllocations;
+}
+
+//----------------------------------------------------------------------------
+void FrameFieldStore::SetField(KeyType key, const std::string& fieldValue, igsioFrameFieldFlags flags)
+{
+  int fieldIndex = this->FindField(key);
+  FieldEntry& entry = (fieldIndex >= 0 ? this->Fields[fieldIndex] : this->AppendField(key));
+  entry.Flags = flags;
+  AssignValue(entry.Value, fieldValue);
+}
+
+//----------------------------------------------------------------------------
+void FrameFieldStore::SetField(const std::string& fieldName, const std::string& fieldValue, igsioFrameFieldFlags flags)
+{
+  this->SetField(InternKey(fieldName), fieldValue, flags);
+}
+
+//----------------------------------------------------------------------------
+const std::string* FrameFieldStore::GetField(KeyType key) const
+{
+  int fieldIndex = this->FindField(key);
+  if (fieldIndex < 0)
+  {
+    return NULL;
+  }
+  return &(this->Fields[fieldIndex].Value);
+}
+
+//----------------------------------------------------------------------------
+const std::string* FrameFieldStore::GetField(const std::string& fieldName) const
+{
+  KeyType key(0);
+  if (!FindKey(fieldName, key))
+  {
+    return NULL;
+  }
+  return this->GetField(key);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus FrameFieldStore::DeleteField(const std::string& fieldName)
+{
+  KeyType key(0);
+  int fieldIndex = (FindKey(fieldName, key) ? this->FindField(key) : -1);
+  if (fieldIndex < 0)
+  {
+    return PLUS_FAIL;
+  }
+  // Move the last used entry into the place of the deleted one (swap does not allocate),
+  // the deleted entry is kept at the end of the array for reuse
+  this->NumberOfFields--;
+  if (static_cast<unsigned int>(fieldIndex) != this->NumberOfFields)
+  {
+    std::swap(this->Fields[fieldIndex], this->Fields[this->NumberOfFields]);
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void FrameFieldStore::Clear()
+{
+  this->NumberOfFields = 0;
+}
+
+//----------------------------------------------------------------------------
+void FrameFieldStore::GetFieldMap(igsioFieldMapType& fieldMap) const
+{
+  fieldMap.clear();
+  for (unsigned int i = 0; i < this->NumberOfFields; ++i)
+  {
+    igsioFieldMapType::mapped_type& field = fieldMap[GetKeyName(this->Fields[i].Key)];
+    field.first = this->Fields[i].Flags;
+    field.second = this->Fields[i].Value;
+  }
+}
+
+//----------------------------------------------------------------------------
+int FrameFieldStore::FindField(KeyType key) const
+{
+  for (unsigned int i = 0; i < this->NumberOfFields; ++i)
+  {
+    if (this->Fields[i].Key == key)
+    {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+//----------------------------------------------------------------------------
+FrameFieldStore::FieldEntry& FrameFieldStore::AppendField(KeyType key)
+{
+  if (this->NumberOfFields == this->Fields.size())
+  {
+    if (this->Fields.size() == this->Fields.capacity())
+    {
+      NumberOfAllocations++;
+    }
+    this->Fields.push_back(FieldEntry());
+  }
+  FieldEntry& entry = this->Fields[this->NumberOfFields];
+  this->NumberOfFields++;
+  entry.Key = key;
+  return entry;
+}
+
+//----------------------------------------------------------------------------
+void FrameFieldStore::AssignValue(std::string& target, const std::string& source)
+{
+  if (source.size() > target.capacity())
+  {
+    NumberOfAllocations++;
+  }
+  target.assign(source);
+}
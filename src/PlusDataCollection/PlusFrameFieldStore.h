@@ -0,0 +1,108 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __FrameFieldStore_h
+#define __FrameFieldStore_h
+
+#include "vtkPlusDataCollectionExport.h"
+
+// IGSIO includes
+#include <igsioCommon.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+/*!
+  \class FrameFieldStore
+  \brief Flat storage of the custom fields of a buffer item.
+
+  Field names are interned (stored once, in a process-wide table) and referred to by a numeric key,
+  the values are kept in a flat array. The key table is append-only, looking up keys and names does not lock
+  (only adding a new name does). When a store is reused (e.g., a slot of a circular buffer is overwritten
+  or a buffer item is copied into the same output item again) the existing strings are overwritten in place,
+  so once the keys are known and the value lengths do not grow, setting and copying fields does not allocate memory.
+
+  NumberOfAllocations counts the events when the store had to allocate memory (new key, new field entry,
+  value longer than the available capacity), so that steady-state operation can be verified to be allocation free.
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport FrameFieldStore
+{
+public:
+  typedef unsigned int KeyType;
+
+  FrameFieldStore();
+  virtual ~FrameFieldStore();
+
+  FrameFieldStore(const FrameFieldStore& store);
+  FrameFieldStore& operator=(const FrameFieldStore& store);
+
+  /*! Get the key of a field name. The name is added to the key table if it is not there yet. */
+  static KeyType InternKey(const std::string& fieldName);
+
+  /*! Get the key of a field name without adding it to the key table. Returns false if the name is not in the table. */
+  static bool FindKey(const std::string& fieldName, KeyType& key);
+
+  /*! Get the field name that belongs to a key */
+  static const std::string& GetKeyName(KeyType key);
+
+  /*! Get the total number of memory allocations performed by all field stores */
+  static unsigned long long GetNumberOfAllocations();
+
+  /*! Set field value. The content of the previous value is overwritten in place. */
+  void SetField(KeyType key, const std::string& fieldValue, igsioFrameFieldFlags flags = FRAMEFIELD_NONE);
+  void SetField(const std::string& fieldName, const std::string& fieldValue, igsioFrameFieldFlags flags = FRAMEFIELD_NONE);
+
+  /*! Get pointer to the field value. Returns NULL if the field is not found. */
+  const std::string* GetField(KeyType key) const;
+  const std::string* GetField(const std::string& fieldName) const;
+
+  /*! Delete field. Returns PLUS_FAIL if the field is not found. */
+  PlusStatus DeleteField(const std::string& fieldName);
+
+  /*! Delete all fields, the allocated memory is kept for reuse */
+  void Clear();
+
+  /*! Get the number of the stored fields. Fields can be accessed by index in the [0, GetNumberOfFields()-1] range. */
+  unsigned int GetNumberOfFields() const { return this->NumberOfFields; }
+  bool IsEmpty() const { return this->NumberOfFields == 0; }
+
+  /*! Get name, value, or flags of the field at the specified index */
+  const std::string& GetFieldName(unsigned int index) const { return GetKeyName(this->Fields[index].Key); }
+  const std::string& GetFieldValue(unsigned int index) const { return this->Fields[index].Value; }
+  igsioFrameFieldFlags GetFieldFlags(unsigned int index) const { return this->Fields[index].Flags; }
+
+  /*! Copy all fields to a field map (allocates memory for the map) */
+  void GetFieldMap(igsioFieldMapType& fieldMap) const;
+
+protected:
+  struct FieldEntry
+  {
+    FieldEntry() : Key(0), Flags(FRAMEFIELD_NONE) {}
+    KeyType Key;
+    igsioFrameFieldFlags Flags;
+    std::string Value;
+  };
+
+  /*! Get the index of the field in Fields, -1 if not found */
+  int FindField(KeyType key) const;
+
+  /*! Get an unused entry at the end of the used range. Unused entries are reused before the array is grown. */
+  FieldEntry& AppendField(KeyType key);
+
+  /*! Copy a string into an existing string, count the allocation if the capacity is not sufficient */
+  static void AssignValue(std::string& target, const std::string& source);
+
+  /*! Entries in the [0, NumberOfFields-1] range are used, the rest are kept for reuse */
+  std::vector<FieldEntry> Fields;
+  unsigned int NumberOfFields;
+
+  static std::atomic<unsigned long long> NumberOfAllocations;
+};
+
+#endif
@@ -0,0 +1,273 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusFrameMemoryRegion.h"
+
+#if defined(_WIN32)
+  #include <windows.h>
+#elif defined(__linux__)
+  #include <sys/mman.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+  #include <sstream>
+  #include <vector>
+#else
+  #include <cstdlib>
+#endif
+
+namespace
+{
+#if defined(_WIN32)
+  //----------------------------------------------------------------------------
+  // Large page allocation requires the SeLockMemoryPrivilege to be enabled in the process token
+  bool EnableLockMemoryPrivilege()
+  {
+    HANDLE token = NULL;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+    {
+      return false;
+    }
+    TOKEN_PRIVILEGES privileges;
+    privileges.PrivilegeCount = 1;
+    privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    bool success = LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid)
+                   && AdjustTokenPrivileges(token, FALSE, &privileges, 0, NULL, NULL)
+                   && GetLastError() == ERROR_SUCCESS;
+    CloseHandle(token);
+    return success;
+  }
+#elif defined(__linux__)
+  // Size of the huge pages on x86-64 and on most aarch64 configurations
+  const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+  // Memory policy constants of the mbind system call (defined in numaif.h, which is not available without libnuma)
+  const int PLUS_MPOL_PREFERRED = 1;
+
+  const size_t REGULAR_PAGE_SIZE = 4096;
+
+  //----------------------------------------------------------------------------
+  size_t RoundUp(size_t size, size_t alignment)
+  {
+    return (size + alignment - 1) / alignment * alignment;
+  }
+#else
+  // Alignment of the region (cache line size)
+  const size_t REGION_ALIGNMENT = 64;
+#endif
+}
+
+//----------------------------------------------------------------------------
+FrameMemoryRegion::FrameMemoryRegion()
+  : Pointer(NULL)
+  , Size(0)
+  , UsingLargePages(false)
+  , NumaNode(-1)
+{
+}
+
+//----------------------------------------------------------------------------
+FrameMemoryRegion::~FrameMemoryRegion()
+{
+  this->Free();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus FrameMemoryRegion::Allocate(size_t sizeInBytes, bool useLargePages, int numaNode)
+{
+  this->Free();
+  if (sizeInBytes == 0)
+  {
+    return PLUS_SUCCESS;
+  }
+
+#if defined(_WIN32)
+  void* pointer = NULL;
+  size_t size = sizeInBytes;
+  SIZE_T largePageSize = GetLargePageMinimum();
+  if (useLargePages && largePageSize > 0)
+  {
+    static const bool lockMemoryPrivilegeEnabled = EnableLockMemoryPrivilege();
+    if (lockMemoryPrivilegeEnabled)
+    {
+      size = (sizeInBytes + largePageSize - 1) / largePageSize * largePageSize;
+      DWORD allocationType = MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES;
+      pointer = (numaNode >= 0 ? VirtualAllocExNuma(GetCurrentProcess(), NULL, size, allocationType, PAGE_READWRITE, numaNode)
+                 : VirtualAlloc(NULL, size, allocationType, PAGE_READWRITE));
+    }
+    if (pointer == NULL)
+    {
+      LOG_DEBUG("Large pages are not available (the Lock pages in memory privilege may be missing), using regular pages for " << sizeInBytes << " bytes");
+    }
+    this->UsingLargePages = (pointer != NULL);
+  }
+  if (pointer == NULL)
+  {
+    size = sizeInBytes;
+    DWORD allocationType = MEM_RESERVE | MEM_COMMIT;
+    pointer = (numaNode >= 0 ? VirtualAllocExNuma(GetCurrentProcess(), NULL, size, allocationType, PAGE_READWRITE, numaNode)
+               : VirtualAlloc(NULL, size, allocationType, PAGE_READWRITE));
+  }
+  if (pointer == NULL)
+  {
+    LOG_ERROR("Failed to allocate " << sizeInBytes << " bytes of frame memory (error code: " << GetLastError() << ")");
+    return PLUS_FAIL;
+  }
+  this->NumaNode = numaNode;
+#elif defined(__linux__)
+  void* pointer = MAP_FAILED;
+  size_t size = RoundUp(sizeInBytes, useLargePages ? HUGE_PAGE_SIZE : REGULAR_PAGE_SIZE);
+  if (useLargePages)
+  {
+#if defined(MAP_HUGETLB)
+    // Pre-reserved huge pages (vm.nr_hugepages)
+    pointer = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    this->UsingLargePages = (pointer != MAP_FAILED);
+#endif
+  }
+  if (pointer == MAP_FAILED)
+  {
+    // Regular pages. Map one more huge page so that the region can be aligned to huge page boundary,
+    // which is needed for transparent huge pages.
+    size_t mappedSize = size + (useLargePages ? HUGE_PAGE_SIZE : 0);
+    void* mappedPointer = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mappedPointer == MAP_FAILED)
+    {
+      LOG_ERROR("Failed to allocate " << sizeInBytes << " bytes of frame memory");
+      return PLUS_FAIL;
+    }
+    pointer = mappedPointer;
+    if (useLargePages)
+    {
+      unsigned char* alignedPointer = reinterpret_cast<unsigned char*>(RoundUp(reinterpret_cast<size_t>(mappedPointer), HUGE_PAGE_SIZE));
+      size_t headSize = alignedPointer - static_cast<unsigned char*>(mappedPointer);
+      if (headSize > 0)
+      {
+        munmap(mappedPointer, headSize);
+      }
+      if (mappedSize - headSize > size)
+      {
+        munmap(alignedPointer + size, mappedSize - headSize - size);
+      }
+      pointer = alignedPointer;
+#if defined(MADV_HUGEPAGE)
+      this->UsingLargePages = (madvise(pointer, size, MADV_HUGEPAGE) == 0);
+#endif
+      if (!this->UsingLargePages)
+      {
+        LOG_DEBUG("Huge pages are not available, using regular pages for " << sizeInBytes << " bytes");
+      }
+    }
+  }
+
+  // Pages are not touched yet, so setting the memory policy now determines where they will be placed
+  if (numaNode >= 0)
+  {
+    const size_t bitsPerLong = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> nodeMask(numaNode / bitsPerLong + 1, 0);
+    nodeMask[numaNode / bitsPerLong] |= 1UL << (numaNode % bitsPerLong);
+    if (syscall(SYS_mbind, pointer, size, PLUS_MPOL_PREFERRED, &nodeMask[0], nodeMask.size() * bitsPerLong + 1, 0) == 0)
+    {
+      this->NumaNode = numaNode;
+    }
+    else
+    {
+      LOG_DEBUG("Failed to set the NUMA node of frame memory to " << numaNode << ", using the default placement");
+    }
+  }
+#else
+  size_t size = sizeInBytes;
+  void* pointer = NULL;
+  if (posix_memalign(&pointer, REGION_ALIGNMENT, size) != 0)
+  {
+    LOG_ERROR("Failed to allocate " << sizeInBytes << " bytes of frame memory");
+    return PLUS_FAIL;
+  }
+#endif
+
+  this->Pointer = static_cast<unsigned char*>(pointer);
+  this->Size = size;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void FrameMemoryRegion::Free()
+{
+  if (this->Pointer != NULL)
+  {
+#if defined(_WIN32)
+    VirtualFree(this->Pointer, 0, MEM_RELEASE);
+#elif defined(__linux__)
+    munmap(this->Pointer, this->Size);
+#else
+    free(this->Pointer);
+#endif
+  }
+  this->Pointer = NULL;
+  this->Size = 0;
+  this->UsingLargePages = false;
+  this->NumaNode = -1;
+}
+
+//----------------------------------------------------------------------------
+bool FrameMemoryRegion::Contains(const void* pointer) const
+{
+  const unsigned char* bytePointer = static_cast<const unsigned char*>(pointer);
+  return this->Pointer != NULL && bytePointer >= this->Pointer && bytePointer < this->Pointer + this->Size;
+}
+
+//----------------------------------------------------------------------------
+int FrameMemoryRegion::GetCurrentThreadNumaNode()
+{
+#if defined(_WIN32)
+  PROCESSOR_NUMBER processorNumber;
+  GetCurrentProcessorNumberEx(&processorNumber);
+  USHORT node = 0;
+  if (!GetNumaProcessorNodeEx(&processorNumber, &node))
+  {
+    return -1;
+  }
+  return node;
+#elif defined(__linux__)
+  unsigned int cpu = 0;
+  unsigned int node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0)
+  {
+    return -1;
+  }
+  return static_cast<int>(node);
+#else
+  return -1;
+#endif
+}
+
+//----------------------------------------------------------------------------
+int FrameMemoryRegion::GetNumberOfNumaNodes()
+{
+#if defined(_WIN32)
+  ULONG highestNodeNumber = 0;
+  if (!GetNumaHighestNodeNumber(&highestNodeNumber))
+  {
+    return 1;
+  }
+  return static_cast<int>(highestNodeNumber) + 1;
+#elif defined(__linux__)
+  int numberOfNodes = 0;
+  while (true)
+  {
+    std::ostringstream nodePath;
+    nodePath << "/sys/devices/system/node/node" << numberOfNodes;
+    if (access(nodePath.str().c_str(), F_OK) != 0)
+    {
+      break;
+    }
+    numberOfNodes++;
+  }
+  return numberOfNodes > 0 ? numberOfNodes : 1;
+#else
+  return 1;
+#endif
+}
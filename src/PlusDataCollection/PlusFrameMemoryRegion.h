@@ -0,0 +1,76 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __FrameMemoryRegion_h
+#define __FrameMemoryRegion_h
+
+#include "vtkPlusDataCollectionExport.h"
+
+#include "PlusConfigure.h"
+
+#include <cstddef>
+
+/*!
+  \class FrameMemoryRegion
+  \brief One contiguous block of memory that backs all the frames of a buffer.
+
+  The memory is allocated with large (huge) pages if the operating system provides them
+  (Linux: pre-reserved huge pages or transparent huge pages, Windows: large pages, which require
+  the "Lock pages in memory" privilege) and falls back to regular pages otherwise.
+  If a NUMA node is specified then the memory is placed on that node.
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport FrameMemoryRegion
+{
+public:
+  FrameMemoryRegion();
+  virtual ~FrameMemoryRegion();
+
+  /*!
+    Allocate memory. Previously allocated memory is released.
+    \param sizeInBytes Requested size, the allocated size is rounded up to the page size
+    \param useLargePages Try to use large pages (falls back to regular pages if not available)
+    \param numaNode NUMA node where the memory should be placed, -1 to use the default placement policy of the operating system
+  */
+  PlusStatus Allocate(size_t sizeInBytes, bool useLargePages, int numaNode);
+
+  /*! Release the allocated memory */
+  void Free();
+
+  /*! Pointer to the beginning of the region, NULL if not allocated */
+  unsigned char* GetPointer() const { return this->Pointer; }
+
+  /*! Allocated size in bytes */
+  size_t GetSize() const { return this->Size; }
+
+  /*! Returns true if the pointer points inside the region */
+  bool Contains(const void* pointer) const;
+
+  /*! Returns true if the memory is backed by large pages */
+  bool GetUsingLargePages() const { return this->UsingLargePages; }
+
+  /*! NUMA node that the memory was placed on, -1 if the default placement policy was used */
+  int GetNumaNode() const { return this->NumaNode; }
+
+  /*! Get the NUMA node of the processor that is running the calling thread. Returns -1 if it cannot be determined. */
+  static int GetCurrentThreadNumaNode();
+
+  /*! Get the number of NUMA nodes in the system (1 if the system is not NUMA or it cannot be determined) */
+  static int GetNumberOfNumaNodes();
+
+protected:
+  unsigned char* Pointer;
+  size_t Size;
+  bool UsingLargePages;
+  int NumaNode;
+
+private:
+  FrameMemoryRegion(const FrameMemoryRegion&);
+  void operator=(const FrameMemoryRegion&);
+};
+
+#endif
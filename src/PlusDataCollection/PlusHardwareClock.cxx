@@ -0,0 +1,344 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusHardwareClock.h"
+
+#include <vtkIGSIOAccurateTimer.h>
+#include <vtkXMLDataElement.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+const double HardwareClock::MINIMUM_RATE_ESTIMATION_SPAN_SEC = 1.0;
+const double HardwareClock::DEFAULT_PTP_UTC_OFFSET_SEC = 37.0;
+
+namespace
+{
+  /*! The rate is estimated by regression only if there are at least this many pairs, before that it is assumed to be 1 */
+  const size_t MINIMUM_NUMBER_OF_PAIRS = 10;
+  const double DEFAULT_MAXIMUM_ARRIVAL_DIFFERENCE_SEC = 1.0;
+  /*! Minimum increment of the returned timestamps, the buffers do not accept items with non-increasing timestamps */
+  const double MINIMUM_TIMESTAMP_INCREMENT_SEC = 1e-6;
+}
+
+//----------------------------------------------------------------------------
+HardwareClock::HardwareClock()
+  : Type(CLOCK_NONE)
+  , PtpUtcOffsetSec(DEFAULT_PTP_UTC_OFFSET_SEC)
+  , MaximumArrivalDifferenceSec(DEFAULT_MAXIMUM_ARRIVAL_DIFFERENCE_SEC)
+  , LastSystemTimeSec(-std::numeric_limits<double>::max())
+  , LastHardwareTimestampSec(-std::numeric_limits<double>::max())
+  , UnsynchronizedReported(false)
+{
+  this->ResetEstimation();
+}
+
+//----------------------------------------------------------------------------
+const char* HardwareClock::GetClockTypeAsString(ClockType type)
+{
+  switch (type)
+  {
+    case CLOCK_DEVICE:
+      return "Device";
+    case CLOCK_PTP:
+      return "Ptp";
+    case CLOCK_UTC:
+      return "Utc";
+    default:
+      return "None";
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus HardwareClock::GetClockTypeFromString(const std::string& typeString, ClockType& type)
+{
+  const ClockType types[] = { CLOCK_NONE, CLOCK_DEVICE, CLOCK_PTP, CLOCK_UTC };
+  for (int i = 0; i < 4; ++i)
+  {
+    if (STRCASECMP(typeString.c_str(), GetClockTypeAsString(types[i])) == 0)
+    {
+      type = types[i];
+      return PLUS_SUCCESS;
+    }
+  }
+  return PLUS_FAIL;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus HardwareClock::ReadConfiguration(vtkXMLDataElement* deviceElement)
+{
+  if (deviceElement == NULL)
+  {
+    LOG_ERROR("Unable to read hardware clock configuration: XML data element is invalid");
+    return PLUS_FAIL;
+  }
+
+  const char* clockType = deviceElement->GetAttribute("HardwareClock");
+  if (clockType != NULL)
+  {
+    ClockType type = CLOCK_NONE;
+    if (GetClockTypeFromString(clockType, type) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Invalid HardwareClock attribute value: " << clockType << " (expected None, Device, Ptp or Utc)");
+      return PLUS_FAIL;
+    }
+    this->SetClockType(type);
+  }
+
+  double ptpUtcOffsetSec = 0;
+  if (deviceElement->GetScalarAttribute("HardwareClockPtpUtcOffsetSec", ptpUtcOffsetSec))
+  {
+    this->SetPtpUtcOffsetSec(ptpUtcOffsetSec);
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus HardwareClock::WriteConfiguration(vtkXMLDataElement* deviceElement) const
+{
+  if (deviceElement == NULL)
+  {
+    LOG_ERROR("Unable to write hardware clock configuration: XML data element is invalid");
+    return PLUS_FAIL;
+  }
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  if (this->Type == CLOCK_NONE)
+  {
+    deviceElement->RemoveAttribute("HardwareClock");
+    return PLUS_SUCCESS;
+  }
+  deviceElement->SetAttribute("HardwareClock", GetClockTypeAsString(this->Type));
+  if (this->Type == CLOCK_PTP && this->PtpUtcOffsetSec != DEFAULT_PTP_UTC_OFFSET_SEC)
+  {
+    deviceElement->SetDoubleAttribute("HardwareClockPtpUtcOffsetSec", this->PtpUtcOffsetSec);
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void HardwareClock::SetClockType(ClockType type)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->Type = type;
+  this->ResetEstimation();
+  this->LastSystemTimeSec = -std::numeric_limits<double>::max();
+  this->LastHardwareTimestampSec = -std::numeric_limits<double>::max();
+}
+
+//----------------------------------------------------------------------------
+HardwareClock::ClockType HardwareClock::GetClockType() const
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return this->Type;
+}
+
+//----------------------------------------------------------------------------
+void HardwareClock::SetPtpUtcOffsetSec(double offsetSec)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->PtpUtcOffsetSec = offsetSec;
+}
+
+//----------------------------------------------------------------------------
+double HardwareClock::GetPtpUtcOffsetSec() const
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return this->PtpUtcOffsetSec;
+}
+
+//----------------------------------------------------------------------------
+void HardwareClock::SetMaximumArrivalDifferenceSec(double differenceSec)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->MaximumArrivalDifferenceSec = differenceSec;
+}
+
+//----------------------------------------------------------------------------
+void HardwareClock::Reset()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->ResetEstimation();
+  this->LastSystemTimeSec = -std::numeric_limits<double>::max();
+  this->LastHardwareTimestampSec = -std::numeric_limits<double>::max();
+}
+
+//----------------------------------------------------------------------------
+void HardwareClock::ResetEstimation()
+{
+  this->Pairs.clear();
+  this->ReferenceValid = false;
+  this->ReferenceHardwareTimeSec = 0;
+  this->ReferenceArrivalTimeSec = 0;
+  this->EstimatedRate = 1.0;
+}
+
+//----------------------------------------------------------------------------
+double HardwareClock::GetEstimatedRate() const
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return this->EstimatedRate;
+}
+
+//----------------------------------------------------------------------------
+double HardwareClock::GetUtcToSystemTimeOffsetSec()
+{
+  // The host UTC clock may be slewed by the PTP or NTP daemon, so the offset is measured at each conversion
+  double systemTimeBefore = vtkIGSIOAccurateTimer::GetSystemTime();
+  double utcTime = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+  double systemTimeAfter = vtkIGSIOAccurateTimer::GetSystemTime();
+  return utcTime - (systemTimeBefore + systemTimeAfter) / 2.0;
+}
+
+//----------------------------------------------------------------------------
+double HardwareClock::GetSystemTime(double hardwareTimestampSec, double arrivalSystemTimeSec)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+
+  if (this->Type != CLOCK_NONE && hardwareTimestampSec == this->LastHardwareTimestampSec)
+  {
+    // another item of the same hardware sample (e.g., multiple tools of one tracker frame), it gets the same timestamp
+    return this->LastSystemTimeSec;
+  }
+
+  double systemTimeSec = arrivalSystemTimeSec;
+  switch (this->Type)
+  {
+    case CLOCK_DEVICE:
+      systemTimeSec = this->GetDeviceClockSystemTime(hardwareTimestampSec, arrivalSystemTimeSec);
+      break;
+    case CLOCK_PTP:
+    case CLOCK_UTC:
+    {
+      double utcTimeSec = hardwareTimestampSec - (this->Type == CLOCK_PTP ? this->PtpUtcOffsetSec : 0.0);
+      systemTimeSec = utcTimeSec - GetUtcToSystemTimeOffsetSec();
+      bool synchronized = (std::fabs(systemTimeSec - arrivalSystemTimeSec) <= this->MaximumArrivalDifferenceSec);
+      if (!synchronized)
+      {
+        if (!this->UnsynchronizedReported)
+        {
+          LOG_WARNING("Hardware timestamp differs from the arrival time by " << systemTimeSec - arrivalSystemTimeSec
+                      << " s, the clocks are not synchronized. The arrival times are used until the clocks are synchronized.");
+        }
+        systemTimeSec = arrivalSystemTimeSec;
+      }
+      else if (this->UnsynchronizedReported)
+      {
+        LOG_INFO("Hardware timestamps are synchronized with the system time, the hardware timestamps are used");
+      }
+      this->UnsynchronizedReported = !synchronized;
+      break;
+    }
+    default:
+      return arrivalSystemTimeSec;
+  }
+
+  if (systemTimeSec <= this->LastSystemTimeSec)
+  {
+    systemTimeSec = this->LastSystemTimeSec + MINIMUM_TIMESTAMP_INCREMENT_SEC;
+  }
+  this->LastSystemTimeSec = systemTimeSec;
+  this->LastHardwareTimestampSec = hardwareTimestampSec;
+  return systemTimeSec;
+}
+
+//----------------------------------------------------------------------------
+double HardwareClock::GetDeviceClockSystemTime(double hardwareTimestampSec, double arrivalSystemTimeSec)
+{
+  if (this->ReferenceValid && !this->Pairs.empty() && hardwareTimestampSec - this->ReferenceHardwareTimeSec < this->Pairs.back().HardwareTimeSec)
+  {
+    LOG_WARNING("Hardware clock of the device went backward, the clock estimation is restarted");
+    this->ResetEstimation();
+  }
+  if (!this->ReferenceValid)
+  {
+    this->ReferenceHardwareTimeSec = hardwareTimestampSec;
+    this->ReferenceArrivalTimeSec = arrivalSystemTimeSec;
+    this->ReferenceValid = true;
+  }
+
+  TimestampPair pair;
+  pair.HardwareTimeSec = hardwareTimestampSec - this->ReferenceHardwareTimeSec;
+  pair.ArrivalTimeSec = arrivalSystemTimeSec - this->ReferenceArrivalTimeSec;
+  this->Pairs.push_back(pair);
+  if (this->Pairs.size() > ESTIMATION_WINDOW_SIZE)
+  {
+    this->Pairs.pop_front();
+  }
+
+  // Rate by linear regression of the arrival times on the hardware times. The sums are computed relative to the
+  // oldest pair of the window, so that their precision does not decrease as the clocks advance.
+  const TimestampPair& oldest = this->Pairs.front();
+  double sumHardware = 0;
+  double sumArrival = 0;
+  double sumHardwareHardware = 0;
+  double sumHardwareArrival = 0;
+  for (std::deque<TimestampPair>::const_iterator pairIt = this->Pairs.begin(); pairIt != this->Pairs.end(); ++pairIt)
+  {
+    double hardwareSec = pairIt->HardwareTimeSec - oldest.HardwareTimeSec;
+    double arrivalSec = pairIt->ArrivalTimeSec - oldest.ArrivalTimeSec;
+    sumHardware += hardwareSec;
+    sumArrival += arrivalSec;
+    sumHardwareHardware += hardwareSec * hardwareSec;
+    sumHardwareArrival += hardwareSec * arrivalSec;
+  }
+  double n = static_cast<double>(this->Pairs.size());
+  double denominator = n * sumHardwareHardware - sumHardware * sumHardware;
+  double hardwareSpanSec = this->Pairs.back().HardwareTimeSec - oldest.HardwareTimeSec;
+  if (this->Pairs.size() >= MINIMUM_NUMBER_OF_PAIRS && denominator > 0 && hardwareSpanSec > 0)
+  {
+    double rate = (n * sumHardwareArrival - sumHardware * sumArrival) / denominator;
+    // A short window is dominated by the arrival jitter, only the unit of the device clock is estimated from it
+    if (hardwareSpanSec >= MINIMUM_RATE_ESTIMATION_SPAN_SEC || std::fabs(rate - 1.0) > 0.1)
+    {
+      this->EstimatedRate = rate;
+    }
+  }
+
+  // The regression is affected by the arrival jitter, so the rate is refined by the line through the items with the smallest
+  // delay in the first and in the second half of the window (their delays are nearly the same minimum transfer delay)
+  if (hardwareSpanSec >= MINIMUM_RATE_ESTIMATION_SPAN_SEC)
+  {
+    size_t halfSize = this->Pairs.size() / 2;
+    const TimestampPair* lowestPairs[2] = { NULL, NULL };
+    double lowestDelays[2] = { std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+    for (size_t pairIndex = 0; pairIndex < this->Pairs.size(); ++pairIndex)
+    {
+      const TimestampPair& currentPair = this->Pairs[pairIndex];
+      int half = (pairIndex < halfSize ? 0 : 1);
+      double delay = currentPair.ArrivalTimeSec - this->EstimatedRate * currentPair.HardwareTimeSec;
+      if (delay < lowestDelays[half])
+      {
+        lowestDelays[half] = delay;
+        lowestPairs[half] = &currentPair;
+      }
+    }
+    if (lowestPairs[0] != NULL && lowestPairs[1] != NULL
+        && lowestPairs[1]->HardwareTimeSec - lowestPairs[0]->HardwareTimeSec >= MINIMUM_RATE_ESTIMATION_SPAN_SEC / 2)
+    {
+      this->EstimatedRate = (lowestPairs[1]->ArrivalTimeSec - lowestPairs[0]->ArrivalTimeSec) / (lowestPairs[1]->HardwareTimeSec - lowestPairs[0]->HardwareTimeSec);
+    }
+  }
+
+  // Offset by the lower envelope: the items that arrived with the smallest delay
+  double offsetSec = std::numeric_limits<double>::max();
+  for (std::deque<TimestampPair>::const_iterator pairIt = this->Pairs.begin(); pairIt != this->Pairs.end(); ++pairIt)
+  {
+    offsetSec = std::min(offsetSec, pairIt->ArrivalTimeSec - this->EstimatedRate * pairIt->HardwareTimeSec);
+  }
+
+  double systemTimeSec = this->ReferenceArrivalTimeSec + this->EstimatedRate * pair.HardwareTimeSec + offsetSec;
+  if (this->Pairs.size() >= MINIMUM_NUMBER_OF_PAIRS && arrivalSystemTimeSec - systemTimeSec > this->MaximumArrivalDifferenceSec)
+  {
+    LOG_WARNING("Hardware timestamp of the device is inconsistent with the arrival time (difference: " << arrivalSystemTimeSec - systemTimeSec
+                << " s), the clock estimation is restarted");
+    this->ResetEstimation();
+    return arrivalSystemTimeSec;
+  }
+  return systemTimeSec;
+}
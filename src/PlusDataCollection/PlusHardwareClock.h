@@ -0,0 +1,133 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __HardwareClock_h
+#define __HardwareClock_h
+
+#include "vtkPlusDataCollectionExport.h"
+
+#include "PlusConfigure.h"
+
+#include <deque>
+#include <mutex>
+#include <string>
+
+class vtkXMLDataElement;
+
+/*!
+  \class HardwareClock
+  \brief Converts timestamps provided by the device (camera chunk data, driver buffer timestamps, tracker frame counters,
+  timestamps received from another computer) to Plus system time.
+
+  Host timestamps are taken when the data arrives, so they contain the jitter of the transfer and of the thread scheduling,
+  which the timestamp filtering of the buffer can only partially remove. Hardware timestamps are taken at acquisition,
+  so they are free of this jitter. The clock types:
+  - Device: free-running clock of the device. The rate and offset of the device clock relative to the system clock are
+    estimated continuously from the (hardware timestamp, arrival time) pairs of the recent items: the rate by linear regression,
+    the offset by the lower envelope of the arrival times (the items with the smallest transfer delay). So the clock drift is
+    followed and the converted timestamps are free of transfer jitter. The minimum transfer delay remains a constant offset,
+    which is compensated by the LocalTimeOffsetSec of the device (determined once by temporal calibration, as it does not drift).
+  - Ptp: absolute time of an IEEE-1588 (PTP) synchronized device clock, in the PTP timescale (TAI). The host clock must
+    be synchronized to the same grandmaster (e.g., by ptp4l and phc2sys on Linux). The timestamps are converted using the
+    current offset between the host UTC clock and the system time, and PtpUtcOffsetSec (TAI - UTC, 37 s since 2017).
+  - Utc: absolute UTC time of a clock that is synchronized to the host clock (e.g., timestamps received over OpenIGTLink
+    from a Plus server on another computer, where both computers are synchronized by PTP). Same as Ptp with zero offset.
+  With PTP-synchronized clocks the devices of multiple computers share one time base with sub-millisecond accuracy,
+  without temporal calibration runs or drifting calibrated offsets.
+
+  If a hardware timestamp is inconsistent with its arrival time (the device clock was reset, or the clocks are not
+  synchronized) by more than MaximumArrivalDifferenceSec then the estimation is restarted and a warning is logged.
+
+  The configuration is read from the device element: HardwareClock="None|Device|Ptp|Utc" and HardwareClockPtpUtcOffsetSec.
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport HardwareClock
+{
+public:
+  enum ClockType
+  {
+    CLOCK_NONE,
+    CLOCK_DEVICE,
+    CLOCK_PTP,
+    CLOCK_UTC
+  };
+
+  /*! Number of recent items that the device clock rate and offset are estimated from */
+  static const unsigned int ESTIMATION_WINDOW_SIZE = 500;
+  /*! The rate of the device clock is assumed to be exact until the estimation window spans at least this time */
+  static const double MINIMUM_RATE_ESTIMATION_SPAN_SEC;
+  /*! The current TAI - UTC offset, default value of PtpUtcOffsetSec */
+  static const double DEFAULT_PTP_UTC_OFFSET_SEC;
+
+  HardwareClock();
+
+  PlusStatus ReadConfiguration(vtkXMLDataElement* deviceElement);
+  PlusStatus WriteConfiguration(vtkXMLDataElement* deviceElement) const;
+
+  void SetClockType(ClockType type);
+  ClockType GetClockType() const;
+  bool IsEnabled() const { return this->GetClockType() != CLOCK_NONE; }
+
+  void SetPtpUtcOffsetSec(double offsetSec);
+  double GetPtpUtcOffsetSec() const;
+
+  /*! Maximum allowed difference between a converted timestamp and the arrival time of the item */
+  void SetMaximumArrivalDifferenceSec(double differenceSec);
+
+  /*! Restart the estimation of the device clock rate and offset (e.g., when the acquisition is restarted) */
+  void Reset();
+
+  /*!
+    Convert a hardware timestamp to system time. Called for each item in the order of acquisition.
+    The returned timestamps are increasing, they can be used as both unfiltered and filtered timestamps of the item.
+    Items with the same hardware timestamp as the previous item (same hardware sample) get the same timestamp.
+    \param hardwareTimestampSec Timestamp provided by the device, in seconds (the unit of the device clock must be converted by the caller)
+    \param arrivalSystemTimeSec System time when the item was received (vtkIGSIOAccurateTimer::GetSystemTime)
+    Returns the arrival time if the clock type is None.
+  */
+  double GetSystemTime(double hardwareTimestampSec, double arrivalSystemTimeSec);
+
+  /*! Estimated rate of the device clock relative to the system clock (system seconds per device second) */
+  double GetEstimatedRate() const;
+
+  /*! Current offset between the host UTC clock and the system time (UTC = system time + offset) */
+  static double GetUtcToSystemTimeOffsetSec();
+
+  static const char* GetClockTypeAsString(ClockType type);
+  static PlusStatus GetClockTypeFromString(const std::string& typeString, ClockType& type);
+
+protected:
+  struct TimestampPair
+  {
+    double HardwareTimeSec;
+    double ArrivalTimeSec;
+  };
+
+  double GetDeviceClockSystemTime(double hardwareTimestampSec, double arrivalSystemTimeSec);
+  void ResetEstimation();
+
+  /*! Protects all members, the clock may be used by the acquisition thread and read by other threads */
+  mutable std::mutex Mutex;
+  ClockType Type;
+  double PtpUtcOffsetSec;
+  double MaximumArrivalDifferenceSec;
+
+  /*! Recent timestamp pairs, relative to the first pair after the last reset */
+  std::deque<TimestampPair> Pairs;
+  bool ReferenceValid;
+  double ReferenceHardwareTimeSec;
+  double ReferenceArrivalTimeSec;
+  double EstimatedRate;
+  /*! Last returned timestamp, kept when the estimation is restarted so that the timestamps remain increasing */
+  double LastSystemTimeSec;
+  /*! Hardware timestamp of the last returned timestamp */
+  double LastHardwareTimestampSec;
+  /*! The PTP or UTC hardware timestamps are not synchronized with the system time, the arrival times are used */
+  bool UnsynchronizedReported;
+};
+
+#endif
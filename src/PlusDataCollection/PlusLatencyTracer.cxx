@@ -0,0 +1,400 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusLatencyTracer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+namespace
+{
+  /*! Number of recent items per data source for which the acquisition time is kept */
+  const size_t ITEM_TRACE_BUFFER_SIZE = 1024;
+  /*! Number of recent frames per channel that can be matched when they are sent */
+  const size_t MAX_NUMBER_OF_FRAME_TRACES_PER_CHANNEL = 1024;
+  const double FIRST_BIN_UPPER_LIMIT_SEC = 0.00025;
+
+  //----------------------------------------------------------------------------
+  std::string EscapeJsonString(const std::string& str)
+  {
+    std::string escaped;
+    for (std::string::const_iterator it = str.begin(); it != str.end(); ++it)
+    {
+      if (*it == '"' || *it == '\\')
+      {
+        escaped += '\\';
+      }
+      if (static_cast<unsigned char>(*it) < 0x20)
+      {
+        // control characters are not expected in names
+        escaped += ' ';
+        continue;
+      }
+      escaped += *it;
+    }
+    return escaped;
+  }
+
+  //----------------------------------------------------------------------------
+  void PrintHistogram(std::ostream& os, const std::string& name, const LatencyTracer::Histogram& histogram)
+  {
+    os << name << ": " << histogram.GetNumberOfSamples() << " frames";
+    if (histogram.GetNumberOfSamples() > 0)
+    {
+      os << std::fixed << std::setprecision(3)
+         << ", mean " << histogram.GetMeanSec() * 1000.0 << "ms"
+         << ", min " << histogram.GetMinimumSec() * 1000.0 << "ms"
+         << ", median " << histogram.GetPercentileSec(50) * 1000.0 << "ms"
+         << ", 95% " << histogram.GetPercentileSec(95) * 1000.0 << "ms"
+         << ", 99% " << histogram.GetPercentileSec(99) * 1000.0 << "ms"
+         << ", max " << histogram.GetMaximumSec() * 1000.0 << "ms"
+         << ", bins:";
+      os.unsetf(std::ios_base::floatfield);
+      for (int bin = 0; bin < LatencyTracer::Histogram::NUMBER_OF_BINS; ++bin)
+      {
+        if (histogram.GetBinCount(bin) == 0)
+        {
+          continue;
+        }
+        double upperLimitSec = LatencyTracer::Histogram::GetBinUpperLimitSec(bin);
+        if (upperLimitSec < 0)
+        {
+          os << " >" << LatencyTracer::Histogram::GetBinUpperLimitSec(bin - 1) * 1000.0 << "ms=" << histogram.GetBinCount(bin);
+        }
+        else
+        {
+          os << " <=" << upperLimitSec * 1000.0 << "ms=" << histogram.GetBinCount(bin);
+        }
+      }
+    }
+    os << std::endl;
+  }
+}
+
+std::atomic<bool> LatencyTracer::Enabled(false);
+
+//----------------------------------------------------------------------------
+LatencyTracer::Histogram::Histogram()
+{
+  this->Reset();
+}
+
+//----------------------------------------------------------------------------
+void LatencyTracer::Histogram::Reset()
+{
+  std::fill(this->BinCounts, this->BinCounts + NUMBER_OF_BINS, 0);
+  this->NumberOfSamples = 0;
+  this->SumSec = 0;
+  this->MinimumSec = 0;
+  this->MaximumSec = 0;
+}
+
+//----------------------------------------------------------------------------
+void LatencyTracer::Histogram::AddSample(double latencySec)
+{
+  int bin = 0;
+  while (bin < NUMBER_OF_BINS - 1 && latencySec > GetBinUpperLimitSec(bin))
+  {
+    ++bin;
+  }
+  this->BinCounts[bin]++;
+  if (this->NumberOfSamples == 0 || latencySec < this->MinimumSec)
+  {
+    this->MinimumSec = latencySec;
+  }
+  if (this->NumberOfSamples == 0 || latencySec > this->MaximumSec)
+  {
+    this->MaximumSec = latencySec;
+  }
+  this->NumberOfSamples++;
+  this->SumSec += latencySec;
+}
+
+//----------------------------------------------------------------------------
+double LatencyTracer::Histogram::GetMeanSec() const
+{
+  if (this->NumberOfSamples == 0)
+  {
+    return 0;
+  }
+  return this->SumSec / this->NumberOfSamples;
+}
+
+//----------------------------------------------------------------------------
+double LatencyTracer::Histogram::GetPercentileSec(double percent) const
+{
+  if (this->NumberOfSamples == 0)
+  {
+    return 0;
+  }
+  double requiredCount = this->NumberOfSamples * percent / 100.0;
+  unsigned long count = 0;
+  for (int bin = 0; bin < NUMBER_OF_BINS; ++bin)
+  {
+    count += this->BinCounts[bin];
+    if (count > 0 && count >= requiredCount)
+    {
+      double upperLimitSec = GetBinUpperLimitSec(bin);
+      if (upperLimitSec < 0 || upperLimitSec > this->MaximumSec)
+      {
+        return this->MaximumSec;
+      }
+      return upperLimitSec;
+    }
+  }
+  return this->MaximumSec;
+}
+
+//----------------------------------------------------------------------------
+double LatencyTracer::Histogram::GetBinUpperLimitSec(int bin)
+{
+  if (bin >= NUMBER_OF_BINS - 1)
+  {
+    return -1;
+  }
+  return FIRST_BIN_UPPER_LIMIT_SEC * (1 << bin);
+}
+
+//----------------------------------------------------------------------------
+LatencyTracer& LatencyTracer::GetInstance()
+{
+  static LatencyTracer instance;
+  return instance;
+}
+
+//----------------------------------------------------------------------------
+LatencyTracer::LatencyTracer()
+{
+}
+
+//----------------------------------------------------------------------------
+LatencyTracer::~LatencyTracer()
+{
+}
+
+//----------------------------------------------------------------------------
+void LatencyTracer::SetEnabled(bool enabled)
+{
+  Enabled = enabled;
+}
+
+//----------------------------------------------------------------------------
+void LatencyTracer::Reset()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->ItemTraces.clear();
+  this->FrameTraces.clear();
+  this->ChannelHistograms.clear();
+  this->ChannelSentHistograms.clear();
+  this->ClientHistogramsById.clear();
+  this->TraceEvents.clear();
+  this->TrackNames.clear();
+  this->TrackIndices.clear();
+}
+
+//----------------------------------------------------------------------------
+void LatencyTracer::RecordItemAdded(const void* sourceId, BufferItemUidType uid)
+{
+  double acquiredTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  std::vector<ItemTrace>& itemTraces = this->ItemTraces[sourceId];
+  if (itemTraces.empty())
+  {
+    itemTraces.resize(ITEM_TRACE_BUFFER_SIZE);
+  }
+  ItemTrace& itemTrace = itemTraces[uid % ITEM_TRACE_BUFFER_SIZE];
+  itemTrace.Uid = uid;
+  itemTrace.AcquiredTime = acquiredTime;
+}
+
+//----------------------------------------------------------------------------
+void LatencyTracer::RecordFrameAssembled(const std::string& channelId, const void* sourceId, BufferItemUidType uid, double frameTimestamp)
+{
+  double assembledTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  std::map<const void*, std::vector<ItemTrace> >::iterator itemTracesIt = this->ItemTraces.find(sourceId);
+  if (itemTracesIt == this->ItemTraces.end())
+  {
+    return;
+  }
+  const ItemTrace& itemTrace = itemTracesIt->second[uid % ITEM_TRACE_BUFFER_SIZE];
+  if (itemTrace.Uid != uid)
+  {
+    // the item was added before tracing was enabled or it is too old
+    return;
+  }
+
+  std::map<double, FrameTrace>& frameTraces = this->FrameTraces[channelId];
+  if (frameTraces.find(frameTimestamp) != frameTraces.end())
+  {
+    // already assembled for another consumer
+    return;
+  }
+  FrameTrace& frameTrace = frameTraces[frameTimestamp];
+  frameTrace.Uid = uid;
+  frameTrace.AcquiredTime = itemTrace.AcquiredTime;
+  frameTrace.AssembledTime = assembledTime;
+  while (frameTraces.size() > MAX_NUMBER_OF_FRAME_TRACES_PER_CHANNEL)
+  {
+    frameTraces.erase(frameTraces.begin());
+  }
+
+  this->ChannelHistograms[channelId].AddSample(assembledTime - itemTrace.AcquiredTime);
+  this->AddTraceEvent("Channel " + channelId, "Assembly", uid, itemTrace.AcquiredTime, assembledTime);
+}
+
+//----------------------------------------------------------------------------
+void LatencyTracer::RecordFrameSent(const std::string& channelId, int clientId, double frameTimestamp, double packStartTime, double packedTime, double sentTime)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  std::map<std::string, std::map<double, FrameTrace> >::iterator frameTracesIt = this->FrameTraces.find(channelId);
+  if (frameTracesIt == this->FrameTraces.end())
+  {
+    return;
+  }
+  std::map<double, FrameTrace>::iterator frameTraceIt = frameTracesIt->second.find(frameTimestamp);
+  if (frameTraceIt == frameTracesIt->second.end())
+  {
+    return;
+  }
+  const FrameTrace& frameTrace = frameTraceIt->second;
+
+  ClientHistograms& histograms = this->ClientHistogramsById[clientId];
+  histograms.Pack.AddSample(packedTime - packStartTime);
+  histograms.Send.AddSample(sentTime - packedTime);
+  histograms.Total.AddSample(sentTime - frameTrace.AcquiredTime);
+  this->ChannelSentHistograms[channelId].AddSample(sentTime - frameTrace.AcquiredTime);
+
+  std::ostringstream trackName;
+  trackName << "Client " << clientId;
+  if (packStartTime > frameTrace.AssembledTime)
+  {
+    this->AddTraceEvent(trackName.str(), "Queue", frameTrace.Uid, frameTrace.AssembledTime, packStartTime);
+  }
+  this->AddTraceEvent(trackName.str(), "Pack", frameTrace.Uid, packStartTime, packedTime);
+  this->AddTraceEvent(trackName.str(), "Send", frameTrace.Uid, packedTime, sentTime);
+}
+
+//----------------------------------------------------------------------------
+void LatencyTracer::AddTraceEvent(const std::string& trackName, const char* name, BufferItemUidType uid, double startTime, double endTime)
+{
+  std::map<std::string, int>::iterator trackIt = this->TrackIndices.find(trackName);
+  if (trackIt == this->TrackIndices.end())
+  {
+    trackIt = this->TrackIndices.insert(std::make_pair(trackName, static_cast<int>(this->TrackNames.size()))).first;
+    this->TrackNames.push_back(trackName);
+  }
+  TraceEvent traceEvent;
+  traceEvent.TrackIndex = trackIt->second;
+  traceEvent.Name = name;
+  traceEvent.Uid = uid;
+  traceEvent.StartTime = startTime;
+  traceEvent.Duration = endTime - startTime;
+  this->TraceEvents.push_back(traceEvent);
+  while (this->TraceEvents.size() > MAX_NUMBER_OF_TRACE_EVENTS)
+  {
+    this->TraceEvents.pop_front();
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus LatencyTracer::GetChannelHistogram(const std::string& channelId, Histogram& histogram)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  std::map<std::string, Histogram>::iterator histogramIt = this->ChannelHistograms.find(channelId);
+  if (histogramIt == this->ChannelHistograms.end())
+  {
+    return PLUS_FAIL;
+  }
+  histogram = histogramIt->second;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus LatencyTracer::GetChannelSentHistogram(const std::string& channelId, Histogram& histogram)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  std::map<std::string, Histogram>::iterator histogramIt = this->ChannelSentHistograms.find(channelId);
+  if (histogramIt == this->ChannelSentHistograms.end())
+  {
+    return PLUS_FAIL;
+  }
+  histogram = histogramIt->second;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus LatencyTracer::GetClientHistograms(int clientId, ClientHistograms& histograms)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  std::map<int, ClientHistograms>::iterator histogramsIt = this->ClientHistogramsById.find(clientId);
+  if (histogramsIt == this->ClientHistogramsById.end())
+  {
+    return PLUS_FAIL;
+  }
+  histograms = histogramsIt->second;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+std::string LatencyTracer::GetStatisticsAsText()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  std::ostringstream os;
+  os << "Latency tracing is " << (IsEnabled() ? "enabled" : "disabled") << std::endl;
+  for (std::map<std::string, Histogram>::iterator it = this->ChannelHistograms.begin(); it != this->ChannelHistograms.end(); ++it)
+  {
+    PrintHistogram(os, "Channel " + it->first + " acquisition to assembly", it->second);
+  }
+  for (std::map<int, ClientHistograms>::iterator it = this->ClientHistogramsById.begin(); it != this->ClientHistogramsById.end(); ++it)
+  {
+    std::ostringstream clientName;
+    clientName << "Client " << it->first;
+    PrintHistogram(os, clientName.str() + " packing", it->second.Pack);
+    PrintHistogram(os, clientName.str() + " sending", it->second.Send);
+    PrintHistogram(os, clientName.str() + " acquisition to sent", it->second.Total);
+  }
+  return os.str();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus LatencyTracer::WriteChromeTrace(const std::string& filename)
+{
+  std::ofstream file(filename.c_str(), std::ios::out | std::ios::trunc);
+  if (!file.is_open())
+  {
+    LOG_ERROR("Failed to open latency trace file for writing: " << filename);
+    return PLUS_FAIL;
+  }
+
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+  bool firstEvent = true;
+  for (size_t trackIndex = 0; trackIndex < this->TrackNames.size(); ++trackIndex)
+  {
+    file << (firstEvent ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << trackIndex
+         << ",\"args\":{\"name\":\"" << EscapeJsonString(this->TrackNames[trackIndex]) << "\"}}";
+    firstEvent = false;
+  }
+  // Timestamps and durations are in microseconds
+  file << std::fixed << std::setprecision(1);
+  for (std::deque<TraceEvent>::iterator it = this->TraceEvents.begin(); it != this->TraceEvents.end(); ++it)
+  {
+    file << (firstEvent ? "" : ",\n") << "{\"name\":\"" << it->Name << "\",\"cat\":\"latency\",\"ph\":\"X\",\"pid\":1,\"tid\":" << it->TrackIndex
+         << ",\"ts\":" << it->StartTime * 1e6 << ",\"dur\":" << it->Duration * 1e6 << ",\"args\":{\"uid\":" << it->Uid << "}}";
+    firstEvent = false;
+  }
+  file << std::endl << "]}" << std::endl;
+
+  if (!file.good())
+  {
+    LOG_ERROR("Failed to write latency trace file: " << filename);
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
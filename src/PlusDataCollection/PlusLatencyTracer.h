@@ -0,0 +1,178 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __LatencyTracer_h
+#define __LatencyTracer_h
+
+#include "vtkPlusDataCollectionExport.h"
+
+#include "PlusConfigure.h"
+#include "PlusStreamBufferItem.h"
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*!
+  \class LatencyTracer
+  \brief Records when each frame passes the stages between acquisition and sending to the OpenIGTLink clients.
+
+  Trace points (all in system time, see vtkIGSIOAccurateTimer::GetSystemTime):
+  \li Acquired: the device added the item to its data source (any data source, identified by the data source pointer and the buffer UID)
+  \li Assembled: the channel assembled the tracked frame from the item of its video source (or timestamp master tool)
+  \li PackStarted, Packed: the server started and completed packing the frame into messages for a client
+  \li Sent: all messages of the frame were sent to the client
+
+  The latencies are collected in per-channel (acquisition to assembly) and per-client (packing, sending,
+  acquisition to sending) histograms and the recent frames can be saved in Chrome trace event format
+  (that can be opened in chrome://tracing or https://ui.perfetto.dev).
+
+  Tracing is disabled by default. When disabled, each trace point only checks an atomic flag.
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport LatencyTracer
+{
+public:
+  /*! Latency histogram with logarithmic bins, from 0.25ms to 1s */
+  class vtkPlusDataCollectionExport Histogram
+  {
+  public:
+    static const int NUMBER_OF_BINS = 14;
+
+    Histogram();
+    void AddSample(double latencySec);
+    void Reset();
+
+    unsigned long GetNumberOfSamples() const { return this->NumberOfSamples; }
+    double GetMinimumSec() const { return this->MinimumSec; }
+    double GetMaximumSec() const { return this->MaximumSec; }
+    double GetMeanSec() const;
+    /*! Approximate percentile (upper limit of the bin that contains it, but not more than the maximum). Percent is between 0 and 100. */
+    double GetPercentileSec(double percent) const;
+    unsigned long GetBinCount(int bin) const { return this->BinCounts[bin]; }
+
+    /*! Upper limit of the bin, the last bin has no upper limit (returns a negative value) */
+    static double GetBinUpperLimitSec(int bin);
+
+  protected:
+    unsigned long BinCounts[NUMBER_OF_BINS];
+    unsigned long NumberOfSamples;
+    double SumSec;
+    double MinimumSec;
+    double MaximumSec;
+  };
+
+  /*! Latencies of the frames sent to a client */
+  struct ClientHistograms
+  {
+    /*! From start to end of packing the messages */
+    Histogram Pack;
+    /*! From end of packing to all messages sent */
+    Histogram Send;
+    /*! From acquisition to all messages sent */
+    Histogram Total;
+  };
+
+  static LatencyTracer& GetInstance();
+
+  /*! Fast check whether trace points have to be recorded */
+  static bool IsEnabled() { return Enabled.load(std::memory_order_relaxed); }
+
+  /*! Enable or disable tracing. Recorded statistics are kept when disabled. */
+  void SetEnabled(bool enabled);
+
+  /*! Remove all recorded trace points and statistics */
+  void Reset();
+
+  /*! Record that an item was added to a data source */
+  void RecordItemAdded(const void* sourceId, BufferItemUidType uid);
+
+  /*!
+    Record that a channel assembled a tracked frame from an item of a data source.
+    Frames are recorded only once, even if multiple consumers request them.
+    \param frameTimestamp Timestamp of the tracked frame, used for identifying the frame when it is sent
+  */
+  void RecordFrameAssembled(const std::string& channelId, const void* sourceId, BufferItemUidType uid, double frameTimestamp);
+
+  /*! Record that a tracked frame of a channel was packed and sent to a client. Ignored if the assembly of the frame was not recorded. */
+  void RecordFrameSent(const std::string& channelId, int clientId, double frameTimestamp, double packStartTime, double packedTime, double sentTime);
+
+  /*! Get the acquisition to assembly latencies of a channel. Returns PLUS_FAIL if no frame was recorded for the channel. */
+  PlusStatus GetChannelHistogram(const std::string& channelId, Histogram& histogram);
+
+  /*! Get the acquisition to sending latencies of the frames of a channel, for all clients. Returns PLUS_FAIL if no frame of the channel was sent. */
+  PlusStatus GetChannelSentHistogram(const std::string& channelId, Histogram& histogram);
+
+  /*! Get the latencies of the frames sent to a client. Returns PLUS_FAIL if no frame was recorded for the client. */
+  PlusStatus GetClientHistograms(int clientId, ClientHistograms& histograms);
+
+  /*! Summary of all histograms (number of samples, mean, percentiles) in a human readable text */
+  std::string GetStatisticsAsText();
+
+  /*! Save the recently recorded frames in Chrome trace event JSON format */
+  PlusStatus WriteChromeTrace(const std::string& filename);
+
+  /*! Maximum number of trace events kept for WriteChromeTrace */
+  static const size_t MAX_NUMBER_OF_TRACE_EVENTS = 100000;
+
+protected:
+  LatencyTracer();
+  virtual ~LatencyTracer();
+
+  /*! Acquisition time of an item, stored in a circular buffer indexed by the UID */
+  struct ItemTrace
+  {
+    ItemTrace() : Uid(0), AcquiredTime(0) {}
+    BufferItemUidType Uid;
+    double AcquiredTime;
+  };
+
+  struct FrameTrace
+  {
+    FrameTrace() : Uid(0), AcquiredTime(0), AssembledTime(0) {}
+    BufferItemUidType Uid;
+    double AcquiredTime;
+    double AssembledTime;
+  };
+
+  /*! Span in the Chrome trace */
+  struct TraceEvent
+  {
+    int TrackIndex;
+    const char* Name;
+    BufferItemUidType Uid;
+    double StartTime;
+    double Duration;
+  };
+
+  /*! Add a trace event to the track with the specified name. Mutex must be locked. */
+  void AddTraceEvent(const std::string& trackName, const char* name, BufferItemUidType uid, double startTime, double endTime);
+
+  static std::atomic<bool> Enabled;
+
+  /*! Protects all the members below */
+  std::mutex Mutex;
+  std::map<const void*, std::vector<ItemTrace> > ItemTraces;
+  /*! Recently assembled frames of each channel, by frame timestamp */
+  std::map<std::string, std::map<double, FrameTrace> > FrameTraces;
+  std::map<std::string, Histogram> ChannelHistograms;
+  /*! Acquisition to sending latencies of each channel */
+  std::map<std::string, Histogram> ChannelSentHistograms;
+  std::map<int, ClientHistograms> ClientHistogramsById;
+  std::deque<TraceEvent> TraceEvents;
+  std::vector<std::string> TrackNames;
+  std::map<std::string, int> TrackIndices;
+
+private:
+  LatencyTracer(const LatencyTracer&);
+  void operator=(const LatencyTracer&);
+};
+
+#endif
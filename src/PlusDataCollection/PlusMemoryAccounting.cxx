@@ -0,0 +1,296 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusMemoryAccounting.h"
+
+// IGSIO includes
+#include <igsioTrackedFrame.h>
+#include <igsioVideoFrame.h>
+#include <vtkIGSIOTrackedFrameList.h>
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkStreamingVolumeFrame.h>
+#include <vtkUnsignedCharArray.h>
+
+#include <chrono>
+#include <sstream>
+
+namespace
+{
+  const double MONITOR_CHECK_INTERVAL_SEC = 1.0;
+  const double BYTES_PER_MB = 1024.0 * 1024.0;
+
+  //----------------------------------------------------------------------------
+  std::string GetUsageDescription(const MemoryAccounting::Usage& usage)
+  {
+    std::ostringstream os;
+    os << usage.Component;
+    for (MetricsRegistry::Labels::const_iterator labelIt = usage.UsageLabels.begin(); labelIt != usage.UsageLabels.end(); ++labelIt)
+    {
+      os << (labelIt == usage.UsageLabels.begin() ? " (" : ", ") << labelIt->first << "=" << labelIt->second;
+    }
+    if (!usage.UsageLabels.empty())
+    {
+      os << ")";
+    }
+    return os.str();
+  }
+}
+
+//----------------------------------------------------------------------------
+MemoryAccounting::MemoryAccounting()
+  : NextReporterId(1)
+  , MetricsCollectorId(0)
+  , SoftLimitBytes(0)
+  , SoftLimitExceeded(false)
+  , MonitorStopRequested(false)
+{
+  this->MetricsCollectorId = MetricsRegistry::GetInstance().AddCollector([this](std::vector<MetricsRegistry::Sample>& samples)
+  {
+    this->CollectMetrics(samples);
+  });
+}
+
+//----------------------------------------------------------------------------
+MemoryAccounting::~MemoryAccounting()
+{
+  this->StopMonitor();
+  MetricsRegistry::GetInstance().RemoveCollector(this->MetricsCollectorId);
+}
+
+//----------------------------------------------------------------------------
+MemoryAccounting& MemoryAccounting::GetInstance()
+{
+  static MemoryAccounting instance;
+  return instance;
+}
+
+//----------------------------------------------------------------------------
+int MemoryAccounting::AddReporter(Reporter reporter, PressureHandler pressureHandler/*=PressureHandler()*/)
+{
+  std::lock_guard<std::mutex> lock(this->ReporterMutex);
+  int reporterId = this->NextReporterId++;
+  RegisteredReporter& registeredReporter = this->Reporters[reporterId];
+  registeredReporter.ReportUsage = reporter;
+  registeredReporter.RelievePressure = pressureHandler;
+  return reporterId;
+}
+
+//----------------------------------------------------------------------------
+void MemoryAccounting::RemoveReporter(int reporterId)
+{
+  // Waits until the reporters complete if the usage is being queried
+  std::lock_guard<std::mutex> lock(this->ReporterMutex);
+  this->Reporters.erase(reporterId);
+}
+
+//----------------------------------------------------------------------------
+void MemoryAccounting::GetUsage(std::vector<Usage>& usages)
+{
+  std::lock_guard<std::mutex> lock(this->ReporterMutex);
+  this->GetUsageLocked(usages);
+}
+
+//----------------------------------------------------------------------------
+void MemoryAccounting::GetUsageLocked(std::vector<Usage>& usages)
+{
+  usages.clear();
+  for (std::map<int, RegisteredReporter>::const_iterator reporterIt = this->Reporters.begin(); reporterIt != this->Reporters.end(); ++reporterIt)
+  {
+    reporterIt->second.ReportUsage(usages);
+  }
+}
+
+//----------------------------------------------------------------------------
+size_t MemoryAccounting::GetTotalBytes()
+{
+  std::vector<Usage> usages;
+  this->GetUsage(usages);
+  size_t totalBytes = 0;
+  for (std::vector<Usage>::const_iterator usageIt = usages.begin(); usageIt != usages.end(); ++usageIt)
+  {
+    totalBytes += usageIt->Bytes;
+  }
+  return totalBytes;
+}
+
+//----------------------------------------------------------------------------
+void MemoryAccounting::SetSoftLimitBytes(size_t limitBytes)
+{
+  this->SoftLimitBytes.store(limitBytes, std::memory_order_relaxed);
+  if (limitBytes > 0)
+  {
+    LOG_INFO("Memory usage soft limit: " << static_cast<double>(limitBytes) / BYTES_PER_MB << " MB");
+    this->StartMonitor();
+  }
+  else
+  {
+    this->StopMonitor();
+    this->SoftLimitExceeded.store(false, std::memory_order_relaxed);
+  }
+}
+
+//----------------------------------------------------------------------------
+void MemoryAccounting::CheckSoftLimit()
+{
+  size_t limitBytes = this->GetSoftLimitBytes();
+  if (limitBytes == 0)
+  {
+    this->SoftLimitExceeded.store(false, std::memory_order_relaxed);
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(this->ReporterMutex);
+  std::vector<Usage> usages;
+  this->GetUsageLocked(usages);
+  size_t totalBytes = 0;
+  const Usage* largestUsage = NULL;
+  for (std::vector<Usage>::const_iterator usageIt = usages.begin(); usageIt != usages.end(); ++usageIt)
+  {
+    totalBytes += usageIt->Bytes;
+    if (largestUsage == NULL || usageIt->Bytes > largestUsage->Bytes)
+    {
+      largestUsage = &(*usageIt);
+    }
+  }
+
+  bool exceeded = (totalBytes > limitBytes);
+  bool wasExceeded = this->SoftLimitExceeded.exchange(exceeded, std::memory_order_relaxed);
+  if (exceeded && !wasExceeded)
+  {
+    LOG_WARNING("Memory usage (" << static_cast<double>(totalBytes) / BYTES_PER_MB << " MB) exceeds the soft limit of " << static_cast<double>(limitBytes) / BYTES_PER_MB
+                << " MB, largest user: " << GetUsageDescription(*largestUsage) << " with " << static_cast<double>(largestUsage->Bytes) / BYTES_PER_MB << " MB."
+                << " Buffers are shrunk and frames are dropped until the usage decreases.");
+  }
+  else if (!exceeded && wasExceeded)
+  {
+    LOG_INFO("Memory usage (" << static_cast<double>(totalBytes) / BYTES_PER_MB << " MB) is below the soft limit again");
+  }
+  if (!exceeded)
+  {
+    return;
+  }
+
+  for (std::map<int, RegisteredReporter>::const_iterator reporterIt = this->Reporters.begin(); reporterIt != this->Reporters.end(); ++reporterIt)
+  {
+    if (reporterIt->second.RelievePressure)
+    {
+      reporterIt->second.RelievePressure(totalBytes - limitBytes);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+size_t MemoryAccounting::GetVideoFrameSizeBytes(igsioVideoFrame& frame)
+{
+  if (frame.IsFrameEncoded())
+  {
+    vtkStreamingVolumeFrame* encodedFrame = frame.GetEncodedFrame();
+    if (encodedFrame == NULL || encodedFrame->GetFrameData() == NULL)
+    {
+      return 0;
+    }
+    return static_cast<size_t>(encodedFrame->GetFrameData()->GetNumberOfValues());
+  }
+  vtkImageData* image = frame.GetImage();
+  if (image == NULL || image->GetPointData()->GetScalars() == NULL)
+  {
+    return 0;
+  }
+  vtkDataArray* scalars = image->GetPointData()->GetScalars();
+  return static_cast<size_t>(scalars->GetNumberOfValues()) * scalars->GetDataTypeSize();
+}
+
+//----------------------------------------------------------------------------
+size_t MemoryAccounting::GetTrackedFrameListSizeBytes(vtkIGSIOTrackedFrameList* frameList)
+{
+  if (frameList == NULL)
+  {
+    return 0;
+  }
+  size_t sizeBytes = 0;
+  for (unsigned int frameIndex = 0; frameIndex < frameList->GetNumberOfTrackedFrames(); ++frameIndex)
+  {
+    igsioTrackedFrame* trackedFrame = frameList->GetTrackedFrame(frameIndex);
+    if (trackedFrame != NULL && trackedFrame->GetImageData() != NULL)
+    {
+      sizeBytes += GetVideoFrameSizeBytes(*trackedFrame->GetImageData());
+    }
+  }
+  return sizeBytes;
+}
+
+//----------------------------------------------------------------------------
+void MemoryAccounting::CollectMetrics(std::vector<MetricsRegistry::Sample>& samples)
+{
+  std::vector<Usage> usages;
+  this->GetUsage(usages);
+  size_t totalBytes = 0;
+  for (std::vector<Usage>::const_iterator usageIt = usages.begin(); usageIt != usages.end(); ++usageIt)
+  {
+    MetricsRegistry::Labels labels = usageIt->UsageLabels;
+    labels["component"] = usageIt->Component;
+    samples.push_back(MetricsRegistry::Sample("plus_memory_bytes", "Memory used by buffers, recorded frames, volumes and send queues",
+                      MetricsRegistry::METRIC_GAUGE, labels, static_cast<double>(usageIt->Bytes)));
+    totalBytes += usageIt->Bytes;
+  }
+  samples.push_back(MetricsRegistry::Sample("plus_memory_total_bytes", "Sum of the accounted memory usage",
+                    MetricsRegistry::METRIC_GAUGE, MetricsRegistry::Labels(), static_cast<double>(totalBytes)));
+  samples.push_back(MetricsRegistry::Sample("plus_memory_soft_limit_bytes", "Soft limit of the accounted memory usage, 0 if there is no limit",
+                    MetricsRegistry::METRIC_GAUGE, MetricsRegistry::Labels(), static_cast<double>(this->GetSoftLimitBytes())));
+  samples.push_back(MetricsRegistry::Sample("plus_memory_soft_limit_exceeded", "1 if the accounted memory usage was above the soft limit at the latest check",
+                    MetricsRegistry::METRIC_GAUGE, MetricsRegistry::Labels(), this->IsSoftLimitExceeded() ? 1.0 : 0.0));
+}
+
+//----------------------------------------------------------------------------
+void MemoryAccounting::StartMonitor()
+{
+  std::lock_guard<std::mutex> lock(this->MonitorMutex);
+  if (this->MonitorThread.joinable())
+  {
+    return;
+  }
+  this->MonitorStopRequested = false;
+  this->MonitorThread = std::thread(&MemoryAccounting::MonitorLoop, this);
+}
+
+//----------------------------------------------------------------------------
+void MemoryAccounting::StopMonitor()
+{
+  std::thread monitorThread;
+  {
+    std::lock_guard<std::mutex> lock(this->MonitorMutex);
+    if (!this->MonitorThread.joinable())
+    {
+      return;
+    }
+    this->MonitorStopRequested = true;
+    monitorThread.swap(this->MonitorThread);
+  }
+  this->MonitorCondition.notify_all();
+  monitorThread.join();
+}
+
+//----------------------------------------------------------------------------
+void MemoryAccounting::MonitorLoop()
+{
+  std::unique_lock<std::mutex> lock(this->MonitorMutex);
+  while (!this->MonitorStopRequested)
+  {
+    if (this->MonitorCondition.wait_for(lock, std::chrono::duration<double>(MONITOR_CHECK_INTERVAL_SEC), [this] { return this->MonitorStopRequested; }))
+    {
+      break;
+    }
+    // The reporters may take a while, so the monitor state is not locked while they run
+    lock.unlock();
+    this->CheckSoftLimit();
+    lock.lock();
+  }
+}
@@ -0,0 +1,137 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __MemoryAccounting_h
+#define __MemoryAccounting_h
+
+#include "vtkPlusDataCollectionExport.h"
+
+#include "PlusConfigure.h"
+#include "PlusMetricsRegistry.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class igsioVideoFrame;
+class vtkIGSIOTrackedFrameList;
+
+/*!
+  \class MemoryAccounting
+  \brief Process-wide accounting of the memory used by buffers, recorded frames, volumes and send queues, with an optional soft limit.
+
+  Objects that hold large amounts of data register a reporter function that lists their current memory usage.
+  Each usage entry is attributed to a component (e.g., "buffer", "capture_recorded_frames", "volume", "client_send_queue")
+  and labels that identify the owner (device, source, client). The entries are exported as the plus_memory_bytes metric
+  (together with the total and the soft limit), so they can be queried by the GetMetrics command.
+
+  If a soft limit is set then a monitor thread compares the total usage with the limit every second.
+  While the limit is exceeded IsSoftLimitExceeded returns true, so that producers can drop frames instead of queuing them,
+  and the pressure handlers of the reporters are called to release memory (e.g., by shrinking buffers).
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport MemoryAccounting
+{
+public:
+  /*! Memory used by a component of an object */
+  struct Usage
+  {
+    Usage() : Bytes(0) {}
+    Usage(const std::string& component, const MetricsRegistry::Labels& labels, size_t bytes)
+      : Component(component), UsageLabels(labels), Bytes(bytes) {}
+    std::string Component;
+    MetricsRegistry::Labels UsageLabels;
+    size_t Bytes;
+  };
+
+  /*! Function that appends the current memory usage of an object to the list */
+  typedef std::function<void(std::vector<Usage>&)> Reporter;
+
+  /*! Function that tries to release memory while the soft limit is exceeded, the parameter is the number of bytes above the limit */
+  typedef std::function<void(size_t)> PressureHandler;
+
+  static MemoryAccounting& GetInstance();
+
+  /*!
+    Add a reporter function, returns an identifier that can be used for removing the reporter
+    \param pressureHandler Called by the monitor thread while the soft limit is exceeded, may be empty
+  */
+  int AddReporter(Reporter reporter, PressureHandler pressureHandler = PressureHandler());
+
+  /*! Remove a reporter. When the method returns the reporter and its pressure handler are not running and will not be called anymore. */
+  void RemoveReporter(int reporterId);
+
+  /*! Get the current memory usage of all the reporters */
+  void GetUsage(std::vector<Usage>& usages);
+
+  /*! Get the sum of the current memory usage of all the reporters */
+  size_t GetTotalBytes();
+
+  /*! Set the soft limit of the total usage in bytes. 0 (default) means no limit. The monitor thread runs while a limit is set. */
+  void SetSoftLimitBytes(size_t limitBytes);
+  size_t GetSoftLimitBytes() const { return this->SoftLimitBytes.load(std::memory_order_relaxed); }
+
+  /*! True if the total usage was above the soft limit at the latest check. Lock-free, so it can be called in acquisition and sending loops. */
+  bool IsSoftLimitExceeded() const { return this->SoftLimitExceeded.load(std::memory_order_relaxed); }
+
+  /*! Compare the total usage with the soft limit and call the pressure handlers if it is exceeded. Called periodically by the monitor thread. */
+  void CheckSoftLimit();
+
+  /*! Size of the pixel data of a frame (encoded or not), in bytes */
+  static size_t GetVideoFrameSizeBytes(igsioVideoFrame& frame);
+
+  /*! Size of the pixel data of all the frames of a list, in bytes */
+  static size_t GetTrackedFrameListSizeBytes(vtkIGSIOTrackedFrameList* frameList);
+
+protected:
+  MemoryAccounting();
+  virtual ~MemoryAccounting();
+
+  /*! Append the usage, the total and the soft limit to the metrics */
+  void CollectMetrics(std::vector<MetricsRegistry::Sample>& samples);
+
+  /*! Must be called with ReporterMutex locked */
+  void GetUsageLocked(std::vector<Usage>& usages);
+
+  void StartMonitor();
+  void StopMonitor();
+  void MonitorLoop();
+
+  struct RegisteredReporter
+  {
+    Reporter ReportUsage;
+    PressureHandler RelievePressure;
+  };
+
+  /*! Protects the reporters and is locked while the reporters or the pressure handlers are running */
+  std::mutex ReporterMutex;
+  std::map<int, RegisteredReporter> Reporters;
+  int NextReporterId;
+
+  /*! Identifier of the metrics collector of the accounting */
+  int MetricsCollectorId;
+
+  std::atomic<size_t> SoftLimitBytes;
+  std::atomic<bool> SoftLimitExceeded;
+
+  /*! Protects the monitor thread state */
+  std::mutex MonitorMutex;
+  std::condition_variable MonitorCondition;
+  std::thread MonitorThread;
+  bool MonitorStopRequested;
+
+private:
+  MemoryAccounting(const MemoryAccounting&);
+  void operator=(const MemoryAccounting&);
+};
+
+#endif
@@ -0,0 +1,294 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusMetricsRegistry.h"
+
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+#if defined(_WIN32)
+  #include <windows.h>
+#else
+  #include <time.h>
+#endif
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  const char* GetPrometheusTypeName(MetricsRegistry::MetricType type)
+  {
+    switch (type)
+    {
+      case MetricsRegistry::METRIC_COUNTER:
+        return "counter";
+      case MetricsRegistry::METRIC_SUMMARY:
+        return "summary";
+      default:
+        return "gauge";
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  std::string EscapeLabelValue(const std::string& str)
+  {
+    std::string escaped;
+    for (std::string::const_iterator it = str.begin(); it != str.end(); ++it)
+    {
+      if (*it == '\n')
+      {
+        escaped += "\\n";
+        continue;
+      }
+      if (*it == '"' || *it == '\\')
+      {
+        escaped += '\\';
+      }
+      escaped += *it;
+    }
+    return escaped;
+  }
+
+  //----------------------------------------------------------------------------
+  void PrintSampleLine(std::ostream& os, const std::string& name, const MetricsRegistry::Labels& labels, double value)
+  {
+    os << name;
+    if (!labels.empty())
+    {
+      os << "{";
+      for (MetricsRegistry::Labels::const_iterator labelIt = labels.begin(); labelIt != labels.end(); ++labelIt)
+      {
+        if (labelIt != labels.begin())
+        {
+          os << ",";
+        }
+        os << labelIt->first << "=\"" << EscapeLabelValue(labelIt->second) << "\"";
+      }
+      os << "}";
+    }
+    os << " ";
+    if (std::isnan(value))
+    {
+      os << "NaN";
+    }
+    else if (std::isinf(value))
+    {
+      os << (value > 0 ? "+Inf" : "-Inf");
+    }
+    else
+    {
+      os << std::setprecision(15) << value;
+    }
+    os << "\n";
+  }
+}
+
+//----------------------------------------------------------------------------
+MetricsRegistry::Metric::Metric()
+  : Value(0.0)
+  , Count(0)
+{
+}
+
+//----------------------------------------------------------------------------
+void MetricsRegistry::Metric::Increment(double value/*=1.0*/)
+{
+  double current = this->Value.load(std::memory_order_relaxed);
+  while (!this->Value.compare_exchange_weak(current, current + value, std::memory_order_relaxed))
+  {
+  }
+}
+
+//----------------------------------------------------------------------------
+void MetricsRegistry::Metric::Set(double value)
+{
+  this->Value.store(value, std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+void MetricsRegistry::Metric::AddSample(double value)
+{
+  this->Increment(value);
+  this->Count.fetch_add(1, std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+MetricsRegistry::MetricsRegistry()
+  : NextCollectorId(1)
+{
+}
+
+//----------------------------------------------------------------------------
+MetricsRegistry::~MetricsRegistry()
+{
+}
+
+//----------------------------------------------------------------------------
+MetricsRegistry& MetricsRegistry::GetInstance()
+{
+  static MetricsRegistry instance;
+  return instance;
+}
+
+//----------------------------------------------------------------------------
+std::shared_ptr<MetricsRegistry::Metric> MetricsRegistry::GetMetric(const std::string& name, const std::string& help, MetricType type, const Labels& labels/*=Labels()*/)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  RegisteredMetric& metric = this->Metrics[name][labels];
+  if (metric.Value == nullptr)
+  {
+    metric.Help = help;
+    metric.Type = type;
+    metric.Value = std::make_shared<Metric>();
+  }
+  else if (metric.Type != type)
+  {
+    LOG_WARNING("Metric " << name << " is already registered with a different type");
+  }
+  return metric.Value;
+}
+
+//----------------------------------------------------------------------------
+std::shared_ptr<MetricsRegistry::Metric> MetricsRegistry::GetThreadCpuTimeMetric(const std::string& threadName)
+{
+  Labels threadLabels;
+  threadLabels["thread"] = threadName;
+  return this->GetMetric("plus_thread_cpu_seconds_total", "CPU time consumed by the thread", METRIC_COUNTER, threadLabels);
+}
+
+//----------------------------------------------------------------------------
+void MetricsRegistry::RemoveMetrics(const std::string& labelName, const std::string& labelValue)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  for (std::map<std::string, std::map<Labels, RegisteredMetric> >::iterator nameIt = this->Metrics.begin(); nameIt != this->Metrics.end();)
+  {
+    for (std::map<Labels, RegisteredMetric>::iterator metricIt = nameIt->second.begin(); metricIt != nameIt->second.end();)
+    {
+      Labels::const_iterator labelIt = metricIt->first.find(labelName);
+      if (labelIt != metricIt->first.end() && labelIt->second == labelValue)
+      {
+        metricIt = nameIt->second.erase(metricIt);
+      }
+      else
+      {
+        ++metricIt;
+      }
+    }
+    if (nameIt->second.empty())
+    {
+      nameIt = this->Metrics.erase(nameIt);
+    }
+    else
+    {
+      ++nameIt;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+int MetricsRegistry::AddCollector(Collector collector)
+{
+  std::lock_guard<std::mutex> lock(this->CollectorMutex);
+  int collectorId = this->NextCollectorId++;
+  this->Collectors[collectorId] = collector;
+  return collectorId;
+}
+
+//----------------------------------------------------------------------------
+void MetricsRegistry::RemoveCollector(int collectorId)
+{
+  // Waits until the collectors complete if metrics are being queried
+  std::lock_guard<std::mutex> lock(this->CollectorMutex);
+  this->Collectors.erase(collectorId);
+}
+
+//----------------------------------------------------------------------------
+void MetricsRegistry::GetSamples(std::vector<Sample>& samples)
+{
+  samples.clear();
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    for (std::map<std::string, std::map<Labels, RegisteredMetric> >::const_iterator nameIt = this->Metrics.begin(); nameIt != this->Metrics.end(); ++nameIt)
+    {
+      for (std::map<Labels, RegisteredMetric>::const_iterator metricIt = nameIt->second.begin(); metricIt != nameIt->second.end(); ++metricIt)
+      {
+        samples.push_back(Sample(nameIt->first, metricIt->second.Help, metricIt->second.Type, metricIt->first,
+                                 metricIt->second.Value->GetValue(), metricIt->second.Value->GetCount()));
+      }
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->CollectorMutex);
+    for (std::map<int, Collector>::const_iterator collectorIt = this->Collectors.begin(); collectorIt != this->Collectors.end(); ++collectorIt)
+    {
+      collectorIt->second(samples);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+std::string MetricsRegistry::GetMetricsAsPrometheusText()
+{
+  std::vector<Sample> samples;
+  this->GetSamples(samples);
+
+  // All samples of a metric have to be listed together, after its HELP and TYPE lines
+  std::map<std::string, std::vector<const Sample*> > samplesByName;
+  for (std::vector<Sample>::const_iterator sampleIt = samples.begin(); sampleIt != samples.end(); ++sampleIt)
+  {
+    samplesByName[sampleIt->Name].push_back(&(*sampleIt));
+  }
+
+  std::ostringstream os;
+  for (std::map<std::string, std::vector<const Sample*> >::const_iterator nameIt = samplesByName.begin(); nameIt != samplesByName.end(); ++nameIt)
+  {
+    const Sample& first = *nameIt->second.front();
+    if (!first.Help.empty())
+    {
+      os << "# HELP " << nameIt->first << " " << first.Help << "\n";
+    }
+    os << "# TYPE " << nameIt->first << " " << GetPrometheusTypeName(first.Type) << "\n";
+    for (std::vector<const Sample*>::const_iterator sampleIt = nameIt->second.begin(); sampleIt != nameIt->second.end(); ++sampleIt)
+    {
+      if (first.Type == METRIC_SUMMARY)
+      {
+        PrintSampleLine(os, nameIt->first + "_sum", (*sampleIt)->MetricLabels, (*sampleIt)->Value);
+        PrintSampleLine(os, nameIt->first + "_count", (*sampleIt)->MetricLabels, static_cast<double>((*sampleIt)->Count));
+      }
+      else
+      {
+        PrintSampleLine(os, nameIt->first, (*sampleIt)->MetricLabels, (*sampleIt)->Value);
+      }
+    }
+  }
+  return os.str();
+}
+
+//----------------------------------------------------------------------------
+double MetricsRegistry::GetCurrentThreadCpuTimeSec()
+{
+#if defined(_WIN32)
+  FILETIME creationTime, exitTime, kernelTime, userTime;
+  if (!GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime))
+  {
+    return -1.0;
+  }
+  // FILETIME is in 100ns units
+  ULONGLONG kernel = (static_cast<ULONGLONG>(kernelTime.dwHighDateTime) << 32) | kernelTime.dwLowDateTime;
+  ULONGLONG user = (static_cast<ULONGLONG>(userTime.dwHighDateTime) << 32) | userTime.dwLowDateTime;
+  return static_cast<double>(kernel + user) * 1e-7;
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+  timespec cpuTime;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuTime) != 0)
+  {
+    return -1.0;
+  }
+  return static_cast<double>(cpuTime.tv_sec) + static_cast<double>(cpuTime.tv_nsec) * 1e-9;
+#else
+  return -1.0;
+#endif
+}
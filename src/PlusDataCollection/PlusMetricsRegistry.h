@@ -0,0 +1,151 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __MetricsRegistry_h
+#define __MetricsRegistry_h
+
+#include "vtkPlusDataCollectionExport.h"
+
+#include "PlusConfigure.h"
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*!
+  \class MetricsRegistry
+  \brief Process-wide registry of performance metrics (counters, gauges, summaries) that can be queried at any time.
+
+  There are two kinds of metrics:
+  \li Registered metrics: created by GetMetric and updated by the owner (e.g., in the acquisition or sending loop).
+    Updates are lock-free atomic operations, so they can be done in hot paths.
+  \li Collected metrics: values that are already known by other objects (e.g., buffer fill level) are read
+    by collector functions only when the metrics are queried.
+
+  Metrics are identified by their name and labels (e.g., name="plus_server_sent_bytes_total", labels={client="3"}).
+  All metrics can be retrieved in Prometheus text exposition format by GetMetricsAsPrometheusText.
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport MetricsRegistry
+{
+public:
+  enum MetricType
+  {
+    /*! Monotonically increasing value */
+    METRIC_COUNTER,
+    /*! Value that can go up and down */
+    METRIC_GAUGE,
+    /*! Sum and count of samples (e.g., latencies) */
+    METRIC_SUMMARY
+  };
+
+  typedef std::map<std::string, std::string> Labels;
+
+  /*! Value of a registered metric. All methods are thread-safe and lock-free. */
+  class vtkPlusDataCollectionExport Metric
+  {
+  public:
+    Metric();
+
+    /*! Add to the value of a counter or gauge */
+    void Increment(double value = 1.0);
+    /*! Set the value of a gauge, or of a counter that is accumulated elsewhere (e.g., CPU time) */
+    void Set(double value);
+    /*! Add a sample to a summary */
+    void AddSample(double value);
+
+    /*! Value of a counter or gauge, sum of the samples of a summary */
+    double GetValue() const { return this->Value.load(std::memory_order_relaxed); }
+    /*! Number of samples of a summary */
+    unsigned long long GetCount() const { return this->Count.load(std::memory_order_relaxed); }
+
+  protected:
+    std::atomic<double> Value;
+    std::atomic<unsigned long long> Count;
+  };
+
+  /*! Value of a metric at the time of the query */
+  struct Sample
+  {
+    Sample() : Type(METRIC_GAUGE), Value(0.0), Count(0) {}
+    Sample(const std::string& name, const std::string& help, MetricType type, const Labels& labels, double value, unsigned long long count = 0)
+      : Name(name), Help(help), Type(type), MetricLabels(labels), Value(value), Count(count) {}
+    std::string Name;
+    std::string Help;
+    MetricType Type;
+    Labels MetricLabels;
+    double Value;
+    unsigned long long Count;
+  };
+
+  /*! Function that appends the current value of collected metrics to the list */
+  typedef std::function<void(std::vector<Sample>&)> Collector;
+
+  static MetricsRegistry& GetInstance();
+
+  /*!
+    Get a registered metric. The metric is created if it does not exist yet.
+    The returned pointer can be kept and updated without accessing the registry again.
+    \param help Description of the metric, used when the metric is created
+  */
+  std::shared_ptr<Metric> GetMetric(const std::string& name, const std::string& help, MetricType type, const Labels& labels = Labels());
+
+  /*!
+    Get the CPU time metric of a thread (plus_thread_cpu_seconds_total with a thread label).
+    The thread should set it periodically to GetCurrentThreadCpuTimeSec and remove it by RemoveMetrics("thread", threadName) when it exits.
+  */
+  std::shared_ptr<Metric> GetThreadCpuTimeMetric(const std::string& threadName);
+
+  /*! Remove all registered metrics that have the specified label value (e.g., all metrics of a disconnected client) */
+  void RemoveMetrics(const std::string& labelName, const std::string& labelValue);
+
+  /*! Add a collector function, returns an identifier that can be used for removing the collector */
+  int AddCollector(Collector collector);
+
+  /*! Remove a collector. When the method returns the collector is not running and will not be called anymore. */
+  void RemoveCollector(int collectorId);
+
+  /*! Get the current value of all registered and collected metrics */
+  void GetSamples(std::vector<Sample>& samples);
+
+  /*! Get all metrics in Prometheus text exposition format (version 0.0.4) */
+  std::string GetMetricsAsPrometheusText();
+
+  /*! CPU time consumed by the calling thread, in seconds. Returns a negative value if not available. */
+  static double GetCurrentThreadCpuTimeSec();
+
+protected:
+  MetricsRegistry();
+  virtual ~MetricsRegistry();
+
+  struct RegisteredMetric
+  {
+    std::string Help;
+    MetricType Type;
+    std::shared_ptr<Metric> Value;
+  };
+
+  /*! Protects the registered metrics */
+  std::mutex Mutex;
+  /*! Registered metrics by name and labels */
+  std::map<std::string, std::map<Labels, RegisteredMetric> > Metrics;
+
+  /*! Protects the collectors and is locked while the collectors are running */
+  std::mutex CollectorMutex;
+  std::map<int, Collector> Collectors;
+  int NextCollectorId;
+
+private:
+  MetricsRegistry(const MetricsRegistry&);
+  void operator=(const MetricsRegistry&);
+};
+
+#endif
@@ -0,0 +1,264 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PixelCodec.h"
+#include "PlusMjpegDecoderPool.h"
+#include "vtkPlusDataSource.h"
+
+// VTK includes
+#include <vtkErrorCode.h>
+#include <vtkImageData.h>
+#include <vtkJPEGReader.h>
+#include <vtkSmartPointer.h>
+
+// STL includes
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+  /*! Frames waiting for a decoder by default, a few frames of latency at typical frame rates */
+  const int DEFAULT_MAXIMUM_NUMBER_OF_QUEUED_FRAMES = 4;
+}
+
+//----------------------------------------------------------------------------
+MjpegDecoderPool::MjpegDecoderPool()
+  : NumberOfThreads(0)
+  , MaximumNumberOfQueuedFrames(DEFAULT_MAXIMUM_NUMBER_OF_QUEUED_FRAMES)
+  , DataSource(NULL)
+  , DecodeToRgb(false)
+  , StopRequested(false)
+  , NumberOfDroppedFrames(0)
+{
+  this->FrameSize[0] = 0;
+  this->FrameSize[1] = 0;
+  this->FrameSize[2] = 0;
+}
+
+//----------------------------------------------------------------------------
+MjpegDecoderPool::~MjpegDecoderPool()
+{
+  this->Stop();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus MjpegDecoderPool::Start(vtkPlusDataSource* dataSource, const FrameSizeType& frameSize)
+{
+  if (dataSource == NULL)
+  {
+    LOG_ERROR("MjpegDecoderPool::Start: invalid data source");
+    return PLUS_FAIL;
+  }
+  this->Stop();
+
+  this->DataSource = dataSource;
+  this->FrameSize = frameSize;
+  this->DecodeToRgb = (dataSource->GetImageType() == US_IMG_RGB_COLOR);
+  this->StopRequested = false;
+  this->NumberOfDroppedFrames = 0;
+
+  int numberOfThreads = this->NumberOfThreads;
+  if (numberOfThreads <= 0)
+  {
+    numberOfThreads = std::max<int>(std::thread::hardware_concurrency(), 1);
+  }
+  for (int i = 0; i < numberOfThreads; ++i)
+  {
+    this->Threads.push_back(std::thread(&MjpegDecoderPool::DecodeFrames, this));
+  }
+  LOG_DEBUG("Started " << numberOfThreads << " MJPEG decoder threads");
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void MjpegDecoderPool::Stop()
+{
+  if (this->Threads.empty())
+  {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->StopRequested = true;
+  }
+  this->FrameQueued.notify_all();
+  for (std::vector<std::thread>::iterator threadIt = this->Threads.begin(); threadIt != this->Threads.end(); ++threadIt)
+  {
+    threadIt->join();
+  }
+  this->Threads.clear();
+  if (this->NumberOfDroppedFrames > 0)
+  {
+    LOG_WARNING("MJPEG decoders could not keep up with the acquisition, " << this->NumberOfDroppedFrames << " frames were dropped");
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus MjpegDecoderPool::AddFrame(const unsigned char* data, size_t numberOfBytes, long frameNumber, double unfilteredTimestamp, const igsioFieldMapType* customFields /*= NULL*/)
+{
+  if (this->Threads.empty())
+  {
+    LOG_ERROR("MjpegDecoderPool::AddFrame: decoders are not started");
+    return PLUS_FAIL;
+  }
+  if (data == NULL || numberOfBytes == 0)
+  {
+    LOG_ERROR("MjpegDecoderPool::AddFrame: empty frame");
+    return PLUS_FAIL;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    if (static_cast<int>(this->PendingFrames.size()) >= this->MaximumNumberOfQueuedFrames)
+    {
+      if (this->NumberOfDroppedFrames == 0)
+      {
+        LOG_WARNING("MJPEG decoders cannot keep up with the acquisition, frames are dropped");
+      }
+      ++this->NumberOfDroppedFrames;
+      return PLUS_SUCCESS;
+    }
+  }
+
+  Frame* frame = new Frame;
+  frame->CompressedData.assign(data, data + numberOfBytes);
+  frame->FrameNumber = frameNumber;
+  frame->UnfilteredTimestamp = unfilteredTimestamp;
+  frame->HasCustomFields = (customFields != NULL);
+  if (customFields != NULL)
+  {
+    frame->CustomFields = *customFields;
+  }
+  frame->Decoded = false;
+  frame->Valid = false;
+
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->Frames.push_back(frame);
+    this->PendingFrames.push_back(frame);
+  }
+  this->FrameQueued.notify_one();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+unsigned long MjpegDecoderPool::GetNumberOfDroppedFrames()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return this->NumberOfDroppedFrames;
+}
+
+//----------------------------------------------------------------------------
+void MjpegDecoderPool::DecodeFrames()
+{
+  // Each thread decodes with its own reader
+  vtkSmartPointer<vtkJPEGReader> reader = vtkSmartPointer<vtkJPEGReader>::New();
+  // Keep the row order of the JPEG image (the first row of the image is the first row in memory)
+  reader->FileLowerLeftOn();
+
+  while (true)
+  {
+    Frame* frame = NULL;
+    {
+      std::unique_lock<std::mutex> lock(this->Mutex);
+      while (!this->StopRequested && this->PendingFrames.empty())
+      {
+        this->FrameQueued.wait(lock);
+      }
+      if (this->PendingFrames.empty())
+      {
+        // stop is requested and all the queued frames are decoded
+        break;
+      }
+      frame = this->PendingFrames.front();
+      this->PendingFrames.pop_front();
+    }
+
+    bool valid = this->DecodeFrame(reader, *frame);
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      frame->Valid = valid;
+      frame->Decoded = true;
+    }
+    this->AddDecodedFrames();
+  }
+}
+
+//----------------------------------------------------------------------------
+bool MjpegDecoderPool::DecodeFrame(vtkJPEGReader* reader, Frame& frame)
+{
+  reader->SetMemoryBuffer(&frame.CompressedData[0]);
+  reader->SetMemoryBufferLength(static_cast<vtkIdType>(frame.CompressedData.size()));
+  // the buffer pointer may be the same as for the previous frame
+  reader->Modified();
+  reader->Update();
+
+  vtkImageData* image = reader->GetOutput();
+  int* dimensions = image->GetDimensions();
+  int numberOfComponents = image->GetNumberOfScalarComponents();
+  if (reader->GetErrorCode() != vtkErrorCode::NoError || image->GetScalarType() != VTK_UNSIGNED_CHAR
+      || dimensions[0] != static_cast<int>(this->FrameSize[0]) || dimensions[1] != static_cast<int>(this->FrameSize[1])
+      || (numberOfComponents != 1 && numberOfComponents != 3))
+  {
+    LOG_ERROR("Failed to decode MJPEG frame " << frame.FrameNumber << " (decoded size: " << dimensions[0] << "x" << dimensions[1]
+              << ", expected: " << this->FrameSize[0] << "x" << this->FrameSize[1] << ")");
+    return false;
+  }
+
+  int numberOfPixels = dimensions[0] * dimensions[1];
+  unsigned char* decodedPixels = static_cast<unsigned char*>(image->GetScalarPointer());
+  frame.Pixels.resize(numberOfPixels * (this->DecodeToRgb ? 3 : 1));
+  if (numberOfComponents == (this->DecodeToRgb ? 3 : 1))
+  {
+    memcpy(&frame.Pixels[0], decodedPixels, frame.Pixels.size());
+  }
+  else if (this->DecodeToRgb)
+  {
+    // grayscale JPEG image, replicate the intensity to all components
+    for (int i = 0; i < numberOfPixels; ++i)
+    {
+      frame.Pixels[i * 3] = frame.Pixels[i * 3 + 1] = frame.Pixels[i * 3 + 2] = decodedPixels[i];
+    }
+  }
+  else
+  {
+    PixelCodec::Rgb24ToGray(dimensions[0], dimensions[1], decodedPixels, &frame.Pixels[0]);
+  }
+  frame.CompressedData.clear();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void MjpegDecoderPool::AddDecodedFrames()
+{
+  std::lock_guard<std::mutex> addFramesLock(this->AddFramesMutex);
+  while (true)
+  {
+    Frame* frame = NULL;
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      if (this->Frames.empty() || !this->Frames.front()->Decoded)
+      {
+        // the next frame is still being decoded, the thread that decodes it will add it
+        return;
+      }
+      frame = this->Frames.front();
+      this->Frames.pop_front();
+    }
+
+    if (frame->Valid)
+    {
+      if (this->DataSource->AddItem(&frame->Pixels[0], this->DataSource->GetInputImageOrientation(), this->FrameSize, VTK_UNSIGNED_CHAR, this->DecodeToRgb ? 3 : 1,
+                                    this->DecodeToRgb ? US_IMG_RGB_COLOR : US_IMG_BRIGHTNESS, 0, frame->FrameNumber, frame->UnfilteredTimestamp, UNDEFINED_TIMESTAMP,
+                                    frame->HasCustomFields ? &frame->CustomFields : NULL) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("MjpegDecoderPool: Unable to add decoded frame " << frame->FrameNumber << " to the buffer");
+      }
+    }
+    delete frame;
+  }
+}
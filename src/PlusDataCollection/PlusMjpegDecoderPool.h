@@ -0,0 +1,117 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusMjpegDecoderPool_h
+#define __PlusMjpegDecoderPool_h
+
+#include "vtkPlusDataCollectionExport.h"
+
+// IGSIO includes
+#include <igsioCommon.h>
+
+// STL includes
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class vtkJPEGReader;
+class vtkPlusDataSource;
+
+/*!
+  \class MjpegDecoderPool
+  \brief Decodes motion JPEG frames on worker threads and adds the decoded frames to a data source
+
+  Cameras and grabbers that deliver high resolution or high frame rate video only as MJPEG would be limited by the decoding
+  speed of the capture thread. The capture thread only queues the compressed frames, which are decoded on multiple threads
+  (by the libjpeg-turbo library of VTK) and are added to the data source in the order they were queued, with the timestamps
+  of the capture.
+
+  If MaximumNumberOfQueuedFrames frames are already waiting for a decoder then new frames are dropped, so the latency
+  remains bounded when the decoders cannot keep up. Frames are decoded to RGB if the image type of the data source is
+  US_IMG_RGB_COLOR, otherwise to grayscale.
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport MjpegDecoderPool
+{
+public:
+  MjpegDecoderPool();
+  virtual ~MjpegDecoderPool();
+
+  /*! Number of decoder threads. If 0 then the number of processors is used. Takes effect at the next Start. */
+  void SetNumberOfThreads(int numberOfThreads) { this->NumberOfThreads = numberOfThreads; }
+  int GetNumberOfThreads() const { return this->NumberOfThreads; }
+
+  /*! Maximum number of frames that wait for a decoder, further frames are dropped */
+  void SetMaximumNumberOfQueuedFrames(int maximumNumberOfQueuedFrames) { this->MaximumNumberOfQueuedFrames = maximumNumberOfQueuedFrames; }
+  int GetMaximumNumberOfQueuedFrames() const { return this->MaximumNumberOfQueuedFrames; }
+
+  /*! Start the decoder threads. The decoded frames must have the specified size, and are added to the data source. */
+  PlusStatus Start(vtkPlusDataSource* dataSource, const FrameSizeType& frameSize);
+
+  /*! Decode and add the frames that are already queued, then stop the decoder threads */
+  void Stop();
+
+  bool IsRunning() const { return !this->Threads.empty(); }
+
+  /*! Queue a compressed frame for decoding. The data is copied, so it can be reused when the method returns. */
+  PlusStatus AddFrame(const unsigned char* data, size_t numberOfBytes, long frameNumber, double unfilteredTimestamp, const igsioFieldMapType* customFields = NULL);
+
+  /*! Number of frames that were dropped since Start because the decoders could not keep up */
+  unsigned long GetNumberOfDroppedFrames();
+
+protected:
+  struct Frame
+  {
+    std::vector<unsigned char> CompressedData;
+    std::vector<unsigned char> Pixels;
+    long FrameNumber;
+    double UnfilteredTimestamp;
+    igsioFieldMapType CustomFields;
+    bool HasCustomFields;
+    bool Decoded;
+    bool Valid;
+  };
+
+  /*! Decode queued frames until Stop is called */
+  void DecodeFrames();
+
+  /*! Decode the compressed data of the frame into its pixels, returns false if the frame cannot be decoded */
+  bool DecodeFrame(vtkJPEGReader* reader, Frame& frame);
+
+  /*! Add the decoded frames at the front of the queue to the data source */
+  void AddDecodedFrames();
+
+  int NumberOfThreads;
+  int MaximumNumberOfQueuedFrames;
+
+  vtkPlusDataSource* DataSource;
+  FrameSizeType FrameSize;
+  bool DecodeToRgb;
+
+  std::vector<std::thread> Threads;
+
+  /*! Protects the frame queues and the stop request */
+  std::mutex Mutex;
+  std::condition_variable FrameQueued;
+  /*! All frames that have not been added to the data source yet, in the order they were queued */
+  std::deque<Frame*> Frames;
+  /*! Frames that wait for a decoder */
+  std::deque<Frame*> PendingFrames;
+  bool StopRequested;
+  unsigned long NumberOfDroppedFrames;
+
+  /*! Held while frames are added to the data source, so frames decoded by different threads are added in order */
+  std::mutex AddFramesMutex;
+
+private:
+  MjpegDecoderPool(const MjpegDecoderPool&);
+  void operator=(const MjpegDecoderPool&);
+};
+
+#endif
@@ -0,0 +1,630 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusOverloadManager.h"
+
+#include <igsioCommon.h>
+#include <vtkIGSIOAccurateTimer.h>
+#include <vtkSmartPointer.h>
+#include <vtkXMLDataElement.h>
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+
+const char* OverloadManager::POLICY_REDUCE_CLIENT_STREAM_RATE = "ReduceClientStreamRate";
+const char* OverloadManager::POLICY_REDUCE_PREVIEW_RECONSTRUCTION = "ReducePreviewReconstruction";
+const char* OverloadManager::POLICY_PAUSE_TEXT_RECOGNITION = "PauseTextRecognition";
+const char* OverloadManager::POLICY_DROP_NON_CRITICAL_CAPTURE = "DropNonCriticalCapture";
+
+namespace
+{
+  const double DEFAULT_EVALUATION_INTERVAL_SEC = 1.0;
+  const double DEFAULT_ESCALATION_DELAY_SEC = 2.0;
+  const double DEFAULT_RECOVERY_DELAY_SEC = 10.0;
+  const char* INDICATOR_TAG_NAME = "Indicator";
+  const char* POLICY_TAG_NAME = "Policy";
+
+  //----------------------------------------------------------------------------
+  OverloadManager::Indicator CreateIndicator(const std::string& metricName, OverloadManager::IndicatorAggregation aggregation, bool rate,
+      double overloadThreshold, double recoveryThreshold)
+  {
+    OverloadManager::Indicator indicator;
+    indicator.MetricName = metricName;
+    indicator.Aggregation = aggregation;
+    indicator.Rate = rate;
+    indicator.OverloadThreshold = overloadThreshold;
+    indicator.RecoveryThreshold = recoveryThreshold;
+    return indicator;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Indicators that are used if none are configured: slow clients, memory soft limit and acquisition deadlines */
+  std::vector<OverloadManager::Indicator> GetDefaultIndicators()
+  {
+    std::vector<OverloadManager::Indicator> indicators;
+    indicators.push_back(CreateIndicator("plus_server_client_send_backlog_bytes", OverloadManager::AGGREGATION_MAX, false, 16e6, 2e6));
+    indicators.push_back(CreateIndicator("plus_memory_soft_limit_exceeded", OverloadManager::AGGREGATION_MAX, false, 0.5, 0.5));
+    indicators.push_back(CreateIndicator("plus_device_missed_deadlines_total", OverloadManager::AGGREGATION_SUM, true, 5.0, 1.0));
+    return indicators;
+  }
+
+  //----------------------------------------------------------------------------
+  std::vector<std::string> GetDefaultPolicies()
+  {
+    std::vector<std::string> policies;
+    policies.push_back(OverloadManager::POLICY_REDUCE_CLIENT_STREAM_RATE);
+    policies.push_back(OverloadManager::POLICY_REDUCE_PREVIEW_RECONSTRUCTION);
+    policies.push_back(OverloadManager::POLICY_PAUSE_TEXT_RECOGNITION);
+    policies.push_back(OverloadManager::POLICY_DROP_NON_CRITICAL_CAPTURE);
+    return policies;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Labels are specified as comma-separated name=value pairs */
+  PlusStatus GetLabelsFromString(const std::string& labelsString, MetricsRegistry::Labels& labels)
+  {
+    labels.clear();
+    std::vector<std::string> pairs = igsioCommon::SplitStringIntoTokens(labelsString, ',', false);
+    for (std::vector<std::string>::const_iterator pairIt = pairs.begin(); pairIt != pairs.end(); ++pairIt)
+    {
+      size_t separatorPos = pairIt->find('=');
+      if (separatorPos == std::string::npos)
+      {
+        return PLUS_FAIL;
+      }
+      labels[igsioCommon::Trim(pairIt->substr(0, separatorPos))] = igsioCommon::Trim(pairIt->substr(separatorPos + 1));
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  std::string GetLabelsAsString(const MetricsRegistry::Labels& labels)
+  {
+    std::ostringstream os;
+    for (MetricsRegistry::Labels::const_iterator labelIt = labels.begin(); labelIt != labels.end(); ++labelIt)
+    {
+      os << (labelIt == labels.begin() ? "" : ",") << labelIt->first << "=" << labelIt->second;
+    }
+    return os.str();
+  }
+
+  //----------------------------------------------------------------------------
+  bool HasLabels(const MetricsRegistry::Labels& sampleLabels, const MetricsRegistry::Labels& requiredLabels)
+  {
+    for (MetricsRegistry::Labels::const_iterator labelIt = requiredLabels.begin(); labelIt != requiredLabels.end(); ++labelIt)
+    {
+      MetricsRegistry::Labels::const_iterator sampleLabelIt = sampleLabels.find(labelIt->first);
+      if (sampleLabelIt == sampleLabels.end() || sampleLabelIt->second != labelIt->second)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+}
+
+//----------------------------------------------------------------------------
+OverloadManager::OverloadManager()
+  : EvaluationIntervalSec(DEFAULT_EVALUATION_INTERVAL_SEC)
+  , EscalationDelaySec(DEFAULT_ESCALATION_DELAY_SEC)
+  , RecoveryDelaySec(DEFAULT_RECOVERY_DELAY_SEC)
+  , NextHandlerId(1)
+  , DegradationLevel(0)
+  , LastLevelChangeTimeSec(-1.0)
+  , RecoveredSinceTimeSec(-1.0)
+  , LastEvaluationTimeSec(-1.0)
+  , MetricsCollectorId(0)
+  , MonitorStopRequested(false)
+{
+  this->SetIndicators(GetDefaultIndicators());
+  this->Policies = GetDefaultPolicies();
+  this->MetricsCollectorId = MetricsRegistry::GetInstance().AddCollector([this](std::vector<MetricsRegistry::Sample>& samples)
+  {
+    this->CollectMetrics(samples);
+  });
+}
+
+//----------------------------------------------------------------------------
+OverloadManager::~OverloadManager()
+{
+  this->Stop();
+  MetricsRegistry::GetInstance().RemoveCollector(this->MetricsCollectorId);
+}
+
+//----------------------------------------------------------------------------
+OverloadManager& OverloadManager::GetInstance()
+{
+  static OverloadManager instance;
+  return instance;
+}
+
+//----------------------------------------------------------------------------
+const char* OverloadManager::GetAggregationAsString(IndicatorAggregation aggregation)
+{
+  return aggregation == AGGREGATION_SUM ? "Sum" : "Max";
+}
+
+//----------------------------------------------------------------------------
+PlusStatus OverloadManager::ReadConfiguration(vtkXMLDataElement* overloadManagerElement)
+{
+  if (overloadManagerElement == NULL)
+  {
+    LOG_ERROR("Unable to read overload manager configuration: XML data element is invalid");
+    return PLUS_FAIL;
+  }
+
+  double value = 0.0;
+  if (overloadManagerElement->GetScalarAttribute("EvaluationIntervalSec", value))
+  {
+    this->SetEvaluationIntervalSec(value);
+  }
+  if (overloadManagerElement->GetScalarAttribute("EscalationDelaySec", value))
+  {
+    this->SetEscalationDelaySec(value);
+  }
+  if (overloadManagerElement->GetScalarAttribute("RecoveryDelaySec", value))
+  {
+    this->SetRecoveryDelaySec(value);
+  }
+
+  std::vector<Indicator> indicators;
+  std::vector<std::string> policies;
+  for (int nestedIndex = 0; nestedIndex < overloadManagerElement->GetNumberOfNestedElements(); ++nestedIndex)
+  {
+    vtkXMLDataElement* nestedElement = overloadManagerElement->GetNestedElement(nestedIndex);
+    if (STRCASECMP(nestedElement->GetName(), INDICATOR_TAG_NAME) == 0)
+    {
+      Indicator indicator;
+      const char* metricName = nestedElement->GetAttribute("Metric");
+      if (metricName == NULL || !nestedElement->GetScalarAttribute("OverloadThreshold", indicator.OverloadThreshold))
+      {
+        LOG_ERROR("Overload indicator must have Metric and OverloadThreshold attributes");
+        return PLUS_FAIL;
+      }
+      indicator.MetricName = metricName;
+      indicator.RecoveryThreshold = indicator.OverloadThreshold * 0.5;
+      nestedElement->GetScalarAttribute("RecoveryThreshold", indicator.RecoveryThreshold);
+      if (indicator.RecoveryThreshold > indicator.OverloadThreshold)
+      {
+        LOG_WARNING("RecoveryThreshold of overload indicator " << metricName << " is above its OverloadThreshold, it is set to the OverloadThreshold");
+        indicator.RecoveryThreshold = indicator.OverloadThreshold;
+      }
+      const char* labels = nestedElement->GetAttribute("Labels");
+      if (labels != NULL && GetLabelsFromString(labels, indicator.MetricLabels) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Invalid Labels attribute of overload indicator " << metricName << ": " << labels << " (expected name=value pairs separated by commas)");
+        return PLUS_FAIL;
+      }
+      const char* aggregation = nestedElement->GetAttribute("Aggregation");
+      if (aggregation != NULL)
+      {
+        if (STRCASECMP(aggregation, "Sum") == 0)
+        {
+          indicator.Aggregation = AGGREGATION_SUM;
+        }
+        else if (STRCASECMP(aggregation, "Max") != 0)
+        {
+          LOG_ERROR("Invalid Aggregation attribute of overload indicator " << metricName << ": " << aggregation << " (expected Max or Sum)");
+          return PLUS_FAIL;
+        }
+      }
+      const char* rate = nestedElement->GetAttribute("Rate");
+      indicator.Rate = (rate != NULL && STRCASECMP(rate, "TRUE") == 0);
+      indicators.push_back(indicator);
+    }
+    else if (STRCASECMP(nestedElement->GetName(), POLICY_TAG_NAME) == 0)
+    {
+      const char* policyName = nestedElement->GetAttribute("Name");
+      if (policyName == NULL)
+      {
+        LOG_ERROR("Overload policy must have a Name attribute");
+        return PLUS_FAIL;
+      }
+      if (std::find(policies.begin(), policies.end(), policyName) != policies.end())
+      {
+        LOG_WARNING("Overload policy " << policyName << " is listed multiple times, only the first one is used");
+        continue;
+      }
+      std::vector<std::string> knownPolicies = GetDefaultPolicies();
+      if (std::find(knownPolicies.begin(), knownPolicies.end(), policyName) == knownPolicies.end())
+      {
+        LOG_WARNING("Overload policy " << policyName << " is not implemented by Plus, it has effect only if a component registers a handler for it");
+      }
+      policies.push_back(policyName);
+    }
+  }
+
+  this->SetIndicators(indicators.empty() ? GetDefaultIndicators() : indicators);
+  this->SetPolicies(policies.empty() ? GetDefaultPolicies() : policies);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus OverloadManager::WriteConfiguration(vtkXMLDataElement* overloadManagerElement)
+{
+  if (overloadManagerElement == NULL)
+  {
+    LOG_ERROR("Unable to write overload manager configuration: XML data element is invalid");
+    return PLUS_FAIL;
+  }
+
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  overloadManagerElement->SetDoubleAttribute("EvaluationIntervalSec", this->EvaluationIntervalSec);
+  overloadManagerElement->SetDoubleAttribute("EscalationDelaySec", this->EscalationDelaySec);
+  overloadManagerElement->SetDoubleAttribute("RecoveryDelaySec", this->RecoveryDelaySec);
+  overloadManagerElement->RemoveAllNestedElements();
+  for (std::vector<Indicator>::const_iterator indicatorIt = this->Indicators.begin(); indicatorIt != this->Indicators.end(); ++indicatorIt)
+  {
+    vtkSmartPointer<vtkXMLDataElement> indicatorElement = vtkSmartPointer<vtkXMLDataElement>::New();
+    indicatorElement->SetName(INDICATOR_TAG_NAME);
+    indicatorElement->SetAttribute("Metric", indicatorIt->MetricName.c_str());
+    if (!indicatorIt->MetricLabels.empty())
+    {
+      indicatorElement->SetAttribute("Labels", GetLabelsAsString(indicatorIt->MetricLabels).c_str());
+    }
+    indicatorElement->SetAttribute("Aggregation", GetAggregationAsString(indicatorIt->Aggregation));
+    indicatorElement->SetAttribute("Rate", indicatorIt->Rate ? "TRUE" : "FALSE");
+    indicatorElement->SetDoubleAttribute("OverloadThreshold", indicatorIt->OverloadThreshold);
+    indicatorElement->SetDoubleAttribute("RecoveryThreshold", indicatorIt->RecoveryThreshold);
+    overloadManagerElement->AddNestedElement(indicatorElement);
+  }
+  for (std::vector<std::string>::const_iterator policyIt = this->Policies.begin(); policyIt != this->Policies.end(); ++policyIt)
+  {
+    vtkSmartPointer<vtkXMLDataElement> policyElement = vtkSmartPointer<vtkXMLDataElement>::New();
+    policyElement->SetName(POLICY_TAG_NAME);
+    policyElement->SetAttribute("Name", policyIt->c_str());
+    overloadManagerElement->AddNestedElement(policyElement);
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void OverloadManager::SetIndicators(const std::vector<Indicator>& indicators)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->Indicators = indicators;
+  this->IndicatorValues.assign(indicators.size(), 0.0);
+  this->IndicatorHistories.assign(indicators.size(), std::map<MetricsRegistry::Labels, SeriesHistory>());
+  this->RecoveredSinceTimeSec = -1.0;
+}
+
+//----------------------------------------------------------------------------
+void OverloadManager::GetIndicators(std::vector<Indicator>& indicators)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  indicators = this->Indicators;
+}
+
+//----------------------------------------------------------------------------
+void OverloadManager::SetPolicies(const std::vector<std::string>& policyNames)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->RevertAllPolicies();
+  this->Policies = policyNames;
+}
+
+//----------------------------------------------------------------------------
+void OverloadManager::GetPolicies(std::vector<std::string>& policyNames)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  policyNames = this->Policies;
+}
+
+//----------------------------------------------------------------------------
+void OverloadManager::SetEvaluationIntervalSec(double intervalSec)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->EvaluationIntervalSec = std::max(intervalSec, 0.01);
+}
+
+//----------------------------------------------------------------------------
+void OverloadManager::SetEscalationDelaySec(double delaySec)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->EscalationDelaySec = std::max(delaySec, 0.0);
+}
+
+//----------------------------------------------------------------------------
+void OverloadManager::SetRecoveryDelaySec(double delaySec)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->RecoveryDelaySec = std::max(delaySec, 0.0);
+}
+
+//----------------------------------------------------------------------------
+int OverloadManager::AddPolicyHandler(const std::string& policyName, PolicyHandler handler)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  int handlerId = this->NextHandlerId++;
+  RegisteredHandler& registeredHandler = this->Handlers[handlerId];
+  registeredHandler.PolicyName = policyName;
+  registeredHandler.Handler = handler;
+
+  // The component is started while the system is overloaded, it is degraded right away
+  std::vector<std::string>::iterator policyIt = std::find(this->Policies.begin(), this->Policies.end(), policyName);
+  if (policyIt != this->Policies.end() && policyIt - this->Policies.begin() < this->DegradationLevel)
+  {
+    handler(true);
+  }
+  return handlerId;
+}
+
+//----------------------------------------------------------------------------
+void OverloadManager::RemovePolicyHandler(int handlerId)
+{
+  // Waits until the handlers complete if a policy is being applied
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->Handlers.erase(handlerId);
+}
+
+//----------------------------------------------------------------------------
+int OverloadManager::GetDegradationLevel()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return this->DegradationLevel;
+}
+
+//----------------------------------------------------------------------------
+bool OverloadManager::IsPolicyApplied(const std::string& policyName)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  std::vector<std::string>::iterator policyIt = std::find(this->Policies.begin(), this->Policies.end(), policyName);
+  return policyIt != this->Policies.end() && policyIt - this->Policies.begin() < this->DegradationLevel;
+}
+
+//----------------------------------------------------------------------------
+double OverloadManager::GetIndicatorValue(size_t indicatorIndex, const std::vector<MetricsRegistry::Sample>& samples, double currentTimeSec)
+{
+  const Indicator& indicator = this->Indicators[indicatorIndex];
+  std::map<MetricsRegistry::Labels, SeriesHistory>& history = this->IndicatorHistories[indicatorIndex];
+  std::map<MetricsRegistry::Labels, SeriesHistory> newHistory;
+  double elapsedSec = (this->LastEvaluationTimeSec >= 0 ? currentTimeSec - this->LastEvaluationTimeSec : 0.0);
+
+  double aggregatedValue = 0.0;
+  for (std::vector<MetricsRegistry::Sample>::const_iterator sampleIt = samples.begin(); sampleIt != samples.end(); ++sampleIt)
+  {
+    if (sampleIt->Name != indicator.MetricName || !HasLabels(sampleIt->MetricLabels, indicator.MetricLabels))
+    {
+      continue;
+    }
+
+    double value = 0.0;
+    if (indicator.Rate)
+    {
+      SeriesHistory& current = newHistory[sampleIt->MetricLabels];
+      current.Value = sampleIt->Value;
+      current.Count = sampleIt->Count;
+      std::map<MetricsRegistry::Labels, SeriesHistory>::const_iterator previousIt = history.find(sampleIt->MetricLabels);
+      if (previousIt == history.end() || elapsedSec <= 0)
+      {
+        // The change can be computed from the next evaluation
+        continue;
+      }
+      if (sampleIt->Type == MetricsRegistry::METRIC_SUMMARY)
+      {
+        // Mean of the samples added since the previous evaluation
+        unsigned long long newCount = (sampleIt->Count > previousIt->second.Count ? sampleIt->Count - previousIt->second.Count : 0);
+        value = (newCount > 0 ? (sampleIt->Value - previousIt->second.Value) / newCount : 0.0);
+      }
+      else
+      {
+        // A counter that was reset (e.g., the device was reconnected) does not indicate a load
+        value = std::max(sampleIt->Value - previousIt->second.Value, 0.0) / elapsedSec;
+      }
+    }
+    else if (sampleIt->Type == MetricsRegistry::METRIC_SUMMARY)
+    {
+      value = (sampleIt->Count > 0 ? sampleIt->Value / sampleIt->Count : 0.0);
+    }
+    else
+    {
+      value = sampleIt->Value;
+    }
+
+    if (indicator.Aggregation == AGGREGATION_SUM)
+    {
+      aggregatedValue += value;
+    }
+    else
+    {
+      aggregatedValue = std::max(aggregatedValue, value);
+    }
+  }
+
+  if (indicator.Rate)
+  {
+    history.swap(newHistory);
+  }
+  return aggregatedValue;
+}
+
+//----------------------------------------------------------------------------
+void OverloadManager::Evaluate(double currentTimeSec)
+{
+  // The metrics are queried without locking the manager, as the collector of the manager locks it
+  std::vector<MetricsRegistry::Sample> samples;
+  MetricsRegistry::GetInstance().GetSamples(samples);
+
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  bool overloaded = false;
+  bool recovered = true;
+  std::ostringstream overloadDescription;
+  for (size_t indicatorIndex = 0; indicatorIndex < this->Indicators.size(); ++indicatorIndex)
+  {
+    const Indicator& indicator = this->Indicators[indicatorIndex];
+    double value = this->GetIndicatorValue(indicatorIndex, samples, currentTimeSec);
+    this->IndicatorValues[indicatorIndex] = value;
+    if (value > indicator.OverloadThreshold)
+    {
+      overloadDescription << (overloaded ? ", " : "") << indicator.MetricName << (indicator.Rate ? " rate" : "") << " = " << value << " > " << indicator.OverloadThreshold;
+      overloaded = true;
+    }
+    if (value >= indicator.RecoveryThreshold)
+    {
+      recovered = false;
+    }
+  }
+  this->LastEvaluationTimeSec = currentTimeSec;
+
+  int maximumLevel = static_cast<int>(this->Policies.size());
+  if (overloaded)
+  {
+    this->RecoveredSinceTimeSec = -1.0;
+    if (this->DegradationLevel < maximumLevel
+        && (this->LastLevelChangeTimeSec < 0 || currentTimeSec - this->LastLevelChangeTimeSec >= this->EscalationDelaySec))
+    {
+      LOG_WARNING("System is overloaded (" << overloadDescription.str() << "), degradation policy " << this->Policies[this->DegradationLevel] << " is applied");
+      this->ChangeDegradationLevel(true, currentTimeSec);
+    }
+  }
+  else if (recovered)
+  {
+    if (this->RecoveredSinceTimeSec < 0)
+    {
+      this->RecoveredSinceTimeSec = currentTimeSec;
+    }
+    if (this->DegradationLevel > 0 && currentTimeSec - this->RecoveredSinceTimeSec >= this->RecoveryDelaySec
+        && currentTimeSec - this->LastLevelChangeTimeSec >= this->RecoveryDelaySec)
+    {
+      LOG_INFO("System load is below the recovery thresholds, degradation policy " << this->Policies[this->DegradationLevel - 1] << " is reverted");
+      this->ChangeDegradationLevel(false, currentTimeSec);
+    }
+  }
+  else
+  {
+    this->RecoveredSinceTimeSec = -1.0;
+  }
+}
+
+//----------------------------------------------------------------------------
+void OverloadManager::ChangeDegradationLevel(bool increment, double currentTimeSec)
+{
+  if (increment)
+  {
+    this->DegradationLevel++;
+    this->CallPolicyHandlers(this->Policies[this->DegradationLevel - 1], true);
+  }
+  else
+  {
+    this->CallPolicyHandlers(this->Policies[this->DegradationLevel - 1], false);
+    this->DegradationLevel--;
+  }
+  this->LastLevelChangeTimeSec = currentTimeSec;
+}
+
+//----------------------------------------------------------------------------
+void OverloadManager::CallPolicyHandlers(const std::string& policyName, bool apply)
+{
+  for (std::map<int, RegisteredHandler>::const_iterator handlerIt = this->Handlers.begin(); handlerIt != this->Handlers.end(); ++handlerIt)
+  {
+    if (handlerIt->second.PolicyName == policyName)
+    {
+      handlerIt->second.Handler(apply);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void OverloadManager::RevertAllPolicies()
+{
+  if (this->DegradationLevel > 0)
+  {
+    LOG_INFO("All overload degradation policies are reverted");
+  }
+  while (this->DegradationLevel > 0)
+  {
+    this->CallPolicyHandlers(this->Policies[this->DegradationLevel - 1], false);
+    this->DegradationLevel--;
+  }
+  this->LastLevelChangeTimeSec = -1.0;
+  this->RecoveredSinceTimeSec = -1.0;
+}
+
+//----------------------------------------------------------------------------
+void OverloadManager::CollectMetrics(std::vector<MetricsRegistry::Sample>& samples)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  samples.push_back(MetricsRegistry::Sample("plus_overload_degradation_level", "Number of the applied overload degradation policies",
+                    MetricsRegistry::METRIC_GAUGE, MetricsRegistry::Labels(), this->DegradationLevel));
+  for (size_t policyIndex = 0; policyIndex < this->Policies.size(); ++policyIndex)
+  {
+    MetricsRegistry::Labels labels;
+    labels["policy"] = this->Policies[policyIndex];
+    samples.push_back(MetricsRegistry::Sample("plus_overload_policy_applied", "1 if the overload degradation policy is applied",
+                      MetricsRegistry::METRIC_GAUGE, labels, static_cast<int>(policyIndex) < this->DegradationLevel ? 1.0 : 0.0));
+  }
+  for (size_t indicatorIndex = 0; indicatorIndex < this->Indicators.size(); ++indicatorIndex)
+  {
+    MetricsRegistry::Labels labels;
+    labels["indicator"] = igsioCommon::ToString<size_t>(indicatorIndex);
+    labels["metric"] = this->Indicators[indicatorIndex].MetricName;
+    samples.push_back(MetricsRegistry::Sample("plus_overload_indicator_value", "Value of the overload indicator at the latest evaluation",
+                      MetricsRegistry::METRIC_GAUGE, labels, this->IndicatorValues[indicatorIndex]));
+  }
+}
+
+//----------------------------------------------------------------------------
+void OverloadManager::Start()
+{
+  std::lock_guard<std::mutex> lock(this->MonitorMutex);
+  if (this->MonitorThread.joinable())
+  {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> stateLock(this->Mutex);
+    LOG_INFO("Overload manager started with " << this->Indicators.size() << " indicators and " << this->Policies.size() << " degradation policies");
+    this->LastEvaluationTimeSec = -1.0;
+  }
+  this->MonitorStopRequested = false;
+  this->MonitorThread = std::thread(&OverloadManager::MonitorLoop, this);
+}
+
+//----------------------------------------------------------------------------
+void OverloadManager::Stop()
+{
+  std::thread monitorThread;
+  {
+    std::lock_guard<std::mutex> lock(this->MonitorMutex);
+    if (this->MonitorThread.joinable())
+    {
+      this->MonitorStopRequested = true;
+      monitorThread.swap(this->MonitorThread);
+    }
+  }
+  if (monitorThread.joinable())
+  {
+    this->MonitorCondition.notify_all();
+    monitorThread.join();
+  }
+
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->RevertAllPolicies();
+}
+
+//----------------------------------------------------------------------------
+void OverloadManager::MonitorLoop()
+{
+  std::unique_lock<std::mutex> lock(this->MonitorMutex);
+  while (!this->MonitorStopRequested)
+  {
+    double intervalSec = DEFAULT_EVALUATION_INTERVAL_SEC;
+    {
+      std::lock_guard<std::mutex> stateLock(this->Mutex);
+      intervalSec = this->EvaluationIntervalSec;
+    }
+    if (this->MonitorCondition.wait_for(lock, std::chrono::duration<double>(intervalSec), [this] { return this->MonitorStopRequested; }))
+    {
+      break;
+    }
+    // The collectors and the policy handlers may take a while, so the monitor state is not locked while they run
+    lock.unlock();
+    this->Evaluate(vtkIGSIOAccurateTimer::GetSystemTime());
+    lock.lock();
+  }
+}
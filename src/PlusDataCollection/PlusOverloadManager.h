@@ -0,0 +1,210 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __OverloadManager_h
+#define __OverloadManager_h
+
+#include "vtkPlusDataCollectionExport.h"
+
+#include "PlusConfigure.h"
+#include "PlusMetricsRegistry.h"
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class vtkXMLDataElement;
+
+/*!
+  \class OverloadManager
+  \brief Process-wide overload detection that degrades the non-essential processing gracefully, in a configured order.
+
+  The load is measured by indicators, each of them is a metric of the MetricsRegistry (e.g., send backlog of the clients,
+  capture write queue, missed update deadlines, CPU time of the threads) compared with an overload and a recovery threshold.
+  Counters can be evaluated as rates (e.g., CPU seconds per second), summaries as the mean of the samples.
+
+  The degradation policies are applied in the configured order: while any indicator is above its overload threshold
+  the next policy is applied every EscalationDelaySec, and when all indicators stayed below their recovery threshold
+  for RecoveryDelaySec the most recently applied policy is reverted. Components register handlers for the policies
+  they implement, a handler is called with true when its policy is applied and with false when it is reverted:
+  - ReduceClientStreamRate: the image streams of the server clients are sent at reduced frame rate (tracking data is not reduced)
+  - ReducePreviewReconstruction: reconstructed volume snapshots are extracted less frequently
+  - PauseTextRecognition: OCR of the screen regions is paused
+  - DropNonCriticalCapture: capture devices that are not marked as critical drop the input frames
+  Tracking and primary imaging are never degraded, they are not listed among the policies.
+
+  The current degradation level and the applied policies are exported as plus_overload_* metrics.
+
+  Configuration (element in the DataCollection element):
+  \code
+  <OverloadManager EvaluationIntervalSec="1.0" EscalationDelaySec="2.0" RecoveryDelaySec="10.0">
+    <Indicator Metric="plus_server_client_send_backlog_bytes" OverloadThreshold="16000000" RecoveryThreshold="2000000" />
+    <Indicator Metric="plus_memory_bytes" Labels="component=capture_write_queue" Aggregation="Sum" OverloadThreshold="500000000" />
+    <Indicator Metric="plus_thread_cpu_seconds_total" Rate="TRUE" Aggregation="Sum" OverloadThreshold="3.5" RecoveryThreshold="2.5" />
+    <Policy Name="ReduceClientStreamRate" />
+    <Policy Name="ReducePreviewReconstruction" />
+    <Policy Name="PauseTextRecognition" />
+    <Policy Name="DropNonCriticalCapture" />
+  </OverloadManager>
+  \endcode
+  If no indicators are listed then the send backlog, the memory soft limit and the missed deadlines are monitored.
+  If no policies are listed then all the above policies are used, in the above order.
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport OverloadManager
+{
+public:
+  static const char* POLICY_REDUCE_CLIENT_STREAM_RATE;
+  static const char* POLICY_REDUCE_PREVIEW_RECONSTRUCTION;
+  static const char* POLICY_PAUSE_TEXT_RECOGNITION;
+  static const char* POLICY_DROP_NON_CRITICAL_CAPTURE;
+
+  enum IndicatorAggregation
+  {
+    /*! The largest value of the matching metric samples is compared with the thresholds (e.g., the slowest client) */
+    AGGREGATION_MAX,
+    /*! The sum of the matching metric samples is compared with the thresholds (e.g., all threads) */
+    AGGREGATION_SUM
+  };
+
+  /*! Metric that indicates the load of the system */
+  struct Indicator
+  {
+    Indicator() : Aggregation(AGGREGATION_MAX), Rate(false), OverloadThreshold(0.0), RecoveryThreshold(0.0) {}
+    std::string MetricName;
+    /*! Only the samples that have all these labels are evaluated */
+    MetricsRegistry::Labels MetricLabels;
+    IndicatorAggregation Aggregation;
+    /*! If true then the change per second of the value is evaluated (for counters) */
+    bool Rate;
+    /*! The system is overloaded if the value is above this threshold */
+    double OverloadThreshold;
+    /*! The system is recovered if the values of all indicators are below their recovery threshold */
+    double RecoveryThreshold;
+  };
+
+  /*! Function that applies (true) or reverts (false) a degradation policy. It must not query the metrics registry. */
+  typedef std::function<void(bool)> PolicyHandler;
+
+  static OverloadManager& GetInstance();
+
+  /*! Read the indicators, policies and delays from the OverloadManager element */
+  PlusStatus ReadConfiguration(vtkXMLDataElement* overloadManagerElement);
+  PlusStatus WriteConfiguration(vtkXMLDataElement* overloadManagerElement);
+
+  void SetIndicators(const std::vector<Indicator>& indicators);
+  void GetIndicators(std::vector<Indicator>& indicators);
+
+  /*! Names of the degradation policies, in the order of application. Reverts the applied policies. */
+  void SetPolicies(const std::vector<std::string>& policyNames);
+  void GetPolicies(std::vector<std::string>& policyNames);
+
+  void SetEvaluationIntervalSec(double intervalSec);
+  void SetEscalationDelaySec(double delaySec);
+  void SetRecoveryDelaySec(double delaySec);
+
+  /*!
+    Add a handler of a degradation policy, returns an identifier that can be used for removing the handler.
+    If the policy is currently applied then the handler is called with true before the method returns.
+  */
+  int AddPolicyHandler(const std::string& policyName, PolicyHandler handler);
+
+  /*! Remove a handler. The handler is not called to revert its policy. When the method returns the handler is not running and will not be called anymore. */
+  void RemovePolicyHandler(int handlerId);
+
+  /*! Start the periodic evaluation of the indicators on a monitor thread */
+  void Start();
+
+  /*! Stop the monitor thread and revert all applied policies */
+  void Stop();
+
+  /*! Evaluate the indicators and apply or revert a policy if needed. Called periodically by the monitor thread. */
+  void Evaluate(double currentTimeSec);
+
+  /*! Number of the currently applied policies */
+  int GetDegradationLevel();
+
+  /*! Returns true if the policy is currently applied */
+  bool IsPolicyApplied(const std::string& policyName);
+
+  static const char* GetAggregationAsString(IndicatorAggregation aggregation);
+
+protected:
+  OverloadManager();
+  virtual ~OverloadManager();
+
+  /*! Value of an indicator computed from the current metric samples. Mutex must be locked. */
+  double GetIndicatorValue(size_t indicatorIndex, const std::vector<MetricsRegistry::Sample>& samples, double currentTimeSec);
+
+  /*! Apply the next policy (increment true) or revert the last applied one. Mutex must be locked. */
+  void ChangeDegradationLevel(bool increment, double currentTimeSec);
+
+  /*! Call the handlers of a policy. Mutex must be locked. */
+  void CallPolicyHandlers(const std::string& policyName, bool apply);
+
+  /*! Revert all applied policies. Mutex must be locked. */
+  void RevertAllPolicies();
+
+  void CollectMetrics(std::vector<MetricsRegistry::Sample>& samples);
+
+  void MonitorLoop();
+
+  struct RegisteredHandler
+  {
+    std::string PolicyName;
+    PolicyHandler Handler;
+  };
+
+  /*! Value of a metric series at the previous evaluation, for computing rates */
+  struct SeriesHistory
+  {
+    SeriesHistory() : Value(0.0), Count(0) {}
+    double Value;
+    unsigned long long Count;
+  };
+
+  /*! Protects all members except the monitor thread state, locked while the handlers are running */
+  std::mutex Mutex;
+  std::vector<Indicator> Indicators;
+  std::vector<std::string> Policies;
+  double EvaluationIntervalSec;
+  double EscalationDelaySec;
+  double RecoveryDelaySec;
+
+  std::map<int, RegisteredHandler> Handlers;
+  int NextHandlerId;
+
+  /*! Number of applied policies, the first DegradationLevel elements of Policies are applied */
+  int DegradationLevel;
+  double LastLevelChangeTimeSec;
+  /*! Time since all indicators are below their recovery threshold, negative if they are not */
+  double RecoveredSinceTimeSec;
+  /*! Latest value of each indicator */
+  std::vector<double> IndicatorValues;
+  /*! Previous values of the metric series of each rate indicator, by labels */
+  std::vector<std::map<MetricsRegistry::Labels, SeriesHistory> > IndicatorHistories;
+  double LastEvaluationTimeSec;
+
+  /*! Identifier of the metrics collector of the manager */
+  int MetricsCollectorId;
+
+  /*! Protects the monitor thread state */
+  std::mutex MonitorMutex;
+  std::condition_variable MonitorCondition;
+  std::thread MonitorThread;
+  bool MonitorStopRequested;
+
+private:
+  OverloadManager(const OverloadManager&);
+  void operator=(const OverloadManager&);
+};
+
+#endif
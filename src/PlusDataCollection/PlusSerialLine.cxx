@@ -7,11 +7,138 @@
 #include "PlusConfigure.h"
 #include "PlusSerialLine.h"
 
+// IGSIO includes
+#include <vtkIGSIOAccurateTimer.h>
+
+// STL includes
+#include <algorithm>
+
+#ifndef _WIN32
+  #include <errno.h>
+  #include <fcntl.h>
+  #include <poll.h>
+  #include <sys/ioctl.h>
+  #include <termios.h>
+  #include <unistd.h>
+#endif
+
+namespace
+{
+  /*! The receive thread checks at least this often if it has to stop */
+  const int RECEIVE_WAIT_TIMEOUT_MSEC = 100;
+  /*! Maximum time between two bytes of a reply */
+  const int READ_INTERVAL_TIMEOUT_MSEC = 200;
+
+#ifdef _WIN32
+  //----------------------------------------------------------------------------
+  /*! Wait for an overlapped operation, returns the transferred bytes in numberOfBytesTransferred */
+  BOOL CompleteOverlapped(HANDLE commHandle, BOOL started, OVERLAPPED& overlapped, DWORD& numberOfBytesTransferred)
+  {
+    if (!started && GetLastError() != ERROR_IO_PENDING)
+    {
+      return FALSE;
+    }
+    // the operation is bounded by the comm timeouts
+    return GetOverlappedResult(commHandle, &overlapped, &numberOfBytesTransferred, TRUE);
+  }
+
+  //----------------------------------------------------------------------------
+  BOOL ReadFileAndWait(HANDLE commHandle, void* data, DWORD numberOfBytesToRead, DWORD& numberOfBytesRead)
+  {
+    OVERLAPPED overlapped = { 0 };
+    overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    numberOfBytesRead = 0;
+    BOOL result = CompleteOverlapped(commHandle, ReadFile(commHandle, data, numberOfBytesToRead, NULL, &overlapped), overlapped, numberOfBytesRead);
+    DWORD lastError = GetLastError();
+    CloseHandle(overlapped.hEvent);
+    SetLastError(lastError);
+    return result;
+  }
+
+  //----------------------------------------------------------------------------
+  BOOL WriteFileAndWait(HANDLE commHandle, const void* data, DWORD numberOfBytesToWrite, DWORD& numberOfBytesWritten)
+  {
+    OVERLAPPED overlapped = { 0 };
+    overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    numberOfBytesWritten = 0;
+    BOOL result = CompleteOverlapped(commHandle, WriteFile(commHandle, data, numberOfBytesToWrite, NULL, &overlapped), overlapped, numberOfBytesWritten);
+    DWORD lastError = GetLastError();
+    CloseHandle(overlapped.hEvent);
+    SetLastError(lastError);
+    return result;
+  }
+#else
+  //----------------------------------------------------------------------------
+  /*! Returns the termios speed constant, B0 if the speed is not supported */
+  speed_t GetTermiosSpeed(unsigned long speed)
+  {
+    switch (speed)
+    {
+      case 1200: return B1200;
+      case 2400: return B2400;
+      case 4800: return B4800;
+      case 9600: return B9600;
+      case 19200: return B19200;
+      case 38400: return B38400;
+      case 57600: return B57600;
+      case 115200: return B115200;
+      case 230400: return B230400;
+#ifdef B460800
+      case 460800: return B460800;
+#endif
+#ifdef B921600
+      case 921600: return B921600;
+#endif
+      default: return B0;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Wait until the port is ready for the requested events (POLLIN or POLLOUT), returns false on timeout or error */
+  bool WaitForPort(int commHandle, short events, int timeoutMsec)
+  {
+    pollfd pollDescriptor;
+    pollDescriptor.fd = commHandle;
+    pollDescriptor.events = events;
+    pollDescriptor.revents = 0;
+    int result = 0;
+    do
+    {
+      result = poll(&pollDescriptor, 1, timeoutMsec);
+    }
+    while (result < 0 && errno == EINTR);
+    return result > 0 && (pollDescriptor.revents & events);
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus SetModemLine(int commHandle, int line, bool onOff)
+  {
+    return ioctl(commHandle, onOff ? TIOCMBIS : TIOCMBIC, &line) == 0 ? PLUS_SUCCESS : PLUS_FAIL;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus GetModemLine(int commHandle, int line, bool& onOff)
+  {
+    int status = 0;
+    if (ioctl(commHandle, TIOCMGET, &status) != 0)
+    {
+      return PLUS_FAIL;
+    }
+    onOff = (status & line) != 0;
+    return PLUS_SUCCESS;
+  }
+#endif
+}
+
 //----------------------------------------------------------------------------
 SerialLine::SerialLine()
   : MaxReplyTime(1000)
   , SerialPortSpeed(9600)
   , CommHandle(INVALID_HANDLE_VALUE)
+  , StopReceivingRequested(false)
+  , FrameDelimiter(0)
+  , MaxFrameLengthBytes(0)
+  , CurrentFrameTimestamp(0)
 {
 
 }
@@ -28,12 +155,15 @@ SerialLine::~SerialLine()
 //----------------------------------------------------------------------------
 void SerialLine::Close()
 {
-#ifdef _WIN32
+  this->StopReceiving();
   if (CommHandle != INVALID_HANDLE_VALUE)
   {
+#ifdef _WIN32
     CloseHandle(CommHandle);
-  }
+#else
+    close(CommHandle);
 #endif
+  }
   CommHandle = INVALID_HANDLE_VALUE;
 }
 
@@ -51,7 +181,7 @@ bool SerialLine::Open()
                           GENERIC_READ | GENERIC_WRITE,
                           0,  // not allowed to share ports
                           0,  // child-processes don't inherit handle
-                          OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                          OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED,
                           NULL); /* no template file */
   if (CommHandle == INVALID_HANDLE_VALUE)
   {
@@ -77,7 +207,7 @@ bool SerialLine::Open()
 
   COMMTIMEOUTS timeouts;
   GetCommTimeouts(CommHandle, &timeouts);
-  timeouts.ReadIntervalTimeout = 200;
+  timeouts.ReadIntervalTimeout = READ_INTERVAL_TIMEOUT_MSEC;
   timeouts.ReadTotalTimeoutConstant = MaxReplyTime;
   timeouts.ReadTotalTimeoutMultiplier = 100;
   timeouts.WriteTotalTimeoutConstant = MaxReplyTime;
@@ -90,9 +220,41 @@ bool SerialLine::Open()
 
   return true;
 #else
-  LOG_ERROR("SerialLine::Open() is only implemented on Windows");
-  CommHandle = INVALID_HANDLE_VALUE;
-  return false;
+  speed_t speed = GetTermiosSpeed(SerialPortSpeed);
+  if (speed == B0)
+  {
+    LOG_ERROR("SerialLine::Open() unsupported serial port speed: " << SerialPortSpeed);
+    return false;
+  }
+
+  // Waiting for the completion of reads and writes is bounded by MaxReplyTime, so the port is non-blocking
+  CommHandle = open(this->PortName.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (CommHandle == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+
+  termios options;
+  if (tcgetattr(CommHandle, &options) != 0)
+  {
+    Close();
+    return false;
+  }
+  // 8 data bits, no parity, one stop bit, no flow control, no character processing
+  cfmakeraw(&options);
+  options.c_cflag |= (CLOCAL | CREAD);
+  options.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+  options.c_iflag &= ~(IXON | IXOFF | IXANY);
+  cfsetispeed(&options, speed);
+  cfsetospeed(&options, speed);
+  if (tcsetattr(CommHandle, TCSANOW, &options) != 0)
+  {
+    Close();
+    return false;
+  }
+  tcflush(CommHandle, TCIOFLUSH);
+
+  return true;
 #endif
 }
 
@@ -104,7 +266,7 @@ int SerialLine::Write(const BYTE* data, int numberOfBytesToWrite)
   while (numberOfBytesToWrite > 0)
   {
     DWORD numberOfBytesWritten = 0;
-    if (WriteFile(CommHandle, &data[numberOfBytesWrittenTotal], numberOfBytesToWrite, &numberOfBytesWritten, NULL) == FALSE)
+    if (WriteFileAndWait(CommHandle, &data[numberOfBytesWrittenTotal], numberOfBytesToWrite, numberOfBytesWritten) == FALSE)
     {
       if (GetLastError() == ERROR_OPERATION_ABORTED)
       {
@@ -129,8 +291,27 @@ int SerialLine::Write(const BYTE* data, int numberOfBytesToWrite)
   }
   return numberOfBytesWrittenTotal;
 #else
-  LOG_ERROR("SerialLine::Write() is only implemented on Windows");
-  return 0;
+  int numberOfBytesWrittenTotal = 0;
+  while (numberOfBytesToWrite > 0)
+  {
+    ssize_t numberOfBytesWritten = write(CommHandle, &data[numberOfBytesWrittenTotal], numberOfBytesToWrite);
+    if (numberOfBytesWritten < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      if ((errno == EAGAIN || errno == EWOULDBLOCK) && WaitForPort(CommHandle, POLLOUT, MaxReplyTime))
+      {
+        continue;
+      }
+      // error or timeout
+      return numberOfBytesWrittenTotal;
+    }
+    numberOfBytesToWrite -= static_cast<int>(numberOfBytesWritten);
+    numberOfBytesWrittenTotal += static_cast<int>(numberOfBytesWritten);
+  }
+  return numberOfBytesWrittenTotal;
 #endif
 }
 
@@ -148,7 +329,7 @@ int SerialLine::Read(BYTE* data, int maxNumberOfBytesToRead)
   while (maxNumberOfBytesToRead > 0)
   {
     DWORD numberOfBytesRead;
-    if (ReadFile(CommHandle, &data[numberOfBytesReadTotal], maxNumberOfBytesToRead, &numberOfBytesRead, NULL) == FALSE)
+    if (ReadFileAndWait(CommHandle, &data[numberOfBytesReadTotal], maxNumberOfBytesToRead, numberOfBytesRead) == FALSE)
     {
       DWORD lastError = GetLastError();
       if (lastError == ERROR_OPERATION_ABORTED)
@@ -173,8 +354,33 @@ int SerialLine::Read(BYTE* data, int maxNumberOfBytesToRead)
   }
   return numberOfBytesReadTotal;
 #else
-  LOG_ERROR("SerialLine::Read() is only implemented on Windows");
-  return 0;
+  int numberOfBytesReadTotal = 0;
+  while (maxNumberOfBytesToRead > 0)
+  {
+    ssize_t numberOfBytesRead = read(CommHandle, &data[numberOfBytesReadTotal], maxNumberOfBytesToRead);
+    if (numberOfBytesRead < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (numberOfBytesRead < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+    {
+      // error
+      return numberOfBytesReadTotal;
+    }
+    if (numberOfBytesRead > 0)
+    {
+      maxNumberOfBytesToRead -= static_cast<int>(numberOfBytesRead);
+      numberOfBytesReadTotal += static_cast<int>(numberOfBytesRead);
+      continue;
+    }
+    // wait for the first byte for at most the reply time, then for the next bytes at most for the interval timeout
+    if (!WaitForPort(CommHandle, POLLIN, numberOfBytesReadTotal == 0 ? MaxReplyTime : READ_INTERVAL_TIMEOUT_MSEC))
+    {
+      // no characters read, must have timed out
+      return numberOfBytesReadTotal;
+    }
+  }
+  return numberOfBytesReadTotal;
 #endif
 }
 
@@ -193,7 +399,7 @@ SerialLine::DWORD SerialLine::ClearError()
   ClearCommError(CommHandle, &dwErrors, &comStat);
   return dwErrors;
 #else
-  LOG_ERROR("SerialLine::ClearError() is only implemented on Windows");
+  // errors are reported by the failing read and write calls, there is no error flag to clear
   return 0;
 #endif
 }
@@ -231,8 +437,12 @@ unsigned int SerialLine::GetNumberOfBytesAvailableForReading() const
   ClearCommError(CommHandle, &dwErrorFlags, &comStat);
   return ((int) comStat.cbInQue);
 #else
-  LOG_ERROR("SerialLine::GetNumberOfBytesAvailableForReading() is only implemented on Windows");
-  return 0;
+  int numberOfBytesAvailable = 0;
+  if (ioctl(CommHandle, FIONREAD, &numberOfBytesAvailable) != 0)
+  {
+    return 0;
+  }
+  return static_cast<unsigned int>(numberOfBytesAvailable);
 #endif
 }
 
@@ -254,8 +464,7 @@ PlusStatus SerialLine::SetDTR(bool onOff)
     return PLUS_FAIL;
   }
 #else
-  LOG_ERROR("SerialLine::SetDTR() is only implemented on Windows");
-  return PLUS_FAIL;
+  return SetModemLine(CommHandle, TIOCM_DTR, onOff);
 #endif
 }
 
@@ -277,8 +486,7 @@ PlusStatus SerialLine::SetRTS(bool onOff)
     return PLUS_FAIL;
   }
 #else
-  LOG_ERROR("SerialLine::SetRTS() is only implemented on Windows");
-  return PLUS_FAIL;
+  return SetModemLine(CommHandle, TIOCM_RTS, onOff);
 #endif
 }
 
@@ -294,8 +502,7 @@ PlusStatus SerialLine::GetDSR(bool & onOff)
   onOff = MS_DSR_ON & dwStatus;
   return PLUS_SUCCESS;
 #else
-  LOG_ERROR("SerialLine::GetDSR() is only implemented on Windows");
-  return PLUS_FAIL;
+  return GetModemLine(CommHandle, TIOCM_DSR, onOff);
 #endif
 }
 
@@ -311,7 +518,143 @@ PlusStatus SerialLine::GetCTS(bool & onOff)
   onOff = MS_CTS_ON & dwStatus;
   return PLUS_SUCCESS;
 #else
-  LOG_ERROR("SerialLine::GetCTS() is only implemented on Windows");
-  return PLUS_FAIL;
+  return GetModemLine(CommHandle, TIOCM_CTS, onOff);
+#endif
+}
+
+//----------------------------------------------------------------------------
+PlusStatus SerialLine::StartReceiving(BYTE frameDelimiter, const FrameReceivedCallbackType& callback, int maxFrameLengthBytes /*= 4096*/)
+{
+  if (CommHandle == INVALID_HANDLE_VALUE)
+  {
+    LOG_ERROR("SerialLine::StartReceiving failed: the serial port is not open");
+    return PLUS_FAIL;
+  }
+  if (!callback || maxFrameLengthBytes <= 0)
+  {
+    LOG_ERROR("SerialLine::StartReceiving failed: invalid callback or maximum frame length");
+    return PLUS_FAIL;
+  }
+  this->StopReceiving();
+
+  this->FrameDelimiter = frameDelimiter;
+  this->FrameReceivedCallback = callback;
+  this->MaxFrameLengthBytes = maxFrameLengthBytes;
+  this->CurrentFrame.clear();
+  this->CurrentFrame.reserve(maxFrameLengthBytes);
+  this->StopReceivingRequested = false;
+#ifdef _WIN32
+  if (!SetCommMask(CommHandle, EV_RXCHAR))
+  {
+    LOG_ERROR("SerialLine::StartReceiving failed: unable to set the communication event mask");
+    return PLUS_FAIL;
+  }
+#endif
+  this->ReceiveThread = std::thread(&SerialLine::ReceiveThreadFunction, this);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void SerialLine::StopReceiving()
+{
+  if (!this->ReceiveThread.joinable())
+  {
+    return;
+  }
+  this->StopReceivingRequested = true;
+#ifdef _WIN32
+  // completes the pending WaitCommEvent
+  SetCommMask(CommHandle, 0);
 #endif
+  this->ReceiveThread.join();
+}
+
+//----------------------------------------------------------------------------
+void SerialLine::ReceiveThreadFunction()
+{
+  std::vector<BYTE> receivedBytes(this->MaxFrameLengthBytes);
+#ifdef _WIN32
+  OVERLAPPED overlapped = { 0 };
+  overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+  while (!this->StopReceivingRequested)
+  {
+    DWORD eventMask = 0;
+    ResetEvent(overlapped.hEvent);
+    if (!WaitCommEvent(CommHandle, &eventMask, &overlapped))
+    {
+      if (GetLastError() != ERROR_IO_PENDING)
+      {
+        LOG_ERROR("SerialLine receive failed: unable to wait for incoming data");
+        break;
+      }
+      DWORD waitResult = WAIT_TIMEOUT;
+      while (!this->StopReceivingRequested && (waitResult = WaitForSingleObject(overlapped.hEvent, RECEIVE_WAIT_TIMEOUT_MSEC)) == WAIT_TIMEOUT)
+      {
+      }
+      DWORD unused = 0;
+      if (waitResult != WAIT_OBJECT_0)
+      {
+        // stop requested, StopReceiving has completed the wait by clearing the event mask
+        GetOverlappedResult(CommHandle, &overlapped, &unused, TRUE);
+        break;
+      }
+      GetOverlappedResult(CommHandle, &overlapped, &unused, FALSE);
+    }
+    // the earliest time the received bytes are visible to the application
+    const double timestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+
+    // read all the bytes that are in the input queue, this completes immediately
+    unsigned int numberOfBytesAvailable = 0;
+    while (!this->StopReceivingRequested && (numberOfBytesAvailable = this->GetNumberOfBytesAvailableForReading()) > 0)
+    {
+      DWORD numberOfBytesRead = 0;
+      DWORD numberOfBytesToRead = std::min<DWORD>(numberOfBytesAvailable, static_cast<DWORD>(receivedBytes.size()));
+      if (!ReadFileAndWait(CommHandle, &receivedBytes[0], numberOfBytesToRead, numberOfBytesRead) || numberOfBytesRead == 0)
+      {
+        break;
+      }
+      this->ProcessReceivedBytes(&receivedBytes[0], static_cast<int>(numberOfBytesRead), timestamp);
+    }
+  }
+  CloseHandle(overlapped.hEvent);
+#else
+  while (!this->StopReceivingRequested)
+  {
+    if (!WaitForPort(CommHandle, POLLIN, RECEIVE_WAIT_TIMEOUT_MSEC))
+    {
+      continue;
+    }
+    // the earliest time the received bytes are visible to the application
+    const double timestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+
+    ssize_t numberOfBytesRead = 0;
+    while (!this->StopReceivingRequested && (numberOfBytesRead = read(CommHandle, &receivedBytes[0], receivedBytes.size())) > 0)
+    {
+      this->ProcessReceivedBytes(&receivedBytes[0], static_cast<int>(numberOfBytesRead), timestamp);
+    }
+    if (numberOfBytesRead < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+    {
+      LOG_ERROR("SerialLine receive failed: unable to read from the serial port");
+      break;
+    }
+  }
+#endif
+}
+
+//----------------------------------------------------------------------------
+void SerialLine::ProcessReceivedBytes(const BYTE* data, int numberOfBytes, double timestamp)
+{
+  for (int i = 0; i < numberOfBytes; ++i)
+  {
+    if (this->CurrentFrame.empty())
+    {
+      this->CurrentFrameTimestamp = timestamp;
+    }
+    this->CurrentFrame.push_back(data[i]);
+    if (data[i] == this->FrameDelimiter || static_cast<int>(this->CurrentFrame.size()) >= this->MaxFrameLengthBytes)
+    {
+      this->FrameReceivedCallback(&this->CurrentFrame[0], static_cast<int>(this->CurrentFrame.size()), this->CurrentFrameTimestamp);
+      this->CurrentFrame.clear();
+    }
+  }
 }
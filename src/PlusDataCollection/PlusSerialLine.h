@@ -14,14 +14,22 @@ See License.txt for details.
   #define INVALID_HANDLE_VALUE (-1)
 #endif
 
+#include <atomic>
+#include <functional>
 #include <string>
+#include <thread>
+#include <vector>
 
 /*!
 \class SerialLine
 \brief Class for reading and writing data through the serial (RS-232) port
 
-The class currently only works on Windows. If serial communication is needed on other platforms then
-sample code can be found in src\Utilities\ndicapi\ndicapi_serial.* or at https://github.com/wjwwood/serial.
+The port is opened for overlapped I/O on Windows and for non-blocking I/O on POSIX systems (termios), Read and Write
+wait for the completion of the operation, bounded by MaxReplyTime.
+
+Instead of polling the port with Read, incoming data can be received on a background thread (StartReceiving): the thread
+waits for incoming bytes (WaitCommEvent on Windows, poll on POSIX systems), splits the received bytes into frames at the
+frame delimiter, and calls the callback with each frame and the time when its first byte was received.
 
 \ingroup PlusLibDataCollection
 */
@@ -39,6 +47,12 @@ public:
   typedef int HANDLE;
 #endif
 
+  /*!
+    Called by the receive thread for each received frame: the received bytes up to and including the frame delimiter.
+    The timestamp is the system time (see vtkIGSIOAccurateTimer) when the first byte of the frame was received.
+  */
+  typedef std::function<void(const BYTE* frame, int numberOfBytes, double timestamp)> FrameReceivedCallbackType;
+
   SerialLine();
   virtual ~SerialLine();
 
@@ -95,11 +109,38 @@ public:
   /*! Clears the device's error flag to enable additional input and output (I/O) operations  */
   DWORD ClearError();
 
+  /*!
+    Start receiving data on a background thread, the callback is called for each frame (see FrameReceivedCallbackType).
+    Frames longer than maxFrameLengthBytes are passed to the callback in parts. Read must not be used while receiving,
+    Write can be used (e.g., to send requests that the replies of are processed by the callback).
+  */
+  PlusStatus StartReceiving(BYTE frameDelimiter, const FrameReceivedCallbackType& callback, int maxFrameLengthBytes = 4096);
+
+  /*! Stop the receive thread. Bytes of an incomplete frame are discarded. */
+  void StopReceiving();
+
+  bool IsReceiving() const { return this->ReceiveThread.joinable(); }
+
 private:
+  /*! Wait for incoming bytes and pass the frames to the callback until StopReceivingRequested is set */
+  void ReceiveThreadFunction();
+
+  /*! Append received bytes to the current frame and pass the completed frames to the callback */
+  void ProcessReceivedBytes(const BYTE* data, int numberOfBytes, double timestamp);
+
   HANDLE      CommHandle;
   std::string PortName;
   DWORD       SerialPortSpeed;
   int         MaxReplyTime;
+
+  std::thread               ReceiveThread;
+  std::atomic<bool>         StopReceivingRequested;
+  FrameReceivedCallbackType FrameReceivedCallback;
+  BYTE                      FrameDelimiter;
+  int                       MaxFrameLengthBytes;
+  /*! Bytes of the frame that is being received, the buffer is reused for all frames */
+  std::vector<BYTE>         CurrentFrame;
+  double                    CurrentFrameTimestamp;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,507 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusSharedMemoryRing.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#if defined(_WIN32)
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+namespace
+{
+  // "PLSM"
+  const uint32_t RING_MAGIC = 0x4D534C50;
+  const uint32_t RING_VERSION = 1;
+
+  // The slots start at page boundaries, so that large images can be copied efficiently
+  const size_t RING_ALIGNMENT = 4096;
+
+  //----------------------------------------------------------------------------
+  size_t RoundUp(size_t size, size_t alignment)
+  {
+    return (size + alignment - 1) / alignment * alignment;
+  }
+
+#if !defined(_WIN32)
+  //----------------------------------------------------------------------------
+  // POSIX shared memory object names must start with a slash
+  std::string GetSharedMemoryObjectName(const std::string& name)
+  {
+    return (!name.empty() && name[0] == '/') ? name : "/" + name;
+  }
+#endif
+}
+
+//----------------------------------------------------------------------------
+// Beginning of the shared memory region. Only fixed size types and lock-free atomics are used.
+struct SharedMemoryRing::RingHeader
+{
+  /*! Set to RING_MAGIC when the ring is fully initialized */
+  std::atomic<uint32_t> Magic;
+  uint32_t Version;
+  uint32_t NumberOfItems;
+  uint32_t Reserved;
+  uint64_t ItemCapacityBytes;
+  uint64_t SlotStride;
+  std::atomic<uint64_t> LatestItemUid;
+  std::atomic<uint32_t> Closed;
+};
+
+//----------------------------------------------------------------------------
+// Beginning of each slot, followed by the image data and the field data.
+struct SharedMemoryRing::SlotHeader
+{
+  /*! 2*uid-1 while item uid is written, 2*uid when item uid is complete */
+  std::atomic<uint64_t> Sequence;
+  ItemInfo Info;
+};
+
+//----------------------------------------------------------------------------
+SharedMemoryRing::ItemInfo::ItemInfo()
+  : Uid(0)
+  , FilteredTimestamp(0)
+  , UnfilteredTimestamp(0)
+  , ScalarType(0)
+  , NumberOfScalarComponents(0)
+  , ImageType(0)
+  , ImageOrientation(0)
+  , Reserved(0)
+  , ImageDataSizeBytes(0)
+  , FieldDataSizeBytes(0)
+{
+  this->FrameSize[0] = 0;
+  this->FrameSize[1] = 0;
+  this->FrameSize[2] = 0;
+}
+
+//----------------------------------------------------------------------------
+SharedMemoryRing::SharedMemoryRing()
+  : Publisher(false)
+  , Header(NULL)
+  , Region(NULL)
+  , RegionSize(0)
+  , SlotStride(0)
+#if defined(_WIN32)
+  , MappingHandle(NULL)
+#else
+  , FileDescriptor(-1)
+#endif
+{
+}
+
+//----------------------------------------------------------------------------
+SharedMemoryRing::~SharedMemoryRing()
+{
+  this->Close();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus SharedMemoryRing::Create(const std::string& name, unsigned int numberOfItems, size_t itemCapacityBytes)
+{
+  this->Close();
+
+  if (name.empty() || numberOfItems == 0)
+  {
+    LOG_ERROR("Cannot create shared memory ring: name must not be empty and the number of items must be positive");
+    return PLUS_FAIL;
+  }
+
+  const size_t headerSize = RoundUp(sizeof(RingHeader), RING_ALIGNMENT);
+  const size_t slotStride = RoundUp(sizeof(SlotHeader), 64) + RoundUp(itemCapacityBytes, RING_ALIGNMENT);
+  const size_t regionSize = headerSize + slotStride * numberOfItems;
+
+#if defined(_WIN32)
+  // The mapping exists as long as any process has a handle to it. If a consumer still keeps the mapping
+  // of a previous publisher open then it is reused (if it is large enough), which the consumer detects from the UIDs.
+  ULARGE_INTEGER mappingSize;
+  mappingSize.QuadPart = regionSize;
+  HANDLE mappingHandle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, mappingSize.HighPart, mappingSize.LowPart, name.c_str());
+  if (mappingHandle == NULL)
+  {
+    LOG_ERROR("Failed to create shared memory " << name << " (error code: " << GetLastError() << ")");
+    return PLUS_FAIL;
+  }
+  void* pointer = MapViewOfFile(mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+  MEMORY_BASIC_INFORMATION memoryInfo;
+  if (pointer == NULL || VirtualQuery(pointer, &memoryInfo, sizeof(memoryInfo)) == 0 || memoryInfo.RegionSize < regionSize)
+  {
+    LOG_ERROR("Failed to map shared memory " << name << ", it may be used by another publisher with a smaller size");
+    if (pointer != NULL)
+    {
+      UnmapViewOfFile(pointer);
+    }
+    CloseHandle(mappingHandle);
+    return PLUS_FAIL;
+  }
+  this->MappingHandle = mappingHandle;
+#else
+  std::string objectName = GetSharedMemoryObjectName(name);
+
+  // Notify the consumers of a previous publisher that has not closed the ring, then replace the ring
+  int previousFileDescriptor = shm_open(objectName.c_str(), O_RDWR, 0);
+  if (previousFileDescriptor >= 0)
+  {
+    void* previousPointer = mmap(NULL, sizeof(RingHeader), PROT_READ | PROT_WRITE, MAP_SHARED, previousFileDescriptor, 0);
+    if (previousPointer != MAP_FAILED)
+    {
+      static_cast<RingHeader*>(previousPointer)->Closed = 1;
+      munmap(previousPointer, sizeof(RingHeader));
+    }
+    close(previousFileDescriptor);
+    shm_unlink(objectName.c_str());
+  }
+
+  int fileDescriptor = shm_open(objectName.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (fileDescriptor < 0)
+  {
+    LOG_ERROR("Failed to create shared memory " << objectName << " (error code: " << errno << ")");
+    return PLUS_FAIL;
+  }
+  void* pointer = MAP_FAILED;
+  if (ftruncate(fileDescriptor, static_cast<off_t>(regionSize)) == 0)
+  {
+    pointer = mmap(NULL, regionSize, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+  }
+  if (pointer == MAP_FAILED)
+  {
+    LOG_ERROR("Failed to allocate " << regionSize << " bytes of shared memory " << objectName << " (error code: " << errno << ")");
+    close(fileDescriptor);
+    shm_unlink(objectName.c_str());
+    return PLUS_FAIL;
+  }
+  this->FileDescriptor = fileDescriptor;
+#endif
+
+  this->Name = name;
+  this->Publisher = true;
+  this->Region = static_cast<unsigned char*>(pointer);
+  this->RegionSize = regionSize;
+  this->SlotStride = slotStride;
+  this->Header = reinterpret_cast<RingHeader*>(this->Region);
+
+  // Consumers do not use the ring until the magic number is set
+  this->Header->Magic.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  new (&this->Header->LatestItemUid) std::atomic<uint64_t>(0);
+  new (&this->Header->Closed) std::atomic<uint32_t>(0);
+  this->Header->Version = RING_VERSION;
+  this->Header->NumberOfItems = numberOfItems;
+  this->Header->Reserved = 0;
+  this->Header->ItemCapacityBytes = itemCapacityBytes;
+  this->Header->SlotStride = slotStride;
+  for (unsigned int i = 0; i < numberOfItems; ++i)
+  {
+    SlotHeader* slot = reinterpret_cast<SlotHeader*>(this->Region + headerSize + i * slotStride);
+    new (&slot->Sequence) std::atomic<uint64_t>(0);
+  }
+  this->Header->Magic.store(RING_MAGIC, std::memory_order_release);
+
+  LOG_DEBUG("Created shared memory ring " << name << " with " << numberOfItems << " items of " << itemCapacityBytes << " bytes");
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus SharedMemoryRing::Open(const std::string& name)
+{
+  this->Close();
+
+#if defined(_WIN32)
+  HANDLE mappingHandle = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+  if (mappingHandle == NULL)
+  {
+    LOG_DEBUG("Shared memory " << name << " is not available (error code: " << GetLastError() << ")");
+    return PLUS_FAIL;
+  }
+  void* pointer = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+  MEMORY_BASIC_INFORMATION memoryInfo;
+  if (pointer == NULL || VirtualQuery(pointer, &memoryInfo, sizeof(memoryInfo)) == 0)
+  {
+    LOG_ERROR("Failed to map shared memory " << name << " (error code: " << GetLastError() << ")");
+    if (pointer != NULL)
+    {
+      UnmapViewOfFile(pointer);
+    }
+    CloseHandle(mappingHandle);
+    return PLUS_FAIL;
+  }
+  size_t regionSize = memoryInfo.RegionSize;
+  this->MappingHandle = mappingHandle;
+#else
+  std::string objectName = GetSharedMemoryObjectName(name);
+  int fileDescriptor = shm_open(objectName.c_str(), O_RDONLY, 0);
+  if (fileDescriptor < 0)
+  {
+    LOG_DEBUG("Shared memory " << objectName << " is not available (error code: " << errno << ")");
+    return PLUS_FAIL;
+  }
+  struct stat fileStatus;
+  void* pointer = MAP_FAILED;
+  if (fstat(fileDescriptor, &fileStatus) == 0 && static_cast<size_t>(fileStatus.st_size) >= sizeof(RingHeader))
+  {
+    pointer = mmap(NULL, static_cast<size_t>(fileStatus.st_size), PROT_READ, MAP_SHARED, fileDescriptor, 0);
+  }
+  if (pointer == MAP_FAILED)
+  {
+    LOG_DEBUG("Failed to map shared memory " << objectName << ", the publisher may not have initialized it yet");
+    close(fileDescriptor);
+    return PLUS_FAIL;
+  }
+  size_t regionSize = static_cast<size_t>(fileStatus.st_size);
+  this->FileDescriptor = fileDescriptor;
+#endif
+
+  this->Name = name;
+  this->Publisher = false;
+  this->Region = static_cast<unsigned char*>(pointer);
+  this->RegionSize = regionSize;
+  this->Header = reinterpret_cast<RingHeader*>(this->Region);
+
+  if (this->Header->Magic.load(std::memory_order_acquire) != RING_MAGIC)
+  {
+    LOG_DEBUG("Shared memory " << name << " is not initialized yet");
+    this->Close();
+    return PLUS_FAIL;
+  }
+  const size_t headerSize = RoundUp(sizeof(RingHeader), RING_ALIGNMENT);
+  if (this->Header->Version != RING_VERSION
+      || this->Header->NumberOfItems == 0
+      || this->Header->SlotStride < sizeof(SlotHeader) + this->Header->ItemCapacityBytes
+      || headerSize + this->Header->SlotStride * this->Header->NumberOfItems > this->RegionSize)
+  {
+    LOG_ERROR("Shared memory " << name << " does not contain a valid frame ring (version: " << this->Header->Version << ")");
+    this->Close();
+    return PLUS_FAIL;
+  }
+  this->SlotStride = static_cast<size_t>(this->Header->SlotStride);
+
+  LOG_DEBUG("Opened shared memory ring " << name << " with " << this->Header->NumberOfItems << " items");
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void SharedMemoryRing::Close()
+{
+  if (this->Header == NULL)
+  {
+    return;
+  }
+
+  if (this->Publisher)
+  {
+    this->Header->Closed.store(1, std::memory_order_release);
+  }
+
+#if defined(_WIN32)
+  UnmapViewOfFile(this->Region);
+  CloseHandle(static_cast<HANDLE>(this->MappingHandle));
+  this->MappingHandle = NULL;
+#else
+  munmap(this->Region, this->RegionSize);
+  close(this->FileDescriptor);
+  this->FileDescriptor = -1;
+  if (this->Publisher)
+  {
+    // Consumers that have the ring open keep their mapping until they close it
+    shm_unlink(GetSharedMemoryObjectName(this->Name).c_str());
+  }
+#endif
+
+  this->Header = NULL;
+  this->Region = NULL;
+  this->RegionSize = 0;
+  this->SlotStride = 0;
+  this->Publisher = false;
+}
+
+//----------------------------------------------------------------------------
+bool SharedMemoryRing::IsClosedByPublisher() const
+{
+  return this->Header != NULL && this->Header->Closed.load(std::memory_order_acquire) != 0;
+}
+
+//----------------------------------------------------------------------------
+unsigned int SharedMemoryRing::GetNumberOfItems() const
+{
+  return this->Header != NULL ? this->Header->NumberOfItems : 0;
+}
+
+//----------------------------------------------------------------------------
+size_t SharedMemoryRing::GetItemCapacityBytes() const
+{
+  return this->Header != NULL ? static_cast<size_t>(this->Header->ItemCapacityBytes) : 0;
+}
+
+//----------------------------------------------------------------------------
+SharedMemoryRing::SlotHeader* SharedMemoryRing::GetSlot(BufferItemUidType uid) const
+{
+  const size_t headerSize = RoundUp(sizeof(RingHeader), RING_ALIGNMENT);
+  size_t slotIndex = static_cast<size_t>((uid - 1) % this->Header->NumberOfItems);
+  return reinterpret_cast<SlotHeader*>(this->Region + headerSize + slotIndex * this->SlotStride);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus SharedMemoryRing::AddItem(ItemInfo& info, const void* imageData, size_t imageDataSizeBytes, const std::string& fieldData)
+{
+  if (this->Header == NULL || !this->Publisher)
+  {
+    LOG_ERROR("Cannot add item to shared memory ring " << this->Name << ": the ring is not created by this process");
+    return PLUS_FAIL;
+  }
+  if (imageDataSizeBytes + fieldData.size() > this->Header->ItemCapacityBytes)
+  {
+    LOG_ERROR("Cannot add item to shared memory ring " << this->Name << ": item size (" << imageDataSizeBytes + fieldData.size()
+              << " bytes) is larger than the capacity (" << this->Header->ItemCapacityBytes << " bytes)");
+    return PLUS_FAIL;
+  }
+
+  uint64_t uid = this->Header->LatestItemUid.load(std::memory_order_relaxed) + 1;
+  info.Uid = uid;
+  info.ImageDataSizeBytes = imageDataSizeBytes;
+  info.FieldDataSizeBytes = fieldData.size();
+
+  SlotHeader* slot = this->GetSlot(uid);
+  unsigned char* slotData = reinterpret_cast<unsigned char*>(slot) + RoundUp(sizeof(SlotHeader), 64);
+  slot->Sequence.store(2 * uid - 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(&slot->Info, &info, sizeof(ItemInfo));
+  if (imageDataSizeBytes > 0)
+  {
+    memcpy(slotData, imageData, imageDataSizeBytes);
+  }
+  if (!fieldData.empty())
+  {
+    memcpy(slotData + imageDataSizeBytes, fieldData.data(), fieldData.size());
+  }
+  slot->Sequence.store(2 * uid, std::memory_order_release);
+  this->Header->LatestItemUid.store(uid, std::memory_order_release);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+BufferItemUidType SharedMemoryRing::GetLatestItemUid() const
+{
+  return this->Header != NULL ? this->Header->LatestItemUid.load(std::memory_order_acquire) : 0;
+}
+
+//----------------------------------------------------------------------------
+BufferItemUidType SharedMemoryRing::GetOldestItemUid() const
+{
+  BufferItemUidType latestUid = this->GetLatestItemUid();
+  if (latestUid == 0)
+  {
+    return 0;
+  }
+  BufferItemUidType numberOfItems = this->Header->NumberOfItems;
+  return (latestUid > numberOfItems) ? latestUid - numberOfItems + 1 : 1;
+}
+
+//----------------------------------------------------------------------------
+ItemStatus SharedMemoryRing::GetItem(BufferItemUidType uid, ItemInfo& info, const unsigned char*& imageData, const char*& fieldData) const
+{
+  imageData = NULL;
+  fieldData = NULL;
+  if (this->Header == NULL || uid == 0)
+  {
+    return ITEM_UNKNOWN_ERROR;
+  }
+  if (uid > this->GetLatestItemUid())
+  {
+    return ITEM_NOT_AVAILABLE_YET;
+  }
+
+  const SlotHeader* slot = this->GetSlot(uid);
+  if (slot->Sequence.load(std::memory_order_acquire) != 2 * uid)
+  {
+    return ITEM_NOT_AVAILABLE_ANYMORE;
+  }
+  memcpy(&info, &slot->Info, sizeof(ItemInfo));
+  // If the slot is being overwritten then the sizes may be invalid, do not return pointers outside of the slot
+  if (info.ImageDataSizeBytes + info.FieldDataSizeBytes > this->Header->ItemCapacityBytes || !this->IsItemValid(uid))
+  {
+    return ITEM_NOT_AVAILABLE_ANYMORE;
+  }
+  const unsigned char* slotData = reinterpret_cast<const unsigned char*>(slot) + RoundUp(sizeof(SlotHeader), 64);
+  imageData = slotData;
+  fieldData = reinterpret_cast<const char*>(slotData + info.ImageDataSizeBytes);
+  return ITEM_OK;
+}
+
+//----------------------------------------------------------------------------
+bool SharedMemoryRing::IsItemValid(BufferItemUidType uid) const
+{
+  if (this->Header == NULL || uid == 0)
+  {
+    return false;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return this->GetSlot(uid)->Sequence.load(std::memory_order_relaxed) == 2 * uid;
+}
+
+//----------------------------------------------------------------------------
+ItemStatus SharedMemoryRing::CopyItem(BufferItemUidType uid, ItemInfo& info, std::vector<unsigned char>& imageData, std::string& fieldData) const
+{
+  const unsigned char* imageDataInRing = NULL;
+  const char* fieldDataInRing = NULL;
+  ItemStatus status = this->GetItem(uid, info, imageDataInRing, fieldDataInRing);
+  if (status != ITEM_OK)
+  {
+    return status;
+  }
+  imageData.assign(imageDataInRing, imageDataInRing + info.ImageDataSizeBytes);
+  fieldData.assign(fieldDataInRing, fieldDataInRing + info.FieldDataSizeBytes);
+  if (!this->IsItemValid(uid))
+  {
+    return ITEM_NOT_AVAILABLE_ANYMORE;
+  }
+  return ITEM_OK;
+}
+
+//----------------------------------------------------------------------------
+void SharedMemoryRing::EncodeFields(const std::map<std::string, std::string>& fields, std::string& fieldData)
+{
+  // name and value are terminated by a zero character
+  fieldData.clear();
+  for (std::map<std::string, std::string>::const_iterator fieldIt = fields.begin(); fieldIt != fields.end(); ++fieldIt)
+  {
+    fieldData.append(fieldIt->first.c_str(), fieldIt->first.size() + 1);
+    fieldData.append(fieldIt->second.c_str(), fieldIt->second.size() + 1);
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus SharedMemoryRing::DecodeFields(const char* fieldData, size_t fieldDataSizeBytes, std::map<std::string, std::string>& fields)
+{
+  fields.clear();
+  const char* position = fieldData;
+  const char* end = fieldData + fieldDataSizeBytes;
+  while (position < end)
+  {
+    const char* nameEnd = static_cast<const char*>(memchr(position, 0, end - position));
+    if (nameEnd == NULL)
+    {
+      return PLUS_FAIL;
+    }
+    const char* valueEnd = static_cast<const char*>(memchr(nameEnd + 1, 0, end - (nameEnd + 1)));
+    if (valueEnd == NULL)
+    {
+      return PLUS_FAIL;
+    }
+    fields[std::string(position, nameEnd)] = std::string(nameEnd + 1, valueEnd);
+    position = valueEnd + 1;
+  }
+  return PLUS_SUCCESS;
+}
@@ -0,0 +1,146 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __SharedMemoryRing_h
+#define __SharedMemoryRing_h
+
+#include "vtkPlusDataCollectionExport.h"
+
+#include "PlusConfigure.h"
+#include "PlusStreamBufferItem.h"
+#include "vtkPlusTimestampedCircularBuffer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+/*!
+  \class SharedMemoryRing
+  \brief Circular buffer of frames in a named shared memory region, for passing frames to other processes on the same computer.
+
+  One process creates the ring (publisher) and any number of processes can open it for reading (consumers).
+  Each item contains the image pixels, the image geometry, the timestamps and the frame fields (including the transforms)
+  of one frame. Items are identified by UIDs that are incremented by one for each new item, starting from 1 (the same way
+  as in vtkPlusBuffer). Timestamps are stored as universal time (seconds since 1970), because the system time is process specific.
+
+  The writer never waits for the readers: each slot has a sequence number that the writer updates before and after
+  writing the slot, so readers can detect when an item was overwritten while they were reading it.
+  GetItem provides direct (zero-copy) access to the item in the shared memory: after processing the data the reader
+  has to call IsItemValid to check that the item was not overwritten meanwhile. CopyItem copies the item and checks validity.
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport SharedMemoryRing
+{
+public:
+  /*! Description of an item. Only fixed size types are used, because the structure is shared between processes. */
+  struct ItemInfo
+  {
+    ItemInfo();
+    uint64_t Uid;
+    double FilteredTimestamp;
+    double UnfilteredTimestamp;
+    uint32_t FrameSize[3];
+    /*! VTK scalar type of the pixels */
+    int32_t ScalarType;
+    uint32_t NumberOfScalarComponents;
+    /*! US_IMAGE_TYPE */
+    int32_t ImageType;
+    /*! US_IMAGE_ORIENTATION */
+    int32_t ImageOrientation;
+    uint32_t Reserved;
+    uint64_t ImageDataSizeBytes;
+    uint64_t FieldDataSizeBytes;
+  };
+
+  SharedMemoryRing();
+  virtual ~SharedMemoryRing();
+
+  /*!
+    Create a new ring for publishing items. If a ring already exists with the same name (for example, because the
+    publisher stopped without closing it) then it is replaced.
+    \param name Name of the shared memory region, the consumers open the ring by this name
+    \param numberOfItems Number of items stored in the ring
+    \param itemCapacityBytes Maximum size of the image and field data of one item
+  */
+  PlusStatus Create(const std::string& name, unsigned int numberOfItems, size_t itemCapacityBytes);
+
+  /*! Open an existing ring for reading */
+  PlusStatus Open(const std::string& name);
+
+  /*! Close the ring. The publisher marks the ring as closed, so that the consumers know that no more items will arrive. */
+  void Close();
+
+  bool IsOpen() const { return this->Header != NULL; }
+  bool IsPublisher() const { return this->Publisher; }
+
+  /*! Returns true if the publisher closed the ring (consumers should reopen the ring to receive items from a new publisher) */
+  bool IsClosedByPublisher() const;
+
+  const std::string& GetName() const { return this->Name; }
+  unsigned int GetNumberOfItems() const;
+  size_t GetItemCapacityBytes() const;
+
+  /*!
+    Add a new item (only for the publisher). The oldest item is overwritten if the ring is full.
+    \param info Description of the item, Uid, ImageDataSizeBytes and FieldDataSizeBytes are set by this method
+    \param imageData Pixels of the image, may be NULL if imageDataSizeBytes is 0
+    \param fieldData Encoded frame fields, see EncodeFields
+  */
+  PlusStatus AddItem(ItemInfo& info, const void* imageData, size_t imageDataSizeBytes, const std::string& fieldData);
+
+  /*! UID of the most recent item, 0 if the ring is empty */
+  BufferItemUidType GetLatestItemUid() const;
+
+  /*! UID of the oldest item that is still in the ring, 0 if the ring is empty */
+  BufferItemUidType GetOldestItemUid() const;
+
+  /*!
+    Get direct access to an item in the shared memory, without copying.
+    The data may be overwritten by the publisher at any time, after the data is processed IsItemValid must be called
+    and the results must be discarded if the item is not valid anymore.
+  */
+  ItemStatus GetItem(BufferItemUidType uid, ItemInfo& info, const unsigned char*& imageData, const char*& fieldData) const;
+
+  /*! Returns true if the item has not been overwritten since it was added */
+  bool IsItemValid(BufferItemUidType uid) const;
+
+  /*! Copy an item from the shared memory. Returns ITEM_NOT_AVAILABLE_ANYMORE if the item was overwritten while copying. */
+  ItemStatus CopyItem(BufferItemUidType uid, ItemInfo& info, std::vector<unsigned char>& imageData, std::string& fieldData) const;
+
+  /*! Encode frame fields (name and value pairs) into a string that can be stored in an item */
+  static void EncodeFields(const std::map<std::string, std::string>& fields, std::string& fieldData);
+
+  /*! Decode frame fields that were encoded by EncodeFields */
+  static PlusStatus DecodeFields(const char* fieldData, size_t fieldDataSizeBytes, std::map<std::string, std::string>& fields);
+
+protected:
+  struct RingHeader;
+  struct SlotHeader;
+
+  /*! Slot that stores the item with the specified UID */
+  SlotHeader* GetSlot(BufferItemUidType uid) const;
+
+  std::string Name;
+  bool Publisher;
+  RingHeader* Header;
+  unsigned char* Region;
+  size_t RegionSize;
+  size_t SlotStride;
+#if defined(_WIN32)
+  void* MappingHandle;
+#else
+  int FileDescriptor;
+#endif
+
+private:
+  SharedMemoryRing(const SharedMemoryRing&);
+  void operator=(const SharedMemoryRing&);
+};
+
+#endif
@@ -8,6 +8,9 @@
 #include "PlusStreamBufferItem.h"
 #include "vtkMatrix4x4.h"
 
+// VTK includes
+#include <vtkImageData.h>
+
 //----------------------------------------------------------------------------
 //            DataBufferItem
 //----------------------------------------------------------------------------
@@ -17,7 +20,6 @@ StreamBufferItem::StreamBufferItem()
   , Index(0)
   , Uid(0)
   , ValidTransformData(false)
-  , Matrix(vtkSmartPointer<vtkMatrix4x4>::New())
   , Status(TOOL_OK)
 {
 }
@@ -30,7 +32,6 @@ StreamBufferItem::~StreamBufferItem()
 //----------------------------------------------------------------------------
 StreamBufferItem::StreamBufferItem(const StreamBufferItem& dataItem)
 {
-  this->Matrix = vtkSmartPointer<vtkMatrix4x4>::New();
   this->Status = TOOL_OK;
   *this = dataItem;
 }
@@ -44,24 +45,37 @@ StreamBufferItem& StreamBufferItem::operator=(StreamBufferItem const& dataItem)
     return *this;
   }
 
+  // The frame assignment copies the pixels into the existing pixel array, which must not be shared with other frames
+  DetachFrameImage(this->Frame);
   this->Frame = dataItem.Frame;
+  this->CopyItemProperties(dataItem);
+
+  return *this;
+}
+
+//----------------------------------------------------------------------------
+void StreamBufferItem::CopyItemProperties(const StreamBufferItem& dataItem)
+{
   this->FilteredTimeStamp = dataItem.FilteredTimeStamp;
   this->UnfilteredTimeStamp = dataItem.UnfilteredTimeStamp;
   this->Index = dataItem.Index;
   this->Uid = dataItem.Uid;
   this->FrameFields = dataItem.FrameFields;
   this->Status = dataItem.Status;
-  this->Matrix->DeepCopy(dataItem.Matrix);
+  this->Transform = dataItem.Transform;
   this->ValidTransformData = dataItem.ValidTransformData;
+}
 
-  return *this;
+//----------------------------------------------------------------------------
+void StreamBufferItem::SetFrameField(const std::string& fieldName, const std::string& fieldValue, igsioFrameFieldFlags flags)
+{
+  this->FrameFields.SetField(fieldName, fieldValue, flags);
 }
 
 //----------------------------------------------------------------------------
-void StreamBufferItem::SetFrameField(std::string fieldName, std::string fieldValue, igsioFrameFieldFlags flags)
+void StreamBufferItem::SetFrameField(FrameFieldStore::KeyType fieldKey, const std::string& fieldValue, igsioFrameFieldFlags flags)
 {
-  this->FrameFields[fieldName].first = flags;
-  this->FrameFields[fieldName].second = fieldValue;
+  this->FrameFields.SetField(fieldKey, fieldValue, flags);
 }
 
 //----------------------------------------------------------------------------
@@ -73,15 +87,22 @@ std::string StreamBufferItem::GetFrameField(const std::string& fieldName) const
     return "";
   }
 
-  igsioFieldMapType::const_iterator fieldIterator;
-  fieldIterator = this->FrameFields.find(fieldName);
-  if (fieldIterator != this->FrameFields.end())
+  const std::string* fieldValue = this->FrameFields.GetField(fieldName);
+  if (fieldValue != NULL)
   {
-    return fieldIterator->second.second;
+    return *fieldValue;
   }
   return "";
 }
 
+//----------------------------------------------------------------------------
+igsioFieldMapType StreamBufferItem::GetFrameFieldMap() const
+{
+  igsioFieldMapType fieldMap;
+  this->FrameFields.GetFieldMap(fieldMap);
+  return fieldMap;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus StreamBufferItem::DeleteFrameField(const char* fieldName)
 {
@@ -91,10 +112,8 @@ PlusStatus StreamBufferItem::DeleteFrameField(const char* fieldName)
     return PLUS_FAIL;
   }
 
-  igsioFieldMapType::iterator field = this->FrameFields.find(fieldName);
-  if (field != this->FrameFields.end())
+  if (this->FrameFields.DeleteField(fieldName) == PLUS_SUCCESS)
   {
-    this->FrameFields.erase(field);
     return PLUS_SUCCESS;
   }
   LOG_DEBUG("Failed to delete frame field - could find field " << fieldName);
@@ -121,6 +140,71 @@ PlusStatus StreamBufferItem::DeepCopy(StreamBufferItem* dataItem)
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus StreamBufferItem::ShallowCopy(StreamBufferItem* dataItem)
+{
+  if (dataItem == NULL)
+  {
+    LOG_ERROR("Failed to shallow copy data buffer item - buffer item NULL!");
+    return PLUS_FAIL;
+  }
+
+  if (this == dataItem)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  if (ShareFrameImage(dataItem->Frame, this->Frame) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  this->CopyItemProperties(*dataItem);
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus StreamBufferItem::ShareFrameImage(igsioVideoFrame& source, igsioVideoFrame& target)
+{
+  if (&source == &target)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  if (source.IsFrameEncoded() || target.IsFrameEncoded() || source.GetImage() == NULL)
+  {
+    DetachFrameImage(target);
+    target = source;
+    return PLUS_SUCCESS;
+  }
+
+  if (target.GetImage() == NULL)
+  {
+    // Allocate a minimal image, its contents are replaced by the shared pixels
+    FrameSizeType minimalFrameSize = { 1, 1, 1 };
+    unsigned int numberOfScalarComponents(1);
+    source.GetNumberOfScalarComponents(numberOfScalarComponents);
+    if (target.AllocateFrame(minimalFrameSize, source.GetVTKScalarPixelType(), numberOfScalarComponents) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to allocate image for sharing frame pixels");
+      return PLUS_FAIL;
+    }
+  }
+
+  target.SetImageType(source.GetImageType());
+  target.SetImageOrientation(source.GetImageOrientation());
+  // The scalar array of the image is reference counted, a shallow copy only adds a reference to it
+  target.GetImage()->ShallowCopy(source.GetImage());
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void StreamBufferItem::DetachFrameImage(igsioVideoFrame& frame)
+{
+  PlusCommon::DetachFrameImage(frame);
+}
+
 //----------------------------------------------------------------------------
 PlusStatus StreamBufferItem::SetMatrix(vtkMatrix4x4* matrix)
 {
@@ -132,7 +216,7 @@ PlusStatus StreamBufferItem::SetMatrix(vtkMatrix4x4* matrix)
 
   ValidTransformData = true;
 
-  this->Matrix->DeepCopy(matrix);
+  this->Transform.SetVtkMatrix(matrix);
 
   return PLUS_SUCCESS;
 }
@@ -146,11 +230,24 @@ PlusStatus StreamBufferItem::GetMatrix(vtkMatrix4x4* outputMatrix)
     return PLUS_FAIL;
   }
 
-  outputMatrix->DeepCopy(this->Matrix);
+  this->Transform.GetVtkMatrix(outputMatrix);
 
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+void StreamBufferItem::GetMatrixElements(double matrix[16]) const
+{
+  this->Transform.GetMatrixElements(matrix);
+}
+
+//----------------------------------------------------------------------------
+void StreamBufferItem::SetTransform(const PlusRigidTransform& transform)
+{
+  ValidTransformData = true;
+  this->Transform = transform;
+}
+
 //----------------------------------------------------------------------------
 void StreamBufferItem::SetStatus(ToolStatus status)
 {
@@ -166,5 +263,5 @@ ToolStatus StreamBufferItem::GetStatus() const
 //----------------------------------------------------------------------------
 bool StreamBufferItem::HasValidFieldData() const
 {
-  return this->FrameFields.size() > 0;
+  return !this->FrameFields.IsEmpty();
 }
\ No newline at end of file
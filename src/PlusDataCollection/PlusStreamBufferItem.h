@@ -8,6 +8,8 @@ See License.txt for details.
 #define __StreamBufferItem_h
 
 #include "vtkPlusDataCollectionExport.h"
+#include "PlusFrameFieldStore.h"
+#include "PlusRigidTransform.h"
 
 // IGSIO includes
 #include <igsioCommon.h>
@@ -71,13 +73,16 @@ public:
   BufferItemUidType GetUid() { return this->Uid; };
   void SetUid(BufferItemUidType uid) { this->Uid = uid; };
 
-  /*! Set frame field */
-  void SetFrameField(std::string fieldName, std::string fieldValue, igsioFrameFieldFlags flags = FRAMEFIELD_NONE);
+  /*! Set frame field. The previous value of the field is overwritten in place, without allocating memory if possible. */
+  void SetFrameField(const std::string& fieldName, const std::string& fieldValue, igsioFrameFieldFlags flags = FRAMEFIELD_NONE);
+  void SetFrameField(FrameFieldStore::KeyType fieldKey, const std::string& fieldValue, igsioFrameFieldFlags flags = FRAMEFIELD_NONE);
 
   /*! Get frame field value */
   std::string GetFrameField(const std::string& fieldName) const;
-  /*! Get frame field map */
-  igsioFieldMapType GetFrameFieldMap() {return this->FrameFields;}
+  /*! Get frame field map. Allocates a new map, use GetFrameFields to access the fields without copying them. */
+  igsioFieldMapType GetFrameFieldMap() const;
+  /*! Get frame fields */
+  const FrameFieldStore& GetFrameFields() const { return this->FrameFields; }
   /*! Delete frame field */
   PlusStatus DeleteFrameField(const char* fieldName);
   PlusStatus DeleteFrameField(const std::string& fieldName);
@@ -85,12 +90,36 @@ public:
   /*! Copy stream buffer item */
   PlusStatus DeepCopy(StreamBufferItem* dataItem);
 
+  /*! Copy stream buffer item. The image pixels are not copied but shared (reference counted) with the source item. */
+  PlusStatus ShallowCopy(StreamBufferItem* dataItem);
+
+  /*!
+    Make the target frame use the image pixels of the source frame, without copying them.
+    Shared pixels must be treated as read-only: frames that are written in place (buffer slots, targets of
+    a StreamBufferItem assignment) release the shared pixels by DetachFrameImage first.
+    Encoded frames are deep copied.
+  */
+  static PlusStatus ShareFrameImage(igsioVideoFrame& source, igsioVideoFrame& target);
+
+  /*!
+    If the image pixels of the frame are shared with other frames then allocate new pixels for the frame
+    (the pixel values are not copied), so that writing into the frame does not modify the other frames.
+    Same as PlusCommon::DetachFrameImage, which can be used by modules that do not depend on the buffers.
+  */
+  static void DetachFrameImage(igsioVideoFrame& frame);
+
   igsioVideoFrame& GetFrame() { return this->Frame; };
 
   /*! Set tracker matrix */
   PlusStatus SetMatrix(vtkMatrix4x4* matrix);
   /*! Get tracker matrix */
   PlusStatus GetMatrix(vtkMatrix4x4* outputMatrix);
+  /*! Get tracker matrix elements (4x4, row-major) without creating a matrix object */
+  void GetMatrixElements(double matrix[16]) const;
+  /*! Set tracker transform without creating a matrix object */
+  void SetTransform(const PlusRigidTransform& transform);
+  /*! Get tracker transform */
+  const PlusRigidTransform& GetTransform() const { return this->Transform; }
 
   /*! Set tracker item status */
   void SetStatus(ToolStatus status);
@@ -106,6 +135,9 @@ public:
   }
 
 protected:
+  /*! Copy all members except the frame */
+  void CopyItemProperties(const StreamBufferItem& dataItem);
+
   double FilteredTimeStamp;
   double UnfilteredTimeStamp;
 
@@ -116,11 +148,12 @@ protected:
   BufferItemUidType Uid;
 
   /*! Custom frame fields */
-  igsioFieldMapType FrameFields;
+  FrameFieldStore FrameFields;
 
   bool ValidTransformData;
   igsioVideoFrame Frame;
-  vtkSmartPointer<vtkMatrix4x4> Matrix;
+  /*! Tracker pose, stored by value so that items can be copied and interpolated without allocating matrix objects */
+  PlusRigidTransform Transform;
   ToolStatus Status;
 };
 
@@ -0,0 +1,164 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusRigidTransform.h"
+#include "PlusTransformInterpolationBatch.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+  // If the quaternions are closer than this then linear interpolation is used instead of SLERP (same as igsioMath::Slerp)
+  const double SLERP_EPSILON = 1e-6;
+  const double RAD_TO_DEG = 57.29577951308232;
+}
+
+//----------------------------------------------------------------------------
+TransformInterpolationBatch::TransformInterpolationBatch()
+  : NumberOfEntries(0)
+{
+}
+
+//----------------------------------------------------------------------------
+void TransformInterpolationBatch::Clear()
+{
+  this->NumberOfEntries = 0;
+}
+
+//----------------------------------------------------------------------------
+int TransformInterpolationBatch::GetNumberOfEntries() const
+{
+  return this->NumberOfEntries;
+}
+
+//----------------------------------------------------------------------------
+int TransformInterpolationBatch::AddTransformPair(const double matrixA[16], const double matrixB[16], double weightB)
+{
+  int index = this->NumberOfEntries++;
+  if (static_cast<int>(this->WeightB.size()) < this->NumberOfEntries)
+  {
+    for (int i = 0; i < 4; ++i)
+    {
+      this->QuaternionA[i].resize(this->NumberOfEntries);
+      this->QuaternionB[i].resize(this->NumberOfEntries);
+      this->InterpolatedQuaternion[i].resize(this->NumberOfEntries);
+    }
+    for (int i = 0; i < 3; ++i)
+    {
+      this->TranslationA[i].resize(this->NumberOfEntries);
+      this->TranslationB[i].resize(this->NumberOfEntries);
+      this->InterpolatedTranslation[i].resize(this->NumberOfEntries);
+    }
+    this->WeightB.resize(this->NumberOfEntries);
+    this->CosAngleA.resize(this->NumberOfEntries);
+    this->CosAngleB.resize(this->NumberOfEntries);
+  }
+
+  double quaternionA[4] = {1, 0, 0, 0};
+  double quaternionB[4] = {1, 0, 0, 0};
+  MatrixToQuaternion(matrixA, quaternionA);
+  MatrixToQuaternion(matrixB, quaternionB);
+  for (int i = 0; i < 4; ++i)
+  {
+    this->QuaternionA[i][index] = quaternionA[i];
+    this->QuaternionB[i][index] = quaternionB[i];
+  }
+  for (int i = 0; i < 3; ++i)
+  {
+    this->TranslationA[i][index] = matrixA[i * 4 + 3];
+    this->TranslationB[i][index] = matrixB[i * 4 + 3];
+  }
+  this->WeightB[index] = weightB;
+  return index;
+}
+
+//----------------------------------------------------------------------------
+void TransformInterpolationBatch::Interpolate()
+{
+  const int numberOfEntries = this->NumberOfEntries;
+  const double* aw = this->QuaternionA[0].data();
+  const double* ax = this->QuaternionA[1].data();
+  const double* ay = this->QuaternionA[2].data();
+  const double* az = this->QuaternionA[3].data();
+  const double* bw = this->QuaternionB[0].data();
+  const double* bx = this->QuaternionB[1].data();
+  const double* by = this->QuaternionB[2].data();
+  const double* bz = this->QuaternionB[3].data();
+  const double* weightB = this->WeightB.data();
+  double* rw = this->InterpolatedQuaternion[0].data();
+  double* rx = this->InterpolatedQuaternion[1].data();
+  double* ry = this->InterpolatedQuaternion[2].data();
+  double* rz = this->InterpolatedQuaternion[3].data();
+  double* cosAngleA = this->CosAngleA.data();
+  double* cosAngleB = this->CosAngleB.data();
+
+  // Rotation: SLERP with sign adjustment, the loop body has no branches so that it can be vectorized
+  for (int i = 0; i < numberOfEntries; ++i)
+  {
+    double cosom = aw[i] * bw[i] + ax[i] * bx[i] + ay[i] * by[i] + az[i] * bz[i];
+    double sign = (cosom < 0.0 ? -1.0 : 1.0);
+    cosom = std::min(cosom * sign, 1.0);
+    double t = weightB[i];
+    bool linear = (1.0 - cosom) <= SLERP_EPSILON;
+    double omega = std::acos(cosom);
+    double sinom = (linear ? 1.0 : std::sin(omega));
+    double scale0 = (linear ? 1.0 - t : std::sin((1.0 - t) * omega) / sinom);
+    double scale1 = (linear ? t : std::sin(t * omega) / sinom) * sign;
+    double w = scale0 * aw[i] + scale1 * bw[i];
+    double x = scale0 * ax[i] + scale1 * bx[i];
+    double y = scale0 * ay[i] + scale1 * by[i];
+    double z = scale0 * az[i] + scale1 * bz[i];
+    double inverseNorm = 1.0 / std::sqrt(w * w + x * x + y * y + z * z);
+    rw[i] = w * inverseNorm;
+    rx[i] = x * inverseNorm;
+    ry[i] = y * inverseNorm;
+    rz[i] = z * inverseNorm;
+    cosAngleA[i] = std::fabs(rw[i] * aw[i] + rx[i] * ax[i] + ry[i] * ay[i] + rz[i] * az[i]);
+    cosAngleB[i] = std::fabs(rw[i] * bw[i] + rx[i] * bx[i] + ry[i] * by[i] + rz[i] * bz[i]);
+  }
+
+  // Translation: linear interpolation
+  for (int component = 0; component < 3; ++component)
+  {
+    const double* translationA = this->TranslationA[component].data();
+    const double* translationB = this->TranslationB[component].data();
+    double* interpolatedTranslation = this->InterpolatedTranslation[component].data();
+    for (int i = 0; i < numberOfEntries; ++i)
+    {
+      interpolatedTranslation[i] = translationA[i] * (1.0 - weightB[i]) + translationB[i] * weightB[i];
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void TransformInterpolationBatch::GetInterpolatedMatrix(int index, double matrix[16]) const
+{
+  const double quaternion[4] =
+  {
+    this->InterpolatedQuaternion[0][index], this->InterpolatedQuaternion[1][index],
+    this->InterpolatedQuaternion[2][index], this->InterpolatedQuaternion[3][index]
+  };
+  const double translation[3] = { this->InterpolatedTranslation[0][index], this->InterpolatedTranslation[1][index], this->InterpolatedTranslation[2][index] };
+  PlusRigidTransform transform;
+  transform.SetQuaternion(quaternion);
+  transform.SetTranslation(translation);
+  transform.GetMatrixElements(matrix);
+}
+
+//----------------------------------------------------------------------------
+void TransformInterpolationBatch::GetOrientationDifferences(int index, double& angleDifferenceADeg, double& angleDifferenceBDeg) const
+{
+  angleDifferenceADeg = 2.0 * std::acos(std::min(this->CosAngleA[index], 1.0)) * RAD_TO_DEG;
+  angleDifferenceBDeg = 2.0 * std::acos(std::min(this->CosAngleB[index], 1.0)) * RAD_TO_DEG;
+}
+
+//----------------------------------------------------------------------------
+void TransformInterpolationBatch::MatrixToQuaternion(const double matrix[16], double quaternion[4])
+{
+  PlusRigidTransform(matrix).GetQuaternion(quaternion);
+}
@@ -0,0 +1,75 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __TransformInterpolationBatch_h
+#define __TransformInterpolationBatch_h
+
+#include "vtkPlusDataCollectionExport.h"
+
+#include <vector>
+
+/*!
+  \class TransformInterpolationBatch
+  \brief Interpolates multiple rigid transforms in one pass.
+
+  Each entry is a pair of transforms (A and B) and the weight of B. The rotation is interpolated with SLERP
+  and the translation linearly, the same way as vtkPlusBuffer::GetInterpolatedStreamBufferItemFromTime does it for one item.
+
+  The transforms are stored as a structure of arrays (one array per quaternion and translation component)
+  and Interpolate() processes all entries in simple loops over these arrays, which the compiler can vectorize.
+
+  Typical use: Clear(), AddTransformPair() for each tool, Interpolate(), then GetInterpolatedMatrix() for each tool.
+  The allocated memory is kept by Clear(), so a batch can be reused without memory allocations.
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport TransformInterpolationBatch
+{
+public:
+  TransformInterpolationBatch();
+
+  /*! Remove all entries */
+  void Clear();
+
+  /*!
+    Add a pair of transforms. Matrices are 4x4 row-major, only the rotation and translation parts are used.
+    \param weightB Weight of transform B (0 = result is A, 1 = result is B)
+    \return Index of the entry
+  */
+  int AddTransformPair(const double matrixA[16], const double matrixB[16], double weightB);
+
+  /*! Compute the interpolated transforms of all entries */
+  void Interpolate();
+
+  int GetNumberOfEntries() const;
+
+  /*! Get the interpolated transform of an entry as a 4x4 row-major matrix. Interpolate() must be called before. */
+  void GetInterpolatedMatrix(int index, double matrix[16]) const;
+
+  /*! Get the angle (in degrees) between the interpolated rotation and the rotation of transform A and B. Interpolate() must be called before. */
+  void GetOrientationDifferences(int index, double& angleDifferenceADeg, double& angleDifferenceBDeg) const;
+
+  /*! Convert the rotation part of a 4x4 row-major matrix to a unit quaternion (w, x, y, z) */
+  static void MatrixToQuaternion(const double matrix[16], double quaternion[4]);
+
+protected:
+  int NumberOfEntries;
+
+  /*! Quaternion (w, x, y, z) and translation components of transform A and B, one element per entry */
+  std::vector<double> QuaternionA[4];
+  std::vector<double> QuaternionB[4];
+  std::vector<double> TranslationA[3];
+  std::vector<double> TranslationB[3];
+  std::vector<double> WeightB;
+
+  /*! Results, one element per entry */
+  std::vector<double> InterpolatedQuaternion[4];
+  std::vector<double> InterpolatedTranslation[3];
+  std::vector<double> CosAngleA;
+  std::vector<double> CosAngleB;
+};
+
+#endif
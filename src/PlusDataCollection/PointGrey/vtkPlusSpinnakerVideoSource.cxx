@@ -11,13 +11,22 @@ See License.txt for details.
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataSource.h"
 
+// IGSIO includes
+#include <vtkIGSIOAccurateTimer.h>
+
 // Spinnaker API includes
 #include <Spinnaker.h>
 #include <SpinGenApi/SpinnakerGenApi.h>
 
 // STL includes
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <map>
+#include <mutex>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkPlusSpinnakerVideoSource);
@@ -35,6 +44,10 @@ namespace
   const float                     FLAG_GAIN_DB(-1);
   const psvs::WHITE_BALANCE_MODE  DEFAULT_WHITE_BALANCE_MODE(psvs::WB_AUTO_CONTINUOUS);
   const float                     FLAG_WHITE_BALANCE(-1);
+  const int                       DEFAULT_STREAM_BUFFER_COUNT(10);
+
+  // received images waiting for conversion, if the conversion falls behind then the oldest images are dropped
+  const size_t                    MAX_NUMBER_OF_QUEUED_IMAGES(4);
 
   // xml attribute values
   std::string EXPOSURE_TIMED_STRING = "TIMED";
@@ -61,6 +74,7 @@ public:
 
   virtual ~vtkInternal()
   {
+    this->StopConversion();
   }
 
   // Singleton reference to system object
@@ -71,6 +85,206 @@ public:
 
   // camera pointer
   Spinnaker::CameraPtr CameraPtr;
+
+  // received image, it is released when it is converted or dropped
+  struct QueuedImage
+  {
+    Spinnaker::ImagePtr Image;
+    unsigned long FrameNumber;
+    double UnfilteredTimestamp;
+    double FilteredTimestamp;
+  };
+
+  // conversion thread: converts the received images and adds them to the video source
+  std::thread ConversionThread;
+  std::mutex QueueMutex;
+  std::condition_variable QueueCondition;
+  std::deque<QueuedImage> Queue;
+  bool StopConversionRequested = false;
+
+  // the images are converted into this buffer, which is allocated once and reused for all frames
+  std::vector<unsigned char> ConvertedPixels;
+  Spinnaker::ImagePtr ConvertedImage;
+
+  // set if the camera timestamps are used, they are converted to system time by the hardware clock of the device
+  bool HardwareTimestampsEnabled = false;
+
+  //----------------------------------------------------------------------------
+  void StartConversion()
+  {
+    this->StopConversion();
+    this->StopConversionRequested = false;
+    this->ConversionThread = std::thread(&vtkInternal::ConversionThreadFunction, this);
+  }
+
+  //----------------------------------------------------------------------------
+  void StopConversion()
+  {
+    if (!this->ConversionThread.joinable())
+    {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(this->QueueMutex);
+      this->StopConversionRequested = true;
+    }
+    this->QueueCondition.notify_all();
+    this->ConversionThread.join();
+
+    // images that were not converted are returned to the camera
+    for (std::deque<QueuedImage>::iterator it = this->Queue.begin(); it != this->Queue.end(); ++it)
+    {
+      this->ReleaseImage(it->Image);
+    }
+    this->Queue.clear();
+  }
+
+  //----------------------------------------------------------------------------
+  void QueueImage(const QueuedImage& image)
+  {
+    {
+      std::lock_guard<std::mutex> lock(this->QueueMutex);
+      if (this->Queue.size() >= MAX_NUMBER_OF_QUEUED_IMAGES)
+      {
+        LOG_WARNING("SpinnakerVideoSource: image conversion is slower than the acquisition, frame " << this->Queue.front().FrameNumber << " is dropped");
+        this->ReleaseImage(this->Queue.front().Image);
+        this->Queue.pop_front();
+      }
+      this->Queue.push_back(image);
+    }
+    this->QueueCondition.notify_one();
+  }
+
+  //----------------------------------------------------------------------------
+  void ReleaseImage(Spinnaker::ImagePtr& image)
+  {
+    try
+    {
+      image->Release();
+    }
+    catch (Spinnaker::Exception& e)
+    {
+      LOG_ERROR("SpinnakerVideoSource: Failed to release image. Exception text: " << e.what());
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void ConversionThreadFunction()
+  {
+    while (true)
+    {
+      QueuedImage image;
+      {
+        std::unique_lock<std::mutex> lock(this->QueueMutex);
+        this->QueueCondition.wait(lock, [this] { return this->StopConversionRequested || !this->Queue.empty(); });
+        if (this->StopConversionRequested)
+        {
+          return;
+        }
+        image = this->Queue.front();
+        this->Queue.pop_front();
+      }
+      this->ConvertAndAddImage(image);
+      this->ReleaseImage(image.Image);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus ConvertAndAddImage(QueuedImage& image)
+  {
+    vtkPlusDataSource* videoSource(NULL);
+    if (this->External->GetFirstVideoSource(videoSource) != PLUS_SUCCESS)
+    {
+      LOG_WARNING("Failed to get video source in SpinnakerVideoSource");
+      return PLUS_FAIL;
+    }
+
+    const bool rgb = (this->External->PixelEncoding == RGB24);
+    const Spinnaker::PixelFormatEnums pixelFormat = rgb ? Spinnaker::PixelFormat_RGB8 : Spinnaker::PixelFormat_Mono8;
+    const unsigned int numberOfScalarComponents = rgb ? 3 : 1;
+    const US_IMAGE_TYPE imageType = rgb ? US_IMG_RGB_COLOR : US_IMG_BRIGHTNESS;
+
+    try
+    {
+      const void* pixels = NULL;
+      if (image.Image->GetPixelFormat() == pixelFormat)
+      {
+        // camera already sends the requested format (e.g., Mono8), no conversion is needed
+        pixels = image.Image->GetData();
+      }
+      else
+      {
+        // convert into the reused buffer
+        const size_t width = image.Image->GetWidth();
+        const size_t height = image.Image->GetHeight();
+        if (!this->ConvertedImage.IsValid() || this->ConvertedImage->GetWidth() != width || this->ConvertedImage->GetHeight() != height)
+        {
+          this->ConvertedPixels.resize(width * height * numberOfScalarComponents);
+          this->ConvertedImage = Spinnaker::Image::Create(width, height, 0, 0, pixelFormat, &this->ConvertedPixels[0]);
+        }
+        image.Image->Convert(this->ConvertedImage, pixelFormat, Spinnaker::HQ_LINEAR);
+        pixels = &this->ConvertedPixels[0];
+      }
+
+      // initialize if buffer is empty
+      if (videoSource->GetNumberOfItems() == 0)
+      {
+        videoSource->SetImageType(imageType);
+        videoSource->SetPixelType(VTK_UNSIGNED_CHAR);
+        videoSource->SetNumberOfScalarComponents(numberOfScalarComponents);
+        videoSource->SetInputFrameSize(this->External->FrameSize);
+      }
+
+      return videoSource->AddItem(
+        pixels,
+        US_IMG_ORIENT_MN,
+        this->External->FrameSize,
+        VTK_UNSIGNED_CHAR,
+        numberOfScalarComponents,
+        imageType,
+        0,
+        image.FrameNumber,
+        image.UnfilteredTimestamp,
+        image.FilteredTimestamp);
+    }
+    catch (Spinnaker::Exception& e)
+    {
+      LOG_ERROR("SpinnakerVideoSource: Failed to convert image. Exception text: " << e.what());
+      return PLUS_FAIL;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Enable the timestamp chunk, so that each image carries the camera clock value at exposure */
+  PlusStatus EnableHardwareTimestamps(Spinnaker::GenApi::INodeMap& nodeMap)
+  {
+    this->HardwareTimestampsEnabled = false;
+
+    Spinnaker::GenApi::CBooleanPtr ptrChunkModeActive = nodeMap.GetNode("ChunkModeActive");
+    Spinnaker::GenApi::CEnumerationPtr ptrChunkSelector = nodeMap.GetNode("ChunkSelector");
+    if (!IsAvailable(ptrChunkModeActive) || !IsWritable(ptrChunkModeActive) || !IsAvailable(ptrChunkSelector) || !IsWritable(ptrChunkSelector))
+    {
+      LOG_WARNING("SpinnakerVideoSource: camera does not support chunk data, frames are timestamped when they are received.");
+      return PLUS_FAIL;
+    }
+    ptrChunkModeActive->SetValue(true);
+    Spinnaker::GenApi::CEnumEntryPtr ptrChunkSelectorTimestamp = ptrChunkSelector->GetEntryByName("Timestamp");
+    if (!IsAvailable(ptrChunkSelectorTimestamp) || !IsReadable(ptrChunkSelectorTimestamp))
+    {
+      LOG_WARNING("SpinnakerVideoSource: camera does not provide timestamp chunk data, frames are timestamped when they are received.");
+      return PLUS_FAIL;
+    }
+    ptrChunkSelector->SetIntValue(ptrChunkSelectorTimestamp->GetValue());
+    Spinnaker::GenApi::CBooleanPtr ptrChunkEnable = nodeMap.GetNode("ChunkEnable");
+    if (!IsAvailable(ptrChunkEnable) || !IsWritable(ptrChunkEnable))
+    {
+      LOG_WARNING("SpinnakerVideoSource: unable to enable timestamp chunk data, frames are timestamped when they are received.");
+      return PLUS_FAIL;
+    }
+    ptrChunkEnable->SetValue(true);
+    this->HardwareTimestampsEnabled = true;
+    return PLUS_SUCCESS;
+  }
 };
 
 //----------------------------------------------------------------------------
@@ -86,7 +300,9 @@ vtkPlusSpinnakerVideoSource::vtkPlusSpinnakerVideoSource()
   GainDB(FLAG_GAIN_DB),
   WhiteBalanceMode(DEFAULT_WHITE_BALANCE_MODE),
   WhiteBalanceRed(FLAG_WHITE_BALANCE),
-  WhiteBalanceBlue(FLAG_WHITE_BALANCE)
+  WhiteBalanceBlue(FLAG_WHITE_BALANCE),
+  UseHardwareTimestamps(false),
+  StreamBufferCount(DEFAULT_STREAM_BUFFER_COUNT)
 {
   LOG_TRACE("vtkPlusSpinnakerVideoSource::vtkPlusSpinnakerVideoSource()");
   this->RequireImageOrientationInConfiguration = true;
@@ -147,6 +363,8 @@ void vtkPlusSpinnakerVideoSource::PrintConfiguration(ostream& os, vtkIndent inde
     os << indent << "WhiteBalance(red):" << this->WhiteBalanceRed << std::endl;
     os << indent << "WhiteBalance(blue):" << this->WhiteBalanceBlue << std::endl;
   }
+  os << indent << "UseHardwareTimestamps:" << (this->UseHardwareTimestamps ? "TRUE" : "FALSE") << std::endl;
+  os << indent << "StreamBufferCount:" << this->StreamBufferCount << std::endl;
 }
 
 //----------------------------------------------------------------------------
@@ -308,6 +526,19 @@ PlusStatus vtkPlusSpinnakerVideoSource::ReadConfiguration(vtkXMLDataElement* roo
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(float, WhiteBalanceRed, deviceConfig);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(float, WhiteBalanceBlue, deviceConfig);
 
+  // acquisition
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(UseHardwareTimestamps, deviceConfig);
+  if (this->UseHardwareTimestamps && !this->IsHardwareClockEnabled())
+  {
+    // free-running camera clock, unless HardwareClock="Ptp" is set for a PTP-synchronized camera
+    this->DeviceHardwareClock.SetClockType(HardwareClock::CLOCK_DEVICE);
+  }
+  else if (this->IsHardwareClockEnabled())
+  {
+    this->UseHardwareTimestamps = true;
+  }
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, StreamBufferCount, deviceConfig);
+
   XML_FIND_NESTED_ELEMENT_REQUIRED(dataSourcesElement, deviceConfig, "DataSources");
   for (int nestedElementIndex = 0; nestedElementIndex < dataSourcesElement->GetNumberOfNestedElements(); nestedElementIndex++)
   {
@@ -624,6 +855,36 @@ PlusStatus vtkPlusSpinnakerVideoSource::InternalStartRecording()
     ptrAcquisitionMode->SetIntValue(acquisitionModeContinuous);
     LOG_INFO("Acquisition mode set to continuous...");
 
+    // received images are held until they are converted, so the stream needs more buffers than the default
+    Spinnaker::GenApi::INodeMap& streamNodeMap = this->Internal->CameraPtr->GetTLStreamNodeMap();
+    Spinnaker::GenApi::CEnumerationPtr ptrBufferCountMode = streamNodeMap.GetNode("StreamBufferCountMode");
+    Spinnaker::GenApi::CIntegerPtr ptrBufferCount = streamNodeMap.GetNode("StreamBufferCountManual");
+    if (IsAvailable(ptrBufferCountMode) && IsWritable(ptrBufferCountMode) && IsAvailable(ptrBufferCount) && IsWritable(ptrBufferCount))
+    {
+      Spinnaker::GenApi::CEnumEntryPtr ptrBufferCountModeManual = ptrBufferCountMode->GetEntryByName("Manual");
+      if (IsAvailable(ptrBufferCountModeManual) && IsReadable(ptrBufferCountModeManual))
+      {
+        ptrBufferCountMode->SetIntValue(ptrBufferCountModeManual->GetValue());
+        ptrBufferCount->SetValue(std::max<int64_t>(ptrBufferCount->GetMin(), std::min<int64_t>(ptrBufferCount->GetMax(), this->StreamBufferCount)));
+      }
+    }
+    else
+    {
+      LOG_WARNING("Unable to set the number of stream buffers, the camera default is used.");
+    }
+
+    if (this->UseHardwareTimestamps)
+    {
+      this->Internal->EnableHardwareTimestamps(nodeMap);
+    }
+    else
+    {
+      this->Internal->HardwareTimestampsEnabled = false;
+    }
+
+    // images are converted and added to the buffer on a separate thread, so the acquisition thread only waits for images
+    this->Internal->StartConversion();
+
     // begin acquiring images
     this->Internal->CameraPtr->BeginAcquisition();
 
@@ -649,6 +910,9 @@ PlusStatus vtkPlusSpinnakerVideoSource::InternalStopRecording()
 {
   LOG_TRACE("vtkPlusSpinnakerVideoSource::InternalStopRecording()");
 
+  // images that are not converted yet are released before the acquisition ends
+  this->Internal->StopConversion();
+
   try
   {
     // End acquiring images
@@ -688,96 +952,32 @@ PlusStatus vtkPlusSpinnakerVideoSource::InternalUpdate()
 {
   LOG_TRACE("vtkPlusSpinnakerVideoSource::InternalUpdate()");
 
-  PlusStatus retVal = PLUS_FAIL;
-
   try
   {
-    // Retrieve next received image and ensure image completion
-    Spinnaker::ImagePtr pResultImage = this->Internal->CameraPtr->GetNextImage();
-    if (pResultImage->IsIncomplete())
-    {
-      cout << "Image incomplete with image status " << pResultImage->GetImageStatus() << "..." << endl << endl;
-    }
-
-    // Convert image from PointGrey to correct image type
-    Spinnaker::ImagePtr convertedImage;
-    if (this->PixelEncoding == RGB24)
-    {
-      convertedImage = pResultImage->Convert(Spinnaker::PixelFormat_RGB8, Spinnaker::HQ_LINEAR);
-    }
-    else if (this->PixelEncoding == MONO8)
+    // Retrieve next received image, conversion and adding to the buffer is done on the conversion thread
+    vtkInternal::QueuedImage queuedImage;
+    queuedImage.Image = this->Internal->CameraPtr->GetNextImage();
+    queuedImage.UnfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+    queuedImage.FilteredTimestamp = UNDEFINED_TIMESTAMP;
+    queuedImage.FrameNumber = this->FrameNumber;
+    if (queuedImage.Image->IsIncomplete())
     {
-      convertedImage = pResultImage->Convert(Spinnaker::PixelFormat_Mono8, Spinnaker::HQ_LINEAR);
+      LOG_WARNING("SpinnakerVideoSource: image incomplete with image status " << queuedImage.Image->GetImageStatus());
+      queuedImage.Image->Release();
+      return PLUS_SUCCESS;
     }
-    else
-    {
-      LOG_ERROR("Invalid image type selected.");
-      return PLUS_FAIL;
-    }
-
-    // add image to PLUS buffer
-
-    // get buffer
-    vtkPlusDataSource* videoSource(NULL);
-    if (this->GetFirstVideoSource(videoSource) != PLUS_SUCCESS)
+    if (this->Internal->HardwareTimestampsEnabled)
     {
-      LOG_WARNING("Failed to get video source in SpinnakerVideoSource");
-      return PLUS_FAIL;
+      // camera clock (ns) converted to system time, free of the transfer jitter
+      queuedImage.FilteredTimestamp = this->GetSystemTimeFromHardwareTimestamp(queuedImage.Image->GetChunkData().GetTimestamp() * 1e-9, queuedImage.UnfilteredTimestamp);
     }
-
-    // initialize if buffer is empty
-    if (videoSource->GetNumberOfItems() == 0)
-    {
-      if (this->PixelEncoding == RGB24)
-      {
-        videoSource->SetImageType(US_IMG_RGB_COLOR);
-        videoSource->SetPixelType(VTK_UNSIGNED_CHAR);
-        videoSource->SetNumberOfScalarComponents(3);
-        videoSource->SetInputFrameSize(this->FrameSize);
-      }
-      else if (this->PixelEncoding == MONO8)
-      {
-        videoSource->SetImageType(US_IMG_BRIGHTNESS);
-        videoSource->SetPixelType(VTK_UNSIGNED_CHAR);
-        videoSource->SetNumberOfScalarComponents(1);
-        videoSource->SetInputFrameSize(this->FrameSize);
-      }
-    }
-    
-    // add frame to PLUS buffer
-    if (this->PixelEncoding == RGB24)
-    {
-      retVal = videoSource->AddItem(
-        convertedImage->GetData(), 
-        US_IMG_ORIENT_MN,
-        this->FrameSize,
-        VTK_UNSIGNED_CHAR,
-        3,
-        US_IMG_RGB_COLOR,
-        0,
-        this->FrameNumber);
-    }
-    else if (this->PixelEncoding == MONO8)
-    {
-      retVal = videoSource->AddItem(
-        convertedImage->GetData(),
-        US_IMG_ORIENT_MN,
-        this->FrameSize,
-        VTK_UNSIGNED_CHAR,
-        1,
-        US_IMG_BRIGHTNESS,
-        0,
-        this->FrameNumber);
-    }
-
-    // Release image
-    pResultImage->Release();
+    this->Internal->QueueImage(queuedImage);
   }
   catch (Spinnaker::Exception &e)
   {
     LOG_ERROR("SpinnakerVideoSource: Failed in InternalUpdate(). Exception text: " << e.what());
     return PLUS_FAIL;
   }
-  this->FrameNumber++; 
-  return retVal;
-}
\ No newline at end of file
+  this->FrameNumber++;
+  return PLUS_SUCCESS;
+}
@@ -7,7 +7,7 @@
 #ifndef __vtkPlusSpinnakerVideoSource_h
 #define __vtkPlusSpinnakerVideoSource_h
 
-#include "vtkPlusDataCollectionExport.h"
+#include "PlusDevicePlugin.h"
 #include "vtkPlusDevice.h"
 #include <string>
 
@@ -16,7 +16,7 @@
   \brief Interface class to Spinnaker API compatible Point Grey Cameras
   \ingroup PlusLibDataCollection
 */
-class vtkPlusDataCollectionExport vtkPlusSpinnakerVideoSource : public vtkPlusDevice
+class vtkPlusDeviceExport vtkPlusSpinnakerVideoSource : public vtkPlusDevice
 {
 public:
 
@@ -104,6 +104,13 @@ protected:
   vtkGetMacro(WhiteBalanceBlue, float);
   vtkSetMacro(WhiteBalanceBlue, float);
 
+  /*! Timestamp the frames by the camera clock (timestamp chunk data), if the camera supports it */
+  vtkGetMacro(UseHardwareTimestamps, bool);
+  vtkSetMacro(UseHardwareTimestamps, bool);
+  /*! Number of images the camera stream can hold while earlier images are converted */
+  vtkGetMacro(StreamBufferCount, int);
+  vtkSetMacro(StreamBufferCount, int);
+
   // check camera parameters as set are valid
   PlusStatus CheckCameraParameterValidity();
 
@@ -126,6 +133,10 @@ protected:
   float WhiteBalanceRed;
   float WhiteBalanceBlue;
 
+  // acquisition configuration
+  bool UseHardwareTimestamps;
+  int StreamBufferCount;
+
 private:
   vtkPlusSpinnakerVideoSource(const vtkPlusSpinnakerVideoSource&);
   void operator=(const vtkPlusSpinnakerVideoSource&);
@@ -7,17 +7,27 @@ See License.txt for details.
 #include "PlusConfigure.h"
 #include "vtkImageData.h"
 #include "vtkMatrix4x4.h"
-#include "vtkIGSIOSequenceIO.h"
 #include "vtkObjectFactory.h"
 #include "vtkPlusBuffer.h"
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataSource.h"
 #include "vtkPlusSavedDataSource.h"
+#include "vtkPlusSequenceIO.h"
+#include "vtkPlusSequenceStreamReader.h"
 #include "vtkIGSIOTrackedFrameList.h"
 #include "vtksys/SystemTools.hxx"
 
+#include <algorithm>
+#include <chrono>
+
 vtkStandardNewMacro(vtkPlusSavedDataSource);
 
+namespace
+{
+  // Maximum time to wait for the read-ahead thread to decode a streamed frame
+  const double STREAMED_FRAME_TIMEOUT_SEC = 30.0;
+}
+
 //----------------------------------------------------------------------------
 vtkPlusSavedDataSource::vtkPlusSavedDataSource()
   : FrameBufferRowAlignment(1)
@@ -28,6 +38,14 @@ vtkPlusSavedDataSource::vtkPlusSavedDataSource()
   , LocalVideoBuffer(NULL)
   , UseAllFrameFields(false)
   , UseOriginalTimestamps(false)
+  , UseMemoryMapping(false)
+  , UseStreaming(false)
+  , NumberOfReadAheadFrames(8)
+  , StreamReader(NULL)
+  , NextReadAheadFrameUid(0)
+  , DecodedReadAheadFrameUid(0)
+  , ReadAheadGeneration(0)
+  , ReadAheadThreadStopRequested(false)
   , LastAddedFrameUid(0)
   , LastAddedLoopIndex(0)
   , SimulatedStream(VIDEO_STREAM)
@@ -107,8 +125,9 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateOriginalTimestamp(BufferItemUid
     {
       currentLoopIndex = floor(elapsedTime / loopTime);
       currentFrameTime_Local = this->LoopStartTime_Local + elapsedTime - loopTime * currentLoopIndex;
+      double oldestTimestamp_Local = 0;
       double latestTimestamp_Local = 0;
-      GetLocalBuffer()->GetLatestTimeStamp(latestTimestamp_Local);
+      GetFrameTimeRange(oldestTimestamp_Local, latestTimestamp_Local);
       if (currentFrameTime_Local > latestTimestamp_Local)
       {
         // hold the last frame after the end of the buffer
@@ -118,10 +137,8 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateOriginalTimestamp(BufferItemUid
     }
 
     // Get the uid of the frame that has been most recently acquired
-    BufferItemUidType closestFrameUid = 0;
-    GetLocalBuffer()->GetItemUidFromTime(currentFrameTime_Local, closestFrameUid);
-    double closestFrameTime_Local = 0;
-    GetLocalBuffer()->GetTimeStamp(closestFrameUid, closestFrameTime_Local);
+    BufferItemUidType closestFrameUid = GetClosestFrameUid(currentFrameTime_Local);
+    double closestFrameTime_Local = GetFrameTimestamp(closestFrameUid);
     if (closestFrameTime_Local > currentFrameTime_Local)
     {
       // the closest frame is newer than the current time, so don't use this item but the one before
@@ -155,8 +172,9 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateOriginalTimestamp(BufferItemUid
     // TODO: use the UID difference as increment
     this->FrameNumber++;
 
+    // Streamed frames are not in the local buffer, they are decoded by the read-ahead thread
     StreamBufferItem dataBufferItemToBeAdded;
-    if (GetLocalBuffer()->GetStreamBufferItem(frameToBeAddedUid, &dataBufferItemToBeAdded) != ITEM_OK)
+    if (this->StreamReader == NULL && GetLocalBuffer()->GetStreamBufferItem(frameToBeAddedUid, &dataBufferItemToBeAdded) != ITEM_OK)
     {
       LOG_ERROR("vtkPlusSavedDataSource: Failed to retrieve item from the buffer, UID=" << frameToBeAddedUid);
       status = PLUS_FAIL;
@@ -165,7 +183,8 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateOriginalTimestamp(BufferItemUid
 
     // Compute the system time corresponding to this frame
     // Get the filtered timestamp from the buffer without any local time offset. Offset will be applied when it is copied to the output stream's buffer.
-    double filteredTimestamp = dataBufferItemToBeAdded.GetFilteredTimestamp(0.0) + frameToBeAddedLoopIndex * loopTime -
+    double frameTimestamp_Local = (this->StreamReader != NULL ? GetFrameTimestamp(frameToBeAddedUid) : dataBufferItemToBeAdded.GetFilteredTimestamp(0.0));
+    double filteredTimestamp = frameTimestamp_Local + frameToBeAddedLoopIndex * loopTime -
                                this->LoopStartTime_Local + this->GetOutputDataSource()->GetStartTime();
     double unfilteredTimestamp = filteredTimestamp; // we ignore unfiltered timestamps
 
@@ -173,6 +192,14 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateOriginalTimestamp(BufferItemUid
     {
       case VIDEO_STREAM:
         {
+          if (this->StreamReader != NULL)
+          {
+            if (this->AddStreamedVideoFrame(frameToBeAddedUid, unfilteredTimestamp, filteredTimestamp) != PLUS_SUCCESS)
+            {
+              status = PLUS_FAIL;
+            }
+            break;
+          }
           igsioFieldMapType fieldMap;
           if (this->UseAllFrameFields)
           {
@@ -263,7 +290,7 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateCurrentTimestamp(BufferItemUidT
 
   this->FrameNumber++;
   StreamBufferItem dataBufferItemToBeAdded;
-  if (GetLocalBuffer()->GetStreamBufferItem(frameToBeAddedUid, &dataBufferItemToBeAdded) != ITEM_OK)
+  if (this->StreamReader == NULL && GetLocalBuffer()->GetStreamBufferItem(frameToBeAddedUid, &dataBufferItemToBeAdded) != ITEM_OK)
   {
     LOG_ERROR("vtkPlusSavedDataSource: Failed to retrieve item from the buffer, UID=" << frameToBeAddedUid);
     return PLUS_FAIL;
@@ -274,6 +301,15 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateCurrentTimestamp(BufferItemUidT
   {
     case VIDEO_STREAM:
       {
+        if (this->StreamReader != NULL)
+        {
+          // UNDEFINED_TIMESTAMP => use current timestamp
+          if (this->AddStreamedVideoFrame(frameToBeAddedUid, UNDEFINED_TIMESTAMP, UNDEFINED_TIMESTAMP) != PLUS_SUCCESS)
+          {
+            status = PLUS_FAIL;
+          }
+          break;
+        }
         igsioFieldMapType fieldMap;
         if (this->UseAllFrameFields)
         {
@@ -379,57 +415,111 @@ PlusStatus vtkPlusSavedDataSource::InternalConnect()
     return PLUS_FAIL;
   }
 
-  vtkSmartPointer<vtkIGSIOTrackedFrameList> savedDataBuffer = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
-
-  // Read sequence file into tracked frame list
-  vtkIGSIOSequenceIO::Read(foundAbsoluteImagePath, savedDataBuffer);
+  this->DeleteLocalBuffers();
 
-  if (savedDataBuffer->GetNumberOfTrackedFrames() < 1)
+  // In streaming mode the file is opened without reading any pixel data
+  vtkSmartPointer<vtkPlusSequenceStreamReader> streamReader;
+  if (this->UseStreaming)
   {
-    LOG_ERROR("Failed to connect to saved dataset - there is no frame in the sequence metafile!");
-    return PLUS_FAIL;
+    if (vtkPlusSequenceStreamReader::CanReadFile(foundAbsoluteImagePath))
+    {
+      streamReader = vtkSmartPointer<vtkPlusSequenceStreamReader>::New();
+      if (streamReader->Open(foundAbsoluteImagePath) != PLUS_SUCCESS)
+      {
+        streamReader = NULL;
+      }
+    }
+    if (streamReader == NULL)
+    {
+      LOG_WARNING("Sequence file cannot be read frame by frame, the whole file is read before replay: " << this->SequenceFile);
+    }
   }
 
   PlusStatus status = PLUS_FAIL;
-  switch (this->SimulatedStream)
+  if (streamReader != NULL && this->SimulatedStream == VIDEO_STREAM)
   {
-    case VIDEO_STREAM:
-      status = InternalConnectVideo(savedDataBuffer);
-      break;
-    case TRACKER_STREAM:
-      status = InternalConnectTracker(savedDataBuffer);
-      break;
-    default:
-      LOG_ERROR("Unknown stream type: " << this->SimulatedStream);
+    status = InternalConnectStreamedVideo(streamReader);
+  }
+  else
+  {
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> savedDataBuffer = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+
+    if (streamReader != NULL)
+    {
+      // Tracker streams only need the frame fields, images are not read
+      std::vector<int> frameIndices;
+      for (int frameIndex = 0; frameIndex < streamReader->GetNumberOfFrames(); ++frameIndex)
+      {
+        frameIndices.push_back(frameIndex);
+      }
+      streamReader->ReadFrames(savedDataBuffer, frameIndices, false);
+    }
+    else
+    {
+      // Read sequence file into tracked frame list. Memory mapped frames are only read from disk when they are copied into the local buffer,
+      // so the whole sequence is not held in memory twice.
+      vtkPlusSequenceIO::Read(foundAbsoluteImagePath, savedDataBuffer, this->UseMemoryMapping);
+    }
+
+    if (savedDataBuffer->GetNumberOfTrackedFrames() < 1)
+    {
+      LOG_ERROR("Failed to connect to saved dataset - there is no frame in the sequence metafile!");
+      return PLUS_FAIL;
+    }
+
+    switch (this->SimulatedStream)
+    {
+      case VIDEO_STREAM:
+        status = InternalConnectVideo(savedDataBuffer);
+        break;
+      case TRACKER_STREAM:
+        status = InternalConnectTracker(savedDataBuffer);
+        break;
+      default:
+        LOG_ERROR("Unknown stream type: " << this->SimulatedStream);
+    }
   }
 
   if (status != PLUS_SUCCESS)
   {
+    this->DeleteLocalBuffers();
     return PLUS_FAIL;
   }
 
-  if (GetLocalBuffer() == NULL)
+  if (this->StreamReader == NULL && GetLocalBuffer() == NULL)
   {
     LOG_ERROR("Local buffer is invalid");
     return PLUS_FAIL;
   }
 
   double oldestTimestamp_Local = 0;
-  GetLocalBuffer()->GetOldestTimeStamp(oldestTimestamp_Local);
   double latestTimestamp_Local = 0;
-  GetLocalBuffer()->GetLatestTimeStamp(latestTimestamp_Local);
+  GetFrameTimeRange(oldestTimestamp_Local, latestTimestamp_Local);
 
   // Set the default loop start time and length to match the video buffer start time and length
 
-  this->LoopFirstFrameUid = GetLocalBuffer()->GetOldestItemUidInBuffer();
-  this->LoopLastFrameUid = GetLocalBuffer()->GetLatestItemUidInBuffer();
+  double frameRate = 0.0;
+  if (this->StreamReader != NULL)
+  {
+    this->LoopFirstFrameUid = 1;
+    this->LoopLastFrameUid = this->StreamedFrameTimestamps.size();
+    if (latestTimestamp_Local > oldestTimestamp_Local)
+    {
+      frameRate = (this->StreamedFrameTimestamps.size() - 1) / (latestTimestamp_Local - oldestTimestamp_Local);
+    }
+  }
+  else
+  {
+    this->LoopFirstFrameUid = GetLocalBuffer()->GetOldestItemUidInBuffer();
+    this->LoopLastFrameUid = GetLocalBuffer()->GetLatestItemUidInBuffer();
+    frameRate = GetLocalBuffer()->GetFrameRate();
+  }
 
   this->LoopStartTime_Local = oldestTimestamp_Local;
 
   // When we reach the last frame we have to wait one frame period before
   // playing the first frame, so we have to add one frame period to the loop length (loopTime)
   double framePeriodSec = 0;
-  double frameRate = GetLocalBuffer()->GetFrameRate();
   if (frameRate != 0.0)
   {
     framePeriodSec = 1.0 / frameRate;
@@ -453,6 +543,11 @@ PlusStatus vtkPlusSavedDataSource::InternalConnect()
   this->LastAddedFrameUid = this->LoopFirstFrameUid - 1;
   this->LastAddedLoopIndex = 0;
 
+  if (this->StreamReader != NULL)
+  {
+    this->StartReadAheadThread();
+  }
+
   return PLUS_SUCCESS;
 }
 
@@ -502,26 +597,85 @@ PlusStatus vtkPlusSavedDataSource::InternalConnectVideo(vtkIGSIOTrackedFrameList
   this->LocalVideoBuffer->CopyImagesFromTrackedFrameList(savedDataBuffer, vtkPlusBuffer::READ_FILTERED_IGNORE_UNFILTERED_TIMESTAMPS, this->UseAllFrameFields);
   savedDataBuffer->Clear();
 
+  return this->SetVideoSourceImageProperties(this->LocalVideoBuffer->GetImageOrientation(), this->LocalVideoBuffer->GetFrameSize(),
+         this->LocalVideoBuffer->GetNumberOfScalarComponents(), this->LocalVideoBuffer->GetPixelType());
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::InternalConnectStreamedVideo(vtkPlusSequenceStreamReader* streamReader)
+{
+  vtkPlusDataSource* outputDataSource = this->GetOutputDataSource();
+  if (outputDataSource == NULL)
+  {
+    return PLUS_FAIL;
+  }
+  if (outputDataSource->SetImageType(streamReader->GetImageType()) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to set video buffer image type");
+    return PLUS_FAIL;
+  }
+
+  // Only the frame fields are read now, the images are decoded during replay.
+  // Frames without a valid image or with a timestamp that is not increasing are not replayed, as in the local buffer.
+  for (int frameIndex = 0; frameIndex < streamReader->GetNumberOfFrames(); ++frameIndex)
+  {
+    igsioTrackedFrame frame;
+    if (streamReader->GetFrameFields(frameIndex, frame) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to read frame fields of frame " << frameIndex << " from sequence file: " << this->SequenceFile);
+      return PLUS_FAIL;
+    }
+    std::string imageStatus = frame.GetFrameField("ImageStatus");
+    if (!imageStatus.empty() && !igsioCommon::IsEqualInsensitive(imageStatus, "OK"))
+    {
+      continue;
+    }
+    if (!this->StreamedFrameTimestamps.empty() && frame.GetTimestamp() <= this->StreamedFrameTimestamps.back())
+    {
+      LOG_DEBUG("Frame " << frameIndex << " is not replayed, its timestamp is not newer than the timestamp of the previous frame");
+      continue;
+    }
+    this->StreamedFrameIndices.push_back(frameIndex);
+    this->StreamedFrameTimestamps.push_back(frame.GetTimestamp());
+  }
+  if (this->StreamedFrameTimestamps.empty())
+  {
+    LOG_ERROR("Failed to connect to saved dataset - there is no frame with valid image in the sequence metafile!");
+    return PLUS_FAIL;
+  }
+
+  this->StreamReader = streamReader;
+  this->StreamReader->Register(this);
+
+  FrameSizeType frameSize = { 0, 0, 0 };
+  streamReader->GetFrameSize(frameSize);
+  return this->SetVideoSourceImageProperties(US_IMG_ORIENT_MF, frameSize, streamReader->GetNumberOfScalarComponents(), streamReader->GetPixelType());
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::SetVideoSourceImageProperties(US_IMAGE_ORIENTATION imageOrientation, const FrameSizeType& frameSize,
+    unsigned int numberOfScalarComponents, igsioCommon::VTKScalarPixelType pixelType)
+{
   PlusStatus result(PLUS_SUCCESS);
   for (DataSourceContainerIterator it = this->VideoSources.begin(); it != this->VideoSources.end(); ++it)
   {
     vtkPlusDataSource* source(it->second);
 
-    if (source->SetInputImageOrientation(this->LocalVideoBuffer->GetImageOrientation()) != PLUS_SUCCESS)
+    if (source->SetInputImageOrientation(imageOrientation) != PLUS_SUCCESS)
     {
       LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
       result = PLUS_FAIL;
       continue;
     }
 
-    if (source->SetInputFrameSize(this->LocalVideoBuffer->GetFrameSize()) != PLUS_SUCCESS)
+    if (source->SetInputFrameSize(frameSize) != PLUS_SUCCESS)
     {
       LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
       result = PLUS_FAIL;
       continue;
     }
 
-    if (source->SetNumberOfScalarComponents(this->LocalVideoBuffer->GetNumberOfScalarComponents()) != PLUS_SUCCESS)
+    if (source->SetNumberOfScalarComponents(numberOfScalarComponents) != PLUS_SUCCESS)
     {
       LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
       result = PLUS_FAIL;
@@ -530,14 +684,14 @@ PlusStatus vtkPlusSavedDataSource::InternalConnectVideo(vtkIGSIOTrackedFrameList
 
     source->Clear();
 
-    if (source->SetInputFrameSize(this->LocalVideoBuffer->GetFrameSize()) != PLUS_SUCCESS)
+    if (source->SetInputFrameSize(frameSize) != PLUS_SUCCESS)
     {
       LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
       result = PLUS_FAIL;
       continue;
     }
 
-    if (source->SetPixelType(this->LocalVideoBuffer->GetPixelType()) != PLUS_SUCCESS)
+    if (source->SetPixelType(pixelType) != PLUS_SUCCESS)
     {
       LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
       result = PLUS_FAIL;
@@ -670,6 +824,9 @@ PlusStatus vtkPlusSavedDataSource::ReadConfiguration(vtkXMLDataElement* rootConf
 
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(RepeatEnabled, deviceConfig);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(UseOriginalTimestamps, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(UseMemoryMapping, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(UseStreaming, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfReadAheadFrames, deviceConfig);
 
   const char* useData = deviceConfig->GetAttribute("UseData");
   if (useData != NULL)
@@ -707,6 +864,9 @@ PlusStatus vtkPlusSavedDataSource::WriteConfiguration(vtkXMLDataElement* rootCon
   XML_WRITE_CSTRING_ATTRIBUTE_IF_NOT_NULL(SequenceFile, imageAcquisitionConfig);
   XML_WRITE_BOOL_ATTRIBUTE(RepeatEnabled, imageAcquisitionConfig);
   XML_WRITE_BOOL_ATTRIBUTE(UseOriginalTimestamps, imageAcquisitionConfig);
+  XML_WRITE_BOOL_ATTRIBUTE(UseMemoryMapping, imageAcquisitionConfig);
+  XML_WRITE_BOOL_ATTRIBUTE(UseStreaming, imageAcquisitionConfig);
+  imageAcquisitionConfig->SetIntAttribute("NumberOfReadAheadFrames", this->GetNumberOfReadAheadFrames());
 
   if (this->UseAllFrameFields)
   {
@@ -771,8 +931,14 @@ void vtkPlusSavedDataSource::SetLoopTimeRange(double loopStartTime, double loopS
   this->LoopStartTime_Local = loopStartTime;
   this->LoopStopTime_Local = loopStopTime;
 
-  this->LoopFirstFrameUid = GetClosestFrameUidWithinTimeRange(this->LoopStartTime_Local, this->LoopStartTime_Local, this->LoopStopTime_Local);
-  this->LoopLastFrameUid = GetClosestFrameUidWithinTimeRange(this->LoopStopTime_Local, this->LoopStartTime_Local, this->LoopStopTime_Local);
+  BufferItemUidType loopFirstFrameUid = GetClosestFrameUidWithinTimeRange(this->LoopStartTime_Local, this->LoopStartTime_Local, this->LoopStopTime_Local);
+  BufferItemUidType loopLastFrameUid = GetClosestFrameUidWithinTimeRange(this->LoopStopTime_Local, this->LoopStartTime_Local, this->LoopStopTime_Local);
+  {
+    // The read-ahead thread decodes the frames of the loop
+    std::lock_guard<std::mutex> lock(this->ReadAheadMutex);
+    this->LoopFirstFrameUid = loopFirstFrameUid;
+    this->LoopLastFrameUid = loopLastFrameUid;
+  }
 
   this->LastAddedFrameUid = this->LoopFirstFrameUid - 1;
   this->LastAddedLoopIndex = 0;
@@ -792,9 +958,8 @@ BufferItemUidType vtkPlusSavedDataSource::GetClosestFrameUidWithinTimeRange(doub
   }
   // time_Local should be also within the local buffer time range
   double oldestTimestamp_Local = 0;
-  GetLocalBuffer()->GetOldestTimeStamp(oldestTimestamp_Local);
   double latestTimestamp_Local = 0;
-  GetLocalBuffer()->GetLatestTimeStamp(latestTimestamp_Local);
+  GetFrameTimeRange(oldestTimestamp_Local, latestTimestamp_Local);
 
   // if the asked time is outside of the loop range then return the closest element in the range
   if (time_Local < oldestTimestamp_Local)
@@ -807,10 +972,8 @@ BufferItemUidType vtkPlusSavedDataSource::GetClosestFrameUidWithinTimeRange(doub
   }
 
   // Get the uid of the frame that has been most recently acquired
-  BufferItemUidType closestFrameUid = 0;
-  GetLocalBuffer()->GetItemUidFromTime(time_Local, closestFrameUid);
-  double closestFrameTime_Local = 0;
-  GetLocalBuffer()->GetTimeStamp(closestFrameUid, closestFrameTime_Local);
+  BufferItemUidType closestFrameUid = GetClosestFrameUid(time_Local);
+  double closestFrameTime_Local = GetFrameTimestamp(closestFrameUid);
 
   // The closest frame is at the boundary, but it may be just outside the range:
   // use the next/previous frame if the closest frame is on the wrong side of the boundary
@@ -829,6 +992,206 @@ BufferItemUidType vtkPlusSavedDataSource::GetClosestFrameUidWithinTimeRange(doub
   }
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusSavedDataSource::GetFrameTimeRange(double& oldestTimestamp_Local, double& latestTimestamp_Local)
+{
+  if (this->StreamReader != NULL)
+  {
+    oldestTimestamp_Local = this->StreamedFrameTimestamps.front();
+    latestTimestamp_Local = this->StreamedFrameTimestamps.back();
+    return;
+  }
+  GetLocalBuffer()->GetOldestTimeStamp(oldestTimestamp_Local);
+  GetLocalBuffer()->GetLatestTimeStamp(latestTimestamp_Local);
+}
+
+//----------------------------------------------------------------------------
+BufferItemUidType vtkPlusSavedDataSource::GetClosestFrameUid(double time_Local)
+{
+  if (this->StreamReader != NULL)
+  {
+    // Timestamps of streamed frames are increasing
+    std::vector<double>::const_iterator nextFrameIt = std::lower_bound(this->StreamedFrameTimestamps.begin(), this->StreamedFrameTimestamps.end(), time_Local);
+    if (nextFrameIt == this->StreamedFrameTimestamps.end())
+    {
+      return this->StreamedFrameTimestamps.size();
+    }
+    size_t closestFrameIndex = nextFrameIt - this->StreamedFrameTimestamps.begin();
+    if (closestFrameIndex > 0 && time_Local - this->StreamedFrameTimestamps[closestFrameIndex - 1] < (*nextFrameIt) - time_Local)
+    {
+      closestFrameIndex--;
+    }
+    return closestFrameIndex + 1;
+  }
+  BufferItemUidType closestFrameUid = 0;
+  GetLocalBuffer()->GetItemUidFromTime(time_Local, closestFrameUid);
+  return closestFrameUid;
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusSavedDataSource::GetFrameTimestamp(BufferItemUidType uid)
+{
+  if (this->StreamReader != NULL)
+  {
+    if (uid < 1 || uid > this->StreamedFrameTimestamps.size())
+    {
+      LOG_ERROR("vtkPlusSavedDataSource: Invalid streamed frame UID=" << uid);
+      return 0.0;
+    }
+    return this->StreamedFrameTimestamps[uid - 1];
+  }
+  double timestamp_Local = 0;
+  GetLocalBuffer()->GetTimeStamp(uid, timestamp_Local);
+  return timestamp_Local;
+}
+
+//----------------------------------------------------------------------------
+BufferItemUidType vtkPlusSavedDataSource::GetNextStreamedFrameUid(BufferItemUidType frameUid)
+{
+  if (frameUid < this->LoopLastFrameUid)
+  {
+    return frameUid + 1;
+  }
+  return this->RepeatEnabled ? this->LoopFirstFrameUid : 0;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::AddStreamedVideoFrame(BufferItemUidType frameUid, double unfilteredTimestamp, double filteredTimestamp)
+{
+  ReadAheadFrame readAheadFrame;
+  {
+    std::unique_lock<std::mutex> lock(this->ReadAheadMutex);
+    BufferItemUidType expectedFrameUid = this->NextReadAheadFrameUid;
+    if (!this->ReadAheadQueue.empty())
+    {
+      expectedFrameUid = this->ReadAheadQueue.front().FrameUid;
+    }
+    else if (this->DecodedReadAheadFrameUid != 0)
+    {
+      expectedFrameUid = this->DecodedReadAheadFrameUid;
+    }
+    if (expectedFrameUid != frameUid)
+    {
+      // Replay does not continue with the decoded frames (for example the loop range has changed), decode from the requested frame
+      for (std::deque<ReadAheadFrame>::iterator frameIt = this->ReadAheadQueue.begin(); frameIt != this->ReadAheadQueue.end(); ++frameIt)
+      {
+        this->FreeReadAheadFrames.push_back(frameIt->Frame);
+      }
+      this->ReadAheadQueue.clear();
+      this->ReadAheadGeneration++;
+      this->NextReadAheadFrameUid = frameUid;
+      this->ReadAheadCondition.notify_all();
+    }
+    if (!this->ReadAheadCondition.wait_for(lock, std::chrono::duration<double>(STREAMED_FRAME_TIMEOUT_SEC), [this] { return !this->ReadAheadQueue.empty(); }))
+    {
+      LOG_ERROR("vtkPlusSavedDataSource: Timeout while reading frame from sequence file: " << this->SequenceFile);
+      return PLUS_FAIL;
+    }
+    readAheadFrame = this->ReadAheadQueue.front();
+    this->ReadAheadQueue.pop_front();
+  }
+
+  PlusStatus status = readAheadFrame.Status;
+  if (status != PLUS_SUCCESS)
+  {
+    LOG_ERROR("vtkPlusSavedDataSource: Failed to read frame " << this->StreamedFrameIndices[readAheadFrame.FrameUid - 1] << " from sequence file: " << this->SequenceFile);
+  }
+  else
+  {
+    igsioFieldMapType fieldMap;
+    if (this->UseAllFrameFields)
+    {
+      fieldMap = readAheadFrame.Frame->GetCustomFields();
+    }
+    status = this->AddVideoItemToVideoSources(this->GetVideoSources(), *readAheadFrame.Frame->GetImageData(), this->FrameNumber, unfilteredTimestamp, filteredTimestamp, &fieldMap);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->ReadAheadMutex);
+    this->FreeReadAheadFrames.push_back(readAheadFrame.Frame);
+  }
+  this->ReadAheadCondition.notify_all();
+  return status;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusSavedDataSource::StartReadAheadThread()
+{
+  this->StopReadAheadThread();
+  for (int i = 0; i < this->NumberOfReadAheadFrames; ++i)
+  {
+    this->FreeReadAheadFrames.push_back(new igsioTrackedFrame);
+  }
+  this->NextReadAheadFrameUid = this->LoopFirstFrameUid;
+  this->DecodedReadAheadFrameUid = 0;
+  this->ReadAheadThreadStopRequested = false;
+  this->ReadAheadThread = std::thread(&vtkPlusSavedDataSource::ReadAheadThreadFunction, this);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusSavedDataSource::StopReadAheadThread()
+{
+  if (this->ReadAheadThread.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(this->ReadAheadMutex);
+      this->ReadAheadThreadStopRequested = true;
+    }
+    this->ReadAheadCondition.notify_all();
+    this->ReadAheadThread.join();
+  }
+
+  for (std::deque<ReadAheadFrame>::iterator frameIt = this->ReadAheadQueue.begin(); frameIt != this->ReadAheadQueue.end(); ++frameIt)
+  {
+    delete frameIt->Frame;
+  }
+  this->ReadAheadQueue.clear();
+  for (std::vector<igsioTrackedFrame*>::iterator frameIt = this->FreeReadAheadFrames.begin(); frameIt != this->FreeReadAheadFrames.end(); ++frameIt)
+  {
+    delete *frameIt;
+  }
+  this->FreeReadAheadFrames.clear();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusSavedDataSource::ReadAheadThreadFunction()
+{
+  std::unique_lock<std::mutex> lock(this->ReadAheadMutex);
+  while (true)
+  {
+    this->ReadAheadCondition.wait(lock, [this] { return this->ReadAheadThreadStopRequested || (this->NextReadAheadFrameUid != 0 && !this->FreeReadAheadFrames.empty()); });
+    if (this->ReadAheadThreadStopRequested)
+    {
+      break;
+    }
+
+    ReadAheadFrame readAheadFrame;
+    readAheadFrame.FrameUid = this->NextReadAheadFrameUid;
+    readAheadFrame.Frame = this->FreeReadAheadFrames.back();
+    this->FreeReadAheadFrames.pop_back();
+    this->DecodedReadAheadFrameUid = readAheadFrame.FrameUid;
+    this->NextReadAheadFrameUid = this->GetNextStreamedFrameUid(readAheadFrame.FrameUid);
+    const int generation = this->ReadAheadGeneration;
+
+    // Replay can take the already decoded frames while this frame is decoded
+    lock.unlock();
+    readAheadFrame.Status = this->StreamReader->ReadFrame(this->StreamedFrameIndices[readAheadFrame.FrameUid - 1], *readAheadFrame.Frame);
+    lock.lock();
+
+    this->DecodedReadAheadFrameUid = 0;
+    if (generation != this->ReadAheadGeneration)
+    {
+      // the queue was flushed while the frame was decoded
+      this->FreeReadAheadFrames.push_back(readAheadFrame.Frame);
+    }
+    else
+    {
+      this->ReadAheadQueue.push_back(readAheadFrame);
+    }
+    this->ReadAheadCondition.notify_all();
+  }
+}
+
 //----------------------------------------------------------------------------
 vtkPlusBuffer* vtkPlusSavedDataSource::GetLocalTrackerBuffer()
 {
@@ -845,6 +1208,15 @@ vtkPlusBuffer* vtkPlusSavedDataSource::GetLocalTrackerBuffer()
 //----------------------------------------------------------------------------
 void vtkPlusSavedDataSource::DeleteLocalBuffers()
 {
+  this->StopReadAheadThread();
+  if (this->StreamReader != NULL)
+  {
+    this->StreamReader->UnRegister(this);
+    this->StreamReader = NULL;
+  }
+  this->StreamedFrameIndices.clear();
+  this->StreamedFrameTimestamps.clear();
+
   if (this->LocalVideoBuffer != NULL)
   {
     this->LocalVideoBuffer->Delete();
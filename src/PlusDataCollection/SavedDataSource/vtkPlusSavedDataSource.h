@@ -11,7 +11,15 @@ See License.txt for details.
 
 #include "vtkPlusDevice.h"
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class igsioTrackedFrame;
 class vtkPlusBuffer;
+class vtkPlusSequenceStreamReader;
 
 class vtkPlusDataCollectionExport vtkPlusSavedDataSource;
 
@@ -27,6 +35,15 @@ Attributes:
 \li UseOriginalTimestamps: if true then the original timestamps (recorded originally in the source file)
   will be replayed exactly, otherwise only the timestamp difference will be replayed exactly,
   starting from the current time (TRUE|FALSE)
+\li UseStreaming: if true then the frames are read from the file during replay instead of loading the whole file
+  when connecting (TRUE|FALSE)
+\li NumberOfReadAheadFrames: number of frames decoded ahead of replay in streaming mode
+
+In streaming mode only the frame fields are read when the device connects. Video frames are decoded on a read-ahead thread,
+in the order they are replayed (wrapping around to the loop start if RepeatEnabled is set), and the replay takes the decoded
+frames from a queue of NumberOfReadAheadFrames frames. Tracker streams read only the frame fields of the file, so they are
+replayed from the local buffers as usual. Streaming requires a MetaImage file that vtkPlusSequenceStreamReader can read,
+other files are loaded into memory.
 
 */
 class vtkPlusDataCollectionExport vtkPlusSavedDataSource : public vtkPlusDevice
@@ -73,7 +90,26 @@ public:
   /*! Read the timestamps from the file and use provide them in the output (instead of the current time) */
   vtkBooleanMacro( UseOriginalTimestamps, bool );
 
-  /*! Get local video buffer */
+  /*! Memory map the sequence file instead of reading it into memory (only uncompressed MetaImage files in MF orientation) */
+  vtkGetMacro( UseMemoryMapping, bool );
+  /*! Memory map the sequence file instead of reading it into memory (only uncompressed MetaImage files in MF orientation) */
+  vtkSetMacro( UseMemoryMapping, bool );
+  /*! Memory map the sequence file instead of reading it into memory (only uncompressed MetaImage files in MF orientation) */
+  vtkBooleanMacro( UseMemoryMapping, bool );
+
+  /*! Read frames from the file during replay, on a read-ahead thread, instead of loading the whole file on connect */
+  vtkGetMacro( UseStreaming, bool );
+  /*! Read frames from the file during replay, on a read-ahead thread, instead of loading the whole file on connect */
+  vtkSetMacro( UseStreaming, bool );
+  /*! Read frames from the file during replay, on a read-ahead thread, instead of loading the whole file on connect */
+  vtkBooleanMacro( UseStreaming, bool );
+
+  /*! Number of frames that are decoded ahead of replay in streaming mode */
+  vtkGetMacro( NumberOfReadAheadFrames, int );
+  /*! Number of frames that are decoded ahead of replay in streaming mode */
+  vtkSetClampMacro( NumberOfReadAheadFrames, int, 1, 1000 );
+
+  /*! Get local video buffer (NULL if video frames are streamed from the file) */
   vtkGetObjectMacro( LocalVideoBuffer, vtkPlusBuffer );
 
   virtual bool IsTracker() const;
@@ -101,6 +137,13 @@ protected:
   /*! Connect to device, in case the output is a tracker stream */
   virtual PlusStatus InternalConnectTracker( vtkIGSIOTrackedFrameList* savedDataBuffer );
 
+  /*! Connect to device, in case the output is a video stream that is read from the file during replay */
+  virtual PlusStatus InternalConnectStreamedVideo( vtkPlusSequenceStreamReader* streamReader );
+
+  /*! Set the image properties of the video sources */
+  PlusStatus SetVideoSourceImageProperties( US_IMAGE_ORIENTATION imageOrientation, const FrameSizeType& frameSize,
+      unsigned int numberOfScalarComponents, igsioCommon::VTKScalarPixelType pixelType );
+
   /*! Disconnect from device */
   virtual PlusStatus InternalDisconnect();
 
@@ -115,6 +158,24 @@ protected:
 
   BufferItemUidType GetClosestFrameUidWithinTimeRange( double time_Local, double startTime_Local, double stopTime_Local );
 
+  /*!
+    Timestamps and UIDs of the replayed frames: items of the local buffer, or the streamed frames
+    (UIDs of streamed frames start at 1, in the order of StreamedFrameTimestamps)
+  */
+  void GetFrameTimeRange( double& oldestTimestamp_Local, double& latestTimestamp_Local );
+  BufferItemUidType GetClosestFrameUid( double time_Local );
+  double GetFrameTimestamp( BufferItemUidType uid );
+
+  /*! Add a streamed frame to the video sources, waits until the read-ahead thread has decoded it */
+  PlusStatus AddStreamedVideoFrame( BufferItemUidType frameUid, double unfilteredTimestamp, double filteredTimestamp );
+
+  /*! Returns the UID of the frame replayed after the specified frame, or 0 if replay ends after it */
+  BufferItemUidType GetNextStreamedFrameUid( BufferItemUidType frameUid );
+
+  void StartReadAheadThread();
+  void StopReadAheadThread();
+  void ReadAheadThreadFunction();
+
   /*! Get local tracker buffer */
   vtkPlusBuffer* GetLocalTrackerBuffer();
 
@@ -161,6 +222,46 @@ protected:
   /*! Read the timestamps from the file and use provide them in the output (instead of the current time) */
   bool UseOriginalTimestamps;
 
+  /*! Memory map the sequence file instead of reading it into memory */
+  bool UseMemoryMapping;
+
+  /*! Read frames from the file during replay instead of loading the whole file on connect */
+  bool UseStreaming;
+
+  /*! Number of frames that are decoded ahead of replay in streaming mode */
+  int NumberOfReadAheadFrames;
+
+  /*! Reader of the streamed video frames, NULL if the frames are replayed from the local buffer */
+  vtkPlusSequenceStreamReader* StreamReader;
+
+  /*! Index in the file and timestamp of each streamed frame that has a valid image, in order of frame UID */
+  std::vector<int> StreamedFrameIndices;
+  std::vector<double> StreamedFrameTimestamps;
+
+  /*! A decoded frame, waiting for replay */
+  struct ReadAheadFrame
+  {
+    BufferItemUidType FrameUid;
+    igsioTrackedFrame* Frame;
+    PlusStatus Status;
+  };
+
+  /*! Decoded frames in replay order and frames that can be used for decoding, protected by ReadAheadMutex */
+  std::deque<ReadAheadFrame> ReadAheadQueue;
+  std::vector<igsioTrackedFrame*> FreeReadAheadFrames;
+
+  /*! UID of the next frame to decode and the frame that is being decoded (0 if none) */
+  BufferItemUidType NextReadAheadFrameUid;
+  BufferItemUidType DecodedReadAheadFrameUid;
+
+  /*! Incremented when the queue is flushed, a frame decoded before that is dropped */
+  int ReadAheadGeneration;
+
+  bool ReadAheadThreadStopRequested;
+  std::thread ReadAheadThread;
+  std::mutex ReadAheadMutex;
+  std::condition_variable ReadAheadCondition;
+
   /*! Buffer item UID of the last added frame in the local buffer */
   BufferItemUidType LastAddedFrameUid;
 
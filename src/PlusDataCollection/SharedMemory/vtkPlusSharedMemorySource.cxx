@@ -0,0 +1,239 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataSource.h"
+#include "vtkPlusSharedMemorySource.h"
+
+// IGSIO includes
+#include <igsioTrackedFrame.h>
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+#include <vtkSmartPointer.h>
+
+//----------------------------------------------------------------------------
+
+vtkStandardNewMacro(vtkPlusSharedMemorySource);
+
+//----------------------------------------------------------------------------
+vtkPlusSharedMemorySource::vtkPlusSharedMemorySource()
+  : LastItemUid(0)
+{
+  // The shared memory is polled, the acquisition rate determines the latency
+  this->AcquisitionRate = 100;
+  this->StartThreadForInternalUpdates = true;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusSharedMemorySource::~vtkPlusSharedMemorySource()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusSharedMemorySource::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "SharedMemoryName: " << this->SharedMemoryName << std::endl;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusSharedMemorySource::ReadConfiguration(vtkXMLDataElement* rootConfigElement)
+{
+  LOG_TRACE("vtkPlusSharedMemorySource::ReadConfiguration");
+  XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_READING(deviceConfig, rootConfigElement);
+
+  XML_READ_STRING_ATTRIBUTE_REQUIRED(SharedMemoryName, deviceConfig);
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusSharedMemorySource::WriteConfiguration(vtkXMLDataElement* rootConfigElement)
+{
+  LOG_TRACE("vtkPlusSharedMemorySource::WriteConfiguration");
+  XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_WRITING(deviceConfig, rootConfigElement);
+
+  XML_WRITE_STRING_ATTRIBUTE_IF_NOT_EMPTY(SharedMemoryName, deviceConfig);
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSharedMemorySource::NotifyConfigured()
+{
+  if (this->OutputChannels.empty())
+  {
+    LOG_ERROR("No output channels defined for vtkPlusSharedMemorySource. Cannot proceed.");
+    this->CorrectlyConfigured = false;
+    return PLUS_FAIL;
+  }
+
+  if (this->SharedMemoryName.empty())
+  {
+    LOG_ERROR("SharedMemoryName is not defined for vtkPlusSharedMemorySource. Cannot proceed.");
+    this->CorrectlyConfigured = false;
+    return PLUS_FAIL;
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSharedMemorySource::InternalConnect()
+{
+  // The publisher may be started later, the shared memory is opened in InternalUpdate when it becomes available
+  if (this->Ring.Open(this->SharedMemoryName) != PLUS_SUCCESS)
+  {
+    LOG_INFO("Shared memory " << this->SharedMemoryName << " is not available yet, waiting for the publisher");
+  }
+  this->LastItemUid = 0;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSharedMemorySource::InternalDisconnect()
+{
+  this->Ring.Close();
+  this->ImageData.clear();
+  this->FieldData.clear();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSharedMemorySource::InternalUpdate()
+{
+  LOG_TRACE("vtkPlusSharedMemorySource::InternalUpdate");
+
+  if (this->Ring.IsClosedByPublisher())
+  {
+    LOG_INFO("Publisher closed shared memory " << this->SharedMemoryName);
+    this->Ring.Close();
+  }
+  if (!this->Ring.IsOpen())
+  {
+    if (this->Ring.Open(this->SharedMemoryName) != PLUS_SUCCESS)
+    {
+      // No need to update until the publisher creates the shared memory
+      return PLUS_SUCCESS;
+    }
+    LOG_INFO("Receiving frames from shared memory " << this->SharedMemoryName);
+    this->LastItemUid = 0;
+  }
+
+  BufferItemUidType latestUid = this->Ring.GetLatestItemUid();
+  if (latestUid == 0)
+  {
+    return PLUS_SUCCESS;
+  }
+  if (latestUid < this->LastItemUid)
+  {
+    // The shared memory was reinitialized by a new publisher
+    this->LastItemUid = 0;
+  }
+
+  // Start from the most recent item after the shared memory is opened
+  BufferItemUidType firstUid = (this->LastItemUid == 0 ? latestUid : this->LastItemUid + 1);
+  BufferItemUidType oldestUid = this->Ring.GetOldestItemUid();
+  if (firstUid < oldestUid)
+  {
+    LOG_WARNING("Reading from shared memory " << this->SharedMemoryName << " cannot keep up with the publisher, " << oldestUid - firstUid << " frames are skipped");
+    firstUid = oldestUid;
+  }
+
+  // Timestamps are stored as universal time in the shared memory
+  const double universalToSystemTimeOffsetSec = vtkIGSIOAccurateTimer::GetSystemTime() - vtkIGSIOAccurateTimer::GetUniversalTime();
+
+  PlusStatus status = PLUS_SUCCESS;
+  for (BufferItemUidType uid = firstUid; uid <= latestUid; ++uid)
+  {
+    SharedMemoryRing::ItemInfo info;
+    if (this->Ring.CopyItem(uid, info, this->ImageData, this->FieldData) != ITEM_OK)
+    {
+      LOG_DEBUG("Item " << uid << " was overwritten in shared memory " << this->SharedMemoryName << " before it could be read");
+      continue;
+    }
+    this->LastItemUid = uid;
+    if (this->AddItemToDataSources(info, universalToSystemTimeOffsetSec) != PLUS_SUCCESS)
+    {
+      status = PLUS_FAIL;
+    }
+    this->FrameNumber++;
+  }
+
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSharedMemorySource::AddItemToDataSources(const SharedMemoryRing::ItemInfo& info, double universalToSystemTimeOffsetSec)
+{
+  double filteredTimestamp = info.FilteredTimestamp + universalToSystemTimeOffsetSec;
+  double unfilteredTimestamp = info.UnfilteredTimestamp + universalToSystemTimeOffsetSec;
+
+  std::map<std::string, std::string> fields;
+  if (SharedMemoryRing::DecodeFields(this->FieldData.data(), this->FieldData.size(), fields) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Invalid frame fields in item " << info.Uid << " of shared memory " << this->SharedMemoryName);
+    return PLUS_FAIL;
+  }
+  // The transforms are parsed from the fields the same way as from a tracked frame
+  igsioTrackedFrame trackedFrame;
+  igsioFieldMapType customFields;
+  for (std::map<std::string, std::string>::const_iterator fieldIt = fields.begin(); fieldIt != fields.end(); ++fieldIt)
+  {
+    trackedFrame.SetFrameField(fieldIt->first, fieldIt->second);
+    customFields[fieldIt->first].second = fieldIt->second;
+  }
+
+  PlusStatus status = PLUS_SUCCESS;
+
+  vtkPlusDataSource* videoSource(NULL);
+  if (info.ImageDataSizeBytes > 0 && this->GetFirstActiveOutputVideoSource(videoSource) == PLUS_SUCCESS && videoSource != NULL)
+  {
+    FrameSizeType frameSize = { info.FrameSize[0], info.FrameSize[1], info.FrameSize[2] };
+    if (videoSource->GetNumberOfItems() == 0)
+    {
+      // Init the buffer with the metadata from the first frame
+      videoSource->SetImageType(static_cast<US_IMAGE_TYPE>(info.ImageType));
+      videoSource->SetPixelType(static_cast<igsioCommon::VTKScalarPixelType>(info.ScalarType));
+      videoSource->SetNumberOfScalarComponents(info.NumberOfScalarComponents);
+      videoSource->SetInputFrameSize(frameSize);
+    }
+    if (videoSource->AddItem(&this->ImageData[0], static_cast<US_IMAGE_ORIENTATION>(info.ImageOrientation), frameSize,
+                             static_cast<igsioCommon::VTKScalarPixelType>(info.ScalarType), info.NumberOfScalarComponents,
+                             static_cast<US_IMAGE_TYPE>(info.ImageType), 0, this->FrameNumber, unfilteredTimestamp, filteredTimestamp, &customFields) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to add frame " << info.Uid << " of shared memory " << this->SharedMemoryName << " to the video source");
+      status = PLUS_FAIL;
+    }
+  }
+
+  vtkSmartPointer<vtkMatrix4x4> toolMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  for (DataSourceContainerConstIterator toolIt = this->GetToolIteratorBegin(); toolIt != this->GetToolIteratorEnd(); ++toolIt)
+  {
+    vtkPlusDataSource* tool = toolIt->second;
+    igsioTransformName transformName(tool->GetId());
+    ToolStatus toolStatus = TOOL_MISSING;
+    toolMatrix->Identity();
+    if (trackedFrame.GetFrameTransform(transformName, toolMatrix) != PLUS_SUCCESS
+        || trackedFrame.GetFrameTransformStatus(transformName, toolStatus) != PLUS_SUCCESS)
+    {
+      // the publisher does not provide this transform
+      toolStatus = TOOL_MISSING;
+    }
+    if (this->ToolTimeStampedUpdateWithoutFiltering(tool->GetId(), toolMatrix, toolStatus, unfilteredTimestamp, filteredTimestamp) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to add transform " << tool->GetId() << " of item " << info.Uid << " of shared memory " << this->SharedMemoryName);
+      status = PLUS_FAIL;
+    }
+  }
+
+  return status;
+}
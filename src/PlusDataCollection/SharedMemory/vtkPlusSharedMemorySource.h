@@ -0,0 +1,74 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusSharedMemorySource_h
+#define __vtkPlusSharedMemorySource_h
+
+#include "vtkPlusDataCollectionExport.h"
+
+#include "PlusSharedMemoryRing.h"
+#include "vtkPlusDevice.h"
+
+/*!
+\class vtkPlusSharedMemorySource
+\brief Device that reads frames from a shared memory output of a channel (published by another Plus process on the same computer)
+
+The image of each frame is added to the video data source, the transforms are added to the tool data sources
+that have the same name as the transforms (for example, the transform ProbeToTracker is added to the tool Probe if the
+ToolReferenceFrame of the device is Tracker). The original timestamps of the frames are kept.
+
+If the publisher is not running yet or it is restarted then the device opens the shared memory when it becomes available.
+
+Attributes:
+\li SharedMemoryName: name of the shared memory, same as the SharedMemoryOutputName attribute of the published channel
+
+\ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport vtkPlusSharedMemorySource : public vtkPlusDevice
+{
+public:
+  static vtkPlusSharedMemorySource* New();
+  vtkTypeMacro(vtkPlusSharedMemorySource, vtkPlusDevice);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  /*! Read configuration from xml data */
+  virtual PlusStatus ReadConfiguration(vtkXMLDataElement* config);
+  /*! Write configuration to xml data */
+  virtual PlusStatus WriteConfiguration(vtkXMLDataElement* config);
+
+  /*! Add the frames that were published since the last update to the data sources */
+  virtual PlusStatus InternalUpdate();
+
+  /*! Verify the device is correctly configured */
+  virtual PlusStatus NotifyConfigured();
+
+  vtkGetStdStringMacro(SharedMemoryName);
+  vtkSetStdStringMacro(SharedMemoryName);
+
+protected:
+  vtkPlusSharedMemorySource();
+  ~vtkPlusSharedMemorySource();
+
+  virtual PlusStatus InternalConnect();
+  virtual PlusStatus InternalDisconnect();
+
+  /*! Add one item of the shared memory to the data sources */
+  PlusStatus AddItemToDataSources(const SharedMemoryRing::ItemInfo& info, double universalToSystemTimeOffsetSec);
+
+  std::string SharedMemoryName;
+  SharedMemoryRing Ring;
+  /*! UID of the last item that was read from the shared memory, 0 if no item has been read since the shared memory was opened */
+  BufferItemUidType LastItemUid;
+  /*! Buffers for copying the items from the shared memory, kept to avoid memory allocation for each frame */
+  std::vector<unsigned char> ImageData;
+  std::string FieldData;
+
+private:
+  vtkPlusSharedMemorySource(const vtkPlusSharedMemorySource&);  // Not implemented.
+  void operator=(const vtkPlusSharedMemorySource&);  // Not implemented.
+};
+
+#endif
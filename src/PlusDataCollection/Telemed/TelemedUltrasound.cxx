@@ -250,10 +250,20 @@ LPBITMAPINFO DSGetBITMAPINFOForDIBSection(HBITMAP hBitmap)
 //----------------------------------------------------------------------------
 unsigned char* TelemedUltrasound::CaptureFrame()
 {
-  if (m_data_view == NULL || m_mixer_control == NULL)
+  if (CaptureFrame(m_FrameBuffer, m_FrameSize) != PLUS_SUCCESS || m_FrameBuffer.empty())
   {
     return NULL;
   }
+  return &(m_FrameBuffer[0]);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus TelemedUltrasound::CaptureFrame(std::vector<unsigned char>& frameBuffer, FrameSizeType& frameSize)
+{
+  if (m_data_view == NULL || m_mixer_control == NULL)
+  {
+    return PLUS_FAIL;
+  }
 
   /*
   {
@@ -268,7 +278,7 @@ unsigned char* TelemedUltrasound::CaptureFrame()
   m_mixer_control->GetCurrentBitmap((LONG*)&bmp);
   if (bmp == NULL)
   {
-    return NULL;
+    return PLUS_FAIL;
   }
 
   int h = 0;
@@ -278,31 +288,23 @@ unsigned char* TelemedUltrasound::CaptureFrame()
     if (pbmi == NULL)
     {
       ::DeleteObject(bmp);
-      return NULL;
+      return PLUS_FAIL;
     }
     h = abs(pbmi->bmiHeader.biHeight);
     pitch = BYTESPERLINE(abs(pbmi->bmiHeader.biWidth), pbmi->bmiHeader.biBitCount);
-    m_FrameSize[0] = abs(pbmi->bmiHeader.biWidth);
-    m_FrameSize[1] = abs(pbmi->bmiHeader.biHeight);
-    m_FrameSize[2] = 1;
+    frameSize[0] = abs(pbmi->bmiHeader.biWidth);
+    frameSize[1] = abs(pbmi->bmiHeader.biHeight);
+    frameSize[2] = 1;
     free(pbmi);
   }
 
   int cbBuffer = pitch * h;
-  if (m_FrameBuffer.size() != cbBuffer)
-  {
-    m_FrameBuffer.resize(cbBuffer);
-  }
-  unsigned char* pBuffer = NULL;
-  if (!m_FrameBuffer.empty())
-  {
-    pBuffer = &(m_FrameBuffer[0]);
-  }
-  if (pBuffer == NULL)
+  if (cbBuffer <= 0)
   {
     ::DeleteObject(bmp);
-    return NULL;
+    return PLUS_FAIL;
   }
+  frameBuffer.resize(cbBuffer);
 
   // get a pointer which points to the image bits for a DIBSection
   DIBSECTION ds;
@@ -310,15 +312,15 @@ unsigned char* TelemedUltrasound::CaptureFrame()
   {
     LOG_ERROR("Failed to get pointer to bitmap");
     ::DeleteObject(bmp);
-    return NULL;
+    return PLUS_FAIL;
   }
   LPBYTE src = (LPBYTE)ds.dsBm.bmBits;
 
-  memcpy(pBuffer, src, pitch * h);
+  memcpy(&(frameBuffer[0]), src, cbBuffer);
 
   ::DeleteObject(bmp);
 
-  return pBuffer;
+  return PLUS_SUCCESS;
 }
 
 //----------------------------------------------------------------------------
@@ -24,6 +24,11 @@ public:
   void Disconnect();
 
   unsigned char* CaptureFrame();
+  /*!
+    Capture the current frame into the provided buffer, which keeps its capacity between calls.
+    Only the bitmap retrieval and a single copy are performed, so it can be called at the maximum frame rate of the probe.
+  */
+  PlusStatus CaptureFrame(std::vector<unsigned char>& frameBuffer, FrameSizeType& frameSize);
   unsigned long GetBufferSize() {return m_FrameBuffer.size();}
   void GetFrameSize(FrameSizeType& frameSize) { frameSize = m_FrameSize; }
 
@@ -7,6 +7,7 @@ See License.txt for details.
 // Local includes
 #include "PlusConfigure.h"
 #include "PixelCodec.h"
+#include "vtkIGSIOAccurateTimer.h"
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataSource.h"
 #include "vtkPlusTelemedVideoSource.h"
@@ -17,6 +18,17 @@ See License.txt for details.
 #include <vtkImageImport.h>
 #include <vtkObjectFactory.h>
 
+// STL includes
+#include <chrono>
+
+namespace
+{
+  // Maximum time to wait for the acquisition thread to apply a parameter change
+  const double IMAGING_PARAMETER_CHANGE_TIMEOUT_SEC = 2.0;
+  // The conversion thread checks for captured frames at least this often, in case a wakeup is missed
+  const int CONVERSION_WAKEUP_INTERVAL_MSEC = 5;
+}
+
 //----------------------------------------------------------------------------
 
 vtkStandardNewMacro(vtkPlusTelemedVideoSource); // Corresponds to the implementation of : static vtkPlusTelemedVideoSource *New();  (in .h file)
@@ -31,6 +43,13 @@ vtkPlusTelemedVideoSource::vtkPlusTelemedVideoSource()
   , PowerDb(-1)
   , FocusDepthPercent(-1)
   , ConnectedToDevice(false)
+  , FrameQueueSize(4)
+  , NumberOfCapturedFrames(0)
+  , NumberOfConvertedFrames(0)
+  , NumberOfDroppedFrames(0)
+  , ConversionThreadStopRequested(false)
+  , NumberOfStartedImagingParameterBatches(0)
+  , NumberOfAppliedImagingParameterBatches(0)
 {
   this->FrameSize[0] = 512;
   this->FrameSize[1] = 512;
@@ -44,6 +63,12 @@ vtkPlusTelemedVideoSource::vtkPlusTelemedVideoSource()
 //----------------------------------------------------------------------------
 vtkPlusTelemedVideoSource::~vtkPlusTelemedVideoSource()
 {
+  if (this->ConversionThread.joinable())
+  {
+    this->ConversionThreadStopRequested = true;
+    this->ConversionWakeupCondition.notify_one();
+    this->ConversionThread.join();
+  }
   delete this->Device;
   this->Device = NULL;
 }
@@ -52,6 +77,8 @@ vtkPlusTelemedVideoSource::~vtkPlusTelemedVideoSource()
 void vtkPlusTelemedVideoSource::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "FrameQueueSize: " << this->FrameQueueSize << std::endl;
+  os << indent << "NumberOfDroppedFrames: " << this->NumberOfDroppedFrames << std::endl;
 }
 
 //-----------------------------------------------------------------------------
@@ -68,6 +95,12 @@ PlusStatus vtkPlusTelemedVideoSource::ReadConfiguration(vtkXMLDataElement* rootC
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, GainPercent, deviceConfig);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, PowerDb, deviceConfig);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, FocusDepthPercent, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, FrameQueueSize, deviceConfig);
+  if (this->FrameQueueSize < 1)
+  {
+    LOG_ERROR("FrameQueueSize must be at least 1, it is " << this->FrameQueueSize);
+    return PLUS_FAIL;
+  }
 
   return PLUS_SUCCESS;
 }
@@ -87,6 +120,7 @@ PlusStatus vtkPlusTelemedVideoSource::WriteConfiguration(vtkXMLDataElement* root
   deviceConfig->SetDoubleAttribute("GainPercent", this->GainPercent);
   deviceConfig->SetDoubleAttribute("PowerDb", this->PowerDb);
   deviceConfig->SetDoubleAttribute("FocusDepthPercent", this->FocusDepthPercent);
+  deviceConfig->SetIntAttribute("FrameQueueSize", this->FrameQueueSize);
   return PLUS_SUCCESS;
 }
 
@@ -138,25 +172,121 @@ PlusStatus vtkPlusTelemedVideoSource::InternalDisconnect()
 PlusStatus vtkPlusTelemedVideoSource::InternalUpdate()
 {
   LOG_TRACE("vtkPlusTelemedVideoSource::InternalUpdate");
+
+  // Parameter changes are applied between two frames, so they do not interrupt a frame retrieval
+  this->ApplyQueuedImagingParameterChanges();
+
   if (!this->Recording)
   {
     // drop the frame, we are not recording data now
     return PLUS_SUCCESS;
   }
 
+  unsigned int numberOfCapturedFrames = this->NumberOfCapturedFrames.load(std::memory_order_relaxed);
+  if (numberOfCapturedFrames - this->NumberOfConvertedFrames.load(std::memory_order_acquire) >= this->CapturedFrames.size())
+  {
+    // all slots are in use, the conversion cannot keep up with the acquisition
+    this->NumberOfDroppedFrames++;
+    return PLUS_SUCCESS;
+  }
+
   // Capture one frame from the Telemed device
-  unsigned char* bufferData = this->Device->CaptureFrame();
-  if (bufferData == NULL)
+  CapturedFrame& frame = this->CapturedFrames[numberOfCapturedFrames % this->CapturedFrames.size()];
+  if (this->Device->CaptureFrame(frame.Data, frame.FrameSize) != PLUS_SUCCESS)
   {
     LOG_ERROR("No frame received by the device");
     return PLUS_FAIL;
   }
+  frame.Timestamp = vtkIGSIOAccurateTimer::GetSystemTime();
 
   this->FrameNumber++;
+  frame.FrameNumber = this->FrameNumber;
+
+  // Hand off the slot to the conversion thread
+  this->NumberOfCapturedFrames.store(numberOfCapturedFrames + 1, std::memory_order_release);
+  this->ConversionWakeupCondition.notify_one();
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTelemedVideoSource::InternalStartRecording()
+{
+  {
+    // The parameter queries return the cached values while recording, so read the current values in one batch
+    std::lock_guard<std::mutex> lock(this->ImagingParameterMutex);
+    const ImagingParameter parameters[] = { IMAGING_PARAMETER_FREQUENCY, IMAGING_PARAMETER_DEPTH, IMAGING_PARAMETER_GAIN,
+                                            IMAGING_PARAMETER_DYNRANGE, IMAGING_PARAMETER_POWER, IMAGING_PARAMETER_FOCUS_DEPTH
+                                          };
+    for (unsigned int i = 0; i < sizeof(parameters) / sizeof(parameters[0]); ++i)
+    {
+      double value = 0;
+      if (this->GetDeviceImagingParameter(parameters[i], value) == PLUS_SUCCESS)
+      {
+        this->GetCachedImagingParameter(parameters[i]) = value;
+      }
+    }
+  }
+
+  this->CapturedFrames.resize(this->FrameQueueSize);
+  this->NumberOfCapturedFrames = 0;
+  this->NumberOfConvertedFrames = 0;
+  this->NumberOfDroppedFrames = 0;
+  this->ConversionThreadStopRequested = false;
+  this->ConversionThread = std::thread(&vtkPlusTelemedVideoSource::ConvertCapturedFrames, this);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTelemedVideoSource::InternalStopRecording()
+{
+  // The acquisition thread is stopped already, apply the changes that it has not picked up
+  this->ApplyQueuedImagingParameterChanges();
+
+  if (this->ConversionThread.joinable())
+  {
+    this->ConversionThreadStopRequested = true;
+    this->ConversionWakeupCondition.notify_one();
+    this->ConversionThread.join();
+  }
+  if (this->NumberOfDroppedFrames > 0)
+  {
+    LOG_WARNING(this->NumberOfDroppedFrames << " frames were not retrieved because the conversion could not keep up with the acquisition. Consider increasing FrameQueueSize.");
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTelemedVideoSource::ConvertCapturedFrames()
+{
+  while (true)
+  {
+    unsigned int numberOfConvertedFrames = this->NumberOfConvertedFrames.load(std::memory_order_relaxed);
+    if (numberOfConvertedFrames == this->NumberOfCapturedFrames.load(std::memory_order_acquire))
+    {
+      if (this->ConversionThreadStopRequested)
+      {
+        // all captured frames are converted
+        break;
+      }
+      std::unique_lock<std::mutex> lock(this->ConversionWakeupMutex);
+      this->ConversionWakeupCondition.wait_for(lock, std::chrono::milliseconds(CONVERSION_WAKEUP_INTERVAL_MSEC));
+      continue;
+    }
 
-  FrameSizeType frameSizeInPix = {0, 0, 1};
-  this->Device->GetFrameSize(frameSizeInPix);
-  int bufferSize = this->Device->GetBufferSize();
+    this->ConvertAndAddFrame(this->CapturedFrames[numberOfConvertedFrames % this->CapturedFrames.size()]);
+
+    // Give back the slot to the acquisition thread
+    this->NumberOfConvertedFrames.store(numberOfConvertedFrames + 1, std::memory_order_release);
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTelemedVideoSource::ConvertAndAddFrame(CapturedFrame& frame)
+{
+  const FrameSizeType& frameSizeInPix = frame.FrameSize;
+  unsigned char* bufferData = &frame.Data[0];
+  int bufferSize = frame.Data.size();
   if (frameSizeInPix[0]*frameSizeInPix[1] == 0)
   {
     LOG_ERROR("Failed to retrieve valid frame size (got " << frameSizeInPix[0] << "x" << frameSizeInPix[1]);
@@ -222,7 +352,7 @@ PlusStatus vtkPlusTelemedVideoSource::InternalUpdate()
   }
 
   // Add the frame to the stream buffer
-  PlusStatus status = aSource->AddItem(&this->UncompressedVideoFrame, this->FrameNumber);
+  PlusStatus status = aSource->AddItem(&this->UncompressedVideoFrame, frame.FrameNumber, frame.Timestamp);
   this->Modified();
 
   return status;
@@ -231,58 +361,194 @@ PlusStatus vtkPlusTelemedVideoSource::InternalUpdate()
 
 /*********** PARAMETERS *************/
 
-#define IMAGING_PARAMETER_SET(parameterName) \
+#define IMAGING_PARAMETER_SET(parameterName, parameterId) \
 PlusStatus vtkPlusTelemedVideoSource::Set##parameterName(double a##parameterName) \
 { \
   LOG_INFO("Setting US parameter "<<#parameterName<<"="<<a##parameterName); \
-  if (this->Device==NULL) \
-  { \
-    /* Connection has not been established yet. Parameter value will be set upon connection. */ \
-    this->parameterName=a##parameterName; \
-    return PLUS_SUCCESS; \
-  } \
-  int oldParamValue = this->parameterName; \
-  this->parameterName=a##parameterName; \
-  if (this->Device->Set##parameterName(this->parameterName)!=PLUS_SUCCESS) \
+  if (this->SetImagingParameter(parameterId, a##parameterName)!=PLUS_SUCCESS) \
   { \
     LOG_ERROR("vtkPlusTelemedVideoSource parameter setting failed: "<<#parameterName<<"="<<a##parameterName); \
-    this->parameterName=oldParamValue; \
     return PLUS_FAIL; \
   } \
   return PLUS_SUCCESS; \
 }
 
-#define IMAGING_PARAMETER_GET(parameterName) \
+#define IMAGING_PARAMETER_GET(parameterName, parameterId) \
 PlusStatus vtkPlusTelemedVideoSource::Get##parameterName(double &a##parameterName) \
 { \
-  if (this->Device==NULL) \
+  if (this->GetImagingParameter(parameterId, a##parameterName)!=PLUS_SUCCESS) \
   { \
-    /* Connection has not been established yet. Return cached parameter value. */ \
-    a##parameterName=this->parameterName; \
-    return PLUS_SUCCESS; \
-  } \
-  if (this->Device->Get##parameterName(this->parameterName)!=PLUS_SUCCESS) \
-  { \
-    LOG_ERROR("vtkPlusTelemedVideoSource parameter setting failed: "<<parameterName<<"="<<a##parameterName); \
+    LOG_ERROR("vtkPlusTelemedVideoSource parameter getting failed: "<<#parameterName); \
     return PLUS_FAIL; \
   } \
-  a##parameterName=this->parameterName; \
   return PLUS_SUCCESS; \
 }
 
-IMAGING_PARAMETER_GET(FrequencyMhz);
-IMAGING_PARAMETER_GET(DepthMm);
-IMAGING_PARAMETER_GET(GainPercent);
-IMAGING_PARAMETER_GET(DynRangeDb);
-IMAGING_PARAMETER_GET(PowerDb);
-IMAGING_PARAMETER_GET(FocusDepthPercent);
-
-IMAGING_PARAMETER_SET(FrequencyMhz);
-IMAGING_PARAMETER_SET(DepthMm);
-IMAGING_PARAMETER_SET(GainPercent);
-IMAGING_PARAMETER_SET(DynRangeDb);
-IMAGING_PARAMETER_SET(PowerDb);
-IMAGING_PARAMETER_SET(FocusDepthPercent);
+IMAGING_PARAMETER_GET(FrequencyMhz, IMAGING_PARAMETER_FREQUENCY);
+IMAGING_PARAMETER_GET(DepthMm, IMAGING_PARAMETER_DEPTH);
+IMAGING_PARAMETER_GET(GainPercent, IMAGING_PARAMETER_GAIN);
+IMAGING_PARAMETER_GET(DynRangeDb, IMAGING_PARAMETER_DYNRANGE);
+IMAGING_PARAMETER_GET(PowerDb, IMAGING_PARAMETER_POWER);
+IMAGING_PARAMETER_GET(FocusDepthPercent, IMAGING_PARAMETER_FOCUS_DEPTH);
+
+IMAGING_PARAMETER_SET(FrequencyMhz, IMAGING_PARAMETER_FREQUENCY);
+IMAGING_PARAMETER_SET(DepthMm, IMAGING_PARAMETER_DEPTH);
+IMAGING_PARAMETER_SET(GainPercent, IMAGING_PARAMETER_GAIN);
+IMAGING_PARAMETER_SET(DynRangeDb, IMAGING_PARAMETER_DYNRANGE);
+IMAGING_PARAMETER_SET(PowerDb, IMAGING_PARAMETER_POWER);
+IMAGING_PARAMETER_SET(FocusDepthPercent, IMAGING_PARAMETER_FOCUS_DEPTH);
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTelemedVideoSource::SetImagingParameter(ImagingParameter parameter, double value)
+{
+  if (this->Device == NULL)
+  {
+    // Connection has not been established yet. Parameter value will be set upon connection.
+    this->GetCachedImagingParameter(parameter) = value;
+    return PLUS_SUCCESS;
+  }
+
+  std::unique_lock<std::mutex> lock(this->ImagingParameterMutex);
+  if (!this->Recording)
+  {
+    if (this->SetDeviceImagingParameter(parameter, value) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    this->GetCachedImagingParameter(parameter) = value;
+    return PLUS_SUCCESS;
+  }
+
+  // Queue the change for the acquisition thread and wait until the batch that contains it is applied
+  this->QueuedImagingParameterChanges[parameter] = value;
+  unsigned int batch = this->NumberOfStartedImagingParameterBatches + 1;
+  if (!this->ImagingParameterChangesApplied.wait_for(lock, std::chrono::duration<double>(IMAGING_PARAMETER_CHANGE_TIMEOUT_SEC),
+      [this, batch] { return this->NumberOfAppliedImagingParameterBatches >= batch; }))
+  {
+    this->QueuedImagingParameterChanges.erase(parameter);
+    LOG_ERROR("Imaging parameter change was not applied by the acquisition thread in " << IMAGING_PARAMETER_CHANGE_TIMEOUT_SEC << " sec");
+    return PLUS_FAIL;
+  }
+  return this->ImagingParameterChangeStatus[parameter];
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTelemedVideoSource::GetImagingParameter(ImagingParameter parameter, double& value)
+{
+  std::lock_guard<std::mutex> lock(this->ImagingParameterMutex);
+  if (this->Device == NULL || this->Recording)
+  {
+    // Return the cached value, while recording it is kept up to date by the acquisition thread
+    value = this->GetCachedImagingParameter(parameter);
+    return PLUS_SUCCESS;
+  }
+  if (this->GetDeviceImagingParameter(parameter, value) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  this->GetCachedImagingParameter(parameter) = value;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTelemedVideoSource::ApplyQueuedImagingParameterChanges()
+{
+  std::map<ImagingParameter, double> changes;
+  unsigned int batch = 0;
+  {
+    std::lock_guard<std::mutex> lock(this->ImagingParameterMutex);
+    if (this->QueuedImagingParameterChanges.empty())
+    {
+      return;
+    }
+    changes.swap(this->QueuedImagingParameterChanges);
+    batch = ++this->NumberOfStartedImagingParameterBatches;
+  }
+
+  // The device is called without holding the lock, so the cached values can be read meanwhile
+  std::map<ImagingParameter, PlusStatus> statuses;
+  for (std::map<ImagingParameter, double>::iterator changeIt = changes.begin(); changeIt != changes.end(); ++changeIt)
+  {
+    statuses[changeIt->first] = this->SetDeviceImagingParameter(changeIt->first, changeIt->second);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->ImagingParameterMutex);
+    for (std::map<ImagingParameter, double>::iterator changeIt = changes.begin(); changeIt != changes.end(); ++changeIt)
+    {
+      this->ImagingParameterChangeStatus[changeIt->first] = statuses[changeIt->first];
+      if (statuses[changeIt->first] == PLUS_SUCCESS)
+      {
+        this->GetCachedImagingParameter(changeIt->first) = changeIt->second;
+      }
+    }
+    this->NumberOfAppliedImagingParameterBatches = batch;
+  }
+  this->ImagingParameterChangesApplied.notify_all();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTelemedVideoSource::SetDeviceImagingParameter(ImagingParameter parameter, double value)
+{
+  switch (parameter)
+  {
+    case IMAGING_PARAMETER_FREQUENCY:
+      return this->Device->SetFrequencyMhz(value);
+    case IMAGING_PARAMETER_DEPTH:
+      return this->Device->SetDepthMm(value);
+    case IMAGING_PARAMETER_GAIN:
+      return this->Device->SetGainPercent(value);
+    case IMAGING_PARAMETER_DYNRANGE:
+      return this->Device->SetDynRangeDb(value);
+    case IMAGING_PARAMETER_POWER:
+      return this->Device->SetPowerDb(value);
+    case IMAGING_PARAMETER_FOCUS_DEPTH:
+      return this->Device->SetFocusDepthPercent(value);
+  }
+  return PLUS_FAIL;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTelemedVideoSource::GetDeviceImagingParameter(ImagingParameter parameter, double& value)
+{
+  switch (parameter)
+  {
+    case IMAGING_PARAMETER_FREQUENCY:
+      return this->Device->GetFrequencyMhz(value);
+    case IMAGING_PARAMETER_DEPTH:
+      return this->Device->GetDepthMm(value);
+    case IMAGING_PARAMETER_GAIN:
+      return this->Device->GetGainPercent(value);
+    case IMAGING_PARAMETER_DYNRANGE:
+      return this->Device->GetDynRangeDb(value);
+    case IMAGING_PARAMETER_POWER:
+      return this->Device->GetPowerDb(value);
+    case IMAGING_PARAMETER_FOCUS_DEPTH:
+      return this->Device->GetFocusDepthPercent(value);
+  }
+  return PLUS_FAIL;
+}
+
+//----------------------------------------------------------------------------
+double& vtkPlusTelemedVideoSource::GetCachedImagingParameter(ImagingParameter parameter)
+{
+  switch (parameter)
+  {
+    case IMAGING_PARAMETER_FREQUENCY:
+      return this->FrequencyMhz;
+    case IMAGING_PARAMETER_DEPTH:
+      return this->DepthMm;
+    case IMAGING_PARAMETER_GAIN:
+      return this->GainPercent;
+    case IMAGING_PARAMETER_DYNRANGE:
+      return this->DynRangeDb;
+    case IMAGING_PARAMETER_POWER:
+      return this->PowerDb;
+    case IMAGING_PARAMETER_FOCUS_DEPTH:
+    default:
+      return this->FocusDepthPercent;
+  }
+}
 
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusTelemedVideoSource::NotifyConfigured()
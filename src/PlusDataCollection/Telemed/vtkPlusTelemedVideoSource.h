@@ -11,6 +11,13 @@
 #include "vtkPlusDataCollectionExport.h"
 #include "vtkPlusUsDevice.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 class vtkImageImport;
 class vtkPlusUsImagingParameters;
 
@@ -22,6 +29,13 @@ class vtkPlusUsImagingParameters;
   Requires the PLUS_USE_TELEMED option in CMake.
   Requires Telemed Usgfw2 SDK (SDK provided by Telemed).
 
+  The acquisition thread only retrieves the bitmap of the current frame into a slot of a ring of FrameQueueSize frames.
+  The slots are handed off without locking to a conversion thread, which decodes the frames and adds them to the buffer.
+  If all slots are in use then the frame is not retrieved.
+  While recording, the imaging parameter changes are queued and applied in a batch by the acquisition thread between
+  two frames, and the imaging parameter queries return the cached values, so that no other thread calls the device
+  while a frame is retrieved.
+
   \ingroup PlusLibDataCollection
 */
 
@@ -104,9 +118,74 @@ protected:
   /*! Device-specific disconnect */
   PlusStatus InternalDisconnect();
 
+  /*! Start the conversion thread */
+  virtual PlusStatus InternalStartRecording();
+  /*! Convert the frames that are already captured, then stop the conversion thread */
+  virtual PlusStatus InternalStopRecording();
+
+  /*! Imaging parameters that can be changed while recording */
+  enum ImagingParameter
+  {
+    IMAGING_PARAMETER_FREQUENCY,
+    IMAGING_PARAMETER_DEPTH,
+    IMAGING_PARAMETER_GAIN,
+    IMAGING_PARAMETER_DYNRANGE,
+    IMAGING_PARAMETER_POWER,
+    IMAGING_PARAMETER_FOCUS_DEPTH
+  };
+
+  /*! Set a parameter in the device. While recording, the change is applied by the acquisition thread and the call waits for it. */
+  PlusStatus SetImagingParameter(ImagingParameter parameter, double value);
+  /*! Get a parameter from the device. While recording, the cached value is returned. */
+  PlusStatus GetImagingParameter(ImagingParameter parameter, double& value);
+
+  /*! Call the device to set or get a parameter */
+  PlusStatus SetDeviceImagingParameter(ImagingParameter parameter, double value);
+  PlusStatus GetDeviceImagingParameter(ImagingParameter parameter, double& value);
+  /*! Cached value of a parameter */
+  double& GetCachedImagingParameter(ImagingParameter parameter);
+
+  /*! Apply the queued parameter changes in one batch. Called by the acquisition thread. */
+  void ApplyQueuedImagingParameterChanges();
+
+  /*! A slot of the ring of captured frames */
+  struct CapturedFrame
+  {
+    std::vector<unsigned char> Data;
+    FrameSizeType FrameSize;
+    long FrameNumber;
+    double Timestamp;
+  };
+
+  /*! Decode the captured frames and add them to the buffer. Runs in the conversion thread. */
+  void ConvertCapturedFrames();
+  PlusStatus ConvertAndAddFrame(CapturedFrame& frame);
+
   TelemedUltrasound* Device;
   bool ConnectedToDevice;
 
+  /*! Number of slots in the ring of captured frames */
+  int FrameQueueSize;
+  std::vector<CapturedFrame> CapturedFrames;
+  /*! Number of frames captured since the start of the recording, only written by the acquisition thread */
+  std::atomic<unsigned int> NumberOfCapturedFrames;
+  /*! Number of frames converted since the start of the recording, only written by the conversion thread */
+  std::atomic<unsigned int> NumberOfConvertedFrames;
+  unsigned int NumberOfDroppedFrames;
+  std::atomic<bool> ConversionThreadStopRequested;
+  std::thread ConversionThread;
+  /*! Only used for waking up the conversion thread, the slots are handed off without it */
+  std::mutex ConversionWakeupMutex;
+  std::condition_variable ConversionWakeupCondition;
+
+  /*! Protects the queued parameter changes and the cached parameter values */
+  std::mutex ImagingParameterMutex;
+  std::condition_variable ImagingParameterChangesApplied;
+  std::map<ImagingParameter, double> QueuedImagingParameterChanges;
+  std::map<ImagingParameter, PlusStatus> ImagingParameterChangeStatus;
+  unsigned int NumberOfStartedImagingParameterBatches;
+  unsigned int NumberOfAppliedImagingParameterBatches;
+
   igsioVideoFrame UncompressedVideoFrame;
 
   FrameSizeType FrameSize;
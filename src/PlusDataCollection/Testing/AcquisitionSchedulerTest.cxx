@@ -0,0 +1,147 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file AcquisitionSchedulerTest.cxx
+  \brief Verifies that the acquisition scheduler runs tasks with the requested period.
+
+  Two tasks with different periods are run on the same scheduler thread. The number of updates
+  and the period error statistics are checked, then tasks are stopped by returning false,
+  by removing themselves from the task function, and by RemoveTask.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusAcquisitionScheduler.h"
+
+#include <vtksys/CommandLineArguments.hxx>
+
+#include <atomic>
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  double testDurationSec(2.0);
+  double maxPeriodErrorSec(0.010);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--test-duration-sec", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &testDurationSec, "Duration of running the tasks (Default: 2.0).");
+  args.AddArgument("--max-period-error-sec", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &maxPeriodErrorSec, "Maximum allowed median period error (Default: 0.010).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  AcquisitionScheduler& scheduler = AcquisitionScheduler::GetInstance();
+  int numberOfErrors = 0;
+
+  // Two periodic tasks on the same thread
+  const double slowPeriodSec = 0.020;
+  const double fastPeriodSec = 0.005;
+  std::atomic<int> slowTaskUpdates(0);
+  std::atomic<int> fastTaskUpdates(0);
+  int slowTaskId = 0;
+  int fastTaskId = 0;
+  if (scheduler.AddTask(&slowTaskId, "AcquisitionSchedulerTest", slowPeriodSec, [&slowTaskUpdates]() { slowTaskUpdates++; return true; }) != PLUS_SUCCESS
+      || scheduler.AddTask(&fastTaskId, "AcquisitionSchedulerTest", fastPeriodSec, [&fastTaskUpdates]() { fastTaskUpdates++; return true; }) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to add tasks");
+    return EXIT_FAILURE;
+  }
+  if (scheduler.AddTask(&slowTaskId, "AcquisitionSchedulerTest", slowPeriodSec, []() { return true; }) == PLUS_SUCCESS)
+  {
+    LOG_ERROR("Adding the same task twice was expected to fail");
+    numberOfErrors++;
+  }
+
+  vtkIGSIOAccurateTimer::Delay(testDurationSec);
+
+  AcquisitionScheduler::TaskStatistics slowTaskStatistics;
+  AcquisitionScheduler::TaskStatistics fastTaskStatistics;
+  if (scheduler.GetTaskStatistics(&slowTaskId, slowTaskStatistics) != PLUS_SUCCESS
+      || scheduler.GetTaskStatistics(&fastTaskId, fastTaskStatistics) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to get task statistics");
+    numberOfErrors++;
+  }
+  scheduler.RemoveTask(&slowTaskId);
+  scheduler.RemoveTask(&fastTaskId);
+
+  // Allow missed deadlines on a busy test machine, but most of the updates have to be run
+  int expectedSlowTaskUpdates = static_cast<int>(testDurationSec / slowPeriodSec);
+  int expectedFastTaskUpdates = static_cast<int>(testDurationSec / fastPeriodSec);
+  LOG_INFO("Slow task: " << slowTaskUpdates << " updates (expected: " << expectedSlowTaskUpdates << "), period error median: "
+           << slowTaskStatistics.PeriodErrorMedianSec * 1000 << " ms, 99th percentile: " << slowTaskStatistics.PeriodErrorPercentile99Sec * 1000 << " ms");
+  LOG_INFO("Fast task: " << fastTaskUpdates << " updates (expected: " << expectedFastTaskUpdates << "), period error median: "
+           << fastTaskStatistics.PeriodErrorMedianSec * 1000 << " ms, 99th percentile: " << fastTaskStatistics.PeriodErrorPercentile99Sec * 1000 << " ms");
+  if (slowTaskUpdates < expectedSlowTaskUpdates / 2 || slowTaskUpdates > expectedSlowTaskUpdates * 6 / 5 + 2
+      || fastTaskUpdates < expectedFastTaskUpdates / 2 || fastTaskUpdates > expectedFastTaskUpdates * 6 / 5 + 2)
+  {
+    LOG_ERROR("Unexpected number of updates");
+    numberOfErrors++;
+  }
+  if (slowTaskStatistics.PeriodErrorMedianSec > maxPeriodErrorSec || fastTaskStatistics.PeriodErrorMedianSec > maxPeriodErrorSec)
+  {
+    LOG_ERROR("Period error is larger than " << maxPeriodErrorSec << " sec");
+    numberOfErrors++;
+  }
+
+  // Removed tasks are not run anymore
+  int slowTaskUpdatesAfterRemove = slowTaskUpdates;
+  vtkIGSIOAccurateTimer::Delay(slowPeriodSec * 5);
+  if (slowTaskUpdates != slowTaskUpdatesAfterRemove || scheduler.GetTaskStatistics(&slowTaskId, slowTaskStatistics) == PLUS_SUCCESS)
+  {
+    LOG_ERROR("Task is still running after it has been removed");
+    numberOfErrors++;
+  }
+
+  // Task that stops itself by returning false and task that removes itself from the task function
+  std::atomic<int> returnFalseTaskUpdates(0);
+  std::atomic<int> removeSelfTaskUpdates(0);
+  int returnFalseTaskId = 0;
+  int removeSelfTaskId = 0;
+  scheduler.AddTask(&returnFalseTaskId, "AcquisitionSchedulerTest", fastPeriodSec, [&returnFalseTaskUpdates]() { return ++returnFalseTaskUpdates < 10; });
+  scheduler.AddTask(&removeSelfTaskId, "AcquisitionSchedulerTest", fastPeriodSec, [&removeSelfTaskUpdates, &removeSelfTaskId]()
+  {
+    if (++removeSelfTaskUpdates == 10)
+    {
+      AcquisitionScheduler::GetInstance().RemoveTask(&removeSelfTaskId);
+    }
+    return true;
+  });
+  vtkIGSIOAccurateTimer::Delay(fastPeriodSec * 40);
+  scheduler.RemoveTask(&returnFalseTaskId);
+  if (returnFalseTaskUpdates != 10 || removeSelfTaskUpdates != 10)
+  {
+    LOG_ERROR("Tasks were not stopped from the task function (updates: " << returnFalseTaskUpdates << ", " << removeSelfTaskUpdates << ")");
+    numberOfErrors++;
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("AcquisitionSchedulerTest failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("AcquisitionSchedulerTest completed successfully");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,200 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file DataflowSchedulerTest.cxx
+  \brief Verifies that the dataflow scheduler runs tasks when their trigger sources are notified.
+
+  A chain of three tasks is built (source -> first stage -> second stage -> sink), each stage notifies
+  the next one. The latency through the chain is checked, then it is verified that a task is never run
+  concurrently and that tasks are stopped by returning false and by RemoveTask.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusDataflowScheduler.h"
+
+#include <vtksys/CommandLineArguments.hxx>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int numberOfItems(100);
+  double maxLatencySec(0.010);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--number-of-items", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfItems, "Number of items sent through the chain (Default: 100).");
+  args.AddArgument("--max-latency-sec", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &maxLatencySec, "Maximum allowed median latency through the chain (Default: 0.010).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  DataflowScheduler& scheduler = DataflowScheduler::GetInstance();
+  int numberOfErrors = 0;
+
+  // Chain of tasks: each stage processes the latest item of its input and notifies the next stage
+  int sourceId = 0;
+  int firstStageId = 0;
+  int secondStageId = 0;
+  int sinkId = 0;
+  std::atomic<int> sourceItem(-1);
+  std::atomic<int> firstStageItem(-1);
+  std::atomic<int> secondStageItem(-1);
+  std::atomic<int> sinkItem(-1);
+  std::atomic<bool> firstStageRunning(false);
+  std::atomic<int> concurrentUpdates(0);
+  DataflowScheduler::TaskFunction firstStage = [&]()
+  {
+    if (firstStageRunning.exchange(true))
+    {
+      concurrentUpdates++;
+    }
+    if (sourceItem > firstStageItem)
+    {
+      firstStageItem = sourceItem.load();
+      DataflowScheduler::GetInstance().NotifyNewData(&firstStageId);
+    }
+    firstStageRunning = false;
+    return true;
+  };
+  DataflowScheduler::TaskFunction secondStage = [&]()
+  {
+    if (firstStageItem > secondStageItem)
+    {
+      secondStageItem = firstStageItem.load();
+      DataflowScheduler::GetInstance().NotifyNewData(&secondStageId);
+    }
+    return true;
+  };
+  DataflowScheduler::TaskFunction sink = [&]()
+  {
+    sinkItem = secondStageItem.load();
+    return true;
+  };
+  if (scheduler.AddTask(&firstStageId, std::vector<const void*>(1, &sourceId), firstStage) != PLUS_SUCCESS
+      || scheduler.AddTask(&secondStageId, std::vector<const void*>(1, &firstStageId), secondStage) != PLUS_SUCCESS
+      || scheduler.AddTask(&sinkId, std::vector<const void*>(1, &secondStageId), sink) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to add tasks");
+    return EXIT_FAILURE;
+  }
+
+  std::vector<double> latenciesSec;
+  for (int item = 0; item < numberOfItems; ++item)
+  {
+    double notificationTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    sourceItem = item;
+    scheduler.NotifyNewData(&sourceId);
+    while (sinkItem < item && vtkIGSIOAccurateTimer::GetSystemTime() - notificationTime < 1.0)
+    {
+      vtkIGSIOAccurateTimer::Delay(0.0001);
+    }
+    if (sinkItem < item)
+    {
+      LOG_ERROR("Item " << item << " did not arrive at the end of the chain");
+      numberOfErrors++;
+      break;
+    }
+    latenciesSec.push_back(vtkIGSIOAccurateTimer::GetSystemTime() - notificationTime);
+  }
+
+  if (!latenciesSec.empty())
+  {
+    std::vector<double>::iterator median = latenciesSec.begin() + latenciesSec.size() / 2;
+    std::nth_element(latenciesSec.begin(), median, latenciesSec.end());
+    LOG_INFO("Median latency through the chain: " << *median * 1000 << " ms");
+    if (*median > maxLatencySec)
+    {
+      LOG_ERROR("Latency through the chain is larger than " << maxLatencySec << " sec");
+      numberOfErrors++;
+    }
+  }
+
+  // Many notifications in a burst are merged, but the last item is always processed and a task is never run concurrently
+  for (int item = numberOfItems; item < numberOfItems * 2; ++item)
+  {
+    sourceItem = item;
+    scheduler.NotifyNewData(&sourceId);
+  }
+  double burstStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  while (sinkItem < numberOfItems * 2 - 1 && vtkIGSIOAccurateTimer::GetSystemTime() - burstStartTime < 1.0)
+  {
+    vtkIGSIOAccurateTimer::Delay(0.001);
+  }
+  DataflowScheduler::TaskStatistics firstStageStatistics;
+  scheduler.GetTaskStatistics(&firstStageId, firstStageStatistics);
+  LOG_INFO("First stage: " << firstStageStatistics.NumberOfUpdates << " updates for " << firstStageStatistics.NumberOfNotifications << " notifications");
+  if (sinkItem != numberOfItems * 2 - 1)
+  {
+    LOG_ERROR("Last item of the burst was not processed (processed: " << sinkItem << ")");
+    numberOfErrors++;
+  }
+  if (concurrentUpdates > 0)
+  {
+    LOG_ERROR("Task was run concurrently " << concurrentUpdates << " times");
+    numberOfErrors++;
+  }
+
+  // Removed tasks are not run anymore
+  scheduler.RemoveTask(&firstStageId);
+  int firstStageItemAfterRemove = firstStageItem;
+  sourceItem = numberOfItems * 2;
+  scheduler.NotifyNewData(&sourceId);
+  vtkIGSIOAccurateTimer::Delay(0.050);
+  if (firstStageItem != firstStageItemAfterRemove || scheduler.GetTaskStatistics(&firstStageId, firstStageStatistics) == PLUS_SUCCESS)
+  {
+    LOG_ERROR("Task is still running after it has been removed");
+    numberOfErrors++;
+  }
+  scheduler.RemoveTask(&secondStageId);
+  scheduler.RemoveTask(&sinkId);
+
+  // Task that stops itself by returning false
+  std::atomic<int> returnFalseTaskUpdates(0);
+  int returnFalseTaskId = 0;
+  scheduler.AddTask(&returnFalseTaskId, std::vector<const void*>(1, &sourceId), [&returnFalseTaskUpdates]() { return ++returnFalseTaskUpdates < 10; });
+  for (int i = 0; i < 20; ++i)
+  {
+    scheduler.NotifyNewData(&sourceId);
+    vtkIGSIOAccurateTimer::Delay(0.005);
+  }
+  scheduler.RemoveTask(&returnFalseTaskId);
+  if (returnFalseTaskUpdates != 10)
+  {
+    LOG_ERROR("Task was not stopped from the task function (updates: " << returnFalseTaskUpdates << ")");
+    numberOfErrors++;
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("DataflowSchedulerTest failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("DataflowSchedulerTest completed successfully");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,150 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file HardwareClockTest.cxx
+  \brief Tests the conversion of hardware timestamps to system time by HardwareClock.
+
+  A device clock with a different unit, offset and drift is simulated, and the items arrive with an exponentially
+  distributed transfer delay. The converted timestamps must be increasing and must be within a fraction of the
+  transfer jitter of the true acquisition times. Then the conversion of synchronized UTC timestamps is checked.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusHardwareClock.h"
+
+#include <vtkIGSIOAccurateTimer.h>
+#include <vtkSmartPointer.h>
+#include <vtkXMLDataElement.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp = false;
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+  double maximumErrorSec = 0.001;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+  args.AddArgument("--maximum-error-sec", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &maximumErrorSec, "Maximum allowed error of the converted timestamps (default: 0.001)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors = 0;
+
+  // 60 fps device, its clock counts in units of 1/3 s with 100 ppm drift, 2 ms minimum and 3 ms mean additional transfer delay
+  const double frameRate = 60.0;
+  const double deviceClockScale = 3.0 * 1.0001;
+  const double minimumDelaySec = 0.002;
+  std::mt19937 randomGenerator(1);
+  std::exponential_distribution<double> delayDistribution(1.0 / 0.003);
+
+  HardwareClock deviceClock;
+  deviceClock.SetClockType(HardwareClock::CLOCK_DEVICE);
+  double lastTimestamp = -1e10;
+  double maximumError = 0;
+  const int numberOfFrames = 20000;
+  const int numberOfSettlingFrames = 600;
+  for (int frameIndex = 0; frameIndex < numberOfFrames; ++frameIndex)
+  {
+    double acquisitionTime = 1000.0 + frameIndex / frameRate;
+    double hardwareTimestamp = 5.0 + frameIndex / frameRate * deviceClockScale;
+    double arrivalTime = acquisitionTime + minimumDelaySec + delayDistribution(randomGenerator);
+    double timestamp = deviceClock.GetSystemTime(hardwareTimestamp, arrivalTime);
+    if (timestamp <= lastTimestamp)
+    {
+      LOG_ERROR("Converted timestamps are not increasing at frame " << frameIndex << ": " << std::fixed << lastTimestamp << " -> " << timestamp);
+      numberOfErrors++;
+    }
+    lastTimestamp = timestamp;
+    if (frameIndex >= numberOfSettlingFrames)
+    {
+      // the minimum transfer delay is a constant offset, which is determined by temporal calibration
+      maximumError = std::max(maximumError, std::fabs(timestamp - (acquisitionTime + minimumDelaySec)));
+    }
+  }
+  LOG_INFO("Device clock: maximum error = " << maximumError * 1000.0 << " ms, estimated rate = " << deviceClock.GetEstimatedRate());
+  if (maximumError > maximumErrorSec)
+  {
+    LOG_ERROR("Device clock conversion error is " << maximumError * 1000.0 << " ms, maximum allowed is " << maximumErrorSec * 1000.0 << " ms");
+    numberOfErrors++;
+  }
+  if (std::fabs(deviceClock.GetEstimatedRate() * deviceClockScale - 1.0) > 1e-5)
+  {
+    LOG_ERROR("Estimated device clock rate is " << deviceClock.GetEstimatedRate() << ", expected " << 1.0 / deviceClockScale);
+    numberOfErrors++;
+  }
+
+  // items of the same hardware sample get the same timestamp
+  double sameSampleTimestamp = deviceClock.GetSystemTime(5.0 + numberOfFrames / frameRate * deviceClockScale, lastTimestamp + 0.02);
+  if (deviceClock.GetSystemTime(5.0 + numberOfFrames / frameRate * deviceClockScale, lastTimestamp + 0.021) != sameSampleTimestamp)
+  {
+    LOG_ERROR("Items of the same hardware sample got different timestamps");
+    numberOfErrors++;
+  }
+
+  HardwareClock utcClock;
+  utcClock.SetClockType(HardwareClock::CLOCK_UTC);
+  double arrivalTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  double acquisitionTimeUtc = arrivalTime - 0.01 + HardwareClock::GetUtcToSystemTimeOffsetSec();
+  double utcError = utcClock.GetSystemTime(acquisitionTimeUtc, arrivalTime) - (arrivalTime - 0.01);
+  LOG_INFO("UTC clock: error = " << utcError * 1000.0 << " ms");
+  if (std::fabs(utcError) > maximumErrorSec)
+  {
+    LOG_ERROR("UTC clock conversion error is " << utcError * 1000.0 << " ms, maximum allowed is " << maximumErrorSec * 1000.0 << " ms");
+    numberOfErrors++;
+  }
+
+  vtkSmartPointer<vtkXMLDataElement> deviceElement = vtkSmartPointer<vtkXMLDataElement>::New();
+  deviceElement->SetName("Device");
+  deviceElement->SetAttribute("HardwareClock", "Ptp");
+  deviceElement->SetAttribute("HardwareClockPtpUtcOffsetSec", "36");
+  HardwareClock ptpClock;
+  if (ptpClock.ReadConfiguration(deviceElement) != PLUS_SUCCESS
+      || ptpClock.GetClockType() != HardwareClock::CLOCK_PTP || ptpClock.GetPtpUtcOffsetSec() != 36.0)
+  {
+    LOG_ERROR("Hardware clock configuration is not read correctly");
+    numberOfErrors++;
+  }
+  vtkSmartPointer<vtkXMLDataElement> writtenElement = vtkSmartPointer<vtkXMLDataElement>::New();
+  writtenElement->SetName("Device");
+  ptpClock.WriteConfiguration(writtenElement);
+  HardwareClock readBackClock;
+  if (readBackClock.ReadConfiguration(writtenElement) != PLUS_SUCCESS
+      || readBackClock.GetClockType() != HardwareClock::CLOCK_PTP || readBackClock.GetPtpUtcOffsetSec() != 36.0)
+  {
+    LOG_ERROR("Hardware clock configuration is changed by writing and reading it");
+    numberOfErrors++;
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
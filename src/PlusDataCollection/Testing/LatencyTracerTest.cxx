@@ -0,0 +1,185 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file LatencyTracerTest.cxx
+  \brief Verifies the latency histograms and the trace output of LatencyTracer.
+
+  Trace points of frames are recorded with known delays between the stages, then the histograms of the channel
+  and the client are checked and the trace is saved in Chrome trace format.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusLatencyTracer.h"
+
+#include <vtksys/CommandLineArguments.hxx>
+
+#include <fstream>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  int CheckHistogram(const LatencyTracer::Histogram& histogram, unsigned long expectedNumberOfSamples, double minimumSec, double maximumSec)
+  {
+    if (histogram.GetNumberOfSamples() != expectedNumberOfSamples)
+    {
+      LOG_ERROR("Number of samples is " << histogram.GetNumberOfSamples() << ", expected " << expectedNumberOfSamples);
+      return 1;
+    }
+    if (histogram.GetMinimumSec() < minimumSec || histogram.GetMaximumSec() > maximumSec)
+    {
+      LOG_ERROR("Latency range " << histogram.GetMinimumSec() << "-" << histogram.GetMaximumSec() << "sec is out of the expected range " << minimumSec << "-" << maximumSec << "sec");
+      return 1;
+    }
+    return 0;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  std::string outputFilename("LatencyTracerTest.json");
+  int numberOfFrames(20);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--output-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &outputFilename, "Name of the Chrome trace output file (Default: LatencyTracerTest.json).");
+  args.AddArgument("--number-of-frames", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfFrames, "Number of traced frames (Default: 20).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors = 0;
+
+  // Histogram bins and percentiles
+  LatencyTracer::Histogram histogram;
+  for (int i = 0; i < 90; ++i)
+  {
+    histogram.AddSample(0.0003);
+  }
+  for (int i = 0; i < 10; ++i)
+  {
+    histogram.AddSample(0.003);
+  }
+  histogram.AddSample(5.0);
+  if (histogram.GetBinCount(1) != 90 || histogram.GetBinCount(4) != 10 || histogram.GetBinCount(LatencyTracer::Histogram::NUMBER_OF_BINS - 1) != 1)
+  {
+    LOG_ERROR("Samples are added to wrong bins");
+    numberOfErrors++;
+  }
+  if (histogram.GetPercentileSec(50) != LatencyTracer::Histogram::GetBinUpperLimitSec(1)
+      || histogram.GetPercentileSec(95) != LatencyTracer::Histogram::GetBinUpperLimitSec(4)
+      || histogram.GetPercentileSec(100) != 5.0)
+  {
+    LOG_ERROR("Wrong percentiles: " << histogram.GetPercentileSec(50) << ", " << histogram.GetPercentileSec(95) << ", " << histogram.GetPercentileSec(100));
+    numberOfErrors++;
+  }
+
+  // Trace points are ignored while tracing is disabled
+  LatencyTracer& tracer = LatencyTracer::GetInstance();
+  tracer.Reset();
+  if (LatencyTracer::IsEnabled())
+  {
+    LOG_ERROR("Latency tracing is enabled by default");
+    numberOfErrors++;
+  }
+
+  tracer.SetEnabled(true);
+  const double stageDelaySec = 0.002;
+  int sourceId = 0; // only the address is used
+  for (int i = 0; i < numberOfFrames; ++i)
+  {
+    BufferItemUidType uid = i + 1;
+    double frameTimestamp = 100.0 + i * 0.1;
+    tracer.RecordItemAdded(&sourceId, uid);
+    vtkIGSIOAccurateTimer::Delay(stageDelaySec);
+    tracer.RecordFrameAssembled("TrackedVideoStream", &sourceId, uid, frameTimestamp);
+    // Another consumer requests the same frame
+    tracer.RecordFrameAssembled("TrackedVideoStream", &sourceId, uid, frameTimestamp);
+    double packStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    double packedTime = packStartTime + stageDelaySec;
+    double sentTime = packedTime + stageDelaySec;
+    tracer.RecordFrameSent("TrackedVideoStream", 1, frameTimestamp, packStartTime, packedTime, sentTime);
+  }
+  // Items that were not recorded as acquired are ignored
+  tracer.RecordFrameAssembled("TrackedVideoStream", &sourceId, numberOfFrames + 1, 1000.0);
+  tracer.RecordFrameSent("TrackedVideoStream", 1, 1000.0, 0, 0, 0);
+  tracer.RecordFrameSent("UnknownChannel", 1, 100.0, 0, 0, 0);
+  tracer.SetEnabled(false);
+
+  LatencyTracer::Histogram channelHistogram;
+  if (tracer.GetChannelHistogram("TrackedVideoStream", channelHistogram) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Channel histogram is not found");
+    numberOfErrors++;
+  }
+  numberOfErrors += CheckHistogram(channelHistogram, numberOfFrames, stageDelaySec * 0.9, 1.0);
+
+  LatencyTracer::ClientHistograms clientHistograms;
+  if (tracer.GetClientHistograms(1, clientHistograms) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Client histograms are not found");
+    numberOfErrors++;
+  }
+  numberOfErrors += CheckHistogram(clientHistograms.Pack, numberOfFrames, stageDelaySec * 0.99, stageDelaySec * 1.01);
+  numberOfErrors += CheckHistogram(clientHistograms.Send, numberOfFrames, stageDelaySec * 0.99, stageDelaySec * 1.01);
+  numberOfErrors += CheckHistogram(clientHistograms.Total, numberOfFrames, stageDelaySec * 2.9, 1.0);
+  if (tracer.GetClientHistograms(2, clientHistograms) != PLUS_FAIL)
+  {
+    LOG_ERROR("Histograms are returned for a client that did not receive frames");
+    numberOfErrors++;
+  }
+  LOG_INFO(tracer.GetStatisticsAsText());
+
+  if (tracer.WriteChromeTrace(outputFilename) != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+  else
+  {
+    std::ifstream traceFile(outputFilename.c_str());
+    std::string trace((std::istreambuf_iterator<char>(traceFile)), std::istreambuf_iterator<char>());
+    if (trace.find("\"traceEvents\"") == std::string::npos || trace.find("\"name\":\"Assembly\"") == std::string::npos
+        || trace.find("\"name\":\"Send\"") == std::string::npos || trace.find("Channel TrackedVideoStream") == std::string::npos)
+    {
+      LOG_ERROR("Trace file content is invalid: " << outputFilename);
+      numberOfErrors++;
+    }
+  }
+
+  tracer.Reset();
+  if (tracer.GetChannelHistogram("TrackedVideoStream", channelHistogram) != PLUS_FAIL)
+  {
+    LOG_ERROR("Histograms are not cleared by Reset");
+    numberOfErrors++;
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("LatencyTracerTest failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("LatencyTracerTest completed successfully");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,159 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file MemoryAccountingTest.cxx
+  \brief Verifies the memory usage reports, their metrics and the soft limit of MemoryAccounting.
+
+  A buffer of frames is reported by a test reporter, the usage is checked in the accounting and in the metrics,
+  then the soft limit is set below and above the usage and the pressure handler is checked to be called only when the limit is exceeded.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusMemoryAccounting.h"
+#include "vtkPlusBuffer.h"
+
+#include <vtkSmartPointer.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+#include <atomic>
+#include <sstream>
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors = 0;
+  MemoryAccounting& accounting = MemoryAccounting::GetInstance();
+
+  // Buffer of 10 frames of 100x100 pixels, 8 bits
+  vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+  buffer->SetBufferSize(10);
+  buffer->SetPixelType(VTK_UNSIGNED_CHAR);
+  buffer->SetNumberOfScalarComponents(1);
+  buffer->SetFrameSize(100, 100, 1);
+  const size_t framesBytes = 10 * 100 * 100;
+  size_t bufferBytes = buffer->GetMemoryUsageBytes();
+  if (bufferBytes < framesBytes || bufferBytes > 2 * framesBytes)
+  {
+    LOG_ERROR("Buffer memory usage is " << bufferBytes << " bytes, expected at least " << framesBytes << " bytes of frames");
+    numberOfErrors++;
+  }
+
+  std::atomic<int> numberOfPressureCalls(0);
+  std::atomic<size_t> lastBytesToRelease(0);
+  int reporterId = accounting.AddReporter([buffer](std::vector<MemoryAccounting::Usage>& usages)
+  {
+    MetricsRegistry::Labels labels;
+    labels["device"] = "TestDevice";
+    labels["source"] = "Video";
+    usages.push_back(MemoryAccounting::Usage("buffer", labels, buffer->GetMemoryUsageBytes()));
+  }, [&numberOfPressureCalls, &lastBytesToRelease](size_t bytesToRelease)
+  {
+    numberOfPressureCalls++;
+    lastBytesToRelease = bytesToRelease;
+  });
+
+  if (accounting.GetTotalBytes() < bufferBytes)
+  {
+    LOG_ERROR("Total memory usage " << accounting.GetTotalBytes() << " bytes does not include the buffer of " << bufferBytes << " bytes");
+    numberOfErrors++;
+  }
+
+  std::ostringstream expectedUsage;
+  expectedUsage << "plus_memory_bytes{component=\"buffer\",device=\"TestDevice\",source=\"Video\"} " << bufferBytes << "\n";
+  std::string text = MetricsRegistry::GetInstance().GetMetricsAsPrometheusText();
+  LOG_DEBUG("Metrics:\n" << text);
+  const std::string expectedMetrics[] = { expectedUsage.str(), "# TYPE plus_memory_total_bytes gauge\n", "plus_memory_soft_limit_bytes 0\n" };
+  for (size_t i = 0; i < sizeof(expectedMetrics) / sizeof(expectedMetrics[0]); i++)
+  {
+    if (text.find(expectedMetrics[i]) == std::string::npos)
+    {
+      LOG_ERROR("Metrics do not contain: " << expectedMetrics[i]);
+      numberOfErrors++;
+    }
+  }
+
+  // Limit above the usage: the handler is not called
+  accounting.SetSoftLimitBytes(100 * bufferBytes);
+  accounting.CheckSoftLimit();
+  if (accounting.IsSoftLimitExceeded() || numberOfPressureCalls > 0)
+  {
+    LOG_ERROR("Soft limit is reported as exceeded below the limit");
+    numberOfErrors++;
+  }
+
+  // Limit below the usage: the handler is called with the excess
+  accounting.SetSoftLimitBytes(bufferBytes / 2);
+  accounting.CheckSoftLimit();
+  if (!accounting.IsSoftLimitExceeded() || numberOfPressureCalls == 0 || lastBytesToRelease < bufferBytes - bufferBytes / 2)
+  {
+    LOG_ERROR("Soft limit is not reported as exceeded above the limit (pressure handler calls: " << numberOfPressureCalls
+              << ", bytes to release: " << lastBytesToRelease << ")");
+    numberOfErrors++;
+  }
+  if (MetricsRegistry::GetInstance().GetMetricsAsPrometheusText().find("plus_memory_soft_limit_exceeded 1\n") == std::string::npos)
+  {
+    LOG_ERROR("Metrics do not report the exceeded soft limit");
+    numberOfErrors++;
+  }
+
+  // Shrinking the buffer makes the usage go below the limit again
+  buffer->SetBufferSize(2);
+  accounting.CheckSoftLimit();
+  if (accounting.IsSoftLimitExceeded())
+  {
+    LOG_ERROR("Soft limit is reported as exceeded after the buffer is shrunk to " << buffer->GetMemoryUsageBytes() << " bytes");
+    numberOfErrors++;
+  }
+
+  // Removing the limit stops the monitoring, removed reporters are not listed
+  accounting.SetSoftLimitBytes(0);
+  accounting.RemoveReporter(reporterId);
+  text = MetricsRegistry::GetInstance().GetMetricsAsPrometheusText();
+  if (text.find("TestDevice") != std::string::npos)
+  {
+    LOG_ERROR("Metrics contain the usage of a removed reporter");
+    numberOfErrors++;
+  }
+  if (text.find("plus_memory_soft_limit_exceeded 0\n") == std::string::npos)
+  {
+    LOG_ERROR("Metrics report the soft limit as exceeded after it is removed");
+    numberOfErrors++;
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("MemoryAccountingTest failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("MemoryAccountingTest completed successfully");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,175 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file MetricsRegistryTest.cxx
+  \brief Verifies the metrics of MetricsRegistry and their Prometheus text output.
+
+  Counters are incremented concurrently from multiple threads, then the values of registered and collected metrics
+  are checked in the Prometheus text output, and removed metrics and collectors are checked not to be listed anymore.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusMetricsRegistry.h"
+
+#include <vtksys/CommandLineArguments.hxx>
+
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  int CheckContains(const std::string& text, const std::string& expected)
+  {
+    if (text.find(expected) == std::string::npos)
+    {
+      LOG_ERROR("Metrics do not contain: " << expected);
+      return 1;
+    }
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  int CheckNotContains(const std::string& text, const std::string& unexpected)
+  {
+    if (text.find(unexpected) != std::string::npos)
+    {
+      LOG_ERROR("Metrics contain: " << unexpected);
+      return 1;
+    }
+    return 0;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int numberOfThreads(4);
+  int numberOfIncrements(100000);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--number-of-threads", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfThreads, "Number of threads that update the counters concurrently (Default: 4).");
+  args.AddArgument("--number-of-increments", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfIncrements, "Number of increments per thread (Default: 100000).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors = 0;
+  MetricsRegistry& registry = MetricsRegistry::GetInstance();
+
+  // Concurrent updates
+  MetricsRegistry::Labels labels;
+  labels["client"] = "1";
+  std::shared_ptr<MetricsRegistry::Metric> counter = registry.GetMetric("test_items_total", "Number of test items", MetricsRegistry::METRIC_COUNTER, labels);
+  std::shared_ptr<MetricsRegistry::Metric> latency = registry.GetMetric("test_latency_seconds", "Test latency", MetricsRegistry::METRIC_SUMMARY, labels);
+  std::vector<std::thread> threads;
+  for (int threadIndex = 0; threadIndex < numberOfThreads; ++threadIndex)
+  {
+    threads.push_back(std::thread([counter, latency, numberOfIncrements]()
+    {
+      for (int i = 0; i < numberOfIncrements; ++i)
+      {
+        counter->Increment();
+        latency->AddSample(0.5);
+      }
+    }));
+  }
+  for (std::vector<std::thread>::iterator threadIt = threads.begin(); threadIt != threads.end(); ++threadIt)
+  {
+    threadIt->join();
+  }
+  const double expectedCount = static_cast<double>(numberOfThreads) * numberOfIncrements;
+  if (counter->GetValue() != expectedCount || latency->GetCount() != static_cast<unsigned long long>(expectedCount) || latency->GetValue() != expectedCount * 0.5)
+  {
+    LOG_ERROR("Concurrent updates are lost: counter=" << counter->GetValue() << ", summary count=" << latency->GetCount()
+              << ", summary sum=" << latency->GetValue() << ", expected count=" << expectedCount);
+    numberOfErrors++;
+  }
+
+  // The same metric is returned for the same name and labels
+  if (registry.GetMetric("test_items_total", "", MetricsRegistry::METRIC_COUNTER, labels) != counter)
+  {
+    LOG_ERROR("A new metric is created for an existing name and labels");
+    numberOfErrors++;
+  }
+
+  std::shared_ptr<MetricsRegistry::Metric> gauge = registry.GetMetric("test_queue_length", "Test queue length", MetricsRegistry::METRIC_GAUGE);
+  gauge->Set(3);
+
+  // Collected metrics
+  int collectorId = registry.AddCollector([](std::vector<MetricsRegistry::Sample>& samples)
+  {
+    MetricsRegistry::Labels sourceLabels;
+    sourceLabels["source"] = "Video \"1\"";
+    samples.push_back(MetricsRegistry::Sample("test_buffer_items", "Test buffer items", MetricsRegistry::METRIC_GAUGE, sourceLabels, 25));
+  });
+
+  std::string text = registry.GetMetricsAsPrometheusText();
+  LOG_DEBUG("Metrics:\n" << text);
+  std::ostringstream expectedCounter;
+  expectedCounter << std::setprecision(15) << "test_items_total{client=\"1\"} " << expectedCount << "\n";
+  std::ostringstream expectedSummaryCount;
+  expectedSummaryCount << std::setprecision(15) << "test_latency_seconds_count{client=\"1\"} " << expectedCount << "\n";
+  numberOfErrors += CheckContains(text, "# HELP test_items_total Number of test items\n# TYPE test_items_total counter\n");
+  numberOfErrors += CheckContains(text, expectedCounter.str());
+  numberOfErrors += CheckContains(text, "# TYPE test_latency_seconds summary\n");
+  numberOfErrors += CheckContains(text, expectedSummaryCount.str());
+  numberOfErrors += CheckContains(text, "test_queue_length 3\n");
+  numberOfErrors += CheckContains(text, "test_buffer_items{source=\"Video \\\"1\\\"\"} 25\n");
+
+  // Removed metrics and collectors are not listed
+  registry.RemoveMetrics("client", "1");
+  registry.RemoveCollector(collectorId);
+  text = registry.GetMetricsAsPrometheusText();
+  numberOfErrors += CheckNotContains(text, "test_items_total");
+  numberOfErrors += CheckNotContains(text, "test_latency_seconds");
+  numberOfErrors += CheckNotContains(text, "test_buffer_items");
+  numberOfErrors += CheckContains(text, "test_queue_length 3\n");
+
+  // Thread CPU time increases while the thread is busy
+  double cpuTimeStartSec = MetricsRegistry::GetCurrentThreadCpuTimeSec();
+  volatile double sum = 0;
+  for (int i = 0; i < 10000000; ++i)
+  {
+    sum = sum + i;
+  }
+  double cpuTimeEndSec = MetricsRegistry::GetCurrentThreadCpuTimeSec();
+  if (cpuTimeStartSec < 0 || cpuTimeEndSec <= cpuTimeStartSec)
+  {
+    LOG_ERROR("Thread CPU time is invalid: " << cpuTimeStartSec << " sec before and " << cpuTimeEndSec << " sec after a busy loop");
+    numberOfErrors++;
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("MetricsRegistryTest failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("MetricsRegistryTest completed successfully");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,200 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file OverloadManagerTest.cxx
+  \brief Verifies that OverloadManager applies the degradation policies in the configured order and reverts them after recovery.
+
+  A queue depth gauge and a processed items counter are used as indicators. The evaluation times are simulated,
+  so the escalation and recovery delays can be checked without waiting.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusOverloadManager.h"
+
+#include <vtkSmartPointer.h>
+#include <vtkXMLDataElement.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+#include <map>
+#include <string>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  int CheckState(OverloadManager& manager, const std::map<std::string, bool>& handlerStates, int expectedLevel, bool expectedFirstApplied,
+                 bool expectedSecondApplied, const std::string& description)
+  {
+    int numberOfErrors = 0;
+    if (manager.GetDegradationLevel() != expectedLevel)
+    {
+      LOG_ERROR(description << ": degradation level is " << manager.GetDegradationLevel() << ", expected " << expectedLevel);
+      numberOfErrors++;
+    }
+    if (handlerStates.at("First") != expectedFirstApplied || handlerStates.at("Second") != expectedSecondApplied)
+    {
+      LOG_ERROR(description << ": policy handler states are " << handlerStates.at("First") << ", " << handlerStates.at("Second")
+                << ", expected " << expectedFirstApplied << ", " << expectedSecondApplied);
+      numberOfErrors++;
+    }
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors = 0;
+  OverloadManager& manager = OverloadManager::GetInstance();
+
+  MetricsRegistry::Labels queueLabels;
+  queueLabels["queue"] = "Test";
+  std::shared_ptr<MetricsRegistry::Metric> queueDepth = MetricsRegistry::GetInstance().GetMetric("plus_test_queue_depth", "Test queue depth",
+      MetricsRegistry::METRIC_GAUGE, queueLabels);
+  std::shared_ptr<MetricsRegistry::Metric> processedItems = MetricsRegistry::GetInstance().GetMetric("plus_test_processed_items_total", "Test processed items",
+      MetricsRegistry::METRIC_COUNTER);
+
+  vtkSmartPointer<vtkXMLDataElement> overloadManagerElement = vtkSmartPointer<vtkXMLDataElement>::New();
+  overloadManagerElement->SetName("OverloadManager");
+  overloadManagerElement->SetAttribute("EscalationDelaySec", "1.0");
+  overloadManagerElement->SetAttribute("RecoveryDelaySec", "2.0");
+  vtkSmartPointer<vtkXMLDataElement> queueIndicator = vtkSmartPointer<vtkXMLDataElement>::New();
+  queueIndicator->SetName("Indicator");
+  queueIndicator->SetAttribute("Metric", "plus_test_queue_depth");
+  queueIndicator->SetAttribute("Labels", "queue=Test");
+  queueIndicator->SetAttribute("OverloadThreshold", "10");
+  queueIndicator->SetAttribute("RecoveryThreshold", "5");
+  overloadManagerElement->AddNestedElement(queueIndicator);
+  vtkSmartPointer<vtkXMLDataElement> rateIndicator = vtkSmartPointer<vtkXMLDataElement>::New();
+  rateIndicator->SetName("Indicator");
+  rateIndicator->SetAttribute("Metric", "plus_test_processed_items_total");
+  rateIndicator->SetAttribute("Rate", "TRUE");
+  rateIndicator->SetAttribute("OverloadThreshold", "100");
+  overloadManagerElement->AddNestedElement(rateIndicator);
+  const char* policyNames[] = { "First", "Second" };
+  for (int policyIndex = 0; policyIndex < 2; ++policyIndex)
+  {
+    vtkSmartPointer<vtkXMLDataElement> policyElement = vtkSmartPointer<vtkXMLDataElement>::New();
+    policyElement->SetName("Policy");
+    policyElement->SetAttribute("Name", policyNames[policyIndex]);
+    overloadManagerElement->AddNestedElement(policyElement);
+  }
+  if (manager.ReadConfiguration(overloadManagerElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to read overload manager configuration");
+    return EXIT_FAILURE;
+  }
+
+  std::map<std::string, bool> handlerStates;
+  handlerStates["First"] = false;
+  handlerStates["Second"] = false;
+  int firstHandlerId = manager.AddPolicyHandler("First", [&handlerStates](bool apply) { handlerStates["First"] = apply; });
+
+  // Overloaded: the policies are applied one by one, with the escalation delay between them
+  queueDepth->Set(20);
+  manager.Evaluate(100.0);
+  numberOfErrors += CheckState(manager, handlerStates, 1, true, false, "First overloaded evaluation");
+  manager.Evaluate(100.5);
+  numberOfErrors += CheckState(manager, handlerStates, 1, true, false, "Overloaded within the escalation delay");
+
+  // A handler of an applied policy is called when it is added
+  int secondHandlerId = manager.AddPolicyHandler("Second", [&handlerStates](bool apply) { handlerStates["Second"] = apply; });
+  manager.Evaluate(101.0);
+  numberOfErrors += CheckState(manager, handlerStates, 2, true, true, "Overloaded after the escalation delay");
+  manager.Evaluate(103.0);
+  numberOfErrors += CheckState(manager, handlerStates, 2, true, true, "Overloaded with all policies applied");
+
+  // Between the recovery and overload thresholds nothing changes
+  queueDepth->Set(7);
+  manager.Evaluate(110.0);
+  numberOfErrors += CheckState(manager, handlerStates, 2, true, true, "Between the thresholds");
+
+  // Recovered: the policies are reverted in reverse order after the recovery delay
+  queueDepth->Set(1);
+  manager.Evaluate(111.0);
+  numberOfErrors += CheckState(manager, handlerStates, 2, true, true, "Recovered within the recovery delay");
+  manager.Evaluate(113.0);
+  numberOfErrors += CheckState(manager, handlerStates, 1, true, false, "Recovered after the recovery delay");
+  manager.Evaluate(114.0);
+  numberOfErrors += CheckState(manager, handlerStates, 1, true, false, "Recovered within the recovery delay after a revert");
+  manager.Evaluate(115.0);
+  numberOfErrors += CheckState(manager, handlerStates, 0, false, false, "Recovered");
+
+  // Rate of a counter: 50 items per second is below the threshold, 500 items per second is above
+  processedItems->Increment(50);
+  manager.Evaluate(116.0);
+  numberOfErrors += CheckState(manager, handlerStates, 0, false, false, "Processing rate below the threshold");
+  processedItems->Increment(500);
+  manager.Evaluate(117.0);
+  numberOfErrors += CheckState(manager, handlerStates, 1, true, false, "Processing rate above the threshold");
+
+  std::string text = MetricsRegistry::GetInstance().GetMetricsAsPrometheusText();
+  LOG_DEBUG("Metrics:\n" << text);
+  if (text.find("plus_overload_degradation_level 1\n") == std::string::npos || text.find("plus_overload_policy_applied{policy=\"First\"} 1\n") == std::string::npos)
+  {
+    LOG_ERROR("Overload metrics do not contain the applied policy");
+    numberOfErrors++;
+  }
+
+  // Writing and reading back the configuration keeps the indicators and policies
+  vtkSmartPointer<vtkXMLDataElement> writtenElement = vtkSmartPointer<vtkXMLDataElement>::New();
+  writtenElement->SetName("OverloadManager");
+  manager.WriteConfiguration(writtenElement);
+  if (manager.ReadConfiguration(writtenElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to read the written overload manager configuration");
+    numberOfErrors++;
+  }
+  std::vector<OverloadManager::Indicator> indicators;
+  manager.GetIndicators(indicators);
+  std::vector<std::string> policies;
+  manager.GetPolicies(policies);
+  if (indicators.size() != 2 || indicators[0].MetricLabels != queueLabels || indicators[0].RecoveryThreshold != 5 || !indicators[1].Rate
+      || indicators[1].RecoveryThreshold != 50 || policies.size() != 2 || policies[1] != "Second")
+  {
+    LOG_ERROR("Overload manager configuration is changed by writing and reading it");
+    numberOfErrors++;
+  }
+
+  // Setting the policies reverts the applied ones
+  numberOfErrors += CheckState(manager, handlerStates, 0, false, false, "Configuration read again");
+
+  manager.RemovePolicyHandler(firstHandlerId);
+  manager.RemovePolicyHandler(secondHandlerId);
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("OverloadManagerTest failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("OverloadManagerTest completed successfully");
+  return EXIT_SUCCESS;
+}
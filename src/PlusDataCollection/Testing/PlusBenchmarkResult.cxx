@@ -0,0 +1,218 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusBenchmarkResult.h"
+
+#include <vtkSmartPointer.h>
+#include <vtkXMLDataElement.h>
+#include <vtkXMLUtilities.h>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <numeric>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  double GetPercentile(const std::vector<double>& sortedValues, double percent)
+  {
+    size_t index = static_cast<size_t>(std::ceil(sortedValues.size() * percent / 100.0));
+    index = std::min(std::max<size_t>(index, 1), sortedValues.size()) - 1;
+    return sortedValues[index];
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusBenchmarkStage::PlusBenchmarkStage()
+  : NumberOfItems(0)
+  , ItemsPerSec(0)
+  , LatencyMeanSec(-1)
+  , LatencyP50Sec(-1)
+  , LatencyP95Sec(-1)
+  , LatencyP99Sec(-1)
+  , LatencyMaxSec(-1)
+{
+}
+
+//----------------------------------------------------------------------------
+void PlusBenchmarkStage::SetLatencies(std::vector<double> latencySamplesSec)
+{
+  if (latencySamplesSec.empty())
+  {
+    this->LatencyMeanSec = this->LatencyP50Sec = this->LatencyP95Sec = this->LatencyP99Sec = this->LatencyMaxSec = -1;
+    return;
+  }
+  std::sort(latencySamplesSec.begin(), latencySamplesSec.end());
+  this->LatencyMeanSec = std::accumulate(latencySamplesSec.begin(), latencySamplesSec.end(), 0.0) / latencySamplesSec.size();
+  this->LatencyP50Sec = GetPercentile(latencySamplesSec, 50);
+  this->LatencyP95Sec = GetPercentile(latencySamplesSec, 95);
+  this->LatencyP99Sec = GetPercentile(latencySamplesSec, 99);
+  this->LatencyMaxSec = latencySamplesSec.back();
+}
+
+//----------------------------------------------------------------------------
+PlusLatencySamples::PlusLatencySamples(size_t maximumNumberOfSamples)
+  : MaximumNumberOfSamples(maximumNumberOfSamples)
+  , NumberOfSamples(0)
+  , Random(1)
+{
+}
+
+//----------------------------------------------------------------------------
+void PlusLatencySamples::AddSample(double latencySec)
+{
+  this->NumberOfSamples++;
+  if (this->KeptSamplesSec.size() < this->MaximumNumberOfSamples)
+  {
+    this->KeptSamplesSec.push_back(latencySec);
+    return;
+  }
+  unsigned long long sampleIndex = this->Random() % this->NumberOfSamples;
+  if (sampleIndex < this->MaximumNumberOfSamples)
+  {
+    this->KeptSamplesSec[sampleIndex] = latencySec;
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusBenchmarkTolerances::PlusBenchmarkTolerances()
+  : Throughput(0.5)
+  , Latency(2.0)
+  , LatencyAbsoluteSec(0)
+  , Memory(-1)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusBenchmarkResult::PlusBenchmarkResult(const std::string& name)
+  : Name(name)
+  , DurationSec(-1)
+  , PeakMemoryMB(-1)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusBenchmarkResult::WriteToFile(const std::string& fileName) const
+{
+  vtkSmartPointer<vtkXMLDataElement> resultElement = vtkSmartPointer<vtkXMLDataElement>::New();
+  resultElement->SetName(this->Name.c_str());
+  if (!this->Mode.empty())
+  {
+    resultElement->SetAttribute("Mode", this->Mode.c_str());
+  }
+  if (this->DurationSec >= 0)
+  {
+    resultElement->SetDoubleAttribute("DurationSec", this->DurationSec);
+  }
+  if (this->PeakMemoryMB >= 0)
+  {
+    resultElement->SetDoubleAttribute("PeakMemoryMB", this->PeakMemoryMB);
+  }
+  for (std::vector<PlusBenchmarkStage>::const_iterator it = this->Stages.begin(); it != this->Stages.end(); ++it)
+  {
+    vtkSmartPointer<vtkXMLDataElement> stageElement = vtkSmartPointer<vtkXMLDataElement>::New();
+    stageElement->SetName("Stage");
+    stageElement->SetAttribute("Name", it->Name.c_str());
+    stageElement->SetAttribute("NumberOfItems", igsioCommon::ToString<unsigned long long>(it->NumberOfItems).c_str());
+    stageElement->SetDoubleAttribute("ItemsPerSec", it->ItemsPerSec);
+    const char* latencyAttributeNames[] = { "LatencyMeanSec", "LatencyP50Sec", "LatencyP95Sec", "LatencyP99Sec", "LatencyMaxSec" };
+    const double latencies[] = { it->LatencyMeanSec, it->LatencyP50Sec, it->LatencyP95Sec, it->LatencyP99Sec, it->LatencyMaxSec };
+    for (int latencyIndex = 0; latencyIndex < 5; ++latencyIndex)
+    {
+      if (latencies[latencyIndex] >= 0)
+      {
+        stageElement->SetDoubleAttribute(latencyAttributeNames[latencyIndex], latencies[latencyIndex]);
+      }
+    }
+    resultElement->AddNestedElement(stageElement);
+  }
+  return igsioCommon::XML::PrintXML(fileName, resultElement);
+}
+
+//----------------------------------------------------------------------------
+int PlusBenchmarkResult::CompareToReference(const std::string& referenceFileName, const PlusBenchmarkTolerances& tolerances) const
+{
+  vtkSmartPointer<vtkXMLDataElement> referenceElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromFile(referenceFileName.c_str()));
+  if (referenceElement == NULL || STRCASECMP(referenceElement->GetName(), this->Name.c_str()) != 0)
+  {
+    LOG_ERROR("Unable to read " << this->Name << " reference result from file " << referenceFileName);
+    return 1;
+  }
+  if (referenceElement->GetAttribute("Mode") != NULL && this->Mode != referenceElement->GetAttribute("Mode"))
+  {
+    LOG_ERROR("The reference was recorded in " << referenceElement->GetAttribute("Mode") << " mode, the current run is in " << this->Mode << " mode");
+    return 1;
+  }
+
+  std::map<std::string, const PlusBenchmarkStage*> stagesByName;
+  for (std::vector<PlusBenchmarkStage>::const_iterator it = this->Stages.begin(); it != this->Stages.end(); ++it)
+  {
+    stagesByName[it->Name] = &(*it);
+  }
+
+  int numberOfRegressions = 0;
+  double referencePeakMemoryMB = 0;
+  if (tolerances.Memory >= 0 && this->PeakMemoryMB >= 0 && referenceElement->GetScalarAttribute("PeakMemoryMB", referencePeakMemoryMB)
+      && this->PeakMemoryMB > referencePeakMemoryMB * (1.0 + tolerances.Memory))
+  {
+    LOG_ERROR("Peak memory usage is " << this->PeakMemoryMB << "MB, reference: " << referencePeakMemoryMB << "MB");
+    numberOfRegressions++;
+  }
+
+  for (int i = 0; i < referenceElement->GetNumberOfNestedElements(); ++i)
+  {
+    vtkXMLDataElement* referenceStage = referenceElement->GetNestedElement(i);
+    if (STRCASECMP(referenceStage->GetName(), "Stage") != 0 || referenceStage->GetAttribute("Name") == NULL)
+    {
+      continue;
+    }
+    std::string stageName = referenceStage->GetAttribute("Name");
+    std::map<std::string, const PlusBenchmarkStage*>::iterator stageIt = stagesByName.find(stageName);
+    if (stageIt == stagesByName.end())
+    {
+      LOG_ERROR("Stage " << stageName << " of the reference is not found in the results");
+      numberOfRegressions++;
+      continue;
+    }
+    const PlusBenchmarkStage& stage = *(stageIt->second);
+
+    double referenceItemsPerSec = 0;
+    if (tolerances.Throughput >= 0 && referenceStage->GetScalarAttribute("ItemsPerSec", referenceItemsPerSec)
+        && stage.ItemsPerSec < referenceItemsPerSec * (1.0 - tolerances.Throughput))
+    {
+      LOG_ERROR("Throughput of " << stageName << " is " << stage.ItemsPerSec << " items/sec, reference: " << referenceItemsPerSec << " items/sec");
+      numberOfRegressions++;
+    }
+
+    if (tolerances.Latency < 0)
+    {
+      continue;
+    }
+    const char* latencyAttributeNames[] = { "LatencyP50Sec", "LatencyP95Sec", "LatencyP99Sec" };
+    const double latencies[] = { stage.LatencyP50Sec, stage.LatencyP95Sec, stage.LatencyP99Sec };
+    for (int latencyIndex = 0; latencyIndex < 3; ++latencyIndex)
+    {
+      double referenceLatencySec = 0;
+      if (!referenceStage->GetScalarAttribute(latencyAttributeNames[latencyIndex], referenceLatencySec))
+      {
+        continue;
+      }
+      if (latencies[latencyIndex] < 0)
+      {
+        LOG_ERROR("Latency of " << stageName << " is not measured, but it is in the reference");
+        numberOfRegressions++;
+      }
+      else if (latencies[latencyIndex] > referenceLatencySec * (1.0 + tolerances.Latency) + tolerances.LatencyAbsoluteSec)
+      {
+        LOG_ERROR(latencyAttributeNames[latencyIndex] << " of " << stageName << " is " << latencies[latencyIndex] << ", reference: " << referenceLatencySec);
+        numberOfRegressions++;
+      }
+    }
+  }
+  return numberOfRegressions;
+}
@@ -0,0 +1,107 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusBenchmarkResult_h
+#define __PlusBenchmarkResult_h
+
+#include "PlusConfigure.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+/*!
+  \file PlusBenchmarkResult.h
+  \brief Results of the benchmark tests (vtkPlusBufferBenchmark, ReplayRecordedDataTest)
+
+  A result consists of stages (an operation, a data source or an output channel) with their throughput and latency.
+  Results are saved to XML files and can be compared to a reference result that was saved by an earlier run.
+*/
+
+//----------------------------------------------------------------------------
+/*! Measured performance of one stage. Latencies are negative if they are not measured. */
+struct PlusBenchmarkStage
+{
+  PlusBenchmarkStage();
+
+  /*! Compute the latency statistics from all the samples of the stage */
+  void SetLatencies(std::vector<double> latencySamplesSec);
+
+  std::string Name;
+  unsigned long long NumberOfItems;
+  double ItemsPerSec;
+  double LatencyMeanSec;
+  double LatencyP50Sec;
+  double LatencyP95Sec;
+  double LatencyP99Sec;
+  double LatencyMaxSec;
+};
+
+//----------------------------------------------------------------------------
+/*!
+  Latency samples collected by one thread. If there are more samples than the maximum then further samples replace
+  random kept samples (reservoir sampling), so that the kept samples represent the whole run.
+*/
+class PlusLatencySamples
+{
+public:
+  explicit PlusLatencySamples(size_t maximumNumberOfSamples = 100000);
+
+  void AddSample(double latencySec);
+
+  /*! Number of all samples added, including the ones that are not kept */
+  unsigned long long GetNumberOfSamples() const { return this->NumberOfSamples; }
+
+  const std::vector<double>& GetKeptSamplesSec() const { return this->KeptSamplesSec; }
+
+private:
+  size_t MaximumNumberOfSamples;
+  unsigned long long NumberOfSamples;
+  std::vector<double> KeptSamplesSec;
+  std::minstd_rand Random;
+};
+
+//----------------------------------------------------------------------------
+/*! Allowed differences from the reference result. Relative tolerances are not checked if they are negative. */
+struct PlusBenchmarkTolerances
+{
+  PlusBenchmarkTolerances();
+
+  /*! Allowed relative decrease of the items per second */
+  double Throughput;
+  /*! Allowed relative increase of the latency percentiles */
+  double Latency;
+  /*! Latency increases that are smaller than this are not reported (timer noise, coarse histogram bins) */
+  double LatencyAbsoluteSec;
+  /*! Allowed relative increase of the peak memory usage */
+  double Memory;
+};
+
+//----------------------------------------------------------------------------
+struct PlusBenchmarkResult
+{
+  /*! \param name Name of the root element of the saved result, it must match the reference */
+  explicit PlusBenchmarkResult(const std::string& name);
+
+  PlusStatus WriteToFile(const std::string& fileName) const;
+
+  /*!
+    Compare to a result that was saved by WriteToFile. Stages that are not in the reference are not checked.
+    Returns the number of regressions (or stages of the reference that are missing from this result).
+  */
+  int CompareToReference(const std::string& referenceFileName, const PlusBenchmarkTolerances& tolerances) const;
+
+  std::string Name;
+  /*! Mode of the benchmark, the reference must be recorded in the same mode (not saved if empty) */
+  std::string Mode;
+  /*! Not saved if negative */
+  double DurationSec;
+  /*! Not saved if negative */
+  double PeakMemoryMB;
+  std::vector<PlusBenchmarkStage> Stages;
+};
+
+#endif
@@ -0,0 +1,46 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusDevicePluginTestDevice.cxx
+  \brief Device plugin module that is loaded by vtkPlusDeviceFactoryPluginTest
+
+  The module contains a device without any hardware dependency and the registration function that the device factory
+  calls when the module is loaded. The manifest of the module is written by the build next to the module.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusDevicePlugin.h"
+#include "vtkPlusDevice.h"
+#include "vtkPlusDeviceFactory.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+
+//----------------------------------------------------------------------------
+/*! Device of the test plugin, it does not connect to any hardware */
+class vtkPlusDeviceExport vtkPlusPluginTestDevice : public vtkPlusDevice
+{
+public:
+  static vtkPlusPluginTestDevice* New();
+  vtkTypeMacro(vtkPlusPluginTestDevice, vtkPlusDevice);
+
+protected:
+  vtkPlusPluginTestDevice() {}
+  virtual ~vtkPlusPluginTestDevice() {}
+
+private:
+  vtkPlusPluginTestDevice(const vtkPlusPluginTestDevice&);
+  void operator=(const vtkPlusPluginTestDevice&);
+};
+
+vtkStandardNewMacro(vtkPlusPluginTestDevice);
+
+//----------------------------------------------------------------------------
+PLUS_DEVICE_PLUGIN_ENTRY_POINT void PlusRegisterDevicePlugin(vtkPlusDeviceFactory* factory)
+{
+  factory->RegisterDevice("PluginTestDevice", "vtkPlusPluginTestDevice", (vtkPlusDeviceFactory::PointerToDevice)&vtkPlusPluginTestDevice::New);
+}
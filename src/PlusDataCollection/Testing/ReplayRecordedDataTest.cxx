@@ -6,27 +6,145 @@ See License.txt for details.
 
 /*!
   \file ReplayRecordedDataTest.cxx
-  \brief This program tests if a recorded tracked ultrasound buffer can be read.
+  \brief Replays recorded data through a device set and measures the performance of the pipeline.
+
+  The devices of the device set configuration are connected and started, the recorded sequences of the saved data sources
+  are played once (RepeatEnabled is disabled) and the output channels of all devices are polled for new tracked frames,
+  the same way as the OpenIGTLink server does. The replay ends when the saved data sources have not added any item for
+  one second (or after the maximum duration).
+
+  Replay modes:
+  - REALTIME: the saved data sources replay the sequences at their original timing
+  - FAST: the saved data sources replay one frame per update at a high acquisition rate (original timestamps are not used),
+    which measures the maximum throughput of the pipeline
+
+  Measured for each stage:
+  - Source/<device>/<data source>: number of items added to the data source and item rate
+  - Channel/<channel>: number of tracked frames received by the consumer, frame rate and acquisition to assembly
+    latency percentiles (recorded by the LatencyTracer)
+
+  The test fails if a saved data source or an output channel of a saved data source device does not provide any item,
+  as the content of the replay does not depend on the performance of the machine.
+
+  The peak memory usage of the process is also measured. The results can be saved to an XML file, which can be used as the
+  baseline of later runs on the same machine: the test fails if the throughput of a stage is lower, or the latency or peak
+  memory usage is higher than the baseline value by more than the specified relative tolerance.
 */ 
 
 #include "PlusConfigure.h"
+#include "PlusBenchmarkResult.h"
 
 #include "vtkSmartPointer.h"
 #include "vtksys/CommandLineArguments.hxx"
-#include "vtkXMLUtilities.h"
 
+#include "PlusLatencyTracer.h"
+#include "vtkIGSIOAccurateTimer.h"
+#include "vtkIGSIOTrackedFrameList.h"
+#include "vtkPlusChannel.h"
 #include "vtkPlusDataCollector.h"
+#include "vtkPlusDataSource.h"
 #include "vtkPlusSavedDataSource.h"
 
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+  /*! The replay is finished if the saved data sources have not added items for this long */
+  const double REPLAY_IDLE_TIMEOUT_SEC = 1.0;
+  /*! Latency increases that are smaller than this are not reported, because the latency histogram bins are coarse */
+  const double LATENCY_ABSOLUTE_TOLERANCE_SEC = 0.001;
+
+  //----------------------------------------------------------------------------
+  /*! Peak memory usage of the process, in megabytes */
+  double GetPeakMemoryUsageMB()
+  {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+      return 0;
+    }
+    return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+      return 0;
+    }
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0); // bytes
+#else
+    return usage.ru_maxrss / 1024.0; // kilobytes
+#endif
+#endif
+  }
 
+  //----------------------------------------------------------------------------
+  /*! Output channel that is polled for new frames, the same way as the OpenIGTLink server polls its broadcast channels */
+  struct PolledChannel
+  {
+    PolledChannel() : Channel(NULL), LastFrameTimestamp(UNDEFINED_TIMESTAMP), NumberOfFrames(0) {}
+    vtkPlusChannel* Channel;
+    double LastFrameTimestamp;
+    unsigned long long NumberOfFrames;
+  };
+
+  //----------------------------------------------------------------------------
+  unsigned long long GetNumberOfItemsAdded(const std::vector<vtkPlusDataSource*>& sources)
+  {
+    unsigned long long numberOfItems = 0;
+    for (std::vector<vtkPlusDataSource*>::const_iterator it = sources.begin(); it != sources.end(); ++it)
+    {
+      numberOfItems += (*it)->GetNumberOfItemsAdded();
+    }
+    return numberOfItems;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Collect all data sources of a device */
+  void GetDataSources(vtkPlusDevice* device, std::vector<vtkPlusDataSource*>& sources)
+  {
+    for (DataSourceContainerConstIterator it = device->GetVideoSourceIteratorBegin(); it != device->GetVideoSourceIteratorEnd(); ++it)
+    {
+      sources.push_back(it->second);
+    }
+    for (DataSourceContainerConstIterator it = device->GetToolIteratorBegin(); it != device->GetToolIteratorEnd(); ++it)
+    {
+      sources.push_back(it->second);
+    }
+    for (DataSourceContainerConstIterator it = device->GetFieldDataSourcessIteratorBegin(); it != device->GetFieldDataSourcessIteratorEnd(); ++it)
+    {
+      sources.push_back(it->second);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
 int main( int argc, char** argv )
 {
 
   // Check command line arguments.
 
   std::string  inputConfigFileName;
-  std::string  inputVideoBufferMetafile;
-  std::string  inputTrackerBufferMetafile;
+  std::string  replayMode("REALTIME");
+  double       fastAcquisitionRate(1000.0);
+  double       maxDurationSec(60.0);
+  double       pollPeriodSec(0.005);
+  std::string  outputFileName;
+  std::string  baselineFileName;
+  double       throughputTolerance(0.2);
+  double       latencyTolerance(0.5);
+  double       memoryTolerance(0.25);
   int          verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
 
   vtksys::CommandLineArguments args;
@@ -34,6 +152,24 @@ int main( int argc, char** argv )
 
   args.AddArgument( "--config-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT,
     &inputConfigFileName, "Name of the input configuration file." );
+  args.AddArgument( "--mode", vtksys::CommandLineArguments::EQUAL_ARGUMENT,
+    &replayMode, "Replay mode: REALTIME (original timing of the recorded data) or FAST (saved data sources replay at the fast acquisition rate). Default: REALTIME." );
+  args.AddArgument( "--fast-acquisition-rate", vtksys::CommandLineArguments::EQUAL_ARGUMENT,
+    &fastAcquisitionRate, "Acquisition rate of the saved data sources in FAST mode, in frames per second. Default: 1000." );
+  args.AddArgument( "--max-duration-sec", vtksys::CommandLineArguments::EQUAL_ARGUMENT,
+    &maxDurationSec, "Maximum duration of the replay. Default: 60." );
+  args.AddArgument( "--poll-period-sec", vtksys::CommandLineArguments::EQUAL_ARGUMENT,
+    &pollPeriodSec, "Period of polling the output channels for new frames. Default: 0.005." );
+  args.AddArgument( "--output-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT,
+    &outputFileName, "XML file where the results are written. It can be used as baseline file later." );
+  args.AddArgument( "--baseline-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT,
+    &baselineFileName, "XML file of the results of a previous run. If specified then the test fails if the performance is worse than the baseline." );
+  args.AddArgument( "--throughput-tolerance", vtksys::CommandLineArguments::EQUAL_ARGUMENT,
+    &throughputTolerance, "Allowed relative decrease of the throughput compared to the baseline. Default: 0.2." );
+  args.AddArgument( "--latency-tolerance", vtksys::CommandLineArguments::EQUAL_ARGUMENT,
+    &latencyTolerance, "Allowed relative increase of the latency percentiles compared to the baseline. Default: 0.5." );
+  args.AddArgument( "--memory-tolerance", vtksys::CommandLineArguments::EQUAL_ARGUMENT,
+    &memoryTolerance, "Allowed relative increase of the peak memory usage compared to the baseline. Default: 0.25." );
   args.AddArgument( "--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, 
     &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug 5=trace)" );  
 
@@ -46,6 +182,20 @@ int main( int argc, char** argv )
 
   vtkPlusLogger::Instance()->SetLogLevel( verboseLevel );
 
+  PlusBenchmarkResult result("ReplayBenchmark");
+  result.Mode = replayMode;
+  std::transform(result.Mode.begin(), result.Mode.end(), result.Mode.begin(), ::toupper);
+  if (result.Mode != "REALTIME" && result.Mode != "FAST")
+  {
+    LOG_ERROR("Invalid replay mode: " << replayMode << ". Valid modes: REALTIME, FAST.");
+    return EXIT_FAILURE;
+  }
+  if (fastAcquisitionRate <= 0 || pollPeriodSec <= 0)
+  {
+    LOG_ERROR("The fast acquisition rate and the poll period must be positive");
+    return EXIT_FAILURE;
+  }
+
   // Prepare data collector object.
   vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::New();
   if (PlusXmlUtils::ReadDeviceSetConfigurationFromFile(configRootElement, inputConfigFileName.c_str())==PLUS_FAIL)
@@ -58,14 +208,219 @@ int main( int argc, char** argv )
 
   vtkSmartPointer<vtkPlusDataCollector> dataCollector = vtkSmartPointer<vtkPlusDataCollector>::New();
 
-  dataCollector->ReadConfiguration( configRootElement );
-  
+  if (dataCollector->ReadConfiguration( configRootElement ) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to parse the data collection configuration");
+    return EXIT_FAILURE;
+  }
+
+  DeviceCollection devices;
+  dataCollector->GetDevices(devices);
+
+  // The recorded data is replayed once, so that the replay ends and its content is the same in each run
+  std::vector<vtkPlusDataSource*> replayedSources;
+  for (DeviceCollectionConstIterator it = devices.begin(); it != devices.end(); ++it)
+  {
+    vtkPlusSavedDataSource* savedDataSource = dynamic_cast<vtkPlusSavedDataSource*>(*it);
+    if (savedDataSource == NULL)
+    {
+      continue;
+    }
+    savedDataSource->SetRepeatEnabled(false);
+    if (result.Mode == "FAST")
+    {
+      savedDataSource->SetUseOriginalTimestamps(false);
+      savedDataSource->SetAcquisitionRate(fastAcquisitionRate);
+    }
+    GetDataSources(savedDataSource, replayedSources);
+  }
+  if (replayedSources.empty())
+  {
+    LOG_ERROR("The device set does not contain any saved data source");
+    return EXIT_FAILURE;
+  }
+
   LOG_DEBUG( "Initializing data collector... " );
-  dataCollector->Connect();
+  if (dataCollector->Connect() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to connect the devices");
+    return EXIT_FAILURE;
+  }
 
-  // TODO: Check if the read transforms are really the same as in the ones recorded in the data file.
+  std::vector<PolledChannel> polledChannels;
+  for (DeviceCollectionConstIterator deviceIt = devices.begin(); deviceIt != devices.end(); ++deviceIt)
+  {
+    for (ChannelContainerConstIterator channelIt = (*deviceIt)->GetOutputChannelsStart(); channelIt != (*deviceIt)->GetOutputChannelsEnd(); ++channelIt)
+    {
+      PolledChannel polledChannel;
+      polledChannel.Channel = *channelIt;
+      polledChannels.push_back(polledChannel);
+    }
+  }
+
+  // Items that are added while starting are not part of the measurement
+  std::map<vtkPlusDataSource*, unsigned long long> initialNumberOfItems;
+  for (DeviceCollectionConstIterator deviceIt = devices.begin(); deviceIt != devices.end(); ++deviceIt)
+  {
+    std::vector<vtkPlusDataSource*> sources;
+    GetDataSources(*deviceIt, sources);
+    for (std::vector<vtkPlusDataSource*>::iterator sourceIt = sources.begin(); sourceIt != sources.end(); ++sourceIt)
+    {
+      initialNumberOfItems[*sourceIt] = (*sourceIt)->GetNumberOfItemsAdded();
+    }
+  }
+
+  LatencyTracer::GetInstance().Reset();
+  LatencyTracer::GetInstance().SetEnabled(true);
+
+  LOG_INFO("Replaying recorded data in " << result.Mode << " mode...");
+  if (dataCollector->Start() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to start the data collection");
+    dataCollector->Disconnect();
+    return EXIT_FAILURE;
+  }
+
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  double lastProgressTime = startTime;
+  unsigned long long lastNumberOfReplayedItems = GetNumberOfItemsAdded(replayedSources);
+  while (true)
+  {
+    vtkIGSIOAccurateTimer::Delay(pollPeriodSec);
+
+    for (std::vector<PolledChannel>::iterator it = polledChannels.begin(); it != polledChannels.end(); ++it)
+    {
+      double mostRecentTimestamp = 0;
+      if (it->Channel->GetMostRecentTimestamp(mostRecentTimestamp) != PLUS_SUCCESS)
+      {
+        // no data yet
+        continue;
+      }
+      trackedFrameList->Clear();
+      if (it->Channel->GetTrackedFrameList(it->LastFrameTimestamp, trackedFrameList, -1) == PLUS_SUCCESS)
+      {
+        it->NumberOfFrames += trackedFrameList->GetNumberOfTrackedFrames();
+      }
+    }
+
+    double currentTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    unsigned long long numberOfReplayedItems = GetNumberOfItemsAdded(replayedSources);
+    if (numberOfReplayedItems != lastNumberOfReplayedItems)
+    {
+      lastNumberOfReplayedItems = numberOfReplayedItems;
+      lastProgressTime = currentTime;
+    }
+    if (currentTime - lastProgressTime > REPLAY_IDLE_TIMEOUT_SEC)
+    {
+      break;
+    }
+    if (currentTime - startTime > maxDurationSec)
+    {
+      LOG_INFO("Maximum replay duration is reached");
+      lastProgressTime = currentTime;
+      break;
+    }
+  }
+  // The idle time at the end is not part of the replay
+  result.DurationSec = lastProgressTime - startTime;
+  result.PeakMemoryMB = GetPeakMemoryUsageMB();
+
+  dataCollector->Stop();
+  LatencyTracer::GetInstance().SetEnabled(false);
+
+  if (result.DurationSec <= 0)
+  {
+    LOG_ERROR("No recorded data was replayed");
+    dataCollector->Disconnect();
+    return EXIT_FAILURE;
+  }
+
+  int numberOfErrors = 0;
+  for (DeviceCollectionConstIterator deviceIt = devices.begin(); deviceIt != devices.end(); ++deviceIt)
+  {
+    std::vector<vtkPlusDataSource*> sources;
+    GetDataSources(*deviceIt, sources);
+    for (std::vector<vtkPlusDataSource*>::iterator sourceIt = sources.begin(); sourceIt != sources.end(); ++sourceIt)
+    {
+      PlusBenchmarkStage stage;
+      stage.Name = std::string("Source/") + (*deviceIt)->GetDeviceId() + "/" + (*sourceIt)->GetId();
+      stage.NumberOfItems = (*sourceIt)->GetNumberOfItemsAdded() - initialNumberOfItems[*sourceIt];
+      stage.ItemsPerSec = stage.NumberOfItems / result.DurationSec;
+      result.Stages.push_back(stage);
+      if (stage.NumberOfItems == 0 && std::find(replayedSources.begin(), replayedSources.end(), *sourceIt) != replayedSources.end())
+      {
+        LOG_ERROR(stage.Name << ": no recorded item was replayed");
+        numberOfErrors++;
+      }
+    }
+  }
+  for (std::vector<PolledChannel>::iterator it = polledChannels.begin(); it != polledChannels.end(); ++it)
+  {
+    PlusBenchmarkStage stage;
+    std::string channelId = (it->Channel->GetChannelId() ? it->Channel->GetChannelId() : "");
+    stage.Name = std::string("Channel/") + channelId;
+    stage.NumberOfItems = it->NumberOfFrames;
+    stage.ItemsPerSec = stage.NumberOfItems / result.DurationSec;
+    if (stage.NumberOfItems == 0 && dynamic_cast<vtkPlusSavedDataSource*>(it->Channel->GetOwnerDevice()) != NULL)
+    {
+      LOG_ERROR(stage.Name << ": no tracked frame was received from the replayed data");
+      numberOfErrors++;
+    }
+    LatencyTracer::Histogram histogram;
+    if (LatencyTracer::GetInstance().GetChannelHistogram(channelId, histogram) == PLUS_SUCCESS && histogram.GetNumberOfSamples() > 0)
+    {
+      stage.LatencyMeanSec = histogram.GetMeanSec();
+      stage.LatencyP50Sec = histogram.GetPercentileSec(50);
+      stage.LatencyP95Sec = histogram.GetPercentileSec(95);
+      stage.LatencyP99Sec = histogram.GetPercentileSec(99);
+    }
+    result.Stages.push_back(stage);
+  }
 
   dataCollector->Disconnect();
-  
+
+  LOG_INFO("Replay duration: " << result.DurationSec << " sec, peak memory usage: " << result.PeakMemoryMB << " MB");
+  for (std::vector<PlusBenchmarkStage>::iterator it = result.Stages.begin(); it != result.Stages.end(); ++it)
+  {
+    if (it->LatencyMeanSec >= 0)
+    {
+      LOG_INFO(it->Name << ": " << it->NumberOfItems << " items, " << it->ItemsPerSec << " items/sec, latency mean/p50/p95/p99: "
+        << it->LatencyMeanSec * 1000 << "/" << it->LatencyP50Sec * 1000 << "/" << it->LatencyP95Sec * 1000 << "/" << it->LatencyP99Sec * 1000 << " ms");
+    }
+    else
+    {
+      LOG_INFO(it->Name << ": " << it->NumberOfItems << " items, " << it->ItemsPerSec << " items/sec");
+    }
+  }
+
+  if (!outputFileName.empty() && result.WriteToFile(outputFileName) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to write the results to " << outputFileName);
+    return EXIT_FAILURE;
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("ReplayRecordedDataTest found " << numberOfErrors << " errors in the replay");
+    return EXIT_FAILURE;
+  }
+
+  if (!baselineFileName.empty())
+  {
+    PlusBenchmarkTolerances tolerances;
+    tolerances.Throughput = throughputTolerance;
+    tolerances.Latency = latencyTolerance;
+    tolerances.LatencyAbsoluteSec = LATENCY_ABSOLUTE_TOLERANCE_SEC;
+    tolerances.Memory = memoryTolerance;
+    int numberOfRegressions = result.CompareToReference(baselineFileName, tolerances);
+    if (numberOfRegressions > 0)
+    {
+      LOG_ERROR("ReplayRecordedDataTest found " << numberOfRegressions << " performance regressions compared to the baseline " << baselineFileName);
+      return EXIT_FAILURE;
+    }
+    LOG_INFO("The performance is within the tolerances of the baseline");
+  }
+
   return EXIT_SUCCESS;
 }
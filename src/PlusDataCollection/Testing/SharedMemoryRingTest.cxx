@@ -0,0 +1,244 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file SharedMemoryRingTest.cxx
+  \brief Verifies publishing and reading of items through a shared memory ring.
+
+  Items are added by a publisher and read by a consumer that opened the ring by name. The UIDs, timestamps,
+  image data and fields of the items are checked, then a writer thread overwrites the ring continuously
+  while the consumer reads it, and it is verified that the consumer never gets a partially overwritten item.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusSharedMemoryRing.h"
+
+#include <vtksys/CommandLineArguments.hxx>
+
+#include <atomic>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  void FillImage(BufferItemUidType uid, std::vector<unsigned char>& image)
+  {
+    for (size_t i = 0; i < image.size(); ++i)
+    {
+      image[i] = static_cast<unsigned char>((uid + i) % 251);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  bool CheckImage(BufferItemUidType uid, const unsigned char* image, size_t imageSizeBytes)
+  {
+    for (size_t i = 0; i < imageSizeBytes; ++i)
+    {
+      if (image[i] != static_cast<unsigned char>((uid + i) % 251))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  std::string ringName("PlusSharedMemoryRingTest");
+  int numberOfItems(8);
+  int numberOfConcurrentItems(20000);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--name", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &ringName, "Name of the shared memory (Default: PlusSharedMemoryRingTest).");
+  args.AddArgument("--number-of-items", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfItems, "Number of items in the ring (Default: 8).");
+  args.AddArgument("--number-of-concurrent-items", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfConcurrentItems, "Number of items written while the consumer is reading (Default: 20000).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors = 0;
+  const size_t imageSizeBytes = 64 * 48 * 3;
+
+  SharedMemoryRing publisher;
+  if (publisher.Create(ringName, numberOfItems, imageSizeBytes + 1024) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to create shared memory ring " << ringName);
+    return EXIT_FAILURE;
+  }
+  SharedMemoryRing consumer;
+  if (consumer.Open(ringName) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to open shared memory ring " << ringName);
+    return EXIT_FAILURE;
+  }
+  if (consumer.GetLatestItemUid() != 0 || consumer.GetOldestItemUid() != 0 || consumer.GetNumberOfItems() != static_cast<unsigned int>(numberOfItems))
+  {
+    LOG_ERROR("New ring is not empty or has wrong size");
+    numberOfErrors++;
+  }
+
+  // Add more items than the size of the ring
+  std::vector<unsigned char> image(imageSizeBytes);
+  const int numberOfAddedItems = numberOfItems * 2 + 3;
+  for (int i = 0; i < numberOfAddedItems; ++i)
+  {
+    SharedMemoryRing::ItemInfo info;
+    info.FrameSize[0] = 64;
+    info.FrameSize[1] = 48;
+    info.FrameSize[2] = 1;
+    info.NumberOfScalarComponents = 3;
+    info.FilteredTimestamp = 1000.0 + i;
+    info.UnfilteredTimestamp = 1000.0 + i + 0.5;
+    FillImage(i + 1, image);
+    std::map<std::string, std::string> fields;
+    std::ostringstream frameNumber;
+    frameNumber << i;
+    fields["FrameNumber"] = frameNumber.str();
+    fields["ProbeToTrackerTransformStatus"] = "OK";
+    std::string fieldData;
+    SharedMemoryRing::EncodeFields(fields, fieldData);
+    if (publisher.AddItem(info, &image[0], image.size(), fieldData) != PLUS_SUCCESS || info.Uid != static_cast<uint64_t>(i + 1))
+    {
+      LOG_ERROR("Failed to add item " << i);
+      numberOfErrors++;
+    }
+  }
+
+  BufferItemUidType latestUid = consumer.GetLatestItemUid();
+  BufferItemUidType oldestUid = consumer.GetOldestItemUid();
+  if (latestUid != static_cast<BufferItemUidType>(numberOfAddedItems) || oldestUid != static_cast<BufferItemUidType>(numberOfAddedItems - numberOfItems + 1))
+  {
+    LOG_ERROR("Wrong UID range: " << oldestUid << "-" << latestUid);
+    numberOfErrors++;
+  }
+
+  SharedMemoryRing::ItemInfo info;
+  std::vector<unsigned char> imageData;
+  std::string fieldData;
+  if (consumer.CopyItem(oldestUid - 1, info, imageData, fieldData) != ITEM_NOT_AVAILABLE_ANYMORE)
+  {
+    LOG_ERROR("Overwritten item is reported as available");
+    numberOfErrors++;
+  }
+  if (consumer.CopyItem(latestUid + 1, info, imageData, fieldData) != ITEM_NOT_AVAILABLE_YET)
+  {
+    LOG_ERROR("Future item is reported as available");
+    numberOfErrors++;
+  }
+  for (BufferItemUidType uid = oldestUid; uid <= latestUid; ++uid)
+  {
+    std::map<std::string, std::string> fields;
+    if (consumer.CopyItem(uid, info, imageData, fieldData) != ITEM_OK
+        || SharedMemoryRing::DecodeFields(fieldData.data(), fieldData.size(), fields) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to read item " << uid);
+      numberOfErrors++;
+      continue;
+    }
+    std::ostringstream frameNumber;
+    frameNumber << uid - 1;
+    if (info.Uid != uid || info.FilteredTimestamp != 1000.0 + uid - 1 || info.UnfilteredTimestamp != 1000.0 + uid - 0.5
+        || info.FrameSize[0] != 64 || info.FrameSize[1] != 48 || info.NumberOfScalarComponents != 3
+        || imageData.size() != imageSizeBytes || !CheckImage(uid, &imageData[0], imageData.size())
+        || fields.size() != 2 || fields["FrameNumber"] != frameNumber.str() || fields["ProbeToTrackerTransformStatus"] != "OK")
+    {
+      LOG_ERROR("Content of item " << uid << " is invalid");
+      numberOfErrors++;
+    }
+  }
+
+  // Zero-copy access
+  const unsigned char* imageInRing = NULL;
+  const char* fieldsInRing = NULL;
+  if (consumer.GetItem(latestUid, info, imageInRing, fieldsInRing) != ITEM_OK
+      || !CheckImage(latestUid, imageInRing, static_cast<size_t>(info.ImageDataSizeBytes))
+      || !consumer.IsItemValid(latestUid))
+  {
+    LOG_ERROR("Direct access to the latest item failed");
+    numberOfErrors++;
+  }
+
+  // The consumer must never get an item that is partially overwritten
+  std::atomic<bool> writerDone(false);
+  std::thread writer([&]()
+  {
+    std::vector<unsigned char> writerImage(imageSizeBytes);
+    for (int i = 0; i < numberOfConcurrentItems; ++i)
+    {
+      SharedMemoryRing::ItemInfo writerInfo;
+      FillImage(publisher.GetLatestItemUid() + 1, writerImage);
+      publisher.AddItem(writerInfo, &writerImage[0], writerImage.size(), std::string());
+    }
+    writerDone = true;
+  });
+  int numberOfReadItems = 0;
+  int numberOfOverwrittenItems = 0;
+  while (!writerDone)
+  {
+    BufferItemUidType uid = consumer.GetOldestItemUid();
+    ItemStatus status = consumer.CopyItem(uid, info, imageData, fieldData);
+    if (status == ITEM_OK)
+    {
+      numberOfReadItems++;
+      if (!CheckImage(uid, &imageData[0], imageData.size()))
+      {
+        LOG_ERROR("Partially overwritten item " << uid << " is returned as valid");
+        numberOfErrors++;
+        break;
+      }
+    }
+    else if (status == ITEM_NOT_AVAILABLE_ANYMORE)
+    {
+      numberOfOverwrittenItems++;
+    }
+  }
+  writer.join();
+  LOG_INFO("Concurrent reading: " << numberOfReadItems << " items read, " << numberOfOverwrittenItems << " items overwritten while reading");
+
+  // Consumers are notified when the publisher closes the ring
+  if (consumer.IsClosedByPublisher())
+  {
+    LOG_ERROR("Ring is reported as closed while the publisher is active");
+    numberOfErrors++;
+  }
+  publisher.Close();
+  if (!consumer.IsClosedByPublisher())
+  {
+    LOG_ERROR("Ring is not reported as closed after the publisher closed it");
+    numberOfErrors++;
+  }
+  consumer.Close();
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("SharedMemoryRingTest failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("SharedMemoryRingTest completed successfully");
+  return EXIT_SUCCESS;
+}
@@ -16,6 +16,7 @@ See License.txt for details.
 #endif
 #include "vtkPlusBuffer.h"
 #include "vtkPlusHTMLGenerator.h"
+#include "vtkPlusTimestampedCircularBuffer.h"
 #include "vtkIGSIOSequenceIO.h"
 #include "vtkIGSIOTrackedFrameList.h"
 
@@ -24,6 +25,148 @@ See License.txt for details.
 #include <vtksys/SystemTools.hxx>
 #include <vtkTable.h>
 
+// STL includes
+#include <algorithm>
+#include <deque>
+#include <random>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Fit a line to the (index, timestamp) pairs with the two-pass least squares formula and evaluate it at itemIndex.
+  // Values are relative to the first pair to avoid loss of precision.
+  double EvaluateReferenceLineFit(const std::deque<std::pair<double, double> >& window, double itemIndex)
+  {
+    double x0 = window.front().first;
+    double y0 = window.front().second;
+    double xMean = 0;
+    double yMean = 0;
+    for (std::deque<std::pair<double, double> >::const_iterator it = window.begin(); it != window.end(); ++it)
+    {
+      xMean += it->first - x0;
+      yMean += it->second - y0;
+    }
+    xMean /= window.size();
+    yMean /= window.size();
+    double covarianceXY = 0;
+    double varianceX = 0;
+    for (std::deque<std::pair<double, double> >::const_iterator it = window.begin(); it != window.end(); ++it)
+    {
+      double xiMinusXmean = it->first - x0 - xMean;
+      covarianceXY += xiMinusXmean * (it->second - y0 - yMean);
+      varianceX += xiMinusXmean * xiMinusXmean;
+    }
+    double a = covarianceXY / varianceX;
+    return y0 + yMean + a * (itemIndex - x0 - xMean);
+  }
+
+  //----------------------------------------------------------------------------
+  // The incrementally updated line fit shall give the same filtered timestamps as fitting a line to the last averagedItemsForFiltering items
+  int CheckIncrementalFilteringEquivalence(vtkIGSIOTrackedFrameList* trackerFrameList, int averagedItemsForFiltering)
+  {
+    const double maxAllowedDifferenceSec = 1e-6;
+    int numberOfErrors = 0;
+    vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    buffer->SetAveragedItemsForFiltering(averagedItemsForFiltering);
+    std::deque<std::pair<double, double> > window;
+    double maxDifference = 0;
+    for (unsigned int frameIndex = 0; frameIndex < trackerFrameList->GetNumberOfTrackedFrames(); ++frameIndex)
+    {
+      igsioTrackedFrame* trackedFrame = trackerFrameList->GetTrackedFrame(frameIndex);
+      double unfilteredTimestamp = 0;
+      unsigned long frameNumber = 0;
+      if (igsioCommon::StringToNumber<double>(trackedFrame->GetFrameField("UnfilteredTimestamp"), unfilteredTimestamp) != PLUS_SUCCESS
+          || igsioCommon::StringToNumber<unsigned long>(trackedFrame->GetFrameField("FrameNumber"), frameNumber) != PLUS_SUCCESS)
+      {
+        continue;
+      }
+
+      double filteredTimestamp = 0;
+      bool filteredTimestampProbablyValid = true;
+      if (buffer->CreateFilteredTimeStampForItem(frameNumber, unfilteredTimestamp, filteredTimestamp, filteredTimestampProbablyValid) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to create filtered timestamp for frame " << frameNumber);
+        numberOfErrors++;
+        continue;
+      }
+
+      window.push_back(std::make_pair(static_cast<double>(frameNumber), unfilteredTimestamp));
+      if (window.size() > static_cast<size_t>(averagedItemsForFiltering))
+      {
+        window.pop_front();
+      }
+      double expectedFilteredTimestamp = unfilteredTimestamp;
+      if (averagedItemsForFiltering > 1 && window.size() == static_cast<size_t>(averagedItemsForFiltering))
+      {
+        expectedFilteredTimestamp = EvaluateReferenceLineFit(window, frameNumber);
+      }
+
+      double difference = fabs(filteredTimestamp - expectedFilteredTimestamp);
+      maxDifference = std::max(maxDifference, difference);
+      if (difference > maxAllowedDifferenceSec)
+      {
+        LOG_ERROR("Incrementally computed filtered timestamp differs from the reference (frame: " << frameNumber << ", averaged items: " << averagedItemsForFiltering
+                  << ", filtered: " << std::fixed << filteredTimestamp << ", reference: " << expectedFilteredTimestamp << ")");
+        numberOfErrors++;
+      }
+    }
+    LOG_INFO("Maximum difference between incremental and reference filtering with " << averagedItemsForFiltering << " averaged items: " << maxDifference * 1e9 << "ns");
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  // Periodic timestamps with small jitter and occasional large delays. With outlier rejection enabled
+  // the delayed items shall not distort the filtered timestamps.
+  int CheckOutlierRejection(int averagedItemsForFiltering)
+  {
+    const double framePeriodSec = 0.020;
+    const double jitterStdevSec = 0.001;
+    const double delaySec = 0.030;
+    const int delayedItemPeriod = 50;
+    const int numberOfItems = 2000;
+    const double outlierRejectionThreshold = 4.0;
+
+    vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    buffer->SetAveragedItemsForFiltering(averagedItemsForFiltering);
+    vtkSmartPointer<vtkPlusBuffer> bufferWithOutlierRejection = vtkSmartPointer<vtkPlusBuffer>::New();
+    bufferWithOutlierRejection->SetAveragedItemsForFiltering(averagedItemsForFiltering);
+    bufferWithOutlierRejection->SetTimestampOutlierRejectionThreshold(outlierRejectionThreshold);
+
+    std::mt19937 randomGenerator(1);
+    std::normal_distribution<double> jitter(0.0, jitterStdevSec);
+    double maxError = 0;
+    double maxErrorWithOutlierRejection = 0;
+    for (int i = 0; i < numberOfItems; ++i)
+    {
+      unsigned long frameNumber = 1000 + i;
+      double trueTimestamp = 100.0 + frameNumber * framePeriodSec;
+      double unfilteredTimestamp = trueTimestamp + jitter(randomGenerator) + ((i % delayedItemPeriod == delayedItemPeriod - 1) ? delaySec : 0.0);
+
+      double filteredTimestamp = 0;
+      double filteredTimestampWithOutlierRejection = 0;
+      bool filteredTimestampProbablyValid = true;
+      buffer->CreateFilteredTimeStampForItem(frameNumber, unfilteredTimestamp, filteredTimestamp, filteredTimestampProbablyValid);
+      bufferWithOutlierRejection->CreateFilteredTimeStampForItem(frameNumber, unfilteredTimestamp, filteredTimestampWithOutlierRejection, filteredTimestampProbablyValid);
+      if (i < 2 * averagedItemsForFiltering)
+      {
+        // the filter is not initialized yet
+        continue;
+      }
+      maxError = std::max(maxError, fabs(filteredTimestamp - trueTimestamp));
+      maxErrorWithOutlierRejection = std::max(maxErrorWithOutlierRejection, fabs(filteredTimestampWithOutlierRejection - trueTimestamp));
+    }
+
+    LOG_INFO("Maximum filtered timestamp error without outlier rejection: " << maxError * 1000 << "ms, with outlier rejection: " << maxErrorWithOutlierRejection * 1000 << "ms");
+    if (maxErrorWithOutlierRejection >= maxError)
+    {
+      LOG_ERROR("Outlier rejection did not reduce the filtered timestamp error (without: " << maxError * 1000 << "ms, with: " << maxErrorWithOutlierRejection * 1000 << "ms)");
+      return 1;
+    }
+    return 0;
+  }
+}
+
+//----------------------------------------------------------------------------
 
 int main(int argc, char** argv)
 {
@@ -90,6 +233,12 @@ int main(int argc, char** argv)
   LOG_INFO("Copy buffer to tracker buffer...");
   vtkSmartPointer<vtkPlusBuffer> trackerBuffer = vtkSmartPointer<vtkPlusBuffer>::New();
   trackerBuffer->SetTimeStampReporting(true);
+  std::string binaryReportFile = vtksys::SystemTools::GetCurrentWorkingDirectory() + std::string("/TimestampReport.bin");
+  if (trackerBuffer->SetTimeStampReportFileName(binaryReportFile) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to set timestamp report file name");
+    numberOfErrors++;
+  }
   // compute filtered timestamps now to test the filtering
   if (trackerBuffer->CopyTransformFromTrackedFrameList(trackerFrameList, vtkPlusBuffer::READ_UNFILTERED_COMPUTE_FILTERED_TIMESTAMPS, transformName) != PLUS_SUCCESS)
   {
@@ -180,6 +329,13 @@ int main(int argc, char** argv)
   }
 
 
+  // 3. Incremental line fitting shall be numerically equivalent to fitting a line to the last items (check also with a large window)
+  numberOfErrors += CheckIncrementalFilteringEquivalence(trackerFrameList, inputAveragedItemsForFiltering);
+  numberOfErrors += CheckIncrementalFilteringEquivalence(trackerFrameList, inputAveragedItemsForFiltering * 10);
+
+  // 4. Outlier rejection shall reduce the effect of occasional large delays on the filtered timestamps
+  numberOfErrors += CheckOutlierRejection(inputAveragedItemsForFiltering);
+
   vtkSmartPointer<vtkTable> timestampReportTable = vtkSmartPointer<vtkTable>::New();
   if (trackerBuffer->GetTimeStampReportTable(timestampReportTable) != PLUS_SUCCESS)
   {
@@ -187,6 +343,37 @@ int main(int argc, char** argv)
     numberOfErrors++;
   }
 
+  // 5. The report file shall contain the same records as the report table (disabling the reporting writes the pending records)
+  trackerBuffer->SetTimeStampReporting(false);
+  vtkSmartPointer<vtkTable> fileReportTable = vtkSmartPointer<vtkTable>::New();
+  if (vtkPlusTimestampedCircularBuffer::ConvertTimeStampReportFileToTable(binaryReportFile, fileReportTable) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to convert timestamp report file to table!");
+    numberOfErrors++;
+  }
+  else if (fileReportTable->GetNumberOfRows() != timestampReportTable->GetNumberOfRows()
+           || fileReportTable->GetNumberOfColumns() != timestampReportTable->GetNumberOfColumns())
+  {
+    LOG_ERROR("Timestamp report file has " << fileReportTable->GetNumberOfRows() << " rows, the report table has " << timestampReportTable->GetNumberOfRows());
+    numberOfErrors++;
+  }
+  else
+  {
+    for (vtkIdType row = 0; row < fileReportTable->GetNumberOfRows(); ++row)
+    {
+      for (vtkIdType column = 0; column < fileReportTable->GetNumberOfColumns(); ++column)
+      {
+        if (fileReportTable->GetValue(row, column).ToDouble() != timestampReportTable->GetValue(row, column).ToDouble())
+        {
+          LOG_ERROR("Timestamp report file differs from the report table at row " << row << ", column " << column);
+          numberOfErrors++;
+          row = fileReportTable->GetNumberOfRows();
+          break;
+        }
+      }
+    }
+  }
+
   std::string reportFile = vtksys::SystemTools::GetCurrentWorkingDirectory() + std::string("/TimestampReport.txt");
 
 #ifdef PLUS_RENDERING_ENABLED
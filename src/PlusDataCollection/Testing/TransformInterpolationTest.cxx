@@ -6,6 +6,7 @@
 
 #include "PlusConfigure.h"
 #include "PlusMath.h"
+#include "PlusTransformInterpolationBatch.h"
 #include "vtkPlusHTMLGenerator.h"
 #include "vtkMath.h"
 #include "vtkMatrix4x4.h"
@@ -26,6 +27,7 @@ int main(int argc, char **argv)
   double inputMaxTranslationDifference(0.5); 
   double inputMaxRotationDifference(1.0); 
   std::string inputTransformName; 
+  double inputMaxBatchDifference(1e-6); 
 
   int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
 
@@ -37,6 +39,7 @@ int main(int argc, char **argv)
   args.AddArgument("--source-seq-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputMetafile, "Input sequence metafile.");
   args.AddArgument("--max-rotation-difference", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputMaxRotationDifference, "Maximum rotation difference in degrees (Default: 1 deg).");
   args.AddArgument("--max-translation-difference", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputMaxTranslationDifference, "Maximum translation difference (Default: 0.5 mm).");
+  args.AddArgument("--max-batch-difference", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputMaxBatchDifference, "Maximum difference of matrix elements between batch and single item interpolation (Default: 1e-6).");
   args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");  
   
   if ( !args.Parse() )
@@ -162,6 +165,63 @@ int main(int argc, char **argv)
     prevmatrix->DeepCopy(matrix);      
   }
 
+  // Check that batch interpolation gives the same results as single item interpolation
+  //****************************
+
+  TransformInterpolationBatch batch; 
+  std::vector<vtkPlusBuffer::TransformSample> batchSamples; 
+  std::vector<StreamBufferItem> referenceItems; 
+  for ( double newTime = startTime; newTime < endTime; newTime += 1.0 / (frameRate * 5.0) )
+  {
+    StreamBufferItem referenceItem; 
+    if ( trackerBuffer->GetStreamBufferItemFromTime(newTime, &referenceItem, vtkPlusBuffer::INTERPOLATED) != ITEM_OK )
+    {
+      continue; 
+    }
+    vtkPlusBuffer::TransformSample sample; 
+    if ( trackerBuffer->PrepareTransformInterpolation(newTime, batch, sample) != ITEM_OK )
+    {
+      LOG_ERROR("Failed to prepare batch interpolation at time: " << std::fixed << newTime ); 
+      numberOfErrors++; 
+      continue; 
+    }
+    batchSamples.push_back(sample); 
+    referenceItems.push_back(referenceItem); 
+  }
+
+  batch.Interpolate(); 
+
+  int numberOfBatchEntries(0); 
+  for ( unsigned int i = 0; i < batchSamples.size(); ++i )
+  {
+    vtkPlusBuffer::TransformSample& sample = batchSamples[i]; 
+    if ( sample.BatchIndex >= 0 )
+    {
+      batch.GetInterpolatedMatrix(sample.BatchIndex, sample.Matrix); 
+      numberOfBatchEntries++; 
+    }
+    double referenceMatrix[16]; 
+    referenceItems[i].GetMatrixElements(referenceMatrix); 
+    double maxDifference(0); 
+    for ( int element = 0; element < 16; ++element )
+    {
+      maxDifference = std::max(maxDifference, fabs(referenceMatrix[element] - sample.Matrix[element])); 
+    }
+    double referenceTimestamp = referenceItems[i].GetTimestamp(trackerBuffer->GetLocalTimeOffsetSec()); 
+    if ( maxDifference > inputMaxBatchDifference || sample.Status != referenceItems[i].GetStatus() || fabs(sample.Timestamp - referenceTimestamp) > 1e-9 )
+    {
+      LOG_ERROR("Batch interpolation differs from single item interpolation (matrix difference=" << maxDifference << ", status=" << sample.Status
+        << " vs. " << referenceItems[i].GetStatus() << ", timestamp=" << std::fixed << sample.Timestamp << " vs. " << referenceTimestamp << ")!"); 
+      numberOfErrors++; 
+    }
+  }
+  LOG_INFO("Compared " << batchSamples.size() << " batch interpolation results (" << numberOfBatchEntries << " interpolated in the batch)"); 
+  if ( numberOfBatchEntries == 0 )
+  {
+    LOG_ERROR("No transforms were interpolated in the batch"); 
+    numberOfErrors++; 
+  }
+
   if ( numberOfErrors != 0 )
   {
     LOG_INFO("Test failed!");
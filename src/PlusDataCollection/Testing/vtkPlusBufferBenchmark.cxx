@@ -0,0 +1,481 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusBufferBenchmark.cxx
+  \brief Measures the throughput and latency of vtkPlusBuffer operations under contention.
+
+  Scenarios (each runs for the specified duration):
+  - AddItem/<size>: writer threads add video frames of the given size to their own buffer as fast as possible, while
+    reader threads get items of the first buffer by GetStreamBufferItemFromTime (CLOSEST_TIME) at random times
+  - GetStreamBufferItemFromTime/Interpolated: a writer adds tool transforms, readers get interpolated transforms
+  - GetTrackedFrameListSampled: a writer adds video frames and tool transforms to the data sources of a channel,
+    consumer threads get the sampled tracked frame lists of the channel (as the capture device does)
+  - ClearAndResize: same as AddItem with small frames, while another thread repeatedly clears and resizes the buffer
+
+  Items are added with timestamp = frame number * FRAME_PERIOD_SEC (and tool translation = frame number), so readers
+  can check that the returned items are consistent. Any inconsistency is an error.
+
+  For each operation the number of operations per second and the latency percentiles are reported. The results can be
+  saved to an XML file, which can be used as the baseline of later runs: the test fails if the throughput of an operation
+  is lower, or its latency is higher than the baseline value by more than the specified relative tolerance.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusBenchmarkResult.h"
+#include "vtkPlusBuffer.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataSource.h"
+
+#include <vtkIGSIOTrackedFrameList.h>
+#include <vtkMatrix4x4.h>
+#include <vtkSmartPointer.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  typedef std::chrono::steady_clock Clock;
+
+  const double FRAME_PERIOD_SEC = 0.001;
+  /*! Latency increases that are smaller than this are not reported, as short operations are dominated by timer noise */
+  const double LATENCY_ABSOLUTE_TOLERANCE_SEC = 0.00005;
+  /*! Time between clear or resize operations in the ClearAndResize scenario */
+  const double CLEAR_AND_RESIZE_PERIOD_SEC = 0.005;
+
+  //----------------------------------------------------------------------------
+  double GetElapsedSec(const Clock::time_point& start)
+  {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Operation count and latency samples of one thread */
+  struct OperationStatistics
+  {
+    OperationStatistics() : NumberOfErrors(0) {}
+
+    void AddSample(double latencySec)
+    {
+      this->LatencySamples.AddSample(latencySec);
+    }
+
+    int NumberOfErrors;
+    PlusLatencySamples LatencySamples;
+  };
+
+  //----------------------------------------------------------------------------
+  /*! Merge the statistics of the threads of an operation into a result. Returns the number of errors of the threads. */
+  int AddStageResult(const std::string& name, const std::vector<OperationStatistics>& statistics, double durationSec, PlusBenchmarkResult& results)
+  {
+    PlusBenchmarkStage result;
+    result.Name = name;
+    std::vector<double> samples;
+    int numberOfErrors = 0;
+    for (std::vector<OperationStatistics>::const_iterator it = statistics.begin(); it != statistics.end(); ++it)
+    {
+      result.NumberOfItems += it->LatencySamples.GetNumberOfSamples();
+      samples.insert(samples.end(), it->LatencySamples.GetKeptSamplesSec().begin(), it->LatencySamples.GetKeptSamplesSec().end());
+      numberOfErrors += it->NumberOfErrors;
+    }
+    result.ItemsPerSec = result.NumberOfItems / durationSec;
+    result.SetLatencies(samples);
+    results.Stages.push_back(result);
+
+    LOG_INFO(name << ": " << result.NumberOfItems << " ops, " << static_cast<long long>(result.ItemsPerSec) << " ops/s, latency p50/p95/p99/max: "
+             << result.LatencyP50Sec * 1e6 << "/" << result.LatencyP95Sec * 1e6 << "/" << result.LatencyP99Sec * 1e6 << "/" << result.LatencyMaxSec * 1e6 << " us");
+    if (numberOfErrors > 0)
+    {
+      LOG_ERROR(name << ": " << numberOfErrors << " inconsistent results");
+    }
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  void JoinThreads(std::vector<std::thread>& threads)
+  {
+    for (std::vector<std::thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+    {
+      it->join();
+    }
+    threads.clear();
+  }
+
+  //----------------------------------------------------------------------------
+  vtkSmartPointer<vtkPlusBuffer> CreateVideoBuffer(const FrameSizeType& frameSize, int bufferSize)
+  {
+    vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    buffer->SetBufferSize(bufferSize);
+    buffer->SetPixelType(VTK_UNSIGNED_CHAR);
+    buffer->SetNumberOfScalarComponents(1);
+    buffer->SetImageType(US_IMG_BRIGHTNESS);
+    buffer->SetImageOrientation(US_IMG_ORIENT_MF);
+    buffer->SetFrameSize(frameSize);
+    return buffer;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Add video frames as fast as possible until stop is requested */
+  void VideoWriterThread(vtkPlusBuffer* buffer, FrameSizeType frameSize, std::atomic<bool>* stopRequested, OperationStatistics* statistics)
+  {
+    std::vector<unsigned char> frame(frameSize[0] * frameSize[1] * frameSize[2], 0);
+    const std::array<int, 3> noClip = { igsioCommon::NO_CLIP, igsioCommon::NO_CLIP, igsioCommon::NO_CLIP };
+    long frameNumber = 0;
+    while (!stopRequested->load())
+    {
+      frameNumber++;
+      frame[0] = static_cast<unsigned char>(frameNumber);
+      double timestamp = frameNumber * FRAME_PERIOD_SEC;
+      Clock::time_point start = Clock::now();
+      PlusStatus status = buffer->AddItem(&frame[0], US_IMG_ORIENT_MF, frameSize, VTK_UNSIGNED_CHAR, 1, US_IMG_BRIGHTNESS, 0, frameNumber,
+                                          noClip, noClip, timestamp, timestamp);
+      statistics->AddSample(GetElapsedSec(start));
+      if (status != PLUS_SUCCESS)
+      {
+        statistics->NumberOfErrors++;
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Get items at random times between the oldest and latest item, check that the item matches its timestamp */
+  void ItemReaderThread(vtkPlusBuffer* buffer, DataItemTemporalInterpolationType interpolation, unsigned int seed,
+                        std::atomic<bool>* stopRequested, OperationStatistics* statistics)
+  {
+    std::minstd_rand random(seed);
+    std::uniform_real_distribution<double> position(0.0, 1.0);
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    StreamBufferItem item;
+    while (!stopRequested->load())
+    {
+      double oldestTimestamp(0);
+      double latestTimestamp(0);
+      if (buffer->GetOldestTimeStamp(oldestTimestamp) != ITEM_OK || buffer->GetLatestTimeStamp(latestTimestamp) != ITEM_OK)
+      {
+        std::this_thread::yield();
+        continue;
+      }
+      double requestedTimestamp = oldestTimestamp + (latestTimestamp - oldestTimestamp) * position(random);
+
+      Clock::time_point start = Clock::now();
+      ItemStatus status = buffer->GetStreamBufferItemFromTime(requestedTimestamp, &item, interpolation);
+      statistics->AddSample(GetElapsedSec(start));
+      if (status != ITEM_OK)
+      {
+        // the item may have been overwritten or the buffer cleared since the timestamps were queried
+        continue;
+      }
+
+      double itemTimestamp = item.GetFilteredTimestamp(0);
+      if (interpolation == INTERPOLATED)
+      {
+        // translation is a linear function of the timestamp, so the interpolated translation is known
+        if (item.GetMatrix(matrix) != PLUS_SUCCESS || fabs(matrix->GetElement(0, 3) - itemTimestamp / FRAME_PERIOD_SEC) > 1e-3)
+        {
+          statistics->NumberOfErrors++;
+        }
+      }
+      else if (fabs(itemTimestamp - item.GetIndex() * FRAME_PERIOD_SEC) > FRAME_PERIOD_SEC * 0.1)
+      {
+        statistics->NumberOfErrors++;
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  int RunAddItemBenchmark(const FrameSizeType& frameSize, int numberOfWriters, int numberOfReaders, int bufferSize, double durationSec, PlusBenchmarkResult& results)
+  {
+    std::vector<vtkSmartPointer<vtkPlusBuffer> > buffers;
+    for (int i = 0; i < numberOfWriters; ++i)
+    {
+      buffers.push_back(CreateVideoBuffer(frameSize, bufferSize));
+    }
+
+    std::atomic<bool> stopRequested(false);
+    std::vector<OperationStatistics> writerStatistics(numberOfWriters);
+    std::vector<OperationStatistics> readerStatistics(numberOfReaders);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < numberOfWriters; ++i)
+    {
+      threads.push_back(std::thread(VideoWriterThread, buffers[i].GetPointer(), frameSize, &stopRequested, &writerStatistics[i]));
+    }
+    for (int i = 0; i < numberOfReaders; ++i)
+    {
+      threads.push_back(std::thread(ItemReaderThread, buffers[0].GetPointer(), CLOSEST_TIME, i + 1, &stopRequested, &readerStatistics[i]));
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(durationSec));
+    stopRequested = true;
+    JoinThreads(threads);
+
+    std::ostringstream sizeName;
+    sizeName << frameSize[0] << "x" << frameSize[1];
+    int numberOfErrors = AddStageResult("AddItem/" + sizeName.str(), writerStatistics, durationSec, results);
+    numberOfErrors += AddStageResult("GetStreamBufferItemFromTime/Closest/" + sizeName.str(), readerStatistics, durationSec, results);
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int RunInterpolationBenchmark(int numberOfReaders, int bufferSize, double durationSec, PlusBenchmarkResult& results)
+  {
+    vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    buffer->SetBufferSize(bufferSize);
+
+    std::atomic<bool> stopRequested(false);
+    std::vector<OperationStatistics> writerStatistics(1);
+    std::vector<OperationStatistics> readerStatistics(numberOfReaders);
+    std::vector<std::thread> threads;
+    threads.push_back(std::thread([&buffer, &stopRequested, &writerStatistics]()
+    {
+      vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+      unsigned long frameNumber = 0;
+      while (!stopRequested.load())
+      {
+        frameNumber++;
+        double timestamp = frameNumber * FRAME_PERIOD_SEC;
+        matrix->SetElement(0, 3, frameNumber);
+        Clock::time_point start = Clock::now();
+        if (buffer->AddTimeStampedItem(matrix, TOOL_OK, frameNumber, timestamp, timestamp) != PLUS_SUCCESS)
+        {
+          writerStatistics[0].NumberOfErrors++;
+        }
+        writerStatistics[0].AddSample(GetElapsedSec(start));
+      }
+    }));
+    for (int i = 0; i < numberOfReaders; ++i)
+    {
+      threads.push_back(std::thread(ItemReaderThread, buffer.GetPointer(), INTERPOLATED, i + 1, &stopRequested, &readerStatistics[i]));
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(durationSec));
+    stopRequested = true;
+    JoinThreads(threads);
+
+    int numberOfErrors = AddStageResult("AddTimeStampedItem", writerStatistics, durationSec, results);
+    numberOfErrors += AddStageResult("GetStreamBufferItemFromTime/Interpolated", readerStatistics, durationSec, results);
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int RunSampledListBenchmark(const FrameSizeType& frameSize, int numberOfConsumers, int bufferSize, double durationSec, PlusBenchmarkResult& results)
+  {
+    vtkSmartPointer<vtkPlusDataSource> videoSource = vtkSmartPointer<vtkPlusDataSource>::New();
+    videoSource->SetId("Video");
+    videoSource->SetBufferSize(bufferSize);
+    videoSource->SetPixelType(VTK_UNSIGNED_CHAR);
+    videoSource->SetNumberOfScalarComponents(1);
+    videoSource->SetImageType(US_IMG_BRIGHTNESS);
+    videoSource->SetInputImageOrientation(US_IMG_ORIENT_MF);
+    videoSource->SetOutputImageOrientation(US_IMG_ORIENT_MF);
+    videoSource->SetInputFrameSize(frameSize);
+    vtkSmartPointer<vtkPlusDataSource> tool = vtkSmartPointer<vtkPlusDataSource>::New();
+    tool->SetId("ProbeToTracker");
+    tool->SetBufferSize(bufferSize);
+    vtkSmartPointer<vtkPlusChannel> channel = vtkSmartPointer<vtkPlusChannel>::New();
+    channel->SetVideoSource(videoSource);
+    channel->AddTool(tool);
+
+    std::atomic<bool> stopRequested(false);
+    std::vector<OperationStatistics> writerStatistics(1);
+    std::vector<OperationStatistics> consumerStatistics(numberOfConsumers);
+    std::vector<std::thread> threads;
+    threads.push_back(std::thread([&videoSource, &tool, &frameSize, &stopRequested, &writerStatistics]()
+    {
+      std::vector<unsigned char> frame(frameSize[0] * frameSize[1] * frameSize[2], 0);
+      vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+      long frameNumber = 0;
+      while (!stopRequested.load())
+      {
+        frameNumber++;
+        double timestamp = frameNumber * FRAME_PERIOD_SEC;
+        matrix->SetElement(0, 3, frameNumber);
+        Clock::time_point start = Clock::now();
+        if (tool->AddTimeStampedItem(matrix, TOOL_OK, frameNumber, timestamp, timestamp) != PLUS_SUCCESS
+            || videoSource->AddItem(&frame[0], US_IMG_ORIENT_MF, frameSize, VTK_UNSIGNED_CHAR, 1, US_IMG_BRIGHTNESS, 0, frameNumber, timestamp, timestamp) != PLUS_SUCCESS)
+        {
+          writerStatistics[0].NumberOfErrors++;
+        }
+        writerStatistics[0].AddSample(GetElapsedSec(start));
+        // leave time for the consumers, as a real device does not add items continuously
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      }
+    }));
+    for (int i = 0; i < numberOfConsumers; ++i)
+    {
+      threads.push_back(std::thread([&channel, &stopRequested, &consumerStatistics, i]()
+      {
+        vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+        double lastAlreadyGotTimestamp = UNDEFINED_TIMESTAMP;
+        double nextToBeAddedTimestamp = UNDEFINED_TIMESTAMP;
+        while (!stopRequested.load())
+        {
+          trackedFrameList->Clear();
+          Clock::time_point start = Clock::now();
+          channel->GetTrackedFrameListSampled(lastAlreadyGotTimestamp, nextToBeAddedTimestamp, trackedFrameList, 2 * FRAME_PERIOD_SEC, 0.01);
+          consumerStatistics[i].AddSample(GetElapsedSec(start));
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+      }));
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(durationSec));
+    stopRequested = true;
+    JoinThreads(threads);
+
+    int numberOfErrors = AddStageResult("ChannelAddItems", writerStatistics, durationSec, results);
+    numberOfErrors += AddStageResult("GetTrackedFrameListSampled", consumerStatistics, durationSec, results);
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int RunClearAndResizeBenchmark(int numberOfReaders, int bufferSize, double durationSec, PlusBenchmarkResult& results)
+  {
+    FrameSizeType frameSize = { 64, 64, 1 };
+    vtkSmartPointer<vtkPlusBuffer> buffer = CreateVideoBuffer(frameSize, bufferSize);
+
+    std::atomic<bool> stopRequested(false);
+    std::vector<OperationStatistics> writerStatistics(1);
+    std::vector<OperationStatistics> readerStatistics(numberOfReaders);
+    std::vector<OperationStatistics> maintenanceStatistics(1);
+    std::vector<std::thread> threads;
+    threads.push_back(std::thread(VideoWriterThread, buffer.GetPointer(), frameSize, &stopRequested, &writerStatistics[0]));
+    for (int i = 0; i < numberOfReaders; ++i)
+    {
+      threads.push_back(std::thread(ItemReaderThread, buffer.GetPointer(), CLOSEST_TIME, i + 1, &stopRequested, &readerStatistics[i]));
+    }
+    threads.push_back(std::thread([&buffer, bufferSize, &stopRequested, &maintenanceStatistics]()
+    {
+      int operationIndex = 0;
+      while (!stopRequested.load())
+      {
+        std::this_thread::sleep_for(std::chrono::duration<double>(CLEAR_AND_RESIZE_PERIOD_SEC));
+        Clock::time_point start = Clock::now();
+        PlusStatus status = PLUS_SUCCESS;
+        switch (operationIndex++ % 3)
+        {
+          case 0:
+            buffer->Clear();
+            break;
+          case 1:
+            status = buffer->SetBufferSize(bufferSize * 2);
+            break;
+          default:
+            status = buffer->SetBufferSize(bufferSize);
+        }
+        maintenanceStatistics[0].AddSample(GetElapsedSec(start));
+        if (status != PLUS_SUCCESS)
+        {
+          maintenanceStatistics[0].NumberOfErrors++;
+        }
+      }
+    }));
+    std::this_thread::sleep_for(std::chrono::duration<double>(durationSec));
+    stopRequested = true;
+    JoinThreads(threads);
+
+    int numberOfErrors = AddStageResult("ClearAndResize/AddItem", writerStatistics, durationSec, results);
+    numberOfErrors += AddStageResult("ClearAndResize/GetStreamBufferItemFromTime", readerStatistics, durationSec, results);
+    numberOfErrors += AddStageResult("ClearAndResize/ClearOrSetBufferSize", maintenanceStatistics, durationSec, results);
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  double durationSec(1.0);
+  int bufferSize(150);
+  int numberOfWriters(2);
+  int numberOfReaders(4);
+  std::string outputFileName;
+  std::string baselineFileName;
+  double throughputTolerance(0.5);
+  double latencyTolerance(2.0);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--duration-sec", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &durationSec, "Duration of each scenario in seconds (Default: 1.0).");
+  args.AddArgument("--buffer-size", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &bufferSize, "Number of items in the buffers (Default: 150).");
+  args.AddArgument("--writers", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfWriters, "Number of concurrent writer threads in the AddItem scenarios (Default: 2).");
+  args.AddArgument("--readers", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfReaders, "Number of concurrent reader threads (Default: 4).");
+  args.AddArgument("--output-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &outputFileName, "Save the results to this XML file, which can be used as a baseline.");
+  args.AddArgument("--baseline-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &baselineFileName, "Compare the results to this baseline XML file. The test fails if there is a regression.");
+  args.AddArgument("--throughput-tolerance", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &throughputTolerance, "Allowed relative decrease of the operations per second compared to the baseline (Default: 0.5).");
+  args.AddArgument("--latency-tolerance", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &latencyTolerance, "Allowed relative increase of the latency percentiles compared to the baseline (Default: 2.0).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (numberOfWriters < 1 || numberOfReaders < 1 || bufferSize < 2 || durationSec <= 0)
+  {
+    LOG_ERROR("Invalid arguments: at least one writer and reader, buffer size of at least 2 and positive duration are required");
+    exit(EXIT_FAILURE);
+  }
+
+  PlusBenchmarkResult results("BufferBenchmark");
+  int numberOfErrors = 0;
+  const FrameSizeType frameSizes[] = { { 64, 64, 1 }, { 640, 480, 1 }, { 1920, 1080, 1 } };
+  for (int i = 0; i < 3; ++i)
+  {
+    numberOfErrors += RunAddItemBenchmark(frameSizes[i], numberOfWriters, numberOfReaders, bufferSize, durationSec, results);
+  }
+  numberOfErrors += RunInterpolationBenchmark(numberOfReaders, bufferSize, durationSec, results);
+  numberOfErrors += RunSampledListBenchmark(frameSizes[1], numberOfReaders, bufferSize, durationSec, results);
+  numberOfErrors += RunClearAndResizeBenchmark(numberOfReaders, bufferSize, durationSec, results);
+
+  if (!outputFileName.empty() && results.WriteToFile(outputFileName) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to write the results to " << outputFileName);
+    return EXIT_FAILURE;
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("vtkPlusBufferBenchmark found " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  if (!baselineFileName.empty())
+  {
+    PlusBenchmarkTolerances tolerances;
+    tolerances.Throughput = throughputTolerance;
+    tolerances.Latency = latencyTolerance;
+    tolerances.LatencyAbsoluteSec = LATENCY_ABSOLUTE_TOLERANCE_SEC;
+    int numberOfRegressions = results.CompareToReference(baselineFileName, tolerances);
+    if (numberOfRegressions > 0)
+    {
+      LOG_ERROR("vtkPlusBufferBenchmark found " << numberOfRegressions << " performance regressions compared to the baseline " << baselineFileName);
+      return EXIT_FAILURE;
+    }
+    LOG_INFO("The performance is within the tolerances of the baseline");
+  }
+
+  LOG_INFO("vtkPlusBufferBenchmark completed successfully");
+  return EXIT_SUCCESS;
+}
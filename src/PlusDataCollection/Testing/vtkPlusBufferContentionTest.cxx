@@ -0,0 +1,179 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusBufferContentionTest.cxx
+  \brief Measures the latency of buffer UID and timestamp queries while a device thread is adding items.
+
+  The test is executed with 1, 4 and 16 concurrent reader threads, both with the default (locked)
+  and with the lock-free read mode of the buffer. It fails if a reader observes inconsistent
+  buffer state (e.g., timestamp of the latest item does not match its UID).
+*/
+
+#include "PlusConfigure.h"
+#include "vtkPlusBuffer.h"
+#include "vtkPlusDevice.h"
+
+#include <vtkMatrix4x4.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  struct ReaderStatistics
+  {
+    ReaderStatistics() : NumberOfQueries(0), TotalLatencySec(0), MaxLatencySec(0), NumberOfErrors(0) {}
+    long NumberOfQueries;
+    double TotalLatencySec;
+    double MaxLatencySec;
+    int NumberOfErrors;
+  };
+
+  //----------------------------------------------------------------------------
+  void ReaderThread(vtkPlusBuffer* buffer, double framePeriodSec, std::atomic<bool>* stopRequested, ReaderStatistics* stats)
+  {
+    typedef std::chrono::high_resolution_clock Clock;
+    double previousLatestTimestamp = 0;
+    while (!stopRequested->load())
+    {
+      Clock::time_point start = Clock::now();
+      BufferItemUidType latestUid = buffer->GetLatestItemUidInBuffer();
+      double latestTimestamp(0);
+      ItemStatus latestStatus = buffer->GetTimeStamp(latestUid, latestTimestamp);
+      double oldestTimestamp(0);
+      buffer->GetOldestTimeStamp(oldestTimestamp);
+      double latencySec = std::chrono::duration<double>(Clock::now() - start).count();
+
+      stats->NumberOfQueries++;
+      stats->TotalLatencySec += latencySec;
+      stats->MaxLatencySec = std::max(stats->MaxLatencySec, latencySec);
+
+      if (latestUid == 0 || latestStatus != ITEM_OK)
+      {
+        // no items yet or the item has been overwritten since we got its UID
+        continue;
+      }
+      // The writer adds item #N (UID=N) with timestamp N*framePeriodSec, so a mismatch means an inconsistent read
+      if (fabs(latestTimestamp - latestUid * framePeriodSec) > framePeriodSec * 0.1 || latestTimestamp < previousLatestTimestamp)
+      {
+        stats->NumberOfErrors++;
+      }
+      previousLatestTimestamp = latestTimestamp;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  int RunContentionTest(bool lockFreeReads, int numberOfReaders, double durationSec, int bufferSize)
+  {
+    vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    buffer->SetBufferSize(bufferSize);
+    buffer->SetLockFreeReads(lockFreeReads);
+
+    const double framePeriodSec = 0.001;
+    std::atomic<bool> stopRequested(false);
+    std::vector<ReaderStatistics> stats(numberOfReaders);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < numberOfReaders; ++i)
+    {
+      readers.push_back(std::thread(ReaderThread, buffer.GetPointer(), framePeriodSec, &stopRequested, &stats[i]));
+    }
+
+    // Writer: simulate a device thread that adds items with exact timestamps
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    unsigned long frameNumber = 0;
+    double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    while (vtkIGSIOAccurateTimer::GetSystemTime() - startTime < durationSec)
+    {
+      frameNumber++;
+      double timestamp = frameNumber * framePeriodSec;
+      matrix->SetElement(0, 3, frameNumber);
+      buffer->AddTimeStampedItem(matrix, TOOL_OK, frameNumber, timestamp, timestamp);
+      std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+
+    stopRequested = true;
+    for (std::vector<std::thread>::iterator it = readers.begin(); it != readers.end(); ++it)
+    {
+      it->join();
+    }
+
+    long numberOfQueries = 0;
+    double totalLatencySec = 0;
+    double maxLatencySec = 0;
+    int numberOfErrors = 0;
+    for (std::vector<ReaderStatistics>::iterator it = stats.begin(); it != stats.end(); ++it)
+    {
+      numberOfQueries += it->NumberOfQueries;
+      totalLatencySec += it->TotalLatencySec;
+      maxLatencySec = std::max(maxLatencySec, it->MaxLatencySec);
+      numberOfErrors += it->NumberOfErrors;
+    }
+
+    double meanLatencyUs = (numberOfQueries > 0 ? totalLatencySec / numberOfQueries * 1e6 : 0);
+    LOG_INFO((lockFreeReads ? "Lock-free" : "Locked") << " reads, " << numberOfReaders << " reader(s): "
+             << numberOfQueries << " queries, mean latency: " << std::fixed << meanLatencyUs << " us, max latency: "
+             << maxLatencySec * 1e6 << " us, items added: " << frameNumber);
+    if (numberOfErrors > 0)
+    {
+      LOG_ERROR("Readers observed " << numberOfErrors << " inconsistent buffer states (" << (lockFreeReads ? "lock-free" : "locked") << " reads, " << numberOfReaders << " readers)");
+    }
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  double durationSec(1.0);
+  int bufferSize(150);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--duration-sec", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &durationSec, "Duration of each measurement in seconds (Default: 1.0).");
+  args.AddArgument("--buffer-size", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &bufferSize, "Number of items in the buffer (Default: 150).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors = 0;
+  const int numberOfReadersToTest[] = { 1, 4, 16 };
+  for (int i = 0; i < 3; ++i)
+  {
+    numberOfErrors += RunContentionTest(false, numberOfReadersToTest[i], durationSec, bufferSize);
+    numberOfErrors += RunContentionTest(true, numberOfReadersToTest[i], durationSec, bufferSize);
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("vtkPlusBufferContentionTest failed");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("vtkPlusBufferContentionTest completed successfully");
+  return EXIT_SUCCESS;
+}
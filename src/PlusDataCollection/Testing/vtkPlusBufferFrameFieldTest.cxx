@@ -0,0 +1,133 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusBufferFrameFieldTest.cxx
+  \brief Verifies that adding and retrieving frame fields does not allocate memory in steady state.
+
+  Items with a dozen custom fields (similar to what ultrasound devices attach to each frame) are added
+  to a buffer until all the slots of the circular buffer are used, then the allocation counter of the
+  frame field store is checked while more items are added and read from the buffer.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusFrameFieldStore.h"
+#include "vtkPlusBuffer.h"
+
+#include <vtksys/CommandLineArguments.hxx>
+
+#include <cstdio>
+
+namespace
+{
+  const int NUMBER_OF_FIELDS = 12;
+
+  //----------------------------------------------------------------------------
+  void UpdateFields(igsioFieldMapType& fields, unsigned long frameNumber)
+  {
+    for (int i = 0; i < NUMBER_OF_FIELDS; ++i)
+    {
+      char fieldName[32];
+      char fieldValue[32];
+      sprintf(fieldName, "TestField%02d", i);
+      // constant length values, as reported by devices (depth, gain, frequency, ...)
+      sprintf(fieldValue, "%010lu", frameNumber * NUMBER_OF_FIELDS + i);
+      fields[fieldName].first = FRAMEFIELD_NONE;
+      fields[fieldName].second = fieldValue;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  int AddItems(vtkPlusBuffer* buffer, StreamBufferItem& outputItem, igsioFieldMapType& fields, unsigned long& frameNumber, int numberOfItems)
+  {
+    int numberOfErrors = 0;
+    for (int i = 0; i < numberOfItems; ++i)
+    {
+      frameNumber++;
+      UpdateFields(fields, frameNumber);
+      if (buffer->AddItem(fields, frameNumber, frameNumber * 0.01, frameNumber * 0.01) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to add item " << frameNumber);
+        numberOfErrors++;
+        continue;
+      }
+      if (buffer->GetStreamBufferItem(buffer->GetLatestItemUidInBuffer(), &outputItem) != ITEM_OK)
+      {
+        LOG_ERROR("Failed to get item " << frameNumber);
+        numberOfErrors++;
+        continue;
+      }
+      if (outputItem.GetFrameFields().GetNumberOfFields() != NUMBER_OF_FIELDS
+          || outputItem.GetFrameField("TestField03") != fields["TestField03"].second)
+      {
+        LOG_ERROR("Frame fields of item " << frameNumber << " do not match the added fields");
+        numberOfErrors++;
+      }
+    }
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int bufferSize(50);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--buffer-size", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &bufferSize, "Number of items in the buffer (Default: 50).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+  buffer->SetBufferSize(bufferSize);
+
+  StreamBufferItem outputItem;
+  igsioFieldMapType fields;
+  unsigned long frameNumber = 0;
+
+  // Warm up: use each slot of the circular buffer once
+  int numberOfErrors = AddItems(buffer, outputItem, fields, frameNumber, bufferSize + 1);
+  unsigned long long allocationsAfterWarmUp = FrameFieldStore::GetNumberOfAllocations();
+
+  // Steady state: slots are overwritten
+  numberOfErrors += AddItems(buffer, outputItem, fields, frameNumber, bufferSize * 3);
+  unsigned long long steadyStateAllocations = FrameFieldStore::GetNumberOfAllocations() - allocationsAfterWarmUp;
+
+  LOG_INFO("Frame field allocations: " << allocationsAfterWarmUp << " during warm-up, " << steadyStateAllocations << " in steady state (" << bufferSize * 3 << " items)");
+  if (steadyStateAllocations > 0)
+  {
+    LOG_ERROR("Frame field storage allocated memory " << steadyStateAllocations << " times in steady state");
+    numberOfErrors++;
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("vtkPlusBufferFrameFieldTest failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("vtkPlusBufferFrameFieldTest completed successfully");
+  return EXIT_SUCCESS;
+}
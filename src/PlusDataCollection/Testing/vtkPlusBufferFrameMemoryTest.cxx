@@ -0,0 +1,256 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusBufferFrameMemoryTest.cxx
+  \brief Verifies the frame memory of a buffer: contiguous allocation and frames that share the pixels of a slot.
+
+  3D frames are added to a buffer that uses FRAME_MEMORY_ALLOCATION_CONTIGUOUS_LARGE_PAGES allocation
+  and read back, while the buffer is switched between contiguous and default allocation and resized.
+
+  Then frames are read from the buffer with shared image data, the buffer is filled with new frames
+  (so every slot is overwritten) and the shared frames are checked to still contain their original pixels.
+  Assigning into a frame that shares pixels or writing into it after detaching it must not modify the other frames,
+  and frames in contiguous frame memory are always copied.
+*/
+
+#include "PlusConfigure.h"
+#include "vtkPlusBuffer.h"
+
+#include <vtkImageData.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+#include <vector>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  void FillFrame(std::vector<unsigned char>& frame, unsigned long frameNumber)
+  {
+    for (size_t i = 0; i < frame.size(); ++i)
+    {
+      frame[i] = static_cast<unsigned char>((i * 7 + frameNumber * 13) & 0xFF);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  int AddAndVerifyFrames(vtkPlusBuffer* buffer, const FrameSizeType& frameSize, unsigned long& frameNumber, int numberOfFrames)
+  {
+    int numberOfErrors = 0;
+    std::vector<unsigned char> frame(frameSize[0] * frameSize[1] * frameSize[2]);
+    StreamBufferItem outputItem;
+    for (int i = 0; i < numberOfFrames; ++i)
+    {
+      frameNumber++;
+      FillFrame(frame, frameNumber);
+      if (buffer->AddItem(&frame[0], frameSize, static_cast<unsigned int>(frame.size()), US_IMG_BRIGHTNESS, frameNumber, frameNumber * 0.1, frameNumber * 0.1) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to add frame " << frameNumber);
+        numberOfErrors++;
+        continue;
+      }
+      if (buffer->GetStreamBufferItem(buffer->GetLatestItemUidInBuffer(), &outputItem) != ITEM_OK
+          || memcmp(outputItem.GetFrame().GetImage()->GetScalarPointer(), &frame[0], frame.size()) != 0)
+      {
+        LOG_ERROR("Frame " << frameNumber << " read from the buffer does not match the added frame");
+        numberOfErrors++;
+      }
+    }
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus AddFrames(vtkPlusBuffer* buffer, const FrameSizeType& frameSize, unsigned long& frameNumber, int numberOfFrames)
+  {
+    std::vector<unsigned char> frame(frameSize[0] * frameSize[1] * frameSize[2]);
+    for (int i = 0; i < numberOfFrames; ++i)
+    {
+      frameNumber++;
+      FillFrame(frame, frameNumber);
+      if (buffer->AddItem(&frame[0], frameSize, static_cast<unsigned int>(frame.size()), US_IMG_BRIGHTNESS, frameNumber, frameNumber * 0.1, frameNumber * 0.1) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to add frame " << frameNumber);
+        return PLUS_FAIL;
+      }
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  int CheckFramePixels(StreamBufferItem& item, const FrameSizeType& frameSize)
+  {
+    std::vector<unsigned char> expectedFrame(frameSize[0] * frameSize[1] * frameSize[2]);
+    FillFrame(expectedFrame, item.GetIndex());
+    if (memcmp(item.GetFrame().GetImage()->GetScalarPointer(), &expectedFrame[0], expectedFrame.size()) != 0)
+    {
+      LOG_ERROR("Pixels of frame " << item.GetIndex() << " have been modified");
+      return 1;
+    }
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestSharedFrames(vtkPlusBuffer* buffer, const FrameSizeType& frameSize, unsigned long& frameNumber)
+  {
+    const int bufferSize = buffer->GetBufferSize();
+    int numberOfErrors = 0;
+    if (AddFrames(buffer, frameSize, frameNumber, bufferSize) != PLUS_SUCCESS)
+    {
+      return 1;
+    }
+
+    // Frames read with shared image data use the pixels of the buffer slot
+    std::vector<StreamBufferItem> sharedItems(bufferSize);
+    for (int i = 0; i < bufferSize; ++i)
+    {
+      if (buffer->GetStreamBufferItem(buffer->GetOldestItemUidInBuffer() + i, &sharedItems[i], true) != ITEM_OK)
+      {
+        LOG_ERROR("Failed to get item " << i << " from the buffer");
+        return 1;
+      }
+    }
+    StreamBufferItem otherSharedItem;
+    StreamBufferItem copiedItem;
+    buffer->GetStreamBufferItem(buffer->GetOldestItemUidInBuffer(), &otherSharedItem, true);
+    buffer->GetStreamBufferItem(buffer->GetOldestItemUidInBuffer(), &copiedItem);
+    if (otherSharedItem.GetFrame().GetImage()->GetScalarPointer() != sharedItems[0].GetFrame().GetImage()->GetScalarPointer())
+    {
+      LOG_ERROR("Frames read with shared image data do not share the pixels");
+      numberOfErrors++;
+    }
+    if (copiedItem.GetFrame().GetImage()->GetScalarPointer() == sharedItems[0].GetFrame().GetImage()->GetScalarPointer())
+    {
+      LOG_ERROR("Frame read without shared image data shares the pixels");
+      numberOfErrors++;
+    }
+
+    // Assigning a frame into a frame that shares pixels does not modify the other frames
+    otherSharedItem = sharedItems[1];
+    numberOfErrors += CheckFramePixels(sharedItems[0], frameSize);
+    numberOfErrors += CheckFramePixels(otherSharedItem, frameSize);
+
+    // Writing into a frame that shares pixels after detaching it (as in-place writers do) does not modify the other frames
+    StreamBufferItem writtenItem;
+    buffer->GetStreamBufferItem(buffer->GetOldestItemUidInBuffer(), &writtenItem, true);
+    PlusCommon::DetachFrameImage(writtenItem.GetFrame());
+    if (writtenItem.GetFrame().GetImage()->GetScalarPointer() == sharedItems[0].GetFrame().GetImage()->GetScalarPointer())
+    {
+      LOG_ERROR("Detached frame still shares the pixels");
+      numberOfErrors++;
+    }
+    memset(writtenItem.GetFrame().GetImage()->GetScalarPointer(), 0, frameSize[0] * frameSize[1] * frameSize[2]);
+    numberOfErrors += CheckFramePixels(sharedItems[0], frameSize);
+
+    // Overwriting all slots keeps the pixels of the frames that have been read
+    if (AddFrames(buffer, frameSize, frameNumber, bufferSize * 2) != PLUS_SUCCESS)
+    {
+      return numberOfErrors + 1;
+    }
+    for (int i = 0; i < bufferSize; ++i)
+    {
+      numberOfErrors += CheckFramePixels(sharedItems[i], frameSize);
+    }
+    StreamBufferItem latestItem;
+    buffer->GetLatestStreamBufferItem(&latestItem);
+    numberOfErrors += CheckFramePixels(latestItem, frameSize);
+
+    // Pixels in contiguous frame memory are copied
+    if (buffer->SetFrameMemoryAllocation(vtkPlusBuffer::FRAME_MEMORY_ALLOCATION_CONTIGUOUS_LARGE_PAGES) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to enable contiguous frame memory allocation");
+      numberOfErrors++;
+    }
+    AddFrames(buffer, frameSize, frameNumber, bufferSize);
+    StreamBufferItem contiguousItem;
+    StreamBufferItem otherContiguousItem;
+    buffer->GetStreamBufferItem(buffer->GetLatestItemUidInBuffer(), &contiguousItem, true);
+    buffer->GetStreamBufferItem(buffer->GetLatestItemUidInBuffer(), &otherContiguousItem, true);
+    if (contiguousItem.GetFrame().GetImage()->GetScalarPointer() == otherContiguousItem.GetFrame().GetImage()->GetScalarPointer())
+    {
+      LOG_ERROR("Pixels in contiguous frame memory are shared");
+      numberOfErrors++;
+    }
+    AddFrames(buffer, frameSize, frameNumber, bufferSize);
+    numberOfErrors += CheckFramePixels(contiguousItem, frameSize);
+
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int bufferSize(20);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--buffer-size", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &bufferSize, "Number of items in the buffer (Default: 20).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  FrameSizeType frameSize = { 64, 48, 16 };
+  vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+  buffer->SetBufferSize(bufferSize);
+  buffer->SetPixelType(VTK_UNSIGNED_CHAR);
+  buffer->SetNumberOfScalarComponents(1);
+  buffer->SetImageType(US_IMG_BRIGHTNESS);
+  buffer->SetFrameSize(frameSize);
+
+  int numberOfErrors = 0;
+  if (buffer->SetFrameMemoryAllocation(vtkPlusBuffer::FRAME_MEMORY_ALLOCATION_CONTIGUOUS_LARGE_PAGES) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to enable contiguous frame memory allocation");
+    numberOfErrors++;
+  }
+
+  unsigned long frameNumber = 0;
+  numberOfErrors += AddAndVerifyFrames(buffer, frameSize, frameNumber, bufferSize * 2);
+
+  // Resizing the buffer and changing the frame size reallocates the region
+  buffer->SetBufferSize(bufferSize / 2);
+  numberOfErrors += AddAndVerifyFrames(buffer, frameSize, frameNumber, bufferSize);
+  FrameSizeType largerFrameSize = { 128, 96, 16 };
+  buffer->SetFrameSize(largerFrameSize);
+  numberOfErrors += AddAndVerifyFrames(buffer, largerFrameSize, frameNumber, bufferSize);
+
+  // Switching back to default allocation keeps the frames usable
+  if (buffer->SetFrameMemoryAllocation(vtkPlusBuffer::FRAME_MEMORY_ALLOCATION_DEFAULT) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to switch to default frame memory allocation");
+    numberOfErrors++;
+  }
+  numberOfErrors += AddAndVerifyFrames(buffer, largerFrameSize, frameNumber, bufferSize);
+
+  // Frames read with shared image data (default allocation, then contiguous)
+  numberOfErrors += TestSharedFrames(buffer, largerFrameSize, frameNumber);
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("vtkPlusBufferFrameMemoryTest failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("vtkPlusBufferFrameMemoryTest completed successfully");
+  return EXIT_SUCCESS;
+}
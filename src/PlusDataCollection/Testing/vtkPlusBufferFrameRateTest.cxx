@@ -0,0 +1,237 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusBufferFrameRateTest.cxx
+  \brief Verifies and benchmarks the incremental frame rate statistics of vtkPlusBuffer.
+
+  Items with jittered timestamps and occasionally skipped frame numbers are added to the buffer and
+  after each item the incrementally maintained frame period statistics are compared to a reference
+  that iterates through all the items in the buffer (the way GetFrameRate worked before the statistics
+  were maintained on insertion). The comparison is repeated with a time window and after the
+  buffer is resized and cleared.
+*/
+
+#include "PlusConfigure.h"
+#include "vtkPlusBuffer.h"
+#include "vtkPlusDevice.h"
+
+#include <vtkMatrix4x4.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Reference implementation: compute the statistics from the frame periods of all the items in the buffer
+  bool GetReferenceFramePeriodStatistics(vtkPlusBuffer* buffer, bool ideal, double windowSec, vtkPlusTimestampedCircularBuffer::FramePeriodStatistics& statistics)
+  {
+    double latestTimestamp(0);
+    if (buffer->GetNumberOfItems() < 1 || buffer->GetLatestTimeStamp(latestTimestamp) != ITEM_OK)
+    {
+      return false;
+    }
+    std::vector<double> framePeriods;
+    for (BufferItemUidType frame = buffer->GetLatestItemUidInBuffer(); frame > buffer->GetOldestItemUidInBuffer(); --frame)
+    {
+      double time(0), prevtime(0);
+      unsigned long framenum(0), prevframenum(0);
+      if (buffer->GetTimeStamp(frame, time) != ITEM_OK || buffer->GetIndex(frame, framenum) != ITEM_OK
+          || buffer->GetTimeStamp(frame - 1, prevtime) != ITEM_OK || buffer->GetIndex(frame - 1, prevframenum) != ITEM_OK)
+      {
+        continue;
+      }
+      if (windowSec > 0 && time < latestTimestamp - windowSec)
+      {
+        continue;
+      }
+      double framePeriod = time - prevtime;
+      int frameDiff = framenum - prevframenum;
+      if (ideal && frameDiff > 0)
+      {
+        framePeriod /= (1.0 * frameDiff);
+      }
+      framePeriods.push_back(framePeriod);
+    }
+    if (framePeriods.empty())
+    {
+      return false;
+    }
+
+    statistics.NumberOfSamples = framePeriods.size();
+    statistics.MeanSec = 0;
+    for (unsigned int i = 0; i < framePeriods.size(); ++i)
+    {
+      statistics.MeanSec += framePeriods[i];
+    }
+    statistics.MeanSec /= statistics.NumberOfSamples;
+    double sumOfXiMeanDiffSquare = 0;
+    for (unsigned int i = 0; i < framePeriods.size(); ++i)
+    {
+      sumOfXiMeanDiffSquare += (framePeriods[i] - statistics.MeanSec) * (framePeriods[i] - statistics.MeanSec);
+    }
+    statistics.StdevSec = sqrt(sumOfXiMeanDiffSquare / statistics.NumberOfSamples);
+    statistics.MinimumSec = *std::min_element(framePeriods.begin(), framePeriods.end());
+    statistics.MaximumSec = *std::max_element(framePeriods.begin(), framePeriods.end());
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  int CompareStatistics(vtkPlusBuffer* buffer, double windowSec, const std::string& stage)
+  {
+    int numberOfErrors = 0;
+    for (int ideal = 0; ideal < 2; ++ideal)
+    {
+      vtkPlusTimestampedCircularBuffer::FramePeriodStatistics referenceStatistics;
+      bool referenceValid = GetReferenceFramePeriodStatistics(buffer, ideal != 0, windowSec, referenceStatistics);
+      vtkPlusTimestampedCircularBuffer::FramePeriodStatistics statistics;
+      bool valid = (buffer->GetFramePeriodStatistics(ideal != 0, statistics) == PLUS_SUCCESS);
+      if (valid != referenceValid)
+      {
+        LOG_ERROR(stage << ": statistics are " << (valid ? "available" : "not available") << ", expected " << (referenceValid ? "available" : "not available"));
+        numberOfErrors++;
+        continue;
+      }
+      if (!valid)
+      {
+        continue;
+      }
+      if (statistics.NumberOfSamples != referenceStatistics.NumberOfSamples
+          || fabs(statistics.MeanSec - referenceStatistics.MeanSec) > 1e-9
+          || fabs(statistics.StdevSec - referenceStatistics.StdevSec) > 1e-6
+          || statistics.MinimumSec != referenceStatistics.MinimumSec
+          || statistics.MaximumSec != referenceStatistics.MaximumSec)
+      {
+        LOG_ERROR(stage << (ideal ? " (ideal)" : "") << ": statistics mismatch: samples=" << statistics.NumberOfSamples << " mean=" << statistics.MeanSec
+                  << " stdev=" << statistics.StdevSec << " min=" << statistics.MinimumSec << " max=" << statistics.MaximumSec
+                  << ", expected samples=" << referenceStatistics.NumberOfSamples << " mean=" << referenceStatistics.MeanSec
+                  << " stdev=" << referenceStatistics.StdevSec << " min=" << referenceStatistics.MinimumSec << " max=" << referenceStatistics.MaximumSec);
+        numberOfErrors++;
+      }
+    }
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int RunFrameRateTest(int bufferSize, double windowSec, int numberOfQueries)
+  {
+    typedef std::chrono::high_resolution_clock Clock;
+    int numberOfErrors = 0;
+
+    vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    buffer->SetBufferSize(bufferSize);
+    buffer->SetFrameRateStatisticsWindowSec(windowSec);
+
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    const double framePeriodSec = 0.01;
+    double timestamp = 100.0;
+    unsigned long frameNumber = 0;
+    for (int i = 0; i < bufferSize * 3; ++i)
+    {
+      timestamp += framePeriodSec * (0.5 + static_cast<double>(rand()) / RAND_MAX);
+      // simulate dropped frames
+      frameNumber += (rand() % 10 == 0) ? 2 : 1;
+      buffer->AddTimeStampedItem(matrix, TOOL_OK, frameNumber, timestamp, timestamp);
+      if (i % 17 == 0)
+      {
+        numberOfErrors += CompareStatistics(buffer, windowSec, "Fill");
+      }
+    }
+    numberOfErrors += CompareStatistics(buffer, windowSec, "Filled");
+
+    // Measure
+    vtkPlusTimestampedCircularBuffer::FramePeriodStatistics referenceStatistics;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < numberOfQueries; ++i)
+    {
+      GetReferenceFramePeriodStatistics(buffer, false, windowSec, referenceStatistics);
+    }
+    double referenceUs = std::chrono::duration<double>(Clock::now() - start).count() * 1e6 / numberOfQueries;
+
+    vtkPlusTimestampedCircularBuffer::FramePeriodStatistics statistics;
+    start = Clock::now();
+    for (int i = 0; i < numberOfQueries; ++i)
+    {
+      buffer->GetFramePeriodStatistics(false, statistics);
+    }
+    double incrementalUs = std::chrono::duration<double>(Clock::now() - start).count() * 1e6 / numberOfQueries;
+
+    LOG_INFO("Buffer size " << bufferSize << ", window " << windowSec << " sec: reference " << std::fixed << referenceUs << " us, incremental " << incrementalUs
+             << " us; frame rate " << buffer->GetFrameRate() << " fps, ideal frame rate " << buffer->GetFrameRate(true) << " fps");
+
+    // Frame periods of removed items must be removed from the statistics
+    buffer->SetBufferSize(bufferSize / 2);
+    numberOfErrors += CompareStatistics(buffer, windowSec, "Shrunk");
+    for (int i = 0; i < bufferSize; ++i)
+    {
+      timestamp += framePeriodSec * (0.5 + static_cast<double>(rand()) / RAND_MAX);
+      buffer->AddTimeStampedItem(matrix, TOOL_OK, ++frameNumber, timestamp, timestamp);
+    }
+    numberOfErrors += CompareStatistics(buffer, windowSec, "Refilled");
+
+    buffer->Clear();
+    numberOfErrors += CompareStatistics(buffer, windowSec, "Cleared");
+    buffer->AddTimeStampedItem(matrix, TOOL_OK, ++frameNumber, timestamp + 1.0, timestamp + 1.0);
+    buffer->AddTimeStampedItem(matrix, TOOL_OK, ++frameNumber, timestamp + 1.0 + framePeriodSec, timestamp + 1.0 + framePeriodSec);
+    numberOfErrors += CompareStatistics(buffer, windowSec, "Restarted");
+
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int numberOfQueries(1000);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--number-of-queries", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfQueries, "Number of queries for each measurement (Default: 1000).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors = 0;
+  const int bufferSizesToTest[] = { 50, 1000 };
+  const double windowsSecToTest[] = { 0, 0.5 };
+  for (int i = 0; i < 2; ++i)
+  {
+    for (int j = 0; j < 2; ++j)
+    {
+      numberOfErrors += RunFrameRateTest(bufferSizesToTest[i], windowsSecToTest[j], numberOfQueries);
+    }
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("vtkPlusBufferFrameRateTest failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("vtkPlusBufferFrameRateTest completed successfully");
+  return EXIT_SUCCESS;
+}
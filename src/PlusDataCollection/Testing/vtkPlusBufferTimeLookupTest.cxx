@@ -0,0 +1,190 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusBufferTimeLookupTest.cxx
+  \brief Verifies and benchmarks the timestamp to item UID lookup of vtkPlusBuffer.
+
+  Buffers of 50, 1000 and 10000 items are filled with jittered timestamps. The indexed lookup
+  (GetItemUidFromTime) is compared to a reference binary search that reads the item timestamps
+  one by one (the way the lookup worked before the timestamp index was introduced), both for
+  random requests and for the common near-latest requests.
+*/
+
+#include "PlusConfigure.h"
+#include "vtkPlusBuffer.h"
+#include "vtkPlusDevice.h"
+
+#include <vtkMatrix4x4.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Reference implementation: binary search by querying the timestamp of each probed item
+  ItemStatus GetReferenceItemUidFromTime(vtkPlusBuffer* buffer, double time, BufferItemUidType& uid)
+  {
+    BufferItemUidType lo = buffer->GetOldestItemUidInBuffer();
+    BufferItemUidType hi = buffer->GetLatestItemUidInBuffer();
+    double tlo(0), thi(0);
+    if (buffer->GetTimeStamp(lo, tlo) != ITEM_OK || buffer->GetTimeStamp(hi, thi) != ITEM_OK)
+    {
+      return ITEM_UNKNOWN_ERROR;
+    }
+    if (time < tlo || time > thi)
+    {
+      return ITEM_UNKNOWN_ERROR;
+    }
+    while (hi - lo > 1)
+    {
+      BufferItemUidType mid = lo + (hi - lo) / 2;
+      double tmid(0);
+      buffer->GetTimeStamp(mid, tmid);
+      if (time < tmid)
+      {
+        hi = mid;
+        thi = tmid;
+      }
+      else
+      {
+        lo = mid;
+        tlo = tmid;
+      }
+    }
+    uid = (time - tlo > thi - time) ? hi : lo;
+    return ITEM_OK;
+  }
+
+  //----------------------------------------------------------------------------
+  int RunLookupTest(int bufferSize, int numberOfQueries)
+  {
+    typedef std::chrono::high_resolution_clock Clock;
+    int numberOfErrors = 0;
+
+    vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    buffer->SetBufferSize(bufferSize);
+
+    // Fill the buffer twice so that the items wrap around in the circular buffer
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    const double framePeriodSec = 0.01;
+    double timestamp = 100.0;
+    for (unsigned long frameNumber = 0; frameNumber < static_cast<unsigned long>(bufferSize) * 2 + bufferSize / 3; ++frameNumber)
+    {
+      timestamp += framePeriodSec * (0.5 + static_cast<double>(rand()) / RAND_MAX);
+      buffer->AddTimeStampedItem(matrix, TOOL_OK, frameNumber, timestamp, timestamp);
+    }
+
+    double oldestTimestamp(0), latestTimestamp(0);
+    buffer->GetOldestTimeStamp(oldestTimestamp);
+    buffer->GetLatestTimeStamp(latestTimestamp);
+
+    std::vector<double> randomTimes(numberOfQueries);
+    std::vector<double> recentTimes(numberOfQueries);
+    for (int i = 0; i < numberOfQueries; ++i)
+    {
+      randomTimes[i] = oldestTimestamp + (latestTimestamp - oldestTimestamp) * static_cast<double>(rand()) / RAND_MAX;
+      recentTimes[i] = latestTimestamp - framePeriodSec * 2.0 * static_cast<double>(rand()) / RAND_MAX;
+    }
+
+    // Verify that the indexed lookup returns the same items as the reference
+    for (int i = 0; i < numberOfQueries; ++i)
+    {
+      BufferItemUidType uid(0), referenceUid(0);
+      if (buffer->GetItemUidFromTime(randomTimes[i], uid) != ITEM_OK
+          || GetReferenceItemUidFromTime(buffer, randomTimes[i], referenceUid) != ITEM_OK
+          || uid != referenceUid)
+      {
+        LOG_ERROR("Lookup mismatch for time " << std::fixed << randomTimes[i] << " in buffer of size " << bufferSize << ": UID=" << uid << ", expected UID=" << referenceUid);
+        numberOfErrors++;
+      }
+    }
+
+    // Measure
+    BufferItemUidType uid(0);
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < numberOfQueries; ++i)
+    {
+      GetReferenceItemUidFromTime(buffer, randomTimes[i], uid);
+    }
+    double referenceRandomUs = std::chrono::duration<double>(Clock::now() - start).count() * 1e6 / numberOfQueries;
+
+    start = Clock::now();
+    for (int i = 0; i < numberOfQueries; ++i)
+    {
+      buffer->GetItemUidFromTime(randomTimes[i], uid);
+    }
+    double indexedRandomUs = std::chrono::duration<double>(Clock::now() - start).count() * 1e6 / numberOfQueries;
+
+    start = Clock::now();
+    for (int i = 0; i < numberOfQueries; ++i)
+    {
+      GetReferenceItemUidFromTime(buffer, recentTimes[i], uid);
+    }
+    double referenceRecentUs = std::chrono::duration<double>(Clock::now() - start).count() * 1e6 / numberOfQueries;
+
+    start = Clock::now();
+    for (int i = 0; i < numberOfQueries; ++i)
+    {
+      buffer->GetItemUidFromTime(recentTimes[i], uid);
+    }
+    double indexedRecentUs = std::chrono::duration<double>(Clock::now() - start).count() * 1e6 / numberOfQueries;
+
+    LOG_INFO("Buffer size " << bufferSize << ": random requests: reference " << std::fixed << referenceRandomUs << " us, indexed " << indexedRandomUs
+             << " us; near-latest requests: reference " << referenceRecentUs << " us, indexed " << indexedRecentUs << " us");
+
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int numberOfQueries(10000);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--number-of-queries", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfQueries, "Number of lookups for each measurement (Default: 10000).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors = 0;
+  const int bufferSizesToTest[] = { 50, 1000, 10000 };
+  for (int i = 0; i < 3; ++i)
+  {
+    numberOfErrors += RunLookupTest(bufferSizesToTest[i], numberOfQueries);
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("vtkPlusBufferTimeLookupTest failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("vtkPlusBufferTimeLookupTest completed successfully");
+  return EXIT_SUCCESS;
+}
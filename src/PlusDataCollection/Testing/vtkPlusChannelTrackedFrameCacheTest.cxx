@@ -0,0 +1,365 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusChannelTrackedFrameCacheTest.cxx
+  \brief Verifies the tracked frame cache and the tracked frame references of vtkPlusChannel.
+
+  Tracked frames are requested repeatedly from a channel with one tool. The number of cache hits and misses,
+  eviction of the least recently used frame, and invalidation of the cache when the channel is cleared are checked.
+  With a field data source the cache is checked to be invalidated by new field data items, and cached frames are
+  checked to be merged into the requested frames without sharing the fields of one consumer with the others.
+
+  Then frame references are sampled from the channel and compared to the frames that are returned by
+  GetTrackedFrameListSampled. The buffer is overwritten and cleared and the references of the removed
+  frames are checked to be reported as not available anymore.
+*/
+
+#include "PlusConfigure.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataSource.h"
+
+#include <igsioTrackedFrame.h>
+#include <vtkIGSIOTrackedFrameList.h>
+#include <vtkMatrix4x4.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+namespace
+{
+  const double FRAME_PERIOD_SEC = 0.1;
+
+  //----------------------------------------------------------------------------
+  PlusStatus AddToolItems(vtkPlusDataSource* tool, int firstItem, int numberOfItems, double translationOffset)
+  {
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    for (int i = firstItem; i < firstItem + numberOfItems; ++i)
+    {
+      matrix->SetElement(0, 3, translationOffset + i);
+      if (tool->AddTimeStampedItem(matrix, TOOL_OK, i, i * FRAME_PERIOD_SEC, i * FRAME_PERIOD_SEC) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to add item " << i << " to the tool buffer");
+        return PLUS_FAIL;
+      }
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus GetTranslation(igsioTrackedFrame& trackedFrame, double& translation)
+  {
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    if (trackedFrame.GetFrameTransform(igsioTransformName("Probe", "Tracker"), matrix) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Tracked frame at " << trackedFrame.GetTimestamp() << " does not contain the tool transform");
+      return PLUS_FAIL;
+    }
+    translation = matrix->GetElement(0, 3);
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  int CheckTranslation(vtkPlusChannel* channel, double timestamp, double expectedTranslation)
+  {
+    igsioTrackedFrame trackedFrame;
+    if (channel->GetTrackedFrame(timestamp, trackedFrame) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to get tracked frame at " << timestamp);
+      return 1;
+    }
+    double translation = 0;
+    if (GetTranslation(trackedFrame, translation) != PLUS_SUCCESS)
+    {
+      return 1;
+    }
+    if (fabs(translation - expectedTranslation) > 1e-6)
+    {
+      LOG_ERROR("Unexpected translation at " << timestamp << ": " << translation << " (expected: " << expectedTranslation << ")");
+      return 1;
+    }
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  int CheckStatistics(vtkPlusChannel* channel, unsigned long expectedHits, unsigned long expectedMisses)
+  {
+    unsigned long hits(0);
+    unsigned long misses(0);
+    channel->GetTrackedFrameCacheStatistics(hits, misses);
+    if (hits != expectedHits || misses != expectedMisses)
+    {
+      LOG_ERROR("Unexpected cache statistics: " << hits << " hits, " << misses << " misses (expected: " << expectedHits << " hits, " << expectedMisses << " misses)");
+      return 1;
+    }
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestTrackedFrameReferences(vtkPlusChannel* channel, vtkPlusDataSource* tool)
+  {
+    int numberOfErrors = 0;
+    channel->Clear();
+    if (AddToolItems(tool, 0, 10, 0.0) != PLUS_SUCCESS)
+    {
+      return 1;
+    }
+
+    // Sample the same period as references and as a tracked frame list
+    const double samplingPeriodSec = 2 * FRAME_PERIOD_SEC;
+    double lastReferenceTimestamp = UNDEFINED_TIMESTAMP;
+    double nextReferenceTimestamp = 3 * FRAME_PERIOD_SEC;
+    std::vector<vtkPlusChannel::TrackedFrameReference> references;
+    if (channel->GetTrackedFrameReferencesSampled(lastReferenceTimestamp, nextReferenceTimestamp, references, samplingPeriodSec) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to sample tracked frame references");
+      numberOfErrors++;
+    }
+    double lastFrameTimestamp = UNDEFINED_TIMESTAMP;
+    double nextFrameTimestamp = 3 * FRAME_PERIOD_SEC;
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    if (channel->GetTrackedFrameListSampled(lastFrameTimestamp, nextFrameTimestamp, trackedFrameList, samplingPeriodSec) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to sample tracked frame list");
+      numberOfErrors++;
+    }
+
+    if (references.empty() || references.size() != trackedFrameList->GetNumberOfTrackedFrames()
+        || lastReferenceTimestamp != lastFrameTimestamp || nextReferenceTimestamp != nextFrameTimestamp)
+    {
+      LOG_ERROR("Sampled " << references.size() << " references (last: " << lastReferenceTimestamp << ", next: " << nextReferenceTimestamp << ") and "
+                << trackedFrameList->GetNumberOfTrackedFrames() << " frames (last: " << lastFrameTimestamp << ", next: " << nextFrameTimestamp << ")");
+      return numberOfErrors + 1;
+    }
+    for (unsigned int i = 0; i < references.size(); ++i)
+    {
+      igsioTrackedFrame trackedFrame;
+      if (channel->GetReferencedTrackedFrame(references[i], trackedFrame) != ITEM_OK)
+      {
+        LOG_ERROR("Failed to get referenced tracked frame " << i);
+        numberOfErrors++;
+        continue;
+      }
+      igsioTrackedFrame* expectedTrackedFrame = trackedFrameList->GetTrackedFrame(i);
+      double translation = 0;
+      double expectedTranslation = 0;
+      if (GetTranslation(trackedFrame, translation) != PLUS_SUCCESS || GetTranslation(*expectedTrackedFrame, expectedTranslation) != PLUS_SUCCESS
+          || trackedFrame.GetTimestamp() != expectedTrackedFrame->GetTimestamp() || translation != expectedTranslation)
+      {
+        LOG_ERROR("Referenced tracked frame " << i << " at " << trackedFrame.GetTimestamp() << " does not match the sampled frame at " << expectedTrackedFrame->GetTimestamp());
+        numberOfErrors++;
+      }
+    }
+
+    // Frames that are removed from the buffer are reported as not available anymore
+    if (AddToolItems(tool, 10, tool->GetBufferSize(), 0.0) != PLUS_SUCCESS)
+    {
+      return numberOfErrors + 1;
+    }
+    if (channel->GetTrackedFrameReferenceStatus(references.front()) != ITEM_NOT_AVAILABLE_ANYMORE)
+    {
+      LOG_ERROR("Reference to an overwritten frame is reported as available");
+      numberOfErrors++;
+    }
+    igsioTrackedFrame evictedTrackedFrame;
+    if (channel->GetReferencedTrackedFrame(references.front(), evictedTrackedFrame) != ITEM_NOT_AVAILABLE_ANYMORE)
+    {
+      LOG_ERROR("Overwritten frame is returned");
+      numberOfErrors++;
+    }
+
+    // UIDs restart after clearing the buffer, but the references must not point to the new items
+    std::vector<vtkPlusChannel::TrackedFrameReference> latestReferences;
+    double lastLatestTimestamp = UNDEFINED_TIMESTAMP;
+    double nextLatestTimestamp = (tool->GetBufferSize() + 5) * FRAME_PERIOD_SEC;
+    channel->GetTrackedFrameReferencesSampled(lastLatestTimestamp, nextLatestTimestamp, latestReferences, samplingPeriodSec);
+    if (latestReferences.empty() || channel->GetTrackedFrameReferenceStatus(latestReferences.back()) != ITEM_OK)
+    {
+      LOG_ERROR("Reference to a frame that is still in the buffer is reported as not available");
+      return numberOfErrors + 1;
+    }
+    channel->Clear();
+    if (AddToolItems(tool, 0, 10, 100.0) != PLUS_SUCCESS)
+    {
+      return numberOfErrors + 1;
+    }
+    if (channel->GetTrackedFrameReferenceStatus(latestReferences.back()) != ITEM_NOT_AVAILABLE_ANYMORE)
+    {
+      LOG_ERROR("Reference to a frame that was cleared is reported as available");
+      numberOfErrors++;
+    }
+
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus AddFieldItem(vtkPlusDataSource* fieldSource, long frameNumber, double timestamp, const std::string& value)
+  {
+    igsioFieldMapType fields;
+    fields["Status"].first = FRAMEFIELD_NONE;
+    fields["Status"].second = value;
+    if (fieldSource->AddItem(fields, frameNumber, timestamp, timestamp) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to add item " << frameNumber << " to the field data buffer");
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  int CheckField(igsioTrackedFrame& trackedFrame, const std::string& fieldName, const std::string& expectedValue)
+  {
+    std::string value = trackedFrame.IsFrameFieldDefined(fieldName) ? trackedFrame.GetFrameField(fieldName) : std::string("(undefined)");
+    if (value != expectedValue)
+    {
+      LOG_ERROR("Unexpected " << fieldName << " field value at " << trackedFrame.GetTimestamp() << ": " << value << " (expected: " << expectedValue << ")");
+      return 1;
+    }
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestFieldDataSource(vtkPlusChannel* channel, vtkPlusDataSource* tool)
+  {
+    int numberOfErrors = 0;
+    channel->SetTrackedFrameCacheSize(2);
+    channel->Clear();
+    if (AddToolItems(tool, 0, 10, 0.0) != PLUS_SUCCESS)
+    {
+      return 1;
+    }
+    vtkSmartPointer<vtkPlusDataSource> fieldSource = vtkSmartPointer<vtkPlusDataSource>::New();
+    fieldSource->SetId("Status");
+    fieldSource->SetBufferSize(10);
+    if (AddFieldItem(fieldSource, 0, 2 * FRAME_PERIOD_SEC, "First") != PLUS_SUCCESS)
+    {
+      return 1;
+    }
+
+    // Frames that were assembled without the field data source are not used anymore
+    numberOfErrors += CheckTranslation(channel, 5 * FRAME_PERIOD_SEC, 5.0);
+    channel->AddFieldDataSource(fieldSource);
+    igsioTrackedFrame trackedFrame;
+    channel->GetTrackedFrame(5 * FRAME_PERIOD_SEC, trackedFrame);
+    numberOfErrors += CheckField(trackedFrame, "Status", "First");
+
+    // Cached frames are merged into the requested frame: its own fields are kept and are not added to the cache
+    igsioTrackedFrame callerTrackedFrame;
+    callerTrackedFrame.SetFrameField("CallerField", "CallerValue");
+    unsigned long hits(0);
+    unsigned long misses(0);
+    channel->GetTrackedFrameCacheStatistics(hits, misses);
+    channel->GetTrackedFrame(5 * FRAME_PERIOD_SEC, callerTrackedFrame);
+    numberOfErrors += CheckStatistics(channel, hits + 1, misses);
+    numberOfErrors += CheckField(callerTrackedFrame, "CallerField", "CallerValue");
+    numberOfErrors += CheckField(callerTrackedFrame, "Status", "First");
+    igsioTrackedFrame otherTrackedFrame;
+    channel->GetTrackedFrame(5 * FRAME_PERIOD_SEC, otherTrackedFrame);
+    numberOfErrors += CheckStatistics(channel, hits + 2, misses);
+    numberOfErrors += CheckField(otherTrackedFrame, "CallerField", "(undefined)");
+
+    // A new field data item may be closer to the timestamp, so the frame is assembled again
+    if (AddFieldItem(fieldSource, 1, 5 * FRAME_PERIOD_SEC, "Second") != PLUS_SUCCESS)
+    {
+      return numberOfErrors + 1;
+    }
+    igsioTrackedFrame updatedTrackedFrame;
+    channel->GetTrackedFrame(5 * FRAME_PERIOD_SEC, updatedTrackedFrame);
+    numberOfErrors += CheckStatistics(channel, hits + 2, misses + 1);
+    numberOfErrors += CheckField(updatedTrackedFrame, "Status", "Second");
+
+    channel->RemoveFieldDataSource(fieldSource->GetId());
+    channel->SetTrackedFrameCacheSize(0);
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  vtkSmartPointer<vtkPlusDataSource> tool = vtkSmartPointer<vtkPlusDataSource>::New();
+  tool->SetId("ProbeToTracker");
+  tool->SetBufferSize(50);
+  vtkSmartPointer<vtkPlusChannel> channel = vtkSmartPointer<vtkPlusChannel>::New();
+  channel->AddTool(tool);
+  channel->SetTrackedFrameCacheSize(2);
+
+  int numberOfErrors = 0;
+  if (AddToolItems(tool, 0, 10, 0.0) != PLUS_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Repeated requests at the same timestamp are served from the cache
+  numberOfErrors += CheckTranslation(channel, 2.5 * FRAME_PERIOD_SEC, 2.5);
+  numberOfErrors += CheckTranslation(channel, 2.5 * FRAME_PERIOD_SEC, 2.5);
+  numberOfErrors += CheckStatistics(channel, 1, 1);
+
+  // Tracked frames without image data are cached separately
+  igsioTrackedFrame trackedFrame;
+  channel->GetTrackedFrame(2.5 * FRAME_PERIOD_SEC, trackedFrame, false);
+  numberOfErrors += CheckStatistics(channel, 1, 2);
+
+  // The least recently used frame is dropped when the cache is full
+  numberOfErrors += CheckTranslation(channel, 4 * FRAME_PERIOD_SEC, 4.0);
+  numberOfErrors += CheckTranslation(channel, 2.5 * FRAME_PERIOD_SEC, 2.5);
+  numberOfErrors += CheckStatistics(channel, 1, 4);
+  numberOfErrors += CheckTranslation(channel, 4 * FRAME_PERIOD_SEC, 4.0);
+  numberOfErrors += CheckStatistics(channel, 2, 4);
+
+  // Clearing the channel invalidates the cache, frames at the same timestamps are assembled from the new data
+  channel->Clear();
+  if (AddToolItems(tool, 0, 10, 100.0) != PLUS_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+  numberOfErrors += CheckTranslation(channel, 2.5 * FRAME_PERIOD_SEC, 102.5);
+  numberOfErrors += CheckStatistics(channel, 2, 5);
+
+  // Disabled cache
+  channel->SetTrackedFrameCacheSize(0);
+  numberOfErrors += CheckTranslation(channel, 2.5 * FRAME_PERIOD_SEC, 102.5);
+  numberOfErrors += CheckStatistics(channel, 2, 5);
+
+  LOG_INFO("Tracked frame cache hit rate: " << channel->GetTrackedFrameCacheHitRate() * 100.0 << "%");
+
+  // Frames with fields of a field data source
+  numberOfErrors += TestFieldDataSource(channel, tool);
+
+  // Tracked frame references
+  numberOfErrors += TestTrackedFrameReferences(channel, tool);
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("vtkPlusChannelTrackedFrameCacheTest failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("vtkPlusChannelTrackedFrameCacheTest completed successfully");
+  return EXIT_SUCCESS;
+}
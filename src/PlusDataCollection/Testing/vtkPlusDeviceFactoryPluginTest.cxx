@@ -0,0 +1,167 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusDeviceFactoryPluginTest.cxx
+  \brief Tests that vtkPlusDeviceFactory creates devices of plugin modules and only loads the modules on demand.
+
+  The directory of the test plugin module (PlusDevicePluginTestDevice.cxx) is added to the plugin directories.
+  The device type of the plugin must be listed by a new factory without loading the module, the module must be
+  loaded when a device of its type is created, and other factories must create the device from the loaded module.
+*/
+
+#include "PlusConfigure.h"
+#include "vtkPlusDevice.h"
+#include "vtkPlusDeviceFactory.h"
+
+// VTK includes
+#include <vtkSmartPointer.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+namespace
+{
+  const char* PLUGIN_DEVICE_TYPE = "PluginTestDevice";
+  const char* PLUGIN_DEVICE_CLASS_NAME = "vtkPlusPluginTestDevice";
+
+  //----------------------------------------------------------------------------
+  /*! Factory that reports whether a device type is registered or is waiting for its plugin module to be loaded */
+  class vtkPlusDeviceFactoryTester : public vtkPlusDeviceFactory
+  {
+  public:
+    static vtkPlusDeviceFactoryTester* New()
+    {
+      return new vtkPlusDeviceFactoryTester;
+    }
+
+    bool IsDeviceTypeRegistered(const std::string& deviceTypeName) const
+    {
+      return this->DeviceTypes.find(deviceTypeName) != this->DeviceTypes.end();
+    }
+
+    bool IsDevicePluginPending(const std::string& deviceTypeName) const
+    {
+      return this->DevicePluginModules.find(deviceTypeName) != this->DevicePluginModules.end();
+    }
+  };
+
+  //----------------------------------------------------------------------------
+  int CreatePluginDevice(vtkPlusDeviceFactoryTester* factory, const std::string& deviceId)
+  {
+    vtkPlusDevice* device = NULL;
+    if (factory->CreateInstance(PLUGIN_DEVICE_TYPE, device, deviceId) != PLUS_SUCCESS || device == NULL)
+    {
+      LOG_ERROR("Failed to create " << PLUGIN_DEVICE_TYPE << " device");
+      return 1;
+    }
+    int numberOfErrors = 0;
+    if (std::string(device->GetClassName()) != PLUGIN_DEVICE_CLASS_NAME || device->GetDeviceId() != deviceId)
+    {
+      LOG_ERROR("Unexpected device is created: " << device->GetClassName() << " " << device->GetDeviceId());
+      numberOfErrors++;
+    }
+    if (!factory->IsDeviceTypeRegistered(PLUGIN_DEVICE_TYPE) || factory->IsDevicePluginPending(PLUGIN_DEVICE_TYPE))
+    {
+      LOG_ERROR("Device type " << PLUGIN_DEVICE_TYPE << " is not registered after its plugin module is loaded");
+      numberOfErrors++;
+    }
+    device->Delete();
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  std::string pluginDirectory;
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--plugin-directory", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &pluginDirectory, "Directory of the test device plugin module and its manifest");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (pluginDirectory.empty())
+  {
+    LOG_ERROR("--plugin-directory is required");
+    exit(EXIT_FAILURE);
+  }
+  vtkPlusDeviceFactory::AddDevicePluginDirectory(pluginDirectory);
+
+  int numberOfErrors = 0;
+
+  // The device type is known from the manifest, the module is not loaded yet
+  vtkSmartPointer<vtkPlusDeviceFactoryTester> factory = vtkSmartPointer<vtkPlusDeviceFactoryTester>::New();
+  std::string className;
+  if (factory->GetDeviceClassName(PLUGIN_DEVICE_TYPE, className) != PLUS_SUCCESS || className != PLUGIN_DEVICE_CLASS_NAME)
+  {
+    LOG_ERROR("Device type " << PLUGIN_DEVICE_TYPE << " of the plugin manifest in " << pluginDirectory << " is not listed");
+    return EXIT_FAILURE;
+  }
+  if (factory->IsDeviceTypeRegistered(PLUGIN_DEVICE_TYPE) || !factory->IsDevicePluginPending(PLUGIN_DEVICE_TYPE))
+  {
+    LOG_ERROR("Plugin module is loaded before a device of its type is created");
+    numberOfErrors++;
+  }
+  std::ostringstream availableDevices;
+  factory->PrintAvailableDevices(availableDevices, vtkIndent());
+  if (availableDevices.str().find(PLUGIN_DEVICE_TYPE) == std::string::npos)
+  {
+    LOG_ERROR("Device type " << PLUGIN_DEVICE_TYPE << " is not printed in the available devices");
+    numberOfErrors++;
+  }
+
+  // Creating a device loads the module
+  numberOfErrors += CreatePluginDevice(factory, "PluginDevice1");
+  numberOfErrors += CreatePluginDevice(factory, "PluginDevice2");
+
+  // Other factories use the module that is already loaded
+  vtkSmartPointer<vtkPlusDeviceFactoryTester> otherFactory = vtkSmartPointer<vtkPlusDeviceFactoryTester>::New();
+  if (otherFactory->IsDeviceTypeRegistered(PLUGIN_DEVICE_TYPE) || !otherFactory->IsDevicePluginPending(PLUGIN_DEVICE_TYPE))
+  {
+    LOG_ERROR("New factory registers the plugin device type before a device of its type is created");
+    numberOfErrors++;
+  }
+  numberOfErrors += CreatePluginDevice(otherFactory, "PluginDevice3");
+
+  // Devices that are built into the library are still created without plugins
+  vtkPlusDevice* builtInDevice = NULL;
+  if (otherFactory->CreateInstance("FakeTracker", builtInDevice, "Tracker") != PLUS_SUCCESS || builtInDevice == NULL)
+  {
+    LOG_ERROR("Failed to create a built-in device");
+    numberOfErrors++;
+  }
+  else
+  {
+    builtInDevice->Delete();
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("vtkPlusDeviceFactoryPluginTest failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("vtkPlusDeviceFactoryPluginTest completed successfully");
+  return EXIT_SUCCESS;
+}
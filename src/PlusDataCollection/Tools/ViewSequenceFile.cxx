@@ -6,6 +6,7 @@ See License.txt for details.
 
 #include "PlusConfigure.h"
 #include "igsioTrackedFrame.h"
+#include "igsioVideoFrame.h"
 #include "vtkActorCollection.h"
 #include "vtkCallbackCommand.h"
 #include "vtkCollectionIterator.h"
@@ -17,13 +18,15 @@ See License.txt for details.
 #include "vtkImageViewer2.h"
 #endif
 #include "vtkMatrix4x4.h"
+#include "vtkPlusConfig.h"
 #include "vtkProp.h"
 #include "vtkRenderWindow.h"
 #include "vtkRenderWindow.h"
 #include "vtkRenderWindowInteractor.h"
 #include "vtkRenderer.h"
 #include "vtkRenderer.h"
-#include "vtkIGSIOSequenceIO.h"
+#include "vtkPlusSequenceIO.h"
+#include "vtkPlusSequenceStreamReader.h"
 #include "vtkSmartPointer.h"
 #include "vtkTextActor.h"
 #include "vtkTextActor3D.h"
@@ -33,7 +36,137 @@ See License.txt for details.
 #include "vtkIGSIOTransformRepository.h"
 #include "vtkXMLUtilities.h"
 #include "vtksys/CommandLineArguments.hxx"
+#include "vtksys/SystemTools.hxx"
 #include <iomanip>
+#include <map>
+
+namespace
+{
+  const char SOURCE_FRAME_INDEX_FIELD_NAME[] = "SourceFrameIndex";
+  const char THUMBNAIL_SOURCE_FILE_SIZE_NAME[] = "ThumbnailSourceFileSize";
+  const char THUMBNAIL_SOURCE_MODIFIED_TIME_NAME[] = "ThumbnailSourceModifiedTime";
+  const char THUMBNAIL_FRAME_STEP_NAME[] = "ThumbnailFrameStep";
+  const char THUMBNAIL_SHRINK_FACTOR_NAME[] = "ThumbnailShrinkFactor";
+}
+
+///////////////////////////////////////////////////////////////////
+// Preview mode: every k-th frame is decoded at reduced resolution and the thumbnails are cached in a sidecar file
+
+//----------------------------------------------------------------------------
+std::string GetThumbnailFilePath(const std::string& sequenceFilePath)
+{
+  return sequenceFilePath + ".thumbnails.mha";
+}
+
+//----------------------------------------------------------------------------
+/*! Thumbnails are only reused if they were created from the same file (same size and modification time) with the same parameters */
+void GetThumbnailProperties(const std::string& sequenceFilePath, int frameStep, int shrinkFactor, std::map<std::string, std::string>& properties)
+{
+  properties[THUMBNAIL_SOURCE_FILE_SIZE_NAME] = igsioCommon::ToString<unsigned long>(vtksys::SystemTools::FileLength(sequenceFilePath));
+  properties[THUMBNAIL_SOURCE_MODIFIED_TIME_NAME] = igsioCommon::ToString<long>(vtksys::SystemTools::ModifiedTime(sequenceFilePath));
+  properties[THUMBNAIL_FRAME_STEP_NAME] = igsioCommon::ToString<int>(frameStep);
+  properties[THUMBNAIL_SHRINK_FACTOR_NAME] = igsioCommon::ToString<int>(shrinkFactor);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus ReadThumbnailFile(const std::string& thumbnailFilePath, const std::map<std::string, std::string>& properties, vtkIGSIOTrackedFrameList* thumbnails)
+{
+  if (!vtksys::SystemTools::FileExists(thumbnailFilePath.c_str(), true))
+  {
+    return PLUS_FAIL;
+  }
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> thumbnailsInFile = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  if (vtkPlusSequenceIO::Read(thumbnailFilePath, thumbnailsInFile) != PLUS_SUCCESS)
+  {
+    LOG_WARNING("Failed to read thumbnail file, thumbnails are created again: " << thumbnailFilePath);
+    return PLUS_FAIL;
+  }
+  for (std::map<std::string, std::string>::const_iterator propertyIt = properties.begin(); propertyIt != properties.end(); ++propertyIt)
+  {
+    const char* value = thumbnailsInFile->GetCustomString(propertyIt->first.c_str());
+    if (value == NULL || propertyIt->second != value)
+    {
+      LOG_DEBUG("Thumbnail file is ignored, it does not match the sequence file or the preview parameters: " << thumbnailFilePath);
+      return PLUS_FAIL;
+    }
+  }
+  thumbnails->AddTrackedFrameList(thumbnailsInFile);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+/*! Nearest neighbor downsampling in the first two dimensions, works for any pixel type */
+PlusStatus ShrinkFrameImage(igsioVideoFrame& sourceImage, int shrinkFactor, igsioVideoFrame& thumbnailImage)
+{
+  vtkImageData* image = sourceImage.GetImage();
+  FrameSizeType sourceSize = sourceImage.GetFrameSize();
+  FrameSizeType thumbnailSize = { (sourceSize[0] + shrinkFactor - 1) / shrinkFactor, (sourceSize[1] + shrinkFactor - 1) / shrinkFactor, sourceSize[2] };
+  const unsigned int numberOfComponents = static_cast<unsigned int>(image->GetNumberOfScalarComponents());
+  if (thumbnailImage.AllocateFrame(thumbnailSize, image->GetScalarType(), numberOfComponents) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to allocate thumbnail image");
+    return PLUS_FAIL;
+  }
+  thumbnailImage.SetImageType(sourceImage.GetImageType());
+  thumbnailImage.SetImageOrientation(sourceImage.GetImageOrientation());
+
+  const size_t bytesPerPixel = numberOfComponents * igsioVideoFrame::GetNumberOfBytesPerScalar(image->GetScalarType());
+  const unsigned char* sourcePixels = static_cast<const unsigned char*>(sourceImage.GetScalarPointer());
+  unsigned char* thumbnailPixels = static_cast<unsigned char*>(thumbnailImage.GetScalarPointer());
+  for (unsigned int z = 0; z < thumbnailSize[2]; z++)
+  {
+    for (unsigned int y = 0; y < thumbnailSize[1]; y++)
+    {
+      const unsigned char* sourceRow = sourcePixels + ((static_cast<size_t>(z) * sourceSize[1] + y * shrinkFactor) * sourceSize[0]) * bytesPerPixel;
+      for (unsigned int x = 0; x < thumbnailSize[0]; x++)
+      {
+        memcpy(thumbnailPixels, sourceRow + static_cast<size_t>(x) * shrinkFactor * bytesPerPixel, bytesPerPixel);
+        thumbnailPixels += bytesPerPixel;
+      }
+    }
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+/*! Decode every frameStep-th frame of the sequence and add them to the thumbnail list with reduced resolution */
+PlusStatus CreateThumbnails(vtkPlusSequenceStreamReader* reader, int frameStep, int shrinkFactor, vtkIGSIOTrackedFrameList* thumbnails)
+{
+  igsioTrackedFrame sourceFrame;
+  const int numberOfFrames = reader->GetNumberOfFrames();
+  for (int frameIndex = 0; frameIndex < numberOfFrames; frameIndex += frameStep)
+  {
+    vtkPlusLogger::PrintProgressbar((100.0 * frameIndex) / numberOfFrames);
+    // Frames are read in increasing order, so compressed pixel data is decompressed only once
+    if (reader->ReadFrame(frameIndex, sourceFrame) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to read frame " << frameIndex << " for creating thumbnails");
+      return PLUS_FAIL;
+    }
+    igsioTrackedFrame* thumbnail = new igsioTrackedFrame;
+    const igsioFieldMapType& fields = sourceFrame.GetCustomFields();
+    for (igsioFieldMapType::const_iterator fieldIt = fields.begin(); fieldIt != fields.end(); ++fieldIt)
+    {
+      thumbnail->SetFrameField(fieldIt->first, fieldIt->second.second, fieldIt->second.first);
+    }
+    thumbnail->SetTimestamp(sourceFrame.GetTimestamp());
+    thumbnail->SetFrameField(SOURCE_FRAME_INDEX_FIELD_NAME, igsioCommon::ToString<int>(frameIndex));
+    if (sourceFrame.GetImageData()->IsImageValid()
+        && ShrinkFrameImage(*sourceFrame.GetImageData(), shrinkFactor, *thumbnail->GetImageData()) != PLUS_SUCCESS)
+    {
+      delete thumbnail;
+      return PLUS_FAIL;
+    }
+    if (thumbnails->TakeTrackedFrame(thumbnail, vtkIGSIOTrackedFrameList::SKIP_INVALID_FRAME) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to add thumbnail of frame " << frameIndex);
+      return PLUS_FAIL;
+    }
+  }
+  vtkPlusLogger::PrintProgressbar(100);
+  std::cout << std::endl;
+  return PLUS_SUCCESS;
+}
 
 ///////////////////////////////////////////////////////////////////
 
@@ -55,11 +188,23 @@ public:
     this->ImageTransforms = imageTransforms;
   }
 
+  /*! In preview mode the actors show thumbnails, the full resolution frame is read from the sequence on request */
+  void InitializePreview(vtkPlusSequenceStreamReader* reader, std::vector<int>* sourceFrameIndices, vtkImageActor* fullResolutionActor)
+  {
+    this->Reader = reader;
+    this->SourceFrameIndices = sourceFrameIndices;
+    this->FullResolutionActor = fullResolutionActor;
+  }
+
   virtual void Execute(vtkObject* caller, unsigned long callerEvent, void*)
   {
     if (callerEvent == vtkCommand::CharEvent)
     {
       char keycode = this->RenderWindowInteractor->GetKeyCode();
+      if (this->FullResolutionActor != NULL && (keycode == '+' || keycode == '-'))
+      {
+        this->FullResolutionActor->VisibilityOff();
+      }
       switch (keycode)
       {
         case '+':
@@ -96,13 +241,26 @@ public:
           this->CurrentActor->VisibilityOn();
         }
         break;
+        case 'f':
+        {
+          if (this->Reader != NULL)
+          {
+            this->ToggleFullResolution();
+          }
+        }
+        break;
       }
     }
 
     double* position = (*this->ImageTransforms)[this->FrameNum]->GetPosition();
     std::ostringstream ss;
     ss.precision(2);
-    ss << "Frame " << this->FrameNum << "\nImage position: " << std::fixed << position[0] << "  " << position[1] << "  " << position[2] << std::ends;
+    ss << "Frame " << this->FrameNum;
+    if (this->SourceFrameIndices != NULL)
+    {
+      ss << " (sequence frame " << (*this->SourceFrameIndices)[this->FrameNum] << (this->FullResolutionActor->GetVisibility() ? ", full resolution)" : ")");
+    }
+    ss << "\nImage position: " << std::fixed << position[0] << "  " << position[1] << "  " << position[2] << std::ends;
     this->TextActor->SetInput(ss.str().c_str());
 
     this->RenderWindow->Render();
@@ -111,6 +269,29 @@ public:
   }
 
 protected:
+  void ToggleFullResolution()
+  {
+    vtkImageActor* thumbnailActor = static_cast<vtkImageActor*>(this->ImageActors->GetItemAsObject(this->FrameNum));
+    if (this->FullResolutionActor->GetVisibility())
+    {
+      this->FullResolutionActor->VisibilityOff();
+      thumbnailActor->VisibilityOn();
+      return;
+    }
+    int sourceFrameIndex = (*this->SourceFrameIndices)[this->FrameNum];
+    if (this->Reader->ReadFrame(sourceFrameIndex, this->FullResolutionFrame) != PLUS_SUCCESS || !this->FullResolutionFrame.GetImageData()->IsImageValid())
+    {
+      LOG_ERROR("Failed to read full resolution image of frame " << sourceFrameIndex);
+      return;
+    }
+    vtkSmartPointer<vtkImageData> frameImageData = vtkSmartPointer<vtkImageData>::New();
+    frameImageData->ShallowCopy(this->FullResolutionFrame.GetImageData()->GetImage());
+    this->FullResolutionActor->SetInputData(frameImageData);
+    this->FullResolutionActor->SetUserTransform((*this->ImageTransforms)[this->FrameNum]);
+    this->FullResolutionActor->VisibilityOn();
+    thumbnailActor->VisibilityOff();
+  }
+
   vtkMyCallback()
   {
     this->FrameNum = 0;
@@ -120,6 +301,9 @@ protected:
     this->TextActor = NULL;
     this->ImageActors = NULL;
     this->ImageTransforms = NULL;
+    this->Reader = NULL;
+    this->SourceFrameIndices = NULL;
+    this->FullResolutionActor = NULL;
   }
 
   virtual ~vtkMyCallback()
@@ -133,6 +317,10 @@ protected:
   vtkTextActor* TextActor;
   vtkCollection* ImageActors;
   std::vector<vtkTransform*>* ImageTransforms;
+  vtkPlusSequenceStreamReader* Reader;
+  std::vector<int>* SourceFrameIndices;
+  vtkImageActor* FullResolutionActor;
+  igsioTrackedFrame FullResolutionFrame;
 };
 
 int main(int argc, char** argv)
@@ -143,6 +331,10 @@ int main(int argc, char** argv)
   std::string outputModelFilename;
   std::string imageToReferenceTransformNameStr;
   bool renderingOff(false);
+  bool memoryMapped(false);
+  bool preview(false);
+  int previewFrameStep(10);
+  int previewShrinkFactor(4);
 
   int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
 
@@ -153,6 +345,10 @@ int main(int argc, char** argv)
   args.AddArgument("--source-seq-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputSequenceFilename, "Tracked ultrasound recorded by Plus (e.g., by the TrackedUltrasoundCapturing application) in a sequence file (.mha/.nrrd)");
   args.AddArgument("--config-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputConfigFileName, "Config file containing coordinate system definitions");
   args.AddArgument("--rendering-off", vtksys::CommandLineArguments::NO_ARGUMENT, &renderingOff, "Run in test mode, without rendering.");
+  args.AddArgument("--memory-mapped", vtksys::CommandLineArguments::NO_ARGUMENT, &memoryMapped, "Memory map the sequence file, so that only the displayed frames are read from the disk (uncompressed .mha/.mhd files in MF orientation).");
+  args.AddArgument("--preview", vtksys::CommandLineArguments::NO_ARGUMENT, &preview, "Show only every k-th frame at reduced resolution, without loading the whole sequence (.mha/.mhd files). Thumbnails are cached in a <sequence file>.thumbnails.mha file. Press 'f' to show the current frame in full resolution.");
+  args.AddArgument("--preview-frame-step", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &previewFrameStep, "In preview mode every k-th frame of the sequence is shown (default: 10)");
+  args.AddArgument("--preview-shrink-factor", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &previewShrinkFactor, "In preview mode the image size is reduced by this factor in both directions (default: 4)");
   args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
   args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
 
@@ -177,6 +373,12 @@ int main(int argc, char** argv)
     exit(EXIT_FAILURE);
   }
 
+  if (preview && (previewFrameStep < 1 || previewShrinkFactor < 1))
+  {
+    std::cerr << "--preview-frame-step and --preview-shrink-factor must be positive" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
   ///////////////
 
   vtkSmartPointer<vtkRenderWindow> renWin = vtkSmartPointer<vtkRenderWindow>::New();
@@ -194,8 +396,49 @@ int main(int argc, char** argv)
   // Read input tracked ultrasound data.
   LOG_DEBUG("Reading input... ");
   vtkSmartPointer< vtkIGSIOTrackedFrameList > trackedFrameList = vtkSmartPointer< vtkIGSIOTrackedFrameList >::New();
+  vtkSmartPointer<vtkPlusSequenceStreamReader> previewReader;
+  std::vector<int> sourceFrameIndices;
+  if (preview)
+  {
+    previewReader = vtkSmartPointer<vtkPlusSequenceStreamReader>::New();
+    if (!vtkPlusSequenceStreamReader::CanReadFile(inputSequenceFilename) || previewReader->Open(inputSequenceFilename) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Unable to open input sequence file for preview (only .mha/.mhd files are supported): " << inputSequenceFilename);
+      return EXIT_FAILURE;
+    }
+    std::string sequenceFilePath = inputSequenceFilename;
+    if (!vtksys::SystemTools::FileExists(sequenceFilePath.c_str(), true))
+    {
+      vtkPlusConfig::GetInstance()->FindImagePath(inputSequenceFilename, sequenceFilePath);
+    }
+    std::string thumbnailFilePath = GetThumbnailFilePath(sequenceFilePath);
+    std::map<std::string, std::string> thumbnailProperties;
+    GetThumbnailProperties(sequenceFilePath, previewFrameStep, previewShrinkFactor, thumbnailProperties);
+    if (ReadThumbnailFile(thumbnailFilePath, thumbnailProperties, trackedFrameList) == PLUS_SUCCESS)
+    {
+      LOG_INFO("Thumbnails are read from " << thumbnailFilePath);
+    }
+    else
+    {
+      LOG_INFO("Creating thumbnails...");
+      if (CreateThumbnails(previewReader, previewFrameStep, previewShrinkFactor, trackedFrameList) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Unable to create thumbnails of the input sequence file.");
+        return EXIT_FAILURE;
+      }
+      for (std::map<std::string, std::string>::iterator propertyIt = thumbnailProperties.begin(); propertyIt != thumbnailProperties.end(); ++propertyIt)
+      {
+        trackedFrameList->SetCustomString(propertyIt->first.c_str(), propertyIt->second.c_str());
+      }
+      // The thumbnail file is only a cache, the preview works without it
+      if (vtkPlusSequenceIO::Write(thumbnailFilePath, trackedFrameList) != PLUS_SUCCESS)
+      {
+        LOG_WARNING("Unable to save thumbnails to " << thumbnailFilePath);
+      }
+    }
+  }
   // Orientation is XX so that the orientation of the trackedFrameList will match the orientation defined in the file
-  if (vtkIGSIOSequenceIO::Read(inputSequenceFilename, trackedFrameList) != PLUS_SUCCESS)
+  else if (vtkPlusSequenceIO::Read(inputSequenceFilename, trackedFrameList, memoryMapped) != PLUS_SUCCESS)
   {
     LOG_ERROR("Unable to load input sequences file.");
     return EXIT_FAILURE;
@@ -253,8 +496,15 @@ int main(int argc, char** argv)
       continue;
     }
 
+    // The frame list is kept until the viewer exits, so the pixels are shared instead of copied.
+    // Memory mapped frames are then only read from the disk when they are displayed.
     vtkSmartPointer<vtkImageData> frameImageData = vtkSmartPointer<vtkImageData>::New();
-    frameImageData->DeepCopy(frame->GetImageData()->GetImage());
+    frameImageData->ShallowCopy(frame->GetImageData()->GetImage());
+    if (preview)
+    {
+      // thumbnails are shown in the same size as the full resolution image
+      frameImageData->SetSpacing(previewShrinkFactor, previewShrinkFactor, 1.0);
+    }
 
     vtkSmartPointer<vtkImageActor> imageActor = vtkSmartPointer<vtkImageActor>::New();
     imageActor->SetInputData(frameImageData);
@@ -277,6 +527,12 @@ int main(int argc, char** argv)
     imageActor->VisibilityOff();
     imageTransforms.push_back(imageToReferenceTransform);
     imageActors->AddItem(imageActor);
+    if (preview)
+    {
+      int sourceFrameIndex = frameIndex * previewFrameStep;
+      igsioCommon::StringToNumber<int>(frame->GetFrameField(SOURCE_FRAME_INDEX_FIELD_NAME), sourceFrameIndex);
+      sourceFrameIndices.push_back(sourceFrameIndex);
+    }
   }
 
   vtkPlusLogger::PrintProgressbar(100);
@@ -316,6 +572,13 @@ int main(int argc, char** argv)
     //establish timer event and create timer
     vtkSmartPointer<vtkMyCallback> call = vtkSmartPointer<vtkMyCallback>::New();
     call->Initialize(renWin, renderWindowInteractor, textActor, imageActors, &imageTransforms);
+    vtkSmartPointer<vtkImageActor> fullResolutionActor = vtkSmartPointer<vtkImageActor>::New();
+    if (preview)
+    {
+      fullResolutionActor->VisibilityOff();
+      renderer->AddActor(fullResolutionActor);
+      call->InitializePreview(previewReader, &sourceFrameIndices, fullResolutionActor);
+    }
     renderWindowInteractor->AddObserver(vtkCommand::TimerEvent, call);
     renderWindowInteractor->AddObserver(vtkCommand::CharEvent, call);
     renderWindowInteractor->CreateTimer(VTKI_TIMER_FIRST);    //VTKI_TIMER_FIRST = 0
@@ -5,6 +5,7 @@
 =========================================================Plus=header=end*/
 
 #include "PlusConfigure.h"
+#include "igsioMath.h"
 #include "vtkImageData.h"
 #include "vtkObjectFactory.h"
 #include "vtkIGSIOTrackedFrameList.h"
@@ -23,6 +24,9 @@ vtkPlusUsSimulatorVideoSource::vtkPlusUsSimulatorVideoSource()
   : UsSimulator(NULL)
   , LastProcessedTrackingDataTimestamp(0)
   , GracePeriodLogLevel(vtkPlusLogger::LOG_LEVEL_DEBUG)
+  , PoseChangeThresholdMm(0)
+  , PoseChangeThresholdDeg(0)
+  , LastSimulatedTrackedFrameValid(false)
 {
   // Create and set up US simulator
   vtkSmartPointer<vtkPlusUsSimulatorAlgo> usSimulator = vtkSmartPointer<vtkPlusUsSimulatorAlgo>::New();
@@ -53,6 +57,8 @@ vtkPlusUsSimulatorVideoSource::~vtkPlusUsSimulatorVideoSource()
 void vtkPlusUsSimulatorVideoSource::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "PoseChangeThresholdMm: " << this->PoseChangeThresholdMm << std::endl;
+  os << indent << "PoseChangeThresholdDeg: " << this->PoseChangeThresholdDeg << std::endl;
 }
 
 //----------------------------------------------------------------------------
@@ -134,7 +140,17 @@ PlusStatus vtkPlusUsSimulatorVideoSource::InternalUpdate()
   }
 
   // Get the simulated US image
-  this->UsSimulator->Modified(); // Signal that the transforms have changed so we need to recompute
+  if (this->HasPoseChangedSinceLastSimulation(*trackedFrame))
+  {
+    this->UsSimulator->Modified(); // Signal that the transforms have changed so we need to recompute
+    this->LastSimulatedTrackedFrame = *trackedFrame;
+    this->LastSimulatedTrackedFrameValid = true;
+  }
+  else
+  {
+    // The simulator is not modified, so the update does not recompute the image, unless a simulation parameter has been changed
+    LOG_TRACE("Transforms have not changed since the last simulated frame, the simulated image is reused");
+  }
   this->UsSimulator->Update();
 
   vtkPlusDataSource* aSource(NULL);
@@ -152,6 +168,50 @@ PlusStatus vtkPlusUsSimulatorVideoSource::InternalUpdate()
   return status;
 }
 
+//----------------------------------------------------------------------------
+bool vtkPlusUsSimulatorVideoSource::HasPoseChangedSinceLastSimulation(igsioTrackedFrame& trackedFrame)
+{
+  if (!this->LastSimulatedTrackedFrameValid)
+  {
+    return true;
+  }
+
+  std::vector<igsioTransformName> transformNames;
+  trackedFrame.GetFrameTransformNameList(transformNames);
+  std::vector<igsioTransformName> lastTransformNames;
+  this->LastSimulatedTrackedFrame.GetFrameTransformNameList(lastTransformNames);
+  if (transformNames.size() != lastTransformNames.size())
+  {
+    return true;
+  }
+
+  vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  vtkSmartPointer<vtkMatrix4x4> lastMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  for (std::vector<igsioTransformName>::iterator nameIt = transformNames.begin(); nameIt != transformNames.end(); ++nameIt)
+  {
+    ToolStatus status = TOOL_INVALID;
+    ToolStatus lastStatus = TOOL_INVALID;
+    if (trackedFrame.GetFrameTransform(*nameIt, matrix) != PLUS_SUCCESS || trackedFrame.GetFrameTransformStatus(*nameIt, status) != PLUS_SUCCESS
+        || this->LastSimulatedTrackedFrame.GetFrameTransform(*nameIt, lastMatrix) != PLUS_SUCCESS
+        || this->LastSimulatedTrackedFrame.GetFrameTransformStatus(*nameIt, lastStatus) != PLUS_SUCCESS)
+    {
+      // The transform is new or not available
+      return true;
+    }
+    if (status != lastStatus)
+    {
+      return true;
+    }
+    if (igsioMath::GetPositionDifference(matrix, lastMatrix) > this->PoseChangeThresholdMm
+        || igsioMath::GetOrientationDifference(matrix, lastMatrix) > this->PoseChangeThresholdDeg)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusUsSimulatorVideoSource::InternalConnect()
 {
@@ -183,6 +243,7 @@ PlusStatus vtkPlusUsSimulatorVideoSource::InternalConnect()
   aSource->SetInputFrameSize(frameSize);
 
   this->LastProcessedTrackingDataTimestamp = 0;
+  this->LastSimulatedTrackedFrameValid = false;
 
   return PLUS_SUCCESS;
 }
@@ -199,6 +260,9 @@ PlusStatus vtkPlusUsSimulatorVideoSource::ReadConfiguration(vtkXMLDataElement* r
   LOG_TRACE("vtkPlusUsSimulatorVideoSource::ReadConfiguration");
   XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_READING(deviceConfig, rootConfigElement);
 
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, PoseChangeThresholdMm, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, PoseChangeThresholdDeg, deviceConfig);
+
   // Read US simulator configuration
   if (!this->UsSimulator
       || this->UsSimulator->ReadConfiguration(deviceConfig) != PLUS_SUCCESS)
@@ -39,6 +39,17 @@ public:
 
   virtual bool IsTracker() const { return false; }
 
+  /*!
+    The previous simulated image is reused if no tracked transform has moved more than this since the image was simulated.
+    0 means that the image is only reused if the transforms are exactly the same.
+  */
+  vtkSetMacro(PoseChangeThresholdMm, double);
+  vtkGetMacro(PoseChangeThresholdMm, double);
+
+  /*! The previous simulated image is reused if no tracked transform has rotated more than this since the image was simulated */
+  vtkSetMacro(PoseChangeThresholdDeg, double);
+  vtkGetMacro(PoseChangeThresholdDeg, double);
+
 protected:
   /*! Set ultrasound simulator */
   vtkSetObjectMacro(UsSimulator, vtkPlusUsSimulatorAlgo);
@@ -61,6 +72,9 @@ protected:
   /*! The internal function which actually does the grab.  */
   virtual PlusStatus InternalUpdate();
 
+  /*! Returns true if any transform or transform status of the tracked frame differs from the last simulated frame by more than the thresholds */
+  bool HasPoseChangedSinceLastSimulation(igsioTrackedFrame& trackedFrame);
+
 protected:
   /*! Ultrasound simulator */
   vtkPlusUsSimulatorAlgo* UsSimulator;
@@ -71,6 +85,14 @@ protected:
   /* Output to different logs depending on the status of the grace period */
   vtkPlusLogger::LogLevelType GracePeriodLogLevel;
 
+  double PoseChangeThresholdMm;
+  double PoseChangeThresholdDeg;
+
+  /*! Tracking data that the current output image of the simulator was simulated from */
+  igsioTrackedFrame LastSimulatedTrackedFrame;
+  /*! False if there is no simulated image that could be reused */
+  bool LastSimulatedTrackedFrameValid;
+
 private:
   static vtkPlusUsSimulatorVideoSource* Instance;
   vtkPlusUsSimulatorVideoSource(const vtkPlusUsSimulatorVideoSource&);  // Not implemented.
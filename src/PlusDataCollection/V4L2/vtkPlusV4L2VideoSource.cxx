@@ -10,9 +10,13 @@
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataSource.h"
 
+// IGSIO includes
+#include <vtkIGSIOAccurateTimer.h>
+
 // VTK includes
 #include <vtkImageData.h>
 #include <vtkObjectFactory.h>
+#include <vtkUnsignedCharArray.h>
 
 // OS includes
 #include <fcntl.h>
@@ -57,7 +61,12 @@ vtkPlusV4L2VideoSource::vtkPlusV4L2VideoSource()
   , FormatHeight(nullptr)
   , PixelFormat(nullptr)
   , FieldOrder(nullptr)
+  , ZeroCopy(false)
+  , NumberOfDecoderThreads(0)
   , DataSource(nullptr)
+  , ZeroCopyActive(false)
+  , MjpegCompressed(false)
+  , FrameHardwareTimestampSec(UNDEFINED_TIMESTAMP)
 {
   memset(this->DeviceFormat.get(), 0, sizeof(struct v4l2_format));
 
@@ -77,6 +86,7 @@ void vtkPlusV4L2VideoSource::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "DeviceName: " << this->DeviceName << std::endl;
   os << indent << "IOMethod: " << this->IOMethodToString(this->IOMethod) << std::endl;
   os << indent << "BufferCount: " << this->BufferCount << std::endl;
+  os << indent << "ZeroCopy: " << (this->ZeroCopy ? "TRUE" : "FALSE") << (this->ZeroCopyActive ? " (active)" : "") << std::endl;
 
   if (this->FileDescriptor != -1)
   {
@@ -114,6 +124,14 @@ PlusStatus vtkPlusV4L2VideoSource::ReadConfiguration(vtkXMLDataElement* rootConf
     LOG_WARNING("Unknown method: " << ioMethod << ". Defaulting to " << vtkPlusV4L2VideoSource::IOMethodToString(this->IOMethod));
   }
 
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(ZeroCopy, deviceConfig);
+  if (this->ZeroCopy && this->IOMethod != IO_METHOD_USERPTR)
+  {
+    LOG_WARNING("ZeroCopy is only supported with IO_METHOD_USERPTR, frames are copied into the buffer.");
+  }
+
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfDecoderThreads, deviceConfig);
+
   int frameSize[2];
   XML_READ_VECTOR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, 2, FrameSize, frameSize, deviceConfig);
   if (deviceConfig->GetAttribute("FrameSize") != nullptr)
@@ -154,6 +172,15 @@ PlusStatus vtkPlusV4L2VideoSource::WriteConfiguration(vtkXMLDataElement* rootCon
   XML_WRITE_STRING_ATTRIBUTE_IF_NOT_EMPTY(DeviceName, deviceConfig);
 
   deviceConfig->SetAttribute("IOMethod", vtkPlusV4L2VideoSource::IOMethodToString(this->IOMethod).c_str());
+  XML_WRITE_BOOL_ATTRIBUTE(ZeroCopy, deviceConfig);
+  if (this->NumberOfDecoderThreads != 0)
+  {
+    deviceConfig->SetIntAttribute("NumberOfDecoderThreads", this->NumberOfDecoderThreads);
+  }
+  else
+  {
+    XML_REMOVE_ATTRIBUTE("NumberOfDecoderThreads", deviceConfig);
+  }
 
   int frameSize[2] = { static_cast<int>(this->DeviceFormat->fmt.pix.width), static_cast<int>(this->DeviceFormat->fmt.pix.height) };
   deviceConfig->SetVectorAttribute("FrameSize", 2, frameSize);
@@ -287,9 +314,29 @@ PlusStatus vtkPlusV4L2VideoSource::InitUserp(unsigned int bufferSize)
     return PLUS_FAIL;
   }
 
+  // Frames can be swapped into the buffer only if the driver writes exactly one frame of the buffer format
+  unsigned int frameSizeInBytes = this->ImageSize[0] * this->ImageSize[1] * this->NumberOfScalarComponents;
+  this->ZeroCopyActive = this->ZeroCopy;
+  if (this->ZeroCopyActive && (this->MjpegCompressed || bufferSize != frameSizeInBytes))
+  {
+    LOG_WARNING("Zero copy capture is not possible, the device buffer size (" << bufferSize << " bytes) is different from the frame size ("
+                << frameSizeInBytes << " bytes, compressed or padded pixel format), frames are copied into the buffer.");
+    this->ZeroCopyActive = false;
+  }
+
   for (this->BufferCount = 0; this->BufferCount < 4; ++this->BufferCount)
   {
     this->FrameBuffers[this->BufferCount].length = bufferSize;
+    if (this->ZeroCopyActive)
+    {
+      // The pixel arrays are swapped with the arrays of the buffer frames, so they have to be allocated as VTK arrays
+      vtkSmartPointer<vtkUnsignedCharArray> pixels = vtkSmartPointer<vtkUnsignedCharArray>::New();
+      pixels->SetNumberOfComponents(this->NumberOfScalarComponents);
+      pixels->SetNumberOfTuples(this->ImageSize[0] * this->ImageSize[1]);
+      this->ZeroCopyPixels.push_back(pixels);
+      this->FrameBuffers[this->BufferCount].start = pixels->GetVoidPointer(0);
+      continue;
+    }
     this->FrameBuffers[this->BufferCount].start = malloc(bufferSize);
 
     if (!this->FrameBuffers[this->BufferCount].start)
@@ -440,7 +487,16 @@ PlusStatus vtkPlusV4L2VideoSource::InternalConnect()
   this->ImageSize[1] = this->DeviceFormat->fmt.pix.height;
   this->ImageSize[2] = 1;
   this->DataSource->SetPixelType(VTK_UNSIGNED_CHAR);
-  this->NumberOfScalarComponents = this->DeviceFormat->fmt.pix.sizeimage / this->DeviceFormat->fmt.pix.width / this->DeviceFormat->fmt.pix.height;
+  this->MjpegCompressed = (this->DeviceFormat->fmt.pix.pixelformat == V4L2_PIX_FMT_MJPEG || this->DeviceFormat->fmt.pix.pixelformat == V4L2_PIX_FMT_JPEG);
+  if (this->MjpegCompressed)
+  {
+    // sizeimage is the maximum size of a compressed frame, the number of components is determined by the decoded image type
+    this->NumberOfScalarComponents = (this->DataSource->GetImageType() == US_IMG_RGB_COLOR ? 3 : 1);
+  }
+  else
+  {
+    this->NumberOfScalarComponents = this->DeviceFormat->fmt.pix.sizeimage / this->DeviceFormat->fmt.pix.width / this->DeviceFormat->fmt.pix.height;
+  }
   this->DataSource->SetNumberOfScalarComponents(this->NumberOfScalarComponents);
 
   this->FrameFields["pixelformat"] = vtkPlusV4L2VideoSource::PixelFormatToString(this->DeviceFormat->fmt.pix.pixelformat);
@@ -491,6 +547,13 @@ PlusStatus vtkPlusV4L2VideoSource::InternalDisconnect()
     }
     case IO_METHOD_USERPTR:
     {
+      if (!this->ZeroCopyPixels.empty())
+      {
+        // in zero copy mode the user pointer buffers are the memory of the pixel arrays
+        this->ZeroCopyPixels.clear();
+        this->ZeroCopyActive = false;
+        break;
+      }
       for (unsigned int i = 0; i < this->BufferCount; ++i)
       {
         free(this->FrameBuffers[i].start);
@@ -541,6 +604,16 @@ PlusStatus vtkPlusV4L2VideoSource::InternalUpdate()
     return PLUS_FAIL;
   }
 
+  if (this->ZeroCopyActive)
+  {
+    if (this->ReadFrameUserPtrZeroCopy() != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    this->FrameNumber++;
+    return PLUS_SUCCESS;
+  }
+
   unsigned int currentBufferIndex;
   unsigned int bytesUsed;
   if (this->ReadFrame(currentBufferIndex, bytesUsed) != PLUS_SUCCESS)
@@ -548,7 +621,24 @@ PlusStatus vtkPlusV4L2VideoSource::InternalUpdate()
     return PLUS_FAIL;
   }
 
-  if (this->DataSource->AddItem(this->FrameBuffers[currentBufferIndex].start, this->ImageSize, bytesUsed, US_IMG_BRIGHTNESS, this->FrameNumber, UNDEFINED_TIMESTAMP, UNDEFINED_TIMESTAMP, &this->FrameFields) != PLUS_SUCCESS)
+  if (this->MjpegCompressed)
+  {
+    // The frame is timestamped now, it is added to the buffer when it is decoded
+    double unfilteredTimestamp(UNDEFINED_TIMESTAMP), filteredTimestamp(UNDEFINED_TIMESTAMP);
+    this->GetFrameTimestamps(unfilteredTimestamp, filteredTimestamp);
+    if (this->MjpegDecoder.AddFrame(static_cast<const unsigned char*>(this->FrameBuffers[currentBufferIndex].start), bytesUsed, this->FrameNumber,
+                                    filteredTimestamp != UNDEFINED_TIMESTAMP ? filteredTimestamp : vtkIGSIOAccurateTimer::GetSystemTime(), &this->FrameFields) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("vtkPlusV4L2VideoSource::Unable to queue MJPEG frame for decoding.");
+      return PLUS_FAIL;
+    }
+    this->FrameNumber++;
+    return PLUS_SUCCESS;
+  }
+
+  double unfilteredTimestamp(UNDEFINED_TIMESTAMP), filteredTimestamp(UNDEFINED_TIMESTAMP);
+  this->GetFrameTimestamps(unfilteredTimestamp, filteredTimestamp);
+  if (this->DataSource->AddItem(this->FrameBuffers[currentBufferIndex].start, this->ImageSize, bytesUsed, US_IMG_BRIGHTNESS, this->FrameNumber, unfilteredTimestamp, filteredTimestamp, &this->FrameFields) != PLUS_SUCCESS)
   {
     LOG_ERROR("vtkPlusV4L2VideoSource::Unable to add item to the buffer.");
     return PLUS_FAIL;
@@ -605,6 +695,7 @@ PlusStatus vtkPlusV4L2VideoSource::ReadFrameFileDescriptor(unsigned int& current
 
   currentBufferIndex = 0;
   bytesUsed = this->FrameBuffers[0].length;
+  this->FrameHardwareTimestampSec = UNDEFINED_TIMESTAMP;
 
   return PLUS_SUCCESS;
 }
@@ -646,6 +737,7 @@ PlusStatus vtkPlusV4L2VideoSource::ReadFrameMemoryMap(unsigned int& currentBuffe
 
   currentBufferIndex = buf.index;
   bytesUsed = buf.length;
+  this->SetFrameHardwareTimestamp(buf);
 
   return PLUS_SUCCESS;
 }
@@ -694,10 +786,93 @@ PlusStatus vtkPlusV4L2VideoSource::ReadFrameUserPtr(unsigned int& currentBufferI
   }
 
   bytesUsed = buf.bytesused;
+  this->SetFrameHardwareTimestamp(buf);
 
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusV4L2VideoSource::SetFrameHardwareTimestamp(const v4l2_buffer& buf)
+{
+  this->FrameHardwareTimestampSec = UNDEFINED_TIMESTAMP;
+  if ((buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) != V4L2_BUF_FLAG_TIMESTAMP_UNKNOWN)
+  {
+    this->FrameHardwareTimestampSec = buf.timestamp.tv_sec + buf.timestamp.tv_usec * 1e-6;
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusV4L2VideoSource::GetFrameTimestamps(double& unfilteredTimestamp, double& filteredTimestamp)
+{
+  unfilteredTimestamp = UNDEFINED_TIMESTAMP;
+  filteredTimestamp = UNDEFINED_TIMESTAMP;
+  if (!this->IsHardwareClockEnabled() || this->FrameHardwareTimestampSec == UNDEFINED_TIMESTAMP)
+  {
+    return;
+  }
+  unfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+  filteredTimestamp = this->GetSystemTimeFromHardwareTimestamp(this->FrameHardwareTimestampSec, unfilteredTimestamp);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusV4L2VideoSource::ReadFrameUserPtrZeroCopy()
+{
+  v4l2_buffer buf;
+  CLEAR(buf);
+
+  buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  buf.memory = V4L2_MEMORY_USERPTR;
+
+  if (-1 == xioctl(this->FileDescriptor, VIDIOC_DQBUF, &buf))
+  {
+    switch (errno)
+    {
+      case EAGAIN:
+      {
+        return PLUS_FAIL;
+      }
+      case EIO:
+      {
+        // Could ignore EIO, see spec
+      }
+      default:
+      {
+        LOG_ERROR("VIDIOC_DQBUF" << ": " << strerror(errno));
+        return PLUS_FAIL;
+      }
+    }
+  }
+
+  if (buf.index >= this->BufferCount)
+  {
+    LOG_ERROR("VIDIOC_DQBUF returned invalid buffer index: " << buf.index);
+    return PLUS_FAIL;
+  }
+
+  // The frame is moved into the buffer, the pixel array of the overwritten buffer frame receives the next frame.
+  // If the frame is not added then the same array is queued again.
+  PlusStatus status = PLUS_SUCCESS;
+  this->SetFrameHardwareTimestamp(buf);
+  double unfilteredTimestamp(UNDEFINED_TIMESTAMP), filteredTimestamp(UNDEFINED_TIMESTAMP);
+  this->GetFrameTimestamps(unfilteredTimestamp, filteredTimestamp);
+  if (this->DataSource->AddItemBySwappingPixels(this->ZeroCopyPixels[buf.index], this->FrameNumber, unfilteredTimestamp, filteredTimestamp, &this->FrameFields) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("vtkPlusV4L2VideoSource::Unable to add item to the buffer.");
+    status = PLUS_FAIL;
+  }
+  this->FrameBuffers[buf.index].start = this->ZeroCopyPixels[buf.index]->GetVoidPointer(0);
+
+  buf.m.userptr = (unsigned long) this->FrameBuffers[buf.index].start;
+  buf.length = this->FrameBuffers[buf.index].length;
+  if (-1 == xioctl(this->FileDescriptor, VIDIOC_QBUF, &buf))
+  {
+    LOG_ERROR("VIDIOC_QBUF" << ": " << strerror(errno));
+    return PLUS_FAIL;
+  }
+
+  return status;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusV4L2VideoSource::NotifyConfigured()
 {
@@ -741,6 +916,9 @@ PlusStatus vtkPlusV4L2VideoSource::InternalStopRecording()
     }
   }
 
+  // Add the frames that are still being decoded
+  this->MjpegDecoder.Stop();
+
   return PLUS_SUCCESS;
 }
 
@@ -749,6 +927,15 @@ PlusStatus vtkPlusV4L2VideoSource::InternalStartRecording()
 {
   enum v4l2_buf_type type;
 
+  if (this->MjpegCompressed)
+  {
+    this->MjpegDecoder.SetNumberOfThreads(this->NumberOfDecoderThreads);
+    if (this->MjpegDecoder.Start(this->DataSource, this->ImageSize) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+  }
+
   switch (this->IOMethod)
   {
     case IO_METHOD_MMAP:
@@ -777,6 +964,12 @@ PlusStatus vtkPlusV4L2VideoSource::InternalStartRecording()
     }
     case IO_METHOD_USERPTR:
     {
+      this->ZeroCopyActive = !this->ZeroCopyPixels.empty();
+      if (this->ZeroCopyActive && !this->DataSource->CanAddItemBySwappingPixels())
+      {
+        LOG_WARNING("Zero copy capture is not possible (the images have to be clipped or reoriented, or the buffer uses contiguous frame memory), frames are copied into the buffer.");
+        this->ZeroCopyActive = false;
+      }
       for (unsigned int i = 0; i < this->BufferCount; ++i)
       {
         struct v4l2_buffer buf;
@@ -9,10 +9,18 @@
 
 #include "vtkPlusDataCollectionExport.h"
 #include "vtkPlusDevice.h"
+#include "PlusMjpegDecoderPool.h"
+
+// VTK includes
+#include <vtkSmartPointer.h>
 
 // V4L2 includes
 #include <linux/videodev2.h>
 
+// STL includes
+#include <vector>
+
+class vtkDataArray;
 class vtkPlusDataSource;
 
 /*!
@@ -21,6 +29,14 @@ class vtkPlusDataSource;
 
  Requires the PLUS_USE_V4L2 option in CMake.
 
+ With IOMethod="IO_METHOD_USERPTR" and ZeroCopy="TRUE" the driver fills the pixel arrays of the Plus buffer frames directly:
+ a dequeued frame is added to the buffer by swapping its pixel array with the array of the overwritten buffer frame, which
+ is then queued for capturing a next frame. This requires uncompressed frames without row padding, no clipping, and the
+ same input and buffer image orientation, otherwise the frames are copied into the buffer.
+
+ Frames of the MJPEG and JPEG pixel formats are decoded on NumberOfDecoderThreads threads (0 means the number of processors),
+ to RGB if the image type of the video source is RGB_COLOR, otherwise to grayscale.
+
  \ingroup PlusLibDataCollection
  */
 
@@ -63,6 +79,14 @@ public:
   vtkSetStdStringMacro(DeviceName);
   vtkGetStdStringMacro(DeviceName);
 
+  /*! If enabled then frames captured with IO_METHOD_USERPTR are added to the buffer without copying them */
+  vtkSetMacro(ZeroCopy, bool);
+  vtkGetMacro(ZeroCopy, bool);
+
+  /*! Number of threads that decode MJPEG frames. If 0 then the number of processors is used. */
+  vtkSetMacro(NumberOfDecoderThreads, int);
+  vtkGetMacro(NumberOfDecoderThreads, int);
+
 protected:
   vtkPlusV4L2VideoSource();
   ~vtkPlusV4L2VideoSource();
@@ -72,6 +96,15 @@ protected:
   PlusStatus ReadFrameFileDescriptor(unsigned int& currentBufferIndex, unsigned int& bytesUsed);
   PlusStatus ReadFrameMemoryMap(unsigned int& currentBufferIndex, unsigned int& bytesUsed);
   PlusStatus ReadFrameUserPtr(unsigned int& currentBufferIndex, unsigned int& bytesUsed);
+  /*! Dequeue a frame, add it to the buffer by swapping pixel arrays, and queue the returned array */
+  PlusStatus ReadFrameUserPtrZeroCopy();
+  /*! Store the driver timestamp of a dequeued buffer, it is used if the hardware clock is enabled */
+  void SetFrameHardwareTimestamp(const v4l2_buffer& buf);
+  /*!
+    Get the timestamps of the last dequeued frame. If the hardware clock is enabled then the driver timestamp
+    is converted to system time, otherwise the timestamps are undefined (the frame is timestamped by the buffer).
+  */
+  void GetFrameTimestamps(double& unfilteredTimestamp, double& filteredTimestamp);
 
   PlusStatus InitRead(unsigned int bufferSize);
   PlusStatus InitMmap();
@@ -102,6 +135,8 @@ protected:
   std::shared_ptr<unsigned int>       FormatHeight;
   std::shared_ptr<unsigned int>       PixelFormat;
   std::shared_ptr<v4l2_field>         FieldOrder;
+  bool                                ZeroCopy;
+  int                                 NumberOfDecoderThreads;
 
   // State variables
   int                                 FileDescriptor;
@@ -110,6 +145,15 @@ protected:
   vtkPlusDataSource*                  DataSource;
   igsioTrackedFrame::FieldMapType      FrameFields;
   std::shared_ptr<struct v4l2_format> DeviceFormat;
+  // Pixel arrays that the user pointer buffers point to in zero copy mode, empty if the buffers are allocated by malloc
+  std::vector<vtkSmartPointer<vtkDataArray> > ZeroCopyPixels;
+  // True if the captured frames are added to the buffer by swapping pixel arrays
+  bool                                ZeroCopyActive;
+  // True if the device format is MJPEG or JPEG, the frames are decoded by MjpegDecoder
+  bool                                MjpegCompressed;
+  // Driver timestamp of the last dequeued frame (start of the frame capture), UNDEFINED_TIMESTAMP if not available
+  double                              FrameHardwareTimestampSec;
+  MjpegDecoderPool                    MjpegDecoder;
 
   // Cached state variable (duplicate of DeviceFormat members, for passing to Plus functions)
   FrameSizeType                       ImageSize;
@@ -5,16 +5,26 @@ See License.txt for details.
 =========================================================Plus=header=end*/
 
 #include "PlusConfigure.h"
+#include "PlusOverloadManager.h"
+#include "PlusProfiler.h"
 #include "igsioTrackedFrame.h"
-#include "vtkIGSIOMetaImageSequenceIO.h"
 #include "vtkObjectFactory.h"
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataSource.h"
+#include "vtkPlusSequenceFileWriter.h"
 #include "vtkIGSIOSequenceIO.h"
 #include "vtkIGSIOTrackedFrameList.h"
 #include "vtkPlusVirtualCapture.h"
 #include "vtksys/SystemTools.hxx"
 
+// vtkAddon includes
+#include <vtkStreamingVolumeFrame.h>
+
+// STL includes
+#include <algorithm>
+#include <iomanip>
+#include <map>
+
 #ifdef PLUS_USE_VTKVIDEOIO_MKV
 //  #include "vtkPlusMkvSequenceIO.h"
 #endif
@@ -30,12 +40,21 @@ namespace
   static const double WARNING_RECORDING_LAG_SEC = 1.0; // if the recording lags more than this then a warning message will be displayed
   static const double MAX_ALLOWED_RECORDING_LAG_SEC = 3.0; // if the recording lags more than this then it'll skip frames to catch up
   static const unsigned int DISABLE_FRAME_BUFFER = std::numeric_limits<unsigned int>::max();
+
+  //----------------------------------------------------------------------------
+  /*! Returns true if the frames of the file are stored encoded by a video codec */
+  bool IsEncodedVideoFile(const std::string& filename)
+  {
+    std::string extension = vtksys::SystemTools::LowerCase(igsioCommon::GetSequenceFilenameExtension(filename));
+    return extension == ".mkv" || extension == ".webm";
+  }
 }
 
 //----------------------------------------------------------------------------
 vtkPlusVirtualCapture::vtkPlusVirtualCapture()
   : vtkPlusDevice()
   , RecordedFrames(vtkIGSIOTrackedFrameList::New())
+  , WriterFrames(vtkIGSIOTrackedFrameList::New())
   , LastAlreadyRecordedFrameTimestamp(UNDEFINED_TIMESTAMP)
   , NextFrameToBeRecordedTimestamp(0.0)
   , RequestedFrameRate(15.0)
@@ -47,19 +66,48 @@ vtkPlusVirtualCapture::vtkPlusVirtualCapture()
   , BaseFilename("TrackedImageSequence.nrrd")
   , Writer(NULL)
   , EnableFileCompression(false)
+  , NumberOfCompressionThreads(0)
+  , CompressionLevel(-1)
+  , SequenceFileWriter(vtkSmartPointer<vtkPlusSequenceFileWriter>::New())
+  , UseSequenceFileWriter(false)
   , IsHeaderPrepared(false)
+  , IsHeaderWritten(false)
   , TotalFramesRecorded(0)
   , EnableCapturingOnStart(false)
   , EnableCapturing(false)
+  , Critical(true)
+  , DroppingFramesForOverload(false)
+  , OverloadPolicyHandlerId(0)
   , FrameBufferSize(DISABLE_FRAME_BUFFER)
   , IsData3D(false)
   , WriterAccessMutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
+  , RecordingMutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
+  , NumberOfWriteBuffers(3)
+  , NumberOfQueuedFrames(0)
+  , StopWriterThreadRequested(false)
+  , WriterFailed(false)
+  , WriterFallingBehind(false)
+  , SkippingFramesForWriter(false)
+  , RecordedFrameSizeBytes(0)
   , GracePeriodLogLevel(vtkPlusLogger::LOG_LEVEL_DEBUG)
   , EncodingFourCC("VP90")
+  , EncodingKeyFrameInterval(-1)
+  , EncodingBitRate(-1)
+  , EncodeFrames(false)
+  , FrameEncoder(vtkSmartPointer<vtkIGSIOFrameConverter>::New())
+  , EncoderKeyFrameRequested(true)
+  , PreTriggerDurationSec(0.0)
+  , PreTriggerMaximumMemoryMB(512)
+  , PreTriggerFrames(vtkSmartPointer<vtkIGSIOTrackedFrameList>::New())
+  , FileFinalizationInProgress(false)
+  , LastFileFinalizationStatus(PLUS_SUCCESS)
+  , LastFinalizedNumberOfFrames(0)
 {
   this->AcquisitionRate = 30.0;
   this->MissingInputGracePeriodSec = 2.0;
   this->RecordedFrames->SetValidationRequirements(REQUIRE_UNIQUE_TIMESTAMP);
+  this->PreTriggerFrames->SetValidationRequirements(REQUIRE_UNIQUE_TIMESTAMP);
+  this->PreTriggerRing.SetMaximumSizeBytes(static_cast<size_t>(this->PreTriggerMaximumMemoryMB) * 1024 * 1024);
 
   // The data capture thread will be used to regularly read the frames and write to disk
   this->StartThreadForInternalUpdates = true;
@@ -68,17 +116,33 @@ vtkPlusVirtualCapture::vtkPlusVirtualCapture()
 //----------------------------------------------------------------------------
 vtkPlusVirtualCapture::~vtkPlusVirtualCapture()
 {
+  this->WaitForFileFinalization();
+
   if (IsHeaderPrepared)
   {
     this->CloseFile();
   }
 
+  this->StopWriterThread();
+
   if (RecordedFrames != NULL)
   {
     this->RecordedFrames->Delete();
     this->RecordedFrames = NULL;
   }
 
+  if (WriterFrames != NULL)
+  {
+    this->WriterFrames->Delete();
+    this->WriterFrames = NULL;
+  }
+
+  for (std::vector<vtkIGSIOTrackedFrameList*>::iterator frameListIt = this->FreeFrameLists.begin(); frameListIt != this->FreeFrameLists.end(); ++frameListIt)
+  {
+    (*frameListIt)->Delete();
+  }
+  this->FreeFrameLists.clear();
+
   if (Writer != NULL)
   {
     this->Writer->Delete();
@@ -90,6 +154,16 @@ vtkPlusVirtualCapture::~vtkPlusVirtualCapture()
 void vtkPlusVirtualCapture::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfWriteBuffers: " << this->NumberOfWriteBuffers << std::endl;
+  os << indent << "NumberOfCompressionThreads: " << this->NumberOfCompressionThreads << std::endl;
+  os << indent << "CompressionLevel: " << this->CompressionLevel << std::endl;
+  os << indent << "EncodingFourCC: " << this->EncodingFourCC << std::endl;
+  os << indent << "EncodingKeyFrameInterval: " << this->EncodingKeyFrameInterval << std::endl;
+  os << indent << "EncodingBitRate: " << this->EncodingBitRate << std::endl;
+  os << indent << "PreTriggerDurationSec: " << this->PreTriggerDurationSec << std::endl;
+  os << indent << "PreTriggerMaximumMemoryMB: " << this->PreTriggerMaximumMemoryMB << std::endl;
+  os << indent << "NumberOfFramesWaitingForWrite: " << this->GetNumberOfFramesWaitingForWrite() << std::endl;
+  os << indent << "WriterFallingBehind: " << (this->IsWriterFallingBehind() ? "TRUE" : "FALSE") << std::endl;
 }
 
 //----------------------------------------------------------------------------
@@ -106,9 +180,17 @@ PlusStatus vtkPlusVirtualCapture::ReadConfiguration(vtkXMLDataElement* rootConfi
   XML_READ_STRING_ATTRIBUTE_OPTIONAL(BaseFilename, deviceConfig);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(EnableFileCompression, deviceConfig);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(EnableCapturingOnStart, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(Critical, deviceConfig);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, RequestedFrameRate, deviceConfig);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, FrameBufferSize, deviceConfig);
   XML_READ_STRING_ATTRIBUTE_OPTIONAL(EncodingFourCC, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfWriteBuffers, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfCompressionThreads, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, CompressionLevel, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, EncodingKeyFrameInterval, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, EncodingBitRate, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, PreTriggerDurationSec, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, PreTriggerMaximumMemoryMB, deviceConfig);
 
   return PLUS_SUCCESS;
 }
@@ -120,7 +202,15 @@ PlusStatus vtkPlusVirtualCapture::WriteConfiguration(vtkXMLDataElement* rootConf
   deviceElement->SetAttribute("EnableCapturing", this->EnableCapturing ? "TRUE" : "FALSE");
   deviceElement->SetAttribute("EnableFileCompression", this->EnableFileCompression ? "TRUE" : "FALSE");
   deviceElement->SetAttribute("EnableCaptureOnStart", this->EnableCapturingOnStart ? "TRUE" : "FALSE");
+  XML_WRITE_BOOL_ATTRIBUTE(Critical, deviceElement);
   deviceElement->SetDoubleAttribute("RequestedFrameRate", this->GetRequestedFrameRate());
+  deviceElement->SetIntAttribute("NumberOfWriteBuffers", this->GetNumberOfWriteBuffers());
+  deviceElement->SetIntAttribute("NumberOfCompressionThreads", this->GetNumberOfCompressionThreads());
+  deviceElement->SetIntAttribute("CompressionLevel", this->GetCompressionLevel());
+  deviceElement->SetIntAttribute("EncodingKeyFrameInterval", this->GetEncodingKeyFrameInterval());
+  deviceElement->SetIntAttribute("EncodingBitRate", this->GetEncodingBitRate());
+  deviceElement->SetDoubleAttribute("PreTriggerDurationSec", this->GetPreTriggerDurationSec());
+  deviceElement->SetIntAttribute("PreTriggerMaximumMemoryMB", this->GetPreTriggerMaximumMemoryMB());
 
   return PLUS_SUCCESS;
 }
@@ -129,6 +219,8 @@ PlusStatus vtkPlusVirtualCapture::WriteConfiguration(vtkXMLDataElement* rootConf
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusVirtualCapture::InternalConnect()
 {
+  this->StartWriterThread();
+
   if (OpenFile() != PLUS_SUCCESS)
   {
     return PLUS_FAIL;
@@ -141,38 +233,53 @@ PlusStatus vtkPlusVirtualCapture::InternalConnect()
 
   this->LastUpdateTime = vtkIGSIOAccurateTimer::GetSystemTime();
 
+  if (!this->Critical && this->OverloadPolicyHandlerId == 0)
+  {
+    this->OverloadPolicyHandlerId = OverloadManager::GetInstance().AddPolicyHandler(OverloadManager::POLICY_DROP_NON_CRITICAL_CAPTURE, [this](bool apply)
+    {
+      if (apply)
+      {
+        LOG_WARNING(this->GetDeviceId() << ": System is overloaded, input frames are dropped until the load decreases");
+      }
+      else
+      {
+        LOG_INFO(this->GetDeviceId() << ": Input frames are recorded again");
+      }
+      this->DroppingFramesForOverload = apply;
+    });
+  }
+
   return PLUS_SUCCESS;
 }
 
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusVirtualCapture::InternalDisconnect()
 {
-  this->EnableCapturing = false;
-
-  // If outstanding frames to be written, deal with them
-  if (this->RecordedFrames->GetNumberOfTrackedFrames() != 0 && this->IsHeaderPrepared)
+  if (this->OverloadPolicyHandlerId != 0)
   {
-    if (this->Writer->AppendImagesToHeader() != PLUS_SUCCESS)
-    {
-      LOG_ERROR("Unable to append image data to header.");
-      this->Disconnect();
-      return PLUS_FAIL;
-    }
-    if (this->Writer->WriteImages() != PLUS_SUCCESS)
-    {
-      LOG_ERROR("Unable to append images. Stopping recording at timestamp: " << this->LastAlreadyRecordedFrameTimestamp);
-      this->Disconnect();
-      return PLUS_FAIL;
-    }
-
-    this->ClearRecordedFrames();
+    OverloadManager::GetInstance().RemovePolicyHandler(this->OverloadPolicyHandlerId);
+    this->OverloadPolicyHandlerId = 0;
+    this->DroppingFramesForOverload = false;
   }
+
+  this->WaitForFileFinalization();
+  this->EnableCapturing = false;
+
+  // Outstanding frames are written when the file is closed
   PlusStatus status = this->CloseFile();
+  this->StopWriterThread();
   return status;
 }
 
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusVirtualCapture::OpenFile(const char* aFilename)
+{
+  this->WaitForFileFinalization();
+  return this->OpenFileInternal(aFilename);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualCapture::OpenFileInternal(const char* aFilename)
 {
   igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->WriterAccessMutex);
 
@@ -185,26 +292,18 @@ PlusStatus vtkPlusVirtualCapture::OpenFile(const char* aFilename)
       // default to nrrd
       ext = ".nrrd";
     }
-    else if (vtkIGSIOMetaImageSequenceIO::CanWriteFile(this->BaseFilename) && this->GetEnableFileCompression())
-    {
-      // they've requested mhd/mha with compression, no can do, yet
-      LOG_WARNING("Compressed saving of metaimage file requested. This is not supported. Reverting to uncompressed metaimage file.");
-      this->SetEnableFileCompression(false);
-    }
     this->CurrentFilename = filenameRoot + "_" + vtksys::SystemTools::GetCurrentDateTime("%Y%m%d_%H%M%S") + ext;
     aFilename = this->CurrentFilename.c_str();
   }
   else
   {
-    if (vtkIGSIOMetaImageSequenceIO::CanWriteFile(aFilename) && this->GetEnableFileCompression())
-    {
-      // they've requested mhd/mha with compression, no can do, yet
-      LOG_WARNING("Compressed saving of metaimage file requested. This is not supported. Reverting to uncompressed metaimage file.");
-      this->SetEnableFileCompression(false);
-    }
     this->CurrentFilename = aFilename;
   }
 
+  if (this->Writer != NULL)
+  {
+    this->Writer->Delete();
+  }
   this->Writer = vtkIGSIOSequenceIO::CreateSequenceHandlerForFile(aFilename);
   if (!this->Writer)
   {
@@ -212,7 +311,14 @@ PlusStatus vtkPlusVirtualCapture::OpenFile(const char* aFilename)
     return PLUS_FAIL;
   }
   this->Writer->SetUseCompression(this->EnableFileCompression);
-  this->Writer->SetTrackedFrameList(this->RecordedFrames);
+  this->Writer->SetTrackedFrameList(this->WriterFrames);
+  this->IsHeaderWritten = false;
+  this->EncodeFrames = !this->EncodingFourCC.empty() && IsEncodedVideoFile(aFilename);
+  {
+    std::lock_guard<std::mutex> queueLock(this->WriteQueueMutex);
+    this->WriterFailed = false;
+    this->EncoderKeyFrameRequested = true;
+  }
   // Need to set the filename before finalizing header, because the pixel data file name depends on the file extension
   this->Writer->SetFileName(vtkPlusConfig::GetInstance()->GetOutputPath(aFilename));
 
@@ -222,8 +328,14 @@ PlusStatus vtkPlusVirtualCapture::OpenFile(const char* aFilename)
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusVirtualCapture::CloseFile(const char* aFilename /* = NULL */, std::string* resultFilename /* = NULL */)
 {
-  // Fix the header to write the correct number of frames
-  igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->WriterAccessMutex);
+  this->WaitForFileFinalization();
+  return this->FinalizeFile(aFilename, resultFilename);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualCapture::FinalizeFile(const char* aFilename, std::string* resultFilename)
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> recordingLock(this->RecordingMutex);
 
   if (!this->IsHeaderPrepared)
   {
@@ -231,6 +343,12 @@ PlusStatus vtkPlusVirtualCapture::CloseFile(const char* aFilename /* = NULL */,
     return PLUS_SUCCESS;
   }
 
+  // Wait until the writer thread writes all the queued frames (the writer lock must not be held while waiting)
+  this->WaitForWriteQueue();
+
+  // Fix the header to write the correct number of frames
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->WriterAccessMutex);
+
   if (aFilename != NULL && strlen(aFilename) != 0)
   {
     // Need to set the filename before finalizing header, because the pixel data file name depends on the file extension
@@ -244,17 +362,55 @@ PlusStatus vtkPlusVirtualCapture::CloseFile(const char* aFilename /* = NULL */,
     this->WriteFrames(true);
   }
 
-  this->Writer->UpdateDimensionsCustomStrings(this->TotalFramesRecorded, this->GetIsData3D());
-  this->Writer->UpdateFieldInImageHeader(this->Writer->GetDimensionSizeString());
-  this->Writer->UpdateFieldInImageHeader(this->Writer->GetDimensionKindsString());
-  this->Writer->FinalizeHeader();
+  if (!this->IsHeaderWritten)
+  {
+    LOG_ERROR(this->GetDeviceId() << ": No frames could be written to file " << this->CurrentFilename);
+    this->IsHeaderPrepared = false;
+    this->TotalFramesRecorded = 0;
+    this->ClearRecordedFrames();
+    this->OpenFileInternal();
+    return PLUS_FAIL;
+  }
+
+  if (this->UseSequenceFileWriter)
+  {
+    // Custom header fields may have been set since the last frames were written
+    PlusStatus status = this->SequenceFileWriter->AppendFrames(this->WriterFrames);
+    if (status == PLUS_SUCCESS)
+    {
+      status = this->SequenceFileWriter->Close(std::string(this->Writer->GetFileName()));
+    }
+    else
+    {
+      this->SequenceFileWriter->Discard();
+    }
+    if (status != PLUS_SUCCESS)
+    {
+      LOG_ERROR(this->GetDeviceId() << ": Failed to write file " << this->CurrentFilename);
+      this->IsHeaderPrepared = false;
+      this->IsHeaderWritten = false;
+      this->TotalFramesRecorded = 0;
+      this->OpenFileInternal();
+      return PLUS_FAIL;
+    }
+  }
+  else
+  {
+    this->Writer->UpdateDimensionsCustomStrings(this->TotalFramesRecorded, this->GetIsData3D());
+    this->Writer->UpdateFieldInImageHeader(this->Writer->GetDimensionSizeString());
+    this->Writer->UpdateFieldInImageHeader(this->Writer->GetDimensionKindsString());
+    this->Writer->FinalizeHeader();
+  }
 
   if (resultFilename != NULL)
   {
     (*resultFilename) = this->Writer->GetFileName();
   }
 
-  this->Writer->Close();
+  if (!this->UseSequenceFileWriter)
+  {
+    this->Writer->Close();
+  }
 
   std::string fullPath = vtkPlusConfig::GetInstance()->GetOutputPath(this->CurrentFilename);
   std::string path = vtksys::SystemTools::GetFilenamePath(fullPath);
@@ -264,9 +420,9 @@ PlusStatus vtkPlusVirtualCapture::CloseFile(const char* aFilename /* = NULL */,
 
   this->IsHeaderPrepared = false;
   this->TotalFramesRecorded = 0;
-  this->RecordedFrames->Clear();
+  this->ClearRecordedFrames();
 
-  if (this->OpenFile() != PLUS_SUCCESS)
+  if (this->OpenFileInternal() != PLUS_SUCCESS)
   {
     return PLUS_FAIL;
   }
@@ -274,11 +430,112 @@ PlusStatus vtkPlusVirtualCapture::CloseFile(const char* aFilename /* = NULL */,
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualCapture::CloseFileInBackground(const char* aFilename, const FileFinalizedCallback& completedCallback)
+{
+  std::lock_guard<std::mutex> threadLock(this->FileFinalizationThreadMutex);
+  // Only one file is finalized at a time
+  if (this->FileFinalizationThread.joinable())
+  {
+    this->FileFinalizationThread.join();
+  }
+
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> recordingLock(this->RecordingMutex);
+    if (this->EnableCapturing)
+    {
+      LOG_ERROR(this->GetDeviceId() << ": The file cannot be closed while capturing is enabled");
+      return PLUS_FAIL;
+    }
+    // The finalizer thread waits until the writer thread writes them, instead of writing them with the recorded frames locked
+    if (this->RecordedFrames->GetNumberOfTrackedFrames() > 0)
+    {
+      this->SetIsData3D(this->RecordedFrames->GetTrackedFrame(0)->GetFrameSize()[2] > 1);
+      this->QueueRecordedFrames();
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> statusLock(this->FileFinalizationStatusMutex);
+    this->FileFinalizationInProgress = true;
+  }
+  this->FileFinalizationThread = std::thread(&vtkPlusVirtualCapture::FileFinalizationThreadFunction, this,
+                                             std::string(aFilename != NULL ? aFilename : ""), completedCallback);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusVirtualCapture::FileFinalizationThreadFunction(std::string filename, FileFinalizedCallback completedCallback)
+{
+  PLUS_PROFILE_THREAD_NAME(this->GetDeviceId() + " finalizer");
+  long numberOfFrames = 0;
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> recordingLock(this->RecordingMutex);
+    numberOfFrames = this->TotalFramesRecorded;
+  }
+  // Reported if the finalization fails, otherwise the actual name of the written file is reported
+  std::string requestedFilename;
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->WriterAccessMutex);
+    requestedFilename = vtkPlusConfig::GetInstance()->GetOutputPath(filename.empty() ? this->CurrentFilename : filename);
+  }
+
+  // Most of the frames are written while the recorded frames are not locked, so the pre-trigger ring is updated meanwhile
+  this->WaitForWriteQueue();
+
+  std::string resultFilename;
+  PlusStatus status = this->FinalizeFile(filename.empty() ? NULL : filename.c_str(), &resultFilename);
+  if (status != PLUS_SUCCESS)
+  {
+    resultFilename = requestedFilename;
+  }
+  LOG_INFO(this->GetDeviceId() << ": Finalization of file " << resultFilename << " " << (status == PLUS_SUCCESS ? "completed" : "failed"));
+
+  {
+    std::lock_guard<std::mutex> statusLock(this->FileFinalizationStatusMutex);
+    this->FileFinalizationInProgress = false;
+    this->LastFileFinalizationStatus = status;
+    this->LastFinalizedFilename = resultFilename;
+    this->LastFinalizedNumberOfFrames = numberOfFrames;
+  }
+
+  if (completedCallback)
+  {
+    completedCallback(status, resultFilename, numberOfFrames);
+  }
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusVirtualCapture::IsFileFinalizationInProgress()
+{
+  std::lock_guard<std::mutex> statusLock(this->FileFinalizationStatusMutex);
+  return this->FileFinalizationInProgress;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusVirtualCapture::GetLastFileFinalizationResult(PlusStatus& status, std::string& resultFilename, long& numberOfFrames)
+{
+  std::lock_guard<std::mutex> statusLock(this->FileFinalizationStatusMutex);
+  status = this->LastFileFinalizationStatus;
+  resultFilename = this->LastFinalizedFilename;
+  numberOfFrames = this->LastFinalizedNumberOfFrames;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusVirtualCapture::WaitForFileFinalization()
+{
+  std::lock_guard<std::mutex> threadLock(this->FileFinalizationThreadMutex);
+  if (this->FileFinalizationThread.joinable())
+  {
+    this->FileFinalizationThread.join();
+  }
+}
+
 //----------------------------------------------------------------------------
 
 PlusStatus vtkPlusVirtualCapture::InternalUpdate()
 {
-  if (!this->EnableCapturing)
+  if (!this->EnableCapturing && this->PreTriggerDurationSec <= 0)
   {
     // Capturing is disabled
     return PLUS_SUCCESS;
@@ -330,12 +587,53 @@ PlusStatus vtkPlusVirtualCapture::InternalUpdate()
     this->GracePeriodLogLevel = vtkPlusLogger::LOG_LEVEL_WARNING;
   }
 
-  igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->WriterAccessMutex);
+  // Only the recorded frames are locked, writing to the file happens on the writer thread
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> recordingLock(this->RecordingMutex);
   if (!this->EnableCapturing)
   {
-    // While this thread was waiting for the unlock, capturing was disabled, so cancel the update now
-    return PLUS_SUCCESS;
+    // While this thread was waiting for the unlock, capturing may have been disabled, so only the pre-trigger ring is updated now
+    PlusStatus status = (this->PreTriggerDurationSec > 0 ? this->UpdatePreTriggerRing(requestedFramePeriodSec, maxProcessingTimeSec) : PLUS_SUCCESS);
+    this->LastUpdateTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    return status;
+  }
+
+  // If the writer cannot keep up then recorded frames are kept in memory, but not more than a few seconds of them
+  int numberOfRecordedFrames = this->RecordedFrames->GetNumberOfTrackedFrames();
+  double waitingFramesSec = 0.0;
+  if (numberOfRecordedFrames > 1)
+  {
+    waitingFramesSec = this->RecordedFrames->GetTrackedFrame(numberOfRecordedFrames - 1)->GetTimestamp() - this->RecordedFrames->GetTrackedFrame(0)->GetTimestamp();
+  }
+  // Non-critical captures give way to tracking and imaging while the system is overloaded
+  if (this->DroppingFramesForOverload)
+  {
+    this->NextFrameToBeRecordedTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+    this->LastUpdateTime = this->NextFrameToBeRecordedTimestamp;
+    return this->WriteFrames();
+  }
+
+  // Frames are not kept in memory for the writer if the memory usage soft limit is exceeded
+  bool memorySoftLimitExceeded = MemoryAccounting::GetInstance().IsSoftLimitExceeded();
+  if ((waitingFramesSec > MAX_ALLOWED_RECORDING_LAG_SEC || memorySoftLimitExceeded) && this->IsWriterFallingBehind())
+  {
+    if (!this->SkippingFramesForWriter)
+    {
+      if (memorySoftLimitExceeded)
+      {
+        LOG_ERROR(this->GetDeviceId() << ": Memory usage soft limit is exceeded while writing to file cannot keep up with the recording. Skip input frames until writing catches up.");
+      }
+      else
+      {
+        LOG_ERROR(this->GetDeviceId() << ": Writing to file cannot keep up with the recording, " << waitingFramesSec << " seconds of frames wait for writing. Skip input frames until writing catches up.");
+      }
+      this->SkippingFramesForWriter = true;
+    }
+    this->NextFrameToBeRecordedTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+    this->LastUpdateTime = this->NextFrameToBeRecordedTimestamp;
+    // Pass the frames to the writer as soon as a frame list is freed up
+    return this->WriteFrames();
   }
+  this->SkippingFramesForWriter = false;
 
   int nbFramesBefore = this->RecordedFrames->GetNumberOfTrackedFrames();
   if (this->GetInputTrackedFrameListSampled(this->LastAlreadyRecordedFrameTimestamp, this->NextFrameToBeRecordedTimestamp, this->RecordedFrames, requestedFramePeriodSec, maxProcessingTimeSec) != PLUS_SUCCESS)
@@ -418,6 +716,30 @@ PlusStatus vtkPlusVirtualCapture::InternalUpdate()
   return PLUS_SUCCESS;
 }
 
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualCapture::UpdatePreTriggerRing(double requestedFramePeriodSec, double maxProcessingTimeSec)
+{
+  // Same sampling as the recording, so recording continues after the last frame of the ring when capturing is enabled
+  this->PreTriggerFrames->Clear();
+  PlusStatus status = this->GetInputTrackedFrameListSampled(this->LastAlreadyRecordedFrameTimestamp, this->NextFrameToBeRecordedTimestamp,
+                      this->PreTriggerFrames, requestedFramePeriodSec, maxProcessingTimeSec);
+  if (status != PLUS_SUCCESS)
+  {
+    LOG_DYNAMIC("Unable to get frames for the pre-trigger ring of " << this->GetDeviceId(), this->GracePeriodLogLevel);
+  }
+  this->PreTriggerRing.SetNumberOfThreads(this->NumberOfCompressionThreads);
+  for (unsigned int frameIndex = 0; frameIndex < this->PreTriggerFrames->GetNumberOfTrackedFrames(); ++frameIndex)
+  {
+    if (this->PreTriggerRing.AddFrame(*this->PreTriggerFrames->GetTrackedFrame(frameIndex)) != PLUS_SUCCESS)
+    {
+      status = PLUS_FAIL;
+    }
+  }
+  // Frames share the pixels of the input buffer, release them now
+  this->PreTriggerFrames->Clear();
+  return status;
+}
+
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusVirtualCapture::NotifyConfigured()
 {
@@ -470,6 +792,8 @@ void vtkPlusVirtualCapture::InternalWriteOutputChannels(vtkXMLDataElement* rootX
 //----------------------------------------------------------------------------
 void vtkPlusVirtualCapture::SetEnableFileCompression(bool aFileCompression)
 {
+  this->WaitForFileFinalization();
+
   if (this->Writer != NULL)
   {
     this->Writer->SetUseCompression(aFileCompression);
@@ -481,35 +805,99 @@ void vtkPlusVirtualCapture::SetEnableFileCompression(bool aFileCompression)
 //-----------------------------------------------------------------------------
 void vtkPlusVirtualCapture::SetEnableCapturing(bool aValue)
 {
-  this->EnableCapturing = aValue;
+  if (aValue)
+  {
+    // Frames of the next recording must not be written to the file that is being finalized
+    this->WaitForFileFinalization();
+  }
 
-  if (this->EnableCapturing)
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> recordingLock(this->RecordingMutex);
+
+  if (aValue)
   {
     this->LastUpdateTime = 0.0;
     this->TimeWaited = 0.0;
-    this->LastAlreadyRecordedFrameTimestamp = UNDEFINED_TIMESTAMP;
-    this->NextFrameToBeRecordedTimestamp = 0.0;
     this->FirstFrameIndexInThisSegment = this->RecordedFrames->GetNumberOfTrackedFrames();
     this->RecordingStartTime = vtkIGSIOAccurateTimer::GetSystemTime(); // reset the starting time for the grace period
+    if (this->PreTriggerRing.GetNumberOfFrames() > 0)
+    {
+      // Record the frames of the pre-trigger ring, recording continues from the next frame after them
+      int numberOfFramesBefore = this->RecordedFrames->GetNumberOfTrackedFrames();
+      double ringDurationSec = this->PreTriggerRing.GetLatestTimestamp() - this->PreTriggerRing.GetOldestTimestamp();
+      if (this->PreTriggerRing.MoveFrames(this->RecordedFrames) != PLUS_SUCCESS)
+      {
+        LOG_ERROR(this->GetDeviceId() << ": Some frames of the pre-trigger ring could not be recorded");
+      }
+      this->TotalFramesRecorded += this->RecordedFrames->GetNumberOfTrackedFrames() - numberOfFramesBefore;
+      LOG_INFO(this->GetDeviceId() << ": Recording starts with " << this->RecordedFrames->GetNumberOfTrackedFrames() - numberOfFramesBefore
+               << " frames (" << std::fixed << std::setprecision(1) << ringDurationSec << " seconds) of the pre-trigger ring");
+    }
+    else
+    {
+      this->LastAlreadyRecordedFrameTimestamp = UNDEFINED_TIMESTAMP;
+      this->NextFrameToBeRecordedTimestamp = 0.0;
+    }
+  }
+  else
+  {
+    // The pre-trigger ring starts after the recorded frames
+    this->PreTriggerRing.Clear();
+  }
+
+  this->EnableCapturing = aValue;
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualCapture::SetPreTriggerDurationSec(double durationSec)
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> recordingLock(this->RecordingMutex);
+  this->PreTriggerDurationSec = durationSec;
+  this->PreTriggerRing.SetDurationSec(durationSec);
+  if (durationSec <= 0)
+  {
+    this->PreTriggerRing.Clear();
   }
 }
 
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualCapture::SetPreTriggerMaximumMemoryMB(int maximumMemoryMB)
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> recordingLock(this->RecordingMutex);
+  this->PreTriggerMaximumMemoryMB = maximumMemoryMB;
+  this->PreTriggerRing.SetMaximumSizeBytes(static_cast<size_t>(std::max(maximumMemoryMB, 1)) * 1024 * 1024);
+}
+
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusVirtualCapture::Reset()
 {
+  this->WaitForFileFinalization();
+
   {
-    igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->WriterAccessMutex);
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> recordingLock(this->RecordingMutex);
 
     this->SetEnableCapturing(false);
 
-    if (this->IsHeaderPrepared)
+    // Drop the frames that are not written yet, the frame list that is being written is completed before discarding the file
+    this->WaitForWriteQueue(true);
+
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->WriterAccessMutex);
+
+    if (this->IsHeaderWritten)
     {
-      this->Writer->Discard();
+      if (this->UseSequenceFileWriter)
+      {
+        this->SequenceFileWriter->Discard();
+      }
+      else
+      {
+        this->Writer->Discard();
+      }
     }
 
     this->ClearRecordedFrames();
     this->Writer->GetTrackedFrameList()->Clear();
     this->IsHeaderPrepared = false;
+    this->IsHeaderWritten = false;
     this->TotalFramesRecorded = 0;
   }
 
@@ -539,6 +927,8 @@ PlusStatus vtkPlusVirtualCapture::TakeSnapshot()
     return PLUS_FAIL;
   }
 
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> recordingLock(this->RecordingMutex);
+
   igsioTrackedFrame trackedFrame;
   if (this->GetInputTrackedFrame(trackedFrame) != PLUS_SUCCESS)
   {
@@ -598,21 +988,23 @@ PlusStatus vtkPlusVirtualCapture::TakeSnapshot()
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusVirtualCapture::SetCustomHeaderField(const std::string& fieldName, const std::string& fieldValue)
 {
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->WriterAccessMutex);
   return this->Writer->GetTrackedFrameList()->SetCustomString(fieldName, fieldValue);
 }
 
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusVirtualCapture::WriteFrames(bool force)
 {
-  if (!this->IsHeaderPrepared && this->RecordedFrames->GetNumberOfTrackedFrames() != 0)
+  bool writerFailed = false;
   {
-    if (this->Writer->PrepareHeader() != PLUS_SUCCESS)
-    {
-      LOG_ERROR("Unable to prepare header");
-      this->StopRecording();
-      return PLUS_FAIL;
-    }
-    this->IsHeaderPrepared = true;
+    std::lock_guard<std::mutex> queueLock(this->WriteQueueMutex);
+    writerFailed = this->WriterFailed;
+  }
+  if (writerFailed)
+  {
+    LOG_ERROR("Unable to write frames to file. Stopping recording at timestamp: " << LastAlreadyRecordedFrameTimestamp);
+    this->StopRecording();
+    return PLUS_FAIL;
   }
 
   if (this->RecordedFrames->GetNumberOfTrackedFrames() == 0)
@@ -622,28 +1014,398 @@ PlusStatus vtkPlusVirtualCapture::WriteFrames(bool force)
 
   this->SetIsData3D(this->RecordedFrames->GetTrackedFrame(0)->GetFrameSize()[2] > 1);
 
-  if (force || !this->IsFrameBuffered() ||
+  // The first frames are passed to the writer immediately, because the header is prepared from them
+  if (force || !this->IsHeaderPrepared || !this->IsFrameBuffered() ||
       (this->IsFrameBuffered() && this->RecordedFrames->GetNumberOfTrackedFrames() > this->GetFrameBufferSize()))
   {
-    if (this->Writer->AppendImagesToHeader() != PLUS_SUCCESS)
+    if (!force)
     {
-      LOG_ERROR("Unable to append image data to header.");
-      this->StopRecording();
-      return PLUS_FAIL;
+      return this->QueueRecordedFrames();
     }
-    if (this->Writer->WriteImages() != PLUS_SUCCESS)
+
+    // Write on this thread, after the queued frames
+    this->WaitForWriteQueue();
+    this->IsHeaderPrepared = true;
+    PlusStatus status = (this->EncodeFrames ? this->EncodeFrameList(this->RecordedFrames) : PLUS_SUCCESS);
+    if (status == PLUS_SUCCESS)
+    {
+      status = this->WriteFrameList(this->RecordedFrames);
+    }
+    this->ClearRecordedFrames();
+    if (status != PLUS_SUCCESS)
     {
       LOG_ERROR("Unable to append images. Stopping recording at timestamp: " << LastAlreadyRecordedFrameTimestamp);
       this->StopRecording();
       return PLUS_FAIL;
     }
+  }
 
-    this->ClearRecordedFrames();
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualCapture::QueueRecordedFrames()
+{
+  if (!this->WriterThread.joinable())
+  {
+    // The device is not connected, there is no writer thread
+    return this->WriteFrames(true);
+  }
+
+  std::lock_guard<std::mutex> queueLock(this->WriteQueueMutex);
+  if (this->FreeFrameLists.empty())
+  {
+    // All the frame lists wait for writing, keep collecting frames in the current one
+    if (!this->WriterFallingBehind)
+    {
+      LOG_WARNING(this->GetDeviceId() << ": Writing to file cannot keep up with the recording, " << this->NumberOfQueuedFrames << " frames wait for writing.");
+      this->WriterFallingBehind = true;
+    }
+    return PLUS_SUCCESS;
   }
+  this->WriterFallingBehind = false;
 
+  this->NumberOfQueuedFrames += this->RecordedFrames->GetNumberOfTrackedFrames();
+  if (this->EncodeFrames)
+  {
+    this->EncodeQueue.push_back(this->RecordedFrames);
+  }
+  else
+  {
+    this->WriteQueue.push_back(this->RecordedFrames);
+  }
+  this->RecordedFrames = this->FreeFrameLists.back();
+  this->FreeFrameLists.pop_back();
+  this->IsHeaderPrepared = true;
+  this->WriteQueueCondition.notify_all();
   return PLUS_SUCCESS;
 }
 
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualCapture::WriteFrameList(vtkIGSIOTrackedFrameList* frameList)
+{
+  PLUS_PROFILE_SCOPE_DETAIL("vtkPlusVirtualCapture::WriteFrameList", this->GetDeviceId());
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->WriterAccessMutex);
+
+  if (frameList->GetNumberOfTrackedFrames() == 0)
+  {
+    return PLUS_SUCCESS;
+  }
+  if (this->Writer == NULL)
+  {
+    LOG_ERROR("Unable to write frames, the output file is not open");
+    return PLUS_FAIL;
+  }
+
+  // The writer always writes its own frame list, which holds the custom header fields
+  if (this->WriterFrames->AddTrackedFrameList(frameList) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to copy frames for writing.");
+    this->WriterFrames->Clear();
+    return PLUS_FAIL;
+  }
+
+  PlusStatus status = PLUS_SUCCESS;
+  if (!this->IsHeaderWritten)
+  {
+    // Compressed MetaImage files are written with multithreaded compression
+    std::string fileName = this->Writer->GetFileName();
+    this->UseSequenceFileWriter = this->EnableFileCompression && vtkPlusSequenceFileWriter::CanWriteFile(fileName);
+    if (this->UseSequenceFileWriter)
+    {
+      this->SequenceFileWriter->SetUseCompression(true);
+      this->SequenceFileWriter->SetNumberOfThreads(this->NumberOfCompressionThreads);
+      this->SequenceFileWriter->SetCompressionLevel(this->CompressionLevel);
+      status = this->SequenceFileWriter->Open(fileName);
+    }
+    else
+    {
+      status = this->Writer->PrepareHeader();
+    }
+    if (status == PLUS_SUCCESS)
+    {
+      this->IsHeaderWritten = true;
+    }
+    else
+    {
+      LOG_ERROR("Unable to prepare header");
+    }
+  }
+  if (this->UseSequenceFileWriter)
+  {
+    if (status == PLUS_SUCCESS && this->SequenceFileWriter->AppendFrames(this->WriterFrames) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Unable to append images.");
+      status = PLUS_FAIL;
+    }
+    this->WriterFrames->Clear();
+    return status;
+  }
+  if (status == PLUS_SUCCESS && this->Writer->AppendImagesToHeader() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to append image data to header.");
+    status = PLUS_FAIL;
+  }
+  if (status == PLUS_SUCCESS && this->Writer->WriteImages() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to append images.");
+    status = PLUS_FAIL;
+  }
+
+  this->WriterFrames->Clear();
+  return status;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualCapture::EncodeFrameList(vtkIGSIOTrackedFrameList* frameList)
+{
+  PLUS_PROFILE_SCOPE_DETAIL("vtkPlusVirtualCapture::EncodeFrameList", this->GetDeviceId());
+  std::map<std::string, std::string> parameters;
+  if (this->EncodingKeyFrameInterval > 0)
+  {
+    parameters["minimumKeyFrameDistance"] = "1";
+    parameters["maximumKeyFrameDistance"] = igsioCommon::ToString(this->EncodingKeyFrameInterval);
+  }
+  if (this->EncodingBitRate > 0)
+  {
+    parameters["losslessEncoding"] = "0";
+    parameters["bitRate"] = igsioCommon::ToString(this->EncodingBitRate);
+  }
+
+  // Number of frames at the beginning of the list that were encoded before the first key frame of the file
+  unsigned int numberOfUndecodableFrames = 0;
+  for (unsigned int frameIndex = 0; frameIndex < frameList->GetNumberOfTrackedFrames(); ++frameIndex)
+  {
+    igsioVideoFrame* image = frameList->GetTrackedFrame(frameIndex)->GetImageData();
+    if (image->IsFrameEncoded() && image->GetEncodedFrame() != NULL)
+    {
+      // The frame has been encoded already (e.g., by vtkPlusVirtualVideoEncoder), it is written as is
+      if (image->GetEncodedFrame()->GetCodecFourCC() != this->EncodingFourCC)
+      {
+        LOG_ERROR(this->GetDeviceId() << ": Frame is encoded with codec " << image->GetEncodedFrame()->GetCodecFourCC() << " instead of " << this->EncodingFourCC);
+        return PLUS_FAIL;
+      }
+      std::lock_guard<std::mutex> queueLock(this->WriteQueueMutex);
+      if (this->EncoderKeyFrameRequested)
+      {
+        if (image->GetEncodedFrame()->GetFrameType() != vtkStreamingVolumeFrame::IFrame)
+        {
+          numberOfUndecodableFrames = frameIndex + 1;
+          continue;
+        }
+        this->EncoderKeyFrameRequested = false;
+      }
+      continue;
+    }
+    if (!image->IsImageValid())
+    {
+      continue;
+    }
+    {
+      std::lock_guard<std::mutex> queueLock(this->WriteQueueMutex);
+      if (this->EncoderKeyFrameRequested)
+      {
+        this->FrameEncoder->RequestKeyFrameOn();
+        this->EncoderKeyFrameRequested = false;
+      }
+    }
+    // The encoded frame is attached to the image, so it is written with the fields of its own tracked frame
+    vtkSmartPointer<vtkStreamingVolumeFrame> encodedFrame = this->FrameEncoder->GetEncodedFrame(image, this->EncodingFourCC, parameters);
+    if (encodedFrame == NULL)
+    {
+      LOG_ERROR(this->GetDeviceId() << ": Unable to encode frame with codec " << this->EncodingFourCC);
+      return PLUS_FAIL;
+    }
+    image->SetEncodedFrame(encodedFrame);
+  }
+  if (numberOfUndecodableFrames > 0)
+  {
+    LOG_DEBUG(this->GetDeviceId() << ": " << numberOfUndecodableFrames << " encoded frames before the first key frame are not written");
+    frameList->RemoveTrackedFrameRange(0, numberOfUndecodableFrames - 1);
+  }
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualCapture::StartWriterThread()
+{
+  if (this->WriterThread.joinable())
+  {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> queueLock(this->WriteQueueMutex);
+    this->StopWriterThreadRequested = false;
+    this->WriterFallingBehind = false;
+    // RecordedFrames is one of the write buffers
+    while (static_cast<int>(this->FreeFrameLists.size()) < this->NumberOfWriteBuffers - 1)
+    {
+      vtkIGSIOTrackedFrameList* frameList = vtkIGSIOTrackedFrameList::New();
+      frameList->SetValidationRequirements(REQUIRE_UNIQUE_TIMESTAMP);
+      this->FreeFrameLists.push_back(frameList);
+    }
+  }
+  this->WriterThread = std::thread(&vtkPlusVirtualCapture::WriterThreadFunction, this);
+  this->EncoderThread = std::thread(&vtkPlusVirtualCapture::EncoderThreadFunction, this);
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualCapture::StopWriterThread()
+{
+  if (!this->WriterThread.joinable())
+  {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> queueLock(this->WriteQueueMutex);
+    this->StopWriterThreadRequested = true;
+    this->WriteQueueCondition.notify_all();
+  }
+  // The threads encode and write all the queued frames before they exit
+  this->EncoderThread.join();
+  this->WriterThread.join();
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualCapture::WriterThreadFunction()
+{
+  PLUS_PROFILE_THREAD_NAME(this->GetDeviceId() + " writer");
+  std::unique_lock<std::mutex> queueLock(this->WriteQueueMutex);
+  while (true)
+  {
+    // Frame lists that are being encoded are written before the thread stops
+    this->WriteQueueCondition.wait(queueLock, [this]() { return (this->StopWriterThreadRequested && this->EncodeQueue.empty()) || !this->WriteQueue.empty(); });
+    if (this->WriteQueue.empty())
+    {
+      // stop is requested and all frames are written
+      break;
+    }
+
+    // The frame list stays in the queue while it is written, so the queue is empty only if the writer is idle
+    vtkIGSIOTrackedFrameList* frameList = this->WriteQueue.front();
+    bool writerFailed = this->WriterFailed;
+    queueLock.unlock();
+
+    // After a failure the frames are dropped, the recording is stopped by the device thread
+    PlusStatus status = (writerFailed ? PLUS_FAIL : this->WriteFrameList(frameList));
+    int numberOfWrittenFrames = frameList->GetNumberOfTrackedFrames();
+    frameList->Clear();
+
+    queueLock.lock();
+    if (status != PLUS_SUCCESS)
+    {
+      this->WriterFailed = true;
+    }
+    this->NumberOfQueuedFrames -= numberOfWrittenFrames;
+    this->WriteQueue.pop_front();
+    this->FreeFrameLists.push_back(frameList);
+    this->WriteQueueCondition.notify_all();
+  }
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualCapture::EncoderThreadFunction()
+{
+  PLUS_PROFILE_THREAD_NAME(this->GetDeviceId() + " encoder");
+  std::unique_lock<std::mutex> queueLock(this->WriteQueueMutex);
+  while (true)
+  {
+    this->WriteQueueCondition.wait(queueLock, [this]() { return this->StopWriterThreadRequested || !this->EncodeQueue.empty(); });
+    if (this->EncodeQueue.empty())
+    {
+      // stop is requested and all frames are encoded
+      break;
+    }
+
+    // The frame list stays in the queue while it is encoded, so the queue is empty only if the encoder is idle
+    vtkIGSIOTrackedFrameList* frameList = this->EncodeQueue.front();
+    bool writerFailed = this->WriterFailed;
+    queueLock.unlock();
+
+    // The encoded frames are written in the order they were encoded
+    PlusStatus status = (writerFailed ? PLUS_FAIL : this->EncodeFrameList(frameList));
+
+    queueLock.lock();
+    if (status != PLUS_SUCCESS)
+    {
+      this->WriterFailed = true;
+    }
+    // The writer thread returns the frame list to the free frame lists, after a failure without writing it
+    this->EncodeQueue.pop_front();
+    this->WriteQueue.push_back(frameList);
+    this->WriteQueueCondition.notify_all();
+  }
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualCapture::WaitForWriteQueue(bool discard /* = false */)
+{
+  std::unique_lock<std::mutex> queueLock(this->WriteQueueMutex);
+  if (discard)
+  {
+    // The first frame list of each queue may be being encoded or written
+    std::deque<vtkIGSIOTrackedFrameList*>* queues[2] = { &this->EncodeQueue, &this->WriteQueue };
+    for (int queueIndex = 0; queueIndex < 2; queueIndex++)
+    {
+      while (queues[queueIndex]->size() > 1)
+      {
+        vtkIGSIOTrackedFrameList* frameList = queues[queueIndex]->back();
+        this->NumberOfQueuedFrames -= frameList->GetNumberOfTrackedFrames();
+        frameList->Clear();
+        queues[queueIndex]->pop_back();
+        this->FreeFrameLists.push_back(frameList);
+      }
+    }
+  }
+  if (this->WriterThread.joinable())
+  {
+    this->WriteQueueCondition.wait(queueLock, [this]() { return this->EncodeQueue.empty() && this->WriteQueue.empty(); });
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool vtkPlusVirtualCapture::IsWriterFallingBehind()
+{
+  std::lock_guard<std::mutex> queueLock(this->WriteQueueMutex);
+  return this->WriterFallingBehind;
+}
+
+//-----------------------------------------------------------------------------
+int vtkPlusVirtualCapture::GetNumberOfFramesWaitingForWrite()
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> recordingLock(this->RecordingMutex);
+  std::lock_guard<std::mutex> queueLock(this->WriteQueueMutex);
+  return this->NumberOfQueuedFrames + static_cast<int>(this->RecordedFrames->GetNumberOfTrackedFrames());
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualCapture::GetMemoryUsage(std::vector<MemoryAccounting::Usage>& usages)
+{
+  this->Superclass::GetMemoryUsage(usages);
+
+  MetricsRegistry::Labels deviceLabels;
+  deviceLabels["device"] = this->GetDeviceId();
+
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> recordingLock(this->RecordingMutex);
+  size_t recordedBytes = MemoryAccounting::GetTrackedFrameListSizeBytes(this->RecordedFrames);
+  if (this->RecordedFrames->GetNumberOfTrackedFrames() > 0)
+  {
+    this->RecordedFrameSizeBytes = recordedBytes / this->RecordedFrames->GetNumberOfTrackedFrames();
+  }
+  size_t preTriggerBytes = this->PreTriggerRing.GetSizeBytes() + MemoryAccounting::GetTrackedFrameListSizeBytes(this->PreTriggerFrames);
+
+  // The queued frame lists may be modified by the encoder thread, so their size is estimated from the recorded frames
+  int numberOfQueuedFrames = 0;
+  {
+    std::lock_guard<std::mutex> queueLock(this->WriteQueueMutex);
+    numberOfQueuedFrames = this->NumberOfQueuedFrames;
+  }
+
+  usages.push_back(MemoryAccounting::Usage("capture_recorded_frames", deviceLabels, recordedBytes));
+  usages.push_back(MemoryAccounting::Usage("capture_write_queue", deviceLabels, numberOfQueuedFrames * this->RecordedFrameSizeBytes));
+  usages.push_back(MemoryAccounting::Usage("capture_pre_trigger", deviceLabels, preTriggerBytes));
+}
+
 //-----------------------------------------------------------------------------
 int vtkPlusVirtualCapture::OutputChannelCount() const
 {
@@ -673,7 +1435,33 @@ PlusStatus vtkPlusVirtualCapture::GetInputTrackedFrameListSampled(double& lastAl
     return PLUS_FAIL;
   }
 
-  return this->OutputChannels[0]->GetTrackedFrameListSampled(lastAlreadyRecordedFrameTimestamp, nextFrameToBeRecordedTimestamp, recordedFrames, requestedFramePeriodSec, maxProcessingTimeSec);
+  vtkPlusChannel* inputChannel = this->OutputChannels[0];
+
+  // The sources of the input channel may be switched (e.g., by a virtual switcher) while the frames are sampled
+  unsigned long sourcesGeneration = inputChannel->GetSourcesGeneration();
+  if (sourcesGeneration % 2 != 0)
+  {
+    // Switching is in progress, sample the frames next time
+    return PLUS_SUCCESS;
+  }
+  double lastAlreadyRecordedFrameTimestampBefore = lastAlreadyRecordedFrameTimestamp;
+  double nextFrameToBeRecordedTimestampBefore = nextFrameToBeRecordedTimestamp;
+  int numberOfFramesBefore = recordedFrames->GetNumberOfTrackedFrames();
+
+  PlusStatus status = inputChannel->GetTrackedFrameListSampled(lastAlreadyRecordedFrameTimestamp, nextFrameToBeRecordedTimestamp, recordedFrames, requestedFramePeriodSec, maxProcessingTimeSec);
+
+  if (inputChannel->GetSourcesGeneration() != sourcesGeneration)
+  {
+    // Frames may contain data from both the previous and the new sources, sample them again from the new sources
+    LOG_DEBUG("Sources of the input channel of " << this->GetDeviceId() << " were switched while sampling frames, the frames are discarded");
+    if (static_cast<int>(recordedFrames->GetNumberOfTrackedFrames()) > numberOfFramesBefore)
+    {
+      recordedFrames->RemoveTrackedFrameRange(numberOfFramesBefore, recordedFrames->GetNumberOfTrackedFrames() - 1);
+    }
+    lastAlreadyRecordedFrameTimestamp = lastAlreadyRecordedFrameTimestampBefore;
+    nextFrameToBeRecordedTimestamp = nextFrameToBeRecordedTimestampBefore;
+  }
+  return status;
 }
 
 //-----------------------------------------------------------------------------
@@ -8,21 +8,62 @@ See License.txt for details.
 #define __vtkPlusVirtualCapture_h
 
 #include "vtkPlusDataCollectionExport.h"
+#include "PlusCompressedFrameRing.h"
 #include "vtkPlusDevice.h"
 #include "vtkIGSIOSequenceIOBase.h"
+
+#include <vtkIGSIOFrameConverter.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 //class vtkIGSIOTrackedFrameList;
+class vtkPlusSequenceFileWriter;
 
 /*!
 \class vtkPlusVirtualCapture
-\brief
+\brief Records the frames of the input channel into a sequence file
+
+Frames are collected from the input channel on the device thread and written to the file on a dedicated writer thread,
+so a slow disk or compression does not slow down the acquisition. Recorded frames are collected in a frame list, which
+is passed to the writer thread when it should be written (see FrameBufferSize) and a free frame list is used for
+collecting the next frames. There are NumberOfWriteBuffers frame lists in total. If all of them are waiting to be
+written then the writer is falling behind: the recorded frames are kept in memory until a frame list is freed up, and
+if more than a few seconds of frames wait then frames of the input are skipped.
+
+Compressed MetaImage files (.mha, .mhd) are written by vtkPlusSequenceFileWriter, which compresses the pixel data on
+NumberOfCompressionThreads threads, so lossless recording of high resolution video is not limited by the speed of a
+single core. Other formats are written by the IGSIO sequence writers.
+
+Frames of encoded video files (.mkv, .webm) are encoded with the EncodingFourCC codec on a dedicated encoder thread before
+they are passed to the writer thread, so encoding, writing and acquisition run in parallel. The encoded frame is attached to
+the image of its tracked frame, so the timestamps, transforms and fields of the frame stay with the encoded picture. The codec
+is created by vtkStreamingVolumeCodecFactory, so a hardware accelerated codec is used if one is registered for the FourCC.
+Frames that are already encoded with the EncodingFourCC codec (e.g., the output of vtkPlusVirtualVideoEncoder) are written
+without encoding them again, starting from the first key frame.
+
+If PreTriggerDurationSec is set then the frames of the last PreTriggerDurationSec seconds are kept in a compressed in-memory
+ring while capturing is disabled (at most PreTriggerMaximumMemoryMB megabytes). When capturing is enabled the frames of the
+ring are recorded first, followed by the newly acquired frames, so the recording starts before the recording request.
+
+A file can be finalized in the background (see CloseFileInBackground): the outstanding frames are written, the header is
+updated and the compression is completed on a finalizer thread, and the writer of the next file is opened when it is done.
+Methods that access the file wait until the finalization is completed.
 
 \ingroup PlusLibDataCollection
 */
 class vtkPlusDataCollectionExport vtkPlusVirtualCapture : public vtkPlusDevice
 {
 public:
+  /*! Called from the finalizer thread with the finalization status, the full path of the written file and the number of recorded frames */
+  typedef std::function<void(PlusStatus, const std::string&, long)> FileFinalizedCallback;
+
   static vtkPlusVirtualCapture* New();
   vtkTypeMacro(vtkPlusVirtualCapture, vtkPlusDevice);
   void PrintSelf(ostream& os, vtkIndent indent);
@@ -49,6 +90,27 @@ public:
   */
   virtual PlusStatus CloseFile(const char* aFilename = NULL, std::string* resultFilename = NULL);
 
+  /*!
+    Close the output file on a background thread and return immediately. Capturing must be disabled.
+    The queued frames are written, then the file is finalized as in CloseFile, and the next file is opened.
+    OpenFile, CloseFile, Reset, SetEnableFileCompression and enabling capturing wait until the finalization is completed.
+    \param aFilename Overrides the name of the file (optional)
+    \param completedCallback Called from the finalizer thread when the file is finalized or the finalization failed (optional)
+  */
+  PlusStatus CloseFileInBackground(const char* aFilename, const FileFinalizedCallback& completedCallback);
+
+  /*! Returns true while a file is being finalized in the background. This method is safe to be called from any thread. */
+  bool IsFileFinalizationInProgress();
+
+  /*!
+    Get the result of the last background finalization. This method is safe to be called from any thread.
+    \param resultFilename Full path of the written file, empty if no file has been finalized in the background
+  */
+  void GetLastFileFinalizationResult(PlusStatus& status, std::string& resultFilename, long& numberOfFrames);
+
+  /*! Wait until the background finalization of the file is completed */
+  void WaitForFileFinalization();
+
   virtual PlusStatus Reset();
 
   virtual PlusStatus TakeSnapshot();
@@ -78,17 +140,64 @@ public:
   vtkGetMacro(EnableFileCompression, bool);
   void SetEnableFileCompression(bool aFileCompression);
 
+  /*! Number of threads that compress the pixel data of MetaImage files. If 0 then the number of processors is used. */
+  vtkSetClampMacro(NumberOfCompressionThreads, int, 0, VTK_MAX_THREADS);
+  vtkGetMacro(NumberOfCompressionThreads, int);
+
+  /*! zlib compression level of MetaImage files (1 = fastest, 9 = smallest), -1 means the zlib default */
+  vtkSetClampMacro(CompressionLevel, int, -1, 9);
+  vtkGetMacro(CompressionLevel, int);
+
   vtkGetStdStringMacro(EncodingFourCC);
   vtkSetStdStringMacro(EncodingFourCC)
 
+  /*! Maximum number of frames between key frames of encoded video files. If not positive then the codec default is used. */
+  vtkSetMacro(EncodingKeyFrameInterval, int);
+  vtkGetMacro(EncodingKeyFrameInterval, int);
+
+  /*! Target bit rate of encoded video files (bits per second). If not positive then the codec default is used. */
+  vtkSetMacro(EncodingBitRate, int);
+  vtkGetMacro(EncodingBitRate, int);
+
   vtkSetMacro(EnableCapturingOnStart, bool);
   vtkGetMacro(EnableCapturingOnStart, bool);
 
+  /*!
+    If false then the input frames are dropped instead of recorded while the DropNonCriticalCapture overload policy
+    is applied (see OverloadManager). Enabled by default.
+  */
+  vtkSetMacro(Critical, bool);
+  vtkGetMacro(Critical, bool);
+
+  /*! Returns true if input frames are dropped because the system is overloaded */
+  bool IsDroppingFramesForOverload() const { return this->DroppingFramesForOverload; }
+
   vtkGetMacro(IsData3D, bool);
 
   vtkSetMacro(FrameBufferSize, unsigned int);
   vtkGetMacro(FrameBufferSize, unsigned int);
 
+  /*! Time span of the frames that are kept in memory while capturing is disabled and recorded when capturing is enabled. 0 disables the pre-trigger ring. */
+  void SetPreTriggerDurationSec(double durationSec);
+  vtkGetMacro(PreTriggerDurationSec, double);
+
+  /*! Maximum memory used by the pre-trigger ring, in megabytes. If the ring is full then it keeps a shorter time span. */
+  void SetPreTriggerMaximumMemoryMB(int maximumMemoryMB);
+  vtkGetMacro(PreTriggerMaximumMemoryMB, int);
+
+  /*! Number of frame lists used for collecting and writing frames (2 = double buffering, 3 = triple buffering), used when the device is connected */
+  vtkSetClampMacro(NumberOfWriteBuffers, int, 2, 64);
+  vtkGetMacro(NumberOfWriteBuffers, int);
+
+  /*! Returns true if all the frame lists are waiting to be written, so newly recorded frames are kept in memory */
+  bool IsWriterFallingBehind();
+
+  /*! Number of recorded frames that are not written to the file yet */
+  int GetNumberOfFramesWaitingForWrite();
+
+  /*! Append the memory used by the buffers, the recorded frames, the frames waiting for writing and the pre-trigger ring */
+  virtual void GetMemoryUsage(std::vector<MemoryAccounting::Usage>& usages);
+
   virtual vtkPlusDataCollector* GetDataCollector() { return this->DataCollector; }
 
   virtual bool IsTracker() const { return false; }
@@ -110,16 +219,52 @@ protected:
 
   virtual bool IsFrameBuffered() const;
 
+  /*! Open the output file without waiting for the background finalization (called by the finalizer thread) */
+  PlusStatus OpenFileInternal(const char* aFilename = NULL);
+
+  /*! Finalize and close the output file, then open the next one. Does not wait for the background finalization. */
+  PlusStatus FinalizeFile(const char* aFilename, std::string* resultFilename);
+
+  /*! Write the queued frames and finalize the file, then call the callback. Runs on the finalizer thread. */
+  void FileFinalizationThreadFunction(std::string filename, FileFinalizedCallback completedCallback);
+
   /*!
-    Copy frames to memory buffer or disk.
+    Copy frames to memory buffer or pass them to the writer thread.
     If force flag is true then data is written to disk immediately.
   */
   virtual PlusStatus WriteFrames(bool force = false);
 
+  /*! Pass the recorded frames to the writer thread and continue recording into a free frame list. Never waits for writing. */
+  PlusStatus QueueRecordedFrames();
+
+  /*! Add the frames acquired since the last update to the pre-trigger ring. Called with the recording mutex locked. */
+  PlusStatus UpdatePreTriggerRing(double requestedFramePeriodSec, double maxProcessingTimeSec);
+
+  /*! Write a frame list to the file, prepares the header at the first call. Called on the writer thread. */
+  PlusStatus WriteFrameList(vtkIGSIOTrackedFrameList* frameList);
+
+  /*! Encode the images of a frame list with the EncodingFourCC codec, already encoded frames are kept. Called on the encoder thread. */
+  PlusStatus EncodeFrameList(vtkIGSIOTrackedFrameList* frameList);
+
+  /*! Start and stop the writer and the encoder thread */
+  void StartWriterThread();
+  void StopWriterThread();
+  void WriterThreadFunction();
+  void EncoderThreadFunction();
+
+  /*!
+    Wait until all the queued frame lists are encoded and written.
+    If discard is true then frame lists that are not being encoded or written are dropped.
+  */
+  void WaitForWriteQueue(bool discard = false);
+
 protected:
-  /*! Recorded tracked frame list */
+  /*! Recorded tracked frame list, frames are collected in it until it is passed to the writer thread */
   vtkIGSIOTrackedFrameList* RecordedFrames;
 
+  /*! Frame list of the writer, the frames of each written frame list are copied into it and it holds the custom header fields */
+  vtkIGSIOTrackedFrameList* WriterFrames;
+
   /*! Timestamp of last recorded frame (only frames that have more recent timestamp will be added) */
   double LastAlreadyRecordedFrameTimestamp;
 
@@ -158,12 +303,38 @@ protected:
   /*! When closing the file, re-read the data from file, and write it compressed */
   bool EnableFileCompression;
 
+  int NumberOfCompressionThreads;
+  int CompressionLevel;
+
+  /*!
+    Writer of compressed MetaImage files, used instead of Writer if UseSequenceFileWriter is set. Writer still holds
+    the file name and the custom header fields. Protected by WriterAccessMutex.
+  */
+  vtkSmartPointer<vtkPlusSequenceFileWriter> SequenceFileWriter;
+  /*! Set when the header is written, if the file is a compressed MetaImage file. Protected by WriterAccessMutex. */
+  bool UseSequenceFileWriter;
+
   /*! FourCC code represending the codec to use when writing the file*/
   std::string EncodingFourCC;
+  int EncodingKeyFrameInterval;
+  int EncodingBitRate;
+
+  /*! Set by OpenFile if the frames of the file are encoded (EncodingFourCC is set and the file is an encoded video file) */
+  bool EncodeFrames;
+  /*! Encoder of the frames, only used by the encoder thread (and by forced writes, when the encoder thread is idle) */
+  vtkSmartPointer<vtkIGSIOFrameConverter> FrameEncoder;
+  /*! Set by OpenFile, so that each file starts with a key frame. Protected by WriteQueueMutex. */
+  bool EncoderKeyFrameRequested;
 
-  /*! Preparing the header requires image data already collected, this flag makes the header preparation wait until valid data is collected */
+  /*!
+    Preparing the header requires image data already collected, this flag makes the header preparation wait until valid data is collected.
+    It is set when the first frames are passed to the writer, the header is written by the writer thread (see IsHeaderWritten).
+  */
   bool IsHeaderPrepared;
 
+  /*! Set when the header is written to the file. Protected by WriterAccessMutex. */
+  bool IsHeaderWritten;
+
   /*! Record the number of frames captured */
   long int TotalFramesRecorded;  // hard drive will probably fill up before a regular int is hit, but still...
 
@@ -173,13 +344,61 @@ protected:
   /*! Internal flag to control capturing */
   bool EnableCapturing;
 
+  bool Critical;
+  /*! Set by the overload policy handler while input frames are dropped */
+  std::atomic<bool> DroppingFramesForOverload;
+  /*! Identifier of the overload policy handler, 0 if not registered */
+  int OverloadPolicyHandlerId;
+
   unsigned int FrameBufferSize;
 
+  double PreTriggerDurationSec;
+  int PreTriggerMaximumMemoryMB;
+  /*! Frames acquired while capturing is disabled, protected by RecordingMutex */
+  CompressedFrameRing PreTriggerRing;
+  /*! Frames sampled from the input for the pre-trigger ring, protected by RecordingMutex */
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> PreTriggerFrames;
+
   bool IsData3D;
 
-  /*! Mutex instance simultaneous access of writer (writer may be accessed from command processing thread and also the internal update thread) */
+  /*! Mutex instance simultaneous access of writer (writer may be accessed from command processing thread and also the writer thread) */
   vtkSmartPointer<vtkIGSIORecursiveCriticalSection> WriterAccessMutex;
 
+  /*! Mutex for the recorded frames (accessed from the command processing thread and the internal update thread), never held while writing */
+  vtkSmartPointer<vtkIGSIORecursiveCriticalSection> RecordingMutex;
+
+  int NumberOfWriteBuffers;
+
+  /*! Frame lists to be encoded, the first one is being encoded by the encoder thread. Protected by WriteQueueMutex. */
+  std::deque<vtkIGSIOTrackedFrameList*> EncodeQueue;
+  /*! Frame lists to be written, the first one is being written by the writer thread. Protected by WriteQueueMutex. */
+  std::deque<vtkIGSIOTrackedFrameList*> WriteQueue;
+  /*! Empty frame lists that can be used for recording. Protected by WriteQueueMutex. */
+  std::vector<vtkIGSIOTrackedFrameList*> FreeFrameLists;
+  int NumberOfQueuedFrames;
+  bool StopWriterThreadRequested;
+  bool WriterFailed;
+  bool WriterFallingBehind;
+  /*! Set while input frames are skipped because too many frames wait for writing */
+  bool SkippingFramesForWriter;
+  /*! Mean size of the recorded frames at the latest memory usage query, for estimating the size of the queued frames. Protected by RecordingMutex. */
+  size_t RecordedFrameSizeBytes;
+  std::mutex WriteQueueMutex;
+  std::condition_variable WriteQueueCondition;
+  std::thread WriterThread;
+  std::thread EncoderThread;
+
+  /*! Finalizes the file in the background, see CloseFileInBackground */
+  std::thread FileFinalizationThread;
+  /*! Protects FileFinalizationThread, so that it is not started and joined at the same time */
+  std::mutex FileFinalizationThreadMutex;
+  /*! Protects the status of the background finalization */
+  std::mutex FileFinalizationStatusMutex;
+  bool FileFinalizationInProgress;
+  PlusStatus LastFileFinalizationStatus;
+  std::string LastFinalizedFilename;
+  long LastFinalizedNumberOfFrames;
+
   vtkPlusLogger::LogLevelType GracePeriodLogLevel;
 
   PlusStatus GetInputTrackedFrame(igsioTrackedFrame& aFrame);
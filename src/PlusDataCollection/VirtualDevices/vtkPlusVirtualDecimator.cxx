@@ -0,0 +1,525 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataSource.h"
+#include "vtkPlusVirtualDecimator.h"
+
+// IGSIO includes
+#include <igsioVideoFrame.h>
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+
+// STL includes
+#include <algorithm>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  /*! Average factor x factor blocks of pixels in each slice. Blocks at the right and bottom edge may be smaller. */
+  template<typename ScalarType>
+  void DownscaleSlices(const ScalarType* input, ScalarType* output, const FrameSizeType& inputSize, const FrameSizeType& outputSize, int numberOfComponents, unsigned int factor)
+  {
+    for (unsigned int z = 0; z < outputSize[2]; ++z)
+    {
+      const ScalarType* inputSlice = input + static_cast<size_t>(z) * inputSize[0] * inputSize[1] * numberOfComponents;
+      for (unsigned int outputY = 0; outputY < outputSize[1]; ++outputY)
+      {
+        const unsigned int firstY = outputY * factor;
+        const unsigned int lastY = std::min(firstY + factor, inputSize[1]);
+        for (unsigned int outputX = 0; outputX < outputSize[0]; ++outputX)
+        {
+          const unsigned int firstX = outputX * factor;
+          const unsigned int lastX = std::min(firstX + factor, inputSize[0]);
+          const double numberOfPixels = static_cast<double>((lastY - firstY) * (lastX - firstX));
+          for (int component = 0; component < numberOfComponents; ++component)
+          {
+            double sum = 0.0;
+            for (unsigned int y = firstY; y < lastY; ++y)
+            {
+              const ScalarType* inputPixel = inputSlice + (static_cast<size_t>(y) * inputSize[0] + firstX) * numberOfComponents + component;
+              for (unsigned int x = firstX; x < lastX; ++x, inputPixel += numberOfComponents)
+              {
+                sum += *inputPixel;
+              }
+            }
+            *(output++) = static_cast<ScalarType>(sum / numberOfPixels);
+          }
+        }
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+
+vtkStandardNewMacro(vtkPlusVirtualDecimator);
+
+//----------------------------------------------------------------------------
+vtkPlusVirtualDecimator::vtkPlusVirtualDecimator()
+  : vtkPlusDevice()
+  , DecimationFactor(1)
+  , OutputFrameRate(0.0)
+  , DownscalingFactor(1)
+  , LastProcessedUid(0)
+  , InputFrameCount(0)
+  , NextOutputTimestamp(0.0)
+{
+  this->AcquisitionRate = vtkPlusDevice::VIRTUAL_DEVICE_FRAME_RATE;
+
+  // The data capture thread will be used to regularly check the input and add the selected frames to the output
+  this->StartThreadForInternalUpdates = true;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusVirtualDecimator::~vtkPlusVirtualDecimator()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusVirtualDecimator::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "DecimationFactor: " << this->DecimationFactor << std::endl;
+  os << indent << "OutputFrameRate: " << this->OutputFrameRate << std::endl;
+  os << indent << "DownscalingFactor: " << this->DownscalingFactor << std::endl;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualDecimator::ReadConfiguration(vtkXMLDataElement* rootConfigElement)
+{
+  XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_READING(deviceConfig, rootConfigElement);
+
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, DecimationFactor, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, OutputFrameRate, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, DownscalingFactor, deviceConfig);
+
+  if (this->DecimationFactor < 1)
+  {
+    LOG_WARNING("DecimationFactor must be at least 1, use 1 instead of " << this->DecimationFactor);
+    this->DecimationFactor = 1;
+  }
+  if (this->DownscalingFactor < 1)
+  {
+    LOG_WARNING("DownscalingFactor must be at least 1, use 1 instead of " << this->DownscalingFactor);
+    this->DownscalingFactor = 1;
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualDecimator::WriteConfiguration(vtkXMLDataElement* rootConfigElement)
+{
+  XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_WRITING(deviceConfig, rootConfigElement);
+
+  deviceConfig->SetIntAttribute("DecimationFactor", this->DecimationFactor);
+  deviceConfig->SetDoubleAttribute("OutputFrameRate", this->OutputFrameRate);
+  deviceConfig->SetIntAttribute("DownscalingFactor", this->DownscalingFactor);
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusVirtualDecimator::GetAcquisitionRate() const
+{
+  if (this->OutputFrameRate > 0)
+  {
+    return this->OutputFrameRate;
+  }
+  if (this->InputChannels.empty() || this->InputChannels[0]->GetOwnerDevice() == NULL)
+  {
+    return this->AcquisitionRate;
+  }
+  return this->InputChannels[0]->GetOwnerDevice()->GetAcquisitionRate() / this->DecimationFactor;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualDecimator::NotifyConfigured()
+{
+  if (this->InputChannels.empty())
+  {
+    LOG_ERROR("No input channel set for vtkPlusVirtualDecimator " << this->GetDeviceId());
+    this->SetCorrectlyConfigured(false);
+    return PLUS_FAIL;
+  }
+  if (this->InputChannels.size() > 1)
+  {
+    LOG_WARNING("vtkPlusVirtualDecimator is expecting one input channel and there are " << this->InputChannels.size() << " channels. First input channel will be used, all other are ignored.");
+  }
+  if (this->OutputChannels.empty())
+  {
+    LOG_ERROR("No output channel set for vtkPlusVirtualDecimator " << this->GetDeviceId());
+    this->SetCorrectlyConfigured(false);
+    return PLUS_FAIL;
+  }
+
+  vtkPlusChannel* inputChannel = this->InputChannels[0];
+  vtkPlusChannel* outputChannel = this->OutputChannels[0];
+  int numberOfErrors(0);
+
+  // Output sources have the same IDs as the input sources. They are reused if the device is configured again.
+  vtkPlusDataSource* inputVideo = NULL;
+  if (inputChannel->HasVideoSource() && inputChannel->GetVideoSource(inputVideo) == PLUS_SUCCESS)
+  {
+    vtkPlusDataSource* outputVideo = NULL;
+    if (this->GetVideoSource(inputVideo->GetId().c_str(), outputVideo) != PLUS_SUCCESS)
+    {
+      vtkSmartPointer<vtkPlusDataSource> aDataSource = vtkSmartPointer<vtkPlusDataSource>::New();
+      aDataSource->SetId(inputVideo->GetId());
+      aDataSource->SetType(DATA_SOURCE_TYPE_VIDEO);
+      aDataSource->SetBufferSize(inputVideo->GetBufferSize());
+      // Frames in the input buffer are already in the output orientation, so the pixels can be shared
+      aDataSource->SetInputImageOrientation(inputVideo->GetOutputImageOrientation());
+      aDataSource->SetOutputImageOrientation(inputVideo->GetOutputImageOrientation());
+      if (this->AddVideoSource(aDataSource) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Unable to add video source " << inputVideo->GetId() << " to device " << this->GetDeviceId());
+        numberOfErrors++;
+      }
+      outputVideo = aDataSource;
+    }
+    outputChannel->SetVideoSource(outputVideo);
+  }
+
+  for (DataSourceContainerConstIterator it = inputChannel->GetToolsStartConstIterator(); it != inputChannel->GetToolsEndConstIterator(); ++it)
+  {
+    vtkPlusDataSource* inputTool = it->second;
+    vtkPlusDataSource* outputTool = NULL;
+    if (this->GetTool(inputTool->GetId(), outputTool) != PLUS_SUCCESS)
+    {
+      vtkSmartPointer<vtkPlusDataSource> aDataSource = vtkSmartPointer<vtkPlusDataSource>::New();
+      aDataSource->SetId(inputTool->GetId());
+      aDataSource->SetType(DATA_SOURCE_TYPE_TOOL);
+      aDataSource->SetReferenceCoordinateFrameName(inputTool->GetReferenceCoordinateFrameName());
+      aDataSource->SetBufferSize(inputTool->GetBufferSize());
+      if (this->AddTool(aDataSource, false) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Unable to add tool " << inputTool->GetId() << " to device " << this->GetDeviceId());
+        numberOfErrors++;
+        continue;
+      }
+      outputTool = aDataSource;
+    }
+    outputChannel->AddTool(outputTool);
+  }
+
+  for (DataSourceContainerConstIterator it = inputChannel->GetFieldDataSourcesStartConstIterator(); it != inputChannel->GetFieldDataSourcesEndConstIterator(); ++it)
+  {
+    vtkPlusDataSource* inputFieldSource = it->second;
+    vtkPlusDataSource* outputFieldSource = NULL;
+    if (this->GetFieldDataSource(inputFieldSource->GetId(), outputFieldSource) != PLUS_SUCCESS)
+    {
+      vtkSmartPointer<vtkPlusDataSource> aDataSource = vtkSmartPointer<vtkPlusDataSource>::New();
+      aDataSource->SetId(inputFieldSource->GetId());
+      aDataSource->SetType(DATA_SOURCE_TYPE_FIELDDATA);
+      aDataSource->SetBufferSize(inputFieldSource->GetBufferSize());
+      if (this->AddFieldDataSource(aDataSource) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Unable to add field data source " << inputFieldSource->GetId() << " to device " << this->GetDeviceId());
+        numberOfErrors++;
+        continue;
+      }
+      outputFieldSource = aDataSource;
+    }
+    outputChannel->AddFieldDataSource(outputFieldSource);
+  }
+
+  if (numberOfErrors > 0)
+  {
+    this->SetCorrectlyConfigured(false);
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualDecimator::InternalStartRecording()
+{
+  // Frames acquired before the recording started are not added to the output
+  this->LastProcessedUid = 0;
+  this->InputFrameCount = 0;
+  this->NextOutputTimestamp = 0.0;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusDataSource* vtkPlusVirtualDecimator::GetInputTimestampSource()
+{
+  if (this->InputChannels.empty())
+  {
+    return NULL;
+  }
+  vtkPlusChannel* inputChannel = this->InputChannels[0];
+  vtkPlusDataSource* aSource = NULL;
+  if (inputChannel->HasVideoSource() && inputChannel->GetVideoSource(aSource) == PLUS_SUCCESS)
+  {
+    return aSource;
+  }
+  if (inputChannel->GetTimestampMasterTool(aSource) == PLUS_SUCCESS)
+  {
+    return aSource;
+  }
+  if (inputChannel->GetFieldDataSourcesStartConstIterator() != inputChannel->GetFieldDataSourcesEndConstIterator())
+  {
+    return inputChannel->GetFieldDataSourcesStartConstIterator()->second;
+  }
+  return NULL;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusVirtualDecimator::IsFrameSelected(double timestamp)
+{
+  if (this->OutputFrameRate > 0)
+  {
+    if (timestamp < this->NextOutputTimestamp)
+    {
+      return false;
+    }
+    const double samplingPeriodSec = 1.0 / this->OutputFrameRate;
+    this->NextOutputTimestamp += samplingPeriodSec;
+    if (this->NextOutputTimestamp <= timestamp)
+    {
+      // First frame or the input was paused, do not try to catch up with the missed sampling times
+      this->NextOutputTimestamp = timestamp + samplingPeriodSec;
+    }
+    return true;
+  }
+
+  bool selected = (this->InputFrameCount % this->DecimationFactor == 0);
+  this->InputFrameCount++;
+  return selected;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualDecimator::InternalUpdate()
+{
+  vtkPlusDataSource* inputTimestampSource = this->GetInputTimestampSource();
+  if (inputTimestampSource == NULL || inputTimestampSource->GetNumberOfItems() < 1)
+  {
+    // No input data yet
+    return PLUS_SUCCESS;
+  }
+
+  BufferItemUidType latestUid = inputTimestampSource->GetLatestItemUidInBuffer();
+  BufferItemUidType uid = inputTimestampSource->GetOldestItemUidInBuffer();
+  if (this->LastProcessedUid == 0)
+  {
+    // Start with the most recent frame
+    uid = latestUid;
+  }
+  else if (this->LastProcessedUid + 1 > uid)
+  {
+    uid = this->LastProcessedUid + 1;
+  }
+
+  PlusStatus status = PLUS_SUCCESS;
+  for (; uid <= latestUid; ++uid)
+  {
+    // Only the timestamps of the frames that are not selected are read
+    double timestamp(0);
+    this->LastProcessedUid = uid;
+    if (inputTimestampSource->GetTimeStamp(uid, timestamp) != ITEM_OK || !this->IsFrameSelected(timestamp))
+    {
+      continue;
+    }
+    if (this->AddOutputFrame(inputTimestampSource, uid, timestamp) != PLUS_SUCCESS)
+    {
+      status = PLUS_FAIL;
+    }
+  }
+
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualDecimator::AddOutputFrame(vtkPlusDataSource* inputTimestampSource, BufferItemUidType uid, double timestamp)
+{
+  vtkPlusChannel* inputChannel = this->InputChannels[0];
+  vtkPlusChannel* outputChannel = this->OutputChannels[0];
+  int numberOfErrors(0);
+
+  // Generate unique frame number (not used for filtering, the input timestamp is used as is)
+  this->FrameNumber++;
+
+  vtkPlusDataSource* outputVideo = NULL;
+  if (inputTimestampSource->GetType() == DATA_SOURCE_TYPE_VIDEO && outputChannel->GetVideoSource(outputVideo) == PLUS_SUCCESS)
+  {
+    StreamBufferItem videoItem;
+    if (inputTimestampSource->GetStreamBufferItem(uid, &videoItem, true /* share image data */) != ITEM_OK)
+    {
+      // The item has just been overwritten in the input buffer
+      return PLUS_SUCCESS;
+    }
+    if (this->AddOutputImage(outputVideo, videoItem, timestamp) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Virtual decimator " << this->GetDeviceId() << " failed to add video frame at " << std::fixed << timestamp);
+      numberOfErrors++;
+    }
+  }
+
+  // Interpolate all tools at the frame time in one pass
+  std::vector<vtkPlusChannel::ToolTransform> toolTransforms;
+  inputChannel->GetInterpolatedToolTransforms(timestamp, toolTransforms);
+  if (!toolTransforms.empty())
+  {
+    std::vector< vtkSmartPointer<vtkMatrix4x4> > matrices(toolTransforms.size());
+    ToolTimeStampedItemList items;
+    items.reserve(toolTransforms.size());
+    for (size_t toolIndex = 0; toolIndex < toolTransforms.size(); ++toolIndex)
+    {
+      const vtkPlusChannel::ToolTransform& toolTransform = toolTransforms[toolIndex];
+      matrices[toolIndex] = vtkSmartPointer<vtkMatrix4x4>::New();
+      ToolStatus toolStatus = TOOL_MISSING;
+      if (toolTransform.Result == ITEM_OK)
+      {
+        matrices[toolIndex]->DeepCopy(toolTransform.Sample.Matrix);
+        toolStatus = toolTransform.Sample.Status;
+      }
+      items.push_back(ToolTimeStampedItem(toolTransform.Tool->GetId(), matrices[toolIndex], toolStatus, this->FrameNumber));
+    }
+    if (this->AddTimeStampedItems(items, timestamp, timestamp) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Virtual decimator " << this->GetDeviceId() << " failed to add tool transforms at " << std::fixed << timestamp);
+      numberOfErrors++;
+    }
+  }
+
+  for (DataSourceContainerConstIterator it = inputChannel->GetFieldDataSourcesStartConstIterator(); it != inputChannel->GetFieldDataSourcesEndConstIterator(); ++it)
+  {
+    vtkPlusDataSource* inputFieldSource = it->second;
+    vtkPlusDataSource* outputFieldSource = NULL;
+    StreamBufferItem fieldItem;
+    if (outputChannel->GetFieldDataSource(outputFieldSource, inputFieldSource->GetId()) != PLUS_SUCCESS
+        || inputFieldSource->GetStreamBufferItemFromTime(timestamp, &fieldItem, vtkPlusBuffer::CLOSEST_TIME) != ITEM_OK)
+    {
+      // Field data is optional, it may not be available yet
+      continue;
+    }
+    igsioFieldMapType customFields;
+    fieldItem.GetFrameFields().GetFieldMap(customFields);
+    if (outputFieldSource->AddItem(customFields, this->FrameNumber, timestamp, timestamp) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Virtual decimator " << this->GetDeviceId() << " failed to add field data of " << inputFieldSource->GetId() << " at " << std::fixed << timestamp);
+      numberOfErrors++;
+    }
+  }
+
+  return numberOfErrors == 0 ? PLUS_SUCCESS : PLUS_FAIL;
+}
+
+//----------------------------------------------------------------------------
+FrameSizeType vtkPlusVirtualDecimator::GetDownscaledSize(const FrameSizeType& inputSize, unsigned int factor)
+{
+  FrameSizeType downscaledSize = { std::max(1u, inputSize[0] / factor), std::max(1u, inputSize[1] / factor), inputSize[2] };
+  return downscaledSize;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualDecimator::DownscalePixels(vtkDataArray* inputPixels, const FrameSizeType& inputSize, unsigned int factor, vtkDataArray* outputPixels)
+{
+  const FrameSizeType outputSize = GetDownscaledSize(inputSize, factor);
+  if (inputPixels == NULL || outputPixels == NULL || inputPixels->GetDataType() != outputPixels->GetDataType()
+      || inputPixels->GetNumberOfComponents() != outputPixels->GetNumberOfComponents()
+      || outputPixels->GetNumberOfTuples() != static_cast<vtkIdType>(outputSize[0]) * outputSize[1] * outputSize[2])
+  {
+    return PLUS_FAIL;
+  }
+  switch (inputPixels->GetDataType())
+  {
+    vtkTemplateMacro(DownscaleSlices<VTK_TT>(static_cast<const VTK_TT*>(inputPixels->GetVoidPointer(0)), static_cast<VTK_TT*>(outputPixels->GetVoidPointer(0)),
+                     inputSize, outputSize, inputPixels->GetNumberOfComponents(), factor));
+    default:
+      return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualDecimator::AddOutputImage(vtkPlusDataSource* outputVideo, StreamBufferItem& inputItem, double timestamp)
+{
+  igsioFieldMapType customFields;
+  inputItem.GetFrameFields().GetFieldMap(customFields);
+
+  igsioVideoFrame& frame = inputItem.GetFrame();
+  if (!frame.IsImageValid())
+  {
+    return outputVideo->AddItem(customFields, this->FrameNumber, timestamp, timestamp);
+  }
+
+  unsigned int numberOfScalarComponents(1);
+  if (frame.GetNumberOfScalarComponents(numberOfScalarComponents) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to retrieve number of scalar components.");
+    return PLUS_FAIL;
+  }
+  FrameSizeType frameSize = frame.GetFrameSize();
+  vtkSmartPointer<vtkDataArray> pixels;
+  if (!frame.IsFrameEncoded())
+  {
+    pixels = frame.GetImage()->GetPointData()->GetScalars();
+  }
+
+  if (this->DownscalingFactor > 1 && pixels != NULL)
+  {
+    const unsigned int factor = static_cast<unsigned int>(this->DownscalingFactor);
+    FrameSizeType downscaledSize = GetDownscaledSize(frameSize, factor);
+    const vtkIdType numberOfPixels = static_cast<vtkIdType>(downscaledSize[0]) * downscaledSize[1] * downscaledSize[2];
+    if (this->DownscaledPixels == NULL || this->DownscaledPixels->GetDataType() != pixels->GetDataType()
+        || this->DownscaledPixels->GetNumberOfComponents() != pixels->GetNumberOfComponents() || this->DownscaledPixels->GetNumberOfTuples() != numberOfPixels)
+    {
+      this->DownscaledPixels = vtkSmartPointer<vtkDataArray>::Take(pixels->NewInstance());
+      this->DownscaledPixels->SetNumberOfComponents(pixels->GetNumberOfComponents());
+      this->DownscaledPixels->SetNumberOfTuples(numberOfPixels);
+    }
+    if (DownscalePixels(pixels, frameSize, factor, this->DownscaledPixels) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Virtual decimator " << this->GetDeviceId() << " cannot downscale images of pixel type " << pixels->GetDataTypeAsString());
+      return PLUS_FAIL;
+    }
+    frameSize = downscaledSize;
+    pixels = this->DownscaledPixels;
+  }
+
+  // The output buffer takes the format of the input frames
+  if (outputVideo->GetNumberOfItems() == 0 || outputVideo->GetInputFrameSize() != frameSize || outputVideo->GetPixelType() != frame.GetVTKScalarPixelType()
+      || outputVideo->GetNumberOfScalarComponents() != numberOfScalarComponents || outputVideo->GetImageType() != frame.GetImageType())
+  {
+    outputVideo->SetPixelType(frame.GetVTKScalarPixelType());
+    outputVideo->SetNumberOfScalarComponents(numberOfScalarComponents);
+    outputVideo->SetImageType(frame.GetImageType());
+    outputVideo->SetInputFrameSize(frameSize);
+  }
+
+  if (pixels == NULL || !outputVideo->CanAddItemBySwappingPixels())
+  {
+    // Encoded frames and buffers with contiguous frame memory need a copy
+    if (this->DownscalingFactor > 1 && pixels != NULL)
+    {
+      return outputVideo->AddItem(pixels->GetVoidPointer(0), outputVideo->GetInputImageOrientation(), frameSize, frame.GetVTKScalarPixelType(), numberOfScalarComponents,
+                                  frame.GetImageType(), 0, this->FrameNumber, timestamp, timestamp, &customFields);
+    }
+    return outputVideo->AddItem(&frame, this->FrameNumber, timestamp, timestamp, &customFields);
+  }
+
+  // The output buffer slot refers to the pixels of the input buffer slot (or to the downscaled pixels),
+  // the buffers allocate new pixels for their slots when the slots are overwritten
+  PlusStatus status = outputVideo->AddItemBySwappingPixels(pixels, this->FrameNumber, timestamp, timestamp, &customFields);
+  if (this->DownscalingFactor > 1)
+  {
+    // Pixels of the overwritten output frame, the next frame is downscaled into them
+    this->DownscaledPixels = pixels;
+  }
+  return status;
+}
@@ -0,0 +1,113 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusVirtualDecimator_h
+#define __vtkPlusVirtualDecimator_h
+
+#include "vtkPlusDataCollectionExport.h"
+
+#include "vtkPlusDevice.h"
+
+class vtkDataArray;
+class vtkPlusChannel;
+class vtkPlusDataSource;
+
+/*!
+\class vtkPlusVirtualDecimator
+\brief Publishes the data of the input channel at a lower frame rate, optionally with downscaled images
+
+Only the selected frames of the input channel are added to the output channel: every DecimationFactor-th frame,
+or the first frame after each sampling time if OutputFrameRate is set. Consumers of the output channel therefore
+do not assemble and then drop the frames that they do not need.
+
+Images are not copied: the output buffer refers to the pixels of the input buffer (see vtkPlusDataSource::AddItemBySwappingPixels),
+only downscaled images are computed. Tool transforms are interpolated at the time of the selected frames.
+
+\ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport vtkPlusVirtualDecimator : public vtkPlusDevice
+{
+public:
+  static vtkPlusVirtualDecimator* New();
+  vtkTypeMacro(vtkPlusVirtualDecimator, vtkPlusDevice);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  virtual bool IsTracker() const { return false; }
+  virtual bool IsVirtual() const { return true; }
+
+  /*! Read configuration from xml data */
+  virtual PlusStatus ReadConfiguration(vtkXMLDataElement*);
+
+  /*! Write configuration to xml data */
+  virtual PlusStatus WriteConfiguration(vtkXMLDataElement*);
+
+  /*! Create the output sources from the sources of the input channel */
+  virtual PlusStatus NotifyConfigured();
+
+  /*! Frame rate of the output channel */
+  virtual double GetAcquisitionRate() const;
+
+  /*! Every DecimationFactor-th input frame is added to the output. Not used if OutputFrameRate is set. */
+  vtkSetMacro(DecimationFactor, int);
+  vtkGetMacro(DecimationFactor, int);
+
+  /*! If positive then frames are added to the output at this rate (in frames per second) instead of every DecimationFactor-th frame */
+  vtkSetMacro(OutputFrameRate, double);
+  vtkGetMacro(OutputFrameRate, double);
+
+  /*! If larger than 1 then the image size is divided by this factor along the first two axes, by averaging blocks of pixels */
+  vtkSetMacro(DownscalingFactor, int);
+  vtkGetMacro(DownscalingFactor, int);
+
+  /*! Size of the images that are downscaled by the factor along the first two axes */
+  static FrameSizeType GetDownscaledSize(const FrameSizeType& inputSize, unsigned int factor);
+
+  /*!
+    Average factor x factor blocks of pixels in each slice of the input pixels. The output array must have the same type
+    and number of components as the input, and the downscaled size (see GetDownscaledSize).
+  */
+  static PlusStatus DownscalePixels(vtkDataArray* inputPixels, const FrameSizeType& inputSize, unsigned int factor, vtkDataArray* outputPixels);
+
+protected:
+  vtkPlusVirtualDecimator();
+  virtual ~vtkPlusVirtualDecimator();
+
+  virtual PlusStatus InternalUpdate();
+
+  virtual PlusStatus InternalStartRecording();
+
+  /*! Get the source of the input channel that determines the frame timestamps (video source, or timestamp master tool) */
+  vtkPlusDataSource* GetInputTimestampSource();
+
+  /*! Returns true if the input frame acquired at the timestamp should be added to the output */
+  bool IsFrameSelected(double timestamp);
+
+  /*! Add the input item and the tool transforms interpolated at its timestamp to the output sources */
+  PlusStatus AddOutputFrame(vtkPlusDataSource* inputTimestampSource, BufferItemUidType uid, double timestamp);
+
+  /*! Add the image of the input item to the output video source, without copying the pixels if the image is not downscaled */
+  PlusStatus AddOutputImage(vtkPlusDataSource* outputVideo, StreamBufferItem& inputItem, double timestamp);
+
+  int DecimationFactor;
+  double OutputFrameRate;
+  int DownscalingFactor;
+
+  /*! UID of the last processed item of the input timestamp source, 0 if none */
+  BufferItemUidType LastProcessedUid;
+  /*! Number of input frames since recording started, for selecting every DecimationFactor-th frame */
+  unsigned long InputFrameCount;
+  /*! The first frame acquired at or after this time is added to the output, if OutputFrameRate is set */
+  double NextOutputTimestamp;
+
+  /*! Downscaled image pixels, swapped with the pixels of the overwritten output buffer frame (so they are reused) */
+  vtkSmartPointer<vtkDataArray> DownscaledPixels;
+
+private:
+  vtkPlusVirtualDecimator(const vtkPlusVirtualDecimator&);  // Not implemented.
+  void operator=(const vtkPlusVirtualDecimator&);  // Not implemented.
+};
+
+#endif
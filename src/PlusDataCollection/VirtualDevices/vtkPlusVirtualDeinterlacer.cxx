@@ -18,6 +18,10 @@ See License.txt for details.
 #include <vtkImageData.h>
 #include <vtkObjectFactory.h>
 
+// STL includes
+#include <algorithm>
+#include <cstring>
+
 namespace
 {
   //----------------------------------------------------------------------------
@@ -29,6 +33,10 @@ namespace
         return "HorizontalInterlace";
       case vtkPlusVirtualDeinterlacer::Stereo_VerticalInterlace:
         return "VerticalInterlace";
+      case vtkPlusVirtualDeinterlacer::Stereo_SideBySide:
+        return "SideBySide";
+      case vtkPlusVirtualDeinterlacer::Stereo_TopBottom:
+        return "TopBottom";
       default:
         return "Unknown";
     }
@@ -45,11 +53,64 @@ namespace
     {
       return vtkPlusVirtualDeinterlacer::Stereo_VerticalInterlace;
     }
+    else if (igsioCommon::IsEqualInsensitive(mode, "SideBySide"))
+    {
+      return vtkPlusVirtualDeinterlacer::Stereo_SideBySide;
+    }
+    else if (igsioCommon::IsEqualInsensitive(mode, "TopBottom"))
+    {
+      return vtkPlusVirtualDeinterlacer::Stereo_TopBottom;
+    }
     else
     {
       return vtkPlusVirtualDeinterlacer::Stereo_Unknown;
     }
   }
+
+  //----------------------------------------------------------------------------
+  size_t GetPixelSizeInBytes(vtkImageData* image)
+  {
+    return static_cast<size_t>(image->GetScalarSize()) * image->GetNumberOfScalarComponents();
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Copy every second pixel, the pixel size is a compile time constant so that the compiler can unroll and vectorize the copy */
+  template<size_t PixelSize>
+  void CopyEverySecondPixel(const unsigned char* input, unsigned char* output, int numberOfOutputPixels)
+  {
+    for (int i = 0; i < numberOfOutputPixels; ++i)
+    {
+      memcpy(output + i * PixelSize, input + 2 * i * PixelSize, PixelSize);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void CopyEverySecondPixel(const unsigned char* input, unsigned char* output, int numberOfOutputPixels, size_t pixelSize)
+  {
+    switch (pixelSize)
+    {
+      case 1:
+        CopyEverySecondPixel<1>(input, output, numberOfOutputPixels);
+        return;
+      case 2:
+        CopyEverySecondPixel<2>(input, output, numberOfOutputPixels);
+        return;
+      case 3:
+        CopyEverySecondPixel<3>(input, output, numberOfOutputPixels);
+        return;
+      case 4:
+        CopyEverySecondPixel<4>(input, output, numberOfOutputPixels);
+        return;
+      case 8:
+        CopyEverySecondPixel<8>(input, output, numberOfOutputPixels);
+        return;
+      default:
+        for (int i = 0; i < numberOfOutputPixels; ++i)
+        {
+          memcpy(output + i * pixelSize, input + 2 * i * pixelSize, pixelSize);
+        }
+    }
+  }
 }
 //----------------------------------------------------------------------------
 
@@ -142,13 +203,31 @@ PlusStatus vtkPlusVirtualDeinterlacer::InternalUpdate()
     }
     else if (this->Mode == Stereo_VerticalInterlace)
     {
-      if (size[01] % 2 == 1)
+      if (size[0] % 2 == 1)
       {
-        LOG_WARNING("Odd sized X dimension, extra column will be lost.");
+        LOG_WARNING("Odd sized X dimension, extra column will be added.");
       }
       // vertical rows, X dim is halved
       size[0] = std::ceil(size[0] / 2.0);
     }
+    else if (this->Mode == Stereo_SideBySide)
+    {
+      if (size[0] % 2 == 1)
+      {
+        LOG_WARNING("Odd sized X dimension, extra column will be lost.");
+      }
+      // left and right halves, X dim is halved
+      size[0] = size[0] / 2;
+    }
+    else if (this->Mode == Stereo_TopBottom)
+    {
+      if (size[1] % 2 == 1)
+      {
+        LOG_WARNING("Odd sized Y dimension, extra row will be lost.");
+      }
+      // top and bottom halves, Y dim is halved
+      size[1] = size[1] / 2;
+    }
     this->LeftSource->SetInputImageOrientation(US_IMG_ORIENT_MFA);
     this->RightSource->SetInputImageOrientation(US_IMG_ORIENT_MFA);
     this->LeftSource->SetInputFrameSize(size);
@@ -166,6 +245,9 @@ PlusStatus vtkPlusVirtualDeinterlacer::InternalUpdate()
     this->RightImage->SetDimensions(size[0], size[1], size[2]);
     this->LeftImage->AllocateScalars(this->InputSource->GetPixelType(), this->InputSource->GetNumberOfScalarComponents());
     this->RightImage->AllocateScalars(this->InputSource->GetPixelType(), this->InputSource->GetNumberOfScalarComponents());
+    // the extra row or column of an odd sized input is not written by the split
+    memset(this->LeftImage->GetScalarPointer(), 0, GetPixelSizeInBytes(this->LeftImage) * size[0] * size[1] * size[2]);
+    memset(this->RightImage->GetScalarPointer(), 0, GetPixelSizeInBytes(this->RightImage) * size[0] * size[1] * size[2]);
 
     this->Initialized = true;
   }
@@ -178,7 +260,14 @@ PlusStatus vtkPlusVirtualDeinterlacer::InternalUpdate()
 
   for (auto frame : *this->FrameList)
   {
-    if (this->Mode == Stereo_HorizontalInterlace)
+    if (this->Mode == Stereo_TopBottom)
+    {
+      // the halves are contiguous in the input frame, no intermediate copy is needed
+      this->AddFrameTopBottom(frame);
+      this->FrameNumber++;
+      continue;
+    }
+    else if (this->Mode == Stereo_HorizontalInterlace)
     {
       this->SplitFrameHorizontal(frame);
     }
@@ -186,6 +275,10 @@ PlusStatus vtkPlusVirtualDeinterlacer::InternalUpdate()
     {
       this->SplitFrameVertical(frame);
     }
+    else if (this->Mode == Stereo_SideBySide)
+    {
+      this->SplitFrameSideBySide(frame);
+    }
 
     this->LeftSource->AddItem(this->LeftImage, this->LeftSource->GetInputImageOrientation(), this->LeftSource->GetImageType(), this->FrameNumber);
     this->RightSource->AddItem(this->RightImage, this->RightSource->GetInputImageOrientation(), this->RightSource->GetImageType(), this->FrameNumber);
@@ -199,47 +292,108 @@ PlusStatus vtkPlusVirtualDeinterlacer::InternalUpdate()
 void vtkPlusVirtualDeinterlacer::SplitFrameHorizontal(igsioTrackedFrame* frame)
 {
   vtkImageData* inputImage = frame->GetImageData()->GetImage();
-  vtkIdType* inputIncrements = inputImage->GetIncrements();
-  unsigned char* inputPtr = (unsigned char*)inputImage->GetScalarPointer();
-  unsigned char* leftPtr = (unsigned char*)this->LeftImage->GetScalarPointer();
-  unsigned char* rightPtr = (unsigned char*)this->RightImage->GetScalarPointer();
-  vtkIdType* outputIncrements = this->LeftImage->GetIncrements();
-
-  // for each input row
-  for (vtkIdType row = 0; row < inputImage->GetDimensions()[1]; row++)
+  const int* inputDimensions = inputImage->GetDimensions();
+  const int* outputDimensions = this->LeftImage->GetDimensions();
+  const size_t pixelSize = GetPixelSizeInBytes(inputImage);
+  const size_t inputRowBytes = inputDimensions[0] * pixelSize;
+  const size_t outputRowBytes = outputDimensions[0] * pixelSize;
+  const size_t rowBytes = std::min(inputRowBytes, outputRowBytes);
+  const int numberOfRows = std::min(inputDimensions[1], 2 * outputDimensions[1]);
+
+  const unsigned char* inputPtr = static_cast<const unsigned char*>(inputImage->GetScalarPointer());
+  unsigned char* evenRowsPtr = static_cast<unsigned char*>((this->SwitchInterlaceOrdering ? this->RightImage : this->LeftImage)->GetScalarPointer());
+  unsigned char* oddRowsPtr = static_cast<unsigned char*>((this->SwitchInterlaceOrdering ? this->LeftImage : this->RightImage)->GetScalarPointer());
+
+  // each input row is copied as a whole, alternating between the two images
+  for (int row = 0; row < numberOfRows; row += 2)
   {
-    // %2 = 0 left, %2 = 1 right
-    bool left(false);
-    if (row % 2 == 0)
-    {
-      left = true;
-    }
-    if (this->SwitchInterlaceOrdering)
-    {
-      left = !left;
-    }
-
-    // finished with this row,
-    // increment output image pointer for this row's image
-    if (left)
+    memcpy(evenRowsPtr, inputPtr + row * inputRowBytes, rowBytes);
+    evenRowsPtr += outputRowBytes;
+    if (row + 1 < numberOfRows)
     {
-      // Copy row to left image, increment left image pointer
-      memcpy(leftPtr, inputPtr, inputIncrements[1]);
-      leftPtr += outputIncrements[1];
+      memcpy(oddRowsPtr, inputPtr + (row + 1) * inputRowBytes, rowBytes);
+      oddRowsPtr += outputRowBytes;
     }
-    else
-    {
-      memcpy(rightPtr, inputPtr, inputIncrements[1]);
-      rightPtr += outputIncrements[1];
-    }
-    inputPtr += inputIncrements[1];
   }
 }
 
 //----------------------------------------------------------------------------
 void vtkPlusVirtualDeinterlacer::SplitFrameVertical(igsioTrackedFrame* frame)
 {
+  vtkImageData* inputImage = frame->GetImageData()->GetImage();
+  const int* inputDimensions = inputImage->GetDimensions();
+  const int* outputDimensions = this->LeftImage->GetDimensions();
+  const size_t pixelSize = GetPixelSizeInBytes(inputImage);
+  const size_t inputRowBytes = inputDimensions[0] * pixelSize;
+  const size_t outputRowBytes = outputDimensions[0] * pixelSize;
+  const int numberOfRows = std::min(inputDimensions[1], outputDimensions[1]);
+  // odd columns are one fewer if the input width is odd
+  const int numberOfEvenColumns = std::min((inputDimensions[0] + 1) / 2, outputDimensions[0]);
+  const int numberOfOddColumns = std::min(inputDimensions[0] / 2, outputDimensions[0]);
+
+  const unsigned char* inputPtr = static_cast<const unsigned char*>(inputImage->GetScalarPointer());
+  unsigned char* evenColumnsPtr = static_cast<unsigned char*>((this->SwitchInterlaceOrdering ? this->RightImage : this->LeftImage)->GetScalarPointer());
+  unsigned char* oddColumnsPtr = static_cast<unsigned char*>((this->SwitchInterlaceOrdering ? this->LeftImage : this->RightImage)->GetScalarPointer());
+
+  for (int row = 0; row < numberOfRows; ++row)
+  {
+    const unsigned char* inputRowPtr = inputPtr + row * inputRowBytes;
+    CopyEverySecondPixel(inputRowPtr, evenColumnsPtr + row * outputRowBytes, numberOfEvenColumns, pixelSize);
+    CopyEverySecondPixel(inputRowPtr + pixelSize, oddColumnsPtr + row * outputRowBytes, numberOfOddColumns, pixelSize);
+  }
+}
 
+//----------------------------------------------------------------------------
+void vtkPlusVirtualDeinterlacer::SplitFrameSideBySide(igsioTrackedFrame* frame)
+{
+  vtkImageData* inputImage = frame->GetImageData()->GetImage();
+  const int* inputDimensions = inputImage->GetDimensions();
+  const int* outputDimensions = this->LeftImage->GetDimensions();
+  const size_t pixelSize = GetPixelSizeInBytes(inputImage);
+  const size_t inputRowBytes = inputDimensions[0] * pixelSize;
+  const size_t outputRowBytes = outputDimensions[0] * pixelSize;
+  const size_t halfRowBytes = std::min(inputDimensions[0] / 2, outputDimensions[0]) * pixelSize;
+  const int numberOfRows = std::min(inputDimensions[1], outputDimensions[1]);
+
+  const unsigned char* inputPtr = static_cast<const unsigned char*>(inputImage->GetScalarPointer());
+  unsigned char* leftHalfPtr = static_cast<unsigned char*>((this->SwitchInterlaceOrdering ? this->RightImage : this->LeftImage)->GetScalarPointer());
+  unsigned char* rightHalfPtr = static_cast<unsigned char*>((this->SwitchInterlaceOrdering ? this->LeftImage : this->RightImage)->GetScalarPointer());
+
+  // two row segments per input row
+  for (int row = 0; row < numberOfRows; ++row)
+  {
+    const unsigned char* inputRowPtr = inputPtr + row * inputRowBytes;
+    memcpy(leftHalfPtr + row * outputRowBytes, inputRowPtr, halfRowBytes);
+    memcpy(rightHalfPtr + row * outputRowBytes, inputRowPtr + halfRowBytes, halfRowBytes);
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualDeinterlacer::AddFrameTopBottom(igsioTrackedFrame* frame)
+{
+  vtkImageData* inputImage = frame->GetImageData()->GetImage();
+  const int* inputDimensions = inputImage->GetDimensions();
+  FrameSizeType halfSize = this->LeftSource->GetInputFrameSize();
+  if (static_cast<unsigned int>(inputDimensions[0]) != halfSize[0] || static_cast<unsigned int>(inputDimensions[1]) < 2 * halfSize[1])
+  {
+    LOG_ERROR("Input frame size (" << inputDimensions[0] << "x" << inputDimensions[1] << ") does not match the size the deinterlacer was initialized with.");
+    return PLUS_FAIL;
+  }
+
+  const size_t halfBytes = GetPixelSizeInBytes(inputImage) * halfSize[0] * halfSize[1];
+  const unsigned char* topHalfPtr = static_cast<const unsigned char*>(inputImage->GetScalarPointer());
+  const unsigned char* bottomHalfPtr = topHalfPtr + halfBytes;
+  vtkPlusDataSource* topSource = this->SwitchInterlaceOrdering ? this->RightSource : this->LeftSource;
+  vtkPlusDataSource* bottomSource = this->SwitchInterlaceOrdering ? this->LeftSource : this->RightSource;
+
+  PlusStatus status = topSource->AddItem(topHalfPtr, topSource->GetInputImageOrientation(), halfSize, inputImage->GetScalarType(),
+                                         inputImage->GetNumberOfScalarComponents(), topSource->GetImageType(), 0, this->FrameNumber);
+  if (bottomSource->AddItem(bottomHalfPtr, bottomSource->GetInputImageOrientation(), halfSize, inputImage->GetScalarType(),
+                            inputImage->GetNumberOfScalarComponents(), bottomSource->GetImageType(), 0, this->FrameNumber) != PLUS_SUCCESS)
+  {
+    status = PLUS_FAIL;
+  }
+  return status;
 }
 
 //----------------------------------------------------------------------------
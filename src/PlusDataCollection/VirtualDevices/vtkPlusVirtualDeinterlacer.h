@@ -22,7 +22,12 @@ class vtkPlusDataSource;
 
 /*!
 \class vtkPlusVirtualDeinterlacer
-\brief
+\brief Splits the frames of a stereo video input into a left and a right video source
+
+Supported stereo layouts: interlaced rows (HorizontalInterlace), interlaced columns (VerticalInterlace),
+left and right halves (SideBySide) and top and bottom halves (TopBottom). Rows and row segments are
+copied with memcpy. The top and bottom halves are contiguous in memory, so they are added to the
+output sources directly from the input frame, without an intermediate copy.
 
 \ingroup PlusLibDataCollection
 */
@@ -33,7 +38,9 @@ public:
   {
     Stereo_Unknown,
     Stereo_HorizontalInterlace,
-    Stereo_VerticalInterlace
+    Stereo_VerticalInterlace,
+    Stereo_SideBySide,
+    Stereo_TopBottom
   };
 
   static vtkPlusVirtualDeinterlacer* New();
@@ -58,8 +65,14 @@ public:
   vtkSetMacro(SwitchInterlaceOrdering, bool);
 
 protected:
+  /*! Even rows to the left image, odd rows to the right image */
   void SplitFrameHorizontal(igsioTrackedFrame* frame);
+  /*! Even columns to the left image, odd columns to the right image */
   void SplitFrameVertical(igsioTrackedFrame* frame);
+  /*! Left half to the left image, right half to the right image */
+  void SplitFrameSideBySide(igsioTrackedFrame* frame);
+  /*! Add the top and bottom halves of the frame to the left and right sources without copying them into the images */
+  PlusStatus AddFrameTopBottom(igsioTrackedFrame* frame);
 
 protected:
   vtkPlusVirtualDeinterlacer();
@@ -0,0 +1,428 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataSource.h"
+#include "vtkPlusVirtualImageResizer.h"
+
+// IGSIO includes
+#include <igsioVideoFrame.h>
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+#include <vtkUnsignedCharArray.h>
+
+//----------------------------------------------------------------------------
+
+vtkStandardNewMacro(vtkPlusVirtualImageResizer);
+
+//----------------------------------------------------------------------------
+vtkPlusVirtualImageResizer::vtkPlusVirtualImageResizer()
+  : vtkPlusDevice()
+  , LastProcessedUid(0)
+{
+  this->AcquisitionRate = vtkPlusDevice::VIRTUAL_DEVICE_FRAME_RATE;
+
+  // The data capture thread will be used to regularly check the input and resize the new frames
+  this->StartThreadForInternalUpdates = true;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusVirtualImageResizer::~vtkPlusVirtualImageResizer()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusVirtualImageResizer::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  for (std::vector<ResizedOutput>::const_iterator it = this->ResizedOutputs.begin(); it != this->ResizedOutputs.end(); ++it)
+  {
+    os << indent << it->Source->GetId() << ": " << it->OutputSize[0] << "x" << it->OutputSize[1]
+       << " (" << PixelCodec::GetResizeFilterAsString(it->Filter) << ")" << std::endl;
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualImageResizer::ReadConfiguration(vtkXMLDataElement* rootConfigElement)
+{
+  XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_READING(deviceConfig, rootConfigElement);
+
+  this->ResizedOutputs.clear();
+  XML_FIND_NESTED_ELEMENT_REQUIRED(dataSourcesElement, deviceConfig, "DataSources");
+  for (int nestedElementIndex = 0; nestedElementIndex < dataSourcesElement->GetNumberOfNestedElements(); nestedElementIndex++)
+  {
+    vtkXMLDataElement* dataElement = dataSourcesElement->GetNestedElement(nestedElementIndex);
+    if (STRCASECMP(dataElement->GetName(), "DataSource") != 0
+        || dataElement->GetAttribute("Type") == NULL || STRCASECMP(dataElement->GetAttribute("Type"), vtkPlusDataSource::DATA_SOURCE_TYPE_VIDEO_TAG.c_str()) != 0)
+    {
+      // if this is not a video data source element, skip it
+      continue;
+    }
+
+    ResizedOutput output;
+    const char* sourceId = dataElement->GetAttribute("Id");
+    if (sourceId == NULL || this->GetVideoSource(sourceId, output.Source) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Unable to find video source " << (sourceId == NULL ? "(undefined)" : sourceId) << " of device " << this->GetDeviceId());
+      return PLUS_FAIL;
+    }
+    XML_READ_VECTOR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, 2, OutputSize, output.OutputSize, dataElement);
+    if (output.OutputSize[0] < 1 || output.OutputSize[1] < 1)
+    {
+      LOG_ERROR("OutputSize attribute with two positive values is required for video source " << sourceId << " of device " << this->GetDeviceId());
+      return PLUS_FAIL;
+    }
+    std::string filterName;
+    XML_READ_STRING_ATTRIBUTE_NONMEMBER_OPTIONAL(ResizeFilter, filterName, dataElement);
+    if (!filterName.empty() && PixelCodec::GetResizeFilterFromString(filterName, output.Filter) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    this->ResizedOutputs.push_back(output);
+  }
+
+  if (this->ResizedOutputs.empty())
+  {
+    LOG_ERROR("No video data sources are defined for vtkPlusVirtualImageResizer " << this->GetDeviceId());
+    return PLUS_FAIL;
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualImageResizer::WriteConfiguration(vtkXMLDataElement* rootConfigElement)
+{
+  XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_WRITING(deviceConfig, rootConfigElement);
+
+  XML_FIND_NESTED_ELEMENT_REQUIRED(dataSourcesElement, deviceConfig, "DataSources");
+  for (int nestedElementIndex = 0; nestedElementIndex < dataSourcesElement->GetNumberOfNestedElements(); nestedElementIndex++)
+  {
+    vtkXMLDataElement* dataElement = dataSourcesElement->GetNestedElement(nestedElementIndex);
+    if (STRCASECMP(dataElement->GetName(), "DataSource") != 0 || dataElement->GetAttribute("Id") == NULL)
+    {
+      continue;
+    }
+    for (std::vector<ResizedOutput>::const_iterator it = this->ResizedOutputs.begin(); it != this->ResizedOutputs.end(); ++it)
+    {
+      if (it->Source->GetId() == dataElement->GetAttribute("Id"))
+      {
+        dataElement->SetVectorAttribute("OutputSize", 2, it->OutputSize);
+        dataElement->SetAttribute("ResizeFilter", PixelCodec::GetResizeFilterAsString(it->Filter).c_str());
+      }
+    }
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusVirtualImageResizer::GetAcquisitionRate() const
+{
+  if (this->InputChannels.empty() || this->InputChannels[0]->GetOwnerDevice() == NULL)
+  {
+    return this->AcquisitionRate;
+  }
+  return this->InputChannels[0]->GetOwnerDevice()->GetAcquisitionRate();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualImageResizer::NotifyConfigured()
+{
+  if (this->InputChannels.empty())
+  {
+    LOG_ERROR("No input channel set for vtkPlusVirtualImageResizer " << this->GetDeviceId());
+    this->SetCorrectlyConfigured(false);
+    return PLUS_FAIL;
+  }
+  if (this->InputChannels.size() > 1)
+  {
+    LOG_WARNING("vtkPlusVirtualImageResizer is expecting one input channel and there are " << this->InputChannels.size() << " channels. First input channel will be used, all other are ignored.");
+  }
+  vtkPlusChannel* inputChannel = this->InputChannels[0];
+  vtkPlusDataSource* inputVideo = NULL;
+  if (!inputChannel->HasVideoSource() || inputChannel->GetVideoSource(inputVideo) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Input channel " << inputChannel->GetChannelId() << " of vtkPlusVirtualImageResizer " << this->GetDeviceId() << " has no video source");
+    this->SetCorrectlyConfigured(false);
+    return PLUS_FAIL;
+  }
+
+  // Resized frames are not reoriented, so their pixels can be swapped into the output buffers
+  for (std::vector<ResizedOutput>::iterator it = this->ResizedOutputs.begin(); it != this->ResizedOutputs.end(); ++it)
+  {
+    it->Source->SetInputImageOrientation(inputVideo->GetOutputImageOrientation());
+    it->Source->SetOutputImageOrientation(inputVideo->GetOutputImageOrientation());
+  }
+
+  // Tool and field data output sources have the same IDs as the input sources and they are shared by all output channels.
+  // They are reused if the device is configured again.
+  int numberOfErrors(0);
+  std::vector<vtkPlusDataSource*> outputTools;
+  for (DataSourceContainerConstIterator it = inputChannel->GetToolsStartConstIterator(); it != inputChannel->GetToolsEndConstIterator(); ++it)
+  {
+    vtkPlusDataSource* inputTool = it->second;
+    vtkPlusDataSource* outputTool = NULL;
+    if (this->GetTool(inputTool->GetId(), outputTool) != PLUS_SUCCESS)
+    {
+      vtkSmartPointer<vtkPlusDataSource> aDataSource = vtkSmartPointer<vtkPlusDataSource>::New();
+      aDataSource->SetId(inputTool->GetId());
+      aDataSource->SetType(DATA_SOURCE_TYPE_TOOL);
+      aDataSource->SetReferenceCoordinateFrameName(inputTool->GetReferenceCoordinateFrameName());
+      aDataSource->SetBufferSize(inputTool->GetBufferSize());
+      if (this->AddTool(aDataSource, false) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Unable to add tool " << inputTool->GetId() << " to device " << this->GetDeviceId());
+        numberOfErrors++;
+        continue;
+      }
+      outputTool = aDataSource;
+    }
+    outputTools.push_back(outputTool);
+  }
+
+  std::vector<vtkPlusDataSource*> outputFieldSources;
+  for (DataSourceContainerConstIterator it = inputChannel->GetFieldDataSourcesStartConstIterator(); it != inputChannel->GetFieldDataSourcesEndConstIterator(); ++it)
+  {
+    vtkPlusDataSource* inputFieldSource = it->second;
+    vtkPlusDataSource* outputFieldSource = NULL;
+    if (this->GetFieldDataSource(inputFieldSource->GetId(), outputFieldSource) != PLUS_SUCCESS)
+    {
+      vtkSmartPointer<vtkPlusDataSource> aDataSource = vtkSmartPointer<vtkPlusDataSource>::New();
+      aDataSource->SetId(inputFieldSource->GetId());
+      aDataSource->SetType(DATA_SOURCE_TYPE_FIELDDATA);
+      aDataSource->SetBufferSize(inputFieldSource->GetBufferSize());
+      if (this->AddFieldDataSource(aDataSource) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Unable to add field data source " << inputFieldSource->GetId() << " to device " << this->GetDeviceId());
+        numberOfErrors++;
+        continue;
+      }
+      outputFieldSource = aDataSource;
+    }
+    outputFieldSources.push_back(outputFieldSource);
+  }
+
+  for (ChannelContainerIterator channelIt = this->OutputChannels.begin(); channelIt != this->OutputChannels.end(); ++channelIt)
+  {
+    vtkPlusChannel* outputChannel = *channelIt;
+    for (std::vector<vtkPlusDataSource*>::iterator toolIt = outputTools.begin(); toolIt != outputTools.end(); ++toolIt)
+    {
+      vtkPlusDataSource* existingTool = NULL;
+      if (outputChannel->GetTool(existingTool, (*toolIt)->GetId()) != PLUS_SUCCESS)
+      {
+        outputChannel->AddTool(*toolIt);
+      }
+    }
+    for (std::vector<vtkPlusDataSource*>::iterator fieldIt = outputFieldSources.begin(); fieldIt != outputFieldSources.end(); ++fieldIt)
+    {
+      vtkPlusDataSource* existingFieldSource = NULL;
+      if (outputChannel->GetFieldDataSource(existingFieldSource, (*fieldIt)->GetId()) != PLUS_SUCCESS)
+      {
+        outputChannel->AddFieldDataSource(*fieldIt);
+      }
+    }
+  }
+
+  if (numberOfErrors > 0)
+  {
+    this->SetCorrectlyConfigured(false);
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualImageResizer::InternalStartRecording()
+{
+  // Frames acquired before the recording started are not added to the output
+  this->LastProcessedUid = 0;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualImageResizer::InternalUpdate()
+{
+  vtkPlusDataSource* inputVideo = NULL;
+  if (this->InputChannels.empty() || this->InputChannels[0]->GetVideoSource(inputVideo) != PLUS_SUCCESS || inputVideo->GetNumberOfItems() < 1)
+  {
+    // No input data yet
+    return PLUS_SUCCESS;
+  }
+
+  BufferItemUidType latestUid = inputVideo->GetLatestItemUidInBuffer();
+  BufferItemUidType uid = inputVideo->GetOldestItemUidInBuffer();
+  if (this->LastProcessedUid == 0)
+  {
+    // Start with the most recent frame
+    uid = latestUid;
+  }
+  else if (this->LastProcessedUid + 1 > uid)
+  {
+    uid = this->LastProcessedUid + 1;
+  }
+
+  PlusStatus status = PLUS_SUCCESS;
+  for (; uid <= latestUid; ++uid)
+  {
+    this->LastProcessedUid = uid;
+    if (this->AddOutputFrame(inputVideo, uid) != PLUS_SUCCESS)
+    {
+      status = PLUS_FAIL;
+    }
+  }
+
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualImageResizer::AddOutputFrame(vtkPlusDataSource* inputVideo, BufferItemUidType uid)
+{
+  StreamBufferItem videoItem;
+  if (inputVideo->GetStreamBufferItem(uid, &videoItem, true /* share image data */) != ITEM_OK)
+  {
+    // The item has just been overwritten in the input buffer
+    return PLUS_SUCCESS;
+  }
+  const double timestamp = videoItem.GetFilteredTimestamp(inputVideo->GetLocalTimeOffsetSec());
+  igsioFieldMapType customFields;
+  videoItem.GetFrameFields().GetFieldMap(customFields);
+
+  // Generate unique frame number (not used for filtering, the input timestamp is used as is)
+  this->FrameNumber++;
+  int numberOfErrors(0);
+
+  for (std::vector<ResizedOutput>::iterator it = this->ResizedOutputs.begin(); it != this->ResizedOutputs.end(); ++it)
+  {
+    if (this->AddOutputImage(*it, videoItem.GetFrame(), timestamp, customFields) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Virtual image resizer " << this->GetDeviceId() << " failed to add resized frame to " << it->Source->GetId() << " at " << std::fixed << timestamp);
+      numberOfErrors++;
+    }
+  }
+
+  // Interpolate all tools at the frame time in one pass
+  vtkPlusChannel* inputChannel = this->InputChannels[0];
+  std::vector<vtkPlusChannel::ToolTransform> toolTransforms;
+  inputChannel->GetInterpolatedToolTransforms(timestamp, toolTransforms);
+  if (!toolTransforms.empty())
+  {
+    std::vector< vtkSmartPointer<vtkMatrix4x4> > matrices(toolTransforms.size());
+    ToolTimeStampedItemList items;
+    items.reserve(toolTransforms.size());
+    for (size_t toolIndex = 0; toolIndex < toolTransforms.size(); ++toolIndex)
+    {
+      const vtkPlusChannel::ToolTransform& toolTransform = toolTransforms[toolIndex];
+      matrices[toolIndex] = vtkSmartPointer<vtkMatrix4x4>::New();
+      ToolStatus toolStatus = TOOL_MISSING;
+      if (toolTransform.Result == ITEM_OK)
+      {
+        matrices[toolIndex]->DeepCopy(toolTransform.Sample.Matrix);
+        toolStatus = toolTransform.Sample.Status;
+      }
+      items.push_back(ToolTimeStampedItem(toolTransform.Tool->GetId(), matrices[toolIndex], toolStatus, this->FrameNumber));
+    }
+    if (this->AddTimeStampedItems(items, timestamp, timestamp) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Virtual image resizer " << this->GetDeviceId() << " failed to add tool transforms at " << std::fixed << timestamp);
+      numberOfErrors++;
+    }
+  }
+
+  for (DataSourceContainerConstIterator it = inputChannel->GetFieldDataSourcesStartConstIterator(); it != inputChannel->GetFieldDataSourcesEndConstIterator(); ++it)
+  {
+    vtkPlusDataSource* inputFieldSource = it->second;
+    vtkPlusDataSource* outputFieldSource = NULL;
+    StreamBufferItem fieldItem;
+    if (this->GetFieldDataSource(inputFieldSource->GetId(), outputFieldSource) != PLUS_SUCCESS
+        || inputFieldSource->GetStreamBufferItemFromTime(timestamp, &fieldItem, vtkPlusBuffer::CLOSEST_TIME) != ITEM_OK)
+    {
+      // Field data is optional, it may not be available yet
+      continue;
+    }
+    igsioFieldMapType fields;
+    fieldItem.GetFrameFields().GetFieldMap(fields);
+    if (outputFieldSource->AddItem(fields, this->FrameNumber, timestamp, timestamp) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Virtual image resizer " << this->GetDeviceId() << " failed to add field data of " << inputFieldSource->GetId() << " at " << std::fixed << timestamp);
+      numberOfErrors++;
+    }
+  }
+
+  return numberOfErrors == 0 ? PLUS_SUCCESS : PLUS_FAIL;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualImageResizer::AddOutputImage(ResizedOutput& output, igsioVideoFrame& inputFrame, double timestamp, const igsioFieldMapType& customFields)
+{
+  vtkPlusDataSource* outputVideo = output.Source;
+  if (!inputFrame.IsImageValid())
+  {
+    return outputVideo->AddItem(customFields, this->FrameNumber, timestamp, timestamp);
+  }
+  if (inputFrame.IsFrameEncoded() || inputFrame.GetVTKScalarPixelType() != VTK_UNSIGNED_CHAR)
+  {
+    LOG_ERROR("Virtual image resizer " << this->GetDeviceId() << " can only resize 8-bit images that are not encoded");
+    return PLUS_FAIL;
+  }
+
+  unsigned int numberOfScalarComponents(1);
+  if (inputFrame.GetNumberOfScalarComponents(numberOfScalarComponents) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to retrieve number of scalar components.");
+    return PLUS_FAIL;
+  }
+  const FrameSizeType inputSize = inputFrame.GetFrameSize();
+  const FrameSizeType outputSize = { static_cast<unsigned int>(output.OutputSize[0]), static_cast<unsigned int>(output.OutputSize[1]), inputSize[2] };
+  const vtkIdType numberOfPixels = static_cast<vtkIdType>(outputSize[0]) * outputSize[1] * outputSize[2];
+  if (output.Pixels == NULL || output.Pixels->GetNumberOfComponents() != static_cast<int>(numberOfScalarComponents) || output.Pixels->GetNumberOfTuples() != numberOfPixels)
+  {
+    output.Pixels = vtkSmartPointer<vtkUnsignedCharArray>::New();
+    output.Pixels->SetNumberOfComponents(numberOfScalarComponents);
+    output.Pixels->SetNumberOfTuples(numberOfPixels);
+  }
+
+  // Slices of volumes are resized one by one
+  const int inputSliceSize[2] = { static_cast<int>(inputSize[0]), static_cast<int>(inputSize[1]) };
+  const size_t inputSliceSizeBytes = static_cast<size_t>(inputSize[0]) * inputSize[1] * numberOfScalarComponents;
+  const size_t outputSliceSizeBytes = static_cast<size_t>(outputSize[0]) * outputSize[1] * numberOfScalarComponents;
+  const unsigned char* inputPixels = static_cast<const unsigned char*>(inputFrame.GetScalarPointer());
+  unsigned char* outputPixels = static_cast<unsigned char*>(output.Pixels->GetVoidPointer(0));
+  for (unsigned int z = 0; z < inputSize[2]; ++z)
+  {
+    if (PixelCodec::ResizeImage(inputPixels + z * inputSliceSizeBytes, inputSliceSize, numberOfScalarComponents, output.OutputSize, output.Filter,
+                                outputPixels + z * outputSliceSizeBytes) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+  }
+
+  // The output buffer takes the format of the input frames
+  if (outputVideo->GetNumberOfItems() == 0 || outputVideo->GetInputFrameSize() != outputSize
+      || outputVideo->GetNumberOfScalarComponents() != numberOfScalarComponents || outputVideo->GetImageType() != inputFrame.GetImageType())
+  {
+    outputVideo->SetPixelType(VTK_UNSIGNED_CHAR);
+    outputVideo->SetNumberOfScalarComponents(numberOfScalarComponents);
+    outputVideo->SetImageType(inputFrame.GetImageType());
+    outputVideo->SetInputFrameSize(outputSize);
+  }
+
+  if (!outputVideo->CanAddItemBySwappingPixels())
+  {
+    // Clipping or buffers with contiguous frame memory need a copy
+    return outputVideo->AddItem(outputPixels, outputVideo->GetInputImageOrientation(), outputSize, VTK_UNSIGNED_CHAR, numberOfScalarComponents,
+                                inputFrame.GetImageType(), 0, this->FrameNumber, timestamp, timestamp, &customFields);
+  }
+
+  // The pixels of the overwritten output frame are returned, the next frame is resized into them
+  return outputVideo->AddItemBySwappingPixels(output.Pixels, this->FrameNumber, timestamp, timestamp, &customFields);
+}
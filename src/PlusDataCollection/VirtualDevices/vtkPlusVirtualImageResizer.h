@@ -0,0 +1,90 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusVirtualImageResizer_h
+#define __vtkPlusVirtualImageResizer_h
+
+#include "vtkPlusDataCollectionExport.h"
+
+#include "PixelCodec.h"
+#include "vtkPlusDevice.h"
+
+#include <vector>
+
+class vtkDataArray;
+class vtkPlusDataSource;
+
+/*!
+\class vtkPlusVirtualImageResizer
+\brief Publishes resized (typically downscaled) copies of the video of the input channel
+
+Each video data source of the device has an OutputSize (and optionally a ResizeFilter) attribute and it is
+the video source of one of the output channels. Every input frame is resized into each video source
+(see PixelCodec::ResizeImage), the tools and field data of the input channel are added to all output channels,
+with the timestamp of the input frame. Consumers that need small images (viewers, inference) can then
+receive the small stream instead of resizing the full resolution images themselves.
+
+Only 8-bit images can be resized.
+
+\ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport vtkPlusVirtualImageResizer : public vtkPlusDevice
+{
+public:
+  static vtkPlusVirtualImageResizer* New();
+  vtkTypeMacro(vtkPlusVirtualImageResizer, vtkPlusDevice);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  virtual bool IsTracker() const { return false; }
+  virtual bool IsVirtual() const { return true; }
+
+  /*! Read configuration from xml data */
+  virtual PlusStatus ReadConfiguration(vtkXMLDataElement*);
+
+  /*! Write configuration to xml data */
+  virtual PlusStatus WriteConfiguration(vtkXMLDataElement*);
+
+  /*! Add the tools and field data sources of the input channel to the output channels */
+  virtual PlusStatus NotifyConfigured();
+
+  /*! Frame rate of the output channels, which is the frame rate of the input channel */
+  virtual double GetAcquisitionRate() const;
+
+protected:
+  vtkPlusVirtualImageResizer();
+  virtual ~vtkPlusVirtualImageResizer();
+
+  virtual PlusStatus InternalUpdate();
+
+  virtual PlusStatus InternalStartRecording();
+
+  /*! Add the resized images, the tool transforms, and the field data of the input item to the output sources */
+  PlusStatus AddOutputFrame(vtkPlusDataSource* inputVideo, BufferItemUidType uid);
+
+  struct ResizedOutput
+  {
+    ResizedOutput() : Source(NULL), Filter(PixelCodec::ResizeFilter_Area) { this->OutputSize[0] = this->OutputSize[1] = 0; }
+    vtkPlusDataSource* Source;
+    int OutputSize[2];
+    PixelCodec::ResizeFilter Filter;
+    /*! Pixels of the next output frame, swapped with the pixels of the overwritten output buffer frame (so they are reused) */
+    vtkSmartPointer<vtkDataArray> Pixels;
+  };
+
+  /*! Resize the input image into the output video source */
+  PlusStatus AddOutputImage(ResizedOutput& output, igsioVideoFrame& inputFrame, double timestamp, const igsioFieldMapType& customFields);
+
+  std::vector<ResizedOutput> ResizedOutputs;
+
+  /*! UID of the last processed item of the input video source, 0 if none */
+  BufferItemUidType LastProcessedUid;
+
+private:
+  vtkPlusVirtualImageResizer(const vtkPlusVirtualImageResizer&);  // Not implemented.
+  void operator=(const vtkPlusVirtualImageResizer&);  // Not implemented.
+};
+
+#endif
@@ -9,6 +9,16 @@ See License.txt for details.
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataSource.h"
 #include "vtkPlusVirtualMixer.h"
+#include "vtkIGSIOAccurateTimer.h"
+#include "vtkMatrix4x4.h"
+
+#include <sstream>
+
+namespace
+{
+  /*! Name of the frame field that contains the time the frame was held back in synchronized output mode */
+  const char* SYNCHRONIZATION_LATENCY_FIELD_NAME = "MixerSynchronizationLatencySec";
+}
 
 //----------------------------------------------------------------------------
 
@@ -17,10 +27,17 @@ vtkStandardNewMacro(vtkPlusVirtualMixer);
 //----------------------------------------------------------------------------
 vtkPlusVirtualMixer::vtkPlusVirtualMixer()
   : vtkPlusDevice()
+  , SynchronizedOutput(false)
+  , MaximumSynchronizationLatencySec(0.2)
+  , LastSynchronizationLatencySec(0.0)
+  , NumberOfLateFrames(0)
+  , MixedInputChannel(vtkSmartPointer<vtkPlusChannel>::New())
+  , LastSynchronizedUid(0)
 {
   this->AcquisitionRate = vtkPlusDevice::VIRTUAL_DEVICE_FRAME_RATE;
 
-  // No need for StartThreadForInternalUpdates, as capturing is performed in other devices, here we just collect references to buffers
+  // No need for StartThreadForInternalUpdates by default, as capturing is performed in other devices, here we just collect references to buffers.
+  // The thread is only started in synchronized output mode (see ReadConfiguration).
 }
 
 //----------------------------------------------------------------------------
@@ -46,6 +63,11 @@ vtkPlusVirtualMixer::~vtkPlusVirtualMixer()
 void vtkPlusVirtualMixer::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "SynchronizedOutput: " << (this->SynchronizedOutput ? "TRUE" : "FALSE") << std::endl;
+  os << indent << "MaximumSynchronizationLatencySec: " << this->MaximumSynchronizationLatencySec << std::endl;
+  os << indent << "LastSynchronizationLatencySec: " << this->LastSynchronizationLatencySec << std::endl;
+  os << indent << "NumberOfLateFrames: " << this->NumberOfLateFrames << std::endl;
 }
 
 //----------------------------------------------------------------------------
@@ -63,6 +85,28 @@ PlusStatus vtkPlusVirtualMixer::ReadConfiguration(vtkXMLDataElement* rootConfigE
     this->AddOutputChannel(aChannel);
   }
 
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(SynchronizedOutput, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, MaximumSynchronizationLatencySec, deviceConfig);
+  if (this->MaximumSynchronizationLatencySec < 0)
+  {
+    LOG_WARNING("MaximumSynchronizationLatencySec must not be negative, use 0 instead of " << this->MaximumSynchronizationLatencySec);
+    this->MaximumSynchronizationLatencySec = 0;
+  }
+
+  // In synchronized output mode the mixer generates the output frames on its own thread
+  this->StartThreadForInternalUpdates = this->SynchronizedOutput;
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualMixer::WriteConfiguration(vtkXMLDataElement* rootConfigElement)
+{
+  XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_WRITING(deviceConfig, rootConfigElement);
+
+  XML_WRITE_BOOL_ATTRIBUTE(SynchronizedOutput, deviceConfig);
+  deviceConfig->SetDoubleAttribute("MaximumSynchronizationLatencySec", this->MaximumSynchronizationLatencySec);
+
   return PLUS_SUCCESS;
 }
 
@@ -114,6 +158,42 @@ PlusStatus vtkPlusVirtualMixer::NotifyConfigured()
   outputChannel->RemoveFieldDataSources();
   outputChannel->Clear();
 
+  PlusStatus status = PLUS_SUCCESS;
+  if (this->SynchronizedOutput)
+  {
+    // The input sources are only sampled, the output channel contains the sources of the mixer.
+    // The sources are removed before Clear() so that the input buffers are not cleared.
+    this->MixedInputChannel->RemoveTools();
+    this->MixedInputChannel->RemoveFieldDataSources();
+    this->MixedInputChannel->SetVideoSource(NULL);
+    this->MixedInputChannel->Clear();
+    this->AddInputSources(this->MixedInputChannel, false);
+    status = this->CreateSynchronizedOutputSources(outputChannel);
+  }
+  else
+  {
+    this->AddInputSources(outputChannel, true);
+  }
+
+  for (ChannelContainerIterator it = this->InputChannels.begin(); it != this->InputChannels.end(); ++it)
+  {
+    vtkPlusChannel* anInputChannel = (*it);
+    if (anInputChannel->GetRfProcessor() != NULL && outputChannel->GetRfProcessor() == NULL)
+    {
+      outputChannel->SetRfProcessor(anInputChannel->GetRfProcessor());
+    }
+    else if (anInputChannel->GetRfProcessor() != NULL && outputChannel->GetRfProcessor() != NULL)
+    {
+      LOG_WARNING("Multiple RfProcessors defined in InputChannels to mixer: " << this->GetDeviceId() << ". Check input configuration.");
+    }
+  }
+
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualMixer::AddInputSources(vtkPlusChannel* aChannel, bool addToDevice)
+{
   for (ChannelContainerIterator it = this->InputChannels.begin(); it != this->InputChannels.end(); ++it)
   {
     vtkPlusChannel* anInputChannel = (*it);
@@ -121,8 +201,11 @@ PlusStatus vtkPlusVirtualMixer::NotifyConfigured()
 
     if (anInputChannel->HasVideoSource() && anInputChannel->GetVideoSource(aSource) == PLUS_SUCCESS)
     {
-      outputChannel->SetVideoSource(aSource);
-      this->AddVideoSource(aSource);
+      aChannel->SetVideoSource(aSource);
+      if (addToDevice)
+      {
+        this->AddVideoSource(aSource);
+      }
     }
 
     for (DataSourceContainerConstIterator fieldSourceIter = anInputChannel->GetToolsStartConstIterator(); fieldSourceIter != anInputChannel->GetToolsEndConstIterator(); ++fieldSourceIter)
@@ -130,7 +213,7 @@ PlusStatus vtkPlusVirtualMixer::NotifyConfigured()
       vtkPlusDataSource* anInputTool = fieldSourceIter->second;
 
       bool found = false;
-      for (DataSourceContainerConstIterator outputToolIt = outputChannel->GetToolsStartConstIterator(); outputToolIt != outputChannel->GetToolsEndConstIterator(); ++outputToolIt)
+      for (DataSourceContainerConstIterator outputToolIt = aChannel->GetToolsStartConstIterator(); outputToolIt != aChannel->GetToolsEndConstIterator(); ++outputToolIt)
       {
         vtkPlusDataSource* anOutputTool = outputToolIt->second;
         // Check for double adds or name conflicts
@@ -150,8 +233,8 @@ PlusStatus vtkPlusVirtualMixer::NotifyConfigured()
 
       if (!found)
       {
-        outputChannel->AddTool(anInputTool);
-        if (this->AddTool(anInputTool, false) != PLUS_SUCCESS)
+        aChannel->AddTool(anInputTool);
+        if (addToDevice && this->AddTool(anInputTool, false) != PLUS_SUCCESS)
         {
           LOG_ERROR("Unable to add tool " << anInputTool->GetId() << " to device " << this->GetDeviceId());
         }
@@ -163,7 +246,7 @@ PlusStatus vtkPlusVirtualMixer::NotifyConfigured()
       vtkPlusDataSource* inputFieldSource = fieldSourceIter->second;
 
       bool found = false;
-      for (DataSourceContainerConstIterator outputFieldSourceIter = outputChannel->GetFieldDataSourcesStartConstIterator(); outputFieldSourceIter != outputChannel->GetFieldDataSourcesEndConstIterator(); ++outputFieldSourceIter)
+      for (DataSourceContainerConstIterator outputFieldSourceIter = aChannel->GetFieldDataSourcesStartConstIterator(); outputFieldSourceIter != aChannel->GetFieldDataSourcesEndConstIterator(); ++outputFieldSourceIter)
       {
         vtkPlusDataSource* outputFieldSource = outputFieldSourceIter->second;
         // Check for double adds or name conflicts
@@ -183,22 +266,14 @@ PlusStatus vtkPlusVirtualMixer::NotifyConfigured()
 
       if (!found)
       {
-        outputChannel->AddFieldDataSource(inputFieldSource);
-        if (this->AddFieldDataSource(inputFieldSource) != PLUS_SUCCESS)
+        aChannel->AddFieldDataSource(inputFieldSource);
+        if (addToDevice && this->AddFieldDataSource(inputFieldSource) != PLUS_SUCCESS)
         {
           LOG_ERROR("Unable to add field data source " << inputFieldSource->GetId() << " to device " << this->GetDeviceId());
         }
       }
     }
 
-    if (anInputChannel->GetRfProcessor() != NULL && outputChannel->GetRfProcessor() == NULL)
-    {
-      outputChannel->SetRfProcessor(anInputChannel->GetRfProcessor());
-    }
-    else if (anInputChannel->GetRfProcessor() != NULL && outputChannel->GetRfProcessor() != NULL)
-    {
-      LOG_WARNING("Multiple RfProcessors defined in InputChannels to mixer: " << this->GetDeviceId() << ". Check input configuration.");
-    }
   }
 
   return PLUS_SUCCESS;
@@ -255,3 +330,311 @@ vtkPlusChannel* vtkPlusVirtualMixer::GetChannel() const
 {
   return this->OutputChannels[0];
 }
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualMixer::CreateSynchronizedOutputSources(vtkPlusChannel* outputChannel)
+{
+  int numberOfErrors(0);
+
+  // Sources are reused if the mixer is configured again
+  vtkPlusDataSource* inputVideo = NULL;
+  if (this->MixedInputChannel->HasVideoSource() && this->MixedInputChannel->GetVideoSource(inputVideo) == PLUS_SUCCESS)
+  {
+    vtkPlusDataSource* outputVideo = NULL;
+    if (this->GetVideoSource(inputVideo->GetId().c_str(), outputVideo) != PLUS_SUCCESS)
+    {
+      vtkSmartPointer<vtkPlusDataSource> aDataSource = vtkSmartPointer<vtkPlusDataSource>::New();
+      aDataSource->SetId(inputVideo->GetId());
+      aDataSource->SetType(DATA_SOURCE_TYPE_VIDEO);
+      aDataSource->SetBufferSize(inputVideo->GetBufferSize());
+      // Frames in the input buffer are already in the output orientation
+      aDataSource->SetInputImageOrientation(inputVideo->GetOutputImageOrientation());
+      aDataSource->SetOutputImageOrientation(inputVideo->GetOutputImageOrientation());
+      if (this->AddVideoSource(aDataSource) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Unable to add video source " << inputVideo->GetId() << " to device " << this->GetDeviceId());
+        numberOfErrors++;
+      }
+      outputVideo = aDataSource;
+    }
+    outputChannel->SetVideoSource(outputVideo);
+  }
+
+  for (DataSourceContainerConstIterator it = this->MixedInputChannel->GetToolsStartConstIterator(); it != this->MixedInputChannel->GetToolsEndConstIterator(); ++it)
+  {
+    vtkPlusDataSource* inputTool = it->second;
+    vtkPlusDataSource* outputTool = NULL;
+    if (this->GetTool(inputTool->GetId(), outputTool) != PLUS_SUCCESS)
+    {
+      vtkSmartPointer<vtkPlusDataSource> aDataSource = vtkSmartPointer<vtkPlusDataSource>::New();
+      aDataSource->SetId(inputTool->GetId());
+      aDataSource->SetType(DATA_SOURCE_TYPE_TOOL);
+      aDataSource->SetReferenceCoordinateFrameName(inputTool->GetReferenceCoordinateFrameName());
+      aDataSource->SetBufferSize(inputTool->GetBufferSize());
+      if (this->AddTool(aDataSource, false) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Unable to add tool " << inputTool->GetId() << " to device " << this->GetDeviceId());
+        numberOfErrors++;
+        continue;
+      }
+      outputTool = aDataSource;
+    }
+    outputChannel->AddTool(outputTool);
+  }
+
+  for (DataSourceContainerConstIterator it = this->MixedInputChannel->GetFieldDataSourcesStartConstIterator(); it != this->MixedInputChannel->GetFieldDataSourcesEndConstIterator(); ++it)
+  {
+    vtkPlusDataSource* inputFieldSource = it->second;
+    vtkPlusDataSource* outputFieldSource = NULL;
+    if (this->GetFieldDataSource(inputFieldSource->GetId(), outputFieldSource) != PLUS_SUCCESS)
+    {
+      vtkSmartPointer<vtkPlusDataSource> aDataSource = vtkSmartPointer<vtkPlusDataSource>::New();
+      aDataSource->SetId(inputFieldSource->GetId());
+      aDataSource->SetType(DATA_SOURCE_TYPE_FIELDDATA);
+      aDataSource->SetBufferSize(inputFieldSource->GetBufferSize());
+      if (this->AddFieldDataSource(aDataSource) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Unable to add field data source " << inputFieldSource->GetId() << " to device " << this->GetDeviceId());
+        numberOfErrors++;
+        continue;
+      }
+      outputFieldSource = aDataSource;
+    }
+    outputChannel->AddFieldDataSource(outputFieldSource);
+  }
+
+  return numberOfErrors == 0 ? PLUS_SUCCESS : PLUS_FAIL;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualMixer::InternalStartRecording()
+{
+  // Frames acquired before the recording started are not added to the output
+  this->LastSynchronizedUid = 0;
+  this->LastSynchronizationLatencySec = 0.0;
+  this->NumberOfLateFrames = 0;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusDataSource* vtkPlusVirtualMixer::GetSynchronizationSource()
+{
+  vtkPlusDataSource* aSource = NULL;
+  if (this->MixedInputChannel->HasVideoSource() && this->MixedInputChannel->GetVideoSource(aSource) == PLUS_SUCCESS)
+  {
+    return aSource;
+  }
+  if (this->MixedInputChannel->GetTimestampMasterTool(aSource) == PLUS_SUCCESS)
+  {
+    return aSource;
+  }
+  if (this->MixedInputChannel->GetFieldDataSourcesStartConstIterator() != this->MixedInputChannel->GetFieldDataSourcesEndConstIterator())
+  {
+    return this->MixedInputChannel->GetFieldDataSourcesStartConstIterator()->second;
+  }
+  return NULL;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusVirtualMixer::IsInputDataAvailable(double timestamp, vtkPlusDataSource* synchronizationSource)
+{
+  std::vector<vtkPlusDataSource*> sources;
+  for (DataSourceContainerConstIterator it = this->MixedInputChannel->GetToolsStartConstIterator(); it != this->MixedInputChannel->GetToolsEndConstIterator(); ++it)
+  {
+    sources.push_back(it->second);
+  }
+  for (DataSourceContainerConstIterator it = this->MixedInputChannel->GetFieldDataSourcesStartConstIterator(); it != this->MixedInputChannel->GetFieldDataSourcesEndConstIterator(); ++it)
+  {
+    sources.push_back(it->second);
+  }
+
+  for (std::vector<vtkPlusDataSource*>::iterator it = sources.begin(); it != sources.end(); ++it)
+  {
+    if (*it == synchronizationSource)
+    {
+      continue;
+    }
+    double latestTimestamp(0);
+    if ((*it)->GetLatestTimeStamp(latestTimestamp) != ITEM_OK || latestTimestamp < timestamp)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualMixer::InternalUpdate()
+{
+  if (!this->SynchronizedOutput)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  vtkPlusDataSource* synchronizationSource = this->GetSynchronizationSource();
+  if (synchronizationSource == NULL || synchronizationSource->GetNumberOfItems() < 1)
+  {
+    // No input data yet
+    return PLUS_SUCCESS;
+  }
+
+  BufferItemUidType latestUid = synchronizationSource->GetLatestItemUidInBuffer();
+  BufferItemUidType uid = synchronizationSource->GetOldestItemUidInBuffer();
+  if (this->LastSynchronizedUid == 0)
+  {
+    // Start with the most recent frame
+    uid = latestUid;
+  }
+  else if (this->LastSynchronizedUid + 1 > uid)
+  {
+    uid = this->LastSynchronizedUid + 1;
+  }
+  else if (this->LastSynchronizedUid + 1 < uid)
+  {
+    LOG_WARNING("Virtual mixer " << this->GetDeviceId() << " could not keep up with the input, " << uid - this->LastSynchronizedUid - 1 << " frames are not available anymore");
+  }
+
+  PlusStatus status = PLUS_SUCCESS;
+  for (; uid <= latestUid; ++uid)
+  {
+    double timestamp(0);
+    if (synchronizationSource->GetTimeStamp(uid, timestamp) != ITEM_OK)
+    {
+      // The item has just been overwritten in the buffer
+      this->LastSynchronizedUid = uid;
+      continue;
+    }
+
+    // Hold the frame back until the other inputs catch up with it, but not longer than the latency limit
+    double latencySec = vtkIGSIOAccurateTimer::GetSystemTime() - timestamp;
+    bool inputDataAvailable = this->IsInputDataAvailable(timestamp, synchronizationSource);
+    if (!inputDataAvailable && latencySec < this->MaximumSynchronizationLatencySec)
+    {
+      break;
+    }
+    if (!inputDataAvailable)
+    {
+      this->NumberOfLateFrames++;
+      LOG_DEBUG("Virtual mixer " << this->GetDeviceId() << " reached the latency limit, frame at " << std::fixed << timestamp << " is added before all inputs have data at that time");
+    }
+
+    if (this->AddSynchronizedFrame(synchronizationSource, uid, timestamp, latencySec) != PLUS_SUCCESS)
+    {
+      status = PLUS_FAIL;
+    }
+    this->LastSynchronizedUid = uid;
+    this->LastSynchronizationLatencySec = latencySec;
+    LOG_TRACE("Virtual mixer " << this->GetDeviceId() << " added synchronized frame at " << std::fixed << timestamp << ", latency: " << latencySec << " sec");
+  }
+
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualMixer::AddSynchronizedFrame(vtkPlusDataSource* synchronizationSource, BufferItemUidType uid, double timestamp, double latencySec)
+{
+  vtkPlusChannel* outputChannel = this->OutputChannels[0];
+  int numberOfErrors(0);
+
+  // Generate unique frame number (not used for filtering, the synchronized timestamp is used as is)
+  this->FrameNumber++;
+
+  igsioFieldMapType latencyField;
+  std::ostringstream latencyStr;
+  latencyStr << std::fixed << latencySec;
+  latencyField[SYNCHRONIZATION_LATENCY_FIELD_NAME].second = latencyStr.str();
+
+  if (synchronizationSource->GetType() == DATA_SOURCE_TYPE_VIDEO)
+  {
+    vtkPlusDataSource* outputVideo = NULL;
+    StreamBufferItem videoItem;
+    if (outputChannel->GetVideoSource(outputVideo) != PLUS_SUCCESS || synchronizationSource->GetStreamBufferItem(uid, &videoItem, true /* share image data */) != ITEM_OK)
+    {
+      LOG_ERROR("Virtual mixer " << this->GetDeviceId() << " failed to get video frame at " << std::fixed << timestamp);
+      return PLUS_FAIL;
+    }
+
+    igsioFieldMapType customFields;
+    videoItem.GetFrameFields().GetFieldMap(customFields);
+    customFields.insert(latencyField.begin(), latencyField.end());
+
+    igsioVideoFrame& frame = videoItem.GetFrame();
+    if (frame.IsImageValid())
+    {
+      // If the buffer is empty, set the pixel type and frame size to the first received properties
+      if (outputVideo->GetNumberOfItems() == 0)
+      {
+        unsigned int numberOfScalarComponents(1);
+        if (frame.GetNumberOfScalarComponents(numberOfScalarComponents) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Unable to retrieve number of scalar components.");
+          return PLUS_FAIL;
+        }
+        outputVideo->SetPixelType(frame.GetVTKScalarPixelType());
+        outputVideo->SetNumberOfScalarComponents(numberOfScalarComponents);
+        outputVideo->SetImageType(frame.GetImageType());
+        outputVideo->SetInputFrameSize(frame.GetFrameSize());
+      }
+      if (outputVideo->AddItem(&frame, this->FrameNumber, timestamp, timestamp, &customFields) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Virtual mixer " << this->GetDeviceId() << " failed to add video frame at " << std::fixed << timestamp);
+        numberOfErrors++;
+      }
+    }
+    else if (outputVideo->AddItem(customFields, this->FrameNumber, timestamp, timestamp) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Virtual mixer " << this->GetDeviceId() << " failed to add video item at " << std::fixed << timestamp);
+      numberOfErrors++;
+    }
+  }
+
+  // Interpolate all tools at the frame time in one pass
+  std::vector<vtkPlusChannel::ToolTransform> toolTransforms;
+  this->MixedInputChannel->GetInterpolatedToolTransforms(timestamp, toolTransforms);
+  if (!toolTransforms.empty())
+  {
+    std::vector< vtkSmartPointer<vtkMatrix4x4> > matrices(toolTransforms.size());
+    ToolTimeStampedItemList items;
+    items.reserve(toolTransforms.size());
+    for (size_t toolIndex = 0; toolIndex < toolTransforms.size(); ++toolIndex)
+    {
+      const vtkPlusChannel::ToolTransform& toolTransform = toolTransforms[toolIndex];
+      matrices[toolIndex] = vtkSmartPointer<vtkMatrix4x4>::New();
+      ToolStatus toolStatus = TOOL_MISSING;
+      if (toolTransform.Result == ITEM_OK)
+      {
+        matrices[toolIndex]->DeepCopy(toolTransform.Sample.Matrix);
+        toolStatus = toolTransform.Sample.Status;
+      }
+      items.push_back(ToolTimeStampedItem(toolTransform.Tool->GetId(), matrices[toolIndex], toolStatus, this->FrameNumber, &latencyField));
+    }
+    if (this->AddTimeStampedItems(items, timestamp, timestamp) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Virtual mixer " << this->GetDeviceId() << " failed to add tool transforms at " << std::fixed << timestamp);
+      numberOfErrors++;
+    }
+  }
+
+  for (DataSourceContainerConstIterator it = this->MixedInputChannel->GetFieldDataSourcesStartConstIterator(); it != this->MixedInputChannel->GetFieldDataSourcesEndConstIterator(); ++it)
+  {
+    vtkPlusDataSource* inputFieldSource = it->second;
+    vtkPlusDataSource* outputFieldSource = NULL;
+    StreamBufferItem fieldItem;
+    if (outputChannel->GetFieldDataSource(outputFieldSource, inputFieldSource->GetId()) != PLUS_SUCCESS
+        || inputFieldSource->GetStreamBufferItemFromTime(timestamp, &fieldItem, vtkPlusBuffer::CLOSEST_TIME) != ITEM_OK)
+    {
+      // Field data is optional, it may not be available yet
+      continue;
+    }
+    igsioFieldMapType customFields;
+    fieldItem.GetFrameFields().GetFieldMap(customFields);
+    customFields.insert(latencyField.begin(), latencyField.end());
+    if (outputFieldSource->AddItem(customFields, this->FrameNumber, timestamp, timestamp) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Virtual mixer " << this->GetDeviceId() << " failed to add field data of " << inputFieldSource->GetId() << " at " << std::fixed << timestamp);
+      numberOfErrors++;
+    }
+  }
+
+  return numberOfErrors == 0 ? PLUS_SUCCESS : PLUS_FAIL;
+}
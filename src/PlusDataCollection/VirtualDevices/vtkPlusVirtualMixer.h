@@ -15,7 +15,11 @@ class vtkPlusChannel;
 
 /*!
 \class vtkPlusVirtualMixer 
-\brief 
+\brief Merges the video, tracking and field data of multiple input channels into one output channel
+
+By default the output channel refers to the buffers of the input channels and the data is resampled at the
+time when a frame is requested. If SynchronizedOutput is enabled then the mixer holds back each frame until all inputs
+have data at the frame time (or the latency limit is reached) and adds the synchronized frame to its own buffers once.
 
 \ingroup PlusLibDataCollection
 */
@@ -39,6 +43,9 @@ public:
   /*! Read main configuration from xml data */
   virtual PlusStatus ReadConfiguration(vtkXMLDataElement*);
 
+  /*! Write main configuration to xml data */
+  virtual PlusStatus WriteConfiguration(vtkXMLDataElement*);
+
   // Virtual stream mixers output only one stream
   vtkPlusChannel* GetChannel() const;
 
@@ -49,10 +56,62 @@ public:
 
   virtual double GetAcquisitionRate() const;
 
+  /*!
+    If enabled then the mixer creates its own output data sources and each frame of the input timestamp source
+    (video source, or the first tool if there is no video) is added to them only when all the other inputs have data
+    newer than the frame, or MaximumSynchronizationLatencySec elapsed since the frame was acquired. All transforms
+    are interpolated at the frame timestamp, so consumers of the output channel do not need to resynchronize the data.
+    If disabled (default) then the output channel refers to the input buffers directly.
+  */
+  vtkSetMacro(SynchronizedOutput, bool);
+  vtkGetMacro(SynchronizedOutput, bool);
+  vtkBooleanMacro(SynchronizedOutput, bool);
+
+  /*! Maximum time a frame is held back waiting for the other inputs in synchronized output mode, in seconds */
+  vtkSetMacro(MaximumSynchronizationLatencySec, double);
+  vtkGetMacro(MaximumSynchronizationLatencySec, double);
+
+  /*! Time between the acquisition and the output of the most recent synchronized frame, in seconds */
+  vtkGetMacro(LastSynchronizationLatencySec, double);
+
+  /*! Number of synchronized frames that were output when the latency limit was reached, before all inputs had data at the frame time */
+  vtkGetMacro(NumberOfLateFrames, unsigned long);
+
 protected:
   vtkPlusVirtualMixer();
   virtual ~vtkPlusVirtualMixer();
 
+  /*! Add the synchronized frames to the output in synchronized output mode */
+  virtual PlusStatus InternalUpdate();
+
+  virtual PlusStatus InternalStartRecording();
+
+  /*! Add the sources of the input channels to the channel. If addToDevice is true then they are added to the mixer device as well. */
+  PlusStatus AddInputSources(vtkPlusChannel* aChannel, bool addToDevice);
+
+  /*! Create the data sources of the mixer in synchronized output mode, one for each source of the mixed input channel */
+  PlusStatus CreateSynchronizedOutputSources(vtkPlusChannel* outputChannel);
+
+  /*! Get the source of the mixed input channel that determines the timestamps of the output frames */
+  vtkPlusDataSource* GetSynchronizationSource();
+
+  /*! Returns true if all the sources of the mixed input channel (except the synchronization source) have data at or after the timestamp */
+  bool IsInputDataAvailable(double timestamp, vtkPlusDataSource* synchronizationSource);
+
+  /*! Interpolate all inputs at the timestamp of the synchronization source item and add the result to the output sources */
+  PlusStatus AddSynchronizedFrame(vtkPlusDataSource* synchronizationSource, BufferItemUidType uid, double timestamp, double latencySec);
+
+  bool SynchronizedOutput;
+  double MaximumSynchronizationLatencySec;
+  double LastSynchronizationLatencySec;
+  unsigned long NumberOfLateFrames;
+
+  /*! Refers to the sources of the input channels in synchronized output mode, the output frames are sampled from it */
+  vtkSmartPointer<vtkPlusChannel> MixedInputChannel;
+
+  /*! UID of the last synchronization source item that was added to the output, 0 if none */
+  BufferItemUidType LastSynchronizedUid;
+
 private:
   vtkPlusVirtualMixer(const vtkPlusVirtualMixer&);  // Not implemented.
   void operator=(const vtkPlusVirtualMixer&);  // Not implemented. 
@@ -0,0 +1,623 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataSource.h"
+#include "vtkPlusImageProcessorVideoSource.h"
+#include "vtkPlusTrackedFrameProcessor.h"
+#include "vtkPlusVirtualDecimator.h"
+#include "vtkPlusVirtualPipeline.h"
+
+// IGSIO includes
+#include <igsioTrackedFrame.h>
+#include <vtkIGSIOTransformRepository.h>
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+
+// STL includes
+#include <string>
+#include <utility>
+
+//----------------------------------------------------------------------------
+class vtkPlusVirtualPipeline::Stage
+{
+public:
+  virtual ~Stage() {}
+
+  /*! Value of the Type attribute of the Stage element */
+  virtual const char* GetTypeName() const = 0;
+
+  /*! Read the configuration from the Stage element */
+  virtual PlusStatus ReadConfiguration(vtkXMLDataElement* stageElement) = 0;
+
+  /*! Write the configuration to the Stage element */
+  virtual PlusStatus WriteConfiguration(vtkXMLDataElement* stageElement)
+  {
+    stageElement->SetAttribute("Type", this->GetTypeName());
+    return PLUS_SUCCESS;
+  }
+
+  /*! Forget the state of the previous frames, called when recording starts */
+  virtual void Reset() {}
+
+  /*!
+    Process the frame in place or point frame to a frame that the stage owns.
+    frame is set to NULL if the frame is not passed to the next stages.
+  */
+  virtual PlusStatus Process(vtkPlusVirtualPipeline* pipeline, igsioTrackedFrame*& frame) = 0;
+};
+
+//----------------------------------------------------------------------------
+class vtkPlusVirtualPipeline::ProcessorStage : public vtkPlusVirtualPipeline::Stage
+{
+public:
+  explicit ProcessorStage(vtkIGSIOTransformRepository* transformRepository) : TransformRepository(transformRepository) {}
+
+  virtual const char* GetTypeName() const { return "Processor"; }
+
+  virtual PlusStatus ReadConfiguration(vtkXMLDataElement* stageElement)
+  {
+    vtkXMLDataElement* processorElement = stageElement->FindNestedElementWithName(vtkPlusTrackedFrameProcessor::GetTagName());
+    if (processorElement == NULL)
+    {
+      LOG_ERROR("Processor stage requires a " << vtkPlusTrackedFrameProcessor::GetTagName() << " element");
+      return PLUS_FAIL;
+    }
+    this->Processor = vtkSmartPointer<vtkPlusTrackedFrameProcessor>::Take(vtkPlusImageProcessorVideoSource::CreateProcessor(processorElement, this->TransformRepository));
+    return this->Processor != NULL ? PLUS_SUCCESS : PLUS_FAIL;
+  }
+
+  virtual PlusStatus WriteConfiguration(vtkXMLDataElement* stageElement)
+  {
+    Stage::WriteConfiguration(stageElement);
+    vtkXMLDataElement* processorElement = stageElement->FindNestedElementWithName(vtkPlusTrackedFrameProcessor::GetTagName());
+    if (processorElement == NULL)
+    {
+      LOG_ERROR("Cannot find " << vtkPlusTrackedFrameProcessor::GetTagName() << " element in XML tree!");
+      return PLUS_FAIL;
+    }
+    return this->Processor->WriteConfiguration(processorElement);
+  }
+
+  virtual PlusStatus Process(vtkPlusVirtualPipeline* pipeline, igsioTrackedFrame*& frame)
+  {
+    // The processor replaces the image of the output frame, so only the fields are copied from the input frame
+    igsioFieldMapType fields = frame->GetFrameFields();
+    for (igsioFieldMapType::const_iterator fieldIt = fields.begin(); fieldIt != fields.end(); ++fieldIt)
+    {
+      this->OutputFrame.SetFrameField(fieldIt->first, fieldIt->second.second, fieldIt->second.first);
+    }
+    this->OutputFrame.SetTimestamp(frame->GetTimestamp());
+    if (this->Processor->ProcessTrackedFrame(frame, &this->OutputFrame) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to process frame with " << this->Processor->GetProcessorTypeName() << " in pipeline " << pipeline->GetDeviceId());
+      return PLUS_FAIL;
+    }
+    frame = &this->OutputFrame;
+    return PLUS_SUCCESS;
+  }
+
+protected:
+  vtkIGSIOTransformRepository* TransformRepository;
+  vtkSmartPointer<vtkPlusTrackedFrameProcessor> Processor;
+  igsioTrackedFrame OutputFrame;
+};
+
+//----------------------------------------------------------------------------
+class vtkPlusVirtualPipeline::FieldInjectionStage : public vtkPlusVirtualPipeline::Stage
+{
+public:
+  virtual const char* GetTypeName() const { return "FieldInjection"; }
+
+  virtual PlusStatus ReadConfiguration(vtkXMLDataElement* stageElement)
+  {
+    this->Fields.clear();
+    for (int nestedElementIndex = 0; nestedElementIndex < stageElement->GetNumberOfNestedElements(); ++nestedElementIndex)
+    {
+      vtkXMLDataElement* fieldElement = stageElement->GetNestedElement(nestedElementIndex);
+      if (fieldElement == NULL || STRCASECMP(fieldElement->GetName(), "Field") != 0)
+      {
+        continue;
+      }
+      const char* name = fieldElement->GetAttribute("Name");
+      const char* value = fieldElement->GetAttribute("Value");
+      if (name == NULL || value == NULL)
+      {
+        LOG_ERROR("Field element of FieldInjection stage requires Name and Value attributes");
+        return PLUS_FAIL;
+      }
+      this->Fields.push_back(std::make_pair(std::string(name), std::string(value)));
+    }
+    return PLUS_SUCCESS;
+  }
+
+  virtual PlusStatus Process(vtkPlusVirtualPipeline* pipeline, igsioTrackedFrame*& frame)
+  {
+    for (std::vector< std::pair<std::string, std::string> >::const_iterator fieldIt = this->Fields.begin(); fieldIt != this->Fields.end(); ++fieldIt)
+    {
+      frame->SetFrameField(fieldIt->first, fieldIt->second);
+    }
+    return PLUS_SUCCESS;
+  }
+
+protected:
+  std::vector< std::pair<std::string, std::string> > Fields;
+};
+
+//----------------------------------------------------------------------------
+class vtkPlusVirtualPipeline::MixerStage : public vtkPlusVirtualPipeline::Stage
+{
+public:
+  virtual const char* GetTypeName() const { return "Mixer"; }
+
+  virtual PlusStatus ReadConfiguration(vtkXMLDataElement* stageElement)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  virtual PlusStatus Process(vtkPlusVirtualPipeline* pipeline, igsioTrackedFrame*& frame)
+  {
+    // Fields include the transforms and their status
+    for (ChannelContainerConstIterator channelIt = pipeline->InputChannels.begin() + 1; channelIt != pipeline->InputChannels.end(); ++channelIt)
+    {
+      if ((*channelIt)->GetTrackedFrame(frame->GetTimestamp(), this->MixedFrame, false /* no image */) != PLUS_SUCCESS)
+      {
+        LOG_DEBUG("Input channel " << (*channelIt)->GetChannelId() << " of pipeline " << pipeline->GetDeviceId() << " has no data at " << std::fixed << frame->GetTimestamp());
+        continue;
+      }
+      igsioFieldMapType fields = this->MixedFrame.GetFrameFields();
+      for (igsioFieldMapType::const_iterator fieldIt = fields.begin(); fieldIt != fields.end(); ++fieldIt)
+      {
+        frame->SetFrameField(fieldIt->first, fieldIt->second.second, fieldIt->second.first);
+      }
+    }
+    return PLUS_SUCCESS;
+  }
+
+protected:
+  igsioTrackedFrame MixedFrame;
+};
+
+//----------------------------------------------------------------------------
+class vtkPlusVirtualPipeline::DecimatorStage : public vtkPlusVirtualPipeline::Stage
+{
+public:
+  DecimatorStage() : DecimationFactor(1), OutputFrameRate(0.0), DownscalingFactor(1), InputFrameCount(0), NextOutputTimestamp(0.0) {}
+
+  virtual const char* GetTypeName() const { return "Decimator"; }
+
+  virtual PlusStatus ReadConfiguration(vtkXMLDataElement* stageElement)
+  {
+    XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, DecimationFactor, this->DecimationFactor, stageElement);
+    XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(double, OutputFrameRate, this->OutputFrameRate, stageElement);
+    XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, DownscalingFactor, this->DownscalingFactor, stageElement);
+    if (this->DecimationFactor < 1 || this->DownscalingFactor < 1)
+    {
+      LOG_ERROR("DecimationFactor and DownscalingFactor of Decimator stage must be positive");
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  virtual PlusStatus WriteConfiguration(vtkXMLDataElement* stageElement)
+  {
+    Stage::WriteConfiguration(stageElement);
+    stageElement->SetIntAttribute("DecimationFactor", this->DecimationFactor);
+    stageElement->SetDoubleAttribute("OutputFrameRate", this->OutputFrameRate);
+    stageElement->SetIntAttribute("DownscalingFactor", this->DownscalingFactor);
+    return PLUS_SUCCESS;
+  }
+
+  virtual void Reset()
+  {
+    this->InputFrameCount = 0;
+    this->NextOutputTimestamp = 0.0;
+  }
+
+  virtual PlusStatus Process(vtkPlusVirtualPipeline* pipeline, igsioTrackedFrame*& frame)
+  {
+    if (!this->IsFrameSelected(frame->GetTimestamp()))
+    {
+      frame = NULL;
+      return PLUS_SUCCESS;
+    }
+    igsioVideoFrame* image = frame->GetImageData();
+    if (this->DownscalingFactor < 2 || image == NULL || !image->IsImageValid() || image->IsFrameEncoded())
+    {
+      return PLUS_SUCCESS;
+    }
+
+    unsigned int numberOfScalarComponents(1);
+    if (image->GetNumberOfScalarComponents(numberOfScalarComponents) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Unable to retrieve number of scalar components.");
+      return PLUS_FAIL;
+    }
+    const unsigned int factor = static_cast<unsigned int>(this->DownscalingFactor);
+    const FrameSizeType frameSize = image->GetFrameSize();
+    const FrameSizeType downscaledSize = vtkPlusVirtualDecimator::GetDownscaledSize(frameSize, factor);
+    igsioVideoFrame* outputImage = this->OutputFrame.GetImageData();
+    if (outputImage->GetImage() == NULL || outputImage->GetFrameSize() != downscaledSize || outputImage->GetVTKScalarPixelType() != image->GetVTKScalarPixelType()
+        || outputImage->GetImage()->GetNumberOfScalarComponents() != static_cast<int>(numberOfScalarComponents))
+    {
+      if (outputImage->AllocateFrame(downscaledSize, image->GetVTKScalarPixelType(), numberOfScalarComponents) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to allocate downscaled image in pipeline " << pipeline->GetDeviceId());
+        return PLUS_FAIL;
+      }
+    }
+    if (vtkPlusVirtualDecimator::DownscalePixels(image->GetImage()->GetPointData()->GetScalars(), frameSize, factor,
+        outputImage->GetImage()->GetPointData()->GetScalars()) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Pipeline " << pipeline->GetDeviceId() << " cannot downscale images of pixel type " << image->GetVTKScalarPixelType());
+      return PLUS_FAIL;
+    }
+    outputImage->SetImageType(image->GetImageType());
+    outputImage->SetImageOrientation(image->GetImageOrientation());
+
+    igsioFieldMapType fields = frame->GetFrameFields();
+    for (igsioFieldMapType::const_iterator fieldIt = fields.begin(); fieldIt != fields.end(); ++fieldIt)
+    {
+      this->OutputFrame.SetFrameField(fieldIt->first, fieldIt->second.second, fieldIt->second.first);
+    }
+    this->OutputFrame.SetTimestamp(frame->GetTimestamp());
+    frame = &this->OutputFrame;
+    return PLUS_SUCCESS;
+  }
+
+protected:
+  /*! Same selection as in vtkPlusVirtualDecimator */
+  bool IsFrameSelected(double timestamp)
+  {
+    if (this->OutputFrameRate > 0)
+    {
+      if (timestamp < this->NextOutputTimestamp)
+      {
+        return false;
+      }
+      const double samplingPeriodSec = 1.0 / this->OutputFrameRate;
+      this->NextOutputTimestamp += samplingPeriodSec;
+      if (this->NextOutputTimestamp <= timestamp)
+      {
+        // First frame or the input was paused, do not try to catch up with the missed sampling times
+        this->NextOutputTimestamp = timestamp + samplingPeriodSec;
+      }
+      return true;
+    }
+    bool selected = (this->InputFrameCount % this->DecimationFactor == 0);
+    this->InputFrameCount++;
+    return selected;
+  }
+
+  int DecimationFactor;
+  double OutputFrameRate;
+  int DownscalingFactor;
+  unsigned long InputFrameCount;
+  double NextOutputTimestamp;
+  igsioTrackedFrame OutputFrame;
+};
+
+//----------------------------------------------------------------------------
+
+vtkStandardNewMacro(vtkPlusVirtualPipeline);
+
+//----------------------------------------------------------------------------
+vtkPlusVirtualPipeline::vtkPlusVirtualPipeline()
+  : vtkPlusDevice()
+  , ProcessLatestFrameOnly(true)
+  , TransformRepository(vtkSmartPointer<vtkIGSIOTransformRepository>::New())
+  , LastProcessedUid(0)
+{
+  this->AcquisitionRate = vtkPlusDevice::VIRTUAL_DEVICE_FRAME_RATE;
+
+  // The data capture thread will be used to regularly run the stages on the new frames
+  this->StartThreadForInternalUpdates = true;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusVirtualPipeline::~vtkPlusVirtualPipeline()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusVirtualPipeline::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "ProcessLatestFrameOnly: " << (this->ProcessLatestFrameOnly ? "TRUE" : "FALSE") << std::endl;
+  os << indent << "Stages:";
+  for (std::vector< std::unique_ptr<Stage> >::const_iterator stageIt = this->Stages.begin(); stageIt != this->Stages.end(); ++stageIt)
+  {
+    os << " " << (*stageIt)->GetTypeName();
+  }
+  os << std::endl;
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusVirtualPipeline::GetNumberOfStages() const
+{
+  return static_cast<int>(this->Stages.size());
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualPipeline::ReadConfiguration(vtkXMLDataElement* rootConfigElement)
+{
+  XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_READING(deviceConfig, rootConfigElement);
+
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(ProcessLatestFrameOnly, deviceConfig);
+
+  // Processors may use the persistent transforms
+  if (this->TransformRepository->ReadConfiguration(rootConfigElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to read transform repository configuration");
+    return PLUS_FAIL;
+  }
+
+  XML_FIND_NESTED_ELEMENT_REQUIRED(stagesElement, deviceConfig, "Stages");
+  this->Stages.clear();
+  for (int nestedElementIndex = 0; nestedElementIndex < stagesElement->GetNumberOfNestedElements(); ++nestedElementIndex)
+  {
+    vtkXMLDataElement* stageElement = stagesElement->GetNestedElement(nestedElementIndex);
+    if (stageElement == NULL || STRCASECMP(stageElement->GetName(), "Stage") != 0)
+    {
+      // not a stage element, ignore it
+      continue;
+    }
+    const char* stageType = stageElement->GetAttribute("Type");
+    if (stageType == NULL)
+    {
+      LOG_ERROR("Type attribute of Stage element is missing in pipeline " << this->GetDeviceId());
+      return PLUS_FAIL;
+    }
+
+    std::unique_ptr<Stage> stage;
+    if (STRCASECMP(stageType, "Processor") == 0)
+    {
+      stage.reset(new ProcessorStage(this->TransformRepository));
+    }
+    else if (STRCASECMP(stageType, "FieldInjection") == 0)
+    {
+      stage.reset(new FieldInjectionStage);
+    }
+    else if (STRCASECMP(stageType, "Mixer") == 0)
+    {
+      stage.reset(new MixerStage);
+    }
+    else if (STRCASECMP(stageType, "Decimator") == 0)
+    {
+      stage.reset(new DecimatorStage);
+    }
+    else
+    {
+      LOG_ERROR("Unknown stage type: " << stageType << " in pipeline " << this->GetDeviceId());
+      return PLUS_FAIL;
+    }
+    if (stage->ReadConfiguration(stageElement) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to read the configuration of the " << stageType << " stage of pipeline " << this->GetDeviceId());
+      return PLUS_FAIL;
+    }
+    this->Stages.push_back(std::move(stage));
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualPipeline::WriteConfiguration(vtkXMLDataElement* rootConfigElement)
+{
+  XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_WRITING(deviceConfig, rootConfigElement);
+
+  XML_WRITE_BOOL_ATTRIBUTE(ProcessLatestFrameOnly, deviceConfig);
+
+  // The stages are written to the Stage elements that they were read from, in the same order
+  XML_FIND_NESTED_ELEMENT_REQUIRED(stagesElement, deviceConfig, "Stages");
+  std::vector< std::unique_ptr<Stage> >::iterator stageIt = this->Stages.begin();
+  for (int nestedElementIndex = 0; nestedElementIndex < stagesElement->GetNumberOfNestedElements() && stageIt != this->Stages.end(); ++nestedElementIndex)
+  {
+    vtkXMLDataElement* stageElement = stagesElement->GetNestedElement(nestedElementIndex);
+    if (stageElement == NULL || STRCASECMP(stageElement->GetName(), "Stage") != 0)
+    {
+      continue;
+    }
+    if ((*stageIt)->WriteConfiguration(stageElement) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    ++stageIt;
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualPipeline::NotifyConfigured()
+{
+  if (this->InputChannels.empty())
+  {
+    LOG_ERROR("No input channel set for vtkPlusVirtualPipeline " << this->GetDeviceId());
+    this->SetCorrectlyConfigured(false);
+    return PLUS_FAIL;
+  }
+  if (this->OutputChannels.empty())
+  {
+    LOG_ERROR("No output channel set for vtkPlusVirtualPipeline " << this->GetDeviceId());
+    this->SetCorrectlyConfigured(false);
+    return PLUS_FAIL;
+  }
+  if (this->OutputChannels.size() > 1)
+  {
+    LOG_WARNING("vtkPlusVirtualPipeline is expecting one output channel and there are " << this->OutputChannels.size() << " channels. First output channel will be used.");
+  }
+
+  vtkPlusDataSource* aSource(NULL);
+  if (!this->InputChannels[0]->HasVideoSource() || this->InputChannels[0]->GetVideoSource(aSource) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("First input channel " << this->InputChannels[0]->GetChannelId() << " of vtkPlusVirtualPipeline " << this->GetDeviceId() << " has no video source");
+    this->SetCorrectlyConfigured(false);
+    return PLUS_FAIL;
+  }
+  if (this->OutputChannels[0]->GetVideoSource(aSource) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Output channel " << this->OutputChannels[0]->GetChannelId() << " of vtkPlusVirtualPipeline " << this->GetDeviceId() << " has no video source");
+    this->SetCorrectlyConfigured(false);
+    return PLUS_FAIL;
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusVirtualPipeline::GetAcquisitionRate() const
+{
+  if (this->InputChannels.empty() || this->InputChannels[0]->GetOwnerDevice() == NULL)
+  {
+    return this->AcquisitionRate;
+  }
+  return this->InputChannels[0]->GetOwnerDevice()->GetAcquisitionRate();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualPipeline::InternalStartRecording()
+{
+  this->LastProcessedUid = 0;
+  for (std::vector< std::unique_ptr<Stage> >::iterator stageIt = this->Stages.begin(); stageIt != this->Stages.end(); ++stageIt)
+  {
+    (*stageIt)->Reset();
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualPipeline::InternalUpdate()
+{
+  vtkPlusDataSource* inputVideo = NULL;
+  if (this->InputChannels.empty() || this->InputChannels[0]->GetVideoSource(inputVideo) != PLUS_SUCCESS || inputVideo->GetNumberOfItems() < 1)
+  {
+    // No input data yet
+    return PLUS_SUCCESS;
+  }
+
+  BufferItemUidType latestUid = inputVideo->GetLatestItemUidInBuffer();
+  BufferItemUidType uid = inputVideo->GetOldestItemUidInBuffer();
+  if (this->LastProcessedUid == 0)
+  {
+    // Start with the most recent frame
+    uid = latestUid;
+  }
+  else if (this->LastProcessedUid + 1 > uid)
+  {
+    uid = this->LastProcessedUid + 1;
+  }
+  if (uid > latestUid)
+  {
+    // No new frame
+    return PLUS_SUCCESS;
+  }
+  if (this->ProcessLatestFrameOnly && uid < latestUid)
+  {
+    this->OutputChannels[0]->AddSkippedFrameStatistics(static_cast<unsigned long>(latestUid - uid));
+    uid = latestUid;
+  }
+
+  PlusStatus status = PLUS_SUCCESS;
+  for (; uid <= latestUid; ++uid)
+  {
+    double timestamp(0);
+    this->LastProcessedUid = uid;
+    if (inputVideo->GetTimeStamp(uid, timestamp) != ITEM_OK)
+    {
+      // The item has just been overwritten in the input buffer
+      continue;
+    }
+    if (this->ProcessFrame(timestamp) != PLUS_SUCCESS)
+    {
+      status = PLUS_FAIL;
+    }
+  }
+
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualPipeline::ProcessFrame(double timestamp)
+{
+  double processingStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+
+  // The image of the input frame refers to the pixels of the input buffer
+  if (this->InputChannels[0]->GetTrackedFrame(timestamp, this->InputFrame) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to get tracked frame at " << std::fixed << timestamp << " for pipeline " << this->GetDeviceId());
+    return PLUS_FAIL;
+  }
+
+  igsioTrackedFrame* frame = &this->InputFrame;
+  for (std::vector< std::unique_ptr<Stage> >::iterator stageIt = this->Stages.begin(); stageIt != this->Stages.end(); ++stageIt)
+  {
+    if ((*stageIt)->Process(this, frame) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    if (frame == NULL)
+    {
+      // The frame is dropped (decimation)
+      return PLUS_SUCCESS;
+    }
+  }
+
+  return this->AddOutputFrame(frame, vtkIGSIOAccurateTimer::GetSystemTime() - processingStartTime);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualPipeline::AddOutputFrame(igsioTrackedFrame* frame, double processingTimeSec)
+{
+  vtkPlusChannel* outputChannel = this->OutputChannels[0];
+  vtkPlusDataSource* outputVideo(NULL);
+  if (outputChannel->GetVideoSource(outputVideo) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to retrieve the video source in pipeline " << this->GetDeviceId());
+    return PLUS_FAIL;
+  }
+
+  // Generate unique frame number (not used for filtering, so the actual increment value does not matter)
+  this->FrameNumber++;
+
+  igsioVideoFrame* videoFrame = frame->GetImageData();
+  unsigned int numberOfScalarComponents(1);
+  if (videoFrame->GetNumberOfScalarComponents(numberOfScalarComponents) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to retrieve number of scalar components.");
+    return PLUS_FAIL;
+  }
+
+  // The output buffer takes the format of the processed frames
+  if (outputVideo->GetNumberOfItems() == 0 || outputVideo->GetInputFrameSize() != frame->GetFrameSize() || outputVideo->GetPixelType() != videoFrame->GetVTKScalarPixelType()
+      || outputVideo->GetNumberOfScalarComponents() != numberOfScalarComponents || outputVideo->GetImageType() != videoFrame->GetImageType())
+  {
+    outputVideo->SetPixelType(videoFrame->GetVTKScalarPixelType());
+    outputVideo->SetNumberOfScalarComponents(numberOfScalarComponents);
+    outputVideo->SetImageType(videoFrame->GetImageType());
+    outputVideo->SetInputFrameSize(frame->GetFrameSize());
+  }
+
+  double timestamp = frame->GetTimestamp();
+  igsioFieldMapType customFields = frame->GetCustomFields();
+  if (outputVideo->AddItem(videoFrame, this->FrameNumber, timestamp, timestamp, &customFields) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Pipeline " << this->GetDeviceId() << " failed to add processed frame at " << std::fixed << timestamp);
+    return PLUS_FAIL;
+  }
+  outputChannel->AddProcessedFrameStatistics(processingTimeSec);
+
+  this->Modified();
+  return PLUS_SUCCESS;
+}
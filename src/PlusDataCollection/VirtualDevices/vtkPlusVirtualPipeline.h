@@ -0,0 +1,108 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusVirtualPipeline_h
+#define __vtkPlusVirtualPipeline_h
+
+#include "vtkPlusDataCollectionExport.h"
+
+#include "vtkPlusDevice.h"
+
+#include <memory>
+#include <vector>
+
+class vtkIGSIOTransformRepository;
+
+/*!
+\class vtkPlusVirtualPipeline
+\brief Runs an ordered list of processing stages on each frame of the input channel in one thread
+
+The stages replace chains of virtual devices (e.g., ImageProcessor, VirtualMixer, VirtualDecimator), which have a buffer,
+a thread and a copy of the frame for each hop. The frame of the first input channel is passed from stage to stage by pointer,
+stages modify it in place or replace it by a frame that they own (processors and downscaling write new images), and only
+the result of the last stage is added to the output buffer.
+
+Stages:
+- Processor: processes the image with a vtkPlusTrackedFrameProcessor (same Processor element as in ImageProcessor)
+- FieldInjection: sets constant frame fields
+- Mixer: adds the transforms and fields of the other input channels at the frame time
+- Decimator: passes only every DecimationFactor-th frame (or frames at OutputFrameRate) and optionally downscales the image
+
+If ProcessLatestFrameOnly is enabled (default) then only the most recent input frame is processed in each update,
+the other new frames are recorded as skipped in the frame processing statistics of the output channel.
+
+\ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport vtkPlusVirtualPipeline : public vtkPlusDevice
+{
+public:
+  static vtkPlusVirtualPipeline* New();
+  vtkTypeMacro(vtkPlusVirtualPipeline, vtkPlusDevice);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  virtual bool IsTracker() const { return false; }
+  virtual bool IsVirtual() const { return true; }
+
+  /*! Read configuration from xml data */
+  virtual PlusStatus ReadConfiguration(vtkXMLDataElement*);
+
+  /*! Write configuration to xml data */
+  virtual PlusStatus WriteConfiguration(vtkXMLDataElement*);
+
+  /*! Check the input and output channels */
+  virtual PlusStatus NotifyConfigured();
+
+  /*! Frame rate of the output channel, which is the frame rate of the first input channel */
+  virtual double GetAcquisitionRate() const;
+
+  /*! If enabled then only the most recent input frame is processed in each update */
+  vtkSetMacro(ProcessLatestFrameOnly, bool);
+  vtkGetMacro(ProcessLatestFrameOnly, bool);
+  vtkBooleanMacro(ProcessLatestFrameOnly, bool);
+
+  /*! Get the number of stages */
+  int GetNumberOfStages() const;
+
+protected:
+  vtkPlusVirtualPipeline();
+  virtual ~vtkPlusVirtualPipeline();
+
+  virtual PlusStatus InternalUpdate();
+
+  virtual PlusStatus InternalStartRecording();
+
+  /*! Run the stages on the input frame acquired at the timestamp and add the result to the output channel */
+  PlusStatus ProcessFrame(double timestamp);
+
+  /*! Add the processed frame to the video source of the output channel. This is the only copy of the image in the pipeline. */
+  PlusStatus AddOutputFrame(igsioTrackedFrame* frame, double processingTimeSec);
+
+  /*! Processing stage, the implementations are in the cxx file */
+  class Stage;
+  class ProcessorStage;
+  class FieldInjectionStage;
+  class MixerStage;
+  class DecimatorStage;
+
+  std::vector< std::unique_ptr<Stage> > Stages;
+
+  bool ProcessLatestFrameOnly;
+
+  /*! Frame of the first input channel, the image pixels are shared with the input buffer */
+  igsioTrackedFrame InputFrame;
+
+  /*! Persistent transforms (e.g., calibration matrices) that processors may use */
+  vtkSmartPointer<vtkIGSIOTransformRepository> TransformRepository;
+
+  /*! UID of the last processed item of the input video source, 0 if none */
+  BufferItemUidType LastProcessedUid;
+
+private:
+  vtkPlusVirtualPipeline(const vtkPlusVirtualPipeline&);  // Not implemented.
+  void operator=(const vtkPlusVirtualPipeline&);  // Not implemented.
+};
+
+#endif
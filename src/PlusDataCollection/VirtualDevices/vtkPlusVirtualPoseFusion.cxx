@@ -0,0 +1,402 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "igsioMath.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataSource.h"
+#include "vtkPlusVirtualPoseFusion.h"
+
+// VTK includes
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+
+// STL includes
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  void GetRotationQuaternion(vtkMatrix4x4* matrix, double quaternion[4])
+  {
+    double rotation[3][3];
+    for (int row = 0; row < 3; ++row)
+    {
+      for (int column = 0; column < 3; ++column)
+      {
+        rotation[row][column] = matrix->GetElement(row, column);
+      }
+    }
+    vtkMath::Matrix3x3ToQuaternion(rotation, quaternion);
+  }
+
+  //----------------------------------------------------------------------------
+  void ConjugateQuaternion(const double quaternion[4], double conjugate[4])
+  {
+    conjugate[0] = quaternion[0];
+    conjugate[1] = -quaternion[1];
+    conjugate[2] = -quaternion[2];
+    conjugate[3] = -quaternion[3];
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Angle of the rotation between two orientations, in degrees */
+  double GetQuaternionDifferenceDeg(const double a[4], const double b[4])
+  {
+    double dot = std::fabs(a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3]);
+    return vtkMath::DegreesFromRadians(2.0 * std::acos(std::min(dot, 1.0)));
+  }
+}
+
+//----------------------------------------------------------------------------
+
+vtkStandardNewMacro(vtkPlusVirtualPoseFusion);
+
+//----------------------------------------------------------------------------
+vtkPlusVirtualPoseFusion::vtkPlusVirtualPoseFusion()
+  : vtkPlusDevice()
+  , OrientationCorrectionGain(0.05)
+  , MaximumOpticalDropoutSec(2.0)
+  , MaximumOrientationDifferenceDeg(0.0)
+  , InertialSensorToTool(vtkSmartPointer<vtkMatrix4x4>::New())
+  , OpticalTool(NULL)
+  , InertialTool(NULL)
+  , InertialChannel(NULL)
+  , OutputTool(NULL)
+  , InertialToOpticalReferenceRotationValid(false)
+  , LastOpticalTimestamp(0.0)
+  , LastOpticalUid(0)
+  , LastInertialUid(0)
+{
+  this->InertialToOpticalReferenceRotation[0] = 1.0;
+  this->InertialToOpticalReferenceRotation[1] = this->InertialToOpticalReferenceRotation[2] = this->InertialToOpticalReferenceRotation[3] = 0.0;
+  this->LastOpticalPosition[0] = this->LastOpticalPosition[1] = this->LastOpticalPosition[2] = 0.0;
+
+  this->AcquisitionRate = vtkPlusDevice::VIRTUAL_DEVICE_FRAME_RATE;
+
+  // The data capture thread will be used to regularly read the new input poses and add the fused poses
+  this->StartThreadForInternalUpdates = true;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusVirtualPoseFusion::~vtkPlusVirtualPoseFusion()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusVirtualPoseFusion::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "OpticalTransformName: " << this->OpticalTransformName << std::endl;
+  os << indent << "InertialTransformName: " << this->InertialTransformName << std::endl;
+  os << indent << "OrientationCorrectionGain: " << this->OrientationCorrectionGain << std::endl;
+  os << indent << "MaximumOpticalDropoutSec: " << this->MaximumOpticalDropoutSec << std::endl;
+  os << indent << "MaximumOrientationDifferenceDeg: " << this->MaximumOrientationDifferenceDeg << std::endl;
+  os << indent << "InertialSensorToTool: " << std::endl;
+  this->InertialSensorToTool->PrintSelf(os, indent.GetNextIndent());
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualPoseFusion::ReadConfiguration(vtkXMLDataElement* rootConfigElement)
+{
+  XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_READING(deviceConfig, rootConfigElement);
+
+  XML_READ_STRING_ATTRIBUTE_REQUIRED(OpticalTransformName, deviceConfig);
+  XML_READ_STRING_ATTRIBUTE_REQUIRED(InertialTransformName, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, OrientationCorrectionGain, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, MaximumOpticalDropoutSec, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, MaximumOrientationDifferenceDeg, deviceConfig);
+
+  double inertialSensorToTool[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+  XML_READ_VECTOR_ATTRIBUTE_NONMEMBER_OPTIONAL(double, 16, InertialSensorToTool, inertialSensorToTool, deviceConfig);
+  this->InertialSensorToTool->DeepCopy(inertialSensorToTool);
+
+  if (this->OrientationCorrectionGain <= 0.0 || this->OrientationCorrectionGain > 1.0)
+  {
+    LOG_ERROR("OrientationCorrectionGain of vtkPlusVirtualPoseFusion " << this->GetDeviceId() << " must be in (0, 1]");
+    return PLUS_FAIL;
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualPoseFusion::WriteConfiguration(vtkXMLDataElement* rootConfigElement)
+{
+  XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_WRITING(deviceConfig, rootConfigElement);
+
+  deviceConfig->SetAttribute("OpticalTransformName", this->OpticalTransformName.c_str());
+  deviceConfig->SetAttribute("InertialTransformName", this->InertialTransformName.c_str());
+  deviceConfig->SetDoubleAttribute("OrientationCorrectionGain", this->OrientationCorrectionGain);
+  deviceConfig->SetDoubleAttribute("MaximumOpticalDropoutSec", this->MaximumOpticalDropoutSec);
+  deviceConfig->SetDoubleAttribute("MaximumOrientationDifferenceDeg", this->MaximumOrientationDifferenceDeg);
+  double inertialSensorToTool[16] = { 0 };
+  vtkMatrix4x4::DeepCopy(inertialSensorToTool, this->InertialSensorToTool);
+  deviceConfig->SetVectorAttribute("InertialSensorToTool", 16, inertialSensorToTool);
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusDataSource* vtkPlusVirtualPoseFusion::FindInputTool(const std::string& transformName, vtkPlusChannel*& inputChannel)
+{
+  for (ChannelContainerConstIterator channelIt = this->InputChannels.begin(); channelIt != this->InputChannels.end(); ++channelIt)
+  {
+    for (DataSourceContainerConstIterator toolIt = (*channelIt)->GetToolsStartConstIterator(); toolIt != (*channelIt)->GetToolsEndConstIterator(); ++toolIt)
+    {
+      if (toolIt->second->GetTransformName() == transformName)
+      {
+        inputChannel = *channelIt;
+        return toolIt->second;
+      }
+    }
+  }
+  return NULL;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualPoseFusion::NotifyConfigured()
+{
+  if (this->InputChannels.empty())
+  {
+    LOG_ERROR("No input channel set for vtkPlusVirtualPoseFusion " << this->GetDeviceId());
+    this->SetCorrectlyConfigured(false);
+    return PLUS_FAIL;
+  }
+
+  vtkPlusChannel* opticalChannel = NULL;
+  this->OpticalTool = this->FindInputTool(this->OpticalTransformName, opticalChannel);
+  this->InertialTool = this->FindInputTool(this->InertialTransformName, this->InertialChannel);
+  if (this->OpticalTool == NULL || this->InertialTool == NULL)
+  {
+    LOG_ERROR("Input channels of vtkPlusVirtualPoseFusion " << this->GetDeviceId() << " do not contain the " << (this->OpticalTool == NULL ? this->OpticalTransformName : this->InertialTransformName) << " tool");
+    this->SetCorrectlyConfigured(false);
+    return PLUS_FAIL;
+  }
+
+  if (this->GetNumberOfTools() != 1 || this->GetFirstActiveTool(this->OutputTool) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("vtkPlusVirtualPoseFusion " << this->GetDeviceId() << " requires exactly one tool data source for the fused poses");
+    this->SetCorrectlyConfigured(false);
+    return PLUS_FAIL;
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusVirtualPoseFusion::GetAcquisitionRate() const
+{
+  if (this->InertialChannel == NULL || this->InertialChannel->GetOwnerDevice() == NULL)
+  {
+    return this->AcquisitionRate;
+  }
+  return this->InertialChannel->GetOwnerDevice()->GetAcquisitionRate();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualPoseFusion::InternalStartRecording()
+{
+  // The relation between the reference frames is estimated again
+  this->InertialToOpticalReferenceRotationValid = false;
+  this->LastOpticalTimestamp = 0.0;
+  this->LastOpticalUid = 0;
+  this->LastInertialUid = 0;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusVirtualPoseFusion::GetToolToInertialReferenceRotation(vtkMatrix4x4* inertialSensorToInertialReference, double rotation[4]) const
+{
+  // ToolToInertialReference = SensorToInertialReference * ToolToSensor
+  double sensorRotation[4] = { 1, 0, 0, 0 };
+  GetRotationQuaternion(inertialSensorToInertialReference, sensorRotation);
+  double sensorToToolRotation[4] = { 1, 0, 0, 0 };
+  GetRotationQuaternion(this->InertialSensorToTool, sensorToToolRotation);
+  double toolToSensorRotation[4] = { 1, 0, 0, 0 };
+  ConjugateQuaternion(sensorToToolRotation, toolToSensorRotation);
+  vtkMath::MultiplyQuaternion(sensorRotation, toolToSensorRotation, rotation);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusVirtualPoseFusion::CorrectOrientation(vtkMatrix4x4* toolToOpticalReference, vtkMatrix4x4* inertialSensorToInertialReference, double timestamp)
+{
+  // Measured InertialReferenceToOpticalReference = ToolToOpticalReference * InertialReferenceToTool
+  double opticalRotation[4] = { 1, 0, 0, 0 };
+  GetRotationQuaternion(toolToOpticalReference, opticalRotation);
+  double inertialRotation[4] = { 1, 0, 0, 0 };
+  this->GetToolToInertialReferenceRotation(inertialSensorToInertialReference, inertialRotation);
+  double inertialRotationInverse[4] = { 1, 0, 0, 0 };
+  ConjugateQuaternion(inertialRotation, inertialRotationInverse);
+  double measuredRotation[4] = { 1, 0, 0, 0 };
+  vtkMath::MultiplyQuaternion(opticalRotation, inertialRotationInverse, measuredRotation);
+
+  if (!this->InertialToOpticalReferenceRotationValid)
+  {
+    std::copy(measuredRotation, measuredRotation + 4, this->InertialToOpticalReferenceRotation);
+    this->InertialToOpticalReferenceRotationValid = true;
+  }
+  else
+  {
+    if (this->MaximumOrientationDifferenceDeg > 0
+        && GetQuaternionDifferenceDeg(measuredRotation, this->InertialToOpticalReferenceRotation) > this->MaximumOrientationDifferenceDeg)
+    {
+      LOG_DEBUG("Optical pose at " << std::fixed << timestamp << " is ignored by vtkPlusVirtualPoseFusion " << this->GetDeviceId() << ", its orientation differs too much from the inertial orientation");
+      return;
+    }
+    // q and -q are the same rotation, interpolate along the shorter arc
+    double dot = 0.0;
+    for (int i = 0; i < 4; ++i)
+    {
+      dot += measuredRotation[i] * this->InertialToOpticalReferenceRotation[i];
+    }
+    if (dot < 0)
+    {
+      for (int i = 0; i < 4; ++i)
+      {
+        measuredRotation[i] = -measuredRotation[i];
+      }
+    }
+    // Complementary filter: the drift of the inertial heading is corrected slowly, the noise of the optical orientation is attenuated
+    double correctedRotation[4] = { 1, 0, 0, 0 };
+    igsioMath::Slerp(correctedRotation, this->OrientationCorrectionGain, this->InertialToOpticalReferenceRotation, measuredRotation);
+    double norm = std::sqrt(correctedRotation[0] * correctedRotation[0] + correctedRotation[1] * correctedRotation[1]
+                            + correctedRotation[2] * correctedRotation[2] + correctedRotation[3] * correctedRotation[3]);
+    for (int i = 0; i < 4; ++i)
+    {
+      this->InertialToOpticalReferenceRotation[i] = correctedRotation[i] / norm;
+    }
+  }
+
+  for (int i = 0; i < 3; ++i)
+  {
+    this->LastOpticalPosition[i] = toolToOpticalReference->GetElement(i, 3);
+  }
+  this->LastOpticalTimestamp = timestamp;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualPoseFusion::InternalUpdate()
+{
+  if (this->OpticalTool == NULL || this->InertialTool == NULL || this->OutputTool == NULL || this->InertialTool->GetNumberOfItems() < 1)
+  {
+    // No input data yet
+    return PLUS_SUCCESS;
+  }
+
+  BufferItemUidType latestInertialUid = this->InertialTool->GetLatestItemUidInBuffer();
+  double latestInertialTimestamp(0);
+  if (this->InertialTool->GetTimeStamp(latestInertialUid, latestInertialTimestamp) != ITEM_OK)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  // Correct the orientation estimate with the optical poses that have been acquired since the last update.
+  // Optical poses are used when inertial data is available at their time, so they are compared with
+  // the inertial orientation at the time of the optical measurement, not with the latest one.
+  if (this->OpticalTool->GetNumberOfItems() > 0)
+  {
+    BufferItemUidType latestOpticalUid = this->OpticalTool->GetLatestItemUidInBuffer();
+    BufferItemUidType opticalUid = std::max(this->OpticalTool->GetOldestItemUidInBuffer(), this->LastOpticalUid + 1);
+    vtkSmartPointer<vtkMatrix4x4> toolToOpticalReference = vtkSmartPointer<vtkMatrix4x4>::New();
+    vtkSmartPointer<vtkMatrix4x4> inertialSensorToInertialReference = vtkSmartPointer<vtkMatrix4x4>::New();
+    for (; opticalUid <= latestOpticalUid; ++opticalUid)
+    {
+      StreamBufferItem opticalItem;
+      if (this->OpticalTool->GetStreamBufferItem(opticalUid, &opticalItem) != ITEM_OK)
+      {
+        this->LastOpticalUid = opticalUid;
+        continue;
+      }
+      double opticalTimestamp = opticalItem.GetFilteredTimestamp(this->OpticalTool->GetLocalTimeOffsetSec());
+      if (opticalTimestamp > latestInertialTimestamp)
+      {
+        // Wait for the inertial data at the time of this pose
+        break;
+      }
+      this->LastOpticalUid = opticalUid;
+      if (opticalItem.GetStatus() != TOOL_OK || opticalItem.GetMatrix(toolToOpticalReference) != PLUS_SUCCESS)
+      {
+        // Occluded
+        continue;
+      }
+      StreamBufferItem inertialItem;
+      if (this->InertialTool->GetStreamBufferItemFromTime(opticalTimestamp, &inertialItem, vtkPlusBuffer::INTERPOLATED) != ITEM_OK
+          || inertialItem.GetStatus() != TOOL_OK || inertialItem.GetMatrix(inertialSensorToInertialReference) != PLUS_SUCCESS)
+      {
+        continue;
+      }
+      this->CorrectOrientation(toolToOpticalReference, inertialSensorToInertialReference, opticalTimestamp);
+    }
+  }
+
+  // Add a fused pose for each new inertial sample
+  BufferItemUidType inertialUid = this->InertialTool->GetOldestItemUidInBuffer();
+  if (this->LastInertialUid == 0)
+  {
+    // Start with the most recent sample
+    inertialUid = latestInertialUid;
+  }
+  else if (this->LastInertialUid + 1 > inertialUid)
+  {
+    inertialUid = this->LastInertialUid + 1;
+  }
+  PlusStatus status = PLUS_SUCCESS;
+  vtkSmartPointer<vtkMatrix4x4> inertialSensorToInertialReference = vtkSmartPointer<vtkMatrix4x4>::New();
+  for (; inertialUid <= latestInertialUid; ++inertialUid)
+  {
+    this->LastInertialUid = inertialUid;
+    StreamBufferItem inertialItem;
+    if (this->InertialTool->GetStreamBufferItem(inertialUid, &inertialItem) != ITEM_OK || inertialItem.GetMatrix(inertialSensorToInertialReference) != PLUS_SUCCESS)
+    {
+      continue;
+    }
+    double timestamp = inertialItem.GetFilteredTimestamp(this->InertialTool->GetLocalTimeOffsetSec());
+    if (this->AddFusedPose(inertialSensorToInertialReference, inertialItem.GetStatus(), timestamp) != PLUS_SUCCESS)
+    {
+      status = PLUS_FAIL;
+    }
+  }
+
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualPoseFusion::AddFusedPose(vtkMatrix4x4* inertialSensorToInertialReference, ToolStatus inertialStatus, double timestamp)
+{
+  ToolStatus status = TOOL_OK;
+  if (inertialStatus != TOOL_OK || !this->InertialToOpticalReferenceRotationValid
+      || (this->MaximumOpticalDropoutSec >= 0 && timestamp - this->LastOpticalTimestamp > this->MaximumOpticalDropoutSec))
+  {
+    status = TOOL_MISSING;
+  }
+
+  vtkSmartPointer<vtkMatrix4x4> toolToOpticalReference = vtkSmartPointer<vtkMatrix4x4>::New();
+  if (status == TOOL_OK)
+  {
+    // ToolToOpticalReference = InertialReferenceToOpticalReference * ToolToInertialReference
+    double inertialRotation[4] = { 1, 0, 0, 0 };
+    this->GetToolToInertialReferenceRotation(inertialSensorToInertialReference, inertialRotation);
+    double fusedRotation[4] = { 1, 0, 0, 0 };
+    vtkMath::MultiplyQuaternion(this->InertialToOpticalReferenceRotation, inertialRotation, fusedRotation);
+    double rotation[3][3];
+    vtkMath::QuaternionToMatrix3x3(fusedRotation, rotation);
+    for (int row = 0; row < 3; ++row)
+    {
+      for (int column = 0; column < 3; ++column)
+      {
+        toolToOpticalReference->SetElement(row, column, rotation[row][column]);
+      }
+      toolToOpticalReference->SetElement(row, 3, this->LastOpticalPosition[row]);
+    }
+  }
+
+  return this->ToolTimeStampedUpdateWithoutFiltering(this->OutputTool->GetId(), toolToOpticalReference, status, timestamp, timestamp);
+}
@@ -0,0 +1,130 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusVirtualPoseFusion_h
+#define __vtkPlusVirtualPoseFusion_h
+
+#include "vtkPlusDataCollectionExport.h"
+
+#include "vtkPlusDevice.h"
+
+#include <string>
+
+class vtkMatrix4x4;
+class vtkPlusDataSource;
+
+/*!
+\class vtkPlusVirtualPoseFusion
+\brief Virtual tracker that fuses the poses of an optical tracker with the orientation of an inertial sensor
+
+The optical tool (OpticalTransformName, e.g., ProbeToTracker) provides accurate poses at a low rate and it may be occluded.
+The inertial sensor that is attached to the same tool (InertialTransformName, e.g., OrientationSensorToTracker of a
+PhidgetSpatial, ChRobotics or WitMotion device) provides orientations at a high rate, but its heading drifts.
+
+A complementary filter estimates the rotation between the inertial and optical reference frames: each valid optical pose
+is compared with the inertial orientation interpolated at the time of the optical pose (so the latency of the optical tracker
+is compensated, as long as the timestamps of the devices are synchronized), and the estimate is moved towards the measured
+rotation by OrientationCorrectionGain. An output pose is added for each inertial sample, so the output rate is the rate
+of the inertial sensor: the orientation is the inertial orientation in the optical reference frame, the position is the
+position of the latest valid optical pose. If there has been no valid optical pose for MaximumOpticalDropoutSec
+then the output tool is missing.
+
+\ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport vtkPlusVirtualPoseFusion : public vtkPlusDevice
+{
+public:
+  static vtkPlusVirtualPoseFusion* New();
+  vtkTypeMacro(vtkPlusVirtualPoseFusion, vtkPlusDevice);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  virtual bool IsTracker() const { return true; }
+  virtual bool IsVirtual() const { return true; }
+
+  /*! Read configuration from xml data */
+  virtual PlusStatus ReadConfiguration(vtkXMLDataElement*);
+
+  /*! Write configuration to xml data */
+  virtual PlusStatus WriteConfiguration(vtkXMLDataElement*);
+
+  /*! Find the input tools in the input channels and check the output tool */
+  virtual PlusStatus NotifyConfigured();
+
+  /*! Rate of the output poses, which is the rate of the inertial sensor */
+  virtual double GetAcquisitionRate() const;
+
+  /*! Name of the transform of the optical tool in the input channels, e.g., ProbeToTracker */
+  vtkGetStdStringMacro(OpticalTransformName);
+  vtkSetStdStringMacro(OpticalTransformName);
+
+  /*! Name of the transform of the inertial orientation sensor in the input channels, e.g., OrientationSensorToTracker */
+  vtkGetStdStringMacro(InertialTransformName);
+  vtkSetStdStringMacro(InertialTransformName);
+
+  /*! Weight of each optical pose in the estimate of the rotation between the inertial and optical reference frames (0 < gain <= 1) */
+  vtkSetClampMacro(OrientationCorrectionGain, double, 0.001, 1.0);
+  vtkGetMacro(OrientationCorrectionGain, double);
+
+  /*! Poses are output without optical poses for this long, then the output tool is missing */
+  vtkSetMacro(MaximumOpticalDropoutSec, double);
+  vtkGetMacro(MaximumOpticalDropoutSec, double);
+
+  /*! Optical poses are ignored if their rotation differs from the fused pose by more than this (e.g., marker swaps). 0 means no limit. */
+  vtkSetMacro(MaximumOrientationDifferenceDeg, double);
+  vtkGetMacro(MaximumOrientationDifferenceDeg, double);
+
+protected:
+  vtkPlusVirtualPoseFusion();
+  virtual ~vtkPlusVirtualPoseFusion();
+
+  virtual PlusStatus InternalUpdate();
+
+  virtual PlusStatus InternalStartRecording();
+
+  /*! Find a tool of the input channels by its transform name, the channel of the tool is returned in inputChannel */
+  vtkPlusDataSource* FindInputTool(const std::string& transformName, vtkPlusChannel*& inputChannel);
+
+  /*! Update the estimate of the inertial reference to optical reference rotation from an optical pose and the inertial orientation at the same time */
+  void CorrectOrientation(vtkMatrix4x4* toolToOpticalReference, vtkMatrix4x4* inertialSensorToInertialReference, double timestamp);
+
+  /*! Get the rotation of the tool in the inertial reference frame as a quaternion */
+  void GetToolToInertialReferenceRotation(vtkMatrix4x4* inertialSensorToInertialReference, double rotation[4]) const;
+
+  /*! Add the fused pose at the time of an inertial sample to the output tool */
+  PlusStatus AddFusedPose(vtkMatrix4x4* inertialSensorToInertialReference, ToolStatus inertialStatus, double timestamp);
+
+  std::string OpticalTransformName;
+  std::string InertialTransformName;
+  double OrientationCorrectionGain;
+  double MaximumOpticalDropoutSec;
+  double MaximumOrientationDifferenceDeg;
+
+  /*! Fixed transform from the inertial sensor to the optical tool, identity by default */
+  vtkSmartPointer<vtkMatrix4x4> InertialSensorToTool;
+
+  vtkPlusDataSource* OpticalTool;
+  vtkPlusDataSource* InertialTool;
+  vtkPlusChannel* InertialChannel;
+  vtkPlusDataSource* OutputTool;
+
+  /*! Estimated rotation from the inertial reference frame to the optical reference frame, as a quaternion */
+  double InertialToOpticalReferenceRotation[4];
+  bool InertialToOpticalReferenceRotationValid;
+
+  /*! Position of the tool in the optical reference frame, from the latest valid optical pose */
+  double LastOpticalPosition[3];
+  double LastOpticalTimestamp;
+
+  /*! UIDs of the last processed items of the input tools, 0 if none */
+  BufferItemUidType LastOpticalUid;
+  BufferItemUidType LastInertialUid;
+
+private:
+  vtkPlusVirtualPoseFusion(const vtkPlusVirtualPoseFusion&);  // Not implemented.
+  void operator=(const vtkPlusVirtualPoseFusion&);  // Not implemented.
+};
+
+#endif
@@ -0,0 +1,466 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusLatencyTracer.h"
+#include "vtkIGSIOAccurateTimer.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataSource.h"
+#include "vtkPlusVirtualPosePredictor.h"
+
+// VTK includes
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+
+// STL includes
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+  /*! Weight of the latest measurement in the smoothed input latency */
+  const double INPUT_LATENCY_SMOOTHING_FACTOR = 0.05;
+
+  /*! The latency tracer is queried at most this often */
+  const double DOWNSTREAM_LATENCY_QUERY_PERIOD_SEC = 1.0;
+
+  //----------------------------------------------------------------------------
+  void GetRotationQuaternion(vtkMatrix4x4* matrix, double quaternion[4])
+  {
+    double rotation[3][3];
+    for (int row = 0; row < 3; ++row)
+    {
+      for (int column = 0; column < 3; ++column)
+      {
+        rotation[row][column] = matrix->GetElement(row, column);
+      }
+    }
+    vtkMath::Matrix3x3ToQuaternion(rotation, quaternion);
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Rotation vector (axis * angle in radians) of the rotation from the older to the newer orientation, in the reference frame */
+  void GetRotationVector(const double olderRotation[4], const double newerRotation[4], double rotationVector[3])
+  {
+    // Difference = newer * inverse(older)
+    double olderInverse[4] = { olderRotation[0], -olderRotation[1], -olderRotation[2], -olderRotation[3] };
+    double difference[4] = { 1, 0, 0, 0 };
+    vtkMath::MultiplyQuaternion(newerRotation, olderInverse, difference);
+    if (difference[0] < 0)
+    {
+      // q and -q are the same rotation, use the shorter arc
+      for (int i = 0; i < 4; ++i)
+      {
+        difference[i] = -difference[i];
+      }
+    }
+    double sinHalfAngle = std::sqrt(difference[1] * difference[1] + difference[2] * difference[2] + difference[3] * difference[3]);
+    double angle = 2.0 * std::atan2(sinHalfAngle, difference[0]);
+    for (int i = 0; i < 3; ++i)
+    {
+      rotationVector[i] = (sinHalfAngle > 1e-12 ? difference[i + 1] / sinHalfAngle * angle : 2.0 * difference[i + 1]);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void GetQuaternionFromRotationVector(const double rotationVector[3], double quaternion[4])
+  {
+    double angle = vtkMath::Norm(rotationVector);
+    quaternion[0] = std::cos(angle / 2.0);
+    double scale = (angle > 1e-12 ? std::sin(angle / 2.0) / angle : 0.5);
+    for (int i = 0; i < 3; ++i)
+    {
+      quaternion[i + 1] = rotationVector[i] * scale;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Extrapolate from the value at t0 and the mean rates in [t0-window, t0] and [t0-2*window, t0-window] (if acceleration is used) */
+  double Extrapolate(double rate, double previousRate, bool useAcceleration, double windowSec, double horizonSec)
+  {
+    if (!useAcceleration)
+    {
+      return rate * horizonSec;
+    }
+    double acceleration = (rate - previousRate) / windowSec;
+    // The mean rate in the window is the rate at the middle of the window
+    double currentRate = rate + acceleration * windowSec / 2.0;
+    return currentRate * horizonSec + 0.5 * acceleration * horizonSec * horizonSec;
+  }
+}
+
+//----------------------------------------------------------------------------
+
+vtkStandardNewMacro(vtkPlusVirtualPosePredictor);
+
+//----------------------------------------------------------------------------
+vtkPlusVirtualPosePredictor::vtkPlusVirtualPosePredictor()
+  : vtkPlusDevice()
+  , PredictionModel(CONSTANT_VELOCITY)
+  , PredictionHorizonSec(0.05)
+  , AutomaticPredictionHorizon(false)
+  , AdditionalPredictionHorizonSec(0.0)
+  , MaximumPredictionHorizonSec(0.2)
+  , VelocityEstimationWindowSec(0.05)
+  , InputLatencySec(-1.0)
+  , LastDownstreamLatencyQueryTime(0.0)
+  , DownstreamLatencySec(-1.0)
+  , CurrentPredictionHorizonSec(0.05)
+{
+  this->AcquisitionRate = vtkPlusDevice::VIRTUAL_DEVICE_FRAME_RATE;
+
+  // The data capture thread will be used to regularly read the new input poses and add the predicted poses
+  this->StartThreadForInternalUpdates = true;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusVirtualPosePredictor::~vtkPlusVirtualPosePredictor()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusVirtualPosePredictor::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "PredictionModel: " << (this->PredictionModel == CONSTANT_ACCELERATION ? "CONSTANT_ACCELERATION" : "CONSTANT_VELOCITY") << std::endl;
+  os << indent << "PredictionHorizonSec: " << this->PredictionHorizonSec << std::endl;
+  os << indent << "AutomaticPredictionHorizon: " << (this->AutomaticPredictionHorizon ? "TRUE" : "FALSE") << std::endl;
+  os << indent << "AdditionalPredictionHorizonSec: " << this->AdditionalPredictionHorizonSec << std::endl;
+  os << indent << "MaximumPredictionHorizonSec: " << this->MaximumPredictionHorizonSec << std::endl;
+  os << indent << "VelocityEstimationWindowSec: " << this->VelocityEstimationWindowSec << std::endl;
+  os << indent << "CurrentPredictionHorizonSec: " << this->CurrentPredictionHorizonSec << std::endl;
+  for (std::vector<PredictedTool>::const_iterator it = this->PredictedTools.begin(); it != this->PredictedTools.end(); ++it)
+  {
+    os << indent << "PredictedTool: " << it->OutputToolId << " from " << it->InputTransformName << std::endl;
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualPosePredictor::ReadConfiguration(vtkXMLDataElement* rootConfigElement)
+{
+  XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_READING(deviceConfig, rootConfigElement);
+
+  XML_READ_ENUM2_ATTRIBUTE_OPTIONAL(PredictionModel, deviceConfig, "CONSTANT_VELOCITY", CONSTANT_VELOCITY, "CONSTANT_ACCELERATION", CONSTANT_ACCELERATION);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, PredictionHorizonSec, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(AutomaticPredictionHorizon, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, AdditionalPredictionHorizonSec, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, MaximumPredictionHorizonSec, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, VelocityEstimationWindowSec, deviceConfig);
+
+  if (this->VelocityEstimationWindowSec <= 0)
+  {
+    LOG_ERROR("VelocityEstimationWindowSec of vtkPlusVirtualPosePredictor " << this->GetDeviceId() << " must be positive");
+    return PLUS_FAIL;
+  }
+  this->CurrentPredictionHorizonSec = std::min(this->PredictionHorizonSec, this->MaximumPredictionHorizonSec);
+
+  this->PredictedTools.clear();
+  XML_FIND_NESTED_ELEMENT_REQUIRED(dataSourcesElement, deviceConfig, "DataSources");
+  for (int nestedElementIndex = 0; nestedElementIndex < dataSourcesElement->GetNumberOfNestedElements(); nestedElementIndex++)
+  {
+    vtkXMLDataElement* toolDataElement = dataSourcesElement->GetNestedElement(nestedElementIndex);
+    if (STRCASECMP(toolDataElement->GetName(), "DataSource") != 0
+        || toolDataElement->GetAttribute("Type") == NULL || STRCASECMP(toolDataElement->GetAttribute("Type"), vtkPlusDataSource::DATA_SOURCE_TYPE_TOOL_TAG.c_str()) != 0)
+    {
+      // if this is not a tool data source element, skip it
+      continue;
+    }
+    const char* toolId = toolDataElement->GetAttribute("Id");
+    const char* inputTransformName = toolDataElement->GetAttribute("InputTransformName");
+    if (toolId == NULL || inputTransformName == NULL)
+    {
+      LOG_ERROR("Tool data sources of vtkPlusVirtualPosePredictor " << this->GetDeviceId() << " require Id and InputTransformName attributes");
+      return PLUS_FAIL;
+    }
+    PredictedTool predictedTool;
+    predictedTool.OutputToolId = igsioTransformName(toolId, this->GetToolReferenceFrameName()).GetTransformName();
+    predictedTool.InputTransformName = inputTransformName;
+    this->PredictedTools.push_back(predictedTool);
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualPosePredictor::WriteConfiguration(vtkXMLDataElement* rootConfigElement)
+{
+  XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_WRITING(deviceConfig, rootConfigElement);
+
+  deviceConfig->SetAttribute("PredictionModel", this->PredictionModel == CONSTANT_ACCELERATION ? "CONSTANT_ACCELERATION" : "CONSTANT_VELOCITY");
+  deviceConfig->SetDoubleAttribute("PredictionHorizonSec", this->PredictionHorizonSec);
+  XML_WRITE_BOOL_ATTRIBUTE(AutomaticPredictionHorizon, deviceConfig);
+  deviceConfig->SetDoubleAttribute("AdditionalPredictionHorizonSec", this->AdditionalPredictionHorizonSec);
+  deviceConfig->SetDoubleAttribute("MaximumPredictionHorizonSec", this->MaximumPredictionHorizonSec);
+  deviceConfig->SetDoubleAttribute("VelocityEstimationWindowSec", this->VelocityEstimationWindowSec);
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualPosePredictor::NotifyConfigured()
+{
+  if (this->InputChannels.empty())
+  {
+    LOG_ERROR("No input channel set for vtkPlusVirtualPosePredictor " << this->GetDeviceId());
+    this->SetCorrectlyConfigured(false);
+    return PLUS_FAIL;
+  }
+  if (this->PredictedTools.empty())
+  {
+    LOG_ERROR("vtkPlusVirtualPosePredictor " << this->GetDeviceId() << " requires at least one tool data source");
+    this->SetCorrectlyConfigured(false);
+    return PLUS_FAIL;
+  }
+
+  for (std::vector<PredictedTool>::iterator predictedToolIt = this->PredictedTools.begin(); predictedToolIt != this->PredictedTools.end(); ++predictedToolIt)
+  {
+    if (this->GetTool(predictedToolIt->OutputToolId, predictedToolIt->OutputTool) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Tool " << predictedToolIt->OutputToolId << " of vtkPlusVirtualPosePredictor " << this->GetDeviceId() << " is not found");
+      this->SetCorrectlyConfigured(false);
+      return PLUS_FAIL;
+    }
+    predictedToolIt->InputTool = NULL;
+    for (ChannelContainerConstIterator channelIt = this->InputChannels.begin(); channelIt != this->InputChannels.end() && predictedToolIt->InputTool == NULL; ++channelIt)
+    {
+      for (DataSourceContainerConstIterator toolIt = (*channelIt)->GetToolsStartConstIterator(); toolIt != (*channelIt)->GetToolsEndConstIterator(); ++toolIt)
+      {
+        if (toolIt->second->GetTransformName() == predictedToolIt->InputTransformName)
+        {
+          predictedToolIt->InputTool = toolIt->second;
+          break;
+        }
+      }
+    }
+    if (predictedToolIt->InputTool == NULL)
+    {
+      LOG_ERROR("Input channels of vtkPlusVirtualPosePredictor " << this->GetDeviceId() << " do not contain the " << predictedToolIt->InputTransformName << " tool");
+      this->SetCorrectlyConfigured(false);
+      return PLUS_FAIL;
+    }
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusVirtualPosePredictor::GetAcquisitionRate() const
+{
+  if (this->InputChannels.empty() || this->InputChannels[0]->GetOwnerDevice() == NULL)
+  {
+    return this->AcquisitionRate;
+  }
+  return this->InputChannels[0]->GetOwnerDevice()->GetAcquisitionRate();
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusVirtualPosePredictor::GetCurrentPredictionHorizonSec() const
+{
+  return this->CurrentPredictionHorizonSec;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualPosePredictor::InternalStartRecording()
+{
+  for (std::vector<PredictedTool>::iterator predictedToolIt = this->PredictedTools.begin(); predictedToolIt != this->PredictedTools.end(); ++predictedToolIt)
+  {
+    predictedToolIt->LastInputUid = 0;
+  }
+  this->InputLatencySec = -1.0;
+  this->DownstreamLatencySec = -1.0;
+  this->LastDownstreamLatencyQueryTime = 0.0;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusVirtualPosePredictor::UpdatePredictionHorizon(double latestInputTimestamp)
+{
+  if (!this->AutomaticPredictionHorizon)
+  {
+    this->CurrentPredictionHorizonSec = std::max(0.0, std::min(this->PredictionHorizonSec, this->MaximumPredictionHorizonSec));
+    return;
+  }
+
+  double now = vtkIGSIOAccurateTimer::GetSystemTime();
+
+  // Latency of the input devices (hardware and transfer, if their LocalTimeOffsetSec is calibrated) and of the input channels
+  double inputLatencySec = std::max(0.0, now - latestInputTimestamp);
+  if (this->InputLatencySec < 0)
+  {
+    this->InputLatencySec = inputLatencySec;
+  }
+  else
+  {
+    this->InputLatencySec += INPUT_LATENCY_SMOOTHING_FACTOR * (inputLatencySec - this->InputLatencySec);
+  }
+
+  // Latency from adding the predicted pose until sending it to the clients
+  if (LatencyTracer::IsEnabled() && now - this->LastDownstreamLatencyQueryTime > DOWNSTREAM_LATENCY_QUERY_PERIOD_SEC)
+  {
+    this->LastDownstreamLatencyQueryTime = now;
+    double downstreamLatencySec = -1.0;
+    for (ChannelContainerConstIterator channelIt = this->OutputChannels.begin(); channelIt != this->OutputChannels.end(); ++channelIt)
+    {
+      LatencyTracer::Histogram histogram;
+      if (LatencyTracer::GetInstance().GetChannelSentHistogram((*channelIt)->GetChannelId(), histogram) == PLUS_SUCCESS && histogram.GetNumberOfSamples() > 0)
+      {
+        downstreamLatencySec = std::max(downstreamLatencySec, histogram.GetMeanSec());
+      }
+    }
+    if (downstreamLatencySec >= 0)
+    {
+      this->DownstreamLatencySec = downstreamLatencySec;
+    }
+  }
+
+  double horizonSec = this->InputLatencySec + std::max(0.0, this->DownstreamLatencySec) + this->AdditionalPredictionHorizonSec;
+  this->CurrentPredictionHorizonSec = std::max(0.0, std::min(horizonSec, this->MaximumPredictionHorizonSec));
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualPosePredictor::PredictPose(vtkPlusDataSource* inputTool, vtkMatrix4x4* toolToReference, double timestamp, vtkMatrix4x4* predictedToolToReference)
+{
+  bool useAcceleration = (this->PredictionModel == CONSTANT_ACCELERATION);
+  int numberOfPreviousPoses = (useAcceleration ? 2 : 1);
+
+  // Previous poses, the first one is VelocityEstimationWindowSec before the timestamp, the second one (if needed) twice as much
+  double positions[3][3] = { { 0 } };
+  double rotations[3][4] = { { 1, 0, 0, 0 } };
+  for (int i = 0; i < 3; ++i)
+  {
+    positions[0][i] = toolToReference->GetElement(i, 3);
+  }
+  GetRotationQuaternion(toolToReference, rotations[0]);
+  vtkSmartPointer<vtkMatrix4x4> previousToolToReference = vtkSmartPointer<vtkMatrix4x4>::New();
+  for (int poseIndex = 1; poseIndex <= numberOfPreviousPoses; ++poseIndex)
+  {
+    StreamBufferItem previousItem;
+    if (inputTool->GetStreamBufferItemFromTime(timestamp - poseIndex * this->VelocityEstimationWindowSec, &previousItem, vtkPlusBuffer::INTERPOLATED) != ITEM_OK
+        || previousItem.GetStatus() != TOOL_OK || previousItem.GetMatrix(previousToolToReference) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    for (int i = 0; i < 3; ++i)
+    {
+      positions[poseIndex][i] = previousToolToReference->GetElement(i, 3);
+    }
+    GetRotationQuaternion(previousToolToReference, rotations[poseIndex]);
+  }
+
+  const double windowSec = this->VelocityEstimationWindowSec;
+  const double horizonSec = this->CurrentPredictionHorizonSec;
+
+  double angularVelocity[3] = { 0 };
+  GetRotationVector(rotations[1], rotations[0], angularVelocity);
+  double previousAngularVelocity[3] = { 0 };
+  if (useAcceleration)
+  {
+    GetRotationVector(rotations[2], rotations[1], previousAngularVelocity);
+  }
+
+  double predictedRotationVector[3] = { 0 };
+  double predictedPosition[3] = { 0 };
+  for (int i = 0; i < 3; ++i)
+  {
+    double velocity = (positions[0][i] - positions[1][i]) / windowSec;
+    double previousVelocity = (useAcceleration ? (positions[1][i] - positions[2][i]) / windowSec : 0.0);
+    predictedPosition[i] = positions[0][i] + Extrapolate(velocity, previousVelocity, useAcceleration, windowSec, horizonSec);
+    predictedRotationVector[i] = Extrapolate(angularVelocity[i] / windowSec, previousAngularVelocity[i] / windowSec, useAcceleration, windowSec, horizonSec);
+  }
+
+  // PredictedRotation = RotationDuringHorizon * Rotation (the angular velocity is in the reference frame)
+  double rotationDuringHorizon[4] = { 1, 0, 0, 0 };
+  GetQuaternionFromRotationVector(predictedRotationVector, rotationDuringHorizon);
+  double predictedRotation[4] = { 1, 0, 0, 0 };
+  vtkMath::MultiplyQuaternion(rotationDuringHorizon, rotations[0], predictedRotation);
+  double rotationMatrix[3][3];
+  vtkMath::QuaternionToMatrix3x3(predictedRotation, rotationMatrix);
+
+  predictedToolToReference->Identity();
+  for (int row = 0; row < 3; ++row)
+  {
+    for (int column = 0; column < 3; ++column)
+    {
+      predictedToolToReference->SetElement(row, column, rotationMatrix[row][column]);
+    }
+    predictedToolToReference->SetElement(row, 3, predictedPosition[row]);
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualPosePredictor::InternalUpdate()
+{
+  PlusStatus status = PLUS_SUCCESS;
+  vtkSmartPointer<vtkMatrix4x4> toolToReference = vtkSmartPointer<vtkMatrix4x4>::New();
+  vtkSmartPointer<vtkMatrix4x4> predictedToolToReference = vtkSmartPointer<vtkMatrix4x4>::New();
+  bool horizonUpdated = false;
+
+  for (std::vector<PredictedTool>::iterator predictedToolIt = this->PredictedTools.begin(); predictedToolIt != this->PredictedTools.end(); ++predictedToolIt)
+  {
+    vtkPlusDataSource* inputTool = predictedToolIt->InputTool;
+    if (inputTool == NULL || predictedToolIt->OutputTool == NULL || inputTool->GetNumberOfItems() < 1)
+    {
+      // No input data yet
+      continue;
+    }
+
+    BufferItemUidType latestUid = inputTool->GetLatestItemUidInBuffer();
+    if (latestUid <= predictedToolIt->LastInputUid)
+    {
+      // No new pose
+      continue;
+    }
+    BufferItemUidType uid = std::max(inputTool->GetOldestItemUidInBuffer(), predictedToolIt->LastInputUid + 1);
+    if (predictedToolIt->LastInputUid == 0)
+    {
+      // Start with the most recent pose
+      uid = latestUid;
+    }
+
+    if (!horizonUpdated)
+    {
+      double latestTimestamp(0);
+      if (inputTool->GetTimeStamp(latestUid, latestTimestamp) == ITEM_OK)
+      {
+        this->UpdatePredictionHorizon(latestTimestamp);
+        horizonUpdated = true;
+      }
+    }
+
+    for (; uid <= latestUid; ++uid)
+    {
+      predictedToolIt->LastInputUid = uid;
+      StreamBufferItem inputItem;
+      if (inputTool->GetStreamBufferItem(uid, &inputItem) != ITEM_OK)
+      {
+        continue;
+      }
+      double timestamp = inputItem.GetFilteredTimestamp(inputTool->GetLocalTimeOffsetSec());
+      ToolStatus toolStatus = inputItem.GetStatus();
+      if (toolStatus != TOOL_OK || inputItem.GetMatrix(toolToReference) != PLUS_SUCCESS)
+      {
+        toolToReference->Identity();
+        predictedToolToReference->Identity();
+        toolStatus = (toolStatus == TOOL_OK ? TOOL_INVALID : toolStatus);
+      }
+      else if (this->PredictPose(inputTool, toolToReference, timestamp, predictedToolToReference) != PLUS_SUCCESS)
+      {
+        // Not enough poses in the buffer to estimate the velocity (e.g., the tool has just become visible)
+        predictedToolToReference->DeepCopy(toolToReference);
+      }
+      if (this->ToolTimeStampedUpdateWithoutFiltering(predictedToolIt->OutputTool->GetId(), predictedToolToReference, toolStatus, timestamp, timestamp) != PLUS_SUCCESS)
+      {
+        status = PLUS_FAIL;
+      }
+    }
+  }
+
+  return status;
+}
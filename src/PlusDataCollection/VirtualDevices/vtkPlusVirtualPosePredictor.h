@@ -0,0 +1,144 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusVirtualPosePredictor_h
+#define __vtkPlusVirtualPosePredictor_h
+
+#include "vtkPlusDataCollectionExport.h"
+
+#include "vtkPlusDevice.h"
+
+#include <string>
+#include <vector>
+
+class vtkMatrix4x4;
+class vtkPlusDataSource;
+
+/*!
+\class vtkPlusVirtualPosePredictor
+\brief Virtual tracker that extrapolates the poses of the input tools to compensate the latency of the pipeline
+
+Each output tool data source predicts the pose of an input tool (InputTransformName attribute of the DataSource element).
+The linear and angular velocity (and, with the CONSTANT_ACCELERATION model, the acceleration) are estimated from the poses
+in the buffer of the input tool, VelocityEstimationWindowSec apart, and the pose is extrapolated by the prediction horizon.
+
+The prediction horizon is PredictionHorizonSec. If AutomaticPredictionHorizon is enabled then it is the measured latency:
+the time from the input pose timestamp until the predictor reads the pose, plus the mean acquisition to sending latency
+of the output channel recorded by the latency tracer (if latency tracing is enabled), plus AdditionalPredictionHorizonSec
+(latency after sending, e.g., rendering on the client). The horizon is limited to MaximumPredictionHorizonSec.
+
+The timestamp of a predicted pose is the timestamp of the input pose that it was predicted from.
+
+\ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport vtkPlusVirtualPosePredictor : public vtkPlusDevice
+{
+public:
+  enum PredictionModelType
+  {
+    CONSTANT_VELOCITY,
+    CONSTANT_ACCELERATION
+  };
+
+  static vtkPlusVirtualPosePredictor* New();
+  vtkTypeMacro(vtkPlusVirtualPosePredictor, vtkPlusDevice);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  virtual bool IsTracker() const { return true; }
+  virtual bool IsVirtual() const { return true; }
+
+  /*! Read configuration from xml data */
+  virtual PlusStatus ReadConfiguration(vtkXMLDataElement*);
+
+  /*! Write configuration to xml data */
+  virtual PlusStatus WriteConfiguration(vtkXMLDataElement*);
+
+  /*! Find the input tools of the output tools in the input channels */
+  virtual PlusStatus NotifyConfigured();
+
+  /*! Rate of the output poses, which is the rate of the device of the first input channel */
+  virtual double GetAcquisitionRate() const;
+
+  vtkSetMacro(PredictionModel, PredictionModelType);
+  vtkGetMacro(PredictionModel, PredictionModelType);
+
+  /*! Prediction horizon if AutomaticPredictionHorizon is disabled or no latency has been measured yet */
+  vtkSetMacro(PredictionHorizonSec, double);
+  vtkGetMacro(PredictionHorizonSec, double);
+
+  /*! If enabled then the prediction horizon is the measured latency */
+  vtkSetMacro(AutomaticPredictionHorizon, bool);
+  vtkGetMacro(AutomaticPredictionHorizon, bool);
+  vtkBooleanMacro(AutomaticPredictionHorizon, bool);
+
+  /*! Added to the measured latency, for the latency that cannot be measured (e.g., rendering on the client) */
+  vtkSetMacro(AdditionalPredictionHorizonSec, double);
+  vtkGetMacro(AdditionalPredictionHorizonSec, double);
+
+  /*! Upper limit of the prediction horizon, because the error of the extrapolation grows quickly with the horizon */
+  vtkSetMacro(MaximumPredictionHorizonSec, double);
+  vtkGetMacro(MaximumPredictionHorizonSec, double);
+
+  /*! Time between the poses that the velocity is estimated from. Longer windows attenuate the noise but respond slower. */
+  vtkSetMacro(VelocityEstimationWindowSec, double);
+  vtkGetMacro(VelocityEstimationWindowSec, double);
+
+  /*! Prediction horizon that was used for the latest poses */
+  double GetCurrentPredictionHorizonSec() const;
+
+protected:
+  vtkPlusVirtualPosePredictor();
+  virtual ~vtkPlusVirtualPosePredictor();
+
+  virtual PlusStatus InternalUpdate();
+
+  virtual PlusStatus InternalStartRecording();
+
+  /*! Output tool with the input tool that it is predicted from */
+  struct PredictedTool
+  {
+    PredictedTool() : InputTool(NULL), OutputTool(NULL), LastInputUid(0) {}
+    std::string OutputToolId;
+    std::string InputTransformName;
+    vtkPlusDataSource* InputTool;
+    vtkPlusDataSource* OutputTool;
+    /*! UID of the last processed item of the input tool, 0 if none */
+    BufferItemUidType LastInputUid;
+  };
+
+  /*! Update the measured latency and the prediction horizon */
+  void UpdatePredictionHorizon(double latestInputTimestamp);
+
+  /*!
+    Extrapolate the pose of the input tool at the timestamp by the prediction horizon.
+    Returns PLUS_FAIL if there are not enough poses in the buffer to estimate the velocity.
+  */
+  PlusStatus PredictPose(vtkPlusDataSource* inputTool, vtkMatrix4x4* toolToReference, double timestamp, vtkMatrix4x4* predictedToolToReference);
+
+  std::vector<PredictedTool> PredictedTools;
+
+  PredictionModelType PredictionModel;
+  double PredictionHorizonSec;
+  bool AutomaticPredictionHorizon;
+  double AdditionalPredictionHorizonSec;
+  double MaximumPredictionHorizonSec;
+  double VelocityEstimationWindowSec;
+
+  /*! Smoothed time from the input pose timestamps until the predictor reads them, negative if not measured yet */
+  double InputLatencySec;
+  /*! System time of the last query of the latency tracer */
+  double LastDownstreamLatencyQueryTime;
+  /*! Mean acquisition to sending latency of the output channel, negative if not measured */
+  double DownstreamLatencySec;
+
+  double CurrentPredictionHorizonSec;
+
+private:
+  vtkPlusVirtualPosePredictor(const vtkPlusVirtualPosePredictor&);  // Not implemented.
+  void operator=(const vtkPlusVirtualPosePredictor&);  // Not implemented.
+};
+
+#endif
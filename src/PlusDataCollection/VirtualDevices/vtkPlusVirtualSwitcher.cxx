@@ -20,6 +20,7 @@ vtkPlusVirtualSwitcher::vtkPlusVirtualSwitcher()
 : vtkPlusDevice()
 , CurrentActiveInputChannel(NULL)
 , OutputChannel(NULL)
+, OutputSourceChannel(NULL)
 , FramesWhileInactive(0)
 {
   // The data capture thread will be used to regularly check the input devices and generate and update the output
@@ -70,44 +71,42 @@ PlusStatus vtkPlusVirtualSwitcher::InternalUpdate()
   //    correctly detect this situation and wait a few frames before switching
       // if timestamp not changed within 'FRAME_COUNT_BEFORE_INACTIVE' frames, then do new stream check
 
+  if( this->CurrentActiveInputChannel == NULL )
+  {
+    // Wait for the first input that provides data
+    this->SelectActiveChannel();
+    return PLUS_SUCCESS;
+  }
+
   double latestCurrentTimestamp(0);
-  if( this->CurrentActiveInputChannel != NULL )
+  if( this->CurrentActiveInputChannel->GetLatestTimestamp(latestCurrentTimestamp) != PLUS_SUCCESS )
   {
-    if( this->CurrentActiveInputChannel->GetLatestTimestamp(latestCurrentTimestamp) != PLUS_SUCCESS )
-    {
-      LOG_ERROR("Unable to retrieve timestamp from active stream.");
-      return PLUS_FAIL;
-    }
-    if( this->LastRecordedTimestampMap[this->CurrentActiveInputChannel] == 0 )
-    {
-      this->LastRecordedTimestampMap[this->CurrentActiveInputChannel] = latestCurrentTimestamp;
-      return PLUS_SUCCESS;
-    }
+    LOG_ERROR("Unable to retrieve timestamp from active stream.");
+    return PLUS_FAIL;
+  }
+  if( this->LastRecordedTimestampMap[this->CurrentActiveInputChannel] == 0 )
+  {
+    this->LastRecordedTimestampMap[this->CurrentActiveInputChannel] = latestCurrentTimestamp;
+    return PLUS_SUCCESS;
+  }
 
-    if( latestCurrentTimestamp > this->LastRecordedTimestampMap[this->CurrentActiveInputChannel] )
-    {
-      // Device is still active
-      return PLUS_SUCCESS;
-    }
-    else
-    {
-      if( FramesWhileInactive >= FRAME_COUNT_BEFORE_INACTIVE )
-      {
-        this->FramesWhileInactive = 0;
-        // Device is no longer active
-        if( this->SelectActiveChannel() == PLUS_FAIL )
-        {
-          // No active devices, don't copy anything!
-          return PLUS_SUCCESS;
-        }
-      }
-      else
-      {
-        FramesWhileInactive++;
-      }
-    }
+  if( latestCurrentTimestamp > this->LastRecordedTimestampMap[this->CurrentActiveInputChannel] )
+  {
+    // Device is still active
+    this->LastRecordedTimestampMap[this->CurrentActiveInputChannel] = latestCurrentTimestamp;
+    this->FramesWhileInactive = 0;
+    return PLUS_SUCCESS;
+  }
 
-    this->CopyInputChannelToOutputChannel();
+  if( FramesWhileInactive >= FRAME_COUNT_BEFORE_INACTIVE )
+  {
+    this->FramesWhileInactive = 0;
+    // Device is no longer active, switch to another one (the output is switched only if the selected channel is different)
+    this->SelectActiveChannel();
+  }
+  else
+  {
+    FramesWhileInactive++;
   }
 
   return PLUS_SUCCESS;
@@ -187,6 +186,7 @@ PlusStatus vtkPlusVirtualSwitcher::ReadConfiguration( vtkXMLDataElement* rootCon
 PlusStatus vtkPlusVirtualSwitcher::NotifyConfigured()
 {
   this->LastRecordedTimestampMap.clear();
+  this->OutputSourceChannel = NULL;
 
   for( ChannelContainerConstIterator it = this->InputChannels.begin(); it != this->InputChannels.end(); ++it )
   {
@@ -200,12 +200,20 @@ PlusStatus vtkPlusVirtualSwitcher::NotifyConfigured()
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusVirtualSwitcher::CopyInputChannelToOutputChannel()
 {
-  // Only destroy if things have to change
-  if( this->CurrentActiveInputChannel != NULL )
+  // Only switch if things have to change
+  if( this->CurrentActiveInputChannel == NULL || this->CurrentActiveInputChannel == this->OutputSourceChannel )
   {
-    // no need to do a deep copy, iterators are used to access data anyways
-    this->OutputChannel->ShallowCopy(*this->CurrentActiveInputChannel);
+    return PLUS_SUCCESS;
+  }
+
+  // The sources are shared with the input channel, their buffers must not be cleared
+  if( this->OutputChannel->SwitchSources(*this->CurrentActiveInputChannel) != PLUS_SUCCESS )
+  {
+    LOG_ERROR("Failed to switch output channel " << this->OutputChannel->GetChannelId() << " to input channel " << this->CurrentActiveInputChannel->GetChannelId());
+    return PLUS_FAIL;
   }
+  this->OutputSourceChannel = this->CurrentActiveInputChannel;
+  LOG_INFO("Output channel " << this->OutputChannel->GetChannelId() << " switched to input channel " << this->CurrentActiveInputChannel->GetChannelId());
 
   return PLUS_SUCCESS;
 }
\ No newline at end of file
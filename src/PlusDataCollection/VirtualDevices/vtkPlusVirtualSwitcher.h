@@ -14,7 +14,10 @@ See License.txt for details.
 
 /*!
 \class vtkPlusVirtualSwitcher
-\brief 
+\brief Forwards the data of the currently active input channel to the output channel
+
+When the active input channel changes, the output channel switches to the sources of the new input channel
+(see vtkPlusChannel::SwitchSources). Consumers detect the switch by the sources generation of the output channel.
 
 \ingroup PlusLibDataCollection
 */
@@ -47,6 +50,7 @@ protected:
 
   PlusStatus SelectActiveChannel();
 
+  /*! Switch the output channel to the sources of the active input channel, if it is not switched already */
   PlusStatus CopyInputChannelToOutputChannel();
 
   vtkPlusVirtualSwitcher();
@@ -60,6 +64,8 @@ protected:
   vtkPlusChannel*                    CurrentActiveInputChannel;
   std::map<vtkPlusChannel*, double>  LastRecordedTimestampMap;
   vtkPlusChannel*                    OutputChannel;
+  /*! Input channel whose sources are in the output channel */
+  vtkPlusChannel*                    OutputSourceChannel;
 
   unsigned long FramesWhileInactive;
 
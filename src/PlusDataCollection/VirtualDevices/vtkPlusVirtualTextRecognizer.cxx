@@ -6,6 +6,7 @@ See License.txt for details.
 
 #include "PlusConfigure.h"
 
+#include "PlusOverloadManager.h"
 #include "igsioCommon.h"
 #include "vtkPlusDataCollector.h"
 #include "vtkObjectFactory.h"
@@ -22,6 +23,10 @@ See License.txt for details.
 // Configuration includes
 #include "tesseractDataDir.h"
 
+// STL includes
+#include <algorithm>
+#include <thread>
+
 //----------------------------------------------------------------------------
 
 vtkStandardNewMacro(vtkPlusVirtualTextRecognizer);
@@ -45,6 +50,9 @@ namespace
 vtkPlusVirtualTextRecognizer::vtkPlusVirtualTextRecognizer()
   : vtkPlusDevice()
   , Language()
+  , NumberOfRecognitionThreads(0)
+  , RecognitionPausedForOverload(false)
+  , OverloadPolicyHandlerId(0)
   , TrackedFrames(vtkIGSIOTrackedFrameList::New())
   , OutputChannel(NULL)
 {
@@ -66,6 +74,7 @@ void vtkPlusVirtualTextRecognizer::ClearConfiguration()
     it->second.clear();
   }
   this->RecognitionFields.clear();
+  this->LastProcessedTimestamps.clear();
 }
 
 //----------------------------------------------------------------------------
@@ -92,42 +101,55 @@ vtkPlusVirtualTextRecognizer::ChannelFieldListMap& vtkPlusVirtualTextRecognizer:
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusVirtualTextRecognizer::InternalUpdate()
 {
-  std::map<double, int> queriedFramesIndexes;
-  std::vector<igsioTrackedFrame*> queriedFrames;
-
-  if (!this->HasGracePeriodExpired())
+  if (!this->HasGracePeriodExpired() || this->RecognitionPausedForOverload)
   {
     return PLUS_SUCCESS;
   }
 
+  // Fields whose screen region changed since their text was last recognized
+  std::vector<TextFieldParameter*> changedParameters;
   for (ChannelFieldListMapIterator it = this->RecognitionFields.begin(); it != this->RecognitionFields.end(); ++it)
   {
-    for (FieldListIterator fieldIt = it->second.begin(); fieldIt != it->second.end(); ++fieldIt)
+    if (it->second.empty())
     {
-      TextFieldParameter* parameter = *fieldIt;
-      igsioTrackedFrame frame;
-
-      // Attempt to find the frame already retrieved
-      PlusStatus result = FindOrQueryFrame(frame, queriedFramesIndexes, parameter, queriedFrames);
+      continue;
+    }
 
-      if (result != PLUS_SUCCESS || frame.GetImageData()->GetImage() == NULL)
+    // Fields are not checked again until the channel has a new frame
+    double mostRecent(UNDEFINED_TIMESTAMP);
+    if (it->first->GetVideoDataAvailable() && it->first->GetMostRecentTimestamp(mostRecent) == PLUS_SUCCESS)
+    {
+      std::map<vtkPlusChannel*, double>::iterator lastIt = this->LastProcessedTimestamps.find(it->first);
+      if (lastIt != this->LastProcessedTimestamps.end() && lastIt->second == mostRecent)
       {
         continue;
       }
+    }
 
-      // We have a frame, let's parse it
-      vtkImageDataToPix(frame, parameter);
-
-      this->TesseractAPI->SetImage(parameter->ReceivedFrame);
-      char* text_out = this->TesseractAPI->GetUTF8Text();
-      std::string textStr(text_out);
-      parameter->LatestParameterValue = igsioCommon::Trim(textStr);
-      delete [] text_out;
+    // All fields of the channel are read from the same frame
+    igsioTrackedFrame* frame(NULL);
+    if (this->QueryFrame(it->first, frame) != PLUS_SUCCESS || frame->GetImageData()->GetImage() == NULL)
+    {
+      continue;
+    }
+    this->LastProcessedTimestamps[it->first] = frame->GetTimestamp();
 
-      frame.SetFrameField(parameter->ParameterName, parameter->LatestParameterValue);
+    for (FieldListIterator fieldIt = it->second.begin(); fieldIt != it->second.end(); ++fieldIt)
+    {
+      TextFieldParameter* parameter = *fieldIt;
+      this->ClipScreenRegion(*frame, parameter);
+      if (!this->UpdateRecognizedRegion(parameter))
+      {
+        // Same pixels as last time, the recognized text is still valid
+        continue;
+      }
+      this->vtkImageDataToPix(parameter);
+      changedParameters.push_back(parameter);
     }
   }
 
+  this->RecognizeText(changedParameters);
+
   // Build the field map to send to the data sources
   igsioFieldMapType fieldMap;
   for (ChannelFieldListMapIterator it = this->RecognitionFields.begin(); it != this->RecognitionFields.end(); ++it)
@@ -149,7 +171,7 @@ PlusStatus vtkPlusVirtualTextRecognizer::InternalUpdate()
 }
 
 //----------------------------------------------------------------------------
-void vtkPlusVirtualTextRecognizer::vtkImageDataToPix(igsioTrackedFrame& frame, TextFieldParameter* parameter)
+void vtkPlusVirtualTextRecognizer::ClipScreenRegion(igsioTrackedFrame& frame, TextFieldParameter* parameter)
 {
   igsioVideoFrame::GetOrientedClippedImage(frame.GetImageData()->GetImage(),
       igsioVideoFrame::FlipInfoType(),
@@ -157,7 +179,26 @@ void vtkPlusVirtualTextRecognizer::vtkImageDataToPix(igsioTrackedFrame& frame, T
       parameter->ScreenRegion,
       parameter->Origin,
       parameter->Size);
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusVirtualTextRecognizer::UpdateRecognizedRegion(TextFieldParameter* parameter)
+{
+  vtkImageData* region = parameter->ScreenRegion;
+  const unsigned char* pixels = static_cast<const unsigned char*>(region->GetScalarPointer());
+  const size_t numberOfBytes = static_cast<size_t>(region->GetNumberOfPoints()) * region->GetNumberOfScalarComponents() * region->GetScalarSize();
+  if (parameter->RecognizedRegionPixels.size() == numberOfBytes
+      && std::equal(pixels, pixels + numberOfBytes, parameter->RecognizedRegionPixels.begin()))
+  {
+    return false;
+  }
+  parameter->RecognizedRegionPixels.assign(pixels, pixels + numberOfBytes);
+  return true;
+}
 
+//----------------------------------------------------------------------------
+void vtkPlusVirtualTextRecognizer::vtkImageDataToPix(TextFieldParameter* parameter)
+{
   unsigned int* data = pixGetData(parameter->ReceivedFrame);
   int wpl = pixGetWpl(parameter->ReceivedFrame);
   int bpl = ((8 * parameter->Size[0]) + 7) / 8;
@@ -183,49 +224,59 @@ void vtkPlusVirtualTextRecognizer::vtkImageDataToPix(igsioTrackedFrame& frame, T
 }
 
 //----------------------------------------------------------------------------
-PlusStatus vtkPlusVirtualTextRecognizer::FindOrQueryFrame(igsioTrackedFrame& frame, std::map<double, int>& QueriedFramesIndexes, TextFieldParameter* parameter, std::vector<igsioTrackedFrame*>& QueriedFrames)
+void vtkPlusVirtualTextRecognizer::RecognizeText(const std::vector<TextFieldParameter*>& parameters)
 {
-  double mostRecent(-1);
-
-  if (!parameter->SourceChannel->GetVideoDataAvailable())
-  {
-    LOG_WARNING("Processed data is not generated, as no video data is available yet. Device ID: " << this->GetDeviceId());
-    return PLUS_FAIL;
-  }
-
-  if (parameter->SourceChannel->GetMostRecentTimestamp(mostRecent) != PLUS_SUCCESS)
+  const size_t numberOfThreads = std::min(this->TesseractAPIs.size(), parameters.size());
+  if (numberOfThreads == 0)
   {
-    LOG_ERROR("Unable to retrieve most recent timestamp for parameter " << parameter->ParameterName);
-    return PLUS_FAIL;
+    return;
   }
 
-  // Search the retrieved frames to see is this timestamp has already been pulled
-  std::map<double, int>::iterator frameIt = QueriedFramesIndexes.find(mostRecent);
-
-  // If it hasn't, go get the latest
-  if (frameIt == QueriedFramesIndexes.end())
+  // Each thread recognizes every numberOfThreads-th field with its own tesseract instance
+  auto recognizeFields = [this, &parameters, numberOfThreads](size_t threadIndex)
   {
-    this->TrackedFrames->Clear();
-    double aTimestamp(UNDEFINED_TIMESTAMP);
-    if (parameter->SourceChannel->GetTrackedFrameList(aTimestamp, this->TrackedFrames, 1) != PLUS_SUCCESS)
+    tesseract::TessBaseAPI* tesseractAPI = this->TesseractAPIs[threadIndex];
+    for (size_t i = threadIndex; i < parameters.size(); i += numberOfThreads)
     {
-      LOG_INFO("Failed to get tracked frame list from data collector.");
-      return PLUS_FAIL;
+      tesseractAPI->SetImage(parameters[i]->ReceivedFrame);
+      char* text_out = tesseractAPI->GetUTF8Text();
+      std::string textStr(text_out);
+      parameters[i]->LatestParameterValue = igsioCommon::Trim(textStr);
+      delete [] text_out;
     }
-    double timestamp = TrackedFrames->GetTrackedFrame(0)->GetTimestamp();
+  };
 
-    // Copy the frame so it isn't lost when the tracked frame list is cleared
-    frame = (*TrackedFrames->GetTrackedFrame(0));
+  std::vector<std::thread> threads;
+  for (size_t threadIndex = 1; threadIndex < numberOfThreads; ++threadIndex)
+  {
+    threads.push_back(std::thread(recognizeFields, threadIndex));
+  }
+  recognizeFields(0);
+  for (std::vector<std::thread>::iterator threadIt = threads.begin(); threadIt != threads.end(); ++threadIt)
+  {
+    threadIt->join();
+  }
+}
 
-    // Record the index of this timestamp
-    QueriedFramesIndexes[timestamp] = QueriedFrames.size();
-    QueriedFrames.push_back(&frame);
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualTextRecognizer::QueryFrame(vtkPlusChannel* channel, igsioTrackedFrame*& frame)
+{
+  if (!channel->GetVideoDataAvailable())
+  {
+    LOG_WARNING("Processed data is not generated, as no video data is available yet. Device ID: " << this->GetDeviceId());
+    return PLUS_FAIL;
   }
-  else
+
+  this->TrackedFrames->Clear();
+  double aTimestamp(UNDEFINED_TIMESTAMP);
+  if (channel->GetTrackedFrameList(aTimestamp, this->TrackedFrames, 1) != PLUS_SUCCESS || this->TrackedFrames->GetNumberOfTrackedFrames() < 1)
   {
-    frame = (*QueriedFrames[frameIt->second]);
+    LOG_INFO("Failed to get tracked frame list from data collector.");
+    return PLUS_FAIL;
   }
 
+  // The frame is owned by the tracked frame list, so it is not copied
+  frame = this->TrackedFrames->GetTrackedFrame(0);
   return PLUS_SUCCESS;
 }
 
@@ -245,13 +296,36 @@ PlusStatus vtkPlusVirtualTextRecognizer::InternalConnect()
   ss << "TESSDATA_PREFIX=" << this->TessdataDirectory;
   vtksys::SystemTools::PutEnv(ss.str());
 
-  this->TesseractAPI = new tesseract::TessBaseAPI();
-  if (this->TesseractAPI->Init(NULL, Language.c_str(), tesseract::OEM_TESSERACT_CUBE_COMBINED) != 0)
+  // One tesseract instance per recognition thread, more threads than fields would be idle
+  size_t numberOfFields(0);
+  for (ChannelFieldListMapIterator it = this->RecognitionFields.begin(); it != this->RecognitionFields.end(); ++it)
   {
-    LOG_ERROR("Unable to init tesseract library. Cannot perform text recognition.");
-    return PLUS_FAIL;
+    numberOfFields += it->second.size();
+  }
+  size_t numberOfThreads = this->NumberOfRecognitionThreads > 0 ? static_cast<size_t>(this->NumberOfRecognitionThreads) : std::thread::hardware_concurrency();
+  numberOfThreads = std::max<size_t>(1, std::min(numberOfThreads, numberOfFields));
+
+  for (size_t i = 0; i < numberOfThreads; ++i)
+  {
+    tesseract::TessBaseAPI* tesseractAPI = new tesseract::TessBaseAPI();
+    this->TesseractAPIs.push_back(tesseractAPI);
+    if (tesseractAPI->Init(NULL, Language.c_str(), tesseract::OEM_TESSERACT_CUBE_COMBINED) != 0)
+    {
+      LOG_ERROR("Unable to init tesseract library. Cannot perform text recognition.");
+      return PLUS_FAIL;
+    }
+    tesseractAPI->SetPageSegMode(tesseract::PSM_SINGLE_LINE);
+  }
+  LOG_DEBUG("Text recognition uses " << numberOfThreads << " thread(s).");
+
+  if (this->OverloadPolicyHandlerId == 0)
+  {
+    this->OverloadPolicyHandlerId = OverloadManager::GetInstance().AddPolicyHandler(OverloadManager::POLICY_PAUSE_TEXT_RECOGNITION, [this](bool apply)
+    {
+      LOG_INFO(this->GetDeviceId() << ": Text recognition is " << (apply ? "paused because the system is overloaded" : "resumed"));
+      this->RecognitionPausedForOverload = apply;
+    });
   }
-  this->TesseractAPI->SetPageSegMode(tesseract::PSM_SINGLE_LINE);
 
   return PLUS_SUCCESS;
 }
@@ -259,8 +333,18 @@ PlusStatus vtkPlusVirtualTextRecognizer::InternalConnect()
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusVirtualTextRecognizer::InternalDisconnect()
 {
-  delete this->TesseractAPI;
-  this->TesseractAPI = NULL;
+  if (this->OverloadPolicyHandlerId != 0)
+  {
+    OverloadManager::GetInstance().RemovePolicyHandler(this->OverloadPolicyHandlerId);
+    this->OverloadPolicyHandlerId = 0;
+    this->RecognitionPausedForOverload = false;
+  }
+
+  for (std::vector<tesseract::TessBaseAPI*>::iterator it = this->TesseractAPIs.begin(); it != this->TesseractAPIs.end(); ++it)
+  {
+    delete *it;
+  }
+  this->TesseractAPIs.clear();
 
   ClearConfiguration();
 
@@ -290,6 +374,7 @@ PlusStatus vtkPlusVirtualTextRecognizer::ReadConfiguration(vtkXMLDataElement* ro
   this->SetLanguage(DEFAULT_LANGUAGE);
   XML_READ_CSTRING_ATTRIBUTE_OPTIONAL(Language, deviceConfig);
   XML_READ_STRING_ATTRIBUTE_OPTIONAL(TessdataDirectory, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfRecognitionThreads, deviceConfig);
 
   XML_FIND_NESTED_ELEMENT_OPTIONAL(screenFields, deviceConfig, PARAMETER_LIST_TAG_NAME);
  
@@ -353,6 +438,10 @@ PlusStatus vtkPlusVirtualTextRecognizer::WriteConfiguration(vtkXMLDataElement* r
   {
     XML_WRITE_STRING_ATTRIBUTE_IF_NOT_EMPTY(Language, deviceConfig);
   }
+  if (this->NumberOfRecognitionThreads > 0)
+  {
+    deviceConfig->SetIntAttribute("NumberOfRecognitionThreads", this->NumberOfRecognitionThreads);
+  }
 
   XML_FIND_NESTED_ELEMENT_CREATE_IF_MISSING(screenFields, deviceConfig, PARAMETER_LIST_TAG_NAME);
 
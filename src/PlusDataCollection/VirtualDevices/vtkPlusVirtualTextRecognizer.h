@@ -12,6 +12,8 @@ See License.txt for details.
 #include "vtkPlusChannel.h"
 #include "vtkPlusDevice.h"
 
+#include <atomic>
+
 namespace tesseract
 {
   class TessBaseAPI;
@@ -21,7 +23,11 @@ typedef struct Pix PIX;
 
 /*!
 \class vtkPlusVirtualTextRecognizer
-\brief
+\brief Recognizes text in screen regions of the input channels' video and sends it as frame fields
+
+OCR only runs on the regions whose pixels changed since their text was last recognized, so the on-screen
+parameters that rarely change cost almost nothing. Changed regions are recognized in parallel, each
+recognition thread uses its own tesseract instance.
 
 \ingroup PlusLibDataCollection
 */
@@ -45,6 +51,8 @@ public:
 
   public:
     std::string LatestParameterValue;
+    /// Pixels of the screen region when LatestParameterValue was recognized, OCR is skipped while they are unchanged
+    std::vector<unsigned char> RecognizedRegionPixels;
     PIX* ReceivedFrame;
     vtkSmartPointer<vtkImageData> ScreenRegion;
     vtkPlusChannel* SourceChannel;
@@ -93,6 +101,13 @@ public:
   vtkSetStdStringMacro(TessdataDirectory);
   vtkGetStdStringMacro(TessdataDirectory);
 
+  /*! Number of threads (and tesseract instances) recognizing the changed fields. If 0 then the number of processors is used. */
+  vtkSetMacro(NumberOfRecognitionThreads, int);
+  vtkGetMacro(NumberOfRecognitionThreads, int);
+
+  /*! Returns true if the recognition is paused by the PauseTextRecognition overload policy (see OverloadManager) */
+  bool IsRecognitionPausedForOverload() const { return this->RecognitionPausedForOverload; }
+
 #ifdef PLUS_TEST_TextRecognizer
   ChannelFieldListMap& GetRecognitionFields();
 #endif
@@ -103,26 +118,45 @@ protected:
   /// Remove any configuration data
   void ClearConfiguration();
 
-  /// Convert a vtkImage data to leptonica pix format
-  void vtkImageDataToPix(igsioTrackedFrame& frame, TextFieldParameter* parameter);
+  /// Copy the screen region of the field from the frame
+  void ClipScreenRegion(igsioTrackedFrame& frame, TextFieldParameter* parameter);
+
+  /// Returns true if the screen region differs from the one the latest value was recognized from, and stores it as the recognized region
+  bool UpdateRecognizedRegion(TextFieldParameter* parameter);
+
+  /// Convert the screen region of the field to leptonica pix format
+  void vtkImageDataToPix(TextFieldParameter* parameter);
 
-  /// If a frame has been queried for this input channel, reuse it instead of getting a new one
-  PlusStatus FindOrQueryFrame(igsioTrackedFrame& frame, std::map<double, int>& queriedFramesIndexes, TextFieldParameter* parameter,
-                              std::vector<igsioTrackedFrame*>& queriedFrames);
+  /// Recognize the text of the fields, in parallel if there are multiple tesseract instances
+  void RecognizeText(const std::vector<TextFieldParameter*>& parameters);
+
+  /// Get the latest frame of the channel, it is valid until the next query
+  PlusStatus QueryFrame(vtkPlusChannel* channel, igsioTrackedFrame*& frame);
 
   /// Language used for detection
   std::string                 Language;
 
   std::string                 TessdataDirectory;
 
-  /// Main entry point for the tesseract API
-  tesseract::TessBaseAPI*     TesseractAPI;
+  /// Main entry points for the tesseract API, one for each recognition thread
+  std::vector<tesseract::TessBaseAPI*> TesseractAPIs;
+
+  int                         NumberOfRecognitionThreads;
+
+  /// Set by the overload policy handler, the latest recognized values are kept while it is set
+  std::atomic<bool>           RecognitionPausedForOverload;
+
+  /// Identifier of the overload policy handler, 0 if not registered
+  int                         OverloadPolicyHandlerId;
 
   vtkIGSIOTrackedFrameList*    TrackedFrames;
 
   /// Map of channels to fields so that we only have to grab an image once from the each source channel
   ChannelFieldListMap         RecognitionFields;
 
+  /// Timestamp of the latest frame processed from each channel, the fields are not checked again until a new frame arrives
+  std::map<vtkPlusChannel*, double> LastProcessedTimestamps;
+
   /// Optional output channel to store recognized fields for broadcasting
   vtkPlusChannel*             OutputChannel;
 
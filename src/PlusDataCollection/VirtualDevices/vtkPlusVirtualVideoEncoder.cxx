@@ -0,0 +1,432 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusVideoEncoderPool.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataSource.h"
+#include "vtkPlusVirtualVideoEncoder.h"
+
+// IGSIO includes
+#include <igsioVideoFrame.h>
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+#include <vtkStreamingVolumeFrame.h>
+
+// STL includes
+#include <vector>
+
+namespace
+{
+  /*! Number of queued frames that are kept while waiting for their encoded frames, frames that the encoder dropped are removed sooner */
+  const size_t MAX_NUMBER_OF_QUEUED_FRAMES = 2 * (VideoEncoderPool::MAX_NUMBER_OF_WAITING_FRAMES + VideoEncoderPool::NUMBER_OF_KEPT_ENCODED_FRAMES);
+}
+
+//----------------------------------------------------------------------------
+
+vtkStandardNewMacro(vtkPlusVirtualVideoEncoder);
+
+//----------------------------------------------------------------------------
+vtkPlusVirtualVideoEncoder::vtkPlusVirtualVideoEncoder()
+  : vtkPlusDevice()
+  , CodecFourCC("VP90")
+  , LosslessEncoding(false)
+  , TargetBitRate(0)
+  , MaximumKeyFrameDistance(50)
+  , Encoders(new VideoEncoderPool)
+  , LastProcessedUid(0)
+  , LastEncodedFrameIndex(0)
+{
+  this->AcquisitionRate = vtkPlusDevice::VIRTUAL_DEVICE_FRAME_RATE;
+
+  // The data capture thread will be used to regularly queue the new frames for encoding and to add the encoded frames to the output
+  this->StartThreadForInternalUpdates = true;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusVirtualVideoEncoder::~vtkPlusVirtualVideoEncoder()
+{
+  // Stops the encoder threads
+  delete this->Encoders;
+  this->Encoders = NULL;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusVirtualVideoEncoder::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "CodecFourCC: " << this->CodecFourCC << std::endl;
+  os << indent << "LosslessEncoding: " << (this->LosslessEncoding ? "TRUE" : "FALSE") << std::endl;
+  os << indent << "TargetBitRate: " << this->TargetBitRate << std::endl;
+  os << indent << "MaximumKeyFrameDistance: " << this->MaximumKeyFrameDistance << std::endl;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualVideoEncoder::ReadConfiguration(vtkXMLDataElement* rootConfigElement)
+{
+  XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_READING(deviceConfig, rootConfigElement);
+
+  XML_READ_STRING_ATTRIBUTE_OPTIONAL(CodecFourCC, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(LosslessEncoding, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, TargetBitRate, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, MaximumKeyFrameDistance, deviceConfig);
+
+  if (this->CodecFourCC.empty())
+  {
+    LOG_ERROR("CodecFourCC must be set for vtkPlusVirtualVideoEncoder " << this->GetDeviceId());
+    return PLUS_FAIL;
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualVideoEncoder::WriteConfiguration(vtkXMLDataElement* rootConfigElement)
+{
+  XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_WRITING(deviceConfig, rootConfigElement);
+
+  deviceConfig->SetAttribute("CodecFourCC", this->CodecFourCC.c_str());
+  XML_WRITE_BOOL_ATTRIBUTE(LosslessEncoding, deviceConfig);
+  deviceConfig->SetIntAttribute("TargetBitRate", this->TargetBitRate);
+  deviceConfig->SetIntAttribute("MaximumKeyFrameDistance", this->MaximumKeyFrameDistance);
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusVirtualVideoEncoder::GetAcquisitionRate() const
+{
+  if (this->InputChannels.empty() || this->InputChannels[0]->GetOwnerDevice() == NULL)
+  {
+    return this->AcquisitionRate;
+  }
+  return this->InputChannels[0]->GetOwnerDevice()->GetAcquisitionRate();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusVirtualVideoEncoder::GetCodecParameters(std::map<std::string, std::string>& parameters) const
+{
+  // Same parameters as the ones of the VIDEO messages of the OpenIGTLink server
+  parameters.clear();
+  parameters["losslessEncoding"] = this->LosslessEncoding ? "1" : "0";
+  if (!this->LosslessEncoding && this->TargetBitRate > 0)
+  {
+    parameters["bitRate"] = igsioCommon::ToString(this->TargetBitRate);
+  }
+  if (this->MaximumKeyFrameDistance > 0)
+  {
+    parameters["minimumKeyFrameDistance"] = "1";
+    parameters["maximumKeyFrameDistance"] = igsioCommon::ToString(this->MaximumKeyFrameDistance);
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualVideoEncoder::NotifyConfigured()
+{
+  if (this->InputChannels.empty())
+  {
+    LOG_ERROR("No input channel set for vtkPlusVirtualVideoEncoder " << this->GetDeviceId());
+    this->SetCorrectlyConfigured(false);
+    return PLUS_FAIL;
+  }
+  if (this->InputChannels.size() > 1)
+  {
+    LOG_WARNING("vtkPlusVirtualVideoEncoder is expecting one input channel and there are " << this->InputChannels.size() << " channels. First input channel will be used, all other are ignored.");
+  }
+  if (this->OutputChannels.empty())
+  {
+    LOG_ERROR("No output channel set for vtkPlusVirtualVideoEncoder " << this->GetDeviceId());
+    this->SetCorrectlyConfigured(false);
+    return PLUS_FAIL;
+  }
+
+  vtkPlusChannel* inputChannel = this->InputChannels[0];
+  vtkPlusChannel* outputChannel = this->OutputChannels[0];
+  vtkPlusDataSource* inputVideo = NULL;
+  if (!inputChannel->HasVideoSource() || inputChannel->GetVideoSource(inputVideo) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Input channel " << inputChannel->GetChannelId() << " of vtkPlusVirtualVideoEncoder " << this->GetDeviceId() << " has no video source");
+    this->SetCorrectlyConfigured(false);
+    return PLUS_FAIL;
+  }
+
+  std::map<std::string, std::string> parameters;
+  this->GetCodecParameters(parameters);
+  this->EncoderKey = VideoEncoderPool::GetEncoderKey(this->GetDeviceId(), this->CodecFourCC, parameters);
+
+  // Output sources have the same IDs as the input sources. They are reused if the device is configured again.
+  int numberOfErrors(0);
+  vtkPlusDataSource* outputVideo = NULL;
+  if (this->GetVideoSource(inputVideo->GetId().c_str(), outputVideo) != PLUS_SUCCESS)
+  {
+    vtkSmartPointer<vtkPlusDataSource> aDataSource = vtkSmartPointer<vtkPlusDataSource>::New();
+    aDataSource->SetId(inputVideo->GetId());
+    aDataSource->SetType(DATA_SOURCE_TYPE_VIDEO);
+    aDataSource->SetBufferSize(inputVideo->GetBufferSize());
+    // Encoded frames are not reoriented
+    aDataSource->SetInputImageOrientation(inputVideo->GetOutputImageOrientation());
+    aDataSource->SetOutputImageOrientation(inputVideo->GetOutputImageOrientation());
+    if (this->AddVideoSource(aDataSource) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Unable to add video source " << inputVideo->GetId() << " to device " << this->GetDeviceId());
+      numberOfErrors++;
+    }
+    outputVideo = aDataSource;
+  }
+  outputChannel->SetVideoSource(outputVideo);
+
+  for (DataSourceContainerConstIterator it = inputChannel->GetToolsStartConstIterator(); it != inputChannel->GetToolsEndConstIterator(); ++it)
+  {
+    vtkPlusDataSource* inputTool = it->second;
+    vtkPlusDataSource* outputTool = NULL;
+    if (this->GetTool(inputTool->GetId(), outputTool) != PLUS_SUCCESS)
+    {
+      vtkSmartPointer<vtkPlusDataSource> aDataSource = vtkSmartPointer<vtkPlusDataSource>::New();
+      aDataSource->SetId(inputTool->GetId());
+      aDataSource->SetType(DATA_SOURCE_TYPE_TOOL);
+      aDataSource->SetReferenceCoordinateFrameName(inputTool->GetReferenceCoordinateFrameName());
+      aDataSource->SetBufferSize(inputTool->GetBufferSize());
+      if (this->AddTool(aDataSource, false) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Unable to add tool " << inputTool->GetId() << " to device " << this->GetDeviceId());
+        numberOfErrors++;
+        continue;
+      }
+      outputTool = aDataSource;
+    }
+    vtkPlusDataSource* existingTool = NULL;
+    if (outputChannel->GetTool(existingTool, outputTool->GetId()) != PLUS_SUCCESS)
+    {
+      outputChannel->AddTool(outputTool);
+    }
+  }
+
+  for (DataSourceContainerConstIterator it = inputChannel->GetFieldDataSourcesStartConstIterator(); it != inputChannel->GetFieldDataSourcesEndConstIterator(); ++it)
+  {
+    vtkPlusDataSource* inputFieldSource = it->second;
+    vtkPlusDataSource* outputFieldSource = NULL;
+    if (this->GetFieldDataSource(inputFieldSource->GetId(), outputFieldSource) != PLUS_SUCCESS)
+    {
+      vtkSmartPointer<vtkPlusDataSource> aDataSource = vtkSmartPointer<vtkPlusDataSource>::New();
+      aDataSource->SetId(inputFieldSource->GetId());
+      aDataSource->SetType(DATA_SOURCE_TYPE_FIELDDATA);
+      aDataSource->SetBufferSize(inputFieldSource->GetBufferSize());
+      if (this->AddFieldDataSource(aDataSource) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Unable to add field data source " << inputFieldSource->GetId() << " to device " << this->GetDeviceId());
+        numberOfErrors++;
+        continue;
+      }
+      outputFieldSource = aDataSource;
+    }
+    vtkPlusDataSource* existingFieldSource = NULL;
+    if (outputChannel->GetFieldDataSource(existingFieldSource, outputFieldSource->GetId()) != PLUS_SUCCESS)
+    {
+      outputChannel->AddFieldDataSource(outputFieldSource);
+    }
+  }
+
+  if (numberOfErrors > 0)
+  {
+    this->SetCorrectlyConfigured(false);
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualVideoEncoder::InternalStartRecording()
+{
+  // Frames acquired before the recording started are not encoded, the output starts with the next key frame
+  this->LastProcessedUid = 0;
+  this->LastEncodedFrameIndex = 0;
+  this->QueuedFrames.clear();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualVideoEncoder::InternalUpdate()
+{
+  vtkPlusDataSource* inputVideo = NULL;
+  if (this->InputChannels.empty() || this->InputChannels[0]->GetVideoSource(inputVideo) != PLUS_SUCCESS || inputVideo->GetNumberOfItems() < 1)
+  {
+    // No input data yet
+    return PLUS_SUCCESS;
+  }
+
+  int numberOfErrors(0);
+
+  // Queue the new input frames for encoding
+  BufferItemUidType latestUid = inputVideo->GetLatestItemUidInBuffer();
+  BufferItemUidType uid = inputVideo->GetOldestItemUidInBuffer();
+  if (this->LastProcessedUid == 0)
+  {
+    // Start with the most recent frame
+    uid = latestUid;
+  }
+  else if (this->LastProcessedUid + 1 > uid)
+  {
+    uid = this->LastProcessedUid + 1;
+  }
+  std::map<std::string, std::string> parameters;
+  this->GetCodecParameters(parameters);
+  vtkSmartPointer<vtkMatrix4x4> identityMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  for (; uid <= latestUid; ++uid)
+  {
+    this->LastProcessedUid = uid;
+    StreamBufferItem videoItem;
+    if (inputVideo->GetStreamBufferItem(uid, &videoItem, true /* share image data */) != ITEM_OK)
+    {
+      // The item has just been overwritten in the input buffer
+      continue;
+    }
+    igsioVideoFrame& frame = videoItem.GetFrame();
+    if (!frame.IsImageValid() || frame.IsFrameEncoded())
+    {
+      continue;
+    }
+
+    QueuedFrame queuedFrame;
+    queuedFrame.Timestamp = videoItem.GetFilteredTimestamp(inputVideo->GetLocalTimeOffsetSec());
+    videoItem.GetFrameFields().GetFieldMap(queuedFrame.CustomFields);
+    queuedFrame.ImageType = frame.GetImageType();
+    queuedFrame.ImageOrientation = frame.GetImageOrientation();
+    queuedFrame.PixelType = frame.GetVTKScalarPixelType();
+    queuedFrame.NumberOfScalarComponents = 1;
+    frame.GetNumberOfScalarComponents(queuedFrame.NumberOfScalarComponents);
+
+    // The encoded frame is matched to the queued frame by its timestamp
+    if (this->Encoders->EncodeFrame(this->EncoderKey, frame, queuedFrame.Timestamp, this->GetDeviceId(), *identityMatrix, this->CodecFourCC, parameters) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Virtual video encoder " << this->GetDeviceId() << " failed to queue frame for encoding at " << std::fixed << queuedFrame.Timestamp);
+      numberOfErrors++;
+      continue;
+    }
+    this->QueuedFrames.push_back(queuedFrame);
+    while (this->QueuedFrames.size() > MAX_NUMBER_OF_QUEUED_FRAMES)
+    {
+      this->QueuedFrames.pop_front();
+    }
+  }
+
+  // Add the frames that have been encoded since the last update, starting from a key frame
+  std::vector<VideoEncoderPool::EncodedFrame> encodedFrames;
+  this->Encoders->GetEncodedFrames(this->EncoderKey, this->LastEncodedFrameIndex, encodedFrames);
+  for (std::vector<VideoEncoderPool::EncodedFrame>::iterator frameIt = encodedFrames.begin(); frameIt != encodedFrames.end(); ++frameIt)
+  {
+    if (this->AddEncodedFrame(frameIt->Frame, frameIt->Timestamp) != PLUS_SUCCESS)
+    {
+      numberOfErrors++;
+    }
+  }
+
+  return numberOfErrors == 0 ? PLUS_SUCCESS : PLUS_FAIL;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualVideoEncoder::AddEncodedFrame(vtkStreamingVolumeFrame* encodedFrame, double timestamp)
+{
+  // Frames that were dropped by the encoder have no encoded frame, forget them
+  while (!this->QueuedFrames.empty() && this->QueuedFrames.front().Timestamp < timestamp)
+  {
+    this->QueuedFrames.pop_front();
+  }
+  if (this->QueuedFrames.empty() || this->QueuedFrames.front().Timestamp != timestamp)
+  {
+    LOG_WARNING("Virtual video encoder " << this->GetDeviceId() << " cannot find the input frame of the encoded frame at " << std::fixed << timestamp);
+    return PLUS_SUCCESS;
+  }
+  QueuedFrame queuedFrame = this->QueuedFrames.front();
+  this->QueuedFrames.pop_front();
+
+  vtkPlusDataSource* outputVideo = NULL;
+  if (this->OutputChannels[0]->GetVideoSource(outputVideo) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Virtual video encoder " << this->GetDeviceId() << " has no output video source");
+    return PLUS_FAIL;
+  }
+
+  // Generate unique frame number (not used for filtering, the input timestamp is used as is)
+  this->FrameNumber++;
+  int numberOfErrors(0);
+
+  // The output buffer takes the format of the input frames
+  int dimensions[3] = { 0, 0, 0 };
+  encodedFrame->GetDimensions(dimensions);
+  FrameSizeType frameSize = { static_cast<unsigned int>(dimensions[0]), static_cast<unsigned int>(dimensions[1]), static_cast<unsigned int>(dimensions[2]) };
+  if (outputVideo->GetNumberOfItems() == 0 || outputVideo->GetInputFrameSize() != frameSize || outputVideo->GetPixelType() != queuedFrame.PixelType
+      || outputVideo->GetNumberOfScalarComponents() != queuedFrame.NumberOfScalarComponents || outputVideo->GetImageType() != queuedFrame.ImageType)
+  {
+    outputVideo->SetPixelType(queuedFrame.PixelType);
+    outputVideo->SetNumberOfScalarComponents(queuedFrame.NumberOfScalarComponents);
+    outputVideo->SetImageType(queuedFrame.ImageType);
+    outputVideo->SetInputFrameSize(frameSize);
+  }
+
+  igsioVideoFrame frame;
+  frame.SetImageType(queuedFrame.ImageType);
+  frame.SetImageOrientation(queuedFrame.ImageOrientation);
+  frame.SetEncodedFrame(encodedFrame);
+  if (outputVideo->AddItem(&frame, this->FrameNumber, timestamp, timestamp, &queuedFrame.CustomFields) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Virtual video encoder " << this->GetDeviceId() << " failed to add encoded frame at " << std::fixed << timestamp);
+    numberOfErrors++;
+  }
+
+  // Interpolate all tools at the frame time in one pass
+  vtkPlusChannel* inputChannel = this->InputChannels[0];
+  std::vector<vtkPlusChannel::ToolTransform> toolTransforms;
+  inputChannel->GetInterpolatedToolTransforms(timestamp, toolTransforms);
+  if (!toolTransforms.empty())
+  {
+    std::vector< vtkSmartPointer<vtkMatrix4x4> > matrices(toolTransforms.size());
+    ToolTimeStampedItemList items;
+    items.reserve(toolTransforms.size());
+    for (size_t toolIndex = 0; toolIndex < toolTransforms.size(); ++toolIndex)
+    {
+      const vtkPlusChannel::ToolTransform& toolTransform = toolTransforms[toolIndex];
+      matrices[toolIndex] = vtkSmartPointer<vtkMatrix4x4>::New();
+      ToolStatus toolStatus = TOOL_MISSING;
+      if (toolTransform.Result == ITEM_OK)
+      {
+        matrices[toolIndex]->DeepCopy(toolTransform.Sample.Matrix);
+        toolStatus = toolTransform.Sample.Status;
+      }
+      items.push_back(ToolTimeStampedItem(toolTransform.Tool->GetId(), matrices[toolIndex], toolStatus, this->FrameNumber));
+    }
+    if (this->AddTimeStampedItems(items, timestamp, timestamp) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Virtual video encoder " << this->GetDeviceId() << " failed to add tool transforms at " << std::fixed << timestamp);
+      numberOfErrors++;
+    }
+  }
+
+  for (DataSourceContainerConstIterator it = inputChannel->GetFieldDataSourcesStartConstIterator(); it != inputChannel->GetFieldDataSourcesEndConstIterator(); ++it)
+  {
+    vtkPlusDataSource* inputFieldSource = it->second;
+    vtkPlusDataSource* outputFieldSource = NULL;
+    StreamBufferItem fieldItem;
+    if (this->GetFieldDataSource(inputFieldSource->GetId(), outputFieldSource) != PLUS_SUCCESS
+        || inputFieldSource->GetStreamBufferItemFromTime(timestamp, &fieldItem, vtkPlusBuffer::CLOSEST_TIME) != ITEM_OK)
+    {
+      // Field data is optional, it may not be available yet
+      continue;
+    }
+    igsioFieldMapType fields;
+    fieldItem.GetFrameFields().GetFieldMap(fields);
+    if (outputFieldSource->AddItem(fields, this->FrameNumber, timestamp, timestamp) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Virtual video encoder " << this->GetDeviceId() << " failed to add field data of " << inputFieldSource->GetId() << " at " << std::fixed << timestamp);
+      numberOfErrors++;
+    }
+  }
+
+  return numberOfErrors == 0 ? PLUS_SUCCESS : PLUS_FAIL;
+}
@@ -0,0 +1,121 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusVirtualVideoEncoder_h
+#define __vtkPlusVirtualVideoEncoder_h
+
+#include "vtkPlusDataCollectionExport.h"
+
+#include "vtkPlusDevice.h"
+
+#include <deque>
+#include <map>
+#include <string>
+
+class VideoEncoderPool;
+class vtkPlusDataSource;
+class vtkStreamingVolumeFrame;
+
+/*!
+\class vtkPlusVirtualVideoEncoder
+\brief Encodes the video of the input channel once and publishes the encoded frames in its output channel
+
+Frames of the input channel are encoded with the CodecFourCC codec on an encoder thread (see VideoEncoderPool) and the encoded
+frames are added to the video source of the output channel, with the timestamp and the fields of the input frame. The tools
+and field data of the input channel are added to the output channel, too. The output channel starts with a key frame.
+
+The OpenIGTLink server sends the encoded frames in VIDEO messages without encoding them again (if the requested codec matches
+or no codec is requested), and vtkPlusVirtualCapture writes them to encoded video files without encoding them again,
+so a stream that is sent to several clients and recorded is encoded only once.
+
+Encoding is not guaranteed to keep up with the acquisition: if the encoder is behind then the oldest frames that are waiting
+for encoding are dropped. Encoded frames are available in the output buffer with a delay of about one frame.
+
+\ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport vtkPlusVirtualVideoEncoder : public vtkPlusDevice
+{
+public:
+  static vtkPlusVirtualVideoEncoder* New();
+  vtkTypeMacro(vtkPlusVirtualVideoEncoder, vtkPlusDevice);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  virtual bool IsTracker() const { return false; }
+  virtual bool IsVirtual() const { return true; }
+
+  /*! Read configuration from xml data */
+  virtual PlusStatus ReadConfiguration(vtkXMLDataElement*);
+
+  /*! Write configuration to xml data */
+  virtual PlusStatus WriteConfiguration(vtkXMLDataElement*);
+
+  /*! Create the output sources from the sources of the input channel */
+  virtual PlusStatus NotifyConfigured();
+
+  /*! Frame rate of the output channel, which is the frame rate of the input channel */
+  virtual double GetAcquisitionRate() const;
+
+  /*! FourCC of the codec, e.g. VP90 or H264 */
+  vtkGetStdStringMacro(CodecFourCC);
+  vtkSetStdStringMacro(CodecFourCC);
+
+  vtkGetMacro(LosslessEncoding, bool);
+  vtkSetMacro(LosslessEncoding, bool);
+
+  /*! Target bit rate of lossy encoding in bits per second, codec default if 0 */
+  vtkGetMacro(TargetBitRate, int);
+  vtkSetMacro(TargetBitRate, int);
+
+  /*! Maximum number of frames between key frames, codec default if 0. Clients can start decoding the output at key frames. */
+  vtkGetMacro(MaximumKeyFrameDistance, int);
+  vtkSetMacro(MaximumKeyFrameDistance, int);
+
+protected:
+  vtkPlusVirtualVideoEncoder();
+  virtual ~vtkPlusVirtualVideoEncoder();
+
+  virtual PlusStatus InternalUpdate();
+
+  virtual PlusStatus InternalStartRecording();
+
+  /*! Get the codec parameters from the configuration */
+  void GetCodecParameters(std::map<std::string, std::string>& parameters) const;
+
+  /*! Add the encoded frame, the tool transforms and the field data at its timestamp to the output sources */
+  PlusStatus AddEncodedFrame(vtkStreamingVolumeFrame* encodedFrame, double timestamp);
+
+  std::string CodecFourCC;
+  bool LosslessEncoding;
+  int TargetBitRate;
+  int MaximumKeyFrameDistance;
+
+  /*! Input frame information that is not stored in the encoded frame */
+  struct QueuedFrame
+  {
+    double Timestamp;
+    igsioFieldMapType CustomFields;
+    US_IMAGE_TYPE ImageType;
+    US_IMAGE_ORIENTATION ImageOrientation;
+    igsioCommon::VTKScalarPixelType PixelType;
+    unsigned int NumberOfScalarComponents;
+  };
+  /*! Frames that have been queued for encoding, in acquisition order */
+  std::deque<QueuedFrame> QueuedFrames;
+
+  VideoEncoderPool* Encoders;
+  std::string EncoderKey;
+
+  /*! UID of the last processed item of the input video source, 0 if none */
+  BufferItemUidType LastProcessedUid;
+  /*! Index of the last encoded frame that was added to the output, 0 if none */
+  unsigned long LastEncodedFrameIndex;
+
+private:
+  vtkPlusVirtualVideoEncoder(const vtkPlusVirtualVideoEncoder&);  // Not implemented.
+  void operator=(const vtkPlusVirtualVideoEncoder&);  // Not implemented.
+};
+
+#endif
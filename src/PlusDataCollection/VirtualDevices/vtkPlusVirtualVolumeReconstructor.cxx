@@ -5,22 +5,75 @@ See License.txt for details.
 =========================================================Plus=header=end*/
 
 #include "PlusConfigure.h"
+#include "PlusOverloadManager.h"
 #include "igsioTrackedFrame.h"
 #include "vtkObjectFactory.h"
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataSource.h"
 #include "vtkPlusSequenceIO.h"
+#include "vtkIGSIOAccurateTimer.h"
 #include "vtkIGSIOTrackedFrameList.h"
 #include "vtkIGSIOTransformRepository.h"
 #include "vtkPlusVirtualVolumeReconstructor.h"
+#include "vtkPlusVolumeFileWriter.h"
 #include "vtkPlusVolumeReconstructor.h"
+#include "vtkImageClip.h"
+#include "vtkImageData.h"
+#include "vtkMatrix4x4.h"
 #include "vtksys/SystemTools.hxx"
 
+#include <algorithm>
+#include <limits>
+
 //----------------------------------------------------------------------------
 
 vtkStandardNewMacro(vtkPlusVirtualVolumeReconstructor);
 
 static const int MAX_ALLOWED_RECONSTRUCTION_LAG_SEC = 3.0; // if the reconstruction lags more than this then it'll skip frames to catch up
+static const std::string RECONSTRUCTED_VOLUME_IMAGE_ID = "Volume"; // image id of the reconstructed volume in GET_IMGMETA and GET_IMAGE replies
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  /*! Set each voxel of the region of the coarse volume to the mean of the corresponding 2x2x2 voxels of the fine volume */
+  template <class T>
+  void DownsampleRegion(vtkImageData* fineVolume, vtkImageData* coarseVolume, const int coarseRegion[6])
+  {
+    int* fineExtent = fineVolume->GetExtent();
+    vtkIdType fineIncrements[3] = { 0, 0, 0 };
+    fineVolume->GetIncrements(fineIncrements);
+    for (int z = coarseRegion[4]; z <= coarseRegion[5]; z++)
+    {
+      int fineZ = fineExtent[4] + 2 * z;
+      int numberOfFineZ = std::min(2, fineExtent[5] - fineZ + 1);
+      for (int y = coarseRegion[2]; y <= coarseRegion[3]; y++)
+      {
+        int fineY = fineExtent[2] + 2 * y;
+        int numberOfFineY = std::min(2, fineExtent[3] - fineY + 1);
+        T* coarseVoxel = static_cast<T*>(coarseVolume->GetScalarPointer(coarseRegion[0], y, z));
+        for (int x = coarseRegion[0]; x <= coarseRegion[1]; x++, coarseVoxel++)
+        {
+          int fineX = fineExtent[0] + 2 * x;
+          int numberOfFineX = std::min(2, fineExtent[1] - fineX + 1);
+          const T* fineVoxel = static_cast<T*>(fineVolume->GetScalarPointer(fineX, fineY, fineZ));
+          double sum = 0.0;
+          for (int dz = 0; dz < numberOfFineZ; dz++)
+          {
+            for (int dy = 0; dy < numberOfFineY; dy++)
+            {
+              for (int dx = 0; dx < numberOfFineX; dx++)
+              {
+                sum += fineVoxel[dx * fineIncrements[0] + dy * fineIncrements[1] + dz * fineIncrements[2]];
+              }
+            }
+          }
+          double mean = sum / (numberOfFineX * numberOfFineY * numberOfFineZ);
+          *coarseVoxel = static_cast<T>(std::numeric_limits<T>::is_integer ? floor(mean + 0.5) : mean);
+        }
+      }
+    }
+  }
+}
 
 //----------------------------------------------------------------------------
 vtkPlusVirtualVolumeReconstructor::vtkPlusVirtualVolumeReconstructor()
@@ -33,18 +86,40 @@ vtkPlusVirtualVolumeReconstructor::vtkPlusVirtualVolumeReconstructor()
   , m_LastUpdateTime(0.0)
   , TotalFramesRecorded(0)
   , EnableReconstruction(false)
+  , IncrementalSnapshot(true)
+  , StreamInputSequence(false)
+  , SnapshotBrickSizeVoxels(32)
+  , SnapshotHoleFillingMarginVoxels(8)
+  , NumberOfPreviewLevels(2)
+  , BackgroundVolumeSaving(false)
+  , OverloadSnapshotIntervalSec(5.0)
+  , SnapshotRateReducedForOverload(false)
+  , OverloadPolicyHandlerId(0)
+  , SnapshotHoleFilled(false)
+  , VolumeContentVersion(0)
+  , PublishedVolumeContentVersion(0)
+  , PublishedVolumeTime(0.0)
+  , FileReconstructionInProgress(false)
+  , FileReconstructionSuspended(false)
+  , FileReconstructionCancelRequested(false)
   , VolumeReconstructorAccessMutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
 {
+  this->SnapshotBrickCount[0] = 0;
+  this->SnapshotBrickCount[1] = 0;
+  this->SnapshotBrickCount[2] = 0;
+
   // The data capture thread will be used to regularly read the frames and write to disk
   this->StartThreadForInternalUpdates = true;
 
   this->VolumeReconstructor = vtkSmartPointer<vtkPlusVolumeReconstructor>::New();
   this->TransformRepository = vtkSmartPointer<vtkIGSIOTransformRepository>::New();
+  this->VolumeFileWriter = vtkSmartPointer<vtkPlusVolumeFileWriter>::New();
 }
 
 //----------------------------------------------------------------------------
 vtkPlusVirtualVolumeReconstructor::~vtkPlusVirtualVolumeReconstructor()
 {
+  this->StopReconstructionFromFile();
 }
 
 //----------------------------------------------------------------------------
@@ -61,9 +136,17 @@ PlusStatus vtkPlusVirtualVolumeReconstructor::ReadConfiguration(vtkXMLDataElemen
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(EnableReconstruction, deviceConfig);
   XML_READ_CSTRING_ATTRIBUTE_OPTIONAL(OutputVolFilename, deviceConfig);
   XML_READ_CSTRING_ATTRIBUTE_OPTIONAL(OutputVolDeviceName, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(IncrementalSnapshot, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(StreamInputSequence, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, SnapshotBrickSizeVoxels, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, SnapshotHoleFillingMarginVoxels, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, OverloadSnapshotIntervalSec, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfPreviewLevels, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(BackgroundVolumeSaving, deviceConfig);
 
   igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
   this->VolumeReconstructor->ReadConfiguration(deviceConfig);
+  this->InvalidateSnapshot();
 
   return PLUS_SUCCESS;
 }
@@ -77,6 +160,13 @@ PlusStatus vtkPlusVirtualVolumeReconstructor::WriteConfiguration(vtkXMLDataEleme
 
   deviceElement->SetAttribute("OutputVolFilename", this->OutputVolFilename.c_str());
   deviceElement->SetAttribute("OutputVolDeviceName", this->OutputVolDeviceName.c_str());
+  XML_WRITE_BOOL_ATTRIBUTE(IncrementalSnapshot, deviceElement);
+  XML_WRITE_BOOL_ATTRIBUTE(StreamInputSequence, deviceElement);
+  deviceElement->SetIntAttribute("SnapshotBrickSizeVoxels", this->SnapshotBrickSizeVoxels);
+  deviceElement->SetIntAttribute("SnapshotHoleFillingMarginVoxels", this->SnapshotHoleFillingMarginVoxels);
+  deviceElement->SetDoubleAttribute("OverloadSnapshotIntervalSec", this->OverloadSnapshotIntervalSec);
+  deviceElement->SetIntAttribute("NumberOfPreviewLevels", this->NumberOfPreviewLevels);
+  XML_WRITE_BOOL_ATTRIBUTE(BackgroundVolumeSaving, deviceElement);
 
   igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
   this->VolumeReconstructor->WriteConfiguration(deviceElement);
@@ -109,13 +199,36 @@ PlusStatus vtkPlusVirtualVolumeReconstructor::InternalConnect()
 
   m_LastUpdateTime = vtkIGSIOAccurateTimer::GetSystemTime();
 
+  if (this->OverloadPolicyHandlerId == 0)
+  {
+    this->OverloadPolicyHandlerId = OverloadManager::GetInstance().AddPolicyHandler(OverloadManager::POLICY_REDUCE_PREVIEW_RECONSTRUCTION, [this](bool apply)
+    {
+      if (apply)
+      {
+        LOG_INFO(this->GetDeviceId() << ": System is overloaded, reconstructed volume snapshots are extracted at most every " << this->OverloadSnapshotIntervalSec << " sec");
+      }
+      else
+      {
+        LOG_INFO(this->GetDeviceId() << ": Reconstructed volume snapshots are extracted on each request again");
+      }
+      this->SnapshotRateReducedForOverload = apply;
+    });
+  }
+
   return PLUS_SUCCESS;
 }
 
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusVirtualVolumeReconstructor::InternalDisconnect()
 {
+  if (this->OverloadPolicyHandlerId != 0)
+  {
+    OverloadManager::GetInstance().RemovePolicyHandler(this->OverloadPolicyHandlerId);
+    this->OverloadPolicyHandlerId = 0;
+    this->SnapshotRateReducedForOverload = false;
+  }
   SetEnableReconstruction(false);
+  this->StopReconstructionFromFile();
   return PLUS_SUCCESS;
 }
 
@@ -269,6 +382,7 @@ PlusStatus vtkPlusVirtualVolumeReconstructor::Reset()
 {
   igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
   this->VolumeReconstructor->Reset();
+  this->InvalidateSnapshot();
   return PLUS_SUCCESS;
 }
 
@@ -308,6 +422,32 @@ PlusStatus vtkPlusVirtualVolumeReconstructor::GetReconstructedVolumeFromFile(con
     LOG_INFO(errorMessage);
     return PLUS_FAIL;
   }
+
+  if (this->StreamInputSequence)
+  {
+    // Frames are read while they are pasted, the sequence is not loaded into memory
+    std::string inputImageSeqFileFullPath = vtkPlusConfig::GetInstance()->GetOutputPath(inputSeqFilename);
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
+    this->InvalidateSnapshot();
+    std::string errorDetail;
+    int numberOfFrames = 0;
+    int numberOfFramesAddedToVolume = 0;
+    if (this->VolumeReconstructor->ReconstructFromSequenceFile(inputImageSeqFileFullPath, this->TransformRepository, true, errorDetail,
+        &numberOfFramesAddedToVolume, &numberOfFrames) != PLUS_SUCCESS)
+    {
+      errorMessage = "Volume reconstruction failed from file " + inputImageSeqFileFullPath + " - " + errorDetail;
+      LOG_INFO(errorMessage);
+      return PLUS_FAIL;
+    }
+    LOG_DEBUG("Number of frames added to the volume: " << numberOfFramesAddedToVolume << " out of " << numberOfFrames);
+    if (GetReconstructedVolume(reconstructedVolume, errorMessage) != PLUS_SUCCESS)
+    {
+      LOG_INFO(errorMessage);
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
   vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
   std::string inputImageSeqFileFullPath = vtkPlusConfig::GetInstance()->GetOutputPath(inputSeqFilename);
   if (vtkPlusSequenceIO::Read(inputImageSeqFileFullPath, trackedFrameList) != PLUS_SUCCESS)
@@ -327,6 +467,7 @@ PlusStatus vtkPlusVirtualVolumeReconstructor::GetReconstructedVolumeFromFile(con
     LOG_INFO(errorMessage);
     return PLUS_FAIL;
   }
+  this->InvalidateSnapshot();
   // Paste slices
   if (AddFrames(trackedFrameList) != PLUS_SUCCESS)
   {
@@ -344,27 +485,586 @@ PlusStatus vtkPlusVirtualVolumeReconstructor::GetReconstructedVolumeFromFile(con
 }
 
 //-----------------------------------------------------------------------------
-PlusStatus vtkPlusVirtualVolumeReconstructor::GetReconstructedVolume(vtkImageData* reconstructedVolume, std::string& outErrorMessage, bool applyHoleFilling/*=true*/)
+PlusStatus vtkPlusVirtualVolumeReconstructor::StartReconstructionFromFile(const std::string& inputSeqFilename, double progressIntervalSec,
+    const FileReconstructionProgressCallback& progressCallback, const FileReconstructionCompletedCallback& completedCallback, std::string& errorMessage)
+{
+  errorMessage.clear();
+  if (inputSeqFilename.empty())
+  {
+    errorMessage = "Volume reconstruction failed, InputSeqFilename has not been defined";
+    LOG_INFO(errorMessage);
+    return PLUS_FAIL;
+  }
+  if (this->EnableReconstruction)
+  {
+    errorMessage = "Volume reconstruction failed, live volume reconstruction is in progress";
+    LOG_INFO(errorMessage);
+    return PLUS_FAIL;
+  }
+
+  std::lock_guard<std::mutex> threadLock(this->FileReconstructionThreadMutex);
+  if (this->FileReconstructionInProgress)
+  {
+    errorMessage = "Volume reconstruction failed, reconstruction from file is already in progress";
+    LOG_INFO(errorMessage);
+    return PLUS_FAIL;
+  }
+  if (this->FileReconstructionThread.joinable())
+  {
+    // the previous reconstruction is completed, its thread is just not joined yet
+    this->FileReconstructionThread.join();
+  }
+  this->FileReconstructionInProgress = true;
+  this->FileReconstructionSuspended = false;
+  this->FileReconstructionCancelRequested = false;
+  std::string inputSeqFileFullPath = vtkPlusConfig::GetInstance()->GetOutputPath(inputSeqFilename);
+  LOG_INFO("Volume reconstruction from file started in the background: " << inputSeqFileFullPath);
+  this->FileReconstructionThread = std::thread(&vtkPlusVirtualVolumeReconstructor::ReconstructFromFileThread, this, inputSeqFileFullPath,
+                                   progressIntervalSec, progressCallback, completedCallback);
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualVolumeReconstructor::ReconstructFromFileThread(std::string inputSeqFileFullPath, double progressIntervalSec,
+    FileReconstructionProgressCallback progressCallback, FileReconstructionCompletedCallback completedCallback)
+{
+  double lastProgressTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  vtkPlusVolumeReconstructor::SequenceProgressCallback chunkPasted = [&](int numberOfProcessedFrames, int numberOfFrames) -> bool
+  {
+    // The volume is only locked while a chunk is pasted, snapshot requests are served in between.
+    // Pasting does not mark the modified bricks, so the next snapshot is extracted from the whole volume.
+    this->InvalidateSnapshot();
+    this->VolumeReconstructorAccessMutex->Unlock();
+    while (this->FileReconstructionSuspended && !this->FileReconstructionCancelRequested)
+    {
+      vtkIGSIOAccurateTimer::Delay(0.05);
+    }
+    double currentTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    if (progressCallback && !this->FileReconstructionCancelRequested && numberOfProcessedFrames < numberOfFrames
+        && currentTime - lastProgressTime >= progressIntervalSec)
+    {
+      lastProgressTime = currentTime;
+      progressCallback(numberOfProcessedFrames, numberOfFrames);
+    }
+    this->VolumeReconstructorAccessMutex->Lock();
+    return !this->FileReconstructionCancelRequested;
+  };
+
+  std::string errorDetail;
+  int numberOfFrames = 0;
+  int numberOfFramesAddedToVolume = 0;
+  this->VolumeReconstructorAccessMutex->Lock();
+  this->InvalidateSnapshot();
+  PlusStatus status = this->VolumeReconstructor->ReconstructFromSequenceFile(inputSeqFileFullPath, this->TransformRepository, true, errorDetail,
+                      &numberOfFramesAddedToVolume, &numberOfFrames, chunkPasted);
+  this->InvalidateSnapshot();
+  this->VolumeReconstructorAccessMutex->Unlock();
+
+  std::string errorMessage;
+  if (status == PLUS_SUCCESS)
+  {
+    LOG_INFO("Volume reconstruction from file completed: " << inputSeqFileFullPath << ", frames added to the volume: " << numberOfFramesAddedToVolume << " out of " << numberOfFrames);
+  }
+  else
+  {
+    errorMessage = "Volume reconstruction failed from file " + inputSeqFileFullPath + " - " + errorDetail;
+    LOG_INFO(errorMessage);
+  }
+  if (completedCallback)
+  {
+    completedCallback(status, errorMessage);
+  }
+  this->FileReconstructionInProgress = false;
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualVolumeReconstructor::CancelReconstructionFromFile()
+{
+  if (this->FileReconstructionInProgress)
+  {
+    LOG_INFO("Volume reconstruction from file cancellation requested, device: " << this->GetDeviceId());
+    this->FileReconstructionCancelRequested = true;
+  }
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualVolumeReconstructor::SetReconstructionFromFileSuspended(bool suspended)
+{
+  this->FileReconstructionSuspended = suspended;
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualVolumeReconstructor::StopReconstructionFromFile()
+{
+  std::lock_guard<std::mutex> threadLock(this->FileReconstructionThreadMutex);
+  this->FileReconstructionCancelRequested = true;
+  if (this->FileReconstructionThread.joinable())
+  {
+    this->FileReconstructionThread.join();
+  }
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualVolumeReconstructor::GetReconstructedVolume(vtkImageData* reconstructedVolume, std::string& outErrorMessage, bool applyHoleFilling/*=true*/, bool modifiedRegionOnly/*=false*/,
+    int previewLevel/*=0*/)
 {
   outErrorMessage.clear();
+  if (previewLevel < 0 || previewLevel > this->NumberOfPreviewLevels)
+  {
+    outErrorMessage = "Invalid preview level " + igsioCommon::ToString<int>(previewLevel) + ", it must be between 0 and " + igsioCommon::ToString<int>(this->NumberOfPreviewLevels);
+    LOG_ERROR(outErrorMessage);
+    return PLUS_FAIL;
+  }
   igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
-  bool oldFillHoles = this->VolumeReconstructor->GetFillHoles();
-  if (!applyHoleFilling)
+
+  bool holeFilling = applyHoleFilling && this->VolumeReconstructor->GetFillHoles();
+  int modifiedExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  vtkSmartPointer<vtkImageData> snapshot = this->Snapshot;
+
+  // The snapshot can be updated if it was extracted with the same settings
+  bool snapshotValid = this->IncrementalSnapshot && snapshot != NULL && this->SnapshotHoleFilled == holeFilling;
+  if (snapshotValid)
+  {
+    int* snapshotExtent = snapshot->GetExtent();
+    for (int axis = 0; axis < 3; axis++)
+    {
+      int snapshotSizeVoxels = snapshotExtent[axis * 2 + 1] - snapshotExtent[axis * 2] + 1;
+      if (this->SnapshotBrickCount[axis] != (snapshotSizeVoxels + this->SnapshotBrickSizeVoxels - 1) / this->SnapshotBrickSizeVoxels)
+      {
+        // brick size has been changed
+        snapshotValid = false;
+      }
+    }
+  }
+
+  if (snapshotValid)
+  {
+    if (this->UpdateSnapshot(holeFilling, modifiedExtent) != PLUS_SUCCESS)
+    {
+      this->InvalidateSnapshot();
+      outErrorMessage = "Updating modified bricks of the reconstructed volume snapshot failed";
+      LOG_ERROR(outErrorMessage);
+      return PLUS_FAIL;
+    }
+  }
+  else
+  {
+    snapshot = vtkSmartPointer<vtkImageData>::New();
+    bool oldFillHoles = this->VolumeReconstructor->GetFillHoles();
+    if (!applyHoleFilling)
+    {
+      this->VolumeReconstructor->SetFillHoles(false);
+    }
+    PlusStatus status = this->VolumeReconstructor->ExtractGrayLevels(snapshot);
+    if (!applyHoleFilling)
+    {
+      this->VolumeReconstructor->SetFillHoles(oldFillHoles);
+    }
+
+    if (status != PLUS_SUCCESS)
+    {
+      this->InvalidateSnapshot();
+      outErrorMessage = "Extracting gray levels failed";
+      LOG_ERROR(outErrorMessage);
+      return PLUS_FAIL;
+    }
+    snapshot->GetExtent(modifiedExtent);
+
+    this->InvalidateSnapshot();
+    if (this->IncrementalSnapshot)
+    {
+      this->Snapshot = snapshot;
+      this->SnapshotHoleFilled = holeFilling;
+      int bricksTotal = 1;
+      for (int axis = 0; axis < 3; axis++)
+      {
+        int snapshotSizeVoxels = modifiedExtent[axis * 2 + 1] - modifiedExtent[axis * 2] + 1;
+        this->SnapshotBrickCount[axis] = std::max((snapshotSizeVoxels + this->SnapshotBrickSizeVoxels - 1) / this->SnapshotBrickSizeVoxels, 0);
+        bricksTotal *= this->SnapshotBrickCount[axis];
+      }
+      this->SnapshotModifiedBricks.assign(bricksTotal, false);
+    }
+  }
+
+  if (previewLevel > 0 || !this->SnapshotPreviewLevels.empty())
   {
-    this->VolumeReconstructor->SetFillHoles(false);
+    // Existing levels are updated even if full resolution is requested, so that they do not get out of date
+    if (this->UpdatePreviewLevels(snapshot, modifiedExtent, previewLevel) != PLUS_SUCCESS)
+    {
+      this->InvalidateSnapshot();
+      outErrorMessage = "Downsampling the reconstructed volume snapshot failed";
+      LOG_ERROR(outErrorMessage);
+      return PLUS_FAIL;
+    }
+    if (previewLevel > 0)
+    {
+      snapshot = this->SnapshotPreviewLevels[previewLevel - 1];
+    }
   }
-  PlusStatus status = this->VolumeReconstructor->ExtractGrayLevels(reconstructedVolume);
-  if (!applyHoleFilling)
+
+  if (!modifiedRegionOnly)
   {
-    this->VolumeReconstructor->SetFillHoles(oldFillHoles);
+    // The snapshot is updated by later requests, so the caller gets a copy
+    reconstructedVolume->DeepCopy(snapshot);
+    return PLUS_SUCCESS;
   }
 
-  if (status != PLUS_SUCCESS)
+  if (modifiedExtent[0] > modifiedExtent[1] || modifiedExtent[2] > modifiedExtent[3] || modifiedExtent[4] > modifiedExtent[5])
+  {
+    // nothing has been modified since the previous snapshot
+    reconstructedVolume->Initialize();
+    return PLUS_SUCCESS;
+  }
+
+  vtkSmartPointer<vtkImageClip> modifiedRegionClip = vtkSmartPointer<vtkImageClip>::New();
+  modifiedRegionClip->SetInputData(snapshot);
+  modifiedRegionClip->SetOutputWholeExtent(modifiedExtent);
+  modifiedRegionClip->ClipDataOn();
+  modifiedRegionClip->Update();
+  reconstructedVolume->DeepCopy(modifiedRegionClip->GetOutput());
+
+  // Make the extent of the region start at 0, so that its origin specifies its position in the volume
+  double* snapshotOrigin = snapshot->GetOrigin();
+  double* snapshotSpacing = snapshot->GetSpacing();
+  double regionOrigin[3] = { 0, 0, 0 };
+  for (int axis = 0; axis < 3; axis++)
+  {
+    regionOrigin[axis] = snapshotOrigin[axis] + modifiedExtent[axis * 2] * snapshotSpacing[axis];
+  }
+  reconstructedVolume->SetExtent(0, modifiedExtent[1] - modifiedExtent[0], 0, modifiedExtent[3] - modifiedExtent[2], 0, modifiedExtent[5] - modifiedExtent[4]);
+  reconstructedVolume->SetOrigin(regionOrigin);
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualVolumeReconstructor::GetImageMetaData(igsioCommon::ImageMetaDataList& imageMetaDataItems)
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
+  int* outputExtent = this->VolumeReconstructor->GetOutputExtent();
+  igsioCommon::ImageMetaDataItem imageMetaDataItem;
+  imageMetaDataItem.Id = RECONSTRUCTED_VOLUME_IMAGE_ID;
+  imageMetaDataItem.Description = "Reconstructed volume";
+  imageMetaDataItem.Modality = "US";
+  imageMetaDataItem.ScalarType = 3; // OpenIGTLink TYPE_UINT8, gray levels of the volume are unsigned char
+  for (int axis = 0; axis < 3; axis++)
+  {
+    imageMetaDataItem.Size[axis] = std::max(outputExtent[axis * 2 + 1] - outputExtent[axis * 2] + 1, 0);
+  }
+  imageMetaDataItem.TimeStampUtc = vtkIGSIOAccurateTimer::GetUniversalTime();
+  imageMetaDataItems.push_back(imageMetaDataItem);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualVolumeReconstructor::GetImage(const std::string& requestedImageId, std::string& assignedImageId, const std::string& imageReferencFrameName,
+    vtkImageData* imageData, vtkMatrix4x4* ijkToReferenceTransform)
+{
+  vtkSmartPointer<vtkImageData> volume;
+  std::string frameUid;
+  if (this->GetImageSnapshot(requestedImageId, assignedImageId, imageReferencFrameName, volume, ijkToReferenceTransform, frameUid) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  imageData->DeepCopy(volume);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualVolumeReconstructor::GetImageSnapshot(const std::string& requestedImageId, std::string& assignedImageId, const std::string& imageReferencFrameName,
+    vtkSmartPointer<vtkImageData>& imageData, vtkMatrix4x4* ijkToReferenceTransform, std::string& frameUid)
+{
+  if (!requestedImageId.empty() && requestedImageId != RECONSTRUCTED_VOLUME_IMAGE_ID)
+  {
+    LOG_ERROR("The image " << requestedImageId << " is not provided by " << this->GetDeviceId());
+    return PLUS_FAIL;
+  }
+  assignedImageId = RECONSTRUCTED_VOLUME_IMAGE_ID;
+
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
+  double currentTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  // While the system is overloaded the frames are still pasted, only the snapshot extraction is less frequent
+  bool snapshotDue = !this->SnapshotRateReducedForOverload || currentTime - this->PublishedVolumeTime >= this->OverloadSnapshotIntervalSec;
+  if (this->PublishedVolume == NULL || (this->PublishedVolumeContentVersion != this->VolumeContentVersion && snapshotDue))
+  {
+    // The previously published volume may still be used by the caller, so the new content goes into a new object
+    vtkSmartPointer<vtkImageData> volume = vtkSmartPointer<vtkImageData>::New();
+    std::string errorMessage;
+    if (this->GetReconstructedVolume(volume, errorMessage) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    this->PublishedVolume = volume;
+    // extracting a new snapshot invalidates the previous one, so the version is read afterwards
+    this->PublishedVolumeContentVersion = this->VolumeContentVersion;
+    this->PublishedVolumeTime = currentTime;
+  }
+  imageData = this->PublishedVolume;
+  frameUid = this->GetDeviceId() + ":" + igsioCommon::ToString<unsigned long>(this->PublishedVolumeContentVersion);
+
+  // The volume geometry is in the reference frame of the reconstructor
+  ijkToReferenceTransform->Identity();
+  std::string volumeFrameName = this->VolumeReconstructor->GetReferenceCoordinateFrame();
+  if (!imageReferencFrameName.empty() && imageReferencFrameName != volumeFrameName)
+  {
+    igsioTransformName volumeToRequestedFrameName(volumeFrameName, imageReferencFrameName);
+    if (this->TransformRepository->GetTransform(volumeToRequestedFrameName, ijkToReferenceTransform) != PLUS_SUCCESS)
+    {
+      LOG_WARNING("Transform " << volumeToRequestedFrameName.GetTransformName() << " is not available, the reconstructed volume is sent in the " << volumeFrameName << " coordinate system");
+      ijkToReferenceTransform->Identity();
+    }
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualVolumeReconstructor::SaveReconstructedVolumeToFile(vtkImageData* volume, const std::string& filename, bool& savedInBackground)
+{
+  savedInBackground = false;
+  if (this->VolumeFileWriter->WaitForBackgroundWrite() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Saving of the previous reconstructed volume failed");
+  }
+  if (!this->BackgroundVolumeSaving || !vtkPlusVolumeFileWriter::CanWriteFile(filename))
+  {
+    return vtkPlusVolumeReconstructor::SaveReconstructedVolumeToFile(volume, filename);
+  }
+  if (this->VolumeFileWriter->WriteInBackground(volume, filename) != PLUS_SUCCESS)
   {
-    outErrorMessage = "Extracting gray levels failed";
-    LOG_ERROR(outErrorMessage);
     return PLUS_FAIL;
   }
+  savedInBackground = true;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusVirtualVolumeReconstructor::InvalidateSnapshot()
+{
+  // The snapshot is invalidated whenever the volume is reset, reconfigured or modified without frame tracking
+  this->VolumeContentVersion++;
+  this->Snapshot = NULL;
+  this->SnapshotHoleFilled = false;
+  this->SnapshotBrickCount[0] = 0;
+  this->SnapshotBrickCount[1] = 0;
+  this->SnapshotBrickCount[2] = 0;
+  this->SnapshotModifiedBricks.clear();
+  this->SnapshotPreviewLevels.clear();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusVirtualVolumeReconstructor::MarkSnapshotBricksModified(igsioTrackedFrame* frame)
+{
+  if (this->Snapshot == NULL || this->SnapshotModifiedBricks.empty())
+  {
+    // The next snapshot is extracted from the whole volume anyway
+    return;
+  }
+
+  int firstBrick[3] = { 0, 0, 0 };
+  int lastBrick[3] = { this->SnapshotBrickCount[0] - 1, this->SnapshotBrickCount[1] - 1, this->SnapshotBrickCount[2] - 1 };
+
+  igsioTransformName imageToReferenceTransformName(this->VolumeReconstructor->GetImageCoordinateFrame(), this->VolumeReconstructor->GetReferenceCoordinateFrame());
+  vtkSmartPointer<vtkMatrix4x4> imageToReferenceMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  if (this->TransformRepository->GetTransform(imageToReferenceTransformName, imageToReferenceMatrix) == PLUS_SUCCESS)
+  {
+    int* snapshotExtent = this->Snapshot->GetExtent();
+    double* snapshotOrigin = this->Snapshot->GetOrigin();
+    double* snapshotSpacing = this->Snapshot->GetSpacing();
+
+    // Bounding box of the slice in voxel coordinates
+    FrameSizeType frameSize = frame->GetFrameSize();
+    double cornerPixels[4][2] =
+    {
+      { 0, 0 },
+      { static_cast<double>(frameSize[0]) - 1, 0 },
+      { 0, static_cast<double>(frameSize[1]) - 1 },
+      { static_cast<double>(frameSize[0]) - 1, static_cast<double>(frameSize[1]) - 1 }
+    };
+    double minVoxel[3] = { VTK_DOUBLE_MAX, VTK_DOUBLE_MAX, VTK_DOUBLE_MAX };
+    double maxVoxel[3] = { -VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX };
+    for (int cornerIndex = 0; cornerIndex < 4; cornerIndex++)
+    {
+      double corner_Image[4] = { cornerPixels[cornerIndex][0], cornerPixels[cornerIndex][1], 0, 1 };
+      double corner_Reference[4] = { 0, 0, 0, 1 };
+      imageToReferenceMatrix->MultiplyPoint(corner_Image, corner_Reference);
+      for (int axis = 0; axis < 3; axis++)
+      {
+        double voxel = (corner_Reference[axis] - snapshotOrigin[axis]) / snapshotSpacing[axis];
+        minVoxel[axis] = std::min(minVoxel[axis], voxel);
+        maxVoxel[axis] = std::max(maxVoxel[axis], voxel);
+      }
+    }
+
+    // Interpolation modifies the neighbor voxels, hole filling modifies voxels within the hole filling margin
+    double marginVoxels = 1 + this->SnapshotHoleFillingMarginVoxels;
+    for (int axis = 0; axis < 3; axis++)
+    {
+      double firstVoxel = floor(minVoxel[axis] - marginVoxels) - snapshotExtent[axis * 2];
+      double lastVoxel = ceil(maxVoxel[axis] + marginVoxels) - snapshotExtent[axis * 2];
+      if (lastVoxel < 0 || firstVoxel > snapshotExtent[axis * 2 + 1] - snapshotExtent[axis * 2])
+      {
+        // the slice is outside the volume
+        return;
+      }
+      firstBrick[axis] = std::max(static_cast<int>(firstVoxel) / this->SnapshotBrickSizeVoxels, 0);
+      lastBrick[axis] = std::min(static_cast<int>(lastVoxel) / this->SnapshotBrickSizeVoxels, this->SnapshotBrickCount[axis] - 1);
+    }
+  }
+  else
+  {
+    LOG_WARNING("Failed to get ImageToReference transform for the modified region of the reconstructed volume, the whole volume will be updated in the next snapshot");
+  }
+
+  for (int z = firstBrick[2]; z <= lastBrick[2]; z++)
+  {
+    for (int y = firstBrick[1]; y <= lastBrick[1]; y++)
+    {
+      int rowStartIndex = (z * this->SnapshotBrickCount[1] + y) * this->SnapshotBrickCount[0];
+      for (int x = firstBrick[0]; x <= lastBrick[0]; x++)
+      {
+        this->SnapshotModifiedBricks[rowStartIndex + x] = true;
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualVolumeReconstructor::UpdateSnapshot(bool applyHoleFilling, int modifiedExtent[6])
+{
+  modifiedExtent[0] = modifiedExtent[2] = modifiedExtent[4] = VTK_INT_MAX;
+  modifiedExtent[1] = modifiedExtent[3] = modifiedExtent[5] = VTK_INT_MIN;
+
+  int* snapshotExtent = this->Snapshot->GetExtent();
+  const int brickSize = this->SnapshotBrickSizeVoxels;
+
+  bool oldFillHoles = this->VolumeReconstructor->GetFillHoles();
+  this->VolumeReconstructor->SetFillHoles(applyHoleFilling);
+
+  PlusStatus status = PLUS_SUCCESS;
+  for (int z = 0; z < this->SnapshotBrickCount[2] && status == PLUS_SUCCESS; z++)
+  {
+    for (int y = 0; y < this->SnapshotBrickCount[1] && status == PLUS_SUCCESS; y++)
+    {
+      int rowStartIndex = (z * this->SnapshotBrickCount[1] + y) * this->SnapshotBrickCount[0];
+      int x = 0;
+      while (x < this->SnapshotBrickCount[0])
+      {
+        if (!this->SnapshotModifiedBricks[rowStartIndex + x])
+        {
+          x++;
+          continue;
+        }
+        // Update consecutive modified bricks of the row at once
+        int firstBrickX = x;
+        while (x < this->SnapshotBrickCount[0] && this->SnapshotModifiedBricks[rowStartIndex + x])
+        {
+          x++;
+        }
+        int bricksExtent[6] =
+        {
+          snapshotExtent[0] + firstBrickX * brickSize, std::min(snapshotExtent[0] + x * brickSize - 1, snapshotExtent[1]),
+          snapshotExtent[2] + y * brickSize, std::min(snapshotExtent[2] + (y + 1) * brickSize - 1, snapshotExtent[3]),
+          snapshotExtent[4] + z * brickSize, std::min(snapshotExtent[4] + (z + 1) * brickSize - 1, snapshotExtent[5])
+        };
+        if (this->VolumeReconstructor->UpdateGrayLevels(this->Snapshot, bricksExtent, this->SnapshotHoleFillingMarginVoxels) != PLUS_SUCCESS)
+        {
+          status = PLUS_FAIL;
+          break;
+        }
+        for (int axis = 0; axis < 3; axis++)
+        {
+          modifiedExtent[axis * 2] = std::min(modifiedExtent[axis * 2], bricksExtent[axis * 2]);
+          modifiedExtent[axis * 2 + 1] = std::max(modifiedExtent[axis * 2 + 1], bricksExtent[axis * 2 + 1]);
+        }
+      }
+    }
+  }
+
+  this->VolumeReconstructor->SetFillHoles(oldFillHoles);
+  std::fill(this->SnapshotModifiedBricks.begin(), this->SnapshotModifiedBricks.end(), false);
+
+  if (modifiedExtent[0] > modifiedExtent[1])
+  {
+    // no modified bricks
+    modifiedExtent[0] = modifiedExtent[2] = modifiedExtent[4] = 0;
+    modifiedExtent[1] = modifiedExtent[3] = modifiedExtent[5] = -1;
+  }
+
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualVolumeReconstructor::UpdatePreviewLevels(vtkImageData* snapshot, int modifiedExtent[6], int previewLevel)
+{
+  int numberOfLevels = std::max(static_cast<int>(this->SnapshotPreviewLevels.size()), previewLevel);
+  int levelModifiedExtent[6] = { 0 };
+  std::copy(modifiedExtent, modifiedExtent + 6, levelModifiedExtent);
+  int requestedLevelModifiedExtent[6] = { 0 };
+  std::copy(modifiedExtent, modifiedExtent + 6, requestedLevelModifiedExtent);
+
+  vtkImageData* fineVolume = snapshot;
+  for (int level = 1; level <= numberOfLevels; level++)
+  {
+    int* fineExtent = fineVolume->GetExtent();
+    int coarseModifiedExtent[6] = { 0, -1, 0, -1, 0, -1 };
+    if (level > static_cast<int>(this->SnapshotPreviewLevels.size()))
+    {
+      // New level, it is computed from the whole finer level
+      double* fineOrigin = fineVolume->GetOrigin();
+      double* fineSpacing = fineVolume->GetSpacing();
+      double coarseOrigin[3] = { 0, 0, 0 };
+      double coarseSpacing[3] = { 0, 0, 0 };
+      for (int axis = 0; axis < 3; axis++)
+      {
+        int fineSizeVoxels = fineExtent[axis * 2 + 1] - fineExtent[axis * 2] + 1;
+        if (fineSizeVoxels < 1)
+        {
+          LOG_ERROR("vtkPlusVirtualVolumeReconstructor::UpdatePreviewLevels: reconstructed volume is empty");
+          return PLUS_FAIL;
+        }
+        coarseModifiedExtent[axis * 2] = 0;
+        coarseModifiedExtent[axis * 2 + 1] = (fineSizeVoxels - 1) / 2;
+        // center of the first 2x2x2 block of fine voxels
+        coarseOrigin[axis] = fineOrigin[axis] + (fineExtent[axis * 2] + 0.5) * fineSpacing[axis];
+        coarseSpacing[axis] = 2.0 * fineSpacing[axis];
+      }
+      vtkSmartPointer<vtkImageData> coarseVolume = vtkSmartPointer<vtkImageData>::New();
+      coarseVolume->SetExtent(coarseModifiedExtent);
+      coarseVolume->SetOrigin(coarseOrigin);
+      coarseVolume->SetSpacing(coarseSpacing);
+      coarseVolume->AllocateScalars(fineVolume->GetScalarType(), 1);
+      this->SnapshotPreviewLevels.push_back(coarseVolume);
+    }
+    else if (levelModifiedExtent[0] <= levelModifiedExtent[1] && levelModifiedExtent[2] <= levelModifiedExtent[3] && levelModifiedExtent[4] <= levelModifiedExtent[5])
+    {
+      for (int axis = 0; axis < 3; axis++)
+      {
+        coarseModifiedExtent[axis * 2] = (levelModifiedExtent[axis * 2] - fineExtent[axis * 2]) / 2;
+        coarseModifiedExtent[axis * 2 + 1] = (levelModifiedExtent[axis * 2 + 1] - fineExtent[axis * 2]) / 2;
+      }
+    }
+
+    vtkImageData* coarseVolume = this->SnapshotPreviewLevels[level - 1];
+    if (coarseModifiedExtent[0] <= coarseModifiedExtent[1])
+    {
+      switch (fineVolume->GetScalarType())
+      {
+        vtkTemplateMacro(DownsampleRegion<VTK_TT>(fineVolume, coarseVolume, coarseModifiedExtent));
+        default:
+          LOG_ERROR("vtkPlusVirtualVolumeReconstructor::UpdatePreviewLevels: unsupported scalar type " << fineVolume->GetScalarTypeAsString());
+          return PLUS_FAIL;
+      }
+    }
+
+    std::copy(coarseModifiedExtent, coarseModifiedExtent + 6, levelModifiedExtent);
+    if (level == previewLevel)
+    {
+      std::copy(coarseModifiedExtent, coarseModifiedExtent + 6, requestedLevelModifiedExtent);
+    }
+    fineVolume = coarseVolume;
+  }
+
+  std::copy(requestedLevelModifiedExtent, requestedLevelModifiedExtent + 6, modifiedExtent);
   return PLUS_SUCCESS;
 }
 
@@ -399,6 +1099,8 @@ PlusStatus vtkPlusVirtualVolumeReconstructor::AddFrames(vtkIGSIOTrackedFrameList
     if (insertedIntoVolume)
     {
       numberOfFramesAddedToVolume++;
+      this->VolumeContentVersion++;
+      this->MarkSnapshotBricksModified(frame);
     }
   }
   trackedFrameList->Clear();
@@ -437,20 +1139,52 @@ PlusStatus vtkPlusVirtualVolumeReconstructor::UpdateTransformRepository(vtkIGSIO
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusVirtualVolumeReconstructor::GetMemoryUsage(std::vector<MemoryAccounting::Usage>& usages)
+{
+  this->Superclass::GetMemoryUsage(usages);
+
+  MetricsRegistry::Labels deviceLabels;
+  deviceLabels["device"] = this->GetDeviceId();
+
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
+  // GetActualMemorySize returns kibibytes
+  size_t snapshotBytes = (this->Snapshot != NULL ? static_cast<size_t>(this->Snapshot->GetActualMemorySize()) * 1024 : 0);
+  for (std::vector< vtkSmartPointer<vtkImageData> >::const_iterator levelIt = this->SnapshotPreviewLevels.begin(); levelIt != this->SnapshotPreviewLevels.end(); ++levelIt)
+  {
+    if (*levelIt != NULL)
+    {
+      snapshotBytes += static_cast<size_t>((*levelIt)->GetActualMemorySize()) * 1024;
+    }
+  }
+  if (this->PublishedVolume != NULL)
+  {
+    snapshotBytes += static_cast<size_t>(this->PublishedVolume->GetActualMemorySize()) * 1024;
+  }
+  usages.push_back(MemoryAccounting::Usage("volume", deviceLabels, this->VolumeReconstructor->GetMemoryUsageBytes()));
+  usages.push_back(MemoryAccounting::Usage("volume_snapshot", deviceLabels, snapshotBytes));
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusVirtualVolumeReconstructor::SetOutputOrigin(double* origin)
 {
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
   this->VolumeReconstructor->SetOutputOrigin(origin);
+  this->InvalidateSnapshot();
 }
 
 //----------------------------------------------------------------------------
 void vtkPlusVirtualVolumeReconstructor::SetOutputSpacing(double* spacing)
 {
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
   this->VolumeReconstructor->SetOutputSpacing(spacing);
+  this->InvalidateSnapshot();
 }
 
 //----------------------------------------------------------------------------
 void vtkPlusVirtualVolumeReconstructor::SetOutputExtent(int* extent)
 {
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
   this->VolumeReconstructor->SetOutputExtent(extent);
+  this->InvalidateSnapshot();
 }
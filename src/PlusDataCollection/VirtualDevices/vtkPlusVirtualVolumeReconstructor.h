@@ -10,8 +10,15 @@ See License.txt for details.
 #include "vtkPlusDataCollectionExport.h"
 
 #include "vtkPlusDevice.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
+class igsioTrackedFrame;
+class vtkPlusVolumeFileWriter;
 class vtkPlusVolumeReconstructor;
 
 /*!
@@ -23,6 +30,11 @@ class vtkPlusVolumeReconstructor;
 class vtkPlusDataCollectionExport vtkPlusVirtualVolumeReconstructor : public vtkPlusDevice
 {
 public:
+  /*! Called from the reconstruction thread with the number of processed frames and the number of frames in the file */
+  typedef std::function<void(int, int)> FileReconstructionProgressCallback;
+  /*! Called from the reconstruction thread when the reconstruction from file is completed, failed, or cancelled */
+  typedef std::function<void(PlusStatus, const std::string&)> FileReconstructionCompletedCallback;
+
   static vtkPlusVirtualVolumeReconstructor* New();
   vtkTypeMacro(vtkPlusVirtualVolumeReconstructor, vtkPlusDevice);
   void PrintSelf(ostream& os, vtkIndent indent);
@@ -33,10 +45,67 @@ public:
   virtual PlusStatus GetReconstructedVolumeFromFile(const std::string& inputSeqFilename, vtkImageData* reconstructedVolume, std::string& errorMessage);
 
   /*!
+    Start reconstructing a volume from a sequence file on a background thread and return immediately.
+    The frames are read in chunks (see vtkPlusVolumeReconstructor::ReconstructFromSequenceFile). The volume is locked only
+    while a chunk is pasted, so GetReconstructedVolume can be called during the reconstruction to get intermediate results.
+    When the reconstruction is completed the result can be retrieved by GetReconstructedVolume.
     This method is safe to be called from any thread.
+    \param progressIntervalSec Minimum time between calls of progressCallback
+    \param progressCallback Called after chunks of frames are pasted (optional). The volume is not locked during the call.
+    \param completedCallback Called when the reconstruction is completed, failed, or cancelled (optional). The volume is not locked during the call.
+  */
+  PlusStatus StartReconstructionFromFile(const std::string& inputSeqFilename, double progressIntervalSec, const FileReconstructionProgressCallback& progressCallback,
+    const FileReconstructionCompletedCallback& completedCallback, std::string& errorMessage);
+
+  /*!
+    Request the background reconstruction from file to stop. The frames that have been pasted are kept in the volume.
+    Returns immediately, the completed callback is called with PLUS_FAIL when the reconstruction thread stopped.
+    This method is safe to be called from any thread.
+  */
+  void CancelReconstructionFromFile();
+
+  /*!
+    Pause or continue the background reconstruction from file. A suspended reconstruction can still be cancelled.
+    This method is safe to be called from any thread.
+  */
+  void SetReconstructionFromFileSuspended(bool suspended);
+  bool GetReconstructionFromFileSuspended() const { return this->FileReconstructionSuspended; }
+
+  /*! Returns true if a background reconstruction from file is in progress (it may be suspended). This method is safe to be called from any thread. */
+  bool IsReconstructionFromFileInProgress() const { return this->FileReconstructionInProgress; }
+
+  /*!
+    This method is safe to be called from any thread.
+    If IncrementalSnapshot is enabled then the result of the previous call is kept and only those bricks of the volume
+    are extracted (and hole filled) again that frames have been pasted into since then.
     \param applyHoleFilling If true (default) then hole filling will be applied (if enabled and fully specified), otherwise hole filling will be skipped
+    \param modifiedRegionOnly If true then only the bounding box of the bricks that have been modified since the previous call is returned,
+      with its origin set to its position in the full volume. The returned volume is empty if nothing has been modified.
+    \param previewLevel If 0 (default) then the full resolution volume is returned. If positive then the volume is returned
+      downsampled by a factor of 2 to the power of previewLevel along each axis. It must not be larger than NumberOfPreviewLevels.
+  */
+  PlusStatus GetReconstructedVolume(vtkImageData* reconstructedVolume, std::string& outErrorMessage, bool applyHoleFilling = true, bool modifiedRegionOnly = false,
+    int previewLevel = 0);
+
+  /*! The reconstructed volume is provided as image "Volume" (for GET_IMGMETA and GET_IMAGE requests) */
+  virtual PlusStatus GetImageMetaData(igsioCommon::ImageMetaDataList& imageMetaDataItems);
+  virtual PlusStatus GetImage(const std::string& requestedImageId, std::string& assignedImageId, const std::string& imageReferencFrameName, vtkImageData* imageData, vtkMatrix4x4* ijkToReferenceTransform);
+
+  /*!
+    Returns the hole filled reconstructed volume. The volume is extracted only if frames have been added to it since the previous call,
+    otherwise the same image object and frame UID are returned, so repeated requests of an unchanged volume are not copied again.
+    This method is safe to be called from any thread.
   */
-  PlusStatus GetReconstructedVolume(vtkImageData* reconstructedVolume, std::string& outErrorMessage, bool applyHoleFilling = true);
+  virtual PlusStatus GetImageSnapshot(const std::string& requestedImageId, std::string& assignedImageId, const std::string& imageReferencFrameName,
+                                      vtkSmartPointer<vtkImageData>& imageData, vtkMatrix4x4* ijkToReferenceTransform, std::string& frameUid);
+
+  /*!
+    Save a reconstructed volume to file. If BackgroundVolumeSaving is enabled and the file format is supported by vtkPlusVolumeFileWriter
+    then the volume is written on a background thread and the method returns immediately. In this case the volume must not be modified
+    after the call and errors of the writing are only logged. Saving waits for the completion of the previous background save.
+    \param savedInBackground Set to true if the volume is being written in the background
+  */
+  PlusStatus SaveReconstructedVolumeToFile(vtkImageData* volume, const std::string& filename, bool& savedInBackground);
 
   /*!
     Updated the transform repository contents within the volume reconstructor.
@@ -81,6 +150,52 @@ public:
 
   vtkGetMacro(TotalFramesRecorded, long int);
 
+  /*!
+    Append the memory used by the buffers, the reconstructed volume and the snapshots.
+    This method is safe to be called from any thread.
+  */
+  virtual void GetMemoryUsage(std::vector<MemoryAccounting::Usage>& usages);
+
+  /*! If enabled then reconstructed volume snapshots are updated only in the bricks that have been modified since the previous snapshot */
+  vtkGetMacro(IncrementalSnapshot, bool);
+  vtkSetMacro(IncrementalSnapshot, bool);
+  vtkBooleanMacro(IncrementalSnapshot, bool);
+
+  /*!
+    If enabled then GetReconstructedVolumeFromFile reads the input sequence in chunks while the frames are pasted,
+    instead of loading the whole sequence into memory (see vtkPlusVolumeReconstructor::ReconstructFromSequenceFile)
+  */
+  vtkGetMacro(StreamInputSequence, bool);
+  vtkSetMacro(StreamInputSequence, bool);
+  vtkBooleanMacro(StreamInputSequence, bool);
+
+  /*! Size of the bricks (in voxels along each axis) that are tracked for modification between snapshots */
+  vtkGetMacro(SnapshotBrickSizeVoxels, int);
+  vtkSetClampMacro(SnapshotBrickSizeVoxels, int, 1, VTK_INT_MAX);
+
+  /*! Neighborhood size that hole filling of a modified brick uses (in voxels). Must not be smaller than the hole filling kernel size. */
+  vtkGetMacro(SnapshotHoleFillingMarginVoxels, int);
+  vtkSetClampMacro(SnapshotHoleFillingMarginVoxels, int, 0, VTK_INT_MAX);
+
+  /*!
+    Number of downsampled preview levels that snapshots can be requested at. Each level halves the resolution of the previous one.
+    A level is created when it is first requested, then its modified region is updated from the finer level on each snapshot request.
+  */
+  vtkGetMacro(NumberOfPreviewLevels, int);
+  vtkSetClampMacro(NumberOfPreviewLevels, int, 0, 8);
+
+  /*!
+    Minimum time between the extraction of volume snapshots by GetImageSnapshot while the ReducePreviewReconstruction
+    overload policy is applied (see OverloadManager). Meanwhile the previous snapshot is returned.
+  */
+  vtkGetMacro(OverloadSnapshotIntervalSec, double);
+  vtkSetMacro(OverloadSnapshotIntervalSec, double);
+
+  /*! If enabled then SaveReconstructedVolumeToFile compresses and writes the volume on a background thread */
+  vtkGetMacro(BackgroundVolumeSaving, bool);
+  vtkSetMacro(BackgroundVolumeSaving, bool);
+  vtkBooleanMacro(BackgroundVolumeSaving, bool);
+
 protected:
 
   /*! Read main configuration from xml data */
@@ -118,6 +233,33 @@ protected:
   /*! Get the sampling period length (in seconds). Frames are copied from the devices to the data collection buffer once in every sampling period. */
   double GetSamplingPeriodSec();
 
+  /*! Discard the snapshot, so that the next snapshot is extracted from the whole volume */
+  void InvalidateSnapshot();
+
+  /*! Body of the background reconstruction from file thread */
+  void ReconstructFromFileThread(std::string inputSeqFileFullPath, double progressIntervalSec, FileReconstructionProgressCallback progressCallback,
+    FileReconstructionCompletedCallback completedCallback);
+
+  /*! Cancel the background reconstruction from file and wait for its thread to stop */
+  void StopReconstructionFromFile();
+
+  /*!
+    Mark the snapshot bricks that may be modified by pasting the frame into the volume.
+    The transform repository must already contain the transforms of the frame.
+  */
+  void MarkSnapshotBricksModified(igsioTrackedFrame* frame);
+
+  /*! Extract the modified bricks of the snapshot again. The extent of the updated region is returned in modifiedExtent. */
+  PlusStatus UpdateSnapshot(bool applyHoleFilling, int modifiedExtent[6]);
+
+  /*!
+    Update the preview levels from the snapshot and create the levels up to previewLevel that do not exist yet.
+    \param snapshot Full resolution volume
+    \param modifiedExtent Region of the snapshot that has been modified. It is replaced by the modified region of the requested level.
+    \param previewLevel Requested level
+  */
+  PlusStatus UpdatePreviewLevels(vtkImageData* snapshot, int modifiedExtent[6], int previewLevel);
+
   vtkPlusVirtualVolumeReconstructor();
   virtual ~vtkPlusVirtualVolumeReconstructor();
 
@@ -152,6 +294,50 @@ protected:
   std::string OutputVolFilename;
   std::string OutputVolDeviceName;
 
+  bool IncrementalSnapshot;
+  bool StreamInputSequence;
+  int SnapshotBrickSizeVoxels;
+  int SnapshotHoleFillingMarginVoxels;
+  int NumberOfPreviewLevels;
+  bool BackgroundVolumeSaving;
+  double OverloadSnapshotIntervalSec;
+
+  /*! Set by the overload policy handler while the snapshots are extracted less frequently */
+  std::atomic<bool> SnapshotRateReducedForOverload;
+  /*! Identifier of the overload policy handler, 0 if not registered */
+  int OverloadPolicyHandlerId;
+
+  /*! Gray levels of the volume returned by the previous snapshot request. NULL if there is no valid snapshot. */
+  vtkSmartPointer<vtkImageData> Snapshot;
+  /*! True if hole filling was applied when the snapshot was extracted */
+  bool SnapshotHoleFilled;
+  /*! Number of bricks along each axis of the snapshot */
+  int SnapshotBrickCount[3];
+  /*! Modified flag of each brick of the snapshot, x index changes the fastest */
+  std::vector<bool> SnapshotModifiedBricks;
+  /*! Downsampled snapshots, the first element is preview level 1 */
+  std::vector< vtkSmartPointer<vtkImageData> > SnapshotPreviewLevels;
+
+  /*! Incremented whenever the content of the volume may have changed */
+  unsigned long VolumeContentVersion;
+  /*! Volume returned by GetImageSnapshot, it is not modified after it has been returned. NULL if not requested yet. */
+  vtkSmartPointer<vtkImageData> PublishedVolume;
+  /*! VolumeContentVersion at the time PublishedVolume was extracted */
+  unsigned long PublishedVolumeContentVersion;
+  /*! System time when PublishedVolume was extracted */
+  double PublishedVolumeTime;
+
+  /*! Writes the reconstructed volumes in the background */
+  vtkSmartPointer<vtkPlusVolumeFileWriter> VolumeFileWriter;
+
+  /*! Thread of the background reconstruction from file, joined when the next one is started or the device is disconnected */
+  std::thread FileReconstructionThread;
+  /*! Protects FileReconstructionThread, so that it is not started and joined at the same time */
+  std::mutex FileReconstructionThreadMutex;
+  std::atomic<bool> FileReconstructionInProgress;
+  std::atomic<bool> FileReconstructionSuspended;
+  std::atomic<bool> FileReconstructionCancelRequested;
+
   /*! Mutex instance simultaneous access of writer (writer may be accessed from command processing thread and also the internal update thread) */
   vtkSmartPointer<vtkIGSIORecursiveCriticalSection> VolumeReconstructorAccessMutex;
 
@@ -19,6 +19,12 @@ See License.txt for details.
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkPlusWinProbeVideoSource);
 
+namespace
+{
+  /*! Number of slots of the handoff ring, frames received while all slots are in use are dropped */
+  const unsigned int HANDOFF_RING_SIZE = 8;
+}
+
 int32_t focalCountFromDepthsArray(float* depths, unsigned arraySize)
 {
   std::vector<float> nonZeroes;
@@ -77,6 +83,8 @@ void vtkPlusWinProbeVideoSource::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "Frequency: " << this->GetTransmitFrequencyMHz() << std::endl;
   os << indent << "Depth: " << this->GetScanDepthMm() << std::endl;
   os << indent << "Mode: " << this->ModeToString(this->GetMode()) << std::endl;
+  os << indent << "CallbackHandoff: " << this->m_CallbackHandoff << std::endl;
+  os << indent << "NumberOfProcessingThreads: " << this->m_NumberOfProcessingThreads << std::endl;
   for(int i = 0; i < 8; i++)
   {
     os << indent << "TGC" << i << ": " << m_TimeGainCompensation[i] << std::endl;
@@ -107,6 +115,8 @@ PlusStatus vtkPlusWinProbeVideoSource::ReadConfiguration(vtkXMLDataElement* root
 
   XML_READ_STRING_ATTRIBUTE_REQUIRED(TransducerID, deviceConfig);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(UseDeviceFrameReconstruction, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(CallbackHandoff, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfProcessingThreads, deviceConfig);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(SpatialCompoundEnabled, deviceConfig);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(BHarmonicEnabled, deviceConfig);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(MRevolvingEnabled, deviceConfig);
@@ -172,6 +182,8 @@ PlusStatus vtkPlusWinProbeVideoSource::WriteConfiguration(vtkXMLDataElement* roo
 
   deviceConfig->SetAttribute("TransducerID", this->m_TransducerID.c_str());
   deviceConfig->SetAttribute("UseDeviceFrameReconstruction", this->m_UseDeviceFrameReconstruction ? "TRUE" : "FALSE");
+  deviceConfig->SetAttribute("CallbackHandoff", this->m_CallbackHandoff ? "TRUE" : "FALSE");
+  deviceConfig->SetIntAttribute("NumberOfProcessingThreads", this->m_NumberOfProcessingThreads);
   deviceConfig->SetAttribute("SpatialCompoundEnabled", this->GetSpatialCompoundEnabled() ? "TRUE" : "FALSE");
   deviceConfig->SetAttribute("HarmonicEnabled", this->GetBHarmonicEnabled() ? "TRUE" : "FALSE");
   deviceConfig->SetAttribute("MRevolvingEnabled", this->GetMRevolvingEnabled() ? "TRUE" : "FALSE");
@@ -332,14 +344,14 @@ void vtkPlusWinProbeVideoSource::ReconstructFrame(char* data, std::vector<uint8_
   }
 }
 
-void vtkPlusWinProbeVideoSource::FlipTexture(char* data, const FrameSizeType& frameSize, int rowPitch)
+void vtkPlusWinProbeVideoSource::FlipTexture(char* data, std::vector<uint8_t>& buffer, const FrameSizeType& frameSize, int rowPitch)
 {
   #pragma omp parallel for
   for(unsigned t = 0; t < frameSize[0]; t++)
   {
     for(unsigned s = 0; s < frameSize[1]; s++)
     {
-      m_PrimaryBuffer[s * frameSize[0] + t] = data[t * rowPitch + s];
+      buffer[s * frameSize[0] + t] = data[t * rowPitch + s];
     }
   }
 }
@@ -507,7 +519,18 @@ void vtkPlusWinProbeVideoSource::FrameCallback(int length, char* data, char* hHe
     }
     else
     {
-      if(usMode & M_PostProcess)
+      if(usMode & M_PostProcess && m_HandoffActive)
+      {
+        HandoffFrame* frame = this->AcquireHandoffFrame(HandoffFrameType::M_MODE, frameSize, timestamp);
+        if(frame != nullptr)
+        {
+          frame->Data.assign(data, data + length);
+          frame->OutputFrameSize[0] = m_ExtraFrameSize[0];
+          frame->Pixels.resize(m_ExtraBuffer.size());
+          this->QueueHandoffFrame(frame);
+        }
+      }
+      else if(usMode & M_PostProcess)
       {
         this->ReconstructFrame(data, m_ExtraBuffer, frameSize);
         for(unsigned i = 0; i < m_ExtraSources.size(); i++)
@@ -536,28 +559,51 @@ void vtkPlusWinProbeVideoSource::FrameCallback(int length, char* data, char* hHe
         {
           LOG_ERROR("B Mode texture data does not match frame size");
         }
-        if(tLength > 0)
+        if(m_HandoffActive)
         {
-          this->FlipTexture(texture, frameSize, rowPitch);
+          // the texture is only valid until it is freed, so the texture or the sample data is copied
+          HandoffFrame* frame = this->AcquireHandoffFrame(tLength > 0 ? HandoffFrameType::TEXTURE : HandoffFrameType::BRIGHTNESS, frameSize, timestamp);
+          if(frame != nullptr)
+          {
+            if(tLength > 0)
+            {
+              frame->Data.assign(texture, texture + tLength);
+              frame->RowPitch = rowPitch;
+            }
+            else
+            {
+              frame->Data.assign(data, data + length);
+            }
+            frame->Pixels.resize(m_PrimaryBuffer.size());
+            this->QueueHandoffFrame(frame);
+          }
+          WPFreePointer(texture);
         }
         else
         {
-          this->ReconstructFrame(data, m_PrimaryBuffer, frameSize);
-        }
-        WPFreePointer(texture);
+          if(tLength > 0)
+          {
+            this->FlipTexture(texture, m_PrimaryBuffer, frameSize, rowPitch);
+          }
+          else
+          {
+            this->ReconstructFrame(data, m_PrimaryBuffer, frameSize);
+          }
+          WPFreePointer(texture);
 
-        for(unsigned i = 0; i < m_PrimarySources.size(); i++)
-        {
-          if(m_PrimarySources[i]->AddItem(&m_PrimaryBuffer[0],
-                                          US_IMG_ORIENT_MF,
-                                          frameSize, VTK_UNSIGNED_CHAR,
-                                          1, US_IMG_BRIGHTNESS, 0,
-                                          this->FrameNumber,
-                                          timestamp,
-                                          timestamp, //no timestamp filtering needed
-                                          &this->m_CustomFields) != PLUS_SUCCESS)
+          for(unsigned i = 0; i < m_PrimarySources.size(); i++)
           {
-            LOG_WARNING("Error adding item to primary video source " << m_PrimarySources[i]->GetSourceId());
+            if(m_PrimarySources[i]->AddItem(&m_PrimaryBuffer[0],
+                                            US_IMG_ORIENT_MF,
+                                            frameSize, VTK_UNSIGNED_CHAR,
+                                            1, US_IMG_BRIGHTNESS, 0,
+                                            this->FrameNumber,
+                                            timestamp,
+                                            timestamp, //no timestamp filtering needed
+                                            &this->m_CustomFields) != PLUS_SUCCESS)
+            {
+              LOG_WARNING("Error adding item to primary video source " << m_PrimarySources[i]->GetSourceId());
+            }
           }
         }
       } // B-mode
@@ -568,6 +614,16 @@ void vtkPlusWinProbeVideoSource::FrameCallback(int length, char* data, char* hHe
     LOG_DEBUG("Frame ignored - B-mode source not defined. Got mode: " << std::hex << usMode);
     return;
   }
+  else if(usMode & ARFI && m_HandoffActive)
+  {
+    // need to spoof the timestamps since the arfi data comes a few seconds after the push
+    HandoffFrame* frame = this->AcquireHandoffFrame(HandoffFrameType::ARFI, frameSize, vtkIGSIOAccurateTimer::GetSystemTime());
+    if(frame != nullptr)
+    {
+      frame->Data.assign(data, data + length);
+      this->QueueHandoffFrame(frame);
+    }
+  }
   else if(usMode & ARFI)
   {
     for(unsigned i = 0; i < m_ExtraSources.size(); i++)
@@ -593,6 +649,15 @@ void vtkPlusWinProbeVideoSource::FrameCallback(int length, char* data, char* hHe
       }
     }
   }
+  else if(usMode & BFRFALineImage_RFData && m_HandoffActive)
+  {
+    HandoffFrame* frame = this->AcquireHandoffFrame(HandoffFrameType::RF, frameSize, timestamp);
+    if(frame != nullptr)
+    {
+      frame->Data.assign(data, data + length);
+      this->QueueHandoffFrame(frame);
+    }
+  }
   else if(usMode & BFRFALineImage_RFData)
   {
     for(unsigned i = 0; i < m_ExtraSources.size(); i++)
@@ -627,6 +692,9 @@ void vtkPlusWinProbeVideoSource::FrameCallback(int length, char* data, char* hHe
 //----------------------------------------------------------------------------
 void vtkPlusWinProbeVideoSource::AdjustBufferSizes()
 {
+  // frames of the previous size must not be added after the buffers are resized
+  this->WaitForHandoffFrames();
+
   FrameSizeType frameSize = m_PrimaryFrameSize;
 
   for(unsigned i = 0; i < m_PrimarySources.size(); i++)
@@ -947,6 +1015,10 @@ PlusStatus vtkPlusWinProbeVideoSource::InternalDisconnect()
 // ----------------------------------------------------------------------------
 PlusStatus vtkPlusWinProbeVideoSource::InternalStartRecording()
 {
+  if(m_CallbackHandoff)
+  {
+    this->StartHandoffThreads();
+  }
   WPExecute();
   return PLUS_SUCCESS;
 }
@@ -955,9 +1027,230 @@ PlusStatus vtkPlusWinProbeVideoSource::InternalStartRecording()
 PlusStatus vtkPlusWinProbeVideoSource::InternalStopRecording()
 {
   WPStopScanning();
+  this->StopHandoffThreads();
   return PLUS_SUCCESS;
 }
 
+// ----------------------------------------------------------------------------
+void vtkPlusWinProbeVideoSource::StartHandoffThreads()
+{
+  this->StopHandoffThreads();
+  {
+    std::lock_guard<std::mutex> lock(m_HandoffMutex);
+    m_HandoffRing.resize(HANDOFF_RING_SIZE);
+    for(HandoffFrame& frame : m_HandoffRing)
+    {
+      frame.InUse = false;
+      frame.Processed = false;
+      // preallocate for the current sample data size, the buffers only grow if the frame size increases
+      frame.Data.reserve(m_PrimaryFrameSize[0] * m_PrimaryFrameSize[1] * sizeof(uint16_t) + 16);
+      frame.Pixels.reserve(m_PrimaryFrameSize[0] * m_PrimaryFrameSize[1]);
+    }
+    m_HandoffWriteIndex = 0;
+    m_HandoffAddIndex = 0;
+    m_HandoffPendingFrames.clear();
+    m_HandoffStopRequested = false;
+    m_HandoffDroppedFrames = 0;
+  }
+
+  int numberOfThreads = m_NumberOfProcessingThreads;
+  if(numberOfThreads <= 0)
+  {
+    numberOfThreads = std::max<int>(std::thread::hardware_concurrency(), 1);
+  }
+  for(int i = 0; i < numberOfThreads; ++i)
+  {
+    m_HandoffThreads.push_back(std::thread(&vtkPlusWinProbeVideoSource::ProcessHandoffFrames, this));
+  }
+  m_HandoffActive = true;
+  LOG_DEBUG("Started " << numberOfThreads << " WinProbe frame processing threads");
+}
+
+// ----------------------------------------------------------------------------
+void vtkPlusWinProbeVideoSource::StopHandoffThreads()
+{
+  m_HandoffActive = false;
+  if(m_HandoffThreads.empty())
+  {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_HandoffMutex);
+    m_HandoffStopRequested = true;
+  }
+  m_HandoffFrameQueued.notify_all();
+  for(std::thread& thread : m_HandoffThreads)
+  {
+    thread.join();
+  }
+  m_HandoffThreads.clear();
+  if(m_HandoffDroppedFrames > 0)
+  {
+    LOG_WARNING("WinProbe frame processing could not keep up with the acquisition, " << m_HandoffDroppedFrames << " frames were dropped");
+  }
+}
+
+// ----------------------------------------------------------------------------
+void vtkPlusWinProbeVideoSource::WaitForHandoffFrames()
+{
+  std::unique_lock<std::mutex> lock(m_HandoffMutex);
+  // the slots in use are contiguous from the add index, so the ring is empty if the slot at the add index is free
+  while(m_HandoffActive && !m_HandoffStopRequested && !m_HandoffRing.empty() && m_HandoffRing[m_HandoffAddIndex].InUse)
+  {
+    m_HandoffFramesAdded.wait(lock);
+  }
+}
+
+// ----------------------------------------------------------------------------
+vtkPlusWinProbeVideoSource::HandoffFrame* vtkPlusWinProbeVideoSource::AcquireHandoffFrame(HandoffFrameType type, const FrameSizeType& frameSize, double timestamp)
+{
+  HandoffFrame* frame = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(m_HandoffMutex);
+    if(m_HandoffRing[m_HandoffWriteIndex].InUse)
+    {
+      if(m_HandoffDroppedFrames == 0)
+      {
+        LOG_WARNING("WinProbe frame processing cannot keep up with the acquisition, frames are dropped");
+      }
+      ++m_HandoffDroppedFrames;
+      return nullptr;
+    }
+    frame = &m_HandoffRing[m_HandoffWriteIndex];
+    frame->InUse = true;
+    frame->Processed = false;
+    m_HandoffWriteIndex = (m_HandoffWriteIndex + 1) % m_HandoffRing.size();
+  }
+  // the slot is owned by the callback until it is queued
+  frame->Type = type;
+  frame->FrameSize = frameSize;
+  frame->OutputFrameSize = frameSize;
+  frame->RowPitch = 0;
+  frame->FrameNumber = this->FrameNumber;
+  frame->Timestamp = timestamp;
+  frame->CustomFields = m_CustomFields;
+  return frame;
+}
+
+// ----------------------------------------------------------------------------
+void vtkPlusWinProbeVideoSource::QueueHandoffFrame(HandoffFrame* frame)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_HandoffMutex);
+    m_HandoffPendingFrames.push_back(frame);
+  }
+  m_HandoffFrameQueued.notify_one();
+}
+
+// ----------------------------------------------------------------------------
+void vtkPlusWinProbeVideoSource::ProcessHandoffFrames()
+{
+  while(true)
+  {
+    HandoffFrame* frame = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(m_HandoffMutex);
+      while(!m_HandoffStopRequested && m_HandoffPendingFrames.empty())
+      {
+        m_HandoffFrameQueued.wait(lock);
+      }
+      if(m_HandoffPendingFrames.empty())
+      {
+        // stop is requested and all the queued frames are processed
+        break;
+      }
+      frame = m_HandoffPendingFrames.front();
+      m_HandoffPendingFrames.pop_front();
+    }
+
+    this->ConvertHandoffFrame(*frame);
+    {
+      std::lock_guard<std::mutex> lock(m_HandoffMutex);
+      frame->Processed = true;
+    }
+    this->AddProcessedHandoffFrames();
+  }
+}
+
+// ----------------------------------------------------------------------------
+void vtkPlusWinProbeVideoSource::ConvertHandoffFrame(HandoffFrame& frame)
+{
+  switch(frame.Type)
+  {
+  case HandoffFrameType::BRIGHTNESS:
+  case HandoffFrameType::M_MODE:
+    this->ReconstructFrame(&frame.Data[0], frame.Pixels, frame.FrameSize);
+    break;
+  case HandoffFrameType::TEXTURE:
+    this->FlipTexture(&frame.Data[0], frame.Pixels, frame.FrameSize, frame.RowPitch);
+    break;
+  default:
+    // RF and ARFI data is added as is
+    break;
+  }
+}
+
+// ----------------------------------------------------------------------------
+void vtkPlusWinProbeVideoSource::AddProcessedHandoffFrames()
+{
+  std::lock_guard<std::mutex> addFramesLock(m_HandoffAddMutex);
+  while(true)
+  {
+    HandoffFrame* frame = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(m_HandoffMutex);
+      HandoffFrame& nextFrame = m_HandoffRing[m_HandoffAddIndex];
+      if(!nextFrame.InUse || !nextFrame.Processed)
+      {
+        // the next frame is still being processed, the thread that processes it will add it
+        return;
+      }
+      frame = &nextFrame;
+    }
+
+    bool brightness = (frame->Type == HandoffFrameType::BRIGHTNESS || frame->Type == HandoffFrameType::TEXTURE || frame->Type == HandoffFrameType::M_MODE);
+    const std::vector<vtkPlusDataSource*>& sources = (frame->Type == HandoffFrameType::BRIGHTNESS || frame->Type == HandoffFrameType::TEXTURE) ? m_PrimarySources : m_ExtraSources;
+    for(unsigned i = 0; i < sources.size(); i++)
+    {
+      PlusStatus status;
+      if(brightness)
+      {
+        status = sources[i]->AddItem(&frame->Pixels[0],
+                                     US_IMG_ORIENT_MF,
+                                     frame->OutputFrameSize, VTK_UNSIGNED_CHAR,
+                                     1, US_IMG_BRIGHTNESS, 0,
+                                     frame->FrameNumber,
+                                     frame->Timestamp,
+                                     frame->Timestamp, //no timestamp filtering needed
+                                     &frame->CustomFields);
+      }
+      else
+      {
+        status = sources[i]->AddItem(&frame->Data[0],
+                                     US_IMG_ORIENT_FM,
+                                     frame->OutputFrameSize, VTK_INT,
+                                     1, US_IMG_RF_REAL, 0,
+                                     frame->FrameNumber,
+                                     frame->Timestamp,
+                                     frame->Timestamp,
+                                     &frame->CustomFields);
+      }
+      if(status != PLUS_SUCCESS)
+      {
+        LOG_WARNING("Error adding item to video source " << sources[i]->GetSourceId());
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(m_HandoffMutex);
+      frame->InUse = false;
+      frame->Processed = false;
+      m_HandoffAddIndex = (m_HandoffAddIndex + 1) % m_HandoffRing.size();
+    }
+    m_HandoffFramesAdded.notify_all();
+  }
+}
+
 // ----------------------------------------------------------------------------
 PlusStatus vtkPlusWinProbeVideoSource::FreezeDevice(bool freeze)
 {
@@ -7,7 +7,12 @@
 #ifndef __vtkPlusWinProbeVideoSource_h
 #define __vtkPlusWinProbeVideoSource_h
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 #include "vtkPlusDataCollectionExport.h"
 #include "vtkPlusUsDevice.h"
@@ -20,6 +25,11 @@
  Requires PLUS_USE_WINPROBE_VIDEO option in CMake.
  Requires the WinProbeSDK.
 
+ If CallbackHandoff is enabled then the frame callback of the SDK only copies the frame data into a preallocated ring
+ and returns, so that the SDK does not drop frames at high line densities. The frames are converted (log compression,
+ reshaping) and added to the data sources on NumberOfProcessingThreads worker threads, in the order they were received.
+ If all slots of the ring are in use then the new frame is dropped.
+
  \ingroup PlusLibDataCollection.
 */
 class vtkPlusDataCollectionExport vtkPlusWinProbeVideoSource : public vtkPlusUsDevice
@@ -138,6 +148,14 @@ public:
   /* Whether or not to use device's built-in frame reconstruction */
   bool GetUseDeviceFrameReconstruction() { return m_UseDeviceFrameReconstruction; }
 
+  /*! Process the frames on worker threads instead of the SDK callback. Takes effect at the next recording start. */
+  void SetCallbackHandoff(bool value) { m_CallbackHandoff = value; }
+  bool GetCallbackHandoff() const { return m_CallbackHandoff; }
+
+  /*! Number of worker threads that process the handed off frames. If 0 then the number of processors is used. */
+  void SetNumberOfProcessingThreads(int value) { m_NumberOfProcessingThreads = value; }
+  int GetNumberOfProcessingThreads() const { return m_NumberOfProcessingThreads; }
+
   /*! Set ON/OFF of collecting US data. */
   PlusStatus FreezeDevice(bool freeze);
 
@@ -295,11 +313,69 @@ protected:
   /*! Updates buffer size based on current depth */
   void AdjustBufferSizes();
 
+  /*! Type of processing that a handed off frame requires */
+  enum class HandoffFrameType
+  {
+    BRIGHTNESS, // B-mode sample data, log compressed into the primary sources
+    TEXTURE, // B-mode fused texture, reshaped into the primary sources
+    M_MODE, // M-mode sample data, log compressed into the extra sources
+    RF, // RF data, added to the extra sources as is
+    ARFI // ARFI data, added to the extra sources as is
+  };
+
+  /*! A slot of the handoff ring. The buffers keep their capacity, so no memory is allocated once the ring is warmed up. */
+  struct HandoffFrame
+  {
+    HandoffFrameType Type = HandoffFrameType::BRIGHTNESS;
+    /*! Copy of the frame data provided by the SDK */
+    std::vector<char> Data;
+    /*! Converted pixels of BRIGHTNESS, TEXTURE and M_MODE frames */
+    std::vector<uint8_t> Pixels;
+    /*! Size of the SDK data */
+    FrameSizeType FrameSize = { 0, 0, 1 };
+    /*! Size of the item added to the data sources */
+    FrameSizeType OutputFrameSize = { 0, 0, 1 };
+    int RowPitch = 0;
+    long FrameNumber = 0;
+    double Timestamp = 0;
+    igsioFieldMapType CustomFields;
+    /*! Set when the frame is converted and can be added to the data sources */
+    bool Processed = false;
+    /*! Set while the slot holds a frame that has not been added to the data sources yet */
+    bool InUse = false;
+  };
+
   friend int __stdcall frameCallback(int length, char* data, char* hHeader, char* hGeometry, char* hModeFrameHeader);
   void ReconstructFrame(char* data, std::vector<uint8_t>& buffer, const FrameSizeType& frameSize);
-  void FlipTexture(char* data, const FrameSizeType& frameSize, int rowPitch);
+  void FlipTexture(char* data, std::vector<uint8_t>& buffer, const FrameSizeType& frameSize, int rowPitch);
   void FrameCallback(int length, char* data, char* hHeader, char* hGeometry);
 
+  /*! Start the worker threads that process the handed off frames */
+  void StartHandoffThreads();
+
+  /*! Process and add the frames that are already handed off, then stop the worker threads */
+  void StopHandoffThreads();
+
+  /*! Wait until all handed off frames are added to the data sources. Must not be called from a worker thread. */
+  void WaitForHandoffFrames();
+
+  /*!
+    Take a free slot of the handoff ring for a new frame, or return nullptr (and count the dropped frame) if all slots are in use.
+    The frame number and the custom fields are copied from the device, the data is copied into the slot by the callback,
+    then the slot is queued for processing by QueueHandoffFrame.
+  */
+  HandoffFrame* AcquireHandoffFrame(HandoffFrameType type, const FrameSizeType& frameSize, double timestamp);
+  void QueueHandoffFrame(HandoffFrame* frame);
+
+  /*! Convert queued frames until the worker threads are stopped */
+  void ProcessHandoffFrames();
+
+  /*! Convert the data of a handed off frame into its pixels */
+  void ConvertHandoffFrame(HandoffFrame& frame);
+
+  /*! Add the processed frames at the front of the ring to the data sources, in the order they were received */
+  void AddProcessedHandoffFrames();
+
   float m_ScanDepth = 26.0; //mm
   float m_TransducerWidth = 38.1; //mm
   float m_Frequency = 10.9; //MHz
@@ -345,6 +421,28 @@ protected:
   std::vector<vtkPlusDataSource*> m_PrimarySources;
   std::vector<vtkPlusDataSource*> m_ExtraSources;
 
+  bool m_CallbackHandoff = false;
+  int m_NumberOfProcessingThreads = 0;
+  /*! Set while the worker threads are running, the callback hands off the frames */
+  std::atomic<bool> m_HandoffActive{ false };
+  std::vector<std::thread> m_HandoffThreads;
+  /*! Protects the handoff ring indices, the slot states, the processing queue and the stop request */
+  std::mutex m_HandoffMutex;
+  std::condition_variable m_HandoffFrameQueued;
+  /*! Signaled when frames are added to the data sources */
+  std::condition_variable m_HandoffFramesAdded;
+  std::vector<HandoffFrame> m_HandoffRing;
+  /*! Slot of the next frame received from the SDK */
+  unsigned int m_HandoffWriteIndex = 0;
+  /*! Slot of the next frame to be added to the data sources */
+  unsigned int m_HandoffAddIndex = 0;
+  /*! Frames that wait for a worker thread */
+  std::deque<HandoffFrame*> m_HandoffPendingFrames;
+  bool m_HandoffStopRequested = false;
+  unsigned long m_HandoffDroppedFrames = 0;
+  /*! Held while frames are added to the data sources, so frames processed by different threads are added in order */
+  std::mutex m_HandoffAddMutex;
+
   Mode m_Mode = Mode::B;
 
 public:
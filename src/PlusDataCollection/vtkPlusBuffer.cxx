@@ -6,28 +6,80 @@ See License.txt for details.
 
 // Local includes
 #include "PlusConfigure.h"
+#include "PixelCodec.h"
+#include "PlusMemoryAccounting.h"
+#include "PlusProfiler.h"
+#include "PlusTransformInterpolationBatch.h"
 #include "igsioMath.h"
 #include "igsioTrackedFrame.h"
 #include "vtkPlusBuffer.h"
 #include "vtkPlusDevice.h"
-#include "vtkPlusSequenceIO.h"
+#include "vtkPlusTrackingSequenceFile.h"
+#include "vtkIGSIOSequenceIO.h"
+#include "vtkIGSIOSequenceIOBase.h"
 #include "vtkIGSIOTrackedFrameList.h"
 
 // VTK includes
+#include <vtkDataArray.h>
 #include <vtkDoubleArray.h>
 #include <vtkImageData.h>
 #include <vtkIntArray.h>
 #include <vtkMath.h>
 #include <vtkMatrix4x4.h>
 #include <vtkObjectFactory.h>
+#include <vtkPointData.h>
 #include <vtkUnsignedLongLongArray.h>
 
+// STL includes
+#include <algorithm>
+#include <iomanip>
+
 // vtkAddon includes
 #include <vtkStreamingVolumeCodec.h>
 
 static const double NEGLIGIBLE_TIME_DIFFERENCE = 0.00001; // in seconds, used for comparing between exact timestamps
+static const size_t SEQUENCE_FILE_WRITE_CHUNK_SIZE_BYTES = 8 * 1024 * 1024; // frames are written to sequence files in chunks of this size to limit memory usage
 static const double ANGLE_INTERPOLATION_WARNING_THRESHOLD_DEG = 10; // if the interpolated orientation differs from both the interpolated orientation by more than this threshold then display a warning
 
+//----------------------------------------------------------------------------
+// Flip and clip the image by the PixelCodec row kernels. Returns false if the kernels cannot perform the orientation change
+// (transposing, doubled RF rows or columns) or the clip rectangle is not inside the image, then the generic
+// igsioVideoFrame::GetOrientedClippedImage has to be used.
+static bool FlipClipImageFast(const unsigned char* imageDataPtr, const igsioVideoFrame::FlipInfoType& flipInfo, igsioCommon::VTKScalarPixelType pixelType,
+                              unsigned int numberOfScalarComponents, const FrameSizeType& inputFrameSizeInPx, igsioVideoFrame& outputFrame,
+                              const std::array<int, 3>& clipRectangleOrigin, const std::array<int, 3>& clipRectangleSize)
+{
+  if (flipInfo.tranpose != igsioVideoFrame::TRANSPOSE_NONE || flipInfo.doubleRow || flipInfo.doubleColumn)
+  {
+    return false;
+  }
+
+  int inputSize[3] = { static_cast<int>(inputFrameSizeInPx[0]), static_cast<int>(inputFrameSizeInPx[1]), static_cast<int>(inputFrameSizeInPx[2]) };
+  int clipOrigin[3] = { 0, 0, 0 };
+  int clipSize[3] = { inputSize[0], inputSize[1], inputSize[2] };
+  if (igsioCommon::IsClippingRequested(clipRectangleOrigin, clipRectangleSize))
+  {
+    for (int i = 0; i < 3; ++i)
+    {
+      clipOrigin[i] = clipRectangleOrigin[i];
+      clipSize[i] = clipRectangleSize[i];
+      if (clipOrigin[i] < 0 || clipSize[i] <= 0 || clipOrigin[i] + clipSize[i] > inputSize[i])
+      {
+        return false;
+      }
+    }
+  }
+
+  unsigned char* outputDataPtr = static_cast<unsigned char*>(outputFrame.GetScalarPointer());
+  if (outputDataPtr == NULL)
+  {
+    return false;
+  }
+  const int bytesPerPixel = igsioVideoFrame::GetNumberOfBytesPerScalar(pixelType) * numberOfScalarComponents;
+  PixelCodec::FlipClipImage(imageDataPtr, inputSize, bytesPerPixel, clipOrigin, clipSize, flipInfo.hFlip, flipInfo.vFlip, flipInfo.eFlip, outputDataPtr);
+  return true;
+}
+
 vtkStandardNewMacro(vtkPlusBuffer);
 
 #define LOCAL_LOG_ERROR(msg) \
@@ -84,6 +136,10 @@ vtkPlusBuffer::vtkPlusBuffer()
   , StreamBuffer(vtkPlusTimestampedCircularBuffer::New())
   , MaxAllowedTimeDifference(0.5)
   , DescriptiveName(NULL)
+  , FrameMemoryAllocation(FRAME_MEMORY_ALLOCATION_DEFAULT)
+  , FrameMemoryNumaNode(-1)
+  , FrameMemory(NULL)
+  , FrameMemoryPlacedForWriterThread(false)
 {
   this->FrameSize[0] = 0;
   this->FrameSize[1] = 0;
@@ -103,6 +159,9 @@ vtkPlusBuffer::~vtkPlusBuffer()
     this->StreamBuffer->Delete();
     this->StreamBuffer = NULL;
   }
+  // the frames that used the contiguous memory are deleted with the stream buffer
+  delete this->FrameMemory;
+  this->FrameMemory = NULL;
 }
 
 //----------------------------------------------------------------------------
@@ -113,6 +172,12 @@ void vtkPlusBuffer::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "Scalar pixel type: " << vtkImageScalarTypeNameMacro(this->GetPixelType()) << std::endl;
   os << indent << "Image type: " << igsioCommon::GetStringFromUsImageType(this->GetImageType()) << std::endl;
   os << indent << "Image orientation: " << igsioCommon::GetStringFromUsImageOrientation(this->GetImageOrientation()) << std::endl;
+  os << indent << "Frame memory allocation: " << (this->FrameMemoryAllocation == FRAME_MEMORY_ALLOCATION_CONTIGUOUS_LARGE_PAGES ? "CONTIGUOUS_LARGE_PAGES" : "DEFAULT") << std::endl;
+  if (this->FrameMemory != NULL)
+  {
+    os << indent << "Frame memory: " << this->FrameMemory->GetSize() << " bytes, large pages: " << (this->FrameMemory->GetUsingLargePages() ? "yes" : "no")
+       << ", NUMA node: " << this->FrameMemory->GetNumaNode() << std::endl;
+  }
 
   os << indent << "StreamBuffer: " << this->StreamBuffer << "\n";
   if (this->StreamBuffer)
@@ -138,9 +203,157 @@ PlusStatus vtkPlusBuffer::AllocateMemoryForFrames()
       }
     }
   }
+
+  if (this->FrameMemoryAllocation == FRAME_MEMORY_ALLOCATION_CONTIGUOUS_LARGE_PAGES)
+  {
+    // The memory will be moved to the NUMA node of the capture thread when the first frame is added
+    this->FrameMemoryPlacedForWriterThread = false;
+    if (this->AllocateFrameMemoryRegion(this->FrameMemoryNumaNode) != PLUS_SUCCESS)
+    {
+      result = PLUS_FAIL;
+    }
+  }
+  else
+  {
+    this->ReleaseFrameMemoryRegion();
+  }
   return result;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::AllocateFrameMemoryRegion(int numaNode)
+{
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+
+  // Frames start at cache line boundaries
+  const size_t frameAlignment = 64;
+  size_t frameSizeInBytes = 0;
+  for (int i = 0; i < this->StreamBuffer->GetBufferSize(); ++i)
+  {
+    igsioVideoFrame& frame = this->StreamBuffer->GetBufferItemPointerFromBufferIndex(i)->GetFrame();
+    if (!frame.IsFrameEncoded() && frame.GetImage() != NULL && frame.GetImage()->GetPointData()->GetScalars() != NULL)
+    {
+      vtkDataArray* scalars = frame.GetImage()->GetPointData()->GetScalars();
+      frameSizeInBytes = std::max(frameSizeInBytes, static_cast<size_t>(scalars->GetNumberOfValues()) * scalars->GetDataTypeSize());
+    }
+  }
+  if (frameSizeInBytes == 0)
+  {
+    this->ReleaseFrameMemoryRegion();
+    return PLUS_SUCCESS;
+  }
+  size_t frameStrideInBytes = (frameSizeInBytes + frameAlignment - 1) / frameAlignment * frameAlignment;
+
+  FrameMemoryRegion* frameMemory = new FrameMemoryRegion;
+  if (frameMemory->Allocate(frameStrideInBytes * this->StreamBuffer->GetBufferSize(), true, numaNode) != PLUS_SUCCESS)
+  {
+    // frames keep using their current memory
+    LOCAL_LOG_ERROR("Failed to allocate contiguous memory for " << this->StreamBuffer->GetBufferSize() << " frames");
+    delete frameMemory;
+    return PLUS_FAIL;
+  }
+
+  // Frames that own their memory release it, frames in the previous region are moved to the new region
+  for (int i = 0; i < this->StreamBuffer->GetBufferSize(); ++i)
+  {
+    igsioVideoFrame& frame = this->StreamBuffer->GetBufferItemPointerFromBufferIndex(i)->GetFrame();
+    if (frame.IsFrameEncoded() || frame.GetImage() == NULL || frame.GetImage()->GetPointData()->GetScalars() == NULL)
+    {
+      continue;
+    }
+    // Pixels that are shared with frames outside the buffer stay where they are
+    StreamBufferItem::DetachFrameImage(frame);
+    vtkDataArray* scalars = frame.GetImage()->GetPointData()->GetScalars();
+    scalars->SetVoidArray(frameMemory->GetPointer() + i * frameStrideInBytes, scalars->GetNumberOfValues(), 1 /* do not delete the memory */);
+    frame.GetImage()->Modified();
+  }
+
+  delete this->FrameMemory;
+  this->FrameMemory = frameMemory;
+
+  LOCAL_LOG_DEBUG("Allocated " << this->FrameMemory->GetSize() << " bytes of contiguous frame memory (large pages: " << (this->FrameMemory->GetUsingLargePages() ? "yes" : "no")
+                  << ", NUMA node: " << this->FrameMemory->GetNumaNode() << ")");
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::ReleaseFrameMemoryRegion()
+{
+  if (this->FrameMemory == NULL)
+  {
+    return;
+  }
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  for (int i = 0; i < this->StreamBuffer->GetBufferSize(); ++i)
+  {
+    igsioVideoFrame& frame = this->StreamBuffer->GetBufferItemPointerFromBufferIndex(i)->GetFrame();
+    if (frame.IsFrameEncoded() || frame.GetImage() == NULL || frame.GetImage()->GetPointData()->GetScalars() == NULL)
+    {
+      continue;
+    }
+    vtkDataArray* scalars = frame.GetImage()->GetPointData()->GetScalars();
+    if (this->FrameMemory->Contains(scalars->GetVoidPointer(0)))
+    {
+      // AllocateScalars would keep using the region memory if the array size does not change, so copy the pixels into a new array
+      vtkSmartPointer<vtkDataArray> ownScalars = vtkSmartPointer<vtkDataArray>::Take(scalars->NewInstance());
+      ownScalars->DeepCopy(scalars);
+      frame.GetImage()->GetPointData()->SetScalars(ownScalars);
+    }
+  }
+  delete this->FrameMemory;
+  this->FrameMemory = NULL;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::PlaceFrameMemoryForWriterThread()
+{
+  if (this->FrameMemory == NULL || this->FrameMemoryNumaNode >= 0 || this->FrameMemoryPlacedForWriterThread)
+  {
+    return;
+  }
+  this->FrameMemoryPlacedForWriterThread = true;
+
+  if (FrameMemoryRegion::GetNumberOfNumaNodes() < 2)
+  {
+    return;
+  }
+  int numaNode = FrameMemoryRegion::GetCurrentThreadNumaNode();
+  if (numaNode < 0 || numaNode == this->FrameMemory->GetNumaNode())
+  {
+    return;
+  }
+  // No frames have been added since the allocation, so the content does not have to be preserved
+  this->AllocateFrameMemoryRegion(numaNode);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::SetFrameMemoryAllocation(FrameMemoryAllocationType allocation)
+{
+  if (allocation == this->FrameMemoryAllocation)
+  {
+    // no change
+    return PLUS_SUCCESS;
+  }
+  this->FrameMemoryAllocation = allocation;
+  return AllocateMemoryForFrames();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::SetFrameMemoryNumaNode(int numaNode)
+{
+  if (numaNode == this->FrameMemoryNumaNode)
+  {
+    // no change
+    return PLUS_SUCCESS;
+  }
+  this->FrameMemoryNumaNode = numaNode;
+  if (this->FrameMemoryAllocation != FRAME_MEMORY_ALLOCATION_CONTIGUOUS_LARGE_PAGES)
+  {
+    return PLUS_SUCCESS;
+  }
+  return AllocateMemoryForFrames();
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusBuffer::SetLocalTimeOffsetSec(double offsetSec)
 {
@@ -159,6 +372,28 @@ int vtkPlusBuffer::GetBufferSize()
   return this->StreamBuffer->GetBufferSize();
 }
 
+//----------------------------------------------------------------------------
+size_t vtkPlusBuffer::GetMemoryUsageBytes()
+{
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  size_t memoryUsageBytes = this->StreamBuffer->GetBufferSize() * sizeof(StreamBufferItem);
+  if (this->FrameMemory != NULL)
+  {
+    memoryUsageBytes += this->FrameMemory->GetSize();
+  }
+  for (int i = 0; i < this->StreamBuffer->GetBufferSize(); ++i)
+  {
+    igsioVideoFrame& frame = this->StreamBuffer->GetBufferItemPointerFromBufferIndex(i)->GetFrame();
+    if (this->FrameMemory != NULL && !frame.IsFrameEncoded())
+    {
+      // the pixel data is in the contiguous frame memory region
+      continue;
+    }
+    memoryUsageBytes += MemoryAccounting::GetVideoFrameSizeBytes(frame);
+  }
+  return memoryUsageBytes;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusBuffer::SetBufferSize(int bufsize)
 {
@@ -321,6 +556,7 @@ PlusStatus vtkPlusBuffer::AddItem(const igsioFieldMapType& fields,
                                   double unfilteredTimestamp/*=UNDEFINED_TIMESTAMP*/,
                                   double filteredTimestamp/*=UNDEFINED_TIMESTAMP*/)
 {
+  PLUS_PROFILE_SCOPE("vtkPlusBuffer::AddItem");
   if (fields.empty())
   {
     return PLUS_SUCCESS;
@@ -377,14 +613,14 @@ PlusStatus vtkPlusBuffer::AddItem(const igsioFieldMapType& fields,
   for (igsioFieldMapType::const_iterator it = fields.begin(); it != fields.end(); ++it)
   {
     newObjectInBuffer->SetFrameField(it->first, it->second.second, it->second.first);
-    std::string name(it->first);
   }
 
+  this->StreamBuffer->PublishNewItem(itemUid);
   return PLUS_SUCCESS;
 }
 
 //----------------------------------------------------------------------------
-PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr,
+PlusStatus vtkPlusBuffer::AddItem(const void* imageDataPtr,
                                   US_IMAGE_ORIENTATION usImageOrientation,
                                   const FrameSizeType& inputFrameSizeInPx,
                                   igsioCommon::VTKScalarPixelType pixelType,
@@ -399,6 +635,7 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr,
                                   const igsioFieldMapType* customFields /*= NULL */,
                                   vtkStreamingVolumeFrame* encodedFrame /*=NULL*/)
 {
+  PLUS_PROFILE_SCOPE("vtkPlusBuffer::AddItem");
   if (unfilteredTimestamp == UNDEFINED_TIMESTAMP)
   {
     unfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
@@ -464,6 +701,7 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr,
   int bufferIndex(0);
   BufferItemUidType itemUid;
   igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  this->PlaceFrameMemoryForWriterThread();
   if (this->StreamBuffer->PrepareForNewItem(filteredTimestamp, itemUid, bufferIndex) != PLUS_SUCCESS)
   {
     // Just a debug message, because we want to avoid unnecessary warning messages if the timestamp is the same as last one
@@ -497,10 +735,14 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr,
   // Skip the numberOfBytesToSkip bytes, e.g. header size
   if (imageDataPtr != NULL)
   {
-    unsigned char* byteImageDataPtr = reinterpret_cast<unsigned char*>(imageDataPtr);
+    // Frames that have been read from this slot keep the previous pixels
+    StreamBufferItem::DetachFrameImage(newObjectInBuffer->GetFrame());
+    const unsigned char* byteImageDataPtr = reinterpret_cast<const unsigned char*>(imageDataPtr);
     byteImageDataPtr += numberOfBytesToSkip;
 
-    if (igsioVideoFrame::GetOrientedClippedImage(byteImageDataPtr, flipInfo, imageType, pixelType, numberOfScalarComponents, inputFrameSizeInPx, newObjectInBuffer->GetFrame(), clipRectangleOrigin, clipRectangleSize) != PLUS_SUCCESS)
+    // GetOrientedClippedImage only reads the input image, it just does not take a const pointer
+    if (!FlipClipImageFast(byteImageDataPtr, flipInfo, pixelType, numberOfScalarComponents, inputFrameSizeInPx, newObjectInBuffer->GetFrame(), clipRectangleOrigin, clipRectangleSize)
+        && igsioVideoFrame::GetOrientedClippedImage(const_cast<unsigned char*>(byteImageDataPtr), flipInfo, imageType, pixelType, numberOfScalarComponents, inputFrameSizeInPx, newObjectInBuffer->GetFrame(), clipRectangleOrigin, clipRectangleSize) != PLUS_SUCCESS)
     {
       LOCAL_LOG_ERROR("Failed to convert input US image to the requested orientation!");
       return PLUS_FAIL;
@@ -523,20 +765,21 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr,
     for (igsioFieldMapType::const_iterator it = customFields->begin(); it != customFields->end(); ++it)
     {
       newObjectInBuffer->SetFrameField(it->first, it->second.second, it->second.first);
-      std::string name(it->first);
-      if (name.find("Transform") != std::string::npos)
+      if (it->first.find("Transform") != std::string::npos)
       {
         newObjectInBuffer->SetValidTransformData(true);
       }
     }
   }
 
+  this->StreamBuffer->PublishNewItem(itemUid);
   return PLUS_SUCCESS;
 }
 
 //----------------------------------------------------------------------------
-PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr, const FrameSizeType& frameSize, unsigned int inputFrameSizeInBytes, US_IMAGE_TYPE imageType, long frameNumber, double unfilteredTimestamp /*= UNDEFINED_TIMESTAMP*/, double filteredTimestamp /*= UNDEFINED_TIMESTAMP*/, const igsioFieldMapType* customFields /*= NULL*/)
+PlusStatus vtkPlusBuffer::AddItem(const void* imageDataPtr, const FrameSizeType& frameSize, unsigned int inputFrameSizeInBytes, US_IMAGE_TYPE imageType, long frameNumber, double unfilteredTimestamp /*= UNDEFINED_TIMESTAMP*/, double filteredTimestamp /*= UNDEFINED_TIMESTAMP*/, const igsioFieldMapType* customFields /*= NULL*/)
 {
+  PLUS_PROFILE_SCOPE("vtkPlusBuffer::AddItem");
   if (unfilteredTimestamp == UNDEFINED_TIMESTAMP)
   {
     unfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
@@ -577,6 +820,7 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr, const FrameSizeType& frame
   int bufferIndex(0);
   BufferItemUidType itemUid;
   igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  this->PlaceFrameMemoryForWriterThread();
   if (this->StreamBuffer->PrepareForNewItem(filteredTimestamp, itemUid, bufferIndex) != PLUS_SUCCESS)
   {
     // Just a debug message, because we want to avoid unnecessary warning messages if the timestamp is the same as last one
@@ -604,6 +848,8 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr, const FrameSizeType& frame
   newObjectInBuffer->SetIndex(frameNumber);
   newObjectInBuffer->SetUid(itemUid);
   newObjectInBuffer->GetFrame().SetImageType(imageType);
+  // Frames that have been read from this slot keep the previous pixels
+  StreamBufferItem::DetachFrameImage(newObjectInBuffer->GetFrame());
   memcpy(newObjectInBuffer->GetFrame().GetImage()->GetScalarPointer(), imageDataPtr, inputFrameSizeInBytes);
 
   // Add custom fields
@@ -612,8 +858,7 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr, const FrameSizeType& frame
     for (igsioFieldMapType::const_iterator it = customFields->begin(); it != customFields->end(); ++it)
     {
       newObjectInBuffer->SetFrameField(it->first, it->second.second, it->second.first);
-      std::string name(it->first);
-      if (name.find("Transform") != std::string::npos)
+      if (it->first.find("Transform") != std::string::npos)
       {
         newObjectInBuffer->SetValidTransformData(true);
       }
@@ -622,12 +867,249 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr, const FrameSizeType& frame
 
   newObjectInBuffer->SetFrameField("FrameSizeInBytes", igsioCommon::ToString<unsigned int>(inputFrameSizeInBytes));
 
+  this->StreamBuffer->PublishNewItem(itemUid);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::ReserveNewItem(void*& imageDataPtr, unsigned int& frameSizeInBytes)
+{
+  imageDataPtr = NULL;
+  frameSizeInBytes = 0;
+
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  this->PlaceFrameMemoryForWriterThread();
+  int bufferIndex(0);
+  if (this->StreamBuffer->ReserveNewItem(bufferIndex) != PLUS_SUCCESS)
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to reserve new frame in video buffer!");
+    return PLUS_FAIL;
+  }
+
+  StreamBufferItem* newObjectInBuffer = this->StreamBuffer->GetBufferItemPointerFromBufferIndex(bufferIndex);
+  if (newObjectInBuffer == NULL || newObjectInBuffer->GetFrame().IsFrameEncoded() || newObjectInBuffer->GetFrame().GetImage() == NULL)
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to reserve new frame in video buffer - frame memory is not allocated!");
+    this->StreamBuffer->CancelReservedItem();
+    return PLUS_FAIL;
+  }
+
+  // Frames that have been read from this slot keep the previous pixels
+  StreamBufferItem::DetachFrameImage(newObjectInBuffer->GetFrame());
+  imageDataPtr = newObjectInBuffer->GetFrame().GetImage()->GetScalarPointer();
+  frameSizeInBytes = newObjectInBuffer->GetFrame().GetFrameSizeInBytes();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::CommitReservedItem(long frameNumber,
+    double unfilteredTimestamp /*= UNDEFINED_TIMESTAMP*/,
+    double filteredTimestamp /*= UNDEFINED_TIMESTAMP*/,
+    const igsioFieldMapType* customFields /*= NULL*/)
+{
+  if (this->StreamBuffer->GetReservedBufferIndex() < 0)
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Unable to commit frame - no frame is reserved in the video buffer!");
+    return PLUS_FAIL;
+  }
+
+  if (unfilteredTimestamp == UNDEFINED_TIMESTAMP)
+  {
+    unfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+  }
+
+  if (filteredTimestamp == UNDEFINED_TIMESTAMP)
+  {
+    bool filteredTimestampProbablyValid = true;
+    if (this->StreamBuffer->CreateFilteredTimeStampForItem(frameNumber, unfilteredTimestamp, filteredTimestamp, filteredTimestampProbablyValid) != PLUS_SUCCESS)
+    {
+      LOCAL_LOG_WARNING("Failed to create filtered timestamp for video buffer item with item index: " << frameNumber);
+      this->StreamBuffer->CancelReservedItem();
+      return PLUS_FAIL;
+    }
+    if (!filteredTimestampProbablyValid)
+    {
+      LOG_INFO("Filtered timestamp is probably invalid for video buffer item with item index=" << frameNumber << ", time=" <<
+               unfilteredTimestamp << ". The item may have been tagged with an inaccurate timestamp, therefore it will not be recorded.");
+      this->StreamBuffer->CancelReservedItem();
+      return PLUS_SUCCESS;
+    }
+  }
+  else
+  {
+    this->StreamBuffer->AddToTimeStampReport(frameNumber, unfilteredTimestamp, filteredTimestamp);
+  }
+
+  int bufferIndex(0);
+  BufferItemUidType itemUid;
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  // The item is stored in the reserved slot. If the reserved slot has been overwritten then the item is not added
+  // (and the latest UID is not advanced), so readers never get an item whose pixels were not written.
+  if (this->StreamBuffer->PrepareForNewItem(filteredTimestamp, itemUid, bufferIndex) != PLUS_SUCCESS)
+  {
+    // Just a debug message, because we want to avoid unnecessary warning messages if the timestamp is the same as last one
+    LOCAL_LOG_DEBUG("vtkPlusBuffer: Failed to prepare for adding new frame to video buffer!");
+    this->StreamBuffer->CancelReservedItem();
+    return PLUS_FAIL;
+  }
+
+  // the pixel data is already in place, only the item properties have to be set
+  StreamBufferItem* newObjectInBuffer = this->StreamBuffer->GetBufferItemPointerFromBufferIndex(bufferIndex);
+  if (newObjectInBuffer == NULL)
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get pointer to video buffer object from the video buffer for the new frame!");
+    return PLUS_FAIL;
+  }
+
+  newObjectInBuffer->SetFilteredTimestamp(filteredTimestamp);
+  newObjectInBuffer->SetUnfilteredTimestamp(unfilteredTimestamp);
+  newObjectInBuffer->SetIndex(frameNumber);
+  newObjectInBuffer->SetUid(itemUid);
+  newObjectInBuffer->GetFrame().SetImageType(this->ImageType);
+  newObjectInBuffer->GetFrame().GetImage()->Modified();
+
+  // Add custom fields
+  if (customFields != NULL)
+  {
+    for (igsioFieldMapType::const_iterator it = customFields->begin(); it != customFields->end(); ++it)
+    {
+      newObjectInBuffer->SetFrameField(it->first, it->second.second, it->second.first);
+      if (it->first.find("Transform") != std::string::npos)
+      {
+        newObjectInBuffer->SetValidTransformData(true);
+      }
+    }
+  }
+
+  this->StreamBuffer->PublishNewItem(itemUid);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusBuffer::CanAddItemBySwappingPixels()
+{
+  return this->FrameMemory == NULL && this->StreamBuffer->GetReservedBufferIndex() < 0;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::AddItemBySwappingPixels(vtkSmartPointer<vtkDataArray>& pixels,
+    long frameNumber,
+    double unfilteredTimestamp /*= UNDEFINED_TIMESTAMP*/,
+    double filteredTimestamp /*= UNDEFINED_TIMESTAMP*/,
+    const igsioFieldMapType* customFields /*= NULL*/)
+{
+  PLUS_PROFILE_SCOPE("vtkPlusBuffer::AddItemBySwappingPixels");
+  if (pixels == NULL)
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Unable to add NULL frame to video buffer!");
+    return PLUS_FAIL;
+  }
+  if (!this->CanAddItemBySwappingPixels())
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Unable to add frame by swapping pixels - the buffer uses contiguous frame memory or a frame is reserved!");
+    return PLUS_FAIL;
+  }
+  const vtkIdType numberOfPixels = static_cast<vtkIdType>(this->FrameSize[0]) * this->FrameSize[1] * this->FrameSize[2];
+  if (pixels->GetDataType() != this->PixelType
+      || pixels->GetNumberOfComponents() != static_cast<int>(this->NumberOfScalarComponents)
+      || pixels->GetNumberOfTuples() != numberOfPixels)
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Unable to add frame to video buffer - frame format doesn't match!");
+    return PLUS_FAIL;
+  }
+
+  if (unfilteredTimestamp == UNDEFINED_TIMESTAMP)
+  {
+    unfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+  }
+
+  if (filteredTimestamp == UNDEFINED_TIMESTAMP)
+  {
+    bool filteredTimestampProbablyValid = true;
+    if (this->StreamBuffer->CreateFilteredTimeStampForItem(frameNumber, unfilteredTimestamp, filteredTimestamp, filteredTimestampProbablyValid) != PLUS_SUCCESS)
+    {
+      LOCAL_LOG_WARNING("Failed to create filtered timestamp for video buffer item with item index: " << frameNumber);
+      return PLUS_FAIL;
+    }
+    if (!filteredTimestampProbablyValid)
+    {
+      LOG_INFO("Filtered timestamp is probably invalid for video buffer item with item index=" << frameNumber << ", time=" <<
+               unfilteredTimestamp << ". The item may have been tagged with an inaccurate timestamp, therefore it will not be recorded.");
+      return PLUS_SUCCESS;
+    }
+  }
+  else
+  {
+    this->StreamBuffer->AddToTimeStampReport(frameNumber, unfilteredTimestamp, filteredTimestamp);
+  }
+
+  int bufferIndex(0);
+  BufferItemUidType itemUid;
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  if (this->StreamBuffer->PrepareForNewItem(filteredTimestamp, itemUid, bufferIndex) != PLUS_SUCCESS)
+  {
+    // Just a debug message, because we want to avoid unnecessary warning messages if the timestamp is the same as last one
+    LOCAL_LOG_DEBUG("vtkPlusBuffer: Failed to prepare for adding new frame to video buffer!");
+    return PLUS_FAIL;
+  }
+
+  StreamBufferItem* newObjectInBuffer = this->StreamBuffer->GetBufferItemPointerFromBufferIndex(bufferIndex);
+  if (newObjectInBuffer == NULL || newObjectInBuffer->GetFrame().IsFrameEncoded() || newObjectInBuffer->GetFrame().GetImage() == NULL)
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get the frame of the video buffer for the new frame!");
+    return PLUS_FAIL;
+  }
+
+  // The slot takes the new pixels, the caller gets the pixels of the overwritten frame for receiving the next frame
+  vtkImageData* image = newObjectInBuffer->GetFrame().GetImage();
+  vtkSmartPointer<vtkDataArray> previousPixels = image->GetPointData()->GetScalars();
+  image->GetPointData()->SetScalars(pixels);
+  image->Modified();
+  if (previousPixels == NULL || previousPixels->GetReferenceCount() > 1
+      || previousPixels->GetDataType() != pixels->GetDataType()
+      || previousPixels->GetNumberOfComponents() != pixels->GetNumberOfComponents()
+      || previousPixels->GetNumberOfTuples() != pixels->GetNumberOfTuples())
+  {
+    // Frames that have been read from this slot keep the previous pixels
+    previousPixels = vtkSmartPointer<vtkDataArray>::Take(pixels->NewInstance());
+    previousPixels->SetNumberOfComponents(pixels->GetNumberOfComponents());
+    previousPixels->SetNumberOfTuples(pixels->GetNumberOfTuples());
+  }
+  pixels = previousPixels;
+
+  newObjectInBuffer->SetFilteredTimestamp(filteredTimestamp);
+  newObjectInBuffer->SetUnfilteredTimestamp(unfilteredTimestamp);
+  newObjectInBuffer->SetIndex(frameNumber);
+  newObjectInBuffer->SetUid(itemUid);
+  newObjectInBuffer->GetFrame().SetImageType(this->ImageType);
+
+  // Add custom fields
+  if (customFields != NULL)
+  {
+    for (igsioFieldMapType::const_iterator it = customFields->begin(); it != customFields->end(); ++it)
+    {
+      newObjectInBuffer->SetFrameField(it->first, it->second.second, it->second.first);
+      if (it->first.find("Transform") != std::string::npos)
+      {
+        newObjectInBuffer->SetValidTransformData(true);
+      }
+    }
+  }
+
+  this->StreamBuffer->PublishNewItem(itemUid);
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::CancelReservedItem()
+{
+  this->StreamBuffer->CancelReservedItem();
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusBuffer::AddTimeStampedItem(vtkMatrix4x4* matrix, ToolStatus status, unsigned long frameNumber, double unfilteredTimestamp, double filteredTimestamp/*=UNDEFINED_TIMESTAMP*/, const igsioFieldMapType* customFields /*= NULL*/)
 {
+  PLUS_PROFILE_SCOPE("vtkPlusBuffer::AddTimeStampedItem");
   if (matrix == NULL)
   {
     LOCAL_LOG_ERROR("vtkPlusBuffer: Unable to add NULL matrix to tracker buffer!");
@@ -688,17 +1170,23 @@ PlusStatus vtkPlusBuffer::AddTimeStampedItem(vtkMatrix4x4* matrix, ToolStatus st
     for (igsioFieldMapType::const_iterator it = customFields->begin(); it != customFields->end(); ++it)
     {
       newObjectInBuffer->SetFrameField(it->first, it->second.second, it->second.first);
-      std::string name(it->first);
-      if (name.find("Transform") != std::string::npos)
+      if (it->first.find("Transform") != std::string::npos)
       {
         newObjectInBuffer->SetValidTransformData(true);
       }
     }
   }
 
+  this->StreamBuffer->PublishNewItem(itemUid);
   return itemStatus;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::CreateFilteredTimeStampForItem(unsigned long frameNumber, double unfilteredTimestamp, double& filteredTimestamp, bool& filteredTimestampProbablyValid)
+{
+  return this->StreamBuffer->CreateFilteredTimeStampForItem(frameNumber, unfilteredTimestamp, filteredTimestamp, filteredTimestampProbablyValid);
+}
+
 //----------------------------------------------------------------------------
 ItemStatus vtkPlusBuffer::GetLatestTimeStamp(double& latestTimestamp)
 {
@@ -711,6 +1199,12 @@ ItemStatus vtkPlusBuffer::GetOldestTimeStamp(double& oldestTimestamp)
   return this->StreamBuffer->GetOldestTimeStamp(oldestTimestamp);
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::WaitForItemNewerThan(double timestamp, double timeoutSec)
+{
+  return this->StreamBuffer->WaitForItemNewerThan(timestamp, timeoutSec);
+}
+
 //----------------------------------------------------------------------------
 ItemStatus vtkPlusBuffer::GetTimeStamp(BufferItemUidType uid, double& timestamp)
 {
@@ -742,6 +1236,30 @@ int vtkPlusBuffer::GetAveragedItemsForFiltering()
   return this->StreamBuffer->GetAveragedItemsForFiltering();
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::SetTimestampOutlierRejectionThreshold(double threshold)
+{
+  this->StreamBuffer->SetOutlierRejectionThreshold(threshold);
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusBuffer::GetTimestampOutlierRejectionThreshold()
+{
+  return this->StreamBuffer->GetOutlierRejectionThreshold();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::SetFrameRateStatisticsWindowSec(double windowSec)
+{
+  this->StreamBuffer->SetFrameRateStatisticsWindowSec(windowSec);
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusBuffer::GetFrameRateStatisticsWindowSec()
+{
+  return this->StreamBuffer->GetFrameRateStatisticsWindowSec();
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusBuffer::SetStartTime(double startTime)
 {
@@ -761,7 +1279,7 @@ PlusStatus vtkPlusBuffer::GetTimeStampReportTable(vtkTable* timeStampReportTable
 }
 
 //----------------------------------------------------------------------------
-ItemStatus vtkPlusBuffer::GetStreamBufferItem(BufferItemUidType uid, StreamBufferItem* bufferItem)
+ItemStatus vtkPlusBuffer::GetStreamBufferItem(BufferItemUidType uid, StreamBufferItem* bufferItem, bool shareImageData/*=false*/)
 {
   if (bufferItem == NULL)
   {
@@ -779,6 +1297,17 @@ ItemStatus vtkPlusBuffer::GetStreamBufferItem(BufferItemUidType uid, StreamBuffe
     return itemStatus;
   }
 
+  // Pixels in the contiguous frame memory region are not reference counted, so they cannot be shared
+  if (shareImageData && this->FrameMemory == NULL)
+  {
+    if (bufferItem->ShallowCopy(dataItem) != PLUS_SUCCESS)
+    {
+      LOCAL_LOG_WARNING("Failed to copy data item");
+      return ITEM_UNKNOWN_ERROR;
+    }
+    return ITEM_OK;
+  }
+
   if (bufferItem->DeepCopy(dataItem) != PLUS_SUCCESS)
   {
     LOCAL_LOG_WARNING("Failed to copy data item");
@@ -1076,67 +1605,264 @@ PlusStatus vtkPlusBuffer::WriteToSequenceFile(const char* filename, bool useComp
 {
   LOG_TRACE("vtkPlusBuffer::WriteToSequenceFile");
 
+  if (this->GetNumberOfItems() < 1)
+  {
+    LOCAL_LOG_ERROR("Unable to write buffer to sequence file: buffer is empty");
+    return PLUS_FAIL;
+  }
+
+  return this->WriteRangeToSequenceFile(filename, this->GetOldestItemUidInBuffer(), this->GetLatestItemUidInBuffer(), useCompression);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::WriteRangeToSequenceFile(const char* filename, BufferItemUidType firstUid, BufferItemUidType lastUid, bool useCompression /*=false*/,
+    double maxBandwidthBytesPerSec /*=0*/, const std::atomic<bool>* cancelRequested /*=NULL*/)
+{
+  LOG_TRACE("vtkPlusBuffer::WriteRangeToSequenceFile(" << filename << ", " << firstUid << ", " << lastUid << ")");
+
+  if (firstUid > lastUid)
+  {
+    LOCAL_LOG_ERROR("Unable to write buffer to sequence file: invalid item range " << firstUid << "-" << lastUid);
+    return PLUS_FAIL;
+  }
+
+  if (vtkPlusTrackingSequenceFile::CanWriteFile(filename))
+  {
+    return this->WriteRangeToTrackingSequenceFile(filename, firstUid, lastUid, cancelRequested);
+  }
+
+  vtkSmartPointer<vtkIGSIOSequenceIOBase> writer = vtkSmartPointer<vtkIGSIOSequenceIOBase>::Take(vtkIGSIOSequenceIO::CreateSequenceHandlerForFile(filename));
+  if (writer == NULL)
+  {
+    LOCAL_LOG_ERROR("Could not create writer for file: " << filename);
+    return PLUS_FAIL;
+  }
+  // Frames of one chunk are collected in the list, the list is cleared after each chunk is written
   vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  writer->SetUseCompression(useCompression);
+  writer->SetTrackedFrameList(trackedFrameList);
+  writer->SetFileName(vtkPlusConfig::GetInstance()->GetOutputPath(filename));
 
   PlusStatus status = PLUS_SUCCESS;
+  bool headerPrepared = false;
+  bool isData3D = false;
+  unsigned long numberOfWrittenFrames = 0;
+  unsigned long numberOfSkippedFrames = 0;
+  size_t chunkSizeBytes = 0;
+  double totalWrittenBytes = 0;
+  const double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+
+  // Write the frames of the current chunk and wait if needed so that the average write speed does not exceed the limit
+  auto writeChunk = [&]() -> PlusStatus
+  {
+    if (trackedFrameList->GetNumberOfTrackedFrames() == 0)
+    {
+      return PLUS_SUCCESS;
+    }
+    if (!headerPrepared)
+    {
+      if (writer->PrepareHeader() != PLUS_SUCCESS)
+      {
+        LOCAL_LOG_ERROR("Unable to prepare header of sequence file " << filename);
+        return PLUS_FAIL;
+      }
+      headerPrepared = true;
+    }
+    if (writer->AppendImagesToHeader() != PLUS_SUCCESS || writer->WriteImages() != PLUS_SUCCESS)
+    {
+      LOCAL_LOG_ERROR("Unable to write images to sequence file " << filename);
+      return PLUS_FAIL;
+    }
+    numberOfWrittenFrames += trackedFrameList->GetNumberOfTrackedFrames();
+    trackedFrameList->Clear();
+    totalWrittenBytes += chunkSizeBytes;
+    chunkSizeBytes = 0;
 
-  for (BufferItemUidType frameUid = this->GetOldestItemUidInBuffer(); frameUid <= this->GetLatestItemUidInBuffer(); ++frameUid)
+    if (maxBandwidthBytesPerSec > 0)
+    {
+      double waitTimeSec = startTime + totalWrittenBytes / maxBandwidthBytesPerSec - vtkIGSIOAccurateTimer::GetSystemTime();
+      if (waitTimeSec > 0)
+      {
+        vtkIGSIOAccurateTimer::Delay(waitTimeSec);
+      }
+    }
+    return PLUS_SUCCESS;
+  };
+
+  for (BufferItemUidType frameUid = firstUid; frameUid <= lastUid; ++frameUid)
   {
+    if (cancelRequested != NULL && *cancelRequested)
+    {
+      LOCAL_LOG_DEBUG("Writing to sequence file " << filename << " is cancelled after " << numberOfWrittenFrames << " frames");
+      break;
+    }
+
+    // The pixels of the buffer slot are shared, the buffer allocates new pixels for the slot when it is overwritten
     StreamBufferItem bufferItem;
-    if (this->GetStreamBufferItem(frameUid, &bufferItem) != ITEM_OK)
+    ItemStatus itemStatus = this->GetStreamBufferItem(frameUid, &bufferItem, true);
+    if (itemStatus == ITEM_NOT_AVAILABLE_ANYMORE)
+    {
+      numberOfSkippedFrames++;
+    }
+    else if (itemStatus != ITEM_OK)
     {
       LOCAL_LOG_ERROR("Unable to get frame from buffer with UID: " << frameUid);
       status = PLUS_FAIL;
-      continue;
     }
+    else
+    {
+      igsioTrackedFrame* trackedFrame = new igsioTrackedFrame;
 
-    igsioTrackedFrame* trackedFrame = new igsioTrackedFrame;
+      // Add image data
+      if (StreamBufferItem::ShareFrameImage(bufferItem.GetFrame(), *trackedFrame->GetImageData()) != PLUS_SUCCESS)
+      {
+        LOCAL_LOG_ERROR("Unable to get image data from buffer item with UID: " << frameUid);
+        status = PLUS_FAIL;
+      }
 
-    // Add image data
-    trackedFrame->SetImageData(bufferItem.GetFrame());
+      // Add tracking data
+      vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+      bufferItem.GetMatrix(matrix);
+      trackedFrame->SetFrameTransform(igsioTransformName("Tool", "Tracker"), matrix);
+      trackedFrame->SetFrameTransformStatus(igsioTransformName("Tool", "Tracker"), bufferItem.GetStatus());
+
+      // Add filtered timestamp
+      double filteredTimestamp = bufferItem.GetFilteredTimestamp(this->GetLocalTimeOffsetSec());
+      std::ostringstream timestampFieldValue;
+      timestampFieldValue << std::fixed << filteredTimestamp;
+      trackedFrame->SetFrameField("Timestamp", timestampFieldValue.str());
+
+      // Add unfiltered timestamp
+      double unfilteredTimestamp = bufferItem.GetUnfilteredTimestamp(this->GetLocalTimeOffsetSec());
+      std::ostringstream unfilteredtimestampFieldValue;
+      unfilteredtimestampFieldValue << std::fixed << unfilteredTimestamp;
+      trackedFrame->SetFrameField("UnfilteredTimestamp", unfilteredtimestampFieldValue.str());
+
+      // Add frame number
+      unsigned long frameNumber = bufferItem.GetIndex();
+      std::ostringstream frameNumberFieldValue;
+      frameNumberFieldValue << std::fixed << frameNumber;
+      trackedFrame->SetFrameField("FrameNumber", frameNumberFieldValue.str());
+
+      // Add custom fields
+      const FrameFieldStore& customFields = bufferItem.GetFrameFields();
+      for (unsigned int i = 0; i < customFields.GetNumberOfFields(); ++i)
+      {
+        trackedFrame->SetFrameField(customFields.GetFieldName(i), customFields.GetFieldValue(i), customFields.GetFieldFlags(i));
+      }
 
-    // Add tracking data
-    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
-    bufferItem.GetMatrix(matrix);
-    trackedFrame->SetFrameTransform(igsioTransformName("Tool", "Tracker"), matrix);
-    trackedFrame->SetFrameTransformStatus(igsioTransformName("Tool", "Tracker"), bufferItem.GetStatus());
+      chunkSizeBytes += bufferItem.GetFrame().GetFrameSizeInBytes();
+      isData3D = (trackedFrame->GetFrameSize()[2] > 1);
 
-    // Add filtered timestamp
-    double filteredTimestamp = bufferItem.GetFilteredTimestamp(this->GetLocalTimeOffsetSec());
-    std::ostringstream timestampFieldValue;
-    timestampFieldValue << std::fixed << filteredTimestamp;
-    trackedFrame->SetFrameField("Timestamp", timestampFieldValue.str());
+      // Add tracked frame to the list
+      trackedFrameList->TakeTrackedFrame(trackedFrame);
+    }
 
-    // Add unfiltered timestamp
-    double unfilteredTimestamp = bufferItem.GetUnfilteredTimestamp(this->GetLocalTimeOffsetSec());
-    std::ostringstream unfilteredtimestampFieldValue;
-    unfilteredtimestampFieldValue << std::fixed << unfilteredTimestamp;
-    trackedFrame->SetFrameField("UnfilteredTimestamp", unfilteredtimestampFieldValue.str());
+    if (chunkSizeBytes >= SEQUENCE_FILE_WRITE_CHUNK_SIZE_BYTES && writeChunk() != PLUS_SUCCESS)
+    {
+      writer->Close();
+      return PLUS_FAIL;
+    }
+  }
+  if (writeChunk() != PLUS_SUCCESS)
+  {
+    writer->Close();
+    return PLUS_FAIL;
+  }
 
-    // Add frame number
-    unsigned long frameNumber = bufferItem.GetIndex();
-    std::ostringstream frameNumberFieldValue;
-    frameNumberFieldValue << std::fixed << frameNumber;
-    trackedFrame->SetFrameField("FrameNumber", frameNumberFieldValue.str());
+  if (!headerPrepared)
+  {
+    LOCAL_LOG_ERROR("No frames were written to sequence file " << filename);
+    return PLUS_FAIL;
+  }
+
+  writer->UpdateDimensionsCustomStrings(numberOfWrittenFrames, isData3D);
+  writer->UpdateFieldInImageHeader(writer->GetDimensionSizeString());
+  writer->UpdateFieldInImageHeader(writer->GetDimensionKindsString());
+  writer->FinalizeHeader();
+  writer->Close();
+
+  if (numberOfSkippedFrames > 0)
+  {
+    LOCAL_LOG_WARNING(numberOfSkippedFrames << " frames were overwritten in the buffer before they could be written to sequence file " << filename);
+  }
+  LOCAL_LOG_DEBUG(numberOfWrittenFrames << " frames written to sequence file " << filename << " in " << std::fixed << std::setprecision(3)
+                  << vtkIGSIOAccurateTimer::GetSystemTime() - startTime << " sec");
 
-    // Add custom fields
-    const igsioFieldMapType& customFields = bufferItem.GetFrameFieldMap();
-    for (igsioFieldMapType::const_iterator cf = customFields.begin(); cf != customFields.end(); ++cf)
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::WriteRangeToTrackingSequenceFile(const char* filename, BufferItemUidType firstUid, BufferItemUidType lastUid, const std::atomic<bool>* cancelRequested)
+{
+  vtkSmartPointer<vtkPlusTrackingSequenceFile> trackingFile = vtkSmartPointer<vtkPlusTrackingSequenceFile>::New();
+  const std::string toolToTrackerTransformName = igsioTransformName("Tool", "Tracker").GetTransformName();
+
+  PlusStatus status = PLUS_SUCCESS;
+  unsigned long numberOfSkippedFrames = 0;
+  const double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  for (BufferItemUidType frameUid = firstUid; frameUid <= lastUid; ++frameUid)
+  {
+    if (cancelRequested != NULL && *cancelRequested)
     {
-      trackedFrame->SetFrameField(cf->first, cf->second.second, cf->second.first);
+      LOCAL_LOG_DEBUG("Writing to tracking sequence file " << filename << " is cancelled after " << trackingFile->GetNumberOfFrames() << " frames");
+      break;
+    }
+
+    // Image data is not written, share it to avoid copying the pixels
+    StreamBufferItem bufferItem;
+    ItemStatus itemStatus = this->GetStreamBufferItem(frameUid, &bufferItem, true);
+    if (itemStatus == ITEM_NOT_AVAILABLE_ANYMORE)
+    {
+      numberOfSkippedFrames++;
+      continue;
+    }
+    else if (itemStatus != ITEM_OK)
+    {
+      LOCAL_LOG_ERROR("Unable to get frame from buffer with UID: " << frameUid);
+      status = PLUS_FAIL;
+      continue;
     }
 
-    // Add tracked frame to the list
-    trackedFrameList->TakeTrackedFrame(trackedFrame);
+    int frameIndex = trackingFile->AddFrame(bufferItem.GetFilteredTimestamp(this->GetLocalTimeOffsetSec()));
+
+    double matrixElements[16];
+    bufferItem.GetMatrixElements(matrixElements);
+    trackingFile->SetFrameTransform(frameIndex, toolToTrackerTransformName, matrixElements, bufferItem.GetStatus());
+
+    std::ostringstream unfilteredTimestampFieldValue;
+    unfilteredTimestampFieldValue << std::fixed << bufferItem.GetUnfilteredTimestamp(this->GetLocalTimeOffsetSec());
+    trackingFile->SetFrameField(frameIndex, "UnfilteredTimestamp", unfilteredTimestampFieldValue.str());
+
+    std::ostringstream frameNumberFieldValue;
+    frameNumberFieldValue << bufferItem.GetIndex();
+    trackingFile->SetFrameField(frameIndex, "FrameNumber", frameNumberFieldValue.str());
+
+    const FrameFieldStore& customFields = bufferItem.GetFrameFields();
+    for (unsigned int i = 0; i < customFields.GetNumberOfFields(); ++i)
+    {
+      trackingFile->SetFrameField(frameIndex, customFields.GetFieldName(i), customFields.GetFieldValue(i));
+    }
   }
 
-  // Save tracked frames to metafile
-  if (vtkPlusSequenceIO::Write(filename, trackedFrameList, trackedFrameList->GetImageOrientation(), useCompression) != PLUS_SUCCESS)
+  if (trackingFile->GetNumberOfFrames() == 0)
+  {
+    LOCAL_LOG_ERROR("No frames were written to tracking sequence file " << filename);
+    return PLUS_FAIL;
+  }
+  if (trackingFile->WriteFile(vtkPlusConfig::GetInstance()->GetOutputPath(filename)) != PLUS_SUCCESS)
   {
-    LOCAL_LOG_ERROR("Failed to save tracked frames to sequence metafile!");
+    LOCAL_LOG_ERROR("Unable to write tracking sequence file " << filename);
     return PLUS_FAIL;
   }
 
+  if (numberOfSkippedFrames > 0)
+  {
+    LOCAL_LOG_WARNING(numberOfSkippedFrames << " frames were overwritten in the buffer before they could be written to tracking sequence file " << filename);
+  }
+  LOCAL_LOG_DEBUG(trackingFile->GetNumberOfFrames() << " frames written to tracking sequence file " << filename << " in " << std::fixed << std::setprecision(3)
+                  << vtkIGSIOAccurateTimer::GetSystemTime() - startTime << " sec");
+
   return status;
 }
 
@@ -1152,10 +1878,34 @@ bool vtkPlusBuffer::GetTimeStampReporting()
   return this->StreamBuffer->GetTimeStampReporting();
 }
 
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::SetTimeStampReportFileName(const std::string& fileName)
+{
+  return this->StreamBuffer->SetTimeStampReportFileName(fileName);
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusBuffer::SetTimeStampReportCapacity(unsigned int capacity)
+{
+  this->StreamBuffer->SetTimeStampReportCapacity(capacity);
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusBuffer::SetLockFreeReads(bool enable)
+{
+  this->StreamBuffer->SetLockFreeReads(enable);
+}
+
+//-----------------------------------------------------------------------------
+bool vtkPlusBuffer::GetLockFreeReads()
+{
+  return this->StreamBuffer->GetLockFreeReads();
+}
+
 //----------------------------------------------------------------------------
-// Returns the two buffer items that are closest previous and next buffer items relative to the specified time.
+// Returns the UIDs of the two buffer items that are closest previous and next buffer items relative to the specified time.
 // itemA is the closest item
-PlusStatus vtkPlusBuffer::GetPrevNextBufferItemFromTime(double time, StreamBufferItem& itemA, StreamBufferItem& itemB)
+PlusStatus vtkPlusBuffer::GetPrevNextBufferItemUidsFromTime(double time, BufferItemUidType& itemAuid, BufferItemUidType& itemBuid)
 {
   igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
 
@@ -1167,7 +1917,8 @@ PlusStatus vtkPlusBuffer::GetPrevNextBufferItemFromTime(double time, StreamBuffe
   //   - time difference between the requested time and itemB is below a threshold
 
   // itemA is the item that is the closest to the requested time, get its UID and time
-  BufferItemUidType itemAuid(0);
+  itemAuid = 0;
+  itemBuid = 0;
   ItemStatus status = this->StreamBuffer->GetItemUidFromTime(time, itemAuid);
   if (status != ITEM_OK)
   {
@@ -1184,7 +1935,8 @@ PlusStatus vtkPlusBuffer::GetPrevNextBufferItemFromTime(double time, StreamBuffe
     }
     return PLUS_FAIL;
   }
-  status = this->GetStreamBufferItem(itemAuid, &itemA);
+  StreamBufferItem* itemA = NULL;
+  status = this->StreamBuffer->GetBufferItemPointerFromUid(itemAuid, itemA);
   if (status != ITEM_OK)
   {
     LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get data buffer item with Uid: " << itemAuid);
@@ -1192,7 +1944,7 @@ PlusStatus vtkPlusBuffer::GetPrevNextBufferItemFromTime(double time, StreamBuffe
   }
 
   // If tracker is out of view, etc. then we don't have a valid before and after the requested time, so we cannot do interpolation
-  if (itemA.GetStatus() != TOOL_OK)
+  if (itemA->GetStatus() != TOOL_OK)
   {
     // tracker is out of view, ...
     LOCAL_LOG_DEBUG("vtkPlusBuffer: Cannot do data interpolation. The closest item to the requested time (time: " << std::fixed << time << ", uid: " << itemAuid << ") is invalid.");
@@ -1211,7 +1963,7 @@ PlusStatus vtkPlusBuffer::GetPrevNextBufferItemFromTime(double time, StreamBuffe
   if (fabs(itemAtime - time) < NEGLIGIBLE_TIME_DIFFERENCE)
   {
     //No need for interpolation, it's very close to the closest element
-    itemB.DeepCopy(&itemA);
+    itemBuid = itemAuid;
     return PLUS_SUCCESS;
   }
 
@@ -1223,7 +1975,6 @@ PlusStatus vtkPlusBuffer::GetPrevNextBufferItemFromTime(double time, StreamBuffe
   }
 
   // Find the closest item on the other side of the timescale (so that time is between itemAtime and itemBtime)
-  BufferItemUidType itemBuid(0);
   if (time < itemAtime)
   {
     // itemBtime < time <itemAtime
@@ -1255,14 +2006,15 @@ PlusStatus vtkPlusBuffer::GetPrevNextBufferItemFromTime(double time, StreamBuffe
     return PLUS_FAIL;
   }
   // Get the item
-  status = this->GetStreamBufferItem(itemBuid, &itemB);
+  StreamBufferItem* itemB = NULL;
+  status = this->StreamBuffer->GetBufferItemPointerFromUid(itemBuid, itemB);
   if (status != ITEM_OK)
   {
     LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get data buffer item with Uid: " << itemBuid);
     return PLUS_FAIL;
   }
   // If there is no valid element on the other side of the requested time, then we cannot do an interpolation
-  if (itemB.GetStatus() != TOOL_OK)
+  if (itemB->GetStatus() != TOOL_OK)
   {
     LOCAL_LOG_DEBUG("vtkPlusBuffer: Cannot get a second element (uid=" << itemBuid << ") on the other side of the requested time (" << std::fixed << time << ")");
     return PLUS_FAIL;
@@ -1271,6 +2023,38 @@ PlusStatus vtkPlusBuffer::GetPrevNextBufferItemFromTime(double time, StreamBuffe
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+// Returns the two buffer items that are closest previous and next buffer items relative to the specified time.
+// itemA is the closest item
+PlusStatus vtkPlusBuffer::GetPrevNextBufferItemFromTime(double time, StreamBufferItem& itemA, StreamBufferItem& itemB)
+{
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+
+  BufferItemUidType itemAuid(0);
+  BufferItemUidType itemBuid(0);
+  if (this->GetPrevNextBufferItemUidsFromTime(time, itemAuid, itemBuid) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  if (this->GetStreamBufferItem(itemAuid, &itemA) != ITEM_OK)
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get data buffer item with Uid: " << itemAuid);
+    return PLUS_FAIL;
+  }
+  if (itemBuid == itemAuid)
+  {
+    itemB.DeepCopy(&itemA);
+    return PLUS_SUCCESS;
+  }
+  if (this->GetStreamBufferItem(itemBuid, &itemB) != ITEM_OK)
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get data buffer item with Uid: " << itemBuid);
+    return PLUS_FAIL;
+  }
+
+  return PLUS_SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 ItemStatus vtkPlusBuffer::GetStreamBufferItemFromTime(double time, StreamBufferItem* bufferItem, DataItemTemporalInterpolationType interpolation)
 {
@@ -1417,59 +2201,12 @@ ItemStatus vtkPlusBuffer::GetInterpolatedStreamBufferItemFromTime(double time, S
   double itemAweight = fabs(itemBtime - time) / fabs(itemAtime - itemBtime);
   double itemBweight = 1 - itemAweight;
 
-  //============== Get transform matrices ==================
-
-  vtkSmartPointer<vtkMatrix4x4> itemAmatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  if (itemA.GetMatrix(itemAmatrix) != PLUS_SUCCESS)
-  {
-    LOCAL_LOG_ERROR("Failed to get item A matrix");
-    return ITEM_UNKNOWN_ERROR;
-  }
-  double matrixA[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
-  double xyzA[3] = {0, 0, 0};
-  for (int i = 0; i < 3; i++)
-  {
-    matrixA[i][0] = itemAmatrix->GetElement(i, 0);
-    matrixA[i][1] = itemAmatrix->GetElement(i, 1);
-    matrixA[i][2] = itemAmatrix->GetElement(i, 2);
-    xyzA[i] = itemAmatrix->GetElement(i, 3);
-  }
-
-  vtkSmartPointer<vtkMatrix4x4> itemBmatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  if (itemB.GetMatrix(itemBmatrix) != PLUS_SUCCESS)
-  {
-    LOCAL_LOG_ERROR("Failed to get item B matrix");
-    return ITEM_UNKNOWN_ERROR;
-  }
-  double matrixB[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
-  double xyzB[3] = {0, 0, 0};
-  for (int i = 0; i < 3; i++)
-  {
-    matrixB[i][0] = itemBmatrix->GetElement(i, 0);
-    matrixB[i][1] = itemBmatrix->GetElement(i, 1);
-    matrixB[i][2] = itemBmatrix->GetElement(i, 2);
-    xyzB[i] = itemBmatrix->GetElement(i, 3);
-  }
-
-  //============== Interpolate rotation ==================
+  //============== Interpolate transform ==================
 
-  double matrixAquat[4] = {0, 0, 0, 0};
-  vtkMath::Matrix3x3ToQuaternion(matrixA, matrixAquat);
-  double matrixBquat[4] = {0, 0, 0, 0};
-  vtkMath::Matrix3x3ToQuaternion(matrixB, matrixBquat);
-  double interpolatedRotationQuat[4] = {0, 0, 0, 0};
-  igsioMath::Slerp(interpolatedRotationQuat, itemBweight, matrixAquat, matrixBquat);
-  double interpolatedRotation[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
-  vtkMath::QuaternionToMatrix3x3(interpolatedRotationQuat, interpolatedRotation);
-
-  vtkSmartPointer<vtkMatrix4x4> interpolatedMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  for (int i = 0; i < 3; i++)
-  {
-    interpolatedMatrix->Element[i][0] = interpolatedRotation[i][0];
-    interpolatedMatrix->Element[i][1] = interpolatedRotation[i][1];
-    interpolatedMatrix->Element[i][2] = interpolatedRotation[i][2];
-    interpolatedMatrix->Element[i][3] = xyzA[i] * itemAweight + xyzB[i] * itemBweight;
-  }
+  // The rotation is interpolated with SLERP and the translation linearly, without creating matrix objects
+  const PlusRigidTransform& itemAtransform = itemA.GetTransform();
+  const PlusRigidTransform& itemBtransform = itemB.GetTransform();
+  PlusRigidTransform interpolatedTransform = PlusRigidTransform::Interpolate(itemAtransform, itemBtransform, itemBweight);
 
   //============== Interpolate time ==================
 
@@ -1480,12 +2217,12 @@ ItemStatus vtkPlusBuffer::GetInterpolatedStreamBufferItemFromTime(double time, S
   //============== Write interpolated results into the bufferItem ==================
 
   bufferItem->DeepCopy(&itemA);
-  bufferItem->SetMatrix(interpolatedMatrix);
+  bufferItem->SetTransform(interpolatedTransform);
   bufferItem->SetFilteredTimestamp(time - this->StreamBuffer->GetLocalTimeOffsetSec());   // global = local + offset => local = global - offset
   bufferItem->SetUnfilteredTimestamp(interpolatedUnfilteredTimestamp);
 
-  double angleDiffA = igsioMath::GetOrientationDifference(interpolatedMatrix, itemAmatrix);
-  double angleDiffB = igsioMath::GetOrientationDifference(interpolatedMatrix, itemBmatrix);
+  double angleDiffA = PlusRigidTransform::GetOrientationDifferenceDeg(interpolatedTransform, itemAtransform);
+  double angleDiffB = PlusRigidTransform::GetOrientationDifferenceDeg(interpolatedTransform, itemBtransform);
   if (fabs(angleDiffA) > ANGLE_INTERPOLATION_WARNING_THRESHOLD_DEG && fabs(angleDiffB) > ANGLE_INTERPOLATION_WARNING_THRESHOLD_DEG)
   {
     static vtkIGSIOLogHelper helper(5.f, 5000, vtkPlusLogger::LOG_LEVEL_WARNING);
@@ -1498,6 +2235,81 @@ ItemStatus vtkPlusBuffer::GetInterpolatedStreamBufferItemFromTime(double time, S
   return ITEM_OK;
 }
 
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusBuffer::PrepareTransformInterpolation(double time, TransformInterpolationBatch& batch, TransformSample& sample)
+{
+  sample.BatchIndex = -1;
+  bool interpolationPossible(false);
+  {
+    igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+
+    BufferItemUidType itemAuid(0);
+    BufferItemUidType itemBuid(0);
+    if (this->GetPrevNextBufferItemUidsFromTime(time, itemAuid, itemBuid) == PLUS_SUCCESS)
+    {
+      interpolationPossible = true;
+      StreamBufferItem* itemA = NULL;
+      StreamBufferItem* itemB = NULL;
+      double itemAtime(0);
+      double itemBtime(0);
+      if (itemAuid != itemBuid
+          && this->StreamBuffer->GetBufferItemPointerFromUid(itemAuid, itemA) == ITEM_OK
+          && this->StreamBuffer->GetBufferItemPointerFromUid(itemBuid, itemB) == ITEM_OK
+          && this->StreamBuffer->GetTimeStamp(itemAuid, itemAtime) == ITEM_OK
+          && this->StreamBuffer->GetTimeStamp(itemBuid, itemBtime) == ITEM_OK
+          && fabs(itemAtime - itemBtime) >= NEGLIGIBLE_TIME_DIFFERENCE)
+      {
+        double itemAweight = fabs(itemBtime - time) / fabs(itemAtime - itemBtime);
+        double matrixA[16];
+        double matrixB[16];
+        itemA->GetMatrixElements(matrixA);
+        itemB->GetMatrixElements(matrixB);
+        sample.BatchIndex = batch.AddTransformPair(matrixA, matrixB, 1 - itemAweight);
+        sample.Status = itemA->GetStatus();
+        sample.FrameFields = itemA->GetFrameFields();
+        // The filtered timestamp of the interpolated item is the requested time
+        sample.Timestamp = time;
+        return ITEM_OK;
+      }
+    }
+  }
+
+  // Interpolation is not needed (exact match) or not possible, get the item the same way as for a single item.
+  // If interpolation is not possible then the closest item is used directly, so that the failure of finding the neighbors is not reported twice.
+  StreamBufferItem bufferItem;
+  ItemStatus status = ITEM_OK;
+  if (interpolationPossible)
+  {
+    status = this->GetInterpolatedStreamBufferItemFromTime(time, &bufferItem);
+  }
+  else
+  {
+    status = this->GetStreamBufferItemFromClosestTime(time, &bufferItem);
+    bufferItem.SetFilteredTimestamp(time);
+    bufferItem.SetUnfilteredTimestamp(time);
+    if (status != ITEM_OK)
+    {
+      LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get data buffer timestamp (time: " << std::fixed << time << ")");
+    }
+    bufferItem.SetStatus(TOOL_MISSING);
+  }
+  if (status != ITEM_OK)
+  {
+    return status;
+  }
+  bufferItem.GetMatrixElements(sample.Matrix);
+  sample.Status = bufferItem.GetStatus();
+  sample.FrameFields = bufferItem.GetFrameFields();
+  sample.Timestamp = bufferItem.GetTimestamp(this->GetLocalTimeOffsetSec());
+  return ITEM_OK;
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusBuffer::GetAngleInterpolationWarningThresholdDeg()
+{
+  return ANGLE_INTERPOLATION_WARNING_THRESHOLD_DEG;
+}
+
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusBuffer::CopyTransformFromTrackedFrameList(vtkIGSIOTrackedFrameList* sourceTrackedFrameList, TIMESTAMP_FILTERING_OPTION timestampFiltering, igsioTransformName& transformName)
 {
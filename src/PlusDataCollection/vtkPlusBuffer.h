@@ -18,6 +18,7 @@ See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
 #include "igsioCommon.h"
 #include "PlusConfigure.h"
 #include "vtkPlusDataCollectionExport.h"
+#include "PlusFrameMemoryRegion.h"
 #include "PlusStreamBufferItem.h"
 #include "vtkPlusTimestampedCircularBuffer.h"
 
@@ -25,7 +26,13 @@ See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
 
 // VTK includes
 #include <vtkObject.h>
+#include <vtkSmartPointer.h>
 
+// STL includes
+#include <atomic>
+
+class TransformInterpolationBatch;
+class vtkDataArray;
 class vtkPlusDevice;
 enum ToolStatus;
 
@@ -49,6 +56,29 @@ public:
     CLOSEST_TIME /*!< returns the closest item  */
   };
 
+  /*! Frame memory allocation strategy */
+  enum FrameMemoryAllocationType
+  {
+    FRAME_MEMORY_ALLOCATION_DEFAULT, /*!< each frame is allocated separately */
+    FRAME_MEMORY_ALLOCATION_CONTIGUOUS_LARGE_PAGES /*!< frames of all the buffer slots are stored in one contiguous region, backed by large pages if available */
+  };
+
+  /*! Transform at a requested time, see PrepareTransformInterpolation */
+  struct TransformSample
+  {
+    TransformSample() : Status(TOOL_INVALID), Timestamp(0), BatchIndex(-1) {}
+    /*! Status of the closest item, TOOL_MISSING if interpolation is not possible */
+    ToolStatus Status;
+    /*! Timestamp of the sample (global time) */
+    double Timestamp;
+    /*! Transform (4x4, row-major). Only set if BatchIndex is -1, otherwise it has to be retrieved from the batch after interpolation. */
+    double Matrix[16];
+    /*! Frame fields of the closest item */
+    FrameFieldStore FrameFields;
+    /*! Index of the entry in the interpolation batch, -1 if the sample did not need interpolation */
+    int BatchIndex;
+  };
+
   static vtkPlusBuffer* New();
   vtkTypeMacro(vtkPlusBuffer, vtkObject);
   virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
@@ -61,6 +91,12 @@ public:
   /*! Get the size of the buffer */
   virtual int GetBufferSize();
 
+  /*!
+    Get the memory used by the items of the buffer, in bytes: the pixel data of the frames
+    (the contiguous frame memory region if it is used) and the item records.
+  */
+  virtual size_t GetMemoryUsageBytes();
+
   /*!
     Add a frame plus a timestamp to the buffer with frame index.
     If the timestamp is  less than or equal to the previous timestamp,
@@ -100,7 +136,7 @@ public:
     then the frame is not added to the buffer. If a clip rectangle is defined
     then only that portion of the image is extracted.
   */
-  virtual PlusStatus AddItem(void* imageDataPtr,
+  virtual PlusStatus AddItem(const void* imageDataPtr,
                              US_IMAGE_ORIENTATION usImageOrientation,
                              const FrameSizeType& inputFrameSizeInPx,
                              igsioCommon::VTKScalarPixelType pixelType,
@@ -124,7 +160,7 @@ public:
     then the frame is not added. This overload is only used for storing
     compressed or variable frame size entries
   */
-  virtual PlusStatus AddItem(void* imageDataPtr,
+  virtual PlusStatus AddItem(const void* imageDataPtr,
                              const FrameSizeType& frameSize,
                              unsigned int frameSizeInBytes,
                              US_IMAGE_TYPE imageType,
@@ -144,6 +180,50 @@ public:
                              double unfilteredTimestamp = UNDEFINED_TIMESTAMP,
                              double filteredTimestamp = UNDEFINED_TIMESTAMP);
 
+  /*!
+    Reserve the next frame of the buffer and get a writable pointer to its pixel data, so that the device
+    (SDK callback, DMA, decoder, ...) can write the image directly into the buffer instead of passing it to AddItem,
+    which would copy the whole frame. The written image must have exactly the buffer's frame size, pixel type,
+    number of scalar components and image orientation, as no clipping or reorientation is performed.
+    The frame is only added to the buffer when CommitReservedItem is called. Only one frame can be reserved at a time
+    and no other items may be added to the buffer until the reservation is committed or cancelled.
+  */
+  virtual PlusStatus ReserveNewItem(void*& imageDataPtr, unsigned int& frameSizeInBytes);
+
+  /*!
+    Add the frame that was written into the memory provided by ReserveNewItem to the buffer.
+    If the timestamp is less than or equal to the previous timestamp then the frame is not added to the buffer.
+    The reservation is released in all cases.
+  */
+  virtual PlusStatus CommitReservedItem(long frameNumber,
+                                        double unfilteredTimestamp = UNDEFINED_TIMESTAMP,
+                                        double filteredTimestamp = UNDEFINED_TIMESTAMP,
+                                        const igsioFieldMapType* customFields = NULL);
+
+  /*! Release the frame reserved by ReserveNewItem without adding it to the buffer */
+  virtual void CancelReservedItem();
+
+  /*!
+    Add a frame by moving its pixel array into the buffer instead of copying the pixels. This allows devices that receive
+    frames into memory that they allocate (e.g., V4L2 user pointer buffers) to add frames without copying them: on success
+    pixels is replaced by the pixel array of the overwritten (oldest) frame of the buffer, which the device can use for
+    receiving the next frame. If the pixels of the overwritten frame are still used by frames that were read from the
+    buffer then a newly allocated array is returned instead. On failure pixels is not changed.
+    The pixel array must have exactly the buffer's frame size, pixel type, number of scalar components and image
+    orientation, as no clipping or reorientation is performed. See CanAddItemBySwappingPixels.
+  */
+  virtual PlusStatus AddItemBySwappingPixels(vtkSmartPointer<vtkDataArray>& pixels,
+      long frameNumber,
+      double unfilteredTimestamp = UNDEFINED_TIMESTAMP,
+      double filteredTimestamp = UNDEFINED_TIMESTAMP,
+      const igsioFieldMapType* customFields = NULL);
+
+  /*!
+    Returns true if frames can be added by AddItemBySwappingPixels. Not available if the frames are stored
+    in contiguous frame memory (pixel arrays cannot be moved out of the region) or a frame is reserved.
+  */
+  virtual bool CanAddItemBySwappingPixels();
+
   /*!
     Add a matrix plus status to the list, with an exactly known timestamp value (e.g., provided by a high-precision hardware timer).
     If the timestamp is less than or equal to the previous timestamp, then nothing  will be done.
@@ -151,8 +231,19 @@ public:
   */
   PlusStatus AddTimeStampedItem(vtkMatrix4x4* matrix, ToolStatus status, unsigned long frameNumber, double unfilteredTimestamp, double filteredTimestamp = UNDEFINED_TIMESTAMP, const igsioFieldMapType* customFields = NULL);
 
-  /*! Get a frame with the specified frame uid from the buffer */
-  virtual ItemStatus GetStreamBufferItem(BufferItemUidType uid, StreamBufferItem* bufferItem);
+  /*!
+    Compute the filtered timestamp of a new item with the timestamp filter of this buffer, without adding an item.
+    Used for computing one filtered timestamp for items that are added to multiple buffers at the same time.
+  */
+  PlusStatus CreateFilteredTimeStampForItem(unsigned long frameNumber, double unfilteredTimestamp, double& filteredTimestamp, bool& filteredTimestampProbablyValid);
+
+  /*!
+    Get a frame with the specified frame uid from the buffer
+    \param shareImageData If true then the image pixels are not copied but shared with the buffer (see StreamBufferItem::ShareFrameImage).
+      The buffer allocates new pixels for the slot when it is overwritten, so the shared pixels remain valid.
+      Pixels in contiguous frame memory (FRAME_MEMORY_ALLOCATION_CONTIGUOUS_LARGE_PAGES) are always copied.
+  */
+  virtual ItemStatus GetStreamBufferItem(BufferItemUidType uid, StreamBufferItem* bufferItem, bool shareImageData = false);
   /*! Get the most recent frame from the buffer */
   virtual ItemStatus GetLatestStreamBufferItem(StreamBufferItem* bufferItem)
   {
@@ -165,6 +256,18 @@ public:
   };
   /*! Get a frame that was acquired at the specified time from buffer */
   virtual ItemStatus GetStreamBufferItemFromTime(double time, StreamBufferItem* bufferItem, DataItemTemporalInterpolationType interpolation);
+
+  /*!
+    Get the transform at the specified time for batch interpolation, without copying buffer items.
+    If the transform has to be interpolated then the transforms of the items around the time are added to the batch
+    and sample.BatchIndex is set to the index of the entry. Otherwise (exact match or interpolation is not possible)
+    sample is set to the result of GetStreamBufferItemFromTime(time, item, INTERPOLATED) and sample.BatchIndex is -1.
+  */
+  virtual ItemStatus PrepareTransformInterpolation(double time, TransformInterpolationBatch& batch, TransformSample& sample);
+
+  /*! Interpolated orientations that differ from the orientations of both neighbor items by more than this angle are reported as inaccurate */
+  static double GetAngleInterpolationWarningThresholdDeg();
+
   virtual PlusStatus ModifyBufferItemFrameField(BufferItemUidType uid, const std::string& key, const std::string& value);
 
   /*! Get latest timestamp in the buffer */
@@ -173,6 +276,12 @@ public:
   /*! Get oldest timestamp in the buffer */
   virtual ItemStatus GetOldestTimeStamp(double& oldestTimestamp);
 
+  /*!
+    Wait until an item newer than the specified timestamp is added to the buffer or the timeout expires.
+    Returns PLUS_SUCCESS if a newer item is available, PLUS_FAIL on timeout.
+  */
+  virtual PlusStatus WaitForItemNewerThan(double timestamp, double timeoutSec);
+
   /*! Get buffer item timestamp */
   virtual ItemStatus GetTimeStamp(BufferItemUidType uid, double& timestamp);
 
@@ -231,6 +340,17 @@ public:
     return this->StreamBuffer->GetFrameRate(ideal, framePeriodStdevSecPtr);
   }
 
+  /*! Get the mean, standard deviation, minimum and maximum of the recent frame periods in constant time (see vtkPlusTimestampedCircularBuffer::GetFramePeriodStatistics) */
+  virtual PlusStatus GetFramePeriodStatistics(bool ideal, vtkPlusTimestampedCircularBuffer::FramePeriodStatistics& statistics)
+  {
+    return this->StreamBuffer->GetFramePeriodStatistics(ideal, statistics);
+  }
+
+  /*! Set the length of the time window for the frame rate statistics in seconds. Not positive value means all items in the buffer. */
+  virtual void SetFrameRateStatisticsWindowSec(double windowSec);
+
+  virtual double GetFrameRateStatisticsWindowSec();
+
   /*! Set maximum allowed time difference in seconds between the desired and the closest valid timestamp */
   vtkSetMacro(MaxAllowedTimeDifference, double);
   /*! Get maximum allowed time difference in seconds between the desired and the closest valid timestamp */
@@ -258,6 +378,14 @@ public:
 
   virtual int GetAveragedItemsForFiltering();
 
+  /*!
+    Set outlier rejection threshold for timestamp filtering, in units of standard deviation of the fit residuals.
+    Unfiltered timestamps that are farther from the fitted line are not used for fitting. Not positive value disables outlier rejection.
+  */
+  virtual void SetTimestampOutlierRejectionThreshold(double threshold);
+
+  virtual double GetTimestampOutlierRejectionThreshold();
+
   /*! Set recording start time */
   virtual void SetStartTime(double startTime);
   /*! Get recording start time */
@@ -270,6 +398,32 @@ public:
   void SetTimeStampReporting(bool enable);
   /*! If TimeStampReporting is enabled then all filtered and unfiltered timestamp values will be saved in a table for diagnostic purposes. */
   bool GetTimeStampReporting();
+  /*! Binary file that the timestamp report records are written to, see vtkPlusTimestampedCircularBuffer::SetTimeStampReportFileName */
+  PlusStatus SetTimeStampReportFileName(const std::string& fileName);
+  /*! Number of most recent timestamp report records that are kept in memory */
+  void SetTimeStampReportCapacity(unsigned int capacity);
+
+  /*!
+    If LockFreeReads is enabled then UID and timestamp queries do not lock the buffer, so consumer threads
+    do not block the device thread that is adding new items. Items must be added from a single thread.
+  */
+  void SetLockFreeReads(bool enable);
+  /*! Returns true if UID and timestamp queries do not lock the buffer */
+  bool GetLockFreeReads();
+
+  /*!
+    Set how the memory of the frames is allocated. With FRAME_MEMORY_ALLOCATION_CONTIGUOUS_LARGE_PAGES all the frames
+    are stored in one contiguous region, which reduces TLB misses for large buffers of large (e.g., 3D) frames.
+  */
+  PlusStatus SetFrameMemoryAllocation(FrameMemoryAllocationType allocation);
+  vtkGetMacro(FrameMemoryAllocation, FrameMemoryAllocationType);
+
+  /*!
+    NUMA node where the contiguous frame memory is placed. If -1 (default) then the memory is placed
+    on the NUMA node of the thread that adds the first frame to the buffer (the capture thread of the device).
+  */
+  PlusStatus SetFrameMemoryNumaNode(int numaNode);
+  vtkGetMacro(FrameMemoryNumaNode, int);
 
   /*! Set the frame size in pixel  */
   PlusStatus SetFrameSize(unsigned int x, unsigned int y, unsigned int z, bool allocateFrames = true);
@@ -314,6 +468,17 @@ public:
   /*! Dump the current state of the video buffer to metafile */
   virtual PlusStatus WriteToSequenceFile(const char* filename, bool useCompression = false);
 
+  /*!
+    Write the items from firstUid to lastUid (inclusive) to a sequence file.
+    The items are written in small chunks directly from the buffer, so the buffer is not locked and not copied
+    while the file is written. Items that are overwritten in the buffer before they could be written are skipped.
+    \param maxBandwidthBytesPerSec Limit of the average file write speed (to leave disk bandwidth for the acquisition), no limit if not positive
+    \param cancelRequested Writing is stopped (the items written so far are kept in the file) when this flag is set, ignored if NULL
+    Tracking sequence files (.ptrk) only store the timestamps, the transform and the frame fields of the items, see vtkPlusTrackingSequenceFile.
+  */
+  virtual PlusStatus WriteRangeToSequenceFile(const char* filename, BufferItemUidType firstUid, BufferItemUidType lastUid, bool useCompression = false,
+      double maxBandwidthBytesPerSec = 0, const std::atomic<bool>* cancelRequested = NULL);
+
   vtkGetStringMacro(DescriptiveName);
   vtkSetStringMacro(DescriptiveName);
 
@@ -324,6 +489,24 @@ protected:
   /*! Update video buffer by setting the frame format for each frame  */
   virtual PlusStatus AllocateMemoryForFrames();
 
+  /*! Move the frames of all buffer slots into a newly allocated contiguous region on the specified NUMA node (-1 for default placement) */
+  PlusStatus AllocateFrameMemoryRegion(int numaNode);
+
+  /*! Give each frame its own memory again and release the contiguous region */
+  void ReleaseFrameMemoryRegion();
+
+  /*!
+    Place the contiguous frame memory on the NUMA node of the calling thread if it has not been done yet
+    since the frames were allocated. Called with the buffer locked, from the methods that add frames.
+  */
+  void PlaceFrameMemoryForWriterThread();
+
+  /*!
+    Write the items from firstUid to lastUid (inclusive) to a tracking sequence file. The columns are filled directly from the
+    buffer items, without creating tracked frames, and the file is written when all items are collected.
+  */
+  PlusStatus WriteRangeToTrackingSequenceFile(const char* filename, BufferItemUidType firstUid, BufferItemUidType lastUid, const std::atomic<bool>* cancelRequested);
+
   /*!
     Compares frame format with new frame imaging parameters.
     \return true if current buffer frame format matches the method arguments, otherwise false
@@ -333,6 +516,9 @@ protected:
   /*! Returns the two buffer items that are closest previous and next buffer items relative to the specified time. itemA is the closest item */
   PlusStatus GetPrevNextBufferItemFromTime(double time, StreamBufferItem& itemA, StreamBufferItem& itemB);
 
+  /*! Same as GetPrevNextBufferItemFromTime, but only returns the UIDs of the items, without copying them */
+  PlusStatus GetPrevNextBufferItemUidsFromTime(double time, BufferItemUidType& itemAuid, BufferItemUidType& itemBuid);
+
   /*!
   Interpolate the matrix for the given timestamp from the two nearest transforms in the buffer.
   The rotation is interpolated with SLERP interpolation, and the position is interpolated with linear interpolation.
@@ -371,6 +557,18 @@ protected:
 
   char* DescriptiveName;
 
+  /*! Frame memory allocation strategy */
+  FrameMemoryAllocationType FrameMemoryAllocation;
+
+  /*! Requested NUMA node of the contiguous frame memory, -1 if it should follow the capture thread */
+  int FrameMemoryNumaNode;
+
+  /*! Contiguous memory of the frames, NULL if each frame is allocated separately */
+  FrameMemoryRegion* FrameMemory;
+
+  /*! True if the contiguous frame memory has been placed on the NUMA node of the thread that is adding frames */
+  bool FrameMemoryPlacedForWriterThread;
+
 private:
   vtkPlusBuffer(const vtkPlusBuffer&);
   void operator=(const vtkPlusBuffer&);
@@ -6,14 +6,20 @@ See License.txt for details.
 
 // Local includes
 #include "PlusConfigure.h"
+#include "PlusDataflowScheduler.h"
+#include "PlusLatencyTracer.h"
+#include "PlusProfiler.h"
 #ifdef PLUS_RENDERING_ENABLED
 #include "PlusPlotter.h"
 #endif
+#include "PlusSharedMemoryRing.h"
+#include "PlusTransformInterpolationBatch.h"
 #include "vtkPlusBuffer.h"
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataSource.h"
 #include "vtkPlusHTMLGenerator.h"
 #include "vtkIGSIOTrackedFrameList.h"
+#include "vtkIGSIORecursiveCriticalSection.h"
 
 // VTK includes
 #include <vtkImageData.h>
@@ -21,6 +27,10 @@ See License.txt for details.
 #include <vtkObjectFactory.h>
 #include <vtkTable.h>
 
+// STL includes
+#include <iomanip>
+#include <sstream>
+
 //----------------------------------------------------------------------------
 
 vtkStandardNewMacro(vtkPlusChannel);
@@ -31,6 +41,32 @@ vtkStandardNewMacro(vtkPlusChannel);
 // This time should be long enough to comfortably retrieve a frame from the buffer.
 static const double SAMPLING_SKIPPING_MARGIN_SEC = 0.1;
 
+// Default number of assembled tracked frames kept in the tracked frame cache
+static const int DEFAULT_TRACKED_FRAME_CACHE_SIZE = 8;
+
+// Default number of frames kept in the shared memory output
+static const int DEFAULT_SHARED_MEMORY_OUTPUT_NUMBER_OF_ITEMS = 16;
+
+// Space reserved for the frame fields (transforms, etc.) in each item of the shared memory output
+static const size_t SHARED_MEMORY_OUTPUT_FIELD_CAPACITY_BYTES = 64 * 1024;
+
+//----------------------------------------------------------------------------
+// Copy the timestamp, fields (including transforms) and optionally the image of a tracked frame that has been
+// assembled by the channel. The image pixels are shared, not copied.
+static void ShareAssembledTrackedFrame(igsioTrackedFrame& source, igsioTrackedFrame& target, bool shareImage)
+{
+  if (shareImage)
+  {
+    StreamBufferItem::ShareFrameImage(*source.GetImageData(), *target.GetImageData());
+  }
+  igsioFieldMapType fields = source.GetFrameFields();
+  for (igsioFieldMapType::const_iterator it = fields.begin(); it != fields.end(); ++it)
+  {
+    target.SetFrameField(it->first, it->second.second, it->second.first);
+  }
+  target.SetTimestamp(source.GetTimestamp());
+}
+
 //----------------------------------------------------------------------------
 vtkPlusChannel::vtkPlusChannel(void)
   : VideoSource(NULL)
@@ -39,6 +75,18 @@ vtkPlusChannel::vtkPlusChannel(void)
   , RfProcessor(NULL)
   , BlankImage(vtkImageData::New())
   , SaveRfProcessingParameters(false)
+  , NumberOfConsumers(0)
+  , SourcesGeneration(0)
+  , TrackedFrameCacheSize(DEFAULT_TRACKED_FRAME_CACHE_SIZE)
+  , TrackedFrameCacheGeneration(0)
+  , TrackedFrameCacheHits(0)
+  , TrackedFrameCacheMisses(0)
+  , TrackedFrameCacheMutex(vtkIGSIORecursiveCriticalSection::New())
+  , ProcessingStatisticsMutex(vtkIGSIORecursiveCriticalSection::New())
+  , SharedMemoryOutputNumberOfItems(DEFAULT_SHARED_MEMORY_OUTPUT_NUMBER_OF_ITEMS)
+  , SharedMemoryOutput(new SharedMemoryRing)
+  , SharedMemoryOutputSource(NULL)
+  , SharedMemoryOutputLastUid(0)
 {
   // Default size for brightness frame
   this->BrightnessFrameSize[0] = 640;
@@ -58,6 +106,10 @@ vtkPlusChannel::vtkPlusChannel(void)
 //----------------------------------------------------------------------------
 vtkPlusChannel::~vtkPlusChannel(void)
 {
+  this->StopSharedMemoryOutput();
+  delete this->SharedMemoryOutput;
+  this->SharedMemoryOutput = NULL;
+
   this->VideoSource = NULL;
   this->Tools.clear();
   this->FieldDataSources.clear();
@@ -67,6 +119,9 @@ vtkPlusChannel::~vtkPlusChannel(void)
   DELETE_IF_NOT_NULL(this->BlankImage);
 
   DELETE_IF_NOT_NULL(this->RfProcessor);
+
+  DELETE_IF_NOT_NULL(this->TrackedFrameCacheMutex);
+  DELETE_IF_NOT_NULL(this->ProcessingStatisticsMutex);
 }
 
 //----------------------------------------------------------------------------
@@ -138,6 +193,18 @@ PlusStatus vtkPlusChannel::ReadConfiguration(vtkXMLDataElement* aChannelElement,
     return PLUS_FAIL;
   }
 
+  int trackedFrameCacheSize = this->TrackedFrameCacheSize;
+  XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, TrackedFrameCacheSize, trackedFrameCacheSize, aChannelElement);
+  this->SetTrackedFrameCacheSize(trackedFrameCacheSize);
+
+  XML_READ_STRING_ATTRIBUTE_NONMEMBER_OPTIONAL(SharedMemoryOutputName, this->SharedMemoryOutputName, aChannelElement);
+  XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, SharedMemoryOutputNumberOfItems, this->SharedMemoryOutputNumberOfItems, aChannelElement);
+  if (this->SharedMemoryOutputNumberOfItems < 1)
+  {
+    LOG_ERROR("SharedMemoryOutputNumberOfItems must be positive in channel " << this->GetChannelId());
+    return PLUS_FAIL;
+  }
+
   vtkXMLDataElement* rfElement = aChannelElement->FindNestedElementWithName(vtkPlusRfProcessor::GetRfProcessorTagName());
   if (rfElement != NULL)
   {
@@ -302,6 +369,8 @@ PlusStatus vtkPlusChannel::AddTool(vtkPlusDataSource* aTool)
     this->TimestampMasterTool = aTool;
   }
 
+  this->SourcesGeneration += 2;
+  this->ClearTrackedFrameCache();
   return PLUS_SUCCESS;
 }
 
@@ -324,6 +393,8 @@ PlusStatus vtkPlusChannel::RemoveTool(const std::string& toolSourceId)
         // the master tool has been deleted
         this->TimestampMasterTool = NULL;
       }
+      this->SourcesGeneration += 2;
+      this->ClearTrackedFrameCache();
       return PLUS_SUCCESS;
     }
   }
@@ -335,6 +406,8 @@ PlusStatus vtkPlusChannel::RemoveTool(const std::string& toolSourceId)
 PlusStatus vtkPlusChannel::RemoveTools()
 {
   this->Tools.clear();
+  this->SourcesGeneration += 2;
+  this->ClearTrackedFrameCache();
 
   return PLUS_SUCCESS;
 }
@@ -359,6 +432,8 @@ PlusStatus vtkPlusChannel::AddFieldDataSource(vtkPlusDataSource* aSource)
 
   this->FieldDataSources[aSource->GetId()] = aSource;
   this->FieldDataSources[aSource->GetId()]->Register(this);
+  this->SourcesGeneration += 2;
+  this->ClearTrackedFrameCache();
 
   return PLUS_SUCCESS;
 }
@@ -377,6 +452,8 @@ PlusStatus vtkPlusChannel::RemoveFieldDataSource(const std::string& sourceId)
     if (it->second->GetId() == sourceId)
     {
       this->FieldDataSources.erase(it);
+      this->SourcesGeneration += 2;
+      this->ClearTrackedFrameCache();
       return PLUS_SUCCESS;
     }
   }
@@ -409,6 +486,8 @@ PlusStatus vtkPlusChannel::GetFieldDataSource(vtkPlusDataSource*& aSource, const
 PlusStatus vtkPlusChannel::RemoveFieldDataSources()
 {
   this->FieldDataSources.clear();
+  this->SourcesGeneration += 2;
+  this->ClearTrackedFrameCache();
 
   return PLUS_SUCCESS;
 }
@@ -429,6 +508,7 @@ PlusStatus vtkPlusChannel::Clear()
   {
     it->second->Clear();
   }
+  this->ClearTrackedFrameCache();
   return PLUS_SUCCESS;
 }
 
@@ -524,10 +604,224 @@ void vtkPlusChannel::ShallowCopy(const vtkPlusChannel& aChannel)
 void vtkPlusChannel::SetVideoSource(vtkPlusDataSource* aSource)
 {
   this->VideoSource = aSource;
+  this->SourcesGeneration += 2;
+  this->ClearTrackedFrameCache();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChannel::SwitchSources(const vtkPlusChannel& aChannel)
+{
+  if (&aChannel == this)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  // Build the new containers before touching the current ones
+  DataSourceContainer tools(aChannel.Tools);
+  for (DataSourceContainerIterator it = tools.begin(); it != tools.end(); ++it)
+  {
+    it->second->Register(this);
+  }
+  DataSourceContainer fieldDataSources(aChannel.FieldDataSources);
+  for (DataSourceContainerIterator it = fieldDataSources.begin(); it != fieldDataSources.end(); ++it)
+  {
+    it->second->Register(this);
+  }
+
+  // Publishing has to follow the new sources
+  bool sharedMemoryOutputActive = (this->SharedMemoryOutputSource != NULL);
+  this->StopSharedMemoryOutput();
+
+  // Release the containers of the previous switch, nobody can be iterating them anymore
+  for (DataSourceContainerIterator it = this->RetiredTools.begin(); it != this->RetiredTools.end(); ++it)
+  {
+    it->second->UnRegister(this);
+  }
+  for (DataSourceContainerIterator it = this->RetiredFieldDataSources.begin(); it != this->RetiredFieldDataSources.end(); ++it)
+  {
+    it->second->UnRegister(this);
+  }
+
+  // Odd generation while the containers are swapped
+  this->SourcesGeneration++;
+  this->RetiredTools.swap(this->Tools);
+  this->Tools.swap(tools);
+  this->RetiredFieldDataSources.swap(this->FieldDataSources);
+  this->FieldDataSources.swap(fieldDataSources);
+  this->VideoSource = aChannel.VideoSource;
+  this->TimestampMasterTool = aChannel.TimestampMasterTool;
+  this->SourcesGeneration++;
+
+  this->ClearTrackedFrameCache();
+
+  if (sharedMemoryOutputActive)
+  {
+    return this->StartSharedMemoryOutput();
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusChannel::SetTrackedFrameCacheSize(int cacheSize)
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> cacheGuardedLock(this->TrackedFrameCacheMutex);
+  this->TrackedFrameCacheSize = (cacheSize > 0 ? cacheSize : 0);
+  while (this->TrackedFrameCache.size() > static_cast<size_t>(this->TrackedFrameCacheSize))
+  {
+    this->TrackedFrameCache.pop_back();
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusChannel::ClearTrackedFrameCache()
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> cacheGuardedLock(this->TrackedFrameCacheMutex);
+  this->TrackedFrameCache.clear();
+  this->TrackedFrameCacheGeneration++;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusChannel::GetTrackedFrameCacheStatistics(unsigned long& numberOfHits, unsigned long& numberOfMisses) const
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> cacheGuardedLock(this->TrackedFrameCacheMutex);
+  numberOfHits = this->TrackedFrameCacheHits;
+  numberOfMisses = this->TrackedFrameCacheMisses;
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusChannel::GetTrackedFrameCacheHitRate() const
+{
+  unsigned long numberOfHits(0);
+  unsigned long numberOfMisses(0);
+  this->GetTrackedFrameCacheStatistics(numberOfHits, numberOfMisses);
+  if (numberOfHits + numberOfMisses == 0)
+  {
+    return 0.0;
+  }
+  return static_cast<double>(numberOfHits) / (numberOfHits + numberOfMisses);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusChannel::AddProcessedFrameStatistics(double processingTimeSec)
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> statisticsGuardedLock(this->ProcessingStatisticsMutex);
+  this->ProcessingStatistics.NumberOfProcessedFrames++;
+  this->ProcessingStatistics.ProcessingTimeSumSec += processingTimeSec;
+  this->ProcessingStatistics.MaximumProcessingTimeSec = std::max(this->ProcessingStatistics.MaximumProcessingTimeSec, processingTimeSec);
+  this->ProcessingStatistics.LastProcessingTimeSec = processingTimeSec;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusChannel::AddSkippedFrameStatistics(unsigned long numberOfSkippedFrames)
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> statisticsGuardedLock(this->ProcessingStatisticsMutex);
+  this->ProcessingStatistics.NumberOfSkippedFrames += numberOfSkippedFrames;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusChannel::FrameProcessingStatistics vtkPlusChannel::GetFrameProcessingStatistics() const
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> statisticsGuardedLock(this->ProcessingStatisticsMutex);
+  return this->ProcessingStatistics;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusChannel::ResetFrameProcessingStatistics()
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> statisticsGuardedLock(this->ProcessingStatisticsMutex);
+  this->ProcessingStatistics = FrameProcessingStatistics();
+}
+
+//----------------------------------------------------------------------------
+vtkPlusChannel::TrackedFrameCacheKey vtkPlusChannel::GetTrackedFrameCacheKey(double timestamp, bool enableImageData)
+{
+  TrackedFrameCacheKey key;
+  key.Timestamp = timestamp;
+  key.EnableImageData = enableImageData;
+  key.SourcesGeneration = this->SourcesGeneration.load();
+  for (DataSourceContainerConstIterator it = this->GetFieldDataSourcesStartIterator(); it != this->GetFieldDataSourcesEndIterator(); ++it)
+  {
+    key.FieldDataSourceLatestUids.push_back(it->second->GetNumberOfItems() > 0 ? it->second->GetLatestItemUidInBuffer() : 0);
+  }
+  return key;
 }
 
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusChannel::GetTrackedFrame(double timestamp, igsioTrackedFrame& aTrackedFrame, bool enableImageData/*=true*/)
+{
+  PLUS_PROFILE_SCOPE("vtkPlusChannel::GetTrackedFrame");
+  unsigned long cacheGeneration(0);
+  int cacheSize(0);
+  // The key is determined before the frame is assembled, so a field data item that arrives meanwhile makes the entry outdated
+  TrackedFrameCacheKey key = this->GetTrackedFrameCacheKey(timestamp, enableImageData);
+  // Cached and newly assembled frames are merged into aTrackedFrame the same way
+  const bool shareImage = enableImageData && this->HasVideoSource();
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> cacheGuardedLock(this->TrackedFrameCacheMutex);
+    cacheSize = this->TrackedFrameCacheSize;
+    for (std::list<TrackedFrameCacheEntry>::iterator it = this->TrackedFrameCache.begin(); it != this->TrackedFrameCache.end(); ++it)
+    {
+      if (it->Key == key)
+      {
+        // Move to the front, as it is the most recently used now
+        this->TrackedFrameCache.splice(this->TrackedFrameCache.begin(), this->TrackedFrameCache, it);
+        this->TrackedFrameCacheHits++;
+        ShareAssembledTrackedFrame(this->TrackedFrameCache.front().TrackedFrame, aTrackedFrame, shareImage);
+        return PLUS_SUCCESS;
+      }
+    }
+    if (cacheSize > 0)
+    {
+      this->TrackedFrameCacheMisses++;
+    }
+    cacheGeneration = this->TrackedFrameCacheGeneration;
+  }
+
+  if (cacheSize <= 0)
+  {
+    return this->AssembleTrackedFrame(timestamp, aTrackedFrame, enableImageData);
+  }
+
+  // The frame is assembled separately, so that the cache only contains the assembled fields and not the fields
+  // that were already in aTrackedFrame. The cache is not locked meanwhile, so that consumers requesting different
+  // frames do not wait for each other.
+  igsioTrackedFrame assembledFrame;
+  if (this->AssembleTrackedFrame(timestamp, assembledFrame, enableImageData) != PLUS_SUCCESS)
+  {
+    // Incomplete frames are not cached, as the missing data may become available later
+    ShareAssembledTrackedFrame(assembledFrame, aTrackedFrame, shareImage && assembledFrame.GetImageData()->IsImageValid());
+    return PLUS_FAIL;
+  }
+  ShareAssembledTrackedFrame(assembledFrame, aTrackedFrame, shareImage);
+
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> cacheGuardedLock(this->TrackedFrameCacheMutex);
+  if (cacheGeneration != this->TrackedFrameCacheGeneration || this->TrackedFrameCacheSize <= 0)
+  {
+    // The cache has been cleared while the frame was assembled
+    return PLUS_SUCCESS;
+  }
+  for (std::list<TrackedFrameCacheEntry>::iterator it = this->TrackedFrameCache.begin(); it != this->TrackedFrameCache.end(); ++it)
+  {
+    if (it->Key == key)
+    {
+      // Another consumer has already added the same frame
+      return PLUS_SUCCESS;
+    }
+  }
+  TrackedFrameCacheEntry entry;
+  entry.Key = key;
+  this->TrackedFrameCache.push_front(entry);
+  ShareAssembledTrackedFrame(assembledFrame, this->TrackedFrameCache.front().TrackedFrame, shareImage);
+  while (this->TrackedFrameCache.size() > static_cast<size_t>(this->TrackedFrameCacheSize))
+  {
+    this->TrackedFrameCache.pop_back();
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChannel::AssembleTrackedFrame(double timestamp, igsioTrackedFrame& aTrackedFrame, bool enableImageData)
 {
   int numberOfErrors(0);
   double synchronizedTimestamp(0);
@@ -563,21 +857,24 @@ PlusStatus vtkPlusChannel::GetTrackedFrame(double timestamp, igsioTrackedFrame&
     }
 
     StreamBufferItem CurrentStreamBufferItem;
-    if (this->VideoSource->GetStreamBufferItem(frameUID, &CurrentStreamBufferItem) != ITEM_OK)
+    if (this->VideoSource->GetStreamBufferItem(frameUID, &CurrentStreamBufferItem, true /* share image data */) != ITEM_OK)
     {
       LOG_ERROR("Couldn't get video buffer item by frame UID: " << frameUID);
       return PLUS_FAIL;
     }
 
-    // Copy frame
-    igsioVideoFrame frame = CurrentStreamBufferItem.GetFrame();
-    aTrackedFrame.SetImageData(frame);
+    // Share the pixels of the buffer slot, the buffer allocates new pixels for the slot when it is overwritten
+    if (StreamBufferItem::ShareFrameImage(CurrentStreamBufferItem.GetFrame(), *aTrackedFrame.GetImageData()) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Couldn't set image data of tracked frame from video buffer item: " << frameUID);
+      return PLUS_FAIL;
+    }
 
     // Copy all custom fields
-    igsioFieldMapType fieldMap = CurrentStreamBufferItem.GetFrameFieldMap();
-    for (igsioFieldMapType::const_iterator fieldIterator = fieldMap.begin(); fieldIterator != fieldMap.end(); fieldIterator++)
+    const FrameFieldStore& fields = CurrentStreamBufferItem.GetFrameFields();
+    for (unsigned int fieldIndex = 0; fieldIndex < fields.GetNumberOfFields(); ++fieldIndex)
     {
-      aTrackedFrame.SetFrameField((*fieldIterator).first, (*fieldIterator).second.second, fieldIterator->second.first);
+      aTrackedFrame.SetFrameField(fields.GetFieldName(fieldIndex), fields.GetFieldValue(fieldIndex), fields.GetFieldFlags(fieldIndex));
     }
 
     synchronizedTimestamp = CurrentStreamBufferItem.GetTimestamp(this->VideoSource->GetLocalTimeOffsetSec());
@@ -591,9 +888,13 @@ PlusStatus vtkPlusChannel::GetTrackedFrame(double timestamp, igsioTrackedFrame&
   // Add main tool timestamp
   aTrackedFrame.SetTimestamp(synchronizedTimestamp);
 
-  for (DataSourceContainerConstIterator it = this->GetToolsStartIterator(); it != this->GetToolsEndIterator(); ++it)
+  // Interpolate all tools in one pass
+  std::vector<ToolTransform> toolTransforms;
+  this->GetInterpolatedToolTransforms(synchronizedTimestamp, toolTransforms);
+  vtkSmartPointer<vtkMatrix4x4> dMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  for (std::vector<ToolTransform>::iterator toolTransformIt = toolTransforms.begin(); toolTransformIt != toolTransforms.end(); ++toolTransformIt)
   {
-    vtkPlusDataSource* aTool = it->second;
+    vtkPlusDataSource* aTool = toolTransformIt->Tool;
     igsioTransformName toolTransformName(aTool->GetId());
     if (!toolTransformName.IsValid())
     {
@@ -602,9 +903,7 @@ PlusStatus vtkPlusChannel::GetTrackedFrame(double timestamp, igsioTrackedFrame&
       continue;
     }
 
-    StreamBufferItem bufferItem;
-    ItemStatus result = aTool->GetStreamBufferItemFromTime(synchronizedTimestamp, &bufferItem, vtkPlusBuffer::INTERPOLATED);
-    if (result != ITEM_OK)
+    if (toolTransformIt->Result != ITEM_OK)
     {
       double latestTimestamp(0);
       if (aTool->GetLatestTimeStamp(latestTimestamp) != ITEM_OK)
@@ -625,14 +924,8 @@ PlusStatus vtkPlusChannel::GetTrackedFrame(double timestamp, igsioTrackedFrame&
       continue;
     }
 
-    vtkSmartPointer<vtkMatrix4x4> dMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-    if (bufferItem.GetMatrix(dMatrix) != PLUS_SUCCESS)
-    {
-      LOG_ERROR("Failed to get matrix from buffer item for tool " << aTool->GetId());
-      numberOfErrors++;
-      continue;
-    }
-
+    const vtkPlusBuffer::TransformSample& sample = toolTransformIt->Sample;
+    dMatrix->DeepCopy(sample.Matrix);
     if (aTrackedFrame.SetFrameTransform(toolTransformName, dMatrix) != PLUS_SUCCESS)
     {
       LOG_ERROR("Failed to set transform for tool " << aTool->GetId());
@@ -640,7 +933,7 @@ PlusStatus vtkPlusChannel::GetTrackedFrame(double timestamp, igsioTrackedFrame&
       continue;
     }
 
-    if (aTrackedFrame.SetFrameTransformStatus(toolTransformName, bufferItem.GetStatus()) != PLUS_SUCCESS)
+    if (aTrackedFrame.SetFrameTransformStatus(toolTransformName, sample.Status) != PLUS_SUCCESS)
     {
       LOG_ERROR("Failed to set transform status for tool " << aTool->GetId());
       numberOfErrors++;
@@ -648,14 +941,12 @@ PlusStatus vtkPlusChannel::GetTrackedFrame(double timestamp, igsioTrackedFrame&
     }
 
     // Copy all custom fields
-    igsioFieldMapType fieldMap = bufferItem.GetFrameFieldMap();
-    igsioFieldMapType::iterator fieldIterator;
-    for (igsioFieldMapType::const_iterator fieldIterator = fieldMap.begin(); fieldIterator != fieldMap.end(); fieldIterator++)
+    for (unsigned int fieldIndex = 0; fieldIndex < sample.FrameFields.GetNumberOfFields(); ++fieldIndex)
     {
-      aTrackedFrame.SetFrameField(fieldIterator->first, fieldIterator->second.second, fieldIterator->second.first);
+      aTrackedFrame.SetFrameField(sample.FrameFields.GetFieldName(fieldIndex), sample.FrameFields.GetFieldValue(fieldIndex), sample.FrameFields.GetFieldFlags(fieldIndex));
     }
 
-    synchronizedTimestamp = bufferItem.GetTimestamp(aTool->GetLocalTimeOffsetSec());
+    synchronizedTimestamp = sample.Timestamp;
   }
 
   for (DataSourceContainerConstIterator it = this->GetFieldDataSourcesStartIterator(); it != this->GetFieldDataSourcesEndIterator(); ++it)
@@ -686,10 +977,10 @@ PlusStatus vtkPlusChannel::GetTrackedFrame(double timestamp, igsioTrackedFrame&
     }
 
     // Copy all custom fields
-    igsioFieldMapType fieldMap = bufferItem.GetFrameFieldMap();
-    for (igsioFieldMapType::const_iterator fieldIterator = fieldMap.begin(); fieldIterator != fieldMap.end(); fieldIterator++)
+    const FrameFieldStore& fields = bufferItem.GetFrameFields();
+    for (unsigned int fieldIndex = 0; fieldIndex < fields.GetNumberOfFields(); ++fieldIndex)
     {
-      aTrackedFrame.SetFrameField(fieldIterator->first, fieldIterator->second.second, fieldIterator->second.first);
+      aTrackedFrame.SetFrameField(fields.GetFieldName(fieldIndex), fields.GetFieldValue(fieldIndex), fields.GetFieldFlags(fieldIndex));
     }
 
     synchronizedTimestamp = bufferItem.GetTimestamp(aSource->GetLocalTimeOffsetSec());
@@ -698,9 +989,84 @@ PlusStatus vtkPlusChannel::GetTrackedFrame(double timestamp, igsioTrackedFrame&
   // Copy frame timestamp
   aTrackedFrame.SetTimestamp(synchronizedTimestamp);
 
+  if (numberOfErrors == 0 && LatencyTracer::IsEnabled())
+  {
+    this->TraceAssembledFrame(aTrackedFrame);
+  }
+
   return (numberOfErrors == 0 ? PLUS_SUCCESS : PLUS_FAIL);
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusChannel::TraceAssembledFrame(igsioTrackedFrame& trackedFrame)
+{
+  // The frame is identified by the item of the source that determines the frame timestamps
+  vtkPlusDataSource* source = NULL;
+  if (this->HasVideoSource())
+  {
+    source = this->VideoSource;
+  }
+  else if (this->ToolCount() > 0)
+  {
+    this->GetTimestampMasterTool(source);
+  }
+  BufferItemUidType uid = 0;
+  if (source == NULL || source->GetItemUidFromTime(trackedFrame.GetTimestamp(), uid) != ITEM_OK)
+  {
+    return;
+  }
+  LatencyTracer::GetInstance().RecordFrameAssembled(this->ChannelId ? this->ChannelId : "", source, uid, trackedFrame.GetTimestamp());
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChannel::GetInterpolatedToolTransforms(double timestamp, std::vector<ToolTransform>& toolTransforms)
+{
+  // Reusing the batch of the thread avoids memory allocations in each call
+  static thread_local TransformInterpolationBatch batch;
+  batch.Clear();
+
+  PlusStatus status = PLUS_SUCCESS;
+  toolTransforms.resize(this->Tools.size());
+  std::vector<ToolTransform>::iterator toolTransformIt = toolTransforms.begin();
+  for (DataSourceContainerConstIterator it = this->GetToolsStartIterator(); it != this->GetToolsEndIterator(); ++it, ++toolTransformIt)
+  {
+    toolTransformIt->Tool = it->second;
+    toolTransformIt->Result = it->second->PrepareTransformInterpolation(timestamp, batch, toolTransformIt->Sample);
+    if (toolTransformIt->Result != ITEM_OK)
+    {
+      status = PLUS_FAIL;
+    }
+  }
+
+  batch.Interpolate();
+
+  const double warningThresholdDeg = vtkPlusBuffer::GetAngleInterpolationWarningThresholdDeg();
+  for (toolTransformIt = toolTransforms.begin(); toolTransformIt != toolTransforms.end(); ++toolTransformIt)
+  {
+    vtkPlusBuffer::TransformSample& sample = toolTransformIt->Sample;
+    if (toolTransformIt->Result != ITEM_OK || sample.BatchIndex < 0)
+    {
+      continue;
+    }
+    batch.GetInterpolatedMatrix(sample.BatchIndex, sample.Matrix);
+
+    double angleDiffA(0);
+    double angleDiffB(0);
+    batch.GetOrientationDifferences(sample.BatchIndex, angleDiffA, angleDiffB);
+    if (angleDiffA > warningThresholdDeg && angleDiffB > warningThresholdDeg)
+    {
+      static vtkIGSIOLogHelper helper(5.f, 5000, vtkPlusLogger::LOG_LEVEL_WARNING);
+      if (helper.ShouldWeLog(true))
+      {
+        LOG_WARNING(toolTransformIt->Tool->GetId() << ": Angle difference between interpolated orientations is large (" << angleDiffA << " and " << angleDiffB
+                    << " deg, warning threshold is " << warningThresholdDeg << "), interpolation may be inaccurate. Consider moving the tools slower.");
+      }
+    }
+  }
+
+  return status;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusChannel::GetTrackedFrame(igsioTrackedFrame& trackedFrame)
 {
@@ -1057,14 +1423,53 @@ PlusStatus vtkPlusChannel::GetTrackedFrameListSampled(double& aTimestampOfLastFr
     return PLUS_FAIL;
   }
 
+  return this->SampleTrackedFrames(aTimestampOfLastFrameAlreadyGot, aTimestampOfNextFrameToBeAdded, aSamplingPeriodSec, maxTimeLimitSec,
+                                   [this, aTrackedFrameList](const TrackedFrameReference & reference, double & frameTimestamp)
+  {
+    // Get tracked frame from buffer (the pixels are shared with the buffer, field data is copied)
+    igsioTrackedFrame* trackedFrame = new igsioTrackedFrame;
+    if (this->GetTrackedFrame(reference.Timestamp, *trackedFrame) != PLUS_SUCCESS)
+    {
+      delete trackedFrame;
+      return ITEM_NOT_AVAILABLE_ANYMORE;
+    }
+    frameTimestamp = trackedFrame->GetTimestamp();
+    // Add tracked frame to the list
+    if (aTrackedFrameList->TakeTrackedFrame(trackedFrame, vtkIGSIOTrackedFrameList::SKIP_INVALID_FRAME) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("vtkPlusChannel::GetTrackedFrameListSampled: Unable to add tracked frame to the list");
+      return ITEM_UNKNOWN_ERROR;
+    }
+    return ITEM_OK;
+  });
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChannel::GetTrackedFrameReferencesSampled(double& aTimestampOfLastFrameAlreadyGot, double& aTimestampOfNextFrameToBeAdded, std::vector<TrackedFrameReference>& aReferences, double aSamplingPeriodSec, double maxTimeLimitSec/*=-1*/)
+{
+  LOG_TRACE("vtkPlusChannel::GetTrackedFrameReferencesSampled: aTimestampOfLastFrameAlreadyGot=" << aTimestampOfLastFrameAlreadyGot << ", aTimestampOfNextFrameToBeAdded=" << aTimestampOfNextFrameToBeAdded << ", aSamplingPeriodSec=" << aSamplingPeriodSec);
+
+  return this->SampleTrackedFrames(aTimestampOfLastFrameAlreadyGot, aTimestampOfNextFrameToBeAdded, aSamplingPeriodSec, maxTimeLimitSec,
+                                   [&aReferences](const TrackedFrameReference & reference, double & frameTimestamp)
+  {
+    aReferences.push_back(reference);
+    frameTimestamp = reference.Timestamp;
+    return ITEM_OK;
+  });
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChannel::SampleTrackedFrames(double& aTimestampOfLastFrameAlreadyGot, double& aTimestampOfNextFrameToBeAdded, double aSamplingPeriodSec, double maxTimeLimitSec,
+    const std::function<ItemStatus(const TrackedFrameReference&, double&)>& addFrame)
+{
   double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
 
   double mostRecentTimestamp(0);
   RETURN_WITH_FAIL_IF(this->GetMostRecentTimestamp(mostRecentTimestamp) != PLUS_SUCCESS,
-                      "vtkPlusChannel::GetTrackedFrameListSampled failed: unable to get most recent timestamp. Probably no frames have been acquired yet.");
+                      "vtkPlusChannel::SampleTrackedFrames failed: unable to get most recent timestamp. Probably no frames have been acquired yet.");
 
   PlusStatus status = PLUS_SUCCESS;
-  // Add frames to input trackedFrameList
+  // Add frames
   for (; aTimestampOfNextFrameToBeAdded <= mostRecentTimestamp; aTimestampOfNextFrameToBeAdded += aSamplingPeriodSec)
   {
     // If the time that is allowed for adding of frames is expired then stop the processing now
@@ -1080,50 +1485,138 @@ PlusStatus vtkPlusChannel::GetTrackedFrameListSampled(double& aTimestampOfLastFr
     double oldestTimestamp = 0;
     if (this->GetOldestTimestamp(oldestTimestamp) != PLUS_SUCCESS)
     {
-      LOG_ERROR("vtkPlusChannel::GetTrackedFrameListSampled: Failed to get oldest timestamp from buffer. Probably no frames have been acquired yet.");
+      LOG_ERROR("vtkPlusChannel::SampleTrackedFrames: Failed to get oldest timestamp from buffer. Probably no frames have been acquired yet.");
       return PLUS_FAIL;
     }
     if (aTimestampOfNextFrameToBeAdded < oldestTimestamp + SAMPLING_SKIPPING_MARGIN_SEC)
     {
       double newTimestampOfFrameToBeAdded = oldestTimestamp + SAMPLING_SKIPPING_MARGIN_SEC;
-      LOG_WARNING("vtkPlusChannel::GetTrackedFrameListSampled: Frames in the buffer are not available any more at time: " << std::fixed << aTimestampOfNextFrameToBeAdded << ". Skipping " << newTimestampOfFrameToBeAdded - aTimestampOfNextFrameToBeAdded << " seconds from the recording to catch up. Increase the buffer size or decrease the acquisition rate to avoid this situation.");
+      LOG_WARNING("vtkPlusChannel::SampleTrackedFrames: Frames in the buffer are not available any more at time: " << std::fixed << aTimestampOfNextFrameToBeAdded << ". Skipping " << newTimestampOfFrameToBeAdded - aTimestampOfNextFrameToBeAdded << " seconds from the recording to catch up. Increase the buffer size or decrease the acquisition rate to avoid this situation.");
       aTimestampOfNextFrameToBeAdded = newTimestampOfFrameToBeAdded;
       continue;
     }
 
     // Get the closest frame to the timestamp of the next frame to be added
-    double closestTimestamp = GetClosestTrackedFrameTimestampByTime(aTimestampOfNextFrameToBeAdded);
-    if (closestTimestamp == UNDEFINED_TIMESTAMP)
+    TrackedFrameReference reference;
+    if (this->GetClosestTrackedFrameReference(aTimestampOfNextFrameToBeAdded, reference) != ITEM_OK)
     {
-      LOG_ERROR("vtkPlusChannel::GetTrackedFrameListSampled: Failed to get closest timestamp from buffer for the next frame. Probably no frames have been acquired yet.");
+      LOG_ERROR("vtkPlusChannel::SampleTrackedFrames: Failed to get closest timestamp from buffer for the next frame. Probably no frames have been acquired yet.");
       return PLUS_FAIL;
     }
-    if (aTimestampOfLastFrameAlreadyGot != UNDEFINED_TIMESTAMP && closestTimestamp <= aTimestampOfLastFrameAlreadyGot)
+    if (aTimestampOfLastFrameAlreadyGot != UNDEFINED_TIMESTAMP && reference.Timestamp <= aTimestampOfLastFrameAlreadyGot)
     {
       // This frame has been already added. Don't spend time with retrieving this frame, just jump to the next
       continue;
     }
-    // Get tracked frame from buffer (actually copies pixel and field data)
-    igsioTrackedFrame* trackedFrame = new igsioTrackedFrame;
-    if (GetTrackedFrame(closestTimestamp, *trackedFrame) != PLUS_SUCCESS)
+
+    double frameTimestamp = reference.Timestamp;
+    ItemStatus frameStatus = addFrame(reference, frameTimestamp);
+    if (frameStatus == ITEM_NOT_AVAILABLE_ANYMORE)
     {
-      LOG_WARNING("vtkPlusChannel::GetTrackedFrameListSampled: Unable retrieve frame from the devices for time: " << std::fixed << aTimestampOfNextFrameToBeAdded << ", probably the item is not available in the buffers anymore. Frames may be lost.");
-      delete trackedFrame;
+      LOG_WARNING("vtkPlusChannel::SampleTrackedFrames: Unable retrieve frame from the devices for time: " << std::fixed << aTimestampOfNextFrameToBeAdded << ", probably the item is not available in the buffers anymore. Frames may be lost.");
       continue;
     }
-    aTimestampOfLastFrameAlreadyGot = trackedFrame->GetTimestamp();
-    // Add tracked frame to the list
-    if (aTrackedFrameList->TakeTrackedFrame(trackedFrame, vtkIGSIOTrackedFrameList::SKIP_INVALID_FRAME) != PLUS_SUCCESS)
+    aTimestampOfLastFrameAlreadyGot = frameTimestamp;
+    if (frameStatus != ITEM_OK)
     {
-      LOG_ERROR("vtkPlusChannel::GetTrackedFrameListSampled: Unable to add tracked frame to the list");
       status = PLUS_FAIL;
     }
   }
 
-
   return status;
 }
 
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusChannel::GetTrackedFrameReferenceStatus(const TrackedFrameReference& aReference)
+{
+  vtkPlusDataSource* source = NULL;
+  if (this->GetTimestampSource(source) != PLUS_SUCCESS)
+  {
+    return ITEM_UNKNOWN_ERROR;
+  }
+  if (source->GetNumberOfItems() < 1 || aReference.Uid > source->GetLatestItemUidInBuffer())
+  {
+    // the buffer has been cleared since the reference was created
+    return ITEM_NOT_AVAILABLE_ANYMORE;
+  }
+  if (aReference.Uid < source->GetOldestItemUidInBuffer())
+  {
+    return ITEM_NOT_AVAILABLE_ANYMORE;
+  }
+  // UIDs restart when the buffer is cleared, the timestamp identifies the item
+  double timestamp(0);
+  ItemStatus status = source->GetTimeStamp(aReference.Uid, timestamp);
+  if (status != ITEM_OK)
+  {
+    return status;
+  }
+  return (timestamp == aReference.Timestamp) ? ITEM_OK : ITEM_NOT_AVAILABLE_ANYMORE;
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusChannel::GetReferencedTrackedFrame(const TrackedFrameReference& aReference, igsioTrackedFrame& aTrackedFrame, bool enableImageData/*=true*/)
+{
+  ItemStatus status = this->GetTrackedFrameReferenceStatus(aReference);
+  if (status != ITEM_OK)
+  {
+    return status;
+  }
+  if (this->GetTrackedFrame(aReference.Timestamp, aTrackedFrame, enableImageData) != PLUS_SUCCESS)
+  {
+    // the item may have been overwritten while the frame was assembled
+    status = this->GetTrackedFrameReferenceStatus(aReference);
+    return (status == ITEM_OK) ? ITEM_UNKNOWN_ERROR : status;
+  }
+  return ITEM_OK;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChannel::WaitForItemNewerThan(double timestamp, double timeoutSec)
+{
+  // The most recent synchronized timestamp is limited by the source that lags the most,
+  // so wait for each source in turn, sharing the same deadline
+  std::vector<vtkPlusDataSource*> sources;
+  if (this->GetVideoDataAvailable())
+  {
+    sources.push_back(this->VideoSource);
+  }
+  if (this->GetTrackingEnabled())
+  {
+    for (DataSourceContainerIterator it = this->Tools.begin(); it != this->Tools.end(); ++it)
+    {
+      sources.push_back(it->second);
+    }
+  }
+  if (this->GetFieldDataEnabled())
+  {
+    for (DataSourceContainerIterator it = this->FieldDataSources.begin(); it != this->FieldDataSources.end(); ++it)
+    {
+      sources.push_back(it->second);
+    }
+  }
+
+  if (sources.empty())
+  {
+    vtkIGSIOAccurateTimer::Delay(timeoutSec);
+    return PLUS_FAIL;
+  }
+
+  const double deadline = vtkIGSIOAccurateTimer::GetSystemTime() + timeoutSec;
+  for (std::vector<vtkPlusDataSource*>::iterator it = sources.begin(); it != sources.end(); ++it)
+  {
+    if (*it == NULL)
+    {
+      continue;
+    }
+    if ((*it)->WaitForItemNewerThan(timestamp, deadline - vtkIGSIOAccurateTimer::GetSystemTime()) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+  }
+
+  return PLUS_SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusChannel::GetOldestTimestamp(double& ts)
 {
@@ -1657,60 +2150,54 @@ int vtkPlusChannel::GetNumberOfFramesBetweenTimestamps(double aTimestampFrom, do
 //----------------------------------------------------------------------------
 double vtkPlusChannel::GetClosestTrackedFrameTimestampByTime(double time)
 {
+  TrackedFrameReference reference;
+  if (this->GetClosestTrackedFrameReference(time, reference) != ITEM_OK)
+  {
+    return UNDEFINED_TIMESTAMP;
+  }
+  return reference.Timestamp;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChannel::GetTimestampSource(vtkPlusDataSource*& aSource)
+{
+  aSource = NULL;
   if (this->GetVideoDataAvailable())
   {
-    BufferItemUidType uid = 0;
-    if (this->VideoSource->GetItemUidFromTime(time, uid) != ITEM_OK)
-    {
-      return UNDEFINED_TIMESTAMP;
-    }
-    double closestTimestamp = UNDEFINED_TIMESTAMP;
-    if (this->VideoSource->GetTimeStamp(uid, closestTimestamp) != ITEM_OK)
-    {
-      return UNDEFINED_TIMESTAMP;
-    }
-    return closestTimestamp;
+    aSource = this->VideoSource;
+    return PLUS_SUCCESS;
   }
 
   if (this->GetTrackingEnabled())
   {
-    vtkPlusDataSource* masterTool = NULL;
-    if (this->GetTimestampMasterTool(masterTool) != PLUS_SUCCESS)
-    {
-      // there is no active tool
-      return UNDEFINED_TIMESTAMP;
-    }
-    BufferItemUidType uid = 0;
-    if (masterTool->GetItemUidFromTime(time, uid) != ITEM_OK)
-    {
-      return UNDEFINED_TIMESTAMP;
-    }
-    double closestTimestamp = UNDEFINED_TIMESTAMP;
-    if (masterTool->GetTimeStamp(uid, closestTimestamp) != ITEM_OK)
-    {
-      return UNDEFINED_TIMESTAMP;
-    }
-    return closestTimestamp;
+    // fails if there is no active tool
+    return this->GetTimestampMasterTool(aSource);
   }
 
   if (this->GetFieldDataEnabled())
   {
-    vtkPlusDataSource* firstSource = this->FieldDataSources.begin()->second;
-    BufferItemUidType uid = 0;
-    if (firstSource->GetItemUidFromTime(time, uid) != ITEM_OK)
-    {
-      return UNDEFINED_TIMESTAMP;
-    }
-    double closestTimestamp = UNDEFINED_TIMESTAMP;
-    if (firstSource->GetTimeStamp(uid, closestTimestamp) != ITEM_OK)
-    {
-      return UNDEFINED_TIMESTAMP;
-    }
-    return closestTimestamp;
+    aSource = this->FieldDataSources.begin()->second;
+    return PLUS_SUCCESS;
   }
 
   // neither tracker, nor video, nor field data available
-  return UNDEFINED_TIMESTAMP;
+  return PLUS_FAIL;
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusChannel::GetClosestTrackedFrameReference(double time, TrackedFrameReference& aReference)
+{
+  vtkPlusDataSource* source = NULL;
+  if (this->GetTimestampSource(source) != PLUS_SUCCESS)
+  {
+    return ITEM_UNKNOWN_ERROR;
+  }
+  ItemStatus status = source->GetItemUidFromTime(time, aReference.Uid);
+  if (status != ITEM_OK)
+  {
+    return status;
+  }
+  return source->GetTimeStamp(aReference.Uid, aReference.Timestamp);
 }
 
 //----------------------------------------------------------------------------
@@ -1821,6 +2308,25 @@ PlusStatus vtkPlusChannel::GenerateDataAcquisitionReport(vtkPlusHTMLGenerator* h
 
   int imageSize[2] = {800, 400};
 
+  unsigned long trackedFrameCacheHits(0);
+  unsigned long trackedFrameCacheMisses(0);
+  this->GetTrackedFrameCacheStatistics(trackedFrameCacheHits, trackedFrameCacheMisses);
+  std::ostringstream cacheReport;
+  cacheReport << "Tracked frame cache: " << trackedFrameCacheHits << " hits, " << trackedFrameCacheMisses << " misses (hit rate: "
+              << std::fixed << std::setprecision(1) << this->GetTrackedFrameCacheHitRate() * 100.0 << "%)";
+  htmlReport->AddParagraph(cacheReport.str().c_str());
+
+  FrameProcessingStatistics processingStatistics = this->GetFrameProcessingStatistics();
+  if (processingStatistics.NumberOfProcessedFrames > 0 || processingStatistics.NumberOfSkippedFrames > 0)
+  {
+    std::ostringstream processingReport;
+    processingReport << "Frame processing: " << processingStatistics.NumberOfProcessedFrames << " processed, "
+                     << processingStatistics.NumberOfSkippedFrames << " skipped frames (processing time: mean "
+                     << std::fixed << std::setprecision(1) << processingStatistics.GetMeanProcessingTimeSec() * 1000.0 << "ms, maximum "
+                     << processingStatistics.MaximumProcessingTimeSec * 1000.0 << "ms)";
+    htmlReport->AddParagraph(processingReport.str().c_str());
+  }
+
   // Video data
   vtkPlusDataSource* videoSource = NULL;
   if (this->GetVideoSource(videoSource) == PLUS_SUCCESS && videoSource != NULL)
@@ -1920,4 +2426,172 @@ bool vtkPlusChannel::IsVideoSource3D() const
   {
     return false;
   }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChannel::StartSharedMemoryOutput()
+{
+  if (this->SharedMemoryOutputName.empty() || this->SharedMemoryOutputSource != NULL)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  vtkPlusDataSource* triggerSource = NULL;
+  if (this->HasVideoSource())
+  {
+    triggerSource = this->VideoSource;
+  }
+  else if (this->ToolCount() > 0)
+  {
+    this->GetTimestampMasterTool(triggerSource);
+  }
+  if (triggerSource == NULL)
+  {
+    LOG_ERROR("Cannot publish channel " << (this->ChannelId ? this->ChannelId : "") << " into shared memory " << this->SharedMemoryOutputName << ": the channel has no video or tool data source");
+    return PLUS_FAIL;
+  }
+
+  // Publish from the most recent frame, the shared memory is created when the first frame is published (its size depends on the frame size)
+  this->SharedMemoryOutputSource = triggerSource;
+  this->SharedMemoryOutputLastUid = 0;
+  if (DataflowScheduler::GetInstance().AddTask(this, std::vector<const void*>(1, triggerSource), [this]() { this->PublishToSharedMemory(); return true; }) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to schedule publishing of channel " << (this->ChannelId ? this->ChannelId : "") << " into shared memory " << this->SharedMemoryOutputName);
+    this->SharedMemoryOutputSource = NULL;
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusChannel::StopSharedMemoryOutput()
+{
+  if (this->SharedMemoryOutputSource == NULL)
+  {
+    return;
+  }
+  // Waits for the completion of the current publishing
+  DataflowScheduler::GetInstance().RemoveTask(this);
+  this->SharedMemoryOutputSource = NULL;
+  this->SharedMemoryOutput->Close();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusChannel::AddConsumer(const void* consumerId)
+{
+  std::lock_guard<std::mutex> lock(this->ConsumersMutex);
+  if (this->Consumers.insert(consumerId).second)
+  {
+    this->NumberOfConsumers = static_cast<int>(this->Consumers.size());
+    LOG_DEBUG("Consumer added to channel " << (this->ChannelId ? this->ChannelId : "(unknown)") << ", number of consumers: " << this->Consumers.size());
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusChannel::RemoveConsumer(const void* consumerId)
+{
+  std::lock_guard<std::mutex> lock(this->ConsumersMutex);
+  if (this->Consumers.erase(consumerId) > 0)
+  {
+    this->NumberOfConsumers = static_cast<int>(this->Consumers.size());
+    LOG_DEBUG("Consumer removed from channel " << (this->ChannelId ? this->ChannelId : "(unknown)") << ", number of consumers: " << this->Consumers.size());
+  }
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusChannel::GetNumberOfConsumers() const
+{
+  return this->NumberOfConsumers;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusChannel::PublishToSharedMemory()
+{
+  vtkPlusDataSource* source = this->SharedMemoryOutputSource;
+  if (source == NULL || source->GetNumberOfItems() == 0)
+  {
+    return;
+  }
+
+  BufferItemUidType latestUid = source->GetLatestItemUidInBuffer();
+  BufferItemUidType oldestUid = source->GetOldestItemUidInBuffer();
+  BufferItemUidType firstUid = this->SharedMemoryOutputLastUid + 1;
+  if (this->SharedMemoryOutputLastUid == 0)
+  {
+    firstUid = latestUid;
+  }
+  else if (firstUid < oldestUid)
+  {
+    LOG_WARNING("Publishing into shared memory " << this->SharedMemoryOutputName << " cannot keep up with the acquisition, " << oldestUid - firstUid << " frames are skipped");
+    firstUid = oldestUid;
+  }
+
+  for (BufferItemUidType uid = firstUid; uid <= latestUid; ++uid)
+  {
+    StreamBufferItem bufferItem;
+    if (source->GetStreamBufferItem(uid, &bufferItem, true /* share image data */) != ITEM_OK)
+    {
+      // overwritten since the UID range was queried
+      continue;
+    }
+    double timestamp = bufferItem.GetTimestamp(source->GetLocalTimeOffsetSec());
+    double unfilteredTimestamp = bufferItem.GetUnfilteredTimestamp(source->GetLocalTimeOffsetSec());
+    igsioTrackedFrame trackedFrame;
+    if (this->GetTrackedFrame(timestamp, trackedFrame, this->HasVideoSource()) != PLUS_SUCCESS
+        || this->AddFrameToSharedMemory(trackedFrame, unfilteredTimestamp) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to publish frame " << std::fixed << timestamp << " into shared memory " << this->SharedMemoryOutputName);
+    }
+  }
+  this->SharedMemoryOutputLastUid = latestUid;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChannel::AddFrameToSharedMemory(igsioTrackedFrame& trackedFrame, double unfilteredTimestamp)
+{
+  SharedMemoryRing::ItemInfo info;
+  // Timestamps are stored as universal time, because the system time is specific to the process
+  info.FilteredTimestamp = vtkIGSIOAccurateTimer::GetUniversalTimeFromSystemTime(trackedFrame.GetTimestamp());
+  info.UnfilteredTimestamp = vtkIGSIOAccurateTimer::GetUniversalTimeFromSystemTime(unfilteredTimestamp);
+
+  const void* imageData = NULL;
+  size_t imageDataSizeBytes = 0;
+  igsioVideoFrame* image = trackedFrame.GetImageData();
+  if (image != NULL && image->IsImageValid())
+  {
+    FrameSizeType frameSize = image->GetFrameSize();
+    unsigned int numberOfScalarComponents(1);
+    image->GetNumberOfScalarComponents(numberOfScalarComponents);
+    for (int i = 0; i < 3; ++i)
+    {
+      info.FrameSize[i] = frameSize[i];
+    }
+    info.ScalarType = image->GetVTKScalarPixelType();
+    info.NumberOfScalarComponents = numberOfScalarComponents;
+    info.ImageType = image->GetImageType();
+    info.ImageOrientation = image->GetImageOrientation();
+    imageData = image->GetScalarPointer();
+    imageDataSizeBytes = image->GetFrameSizeInBytes();
+  }
+
+  std::map<std::string, std::string> fields;
+  igsioFieldMapType frameFields = trackedFrame.GetFrameFields();
+  for (igsioFieldMapType::const_iterator fieldIt = frameFields.begin(); fieldIt != frameFields.end(); ++fieldIt)
+  {
+    fields[fieldIt->first] = fieldIt->second.second;
+  }
+  std::string fieldData;
+  SharedMemoryRing::EncodeFields(fields, fieldData);
+
+  size_t itemSizeBytes = imageDataSizeBytes + fieldData.size();
+  if (!this->SharedMemoryOutput->IsOpen() || this->SharedMemoryOutput->GetItemCapacityBytes() < itemSizeBytes)
+  {
+    // The consumers are notified that the ring is closed and they open the new one
+    if (this->SharedMemoryOutput->Create(this->SharedMemoryOutputName, this->SharedMemoryOutputNumberOfItems, itemSizeBytes + SHARED_MEMORY_OUTPUT_FIELD_CAPACITY_BYTES) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    LOG_INFO("Publishing channel " << (this->ChannelId ? this->ChannelId : "") << " into shared memory " << this->SharedMemoryOutputName);
+  }
+  return this->SharedMemoryOutput->AddItem(info, imageData, imageDataSizeBytes, fieldData);
 }
\ No newline at end of file
@@ -11,10 +11,23 @@
 #include "vtkPlusDataCollectionExport.h"
 
 #include "PlusStreamBufferItem.h"
+#include "vtkPlusBuffer.h"
 #include "vtkDataObject.h"
 #include "vtkPlusRfProcessor.h"
 
-//class igsioTrackedFrame; 
+// IGSIO includes
+#include <igsioTrackedFrame.h>
+
+// STL includes
+#include <atomic>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <set>
+#include <vector>
+
+class SharedMemoryRing;
+class vtkIGSIORecursiveCriticalSection;
 class vtkPlusHTMLGenerator;
 class vtkPlusDataSource;
 class vtkPlusDevice;
@@ -108,10 +121,74 @@ public:
     \param timestamp Timestamp of the requested tracked frame
     \param trackedFrame Target tracked frame
     \param enableImageData Enable returning of image data. Tracking data will be interpolated at the timestamp of the image data.
+    The image pixels are shared (reference counted) with the video buffer and with other tracked frames, therefore they must not be modified in place.
   */
   virtual PlusStatus GetTrackedFrame(double timestamp, igsioTrackedFrame& trackedFrame, bool enableImageData = true);
   virtual PlusStatus GetTrackedFrame(igsioTrackedFrame& trackedFrame);
 
+  /*! Transform of a tool at a requested time, see GetInterpolatedToolTransforms */
+  struct ToolTransform
+  {
+    ToolTransform() : Tool(NULL), Result(ITEM_UNKNOWN_ERROR) {}
+    vtkPlusDataSource* Tool;
+    /*! ITEM_OK if the transform of the tool is available at the requested time */
+    ItemStatus Result;
+    /*! Transform matrix, status, timestamp and frame fields of the tool */
+    vtkPlusBuffer::TransformSample Sample;
+  };
+
+  /*!
+    Get the transforms of all tools of the channel at the specified time. The result is the same as calling
+    GetStreamBufferItemFromTime(timestamp, item, vtkPlusBuffer::INTERPOLATED) for each tool, but the buffer items
+    are not copied and the transforms of all tools are interpolated together in one pass (see TransformInterpolationBatch).
+    Returns PLUS_FAIL if the transform of any tool is not available (see ToolTransform::Result).
+  */
+  PlusStatus GetInterpolatedToolTransforms(double timestamp, std::vector<ToolTransform>& toolTransforms);
+
+  /*!
+    Set the maximum number of assembled tracked frames that are kept in the tracked frame cache.
+    GetTrackedFrame returns a copy of the cached frame if a frame is requested again at exactly the same timestamp
+    (typical when multiple consumers, such as the OpenIGTLink server and the recorder, request the same latest frame).
+    The least recently used frame is dropped when the cache is full. Set to 0 to disable caching.
+  */
+  void SetTrackedFrameCacheSize(int cacheSize);
+  vtkGetMacro(TrackedFrameCacheSize, int);
+
+  /*! Remove all frames from the tracked frame cache. Called automatically when the buffers or the sources of the channel change. */
+  void ClearTrackedFrameCache();
+
+  /*! Get the number of GetTrackedFrame calls that were served from the tracked frame cache (hits) and that had to assemble the frame (misses) */
+  void GetTrackedFrameCacheStatistics(unsigned long& numberOfHits, unsigned long& numberOfMisses) const;
+
+  /*! Get the ratio of GetTrackedFrame calls served from the tracked frame cache (0 if there were no calls yet) */
+  double GetTrackedFrameCacheHitRate() const;
+
+  /*! Statistics of the frames that a processing device (such as vtkPlusImageProcessorVideoSource) generated into this channel */
+  struct FrameProcessingStatistics
+  {
+    FrameProcessingStatistics()
+      : NumberOfProcessedFrames(0), NumberOfSkippedFrames(0), ProcessingTimeSumSec(0), MaximumProcessingTimeSec(0), LastProcessingTimeSec(0) {}
+    double GetMeanProcessingTimeSec() const { return NumberOfProcessedFrames > 0 ? ProcessingTimeSumSec / NumberOfProcessedFrames : 0.0; }
+    unsigned long NumberOfProcessedFrames;
+    /*! Input frames that were not processed or whose result was not used, because a newer frame was available */
+    unsigned long NumberOfSkippedFrames;
+    double ProcessingTimeSumSec;
+    double MaximumProcessingTimeSec;
+    double LastProcessingTimeSec;
+  };
+
+  /*! Record that a processed frame was added to the channel. Called by the device that generates the frames. */
+  void AddProcessedFrameStatistics(double processingTimeSec);
+
+  /*! Record that input frames were skipped by the device that generates the frames of this channel */
+  void AddSkippedFrameStatistics(unsigned long numberOfSkippedFrames);
+
+  /*! Get the processing statistics of the frames of the channel */
+  FrameProcessingStatistics GetFrameProcessingStatistics() const;
+
+  /*! Set all frame processing statistics to zero */
+  void ResetFrameProcessingStatistics();
+
   /*!
     Get the tracked frame list from devices since time specified
     \param aTimestampOfLastFrameAlreadyGot Used for preventing returning the same frame multiple times. In: the timestamp of the timestamp that has been already returned in previous GetTrackedFrameListSampled calls. If no frames have got yet then set it to UNDEFINED_TIMESTAMP. Out: the timestamp of the most recent frame that is returned.
@@ -122,6 +199,36 @@ public:
   */
   virtual PlusStatus GetTrackedFrameListSampled(double& aTimestampOfLastFrameAlreadyGot, double& aTimestampOfNextFrameToBeAdded, vtkIGSIOTrackedFrameList* aTrackedFrameList, double aSamplingPeriodSec, double maxTimeLimitSec = -1);
 
+  /*!
+    Reference to a tracked frame in the buffers of the channel, without the frame content.
+    Uid is the UID of the item in the timestamp source of the channel (video source, or timestamp master tool, or first field data source).
+  */
+  struct TrackedFrameReference
+  {
+    TrackedFrameReference() : Uid(0), Timestamp(UNDEFINED_TIMESTAMP) {}
+    BufferItemUidType Uid;
+    double Timestamp;
+  };
+
+  /*!
+    Sample the frames the same way as GetTrackedFrameListSampled, but only get references to the frames, without assembling them.
+    Sampling is therefore fast even for long periods, and the frames can be retrieved by GetReferencedTrackedFrame
+    when they are needed, as long as they are in the buffers.
+    The new references are appended to aReferences. The other parameters are the same as in GetTrackedFrameListSampled.
+  */
+  virtual PlusStatus GetTrackedFrameReferencesSampled(double& aTimestampOfLastFrameAlreadyGot, double& aTimestampOfNextFrameToBeAdded, std::vector<TrackedFrameReference>& aReferences, double aSamplingPeriodSec, double maxTimeLimitSec = -1);
+
+  /*!
+    Get the tracked frame that a reference points to.
+    The image pixels are shared with the buffer (they remain valid when the buffer slot is overwritten),
+    a consumer that modifies the pixels has to call StreamBufferItem::DetachFrameImage first.
+    Returns ITEM_NOT_AVAILABLE_ANYMORE without logging an error if the frame has already been removed from the buffer.
+  */
+  virtual ItemStatus GetReferencedTrackedFrame(const TrackedFrameReference& aReference, igsioTrackedFrame& aTrackedFrame, bool enableImageData = true);
+
+  /*! Get the status of the referenced frame: ITEM_OK if it is still in the buffer, ITEM_NOT_AVAILABLE_ANYMORE if it has been removed */
+  virtual ItemStatus GetTrackedFrameReferenceStatus(const TrackedFrameReference& aReference);
+
   /*!
     Get all the tracked frame list from devices since time specified
     \param aTimestampOfLastFrameAlreadyGot Used for preventing returning the same frame multiple times.
@@ -142,11 +249,34 @@ public:
   /*! Return the oldest synchronized timestamp in the buffers */
   virtual PlusStatus GetOldestTimestamp(double& ts);
 
+  /*!
+    Block until all the video, tool and field data sources of the channel contain an item that is newer
+    than the specified timestamp, or until the timeout expires. Consumers should use this instead of
+    polling GetMostRecentTimestamp with a fixed delay.
+    Returns PLUS_SUCCESS if newer data is available, PLUS_FAIL on timeout.
+  */
+  virtual PlusStatus WaitForItemNewerThan(double timestamp, double timeoutSec);
+
   virtual PlusStatus Clear();
 
   virtual void ShallowCopy(vtkDataObject*);
   virtual void ShallowCopy(const vtkPlusChannel& aChannel);
 
+  /*!
+    Replace the video, tool and field data sources of the channel by the sources of another channel.
+    The sources are shared with the other channel and their buffers are not cleared (unlike ShallowCopy).
+    The new source containers are built first and then swapped in at once. The previous containers are kept until the next switch,
+    so a consumer that is still iterating them does not access freed memory.
+  */
+  PlusStatus SwitchSources(const vtkPlusChannel& aChannel);
+
+  /*!
+    Counter that is incremented whenever the sources of the channel change. It is odd while SwitchSources is in progress.
+    Consumers can read it before and after getting frames from the channel to detect without locking that the sources
+    were switched meanwhile, and discard the frames that may mix data of the previous and the new sources.
+  */
+  unsigned long GetSourcesGeneration() const { return this->SourcesGeneration.load(); }
+
   virtual PlusStatus GetLatestTimestamp(double& aTimestamp) const;
 
   void SetOwnerDevice(vtkPlusDevice* _arg) { this->OwnerDevice = _arg; }
@@ -164,6 +294,42 @@ public:
 
   vtkSetMacro(SaveRfProcessingParameters, bool);
 
+  /*!
+    Name of the shared memory that the frames of the channel are published into (see SharedMemoryRing).
+    If it is empty (default) then the frames are not published. Processes on the same computer can read the frames
+    directly from the shared memory, for example, by using a SharedMemory device.
+  */
+  vtkSetStdStringMacro(SharedMemoryOutputName);
+  vtkGetStdStringMacro(SharedMemoryOutputName);
+
+  /*! Number of frames kept in the shared memory output */
+  vtkSetMacro(SharedMemoryOutputNumberOfItems, int);
+  vtkGetMacro(SharedMemoryOutputNumberOfItems, int);
+
+  /*!
+    Start publishing each new frame of the channel into the shared memory output. Frames are published when
+    they are added to the video source (or to the timestamp master tool if there is no video source).
+    Does nothing if no shared memory output name is set. Called by the owner device when recording is started.
+  */
+  PlusStatus StartSharedMemoryOutput();
+
+  /*! Stop publishing frames and close the shared memory output. Called by the owner device when recording is stopped. */
+  void StopSharedMemoryOutput();
+
+  /*!
+    Register a consumer of the channel: a server that broadcasts it to connected clients, or a recording device that
+    uses it as input. Owner devices that have IdleWhenUnconsumed enabled skip their processing while none of their output
+    channels has a consumer. Adding the same consumer again has no effect.
+    \param consumerId Unique identifier of the consumer (typically its pointer)
+  */
+  void AddConsumer(const void* consumerId);
+
+  /*! Unregister a consumer of the channel. Removing a consumer that is not registered has no effect. */
+  void RemoveConsumer(const void* consumerId);
+
+  /*! Number of registered consumers. Can be called from any thread, it does not lock. */
+  int GetNumberOfConsumers() const;
+
   /*!
     Add generated html report from data acquisition to the existing html report.
     htmlReport and plotter arguments has to be defined by the caller function
@@ -174,6 +340,59 @@ protected:
   /*! Get number of tracked frames between two given timestamps (inclusive) */
   virtual int GetNumberOfFramesBetweenTimestamps(double aTimestampFrom, double aTimestampTo);
 
+  /*! Get the data source that provides the timestamps of the tracked frames (video source, or timestamp master tool, or first field data source) */
+  PlusStatus GetTimestampSource(vtkPlusDataSource*& aSource);
+
+  /*! Get a reference to the tracked frame closest to the specified time */
+  ItemStatus GetClosestTrackedFrameReference(double time, TrackedFrameReference& aReference);
+
+  /*!
+    Sampling loop of GetTrackedFrameListSampled and GetTrackedFrameReferencesSampled. addFrame is called for each sampled frame
+    and it sets the timestamp of the added frame. If it returns ITEM_NOT_AVAILABLE_ANYMORE then the frame is skipped,
+    if it returns ITEM_UNKNOWN_ERROR then sampling continues but the method returns PLUS_FAIL.
+  */
+  PlusStatus SampleTrackedFrames(double& aTimestampOfLastFrameAlreadyGot, double& aTimestampOfNextFrameToBeAdded, double aSamplingPeriodSec, double maxTimeLimitSec,
+                                 const std::function<ItemStatus(const TrackedFrameReference&, double&)>& addFrame);
+
+  /*! Assemble a tracked frame from the buffers of the data sources (GetTrackedFrame without caching) */
+  virtual PlusStatus AssembleTrackedFrame(double timestamp, igsioTrackedFrame& trackedFrame, bool enableImageData);
+
+  /*! Record the latency trace point of an assembled frame (only called if latency tracing is enabled) */
+  void TraceAssembledFrame(igsioTrackedFrame& trackedFrame);
+
+  /*! Publish the frames that were added since the last call into the shared memory output */
+  void PublishToSharedMemory();
+
+  /*! Add one tracked frame to the shared memory output. The shared memory is (re)created if the frame does not fit in the current one. */
+  PlusStatus AddFrameToSharedMemory(igsioTrackedFrame& trackedFrame, double unfilteredTimestamp);
+
+  /*!
+    Identifies an assembled tracked frame. Field data sources are sampled at the closest time, so the frame also depends on
+    the sources of the channel and on the latest item of each field data source (a newer item may be closer to the timestamp).
+  */
+  struct TrackedFrameCacheKey
+  {
+    double Timestamp;
+    bool EnableImageData;
+    unsigned long SourcesGeneration;
+    std::vector<BufferItemUidType> FieldDataSourceLatestUids;
+
+    bool operator==(const TrackedFrameCacheKey& other) const
+    {
+      return this->Timestamp == other.Timestamp && this->EnableImageData == other.EnableImageData
+             && this->SourcesGeneration == other.SourcesGeneration && this->FieldDataSourceLatestUids == other.FieldDataSourceLatestUids;
+    }
+  };
+
+  struct TrackedFrameCacheEntry
+  {
+    TrackedFrameCacheKey Key;
+    igsioTrackedFrame TrackedFrame;
+  };
+
+  /*! Get the cache key of the tracked frame at the timestamp in the current state of the sources */
+  TrackedFrameCacheKey GetTrackedFrameCacheKey(double timestamp, bool enableImageData);
+
 protected:
   DataSourceContainer       FieldDataSources;
   DataSourceContainer       Tools;
@@ -190,6 +409,12 @@ protected:
   /*! If true then RF processing parameters will be saved into the config file */
   bool SaveRfProcessingParameters;
 
+  /*! Protects Consumers */
+  std::mutex ConsumersMutex;
+  std::set<const void*> Consumers;
+  /*! Size of Consumers, for checking it without locking */
+  std::atomic<int> NumberOfConsumers;
+
   /*!
     This tool will be used to provide timestamps if no video data is present
     All the other tools will use the same timestamps and the transforms will be
@@ -199,6 +424,32 @@ protected:
 
   CustomAttributeMap CustomAttributes;
 
+  /*! See GetSourcesGeneration */
+  std::atomic<unsigned long> SourcesGeneration;
+  /*! Source containers replaced by the last SwitchSources call */
+  DataSourceContainer RetiredTools;
+  DataSourceContainer RetiredFieldDataSources;
+
+  /*! Assembled tracked frames, the most recently used is the first */
+  std::list<TrackedFrameCacheEntry> TrackedFrameCache;
+  int TrackedFrameCacheSize;
+  /*! Incremented when the cache is cleared, to prevent adding frames that were assembled before clearing */
+  unsigned long TrackedFrameCacheGeneration;
+  unsigned long TrackedFrameCacheHits;
+  unsigned long TrackedFrameCacheMisses;
+  vtkIGSIORecursiveCriticalSection* TrackedFrameCacheMutex;
+
+  FrameProcessingStatistics ProcessingStatistics;
+  vtkIGSIORecursiveCriticalSection* ProcessingStatisticsMutex;
+
+  std::string SharedMemoryOutputName;
+  int SharedMemoryOutputNumberOfItems;
+  SharedMemoryRing* SharedMemoryOutput;
+  /*! Data source that triggers publishing (video source or timestamp master tool), NULL if publishing is not active */
+  vtkPlusDataSource* SharedMemoryOutputSource;
+  /*! UID of the last published item in the buffer of SharedMemoryOutputSource */
+  BufferItemUidType SharedMemoryOutputLastUid;
+
   vtkPlusChannel(void);
   virtual ~vtkPlusChannel(void);
 
@@ -6,6 +6,7 @@ See License.txt for details.
 
 // Local includes
 #include "PlusConfigure.h"
+#include "PlusAcquisitionScheduler.h"
 #include "vtkPlusBuffer.h"
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataCollector.h"
@@ -25,7 +26,13 @@ See License.txt for details.
 #endif
 
 // STD includes
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <iomanip>
+#include <map>
 #include <set>
+#include <sstream>
 
 // VTK includes
 #include <vtkObjectFactory.h>
@@ -36,6 +43,16 @@ See License.txt for details.
 
 vtkStandardNewMacro(vtkPlusDataCollector);
 
+namespace
+{
+  const double DEFAULT_BUFFER_DUMP_MAX_BANDWIDTH_MBPS = 50.0;
+  /*! Video buffers are not shrunk below this duration of frames (or MINIMUM_SHRUNK_BUFFER_SIZE items, whichever is more) */
+  const double MINIMUM_SHRUNK_BUFFER_DURATION_SEC = 2.0;
+  const int MINIMUM_SHRUNK_BUFFER_SIZE = 10;
+  /*! Room in the device list for devices that are added at runtime (see AddDevice) */
+  const size_t NUMBER_OF_RESERVED_RUNTIME_DEVICES = 32;
+}
+
 //----------------------------------------------------------------------------
 vtkPlusDataCollector::vtkPlusDataCollector()
   : vtkObject()
@@ -43,6 +60,13 @@ vtkPlusDataCollector::vtkPlusDataCollector()
   , DeviceFactory(vtkSmartPointer<vtkPlusDeviceFactory>::New())
   , Connected(false)
   , Started(false)
+  , ConcurrentDeviceStartup(false)
+  , BufferDumpMaxBandwidthMBps(DEFAULT_BUFFER_DUMP_MAX_BANDWIDTH_MBPS)
+  , BufferDumpCancelRequested(false)
+  , MetricsCollectorId(0)
+  , MemorySoftLimitMB(0.0)
+  , MemoryReporterId(0)
+  , OverloadManagementEnabled(false)
 {
   vtkStreamingVolumeCodecFactory* factory = vtkStreamingVolumeCodecFactory::GetInstance();
 #if defined PLUS_USE_VP9
@@ -55,6 +79,8 @@ vtkPlusDataCollector::vtkPlusDataCollector()
 vtkPlusDataCollector::~vtkPlusDataCollector()
 {
   LOG_TRACE("vtkPlusDataCollector::~vtkPlusDataCollector()");
+  // The buffer dump reads the buffers of the devices
+  this->CancelBufferDump();
   if (this->Started)
   {
     this->Stop();
@@ -105,6 +131,18 @@ PlusStatus vtkPlusDataCollector::ReadConfiguration(vtkXMLDataElement* aConfig)
     LOG_DEBUG("StartupDelaySec: " << std::fixed << startupDelaySec);
   }
 
+  XML_READ_BOOL_ATTRIBUTE_NONMEMBER_OPTIONAL(ConcurrentDeviceStartup, this->ConcurrentDeviceStartup, dataCollectionElement);
+  XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(double, BufferDumpMaxBandwidthMBps, this->BufferDumpMaxBandwidthMBps, dataCollectionElement);
+  XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(double, MemorySoftLimitMB, this->MemorySoftLimitMB, dataCollectionElement);
+
+  vtkXMLDataElement* overloadManagerElement = dataCollectionElement->FindNestedElementWithName("OverloadManager");
+  this->OverloadManagementEnabled = (overloadManagerElement != NULL);
+  if (overloadManagerElement != NULL && OverloadManager::GetInstance().ReadConfiguration(overloadManagerElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to read overload manager configuration");
+    return PLUS_FAIL;
+  }
+
   std::set<std::string> existingDeviceIds;
 
   for (int i = 0; i < dataCollectionElement->GetNumberOfNestedElements(); ++i)
@@ -150,6 +188,8 @@ PlusStatus vtkPlusDataCollector::ReadConfiguration(vtkXMLDataElement* aConfig)
     LOG_ERROR("No devices created. Please verify configuration file and any error produced.");
     return PLUS_FAIL;
   }
+  // Devices added at runtime must not reallocate the list while other threads iterate it
+  this->Devices.reserve(this->Devices.size() + NUMBER_OF_RESERVED_RUNTIME_DEVICES);
 
   // Check output channels (at least one should exist and each id must be unique)
   std::set<std::string> existingOutputChannelNames;
@@ -281,6 +321,26 @@ PlusStatus vtkPlusDataCollector::WriteConfiguration(vtkXMLDataElement* aConfig)
   }
 
   dataCollectionConfig->SetDoubleAttribute("StartupDelaySec", GetStartupDelaySec());
+  if (this->ConcurrentDeviceStartup)
+  {
+    dataCollectionConfig->SetAttribute("ConcurrentDeviceStartup", "TRUE");
+  }
+  if (this->BufferDumpMaxBandwidthMBps != DEFAULT_BUFFER_DUMP_MAX_BANDWIDTH_MBPS)
+  {
+    dataCollectionConfig->SetDoubleAttribute("BufferDumpMaxBandwidthMBps", this->BufferDumpMaxBandwidthMBps);
+  }
+  if (this->MemorySoftLimitMB > 0)
+  {
+    dataCollectionConfig->SetDoubleAttribute("MemorySoftLimitMB", this->MemorySoftLimitMB);
+  }
+  if (this->OverloadManagementEnabled)
+  {
+    vtkXMLDataElement* overloadManagerElement = igsioXmlUtils::GetNestedElementWithName(dataCollectionConfig, "OverloadManager");
+    if (overloadManagerElement == NULL || OverloadManager::GetInstance().WriteConfiguration(overloadManagerElement) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to write overload manager configuration");
+    }
+  }
 
   PlusStatus status = PLUS_SUCCESS;
 
@@ -322,17 +382,17 @@ PlusStatus vtkPlusDataCollector::Start()
 
   const double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
 
-  for (DeviceCollectionIterator it = Devices.begin(); it != Devices.end(); ++ it)
+  status = this->RunDeviceOperation("Start", [startTime](vtkPlusDevice * device)
   {
-    vtkPlusDevice* device = *it;
-
+    PlusStatus deviceStatus = PLUS_SUCCESS;
     if (device->StartRecording() != PLUS_SUCCESS)
     {
       LOG_ERROR("Failed to start data acquisition for device " << device->GetDeviceId() << ".");
-      status = PLUS_FAIL;
+      deviceStatus = PLUS_FAIL;
     }
     device->SetStartTime(startTime);
-  }
+    return deviceStatus;
+  });
 
   LOG_DEBUG("vtkPlusDataCollector::Start -- wait " << std::fixed << this->StartupDelaySec << " sec for buffer init...");
 
@@ -358,18 +418,15 @@ PlusStatus vtkPlusDataCollector::Connect()
 {
   LOG_TRACE("vtkPlusDataCollector::Connect()");
 
-  PlusStatus status = PLUS_SUCCESS;
-
-  for (DeviceCollectionIterator it = Devices.begin(); it != Devices.end(); ++ it)
+  PlusStatus status = this->RunDeviceOperation("Connect", [](vtkPlusDevice * device)
   {
-    vtkPlusDevice* device = *it;
-
     if (device->Connect() != PLUS_SUCCESS)
     {
       LOG_ERROR("Unable to connect device: " << device->GetDeviceId() << ".");
-      status = PLUS_FAIL;
+      return PLUS_FAIL;
     }
-  }
+    return PLUS_SUCCESS;
+  });
 
   if (status != PLUS_SUCCESS)
   {
@@ -384,6 +441,169 @@ PlusStatus vtkPlusDataCollector::Connect()
   }
 
   this->Connected = (status == PLUS_SUCCESS);
+  if (this->Connected && this->MetricsCollectorId == 0)
+  {
+    this->MetricsCollectorId = MetricsRegistry::GetInstance().AddCollector([this](std::vector<MetricsRegistry::Sample>& samples)
+    {
+      this->CollectMetrics(samples);
+    });
+  }
+  if (this->Connected && this->MemoryReporterId == 0)
+  {
+    this->MemoryReporterId = MemoryAccounting::GetInstance().AddReporter([this](std::vector<MemoryAccounting::Usage>& usages)
+    {
+      this->GetMemoryUsage(usages);
+    }, [this](size_t bytesToRelease)
+    {
+      this->ShrinkVideoBuffers(bytesToRelease);
+    });
+    if (this->MemorySoftLimitMB > 0)
+    {
+      MemoryAccounting::GetInstance().SetSoftLimitBytes(static_cast<size_t>(this->MemorySoftLimitMB * 1024.0 * 1024.0));
+    }
+  }
+  if (this->Connected && this->OverloadManagementEnabled)
+  {
+    OverloadManager::GetInstance().Start();
+  }
+  return status;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusDataCollector::GetInputDevices(vtkPlusDevice* device, DeviceCollection& inputDevices) const
+{
+  inputDevices.clear();
+  for (ChannelContainerConstIterator it = device->GetInputChannelsStart(); it != device->GetInputChannelsEnd(); ++it)
+  {
+    vtkPlusDevice* inputDevice = (*it)->GetOwnerDevice();
+    if (inputDevice == NULL || inputDevice == device
+        || std::find(this->Devices.begin(), this->Devices.end(), inputDevice) == this->Devices.end()
+        || std::find(inputDevices.begin(), inputDevices.end(), inputDevice) != inputDevices.end())
+    {
+      continue;
+    }
+    inputDevices.push_back(inputDevice);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusDataCollector::GetDevicesInDependencyOrder(DeviceCollection& orderedDevices) const
+{
+  // Depth-first traversal, the devices that do not depend on each other keep their order in the configuration
+  enum VisitState { NOT_VISITED, VISITING, VISITED };
+  std::map<vtkPlusDevice*, VisitState> visitStates;
+  bool cycleFound(false);
+  std::function<void(vtkPlusDevice*)> visit = [&](vtkPlusDevice * device)
+  {
+    VisitState& state = visitStates[device];
+    if (state == VISITED)
+    {
+      return;
+    }
+    if (state == VISITING)
+    {
+      cycleFound = true;
+      return;
+    }
+    state = VISITING;
+    DeviceCollection inputDevices;
+    this->GetInputDevices(device, inputDevices);
+    for (DeviceCollectionIterator it = inputDevices.begin(); it != inputDevices.end(); ++it)
+    {
+      visit(*it);
+    }
+    visitStates[device] = VISITED;
+    orderedDevices.push_back(device);
+  };
+
+  orderedDevices.clear();
+  for (DeviceCollectionConstIterator it = this->Devices.begin(); it != this->Devices.end(); ++it)
+  {
+    visit(*it);
+  }
+
+  if (cycleFound)
+  {
+    LOG_WARNING("Devices depend on each other through their input channels in a cycle. Devices in the cycle are processed in the order of the configuration.");
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusDataCollector::RunDeviceOperation(const std::string& operationName, const DeviceOperation& operation)
+{
+  DeviceCollection orderedDevices;
+  this->GetDevicesInDependencyOrder(orderedDevices);
+
+  // Each element is only written by the thread that processes the device
+  std::map<vtkPlusDevice*, double> operationTimesSec;
+  std::map<vtkPlusDevice*, PlusStatus> operationResults;
+  for (DeviceCollectionIterator it = orderedDevices.begin(); it != orderedDevices.end(); ++it)
+  {
+    operationTimesSec[*it] = 0.0;
+    operationResults[*it] = PLUS_FAIL;
+  }
+
+  const double operationStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  if (!this->ConcurrentDeviceStartup || orderedDevices.size() < 2)
+  {
+    for (DeviceCollectionIterator it = orderedDevices.begin(); it != orderedDevices.end(); ++it)
+    {
+      const double deviceStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+      operationResults[*it] = operation(*it);
+      operationTimesSec[*it] = vtkIGSIOAccurateTimer::GetSystemTime() - deviceStartTime;
+    }
+  }
+  else
+  {
+    // Devices are processed in dependency order, so the futures of the input devices already exist when a device is launched
+    std::map<vtkPlusDevice*, std::shared_future<void> > completions;
+    for (DeviceCollectionIterator it = orderedDevices.begin(); it != orderedDevices.end(); ++it)
+    {
+      vtkPlusDevice* device = *it;
+      std::vector<std::shared_future<void> > inputCompletions;
+      DeviceCollection inputDevices;
+      this->GetInputDevices(device, inputDevices);
+      for (DeviceCollectionIterator inputIt = inputDevices.begin(); inputIt != inputDevices.end(); ++inputIt)
+      {
+        std::map<vtkPlusDevice*, std::shared_future<void> >::iterator completionIt = completions.find(*inputIt);
+        if (completionIt != completions.end())
+        {
+          inputCompletions.push_back(completionIt->second);
+        }
+      }
+      double& operationTimeSec = operationTimesSec[device];
+      PlusStatus& operationResult = operationResults[device];
+      completions[device] = std::async(std::launch::async, [device, inputCompletions, &operation, &operationTimeSec, &operationResult]()
+      {
+        for (std::vector<std::shared_future<void> >::const_iterator inputIt = inputCompletions.begin(); inputIt != inputCompletions.end(); ++inputIt)
+        {
+          inputIt->wait();
+        }
+        const double deviceStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+        operationResult = operation(device);
+        operationTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - deviceStartTime;
+      }).share();
+    }
+    for (std::map<vtkPlusDevice*, std::shared_future<void> >::iterator it = completions.begin(); it != completions.end(); ++it)
+    {
+      it->second.wait();
+    }
+  }
+
+  PlusStatus status = PLUS_SUCCESS;
+  std::ostringstream timingReport;
+  timingReport << std::fixed << std::setprecision(3);
+  for (DeviceCollectionIterator it = orderedDevices.begin(); it != orderedDevices.end(); ++it)
+  {
+    if (operationResults[*it] != PLUS_SUCCESS)
+    {
+      status = PLUS_FAIL;
+    }
+    timingReport << (it == orderedDevices.begin() ? "" : ", ") << (*it)->GetDeviceId() << ": " << operationTimesSec[*it] << " sec";
+  }
+  LOG_INFO(operationName << " of " << orderedDevices.size() << " devices" << (this->ConcurrentDeviceStartup ? " (concurrent)" : "") << " completed in " << std::fixed << std::setprecision(3)
+           << vtkIGSIOAccurateTimer::GetSystemTime() - operationStartTime << " sec (" << timingReport.str() << ")");
+
   return status;
 }
 
@@ -392,6 +612,28 @@ PlusStatus vtkPlusDataCollector::Disconnect()
 {
   LOG_TRACE("vtkPlusDataCollector::Disconnect()");
 
+  // The applied policies are reverted while the devices are still connected
+  if (this->OverloadManagementEnabled)
+  {
+    OverloadManager::GetInstance().Stop();
+  }
+
+  if (this->MetricsCollectorId != 0)
+  {
+    MetricsRegistry::GetInstance().RemoveCollector(this->MetricsCollectorId);
+    this->MetricsCollectorId = 0;
+  }
+
+  if (this->MemoryReporterId != 0)
+  {
+    if (this->MemorySoftLimitMB > 0)
+    {
+      MemoryAccounting::GetInstance().SetSoftLimitBytes(0);
+    }
+    MemoryAccounting::GetInstance().RemoveReporter(this->MemoryReporterId);
+    this->MemoryReporterId = 0;
+  }
+
   PlusStatus status = PLUS_SUCCESS;
 
   for (DeviceCollectionIterator it = Devices.begin(); it != Devices.end(); ++ it)
@@ -411,6 +653,119 @@ PlusStatus vtkPlusDataCollector::Disconnect()
   return status;
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusDataCollector::CollectMetrics(std::vector<MetricsRegistry::Sample>& samples) const
+{
+  for (DeviceCollectionConstIterator it = this->Devices.begin(); it != this->Devices.end(); ++it)
+  {
+    vtkPlusDevice* device = *it;
+    MetricsRegistry::Labels deviceLabels;
+    deviceLabels["device"] = device->GetDeviceId();
+
+    samples.push_back(MetricsRegistry::Sample("plus_device_connected", "1 if the device is connected",
+                      MetricsRegistry::METRIC_GAUGE, deviceLabels, device->GetConnected() ? 1.0 : 0.0));
+    samples.push_back(MetricsRegistry::Sample("plus_device_recording", "1 if the device is acquiring data",
+                      MetricsRegistry::METRIC_GAUGE, deviceLabels, device->IsRecording() ? 1.0 : 0.0));
+    samples.push_back(MetricsRegistry::Sample("plus_device_acquisition_rate_hz", "Requested acquisition rate of the device",
+                      MetricsRegistry::METRIC_GAUGE, deviceLabels, device->GetAcquisitionRate()));
+
+    AcquisitionScheduler::TaskStatistics statistics;
+    if (AcquisitionScheduler::GetInstance().GetTaskStatistics(device, statistics) == PLUS_SUCCESS)
+    {
+      samples.push_back(MetricsRegistry::Sample("plus_device_updates_total", "Number of internal updates of the device",
+                        MetricsRegistry::METRIC_COUNTER, deviceLabels, statistics.NumberOfUpdates));
+      samples.push_back(MetricsRegistry::Sample("plus_device_missed_deadlines_total", "Number of internal updates that started later than their deadline",
+                        MetricsRegistry::METRIC_COUNTER, deviceLabels, statistics.NumberOfMissedDeadlines));
+      samples.push_back(MetricsRegistry::Sample("plus_device_update_period_error_seconds", "Median absolute difference between the actual and requested update period",
+                        MetricsRegistry::METRIC_GAUGE, deviceLabels, statistics.PeriodErrorMedianSec));
+    }
+
+    std::vector<vtkPlusDataSource*> sources;
+    for (DataSourceContainerConstIterator sourceIt = device->GetVideoSourceIteratorBegin(); sourceIt != device->GetVideoSourceIteratorEnd(); ++sourceIt)
+    {
+      sources.push_back(sourceIt->second);
+    }
+    for (DataSourceContainerConstIterator sourceIt = device->GetToolIteratorBegin(); sourceIt != device->GetToolIteratorEnd(); ++sourceIt)
+    {
+      sources.push_back(sourceIt->second);
+    }
+    for (DataSourceContainerConstIterator sourceIt = device->GetFieldDataSourcessIteratorBegin(); sourceIt != device->GetFieldDataSourcessIteratorEnd(); ++sourceIt)
+    {
+      sources.push_back(sourceIt->second);
+    }
+
+    for (std::vector<vtkPlusDataSource*>::const_iterator sourceIt = sources.begin(); sourceIt != sources.end(); ++sourceIt)
+    {
+      vtkPlusDataSource* source = *sourceIt;
+      MetricsRegistry::Labels sourceLabels = deviceLabels;
+      sourceLabels["source"] = source->GetSourceId();
+
+      samples.push_back(MetricsRegistry::Sample("plus_data_source_items_added_total", "Number of items added to the buffer of the data source",
+                        MetricsRegistry::METRIC_COUNTER, sourceLabels, static_cast<double>(source->GetNumberOfItemsAdded())));
+      samples.push_back(MetricsRegistry::Sample("plus_data_source_items_rejected_total", "Number of items that could not be added to the buffer of the data source",
+                        MetricsRegistry::METRIC_COUNTER, sourceLabels, static_cast<double>(source->GetNumberOfItemsRejected())));
+      samples.push_back(MetricsRegistry::Sample("plus_data_source_buffer_items", "Number of items in the buffer of the data source",
+                        MetricsRegistry::METRIC_GAUGE, sourceLabels, source->GetNumberOfItems()));
+      samples.push_back(MetricsRegistry::Sample("plus_data_source_buffer_size", "Maximum number of items in the buffer of the data source",
+                        MetricsRegistry::METRIC_GAUGE, sourceLabels, source->GetBufferSize()));
+      samples.push_back(MetricsRegistry::Sample("plus_data_source_frame_rate_hz", "Measured rate of the items in the buffer of the data source",
+                        MetricsRegistry::METRIC_GAUGE, sourceLabels, source->GetFrameRate()));
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusDataCollector::GetMemoryUsage(std::vector<MemoryAccounting::Usage>& usages) const
+{
+  for (DeviceCollectionConstIterator it = this->Devices.begin(); it != this->Devices.end(); ++it)
+  {
+    (*it)->GetMemoryUsage(usages);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusDataCollector::ShrinkVideoBuffers(size_t bytesToRelease)
+{
+  // Video buffers hold most of the memory, start with the largest ones
+  std::vector<std::pair<size_t, vtkPlusDataSource*> > videoSources;
+  std::set<vtkPlusDataSource*> processedSources;
+  for (DeviceCollectionConstIterator it = this->Devices.begin(); it != this->Devices.end(); ++it)
+  {
+    for (DataSourceContainerConstIterator sourceIt = (*it)->GetVideoSourceIteratorBegin(); sourceIt != (*it)->GetVideoSourceIteratorEnd(); ++sourceIt)
+    {
+      if (processedSources.insert(sourceIt->second).second)
+      {
+        videoSources.push_back(std::make_pair(sourceIt->second->GetBufferMemoryUsageBytes(), sourceIt->second));
+      }
+    }
+  }
+  std::sort(videoSources.begin(), videoSources.end(), [](const std::pair<size_t, vtkPlusDataSource*>& a, const std::pair<size_t, vtkPlusDataSource*>& b)
+  {
+    return a.first > b.first;
+  });
+
+  size_t releasedBytes = 0;
+  for (std::vector<std::pair<size_t, vtkPlusDataSource*> >::iterator sourceIt = videoSources.begin(); sourceIt != videoSources.end() && releasedBytes < bytesToRelease; ++sourceIt)
+  {
+    vtkPlusDataSource* source = sourceIt->second;
+    int bufferSize = source->GetBufferSize();
+    int minimumBufferSize = std::max(MINIMUM_SHRUNK_BUFFER_SIZE, static_cast<int>(source->GetFrameRate() * MINIMUM_SHRUNK_BUFFER_DURATION_SEC));
+    if (bufferSize <= minimumBufferSize)
+    {
+      continue;
+    }
+    int newBufferSize = std::max(bufferSize / 2, minimumBufferSize);
+    if (source->SetBufferSize(newBufferSize) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to shrink the buffer of " << source->GetSourceId() << " to " << newBufferSize << " items");
+      continue;
+    }
+    size_t remainingBytes = source->GetBufferMemoryUsageBytes();
+    releasedBytes += (sourceIt->first > remainingBytes ? sourceIt->first - remainingBytes : 0);
+    LOG_WARNING("Memory usage soft limit is exceeded, buffer size of " << source->GetSourceId() << " is reduced from " << bufferSize << " to " << newBufferSize << " items");
+  }
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusDataCollector::PrintSelf(ostream& os, vtkIndent indent)
 {
@@ -476,31 +831,111 @@ PlusStatus vtkPlusDataCollector::DumpBuffersToDirectory(const char* aDirectory)
 {
   LOG_TRACE("vtkPlusDataCollector::DumpBuffersToDirectory(" << aDirectory << ")");
 
+  if (this->IsBufferDumpInProgress())
+  {
+    LOG_ERROR("Unable to dump buffers: the previous buffer dump is still in progress");
+    return PLUS_FAIL;
+  }
+  // Get the result of the previous dump, so that a new one can be started
+  this->WaitForBufferDump();
+
   // Assemble file names
   std::string dateAndTime = vtksys::SystemTools::GetCurrentDateTime("%Y%m%d_%H%M%S");
 
+  // Take a snapshot of the item ranges now, items that are acquired during the dump are not written
+  struct BufferDumpItem
+  {
+    vtkPlusDataSource* Source;
+    BufferItemUidType FirstUid;
+    BufferItemUidType LastUid;
+    std::string FileName;
+  };
+  std::vector<BufferDumpItem> dumpItems;
   for (DeviceCollectionIterator it = this->Devices.begin(); it != this->Devices.end(); ++it)
   {
     vtkPlusDevice* device = *it;
 
-    std::string outputDeviceBufferSequenceFileName = vtkPlusConfig::GetInstance()->GetOutputPath(std::string("BufferDump_") + device->GetDeviceId() + "_" + dateAndTime + ".nrrd");
-
-    LOG_INFO("Write device buffer to " << outputDeviceBufferSequenceFileName);
-    vtkPlusDataSource* aSource(NULL);
+    // Channels of a device usually share the same video source
+    std::vector<vtkPlusDataSource*> videoSources;
     for (ChannelContainerIterator chanIt = device->GetOutputChannelsStart(); chanIt != device->GetOutputChannelsEnd(); ++chanIt)
     {
+      vtkPlusDataSource* aSource(NULL);
       if ((*chanIt)->GetVideoSource(aSource) != PLUS_SUCCESS)
       {
         LOG_ERROR("Unable to retrieve the video source in the device.");
         return PLUS_FAIL;
       }
-      aSource->WriteToSequenceFile(outputDeviceBufferSequenceFileName.c_str(), false);
+      if (std::find(videoSources.begin(), videoSources.end(), aSource) == videoSources.end())
+      {
+        videoSources.push_back(aSource);
+      }
+    }
+
+    for (std::vector<vtkPlusDataSource*>::iterator sourceIt = videoSources.begin(); sourceIt != videoSources.end(); ++sourceIt)
+    {
+      if ((*sourceIt)->GetNumberOfItems() < 1)
+      {
+        LOG_WARNING("Buffer of video source " << (*sourceIt)->GetId() << " of device " << device->GetDeviceId() << " is empty, it is not dumped");
+        continue;
+      }
+      BufferDumpItem dumpItem;
+      dumpItem.Source = *sourceIt;
+      dumpItem.FirstUid = (*sourceIt)->GetOldestItemUidInBuffer();
+      dumpItem.LastUid = (*sourceIt)->GetLatestItemUidInBuffer();
+      std::string fileNameSuffix = (videoSources.size() > 1 ? std::string("_") + (*sourceIt)->GetId() : std::string());
+      dumpItem.FileName = vtkPlusConfig::GetInstance()->GetOutputPath(std::string("BufferDump_") + device->GetDeviceId() + fileNameSuffix + "_" + dateAndTime + ".nrrd");
+      dumpItems.push_back(dumpItem);
     }
   }
 
+  const double maxBandwidthBytesPerSec = this->BufferDumpMaxBandwidthMBps * 1024.0 * 1024.0;
+  this->BufferDumpCancelRequested = false;
+  this->BufferDumpResult = std::async(std::launch::async, [this, dumpItems, maxBandwidthBytesPerSec]()
+  {
+    PlusStatus status = PLUS_SUCCESS;
+    for (std::vector<BufferDumpItem>::const_iterator dumpItemIt = dumpItems.begin(); dumpItemIt != dumpItems.end() && !this->BufferDumpCancelRequested; ++dumpItemIt)
+    {
+      LOG_INFO("Write device buffer to " << dumpItemIt->FileName);
+      if (dumpItemIt->Source->WriteRangeToSequenceFile(dumpItemIt->FileName.c_str(), dumpItemIt->FirstUid, dumpItemIt->LastUid, false,
+          maxBandwidthBytesPerSec, &this->BufferDumpCancelRequested) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to write device buffer to " << dumpItemIt->FileName);
+        status = PLUS_FAIL;
+      }
+    }
+    return status;
+  });
+
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+bool vtkPlusDataCollector::IsBufferDumpInProgress()
+{
+  return this->BufferDumpResult.valid() && this->BufferDumpResult.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusDataCollector::WaitForBufferDump()
+{
+  if (!this->BufferDumpResult.valid())
+  {
+    return PLUS_SUCCESS;
+  }
+  return this->BufferDumpResult.get();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusDataCollector::CancelBufferDump()
+{
+  if (!this->BufferDumpResult.valid())
+  {
+    return;
+  }
+  this->BufferDumpCancelRequested = true;
+  this->WaitForBufferDump();
+}
+
 //----------------------------------------------------------------------------
 DeviceCollectionConstIterator vtkPlusDataCollector::GetDeviceConstIteratorBegin() const
 {
@@ -631,10 +1066,10 @@ PlusStatus vtkPlusDataCollector::GetVideoData(vtkPlusChannel* aRequestedChannel,
     trackedFrame->SetTimestamp(itemTimestamp);
 
     // Copy all custom fields
-    igsioFieldMapType fieldMap = currentStreamBufferItem.GetFrameFieldMap();
-    for (igsioFieldMapType::const_iterator fieldIterator = fieldMap.begin(); fieldIterator != fieldMap.end(); fieldIterator++)
+    const FrameFieldStore& fields = currentStreamBufferItem.GetFrameFields();
+    for (unsigned int fieldIndex = 0; fieldIndex < fields.GetNumberOfFields(); ++fieldIndex)
     {
-      trackedFrame->SetFrameField(fieldIterator->first, fieldIterator->second.second, fieldIterator->second.first);
+      trackedFrame->SetFrameField(fields.GetFieldName(fieldIndex), fields.GetFieldValue(fieldIndex), fields.GetFieldFlags(fieldIndex));
     }
 
     // Add tracked frame to the list
@@ -727,8 +1162,14 @@ PlusStatus vtkPlusDataCollector::AddDevice(vtkPlusDevice* aDevice)
     return PLUS_FAIL;
   }
 
+  if (this->Devices.size() == this->Devices.capacity() && this->Connected)
+  {
+    LOG_WARNING("The device list is reallocated to add device " << aDevice->GetDeviceId() << ", too many devices have been added at runtime.");
+  }
   aDevice->SetDataCollector(this);
   Devices.push_back(aDevice);
+  // cached queries of the device list are invalidated by the modification time
+  this->Modified();
   return PLUS_SUCCESS;
 }
 
@@ -9,12 +9,20 @@ See License.txt for details.
 
 // Local includes
 #include "igsioCommon.h"
+#include "PlusMemoryAccounting.h"
+#include "PlusOverloadManager.h"
+#include "PlusMetricsRegistry.h"
 #include "vtkPlusDataCollectionExport.h"
 #include "vtkPlusDevice.h"
 
 // VTK includes
 #include <vtkObject.h>
 
+// STL includes
+#include <atomic>
+#include <functional>
+#include <future>
+
 //class igsioTrackedFrame; 
 class vtkPlusChannel;
 class vtkPlusDeviceFactory;
@@ -87,6 +95,9 @@ public:
 
   /*!
     Add a device to the device list
+    Devices can be added while the data collection is running: room is reserved in the list when the configuration is read,
+    so iterators of the list that other threads hold remain valid. The device should be connected (and started)
+    before it is added, so that it becomes visible with its buffers already allocated.
     \param aDevice the device to add
   */
   PlusStatus AddDevice(vtkPlusDevice* aDevice);
@@ -113,12 +124,27 @@ public:
   DeviceCollectionConstIterator GetDeviceConstIteratorEnd() const;
 
   /*!
-    Have each device dump their buffers to disk
+    Have each device dump their buffers to disk.
+    The range of items that are currently in the buffers is dumped in a background thread and the method returns immediately.
+    The frames are written directly from the buffers, at most BufferDumpMaxBandwidthMBps, so that the acquisition is not slowed down.
+    Frames that are overwritten in the buffers before they could be written are skipped.
     \param aDirectory directory to dump to
-    \param maxTimeLimitSec Maximum time spent in the function (in sec)
   */
   PlusStatus DumpBuffersToDirectory(const char* aDirectory);
 
+  /*! Returns true if a buffer dump started by DumpBuffersToDirectory is still being written */
+  bool IsBufferDumpInProgress();
+
+  /*! Wait until the buffer dump is completed. Returns the result of the dump (PLUS_SUCCESS if no dump was started). */
+  PlusStatus WaitForBufferDump();
+
+  /*! Stop the buffer dump as soon as possible (the frames written so far are kept) and wait until it is stopped */
+  void CancelBufferDump();
+
+  /*! Maximum write speed of buffer dumps in MB/s. If not positive then the speed is not limited. */
+  vtkSetMacro(BufferDumpMaxBandwidthMBps, double);
+  vtkGetMacro(BufferDumpMaxBandwidthMBps, double);
+
   /*!
     Get tracking data in a tracked frame list since time specified
     \param aTimestamp The oldest timestamp we search for in the buffer. If -1 get all frames in the time range since the most recent timestamp. Out parameter - changed to timestamp of last added frame
@@ -154,7 +180,60 @@ public:
   /*! Get startup delay in sec to give some time to the buffers for proper initialization */
   vtkGetMacro(StartupDelaySec, double);
 
+  /*!
+    If enabled then Connect and Start process devices that do not depend on each other concurrently, each in a separate thread.
+    A device that uses an output channel of another device as input channel (e.g., a virtual device) is processed
+    only when that device is completed. Disabled by default, as some device SDKs expect to be initialized from the main thread.
+  */
+  vtkSetMacro(ConcurrentDeviceStartup, bool);
+  vtkGetMacro(ConcurrentDeviceStartup, bool);
+  vtkBooleanMacro(ConcurrentDeviceStartup, bool);
+
+  /*!
+    Soft limit of the memory used by the buffers, recorded frames, volumes and send queues in MB (see MemoryAccounting).
+    While the limit is exceeded the video buffers are shrunk and frames are dropped. If not positive (default) then there is no limit.
+    The limit is applied when the devices are connected.
+  */
+  vtkSetMacro(MemorySoftLimitMB, double);
+  vtkGetMacro(MemorySoftLimitMB, double);
+
+  /*!
+    If enabled then the OverloadManager monitors the load while the devices are connected and degrades the non-essential
+    processing when the system is overloaded. Enabled by an OverloadManager element in the DataCollection element.
+  */
+  vtkSetMacro(OverloadManagementEnabled, bool);
+  vtkGetMacro(OverloadManagementEnabled, bool);
+
 protected:
+  typedef std::function<PlusStatus(vtkPlusDevice*)> DeviceOperation;
+
+  /*!
+    Run an operation (connect, start) on all devices. Each device is processed after the devices that provide its input channels.
+    The time spent in the operation is logged for each device.
+  */
+  PlusStatus RunDeviceOperation(const std::string& operationName, const DeviceOperation& operation);
+
+  /*! Get the devices in an order where each device comes after the devices that provide its input channels */
+  void GetDevicesInDependencyOrder(DeviceCollection& orderedDevices) const;
+
+  /*! Get the devices of the data collector that provide the input channels of a device */
+  void GetInputDevices(vtkPlusDevice* device, DeviceCollection& inputDevices) const;
+
+  /*!
+    Append the acquisition metrics of the devices and their data sources (acquisition rate, buffer fill level, etc.).
+    Registered as a MetricsRegistry collector while the devices are connected.
+  */
+  void CollectMetrics(std::vector<MetricsRegistry::Sample>& samples) const;
+
+  /*! Append the memory used by the devices. Registered as a MemoryAccounting reporter while the devices are connected. */
+  void GetMemoryUsage(std::vector<MemoryAccounting::Usage>& usages) const;
+
+  /*!
+    Release memory when the memory soft limit is exceeded by halving the size of the largest video buffers,
+    until bytesToRelease is released. Buffers are not shrunk below a few seconds of frames.
+  */
+  void ShrinkVideoBuffers(size_t bytesToRelease);
+
   vtkPlusDataCollector();
   virtual ~vtkPlusDataCollector();
 
@@ -168,6 +247,22 @@ protected:
   bool Connected;
   bool Started;
 
+  bool ConcurrentDeviceStartup;
+
+  double BufferDumpMaxBandwidthMBps;
+  /*! Result of the background buffer dump, not valid if no dump was started */
+  std::future<PlusStatus> BufferDumpResult;
+  std::atomic<bool> BufferDumpCancelRequested;
+
+  /*! Identifier of the metrics collector, 0 if not registered */
+  int MetricsCollectorId;
+
+  double MemorySoftLimitMB;
+  /*! Identifier of the memory accounting reporter, 0 if not registered */
+  int MemoryReporterId;
+
+  bool OverloadManagementEnabled;
+
 private:
   vtkPlusDataCollector(const vtkPlusDataCollector&);
   void operator=(const vtkPlusDataCollector&);
@@ -6,6 +6,8 @@ See License.txt for details.
 
 // Local includes
 #include "PlusConfigure.h"
+#include "PlusDataflowScheduler.h"
+#include "PlusLatencyTracer.h"
 #include "vtkPlusBuffer.h"
 #include "vtkPlusDataSource.h"
 
@@ -33,6 +35,9 @@ vtkPlusDataSource::vtkPlusDataSource()
   , Id("")
   , ReferenceCoordinateFrameName("")
   , Buffer(vtkPlusBuffer::New())
+  , ClipRectangleAppliedByDevice(false)
+  , NumberOfItemsAdded(0)
+  , NumberOfItemsRejected(0)
 {
   this->ClipRectangleOrigin[0] = igsioCommon::NO_CLIP;
   this->ClipRectangleOrigin[1] = igsioCommon::NO_CLIP;
@@ -247,6 +252,46 @@ void vtkPlusDataSource::SetClipRectangleOrigin(const std::array<int, 3> _arg)
   this->ClipRectangleOrigin = _arg;
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusDataSource::SetClipRectangleAppliedByDevice(bool applied)
+{
+  this->ClipRectangleAppliedByDevice = applied;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusDataSource::GetClipRectangleAppliedByDevice() const
+{
+  return this->ClipRectangleAppliedByDevice;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusDataSource::IsSoftwareClippingRequested() const
+{
+  return !this->ClipRectangleAppliedByDevice && igsioCommon::IsClippingRequested(this->ClipRectangleOrigin, this->ClipRectangleSize);
+}
+
+//----------------------------------------------------------------------------
+std::array<int, 3> vtkPlusDataSource::GetSoftwareClipRectangleOrigin() const
+{
+  if (this->ClipRectangleAppliedByDevice)
+  {
+    std::array<int, 3> noClip = { igsioCommon::NO_CLIP, igsioCommon::NO_CLIP, igsioCommon::NO_CLIP };
+    return noClip;
+  }
+  return this->ClipRectangleOrigin;
+}
+
+//----------------------------------------------------------------------------
+std::array<int, 3> vtkPlusDataSource::GetSoftwareClipRectangleSize() const
+{
+  if (this->ClipRectangleAppliedByDevice)
+  {
+    std::array<int, 3> noClip = { igsioCommon::NO_CLIP, igsioCommon::NO_CLIP, igsioCommon::NO_CLIP };
+    return noClip;
+  }
+  return this->ClipRectangleSize;
+}
+
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusDataSource::ReadConfiguration(vtkXMLDataElement* sourceElement, bool requirePortNameInSourceConfiguration, bool requireImageOrientationInSourceConfiguration, const std::string& aDescriptiveNameForBuffer)
 {
@@ -401,6 +446,33 @@ PlusStatus vtkPlusDataSource::ReadConfiguration(vtkXMLDataElement* sourceElement
     LOG_DEBUG("AveragedItemsForFiltering is not defined in source element \"" << this->GetId() << "\". Using default value: " << this->GetBuffer()->GetAveragedItemsForFiltering());
   }
 
+  double timestampOutlierRejectionThreshold = 0;
+  if (sourceElement->GetScalarAttribute("TimestampOutlierRejectionThreshold", timestampOutlierRejectionThreshold))
+  {
+    this->GetBuffer()->SetTimestampOutlierRejectionThreshold(timestampOutlierRejectionThreshold);
+  }
+
+  double frameRateStatisticsWindowSec = this->GetBuffer()->GetFrameRateStatisticsWindowSec();
+  XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(double, FrameRateStatisticsWindowSec, frameRateStatisticsWindowSec, sourceElement);
+  this->GetBuffer()->SetFrameRateStatisticsWindowSec(frameRateStatisticsWindowSec);
+
+  bool lockFreeReads = false;
+  XML_READ_BOOL_ATTRIBUTE_NONMEMBER_OPTIONAL(LockFreeReads, lockFreeReads, sourceElement);
+  this->GetBuffer()->SetLockFreeReads(lockFreeReads);
+
+  vtkPlusBuffer::FrameMemoryAllocationType frameMemoryAllocation = this->GetBuffer()->GetFrameMemoryAllocation();
+  XML_READ_ENUM2_ATTRIBUTE_NONMEMBER_OPTIONAL(FrameMemoryAllocation, frameMemoryAllocation, sourceElement,
+      "DEFAULT", vtkPlusBuffer::FRAME_MEMORY_ALLOCATION_DEFAULT, "CONTIGUOUS_LARGE_PAGES", vtkPlusBuffer::FRAME_MEMORY_ALLOCATION_CONTIGUOUS_LARGE_PAGES);
+  int frameMemoryNumaNode = this->GetBuffer()->GetFrameMemoryNumaNode();
+  XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, FrameMemoryNumaNode, frameMemoryNumaNode, sourceElement);
+  // Set the NUMA node first, so that the frames are allocated only once
+  this->GetBuffer()->SetFrameMemoryNumaNode(frameMemoryNumaNode);
+  if (this->GetBuffer()->SetFrameMemoryAllocation(frameMemoryAllocation) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to set frame memory allocation of source " << this->GetId());
+    return PLUS_FAIL;
+  }
+
   std::string descName;
   if (!aDescriptiveNameForBuffer.empty())
   {
@@ -462,6 +534,32 @@ PlusStatus vtkPlusDataSource::WriteConfiguration(vtkXMLDataElement* aSourceEleme
     aSourceElement->SetIntAttribute("AveragedItemsForFiltering", this->GetBuffer()->GetAveragedItemsForFiltering());
   }
 
+  if (aSourceElement->GetAttribute("TimestampOutlierRejectionThreshold") != NULL)
+  {
+    aSourceElement->SetDoubleAttribute("TimestampOutlierRejectionThreshold", this->GetBuffer()->GetTimestampOutlierRejectionThreshold());
+  }
+
+  if (aSourceElement->GetAttribute("FrameRateStatisticsWindowSec") != NULL)
+  {
+    aSourceElement->SetDoubleAttribute("FrameRateStatisticsWindowSec", this->GetBuffer()->GetFrameRateStatisticsWindowSec());
+  }
+
+  if (aSourceElement->GetAttribute("LockFreeReads") != NULL)
+  {
+    aSourceElement->SetAttribute("LockFreeReads", this->GetBuffer()->GetLockFreeReads() ? "TRUE" : "FALSE");
+  }
+
+  if (aSourceElement->GetAttribute("FrameMemoryAllocation") != NULL)
+  {
+    aSourceElement->SetAttribute("FrameMemoryAllocation",
+                                 this->GetBuffer()->GetFrameMemoryAllocation() == vtkPlusBuffer::FRAME_MEMORY_ALLOCATION_CONTIGUOUS_LARGE_PAGES ? "CONTIGUOUS_LARGE_PAGES" : "DEFAULT");
+  }
+
+  if (aSourceElement->GetAttribute("FrameMemoryNumaNode") != NULL)
+  {
+    aSourceElement->SetIntAttribute("FrameMemoryNumaNode", this->GetBuffer()->GetFrameMemoryNumaNode());
+  }
+
   // Write custom properties
   if (this->CustomProperties.size() > 0)
   {
@@ -548,35 +646,84 @@ void vtkPlusDataSource::SetCustomProperty(const std::string& propertyName, const
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusDataSource::AddItem(vtkImageData* frame, US_IMAGE_ORIENTATION usImageOrientation, US_IMAGE_TYPE imageType, long frameNumber, double unfilteredTimestamp/*=UNDEFINED_TIMESTAMP*/, double filteredTimestamp/*=UNDEFINED_TIMESTAMP*/, const igsioFieldMapType* customFields /*= NULL*/)
 {
-  return this->GetBuffer()->AddItem(frame, usImageOrientation, imageType, frameNumber, this->ClipRectangleOrigin, this->ClipRectangleSize, unfilteredTimestamp, filteredTimestamp, customFields);
+  return this->NotifyItemAdded(this->GetBuffer()->AddItem(frame, usImageOrientation, imageType, frameNumber, this->GetSoftwareClipRectangleOrigin(), this->GetSoftwareClipRectangleSize(), unfilteredTimestamp, filteredTimestamp, customFields));
 }
 
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusDataSource::AddItem(const igsioVideoFrame* frame, long frameNumber, double unfilteredTimestamp/*=UNDEFINED_TIMESTAMP*/, double filteredTimestamp/*=UNDEFINED_TIMESTAMP*/, const igsioFieldMapType* customFields /*= NULL*/)
 {
-  return this->GetBuffer()->AddItem(frame, frameNumber, this->ClipRectangleOrigin, this->ClipRectangleSize, unfilteredTimestamp, filteredTimestamp, customFields);
+  return this->NotifyItemAdded(this->GetBuffer()->AddItem(frame, frameNumber, this->GetSoftwareClipRectangleOrigin(), this->GetSoftwareClipRectangleSize(), unfilteredTimestamp, filteredTimestamp, customFields));
 }
 
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusDataSource::AddItem(const igsioFieldMapType& customFields, long frameNumber, double unfilteredTimestamp/*=UNDEFINED_TIMESTAMP*/,
                                       double filteredTimestamp/*=UNDEFINED_TIMESTAMP*/)
 {
-  return this->GetBuffer()->AddItem(customFields, frameNumber, unfilteredTimestamp, filteredTimestamp);
+  return this->NotifyItemAdded(this->GetBuffer()->AddItem(customFields, frameNumber, unfilteredTimestamp, filteredTimestamp));
 }
 
 //----------------------------------------------------------------------------
-PlusStatus vtkPlusDataSource::AddItem(void* imageDataPtr, US_IMAGE_ORIENTATION usImageOrientation, const FrameSizeType& frameSizeInPx, igsioCommon::VTKScalarPixelType pixelType,
+PlusStatus vtkPlusDataSource::AddItem(const void* imageDataPtr, US_IMAGE_ORIENTATION usImageOrientation, const FrameSizeType& frameSizeInPx, igsioCommon::VTKScalarPixelType pixelType,
                                       unsigned int numberOfScalarComponents, US_IMAGE_TYPE imageType, int numberOfBytesToSkip, long frameNumber, double unfilteredTimestamp /*= UNDEFINED_TIMESTAMP*/,
                                       double filteredTimestamp /*= UNDEFINED_TIMESTAMP*/, const igsioFieldMapType* customFields /*= NULL*/)
 {
-  return this->GetBuffer()->AddItem(imageDataPtr, usImageOrientation, frameSizeInPx, pixelType, numberOfScalarComponents, imageType, numberOfBytesToSkip, frameNumber,
-                                    this->ClipRectangleOrigin, this->ClipRectangleSize, unfilteredTimestamp, filteredTimestamp, customFields);
+  return this->NotifyItemAdded(this->GetBuffer()->AddItem(imageDataPtr, usImageOrientation, frameSizeInPx, pixelType, numberOfScalarComponents, imageType, numberOfBytesToSkip, frameNumber,
+                               this->GetSoftwareClipRectangleOrigin(), this->GetSoftwareClipRectangleSize(), unfilteredTimestamp, filteredTimestamp, customFields));
 }
 
 //----------------------------------------------------------------------------
-PlusStatus vtkPlusDataSource::AddItem(void* imageDataPtr, const FrameSizeType& frameSize, unsigned int frameSizeInBytes, US_IMAGE_TYPE imageType, long frameNumber, double unfilteredTimestamp /*= UNDEFINED_TIMESTAMP*/, double filteredTimestamp /*= UNDEFINED_TIMESTAMP*/, const igsioFieldMapType* customFields /*= NULL*/)
+PlusStatus vtkPlusDataSource::AddItem(const void* imageDataPtr, const FrameSizeType& frameSize, unsigned int frameSizeInBytes, US_IMAGE_TYPE imageType, long frameNumber, double unfilteredTimestamp /*= UNDEFINED_TIMESTAMP*/, double filteredTimestamp /*= UNDEFINED_TIMESTAMP*/, const igsioFieldMapType* customFields /*= NULL*/)
 {
-  return this->GetBuffer()->AddItem(imageDataPtr, frameSize, frameSizeInBytes, imageType, frameNumber, unfilteredTimestamp, filteredTimestamp, customFields);
+  return this->NotifyItemAdded(this->GetBuffer()->AddItem(imageDataPtr, frameSize, frameSizeInBytes, imageType, frameNumber, unfilteredTimestamp, filteredTimestamp, customFields));
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusDataSource::ReserveNewItem(void*& imageDataPtr, unsigned int& frameSizeInBytes)
+{
+  if (this->IsSoftwareClippingRequested())
+  {
+    LOG_ERROR("Unable to reserve frame in source " << this->GetId() << " - images have to be clipped, use AddItem instead");
+    return PLUS_FAIL;
+  }
+  if (this->InputImageOrientation != this->GetBuffer()->GetImageOrientation())
+  {
+    LOG_ERROR("Unable to reserve frame in source " << this->GetId() << " - images have to be reoriented from " << igsioCommon::GetStringFromUsImageOrientation(this->InputImageOrientation)
+              << " to " << igsioCommon::GetStringFromUsImageOrientation(this->GetBuffer()->GetImageOrientation()) << ", use AddItem instead");
+    return PLUS_FAIL;
+  }
+  return this->GetBuffer()->ReserveNewItem(imageDataPtr, frameSizeInBytes);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusDataSource::CommitReservedItem(long frameNumber, double unfilteredTimestamp /*= UNDEFINED_TIMESTAMP*/, double filteredTimestamp /*= UNDEFINED_TIMESTAMP*/, const igsioFieldMapType* customFields /*= NULL*/)
+{
+  return this->NotifyItemAdded(this->GetBuffer()->CommitReservedItem(frameNumber, unfilteredTimestamp, filteredTimestamp, customFields));
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusDataSource::CancelReservedItem()
+{
+  this->GetBuffer()->CancelReservedItem();
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusDataSource::CanAddItemBySwappingPixels()
+{
+  return !this->IsSoftwareClippingRequested()
+         && this->InputImageOrientation == this->GetBuffer()->GetImageOrientation()
+         && this->GetBuffer()->CanAddItemBySwappingPixels();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusDataSource::AddItemBySwappingPixels(vtkSmartPointer<vtkDataArray>& pixels, long frameNumber, double unfilteredTimestamp /*= UNDEFINED_TIMESTAMP*/,
+    double filteredTimestamp /*= UNDEFINED_TIMESTAMP*/, const igsioFieldMapType* customFields /*= NULL*/)
+{
+  if (!this->CanAddItemBySwappingPixels())
+  {
+    LOG_ERROR("Unable to add frame by swapping pixels in source " << this->GetId() << " - images have to be clipped or reoriented, or the buffer uses contiguous frame memory, use AddItem instead");
+    return PLUS_FAIL;
+  }
+  return this->NotifyItemAdded(this->GetBuffer()->AddItemBySwappingPixels(pixels, frameNumber, unfilteredTimestamp, filteredTimestamp, customFields));
 }
 
 //-----------------------------------------------------------------------------
@@ -609,7 +756,7 @@ PlusStatus vtkPlusDataSource::SetInputFrameSize(unsigned int x, unsigned int y,
   }
 
   int extents[6] = {0, static_cast<int>(x) - 1, 0, static_cast<int>(y) - 1, 0, static_cast<int>(z) - 1};
-  if (igsioCommon::IsClippingRequested(this->ClipRectangleOrigin, this->ClipRectangleSize))
+  if (this->IsSoftwareClippingRequested())
   {
     if (igsioCommon::IsClippingWithinExtents(this->ClipRectangleOrigin, this->ClipRectangleSize, extents))
     {
@@ -808,9 +955,9 @@ bool vtkPlusDataSource::GetLatestItemHasValidFieldData()
 }
 
 //-----------------------------------------------------------------------------
-ItemStatus vtkPlusDataSource::GetStreamBufferItem(BufferItemUidType uid, StreamBufferItem* bufferItem)
+ItemStatus vtkPlusDataSource::GetStreamBufferItem(BufferItemUidType uid, StreamBufferItem* bufferItem, bool shareImageData/*=false*/)
 {
-  return this->GetBuffer()->GetStreamBufferItem(uid, bufferItem);
+  return this->GetBuffer()->GetStreamBufferItem(uid, bufferItem, shareImageData);
 }
 
 //-----------------------------------------------------------------------------
@@ -831,6 +978,12 @@ ItemStatus vtkPlusDataSource::GetStreamBufferItemFromTime(double time, StreamBuf
   return this->GetBuffer()->GetStreamBufferItemFromTime(time, bufferItem, interpolation);
 }
 
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusDataSource::PrepareTransformInterpolation(double time, TransformInterpolationBatch& batch, vtkPlusBuffer::TransformSample& sample)
+{
+  return this->GetBuffer()->PrepareTransformInterpolation(time, batch, sample);
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusDataSource::ModifyBufferItemFrameField(BufferItemUidType uid, const std::string& key, const std::string& value)
 {
@@ -855,6 +1008,12 @@ int vtkPlusDataSource::GetBufferSize()
   return this->GetBuffer()->GetBufferSize();
 }
 
+//-----------------------------------------------------------------------------
+size_t vtkPlusDataSource::GetBufferMemoryUsageBytes()
+{
+  return this->GetBuffer()->GetMemoryUsageBytes();
+}
+
 //-----------------------------------------------------------------------------
 ItemStatus vtkPlusDataSource::GetLatestTimeStamp(double& latestTimestamp)
 {
@@ -867,6 +1026,12 @@ ItemStatus vtkPlusDataSource::GetOldestTimeStamp(double& oldestTimestamp)
   return this->GetBuffer()->GetOldestTimeStamp(oldestTimestamp);
 }
 
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusDataSource::WaitForItemNewerThan(double timestamp, double timeoutSec)
+{
+  return this->GetBuffer()->WaitForItemNewerThan(timestamp, timeoutSec);
+}
+
 //-----------------------------------------------------------------------------
 ItemStatus vtkPlusDataSource::GetTimeStamp(BufferItemUidType uid, double& timestamp)
 {
@@ -903,12 +1068,25 @@ bool vtkPlusDataSource::GetTimeStampReporting()
   return this->GetBuffer()->GetTimeStampReporting();
 }
 
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusDataSource::SetTimeStampReportFileName(const std::string& fileName)
+{
+  return this->GetBuffer()->SetTimeStampReportFileName(fileName);
+}
+
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusDataSource::WriteToSequenceFile(const char* filename, bool useCompression /*= false */)
 {
   return this->GetBuffer()->WriteToSequenceFile(filename, useCompression);
 }
 
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusDataSource::WriteRangeToSequenceFile(const char* filename, BufferItemUidType firstUid, BufferItemUidType lastUid, bool useCompression /*= false*/,
+    double maxBandwidthBytesPerSec /*= 0*/, const std::atomic<bool>* cancelRequested /*= NULL*/)
+{
+  return this->GetBuffer()->WriteRangeToSequenceFile(filename, firstUid, lastUid, useCompression, maxBandwidthBytesPerSec, cancelRequested);
+}
+
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusDataSource::DeepCopyBufferTo(vtkPlusBuffer& bufferToFill)
 {
@@ -920,7 +1098,26 @@ PlusStatus vtkPlusDataSource::DeepCopyBufferTo(vtkPlusBuffer& bufferToFill)
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusDataSource::AddTimeStampedItem(vtkMatrix4x4* matrix, ToolStatus status, unsigned long frameNumber, double unfilteredTimestamp, double filteredTimestamp/*=UNDEFINED_TIMESTAMP*/, const igsioFieldMapType* customFields /*= NULL*/)
 {
-  return this->GetBuffer()->AddTimeStampedItem(matrix, status, frameNumber, unfilteredTimestamp, filteredTimestamp, customFields);
+  return this->NotifyItemAdded(this->GetBuffer()->AddTimeStampedItem(matrix, status, frameNumber, unfilteredTimestamp, filteredTimestamp, customFields));
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusDataSource::NotifyItemAdded(PlusStatus addStatus)
+{
+  if (addStatus == PLUS_SUCCESS)
+  {
+    this->NumberOfItemsAdded.fetch_add(1, std::memory_order_relaxed);
+    if (LatencyTracer::IsEnabled())
+    {
+      LatencyTracer::GetInstance().RecordItemAdded(this, this->GetLatestItemUidInBuffer());
+    }
+    DataflowScheduler::GetInstance().NotifyNewData(this);
+  }
+  else
+  {
+    this->NumberOfItemsRejected.fetch_add(1, std::memory_order_relaxed);
+  }
+  return addStatus;
 }
 
 //-----------------------------------------------------------------------------
@@ -22,6 +22,9 @@
 // VTK includes
 #include <vtkObject.h>
 
+// STL includes
+#include <atomic>
+
 /*!
 \class vtkPlusDataSource
 \brief Interface to a 3D positioning tool, video source, or generalized data stream
@@ -132,14 +135,16 @@ public:
   /*! Returns true if the latest item contains valid field data */
   virtual bool GetLatestItemHasValidFieldData();
 
-  /*! Get a frame with the specified frame uid from the buffer */
-  virtual ItemStatus GetStreamBufferItem(BufferItemUidType uid, StreamBufferItem* bufferItem);
+  /*! Get a frame with the specified frame uid from the buffer. See vtkPlusBuffer::GetStreamBufferItem. */
+  virtual ItemStatus GetStreamBufferItem(BufferItemUidType uid, StreamBufferItem* bufferItem, bool shareImageData = false);
   /*! Get the most recent frame from the buffer */
   virtual ItemStatus GetLatestStreamBufferItem(StreamBufferItem* bufferItem);
   /*! Get the oldest frame from buffer */
   virtual ItemStatus GetOldestStreamBufferItem(StreamBufferItem* bufferItem);
   /*! Get a frame that was acquired at the specified time from buffer */
   virtual ItemStatus GetStreamBufferItemFromTime(double time, StreamBufferItem* bufferItem, vtkPlusBuffer::DataItemTemporalInterpolationType interpolation);
+  /*! Get the transform at the specified time for batch interpolation, see vtkPlusBuffer::PrepareTransformInterpolation */
+  virtual ItemStatus PrepareTransformInterpolation(double time, TransformInterpolationBatch& batch, vtkPlusBuffer::TransformSample& sample);
   /*! Update a field in the specified stream buffer item */
   virtual PlusStatus ModifyBufferItemFrameField(BufferItemUidType uid, const std::string& key, const std::string& value);
 
@@ -152,6 +157,10 @@ public:
   /*! Dump the current state of the video buffer to metafile */
   virtual PlusStatus WriteToSequenceFile(const char* filename, bool useCompression = false);
 
+  /*! Write a range of items of the buffer to a sequence file without copying the buffer, see vtkPlusBuffer::WriteRangeToSequenceFile */
+  virtual PlusStatus WriteRangeToSequenceFile(const char* filename, BufferItemUidType firstUid, BufferItemUidType lastUid, bool useCompression = false,
+      double maxBandwidthBytesPerSec = 0, const std::atomic<bool>* cancelRequested = NULL);
+
   /*! Get the table report of the timestamped buffer  */
   virtual PlusStatus GetTimeStampReportTable(vtkTable* timeStampReportTable);
 
@@ -159,6 +168,8 @@ public:
   void SetTimeStampReporting(bool enable);
   /*! If TimeStampReporting is enabled then all filtered and unfiltered timestamp values will be saved in a table for diagnostic purposes. */
   bool GetTimeStampReporting();
+  /*! Binary file that the timestamp report records are written to, see vtkPlusTimestampedCircularBuffer::SetTimeStampReportFileName */
+  PlusStatus SetTimeStampReportFileName(const std::string& fileName);
 
   /*!
     Set the size of the buffer, i.e. the maximum number of
@@ -168,12 +179,23 @@ public:
   /*! Get the size of the buffer */
   virtual int GetBufferSize();
 
+  /*! Get the memory used by the buffer of the data source, in bytes */
+  virtual size_t GetBufferMemoryUsageBytes();
+
+  /*! Number of items that were added to the buffer since the data source was created */
+  unsigned long long GetNumberOfItemsAdded() const { return this->NumberOfItemsAdded.load(std::memory_order_relaxed); }
+  /*! Number of items that could not be added to the buffer (e.g., because of invalid timestamp or frame format) */
+  unsigned long long GetNumberOfItemsRejected() const { return this->NumberOfItemsRejected.load(std::memory_order_relaxed); }
+
   /*! Get latest timestamp in the buffer */
   virtual ItemStatus GetLatestTimeStamp(double& latestTimestamp);
 
   /*! Get oldest timestamp in the buffer */
   virtual ItemStatus GetOldestTimeStamp(double& oldestTimestamp);
 
+  /*! Wait until an item newer than the specified timestamp is added to the buffer. See vtkPlusBuffer::WaitForItemNewerThan. */
+  virtual PlusStatus WaitForItemNewerThan(double timestamp, double timeoutSec);
+
   /*! Get video buffer item timestamp */
   virtual ItemStatus GetTimeStamp(BufferItemUidType uid, double& timestamp);
 
@@ -216,7 +238,7 @@ public:
     or if the frame's format doesn't match the buffer's frame format,
     then the frame is not added to the buffer.
   */
-  virtual PlusStatus AddItem(void* imageDataPtr,
+  virtual PlusStatus AddItem(const void* imageDataPtr,
                              US_IMAGE_ORIENTATION usImageOrientation,
                              const FrameSizeType& frameSizeInPx,
                              igsioCommon::VTKScalarPixelType pixelType,
@@ -236,7 +258,7 @@ public:
     or if the frame's format doesn't match the buffer's frame format,
     then the frame is not added to the buffer.
   */
-  virtual PlusStatus AddItem(void* imageDataPtr,
+  virtual PlusStatus AddItem(const void* imageDataPtr,
                              const FrameSizeType& frameSize,
                              unsigned int frameSizeInBytes,
                              US_IMAGE_TYPE imageType,
@@ -253,6 +275,29 @@ public:
   */
   virtual PlusStatus AddItem(const igsioFieldMapType& customFields, long frameNumber, double unfilteredTimestamp = UNDEFINED_TIMESTAMP, double filteredTimestamp = UNDEFINED_TIMESTAMP);
 
+  /*!
+    Reserve the next frame of the buffer and get a writable pointer to its pixel data, so that the device can write the image
+    directly into the buffer without an extra copy. Only available if no clipping is defined and the input image orientation
+    is the same as the buffer image orientation. See vtkPlusBuffer::ReserveNewItem.
+  */
+  virtual PlusStatus ReserveNewItem(void*& imageDataPtr, unsigned int& frameSizeInBytes);
+
+  /*! Add the frame written into the memory provided by ReserveNewItem to the buffer. See vtkPlusBuffer::CommitReservedItem. */
+  virtual PlusStatus CommitReservedItem(long frameNumber, double unfilteredTimestamp = UNDEFINED_TIMESTAMP, double filteredTimestamp = UNDEFINED_TIMESTAMP, const igsioFieldMapType* customFields = NULL);
+
+  /*! Release the frame reserved by ReserveNewItem without adding it to the buffer */
+  virtual void CancelReservedItem();
+
+  /*!
+    Add a frame by swapping its pixel array with the pixel array of the overwritten buffer frame, without copying the pixels.
+    Only available if no clipping is defined and the input image orientation is the same as the buffer image orientation.
+    See vtkPlusBuffer::AddItemBySwappingPixels.
+  */
+  virtual PlusStatus AddItemBySwappingPixels(vtkSmartPointer<vtkDataArray>& pixels, long frameNumber, double unfilteredTimestamp = UNDEFINED_TIMESTAMP, double filteredTimestamp = UNDEFINED_TIMESTAMP, const igsioFieldMapType* customFields = NULL);
+
+  /*! Returns true if frames can be added by AddItemBySwappingPixels (no clipping, no reorientation, and supported by the buffer) */
+  virtual bool CanAddItemBySwappingPixels();
+
   /*!
   Add a matrix plus status to the list, with an exactly known timestamp value (e.g., provided by a high-precision hardware timer).
   If the timestamp is less than or equal to the previous timestamp, then nothing  will be done.
@@ -356,10 +401,29 @@ public:
   */
   void SetClipRectangleOrigin(const std::array<int, 3> _arg);
 
+  /*!
+    Set if the device applies the clip rectangle in hardware (e.g., it reads out or transfers only that region of the sensor).
+    The device then delivers frames of the size of the clip rectangle, which are not clipped again when they are added to the buffer.
+    The clip rectangle is kept and written to the configuration. Must be set before the input frame size is set.
+  */
+  void SetClipRectangleAppliedByDevice(bool applied);
+  bool GetClipRectangleAppliedByDevice() const;
+
 protected:
   /*! Access the data buffer */
   virtual vtkPlusBuffer* GetBuffer() const;
 
+  /*! Returns true if the frames have to be clipped when they are added to the buffer (clipping is requested and the device does not apply it) */
+  bool IsSoftwareClippingRequested() const;
+
+  /*! Clip rectangle origin used when the frames are added to the buffer, no clipping if the device applies the clip rectangle */
+  std::array<int, 3> GetSoftwareClipRectangleOrigin() const;
+  /*! Clip rectangle size used when the frames are added to the buffer, no clipping if the device applies the clip rectangle */
+  std::array<int, 3> GetSoftwareClipRectangleSize() const;
+
+  /*! Schedule the dataflow tasks (virtual devices) that use this source as input if an item has been added. Returns addStatus. */
+  PlusStatus NotifyItemAdded(PlusStatus addStatus);
+
 protected:
   vtkPlusDataSource();
   ~vtkPlusDataSource();
@@ -385,9 +449,15 @@ protected:
   std::array<int, 3> ClipRectangleOrigin;
   /*! Crop rectangle size for this data source */
   std::array<int, 3> ClipRectangleSize;
+  /*! The device delivers only the region of the clip rectangle */
+  bool ClipRectangleAppliedByDevice;
 
   FrameSizeType InputFrameSize;
 
+  /*! Updated by NotifyItemAdded, read by the metrics collectors */
+  std::atomic<unsigned long long> NumberOfItemsAdded;
+  std::atomic<unsigned long long> NumberOfItemsRejected;
+
 private:
   vtkPlusDataSource(const vtkPlusDataSource&);
   void operator=(const vtkPlusDataSource&);
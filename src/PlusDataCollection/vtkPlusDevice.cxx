@@ -6,6 +6,9 @@ See License.txt for details.
 
 // Local includes
 #include "PlusConfigure.h"
+#include "PlusAcquisitionScheduler.h"
+#include "PlusDataflowScheduler.h"
+#include "PlusProfiler.h"
 #include "vtkPlusBuffer.h"
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataSource.h"
@@ -26,6 +29,7 @@ See License.txt for details.
 #include <vtksys/SystemTools.hxx>
 
 // STD includes
+#include <algorithm>
 #include <set>
 
 // System includes
@@ -123,8 +127,11 @@ const std::string vtkPlusDevice::PARAMETER_XML_ELEMENT_TAG = "Parameter";
 vtkPlusDevice::vtkPlusDevice()
   : ThreadAlive(false)
   , Connected(0)
-  , Threader(vtkMultiThreader::New())
-  , ThreadId(-1)
+  , DataflowScheduling(false)
+  , DataflowScheduled(false)
+  , IdleWhenUnconsumed(false)
+  , Idle(false)
+  , InternalUpdateCount(0)
   , CurrentStreamBufferItem(new StreamBufferItem())
   , ToolReferenceFrameName("")
   , DeviceId("")
@@ -184,8 +191,6 @@ vtkPlusDevice::~vtkPlusDevice()
   delete this->CurrentStreamBufferItem;
   this->CurrentStreamBufferItem = NULL;
 
-  DELETE_IF_NOT_NULL(this->Threader);
-
   DELETE_IF_NOT_NULL(this->UpdateMutex);
 
   LOCAL_LOG_TRACE("vtkPlusDevice::~vtkPlusDevice() completed");
@@ -536,6 +541,18 @@ double vtkPlusDevice::GetLocalTimeOffsetSec() const
   return this->LocalTimeOffsetSec;
 }
 
+//----------------------------------------------------------------------------
+bool vtkPlusDevice::IsHardwareClockEnabled() const
+{
+  return this->DeviceHardwareClock.IsEnabled();
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusDevice::GetSystemTimeFromHardwareTimestamp(double hardwareTimestampSec, double arrivalSystemTimeSec)
+{
+  return this->DeviceHardwareClock.GetSystemTime(hardwareTimestampSec, arrivalSystemTimeSec);
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusDevice::InternalUpdate()
 {
@@ -665,6 +682,19 @@ double vtkPlusDevice::GetInternalUpdateRate() const
   return this->InternalUpdateRate;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusDevice::GetInternalUpdatePeriodError(double& medianSec, double& percentile99Sec) const
+{
+  AcquisitionScheduler::TaskStatistics statistics;
+  if (AcquisitionScheduler::GetInstance().GetTaskStatistics(this, statistics) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  medianSec = statistics.PeriodErrorMedianSec;
+  percentile99Sec = statistics.PeriodErrorPercentile99Sec;
+  return PLUS_SUCCESS;
+}
+
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusDevice::SetAcquisitionRate(double aRate)
 {
@@ -841,6 +871,15 @@ vtkXMLDataElement* vtkPlusDevice::FindThisDeviceElement(vtkXMLDataElement* rootX
     return NULL;
   }
 
+  // Reuse the element found last time if it is still the element of this device in the same tree
+  vtkXMLDataElement* lastDeviceXMLElement = this->LastDeviceXMLElement;
+  if (lastDeviceXMLElement != NULL && this->LastDeviceXMLElementRoot == rootXMLElement &&
+      lastDeviceXMLElement->GetParent() != NULL && lastDeviceXMLElement->GetParent()->GetParent() == rootXMLElement &&
+      lastDeviceXMLElement->GetAttribute("Id") != NULL && std::string(lastDeviceXMLElement->GetAttribute("Id")) == this->GetDeviceId())
+  {
+    return lastDeviceXMLElement;
+  }
+
   vtkXMLDataElement* dataCollectionElement = rootXMLElement->FindNestedElementWithName("DataCollection");
   if (dataCollectionElement == NULL)
   {
@@ -858,6 +897,8 @@ vtkXMLDataElement* vtkPlusDevice::FindThisDeviceElement(vtkXMLDataElement* rootX
         std::string(deviceXMLElement->GetName()) == "Device" &&
         std::string(deviceXMLElement->GetAttribute("Id")) == this->GetDeviceId())
     {
+      this->LastDeviceXMLElementRoot = rootXMLElement;
+      this->LastDeviceXMLElement = deviceXMLElement;
       return deviceXMLElement;
     }
   }
@@ -1050,6 +1091,36 @@ PlusStatus vtkPlusDevice::ReadConfiguration(vtkXMLDataElement* rootXMLElement)
     LOCAL_LOG_DEBUG("Unable to find acquisition rate in device element when it is required, using default " << this->GetAcquisitionRate());
   }
 
+  XML_READ_STRING_ATTRIBUTE_NONMEMBER_OPTIONAL(AcquisitionThread, this->AcquisitionThreadName, deviceXMLElement);
+  int acquisitionThreadCpuAffinity = -1;
+  XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, AcquisitionThreadCpuAffinity, acquisitionThreadCpuAffinity, deviceXMLElement);
+  if (acquisitionThreadCpuAffinity >= 0 && acquisitionThreadCpuAffinity < 64)
+  {
+    this->AcquisitionThreadSettings.CpuAffinityMask = (1ULL << acquisitionThreadCpuAffinity);
+  }
+  bool acquisitionThreadRealTimePriority = false;
+  XML_READ_BOOL_ATTRIBUTE_NONMEMBER_OPTIONAL(AcquisitionThreadRealTimePriority, acquisitionThreadRealTimePriority, deviceXMLElement);
+  if (acquisitionThreadRealTimePriority)
+  {
+    this->AcquisitionThreadSettings.Priority = PlusThreadSettings::PRIORITY_REALTIME;
+  }
+  if (this->AcquisitionThreadSettings.ReadConfiguration(deviceXMLElement, "AcquisitionThread") != PLUS_SUCCESS)
+  {
+    LOCAL_LOG_ERROR("Invalid acquisition thread settings");
+    return PLUS_FAIL;
+  }
+  XML_READ_BOOL_ATTRIBUTE_NONMEMBER_OPTIONAL(DataflowScheduling, this->DataflowScheduling, deviceXMLElement);
+  XML_READ_BOOL_ATTRIBUTE_NONMEMBER_OPTIONAL(IdleWhenUnconsumed, this->IdleWhenUnconsumed, deviceXMLElement);
+  if (this->IdleWhenUnconsumed && !this->IsVirtual())
+  {
+    LOCAL_LOG_WARNING("IdleWhenUnconsumed is enabled for a device that is not virtual, data is not acquired while the device is idle");
+  }
+  if (this->DeviceHardwareClock.ReadConfiguration(deviceXMLElement) != PLUS_SUCCESS)
+  {
+    LOCAL_LOG_ERROR("Invalid hardware clock settings");
+    return PLUS_FAIL;
+  }
+
   vtkXMLDataElement* outputChannelsElement = deviceXMLElement->FindNestedElementWithName("OutputChannels");
   if (outputChannelsElement != NULL)
   {
@@ -1200,6 +1271,7 @@ PlusStatus vtkPlusDevice::WriteConfiguration(vtkXMLDataElement* config)
   {
     deviceDataElement->SetDoubleAttribute("LocalTimeOffsetSec", this->GetLocalTimeOffsetSec());
   }
+  this->DeviceHardwareClock.WriteConfiguration(deviceDataElement);
 
   // Parameters writing
   XML_FIND_NESTED_ELEMENT_CREATE_IF_MISSING(parameterList, deviceDataElement, PARAMETERS_XML_ELEMENT_TAG.c_str());
@@ -1296,13 +1368,63 @@ PlusStatus vtkPlusDevice::StartRecording()
   }
 
   this->RecordingStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  this->DeviceHardwareClock.Reset();
   this->Recording = 1;
 
+  // The device consumes its inputs while it is recording and not idle
+  this->Idle = false;
+  for (ChannelContainerIterator it = this->InputChannels.begin(); it != this->InputChannels.end(); ++it)
+  {
+    (*it)->AddConsumer(this);
+  }
+
   if (this->StartThreadForInternalUpdates)
   {
-    this->ThreadId =
-      this->Threader->SpawnThread((vtkThreadFunctionType)\
-                                  &vtkDataCaptureThread, this);
+    std::vector<const void*> inputDataSources;
+    if (this->DataflowScheduling)
+    {
+      this->GetInputDataSources(inputDataSources);
+      if (inputDataSources.empty())
+      {
+        LOCAL_LOG_WARNING("Dataflow scheduling requires input channels with data sources, internal updates are run periodically");
+      }
+    }
+    this->DataflowScheduled = !inputDataSources.empty();
+
+    this->InternalUpdateStartTimes.assign(FRAME_RATE_AVERAGING, 0.0);
+    this->InternalUpdateCount = 0;
+    this->ThreadAlive = true;
+    PlusStatus scheduleStatus = PLUS_FAIL;
+    if (this->DataflowScheduled)
+    {
+      if (!this->AcquisitionThreadSettings.IsDefault())
+      {
+        LOCAL_LOG_WARNING("Acquisition thread settings are ignored, the internal updates are run by the shared dataflow scheduler threads");
+      }
+      scheduleStatus = DataflowScheduler::GetInstance().AddTask(this, inputDataSources, [this]() { return this->ScheduledInternalUpdate(); });
+    }
+    else
+    {
+      std::string threadName = (this->AcquisitionThreadName.empty() ? this->GetDeviceId() : this->AcquisitionThreadName);
+      scheduleStatus = AcquisitionScheduler::GetInstance().AddTask(this, threadName, 1.0 / this->GetAcquisitionRate(),
+                       [this]() { return this->ScheduledInternalUpdate(); }, this->AcquisitionThreadSettings);
+    }
+    if (scheduleStatus != PLUS_SUCCESS)
+    {
+      LOCAL_LOG_ERROR("Cannot start recording, failed to schedule internal updates");
+      this->ThreadAlive = false;
+      this->Recording = 0;
+      this->InternalStopRecording();
+      return PLUS_FAIL;
+    }
+  }
+
+  for (ChannelContainerIterator it = this->OutputChannels.begin(); it != this->OutputChannels.end(); ++it)
+  {
+    if ((*it)->StartSharedMemoryOutput() != PLUS_SUCCESS)
+    {
+      LOCAL_LOG_ERROR("Failed to start shared memory output of channel " << (*it)->GetChannelId());
+    }
   }
 
   this->Modified();
@@ -1323,21 +1445,35 @@ PlusStatus vtkPlusDevice::StopRecording()
     return PLUS_SUCCESS;
   }
 
-  this->ThreadId = -1;
   this->Recording = 0;
 
+  for (ChannelContainerIterator it = this->OutputChannels.begin(); it != this->OutputChannels.end(); ++it)
+  {
+    (*it)->StopSharedMemoryOutput();
+  }
+
   if (this->GetStartThreadForInternalUpdates())
   {
-    LOCAL_LOG_DEBUG("Wait for internal update thread to terminate");
-    // Let's give a chance to the thread to stop before we kill the connection
-    while (this->ThreadAlive)
+    LOCAL_LOG_DEBUG("Wait for internal updates to terminate");
+    // Waits for the completion of the current update before we kill the connection
+    if (this->DataflowScheduled)
+    {
+      DataflowScheduler::GetInstance().RemoveTask(this);
+    }
+    else
     {
-      vtkIGSIOAccurateTimer::Delay(0.1);
+      AcquisitionScheduler::GetInstance().RemoveTask(this);
     }
-    this->ThreadId = -1;
-    LOCAL_LOG_DEBUG("Internal update thread terminated");
+    this->ThreadAlive = false;
+    LOCAL_LOG_DEBUG("Internal updates terminated");
   }
 
+  for (ChannelContainerIterator it = this->InputChannels.begin(); it != this->InputChannels.end(); ++it)
+  {
+    (*it)->RemoveConsumer(this);
+  }
+  this->Idle = false;
+
   if (this->InternalStopRecording() != PLUS_SUCCESS)
   {
     LOCAL_LOG_ERROR("Failed to stop tracking thread!");
@@ -1350,50 +1486,112 @@ PlusStatus vtkPlusDevice::StopRecording()
 }
 
 //----------------------------------------------------------------------------
-// this function runs in an alternate thread to asynchronously acquire data
-void* vtkPlusDevice::vtkDataCaptureThread(vtkMultiThreader::ThreadInfo* data)
+void vtkPlusDevice::GetInputDataSources(std::vector<const void*>& dataSources) const
 {
-  vtkPlusDevice* self = (vtkPlusDevice*)(data->UserData);
-
-  double rate = self->GetAcquisitionRate();
-  double currtime[FRAME_RATE_AVERAGING] = {0};
-  unsigned long updatecount = 0;
-  self->ThreadAlive = true;
-
-  while (self->IsRecording() && self->GetCorrectlyConfigured())
+  dataSources.clear();
+  for (ChannelContainerConstIterator it = this->InputChannels.begin(); it != this->InputChannels.end(); ++it)
   {
-    double newtime = vtkIGSIOAccurateTimer::GetSystemTime();
-    // get current tracking rate over last few updates
-    double difftime = newtime - currtime[updatecount % FRAME_RATE_AVERAGING];
-    currtime[updatecount % FRAME_RATE_AVERAGING] = newtime;
-    if (updatecount > FRAME_RATE_AVERAGING && difftime != 0)
+    vtkPlusChannel* inputChannel = *it;
+    vtkPlusDataSource* videoSource = NULL;
+    if (inputChannel->HasVideoSource() && inputChannel->GetVideoSource(videoSource) == PLUS_SUCCESS)
     {
-      self->InternalUpdateRate = (FRAME_RATE_AVERAGING / difftime);
+      dataSources.push_back(videoSource);
     }
+    for (DataSourceContainerConstIterator toolIt = inputChannel->GetToolsStartConstIterator(); toolIt != inputChannel->GetToolsEndConstIterator(); ++toolIt)
+    {
+      dataSources.push_back(toolIt->second);
+    }
+    for (DataSourceContainerConstIterator fieldIt = inputChannel->GetFieldDataSourcesStartConstIterator(); fieldIt != inputChannel->GetFieldDataSourcesEndConstIterator(); ++fieldIt)
+    {
+      dataSources.push_back(fieldIt->second);
+    }
+  }
+}
 
+//----------------------------------------------------------------------------
+// this function is called by the acquisition or dataflow scheduler to asynchronously acquire data
+bool vtkPlusDevice::ScheduledInternalUpdate()
+{
+  if (!this->IsRecording() || !this->GetCorrectlyConfigured())
+  {
+    this->ThreadAlive = false;
+    return false;
+  }
+
+  if (this->IdleWhenUnconsumed && this->UpdateIdleState())
+  {
+    // nobody uses the output, the update is skipped until a consumer is added
+    return true;
+  }
+
+  double newtime = vtkIGSIOAccurateTimer::GetSystemTime();
+  // get current tracking rate over last few updates
+  double difftime = newtime - this->InternalUpdateStartTimes[this->InternalUpdateCount % FRAME_RATE_AVERAGING];
+  this->InternalUpdateStartTimes[this->InternalUpdateCount % FRAME_RATE_AVERAGING] = newtime;
+  if (this->InternalUpdateCount > FRAME_RATE_AVERAGING && difftime != 0)
+  {
+    this->InternalUpdateRate = (FRAME_RATE_AVERAGING / difftime);
+  }
+  this->InternalUpdateCount++;
+
+  {
+    // Lock before update
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->UpdateMutex);
+    if (!this->Recording)
     {
-      // Lock before update
-      igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(self->UpdateMutex);
-      if (!self->Recording)
-      {
-        // recording has been stopped
-        break;
-      }
-      self->InternalUpdate();
-      self->UpdateTime.Modified();
+      // recording has been stopped
+      this->ThreadAlive = false;
+      return false;
     }
+    PLUS_PROFILE_SCOPE_DETAIL("vtkPlusDevice::InternalUpdate", this->GetDeviceId());
+    this->InternalUpdate();
+    this->UpdateTime.Modified();
+  }
+
+  return true;
+}
 
-    double delay = (newtime + 1.0 / rate - vtkIGSIOAccurateTimer::GetSystemTime());
-    if (delay > 0)
+//----------------------------------------------------------------------------
+bool vtkPlusDevice::HasOutputConsumers() const
+{
+  for (ChannelContainerConstIterator it = this->OutputChannels.begin(); it != this->OutputChannels.end(); ++it)
+  {
+    if ((*it)->GetNumberOfConsumers() > 0)
     {
-      vtkIGSIOAccurateTimer::Delay(delay);
+      return true;
     }
+  }
+  return false;
+}
 
-    updatecount++;
+//----------------------------------------------------------------------------
+bool vtkPlusDevice::UpdateIdleState()
+{
+  const bool idle = !this->HasOutputConsumers();
+  if (idle == this->Idle)
+  {
+    return idle;
   }
 
-  self->ThreadAlive = false;
-  return NULL;
+  for (ChannelContainerIterator it = this->InputChannels.begin(); it != this->InputChannels.end(); ++it)
+  {
+    if (idle)
+    {
+      (*it)->RemoveConsumer(this);
+    }
+    else
+    {
+      (*it)->AddConsumer(this);
+    }
+  }
+  if (!idle)
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->UpdateMutex);
+    this->InternalResumeFromIdle();
+  }
+  this->Idle = idle;
+  LOCAL_LOG_DEBUG((idle ? "Device is idle, its output channels have no consumers" : "Device resumed processing, its output channels have consumers"));
+  return idle;
 }
 
 //----------------------------------------------------------------------------
@@ -1591,6 +1789,10 @@ void vtkPlusDevice::ClearAllBuffers()
   {
     it->second->Clear();
   }
+  for (ChannelContainerIterator it = this->OutputChannels.begin(); it != this->OutputChannels.end(); ++it)
+  {
+    (*it)->ClearTrackedFrameCache();
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -1609,6 +1811,7 @@ PlusStatus vtkPlusDevice::ForceUpdate()
 
   {
     igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->UpdateMutex);
+    PLUS_PROFILE_SCOPE_DETAIL("vtkPlusDevice::InternalUpdate", this->GetDeviceId());
     this->InternalUpdate();
   }
   return PLUS_SUCCESS;
@@ -1673,6 +1876,27 @@ PlusStatus vtkPlusDevice::AddVideoItemToVideoSources(const std::vector<vtkPlusDa
   return result;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusDevice::GetCommonClipRectangleOfVideoSources(std::array<int, 3>& origin, std::array<int, 3>& size) const
+{
+  std::vector<vtkPlusDataSource*> videoSources = this->GetVideoSources();
+  if (videoSources.empty())
+  {
+    return PLUS_FAIL;
+  }
+  origin = videoSources[0]->GetClipRectangleOrigin();
+  size = videoSources[0]->GetClipRectangleSize();
+  for (std::vector<vtkPlusDataSource*>::const_iterator it = videoSources.begin(); it != videoSources.end(); ++it)
+  {
+    if (!igsioCommon::IsClippingRequested((*it)->GetClipRectangleOrigin(), (*it)->GetClipRectangleSize())
+        || (*it)->GetClipRectangleOrigin() != origin || (*it)->GetClipRectangleSize() != size)
+    {
+      return PLUS_FAIL;
+    }
+  }
+  return PLUS_SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusDevice::ToolTimeStampedUpdate(const std::string& aToolSourceId, vtkMatrix4x4* matrix, ToolStatus status, unsigned long frameNumber, double unfilteredtimestamp, const igsioFieldMapType* customFields/*= NULL*/)
 {
@@ -1700,6 +1924,82 @@ PlusStatus vtkPlusDevice::ToolTimeStampedUpdate(const std::string& aToolSourceId
   return bufferStatus;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusDevice::AddTimeStampedItems(const ToolTimeStampedItemList& items, double unfilteredTimestamp, double filteredTimestamp /*= UNDEFINED_TIMESTAMP*/)
+{
+  if (items.empty())
+  {
+    return PLUS_SUCCESS;
+  }
+  if (unfilteredTimestamp == UNDEFINED_TIMESTAMP)
+  {
+    unfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+  }
+
+  PlusStatus status = PLUS_SUCCESS;
+  std::vector<vtkPlusDataSource*> tools(items.size(), NULL);
+  for (size_t itemIndex = 0; itemIndex < items.size(); ++itemIndex)
+  {
+    const std::string& toolSourceId = items[itemIndex].ToolSourceId;
+    if (toolSourceId.empty())
+    {
+      LOCAL_LOG_ERROR("Failed to update tool - tool source ID is empty!");
+      status = PLUS_FAIL;
+      continue;
+    }
+    if (this->GetTool(toolSourceId, tools[itemIndex]) != PLUS_SUCCESS)
+    {
+      if (this->ReportedUnknownTools.find(toolSourceId) == this->ReportedUnknownTools.end())
+      {
+        // We have not reported yet that this tool is unknown
+        LOCAL_LOG_ERROR("Failed to update tool - unable to find tool: " << toolSourceId);
+        this->ReportedUnknownTools.insert(toolSourceId);
+      }
+      tools[itemIndex] = NULL;
+      status = PLUS_FAIL;
+    }
+  }
+
+  // All tools are measured at the same time, so the filtered timestamp is computed once for all of them
+  if (filteredTimestamp == UNDEFINED_TIMESTAMP)
+  {
+    std::vector<vtkPlusDataSource*>::iterator firstToolIt = std::find_if(tools.begin(), tools.end(), [](vtkPlusDataSource* tool) { return tool != NULL; });
+    if (firstToolIt == tools.end())
+    {
+      return PLUS_FAIL;
+    }
+    const ToolTimeStampedItem& firstItem = items[firstToolIt - tools.begin()];
+    bool filteredTimestampProbablyValid = true;
+    if ((*firstToolIt)->GetBuffer()->CreateFilteredTimeStampForItem(firstItem.FrameNumber, unfilteredTimestamp, filteredTimestamp, filteredTimestampProbablyValid) != PLUS_SUCCESS)
+    {
+      LOCAL_LOG_DEBUG("Failed to create filtered timestamp for tracker buffer item with item index: " << firstItem.FrameNumber);
+      return PLUS_FAIL;
+    }
+    if (!filteredTimestampProbablyValid)
+    {
+      LOG_INFO("Filtered timestamp is probably invalid for tracker buffer item with item index=" << firstItem.FrameNumber << ", time=" << unfilteredTimestamp << ". The item may have been tagged with an inaccurate timestamp, therefore it will not be recorded.");
+      return status;
+    }
+  }
+
+  for (size_t itemIndex = 0; itemIndex < items.size(); ++itemIndex)
+  {
+    vtkPlusDataSource* tool = tools[itemIndex];
+    if (tool == NULL)
+    {
+      continue;
+    }
+    const ToolTimeStampedItem& item = items[itemIndex];
+    if (tool->AddTimeStampedItem(item.Matrix, item.Status, item.FrameNumber, unfilteredTimestamp, filteredTimestamp, item.CustomFields) != PLUS_SUCCESS)
+    {
+      status = PLUS_FAIL;
+    }
+    tool->SetFrameNumber(item.FrameNumber);
+  }
+
+  return status;
+}
+
 //----------------------------------------------------------------------------
 // This method returns the largest data that can be generated.
 int vtkPlusDevice::RequestInformation(vtkInformation* vtkNotUsed(request), vtkInformationVector** vtkNotUsed(inputVector), vtkInformationVector* outputVector)
@@ -2064,6 +2364,32 @@ double vtkPlusDevice::GetAcquisitionRate() const
   return this->AcquisitionRate;
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusDevice::GetMemoryUsage(std::vector<MemoryAccounting::Usage>& usages)
+{
+  std::vector<vtkPlusDataSource*> sources;
+  for (DataSourceContainerConstIterator sourceIt = this->GetVideoSourceIteratorBegin(); sourceIt != this->GetVideoSourceIteratorEnd(); ++sourceIt)
+  {
+    sources.push_back(sourceIt->second);
+  }
+  for (DataSourceContainerConstIterator sourceIt = this->GetToolIteratorBegin(); sourceIt != this->GetToolIteratorEnd(); ++sourceIt)
+  {
+    sources.push_back(sourceIt->second);
+  }
+  for (DataSourceContainerConstIterator sourceIt = this->GetFieldDataSourcessIteratorBegin(); sourceIt != this->GetFieldDataSourcessIteratorEnd(); ++sourceIt)
+  {
+    sources.push_back(sourceIt->second);
+  }
+
+  MetricsRegistry::Labels sourceLabels;
+  sourceLabels["device"] = this->GetDeviceId();
+  for (std::vector<vtkPlusDataSource*>::const_iterator sourceIt = sources.begin(); sourceIt != sources.end(); ++sourceIt)
+  {
+    sourceLabels["source"] = (*sourceIt)->GetSourceId();
+    usages.push_back(MemoryAccounting::Usage("buffer", sourceLabels, (*sourceIt)->GetBufferMemoryUsageBytes()));
+  }
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusDevice::InternalWriteOutputChannels(vtkXMLDataElement* rootXMLElement)
 {
@@ -2308,6 +2634,18 @@ ChannelContainerIterator vtkPlusDevice::GetOutputChannelsEnd()
   return this->OutputChannels.end();
 }
 
+//----------------------------------------------------------------------------
+ChannelContainerConstIterator vtkPlusDevice::GetInputChannelsStart() const
+{
+  return this->InputChannels.begin();
+}
+
+//----------------------------------------------------------------------------
+ChannelContainerConstIterator vtkPlusDevice::GetInputChannelsEnd() const
+{
+  return this->InputChannels.end();
+}
+
 //------------------------------------------------------------------------------
 PlusStatus vtkPlusDevice::GetToolReferenceFrameFromTrackedFrame(igsioTrackedFrame& aFrame, std::string& aToolReferenceFrameName)
 {
@@ -2470,6 +2808,15 @@ PlusStatus vtkPlusDevice::GetImage(const std::string& requestedImageId, std::str
   return PLUS_FAIL;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusDevice::GetImageSnapshot(const std::string& requestedImageId, std::string& assignedImageId, const std::string& imageReferencFrameName,
+    vtkSmartPointer<vtkImageData>& imageData, vtkMatrix4x4* ijkToReferenceTransform, std::string& frameUid)
+{
+  frameUid.clear();
+  imageData = vtkSmartPointer<vtkImageData>::New();
+  return this->GetImage(requestedImageId, assignedImageId, imageReferencFrameName, imageData, ijkToReferenceTransform);
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusDevice::SendText(const std::string& textToSend, std::string* textReceived/*=NULL*/)
 {
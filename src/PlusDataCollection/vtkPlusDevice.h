@@ -10,15 +10,21 @@ See License.txt for details.
 // Local includes
 #include "igsioCommon.h"
 #include "PlusConfigure.h"
+#include "PlusHardwareClock.h"
+#include "PlusMemoryAccounting.h"
 #include "PlusStreamBufferItem.h"
+#include "PlusThreadSettings.h"
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataCollectionExport.h"
 
 // VTK includes
 #include <vtkImageAlgorithm.h>
 #include <vtkMultiThreader.h>
+#include <vtkSmartPointer.h>
 #include <vtkStdString.h>
+#include <vtkWeakPointer.h>
 
+#include <atomic>
 #include <set>
 
 // STL includes
@@ -162,6 +168,38 @@ public:
   /*! Get the internal update rate for this tracking system.  This is the number of buffer entry items sent by the device per second (per tool). */
   double GetInternalUpdateRate() const;
 
+  /*!
+    Get the jitter of the internal update thread: median and 99th percentile of the absolute difference
+    between the actual and the requested (1/AcquisitionRate) update period, over the most recent updates.
+    Returns PLUS_FAIL if the device is not recording with an internal update thread or the updates are run by dataflow scheduling.
+  */
+  PlusStatus GetInternalUpdatePeriodError(double& medianSec, double& percentile99Sec) const;
+
+  /*!
+    If enabled, then the internal updates of a device that has input channels are run on the shared dataflow worker pool
+    each time new data is added to an input channel, instead of periodically at AcquisitionRate.
+    Only used if the device runs internal updates (typically virtual devices).
+  */
+  vtkSetMacro(DataflowScheduling, bool);
+  vtkGetMacro(DataflowScheduling, bool);
+  vtkBooleanMacro(DataflowScheduling, bool);
+
+  /*!
+    If enabled, then the internal updates are skipped while none of the output channels has a consumer (see vtkPlusChannel::AddConsumer),
+    and the device does not consume its input channels meanwhile, so idle upstream processing devices can pause as well.
+    Processing resumes at the next scheduled update after a consumer is added. Intended for processing devices
+    (image processors, OCR, simulators), as a device that polls hardware in its internal update does not acquire data while idle.
+  */
+  vtkSetMacro(IdleWhenUnconsumed, bool);
+  vtkGetMacro(IdleWhenUnconsumed, bool);
+  vtkBooleanMacro(IdleWhenUnconsumed, bool);
+
+  /*! True if the internal updates are skipped because no output channel has a consumer */
+  bool IsIdle() const { return this->Idle; }
+
+  /*! True if any of the output channels has a consumer */
+  bool HasOutputConsumers() const;
+
   /*! Get the data source object for the specified Id name, checks both video and tools */
   PlusStatus GetDataSource(const char* aSourceId, vtkPlusDataSource*& aSource);
   PlusStatus GetDataSource(const std::string& aSourceId, vtkPlusDataSource*& aSource);
@@ -253,6 +291,9 @@ public:
   virtual void SetLocalTimeOffsetSec(double aTimeOffsetSec);
   virtual double GetLocalTimeOffsetSec() const;
 
+  /*! True if the timestamps provided by the device hardware are used (HardwareClock attribute is not None) */
+  bool IsHardwareClockEnabled() const;
+
   /*!
   The subclass will do all the hardware-specific update stuff
   in this function. It should call ToolUpdate() for each tool.
@@ -297,6 +338,12 @@ public:
   /*! Get whether recording is underway */
   virtual bool IsRecording() const;
 
+  /*!
+    Append the memory used by the device to the list. By default it is the buffers of the data sources of the device,
+    devices that keep frames or volumes outside of the buffers add their own entries.
+  */
+  virtual void GetMemoryUsage(std::vector<MemoryAccounting::Usage>& usages);
+
   /* Return the id of the device */
   virtual std::string GetDeviceId() const;
   // Set the device Id
@@ -396,6 +443,10 @@ public:
   /*! Add an input channel */
   PlusStatus AddInputChannel(vtkPlusChannel* aChannel);
 
+  /*! Access the input channels */
+  ChannelContainerConstIterator GetInputChannelsStart() const;
+  ChannelContainerConstIterator GetInputChannelsEnd() const;
+
   /*!
   Perform any completion tasks once configured
   */
@@ -436,6 +487,17 @@ public:
   */
   virtual PlusStatus GetImage(const std::string& requestedImageId, std::string& assignedImageId, const std::string& imageReferencFrameName, vtkImageData* imageData, vtkMatrix4x4* ijkToReferenceTransform);
 
+  /*!
+    Same as GetImage, but the image is returned as a reference-counted snapshot instead of a copy. The device does not modify
+    the returned image object (new content is written into a new object), so it can be sent and kept by the caller without copying,
+    while acquisition goes on. The caller must not modify it either.
+    \param frameUid Identifies the content of the returned image: the same UID is returned as long as the image (pixels and geometry)
+      is not changed, so the encoded image can be reused. Empty if the device cannot identify its content.
+    The default implementation returns a new image filled by GetImage, with empty frameUid.
+  */
+  virtual PlusStatus GetImageSnapshot(const std::string& requestedImageId, std::string& assignedImageId, const std::string& imageReferencFrameName,
+                                      vtkSmartPointer<vtkImageData>& imageData, vtkMatrix4x4* ijkToReferenceTransform, std::string& frameUid);
+
   /*!
     Send text message to the device. If a non-NULL pointer is passed as textReceived
     then the device waits for a response and returns it in textReceived.
@@ -443,7 +505,8 @@ public:
   virtual PlusStatus SendText(const std::string& textToSend, std::string* textReceived = NULL);
 
 protected:
-  static void* vtkDataCaptureThread(vtkMultiThreader::ThreadInfo* data);
+  /*! Called periodically by the acquisition scheduler if StartThreadForInternalUpdates is enabled. Returns false when the updates should be stopped. */
+  bool ScheduledInternalUpdate();
 
   /*! Should be overridden to connect to the hardware */
   virtual PlusStatus InternalConnect();
@@ -476,6 +539,22 @@ protected:
       igsioCommon::VTKScalarPixelType pixelType, unsigned int numberOfScalarComponents, US_IMAGE_TYPE imageType, int numberOfBytesToSkip, long frameNumber, double unfilteredTimestamp = UNDEFINED_TIMESTAMP,
       double filteredTimestamp = UNDEFINED_TIMESTAMP, const igsioFieldMapType* customFields = NULL);
 
+  /*!
+    Get the clip rectangle that is requested for all video sources of the device, so that the device can apply it in hardware
+    (see vtkPlusDataSource::SetClipRectangleAppliedByDevice). Returns PLUS_FAIL if there are no video sources,
+    any of them is not clipped, or their clip rectangles are different.
+  */
+  PlusStatus GetCommonClipRectangleOfVideoSources(std::array<int, 3>& origin, std::array<int, 3>& size) const;
+
+  /*!
+    Convert a timestamp provided by the device hardware to system time, using the clock selected by the HardwareClock
+    attribute. The result can be used as both unfiltered and filtered timestamp of the item (the conversion removes
+    the transfer jitter, so no further filtering is needed). Returns the arrival time if the hardware clock is not enabled.
+    \param hardwareTimestampSec Timestamp provided by the device, in seconds
+    \param arrivalSystemTimeSec System time when the item was received
+  */
+  double GetSystemTimeFromHardwareTimestamp(double hardwareTimestampSec, double arrivalSystemTimeSec);
+
   /*!
   This function is called by InternalUpdate() so that the subclasses
   can communicate information back to the vtkPlusDevice base class, which
@@ -491,6 +570,29 @@ protected:
   */
   virtual PlusStatus ToolTimeStampedUpdateWithoutFiltering(const std::string& aToolSourceId, vtkMatrix4x4* matrix, ToolStatus status, double unfilteredtimestamp, double filteredtimestamp, const igsioFieldMapType* customFields = NULL);
 
+  /*! Pose of one tool in a batch of tool updates (see AddTimeStampedItems) */
+  struct ToolTimeStampedItem
+  {
+    ToolTimeStampedItem(const std::string& toolSourceId, vtkMatrix4x4* matrix, ToolStatus status, unsigned long frameNumber, const igsioFieldMapType* customFields = NULL)
+      : ToolSourceId(toolSourceId), Matrix(matrix), Status(status), FrameNumber(frameNumber), CustomFields(customFields) {}
+    std::string ToolSourceId;
+    /*! The matrix is copied into the buffer, it is not stored */
+    vtkMatrix4x4* Matrix;
+    ToolStatus Status;
+    unsigned long FrameNumber;
+    const igsioFieldMapType* CustomFields;
+  };
+  typedef std::vector<ToolTimeStampedItem> ToolTimeStampedItemList;
+
+  /*!
+  Batch version of ToolTimeStampedUpdate for trackers that measure the poses of all tools in one hardware sample.
+  The filtered timestamp is computed only once (using the timestamp filter of the first known tool) and all
+  the tool buffers receive the same filtered timestamp, so all tools of the sample remain synchronized.
+  If filteredTimestamp is defined then it is used instead of filtering the unfiltered timestamp.
+  Returns PLUS_FAIL if any of the tools could not be updated (the other tools are still updated).
+  */
+  virtual PlusStatus AddTimeStampedItems(const ToolTimeStampedItemList& items, double unfilteredTimestamp, double filteredTimestamp = UNDEFINED_TIMESTAMP);
+
   /*!
   Helper function used during configuration to locate the correct XML element for a device
   */
@@ -537,11 +639,55 @@ protected:
   /* Is device connected */
   int Connected;
 
-  /*! Thread used for acquisition */
-  vtkMultiThreader* Threader;
+  /*!
+    Name of the scheduler thread that runs the internal updates. Devices that specify the same name share one thread.
+    If empty then the device id is used (each device has its own thread).
+  */
+  std::string AcquisitionThreadName;
+
+  /*!
+    Priority, CPU affinity and memory locking settings of the internal update thread (AcquisitionThreadPriority,
+    AcquisitionThreadMmcssTask, AcquisitionThreadCpuAffinityMask, AcquisitionThreadLockMemory attributes).
+    The older AcquisitionThreadCpuAffinity (CPU index) and AcquisitionThreadRealTimePriority attributes are also accepted.
+  */
+  PlusThreadSettings AcquisitionThreadSettings;
+
+  /*!
+    Converts the timestamps provided by the device hardware to system time (HardwareClock attribute).
+    Only used by devices that provide hardware timestamps, see GetSystemTimeFromHardwareTimestamp.
+  */
+  HardwareClock DeviceHardwareClock;
+
+  /*! Run internal updates when new data is added to the input channels (DataflowScheduler) instead of periodically */
+  bool DataflowScheduling;
+
+  /*! The internal updates of the current recording are run by the DataflowScheduler */
+  bool DataflowScheduled;
 
-  /*! Recording thread id */
-  int ThreadId;
+  /*! Get the data sources of all input channels, used as triggers of dataflow scheduling */
+  void GetInputDataSources(std::vector<const void*>& dataSources) const;
+
+  /*! Skip the internal updates while no output channel has a consumer */
+  bool IdleWhenUnconsumed;
+
+  /*! Internal updates are skipped, the device is not registered as a consumer of its input channels. Set by the update thread. */
+  std::atomic<bool> Idle;
+
+  /*!
+    Enter or leave the idle state if the consumers of the output channels changed.
+    Called by the update thread when IdleWhenUnconsumed is enabled. Returns true if the device is idle.
+  */
+  bool UpdateIdleState();
+
+  /*!
+    Called before the first internal update after the device was idle. Devices that process their input incrementally
+    should forget about the input that arrived while idle here, so that processing continues with the latest data.
+  */
+  virtual void InternalResumeFromIdle() {}
+
+  /*! Start times of the most recent internal updates, used for computing InternalUpdateRate */
+  std::vector<double> InternalUpdateStartTimes;
+  unsigned long InternalUpdateCount;
 
   ChannelContainer  OutputChannels;
   ChannelContainer  InputChannels;
@@ -581,6 +727,13 @@ protected:
   /*! Is this device correctly configured? */
   bool CorrectlyConfigured;
 
+  /*!
+  Device element that FindThisDeviceElement found last time and the root element that it was found in.
+  The device element is looked up by many configuration functions, so it is not searched again in the same tree.
+  */
+  vtkWeakPointer<vtkXMLDataElement> LastDeviceXMLElementRoot;
+  vtkWeakPointer<vtkXMLDataElement> LastDeviceXMLElement;
+
   /*!
   If enabled, then a data capture thread is created when the device is connected that regularly calls InternalUpdate.
   This update mechanism is useful for devices that don't provide callback functions but require polling.
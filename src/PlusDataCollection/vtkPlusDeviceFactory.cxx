@@ -6,11 +6,20 @@ See License.txt for details.
 
 // Local includes
 #include "PlusConfigure.h"
+#include "PlusDevicePlugin.h"
 #include "vtkPlusDevice.h"
 #include "vtkPlusDeviceFactory.h"
 
 // VTK includes
 #include <vtkObjectFactory.h>
+#include <vtksys/Directory.hxx>
+#include <vtksys/DynamicLoader.hxx>
+#include <vtksys/SystemTools.hxx>
+
+// STL includes
+#include <fstream>
+#include <mutex>
+#include <sstream>
 
 //----------------------------------------------------------------------------
 // Virtual devices
@@ -19,6 +28,11 @@ See License.txt for details.
 #include "vtkPlusVirtualCapture.h"
 #include "vtkPlusVirtualVolumeReconstructor.h"
 #include "vtkPlusVirtualDeinterlacer.h"
+#include "vtkPlusVirtualDecimator.h"
+#include "vtkPlusVirtualImageResizer.h"
+#include "vtkPlusVirtualPipeline.h"
+#include "vtkPlusVirtualPoseFusion.h"
+#include "vtkPlusVirtualPosePredictor.h"
 #include "vtkPlusImageProcessorVideoSource.h"
 #include "vtkPlusGenericSerialDevice.h"
 #ifdef PLUS_USE_TextRecognizer
@@ -44,7 +58,7 @@ See License.txt for details.
 #ifdef PLUS_USE_WITMOTIONTRACKER
 #include "vtkPlusWitMotionTracker.h"
 #endif
-#ifdef PLUS_USE_INTELREALSENSE
+#if defined(PLUS_USE_INTELREALSENSE) && !defined(PLUS_DEVICE_PLUGIN_INTELREALSENSE)
 #include "vtkPlusIntelRealSense.h"
 #endif
 #ifdef PLUS_USE_OPTICAL_MARKER_TRACKER
@@ -96,7 +110,9 @@ See License.txt for details.
 
 //----------------------------------------------------------------------------
 // Video sources
+#include "vtkPlusLoadGenerator.h"
 #include "vtkPlusSavedDataSource.h"
+#include "vtkPlusSharedMemorySource.h"
 #include "vtkPlusUsSimulatorVideoSource.h"
 
 #ifdef PLUS_USE_VFW_VIDEO
@@ -139,7 +155,7 @@ See License.txt for details.
 #include "Telemed\vtkPlusTelemedVideoSource.h"
 #endif
 
-#ifdef PLUS_USE_SPINNAKER_VIDEO
+#if defined(PLUS_USE_SPINNAKER_VIDEO) && !defined(PLUS_DEVICE_PLUGIN_SPINNAKER)
 #include "vtkPlusSpinnakerVideoSource.h"
 #endif
 
@@ -153,6 +169,7 @@ See License.txt for details.
 
 #ifdef PLUS_USE_OpenIGTLink
 #include "vtkPlusOpenIGTLinkVideoSource.h"
+#include "vtkPlusVirtualVideoEncoder.h"
 #endif
 
 #ifdef PLUS_USE_EPIPHAN
@@ -217,6 +234,104 @@ See License.txt for details.
 #include "vtkPlusClarius.h"
 #endif
 
+//----------------------------------------------------------------------------
+namespace
+{
+  /*! Device plugin manifests and loaded plugin modules, shared by all factories */
+  struct DevicePluginRegistry
+  {
+    DevicePluginRegistry() : DirectoriesScanned(false) {}
+
+    struct PluginDevice
+    {
+      std::string ModulePath;
+      std::string ClassName;
+    };
+
+    std::mutex Mutex;
+    std::vector<std::string> AdditionalDirectories;
+    bool DirectoriesScanned;
+    std::map<std::string, PluginDevice> Devices;
+    std::map<std::string, PlusRegisterDevicePluginFunction> LoadedModules;
+  };
+
+  //----------------------------------------------------------------------------
+  DevicePluginRegistry& GetDevicePluginRegistry()
+  {
+    static DevicePluginRegistry registry;
+    return registry;
+  }
+
+  //----------------------------------------------------------------------------
+  void ReadDevicePluginManifest(const std::string& directory, const std::string& manifestFileName, std::map<std::string, DevicePluginRegistry::PluginDevice>& devices)
+  {
+    std::string manifestPath = directory + "/" + manifestFileName;
+    std::ifstream manifest(manifestPath.c_str());
+    std::string modulePath;
+    std::string line;
+    while (std::getline(manifest, line))
+    {
+      std::istringstream lineStream(line);
+      std::string keyword;
+      lineStream >> keyword;
+      if (keyword == "Module")
+      {
+        std::string moduleFileName;
+        lineStream >> moduleFileName;
+        modulePath = directory + "/" + moduleFileName;
+      }
+      else if (keyword == "Device")
+      {
+        DevicePluginRegistry::PluginDevice device;
+        std::string deviceTypeName;
+        lineStream >> deviceTypeName >> device.ClassName;
+        if (modulePath.empty() || deviceTypeName.empty())
+        {
+          LOG_WARNING("Invalid device plugin manifest " << manifestPath << ": device is listed without a module or device type");
+          continue;
+        }
+        device.ModulePath = modulePath;
+        if (devices.find(deviceTypeName) == devices.end())
+        {
+          devices[deviceTypeName] = device;
+        }
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Find the device plugin manifests in the directories, must be called with the registry locked */
+  void ScanDevicePluginDirectories(DevicePluginRegistry& registry)
+  {
+    if (registry.DirectoriesScanned)
+    {
+      return;
+    }
+    registry.DirectoriesScanned = true;
+
+    std::vector<std::string> directories;
+    directories.push_back(vtkPlusConfig::GetInstance()->GetProgramDirectory());
+    directories.insert(directories.end(), registry.AdditionalDirectories.begin(), registry.AdditionalDirectories.end());
+    std::string manifestExtension = PLUS_DEVICE_PLUGIN_MANIFEST_EXTENSION;
+    for (std::vector<std::string>::iterator directoryIt = directories.begin(); directoryIt != directories.end(); ++directoryIt)
+    {
+      vtksys::Directory directory;
+      if (directoryIt->empty() || !directory.Load(*directoryIt))
+      {
+        continue;
+      }
+      for (unsigned long fileIndex = 0; fileIndex < directory.GetNumberOfFiles(); ++fileIndex)
+      {
+        std::string fileName = directory.GetFile(fileIndex);
+        if (fileName.size() > manifestExtension.size() && fileName.compare(fileName.size() - manifestExtension.size(), manifestExtension.size(), manifestExtension) == 0)
+        {
+          ReadDevicePluginManifest(*directoryIt, fileName, registry.Devices);
+        }
+      }
+    }
+  }
+}
+
 //----------------------------------------------------------------------------
 
 vtkStandardNewMacro(vtkPlusDeviceFactory);
@@ -255,7 +370,7 @@ vtkPlusDeviceFactory::vtkPlusDeviceFactory()
 #ifdef PLUS_USE_WITMOTIONTRACKER
   RegisterDevice("WitMotionTracker", "vtkPlusWitMotionTracker", (PointerToDevice)&vtkPlusWitMotionTracker::New);
 #endif
-#ifdef PLUS_USE_INTELREALSENSE
+#if defined(PLUS_USE_INTELREALSENSE) && !defined(PLUS_DEVICE_PLUGIN_INTELREALSENSE)
   RegisterDevice("IntelRealSense", "vtkPlusIntelRealSense", (PointerToDevice)&vtkPlusIntelRealSense::New);
 #endif
 
@@ -282,7 +397,9 @@ vtkPlusDeviceFactory::vtkPlusDeviceFactory()
 #endif
 
   RegisterDevice("SavedDataSource", "vtkPlusSavedDataSource", (PointerToDevice)&vtkPlusSavedDataSource::New);
+  RegisterDevice("SharedMemory", "vtkPlusSharedMemorySource", (PointerToDevice)&vtkPlusSharedMemorySource::New);
   RegisterDevice("UsSimulator", "vtkPlusUsSimulatorVideoSource", (PointerToDevice)&vtkPlusUsSimulatorVideoSource::New);
+  RegisterDevice("LoadGenerator", "vtkPlusLoadGenerator", (PointerToDevice)&vtkPlusLoadGenerator::New);
   RegisterDevice("ImageProcessor", "vtkPlusImageProcessorVideoSource", (PointerToDevice)&vtkPlusImageProcessorVideoSource::New);
   RegisterDevice("GenericSerialDevice", "vtkPlusGenericSerialDevice", (PointerToDevice)&vtkPlusGenericSerialDevice::New);
   RegisterDevice("NoiseVideo", "vtkPlusDevice", (PointerToDevice)&vtkPlusDevice::New);
@@ -327,7 +444,7 @@ vtkPlusDeviceFactory::vtkPlusDeviceFactory()
 #ifdef PLUS_USE_TELEMED_VIDEO
   RegisterDevice("TelemedVideo", "vtkPlusTelemedVideoSource", (PointerToDevice)&vtkPlusTelemedVideoSource::New);
 #endif
-#ifdef PLUS_USE_SPINNAKER_VIDEO
+#if defined(PLUS_USE_SPINNAKER_VIDEO) && !defined(PLUS_DEVICE_PLUGIN_SPINNAKER)
   RegisterDevice("SpinnakerVideo", "vtkPlusSpinnakerVideoSource", (PointerToDevice)&vtkPlusSpinnakerVideoSource::New);
 #endif
 #ifdef PLUS_USE_BLACKMAGIC_DECKLINK
@@ -409,6 +526,16 @@ vtkPlusDeviceFactory::vtkPlusDeviceFactory()
   RegisterDevice("VirtualBufferedCapture", "vtkPlusVirtualCapture", (PointerToDevice)&vtkPlusVirtualCapture::New); // for backward compatibility
   RegisterDevice("VirtualVolumeReconstructor", "vtkPlusVirtualVolumeReconstructor", (PointerToDevice)&vtkPlusVirtualVolumeReconstructor::New);
   RegisterDevice("VirtualDeinterlacer", "vtkPlusVirtualDeinterlacer", (PointerToDevice)&vtkPlusVirtualDeinterlacer::New);
+  RegisterDevice("VirtualDecimator", "vtkPlusVirtualDecimator", (PointerToDevice)&vtkPlusVirtualDecimator::New);
+  RegisterDevice("VirtualImageResizer", "vtkPlusVirtualImageResizer", (PointerToDevice)&vtkPlusVirtualImageResizer::New);
+  RegisterDevice("VirtualPipeline", "vtkPlusVirtualPipeline", (PointerToDevice)&vtkPlusVirtualPipeline::New);
+  RegisterDevice("VirtualPoseFusion", "vtkPlusVirtualPoseFusion", (PointerToDevice)&vtkPlusVirtualPoseFusion::New);
+  RegisterDevice("VirtualPosePredictor", "vtkPlusVirtualPosePredictor", (PointerToDevice)&vtkPlusVirtualPosePredictor::New);
+#ifdef PLUS_USE_OpenIGTLink
+  RegisterDevice("VirtualVideoEncoder", "vtkPlusVirtualVideoEncoder", (PointerToDevice)&vtkPlusVirtualVideoEncoder::New);
+#endif
+
+  this->RegisterDevicePlugins();
 }
 
 //----------------------------------------------------------------------------
@@ -438,6 +565,11 @@ void vtkPlusDeviceFactory::PrintAvailableDevices(ostream& os, vtkIndent indent)
       device = NULL;
     }
   }
+  // The modules of the plugin devices are not loaded just to print their SDK version
+  for (std::map<std::string, std::string>::iterator pluginIt = DevicePluginModules.begin(); pluginIt != DevicePluginModules.end(); ++pluginIt)
+  {
+    os << indent.GetNextIndent() << "- " << pluginIt->first << " (plugin: " << pluginIt->second << ")" << std::endl;
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -455,23 +587,25 @@ PlusStatus vtkPlusDeviceFactory::CreateInstance(const char* aDeviceType, vtkPlus
     return PLUS_FAIL;
   }
 
+  if (DeviceTypes.find(aDeviceType) == DeviceTypes.end() && DevicePluginModules.find(aDeviceType) != DevicePluginModules.end())
+  {
+    if (this->LoadDevicePlugin(aDeviceType) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+  }
+
   if (DeviceTypes.find(aDeviceType) == DeviceTypes.end())
   {
     std::string listOfSupportedDevices;
-    std::map<std::string, PointerToDevice>::iterator it;
-    for (it = DeviceTypes.begin(); it != DeviceTypes.end(); ++it)
+    std::map<std::string, std::string>::iterator it;
+    for (it = DeviceTypeClassNames.begin(); it != DeviceTypeClassNames.end(); ++it)
     {
-      if (it->second != NULL)
+      if (!listOfSupportedDevices.empty())
       {
-        vtkPlusDevice* device = (*it->second)();
-        if (!listOfSupportedDevices.empty())
-        {
-          listOfSupportedDevices.append(", ");
-        }
-        listOfSupportedDevices.append(it->first);
-        device->Delete();
-        device = NULL;
+        listOfSupportedDevices.append(", ");
       }
+      listOfSupportedDevices.append(it->first);
     }
     LOG_ERROR("Unknown device type: " << aDeviceType << ". Supported devices: " << listOfSupportedDevices);
     return PLUS_FAIL;
@@ -530,3 +664,86 @@ void vtkPlusDeviceFactory::RegisterDevice(const std::string& deviceTypeName, con
   vtkPlusDeviceFactory::DeviceTypes[deviceTypeName] = constructionMethod;
   vtkPlusDeviceFactory::DeviceTypeClassNames[deviceTypeName] = deviceClassName;
 }
+
+//----------------------------------------------------------------------------
+void vtkPlusDeviceFactory::AddDevicePluginDirectory(const std::string& directory)
+{
+  DevicePluginRegistry& registry = GetDevicePluginRegistry();
+  std::lock_guard<std::mutex> lock(registry.Mutex);
+  registry.AdditionalDirectories.push_back(directory);
+  registry.DirectoriesScanned = false;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusDeviceFactory::RegisterDevicePlugins()
+{
+  DevicePluginRegistry& registry = GetDevicePluginRegistry();
+  std::lock_guard<std::mutex> lock(registry.Mutex);
+  ScanDevicePluginDirectories(registry);
+  for (std::map<std::string, DevicePluginRegistry::PluginDevice>::iterator it = registry.Devices.begin(); it != registry.Devices.end(); ++it)
+  {
+    // Devices that are built into the library take precedence
+    if (DeviceTypes.find(it->first) != DeviceTypes.end())
+    {
+      continue;
+    }
+    DevicePluginModules[it->first] = it->second.ModulePath;
+    DeviceTypeClassNames[it->first] = it->second.ClassName;
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusDeviceFactory::LoadDevicePlugin(const std::string& deviceTypeName)
+{
+  std::string modulePath = DevicePluginModules[deviceTypeName];
+  PlusRegisterDevicePluginFunction registerFunction = NULL;
+  {
+    DevicePluginRegistry& registry = GetDevicePluginRegistry();
+    std::lock_guard<std::mutex> lock(registry.Mutex);
+    std::map<std::string, PlusRegisterDevicePluginFunction>::iterator moduleIt = registry.LoadedModules.find(modulePath);
+    if (moduleIt != registry.LoadedModules.end())
+    {
+      registerFunction = moduleIt->second;
+    }
+    else
+    {
+      vtksys::DynamicLoader::LibraryHandle module = vtksys::DynamicLoader::OpenLibrary(modulePath);
+      if (module == NULL)
+      {
+        LOG_ERROR("Failed to load the device plugin module " << modulePath << " of device type " << deviceTypeName << ": " << vtksys::DynamicLoader::LastError());
+        return PLUS_FAIL;
+      }
+      registerFunction = reinterpret_cast<PlusRegisterDevicePluginFunction>(vtksys::DynamicLoader::GetSymbolAddress(module, PLUS_DEVICE_PLUGIN_REGISTER_FUNCTION_NAME));
+      if (registerFunction == NULL)
+      {
+        LOG_ERROR("Invalid device plugin module " << modulePath << ": " << PLUS_DEVICE_PLUGIN_REGISTER_FUNCTION_NAME << " function is not found");
+        vtksys::DynamicLoader::CloseLibrary(module);
+        return PLUS_FAIL;
+      }
+      registry.LoadedModules[modulePath] = registerFunction;
+      LOG_DEBUG("Loaded device plugin module " << modulePath);
+    }
+  }
+
+  registerFunction(this);
+
+  // All devices of the module are registered now
+  for (std::map<std::string, std::string>::iterator it = DevicePluginModules.begin(); it != DevicePluginModules.end();)
+  {
+    if (it->second == modulePath)
+    {
+      DevicePluginModules.erase(it++);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+
+  if (DeviceTypes.find(deviceTypeName) == DeviceTypes.end())
+  {
+    LOG_ERROR("Device plugin module " << modulePath << " does not register device type " << deviceTypeName << " that is listed in its manifest");
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
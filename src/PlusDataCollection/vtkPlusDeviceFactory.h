@@ -22,6 +22,11 @@ class vtkPlusDevice;
 
   This class is a factory class of supported trackers and video sources to localize the object creation code.
 
+  Devices that are built into plugin modules (see PlusDevicePlugin.h) are listed by the manifest files in the
+  device plugin directories, and the module of a device type is only loaded when an instance of the device type
+  is created, so that applications do not load the vendor SDKs of devices that the device set does not use.
+  Loaded modules are never unloaded, because the devices that they created may still exist.
+
   \ingroup PlusLibigsioCommon
 */
 class vtkPlusDataCollectionExport vtkPlusDeviceFactory : public vtkObject
@@ -50,6 +55,12 @@ public:
   /*! Registration function to add new devices to the factory */
   void RegisterDevice(const std::string& deviceTypeName, const std::string& deviceClassName, PointerToDevice constructionMethod);
 
+  /*!
+    Add a directory that is searched for device plugin manifests. The program directory is searched by default.
+    Applies to all factories, the directory is scanned when a factory is created next time.
+  */
+  static void AddDevicePluginDirectory(const std::string& directory);
+
 protected:
   vtkPlusDeviceFactory(void);
   virtual ~vtkPlusDeviceFactory(void);
@@ -58,6 +69,14 @@ protected:
   std::map<std::string, PointerToDevice> DeviceTypes;
   /*! Lookup map to translate factory names to C++ class names */
   std::map<std::string, std::string> DeviceTypeClassNames;
+  /*! Path of the plugin module of the device types that are not registered until their module is loaded */
+  std::map<std::string, std::string> DevicePluginModules;
+
+  /*! Register the device types that are listed by the plugin manifests, without loading the modules */
+  void RegisterDevicePlugins();
+
+  /*! Load the plugin module of a device type and register its devices */
+  PlusStatus LoadDevicePlugin(const std::string& deviceTypeName);
 
 private:
   vtkPlusDeviceFactory(const vtkPlusDeviceFactory&);
@@ -10,7 +10,17 @@ See License.txt for details.
 #include "vtkDoubleArray.h"
 #include "vtkIGSIORecursiveCriticalSection.h"
 #include "vtkTable.h"
-#include "vtkVariantArray.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+  // Identifies timestamp report files, followed by TimeStampReportRecord items
+  const char TIMESTAMP_REPORT_FILE_SIGNATURE[8] = { 'P', 'l', 'u', 's', 'T', 'S', 'R', '1' };
+}
 
 vtkStandardNewMacro(vtkPlusTimestampedCircularBuffer);
 
@@ -22,19 +32,49 @@ vtkPlusTimestampedCircularBuffer::vtkPlusTimestampedCircularBuffer()
   , CurrentTimeStamp(0.0)
   , LocalTimeOffsetSec(0.0)
   , LatestItemUid(0)
+  , LastTimeLookupUid(0)
+  , FilterSumIndex(0)
+  , FilterSumTimestamp(0)
+  , FilterSumIndexSquared(0)
+  , FilterSumIndexTimestamp(0)
+  , FilterSumTimestampSquared(0)
+  , FilterSumsReferenceIndex(0)
+  , FilterSumsReferenceTimestamp(0)
+  , FilterSumsNumberOfUpdates(0)
+  , OutlierRejectionThreshold(0)
+  , NumberOfConsecutiveOutliers(0)
   , AveragedItemsForFiltering(20)
   , MaxAllowedFilteringTimeDifference(0.5)
-  , TimeStampReportTable(NULL)
+  , TimeStampReportCapacity(100000)
+  , TimeStampReportWriteIndex(0)
+  , TimeStampReportNumberOfRecords(0)
+  , TimeStampReportNumberOfUnwrittenRecords(0)
   , TimeStampReporting(false)
   , TimeStampLogging(false)
   , StartTime(0)
   , NegligibleTimeDifferenceSec(1e-5)
+  , FramePeriodSumsNumberOfUpdates(0)
+  , NumberOfInvalidIdealFramePeriods(0)
+  , FramePeriodLastItemUid(0)
+  , FramePeriodLastItemTimestamp(0)
+  , FramePeriodLastItemIndex(0)
+  , FrameRateStatisticsWindowSec(0)
+  , ReservedBufferIndex(-1)
+  , LockFreeReads(false)
+  , ContainerReallocating(false)
+  , ActiveLockFreeContainerReaders(0)
+  , PublishedSequence(0)
+  , PublishedOldestItemUid(1)
+  , PublishedLatestItemUid(0)
+  , PublishedLatestBufferIndex(-1)
+  , NewItemCount(0)
 {
   this->BufferItemContainer.resize(0);
   this->FilterContainerIndexVector.set_size(0);
   this->FilterContainerTimestampVector.set_size(0);
   this->FilterContainersOldestIndex = 0;
   this->FilterContainersNumberOfValidElements = 0;
+  this->RecomputeFramePeriodSums();
 }
 
 //----------------------------------------------------------------------------
@@ -49,12 +89,8 @@ vtkPlusTimestampedCircularBuffer::~vtkPlusTimestampedCircularBuffer()
     this->Mutex = NULL;
   }
 
-  if (this->TimeStampReportTable != NULL)
-  {
-    this->TimeStampReportTable->Delete();
-    this->TimeStampReportTable = NULL;
-  }
-
+  std::lock_guard<std::mutex> reportLock(this->TimeStampReportMutex);
+  this->WriteTimeStampReportRecords();
 }
 
 //----------------------------------------------------------------------------
@@ -67,6 +103,8 @@ void vtkPlusTimestampedCircularBuffer::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "CurrentTimeStamp: " << this->CurrentTimeStamp << "\n";
   os << indent << "Local time offset: " << this->LocalTimeOffsetSec << "\n";
   os << indent << "Latest Item Uid: " << this->LatestItemUid << "\n";
+  os << indent << "Lock-free reads: " << (this->LockFreeReads ? "enabled" : "disabled") << "\n";
+  os << indent << "Frame rate statistics window: " << this->FrameRateStatisticsWindowSec << " sec\n";
 }
 
 //----------------------------------------------------------------------------
@@ -79,11 +117,21 @@ PlusStatus vtkPlusTimestampedCircularBuffer::PrepareForNewItem(const double time
     LOG_DEBUG("Need to skip newly added frame - new timestamp (" << std::fixed << timestamp << ") is not newer than the last one (" << this->CurrentTimeStamp << ")!");
     return PLUS_FAIL;
   }
+  if (this->ReservedBufferIndex >= 0 && this->ReservedBufferIndex != this->WritePointer)
+  {
+    // Nothing is changed, so the UID of the latest item remains valid
+    LOG_ERROR("Reserved buffer item " << this->ReservedBufferIndex << " was overwritten - items must not be added while an item is reserved!");
+    this->ReservedBufferIndex = -1;
+    return PLUS_FAIL;
+  }
 
   // Increase frame unique ID
   newFrameUid = ++this->LatestItemUid;
   bufferIndex = this->WritePointer;
   this->CurrentTimeStamp = timestamp;
+  // if a slot was reserved then it is the one at the write pointer, the new item is stored there
+  this->ReservedBufferIndex = -1;
+  this->FilteredTimestampIndex[bufferIndex] = timestamp;
 
   this->NumberOfItems++;
   if (this->NumberOfItems > this->GetBufferSize())
@@ -96,9 +144,299 @@ PlusStatus vtkPlusTimestampedCircularBuffer::PrepareForNewItem(const double time
     this->WritePointer = 0;
   }
 
+  if (this->LockFreeReads)
+  {
+    // Publish the previous item and hide the slot that is about to be overwritten from lock-free readers
+    int previousBufferIndex = bufferIndex - 1;
+    if (previousBufferIndex < 0)
+    {
+      previousBufferIndex += this->GetBufferSize();
+    }
+    this->WritePublishedState(newFrameUid - (this->NumberOfItems - 1), newFrameUid - 1, previousBufferIndex);
+  }
+
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTimestampedCircularBuffer::ReserveNewItem(int& bufferIndex)
+{
+  igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
+  bufferIndex = -1;
+
+  if (this->GetBufferSize() <= 0)
+  {
+    LOG_ERROR("Failed to reserve buffer item - buffer size is " << this->GetBufferSize());
+    return PLUS_FAIL;
+  }
+  if (this->ReservedBufferIndex >= 0)
+  {
+    LOG_ERROR("Failed to reserve buffer item - buffer item " << this->ReservedBufferIndex << " is already reserved");
+    return PLUS_FAIL;
+  }
+
+  if (this->NumberOfItems >= this->GetBufferSize())
+  {
+    // The slot at the write pointer contains the oldest item, it will be overwritten,
+    // therefore it has to be removed from the buffer before the caller starts writing into it
+    this->NumberOfItems = this->GetBufferSize() - 1;
+    if (this->LockFreeReads)
+    {
+      this->PublishCurrentState();
+    }
+  }
+
+  this->ReservedBufferIndex = this->WritePointer;
+  bufferIndex = this->ReservedBufferIndex;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::CancelReservedItem()
+{
+  igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
+  this->ReservedBufferIndex = -1;
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusTimestampedCircularBuffer::GetReservedBufferIndex()
+{
+  igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
+  return this->ReservedBufferIndex;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::PublishNewItem(const BufferItemUidType uid)
+{
+  // the caller must have locked the buffer
+  this->AddToFramePeriodStatistics(uid);
+
+  if (this->LockFreeReads && uid == this->LatestItemUid)
+  {
+    this->PublishCurrentState();
+  }
+
+  // wake up threads that are waiting for a new item
+  {
+    std::lock_guard<std::mutex> newItemLock(this->NewItemMutex);
+    this->NewItemCount++;
+  }
+  this->NewItemCondition.notify_all();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTimestampedCircularBuffer::WaitForItemNewerThan(double timestamp, double timeoutSec)
+{
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now()
+      + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(std::max(timeoutSec, 0.0)));
+  std::unique_lock<std::mutex> newItemLock(this->NewItemMutex);
+  while (true)
+  {
+    // The buffer must not be locked while NewItemMutex is held (the writer locks them in the opposite order),
+    // therefore the item count is saved and the latest timestamp is checked without holding NewItemMutex.
+    unsigned long itemCountBeforeCheck = this->NewItemCount;
+    newItemLock.unlock();
+    double latestTimestamp(0);
+    if (this->GetLatestTimeStamp(latestTimestamp) == ITEM_OK && latestTimestamp > timestamp)
+    {
+      return PLUS_SUCCESS;
+    }
+    newItemLock.lock();
+    if (!this->NewItemCondition.wait_until(newItemLock, deadline, [this, itemCountBeforeCheck] { return this->NewItemCount != itemCountBeforeCheck; }))
+    {
+      return PLUS_FAIL;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::SetLockFreeReads(bool enable)
+{
+  igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
+  if (this->LockFreeReads == enable)
+  {
+    return;
+  }
+  this->PublishCurrentState();
+  this->LockFreeReads = enable;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusTimestampedCircularBuffer::BeginLockFreeContainerRead()
+{
+  // The reader registers itself before checking the flag and the writer sets the flag before checking the readers
+  // (both sequentially consistent), so either the reader sees the reallocation or the writer waits for the reader
+  this->ActiveLockFreeContainerReaders++;
+  if (this->ContainerReallocating)
+  {
+    this->ActiveLockFreeContainerReaders--;
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::EndLockFreeContainerRead()
+{
+  this->ActiveLockFreeContainerReaders--;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::BeginContainerReallocation()
+{
+  // the caller must have locked the buffer
+  this->ContainerReallocating = true;
+  while (this->ActiveLockFreeContainerReaders > 0)
+  {
+    // lock-free reads only take a few instructions
+    std::this_thread::yield();
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::EndContainerReallocation()
+{
+  // the caller must have locked the buffer
+  this->ContainerReallocating = false;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::PublishCurrentState()
+{
+  // the caller must have locked the buffer
+  int latestBufferIndex = this->WritePointer - 1;
+  if (latestBufferIndex < 0)
+  {
+    latestBufferIndex += this->GetBufferSize();
+  }
+  // LatestItemUid - ( NumberOfItems - 1 ) is the oldest element in the buffer
+  this->WritePublishedState(this->LatestItemUid - (this->NumberOfItems - 1), this->LatestItemUid, latestBufferIndex);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::WritePublishedState(BufferItemUidType oldestUid, BufferItemUidType latestUid, int latestBufferIndex)
+{
+  // the caller must have locked the buffer, so there is only one writer at a time
+  unsigned int sequence = this->PublishedSequence.load(std::memory_order_relaxed);
+  // odd sequence number tells the readers that the state is being modified
+  this->PublishedSequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  this->PublishedOldestItemUid.store(oldestUid, std::memory_order_relaxed);
+  this->PublishedLatestItemUid.store(latestUid, std::memory_order_relaxed);
+  this->PublishedLatestBufferIndex.store(latestBufferIndex, std::memory_order_relaxed);
+  this->PublishedSequence.store(sequence + 2, std::memory_order_release);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::ReadPublishedState(BufferItemUidType& oldestUid, BufferItemUidType& latestUid, int& latestBufferIndex) const
+{
+  for (;;)
+  {
+    unsigned int sequenceBefore = this->PublishedSequence.load(std::memory_order_acquire);
+    if (sequenceBefore & 1)
+    {
+      // the writer is updating the state, it only takes a few instructions
+      continue;
+    }
+    oldestUid = this->PublishedOldestItemUid.load(std::memory_order_relaxed);
+    latestUid = this->PublishedLatestItemUid.load(std::memory_order_relaxed);
+    latestBufferIndex = this->PublishedLatestBufferIndex.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (this->PublishedSequence.load(std::memory_order_relaxed) == sequenceBefore)
+    {
+      return;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTimestampedCircularBuffer::GetPublishedItemTimeStamp(const BufferItemUidType uid, bool useOldestItem, bool filtered, double& timestamp)
+{
+  for (;;)
+  {
+    unsigned int sequenceBefore = this->PublishedSequence.load(std::memory_order_acquire);
+    if (sequenceBefore & 1)
+    {
+      continue;
+    }
+    BufferItemUidType oldestUid = this->PublishedOldestItemUid.load(std::memory_order_relaxed);
+    BufferItemUidType latestUid = this->PublishedLatestItemUid.load(std::memory_order_relaxed);
+    int latestBufferIndex = this->PublishedLatestBufferIndex.load(std::memory_order_relaxed);
+    BufferItemUidType requestedUid = useOldestItem ? oldestUid : uid;
+
+    ItemStatus status = ITEM_OK;
+    timestamp = 0;
+    if (requestedUid < oldestUid)
+    {
+      status = ITEM_NOT_AVAILABLE_ANYMORE;
+    }
+    else if (requestedUid > latestUid)
+    {
+      status = ITEM_NOT_AVAILABLE_YET;
+    }
+    else
+    {
+      int bufferIndex = latestBufferIndex - static_cast<int>(latestUid - requestedUid);
+      if (bufferIndex < 0)
+      {
+        bufferIndex += this->BufferItemContainer.size();
+      }
+      StreamBufferItem& item = this->BufferItemContainer[bufferIndex];
+      timestamp = filtered ? item.GetFilteredTimestamp(this->LocalTimeOffsetSec) : item.GetUnfilteredTimestamp(this->LocalTimeOffsetSec);
+    }
+
+    // If the writer has published a new state meanwhile then the item may have been overwritten while we read it
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (this->PublishedSequence.load(std::memory_order_relaxed) == sequenceBefore)
+    {
+      return status;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTimestampedCircularBuffer::GetPublishedItemIndex(const BufferItemUidType uid, unsigned long& index)
+{
+  for (;;)
+  {
+    unsigned int sequenceBefore = this->PublishedSequence.load(std::memory_order_acquire);
+    if (sequenceBefore & 1)
+    {
+      continue;
+    }
+    BufferItemUidType oldestUid = this->PublishedOldestItemUid.load(std::memory_order_relaxed);
+    BufferItemUidType latestUid = this->PublishedLatestItemUid.load(std::memory_order_relaxed);
+    int latestBufferIndex = this->PublishedLatestBufferIndex.load(std::memory_order_relaxed);
+
+    ItemStatus status = ITEM_OK;
+    index = 0;
+    if (uid < oldestUid)
+    {
+      status = ITEM_NOT_AVAILABLE_ANYMORE;
+    }
+    else if (uid > latestUid)
+    {
+      status = ITEM_NOT_AVAILABLE_YET;
+    }
+    else
+    {
+      int bufferIndex = latestBufferIndex - static_cast<int>(latestUid - uid);
+      if (bufferIndex < 0)
+      {
+        bufferIndex += this->BufferItemContainer.size();
+      }
+      index = this->BufferItemContainer[bufferIndex].GetIndex();
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (this->PublishedSequence.load(std::memory_order_relaxed) == sequenceBefore)
+    {
+      return status;
+    }
+  }
+}
+
 //----------------------------------------------------------------------------
 // Sets the buffer size, and copies the maximum number of the most current old
 // frames and timestamps
@@ -117,6 +455,8 @@ PlusStatus vtkPlusTimestampedCircularBuffer::SetBufferSize(int newBufferSize)
     return PLUS_SUCCESS;
   }
 
+  this->BeginContainerReallocation();
+
   if (this->GetBufferSize() == 0)
   {
     for (int i = 0; i < newBufferSize; i++)
@@ -161,6 +501,16 @@ PlusStatus vtkPlusTimestampedCircularBuffer::SetBufferSize(int newBufferSize)
     this->NumberOfItems = this->GetBufferSize();
   }
 
+  // the slots are moved, so a reservation would not point to the next item anymore
+  this->ReservedBufferIndex = -1;
+  this->RebuildFilteredTimestampIndex();
+
+  if (this->LockFreeReads)
+  {
+    this->PublishCurrentState();
+  }
+  this->EndContainerReallocation();
+
   this->Modified();
 
   return PLUS_SUCCESS;
@@ -209,6 +559,12 @@ StreamBufferItem* vtkPlusTimestampedCircularBuffer::GetBufferItemPointerFromBuff
 //----------------------------------------------------------------------------
 ItemStatus vtkPlusTimestampedCircularBuffer::GetFilteredTimeStamp(const BufferItemUidType uid, double& filteredTimestamp)
 {
+  if (this->LockFreeReads && this->BeginLockFreeContainerRead())
+  {
+    ItemStatus status = this->GetPublishedItemTimeStamp(uid, false, true, filteredTimestamp);
+    this->EndLockFreeContainerRead();
+    return status;
+  }
   igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
   StreamBufferItem* itemPtr = NULL;
   ItemStatus status = GetBufferItemPointerFromUid(uid, itemPtr);
@@ -224,6 +580,12 @@ ItemStatus vtkPlusTimestampedCircularBuffer::GetFilteredTimeStamp(const BufferIt
 //----------------------------------------------------------------------------
 ItemStatus vtkPlusTimestampedCircularBuffer::GetUnfilteredTimeStamp(const BufferItemUidType uid, double& unfilteredTimestamp)
 {
+  if (this->LockFreeReads && this->BeginLockFreeContainerRead())
+  {
+    ItemStatus status = this->GetPublishedItemTimeStamp(uid, false, false, unfilteredTimestamp);
+    this->EndLockFreeContainerRead();
+    return status;
+  }
   igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
   StreamBufferItem* itemPtr = NULL;
   ItemStatus status = GetBufferItemPointerFromUid(uid, itemPtr);
@@ -275,6 +637,12 @@ bool vtkPlusTimestampedCircularBuffer::GetLatestItemHasValidFieldData()
 //----------------------------------------------------------------------------
 ItemStatus vtkPlusTimestampedCircularBuffer::GetIndex(const BufferItemUidType uid, unsigned long& index)
 {
+  if (this->LockFreeReads && this->BeginLockFreeContainerRead())
+  {
+    ItemStatus status = this->GetPublishedItemIndex(uid, index);
+    this->EndLockFreeContainerRead();
+    return status;
+  }
   igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
   StreamBufferItem* itemPtr = NULL;
   ItemStatus status = GetBufferItemPointerFromUid(uid, itemPtr);
@@ -310,12 +678,41 @@ ItemStatus vtkPlusTimestampedCircularBuffer::GetBufferIndexFromTime(const double
 }
 
 //----------------------------------------------------------------------------
-// do a simple divide-and-conquer search for the transform
-// that best matches the given timestamp
+double vtkPlusTimestampedCircularBuffer::GetIndexedTimeStamp(const BufferItemUidType uid) const
+{
+  // the caller must have locked the buffer
+  int bufferIndex = (this->WritePointer - 1) - (this->LatestItemUid - uid);
+  if (bufferIndex < 0)
+  {
+    bufferIndex += this->FilteredTimestampIndex.size();
+  }
+  return this->FilteredTimestampIndex[bufferIndex];
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::RebuildFilteredTimestampIndex()
+{
+  // the caller must have locked the buffer
+  this->FilteredTimestampIndex.resize(this->BufferItemContainer.size());
+  for (unsigned int i = 0; i < this->BufferItemContainer.size(); ++i)
+  {
+    this->FilteredTimestampIndex[i] = this->BufferItemContainer[i].GetFilteredTimestamp(0.0);
+  }
+}
+
+//----------------------------------------------------------------------------
+// Find the item that best matches the given timestamp. First the previous result and the latest item
+// are checked, because most requests are for the same or the next item, and if they don't match then
+// a binary search is performed in the timestamp index.
 ItemStatus vtkPlusTimestampedCircularBuffer::GetItemUidFromTime(const double time, BufferItemUidType& uid)
 {
   igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
 
+  if (this->NumberOfItems < 1)
+  {
+    return ITEM_NOT_AVAILABLE_YET;
+  }
+
   if (this->NumberOfItems == 1)
   {
     // There is only one item, it's the closest one to any timestamp
@@ -323,64 +720,71 @@ ItemStatus vtkPlusTimestampedCircularBuffer::GetItemUidFromTime(const double tim
     return ITEM_OK;
   }
 
+  // Timestamps are stored in local time in the index
+  const double localTime = time - this->LocalTimeOffsetSec;
+
   BufferItemUidType lo = this->LatestItemUid - (this->NumberOfItems - 1);   // oldest item UID
   BufferItemUidType hi = this->LatestItemUid; // latest item UID
-
-  // minimum time
-  // This method is called often, therefore instead of calling this->GetTimeStamp(lo, tlo) we perform low-level operations to get the timestamp
-  int loBufferIndex = (this->WritePointer - 1) - (this->LatestItemUid - lo);
-  if (loBufferIndex < 0)
-  {
-    loBufferIndex += this->BufferItemContainer.size();
-  }
-  double tlo = this->BufferItemContainer[loBufferIndex].GetFilteredTimestamp(this->LocalTimeOffsetSec);
-
-  // This method is called often, therefore instead of calling this->GetTimeStamp(hi, thi) we perform low-level operations to get the timestamp
-  int hiBufferIndex = (this->WritePointer - 1) - (this->LatestItemUid - hi);
-  if (hiBufferIndex < 0)
-  {
-    hiBufferIndex += this->BufferItemContainer.size();
-  }
-  double thi = this->BufferItemContainer[hiBufferIndex].GetFilteredTimestamp(this->LocalTimeOffsetSec);
+  double tlo = this->GetIndexedTimeStamp(lo);
+  double thi = this->GetIndexedTimeStamp(hi);
 
   // If the timestamp is slightly out of range then still accept it
   // (due to errors in conversions there could be slight differences)
-  if (time < tlo - this->NegligibleTimeDifferenceSec)
+  if (localTime < tlo - this->NegligibleTimeDifferenceSec)
   {
     return ITEM_NOT_AVAILABLE_ANYMORE;
   }
-  else if (time > thi + this->NegligibleTimeDifferenceSec)
+  else if (localTime > thi + this->NegligibleTimeDifferenceSec)
   {
     return ITEM_NOT_AVAILABLE_YET;
   }
 
-  for (;;)
+  // Try to narrow the search range to the neighbors of the latest item or the previously found item
+  double tBeforeLatest = this->GetIndexedTimeStamp(hi - 1);
+  if (localTime >= tBeforeLatest)
+  {
+    lo = hi - 1;
+    tlo = tBeforeLatest;
+  }
+  else if (this->LastTimeLookupUid > lo && this->LastTimeLookupUid < hi)
   {
-    if (hi - lo <= 1)
+    BufferItemUidType cursor = this->LastTimeLookupUid;
+    double tCursor = this->GetIndexedTimeStamp(cursor);
+    if (localTime >= tCursor)
     {
-      if (time - tlo > thi - time)
+      double tAfterCursor = this->GetIndexedTimeStamp(cursor + 1);
+      if (localTime <= tAfterCursor)
       {
-        uid = hi;
-        return ITEM_OK;
+        lo = cursor;
+        tlo = tCursor;
+        hi = cursor + 1;
+        thi = tAfterCursor;
       }
       else
       {
-        uid = lo;
-        return ITEM_OK;
+        lo = cursor;
+        tlo = tCursor;
       }
     }
-
-    int mid = (lo + hi) / 2;
-
-    // This is a hot loop, therefore instead of calling this->GetTimeStamp(mid, tmid) we perform low-level operations to get the timestamp
-    int midBufferIndex = (this->WritePointer - 1) - (this->LatestItemUid - mid);
-    if (midBufferIndex < 0)
+    else
     {
-      midBufferIndex += this->BufferItemContainer.size();
+      double tBeforeCursor = this->GetIndexedTimeStamp(cursor - 1);
+      if (localTime >= tBeforeCursor)
+      {
+        lo = cursor - 1;
+        tlo = tBeforeCursor;
+      }
+      hi = cursor;
+      thi = tCursor;
     }
-    double tmid = this->BufferItemContainer[midBufferIndex].GetFilteredTimestamp(this->LocalTimeOffsetSec);
+  }
 
-    if (time < tmid)
+  // Binary search between lo and hi
+  while (hi - lo > 1)
+  {
+    BufferItemUidType mid = lo + (hi - lo) / 2;
+    double tmid = this->GetIndexedTimeStamp(mid);
+    if (localTime < tmid)
     {
       hi = mid;
       thi = tmid;
@@ -392,6 +796,9 @@ ItemStatus vtkPlusTimestampedCircularBuffer::GetItemUidFromTime(const double tim
     }
   }
 
+  uid = (localTime - tlo > thi - localTime) ? hi : lo;
+  this->LastTimeLookupUid = uid;
+  return ITEM_OK;
 }
 
 //----------------------------------------------------------------------------
@@ -399,6 +806,7 @@ void vtkPlusTimestampedCircularBuffer::DeepCopy(vtkPlusTimestampedCircularBuffer
 {
   buffer->Lock();
   this->Lock();
+  this->BeginContainerReallocation();
   this->WritePointer = buffer->WritePointer;
   this->NumberOfItems = buffer->NumberOfItems;
   this->CurrentTimeStamp = buffer->CurrentTimeStamp;
@@ -410,8 +818,30 @@ void vtkPlusTimestampedCircularBuffer::DeepCopy(vtkPlusTimestampedCircularBuffer
   this->FilterContainersOldestIndex = buffer->FilterContainersOldestIndex;
   this->FilterContainerTimestampVector = buffer->FilterContainerTimestampVector;
   this->FilterContainerIndexVector = buffer->FilterContainerIndexVector;
+  this->OutlierRejectionThreshold = buffer->OutlierRejectionThreshold;
+  this->NumberOfConsecutiveOutliers = buffer->NumberOfConsecutiveOutliers;
+  this->RecomputeFilterSums();
 
   this->BufferItemContainer = buffer->BufferItemContainer;
+  this->FilteredTimestampIndex = buffer->FilteredTimestampIndex;
+  this->LastTimeLookupUid = buffer->LastTimeLookupUid;
+  this->FramePeriodSamples = buffer->FramePeriodSamples;
+  for (int periodType = 0; periodType < NUMBER_OF_FRAME_PERIOD_TYPES; ++periodType)
+  {
+    this->FramePeriodMinimumCandidates[periodType] = buffer->FramePeriodMinimumCandidates[periodType];
+    this->FramePeriodMaximumCandidates[periodType] = buffer->FramePeriodMaximumCandidates[periodType];
+  }
+  this->NumberOfInvalidIdealFramePeriods = buffer->NumberOfInvalidIdealFramePeriods;
+  this->FramePeriodLastItemUid = buffer->FramePeriodLastItemUid;
+  this->FramePeriodLastItemTimestamp = buffer->FramePeriodLastItemTimestamp;
+  this->FramePeriodLastItemIndex = buffer->FramePeriodLastItemIndex;
+  this->FrameRateStatisticsWindowSec = buffer->FrameRateStatisticsWindowSec;
+  this->RecomputeFramePeriodSums();
+  if (this->LockFreeReads)
+  {
+    this->PublishCurrentState();
+  }
+  this->EndContainerReallocation();
   this->Unlock();
   buffer->Unlock();
 }
@@ -424,103 +854,232 @@ void vtkPlusTimestampedCircularBuffer::Clear()
   this->NumberOfItems = 0;
   this->CurrentTimeStamp = 0;
   this->LatestItemUid = 0;
+  this->ReservedBufferIndex = -1;
+  this->ClearFramePeriodStatistics();
+  if (this->LockFreeReads)
+  {
+    this->PublishCurrentState();
+  }
   this->Unlock();
 }
 
 //----------------------------------------------------------------------------
 double vtkPlusTimestampedCircularBuffer::GetFrameRate(bool ideal /*=false*/, double* framePeriodStdevSecPtr /* =NULL */)
 {
-  // TODO: Start the frame rate computation from the latest frame UID with using a few seconds of items in the buffer
-  bool cannotComputeIdealFrameRateDueToInvalidFrameNumbers = false;
+  igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
 
-  std::vector<double> framePeriods;
-  for (BufferItemUidType frame = this->GetLatestItemUidInBuffer(); frame > this->GetOldestItemUidInBuffer(); --frame)
+  FramePeriodStatistics statistics;
+  if (this->GetFramePeriodStatistics(ideal, statistics) != PLUS_SUCCESS)
   {
-    double time(0);
-    if (this->GetTimeStamp(frame, time) != ITEM_OK)
-    {
-      continue;
-    }
+    LOG_WARNING("Failed to compute frame rate. Not enough samples.");
+    return 0;
+  }
 
-    unsigned long framenum(0);
-    if (this->GetIndex(frame, framenum) != ITEM_OK)
-    {
-      continue;
-    }
+  if (ideal && this->NumberOfInvalidIdealFramePeriods > 0)
+  {
+    LOG_WARNING("Cannot compute ideal frame rate acurately, as frame numbers are invalid or missing");
+  }
 
-    double prevtime(0);
-    if (this->GetTimeStamp(frame - 1, prevtime) != ITEM_OK)
-    {
-      continue;
-    }
+  double frameRate(0);
+  if (statistics.MeanSec != 0)
+  {
+    frameRate = 1.0 / statistics.MeanSec;
+  }
+
+  if (framePeriodStdevSecPtr != NULL)
+  {
+    (*framePeriodStdevSecPtr) = statistics.StdevSec;
+  }
+
+  return frameRate;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTimestampedCircularBuffer::GetFramePeriodStatistics(bool ideal, FramePeriodStatistics& statistics)
+{
+  igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
+
+  // the buffer may have been shrunk or the oldest item may have been removed by ReserveNewItem since the last item was added
+  this->RemoveExpiredFramePeriods();
 
-    unsigned long prevframenum(0);
-    if (this->GetIndex(frame - 1, prevframenum) != ITEM_OK)
+  statistics = FramePeriodStatistics();
+  if (this->FramePeriodSamples.empty())
+  {
+    return PLUS_FAIL;
+  }
+
+  const int periodType = ideal ? FRAME_PERIOD_IDEAL : FRAME_PERIOD_ACTUAL;
+  statistics.NumberOfSamples = this->FramePeriodSamples.size();
+  statistics.MeanSec = this->FramePeriodSum[periodType] / statistics.NumberOfSamples;
+  // stdev = sqrt ( 1/N * sum[ (xi-mean)^2 ] ) = sqrt ( 1/N * sum[ xi^2 ] - mean^2 )
+  double variance = this->FramePeriodSumSquared[periodType] / statistics.NumberOfSamples - statistics.MeanSec * statistics.MeanSec;
+  statistics.StdevSec = (variance > 0) ? sqrt(variance) : 0.0;
+  statistics.MinimumSec = this->FramePeriodMinimumCandidates[periodType].front().second;
+  statistics.MaximumSec = this->FramePeriodMaximumCandidates[periodType].front().second;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::AddToFramePeriodStatistics(const BufferItemUidType uid)
+{
+  // the caller must have locked the buffer
+  StreamBufferItem* item = NULL;
+  if (uid != this->LatestItemUid || this->GetBufferItemPointerFromUid(uid, item) != ITEM_OK)
+  {
+    return;
+  }
+  const double timestamp = this->GetIndexedTimeStamp(uid);
+  const unsigned long index = item->GetIndex();
+
+  if (this->FramePeriodLastItemUid != 0 && this->FramePeriodLastItemUid == uid - 1)
+  {
+    FramePeriodSample sample;
+    sample.Uid = uid;
+    sample.Timestamp = timestamp;
+    sample.PeriodSec[FRAME_PERIOD_ACTUAL] = timestamp - this->FramePeriodLastItemTimestamp;
+    sample.PeriodSec[FRAME_PERIOD_IDEAL] = sample.PeriodSec[FRAME_PERIOD_ACTUAL];
+    int frameDiff = index - this->FramePeriodLastItemIndex;
+    sample.IdealPeriodValid = (frameDiff > 0);
+    if (sample.IdealPeriodValid)
     {
-      continue;
+      sample.PeriodSec[FRAME_PERIOD_IDEAL] /= (1.0 * frameDiff);
     }
+    // else: the same frame number was set for different frame indexes; this should not happen (probably no frame number is available),
+    // the actual period is used as ideal period
 
-    double frameperiod = (time - prevtime);
-    int frameDiff = framenum - prevframenum;
-
-    if (ideal)
+    if (sample.PeriodSec[FRAME_PERIOD_ACTUAL] > 0)
     {
-      if (frameDiff > 0)
+      this->FramePeriodSamples.push_back(sample);
+      for (int periodType = 0; periodType < NUMBER_OF_FRAME_PERIOD_TYPES; ++periodType)
       {
-        frameperiod /= (1.0 * frameDiff);
+        const double periodSec = sample.PeriodSec[periodType];
+        this->FramePeriodSum[periodType] += periodSec;
+        this->FramePeriodSumSquared[periodType] += periodSec * periodSec;
+        std::deque< std::pair<BufferItemUidType, double> >& minimumCandidates = this->FramePeriodMinimumCandidates[periodType];
+        while (!minimumCandidates.empty() && minimumCandidates.back().second >= periodSec)
+        {
+          minimumCandidates.pop_back();
+        }
+        minimumCandidates.push_back(std::make_pair(uid, periodSec));
+        std::deque< std::pair<BufferItemUidType, double> >& maximumCandidates = this->FramePeriodMaximumCandidates[periodType];
+        while (!maximumCandidates.empty() && maximumCandidates.back().second <= periodSec)
+        {
+          maximumCandidates.pop_back();
+        }
+        maximumCandidates.push_back(std::make_pair(uid, periodSec));
       }
-      else
+      if (!sample.IdealPeriodValid)
       {
-        // the same frame number was set for different frame indexes; this should not happen (probably no frame number is available)
-        cannotComputeIdealFrameRateDueToInvalidFrameNumbers = true;
+        this->NumberOfInvalidIdealFramePeriods++;
       }
+      this->FramePeriodSumsNumberOfUpdates++;
     }
+  }
 
-    if (frameperiod > 0)
+  this->FramePeriodLastItemUid = uid;
+  this->FramePeriodLastItemTimestamp = timestamp;
+  this->FramePeriodLastItemIndex = index;
+
+  this->RemoveExpiredFramePeriods();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::RemoveExpiredFramePeriods()
+{
+  // the caller must have locked the buffer
+  // a frame period can be used while both of its items are in the buffer
+  const BufferItemUidType oldestUid = this->LatestItemUid - (this->NumberOfItems - 1);
+  const bool useTimeWindow = (this->FrameRateStatisticsWindowSec > 0);
+  const double oldestTimestamp = this->CurrentTimeStamp - this->FrameRateStatisticsWindowSec;
+  bool removed = false;
+  while (!this->FramePeriodSamples.empty())
+  {
+    const FramePeriodSample& sample = this->FramePeriodSamples.front();
+    if (this->NumberOfItems > 0 && sample.Uid - 1 >= oldestUid && (!useTimeWindow || sample.Timestamp >= oldestTimestamp))
+    {
+      break;
+    }
+    for (int periodType = 0; periodType < NUMBER_OF_FRAME_PERIOD_TYPES; ++periodType)
+    {
+      this->FramePeriodSum[periodType] -= sample.PeriodSec[periodType];
+      this->FramePeriodSumSquared[periodType] -= sample.PeriodSec[periodType] * sample.PeriodSec[periodType];
+    }
+    if (!sample.IdealPeriodValid)
     {
-      framePeriods.push_back(frameperiod);
+      this->NumberOfInvalidIdealFramePeriods--;
     }
+    this->FramePeriodSamples.pop_front();
+    this->FramePeriodSumsNumberOfUpdates++;
+    removed = true;
   }
 
-  if (cannotComputeIdealFrameRateDueToInvalidFrameNumbers)
+  if (!removed)
   {
-    LOG_WARNING("Cannot compute ideal frame rate acurately, as frame numbers are invalid or missing");
+    return;
   }
 
-  const int numberOfFramePeriods =  framePeriods.size();
-  if (numberOfFramePeriods < 1)
+  if (this->FramePeriodSamples.empty())
   {
-    LOG_WARNING("Failed to compute frame rate. Not enough samples.");
-    return 0;
+    for (int periodType = 0; periodType < NUMBER_OF_FRAME_PERIOD_TYPES; ++periodType)
+    {
+      this->FramePeriodMinimumCandidates[periodType].clear();
+      this->FramePeriodMaximumCandidates[periodType].clear();
+    }
+    this->RecomputeFramePeriodSums();
+    return;
   }
 
-  double samplingPeriod(0);
-  for (int i = 0; i < numberOfFramePeriods; i++)
+  const BufferItemUidType oldestSampleUid = this->FramePeriodSamples.front().Uid;
+  for (int periodType = 0; periodType < NUMBER_OF_FRAME_PERIOD_TYPES; ++periodType)
   {
-    samplingPeriod += framePeriods[i];
+    while (this->FramePeriodMinimumCandidates[periodType].front().first < oldestSampleUid)
+    {
+      this->FramePeriodMinimumCandidates[periodType].pop_front();
+    }
+    while (this->FramePeriodMaximumCandidates[periodType].front().first < oldestSampleUid)
+    {
+      this->FramePeriodMaximumCandidates[periodType].pop_front();
+    }
   }
-  samplingPeriod /= 1.0 * numberOfFramePeriods;
 
-  double frameRate(0);
-  if (samplingPeriod != 0)
+  // the cost of recomputation is proportional to the number of updates since the last recomputation
+  if (this->FramePeriodSumsNumberOfUpdates > this->FramePeriodSamples.size() + 100)
   {
-    frameRate = 1.0 / samplingPeriod;
+    this->RecomputeFramePeriodSums();
   }
+}
 
-  if (framePeriodStdevSecPtr != NULL)
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::RecomputeFramePeriodSums()
+{
+  for (int periodType = 0; periodType < NUMBER_OF_FRAME_PERIOD_TYPES; ++periodType)
   {
-    // Standard deviation of sampling period
-    // stdev = sqrt ( 1/N * sum[ (xi-mean)^2 ] ) = sqrt ( 1/N * sumOfXiMeanDiffSquare )
-    double sumOfXiMeanDiffSquare = 0;
-    for (int i = 0; i < numberOfFramePeriods; i++)
+    this->FramePeriodSum[periodType] = 0;
+    this->FramePeriodSumSquared[periodType] = 0;
+    for (std::deque<FramePeriodSample>::const_iterator it = this->FramePeriodSamples.begin(); it != this->FramePeriodSamples.end(); ++it)
     {
-      sumOfXiMeanDiffSquare += (framePeriods[i] - samplingPeriod) * (framePeriods[i] - samplingPeriod);
+      this->FramePeriodSum[periodType] += it->PeriodSec[periodType];
+      this->FramePeriodSumSquared[periodType] += it->PeriodSec[periodType] * it->PeriodSec[periodType];
     }
-    double framePeriodStdev = sqrt(sumOfXiMeanDiffSquare / numberOfFramePeriods);
-    (*framePeriodStdevSecPtr) = framePeriodStdev;
   }
+  this->FramePeriodSumsNumberOfUpdates = 0;
+}
 
-  return frameRate;
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::ClearFramePeriodStatistics()
+{
+  // the caller must have locked the buffer
+  this->FramePeriodSamples.clear();
+  for (int periodType = 0; periodType < NUMBER_OF_FRAME_PERIOD_TYPES; ++periodType)
+  {
+    this->FramePeriodMinimumCandidates[periodType].clear();
+    this->FramePeriodMaximumCandidates[periodType].clear();
+  }
+  this->NumberOfInvalidIdealFramePeriods = 0;
+  this->FramePeriodLastItemUid = 0;
+  this->FramePeriodLastItemTimestamp = 0;
+  this->FramePeriodLastItemIndex = 0;
+  this->RecomputeFramePeriodSums();
 }
 
 //----------------------------------------------------------------------------
@@ -539,11 +1098,50 @@ PlusStatus vtkPlusTimestampedCircularBuffer::CreateFilteredTimeStampForItem(unsi
     this->FilterContainerTimestampVector.set_size(this->AveragedItemsForFiltering);
     this->FilterContainersOldestIndex = 0;
     this->FilterContainersNumberOfValidElements = 0;
+    this->NumberOfConsecutiveOutliers = 0;
+    this->RecomputeFilterSums();
+  }
+
+  bool filterContainersFull = (this->AveragedItemsForFiltering > 1 && this->FilterContainersNumberOfValidElements >= this->AveragedItemsForFiltering);
+
+  // Reject the item from fitting if it is too far from the line that is fitted to the previous items.
+  // Residual statistics need at least 3 items.
+  if (this->OutlierRejectionThreshold > 0 && filterContainersFull && this->AveragedItemsForFiltering > 2
+      && this->NumberOfConsecutiveOutliers < this->AveragedItemsForFiltering / 2)
+  {
+    double residualStdev = 0;
+    double predictedTimestamp = this->EvaluateFilterLine(itemIndex, &residualStdev);
+    if (residualStdev > 0 && fabs(inUnfilteredTimestamp - predictedTimestamp) > this->OutlierRejectionThreshold * residualStdev)
+    {
+      this->NumberOfConsecutiveOutliers++;
+      outFilteredTimestamp = predictedTimestamp;
+      LOG_TRACE("Unfiltered timestamp " << std::fixed << inUnfilteredTimestamp << " of item " << itemIndex << " is rejected as outlier (predicted: " << predictedTimestamp << ", residual stdev: " << residualStdev << ")");
+      AddToTimeStampReport(itemIndex, inUnfilteredTimestamp, outFilteredTimestamp);
+      if (fabs(outFilteredTimestamp - inUnfilteredTimestamp) > this->MaxAllowedFilteringTimeDifference)
+      {
+        filteredTimestampProbablyValid = false;
+      }
+      this->Unlock();
+      return PLUS_SUCCESS;
+    }
   }
+  this->NumberOfConsecutiveOutliers = 0;
 
   // We store the last AveragedItemsForFiltering unfiltered timestamp and item indexes, because these are used for computing the filtered timestamp.
   if (this->AveragedItemsForFiltering > 1)
   {
+    if (filterContainersFull)
+    {
+      // the oldest item is overwritten, remove it from the sums
+      this->UpdateFilterSums(this->FilterContainerIndexVector(this->FilterContainersOldestIndex), this->FilterContainerTimestampVector(this->FilterContainersOldestIndex), -1.0);
+    }
+    else if (this->FilterContainersNumberOfValidElements == 0)
+    {
+      this->FilterSumsReferenceIndex = itemIndex;
+      this->FilterSumsReferenceTimestamp = inUnfilteredTimestamp;
+    }
+    this->UpdateFilterSums(itemIndex, inUnfilteredTimestamp, 1.0);
+
     this->FilterContainerIndexVector(this->FilterContainersOldestIndex) = itemIndex;
     this->FilterContainerTimestampVector[this->FilterContainersOldestIndex] = inUnfilteredTimestamp;
     this->FilterContainersNumberOfValidElements++;
@@ -558,6 +1156,13 @@ PlusStatus vtkPlusTimestampedCircularBuffer::CreateFilteredTimeStampForItem(unsi
     {
       this->FilterContainersOldestIndex = 0;
     }
+
+    // Recomputing the sums once per AveragedItemsForFiltering items keeps the amortized cost constant
+    this->FilterSumsNumberOfUpdates++;
+    if (this->FilterSumsNumberOfUpdates >= this->AveragedItemsForFiltering)
+    {
+      this->RecomputeFilterSums();
+    }
   }
 
   // If we don't have enough unfiltered timestamps or we don't want to use afiltering then just use the unfiltered timestamps
@@ -569,6 +1174,71 @@ PlusStatus vtkPlusTimestampedCircularBuffer::CreateFilteredTimeStampForItem(unsi
     return PLUS_SUCCESS;
   }
 
+  outFilteredTimestamp = this->EvaluateFilterLine(itemIndex);
+
+  if (this->TimeStampLogging)
+  {
+    LOG_TRACE("timestamps = [" << std::fixed << this->FilterContainerTimestampVector << "];");
+    LOG_TRACE("frameindexes = [" << std::fixed << this->FilterContainerIndexVector << "];");
+  }
+
+  AddToTimeStampReport(itemIndex, inUnfilteredTimestamp, outFilteredTimestamp);
+
+  if (fabs(outFilteredTimestamp - inUnfilteredTimestamp) > this->MaxAllowedFilteringTimeDifference)
+  {
+    // Write current timestamps and frame indexes to the log to allow investigation of the problem
+    filteredTimestampProbablyValid = false;
+    LOG_DEBUG("Difference between unfiltered timestamp is larger than the threshold. The unfiltered timestamp may be incorrect."
+              << " Unfiltered timestamp: " << inUnfilteredTimestamp << ", filtered timestamp: " << outFilteredTimestamp << ", difference: " << fabs(outFilteredTimestamp - inUnfilteredTimestamp) << ", threshold: " << this->MaxAllowedFilteringTimeDifference << "."
+              << " timestamps = [" << std::fixed << this->FilterContainerTimestampVector << "];"
+              << " frameindexes = [" << std::fixed << this->FilterContainerIndexVector << "];");
+  }
+
+  this->Unlock();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::UpdateFilterSums(double itemIndex, double timestamp, double sign)
+{
+  double x = itemIndex - this->FilterSumsReferenceIndex;
+  double y = timestamp - this->FilterSumsReferenceTimestamp;
+  this->FilterSumIndex += sign * x;
+  this->FilterSumTimestamp += sign * y;
+  this->FilterSumIndexSquared += sign * x * x;
+  this->FilterSumIndexTimestamp += sign * x * y;
+  this->FilterSumTimestampSquared += sign * y * y;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::RecomputeFilterSums()
+{
+  this->FilterSumIndex = 0;
+  this->FilterSumTimestamp = 0;
+  this->FilterSumIndexSquared = 0;
+  this->FilterSumIndexTimestamp = 0;
+  this->FilterSumTimestampSquared = 0;
+  this->FilterSumsNumberOfUpdates = 0;
+  if (this->FilterContainersNumberOfValidElements == 0 || this->FilterContainerIndexVector.size() == 0)
+  {
+    return;
+  }
+
+  // The valid elements are the ones written most recently, the newest one is before FilterContainersOldestIndex
+  unsigned int containerSize = this->FilterContainerIndexVector.size();
+  unsigned int newestIndex = (this->FilterContainersOldestIndex + containerSize - 1) % containerSize;
+  this->FilterSumsReferenceIndex = this->FilterContainerIndexVector(newestIndex);
+  this->FilterSumsReferenceTimestamp = this->FilterContainerTimestampVector(newestIndex);
+  for (unsigned int i = 0; i < this->FilterContainersNumberOfValidElements; ++i)
+  {
+    unsigned int containerIndex = (newestIndex + containerSize - i) % containerSize;
+    this->UpdateFilterSums(this->FilterContainerIndexVector(containerIndex), this->FilterContainerTimestampVector(containerIndex), 1.0);
+  }
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusTimestampedCircularBuffer::EvaluateFilterLine(double itemIndex, double* residualStdev /*=NULL*/) const
+{
   // The items are acquired periodically, with quite accurate frame periods. The data is not timestamped
   // by the source, only Plus attaches a timestamp when it receives the data. The timestamp that Plus attaches
   // (the unfiltered timestamp) may be inaccurate, due to random delays in transferring the data.
@@ -590,42 +1260,28 @@ PlusStatus vtkPlusTimestampedCircularBuffer::CreateFilteredTimeStampForItem(unsi
   //   a = sum( (x(i)-xMean) * (y(i)-yMean) ) / sum( (x(i)-xMean) * (x(i)-xMean) )
   //   b = yMean - a*xMean
   //
+  // The centered sums are computed from the running sums:
+  //   sum( (x(i)-xMean) * (y(i)-yMean) ) = sum( x(i)*y(i) ) - n * xMean * yMean
+  //   sum( (x(i)-xMean) * (x(i)-xMean) ) = sum( x(i)*x(i) ) - n * xMean * xMean
+  // x and y are relative to the reference item, which does not change the line, just shifts its origin.
+  //
 
-  double xMean = this->FilterContainerIndexVector.mean();
-  double yMean = this->FilterContainerTimestampVector.mean();
-  double covarianceXY = 0;
-  double varianceX = 0;
-  for (int i = this->FilterContainerTimestampVector.size() - 1; i >= 0; i--)
-  {
-    double xiMinusXmean = (this->FilterContainerIndexVector(i) - xMean);
-    covarianceXY += xiMinusXmean * (this->FilterContainerTimestampVector(i) - yMean);
-    varianceX += xiMinusXmean * xiMinusXmean;
-  }
+  double n = this->FilterContainersNumberOfValidElements;
+  double xMean = this->FilterSumIndex / n;
+  double yMean = this->FilterSumTimestamp / n;
+  double covarianceXY = this->FilterSumIndexTimestamp - this->FilterSumIndex * yMean;
+  double varianceX = this->FilterSumIndexSquared - this->FilterSumIndex * xMean;
   double a = covarianceXY / varianceX;
-  double b = yMean - a * xMean;
-
-  outFilteredTimestamp = a * itemIndex + b;
-
-  if (this->TimeStampLogging)
-  {
-    LOG_TRACE("timestamps = [" << std::fixed << this->FilterContainerTimestampVector << "];");
-    LOG_TRACE("frameindexes = [" << std::fixed << this->FilterContainerIndexVector << "];");
-  }
-
-  AddToTimeStampReport(itemIndex, inUnfilteredTimestamp, outFilteredTimestamp);
 
-  if (fabs(outFilteredTimestamp - inUnfilteredTimestamp) > this->MaxAllowedFilteringTimeDifference)
+  if (residualStdev != NULL)
   {
-    // Write current timestamps and frame indexes to the log to allow investigation of the problem
-    filteredTimestampProbablyValid = false;
-    LOG_DEBUG("Difference between unfiltered timestamp is larger than the threshold. The unfiltered timestamp may be incorrect."
-              << " Unfiltered timestamp: " << inUnfilteredTimestamp << ", filtered timestamp: " << outFilteredTimestamp << ", difference: " << fabs(outFilteredTimestamp - inUnfilteredTimestamp) << ", threshold: " << this->MaxAllowedFilteringTimeDifference << "."
-              << " timestamps = [" << std::fixed << this->FilterContainerTimestampVector << "];"
-              << " frameindexes = [" << std::fixed << this->FilterContainerIndexVector << "];");
+    // residual sum of squares = sum( (y(i)-yMean)^2 ) - a * sum( (x(i)-xMean) * (y(i)-yMean) )
+    double varianceY = this->FilterSumTimestampSquared - this->FilterSumTimestamp * yMean;
+    double residualSumOfSquares = varianceY - a * covarianceXY;
+    (*residualStdev) = (n > 2 && residualSumOfSquares > 0) ? sqrt(residualSumOfSquares / (n - 2)) : 0.0;
   }
 
-  this->Unlock();
-  return PLUS_SUCCESS;
+  return this->FilterSumsReferenceTimestamp + yMean + a * (itemIndex - this->FilterSumsReferenceIndex - xMean);
 }
 
 //----------------------------------------------------------------------------
@@ -637,15 +1293,39 @@ PlusStatus vtkPlusTimestampedCircularBuffer::GetTimeStampReportTable(vtkTable* t
     return PLUS_FAIL;
   }
 
-  if (this->TimeStampReportTable == NULL)
+  vtkSmartPointer<vtkDoubleArray> colFrameNumber = vtkSmartPointer<vtkDoubleArray>::New();
+  colFrameNumber->SetName("FrameNumber");
+  vtkSmartPointer<vtkDoubleArray> colUnfilteredTimestamp = vtkSmartPointer<vtkDoubleArray>::New();
+  colUnfilteredTimestamp->SetName("UnfilteredTimestamp");
+  vtkSmartPointer<vtkDoubleArray> colFilteredTimestamp = vtkSmartPointer<vtkDoubleArray>::New();
+  colFilteredTimestamp->SetName("FilteredTimestamp");
+
   {
-    LOG_ERROR("Failed to get timestamp report table from buffer - table is NULL!");
-    return PLUS_FAIL;
+    std::lock_guard<std::mutex> reportLock(this->TimeStampReportMutex);
+    const size_t numberOfRecords = this->TimeStampReportNumberOfRecords;
+    if (numberOfRecords == 0)
+    {
+      LOG_ERROR("Failed to get timestamp report table from buffer - no timestamps are reported!");
+      return PLUS_FAIL;
+    }
+    colFrameNumber->SetNumberOfTuples(numberOfRecords);
+    colUnfilteredTimestamp->SetNumberOfTuples(numberOfRecords);
+    colFilteredTimestamp->SetNumberOfTuples(numberOfRecords);
+    // the oldest record is at the write index if the ring is full, otherwise at the beginning
+    const size_t oldestIndex = (numberOfRecords < this->TimeStampReportRecords.size()) ? 0 : this->TimeStampReportWriteIndex;
+    for (size_t i = 0; i < numberOfRecords; ++i)
+    {
+      const TimeStampReportRecord& record = this->TimeStampReportRecords[(oldestIndex + i) % this->TimeStampReportRecords.size()];
+      colFrameNumber->SetValue(i, record.FrameNumber);
+      colUnfilteredTimestamp->SetValue(i, record.UnfilteredTimestamp);
+      colFilteredTimestamp->SetValue(i, record.FilteredTimestamp);
+    }
   }
 
-  this->Lock();
-  timeStampReportTable->DeepCopy(this->TimeStampReportTable);
-  this->Unlock();
+  timeStampReportTable->Initialize();
+  timeStampReportTable->AddColumn(colFrameNumber);
+  timeStampReportTable->AddColumn(colUnfilteredTimestamp);
+  timeStampReportTable->AddColumn(colFilteredTimestamp);
 
   return PLUS_SUCCESS;
 }
@@ -659,33 +1339,208 @@ void vtkPlusTimestampedCircularBuffer::AddToTimeStampReport(unsigned long itemIn
     return;
   }
 
-  if (this->TimeStampReportTable == NULL)
+  std::lock_guard<std::mutex> reportLock(this->TimeStampReportMutex);
+  if (this->TimeStampReportCapacity == 0)
+  {
+    return;
+  }
+  if (this->TimeStampReportRecords.size() != this->TimeStampReportCapacity)
+  {
+    this->TimeStampReportRecords.resize(this->TimeStampReportCapacity);
+    this->TimeStampReportWriteIndex = 0;
+    this->TimeStampReportNumberOfRecords = 0;
+    this->TimeStampReportNumberOfUnwrittenRecords = 0;
+  }
+
+  TimeStampReportRecord& record = this->TimeStampReportRecords[this->TimeStampReportWriteIndex];
+  record.FrameNumber = itemIndex;
+  record.UnfilteredTimestamp = unfilteredTimestamp - this->StartTime;
+  record.FilteredTimestamp = filteredTimestamp - this->StartTime;
+  this->TimeStampReportWriteIndex = (this->TimeStampReportWriteIndex + 1) % this->TimeStampReportRecords.size();
+  this->TimeStampReportNumberOfRecords = std::min(this->TimeStampReportNumberOfRecords + 1, this->TimeStampReportRecords.size());
+
+  if (!this->TimeStampReportFile.is_open())
+  {
+    return;
+  }
+  // write in large blocks, well before the unwritten records would be overwritten
+  this->TimeStampReportNumberOfUnwrittenRecords++;
+  if (this->TimeStampReportNumberOfUnwrittenRecords * 2 >= this->TimeStampReportRecords.size())
+  {
+    this->WriteTimeStampReportRecords();
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::SetTimeStampReporting(bool enable)
+{
+  if (this->TimeStampReporting == enable)
+  {
+    return;
+  }
+  this->TimeStampReporting = enable;
+  if (!enable)
+  {
+    std::lock_guard<std::mutex> reportLock(this->TimeStampReportMutex);
+    this->WriteTimeStampReportRecords();
+  }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::SetTimeStampReportCapacity(unsigned int capacity)
+{
+  std::lock_guard<std::mutex> reportLock(this->TimeStampReportMutex);
+  if (this->TimeStampReportNumberOfUnwrittenRecords > 0)
+  {
+    LOG_WARNING("Timestamp report capacity is changed, " << this->TimeStampReportNumberOfUnwrittenRecords << " records are not written to the report file");
+  }
+  this->TimeStampReportCapacity = capacity;
+  // the ring is reallocated when the next record is added
+  this->TimeStampReportRecords.clear();
+  this->TimeStampReportWriteIndex = 0;
+  this->TimeStampReportNumberOfRecords = 0;
+  this->TimeStampReportNumberOfUnwrittenRecords = 0;
+}
+
+//----------------------------------------------------------------------------
+unsigned int vtkPlusTimestampedCircularBuffer::GetTimeStampReportCapacity()
+{
+  std::lock_guard<std::mutex> reportLock(this->TimeStampReportMutex);
+  return this->TimeStampReportCapacity;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTimestampedCircularBuffer::SetTimeStampReportFileName(const std::string& fileName)
+{
+  std::lock_guard<std::mutex> reportLock(this->TimeStampReportMutex);
+  if (fileName == this->TimeStampReportFileName)
+  {
+    return PLUS_SUCCESS;
+  }
+  PlusStatus status = this->WriteTimeStampReportRecords();
+  if (this->TimeStampReportFile.is_open())
+  {
+    this->TimeStampReportFile.close();
+  }
+  this->TimeStampReportFileName = fileName;
+  this->TimeStampReportNumberOfUnwrittenRecords = 0;
+  if (fileName.empty())
+  {
+    return status;
+  }
+
+  this->TimeStampReportFile.open(fileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!this->TimeStampReportFile.is_open())
+  {
+    LOG_ERROR("Failed to open timestamp report file: " << fileName);
+    this->TimeStampReportFileName.clear();
+    return PLUS_FAIL;
+  }
+  this->TimeStampReportFile.write(TIMESTAMP_REPORT_FILE_SIGNATURE, sizeof(TIMESTAMP_REPORT_FILE_SIGNATURE));
+  return status;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusTimestampedCircularBuffer::GetTimeStampReportFileName()
+{
+  std::lock_guard<std::mutex> reportLock(this->TimeStampReportMutex);
+  return this->TimeStampReportFileName;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTimestampedCircularBuffer::FlushTimeStampReport()
+{
+  std::lock_guard<std::mutex> reportLock(this->TimeStampReportMutex);
+  return this->WriteTimeStampReportRecords();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTimestampedCircularBuffer::WriteTimeStampReportRecords()
+{
+  if (!this->TimeStampReportFile.is_open() || this->TimeStampReportNumberOfUnwrittenRecords == 0)
   {
-    this->TimeStampReportTable = vtkTable::New();
+    return PLUS_SUCCESS;
+  }
 
-    const char* colFrameNumberName = "FrameNumber";
-    vtkSmartPointer<vtkDoubleArray> colFrameNumber = vtkSmartPointer<vtkDoubleArray>::New();
-    colFrameNumber->SetName(colFrameNumberName);
-    this->TimeStampReportTable->AddColumn(colFrameNumber);
+  // the unwritten records are the most recent ones, they may wrap around the end of the ring
+  const size_t ringSize = this->TimeStampReportRecords.size();
+  size_t firstIndex = (this->TimeStampReportWriteIndex + ringSize - this->TimeStampReportNumberOfUnwrittenRecords) % ringSize;
+  size_t numberOfRecordsToEnd = std::min(this->TimeStampReportNumberOfUnwrittenRecords, ringSize - firstIndex);
+  this->TimeStampReportFile.write(reinterpret_cast<const char*>(&this->TimeStampReportRecords[firstIndex]), numberOfRecordsToEnd * sizeof(TimeStampReportRecord));
+  if (numberOfRecordsToEnd < this->TimeStampReportNumberOfUnwrittenRecords)
+  {
+    this->TimeStampReportFile.write(reinterpret_cast<const char*>(&this->TimeStampReportRecords[0]),
+                                    (this->TimeStampReportNumberOfUnwrittenRecords - numberOfRecordsToEnd) * sizeof(TimeStampReportRecord));
+  }
+  this->TimeStampReportFile.flush();
+  this->TimeStampReportNumberOfUnwrittenRecords = 0;
 
-    const char* colUnfilteredTimestampName = "UnfilteredTimestamp";
-    vtkSmartPointer<vtkDoubleArray> colUnfilteredTimestamp = vtkSmartPointer<vtkDoubleArray>::New();
-    colUnfilteredTimestamp->SetName(colUnfilteredTimestampName);
-    this->TimeStampReportTable->AddColumn(colUnfilteredTimestamp);
+  if (!this->TimeStampReportFile.good())
+  {
+    LOG_ERROR("Failed to write timestamp report file: " << this->TimeStampReportFileName);
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
 
-    const char* colFilteredTimestampName = "FilteredTimestamp";
-    vtkSmartPointer<vtkDoubleArray> colFilteredTimestamp = vtkSmartPointer<vtkDoubleArray>::New();
-    colFilteredTimestamp->SetName(colFilteredTimestampName);
-    this->TimeStampReportTable->AddColumn(colFilteredTimestamp);
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTimestampedCircularBuffer::ConvertTimeStampReportFileToTable(const std::string& fileName, vtkTable* timeStampReportTable)
+{
+  if (timeStampReportTable == NULL)
+  {
+    LOG_ERROR("Failed to convert timestamp report file - output table is NULL!");
+    return PLUS_FAIL;
   }
 
-  // create a new row for the timestamp report table
-  vtkSmartPointer<vtkVariantArray> timeStampReportTableRow = vtkSmartPointer<vtkVariantArray>::New();
+  std::ifstream file(fileName.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+  if (!file.is_open())
+  {
+    LOG_ERROR("Failed to open timestamp report file: " << fileName);
+    return PLUS_FAIL;
+  }
+  const std::streamoff fileSize = file.tellg();
+  file.seekg(0, std::ios::beg);
+  char signature[sizeof(TIMESTAMP_REPORT_FILE_SIGNATURE)] = { 0 };
+  file.read(signature, sizeof(signature));
+  if (!file.good() || memcmp(signature, TIMESTAMP_REPORT_FILE_SIGNATURE, sizeof(signature)) != 0)
+  {
+    LOG_ERROR("File is not a timestamp report file: " << fileName);
+    return PLUS_FAIL;
+  }
 
-  timeStampReportTableRow->InsertNextValue(itemIndex);
-  timeStampReportTableRow->InsertNextValue(unfilteredTimestamp - this->StartTime);
-  timeStampReportTableRow->InsertNextValue(filteredTimestamp - this->StartTime);
+  // a partially written last record (e.g., the application was terminated while writing) is ignored
+  const size_t numberOfRecords = static_cast<size_t>((fileSize - static_cast<std::streamoff>(sizeof(signature))) / sizeof(TimeStampReportRecord));
+  std::vector<TimeStampReportRecord> records(numberOfRecords);
+  if (numberOfRecords > 0)
+  {
+    file.read(reinterpret_cast<char*>(&records[0]), numberOfRecords * sizeof(TimeStampReportRecord));
+    if (!file.good())
+    {
+      LOG_ERROR("Failed to read timestamp report file: " << fileName);
+      return PLUS_FAIL;
+    }
+  }
 
-  this->TimeStampReportTable->InsertNextRow(timeStampReportTableRow);
+  vtkSmartPointer<vtkDoubleArray> colFrameNumber = vtkSmartPointer<vtkDoubleArray>::New();
+  colFrameNumber->SetName("FrameNumber");
+  colFrameNumber->SetNumberOfTuples(numberOfRecords);
+  vtkSmartPointer<vtkDoubleArray> colUnfilteredTimestamp = vtkSmartPointer<vtkDoubleArray>::New();
+  colUnfilteredTimestamp->SetName("UnfilteredTimestamp");
+  colUnfilteredTimestamp->SetNumberOfTuples(numberOfRecords);
+  vtkSmartPointer<vtkDoubleArray> colFilteredTimestamp = vtkSmartPointer<vtkDoubleArray>::New();
+  colFilteredTimestamp->SetName("FilteredTimestamp");
+  colFilteredTimestamp->SetNumberOfTuples(numberOfRecords);
+  for (size_t i = 0; i < numberOfRecords; ++i)
+  {
+    colFrameNumber->SetValue(i, records[i].FrameNumber);
+    colUnfilteredTimestamp->SetValue(i, records[i].UnfilteredTimestamp);
+    colFilteredTimestamp->SetValue(i, records[i].FilteredTimestamp);
+  }
 
+  timeStampReportTable->Initialize();
+  timeStampReportTable->AddColumn(colFrameNumber);
+  timeStampReportTable->AddColumn(colUnfilteredTimestamp);
+  timeStampReportTable->AddColumn(colFilteredTimestamp);
+  return PLUS_SUCCESS;
 }
@@ -10,7 +10,13 @@
 #include "PlusConfigure.h"
 #include "PlusStreamBufferItem.h"
 #include "vtkObject.h"
+#include <atomic>
+#include <condition_variable>
 #include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
 
 #include "vnl/vnl_matrix.h"
 #include "vnl/vnl_vector.h"
@@ -57,13 +63,22 @@ public:
 
   /*!
     Given a timestamp, compute the nearest frame UID
-    This assumes that the times motonically increase
+    This assumes that the times motonically increase.
+    The search uses a timestamp index, so it takes O(log n) time, and O(1) time for requests close to the latest
+    or to the previously requested item.
   */
   virtual ItemStatus GetItemUidFromTime( const double time, BufferItemUidType& uid );
 
   /*! Get the most recent frame UID that is already in the buffer */
   virtual BufferItemUidType GetLatestItemUidInBuffer()
   {
+    if ( this->LockFreeReads )
+    {
+      BufferItemUidType oldestUid( 0 ), latestUid( 0 );
+      int latestBufferIndex( 0 );
+      this->ReadPublishedState( oldestUid, latestUid, latestBufferIndex );
+      return latestUid;
+    }
     this->Lock();
     BufferItemUidType latestUid = this->LatestItemUid;
     this->Unlock();
@@ -73,6 +88,13 @@ public:
   /*! Get the oldest frame UID in the buffer  */
   virtual BufferItemUidType GetOldestItemUidInBuffer()
   {
+    if ( this->LockFreeReads )
+    {
+      BufferItemUidType oldestUid( 0 ), latestUid( 0 );
+      int latestBufferIndex( 0 );
+      this->ReadPublishedState( oldestUid, latestUid, latestBufferIndex );
+      return oldestUid;
+    }
     this->Lock();
     // LatestItemUid - ( NumberOfItems - 1 ) is the oldest element in the buffer
     BufferItemUidType oldestUid = this->LatestItemUid - ( this->NumberOfItems - 1 );
@@ -88,6 +110,12 @@ public:
 
   virtual ItemStatus GetOldestTimeStamp( double& timestamp )
   {
+    if ( this->LockFreeReads && this->BeginLockFreeContainerRead() )
+    {
+      ItemStatus status = this->GetPublishedItemTimeStamp( 0, true, true, timestamp );
+      this->EndLockFreeContainerRead();
+      return status;
+    }
     // The oldest item may be removed from the buffer at any moment
     // therefore we need to retrieve its UID and timestamp within a single lock
     this->Lock();
@@ -138,6 +166,34 @@ public:
   */
   virtual double GetFrameRate( bool ideal = false, double* framePeriodStdevSecPtr = NULL );
 
+  /*! Statistics of the periods between consecutive items */
+  struct FramePeriodStatistics
+  {
+    FramePeriodStatistics() : NumberOfSamples( 0 ), MeanSec( 0 ), StdevSec( 0 ), MinimumSec( 0 ), MaximumSec( 0 ) {}
+    int NumberOfSamples;
+    double MeanSec;
+    double StdevSec;
+    double MinimumSec;
+    double MaximumSec;
+  };
+
+  /*!
+    Get the mean, standard deviation, minimum and maximum of the frame periods in the buffer (see GetFrameRate).
+    Only the frame periods that ended in the last FrameRateStatisticsWindowSec seconds are included.
+    The statistics are updated when items are added, so the query takes constant time and can be used for
+    monitoring the frame rate and jitter at high frequency.
+    Returns PLUS_FAIL if there are no frame periods in the window.
+  */
+  virtual PlusStatus GetFramePeriodStatistics( bool ideal, FramePeriodStatistics& statistics );
+
+  /*!
+    Length of the time window for the frame rate statistics (GetFrameRate, GetFramePeriodStatistics), in seconds.
+    If not positive then all items in the buffer are included. Default is 0.
+    Increasing the window does not restore frame periods that have already been removed from the statistics.
+  */
+  vtkSetMacro( FrameRateStatisticsWindowSec, double );
+  vtkGetMacro( FrameRateStatisticsWindowSec, double );
+
   /*! Clear buffer (set the buffer pointer to the first element) */
   virtual void Clear();
 
@@ -166,13 +222,61 @@ public:
   */
   virtual ItemStatus GetBufferItemPointerFromUid( const BufferItemUidType uid, StreamBufferItem*& itemPtr );
 
+  /*!
+    Reserve the buffer slot that the next item will be stored in, so that the item content can be written
+    before its timestamp is known and PrepareForNewItem is called. The oldest item is removed from the
+    buffer if the slot is occupied. Only one slot can be reserved at a time and no other items may be
+    added until the reservation is used by PrepareForNewItem or cancelled by CancelReservedItem.
+    INTERNAL USE ONLY!
+  */
+  virtual PlusStatus ReserveNewItem( int& bufferIndex );
+
+  /*! Release the reserved buffer slot without adding an item */
+  virtual void CancelReservedItem();
+
+  /*! Get the index of the reserved buffer slot. Returns -1 if no slot is reserved. */
+  virtual int GetReservedBufferIndex();
+
+  /*!
+    Add a new item to the buffer and get its UID and buffer index. If a slot is reserved then the item is stored in it.
+    Fails without adding the item if the timestamp is not newer than the latest one, or the reserved slot is no longer the next slot.
+  */
   virtual PlusStatus PrepareForNewItem( const double timestamp, BufferItemUidType& newFrameUid, int& bufferIndex );
 
+  /*!
+    Make the item that was prepared by PrepareForNewItem visible to lock-free readers.
+    Has to be called after the item content is completely filled, while the buffer is still locked.
+    If it is not called then the item is published when the next item is prepared.
+    Has no effect if LockFreeReads is disabled.
+  */
+  virtual void PublishNewItem( const BufferItemUidType uid );
+
+  /*!
+    Block the calling thread until an item with a timestamp newer than the specified timestamp is available
+    in the buffer or the timeout expires. Threads waiting in this method are woken up by PublishNewItem.
+    Returns PLUS_SUCCESS if a newer item is available, PLUS_FAIL if the timeout expired.
+  */
+  virtual PlusStatus WaitForItemNewerThan( double timestamp, double timeoutSec );
+
+  /*!
+    If enabled then UID and timestamp queries (GetLatestItemUidInBuffer, GetOldestItemUidInBuffer,
+    GetLatestTimeStamp, GetOldestTimeStamp, GetTimeStamp, GetIndex, ...) do not lock the buffer
+    but read a snapshot that the single writer thread publishes through a sequence lock.
+    Items can still be only added from a single thread and item content (frame, matrix, fields)
+    must still be accessed with the buffer locked.
+    The mode should be set before acquisition is started. The buffer size can still be changed: while the items
+    are reallocated the queries wait for the buffer lock instead of reading the published snapshot.
+  */
+  virtual void SetLockFreeReads( bool enable );
+  virtual bool GetLockFreeReads() { return this->LockFreeReads; }
+  vtkBooleanMacro( LockFreeReads, bool );
+
   /*!
     Create filtered and unfiltered timestamp for accurate timing of the buffer item.
     The timing may be inaccurate because the timestamp is attached to the item when Plus receives it
     and so the timestamp is affected by data transfer speed (which may slightly vary).
     A line is fitted to the index and timestamp of the last (AveragedItemsForFiltering) items.
+    The fit is updated incrementally (using running sums), so its cost does not depend on AveragedItemsForFiltering.
     The filtered timestamp is the time value that corresponds to the frame index according to the fitted line.
     If the filtered timestamp is very different from the non-filtered timestamp then
     filteredTimestampProbablyValid will be false and it is recommended not to use that item,
@@ -183,14 +287,39 @@ public:
   /*! Add values to the timestamp report. If reporting is not enabled then no values will be added. This should only be called if an item is added without calling CreateFilteredTimeStampForItem. */
   void AddToTimeStampReport( unsigned long itemIndex, double unfilteredTimestamp, double filteredTimestamp );
 
-  /*! Get the table report of the timestamped buffer. To fill this table TimeStampReporting has to be enabled.  */
+  /*!
+    Get the table report of the timestamped buffer (FrameNumber, UnfilteredTimestamp, FilteredTimestamp columns).
+    To fill this table TimeStampReporting has to be enabled. Only the last TimeStampReportCapacity records are kept in memory,
+    all the records can be retrieved from the report file by ConvertTimeStampReportFileToTable.
+  */
   PlusStatus GetTimeStampReportTable( vtkTable* timeStampReportTable );
 
-  /*! If TimeStampReporting is enabled then all filtered and unfiltered timestamp values will be saved in a table for diagnostic purposes. */
-  vtkSetMacro( TimeStampReporting, bool );
+  /*!
+    If TimeStampReporting is enabled then all filtered and unfiltered timestamp values will be saved for diagnostic purposes.
+    The records are stored in a fixed-size ring and written to the report file (if set), so reporting can be left enabled.
+    Disabling the reporting writes the pending records to the file.
+  */
+  void SetTimeStampReporting( bool enable );
   vtkGetMacro( TimeStampReporting, bool );
   vtkBooleanMacro( TimeStampReporting, bool );
 
+  /*! Number of timestamp report records kept in memory. Changing it discards the records that are not written to file yet. */
+  void SetTimeStampReportCapacity( unsigned int capacity );
+  unsigned int GetTimeStampReportCapacity();
+
+  /*!
+    Binary file that all the timestamp report records are appended to. The records are written whenever half of the
+    ring is filled and when reporting is disabled. If empty then the records are only kept in memory.
+  */
+  PlusStatus SetTimeStampReportFileName( const std::string& fileName );
+  std::string GetTimeStampReportFileName();
+
+  /*! Write the pending timestamp report records to the report file */
+  PlusStatus FlushTimeStampReport();
+
+  /*! Read a timestamp report file into a table that has the same columns as the one returned by GetTimeStampReportTable */
+  static PlusStatus ConvertTimeStampReportFileToTable( const std::string& fileName, vtkTable* timeStampReportTable );
+
   /*! If TimeStampLogging is enabled then the timestamps and frame indexes that are used for filtering will be logged at TRACE level for diagnostic purposes. */
   vtkSetMacro( TimeStampLogging, bool );
   vtkGetMacro( TimeStampLogging, bool );
@@ -201,6 +330,16 @@ public:
   /*! Get number of items used for timestamp filtering (with LSQR mimimizer) */
   vtkGetMacro( AveragedItemsForFiltering, int );
 
+  /*!
+    If positive then outlier rejection is enabled in timestamp filtering: if the unfiltered timestamp of a new item
+    is farther from the fitted line than OutlierRejectionThreshold times the standard deviation of the residuals
+    of the fit, then it is not used for fitting and the item gets the timestamp predicted by the line.
+    At most AveragedItemsForFiltering/2 consecutive items are rejected, to allow following real changes in the frame rate.
+    Default is 0 (disabled).
+  */
+  vtkSetMacro( OutlierRejectionThreshold, double );
+  vtkGetMacro( OutlierRejectionThreshold, double );
+
   /*! Set recording start time */
   vtkSetMacro( StartTime, double );
   /*! Get recording start time */
@@ -210,6 +349,60 @@ protected:
   vtkPlusTimestampedCircularBuffer();
   ~vtkPlusTimestampedCircularBuffer();
 
+  /*!
+    Update the state that is visible to lock-free readers. The caller must have locked the buffer.
+    Items in the [oldestUid, latestUid] range must not be modified until the next publish call.
+  */
+  void WritePublishedState( BufferItemUidType oldestUid, BufferItemUidType latestUid, int latestBufferIndex );
+
+  /*! Publish the current state of the buffer to lock-free readers. The caller must have locked the buffer. */
+  void PublishCurrentState();
+
+  /*! Get a consistent copy of the state that is visible to lock-free readers. Does not lock the buffer. */
+  void ReadPublishedState( BufferItemUidType& oldestUid, BufferItemUidType& latestUid, int& latestBufferIndex ) const;
+
+  /*!
+    Read the timestamp of a published item without locking the buffer.
+    If useOldestItem is true then the uid argument is ignored and the oldest item's timestamp is returned.
+  */
+  ItemStatus GetPublishedItemTimeStamp( const BufferItemUidType uid, bool useOldestItem, bool filtered, double& timestamp );
+
+  /*! Get the filtered timestamp (in local time) of an item from the timestamp index. The caller must have locked the buffer and uid must be in the buffer. */
+  double GetIndexedTimeStamp( const BufferItemUidType uid ) const;
+
+  /*! Fill the timestamp index from the buffer items. The caller must have locked the buffer. */
+  void RebuildFilteredTimestampIndex();
+
+  /*! Read the index of a published item without locking the buffer */
+  ItemStatus GetPublishedItemIndex( const BufferItemUidType uid, unsigned long& index );
+
+  /*! Add (sign=1) or remove (sign=-1) an index and timestamp pair to the running sums of the timestamp filter */
+  void UpdateFilterSums( double itemIndex, double timestamp, double sign );
+
+  /*!
+    Recompute the running sums of the timestamp filter from the filter containers, relative to the newest item.
+    Called regularly to prevent accumulation of rounding errors and keep the relative values small.
+  */
+  void RecomputeFilterSums();
+
+  /*!
+    Evaluate the line that is fitted to the items in the filter containers at the specified index.
+    Optionally returns the standard deviation of the residuals of the fit. The containers must contain at least 2 items.
+  */
+  double EvaluateFilterLine( double itemIndex, double* residualStdev = NULL ) const;
+
+  /*! Add the period between the item and the previously added item to the frame rate statistics. The caller must have locked the buffer. */
+  void AddToFramePeriodStatistics( const BufferItemUidType uid );
+
+  /*! Remove the frame periods that are not in the buffer or in the statistics window anymore. The caller must have locked the buffer. */
+  void RemoveExpiredFramePeriods();
+
+  /*! Recompute the running sums of the frame periods. Called regularly to prevent accumulation of rounding errors. */
+  void RecomputeFramePeriodSums();
+
+  /*! Remove all frame periods from the statistics. The caller must have locked the buffer. */
+  void ClearFramePeriodStatistics();
+
 protected:
   vtkIGSIORecursiveCriticalSection* Mutex;
 
@@ -231,6 +424,15 @@ protected:
 
   std::deque<StreamBufferItem> BufferItemContainer;
 
+  /*!
+    Filtered timestamps (in local time) of the items, in the same order as in BufferItemContainer.
+    Timestamp lookups search in this contiguous array instead of accessing the buffer items.
+  */
+  std::vector<double> FilteredTimestampIndex;
+
+  /*! UID of the item that was found by the last GetItemUidFromTime call, used as starting guess for the next search */
+  BufferItemUidType LastTimeLookupUid;
+
   /*! Matrix used for storing the last number of AveragedItemsForFiltering frame index */
   vnl_vector<double> FilterContainerIndexVector;
 
@@ -243,6 +445,27 @@ protected:
   /*! Number of valid elements in the frame index and timestamp containers (maximum can be equal to AveragedItemsForFiltering) */
   unsigned int FilterContainersNumberOfValidElements;
 
+  /*!
+    Running sums of the valid elements of the filter containers (index, timestamp, index^2, index*timestamp, timestamp^2).
+    Values are relative to FilterSumsReferenceIndex and FilterSumsReferenceTimestamp to avoid loss of precision.
+  */
+  double FilterSumIndex;
+  double FilterSumTimestamp;
+  double FilterSumIndexSquared;
+  double FilterSumIndexTimestamp;
+  double FilterSumTimestampSquared;
+  double FilterSumsReferenceIndex;
+  double FilterSumsReferenceTimestamp;
+
+  /*! Number of items added to the running sums since they were last recomputed */
+  unsigned int FilterSumsNumberOfUpdates;
+
+  /*! Outlier rejection threshold in timestamp filtering, in units of standard deviation of the fit residuals. Disabled if not positive. */
+  double OutlierRejectionThreshold;
+
+  /*! Number of consecutive items that were rejected as outliers in timestamp filtering */
+  unsigned int NumberOfConsecutiveOutliers;
+
   /*! Number of averaged items used for filtering - read from config files */
   unsigned int AveragedItemsForFiltering;
 
@@ -256,13 +479,31 @@ protected:
   /*! Acquisition start time */
   double StartTime;
 
-  /*! Table used for storing timestamp filtering results */
-  vtkTable* TimeStampReportTable;
-
-  /*!
-    If TimeStampReporting is enabled then all filtered and unfiltered timestamp values will be saved in
-    a table. As the table is continuously growing it should be enabled only temporarily, for diagnostic purposes.
-  */
+  /*! Timestamp report record, stored in memory and in the report file as is */
+  struct TimeStampReportRecord
+  {
+    double FrameNumber;
+    double UnfilteredTimestamp;
+    double FilteredTimestamp;
+  };
+
+  /*! Write the records that are not in the report file yet. TimeStampReportMutex must be locked by the caller. */
+  PlusStatus WriteTimeStampReportRecords();
+
+  /*! Protects the timestamp report members, records may be added with or without the buffer lock */
+  std::mutex TimeStampReportMutex;
+  /*! Ring of the most recent timestamp report records, allocated when the first record is added */
+  std::vector<TimeStampReportRecord> TimeStampReportRecords;
+  unsigned int TimeStampReportCapacity;
+  /*! Index of the next record to be written in TimeStampReportRecords */
+  size_t TimeStampReportWriteIndex;
+  size_t TimeStampReportNumberOfRecords;
+  /*! Number of most recent records that are not written to the report file yet */
+  size_t TimeStampReportNumberOfUnwrittenRecords;
+  std::string TimeStampReportFileName;
+  std::ofstream TimeStampReportFile;
+
+  /*! If TimeStampReporting is enabled then all filtered and unfiltered timestamp values will be saved for diagnostic purposes. */
   bool TimeStampReporting;
   /*!
     If TimeStampReporting is enabled then all filtered and unfiltered timestamp values will be saved in a table for diagnostic purposes.
@@ -276,6 +517,83 @@ protected:
   */
   double NegligibleTimeDifferenceSec;
 
+  /*! Index of the actual and the ideal (frame number based) frame periods in the frame rate statistics arrays */
+  enum FramePeriodType
+  {
+    FRAME_PERIOD_ACTUAL = 0,
+    FRAME_PERIOD_IDEAL,
+    NUMBER_OF_FRAME_PERIOD_TYPES
+  };
+
+  /*! Period between an item and the previous item */
+  struct FramePeriodSample
+  {
+    BufferItemUidType Uid;
+    double Timestamp;
+    double PeriodSec[NUMBER_OF_FRAME_PERIOD_TYPES];
+    bool IdealPeriodValid;
+  };
+
+  /*! Frame periods in the statistics window, ordered by UID */
+  std::deque<FramePeriodSample> FramePeriodSamples;
+  /*! UID and value of the frame periods that may become the minimum (increasing values) when older periods are removed */
+  std::deque< std::pair<BufferItemUidType, double> > FramePeriodMinimumCandidates[NUMBER_OF_FRAME_PERIOD_TYPES];
+  /*! UID and value of the frame periods that may become the maximum (decreasing values) when older periods are removed */
+  std::deque< std::pair<BufferItemUidType, double> > FramePeriodMaximumCandidates[NUMBER_OF_FRAME_PERIOD_TYPES];
+  double FramePeriodSum[NUMBER_OF_FRAME_PERIOD_TYPES];
+  double FramePeriodSumSquared[NUMBER_OF_FRAME_PERIOD_TYPES];
+  /*! Number of frame periods added or removed since the sums were last recomputed */
+  unsigned int FramePeriodSumsNumberOfUpdates;
+  /*! Number of frame periods in the window where the ideal period could not be computed because of invalid frame numbers */
+  int NumberOfInvalidIdealFramePeriods;
+  /*! UID, timestamp and index of the item that was last added to the statistics (UID is 0 if there is no such item) */
+  BufferItemUidType FramePeriodLastItemUid;
+  double FramePeriodLastItemTimestamp;
+  unsigned long FramePeriodLastItemIndex;
+  /*! Length of the time window for the frame rate statistics in seconds, not positive value means the whole buffer */
+  double FrameRateStatisticsWindowSec;
+
+  /*! Buffer slot that is reserved for the next item, -1 if there is no reservation */
+  int ReservedBufferIndex;
+
+  /*!
+    Register a lock-free reader of the item container. Returns false if the container is being reallocated,
+    in this case the reader must use the locked path. EndLockFreeContainerRead must be called if true is returned.
+  */
+  bool BeginLockFreeContainerRead();
+  void EndLockFreeContainerRead();
+
+  /*!
+    Make the lock-free readers use the locked path and wait until the active ones finish reading the item container,
+    so that the container can be reallocated. The caller must have locked the buffer.
+  */
+  void BeginContainerReallocation();
+  void EndContainerReallocation();
+
+  /*! If enabled then UID and timestamp queries read the published state instead of locking the buffer */
+  std::atomic<bool> LockFreeReads;
+
+  /*! Set while the item container is reallocated (SetBufferSize, DeepCopy) */
+  std::atomic<bool> ContainerReallocating;
+  /*! Number of lock-free readers that are accessing the item container */
+  std::atomic<int> ActiveLockFreeContainerReaders;
+
+  /*! Sequence lock counter of the published state. Odd value means that the writer is updating the state. */
+  std::atomic<unsigned int> PublishedSequence;
+  /*! Oldest item UID that lock-free readers may access */
+  std::atomic<BufferItemUidType> PublishedOldestItemUid;
+  /*! Latest item UID that lock-free readers may access */
+  std::atomic<BufferItemUidType> PublishedLatestItemUid;
+  /*! Buffer index of the latest published item */
+  std::atomic<int> PublishedLatestBufferIndex;
+
+  /*! Protects NewItemCount, used with NewItemCondition */
+  std::mutex NewItemMutex;
+  /*! Signalled each time a new item is published */
+  std::condition_variable NewItemCondition;
+  /*! Number of published items, allows waiting threads to detect that a new item has arrived */
+  unsigned long NewItemCount;
+
 private:
   vtkPlusTimestampedCircularBuffer( const vtkPlusTimestampedCircularBuffer& );
   void operator=( const vtkPlusTimestampedCircularBuffer& );
@@ -34,6 +34,7 @@ const char* vtkPlusUsImagingParameters::KEY_IMAGESIZE     = "ImageSize";
 //----------------------------------------------------------------------------
 vtkPlusUsImagingParameters::vtkPlusUsImagingParameters()
   : vtkObject()
+  , Version(1)
 {
   this->Parameters[KEY_FREQUENCY] = ParameterInfo("-1");
   this->Parameters[KEY_DEPTH] = ParameterInfo("-1");
@@ -143,13 +144,10 @@ PlusStatus vtkPlusUsImagingParameters::SetTimeGainCompensation(const std::vector
   std::stringstream result;
   std::copy(tgc.begin(), tgc.end(), std::ostream_iterator<double>(result, " "));
 
-  if (this->Parameters[KEY_TGC].Value != result.str())
+  if (this->UpdateParameter(KEY_TGC, result.str(), true))
   {
-    // If the value changed, then mark it pending
-    this->Parameters[KEY_TGC].Pending = true;
+    this->Modified();
   }
-  this->Parameters[KEY_TGC].Value = result.str();
-  this->Parameters[KEY_TGC].Set = true;
   return PLUS_SUCCESS;
 }
 
@@ -459,6 +457,7 @@ PlusStatus vtkPlusUsImagingParameters::ReadConfiguration(vtkXMLDataElement* devi
     return PLUS_FAIL;
   }
 
+  bool changed(false);
   for (int i = 0; i < parameterList->GetNumberOfNestedElements(); ++i)
   {
     vtkXMLDataElement* element = parameterList->GetNestedElement(i);
@@ -469,15 +468,16 @@ PlusStatus vtkPlusUsImagingParameters::ReadConfiguration(vtkXMLDataElement* devi
       continue;
     }
 
-    if (this->Parameters[name].Value != value)
+    if (this->UpdateParameter(name, value, true))
     {
-      // If the value changed, then mark it pending
-      this->Parameters[name].Pending = true;
+      changed = true;
     }
-    this->Parameters[name].Value = value;
-    this->Parameters[name].Set = true;
   }
 
+  if (changed)
+  {
+    this->Modified();
+  }
   return PLUS_SUCCESS;
 }
 
@@ -569,16 +569,88 @@ PlusStatus vtkPlusUsImagingParameters::SetPending(const std::string& paramName,
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusUsImagingParameters::DeepCopy(const vtkPlusUsImagingParameters& otherParameters)
 {
+  bool changed(false);
   for (ParameterMapConstIterator it = otherParameters.Parameters.begin(); it != otherParameters.Parameters.end(); ++it)
   {
-    if (this->Parameters[it->first].Value != it->second.Value)
+    if (this->UpdateParameter(it->first, it->second.Value, it->second.Set))
     {
-      // If the value changed, then mark it pending
-      this->Parameters[it->first].Pending = true;
+      changed = true;
     }
-    this->Parameters[it->first].Value = it->second.Value;
-    this->Parameters[it->first].Set = it->second.Set;
   }
 
+  if (changed)
+  {
+    this->Modified();
+  }
   return PLUS_SUCCESS;
 }
+
+//-----------------------------------------------------------------------------
+bool vtkPlusUsImagingParameters::UpdateParameter(const std::string& paramName, const std::string& value, bool set)
+{
+  ParameterInfo& parameter = this->Parameters[paramName];
+  if (parameter.Value == value && parameter.Set == set)
+  {
+    return false;
+  }
+  if (parameter.Value != value)
+  {
+    // If the value changed, then mark it pending
+    parameter.Pending = true;
+  }
+  parameter.Value = value;
+  parameter.Set = set;
+  ++this->Version;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+unsigned long vtkPlusUsImagingParameters::GetVersion() const
+{
+  return this->Version;
+}
+
+//-----------------------------------------------------------------------------
+std::shared_ptr<const vtkPlusUsImagingParameters::Snapshot> vtkPlusUsImagingParameters::GetSnapshot() const
+{
+  std::lock_guard<std::mutex> lock(this->SnapshotMutex);
+  // The version is read before the values, so a change during the copy makes the next call create a new snapshot
+  unsigned long version = this->Version;
+  if (this->CachedSnapshot != nullptr && this->CachedSnapshot->Version == version)
+  {
+    return this->CachedSnapshot;
+  }
+
+  std::shared_ptr<Snapshot> snapshot = std::make_shared<Snapshot>();
+  snapshot->Version = version;
+  vtkSmartPointer<vtkXMLDataElement> parameterList = vtkSmartPointer<vtkXMLDataElement>::New();
+  parameterList->SetName(XML_ELEMENT_TAG);
+  parameterList->SetAttribute("Version", igsioCommon::ToString<unsigned long>(version).c_str());
+  for (ParameterMapConstIterator it = this->Parameters.begin(); it != this->Parameters.end(); ++it)
+  {
+    if (!it->second.Set)
+    {
+      continue;
+    }
+    snapshot->Values[it->first] = it->second.Value;
+
+    vtkSmartPointer<vtkXMLDataElement> parameter = vtkSmartPointer<vtkXMLDataElement>::New();
+    parameter->SetName("UsParameter");
+    parameter->SetAttribute("name", it->first.c_str());
+    parameter->SetAttribute("value", it->second.Value.c_str());
+    parameterList->AddNestedElement(parameter);
+  }
+  std::ostringstream os;
+  igsioCommon::XML::PrintXML(os, vtkIndent(0), parameterList);
+  snapshot->SerializedXml = os.str();
+
+  this->CachedSnapshot = snapshot;
+  return this->CachedSnapshot;
+}
+
+//-----------------------------------------------------------------------------
+const std::string* vtkPlusUsImagingParameters::Snapshot::GetValue(const std::string& paramName) const
+{
+  std::map<std::string, std::string>::const_iterator valueIt = this->Values.find(paramName);
+  return (valueIt != this->Values.end() ? &valueIt->second : NULL);
+}
@@ -9,8 +9,11 @@ See License.txt for details.
 
 #include "vtkPlusDataCollectionExport.h"
 
-#include <string>
+#include <atomic>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <string>
 
 /*!
 \class vtkPlusUsImagingParameters
@@ -36,6 +39,11 @@ Currently contains the following items
 * Voltage
 * ImageSize [x, y, z]
 * SoundVelocity
+
+Each change of a parameter value increments the version of the parameters and invokes a vtkCommand::ModifiedEvent.
+Readers that poll the parameters (e.g., GetUsParameter commands, clients subscribed to the parameter updates of the
+OpenIGTLink server) should use GetSnapshot(): the snapshot contains the serialized values of the set parameters and is
+shared by all readers until a parameter changes, so repeated reads neither parse nor serialize the values again.
 */
 
 class vtkPlusDataCollectionExport vtkPlusUsImagingParameters : public vtkObject
@@ -59,6 +67,12 @@ protected:
   typedef ParameterMap::iterator ParameterMapIterator;
   typedef ParameterMap::const_iterator ParameterMapConstIterator;
 
+  /*!
+  Store a serialized parameter value. The parameter is marked pending if its value is changed.
+  Returns true if the value or the set status is changed, in this case the version is incremented.
+  */
+  bool UpdateParameter(const std::string& paramName, const std::string& value, bool set);
+
   /*! Return an iterator to the beginning of the parameter space */
   ParameterMapConstIterator begin() const;
   /*! Return an iterator to the end of the parameter space */
@@ -81,6 +95,24 @@ public:
   static const char* KEY_VOLTAGE;
   static const char* KEY_IMAGESIZE;
 
+public:
+  /*! Immutable copy of the set parameters, created by GetSnapshot() */
+  class Snapshot
+  {
+  public:
+    Snapshot() : Version(0) {};
+
+    /*! Returns the serialized value of a parameter, NULL if the parameter is not set */
+    const std::string* GetValue(const std::string& paramName) const;
+
+    /// Version of the parameters that the snapshot is created from
+    unsigned long Version;
+    /// Serialized values of the set parameters, by parameter name
+    std::map<std::string, std::string> Values;
+    /// The set parameters as an UsImagingParameters XML element (same format as in the device configuration) with a Version attribute
+    std::string SerializedXml;
+  };
+
 public:
   static vtkPlusUsImagingParameters* New();
   vtkTypeMacro(vtkPlusUsImagingParameters, vtkObject);
@@ -138,12 +170,10 @@ public:
   {
     std::stringstream ss;
     ss << aValue;
-    if (this->Parameters[paramName].Value != ss.str())
+    if (this->UpdateParameter(paramName, ss.str(), true))
     {
-      this->Parameters[paramName].Pending = true;
+      this->Modified();
     }
-    this->Parameters[paramName].Value = ss.str();
-    this->Parameters[paramName].Set = true;
     return PLUS_SUCCESS;
   };
   /*!
@@ -161,6 +191,18 @@ public:
   */
   PlusStatus SetPending(const std::string& paramName, bool pending);
 
+  /*!
+  Version of the parameter values, incremented at each change. Can be called from any thread,
+  the value can be compared with the version of a snapshot to check whether the snapshot is still current.
+  */
+  unsigned long GetVersion() const;
+
+  /*!
+  Get the current parameter values. The snapshot is created only if a parameter has changed since the previous call,
+  otherwise the same snapshot is returned. Can be called from any thread.
+  */
+  std::shared_ptr<const Snapshot> GetSnapshot() const;
+
   /*! Set ultrasound transmitter frequency (MHz) */
   PlusStatus SetFrequencyMhz(double aFrequencyMhz);
   /*! Get ultrasound transmitter frequency (MHz) */
@@ -317,6 +359,14 @@ protected:
   virtual ~vtkPlusUsImagingParameters();
 
   ParameterMap Parameters;
+
+  /// Incremented at each change of the parameter values
+  std::atomic<unsigned long> Version;
+
+  /// Protects CachedSnapshot
+  mutable std::mutex SnapshotMutex;
+  /// Snapshot returned by GetSnapshot, recreated when the version changes
+  mutable std::shared_ptr<const Snapshot> CachedSnapshot;
 };
 
 #endif
\ No newline at end of file
@@ -26,7 +26,150 @@ See License.txt for details.
 #include <vtkIGSIOTrackedFrameList.h>
 
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Remove the pixels of a row that are too low compared to the intensity statistics of the row
+  void ThresholdRowViaStdDeviation(unsigned char* row, int rowLength)
+  {
+    int fatLayerToCut = 20; //The area of fat too close to the transducer should not be considered
+
+    float vInput = 0;
+    int max = 0;
+
+    //values used to calculate the standard deviation
+    int pixelSum = 0;
+    int squearSum = 0;
+    float pixelAverage = 0;
+    float meanDiffSum;
+    float meanDiffAverage;
+    float thresholdValue;
+
+    //determine the average, sum, and max of the row
+    for (int x = rowLength - 1; x >= fatLayerToCut; --x)
+    {
+      vInput = row[x];
+      pixelSum += vInput;
+      squearSum += vInput * vInput;
+
+      if (vInput > max)
+      {
+        max = vInput;
+      }
+    }
+    pixelAverage = pixelSum / (rowLength - fatLayerToCut);
+
+    //determine the standard deviation of the row
+    meanDiffSum = squearSum + (rowLength - fatLayerToCut) * pixelAverage * pixelAverage + (-2 * pixelAverage * pixelSum);
+    meanDiffAverage = meanDiffSum / (rowLength - fatLayerToCut);
+    thresholdValue = max - 3 * pow(meanDiffAverage, 0.5f);
+
+    //if a pixel's value is too low, remove it
+    if (pixelSum != 0)
+    {
+      for (int x = rowLength - 1; x >= 0; --x)
+      {
+        if (row[x] < thresholdValue && row[x] != 0)
+        {
+          row[x] = 0;
+        }
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Smooth a row with a Gaussian kernel (kernel[i] is the weight at distance i).
+  // The kernel is truncated and renormalized at the image boundary, as in vtkImageGaussianSmooth.
+  void SmoothRow(const unsigned char* input, unsigned char* output, int rowLength, const double* kernel, int radius)
+  {
+    for (int x = 0; x < rowLength; ++x)
+    {
+      int first = std::max(-radius, -x);
+      int last = std::min(radius, rowLength - 1 - x);
+      double sum = 0.0;
+      double kernelSum = 0.0;
+      for (int k = first; k <= last; ++k)
+      {
+        double weight = kernel[std::abs(k)];
+        sum += weight * input[x + k];
+        kernelSum += weight;
+      }
+      output[x] = static_cast<unsigned char>(sum / kernelSum);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Compute the Sobel gradient of a row as vtkImageSobel2D (neighbors outside the image are replaced by the center pixel),
+  // convert it to intensity as VectorImageToUchar, and binarize it as vtkImageThreshold.
+  void DetectEdgesAndBinarizeRow(const unsigned char* previousRow, const unsigned char* row, const unsigned char* nextRow, unsigned char* output,
+                                 int rowLength, double lowerThreshold, double upperThreshold, unsigned char inValue, unsigned char outValue)
+  {
+    for (int x = 0; x < rowLength; ++x)
+    {
+      int left = (x > 0 ? x - 1 : x);
+      int right = (x < rowLength - 1 ? x + 1 : x);
+      double gradient0 = 0.125 * (2.0 * (row[right] - row[left]) + (previousRow[right] + nextRow[right]) - (previousRow[left] + nextRow[left]));
+      double gradient1 = 0.125 * (2.0 * (nextRow[x] - previousRow[x]) + (nextRow[left] + nextRow[right]) - (previousRow[left] + previousRow[right]));
+      // Same conversion as in VectorImageToUchar: negative gradient values wrap around
+      unsigned char edgeDetectorOutput0 = static_cast<unsigned char>(static_cast<int>(static_cast<float>(gradient0)));
+      unsigned char edgeDetectorOutput1 = static_cast<unsigned char>(static_cast<int>(static_cast<float>(gradient1)));
+      float edgeOutput = (float)(edgeDetectorOutput0 + edgeDetectorOutput1) / (float)2;
+      unsigned char edge = (unsigned char)std::max(0, std::min(255, (int)edgeOutput));
+      output[x] = (edge >= lowerThreshold && edge <= upperThreshold) ? inValue : outValue;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Replace erodeValue pixels by dilateValue if a dilateValue pixel is within the elliptical kernel, as in vtkImageDilateErode3D
+  void DilateErode(const unsigned char* input, unsigned char* output, const int dims[2], const int kernelSize[2],
+                   unsigned char erodeValue, unsigned char dilateValue, std::vector<int>& kernelOffsets)
+  {
+    // Kernel footprint: ellipse that fits in the kernel box (x and y offsets are stored interleaved)
+    kernelOffsets.clear();
+    int size[2] = { std::max(kernelSize[0], 1), std::max(kernelSize[1], 1) };
+    for (int j = 0; j < size[1]; ++j)
+    {
+      for (int i = 0; i < size[0]; ++i)
+      {
+        double dx = (i - (size[0] - 1) * 0.5) / (size[0] * 0.5);
+        double dy = (j - (size[1] - 1) * 0.5) / (size[1] * 0.5);
+        if (dx * dx + dy * dy <= 1.0)
+        {
+          kernelOffsets.push_back(i - size[0] / 2);
+          kernelOffsets.push_back(j - size[1] / 2);
+        }
+      }
+    }
+    int numberOfKernelOffsets = static_cast<int>(kernelOffsets.size());
+
+    for (int y = 0; y < dims[1]; ++y)
+    {
+      for (int x = 0; x < dims[0]; ++x)
+      {
+        unsigned char value = input[y * dims[0] + x];
+        if (value == erodeValue)
+        {
+          for (int k = 0; k < numberOfKernelOffsets; k += 2)
+          {
+            int neighborX = x + kernelOffsets[k];
+            int neighborY = y + kernelOffsets[k + 1];
+            if (neighborX >= 0 && neighborX < dims[0] && neighborY >= 0 && neighborY < dims[1]
+                && input[neighborY * dims[0] + neighborX] == dilateValue)
+            {
+              value = dilateValue;
+              break;
+            }
+          }
+        }
+        output[y * dims[0] + x] = value;
+      }
+    }
+  }
+}
 
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkPlusBoneEnhancer);
@@ -59,7 +202,8 @@ vtkPlusBoneEnhancer::vtkPlusBoneEnhancer()
   ProcessedLinesImage(NULL),
   FirstFrame(true),
 
-  SaveIntermediateResults(false)
+  SaveIntermediateResults(false),
+  StreamingMode(false)
 {
 
   this->GaussianSmooth = vtkSmartPointer<vtkImageGaussianSmooth>::New();    // Used to smooth the image
@@ -104,6 +248,12 @@ vtkPlusBoneEnhancer::vtkPlusBoneEnhancer()
   this->LinesImage->SetExtent(0, 0, 0, 0, 0, 0);
   this->ProcessedLinesImage->SetExtent(0, 0, 0, 0, 0, 0);
 
+  this->FanImage = vtkSmartPointer<vtkImageData>::New();
+  for (int i = 0; i < 6; ++i)
+  {
+    this->LinesImageInputExtent[i] = 0;
+  }
+
   this->IntermediateImageMap.clear();
 }
 
@@ -119,12 +269,17 @@ vtkPlusBoneEnhancer::~vtkPlusBoneEnhancer()
 void vtkPlusBoneEnhancer::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "StreamingMode: " << (this->StreamingMode ? "true" : "false") << std::endl;
 }
 
 //----------------------------------------------------------------------------
-PlusStatus vtkPlusBoneEnhancer::ReadConfiguration(vtkSmartPointer<vtkXMLDataElement> processingElement)
+PlusStatus vtkPlusBoneEnhancer::ReadConfiguration(vtkXMLDataElement* processingElement)
 {
   XML_VERIFY_ELEMENT(processingElement, this->GetTagName());
+  if (this->Superclass::ReadConfiguration(processingElement) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
 
   //Read things in the ScanConversion tag
   vtkSmartPointer<vtkXMLDataElement> scanConversionElement = processingElement->FindNestedElementWithName("ScanConversion");
@@ -240,6 +395,12 @@ PlusStatus vtkPlusBoneEnhancer::ReadConfiguration(vtkSmartPointer<vtkXMLDataElem
   XML_READ_SCALAR_ATTRIBUTE_REQUIRED(int, NumberOfScanLines, processingElement);
   XML_READ_SCALAR_ATTRIBUTE_REQUIRED(int, NumberOfSamplesPerScanLine, processingElement);
 
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(StreamingMode, processingElement);
+  if (this->StreamingMode && this->SaveIntermediateResults)
+  {
+    LOG_WARNING("StreamingMode is ignored, because SaveIntermediateResults is enabled");
+  }
+
   int rfImageExtent[6] = { 0, this->NumberOfSamplesPerScanLine - 1, 0, this->NumberOfScanLines - 1, 0, 0 };
   this->ScanConverter->SetInputImageExtent(rfImageExtent);
 
@@ -248,14 +409,19 @@ PlusStatus vtkPlusBoneEnhancer::ReadConfiguration(vtkSmartPointer<vtkXMLDataElem
 
 //----------------------------------------------------------------------------
 // Writes the parameters that were used to a config file
-PlusStatus vtkPlusBoneEnhancer::WriteConfiguration(vtkSmartPointer<vtkXMLDataElement> processingElement)
+PlusStatus vtkPlusBoneEnhancer::WriteConfiguration(vtkXMLDataElement* processingElement)
 {
   XML_VERIFY_ELEMENT(processingElement, this->GetTagName());
+  if (this->Superclass::WriteConfiguration(processingElement) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
 
   //Write the parameters for filters to the scanner's properties to the output config file
   processingElement->SetAttribute("Type", this->GetProcessorTypeName());
   processingElement->SetIntAttribute("NumberOfScanLines", NumberOfScanLines);
   processingElement->SetIntAttribute("NumberOfSamplesPerScanLine", NumberOfSamplesPerScanLine);
+  XML_WRITE_BOOL_ATTRIBUTE(StreamingMode, processingElement);
 
   XML_FIND_NESTED_ELEMENT_CREATE_IF_MISSING(scanConversionElement, processingElement, "ScanConversion");
   this->ScanConverter->WriteConfiguration(scanConversionElement);
@@ -303,6 +469,9 @@ PlusStatus vtkPlusBoneEnhancer::ProcessImageExtents()
   this->LinesImage->SetExtent(linesImageExtent);
   this->LinesImage->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
 
+  this->ProcessedLinesImage->SetExtent(linesImageExtent);
+  this->ProcessedLinesImage->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+
   //Set up variables related to image extents
   int dims[3] = { 0, 0, 0 };
   this->LinesImage->GetDimensions(dims);
@@ -530,64 +699,12 @@ void vtkPlusBoneEnhancer::MarkShadowOutline(vtkSmartPointer<vtkImageData> inputI
 //a way of threasholding based on the standard deviation of a row
 void vtkPlusBoneEnhancer::ThresholdViaStdDeviation(vtkSmartPointer<vtkImageData> inputImage)
 {
-  int fatLayerToCut = 20; //The area of fat too close to the transducer should not be considered
-
-  float vInput = 0;
-  unsigned char* vOutput = 0;
-
   int dims[3] = { 0, 0, 0 };
   inputImage->GetDimensions(dims);
 
-  int max;
-
-  //values used to calculate the standard deviation
-  int pixelSum;
-  int squearSum;
-  float pixelAverage;
-  float meanDiffSum;
-  float meanDiffAverage;
-  float thresholdValue;
-
   for (int y = dims[1] - 1; y >= 0; --y)
   {
-    max = 0;
-
-    pixelSum = 0;
-    squearSum = 0;
-    pixelAverage = 0;
-
-    //determine the average, sum, and max of the row
-    for (int x = dims[0] - 1; x >= fatLayerToCut; --x)
-    {
-      vInput = inputImage->GetScalarComponentAsFloat(x, y, 0, 0);
-      pixelSum += vInput;
-      squearSum += vInput * vInput;
-
-      if (vInput > max)
-      {
-        max = vInput;
-      }
-    }
-    pixelAverage = pixelSum / (dims[0] - fatLayerToCut);
-
-    //determine the standard deviation of the row
-    meanDiffSum = squearSum + (dims[0] - fatLayerToCut) * pixelAverage * pixelAverage + (-2 * pixelAverage * pixelSum);
-    meanDiffAverage = meanDiffSum / (dims[0] - fatLayerToCut);
-    thresholdValue = max - 3 * pow(meanDiffAverage, 0.5f);
-
-
-    //if a pixel's value is too low, remove it
-    if (pixelSum != 0)
-    {
-      for (int x = dims[0] - 1; x >= 0; --x)
-      {
-        vOutput = static_cast<unsigned char*>(inputImage->GetScalarPointer(x, y, 0));
-        if (*vOutput < thresholdValue && *vOutput != 0)
-        {
-          *vOutput = 0;
-        }
-      }
-    }
+    ThresholdRowViaStdDeviation(static_cast<unsigned char*>(inputImage->GetScalarPointer(0, y, 0)), dims[0]);
   }
 }
 
@@ -625,6 +742,10 @@ void vtkPlusBoneEnhancer::ImageConjunction(vtkSmartPointer<vtkImageData> InputIm
 // Processes a given frame and marks potential bone areas.
 PlusStatus vtkPlusBoneEnhancer::ProcessFrame(igsioTrackedFrame* inputFrame, igsioTrackedFrame* outputFrame)
 {
+  if (this->StreamingMode && !this->SaveIntermediateResults)
+  {
+    return this->ProcessFrameStreaming(inputFrame, outputFrame);
+  }
   //Process the input into a linear image
   vtkSmartPointer<vtkImageData> intermediateImage = this->UnprocessedFrameToLinearImage(inputFrame);
   //Remove noise and mark all possible bones
@@ -634,6 +755,247 @@ PlusStatus vtkPlusBoneEnhancer::ProcessFrame(igsioTrackedFrame* inputFrame, igsi
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+// Same processing as ProcessFrame, but the VTK filters are not executed and no images are allocated after the first frame.
+PlusStatus vtkPlusBoneEnhancer::ProcessFrameStreaming(igsioTrackedFrame* inputFrame, igsioTrackedFrame* outputFrame)
+{
+  vtkImageData* inputImage = inputFrame->GetImageData()->GetImage();
+  if (inputImage == NULL || inputImage->GetScalarType() != VTK_UNSIGNED_CHAR || inputImage->GetNumberOfScalarComponents() != 1)
+  {
+    LOG_ERROR("Bone enhancement in streaming mode requires single-component 8-bit input images");
+    return PLUS_FAIL;
+  }
+  if (this->FirstFrame == true)
+  {
+    //set up variables for future loops
+    this->ProcessImageExtents();
+    this->FirstFrame = false;
+  }
+  this->BoneAreasInfo.clear();
+
+  int dims[3] = { 0, 0, 0 };
+  this->LinesImage->GetDimensions(dims);
+  int numberOfPixels = dims[0] * dims[1];
+
+  // Sample the input image along the scanlines
+  int* inputExtent = inputImage->GetExtent();
+  if (static_cast<int>(this->LinesImageInputOffsets.size()) != numberOfPixels || !std::equal(inputExtent, inputExtent + 6, this->LinesImageInputExtent))
+  {
+    this->UpdateLinesImageInputOffsets(inputImage);
+  }
+  const unsigned char* inputPixels = static_cast<unsigned char*>(inputImage->GetScalarPointer());
+  unsigned char* linesPixels = static_cast<unsigned char*>(this->LinesImage->GetScalarPointer());
+  for (int i = 0; i < numberOfPixels; ++i)
+  {
+    int inputOffset = this->LinesImageInputOffsets[i];
+    linesPixels[i] = (inputOffset < 0 ? 0 : inputPixels[inputOffset]);
+  }
+  this->LinesImage->Modified();
+
+  //Threashold the image based on the standard deviation of a pixel's columns
+  for (int y = dims[1] - 1; y >= 0; --y)
+  {
+    ThresholdRowViaStdDeviation(linesPixels + y * dims[0], dims[0]);
+  }
+
+  this->MorphologyImage.resize(numberOfPixels);
+  this->SmoothDetectEdgesAndBinarize(linesPixels, this->MorphologyImage.data(), dims);
+  this->RemoveIslands(this->MorphologyImage.data(), dims);
+
+  // Erode then dilate the image
+  unsigned char* binaryPixels = static_cast<unsigned char*>(this->BinaryImageForMorphology->GetScalarPointer());
+  DilateErode(this->MorphologyImage.data(), binaryPixels, dims, this->ErosionKernelSize, 255, 0, this->MorphologyKernelOffsets);
+  memcpy(this->MorphologyImage.data(), binaryPixels, numberOfPixels);
+  DilateErode(this->MorphologyImage.data(), binaryPixels, dims, this->DilationKernelSize, 0, 255, this->MorphologyKernelOffsets);
+  this->BinaryImageForMorphology->Modified();
+
+  //Detect each possible bone area, then subject it to various tests to confirm if it is valid
+  this->MarkShadowOutline(this->BinaryImageForMorphology);
+
+  //Reconvert the image back into a fan-image and return it
+  memcpy(this->ProcessedLinesImage->GetScalarPointer(), binaryPixels, numberOfPixels);
+  this->ProcessedLinesImage->Modified();
+  this->ScanConverter->SetInputData(this->ProcessedLinesImage);
+  this->ScanConverter->SetOutput(this->FanImage);
+  this->ScanConverter->Update();
+  outputFrame->GetImageData()->DeepCopyFrom(this->FanImage);
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+// Precomputes the input pixel positions that FillLinesImage samples
+void vtkPlusBoneEnhancer::UpdateLinesImageInputOffsets(vtkImageData* inputImage)
+{
+  int* linesImageExtent = this->ScanConverter->GetInputImageExtent();
+  int lineLengthPx = linesImageExtent[1] - linesImageExtent[0] + 1;
+  int numScanLines = linesImageExtent[3] - linesImageExtent[2] + 1;
+
+  int* inputExtent = inputImage->GetExtent();
+  std::copy(inputExtent, inputExtent + 6, this->LinesImageInputExtent);
+  int inputRowLength = inputExtent[1] - inputExtent[0] + 1;
+
+  this->LinesImageInputOffsets.resize(std::max(0, lineLengthPx * numScanLines));
+  for (int scanLine = 0; scanLine < numScanLines; ++scanLine)
+  {
+    double start[4] = { 0, 0, 0, 0 };
+    double end[4] = { 0, 0, 0, 0 };
+    ScanConverter->GetScanLineEndPoints(scanLine, start, end);
+
+    double directionVectorX = static_cast<double>(end[0] - start[0]) / (lineLengthPx - 1);
+    double directionVectorY = static_cast<double>(end[1] - start[1]) / (lineLengthPx - 1);
+    for (int pointIndex = 0; pointIndex < lineLengthPx; ++pointIndex)
+    {
+      int pixelCoordX = start[0] + directionVectorX * pointIndex;
+      int pixelCoordY = start[1] + directionVectorY * pointIndex;
+      if (pixelCoordX < inputExtent[0] || pixelCoordX > inputExtent[1]
+        || pixelCoordY < inputExtent[2] || pixelCoordY > inputExtent[3])
+      {
+        this->LinesImageInputOffsets[scanLine * lineLengthPx + pointIndex] = -1; // outside of the specified extent
+        continue;
+      }
+      this->LinesImageInputOffsets[scanLine * lineLengthPx + pointIndex] = (pixelCoordY - inputExtent[2]) * inputRowLength + (pixelCoordX - inputExtent[0]);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+// Separable Gaussian smoothing. The vertical pass produces one smoothed row at a time, and the edges of a row
+// are detected as soon as the next smoothed row is available, so only three smoothed rows are stored.
+void vtkPlusBoneEnhancer::SmoothDetectEdgesAndBinarize(const unsigned char* linesImage, unsigned char* binaryImage, const int dims[2])
+{
+  int rowLength = dims[0];
+  int numberOfRows = dims[1];
+
+  // Same kernel as vtkImageGaussianSmooth: the radius is the standard deviation multiplied by the radius factor
+  int radius = std::max(0, static_cast<int>(this->GaussianStdDev * this->GaussianKernelSize));
+  this->GaussianKernel.resize(radius + 1);
+  this->GaussianKernel[0] = 1.0;
+  for (int k = 1; k <= radius; ++k)
+  {
+    this->GaussianKernel[k] = exp(-static_cast<double>(k * k) / (this->GaussianStdDev * this->GaussianStdDev * 2.0));
+  }
+  const double* kernel = this->GaussianKernel.data();
+
+  this->HorizontallySmoothedImage.resize(rowLength * numberOfRows);
+  for (int y = 0; y < numberOfRows; ++y)
+  {
+    SmoothRow(linesImage + y * rowLength, this->HorizontallySmoothedImage.data() + y * rowLength, rowLength, kernel, radius);
+  }
+
+  double lowerThreshold = this->ImageBinarizer->GetLowerThreshold();
+  double upperThreshold = this->ImageBinarizer->GetUpperThreshold();
+  unsigned char inValue = static_cast<unsigned char>(this->ImageBinarizer->GetInValue());
+  unsigned char outValue = static_cast<unsigned char>(this->ImageBinarizer->GetOutValue());
+
+  this->VerticalSmoothingSums.resize(rowLength);
+  this->SmoothedRows.resize(3 * rowLength);
+  double* sums = this->VerticalSmoothingSums.data();
+  for (int y = 0; y < numberOfRows; ++y)
+  {
+    // Smoothed row y is stored in SmoothedRows at position y % 3
+    int firstRow = std::max(-radius, -y);
+    int lastRow = std::min(radius, numberOfRows - 1 - y);
+    std::fill(sums, sums + rowLength, 0.0);
+    double kernelSum = 0.0;
+    for (int k = firstRow; k <= lastRow; ++k)
+    {
+      double weight = kernel[std::abs(k)];
+      const unsigned char* row = this->HorizontallySmoothedImage.data() + (y + k) * rowLength;
+      for (int x = 0; x < rowLength; ++x)
+      {
+        sums[x] += weight * row[x];
+      }
+      kernelSum += weight;
+    }
+    unsigned char* smoothedRow = this->SmoothedRows.data() + (y % 3) * rowLength;
+    for (int x = 0; x < rowLength; ++x)
+    {
+      smoothedRow[x] = static_cast<unsigned char>(sums[x] / kernelSum);
+    }
+
+    // Edges of the previous row can be computed now
+    if (y > 0)
+    {
+      const unsigned char* previousRow = this->SmoothedRows.data() + (std::max(y - 2, 0) % 3) * rowLength;
+      const unsigned char* currentRow = this->SmoothedRows.data() + ((y - 1) % 3) * rowLength;
+      DetectEdgesAndBinarizeRow(previousRow, currentRow, smoothedRow, binaryImage + (y - 1) * rowLength, rowLength,
+        lowerThreshold, upperThreshold, inValue, outValue);
+    }
+  }
+  if (numberOfRows > 0)
+  {
+    int y = numberOfRows - 1;
+    const unsigned char* previousRow = this->SmoothedRows.data() + (std::max(y - 1, 0) % 3) * rowLength;
+    const unsigned char* currentRow = this->SmoothedRows.data() + (y % 3) * rowLength;
+    DetectEdgesAndBinarizeRow(previousRow, currentRow, currentRow, binaryImage + y * rowLength, rowLength,
+      lowerThreshold, upperThreshold, inValue, outValue);
+  }
+}
+
+//----------------------------------------------------------------------------
+// Replaces connected regions of IslandValue pixels that are smaller than AreaThreshold, as vtkImageIslandRemoval2D
+void vtkPlusBoneEnhancer::RemoveIslands(unsigned char* binaryImage, const int dims[2])
+{
+  int areaThreshold = this->IslandRemover->GetAreaThreshold();
+  if (areaThreshold <= 1)
+  {
+    // every island has at least one pixel
+    return;
+  }
+  bool squareNeighborhood = (this->IslandRemover->GetSquareNeighborhood() != 0);
+  unsigned char islandValue = static_cast<unsigned char>(this->IslandRemover->GetIslandValue());
+  unsigned char replaceValue = static_cast<unsigned char>(this->IslandRemover->GetReplaceValue());
+
+  int numberOfPixels = dims[0] * dims[1];
+  this->IslandVisitedPixels.assign(numberOfPixels, 0);
+  this->IslandPixels.resize(numberOfPixels);
+  unsigned char* visited = this->IslandVisitedPixels.data();
+  int* islandPixels = this->IslandPixels.data();
+
+  for (int seed = 0; seed < numberOfPixels; ++seed)
+  {
+    if (binaryImage[seed] != islandValue || visited[seed])
+    {
+      continue;
+    }
+    // Breadth-first fill, islandPixels is used as the queue
+    int islandSize = 0;
+    islandPixels[islandSize++] = seed;
+    visited[seed] = 1;
+    for (int head = 0; head < islandSize; ++head)
+    {
+      int x = islandPixels[head] % dims[0];
+      int y = islandPixels[head] / dims[0];
+      for (int neighborY = std::max(y - 1, 0); neighborY <= std::min(y + 1, dims[1] - 1); ++neighborY)
+      {
+        for (int neighborX = std::max(x - 1, 0); neighborX <= std::min(x + 1, dims[0] - 1); ++neighborX)
+        {
+          if (!squareNeighborhood && neighborX != x && neighborY != y)
+          {
+            // diagonal neighbors are only connected in square neighborhood
+            continue;
+          }
+          int neighbor = neighborY * dims[0] + neighborX;
+          if (binaryImage[neighbor] == islandValue && !visited[neighbor])
+          {
+            visited[neighbor] = 1;
+            islandPixels[islandSize++] = neighbor;
+          }
+        }
+      }
+    }
+    if (islandSize < areaThreshold)
+    {
+      for (int i = 0; i < islandSize; ++i)
+      {
+        binaryImage[islandPixels[i]] = replaceValue;
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
 void vtkPlusBoneEnhancer::LinearToFanImage(vtkSmartPointer<vtkImageData> inputImage, igsioTrackedFrame* outputFrame)
 {
 
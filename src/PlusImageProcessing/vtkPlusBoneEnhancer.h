@@ -40,10 +40,10 @@ public:
   virtual PlusStatus ProcessFrame(igsioTrackedFrame* inputFrame, igsioTrackedFrame* outputFrame);
 
   /*! Read configuration from xml data */
-  virtual PlusStatus ReadConfiguration(vtkSmartPointer<vtkXMLDataElement> processingElement);
+  virtual PlusStatus ReadConfiguration(vtkXMLDataElement* processingElement);
 
   /*! Write configuration to xml data */
-  virtual PlusStatus WriteConfiguration(vtkSmartPointer<vtkXMLDataElement> processingElement);
+  virtual PlusStatus WriteConfiguration(vtkXMLDataElement* processingElement);
 
   /*! Get the Type attribute of the configuration element */
   virtual const char* GetProcessorTypeName() { return "vtkPlusBoneEnhancer"; };
@@ -52,6 +52,9 @@ public:
   vtkSetMacro(IntermediateImageFileName, std::string);
   vtkSetMacro(SaveIntermediateResults, bool);
   vtkGetMacro(SaveIntermediateResults, bool);
+
+  /*! Intermediate results are collected from all frames, therefore frames can only be processed in parallel if they are not saved */
+  virtual bool IsFrameParallelProcessingSupported() { return !this->SaveIntermediateResults; };
   
   /*! Get and Set methods for variables related to the scanner used */
   vtkSetMacro(NumberOfScanLines, int);
@@ -87,6 +90,15 @@ public:
   vtkSetVector2Macro(DilationKernelSize, int);
   vtkGetVector2Macro(DilationKernelSize, int);
 
+  /*!
+    If enabled then frames are processed without executing the VTK filters, in buffers that are only allocated when the image size changes.
+    Gaussian smoothing, edge detection and binarization are computed together, scanline by scanline. The result may differ from the filter
+    pipeline by rounding. Ignored if SaveIntermediateResults is enabled, as intermediate results are taken from the filters.
+  */
+  vtkSetMacro(StreamingMode, bool);
+  vtkGetMacro(StreamingMode, bool);
+  vtkBooleanMacro(StreamingMode, bool);
+
   void ThresholdViaStdDeviation(vtkSmartPointer<vtkImageData> inputImage);
 
   vtkImageData* GetProcessedLinesImage() { return (this->ProcessedLinesImage); }
@@ -117,6 +129,18 @@ protected:
 
   virtual PlusStatus ProcessImageExtents();
 
+  /*! Process a frame without executing the VTK filters (see StreamingMode) */
+  PlusStatus ProcessFrameStreaming(igsioTrackedFrame* inputFrame, igsioTrackedFrame* outputFrame);
+
+  /*! Compute the position of each lines image pixel in the input image (-1 if outside of the input image) */
+  void UpdateLinesImageInputOffsets(vtkImageData* inputImage);
+
+  /*! Gaussian smoothing, edge detection and binarization of the lines image, with the parameters of the corresponding filters */
+  void SmoothDetectEdgesAndBinarize(const unsigned char* linesImage, unsigned char* binaryImage, const int dims[2]);
+
+  /*! Remove small islands from the binary image, with the parameters of IslandRemover */
+  void RemoveIslands(unsigned char* binaryImage, const int dims[2]);
+
 protected:
   vtkSmartPointer<vtkPlusUsScanConvert>     ScanConverter;
   vtkSmartPointer<vtkImageGaussianSmooth>   GaussianSmooth; // Trying to incorporate existing GaussianSmooth vtkThreadedAlgorithm class
@@ -165,6 +189,20 @@ protected:
   std::vector<std::map<std::string, int> > BoneAreasInfo;
   bool FirstFrame;
 
+  bool StreamingMode;
+  /*! Buffers that are used in streaming mode */
+  std::vector<int> LinesImageInputOffsets;
+  int LinesImageInputExtent[6];
+  std::vector<double> GaussianKernel;
+  std::vector<unsigned char> HorizontallySmoothedImage;
+  std::vector<double> VerticalSmoothingSums;
+  std::vector<unsigned char> SmoothedRows;
+  std::vector<unsigned char> MorphologyImage;
+  std::vector<unsigned char> IslandVisitedPixels;
+  std::vector<int> IslandPixels;
+  std::vector<int> MorphologyKernelOffsets;
+  vtkSmartPointer<vtkImageData> FanImage;
+
 private:
   vtkPlusBoneEnhancer(const vtkPlusBoneEnhancer&);  // Not implemented.
   void operator=(const vtkPlusBoneEnhancer&);  // Not implemented.
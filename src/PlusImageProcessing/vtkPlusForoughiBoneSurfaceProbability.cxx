@@ -18,7 +18,9 @@ See License.txt for details.
 #include <vtkTimerLog.h>
 
 // STD includes
+#include <algorithm>
 #include <cassert>
+#include <cfloat>
 
 // Other includes
 #include "mkl.h"
@@ -35,6 +37,14 @@ See License.txt for details.
 
 vtkStandardNewMacro(vtkPlusForoughiBoneSurfaceProbability);
 
+namespace
+{
+  // Number of adjacent columns that are processed together (a multiple of the SIMD width, small enough to stay in cache)
+  const int COLUMN_BLOCK_SIZE = 64;
+  // The shadow model is zero for the last rows of the image
+  const int SHADOW_MODEL_ZERO_ROWS = 5;
+}
+
 //----------------------------------------------------------------------------
 vtkPlusForoughiBoneSurfaceProbability::vtkPlusForoughiBoneSurfaceProbability()
 {
@@ -61,6 +71,11 @@ vtkPlusForoughiBoneSurfaceProbability::vtkPlusForoughiBoneSurfaceProbability()
   this->MklShadowModel = NULL;
   this->MklGaussianKernel = NULL;
   this->MklLaplacianKernel = NULL;
+  this->MklShadowIntensitySumBuffer = NULL;
+  this->MklShadowCorrectionBuffer = NULL;
+  this->MklShadowModelSum = NULL;
+  this->MklShadowCorrectionKernel = NULL;
+  this->ShadowCorrectionKernelSize = 0;
 }
 
 //----------------------------------------------------------------------------
@@ -99,7 +114,6 @@ void vtkPlusForoughiBoneSurfaceProbability::SimpleExecute(vtkImageData* input, v
 
   int* dims = input->GetDimensions();
   unsigned int nx = this->FrameSize[0];
-  unsigned int ny = this->FrameSize[1];
   unsigned int sliceSize = this->FrameSize[0] * this->FrameSize[1];
 
   vtkSmartPointer<vtkTimerLog> timer = vtkSmartPointer<vtkTimerLog>::New();
@@ -132,54 +146,17 @@ void vtkPlusForoughiBoneSurfaceProbability::SimpleExecute(vtkImageData* input, v
       timer->StopTimer();
       LOG_INFO("Conv2 2: " << timer->GetElapsedTime());
 
-      // Main loop calculating reflection number and shadow value
+      // Main loop calculating reflection number and shadow value, bands of columns are processed in parallel
       timer->StartTimer();
-      double sumG = 0;
-      double sumGI = 0;
-      double sumHist = 0;
-      int i, pixelIdx, x, y;
+      int numberOfColumnBlocks = (nx + COLUMN_BLOCK_SIZE - 1) / COLUMN_BLOCK_SIZE;
 #ifdef NDEBUG
-      #pragma omp parallel for reduction(+:sumG,sumGI, sumHist), private(i, x, pixelIdx)
+      #pragma omp parallel for
 #endif
-      for (y = 0; y < ny; ++y)
+      for (int blockIdx = 0; blockIdx < numberOfColumnBlocks; ++blockIdx)
       {
-        for (x = 0; x < nx; ++x)
-        {
-          pixelIdx = x + y * nx;
-
-          // Only include pixels with intensity value larger than a specified threshold
-          if (this->MklGaussianBuffer[pixelIdx] >= this->BoneThreshold && pixelIdx > this->TransducerMargin * nx)
-          {
-            // Set outermost border pixels to zero and exclude negative pixels
-            if ((x == nx - 1 || x == 0 || y == ny - 1 || y == 0) || this->MklLaplacianOfGaussianBuffer[pixelIdx] <= 0)
-            {
-              this->MklLaplacianOfGaussianBuffer[pixelIdx] = 0.0;
-            }
-            else
-            {
-              // Divide by small number to increase image intensity (What! :)
-              this->MklLaplacianOfGaussianBuffer[pixelIdx] = this->MklLaplacianOfGaussianBuffer[pixelIdx] / 0.005;
-            }
-
-            // Calculate reflection number
-            this->MklReflectionNumberBuffer[pixelIdx] = pow(this->MklGaussianBuffer[pixelIdx], this->BlurredVSBLoG) + this->MklLaplacianOfGaussianBuffer[pixelIdx];
-
-            // Calculate shadow value
-            sumG = 0;
-            sumGI = 0;
-            for (i = y; i < ny; ++i)
-            {
-              sumG += this->MklShadowModel[i - y];
-              sumGI += this->MklShadowModel[i - y] * this->MklGaussianBuffer[x + i * nx];
-            }
-            this->MklShadowValueBuffer[pixelIdx] = sumGI / sumG;
-          }
-          else
-          {
-            this->MklReflectionNumberBuffer[pixelIdx] = 0.0;
-            this->MklShadowValueBuffer[pixelIdx] = 0.0;
-          }
-        }
+        int firstColumn = blockIdx * COLUMN_BLOCK_SIZE;
+        int lastColumn = std::min(firstColumn + COLUMN_BLOCK_SIZE, static_cast<int>(nx)) - 1;
+        ComputeReflectionAndShadowValues(firstColumn, lastColumn);
       }
 
       timer->StopTimer();
@@ -225,6 +202,10 @@ void vtkPlusForoughiBoneSurfaceProbability::UpdateKernels()
   this->MklShadowModel = (double*)mkl_malloc(this->FrameSize[1] * sizeof(double), 64);
   this->MklGaussianKernel = (double*)mkl_malloc(GaussianKernelSize * GaussianKernelSize * sizeof(double), 64);
   this->MklLaplacianKernel = (double*)mkl_malloc(3 * 3 * sizeof(double), 64);
+  this->MklShadowIntensitySumBuffer = (double*)mkl_malloc(this->FrameSize[0] * sizeof(double), 64);
+  this->MklShadowCorrectionBuffer = (double*)mkl_malloc(this->FrameSize[0] * sizeof(double), 64);
+  this->MklShadowModelSum = (double*)mkl_malloc(this->FrameSize[1] * sizeof(double), 64);
+  this->MklShadowCorrectionKernel = (double*)mkl_malloc(this->FrameSize[1] * sizeof(double), 64);
 
   // Calculate shadow model
   for (int i = 0; i < this->FrameSize[1]; ++i)
@@ -239,6 +220,27 @@ void vtkPlusForoughiBoneSurfaceProbability::UpdateKernels()
     }
   }
 
+  // Cumulative sum of the shadow model, in the same order as the shadow value computation would sum it
+  double shadowModelSum = 0.0;
+  for (int i = 0; i < this->FrameSize[1]; ++i)
+  {
+    shadowModelSum += this->MklShadowModel[i];
+    this->MklShadowModelSum[i] = shadowModelSum;
+  }
+
+  // The shadow model is 1-exp(...), the exponential term quickly becomes negligible, so only a few rows need correction
+  this->ShadowCorrectionKernelSize = 0;
+  for (int i = 0; i < this->FrameSize[1] - SHADOW_MODEL_ZERO_ROWS; ++i)
+  {
+    double correction = 1 - this->MklShadowModel[i];
+    if (i > 1 && correction < DBL_EPSILON)
+    {
+      break;
+    }
+    this->MklShadowCorrectionKernel[i] = correction;
+    this->ShadowCorrectionKernelSize = i + 1;
+  }
+
   // Calculate Gaussian kernel
   int idx = 0;
   int intervall = (GaussianKernelSize - 1) / 2;
@@ -276,6 +278,135 @@ void vtkPlusForoughiBoneSurfaceProbability::DeleteKernels()
   MKL_FREE_IF_NULL(this->MklShadowModel);
   MKL_FREE_IF_NULL(this->MklGaussianKernel);
   MKL_FREE_IF_NULL(this->MklLaplacianKernel);
+  MKL_FREE_IF_NULL(this->MklShadowIntensitySumBuffer);
+  MKL_FREE_IF_NULL(this->MklShadowCorrectionBuffer);
+  MKL_FREE_IF_NULL(this->MklShadowModelSum);
+  MKL_FREE_IF_NULL(this->MklShadowCorrectionKernel);
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusForoughiBoneSurfaceProbability::ComputeReflectionAndShadowValues(int firstColumn, int lastColumn)
+{
+  const int nx = static_cast<int>(this->FrameSize[0]);
+  const int ny = static_cast<int>(this->FrameSize[1]);
+  const double* blurred = this->MklGaussianBuffer;
+  double* intensitySum = this->MklShadowIntensitySumBuffer;
+  double* correction = this->MklShadowCorrectionBuffer;
+  // Pixels with index not larger than this are in the transducer margin
+  const int lastMarginPixelIdx = this->TransducerMargin * nx;
+
+  for (int x = firstColumn; x <= lastColumn; ++x)
+  {
+    intensitySum[x] = 0.0;
+  }
+
+  for (int y = ny - 1; y >= 0; --y)
+  {
+    const double* blurredRow = blurred + y * nx;
+    for (int x = firstColumn; x <= lastColumn; ++x)
+    {
+      intensitySum[x] += blurredRow[x];
+    }
+    if (y * nx + lastColumn <= lastMarginPixelIdx)
+    {
+      // the rest of the column band is in the transducer margin
+      for (int yMargin = y; yMargin >= 0; --yMargin)
+      {
+        for (int x = firstColumn; x <= lastColumn; ++x)
+        {
+          this->MklReflectionNumberBuffer[x + yMargin * nx] = 0.0;
+          this->MklShadowValueBuffer[x + yMargin * nx] = 0.0;
+        }
+      }
+      break;
+    }
+
+    // Only include pixels with intensity value larger than a specified threshold
+    int numberOfIncludedPixels = 0;
+    for (int x = firstColumn; x <= lastColumn; ++x)
+    {
+      int pixelIdx = x + y * nx;
+      if (blurredRow[x] >= this->BoneThreshold && pixelIdx > lastMarginPixelIdx)
+      {
+        ++numberOfIncludedPixels;
+      }
+    }
+
+    // Sum of the shadow model weighted intensities is the intensity sum minus the correction term.
+    // If many pixels of the row are included then the correction term is computed for the whole row at once,
+    // otherwise only for the included pixels.
+    bool shadowModelTruncated = (y < SHADOW_MODEL_ZERO_ROWS);
+    int numberOfCorrectionRows = std::min(this->ShadowCorrectionKernelSize, ny - y);
+    bool rowCorrection = (!shadowModelTruncated && numberOfIncludedPixels * 4 >= lastColumn - firstColumn + 1);
+    if (rowCorrection)
+    {
+      for (int x = firstColumn; x <= lastColumn; ++x)
+      {
+        correction[x] = 0.0;
+      }
+      for (int i = 0; i < numberOfCorrectionRows; ++i)
+      {
+        const double weight = this->MklShadowCorrectionKernel[i];
+        const double* correctionRow = blurred + (y + i) * nx;
+        for (int x = firstColumn; x <= lastColumn; ++x)
+        {
+          correction[x] += weight * correctionRow[x];
+        }
+      }
+    }
+    const double sumG = this->MklShadowModelSum[ny - 1 - y];
+
+    for (int x = firstColumn; x <= lastColumn; ++x)
+    {
+      int pixelIdx = x + y * nx;
+
+      if (blurred[pixelIdx] >= this->BoneThreshold && pixelIdx > lastMarginPixelIdx)
+      {
+        // Set outermost border pixels to zero and exclude negative pixels
+        if ((x == nx - 1 || x == 0 || y == ny - 1 || y == 0) || this->MklLaplacianOfGaussianBuffer[pixelIdx] <= 0)
+        {
+          this->MklLaplacianOfGaussianBuffer[pixelIdx] = 0.0;
+        }
+        else
+        {
+          // Divide by small number to increase image intensity (What! :)
+          this->MklLaplacianOfGaussianBuffer[pixelIdx] = this->MklLaplacianOfGaussianBuffer[pixelIdx] / 0.005;
+        }
+
+        // Calculate reflection number
+        this->MklReflectionNumberBuffer[pixelIdx] = pow(blurred[pixelIdx], this->BlurredVSBLoG) + this->MklLaplacianOfGaussianBuffer[pixelIdx];
+
+        // Calculate shadow value
+        if (shadowModelTruncated)
+        {
+          // the shadow model is zero at the bottom rows, sum directly
+          double sumGI = 0;
+          for (int i = y; i < ny; ++i)
+          {
+            sumGI += this->MklShadowModel[i - y] * blurred[x + i * nx];
+          }
+          this->MklShadowValueBuffer[pixelIdx] = sumGI / sumG;
+        }
+        else
+        {
+          if (!rowCorrection)
+          {
+            correction[x] = 0.0;
+            for (int i = 0; i < numberOfCorrectionRows; ++i)
+            {
+              correction[x] += this->MklShadowCorrectionKernel[i] * blurred[x + (y + i) * nx];
+            }
+          }
+          this->MklShadowValueBuffer[pixelIdx] = (intensitySum[x] - correction[x]) / sumG;
+        }
+      }
+      else
+      {
+        this->MklReflectionNumberBuffer[pixelIdx] = 0.0;
+        this->MklShadowValueBuffer[pixelIdx] = 0.0;
+      }
+    }
+  }
 }
 
 //-----------------------------------------------------------------------------
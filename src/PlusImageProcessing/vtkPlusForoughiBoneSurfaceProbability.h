@@ -75,6 +75,14 @@ protected:
   double GetMaxPixelValue(const double* buffer, int size);
   void Normalize(double* buffer, int size, bool doInverse, double maxValue = 1.0);
 
+  /*!
+    Compute reflection numbers and shadow values in the columns [firstColumn, lastColumn] of the current slice.
+    Columns are scanned from the bottom of the image, so that the sum of the blurred intensities below each pixel is maintained
+    as a running sum. The shadow value is computed from this sum and a correction term that only covers the few rows where
+    the shadow model differs from 1. Rows of a column band are processed together, so the inner loops are vectorized.
+  */
+  void ComputeReflectionAndShadowValues(int firstColumn, int lastColumn);
+
   virtual void SimpleExecute(vtkImageData* input, vtkImageData* output);
 
   int BlurredVSBLoG;
@@ -99,6 +107,16 @@ protected:
   double* MklGaussianKernel;
   double* MklLaplacianKernel;
 
+  /*! Sum of the blurred intensities from the current row to the bottom of the image, for each column */
+  double* MklShadowIntensitySumBuffer;
+  /*! Shadow model correction term of the current row, for each column */
+  double* MklShadowCorrectionBuffer;
+  /*! MklShadowModelSum[i] is the sum of MklShadowModel[0..i] */
+  double* MklShadowModelSum;
+  /*! 1-MklShadowModel, truncated where it becomes negligible */
+  double* MklShadowCorrectionKernel;
+  int ShadowCorrectionKernelSize;
+
 private:
   vtkPlusForoughiBoneSurfaceProbability(const vtkPlusForoughiBoneSurfaceProbability&);  // Not implemented.
   void operator=(const vtkPlusForoughiBoneSurfaceProbability&);  // Not implemented.
@@ -12,6 +12,14 @@ See License.txt for details.
 #include "vtkPlusUsScanConvertLinear.h"
 #include "vtkPlusUsScanConvertCurvilinear.h"
 #include "vtkImageData.h"
+#include "vtkMultiThreader.h"
+#include "vtkPointData.h"
+
+#include <algorithm>
+
+#ifdef PLUS_USE_OPENCL
+#include "vtkPlusRfProcessorOpenCL.h"
+#endif
 
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkPlusRfProcessor);
@@ -19,11 +27,79 @@ vtkStandardNewMacro(vtkPlusRfProcessor);
 const char* vtkPlusRfProcessor::RF_PROCESSOR_TAG_NAME = "RfProcessing";
 //----------------------------------------------------------------------------
 
+//----------------------------------------------------------------------------
+struct vtkPlusRfProcessor::FusedScanConversionPlan
+{
+  /*! Interpolation table that the plan is computed from */
+  std::shared_ptr<const vtkPlusUsScanConvertCurvilinear::InterpolationTable> Table;
+  /*! Number of samples in a B-mode scanline */
+  int NumberOfSamples;
+  /*! Number of B-mode scanlines */
+  int NumberOfScanlines;
+  /*! Interpolation table point indices, ordered by the B-mode scanline of the first input pixel of the point */
+  std::vector<int> PointIndices;
+  /*! Points that are interpolated between scanline i and i+1 are PointIndices[ScanlinePointsStart[i]] ... PointIndices[ScanlinePointsStart[i+1]-1] */
+  std::vector<int> ScanlinePointsStart;
+  /*! First and last B-mode sample of each scanline that is used by any point (first>last if the scanline is not used at all) */
+  std::vector<int> FirstUsedSample;
+  std::vector<int> LastUsedSample;
+
+  /*! Group the points of the table by scanline. Returns PLUS_FAIL if the table refers to pixels outside the B-mode image. */
+  PlusStatus Compute(const std::shared_ptr<const vtkPlusUsScanConvertCurvilinear::InterpolationTable>& table, int numberOfSamples, int numberOfScanlines)
+  {
+    this->Table = table;
+    this->NumberOfSamples = numberOfSamples;
+    this->NumberOfScanlines = numberOfScanlines;
+    const int* inputPixelIndices = table->InputPixelIndices.data();
+    int numberOfPoints = table->GetNumberOfPoints();
+
+    // Counting sort of the points by scanline
+    this->ScanlinePointsStart.assign(numberOfScanlines + 1, 0);
+    this->FirstUsedSample.assign(numberOfScanlines, numberOfSamples);
+    this->LastUsedSample.assign(numberOfScanlines, -1);
+    for (int i = 0; i < numberOfPoints; ++i)
+    {
+      int scanline = inputPixelIndices[i] / numberOfSamples;
+      int sample = inputPixelIndices[i] - scanline * numberOfSamples;
+      if (inputPixelIndices[i] < 0 || scanline + 1 >= numberOfScanlines || sample + 1 >= numberOfSamples)
+      {
+        // the 4 input pixels of the point are not all inside the B-mode image
+        return PLUS_FAIL;
+      }
+      this->ScanlinePointsStart[scanline + 1]++;
+      for (int usedScanline = scanline; usedScanline <= scanline + 1; ++usedScanline)
+      {
+        this->FirstUsedSample[usedScanline] = std::min(this->FirstUsedSample[usedScanline], sample);
+        this->LastUsedSample[usedScanline] = std::max(this->LastUsedSample[usedScanline], sample + 1);
+      }
+    }
+    for (int scanline = 0; scanline < numberOfScanlines; ++scanline)
+    {
+      this->ScanlinePointsStart[scanline + 1] += this->ScanlinePointsStart[scanline];
+    }
+    std::vector<int> nextPointPosition(this->ScanlinePointsStart.begin(), this->ScanlinePointsStart.end() - 1);
+    this->PointIndices.resize(numberOfPoints);
+    for (int i = 0; i < numberOfPoints; ++i)
+    {
+      // keep the original order of the points within a scanline, so the output image is written mostly sequentially
+      this->PointIndices[nextPointPosition[inputPixelIndices[i] / numberOfSamples]++] = i;
+    }
+    return PLUS_SUCCESS;
+  }
+};
+
+
 //----------------------------------------------------------------------------
 vtkPlusRfProcessor::vtkPlusRfProcessor()
 {
   this->RfToBrightnessConverter=vtkPlusRfToBrightnessConvert::New();
   this->ScanConverter=NULL;  
+  this->Backend=BACKEND_CPU;
+  this->OpenCLProcessor=NULL;
+  this->OpenCLOutputImage=NULL;
+  this->FusedProcessing=false;
+  this->FusedProcessingThreader=NULL;
+  this->FusedOutputImage=NULL;
 }
 
 //----------------------------------------------------------------------------
@@ -32,12 +108,36 @@ vtkPlusRfProcessor::~vtkPlusRfProcessor()
   SetScanConverter(NULL);
   this->RfToBrightnessConverter->Delete();
   this->RfToBrightnessConverter=NULL;  
+#ifdef PLUS_USE_OPENCL
+  if (this->OpenCLProcessor!=NULL)
+  {
+    this->OpenCLProcessor->Delete();
+    this->OpenCLProcessor=NULL;
+  }
+#endif
+  if (this->OpenCLOutputImage!=NULL)
+  {
+    this->OpenCLOutputImage->Delete();
+    this->OpenCLOutputImage=NULL;
+  }
+  if (this->FusedProcessingThreader!=NULL)
+  {
+    this->FusedProcessingThreader->Delete();
+    this->FusedProcessingThreader=NULL;
+  }
+  if (this->FusedOutputImage!=NULL)
+  {
+    this->FusedOutputImage->Delete();
+    this->FusedOutputImage=NULL;
+  }
 }
 
 //----------------------------------------------------------------------------
 void vtkPlusRfProcessor::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os,indent);
+  os << indent << "Backend: " << (this->Backend==BACKEND_OPENCL ? "OpenCL" : "CPU") << std::endl;
+  os << indent << "FusedProcessing: " << (this->FusedProcessing ? "true" : "false") << std::endl;
 }
 
 //-----------------------------------------------------------------------------
@@ -51,6 +151,14 @@ PlusStatus vtkPlusRfProcessor::SetRfFrame(vtkImageData* rfFrame, US_IMAGE_TYPE i
 //-----------------------------------------------------------------------------
 vtkImageData* vtkPlusRfProcessor::GetBrightnessConvertedImage()
 {
+  if (this->Backend==BACKEND_OPENCL)
+  {
+    vtkImageData* outputImage=ProcessFrameOpenCL(NULL);
+    if (outputImage!=NULL)
+    {
+      return outputImage;
+    }
+  }
   this->RfToBrightnessConverter->Update();
   return this->RfToBrightnessConverter->GetOutput();
 }
@@ -63,10 +171,240 @@ vtkImageData* vtkPlusRfProcessor::GetBrightnessScanConvertedImage()
     LOG_ERROR("Scan converter is not defined, skipping scan conversion");
     return GetBrightnessConvertedImage();
   }
+  if (this->Backend==BACKEND_OPENCL)
+  {
+    vtkImageData* outputImage=ProcessFrameOpenCL(this->ScanConverter);
+    if (outputImage!=NULL)
+    {
+      return outputImage;
+    }
+  }
+  if (this->FusedProcessing)
+  {
+    vtkImageData* outputImage=ProcessFrameFused();
+    if (outputImage!=NULL)
+    {
+      return outputImage;
+    }
+  }
   this->ScanConverter->Update();
   return this->ScanConverter->GetOutput();
 }
 
+//-----------------------------------------------------------------------------
+vtkImageData* vtkPlusRfProcessor::ProcessFrameOpenCL(vtkPlusUsScanConvert* scanConverter)
+{
+#ifdef PLUS_USE_OPENCL
+  if (this->OpenCLProcessor==NULL)
+  {
+    this->OpenCLProcessor=vtkPlusRfProcessorOpenCL::New();
+  }
+  if (!this->OpenCLProcessor->IsInitialized() && this->OpenCLProcessor->Initialize()!=PLUS_SUCCESS)
+  {
+    LOG_WARNING("OpenCL processing is not available, RF processing is performed on the CPU");
+    this->Backend=BACKEND_CPU;
+    return NULL;
+  }
+  if (this->OpenCLOutputImage==NULL)
+  {
+    this->OpenCLOutputImage=vtkImageData::New();
+  }
+  vtkImageData* rfFrame=vtkImageData::SafeDownCast(this->RfToBrightnessConverter->GetInput());
+  if (this->OpenCLProcessor->ProcessFrame(rfFrame, this->RfToBrightnessConverter->GetImageType(),
+    this->RfToBrightnessConverter, scanConverter, this->OpenCLOutputImage)!=PLUS_SUCCESS)
+  {
+    LOG_WARNING("OpenCL processing failed, RF processing is performed on the CPU");
+    this->Backend=BACKEND_CPU;
+    return NULL;
+  }
+  return this->OpenCLOutputImage;
+#else
+  LOG_WARNING("Plus is built without OpenCL support (PLUS_USE_OPENCL), RF processing is performed on the CPU");
+  this->Backend=BACKEND_CPU;
+  return NULL;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+vtkImageData* vtkPlusRfProcessor::ProcessFrameFused()
+{
+  vtkPlusUsScanConvertCurvilinear* scanConverter=vtkPlusUsScanConvertCurvilinear::SafeDownCast(this->ScanConverter);
+  vtkImageData* rfFrame=vtkImageData::SafeDownCast(this->RfToBrightnessConverter->GetInput());
+  if (scanConverter==NULL || rfFrame==NULL)
+  {
+    // Linear scan conversion uses vtkImageReslice, which needs the whole brightness converted image
+    return NULL;
+  }
+
+  int rfExtent[6]={0,-1,0,-1,0,-1};
+  rfFrame->GetExtent(rfExtent);
+  int brightnessExtent[6]={0,-1,0,-1,0,-1};
+  if (vtkPlusRfToBrightnessConvert::GetBrightnessImageExtent(this->RfToBrightnessConverter->GetImageType(), rfExtent, brightnessExtent)!=PLUS_SUCCESS
+    || brightnessExtent[4]!=brightnessExtent[5])
+  {
+    return NULL;
+  }
+  int numberOfSamples=brightnessExtent[1]-brightnessExtent[0]+1;
+  int numberOfScanlines=brightnessExtent[3]-brightnessExtent[2]+1;
+  if (numberOfSamples<2 || numberOfScanlines<2)
+  {
+    return NULL;
+  }
+
+  scanConverter->SetInputImageExtent(brightnessExtent);
+  std::shared_ptr<const vtkPlusUsScanConvertCurvilinear::InterpolationTable> table=scanConverter->GetInterpolationTableForInputExtent(brightnessExtent);
+  bool planChanged=false;
+  if (!this->FusedPlan || this->FusedPlan->Table!=table)
+  {
+    std::shared_ptr<FusedScanConversionPlan> plan=std::make_shared<FusedScanConversionPlan>();
+    if (plan->Compute(table, numberOfSamples, numberOfScanlines)!=PLUS_SUCCESS)
+    {
+      LOG_WARNING("Scan conversion parameters are not supported by fused RF processing, brightness and scan conversion are computed separately");
+      this->FusedPlan.reset();
+      this->FusedProcessing=false;
+      return NULL;
+    }
+    this->FusedPlan=plan;
+    planChanged=true;
+  }
+
+  this->RfToBrightnessConverter->PrepareBrightnessScanlineComputation(rfExtent[1]-rfExtent[0]+1);
+
+  if (this->FusedOutputImage==NULL)
+  {
+    this->FusedOutputImage=vtkImageData::New();
+  }
+  int* outputExtent=scanConverter->GetOutputImageExtent();
+  int* currentOutputExtent=this->FusedOutputImage->GetExtent();
+  if (planChanged || this->FusedOutputImage->GetScalarType()!=VTK_UNSIGNED_CHAR || this->FusedOutputImage->GetPointData()->GetScalars()==NULL
+    || !std::equal(outputExtent, outputExtent+6, currentOutputExtent))
+  {
+    // Pixels outside the fan are never written, so they only have to be cleared when the set of fan pixels may change
+    this->FusedOutputImage->SetExtent(outputExtent);
+    // In Plus the convention is that the image coordinate system has always unit spacing and zero origin
+    this->FusedOutputImage->SetSpacing(1.0, 1.0, 1.0);
+    this->FusedOutputImage->SetOrigin(0.0, 0.0, 0.0);
+    this->FusedOutputImage->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+    memset(this->FusedOutputImage->GetScalarPointer(), 0, this->FusedOutputImage->GetNumberOfPoints());
+  }
+
+  if (this->FusedProcessingThreader==NULL)
+  {
+    this->FusedProcessingThreader=vtkMultiThreader::New();
+  }
+  // Each thread processes a band of scanlines, so each thread needs at least a few scanlines
+  int numberOfThreads=std::max(1, std::min(vtkMultiThreader::GetGlobalDefaultNumberOfThreads(), numberOfScanlines/4));
+  this->FusedThreadStatus.assign(numberOfThreads, PLUS_SUCCESS);
+  this->FusedProcessingThreader->SetNumberOfThreads(numberOfThreads);
+  this->FusedProcessingThreader->SetSingleMethod((vtkThreadFunctionType)&FusedProcessingThread, this);
+  this->FusedProcessingThreader->SingleMethodExecute();
+
+  if (std::find(this->FusedThreadStatus.begin(), this->FusedThreadStatus.end(), PLUS_FAIL)!=this->FusedThreadStatus.end())
+  {
+    LOG_WARNING("Fused RF processing failed, brightness and scan conversion are computed separately");
+    this->FusedProcessing=false;
+    return NULL;
+  }
+  this->FusedOutputImage->Modified();
+  return this->FusedOutputImage;
+}
+
+//-----------------------------------------------------------------------------
+void* vtkPlusRfProcessor::FusedProcessingThread(vtkMultiThreader::ThreadInfo* data)
+{
+  vtkPlusRfProcessor* self=static_cast<vtkPlusRfProcessor*>(data->UserData);
+  int numberOfScanlines=self->FusedPlan->NumberOfScanlines;
+  int firstScanline=numberOfScanlines*data->ThreadID/data->NumberOfThreads;
+  int lastScanline=numberOfScanlines*(data->ThreadID+1)/data->NumberOfThreads-1;
+  self->FusedThreadStatus[data->ThreadID]=self->ProcessFusedScanlines(firstScanline, lastScanline);
+  return NULL;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusRfProcessor::ProcessFusedScanlines(int firstScanline, int lastScanline)
+{
+  const FusedScanConversionPlan& plan=*this->FusedPlan;
+  const vtkPlusUsScanConvertCurvilinear::InterpolationTable& table=*plan.Table;
+  vtkPlusUsScanConvertCurvilinear* scanConverter=vtkPlusUsScanConvertCurvilinear::SafeDownCast(this->ScanConverter);
+  vtkImageData* rfFrame=vtkImageData::SafeDownCast(this->RfToBrightnessConverter->GetInput());
+  // Same condition as in vtkPlusUsScanConvertCurvilinear, fixed-point weights are only computed for unit intensity scaling
+  bool fixedPointInterpolation=scanConverter->GetFixedPointInterpolation() && scanConverter->GetOutputIntensityScaling()==1.0;
+
+  const int* inputPixelIndices=table.InputPixelIndices.data();
+  const int* outputPixelIndices=table.OutputPixelIndices.data();
+  unsigned char* outputPixels=static_cast<unsigned char*>(this->FusedOutputImage->GetScalarPointer());
+
+  // Scanline i is stored in buffer i%2, so that the two scanlines that a point is interpolated from are both available
+  std::vector<unsigned char> scanlineBuffers[2]={ std::vector<unsigned char>(plan.NumberOfSamples), std::vector<unsigned char>(plan.NumberOfSamples) };
+  int bufferedScanline[2]={-1, -1};
+  std::vector< std::complex<double> > workspace;
+
+  for (int scanline=firstScanline; scanline<=lastScanline; ++scanline)
+  {
+    int firstPoint=plan.ScanlinePointsStart[scanline];
+    int endPoint=plan.ScanlinePointsStart[scanline+1];
+    if (firstPoint==endPoint)
+    {
+      // no output pixels between this scanline and the next one
+      continue;
+    }
+    for (int usedScanline=scanline; usedScanline<=scanline+1; ++usedScanline)
+    {
+      if (bufferedScanline[usedScanline%2]==usedScanline)
+      {
+        continue;
+      }
+      if (this->RfToBrightnessConverter->ComputeBrightnessScanline(rfFrame, usedScanline, plan.FirstUsedSample[usedScanline], plan.LastUsedSample[usedScanline],
+        scanlineBuffers[usedScanline%2].data(), workspace)!=PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+      bufferedScanline[usedScanline%2]=usedScanline;
+    }
+
+    const unsigned char* currentScanline=scanlineBuffers[scanline%2].data();
+    const unsigned char* nextScanline=scanlineBuffers[(scanline+1)%2].data();
+    int scanlineStartPixelIndex=scanline*plan.NumberOfSamples;
+    if (fixedPointInterpolation)
+    {
+      const unsigned short* w0=table.FixedPointWeightCoefficients[0].data();
+      const unsigned short* w1=table.FixedPointWeightCoefficients[1].data();
+      const unsigned short* w2=table.FixedPointWeightCoefficients[2].data();
+      const unsigned short* w3=table.FixedPointWeightCoefficients[3].data();
+      for (int pointPosition=firstPoint; pointPosition<endPoint; ++pointPosition)
+      {
+        int i=plan.PointIndices[pointPosition];
+        int sample=inputPixelIndices[i]-scanlineStartPixelIndex;
+        unsigned int value=w0[i]*static_cast<unsigned int>(currentScanline[sample])
+          + w1[i]*static_cast<unsigned int>(currentScanline[sample+1])
+          + w2[i]*static_cast<unsigned int>(nextScanline[sample])
+          + w3[i]*static_cast<unsigned int>(nextScanline[sample+1])
+          + vtkPlusUsScanConvertCurvilinear::FIXED_POINT_WEIGHT_SCALE/2; // for rounding
+        outputPixels[outputPixelIndices[i]]=static_cast<unsigned char>(value>>15);
+      }
+    }
+    else
+    {
+      const double* w0=table.WeightCoefficients[0].data();
+      const double* w1=table.WeightCoefficients[1].data();
+      const double* w2=table.WeightCoefficients[2].data();
+      const double* w3=table.WeightCoefficients[3].data();
+      for (int pointPosition=firstPoint; pointPosition<endPoint; ++pointPosition)
+      {
+        int i=plan.PointIndices[pointPosition];
+        int sample=inputPixelIndices[i]-scanlineStartPixelIndex;
+        outputPixels[outputPixelIndices[i]]=static_cast<unsigned char>(
+          w0[i]*currentScanline[sample]
+          + w1[i]*currentScanline[sample+1]
+          + w2[i]*nextScanline[sample]
+          + w3[i]*nextScanline[sample+1]
+          + 0.5); // for rounding
+      }
+    }
+  }
+  return PLUS_SUCCESS;
+}
+
 //-----------------------------------------------------------------------------
 void vtkPlusRfProcessor::SetScanConverter(vtkPlusUsScanConvert* scanConverter)
 {
@@ -94,6 +432,9 @@ PlusStatus vtkPlusRfProcessor::ReadConfiguration(vtkXMLDataElement* rfProcessing
 
   PlusStatus status=PLUS_SUCCESS;
 
+  XML_READ_ENUM2_ATTRIBUTE_OPTIONAL(Backend, rfProcessingElement, "CPU", BACKEND_CPU, "OpenCL", BACKEND_OPENCL);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(FusedProcessing, rfProcessingElement);
+
   vtkXMLDataElement* brightnessConversionElement = rfProcessingElement->FindNestedElementWithName("RfToBrightnessConversion"); 
   if (brightnessConversionElement)
   {
@@ -168,6 +509,16 @@ PlusStatus vtkPlusRfProcessor::WriteConfiguration(vtkXMLDataElement* rfElement)
 
   PlusStatus status(PLUS_SUCCESS);
 
+  if (this->Backend==BACKEND_OPENCL)
+  {
+    rfElement->SetAttribute("Backend", "OpenCL");
+  }
+  else
+  {
+    rfElement->RemoveAttribute("Backend");
+  }
+  XML_WRITE_BOOL_ATTRIBUTE(FusedProcessing, rfElement);
+
   if ( this->RfToBrightnessConverter->WriteConfiguration(brightnessConversionElement) != PLUS_SUCCESS )
   {
     status = PLUS_FAIL;
@@ -8,7 +8,11 @@
 #define __vtkPlusRfProcessor_h
 
 #include "vtkPlusImageProcessingExport.h"
+#include "vtkMultiThreader.h"
 
+#include <memory>
+
+class vtkPlusRfProcessorOpenCL;
 class vtkPlusRfToBrightnessConvert;
 class vtkPlusUsScanConvert;
 class vtkImageData;
@@ -16,11 +20,27 @@ class vtkImageData;
 /*!
   \class vtkPlusRfProcessor 
   \brief Convenience class to combine multiple algorithms to compute a displayable B-mode frame from RF data
+
+  If Backend="OpenCL" is set in the RfProcessing element and Plus is built with PLUS_USE_OPENCL then
+  brightness and scan conversion are computed on an OpenCL device (see vtkPlusRfProcessorOpenCL).
+  If no OpenCL device is available then the CPU filters are used.
+
+  If FusedProcessing="TRUE" is set in the RfProcessing element and curvilinear scan conversion is used then
+  the scan converted image is computed in a single pass: each B-mode scanline is computed into a small buffer
+  right before the scan conversion interpolates from it, so the full B-mode image is not stored. Only those samples
+  of each scanline are computed that the scan conversion uses.
+
   \ingroup PlusLibImageProcessingAlgo
 */ 
 class vtkPlusImageProcessingExport vtkPlusRfProcessor : public vtkObject
 {
 public:
+  enum ProcessingBackend
+  {
+    BACKEND_CPU,
+    BACKEND_OPENCL
+  };
+
   static vtkPlusRfProcessor *New();
   vtkTypeMacro(vtkPlusRfProcessor , vtkObject);
   virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
@@ -51,17 +71,55 @@ public:
   /*! Get the rf to brightness converter object */
   vtkGetMacro(RfToBrightnessConverter, vtkPlusRfToBrightnessConvert*);
 
+  /*! Set/get the device that is used for computing the B-mode image. Falls back to CPU if OpenCL processing is not available. */
+  vtkSetMacro(Backend, ProcessingBackend);
+  vtkGetMacro(Backend, ProcessingBackend);
+
+  /*!
+    If enabled then brightness conversion and curvilinear scan conversion are computed in one pass, without storing the
+    brightness converted image. The result is the same as with separate processing (except for the FFT Hilbert transform method,
+    where a few pixels may differ by one intensity level). Ignored for linear scan conversion.
+  */
+  vtkSetMacro(FusedProcessing, bool);
+  vtkGetMacro(FusedProcessing, bool);
+  vtkBooleanMacro(FusedProcessing, bool);
+
   static const char* GetRfProcessorTagName();
 
 protected:
   vtkPlusRfProcessor();
   virtual ~vtkPlusRfProcessor(); 
 
+  /*! Compute the B-mode image on the OpenCL device. Returns NULL and switches to CPU backend if processing failed. */
+  vtkImageData* ProcessFrameOpenCL(vtkPlusUsScanConvert* scanConverter);
+
+  /*! Compute the scan converted B-mode image without storing the brightness converted image. Returns NULL if fused processing is not possible. */
+  vtkImageData* ProcessFrameFused();
+
+  /*! Compute the scan converted output pixels that are interpolated from a range of B-mode scanlines */
+  PlusStatus ProcessFusedScanlines(int firstScanline, int lastScanline);
+
+  /*! Thread function of fused processing, each thread processes a band of scanlines */
+  static void* FusedProcessingThread(vtkMultiThreader::ThreadInfo* data);
+
+  /*! Interpolation table points grouped by B-mode scanline (defined in the cxx file) */
+  struct FusedScanConversionPlan;
+
   vtkPlusRfToBrightnessConvert* RfToBrightnessConverter;
 
   vtkPlusUsScanConvert* ScanConverter;  
   std::vector<vtkPlusUsScanConvert*> AvailableScanConverters;  
 
+  ProcessingBackend Backend;
+  vtkPlusRfProcessorOpenCL* OpenCLProcessor;
+  vtkImageData* OpenCLOutputImage;
+
+  bool FusedProcessing;
+  std::shared_ptr<FusedScanConversionPlan> FusedPlan;
+  vtkMultiThreader* FusedProcessingThreader;
+  vtkImageData* FusedOutputImage;
+  std::vector<PlusStatus> FusedThreadStatus;
+
   static const char* RF_PROCESSOR_TAG_NAME;
 }; 
 
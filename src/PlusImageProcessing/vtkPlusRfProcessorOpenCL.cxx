@@ -0,0 +1,632 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+
+#include "vtkPlusRfProcessorOpenCL.h"
+#include "vtkPlusRfToBrightnessConvert.h"
+#include "vtkPlusUsScanConvertCurvilinear.h"
+#include "vtkPlusUsScanConvertLinear.h"
+
+#include "vtkImageData.h"
+#include "vtkObjectFactory.h"
+
+#include "PlusOpenCL.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <vector>
+
+vtkStandardNewMacro(vtkPlusRfProcessorOpenCL);
+
+namespace
+{
+  /*!
+    Kernels of the processing chain. RF_PIXEL_TYPE is defined when the program is built.
+    Each kernel computes the same as the corresponding CPU filter, but in single precision.
+  */
+  const char* KERNEL_SOURCE =
+    "inline uchar CompressDynamicRange(float i, float q, float brightnessScale)\n"
+    "{\n"
+    "  return convert_uchar_sat(clamp(sqrt(sqrt(sqrt(i * i + q * q))) * brightnessScale, 0.0f, 255.0f));\n"
+    "}\n"
+    "\n"
+    "// RF data: IQIQIQ..., IQIQIQ...\n"
+    "__kernel void ConvertIqLine(__global const RF_PIXEL_TYPE* rf, __global uchar* bmode, int rfSamplesPerLine, int bmodeSamplesPerLine, float brightnessScale)\n"
+    "{\n"
+    "  int sample = get_global_id(0);\n"
+    "  int line = get_global_id(1);\n"
+    "  __global const RF_PIXEL_TYPE* iq = rf + line * rfSamplesPerLine + 2 * sample;\n"
+    "  bmode[line * bmodeSamplesPerLine + sample] = CompressDynamicRange(iq[0], iq[1], brightnessScale);\n"
+    "}\n"
+    "\n"
+    "// RF data: IIIIII..., QQQQQQ..., IIIIII..., QQQQQQ...\n"
+    "__kernel void ConvertILineQLine(__global const RF_PIXEL_TYPE* rf, __global uchar* bmode, int samplesPerLine, int numberOfHilbertFilterCoeffs, float brightnessScale)\n"
+    "{\n"
+    "  int sample = get_global_id(0);\n"
+    "  int line = get_global_id(1);\n"
+    "  uchar value = 0;\n"
+    "  if (sample >= numberOfHilbertFilterCoeffs / 2 + 1 && sample <= samplesPerLine - numberOfHilbertFilterCoeffs / 2)\n"
+    "  {\n"
+    "    __global const RF_PIXEL_TYPE* i = rf + 2 * line * samplesPerLine;\n"
+    "    value = CompressDynamicRange(i[sample], i[samplesPerLine + sample], brightnessScale);\n"
+    "  }\n"
+    "  bmode[line * samplesPerLine + sample] = value;\n"
+    "}\n"
+    "\n"
+    "// Convolution of the RF data with the Hilbert transform filter (coefficients in reverse order)\n"
+    "__kernel void ComputeHilbertFilter(__global const RF_PIXEL_TYPE* rf, __global RF_PIXEL_TYPE* filtered, __constant float* reversedCoeffs,\n"
+    "  int samplesPerLine, int numberOfHilbertFilterCoeffs)\n"
+    "{\n"
+    "  int l = get_global_id(0) + 1;\n"
+    "  int line = get_global_id(1);\n"
+    "  int first = line * samplesPerLine + l;\n"
+    "  // The last term is the first sample of the next line, as in the CPU implementation (except after the last line)\n"
+    "  int end = min(first + numberOfHilbertFilterCoeffs, (int)get_global_size(1) * samplesPerLine);\n"
+    "  float yt = 0.0f;\n"
+    "  for (int i = first; i < end; i++)\n"
+    "  {\n"
+    "    yt += rf[i] * reversedCoeffs[i - first];\n"
+    "  }\n"
+    "  filtered[line * (samplesPerLine + 1) + l] = (RF_PIXEL_TYPE)yt;\n"
+    "}\n"
+    "\n"
+    "// RF data: IIIIII..., IIIIII..., the Q signal is computed from the filtered signal\n"
+    "__kernel void ConvertReal(__global const RF_PIXEL_TYPE* rf, __global const RF_PIXEL_TYPE* filtered, __global uchar* bmode,\n"
+    "  int samplesPerLine, int numberOfHilbertFilterCoeffs, float brightnessScale)\n"
+    "{\n"
+    "  int sample = get_global_id(0);\n"
+    "  int line = get_global_id(1);\n"
+    "  uchar value = 0;\n"
+    "  if (sample >= numberOfHilbertFilterCoeffs / 2 + 1 && sample <= samplesPerLine - numberOfHilbertFilterCoeffs / 2)\n"
+    "  {\n"
+    "    // Average of two neighboring filtered samples, shifted by half of the filter length\n"
+    "    __global const RF_PIXEL_TYPE* y = filtered + line * (samplesPerLine + 1) + sample - numberOfHilbertFilterCoeffs / 2;\n"
+    "    RF_PIXEL_TYPE q = (RF_PIXEL_TYPE)(0.5f * (y[0] + y[1]));\n"
+    "    value = CompressDynamicRange(rf[line * samplesPerLine + sample], q, brightnessScale);\n"
+    "  }\n"
+    "  bmode[line * samplesPerLine + sample] = value;\n"
+    "}\n"
+    "\n"
+    "__kernel void ScanConvertCurvilinear(__global const uchar* bmode, __global uchar* image, __global const int2* pixelIndices,\n"
+    "  __global const float4* weights, int bmodeSamplesPerLine)\n"
+    "{\n"
+    "  int point = get_global_id(0);\n"
+    "  int2 index = pixelIndices[point];\n"
+    "  float4 w = weights[point];\n"
+    "  __global const uchar* p = bmode + index.x;\n"
+    "  image[index.y] = convert_uchar_sat(w.x * p[0] + w.y * p[1] + w.z * p[bmodeSamplesPerLine] + w.w * p[bmodeSamplesPerLine + 1] + 0.5f);\n"
+    "}\n"
+    "\n"
+    "__kernel void ScanConvertLinear(__global const uchar* bmode, __global uchar* image, int bmodeSamplesPerLine, int numberOfLines,\n"
+    "  int imageWidth, float originX, float originY, float linesPerPixel, float samplesPerPixel)\n"
+    "{\n"
+    "  int x = get_global_id(0);\n"
+    "  int y = get_global_id(1);\n"
+    "  int line = (int)floor((originX + x) * linesPerPixel + 0.5f);\n"
+    "  int sample = (int)floor((originY + y) * samplesPerPixel + 0.5f);\n"
+    "  uchar value = 0;\n"
+    "  if (line >= 0 && line < numberOfLines && sample >= 0 && sample < bmodeSamplesPerLine)\n"
+    "  {\n"
+    "    value = bmode[line * bmodeSamplesPerLine + sample];\n"
+    "  }\n"
+    "  image[y * imageWidth + x] = value;\n"
+    "}\n";
+
+  /*! Kernels of a program that is built for an RF pixel type, indices of Program::Kernels */
+  enum KernelIndex
+  {
+    CONVERT_IQ_LINE_KERNEL,
+    CONVERT_I_LINE_Q_LINE_KERNEL,
+    COMPUTE_HILBERT_FILTER_KERNEL,
+    CONVERT_REAL_KERNEL,
+    SCAN_CONVERT_CURVILINEAR_KERNEL,
+    SCAN_CONVERT_LINEAR_KERNEL,
+    NUMBER_OF_KERNELS
+  };
+  const char* const KERNEL_NAMES[NUMBER_OF_KERNELS] =
+  {
+    "ConvertIqLine", "ConvertILineQLine", "ComputeHilbertFilter", "ConvertReal", "ScanConvertCurvilinear", "ScanConvertLinear"
+  };
+
+  typedef PlusOpenCL::Buffer Buffer;
+  typedef PlusOpenCL::Program Program;
+}
+
+//----------------------------------------------------------------------------
+class vtkPlusRfProcessorOpenCL::vtkInternal : public PlusOpenCL
+{
+public:
+  vtkInternal()
+    : PlusOpenCL("RF processing")
+    , UploadedHilbertFilterCoeffsCount(-1)
+  {
+  }
+
+  virtual ~vtkInternal()
+  {
+    this->ReleaseBuffer(this->RfBuffer);
+    this->ReleaseBuffer(this->FilteredBuffer);
+    this->ReleaseBuffer(this->BmodeBuffer);
+    this->ReleaseBuffer(this->ImageBuffer);
+    this->ReleaseBuffer(this->HilbertFilterCoeffsBuffer);
+    this->ReleaseBuffer(this->PixelIndicesBuffer);
+    this->ReleaseBuffer(this->WeightsBuffer);
+    for (std::map<int, Program>::iterator it = this->Programs.begin(); it != this->Programs.end(); ++it)
+    {
+      this->ReleaseProgram(it->second);
+    }
+  }
+
+  /*! Get the program for the RF pixel type, build it if it has not been built yet */
+  Program* GetProgram(int rfScalarType);
+
+  PlusStatus ComputeBrightness(vtkImageData* rfFrame, US_IMAGE_TYPE imageType, vtkPlusRfToBrightnessConvert* brightnessConverter,
+                               Program* program, int bmodeExtent[6]);
+
+  PlusStatus ScanConvertCurvilinear(vtkPlusUsScanConvertCurvilinear* scanConverter, Program* program, int bmodeExtent[6]);
+
+  PlusStatus ScanConvertLinear(vtkPlusUsScanConvertLinear* scanConverter, Program* program, int bmodeExtent[6]);
+
+  /*! Programs for each RF pixel type */
+  std::map<int, Program> Programs;
+
+  Buffer RfBuffer;
+  Buffer FilteredBuffer;
+  Buffer BmodeBuffer;
+  Buffer ImageBuffer;
+
+  Buffer HilbertFilterCoeffsBuffer;
+  int UploadedHilbertFilterCoeffsCount;
+
+  Buffer PixelIndicesBuffer;
+  Buffer WeightsBuffer;
+  /*! Interpolation table that is currently on the device (kept to detect changes, as tables are never modified) */
+  std::shared_ptr<const vtkPlusUsScanConvertCurvilinear::InterpolationTable> UploadedInterpolationTable;
+};
+
+//----------------------------------------------------------------------------
+Program* vtkPlusRfProcessorOpenCL::vtkInternal::GetProgram(int rfScalarType)
+{
+  std::map<int, Program>::iterator existingProgram = this->Programs.find(rfScalarType);
+  if (existingProgram != this->Programs.end())
+  {
+    return &existingProgram->second;
+  }
+
+  std::string options = "-D RF_PIXEL_TYPE=";
+  switch (rfScalarType)
+  {
+    case VTK_SHORT:
+      options += "short";
+      break;
+    case VTK_INT:
+      options += "int";
+      break;
+    case VTK_UNSIGNED_CHAR:
+      options += "uchar";
+      break;
+    default:
+      LOG_ERROR("OpenCL RF processing failed: unsupported pixel type " << rfScalarType);
+      return NULL;
+  }
+
+  Program program;
+  if (this->BuildProgram(KERNEL_SOURCE, options, KERNEL_NAMES, NUMBER_OF_KERNELS, program) != PLUS_SUCCESS)
+  {
+    return NULL;
+  }
+  Program& storedProgram = this->Programs[rfScalarType];
+  storedProgram = program;
+  return &storedProgram;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusRfProcessorOpenCL::vtkInternal::ComputeBrightness(vtkImageData* rfFrame, US_IMAGE_TYPE imageType,
+    vtkPlusRfToBrightnessConvert* brightnessConverter, Program* program, int bmodeExtent[6])
+{
+  int rfExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  rfFrame->GetExtent(rfExtent);
+  int rfSamplesPerLine = rfExtent[1] - rfExtent[0] + 1;
+  int numberOfRfLines = rfExtent[3] - rfExtent[2] + 1;
+  if (rfExtent[5] != rfExtent[4] || rfFrame->GetNumberOfScalarComponents() != 1)
+  {
+    LOG_ERROR("OpenCL RF processing failed: expecting a single-slice, single-component RF frame");
+    return PLUS_FAIL;
+  }
+
+  // Output extent, as in vtkPlusRfToBrightnessConvert::RequestInformation
+  for (int i = 0; i < 6; i++)
+  {
+    bmodeExtent[i] = rfExtent[i];
+  }
+  switch (imageType)
+  {
+    case US_IMG_BRIGHTNESS:
+    case US_IMG_RF_REAL:
+      break;
+    case US_IMG_RF_I_LINE_Q_LINE:
+      bmodeExtent[2] = rfExtent[2] / 2;
+      bmodeExtent[3] = bmodeExtent[2] + numberOfRfLines / 2 - 1;
+      break;
+    case US_IMG_RF_IQ_LINE:
+      bmodeExtent[0] = rfExtent[0] / 2;
+      bmodeExtent[1] = bmodeExtent[0] + rfSamplesPerLine / 2 - 1;
+      break;
+    default:
+      LOG_ERROR("OpenCL RF processing failed: unsupported image type for brightness conversion: " << igsioCommon::GetStringFromUsImageType(imageType));
+      return PLUS_FAIL;
+  }
+  int bmodeSamplesPerLine = bmodeExtent[1] - bmodeExtent[0] + 1;
+  int numberOfBmodeLines = bmodeExtent[3] - bmodeExtent[2] + 1;
+  size_t bmodeSize = static_cast<size_t>(bmodeSamplesPerLine) * numberOfBmodeLines;
+  if (this->ReserveBuffer(this->BmodeBuffer, bmodeSize, CL_MEM_READ_WRITE) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  if (imageType == US_IMG_BRIGHTNESS && rfFrame->GetScalarType() != VTK_UNSIGNED_CHAR)
+  {
+    LOG_ERROR("OpenCL RF processing failed: expecting VTK_UNSIGNED_CHAR pixel type for brightness images");
+    return PLUS_FAIL;
+  }
+
+  // Single upload of the RF data (brightness frames are uploaded directly as B-mode data)
+  size_t rfSize = static_cast<size_t>(rfSamplesPerLine) * numberOfRfLines * rfFrame->GetScalarSize();
+  Buffer& uploadBuffer = (imageType == US_IMG_BRIGHTNESS ? this->BmodeBuffer : this->RfBuffer);
+  if (this->UploadBuffer(uploadBuffer, rfFrame->GetScalarPointer(), rfSize, CL_FALSE) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  if (imageType == US_IMG_BRIGHTNESS)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  float brightnessScale = static_cast<float>(brightnessConverter->GetBrightnessScale());
+  int numberOfHilbertFilterCoeffs = brightnessConverter->GetNumberOfHilbertFilterCoeffs();
+  cl_int error = CL_SUCCESS;
+  switch (imageType)
+  {
+    case US_IMG_RF_IQ_LINE:
+      {
+        cl_kernel kernel = program->Kernels[CONVERT_IQ_LINE_KERNEL];
+        error |= PlusOpenCL::SetKernelArg(kernel, 0, this->RfBuffer.Handle);
+        error |= PlusOpenCL::SetKernelArg(kernel, 1, this->BmodeBuffer.Handle);
+        error |= PlusOpenCL::SetKernelArg(kernel, 2, rfSamplesPerLine);
+        error |= PlusOpenCL::SetKernelArg(kernel, 3, bmodeSamplesPerLine);
+        error |= PlusOpenCL::SetKernelArg(kernel, 4, brightnessScale);
+        size_t workSize[2] = { static_cast<size_t>(bmodeSamplesPerLine), static_cast<size_t>(numberOfBmodeLines) };
+        if (this->CheckError(error, "clSetKernelArg(ConvertIqLine)") != PLUS_SUCCESS
+            || this->RunKernel(kernel, 2, workSize, "ConvertIqLine") != PLUS_SUCCESS)
+        {
+          return PLUS_FAIL;
+        }
+      }
+      break;
+    case US_IMG_RF_I_LINE_Q_LINE:
+      {
+        cl_kernel kernel = program->Kernels[CONVERT_I_LINE_Q_LINE_KERNEL];
+        error |= PlusOpenCL::SetKernelArg(kernel, 0, this->RfBuffer.Handle);
+        error |= PlusOpenCL::SetKernelArg(kernel, 1, this->BmodeBuffer.Handle);
+        error |= PlusOpenCL::SetKernelArg(kernel, 2, rfSamplesPerLine);
+        error |= PlusOpenCL::SetKernelArg(kernel, 3, numberOfHilbertFilterCoeffs);
+        error |= PlusOpenCL::SetKernelArg(kernel, 4, brightnessScale);
+        size_t workSize[2] = { static_cast<size_t>(bmodeSamplesPerLine), static_cast<size_t>(numberOfBmodeLines) };
+        if (this->CheckError(error, "clSetKernelArg(ConvertILineQLine)") != PLUS_SUCCESS
+            || this->RunKernel(kernel, 2, workSize, "ConvertILineQLine") != PLUS_SUCCESS)
+        {
+          return PLUS_FAIL;
+        }
+      }
+      break;
+    case US_IMG_RF_REAL:
+      {
+        if (rfSamplesPerLine < numberOfHilbertFilterCoeffs)
+        {
+          LOG_ERROR("Insufficient data for performing Hilbert transform");
+          return PLUS_FAIL;
+        }
+        if (this->UploadedHilbertFilterCoeffsCount != numberOfHilbertFilterCoeffs)
+        {
+          // Coefficients are stored in reverse order, so that the convolution reads the RF data sequentially
+          const std::vector<double>& coeffs = brightnessConverter->GetHilbertTransformCoeffs();
+          std::vector<float> reversedCoeffs(numberOfHilbertFilterCoeffs);
+          for (int k = 0; k < numberOfHilbertFilterCoeffs; k++)
+          {
+            reversedCoeffs[k] = static_cast<float>(coeffs[numberOfHilbertFilterCoeffs - k]);
+          }
+          size_t coeffsSize = reversedCoeffs.size() * sizeof(float);
+          if (this->UploadBuffer(this->HilbertFilterCoeffsBuffer, &reversedCoeffs[0], coeffsSize, CL_TRUE) != PLUS_SUCCESS)
+          {
+            return PLUS_FAIL;
+          }
+          this->UploadedHilbertFilterCoeffsCount = numberOfHilbertFilterCoeffs;
+        }
+        // Filtered lines are 1-based, as in vtkPlusRfToBrightnessConvert::ComputeHilbertTransform
+        size_t filteredSize = static_cast<size_t>(rfSamplesPerLine + 1) * numberOfRfLines * rfFrame->GetScalarSize();
+        if (this->ReserveBuffer(this->FilteredBuffer, filteredSize, CL_MEM_READ_WRITE) != PLUS_SUCCESS)
+        {
+          return PLUS_FAIL;
+        }
+
+        cl_kernel filterKernel = program->Kernels[COMPUTE_HILBERT_FILTER_KERNEL];
+        error |= PlusOpenCL::SetKernelArg(filterKernel, 0, this->RfBuffer.Handle);
+        error |= PlusOpenCL::SetKernelArg(filterKernel, 1, this->FilteredBuffer.Handle);
+        error |= PlusOpenCL::SetKernelArg(filterKernel, 2, this->HilbertFilterCoeffsBuffer.Handle);
+        error |= PlusOpenCL::SetKernelArg(filterKernel, 3, rfSamplesPerLine);
+        error |= PlusOpenCL::SetKernelArg(filterKernel, 4, numberOfHilbertFilterCoeffs);
+        size_t filterWorkSize[2] = { static_cast<size_t>(rfSamplesPerLine - numberOfHilbertFilterCoeffs + 1), static_cast<size_t>(numberOfRfLines) };
+        if (this->CheckError(error, "clSetKernelArg(ComputeHilbertFilter)") != PLUS_SUCCESS
+            || this->RunKernel(filterKernel, 2, filterWorkSize, "ComputeHilbertFilter") != PLUS_SUCCESS)
+        {
+          return PLUS_FAIL;
+        }
+
+        cl_kernel kernel = program->Kernels[CONVERT_REAL_KERNEL];
+        error |= PlusOpenCL::SetKernelArg(kernel, 0, this->RfBuffer.Handle);
+        error |= PlusOpenCL::SetKernelArg(kernel, 1, this->FilteredBuffer.Handle);
+        error |= PlusOpenCL::SetKernelArg(kernel, 2, this->BmodeBuffer.Handle);
+        error |= PlusOpenCL::SetKernelArg(kernel, 3, rfSamplesPerLine);
+        error |= PlusOpenCL::SetKernelArg(kernel, 4, numberOfHilbertFilterCoeffs);
+        error |= PlusOpenCL::SetKernelArg(kernel, 5, brightnessScale);
+        size_t workSize[2] = { static_cast<size_t>(bmodeSamplesPerLine), static_cast<size_t>(numberOfBmodeLines) };
+        if (this->CheckError(error, "clSetKernelArg(ConvertReal)") != PLUS_SUCCESS
+            || this->RunKernel(kernel, 2, workSize, "ConvertReal") != PLUS_SUCCESS)
+        {
+          return PLUS_FAIL;
+        }
+      }
+      break;
+    default:
+      break;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusRfProcessorOpenCL::vtkInternal::ScanConvertCurvilinear(vtkPlusUsScanConvertCurvilinear* scanConverter, Program* program, int bmodeExtent[6])
+{
+  std::shared_ptr<const vtkPlusUsScanConvertCurvilinear::InterpolationTable> table = scanConverter->GetInterpolationTableForInputExtent(bmodeExtent);
+  int numberOfPoints = table->GetNumberOfPoints();
+  if (table != this->UploadedInterpolationTable)
+  {
+    // Scan conversion parameters are changed, upload the new table
+    std::vector<cl_int> pixelIndices(2 * static_cast<size_t>(numberOfPoints));
+    std::vector<cl_float> weights(4 * static_cast<size_t>(numberOfPoints));
+    for (int i = 0; i < numberOfPoints; i++)
+    {
+      pixelIndices[2 * i] = table->InputPixelIndices[i];
+      pixelIndices[2 * i + 1] = table->OutputPixelIndices[i];
+      for (int k = 0; k < 4; k++)
+      {
+        weights[4 * i + k] = static_cast<cl_float>(table->WeightCoefficients[k][i]);
+      }
+    }
+    size_t pixelIndicesSize = pixelIndices.size() * sizeof(cl_int);
+    size_t weightsSize = weights.size() * sizeof(cl_float);
+    this->UploadedInterpolationTable.reset();
+    if (numberOfPoints > 0 &&
+        (this->UploadBuffer(this->PixelIndicesBuffer, &pixelIndices[0], pixelIndicesSize, CL_TRUE) != PLUS_SUCCESS
+         || this->UploadBuffer(this->WeightsBuffer, &weights[0], weightsSize, CL_TRUE) != PLUS_SUCCESS))
+    {
+      return PLUS_FAIL;
+    }
+    this->UploadedInterpolationTable = table;
+  }
+
+  int bmodeSamplesPerLine = bmodeExtent[1] - bmodeExtent[0] + 1;
+  cl_int error = CL_SUCCESS;
+  cl_kernel kernel = program->Kernels[SCAN_CONVERT_CURVILINEAR_KERNEL];
+  error |= PlusOpenCL::SetKernelArg(kernel, 0, this->BmodeBuffer.Handle);
+  error |= PlusOpenCL::SetKernelArg(kernel, 1, this->ImageBuffer.Handle);
+  error |= PlusOpenCL::SetKernelArg(kernel, 2, this->PixelIndicesBuffer.Handle);
+  error |= PlusOpenCL::SetKernelArg(kernel, 3, this->WeightsBuffer.Handle);
+  error |= PlusOpenCL::SetKernelArg(kernel, 4, bmodeSamplesPerLine);
+  size_t workSize[1] = { static_cast<size_t>(numberOfPoints) };
+  if (this->CheckError(error, "clSetKernelArg(ScanConvertCurvilinear)") != PLUS_SUCCESS
+      || this->RunKernel(kernel, 1, workSize, "ScanConvertCurvilinear") != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusRfProcessorOpenCL::vtkInternal::ScanConvertLinear(vtkPlusUsScanConvertLinear* scanConverter, Program* program, int bmodeExtent[6])
+{
+  double outputOrigin[2] = { 0 };
+  double inputPixelsPerOutputPixel[2] = { 0 };
+  scanConverter->GetOutputToInputMapping(bmodeExtent, outputOrigin, inputPixelsPerOutputPixel);
+
+  int* outputExtent = scanConverter->GetOutputImageExtent();
+  int imageWidth = outputExtent[1] - outputExtent[0] + 1;
+  int imageHeight = outputExtent[3] - outputExtent[2] + 1;
+  int bmodeSamplesPerLine = bmodeExtent[1] - bmodeExtent[0] + 1;
+  int numberOfBmodeLines = bmodeExtent[3] - bmodeExtent[2] + 1;
+  // Pixel positions are relative to the first pixel of the extents
+  float originX = static_cast<float>(outputOrigin[0] + outputExtent[0] - bmodeExtent[2] / inputPixelsPerOutputPixel[0]);
+  float originY = static_cast<float>(outputOrigin[1] + outputExtent[2] - bmodeExtent[0] / inputPixelsPerOutputPixel[1]);
+  float linesPerPixel = static_cast<float>(inputPixelsPerOutputPixel[0]);
+  float samplesPerPixel = static_cast<float>(inputPixelsPerOutputPixel[1]);
+
+  cl_int error = CL_SUCCESS;
+  cl_kernel kernel = program->Kernels[SCAN_CONVERT_LINEAR_KERNEL];
+  error |= PlusOpenCL::SetKernelArg(kernel, 0, this->BmodeBuffer.Handle);
+  error |= PlusOpenCL::SetKernelArg(kernel, 1, this->ImageBuffer.Handle);
+  error |= PlusOpenCL::SetKernelArg(kernel, 2, bmodeSamplesPerLine);
+  error |= PlusOpenCL::SetKernelArg(kernel, 3, numberOfBmodeLines);
+  error |= PlusOpenCL::SetKernelArg(kernel, 4, imageWidth);
+  error |= PlusOpenCL::SetKernelArg(kernel, 5, originX);
+  error |= PlusOpenCL::SetKernelArg(kernel, 6, originY);
+  error |= PlusOpenCL::SetKernelArg(kernel, 7, linesPerPixel);
+  error |= PlusOpenCL::SetKernelArg(kernel, 8, samplesPerPixel);
+  size_t workSize[2] = { static_cast<size_t>(imageWidth), static_cast<size_t>(imageHeight) };
+  if (this->CheckError(error, "clSetKernelArg(ScanConvertLinear)") != PLUS_SUCCESS
+      || this->RunKernel(kernel, 2, workSize, "ScanConvertLinear") != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusRfProcessorOpenCL::vtkPlusRfProcessorOpenCL()
+  : Internal(new vtkInternal)
+{
+}
+
+//----------------------------------------------------------------------------
+vtkPlusRfProcessorOpenCL::~vtkPlusRfProcessorOpenCL()
+{
+  delete this->Internal;
+  this->Internal = NULL;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusRfProcessorOpenCL::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Device: " << (this->IsInitialized() ? this->Internal->GetDeviceName() : std::string("(not initialized)")) << "\n";
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusRfProcessorOpenCL::Initialize()
+{
+  if (this->IsInitialized())
+  {
+    return PLUS_SUCCESS;
+  }
+
+  if (this->Internal->CreateCommandQueue() != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  // Build the program of the most common RF pixel type now, to report errors early
+  if (this->Internal->GetProgram(VTK_SHORT) == NULL)
+  {
+    // Leave the processor uninitialized, so that Initialize can be retried
+    this->Internal->ReleaseCommandQueue();
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusRfProcessorOpenCL::IsInitialized() const
+{
+  return this->Internal->IsInitialized();
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusRfProcessorOpenCL::GetDeviceName() const
+{
+  return this->Internal->GetDeviceName();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusRfProcessorOpenCL::ProcessFrame(vtkImageData* rfFrame, US_IMAGE_TYPE imageType, vtkPlusRfToBrightnessConvert* brightnessConverter,
+    vtkPlusUsScanConvert* scanConverter, vtkImageData* outputImage)
+{
+  if (!this->IsInitialized())
+  {
+    LOG_ERROR("OpenCL RF processing failed: the device is not initialized");
+    return PLUS_FAIL;
+  }
+  if (rfFrame == NULL || brightnessConverter == NULL || outputImage == NULL)
+  {
+    LOG_ERROR("OpenCL RF processing failed: invalid input");
+    return PLUS_FAIL;
+  }
+  if (imageType == US_IMG_RF_REAL && brightnessConverter->GetHilbertTransformMethod() == vtkPlusRfToBrightnessConvert::HILBERT_TRANSFORM_FFT)
+  {
+    LOG_ERROR("OpenCL RF processing failed: FFT-based Hilbert transform is not supported, only FIR");
+    return PLUS_FAIL;
+  }
+  if (brightnessConverter->GetDynamicRangeCompression() != vtkPlusRfToBrightnessConvert::COMPRESSION_SQRT_SQRT)
+  {
+    LOG_ERROR("OpenCL RF processing failed: only SqrtSqrt dynamic range compression is supported");
+    return PLUS_FAIL;
+  }
+
+  Program* program = this->Internal->GetProgram(rfFrame->GetScalarType());
+  if (program == NULL)
+  {
+    return PLUS_FAIL;
+  }
+
+  int bmodeExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  if (this->Internal->ComputeBrightness(rfFrame, imageType, brightnessConverter, program, bmodeExtent) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  // Download only the final result
+  int outputExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  Buffer* resultBuffer = &this->Internal->BmodeBuffer;
+  if (scanConverter == NULL)
+  {
+    std::copy(bmodeExtent, bmodeExtent + 6, outputExtent);
+  }
+  else
+  {
+    scanConverter->SetInputImageExtent(bmodeExtent);
+    std::copy(scanConverter->GetOutputImageExtent(), scanConverter->GetOutputImageExtent() + 6, outputExtent);
+    outputExtent[4] = outputExtent[5] = 0;
+    size_t imageSize = static_cast<size_t>(outputExtent[1] - outputExtent[0] + 1) * (outputExtent[3] - outputExtent[2] + 1);
+    if (this->Internal->ReserveBuffer(this->Internal->ImageBuffer, imageSize, CL_MEM_READ_WRITE) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    resultBuffer = &this->Internal->ImageBuffer;
+
+    vtkPlusUsScanConvertCurvilinear* curvilinear = vtkPlusUsScanConvertCurvilinear::SafeDownCast(scanConverter);
+    vtkPlusUsScanConvertLinear* linear = vtkPlusUsScanConvertLinear::SafeDownCast(scanConverter);
+    if (curvilinear != NULL)
+    {
+      // Only the pixels inside the fan are written by the kernel
+      const cl_uchar zero = 0;
+      if (this->Internal->CheckError(clEnqueueFillBuffer(this->Internal->GetQueue(), this->Internal->ImageBuffer.Handle, &zero, sizeof(zero), 0, imageSize, 0, NULL, NULL),
+                                     "clEnqueueFillBuffer") != PLUS_SUCCESS
+          || this->Internal->ScanConvertCurvilinear(curvilinear, program, bmodeExtent) != PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+    }
+    else if (linear != NULL)
+    {
+      if (this->Internal->ScanConvertLinear(linear, program, bmodeExtent) != PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+    }
+    else
+    {
+      LOG_ERROR("OpenCL RF processing failed: unsupported transducer geometry: " << scanConverter->GetTransducerGeometry());
+      return PLUS_FAIL;
+    }
+  }
+
+  int* currentExtent = outputImage->GetExtent();
+  if (outputImage->GetScalarType() != VTK_UNSIGNED_CHAR || outputImage->GetNumberOfScalarComponents() != 1 || !std::equal(outputExtent, outputExtent + 6, currentExtent))
+  {
+    outputImage->SetExtent(outputExtent);
+    outputImage->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  }
+  // In Plus the convention is that the image coordinate system has always unit spacing and zero origin
+  outputImage->SetSpacing(1.0, 1.0, 1.0);
+  outputImage->SetOrigin(0.0, 0.0, 0.0);
+  size_t outputSize = static_cast<size_t>(outputExtent[1] - outputExtent[0] + 1) * (outputExtent[3] - outputExtent[2] + 1);
+  if (this->Internal->CheckError(clEnqueueReadBuffer(this->Internal->GetQueue(), resultBuffer->Handle, CL_TRUE, 0, outputSize, outputImage->GetScalarPointer(), 0, NULL, NULL),
+                                 "clEnqueueReadBuffer") != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  outputImage->Modified();
+  return PLUS_SUCCESS;
+}
@@ -0,0 +1,74 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusRfProcessorOpenCL_h
+#define __vtkPlusRfProcessorOpenCL_h
+
+#include "vtkPlusImageProcessingExport.h"
+#include "vtkObject.h"
+
+class vtkImageData;
+class vtkPlusRfToBrightnessConvert;
+class vtkPlusUsScanConvert;
+
+/*!
+  \class vtkPlusRfProcessorOpenCL
+  \brief Computes B-mode frames from RF data on an OpenCL device
+
+  Performs the same processing as the vtkPlusRfToBrightnessConvert and the vtkPlusUsScanConvertLinear
+  or vtkPlusUsScanConvertCurvilinear filters, using their parameters. The RF frame is uploaded to the device once,
+  envelope detection, dynamic range compression and scan conversion are performed on the device and only the result
+  image is downloaded. The curvilinear interpolation table is uploaded only when the scan conversion parameters change.
+
+  Computations are performed in single precision, therefore a few pixels may differ by one intensity level
+  from the result of the CPU filters.
+
+  Only available if Plus is built with PLUS_USE_OPENCL. Used by vtkPlusRfProcessor if Backend="OpenCL" is specified
+  in the RfProcessing element.
+
+  \ingroup PlusLibImageProcessingAlgo
+*/
+class vtkPlusImageProcessingExport vtkPlusRfProcessorOpenCL : public vtkObject
+{
+public:
+  static vtkPlusRfProcessorOpenCL* New();
+  vtkTypeMacro(vtkPlusRfProcessorOpenCL, vtkObject);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  /*! Select an OpenCL device (the first GPU, or any device if there is no GPU) and compile the kernels */
+  PlusStatus Initialize();
+
+  /*! Returns true if the device is initialized */
+  bool IsInitialized() const;
+
+  /*!
+    Compute the B-mode image from the RF frame.
+    \param rfFrame frame containing RF data, without scan conversion
+    \param imageType RF data encoding type
+    \param brightnessConverter the envelope detection and dynamic range compression parameters are taken from this object
+    \param scanConverter scan conversion parameters are taken from this object. If NULL then the
+      brightness converted image is returned, without scan conversion.
+    \param outputImage the result is stored in this image
+  */
+  PlusStatus ProcessFrame(vtkImageData* rfFrame, US_IMAGE_TYPE imageType, vtkPlusRfToBrightnessConvert* brightnessConverter,
+                          vtkPlusUsScanConvert* scanConverter, vtkImageData* outputImage);
+
+  /*! Name of the OpenCL device that is used for processing */
+  std::string GetDeviceName() const;
+
+protected:
+  vtkPlusRfProcessorOpenCL();
+  virtual ~vtkPlusRfProcessorOpenCL();
+
+  class vtkInternal;
+  vtkInternal* Internal;
+
+private:
+  vtkPlusRfProcessorOpenCL(const vtkPlusRfProcessorOpenCL&);  // Not implemented.
+  void operator=(const vtkPlusRfProcessorOpenCL&);  // Not implemented.
+};
+
+#endif
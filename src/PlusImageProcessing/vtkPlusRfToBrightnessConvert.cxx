@@ -15,19 +15,161 @@ See License.txt for details.
 #include "vtkStreamingDemandDrivenPipeline.h"
 #include "vtkMath.h"
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
 #include <math.h>
+#include <stdint.h>
 
 vtkStandardNewMacro(vtkPlusRfToBrightnessConvert);
 
-const double MIN_BRIGHTNESS_VALUE = 0.0;
-const double MAX_BRIGHTNESS_VALUE = 255.0;
+const int MAX_BRIGHTNESS_VALUE = 255;
+
+namespace
+{
+  // The brightness lookup table is indexed by the exponent and the highest mantissa bits of the squared envelope value,
+  // starting from 1.0 (smaller values are in the first bin), with 64 exponents
+  const int LOOKUP_MANTISSA_BITS = 8;
+  const uint64_t LOOKUP_FIRST_BIN_BITS = 0x3FF0000000000000ULL; // 1.0
+  const int LOOKUP_TABLE_SIZE = 64 << LOOKUP_MANTISSA_BITS;
+
+  //----------------------------------------------------------------------------
+  // Binary representations of non-negative doubles have the same ordering as the values
+  inline uint64_t DoubleToBits(double value)
+  {
+    uint64_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+  }
+  inline double BitsToDouble(uint64_t bits)
+  {
+    double value = 0;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  //----------------------------------------------------------------------------
+  /*!
+    Convolution filter output of ComputeHilbertTransform at index filterIndex (starting from 1), before shifting.
+    Input samples filterIndex..filterIndex+numberOfCoeffs-1 are used.
+  */
+  template<typename ScalarType>
+  inline ScalarType ComputeHilbertFilterOutput(const ScalarType* input, const double* hilbertTransformCoeffs, int numberOfCoeffs, int filterIndex)
+  {
+    double yt = 0.0;
+    for (int i = 1; i <= numberOfCoeffs; i++)
+    {
+      yt += input[filterIndex + i - 1] * hilbertTransformCoeffs[numberOfCoeffs + 1 - i];
+    }
+    return yt;
+  }
+
+  //----------------------------------------------------------------------------
+  /*!
+    Get the brightness value of a squared envelope value. The lookup table contains the brightness at the lower bound
+    of each bin, which is then incremented while the next brightness threshold is not greater than the squared envelope.
+  */
+  inline unsigned char LookUpBrightness(const unsigned char* lookupTable, const double* brightnessThresholds, double squaredEnvelope)
+  {
+    uint64_t bits = DoubleToBits(squaredEnvelope);
+    uint64_t bin = (bits < LOOKUP_FIRST_BIN_BITS) ? 0 : ((bits - LOOKUP_FIRST_BIN_BITS) >> (52 - LOOKUP_MANTISSA_BITS));
+    if (bin >= LOOKUP_TABLE_SIZE)
+    {
+      bin = LOOKUP_TABLE_SIZE - 1;
+    }
+    int brightness = lookupTable[bin];
+    // the last threshold is NaN, so the loop stops at the maximum brightness
+    while (squaredEnvelope >= brightnessThresholds[brightness + 1])
+    {
+      brightness++;
+    }
+    return static_cast<unsigned char>(brightness);
+  }
+}
+
+//----------------------------------------------------------------------------
+struct vtkPlusRfToBrightnessConvert::FftPlan
+{
+  explicit FftPlan(int numberOfSamples)
+    : NumberOfSamples(numberOfSamples)
+    , Size(1)
+  {
+    // Scanlines are zero-padded to the next power of two
+    int numberOfBits = 0;
+    while (this->Size < numberOfSamples)
+    {
+      this->Size *= 2;
+      numberOfBits++;
+    }
+    this->BitReversedIndices.resize(this->Size);
+    for (int i = 0; i < this->Size; i++)
+    {
+      int reversed = 0;
+      for (int bit = 0; bit < numberOfBits; bit++)
+      {
+        reversed |= ((i >> bit) & 1) << (numberOfBits - 1 - bit);
+      }
+      this->BitReversedIndices[i] = reversed;
+    }
+    this->Twiddles.resize(this->Size / 2);
+    for (int k = 0; k < this->Size / 2; k++)
+    {
+      double angle = -2.0 * vtkMath::Pi() * k / this->Size;
+      this->Twiddles[k] = std::complex<double>(cos(angle), sin(angle));
+    }
+  }
+
+  /*! In-place radix-2 FFT of Size elements */
+  void Transform(std::complex<double>* data, bool inverse) const
+  {
+    for (int i = 0; i < this->Size; i++)
+    {
+      int j = this->BitReversedIndices[i];
+      if (i < j)
+      {
+        std::swap(data[i], data[j]);
+      }
+    }
+    double imaginarySign = inverse ? -1.0 : 1.0;
+    for (int halfSize = 1; halfSize < this->Size; halfSize *= 2)
+    {
+      int twiddleStep = this->Size / (2 * halfSize);
+      for (int start = 0; start < this->Size; start += 2 * halfSize)
+      {
+        for (int k = 0; k < halfSize; k++)
+        {
+          const std::complex<double>& w = this->Twiddles[k * twiddleStep];
+          double wr = w.real();
+          double wi = imaginarySign * w.imag();
+          std::complex<double>& even = data[start + k];
+          std::complex<double>& odd = data[start + k + halfSize];
+          double tr = wr * odd.real() - wi * odd.imag();
+          double ti = wr * odd.imag() + wi * odd.real();
+          odd = std::complex<double>(even.real() - tr, even.imag() - ti);
+          even = std::complex<double>(even.real() + tr, even.imag() + ti);
+        }
+      }
+    }
+  }
+
+  int NumberOfSamples;
+  int Size;
+  std::vector<int> BitReversedIndices;
+  std::vector< std::complex<double> > Twiddles;
+};
 
 //----------------------------------------------------------------------------
 vtkPlusRfToBrightnessConvert::vtkPlusRfToBrightnessConvert()
 {
   this->ImageType = US_IMG_TYPE_XX;
   this->BrightnessScale = 10.0;
+  this->DynamicRangeCompression = COMPRESSION_SQRT_SQRT;
+  this->BrightnessGamma = 0.25;
+  this->BrightnessThresholdsCompression = COMPRESSION_SQRT_SQRT;
+  this->BrightnessThresholdsScale = 0.0;
+  this->BrightnessThresholdsGamma = 0.0;
   this->NumberOfHilbertFilterCoeffs = 64;
+  this->HilbertTransformMethod = HILBERT_TRANSFORM_FIR;
 }
 
 //----------------------------------------------------------------------------
@@ -36,23 +178,15 @@ vtkPlusRfToBrightnessConvert::~vtkPlusRfToBrightnessConvert()
 }
 
 //----------------------------------------------------------------------------
-int vtkPlusRfToBrightnessConvert::RequestInformation(vtkInformation*,
-    vtkInformationVector** inputVector,
-    vtkInformationVector* outputVector)
+PlusStatus vtkPlusRfToBrightnessConvert::GetBrightnessImageExtent(US_IMAGE_TYPE imageType, const int rfImageExtent[6], int brightnessImageExtent[6])
 {
-  // get the info objects
-  vtkInformation* outInfo = outputVector->GetInformationObject(0);
-  vtkInformation* inInfo = inputVector[0]->GetInformationObject(0);
-
-  int inExt[6] = {0};
-  inInfo->Get(vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), inExt);
-
-  // Set the output extent to be the same as the input extent by default
-  int outExt[6] = {0};
-  inInfo->Get(vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), outExt);
+  // The output extent is the same as the input extent by default
+  for (int i = 0; i < 6; i++)
+  {
+    brightnessImageExtent[i] = rfImageExtent[i];
+  }
 
-  // Update the output image extent depending on the RF encoding type
-  switch (this->ImageType)
+  switch (imageType)
   {
     case US_IMG_BRIGHTNESS:
       {
@@ -64,9 +198,9 @@ int vtkPlusRfToBrightnessConvert::RequestInformation(vtkInformation*,
         // RF data: IIIIII..., QQQQQQ....
         // B-mode data: BBBBBB
         // => number of rows in the output image is half of the rows in the input image
-        int numberOfBmodeRows = (inExt[3] - inExt[2] + 1) / 2;
-        outExt[2] = inExt[2] / 2;
-        outExt[3] = outExt[2] + numberOfBmodeRows - 1;
+        int numberOfBmodeRows = (rfImageExtent[3] - rfImageExtent[2] + 1) / 2;
+        brightnessImageExtent[2] = rfImageExtent[2] / 2;
+        brightnessImageExtent[3] = brightnessImageExtent[2] + numberOfBmodeRows - 1;
       }
       break;
     case US_IMG_RF_REAL:
@@ -82,16 +216,41 @@ int vtkPlusRfToBrightnessConvert::RequestInformation(vtkInformation*,
         // RF data: IQIQIQ....., IQIQIQ.....
         // B-mode data: BBB..., BBB...
         // => number of columns in the output image is half of the columns in the input image
-        int numberOfBmodeColumns = (inExt[1] - inExt[0] + 1) / 2;
-        outExt[0] = inExt[0] / 2;
-        outExt[1] = outExt[0] + numberOfBmodeColumns - 1;
+        int numberOfBmodeColumns = (rfImageExtent[1] - rfImageExtent[0] + 1) / 2;
+        brightnessImageExtent[0] = rfImageExtent[0] / 2;
+        brightnessImageExtent[1] = brightnessImageExtent[0] + numberOfBmodeColumns - 1;
       }
       break;
     default:
-      vtkErrorMacro("Unknown RF image type: " << this->ImageType);
-      return 0;
+      return PLUS_FAIL;
   }
 
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusRfToBrightnessConvert::RequestInformation(vtkInformation*,
+    vtkInformationVector** inputVector,
+    vtkInformationVector* outputVector)
+{
+  // get the info objects
+  vtkInformation* outInfo = outputVector->GetInformationObject(0);
+  vtkInformation* inInfo = inputVector[0]->GetInformationObject(0);
+
+  int inExt[6] = {0};
+  inInfo->Get(vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), inExt);
+
+  // Update the output image extent depending on the RF encoding type
+  int outExt[6] = {0};
+  if (GetBrightnessImageExtent(this->ImageType, inExt, outExt) != PLUS_SUCCESS)
+  {
+    vtkErrorMacro("Unknown RF image type: " << this->ImageType);
+    return 0;
+  }
+
+  // Prepare the brightness lookup and the Hilbert transform for the scanline length, so that threads can share them
+  PrepareBrightnessScanlineComputation(inExt[1] - inExt[0] + 1);
+
   // Set the updated output image size
   outInfo->Set(vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), outExt, 6);
 
@@ -128,6 +287,12 @@ void vtkPlusRfToBrightnessConvert::ThreadedRequestData(
     return;
   }
 
+  if ((int)(this->BrightnessLookupTable.size()) != LOOKUP_TABLE_SIZE)
+  {
+    vtkErrorMacro("Brightness thresholds are not computed");
+    return;
+  }
+
   int inExt[6] = {outExt[0], outExt[1], outExt[2], outExt[3], outExt[4], outExt[5]};
   // Get the input extent for the output extent
   switch (this->ImageType)
@@ -240,6 +405,18 @@ void vtkPlusRfToBrightnessConvert::ThreadedLineByLineHilbertTransform(int inExt[
     return;
   }
 
+  std::shared_ptr<const FftPlan> fftPlan;
+  std::vector< std::complex<double> > fftBuffer;
+  if (this->ImageType == US_IMG_RF_REAL && this->HilbertTransformMethod == HILBERT_TRANSFORM_FFT)
+  {
+    fftPlan = this->HilbertFftPlan;
+    if (!fftPlan || fftPlan->NumberOfSamples != numberOfRfSamplesInScanline)
+    {
+      fftPlan = std::make_shared<const FftPlan>(numberOfRfSamplesInScanline);
+    }
+    fftBuffer.resize(fftPlan->Size);
+  }
+
   ScalarType* hilbertTransformBuffer = new ScalarType[numberOfRfSamplesInScanline + 1];
   for (int idx2 = outExt[4]; idx2 <= outExt[5]; ++idx2)
   {
@@ -273,6 +450,24 @@ void vtkPlusRfToBrightnessConvert::ThreadedLineByLineHilbertTransform(int inExt[
           {
             // e.g., Ultrasonix
             // RF data: IIIII..., IIIII...
+            if (fftPlan)
+            {
+              // The next scanline is transformed together with this one, if it is in the extent of this thread
+              ScalarType* nextSignal = NULL;
+              unsigned char* nextOutput = NULL;
+              int numberOfScanlines = 1;
+              if (idx1 < outExt[3])
+              {
+                nextSignal = inPtr + numberOfRfSamplesInScanline + inInc1;
+                nextOutput = outPtr + numberOfBmodeSamplesInScanline + outInc1;
+                numberOfScanlines = 2;
+                ++idx1;
+              }
+              ComputeAmplitudeFftHilbertTransform(outPtr, nextOutput, inPtr, nextSignal, numberOfRfSamplesInScanline, *fftPlan, fftBuffer);
+              inPtr += numberOfScanlines * (numberOfRfSamplesInScanline + inInc1);
+              outPtr += numberOfScanlines * (numberOfBmodeSamplesInScanline + outInc1);
+              break;
+            }
             ComputeHilbertTransform(hilbertTransformBuffer, inPtr, numberOfRfSamplesInScanline);
             ComputeAmplitudeILineQLine(outPtr, inPtr, hilbertTransformBuffer, numberOfRfSamplesInScanline);
             inPtr += numberOfRfSamplesInScanline + inInc1;
@@ -315,6 +510,10 @@ PlusStatus vtkPlusRfToBrightnessConvert::ReadConfiguration(vtkXMLDataElement* rf
   XML_VERIFY_ELEMENT(rfToBrightnessElement, "RfToBrightnessConversion");
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfHilbertFilterCoeffs, rfToBrightnessElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, BrightnessScale, rfToBrightnessElement);
+  XML_READ_ENUM3_ATTRIBUTE_OPTIONAL(DynamicRangeCompression, rfToBrightnessElement,
+    "SqrtSqrt", COMPRESSION_SQRT_SQRT, "Log", COMPRESSION_LOG, "Gamma", COMPRESSION_GAMMA);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, BrightnessGamma, rfToBrightnessElement);
+  XML_READ_ENUM2_ATTRIBUTE_OPTIONAL(HilbertTransformMethod, rfToBrightnessElement, "FIR", HILBERT_TRANSFORM_FIR, "FFT", HILBERT_TRANSFORM_FFT);
   return PLUS_SUCCESS;
 }
 
@@ -327,10 +526,192 @@ PlusStatus vtkPlusRfToBrightnessConvert::WriteConfiguration(vtkXMLDataElement* r
 
   rfToBrightnessElement->SetDoubleAttribute("NumberOfHilbertFilterCoeffs", this->NumberOfHilbertFilterCoeffs);
   rfToBrightnessElement->SetDoubleAttribute("BrightnessScale", this->BrightnessScale);
+  switch (this->DynamicRangeCompression)
+  {
+    case COMPRESSION_LOG:
+      rfToBrightnessElement->SetAttribute("DynamicRangeCompression", "Log");
+      break;
+    case COMPRESSION_GAMMA:
+      rfToBrightnessElement->SetAttribute("DynamicRangeCompression", "Gamma");
+      break;
+    default:
+      rfToBrightnessElement->SetAttribute("DynamicRangeCompression", "SqrtSqrt");
+  }
+  rfToBrightnessElement->SetDoubleAttribute("BrightnessGamma", this->BrightnessGamma);
+  rfToBrightnessElement->SetAttribute("HilbertTransformMethod", this->HilbertTransformMethod == HILBERT_TRANSFORM_FFT ? "FFT" : "FIR");
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+const std::vector<double>& vtkPlusRfToBrightnessConvert::GetHilbertTransformCoeffs()
+{
+  ComputeHilbertTransformCoeffs(); // update the transform coefficients if needed
+  return this->HilbertTransformCoeffs;
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusRfToBrightnessConvert::PrepareBrightnessScanlineComputation(int numberOfRfSamplesInScanline)
+{
+  UpdateBrightnessThresholds();
+  ComputeHilbertTransformCoeffs();
+  if (this->ImageType == US_IMG_RF_REAL && this->HilbertTransformMethod == HILBERT_TRANSFORM_FFT)
+  {
+    if (!this->HilbertFftPlan || this->HilbertFftPlan->NumberOfSamples != numberOfRfSamplesInScanline)
+    {
+      this->HilbertFftPlan = std::make_shared<const FftPlan>(numberOfRfSamplesInScanline);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusRfToBrightnessConvert::ComputeBrightnessScanline(vtkImageData* rfFrame, int scanlineIndex, int firstSample, int lastSample,
+    unsigned char* brightnessScanline, std::vector< std::complex<double> >& workspace)
+{
+  if (rfFrame == NULL || rfFrame->GetNumberOfScalarComponents() != 1)
+  {
+    LOG_ERROR("Brightness scanline computation failed: invalid RF frame");
+    return PLUS_FAIL;
+  }
+  if ((int)(this->BrightnessLookupTable.size()) != LOOKUP_TABLE_SIZE)
+  {
+    LOG_ERROR("Brightness scanline computation failed: PrepareBrightnessScanlineComputation has not been called");
+    return PLUS_FAIL;
+  }
+
+  int rfExtent[6] = {0, -1, 0, -1, 0, -1};
+  rfFrame->GetExtent(rfExtent);
+  int brightnessExtent[6] = {0, -1, 0, -1, 0, -1};
+  if (GetBrightnessImageExtent(this->ImageType, rfExtent, brightnessExtent) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unsupported image type for brightness conversion: " << igsioCommon::GetStringFromUsImageType(this->ImageType));
+    return PLUS_FAIL;
+  }
+  if (scanlineIndex < 0 || scanlineIndex > brightnessExtent[3] - brightnessExtent[2]
+      || firstSample < 0 || lastSample > brightnessExtent[1] - brightnessExtent[0])
+  {
+    LOG_ERROR("Brightness scanline computation failed: scanline " << scanlineIndex << " samples " << firstSample << "-" << lastSample << " are out of the image");
+    return PLUS_FAIL;
+  }
+
+  // I and Q lines are interleaved in US_IMG_RF_I_LINE_Q_LINE images
+  int rfLineIndex = (this->ImageType == US_IMG_RF_I_LINE_Q_LINE) ? 2 * scanlineIndex : scanlineIndex;
+  void* rfLine = rfFrame->GetScalarPointer(rfExtent[0], rfExtent[2] + rfLineIndex, rfExtent[4]);
+  void* rfSecondLine = (this->ImageType == US_IMG_RF_I_LINE_Q_LINE) ? rfFrame->GetScalarPointer(rfExtent[0], rfExtent[2] + rfLineIndex + 1, rfExtent[4]) : NULL;
+  int numberOfRfSamplesInScanline = rfExtent[1] - rfExtent[0] + 1;
+
+  if (this->ImageType == US_IMG_BRIGHTNESS)
+  {
+    if (rfFrame->GetScalarType() != VTK_UNSIGNED_CHAR)
+    {
+      LOG_ERROR("Brightness scanline computation failed: expecting VTK_UNSIGNED_CHAR pixel type for US_IMG_BRIGHTNESS image type");
+      return PLUS_FAIL;
+    }
+    if (lastSample >= firstSample)
+    {
+      memcpy(brightnessScanline + firstSample, static_cast<unsigned char*>(rfLine) + firstSample, lastSample - firstSample + 1);
+    }
+    return PLUS_SUCCESS;
+  }
 
+  if (rfFrame->GetScalarType() == VTK_SHORT)
+  {
+    ComputeBrightnessScanlineSamples(static_cast<short*>(rfLine), static_cast<short*>(rfSecondLine), numberOfRfSamplesInScanline,
+                                     firstSample, lastSample, brightnessScanline, workspace);
+  }
+  else if (rfFrame->GetScalarType() == VTK_INT)
+  {
+    ComputeBrightnessScanlineSamples(static_cast<int*>(rfLine), static_cast<int*>(rfSecondLine), numberOfRfSamplesInScanline,
+                                     firstSample, lastSample, brightnessScanline, workspace);
+  }
+  else
+  {
+    LOG_ERROR("Brightness scanline computation failed: expecting VTK_SHORT or VTK_INT as input pixel type");
+    return PLUS_FAIL;
+  }
   return PLUS_SUCCESS;
 }
 
+//-----------------------------------------------------------------------------
+double vtkPlusRfToBrightnessConvert::ComputeCompressedBrightness(double squaredEnvelope) const
+{
+  switch (this->DynamicRangeCompression)
+  {
+    case COMPRESSION_LOG:
+      return log(1.0 + sqrt(squaredEnvelope)) * this->BrightnessScale;
+    case COMPRESSION_GAMMA:
+      return pow(sqrt(squaredEnvelope), this->BrightnessGamma) * this->BrightnessScale;
+    default:
+      return sqrt(sqrt(sqrt(squaredEnvelope))) * this->BrightnessScale;
+  }
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusRfToBrightnessConvert::UpdateBrightnessThresholds()
+{
+  if ((int)(this->BrightnessLookupTable.size()) == LOOKUP_TABLE_SIZE
+      && this->BrightnessThresholdsCompression == this->DynamicRangeCompression
+      && this->BrightnessThresholdsScale == this->BrightnessScale
+      && this->BrightnessThresholdsGamma == this->BrightnessGamma)
+  {
+    // already computed for the current compression parameters
+    return;
+  }
+
+  // The compression functions are monotonic, therefore the smallest squared envelope value
+  // that results in at least the given brightness can be found by bisection. The thresholds are
+  // exact, so the looked up brightness is the same as the truncated value of the compression function.
+  this->BrightnessThresholds.resize(MAX_BRIGHTNESS_VALUE + 2);
+  this->BrightnessThresholds[0] = 0.0;
+  this->BrightnessThresholds[MAX_BRIGHTNESS_VALUE + 1] = std::numeric_limits<double>::quiet_NaN();
+  const uint64_t infinityBits = DoubleToBits(std::numeric_limits<double>::infinity());
+  for (int brightness = 1; brightness <= MAX_BRIGHTNESS_VALUE; brightness++)
+  {
+    if (ComputeCompressedBrightness(0.0) >= brightness)
+    {
+      this->BrightnessThresholds[brightness] = 0.0;
+      continue;
+    }
+    if (!(ComputeCompressedBrightness(std::numeric_limits<double>::infinity()) >= brightness))
+    {
+      // this brightness value is never reached
+      this->BrightnessThresholds[brightness] = std::numeric_limits<double>::quiet_NaN();
+      continue;
+    }
+    uint64_t belowThresholdBits = 0;
+    uint64_t aboveThresholdBits = infinityBits;
+    while (aboveThresholdBits - belowThresholdBits > 1)
+    {
+      uint64_t middleBits = belowThresholdBits + (aboveThresholdBits - belowThresholdBits) / 2;
+      if (ComputeCompressedBrightness(BitsToDouble(middleBits)) >= brightness)
+      {
+        aboveThresholdBits = middleBits;
+      }
+      else
+      {
+        belowThresholdBits = middleBits;
+      }
+    }
+    this->BrightnessThresholds[brightness] = BitsToDouble(aboveThresholdBits);
+  }
+
+  this->BrightnessLookupTable.resize(LOOKUP_TABLE_SIZE);
+  for (int bin = 0; bin < LOOKUP_TABLE_SIZE; bin++)
+  {
+    double binLowerBound = (bin == 0) ? 0.0 : BitsToDouble(LOOKUP_FIRST_BIN_BITS + (static_cast<uint64_t>(bin) << (52 - LOOKUP_MANTISSA_BITS)));
+    int brightness = 0;
+    while (binLowerBound >= this->BrightnessThresholds[brightness + 1])
+    {
+      brightness++;
+    }
+    this->BrightnessLookupTable[bin] = static_cast<unsigned char>(brightness);
+  }
+
+  this->BrightnessThresholdsCompression = this->DynamicRangeCompression;
+  this->BrightnessThresholdsScale = this->BrightnessScale;
+  this->BrightnessThresholdsGamma = this->BrightnessGamma;
+}
+
 //-----------------------------------------------------------------------------
 void vtkPlusRfToBrightnessConvert::ComputeHilbertTransformCoeffs()
 {
@@ -412,6 +793,8 @@ PlusStatus vtkPlusRfToBrightnessConvert::ComputeHilbertTransform(ScalarType* hil
 template<typename ScalarType>
 void vtkPlusRfToBrightnessConvert::ComputeAmplitudeILineQLine(unsigned char* ampl, ScalarType* inputSignal, ScalarType* inputSignalHilbertTransformed, int npt)
 {
+  const unsigned char* brightnessLookupTable = &this->BrightnessLookupTable[0];
+  const double* brightnessThresholds = &this->BrightnessThresholds[0];
   for (int i = 0; i < this->NumberOfHilbertFilterCoeffs / 2 + 1; i++)
   {
     ampl[i] = 0;
@@ -420,10 +803,7 @@ void vtkPlusRfToBrightnessConvert::ComputeAmplitudeILineQLine(unsigned char* amp
   {
     double xt = inputSignal[i];
     double xht = inputSignalHilbertTransformed[i];
-    double brightnessValue = sqrt(sqrt(sqrt(xt * xt + xht * xht))) * this->BrightnessScale;
-    if (brightnessValue > MAX_BRIGHTNESS_VALUE) { brightnessValue = MAX_BRIGHTNESS_VALUE; }
-    if (brightnessValue < MIN_BRIGHTNESS_VALUE) { brightnessValue = MIN_BRIGHTNESS_VALUE; }
-    ampl[i] = brightnessValue;
+    ampl[i] = LookUpBrightness(brightnessLookupTable, brightnessThresholds, xt * xt + xht * xht);
     /*
     If needed, the phase could be computed as follows:
     phase[i] = atan2(xht ,xt);
@@ -440,19 +820,145 @@ void vtkPlusRfToBrightnessConvert::ComputeAmplitudeILineQLine(unsigned char* amp
   }
 }
 
+template<typename ScalarType>
+void vtkPlusRfToBrightnessConvert::ComputeAmplitudeFftHilbertTransform(unsigned char* ampl1, unsigned char* ampl2, ScalarType* inputSignal1, ScalarType* inputSignal2,
+    int npt, const FftPlan& plan, std::vector< std::complex<double> >& buffer)
+{
+  // The two real scanlines are stored in the real and imaginary part of one complex signal.
+  // The Hilbert transform is real and linear, therefore the real and imaginary part of the result
+  // are the Hilbert transforms of the two scanlines.
+  for (int i = 0; i < npt; i++)
+  {
+    buffer[i] = std::complex<double>(inputSignal1[i], inputSignal2 != NULL ? inputSignal2[i] : 0);
+  }
+  for (int i = npt; i < plan.Size; i++)
+  {
+    buffer[i] = 0;
+  }
+
+  plan.Transform(&buffer[0], false);
+
+  // Multiply by -i*sign(frequency) and normalize
+  double scale = 1.0 / plan.Size;
+  buffer[0] = 0;
+  for (int k = 1; k < plan.Size / 2; k++)
+  {
+    buffer[k] = std::complex<double>(buffer[k].imag() * scale, -buffer[k].real() * scale);
+  }
+  if (plan.Size > 1)
+  {
+    buffer[plan.Size / 2] = 0;
+  }
+  for (int k = plan.Size / 2 + 1; k < plan.Size; k++)
+  {
+    buffer[k] = std::complex<double>(-buffer[k].imag() * scale, buffer[k].real() * scale);
+  }
+
+  plan.Transform(&buffer[0], true);
+
+  const unsigned char* brightnessLookupTable = &this->BrightnessLookupTable[0];
+  const double* brightnessThresholds = &this->BrightnessThresholds[0];
+  for (int i = 0; i < npt; i++)
+  {
+    double xt = inputSignal1[i];
+    double xht = buffer[i].real();
+    ampl1[i] = LookUpBrightness(brightnessLookupTable, brightnessThresholds, xt * xt + xht * xht);
+  }
+  if (inputSignal2 == NULL)
+  {
+    return;
+  }
+  for (int i = 0; i < npt; i++)
+  {
+    double xt = inputSignal2[i];
+    double xht = buffer[i].imag();
+    ampl2[i] = LookUpBrightness(brightnessLookupTable, brightnessThresholds, xt * xt + xht * xht);
+  }
+}
+
+template<typename ScalarType>
+void vtkPlusRfToBrightnessConvert::ComputeBrightnessScanlineSamples(ScalarType* rfLine, ScalarType* rfSecondLine, int npt,
+    int firstSample, int lastSample, unsigned char* brightnessScanline, std::vector< std::complex<double> >& workspace)
+{
+  const unsigned char* brightnessLookupTable = &this->BrightnessLookupTable[0];
+  const double* brightnessThresholds = &this->BrightnessThresholds[0];
+
+  if (this->ImageType == US_IMG_RF_IQ_LINE)
+  {
+    for (int i = firstSample; i <= lastSample; i++)
+    {
+      double xt = rfLine[2 * i];
+      double xht = rfLine[2 * i + 1];
+      brightnessScanline[i] = LookUpBrightness(brightnessLookupTable, brightnessThresholds, xt * xt + xht * xht);
+    }
+    return;
+  }
+
+  if (this->ImageType == US_IMG_RF_REAL && this->HilbertTransformMethod == HILBERT_TRANSFORM_FFT)
+  {
+    // The whole scanline is needed for the transform
+    workspace.resize(this->HilbertFftPlan->Size);
+    ComputeAmplitudeFftHilbertTransform(brightnessScanline, static_cast<unsigned char*>(NULL), rfLine, static_cast<ScalarType*>(NULL), npt, *this->HilbertFftPlan, workspace);
+    return;
+  }
+
+  // Same result as ComputeHilbertTransform (for US_IMG_RF_REAL) followed by ComputeAmplitudeILineQLine, but only the
+  // requested samples are computed. The samples at the ends of the scanline are not computed, as the filter does not fit.
+  const int numberOfCoeffs = this->NumberOfHilbertFilterCoeffs;
+  const double* hilbertTransformCoeffs = &this->HilbertTransformCoeffs[0];
+  int firstComputedSample = std::max(firstSample, numberOfCoeffs / 2 + 1);
+  int lastComputedSample = std::min(lastSample, npt - numberOfCoeffs / 2);
+  if (this->ImageType == US_IMG_RF_REAL)
+  {
+    // ComputeHilbertTransform only shifts this many filter outputs into the scanline
+    lastComputedSample = std::min(lastComputedSample, npt - numberOfCoeffs + numberOfCoeffs / 2);
+  }
+  for (int i = firstSample; i <= lastSample && i < firstComputedSample; i++)
+  {
+    brightnessScanline[i] = 0;
+  }
+  ScalarType nextFilterOutput = 0;
+  for (int i = firstComputedSample; i <= lastComputedSample; i++)
+  {
+    double xt = rfLine[i];
+    double xht = 0;
+    if (this->ImageType == US_IMG_RF_REAL)
+    {
+      // The Hilbert transform at sample i is the average of the filter outputs at i-numberOfCoeffs/2 and i-numberOfCoeffs/2+1
+      int filterIndex = i - numberOfCoeffs / 2;
+      ScalarType filterOutput = nextFilterOutput;
+      if (i == firstComputedSample)
+      {
+        filterOutput = ComputeHilbertFilterOutput(rfLine, hilbertTransformCoeffs, numberOfCoeffs, filterIndex);
+      }
+      nextFilterOutput = ComputeHilbertFilterOutput(rfLine, hilbertTransformCoeffs, numberOfCoeffs, filterIndex + 1);
+      ScalarType hilbertTransformOutput = 0.5 * (filterOutput + nextFilterOutput);
+      xht = hilbertTransformOutput;
+    }
+    else
+    {
+      xht = rfSecondLine[i];
+    }
+    brightnessScanline[i] = LookUpBrightness(brightnessLookupTable, brightnessThresholds, xt * xt + xht * xht);
+  }
+  for (int i = std::max(firstSample, lastComputedSample + 1); i <= lastSample; i++)
+  {
+    brightnessScanline[i] = 0;
+  }
+}
+
 template<typename ScalarType>
 void vtkPlusRfToBrightnessConvert::ComputeAmplitudeIqLine(unsigned char* ampl, ScalarType* inputSignal, const int npt)
 {
   int inputIndex = 0;
   int outputIndex = 0;
   int numberOfIqPairs = floor(double(npt) / 2);
+  const unsigned char* brightnessLookupTable = &this->BrightnessLookupTable[0];
+  const double* brightnessThresholds = &this->BrightnessThresholds[0];
   for (int i = 0; i < numberOfIqPairs; i++)
   {
     double xt = inputSignal[inputIndex++];
     double xht = inputSignal[inputIndex++];
-    double outputValue = sqrt(sqrt(sqrt(xt * xt + xht * xht))) * this->BrightnessScale;
-    if (outputValue > MAX_BRIGHTNESS_VALUE) { outputValue = MAX_BRIGHTNESS_VALUE; }
-    if (outputValue < MIN_BRIGHTNESS_VALUE) { outputValue = MIN_BRIGHTNESS_VALUE; }
-    ampl[outputIndex++] = outputValue;
+    ampl[outputIndex++] = LookUpBrightness(brightnessLookupTable, brightnessThresholds, xt * xt + xht * xht);
   }
 }
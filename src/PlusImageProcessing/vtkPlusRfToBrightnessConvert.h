@@ -10,6 +10,10 @@
 #include "vtkPlusImageProcessingExport.h"
 #include "vtkThreadedImageAlgorithm.h"
 
+#include <complex>
+#include <memory>
+#include <vector>
+
 /*!
 \class vtkPlusRfToBrightnessConvert
 \brief This class converts ultrasound RF data to brightness values
@@ -22,11 +26,22 @@ the Euclidean norm of the RF signal (in-phase, I) and a 90deg phase shifted vers
 RF signal (quadrature, Q). The Q signal may be provided by the acquisition system or can be
 computed from the I signal by a Hilbert transform.
 
+The Hilbert transform is computed either by a convolution filter (HilbertTransformMethod="FIR", default),
+which has NumberOfHilbertFilterCoeffs taps and leaves NumberOfHilbertFilterCoeffs/2 samples blank at both ends
+of each scanline, or in the frequency domain (HilbertTransformMethod="FFT"), which computes the exact analytic
+signal of the whole scanline. The FFT is precomputed for the scanline length and two scanlines are
+transformed at once, so its cost does not depend on the filter length.
+
 Dynamic range compression converts the 16-bit input signal to 8-bit by a non-linear function.
-In this filter the compressedSignal=sqrt(sqrt(envelopeDetected))*BrightnessScale function is used.
-A log function is also frequently used for dynamic range compression. The sqrt(sqrt(.)) function was
-chosen because it provides a somewhat more linear mapping than log(.) function for the input data
-range (16 bits).
+By default (DynamicRangeCompression="SqrtSqrt") the compressedSignal=sqrt(sqrt(envelopeDetected))*BrightnessScale
+function is used. The sqrt(sqrt(.)) function was chosen because it provides a somewhat more linear mapping
+than log(.) function for the input data range (16 bits). A log function is also frequently used for dynamic
+range compression (DynamicRangeCompression="Log": log(1+envelopeDetected)*BrightnessScale), and a gamma curve
+(DynamicRangeCompression="Gamma": pow(envelopeDetected, BrightnessGamma)*BrightnessScale) is available, too.
+The compression function is not evaluated for each sample: the squared envelope values where the output
+brightness changes are precomputed and the brightness is looked up from a table indexed by the quantized
+squared envelope, therefore all compression functions have the same computation cost and the result is
+the same as if the compression function was evaluated for each sample.
 
 The input image type must be VTK_SHORT (signed 16-bit) and the output image type
 is always VTK_UNSIGNED_CHAR (unsigned 8-bit).
@@ -36,6 +51,19 @@ is always VTK_UNSIGNED_CHAR (unsigned 8-bit).
 class vtkPlusImageProcessingExport vtkPlusRfToBrightnessConvert : public vtkThreadedImageAlgorithm
 {
 public:
+  enum DynamicRangeCompressionType
+  {
+    COMPRESSION_SQRT_SQRT,
+    COMPRESSION_LOG,
+    COMPRESSION_GAMMA
+  };
+
+  enum HilbertTransformMethodType
+  {
+    HILBERT_TRANSFORM_FIR,
+    HILBERT_TRANSFORM_FFT
+  };
+
   static vtkPlusRfToBrightnessConvert *New();
   vtkTypeMacro(vtkPlusRfToBrightnessConvert,vtkThreadedImageAlgorithm);
   virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
@@ -53,9 +81,49 @@ public:
   vtkSetMacro(NumberOfHilbertFilterCoeffs, int);
   vtkGetMacro(NumberOfHilbertFilterCoeffs, int);
 
+  /*! Specify if the Hilbert transform of US_IMG_RF_REAL data is computed by a convolution filter or by FFT */
+  vtkSetMacro(HilbertTransformMethod, HilbertTransformMethodType);
+  vtkGetMacro(HilbertTransformMethod, HilbertTransformMethodType);
+
   vtkSetMacro(BrightnessScale, double);
   vtkGetMacro(BrightnessScale, double);
 
+  /*! Function that maps envelope detected values to brightness values */
+  vtkSetMacro(DynamicRangeCompression, DynamicRangeCompressionType);
+  vtkGetMacro(DynamicRangeCompression, DynamicRangeCompressionType);
+
+  /*! Exponent of the gamma dynamic range compression function */
+  vtkSetClampMacro(BrightnessGamma, double, 0.0, VTK_DOUBLE_MAX);
+  vtkGetMacro(BrightnessGamma, double);
+
+  /*!
+    Get the Hilbert transform coefficients for the current NumberOfHilbertFilterCoeffs.
+    Element 0 is not used, elements 1..NumberOfHilbertFilterCoeffs are the filter coefficients.
+  */
+  const std::vector<double>& GetHilbertTransformCoeffs();
+
+  /*! Compute the extent of the B-mode image from the extent of the RF image. Returns PLUS_FAIL for unknown image types. */
+  static PlusStatus GetBrightnessImageExtent(US_IMAGE_TYPE imageType, const int rfImageExtent[6], int brightnessImageExtent[6]);
+
+  /*!
+    Prepare the lookup table, filter coefficients and FFT that ComputeBrightnessScanline uses for the current parameters.
+    Must be called after the parameters are changed and before ComputeBrightnessScanline is called (from any thread).
+  */
+  void PrepareBrightnessScanlineComputation(int numberOfRfSamplesInScanline);
+
+  /*!
+    Compute samples [firstSample, lastSample] of a B-mode scanline from an RF frame, outside of the VTK pipeline.
+    It allows computing only those B-mode samples that are used by scan conversion. The values are the same as in the
+    output of the filter, except for the FFT Hilbert transform method, as the scanline is transformed without its neighbor
+    scanline, which may change a few values by one intensity level. May be called from multiple threads.
+    \param rfFrame RF data, encoded as specified by ImageType
+    \param scanlineIndex index of the B-mode scanline (row of the B-mode image)
+    \param brightnessScanline output, which must have space for the whole B-mode scanline. Samples outside of the requested range may be modified.
+    \param workspace temporary buffer, may be reused between calls in the same thread
+  */
+  PlusStatus ComputeBrightnessScanline(vtkImageData* rfFrame, int scanlineIndex, int firstSample, int lastSample,
+    unsigned char* brightnessScanline, std::vector< std::complex<double> >& workspace);
+
 protected:
   vtkPlusRfToBrightnessConvert();
   ~vtkPlusRfToBrightnessConvert();
@@ -70,6 +138,12 @@ protected:
                             vtkImageData ***inData, vtkImageData **outData,
                             int outExt[6], int id);
 
+  /*! Compute brightness value from the squared envelope value using the dynamic range compression function */
+  double ComputeCompressedBrightness(double squaredEnvelope) const;
+
+  /*! Compute the brightness lookup table if the compression parameters changed. Used by RequestInformation. */
+  void UpdateBrightnessThresholds();
+
   /*! Compute the Hilbert transform coefficients. Used by the ComputeHilbertTransform method. */
   virtual void ComputeHilbertTransformCoeffs();
 
@@ -85,6 +159,25 @@ protected:
   template<typename ScalarType>
   void ComputeAmplitudeILineQLine(unsigned char *ampl, ScalarType *inputSignal, ScalarType *inputSignalHilbertTransformed, int npt);
   
+  /*! Precomputed bit reversal table and twiddle factors for FFT of scanlines */
+  struct FftPlan;
+
+  /*!
+    Compute amplitude from real RF data using FFT-based Hilbert transform. Two scanlines are processed at once,
+    inputSignal2 and ampl2 may be NULL if there is only one scanline to process. npt is the number of samples in a scanline.
+  */
+  template<typename ScalarType>
+  void ComputeAmplitudeFftHilbertTransform(unsigned char *ampl1, unsigned char *ampl2, ScalarType *inputSignal1, ScalarType *inputSignal2,
+    int npt, const FftPlan& plan, std::vector< std::complex<double> >& buffer);
+
+  /*!
+    Compute samples [firstSample, lastSample] of a B-mode scanline. rfSecondLine is the Q line for US_IMG_RF_I_LINE_Q_LINE images.
+    npt is the number of samples in an RF scanline.
+  */
+  template<typename ScalarType>
+  void ComputeBrightnessScanlineSamples(ScalarType *rfLine, ScalarType *rfSecondLine, int npt, int firstSample, int lastSample,
+    unsigned char *brightnessScanline, std::vector< std::complex<double> >& workspace);
+
   /*! Compute amplitude from IQ encoded RF data. npt is the number of IQ pairs * 2. */
   template<typename ScalarType>
   void ComputeAmplitudeIqLine(unsigned char *ampl, ScalarType *inputSignal, const int npt);
@@ -92,12 +185,36 @@ protected:
   /*! Scaling of the brightness output. Higher value means brighter image. */
   double BrightnessScale;
 
+  /*! Function that maps envelope detected values to brightness values */
+  DynamicRangeCompressionType DynamicRangeCompression;
+
+  /*! Exponent of the gamma dynamic range compression function */
+  double BrightnessGamma;
+
+  /*!
+    Smallest squared envelope value for each brightness value (element i is the threshold of brightness i,
+    NaN if it cannot be reached, element 0 is not used, the last element is NaN). Computed from the compression
+    parameters stored in BrightnessThresholdsCompression, BrightnessThresholdsScale and BrightnessThresholdsGamma.
+  */
+  std::vector<double> BrightnessThresholds;
+  /*! Brightness value at the lower bound of each quantized squared envelope bin */
+  std::vector<unsigned char> BrightnessLookupTable;
+  DynamicRangeCompressionType BrightnessThresholdsCompression;
+  double BrightnessThresholdsScale;
+  double BrightnessThresholdsGamma;
+
   /*! Number of the Hilbert transform convolution filter coefficients. Higher number results in better approximation but longer computation time. */
   int NumberOfHilbertFilterCoeffs;
 
   /*! Coefficients of the Hilbert transform, computed from the NumberOfHilbertFilterCoeffs */
   std::vector<double> HilbertTransformCoeffs;
 
+  /*! Hilbert transform computation method for US_IMG_RF_REAL data */
+  HilbertTransformMethodType HilbertTransformMethod;
+
+  /*! FFT plan for the current scanline length, updated in RequestInformation */
+  std::shared_ptr<const FftPlan> HilbertFftPlan;
+
   /*! Image type (RF_IQ_LINE, RF_I_LINE_Q_LINE, ...) */
   US_IMAGE_TYPE ImageType;
 
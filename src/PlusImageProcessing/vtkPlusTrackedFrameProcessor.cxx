@@ -10,6 +10,16 @@ See License.txt for details.
 #include "vtkIGSIOTrackedFrameList.h"
 #include "vtkIGSIOTransformRepository.h"
 #include "igsioCommon.h"
+#include "igsioTrackedFrame.h"
+
+#include <algorithm>
+
+namespace
+{
+  // Number of frames in a processing window for each worker thread. A few frames per worker are needed
+  // for load balancing, as processing time of frames may be different.
+  const int WINDOW_FRAMES_PER_WORKER = 4;
+}
 
 //----------------------------------------------------------------------------
 vtkCxxSetObjectMacro( vtkPlusTrackedFrameProcessor, InputFrames, vtkIGSIOTrackedFrameList );
@@ -22,6 +32,9 @@ vtkPlusTrackedFrameProcessor::vtkPlusTrackedFrameProcessor()
   this->InputFrames = NULL;
   this->TransformRepository = NULL;
   this->OutputFrames = vtkIGSIOTrackedFrameList::New();
+  this->NumberOfThreads = 1;
+  this->NumberOfWindowFrames = 0;
+  this->NextWindowFrameIndex = 0;
 }
 
 //----------------------------------------------------------------------------
@@ -37,12 +50,14 @@ vtkPlusTrackedFrameProcessor::~vtkPlusTrackedFrameProcessor()
 void vtkPlusTrackedFrameProcessor::PrintSelf( ostream& os, vtkIndent indent )
 {
   this->Superclass::PrintSelf( os, indent );
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << std::endl;
 }
 
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusTrackedFrameProcessor::ReadConfiguration( vtkXMLDataElement* processingElement )
 {
   XML_VERIFY_ELEMENT( processingElement, this->GetTagName() );
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL( int, NumberOfThreads, processingElement );
   return PLUS_SUCCESS;
 }
 
@@ -51,6 +66,7 @@ PlusStatus vtkPlusTrackedFrameProcessor::WriteConfiguration( vtkXMLDataElement*
 {
   XML_VERIFY_ELEMENT( processingElement, this->GetTagName() );
   processingElement->SetAttribute( "Type", this->GetProcessorTypeName() );
+  processingElement->SetIntAttribute( "NumberOfThreads", this->NumberOfThreads );
   return PLUS_SUCCESS;
 }
 
@@ -63,6 +79,10 @@ PlusStatus vtkPlusTrackedFrameProcessor::Update()
     // nothing to do
     return PLUS_SUCCESS;
   }
+  if ( this->NumberOfThreads != 1 && this->InputFrames->GetNumberOfTrackedFrames() > 1 && this->PrepareWorkers() > 1 )
+  {
+    return this->UpdateFrameParallel();
+  }
   PlusStatus status = PLUS_SUCCESS;
   for ( unsigned int frameIndex = 0; frameIndex < this->InputFrames->GetNumberOfTrackedFrames(); frameIndex++ )
   {
@@ -90,4 +110,244 @@ PlusStatus vtkPlusTrackedFrameProcessor::Update()
   }
 
   return status;
-}
\ No newline at end of file
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusTrackedFrameProcessor::ProcessTrackedFrame( igsioTrackedFrame* inputFrame, igsioTrackedFrame* outputFrame )
+{
+  if ( inputFrame == NULL || outputFrame == NULL )
+  {
+    LOG_ERROR( "Input and output frames are required for processing a frame" );
+    return PLUS_FAIL;
+  }
+  if ( this->TransformRepository && this->TransformRepository->SetTransforms( *inputFrame ) != PLUS_SUCCESS )
+  {
+    LOG_ERROR( "Failed to set repository transforms from tracked frame!" );
+    return PLUS_FAIL;
+  }
+  return this->ProcessFrame( inputFrame, outputFrame );
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusTrackedFrameProcessor::UpdateFrameParallel()
+{
+  PlusStatus status = PLUS_SUCCESS;
+  const unsigned int numberOfInputFrames = this->InputFrames->GetNumberOfTrackedFrames();
+  const unsigned int windowSize = this->WindowInputFrames.size();
+  std::vector<unsigned int> outputFrameIndices( windowSize );
+  for ( unsigned int windowStartIndex = 0; windowStartIndex < numberOfInputFrames; windowStartIndex += windowSize )
+  {
+    int numberOfFrames = std::min( windowSize, numberOfInputFrames - windowStartIndex );
+    for ( int i = 0; i < numberOfFrames; i++ )
+    {
+      // Create a clone of the input frame in the output buffer, as in sequential processing
+      this->WindowInputFrames[i] = this->InputFrames->GetTrackedFrame( windowStartIndex + i );
+      this->OutputFrames->AddTrackedFrame( this->WindowInputFrames[i] );
+      outputFrameIndices[i] = this->OutputFrames->GetNumberOfTrackedFrames() - 1;
+      this->WindowOutputFrames[i] = this->OutputFrames->GetTrackedFrame( outputFrameIndices[i] );
+    }
+
+    if ( this->ProcessFrameWindow( numberOfFrames ) != PLUS_SUCCESS )
+    {
+      status = PLUS_FAIL;
+    }
+
+    // Frames that transforms could not be set from are not added to the output in sequential processing either
+    for ( int i = numberOfFrames - 1; i >= 0; i-- )
+    {
+      if ( this->WindowFrameStatus[i] == WINDOW_FRAME_SKIPPED )
+      {
+        this->OutputFrames->RemoveTrackedFrameRange( outputFrameIndices[i], outputFrameIndices[i] );
+      }
+    }
+  }
+
+  this->ReleaseWorkers();
+  return status;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusTrackedFrameProcessor::ProcessFrameStream( const InputFrameReaderType& readInputFrame, const OutputFrameWriterType& writeOutputFrame )
+{
+  if ( !readInputFrame || !writeOutputFrame )
+  {
+    LOG_ERROR( "Frame reader and writer are required for processing a frame stream" );
+    return PLUS_FAIL;
+  }
+
+  this->PrepareWorkers();
+  const int windowSize = this->WindowInputFrames.size();
+  std::vector<igsioTrackedFrame> inputFrames( windowSize );
+  std::vector<igsioTrackedFrame> outputFrames( windowSize );
+
+  PlusStatus status = PLUS_SUCCESS;
+  bool endOfStream = false;
+  while ( !endOfStream )
+  {
+    int numberOfFrames = 0;
+    for ( ; numberOfFrames < windowSize; numberOfFrames++ )
+    {
+      if ( !readInputFrame( inputFrames[numberOfFrames] ) )
+      {
+        endOfStream = true;
+        break;
+      }
+      // The output frame starts as a copy of the input frame, as in Update()
+      outputFrames[numberOfFrames] = inputFrames[numberOfFrames];
+      this->WindowInputFrames[numberOfFrames] = &inputFrames[numberOfFrames];
+      this->WindowOutputFrames[numberOfFrames] = &outputFrames[numberOfFrames];
+    }
+
+    if ( this->ProcessFrameWindow( numberOfFrames ) != PLUS_SUCCESS )
+    {
+      status = PLUS_FAIL;
+    }
+
+    for ( int i = 0; i < numberOfFrames; i++ )
+    {
+      if ( this->WindowFrameStatus[i] == WINDOW_FRAME_SKIPPED )
+      {
+        continue;
+      }
+      if ( writeOutputFrame( outputFrames[i] ) != PLUS_SUCCESS )
+      {
+        LOG_ERROR( "Failed to write processed frame, processing is stopped" );
+        this->ReleaseWorkers();
+        return PLUS_FAIL;
+      }
+    }
+  }
+
+  this->ReleaseWorkers();
+  return status;
+}
+
+//-----------------------------------------------------------------------------
+vtkPlusTrackedFrameProcessor* vtkPlusTrackedFrameProcessor::CreateWorkerProcessor()
+{
+  vtkPlusTrackedFrameProcessor* worker = this->NewInstance();
+  vtkSmartPointer<vtkXMLDataElement> processingElement = vtkSmartPointer<vtkXMLDataElement>::New();
+  processingElement->SetName( this->GetTagName() );
+  if ( this->WriteConfiguration( processingElement ) != PLUS_SUCCESS || worker->ReadConfiguration( processingElement ) != PLUS_SUCCESS )
+  {
+    LOG_ERROR( "Failed to copy the configuration of the " << this->GetProcessorTypeName() << " processor to a worker" );
+    worker->Delete();
+    return NULL;
+  }
+  return worker;
+}
+
+//-----------------------------------------------------------------------------
+int vtkPlusTrackedFrameProcessor::PrepareWorkers()
+{
+  this->ReleaseWorkers();
+
+  int numberOfWorkers = ( this->NumberOfThreads > 0 ? this->NumberOfThreads : vtkMultiThreader::GetGlobalDefaultNumberOfThreads() );
+  numberOfWorkers = std::max( 1, std::min( numberOfWorkers, VTK_MAX_THREADS ) );
+  if ( numberOfWorkers > 1 && !this->IsFrameParallelProcessingSupported() )
+  {
+    LOG_DEBUG( "The " << this->GetProcessorTypeName() << " processor does not support frame-parallel processing with the current settings, frames are processed in one thread" );
+    numberOfWorkers = 1;
+  }
+
+  for ( int workerIndex = 1; workerIndex < numberOfWorkers; workerIndex++ )
+  {
+    vtkSmartPointer<vtkPlusTrackedFrameProcessor> worker = vtkSmartPointer<vtkPlusTrackedFrameProcessor>::Take( this->CreateWorkerProcessor() );
+    if ( worker == NULL )
+    {
+      LOG_WARNING( "Failed to create worker processors, frames are processed in one thread" );
+      this->WorkerProcessors.clear();
+      numberOfWorkers = 1;
+      break;
+    }
+    if ( this->TransformRepository != NULL )
+    {
+      // Each worker sets the transforms of its frames in its own repository
+      vtkSmartPointer<vtkIGSIOTransformRepository> transformRepository = vtkSmartPointer<vtkIGSIOTransformRepository>::New();
+      transformRepository->DeepCopy( this->TransformRepository );
+      worker->SetTransformRepository( transformRepository );
+    }
+    this->WorkerProcessors.push_back( worker );
+  }
+
+  if ( numberOfWorkers > 1 && this->FrameThreader == NULL )
+  {
+    this->FrameThreader = vtkSmartPointer<vtkMultiThreader>::New();
+  }
+
+  const int windowSize = numberOfWorkers * WINDOW_FRAMES_PER_WORKER;
+  this->WindowInputFrames.assign( windowSize, NULL );
+  this->WindowOutputFrames.assign( windowSize, NULL );
+  this->WindowFrameStatus.assign( windowSize, WINDOW_FRAME_PROCESSED );
+  this->NumberOfWindowFrames = 0;
+
+  return numberOfWorkers;
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusTrackedFrameProcessor::ReleaseWorkers()
+{
+  this->WorkerProcessors.clear();
+  this->WindowInputFrames.clear();
+  this->WindowOutputFrames.clear();
+  this->WindowFrameStatus.clear();
+  this->NumberOfWindowFrames = 0;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusTrackedFrameProcessor::ProcessFrameWindow( int numberOfFrames )
+{
+  this->NumberOfWindowFrames = numberOfFrames;
+  this->NextWindowFrameIndex = 0;
+  int numberOfThreads = std::min( static_cast<int>( this->WorkerProcessors.size() ) + 1, numberOfFrames );
+  if ( numberOfThreads > 1 )
+  {
+    this->FrameThreader->SetNumberOfThreads( numberOfThreads );
+    this->FrameThreader->SetSingleMethod( ( vtkThreadFunctionType )&FrameProcessingThread, this );
+    this->FrameThreader->SingleMethodExecute();
+  }
+  else
+  {
+    this->ProcessWindowFrames( this );
+  }
+
+  PlusStatus status = PLUS_SUCCESS;
+  for ( int i = 0; i < numberOfFrames; i++ )
+  {
+    if ( this->WindowFrameStatus[i] != WINDOW_FRAME_PROCESSED )
+    {
+      status = PLUS_FAIL;
+    }
+  }
+  return status;
+}
+
+//-----------------------------------------------------------------------------
+void* vtkPlusTrackedFrameProcessor::FrameProcessingThread( vtkMultiThreader::ThreadInfo* data )
+{
+  vtkPlusTrackedFrameProcessor* self = static_cast<vtkPlusTrackedFrameProcessor*>( data->UserData );
+  vtkPlusTrackedFrameProcessor* worker = ( data->ThreadID == 0 ? self : self->WorkerProcessors[data->ThreadID - 1].GetPointer() );
+  self->ProcessWindowFrames( worker );
+  return NULL;
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusTrackedFrameProcessor::ProcessWindowFrames( vtkPlusTrackedFrameProcessor* worker )
+{
+  for ( int frameIndex = this->NextWindowFrameIndex++; frameIndex < this->NumberOfWindowFrames; frameIndex = this->NextWindowFrameIndex++ )
+  {
+    igsioTrackedFrame* inputFrame = this->WindowInputFrames[frameIndex];
+    if ( worker->TransformRepository && worker->TransformRepository->SetTransforms( *inputFrame ) != PLUS_SUCCESS )
+    {
+      LOG_ERROR( "Failed to set repository transforms from tracked frame!" );
+      this->WindowFrameStatus[frameIndex] = WINDOW_FRAME_SKIPPED;
+      continue;
+    }
+    if ( worker->ProcessFrame( inputFrame, this->WindowOutputFrames[frameIndex] ) != PLUS_SUCCESS )
+    {
+      this->WindowFrameStatus[frameIndex] = WINDOW_FRAME_PROCESSING_FAILED;
+      continue;
+    }
+    this->WindowFrameStatus[frameIndex] = WINDOW_FRAME_PROCESSED;
+  }
+}
@@ -8,6 +8,12 @@
 #define __vtkPlusTrackedFrameProcessor_h
 
 #include "vtkPlusImageProcessingExport.h"
+#include "vtkMultiThreader.h"
+#include "vtkSmartPointer.h"
+
+#include <atomic>
+#include <functional>
+#include <vector>
 
 //class igsioTrackedFrame; 
 //class vtkIGSIOTrackedFrameList;
@@ -16,6 +22,13 @@
 /*!
   \class vtkPlusTrackedFrameProcessor 
   \brief Simple interface class to allow running various algorithms that process tracked frame lists
+
+  Frames are independent from each other, therefore if NumberOfThreads is not 1 then frames are processed in parallel.
+  Each worker thread uses its own copy of the processor (see CreateWorkerProcessor) and of the transform repository.
+  Frames are processed in windows of a few frames per worker thread and the output frames are always in the same order
+  as the input frames. ProcessFrameStream keeps only one window of frames in memory, therefore it can be used for
+  processing long sequences.
+
   \ingroup PlusLibImageProcessingAlgo
 */ 
 class vtkPlusImageProcessingExport vtkPlusTrackedFrameProcessor : public vtkObject
@@ -39,7 +52,42 @@ public:
      are not processed one by one.
    */
   virtual PlusStatus Update();
- 
+
+  /*! Reads the next input frame into the provided frame. Returns false if there are no more frames. */
+  typedef std::function<bool(igsioTrackedFrame& inputFrame)> InputFrameReaderType;
+  /*! Receives the processed output frames, in the order of the input frames */
+  typedef std::function<PlusStatus(igsioTrackedFrame& outputFrame)> OutputFrameWriterType;
+
+  /*!
+    Process all frames that the reader provides and pass the results to the writer. Same as Update(), but InputFrames
+    and OutputFrames are not used and only a few frames per worker thread are kept in memory at a time.
+    Returns PLUS_FAIL if any of the frames could not be processed. Processing is stopped if the writer fails.
+  */
+  PlusStatus ProcessFrameStream(const InputFrameReaderType& readInputFrame, const OutputFrameWriterType& writeOutputFrame);
+
+  /*!
+    Process a single frame in the caller thread, without using InputFrames and OutputFrames. The transform repository is updated
+    from the input frame. The output frame is not required to contain a copy of the input image: the processors replace its image.
+  */
+  PlusStatus ProcessTrackedFrame(igsioTrackedFrame* inputFrame, igsioTrackedFrame* outputFrame);
+
+  /*!
+    Number of frames that are processed in parallel. 1 (default) means that all frames are processed in the caller thread,
+    0 means that one worker thread is used for each processor core.
+  */
+  vtkSetClampMacro(NumberOfThreads, int, 0, VTK_MAX_THREADS);
+  vtkGetMacro(NumberOfThreads, int);
+
+  /*!
+    Create a processor that processes frames in a worker thread. The caller owns the returned object, NULL is returned
+    in case of an error. The default implementation creates a new instance and copies the configuration to it
+    by WriteConfiguration and ReadConfiguration. The transform repository is set by the caller.
+  */
+  virtual vtkPlusTrackedFrameProcessor* CreateWorkerProcessor();
+
+  /*! Returns false if the frames must be processed one by one in the caller thread (e.g., if data is collected across frames) */
+  virtual bool IsFrameParallelProcessingSupported() { return true; };
+
   /*! Get the processed output data. Perform processing if needed. */
   vtkGetObjectMacro(OutputFrames, vtkIGSIOTrackedFrameList);
 
@@ -65,9 +113,52 @@ protected:
   */
   virtual PlusStatus ProcessFrame(igsioTrackedFrame* inputFrame, igsioTrackedFrame* outputFrame) = 0;
 
+  /*! Processing state of the frames of the current window */
+  enum WindowFrameStatusType
+  {
+    WINDOW_FRAME_PROCESSED,
+    WINDOW_FRAME_PROCESSING_FAILED,
+    WINDOW_FRAME_SKIPPED // the frame is not included in the output because transforms could not be set from it
+  };
+
+  /*! Create the worker processors. Returns the number of workers, which is 1 if frames are processed in the caller thread. */
+  int PrepareWorkers();
+
+  /*! Delete the worker processors */
+  void ReleaseWorkers();
+
+  /*! Frame-parallel implementation of Update(). Requires prepared workers. */
+  PlusStatus UpdateFrameParallel();
+
+  /*! Process the first numberOfFrames frames of WindowInputFrames into WindowOutputFrames using all the workers */
+  PlusStatus ProcessFrameWindow(int numberOfFrames);
+
+  /*! Process frames of the current window until all of them are taken by a worker */
+  void ProcessWindowFrames(vtkPlusTrackedFrameProcessor* worker);
+
+  static void* FrameProcessingThread(vtkMultiThreader::ThreadInfo* data);
+
   vtkIGSIOTrackedFrameList* InputFrames;
   vtkIGSIOTransformRepository *TransformRepository;
   vtkIGSIOTrackedFrameList* OutputFrames;
+
+  /*! Number of frames that are processed in parallel, 0 means the number of processor cores */
+  int NumberOfThreads;
+
+  /*! Processors of the worker threads. The first worker thread uses this object, therefore it is not in the list. */
+  std::vector< vtkSmartPointer<vtkPlusTrackedFrameProcessor> > WorkerProcessors;
+  vtkSmartPointer<vtkMultiThreader> FrameThreader;
+
+  /*! Frames of the window that is being processed. Each frame is processed by the worker that takes its index from NextWindowFrameIndex. */
+  std::vector<igsioTrackedFrame*> WindowInputFrames;
+  std::vector<igsioTrackedFrame*> WindowOutputFrames;
+  std::vector<WindowFrameStatusType> WindowFrameStatus;
+  int NumberOfWindowFrames;
+  std::atomic<int> NextWindowFrameIndex;
+
+private:
+  vtkPlusTrackedFrameProcessor(const vtkPlusTrackedFrameProcessor&);  // Not implemented.
+  void operator=(const vtkPlusTrackedFrameProcessor&);  // Not implemented.
 }; 
 
 #endif
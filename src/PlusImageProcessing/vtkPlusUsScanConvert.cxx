@@ -7,6 +7,7 @@ See License.txt for details.
 #include "PlusConfigure.h"
 
 #include "vtkPlusUsScanConvert.h"
+#include "PlusValidPixelMask.h"
 
 #include "vtkObjectFactory.h"
 
@@ -137,3 +138,39 @@ FrameSizeType vtkPlusUsScanConvert::GetOutputImageSizePixel()
                             };
   return frameSize;
 }
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusUsScanConvert::ComputeOutputImageValidPixelMask(PlusValidPixelMask& mask, int marginPixels /*=1*/)
+{
+  mask.Clear();
+
+  int numberOfScanLines = this->InputImageExtent[3] - this->InputImageExtent[2] + 1;
+  if (numberOfScanLines < 2)
+  {
+    LOG_ERROR("ComputeOutputImageValidPixelMask failed: at least 2 scanlines are required, but the input image extent contains " << numberOfScanLines);
+    return PLUS_FAIL;
+  }
+
+  // The region is bounded by the scanline start points (transducer surface), the last scanline,
+  // the scanline end points (in reverse order) and the first scanline
+  std::vector<double> polygonColumns(2 * numberOfScanLines);
+  std::vector<double> polygonRows(2 * numberOfScanLines);
+  for (int scanLineIndex = 0; scanLineIndex < numberOfScanLines; ++scanLineIndex)
+  {
+    double scanlineStartPoint_OutputImage[4] = {0, 0, 0, 1};
+    double scanlineEndPoint_OutputImage[4] = {0, 0, 0, 1};
+    if (this->GetScanLineEndPoints(scanLineIndex, scanlineStartPoint_OutputImage, scanlineEndPoint_OutputImage) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("ComputeOutputImageValidPixelMask failed: cannot get end points of scanline " << scanLineIndex);
+      return PLUS_FAIL;
+    }
+    polygonColumns[scanLineIndex] = scanlineStartPoint_OutputImage[0];
+    polygonRows[scanLineIndex] = scanlineStartPoint_OutputImage[1];
+    polygonColumns[2 * numberOfScanLines - 1 - scanLineIndex] = scanlineEndPoint_OutputImage[0];
+    polygonRows[2 * numberOfScanLines - 1 - scanLineIndex] = scanlineEndPoint_OutputImage[1];
+  }
+
+  FrameSizeType outputImageSizePixel = this->GetOutputImageSizePixel();
+  mask.SetToPolygon(outputImageSizePixel[0], outputImageSizePixel[1], polygonColumns, polygonRows, marginPixels);
+  return PLUS_SUCCESS;
+}
@@ -10,6 +10,8 @@ See License.txt for details.
 #include "vtkPlusImageProcessingExport.h"
 #include "vtkThreadedImageAlgorithm.h"
 
+class PlusValidPixelMask;
+
 /*!
 \class vtkPlusUsScanConvert
 \brief This is a base class for defining a common scan conversion algorithm interface for all kinds of probes
@@ -66,6 +68,15 @@ public:
   /*! Get the distance between two sample points in the scanline, in mm. Setting of the input image or at least the input image extent is required before calling this method. */
   virtual double GetDistanceBetweenScanlineSamplePointsMm() = 0;
 
+  /*!
+    Compute the mask of the output image pixels that are covered by the scanlines (the fan for curvilinear probes),
+    so that processing of the scan converted image can be restricted to these pixels.
+    Setting of the input image or at least the input image extent is required before calling this method.
+    \param mask the computed mask, of the size of the output image
+    \param marginPixels pixels that are closer to the region boundary than this are also considered valid
+  */
+  virtual PlusStatus ComputeOutputImageValidPixelMask(PlusValidPixelMask& mask, int marginPixels = 1);
+
 protected:
   vtkPlusUsScanConvert();
   virtual ~vtkPlusUsScanConvert();
@@ -13,6 +13,7 @@ non-commercial terms in your toolbox and distribute it."
 */
 
 #include "PlusConfigure.h"
+#include "PlusProfiler.h"
 #include "igsioCommon.h"
 
 #include "vtkPlusUsScanConvertCurvilinear.h"
@@ -32,8 +33,230 @@ non-commercial terms in your toolbox and distribute it."
 #include <string.h>
 #include <ctype.h>
 
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+  #define PLUS_SCAN_CONVERT_AVX2
+  #if defined(_MSC_VER)
+    #include <intrin.h>
+    #define PLUS_SCAN_CONVERT_AVX2_TARGET
+  #else
+    #define PLUS_SCAN_CONVERT_AVX2_TARGET __attribute__((target("avx2")))
+  #endif
+  #include <immintrin.h>
+#endif
+
 vtkStandardNewMacro( vtkPlusUsScanConvertCurvilinear );
 
+namespace
+{
+  /*! Number of interpolation tables that are kept for recently used scan conversion parameters */
+  const size_t MAX_NUMBER_OF_CACHED_INTERPOLATION_TABLES = 4;
+
+  /*!
+    Interpolates output pixels [firstPoint, lastPoint] of the interpolation table with fixed-point weights.
+    T is unsigned char or unsigned short.
+  */
+  template <class T>
+  void InterpolateFixedPoint( const vtkPlusUsScanConvertCurvilinear::InterpolationTable& table, const T* inPtr, int numberOfSamples,
+                              int inputSize, T* outPtr, int firstPoint, int lastPoint )
+  {
+    const int* inputPixelIndices = table.InputPixelIndices.data();
+    const int* outputPixelIndices = table.OutputPixelIndices.data();
+    const unsigned short* w0 = table.FixedPointWeightCoefficients[0].data();
+    const unsigned short* w1 = table.FixedPointWeightCoefficients[1].data();
+    const unsigned short* w2 = table.FixedPointWeightCoefficients[2].data();
+    const unsigned short* w3 = table.FixedPointWeightCoefficients[3].data();
+    for ( int i = firstPoint; i <= lastPoint; ++i )
+    {
+      const T* p = inPtr + inputPixelIndices[i];
+      unsigned int value = w0[i] * static_cast<unsigned int>( p[0] )
+                           + w1[i] * static_cast<unsigned int>( p[1] )
+                           + w2[i] * static_cast<unsigned int>( p[numberOfSamples] )
+                           + w3[i] * static_cast<unsigned int>( p[numberOfSamples + 1] )
+                           + vtkPlusUsScanConvertCurvilinear::FIXED_POINT_WEIGHT_SCALE / 2; // for rounding
+      outPtr[outputPixelIndices[i]] = static_cast<T>( value >> 15 );
+    }
+  }
+
+  typedef void ( *InterpolateFixedPoint8Function )( const vtkPlusUsScanConvertCurvilinear::InterpolationTable& table, const unsigned char* inPtr,
+      int numberOfSamples, int inputSize, unsigned char* outPtr, int firstPoint, int lastPoint );
+  typedef void ( *InterpolateFixedPoint16Function )( const vtkPlusUsScanConvertCurvilinear::InterpolationTable& table, const unsigned short* inPtr,
+      int numberOfSamples, int inputSize, unsigned short* outPtr, int firstPoint, int lastPoint );
+
+#ifdef PLUS_SCAN_CONVERT_AVX2
+  //----------------------------------------------------------------------------
+  bool IsAvx2Supported()
+  {
+#if defined(_MSC_VER)
+    int cpuInfo[4] = { 0 };
+    __cpuid( cpuInfo, 0 );
+    if ( cpuInfo[0] < 7 )
+    {
+      return false;
+    }
+    __cpuid( cpuInfo, 1 );
+    const int OSXSAVE_BIT = 1 << 27;
+    const int AVX_BIT = 1 << 28;
+    if ( !( cpuInfo[2] & OSXSAVE_BIT ) || !( cpuInfo[2] & AVX_BIT ) )
+    {
+      return false;
+    }
+    // The operating system must save the YMM registers on context switch
+    const unsigned long long XMM_YMM_STATE = 0x6;
+    if ( ( _xgetbv( 0 ) & XMM_YMM_STATE ) != XMM_YMM_STATE )
+    {
+      return false;
+    }
+    __cpuidex( cpuInfo, 7, 0 );
+    const int AVX2_BIT = 1 << 5;
+    return ( cpuInfo[1] & AVX2_BIT ) != 0;
+#else
+    return __builtin_cpu_supports( "avx2" );
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  /*!
+    Same as InterpolateFixedPoint, but 8 points are interpolated at a time. The two horizontally neighboring input pixels
+    are loaded with one 32-bit gather, so for 8-bit images the gather reads 2 bytes past the last used pixel: blocks
+    that would read past the end of the input image are interpolated by the scalar loop.
+  */
+  template <class T>
+  PLUS_SCAN_CONVERT_AVX2_TARGET void InterpolateFixedPointAvx2( const vtkPlusUsScanConvertCurvilinear::InterpolationTable& table, const T* inPtr,
+      int numberOfSamples, int inputSize, T* outPtr, int firstPoint, int lastPoint )
+  {
+    const int BLOCK_SIZE = 8;
+    const int* inputPixelIndices = table.InputPixelIndices.data();
+    const int* outputPixelIndices = table.OutputPixelIndices.data();
+    const unsigned short* w0 = table.FixedPointWeightCoefficients[0].data();
+    const unsigned short* w1 = table.FixedPointWeightCoefficients[1].data();
+    const unsigned short* w2 = table.FixedPointWeightCoefficients[2].data();
+    const unsigned short* w3 = table.FixedPointWeightCoefficients[3].data();
+
+    const int* inPtrNextLine = reinterpret_cast<const int*>( inPtr + numberOfSamples );
+    const int* inPtrLine = reinterpret_cast<const int*>( inPtr );
+    const int PIXEL_BITS = 8 * sizeof( T );
+    const __m256i pixelMask = _mm256_set1_epi32( ( 1 << PIXEL_BITS ) - 1 );
+    const __m256i rounding = _mm256_set1_epi32( vtkPlusUsScanConvertCurvilinear::FIXED_POINT_WEIGHT_SCALE / 2 );
+    // A block can be gathered only if all the 4 bytes after each pixel of the next line are inside the input image
+    const __m256i maxGatheredInputPixelIndex = _mm256_set1_epi32( inputSize - numberOfSamples - 4 / static_cast<int>( sizeof( T ) ) );
+
+    int i = firstPoint;
+    for ( ; i + BLOCK_SIZE - 1 <= lastPoint; i += BLOCK_SIZE )
+    {
+      __m256i index = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( inputPixelIndices + i ) );
+      if ( sizeof( T ) == 1 && _mm256_movemask_epi8( _mm256_cmpgt_epi32( index, maxGatheredInputPixelIndex ) ) != 0 )
+      {
+        InterpolateFixedPoint( table, inPtr, numberOfSamples, inputSize, outPtr, i, i + BLOCK_SIZE - 1 );
+        continue;
+      }
+      __m256i line = _mm256_i32gather_epi32( inPtrLine, index, sizeof( T ) );
+      __m256i nextLine = _mm256_i32gather_epi32( inPtrNextLine, index, sizeof( T ) );
+
+      __m256i value = _mm256_add_epi32( rounding,
+                                        _mm256_mullo_epi32( _mm256_cvtepu16_epi32( _mm_loadu_si128( reinterpret_cast<const __m128i*>( w0 + i ) ) ),
+                                            _mm256_and_si256( line, pixelMask ) ) );
+      value = _mm256_add_epi32( value,
+                                _mm256_mullo_epi32( _mm256_cvtepu16_epi32( _mm_loadu_si128( reinterpret_cast<const __m128i*>( w1 + i ) ) ),
+                                    _mm256_and_si256( _mm256_srli_epi32( line, PIXEL_BITS ), pixelMask ) ) );
+      value = _mm256_add_epi32( value,
+                                _mm256_mullo_epi32( _mm256_cvtepu16_epi32( _mm_loadu_si128( reinterpret_cast<const __m128i*>( w2 + i ) ) ),
+                                    _mm256_and_si256( nextLine, pixelMask ) ) );
+      value = _mm256_add_epi32( value,
+                                _mm256_mullo_epi32( _mm256_cvtepu16_epi32( _mm_loadu_si128( reinterpret_cast<const __m128i*>( w3 + i ) ) ),
+                                    _mm256_and_si256( _mm256_srli_epi32( nextLine, PIXEL_BITS ), pixelMask ) ) );
+      value = _mm256_srli_epi32( value, 15 );
+
+      // Output pixels of a block are usually consecutive pixels of a row, which can be stored at once
+      const int* outputIndex = outputPixelIndices + i;
+      __m128i packedValue = _mm_packus_epi32( _mm256_castsi256_si128( value ), _mm256_extracti128_si256( value, 1 ) );
+      if ( outputIndex[BLOCK_SIZE - 1] - outputIndex[0] == BLOCK_SIZE - 1 )
+      {
+        if ( sizeof( T ) == 1 )
+        {
+          _mm_storel_epi64( reinterpret_cast<__m128i*>( outPtr + outputIndex[0] ), _mm_packus_epi16( packedValue, packedValue ) );
+        }
+        else
+        {
+          _mm_storeu_si128( reinterpret_cast<__m128i*>( outPtr + outputIndex[0] ), packedValue );
+        }
+        continue;
+      }
+      unsigned short values[BLOCK_SIZE];
+      _mm_storeu_si128( reinterpret_cast<__m128i*>( values ), packedValue );
+      for ( int k = 0; k < BLOCK_SIZE; ++k )
+      {
+        outPtr[outputIndex[k]] = static_cast<T>( values[k] );
+      }
+    }
+    if ( i <= lastPoint )
+    {
+      InterpolateFixedPoint( table, inPtr, numberOfSamples, inputSize, outPtr, i, lastPoint );
+    }
+  }
+#endif
+
+  //----------------------------------------------------------------------------
+  /*!
+    Fixed-point interpolation implementation that is used on this CPU.
+    There is no gather instruction in NEON, so on ARM the scalar loop is used (it is vectorized as far as the compiler can).
+  */
+  struct FixedPointImplementation
+  {
+    InterpolateFixedPoint8Function Function8;
+    InterpolateFixedPoint16Function Function16;
+    const char* Name;
+
+    FixedPointImplementation()
+      : Function8( &InterpolateFixedPoint<unsigned char> )
+      , Function16( &InterpolateFixedPoint<unsigned short> )
+      , Name( "scalar" )
+    {
+#ifdef PLUS_SCAN_CONVERT_AVX2
+      if ( IsAvx2Supported() )
+      {
+        this->Function8 = &InterpolateFixedPointAvx2<unsigned char>;
+        this->Function16 = &InterpolateFixedPointAvx2<unsigned short>;
+        this->Name = "AVX2";
+      }
+#endif
+    }
+  };
+
+  //----------------------------------------------------------------------------
+  const FixedPointImplementation& GetFixedPointImplementation()
+  {
+    static const FixedPointImplementation implementation;
+    return implementation;
+  }
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusUsScanConvertCurvilinear::InterpolationTableKey::operator==( const InterpolationTableKey& other ) const
+{
+  for ( int i = 0; i < 6; i++ )
+  {
+    if ( this->InputImageExtent[i] != other.InputImageExtent[i]
+         || this->OutputImageExtent[i] != other.OutputImageExtent[i] )
+    {
+      return false;
+    }
+  }
+  for ( int i = 0; i < 3; i++ )
+  {
+    if ( this->OutputImageSpacing[i] != other.OutputImageSpacing[i] )
+    {
+      return false;
+    }
+  }
+  return ( this->RadiusStartMm == other.RadiusStartMm )
+         && ( this->RadiusStopMm == other.RadiusStopMm )
+         && ( this->ThetaStartDeg == other.ThetaStartDeg )
+         && ( this->ThetaStopDeg == other.ThetaStopDeg )
+         && ( this->TransducerCenterPixel[0] == other.TransducerCenterPixel[0] )
+         && ( this->TransducerCenterPixel[1] == other.TransducerCenterPixel[1] )
+         && ( this->IntensityScaling == other.IntensityScaling );
+}
+
 //----------------------------------------------------------------------------
 vtkPlusUsScanConvertCurvilinear::vtkPlusUsScanConvertCurvilinear()
 {
@@ -43,30 +266,10 @@ vtkPlusUsScanConvertCurvilinear::vtkPlusUsScanConvertCurvilinear()
   this->ThetaStartDeg = -30.0;
   this->ThetaStopDeg = 30.0;
   this->OutputIntensityScaling = 1.0;
+  this->FixedPointInterpolation = false;
 
-  // Values that are used for computing the InterpolatedPointArray
-  this->InterpInputImageExtent[0] = 0;
-  this->InterpInputImageExtent[1] = -1;
-  this->InterpInputImageExtent[2] = 0;
-  this->InterpInputImageExtent[3] = -1;
-  this->InterpInputImageExtent[4] = 0;
-  this->InterpInputImageExtent[5] = -1;
-  this->InterpRadiusStartMm = 0.0;
-  this->InterpRadiusStopMm = 0.0;
-  this->InterpThetaStartDeg = 0.0;
-  this->InterpThetaStopDeg = 0.0;
-  this->InterpOutputImageExtent[0] = 0;
-  this->InterpOutputImageExtent[1] = -1;
-  this->InterpOutputImageExtent[2] = 0;
-  this->InterpOutputImageExtent[3] = -1;
-  this->InterpOutputImageExtent[4] = 0;
-  this->InterpOutputImageExtent[5] = -1;
-  this->InterpOutputImageSpacing[0] = 0.0;
-  this->InterpOutputImageSpacing[1] = 0.0;
-  this->InterpOutputImageSpacing[2] = 0.0;
-  this->InterpTransducerCenterPixel[0] = 0.0;
-  this->InterpTransducerCenterPixel[1] = 0.0;
-  this->InterpIntensityScaling = 0.0;
+  // Empty table until the scan conversion parameters are known
+  this->CurrentInterpolationTable = std::make_shared<InterpolationTable>();
 }
 
 //----------------------------------------------------------------------------
@@ -75,93 +278,99 @@ vtkPlusUsScanConvertCurvilinear::~vtkPlusUsScanConvertCurvilinear()
 }
 
 //----------------------------------------------------------------------------
-void vtkPlusUsScanConvertCurvilinear::ComputeInterpolatedPointArray(
+const char* vtkPlusUsScanConvertCurvilinear::GetFixedPointInterpolationImplementationName()
+{
+  return GetFixedPointImplementation().Name;
+}
+
+//----------------------------------------------------------------------------
+std::shared_ptr<const vtkPlusUsScanConvertCurvilinear::InterpolationTable> vtkPlusUsScanConvertCurvilinear::GetInterpolationTableForInputExtent( const int inputImageExtent[6] )
+{
+  int inExtent[6] = { inputImageExtent[0], inputImageExtent[1], inputImageExtent[2], inputImageExtent[3], inputImageExtent[4], inputImageExtent[5] };
+  UpdateInterpolationTable( inExtent, this->RadiusStartMm, this->RadiusStopMm, this->ThetaStartDeg, this->ThetaStopDeg,
+                            this->OutputImageExtent, this->OutputImageSpacing, this->TransducerCenterPixel, this->OutputIntensityScaling );
+  return this->CurrentInterpolationTable;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusUsScanConvertCurvilinear::UpdateInterpolationTable(
   int* inputImageExtent, double radiusStartMm, double radiusStopMm, double thetaStartDeg, double thetaStopDeg,
   int* outputImageExtent, double* outputImageSpacing, double* transducerCenterPixel, double intensityScaling )
 {
-  // Computing the point array is a costly operation, so perform it only if a scan conversion parameter has been changed
-
-  // Check if any scan conversion parameter has been changed
-  bool modifiedScanConversionParams = false;
+  InterpolationTableKey key;
   for ( int i = 0; i < 6; i++ )
   {
-    if ( this->InterpInputImageExtent[i] != inputImageExtent[i] )
-    {
-      modifiedScanConversionParams = true;
-    }
-    if ( this->OutputImageExtent[i] != outputImageExtent[i] )
-    {
-      modifiedScanConversionParams = true;
-    }
+    key.InputImageExtent[i] = inputImageExtent[i];
+    key.OutputImageExtent[i] = outputImageExtent[i];
   }
   for ( int i = 0; i < 3; i++ )
   {
-    if ( this->InterpOutputImageSpacing[i] != outputImageSpacing[i] )
-    {
-      modifiedScanConversionParams = true;
-    }
-  }
-  if ( ( this->InterpRadiusStartMm != radiusStartMm )
-       || ( this->InterpRadiusStopMm != radiusStopMm )
-       || ( this->InterpThetaStartDeg != thetaStartDeg )
-       || ( this->InterpThetaStopDeg != thetaStopDeg )
-       || ( this->InterpTransducerCenterPixel[0] != transducerCenterPixel[0] )
-       || ( this->InterpTransducerCenterPixel[1] != transducerCenterPixel[1] )
-       || ( this->InterpIntensityScaling != intensityScaling ) )
-  {
-    modifiedScanConversionParams = true;
+    key.OutputImageSpacing[i] = outputImageSpacing[i];
   }
-
-  if ( !modifiedScanConversionParams )
+  key.RadiusStartMm = radiusStartMm;
+  key.RadiusStopMm = radiusStopMm;
+  key.ThetaStartDeg = thetaStartDeg;
+  key.ThetaStopDeg = thetaStopDeg;
+  key.TransducerCenterPixel[0] = transducerCenterPixel[0];
+  key.TransducerCenterPixel[1] = transducerCenterPixel[1];
+  key.IntensityScaling = intensityScaling;
+
+  // Computing the table is a costly operation, so perform it only if it has not been computed recently for these parameters
+  for ( auto it = this->InterpolationTableCache.begin(); it != this->InterpolationTableCache.end(); ++it )
   {
-    // scan conversion parameters haven't been modified since the InterpolatedPointArray was last computed
-    // there is no need to recompute, just return
-    return;
+    if ( it->first == key )
+    {
+      this->CurrentInterpolationTable = it->second;
+      if ( it != this->InterpolationTableCache.begin() )
+      {
+        // Move to the front, as the most recently used
+        std::pair<InterpolationTableKey, std::shared_ptr<InterpolationTable> > entry = *it;
+        this->InterpolationTableCache.erase( it );
+        this->InterpolationTableCache.push_front( entry );
+      }
+      return;
+    }
   }
 
-  // remember the current scan conversion parameters that are used to compute the interpolated point array
-  for ( int i = 0; i < 6; i++ )
-  {
-    this->InterpInputImageExtent[i] = inputImageExtent[i];
-    this->OutputImageExtent[i] = outputImageExtent[i];
-  }
-  for ( int i = 0; i < 3; i++ )
+  std::shared_ptr<InterpolationTable> table = std::make_shared<InterpolationTable>();
+  ComputeInterpolationTable( key, *table );
+  this->InterpolationTableCache.push_front( std::make_pair( key, table ) );
+  if ( this->InterpolationTableCache.size() > MAX_NUMBER_OF_CACHED_INTERPOLATION_TABLES )
   {
-    this->InterpOutputImageSpacing[i] = outputImageSpacing[i];
+    this->InterpolationTableCache.pop_back();
   }
-  this->InterpRadiusStartMm = radiusStartMm;
-  this->InterpRadiusStopMm = radiusStopMm;
-  this->InterpThetaStartDeg = thetaStartDeg;
-  this->InterpThetaStopDeg = thetaStopDeg;
-  this->InterpTransducerCenterPixel[0] = transducerCenterPixel[0];
-  this->InterpTransducerCenterPixel[1] = transducerCenterPixel[1];
-  this->InterpIntensityScaling = intensityScaling;
-
-  // Compute the interpolated point array now
+  this->CurrentInterpolationTable = table;
+}
 
-  this->InterpolatedPointArray.clear();
+//----------------------------------------------------------------------------
+void vtkPlusUsScanConvertCurvilinear::ComputeInterpolationTable( const InterpolationTableKey& key, InterpolationTable& table )
+{
+  const int* inputImageExtent = key.InputImageExtent;
+  const int* outputImageExtent = key.OutputImageExtent;
+  double radiusStartMm = key.RadiusStartMm;
+  double intensityScaling = key.IntensityScaling;
 
   int numberOfSamples = inputImageExtent[1] - inputImageExtent[0] + 1;
   int numberOfLines = inputImageExtent[3] - inputImageExtent[2] + 1;
-  double radiusDeltaMm = ( radiusStopMm - radiusStartMm ) / numberOfSamples;
-  double thetaStartRad = vtkMath::RadiansFromDegrees( thetaStartDeg );
+  double radiusDeltaMm = ( key.RadiusStopMm - radiusStartMm ) / numberOfSamples;
+  double thetaStartRad = vtkMath::RadiansFromDegrees( key.ThetaStartDeg );
   double thetaDeltaRad = 0;
   if ( numberOfLines > 1 )
   {
-    thetaDeltaRad = vtkMath::RadiansFromDegrees( ( thetaStopDeg - thetaStartDeg ) / ( numberOfLines - 1 ) );
+    thetaDeltaRad = vtkMath::RadiansFromDegrees( ( key.ThetaStopDeg - key.ThetaStartDeg ) / ( numberOfLines - 1 ) );
   }
   int outputImageSizePixelsX = outputImageExtent[1] - outputImageExtent[0] + 1;
   int outputImageSizePixelsY = outputImageExtent[3] - outputImageExtent[2] + 1;
 
   // Increments in image coordinates in mm
-  double dx = outputImageSpacing[0];
-  double dz = outputImageSpacing[1];
+  double dx = key.OutputImageSpacing[0];
+  double dz = key.OutputImageSpacing[1];
 
   // Starting depth in image coordinates in mm
-  double z = radiusStartMm - this->InterpTransducerCenterPixel[1] * dz;
+  double z = radiusStartMm - key.TransducerCenterPixel[1] * dz;
   for ( int i = 0; i < outputImageSizePixelsY; i++ )
   {
-    double x = -( this->InterpTransducerCenterPixel[0] - 0.5 ) * dx; // image coordinate, in mm
+    double x = -( key.TransducerCenterPixel[0] - 0.5 ) * dx; // image coordinate, in mm
     double z2 = z * z;
 
     for ( int j = 0; j < outputImageSizePixelsX; j++ )
@@ -178,27 +387,49 @@ void vtkPlusUsScanConvertCurvilinear::ComputeInterpolatedPointArray(
            ( index_line >= 0 ) && ( index_line + 1 < numberOfLines ) )
       {
         // The sample is inside the input image, so it can be computed
-        InterpolatedPoint ip;
         double samp_val = samp - index_samp; // Sub-sample fraction for interpolation
         double line_val = line - index_line; // Sub-line fraction for interpolation
 
         //  Calculate the coefficients
-        ip.weightCoefficients[0] = ( 1 - samp_val ) * ( 1 - line_val ) * intensityScaling;
-        ip.weightCoefficients[1] =    samp_val * ( 1 - line_val ) * intensityScaling;
-        ip.weightCoefficients[2] = ( 1 - samp_val ) * line_val   * intensityScaling;
-        ip.weightCoefficients[3] =    samp_val * line_val   * intensityScaling;
-
-        ip.inputPixelIndex = index_samp + index_line * numberOfSamples;
-        ip.outputPixelIndex = j + outputImageSizePixelsX * i;
-
-        this->InterpolatedPointArray.push_back( ip );
+        double weights[4] =
+        {
+          ( 1 - samp_val ) * ( 1 - line_val ),
+          samp_val * ( 1 - line_val ),
+          ( 1 - samp_val ) * line_val,
+          samp_val * line_val
+        };
+        for ( int k = 0; k < 4; k++ )
+        {
+          table.WeightCoefficients[k].push_back( weights[k] * intensityScaling );
+        }
+
+        // Fixed-point weights are rounded so that their sum is exactly 1.0: the rounding error goes to the largest weight
+        unsigned int fixedPointWeights[4];
+        unsigned int fixedPointWeightSum = 0;
+        int largestWeightIndex = 0;
+        for ( int k = 0; k < 4; k++ )
+        {
+          fixedPointWeights[k] = static_cast<unsigned int>( weights[k] * FIXED_POINT_WEIGHT_SCALE + 0.5 );
+          fixedPointWeightSum += fixedPointWeights[k];
+          if ( weights[k] > weights[largestWeightIndex] )
+          {
+            largestWeightIndex = k;
+          }
+        }
+        fixedPointWeights[largestWeightIndex] += FIXED_POINT_WEIGHT_SCALE - fixedPointWeightSum;
+        for ( int k = 0; k < 4; k++ )
+        {
+          table.FixedPointWeightCoefficients[k].push_back( static_cast<unsigned short>( fixedPointWeights[k] ) );
+        }
+
+        table.InputPixelIndices.push_back( index_samp + index_line * numberOfSamples );
+        table.OutputPixelIndices.push_back( j + outputImageSizePixelsX * i );
       }
 
       x = x + dx;
     }
     z = z + dz;
   }
-
 }
 
 //----------------------------------------------------------------------------
@@ -221,9 +452,9 @@ int vtkPlusUsScanConvertCurvilinear::RequestInformation ( vtkInformation* vtkNot
   inInfo->Get( vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), inExtent );
   //inInfo->Set(vtkStreamingDemandDrivenPipeline::UPDATE_EXTENT(),inExtent, 6);
 
-  // Create the interpolation table. It is recomputed only if the scan conversion parameters change.
-  ComputeInterpolatedPointArray( inExtent, this->RadiusStartMm, this->RadiusStopMm, this->ThetaStartDeg, this->ThetaStopDeg,
-                                 this->OutputImageExtent, this->OutputImageSpacing, this->TransducerCenterPixel, this->OutputIntensityScaling );
+  // Select the interpolation table. It is recomputed only if the scan conversion parameters have not been used recently.
+  UpdateInterpolationTable( inExtent, this->RadiusStartMm, this->RadiusStopMm, this->ThetaStartDeg, this->ThetaStopDeg,
+                            this->OutputImageExtent, this->OutputImageSpacing, this->TransducerCenterPixel, this->OutputIntensityScaling );
 
   return 1;
 }
@@ -293,16 +524,21 @@ void vtkPlusUsScanConvertExecute( vtkPlusUsScanConvertCurvilinear* self,
 
   T* image = outPtr; // The resulting image
 
-  std::vector<vtkPlusUsScanConvertCurvilinear::InterpolatedPoint>::const_iterator firstPoint = self->GetInterpolatedPointArray().begin() + interpolationTableExt[0];
-  std::vector<vtkPlusUsScanConvertCurvilinear::InterpolatedPoint>::const_iterator afterLastPoint = self->GetInterpolatedPointArray().begin() + interpolationTableExt[1] + 1;
-  for ( std::vector<vtkPlusUsScanConvertCurvilinear::InterpolatedPoint>::const_iterator it = firstPoint; it != afterLastPoint; ++it )
+  const vtkPlusUsScanConvertCurvilinear::InterpolationTable& table = self->GetInterpolationTable();
+  const int* inputPixelIndices = table.InputPixelIndices.data();
+  const int* outputPixelIndices = table.OutputPixelIndices.data();
+  const double* w0 = table.WeightCoefficients[0].data();
+  const double* w1 = table.WeightCoefficients[1].data();
+  const double* w2 = table.WeightCoefficients[2].data();
+  const double* w3 = table.WeightCoefficients[3].data();
+  for ( int i = interpolationTableExt[0]; i <= interpolationTableExt[1]; ++i )
   {
-    T* env_pointer = ( T* ) & ( envelope_data[it->inputPixelIndex] ); // Pointer to the envelope data
-    image[it->outputPixelIndex] =
-      it->weightCoefficients[0] * env_pointer[0] // (+0, +0)
-      + it->weightCoefficients[1] * env_pointer[1] // (+1, +0)
-      + it->weightCoefficients[2] * env_pointer[numberOfSamples] // (+0, +1)
-      + it->weightCoefficients[3] * env_pointer[numberOfSamples + 1] // (+1, +1)
+    T* env_pointer = envelope_data + inputPixelIndices[i]; // Pointer to the envelope data
+    image[outputPixelIndices[i]] =
+      w0[i] * env_pointer[0] // (+0, +0)
+      + w1[i] * env_pointer[1] // (+1, +0)
+      + w2[i] * env_pointer[numberOfSamples] // (+0, +1)
+      + w3[i] * env_pointer[numberOfSamples + 1] // (+1, +1)
       + 0.5; // for rounding
   }
 }
@@ -316,6 +552,7 @@ void vtkPlusUsScanConvertCurvilinear::ThreadedRequestData(
   vtkImageData** outData,
   int outExt[6], int id )
 {
+  PLUS_PROFILE_SCOPE("vtkPlusUsScanConvertCurvilinear::ThreadedRequestData");
 
   void* inPtr = inData[0][0]->GetScalarPointer();
   void* outPtr = outData[0]->GetScalarPointer();
@@ -330,6 +567,26 @@ void vtkPlusUsScanConvertCurvilinear::ThreadedRequestData(
     return;
   }
 
+  // Fixed-point weights are only computed for unit intensity scaling
+  if ( this->FixedPointInterpolation && this->OutputIntensityScaling == 1.0
+       && ( inData[0][0]->GetScalarType() == VTK_UNSIGNED_CHAR || inData[0][0]->GetScalarType() == VTK_UNSIGNED_SHORT ) )
+  {
+    int* inExtent = inData[0][0]->GetExtent();
+    int numberOfSamples = inExtent[1] - inExtent[0] + 1;
+    int inputSize = numberOfSamples * ( inExtent[3] - inExtent[2] + 1 ) * ( inExtent[5] - inExtent[4] + 1 );
+    if ( inData[0][0]->GetScalarType() == VTK_UNSIGNED_CHAR )
+    {
+      GetFixedPointImplementation().Function8( *this->CurrentInterpolationTable, static_cast<unsigned char*>( inPtr ), numberOfSamples, inputSize,
+          static_cast<unsigned char*>( outPtr ), outExt[0], outExt[1] );
+    }
+    else
+    {
+      GetFixedPointImplementation().Function16( *this->CurrentInterpolationTable, static_cast<unsigned short*>( inPtr ), numberOfSamples, inputSize,
+          static_cast<unsigned short*>( outPtr ), outExt[0], outExt[1] );
+    }
+    return;
+  }
+
   switch ( inData[0][0]->GetScalarType() )
   {
     vtkTemplateMacro(
@@ -354,7 +611,10 @@ void vtkPlusUsScanConvertCurvilinear::PrintSelf( ostream& os, vtkIndent indent )
   os << indent << "ThetaStartDeg: " << this->ThetaStartDeg << "\n";
   os << indent << "ThetaStopDeg: " << this->ThetaStopDeg << "\n";
   os << indent << "OutputIntensityScaling: " << this->OutputIntensityScaling << "\n";
-  os << indent << "InterpolatedPointArraySize: " << this->InterpolatedPointArray.size() << "\n";
+  os << indent << "FixedPointInterpolation: " << ( this->FixedPointInterpolation ? "true" : "false" )
+     << " (" << GetFixedPointInterpolationImplementationName() << ")\n";
+  os << indent << "InterpolationTableSize: " << this->CurrentInterpolationTable->GetNumberOfPoints() << "\n";
+  os << indent << "NumberOfCachedInterpolationTables: " << this->InterpolationTableCache.size() << "\n";
 
 }
 
@@ -371,7 +631,7 @@ int vtkPlusUsScanConvertCurvilinear::SplitExtent( int splitExt[6], int startExt[
 
   // Starting extent
   int min = 0;
-  int max = this->InterpolatedPointArray.size() - 1;
+  int max = this->CurrentInterpolationTable->GetNumberOfPoints() - 1;
 
   splitExt[0] = min;
   splitExt[1] = max;
@@ -447,6 +707,8 @@ PlusStatus vtkPlusUsScanConvertCurvilinear::ReadConfiguration( vtkXMLDataElement
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL( double, ThetaStartDeg, scanConversionElement );
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL( double, ThetaStopDeg, scanConversionElement );
 
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL( FixedPointInterpolation, scanConversionElement );
+
   return PLUS_SUCCESS;
 }
 
@@ -465,6 +727,8 @@ PlusStatus vtkPlusUsScanConvertCurvilinear::WriteConfiguration( vtkXMLDataElemen
   scanConversionElement->SetDoubleAttribute( "ThetaStartDeg", this->ThetaStartDeg );
   scanConversionElement->SetDoubleAttribute( "ThetaStopDeg", this->ThetaStopDeg );
 
+  XML_WRITE_BOOL_ATTRIBUTE( FixedPointInterpolation, scanConversionElement );
+
   return PLUS_SUCCESS;
 }
 
@@ -493,7 +757,7 @@ PlusStatus vtkPlusUsScanConvertCurvilinear::GetScanLineEndPoints( int scanLineIn
   scanlineEndPoint_OutputImage[2] = 0;
   scanlineEndPoint_OutputImage[3] = 1;
 
-  return PLUS_FAIL;
+  return PLUS_SUCCESS;
 }
 
 //-----------------------------------------------------------------------------
@@ -10,9 +10,22 @@ See License.txt for details.
 #include "vtkPlusImageProcessingExport.h"
 #include "vtkPlusUsScanConvert.h"
 
+#include <deque>
+#include <memory>
+#include <vector>
+
 /*!
 \class vtkPlusUsScanConvertCurvilinear
 \brief This class performs scan conversion from scan lines for curvilinear probes
+
+Each output pixel inside the fan is interpolated from 4 neighboring input pixels, as defined by an interpolation table.
+Computing the table is costly, therefore the tables of the most recently used geometries (input and output extent,
+output spacing, radius and theta range, transducer center, intensity scaling) are kept, so switching between
+imaging presets (e.g., depth settings) does not recompute them.
+
+If FixedPointInterpolation is enabled then 8 and 16-bit images are interpolated with 16-bit fixed-point weights, 8 pixels
+at a time on CPUs with AVX2. The result may differ from the default floating-point interpolation by one intensity level
+for 8-bit images and by a few intensity levels for 16-bit images. Fixed-point interpolation is not used if OutputIntensityScaling is not 1.
 \ingroup PlusLibImageProcessingAlgo
 */
 class vtkPlusImageProcessingExport vtkPlusUsScanConvertCurvilinear : public vtkPlusUsScanConvert
@@ -36,22 +49,51 @@ public:
   /*! Get the scan converted image */
   virtual vtkImageData* GetOutput();
 
-  struct InterpolatedPoint
+  /*!
+    Defines the computation of each output pixel that is inside the fan from 4 input pixels.
+    Stored as a structure of arrays, so that multiple points can be loaded into SIMD registers at once.
+  */
+  struct InterpolationTable
   {
-    /*! Weighting coefficients that used to construct the output pixel from 4 input pixels */
-    double weightCoefficients[4];
     /*! Position of the first input pixel that is used to construct the output point (in the sample line matrix). The 3 others are one row/column away. */
-    int inputPixelIndex;
-    // Position of the output pixel (in the image matrix) */
-    int outputPixelIndex;
+    std::vector<int> InputPixelIndices;
+    /*! Position of the output pixel (in the image matrix) */
+    std::vector<int> OutputPixelIndices;
+    /*! Weighting coefficients that are used to construct the output pixel from the 4 input pixels, including intensity scaling */
+    std::vector<double> WeightCoefficients[4];
+    /*! Weighting coefficients without intensity scaling, in fixed point: the sum of the 4 weights is FIXED_POINT_WEIGHT_SCALE */
+    std::vector<unsigned short> FixedPointWeightCoefficients[4];
+
+    int GetNumberOfPoints() const
+    {
+      return static_cast<int>(this->InputPixelIndices.size());
+    }
   };
 
-  /*! Retrieve the InterpolatedPointArray (used internally by the thread function) */
-  const std::vector<InterpolatedPoint>& GetInterpolatedPointArray()
+  /*! Fixed-point weight that corresponds to 1.0 */
+  static const unsigned int FIXED_POINT_WEIGHT_SCALE = 1 << 15;
+
+  /*! Retrieve the current interpolation table (used internally by the thread function) */
+  const InterpolationTable& GetInterpolationTable()
   {
-    return this->InterpolatedPointArray;
+    return *this->CurrentInterpolationTable;
   };
 
+  /*!
+    Get the interpolation table of the current scan conversion parameters for the specified input image extent.
+    Used for scan conversion outside of the VTK pipeline. The returned table is never modified, so the same
+    table object is returned as long as the parameters are the same.
+  */
+  std::shared_ptr<const InterpolationTable> GetInterpolationTableForInputExtent(const int inputImageExtent[6]);
+
+  /*! Interpolate 8 and 16-bit images with fixed-point weights, which is faster, but the result may slightly differ */
+  vtkSetMacro(FixedPointInterpolation, bool);
+  vtkGetMacro(FixedPointInterpolation, bool);
+  vtkBooleanMacro(FixedPointInterpolation, bool);
+
+  /*! Name of the fixed-point interpolation implementation that is used on this CPU ("AVX2" or "scalar") */
+  static const char* GetFixedPointInterpolationImplementationName();
+
   /*! Initialize the parameters used in reconstruction. These are for the cases when video source can obtain them from the hardware */
   vtkSetMacro(RadiusStartMm, double);
   vtkGetMacro(RadiusStartMm, double);
@@ -61,6 +103,9 @@ public:
   vtkSetMacro(ThetaStopDeg, double);
   vtkSetMacro(OutputImageStartDepthMm, double);
 
+  /*! Get the factor that the interpolated intensity values are multiplied by */
+  vtkGetMacro(OutputIntensityScaling, double);
+
   /*!
     Get the start and end point of the selected scanline
     transducer surface, the end point is far from the transducer surface.
@@ -109,28 +154,43 @@ protected:
   /*! Intensity scaling factor from envelope to image */
   double OutputIntensityScaling;
 
-  /*! Each element of this array defines the computation of a pixel in the output (scan converted) image.  */
-  std::vector<InterpolatedPoint> InterpolatedPointArray;
+  /*! Interpolate 8 and 16-bit images with fixed-point weights */
+  bool FixedPointInterpolation;
+
+  /*! Scan conversion parameters that an interpolation table is computed from */
+  struct InterpolationTableKey
+  {
+    int InputImageExtent[6];
+    double RadiusStartMm;
+    double RadiusStopMm;
+    double ThetaStartDeg;
+    double ThetaStopDeg;
+    int OutputImageExtent[6];
+    double OutputImageSpacing[3];
+    double TransducerCenterPixel[2];
+    double IntensityScaling;
+
+    bool operator==(const InterpolationTableKey& other) const;
+  };
 
-  int InterpInputImageExtent[6];
-  double InterpRadiusStartMm;
-  double InterpRadiusStopMm;
-  double InterpThetaStartDeg;
-  double InterpThetaStopDeg;
-  int InterpOutputImageExtent[6];
-  double InterpOutputImageSpacing[3];
-  double InterpTransducerCenterPixel[2];
-  double InterpIntensityScaling;
+  /*! Interpolation tables of the most recently used scan conversion parameters, the most recent first */
+  std::deque<std::pair<InterpolationTableKey, std::shared_ptr<InterpolationTable> > > InterpolationTableCache;
+
+  /*! Interpolation table of the current scan conversion parameters, never NULL */
+  std::shared_ptr<InterpolationTable> CurrentInterpolationTable;
 
   /*!
-    Computes the InterpolatedPointArray from the method arguments. The array is not recomputed if
-    the input arguments are the same as last time.
+    Sets the interpolation table of the method arguments as the current table. The table is only computed
+    if it is not among the tables of the most recently used parameters.
   */
-  void ComputeInterpolatedPointArray(
+  void UpdateInterpolationTable(
     int* inputImageExtent, double radiusStartMm, double radiusStopMm, double thetaStartDeg, double thetaStopDeg,
     int* outputImageExtent, double* outputImageSpacing, double* transducerCenterPixel, double intensityScaling
   );
 
+  /*! Computes the interpolation table of the scan conversion parameters */
+  static void ComputeInterpolationTable(const InterpolationTableKey& key, InterpolationTable& table);
+
 private:
   vtkPlusUsScanConvertCurvilinear(const vtkPlusUsScanConvertCurvilinear&);  // Not implemented.
   void operator=(const vtkPlusUsScanConvertCurvilinear&);  // Not implemented.
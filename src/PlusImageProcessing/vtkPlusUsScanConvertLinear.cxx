@@ -5,8 +5,10 @@ See License.txt for details.
 =========================================================Plus=header=end*/ 
 
 #include "PlusConfigure.h"
+#include "PlusProfiler.h"
 
 #include "vtkPlusUsScanConvertLinear.h"
+#include "PlusValidPixelMask.h"
 
 #include "vtkObjectFactory.h"
 #include "vtkXMLDataElement.h"
@@ -54,6 +56,7 @@ void vtkPlusUsScanConvertLinear::SetInputData(vtkDataObject *input)
 //-----------------------------------------------------------------------------
 void vtkPlusUsScanConvertLinear::Update()
 {
+  PLUS_PROFILE_SCOPE("vtkPlusUsScanConvertLinear::Update");
   this->ImageReslice->SetOutputExtent(this->OutputImageExtent);
   // In Plus the convention is that the image coordinate system has always unit spacing and zero origin
   this->ImageReslice->SetOutputSpacing(1.0, 1.0, 1.0);
@@ -69,20 +72,35 @@ void vtkPlusUsScanConvertLinear::Update()
   }
 
   inputImage->GetExtent(this->InputImageExtent);  
-  int scanLineLengthPixels=this->InputImageExtent[1]-this->InputImageExtent[0]+1;
-  int numberOfScanLines=this->InputImageExtent[3]-this->InputImageExtent[2]+1;
+
+  double outputOrigin[2]={0};
+  double inputPixelsPerOutputPixel[2]={0};
+  GetOutputToInputMapping(this->InputImageExtent, outputOrigin, inputPixelsPerOutputPixel);
 
   // xVec: controls the width of the output image, if larger then image becomes narrower
-  double inputWidthSpacing=this->TransducerWidthMm/static_cast<double>(numberOfScanLines);
-  double xVec[3]={0, (this->OutputImageSpacing[0]/inputWidthSpacing), 0};
-  
+  double xVec[3]={0, inputPixelsPerOutputPixel[0], 0};
   // yVec: controls the height of the output image, if larger then image becomes shorter
-  double inputDepthSpacing=this->ImagingDepthMm/static_cast<double>(scanLineLengthPixels);
-  double yVec[3]={this->OutputImageSpacing[1]/inputDepthSpacing, 0, 0};
-
+  double yVec[3]={inputPixelsPerOutputPixel[1], 0, 0};
   double zVec[3]={0,0,1.0};
   this->ImageReslice->SetResliceAxesDirectionCosines(xVec, yVec, zVec);
 
+  this->ImageReslice->SetOutputOrigin(outputOrigin[0],outputOrigin[1],0);
+
+  this->ImageReslice->Update();
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusUsScanConvertLinear::GetOutputToInputMapping(const int inputImageExtent[6], double outputOrigin[2], double inputPixelsPerOutputPixel[2])
+{
+  int scanLineLengthPixels=inputImageExtent[1]-inputImageExtent[0]+1;
+  int numberOfScanLines=inputImageExtent[3]-inputImageExtent[2]+1;
+
+  double inputWidthSpacing=this->TransducerWidthMm/static_cast<double>(numberOfScanLines);
+  inputPixelsPerOutputPixel[0]=this->OutputImageSpacing[0]/inputWidthSpacing;
+  
+  double inputDepthSpacing=this->ImagingDepthMm/static_cast<double>(scanLineLengthPixels);
+  inputPixelsPerOutputPixel[1]=this->OutputImageSpacing[1]/inputDepthSpacing;
+
   // Default transducer center is horizontally centered, with 0 offset along y axis
   double halfImageWidthPixel=numberOfScanLines/2*inputWidthSpacing/this->OutputImageSpacing[0];
   double transducerCenterPixel[2] = { halfImageWidthPixel, 0};
@@ -92,9 +110,8 @@ void vtkPlusUsScanConvertLinear::Update()
     transducerCenterPixel[1]=this->TransducerCenterPixel[1];
   }
 
-  this->ImageReslice->SetOutputOrigin(-this->TransducerCenterPixel[0]+halfImageWidthPixel,-this->TransducerCenterPixel[1],0);
-
-  this->ImageReslice->Update();
+  outputOrigin[0]=-this->TransducerCenterPixel[0]+halfImageWidthPixel;
+  outputOrigin[1]=-this->TransducerCenterPixel[1];
 }
 
 //-----------------------------------------------------------------------------
@@ -175,6 +192,41 @@ PlusStatus vtkPlusUsScanConvertLinear::GetScanLineEndPoints(int scanLineIndex, d
   return PLUS_SUCCESS;
 }
 
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusUsScanConvertLinear::ComputeOutputImageValidPixelMask(PlusValidPixelMask& mask, int marginPixels /*=1*/)
+{
+  mask.Clear();
+
+  int numberOfScanLines = this->InputImageExtent[3] - this->InputImageExtent[2] + 1;
+  double firstScanlineStartPoint_OutputImage[4] = {0, 0, 0, 1};
+  double firstScanlineEndPoint_OutputImage[4] = {0, 0, 0, 1};
+  double lastScanlineStartPoint_OutputImage[4] = {0, 0, 0, 1};
+  double lastScanlineEndPoint_OutputImage[4] = {0, 0, 0, 1};
+  if (this->GetScanLineEndPoints(0, firstScanlineStartPoint_OutputImage, firstScanlineEndPoint_OutputImage) != PLUS_SUCCESS
+      || this->GetScanLineEndPoints(numberOfScanLines - 1, lastScanlineStartPoint_OutputImage, lastScanlineEndPoint_OutputImage) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("ComputeOutputImageValidPixelMask failed: cannot get scanline end points");
+    return PLUS_FAIL;
+  }
+
+  // The image is a rectangle, the last scanline covers one scanline spacing beyond its start point
+  double scanlineSpacingXPixel = this->TransducerWidthMm / this->OutputImageSpacing[0] / double(numberOfScanLines);
+  int origin[2] =
+  {
+    static_cast<int>(floor(firstScanlineStartPoint_OutputImage[0])) - marginPixels,
+    static_cast<int>(floor(firstScanlineStartPoint_OutputImage[1])) - marginPixels
+  };
+  int size[2] =
+  {
+    static_cast<int>(ceil(lastScanlineStartPoint_OutputImage[0] + scanlineSpacingXPixel)) + marginPixels - origin[0],
+    static_cast<int>(ceil(lastScanlineEndPoint_OutputImage[1])) + marginPixels - origin[1]
+  };
+
+  FrameSizeType outputImageSizePixel = this->GetOutputImageSizePixel();
+  mask.SetToRectangle(outputImageSizePixel[0], outputImageSizePixel[1], origin, size);
+  return PLUS_SUCCESS;
+}
+
 //-----------------------------------------------------------------------------
 double vtkPlusUsScanConvertLinear::GetDistanceBetweenScanlineSamplePointsMm()
 {
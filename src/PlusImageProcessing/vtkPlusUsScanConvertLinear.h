@@ -63,6 +63,16 @@ public:
   /*! Get the distance between two sample points in the scanline, in mm */
   virtual double GetDistanceBetweenScanlineSamplePointsMm();
 
+  /*! Compute the mask of the output image pixels that are covered by the scanlines. Each scanline covers a stripe of the scanline spacing width. */
+  virtual PlusStatus ComputeOutputImageValidPixelMask(PlusValidPixelMask& mask, int marginPixels = 1);
+
+  /*!
+    Get the mapping from output image pixels to input image pixels that is used for the resampling.
+    Output pixel (x, y) is computed from input line (outputOrigin[0]+x)*inputPixelsPerOutputPixel[0]
+    and sample (outputOrigin[1]+y)*inputPixelsPerOutputPixel[1] (nearest neighbor interpolation).
+  */
+  void GetOutputToInputMapping(const int inputImageExtent[6], double outputOrigin[2], double inputPixelsPerOutputPixel[2]);
+
 protected:
   vtkPlusUsScanConvertLinear();
   virtual ~vtkPlusUsScanConvertLinear();
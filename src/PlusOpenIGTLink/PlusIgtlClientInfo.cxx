@@ -7,15 +7,34 @@ See License.txt for details.
 // Local includes
 #include "PlusIgtlClientInfo.h"
 
+// IGSIO includes
+#include <igsioTrackedFrame.h>
+
 // IGTL includes
 #include <igtl_header.h>
 
+// Definition of the constant, it is bound to references (std::min, vtkSetClampMacro)
+const int PlusIgtlClientInfo::MAX_ADAPTIVE_QUALITY_LEVEL;
+
 //----------------------------------------------------------------------------
 PlusIgtlClientInfo::PlusIgtlClientInfo()
   : ClientHeaderVersion(IGTL_HEADER_VERSION_1)
   , TDATAResolution(0)
   , TDATARequested(false)
   , LastTDATASentTimeStamp(-1)
+  , NumberOfSentFrames(0)
+  , NumberOfDroppedFrames(0)
+  , AdaptiveQualityLevel(0)
+  , NumberOfSkippedImageFrames(0)
+  , NextImageFrameTimeStamp(-1)
+  , CoalesceTransforms(false)
+  , CoalescedTransformsMaxRate(0)
+  , NextCoalescedTransformsTimeStamp(-1)
+  , SendStringFieldsOnChangeOnly(false)
+  , StringFieldsMaxRate(0)
+  , NextStringFieldsTimeStamp(-1)
+  , SendUsImagingParameters(false)
+  , LastSentUsImagingParametersVersion(0)
 {
 
 }
@@ -52,6 +71,7 @@ PlusStatus PlusIgtlClientInfo::SetClientInfoFromXmlData(vtkXMLDataElement* xmlda
   PlusIgtlClientInfo clientInfo;
 
   XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, ClientHeaderVersion, clientInfo.ClientHeaderVersion, xmldata);
+  XML_READ_STRING_ATTRIBUTE_NONMEMBER_OPTIONAL(OutputChannelId, clientInfo.OutputChannelId, xmldata);
   XML_READ_BOOL_ATTRIBUTE_NONMEMBER_OPTIONAL(TDATARequested, clientInfo.TDATARequested, xmldata);
   XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, TDATAResolution, clientInfo.TDATAResolution, xmldata);
   if (xmldata->GetAttribute("Resolution") != NULL)
@@ -202,10 +222,58 @@ PlusStatus PlusIgtlClientInfo::SetClientInfoFromXmlData(vtkXMLDataElement* xmlda
     }
   }
 
+  // Get streaming options
+  vtkXMLDataElement* streamingOptions = xmldata->FindNestedElementWithName("StreamingOptions");
+  if (streamingOptions != NULL)
+  {
+    StreamingOptions& options = clientInfo.ImageStreamingOptions;
+    XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(double, MaxFrameRate, options.MaxFrameRate, streamingOptions);
+    XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, FrameDecimation, options.FrameDecimation, streamingOptions);
+    XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, ImageDownscaleFactor, options.ImageDownscaleFactor, streamingOptions);
+    XML_READ_BOOL_ATTRIBUTE_NONMEMBER_OPTIONAL(Adaptive, options.Adaptive, streamingOptions);
+    streamingOptions->GetVectorAttribute("ClipRectangleOrigin", 2, options.ClipRectangleOrigin);
+    streamingOptions->GetVectorAttribute("ClipRectangleSize", 2, options.ClipRectangleSize);
+    if (options.MaxFrameRate < 0)
+    {
+      LOG_WARNING("StreamingOptions MaxFrameRate must not be negative. The frame rate will not be limited.");
+      options.MaxFrameRate = 0;
+    }
+    if (options.FrameDecimation < 1)
+    {
+      LOG_WARNING("StreamingOptions FrameDecimation must be at least 1. All frames will be sent.");
+      options.FrameDecimation = 1;
+    }
+    if (options.ImageDownscaleFactor < 1)
+    {
+      LOG_WARNING("StreamingOptions ImageDownscaleFactor must be at least 1. Images will not be downscaled.");
+      options.ImageDownscaleFactor = 1;
+    }
+  }
+
+  // Get transform coalescing options
+  vtkXMLDataElement* coalescedTransforms = xmldata->FindNestedElementWithName("CoalescedTransforms");
+  if (coalescedTransforms != NULL)
+  {
+    clientInfo.CoalesceTransforms = true;
+    XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(double, MaxRate, clientInfo.CoalescedTransformsMaxRate, coalescedTransforms);
+    if (clientInfo.CoalescedTransformsMaxRate < 0)
+    {
+      LOG_WARNING("CoalescedTransforms MaxRate must not be negative. The rate will not be limited.");
+      clientInfo.CoalescedTransformsMaxRate = 0;
+    }
+  }
+
   // Get string names
   vtkXMLDataElement* stringNames = xmldata->FindNestedElementWithName("StringNames");
   if (stringNames != NULL)
   {
+    XML_READ_BOOL_ATTRIBUTE_NONMEMBER_OPTIONAL(OnChangeOnly, clientInfo.SendStringFieldsOnChangeOnly, stringNames);
+    XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(double, MaxRate, clientInfo.StringFieldsMaxRate, stringNames);
+    if (clientInfo.StringFieldsMaxRate < 0)
+    {
+      LOG_WARNING("StringNames MaxRate must not be negative. The rate will not be limited.");
+      clientInfo.StringFieldsMaxRate = 0;
+    }
     for (int i = 0; i < stringNames->GetNumberOfNestedElements(); ++i)
     {
       const char* string = stringNames->GetNestedElement(i)->GetName();
@@ -226,6 +294,14 @@ PlusStatus PlusIgtlClientInfo::SetClientInfoFromXmlData(vtkXMLDataElement* xmlda
     }
   }
 
+  // Get imaging parameter updates
+  vtkXMLDataElement* usImagingParameters = xmldata->FindNestedElementWithName("UsImagingParameters");
+  if (usImagingParameters != NULL)
+  {
+    clientInfo.SendUsImagingParameters = true;
+    XML_READ_STRING_ATTRIBUTE_NONMEMBER_OPTIONAL(UsDeviceId, clientInfo.UsImagingParametersDeviceId, usImagingParameters);
+  }
+
   // Copy over the new client info
   (*this) = clientInfo;
 
@@ -239,6 +315,10 @@ void PlusIgtlClientInfo::GetClientInfoInXmlData(std::string& strXmlData)
   xmldata->SetName("ClientInfo");
   xmldata->SetAttribute("TDATARequested", (this->GetTDATARequested() ? "TRUE" : "FALSE"));
   xmldata->SetIntAttribute("TDATAResolution", this->GetTDATAResolution());
+  if (!this->OutputChannelId.empty())
+  {
+    xmldata->SetAttribute("OutputChannelId", this->OutputChannelId.c_str());
+  }
 
   vtkSmartPointer<vtkXMLDataElement> messageTypes = vtkSmartPointer<vtkXMLDataElement>::New();
   messageTypes->SetName("MessageTypes");
@@ -273,6 +353,11 @@ void PlusIgtlClientInfo::GetClientInfoInXmlData(std::string& strXmlData)
 
   vtkSmartPointer<vtkXMLDataElement> stringNames = vtkSmartPointer<vtkXMLDataElement>::New();
   stringNames->SetName("StringNames");
+  if (this->SendStringFieldsOnChangeOnly)
+  {
+    stringNames->SetAttribute("OnChangeOnly", "TRUE");
+    stringNames->SetDoubleAttribute("MaxRate", this->StringFieldsMaxRate);
+  }
   for (unsigned int i = 0; i < StringNames.size(); ++i)
   {
     if (StringNames[i].empty())
@@ -299,6 +384,41 @@ void PlusIgtlClientInfo::GetClientInfoInXmlData(std::string& strXmlData)
   }
   xmldata->AddNestedElement(imageNames);
 
+  if (!(this->ImageStreamingOptions == StreamingOptions()))
+  {
+    vtkSmartPointer<vtkXMLDataElement> streamingOptions = vtkSmartPointer<vtkXMLDataElement>::New();
+    streamingOptions->SetName("StreamingOptions");
+    streamingOptions->SetDoubleAttribute("MaxFrameRate", this->ImageStreamingOptions.MaxFrameRate);
+    streamingOptions->SetIntAttribute("FrameDecimation", this->ImageStreamingOptions.FrameDecimation);
+    streamingOptions->SetIntAttribute("ImageDownscaleFactor", this->ImageStreamingOptions.ImageDownscaleFactor);
+    if (this->ImageStreamingOptions.IsClipRectangleDefined())
+    {
+      streamingOptions->SetVectorAttribute("ClipRectangleOrigin", 2, this->ImageStreamingOptions.ClipRectangleOrigin);
+      streamingOptions->SetVectorAttribute("ClipRectangleSize", 2, this->ImageStreamingOptions.ClipRectangleSize);
+    }
+    streamingOptions->SetAttribute("Adaptive", (this->ImageStreamingOptions.Adaptive ? "TRUE" : "FALSE"));
+    xmldata->AddNestedElement(streamingOptions);
+  }
+
+  if (this->CoalesceTransforms)
+  {
+    vtkSmartPointer<vtkXMLDataElement> coalescedTransforms = vtkSmartPointer<vtkXMLDataElement>::New();
+    coalescedTransforms->SetName("CoalescedTransforms");
+    coalescedTransforms->SetDoubleAttribute("MaxRate", this->CoalescedTransformsMaxRate);
+    xmldata->AddNestedElement(coalescedTransforms);
+  }
+
+  if (this->SendUsImagingParameters)
+  {
+    vtkSmartPointer<vtkXMLDataElement> usImagingParameters = vtkSmartPointer<vtkXMLDataElement>::New();
+    usImagingParameters->SetName("UsImagingParameters");
+    if (!this->UsImagingParametersDeviceId.empty())
+    {
+      usImagingParameters->SetAttribute("UsDeviceId", this->UsImagingParametersDeviceId.c_str());
+    }
+    xmldata->AddNestedElement(usImagingParameters);
+  }
+
   std::ostringstream os;
   igsioCommon::XML::PrintXML(os, vtkIndent(0), xmldata);
   strXmlData = os.str();
@@ -328,7 +448,26 @@ void PlusIgtlClientInfo::PrintSelf(ostream& os, vtkIndent indent)
 
   os << indent << "TDATARequested: " << (this->GetTDATARequested() ? "TRUE" : "FALSE") << ". ";
   os << indent << "LastTDATASentTimeStamp: " << this->GetLastTDATASentTimeStamp() << ". ";
+  os << indent << "Sent frames: " << this->NumberOfSentFrames << ", dropped frames: " << this->NumberOfDroppedFrames << ". ";
   os << indent << "TDATAResolution: " << this->GetTDATAResolution() << ". ";
+  os << indent << "Image frame decimation: " << this->GetEffectiveFrameDecimation() << ", downscale factor: " << this->GetEffectiveImageDownscaleFactor()
+     << ", adaptive quality level: " << this->AdaptiveQualityLevel << ". ";
+  if (this->CoalesceTransforms)
+  {
+    os << indent << "Coalesced transforms max rate: " << this->CoalescedTransformsMaxRate << ". ";
+  }
+  if (this->SendStringFieldsOnChangeOnly)
+  {
+    os << indent << "String fields sent on change only, max rate: " << this->StringFieldsMaxRate << ". ";
+  }
+  if (this->SendUsImagingParameters)
+  {
+    os << indent << "Imaging parameter updates of device: " << (this->UsImagingParametersDeviceId.empty() ? "(first ultrasound device)" : this->UsImagingParametersDeviceId) << ". ";
+  }
+  if (!this->OutputChannelId.empty())
+  {
+    os << indent << "Output channel: " << this->OutputChannelId << ". ";
+  }
 
   os << ". Transforms: ";
   if (!this->TransformNames.empty())
@@ -386,6 +525,70 @@ void PlusIgtlClientInfo::PrintSelf(ostream& os, vtkIndent indent)
   }
 }
 
+//----------------------------------------------------------------------------
+bool PlusIgtlClientInfo::IsSubscriptionEquivalent(const PlusIgtlClientInfo& other) const
+{
+  if (!this->VideoStreams.empty() || !other.VideoStreams.empty())
+  {
+    return false;
+  }
+  if (this->ClientHeaderVersion != other.ClientHeaderVersion
+      || this->IgtlMessageTypes != other.IgtlMessageTypes
+      || this->StringNames != other.StringNames
+      || this->TransformNames.size() != other.TransformNames.size()
+      || this->ImageStreams.size() != other.ImageStreams.size())
+  {
+    return false;
+  }
+  // TDATA is sent depending on the time when it was last sent to the client
+  if (this->TDATARequested != other.TDATARequested
+      || (this->TDATARequested && (this->TDATAResolution != other.TDATAResolution || this->LastTDATASentTimeStamp != other.LastTDATASentTimeStamp)))
+  {
+    return false;
+  }
+  // Coalesced TDATA is sent depending on the time when it was last sent to the client
+  if (this->CoalesceTransforms != other.CoalesceTransforms
+      || (this->CoalesceTransforms && (this->CoalescedTransformsMaxRate != other.CoalescedTransformsMaxRate
+                                       || this->NextCoalescedTransformsTimeStamp != other.NextCoalescedTransformsTimeStamp)))
+  {
+    return false;
+  }
+  // Changed string fields are sent depending on the values and the time when they were last sent to the client
+  if (this->SendStringFieldsOnChangeOnly != other.SendStringFieldsOnChangeOnly
+      || (this->SendStringFieldsOnChangeOnly && !this->StringNames.empty()
+          && (this->StringFieldsMaxRate != other.StringFieldsMaxRate
+              || this->NextStringFieldsTimeStamp != other.NextStringFieldsTimeStamp
+              || this->LastSentStringFieldValues != other.LastSentStringFieldValues)))
+  {
+    return false;
+  }
+  for (unsigned int i = 0; i < this->TransformNames.size(); ++i)
+  {
+    if (this->TransformNames[i].GetTransformName() != other.TransformNames[i].GetTransformName())
+    {
+      return false;
+    }
+  }
+  // Image frames are sent depending on the streaming state of the client
+  if (!this->ImageStreams.empty()
+      && (!(this->ImageStreamingOptions == other.ImageStreamingOptions)
+          || this->AdaptiveQualityLevel != other.AdaptiveQualityLevel
+          || this->NumberOfSkippedImageFrames != other.NumberOfSkippedImageFrames
+          || this->NextImageFrameTimeStamp != other.NextImageFrameTimeStamp))
+  {
+    return false;
+  }
+  for (unsigned int i = 0; i < this->ImageStreams.size(); ++i)
+  {
+    if (this->ImageStreams[i].Name != other.ImageStreams[i].Name
+        || this->ImageStreams[i].EmbeddedTransformToFrame != other.ImageStreams[i].EmbeddedTransformToFrame)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
 //----------------------------------------------------------------------------
 int PlusIgtlClientInfo::GetClientHeaderVersion() const
 {
@@ -398,6 +601,18 @@ void PlusIgtlClientInfo::SetClientHeaderVersion(int version)
   this->ClientHeaderVersion = version;
 }
 
+//----------------------------------------------------------------------------
+std::string PlusIgtlClientInfo::GetOutputChannelId() const
+{
+  return this->OutputChannelId;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::SetOutputChannelId(const std::string& channelId)
+{
+  this->OutputChannelId = channelId;
+}
+
 //----------------------------------------------------------------------------
 int PlusIgtlClientInfo::GetTDATAResolution() const
 {
@@ -433,3 +648,267 @@ void PlusIgtlClientInfo::SetLastTDATASentTimeStamp(double val)
 {
   this->LastTDATASentTimeStamp = val;
 }
+
+//----------------------------------------------------------------------------
+unsigned long PlusIgtlClientInfo::GetNumberOfSentFrames() const
+{
+  return this->NumberOfSentFrames;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::SetNumberOfSentFrames(unsigned long val)
+{
+  this->NumberOfSentFrames = val;
+}
+
+//----------------------------------------------------------------------------
+unsigned long PlusIgtlClientInfo::GetNumberOfDroppedFrames() const
+{
+  return this->NumberOfDroppedFrames;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::SetNumberOfDroppedFrames(unsigned long val)
+{
+  this->NumberOfDroppedFrames = val;
+}
+
+//----------------------------------------------------------------------------
+int PlusIgtlClientInfo::GetAdaptiveQualityLevel() const
+{
+  return this->AdaptiveQualityLevel;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::SetAdaptiveQualityLevel(int level)
+{
+  this->AdaptiveQualityLevel = std::min(std::max(level, 0), MAX_ADAPTIVE_QUALITY_LEVEL);
+}
+
+//----------------------------------------------------------------------------
+int PlusIgtlClientInfo::GetEffectiveFrameDecimation() const
+{
+  // Odd levels halve the frame rate, even levels halve the image size
+  return this->ImageStreamingOptions.FrameDecimation << ((this->AdaptiveQualityLevel + 1) / 2);
+}
+
+//----------------------------------------------------------------------------
+int PlusIgtlClientInfo::GetEffectiveImageDownscaleFactor() const
+{
+  return this->ImageStreamingOptions.ImageDownscaleFactor << (this->AdaptiveQualityLevel / 2);
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlClientInfo::IsImageFrameDue(double timestamp) const
+{
+  if (this->ImageStreamingOptions.MaxFrameRate > 0 && this->NextImageFrameTimeStamp >= 0 && timestamp < this->NextImageFrameTimeStamp)
+  {
+    return false;
+  }
+  return this->NumberOfSkippedImageFrames + 1 >= this->GetEffectiveFrameDecimation();
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::UpdateImageFrameState(double timestamp)
+{
+  if (!this->IsImageFrameDue(timestamp))
+  {
+    this->NumberOfSkippedImageFrames++;
+    return;
+  }
+  this->NumberOfSkippedImageFrames = 0;
+  if (this->ImageStreamingOptions.MaxFrameRate > 0)
+  {
+    // Keep the average rate, unless the frames are late by more than a period
+    double frameIntervalSec = 1.0 / this->ImageStreamingOptions.MaxFrameRate;
+    if (this->NextImageFrameTimeStamp < 0 || timestamp - this->NextImageFrameTimeStamp > frameIntervalSec)
+    {
+      this->NextImageFrameTimeStamp = timestamp + frameIntervalSec;
+    }
+    else
+    {
+      this->NextImageFrameTimeStamp += frameIntervalSec;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlClientInfo::GetCoalesceTransforms() const
+{
+  return this->CoalesceTransforms;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::SetCoalesceTransforms(bool enable)
+{
+  this->CoalesceTransforms = enable;
+}
+
+//----------------------------------------------------------------------------
+double PlusIgtlClientInfo::GetCoalescedTransformsMaxRate() const
+{
+  return this->CoalescedTransformsMaxRate;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::SetCoalescedTransformsMaxRate(double rate)
+{
+  this->CoalescedTransformsMaxRate = std::max(rate, 0.0);
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlClientInfo::IsCoalescedTransformsDue(double timestamp) const
+{
+  if (!this->CoalesceTransforms)
+  {
+    return false;
+  }
+  return this->CoalescedTransformsMaxRate <= 0 || this->NextCoalescedTransformsTimeStamp < 0 || timestamp >= this->NextCoalescedTransformsTimeStamp;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::UpdateCoalescedTransformsState(double timestamp)
+{
+  if (!this->IsCoalescedTransformsDue(timestamp) || this->CoalescedTransformsMaxRate <= 0)
+  {
+    return;
+  }
+  // Keep the average rate, unless the frames are late by more than a period
+  double intervalSec = 1.0 / this->CoalescedTransformsMaxRate;
+  if (this->NextCoalescedTransformsTimeStamp < 0 || timestamp - this->NextCoalescedTransformsTimeStamp > intervalSec)
+  {
+    this->NextCoalescedTransformsTimeStamp = timestamp + intervalSec;
+  }
+  else
+  {
+    this->NextCoalescedTransformsTimeStamp += intervalSec;
+  }
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlClientInfo::GetSendStringFieldsOnChangeOnly() const
+{
+  return this->SendStringFieldsOnChangeOnly;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::SetSendStringFieldsOnChangeOnly(bool enable)
+{
+  this->SendStringFieldsOnChangeOnly = enable;
+  this->LastSentStringFieldValues.clear();
+  this->NextStringFieldsTimeStamp = -1;
+}
+
+//----------------------------------------------------------------------------
+double PlusIgtlClientInfo::GetStringFieldsMaxRate() const
+{
+  return this->StringFieldsMaxRate;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::SetStringFieldsMaxRate(double rate)
+{
+  this->StringFieldsMaxRate = std::max(rate, 0.0);
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlClientInfo::IsStringFieldDue(const std::string& fieldName, const std::string& fieldValue, double timestamp) const
+{
+  if (!this->SendStringFieldsOnChangeOnly)
+  {
+    return true;
+  }
+  std::map<std::string, std::string>::const_iterator lastSentIt = this->LastSentStringFieldValues.find(fieldName);
+  if (lastSentIt != this->LastSentStringFieldValues.end() && lastSentIt->second == fieldValue)
+  {
+    return false;
+  }
+  return this->StringFieldsMaxRate <= 0 || this->NextStringFieldsTimeStamp < 0 || timestamp >= this->NextStringFieldsTimeStamp;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::UpdateStringFieldsState(igsioTrackedFrame& trackedFrame)
+{
+  if (!this->SendStringFieldsOnChangeOnly)
+  {
+    return;
+  }
+  const double timestamp = trackedFrame.GetTimestamp();
+  bool fieldSent = false;
+  for (std::vector<std::string>::const_iterator stringNameIt = this->StringNames.begin(); stringNameIt != this->StringNames.end(); ++stringNameIt)
+  {
+    // Same condition as when the messages are packed: empty values are not sent
+    std::string fieldValue = trackedFrame.GetFrameField(*stringNameIt);
+    if (fieldValue.empty() || !this->IsStringFieldDue(*stringNameIt, fieldValue, timestamp))
+    {
+      continue;
+    }
+    this->LastSentStringFieldValues[*stringNameIt] = fieldValue;
+    fieldSent = true;
+  }
+  if (!fieldSent || this->StringFieldsMaxRate <= 0)
+  {
+    return;
+  }
+  // Keep the average rate, unless the changes are late by more than a period
+  double intervalSec = 1.0 / this->StringFieldsMaxRate;
+  if (this->NextStringFieldsTimeStamp < 0 || timestamp - this->NextStringFieldsTimeStamp > intervalSec)
+  {
+    this->NextStringFieldsTimeStamp = timestamp + intervalSec;
+  }
+  else
+  {
+    this->NextStringFieldsTimeStamp += intervalSec;
+  }
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlClientInfo::StreamingOptions::operator==(const StreamingOptions& other) const
+{
+  return this->MaxFrameRate == other.MaxFrameRate
+         && this->FrameDecimation == other.FrameDecimation
+         && this->ImageDownscaleFactor == other.ImageDownscaleFactor
+         && this->ClipRectangleOrigin[0] == other.ClipRectangleOrigin[0]
+         && this->ClipRectangleOrigin[1] == other.ClipRectangleOrigin[1]
+         && this->ClipRectangleSize[0] == other.ClipRectangleSize[0]
+         && this->ClipRectangleSize[1] == other.ClipRectangleSize[1]
+         && this->Adaptive == other.Adaptive;
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlClientInfo::GetSendUsImagingParameters() const
+{
+  return this->SendUsImagingParameters;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::SetSendUsImagingParameters(bool enable)
+{
+  this->SendUsImagingParameters = enable;
+  this->LastSentUsImagingParametersVersion = 0;
+}
+
+//----------------------------------------------------------------------------
+std::string PlusIgtlClientInfo::GetUsImagingParametersDeviceId() const
+{
+  return this->UsImagingParametersDeviceId;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::SetUsImagingParametersDeviceId(const std::string& deviceId)
+{
+  this->UsImagingParametersDeviceId = deviceId;
+  this->LastSentUsImagingParametersVersion = 0;
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlClientInfo::IsUsImagingParametersUpdateDue(unsigned long version) const
+{
+  return this->SendUsImagingParameters && version != this->LastSentUsImagingParametersVersion;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::UpdateUsImagingParametersState(unsigned long version)
+{
+  this->LastSentUsImagingParametersVersion = version;
+}
@@ -18,6 +18,7 @@
 #include <igtlClientSocket.h>
 
 // STL includes
+#include <map>
 #include <string>
 #include <vector>
 
@@ -95,6 +96,40 @@ public:
     };
   };
 
+  /*! Options for limiting the rate and the size of the images (IMAGE and VIDEO messages) sent to the client */
+  struct StreamingOptions
+  {
+    /*! Maximum number of image frames sent per second. 0 means no limit. */
+    double MaxFrameRate;
+    /*! Only every N-th image frame is sent */
+    int FrameDecimation;
+    /*! Image width and height are divided by this factor before sending (IMAGE messages only) */
+    int ImageDownscaleFactor;
+    /*! Origin of the region of the image that is sent, in pixels (IMAGE messages only) */
+    int ClipRectangleOrigin[2];
+    /*! Size of the region of the image that is sent, in pixels. If any of the values is 0 then the whole image is sent. */
+    int ClipRectangleSize[2];
+    /*!
+      If enabled then the server reduces the image frame rate and size while frames have to be dropped because the client
+      cannot receive them fast enough, and restores them when the frames are received without dropping
+    */
+    bool Adaptive;
+    StreamingOptions()
+      : MaxFrameRate(0)
+      , FrameDecimation(1)
+      , ImageDownscaleFactor(1)
+      , Adaptive(false)
+    {
+      ClipRectangleOrigin[0] = ClipRectangleOrigin[1] = 0;
+      ClipRectangleSize[0] = ClipRectangleSize[1] = 0;
+    }
+    bool IsClipRectangleDefined() const { return ClipRectangleSize[0] > 0 && ClipRectangleSize[1] > 0; }
+    bool operator==(const StreamingOptions& other) const;
+  };
+
+  /*! Highest adaptive quality level. Each level halves the image frame rate or the image size. */
+  static const int MAX_ADAPTIVE_QUALITY_LEVEL = 6;
+
   PlusIgtlClientInfo();
 
   /*! De-serialize client info data from string xml data */
@@ -108,11 +143,25 @@ public:
 
   virtual void PrintSelf(ostream& os, vtkIndent indent);
 
+  /*!
+    Returns true if the same messages are sent for any tracked frame to a client with this and the other client info,
+    therefore the packed messages can be shared between the clients.
+    Client infos with video streams are never equivalent, as the encoder of each client has its own state.
+  */
+  bool IsSubscriptionEquivalent(const PlusIgtlClientInfo& other) const;
+
   /*! IGTL header version supported by the client */
   int GetClientHeaderVersion() const;
   /*! IGTL header version supported by the client */
   void SetClientHeaderVersion(int version);
 
+  /*!
+    Output channel of the server that the data is sent from, if the server publishes multiple channels.
+    Empty means the default output channel of the server (OutputChannelId attribute of the server configuration).
+  */
+  std::string GetOutputChannelId() const;
+  void SetOutputChannelId(const std::string& channelId);
+
   /*! Minimum time between two TDATA frames. Use 0 for as fast as possible. If e.g. 50 ms is specified, the maximum update rate will be 20 Hz. */
   int GetTDATAResolution() const;
   /*! Minimum time between two TDATA frames. Use 0 for as fast as possible. If e.g. 50 ms is specified, the maximum update rate will be 20 Hz. */
@@ -130,6 +179,86 @@ public:
   /*! timestamp of the last sent TDATA message. */
   void SetLastTDATASentTimeStamp(double val);
 
+  /*! Number of tracked frames passed to the client's socket by the server */
+  unsigned long GetNumberOfSentFrames() const;
+  /*! Number of tracked frames passed to the client's socket by the server */
+  void SetNumberOfSentFrames(unsigned long val);
+
+  /*! Number of tracked frames dropped from the client's send queue, because newer frames replaced them or the queue was full */
+  unsigned long GetNumberOfDroppedFrames() const;
+  /*! Number of tracked frames dropped from the client's send queue, because newer frames replaced them or the queue was full */
+  void SetNumberOfDroppedFrames(unsigned long val);
+
+  /*! Adaptive quality level, 0 means that the images are sent as specified in the streaming options */
+  int GetAdaptiveQualityLevel() const;
+  /*! Adaptive quality level, 0 means that the images are sent as specified in the streaming options */
+  void SetAdaptiveQualityLevel(int level);
+
+  /*! Every N-th image frame is sent, according to the streaming options and the adaptive quality level */
+  int GetEffectiveFrameDecimation() const;
+  /*! Image width and height are divided by this factor, according to the streaming options and the adaptive quality level */
+  int GetEffectiveImageDownscaleFactor() const;
+
+  /*! Returns true if images of the tracked frame with the specified timestamp should be sent to the client */
+  bool IsImageFrameDue(double timestamp) const;
+  /*! Update the image frame rate limiting state after a tracked frame is processed for the client. See IsImageFrameDue. */
+  void UpdateImageFrameState(double timestamp);
+
+  /*!
+    If enabled then the subscribed transforms are not sent in TRANSFORM and TDATA messages, but all of them are gathered
+    into a single TDATA message per tracked frame, at most CoalescedTransformsMaxRate times per second. The status of each
+    transform is sent in the meta data of the message (header version 2 or later).
+    Enabled by the CoalescedTransforms element of the client info.
+  */
+  bool GetCoalesceTransforms() const;
+  void SetCoalesceTransforms(bool enable);
+
+  /*! Maximum number of coalesced TDATA messages sent per second. 0 means that one is sent for each tracked frame. */
+  double GetCoalescedTransformsMaxRate() const;
+  void SetCoalescedTransformsMaxRate(double rate);
+
+  /*! Returns true if the coalesced TDATA message should be sent for the tracked frame with the specified timestamp */
+  bool IsCoalescedTransformsDue(double timestamp) const;
+  /*! Update the coalesced TDATA rate limiting state after a tracked frame is processed for the client. See IsCoalescedTransformsDue. */
+  void UpdateCoalescedTransformsState(double timestamp);
+
+  /*!
+    If enabled then the subscribed string fields are sent in STRING messages only when their value differs from the value
+    last sent to the client, instead of with every tracked frame. The changed fields are sent at most StringFieldsMaxRate
+    times per second, a throttled change is sent with a later frame (always the latest value).
+    Enabled by the OnChangeOnly attribute of the StringNames element of the client info.
+  */
+  bool GetSendStringFieldsOnChangeOnly() const;
+  void SetSendStringFieldsOnChangeOnly(bool enable);
+
+  /*! Maximum number of times per second that changed string fields are sent. 0 means that the rate is not limited. */
+  double GetStringFieldsMaxRate() const;
+  void SetStringFieldsMaxRate(double rate);
+
+  /*! Returns true if the string field with the specified value should be sent for the tracked frame with the specified timestamp */
+  bool IsStringFieldDue(const std::string& fieldName, const std::string& fieldValue, double timestamp) const;
+  /*! Record the sent string field values after a tracked frame is processed for the client. See IsStringFieldDue. */
+  void UpdateStringFieldsState(igsioTrackedFrame& trackedFrame);
+
+  /*!
+    If enabled then the imaging parameters of an ultrasound device are sent to the client in a STRING message
+    (UsImagingParameters XML element, see vtkPlusUsImagingParameters) when the client connects and then whenever
+    a parameter changes, so the client does not need to poll them by GetUsParameter commands.
+    Enabled by the UsImagingParameters element of the client info, its UsDeviceId attribute selects the device
+    (the first ultrasound device if empty).
+  */
+  bool GetSendUsImagingParameters() const;
+  void SetSendUsImagingParameters(bool enable);
+
+  /*! Id of the ultrasound device whose imaging parameters are sent. Empty means the first ultrasound device. */
+  std::string GetUsImagingParametersDeviceId() const;
+  void SetUsImagingParametersDeviceId(const std::string& deviceId);
+
+  /*! Returns true if the imaging parameters with the specified version have not been sent to the client yet */
+  bool IsUsImagingParametersUpdateDue(unsigned long version) const;
+  /*! Record the version of the imaging parameters sent to the client. See IsUsImagingParametersUpdateDue. */
+  void UpdateUsImagingParametersState(unsigned long version);
+
   /*! Message types that client expects from the server */
   std::vector<std::string> IgtlMessageTypes;
 
@@ -145,11 +274,32 @@ public:
   /*! Transform names to send with IGT VIDEO message */
   std::vector<VideoStream> VideoStreams;
 
+  /*! Rate and size limits of the image and video streams */
+  StreamingOptions ImageStreamingOptions;
+
 protected:
   int     ClientHeaderVersion;
   bool    TDATARequested;
   double  LastTDATASentTimeStamp;
   int     TDATAResolution;
+  unsigned long NumberOfSentFrames;
+  unsigned long NumberOfDroppedFrames;
+  int     AdaptiveQualityLevel;
+  int     NumberOfSkippedImageFrames;
+  double  NextImageFrameTimeStamp;
+  bool    CoalesceTransforms;
+  double  CoalescedTransformsMaxRate;
+  double  NextCoalescedTransformsTimeStamp;
+  bool    SendStringFieldsOnChangeOnly;
+  double  StringFieldsMaxRate;
+  double  NextStringFieldsTimeStamp;
+  /*! String field values last sent to the client, by field name */
+  std::map<std::string, std::string> LastSentStringFieldValues;
+  bool    SendUsImagingParameters;
+  std::string UsImagingParametersDeviceId;
+  /*! Version of the imaging parameters last sent to the client, 0 if none has been sent */
+  unsigned long LastSentUsImagingParametersVersion;
+  std::string OutputChannelId;
 };
 
 #endif
\ No newline at end of file
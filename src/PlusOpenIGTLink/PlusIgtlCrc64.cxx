@@ -0,0 +1,354 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusIgtlCrc64.h"
+
+// OpenIGTLink includes
+#include <igtl_header.h>
+#include <igtl_util.h>
+
+// STL includes
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+  #define PLUS_CRC64_CLMUL
+  #if defined(_MSC_VER)
+    #include <intrin.h>
+    #define PLUS_CRC64_CLMUL_TARGET
+  #else
+    #define PLUS_CRC64_CLMUL_TARGET __attribute__((target("pclmul,ssse3")))
+  #endif
+  #include <emmintrin.h>
+  #include <tmmintrin.h>
+  #include <wmmintrin.h>
+#endif
+
+namespace
+{
+  /*! ECMA-182 polynomial used by OpenIGTLink, without the x^64 term */
+  const igtl_uint64 POLYNOMIAL = 0x42F0E1EBA9EA3693ULL;
+
+  typedef igtl_uint64(*ComputeFunction)(igtl_uint64 crc, const unsigned char* data, igtl_uint64 length);
+
+  //----------------------------------------------------------------------------
+  /*! Tables[k][b] is the CRC of byte b followed by k zero bytes */
+  struct SliceTables
+  {
+    igtl_uint64 Tables[8][256];
+
+    SliceTables()
+    {
+      for (int b = 0; b < 256; ++b)
+      {
+        igtl_uint64 crc = static_cast<igtl_uint64>(b) << 56;
+        for (int bit = 0; bit < 8; ++bit)
+        {
+          crc = (crc & 0x8000000000000000ULL) ? ((crc << 1) ^ POLYNOMIAL) : (crc << 1);
+        }
+        this->Tables[0][b] = crc;
+      }
+      for (int k = 1; k < 8; ++k)
+      {
+        for (int b = 0; b < 256; ++b)
+        {
+          igtl_uint64 previous = this->Tables[k - 1][b];
+          this->Tables[k][b] = (previous << 8) ^ this->Tables[0][previous >> 56];
+        }
+      }
+    }
+  };
+
+  //----------------------------------------------------------------------------
+  const SliceTables& GetSliceTables()
+  {
+    static const SliceTables tables;
+    return tables;
+  }
+
+  //----------------------------------------------------------------------------
+  igtl_uint64 ComputeSliceBy8(igtl_uint64 crc, const unsigned char* data, igtl_uint64 length)
+  {
+    const SliceTables& t = GetSliceTables();
+    while (length >= 8)
+    {
+      // Bytes are in big-endian order in the CRC register, so the first byte goes through the most shifts
+      crc ^= (static_cast<igtl_uint64>(data[0]) << 56) | (static_cast<igtl_uint64>(data[1]) << 48)
+             | (static_cast<igtl_uint64>(data[2]) << 40) | (static_cast<igtl_uint64>(data[3]) << 32)
+             | (static_cast<igtl_uint64>(data[4]) << 24) | (static_cast<igtl_uint64>(data[5]) << 16)
+             | (static_cast<igtl_uint64>(data[6]) << 8) | static_cast<igtl_uint64>(data[7]);
+      crc = t.Tables[7][crc >> 56] ^ t.Tables[6][(crc >> 48) & 0xff] ^ t.Tables[5][(crc >> 40) & 0xff] ^ t.Tables[4][(crc >> 32) & 0xff]
+            ^ t.Tables[3][(crc >> 24) & 0xff] ^ t.Tables[2][(crc >> 16) & 0xff] ^ t.Tables[1][(crc >> 8) & 0xff] ^ t.Tables[0][crc & 0xff];
+      data += 8;
+      length -= 8;
+    }
+    for (; length > 0; --length, ++data)
+    {
+      crc = t.Tables[0][((crc >> 56) ^ *data) & 0xff] ^ (crc << 8);
+    }
+    return crc;
+  }
+
+  //----------------------------------------------------------------------------
+  igtl_uint64 ComputeOpenIGTLink(igtl_uint64 crc, const unsigned char* data, igtl_uint64 length)
+  {
+    return crc64(const_cast<unsigned char*>(data), length, crc);
+  }
+
+#ifdef PLUS_CRC64_CLMUL
+  //----------------------------------------------------------------------------
+  /*! x^exponent mod P */
+  igtl_uint64 GetXPowerModPolynomial(int exponent)
+  {
+    igtl_uint64 remainder = 1;
+    for (int i = 0; i < exponent; ++i)
+    {
+      remainder = (remainder & 0x8000000000000000ULL) ? ((remainder << 1) ^ POLYNOMIAL) : (remainder << 1);
+    }
+    return remainder;
+  }
+
+  //----------------------------------------------------------------------------
+  /*!
+    Multipliers that move a 128-bit value forward in the message: the high 64 bits are multiplied by x^(d+64) mod P,
+    the low 64 bits by x^d mod P, where d is the folding distance in bits
+  */
+  struct FoldConstants
+  {
+    igtl_uint64 Fold128High;
+    igtl_uint64 Fold128Low;
+    igtl_uint64 Fold512High;
+    igtl_uint64 Fold512Low;
+
+    FoldConstants()
+      : Fold128High(GetXPowerModPolynomial(192))
+      , Fold128Low(GetXPowerModPolynomial(128))
+      , Fold512High(GetXPowerModPolynomial(576))
+      , Fold512Low(GetXPowerModPolynomial(512))
+    {
+    }
+  };
+
+  //----------------------------------------------------------------------------
+  const FoldConstants& GetFoldConstants()
+  {
+    static const FoldConstants constants;
+    return constants;
+  }
+
+  //----------------------------------------------------------------------------
+  bool IsClmulSupported()
+  {
+#if defined(_MSC_VER)
+    int cpuInfo[4] = { 0 };
+    __cpuid(cpuInfo, 1);
+    const int SSSE3_BIT = 1 << 9;
+    const int PCLMULQDQ_BIT = 1 << 1;
+    return (cpuInfo[2] & SSSE3_BIT) && (cpuInfo[2] & PCLMULQDQ_BIT);
+#else
+    return __builtin_cpu_supports("ssse3") && __builtin_cpu_supports("pclmul");
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  PLUS_CRC64_CLMUL_TARGET inline __m128i LoadBigEndian(const unsigned char* data, __m128i byteReverseMask)
+  {
+    return _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)), byteReverseMask);
+  }
+
+  //----------------------------------------------------------------------------
+  PLUS_CRC64_CLMUL_TARGET inline __m128i Fold(__m128i value, __m128i constants)
+  {
+    return _mm_xor_si128(_mm_clmulepi64_si128(value, constants, 0x11), _mm_clmulepi64_si128(value, constants, 0x00));
+  }
+
+  //----------------------------------------------------------------------------
+  /*!
+    The message is processed as a polynomial in four interleaved 128-bit accumulators that are folded forward by
+    512 bits per 64-byte block, then combined into one. The remaining 128 bits and the tail are reduced with the table.
+  */
+  PLUS_CRC64_CLMUL_TARGET igtl_uint64 ComputeClmul(igtl_uint64 crc, const unsigned char* data, igtl_uint64 length)
+  {
+    if (length < 128)
+    {
+      return ComputeSliceBy8(crc, data, length);
+    }
+    const FoldConstants& c = GetFoldConstants();
+    const __m128i byteReverseMask = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m128i fold128 = _mm_set_epi64x(static_cast<long long>(c.Fold128High), static_cast<long long>(c.Fold128Low));
+    const __m128i fold512 = _mm_set_epi64x(static_cast<long long>(c.Fold512High), static_cast<long long>(c.Fold512Low));
+
+    // The initial CRC is added to the first 8 bytes of the message
+    __m128i x0 = _mm_xor_si128(LoadBigEndian(data, byteReverseMask), _mm_set_epi64x(static_cast<long long>(crc), 0));
+    __m128i x1 = LoadBigEndian(data + 16, byteReverseMask);
+    __m128i x2 = LoadBigEndian(data + 32, byteReverseMask);
+    __m128i x3 = LoadBigEndian(data + 48, byteReverseMask);
+    data += 64;
+    length -= 64;
+
+    while (length >= 64)
+    {
+      x0 = _mm_xor_si128(Fold(x0, fold512), LoadBigEndian(data, byteReverseMask));
+      x1 = _mm_xor_si128(Fold(x1, fold512), LoadBigEndian(data + 16, byteReverseMask));
+      x2 = _mm_xor_si128(Fold(x2, fold512), LoadBigEndian(data + 32, byteReverseMask));
+      x3 = _mm_xor_si128(Fold(x3, fold512), LoadBigEndian(data + 48, byteReverseMask));
+      data += 64;
+      length -= 64;
+    }
+
+    x1 = _mm_xor_si128(Fold(x0, fold128), x1);
+    x2 = _mm_xor_si128(Fold(x1, fold128), x2);
+    x3 = _mm_xor_si128(Fold(x2, fold128), x3);
+    while (length >= 16)
+    {
+      x3 = _mm_xor_si128(Fold(x3, fold128), LoadBigEndian(data, byteReverseMask));
+      data += 16;
+      length -= 16;
+    }
+
+    unsigned char remainder[16];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(remainder), _mm_shuffle_epi8(x3, byteReverseMask));
+    crc = ComputeSliceBy8(0, remainder, sizeof(remainder));
+    return ComputeSliceBy8(crc, data, length);
+  }
+#endif
+
+  //----------------------------------------------------------------------------
+  /*! Compare an implementation to crc64() of OpenIGTLink on a test pattern that covers all code paths */
+  bool IsCompatibleWithOpenIGTLink(ComputeFunction function)
+  {
+    std::vector<unsigned char> pattern(1031);
+    unsigned int state = 12345;
+    for (size_t i = 0; i < pattern.size(); ++i)
+    {
+      state = state * 1103515245u + 12345u;
+      pattern[i] = static_cast<unsigned char>(state >> 16);
+    }
+    const igtl_uint64 lengths[] = { 0, 1, 7, 8, 15, 16, 127, 128, 129, 191, 200, 256, 1000, 1031 };
+    const igtl_uint64 initialCrcs[] = { 0, 0xFEDCBA9876543210ULL };
+    for (size_t lengthIndex = 0; lengthIndex < sizeof(lengths) / sizeof(lengths[0]); ++lengthIndex)
+    {
+      for (size_t crcIndex = 0; crcIndex < sizeof(initialCrcs) / sizeof(initialCrcs[0]); ++crcIndex)
+      {
+        if (function(initialCrcs[crcIndex], &pattern[0], lengths[lengthIndex]) != ComputeOpenIGTLink(initialCrcs[crcIndex], &pattern[0], lengths[lengthIndex]))
+        {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  struct Implementation
+  {
+    ComputeFunction Function;
+    const char* Name;
+
+    Implementation()
+      : Function(&ComputeOpenIGTLink)
+      , Name("OpenIGTLink")
+    {
+#ifdef PLUS_CRC64_CLMUL
+      if (IsClmulSupported())
+      {
+        if (IsCompatibleWithOpenIGTLink(&ComputeClmul))
+        {
+          this->Function = &ComputeClmul;
+          this->Name = "PCLMULQDQ";
+          return;
+        }
+        LOG_WARNING("PCLMULQDQ CRC64 computation does not match OpenIGTLink, it is not used");
+      }
+#endif
+      if (IsCompatibleWithOpenIGTLink(&ComputeSliceBy8))
+      {
+        this->Function = &ComputeSliceBy8;
+        this->Name = "slicing-by-8";
+        return;
+      }
+      LOG_WARNING("Slicing-by-8 CRC64 computation does not match OpenIGTLink, it is not used");
+    }
+  };
+
+  //----------------------------------------------------------------------------
+  const Implementation& GetImplementation()
+  {
+    static const Implementation implementation;
+    return implementation;
+  }
+}
+
+//----------------------------------------------------------------------------
+igtl_uint64 IgtlCrc64::Compute(const void* data, igtl_uint64 length, igtl_uint64 crc/*=0*/)
+{
+  if (data == NULL || length == 0)
+  {
+    return crc;
+  }
+  return GetImplementation().Function(crc, static_cast<const unsigned char*>(data), length);
+}
+
+//----------------------------------------------------------------------------
+igtl_uint64 IgtlCrc64::GetHeaderCrc(igtl::MessageBase* headerMsg)
+{
+  if (headerMsg == NULL)
+  {
+    return 0;
+  }
+  return static_cast<const igtl_header*>(headerMsg->GetBufferPointer())->crc;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus IgtlCrc64::CheckBody(igtl::MessageBase* bodyMsg, igtl_uint64 expectedCrc)
+{
+  if (bodyMsg == NULL)
+  {
+    LOG_ERROR("Unable to check CRC of OpenIGTLink message - message is NULL!");
+    return PLUS_FAIL;
+  }
+  if (Compute(bodyMsg->GetBufferBodyPointer(), bodyMsg->GetBufferBodySize()) != expectedCrc)
+  {
+    LOG_ERROR("CRC check of OpenIGTLink " << bodyMsg->GetDeviceType() << " message failed");
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+const char* IgtlCrc64::GetImplementationName()
+{
+  return GetImplementation().Name;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus IgtlCrc64::ComputeWithImplementation(ImplementationType implementation, const void* data, igtl_uint64 length, igtl_uint64 crc, igtl_uint64& result)
+{
+  ComputeFunction function = NULL;
+  switch (implementation)
+  {
+    case IMPLEMENTATION_PCLMULQDQ:
+#ifdef PLUS_CRC64_CLMUL
+      if (IsClmulSupported())
+      {
+        function = &ComputeClmul;
+      }
+#endif
+      break;
+    case IMPLEMENTATION_SLICING_BY_8:
+      function = &ComputeSliceBy8;
+      break;
+    case IMPLEMENTATION_OPENIGTLINK:
+      function = &ComputeOpenIGTLink;
+      break;
+  }
+  if (function == NULL)
+  {
+    return PLUS_FAIL;
+  }
+  result = (data == NULL || length == 0) ? crc : function(crc, static_cast<const unsigned char*>(data), length);
+  return PLUS_SUCCESS;
+}
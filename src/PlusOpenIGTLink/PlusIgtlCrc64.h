@@ -0,0 +1,63 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __IgtlCrc64_h
+#define __IgtlCrc64_h
+
+#include "vtkPlusOpenIGTLinkExport.h"
+
+#include "PlusConfigure.h"
+
+// OpenIGTLink includes
+#include <igtlMessageBase.h>
+#include <igtl_types.h>
+
+/*!
+  \class IgtlCrc64
+  \brief Computes the CRC64 checksum of OpenIGTLink messages faster than crc64() of OpenIGTLink.
+
+  The result is identical to crc64() (ECMA-182 polynomial, MSB first, no final XOR), so it can be used in place of it
+  and compared to the CRC in the message header. On x86 CPUs that support carry-less multiplication (PCLMULQDQ) the
+  data is folded 64 bytes at a time, otherwise a slicing-by-8 table processes 8 bytes at a time instead of one.
+
+  The implementation is selected at the first call. The accelerated implementation is checked against crc64() on a
+  test pattern and is not used if the results differ.
+
+  \ingroup PlusLibOpenIGTLink
+*/
+class vtkPlusOpenIGTLinkExport IgtlCrc64
+{
+public:
+  enum ImplementationType
+  {
+    IMPLEMENTATION_PCLMULQDQ,
+    IMPLEMENTATION_SLICING_BY_8,
+    IMPLEMENTATION_OPENIGTLINK
+  };
+
+  /*! Update crc (initially 0) with length bytes of data, the same way as crc64(data, length, crc) */
+  static igtl_uint64 Compute(const void* data, igtl_uint64 length, igtl_uint64 crc = 0);
+
+  /*! CRC stored in an unpacked message header (its fields are already in host byte order) */
+  static igtl_uint64 GetHeaderCrc(igtl::MessageBase* headerMsg);
+
+  /*!
+    Verify that the CRC of the received body of bodyMsg matches expectedCrc (taken from the header with GetHeaderCrc() before
+    the body buffer was allocated). The body can then be unpacked without CRC check.
+  */
+  static PlusStatus CheckBody(igtl::MessageBase* bodyMsg, igtl_uint64 expectedCrc);
+
+  /*! Name of the implementation that Compute() uses ("PCLMULQDQ", "slicing-by-8" or "OpenIGTLink") */
+  static const char* GetImplementationName();
+
+  /*!
+    Compute the CRC with the specified implementation instead of the selected one (for testing).
+    Returns with failure if the implementation is not supported by the CPU.
+  */
+  static PlusStatus ComputeWithImplementation(ImplementationType implementation, const void* data, igtl_uint64 length, igtl_uint64 crc, igtl_uint64& result);
+};
+
+#endif
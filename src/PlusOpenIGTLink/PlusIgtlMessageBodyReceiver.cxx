@@ -0,0 +1,194 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusIgtlCrc64.h"
+#include "PlusIgtlMessageBodyReceiver.h"
+
+// STL includes
+#include <algorithm>
+
+const igtl_uint64 IgtlMessageBodyReceiver::CHUNK_SIZE = 1024 * 1024;
+
+namespace
+{
+  const igtl_uint64 MAX_SKIP_BUFFER_SIZE = 64 * 1024;
+}
+
+//----------------------------------------------------------------------------
+IgtlMessageBodyReceiver::IgtlMessageBodyReceiver(igtl::Socket* socket, igtl::MessageBase* headerMsg, bool crcCheck)
+  : Socket(socket)
+  , HeaderVersion(IGTL_HEADER_VERSION_1)
+  , CrcCheck(crcCheck)
+  , ExpectedCrc(0)
+  , Crc(0)
+  , RemainingBodySize(0)
+  , MetaDataSize(0)
+  , Failed(false)
+{
+  if (socket == NULL || headerMsg == NULL)
+  {
+    LOG_ERROR("Unable to receive message body - socket or header message is NULL!");
+    this->Failed = true;
+    return;
+  }
+  this->HeaderVersion = headerMsg->GetHeaderVersion();
+  this->RemainingBodySize = headerMsg->GetBodySizeToRead();
+  this->ExpectedCrc = IgtlCrc64::GetHeaderCrc(headerMsg);
+}
+
+//----------------------------------------------------------------------------
+IgtlMessageBodyReceiver::~IgtlMessageBodyReceiver()
+{
+}
+
+//----------------------------------------------------------------------------
+PlusStatus IgtlMessageBodyReceiver::ReceiveExtendedHeader()
+{
+  if (this->HeaderVersion < IGTL_HEADER_VERSION_2)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  unsigned char extendedHeader[IGTL_EXTENDED_HEADER_SIZE];
+  if (this->Receive(extendedHeader, sizeof(extendedHeader)) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to receive extended header of OpenIGTLink message");
+    return PLUS_FAIL;
+  }
+
+  // Fields in network byte order: extended header size, meta data header size, meta data size, message ID
+  igtl_uint64 extendedHeaderSize = (static_cast<igtl_uint64>(extendedHeader[0]) << 8) | extendedHeader[1];
+  igtl_uint64 metaDataHeaderSize = (static_cast<igtl_uint64>(extendedHeader[2]) << 8) | extendedHeader[3];
+  igtl_uint64 metaDataSize = (static_cast<igtl_uint64>(extendedHeader[4]) << 24) | (static_cast<igtl_uint64>(extendedHeader[5]) << 16)
+                             | (static_cast<igtl_uint64>(extendedHeader[6]) << 8) | extendedHeader[7];
+  if (extendedHeaderSize < IGTL_EXTENDED_HEADER_SIZE
+      || extendedHeaderSize - IGTL_EXTENDED_HEADER_SIZE + metaDataHeaderSize + metaDataSize > this->RemainingBodySize)
+  {
+    LOG_ERROR("Invalid extended header in OpenIGTLink message: extended header size " << extendedHeaderSize << ", meta data size "
+              << metaDataHeaderSize + metaDataSize << ", body size " << this->RemainingBodySize + IGTL_EXTENDED_HEADER_SIZE);
+    this->Failed = true;
+    return PLUS_FAIL;
+  }
+  if (extendedHeaderSize > IGTL_EXTENDED_HEADER_SIZE && this->Skip(extendedHeaderSize - IGTL_EXTENDED_HEADER_SIZE) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  this->MetaDataSize = metaDataHeaderSize + metaDataSize;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus IgtlMessageBodyReceiver::Receive(void* data, igtl_uint64 length)
+{
+  if (this->Failed)
+  {
+    return PLUS_FAIL;
+  }
+  if (length > this->RemainingBodySize)
+  {
+    LOG_ERROR("OpenIGTLink message body is too short: " << length << " bytes are expected, but only " << this->RemainingBodySize << " bytes are left");
+    this->Failed = true;
+    return PLUS_FAIL;
+  }
+
+  unsigned char* chunkPtr = static_cast<unsigned char*>(data);
+  while (length > 0)
+  {
+    igtl_uint64 chunkSize = std::min(length, CHUNK_SIZE);
+    if (this->Socket->Receive(chunkPtr, static_cast<int>(chunkSize)) != static_cast<int>(chunkSize))
+    {
+      LOG_ERROR("Failed to receive OpenIGTLink message body, " << this->RemainingBodySize << " bytes are not received");
+      this->Failed = true;
+      return PLUS_FAIL;
+    }
+    if (this->CrcCheck)
+    {
+      this->Crc = IgtlCrc64::Compute(chunkPtr, chunkSize, this->Crc);
+    }
+    chunkPtr += chunkSize;
+    length -= chunkSize;
+    this->RemainingBodySize -= chunkSize;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus IgtlMessageBodyReceiver::ReceiveImageHeader(igtl_image_header& imageHeader)
+{
+  if (this->Receive(&imageHeader, IGTL_IMAGE_HEADER_SIZE) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to receive image header of OpenIGTLink message");
+    return PLUS_FAIL;
+  }
+  igtl_image_convert_byte_order(&imageHeader);
+
+  if (imageHeader.subvol_size[0] == 0 || imageHeader.subvol_size[1] == 0 || imageHeader.subvol_size[2] == 0)
+  {
+    LOG_ERROR("Invalid image size in OpenIGTLink message: " << imageHeader.subvol_size[0] << "x" << imageHeader.subvol_size[1] << "x" << imageHeader.subvol_size[2]);
+    return PLUS_FAIL;
+  }
+  if (igtl_image_get_data_size(&imageHeader) > this->GetRemainingContentSize())
+  {
+    LOG_ERROR("Image data size in OpenIGTLink message (" << igtl_image_get_data_size(&imageHeader) << " bytes) is larger than the rest of the message content ("
+              << this->GetRemainingContentSize() << " bytes)");
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus IgtlMessageBodyReceiver::Skip(igtl_uint64 length)
+{
+  if (length == 0)
+  {
+    return this->Failed ? PLUS_FAIL : PLUS_SUCCESS;
+  }
+  // The skipped data is received into a small buffer, so that it is included in the CRC.
+  // The buffer grows if an earlier skip was shorter, so that long skips are not received in tiny parts.
+  size_t skipBufferSize = static_cast<size_t>(std::min(length, MAX_SKIP_BUFFER_SIZE));
+  if (this->SkipBuffer.size() < skipBufferSize)
+  {
+    this->SkipBuffer.resize(skipBufferSize);
+  }
+  while (length > 0)
+  {
+    igtl_uint64 partSize = std::min(length, static_cast<igtl_uint64>(this->SkipBuffer.size()));
+    if (this->Receive(&this->SkipBuffer[0], partSize) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    length -= partSize;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus IgtlMessageBodyReceiver::Finish()
+{
+  if (this->Skip(this->RemainingBodySize) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  if (this->CrcCheck && this->Crc != this->ExpectedCrc)
+  {
+    LOG_ERROR("CRC check of OpenIGTLink message failed");
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+igtl_uint64 IgtlMessageBodyReceiver::GetRemainingBodySize() const
+{
+  return this->RemainingBodySize;
+}
+
+//----------------------------------------------------------------------------
+igtl_uint64 IgtlMessageBodyReceiver::GetRemainingContentSize() const
+{
+  return this->RemainingBodySize > this->MetaDataSize ? this->RemainingBodySize - this->MetaDataSize : 0;
+}
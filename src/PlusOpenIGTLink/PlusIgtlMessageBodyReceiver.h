@@ -0,0 +1,88 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __IgtlMessageBodyReceiver_h
+#define __IgtlMessageBodyReceiver_h
+
+#include "vtkPlusOpenIGTLinkExport.h"
+
+#include "PlusConfigure.h"
+
+// OpenIGTLink includes
+#include <igtlMessageBase.h>
+#include <igtlSocket.h>
+#include <igtl_image.h>
+
+// STL includes
+#include <vector>
+
+/*!
+  \class IgtlMessageBodyReceiver
+  \brief Receives the body of an OpenIGTLink message from a socket in parts, directly into their destination.
+
+  Large messages (such as 3D volumes) are not received into a message buffer: the caller receives the fixed size
+  headers of the message content, allocates the destination (such as the image of a tracked frame) and then receives
+  the bulk data directly into it. The socket is read in chunks of at most CHUNK_SIZE bytes and the CRC is computed
+  incrementally while the chunk is still in the cache, so the CRC check does not need the whole body in memory either.
+
+  The receiver keeps track of the unread part of the body. If the content is invalid then Finish() skips the rest
+  of the body, so that the socket remains at a message boundary.
+
+  The message header must be unpacked before the receiver is created; the socket must not be read by other threads
+  while the body is received.
+
+  \ingroup PlusLibOpenIGTLink
+*/
+class vtkPlusOpenIGTLinkExport IgtlMessageBodyReceiver
+{
+public:
+  IgtlMessageBodyReceiver(igtl::Socket* socket, igtl::MessageBase* headerMsg, bool crcCheck);
+  virtual ~IgtlMessageBodyReceiver();
+
+  /*!
+    Receive the extended header, which precedes the content from header version 2.
+    Does nothing for header version 1. The size of the meta data at the end of the body is taken from the extended header.
+  */
+  PlusStatus ReceiveExtendedHeader();
+
+  /*! Receive the next length bytes of the body into data */
+  PlusStatus Receive(void* data, igtl_uint64 length);
+
+  /*! Receive the standard IMAGE header (also used by USMESSAGE) and convert it to host byte order */
+  PlusStatus ReceiveImageHeader(igtl_image_header& imageHeader);
+
+  /*! Read and discard the next length bytes of the body */
+  PlusStatus Skip(igtl_uint64 length);
+
+  /*! Skip the rest of the body (the meta data, unused content) and verify the CRC, if CRC check is enabled */
+  PlusStatus Finish();
+
+  /*! Number of body bytes that are not read yet */
+  igtl_uint64 GetRemainingBodySize() const;
+
+  /*! Number of content bytes that are not read yet (the meta data at the end of the body is not included) */
+  igtl_uint64 GetRemainingContentSize() const;
+
+  static const igtl_uint64 CHUNK_SIZE;
+
+protected:
+  igtl::Socket* Socket;
+  int HeaderVersion;
+  bool CrcCheck;
+  igtl_uint64 ExpectedCrc;
+  igtl_uint64 Crc;
+  igtl_uint64 RemainingBodySize;
+  igtl_uint64 MetaDataSize;
+  /*! Set if the socket could not be read or the body is inconsistent, no more data is read from the socket */
+  bool Failed;
+  std::vector<unsigned char> SkipBuffer;
+
+private:
+  IgtlMessageBodyReceiver(const IgtlMessageBodyReceiver&);
+  void operator=(const IgtlMessageBodyReceiver&);
+};
+
+#endif
@@ -0,0 +1,383 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusIgtlUdpSocket.h"
+#include "vtkPlusIgtlMessageFactory.h"
+
+// OpenIGTLink includes
+#include <igtlMessageHeader.h>
+
+#if defined(_WIN32)
+  #include <winsock2.h>
+  #include <ws2tcpip.h>
+  typedef int socklen_t;
+  typedef SOCKET PlatformSocket;
+  #define CLOSE_SOCKET closesocket
+#else
+  #include <arpa/inet.h>
+  #include <netinet/in.h>
+  #include <sys/select.h>
+  #include <sys/socket.h>
+  #include <unistd.h>
+  typedef int PlatformSocket;
+  #define CLOSE_SOCKET close
+#endif
+
+#include <string.h>
+
+const unsigned int IgtlUdpSocket::MAX_DATAGRAM_SIZE = 1472;
+const unsigned int IgtlUdpSocket::MAX_FRAGMENTED_DATAGRAM_SIZE = 65507;
+const unsigned int IgtlUdpSocket::DATAGRAM_HEADER_SIZE = 8;
+
+namespace
+{
+  const char DATAGRAM_MAGIC[4] = { 'P', 'L', 'U', 'D' };
+  const long long INVALID_SOCKET_DESCRIPTOR = -1;
+
+  //----------------------------------------------------------------------------
+  void WriteDatagramHeader(std::vector<char>& datagram, unsigned int sequenceNumber)
+  {
+    datagram.resize(IgtlUdpSocket::DATAGRAM_HEADER_SIZE);
+    memcpy(&datagram[0], DATAGRAM_MAGIC, sizeof(DATAGRAM_MAGIC));
+    for (int i = 0; i < 4; ++i)
+    {
+      datagram[4 + i] = static_cast<char>((sequenceNumber >> (8 * (3 - i))) & 0xFF);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  bool ReadDatagramHeader(const char* datagram, size_t size, unsigned int& sequenceNumber)
+  {
+    if (size < IgtlUdpSocket::DATAGRAM_HEADER_SIZE || memcmp(datagram, DATAGRAM_MAGIC, sizeof(DATAGRAM_MAGIC)) != 0)
+    {
+      return false;
+    }
+    sequenceNumber = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+      sequenceNumber = (sequenceNumber << 8) | static_cast<unsigned char>(datagram[4 + i]);
+    }
+    return true;
+  }
+}
+
+//----------------------------------------------------------------------------
+IgtlUdpSocket::IgtlUdpSocket()
+  : SocketDescriptor(INVALID_SOCKET_DESCRIPTOR)
+  , NextSequenceNumber(0)
+  , FirstDatagramReceived(false)
+  , LastReceivedSequenceNumber(0)
+  , NumberOfDatagrams(0)
+  , NumberOfLostDatagrams(0)
+  , NumberOfStaleDatagrams(0)
+{
+#if defined(_WIN32)
+  WSADATA wsaData;
+  WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+}
+
+//----------------------------------------------------------------------------
+IgtlUdpSocket::~IgtlUdpSocket()
+{
+  this->Close();
+#if defined(_WIN32)
+  WSACleanup();
+#endif
+}
+
+//----------------------------------------------------------------------------
+bool IgtlUdpSocket::IsMulticastAddress(const std::string& address)
+{
+  struct in_addr inAddress;
+  if (inet_pton(AF_INET, address.c_str(), &inAddress) != 1)
+  {
+    return false;
+  }
+  return (ntohl(inAddress.s_addr) & 0xF0000000) == 0xE0000000;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus IgtlUdpSocket::OpenForSending(const std::string& address, int port, int multicastTtl/*=1*/)
+{
+  this->Close();
+
+  struct sockaddr_in destination;
+  memset(&destination, 0, sizeof(destination));
+  destination.sin_family = AF_INET;
+  destination.sin_port = htons(static_cast<unsigned short>(port));
+  if (inet_pton(AF_INET, address.c_str(), &destination.sin_addr) != 1)
+  {
+    LOG_ERROR("Invalid UDP destination address: " << address);
+    return PLUS_FAIL;
+  }
+
+  PlatformSocket socketDescriptor = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (socketDescriptor == static_cast<PlatformSocket>(INVALID_SOCKET_DESCRIPTOR))
+  {
+    LOG_ERROR("Failed to create UDP socket");
+    return PLUS_FAIL;
+  }
+  if (IsMulticastAddress(address))
+  {
+    unsigned char ttl = static_cast<unsigned char>(multicastTtl);
+    if (setsockopt(socketDescriptor, IPPROTO_IP, IP_MULTICAST_TTL, reinterpret_cast<const char*>(&ttl), sizeof(ttl)) != 0)
+    {
+      LOG_WARNING("Failed to set multicast TTL of UDP socket to " << multicastTtl);
+    }
+  }
+
+  this->SocketDescriptor = static_cast<long long>(socketDescriptor);
+  this->DestinationAddress.assign(reinterpret_cast<const char*>(&destination), reinterpret_cast<const char*>(&destination) + sizeof(destination));
+  this->NextSequenceNumber = 0;
+  this->NumberOfDatagrams = 0;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus IgtlUdpSocket::OpenForReceiving(int port, const std::string& multicastAddress/*=""*/)
+{
+  this->Close();
+
+  PlatformSocket socketDescriptor = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (socketDescriptor == static_cast<PlatformSocket>(INVALID_SOCKET_DESCRIPTOR))
+  {
+    LOG_ERROR("Failed to create UDP socket");
+    return PLUS_FAIL;
+  }
+
+  // Allow multiple receivers of a multicast stream on the same host
+  int reuseAddress = 1;
+  setsockopt(socketDescriptor, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuseAddress), sizeof(reuseAddress));
+
+  struct sockaddr_in localAddress;
+  memset(&localAddress, 0, sizeof(localAddress));
+  localAddress.sin_family = AF_INET;
+  localAddress.sin_port = htons(static_cast<unsigned short>(port));
+  localAddress.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(socketDescriptor, reinterpret_cast<struct sockaddr*>(&localAddress), sizeof(localAddress)) != 0)
+  {
+    LOG_ERROR("Failed to bind UDP socket to port " << port);
+    CLOSE_SOCKET(socketDescriptor);
+    return PLUS_FAIL;
+  }
+
+  if (!multicastAddress.empty())
+  {
+    struct ip_mreq membership;
+    memset(&membership, 0, sizeof(membership));
+    if (!IsMulticastAddress(multicastAddress) || inet_pton(AF_INET, multicastAddress.c_str(), &membership.imr_multiaddr) != 1)
+    {
+      LOG_ERROR("Invalid UDP multicast group address: " << multicastAddress);
+      CLOSE_SOCKET(socketDescriptor);
+      return PLUS_FAIL;
+    }
+    membership.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (setsockopt(socketDescriptor, IPPROTO_IP, IP_ADD_MEMBERSHIP, reinterpret_cast<const char*>(&membership), sizeof(membership)) != 0)
+    {
+      LOG_ERROR("Failed to join UDP multicast group " << multicastAddress);
+      CLOSE_SOCKET(socketDescriptor);
+      return PLUS_FAIL;
+    }
+  }
+
+  this->SocketDescriptor = static_cast<long long>(socketDescriptor);
+  this->ReceiveBuffer.resize(MAX_FRAGMENTED_DATAGRAM_SIZE);
+  this->FirstDatagramReceived = false;
+  this->NumberOfDatagrams = 0;
+  this->NumberOfLostDatagrams = 0;
+  this->NumberOfStaleDatagrams = 0;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void IgtlUdpSocket::Close()
+{
+  if (this->SocketDescriptor != INVALID_SOCKET_DESCRIPTOR)
+  {
+    CLOSE_SOCKET(static_cast<PlatformSocket>(this->SocketDescriptor));
+    this->SocketDescriptor = INVALID_SOCKET_DESCRIPTOR;
+  }
+  this->DestinationAddress.clear();
+}
+
+//----------------------------------------------------------------------------
+bool IgtlUdpSocket::IsOpen() const
+{
+  return this->SocketDescriptor != INVALID_SOCKET_DESCRIPTOR;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus IgtlUdpSocket::SendMessages(const std::vector<igtl::MessageBase::Pointer>& messages)
+{
+  if (!this->IsOpen() || this->DestinationAddress.empty())
+  {
+    LOG_ERROR("UDP socket is not open for sending");
+    return PLUS_FAIL;
+  }
+
+  PlusStatus status = PLUS_SUCCESS;
+  std::vector<char> datagram;
+  for (std::vector<igtl::MessageBase::Pointer>::const_iterator messageIt = messages.begin(); messageIt != messages.end(); ++messageIt)
+  {
+    size_t messageSize = (*messageIt)->GetPackSize();
+    if (messageSize + DATAGRAM_HEADER_SIZE > MAX_FRAGMENTED_DATAGRAM_SIZE)
+    {
+      LOG_ERROR("Message " << (*messageIt)->GetMessageType() << " (" << messageSize << " bytes) is too large to be sent in a UDP datagram");
+      status = PLUS_FAIL;
+      continue;
+    }
+    if (!datagram.empty() && datagram.size() + messageSize > MAX_DATAGRAM_SIZE)
+    {
+      if (this->SendDatagram(datagram) != PLUS_SUCCESS)
+      {
+        status = PLUS_FAIL;
+      }
+      datagram.clear();
+    }
+    if (datagram.empty())
+    {
+      WriteDatagramHeader(datagram, this->NextSequenceNumber++);
+    }
+    const char* messageData = static_cast<const char*>((*messageIt)->GetPackPointer());
+    datagram.insert(datagram.end(), messageData, messageData + messageSize);
+  }
+  if (!datagram.empty() && this->SendDatagram(datagram) != PLUS_SUCCESS)
+  {
+    status = PLUS_FAIL;
+  }
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus IgtlUdpSocket::SendDatagram(const std::vector<char>& datagram)
+{
+  int bytesSent = sendto(static_cast<PlatformSocket>(this->SocketDescriptor), &datagram[0], static_cast<int>(datagram.size()), 0,
+                         reinterpret_cast<const struct sockaddr*>(&this->DestinationAddress[0]), static_cast<socklen_t>(this->DestinationAddress.size()));
+  if (bytesSent != static_cast<int>(datagram.size()))
+  {
+    LOG_ERROR("Failed to send UDP datagram of " << datagram.size() << " bytes");
+    return PLUS_FAIL;
+  }
+  this->NumberOfDatagrams++;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus IgtlUdpSocket::ReceiveMessages(double timeoutSec, vtkPlusIgtlMessageFactory* messageFactory, int crccheck, std::vector<igtl::MessageBase::Pointer>& messages)
+{
+  if (!this->IsOpen() || this->ReceiveBuffer.empty())
+  {
+    LOG_ERROR("UDP socket is not open for receiving");
+    return PLUS_FAIL;
+  }
+  if (messageFactory == NULL)
+  {
+    LOG_ERROR("Unable to receive UDP messages - message factory is NULL");
+    return PLUS_FAIL;
+  }
+
+  PlatformSocket socketDescriptor = static_cast<PlatformSocket>(this->SocketDescriptor);
+  fd_set readSockets;
+  FD_ZERO(&readSockets);
+  FD_SET(socketDescriptor, &readSockets);
+  struct timeval timeout;
+  timeout.tv_sec = static_cast<long>(timeoutSec);
+  timeout.tv_usec = static_cast<long>((timeoutSec - timeout.tv_sec) * 1000000);
+  int numberOfReadySockets = select(static_cast<int>(socketDescriptor) + 1, &readSockets, NULL, NULL, &timeout);
+  if (numberOfReadySockets < 0)
+  {
+    LOG_ERROR("Failed to wait for UDP datagram");
+    return PLUS_FAIL;
+  }
+  if (numberOfReadySockets == 0)
+  {
+    // Timeout
+    return PLUS_SUCCESS;
+  }
+
+  int bytesReceived = recvfrom(socketDescriptor, &this->ReceiveBuffer[0], static_cast<int>(this->ReceiveBuffer.size()), 0, NULL, NULL);
+  if (bytesReceived < 0)
+  {
+    LOG_ERROR("Failed to receive UDP datagram");
+    return PLUS_FAIL;
+  }
+
+  unsigned int sequenceNumber = 0;
+  if (!ReadDatagramHeader(&this->ReceiveBuffer[0], bytesReceived, sequenceNumber))
+  {
+    LOG_DEBUG("Ignored UDP datagram with invalid header (" << bytesReceived << " bytes)");
+    return PLUS_SUCCESS;
+  }
+  if (this->FirstDatagramReceived)
+  {
+    // The difference is interpreted as signed so that the sequence number can wrap around
+    int sequenceNumberDifference = static_cast<int>(sequenceNumber - this->LastReceivedSequenceNumber);
+    if (sequenceNumberDifference <= 0)
+    {
+      this->NumberOfStaleDatagrams++;
+      return PLUS_SUCCESS;
+    }
+    this->NumberOfLostDatagrams += sequenceNumberDifference - 1;
+  }
+  this->FirstDatagramReceived = true;
+  this->LastReceivedSequenceNumber = sequenceNumber;
+  this->NumberOfDatagrams++;
+
+  size_t position = DATAGRAM_HEADER_SIZE;
+  while (position + IGTL_HEADER_SIZE <= static_cast<size_t>(bytesReceived))
+  {
+    igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+    headerMsg->InitBuffer();
+    memcpy(headerMsg->GetPackPointer(), &this->ReceiveBuffer[position], IGTL_HEADER_SIZE);
+    headerMsg->Unpack(crccheck);
+    position += IGTL_HEADER_SIZE;
+    size_t bodySize = headerMsg->GetBodySizeToRead();
+    if (position + bodySize > static_cast<size_t>(bytesReceived))
+    {
+      LOG_ERROR("Truncated " << headerMsg->GetMessageType() << " message in UDP datagram");
+      break;
+    }
+
+    igtl::MessageBase::Pointer bodyMsg = messageFactory->CreateReceiveMessage(headerMsg);
+    if (bodyMsg.IsNotNull())
+    {
+      bodyMsg->SetMessageHeader(headerMsg);
+      bodyMsg->AllocateBuffer();
+      memcpy(bodyMsg->GetBufferBodyPointer(), &this->ReceiveBuffer[position], bodySize);
+      int c = bodyMsg->Unpack(crccheck);
+      if (c & igtl::MessageHeader::UNPACK_BODY)
+      {
+        messages.push_back(bodyMsg);
+      }
+      else
+      {
+        LOG_ERROR("Failed to unpack " << headerMsg->GetMessageType() << " message from UDP datagram");
+      }
+    }
+    position += bodySize;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+unsigned long IgtlUdpSocket::GetNumberOfDatagrams() const
+{
+  return this->NumberOfDatagrams;
+}
+
+//----------------------------------------------------------------------------
+unsigned long IgtlUdpSocket::GetNumberOfLostDatagrams() const
+{
+  return this->NumberOfLostDatagrams;
+}
+
+//----------------------------------------------------------------------------
+unsigned long IgtlUdpSocket::GetNumberOfStaleDatagrams() const
+{
+  return this->NumberOfStaleDatagrams;
+}
@@ -0,0 +1,101 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __IgtlUdpSocket_h
+#define __IgtlUdpSocket_h
+
+#include "vtkPlusOpenIGTLinkExport.h"
+
+#include "PlusConfigure.h"
+
+// OpenIGTLink includes
+#include <igtlMessageBase.h>
+
+// STL includes
+#include <string>
+#include <vector>
+
+class vtkPlusIgtlMessageFactory;
+
+/*!
+  \class IgtlUdpSocket
+  \brief Sends and receives OpenIGTLink messages in UDP datagrams (unicast or multicast).
+
+  Used for streaming high-rate tracking data (TRANSFORM, POSITION, TDATA messages), where a late message is worth
+  less than the next one: there is no retransmission and no head-of-line blocking. Each datagram starts with a
+  DATAGRAM_HEADER_SIZE byte header: the "PLUD" magic followed by a big-endian 32-bit sequence number. The header
+  is followed by one or more complete OpenIGTLink messages (header and body). Messages of a frame are packed into
+  as few datagrams of at most MAX_DATAGRAM_SIZE bytes as possible.
+
+  The receiver counts the datagrams that are lost and drops those that arrive out of order (older than the last
+  received datagram), so that older transforms never overwrite newer ones.
+
+  \ingroup PlusLibOpenIGTLink
+*/
+class vtkPlusOpenIGTLinkExport IgtlUdpSocket
+{
+public:
+  IgtlUdpSocket();
+  virtual ~IgtlUdpSocket();
+
+  /*!
+    Open the socket for sending datagrams to the address and port.
+    If the address is a multicast group address (224.0.0.0-239.255.255.255) then multicastTtl limits the number of hops.
+  */
+  PlusStatus OpenForSending(const std::string& address, int port, int multicastTtl = 1);
+
+  /*! Open the socket for receiving datagrams on the port. If multicastAddress is not empty then the multicast group is joined. */
+  PlusStatus OpenForReceiving(int port, const std::string& multicastAddress = "");
+
+  void Close();
+  bool IsOpen() const;
+
+  /*! Send packed messages. Fails if a message does not fit in a datagram or the datagram cannot be sent. */
+  PlusStatus SendMessages(const std::vector<igtl::MessageBase::Pointer>& messages);
+
+  /*!
+    Wait at most timeoutSec for a datagram and append its unpacked messages to messages.
+    No messages are appended if no datagram is received within the timeout or the datagram is older than the last one.
+    Messages that cannot be created by the factory or fail to unpack are skipped.
+  */
+  PlusStatus ReceiveMessages(double timeoutSec, vtkPlusIgtlMessageFactory* messageFactory, int crccheck, std::vector<igtl::MessageBase::Pointer>& messages);
+
+  /*! Number of datagrams sent or accepted by the receiver */
+  unsigned long GetNumberOfDatagrams() const;
+  /*! Number of datagrams that did not arrive at the receiver (based on the gaps in the sequence numbers) */
+  unsigned long GetNumberOfLostDatagrams() const;
+  /*! Number of datagrams that the receiver dropped because they arrived later than a newer datagram */
+  unsigned long GetNumberOfStaleDatagrams() const;
+
+  static bool IsMulticastAddress(const std::string& address);
+
+  /*! Datagrams are kept within the payload of an Ethernet frame (1500 byte MTU) to avoid IP fragmentation */
+  static const unsigned int MAX_DATAGRAM_SIZE;
+  /*! Messages larger than MAX_DATAGRAM_SIZE are sent alone in a datagram of at most this size (IP fragmented) */
+  static const unsigned int MAX_FRAGMENTED_DATAGRAM_SIZE;
+  static const unsigned int DATAGRAM_HEADER_SIZE;
+
+protected:
+  PlusStatus SendDatagram(const std::vector<char>& datagram);
+
+  /*! Platform socket handle, stored as a 64-bit integer to avoid including the platform socket headers */
+  long long SocketDescriptor;
+  std::vector<char> DestinationAddress;
+  std::vector<char> ReceiveBuffer;
+
+  unsigned int NextSequenceNumber;
+  bool FirstDatagramReceived;
+  unsigned int LastReceivedSequenceNumber;
+  unsigned long NumberOfDatagrams;
+  unsigned long NumberOfLostDatagrams;
+  unsigned long NumberOfStaleDatagrams;
+
+private:
+  IgtlUdpSocket(const IgtlUdpSocket&);
+  void operator=(const IgtlUdpSocket&);
+};
+
+#endif
@@ -0,0 +1,237 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusImageCompressor.h"
+
+#include <algorithm>
+#include <cstring>
+
+const unsigned int ImageCompressor::MAX_NUMBER_OF_THREADS = 16;
+
+namespace
+{
+  const size_t MAX_LITERAL_LENGTH = 0x80;
+  const size_t MAX_ZERO_RUN_LENGTH = 0x8000;
+  // Shorter zero runs are not worth interrupting a literal for
+  const size_t MIN_ZERO_RUN_LENGTH = 3;
+
+  //----------------------------------------------------------------------------
+  void AppendLiterals(const unsigned char* data, size_t size, std::vector<unsigned char>& output)
+  {
+    while (size > 0)
+    {
+      size_t length = std::min(size, MAX_LITERAL_LENGTH);
+      output.push_back(static_cast<unsigned char>(length - 1));
+      output.insert(output.end(), data, data + length);
+      data += length;
+      size -= length;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+ImageCompressor::ImageCompressor()
+  : NumberOfThreads(1)
+  , NumberOfUnfinishedJobs(0)
+  , Stop(false)
+{
+}
+
+//----------------------------------------------------------------------------
+ImageCompressor::~ImageCompressor()
+{
+  this->StopWorkers();
+}
+
+//----------------------------------------------------------------------------
+void ImageCompressor::SetNumberOfThreads(unsigned int numberOfThreads)
+{
+  numberOfThreads = std::max(1u, std::min(numberOfThreads, MAX_NUMBER_OF_THREADS));
+  std::lock_guard<std::mutex> compressLock(this->CompressMutex);
+  if (numberOfThreads == this->NumberOfThreads)
+  {
+    return;
+  }
+  this->StopWorkers();
+  this->NumberOfThreads = numberOfThreads;
+  this->StartWorkers();
+}
+
+//----------------------------------------------------------------------------
+unsigned int ImageCompressor::GetNumberOfThreads() const
+{
+  return this->NumberOfThreads;
+}
+
+//----------------------------------------------------------------------------
+void ImageCompressor::StartWorkers()
+{
+  // The calling thread compresses the first band
+  for (unsigned int i = 1; i < this->NumberOfThreads; ++i)
+  {
+    this->Workers.push_back(std::thread(&ImageCompressor::RunWorker, this));
+  }
+}
+
+//----------------------------------------------------------------------------
+void ImageCompressor::StopWorkers()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->Stop = true;
+    this->JobCondition.notify_all();
+  }
+  for (std::vector<std::thread>::iterator workerIt = this->Workers.begin(); workerIt != this->Workers.end(); ++workerIt)
+  {
+    workerIt->join();
+  }
+  this->Workers.clear();
+  this->Stop = false;
+}
+
+//----------------------------------------------------------------------------
+void ImageCompressor::RunWorker()
+{
+  std::unique_lock<std::mutex> lock(this->Mutex);
+  while (true)
+  {
+    this->JobCondition.wait(lock, [this]() { return this->Stop || !this->Jobs.empty(); });
+    if (this->Stop)
+    {
+      return;
+    }
+    Job job = this->Jobs.front();
+    this->Jobs.pop_front();
+
+    lock.unlock();
+    CompressBand(job.Data, job.Size, *job.Output);
+    lock.lock();
+
+    if (--this->NumberOfUnfinishedJobs == 0)
+    {
+      this->DoneCondition.notify_all();
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void ImageCompressor::Compress(const unsigned char* data, size_t size, size_t bandAlignment, std::vector<size_t>& bandSizes, std::vector<std::vector<unsigned char> >& compressedBands)
+{
+  std::lock_guard<std::mutex> compressLock(this->CompressMutex);
+
+  bandAlignment = std::max<size_t>(bandAlignment, 1);
+  size_t numberOfUnits = (size + bandAlignment - 1) / bandAlignment;
+  size_t numberOfBands = std::max<size_t>(1, std::min<size_t>(this->NumberOfThreads, numberOfUnits));
+  bandSizes.resize(numberOfBands);
+  compressedBands.resize(numberOfBands);
+
+  std::vector<Job> jobs(numberOfBands);
+  size_t offset = 0;
+  for (size_t band = 0; band < numberOfBands; ++band)
+  {
+    size_t bandEnd = std::min(size, (numberOfUnits * (band + 1) / numberOfBands) * bandAlignment);
+    jobs[band].Data = data + offset;
+    jobs[band].Size = bandEnd - offset;
+    jobs[band].Output = &compressedBands[band];
+    bandSizes[band] = bandEnd - offset;
+    offset = bandEnd;
+  }
+
+  if (numberOfBands > 1)
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->Jobs.insert(this->Jobs.end(), jobs.begin() + 1, jobs.end());
+    this->NumberOfUnfinishedJobs = static_cast<unsigned int>(numberOfBands - 1);
+    this->JobCondition.notify_all();
+  }
+
+  CompressBand(jobs[0].Data, jobs[0].Size, *jobs[0].Output);
+
+  if (numberOfBands > 1)
+  {
+    std::unique_lock<std::mutex> lock(this->Mutex);
+    this->DoneCondition.wait(lock, [this]() { return this->NumberOfUnfinishedJobs == 0; });
+  }
+}
+
+//----------------------------------------------------------------------------
+void ImageCompressor::CompressBand(const unsigned char* data, size_t size, std::vector<unsigned char>& output)
+{
+  output.clear();
+  output.reserve(size + size / MAX_LITERAL_LENGTH + 1);
+
+  size_t literalStart = 0;
+  size_t i = 0;
+  while (i < size)
+  {
+    if (data[i] != 0)
+    {
+      ++i;
+      continue;
+    }
+    size_t runEnd = i;
+    while (runEnd < size && data[runEnd] == 0 && runEnd - i < MAX_ZERO_RUN_LENGTH)
+    {
+      ++runEnd;
+    }
+    size_t runLength = runEnd - i;
+    if (runLength >= MIN_ZERO_RUN_LENGTH)
+    {
+      AppendLiterals(data + literalStart, i - literalStart, output);
+      output.push_back(static_cast<unsigned char>(0x80 | ((runLength - 1) >> 8)));
+      output.push_back(static_cast<unsigned char>((runLength - 1) & 0xFF));
+      literalStart = runEnd;
+    }
+    i = runEnd;
+  }
+  AppendLiterals(data + literalStart, size - literalStart, output);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus ImageCompressor::DecompressBand(const unsigned char* data, size_t size, unsigned char* output, size_t outputSize)
+{
+  const unsigned char* dataEnd = data + size;
+  unsigned char* outputEnd = output + outputSize;
+  while (data < dataEnd)
+  {
+    unsigned char token = *data++;
+    if (token & 0x80)
+    {
+      if (data >= dataEnd)
+      {
+        LOG_ERROR("Failed to decompress image data: incomplete zero run");
+        return PLUS_FAIL;
+      }
+      size_t runLength = ((static_cast<size_t>(token & 0x7F) << 8) | *data++) + 1;
+      if (runLength > static_cast<size_t>(outputEnd - output))
+      {
+        LOG_ERROR("Failed to decompress image data: decompressed data is larger than " << outputSize << " bytes");
+        return PLUS_FAIL;
+      }
+      memset(output, 0, runLength);
+      output += runLength;
+    }
+    else
+    {
+      size_t length = static_cast<size_t>(token) + 1;
+      if (length > static_cast<size_t>(dataEnd - data) || length > static_cast<size_t>(outputEnd - output))
+      {
+        LOG_ERROR("Failed to decompress image data: invalid literal length");
+        return PLUS_FAIL;
+      }
+      memcpy(output, data, length);
+      data += length;
+      output += length;
+    }
+  }
+  if (output != outputEnd)
+  {
+    LOG_ERROR("Failed to decompress image data: decompressed data is smaller than " << outputSize << " bytes");
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
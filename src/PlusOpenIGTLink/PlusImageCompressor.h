@@ -0,0 +1,95 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __ImageCompressor_h
+#define __ImageCompressor_h
+
+#include "vtkPlusOpenIGTLinkExport.h"
+
+#include "PlusConfigure.h"
+
+// STL includes
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*!
+  \class ImageCompressor
+  \brief Lossless compression of image scalars, split into bands that are compressed in parallel.
+
+  The codec is a zero run-length encoding, which is fast enough to compress the frames of several streams without
+  adding visible latency, and removes the large black regions of ultrasound images (e.g., outside the B-mode fan).
+  The compressed data is a sequence of tokens:
+  - 0xxxxxxx: literal, followed by x+1 bytes that are copied to the output
+  - 1xxxxxxx yyyyyyyy: run of ((x<<8)|y)+1 zero bytes
+
+  Images are split into NumberOfThreads bands. The first band is compressed on the calling thread,
+  the other bands on worker threads.
+
+  \ingroup PlusLibOpenIGTLink
+*/
+class vtkPlusOpenIGTLinkExport ImageCompressor
+{
+public:
+  ImageCompressor();
+  virtual ~ImageCompressor();
+
+  /*! Set the number of threads (and bands) that an image is compressed with, including the calling thread */
+  void SetNumberOfThreads(unsigned int numberOfThreads);
+  unsigned int GetNumberOfThreads() const;
+
+  /*!
+    Compress data of size bytes. The data is split into bands at multiples of bandAlignment bytes (e.g., the size of an image row).
+    The uncompressed size and the compressed data of each band is returned.
+  */
+  void Compress(const unsigned char* data, size_t size, size_t bandAlignment, std::vector<size_t>& bandSizes, std::vector<std::vector<unsigned char> >& compressedBands);
+
+  /*! Compress data of size bytes into output (its previous content is replaced) */
+  static void CompressBand(const unsigned char* data, size_t size, std::vector<unsigned char>& output);
+
+  /*! Decompress data of size bytes into output. Fails if the data is invalid or does not decompress into exactly outputSize bytes. */
+  static PlusStatus DecompressBand(const unsigned char* data, size_t size, unsigned char* output, size_t outputSize);
+
+  /*! Maximum number of compression threads */
+  static const unsigned int MAX_NUMBER_OF_THREADS;
+
+protected:
+  struct Job
+  {
+    const unsigned char* Data;
+    size_t Size;
+    std::vector<unsigned char>* Output;
+  };
+
+  /*! Worker thread function */
+  void RunWorker();
+  void StartWorkers();
+  void StopWorkers();
+
+  unsigned int NumberOfThreads;
+
+  /*! Only one image is compressed at a time */
+  std::mutex CompressMutex;
+  /*! Protects the job queue */
+  std::mutex Mutex;
+  /*! Notified when jobs are queued or the workers have to stop */
+  std::condition_variable JobCondition;
+  /*! Notified when a job is completed */
+  std::condition_variable DoneCondition;
+  std::deque<Job> Jobs;
+  /*! Number of queued and running jobs of the image that is being compressed */
+  unsigned int NumberOfUnfinishedJobs;
+  bool Stop;
+  std::vector<std::thread> Workers;
+
+private:
+  ImageCompressor(const ImageCompressor&);
+  void operator=(const ImageCompressor&);
+};
+
+#endif
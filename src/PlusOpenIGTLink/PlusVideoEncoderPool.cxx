@@ -0,0 +1,235 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusVideoEncoderPool.h"
+
+#include <sstream>
+
+const unsigned int VideoEncoderPool::MAX_NUMBER_OF_WAITING_FRAMES = 2;
+const unsigned int VideoEncoderPool::NUMBER_OF_KEPT_ENCODED_FRAMES = 8;
+const double VideoEncoderPool::ENCODER_IDLE_TIMEOUT_SEC = 10.0;
+
+//----------------------------------------------------------------------------
+bool VideoEncoderPool::EncodedFrame::IsKeyFrame() const
+{
+  return this->Frame != nullptr && this->Frame->GetFrameType() == vtkStreamingVolumeFrame::IFrame;
+}
+
+//----------------------------------------------------------------------------
+VideoEncoderPool::VideoEncoderPool()
+{
+}
+
+//----------------------------------------------------------------------------
+VideoEncoderPool::~VideoEncoderPool()
+{
+  std::vector<std::thread> threads;
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    for (std::map<std::string, std::shared_ptr<Encoder> >::iterator encoderIt = this->Encoders.begin(); encoderIt != this->Encoders.end(); ++encoderIt)
+    {
+      encoderIt->second->Stop = true;
+      encoderIt->second->Condition.notify_all();
+      threads.push_back(std::move(encoderIt->second->Thread));
+    }
+    this->Encoders.clear();
+  }
+  for (std::vector<std::thread>::iterator threadIt = threads.begin(); threadIt != threads.end(); ++threadIt)
+  {
+    threadIt->join();
+  }
+}
+
+//----------------------------------------------------------------------------
+std::string VideoEncoderPool::GetEncoderKey(const std::string& streamName, const std::string& codecFourCC, const std::map<std::string, std::string>& parameters)
+{
+  std::ostringstream key;
+  key << streamName << "|" << codecFourCC;
+  for (std::map<std::string, std::string>::const_iterator parameterIt = parameters.begin(); parameterIt != parameters.end(); ++parameterIt)
+  {
+    key << "|" << parameterIt->first << "=" << parameterIt->second;
+  }
+  return key.str();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus VideoEncoderPool::EncodeFrame(const std::string& encoderKey, igsioVideoFrame& frame, double timestamp, const std::string& deviceName,
+    const vtkMatrix4x4& imageToReferenceTransform, const std::string& codecFourCC, const std::map<std::string, std::string>& parameters)
+{
+  double currentTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  std::vector<std::thread> stoppedThreads;
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    std::shared_ptr<Encoder> encoder;
+    std::map<std::string, std::shared_ptr<Encoder> >::iterator encoderIt = this->Encoders.find(encoderKey);
+    if (encoderIt != this->Encoders.end())
+    {
+      encoder = encoderIt->second;
+    }
+    else
+    {
+      encoder = std::make_shared<Encoder>();
+      encoder->CodecFourCC = codecFourCC;
+      encoder->Parameters = parameters;
+      encoder->FrameConverter = vtkSmartPointer<vtkIGSIOFrameConverter>::New();
+      encoder->Thread = std::thread(&VideoEncoderPool::RunEncoder, this, encoder);
+      this->Encoders[encoderKey] = encoder;
+      LOG_DEBUG("Video encoder started: " << encoderKey);
+    }
+    encoder->LastUsedTime = currentTime;
+
+    if (timestamp != encoder->LastQueuedTimestamp)
+    {
+      WaitingFrame waitingFrame;
+      waitingFrame.Frame = std::make_shared<igsioVideoFrame>();
+      if (waitingFrame.Frame->DeepCopy(&frame) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to copy video frame for encoding");
+        return PLUS_FAIL;
+      }
+      waitingFrame.Timestamp = timestamp;
+      waitingFrame.DeviceName = deviceName;
+      waitingFrame.ImageToReferenceTransform = vtkSmartPointer<vtkMatrix4x4>::New();
+      waitingFrame.ImageToReferenceTransform->DeepCopy(&imageToReferenceTransform);
+
+      // The receivers only need the latest frames, so drop the oldest ones if the encoder is behind.
+      // Frames that are not encoded at all do not break the dependency between the encoded frames.
+      while (encoder->WaitingFrames.size() >= MAX_NUMBER_OF_WAITING_FRAMES)
+      {
+        encoder->WaitingFrames.pop_front();
+      }
+      encoder->WaitingFrames.push_back(waitingFrame);
+      encoder->LastQueuedTimestamp = timestamp;
+      encoder->Condition.notify_all();
+    }
+
+    stoppedThreads = this->StopIdleEncoders(currentTime);
+  }
+  for (std::vector<std::thread>::iterator threadIt = stoppedThreads.begin(); threadIt != stoppedThreads.end(); ++threadIt)
+  {
+    threadIt->join();
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void VideoEncoderPool::GetEncodedFrames(const std::string& encoderKey, unsigned long& lastFrameIndex, std::vector<EncodedFrame>& frames)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  std::map<std::string, std::shared_ptr<Encoder> >::iterator encoderIt = this->Encoders.find(encoderKey);
+  if (encoderIt == this->Encoders.end())
+  {
+    return;
+  }
+  std::shared_ptr<Encoder> encoder = encoderIt->second;
+  if (encoder->EncodedFrames.empty())
+  {
+    return;
+  }
+
+  bool continuous = (lastFrameIndex > 0 && encoder->EncodedFrames.front().Index <= lastFrameIndex + 1);
+  bool framesSkipped = false;
+  for (std::deque<EncodedFrame>::iterator frameIt = encoder->EncodedFrames.begin(); frameIt != encoder->EncodedFrames.end(); ++frameIt)
+  {
+    if (frameIt->Index <= lastFrameIndex)
+    {
+      continue;
+    }
+    if (!continuous)
+    {
+      if (!frameIt->IsKeyFrame())
+      {
+        framesSkipped = true;
+        continue;
+      }
+      continuous = true;
+    }
+    frames.push_back(*frameIt);
+    lastFrameIndex = frameIt->Index;
+  }
+
+  if (!continuous && framesSkipped)
+  {
+    // The receiver can only start decoding from a key frame
+    encoder->KeyFrameRequested = true;
+  }
+}
+
+//----------------------------------------------------------------------------
+void VideoEncoderPool::RequestKeyFrame(const std::string& encoderKey)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  std::map<std::string, std::shared_ptr<Encoder> >::iterator encoderIt = this->Encoders.find(encoderKey);
+  if (encoderIt != this->Encoders.end())
+  {
+    encoderIt->second->KeyFrameRequested = true;
+  }
+}
+
+//----------------------------------------------------------------------------
+void VideoEncoderPool::RunEncoder(std::shared_ptr<Encoder> encoder)
+{
+  std::unique_lock<std::mutex> lock(this->Mutex);
+  while (true)
+  {
+    encoder->Condition.wait(lock, [&encoder]() { return encoder->Stop || !encoder->WaitingFrames.empty(); });
+    if (encoder->Stop)
+    {
+      return;
+    }
+    WaitingFrame waitingFrame = encoder->WaitingFrames.front();
+    encoder->WaitingFrames.pop_front();
+    bool keyFrameRequested = encoder->KeyFrameRequested;
+    encoder->KeyFrameRequested = false;
+
+    // Encode without locking, so that frames can be queued and encoded frames can be retrieved meanwhile
+    lock.unlock();
+    if (keyFrameRequested)
+    {
+      encoder->FrameConverter->RequestKeyFrameOn();
+    }
+    vtkSmartPointer<vtkStreamingVolumeFrame> frame = encoder->FrameConverter->GetEncodedFrame(waitingFrame.Frame.get(), encoder->CodecFourCC, encoder->Parameters);
+    lock.lock();
+
+    if (!frame)
+    {
+      LOG_ERROR("Could not encode frame with codec " << encoder->CodecFourCC);
+      continue;
+    }
+    EncodedFrame encodedFrame;
+    encodedFrame.Index = ++encoder->LastFrameIndex;
+    encodedFrame.Timestamp = waitingFrame.Timestamp;
+    encodedFrame.DeviceName = waitingFrame.DeviceName;
+    encodedFrame.ImageToReferenceTransform = waitingFrame.ImageToReferenceTransform;
+    encodedFrame.Frame = frame;
+    encoder->EncodedFrames.push_back(encodedFrame);
+    while (encoder->EncodedFrames.size() > NUMBER_OF_KEPT_ENCODED_FRAMES)
+    {
+      encoder->EncodedFrames.pop_front();
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+std::vector<std::thread> VideoEncoderPool::StopIdleEncoders(double currentTime)
+{
+  std::vector<std::thread> threads;
+  for (std::map<std::string, std::shared_ptr<Encoder> >::iterator encoderIt = this->Encoders.begin(); encoderIt != this->Encoders.end();)
+  {
+    if (currentTime - encoderIt->second->LastUsedTime < ENCODER_IDLE_TIMEOUT_SEC)
+    {
+      ++encoderIt;
+      continue;
+    }
+    LOG_DEBUG("Video encoder stopped: " << encoderIt->first);
+    encoderIt->second->Stop = true;
+    encoderIt->second->Condition.notify_all();
+    threads.push_back(std::move(encoderIt->second->Thread));
+    encoderIt = this->Encoders.erase(encoderIt);
+  }
+  return threads;
+}
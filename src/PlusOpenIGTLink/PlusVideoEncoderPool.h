@@ -0,0 +1,136 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __VideoEncoderPool_h
+#define __VideoEncoderPool_h
+
+#include "vtkPlusOpenIGTLinkExport.h"
+
+#include "PlusConfigure.h"
+
+// IGSIO includes
+#include <igsioVideoFrame.h>
+#include <vtkIGSIOFrameConverter.h>
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkSmartPointer.h>
+
+// STL includes
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*!
+  \class VideoEncoderPool
+  \brief Encodes video frames on worker threads, one encoder for each stream and codec configuration.
+
+  Frames are queued for encoding and the caller continues without waiting for the encoder. The encoded frames are
+  kept for a few frames, so that they can be sent to all the clients that requested the same stream with the same
+  codec configuration, and each stream is encoded only once. As the encoding runs while the next frame is acquired,
+  an encoded frame is typically available one frame later than the frame that was queued.
+
+  Encoded frames depend on the previous ones, therefore a receiver has to get all the frames starting from a key frame.
+  GetEncodedFrames keeps track of this with the index of the last frame that was returned to the receiver.
+
+  \ingroup PlusLibOpenIGTLink
+*/
+class vtkPlusOpenIGTLinkExport VideoEncoderPool
+{
+public:
+  /*! Encoded frame with the information that is needed for sending it */
+  struct EncodedFrame
+  {
+    EncodedFrame() : Index(0), Timestamp(0) {}
+    /*! Sequence number of the frame in its encoder, starts from 1 */
+    unsigned long Index;
+    double Timestamp;
+    std::string DeviceName;
+    vtkSmartPointer<vtkMatrix4x4> ImageToReferenceTransform;
+    vtkSmartPointer<vtkStreamingVolumeFrame> Frame;
+    bool IsKeyFrame() const;
+  };
+
+  VideoEncoderPool();
+  virtual ~VideoEncoderPool();
+
+  /*! Get the identifier of the encoder of a stream with a codec configuration */
+  static std::string GetEncoderKey(const std::string& streamName, const std::string& codecFourCC, const std::map<std::string, std::string>& parameters);
+
+  /*!
+    Queue a frame for encoding. The encoder and its thread are created when the key is first used.
+    The frame is ignored if a frame with the same timestamp has already been queued (it was requested for another client).
+    If the encoder cannot keep up then the oldest frames that are waiting for encoding are dropped.
+  */
+  PlusStatus EncodeFrame(const std::string& encoderKey, igsioVideoFrame& frame, double timestamp, const std::string& deviceName,
+                         const vtkMatrix4x4& imageToReferenceTransform, const std::string& codecFourCC, const std::map<std::string, std::string>& parameters);
+
+  /*!
+    Append the encoded frames that follow the frame with index lastFrameIndex to frames, in encoding order, and update lastFrameIndex.
+    If frames are missing after lastFrameIndex (e.g., it is 0 for a new receiver) then frames are returned only from the next key frame,
+    which is requested from the encoder.
+  */
+  void GetEncodedFrames(const std::string& encoderKey, unsigned long& lastFrameIndex, std::vector<EncodedFrame>& frames);
+
+  /*! Make the encoder encode the next frame as a key frame */
+  void RequestKeyFrame(const std::string& encoderKey);
+
+  /*! Maximum number of frames waiting for encoding in an encoder */
+  static const unsigned int MAX_NUMBER_OF_WAITING_FRAMES;
+  /*! Number of recently encoded frames that are kept for the receivers */
+  static const unsigned int NUMBER_OF_KEPT_ENCODED_FRAMES;
+  /*! Encoders that have not received frames for this long are stopped */
+  static const double ENCODER_IDLE_TIMEOUT_SEC;
+
+protected:
+  struct WaitingFrame
+  {
+    std::shared_ptr<igsioVideoFrame> Frame;
+    double Timestamp;
+    std::string DeviceName;
+    vtkSmartPointer<vtkMatrix4x4> ImageToReferenceTransform;
+  };
+
+  struct Encoder
+  {
+    Encoder() : LastQueuedTimestamp(-1), LastUsedTime(0), LastFrameIndex(0), KeyFrameRequested(false), Stop(false) {}
+    std::string CodecFourCC;
+    std::map<std::string, std::string> Parameters;
+    /*! Only used by the encoder thread */
+    vtkSmartPointer<vtkIGSIOFrameConverter> FrameConverter;
+    std::deque<WaitingFrame> WaitingFrames;
+    std::deque<EncodedFrame> EncodedFrames;
+    double LastQueuedTimestamp;
+    double LastUsedTime;
+    unsigned long LastFrameIndex;
+    bool KeyFrameRequested;
+    bool Stop;
+    /*! Notified when a frame is queued or the encoder has to stop */
+    std::condition_variable Condition;
+    std::thread Thread;
+  };
+
+  /*! Encoder thread function */
+  void RunEncoder(std::shared_ptr<Encoder> encoder);
+
+  /*! Stop the encoders that have not been used recently. Mutex must be locked. The returned threads have to be joined after unlocking the mutex. */
+  std::vector<std::thread> StopIdleEncoders(double currentTime);
+
+  /*! Protects all the members of the encoders, except the frame converters */
+  std::mutex Mutex;
+  std::map<std::string, std::shared_ptr<Encoder> > Encoders;
+
+private:
+  VideoEncoderPool(const VideoEncoderPool&);
+  void operator=(const VideoEncoderPool&);
+};
+
+#endif
@@ -0,0 +1,160 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusIgtlCrc64Test.cxx
+  \brief Compares the CRC64 implementations of IgtlCrc64 to crc64() of OpenIGTLink.
+
+  Both the PCLMULQDQ (if supported by the CPU) and the slicing-by-8 implementations are tested, as well as the one
+  that is selected by IgtlCrc64::Compute. Inputs cover the empty input, the short lengths that only use the table,
+  lengths around the folding block sizes, unaligned start addresses, multi-megabyte buffers and computing the CRC
+  of a buffer in two parts.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusIgtlCrc64.h"
+
+#include <igtl_util.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+#include <string>
+#include <vector>
+
+namespace
+{
+  const igtl_uint64 INITIAL_CRCS[] = { 0, 0xFEDCBA9876543210ULL };
+  const int NUMBER_OF_INITIAL_CRCS = sizeof(INITIAL_CRCS) / sizeof(INITIAL_CRCS[0]);
+
+  //----------------------------------------------------------------------------
+  igtl_uint64 ComputeReference(const unsigned char* data, igtl_uint64 length, igtl_uint64 crc)
+  {
+    return length == 0 ? crc : crc64(const_cast<unsigned char*>(data), length, crc);
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Compute the CRC with the implementation, or with IgtlCrc64::Compute if implementation is NULL */
+  igtl_uint64 Compute(const IgtlCrc64::ImplementationType* implementation, const unsigned char* data, igtl_uint64 length, igtl_uint64 crc)
+  {
+    if (implementation == NULL)
+    {
+      return IgtlCrc64::Compute(data, length, crc);
+    }
+    igtl_uint64 result = 0;
+    IgtlCrc64::ComputeWithImplementation(*implementation, data, length, crc, result);
+    return result;
+  }
+
+  //----------------------------------------------------------------------------
+  int CheckCrc(const IgtlCrc64::ImplementationType* implementation, const std::string& implementationName, const std::vector<unsigned char>& buffer, size_t offset, igtl_uint64 length)
+  {
+    int numberOfErrors = 0;
+    for (int crcIndex = 0; crcIndex < NUMBER_OF_INITIAL_CRCS; ++crcIndex)
+    {
+      const unsigned char* data = buffer.empty() ? NULL : &buffer[offset];
+      igtl_uint64 expectedCrc = ComputeReference(data, length, INITIAL_CRCS[crcIndex]);
+      igtl_uint64 crc = Compute(implementation, data, length, INITIAL_CRCS[crcIndex]);
+      if (crc != expectedCrc)
+      {
+        LOG_ERROR(implementationName << " CRC64 of " << length << " bytes at offset " << offset
+                  << " with initial CRC " << INITIAL_CRCS[crcIndex] << " is " << crc << ", expected " << expectedCrc);
+        numberOfErrors++;
+      }
+    }
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestImplementation(const IgtlCrc64::ImplementationType* implementation, const std::string& implementationName, const std::vector<unsigned char>& buffer)
+  {
+    int numberOfErrors = 0;
+
+    // Empty input, with and without data
+    numberOfErrors += CheckCrc(implementation, implementationName, std::vector<unsigned char>(), 0, 0);
+    numberOfErrors += CheckCrc(implementation, implementationName, buffer, 0, 0);
+
+    // Short lengths and lengths around the 16 and 64 byte folding blocks, at aligned and unaligned start addresses
+    const igtl_uint64 lengths[] = { 16, 63, 64, 65, 127, 128, 129, 143, 144, 191, 192, 193, 255, 256, 257, 1000, 4096, 4103 };
+    for (size_t offset = 0; offset < 16; ++offset)
+    {
+      for (igtl_uint64 length = 1; length < 16; ++length)
+      {
+        numberOfErrors += CheckCrc(implementation, implementationName, buffer, offset, length);
+      }
+      for (size_t lengthIndex = 0; lengthIndex < sizeof(lengths) / sizeof(lengths[0]); ++lengthIndex)
+      {
+        numberOfErrors += CheckCrc(implementation, implementationName, buffer, offset, lengths[lengthIndex]);
+      }
+    }
+
+    // Multi-megabyte buffers
+    numberOfErrors += CheckCrc(implementation, implementationName, buffer, 0, buffer.size() - 16);
+    numberOfErrors += CheckCrc(implementation, implementationName, buffer, 3, buffer.size() - 16);
+
+    // The CRC of the first part is the initial CRC of the second part
+    const igtl_uint64 splitLength = 1000003;
+    igtl_uint64 crc = Compute(implementation, &buffer[0], splitLength, 0);
+    crc = Compute(implementation, &buffer[splitLength], buffer.size() - splitLength, crc);
+    if (crc != ComputeReference(&buffer[0], buffer.size(), 0))
+    {
+      LOG_ERROR(implementationName << " CRC64 computed in two parts does not match");
+      numberOfErrors++;
+    }
+
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  // Pseudo-random content, so that every byte affects the result differently
+  std::vector<unsigned char> buffer(5 * 1024 * 1024 + 16);
+  unsigned int state = 12345;
+  for (size_t i = 0; i < buffer.size(); ++i)
+  {
+    state = state * 1103515245u + 12345u;
+    buffer[i] = static_cast<unsigned char>(state >> 16);
+  }
+
+  int numberOfErrors = 0;
+
+  igtl_uint64 result = 0;
+  const IgtlCrc64::ImplementationType clmulImplementation = IgtlCrc64::IMPLEMENTATION_PCLMULQDQ;
+  if (IgtlCrc64::ComputeWithImplementation(clmulImplementation, &buffer[0], 1, 0, result) == PLUS_SUCCESS)
+  {
+    numberOfErrors += TestImplementation(&clmulImplementation, "PCLMULQDQ", buffer);
+  }
+  else
+  {
+    LOG_INFO("PCLMULQDQ is not supported by the CPU, only the fallback implementation is tested");
+  }
+  const IgtlCrc64::ImplementationType tableImplementation = IgtlCrc64::IMPLEMENTATION_SLICING_BY_8;
+  numberOfErrors += TestImplementation(&tableImplementation, "slicing-by-8", buffer);
+
+  LOG_INFO("Selected implementation: " << IgtlCrc64::GetImplementationName());
+  numberOfErrors += TestImplementation(NULL, std::string("selected ") + IgtlCrc64::GetImplementationName(), buffer);
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("PlusIgtlCrc64Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+  LOG_INFO("PlusIgtlCrc64Test completed successfully");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,215 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusIGTLMessageQueueTest.cxx
+  \brief Stress test of vtkPlusIGTLMessageQueue with multiple producers and consumers.
+
+  Producer threads push their own messages in order into a small queue (so that it is often full and wraps around
+  many times), consumer threads pull them with PullMessage and PullMessages. The test fails if a message is lost
+  or pulled more than once, or if a consumer receives the messages of a producer out of order.
+  Pulling from an empty queue must wait until the timeout expires.
+*/
+
+#include "PlusConfigure.h"
+#include "vtkPlusIGTLMessageQueue.h"
+
+#include <igtlStatusMessage.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  struct MessageId
+  {
+    int Producer;
+    int Index;
+  };
+
+  //----------------------------------------------------------------------------
+  void ProducerThread(vtkPlusIGTLMessageQueue* queue, const std::vector<igtl::MessageBase::Pointer>* messages)
+  {
+    for (std::vector<igtl::MessageBase::Pointer>::const_iterator it = messages->begin(); it != messages->end(); ++it)
+    {
+      while (queue->PushMessage(*it) != PLUS_SUCCESS)
+      {
+        // Queue is full
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void ConsumerThread(vtkPlusIGTLMessageQueue* queue, bool batchPull, const std::map<igtl::MessageBase*, MessageId>* messageIds,
+                      int numberOfProducers, std::atomic<int>* numberOfPulledMessages, int totalNumberOfMessages,
+                      std::vector<std::atomic<int> >* pullCounts, int* numberOfErrors)
+  {
+    std::vector<int> lastIndexOfProducer(numberOfProducers, -1);
+    std::vector<igtl::MessageBase*> pulledMessages;
+    while (numberOfPulledMessages->load() < totalNumberOfMessages)
+    {
+      pulledMessages.clear();
+      if (batchPull)
+      {
+        queue->PullMessages(pulledMessages, 16, 0.01);
+      }
+      else
+      {
+        igtl::MessageBase* message = queue->PullMessage(0.01);
+        if (message != NULL)
+        {
+          pulledMessages.push_back(message);
+        }
+      }
+      for (std::vector<igtl::MessageBase*>::iterator it = pulledMessages.begin(); it != pulledMessages.end(); ++it)
+      {
+        std::map<igtl::MessageBase*, MessageId>::const_iterator idIt = messageIds->find(*it);
+        if (idIt == messageIds->end())
+        {
+          LOG_ERROR("Pulled an unknown message");
+          (*numberOfErrors)++;
+          continue;
+        }
+        const MessageId& id = idIt->second;
+        if (id.Index <= lastIndexOfProducer[id.Producer])
+        {
+          LOG_ERROR("Message " << id.Index << " of producer " << id.Producer << " is pulled after message " << lastIndexOfProducer[id.Producer]);
+          (*numberOfErrors)++;
+        }
+        lastIndexOfProducer[id.Producer] = id.Index;
+        (*pullCounts)[id.Producer * (totalNumberOfMessages / numberOfProducers) + id.Index]++;
+        (*numberOfPulledMessages)++;
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int numberOfProducers(4);
+  int numberOfConsumers(4);
+  int numberOfMessagesPerProducer(50000);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--number-of-producers", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfProducers, "Number of producer threads (Default: 4).");
+  args.AddArgument("--number-of-consumers", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfConsumers, "Number of consumer threads (Default: 4).");
+  args.AddArgument("--number-of-messages", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfMessagesPerProducer, "Number of messages pushed by each producer (Default: 50000).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors = 0;
+  vtkSmartPointer<vtkPlusIGTLMessageQueue> queue = vtkSmartPointer<vtkPlusIGTLMessageQueue>::New();
+
+  // Pulling from an empty queue waits until the timeout
+  const double timeoutSec = 0.1;
+  std::chrono::steady_clock::time_point pullStartTime = std::chrono::steady_clock::now();
+  if (queue->PullMessage(timeoutSec) != NULL)
+  {
+    LOG_ERROR("Message is pulled from an empty queue");
+    numberOfErrors++;
+  }
+  double waitTimeSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - pullStartTime).count();
+  if (waitTimeSec < timeoutSec * 0.9)
+  {
+    LOG_ERROR("Pulling from an empty queue returned after " << waitTimeSec << " sec, before the " << timeoutSec << " sec timeout");
+    numberOfErrors++;
+  }
+
+  // Small queue, so that producers often find it full
+  queue->SetCapacity(64);
+
+  const int totalNumberOfMessages = numberOfProducers * numberOfMessagesPerProducer;
+  std::vector<std::vector<igtl::MessageBase::Pointer> > producerMessages(numberOfProducers);
+  std::map<igtl::MessageBase*, MessageId> messageIds;
+  for (int producer = 0; producer < numberOfProducers; ++producer)
+  {
+    for (int index = 0; index < numberOfMessagesPerProducer; ++index)
+    {
+      igtl::MessageBase::Pointer message = igtl::StatusMessage::New().GetPointer();
+      producerMessages[producer].push_back(message);
+      MessageId id = { producer, index };
+      messageIds[message.GetPointer()] = id;
+    }
+  }
+
+  std::vector<std::atomic<int> > pullCounts(totalNumberOfMessages);
+  for (int i = 0; i < totalNumberOfMessages; ++i)
+  {
+    pullCounts[i] = 0;
+  }
+  std::atomic<int> numberOfPulledMessages(0);
+  std::vector<int> consumerErrors(numberOfConsumers, 0);
+
+  std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int consumer = 0; consumer < numberOfConsumers; ++consumer)
+  {
+    threads.push_back(std::thread(ConsumerThread, queue.GetPointer(), consumer % 2 == 0, &messageIds, numberOfProducers,
+                                  &numberOfPulledMessages, totalNumberOfMessages, &pullCounts, &consumerErrors[consumer]));
+  }
+  for (int producer = 0; producer < numberOfProducers; ++producer)
+  {
+    threads.push_back(std::thread(ProducerThread, queue.GetPointer(), &producerMessages[producer]));
+  }
+  for (std::vector<std::thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+  {
+    it->join();
+  }
+  double elapsedSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+  LOG_INFO(totalNumberOfMessages << " messages passed through the queue in " << elapsedSec << " sec");
+
+  for (int consumer = 0; consumer < numberOfConsumers; ++consumer)
+  {
+    numberOfErrors += consumerErrors[consumer];
+  }
+  for (int i = 0; i < totalNumberOfMessages; ++i)
+  {
+    if (pullCounts[i] != 1)
+    {
+      LOG_ERROR("Message " << i % numberOfMessagesPerProducer << " of producer " << i / numberOfMessagesPerProducer << " is pulled " << pullCounts[i] << " times");
+      numberOfErrors++;
+    }
+  }
+  if (queue->GetSize() != 0)
+  {
+    LOG_ERROR("Queue is not empty after all messages are pulled: " << queue->GetSize() << " messages");
+    numberOfErrors++;
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("vtkPlusIGTLMessageQueueTest failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("vtkPlusIGTLMessageQueueTest completed successfully");
+  return EXIT_SUCCESS;
+}
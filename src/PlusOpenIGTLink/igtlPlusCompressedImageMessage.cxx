@@ -0,0 +1,304 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "igtlPlusCompressedImageMessage.h"
+#include "vtkPlusIgtlMessageFactory.h"
+
+#include <cstring>
+
+namespace
+{
+  // Uncompressed and compressed size of a band
+  const size_t BAND_SIZES_SIZE = 2 * sizeof(igtl_uint32);
+}
+
+namespace igtl
+{
+  //----------------------------------------------------------------------------
+  PlusCompressedImageMessage::PlusCompressedImageMessage()
+    : MessageBase()
+  {
+    this->m_SendMessageType = "CIMAGE";
+    memset(&this->m_ImageHeader, 0, sizeof(igtl_image_header));
+  }
+
+  //----------------------------------------------------------------------------
+  PlusCompressedImageMessage::~PlusCompressedImageMessage()
+  {
+  }
+
+  //----------------------------------------------------------------------------
+  igtl::MessageBase::Pointer PlusCompressedImageMessage::Clone()
+  {
+    igtl::MessageBase::Pointer clone;
+    {
+      vtkSmartPointer<vtkPlusIgtlMessageFactory> factory = vtkSmartPointer<vtkPlusIgtlMessageFactory>::New();
+      clone = dynamic_cast<igtl::MessageBase*>(factory->CreateSendMessage(this->GetMessageType(), this->GetHeaderVersion()).GetPointer());
+    }
+
+    igtl::PlusCompressedImageMessage::Pointer msg = dynamic_cast<igtl::PlusCompressedImageMessage*>(clone.GetPointer());
+
+    int bodySize = this->m_MessageSize - IGTL_HEADER_SIZE;
+    msg->InitBuffer();
+    msg->CopyHeader(this);
+    msg->AllocateBuffer(bodySize);
+    if (bodySize > 0)
+    {
+      msg->CopyBody(this);
+    }
+
+    return clone;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus PlusCompressedImageMessage::SetImageMessage(igtl::ImageMessage* imageMessage, ImageCompressor& compressor)
+  {
+    if (imageMessage == NULL || imageMessage->GetScalarPointer() == NULL)
+    {
+      LOG_ERROR("Failed to set compressed image message - image message has no image data");
+      return PLUS_FAIL;
+    }
+
+    int size[3] = { 0 };
+    int subvolumeSize[3] = { 0 };
+    int subvolumeOffset[3] = { 0 };
+    float spacing[3] = { 0 };
+    float origin[3] = { 0 };
+    float normals[3][3] = { { 0 } };
+    imageMessage->GetDimensions(size);
+    imageMessage->GetSubVolume(subvolumeSize, subvolumeOffset);
+    imageMessage->GetSpacing(spacing);
+    imageMessage->GetOrigin(origin);
+    imageMessage->GetNormals(normals[0], normals[1], normals[2]);
+
+    this->m_ImageHeader.header_version = IGTL_IMAGE_HEADER_VERSION;
+    this->m_ImageHeader.num_components = static_cast<igtl_uint8>(imageMessage->GetNumComponents());
+    this->m_ImageHeader.scalar_type = static_cast<igtl_uint8>(imageMessage->GetScalarType());
+    this->m_ImageHeader.endian = static_cast<igtl_uint8>(imageMessage->GetEndian());
+    this->m_ImageHeader.coord = static_cast<igtl_uint8>(imageMessage->GetCoordinateSystem());
+    for (int i = 0; i < 3; ++i)
+    {
+      this->m_ImageHeader.size[i] = static_cast<igtl_uint16>(size[i]);
+      this->m_ImageHeader.subvol_size[i] = static_cast<igtl_uint16>(subvolumeSize[i]);
+      this->m_ImageHeader.subvol_offset[i] = static_cast<igtl_uint16>(subvolumeOffset[i]);
+    }
+    igtl_image_set_matrix(spacing, origin, normals[0], normals[1], normals[2], &this->m_ImageHeader);
+    igtl_image_convert_byte_order(&this->m_ImageHeader);
+
+    size_t rowSize = static_cast<size_t>(subvolumeSize[0]) * imageMessage->GetNumComponents() * imageMessage->GetScalarSize();
+    compressor.Compress(static_cast<const unsigned char*>(imageMessage->GetScalarPointer()), imageMessage->GetSubVolumeImageSize(), rowSize,
+                        this->m_BandSizes, this->m_CompressedBands);
+    this->m_CompressionHeader.m_Codec = CODEC_ZERO_RUN_LENGTH;
+    this->m_CompressionHeader.m_NumberOfBands = static_cast<igtl_uint16>(this->m_CompressedBands.size());
+
+    this->SetDeviceName(imageMessage->GetDeviceName());
+    igtl::TimeStamp::Pointer timestamp = igtl::TimeStamp::New();
+    imageMessage->GetTimeStamp(timestamp);
+    this->SetTimeStamp(timestamp);
+
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus PlusCompressedImageMessage::GetImageMessage(igtl::ImageMessage* imageMessage)
+  {
+    if (imageMessage == NULL)
+    {
+      LOG_ERROR("Failed to get image message from compressed image message - image message is NULL");
+      return PLUS_FAIL;
+    }
+    if (this->m_CompressionHeader.m_Codec != CODEC_ZERO_RUN_LENGTH)
+    {
+      LOG_ERROR("Failed to get image message from compressed image message - unknown compression method: " << this->m_CompressionHeader.m_Codec);
+      return PLUS_FAIL;
+    }
+
+    igtl_image_header imageHeader = this->m_ImageHeader;
+    igtl_image_convert_byte_order(&imageHeader);
+
+    int size[3] = { imageHeader.size[0], imageHeader.size[1], imageHeader.size[2] };
+    int subvolumeSize[3] = { imageHeader.subvol_size[0], imageHeader.subvol_size[1], imageHeader.subvol_size[2] };
+    int subvolumeOffset[3] = { imageHeader.subvol_offset[0], imageHeader.subvol_offset[1], imageHeader.subvol_offset[2] };
+    float spacing[3] = { 0 };
+    float origin[3] = { 0 };
+    float normals[3][3] = { { 0 } };
+    igtl_image_get_matrix(spacing, origin, normals[0], normals[1], normals[2], &imageHeader);
+
+    imageMessage->SetDimensions(size);
+    imageMessage->SetSubVolume(subvolumeSize, subvolumeOffset);
+    imageMessage->SetSpacing(spacing);
+    imageMessage->SetOrigin(origin);
+    imageMessage->SetNormals(normals[0], normals[1], normals[2]);
+    imageMessage->SetNumComponents(imageHeader.num_components);
+    imageMessage->SetScalarType(imageHeader.scalar_type);
+    imageMessage->SetEndian(imageHeader.endian);
+    imageMessage->SetCoordinateSystem(imageHeader.coord);
+    imageMessage->SetDeviceName(this->GetDeviceName());
+    igtl::TimeStamp::Pointer timestamp = igtl::TimeStamp::New();
+    this->GetTimeStamp(timestamp);
+    imageMessage->SetTimeStamp(timestamp);
+    imageMessage->AllocateScalars();
+
+    if (this->GetUncompressedImageSize() != static_cast<size_t>(imageMessage->GetSubVolumeImageSize()))
+    {
+      LOG_ERROR("Failed to get image message from compressed image message - image data size is " << this->GetUncompressedImageSize()
+                << " bytes, expected " << imageMessage->GetSubVolumeImageSize() << " bytes");
+      return PLUS_FAIL;
+    }
+    unsigned char* scalars = static_cast<unsigned char*>(imageMessage->GetScalarPointer());
+    for (size_t band = 0; band < this->m_CompressedBands.size(); ++band)
+    {
+      if (ImageCompressor::DecompressBand(this->m_CompressedBands[band].data(), this->m_CompressedBands[band].size(), scalars, this->m_BandSizes[band]) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to get image message from compressed image message - band " << band << " cannot be decompressed");
+        return PLUS_FAIL;
+      }
+      scalars += this->m_BandSizes[band];
+    }
+
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  size_t PlusCompressedImageMessage::GetUncompressedImageSize() const
+  {
+    size_t imageSize = 0;
+    for (std::vector<size_t>::const_iterator bandSizeIt = this->m_BandSizes.begin(); bandSizeIt != this->m_BandSizes.end(); ++bandSizeIt)
+    {
+      imageSize += *bandSizeIt;
+    }
+    return imageSize;
+  }
+
+  //----------------------------------------------------------------------------
+  size_t PlusCompressedImageMessage::GetCompressedImageSize() const
+  {
+    size_t imageSize = 0;
+    for (std::vector<std::vector<unsigned char> >::const_iterator bandIt = this->m_CompressedBands.begin(); bandIt != this->m_CompressedBands.end(); ++bandIt)
+    {
+      imageSize += bandIt->size();
+    }
+    return imageSize;
+  }
+
+  //----------------------------------------------------------------------------
+  int PlusCompressedImageMessage::CalculateContentBufferSize()
+  {
+    return static_cast<int>(IGTL_IMAGE_HEADER_SIZE
+                            + this->m_CompressionHeader.GetMessageHeaderSize()
+                            + this->m_CompressedBands.size() * BAND_SIZES_SIZE
+                            + this->GetCompressedImageSize());
+  }
+
+  //----------------------------------------------------------------------------
+  int PlusCompressedImageMessage::PackContent()
+  {
+    AllocateBuffer();
+
+    // Copy image header, it is already in network byte order
+    unsigned char* content = this->m_Content;
+    memcpy(content, &this->m_ImageHeader, IGTL_IMAGE_HEADER_SIZE);
+    content += IGTL_IMAGE_HEADER_SIZE;
+
+    // Copy compression header
+    CompressionHeader* header = (CompressionHeader*)content;
+    header->m_Codec = this->m_CompressionHeader.m_Codec;
+    header->m_NumberOfBands = this->m_CompressionHeader.m_NumberOfBands;
+    header->ConvertEndianness();
+    content += this->m_CompressionHeader.GetMessageHeaderSize();
+
+    // Copy band sizes
+    for (size_t band = 0; band < this->m_CompressedBands.size(); ++band)
+    {
+      igtl_uint32 bandSizes[2] = { static_cast<igtl_uint32>(this->m_BandSizes[band]), static_cast<igtl_uint32>(this->m_CompressedBands[band].size()) };
+      if (igtl_is_little_endian())
+      {
+        bandSizes[0] = BYTE_SWAP_INT32(bandSizes[0]);
+        bandSizes[1] = BYTE_SWAP_INT32(bandSizes[1]);
+      }
+      memcpy(content, bandSizes, BAND_SIZES_SIZE);
+      content += BAND_SIZES_SIZE;
+    }
+
+    // Copy compressed image data
+    for (size_t band = 0; band < this->m_CompressedBands.size(); ++band)
+    {
+      if (!this->m_CompressedBands[band].empty())
+      {
+        memcpy(content, this->m_CompressedBands[band].data(), this->m_CompressedBands[band].size());
+        content += this->m_CompressedBands[band].size();
+      }
+    }
+
+    return 1;
+  }
+
+  //----------------------------------------------------------------------------
+  int PlusCompressedImageMessage::UnpackContent()
+  {
+    size_t contentSize = static_cast<size_t>(this->CalculateReceiveContentSize());
+    size_t headerSize = IGTL_IMAGE_HEADER_SIZE + this->m_CompressionHeader.GetMessageHeaderSize();
+    if (contentSize < headerSize)
+    {
+      LOG_ERROR("Compressed image message is too short: " << contentSize << " bytes");
+      return 0;
+    }
+
+    // Copy image header, it is kept in network byte order
+    const unsigned char* content = this->m_Content;
+    memcpy(&this->m_ImageHeader, content, IGTL_IMAGE_HEADER_SIZE);
+    content += IGTL_IMAGE_HEADER_SIZE;
+
+    // Copy compression header
+    CompressionHeader* header = (CompressionHeader*)content;
+    header->ConvertEndianness();
+    this->m_CompressionHeader.m_Codec = header->m_Codec;
+    this->m_CompressionHeader.m_NumberOfBands = header->m_NumberOfBands;
+    content += this->m_CompressionHeader.GetMessageHeaderSize();
+
+    size_t numberOfBands = this->m_CompressionHeader.m_NumberOfBands;
+    if (contentSize < headerSize + numberOfBands * BAND_SIZES_SIZE)
+    {
+      LOG_ERROR("Compressed image message is too short for " << numberOfBands << " bands: " << contentSize << " bytes");
+      return 0;
+    }
+
+    // Copy band sizes
+    this->m_BandSizes.resize(numberOfBands);
+    this->m_CompressedBands.resize(numberOfBands);
+    std::vector<size_t> compressedBandSizes(numberOfBands);
+    size_t compressedImageSize = 0;
+    for (size_t band = 0; band < numberOfBands; ++band)
+    {
+      igtl_uint32 bandSizes[2] = { 0 };
+      memcpy(bandSizes, content, BAND_SIZES_SIZE);
+      if (igtl_is_little_endian())
+      {
+        bandSizes[0] = BYTE_SWAP_INT32(bandSizes[0]);
+        bandSizes[1] = BYTE_SWAP_INT32(bandSizes[1]);
+      }
+      this->m_BandSizes[band] = bandSizes[0];
+      compressedBandSizes[band] = bandSizes[1];
+      compressedImageSize += bandSizes[1];
+      content += BAND_SIZES_SIZE;
+    }
+    if (contentSize < headerSize + numberOfBands * BAND_SIZES_SIZE + compressedImageSize)
+    {
+      LOG_ERROR("Compressed image message is too short for " << compressedImageSize << " bytes of compressed image data: " << contentSize << " bytes");
+      return 0;
+    }
+
+    // Copy compressed image data
+    for (size_t band = 0; band < numberOfBands; ++band)
+    {
+      this->m_CompressedBands[band].assign(content, content + compressedBandSizes[band]);
+      content += compressedBandSizes[band];
+    }
+
+    return 1;
+  }
+}
@@ -0,0 +1,115 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __igtlPlusCompressedImageMessage_h
+#define __igtlPlusCompressedImageMessage_h
+
+#include "vtkPlusOpenIGTLinkExport.h"
+
+#include "PlusConfigure.h"
+#include "PlusImageCompressor.h"
+#include "igtl_image.h"
+#include "igtl_types.h"
+#include "igtl_util.h"
+#include "igtlImageMessage.h"
+#include "igtlMessageBase.h"
+#include "igtlObject.h"
+#include <vector>
+
+namespace igtl
+{
+  // This command prevents 4-byte alignment in the struct
+#pragma pack(1)     /* For 1-byte boundary in memory */
+
+  /*!
+    \class PlusCompressedImageMessage
+    \brief IGTL message helper class for losslessly compressed image messages (CIMAGE)
+
+    The message contains the image header of an IMAGE message (size, scalar type, geometry) followed by the
+    image scalars compressed by ImageCompressor. The scalars are compressed in bands, the size of each band
+    is stored in the message. Clients that support this message type can request it instead of IMAGE
+    to reduce the network bandwidth.
+
+    \ingroup PlusLibOpenIGTLink
+  */
+  class vtkPlusOpenIGTLinkExport PlusCompressedImageMessage: public MessageBase
+  {
+  public:
+    igtlTypeMacro(igtl::PlusCompressedImageMessage, igtl::MessageBase);
+    igtlNewMacro(igtl::PlusCompressedImageMessage);
+
+  public:
+    /*! Override clone so that we use the plus igtl factory */
+    virtual igtl::MessageBase::Pointer Clone();
+
+    /*! Set the image header, device name and timestamp from a packed image message and compress its image scalars */
+    PlusStatus SetImageMessage(igtl::ImageMessage* imageMessage, ImageCompressor& compressor);
+
+    /*! Decompress the image into an image message and set its image header, device name and timestamp */
+    PlusStatus GetImageMessage(igtl::ImageMessage* imageMessage);
+
+    /*! Size of the uncompressed image scalars, in bytes */
+    size_t GetUncompressedImageSize() const;
+
+    /*! Size of the compressed image scalars, in bytes */
+    size_t GetCompressedImageSize() const;
+
+  protected:
+    enum
+    {
+      CODEC_ZERO_RUN_LENGTH = 1
+    };
+
+    class CompressionHeader
+    {
+    public:
+      CompressionHeader()
+        : m_Codec(CODEC_ZERO_RUN_LENGTH)
+        , m_NumberOfBands(0)
+      {
+      }
+
+      size_t GetMessageHeaderSize()
+      {
+        size_t headersize = 0;
+        headersize += sizeof(igtl_uint16);        // m_Codec
+        headersize += sizeof(igtl_uint16);        // m_NumberOfBands
+        return headersize;
+      }
+
+      void ConvertEndianness()
+      {
+        if (igtl_is_little_endian())
+        {
+          m_Codec = BYTE_SWAP_INT16(m_Codec);
+          m_NumberOfBands = BYTE_SWAP_INT16(m_NumberOfBands);
+        }
+      }
+
+      igtl_uint16     m_Codec;                  /* compression method */
+      igtl_uint16     m_NumberOfBands;          /* number of separately compressed bands */
+    };
+
+    virtual int  CalculateContentBufferSize();
+    virtual int  PackContent();
+    virtual int  UnpackContent();
+
+    PlusCompressedImageMessage();
+    ~PlusCompressedImageMessage();
+
+    /*! Image header of the IMAGE message, in network byte order */
+    igtl_image_header m_ImageHeader;
+    CompressionHeader m_CompressionHeader;
+    /*! Uncompressed size of each band */
+    std::vector<size_t> m_BandSizes;
+    std::vector<std::vector<unsigned char> > m_CompressedBands;
+  };
+
+#pragma pack()
+
+} // namespace igtl
+
+#endif
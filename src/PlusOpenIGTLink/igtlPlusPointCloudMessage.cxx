@@ -0,0 +1,158 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "igtlPlusPointCloudMessage.h"
+#include "igtl_polydata.h"
+#include "igtl_util.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  igtl_uint32 ToNetworkByteOrder(igtl_uint32 value)
+  {
+    return igtl_is_little_endian() ? BYTE_SWAP_INT32(value) : value;
+  }
+
+  //----------------------------------------------------------------------------
+  igtl_float32 ToNetworkByteOrder(igtl_float32 value)
+  {
+    if (!igtl_is_little_endian())
+    {
+      return value;
+    }
+    igtl_uint32 bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    bits = BYTE_SWAP_INT32(bits);
+    memcpy(&value, &bits, sizeof(bits));
+    return value;
+  }
+}
+
+namespace igtl
+{
+  //----------------------------------------------------------------------------
+  PlusPointCloudMessage::PlusPointCloudMessage()
+    : MessageBase()
+  {
+    this->m_SendMessageType = "POLYDATA";
+  }
+
+  //----------------------------------------------------------------------------
+  PlusPointCloudMessage::~PlusPointCloudMessage()
+  {
+  }
+
+  //----------------------------------------------------------------------------
+  igtl::MessageBase::Pointer PlusPointCloudMessage::Clone()
+  {
+    igtl::PlusPointCloudMessage::Pointer msg = igtl::PlusPointCloudMessage::New();
+    msg->SetHeaderVersion(this->GetHeaderVersion());
+
+    int bodySize = this->m_MessageSize - IGTL_HEADER_SIZE;
+    msg->InitBuffer();
+    msg->CopyHeader(this);
+    msg->AllocateBuffer(bodySize);
+    if (bodySize > 0)
+    {
+      msg->CopyBody(this);
+    }
+    msg->m_Points = this->m_Points;
+
+    return msg.GetPointer();
+  }
+
+  //----------------------------------------------------------------------------
+  void PlusPointCloudMessage::SetPoints(const float* points, unsigned int numberOfPoints, const double pointToDeviceMatrix[16]/*=NULL*/)
+  {
+    this->m_Points.resize(static_cast<size_t>(numberOfPoints) * 3);
+    igtl_float32* outputPoint = this->m_Points.data();
+    for (const float* point = points; point != points + static_cast<size_t>(numberOfPoints) * 3; point += 3)
+    {
+      if (std::isnan(point[0]) || std::isnan(point[1]) || std::isnan(point[2]))
+      {
+        continue;
+      }
+      if (pointToDeviceMatrix == NULL)
+      {
+        outputPoint[0] = ToNetworkByteOrder(point[0]);
+        outputPoint[1] = ToNetworkByteOrder(point[1]);
+        outputPoint[2] = ToNetworkByteOrder(point[2]);
+      }
+      else
+      {
+        for (int i = 0; i < 3; ++i)
+        {
+          const double* row = pointToDeviceMatrix + 4 * i;
+          outputPoint[i] = ToNetworkByteOrder(static_cast<igtl_float32>(row[0] * point[0] + row[1] * point[1] + row[2] * point[2] + row[3]));
+        }
+      }
+      outputPoint += 3;
+    }
+    this->m_Points.resize(outputPoint - this->m_Points.data());
+  }
+
+  //----------------------------------------------------------------------------
+  unsigned int PlusPointCloudMessage::GetNumberOfPoints() const
+  {
+    return static_cast<unsigned int>(this->m_Points.size() / 3);
+  }
+
+  //----------------------------------------------------------------------------
+  int PlusPointCloudMessage::CalculateContentBufferSize()
+  {
+    // Header, points, and a single poly-vertex cell (number of indices followed by the indices)
+    const size_t numberOfPoints = this->GetNumberOfPoints();
+    const size_t verticesSize = (numberOfPoints > 0 ? (numberOfPoints + 1) * sizeof(igtl_uint32) : 0);
+    return static_cast<int>(sizeof(igtl_polydata_header) + this->m_Points.size() * sizeof(igtl_float32) + verticesSize);
+  }
+
+  //----------------------------------------------------------------------------
+  int PlusPointCloudMessage::PackContent()
+  {
+    AllocateBuffer();
+
+    const igtl_uint32 numberOfPoints = this->GetNumberOfPoints();
+    unsigned char* content = this->m_Content;
+
+    igtl_polydata_header header;
+    memset(&header, 0, sizeof(header));
+    header.npoints = ToNetworkByteOrder(numberOfPoints);
+    if (numberOfPoints > 0)
+    {
+      header.nvertices = ToNetworkByteOrder(static_cast<igtl_uint32>(1));
+      header.size_vertices = ToNetworkByteOrder(static_cast<igtl_uint32>((numberOfPoints + 1) * sizeof(igtl_uint32)));
+    }
+    memcpy(content, &header, sizeof(header));
+    content += sizeof(header);
+
+    // Points are already in network byte order
+    if (numberOfPoints > 0)
+    {
+      memcpy(content, this->m_Points.data(), this->m_Points.size() * sizeof(igtl_float32));
+      content += this->m_Points.size() * sizeof(igtl_float32);
+
+      igtl_uint32* vertexCell = reinterpret_cast<igtl_uint32*>(content);
+      vertexCell[0] = ToNetworkByteOrder(numberOfPoints);
+      for (igtl_uint32 pointIndex = 0; pointIndex < numberOfPoints; ++pointIndex)
+      {
+        vertexCell[pointIndex + 1] = ToNetworkByteOrder(pointIndex);
+      }
+    }
+
+    return 1;
+  }
+
+  //----------------------------------------------------------------------------
+  int PlusPointCloudMessage::UnpackContent()
+  {
+    LOG_ERROR("Point cloud messages cannot be unpacked, POLYDATA messages are received as igtl::PolyDataMessage");
+    return 0;
+  }
+}
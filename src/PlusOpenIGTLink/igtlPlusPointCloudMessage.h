@@ -0,0 +1,66 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __igtlPlusPointCloudMessage_h
+#define __igtlPlusPointCloudMessage_h
+
+#include "vtkPlusOpenIGTLinkExport.h"
+
+#include "PlusConfigure.h"
+#include "igtl_types.h"
+#include "igtlMessageBase.h"
+#include "igtlObject.h"
+#include <vector>
+
+namespace igtl
+{
+  /*!
+    \class PlusPointCloudMessage
+    \brief IGTL message helper class for sending point clouds as POLYDATA messages
+
+    The points are written directly into the message body in the POLYDATA format, with a single poly-vertex cell
+    and without attributes, so that no intermediate polydata objects are built for each frame (igtl::PolyDataMessage
+    stores each point separately). Receivers read the message as a standard POLYDATA message.
+    The message can only be sent, received POLYDATA messages are created as igtl::PolyDataMessage by the factory.
+
+    \ingroup PlusLibOpenIGTLink
+  */
+  class vtkPlusOpenIGTLinkExport PlusPointCloudMessage: public MessageBase
+  {
+  public:
+    igtlTypeMacro(igtl::PlusPointCloudMessage, igtl::MessageBase);
+    igtlNewMacro(igtl::PlusPointCloudMessage);
+
+  public:
+    /*! Override clone, the factory would create a standard POLYDATA message */
+    virtual igtl::MessageBase::Pointer Clone();
+
+    /*!
+      Set the points of the message. Points that have NaN coordinates are skipped.
+      \param points Point coordinates (x0, y0, z0, x1, y1, z1, ...)
+      \param numberOfPoints Number of points, including the skipped ones
+      \param pointToDeviceMatrix If not NULL then the points are transformed by this matrix (row-major 4x4)
+    */
+    void SetPoints(const float* points, unsigned int numberOfPoints, const double pointToDeviceMatrix[16] = NULL);
+
+    /*! Number of points in the message (without the skipped points) */
+    unsigned int GetNumberOfPoints() const;
+
+  protected:
+    virtual int  CalculateContentBufferSize();
+    virtual int  PackContent();
+    virtual int  UnpackContent();
+
+    PlusPointCloudMessage();
+    ~PlusPointCloudMessage();
+
+    /*! Point coordinates in network byte order, ready to be copied into the message body */
+    std::vector<igtl_float32> m_Points;
+  };
+
+} // namespace igtl
+
+#endif
@@ -5,16 +5,144 @@ See License.txt for details.
 =========================================================Plus=header=end*/
 
 #include "PlusConfigure.h"
+#include "PlusIgtlMessageBodyReceiver.h"
 #include "igtlPlusTrackedFrameMessage.h"
 #include "vtkImageData.h"
 #include "vtkMatrix4x4.h"
 #include "vtkPlusIgtlMessageFactory.h"
 
+#include <set>
+#include <vector>
+
+namespace
+{
+  /*!
+    Binary frame field data starts with this marker, so that it can be distinguished from XML data.
+    It is followed by the encoding version (uint16), the timestamp (float64), the number of fields (uint32) and
+    for each field the name length (uint16), name, value length (uint32) and value. Numbers are in network byte order.
+  */
+  const char BINARY_FRAME_FIELD_MARKER[4] = { '\0', 'P', 'T', 'F' };
+
+  //----------------------------------------------------------------------------
+  void AppendUInt16(std::string& data, igtl_uint16 value)
+  {
+    if (igtl_is_little_endian())
+    {
+      value = BYTE_SWAP_INT16(value);
+    }
+    data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  //----------------------------------------------------------------------------
+  void AppendUInt32(std::string& data, igtl_uint32 value)
+  {
+    if (igtl_is_little_endian())
+    {
+      value = BYTE_SWAP_INT32(value);
+    }
+    data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  //----------------------------------------------------------------------------
+  void AppendFloat64(std::string& data, igtl_float64 value)
+  {
+    igtl_uint64 bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    if (igtl_is_little_endian())
+    {
+      bits = BYTE_SWAP_INT64(bits);
+    }
+    data.append(reinterpret_cast<const char*>(&bits), sizeof(bits));
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Reads numbers and strings from binary frame field data, fails if the data is shorter than expected */
+  class BinaryFrameFieldReader
+  {
+  public:
+    BinaryFrameFieldReader(const char* data, size_t dataSize)
+      : Data(data)
+      , Remaining(dataSize)
+    {
+    }
+
+    bool Read(void* value, size_t size)
+    {
+      if (size > this->Remaining)
+      {
+        return false;
+      }
+      memcpy(value, this->Data, size);
+      this->Data += size;
+      this->Remaining -= size;
+      return true;
+    }
+
+    bool ReadUInt16(igtl_uint16& value)
+    {
+      if (!this->Read(&value, sizeof(value)))
+      {
+        return false;
+      }
+      if (igtl_is_little_endian())
+      {
+        value = BYTE_SWAP_INT16(value);
+      }
+      return true;
+    }
+
+    bool ReadUInt32(igtl_uint32& value)
+    {
+      if (!this->Read(&value, sizeof(value)))
+      {
+        return false;
+      }
+      if (igtl_is_little_endian())
+      {
+        value = BYTE_SWAP_INT32(value);
+      }
+      return true;
+    }
+
+    bool ReadFloat64(igtl_float64& value)
+    {
+      igtl_uint64 bits = 0;
+      if (!this->Read(&bits, sizeof(bits)))
+      {
+        return false;
+      }
+      if (igtl_is_little_endian())
+      {
+        bits = BYTE_SWAP_INT64(bits);
+      }
+      memcpy(&value, &bits, sizeof(value));
+      return true;
+    }
+
+    bool ReadString(std::string& value, size_t length)
+    {
+      if (length > this->Remaining)
+      {
+        return false;
+      }
+      value.assign(this->Data, length);
+      this->Data += length;
+      this->Remaining -= length;
+      return true;
+    }
+
+  protected:
+    const char* Data;
+    size_t Remaining;
+  };
+}
+
 namespace igtl
 {
   //----------------------------------------------------------------------------
   PlusTrackedFrameMessage::PlusTrackedFrameMessage()
     : MessageBase()
+    , m_FrameFieldEncoding(FRAME_FIELD_ENCODING_XML)
   {
     this->m_SendMessageType = "TRACKEDFRAME";
   }
@@ -52,10 +180,20 @@ namespace igtl
   {
     this->m_TrackedFrame = trackedFrame;
 
-    if (this->m_TrackedFrame.GetTrackedFrameInXmlData(this->m_TrackedFrameXmlData, requestedTransforms) != PLUS_SUCCESS)
+    // Clients that use header version 1 may not be able to decode anything else than XML
+    if (this->GetHeaderVersion() >= IGTL_HEADER_VERSION_2)
     {
-      LOG_ERROR("Failed to pack Plus TrackedFrame message - unable to get tracked frame in xml data.");
-      return PLUS_FAIL;
+      this->m_FrameFieldEncoding = FRAME_FIELD_ENCODING_BINARY;
+      this->EncodeBinaryFrameFields(requestedTransforms);
+    }
+    else
+    {
+      this->m_FrameFieldEncoding = FRAME_FIELD_ENCODING_XML;
+      if (this->m_TrackedFrame.GetTrackedFrameInXmlData(this->m_TrackedFrameXmlData, requestedTransforms) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to pack Plus TrackedFrame message - unable to get tracked frame in xml data.");
+        return PLUS_FAIL;
+      }
     }
 
     FrameSizeType frameSize = this->m_TrackedFrame.GetFrameSize();
@@ -121,6 +259,101 @@ namespace igtl
     return mat;
   }
 
+  //----------------------------------------------------------------------------
+  PlusTrackedFrameMessage::FrameFieldEncoding PlusTrackedFrameMessage::GetFrameFieldEncoding() const
+  {
+    return this->m_FrameFieldEncoding;
+  }
+
+  //----------------------------------------------------------------------------
+  void PlusTrackedFrameMessage::EncodeBinaryFrameFields(const std::vector<igsioTransformName>& requestedTransforms)
+  {
+    // Same fields as in the XML data: if transforms are requested then the other transforms are not sent
+    std::set<std::string> requestedTransformFieldNames;
+    for (std::vector<igsioTransformName>::const_iterator nameIt = requestedTransforms.begin(); nameIt != requestedTransforms.end(); ++nameIt)
+    {
+      std::string transformName = nameIt->GetTransformName();
+      requestedTransformFieldNames.insert(transformName + "Transform");
+      requestedTransformFieldNames.insert(transformName + "TransformStatus");
+    }
+
+    const igsioFieldMapType& fields = this->m_TrackedFrame.GetCustomFields();
+    std::vector<igsioFieldMapType::const_iterator> sentFields;
+    sentFields.reserve(fields.size());
+    size_t dataSize = sizeof(BINARY_FRAME_FIELD_MARKER) + sizeof(igtl_uint16) + sizeof(igtl_float64) + sizeof(igtl_uint32);
+    for (igsioFieldMapType::const_iterator fieldIt = fields.begin(); fieldIt != fields.end(); ++fieldIt)
+    {
+      if (!requestedTransformFieldNames.empty()
+          && (igsioTrackedFrame::IsTransform(fieldIt->first) || igsioTrackedFrame::IsTransformStatus(fieldIt->first))
+          && requestedTransformFieldNames.find(fieldIt->first) == requestedTransformFieldNames.end())
+      {
+        continue;
+      }
+      if (fieldIt->first.size() > std::numeric_limits<igtl_uint16>::max() || fieldIt->second.second.size() > std::numeric_limits<igtl_uint32>::max())
+      {
+        LOG_WARNING("Frame field " << fieldIt->first.substr(0, 64) << " is too large to be sent in Plus TrackedFrame message, it is skipped");
+        continue;
+      }
+      sentFields.push_back(fieldIt);
+      dataSize += sizeof(igtl_uint16) + fieldIt->first.size() + sizeof(igtl_uint32) + fieldIt->second.second.size();
+    }
+
+    std::string& data = this->m_TrackedFrameXmlData;
+    data.clear();
+    data.reserve(dataSize);
+    data.append(BINARY_FRAME_FIELD_MARKER, sizeof(BINARY_FRAME_FIELD_MARKER));
+    AppendUInt16(data, BINARY_FRAME_FIELD_ENCODING_VERSION);
+    AppendFloat64(data, this->m_TrackedFrame.GetTimestamp());
+    AppendUInt32(data, static_cast<igtl_uint32>(sentFields.size()));
+    for (std::vector<igsioFieldMapType::const_iterator>::const_iterator fieldIt = sentFields.begin(); fieldIt != sentFields.end(); ++fieldIt)
+    {
+      AppendUInt16(data, static_cast<igtl_uint16>((*fieldIt)->first.size()));
+      data.append((*fieldIt)->first);
+      AppendUInt32(data, static_cast<igtl_uint32>((*fieldIt)->second.second.size()));
+      data.append((*fieldIt)->second.second);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus PlusTrackedFrameMessage::DecodeBinaryFrameFields(const char* data, size_t dataSize)
+  {
+    BinaryFrameFieldReader reader(data, dataSize);
+    char marker[sizeof(BINARY_FRAME_FIELD_MARKER)] = { 0 };
+    igtl_uint16 version = 0;
+    igtl_float64 timestamp = 0;
+    igtl_uint32 numberOfFields = 0;
+    if (!reader.Read(marker, sizeof(marker)) || memcmp(marker, BINARY_FRAME_FIELD_MARKER, sizeof(marker)) != 0
+        || !reader.ReadUInt16(version) || !reader.ReadFloat64(timestamp) || !reader.ReadUInt32(numberOfFields))
+    {
+      LOG_ERROR("Invalid binary frame field data in Plus TrackedFrame message");
+      return PLUS_FAIL;
+    }
+    if (version > BINARY_FRAME_FIELD_ENCODING_VERSION)
+    {
+      LOG_ERROR("Unsupported binary frame field encoding version in Plus TrackedFrame message: " << version
+                << " (supported version: " << BINARY_FRAME_FIELD_ENCODING_VERSION << ")");
+      return PLUS_FAIL;
+    }
+
+    this->m_TrackedFrame = igsioTrackedFrame();
+    this->m_TrackedFrame.SetTimestamp(timestamp);
+    std::string name;
+    std::string value;
+    for (igtl_uint32 fieldIndex = 0; fieldIndex < numberOfFields; ++fieldIndex)
+    {
+      igtl_uint16 nameLength = 0;
+      igtl_uint32 valueLength = 0;
+      if (!reader.ReadUInt16(nameLength) || !reader.ReadString(name, nameLength)
+          || !reader.ReadUInt32(valueLength) || !reader.ReadString(value, valueLength))
+      {
+        LOG_ERROR("Invalid binary frame field data in Plus TrackedFrame message: field " << fieldIndex << " of " << numberOfFields << " is truncated");
+        return PLUS_FAIL;
+      }
+      this->m_TrackedFrame.SetFrameField(name, value);
+    }
+    return PLUS_SUCCESS;
+  }
+
   //----------------------------------------------------------------------------
   int PlusTrackedFrameMessage::CalculateContentBufferSize()
   {
@@ -147,9 +380,9 @@ namespace igtl
     header->m_ImageOrientation = this->m_MessageHeader.m_ImageOrientation;
     memcpy(header->m_EmbeddedImageTransform, this->m_MessageHeader.m_EmbeddedImageTransform, sizeof(igtl::Matrix4x4));
 
-    // Copy xml data
+    // Copy frame field data (xml or binary)
     char* xmlData = (char*)(this->m_Content + header->GetMessageHeaderSize());
-    strncpy(xmlData, this->m_TrackedFrameXmlData.c_str(), this->m_TrackedFrameXmlData.size());
+    memcpy(xmlData, this->m_TrackedFrameXmlData.data(), this->m_TrackedFrameXmlData.size());
     header->m_XmlDataSizeInBytes = this->m_MessageHeader.m_XmlDataSizeInBytes;
 
     // Copy image data
@@ -176,29 +409,20 @@ namespace igtl
     header->ConvertEndianness();
 
     // Copy header
-    this->m_MessageHeader.m_ScalarType = header->m_ScalarType;
-    this->m_MessageHeader.m_NumberOfComponents = header->m_NumberOfComponents;
-    this->m_MessageHeader.m_ImageType = header->m_ImageType;
-    this->m_MessageHeader.m_FrameSize[0] = header->m_FrameSize[0];
-    this->m_MessageHeader.m_FrameSize[1] = header->m_FrameSize[1];
-    this->m_MessageHeader.m_FrameSize[2] = header->m_FrameSize[2];
-    this->m_MessageHeader.m_ImageDataSizeInBytes = header->m_ImageDataSizeInBytes;
-    this->m_MessageHeader.m_XmlDataSizeInBytes = header->m_XmlDataSizeInBytes;
-    this->m_MessageHeader.m_ImageOrientation = header->m_ImageOrientation;
-    memcpy(this->m_MessageHeader.m_EmbeddedImageTransform, header->m_EmbeddedImageTransform, sizeof(igtl::Matrix4x4));
-
-    // Copy xml data
+    this->SetMessageHeaderFields(*header);
+
+    // Copy frame field data
     char* xmlData = (char*)(this->m_Content + header->GetMessageHeaderSize());
-    this->m_TrackedFrameXmlData.assign(xmlData, header->m_XmlDataSizeInBytes);
-    if (this->m_TrackedFrame.SetTrackedFrameFromXmlData(this->m_TrackedFrameXmlData) != PLUS_SUCCESS)
+    if (this->DecodeFrameFields(xmlData, header->m_XmlDataSizeInBytes) != PLUS_SUCCESS)
     {
-      LOG_ERROR("Failed to set tracked frame data from xml received in Plus TrackedFrame message");
       return 0;
     }
 
     // Copy image data
     void* imageData = (void*)(this->m_Content + header->GetMessageHeaderSize() + header->m_XmlDataSizeInBytes);
     FrameSizeType frameSize = { header->m_FrameSize[0], header->m_FrameSize[1], header->m_FrameSize[2] };
+    // The frame may share its pixels with the frame that was set by SetTrackedFrame, they are overwritten
+    PlusCommon::DetachFrameImage(*this->m_TrackedFrame.GetImageData());
     if (this->m_TrackedFrame.GetImageData()->AllocateFrame(frameSize, PlusCommon::GetVTKScalarPixelTypeFromIGTL(header->m_ScalarType), header->m_NumberOfComponents) != PLUS_SUCCESS)
     {
       LOG_ERROR("Failed to allocate memory for frame received in Plus TrackedFrame message");
@@ -218,4 +442,116 @@ namespace igtl
 
     return 1;
   }
+
+  //----------------------------------------------------------------------------
+  PlusStatus PlusTrackedFrameMessage::ReceiveTrackedFrame(IgtlMessageBodyReceiver& receiver, igsioTrackedFrame& trackedFrame)
+  {
+    TrackedFrameHeader header;
+    if (receiver.ReceiveExtendedHeader() != PLUS_SUCCESS
+        || receiver.Receive(&header, header.GetMessageHeaderSize()) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to receive header of Plus TrackedFrame message");
+      receiver.Finish();
+      return PLUS_FAIL;
+    }
+    header.ConvertEndianness();
+    this->SetMessageHeaderFields(header);
+    if (static_cast<igtl_uint64>(header.m_XmlDataSizeInBytes) + header.m_ImageDataSizeInBytes > receiver.GetRemainingContentSize())
+    {
+      LOG_ERROR("Invalid Plus TrackedFrame message: frame field and image data (" << header.m_XmlDataSizeInBytes << " and " << header.m_ImageDataSizeInBytes
+                << " bytes) do not fit in the message content (" << receiver.GetRemainingContentSize() << " bytes)");
+      receiver.Finish();
+      return PLUS_FAIL;
+    }
+
+    // Frame fields are small, they are received into a buffer and decoded before the image is received
+    std::vector<char> xmlData(header.m_XmlDataSizeInBytes);
+    if (!xmlData.empty() && receiver.Receive(&xmlData[0], xmlData.size()) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to receive frame fields of Plus TrackedFrame message");
+      receiver.Finish();
+      return PLUS_FAIL;
+    }
+    if (this->DecodeFrameFields(xmlData.empty() ? "" : &xmlData[0], xmlData.size()) != PLUS_SUCCESS)
+    {
+      receiver.Finish();
+      return PLUS_FAIL;
+    }
+
+    // The decoded frame has no image yet, so it is cheap to copy
+    trackedFrame = this->m_TrackedFrame;
+
+    FrameSizeType frameSize = { header.m_FrameSize[0], header.m_FrameSize[1], header.m_FrameSize[2] };
+    igsioVideoFrame* videoFrame = trackedFrame.GetImageData();
+    if (videoFrame->AllocateFrame(frameSize, PlusCommon::GetVTKScalarPixelTypeFromIGTL(header.m_ScalarType), header.m_NumberOfComponents) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to allocate memory for frame received in Plus TrackedFrame message");
+      receiver.Finish();
+      return PLUS_FAIL;
+    }
+    videoFrame->SetImageType((US_IMAGE_TYPE)header.m_ImageType);
+    if (header.m_ImageDataSizeInBytes > 0)
+    {
+      if (videoFrame->GetFrameSizeInBytes() != header.m_ImageDataSizeInBytes)
+      {
+        LOG_ERROR("Invalid Plus TrackedFrame message: image data size is " << header.m_ImageDataSizeInBytes << " bytes, but the frame size is "
+                  << videoFrame->GetFrameSizeInBytes() << " bytes");
+        receiver.Finish();
+        return PLUS_FAIL;
+      }
+      if (receiver.Receive(videoFrame->GetScalarPointer(), header.m_ImageDataSizeInBytes) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to receive image data of Plus TrackedFrame message");
+        receiver.Finish();
+        return PLUS_FAIL;
+      }
+      videoFrame->GetImage()->Modified();
+    }
+
+    igtl::TimeStamp::Pointer timestamp = igtl::TimeStamp::New();
+    this->GetTimeStamp(timestamp);
+    trackedFrame.SetTimestamp(timestamp->GetTimeStamp());
+
+    return receiver.Finish();
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus PlusTrackedFrameMessage::DecodeFrameFields(const char* data, size_t dataSize)
+  {
+    if (dataSize >= sizeof(BINARY_FRAME_FIELD_MARKER) && memcmp(data, BINARY_FRAME_FIELD_MARKER, sizeof(BINARY_FRAME_FIELD_MARKER)) == 0)
+    {
+      this->m_FrameFieldEncoding = FRAME_FIELD_ENCODING_BINARY;
+      if (this->DecodeBinaryFrameFields(data, dataSize) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to set tracked frame data from binary frame fields received in Plus TrackedFrame message");
+        return PLUS_FAIL;
+      }
+    }
+    else
+    {
+      this->m_FrameFieldEncoding = FRAME_FIELD_ENCODING_XML;
+      this->m_TrackedFrameXmlData.assign(data, dataSize);
+      if (this->m_TrackedFrame.SetTrackedFrameFromXmlData(this->m_TrackedFrameXmlData) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to set tracked frame data from xml received in Plus TrackedFrame message");
+        return PLUS_FAIL;
+      }
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  void PlusTrackedFrameMessage::SetMessageHeaderFields(const TrackedFrameHeader& header)
+  {
+    this->m_MessageHeader.m_ScalarType = header.m_ScalarType;
+    this->m_MessageHeader.m_NumberOfComponents = header.m_NumberOfComponents;
+    this->m_MessageHeader.m_ImageType = header.m_ImageType;
+    this->m_MessageHeader.m_FrameSize[0] = header.m_FrameSize[0];
+    this->m_MessageHeader.m_FrameSize[1] = header.m_FrameSize[1];
+    this->m_MessageHeader.m_FrameSize[2] = header.m_FrameSize[2];
+    this->m_MessageHeader.m_ImageDataSizeInBytes = header.m_ImageDataSizeInBytes;
+    this->m_MessageHeader.m_XmlDataSizeInBytes = header.m_XmlDataSizeInBytes;
+    this->m_MessageHeader.m_ImageOrientation = header.m_ImageOrientation;
+    memcpy(this->m_MessageHeader.m_EmbeddedImageTransform, header.m_EmbeddedImageTransform, sizeof(igtl::Matrix4x4));
+  }
 }
\ No newline at end of file
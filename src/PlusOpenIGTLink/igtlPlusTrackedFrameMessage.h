@@ -20,6 +20,8 @@
 #include "vtkSmartPointer.h"
 #include <string>
 
+class IgtlMessageBodyReceiver;
+
 namespace igtl
 {
   // This command prevents 4-byte alignment in the struct (which enables m_FrameSize[3])
@@ -28,6 +30,12 @@ namespace igtl
   /*!
     \class PlusTrackedFrameMessage
     \brief IGTL message helper class for tracked frame messages
+
+    The frame fields (transforms, transform statuses, custom fields) are encoded as XML for clients that use header version 1.
+    For clients that use header version 2 or later the fields are sent in a compact binary encoding, which does not require
+    building and parsing an XML document for each frame. The receiver detects the encoding from the message content,
+    so both encodings can be received by any client.
+
     \ingroup PlusLibOpenIGTLink
   */
   class vtkPlusOpenIGTLinkExport PlusTrackedFrameMessage: public MessageBase
@@ -36,6 +44,16 @@ namespace igtl
     igtlTypeMacro(igtl::PlusTrackedFrameMessage, igtl::MessageBase);
     igtlNewMacro(igtl::PlusTrackedFrameMessage);
 
+  public:
+    enum FrameFieldEncoding
+    {
+      FRAME_FIELD_ENCODING_XML,
+      FRAME_FIELD_ENCODING_BINARY
+    };
+
+    /*! Version of the binary frame field encoding */
+    static const igtl_uint16 BINARY_FRAME_FIELD_ENCODING_VERSION = 1;
+
   public:
     /*! Override clone so that we use the plus igtl factory */
     virtual igtl::MessageBase::Pointer Clone();
@@ -46,12 +64,21 @@ namespace igtl
     /*! Get Plus TrackedFrame */
     igsioTrackedFrame GetTrackedFrame();
 
+    /*!
+      Receive the message content into trackedFrame without buffering the message body: the frame fields are decoded
+      first, then the image data is received directly into the image of trackedFrame. The message header must be set.
+    */
+    PlusStatus ReceiveTrackedFrame(IgtlMessageBodyReceiver& receiver, igsioTrackedFrame& trackedFrame);
+
     /*! Set the embedded transform of the underlying image */
     PlusStatus SetEmbeddedImageTransform(vtkSmartPointer<vtkMatrix4x4> matrix);
 
     /*! Get the embedded transform of the underlying image */
     vtkSmartPointer<vtkMatrix4x4> GetEmbeddedImageTransform();
 
+    /*! Encoding of the frame fields in the last packed or unpacked message */
+    FrameFieldEncoding GetFrameFieldEncoding() const;
+
   protected:
     class TrackedFrameHeader
     {
@@ -110,7 +137,7 @@ namespace igtl
       igtl_uint16     m_ImageType;              /* image type */
       igtl_uint16     m_FrameSize[3];           /* entire image volume size */
       igtl_uint32     m_ImageDataSizeInBytes;   /* size of the image, in bytes */
-      igtl_uint32     m_XmlDataSizeInBytes;     /* size of the xml data, in bytes */
+      igtl_uint32     m_XmlDataSizeInBytes;     /* size of the frame field data (xml or binary), in bytes */
       igtl_uint16     m_ImageOrientation;       /* orientation of the image */
       igtl::Matrix4x4 m_EmbeddedImageTransform; /* matrix representing the IJK to world transformation */
     };
@@ -119,11 +146,26 @@ namespace igtl
     virtual int  PackContent();
     virtual int  UnpackContent();
 
+    /*! Encode the timestamp and the frame fields (only the requested transforms, if any is requested) in binary format */
+    void EncodeBinaryFrameFields(const std::vector<igsioTransformName>& requestedTransforms);
+
+    /*! Decode the timestamp and the frame fields from binary format. Returns PLUS_FAIL if the data is invalid. */
+    PlusStatus DecodeBinaryFrameFields(const char* data, size_t dataSize);
+
+    /*! Decode the frame fields, binary data is recognized by its marker (xml data starts with a printable character) */
+    PlusStatus DecodeFrameFields(const char* data, size_t dataSize);
+
+    /*! Copy the received header (already in host byte order) to m_MessageHeader */
+    void SetMessageHeaderFields(const TrackedFrameHeader& header);
+
     PlusTrackedFrameMessage();
     ~PlusTrackedFrameMessage();
 
     igsioTrackedFrame m_TrackedFrame;
+
+    /*! Encoded frame fields, as XML or in binary format */
     std::string m_TrackedFrameXmlData;
+    FrameFieldEncoding m_FrameFieldEncoding;
 
     TrackedFrameHeader m_MessageHeader;
   };
@@ -5,6 +5,7 @@ See License.txt for details.
 =========================================================Plus=header=end*/
 
 #include "PlusConfigure.h"
+#include "PlusIgtlMessageBodyReceiver.h"
 #include "igsioTrackedFrame.h"
 #include "igtlPlusUsMessage.h"
 #include "igtl_image.h"
@@ -12,6 +13,8 @@ See License.txt for details.
 #include "igtl_util.h"
 #include "vtkPlusIgtlMessageFactory.h"
 
+#include <sstream>
+
 namespace igtl
 {
 
@@ -256,6 +259,76 @@ namespace igtl
     return 1;
   }
 
+  //----------------------------------------------------------------------------
+  PlusStatus PlusUsMessage::ReceiveTrackedFrame(IgtlMessageBodyReceiver& receiver, igsioTrackedFrame& trackedFrame)
+  {
+    igtl_image_header imageHeader;
+    if (receiver.ReceiveExtendedHeader() != PLUS_SUCCESS || receiver.ReceiveImageHeader(imageHeader) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to receive image header of US message");
+      receiver.Finish();
+      return PLUS_FAIL;
+    }
+    if (imageHeader.subvol_offset[0] != 0 || imageHeader.subvol_offset[1] != 0 || imageHeader.subvol_offset[2] != 0
+        || imageHeader.subvol_size[0] != imageHeader.size[0] || imageHeader.subvol_size[1] != imageHeader.size[1] || imageHeader.subvol_size[2] != imageHeader.size[2])
+    {
+      LOG_ERROR("Sub-volumes are not supported in US message");
+      receiver.Finish();
+      return PLUS_FAIL;
+    }
+
+    // Width and height are swapped in SetTrackedFrame, the pixel data is not rearranged
+    FrameSizeType frameSize = { imageHeader.size[1], imageHeader.size[0], imageHeader.size[2] };
+    trackedFrame = igsioTrackedFrame();
+    igsioVideoFrame* videoFrame = trackedFrame.GetImageData();
+    if (videoFrame->AllocateFrame(frameSize, PlusCommon::GetVTKScalarPixelTypeFromIGTL(imageHeader.scalar_type), imageHeader.num_components) != PLUS_SUCCESS
+        || videoFrame->GetFrameSizeInBytes() != igtl_image_get_data_size(&imageHeader))
+    {
+      LOG_ERROR("Failed to allocate memory for frame received in US message");
+      receiver.Finish();
+      return PLUS_FAIL;
+    }
+    MessageHeader usHeader;
+    if (receiver.Receive(videoFrame->GetScalarPointer(), videoFrame->GetFrameSizeInBytes()) != PLUS_SUCCESS
+        || receiver.Receive(&usHeader, usHeader.GetMessageHeaderSize()) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to receive US message");
+      receiver.Finish();
+      return PLUS_FAIL;
+    }
+    usHeader.ConvertEndianness();
+    this->m_MessageHeader = usHeader;
+
+    const std::pair<const char*, igtl_int32> usFields[] =
+    {
+      std::make_pair("SonixDataType", usHeader.m_DataType),
+      std::make_pair("SonixTransmitFrequency", usHeader.m_TransmitFrequency),
+      std::make_pair("SonixSamplingFrequency", usHeader.m_SamplingFrequency),
+      std::make_pair("SonixDataRate", usHeader.m_DataRate),
+      std::make_pair("SonixLineDensity", usHeader.m_LineDensity),
+      std::make_pair("SonixSteeringAngle", usHeader.m_SteeringAngle),
+      std::make_pair("SonixProbeID", usHeader.m_ProbeID),
+      std::make_pair("SonixExtensionAngle", usHeader.m_ExtensionAngle),
+      std::make_pair("SonixElements", usHeader.m_Elements),
+      std::make_pair("SonixPitch", usHeader.m_Pitch),
+      std::make_pair("SonixRadius", usHeader.m_Radius),
+      std::make_pair("SonixProbeAngle", usHeader.m_ProbeAngle),
+      std::make_pair("SonixTxOffset", usHeader.m_TxOffset)
+    };
+    for (size_t i = 0; i < sizeof(usFields) / sizeof(usFields[0]); ++i)
+    {
+      std::ostringstream fieldValue;
+      fieldValue << usFields[i].second;
+      trackedFrame.SetFrameField(usFields[i].first, fieldValue.str());
+    }
+
+    igtl::TimeStamp::Pointer timestamp = igtl::TimeStamp::New();
+    this->GetTimeStamp(timestamp);
+    trackedFrame.SetTimestamp(timestamp->GetTimeStamp());
+
+    return receiver.Finish();
+  }
+
   //----------------------------------------------------------------------------
   int PlusUsMessage::UnpackContent()
   {
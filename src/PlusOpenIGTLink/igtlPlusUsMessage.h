@@ -12,6 +12,7 @@ See License.txt for details.
 #include "igtl_types.h"
 
 class igsioTrackedFrame; 
+class IgtlMessageBodyReceiver;
 
 namespace igtl
 {
@@ -37,6 +38,13 @@ namespace igtl
     /*! Get Plus TrackedFrame */ 
     igsioTrackedFrame& GetTrackedFrame(); 
 
+    /*!
+      Receive the message content into trackedFrame without buffering the message body: the image data is received
+      directly into the image of trackedFrame and the ultrasound parameters are stored in Sonix* frame fields.
+      Width and height are swapped back, as in SetTrackedFrame. The message header must be set.
+    */
+    PlusStatus ReceiveTrackedFrame(IgtlMessageBodyReceiver& receiver, igsioTrackedFrame& trackedFrame);
+
   protected:
 
     struct MessageHeader 
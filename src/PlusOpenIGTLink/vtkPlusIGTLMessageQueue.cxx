@@ -8,15 +8,12 @@ See License.txt for details.
 #include "PlusConfigure.h"
 #include "vtkPlusIGTLMessageQueue.h"
 
-// IGSIO includes
-#include "vtkIGSIORecursiveCriticalSection.h"
-
 // VTK includes
 #include <vtkObjectFactory.h>
-#include <vtksys/SystemTools.hxx>
 
 // STL includes
-#include <string>
+#include <chrono>
+#include <cstdint>
 
 // IGT includes
 #include <igtlMessageBase.h>
@@ -28,46 +25,218 @@ vtkStandardNewMacro(vtkPlusIGTLMessageQueue);
 //----------------------------------------------------------------------------
 void vtkPlusIGTLMessageQueue::PrintSelf(ostream& os, vtkIndent indent)
 {
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Capacity: " << this->GetCapacity() << std::endl;
+  os << indent << "Size: " << this->GetSize() << std::endl;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIGTLMessageQueue::PushMessage(igtl::MessageBase* message)
+{
+  size_t position = this->PushPosition.load(std::memory_order_relaxed);
+  Cell* cell = NULL;
+  while (true)
+  {
+    cell = &this->Cells[position & this->CellIndexMask];
+    size_t sequence = cell->Sequence.load(std::memory_order_acquire);
+    intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+    if (difference == 0)
+    {
+      if (this->PushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+      {
+        break;
+      }
+    }
+    else if (difference < 0)
+    {
+      // The cell still holds the message that was pushed one round earlier
+      LOG_DEBUG("OpenIGTLink message queue is full (" << this->GetCapacity() << " messages), message is dropped");
+      return PLUS_FAIL;
+    }
+    else
+    {
+      // Another producer took this position
+      position = this->PushPosition.load(std::memory_order_relaxed);
+    }
+  }
+  cell->Message = message;
+  cell->Sequence.store(position + 1, std::memory_order_release);
+
+  // Pairs with the increment of NumberOfWaitingConsumers in WaitForMessage: either the consumer sees the message
+  // before it starts waiting or we see the waiting consumer
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (this->NumberOfWaitingConsumers.load(std::memory_order_relaxed) > 0)
+  {
+    std::lock_guard<std::mutex> lock(this->WaitMutex);
+    this->MessageAvailable.notify_all();
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+igtl::MessageBase* vtkPlusIGTLMessageQueue::TryPullMessage()
+{
+  size_t position = this->PullPosition.load(std::memory_order_relaxed);
+  while (true)
+  {
+    Cell& cell = this->Cells[position & this->CellIndexMask];
+    size_t sequence = cell.Sequence.load(std::memory_order_acquire);
+    intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+    if (difference == 0)
+    {
+      if (this->PullPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+      {
+        igtl::MessageBase* message = cell.Message;
+        // The cell can be reused for the message that is pushed one round later
+        cell.Sequence.store(position + this->CellIndexMask + 1, std::memory_order_release);
+        return message;
+      }
+    }
+    else if (difference < 0)
+    {
+      // Empty, or the message at this position is not completely pushed yet
+      return NULL;
+    }
+    else
+    {
+      // Another consumer took this position
+      position = this->PullPosition.load(std::memory_order_relaxed);
+    }
+  }
+}
 
+//----------------------------------------------------------------------------
+void vtkPlusIGTLMessageQueue::WaitForMessage(double timeoutSec)
+{
+  if (timeoutSec <= 0)
+  {
+    return;
+  }
+  this->NumberOfWaitingConsumers.fetch_add(1, std::memory_order_seq_cst);
+  {
+    std::unique_lock<std::mutex> lock(this->WaitMutex);
+    this->MessageAvailable.wait_for(lock, std::chrono::duration<double>(timeoutSec), [this]()
+    {
+      size_t position = this->PullPosition.load(std::memory_order_relaxed);
+      return this->Cells[position & this->CellIndexMask].Sequence.load(std::memory_order_acquire) == position + 1;
+    });
+  }
+  this->NumberOfWaitingConsumers.fetch_sub(1, std::memory_order_relaxed);
 }
 
 //----------------------------------------------------------------------------
-void vtkPlusIGTLMessageQueue::PushMessage(igtl::MessageBase* message)
+igtl::MessageBase* vtkPlusIGTLMessageQueue::PullMessage(double timeoutSec/*=0*/)
 {
-  this->Mutex->Lock();
-  this->DataBuffer.push_back(message);
-  this->Mutex->Unlock();
+  igtl::MessageBase* message = this->TryPullMessage();
+  if (message != NULL || timeoutSec <= 0)
+  {
+    return message;
+  }
+  // Another consumer may take the message that ended the wait, so keep waiting until the deadline
+  const std::chrono::steady_clock::time_point deadline = GetDeadline(timeoutSec);
+  for (double remainingSec = timeoutSec; message == NULL && remainingSec > 0; remainingSec = GetRemainingSec(deadline))
+  {
+    this->WaitForMessage(remainingSec);
+    message = this->TryPullMessage();
+  }
+  return message;
 }
 
 //----------------------------------------------------------------------------
-igtl::MessageBase* vtkPlusIGTLMessageQueue::PullMessage()
+unsigned int vtkPlusIGTLMessageQueue::PullMessages(std::vector<igtl::MessageBase*>& messages, unsigned int maxNumberOfMessages, double timeoutSec/*=0*/)
 {
-  this->Mutex->Lock();
-  igtl::MessageBase* ret = NULL;
-  if (this->DataBuffer.size() > 0)
+  unsigned int numberOfPulledMessages = 0;
+  const std::chrono::steady_clock::time_point deadline = GetDeadline(timeoutSec);
+  while (true)
   {
-    ret = this->DataBuffer.front();
-    this->DataBuffer.pop_front();
+    while (numberOfPulledMessages < maxNumberOfMessages)
+    {
+      igtl::MessageBase* message = this->TryPullMessage();
+      if (message == NULL)
+      {
+        break;
+      }
+      messages.push_back(message);
+      numberOfPulledMessages++;
+    }
+    double remainingSec = GetRemainingSec(deadline);
+    if (numberOfPulledMessages > 0 || maxNumberOfMessages == 0 || remainingSec <= 0)
+    {
+      return numberOfPulledMessages;
+    }
+    this->WaitForMessage(remainingSec);
   }
-  this->Mutex->Unlock();
+}
 
-  return ret;
+//----------------------------------------------------------------------------
+std::chrono::steady_clock::time_point vtkPlusIGTLMessageQueue::GetDeadline(double timeoutSec)
+{
+  return std::chrono::steady_clock::now()
+         + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeoutSec > 0 ? timeoutSec : 0));
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusIGTLMessageQueue::GetRemainingSec(const std::chrono::steady_clock::time_point& deadline)
+{
+  return std::chrono::duration<double>(deadline - std::chrono::steady_clock::now()).count();
 }
 
 //----------------------------------------------------------------------------
 int vtkPlusIGTLMessageQueue::GetSize()
 {
-  return this->DataBuffer.size();
+  size_t pullPosition = this->PullPosition.load(std::memory_order_relaxed);
+  size_t pushPosition = this->PushPosition.load(std::memory_order_relaxed);
+  return (pushPosition > pullPosition ? static_cast<int>(pushPosition - pullPosition) : 0);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIGTLMessageQueue::SetCapacity(unsigned int capacity)
+{
+  if (this->GetSize() > 0)
+  {
+    LOG_ERROR("Cannot change the capacity of a non-empty OpenIGTLink message queue");
+    return PLUS_FAIL;
+  }
+  size_t roundedCapacity = 2;
+  while (roundedCapacity < capacity)
+  {
+    roundedCapacity *= 2;
+  }
+  this->AllocateCells(roundedCapacity);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+unsigned int vtkPlusIGTLMessageQueue::GetCapacity() const
+{
+  return static_cast<unsigned int>(this->CellIndexMask + 1);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusIGTLMessageQueue::AllocateCells(size_t capacity)
+{
+  this->Cells.reset(new Cell[capacity]);
+  for (size_t i = 0; i < capacity; ++i)
+  {
+    this->Cells[i].Sequence.store(i, std::memory_order_relaxed);
+    this->Cells[i].Message = NULL;
+  }
+  this->CellIndexMask = capacity - 1;
+  this->PushPosition.store(0, std::memory_order_relaxed);
+  this->PullPosition.store(0, std::memory_order_relaxed);
 }
 
 //----------------------------------------------------------------------------
 vtkPlusIGTLMessageQueue::vtkPlusIGTLMessageQueue()
+  : CellIndexMask(0)
+  , PushPosition(0)
+  , PullPosition(0)
+  , NumberOfWaitingConsumers(0)
 {
-  this->Mutex = vtkIGSIORecursiveCriticalSection::New();
+  this->AllocateCells(DEFAULT_CAPACITY);
 }
 
 //----------------------------------------------------------------------------
 vtkPlusIGTLMessageQueue::~vtkPlusIGTLMessageQueue()
 {
-  this->Mutex->Delete();
 }
@@ -2,49 +2,114 @@
   Program: Plus
   Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
   See License.txt for details.
-=========================================================Plus=header=end*/ 
+=========================================================Plus=header=end*/
 
 #ifndef __vtkPlusIGTLMessageQueue_h
 #define __vtkPlusIGTLMessageQueue_h
 
 #include "vtkPlusOpenIGTLinkExport.h"
 
+#include "PlusConfigure.h"
 #include "vtkObject.h"
 
-#include <deque>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 #include "igtlMessageBase.h"
 
-class vtkIGSIORecursiveCriticalSection;
-
 /*!
-  \class vtkPlusIGTLMessageQueue 
+  \class vtkPlusIGTLMessageQueue
   \brief Message queue to store OpenIGTLink messages.
+
+  Bounded lock-free queue (a ring of Capacity slots, each with a sequence number, see D. Vyukov's bounded MPMC queue),
+  so that the receiving thread and the consumers can hand off thousands of messages per second without contending on a lock
+  or allocating memory. Any number of threads can push and pull messages concurrently.
+  Pushing fails if the queue is full. Pulling can wait until a message is available; the producers only
+  notify the consumers if one of them is waiting.
+
+  The queue does not take ownership of the messages (does not change their reference count).
+
   \ingroup PlusLibOpenIGTLink
 */
 class vtkPlusOpenIGTLinkExport vtkPlusIGTLMessageQueue : public vtkObject
 {
-  typedef std::deque<igtl::MessageBase*> MessageBuffer;
-
 public:
   static vtkPlusIGTLMessageQueue *New();
   vtkTypeMacro( vtkPlusIGTLMessageQueue,vtkObject );
   virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
 
-  void PushMessage( igtl::MessageBase* message );
-  igtl::MessageBase* PullMessage();
-  
+  /*! Add a message to the end of the queue. Returns PLUS_FAIL if the queue is full. */
+  PlusStatus PushMessage( igtl::MessageBase* message );
+
+  /*!
+    Remove the first message from the queue.
+    If the queue is empty then waits at most timeoutSec for a message. Returns NULL if no message is available until the timeout.
+  */
+  igtl::MessageBase* PullMessage(double timeoutSec = 0);
+
+  /*!
+    Remove at most maxNumberOfMessages messages from the queue and append them to messages.
+    If the queue is empty then waits at most timeoutSec for the first message. Returns the number of pulled messages.
+  */
+  unsigned int PullMessages(std::vector<igtl::MessageBase*>& messages, unsigned int maxNumberOfMessages, double timeoutSec = 0);
+
+  /*! Number of messages in the queue. The value may be outdated if other threads push or pull messages at the same time. */
   int GetSize();
-  
+
+  /*!
+    Set the maximum number of messages in the queue (rounded up to a power of two). Default is DEFAULT_CAPACITY.
+    Can only be changed while the queue is empty and no other thread uses it.
+  */
+  PlusStatus SetCapacity(unsigned int capacity);
+  unsigned int GetCapacity() const;
+
+  static const unsigned int DEFAULT_CAPACITY = 4096;
+
 protected:
-  
   vtkPlusIGTLMessageQueue();
   virtual ~vtkPlusIGTLMessageQueue();
-  
-  
+
+  struct Cell
+  {
+    /*! Position of the message that the cell is ready for: pushed at Sequence, pulled at Sequence-1 */
+    std::atomic<size_t> Sequence;
+    igtl::MessageBase* Message;
+  };
+
+  /*! Remove the first message without waiting. Returns NULL if the queue is empty. */
+  igtl::MessageBase* TryPullMessage();
+
+  /*! Wait until a message is pushed or the timeout expires */
+  void WaitForMessage(double timeoutSec);
+
+  static std::chrono::steady_clock::time_point GetDeadline(double timeoutSec);
+  static double GetRemainingSec(const std::chrono::steady_clock::time_point& deadline);
+
+  void AllocateCells(size_t capacity);
+
 protected:
-  vtkIGSIORecursiveCriticalSection* Mutex;
-  MessageBuffer DataBuffer;
+  std::unique_ptr<Cell[]> Cells;
+  size_t CellIndexMask;
+
+  /*! Producer and consumer positions are in separate cache lines, so that pushing and pulling do not slow down each other */
+  char PaddingBeforePush[64];
+  std::atomic<size_t> PushPosition;
+  char PaddingBeforePull[64];
+  std::atomic<size_t> PullPosition;
+  char PaddingAfterPull[64];
+
+  /*! Number of consumers that wait in PullMessage(s), producers notify only if it is not zero */
+  std::atomic<int> NumberOfWaitingConsumers;
+  std::mutex WaitMutex;
+  std::condition_variable MessageAvailable;
+
+private:
+  vtkPlusIGTLMessageQueue(const vtkPlusIGTLMessageQueue&);
+  void operator=(const vtkPlusIGTLMessageQueue&);
 };
 
 
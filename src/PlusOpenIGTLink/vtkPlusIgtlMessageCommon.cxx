@@ -6,6 +6,8 @@ See License.txt for details.
 
 // Local includes
 #include "PlusConfigure.h"
+#include "PlusIgtlCrc64.h"
+#include "PlusIgtlMessageBodyReceiver.h"
 #include "igsioTrackedFrame.h"
 #include "igsioVideoFrame.h"
 #include "vtkPlusIgtlMessageCommon.h"
@@ -138,20 +140,15 @@ PlusStatus vtkPlusIgtlMessageCommon::UnpackTrackedFrameMessage(igtl::MessageHead
     trackedFrameMsg = igtl::PlusTrackedFrameMessage::New();
   }
   trackedFrameMsg->SetMessageHeader(headerMsg);
-  trackedFrameMsg->AllocateBuffer();
 
-  socket->Receive(trackedFrameMsg->GetBufferBodyPointer(), trackedFrameMsg->GetBufferBodySize());
-
-  int c = trackedFrameMsg->Unpack(crccheck);
-  if (!(c & igtl::MessageHeader::UNPACK_BODY))
+  // The body is not received into the message buffer, the image is received directly into the tracked frame
+  IgtlMessageBodyReceiver receiver(socket, headerMsg.GetPointer(), crccheck != 0);
+  if (trackedFrameMsg->ReceiveTrackedFrame(receiver, trackedFrame) != PLUS_SUCCESS)
   {
     LOG_ERROR("Couldn't receive tracked frame message from server!");
     return PLUS_FAIL;
   }
 
-  // if CRC check is OK. get tracked frame data.
-  trackedFrame = trackedFrameMsg->GetTrackedFrame();
-
   if (embeddedTransformName.IsValid())
   {
     // Save the transform that is embedded in the TRACKEDFRAME message into the tracked frame
@@ -196,20 +193,15 @@ PlusStatus vtkPlusIgtlMessageCommon::UnpackUsMessage(igtl::MessageHeader::Pointe
 
   igtl::PlusUsMessage::Pointer usMsg = igtl::PlusUsMessage::New();
   usMsg->SetMessageHeader(headerMsg);
-  usMsg->AllocateBuffer();
 
-  socket->Receive(usMsg->GetBufferBodyPointer(), usMsg->GetBufferBodySize());
-
-  int c = usMsg->Unpack(crccheck);
-  if (!(c & igtl::MessageHeader::UNPACK_BODY))
+  // The body is not received into the message buffer, the image is received directly into the tracked frame
+  IgtlMessageBodyReceiver receiver(socket, headerMsg.GetPointer(), crccheck != 0);
+  if (usMsg->ReceiveTrackedFrame(receiver, trackedFrame) != PLUS_SUCCESS)
   {
     LOG_ERROR("Couldn't receive US message from server!");
     return PLUS_FAIL;
   }
 
-  // if CRC check is OK. get tracked frame data.
-  trackedFrame = usMsg->GetTrackedFrame();
-
   return PLUS_SUCCESS;
 }
 
@@ -329,6 +321,7 @@ PlusStatus vtkPlusIgtlMessageCommon::PackImageMessage(igtl::ImageMessage::Pointe
 
   int scalarType = PlusCommon::GetIGTLScalarPixelTypeFromVTK(image->GetScalarType());
   imageMessage->SetScalarType(scalarType);
+  imageMessage->SetNumComponents(image->GetNumberOfScalarComponents());
   imageMessage->SetEndian(igtl_is_little_endian() ? igtl::ImageMessage::ENDIAN_LITTLE : igtl::ImageMessage::ENDIAN_BIG);
   imageMessage->AllocateScalars();
 
@@ -372,25 +365,92 @@ PlusStatus vtkPlusIgtlMessageCommon::UnpackImageMessage(igtl::MessageHeader::Poi
     return PLUS_FAIL;
   }
 
-  // Message body handler for IMAGE
-  igtl::ImageMessage::Pointer imgMsg = dynamic_cast<igtl::ImageMessage*>(headerMsg.GetPointer());
-  if (imgMsg.IsNull())
+  // The body is not received into the message buffer, the image is received directly into the tracked frame
+  IgtlMessageBodyReceiver receiver(socket, headerMsg.GetPointer(), crccheck != 0);
+  igtl_image_header imageHeader;
+  if (receiver.ReceiveExtendedHeader() != PLUS_SUCCESS || receiver.ReceiveImageHeader(imageHeader) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Couldn't receive image message from server!");
+    receiver.Finish();
+    return PLUS_FAIL;
+  }
+  return ReceiveImageData(receiver, headerMsg.GetPointer(), imageHeader, trackedFrame, embeddedTransformName);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlMessageCommon::ReceiveImageData(IgtlMessageBodyReceiver& receiver,
+    igtl::MessageBase* headerMsg,
+    const igtl_image_header& imageHeader,
+    igsioTrackedFrame& trackedFrame,
+    const igsioTransformName& embeddedTransformName)
+{
+  igtl_image_header header = imageHeader;
+  if (header.subvol_offset[0] != 0 || header.subvol_offset[1] != 0 || header.subvol_offset[2] != 0
+      || header.subvol_size[0] != header.size[0] || header.subvol_size[1] != header.size[1] || header.subvol_size[2] != header.size[2])
   {
-    imgMsg = igtl::ImageMessage::New();
+    LOG_ERROR("Unable to unpack image message - sub-volumes are not supported");
+    receiver.Finish();
+    return PLUS_FAIL;
   }
-  imgMsg->SetMessageHeader(headerMsg);
-  imgMsg->AllocateBuffer();
 
-  socket->Receive(imgMsg->GetBufferBodyPointer(), imgMsg->GetBufferBodySize());
+  FrameSizeType imageSize = { header.size[0], header.size[1], header.size[2] };
+  igsioCommon::VTKScalarPixelType pixelType = PlusCommon::GetVTKScalarPixelTypeFromIGTL(header.scalar_type);
+  igsioVideoFrame* frame = trackedFrame.GetImageData();
+  if (frame->AllocateFrame(imageSize, pixelType, header.num_components) != PLUS_SUCCESS
+      || frame->GetFrameSizeInBytes() != igtl_image_get_data_size(&header))
+  {
+    LOG_ERROR("Failed to allocate image data for tracked frame!");
+    receiver.Finish();
+    return PLUS_FAIL;
+  }
 
-  int c = imgMsg->Unpack(crccheck);
-  if (!(c & igtl::MessageHeader::UNPACK_BODY))
+  // Set the image type to support color images
+  if (header.scalar_type == igtl::ImageMessage::TYPE_INT8)
+  {
+    frame->SetImageType((header.num_components == igtl::ImageMessage::DTYPE_VECTOR) ? US_IMG_RGB_COLOR : US_IMG_BRIGHTNESS);
+  }
+
+  if (receiver.Receive(frame->GetScalarPointer(), frame->GetFrameSizeInBytes()) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Couldn't receive image data from server!");
+    receiver.Finish();
+    return PLUS_FAIL;
+  }
+  // The rest of the body is meta data, which is not used
+  if (receiver.Finish() != PLUS_SUCCESS)
   {
     LOG_ERROR("Couldn't receive image message from server!");
     return PLUS_FAIL;
   }
 
-  // if CRC check is OK. Read data.
+  igtl::TimeStamp::Pointer igtlTimestamp = igtl::TimeStamp::New();
+  headerMsg->GetTimeStamp(igtlTimestamp);
+  trackedFrame.SetTimestamp(igtlTimestamp->GetTimeStamp());
+
+  if (embeddedTransformName.IsValid())
+  {
+    vtkSmartPointer<vtkMatrix4x4> vtkMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    if (UnpackImageHeaderTransform(header, vtkMatrix) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    trackedFrame.SetFrameTransform(embeddedTransformName, vtkMatrix);
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlMessageCommon::UnpackImageMessage(igtl::ImageMessage::Pointer imgMsg,
+    igsioTrackedFrame& trackedFrame,
+    const igsioTransformName& embeddedTransformName)
+{
+  if (imgMsg.IsNull())
+  {
+    LOG_ERROR("Unable to unpack image message - image message is NULL!");
+    return PLUS_FAIL;
+  }
+
   igtl::TimeStamp::Pointer igtlTimestamp = igtl::TimeStamp::New();
   imgMsg->GetTimeStamp(igtlTimestamp);
 
@@ -439,6 +499,90 @@ PlusStatus vtkPlusIgtlMessageCommon::UnpackImageMessage(igtl::MessageHeader::Poi
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlMessageCommon::UnpackImageHeaderTransform(const igtl_image_header& imageHeader, vtkMatrix4x4* ijkToRasMatrix)
+{
+  if (ijkToRasMatrix == NULL)
+  {
+    LOG_ERROR("Unable to unpack image header transform - output matrix is NULL!");
+    return PLUS_FAIL;
+  }
+
+  // The image message is only used for computing the transform, no image data is allocated
+  igtl_image_header header = imageHeader;
+  int size[3] = { header.size[0], header.size[1], header.size[2] };
+  float spacing[3] = { 0 };
+  float origin[3] = { 0 };
+  float normals[3][3] = { { 0 } };
+  igtl_image_get_matrix(spacing, origin, normals[0], normals[1], normals[2], &header);
+
+  igtl::ImageMessage::Pointer imgMsg = igtl::ImageMessage::New();
+  imgMsg->SetDimensions(size);
+  imgMsg->SetSpacing(spacing);
+  imgMsg->SetOrigin(origin);
+  imgMsg->SetNormals(normals[0], normals[1], normals[2]);
+
+  if (igtlioImageConverter::IGTLImageToVTKTransform(imgMsg, ijkToRasMatrix) != 1)
+  {
+    LOG_ERROR("Failed to unpack image header - unable to extract IJKToRAS transform");
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlMessageCommon::UnpackCompressedImageMessage(igtl::MessageHeader::Pointer headerMsg,
+    igtl::Socket* socket,
+    igsioTrackedFrame& trackedFrame,
+    const igsioTransformName& embeddedTransformName,
+    int crccheck)
+{
+  if (headerMsg.IsNull())
+  {
+    LOG_ERROR("Unable to unpack compressed image message - header message is NULL!");
+    return PLUS_FAIL;
+  }
+
+  if (socket == NULL)
+  {
+    LOG_ERROR("Unable to unpack compressed image message - socket is NULL!");
+    return PLUS_FAIL;
+  }
+
+  // Message body handler for CIMAGE
+  const igtl_uint64 expectedCrc = IgtlCrc64::GetHeaderCrc(headerMsg.GetPointer());
+  igtl::PlusCompressedImageMessage::Pointer compressedImgMsg = dynamic_cast<igtl::PlusCompressedImageMessage*>(headerMsg.GetPointer());
+  if (compressedImgMsg.IsNull())
+  {
+    compressedImgMsg = igtl::PlusCompressedImageMessage::New();
+  }
+  compressedImgMsg->SetMessageHeader(headerMsg);
+  compressedImgMsg->AllocateBuffer();
+
+  socket->Receive(compressedImgMsg->GetBufferBodyPointer(), compressedImgMsg->GetBufferBodySize());
+
+  // The CRC is checked with IgtlCrc64, which is faster than the check in Unpack
+  if (crccheck && IgtlCrc64::CheckBody(compressedImgMsg, expectedCrc) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  int c = compressedImgMsg->Unpack(0);
+  if (!(c & igtl::MessageHeader::UNPACK_BODY))
+  {
+    LOG_ERROR("Couldn't receive compressed image message from server!");
+    return PLUS_FAIL;
+  }
+
+  igtl::ImageMessage::Pointer imgMsg = igtl::ImageMessage::New();
+  if (compressedImgMsg->GetImageMessage(imgMsg) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to decompress image message!");
+    return PLUS_FAIL;
+  }
+
+  return UnpackImageMessage(imgMsg, trackedFrame, embeddedTransformName);
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusIgtlMessageCommon::PackImageMetaMessage(igtl::ImageMetaMessage::Pointer imageMetaMessage,
     igsioCommon::ImageMetaDataList& imageMetaDataList)
@@ -523,10 +667,25 @@ PlusStatus vtkPlusIgtlMessageCommon::PackVideoMessage(igtl::VideoMessage::Pointe
     return PLUS_FAIL;
   }
 
+  return vtkPlusIgtlMessageCommon::PackVideoMessage(videoMessage, frame, matrix, trackedFrame.GetTimestamp());
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlMessageCommon::PackVideoMessage(igtl::VideoMessage::Pointer videoMessage,
+    vtkStreamingVolumeFrame* frame,
+    vtkMatrix4x4& matrix,
+    double timestamp)
+{
+  if (videoMessage.IsNull() || frame == NULL)
+  {
+    LOG_ERROR("Failed to pack video message - input video message or frame is NULL");
+    return PLUS_FAIL;
+  }
+
   vtkSmartPointer<vtkUnsignedCharArray> frameData = frame->GetFrameData();
   int frameType = frame->GetFrameType();
   unsigned int frameSize = frameData->GetSize() * frameData->GetElementComponentSize();
-  codecFourCC = frame->GetCodecFourCC();
+  std::string codecFourCC = frame->GetCodecFourCC();
   int endian = (igtl_is_little_endian() == 1 ? IGTL_VIDEO_ENDIAN_LITTLE : IGTL_VIDEO_ENDIAN_BIG);
   int dimensions[3] = { 0, 0, 0 };
   frame->GetDimensions(dimensions);
@@ -545,7 +704,6 @@ PlusStatus vtkPlusIgtlMessageCommon::PackVideoMessage(igtl::VideoMessage::Pointe
   igtl::IdentityMatrix(videoMatrix);
   igtlioConverterUtilities::VTKTransformToIGTLTransform(&matrix, frame->GetDimensions(), spacing, videoMatrix);
 
-  double timestamp = trackedFrame.GetTimestamp();
   igtl::TimeStamp::Pointer igtlFrameTime = igtl::TimeStamp::New();
   igtlFrameTime->SetTime(timestamp);
 
@@ -638,40 +796,74 @@ PlusStatus vtkPlusIgtlMessageCommon::PackTrackingDataMessage(igtl::TrackingDataM
     return PLUS_FAIL;
   }
 
+  std::vector<igsioTransformName> foundNames;
+  std::vector<vtkSmartPointer<vtkMatrix4x4> > foundMatrices;
+  std::vector<vtkMatrix4x4*> matrices;
+  std::vector<ToolStatus> statuses;
+  for (auto it = names.begin(); it != names.end(); ++it)
+  {
+    vtkSmartPointer<vtkMatrix4x4> vtkMat = vtkSmartPointer<vtkMatrix4x4>::New();
+    ToolStatus status(TOOL_INVALID);
+    if (!it->GetTransformName().empty() && repository.GetTransform(*it, vtkMat, &status) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Transform " << it->From() << "To" << it->To() << " not found in repository.");
+      continue;
+    }
+    foundNames.push_back(*it);
+    foundMatrices.push_back(vtkMat);
+    matrices.push_back(vtkMat);
+    statuses.push_back(status);
+  }
+
+  return PackTrackingDataMessage(trackingDataMessage, foundNames, matrices, statuses, timestamp);
+}
+
+//-------------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlMessageCommon::PackTrackingDataMessage(igtl::TrackingDataMessage::Pointer trackingDataMessage,
+    const std::vector<igsioTransformName>& names,
+    const std::vector<vtkMatrix4x4*>& matrices,
+    const std::vector<ToolStatus>& statuses,
+    double timestamp)
+{
+  if (trackingDataMessage.IsNull())
+  {
+    LOG_ERROR("Failed to pack tracking data message - input tracking data message is NULL");
+    return PLUS_FAIL;
+  }
+  if (matrices.size() != names.size() || statuses.size() != names.size())
+  {
+    LOG_ERROR("Failed to pack tracking data message - the number of matrices and statuses does not match the number of transform names");
+    return PLUS_FAIL;
+  }
+
   igtl::TimeStamp::Pointer igtlTime = igtl::TimeStamp::New();
   igtlTime->SetTime(timestamp);
 
   uint32_t i = 0;
-  for (auto it = names.begin(); it != names.end(); ++it)
+  for (size_t nameIndex = 0; nameIndex < names.size(); ++nameIndex)
   {
-    if (it->GetTransformName().empty())
+    const igsioTransformName& name = names[nameIndex];
+    if (name.GetTransformName().empty())
     {
       LOG_ERROR("Unable to pack transform element in TDATA message. Skipping.");
       continue;
     }
 
-    vtkNew<vtkMatrix4x4> vtkMat;
-    ToolStatus status(TOOL_INVALID);
-    if (repository.GetTransform(*it, vtkMat.GetPointer(), &status) != PLUS_SUCCESS)
-    {
-      LOG_ERROR("Transform " << it->From() << "To" << it->To() << " not found in repository.");
-      continue;
-    }
     igtl::Matrix4x4 matrix;
-    if (igtlioTransformConverter::VTKToIGTLTransform(*vtkMat.GetPointer(), matrix) != 1)
+    if (igtlioTransformConverter::VTKToIGTLTransform(*matrices[nameIndex], matrix) != 1)
     {
       LOG_ERROR("Unable to convert from VTK to IGTL transform.");
       continue;
     }
 
     igtl::TrackingDataElement::Pointer trackElement = igtl::TrackingDataElement::New();
-    std::string shortenedName = it->GetTransformName().substr(0, IGTL_TDATA_LEN_NAME);
+    std::string shortenedName = name.GetTransformName().substr(0, IGTL_TDATA_LEN_NAME);
     trackElement->SetName(shortenedName.c_str());
     trackElement->SetType(igtl::TrackingDataElement::TYPE_6D);
     trackElement->SetMatrix(matrix);
     trackingDataMessage->AddTrackingDataElement(trackElement);
-    trackingDataMessage->SetMetaDataElement(it->GetTransformName() + "Status", IANA_TYPE_US_ASCII,  igsioCommon::ConvertToolStatusToString(status));
-    trackingDataMessage->SetMetaDataElement(it->GetTransformName() + "Index", IANA_TYPE_US_ASCII, igsioCommon::ToString(i));
+    trackingDataMessage->SetMetaDataElement(name.GetTransformName() + "Status", IANA_TYPE_US_ASCII,  igsioCommon::ConvertToolStatusToString(statuses[nameIndex]));
+    trackingDataMessage->SetMetaDataElement(name.GetTransformName() + "Index", IANA_TYPE_US_ASCII, igsioCommon::ToString(i));
     ++i;
   }
 
@@ -702,13 +894,18 @@ PlusStatus vtkPlusIgtlMessageCommon::UnpackTrackingDataMessage(igtl::MessageHead
     return PLUS_FAIL;
   }
 
+  const igtl_uint64 expectedCrc = IgtlCrc64::GetHeaderCrc(headerMsg.GetPointer());
   igtl::TrackingDataMessage::Pointer tdMsg = igtl::TrackingDataMessage::New();
   tdMsg->SetMessageHeader(headerMsg);
   tdMsg->InitBuffer();
 
   socket->Receive(tdMsg->GetBufferBodyPointer(), tdMsg->GetBufferBodySize());
 
-  int c = tdMsg->Unpack(crccheck);
+  if (crccheck && IgtlCrc64::CheckBody(tdMsg, expectedCrc) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  int c = tdMsg->Unpack(0);
   if (!(c & igtl::MessageHeader::UNPACK_BODY))
   {
     LOG_ERROR("Couldn't receive tracking data message from server!");
@@ -794,6 +991,7 @@ PlusStatus vtkPlusIgtlMessageCommon::UnpackTransformMessage(igtl::MessageHeader:
     return PLUS_FAIL;
   }
 
+  const igtl_uint64 expectedCrc = IgtlCrc64::GetHeaderCrc(headerMsg.GetPointer());
   igtl::TransformMessage::Pointer transMsg = dynamic_cast<igtl::TransformMessage*>(headerMsg.GetPointer());
   if (transMsg.IsNull())
   {
@@ -804,13 +1002,33 @@ PlusStatus vtkPlusIgtlMessageCommon::UnpackTransformMessage(igtl::MessageHeader:
 
   socket->Receive(transMsg->GetBufferBodyPointer(), transMsg->GetBufferBodySize());
 
-  int c = transMsg->Unpack(crccheck);
+  if (crccheck && IgtlCrc64::CheckBody(transMsg, expectedCrc) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  int c = transMsg->Unpack(0);
   if (!(c & igtl::MessageHeader::UNPACK_BODY))
   {
     LOG_ERROR("Couldn't receive transform message from server!");
     return PLUS_FAIL;
   }
   // if CRC check is OK. Read transform data.
+  return UnpackTransformMessage(transMsg, transformMatrix, toolStatus, transformName, timestamp);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlMessageCommon::UnpackTransformMessage(igtl::TransformMessage::Pointer transMsg,
+    vtkMatrix4x4* transformMatrix,
+    ToolStatus& toolStatus,
+    std::string& transformName,
+    double& timestamp)
+{
+  if (transMsg.IsNull() || transformMatrix == NULL)
+  {
+    LOG_ERROR("Unable to unpack transform message - message or matrix is NULL!");
+    return PLUS_FAIL;
+  }
+
   igtl::Matrix4x4 igtlMatrix;
   igtl::IdentityMatrix(igtlMatrix);
   transMsg->GetMatrix(igtlMatrix);
@@ -904,6 +1122,7 @@ PlusStatus vtkPlusIgtlMessageCommon::UnpackPositionMessage(igtl::MessageHeader::
     return PLUS_FAIL;
   }
 
+  const igtl_uint64 expectedCrc = IgtlCrc64::GetHeaderCrc(headerMsg.GetPointer());
   igtl::PositionMessage::Pointer posMsg = dynamic_cast<igtl::PositionMessage*>(headerMsg.GetPointer());
   if (posMsg.IsNull())
   {
@@ -914,8 +1133,12 @@ PlusStatus vtkPlusIgtlMessageCommon::UnpackPositionMessage(igtl::MessageHeader::
 
   socket->Receive(posMsg->GetBufferBodyPointer(), posMsg->GetBufferBodySize());
 
-  //  If crccheck is specified it performs CRC check and unpack the data only if CRC passes
-  int c = posMsg->Unpack(crccheck);
+  //  If crccheck is specified, the data is unpacked only if CRC passes
+  if (crccheck && IgtlCrc64::CheckBody(posMsg, expectedCrc) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  int c = posMsg->Unpack(0);
   if (!(c & igtl::MessageHeader::UNPACK_BODY))
   {
     LOG_ERROR("Couldn't receive position message from server!");
@@ -923,6 +1146,22 @@ PlusStatus vtkPlusIgtlMessageCommon::UnpackPositionMessage(igtl::MessageHeader::
   }
 
   // if CRC check is OK. Read position data.
+  return UnpackPositionMessage(posMsg, transformMatrix, transformName, toolStatus, timestamp);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlMessageCommon::UnpackPositionMessage(igtl::PositionMessage::Pointer posMsg,
+    vtkMatrix4x4* transformMatrix,
+    std::string& transformName,
+    ToolStatus& toolStatus,
+    double& timestamp)
+{
+  if (posMsg.IsNull() || transformMatrix == NULL)
+  {
+    LOG_ERROR("Unable to unpack position message - message or matrix is NULL!");
+    return PLUS_FAIL;
+  }
+
   float position[3] = {0};
   posMsg->GetPosition(position);
 
@@ -18,6 +18,7 @@ See License.txt for details.
 #include <igtlImageMessage.h>
 #include <igtlImageMetaMessage.h>
 #include <igtlMessageBase.h>
+#include <igtlPlusCompressedImageMessage.h>
 #include <igtlPlusTrackedFrameMessage.h>
 #include <igtlPlusUsMessage.h>
 #include <igtlPolyDataMessage.h>
@@ -26,16 +27,19 @@ See License.txt for details.
 #include <igtlStringMessage.h>
 #include <igtlTrackingDataMessage.h>
 #include <igtlTransformMessage.h>
+#include <igtl_image.h>
 #if defined(OpenIGTLink_ENABLE_VIDEOSTREAMING)
   #include <igtlCodecCommonClasses.h>
   #include <igtlVideoMessage.h>
 #endif
 
+class IgtlMessageBodyReceiver;
 class vtkXMLDataElement;
 //class igsioTrackedFrame;
 class vtkPolyData;
 //class vtkIGSIOTransformRepository;
 class vtkIGSIOFrameConverter;
+class vtkStreamingVolumeFrame;
 
 /*!
 \class vtkPlusIgtlMessageCommon
@@ -55,13 +59,13 @@ public:
   /*! Pack tracked frame message from tracked frame */
   static PlusStatus PackTrackedFrameMessage(igtl::PlusTrackedFrameMessage::Pointer trackedFrameMessage, igsioTrackedFrame& trackedFrame, vtkSmartPointer<vtkMatrix4x4> embeddedImageTransform, const std::vector<igsioTransformName>& requestedTransforms);
 
-  /*! Unpack tracked frame message to tracked frame */
+  /*! Unpack tracked frame message to tracked frame. The message body is received in chunks directly into the tracked frame. */
   static PlusStatus UnpackTrackedFrameMessage(igtl::MessageHeader::Pointer headerMsg, igtl::Socket* socket, igsioTrackedFrame& trackedFrame, const igsioTransformName& embeddedTransformName, int crccheck);
 
   /*! Pack US message from tracked frame */
   static PlusStatus PackUsMessage(igtl::PlusUsMessage::Pointer usMessage, igsioTrackedFrame& trackedFrame);
 
-  /*! Unpack US message to tracked frame */
+  /*! Unpack US message to tracked frame. The message body is received in chunks directly into the tracked frame. */
   static PlusStatus UnpackUsMessage(igtl::MessageHeader::Pointer headerMsg, igtl::Socket* socket, igsioTrackedFrame& trackedFrame, int crccheck);
 
   /*! Pack image message from tracked frame */
@@ -70,15 +74,33 @@ public:
   /*! Pack image message from vtkImageData volume */
   static PlusStatus PackImageMessage(igtl::ImageMessage::Pointer imageMessage, vtkImageData* image, const vtkMatrix4x4& imageToReferenceTransform, double timestamp);
 
-  /*! Unpack image message to tracked frame */
+  /*! Unpack image message to tracked frame. The message body is received in chunks directly into the tracked frame. */
   static PlusStatus UnpackImageMessage(igtl::MessageHeader::Pointer headerMsg, igtl::Socket* socket, igsioTrackedFrame& trackedFrame, const igsioTransformName& embeddedTransformName, int crccheck);
 
+  /*!
+    Receive the rest of an image message, whose image header is already received, directly into the image of the tracked frame.
+    The timestamp is taken from the message header. Sub-volumes are not supported.
+  */
+  static PlusStatus ReceiveImageData(IgtlMessageBodyReceiver& receiver, igtl::MessageBase* headerMsg, const igtl_image_header& imageHeader, igsioTrackedFrame& trackedFrame, const igsioTransformName& embeddedTransformName);
+
+  /*! Unpack an already received and unpacked image message to tracked frame */
+  static PlusStatus UnpackImageMessage(igtl::ImageMessage::Pointer imgMsg, igsioTrackedFrame& trackedFrame, const igsioTransformName& embeddedTransformName);
+
+  /*! Get the IJKToRAS transform from the image header of an image message (in host byte order), without the image data */
+  static PlusStatus UnpackImageHeaderTransform(const igtl_image_header& imageHeader, vtkMatrix4x4* ijkToRasMatrix);
+
+  /*! Unpack compressed image message to tracked frame */
+  static PlusStatus UnpackCompressedImageMessage(igtl::MessageHeader::Pointer headerMsg, igtl::Socket* socket, igsioTrackedFrame& trackedFrame, const igsioTransformName& embeddedTransformName, int crccheck);
+
   /*! Pack image meta deta message from vtkPlusServer::ImageMetaDataList  */
   static PlusStatus PackImageMetaMessage(igtl::ImageMetaMessage::Pointer imageMetaMessage, igsioCommon::ImageMetaDataList& imageMetaDataList);
 
 #if defined(OpenIGTLink_ENABLE_VIDEOSTREAMING)
   /*! Pack video message from tracked frame */
   static PlusStatus PackVideoMessage(igtl::VideoMessage::Pointer imageMessage, igsioTrackedFrame& trackedFrame, vtkMatrix4x4& imageToReferenceTransform, vtkIGSIOFrameConverter* frameConverter = NULL, std::string codecFourCC = "", std::map<std::string, std::string> parameters = std::map<std::string, std::string>());
+
+  /*! Pack video message from an already encoded frame */
+  static PlusStatus PackVideoMessage(igtl::VideoMessage::Pointer videoMessage, vtkStreamingVolumeFrame* frame, vtkMatrix4x4& imageToReferenceTransform, double timestamp);
 #endif
 
   /*! Pack transform message from tracked frame */
@@ -91,6 +113,10 @@ public:
   /*! Pack data message from tracked frame */
   static PlusStatus PackTrackingDataMessage(igtl::TrackingDataMessage::Pointer tdataMessage, const std::vector<igsioTransformName>& names, const vtkIGSIOTransformRepository& repository, double timestamp);
 
+  /*! Pack data message from transforms that are already computed, matrices and statuses contain the transform of each name */
+  static PlusStatus PackTrackingDataMessage(igtl::TrackingDataMessage::Pointer tdataMessage, const std::vector<igsioTransformName>& names,
+      const std::vector<vtkMatrix4x4*>& matrices, const std::vector<ToolStatus>& statuses, double timestamp);
+
   /*! Unpack data message */
   static PlusStatus UnpackTrackingDataMessage(igtl::MessageHeader::Pointer headerMsg, igtl::Socket* socket,
       std::vector<igsioTransformName>& names, vtkIGSIOTransformRepository& repository, double& timestamp, int crccheck);
@@ -99,6 +125,10 @@ public:
   static PlusStatus UnpackTransformMessage(igtl::MessageHeader::Pointer headerMsg, igtl::Socket* socket,
       vtkMatrix4x4* transformMatrix, ToolStatus& toolStatus, std::string& transformName, double& timestamp, int crccheck);
 
+  /*! Get the transform from a transform message that is already unpacked (e.g., received in a UDP datagram) */
+  static PlusStatus UnpackTransformMessage(igtl::TransformMessage::Pointer transMsg,
+      vtkMatrix4x4* transformMatrix, ToolStatus& toolStatus, std::string& transformName, double& timestamp);
+
   /*! Pack position message from tracked frame */
   static PlusStatus PackPositionMessage(igtl::PositionMessage::Pointer positionMessage, igsioTransformName& transformName, ToolStatus status,
                                         float position[3], float quaternion[4], double timestamp);
@@ -107,6 +137,10 @@ public:
   static PlusStatus UnpackPositionMessage(igtl::MessageHeader::Pointer headerMsg, igtl::Socket* socket,
                                           vtkMatrix4x4* transformMatrix, std::string& transformName, ToolStatus& toolStatus, double& timestamp, int crccheck);
 
+  /*! Get the transform from a position message that is already unpacked (e.g., received in a UDP datagram) */
+  static PlusStatus UnpackPositionMessage(igtl::PositionMessage::Pointer posMsg,
+                                          vtkMatrix4x4* transformMatrix, std::string& transformName, ToolStatus& toolStatus, double& timestamp);
+
   /*! Pack string message */
   static PlusStatus PackStringMessage(igtl::StringMessage::Pointer stringMessage, const char* stringName, const char* stringValue, double timestamp);
   static PlusStatus PackStringMessage(igtl::StringMessage::Pointer stringMessage, const std::string& stringName, const std::string& stringValue, double timestamp);
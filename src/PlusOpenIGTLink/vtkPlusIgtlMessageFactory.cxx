@@ -5,9 +5,11 @@ See License.txt for details.
 =========================================================Plus=header=end*/
 
 #include "PlusConfigure.h"
+#include "PlusProfiler.h"
 
 #include "igsioTrackedFrame.h"
 #include "igsioVideoFrame.h"
+#include "vtkExtractVOI.h"
 #include "vtkImageData.h"
 #include "vtkNew.h"
 #include "vtkMatrix4x4.h"
@@ -17,6 +19,7 @@ See License.txt for details.
 #include "vtkIGSIOTrackedFrameList.h"
 #include "vtkIGSIOTransformRepository.h"
 #include "vtksys/SystemTools.hxx"
+#include <igtlioTransformConverter.h>
 #include <typeinfo>
 
 //----------------------------------------------------------------------------
@@ -24,8 +27,11 @@ See License.txt for details.
 #include "igtlCommandMessage.h"
 #include "igtlImageMessage.h"
 #include "igtlPlusClientInfoMessage.h"
+#include "igtlPlusCompressedImageMessage.h"
+#include "igtlPlusPointCloudMessage.h"
 #include "igtlPlusTrackedFrameMessage.h"
 #include "igtlPlusUsMessage.h"
+#include "igtlPolyDataMessage.h"
 #include "igtlPositionMessage.h"
 #include "igtlStatusMessage.h"
 #include "igtlTrackingDataMessage.h"
@@ -47,6 +53,66 @@ See License.txt for details.
 
 vtkStandardNewMacro(vtkPlusIgtlMessageFactory);
 
+const unsigned int vtkPlusIgtlMessageFactory::MAX_NUMBER_OF_POOLED_MESSAGES = 8;
+const unsigned int vtkPlusIgtlMessageFactory::MAX_NUMBER_OF_MESSAGE_POOLS = 16;
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Crop and downscale the image as requested in the streaming options of the client
+  vtkSmartPointer<vtkImageData> GetStreamedImage(vtkImageData* frameImage, const PlusIgtlClientInfo& clientInfo)
+  {
+    const PlusIgtlClientInfo::StreamingOptions& options = clientInfo.ImageStreamingOptions;
+    int voi[6] = { 0 };
+    frameImage->GetExtent(voi);
+    if (options.IsClipRectangleDefined())
+    {
+      for (int i = 0; i < 2; ++i)
+      {
+        int minimum = std::min(voi[2 * i] + std::max(options.ClipRectangleOrigin[i], 0), voi[2 * i + 1]);
+        voi[2 * i + 1] = std::min(minimum + options.ClipRectangleSize[i] - 1, voi[2 * i + 1]);
+        voi[2 * i] = minimum;
+      }
+    }
+    int downscaleFactor = clientInfo.GetEffectiveImageDownscaleFactor();
+
+    vtkSmartPointer<vtkExtractVOI> extractVoi = vtkSmartPointer<vtkExtractVOI>::New();
+    extractVoi->SetInputData(frameImage);
+    extractVoi->SetVOI(voi);
+    extractVoi->SetSampleRate(downscaleFactor, downscaleFactor, 1);
+    extractVoi->Update();
+
+    // The packed image starts at the first pixel of the extracted region, so move the origin there
+    vtkSmartPointer<vtkImageData> streamedImage = vtkSmartPointer<vtkImageData>::New();
+    streamedImage->ShallowCopy(extractVoi->GetOutput());
+    int extent[6] = { 0 };
+    double origin[3] = { 0 };
+    double spacing[3] = { 0 };
+    streamedImage->GetExtent(extent);
+    streamedImage->GetOrigin(origin);
+    streamedImage->GetSpacing(spacing);
+    for (int i = 0; i < 3; ++i)
+    {
+      origin[i] += extent[2 * i] * spacing[i];
+    }
+    streamedImage->SetExtent(0, extent[1] - extent[0], 0, extent[3] - extent[2], 0, extent[5] - extent[4]);
+    streamedImage->SetOrigin(origin);
+    return streamedImage;
+  }
+
+  //----------------------------------------------------------------------------
+  // Messages can be reused for images of the same type and size without reallocating their buffer
+  std::string GetImageMessagePoolKey(const std::string& messageType, int headerVersion, vtkImageData* image)
+  {
+    int dimensions[3] = { 0 };
+    image->GetDimensions(dimensions);
+    std::ostringstream key;
+    key << messageType << "_" << headerVersion << "_" << dimensions[0] << "x" << dimensions[1] << "x" << dimensions[2]
+        << "_" << image->GetScalarType() << "_" << image->GetNumberOfScalarComponents();
+    return key.str();
+  }
+}
+
 //----------------------------------------------------------------------------
 vtkPlusIgtlMessageFactory::vtkPlusIgtlMessageFactory()
   : IgtlFactory(igtl::MessageFactory::New())
@@ -54,6 +120,7 @@ vtkPlusIgtlMessageFactory::vtkPlusIgtlMessageFactory()
   this->IgtlFactory->AddMessageType("CLIENTINFO", (PointerToMessageBaseNew)&igtl::PlusClientInfoMessage::New);
   this->IgtlFactory->AddMessageType("TRACKEDFRAME", (PointerToMessageBaseNew)&igtl::PlusTrackedFrameMessage::New);
   this->IgtlFactory->AddMessageType("USMESSAGE", (PointerToMessageBaseNew)&igtl::PlusUsMessage::New);
+  this->IgtlFactory->AddMessageType("CIMAGE", (PointerToMessageBaseNew)&igtl::PlusCompressedImageMessage::New);
 }
 
 //----------------------------------------------------------------------------
@@ -142,6 +209,7 @@ igtl::MessageBase::Pointer vtkPlusIgtlMessageFactory::CreateSendMessage(const st
 PlusStatus vtkPlusIgtlMessageFactory::PackMessages(int clientId, const PlusIgtlClientInfo& clientInfo, std::vector<igtl::MessageBase::Pointer>& igtlMessages, igsioTrackedFrame& trackedFrame,
     bool packValidTransformsOnly, vtkIGSIOTransformRepository* transformRepository/*=NULL*/)
 {
+  PLUS_PROFILE_SCOPE("vtkPlusIgtlMessageFactory::PackMessages");
   int numberOfErrors(0);
   igtlMessages.clear();
 
@@ -150,6 +218,12 @@ PlusStatus vtkPlusIgtlMessageFactory::PackMessages(int clientId, const PlusIgtlC
     transformRepository->SetTransforms(trackedFrame);
   }
 
+  // TRANSFORM and TDATA messages are replaced by a single TDATA message if the client requests coalesced transforms
+  bool coalescedTransformsSubscribed(false);
+
+  // The requested transforms are computed once for all the message types
+  bool transformsResolved(false);
+
   for (std::vector<std::string>::const_iterator messageTypeIterator = clientInfo.IgtlMessageTypes.begin(); messageTypeIterator != clientInfo.IgtlMessageTypes.end(); ++ messageTypeIterator)
   {
     std::string messageType = (*messageTypeIterator);
@@ -171,27 +245,50 @@ PlusStatus vtkPlusIgtlMessageFactory::PackMessages(int clientId, const PlusIgtlC
       continue;
     }
 
+    if (!transformsResolved
+        && (typeid(*igtlMessage) == typeid(igtl::TransformMessage) || typeid(*igtlMessage) == typeid(igtl::TrackingDataMessage)
+            || typeid(*igtlMessage) == typeid(igtl::PositionMessage) || typeid(*igtlMessage) == typeid(igtl::PlusTrackedFrameMessage)))
+    {
+      this->ResolveTransforms(clientInfo, transformRepository);
+      transformsResolved = true;
+    }
+
+    if (clientInfo.GetCoalesceTransforms()
+        && (typeid(*igtlMessage) == typeid(igtl::TransformMessage) || typeid(*igtlMessage) == typeid(igtl::TrackingDataMessage)))
+    {
+      coalescedTransformsSubscribed = true;
+      continue;
+    }
+
     if (typeid(*igtlMessage) == typeid(igtl::ImageMessage))
     {
       numberOfErrors += PackImageMessage(clientInfo, *transformRepository, messageType, igtlMessage, trackedFrame, igtlMessages, clientId);
     }
+    else if (typeid(*igtlMessage) == typeid(igtl::PlusCompressedImageMessage))
+    {
+      numberOfErrors += PackCompressedImageMessage(clientInfo, *transformRepository, messageType, igtlMessage, trackedFrame, igtlMessages, clientId);
+    }
 #if defined(OpenIGTLink_ENABLE_VIDEOSTREAMING)
     else if (typeid(*igtlMessage) == typeid(igtl::VideoMessage))
     {
       numberOfErrors += PackVideoMessage(clientInfo, *transformRepository, messageType, igtlMessage, trackedFrame, igtlMessages, clientId);
     }
 #endif
+    else if (typeid(*igtlMessage) == typeid(igtl::PolyDataMessage))
+    {
+      numberOfErrors += PackPointCloudMessage(clientInfo, *transformRepository, messageType, trackedFrame, igtlMessages);
+    }
     else if (typeid(*igtlMessage) == typeid(igtl::TransformMessage))
     {
-      numberOfErrors += PackTransformMessage(clientInfo, *transformRepository, packValidTransformsOnly, igtlMessage, trackedFrame, igtlMessages);
+      numberOfErrors += PackTransformMessage(packValidTransformsOnly, igtlMessage, trackedFrame, igtlMessages);
     }
     else if (typeid(*igtlMessage) == typeid(igtl::TrackingDataMessage))
     {
-      numberOfErrors += PackTrackingDataMessage(clientInfo, trackedFrame, *transformRepository, packValidTransformsOnly, igtlMessage, igtlMessages);
+      numberOfErrors += PackTrackingDataMessage(clientInfo, trackedFrame, packValidTransformsOnly, igtlMessage, igtlMessages);
     }
     else if (typeid(*igtlMessage) == typeid(igtl::PositionMessage))
     {
-      numberOfErrors += PackPositionMessage(clientInfo, *transformRepository, igtlMessage, trackedFrame, igtlMessages);
+      numberOfErrors += PackPositionMessage(igtlMessage, trackedFrame, igtlMessages);
     }
     else if (typeid(*igtlMessage) == typeid(igtl::PlusTrackedFrameMessage))
     {
@@ -215,9 +312,48 @@ PlusStatus vtkPlusIgtlMessageFactory::PackMessages(int clientId, const PlusIgtlC
     }
   }
 
+  if (coalescedTransformsSubscribed)
+  {
+    numberOfErrors += PackCoalescedTrackingDataMessage(clientInfo, trackedFrame, packValidTransformsOnly, igtlMessages);
+  }
+
   return (numberOfErrors == 0 ? PLUS_SUCCESS : PLUS_FAIL);
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusIgtlMessageFactory::ResolveTransforms(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository* transformRepository)
+{
+  // The matrices of the previous frame are kept, so no matrices are allocated if the requested transforms do not change
+  this->ResolvedTransforms.resize(clientInfo.TransformNames.size());
+  for (size_t i = 0; i < clientInfo.TransformNames.size(); ++i)
+  {
+    ResolvedTransform& transform = this->ResolvedTransforms[i];
+    transform.Name = clientInfo.TransformNames[i];
+    if (transform.Matrix == NULL)
+    {
+      transform.Matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    }
+    transform.Matrix->Identity();
+    transform.Status = TOOL_INVALID;
+    transform.Found = (transformRepository != NULL && transformRepository->GetTransform(transform.Name, transform.Matrix, &transform.Status) == PLUS_SUCCESS);
+    if (!transform.Found)
+    {
+      transform.Status = TOOL_INVALID;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusIgtlMessageFactory::GetIgtlMatrix(const ResolvedTransform& transform, igtl::Matrix4x4& igtlMatrix)
+{
+  if (!transform.Found || transform.Status != TOOL_OK)
+  {
+    igtl::IdentityMatrix(igtlMatrix);
+    return;
+  }
+  igtlioTransformConverter::VTKToIGTLTransform(*transform.Matrix, igtlMatrix);
+}
+
 //----------------------------------------------------------------------------
 int vtkPlusIgtlMessageFactory::PackCommandMessage(igtl::MessageBase::Pointer igtlMessage, std::vector<igtl::MessageBase::Pointer>& igtlMessages)
 {
@@ -240,6 +376,11 @@ int vtkPlusIgtlMessageFactory::PackStringMessage(const PlusIgtlClientInfo& clien
       // no value is available, do not send anything
       continue;
     }
+    if (!clientInfo.IsStringFieldDue(*stringNameIterator, stringValue, trackedFrame.GetTimestamp()))
+    {
+      // the client has already received this value
+      continue;
+    }
     igtl::StringMessage::Pointer stringMessage = dynamic_cast<igtl::StringMessage*>(igtlMessage->Clone().GetPointer());
     vtkPlusIgtlMessageCommon::PackStringMessage(stringMessage, *stringNameIterator, stringValue, trackedFrame.GetTimestamp());
     igtlMessages.push_back(stringMessage.GetPointer());
@@ -268,13 +409,10 @@ int vtkPlusIgtlMessageFactory::PackTrackedFrameMessage(igtl::MessageBase::Pointe
   int numberOfErrors(0);
   igtl::PlusTrackedFrameMessage::Pointer trackedFrameMessage = dynamic_cast<igtl::PlusTrackedFrameMessage*>(igtlMessage->Clone().GetPointer());
 
-  for (auto nameIter = clientInfo.TransformNames.begin(); nameIter != clientInfo.TransformNames.end(); ++nameIter)
+  for (std::vector<ResolvedTransform>::const_iterator transformIter = this->ResolvedTransforms.begin(); transformIter != this->ResolvedTransforms.end(); ++transformIter)
   {
-    ToolStatus status(TOOL_INVALID);
-    vtkSmartPointer<vtkMatrix4x4> matrix(vtkSmartPointer<vtkMatrix4x4>::New());
-    transformRepository.GetTransform(*nameIter, matrix, &status);
-    trackedFrame.SetFrameTransform(*nameIter, matrix);
-    trackedFrame.SetFrameTransformStatus(*nameIter, status);
+    trackedFrame.SetFrameTransform(transformIter->Name, transformIter->Matrix);
+    trackedFrame.SetFrameTransformStatus(transformIter->Name, transformIter->Status);
   }
 
   vtkSmartPointer<vtkMatrix4x4> imageMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
@@ -300,9 +438,9 @@ int vtkPlusIgtlMessageFactory::PackTrackedFrameMessage(igtl::MessageBase::Pointe
 }
 
 //----------------------------------------------------------------------------
-int vtkPlusIgtlMessageFactory::PackPositionMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages)
+int vtkPlusIgtlMessageFactory::PackPositionMessage(igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages)
 {
-  for (std::vector<igsioTransformName>::const_iterator transformNameIterator = clientInfo.TransformNames.begin(); transformNameIterator != clientInfo.TransformNames.end(); ++transformNameIterator)
+  for (std::vector<ResolvedTransform>::iterator transformIterator = this->ResolvedTransforms.begin(); transformIterator != this->ResolvedTransforms.end(); ++transformIterator)
   {
     /*
       Advantage of using position message type:
@@ -310,20 +448,15 @@ int vtkPlusIgtlMessageFactory::PackPositionMessage(const PlusIgtlClientInfo& cli
       the POSITION data type has the advantage of smaller data size (19%). It is therefore more suitable for
       pushing high frame-rate data from tracking devices.
     */
-    igsioTransformName transformName = (*transformNameIterator);
     igtl::Matrix4x4 igtlMatrix;
-    vtkPlusIgtlMessageCommon::GetIgtlMatrix(igtlMatrix, &transformRepository, transformName);
-
-    ToolStatus status;
-    vtkNew<vtkMatrix4x4> temp;
-    transformRepository.GetTransform(transformName, temp.GetPointer(), &status);
+    GetIgtlMatrix(*transformIterator, igtlMatrix);
 
     float position[3] = { igtlMatrix[0][3], igtlMatrix[1][3], igtlMatrix[2][3] };
     float quaternion[4] = { 0, 0, 0, 1 };
     igtl::MatrixToQuaternion(igtlMatrix, quaternion);
 
     igtl::PositionMessage::Pointer positionMessage = dynamic_cast<igtl::PositionMessage*>(igtlMessage->Clone().GetPointer());
-    vtkPlusIgtlMessageCommon::PackPositionMessage(positionMessage, transformName, status, position, quaternion, trackedFrame.GetTimestamp());
+    vtkPlusIgtlMessageCommon::PackPositionMessage(positionMessage, transformIterator->Name, transformIterator->Status, position, quaternion, trackedFrame.GetTimestamp());
     igtlMessages.push_back(positionMessage.GetPointer());
   }
 
@@ -331,46 +464,80 @@ int vtkPlusIgtlMessageFactory::PackPositionMessage(const PlusIgtlClientInfo& cli
 }
 
 //----------------------------------------------------------------------------
-int vtkPlusIgtlMessageFactory::PackTrackingDataMessage(const PlusIgtlClientInfo& clientInfo, igsioTrackedFrame& trackedFrame, vtkIGSIOTransformRepository& transformRepository, bool packValidTransformsOnly, igtl::MessageBase::Pointer igtlMessage, std::vector<igtl::MessageBase::Pointer>& igtlMessages)
+int vtkPlusIgtlMessageFactory::PackTrackingDataMessage(const PlusIgtlClientInfo& clientInfo, igsioTrackedFrame& trackedFrame, bool packValidTransformsOnly, igtl::MessageBase::Pointer igtlMessage, std::vector<igtl::MessageBase::Pointer>& igtlMessages)
 {
   if (clientInfo.GetTDATARequested() && clientInfo.GetLastTDATASentTimeStamp() + clientInfo.GetTDATAResolution() < trackedFrame.GetTimestamp())
   {
     std::vector<igsioTransformName> names;
+    std::vector<vtkMatrix4x4*> matrices;
+    std::vector<ToolStatus> statuses;
+    GetTrackingDataTransforms(packValidTransformsOnly, names, matrices, statuses);
 
-    std::map<std::string, vtkSmartPointer<vtkMatrix4x4> > transforms;
-    for (std::vector<igsioTransformName>::const_iterator transformNameIterator = clientInfo.TransformNames.begin(); transformNameIterator != clientInfo.TransformNames.end(); ++transformNameIterator)
-    {
-      igsioTransformName transformName = (*transformNameIterator);
+    igtl::TrackingDataMessage::Pointer trackingDataMessage = dynamic_cast<igtl::TrackingDataMessage*>(igtlMessage->Clone().GetPointer());
+    vtkPlusIgtlMessageCommon::PackTrackingDataMessage(trackingDataMessage, names, matrices, statuses, trackedFrame.GetTimestamp());
+    igtlMessages.push_back(trackingDataMessage.GetPointer());
+  }
+  return 0; // no errors possible for this message type
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusIgtlMessageFactory::PackCoalescedTrackingDataMessage(const PlusIgtlClientInfo& clientInfo, igsioTrackedFrame& trackedFrame, bool packValidTransformsOnly, std::vector<igtl::MessageBase::Pointer>& igtlMessages)
+{
+  if (!clientInfo.IsCoalescedTransformsDue(trackedFrame.GetTimestamp()))
+  {
+    return 0;
+  }
 
-      ToolStatus status(TOOL_INVALID);
-      vtkSmartPointer<vtkMatrix4x4> mat = vtkSmartPointer<vtkMatrix4x4>::New();
-      transformRepository.GetTransform(transformName, mat, &status);
+  std::vector<igsioTransformName> names;
+  std::vector<vtkMatrix4x4*> matrices;
+  std::vector<ToolStatus> statuses;
+  GetTrackingDataTransforms(packValidTransformsOnly, names, matrices, statuses);
+  if (names.empty())
+  {
+    return 0;
+  }
 
-      if (status != TOOL_OK && packValidTransformsOnly)
-      {
-        LOG_TRACE("Attempted to send invalid transform over IGT Link when server has prevented sending.");
-        continue;
-      }
+  igtl::MessageBase::Pointer igtlMessage = this->CreateSendMessage("TDATA", clientInfo.GetClientHeaderVersion());
+  igtl::TrackingDataMessage::Pointer trackingDataMessage = dynamic_cast<igtl::TrackingDataMessage*>(igtlMessage.GetPointer());
+  if (trackingDataMessage.IsNull())
+  {
+    LOG_ERROR("Failed to pack IGT messages - unable to create TDATA message for coalesced transforms");
+    return 1;
+  }
+  // The status of each transform is stored in the meta data, so invalid transforms can be sent in the same message
+  vtkPlusIgtlMessageCommon::PackTrackingDataMessage(trackingDataMessage, names, matrices, statuses, trackedFrame.GetTimestamp());
+  igtlMessages.push_back(trackingDataMessage.GetPointer());
+  return 0;
+}
 
-      names.push_back(transformName);
+//----------------------------------------------------------------------------
+void vtkPlusIgtlMessageFactory::GetTrackingDataTransforms(bool packValidTransformsOnly, std::vector<igsioTransformName>& names, std::vector<vtkMatrix4x4*>& matrices, std::vector<ToolStatus>& statuses)
+{
+  for (std::vector<ResolvedTransform>::const_iterator transformIterator = this->ResolvedTransforms.begin(); transformIterator != this->ResolvedTransforms.end(); ++transformIterator)
+  {
+    if (packValidTransformsOnly && transformIterator->Status != TOOL_OK)
+    {
+      LOG_TRACE("Attempted to send invalid transform over IGT Link when server has prevented sending.");
+      continue;
     }
-
-    igtl::TrackingDataMessage::Pointer trackingDataMessage = dynamic_cast<igtl::TrackingDataMessage*>(igtlMessage->Clone().GetPointer());
-    vtkPlusIgtlMessageCommon::PackTrackingDataMessage(trackingDataMessage, names, transformRepository, trackedFrame.GetTimestamp());
-    igtlMessages.push_back(trackingDataMessage.GetPointer());
+    if (!transformIterator->Found)
+    {
+      LOG_ERROR("Transform " << transformIterator->Name.From() << "To" << transformIterator->Name.To() << " not found in repository.");
+      continue;
+    }
+    names.push_back(transformIterator->Name);
+    matrices.push_back(transformIterator->Matrix);
+    statuses.push_back(transformIterator->Status);
   }
-  return 0; // no errors possible for this message type
 }
 
 //----------------------------------------------------------------------------
-int vtkPlusIgtlMessageFactory::PackTransformMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, bool packValidTransformsOnly, igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages)
+int vtkPlusIgtlMessageFactory::PackTransformMessage(bool packValidTransformsOnly, igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages)
 {
-  for (std::vector<igsioTransformName>::const_iterator transformNameIterator = clientInfo.TransformNames.begin(); transformNameIterator != clientInfo.TransformNames.end(); ++transformNameIterator)
+  for (std::vector<ResolvedTransform>::iterator transformIterator = this->ResolvedTransforms.begin(); transformIterator != this->ResolvedTransforms.end(); ++transformIterator)
   {
-    igsioTransformName transformName = (*transformNameIterator);
-    ToolStatus status(TOOL_UNKNOWN);
-    vtkNew<vtkMatrix4x4> temp;
-    transformRepository.GetTransform(transformName, temp.GetPointer(), &status);
+    igsioTransformName& transformName = transformIterator->Name;
+    ToolStatus status = transformIterator->Status;
 
     if (status != TOOL_OK && packValidTransformsOnly)
     {
@@ -379,7 +546,7 @@ int vtkPlusIgtlMessageFactory::PackTransformMessage(const PlusIgtlClientInfo& cl
     }
 
     igtl::Matrix4x4 igtlMatrix;
-    vtkPlusIgtlMessageCommon::GetIgtlMatrix(igtlMatrix, &transformRepository, transformName);
+    GetIgtlMatrix(*transformIterator, igtlMatrix);
     igtl::TransformMessage::Pointer transformMessage = dynamic_cast<igtl::TransformMessage*>(igtlMessage->Clone().GetPointer()); 
     igsioFieldMapType frameFields = trackedFrame.GetFrameFields();
     for (igsioFieldMapType::iterator iter = frameFields.begin(); iter != frameFields.end(); ++iter)
@@ -401,10 +568,62 @@ int vtkPlusIgtlMessageFactory::PackTransformMessage(const PlusIgtlClientInfo& cl
   return 0; // no errors possible in this message type
 }
 
+//----------------------------------------------------------------------------
+igtl::MessageBase::Pointer vtkPlusIgtlMessageFactory::GetPooledMessage(igtl::MessageBase::Pointer prototypeMessage, const std::string& poolKey, const std::vector<std::string>& metaDataKeys)
+{
+  std::map<std::string, std::vector<igtl::MessageBase::Pointer> >::iterator poolIterator = this->MessagePool.find(poolKey);
+  if (poolIterator == this->MessagePool.end())
+  {
+    if (this->MessagePool.size() >= MAX_NUMBER_OF_MESSAGE_POOLS)
+    {
+      // Image sizes have changed, messages of the old sizes are not needed anymore
+      this->MessagePool.clear();
+    }
+    poolIterator = this->MessagePool.insert(std::make_pair(poolKey, std::vector<igtl::MessageBase::Pointer>())).first;
+  }
+  std::vector<igtl::MessageBase::Pointer>& pooledMessages = poolIterator->second;
+
+  for (std::vector<igtl::MessageBase::Pointer>::iterator messageIterator = pooledMessages.begin(); messageIterator != pooledMessages.end(); ++messageIterator)
+  {
+    // The message can be reused if only the pool refers to it (it is not waiting to be sent to any client)
+    // and it has the same meta data elements, as meta data elements cannot be removed from a message
+    if ((*messageIterator)->GetReferenceCount() != 1 || (*messageIterator)->GetMetaData().size() != metaDataKeys.size())
+    {
+      continue;
+    }
+    bool sameMetaDataKeys = true;
+    for (std::vector<std::string>::const_iterator keyIterator = metaDataKeys.begin(); keyIterator != metaDataKeys.end(); ++keyIterator)
+    {
+      if ((*messageIterator)->GetMetaData().find(*keyIterator) == (*messageIterator)->GetMetaData().end())
+      {
+        sameMetaDataKeys = false;
+        break;
+      }
+    }
+    if (sameMetaDataKeys)
+    {
+      return *messageIterator;
+    }
+  }
+
+  igtl::MessageBase::Pointer message = prototypeMessage->Clone();
+  if (pooledMessages.size() < MAX_NUMBER_OF_POOLED_MESSAGES)
+  {
+    pooledMessages.push_back(message);
+  }
+  return message;
+}
+
 //----------------------------------------------------------------------------
 int vtkPlusIgtlMessageFactory::PackImageMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, const std::string& messageType, igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages, int clientId)
 {
   int numberOfErrors = 0;
+  if (!clientInfo.IsImageFrameDue(trackedFrame.GetTimestamp()))
+  {
+    // Image frame rate is limited for this client
+    return numberOfErrors;
+  }
+  bool imageResamplingRequired = clientInfo.ImageStreamingOptions.IsClipRectangleDefined() || clientInfo.GetEffectiveImageDownscaleFactor() > 1;
   for (std::vector<PlusIgtlClientInfo::ImageStream>::const_iterator imageStreamIterator = clientInfo.ImageStreams.begin(); imageStreamIterator != clientInfo.ImageStreams.end(); ++imageStreamIterator)
   {
     PlusIgtlClientInfo::ImageStream imageStream = (*imageStreamIterator);
@@ -422,18 +641,16 @@ int vtkPlusIgtlMessageFactory::PackImageMessage(const PlusIgtlClientInfo& client
     }
 
     std::string deviceName = imageTransformName.From() + std::string("_") + imageTransformName.To();
-
-    igtl::ImageMessage::Pointer imageMessage = dynamic_cast<igtl::ImageMessage*>(igtlMessage->Clone().GetPointer());
     if (trackedFrame.IsFrameFieldDefined(igsioTrackedFrame::FIELD_FRIENDLY_DEVICE_NAME))
     {
       // Allow overriding of device name with something human readable
       // The transform name is passed in the metadata
       deviceName = trackedFrame.GetFrameField(igsioTrackedFrame::FIELD_FRIENDLY_DEVICE_NAME);
     }
-    imageMessage->SetDeviceName(deviceName.c_str());
 
     // Send igsioTrackedFrame::CustomFrameFields as meta data in the image message.
     std::vector<std::string> frameFields;
+    std::vector<std::string> metaDataKeys;
     trackedFrame.GetFrameFieldNameList(frameFields);
     for (std::vector<std::string>::const_iterator stringNameIterator = frameFields.begin(); stringNameIterator != frameFields.end(); ++stringNameIterator)
     {
@@ -443,10 +660,48 @@ int vtkPlusIgtlMessageFactory::PackImageMessage(const PlusIgtlClientInfo& client
         LOG_WARNING("No metadata value for: " << *stringNameIterator)
         continue;
       }
-      imageMessage->SetMetaDataElement(*stringNameIterator, IANA_TYPE_US_ASCII, trackedFrame.GetFrameField(*stringNameIterator));
+      metaDataKeys.push_back(*stringNameIterator);
+    }
+
+    vtkSmartPointer<vtkIGSIOFrameConverter> converter = imageStream.FrameConverter;
+    if (!converter)
+    {
+      converter = vtkSmartPointer<vtkIGSIOFrameConverter>::New();
+    }
+    vtkSmartPointer<vtkImageData> frameImage;
+    if (trackedFrame.GetImageData()->IsImageValid())
+    {
+      frameImage = converter->GetImageData(trackedFrame.GetImageData());
+      if (frameImage != nullptr && imageResamplingRequired)
+      {
+        frameImage = GetStreamedImage(frameImage, clientInfo);
+      }
+    }
+    if (frameImage == nullptr)
+    {
+      LOG_ERROR("Failed to create " << messageType << " message - image data is NOT valid");
+      numberOfErrors++;
+      continue;
+    }
+
+    // The image is packed directly into the buffer of a reused message
+    igtl::ImageMessage::Pointer imageMessage = dynamic_cast<igtl::ImageMessage*>(this->GetPooledMessage(igtlMessage, GetImageMessagePoolKey(messageType, clientInfo.GetClientHeaderVersion(), frameImage), metaDataKeys).GetPointer());
+    imageMessage->SetDeviceName(deviceName.c_str());
+    for (std::vector<std::string>::const_iterator keyIterator = metaDataKeys.begin(); keyIterator != metaDataKeys.end(); ++keyIterator)
+    {
+      imageMessage->SetMetaDataElement(*keyIterator, IANA_TYPE_US_ASCII, trackedFrame.GetFrameField(*keyIterator));
     }
 
-    if (vtkPlusIgtlMessageCommon::PackImageMessage(imageMessage, trackedFrame, *matrix, imageStream.FrameConverter) != PLUS_SUCCESS)
+    PlusStatus packStatus = PLUS_FAIL;
+    if (imageResamplingRequired)
+    {
+      packStatus = vtkPlusIgtlMessageCommon::PackImageMessage(imageMessage, frameImage, *matrix, trackedFrame.GetTimestamp());
+    }
+    else
+    {
+      packStatus = vtkPlusIgtlMessageCommon::PackImageMessage(imageMessage, trackedFrame, *matrix, converter);
+    }
+    if (packStatus != PLUS_SUCCESS)
     {
       LOG_ERROR("Failed to create " << messageType << " message - unable to pack image message");
       numberOfErrors++;
@@ -457,11 +712,101 @@ int vtkPlusIgtlMessageFactory::PackImageMessage(const PlusIgtlClientInfo& client
   return numberOfErrors;
 }
 
+//----------------------------------------------------------------------------
+int vtkPlusIgtlMessageFactory::PackPointCloudMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, const std::string& messageType, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages)
+{
+  int numberOfErrors = 0;
+  if (!clientInfo.IsImageFrameDue(trackedFrame.GetTimestamp()))
+  {
+    // Image frame rate is limited for this client
+    return numberOfErrors;
+  }
+
+  // Point clouds are stored as single row images of 3 float components (point coordinates), see vtkPlusIntelRealSense
+  igsioVideoFrame* frame = trackedFrame.GetImageData();
+  FrameSizeType frameSize = frame->GetFrameSize();
+  if (!frame->IsImageValid() || frame->GetVTKScalarPixelType() != VTK_FLOAT || frame->GetNumberOfScalarComponents() != 3 || frameSize[1] != 1 || frameSize[2] != 1)
+  {
+    // Not a point cloud, the client may have requested POLYDATA for another channel
+    return numberOfErrors;
+  }
+
+  for (std::vector<PlusIgtlClientInfo::ImageStream>::const_iterator imageStreamIterator = clientInfo.ImageStreams.begin(); imageStreamIterator != clientInfo.ImageStreams.end(); ++imageStreamIterator)
+  {
+    // The points are transformed by [Name]To[EmbeddedTransformToFrame], as POLYDATA messages have no transform
+    igsioTransformName pointCloudTransformName = igsioTransformName(imageStreamIterator->Name, imageStreamIterator->EmbeddedTransformToFrame);
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    ToolStatus status;
+    if (transformRepository.GetTransform(pointCloudTransformName, matrix.Get(), &status) != PLUS_SUCCESS)
+    {
+      LOG_WARNING("Failed to create " << messageType << " message: cannot get point cloud transform. ToolStatus: " << status);
+      numberOfErrors++;
+      continue;
+    }
+
+    std::string deviceName = pointCloudTransformName.From() + std::string("_") + pointCloudTransformName.To();
+    if (trackedFrame.IsFrameFieldDefined(igsioTrackedFrame::FIELD_FRIENDLY_DEVICE_NAME))
+    {
+      deviceName = trackedFrame.GetFrameField(igsioTrackedFrame::FIELD_FRIENDLY_DEVICE_NAME);
+    }
+
+    // The points are written directly into a reused message, instead of building a polydata for each frame
+    igtl::PlusPointCloudMessage::Pointer prototypeMessage = igtl::PlusPointCloudMessage::New();
+    prototypeMessage->SetHeaderVersion(clientInfo.GetClientHeaderVersion());
+    std::ostringstream poolKey;
+    poolKey << "PLUSPOINTCLOUD_v" << clientInfo.GetClientHeaderVersion() << "_" << frameSize[0];
+    igtl::PlusPointCloudMessage::Pointer pointCloudMessage = dynamic_cast<igtl::PlusPointCloudMessage*>(this->GetPooledMessage(prototypeMessage.GetPointer(), poolKey.str(), std::vector<std::string>()).GetPointer());
+
+    pointCloudMessage->SetDeviceName(deviceName.c_str());
+    igtl::TimeStamp::Pointer timestamp = igtl::TimeStamp::New();
+    timestamp->SetTime(trackedFrame.GetTimestamp());
+    pointCloudMessage->SetTimeStamp(timestamp);
+    pointCloudMessage->SetPoints(static_cast<const float*>(frame->GetScalarPointer()), frameSize[0], matrix->IsIdentity() ? NULL : &matrix->Element[0][0]);
+    pointCloudMessage->Pack();
+    igtlMessages.push_back(pointCloudMessage.GetPointer());
+  }
+  return numberOfErrors;
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusIgtlMessageFactory::PackCompressedImageMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, const std::string& messageType, igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages, int clientId)
+{
+  // Pack the images into IMAGE messages first, so that the geometry, meta data and streaming options are the same as in IMAGE messages
+  igtl::MessageBase::Pointer imagePrototypeMessage = this->IgtlFactory->CreateSendMessage("IMAGE", igtlMessage->GetHeaderVersion());
+  std::vector<igtl::MessageBase::Pointer> imageMessages;
+  int numberOfErrors = PackImageMessage(clientInfo, transformRepository, messageType, imagePrototypeMessage, trackedFrame, imageMessages, clientId);
+  for (std::vector<igtl::MessageBase::Pointer>::iterator imageMessageIt = imageMessages.begin(); imageMessageIt != imageMessages.end(); ++imageMessageIt)
+  {
+    igtl::ImageMessage::Pointer imageMessage = dynamic_cast<igtl::ImageMessage*>(imageMessageIt->GetPointer());
+    igtl::PlusCompressedImageMessage::Pointer compressedImageMessage = dynamic_cast<igtl::PlusCompressedImageMessage*>(this->IgtlFactory->CreateSendMessage(messageType, igtlMessage->GetHeaderVersion()).GetPointer());
+    if (compressedImageMessage->SetImageMessage(imageMessage, this->ImageMessageCompressor) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to create " << messageType << " message - unable to compress image");
+      numberOfErrors++;
+      continue;
+    }
+    for (igtl::MessageBase::MetaDataMap::const_iterator metaDataIt = imageMessage->GetMetaData().begin(); metaDataIt != imageMessage->GetMetaData().end(); ++metaDataIt)
+    {
+      compressedImageMessage->SetMetaDataElement(metaDataIt->first, metaDataIt->second.first, metaDataIt->second.second);
+    }
+    compressedImageMessage->Pack();
+    LOG_TRACE("Image of " << compressedImageMessage->GetDeviceName() << " compressed from " << compressedImageMessage->GetUncompressedImageSize()
+              << " to " << compressedImageMessage->GetCompressedImageSize() << " bytes");
+    igtlMessages.push_back(compressedImageMessage.GetPointer());
+  }
+  return numberOfErrors;
+}
+
 #if defined(OpenIGTLink_ENABLE_VIDEOSTREAMING)
 //----------------------------------------------------------------------------
 int vtkPlusIgtlMessageFactory::PackVideoMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, const std::string& messageType, igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages, int clientId)
 {
   int numberOfErrors = 0;
+  if (!clientInfo.IsImageFrameDue(trackedFrame.GetTimestamp()))
+  {
+    // Image frame rate is limited for this client
+    return numberOfErrors;
+  }
   for (std::vector<PlusIgtlClientInfo::VideoStream>::const_iterator videoStreamIterator = clientInfo.VideoStreams.begin(); videoStreamIterator != clientInfo.VideoStreams.end(); ++videoStreamIterator)
   {
     PlusIgtlClientInfo::VideoStream videoStream = (*videoStreamIterator);
@@ -478,31 +823,13 @@ int vtkPlusIgtlMessageFactory::PackVideoMessage(const PlusIgtlClientInfo& client
     }
 
     std::string deviceName = imageTransformName.From() + std::string("_") + imageTransformName.To();
-
-    igtl::VideoMessage::Pointer videoMessage = dynamic_cast<igtl::VideoMessage*>(igtlMessage->Clone().GetPointer());
     if (trackedFrame.IsFrameFieldDefined(igsioTrackedFrame::FIELD_FRIENDLY_DEVICE_NAME))
     {
       // Allow overriding of device name with something human readable
       // The transform name is passed in the metadata
       deviceName = trackedFrame.GetFrameField(igsioTrackedFrame::FIELD_FRIENDLY_DEVICE_NAME);
     }
-    videoMessage->SetDeviceName(deviceName.c_str());
 
-    // Send igsioTrackedFrame::CustomFrameFields as meta data in the image message.
-    std::vector<std::string> frameFields;
-    trackedFrame.GetFrameFieldNameList(frameFields);
-    for (std::vector<std::string>::const_iterator stringNameIterator = frameFields.begin(); stringNameIterator != frameFields.end(); ++stringNameIterator)
-    {
-      if (trackedFrame.GetFrameField(*stringNameIterator).empty())
-      {
-        // No value is available, do not send anything
-        LOG_WARNING("No metadata value for: " << *stringNameIterator);
-        continue;
-      }
-      videoMessage->SetMetaDataElement(*stringNameIterator, IANA_TYPE_US_ASCII, trackedFrame.GetFrameField(*stringNameIterator));
-    }
-    videoMessage = igtl::VideoMessage::New();
-    videoMessage->SetDeviceName(deviceName.c_str());
     std::map<std::string, std::string> parameters;
     parameters["losslessEncoding"] = videoStream.EncodeVideoParameters.Lossless ? "1" : "0";
     if (!videoStream.EncodeVideoParameters.Lossless)
@@ -515,14 +842,115 @@ int vtkPlusIgtlMessageFactory::PackVideoMessage(const PlusIgtlClientInfo& client
       parameters["deadlineMode"] = videoStream.EncodeVideoParameters.DeadlineMode;
     }
 
-    if (vtkPlusIgtlMessageCommon::PackVideoMessage(videoMessage, trackedFrame, *matrix, videoStream.FrameConverter, videoStream.EncodeVideoParameters.FourCC, parameters) != PLUS_SUCCESS)
+    igsioVideoFrame* videoFrame = trackedFrame.GetImageData();
+    if (videoFrame->IsFrameEncoded() && videoFrame->GetEncodedFrame() != NULL
+        && (videoStream.EncodeVideoParameters.FourCC.empty() || videoStream.EncodeVideoParameters.FourCC == videoFrame->GetEncodedFrame()->GetCodecFourCC()))
     {
-      LOG_ERROR("Failed to create " << messageType << " message - unable to pack image message");
+      // The frame has been encoded already (e.g., by vtkPlusVirtualVideoEncoder), send it as is.
+      // The index is 0 until the first key frame is sent to the client, the client cannot decode the frames before it.
+      std::string forwardKey = "Encoded:" + imageTransformName.GetTransformName();
+      unsigned long& lastPackedIndex = this->LastPackedVideoFrameIndices[std::make_pair(clientId, forwardKey)];
+      if (lastPackedIndex == 0 && videoFrame->GetEncodedFrame()->GetFrameType() != vtkStreamingVolumeFrame::IFrame)
+      {
+        continue;
+      }
+      lastPackedIndex = 1;
+      igtl::VideoMessage::Pointer videoMessage = igtl::VideoMessage::New();
+      videoMessage->SetDeviceName(deviceName.c_str());
+      if (vtkPlusIgtlMessageCommon::PackVideoMessage(videoMessage, videoFrame->GetEncodedFrame(), *matrix, trackedFrame.GetTimestamp()) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to create " << messageType << " message - unable to pack video message");
+        numberOfErrors++;
+        continue;
+      }
+      igtlMessages.push_back(videoMessage.GetPointer());
+      continue;
+    }
+
+    if (!trackedFrame.GetImageData()->IsImageValid())
+    {
+      LOG_ERROR("Failed to create " << messageType << " message - image data is NOT valid");
+      numberOfErrors++;
+      continue;
+    }
+    std::string codecFourCC = videoStream.EncodeVideoParameters.FourCC;
+    if (codecFourCC.empty() && trackedFrame.GetImageData()->GetEncodedFrame())
+    {
+      codecFourCC = trackedFrame.GetImageData()->GetEncodedFrame()->GetCodecFourCC();
+    }
+    if (codecFourCC.empty())
+    {
+      LOG_ERROR("Failed to create " << messageType << " message - unknown frame encoding");
       numberOfErrors++;
       continue;
     }
-    igtlMessages.push_back(videoMessage.GetPointer());
+
+    // Encoding runs on the encoder thread of the stream, the frames that have been encoded since the last call are sent now.
+    // The frame is encoded only once for all the clients that request the same stream with the same codec configuration.
+    std::string encoderKey = VideoEncoderPool::GetEncoderKey(imageTransformName.GetTransformName(), codecFourCC, parameters);
+    if (this->VideoEncoders.EncodeFrame(encoderKey, *trackedFrame.GetImageData(), trackedFrame.GetTimestamp(), deviceName, *matrix, codecFourCC, parameters) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to create " << messageType << " message - unable to queue frame for encoding");
+      numberOfErrors++;
+      continue;
+    }
+    std::vector<VideoEncoderPool::EncodedFrame> encodedFrames;
+    this->VideoEncoders.GetEncodedFrames(encoderKey, this->LastPackedVideoFrameIndices[std::make_pair(clientId, encoderKey)], encodedFrames);
+    for (std::vector<VideoEncoderPool::EncodedFrame>::iterator encodedFrameIt = encodedFrames.begin(); encodedFrameIt != encodedFrames.end(); ++encodedFrameIt)
+    {
+      igtl::VideoMessage::Pointer videoMessage = igtl::VideoMessage::New();
+      videoMessage->SetDeviceName(encodedFrameIt->DeviceName.c_str());
+      if (vtkPlusIgtlMessageCommon::PackVideoMessage(videoMessage, encodedFrameIt->Frame, *encodedFrameIt->ImageToReferenceTransform, encodedFrameIt->Timestamp) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to create " << messageType << " message - unable to pack video message");
+        numberOfErrors++;
+        continue;
+      }
+      igtlMessages.push_back(videoMessage.GetPointer());
+    }
   }
   return numberOfErrors;
 }
 #endif
+
+//----------------------------------------------------------------------------
+void vtkPlusIgtlMessageFactory::RequestVideoKeyFrames(int clientId)
+{
+  // Packing restarts from the next key frame
+  for (std::map<std::pair<int, std::string>, unsigned long>::iterator indexIt = this->LastPackedVideoFrameIndices.begin(); indexIt != this->LastPackedVideoFrameIndices.end(); ++indexIt)
+  {
+    if (indexIt->first.first == clientId)
+    {
+      indexIt->second = 0;
+      this->VideoEncoders.RequestKeyFrame(indexIt->first.second);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusIgtlMessageFactory::RemoveClient(int clientId)
+{
+  for (std::map<std::pair<int, std::string>, unsigned long>::iterator indexIt = this->LastPackedVideoFrameIndices.begin(); indexIt != this->LastPackedVideoFrameIndices.end();)
+  {
+    if (indexIt->first.first == clientId)
+    {
+      indexIt = this->LastPackedVideoFrameIndices.erase(indexIt);
+    }
+    else
+    {
+      ++indexIt;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusIgtlMessageFactory::SetNumberOfImageCompressionThreads(unsigned int numberOfThreads)
+{
+  this->ImageMessageCompressor.SetNumberOfThreads(numberOfThreads);
+}
+
+//----------------------------------------------------------------------------
+unsigned int vtkPlusIgtlMessageFactory::GetNumberOfImageCompressionThreads() const
+{
+  return this->ImageMessageCompressor.GetNumberOfThreads();
+}
@@ -12,14 +12,23 @@
 
 // VTK includes
 #include "vtkObject.h"
+#include "vtkSmartPointer.h"
 
 // OpenIGTLink includes
+#include "igtlMath.h"
 #include "igtlMessageBase.h"
 #include "igtlMessageFactory.h"
 
+// STL includes
+#include <map>
+#include <vector>
+
 // PlusLib includes
 #include "PlusIgtlClientInfo.h"
+#include "PlusImageCompressor.h"
+#include "PlusVideoEncoderPool.h"
 
+class vtkMatrix4x4;
 class vtkXMLDataElement;
 //class igsioTrackedFrame; 
 //class vtkIGSIOTransformRepository;
@@ -80,25 +89,93 @@ public:
   PlusStatus PackMessages(int clientId, const PlusIgtlClientInfo& clientInfo, std::vector<igtl::MessageBase::Pointer>& igtMessages, igsioTrackedFrame& trackedFrame,
                           bool packValidTransformsOnly, vtkIGSIOTransformRepository* transformRepository = NULL);
 
+  /*! Make the video streams of the client restart from a key frame (e.g., because a VIDEO message could not be sent to the client) */
+  void RequestVideoKeyFrames(int clientId);
+
+  /*! Forget the video streaming state of a client that is disconnected */
+  void RemoveClient(int clientId);
+
+  /*! Set the number of threads that the images of CIMAGE messages are compressed with */
+  void SetNumberOfImageCompressionThreads(unsigned int numberOfThreads);
+  unsigned int GetNumberOfImageCompressionThreads() const;
+
 protected:
   vtkPlusIgtlMessageFactory();
   virtual ~vtkPlusIgtlMessageFactory();
 
+  /*!
+    Returns a message from the pool of the specified key that is not referenced anywhere else anymore (it has been sent to all the clients)
+    and has the specified meta data elements, or a clone of the prototype message if there is no such message. New messages are added to
+    the pool, so that the message buffers (e.g., multi-megabyte image buffers) are reused instead of being allocated for each frame.
+    The pool key has to identify the message type and size.
+  */
+  igtl::MessageBase::Pointer GetPooledMessage(igtl::MessageBase::Pointer prototypeMessage, const std::string& poolKey, const std::vector<std::string>& metaDataKeys);
+
   igtl::MessageFactory::Pointer IgtlFactory;
 
+  /*! Reusable messages for each message type and size */
+  std::map<std::string, std::vector<igtl::MessageBase::Pointer> > MessagePool;
+
+  /*! Maximum number of messages in the pool of a message type and size */
+  static const unsigned int MAX_NUMBER_OF_POOLED_MESSAGES;
+  /*! Maximum number of message types and sizes that messages are kept for */
+  static const unsigned int MAX_NUMBER_OF_MESSAGE_POOLS;
+
+  /*! Encoders of the video streams, shared by the clients that request the same stream with the same codec configuration */
+  VideoEncoderPool VideoEncoders;
+
+  /*! Index of the last encoded frame that was packed for each client and video encoder */
+  std::map<std::pair<int, std::string>, unsigned long> LastPackedVideoFrameIndices;
+
+  /*! Compresses the images of CIMAGE messages */
+  ImageCompressor ImageMessageCompressor;
+
+  /*! Transform requested by a client, computed from the transform repository */
+  struct ResolvedTransform
+  {
+    ResolvedTransform() : Status(TOOL_INVALID), Found(false) {}
+    igsioTransformName Name;
+    vtkSmartPointer<vtkMatrix4x4> Matrix;
+    ToolStatus Status;
+    /*! False if the transform cannot be computed from the transforms in the repository */
+    bool Found;
+  };
+
+  /*!
+    Compute the requested transforms of the client from the transform repository. The transforms are computed once
+    for all the transform message types of a frame (TRANSFORM, TDATA, POSITION, TRACKEDFRAME), instead of for each
+    message type, and for the valid transform check again. The matrices are reused for the next frames.
+  */
+  void ResolveTransforms(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository* transformRepository);
+
+  /*! Get the matrix of a resolved transform, identity if the transform is not found or not valid (as vtkPlusIgtlMessageCommon::GetIgtlMatrix) */
+  static void GetIgtlMatrix(const ResolvedTransform& transform, igtl::Matrix4x4& igtlMatrix);
+
+  /*! Transforms of the client of the last PackMessages call, in the order of PlusIgtlClientInfo::TransformNames */
+  std::vector<ResolvedTransform> ResolvedTransforms;
+
 protected:
   int PackImageMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, const std::string& messageType,
                        igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages, int clientId);
+  int PackCompressedImageMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, const std::string& messageType,
+                                 igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages, int clientId);
+  /*! Pack the point cloud of the tracked frame (image of 3 float components in a single row) into POLYDATA messages */
+  int PackPointCloudMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, const std::string& messageType,
+                            igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages);
 #if defined(OpenIGTLink_ENABLE_VIDEOSTREAMING)
   int PackVideoMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, const std::string& messageType,
                        igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages, int clientId);
 #endif
-  int PackTransformMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, bool packValidTransformsOnly,
-                           igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages);
-  int PackTrackingDataMessage(const PlusIgtlClientInfo& clientInfo, igsioTrackedFrame& trackedFrame, vtkIGSIOTransformRepository& transformRepository, bool packValidTransformsOnly,
+  /*! The transform message packing functions use the transforms computed by ResolveTransforms */
+  int PackTransformMessage(bool packValidTransformsOnly, igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages);
+  int PackTrackingDataMessage(const PlusIgtlClientInfo& clientInfo, igsioTrackedFrame& trackedFrame, bool packValidTransformsOnly,
                               igtl::MessageBase::Pointer igtlMessage, std::vector<igtl::MessageBase::Pointer>& igtlMessages);
-  int PackPositionMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, igtl::MessageBase::Pointer igtlMessage,
-                          igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages);
+  /*! Pack all the transforms of the client into a single TDATA message, if it is due (see PlusIgtlClientInfo::GetCoalesceTransforms) */
+  int PackCoalescedTrackingDataMessage(const PlusIgtlClientInfo& clientInfo, igsioTrackedFrame& trackedFrame, bool packValidTransformsOnly,
+                                       std::vector<igtl::MessageBase::Pointer>& igtlMessages);
+  /*! Transforms of the client to send in a TDATA message: all of them, or only the valid ones if packValidTransformsOnly is set */
+  void GetTrackingDataTransforms(bool packValidTransformsOnly, std::vector<igsioTransformName>& names, std::vector<vtkMatrix4x4*>& matrices, std::vector<ToolStatus>& statuses);
+  int PackPositionMessage(igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages);
   int PackTrackedFrameMessage(igtl::MessageBase::Pointer igtlMessage, const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository,
                               igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages);
   int PackUsMessage(igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages);
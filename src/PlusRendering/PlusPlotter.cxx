@@ -8,12 +8,12 @@ See License.txt for details.
 #include "PlusPlotter.h"
 
 // VTK includes
+#include <vtkAbstractArray.h>
 #include <vtkAxis.h>
 #include <vtkChartXY.h>
 #include <vtkContextScene.h>
 #include <vtkContextView.h>
 #include <vtkDataArray.h>
-#include <vtkDelimitedTextWriter.h>
 #include <vtkDoubleArray.h>
 #include <vtkInformation.h>
 #include <vtkMultiBlockDataSet.h>
@@ -25,8 +25,43 @@ See License.txt for details.
 #include <vtkRenderWindow.h>
 #include <vtkRenderer.h>
 #include <vtkTable.h>
+#include <vtkVariant.h>
 #include <vtkWindowToImageFilter.h>
 
+// STL includes
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <thread>
+
+namespace
+{
+  // Line charts are decimated if they have more rows than this number times the image width
+  const int MAXIMUM_LINE_CHART_ROWS_PER_PIXEL = 4;
+  // Histogram computation is not split between threads for fewer values than this per thread
+  const vtkIdType MINIMUM_HISTOGRAM_VALUES_PER_THREAD = 50000;
+
+  //----------------------------------------------------------------------------
+  PlusStatus OpenTableFile(const std::string& filename, std::ofstream& file)
+  {
+    if (filename.empty())
+    {
+      LOG_ERROR("Failed to dump table to file - Input filename is empty!");
+      return PLUS_FAIL;
+    }
+    file.open(filename.c_str(), std::ios::out | std::ios::trunc);
+    if (!file.is_open())
+    {
+      LOG_ERROR("Failed to dump table to file - unable to open " << filename);
+      return PLUS_FAIL;
+    }
+    // All significant digits are written, so that timestamps are not rounded
+    file << std::setprecision(std::numeric_limits<double>::digits10);
+    return PLUS_SUCCESS;
+  }
+}
+
 //----------------------------------------------------------------------------
 PlusStatus PlusPlotter::WriteScatterChartToFile(const std::string& chartTitle,
     const std::string& yAxisText,
@@ -64,6 +99,28 @@ PlusStatus PlusPlotter::WriteLineChartToFile(const std::string& chartTitle,
     int imageSize[2],
     const std::string& outputImageFilename)
 {
+  // Rendering more than a few points per pixel column does not change the image, only the extremes have to be kept
+  vtkTable* plottedTable = &inputTable;
+  vtkSmartPointer<vtkTable> decimatedTable;
+  const int numberOfBuckets = std::max(imageSize[0], 1);
+  if (inputTable.GetNumberOfRows() > MAXIMUM_LINE_CHART_ROWS_PER_PIXEL * numberOfBuckets)
+  {
+    std::vector<int> yColumnIndices;
+    if (y1ColumnIndex >= 0)
+    {
+      yColumnIndices.push_back(y1ColumnIndex);
+    }
+    if (y2ColumnIndex >= 0)
+    {
+      yColumnIndices.push_back(y2ColumnIndex);
+    }
+    decimatedTable = vtkSmartPointer<vtkTable>::New();
+    if (DecimateTableMinMax(inputTable, yColumnIndices, numberOfBuckets, *decimatedTable) == PLUS_SUCCESS)
+    {
+      plottedTable = decimatedTable;
+    }
+  }
+
   vtkSmartPointer<vtkContextView> view = vtkSmartPointer<vtkContextView>::New();
   view->GetRenderer()->SetBackground(1.0, 1.0, 1.0);
   vtkSmartPointer<vtkChartXY> chart = vtkSmartPointer<vtkChartXY>::New();
@@ -72,14 +129,14 @@ PlusStatus PlusPlotter::WriteLineChartToFile(const std::string& chartTitle,
   if (y1ColumnIndex >= 0)
   {
     vtkPlotLine* linePlot = vtkPlotLine::SafeDownCast(chart->AddPlot(vtkChart::LINE));
-    linePlot->SetInputData(&inputTable, xColumnIndex, y1ColumnIndex);
+    linePlot->SetInputData(plottedTable, xColumnIndex, y1ColumnIndex);
     //linePlot->SetColor(0,0,1);
   }
 
   if (y2ColumnIndex >= 0)
   {
     vtkPlotLine* linePlot = vtkPlotLine::SafeDownCast(chart->AddPlot(vtkChart::LINE));
-    linePlot->SetInputData(&inputTable, xColumnIndex, y2ColumnIndex);
+    linePlot->SetInputData(plottedTable, xColumnIndex, y2ColumnIndex);
     //linePlot1->SetColor(0,0,1);
   }
 
@@ -152,31 +209,70 @@ PlusStatus PlusPlotter::ComputeHistogram(vtkTable& inputTable,
     vtkTable& resultTable,
     double valueRangeMin,
     double valueRangeMax,
-    unsigned int numberOfBins)
+    unsigned int numberOfBins,
+    int numberOfThreads/*=0*/)
 {
   vtkDataArray* inputArray = vtkDataArray::SafeDownCast(inputTable.GetColumn(inputColumnIndex));
   if (inputArray == NULL)
   {
     LOG_ERROR("PlusMath::ComputeHistogram failed: cannot find a valid data in column " << inputColumnIndex);
+    return PLUS_FAIL;
+  }
+  if (numberOfBins == 0 || valueRangeMax <= valueRangeMin)
+  {
+    LOG_ERROR("PlusMath::ComputeHistogram failed: invalid number of bins (" << numberOfBins << ") or value range (" << valueRangeMin << ", " << valueRangeMax << ")");
+    return PLUS_FAIL;
   }
 
-  std::vector<int> histogramBins(numberOfBins, 0);
-  int numberOfValues = inputArray->GetNumberOfTuples();
+  const vtkIdType numberOfValues = inputArray->GetNumberOfTuples();
   const double binSize = (valueRangeMax - valueRangeMin) / numberOfBins;
-  for (int i = 0; i < numberOfValues; i++)
+  if (numberOfThreads <= 0)
   {
-    int histogramBinIndex = static_cast<int>(floor((inputArray->GetTuple(i)[0] - valueRangeMin) / binSize));
-    if (histogramBinIndex < 0)
+    numberOfThreads = std::max<int>(std::thread::hardware_concurrency(), 1);
+  }
+  numberOfThreads = static_cast<int>(std::min<vtkIdType>(numberOfThreads, std::max<vtkIdType>(numberOfValues / MINIMUM_HISTOGRAM_VALUES_PER_THREAD, 1)));
+
+  // Each thread bins a contiguous range of the values into its own bins, the bins are summed at the end
+  std::vector<std::vector<unsigned int> > threadHistogramBins(numberOfThreads, std::vector<unsigned int>(numberOfBins, 0));
+  auto binValues = [&](int threadIndex)
+  {
+    std::vector<unsigned int>& bins = threadHistogramBins[threadIndex];
+    const vtkIdType beginIndex = numberOfValues * threadIndex / numberOfThreads;
+    const vtkIdType endIndex = numberOfValues * (threadIndex + 1) / numberOfThreads;
+    for (vtkIdType i = beginIndex; i < endIndex; i++)
     {
-      histogramBinIndex = 0;
+      // GetComponent does not use the shared tuple buffer of the array, so it can be called from multiple threads
+      double binPosition = (inputArray->GetComponent(i, 0) - valueRangeMin) / binSize;
+      unsigned int histogramBinIndex = 0;
+      if (binPosition >= numberOfBins)
+      {
+        histogramBinIndex = numberOfBins - 1;
+      }
+      else if (binPosition > 0)
+      {
+        histogramBinIndex = static_cast<unsigned int>(binPosition);
+      }
+      ++bins[histogramBinIndex];
     }
+  };
+  std::vector<std::thread> threads;
+  for (int threadIndex = 1; threadIndex < numberOfThreads; ++threadIndex)
+  {
+    threads.push_back(std::thread(binValues, threadIndex));
+  }
+  binValues(0);
+  for (std::vector<std::thread>::iterator threadIt = threads.begin(); threadIt != threads.end(); ++threadIt)
+  {
+    threadIt->join();
+  }
 
-    unsigned int histogramBinIndexUint = static_cast<unsigned int>(histogramBinIndex);
-    if (histogramBinIndexUint >= numberOfBins)
+  std::vector<unsigned int> histogramBins(numberOfBins, 0);
+  for (int threadIndex = 0; threadIndex < numberOfThreads; ++threadIndex)
+  {
+    for (unsigned int binIndex = 0; binIndex < numberOfBins; ++binIndex)
     {
-      histogramBinIndexUint = numberOfBins - 1;
+      histogramBins[binIndex] += threadHistogramBins[threadIndex][binIndex];
     }
-    ++histogramBins[histogramBinIndexUint];
   }
 
   // Clear table
@@ -202,23 +298,213 @@ PlusStatus PlusPlotter::ComputeHistogram(vtkTable& inputTable,
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus PlusPlotter::DecimateTableMinMax(vtkTable& inputTable,
+    const std::vector<int>& columnIndices,
+    unsigned int numberOfBuckets,
+    vtkTable& outputTable)
+{
+  std::vector<vtkDataArray*> columns;
+  for (std::vector<int>::const_iterator columnIndexIt = columnIndices.begin(); columnIndexIt != columnIndices.end(); ++columnIndexIt)
+  {
+    vtkDataArray* column = vtkDataArray::SafeDownCast(inputTable.GetColumn(*columnIndexIt));
+    if (column == NULL)
+    {
+      LOG_ERROR("PlusPlotter::DecimateTableMinMax failed: cannot find a valid data in column " << *columnIndexIt);
+      return PLUS_FAIL;
+    }
+    columns.push_back(column);
+  }
+  if (numberOfBuckets == 0)
+  {
+    LOG_ERROR("PlusPlotter::DecimateTableMinMax failed: number of buckets must be positive");
+    return PLUS_FAIL;
+  }
+
+  // Select the rows of the extremes in each bucket
+  const vtkIdType numberOfRows = inputTable.GetNumberOfRows();
+  std::vector<vtkIdType> selectedRows;
+  for (unsigned int bucketIndex = 0; bucketIndex < numberOfBuckets; ++bucketIndex)
+  {
+    const vtkIdType beginRow = numberOfRows * bucketIndex / numberOfBuckets;
+    const vtkIdType endRow = numberOfRows * (bucketIndex + 1) / numberOfBuckets;
+    if (beginRow >= endRow)
+    {
+      continue;
+    }
+    const size_t firstSelectedRowInBucket = selectedRows.size();
+    for (std::vector<vtkDataArray*>::iterator columnIt = columns.begin(); columnIt != columns.end(); ++columnIt)
+    {
+      vtkIdType minimumRow = beginRow;
+      vtkIdType maximumRow = beginRow;
+      double minimumValue = (*columnIt)->GetComponent(beginRow, 0);
+      double maximumValue = minimumValue;
+      for (vtkIdType row = beginRow + 1; row < endRow; ++row)
+      {
+        double value = (*columnIt)->GetComponent(row, 0);
+        if (value < minimumValue)
+        {
+          minimumValue = value;
+          minimumRow = row;
+        }
+        else if (value > maximumValue)
+        {
+          maximumValue = value;
+          maximumRow = row;
+        }
+      }
+      selectedRows.push_back(minimumRow);
+      selectedRows.push_back(maximumRow);
+    }
+    std::sort(selectedRows.begin() + firstSelectedRowInBucket, selectedRows.end());
+  }
+  if (numberOfRows > 0)
+  {
+    selectedRows.insert(selectedRows.begin(), 0);
+    selectedRows.push_back(numberOfRows - 1);
+  }
+  selectedRows.erase(std::unique(selectedRows.begin(), selectedRows.end()), selectedRows.end());
+
+  // Copy the selected rows of all columns
+  while (outputTable.GetNumberOfColumns() > 0)
+  {
+    outputTable.RemoveColumn(0);
+  }
+  for (vtkIdType columnIndex = 0; columnIndex < inputTable.GetNumberOfColumns(); ++columnIndex)
+  {
+    vtkAbstractArray* inputColumn = inputTable.GetColumn(columnIndex);
+    vtkSmartPointer<vtkAbstractArray> outputColumn = vtkSmartPointer<vtkAbstractArray>::Take(inputColumn->NewInstance());
+    outputColumn->SetName(inputColumn->GetName());
+    outputColumn->SetNumberOfComponents(inputColumn->GetNumberOfComponents());
+    outputColumn->SetNumberOfTuples(selectedRows.size());
+    for (size_t i = 0; i < selectedRows.size(); ++i)
+    {
+      outputColumn->SetTuple(i, selectedRows[i], inputColumn);
+    }
+    outputTable.AddColumn(outputColumn);
+  }
+
+  return PLUS_SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus PlusPlotter::WriteTableToFile(vtkTable& table, const std::string& filename)
 {
   LOG_TRACE("PlusPlotter::WriteTableToFile");
 
-  if (filename.empty())
+  std::ofstream file;
+  if (OpenTableFile(filename, file) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  // Header, components of multi-component columns are written as separate columns
+  const vtkIdType numberOfColumns = table.GetNumberOfColumns();
+  for (vtkIdType columnIndex = 0; columnIndex < numberOfColumns; ++columnIndex)
+  {
+    vtkAbstractArray* column = table.GetColumn(columnIndex);
+    const int numberOfComponents = column->GetNumberOfComponents();
+    for (int component = 0; component < numberOfComponents; ++component)
+    {
+      if (columnIndex > 0 || component > 0)
+      {
+        file << '\t';
+      }
+      file << (column->GetName() != NULL ? column->GetName() : "");
+      if (numberOfComponents > 1)
+      {
+        file << ':' << component;
+      }
+    }
+  }
+  file << '\n';
+
+  // Rows, numeric values are written directly from the arrays
+  const vtkIdType numberOfRows = table.GetNumberOfRows();
+  for (vtkIdType row = 0; row < numberOfRows; ++row)
+  {
+    for (vtkIdType columnIndex = 0; columnIndex < numberOfColumns; ++columnIndex)
+    {
+      vtkAbstractArray* column = table.GetColumn(columnIndex);
+      vtkDataArray* dataColumn = vtkDataArray::SafeDownCast(column);
+      const int numberOfComponents = column->GetNumberOfComponents();
+      for (int component = 0; component < numberOfComponents; ++component)
+      {
+        if (columnIndex > 0 || component > 0)
+        {
+          file << '\t';
+        }
+        if (dataColumn != NULL)
+        {
+          file << dataColumn->GetComponent(row, component);
+        }
+        else
+        {
+          file << column->GetVariantValue(row * numberOfComponents + component).ToString();
+        }
+      }
+    }
+    file << '\n';
+  }
+
+  if (!file.good())
+  {
+    LOG_ERROR("Failed to dump table to file - error while writing " << filename);
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusPlotter::WriteColumnsToFile(const std::vector<std::string>& columnNames,
+    const std::vector<std::vector<double> >& columns,
+    const std::string& filename)
+{
+  LOG_TRACE("PlusPlotter::WriteColumnsToFile");
+
+  if (columnNames.size() != columns.size())
   {
-    LOG_ERROR("Failed to dump table to file - Input filename is empty!");
+    LOG_ERROR("Failed to dump columns to file - number of column names (" << columnNames.size() << ") and columns (" << columns.size() << ") differ");
     return PLUS_FAIL;
   }
+  const size_t numberOfRows = columns.empty() ? 0 : columns[0].size();
+  for (std::vector<std::vector<double> >::const_iterator columnIt = columns.begin(); columnIt != columns.end(); ++columnIt)
+  {
+    if (columnIt->size() != numberOfRows)
+    {
+      LOG_ERROR("Failed to dump columns to file - columns have different number of values");
+      return PLUS_FAIL;
+    }
+  }
 
-  vtkSmartPointer<vtkDelimitedTextWriter> textWriter = vtkSmartPointer<vtkDelimitedTextWriter>::New();
-  textWriter->SetFieldDelimiter("\t");
-  textWriter->SetUseStringDelimiter(false);
-  textWriter->SetFileName(filename.c_str());
-  textWriter->SetInputData(&table);
-  textWriter->Update();
+  std::ofstream file;
+  if (OpenTableFile(filename, file) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  for (size_t columnIndex = 0; columnIndex < columnNames.size(); ++columnIndex)
+  {
+    file << (columnIndex > 0 ? "\t" : "") << columnNames[columnIndex];
+  }
+  file << '\n';
+  for (size_t row = 0; row < numberOfRows; ++row)
+  {
+    for (size_t columnIndex = 0; columnIndex < columns.size(); ++columnIndex)
+    {
+      if (columnIndex > 0)
+      {
+        file << '\t';
+      }
+      file << columns[columnIndex][row];
+    }
+    file << '\n';
+  }
 
+  if (!file.good())
+  {
+    LOG_ERROR("Failed to dump columns to file - error while writing " << filename);
+    return PLUS_FAIL;
+  }
   return PLUS_SUCCESS;
 }
@@ -12,6 +12,10 @@ See License.txt for details.
 // Local includes
 #include "PlusCommon.h"
 
+// STL includes
+#include <string>
+#include <vector>
+
 class vtkTable;
 class vtkContextView;
 
@@ -27,7 +31,11 @@ public:
       int imageSize[2],
       const std::string& outputImageFilename);
 
-  /*! Write line plot to PNG file */
+  /*!
+    Write line plot to PNG file.
+    Tables that have more rows than what can be displayed are decimated by DecimateTableMinMax to a few rows per pixel column
+    of the image, so the minimum and maximum values (e.g., timestamp jitter peaks) are still visible.
+  */
   static PlusStatus WriteLineChartToFile(const std::string& chartTitle,
                                          const std::string& yAxisText,
                                          vtkTable& inputTable,
@@ -52,16 +60,36 @@ public:
                                      int imageSize[2],
                                      const std::string& outputImageFilename);
 
-  /*! Compute histogram for values in a table column */
+  /*!
+    Compute histogram for values in a table column. The values are binned in a single pass, split between
+    numberOfThreads threads (number of processors if 0). Values outside the range are counted in the first or last bin.
+  */
   static PlusStatus ComputeHistogram(vtkTable& inputTable,
                                      int inputColumnIndex,
                                      vtkTable& resultTable,
                                      double valueRangeMin,
                                      double valueRangeMax,
-                                     unsigned int numberOfBins);
+                                     unsigned int numberOfBins,
+                                     int numberOfThreads = 0);
+
+  /*!
+    Select the rows of a table that preserve the shape of line plots: the rows are split into numberOfBuckets
+    consecutive ranges, and in each range the rows of the minimum and maximum values of each of the columns are kept,
+    in their original order. The first and last rows are always kept.
+    \param columnIndices Columns whose minimum and maximum values are preserved (e.g., the plotted y columns)
+  */
+  static PlusStatus DecimateTableMinMax(vtkTable& inputTable,
+                                        const std::vector<int>& columnIndices,
+                                        unsigned int numberOfBuckets,
+                                        vtkTable& outputTable);
 
-  /*! Write table to delimited text file */
+  /*! Write table to delimited text file. The rows are written directly to the file, no text table is built in memory. */
   static PlusStatus WriteTableToFile(vtkTable& table, const std::string& filename);
+
+  /*! Write columns of values to a delimited text file, without building a vtkTable. All columns must have the same number of values. */
+  static PlusStatus WriteColumnsToFile(const std::vector<std::string>& columnNames,
+                                       const std::vector<std::vector<double> >& columns,
+                                       const std::string& filename);
 };
 
 #endif //__PlusPlotter_h
\ No newline at end of file
@@ -0,0 +1,401 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+
+#include "vtkPlusToolAxesCollectionActor.h"
+
+#include "vtkActor.h"
+#include "vtkActor2D.h"
+#include "vtkAppendPolyData.h"
+#include "vtkBitArray.h"
+#include "vtkConeSource.h"
+#include "vtkDoubleArray.h"
+#include "vtkGlyph3DMapper.h"
+#include "vtkLabeledDataMapper.h"
+#include "vtkLineSource.h"
+#include "vtkMath.h"
+#include "vtkMatrix4x4.h"
+#include "vtkObjectFactory.h"
+#include "vtkPointData.h"
+#include "vtkPoints.h"
+#include "vtkPolyData.h"
+#include "vtkPropCollection.h"
+#include "vtkProperty.h"
+#include "vtkStringArray.h"
+#include "vtkTextProperty.h"
+#include "vtkTubeFilter.h"
+
+#include <algorithm>
+
+vtkStandardNewMacro(vtkPlusToolAxesCollectionActor);
+
+namespace
+{
+  const char* ORIENTATION_ARRAY_NAME = "Orientation";
+  const char* VISIBILITY_ARRAY_NAME = "Visibility";
+  const char* LABEL_ARRAY_NAME = "Label";
+  const char* AXIS_LABELS[3] = { "X", "Y", "Z" };
+}
+
+//----------------------------------------------------------------------------
+vtkPlusToolAxesCollectionActor::vtkPlusToolAxesCollectionActor()
+  : Poses(vtkSmartPointer<vtkPolyData>::New())
+  , Orientations(vtkSmartPointer<vtkDoubleArray>::New())
+  , Visibilities(vtkSmartPointer<vtkBitArray>::New())
+  , Labels(vtkSmartPointer<vtkPolyData>::New())
+  , LabelTexts(vtkSmartPointer<vtkStringArray>::New())
+  , LabelMapper(vtkSmartPointer<vtkLabeledDataMapper>::New())
+  , LabelActor(vtkSmartPointer<vtkActor2D>::New())
+  , ShaftLength(0.0)
+  , ShowLabels(true)
+  , ShowName(false)
+{
+  // Pose array
+  this->Poses->SetPoints(vtkSmartPointer<vtkPoints>::New());
+  this->Orientations->SetName(ORIENTATION_ARRAY_NAME);
+  this->Orientations->SetNumberOfComponents(4);
+  this->Poses->GetPointData()->AddArray(this->Orientations);
+  this->Visibilities->SetName(VISIBILITY_ARRAY_NAME);
+  this->Poses->GetPointData()->AddArray(this->Visibilities);
+
+  // One arrow per axis in the tool coordinate system, instanced at each pose
+  const double axisColors[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    this->ArrowShaftLineSources[axis] = vtkSmartPointer<vtkLineSource>::New();
+    this->ArrowShaftLineSources[axis]->SetPoint1(0, 0, 0);
+    this->TubeFilters[axis] = vtkSmartPointer<vtkTubeFilter>::New();
+    this->TubeFilters[axis]->SetInputConnection(this->ArrowShaftLineSources[axis]->GetOutputPort());
+    this->TubeFilters[axis]->CappingOn();
+    this->TubeFilters[axis]->SetNumberOfSides(32);
+
+    this->ArrowTipConeSources[axis] = vtkSmartPointer<vtkConeSource>::New();
+    this->ArrowTipConeSources[axis]->SetResolution(32);
+    double direction[3] = { 0, 0, 0 };
+    direction[axis] = 1;
+    this->ArrowTipConeSources[axis]->SetDirection(direction);
+
+    this->ArrowAppendFilters[axis] = vtkSmartPointer<vtkAppendPolyData>::New();
+    this->ArrowAppendFilters[axis]->AddInputConnection(this->TubeFilters[axis]->GetOutputPort());
+    this->ArrowAppendFilters[axis]->AddInputConnection(this->ArrowTipConeSources[axis]->GetOutputPort());
+
+    this->AxisMappers[axis] = vtkSmartPointer<vtkGlyph3DMapper>::New();
+    this->AxisMappers[axis]->SetInputData(this->Poses);
+    this->AxisMappers[axis]->SetSourceConnection(this->ArrowAppendFilters[axis]->GetOutputPort());
+    this->AxisMappers[axis]->ScalingOff();
+    this->AxisMappers[axis]->ScalarVisibilityOff();
+    this->AxisMappers[axis]->OrientOn();
+    this->AxisMappers[axis]->SetOrientationModeToQuaternion();
+    this->AxisMappers[axis]->SetOrientationArray(ORIENTATION_ARRAY_NAME);
+    this->AxisMappers[axis]->MaskingOn();
+    this->AxisMappers[axis]->SetMaskArray(VISIBILITY_ARRAY_NAME);
+
+    this->AxisActors[axis] = vtkSmartPointer<vtkActor>::New();
+    this->AxisActors[axis]->SetMapper(this->AxisMappers[axis]);
+    this->AxisActors[axis]->GetProperty()->SetColor(axisColors[axis][0], axisColors[axis][1], axisColors[axis][2]);
+  }
+
+  // Labels
+  this->Labels->SetPoints(vtkSmartPointer<vtkPoints>::New());
+  this->LabelTexts->SetName(LABEL_ARRAY_NAME);
+  this->Labels->GetPointData()->AddArray(this->LabelTexts);
+  this->LabelMapper->SetInputData(this->Labels);
+  this->LabelMapper->SetLabelModeToLabelFieldData();
+  this->LabelMapper->SetFieldDataName(LABEL_ARRAY_NAME);
+  vtkTextProperty* textprop = this->LabelMapper->GetLabelTextProperty();
+  textprop->ItalicOff();
+  textprop->SetFontSize(14);
+  textprop->SetJustificationToLeft();
+  textprop->SetVerticalJustificationToCentered();
+  this->LabelActor->SetMapper(this->LabelMapper);
+
+  this->SetShaftLength(100.0);
+}
+
+//----------------------------------------------------------------------------
+vtkPlusToolAxesCollectionActor::~vtkPlusToolAxesCollectionActor()
+{
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusToolAxesCollectionActor::AddTool(const std::string& name)
+{
+  const double origin[3] = { 0, 0, 0 };
+  const double identityQuaternion[4] = { 1, 0, 0, 0 };
+  this->Poses->GetPoints()->InsertNextPoint(origin);
+  this->Orientations->InsertNextTuple(identityQuaternion);
+  this->Visibilities->InsertNextValue(1);
+  this->Poses->Modified();
+
+  this->ToolToWorldMatrices.push_back(vtkSmartPointer<vtkMatrix4x4>::New());
+  this->ToolNames.push_back(name);
+  this->Modified();
+  return static_cast<int>(this->ToolNames.size()) - 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusToolAxesCollectionActor::RemoveAllTools()
+{
+  this->Poses->GetPoints()->Reset();
+  this->Orientations->Reset();
+  this->Visibilities->Reset();
+  this->Poses->Modified();
+
+  this->ToolToWorldMatrices.clear();
+  this->ToolNames.clear();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusToolAxesCollectionActor::GetNumberOfTools() const
+{
+  return static_cast<int>(this->ToolNames.size());
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusToolAxesCollectionActor::SetToolToWorldTransform(int toolIndex, vtkMatrix4x4* toolToWorldMatrix)
+{
+  if (toolIndex < 0 || toolIndex >= this->GetNumberOfTools() || toolToWorldMatrix == NULL)
+  {
+    LOG_ERROR("vtkPlusToolAxesCollectionActor: invalid tool index " << toolIndex << " or transform");
+    return PLUS_FAIL;
+  }
+  this->ToolToWorldMatrices[toolIndex]->DeepCopy(toolToWorldMatrix);
+
+  double rotation[3][3];
+  for (int row = 0; row < 3; ++row)
+  {
+    for (int column = 0; column < 3; ++column)
+    {
+      rotation[row][column] = toolToWorldMatrix->GetElement(row, column);
+    }
+  }
+  double quaternion[4] = { 1, 0, 0, 0 };
+  vtkMath::Matrix3x3ToQuaternion(rotation, quaternion);
+
+  this->Poses->GetPoints()->SetPoint(toolIndex, toolToWorldMatrix->GetElement(0, 3), toolToWorldMatrix->GetElement(1, 3), toolToWorldMatrix->GetElement(2, 3));
+  this->Orientations->SetTuple(toolIndex, quaternion);
+  this->Poses->GetPoints()->Modified();
+  this->Orientations->Modified();
+  this->Poses->Modified();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusToolAxesCollectionActor::SetToolVisibility(int toolIndex, bool visible)
+{
+  if (toolIndex < 0 || toolIndex >= this->GetNumberOfTools())
+  {
+    LOG_ERROR("vtkPlusToolAxesCollectionActor: invalid tool index " << toolIndex);
+    return PLUS_FAIL;
+  }
+  if ((this->Visibilities->GetValue(toolIndex) != 0) == visible)
+  {
+    return PLUS_SUCCESS;
+  }
+  this->Visibilities->SetValue(toolIndex, visible ? 1 : 0);
+  this->Visibilities->Modified();
+  this->Poses->Modified();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusToolAxesCollectionActor::GetActors(vtkPropCollection* ac)
+{
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    ac->AddItem(this->AxisActors[axis]);
+  }
+  if (this->ShowLabels || this->ShowName)
+  {
+    ac->AddItem(this->LabelActor);
+  }
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusToolAxesCollectionActor::RenderOpaqueGeometry(vtkViewport* vp)
+{
+  if (this->ToolNames.empty())
+  {
+    return 0;
+  }
+
+  int renderedSomething = 0;
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    renderedSomething += this->AxisActors[axis]->RenderOpaqueGeometry(vp);
+  }
+
+  if (this->ShowLabels || this->ShowName)
+  {
+    this->UpdateLabels();
+    renderedSomething += this->LabelActor->RenderOpaqueGeometry(vp);
+  }
+
+  return (renderedSomething > 0) ? (1) : (0);
+}
+
+//-----------------------------------------------------------------------------
+int vtkPlusToolAxesCollectionActor::RenderTranslucentPolygonalGeometry(vtkViewport* vp)
+{
+  if (this->ToolNames.empty())
+  {
+    return 0;
+  }
+
+  int renderedSomething = 0;
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    renderedSomething += this->AxisActors[axis]->RenderTranslucentPolygonalGeometry(vp);
+  }
+
+  return (renderedSomething > 0) ? (1) : (0);
+}
+
+//-----------------------------------------------------------------------------
+int vtkPlusToolAxesCollectionActor::HasTranslucentPolygonalGeometry()
+{
+  int result = 0;
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    result |= this->AxisActors[axis]->HasTranslucentPolygonalGeometry();
+  }
+  return result;
+}
+
+//-----------------------------------------------------------------------------
+int vtkPlusToolAxesCollectionActor::RenderOverlay(vtkViewport* vp)
+{
+  if (this->ToolNames.empty() || (!this->ShowLabels && !this->ShowName))
+  {
+    return 0;
+  }
+
+  this->UpdateLabels();
+  return (this->LabelActor->RenderOverlay(vp) > 0) ? (1) : (0);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusToolAxesCollectionActor::ReleaseGraphicsResources(vtkWindow* win)
+{
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    this->AxisActors[axis]->ReleaseGraphicsResources(win);
+  }
+  this->LabelActor->ReleaseGraphicsResources(win);
+}
+
+//----------------------------------------------------------------------------
+double* vtkPlusToolAxesCollectionActor::GetBounds()
+{
+  vtkMath::UninitializeBounds(this->Bounds);
+  bool boundsInitialized = false;
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    double axisBounds[6] = { 0 };
+    this->AxisActors[axis]->GetBounds(axisBounds);
+    if (!vtkMath::AreBoundsInitialized(axisBounds))
+    {
+      continue;
+    }
+    for (int i = 0; i < 3; ++i)
+    {
+      this->Bounds[2 * i] = boundsInitialized ? std::min(this->Bounds[2 * i], axisBounds[2 * i]) : axisBounds[2 * i];
+      this->Bounds[2 * i + 1] = boundsInitialized ? std::max(this->Bounds[2 * i + 1], axisBounds[2 * i + 1]) : axisBounds[2 * i + 1];
+    }
+    boundsInitialized = true;
+  }
+  return this->Bounds;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusToolAxesCollectionActor::GetToolPoints(int toolIndex, double origin_World[3], double shaftTips_World[3][3])
+{
+  vtkMatrix4x4* toolToWorldMatrix = this->ToolToWorldMatrices[toolIndex];
+  for (int i = 0; i < 3; ++i)
+  {
+    origin_World[i] = toolToWorldMatrix->GetElement(i, 3);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      shaftTips_World[axis][i] = origin_World[i] + this->ShaftLength * toolToWorldMatrix->GetElement(i, axis);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusToolAxesCollectionActor::UpdateLabels()
+{
+  if (this->LabelsBuildTime > this->Poses->GetMTime() && this->LabelsBuildTime > this->GetMTime())
+  {
+    // the tool poses and the label settings have not changed since the labels were built
+    return;
+  }
+
+  vtkPoints* labelPoints = this->Labels->GetPoints();
+  labelPoints->Reset();
+  this->LabelTexts->Reset();
+  for (int toolIndex = 0; toolIndex < this->GetNumberOfTools(); ++toolIndex)
+  {
+    if (this->Visibilities->GetValue(toolIndex) == 0)
+    {
+      continue;
+    }
+    double origin_World[3] = { 0, 0, 0 };
+    double shaftTips_World[3][3];
+    this->GetToolPoints(toolIndex, origin_World, shaftTips_World);
+    if (this->ShowLabels)
+    {
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        labelPoints->InsertNextPoint(shaftTips_World[axis]);
+        this->LabelTexts->InsertNextValue(AXIS_LABELS[axis]);
+      }
+    }
+    if (this->ShowName)
+    {
+      labelPoints->InsertNextPoint(origin_World);
+      this->LabelTexts->InsertNextValue(this->ToolNames[toolIndex]);
+    }
+  }
+  labelPoints->Modified();
+  this->LabelTexts->Modified();
+  this->Labels->Modified();
+  this->LabelsBuildTime.Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusToolAxesCollectionActor::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "NumberOfTools: " << this->GetNumberOfTools() << endl;
+  os << indent << "ShaftLength: " << this->ShaftLength << endl;
+  os << indent << "ShowLabels: " << (this->ShowLabels ? "true" : "false") << endl;
+  os << indent << "ShowName: " << (this->ShowName ? "true" : "false") << endl;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusToolAxesCollectionActor::SetShaftLength(double shaftLength)
+{
+  if (this->ShaftLength == shaftLength)
+  {
+    return;
+  }
+  this->ShaftLength = shaftLength;
+
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    double shaftTip[3] = { 0, 0, 0 };
+    shaftTip[axis] = this->ShaftLength;
+    this->ArrowShaftLineSources[axis]->SetPoint2(shaftTip);
+    this->TubeFilters[axis]->SetRadius(this->ShaftLength * 0.03);
+    this->ArrowTipConeSources[axis]->SetCenter(shaftTip);
+    this->ArrowTipConeSources[axis]->SetRadius(this->ShaftLength * 0.06);
+    this->ArrowTipConeSources[axis]->SetHeight(this->ShaftLength * 0.12);
+  }
+  this->Modified();
+}
@@ -0,0 +1,151 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusToolAxesCollectionActor_h
+#define __vtkPlusToolAxesCollectionActor_h
+
+// Local includes
+#include "vtkPlusRenderingExport.h"
+
+// PlusLib includes
+#include <PlusConfigure.h>
+
+// VTK includes
+#include <vtkProp3D.h>
+#include <vtkSetGet.h>
+#include <vtkSmartPointer.h>
+
+// STL includes
+#include <string>
+#include <vector>
+
+class vtkActor;
+class vtkActor2D;
+class vtkAppendPolyData;
+class vtkBitArray;
+class vtkConeSource;
+class vtkDoubleArray;
+class vtkGlyph3DMapper;
+class vtkLabeledDataMapper;
+class vtkLineSource;
+class vtkMatrix4x4;
+class vtkPolyData;
+class vtkPropCollection;
+class vtkStringArray;
+class vtkTubeFilter;
+
+/*!
+  \class vtkPlusToolAxesCollectionActor
+  \brief Actor for displaying the coordinate system axes of many tools
+
+  Draws the same axes as vtkPlusToolAxesActor for any number of tools, with a constant number of render calls.
+  The arrow geometry of each axis is built once, in tool coordinates, and it is drawn for all tools by a
+  vtkGlyph3DMapper (instanced rendering on OpenGL2) from a single pose array (tool origin and orientation quaternion).
+  Setting the tool to world transforms only updates the pose array, so it can be done for every frame.
+  All axis and name labels are drawn by a single label mapper, the rendered texts are cached by the text mappers.
+
+  The tool to world transforms must be rigid. Tools can be hidden (e.g., when they are out of view of the tracker)
+  without rebuilding the pose array.
+*/
+class vtkPlusRenderingExport vtkPlusToolAxesCollectionActor : public vtkProp3D
+{
+public:
+  static vtkPlusToolAxesCollectionActor* New();
+  vtkTypeMacro(vtkPlusToolAxesCollectionActor, vtkProp3D);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  /*! Add a tool, its axes are displayed at the origin until its transform is set. Returns the index of the tool. */
+  int AddTool(const std::string& name);
+  /*! Remove all tools */
+  void RemoveAllTools();
+  /*! Get the number of tools */
+  int GetNumberOfTools() const;
+
+  /*! Set the tool to world transform of a tool */
+  PlusStatus SetToolToWorldTransform(int toolIndex, vtkMatrix4x4* toolToWorldMatrix);
+  /*! Show or hide the axes and labels of a tool */
+  PlusStatus SetToolVisibility(int toolIndex, bool visible);
+
+  /*! Collect the actors that are used for rendering */
+  virtual void GetActors(vtkPropCollection*);
+
+  /*! Support the standard render methods. */
+  virtual int RenderOpaqueGeometry(vtkViewport* viewport);
+  /*! Support the standard render methods. */
+  virtual int RenderTranslucentPolygonalGeometry(vtkViewport* viewport);
+  /*! Support the standard render methods. */
+  virtual int RenderOverlay(vtkViewport* viewport);
+
+  /*! Does this prop have some translucent polygonal geometry? */
+  virtual int HasTranslucentPolygonalGeometry();
+
+  /*! Release any graphics resources that are being consumed by this actor. */
+  void ReleaseGraphicsResources(vtkWindow*);
+
+  /*! Get the bounds of the axes of all tools as (Xmin,Xmax,Ymin,Ymax,Zmin,Zmax) */
+  double* GetBounds();
+
+  /*! Set shaft length */
+  void SetShaftLength(double shaftLength);
+  /*! Get shaft length */
+  vtkGetMacro(ShaftLength, double);
+
+  /*! Set show labels flag */
+  vtkSetMacro(ShowLabels, bool);
+  vtkBooleanMacro(ShowLabels, bool);
+  /*! Get show labels flag */
+  vtkGetMacro(ShowLabels, bool);
+
+  /*! Set show name flag */
+  vtkSetMacro(ShowName, bool);
+  vtkBooleanMacro(ShowName, bool);
+  /*! Get show name flag */
+  vtkGetMacro(ShowName, bool);
+
+protected:
+  vtkPlusToolAxesCollectionActor();
+  ~vtkPlusToolAxesCollectionActor();
+
+  /*! Update the label positions if the poses or the label settings changed since the last update */
+  void UpdateLabels();
+
+  /*! Get the origin and axis tip positions of a tool in the world coordinate system */
+  void GetToolPoints(int toolIndex, double origin_World[3], double shaftTips_World[3][3]);
+
+protected:
+  /*! Arrow geometry and instanced actor of each axis */
+  vtkSmartPointer<vtkLineSource> ArrowShaftLineSources[3];
+  vtkSmartPointer<vtkTubeFilter> TubeFilters[3];
+  vtkSmartPointer<vtkConeSource> ArrowTipConeSources[3];
+  vtkSmartPointer<vtkAppendPolyData> ArrowAppendFilters[3];
+  vtkSmartPointer<vtkGlyph3DMapper> AxisMappers[3];
+  vtkSmartPointer<vtkActor> AxisActors[3];
+
+  /*! Pose array: one point per tool (origin), with orientation quaternion and visibility mask */
+  vtkSmartPointer<vtkPolyData> Poses;
+  vtkSmartPointer<vtkDoubleArray> Orientations;
+  vtkSmartPointer<vtkBitArray> Visibilities;
+
+  /*! Tool to world transforms, for computing the label positions */
+  std::vector<vtkSmartPointer<vtkMatrix4x4> > ToolToWorldMatrices;
+  std::vector<std::string> ToolNames;
+
+  vtkSmartPointer<vtkPolyData> Labels;
+  vtkSmartPointer<vtkStringArray> LabelTexts;
+  vtkSmartPointer<vtkLabeledDataMapper> LabelMapper;
+  vtkSmartPointer<vtkActor2D> LabelActor;
+  vtkTimeStamp LabelsBuildTime;
+
+  double ShaftLength;
+  bool ShowLabels;
+  bool ShowName;
+
+private:
+  vtkPlusToolAxesCollectionActor(const vtkPlusToolAxesCollectionActor&);  // Not implemented.
+  void operator=(const vtkPlusToolAxesCollectionActor&);  // Not implemented.
+};
+
+#endif
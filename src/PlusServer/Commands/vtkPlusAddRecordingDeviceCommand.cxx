@@ -139,7 +139,7 @@ PlusStatus vtkPlusAddRecordingDeviceCommand::Execute()
 
   // Configuration options
   std::string baseFilename("GeneratedVirtualCapture.nrrd");
-  if (this->MetaData.find("BaseFilename") == end(this->MetaData) || this->MetaData["BaseFilename"].second.empty())
+  if (this->MetaData.find("BaseFilename") != end(this->MetaData) && !this->MetaData["BaseFilename"].second.empty())
   {
     baseFilename = this->MetaData["BaseFilename"].second;
     if (vtksys::SystemTools::GetFilenameExtension(baseFilename) == "")
@@ -150,21 +150,21 @@ PlusStatus vtkPlusAddRecordingDeviceCommand::Execute()
   captureDevice->SetBaseFilename(baseFilename);
 
   bool enableFileCompression(true);
-  if (this->MetaData.find("EnableFileCompression") == end(this->MetaData) || this->MetaData["EnableFileCompression"].second.empty())
+  if (this->MetaData.find("EnableFileCompression") != end(this->MetaData) && !this->MetaData["EnableFileCompression"].second.empty())
   {
     enableFileCompression = igsioCommon::IsEqualInsensitive(this->MetaData["EnableFileCompression"].second, "TRUE");
   }
   captureDevice->SetEnableFileCompression(enableFileCompression);
 
 
+  // Capturing is enabled when the device is completely set up
   bool enableCapturingOnStart(true);
-  if (this->MetaData.find("EnableCapturingOnStart") == end(this->MetaData) || this->MetaData["EnableCapturingOnStart"].second.empty())
+  if (this->MetaData.find("EnableCapturingOnStart") != end(this->MetaData) && !this->MetaData["EnableCapturingOnStart"].second.empty())
   {
     enableCapturingOnStart = igsioCommon::IsEqualInsensitive(this->MetaData["EnableCapturingOnStart"].second, "TRUE");
   }
-  captureDevice->SetEnableCapturing(enableCapturingOnStart);
 
-  if (this->MetaData.find("RequestedFrameRate") == end(this->MetaData) || this->MetaData["RequestedFrameRate"].second.empty())
+  if (this->MetaData.find("RequestedFrameRate") != end(this->MetaData) && !this->MetaData["RequestedFrameRate"].second.empty())
   {
     std::stringstream ss;
     ss << this->MetaData["RequestedFrameRate"].second;
@@ -178,7 +178,7 @@ PlusStatus vtkPlusAddRecordingDeviceCommand::Execute()
   }
 
   int frameBufferSize(0);
-  if (this->MetaData.find("FrameBufferSize") == end(this->MetaData) || this->MetaData["FrameBufferSize"].second.empty())
+  if (this->MetaData.find("FrameBufferSize") != end(this->MetaData) && !this->MetaData["FrameBufferSize"].second.empty())
   {
     std::stringstream ss;
     ss << this->MetaData["FrameBufferSize"].second;
@@ -195,13 +195,47 @@ PlusStatus vtkPlusAddRecordingDeviceCommand::Execute()
     captureDevice->AddInputChannel(*it);
   }
 
+  // The device is set up completely before it is added to the data collector: its write buffers and writer thread
+  // are allocated, its file is opened and its updates are scheduled. The input devices are not modified, the device
+  // only subscribes to the new data of their sources, so their acquisition is not interrupted.
+  captureDevice->SetDataCollector(this->GetDataCollector());
+  PlusStatus setupStatus = PLUS_SUCCESS;
+  if (this->GetDataCollector()->IsStarted())
+  {
+    setupStatus = captureDevice->StartRecording();
+  }
+  else if (this->GetDataCollector()->GetConnected())
+  {
+    setupStatus = captureDevice->Connect();
+  }
+  if (setupStatus != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to start capture device " << deviceId);
+    captureDevice->Disconnect();
+    captureDevice->Delete();
+    this->QueueCommandResponse(PLUS_FAIL, "Unable to start capture device.", "See server log for error details.");
+    return PLUS_FAIL;
+  }
+
   if (this->GetDataCollector()->AddDevice(captureDevice) == PLUS_FAIL)
   {
     LOG_ERROR("Unable to add capture device.");
+    captureDevice->Disconnect();
+    captureDevice->Delete();
     this->QueueCommandResponse(PLUS_FAIL, "Unable to add capture device.", "See server log for error details.");
     return PLUS_FAIL;
   }
 
+  if (enableCapturingOnStart && captureDevice->IsConnected())
+  {
+    captureDevice->SetEnableCapturing(true);
+  }
+  else
+  {
+    // Capturing starts when the device is connected
+    captureDevice->SetEnableCapturingOnStart(enableCapturingOnStart);
+  }
+
   this->QueueCommandResponse(PLUS_SUCCESS, "Success.", "");
   return PLUS_SUCCESS;
 }
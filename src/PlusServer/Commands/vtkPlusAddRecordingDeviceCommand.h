@@ -26,6 +26,9 @@ public:
   /*! Executes the command  */
   virtual PlusStatus Execute();
 
+  /*! The added device and its channel are part of the configuration snapshot */
+  virtual bool ChangesConfiguration() const { return true; }
+
   /*! Get all the command names that this class can execute */
   virtual void GetCommandNames(std::list<std::string>& cmdNames);
 
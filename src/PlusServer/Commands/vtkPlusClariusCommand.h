@@ -42,6 +42,9 @@ public:
   /*! Gets the description for the specified command name. */
   virtual std::string GetDescription(const std::string& commandName);
 
+  /*! Commands of the same Clarius device are executed in order */
+  virtual std::string GetTargetDeviceId() const { return this->ClariusDeviceId; }
+
   /*!
   Set the command to get the raw data from the clarius
   See: https://support.clarius.com/hc/en-us/articles/360019787932-Raw-Data-Collection
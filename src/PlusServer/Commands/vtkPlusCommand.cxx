@@ -250,7 +250,51 @@ void vtkPlusCommand::PopCommandResponses(PlusCommandResponseList& responses)
 }
 
 //------------------------------------------------------------------------------
-void vtkPlusCommand::QueueCommandResponse(PlusStatus status, const std::string& message, const std::string& error, const igtl::MessageBase::MetaDataMap* replyMetaData)
+std::string vtkPlusCommand::GetTargetDeviceId() const
+{
+  return "";
+}
+
+//------------------------------------------------------------------------------
+std::string vtkPlusCommand::GetCoalescingKey() const
+{
+  return "";
+}
+
+//------------------------------------------------------------------------------
+bool vtkPlusCommand::Coalesce(vtkPlusCommand* laterCommand)
+{
+  return false;
+}
+
+//------------------------------------------------------------------------------
+void vtkPlusCommand::CompleteCoalesced(vtkPlusCommand* executedCommand, PlusStatus executionStatus)
+{
+  if (executionStatus == PLUS_SUCCESS)
+  {
+    this->QueueCommandResponse(PLUS_SUCCESS, this->Name + " completed successfully (executed together with other requests)");
+  }
+  else
+  {
+    this->QueueCommandResponse(PLUS_FAIL, "Command failed. See error message.", this->Name + " failed (executed together with other requests)");
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkPlusCommand::ReportProgress(double progressPercent, const std::string& message)
+{
+  igtl::MessageBase::MetaDataMap metaData;
+  metaData["Progress"] = std::pair<IANA_ENCODING_TYPE, std::string>(IANA_TYPE_US_ASCII, igsioCommon::ToString<double>(progressPercent));
+  this->QueueCommandResponse(PLUS_SUCCESS, message, "", &metaData);
+  if (this->CommandProcessor != NULL)
+  {
+    this->CommandProcessor->QueueResponsesOfCommand(this);
+  }
+}
+
+//------------------------------------------------------------------------------
+vtkSmartPointer<vtkPlusCommandRTSCommandResponse> vtkPlusCommand::CreateCommandResponse(PlusStatus status, const std::string& message, const std::string& error,
+    const igtl::MessageBase::MetaDataMap* replyMetaData)
 {
   // Proper v1/v2 header version response handling is performed in vtkPlusOpenIGTLinkServer::CreateIgtlMessageFromCommandResponse
 
@@ -267,5 +311,11 @@ void vtkPlusCommand::QueueCommandResponse(PlusStatus status, const std::string&
   {
     commandResponse->SetParameters(*replyMetaData);
   }
-  this->CommandResponseQueue.push_back(commandResponse);
+  return commandResponse;
+}
+
+//------------------------------------------------------------------------------
+void vtkPlusCommand::QueueCommandResponse(PlusStatus status, const std::string& message, const std::string& error, const igtl::MessageBase::MetaDataMap* replyMetaData)
+{
+  this->CommandResponseQueue.push_back(this->CreateCommandResponse(status, message, error, replyMetaData));
 }
\ No newline at end of file
@@ -81,6 +81,39 @@ public:
   vtkGetMacro(Id, uint32_t);
   vtkSetMacro(Id, uint32_t);
 
+  /*!
+    Id of the device that the command operates on. Commands with the same target device are executed one at a time,
+    in the order they were received, commands of different devices may be executed concurrently (see vtkPlusCommandProcessor).
+    Empty if the command does not operate on a specific device, these commands are executed in order, too.
+  */
+  virtual std::string GetTargetDeviceId() const;
+
+  /*!
+    Commands that only set values (transforms, imaging parameters) can be coalesced: if commands with the same non-empty
+    coalescing key are waiting consecutively in the queue of a strand then they are merged into the first one by Coalesce
+    and executed once, applying only the latest value of each item. Empty (no coalescing) by default.
+  */
+  virtual std::string GetCoalescingKey() const;
+
+  /*!
+    Merge the requested changes of a later command (with the same coalescing key) into this command,
+    the values of the later command take precedence. Returns false if the commands cannot be merged.
+  */
+  virtual bool Coalesce(vtkPlusCommand* laterCommand);
+
+  /*!
+    Called instead of Execute for a command that has been merged into an earlier command, after that has been executed,
+    to queue the response of this command. The default implementation replies with the status of the execution.
+  */
+  virtual void CompleteCoalesced(vtkPlusCommand* executedCommand, PlusStatus executionStatus);
+
+  /*!
+    Returns true if the command changes the configuration that the clients can query (devices, channels, persistent transforms).
+    The command processor increments its configuration version after executing such a command, which invalidates
+    the cached configuration snapshot (see vtkPlusRequestIdsCommand). False by default.
+  */
+  virtual bool ChangesConfiguration() const { return false; }
+
   /*!
     Get command responses from the device, append them to the provided list, and then remove them from the command.
     The ownership of the command responses are transferred to the caller, it is responsible
@@ -138,6 +171,16 @@ protected:
   /*! Check if the command name is in the list of command names */
   PlusStatus ValidateName();
 
+  /*!
+    Send a progress response to the client while the command is being executed. The response is sent immediately
+    (not when the command execution is completed), with success status and Progress (percent) parameter.
+  */
+  void ReportProgress(double progressPercent, const std::string& message);
+
+  /*! Helper method to create a command response. Can be used for responses that are not added to the response queue of the command. */
+  vtkSmartPointer<vtkPlusCommandRTSCommandResponse> CreateCommandResponse(PlusStatus status, const std::string& message, const std::string& error = "",
+      const igtl::MessageBase::MetaDataMap* metaData = nullptr);
+
   /*! Helper method to add a command response to the response queue */
   void QueueCommandResponse(PlusStatus status, const std::string& message, const std::string& error = "", const igtl::MessageBase::MetaDataMap* metaData = nullptr);
 
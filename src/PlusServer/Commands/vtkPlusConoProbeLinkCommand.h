@@ -50,6 +50,9 @@ public:
   /*! Gets the description for the specified command name. */
   virtual std::string GetDescription(const std::string& commandName);
 
+  /*! Commands of the same ConoProbe device are executed in order */
+  virtual std::string GetTargetDeviceId() const { return this->ConoProbeDeviceId; }
+
   vtkGetStdStringMacro(ConoProbeDeviceId);
   vtkSetStdStringMacro(ConoProbeDeviceId);
 
@@ -121,7 +121,7 @@ PlusStatus vtkPlusGetImageCommand::ExecuteImageReply(std::string& outErrorString
     return PLUS_FAIL;
   }
 
-  vtkSmartPointer<vtkImageData> imageData = vtkSmartPointer<vtkImageData>::New();
+  vtkSmartPointer<vtkImageData> imageData;
   vtkSmartPointer<vtkMatrix4x4> ijkToRasTransform = vtkSmartPointer<vtkMatrix4x4>::New();
   for (DeviceCollectionConstIterator it = dataCollector->GetDeviceConstIteratorBegin(); it != dataCollector->GetDeviceConstIteratorEnd(); ++it)
   {
@@ -145,8 +145,10 @@ PlusStatus vtkPlusGetImageCommand::ExecuteImageReply(std::string& outErrorString
     std::string deviceIdStr(plusDevice->GetDeviceId()); // SLD
     if (requestedDeviceId.compare(deviceIdStr) == 0)
     {
+      // The image is not copied if the device provides it as a snapshot, so acquisition is not blocked while it is packed and sent
       std::string assignedImageId("");
-      if (plusDevice->GetImage(requestedImageId, assignedImageId, std::string("Ras"), imageData, ijkToRasTransform))
+      std::string frameUid;
+      if (plusDevice->GetImageSnapshot(requestedImageId, assignedImageId, std::string("Ras"), imageData, ijkToRasTransform, frameUid) == PLUS_SUCCESS)
       {
         if (assignedImageId.compare(requestedImageId) != 0)
         {
@@ -161,6 +163,7 @@ PlusStatus vtkPlusGetImageCommand::ExecuteImageReply(std::string& outErrorString
         imageResponse->SetImageData(imageData);
         imageResponse->SetRespondWithCommandMessage(this->RespondWithCommandMessage);
         imageResponse->SetImageToReferenceTransform(ijkToRasTransform);
+        imageResponse->SetFrameUid(frameUid);
 
         return PLUS_SUCCESS;
       }
@@ -0,0 +1,60 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusMetricsRegistry.h"
+#include "vtkPlusGetMetricsCommand.h"
+
+vtkStandardNewMacro(vtkPlusGetMetricsCommand);
+
+namespace
+{
+  static const std::string GET_METRICS_CMD = "GetMetrics";
+}
+
+//----------------------------------------------------------------------------
+vtkPlusGetMetricsCommand::vtkPlusGetMetricsCommand()
+{
+  // It handles only one command, set its name by default
+  this->SetName(GET_METRICS_CMD);
+}
+
+//----------------------------------------------------------------------------
+vtkPlusGetMetricsCommand::~vtkPlusGetMetricsCommand()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusGetMetricsCommand::SetNameToGetMetrics()
+{
+  this->SetName(GET_METRICS_CMD);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusGetMetricsCommand::GetCommandNames(std::list<std::string>& cmdNames)
+{
+  cmdNames.clear();
+  cmdNames.push_back(GET_METRICS_CMD);
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusGetMetricsCommand::GetDescription(const std::string& commandName)
+{
+  std::string desc;
+  if (commandName.empty() || igsioCommon::IsEqualInsensitive(commandName, GET_METRICS_CMD))
+  {
+    desc += GET_METRICS_CMD;
+    desc += ": Send the performance metrics of the server (device acquisition, client sending, thread CPU time) in Prometheus text format.";
+  }
+  return desc;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusGetMetricsCommand::Execute()
+{
+  this->QueueCommandResponse(PLUS_SUCCESS, MetricsRegistry::GetInstance().GetMetricsAsPrometheusText());
+  return PLUS_SUCCESS;
+}
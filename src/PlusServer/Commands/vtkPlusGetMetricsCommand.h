@@ -0,0 +1,52 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusGetMetricsCommand_h
+#define __vtkPlusGetMetricsCommand_h
+
+#include "vtkPlusServerExport.h"
+
+#include "vtkPlusCommand.h"
+
+/*!
+  \class vtkPlusGetMetricsCommand
+  \brief This command sends the current performance metrics of the server to the client
+
+  The metrics (acquisition rate and buffer fill level of the devices, send rate, latency and backlog of the clients,
+  CPU time of the threads, etc.) are returned in the response message in Prometheus text exposition format.
+  See MetricsRegistry.
+
+  \ingroup PlusLibPlusServer
+ */
+class vtkPlusServerExport vtkPlusGetMetricsCommand : public vtkPlusCommand
+{
+public:
+
+  static vtkPlusGetMetricsCommand* New();
+  vtkTypeMacro(vtkPlusGetMetricsCommand, vtkPlusCommand);
+  virtual vtkPlusCommand* Clone() { return New(); }
+
+  /*! Executes the command  */
+  virtual PlusStatus Execute();
+
+  /*! Get all the command names that this class can execute */
+  virtual void GetCommandNames(std::list<std::string>& cmdNames);
+
+  /*! Gets the description for the specified command name. */
+  virtual std::string GetDescription(const std::string& commandName);
+
+  void SetNameToGetMetrics();
+
+protected:
+  vtkPlusGetMetricsCommand();
+  virtual ~vtkPlusGetMetricsCommand();
+
+private:
+  vtkPlusGetMetricsCommand(const vtkPlusGetMetricsCommand&);
+  void operator=(const vtkPlusGetMetricsCommand&);
+};
+
+#endif
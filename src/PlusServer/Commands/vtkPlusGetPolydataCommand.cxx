@@ -6,15 +6,13 @@ See License.txt for details.
 
 // Local includes
 #include "PlusConfigure.h"
+#include "vtkPlusCommandProcessor.h"
 #include "vtkPlusDataCollector.h"
 #include "vtkPlusGetPolydataCommand.h"
+#include "vtkPlusPolydataCache.h"
 
 // VTK includes
-#include <vtkOBJReader.h>
-#include <vtkPLYReader.h>
 #include <vtkPolyData.h>
-#include <vtkPolyDataReader.h>
-#include <vtkSTLReader.h>
 
 namespace
 {
@@ -26,6 +24,7 @@ vtkStandardNewMacro(vtkPlusGetPolydataCommand);
 //----------------------------------------------------------------------------
 vtkPlusGetPolydataCommand::vtkPlusGetPolydataCommand()
   : PolydataId("")
+  , DecimationTargetReduction(0.0)
 {
 
 }
@@ -59,6 +58,13 @@ PlusStatus vtkPlusGetPolydataCommand::ReadConfiguration(vtkXMLDataElement* aConf
     return PLUS_FAIL;
   }
 
+  // Optional decimation for clients that cannot handle the full resolution mesh
+  if (this->MetaData.find("DecimationTargetReduction") != this->MetaData.end())
+  {
+    igsioCommon::StringToDouble(this->MetaData["DecimationTargetReduction"].second.c_str(), this->DecimationTargetReduction);
+  }
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, DecimationTargetReduction, aConfig);
+
   return Superclass::ReadConfiguration(aConfig);
 }
 
@@ -71,6 +77,10 @@ PlusStatus vtkPlusGetPolydataCommand::WriteConfiguration(vtkXMLDataElement* aCon
     return PLUS_FAIL;
   }
   aConfig->SetAttribute("FileName", this->GetPolydataId().c_str());
+  if (this->DecimationTargetReduction > 0)
+  {
+    aConfig->SetDoubleAttribute("DecimationTargetReduction", this->DecimationTargetReduction);
+  }
 
   return Superclass::WriteConfiguration(aConfig);
 }
@@ -89,7 +99,7 @@ std::string vtkPlusGetPolydataCommand::GetDescription(const std::string& command
   if (commandName.empty() || igsioCommon::IsEqualInsensitive(commandName, GET_POLYDATA))
   {
     desc += GET_POLYDATA;
-    desc += "Acquire the polydata.";
+    desc += "Acquire the polydata. Attributes: FileName: name of the model file (VTK, STL, OBJ, or PLY). DecimationTargetReduction: if positive then this fraction (between 0 and 1) of the triangles is removed by decimation before sending (optional, default: 0).";
   }
   return desc;
 }
@@ -122,22 +132,10 @@ PlusStatus vtkPlusGetPolydataCommand::Execute()
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusGetPolydataCommand::ExecutePolydataReply(std::string& outErrorString)
 {
-  bool loaded(false);
-
-  vtkSmartPointer<vtkPolyDataReader> reader = vtkSmartPointer<vtkPolyDataReader>::New();
-
   std::string finalFileName(this->PolydataId);
-  if (vtksys::SystemTools::FileExists(this->PolydataId))
-  {
-    reader->SetFileName(this->PolydataId.c_str());
-  }
-  else
+  if (!vtksys::SystemTools::FileExists(this->PolydataId))
   {
-    if (vtkPlusConfig::GetInstance()->FindModelPath(this->PolydataId, finalFileName) == PLUS_SUCCESS)
-    {
-      reader->SetFileName(finalFileName.c_str());
-    }
-    else
+    if (vtkPlusConfig::GetInstance()->FindModelPath(this->PolydataId, finalFileName) != PLUS_SUCCESS)
     {
       LOG_ERROR("Unable to locate file with name " << this->PolydataId);
       this->QueueCommandResponse(PLUS_FAIL, "Command failed.", std::string("Unable to locate file with name ") + this->PolydataId);
@@ -145,58 +143,35 @@ PlusStatus vtkPlusGetPolydataCommand::ExecutePolydataReply(std::string& outError
     }
   }
 
-  vtkSmartPointer<vtkAbstractPolyDataReader> polyReader = vtkSmartPointer<vtkSTLReader>::New();
-  if (!reader->IsFilePolyData())
+  // Models are parsed (and their reply messages packed) only once, repeated requests are served from the cache of the server
+  vtkSmartPointer<vtkPlusPolydataCache> cache;
+  if (this->CommandProcessor != NULL && this->CommandProcessor->GetPlusServer() != NULL)
   {
-    reader = nullptr; // This flags later code to recognize that it's not a .vtk file
-    polyReader->SetFileName(finalFileName.c_str());
-    polyReader->Update();
-    if (polyReader->GetOutput() == nullptr)
-    {
-      polyReader = vtkSmartPointer<vtkOBJReader>::New();
-      polyReader->SetFileName(finalFileName.c_str());
-      polyReader->Update();
-      if (polyReader->GetOutput() == nullptr)
-      {
-        polyReader = vtkSmartPointer<vtkPLYReader>::New();
-        polyReader->SetFileName(finalFileName.c_str());
-        polyReader->Update();
-        if (polyReader->GetOutput() == nullptr)
-        {
-          LOG_ERROR("Unrecognized polydata file type: " << this->PolydataId);
-          this->QueueCommandResponse(PLUS_FAIL, "Command failed.", std::string("Unrecognized polydata file type: ") + this->PolydataId);
-          return PLUS_FAIL;
-        }
-      }
-    }
+    cache = this->CommandProcessor->GetPlusServer()->GetPolydataCache();
   }
-  else
+  if (cache == NULL)
   {
-    reader->Update();
+    cache = vtkSmartPointer<vtkPlusPolydataCache>::New();
   }
 
-  auto errorCode = (reader == nullptr ? polyReader->GetErrorCode() : reader->GetErrorCode());
-  vtkPolyData* polyData = (reader == nullptr ? polyReader->GetOutput() : reader->GetOutput());
-  if (errorCode != 0)
+  vtkSmartPointer<vtkPolyData> polyData;
+  std::string cacheKey;
+  if (cache->GetPolyData(finalFileName, this->DecimationTargetReduction, polyData, cacheKey, outErrorString) != PLUS_SUCCESS)
   {
-    std::stringstream ss;
-    ss << "Reader threw error: " << errorCode;
-    this->QueueCommandResponse(PLUS_FAIL, "PlusServer", ss.str());
-  }
-  else if (polyData != nullptr)
-  {
-    vtkSmartPointer<vtkPlusCommandPolydataResponse> response = vtkSmartPointer<vtkPlusCommandPolydataResponse>::New();
-    response->SetClientId(this->ClientId);
-    response->SetPolyDataName(this->GetPolydataId());
-    response->SetPolyData(polyData);
-    response->SetRespondWithCommandMessage(this->RespondWithCommandMessage);
-    this->CommandResponseQueue.push_back(response);
-
-    std::string name = vtksys::SystemTools::GetFilenameName(this->PolydataId);
-    this->QueueCommandResponse(PLUS_SUCCESS, name, "Command succeeded.");
-    return PLUS_SUCCESS;
+    LOG_ERROR("Unable to load polydata " << this->PolydataId << ": " << outErrorString);
+    this->QueueCommandResponse(PLUS_FAIL, "Command failed.", outErrorString);
+    return PLUS_FAIL;
   }
 
-  this->QueueCommandResponse(PLUS_FAIL, "Unable to load polydata.");
-  return PLUS_FAIL;
+  vtkSmartPointer<vtkPlusCommandPolydataResponse> response = vtkSmartPointer<vtkPlusCommandPolydataResponse>::New();
+  response->SetClientId(this->ClientId);
+  response->SetPolyDataName(this->GetPolydataId());
+  response->SetPolyData(polyData);
+  response->SetCacheKey(cacheKey);
+  response->SetRespondWithCommandMessage(this->RespondWithCommandMessage);
+  this->CommandResponseQueue.push_back(response);
+
+  std::string name = vtksys::SystemTools::GetFilenameName(this->PolydataId);
+  this->QueueCommandResponse(PLUS_SUCCESS, name, "Command succeeded.");
+  return PLUS_SUCCESS;
 }
\ No newline at end of file
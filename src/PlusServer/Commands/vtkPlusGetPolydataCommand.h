@@ -45,6 +45,10 @@ public:
   vtkGetStdStringMacro(PolydataId);
   vtkSetStdStringMacro(PolydataId);
 
+  /*! If positive then this fraction (between 0 and 1) of the triangles of the mesh is removed by decimation before sending */
+  vtkGetMacro(DecimationTargetReduction, double);
+  vtkSetMacro(DecimationTargetReduction, double);
+
 protected:
   /*! Prepare sending image as a response */
   PlusStatus ExecutePolydataReply(std::string& outErrorString);
@@ -54,6 +58,7 @@ protected:
 
 protected:
   std::string PolydataId;
+  double DecimationTargetReduction;
 
 private:
   vtkPlusGetPolydataCommand(const vtkPlusGetPolydataCommand&);
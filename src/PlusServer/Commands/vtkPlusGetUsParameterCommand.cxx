@@ -154,8 +154,9 @@ PlusStatus vtkPlusGetUsParameterCommand::Execute()
 
   std::map < std::string, std::pair<IANA_ENCODING_TYPE, std::string> > metaData;
 
-  vtkPlusUsImagingParameters* imagingParameters = usDevice->GetImagingParameters();
-  std::string resultString = "<CommandReply>";
+  // The values are read from the snapshot of the parameters, which is shared by all requests until a parameter changes
+  std::shared_ptr<const vtkPlusUsImagingParameters::Snapshot> imagingParameters = usDevice->GetImagingParameters()->GetSnapshot();
+  std::string resultString = "<CommandReply Version=\"" + igsioCommon::ToString<unsigned long>(imagingParameters->Version) + "\">";
   std::string error = "";
   PlusStatus status = PLUS_SUCCESS;
 
@@ -165,85 +166,22 @@ PlusStatus vtkPlusGetUsParameterCommand::Execute()
     std::string parameterName = *paramIt;
     resultString += "<Parameter Name=\"" + parameterName + "\"";
 
-    if (parameterName == vtkPlusUsImagingParameters::KEY_TGC)
+    if (!usDevice->IsKnownKey(parameterName))
     {
-      if (imagingParameters->IsSet(vtkPlusUsImagingParameters::KEY_TGC))
-      {
-        std::stringstream ss;
-        std::vector<double> numbers = imagingParameters->GetTimeGainCompensation();
-        for (std::vector<double>::iterator numberIt; numberIt != numbers.begin(); numberIt != numbers.end())
-        {
-          ss << *numberIt << " ";
-        }
-        resultString += " Success=\"true\"";
-        resultString += " Value=\"" + ss.str() + "\"";
-        metaData[parameterName] = std::make_pair(IANA_TYPE_US_ASCII, ss.str());
-      }
-      else
-      {
-        resultString += " Success=\"false\"";
-        error += parameterName + " is not set. ";
-        status = PLUS_FAIL;
-      }
-    }
-    else if (parameterName == vtkPlusUsImagingParameters::KEY_IMAGESIZE)
-    {
-      if (imagingParameters->IsSet(vtkPlusUsImagingParameters::KEY_IMAGESIZE))
-      {
-        std::stringstream ss;
-        FrameSizeType imageSize = imagingParameters->GetImageSize();
-        for (FrameSizeType::iterator imageSizeIt = imageSize.begin(); imageSizeIt != imageSize.end(); ++imageSizeIt)
-        {
-          ss << *imageSizeIt << " ";
-        }
-        resultString += " Success=\"true\"";
-        resultString += " Value=\"" + ss.str() + "\"";
-        metaData[parameterName] = std::make_pair(IANA_TYPE_US_ASCII, ss.str());
-      }
-      else
-      {
-        resultString += " Success=\"false\"";
-        error += parameterName + " is not set. ";
-        status = PLUS_FAIL;
-      }
+      error += "Invalid parameter " + parameterName + ". ";
+      resultString += " Success=\"false\"";
+      status = PLUS_FAIL;
     }
-    else if (parameterName == vtkPlusUsImagingParameters::KEY_FREQUENCY
-             || parameterName == vtkPlusUsImagingParameters::KEY_DEPTH
-             || parameterName == vtkPlusUsImagingParameters::KEY_FOCUS_DEPTH
-             || parameterName == vtkPlusUsImagingParameters::KEY_SECTOR
-             || parameterName == vtkPlusUsImagingParameters::KEY_GAIN
-             || parameterName == vtkPlusUsImagingParameters::KEY_INTENSITY
-             || parameterName == vtkPlusUsImagingParameters::KEY_CONTRAST
-             || parameterName == vtkPlusUsImagingParameters::KEY_POWER
-             || parameterName == vtkPlusUsImagingParameters::KEY_DYNRANGE
-             || parameterName == vtkPlusUsImagingParameters::KEY_ZOOM
-             || parameterName == vtkPlusUsImagingParameters::KEY_SOUNDVELOCITY
-             || parameterName == vtkPlusUsImagingParameters::KEY_VOLTAGE)
+    else if (const std::string* value = imagingParameters->GetValue(parameterName))
     {
-      if (imagingParameters->IsSet(parameterName))
-      {
-        // double type parameter
-        double value = 0;
-        if (imagingParameters->GetValue<double>(parameterName, value) == PLUS_SUCCESS)
-        {
-          std::stringstream ss;
-          ss << value;
-          resultString += " Success=\"true\"";
-          resultString += " Value=\"" + ss.str() + "\"";
-          metaData[parameterName] = std::make_pair(IANA_TYPE_US_ASCII, ss.str());
-        }
-      }
-      else
-      {
-        resultString += " Success=\"false\"";
-        error += parameterName + " is not set. ";
-        status = PLUS_FAIL;
-      }
+      resultString += " Success=\"true\"";
+      resultString += " Value=\"" + *value + "\"";
+      metaData[parameterName] = std::make_pair(IANA_TYPE_US_ASCII, *value);
     }
     else
     {
-      error += "Invalid parameter " + parameterName + ". ";
       resultString += " Success=\"false\"";
+      error += parameterName + " is not set. ";
       status = PLUS_FAIL;
     }
     resultString += "/>";
@@ -42,6 +42,9 @@ public:
   /*! Gets the description for the specified command name. */
   virtual std::string GetDescription(const std::string& commandName);
 
+  /*! Commands of the same ultrasound device are executed in order */
+  virtual std::string GetTargetDeviceId() const { return this->UsDeviceId; }
+
   /*! Id of the ultrasound device to change the parameters of at the next Execute */
   vtkGetStdStringMacro(UsDeviceId);
   vtkSetStdStringMacro(UsDeviceId);
@@ -0,0 +1,141 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusLatencyTracer.h"
+#include "vtkPlusLatencyTracingCommand.h"
+
+vtkStandardNewMacro(vtkPlusLatencyTracingCommand);
+
+namespace
+{
+  static const std::string START_CMD = "StartLatencyTracing";
+  static const std::string STOP_CMD = "StopLatencyTracing";
+  static const std::string GET_STATISTICS_CMD = "GetLatencyStatistics";
+  static const std::string SAVE_TRACE_CMD = "SaveLatencyTrace";
+
+  static const std::string DEFAULT_TRACE_FILENAME = "LatencyTrace.json";
+}
+
+//----------------------------------------------------------------------------
+vtkPlusLatencyTracingCommand::vtkPlusLatencyTracingCommand()
+{
+}
+
+//----------------------------------------------------------------------------
+vtkPlusLatencyTracingCommand::~vtkPlusLatencyTracingCommand()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusLatencyTracingCommand::SetNameToStart() { SetName(START_CMD); }
+void vtkPlusLatencyTracingCommand::SetNameToStop() { SetName(STOP_CMD); }
+void vtkPlusLatencyTracingCommand::SetNameToGetStatistics() { SetName(GET_STATISTICS_CMD); }
+void vtkPlusLatencyTracingCommand::SetNameToSaveTrace() { SetName(SAVE_TRACE_CMD); }
+
+//----------------------------------------------------------------------------
+void vtkPlusLatencyTracingCommand::GetCommandNames(std::list<std::string>& cmdNames)
+{
+  cmdNames.clear();
+  cmdNames.push_back(START_CMD);
+  cmdNames.push_back(STOP_CMD);
+  cmdNames.push_back(GET_STATISTICS_CMD);
+  cmdNames.push_back(SAVE_TRACE_CMD);
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusLatencyTracingCommand::GetDescription(const std::string& commandName)
+{
+  std::string desc;
+  if (commandName.empty() || igsioCommon::IsEqualInsensitive(commandName, START_CMD))
+  {
+    desc += START_CMD;
+    desc += ": Clear the latency statistics and start recording the latency of the frames from acquisition to sending.";
+  }
+  if (commandName.empty() || igsioCommon::IsEqualInsensitive(commandName, STOP_CMD))
+  {
+    desc += STOP_CMD;
+    desc += ": Stop recording latencies. The recorded statistics are kept.";
+  }
+  if (commandName.empty() || igsioCommon::IsEqualInsensitive(commandName, GET_STATISTICS_CMD))
+  {
+    desc += GET_STATISTICS_CMD;
+    desc += ": Get the per-channel and per-client latency histograms.";
+  }
+  if (commandName.empty() || igsioCommon::IsEqualInsensitive(commandName, SAVE_TRACE_CMD))
+  {
+    desc += SAVE_TRACE_CMD;
+    desc += ": Save the recently recorded frames in Chrome trace JSON format. Attributes: OutputFilename: name of the output file, relative to the output directory (optional, default: " + DEFAULT_TRACE_FILENAME + ")";
+  }
+  return desc;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusLatencyTracingCommand::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusLatencyTracingCommand::ReadConfiguration(vtkXMLDataElement* aConfig)
+{
+  if (vtkPlusCommand::ReadConfiguration(aConfig) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  XML_READ_STRING_ATTRIBUTE_OPTIONAL(OutputFilename, aConfig);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusLatencyTracingCommand::WriteConfiguration(vtkXMLDataElement* aConfig)
+{
+  if (vtkPlusCommand::WriteConfiguration(aConfig) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  XML_WRITE_STRING_ATTRIBUTE_REMOVE_IF_EMPTY(OutputFilename, aConfig);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusLatencyTracingCommand::Execute()
+{
+  LatencyTracer& tracer = LatencyTracer::GetInstance();
+
+  if (igsioCommon::IsEqualInsensitive(this->Name, START_CMD))
+  {
+    tracer.Reset();
+    tracer.SetEnabled(true);
+    this->QueueCommandResponse(PLUS_SUCCESS, "Latency tracing started.");
+    return PLUS_SUCCESS;
+  }
+  else if (igsioCommon::IsEqualInsensitive(this->Name, STOP_CMD))
+  {
+    tracer.SetEnabled(false);
+    this->QueueCommandResponse(PLUS_SUCCESS, "Latency tracing stopped.");
+    return PLUS_SUCCESS;
+  }
+  else if (igsioCommon::IsEqualInsensitive(this->Name, GET_STATISTICS_CMD))
+  {
+    this->QueueCommandResponse(PLUS_SUCCESS, tracer.GetStatisticsAsText());
+    return PLUS_SUCCESS;
+  }
+  else if (igsioCommon::IsEqualInsensitive(this->Name, SAVE_TRACE_CMD))
+  {
+    std::string outputFilename = vtkPlusConfig::GetInstance()->GetOutputPath(this->OutputFilename.empty() ? DEFAULT_TRACE_FILENAME : this->OutputFilename);
+    if (tracer.WriteChromeTrace(outputFilename) != PLUS_SUCCESS)
+    {
+      this->QueueCommandResponse(PLUS_FAIL, "Command failed. See error message.", "Failed to save latency trace to " + outputFilename);
+      return PLUS_FAIL;
+    }
+    this->QueueCommandResponse(PLUS_SUCCESS, "Latency trace saved to " + outputFilename);
+    return PLUS_SUCCESS;
+  }
+
+  this->QueueCommandResponse(PLUS_FAIL, "Command failed. See error message.", "Unknown command: " + this->Name);
+  return PLUS_FAIL;
+}
@@ -0,0 +1,62 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusLatencyTracingCommand_h
+#define __vtkPlusLatencyTracingCommand_h
+
+#include "vtkPlusServerExport.h"
+
+#include "vtkPlusCommand.h"
+
+/*!
+  \class vtkPlusLatencyTracingCommand
+  \brief This command controls the latency tracing of frames from acquisition to sending (see LatencyTracer)
+  \ingroup PlusLibPlusServer
+ */
+class vtkPlusServerExport vtkPlusLatencyTracingCommand : public vtkPlusCommand
+{
+public:
+
+  static vtkPlusLatencyTracingCommand* New();
+  vtkTypeMacro(vtkPlusLatencyTracingCommand, vtkPlusCommand);
+  virtual void PrintSelf(ostream& os, vtkIndent indent);
+  virtual vtkPlusCommand* Clone() { return New(); }
+
+  /*! Executes the command  */
+  virtual PlusStatus Execute();
+
+  /*! Read command parameters from XML */
+  virtual PlusStatus ReadConfiguration(vtkXMLDataElement* aConfig);
+
+  /*! Write command parameters to XML */
+  virtual PlusStatus WriteConfiguration(vtkXMLDataElement* aConfig);
+
+  /*! Get all the command names that this class can execute */
+  virtual void GetCommandNames(std::list<std::string>& cmdNames);
+
+  /*! Gets the description for the specified command name. */
+  virtual std::string GetDescription(const std::string& commandName);
+
+  vtkGetStdStringMacro(OutputFilename);
+  vtkSetStdStringMacro(OutputFilename);
+
+  void SetNameToStart();
+  void SetNameToStop();
+  void SetNameToGetStatistics();
+  void SetNameToSaveTrace();
+
+protected:
+  vtkPlusLatencyTracingCommand();
+  virtual ~vtkPlusLatencyTracingCommand();
+
+private:
+  std::string OutputFilename;
+
+  vtkPlusLatencyTracingCommand(const vtkPlusLatencyTracingCommand&);
+  void operator=(const vtkPlusLatencyTracingCommand&);
+};
+
+#endif
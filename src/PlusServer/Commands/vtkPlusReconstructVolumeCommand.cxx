@@ -33,6 +33,11 @@ vtkStandardNewMacro(vtkPlusReconstructVolumeCommand);
 //----------------------------------------------------------------------------
 vtkPlusReconstructVolumeCommand::vtkPlusReconstructVolumeCommand()
   : ApplyHoleFilling(true)
+  , ModifiedRegionOnly(false)
+  , PreviewLevel(0)
+  , Background(false)
+  , ProgressIntervalSec(1.0)
+  , SendIntermediateVolumes(false)
 {
   this->OutputOrigin[0] = UNDEFINED_VALUE;
   this->OutputOrigin[1] = UNDEFINED_VALUE;
@@ -104,7 +109,7 @@ std::string vtkPlusReconstructVolumeCommand::GetDescription(const std::string& c
   if (commandName.empty() || igsioCommon::IsEqualInsensitive(commandName, RECONSTRUCT_PRERECORDED_CMD))
   {
     desc += RECONSTRUCT_PRERECORDED_CMD;
-    desc += ": Reconstruct a volume from a file and writes the result to a file. Attributes: InputSeqFilename: name of the input sequence file name that contains the list of frames. OutputVolFilename: name of the output volume file name (optional). OutputVolDeviceName: name of the OpenIGTLink device for the IMAGE message (optional).";
+    desc += ": Reconstruct a volume from a file and writes the result to a file. Attributes: InputSeqFilename: name of the input sequence file name that contains the list of frames. OutputVolFilename: name of the output volume file name (optional). OutputVolDeviceName: name of the OpenIGTLink device for the IMAGE message (optional). Background: if TRUE then the command replies immediately and the reconstruction runs in the background, it sends progress replies and the result when completed, and it can be suspended, resumed, stopped, or snapshots can be requested as in live reconstruction (optional, default: FALSE). ProgressIntervalSec: minimum time between progress replies (optional, default: 1.0). SendIntermediateVolumes: if TRUE then the volume is sent at PreviewLevel resolution with each progress reply (optional, default: FALSE).";
   }
   if (commandName.empty() || igsioCommon::IsEqualInsensitive(commandName, START_LIVE_RECONSTRUCTION_CMD))
   {
@@ -114,22 +119,22 @@ std::string vtkPlusReconstructVolumeCommand::GetDescription(const std::string& c
   if (commandName.empty() || igsioCommon::IsEqualInsensitive(commandName, SUSPEND_LIVE_RECONSTRUCTION_CMD))
   {
     desc += SUSPEND_LIVE_RECONSTRUCTION_CMD;
-    desc += ": Suspend adding acquired frames to the volume. Attributes: VolumeReconstructorDeviceId: ID of the volume reconstructor device.";
+    desc += ": Suspend adding acquired frames (or frames of the background reconstruction from file) to the volume. Attributes: VolumeReconstructorDeviceId: ID of the volume reconstructor device.";
   }
   if (commandName.empty() || igsioCommon::IsEqualInsensitive(commandName, RESUME_LIVE_RECONSTRUCTION_CMD))
   {
     desc += RESUME_LIVE_RECONSTRUCTION_CMD;
-    desc += ": Resume adding acquired frames to the volume. Attributes: VolumeReconstructorDeviceId: ID of the volume reconstructor device.";
+    desc += ": Resume adding acquired frames (or frames of the background reconstruction from file) to the volume. Attributes: VolumeReconstructorDeviceId: ID of the volume reconstructor device.";
   }
   if (commandName.empty() || igsioCommon::IsEqualInsensitive(commandName, STOP_LIVE_RECONSTRUCTION_CMD))
   {
     desc += STOP_LIVE_RECONSTRUCTION_CMD;
-    desc += ": Stop adding acquired frames to the volume, finalize reconstruction, and save/send the results. Attributes: VolumeReconstructorDeviceId: ID of the volume reconstructor device. OutputVolFilename: name of the output volume file name (optional). OutputVolDeviceName: name of the OpenIGTLink device for the IMAGE message (optional).";
+    desc += ": Stop adding acquired frames to the volume, finalize reconstruction, and save/send the results. A background reconstruction from file is cancelled. Attributes: VolumeReconstructorDeviceId: ID of the volume reconstructor device. OutputVolFilename: name of the output volume file name (optional). OutputVolDeviceName: name of the OpenIGTLink device for the IMAGE message (optional).";
   }
   if (commandName.empty() || igsioCommon::IsEqualInsensitive(commandName, GET_LIVE_RECONSTRUCTION_SNAPSHOT_CMD))
   {
     desc += GET_LIVE_RECONSTRUCTION_SNAPSHOT_CMD;
-    desc += ": Request a snapshot of the live reconstruction result. Attributes: VolumeReconstructorDeviceId: ID of the volume reconstructor device. OutputVolFilename: name of the output volume file name (optional). OutputVolDeviceName: name of the OpenIGTLink device for the IMAGE message (optional). ApplyHoleFilling: if FALSE then holes will not be filled (optional, default: TRUE).";
+    desc += ": Request a snapshot of the live or background reconstruction result. Attributes: VolumeReconstructorDeviceId: ID of the volume reconstructor device. OutputVolFilename: name of the output volume file name (optional). OutputVolDeviceName: name of the OpenIGTLink device for the IMAGE message (optional). ApplyHoleFilling: if FALSE then holes will not be filled (optional, default: TRUE). ModifiedRegionOnly: if TRUE then only the region that has been modified since the previous snapshot is sent, positioned by its origin, and no image is sent if nothing has been modified (optional, default: FALSE). PreviewLevel: if positive then the volume is sent downsampled by a factor of 2 to the power of PreviewLevel along each axis, for fast live preview (optional, default: 0).";
   }
 
   return desc;
@@ -154,6 +159,11 @@ PlusStatus vtkPlusReconstructVolumeCommand::ReadConfiguration(vtkXMLDataElement*
   XML_READ_VECTOR_ATTRIBUTE_OPTIONAL(int, 6, OutputExtent, aConfig);
 
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(ApplyHoleFilling, aConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(ModifiedRegionOnly, aConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, PreviewLevel, aConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(Background, aConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, ProgressIntervalSec, aConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(SendIntermediateVolumes, aConfig);
   return PLUS_SUCCESS;
 }
 
@@ -192,6 +202,11 @@ PlusStatus vtkPlusReconstructVolumeCommand::WriteConfiguration(vtkXMLDataElement
   }
 
   XML_WRITE_BOOL_ATTRIBUTE(ApplyHoleFilling, aConfig);
+  XML_WRITE_BOOL_ATTRIBUTE(ModifiedRegionOnly, aConfig);
+  aConfig->SetIntAttribute("PreviewLevel", this->PreviewLevel);
+  XML_WRITE_BOOL_ATTRIBUTE(Background, aConfig);
+  aConfig->SetDoubleAttribute("ProgressIntervalSec", this->ProgressIntervalSec);
+  XML_WRITE_BOOL_ATTRIBUTE(SendIntermediateVolumes, aConfig);
 
   return PLUS_SUCCESS;
 }
@@ -229,10 +244,16 @@ PlusStatus vtkPlusReconstructVolumeCommand::Execute()
   std::string outputVolDeviceName = (!reconstructorDevice->GetOutputVolDeviceName().empty() ? reconstructorDevice->GetOutputVolDeviceName() : "");
 
   std::string reconstructorDeviceId = (reconstructorDevice->GetDeviceId().empty() ? "(unknown)" : reconstructorDevice->GetDeviceId());
+  std::string baseMessage = this->Name + std::string("(") + reconstructorDeviceId + std::string(")");
 
   // Set output volume size and resolution
   if (igsioCommon::IsEqualInsensitive(this->Name, RECONSTRUCT_PRERECORDED_CMD) || igsioCommon::IsEqualInsensitive(this->Name, START_LIVE_RECONSTRUCTION_CMD))
   {
+    if (reconstructorDevice->IsReconstructionFromFileInProgress())
+    {
+      this->QueueCommandResponse(PLUS_FAIL, "Command failed. See error message.", baseMessage + " Reconstruction failed: background reconstruction from sequence file is in progress.");
+      return PLUS_FAIL;
+    }
     // Only allow changing the output volume when we start the reconstruction
     if (this->OutputOrigin[0] != UNDEFINED_VALUE && this->OutputOrigin[1] != UNDEFINED_VALUE && this->OutputOrigin[2] != UNDEFINED_VALUE)
     {
@@ -250,7 +271,6 @@ PlusStatus vtkPlusReconstructVolumeCommand::Execute()
     }
   }
 
-  std::string baseMessage = this->Name + std::string("(") + reconstructorDeviceId + std::string(")");
   if (igsioCommon::IsEqualInsensitive(this->Name, RECONSTRUCT_PRERECORDED_CMD))
   {
     LOG_INFO("Volume reconstruction from sequence file: " << (!this->InputSeqFilename.empty() ? this->InputSeqFilename : "(undefined)") << ", device: " << reconstructorDeviceId);
@@ -265,6 +285,10 @@ PlusStatus vtkPlusReconstructVolumeCommand::Execute()
       return PLUS_FAIL;
     }
     reconstructorDevice->Reset(); // Clear volume
+    if (this->Background)
+    {
+      return this->StartBackgroundReconstruction(reconstructorDevice, outputVolFilename, outputVolDeviceName, baseMessage);
+    }
     vtkSmartPointer<vtkImageData> volumeToSend = vtkSmartPointer<vtkImageData>::New();
     std::string errorMessage;
     if (reconstructorDevice->GetReconstructedVolumeFromFile(this->InputSeqFilename, volumeToSend, errorMessage) != PLUS_SUCCESS)
@@ -273,7 +297,7 @@ PlusStatus vtkPlusReconstructVolumeCommand::Execute()
       return PLUS_FAIL;
     }
     std::string statusMessage;
-    PlusStatus status = ProcessImageReply(volumeToSend, outputVolFilename, outputVolDeviceName, statusMessage);
+    PlusStatus status = ProcessImageReply(reconstructorDevice, volumeToSend, outputVolFilename, outputVolDeviceName, statusMessage, this->CommandResponseQueue);
     this->QueueCommandResponse(status, std::string("Command ") + std::string((status == PLUS_SUCCESS ? "succeeded." : "failed. See error message.")), baseMessage + " Reconstruction from sequence file completed: " + statusMessage);
     return status;
   }
@@ -297,6 +321,13 @@ PlusStatus vtkPlusReconstructVolumeCommand::Execute()
   }
   else if (igsioCommon::IsEqualInsensitive(this->Name, STOP_LIVE_RECONSTRUCTION_CMD))
   {
+    if (reconstructorDevice->IsReconstructionFromFileInProgress())
+    {
+      // the result is sent by the reconstruction thread in reply to the command that started it
+      reconstructorDevice->CancelReconstructionFromFile();
+      this->QueueCommandResponse(PLUS_SUCCESS, baseMessage + " Background reconstruction from sequence file cancelled.");
+      return PLUS_SUCCESS;
+    }
     // it's stopped if: not in progress (it may be just suspended) and no frames have been recorded
     if (!reconstructorDevice->GetEnableReconstruction() && reconstructorDevice->GetTotalFramesRecorded() == 0)
     {
@@ -315,7 +346,7 @@ PlusStatus vtkPlusReconstructVolumeCommand::Execute()
     }
     reconstructorDevice->Reset(); // Clear volume
     std::string statusMessage;
-    PlusStatus status = ProcessImageReply(volumeToSend, outputVolFilename, outputVolDeviceName, statusMessage);
+    PlusStatus status = ProcessImageReply(reconstructorDevice, volumeToSend, outputVolFilename, outputVolDeviceName, statusMessage, this->CommandResponseQueue);
     this->QueueCommandResponse(status, std::string("Command ") + std::string((status == PLUS_SUCCESS ? "succeeded." : "failed. See error message.")), baseMessage + " Reconstruction from live frames completed: " + statusMessage);
     return status;
   }
@@ -324,18 +355,30 @@ PlusStatus vtkPlusReconstructVolumeCommand::Execute()
     LOG_INFO("Volume reconstruction from live frames snapshot request, device: " << reconstructorDeviceId);
     vtkSmartPointer<vtkImageData> volumeToSend = vtkSmartPointer<vtkImageData>::New();
     std::string errorMessage;
-    if (reconstructorDevice->GetReconstructedVolume(volumeToSend, errorMessage, this->ApplyHoleFilling) != PLUS_SUCCESS)
+    if (reconstructorDevice->GetReconstructedVolume(volumeToSend, errorMessage, this->ApplyHoleFilling, this->ModifiedRegionOnly, this->PreviewLevel) != PLUS_SUCCESS)
     {
       this->QueueCommandResponse(PLUS_FAIL, "Command failed. See error message.", baseMessage + " Reconstruction snapshot request failed, device: " + errorMessage);
       return PLUS_FAIL;
     }
+    if (this->ModifiedRegionOnly && volumeToSend->GetNumberOfPoints() == 0)
+    {
+      this->QueueCommandResponse(PLUS_SUCCESS, baseMessage + " Volume has not been modified since the previous snapshot.");
+      return PLUS_SUCCESS;
+    }
     std::string statusMessage;
-    PlusStatus status = ProcessImageReply(volumeToSend, outputVolFilename, outputVolDeviceName, statusMessage);
+    PlusStatus status = ProcessImageReply(reconstructorDevice, volumeToSend, outputVolFilename, outputVolDeviceName, statusMessage, this->CommandResponseQueue);
     this->QueueCommandResponse(status, std::string("Command ") + std::string((status == PLUS_SUCCESS ? "succeeded." : "failed. See error message.")), baseMessage + " " + statusMessage);
     return status;
   }
   else if (igsioCommon::IsEqualInsensitive(this->Name, SUSPEND_LIVE_RECONSTRUCTION_CMD))
   {
+    if (reconstructorDevice->IsReconstructionFromFileInProgress())
+    {
+      LOG_INFO("Volume reconstruction from sequence file suspending, device: " << reconstructorDeviceId);
+      reconstructorDevice->SetReconstructionFromFileSuspended(true);
+      this->QueueCommandResponse(PLUS_SUCCESS, baseMessage + " Background reconstruction from sequence file suspended.");
+      return PLUS_SUCCESS;
+    }
     LOG_INFO("Volume reconstruction from live frames suspending, device: " << reconstructorDeviceId);
     if (!reconstructorDevice->GetEnableReconstruction())
     {
@@ -348,6 +391,13 @@ PlusStatus vtkPlusReconstructVolumeCommand::Execute()
   }
   else if (igsioCommon::IsEqualInsensitive(this->Name, RESUME_LIVE_RECONSTRUCTION_CMD))
   {
+    if (reconstructorDevice->IsReconstructionFromFileInProgress())
+    {
+      LOG_INFO("Volume reconstruction from sequence file resuming, device: " << reconstructorDeviceId);
+      reconstructorDevice->SetReconstructionFromFileSuspended(false);
+      this->QueueCommandResponse(PLUS_SUCCESS, baseMessage + " Background reconstruction from sequence file resumed.");
+      return PLUS_SUCCESS;
+    }
     LOG_INFO("Volume reconstruction from live frames resuming, device: " << reconstructorDeviceId);
     if (reconstructorDevice->GetEnableReconstruction())
     {
@@ -364,7 +414,8 @@ PlusStatus vtkPlusReconstructVolumeCommand::Execute()
 }
 
 //----------------------------------------------------------------------------
-PlusStatus vtkPlusReconstructVolumeCommand::ProcessImageReply(vtkImageData* volumeToSend, const std::string& outputVolFilename, const std::string& outputVolDeviceName, std::string& resultMessage)
+PlusStatus vtkPlusReconstructVolumeCommand::ProcessImageReply(vtkPlusVirtualVolumeReconstructor* reconstructorDevice, vtkImageData* volumeToSend, const std::string& outputVolFilename,
+    const std::string& outputVolDeviceName, std::string& resultMessage, PlusCommandResponseList& responses)
 {
   PlusStatus status = PLUS_SUCCESS;
   resultMessage.clear();
@@ -372,11 +423,16 @@ PlusStatus vtkPlusReconstructVolumeCommand::ProcessImageReply(vtkImageData* volu
   {
     std::string outputVolFileFullPath = vtkPlusConfig::GetInstance()->GetOutputPath(outputVolFilename);
     LOG_INFO("Saving reconstructed volume to file: " << outputVolFileFullPath);
-    if (vtkPlusVolumeReconstructor::SaveReconstructedVolumeToFile(volumeToSend, outputVolFileFullPath) != PLUS_SUCCESS)
+    bool savedInBackground = false;
+    if (reconstructorDevice->SaveReconstructedVolumeToFile(volumeToSend, outputVolFileFullPath, savedInBackground) != PLUS_SUCCESS)
     {
       status = PLUS_FAIL;
       resultMessage += std::string("saving reconstructed volume to ") + outputVolFileFullPath + " failed";
     }
+    else if (savedInBackground)
+    {
+      resultMessage += std::string("saving reconstructed volume to file in the background: ") + outputVolFileFullPath;
+    }
     else
     {
       resultMessage += std::string("saved reconstructed volume to file: ") + outputVolFileFullPath;
@@ -399,11 +455,99 @@ PlusStatus vtkPlusReconstructVolumeCommand::ProcessImageReply(vtkImageData* volu
       resultMessage += ", ";
     }
     resultMessage += std::string("image sent as: ") + outputVolDeviceName;
-    this->CommandResponseQueue.push_back(imageResponse);
+    responses.push_back(imageResponse);
   }
   return status;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusReconstructVolumeCommand::StartBackgroundReconstruction(vtkPlusVirtualVolumeReconstructor* reconstructorDevice, const std::string& outputVolFilename,
+    const std::string& outputVolDeviceName, const std::string& baseMessage)
+{
+  // The command and the processor are kept alive until the reconstruction thread is completed.
+  // The device is not: it joins the reconstruction thread when it is disconnected or deleted.
+  vtkSmartPointer<vtkPlusReconstructVolumeCommand> self = this;
+  vtkSmartPointer<vtkPlusCommandProcessor> processor = this->CommandProcessor;
+  vtkPlusVirtualVolumeReconstructor::FileReconstructionProgressCallback progressCallback =
+    [self, processor, reconstructorDevice, outputVolDeviceName, baseMessage](int numberOfProcessedFrames, int numberOfFrames)
+  {
+    self->SendBackgroundReconstructionProgress(reconstructorDevice, numberOfProcessedFrames, numberOfFrames, outputVolDeviceName, baseMessage);
+  };
+  vtkPlusVirtualVolumeReconstructor::FileReconstructionCompletedCallback completedCallback =
+    [self, processor, reconstructorDevice, outputVolFilename, outputVolDeviceName, baseMessage](PlusStatus status, const std::string& errorMessage)
+  {
+    self->SendBackgroundReconstructionResult(reconstructorDevice, status, errorMessage, outputVolFilename, outputVolDeviceName, baseMessage);
+  };
+
+  if (this->InputSeqFilename.empty())
+  {
+    this->QueueCommandResponse(PLUS_FAIL, "Command failed. See error message.", baseMessage + " Reconstruction from sequence file failed: InputSeqFilename has not been defined.");
+    return PLUS_FAIL;
+  }
+  // The start reply is sent before the reconstruction thread is started, so that it cannot be preceded by progress or result replies
+  this->ReportProgress(0.0, baseMessage + " Background reconstruction from sequence file started.");
+  std::string errorMessage;
+  if (reconstructorDevice->StartReconstructionFromFile(this->InputSeqFilename, this->ProgressIntervalSec, progressCallback, completedCallback, errorMessage) != PLUS_SUCCESS)
+  {
+    this->QueueCommandResponse(PLUS_FAIL, "Command failed. See error message.", baseMessage + " Reconstruction from sequence file failed: " + errorMessage);
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusReconstructVolumeCommand::SendBackgroundReconstructionProgress(vtkPlusVirtualVolumeReconstructor* reconstructorDevice, int numberOfProcessedFrames,
+    int numberOfFrames, const std::string& outputVolDeviceName, const std::string& baseMessage)
+{
+  PlusCommandResponseList responses;
+  if (this->SendIntermediateVolumes && !outputVolDeviceName.empty())
+  {
+    // hole filling is skipped, intermediate volumes are only for monitoring the progress
+    vtkSmartPointer<vtkImageData> intermediateVolume = vtkSmartPointer<vtkImageData>::New();
+    std::string errorMessage;
+    if (reconstructorDevice->GetReconstructedVolume(intermediateVolume, errorMessage, false, false, this->PreviewLevel) == PLUS_SUCCESS)
+    {
+      std::string statusMessage;
+      this->ProcessImageReply(reconstructorDevice, intermediateVolume, "", outputVolDeviceName, statusMessage, responses);
+      // the intermediate volume is sent before the progress report that it belongs to
+      this->CommandProcessor->QueueResponses(responses);
+    }
+    else
+    {
+      LOG_WARNING("Failed to get intermediate volume of the background reconstruction: " << errorMessage);
+    }
+  }
+
+  double progressPercent = (numberOfFrames > 0 ? 100.0 * numberOfProcessedFrames / numberOfFrames : 0.0);
+  this->ReportProgress(progressPercent, baseMessage + " Reconstruction from sequence file in progress: "
+                       + igsioCommon::ToString<int>(numberOfProcessedFrames) + " out of " + igsioCommon::ToString<int>(numberOfFrames) + " frames processed.");
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusReconstructVolumeCommand::SendBackgroundReconstructionResult(vtkPlusVirtualVolumeReconstructor* reconstructorDevice, PlusStatus reconstructionStatus,
+    const std::string& errorMessage, const std::string& outputVolFilename, const std::string& outputVolDeviceName, const std::string& baseMessage)
+{
+  PlusCommandResponseList responses;
+  vtkSmartPointer<vtkImageData> volumeToSend = vtkSmartPointer<vtkImageData>::New();
+  std::string volumeErrorMessage;
+  if (reconstructionStatus != PLUS_SUCCESS)
+  {
+    responses.push_back(this->CreateCommandResponse(PLUS_FAIL, "Command failed. See error message.", baseMessage + " Reconstruction from sequence file failed: " + errorMessage));
+  }
+  else if (reconstructorDevice->GetReconstructedVolume(volumeToSend, volumeErrorMessage) != PLUS_SUCCESS)
+  {
+    responses.push_back(this->CreateCommandResponse(PLUS_FAIL, "Command failed. See error message.", baseMessage + " Reconstruction from sequence file failed: " + volumeErrorMessage));
+  }
+  else
+  {
+    std::string statusMessage;
+    PlusStatus status = ProcessImageReply(reconstructorDevice, volumeToSend, outputVolFilename, outputVolDeviceName, statusMessage, responses);
+    responses.push_back(this->CreateCommandResponse(status, std::string("Command ") + std::string((status == PLUS_SUCCESS ? "succeeded." : "failed. See error message.")),
+                        baseMessage + " Reconstruction from sequence file completed: " + statusMessage));
+  }
+  this->CommandProcessor->QueueResponses(responses);
+}
+
 //----------------------------------------------------------------------------
 vtkPlusVirtualVolumeReconstructor* vtkPlusReconstructVolumeCommand::GetVolumeReconstructorDevice()
 {
@@ -44,6 +44,9 @@ public:
   /*! Gets the description for the specified command name. */
   virtual std::string GetDescription(const std::string& commandName);
 
+  /*! Commands of the same volume reconstructor device are executed in order */
+  virtual std::string GetTargetDeviceId() const { return this->VolumeReconstructorDeviceId; }
+
   /*! File name of the sequence file that contains the image frames */
   vtkGetStdStringMacro(InputSeqFilename);
   vtkSetStdStringMacro(InputSeqFilename);
@@ -87,6 +90,30 @@ public:
   vtkGetMacro(ApplyHoleFilling, bool);
   vtkSetMacro(ApplyHoleFilling, bool);
 
+  /*! If true then the snapshot contains only the region of the volume that has been modified since the previous snapshot */
+  vtkGetMacro(ModifiedRegionOnly, bool);
+  vtkSetMacro(ModifiedRegionOnly, bool);
+
+  /*! Resolution level of the snapshot: 0 is full resolution, each higher level halves the resolution (see vtkPlusVirtualVolumeReconstructor::GetReconstructedVolume) */
+  vtkGetMacro(PreviewLevel, int);
+  vtkSetMacro(PreviewLevel, int);
+
+  /*!
+    If true then the reconstruction from sequence file runs in the background: the command replies immediately, then sends
+    progress replies (with Progress parameter) and the result when the reconstruction is completed. Meanwhile the
+    reconstruction can be suspended, resumed, stopped (cancelled), and snapshots can be requested, as in live reconstruction.
+  */
+  vtkGetMacro(Background, bool);
+  vtkSetMacro(Background, bool);
+
+  /*! Minimum time between progress replies of a background reconstruction */
+  vtkGetMacro(ProgressIntervalSec, double);
+  vtkSetMacro(ProgressIntervalSec, double);
+
+  /*! If true then the volume is sent at PreviewLevel resolution, without hole filling, with each progress reply of a background reconstruction */
+  vtkGetMacro(SendIntermediateVolumes, bool);
+  vtkSetMacro(SendIntermediateVolumes, bool);
+
   void SetNameToReconstruct();
   void SetNameToStart();
   void SetNameToStop();
@@ -96,7 +123,20 @@ public:
 
 protected:
   /*! Saves image to disk (if requested) and prepare sending image as a response (if requested) */
-  PlusStatus ProcessImageReply(vtkImageData* volumeToSend, const std::string& outputVolFilename, const std::string& outputVolDeviceName, std::string& resultMessage);
+  PlusStatus ProcessImageReply(vtkPlusVirtualVolumeReconstructor* reconstructorDevice, vtkImageData* volumeToSend, const std::string& outputVolFilename,
+                               const std::string& outputVolDeviceName, std::string& resultMessage, PlusCommandResponseList& responses);
+
+  /*! Start reconstruction from sequence file in the background. Progress and result replies are sent by the reconstruction thread. */
+  PlusStatus StartBackgroundReconstruction(vtkPlusVirtualVolumeReconstructor* reconstructorDevice, const std::string& outputVolFilename,
+      const std::string& outputVolDeviceName, const std::string& baseMessage);
+
+  /*! Send a progress reply (and an intermediate volume, if requested) of the background reconstruction. Called from the reconstruction thread. */
+  void SendBackgroundReconstructionProgress(vtkPlusVirtualVolumeReconstructor* reconstructorDevice, int numberOfProcessedFrames, int numberOfFrames,
+      const std::string& outputVolDeviceName, const std::string& baseMessage);
+
+  /*! Save/send the result of the background reconstruction. Called from the reconstruction thread. */
+  void SendBackgroundReconstructionResult(vtkPlusVirtualVolumeReconstructor* reconstructorDevice, PlusStatus reconstructionStatus, const std::string& errorMessage,
+                                          const std::string& outputVolFilename, const std::string& outputVolDeviceName, const std::string& baseMessage);
 
   vtkPlusVirtualVolumeReconstructor* GetVolumeReconstructorDevice();
 
@@ -115,6 +155,11 @@ protected:
   int OutputExtent[6];
 
   bool ApplyHoleFilling;
+  bool ModifiedRegionOnly;
+  int PreviewLevel;
+  bool Background;
+  double ProgressIntervalSec;
+  bool SendIntermediateVolumes;
 
   vtkPlusReconstructVolumeCommand(const vtkPlusReconstructVolumeCommand&);
   void operator=(const vtkPlusReconstructVolumeCommand&);
@@ -10,10 +10,14 @@ See License.txt for details.
 #include "vtkPlusCommandProcessor.h"
 #include "vtkPlusCommandResponse.h"
 #include "vtkPlusDataCollector.h"
+#include "vtkPlusDataSource.h"
 #include "vtkPlusDeviceFactory.h"
 #include "vtkPlusOpenIGTLinkServer.h"
 #include "vtkPlusRequestIdsCommand.h"
 
+#include <vtkIGSIOTransformRepository.h>
+#include <vtkXMLDataElement.h>
+
 vtkStandardNewMacro(vtkPlusRequestIdsCommand);
 
 namespace
@@ -22,6 +26,23 @@ namespace
   static const std::string REQUEST_DEVICE_CHANNEL_IDS_CMD = "RequestDeviceChannelIds";
   static const std::string REQUEST_DEVICE_IDS_CMD = "RequestDeviceIds";
   static const std::string REQUEST_INPUT_DEVICE_IDS_CMD = "RequestInputDeviceIds";
+  static const std::string REQUEST_CONFIGURATION_SNAPSHOT_CMD = "RequestConfigurationSnapshot";
+
+  //----------------------------------------------------------------------------
+  void SetSnapshotParameter(igtl::MessageBase::MetaDataMap& snapshot, const std::string& key, const std::string& value)
+  {
+    snapshot[key] = std::pair<IANA_ENCODING_TYPE, std::string>(IANA_TYPE_US_ASCII, value);
+  }
+
+  //----------------------------------------------------------------------------
+  void AppendToList(std::string& list, const std::string& item)
+  {
+    if (!list.empty())
+    {
+      list += ",";
+    }
+    list += item;
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -51,6 +72,10 @@ void vtkPlusRequestIdsCommand::SetNameToRequestDeviceChannelIds()
 {
   SetName(REQUEST_DEVICE_CHANNEL_IDS_CMD);
 }
+void vtkPlusRequestIdsCommand::SetNameToRequestConfigurationSnapshot()
+{
+  SetName(REQUEST_CONFIGURATION_SNAPSHOT_CMD);
+}
 
 //----------------------------------------------------------------------------
 void vtkPlusRequestIdsCommand::GetCommandNames(std::list<std::string>& cmdNames)
@@ -60,6 +85,7 @@ void vtkPlusRequestIdsCommand::GetCommandNames(std::list<std::string>& cmdNames)
   cmdNames.push_back(REQUEST_DEVICE_IDS_CMD);
   cmdNames.push_back(REQUEST_INPUT_DEVICE_IDS_CMD);
   cmdNames.push_back(REQUEST_DEVICE_CHANNEL_IDS_CMD);
+  cmdNames.push_back(REQUEST_CONFIGURATION_SNAPSHOT_CMD);
 }
 
 //----------------------------------------------------------------------------
@@ -86,6 +112,11 @@ std::string vtkPlusRequestIdsCommand::GetDescription(const std::string& commandN
     desc += REQUEST_DEVICE_CHANNEL_IDS_CMD;
     desc += ": Request the list of channels for a given device. Attributes: DeviceId: the id of the device to query.";
   }
+  if (commandName.empty() || igsioCommon::IsEqualInsensitive(commandName, REQUEST_CONFIGURATION_SNAPSHOT_CMD))
+  {
+    desc += REQUEST_CONFIGURATION_SNAPSHOT_CMD;
+    desc += ": Request all devices, channels, sources and persistent transforms in the reply parameters. Attributes: KnownVersion: ConfigurationVersion of a previous reply, only the version is returned if the configuration has not changed since.";
+  }
   return desc;
 }
 
@@ -104,6 +135,7 @@ PlusStatus vtkPlusRequestIdsCommand::ReadConfiguration(vtkXMLDataElement* aConfi
   }
   XML_READ_CSTRING_ATTRIBUTE_OPTIONAL(DeviceType, aConfig);
   XML_READ_CSTRING_ATTRIBUTE_OPTIONAL(DeviceId, aConfig);
+  XML_READ_CSTRING_ATTRIBUTE_OPTIONAL(KnownVersion, aConfig);
   return PLUS_SUCCESS;
 }
 
@@ -116,6 +148,7 @@ PlusStatus vtkPlusRequestIdsCommand::WriteConfiguration(vtkXMLDataElement* aConf
   }
   XML_WRITE_STRING_ATTRIBUTE_IF_NOT_EMPTY(DeviceId, aConfig);
   XML_WRITE_STRING_ATTRIBUTE_IF_NOT_EMPTY(DeviceType, aConfig);
+  XML_WRITE_STRING_ATTRIBUTE_IF_NOT_EMPTY(KnownVersion, aConfig);
   return PLUS_SUCCESS;
 }
 
@@ -300,7 +333,144 @@ PlusStatus vtkPlusRequestIdsCommand::Execute()
     this->QueueCommandResponse(PLUS_SUCCESS, oss.str(), "", nullptr);
     return PLUS_SUCCESS;
   }
+  else if (igsioCommon::IsEqualInsensitive(this->Name, REQUEST_CONFIGURATION_SNAPSHOT_CMD))
+  {
+    // The configuration state is identified by the configuration version of the command processor
+    // and the modification times of the device list and the transform repository
+    std::ostringstream versionStream;
+    versionStream << this->CommandProcessor->GetConfigurationVersion() << "." << dataCollector->GetMTime();
+    if (this->GetTransformRepository() != NULL)
+    {
+      versionStream << "." << this->GetTransformRepository()->GetMTime();
+    }
+    const std::string version = versionStream.str();
+
+    if (!this->KnownVersion.empty() && this->KnownVersion == version)
+    {
+      igtl::MessageBase::MetaDataMap unchangedParameters;
+      SetSnapshotParameter(unchangedParameters, "ConfigurationVersion", version);
+      SetSnapshotParameter(unchangedParameters, "Unchanged", "TRUE");
+      this->QueueCommandResponse(PLUS_SUCCESS, "Configuration is unchanged.", "", &unchangedParameters);
+      return PLUS_SUCCESS;
+    }
+
+    std::shared_ptr<const igtl::MessageBase::MetaDataMap> snapshot = this->CommandProcessor->GetConfigurationSnapshot(version);
+    if (snapshot == nullptr)
+    {
+      std::shared_ptr<igtl::MessageBase::MetaDataMap> newSnapshot = std::make_shared<igtl::MessageBase::MetaDataMap>();
+      if (this->BuildConfigurationSnapshot(aCollection, version, *newSnapshot) != PLUS_SUCCESS)
+      {
+        this->QueueCommandResponse(PLUS_FAIL, "Command failed, see error message.", "Unable to retrieve the configuration.");
+        return PLUS_FAIL;
+      }
+      this->CommandProcessor->SetConfigurationSnapshot(version, newSnapshot);
+      snapshot = newSnapshot;
+    }
+
+    std::ostringstream oss;
+    oss << "Configuration version " << version << ": " << snapshot->size() << " parameter" << (snapshot->size() > 1 ? "s." : ".");
+    this->QueueCommandResponse(PLUS_SUCCESS, oss.str(), "", snapshot.get());
+    return PLUS_SUCCESS;
+  }
 
   this->QueueCommandResponse(PLUS_FAIL, "Command failed, see error message.", "Unknown command.");
   return PLUS_FAIL;
 }
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusRequestIdsCommand::BuildConfigurationSnapshot(const DeviceCollection& devices, const std::string& version, igtl::MessageBase::MetaDataMap& snapshot)
+{
+  snapshot.clear();
+  SetSnapshotParameter(snapshot, "ConfigurationVersion", version);
+
+  std::string deviceIds;
+  std::string channelIds;
+  for (DeviceCollectionConstIterator deviceIt = devices.begin(); deviceIt != devices.end(); ++deviceIt)
+  {
+    vtkPlusDevice* device = *deviceIt;
+    if (device == NULL)
+    {
+      continue;
+    }
+    const std::string deviceKey = "Device:" + device->GetDeviceId();
+    AppendToList(deviceIds, device->GetDeviceId());
+    SetSnapshotParameter(snapshot, deviceKey + ":Type", device->GetClassName());
+
+    std::string inputChannelIds;
+    for (ChannelContainerConstIterator channelIt = device->GetInputChannelsStart(); channelIt != device->GetInputChannelsEnd(); ++channelIt)
+    {
+      AppendToList(inputChannelIds, (*channelIt)->GetChannelId());
+    }
+    SetSnapshotParameter(snapshot, deviceKey + ":InputChannels", inputChannelIds);
+
+    std::string outputChannelIds;
+    for (ChannelContainerConstIterator channelIt = device->GetOutputChannelsStart(); channelIt != device->GetOutputChannelsEnd(); ++channelIt)
+    {
+      vtkPlusChannel* channel = *channelIt;
+      AppendToList(outputChannelIds, channel->GetChannelId());
+      AppendToList(channelIds, channel->GetChannelId());
+
+      std::string sourceIds;
+      vtkPlusDataSource* videoSource = NULL;
+      if (channel->GetVideoSource(videoSource) == PLUS_SUCCESS)
+      {
+        AppendToList(sourceIds, videoSource->GetSourceId());
+      }
+      for (DataSourceContainerConstIterator toolIt = channel->GetToolsStartConstIterator(); toolIt != channel->GetToolsEndConstIterator(); ++toolIt)
+      {
+        AppendToList(sourceIds, toolIt->second->GetSourceId());
+      }
+      for (DataSourceContainerConstIterator fieldIt = channel->GetFieldDataSourcesStartConstIterator(); fieldIt != channel->GetFieldDataSourcesEndConstIterator(); ++fieldIt)
+      {
+        AppendToList(sourceIds, fieldIt->second->GetSourceId());
+      }
+      SetSnapshotParameter(snapshot, "Channel:" + channel->GetChannelId() + ":Device", device->GetDeviceId());
+      SetSnapshotParameter(snapshot, "Channel:" + channel->GetChannelId() + ":Sources", sourceIds);
+    }
+    SetSnapshotParameter(snapshot, deviceKey + ":OutputChannels", outputChannelIds);
+  }
+  SetSnapshotParameter(snapshot, "Devices", deviceIds);
+  SetSnapshotParameter(snapshot, "Channels", channelIds);
+
+  // The persistent transforms are enumerated by writing them to a temporary configuration element.
+  // The values of the non-persistent transforms change with each frame, they are queried by GetTransform.
+  std::string transformNames;
+  if (this->GetTransformRepository() != NULL)
+  {
+    vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::New();
+    configRootElement->SetName("PlusConfiguration");
+    if (this->GetTransformRepository()->WriteConfiguration(configRootElement) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Unable to write the transforms of the transform repository");
+      return PLUS_FAIL;
+    }
+    vtkXMLDataElement* coordinateDefinitions = configRootElement->FindNestedElementWithName("CoordinateDefinitions");
+    for (int nestedElementIndex = 0; coordinateDefinitions != NULL && nestedElementIndex < coordinateDefinitions->GetNumberOfNestedElements(); ++nestedElementIndex)
+    {
+      vtkXMLDataElement* transformElement = coordinateDefinitions->GetNestedElement(nestedElementIndex);
+      const char* fromAttribute = transformElement->GetAttribute("From");
+      const char* toAttribute = transformElement->GetAttribute("To");
+      if (STRCASECMP(transformElement->GetName(), "Transform") != 0 || fromAttribute == NULL || toAttribute == NULL)
+      {
+        continue;
+      }
+      const std::string transformName = std::string(fromAttribute) + "To" + toAttribute;
+      AppendToList(transformNames, transformName);
+      const char* matrixAttribute = transformElement->GetAttribute("Matrix");
+      SetSnapshotParameter(snapshot, "Transform:" + transformName, matrixAttribute != NULL ? matrixAttribute : "");
+      const char* errorAttribute = transformElement->GetAttribute("Error");
+      if (errorAttribute != NULL)
+      {
+        SetSnapshotParameter(snapshot, "Transform:" + transformName + ":Error", errorAttribute);
+      }
+      const char* dateAttribute = transformElement->GetAttribute("Date");
+      if (dateAttribute != NULL)
+      {
+        SetSnapshotParameter(snapshot, "Transform:" + transformName + ":Date", dateAttribute);
+      }
+    }
+  }
+  SetSnapshotParameter(snapshot, "Transforms", transformNames);
+
+  return PLUS_SUCCESS;
+}
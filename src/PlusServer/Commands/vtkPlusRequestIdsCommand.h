@@ -11,9 +11,17 @@
 
 #include "vtkPlusCommand.h"
 
+class vtkPlusDevice;
+
 /*!
   \class vtkPlusRequestDeviceIDsCommand
   \brief This command returns the list of devices to the client
+
+  RequestConfigurationSnapshot returns all devices, channels, sources and persistent transforms in the reply parameters
+  of one reply. The snapshot is built once for each configuration state and shared by all clients until a command changes
+  the configuration (see vtkPlusCommand::ChangesConfiguration) or the device list or transform repository is modified.
+  A client that polls the configuration can send the ConfigurationVersion of its last reply as KnownVersion, then only
+  the version is returned while the configuration is unchanged.
   \ingroup PlusLibPlusServer
  */
 class vtkPlusServerExport vtkPlusRequestIdsCommand : public vtkPlusCommand
@@ -38,6 +46,7 @@ public:
   void SetNameToRequestDeviceIds();
   void SetNameToRequestInputDeviceIds();
   void SetNameToRequestDeviceChannelIds();
+  void SetNameToRequestConfigurationSnapshot();
 
   /*! Read command parameters from XML */
   virtual PlusStatus ReadConfiguration(vtkXMLDataElement* aConfig);
@@ -52,13 +61,21 @@ public:
   vtkGetStdStringMacro(DeviceId);
   vtkSetStdStringMacro(DeviceId);
 
+  /*! ConfigurationVersion of the snapshot that the client already has, the snapshot is not sent again if it is still current */
+  vtkGetStdStringMacro(KnownVersion);
+  vtkSetStdStringMacro(KnownVersion);
+
 protected:
 
   vtkPlusRequestIdsCommand();
   virtual ~vtkPlusRequestIdsCommand();
 
+  /*! Build the reply parameters of RequestConfigurationSnapshot from the current devices and transforms */
+  PlusStatus BuildConfigurationSnapshot(const std::vector<vtkPlusDevice*>& devices, const std::string& version, igtl::MessageBase::MetaDataMap& snapshot);
+
   std::string DeviceType;
   std::string DeviceId;
+  std::string KnownVersion;
 
 private:
 
@@ -44,6 +44,9 @@ public:
   /*! Gets the description for the specified command name. */
   virtual std::string GetDescription(const std::string& commandName);
 
+  /*! Commands of the same device are executed in order */
+  virtual std::string GetTargetDeviceId() const { return this->DeviceId; }
+
   /*! Id of the device that the text will be sent to */
   virtual std::string GetDeviceId() const;
   virtual void SetDeviceId(const std::string& deviceId);
@@ -154,19 +154,23 @@ PlusStatus vtkPlusSetUsParameterCommand::Execute()
     return PLUS_FAIL;
   }
 
-  std::string usDeviceId = (usDevice->GetDeviceId().empty() ? "(unknown)" : usDevice->GetDeviceId());
   vtkPlusUsImagingParameters* imagingParameters = usDevice->GetImagingParameters();
-  std::string resultString = "<CommandReply>";
-  std::string error = "";
-  std::map < std::string, std::pair<IANA_ENCODING_TYPE, std::string> > metaData;
-  PlusStatus status = PLUS_SUCCESS;
+  this->ParameterResults.clear();
+  this->ParameterErrors.clear();
 
+  // The later values of the merged commands replace the requested ones
+  std::map<std::string, std::string> parameterChanges = this->RequestedParameterChanges;
+  for (std::map<std::string, std::string>::const_iterator coalescedIt = this->CoalescedParameterChanges.begin(); coalescedIt != this->CoalescedParameterChanges.end(); ++coalescedIt)
+  {
+    parameterChanges[coalescedIt->first] = coalescedIt->second;
+  }
+
+  // All the parameters are set first and then applied to the device at once
   std::map<std::string, std::string>::iterator paramIt;
-  for (paramIt = this->RequestedParameterChanges.begin(); paramIt != this->RequestedParameterChanges.end(); ++paramIt)
+  for (paramIt = parameterChanges.begin(); paramIt != parameterChanges.end(); ++paramIt)
   {
     std::string parameterName = paramIt->first;
     std::string value = paramIt->second;
-    resultString += "<Parameter Name=\"" + parameterName + "\"";
 
     if (parameterName == vtkPlusUsImagingParameters::KEY_TGC)
     {
@@ -175,10 +179,7 @@ PlusStatus vtkPlusSetUsParameterCommand::Execute()
       std::vector<double> numbers((std::istream_iterator<double>(ss)), std::istream_iterator<double>());
       if (numbers.size() != 3)
       {
-        error += "Failed to parse " + parameterName + ".";
-        resultString += " Success=\"false\"/>";
-        metaData[parameterName] = std::make_pair(IANA_TYPE_US_ASCII, "FAIL");
-        status = PLUS_FAIL;
+        this->SetParameterResult(parameterName, false, "Failed to parse " + parameterName + ". ");
         continue;
       }
       imagingParameters->SetTimeGainCompensation(numbers);
@@ -190,10 +191,7 @@ PlusStatus vtkPlusSetUsParameterCommand::Execute()
       std::vector<int> numbers((std::istream_iterator<int>(ss)), std::istream_iterator<int>());
       if (numbers.size() != 3)
       {
-        error += "Failed to parse " + parameterName + ". ";
-        resultString += " Success=\"false\"/>";
-        metaData[parameterName] = std::make_pair(IANA_TYPE_US_ASCII, "FAIL");
-        status = PLUS_FAIL;
+        this->SetParameterResult(parameterName, false, "Failed to parse " + parameterName + ". ");
         continue;
       }
       imagingParameters->SetImageSize(numbers[0], numbers[1], numbers[2]);
@@ -216,37 +214,115 @@ PlusStatus vtkPlusSetUsParameterCommand::Execute()
       double parameterValue = vtkVariant(value).ToDouble(&valid);
       if (!valid)
       {
-        error += "Failed to parse " + parameterName + ". ";
-        resultString += " Success=\"false\"/>";
-        metaData[parameterName] = std::make_pair(IANA_TYPE_US_ASCII, "FAIL");
-        status = PLUS_FAIL;
+        this->SetParameterResult(parameterName, false, "Failed to parse " + parameterName + ". ");
         continue;
       }
       imagingParameters->SetValue<double>(parameterName, parameterValue);
     }
     else
     {
-      error += "Invalid parameter " + parameterName + ". ";
-      resultString += " Success=\"false\"/>";
-      metaData[parameterName] = std::make_pair(IANA_TYPE_US_ASCII, "FAIL");
-      status = PLUS_FAIL;
+      this->SetParameterResult(parameterName, false, "Invalid parameter " + parameterName + ". ");
       continue;
     }
+    this->SetParameterResult(parameterName, true, "");
+  } // For each parameter
 
-    if (usDevice->SetNewImagingParameters(*imagingParameters) == PLUS_FAIL)
+  bool anyParameterSet = false;
+  for (std::map<std::string, bool>::const_iterator resultIt = this->ParameterResults.begin(); resultIt != this->ParameterResults.end(); ++resultIt)
+  {
+    anyParameterSet |= resultIt->second;
+  }
+  if (anyParameterSet && usDevice->SetNewImagingParameters(*imagingParameters) == PLUS_FAIL)
+  {
+    for (std::map<std::string, bool>::iterator resultIt = this->ParameterResults.begin(); resultIt != this->ParameterResults.end(); ++resultIt)
     {
-      error += "Failed to set " + parameterName + ". ";
-      resultString += " Success=\"false\"/>";
-      metaData[parameterName] = std::make_pair(IANA_TYPE_US_ASCII, "FAIL");
-      status = PLUS_FAIL;
-      continue;
+      if (resultIt->second)
+      {
+        this->SetParameterResult(resultIt->first, false, "Failed to set " + resultIt->first + ". ");
+      }
     }
+  }
 
-    resultString += " Success=\"true\"/>";
-    metaData[parameterName] = std::make_pair(IANA_TYPE_US_ASCII, "SUCCESS");
-  } // For each parameter
+  return this->QueueParameterReply(this);
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusSetUsParameterCommand::GetCoalescingKey() const
+{
+  return SET_US_PARAMETER_CMD + ":" + this->UsDeviceId;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusSetUsParameterCommand::Coalesce(vtkPlusCommand* laterCommand)
+{
+  vtkPlusSetUsParameterCommand* laterParameterCommand = vtkPlusSetUsParameterCommand::SafeDownCast(laterCommand);
+  if (laterParameterCommand == NULL || laterParameterCommand->UsDeviceId != this->UsDeviceId)
+  {
+    return false;
+  }
+  std::map<std::string, std::string>::const_iterator paramIt;
+  for (paramIt = laterParameterCommand->RequestedParameterChanges.begin(); paramIt != laterParameterCommand->RequestedParameterChanges.end(); ++paramIt)
+  {
+    this->CoalescedParameterChanges[paramIt->first] = paramIt->second;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusSetUsParameterCommand::CompleteCoalesced(vtkPlusCommand* executedCommand, PlusStatus executionStatus)
+{
+  vtkPlusSetUsParameterCommand* executedParameterCommand = vtkPlusSetUsParameterCommand::SafeDownCast(executedCommand);
+  if (executedParameterCommand == NULL)
+  {
+    this->Superclass::CompleteCoalesced(executedCommand, executionStatus);
+    return;
+  }
+  this->QueueParameterReply(executedParameterCommand);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusSetUsParameterCommand::SetParameterResult(const std::string& parameterName, bool success, const std::string& error)
+{
+  this->ParameterResults[parameterName] = success;
+  if (success)
+  {
+    this->ParameterErrors.erase(parameterName);
+  }
+  else
+  {
+    this->ParameterErrors[parameterName] = error;
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSetUsParameterCommand::QueueParameterReply(vtkPlusSetUsParameterCommand* executedCommand)
+{
+  std::string resultString = "<CommandReply>";
+  std::string error = "";
+  std::map < std::string, std::pair<IANA_ENCODING_TYPE, std::string> > metaData;
+  PlusStatus status = PLUS_SUCCESS;
+
+  // Only the parameters requested by this command are reported, with the result of the command that set them
+  std::map<std::string, std::string>::const_iterator paramIt;
+  for (paramIt = this->RequestedParameterChanges.begin(); paramIt != this->RequestedParameterChanges.end(); ++paramIt)
+  {
+    const std::string& parameterName = paramIt->first;
+    resultString += "<Parameter Name=\"" + parameterName + "\"";
+    std::map<std::string, bool>::const_iterator resultIt = executedCommand->ParameterResults.find(parameterName);
+    if (resultIt != executedCommand->ParameterResults.end() && resultIt->second)
+    {
+      resultString += " Success=\"true\"/>";
+      metaData[parameterName] = std::make_pair(IANA_TYPE_US_ASCII, "SUCCESS");
+      continue;
+    }
+    std::map<std::string, std::string>::const_iterator errorIt = executedCommand->ParameterErrors.find(parameterName);
+    error += (errorIt != executedCommand->ParameterErrors.end() ? errorIt->second : "Failed to set " + parameterName + ". ");
+    resultString += " Success=\"false\"/>";
+    metaData[parameterName] = std::make_pair(IANA_TYPE_US_ASCII, "FAIL");
+    status = PLUS_FAIL;
+  }
   resultString += "</CommandReply>";
-  
+
   vtkSmartPointer<vtkPlusCommandRTSCommandResponse> commandResponse = vtkSmartPointer<vtkPlusCommandRTSCommandResponse>::New();
   commandResponse->UseDefaultFormatOff();
   commandResponse->SetClientId(this->ClientId);
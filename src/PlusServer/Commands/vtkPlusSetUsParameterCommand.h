@@ -16,6 +16,10 @@ class vtkPlusUsDevice;
 /*!
   \class vtkPlusSetUsParameterCommand
   \brief This command requests ultrasound parameter change in the client
+
+  Multiple parameters can be set by one command (nested Parameter elements), they are applied to the device at once.
+  SetUsParameter commands of the same device that are waiting in the queue consecutively (e.g., a burst sent while a slider
+  is dragged) are coalesced: only the latest value of each parameter is applied, and each command gets its reply.
   \ingroup PlusLibPlusServer
  */
 class vtkPlusServerExport vtkPlusSetUsParameterCommand : public vtkPlusCommand
@@ -42,15 +46,29 @@ public:
   /*! Gets the description for the specified command name. */
   virtual std::string GetDescription(const std::string& commandName);
 
+  /*! Commands of the same ultrasound device are executed in order */
+  virtual std::string GetTargetDeviceId() const { return this->UsDeviceId; }
+
   /*! Id of the ultrasound device to change the parameters of at the next Execute */
   vtkGetStdStringMacro(UsDeviceId);
   vtkSetStdStringMacro(UsDeviceId);
 
   void SetNameToSetUsParameter();
 
+  /*! Only the latest values of the parameters of consecutive commands of the same device are applied */
+  virtual std::string GetCoalescingKey() const;
+  virtual bool Coalesce(vtkPlusCommand* laterCommand);
+  virtual void CompleteCoalesced(vtkPlusCommand* executedCommand, PlusStatus executionStatus);
+
 protected:
   vtkPlusUsDevice* GetUsDevice();
 
+  /*! Record the result of setting a parameter at execution */
+  void SetParameterResult(const std::string& parameterName, bool success, const std::string& error);
+
+  /*! Queue the reply for the parameters requested by this command, with the results of the command that has been executed */
+  PlusStatus QueueParameterReply(vtkPlusSetUsParameterCommand* executedCommand);
+
   vtkPlusSetUsParameterCommand();
   virtual ~vtkPlusSetUsParameterCommand();
 
@@ -64,6 +82,13 @@ protected:
   */
   std::map<std::string, std::string> RequestedParameterChanges;
 
+  /*! Parameter changes of the later commands that have been merged into this command */
+  std::map<std::string, std::string> CoalescedParameterChanges;
+
+  /*! Result of setting each parameter at the last execution, and the error message of the failed ones */
+  std::map<std::string, bool> ParameterResults;
+  std::map<std::string, std::string> ParameterErrors;
+
   vtkPlusSetUsParameterCommand(const vtkPlusSetUsParameterCommand&);
   void operator=(const vtkPlusSetUsParameterCommand&);
 };
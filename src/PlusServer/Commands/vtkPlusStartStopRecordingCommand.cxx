@@ -25,11 +25,13 @@ namespace
   static const std::string SUSPEND_CMD = "SuspendRecording";
   static const std::string RESUME_CMD = "ResumeRecording";
   static const std::string STOP_CMD = "StopRecording";
+  static const std::string GET_STATUS_CMD = "GetRecordingStatus";
 }
 
 //----------------------------------------------------------------------------
 vtkPlusStartStopRecordingCommand::vtkPlusStartStopRecordingCommand()
   : EnableCompression(false)
+  , Background(false)
   , CodecFourCC("")
 {
 }
@@ -44,6 +46,7 @@ void vtkPlusStartStopRecordingCommand::SetNameToStart() { SetName(START_CMD); }
 void vtkPlusStartStopRecordingCommand::SetNameToSuspend() { SetName(SUSPEND_CMD); }
 void vtkPlusStartStopRecordingCommand::SetNameToResume() { SetName(RESUME_CMD); }
 void vtkPlusStartStopRecordingCommand::SetNameToStop() { SetName(STOP_CMD); }
+void vtkPlusStartStopRecordingCommand::SetNameToGetStatus() { SetName(GET_STATUS_CMD); }
 
 //----------------------------------------------------------------------------
 void vtkPlusStartStopRecordingCommand::GetCommandNames(std::list<std::string>& cmdNames)
@@ -53,6 +56,7 @@ void vtkPlusStartStopRecordingCommand::GetCommandNames(std::list<std::string>& c
   cmdNames.push_back(SUSPEND_CMD);
   cmdNames.push_back(RESUME_CMD);
   cmdNames.push_back(STOP_CMD);
+  cmdNames.push_back(GET_STATUS_CMD);
 }
 
 //----------------------------------------------------------------------------
@@ -77,7 +81,12 @@ std::string vtkPlusStartStopRecordingCommand::GetDescription(const std::string&
   if (commandName.empty() || igsioCommon::IsEqualInsensitive(commandName, STOP_CMD))
   {
     desc += STOP_CMD;
-    desc += ": Stop collecting data into file with a VirtualCapture device. Attributes: OutputFilename: name of the output file (optional if base file name is specified in config file). CaptureDeviceId (optional)";
+    desc += ": Stop collecting data into file with a VirtualCapture device. Attributes: OutputFilename: name of the output file (optional if base file name is specified in config file). CaptureDeviceId (optional). Background: if TRUE then the command replies immediately and the file is finalized in the background, a second reply is sent when the file is finalized (optional, default: FALSE)";
+  }
+  if (commandName.empty() || igsioCommon::IsEqualInsensitive(commandName, GET_STATUS_CMD))
+  {
+    desc += GET_STATUS_CMD;
+    desc += ": Get the state of recording and of the background file finalization of a VirtualCapture device. Attributes: CaptureDeviceId (optional)";
   }
   return desc;
 }
@@ -115,6 +124,12 @@ PlusStatus vtkPlusStartStopRecordingCommand::ReadConfiguration(vtkXMLDataElement
   // Start/Stop Common parameters
   XML_READ_CSTRING_ATTRIBUTE_OPTIONAL(OutputFilename, aConfig);
 
+  // Stop-only parameters
+  if (this->GetName() == STOP_CMD)
+  {
+    XML_READ_BOOL_ATTRIBUTE_OPTIONAL(Background, aConfig);
+  }
+
   // Start-only parameters
   if (this->GetName() == START_CMD)
   {
@@ -141,6 +156,10 @@ PlusStatus vtkPlusStartStopRecordingCommand::WriteConfiguration(vtkXMLDataElemen
   {
     XML_WRITE_BOOL_ATTRIBUTE(EnableCompression, aConfig);
   }
+  if (this->GetName() == STOP_CMD)
+  {
+    XML_WRITE_BOOL_ATTRIBUTE(Background, aConfig);
+  }
 
   return PLUS_SUCCESS;
 }
@@ -343,7 +362,7 @@ PlusStatus vtkPlusStartStopRecordingCommand::Execute()
   else if (igsioCommon::IsEqualInsensitive(this->Name, STOP_CMD))
   {
     // it's stopped if: not in progress (it may be just suspended) and no frames have been recorded
-    if (!captureDevice->GetEnableCapturing() && captureDevice->GetTotalFramesRecorded() == 0)
+    if (!captureDevice->GetEnableCapturing() && (captureDevice->GetTotalFramesRecorded() == 0 || captureDevice->IsFileFinalizationInProgress()))
     {
       this->QueueCommandResponse(PLUS_FAIL, "Command failed. See error message.", responseMessageBase + std::string("Recording to file is already stopped."));
       return PLUS_FAIL;
@@ -360,6 +379,25 @@ PlusStatus vtkPlusStartStopRecordingCommand::Execute()
     }
 
     long numberOfFramesRecorded = captureDevice->GetTotalFramesRecorded();
+    if (this->Background)
+    {
+      // The command and the processor are kept alive until the file is finalized
+      vtkSmartPointer<vtkPlusStartStopRecordingCommand> self = this;
+      vtkSmartPointer<vtkPlusCommandProcessor> processor = this->CommandProcessor;
+      vtkPlusVirtualCapture::FileFinalizedCallback completedCallback =
+        [self, processor, responseMessageBase](PlusStatus status, const std::string & actualOutputFilename, long numberOfFrames)
+      {
+        self->SendFileFinalizedResponse(status, actualOutputFilename, numberOfFrames, responseMessageBase);
+      };
+      // The stop reply is sent before the finalization is started, so that it cannot be preceded by the result reply
+      this->ReportProgress(0.0, responseMessageBase + "Recording " + igsioCommon::ToString<long>(numberOfFramesRecorded) + " frames stopped, finalizing file " + resultFilename + " in the background.");
+      if (captureDevice->CloseFileInBackground(this->OutputFilename.c_str(), completedCallback) != PLUS_SUCCESS)
+      {
+        this->QueueCommandResponse(PLUS_FAIL, "Command failed. See error message.", responseMessageBase + "Failed to finalize file: " + resultFilename);
+        return PLUS_FAIL;
+      }
+      return PLUS_SUCCESS;
+    }
     std::string actualOutputFilename;
     if (captureDevice->CloseFile(this->OutputFilename.c_str(), &actualOutputFilename) != PLUS_SUCCESS)
     {
@@ -371,7 +409,42 @@ PlusStatus vtkPlusStartStopRecordingCommand::Execute()
     this->QueueCommandResponse(PLUS_SUCCESS, responseMessageBase + ss.str());
     return PLUS_SUCCESS;
   }
+  else if (igsioCommon::IsEqualInsensitive(this->Name, GET_STATUS_CMD))
+  {
+    PlusStatus lastFinalizationStatus = PLUS_SUCCESS;
+    std::string lastFinalizedFilename;
+    long lastFinalizedNumberOfFrames = 0;
+    captureDevice->GetLastFileFinalizationResult(lastFinalizationStatus, lastFinalizedFilename, lastFinalizedNumberOfFrames);
+    bool finalizing = captureDevice->IsFileFinalizationInProgress();
+
+    igtl::MessageBase::MetaDataMap metaData;
+    metaData["Recording"] = std::pair<IANA_ENCODING_TYPE, std::string>(IANA_TYPE_US_ASCII, captureDevice->GetEnableCapturing() ? "TRUE" : "FALSE");
+    metaData["NumberOfFramesRecorded"] = std::pair<IANA_ENCODING_TYPE, std::string>(IANA_TYPE_US_ASCII, igsioCommon::ToString<long>(finalizing ? 0 : captureDevice->GetTotalFramesRecorded()));
+    metaData["Finalizing"] = std::pair<IANA_ENCODING_TYPE, std::string>(IANA_TYPE_US_ASCII, finalizing ? "TRUE" : "FALSE");
+    metaData["LastFinalizedFilename"] = std::pair<IANA_ENCODING_TYPE, std::string>(IANA_TYPE_US_ASCII, lastFinalizedFilename);
+    metaData["LastFinalizedNumberOfFrames"] = std::pair<IANA_ENCODING_TYPE, std::string>(IANA_TYPE_US_ASCII, igsioCommon::ToString<long>(lastFinalizedNumberOfFrames));
+    metaData["LastFinalizationStatus"] = std::pair<IANA_ENCODING_TYPE, std::string>(IANA_TYPE_US_ASCII, lastFinalizationStatus == PLUS_SUCCESS ? "SUCCESS" : "FAIL");
+    this->QueueCommandResponse(PLUS_SUCCESS, responseMessageBase + (finalizing ? "file is being finalized." : "successful."), "", &metaData);
+    return PLUS_SUCCESS;
+  }
 
   this->QueueCommandResponse(PLUS_FAIL, "Command failed. See error message.", responseMessageBase + "Unknown command: " + this->Name);
   return PLUS_FAIL;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusStartStopRecordingCommand::SendFileFinalizedResponse(PlusStatus status, const std::string& resultFilename, long numberOfFramesRecorded, const std::string& responseMessageBase)
+{
+  PlusCommandResponseList responses;
+  if (status != PLUS_SUCCESS)
+  {
+    responses.push_back(this->CreateCommandResponse(PLUS_FAIL, "Command failed. See error message.", responseMessageBase + "Failed to finalize file: " + resultFilename));
+  }
+  else
+  {
+    std::ostringstream ss;
+    ss << "Recording " << numberOfFramesRecorded << " frames successful to file " << resultFilename;
+    responses.push_back(this->CreateCommandResponse(PLUS_SUCCESS, responseMessageBase + ss.str()));
+  }
+  this->CommandProcessor->QueueResponses(responses);
 }
\ No newline at end of file
@@ -17,6 +17,10 @@ class vtkPlusDataCollector;
 /*!
   \class vtkPlusStartStopRecordingCommand
   \brief This command starts and stops capturing with a vtkPlusVirtualCapture capture on the server side.
+
+  If Background is set then StopRecording replies immediately and the file is finalized in the background,
+  a second reply is sent when the file is finalized. The state of the recording and of the finalization
+  can be queried by the GetRecordingStatus command.
   \ingroup PlusLibPlusServer
  */
 class vtkPlusServerExport vtkPlusStartStopRecordingCommand : public vtkPlusCommand
@@ -43,6 +47,9 @@ public:
   /*! Gets the description for the specified command name. */
   virtual std::string GetDescription(const std::string& commandName);
 
+  /*! Commands of the same capture device are executed in order */
+  virtual std::string GetTargetDeviceId() const { return this->CaptureDeviceId; }
+
   vtkGetStdStringMacro(OutputFilename);
   vtkSetStdStringMacro(OutputFilename);
 
@@ -58,10 +65,14 @@ public:
   vtkGetStdStringMacro(CodecFourCC);
   vtkSetStdStringMacro(CodecFourCC);
 
+  vtkGetMacro(Background, bool);
+  vtkSetMacro(Background, bool);
+
   void SetNameToStart();
   void SetNameToSuspend();
   void SetNameToResume();
   void SetNameToStop();
+  void SetNameToGetStatus();
 
   /*!
     Helper function to get pointer to the capture device
@@ -79,8 +90,12 @@ protected:
   vtkPlusStartStopRecordingCommand();
   virtual ~vtkPlusStartStopRecordingCommand();
 
+  /*! Send the result of the background finalization of the file. Called from the finalizer thread of the capture device. */
+  void SendFileFinalizedResponse(PlusStatus status, const std::string& resultFilename, long numberOfFramesRecorded, const std::string& responseMessageBase);
+
 private:
   bool        EnableCompression;
+  bool        Background;
   std::string CodecFourCC;
   std::string OutputFilename;
   std::string CaptureDeviceId;
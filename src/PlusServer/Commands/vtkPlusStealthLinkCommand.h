@@ -43,6 +43,9 @@ public:
   /*! Gets the description for the specified command name. */
   virtual std::string GetDescription(const std::string& commandName);
 
+  /*! Commands of the same StealthLink device are executed in order */
+  virtual std::string GetTargetDeviceId() const { return this->StealthLinkDeviceId; }
+
   /*! Id of the stealthlink device */
   vtkGetStdStringMacro(StealthLinkDeviceId);
   vtkSetStdStringMacro(StealthLinkDeviceId);
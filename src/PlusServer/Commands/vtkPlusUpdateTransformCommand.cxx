@@ -16,6 +16,7 @@ vtkStandardNewMacro(vtkPlusUpdateTransformCommand);
 namespace
 {
   static const std::string UPDATE_TRANSFORM_CMD = "UpdateTransform";
+  static const char* TRANSFORM_ELEMENT_NAME = "Transform";
 }
 
 //----------------------------------------------------------------------------
@@ -52,7 +53,7 @@ std::string vtkPlusUpdateTransformCommand::GetDescription(const std::string& com
   if (commandName.empty() || igsioCommon::IsEqualInsensitive(commandName, UPDATE_TRANSFORM_CMD))
   {
     desc += UPDATE_TRANSFORM_CMD;
-    desc += ": Update the details of a transform in the remote transform repository.";
+    desc += ": Update the details of a transform in the remote transform repository. Multiple transforms can be updated by nested Transform elements.";
   }
   return desc;
 }
@@ -70,8 +71,47 @@ PlusStatus vtkPlusUpdateTransformCommand::ReadConfiguration(vtkXMLDataElement* a
   {
     return PLUS_FAIL;
   }
+  this->BatchTransformUpdates.clear();
+  this->CoalescedTransformUpdates.clear();
+  for (int elemIndex = 0; elemIndex < aConfig->GetNumberOfNestedElements(); ++elemIndex)
+  {
+    vtkXMLDataElement* transformElem = aConfig->GetNestedElement(elemIndex);
+    if (!igsioCommon::IsEqualInsensitive(transformElem->GetName(), TRANSFORM_ELEMENT_NAME))
+    {
+      continue;
+    }
+    TransformUpdate update;
+    double matrixElements[16] = { 0 };
+    const char* transformName = transformElem->GetAttribute("TransformName");
+    if (transformName == NULL || transformElem->GetVectorAttribute("TransformValue", 16, matrixElements) != 16)
+    {
+      LOG_ERROR("Unable to find required TransformName or TransformValue attribute in " << TRANSFORM_ELEMENT_NAME << " element in UpdateTransform command");
+      return PLUS_FAIL;
+    }
+    update.Name = transformName;
+    update.Value = vtkSmartPointer<vtkMatrix4x4>::New();
+    update.Value->DeepCopy(matrixElements);
+    if (transformElem->GetAttribute("TransformPersistent") != NULL)
+    {
+      update.Persistent = igsioCommon::IsEqualInsensitive(transformElem->GetAttribute("TransformPersistent"), "TRUE");
+    }
+    transformElem->GetScalarAttribute("TransformError", update.Error);
+    if (transformElem->GetAttribute("TransformDate") != NULL)
+    {
+      update.Date = transformElem->GetAttribute("TransformDate");
+    }
+    MergeTransformUpdate(this->BatchTransformUpdates, update);
+  }
+
   XML_READ_STRING_ATTRIBUTE_OPTIONAL(TransformName, aConfig);
-  XML_READ_VECTOR_ATTRIBUTE_REQUIRED(double, 16, TransformValue, aConfig);
+  if (this->BatchTransformUpdates.empty())
+  {
+    XML_READ_VECTOR_ATTRIBUTE_REQUIRED(double, 16, TransformValue, aConfig);
+  }
+  else
+  {
+    XML_READ_VECTOR_ATTRIBUTE_OPTIONAL(double, 16, TransformValue, aConfig);
+  }
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(TransformPersistent, aConfig);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, TransformError, aConfig);
   XML_READ_CSTRING_ATTRIBUTE_OPTIONAL(TransformDate, aConfig);
@@ -104,15 +144,42 @@ PlusStatus vtkPlusUpdateTransformCommand::WriteConfiguration(vtkXMLDataElement*
 
   XML_WRITE_BOOL_ATTRIBUTE(TransformPersistent, aConfig);
 
+  for (std::vector<TransformUpdate>::const_iterator updateIt = this->BatchTransformUpdates.begin(); updateIt != this->BatchTransformUpdates.end(); ++updateIt)
+  {
+    vtkSmartPointer<vtkXMLDataElement> transformElem = vtkSmartPointer<vtkXMLDataElement>::New();
+    transformElem->SetName(TRANSFORM_ELEMENT_NAME);
+    transformElem->SetAttribute("TransformName", updateIt->Name.c_str());
+    double vectorMatrix[16] = {0};
+    vtkMatrix4x4::DeepCopy(vectorMatrix, updateIt->Value);
+    transformElem->SetVectorAttribute("TransformValue", 16, vectorMatrix);
+    if (!updateIt->Date.empty())
+    {
+      transformElem->SetAttribute("TransformDate", updateIt->Date.c_str());
+    }
+    if (updateIt->Error >= 0)
+    {
+      transformElem->SetDoubleAttribute("TransformError", updateIt->Error);
+    }
+    transformElem->SetAttribute("TransformPersistent", updateIt->Persistent ? "TRUE" : "FALSE");
+    aConfig->AddNestedElement(transformElem);
+  }
+
   return PLUS_SUCCESS;
 }
 
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusUpdateTransformCommand::Execute()
 {
-  LOG_INFO("vtkPlusUpdateTransformCommand::Execute:");
+  LOG_DEBUG("vtkPlusUpdateTransformCommand::Execute:");
 
-  std::string baseMessageString = std::string("UpdateTransform (") + (!this->GetTransformName().empty() ? this->GetTransformName() : "undefined") + ")";
+  std::vector<TransformUpdate> updates;
+  this->GetRequestedTransformUpdates(updates);
+  std::string transformNames;
+  for (std::vector<TransformUpdate>::const_iterator updateIt = updates.begin(); updateIt != updates.end(); ++updateIt)
+  {
+    transformNames += (transformNames.empty() ? "" : ", ") + (!updateIt->Name.empty() ? updateIt->Name : std::string("undefined"));
+  }
+  std::string baseMessageString = std::string("UpdateTransform (") + transformNames + ")";
   std::string warningString;
 
   if (this->GetTransformRepository() == NULL)
@@ -121,41 +188,124 @@ PlusStatus vtkPlusUpdateTransformCommand::Execute()
     return PLUS_FAIL;
   }
 
-  igsioTransformName aName;
-  aName.SetTransformName(this->GetTransformName());
+  // The later values of the merged commands replace the requested ones
+  for (std::vector<TransformUpdate>::const_iterator updateIt = this->CoalescedTransformUpdates.begin(); updateIt != this->CoalescedTransformUpdates.end(); ++updateIt)
+  {
+    MergeTransformUpdate(updates, *updateIt);
+  }
 
-  if (this->GetTransformRepository()->IsExistingTransform(aName) == PLUS_SUCCESS)
+  for (std::vector<TransformUpdate>::const_iterator updateIt = updates.begin(); updateIt != updates.end(); ++updateIt)
   {
-    bool persistent = false;
-    this->GetTransformRepository()->GetTransformPersistent(aName, persistent);
-    if (!persistent && this->GetTransformPersistent())
+    igsioTransformName aName;
+    aName.SetTransformName(updateIt->Name);
+
+    if (this->GetTransformRepository()->IsExistingTransform(aName) == PLUS_SUCCESS)
+    {
+      bool persistent = false;
+      this->GetTransformRepository()->GetTransformPersistent(aName, persistent);
+      if (!persistent && updateIt->Persistent)
+      {
+        warningString += " WARNING: replacing non-persistent transform " + updateIt->Name + " with a persistent transform.";
+      }
+    }
+
+    if (updateIt->Value)
     {
-      warningString += " WARNING: replacing non-persistent transform with a persistent transform.";
+      this->GetTransformRepository()->SetTransform(aName, updateIt->Value);
+    }
+    else
+    {
+      warningString += " WARNING: transform is not specified.";
+    }
+
+    this->GetTransformRepository()->SetTransformPersistent(aName, updateIt->Persistent);
+
+    if (!updateIt->Date.empty())
+    {
+      this->GetTransformRepository()->SetTransformDate(aName, updateIt->Date);
+    }
+    if (updateIt->Error >= 0)
+    {
+      this->GetTransformRepository()->SetTransformError(aName, updateIt->Error);
     }
   }
 
-  if (this->TransformValue)
+  this->QueueCommandResponse(PLUS_SUCCESS, baseMessageString + " completed successfully" + warningString);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusUpdateTransformCommand::AddTransformUpdate(const std::string& transformName, vtkMatrix4x4* transformValue, bool persistent/*=true*/,
+    double error/*=-1.0*/, const std::string& date/*=""*/)
+{
+  TransformUpdate update;
+  update.Name = transformName;
+  update.Value = vtkSmartPointer<vtkMatrix4x4>::New();
+  if (transformValue != NULL)
   {
-    this->GetTransformRepository()->SetTransform(aName, this->TransformValue);
+    update.Value->DeepCopy(transformValue);
   }
-  else
+  update.Persistent = persistent;
+  update.Error = error;
+  update.Date = date;
+  MergeTransformUpdate(this->BatchTransformUpdates, update);
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusUpdateTransformCommand::GetCoalescingKey() const
+{
+  return UPDATE_TRANSFORM_CMD;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusUpdateTransformCommand::Coalesce(vtkPlusCommand* laterCommand)
+{
+  vtkPlusUpdateTransformCommand* laterUpdateCommand = vtkPlusUpdateTransformCommand::SafeDownCast(laterCommand);
+  if (laterUpdateCommand == NULL)
   {
-    warningString += " WARNING: transform is not specified.";
+    return false;
   }
+  std::vector<TransformUpdate> laterUpdates;
+  laterUpdateCommand->GetRequestedTransformUpdates(laterUpdates);
+  for (std::vector<TransformUpdate>::const_iterator updateIt = laterUpdates.begin(); updateIt != laterUpdates.end(); ++updateIt)
+  {
+    MergeTransformUpdate(this->CoalescedTransformUpdates, *updateIt);
+  }
+  return true;
+}
 
-  this->GetTransformRepository()->SetTransformPersistent(aName, this->GetTransformPersistent());
-
-  if (!this->GetTransformDate().empty())
+//----------------------------------------------------------------------------
+void vtkPlusUpdateTransformCommand::GetRequestedTransformUpdates(std::vector<TransformUpdate>& updates) const
+{
+  updates.clear();
+  if (!this->TransformName.empty() || this->BatchTransformUpdates.empty())
   {
-    this->GetTransformRepository()->SetTransformDate(aName, this->GetTransformDate());
+    TransformUpdate update;
+    update.Name = this->TransformName;
+    update.Value = this->TransformValue;
+    update.Persistent = this->TransformPersistent;
+    update.Error = this->TransformError;
+    update.Date = this->TransformDate;
+    updates.push_back(update);
   }
-  if (this->GetTransformError() >= 0)
+  for (std::vector<TransformUpdate>::const_iterator updateIt = this->BatchTransformUpdates.begin(); updateIt != this->BatchTransformUpdates.end(); ++updateIt)
   {
-    this->GetTransformRepository()->SetTransformError(aName, this->GetTransformError());
+    MergeTransformUpdate(updates, *updateIt);
   }
+}
 
-  this->QueueCommandResponse(PLUS_SUCCESS, baseMessageString + " completed successfully" + warningString);
-  return PLUS_SUCCESS;
+//----------------------------------------------------------------------------
+void vtkPlusUpdateTransformCommand::MergeTransformUpdate(std::vector<TransformUpdate>& updates, const TransformUpdate& update)
+{
+  for (std::vector<TransformUpdate>::iterator updateIt = updates.begin(); updateIt != updates.end(); ++updateIt)
+  {
+    if (updateIt->Name == update.Name)
+    {
+      *updateIt = update;
+      return;
+    }
+  }
+  updates.push_back(update);
 }
 
 //-----------------------------------------------------------------------------
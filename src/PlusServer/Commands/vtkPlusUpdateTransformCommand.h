@@ -10,11 +10,25 @@
 #include "vtkPlusServerExport.h"
 #include "vtkPlusCommand.h"
 
+#include <vector>
+
 class vtkMatrix4x4;
 
 /*!
   \class vtkPlusUpdateTransformCommand
   \brief This command updates the value of a transformation in the transform repository
+
+  Multiple transforms can be updated by one command (batch form), by nested Transform elements
+  with the same attributes as the command (TransformName, TransformValue, TransformPersistent, TransformError, TransformDate):
+  \code
+  <Command Name="UpdateTransform">
+    <Transform TransformName="StylusTipToStylus" TransformValue="1 0 0 10 0 1 0 0 0 0 1 0 0 0 0 1" />
+    <Transform TransformName="ImageToProbe" TransformValue="..." TransformPersistent="FALSE" />
+  </Command>
+  \endcode
+
+  UpdateTransform commands that are waiting in the queue consecutively are coalesced: they are executed once,
+  setting only the latest value of each transform.
   \ingroup PlusLibPlusServer
  */
 class vtkPlusServerExport vtkPlusUpdateTransformCommand : public vtkPlusCommand
@@ -59,11 +73,43 @@ public:
 
   void SetNameToUpdateTransform();
 
+  /*! Add a transform to be updated by the same command (batch form), it is updated after the transform specified by TransformName */
+  void AddTransformUpdate(const std::string& transformName, vtkMatrix4x4* transformValue, bool persistent = true, double error = -1.0,
+                          const std::string& date = "");
+
+  /*! Only the latest values of the transforms of consecutive UpdateTransform commands are set */
+  virtual std::string GetCoalescingKey() const;
+  virtual bool Coalesce(vtkPlusCommand* laterCommand);
+
+  /*! Updated transforms may be persistent, which are part of the configuration snapshot */
+  virtual bool ChangesConfiguration() const { return true; }
+
 protected:
+  struct TransformUpdate
+  {
+    TransformUpdate() : Persistent(true), Error(-1.0) {}
+    std::string Name;
+    vtkSmartPointer<vtkMatrix4x4> Value;
+    bool Persistent;
+    double Error;
+    std::string Date;
+  };
+
+  /*! Get the transforms requested by this command: the one specified by TransformName (if any) and the batch items */
+  void GetRequestedTransformUpdates(std::vector<TransformUpdate>& updates) const;
+
+  /*! Replace the update of the same transform or append it */
+  static void MergeTransformUpdate(std::vector<TransformUpdate>& updates, const TransformUpdate& update);
 
   vtkPlusUpdateTransformCommand();
   virtual ~vtkPlusUpdateTransformCommand();
 
+  /*! Transforms of the batch form, from nested Transform elements */
+  std::vector<TransformUpdate> BatchTransformUpdates;
+
+  /*! Updates of the later commands that have been merged into this command */
+  std::vector<TransformUpdate> CoalescedTransformUpdates;
+
 private:
   std::string TransformName;
   vtkMatrix4x4* TransformValue;
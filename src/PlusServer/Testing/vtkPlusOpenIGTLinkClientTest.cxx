@@ -0,0 +1,182 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusOpenIGTLinkClientTest.cxx
+  \brief Tests that progress reports of an asynchronous command do not complete the command.
+
+  The replies are passed to the client as if they were received from the server: a command is registered,
+  then progress reports (replies with a Progress parameter, as sent by vtkPlusCommand::ReportProgress) and the
+  final reply are delivered. The progress reports must reach the progress callback only, the future and the
+  reply callback must be completed by the final reply.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusOpenIGTLinkClient.h"
+
+// IGTL includes
+#include <igtlCommandMessage.h>
+
+// VTK includes
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <chrono>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  /*! Client that allows delivering replies without a server connection */
+  class vtkPlusOpenIGTLinkClientTester : public vtkPlusOpenIGTLinkClient
+  {
+  public:
+    static vtkPlusOpenIGTLinkClientTester* New()
+    {
+      return new vtkPlusOpenIGTLinkClientTester;
+    }
+
+    PlusStatus RegisterCommand(const std::string& commandName, uint32_t commandId, ReplyCallback callback, ProgressCallback progressCallback, std::shared_future<CommandReply>& reply)
+    {
+      igtl::MessageBase::Pointer message;
+      igtlUint32 commandUid = 0;
+      return this->PrepareAsyncCommand(commandName, "<Command Name=\"" + commandName + "\" />", commandId, callback, progressCallback, message, commandUid, reply);
+    }
+
+    void DeliverReply(igtl::MessageBase::Pointer message)
+    {
+      this->OnReplyReceived(message);
+    }
+  };
+
+  //----------------------------------------------------------------------------
+  igtl::MessageBase::Pointer CreateReplyMessage(const std::string& commandName, uint32_t commandId, const std::string& message, double progressPercent)
+  {
+    igtl::RTSCommandMessage::Pointer replyMessage = igtl::RTSCommandMessage::New();
+    replyMessage->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+    replyMessage->SetDeviceName("");
+    replyMessage->SetCommandName(commandName);
+    replyMessage->SetCommandId(commandId);
+    replyMessage->SetCommandContent("<Command><Result>true</Result><Message>" + message + "</Message></Command>");
+    if (progressPercent >= 0)
+    {
+      replyMessage->SetMetaDataElement("Progress", IANA_TYPE_US_ASCII, igsioCommon::ToString<double>(progressPercent));
+    }
+    return replyMessage.GetPointer();
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors = 0;
+  const std::string commandName = "ReconstructVolume";
+  const uint32_t commandId = 12;
+  const double progressPercents[] = { 25.0, 50.0, 75.0 };
+  const int numberOfProgressReports = sizeof(progressPercents) / sizeof(progressPercents[0]);
+
+  vtkSmartPointer<vtkPlusOpenIGTLinkClientTester> client = vtkSmartPointer<vtkPlusOpenIGTLinkClientTester>::New();
+  std::vector<double> receivedProgressPercents;
+  std::vector<std::string> receivedProgressMessages;
+  int numberOfReplyCallbacks = 0;
+  vtkPlusOpenIGTLinkClient::ReplyCallback replyCallback = [&numberOfReplyCallbacks](const vtkPlusOpenIGTLinkClient::CommandReply&)
+  {
+    ++numberOfReplyCallbacks;
+  };
+  vtkPlusOpenIGTLinkClient::ProgressCallback progressCallback = [&receivedProgressPercents, &receivedProgressMessages](double progressPercent, const vtkPlusOpenIGTLinkClient::CommandReply & progressReply)
+  {
+    receivedProgressPercents.push_back(progressPercent);
+    receivedProgressMessages.push_back(progressReply.Content);
+  };
+  std::shared_future<vtkPlusOpenIGTLinkClient::CommandReply> reply;
+  if (client->RegisterCommand(commandName, commandId, replyCallback, progressCallback, reply) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to register the command");
+    return EXIT_FAILURE;
+  }
+
+  // Progress reports keep the command pending
+  for (int i = 0; i < numberOfProgressReports; ++i)
+  {
+    client->DeliverReply(CreateReplyMessage(commandName, commandId, "In progress " + igsioCommon::ToString<int>(i), progressPercents[i]));
+    if (reply.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+      LOG_ERROR("The command is completed by progress report " << i);
+      ++numberOfErrors;
+      break;
+    }
+  }
+  if (client->GetNumberOfPendingCommands() != 1)
+  {
+    LOG_ERROR("The command is not pending after the progress reports");
+    ++numberOfErrors;
+  }
+  if (numberOfReplyCallbacks != 0)
+  {
+    LOG_ERROR("The reply callback is called with a progress report");
+    ++numberOfErrors;
+  }
+  if (receivedProgressPercents.size() != static_cast<size_t>(numberOfProgressReports))
+  {
+    LOG_ERROR("Received " << receivedProgressPercents.size() << " progress reports, expected " << numberOfProgressReports);
+    ++numberOfErrors;
+  }
+  else
+  {
+    for (int i = 0; i < numberOfProgressReports; ++i)
+    {
+      if (receivedProgressPercents[i] != progressPercents[i] || receivedProgressMessages[i] != "In progress " + igsioCommon::ToString<int>(i))
+      {
+        LOG_ERROR("Progress report " << i << " mismatch: " << receivedProgressPercents[i] << "% " << receivedProgressMessages[i]);
+        ++numberOfErrors;
+      }
+    }
+  }
+
+  // The final reply completes the command
+  client->DeliverReply(CreateReplyMessage(commandName, commandId, "Completed", -1));
+  if (reply.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+  {
+    LOG_ERROR("The command is not completed by the final reply");
+    return EXIT_FAILURE;
+  }
+  if (reply.get().Status != PLUS_SUCCESS || reply.get().Content != "Completed" || reply.get().Parameters.find("Progress") != reply.get().Parameters.end())
+  {
+    LOG_ERROR("The command is completed with an unexpected reply: " << reply.get().Content);
+    ++numberOfErrors;
+  }
+  if (numberOfReplyCallbacks != 1)
+  {
+    LOG_ERROR("The reply callback is called " << numberOfReplyCallbacks << " times, expected once");
+    ++numberOfErrors;
+  }
+  if (client->GetNumberOfPendingCommands() != 0)
+  {
+    LOG_ERROR("The command is still pending after the final reply");
+    ++numberOfErrors;
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("vtkPlusOpenIGTLinkClientTest failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+  LOG_INFO("vtkPlusOpenIGTLinkClientTest completed successfully");
+  return EXIT_SUCCESS;
+}
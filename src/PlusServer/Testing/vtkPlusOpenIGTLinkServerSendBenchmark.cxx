@@ -0,0 +1,259 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusOpenIGTLinkServerSendBenchmark.cxx
+  \brief Compares sending the TRANSFORM messages of tracked frames one by one and gathered into one write.
+
+  Frames of transform messages are sent at a fixed rate to a client connected through the loopback interface,
+  first with one igtl::Socket::Send call per message, then with vtkPlusOpenIGTLinkServer::SendBuffersWithoutBlocking
+  (one sendmsg/WSASend call per frame). The number of send calls per frame and the message rate achieved
+  at the receiver are reported for both methods.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "igsioCommon.h"
+#include "vtkPlusOpenIGTLinkServer.h"
+
+// IGTL includes
+#include <igtlClientSocket.h>
+#include <igtlMessageHeader.h>
+#include <igtlServerSocket.h>
+#include <igtlTransformMessage.h>
+
+// VTK includes
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <atomic>
+#include <thread>
+
+namespace
+{
+  const double RECEIVE_TIMEOUT_SEC = 5.0;
+
+  struct BenchmarkResult
+  {
+    BenchmarkResult() : NumberOfSendCalls(0), NumberOfReceivedMessages(0), ReceiveDurationSec(0) {}
+    long NumberOfSendCalls;
+    long NumberOfReceivedMessages;
+    double ReceiveDurationSec;
+  };
+
+  //----------------------------------------------------------------------------
+  void ReceiveMessages(igtl::ClientSocket::Pointer socket, long expectedNumberOfMessages, std::atomic<long>* numberOfReceivedMessages, double* lastReceiveTime)
+  {
+    igtl::MessageHeader::Pointer header = igtl::MessageHeader::New();
+    double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    while (numberOfReceivedMessages->load() < expectedNumberOfMessages && vtkIGSIOAccurateTimer::GetSystemTime() - startTime < RECEIVE_TIMEOUT_SEC)
+    {
+      header->InitBuffer();
+      int bytesReceived = socket->Receive(header->GetPackPointer(), header->GetPackSize());
+      if (bytesReceived != header->GetPackSize())
+      {
+        continue;
+      }
+      header->Unpack();
+      socket->Skip(header->GetBodySizeToRead(), 0);
+      ++(*numberOfReceivedMessages);
+      *lastReceiveTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void PackFrame(std::vector<igtl::MessageBase::Pointer>& messages, int numberOfTransforms, int frameIndex)
+  {
+    messages.clear();
+    for (int i = 0; i < numberOfTransforms; ++i)
+    {
+      igtl::TransformMessage::Pointer transformMessage = igtl::TransformMessage::New();
+      transformMessage->SetDeviceName((std::string("Tool") + igsioCommon::ToString<int>(i) + "ToReference").c_str());
+      igtl::Matrix4x4 matrix;
+      igtl::IdentityMatrix(matrix);
+      matrix[0][3] = static_cast<float>(frameIndex);
+      transformMessage->SetMatrix(matrix);
+      transformMessage->Pack();
+      messages.push_back(transformMessage.GetPointer());
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus RunBenchmark(igtl::ClientSocket::Pointer senderSocket, igtl::ClientSocket::Pointer receiverSocket, bool gathered,
+                          int numberOfTransforms, double frameRateHz, int numberOfFrames, BenchmarkResult& result)
+  {
+    result = BenchmarkResult();
+    std::atomic<long> numberOfReceivedMessages(0);
+    double lastReceiveTime = 0;
+    double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    std::thread receiverThread(ReceiveMessages, receiverSocket, static_cast<long>(numberOfTransforms) * numberOfFrames, &numberOfReceivedMessages, &lastReceiveTime);
+
+    PlusStatus status = PLUS_SUCCESS;
+    std::vector<igtl::MessageBase::Pointer> messages;
+    for (int frameIndex = 0; frameIndex < numberOfFrames && status == PLUS_SUCCESS; ++frameIndex)
+    {
+      // Wait until the frame is due
+      double frameTime = startTime + frameIndex / frameRateHz;
+      double delaySec = frameTime - vtkIGSIOAccurateTimer::GetSystemTime();
+      if (delaySec > 0)
+      {
+        vtkIGSIOAccurateTimer::Delay(delaySec);
+      }
+
+      PackFrame(messages, numberOfTransforms, frameIndex);
+      if (!gathered)
+      {
+        for (std::vector<igtl::MessageBase::Pointer>::iterator messageIt = messages.begin(); messageIt != messages.end(); ++messageIt)
+        {
+          result.NumberOfSendCalls++;
+          if (senderSocket->Send((*messageIt)->GetPackPointer(), (*messageIt)->GetPackSize()) == 0)
+          {
+            LOG_ERROR("Failed to send message");
+            status = PLUS_FAIL;
+            break;
+          }
+        }
+        continue;
+      }
+
+      std::vector<vtkPlusOpenIGTLinkServer::SendBuffer> buffers;
+      for (std::vector<igtl::MessageBase::Pointer>::iterator messageIt = messages.begin(); messageIt != messages.end(); ++messageIt)
+      {
+        buffers.push_back(vtkPlusOpenIGTLinkServer::SendBuffer(static_cast<const char*>((*messageIt)->GetPackPointer()), (*messageIt)->GetPackSize()));
+      }
+      while (!buffers.empty())
+      {
+        result.NumberOfSendCalls++;
+        int bytesSent = vtkPlusOpenIGTLinkServer::SendBuffersWithoutBlocking(senderSocket, buffers);
+        if (bytesSent < 0)
+        {
+          LOG_ERROR("Failed to send messages");
+          status = PLUS_FAIL;
+          break;
+        }
+        if (bytesSent == 0)
+        {
+          // The socket buffer is full, wait for the receiver
+          vtkIGSIOAccurateTimer::Delay(0.001);
+          continue;
+        }
+        // Remove the sent data from the buffers
+        while (!buffers.empty() && bytesSent >= buffers.front().second)
+        {
+          bytesSent -= buffers.front().second;
+          buffers.erase(buffers.begin());
+        }
+        if (!buffers.empty())
+        {
+          buffers.front().first += bytesSent;
+          buffers.front().second -= bytesSent;
+        }
+      }
+    }
+
+    receiverThread.join();
+    result.NumberOfReceivedMessages = numberOfReceivedMessages.load();
+    result.ReceiveDurationSec = lastReceiveTime - startTime;
+    return status;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int port(18954);
+  int numberOfTransforms(30);
+  double frameRateHz(250);
+  double durationSec(2);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--port", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &port, "Port used for the loopback connection (Default: 18954).");
+  args.AddArgument("--number-of-transforms", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfTransforms, "Number of TRANSFORM messages per frame (Default: 30).");
+  args.AddArgument("--frame-rate", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &frameRateHz, "Number of frames sent per second (Default: 250).");
+  args.AddArgument("--duration-sec", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &durationSec, "Duration of sending with each method (Default: 2).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  igtl::ServerSocket::Pointer serverSocket = igtl::ServerSocket::New();
+  if (serverSocket->CreateServer(port) < 0)
+  {
+    LOG_ERROR("Cannot create server socket on port " << port);
+    return EXIT_FAILURE;
+  }
+  igtl::ClientSocket::Pointer receiverSocket = igtl::ClientSocket::New();
+  if (receiverSocket->ConnectToServer("127.0.0.1", port) != 0)
+  {
+    LOG_ERROR("Cannot connect to port " << port);
+    return EXIT_FAILURE;
+  }
+  igtl::ClientSocket::Pointer senderSocket = serverSocket->WaitForConnection(1000);
+  if (senderSocket.IsNull())
+  {
+    LOG_ERROR("Connection is not accepted");
+    return EXIT_FAILURE;
+  }
+  receiverSocket->SetReceiveTimeout(RECEIVE_TIMEOUT_SEC * 1000);
+
+  int numberOfErrors = 0;
+  int numberOfFrames = static_cast<int>(durationSec * frameRateHz);
+  long expectedNumberOfMessages = static_cast<long>(numberOfTransforms) * numberOfFrames;
+  BenchmarkResult results[2];
+  for (int gathered = 0; gathered < 2; ++gathered)
+  {
+    BenchmarkResult& result = results[gathered];
+    if (RunBenchmark(senderSocket, receiverSocket, gathered != 0, numberOfTransforms, frameRateHz, numberOfFrames, result) != PLUS_SUCCESS)
+    {
+      numberOfErrors++;
+    }
+    if (result.NumberOfReceivedMessages != expectedNumberOfMessages)
+    {
+      LOG_ERROR("Received " << result.NumberOfReceivedMessages << " messages, expected " << expectedNumberOfMessages);
+      numberOfErrors++;
+    }
+    LOG_INFO((gathered ? "Gathered send" : "Send per message") << ": "
+             << static_cast<double>(result.NumberOfSendCalls) / numberOfFrames << " send calls per frame, "
+             << (result.ReceiveDurationSec > 0 ? result.NumberOfReceivedMessages / result.ReceiveDurationSec : 0) << " messages per second received"
+             << " (" << numberOfTransforms << " transforms at " << frameRateHz << " Hz)");
+  }
+
+  if (results[1].NumberOfSendCalls > results[0].NumberOfSendCalls)
+  {
+    LOG_ERROR("Gathered send used more send calls (" << results[1].NumberOfSendCalls << ") than sending per message (" << results[0].NumberOfSendCalls << ")");
+    numberOfErrors++;
+  }
+
+  senderSocket->CloseSocket();
+  receiverSocket->CloseSocket();
+  serverSocket->CloseSocket();
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("vtkPlusOpenIGTLinkServerSendBenchmark failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("vtkPlusOpenIGTLinkServerSendBenchmark completed successfully");
+  return EXIT_SUCCESS;
+}
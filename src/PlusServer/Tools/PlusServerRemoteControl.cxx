@@ -14,6 +14,7 @@ See License.txt for details.
 #include "igtlTrackingDataMessage.h"
 #include "igtl_header.h"
 #include "vtkPlusGetTransformCommand.h"
+#include "vtkPlusGetMetricsCommand.h"
 #include "vtkPlusOpenIGTLinkClient.h"
 #include "vtkPlusReconstructVolumeCommand.h"
 #include "vtkPlusRequestIdsCommand.h"
@@ -35,6 +36,7 @@ See License.txt for details.
 #include "vtksys/Process.h"
 #include "vtkXMLUtilities.h"
 
+#include "igtlPlusClientInfoMessage.h"
 #include "igtlTransformMessage.h"
 
 // For catching Ctrl-C
@@ -42,6 +44,16 @@ See License.txt for details.
 #include <cstdlib>
 #include <cstdio>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
 //----------------------------------------------------------------------------
 // For CTRL-C signal handling
 static bool StopClientRequested = false;
@@ -103,6 +115,100 @@ private:
 
 vtkStandardNewMacro(vtkPlusOpenIGTLinkClientWithTransformLogging);
 
+//----------------------------------------------------------------------------
+// A customized vtkPlusOpenIGTLinkClient that discards the received data messages and collects statistics about them,
+// used for generating load on the server in benchmark mode
+class vtkPlusOpenIGTLinkClientWithStatistics : public vtkPlusOpenIGTLinkClient
+{
+public:
+  static vtkPlusOpenIGTLinkClientWithStatistics* New();
+  vtkTypeMacro(vtkPlusOpenIGTLinkClientWithStatistics, vtkPlusOpenIGTLinkClient);
+
+  struct Statistics
+  {
+    unsigned long NumberOfMessages;
+    double NumberOfBytes;
+    std::map<std::string, unsigned long> NumberOfMessagesByType;
+    /*! Time between the IGTL timestamp of the message (set by the server) and the time when the message is completely received */
+    std::vector<double> MessageLatenciesSec;
+    unsigned long NumberOfCommands;
+    unsigned long NumberOfFailedCommands;
+    std::vector<double> CommandRoundTripTimesSec;
+    Statistics()
+      : NumberOfMessages(0)
+      , NumberOfBytes(0)
+      , NumberOfCommands(0)
+      , NumberOfFailedCommands(0)
+    {
+    }
+  };
+
+  bool OnMessageReceived(igtl::MessageHeader::Pointer messageHeader)
+  {
+    std::string messageType = messageHeader->GetMessageType();
+    if (messageType == "RTS_COMMAND" || messageType == "RTS_TDATA"
+        || (messageType == "STRING" && vtkPlusCommand::IsReplyDeviceName(messageHeader->GetDeviceName(), "")))
+    {
+      // Command replies are processed by the client
+      return false;
+    }
+
+    {
+      igsioLockGuard<vtkIGSIORecursiveCriticalSection> socketGuard(this->SocketMutex);
+      this->ClientSocket->Skip(messageHeader->GetBodySizeToRead(), 0);
+    }
+    igtl::TimeStamp::Pointer messageTimestamp = igtl::TimeStamp::New();
+    messageHeader->GetTimeStamp(messageTimestamp);
+    double latencySec = vtkIGSIOAccurateTimer::GetUniversalTime() - messageTimestamp->GetTimeStamp();
+
+    std::lock_guard<std::mutex> statisticsGuard(this->StatisticsMutex);
+    this->CurrentStatistics.NumberOfMessages++;
+    this->CurrentStatistics.NumberOfBytes += IGTL_HEADER_SIZE + messageHeader->GetBodySizeToRead();
+    this->CurrentStatistics.NumberOfMessagesByType[messageType]++;
+    if (messageTimestamp->GetTimeStamp() > 0)
+    {
+      this->CurrentStatistics.MessageLatenciesSec.push_back(latencySec);
+    }
+    return true;
+  }
+
+  void RecordCommandReply(PlusStatus status, double roundTripTimeSec)
+  {
+    std::lock_guard<std::mutex> statisticsGuard(this->StatisticsMutex);
+    this->CurrentStatistics.NumberOfCommands++;
+    if (status != PLUS_SUCCESS)
+    {
+      this->CurrentStatistics.NumberOfFailedCommands++;
+    }
+    this->CurrentStatistics.CommandRoundTripTimesSec.push_back(roundTripTimeSec);
+  }
+
+  Statistics GetStatistics()
+  {
+    std::lock_guard<std::mutex> statisticsGuard(this->StatisticsMutex);
+    return this->CurrentStatistics;
+  }
+
+  void ResetStatistics()
+  {
+    std::lock_guard<std::mutex> statisticsGuard(this->StatisticsMutex);
+    this->CurrentStatistics = Statistics();
+  }
+
+protected:
+  vtkPlusOpenIGTLinkClientWithStatistics() {};
+  virtual ~vtkPlusOpenIGTLinkClientWithStatistics() {};
+
+  std::mutex StatisticsMutex;
+  Statistics CurrentStatistics;
+
+private:
+  vtkPlusOpenIGTLinkClientWithStatistics(const vtkPlusOpenIGTLinkClientWithStatistics&);
+  void operator=(const vtkPlusOpenIGTLinkClientWithStatistics&);
+};
+
+vtkStandardNewMacro(vtkPlusOpenIGTLinkClientWithStatistics);
+
 // Utility functions for sending commands
 
 //----------------------------------------------------------------------------
@@ -511,6 +617,80 @@ PlusStatus ReceiveAndPrintReply(vtkPlusOpenIGTLinkClient* client,
   return result;
 }
 
+//----------------------------------------------------------------------------
+void PrintReply(const vtkPlusOpenIGTLinkClient::CommandReply& reply)
+{
+  LOG_INFO("Command ID: " << reply.OriginalCommandId);
+  LOG_INFO("Status: " << (reply.Status == PLUS_SUCCESS ? "SUCCESS" : "FAIL"));
+  if (reply.Status == PLUS_FAIL)
+  {
+    LOG_INFO("Error: " << reply.ErrorString);
+  }
+  LOG_INFO("Message: " << reply.Content);
+  for (igtl::MessageBase::MetaDataMap::const_iterator it = reply.Parameters.begin(); it != reply.Parameters.end(); ++it)
+  {
+    LOG_INFO(it->first << ": " << it->second.second);
+  }
+}
+
+//----------------------------------------------------------------------------
+/*!
+  Send all the commands of a file without waiting for the replies, then print the replies in the order of the commands.
+  Each non-empty line that does not start with # contains a command XML element, for example:
+  <Command Name="RequestChannelIds" />
+*/
+PlusStatus ExecuteCommandFile(vtkPlusOpenIGTLinkClient* client, const std::string& commandFileName, int firstCommandId, double timeoutSec = 30)
+{
+  std::ifstream commandFile(commandFileName.c_str());
+  if (!commandFile.is_open())
+  {
+    LOG_ERROR("Failed to open command file: " << commandFileName);
+    return PLUS_FAIL;
+  }
+
+  PlusStatus status = PLUS_SUCCESS;
+  std::vector<std::shared_future<vtkPlusOpenIGTLinkClient::CommandReply> > replies;
+  int commandId = firstCommandId;
+  std::string line;
+  while (std::getline(commandFile, line))
+  {
+    line = igsioCommon::Trim(line);
+    if (line.empty() || line[0] == '#')
+    {
+      continue;
+    }
+    vtkSmartPointer<vtkXMLDataElement> cmdElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(line.c_str()));
+    if (cmdElement == NULL || cmdElement->GetAttribute("Name") == NULL)
+    {
+      LOG_ERROR("Invalid command in " << commandFileName << ": " << line);
+      status = PLUS_FAIL;
+      continue;
+    }
+    LOG_INFO(">>> Command: " << line);
+    replies.push_back(client->SendCommandAsync(cmdElement->GetAttribute("Name"), line, commandId > 0 ? commandId++ : 0));
+  }
+
+  if (vtkPlusOpenIGTLinkClient::WaitForReplies(replies, timeoutSec) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to receive reply to all the commands within " << timeoutSec << " sec");
+    status = PLUS_FAIL;
+  }
+  for (std::vector<std::shared_future<vtkPlusOpenIGTLinkClient::CommandReply> >::iterator replyIt = replies.begin(); replyIt != replies.end(); ++replyIt)
+  {
+    if (replyIt->wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+      continue;
+    }
+    const vtkPlusOpenIGTLinkClient::CommandReply& reply = replyIt->get();
+    PrintReply(reply);
+    if (reply.Status != PLUS_SUCCESS)
+    {
+      status = PLUS_FAIL;
+    }
+  }
+  return status;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus StartPlusServerProcess(const std::string& configFile, vtksysProcess*& processPtr)
 {
@@ -675,6 +855,43 @@ PlusStatus RunTests(vtkPlusOpenIGTLinkClient* client)
   RETURN_IF_FAIL(ReceiveAndPrintReply(client, didTimeout, replyMessage, errorMessage, parameters));
   parameters.clear();
 
+  // Pipelined commands: all are sent before the first reply is received
+  {
+    std::vector<vtkSmartPointer<vtkPlusCommand> > pipelinedCommands;
+    for (int i = 0; i < 4; ++i)
+    {
+      vtkSmartPointer<vtkPlusRequestIdsCommand> channelIdsCmd = vtkSmartPointer<vtkPlusRequestIdsCommand>::New();
+      channelIdsCmd->SetNameToRequestChannelIds();
+      channelIdsCmd->SetId(commandId++);
+      pipelinedCommands.push_back(channelIdsCmd);
+      vtkSmartPointer<vtkPlusGetTransformCommand> getTransformCmd = vtkSmartPointer<vtkPlusGetTransformCommand>::New();
+      getTransformCmd->SetNameToGetTransform();
+      getTransformCmd->SetId(commandId++);
+      getTransformCmd->SetTransformName("Test1ToReference");
+      pipelinedCommands.push_back(getTransformCmd);
+    }
+    std::vector<vtkPlusCommand*> commands;
+    for (std::vector<vtkSmartPointer<vtkPlusCommand> >::iterator cmdIt = pipelinedCommands.begin(); cmdIt != pipelinedCommands.end(); ++cmdIt)
+    {
+      PrintCommand(*cmdIt);
+      commands.push_back(*cmdIt);
+    }
+    std::vector<std::shared_future<vtkPlusOpenIGTLinkClient::CommandReply> > replies;
+    RETURN_IF_FAIL(client->SendCommands(commands, replies));
+    RETURN_IF_FAIL(vtkPlusOpenIGTLinkClient::WaitForReplies(replies, 30));
+    for (size_t i = 0; i < replies.size(); ++i)
+    {
+      const vtkPlusOpenIGTLinkClient::CommandReply& reply = replies[i].get();
+      PrintReply(reply);
+      if (client->GetServerIGTLVersion() >= OpenIGTLink_PROTOCOL_VERSION_3 && reply.OriginalCommandId != static_cast<int32_t>(commands[i]->GetId()))
+      {
+        LOG_ERROR("Reply is matched to the wrong command. Got ID: " << reply.OriginalCommandId << ". Expected: " << commands[i]->GetId());
+        return PLUS_FAIL;
+      }
+      RETURN_IF_FAIL(reply.Status);
+    }
+  }
+
   // Capturing
   ExecuteStartAcquisition(client, captureDeviceId, capturingOutputFileName, false, commandId++);
   RETURN_IF_FAIL(ReceiveAndPrintReply(client, didTimeout, replyMessage, errorMessage, parameters));
@@ -739,6 +956,240 @@ void SignalInterruptHandler(int s)
   StopClientRequested = true;
 }
 
+//----------------------------------------------------------------------------
+// Value below which the specified fraction of the values fall (nearest rank), values must be sorted
+double GetPercentile(const std::vector<double>& sortedValues, double fraction)
+{
+  if (sortedValues.empty())
+  {
+    return 0;
+  }
+  size_t rank = static_cast<size_t>(std::ceil(fraction * sortedValues.size()));
+  return sortedValues[std::min(std::max(rank, static_cast<size_t>(1)), sortedValues.size()) - 1];
+}
+
+//----------------------------------------------------------------------------
+std::string GetPercentilesAsString(std::vector<double> valuesSec)
+{
+  std::sort(valuesSec.begin(), valuesSec.end());
+  std::ostringstream os;
+  os << std::fixed << std::setprecision(2)
+     << "p50=" << GetPercentile(valuesSec, 0.50) * 1000 << "ms"
+     << " p90=" << GetPercentile(valuesSec, 0.90) * 1000 << "ms"
+     << " p99=" << GetPercentile(valuesSec, 0.99) * 1000 << "ms"
+     << " max=" << (valuesSec.empty() ? 0 : valuesSec.back() * 1000) << "ms";
+  return os.str();
+}
+
+//----------------------------------------------------------------------------
+void PrintStatistics(const std::string& title, const vtkPlusOpenIGTLinkClientWithStatistics::Statistics& statistics, double durationSec)
+{
+  std::ostringstream os;
+  os << std::fixed << std::setprecision(1) << title << ": " << statistics.NumberOfMessages << " messages ("
+     << statistics.NumberOfMessages / durationSec << "/s, " << statistics.NumberOfBytes / durationSec / 1e6 << " MB/s";
+  for (std::map<std::string, unsigned long>::const_iterator typeIt = statistics.NumberOfMessagesByType.begin(); typeIt != statistics.NumberOfMessagesByType.end(); ++typeIt)
+  {
+    os << ", " << typeIt->first << ": " << typeIt->second;
+  }
+  os << ")";
+  if (!statistics.MessageLatenciesSec.empty())
+  {
+    os << ", latency: " << GetPercentilesAsString(statistics.MessageLatenciesSec);
+  }
+  if (statistics.NumberOfCommands > 0)
+  {
+    os << ", commands: " << statistics.NumberOfCommands << " (" << statistics.NumberOfFailedCommands << " failed), round trip: "
+       << GetPercentilesAsString(statistics.CommandRoundTripTimesSec);
+  }
+  LOG_INFO(os.str());
+}
+
+//----------------------------------------------------------------------------
+// Sum of the values of a metric (all label combinations) in Prometheus text format
+double GetMetricSum(const std::string& metricsText, const std::string& metricName)
+{
+  double sum = 0;
+  std::istringstream lines(metricsText);
+  std::string line;
+  while (std::getline(lines, line))
+  {
+    if (line.compare(0, metricName.size(), metricName) != 0 || line.size() <= metricName.size()
+        || (line[metricName.size()] != ' ' && line[metricName.size()] != '{'))
+    {
+      continue;
+    }
+    double value = 0;
+    if (igsioCommon::StringToDouble(line.substr(line.find_last_of(' ') + 1).c_str(), value) == PLUS_SUCCESS)
+    {
+      sum += value;
+    }
+  }
+  return sum;
+}
+
+//----------------------------------------------------------------------------
+/*!
+  Connect numberOfClients clients to the server, subscribe them to the messages described in the client info file
+  (ClientInfo element, in the same format as DefaultClientInfo in the device set configuration; if not specified then the
+  server's default client info is used), and receive and discard the messages for durationSec. Each client sends
+  RequestChannelIds commands at commandRate per second. The throughput, message latency and command round trip time
+  percentiles are reported for each client and in total. The latency is computed from the IGTL timestamps of the messages,
+  therefore it is only accurate if the clocks of the server and the client computers are synchronized.
+  metricsClient is used for requesting the number of frames that the server sent and dropped.
+*/
+PlusStatus RunBenchmark(vtkPlusOpenIGTLinkClient* metricsClient, const std::string& serverHost, int serverPort, int numberOfClients,
+                        const std::string& clientInfoFileName, double durationSec, double commandRate)
+{
+  PlusIgtlClientInfo clientInfo;
+  bool clientInfoSpecified = !clientInfoFileName.empty();
+  if (clientInfoSpecified)
+  {
+    vtkSmartPointer<vtkXMLDataElement> clientInfoFileElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromFile(clientInfoFileName.c_str()));
+    if (clientInfoFileElement == NULL)
+    {
+      LOG_ERROR("Failed to read client info file: " << clientInfoFileName);
+      return PLUS_FAIL;
+    }
+    vtkXMLDataElement* clientInfoElement = clientInfoFileElement;
+    if (STRCASECMP(clientInfoElement->GetName(), "ClientInfo") != 0 && STRCASECMP(clientInfoElement->GetName(), "DefaultClientInfo") != 0)
+    {
+      clientInfoElement = clientInfoFileElement->LookupElementWithName("ClientInfo");
+      if (clientInfoElement == NULL)
+      {
+        clientInfoElement = clientInfoFileElement->LookupElementWithName("DefaultClientInfo");
+      }
+    }
+    if (clientInfoElement == NULL || clientInfo.SetClientInfoFromXmlData(clientInfoElement) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("No valid ClientInfo element is found in " << clientInfoFileName);
+      return PLUS_FAIL;
+    }
+  }
+
+  PlusStatus status = PLUS_SUCCESS;
+  std::vector<vtkSmartPointer<vtkPlusOpenIGTLinkClientWithStatistics> > clients;
+  for (int clientIndex = 0; clientIndex < numberOfClients; ++clientIndex)
+  {
+    vtkSmartPointer<vtkPlusOpenIGTLinkClientWithStatistics> client = vtkSmartPointer<vtkPlusOpenIGTLinkClientWithStatistics>::New();
+    client->SetServerHost(serverHost.c_str());
+    client->SetServerPort(serverPort);
+    client->SetServerIGTLVersion(metricsClient->GetServerIGTLVersion());
+    if (client->Connect(15.0) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Benchmark client " << clientIndex << " failed to connect to server at " << serverHost << ":" << serverPort);
+      status = PLUS_FAIL;
+      break;
+    }
+    clients.push_back(client);
+    if (clientInfoSpecified)
+    {
+      igtl::PlusClientInfoMessage::Pointer clientInfoMsg = igtl::PlusClientInfoMessage::New();
+      if (clientInfo.GetClientHeaderVersion() >= IGTL_HEADER_VERSION_2)
+      {
+        clientInfoMsg->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+      }
+      clientInfoMsg->SetClientInfo(clientInfo);
+      clientInfoMsg->Pack();
+      if (client->SendMessage(clientInfoMsg) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Benchmark client " << clientIndex << " failed to send client info");
+        status = PLUS_FAIL;
+        break;
+      }
+    }
+  }
+
+  if (status == PLUS_SUCCESS)
+  {
+    LOG_INFO("Benchmark with " << clients.size() << " clients for " << durationSec << " sec" << (commandRate > 0 ? ", " + igsioCommon::ToString(commandRate) + " commands/s per client" : ""));
+    signal(SIGINT, SignalInterruptHandler);
+
+    double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    for (std::vector<vtkSmartPointer<vtkPlusOpenIGTLinkClientWithStatistics> >::iterator clientIt = clients.begin(); clientIt != clients.end(); ++clientIt)
+    {
+      (*clientIt)->ResetStatistics();
+    }
+    double nextCommandTime = startTime;
+    double currentTime = startTime;
+    while (currentTime - startTime < durationSec && !StopClientRequested)
+    {
+      if (commandRate > 0 && currentTime >= nextCommandTime)
+      {
+        for (std::vector<vtkSmartPointer<vtkPlusOpenIGTLinkClientWithStatistics> >::iterator clientIt = clients.begin(); clientIt != clients.end(); ++clientIt)
+        {
+          vtkPlusOpenIGTLinkClientWithStatistics* client = *clientIt;
+          vtkSmartPointer<vtkPlusRequestIdsCommand> cmd = vtkSmartPointer<vtkPlusRequestIdsCommand>::New();
+          cmd->SetNameToRequestChannelIds();
+          double commandSentTime = vtkIGSIOAccurateTimer::GetSystemTime();
+          client->SendCommandAsync(cmd, [client, commandSentTime](const vtkPlusOpenIGTLinkClient::CommandReply & reply)
+          {
+            client->RecordCommandReply(reply.Status, vtkIGSIOAccurateTimer::GetSystemTime() - commandSentTime);
+          });
+        }
+        nextCommandTime += 1.0 / commandRate;
+      }
+      vtkIGSIOAccurateTimer::Delay(commandRate > 0 ? std::min(0.010, 0.5 / commandRate) : 0.010);
+      currentTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    }
+    double measuredDurationSec = std::max(currentTime - startTime, 0.001);
+
+    // Replies of the last commands
+    const double commandReplyTimeoutSec = 5.0;
+    double replyWaitStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    for (std::vector<vtkSmartPointer<vtkPlusOpenIGTLinkClientWithStatistics> >::iterator clientIt = clients.begin(); clientIt != clients.end(); ++clientIt)
+    {
+      while ((*clientIt)->GetNumberOfPendingCommands() > 0 && vtkIGSIOAccurateTimer::GetSystemTime() - replyWaitStartTime < commandReplyTimeoutSec)
+      {
+        vtkIGSIOAccurateTimer::Delay(0.010);
+      }
+    }
+
+    vtkPlusOpenIGTLinkClientWithStatistics::Statistics totalStatistics;
+    for (size_t clientIndex = 0; clientIndex < clients.size(); ++clientIndex)
+    {
+      vtkPlusOpenIGTLinkClientWithStatistics::Statistics statistics = clients[clientIndex]->GetStatistics();
+      PrintStatistics("Client " + igsioCommon::ToString(clientIndex), statistics, measuredDurationSec);
+      totalStatistics.NumberOfMessages += statistics.NumberOfMessages;
+      totalStatistics.NumberOfBytes += statistics.NumberOfBytes;
+      for (std::map<std::string, unsigned long>::const_iterator typeIt = statistics.NumberOfMessagesByType.begin(); typeIt != statistics.NumberOfMessagesByType.end(); ++typeIt)
+      {
+        totalStatistics.NumberOfMessagesByType[typeIt->first] += typeIt->second;
+      }
+      totalStatistics.MessageLatenciesSec.insert(totalStatistics.MessageLatenciesSec.end(), statistics.MessageLatenciesSec.begin(), statistics.MessageLatenciesSec.end());
+      totalStatistics.NumberOfCommands += statistics.NumberOfCommands;
+      totalStatistics.NumberOfFailedCommands += statistics.NumberOfFailedCommands;
+      totalStatistics.CommandRoundTripTimesSec.insert(totalStatistics.CommandRoundTripTimesSec.end(), statistics.CommandRoundTripTimesSec.begin(), statistics.CommandRoundTripTimesSec.end());
+    }
+    PrintStatistics("Total", totalStatistics, measuredDurationSec);
+    if (totalStatistics.NumberOfFailedCommands > 0)
+    {
+      status = PLUS_FAIL;
+    }
+
+    // Frame counters of the server, they include all the clients that are connected to the server
+    vtkSmartPointer<vtkPlusGetMetricsCommand> metricsCmd = vtkSmartPointer<vtkPlusGetMetricsCommand>::New();
+    metricsCmd->SetNameToGetMetrics();
+    std::shared_future<vtkPlusOpenIGTLinkClient::CommandReply> metricsReply = metricsClient->SendCommandAsync(metricsCmd);
+    if (metricsReply.wait_for(std::chrono::duration<double>(commandReplyTimeoutSec)) == std::future_status::ready && metricsReply.get().Status == PLUS_SUCCESS)
+    {
+      const std::string& metricsText = metricsReply.get().Content;
+      LOG_INFO("Server frames sent: " << GetMetricSum(metricsText, "plus_server_client_sent_frames_total")
+               << ", dropped: " << GetMetricSum(metricsText, "plus_server_client_dropped_frames_total")
+               << ", queued: " << GetMetricSum(metricsText, "plus_server_client_queued_frames"));
+    }
+    else
+    {
+      LOG_WARNING("Failed to get the frame counters of the server (GetMetrics command)");
+    }
+  }
+
+  for (std::vector<vtkSmartPointer<vtkPlusOpenIGTLinkClientWithStatistics> >::iterator clientIt = clients.begin(); clientIt != clients.end(); ++clientIt)
+  {
+    (*clientIt)->Disconnect();
+  }
+  return status;
+}
+
 //----------------------------------------------------------------------------
 int main(int argc, char** argv)
 {
@@ -765,7 +1216,12 @@ int main(int argc, char** argv)
   int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
   bool keepConnected = false;
   std::string serverConfigFileName;
+  std::string commandFileName;
   bool runTests = false;
+  int benchmarkNumberOfClients(0);
+  std::string benchmarkClientInfoFileName;
+  double benchmarkDurationSec(10.0);
+  double benchmarkCommandRate(0.0);
   int serverIGTLVersion(-1);
   int commandId(0);
   double lastNSeconds(-1.0);
@@ -778,6 +1234,7 @@ int main(int argc, char** argv)
   args.AddArgument("--command", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &command,
                    "Command name to be executed on the server (START_ACQUISITION, STOP_ACQUISITION, SUSPEND_ACQUISITION, RESUME_ACQUISITION, RECONSTRUCT, START_RECONSTRUCTION, SUSPEND_RECONSTRUCTION, RESUME_RECONSTRUCTION, STOP_RECONSTRUCTION, GET_RECONSTRUCTION_SNAPSHOT, GET_CHANNEL_IDS, GET_DEVICE_IDS, GET_EXAM_DATA, SAVE_RAW_DATA, SEND_TEXT, UPDATE_TRANSFORM, GET_TRANSFORM, GET_POINT)");
   args.AddArgument("--command-id", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &commandId, "Command ID to send to the server.");
+  args.AddArgument("--command-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &commandFileName, "File that contains one command XML element per line (e.g., <Command Name=\"RequestChannelIds\" />). All the commands are sent without waiting for the replies, then the replies are printed. If --command-id is specified then the commands get consecutive IDs starting from it.");
   args.AddArgument("--server-igtl-version", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &serverHeaderVersion, "The version of IGTL used by the server. Remove this parameter when querying is dynamic.");
   args.AddArgument("--device", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &deviceId, "ID of the controlled device (optional, default: first VirtualStreamCapture or VirtualVolumeReconstructor device). In case of GET_DEVICE_IDS it is not an ID but a device type.");
   args.AddArgument("--input-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputFilename, "File name of the input, used for RECONSTRUCT command");
@@ -799,6 +1256,10 @@ int main(int argc, char** argv)
   args.AddArgument("--server-config-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &serverConfigFileName, "Starts a PlusServer instance with the provided config file. When this process exits, the server is stopped.");
   args.AddArgument("--run-tests", vtksys::CommandLineArguments::NO_ARGUMENT, &runTests, "Test execution of all remote control commands. Requires a running PlusServer, which can be launched by --server-config-file");
   args.AddArgument("--last-n-seconds", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &lastNSeconds, "Number of seconds of raw data to acquire from Clarius");
+  args.AddArgument("--benchmark-clients", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &benchmarkNumberOfClients, "Benchmark mode: number of simulated clients that connect to the server, receive and discard the messages, and report throughput, latency and dropped frames");
+  args.AddArgument("--benchmark-client-info", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &benchmarkClientInfoFileName, "Benchmark mode: XML file with a ClientInfo element that specifies the messages requested by each simulated client (default: the server's DefaultClientInfo)");
+  args.AddArgument("--benchmark-duration", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &benchmarkDurationSec, "Benchmark mode: duration of the measurement in seconds (default: 10)");
+  args.AddArgument("--benchmark-command-rate", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &benchmarkCommandRate, "Benchmark mode: number of commands sent per second by each simulated client (default: 0)");
 
   if (!args.Parse())
   {
@@ -807,9 +1268,9 @@ int main(int argc, char** argv)
     exit(EXIT_FAILURE);
   }
 
-  if (command.empty() && !keepConnected && !runTests)
+  if (command.empty() && commandFileName.empty() && !keepConnected && !runTests && benchmarkNumberOfClients <= 0)
   {
-    LOG_ERROR("The program has nothing to do, as neither --command, --keep-connected, nor --run-tests is specifed");
+    LOG_ERROR("The program has nothing to do, as neither --command, --command-file, --keep-connected, --run-tests, nor --benchmark-clients is specifed");
     std::cout << "Help: " << args.GetHelp() << std::endl;
     exit(EXIT_FAILURE);
   }
@@ -970,6 +1431,19 @@ int main(int argc, char** argv)
     }
   }
 
+  // Run the commands of a file
+  if (!commandFileName.empty())
+  {
+    if (ExecuteCommandFile(client, commandFileName, commandId) != PLUS_SUCCESS)
+    {
+      processReturnValue = EXIT_FAILURE;
+    }
+    if (!keepConnected)
+    {
+      StopClientRequested = true;
+    }
+  }
+
   // Run automatic tests
   if (runTests)
   {
@@ -981,6 +1455,16 @@ int main(int argc, char** argv)
     StopClientRequested = true;
   }
 
+  // Run benchmark
+  if (benchmarkNumberOfClients > 0)
+  {
+    if (RunBenchmark(client, serverHost, serverPort, benchmarkNumberOfClients, benchmarkClientInfoFileName, benchmarkDurationSec, benchmarkCommandRate) != PLUS_SUCCESS)
+    {
+      processReturnValue = EXIT_FAILURE;
+    }
+    StopClientRequested = true;
+  }
+
   // Remain connected until the user requests to stop
   if (!StopClientRequested)
   {
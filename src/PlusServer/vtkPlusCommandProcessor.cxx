@@ -8,6 +8,7 @@ See License.txt for details.
 #include "PlusConfigure.h"
 #include "vtkIGSIORecursiveCriticalSection.h"
 #include "vtkPlusCommandProcessor.h"
+#include "vtkPlusOpenIGTLinkServer.h"
 
 // Command includes
 #include "vtkPlusCommand.h"
@@ -27,9 +28,11 @@ See License.txt for details.
 #endif
 
 #include "vtkPlusAddRecordingDeviceCommand.h"
+#include "vtkPlusGetMetricsCommand.h"
 #include "vtkPlusGetPolydataCommand.h"
 #include "vtkPlusGetTransformCommand.h"
 #include "vtkPlusGetUsParameterCommand.h"
+#include "vtkPlusLatencyTracingCommand.h"
 #include "vtkPlusRequestIdsCommand.h"
 #include "vtkPlusSaveConfigCommand.h"
 #include "vtkPlusSendTextCommand.h"
@@ -52,10 +55,10 @@ vtkStandardNewMacro(vtkPlusCommandProcessor);
 //----------------------------------------------------------------------------
 vtkPlusCommandProcessor::vtkPlusCommandProcessor()
   : PlusServer(NULL)
-  , Threader(vtkSmartPointer<vtkMultiThreader>::New())
   , Mutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
-  , CommandExecutionActive(std::make_pair(false, false))
-  , CommandExecutionThreadId(-1)
+  , NumberOfThreads(1)
+  , CommandExecutionActive(false)
+  , ConfigurationVersion(0)
 {
   // Register default commands
   RegisterPlusCommand(vtkSmartPointer<vtkPlusGetImageCommand>::New());
@@ -71,6 +74,8 @@ vtkPlusCommandProcessor::vtkPlusCommandProcessor()
   RegisterPlusCommand(vtkSmartPointer<vtkPlusSetUsParameterCommand>::New());
   RegisterPlusCommand(vtkSmartPointer<vtkPlusGetUsParameterCommand>::New());
   RegisterPlusCommand(vtkSmartPointer<vtkPlusAddRecordingDeviceCommand>::New());
+  RegisterPlusCommand(vtkSmartPointer<vtkPlusLatencyTracingCommand>::New());
+  RegisterPlusCommand(vtkSmartPointer<vtkPlusGetMetricsCommand>::New());
 #ifdef PLUS_USE_STEALTHLINK
   RegisterPlusCommand(vtkSmartPointer<vtkPlusStealthLinkCommand>::New());
 #endif
@@ -88,6 +93,7 @@ vtkPlusCommandProcessor::vtkPlusCommandProcessor()
 //----------------------------------------------------------------------------
 vtkPlusCommandProcessor::~vtkPlusCommandProcessor()
 {
+  this->Stop();
   SetPlusServer(NULL);
 }
 
@@ -100,100 +106,247 @@ void vtkPlusCommandProcessor::PrintSelf(ostream& os, vtkIndent indent)
   {
     os << indent << "  " << iter->first << std::endl;
   }
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << std::endl;
+  os << indent << "ConfigurationVersion: " << this->ConfigurationVersion << std::endl;
 }
 
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusCommandProcessor::Start()
 {
-  if (this->CommandExecutionThreadId < 0)
+  if (!this->CommandExecutionThreads.empty())
   {
-    this->CommandExecutionActive.first = true;
-    this->CommandExecutionThreadId = this->Threader->SpawnThread((vtkThreadFunctionType)&CommandExecutionThread, this);
+    return PLUS_SUCCESS;
   }
+  if (this->NumberOfThreads < 1)
+  {
+    LOG_ERROR("Cannot start command processing: invalid number of threads (" << this->NumberOfThreads << ")");
+    return PLUS_FAIL;
+  }
+
+  this->CommandExecutionActive = true;
+  for (int threadIndex = 0; threadIndex < this->NumberOfThreads; ++threadIndex)
+  {
+    this->CommandExecutionThreads.push_back(std::thread(&vtkPlusCommandProcessor::CommandExecutionThread, this, threadIndex));
+  }
+  LOG_DEBUG("Command execution started on " << this->NumberOfThreads << " threads");
   return PLUS_SUCCESS;
 }
 
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusCommandProcessor::Stop()
 {
-  // Stop the command execution thread
-  if (this->CommandExecutionThreadId >= 0)
+  if (this->CommandExecutionThreads.empty())
   {
-    this->CommandExecutionActive.first = false;
-    while (this->CommandExecutionActive.second)
-    {
-      // Wait until the thread stops
-      vtkIGSIOAccurateTimer::Delay(0.2);
-    }
-    this->CommandExecutionThreadId = -1;
+    return PLUS_SUCCESS;
   }
 
-  LOG_DEBUG("Command execution thread stopped");
+  // Stop the command execution threads, the commands that are being executed are completed
+  {
+    std::lock_guard<std::mutex> queueLock(this->CommandQueueMutex);
+    this->CommandExecutionActive = false;
+  }
+  this->CommandQueueCondition.notify_all();
+  for (std::vector<std::thread>::iterator threadIt = this->CommandExecutionThreads.begin(); threadIt != this->CommandExecutionThreads.end(); ++threadIt)
+  {
+    threadIt->join();
+  }
+  this->CommandExecutionThreads.clear();
+
+  LOG_DEBUG("Command execution threads stopped");
 
   return PLUS_SUCCESS;
 }
 
 //----------------------------------------------------------------------------
-void* vtkPlusCommandProcessor::CommandExecutionThread(vtkMultiThreader::ThreadInfo* data)
+void vtkPlusCommandProcessor::CommandExecutionThread(int threadIndex)
 {
-  vtkPlusCommandProcessor* self = (vtkPlusCommandProcessor*)(data->UserData);
-
-  self->CommandExecutionActive.second = true;
+  if (this->PlusServer != NULL)
+  {
+    this->PlusServer->GetThreadSettings().ApplyToCurrentThread("command execution " + igsioCommon::ToString<int>(threadIndex));
+  }
 
   // Execute commands until a stop is requested
-  while (self->CommandExecutionActive.first)
+  while (true)
   {
-    self->ExecuteCommands();
-    // no commands in the queue, wait a bit before checking again
-    const double commandQueuePollIntervalSec = 0.010;
-#ifdef _WIN32
-    Sleep(commandQueuePollIntervalSec * 1000);
-#else
-    usleep(commandQueuePollIntervalSec * 1000000);
-#endif
+    vtkSmartPointer<vtkPlusCommand> cmd;
+    PlusCommandList coalescedCommands;
+    {
+      std::unique_lock<std::mutex> queueLock(this->CommandQueueMutex);
+      this->CommandQueueCondition.wait(queueLock, [this, &cmd, &coalescedCommands]()
+      {
+        if (!this->CommandExecutionActive)
+        {
+          return true;
+        }
+        cmd = this->TakeNextExecutableCommand(coalescedCommands);
+        return cmd.GetPointer() != NULL;
+      });
+      if (!this->CommandExecutionActive)
+      {
+        break;
+      }
+    }
+    this->ExecuteCommand(cmd, coalescedCommands);
   }
-
-  // Close thread
-  self->CommandExecutionThreadId = -1;
-  self->CommandExecutionActive.second = false;
-  return NULL;
 }
 
 //----------------------------------------------------------------------------
 int vtkPlusCommandProcessor::ExecuteCommands()
 {
-  // Implemented in a while loop to not block the mutex during command execution, only during management of the queue.
+  if (!this->CommandExecutionThreads.empty())
+  {
+    // the commands are executed by the worker threads
+    return 0;
+  }
+
+  // Implemented in a loop to not block the mutex during command execution, only during management of the queue.
   int numberOfExecutedCommands(0);
-  while (1)
+  while (true)
   {
     vtkSmartPointer<vtkPlusCommand> cmd; // next command to be processed
+    PlusCommandList coalescedCommands;
     {
-      igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
-      if (this->CommandQueue.empty())
-      {
-        return numberOfExecutedCommands;
-      }
-      cmd = this->CommandQueue.front();
-      this->CommandQueue.pop_front();
+      std::lock_guard<std::mutex> queueLock(this->CommandQueueMutex);
+      cmd = this->TakeNextExecutableCommand(coalescedCommands);
+    }
+    if (cmd.GetPointer() == NULL)
+    {
+      return numberOfExecutedCommands;
     }
+    this->ExecuteCommand(cmd, coalescedCommands);
+    numberOfExecutedCommands += 1 + static_cast<int>(coalescedCommands.size());
+  }
+}
 
-    LOG_DEBUG("Executing command");
-    if (cmd->Execute() != PLUS_SUCCESS)
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkPlusCommand> vtkPlusCommandProcessor::TakeNextExecutableCommand(PlusCommandList& coalescedCommands)
+{
+  coalescedCommands.clear();
+  for (PlusCommandList::iterator cmdIt = this->CommandQueue.begin(); cmdIt != this->CommandQueue.end(); ++cmdIt)
+  {
+    // the earlier commands of a strand are queued before the later ones, so the first command of a free strand is the next one in order
+    std::string strand = (*cmdIt)->GetTargetDeviceId();
+    if (this->BusyStrands.find(strand) != this->BusyStrands.end())
     {
-      LOG_ERROR("Command execution failed");
+      continue;
     }
+    vtkSmartPointer<vtkPlusCommand> cmd = *cmdIt;
+    cmdIt = this->CommandQueue.erase(cmdIt);
+    this->BusyStrands.insert(strand);
 
-    // move the response objects from the command to the processor's queue
+    // Merge the following commands of the strand until a command that cannot be merged, so that the order of the strand is kept
+    std::string coalescingKey = cmd->GetCoalescingKey();
+    while (!coalescingKey.empty() && cmdIt != this->CommandQueue.end())
     {
-      igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
-      cmd->PopCommandResponses(this->CommandResponseQueue);
+      if ((*cmdIt)->GetTargetDeviceId() != strand)
+      {
+        ++cmdIt;
+        continue;
+      }
+      if ((*cmdIt)->GetCoalescingKey() != coalescingKey || !cmd->Coalesce(*cmdIt))
+      {
+        break;
+      }
+      coalescedCommands.push_back(*cmdIt);
+      cmdIt = this->CommandQueue.erase(cmdIt);
+    }
+    if (!coalescedCommands.empty())
+    {
+      LOG_DEBUG("Command " << cmd->GetName() << " is merged with " << coalescedCommands.size() << " later requests");
     }
+    return cmd;
+  }
+  return vtkSmartPointer<vtkPlusCommand>();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusCommandProcessor::ExecuteCommand(vtkPlusCommand* cmd, const PlusCommandList& coalescedCommands)
+{
+  const std::string strand = cmd->GetTargetDeviceId();
+  LOG_DEBUG("Executing command " << cmd->GetName() << (strand.empty() ? std::string("") : " on device " + strand));
+  PlusStatus status = cmd->Execute();
+  if (status != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Command execution failed");
+  }
+
+  // the version is incremented before the reply is queued, so a client that queries the configuration
+  // after receiving the reply gets the new configuration
+  bool configurationChanged = cmd->ChangesConfiguration();
+  for (PlusCommandList::const_iterator coalescedIt = coalescedCommands.begin(); coalescedIt != coalescedCommands.end(); ++coalescedIt)
+  {
+    configurationChanged = configurationChanged || (*coalescedIt)->ChangesConfiguration();
+  }
+  if (configurationChanged)
+  {
+    ++this->ConfigurationVersion;
+  }
+
+  // move the response objects from the command to the processor's queue
+  this->QueueResponsesOfCommand(cmd);
+
+  // the merged commands are replied in the order they were received
+  for (PlusCommandList::const_iterator coalescedIt = coalescedCommands.begin(); coalescedIt != coalescedCommands.end(); ++coalescedIt)
+  {
+    (*coalescedIt)->CompleteCoalesced(cmd, status);
+    this->QueueResponsesOfCommand(*coalescedIt);
+  }
+
+  {
+    std::lock_guard<std::mutex> queueLock(this->CommandQueueMutex);
+    this->BusyStrands.erase(strand);
+  }
+  // the next command of the strand may be executed now
+  this->CommandQueueCondition.notify_all();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusCommandProcessor::QueueResponsesOfCommand(vtkPlusCommand* cmd)
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
+  cmd->PopCommandResponses(this->CommandResponseQueue);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusCommandProcessor::QueueResponses(const PlusCommandResponseList& responses)
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
+  this->CommandResponseQueue.insert(this->CommandResponseQueue.end(), responses.begin(), responses.end());
+}
+
+//----------------------------------------------------------------------------
+unsigned long vtkPlusCommandProcessor::GetConfigurationVersion() const
+{
+  return this->ConfigurationVersion;
+}
 
-    numberOfExecutedCommands++;
+//----------------------------------------------------------------------------
+std::shared_ptr<const igtl::MessageBase::MetaDataMap> vtkPlusCommandProcessor::GetConfigurationSnapshot(const std::string& snapshotKey)
+{
+  std::lock_guard<std::mutex> snapshotLock(this->ConfigurationSnapshotMutex);
+  if (this->ConfigurationSnapshotKey != snapshotKey)
+  {
+    return nullptr;
   }
+  return this->ConfigurationSnapshot;
+}
 
-  // we never actually reach this point
-  return numberOfExecutedCommands;
+//----------------------------------------------------------------------------
+void vtkPlusCommandProcessor::SetConfigurationSnapshot(const std::string& snapshotKey, std::shared_ptr<const igtl::MessageBase::MetaDataMap> snapshot)
+{
+  std::lock_guard<std::mutex> snapshotLock(this->ConfigurationSnapshotMutex);
+  this->ConfigurationSnapshotKey = snapshotKey;
+  this->ConfigurationSnapshot = snapshot;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusCommandProcessor::EnqueueCommand(vtkPlusCommand* cmd)
+{
+  {
+    std::lock_guard<std::mutex> queueLock(this->CommandQueueMutex);
+    this->CommandQueue.push_back(cmd);
+  }
+  this->CommandQueueCondition.notify_one();
 }
 
 //----------------------------------------------------------------------------
@@ -292,8 +445,7 @@ PlusStatus vtkPlusCommandProcessor::QueueCommand(bool respondUsingIGTLCommand, u
   cmd->SetRespondWithCommandMessage(respondUsingIGTLCommand);
 
   // Add command to the execution queue
-  igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
-  this->CommandQueue.push_back(cmd);
+  this->EnqueueCommand(cmd);
 
   return PLUS_SUCCESS;
 }
@@ -350,11 +502,7 @@ PlusStatus vtkPlusCommandProcessor::QueueGetImageMetaData(unsigned int clientId,
   cmdGetImage->SetDeviceName(deviceName.c_str());
   cmdGetImage->SetNameToGetImageMeta();
   cmdGetImage->SetImageId(deviceName.c_str());
-  {
-    // Add command to the execution queue
-    igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
-    this->CommandQueue.push_back(cmdGetImage);
-  }
+  this->EnqueueCommand(cmdGetImage);
   return PLUS_SUCCESS;
 }
 
@@ -367,11 +515,7 @@ PlusStatus vtkPlusCommandProcessor::QueueGetImage(unsigned int clientId, const s
   cmdGetImage->SetDeviceName(deviceName.c_str());
   cmdGetImage->SetNameToGetImage();
   cmdGetImage->SetImageId(deviceName.c_str());
-  {
-    // Add command to the execution queue
-    igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
-    this->CommandQueue.push_back(cmdGetImage);
-  }
+  this->EnqueueCommand(cmdGetImage);
   return PLUS_SUCCESS;
 }
 
@@ -388,6 +532,6 @@ void vtkPlusCommandProcessor::PopCommandResponses(PlusCommandResponseList& respo
 //------------------------------------------------------------------------------
 bool vtkPlusCommandProcessor::IsRunning()
 {
-  return this->CommandExecutionActive.second;
+  return this->CommandExecutionActive;
 }
 
@@ -14,7 +14,15 @@
 #include "vtkPlusCommand.h"
 #include "vtkPlusCommandResponse.h"
 #include "vtkPlusOpenIGTLinkServer.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <string>
+#include <thread>
+#include <vector>
 
 class vtkImageData;
 class vtkMatrix4x4;
@@ -23,9 +31,19 @@ class vtkMatrix4x4;
   \class vtkPlusCommandProcessor
   \brief Creates a PlusCommand from a string.
   If the commands are to be executed on the main thread then call ExecuteCommands() periodically from the main thread.
-  If the commands are to be executed on a separate thread (to allow background processing, but maybe requiring more synchronization) call Start() to start an internal processing thread.
-  Probably one of the processing models would be enough, but at this point it's not clear which one is better.
-  TODO: keep only one method and remove the other approach completely once the processing model decision is finalized.
+  If the commands are to be executed concurrently then set NumberOfThreads and call Start() to start a pool of worker threads.
+
+  Each command belongs to an execution strand, identified by its target device (see vtkPlusCommand::GetTargetDeviceId).
+  Commands of the same strand are executed one at a time, in the order they were queued, while commands of different strands
+  run concurrently. So a long reconstruction or recording command blocks only the commands of its own device, not the
+  transform updates or parameter queries of other devices. Commands that do not target a specific device share one strand.
+
+  Consecutive commands of a strand that have the same coalescing key (e.g., a burst of UpdateTransform or SetUsParameter
+  commands) are merged and executed once, applying only the latest value of each item, so the queue stays short under
+  interactive load. Each merged command still gets its reply (see vtkPlusCommand::GetCoalescingKey).
+
+  Command responses are sent when the command execution is completed. Long-running commands may send progress responses
+  while executing (see vtkPlusCommand::ReportProgress).
   \ingroup PlusLibPlusServer
 */
 class vtkPlusServerExport vtkPlusCommandProcessor : public vtkObject
@@ -41,15 +59,19 @@ public:
   */
   int ExecuteCommands();
 
-  /*! Start thread for processing the commands in the queue. Must be called from the main thread. */
+  /*! Start the worker threads for processing the commands in the queue. Must be called from the main thread. */
   virtual PlusStatus Start();
 
-  /*! Stop command processing. Must be called from the main thread. */
+  /*! Stop command processing, waits for the commands that are being executed. Must be called from the main thread. */
   virtual PlusStatus Stop();
 
-  /*! Returns true if the command processing thread is running. Can be called from any thread. */
+  /*! Returns true if the command processing threads are running. Can be called from any thread. */
   virtual bool IsRunning();
 
+  /*! Number of worker threads started by Start(). Must be set before Start() is called. */
+  vtkSetMacro(NumberOfThreads, int);
+  vtkGetMacro(NumberOfThreads, int);
+
   /*!
     Register custom command. Must be called from the main thread.
     \param cmd It should point to a valid vtkPlusCommand instance. The caller can delete the cmd object after the call.
@@ -88,14 +110,61 @@ public:
   */
   virtual void PopCommandResponses(PlusCommandResponseList& responses);
 
+  /*!
+    Move the responses of a command to the response queue, so that they are sent to the client.
+    Called when the command execution is completed, and by commands that report progress while executing.
+    Can be called from any thread.
+  */
+  void QueueResponsesOfCommand(vtkPlusCommand* cmd);
+
+  /*!
+    Add responses to the response queue, so that they are sent to the client.
+    Used by commands that continue processing in the background after their execution is completed.
+    Can be called from any thread.
+  */
+  void QueueResponses(const PlusCommandResponseList& responses);
+
+  /*!
+    Version of the configuration that the clients can query (devices, channels, persistent transforms).
+    Incremented after each command that changes the configuration (see vtkPlusCommand::ChangesConfiguration).
+    Can be called from any thread.
+  */
+  unsigned long GetConfigurationVersion() const;
+
+  /*!
+    Get the cached configuration snapshot (reply parameters of a configuration query).
+    Returns nullptr if the cached snapshot was built for another configuration state than snapshotKey.
+    The snapshot is shared by the commands and must not be modified. Can be called from any thread.
+  */
+  std::shared_ptr<const igtl::MessageBase::MetaDataMap> GetConfigurationSnapshot(const std::string& snapshotKey);
+
+  /*! Store the configuration snapshot built for the configuration state snapshotKey. Can be called from any thread. */
+  void SetConfigurationSnapshot(const std::string& snapshotKey, std::shared_ptr<const igtl::MessageBase::MetaDataMap> snapshot);
+
   vtkGetObjectMacro(PlusServer, vtkPlusOpenIGTLinkServer);
   vtkSetObjectMacro(PlusServer, vtkPlusOpenIGTLinkServer);
 
 protected:
+  typedef std::list< vtkSmartPointer<vtkPlusCommand> > PlusCommandList;
+
   vtkPlusCommand* CreatePlusCommand(const std::string& commandName, const std::string& commandStr, const igtl::MessageBase::MetaDataMap& metaData);
 
-  /*! Thread for client connection handling */
-  static void* CommandExecutionThread(vtkMultiThreader::ThreadInfo* data);
+  /*! Worker thread that executes commands until command processing is stopped */
+  void CommandExecutionThread(int threadIndex);
+
+  /*! Add a command to the execution queue and wake up a worker thread */
+  void EnqueueCommand(vtkPlusCommand* cmd);
+
+  /*!
+    Remove the first command from the queue whose strand is not being executed and mark its strand as busy.
+    The commands of the strand that are waiting right after it with the same coalescing key are merged into it,
+    removed from the queue and returned in coalescedCommands.
+    Returns NULL if no command can be executed now. CommandQueueMutex must be locked by the caller.
+  */
+  vtkSmartPointer<vtkPlusCommand> TakeNextExecutableCommand(PlusCommandList& coalescedCommands);
+
+  /*! Execute a command taken by TakeNextExecutableCommand, queue its responses and the responses of the merged commands, and release its strand */
+  void ExecuteCommand(vtkPlusCommand* cmd, const PlusCommandList& coalescedCommands);
 
   vtkPlusCommandProcessor();
   virtual ~vtkPlusCommandProcessor();
@@ -104,31 +173,42 @@ private:
   /*! Link to the server that owns this command processor */
   vtkPlusOpenIGTLinkServer* PlusServer;
 
-  /*! vtkMultiThreader instance for controlling threads */
-  vtkSmartPointer<vtkMultiThreader> Threader;
-
-  /*! Mutex instance for safe data access */
+  /*! Mutex instance for safe access of the response queue */
   vtkSmartPointer<vtkIGSIORecursiveCriticalSection> Mutex;
 
-  // Active flag for threads (first: request, second: respond )
-  std::pair<bool, bool> CommandExecutionActive;
+  /*! Number of worker threads started by Start() */
+  int NumberOfThreads;
 
-  // Thread identifier
-  int CommandExecutionThreadId;
+  /*! Worker threads, empty if the commands are executed by ExecuteCommands() */
+  std::vector<std::thread> CommandExecutionThreads;
+
+  /*! Set while the worker threads are requested to run */
+  std::atomic<bool> CommandExecutionActive;
+
+  /*! Protects CommandQueue and BusyStrands */
+  std::mutex CommandQueueMutex;
+
+  /*! Signaled when a command is queued or a strand is released */
+  std::condition_variable CommandQueueCondition;
+
+  /*! Strands (target device ids) that have a command being executed */
+  std::set<std::string> BusyStrands;
 
   /*! Map command names and the New() static methods of vtkPlusCommand classes */
   std::map<std::string, vtkPlusCommand*> RegisteredCommands;
 
-  /*!
-    This queue contains all the active commands.
-    After a command's execute method is called it may still remain active (remain in the queue),
-    until it signals that it is completed.
-  */
-  //std::list<vtkPlusCommand*> CommandQueue;
-  typedef std::list< vtkSmartPointer<vtkPlusCommand> > PlusCommandList;
+  /*! Commands waiting for execution, in the order they were received */
   PlusCommandList CommandQueue;
   PlusCommandResponseList CommandResponseQueue;
 
+  /*! Incremented after each executed command that changes the configuration */
+  std::atomic<unsigned long> ConfigurationVersion;
+
+  /*! Protects ConfigurationSnapshotKey and ConfigurationSnapshot */
+  std::mutex ConfigurationSnapshotMutex;
+  std::string ConfigurationSnapshotKey;
+  std::shared_ptr<const igtl::MessageBase::MetaDataMap> ConfigurationSnapshot;
+
   vtkPlusCommandProcessor(const vtkPlusCommandProcessor&);  // Not implemented.
   void operator=(const vtkPlusCommandProcessor&);  // Not implemented.
 };
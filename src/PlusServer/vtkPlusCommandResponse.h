@@ -132,6 +132,9 @@ public:
   vtkGetMacro(ImageData, vtkImageData*);
   vtkSetObjectMacro(ImageToReferenceTransform, vtkMatrix4x4);
   vtkGetMacro(ImageToReferenceTransform, vtkMatrix4x4*);
+  /*! If not empty then the image is a snapshot that is not modified (see vtkPlusDevice::GetImageSnapshot), its packed message is cached with this UID */
+  vtkGetMacro(FrameUid, std::string);
+  vtkSetMacro(FrameUid, std::string);
 protected:
   vtkPlusCommandImageResponse()
     : ImageData(NULL)
@@ -146,6 +149,7 @@ protected:
   std::string ImageName;
   vtkImageData* ImageData;
   vtkMatrix4x4* ImageToReferenceTransform;
+  std::string FrameUid;
 private:
   // We have pointers in this class, so make sure we don't try to accidentally copy it
   vtkPlusCommandImageResponse(const vtkPlusCommandImageResponse&);
@@ -163,6 +167,9 @@ public:
   vtkSetMacro(PolyDataName, std::string);
   vtkSetObjectMacro(PolyData, vtkPolyData);
   vtkGetMacro(PolyData, vtkPolyData*);
+  /*! If not empty then the polydata is from vtkPlusPolydataCache, and the packed message is cached with this key */
+  vtkGetMacro(CacheKey, std::string);
+  vtkSetMacro(CacheKey, std::string);
 protected:
   vtkPlusCommandPolydataResponse()
     : PolyData(NULL)
@@ -174,6 +181,7 @@ protected:
   }
   std::string   PolyDataName;
   vtkPolyData*  PolyData;
+  std::string   CacheKey;
 
 private:
   vtkPlusCommandPolydataResponse(const vtkPlusCommandPolydataResponse&);
@@ -17,6 +17,9 @@ See License.txt for details.
 #include "vtkIGSIORecursiveCriticalSection.h"
 #include "vtkXMLUtilities.h"
 
+// STL includes
+#include <chrono>
+
 const float vtkPlusOpenIGTLinkClient::CLIENT_SOCKET_TIMEOUT_SEC = 0.5;
 
 vtkStandardNewMacro(vtkPlusOpenIGTLinkClient);
@@ -32,6 +35,7 @@ vtkPlusOpenIGTLinkClient::vtkPlusOpenIGTLinkClient()
   , SocketMutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
   , ClientSocket(igtl::ClientSocket::New())
   , LastGeneratedCommandId(0)
+  , Replies(vtkSmartPointer<vtkPlusIGTLMessageQueue>::New())
   , ServerPort(-1)
   , ServerHost("")
   , ServerIGTLVersion(IGTL_HEADER_VERSION_1)
@@ -42,6 +46,11 @@ vtkPlusOpenIGTLinkClient::vtkPlusOpenIGTLinkClient()
 //----------------------------------------------------------------------------
 vtkPlusOpenIGTLinkClient::~vtkPlusOpenIGTLinkClient()
 {
+  // Release the replies that have not been received
+  for (igtl::MessageBase* message = this->Replies->PullMessage(); message != NULL; message = this->Replies->PullMessage())
+  {
+    message->UnRegister();
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -99,42 +108,25 @@ PlusStatus vtkPlusOpenIGTLinkClient::Disconnect()
     this->DataReceiverThreadId = -1;
   }
 
+  // No more replies can be received
+  this->CancelPendingCommands("Disconnected from server before the reply was received");
+
   return PLUS_SUCCESS;
 }
 
 //----------------------------------------------------------------------------
-PlusStatus vtkPlusOpenIGTLinkClient::SendCommand(vtkPlusCommand* command)
+std::string vtkPlusOpenIGTLinkClient::GetCommandXml(vtkPlusCommand* command)
 {
-  // Get the XML string
   vtkSmartPointer<vtkXMLDataElement> cmdConfig = vtkSmartPointer<vtkXMLDataElement>::New();
   command->WriteConfiguration(cmdConfig);
   std::ostringstream xmlStr;
   vtkXMLUtilities::FlattenElement(cmdConfig, xmlStr);
-  xmlStr << std::ends;
-
-  std::ostringstream commandUidStringStream;
-
-  // Ensure commandUid is populated
-  igtlUint32 commandUid;
-  if (command->GetId())
-  {
-    commandUid = command->GetId();
-  }
-  else
-  {
-    if (igtl::IGTLProtocolToHeaderLookup(this->GetServerIGTLVersion()) < IGTL_HEADER_VERSION_2)
-    {
-      // command UID is not specified, generate one automatically from the timestamp
-      commandUid = vtkIGSIOAccurateTimer::GetUniversalTime();
-    }
-    else
-    {
-      // command UID is not specified, generate one automatically
-      commandUid = LastGeneratedCommandId;
-      LastGeneratedCommandId++;
-    }
-  }
+  return xmlStr.str();
+}
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkClient::PackCommandMessage(const std::string& commandName, const std::string& commandXml, igtlUint32 commandUid, igtl::MessageBase::Pointer& message)
+{
   // Generate the device name
   std::ostringstream deviceNameSs;
   if (igtl::IGTLProtocolToHeaderLookup(this->GetServerIGTLVersion()) >= IGTL_HEADER_VERSION_2)
@@ -144,35 +136,78 @@ PlusStatus vtkPlusOpenIGTLinkClient::SendCommand(vtkPlusCommand* command)
   }
   else
   {
-    std::string deviceName;
+    std::ostringstream commandUidStringStream;
     commandUidStringStream << commandUid;
+    std::string deviceName;
     vtkPlusCommand::GenerateCommandDeviceName(commandUidStringStream.str(), deviceName);
     deviceNameSs << deviceName;
   }
 
-  igtl::MessageBase::Pointer message;
   if (igtl::IGTLProtocolToHeaderLookup(this->GetServerIGTLVersion()) < IGTL_HEADER_VERSION_2)
   {
     igtl::StringMessage::Pointer strMsg = dynamic_cast<igtl::StringMessage*>(this->IgtlMessageFactory->CreateSendMessage("STRING", igtl::IGTLProtocolToHeaderLookup(this->GetServerIGTLVersion())).GetPointer());
+    if (strMsg.IsNull())
+    {
+      LOG_ERROR("Failed to create STRING message for command " << commandName);
+      return PLUS_FAIL;
+    }
     strMsg->SetDeviceName(deviceNameSs.str().c_str());
-    std::string xmlString = xmlStr.str();
-    strMsg->SetString(xmlString.c_str());
+    strMsg->SetString(commandXml.c_str());
     strMsg->Pack();
     message = strMsg;
   }
   else
   {
     igtl::CommandMessage::Pointer cmdMsg = dynamic_cast<igtl::CommandMessage*>(this->IgtlMessageFactory->CreateSendMessage("COMMAND", igtl::IGTLProtocolToHeaderLookup(this->GetServerIGTLVersion())).GetPointer());
+    if (cmdMsg.IsNull())
+    {
+      LOG_ERROR("Failed to create COMMAND message for command " << commandName);
+      return PLUS_FAIL;
+    }
     cmdMsg->SetDeviceName(deviceNameSs.str().c_str());
     cmdMsg->SetCommandId(commandUid);
-    cmdMsg->SetCommandName(command->GetName());
-    cmdMsg->SetCommandContent(xmlStr.str().c_str());
+    cmdMsg->SetCommandName(commandName);
+    cmdMsg->SetCommandContent(commandXml);
     cmdMsg->Pack();
     message = cmdMsg;
   }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkClient::SendCommand(vtkPlusCommand* command)
+{
+  std::string xmlString = GetCommandXml(command);
+
+  // Ensure commandUid is populated
+  igtlUint32 commandUid;
+  if (command->GetId())
+  {
+    commandUid = command->GetId();
+  }
+  else
+  {
+    if (igtl::IGTLProtocolToHeaderLookup(this->GetServerIGTLVersion()) < IGTL_HEADER_VERSION_2)
+    {
+      // command UID is not specified, generate one automatically from the timestamp
+      commandUid = vtkIGSIOAccurateTimer::GetUniversalTime();
+    }
+    else
+    {
+      // command UID is not specified, generate one automatically
+      commandUid = LastGeneratedCommandId;
+      LastGeneratedCommandId++;
+    }
+  }
+
+  igtl::MessageBase::Pointer message;
+  if (this->PackCommandMessage(command->GetName(), xmlString, commandUid, message) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
 
   // Send the string message to the server.
-  LOG_DEBUG("Sending message: " << xmlStr.str());
+  LOG_DEBUG("Sending message: " << xmlString);
   int success = 0;
   {
     igsioLockGuard<vtkIGSIORecursiveCriticalSection> socketGuard(this->SocketMutex);
@@ -186,6 +221,219 @@ PlusStatus vtkPlusOpenIGTLinkClient::SendCommand(vtkPlusCommand* command)
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkClient::PrepareAsyncCommand(const std::string& commandName, const std::string& commandXml, uint32_t commandId, ReplyCallback callback,
+    ProgressCallback progressCallback, igtl::MessageBase::Pointer& message, igtlUint32& commandUid, std::shared_future<CommandReply>& reply)
+{
+  PendingCommand pendingCommand;
+  pendingCommand.Promise = std::make_shared<std::promise<CommandReply> >();
+  pendingCommand.Callback = callback;
+  pendingCommand.ProgressReportCallback = progressCallback;
+  reply = pendingCommand.Promise->get_future().share();
+
+  CommandReply failedReply;
+  failedReply.CommandName = commandName;
+  {
+    // The command is registered before it is sent, as the reply may arrive before Send returns
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
+    commandUid = commandId;
+    if (commandUid == 0)
+    {
+      // Replies are matched by UID, therefore generated UIDs must not collide with commands in flight
+      do
+      {
+        commandUid = this->LastGeneratedCommandId++;
+      }
+      while (commandUid == 0 || this->PendingCommands.find(commandUid) != this->PendingCommands.end());
+    }
+    else if (this->PendingCommands.find(commandUid) != this->PendingCommands.end())
+    {
+      failedReply.ErrorString = "A command with the same ID is already waiting for reply";
+    }
+    if (failedReply.ErrorString.empty())
+    {
+      this->PendingCommands[commandUid] = pendingCommand;
+    }
+  }
+
+  if (!failedReply.ErrorString.empty())
+  {
+    LOG_ERROR("Cannot send command " << commandName << " (ID: " << commandUid << "): " << failedReply.ErrorString);
+    failedReply.OriginalCommandId = commandUid;
+    pendingCommand.Promise->set_value(failedReply);
+    if (callback)
+    {
+      callback(failedReply);
+    }
+    return PLUS_FAIL;
+  }
+
+  if (this->PackCommandMessage(commandName, commandXml, commandUid, message) != PLUS_SUCCESS)
+  {
+    failedReply.OriginalCommandId = commandUid;
+    failedReply.ErrorString = "Failed to create command message";
+    this->CompletePendingCommand(commandUid, failedReply);
+    return PLUS_FAIL;
+  }
+  LOG_DEBUG("Sending message: " << commandXml);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+std::shared_future<vtkPlusOpenIGTLinkClient::CommandReply> vtkPlusOpenIGTLinkClient::SendCommandAsync(vtkPlusCommand* command, ReplyCallback callback/*=ReplyCallback()*/,
+    ProgressCallback progressCallback/*=ProgressCallback()*/)
+{
+  return this->SendCommandAsync(command->GetName(), GetCommandXml(command), command->GetId(), callback, progressCallback);
+}
+
+//----------------------------------------------------------------------------
+std::shared_future<vtkPlusOpenIGTLinkClient::CommandReply> vtkPlusOpenIGTLinkClient::SendCommandAsync(const std::string& commandName, const std::string& commandXml,
+    uint32_t commandId/*=0*/, ReplyCallback callback/*=ReplyCallback()*/, ProgressCallback progressCallback/*=ProgressCallback()*/)
+{
+  igtl::MessageBase::Pointer message;
+  igtlUint32 commandUid = 0;
+  std::shared_future<CommandReply> reply;
+  if (this->PrepareAsyncCommand(commandName, commandXml, commandId, callback, progressCallback, message, commandUid, reply) != PLUS_SUCCESS)
+  {
+    return reply;
+  }
+
+  int success = 0;
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> socketGuard(this->SocketMutex);
+    success = this->ClientSocket->Send(message->GetBufferPointer(), message->GetBufferSize());
+  }
+  if (!success)
+  {
+    LOG_ERROR("OpenIGTLink client couldn't send command to server.");
+    CommandReply failedReply;
+    failedReply.OriginalCommandId = commandUid;
+    failedReply.CommandName = commandName;
+    failedReply.ErrorString = "Failed to send command to server";
+    this->CompletePendingCommand(commandUid, failedReply);
+  }
+  return reply;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkClient::SendCommands(const std::vector<vtkPlusCommand*>& commands, std::vector<std::shared_future<CommandReply> >& replies)
+{
+  PlusStatus status = PLUS_SUCCESS;
+  replies.clear();
+  replies.reserve(commands.size());
+  std::vector<igtl::MessageBase::Pointer> messages;
+  std::vector<igtlUint32> commandUids;
+  std::vector<std::string> commandNames;
+  for (std::vector<vtkPlusCommand*>::const_iterator commandIt = commands.begin(); commandIt != commands.end(); ++commandIt)
+  {
+    igtl::MessageBase::Pointer message;
+    igtlUint32 commandUid = 0;
+    std::shared_future<CommandReply> reply;
+    if (this->PrepareAsyncCommand((*commandIt)->GetName(), GetCommandXml(*commandIt), (*commandIt)->GetId(), ReplyCallback(), ProgressCallback(), message, commandUid, reply) == PLUS_SUCCESS)
+    {
+      messages.push_back(message);
+      commandUids.push_back(commandUid);
+      commandNames.push_back((*commandIt)->GetName());
+    }
+    else
+    {
+      status = PLUS_FAIL;
+    }
+    replies.push_back(reply);
+  }
+
+  // All the commands are written in one go, so that the receiver thread or other senders cannot interleave with them
+  size_t numberOfSentMessages = 0;
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> socketGuard(this->SocketMutex);
+    for (; numberOfSentMessages < messages.size(); ++numberOfSentMessages)
+    {
+      if (!this->ClientSocket->Send(messages[numberOfSentMessages]->GetBufferPointer(), messages[numberOfSentMessages]->GetBufferSize()))
+      {
+        break;
+      }
+    }
+  }
+  if (numberOfSentMessages < messages.size())
+  {
+    LOG_ERROR("OpenIGTLink client couldn't send " << messages.size() - numberOfSentMessages << " commands to server.");
+    for (size_t i = numberOfSentMessages; i < messages.size(); ++i)
+    {
+      CommandReply failedReply;
+      failedReply.OriginalCommandId = commandUids[i];
+      failedReply.CommandName = commandNames[i];
+      failedReply.ErrorString = "Failed to send command to server";
+      this->CompletePendingCommand(commandUids[i], failedReply);
+    }
+    status = PLUS_FAIL;
+  }
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkClient::WaitForReplies(const std::vector<std::shared_future<CommandReply> >& replies, double timeoutSec)
+{
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now()
+      + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeoutSec));
+  for (std::vector<std::shared_future<CommandReply> >::const_iterator replyIt = replies.begin(); replyIt != replies.end(); ++replyIt)
+  {
+    if (!replyIt->valid() || replyIt->wait_until(deadline) != std::future_status::ready)
+    {
+      return PLUS_FAIL;
+    }
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusOpenIGTLinkClient::GetNumberOfPendingCommands()
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
+  return static_cast<int>(this->PendingCommands.size());
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkClient::CompletePendingCommand(igtlUint32 commandUid, const CommandReply& reply)
+{
+  PendingCommand pendingCommand;
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
+    std::map<igtlUint32, PendingCommand>::iterator pendingIt = this->PendingCommands.find(commandUid);
+    if (pendingIt == this->PendingCommands.end())
+    {
+      return;
+    }
+    pendingCommand = pendingIt->second;
+    this->PendingCommands.erase(pendingIt);
+  }
+  // Called without holding the mutex, so that the callback can send new commands
+  pendingCommand.Promise->set_value(reply);
+  if (pendingCommand.Callback)
+  {
+    pendingCommand.Callback(reply);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkClient::CancelPendingCommands(const std::string& errorString)
+{
+  std::vector<igtlUint32> commandUids;
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
+    for (std::map<igtlUint32, PendingCommand>::const_iterator pendingIt = this->PendingCommands.begin(); pendingIt != this->PendingCommands.end(); ++pendingIt)
+    {
+      commandUids.push_back(pendingIt->first);
+    }
+  }
+  for (std::vector<igtlUint32>::const_iterator uidIt = commandUids.begin(); uidIt != commandUids.end(); ++uidIt)
+  {
+    CommandReply reply;
+    reply.OriginalCommandId = *uidIt;
+    reply.ErrorString = errorString;
+    this->CompletePendingCommand(*uidIt, reply);
+  }
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusOpenIGTLinkClient::SendMessage(igtl::MessageBase::Pointer packedMessage)
 {
@@ -203,100 +451,184 @@ PlusStatus vtkPlusOpenIGTLinkClient::SendMessage(igtl::MessageBase::Pointer pack
 }
 
 //----------------------------------------------------------------------------
-PlusStatus vtkPlusOpenIGTLinkClient::ReceiveReply(PlusStatus& result, int32_t& outOriginalCommandId, std::string& outErrorString,
-    std::string& outContent, igtl::MessageBase::MetaDataMap& outParameters,
-    std::string& outCommandName, double timeoutSec/*=0*/)
+PlusStatus vtkPlusOpenIGTLinkClient::ParseReply(igtl::MessageBase::Pointer message, CommandReply& reply)
 {
-  double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
-  while (1)
+  if (typeid(*message) == typeid(igtl::StringMessage))
+  {
+    // Process the command as v1/v2 string reply
+    igtl::StringMessage::Pointer strMsg = dynamic_cast<igtl::StringMessage*>(message.GetPointer());
+
+    if (vtkPlusCommand::IsReplyDeviceName(strMsg->GetDeviceName()))
+    {
+      if (igsioCommon::StringToInt<int32_t>(vtkPlusCommand::GetUidFromCommandDeviceName(strMsg->GetDeviceName()).c_str(), reply.OriginalCommandId) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to get UID from command device name.");
+        return PLUS_FAIL;
+      }
+    }
+    vtkSmartPointer<vtkXMLDataElement> cmdElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(strMsg->GetString()));
+    if (cmdElement == NULL)
+    {
+      LOG_ERROR("Unable to parse command reply as XML. Skipping.");
+      return PLUS_FAIL;
+    }
+    if (cmdElement->GetAttribute("Status") == NULL)
+    {
+      LOG_ERROR("No status returned. Skipping.");
+      return PLUS_FAIL;
+    }
+    reply.Status = std::string(cmdElement->GetAttribute("Status")) == "SUCCESS" ? PLUS_SUCCESS : PLUS_FAIL;
+    if (cmdElement->GetAttribute("Message") == NULL)
+    {
+      LOG_ERROR("No message returned. Skipping.");
+      return PLUS_FAIL;
+    }
+    reply.Content = cmdElement->GetAttribute("Message");
+  }
+  else if (typeid(*message) == typeid(igtl::RTSCommandMessage))
+  {
+    // Process the command as v3 RTS_Command
+    igtl::RTSCommandMessage::Pointer rtsCommandMsg = dynamic_cast<igtl::RTSCommandMessage*>(message.GetPointer());
+
+    reply.CommandName = rtsCommandMsg->GetCommandName();
+    reply.OriginalCommandId = rtsCommandMsg->GetCommandId();
+
+    vtkSmartPointer<vtkXMLDataElement> cmdElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(rtsCommandMsg->GetCommandContent().c_str()));
+    if (cmdElement == NULL)
+    {
+      LOG_ERROR("Unable to parse command reply as XML. Skipping.");
+      return PLUS_FAIL;
+    }
+
+    XML_FIND_NESTED_ELEMENT_OPTIONAL(resultElement, cmdElement, "Result");
+    if (resultElement != NULL)
+    {
+      reply.Status = STRCASECMP(resultElement->GetCharacterData(), "true") == 0 ? PLUS_SUCCESS : PLUS_FAIL;
+    }
+    XML_FIND_NESTED_ELEMENT_OPTIONAL(errorElement, cmdElement, "Error");
+    if (!reply.Status && errorElement == NULL)
+    {
+      LOG_ERROR("Server sent error without reason. Notify server developers.");
+    }
+    else if (!reply.Status && errorElement != NULL)
+    {
+      reply.ErrorString = errorElement->GetCharacterData();
+    }
+    XML_FIND_NESTED_ELEMENT_REQUIRED(messageElement, cmdElement, "Message");
+    reply.Content = messageElement->GetCharacterData();
+
+    reply.Parameters = rtsCommandMsg->GetMetaData();
+  }
+  else if (typeid(*message) == typeid(igtl::RTSTrackingDataMessage))
+  {
+    igtl::RTSTrackingDataMessage* rtsTrackingMsg = dynamic_cast<igtl::RTSTrackingDataMessage*>(message.GetPointer());
+
+    reply.Status = rtsTrackingMsg->GetStatus() == 0 ? PLUS_SUCCESS : PLUS_FAIL;
+    reply.Content = (rtsTrackingMsg->GetStatus() == 0 ? "SUCCESS" : "FAILURE");
+    reply.CommandName = "RTSTrackingDataMessage";
+    reply.OriginalCommandId = -1;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkClient::OnReplyReceived(igtl::MessageBase::Pointer message)
+{
+  CommandReply reply;
+  PlusStatus parseStatus = ParseReply(message, reply);
+  if (reply.OriginalCommandId >= 0)
   {
+    bool pending = false;
+    ProgressCallback progressCallback;
     {
-      // save command reply
       igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
-      if (!this->Replies.empty())
+      std::map<igtlUint32, PendingCommand>::iterator pendingIt = this->PendingCommands.find(static_cast<igtlUint32>(reply.OriginalCommandId));
+      if (pendingIt != this->PendingCommands.end())
       {
-        igtl::MessageBase::Pointer message = this->Replies.front();
-        if (typeid(*message) == typeid(igtl::StringMessage))
-        {
-          // Process the command as v1/v2 string reply
-          igtl::StringMessage::Pointer strMsg = dynamic_cast<igtl::StringMessage*>(message.GetPointer());
-
-          if (vtkPlusCommand::IsReplyDeviceName(strMsg->GetDeviceName()))
-          {
-            if (igsioCommon::StringToInt<int32_t>(vtkPlusCommand::GetUidFromCommandDeviceName(strMsg->GetDeviceName()).c_str(), outOriginalCommandId) != PLUS_SUCCESS)
-            {
-              LOG_ERROR("Failed to get UID from command device name.");
-              continue;
-            }
-          }
-          vtkSmartPointer<vtkXMLDataElement> cmdElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(strMsg->GetString()));
-          if (cmdElement == NULL)
-          {
-            LOG_ERROR("Unable to parse command reply as XML. Skipping.");
-            continue;
-          }
-          if (cmdElement->GetAttribute("Status") == NULL)
-          {
-            LOG_ERROR("No status returned. Skipping.");
-            continue;
-          }
-          result = std::string(cmdElement->GetAttribute("Status")) == "SUCCESS" ? PLUS_SUCCESS : PLUS_FAIL;
-          if (cmdElement->GetAttribute("Message") == NULL)
-          {
-            LOG_ERROR("No message returned. Skipping.");
-            continue;
-          }
-          outContent = cmdElement->GetAttribute("Message");
-        }
-        else if (typeid(*message) == typeid(igtl::RTSCommandMessage))
-        {
-          // Process the command as v3 RTS_Command
-          igtl::RTSCommandMessage::Pointer rtsCommandMsg = dynamic_cast<igtl::RTSCommandMessage*>(message.GetPointer());
-
-          vtkSmartPointer<vtkXMLDataElement> cmdElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(rtsCommandMsg->GetCommandContent().c_str()));
-
-          outCommandName = rtsCommandMsg->GetCommandName();
-          outOriginalCommandId = rtsCommandMsg->GetCommandId();
-
-          XML_FIND_NESTED_ELEMENT_OPTIONAL(resultElement, cmdElement, "Result");
-          if (resultElement != NULL)
-          {
-            result = STRCASECMP(resultElement->GetCharacterData(), "true") == 0 ? PLUS_SUCCESS : PLUS_FAIL;
-          }
-          XML_FIND_NESTED_ELEMENT_OPTIONAL(errorElement, cmdElement, "Error");
-          if (!result && errorElement == NULL)
-          {
-            LOG_ERROR("Server sent error without reason. Notify server developers.");
-          }
-          else if (!result && errorElement != NULL)
-          {
-            outErrorString = errorElement->GetCharacterData();
-          }
-          XML_FIND_NESTED_ELEMENT_REQUIRED(messageElement, cmdElement, "Message");
-          outContent = messageElement->GetCharacterData();
-
-          outParameters = rtsCommandMsg->GetMetaData();
-        }
-        else if (typeid(*message) == typeid(igtl::RTSTrackingDataMessage))
-        {
-          igtl::RTSTrackingDataMessage* rtsTrackingMsg = dynamic_cast<igtl::RTSTrackingDataMessage*>(message.GetPointer());
-
-          result = rtsTrackingMsg->GetStatus() == 0 ? PLUS_SUCCESS : PLUS_FAIL;
-          outContent = (rtsTrackingMsg->GetStatus() == 0 ? "SUCCESS" : "FAILURE");
-          outCommandName = "RTSTrackingDataMessage";
-          outOriginalCommandId = -1;
-        }
-
-        this->Replies.pop_front();
-        return PLUS_SUCCESS;
+        pending = true;
+        progressCallback = pendingIt->second.ProgressReportCallback;
       }
     }
-    if (vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec > timeoutSec)
+    igtl::MessageBase::MetaDataMap::const_iterator progressIt = reply.Parameters.find("Progress");
+    if (pending && parseStatus == PLUS_SUCCESS && progressIt != reply.Parameters.end())
+    {
+      // Progress report, the command stays pending until the final reply (that has no Progress parameter)
+      if (progressCallback)
+      {
+        double progressPercent = 0;
+        igsioCommon::StringToDouble(progressIt->second.second.c_str(), progressPercent);
+        progressCallback(progressPercent, reply);
+      }
+      return;
+    }
+    if (pending)
+    {
+      if (parseStatus != PLUS_SUCCESS)
+      {
+        // Do not let the command wait for a reply that has already arrived
+        reply.Status = PLUS_FAIL;
+        reply.ErrorString = "Invalid reply received from server";
+      }
+      this->CompletePendingCommand(static_cast<igtlUint32>(reply.OriginalCommandId), reply);
+      return;
+    }
+  }
+
+  // save command reply, the queue keeps a reference until the reply is received
+  message->Register();
+  if (this->Replies->PushMessage(message) != PLUS_SUCCESS)
+  {
+    message->UnRegister();
+    LOG_WARNING("Too many command replies are waiting to be received, reply is dropped");
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkClient::ReceiveReply(PlusStatus& result, int32_t& outOriginalCommandId, std::string& outErrorString,
+    std::string& outContent, igtl::MessageBase::MetaDataMap& outParameters,
+    std::string& outCommandName, double timeoutSec/*=0*/)
+{
+  double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+  while (1)
+  {
+    // Wait for the reply instead of polling, the receiver thread wakes us up when it pushes a reply
+    double remainingSec = timeoutSec - (vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec);
+    igtl::MessageBase* receivedMessage = this->Replies->PullMessage(remainingSec);
+    if (receivedMessage == NULL)
     {
       LOG_DEBUG("vtkPlusOpenIGTLinkClient::ReceiveReply timeout passed (" << timeoutSec << "sec)");
       return PLUS_FAIL;
     }
-    vtkIGSIOAccurateTimer::Delay(0.010);
+    // Take over the reference that was kept while the message was in the queue
+    igtl::MessageBase::Pointer message = receivedMessage;
+    receivedMessage->UnRegister();
+
+    CommandReply reply;
+    reply.Status = result;
+    if (ParseReply(message, reply) != PLUS_SUCCESS)
+    {
+      // Invalid reply, try the next one
+      continue;
+    }
+    result = reply.Status;
+    if (reply.OriginalCommandId >= 0)
+    {
+      outOriginalCommandId = reply.OriginalCommandId;
+    }
+    if (!reply.ErrorString.empty())
+    {
+      outErrorString = reply.ErrorString;
+    }
+    outContent = reply.Content;
+    if (typeid(*message) == typeid(igtl::RTSCommandMessage))
+    {
+      outParameters = reply.Parameters;
+    }
+    if (!reply.CommandName.empty())
+    {
+      outCommandName = reply.CommandName;
+    }
+    return PLUS_SUCCESS;
   }
   return PLUS_FAIL;
 }
@@ -371,11 +703,7 @@ void* vtkPlusOpenIGTLinkClient::DataReceiverThread(vtkMultiThreader::ThreadInfo*
         LOG_ERROR("Failed to receive reply (invalid body)");
         continue;
       }
-      {
-        // save command reply
-        igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(self->Mutex);
-        self->Replies.push_back(bodyMsg);
-      }
+      self->OnReplyReceived(bodyMsg);
     }
     else if (typeid(*bodyMsg) == typeid(igtl::RTSTrackingDataMessage))
     {
@@ -392,11 +720,7 @@ void* vtkPlusOpenIGTLinkClient::DataReceiverThread(vtkMultiThreader::ThreadInfo*
         LOG_ERROR("Failed to receive reply (invalid body)");
         continue;
       }
-      {
-        // save command reply
-        igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(self->Mutex);
-        self->Replies.push_back(bodyMsg);
-      }
+      self->OnReplyReceived(bodyMsg);
     }
     else
     {
@@ -11,6 +11,7 @@
 
 // Local includes
 #include "vtkPlusCommand.h"
+#include "vtkPlusIGTLMessageQueue.h"
 #include "vtkPlusIgtlMessageFactory.h"
 
 // OpenIGTLink includes
@@ -23,8 +24,12 @@
 #include <vtkObject.h>
 
 // STL includes
-#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 class vtkMultiThreader;
 class vtkIGSIORecursiveCriticalSection;
@@ -35,11 +40,44 @@ class vtkIGSIORecursiveCriticalSection;
 
   It connects to a Plus server, sends requests and receives responses.
 
+  Commands can be sent synchronously (SendCommand then ReceiveReply) or asynchronously (SendCommandAsync, SendCommands):
+  asynchronous commands do not wait for the reply of the previous command, many commands can be in flight at the same time.
+  Their replies are matched by command UID and delivered through a future and an optional callback.
+  Progress reports of a command (replies with a Progress parameter, see vtkPlusCommand::ReportProgress) keep the command
+  pending and are delivered through an optional progress callback, the future is completed by the final reply.
+
   \ingroup PlusLibPlusServer
 */
 class vtkPlusServerExport vtkPlusOpenIGTLinkClient : public vtkObject
 {
 public:
+  /*! Reply to a command sent by SendCommandAsync or SendCommands */
+  struct CommandReply
+  {
+    /*! Result of the command. PLUS_FAIL if the command failed, or it could not be sent, or no reply was received. */
+    PlusStatus Status;
+    int32_t OriginalCommandId;
+    std::string CommandName;
+    std::string ErrorString;
+    std::string Content;
+    igtl::MessageBase::MetaDataMap Parameters;
+    CommandReply()
+      : Status(PLUS_FAIL)
+      , OriginalCommandId(-1)
+    {
+    }
+  };
+
+  /*! Function called with the reply of an asynchronous command. It is called from the data receiver thread. */
+  typedef std::function<void(const CommandReply&)> ReplyCallback;
+
+  /*!
+    Function called with each progress report of an asynchronous command, before the final reply is received.
+    The reply contains the progress message in Content and the percentage in the Progress parameter.
+    It is called from the data receiver thread.
+  */
+  typedef std::function<void(double progressPercent, const CommandReply&)> ProgressCallback;
+
   static vtkPlusOpenIGTLinkClient* New();
   vtkTypeMacro(vtkPlusOpenIGTLinkClient, vtkObject);
   virtual void PrintSelf(ostream& os, vtkIndent indent);
@@ -62,6 +100,35 @@ public:
   /*! Send a command to the connected server */
   PlusStatus SendCommand(vtkPlusCommand* command);
 
+  /*!
+    Send a command to the connected server without waiting for the reply.
+    If the command has no ID then a unique ID is assigned, which is used for matching the reply.
+    The returned future is always valid: if the command cannot be sent or the client is disconnected before the reply
+    is received then the reply has PLUS_FAIL status and its ErrorString describes the problem.
+    The callback (if specified) is called when the reply is available.
+    The progress callback (if specified) is called with each progress report that is received before the reply.
+  */
+  std::shared_future<CommandReply> SendCommandAsync(vtkPlusCommand* command, ReplyCallback callback = ReplyCallback(), ProgressCallback progressCallback = ProgressCallback());
+
+  /*!
+    Send a command that is specified by its name and its XML representation (Command element, as written by
+    vtkPlusCommand::WriteConfiguration) to the connected server without waiting for the reply. See SendCommandAsync.
+  */
+  std::shared_future<CommandReply> SendCommandAsync(const std::string& commandName, const std::string& commandXml, uint32_t commandId = 0, ReplyCallback callback = ReplyCallback(),
+      ProgressCallback progressCallback = ProgressCallback());
+
+  /*!
+    Send multiple commands to the connected server without waiting for replies between them.
+    The replies are returned in the same order as the commands. Returns PLUS_FAIL if any of the commands could not be sent.
+  */
+  PlusStatus SendCommands(const std::vector<vtkPlusCommand*>& commands, std::vector<std::shared_future<CommandReply> >& replies);
+
+  /*! Wait until all the replies are available. Returns PLUS_FAIL if any of the replies is not received within timeoutSec. */
+  static PlusStatus WaitForReplies(const std::vector<std::shared_future<CommandReply> >& replies, double timeoutSec);
+
+  /*! Number of asynchronous commands that are waiting for a reply */
+  int GetNumberOfPendingCommands();
+
   /*! Send a packed message to the connected server */
   PlusStatus SendMessage(igtl::MessageBase::Pointer packedMessage);
 
@@ -97,6 +164,35 @@ protected:
   /*! Thread-safe method that allows child classes to read data from the socket */
   int SocketReceive(void* data, int length);
 
+  /*! Get the XML representation of the command that is sent to the server */
+  static std::string GetCommandXml(vtkPlusCommand* command);
+
+  /*! Create a packed COMMAND (or STRING, if the server uses header version 1) message for the command */
+  PlusStatus PackCommandMessage(const std::string& commandName, const std::string& commandXml, igtlUint32 commandUid, igtl::MessageBase::Pointer& message);
+
+  /*! Get reply data from a received reply message */
+  static PlusStatus ParseReply(igtl::MessageBase::Pointer message, CommandReply& reply);
+
+  /*!
+    Register the pending command and create its packed message. If the command cannot be registered or packed then
+    the reply is completed with failure and PLUS_FAIL is returned.
+  */
+  PlusStatus PrepareAsyncCommand(const std::string& commandName, const std::string& commandXml, uint32_t commandId, ReplyCallback callback,
+                                 ProgressCallback progressCallback, igtl::MessageBase::Pointer& message, igtlUint32& commandUid, std::shared_future<CommandReply>& reply);
+
+  /*!
+    Deliver the reply to the pending command that it belongs to. Progress reports are passed to the progress callback
+    of the command, which stays pending until its final reply.
+    Replies that do not belong to any pending command are stored for ReceiveReply.
+  */
+  void OnReplyReceived(igtl::MessageBase::Pointer message);
+
+  /*! Remove a pending command and set its reply */
+  void CompletePendingCommand(igtlUint32 commandUid, const CommandReply& reply);
+
+  /*! Complete all pending commands with failure */
+  void CancelPendingCommands(const std::string& errorString);
+
   /*! Thread for receiving control data from clients */
   static void* DataReceiverThread(vtkMultiThreader::ThreadInfo* data);
 
@@ -119,7 +215,21 @@ protected:
 
   igtlUint32                                        LastGeneratedCommandId;
 
-  std::deque<igtl::MessageBase::Pointer>            Replies;
+  /*!
+    Replies that do not belong to any pending command, waiting for ReceiveReply. The receiver thread hands them off
+    without locking. A message holds a reference (Register) while it is in the queue.
+  */
+  vtkSmartPointer<vtkPlusIGTLMessageQueue>          Replies;
+
+  struct PendingCommand
+  {
+    std::shared_ptr<std::promise<CommandReply> >    Promise;
+    ReplyCallback                                   Callback;
+    ProgressCallback                                ProgressReportCallback;
+  };
+
+  /*! Asynchronous commands that are waiting for reply, by command UID. Protected by Mutex. */
+  std::map<igtlUint32, PendingCommand>              PendingCommands;
 
   int                                               ServerPort;
   std::string                                       ServerHost;
@@ -8,6 +8,9 @@ See License.txt for details.
 #include "PlusConfigure.h"
 #include "PlusCommon.h"
 #include "PlusConfigure.h"
+#include "PlusLatencyTracer.h"
+#include "PlusMetricsRegistry.h"
+#include "PlusProfiler.h"
 #include "igsioTrackedFrame.h"
 #include "vtkPlusChannel.h"
 #include "vtkPlusCommand.h"
@@ -15,7 +18,10 @@ See License.txt for details.
 #include "vtkPlusDataCollector.h"
 #include "vtkPlusIgtlMessageCommon.h"
 #include "vtkPlusIgtlMessageFactory.h"
+#include "vtkPlusOpenIGTLinkDevice.h"
 #include "vtkPlusOpenIGTLinkServer.h"
+#include "vtkPlusUsDevice.h"
+#include "vtkPlusUsImagingParameters.h"
 #include "vtkIGSIORecursiveCriticalSection.h"
 #include "vtkIGSIOTrackedFrameList.h"
 #include "vtkIGSIOTransformRepository.h"
@@ -25,7 +31,6 @@ See License.txt for details.
 #include <vtkObjectFactory.h>
 #include <vtkPoints.h>
 #include <vtkPolyData.h>
-#include <vtkPolyDataReader.h>
 
 // OpenIGTLink includes
 #include <igtlCommandMessage.h>
@@ -51,23 +56,270 @@ See License.txt for details.
 #endif
 
 // STL includes
+#include <algorithm>
 #include <fstream>
+#include <sstream>
 #include <streambuf>
 
 namespace
 {
   const double DELAY_ON_SENDING_ERROR_SEC = 0.02;
   const double DELAY_ON_NO_NEW_FRAMES_SEC = 0.005;
+  const double DELAY_ON_NO_NEW_FRAMES_MULTIPLE_CHANNELS_SEC = 0.001;
   const int NUMBER_OF_RECENT_COMMAND_IDS_STORED = 10;
-  const int IGTL_EMPTY_DATA_SIZE = -1;
+  /// Maximum number of bytes requested from a client socket at once
+  const igtlUint64 MAX_RECEIVE_SIZE = 1 << 20;
   const double SERVER_START_CHECK_DELAY_SEC = 2.0;
   const double SERVER_START_CHECK_DELAY_INTERVAL_SEC = 0.05;
+  const double DELAY_ON_POLLING_ERROR_SEC = 0.1;
+  // Packing large replies (images, polydata) must not delay the already packed replies more than this
+  const double MAX_COMMAND_RESPONSE_BATCH_DELAY_SEC = 0.005;
+
+  //----------------------------------------------------------------------------
+  // Thread names in the thread CPU time metrics
+  const char* DATA_SENDER_THREAD_NAME = "PlusServerDataSender";
+  const char* CONNECTION_RECEIVER_THREAD_NAME = "PlusServerConnectionReceiver";
+
+  //----------------------------------------------------------------------------
+  // Metrics HTTP requests are small and scrapers send them at once, so a short timeout is enough
+  const int METRICS_HTTP_TIMEOUT_MS = 1000;
+  const size_t METRICS_HTTP_MAX_REQUEST_HEADER_SIZE = 8192;
+
+  //----------------------------------------------------------------------------
+  /*! Receive the request line and headers of an HTTP request (the request body is not used) */
+  PlusStatus ReceiveHttpRequestHeader(igtl::Socket* socket, std::string& requestHeader)
+  {
+    requestHeader.clear();
+    while (requestHeader.size() < METRICS_HTTP_MAX_REQUEST_HEADER_SIZE)
+    {
+      char c = 0;
+      if (socket->Receive(&c, 1) != 1)
+      {
+        return PLUS_FAIL;
+      }
+      requestHeader += c;
+      if (requestHeader.size() >= 4 && requestHeader.compare(requestHeader.size() - 4, 4, "\r\n\r\n") == 0)
+      {
+        return PLUS_SUCCESS;
+      }
+    }
+    return PLUS_FAIL;
+  }
+
+  //----------------------------------------------------------------------------
+  std::string CreateHttpResponse(const std::string& status, const std::string& contentType, const std::string& body)
+  {
+    std::ostringstream response;
+    response << "HTTP/1.1 " << status << "\r\n"
+             << "Content-Type: " << contentType << "\r\n"
+             << "Content-Length: " << body.size() << "\r\n"
+             << "Connection: close\r\n"
+             << "\r\n"
+             << body;
+    return response.str();
+  }
+
+  //----------------------------------------------------------------------------
+  // Adaptive streaming quality is updated after each ADAPTIVE_STREAMING_INTERVAL_SEC long measurement.
+  // Quality is increased only after ADAPTIVE_STREAMING_STABLE_INTERVALS consecutive intervals without dropped frames,
+  // so that the quality does not oscillate when the throughput is close to the limit.
+  const double ADAPTIVE_STREAMING_INTERVAL_SEC = 1.0;
+  const int ADAPTIVE_STREAMING_STABLE_INTERVALS = 5;
 
   //----------------------------------------------------------------------------
   // If a frame cannot be retrieved from the device buffers (because it was overwritten by new frames)
   // then we skip a SAMPLING_SKIPPING_MARGIN_SEC long period to allow the application to catch up.
   // This time should be long enough to comfortably retrieve a frame from the buffer.
   const double SAMPLING_SKIPPING_MARGIN_SEC = 0.1;
+
+  //----------------------------------------------------------------------------
+  // igtl::Socket does not provide public access to the socket descriptor,
+  // which is needed for waiting for events on multiple sockets and for sending without blocking.
+  class SocketDescriptorAccessor : public igtl::Socket
+  {
+  public:
+    static int GetSocketDescriptor(igtl::Socket* socket)
+    {
+      return socket->*(&SocketDescriptorAccessor::m_SocketDescriptor);
+    }
+  };
+
+  //----------------------------------------------------------------------------
+  // Client classes of the SocketOptions elements
+  const char* TRACKING_CLIENT_CLASS = "Tracking";
+  const char* IMAGING_CLIENT_CLASS = "Imaging";
+
+  //----------------------------------------------------------------------------
+  /*! Clients that request any image messages belong to the Imaging class, other clients to the Tracking class */
+  std::string GetSocketOptionsClientClass(const PlusIgtlClientInfo& clientInfo)
+  {
+    const char* imageMessageTypes[] = { "IMAGE", "CIMAGE", "VIDEO", "USMESSAGE", "TRACKEDFRAME" };
+    for (std::vector<std::string>::const_iterator messageTypeIt = clientInfo.IgtlMessageTypes.begin(); messageTypeIt != clientInfo.IgtlMessageTypes.end(); ++messageTypeIt)
+    {
+      for (size_t i = 0; i < sizeof(imageMessageTypes) / sizeof(imageMessageTypes[0]); ++i)
+      {
+        if (igsioCommon::IsEqualInsensitive(*messageTypeIt, imageMessageTypes[i]))
+        {
+          return IMAGING_CLIENT_CLASS;
+        }
+      }
+    }
+    return TRACKING_CLIENT_CLASS;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Read a boolean socket option attribute: 1 if TRUE, 0 if FALSE, unchanged if not specified */
+  PlusStatus ReadSocketOptionFlag(vtkXMLDataElement* element, const char* attributeName, int& flag)
+  {
+    const char* value = element->GetAttribute(attributeName);
+    if (value == NULL)
+    {
+      return PLUS_SUCCESS;
+    }
+    if (STRCASECMP(value, "TRUE") == 0)
+    {
+      flag = 1;
+    }
+    else if (STRCASECMP(value, "FALSE") == 0)
+    {
+      flag = 0;
+    }
+    else
+    {
+      LOG_ERROR("Invalid " << attributeName << " attribute value in SocketOptions element: " << value << " (expected TRUE or FALSE)");
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Set the specified options on the socket. Options that cannot be set are logged, the others are still set. */
+  void SetSocketOptions(int socketDescriptor, const vtkPlusOpenIGTLinkServer::SocketOptions& options, const std::string& socketName)
+  {
+    struct SocketOptionValue
+    {
+      const char* Name;
+      int Level;
+      int OptionName;
+      int Value;
+    };
+    std::vector<SocketOptionValue> optionValues;
+    if (options.TcpNoDelay >= 0)
+    {
+      SocketOptionValue optionValue = { "TcpNoDelay", IPPROTO_TCP, TCP_NODELAY, options.TcpNoDelay };
+      optionValues.push_back(optionValue);
+    }
+    if (options.TcpQuickAck >= 0)
+    {
+#ifdef TCP_QUICKACK
+      SocketOptionValue optionValue = { "TcpQuickAck", IPPROTO_TCP, TCP_QUICKACK, options.TcpQuickAck };
+      optionValues.push_back(optionValue);
+#else
+      LOG_WARNING("TcpQuickAck socket option is not supported on this platform, it is ignored for " << socketName);
+#endif
+    }
+    if (options.KeepAlive >= 0)
+    {
+      SocketOptionValue optionValue = { "KeepAlive", SOL_SOCKET, SO_KEEPALIVE, options.KeepAlive };
+      optionValues.push_back(optionValue);
+    }
+    if (options.KeepAliveIdleSec >= 0)
+    {
+#if defined(TCP_KEEPIDLE)
+      SocketOptionValue optionValue = { "KeepAliveIdleSec", IPPROTO_TCP, TCP_KEEPIDLE, options.KeepAliveIdleSec };
+      optionValues.push_back(optionValue);
+#elif defined(TCP_KEEPALIVE)
+      // macOS name of the same option
+      SocketOptionValue optionValue = { "KeepAliveIdleSec", IPPROTO_TCP, TCP_KEEPALIVE, options.KeepAliveIdleSec };
+      optionValues.push_back(optionValue);
+#else
+      LOG_WARNING("KeepAliveIdleSec socket option is not supported on this platform, it is ignored for " << socketName);
+#endif
+    }
+    if (options.SendBufferSize >= 0)
+    {
+      SocketOptionValue optionValue = { "SendBufferSize", SOL_SOCKET, SO_SNDBUF, options.SendBufferSize };
+      optionValues.push_back(optionValue);
+    }
+    if (options.ReceiveBufferSize >= 0)
+    {
+      SocketOptionValue optionValue = { "ReceiveBufferSize", SOL_SOCKET, SO_RCVBUF, options.ReceiveBufferSize };
+      optionValues.push_back(optionValue);
+    }
+    if (options.Dscp >= 0)
+    {
+      // The DSCP is the upper 6 bits of the former type of service field
+      SocketOptionValue optionValue = { "Dscp", IPPROTO_IP, IP_TOS, options.Dscp << 2 };
+      optionValues.push_back(optionValue);
+    }
+
+    for (std::vector<SocketOptionValue>::iterator optionValueIt = optionValues.begin(); optionValueIt != optionValues.end(); ++optionValueIt)
+    {
+      std::string errorMessage;
+      if (SetIntegerSocketOption(socketDescriptor, optionValueIt->Level, optionValueIt->OptionName, optionValueIt->Value, errorMessage) != PLUS_SUCCESS)
+      {
+        LOG_WARNING("Failed to set " << optionValueIt->Name << " socket option of " << socketName << ": " << errorMessage);
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Number of bytes queued for the client that have not been accepted by the socket yet */
+  size_t GetSendBacklogBytes(const ClientData& client)
+  {
+    size_t backlogBytes = client.PendingSendData.size();
+    for (std::deque<ClientData::SendQueueItem>::const_iterator itemIt = client.SendQueue.begin(); itemIt != client.SendQueue.end(); ++itemIt)
+    {
+      for (std::vector<igtl::MessageBase::Pointer>::const_iterator messageIt = itemIt->Messages.begin(); messageIt != itemIt->Messages.end(); ++messageIt)
+      {
+        backlogBytes += (*messageIt)->GetBufferSize();
+      }
+    }
+    return backlogBytes;
+  }
+
+  //----------------------------------------------------------------------------
+  /*!
+    Returns true if the relayed message of the tracked frame is forwarded to the client instead of packing the message from
+    the tracked frame: the client is subscribed to the message type (and to the image stream of IMAGE and CIMAGE messages),
+    supports the header version of the message, the image is due and it is not clipped or downscaled for the client.
+  */
+  bool IsRelayedMessageRequested(const PlusIgtlClientInfo& clientInfo, igtl::MessageBase* relayedMessage, double timestampUniversal)
+  {
+    if (relayedMessage->GetHeaderVersion() > clientInfo.GetClientHeaderVersion())
+    {
+      return false;
+    }
+    std::string messageType = relayedMessage->GetMessageType();
+    bool messageTypeRequested = false;
+    for (std::vector<std::string>::const_iterator messageTypeIt = clientInfo.IgtlMessageTypes.begin(); messageTypeIt != clientInfo.IgtlMessageTypes.end(); ++messageTypeIt)
+    {
+      if (igsioCommon::IsEqualInsensitive(*messageTypeIt, messageType))
+      {
+        messageTypeRequested = true;
+        break;
+      }
+    }
+    if (!messageTypeRequested
+        || !clientInfo.IsImageFrameDue(timestampUniversal)
+        || clientInfo.GetEffectiveImageDownscaleFactor() != 1
+        || clientInfo.ImageStreamingOptions.IsClipRectangleDefined())
+    {
+      return false;
+    }
+    if (igsioCommon::IsEqualInsensitive(messageType, "TRACKEDFRAME"))
+    {
+      return true;
+    }
+    for (std::vector<PlusIgtlClientInfo::ImageStream>::const_iterator imageStreamIt = clientInfo.ImageStreams.begin(); imageStreamIt != clientInfo.ImageStreams.end(); ++imageStreamIt)
+    {
+      if (imageStreamIt->Name == relayedMessage->GetDeviceName())
+      {
+        return true;
+      }
+    }
+    return false;
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -75,6 +327,7 @@ namespace
 vtkStandardNewMacro(vtkPlusOpenIGTLinkServer);
 int vtkPlusOpenIGTLinkServer::ClientIdCounter = 1;
 const float vtkPlusOpenIGTLinkServer::CLIENT_SOCKET_TIMEOUT_SEC = 0.5f;
+const int vtkPlusOpenIGTLinkServer::UDP_OUTPUT_CLIENT_ID = -1;
 
 //----------------------------------------------------------------------------
 vtkPlusOpenIGTLinkServer::vtkPlusOpenIGTLinkServer()
@@ -88,28 +341,63 @@ vtkPlusOpenIGTLinkServer::vtkPlusOpenIGTLinkServer()
   , NumberOfRetryAttempts(10)
   , DelayBetweenRetryAttemptsSec(0.05)
   , MaxNumberOfIgtlMessagesToSend(100)
+  , MaxNumberOfQueuedFramesPerClient(2)
+  , OverloadClientQualityLevel(1)
+  , ClientStreamRateReducedForOverload(false)
+  , OverloadPolicyHandlerId(0)
+  , NumberOfImageCompressionThreads(1)
+  , NumberOfCommandExecutionThreads(0)
+  , MetricsHttpPort(0)
+  , MetricsCollectorId(0)
+  , MemoryReporterId(0)
   , ConnectionReceiverThreadId(-1)
   , DataSenderThreadId(-1)
+  , MetricsHttpThreadId(-1)
   , IgtlMessageFactory(vtkSmartPointer<vtkPlusIgtlMessageFactory>::New())
   , IgtlClientsMutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
-  , LastSentTrackedFrameTimestamp(0)
+  , PolydataCache(vtkSmartPointer<vtkPlusPolydataCache>::New())
   , MaxTimeSpentWithProcessingMs(50)
   , LastProcessingTimePerFrameMs(-1)
   , SendValidTransformsOnly(true)
   , DefaultClientSendTimeoutSec(CLIENT_SOCKET_TIMEOUT_SEC)
   , DefaultClientReceiveTimeoutSec(CLIENT_SOCKET_TIMEOUT_SEC)
+  , UdpOutputPort(0)
+  , UdpOutputMulticastTtl(1)
   , IgtlMessageCrcCheckEnabled(0)
   , PlusCommandProcessor(vtkSmartPointer<vtkPlusCommandProcessor>::New())
   , MessageResponseQueueMutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
-  , BroadcastChannel(NULL)
   , LogWarningOnNoDataAvailable(true)
   , KeepAliveIntervalSec(CLIENT_SOCKET_TIMEOUT_SEC / 2.0)
   , GracePeriodLogLevel(vtkPlusLogger::LOG_LEVEL_DEBUG)
   , MissingInputGracePeriodSec(0.0)
   , BroadcastStartTime(0.0)
-  , NewClientConnected(false)
 {
+  // All the messages of a frame are written at once, therefore delaying the last partial segment would only increase the latency
+  this->DefaultSocketOptions.TcpNoDelay = 1;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusOpenIGTLinkServer::SocketOptions::SocketOptions()
+  : TcpNoDelay(-1)
+  , TcpQuickAck(-1)
+  , KeepAlive(-1)
+  , KeepAliveIdleSec(-1)
+  , SendBufferSize(-1)
+  , ReceiveBufferSize(-1)
+  , Dscp(-1)
+{
+}
 
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::SocketOptions::Merge(const SocketOptions& other)
+{
+  this->TcpNoDelay = (other.TcpNoDelay >= 0 ? other.TcpNoDelay : this->TcpNoDelay);
+  this->TcpQuickAck = (other.TcpQuickAck >= 0 ? other.TcpQuickAck : this->TcpQuickAck);
+  this->KeepAlive = (other.KeepAlive >= 0 ? other.KeepAlive : this->KeepAlive);
+  this->KeepAliveIdleSec = (other.KeepAliveIdleSec >= 0 ? other.KeepAliveIdleSec : this->KeepAliveIdleSec);
+  this->SendBufferSize = (other.SendBufferSize >= 0 ? other.SendBufferSize : this->SendBufferSize);
+  this->ReceiveBufferSize = (other.ReceiveBufferSize >= 0 ? other.ReceiveBufferSize : this->ReceiveBufferSize);
+  this->Dscp = (other.Dscp >= 0 ? other.Dscp : this->Dscp);
 }
 
 //----------------------------------------------------------------------------
@@ -170,12 +458,56 @@ PlusStatus vtkPlusOpenIGTLinkServer::StartOpenIGTLinkService()
     this->ConnectionReceiverThreadId = this->Threader->SpawnThread((vtkThreadFunctionType)&ConnectionReceiverThread, this);
   }
 
+  this->IgtlMessageFactory->SetNumberOfImageCompressionThreads(static_cast<unsigned int>(std::max(this->NumberOfImageCompressionThreads, 1)));
+
+  if (this->UdpOutputPort > 0 && !this->UdpOutputSocket.IsOpen())
+  {
+    if (this->UdpOutputSocket.OpenForSending(this->UdpOutputAddress, this->UdpOutputPort, this->UdpOutputMulticastTtl) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Unable to open UDP output to " << this->UdpOutputAddress << ":" << this->UdpOutputPort);
+      return PLUS_FAIL;
+    }
+    LOG_INFO("Plus OpenIGTLink server streams tracking data in UDP datagrams to " << this->UdpOutputAddress << ":" << this->UdpOutputPort
+             << (IgtlUdpSocket::IsMulticastAddress(this->UdpOutputAddress) ? " (multicast)" : ""));
+  }
+
   if (this->DataSenderThreadId < 0)
   {
     this->DataSenderActive.Request = true;
     this->DataSenderThreadId = this->Threader->SpawnThread((vtkThreadFunctionType)&DataSenderThread, this);
   }
 
+  if (this->MetricsCollectorId == 0)
+  {
+    this->MetricsCollectorId = MetricsRegistry::GetInstance().AddCollector([this](std::vector<MetricsRegistry::Sample>& samples)
+    {
+      this->CollectMetrics(samples);
+    });
+  }
+
+  if (this->MemoryReporterId == 0)
+  {
+    this->MemoryReporterId = MemoryAccounting::GetInstance().AddReporter([this](std::vector<MemoryAccounting::Usage>& usages)
+    {
+      this->GetMemoryUsage(usages);
+    });
+  }
+
+  if (this->OverloadPolicyHandlerId == 0)
+  {
+    this->OverloadPolicyHandlerId = OverloadManager::GetInstance().AddPolicyHandler(OverloadManager::POLICY_REDUCE_CLIENT_STREAM_RATE, [this](bool apply)
+    {
+      LOG_INFO("Image streaming quality of all clients is " << (apply ? "reduced because the system is overloaded" : "restored"));
+      this->ClientStreamRateReducedForOverload = apply;
+    });
+  }
+
+  if (this->MetricsHttpPort > 0 && this->MetricsHttpThreadId < 0)
+  {
+    this->MetricsHttpActive.Request = true;
+    this->MetricsHttpThreadId = this->Threader->SpawnThread((vtkThreadFunctionType)&MetricsHttpThread, this);
+  }
+
   // Wait a short duration to see if both threads initialized properly, check at 50ms interval
   RETRY_UNTIL_TRUE(this->ConnectionActive.Respond,
                    vtkMath::Round(SERVER_START_CHECK_DELAY_SEC / SERVER_START_CHECK_DELAY_INTERVAL_SEC),
@@ -192,6 +524,15 @@ PlusStatus vtkPlusOpenIGTLinkServer::StartOpenIGTLinkService()
   LOG_DEBUG(ss.str());
 
   this->PlusCommandProcessor->SetPlusServer(this);
+  if (this->NumberOfCommandExecutionThreads > 0)
+  {
+    this->PlusCommandProcessor->SetNumberOfThreads(this->NumberOfCommandExecutionThreads);
+    if (this->PlusCommandProcessor->Start() != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Unable to start command execution threads.");
+      return PLUS_FAIL;
+    }
+  }
 
   this->BroadcastStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
 
@@ -201,6 +542,41 @@ PlusStatus vtkPlusOpenIGTLinkServer::StartOpenIGTLinkService()
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusOpenIGTLinkServer::StopOpenIGTLinkService()
 {
+  // Complete the commands that are being executed while the responses can still be sent
+  this->PlusCommandProcessor->Stop();
+
+  // Stop metrics HTTP thread
+  if (this->MetricsHttpThreadId >= 0)
+  {
+    this->MetricsHttpActive.Request = false;
+    while (this->MetricsHttpActive.Respond)
+    {
+      // Wait until the thread stops
+      vtkIGSIOAccurateTimer::DelayWithEventProcessing(0.2);
+    }
+    this->MetricsHttpThreadId = -1;
+    LOG_DEBUG("MetricsHttpThread stopped");
+  }
+
+  if (this->MetricsCollectorId != 0)
+  {
+    MetricsRegistry::GetInstance().RemoveCollector(this->MetricsCollectorId);
+    this->MetricsCollectorId = 0;
+  }
+
+  if (this->MemoryReporterId != 0)
+  {
+    MemoryAccounting::GetInstance().RemoveReporter(this->MemoryReporterId);
+    this->MemoryReporterId = 0;
+  }
+
+  if (this->OverloadPolicyHandlerId != 0)
+  {
+    OverloadManager::GetInstance().RemovePolicyHandler(this->OverloadPolicyHandlerId);
+    this->OverloadPolicyHandlerId = 0;
+    this->ClientStreamRateReducedForOverload = false;
+  }
+
   // Stop connection receiver thread
   if (this->ConnectionReceiverThreadId >= 0)
   {
@@ -238,6 +614,8 @@ PlusStatus vtkPlusOpenIGTLinkServer::StopOpenIGTLinkService()
 void* vtkPlusOpenIGTLinkServer::ConnectionReceiverThread(vtkMultiThreader::ThreadInfo* data)
 {
   vtkPlusOpenIGTLinkServer* self = (vtkPlusOpenIGTLinkServer*)(data->UserData);
+  PLUS_PROFILE_THREAD_NAME("OpenIGTLinkServer:" + igsioCommon::ToString<int>(self->ListeningPort) + " receiver");
+  self->ThreadSettings.ApplyToCurrentThread("OpenIGTLinkServer:" + igsioCommon::ToString<int>(self->ListeningPort) + " receiver");
 
   int r = self->ServerSocket->CreateServer(self->ListeningPort);
   if (r < 0)
@@ -246,60 +624,111 @@ void* vtkPlusOpenIGTLinkServer::ConnectionReceiverThread(vtkMultiThreader::Threa
     return NULL;
   }
 
+  SocketPoller poller;
+  int serverSocketDescriptor = SocketDescriptorAccessor::GetSocketDescriptor(self->ServerSocket);
+  if (self->DefaultSocketOptions.ReceiveBufferSize >= 0)
+  {
+    // Accepted sockets inherit the receive buffer size of the listening socket. The TCP window scale is negotiated
+    // during connection setup, so a large receive buffer set after the connection is accepted could not be fully used.
+    vtkPlusOpenIGTLinkServer::SocketOptions listeningSocketOptions;
+    listeningSocketOptions.ReceiveBufferSize = self->DefaultSocketOptions.ReceiveBufferSize;
+    SetSocketOptions(serverSocketDescriptor, listeningSocketOptions, "the server socket");
+  }
+  if (!poller.IsValid() || poller.AddSocket(serverSocketDescriptor) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Cannot wait for connections on the server socket.");
+    self->ServerSocket->CloseSocket();
+    return NULL;
+  }
+
   PrintServerInfo(self);
 
   self->ConnectionActive.Respond = true;
 
-  // Wait for connections until we want to stop the thread
+  std::shared_ptr<MetricsRegistry::Metric> cpuTimeMetric = MetricsRegistry::GetInstance().GetThreadCpuTimeMetric(CONNECTION_RECEIVER_THREAD_NAME);
+
+  // Socket descriptors of the clients that are registered in the poller
+  std::map<int, int> polledClientSocketDescriptors;
+  std::vector<int> readySocketDescriptors;
+
+  // Wait for connections and messages until we want to stop the thread
   while (self->ConnectionActive.Request)
   {
-    igtl::ClientSocket::Pointer newClientSocket = self->ServerSocket->WaitForConnection(CLIENT_SOCKET_TIMEOUT_SEC * 1000);
-    if (newClientSocket.IsNotNull())
+    cpuTimeMetric->Set(MetricsRegistry::GetCurrentThreadCpuTimeSec());
     {
-      // Lock before we change the clients list
+      // Update the polled sockets: clients may have been connected or disconnected (e.g., by the sender thread) since the last wait.
+      // Sockets of removed clients are unregistered first, as a new client may have received the same socket descriptor.
       igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self->IgtlClientsMutex);
-      ClientData newClient;
-      self->IgtlClients.push_back(newClient);
-      self->NewClientConnected = true;
-
-      ClientData* client = &(self->IgtlClients.back());   // get a reference to the client data that is stored in the list
-      client->ClientId = self->ClientIdCounter;
-      self->ClientIdCounter++;
-      client->ClientSocket = newClientSocket;
-      client->ClientSocket->SetReceiveTimeout(self->DefaultClientReceiveTimeoutSec * 1000);
-      client->ClientSocket->SetSendTimeout(self->DefaultClientSendTimeoutSec * 1000);
-      client->ClientInfo = self->DefaultClientInfo;
-      client->Server = self;
-
-      // Setup vtkIGSIOFrameConverters for each stream
-      for (std::vector<PlusIgtlClientInfo::ImageStream>::iterator imageStreamIterator = client->ClientInfo.ImageStreams.begin();
-        imageStreamIterator != client->ClientInfo.ImageStreams.end(); ++imageStreamIterator)
-      {
-        PlusIgtlClientInfo::ImageStream* imageStream = &(*imageStreamIterator);
-        if (!imageStream->FrameConverter)
+      for (std::map<int, int>::iterator polledIt = polledClientSocketDescriptors.begin(); polledIt != polledClientSocketDescriptors.end();)
+      {
+        bool clientFound = false;
+        for (std::list<ClientData>::iterator clientIterator = self->IgtlClients.begin(); clientIterator != self->IgtlClients.end(); ++clientIterator)
+        {
+          if (clientIterator->ClientId == polledIt->first)
+          {
+            clientFound = true;
+            break;
+          }
+        }
+        if (clientFound)
         {
-          imageStream->FrameConverter = vtkSmartPointer<vtkIGSIOFrameConverter>::New();
+          ++polledIt;
+          continue;
         }
+        poller.RemoveSocket(polledIt->second);
+        polledClientSocketDescriptors.erase(polledIt++);
       }
-      for (std::vector<PlusIgtlClientInfo::VideoStream>::iterator videoStreamIterator = client->ClientInfo.VideoStreams.begin();
-           videoStreamIterator != client->ClientInfo.VideoStreams.end(); ++videoStreamIterator)
+      for (std::list<ClientData>::iterator clientIterator = self->IgtlClients.begin(); clientIterator != self->IgtlClients.end(); ++clientIterator)
       {
-        PlusIgtlClientInfo::VideoStream* videoStream = &(*videoStreamIterator);
-        if (!videoStream->FrameConverter)
+        if (polledClientSocketDescriptors.find(clientIterator->ClientId) != polledClientSocketDescriptors.end())
+        {
+          continue;
+        }
+        int socketDescriptor = SocketDescriptorAccessor::GetSocketDescriptor(clientIterator->ClientSocket);
+        if (poller.AddSocket(socketDescriptor) != PLUS_SUCCESS)
         {
-          videoStream->FrameConverter = vtkSmartPointer<vtkIGSIOFrameConverter>::New();
+          LOG_ERROR("Cannot receive messages from client " << clientIterator->ClientId);
         }
+        polledClientSocketDescriptors[clientIterator->ClientId] = socketDescriptor;
       }
+    }
 
-      int port = 0;
-      std::string address = "unknown";
-#if (OPENIGTLINK_VERSION_MAJOR > 1) || ( OPENIGTLINK_VERSION_MAJOR == 1 && OPENIGTLINK_VERSION_MINOR > 9 ) || ( OPENIGTLINK_VERSION_MAJOR == 1 && OPENIGTLINK_VERSION_MINOR == 9 && OPENIGTLINK_VERSION_PATCH > 4 )
-      newClientSocket->GetSocketAddressAndPort(address, port);
-#endif
-      LOG_INFO("Received new client connection (client " << client->ClientId << " at " << address << ":" << port << "). Number of connected clients: " << self->GetNumberOfConnectedClients());
+    if (poller.Wait(CLIENT_SOCKET_TIMEOUT_SEC * 1000, readySocketDescriptors) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to wait for data from the client sockets");
+      vtkIGSIOAccurateTimer::Delay(DELAY_ON_POLLING_ERROR_SEC);
+      continue;
+    }
+
+    std::vector<int> disconnectedClientIds;
+    for (std::vector<int>::iterator readyIt = readySocketDescriptors.begin(); readyIt != readySocketDescriptors.end(); ++readyIt)
+    {
+      if (*readyIt == serverSocketDescriptor)
+      {
+        self->AcceptNewClient();
+        continue;
+      }
+      // The clients are not locked here, ReceiveMessageFromClient locks them (it does not block on the socket)
+      for (std::map<int, int>::iterator polledIt = polledClientSocketDescriptors.begin(); polledIt != polledClientSocketDescriptors.end(); ++polledIt)
+      {
+        if (polledIt->second != *readyIt)
+        {
+          continue;
+        }
+        bool clientDisconnected = false;
+        self->ReceiveMessageFromClient(polledIt->first, clientDisconnected);
+        if (clientDisconnected)
+        {
+          disconnectedClientIds.push_back(polledIt->first);
+        }
+        break;
+      }
+    }
 
-      client->DataReceiverActive.first = true;
-      client->DataReceiverThreadId = self->Threader->SpawnThread((vtkThreadFunctionType)&DataReceiverThread, client);
+    // Clean up disconnected clients
+    for (std::vector< int >::iterator it = disconnectedClientIds.begin(); it != disconnectedClientIds.end(); ++it)
+    {
+      self->DisconnectClient(*it);
     }
   }
 
@@ -308,6 +737,7 @@ void* vtkPlusOpenIGTLinkServer::ConnectionReceiverThread(vtkMultiThreader::Threa
   {
     self->ServerSocket->CloseSocket();
   }
+  MetricsRegistry::GetInstance().RemoveMetrics("thread", CONNECTION_RECEIVER_THREAD_NAME);
 
   // Close thread
   self->ConnectionReceiverThreadId = -1;
@@ -315,10 +745,74 @@ void* vtkPlusOpenIGTLinkServer::ConnectionReceiverThread(vtkMultiThreader::Threa
   return NULL;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkServer::AcceptNewClient()
+{
+  // The server socket is ready, so the connection is accepted immediately (0 timeout would mean waiting forever)
+  igtl::ClientSocket::Pointer newClientSocket = this->ServerSocket->WaitForConnection(1);
+  if (newClientSocket.IsNull())
+  {
+    return PLUS_FAIL;
+  }
+
+  // Lock before we change the clients list
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
+  ClientData newClient;
+  this->IgtlClients.push_back(newClient);
+
+  ClientData* client = &(this->IgtlClients.back());   // get a reference to the client data that is stored in the list
+  client->ClientId = this->ClientIdCounter;
+  this->ClientIdCounter++;
+  client->ClientSocket = newClientSocket;
+  client->ClientSocket->SetReceiveTimeout(this->DefaultClientReceiveTimeoutSec * 1000);
+  client->ClientSocket->SetSendTimeout(this->DefaultClientSendTimeoutSec * 1000);
+  client->ClientInfo = this->DefaultClientInfo;
+  client->Server = this;
+  this->ApplySocketOptions(*client);
+
+  MetricsRegistry::Labels clientLabels;
+  clientLabels["client"] = igsioCommon::ToString<int>(client->ClientId);
+  client->SentBytesMetric = MetricsRegistry::GetInstance().GetMetric("plus_server_client_sent_bytes_total",
+                            "Number of bytes accepted by the socket of the client", MetricsRegistry::METRIC_COUNTER, clientLabels);
+  client->FrameLatencyMetric = MetricsRegistry::GetInstance().GetMetric("plus_server_client_frame_latency_seconds",
+                               "Time from the acquisition of a tracked frame until its messages are accepted by the socket of the client", MetricsRegistry::METRIC_SUMMARY, clientLabels);
+
+  // Setup vtkIGSIOFrameConverters for each stream
+  for (std::vector<PlusIgtlClientInfo::ImageStream>::iterator imageStreamIterator = client->ClientInfo.ImageStreams.begin();
+    imageStreamIterator != client->ClientInfo.ImageStreams.end(); ++imageStreamIterator)
+  {
+    PlusIgtlClientInfo::ImageStream* imageStream = &(*imageStreamIterator);
+    if (!imageStream->FrameConverter)
+    {
+      imageStream->FrameConverter = vtkSmartPointer<vtkIGSIOFrameConverter>::New();
+    }
+  }
+  for (std::vector<PlusIgtlClientInfo::VideoStream>::iterator videoStreamIterator = client->ClientInfo.VideoStreams.begin();
+       videoStreamIterator != client->ClientInfo.VideoStreams.end(); ++videoStreamIterator)
+  {
+    PlusIgtlClientInfo::VideoStream* videoStream = &(*videoStreamIterator);
+    if (!videoStream->FrameConverter)
+    {
+      videoStream->FrameConverter = vtkSmartPointer<vtkIGSIOFrameConverter>::New();
+    }
+  }
+
+  int port = 0;
+  std::string address = "unknown";
+#if (OPENIGTLINK_VERSION_MAJOR > 1) || ( OPENIGTLINK_VERSION_MAJOR == 1 && OPENIGTLINK_VERSION_MINOR > 9 ) || ( OPENIGTLINK_VERSION_MAJOR == 1 && OPENIGTLINK_VERSION_MINOR == 9 && OPENIGTLINK_VERSION_PATCH > 4 )
+  newClientSocket->GetSocketAddressAndPort(address, port);
+#endif
+  LOG_INFO("Received new client connection (client " << client->ClientId << " at " << address << ":" << port << "). Number of connected clients: " << this->GetNumberOfConnectedClients());
+
+  return PLUS_SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 void* vtkPlusOpenIGTLinkServer::DataSenderThread(vtkMultiThreader::ThreadInfo* data)
 {
   vtkPlusOpenIGTLinkServer* self = (vtkPlusOpenIGTLinkServer*)(data->UserData);
+  PLUS_PROFILE_THREAD_NAME("OpenIGTLinkServer:" + igsioCommon::ToString<int>(self->ListeningPort) + " sender");
+  self->ThreadSettings.ApplyToCurrentThread("OpenIGTLinkServer:" + igsioCommon::ToString<int>(self->ListeningPort) + " sender");
   self->DataSenderActive.Respond = true;
 
   vtkPlusDevice* aDevice(NULL);
@@ -369,28 +863,65 @@ void* vtkPlusOpenIGTLinkServer::DataSenderThread(vtkMultiThreader::ThreadInfo* d
     LOG_WARNING("There are no channels to broadcast. Only command processing is available.");
   }
 
-  self->BroadcastChannel = aChannel;
-  if (self->BroadcastChannel)
+  self->OutputChannels.clear();
+  OutputChannel defaultOutputChannel;
+  defaultOutputChannel.Channel = aChannel;
+  defaultOutputChannel.ChannelId = (aChannel != NULL && aChannel->GetChannelId() != NULL ? aChannel->GetChannelId() : self->GetOutputChannelId());
+  self->OutputChannels.push_back(defaultOutputChannel);
+
+  // Find the additional channels
+  for (std::vector<std::string>::iterator channelIdIt = self->AdditionalOutputChannelIds.begin(); channelIdIt != self->AdditionalOutputChannelIds.end(); ++channelIdIt)
+  {
+    OutputChannel outputChannel;
+    outputChannel.ChannelId = *channelIdIt;
+    for (DeviceCollectionIterator it = aCollection.begin(); it != aCollection.end(); ++it)
+    {
+      if ((*it)->GetOutputChannelByName(outputChannel.Channel, *channelIdIt) == PLUS_SUCCESS)
+      {
+        break;
+      }
+    }
+    if (outputChannel.Channel == NULL)
+    {
+      LOG_ERROR("Unable to start data sending. Additional output channel not found: " << *channelIdIt);
+      return NULL;
+    }
+    self->OutputChannels.push_back(outputChannel);
+  }
+
+  for (std::vector<OutputChannel>::iterator outputChannelIt = self->OutputChannels.begin(); outputChannelIt != self->OutputChannels.end(); ++outputChannelIt)
   {
-    self->BroadcastChannel->GetMostRecentTimestamp(self->LastSentTrackedFrameTimestamp);
+    if (outputChannelIt->Channel != NULL)
+    {
+      outputChannelIt->Channel->GetMostRecentTimestamp(outputChannelIt->LastSentTrackedFrameTimestamp);
+    }
   }
 
+  std::shared_ptr<MetricsRegistry::Metric> cpuTimeMetric = MetricsRegistry::GetInstance().GetThreadCpuTimeMetric(DATA_SENDER_THREAD_NAME);
+
   double elapsedTimeSinceLastPacketSentSec = 0;
   while (self->ConnectionActive.Request && self->DataSenderActive.Request)
   {
+    cpuTimeMetric->Set(MetricsRegistry::GetCurrentThreadCpuTimeSec());
+
     bool clientsConnected = false;
     {
       igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self->IgtlClientsMutex);
-      if (!self->IgtlClients.empty())
+      if (!self->IgtlClients.empty() || self->UdpOutputSocket.IsOpen())
       {
+        // The UDP output is sent even if no client is listening
         clientsConnected = true;
       }
     }
     if (!clientsConnected)
     {
       // No client connected, wait for a while
+      self->UpdateOutputChannelConsumers(std::vector<bool>());
       vtkIGSIOAccurateTimer::Delay(0.2);
-      self->LastSentTrackedFrameTimestamp = 0; // next time start sending from the most recent timestamp
+      for (std::vector<OutputChannel>::iterator outputChannelIt = self->OutputChannels.begin(); outputChannelIt != self->OutputChannels.end(); ++outputChannelIt)
+      {
+        outputChannelIt->LastSentTrackedFrameTimestamp = 0; // next time start sending from the most recent timestamp
+      }
       continue;
     }
 
@@ -399,14 +930,23 @@ void* vtkPlusOpenIGTLinkServer::DataSenderThread(vtkMultiThreader::ThreadInfo* d
       self->GracePeriodLogLevel = vtkPlusLogger::LOG_LEVEL_WARNING;
     }
 
+    // Continue sending the data that slow clients have not accepted yet
+    self->FlushClientsSendData();
+
     SendMessageResponses(*self);
 
     // Send remote command execution replies to clients before sending any images/transforms/etc...
     SendCommandResponses(*self);
 
+    // Send the changed imaging parameters before the images that are acquired with them
+    SendUsImagingParameterUpdates(*self);
+
     // Send image/tracking/string data
     SendLatestFramesToClients(*self, elapsedTimeSinceLastPacketSentSec);
   }
+  self->UdpOutputSocket.Close();
+  self->UpdateOutputChannelConsumers(std::vector<bool>());
+  MetricsRegistry::GetInstance().RemoveMetrics("thread", DATA_SENDER_THREAD_NAME);
   // Close thread
   self->DataSenderThreadId = -1;
   self->DataSenderActive.Respond = false;
@@ -416,7 +956,6 @@ void* vtkPlusOpenIGTLinkServer::DataSenderThread(vtkMultiThreader::ThreadInfo* d
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusOpenIGTLinkServer::SendLatestFramesToClients(vtkPlusOpenIGTLinkServer& self, double& elapsedTimeSinceLastPacketSentSec)
 {
-  vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
   double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
 
   // Acquire tracked frames since last acquisition (minimum 1 frame)
@@ -429,103 +968,222 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendLatestFramesToClients(vtkPlusOpenIGTLin
   // Maximize the number of frames to send
   numberOfFramesToGet = std::min(numberOfFramesToGet, self.MaxNumberOfIgtlMessagesToSend);
 
-  if (self.BroadcastChannel != NULL)
+  // Only the channels that the clients requested are sent (the UDP output is sent from the default channel)
+  std::vector<bool> outputChannelRequested(self.OutputChannels.size(), false);
   {
-    if ((self.BroadcastChannel->HasVideoSource() && !self.BroadcastChannel->GetVideoDataAvailable())
-        || (self.BroadcastChannel->ToolCount() > 0 && !self.BroadcastChannel->GetTrackingDataAvailable())
-        || (self.BroadcastChannel->FieldCount() > 0 && !self.BroadcastChannel->GetFieldDataAvailable()))
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self.IgtlClientsMutex);
+    for (std::list<ClientData>::iterator clientIterator = self.IgtlClients.begin(); clientIterator != self.IgtlClients.end(); ++clientIterator)
     {
-      if (self.LogWarningOnNoDataAvailable)
+      int outputChannelIndex = self.GetOutputChannelIndex(clientIterator->ClientInfo);
+      if (outputChannelIndex >= 0)
       {
-        LOG_DYNAMIC("No data is broadcasted, as no data is available yet.", self.GracePeriodLogLevel);
+        outputChannelRequested[outputChannelIndex] = true;
       }
     }
-    else
+    if (!outputChannelRequested.empty() && self.UdpOutputSocket.IsOpen())
     {
-      double oldestDataTimestamp = 0;
-      if (self.BroadcastChannel->GetOldestTimestamp(oldestDataTimestamp) == PLUS_SUCCESS)
-      {
-        if (self.LastSentTrackedFrameTimestamp < oldestDataTimestamp)
-        {
-          LOG_INFO("OpenIGTLink broadcasting started. No data was available between " << self.LastSentTrackedFrameTimestamp << "-" << oldestDataTimestamp << "sec, therefore no data were broadcasted during this time period.");
-          self.LastSentTrackedFrameTimestamp = oldestDataTimestamp + SAMPLING_SKIPPING_MARGIN_SEC;
-        }
-        static vtkIGSIOLogHelper logHelper(60.0, 500000);
-        CUSTOM_RETURN_WITH_FAIL_IF(self.BroadcastChannel->GetTrackedFrameList(self.LastSentTrackedFrameTimestamp, trackedFrameList, numberOfFramesToGet) != PLUS_SUCCESS,
-                                   "Failed to get tracked frame list from data collector (last recorded timestamp: " << std::fixed << self.LastSentTrackedFrameTimestamp);
-      }
+      outputChannelRequested[0] = true;
     }
   }
+  self.UpdateOutputChannelConsumers(outputChannelRequested);
 
-  // There is no new frame in the buffer
-  if (trackedFrameList->GetNumberOfTrackedFrames() == 0)
+  unsigned int numberOfSentFrames = 0;
+  std::vector<OutputChannel*> outputChannelsWithoutNewFrames;
+  for (size_t outputChannelIndex = 0; outputChannelIndex < self.OutputChannels.size(); ++outputChannelIndex)
   {
-    vtkIGSIOAccurateTimer::Delay(DELAY_ON_NO_NEW_FRAMES_SEC);
-    elapsedTimeSinceLastPacketSentSec += vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
-
-    // Send keep alive packet to clients
-    if (elapsedTimeSinceLastPacketSentSec > self.KeepAliveIntervalSec)
+    OutputChannel& outputChannel = self.OutputChannels[outputChannelIndex];
+    if (!outputChannelRequested[outputChannelIndex])
     {
-      self.KeepAlive();
-      elapsedTimeSinceLastPacketSentSec = 0;
-      return PLUS_SUCCESS;
+      outputChannel.LastSentTrackedFrameTimestamp = 0; // next time start sending from the most recent timestamp
+      continue;
+    }
+    if (outputChannel.Channel == NULL)
+    {
+      continue;
     }
 
-    return PLUS_FAIL;
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    if (self.GetNewTrackedFrames(outputChannel, numberOfFramesToGet, trackedFrameList) != PLUS_SUCCESS)
+    {
+      continue;
+    }
+    if (trackedFrameList->GetNumberOfTrackedFrames() == 0)
+    {
+      outputChannelsWithoutNewFrames.push_back(&outputChannel);
+      continue;
+    }
+    for (unsigned int i = 0; i < trackedFrameList->GetNumberOfTrackedFrames(); ++i)
+    {
+      // Send tracked frame
+      self.SendTrackedFrame(*trackedFrameList->GetTrackedFrame(i), static_cast<int>(outputChannelIndex));
+    }
+    numberOfSentFrames += trackedFrameList->GetNumberOfTrackedFrames();
   }
 
-  for (unsigned int i = 0; i < trackedFrameList->GetNumberOfTrackedFrames(); ++i)
+  // There is no new frame in the buffers
+  if (numberOfSentFrames == 0)
   {
-    // Send tracked frame
-    self.SendTrackedFrame(*trackedFrameList->GetTrackedFrame(i));
-    elapsedTimeSinceLastPacketSentSec = 0;
+    // Wait until the devices add new data instead of sleeping for a fixed period, so that new frames are sent
+    // as soon as they are available. The wait is limited so that keep alive, command and message responses are not delayed.
+    if (outputChannelsWithoutNewFrames.size() == 1)
+    {
+      outputChannelsWithoutNewFrames[0]->Channel->WaitForItemNewerThan(outputChannelsWithoutNewFrames[0]->LastSentTrackedFrameTimestamp, DELAY_ON_NO_NEW_FRAMES_SEC);
+    }
+    else if (outputChannelsWithoutNewFrames.size() > 1)
+    {
+      // New data of any of the channels cannot be waited for at once, therefore the channels are checked frequently
+      vtkIGSIOAccurateTimer::Delay(DELAY_ON_NO_NEW_FRAMES_MULTIPLE_CHANNELS_SEC);
+    }
+    else
+    {
+      vtkIGSIOAccurateTimer::Delay(DELAY_ON_NO_NEW_FRAMES_SEC);
+    }
+    elapsedTimeSinceLastPacketSentSec += vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
+
+    // Send keep alive packet to clients
+    if (elapsedTimeSinceLastPacketSentSec > self.KeepAliveIntervalSec)
+    {
+      self.KeepAlive();
+      elapsedTimeSinceLastPacketSentSec = 0;
+      return PLUS_SUCCESS;
+    }
+
+    return PLUS_FAIL;
   }
+  elapsedTimeSinceLastPacketSentSec = 0;
 
   // Compute time spent with processing one frame in this round
   double computationTimeMs = (vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec) * 1000.0;
+  self.LastProcessingTimePerFrameMs = computationTimeMs / numberOfSentFrames;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkServer::GetNewTrackedFrames(OutputChannel& outputChannel, int numberOfFramesToGet, vtkIGSIOTrackedFrameList* trackedFrameList)
+{
+  vtkPlusChannel* channel = outputChannel.Channel;
+
+  // The sources of the channel may be switched (e.g., by a virtual switcher) while the frames are read
+  unsigned long sourcesGeneration = channel->GetSourcesGeneration();
+  if (sourcesGeneration % 2 != 0)
+  {
+    // Switching is in progress, get the frames next time
+    return PLUS_SUCCESS;
+  }
+
+  if ((channel->HasVideoSource() && !channel->GetVideoDataAvailable())
+      || (channel->ToolCount() > 0 && !channel->GetTrackingDataAvailable())
+      || (channel->FieldCount() > 0 && !channel->GetFieldDataAvailable()))
+  {
+    if (this->LogWarningOnNoDataAvailable)
+    {
+      LOG_DYNAMIC("No data is broadcasted from channel " << outputChannel.ChannelId << ", as no data is available yet.", this->GracePeriodLogLevel);
+    }
+    return PLUS_SUCCESS;
+  }
 
-  // Update last processing time if new tracked frames have been acquired
-  if (trackedFrameList->GetNumberOfTrackedFrames() > 0)
+  double oldestDataTimestamp = 0;
+  if (channel->GetOldestTimestamp(oldestDataTimestamp) != PLUS_SUCCESS)
   {
-    self.LastProcessingTimePerFrameMs = computationTimeMs / trackedFrameList->GetNumberOfTrackedFrames();
+    return PLUS_SUCCESS;
+  }
+  if (outputChannel.LastSentTrackedFrameTimestamp < oldestDataTimestamp)
+  {
+    LOG_INFO("OpenIGTLink broadcasting of channel " << outputChannel.ChannelId << " started. No data was available between " << outputChannel.LastSentTrackedFrameTimestamp << "-" << oldestDataTimestamp << "sec, therefore no data were broadcasted during this time period.");
+    outputChannel.LastSentTrackedFrameTimestamp = oldestDataTimestamp + SAMPLING_SKIPPING_MARGIN_SEC;
+  }
+  double lastSentTrackedFrameTimestamp = outputChannel.LastSentTrackedFrameTimestamp;
+
+  static vtkIGSIOLogHelper logHelper(60.0, 500000);
+  CUSTOM_RETURN_WITH_FAIL_IF(channel->GetTrackedFrameList(outputChannel.LastSentTrackedFrameTimestamp, trackedFrameList, numberOfFramesToGet) != PLUS_SUCCESS,
+                             "Failed to get tracked frame list of channel " << outputChannel.ChannelId << " from data collector (last recorded timestamp: " << std::fixed << outputChannel.LastSentTrackedFrameTimestamp);
+
+  if (channel->GetSourcesGeneration() != sourcesGeneration)
+  {
+    // Frames may contain data from both the previous and the new sources, get them again from the new sources
+    LOG_DEBUG("Sources of channel " << outputChannel.ChannelId << " were switched while getting frames, the frames are discarded");
+    trackedFrameList->Clear();
+    outputChannel.LastSentTrackedFrameTimestamp = lastSentTrackedFrameTimestamp;
   }
   return PLUS_SUCCESS;
 }
 
 //----------------------------------------------------------------------------
-PlusStatus vtkPlusOpenIGTLinkServer::SendMessageResponses(vtkPlusOpenIGTLinkServer& self)
+int vtkPlusOpenIGTLinkServer::GetOutputChannelIndex(const PlusIgtlClientInfo& clientInfo) const
 {
-  igsioLockGuard<vtkIGSIORecursiveCriticalSection> mutexGuardedLock(self.MessageResponseQueueMutex);
-  if (!self.MessageResponseQueue.empty())
+  std::string channelId = clientInfo.GetOutputChannelId();
+  if (channelId.empty() || channelId == this->OutputChannelId)
+  {
+    return (this->OutputChannels.empty() ? -1 : 0);
+  }
+  for (size_t outputChannelIndex = 0; outputChannelIndex < this->OutputChannels.size(); ++outputChannelIndex)
   {
-    for (ClientIdToMessageListMap::iterator it = self.MessageResponseQueue.begin(); it != self.MessageResponseQueue.end(); ++it)
+    if (this->OutputChannels[outputChannelIndex].ChannelId == channelId)
     {
-      igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self.IgtlClientsMutex);
-      igtl::ClientSocket::Pointer clientSocket = NULL;
+      return static_cast<int>(outputChannelIndex);
+    }
+  }
+  return -1;
+}
 
-      for (std::list<ClientData>::iterator clientIterator = self.IgtlClients.begin(); clientIterator != self.IgtlClients.end(); ++clientIterator)
-      {
-        if (clientIterator->ClientId == it->first)
-        {
-          clientSocket = clientIterator->ClientSocket;
-          break;
-        }
-      }
-      if (clientSocket.IsNull())
-      {
-        LOG_WARNING("Message reply cannot be sent to client " << it->first << ", probably client has been disconnected.");
-        continue;
-      }
+//----------------------------------------------------------------------------
+bool vtkPlusOpenIGTLinkServer::IsOutputChannelPublished(const std::string& channelId) const
+{
+  return channelId.empty() || channelId == this->OutputChannelId
+         || std::find(this->AdditionalOutputChannelIds.begin(), this->AdditionalOutputChannelIds.end(), channelId) != this->AdditionalOutputChannelIds.end();
+}
+
+//----------------------------------------------------------------------------
+const std::vector<std::string>& vtkPlusOpenIGTLinkServer::GetAdditionalOutputChannelIds() const
+{
+  return this->AdditionalOutputChannelIds;
+}
 
-      for (std::vector<igtl::MessageBase::Pointer>::iterator messageIt = it->second.begin(); messageIt != it->second.end(); ++messageIt)
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkServer::SendMessageResponses(vtkPlusOpenIGTLinkServer& self)
+{
+  // Take the queued messages and release the queue before locking the client list, as the queue
+  // is filled by the receiver thread while it holds the client list lock
+  ClientIdToMessageListMap messageResponses;
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> mutexGuardedLock(self.MessageResponseQueueMutex);
+    messageResponses.swap(self.MessageResponseQueue);
+  }
+
+  self.SendMessagesToClients(messageResponses);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::SendMessagesToClients(ClientIdToMessageListMap& clientMessages)
+{
+  if (clientMessages.empty())
+  {
+    return;
+  }
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
+  for (ClientIdToMessageListMap::iterator it = clientMessages.begin(); it != clientMessages.end(); ++it)
+  {
+    ClientData* client = NULL;
+    for (std::list<ClientData>::iterator clientIterator = this->IgtlClients.begin(); clientIterator != this->IgtlClients.end(); ++clientIterator)
+    {
+      if (clientIterator->ClientId == it->first)
       {
-        clientSocket->Send((*messageIt)->GetBufferPointer(), (*messageIt)->GetBufferSize());
+        client = &(*clientIterator);
+        break;
       }
     }
-    self.MessageResponseQueue.clear();
-  }
+    if (client == NULL)
+    {
+      LOG_WARNING("Message reply cannot be sent to client " << it->first << ", probably client has been disconnected.");
+      continue;
+    }
 
-  return PLUS_SUCCESS;
+    // Sending errors are handled when the pending data of the clients is flushed
+    LOG_DEBUG("Send " << it->second.size() << " replies to client " << it->first);
+    this->SendToClient(*client, it->second);
+  }
+  clientMessages.clear();
 }
 
 //----------------------------------------------------------------------------
@@ -535,6 +1193,10 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendCommandResponses(vtkPlusOpenIGTLinkServ
   self.PlusCommandProcessor->PopCommandResponses(replies);
   if (!replies.empty())
   {
+    // Replies are collected by client, so that a burst of replies is sent in a few gathered sends instead of one send per reply.
+    // The messages cannot be reused, because slow clients keep them in their send queue until they are sent.
+    ClientIdToMessageListMap batches;
+    double batchStartTime = -1;
     for (PlusCommandResponseList::iterator responseIt = replies.begin(); responseIt != replies.end(); responseIt++)
     {
       igtl::MessageBase::Pointer igtlResponseMessage = self.CreateIgtlMessageFromCommandResponse(*responseIt);
@@ -543,619 +1205,1090 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendCommandResponses(vtkPlusOpenIGTLinkServ
         LOG_ERROR("Failed to create OpenIGTLink message from command response");
         continue;
       }
-      igtlResponseMessage->Pack();
+      vtkPlusCommandPolydataResponse* polydataResponse = vtkPlusCommandPolydataResponse::SafeDownCast(*responseIt);
+      vtkPlusCommandImageResponse* imageResponse = vtkPlusCommandImageResponse::SafeDownCast(*responseIt);
+      bool alreadyPacked = (polydataResponse != NULL && !polydataResponse->GetCacheKey().empty())
+                           || (imageResponse != NULL && !imageResponse->GetFrameUid().empty());
+      if (!alreadyPacked)
+      {
+        // cached polydata and image messages are packed by CreateIgtlMessageFromCommandResponse
+        igtlResponseMessage->Pack();
+      }
 
       // Only send the response to the client that requested the command
-      LOG_DEBUG("Send command reply to client " << (*responseIt)->GetClientId() << ": " << igtlResponseMessage->GetDeviceName());
-      igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self.IgtlClientsMutex);
-      igtl::ClientSocket::Pointer clientSocket = NULL;
-      for (std::list<ClientData>::iterator clientIterator = self.IgtlClients.begin(); clientIterator != self.IgtlClients.end(); ++clientIterator)
+      LOG_DEBUG("Queue command reply to client " << (*responseIt)->GetClientId() << ": " << igtlResponseMessage->GetDeviceName());
+      batches[(*responseIt)->GetClientId()].push_back(igtlResponseMessage);
+
+      double currentTime = vtkIGSIOAccurateTimer::GetSystemTime();
+      if (batchStartTime < 0)
       {
-        if (clientIterator->ClientId == (*responseIt)->GetClientId())
-        {
-          clientSocket = clientIterator->ClientSocket;
-          break;
-        }
+        batchStartTime = currentTime;
       }
-
-      if (clientSocket.IsNull())
+      else if (currentTime - batchStartTime > MAX_COMMAND_RESPONSE_BATCH_DELAY_SEC)
       {
-        LOG_WARNING("Message reply cannot be sent to client " << (*responseIt)->GetClientId() << ", probably client has been disconnected");
-        continue;
+        // The replies of each client stay in order, as a client's batch is always sent before its next replies
+        self.SendMessagesToClients(batches);
+        batchStartTime = -1;
       }
-      clientSocket->Send(igtlResponseMessage->GetBufferPointer(), igtlResponseMessage->GetBufferSize());
     }
+    self.SendMessagesToClients(batches);
   }
 
   return PLUS_SUCCESS;
 }
 
 //----------------------------------------------------------------------------
-void* vtkPlusOpenIGTLinkServer::DataReceiverThread(vtkMultiThreader::ThreadInfo* data)
+PlusStatus vtkPlusOpenIGTLinkServer::SendUsImagingParameterUpdates(vtkPlusOpenIGTLinkServer& self)
 {
-  ClientData* client = (ClientData*)(data->UserData);
-  client->DataReceiverActive.second = true;
-  vtkPlusOpenIGTLinkServer* self = client->Server;
-
-  /*! Store the IDs of recent commands to be able to detect duplicate command IDs */
-  std::deque<uint32_t> previousCommandIds;
-
-  // Make copy of frequently used data to avoid locking of client data
-  igtl::ClientSocket::Pointer clientSocket = client->ClientSocket;
-  int clientId = client->ClientId;
-
-  igtl::MessageHeader::Pointer headerMsg = self->IgtlMessageFactory->CreateHeaderMessage(IGTL_HEADER_VERSION_1);
-
-  while (client->DataReceiverActive.first)
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self.IgtlClientsMutex);
+  for (std::list<ClientData>::iterator clientIterator = self.IgtlClients.begin(); clientIterator != self.IgtlClients.end(); ++clientIterator)
   {
-    headerMsg->InitBuffer();
-
-    // Receive generic header from the socket
-    int bytesReceived = clientSocket->Receive(headerMsg->GetBufferPointer(), headerMsg->GetBufferSize());
-    if (bytesReceived == IGTL_EMPTY_DATA_SIZE || bytesReceived != headerMsg->GetBufferSize())
+    PlusIgtlClientInfo& clientInfo = clientIterator->ClientInfo;
+    if (!clientInfo.GetSendUsImagingParameters())
     {
-      vtkIGSIOAccurateTimer::Delay(0.1);
       continue;
     }
 
-    headerMsg->Unpack(self->IgtlMessageCrcCheckEnabled);
-
+    vtkPlusUsDevice* usDevice = NULL;
+    if (!clientInfo.GetUsImagingParametersDeviceId().empty())
     {
-      igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self->IgtlClientsMutex);
-      // Keep track of the highest known version of message ever sent by this client, this is the version that we reply with
-      // (upper bounded by the servers version)
-      if (headerMsg->GetHeaderVersion() > client->ClientInfo.GetClientHeaderVersion())
+      vtkPlusDevice* device = NULL;
+      if (self.DataCollector->GetDevice(device, clientInfo.GetUsImagingParametersDeviceId()) == PLUS_SUCCESS)
+      {
+        usDevice = vtkPlusUsDevice::SafeDownCast(device);
+      }
+    }
+    else
+    {
+      for (DeviceCollectionConstIterator it = self.DataCollector->GetDeviceConstIteratorBegin(); it != self.DataCollector->GetDeviceConstIteratorEnd() && usDevice == NULL; ++it)
       {
-        client->ClientInfo.SetClientHeaderVersion(std::min<int>(self->GetIGTLHeaderVersion(), headerMsg->GetHeaderVersion()));
+        usDevice = vtkPlusUsDevice::SafeDownCast(*it);
       }
     }
+    if (usDevice == NULL)
+    {
+      LOG_WARNING("Imaging parameters cannot be sent to client " << clientIterator->ClientId << ", ultrasound device "
+                  << (clientInfo.GetUsImagingParametersDeviceId().empty() ? "(undefined)" : clientInfo.GetUsImagingParametersDeviceId()) << " is not found");
+      clientInfo.SetSendUsImagingParameters(false);
+      continue;
+    }
 
-    igtl::MessageBase::Pointer bodyMessage = self->IgtlMessageFactory->CreateReceiveMessage(headerMsg);
-    if (bodyMessage.IsNull())
+    vtkPlusUsImagingParameters* imagingParameters = usDevice->GetImagingParameters();
+    if (!clientInfo.IsUsImagingParametersUpdateDue(imagingParameters->GetVersion()))
     {
-      LOG_ERROR("Unable to receive message from client: " << client->ClientId);
       continue;
     }
 
-    if (typeid(*bodyMessage) == typeid(igtl::PlusClientInfoMessage))
+    std::shared_ptr<const vtkPlusUsImagingParameters::Snapshot> snapshot = imagingParameters->GetSnapshot();
+    std::string deviceId = usDevice->GetDeviceId();
+    std::string packedMessageKey = deviceId + "|" + igsioCommon::ToString<int>(clientInfo.GetClientHeaderVersion());
+    std::pair<unsigned long, igtl::MessageBase::Pointer>& packedMessage = self.PackedUsImagingParameterMessages[packedMessageKey];
+    if (packedMessage.second.IsNull() || packedMessage.first != snapshot->Version)
     {
-      igtl::PlusClientInfoMessage::Pointer clientInfoMsg = dynamic_cast<igtl::PlusClientInfoMessage*>(bodyMessage.GetPointer());
-      clientInfoMsg->SetMessageHeader(headerMsg);
-      clientInfoMsg->AllocateBuffer();
+      igtl::StringMessage::Pointer igtlMessage = dynamic_cast<igtl::StringMessage*>(self.IgtlMessageFactory->CreateSendMessage("STRING", clientInfo.GetClientHeaderVersion()).GetPointer());
+      igtlMessage->SetDeviceName(deviceId.c_str());
+      igtlMessage->SetString(snapshot->SerializedXml);
+      if (clientInfo.GetClientHeaderVersion() >= IGTL_HEADER_VERSION_2)
+      {
+        igtlMessage->SetMetaDataElement("Version", IANA_TYPE_US_ASCII, igsioCommon::ToString<unsigned long>(snapshot->Version));
+        for (std::map<std::string, std::string>::const_iterator valueIt = snapshot->Values.begin(); valueIt != snapshot->Values.end(); ++valueIt)
+        {
+          igtlMessage->SetMetaDataElement(valueIt->first, IANA_TYPE_US_ASCII, valueIt->second);
+        }
+      }
+      igtlMessage->Pack();
+      packedMessage = std::make_pair(snapshot->Version, igtl::MessageBase::Pointer(igtlMessage.GetPointer()));
+    }
 
-      clientSocket->Receive(clientInfoMsg->GetBufferBodyPointer(), clientInfoMsg->GetBufferBodySize());
+    LOG_DEBUG("Send imaging parameters version " << snapshot->Version << " of " << deviceId << " to client " << clientIterator->ClientId);
+    // Sending errors are handled when the pending data of the clients is flushed
+    self.SendToClient(*clientIterator, packedMessage.second);
+    clientInfo.UpdateUsImagingParametersState(snapshot->Version);
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkServer::ReceiveMessageFromClient(int clientId, bool& clientDisconnected)
+{
+  clientDisconnected = false;
+
+  // Reading does not block, so the clients can be locked while the received parts are stored in the client data
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
+  ClientData* client = NULL;
+  for (std::list<ClientData>::iterator clientIterator = this->IgtlClients.begin(); clientIterator != this->IgtlClients.end(); ++clientIterator)
+  {
+    if (clientIterator->ClientId == clientId)
+    {
+      client = &(*clientIterator);
+      break;
+    }
+  }
+  if (client == NULL)
+  {
+    // The client has been disconnected since the socket was reported to be readable
+    return PLUS_FAIL;
+  }
+  int socketDescriptor = SocketDescriptorAccessor::GetSocketDescriptor(client->ClientSocket);
 
-      int c = clientInfoMsg->Unpack(self->IgtlMessageCrcCheckEnabled);
-      if (c & igtl::MessageHeader::UNPACK_BODY || clientInfoMsg->GetBufferBodySize() == 0)
+  // Process all the messages that can be completed with the available data
+  PlusStatus status = PLUS_SUCCESS;
+  bool dataReceived = false;
+  while (true)
+  {
+    int bytesReceived = 0;
+    if (client->ReceivedBody.IsNull())
+    {
+      // Receive the generic header
+      if (client->ReceivedHeader.IsNull())
+      {
+        client->ReceivedHeader = this->IgtlMessageFactory->CreateHeaderMessage(IGTL_HEADER_VERSION_1);
+        client->ReceivedHeader->InitBuffer();
+        client->NumberOfReceivedHeaderBytes = 0;
+      }
+      bytesReceived = ReceiveWithoutBlocking(socketDescriptor, static_cast<char*>(client->ReceivedHeader->GetBufferPointer()) + client->NumberOfReceivedHeaderBytes,
+                                             client->ReceivedHeader->GetBufferSize() - client->NumberOfReceivedHeaderBytes);
+      if (bytesReceived > 0)
       {
-        // Message received from client, need to lock to modify client info
-        igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self->IgtlClientsMutex);
-        client->ClientInfo = clientInfoMsg->GetClientInfo();
-        LOG_DEBUG("Client info message received from client " << clientId);
+        dataReceived = true;
+        client->NumberOfReceivedHeaderBytes += bytesReceived;
+        if (client->NumberOfReceivedHeaderBytes == client->ReceivedHeader->GetBufferSize())
+        {
+          client->ReceivedHeader->Unpack(this->IgtlMessageCrcCheckEnabled);
+          client->ReceivedBody = this->IgtlMessageFactory->CreateReceiveMessage(client->ReceivedHeader);
+          client->ReceivedBodyIgnored = client->ReceivedBody.IsNull();
+          if (client->ReceivedBodyIgnored)
+          {
+            // The body is still received to keep the stream in sync with the message boundaries
+            LOG_ERROR("Unable to receive " << client->ReceivedHeader->GetMessageType() << " message from client: " << clientId);
+            client->ReceivedBody = igtl::MessageBase::New();
+            status = PLUS_FAIL;
+          }
+          client->ReceivedBody->SetMessageHeader(client->ReceivedHeader);
+          client->ReceivedBody->AllocateBuffer();
+          client->NumberOfReceivedBodyBytes = 0;
+        }
       }
     }
-    else if (typeid(*bodyMessage) == typeid(igtl::GetStatusMessage))
+    else if (client->NumberOfReceivedBodyBytes < client->ReceivedBody->GetBufferBodySize())
     {
-      // Just ping server, we can skip message and respond
-      clientSocket->Skip(headerMsg->GetBodySizeToRead(), 0);
-
-      igtl::StatusMessage::Pointer replyMsg = dynamic_cast<igtl::StatusMessage*>(self->IgtlMessageFactory->CreateSendMessage("STATUS", client->ClientInfo.GetClientHeaderVersion()).GetPointer());
-      replyMsg->SetCode(igtl::StatusMessage::STATUS_OK);
-      replyMsg->Pack();
-      clientSocket->Send(replyMsg->GetBufferPointer(), replyMsg->GetBufferSize());
+      // Receive the body of the message, messages that are not processed are read as well to skip them
+      igtlUint64 remainingBodySize = client->ReceivedBody->GetBufferBodySize() - client->NumberOfReceivedBodyBytes;
+      bytesReceived = ReceiveWithoutBlocking(socketDescriptor, static_cast<char*>(client->ReceivedBody->GetBufferBodyPointer()) + client->NumberOfReceivedBodyBytes,
+                                             static_cast<int>(std::min<igtlUint64>(remainingBodySize, MAX_RECEIVE_SIZE)));
+      if (bytesReceived > 0)
+      {
+        dataReceived = true;
+        client->NumberOfReceivedBodyBytes += bytesReceived;
+      }
     }
-    else if (typeid(*bodyMessage) == typeid(igtl::StringMessage)
-             && vtkPlusCommand::IsCommandDeviceName(headerMsg->GetDeviceName()))
+    if (bytesReceived < 0)
     {
-      igtl::StringMessage::Pointer stringMsg = dynamic_cast<igtl::StringMessage*>(bodyMessage.GetPointer());
-      stringMsg->SetMessageHeader(headerMsg);
-      stringMsg->AllocateBuffer();
-      clientSocket->Receive(stringMsg->GetBufferBodyPointer(), stringMsg->GetBufferBodySize());
+      clientDisconnected = true;
+      return PLUS_FAIL;
+    }
 
-      // We are receiving old style commands, handle it
-      int c = stringMsg->Unpack(self->IgtlMessageCrcCheckEnabled);
-      if (c & igtl::MessageHeader::UNPACK_BODY || stringMsg->GetBufferBodySize() == 0)
+    if (client->ReceivedBody.IsNotNull() && client->NumberOfReceivedBodyBytes == client->ReceivedBody->GetBufferBodySize())
+    {
+      // The message is complete
+      igtl::MessageHeader::Pointer headerMsg = client->ReceivedHeader;
+      igtl::MessageBase::Pointer bodyMessage = client->ReceivedBody;
+      bool bodyIgnored = client->ReceivedBodyIgnored;
+      client->ReceivedHeader = NULL;
+      client->ReceivedBody = NULL;
+      client->ReceivedBodyIgnored = false;
+      if (!bodyIgnored)
       {
-        std::string deviceName(headerMsg->GetDeviceName());
-        if (deviceName.empty())
+        int c = bodyMessage->Unpack(this->IgtlMessageCrcCheckEnabled);
+        bool bodyUnpacked = (c & igtl::MessageHeader::UNPACK_BODY) || bodyMessage->GetBufferBodySize() == 0;
+        if (this->ProcessMessageFromClient(*client, headerMsg, bodyMessage, bodyUnpacked) != PLUS_SUCCESS)
         {
-          self->PlusCommandProcessor->QueueStringResponse(PLUS_FAIL, std::string(vtkPlusCommand::DEVICE_NAME_REPLY), clientId, "Unable to read DeviceName.");
-          continue;
+          status = PLUS_FAIL;
         }
+      }
+      continue;
+    }
 
-        uint32_t uid(0);
-        try
-        {
-#if (_MSC_VER == 1500)
-          std::istringstream ss(vtkPlusCommand::GetUidFromCommandDeviceName(deviceName));
-          ss >> uid;
-#else
-          uid = std::stoi(vtkPlusCommand::GetUidFromCommandDeviceName(deviceName));
-#endif
-        }
-        catch (std::invalid_argument e)
-        {
-          LOG_ERROR("Unable to extract command UID from device name string.");
-          // Removing support for malformed command strings, reply with error
-          self->PlusCommandProcessor->QueueStringResponse(PLUS_FAIL, std::string(vtkPlusCommand::DEVICE_NAME_REPLY), clientId, "Malformed DeviceName. Expected CMD_cmdId (ex: CMD_001)");
-          continue;
-        }
+    if (bytesReceived == 0)
+    {
+      // No more data is available, the rest of the message will be received when it arrives
+      break;
+    }
+  }
 
-        deviceName = vtkPlusCommand::GetPrefixFromCommandDeviceName(deviceName);
+#ifdef TCP_QUICKACK
+  if (dataReceived && client->TcpQuickAck)
+  {
+    std::string errorMessage;
+    SetIntegerSocketOption(socketDescriptor, IPPROTO_TCP, TCP_QUICKACK, 1, errorMessage);
+  }
+#endif
 
-        if (std::find(previousCommandIds.begin(), previousCommandIds.end(), uid) != previousCommandIds.end())
-        {
-          // Command already exists
-          LOG_WARNING("Already received a command with id = " << uid << " from client " << clientId << ". This repeated command will be ignored.");
-          continue;
-        }
-        // New command, remember its ID
-        previousCommandIds.push_back(uid);
-        if (previousCommandIds.size() > NUMBER_OF_RECENT_COMMAND_IDS_STORED)
-        {
-          previousCommandIds.pop_front();
-        }
+  return status;
+}
 
-        LOG_DEBUG("Received command from client " << clientId << ", device " << deviceName << " with UID " << uid << ": " << stringMsg->GetString());
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkServer::ProcessMessageFromClient(ClientData& client, igtl::MessageHeader::Pointer headerMsg, igtl::MessageBase::Pointer bodyMessage, bool bodyUnpacked)
+{
+  int clientId = client.ClientId;
 
-        vtkSmartPointer<vtkXMLDataElement> cmdElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(stringMsg->GetString()));
-        std::string commandName = std::string(cmdElement->GetAttribute("Name") == NULL ? "" : cmdElement->GetAttribute("Name"));
+  // Keep track of the highest known version of message ever sent by this client, this is the version that we reply with
+  // (upper bounded by the servers version)
+  if (headerMsg->GetHeaderVersion() > client.ClientInfo.GetClientHeaderVersion())
+  {
+    client.ClientInfo.SetClientHeaderVersion(std::min<int>(this->GetIGTLHeaderVersion(), headerMsg->GetHeaderVersion()));
+  }
 
-        self->PlusCommandProcessor->QueueCommand(false, clientId, commandName, stringMsg->GetString(), deviceName, uid, stringMsg->GetMetaData());
+  if (typeid(*bodyMessage) == typeid(igtl::PlusClientInfoMessage))
+  {
+    igtl::PlusClientInfoMessage::Pointer clientInfoMsg = dynamic_cast<igtl::PlusClientInfoMessage*>(bodyMessage.GetPointer());
+    if (bodyUnpacked)
+    {
+      // The frame counters are maintained by the server
+      unsigned long numberOfSentFrames = client.ClientInfo.GetNumberOfSentFrames();
+      unsigned long numberOfDroppedFrames = client.ClientInfo.GetNumberOfDroppedFrames();
+      client.ClientInfo = clientInfoMsg->GetClientInfo();
+      client.ClientInfo.SetNumberOfSentFrames(numberOfSentFrames);
+      client.ClientInfo.SetNumberOfDroppedFrames(numberOfDroppedFrames);
+      // The new client info has full quality, the overload quality level is applied to it again with the next frame
+      client.OverloadQualityLevel = 0;
+      this->ApplySocketOptions(client);
+      if (!this->IsOutputChannelPublished(client.ClientInfo.GetOutputChannelId()))
+      {
+        LOG_WARNING("Client " << clientId << " requested output channel " << client.ClientInfo.GetOutputChannelId() << ", which is not published by the server. No data will be sent to the client.");
       }
-
+      LOG_DEBUG("Client info message received from client " << clientId);
     }
-    else if (typeid(*bodyMessage) == typeid(igtl::CommandMessage))
-    {
-      igtl::CommandMessage::Pointer commandMsg = dynamic_cast<igtl::CommandMessage*>(bodyMessage.GetPointer());
-      commandMsg->SetMessageHeader(headerMsg);
-      commandMsg->AllocateBuffer();
-      clientSocket->Receive(commandMsg->GetBufferBodyPointer(), commandMsg->GetBufferBodySize());
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::GetStatusMessage))
+  {
+    // Just ping server, respond
 
-      int c = commandMsg->Unpack(self->IgtlMessageCrcCheckEnabled);
-      if (c & igtl::MessageHeader::UNPACK_BODY || commandMsg->GetBufferBodySize() == 0)
-      {
-        std::string deviceName(headerMsg->GetDeviceName());
+    igtl::StatusMessage::Pointer replyMsg = dynamic_cast<igtl::StatusMessage*>(this->IgtlMessageFactory->CreateSendMessage("STATUS", client.ClientInfo.GetClientHeaderVersion()).GetPointer());
+    replyMsg->SetCode(igtl::StatusMessage::STATUS_OK);
+    replyMsg->Pack();
+    this->SendToClient(client, replyMsg.GetPointer());
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::StringMessage)
+           && vtkPlusCommand::IsCommandDeviceName(headerMsg->GetDeviceName()))
+  {
+    igtl::StringMessage::Pointer stringMsg = dynamic_cast<igtl::StringMessage*>(bodyMessage.GetPointer());
 
-        uint32_t uid;
-        uid = commandMsg->GetCommandId();
+    // We are receiving old style commands, handle it
+    if (bodyUnpacked)
+    {
+      std::string deviceName(headerMsg->GetDeviceName());
+      if (deviceName.empty())
+      {
+        this->PlusCommandProcessor->QueueStringResponse(PLUS_FAIL, std::string(vtkPlusCommand::DEVICE_NAME_REPLY), clientId, "Unable to read DeviceName.");
+        return PLUS_FAIL;
+      }
 
-        if (std::find(previousCommandIds.begin(), previousCommandIds.end(), uid) != previousCommandIds.end())
-        {
-          // Command already exists
-          LOG_WARNING("Already received a command with id = " << uid << " from client " << clientId << ". This repeated command will be ignored.");
-          continue;
-        }
-        // New command, remember its ID
-        previousCommandIds.push_back(uid);
-        if (previousCommandIds.size() > NUMBER_OF_RECENT_COMMAND_IDS_STORED)
-        {
-          previousCommandIds.pop_front();
-        }
+      uint32_t uid(0);
+      try
+      {
+#if (_MSC_VER == 1500)
+        std::istringstream ss(vtkPlusCommand::GetUidFromCommandDeviceName(deviceName));
+        ss >> uid;
+#else
+        uid = std::stoi(vtkPlusCommand::GetUidFromCommandDeviceName(deviceName));
+#endif
+      }
+      catch (std::invalid_argument e)
+      {
+        LOG_ERROR("Unable to extract command UID from device name string.");
+        // Removing support for malformed command strings, reply with error
+        this->PlusCommandProcessor->QueueStringResponse(PLUS_FAIL, std::string(vtkPlusCommand::DEVICE_NAME_REPLY), clientId, "Malformed DeviceName. Expected CMD_cmdId (ex: CMD_001)");
+        return PLUS_FAIL;
+      }
 
-        LOG_DEBUG("Received header version " << commandMsg->GetHeaderVersion() << " command " << commandMsg->GetCommandName()
-                  << " from client " << clientId << ", device " << deviceName << " with UID " << uid << ": " << commandMsg->GetCommandContent());
+      deviceName = vtkPlusCommand::GetPrefixFromCommandDeviceName(deviceName);
 
-        self->PlusCommandProcessor->QueueCommand(true, clientId, commandMsg->GetCommandName(), commandMsg->GetCommandContent(), deviceName, uid, commandMsg->GetMetaData());
+      if (std::find(client.PreviousCommandIds.begin(), client.PreviousCommandIds.end(), uid) != client.PreviousCommandIds.end())
+      {
+        // Command already exists
+        LOG_WARNING("Already received a command with id = " << uid << " from client " << clientId << ". This repeated command will be ignored.");
+        return PLUS_SUCCESS;
       }
-      else
+      // New command, remember its ID
+      client.PreviousCommandIds.push_back(uid);
+      if (client.PreviousCommandIds.size() > NUMBER_OF_RECENT_COMMAND_IDS_STORED)
       {
-        LOG_ERROR("STRING message unpacking failed for client " << clientId);
+        client.PreviousCommandIds.pop_front();
       }
+
+      LOG_DEBUG("Received command from client " << clientId << ", device " << deviceName << " with UID " << uid << ": " << stringMsg->GetString());
+
+      vtkSmartPointer<vtkXMLDataElement> cmdElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(stringMsg->GetString()));
+      std::string commandName = std::string(cmdElement->GetAttribute("Name") == NULL ? "" : cmdElement->GetAttribute("Name"));
+
+      this->PlusCommandProcessor->QueueCommand(false, clientId, commandName, stringMsg->GetString(), deviceName, uid, stringMsg->GetMetaData());
     }
-    else if (typeid(*bodyMessage) == typeid(igtl::StartTrackingDataMessage))
-    {
-      std::string deviceName("");
 
-      igtl::StartTrackingDataMessage::Pointer startTracking = dynamic_cast<igtl::StartTrackingDataMessage*>(bodyMessage.GetPointer());
-      startTracking->SetMessageHeader(headerMsg);
-      startTracking->AllocateBuffer();
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::CommandMessage))
+  {
+    igtl::CommandMessage::Pointer commandMsg = dynamic_cast<igtl::CommandMessage*>(bodyMessage.GetPointer());
+    if (bodyUnpacked)
+    {
+      std::string deviceName(headerMsg->GetDeviceName());
 
-      clientSocket->Receive(startTracking->GetBufferBodyPointer(), startTracking->GetBufferBodySize());
+      uint32_t uid;
+      uid = commandMsg->GetCommandId();
 
-      int c = startTracking->Unpack(self->IgtlMessageCrcCheckEnabled);
-      if (c & igtl::MessageHeader::UNPACK_BODY || startTracking->GetBufferBodySize() == 0)
+      if (std::find(client.PreviousCommandIds.begin(), client.PreviousCommandIds.end(), uid) != client.PreviousCommandIds.end())
       {
-        client->ClientInfo.SetTDATAResolution(startTracking->GetResolution());
-        client->ClientInfo.SetTDATARequested(true);
+        // Command already exists
+        LOG_WARNING("Already received a command with id = " << uid << " from client " << clientId << ". This repeated command will be ignored.");
+        return PLUS_SUCCESS;
       }
-      else
+      // New command, remember its ID
+      client.PreviousCommandIds.push_back(uid);
+      if (client.PreviousCommandIds.size() > NUMBER_OF_RECENT_COMMAND_IDS_STORED)
       {
-        LOG_ERROR("Client " << clientId << " STT_TDATA failed: could not retrieve startTracking message");
-        return NULL;
+        client.PreviousCommandIds.pop_front();
       }
 
-      igtl::MessageBase::Pointer msg = self->IgtlMessageFactory->CreateSendMessage("RTS_TDATA", client->ClientInfo.GetClientHeaderVersion());
-      igtl::RTSTrackingDataMessage* rtsMsg = dynamic_cast<igtl::RTSTrackingDataMessage*>(msg.GetPointer());
-      rtsMsg->SetStatus(0);
-      rtsMsg->Pack();
-      self->QueueMessageResponseForClient(client->ClientId, msg);
+      LOG_DEBUG("Received header version " << commandMsg->GetHeaderVersion() << " command " << commandMsg->GetCommandName()
+                << " from client " << clientId << ", device " << deviceName << " with UID " << uid << ": " << commandMsg->GetCommandContent());
+
+      this->PlusCommandProcessor->QueueCommand(true, clientId, commandMsg->GetCommandName(), commandMsg->GetCommandContent(), deviceName, uid, commandMsg->GetMetaData());
     }
-    else if (typeid(*bodyMessage) == typeid(igtl::StopTrackingDataMessage))
+    else
     {
-      igtl::StopTrackingDataMessage::Pointer stopTracking = dynamic_cast<igtl::StopTrackingDataMessage*>(bodyMessage.GetPointer());
-      stopTracking->SetMessageHeader(headerMsg);
-      stopTracking->AllocateBuffer();
-
-      clientSocket->Receive(stopTracking->GetBufferBodyPointer(), stopTracking->GetBufferBodySize());
+      LOG_ERROR("STRING message unpacking failed for client " << clientId);
+    }
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::StartTrackingDataMessage))
+  {
+    std::string deviceName("");
 
-      client->ClientInfo.SetTDATARequested(false);
-      igtl::MessageBase::Pointer msg = self->IgtlMessageFactory->CreateSendMessage("RTS_TDATA", client->ClientInfo.GetClientHeaderVersion());
-      igtl::RTSTrackingDataMessage* rtsMsg = dynamic_cast<igtl::RTSTrackingDataMessage*>(msg.GetPointer());
-      rtsMsg->SetStatus(0);
-      rtsMsg->Pack();
-      self->QueueMessageResponseForClient(client->ClientId, msg);
+    igtl::StartTrackingDataMessage::Pointer startTracking = dynamic_cast<igtl::StartTrackingDataMessage*>(bodyMessage.GetPointer());
+    if (bodyUnpacked)
+    {
+      client.ClientInfo.SetTDATAResolution(startTracking->GetResolution());
+      client.ClientInfo.SetTDATARequested(true);
     }
-    else if (typeid(*bodyMessage) == typeid(igtl::GetPolyDataMessage))
+    else
     {
-      igtl::GetPolyDataMessage::Pointer polyDataMessage = dynamic_cast<igtl::GetPolyDataMessage*>(bodyMessage.GetPointer());
-      polyDataMessage->SetMessageHeader(headerMsg);
-      polyDataMessage->AllocateBuffer();
-
-      clientSocket->Receive(polyDataMessage->GetBufferBodyPointer(), polyDataMessage->GetBufferBodySize());
+      LOG_ERROR("Client " << clientId << " STT_TDATA failed: could not retrieve startTracking message");
+      return PLUS_FAIL;
+    }
 
-      int c = polyDataMessage->Unpack(self->IgtlMessageCrcCheckEnabled);
-      if (c & igtl::MessageHeader::UNPACK_BODY || polyDataMessage->GetBufferBodySize() == 0)
+    igtl::MessageBase::Pointer msg = this->IgtlMessageFactory->CreateSendMessage("RTS_TDATA", client.ClientInfo.GetClientHeaderVersion());
+    igtl::RTSTrackingDataMessage* rtsMsg = dynamic_cast<igtl::RTSTrackingDataMessage*>(msg.GetPointer());
+    rtsMsg->SetStatus(0);
+    rtsMsg->Pack();
+    this->QueueMessageResponseForClient(client.ClientId, msg);
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::StopTrackingDataMessage))
+  {
+    igtl::StopTrackingDataMessage::Pointer stopTracking = dynamic_cast<igtl::StopTrackingDataMessage*>(bodyMessage.GetPointer());
+
+    client.ClientInfo.SetTDATARequested(false);
+    igtl::MessageBase::Pointer msg = this->IgtlMessageFactory->CreateSendMessage("RTS_TDATA", client.ClientInfo.GetClientHeaderVersion());
+    igtl::RTSTrackingDataMessage* rtsMsg = dynamic_cast<igtl::RTSTrackingDataMessage*>(msg.GetPointer());
+    rtsMsg->SetStatus(0);
+    rtsMsg->Pack();
+    this->QueueMessageResponseForClient(client.ClientId, msg);
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::GetPolyDataMessage))
+  {
+    igtl::GetPolyDataMessage::Pointer polyDataMessage = dynamic_cast<igtl::GetPolyDataMessage*>(bodyMessage.GetPointer());
+    if (bodyUnpacked)
+    {
+      std::string fileName;
+      // Check metadata for requisite parameters, if absent, check deviceName
+      if (polyDataMessage->GetHeaderVersion() > IGTL_HEADER_VERSION_1)
       {
-        std::string fileName;
-        // Check metadata for requisite parameters, if absent, check deviceName
-        if (polyDataMessage->GetHeaderVersion() > IGTL_HEADER_VERSION_1)
-        {
-          if (!polyDataMessage->GetMetaDataElement("filename", fileName))
-          {
-            fileName = polyDataMessage->GetDeviceName();
-            if (fileName.empty())
-            {
-              LOG_ERROR("GetPolyData message sent with no filename in either metadata or deviceName field.");
-              continue;
-            }
-          }
-        }
-        else
+        if (!polyDataMessage->GetMetaDataElement("filename", fileName))
         {
           fileName = polyDataMessage->GetDeviceName();
           if (fileName.empty())
           {
             LOG_ERROR("GetPolyData message sent with no filename in either metadata or deviceName field.");
-            continue;
+            return PLUS_FAIL;
           }
         }
-
-        vtkSmartPointer<vtkPolyDataReader> reader = vtkSmartPointer<vtkPolyDataReader>::New();
-        reader->SetFileName(fileName.c_str());
-        reader->Update();
-
-        auto polyData = reader->GetOutput();
-        if (polyData != nullptr)
+      }
+      else
+      {
+        fileName = polyDataMessage->GetDeviceName();
+        if (fileName.empty())
         {
-          igtl::MessageBase::Pointer msg = self->IgtlMessageFactory->CreateSendMessage("POLYDATA", client->ClientInfo.GetClientHeaderVersion());
-          igtl::PolyDataMessage* polyMsg = dynamic_cast<igtl::PolyDataMessage*>(msg.GetPointer());
+          LOG_ERROR("GetPolyData message sent with no filename in either metadata or deviceName field.");
+          return PLUS_FAIL;
+        }
+      }
 
-          igtlioPolyDataConverter::ContentData data;
-          data.deviceName = "PlusServer";
-          data.polydata = polyData;
+      vtkSmartPointer<vtkPolyData> polyData;
+      std::string cacheKey;
+      std::string errorMessage;
+      if (this->PolydataCache->GetPolyData(fileName, 0.0, polyData, cacheKey, errorMessage) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Client " << clientId << " GET_POLYDATA failed: " << errorMessage);
+      }
+      if (polyData != nullptr)
+      {
+        igtl::MessageBase::Pointer msg = this->IgtlMessageFactory->CreateSendMessage("POLYDATA", client.ClientInfo.GetClientHeaderVersion());
+        igtl::PolyDataMessage* polyMsg = dynamic_cast<igtl::PolyDataMessage*>(msg.GetPointer());
 
-          igtlioBaseConverter::HeaderData header;
-          header.deviceName = "PlusServer";
+        igtlioPolyDataConverter::ContentData data;
+        data.deviceName = "PlusServer";
+        data.polydata = polyData;
 
-          igtlioPolyDataConverter::toIGTL(header, data, (igtl::PolyDataMessage::Pointer*)&msg);
-          if (!msg->SetMetaDataElement("fileName", IANA_TYPE_US_ASCII, fileName))
-          {
-            LOG_ERROR("Filename too long to be sent back to client. Aborting.");
-            continue;
-          }
-          self->QueueMessageResponseForClient(client->ClientId, msg);
-          continue;
+        igtlioBaseConverter::HeaderData header;
+        header.deviceName = "PlusServer";
+
+        igtlioPolyDataConverter::toIGTL(header, data, (igtl::PolyDataMessage::Pointer*)&msg);
+        if (!msg->SetMetaDataElement("fileName", IANA_TYPE_US_ASCII, fileName))
+        {
+          LOG_ERROR("Filename too long to be sent back to client. Aborting.");
+          return PLUS_FAIL;
         }
+        this->QueueMessageResponseForClient(client.ClientId, msg);
+        return PLUS_SUCCESS;
+      }
 
-        igtl::MessageBase::Pointer msg = self->IgtlMessageFactory->CreateSendMessage("RTS_POLYDATA", polyDataMessage->GetHeaderVersion());
-        igtl::RTSPolyDataMessage* rtsPolyMsg = dynamic_cast<igtl::RTSPolyDataMessage*>(msg.GetPointer());
-        rtsPolyMsg->SetStatus(false);
-        self->QueueMessageResponseForClient(client->ClientId, rtsPolyMsg);
+      igtl::MessageBase::Pointer msg = this->IgtlMessageFactory->CreateSendMessage("RTS_POLYDATA", polyDataMessage->GetHeaderVersion());
+      igtl::RTSPolyDataMessage* rtsPolyMsg = dynamic_cast<igtl::RTSPolyDataMessage*>(msg.GetPointer());
+      rtsPolyMsg->SetStatus(false);
+      this->QueueMessageResponseForClient(client.ClientId, rtsPolyMsg);
+    }
+    else
+    {
+      LOG_ERROR("Client " << clientId << " GET_POLYDATA failed: could not retrieve message");
+      return PLUS_FAIL;
+    }
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::StatusMessage))
+  {
+    // status message is used as a keep-alive, don't do anything
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::GetImageMetaMessage))
+  {
+    igtl::GetImageMetaMessage::Pointer getImageMetaMsg = dynamic_cast<igtl::GetImageMetaMessage*>(bodyMessage.GetPointer());
+    if (bodyUnpacked)
+    {
+      // Image meta message
+      std::string deviceName("");
+      if (headerMsg->GetDeviceName() != NULL)
+      {
+        deviceName = headerMsg->GetDeviceName();
+      }
+      this->PlusCommandProcessor->QueueGetImageMetaData(clientId, deviceName);
+    }
+    else
+    {
+      LOG_ERROR("Client " << clientId << " GET_IMGMETA failed: could not retrieve message");
+      return PLUS_FAIL;
+    }
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::GetImageMessage))
+  {
+    igtl::GetImageMessage::Pointer getImageMsg = dynamic_cast<igtl::GetImageMessage*>(bodyMessage.GetPointer());
+    if (bodyUnpacked)
+    {
+      std::string deviceName("");
+      if (headerMsg->GetDeviceName() != NULL)
+      {
+        deviceName = headerMsg->GetDeviceName();
       }
       else
       {
-        LOG_ERROR("Client " << clientId << " GET_POLYDATA failed: could not retrieve message");
-        return NULL;
+        LOG_ERROR("Please select the image you want to acquire");
+        return PLUS_FAIL;
       }
+      this->PlusCommandProcessor->QueueGetImage(clientId, deviceName);
     }
-    else if (typeid(*bodyMessage) == typeid(igtl::StatusMessage))
+    else
     {
-      // status message is used as a keep-alive, don't do anything
-      clientSocket->Skip(headerMsg->GetBodySizeToRead(), 0);
+      LOG_ERROR("Client " << clientId << " GET_IMAGE failed: could not retrieve message");
+      return PLUS_FAIL;
     }
-    else if (typeid(*bodyMessage) == typeid(igtl::GetImageMetaMessage))
+
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::GetPointMessage))
+  {
+    igtl::GetPointMessage* getPointMsg = dynamic_cast<igtl::GetPointMessage*>(bodyMessage.GetPointer());
+    if (bodyUnpacked)
     {
-      igtl::GetImageMetaMessage::Pointer getImageMetaMsg = dynamic_cast<igtl::GetImageMetaMessage*>(bodyMessage.GetPointer());
-      getImageMetaMsg->SetMessageHeader(headerMsg);
-      getImageMetaMsg->AllocateBuffer();
+      std::string fileName;
+      if (!getPointMsg->GetMetaDataElement("Filename", fileName))
+      {
+        fileName = getPointMsg->GetDeviceName();
+      }
 
-      clientSocket->Receive(getImageMetaMsg->GetBufferBodyPointer(), getImageMetaMsg->GetBufferBodySize());
+      if (igsioCommon::Tail(fileName, 4) != "fcsv")
+      {
+        LOG_WARNING("Filename does not end in fcsv. GetPoint behaviour may not function correctly.");
+      }
 
-      int c = getImageMetaMsg->Unpack(self->IgtlMessageCrcCheckEnabled);
-      if (c & igtl::MessageHeader::UNPACK_BODY || getImageMetaMsg->GetBufferBodySize() == 0)
+      if (!vtksys::SystemTools::FileExists(fileName) &&
+          !vtksys::SystemTools::FileExists(vtkPlusConfig::GetInstance()->GetImagePath(fileName)))
       {
-        // Image meta message
-        std::string deviceName("");
-        if (headerMsg->GetDeviceName() != NULL)
+        LOG_ERROR("File: " << fileName << " requested but does not exist. Cannot get POINT data from it.");
+        return PLUS_FAIL;
+      }
+
+      igtl::MessageBase::Pointer msg = this->IgtlMessageFactory->CreateSendMessage("POINT", client.ClientInfo.GetClientHeaderVersion());
+      igtl::PointMessage* pointMsg = dynamic_cast<igtl::PointMessage*>(msg.GetPointer());
+
+      std::ifstream t(fileName);
+      if (!t.is_open())
+      {
+        t.open(vtkPlusConfig::GetInstance()->GetImagePath(fileName));
+        if (!t.is_open())
         {
-          deviceName = headerMsg->GetDeviceName();
+          LOG_ERROR("Cannot read file: " << fileName);
+          return PLUS_FAIL;
         }
-        self->PlusCommandProcessor->QueueGetImageMetaData(clientId, deviceName);
       }
-      else
+      std::stringstream buffer;
+      buffer << t.rdbuf();
+      std::vector<std::string> lines = igsioCommon::SplitStringIntoTokens(buffer.str(), '\n', false);
+      for (std::vector<std::string>::iterator it = lines.begin(); it != lines.end(); ++it)
       {
-        LOG_ERROR("Client " << clientId << " GET_IMGMETA failed: could not retrieve message");
-        return NULL;
+        std::string line = igsioCommon::Trim(*it);
+        if (line[0] == '#')
+        {
+          continue;
+        }
+
+        std::vector<std::string> tokens = igsioCommon::SplitStringIntoTokens(line, ',', true);
+        igtl::PointElement::Pointer elem = igtl::PointElement::New();
+        elem->SetPosition(std::stof(tokens[1]), std::stof(tokens[2]), std::stof(tokens[3]));
+        elem->SetName(tokens[0].c_str());
+        elem->SetGroupName("Point");
+        pointMsg->AddPointElement(elem);
       }
+
+      this->QueueMessageResponseForClient(client.ClientId, pointMsg);
     }
-    else if (typeid(*bodyMessage) == typeid(igtl::GetImageMessage))
+    else
     {
-      igtl::GetImageMessage::Pointer getImageMsg = dynamic_cast<igtl::GetImageMessage*>(bodyMessage.GetPointer());
-      getImageMsg->SetMessageHeader(headerMsg);
-      getImageMsg->AllocateBuffer();
+      LOG_ERROR("Client " << clientId << " GET_POINT failed: could not retrieve message");
+      return PLUS_FAIL;
+    }
+  }
+  else
+  {
+    // if the device type is unknown, the message is skipped
+    LOG_WARNING("Unknown OpenIGTLink message is received from client " << clientId << ". Device type: " << headerMsg->GetMessageType()
+                << ". Device name: " << headerMsg->GetDeviceName() << ".");
+  }
 
-      clientSocket->Receive(getImageMsg->GetBufferBodyPointer(), getImageMsg->GetBufferBodySize());
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkServer::SendTrackedFrame(igsioTrackedFrame& trackedFrame, int outputChannelIndex)
+{
+  int numberOfErrors = 0;
+
+  // Update transform repository with the tracked frame
+  if (this->TransformRepository != NULL)
+  {
+    if (this->TransformRepository->SetTransforms(trackedFrame) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to set current transforms to transform repository");
+      numberOfErrors++;
+    }
+  }
 
-      int c = getImageMsg->Unpack(self->IgtlMessageCrcCheckEnabled);
-      if (c & igtl::MessageHeader::UNPACK_BODY || getImageMsg->GetBufferBodySize() == 0)
+  // Convert relative timestamp to UTC
+  double timestampSystem = trackedFrame.GetTimestamp(); // save original timestamp, we'll restore it later
+  double timestampUniversal = vtkIGSIOAccurateTimer::GetUniversalTimeFromSystemTime(timestampSystem);
+  trackedFrame.SetTimestamp(timestampUniversal);
+
+  vtkPlusChannel* outputChannel = this->OutputChannels[outputChannelIndex].Channel;
+  const bool latencyTracingEnabled = LatencyTracer::IsEnabled() && outputChannel != NULL && outputChannel->GetChannelId() != NULL;
+
+  // If the channel is received from another server in relay mode then the received message of the frame is forwarded as it is
+  igtl::MessageBase::Pointer relayedMessage;
+  vtkPlusOpenIGTLinkDevice* relayDevice = (outputChannel != NULL ? vtkPlusOpenIGTLinkDevice::SafeDownCast(outputChannel->GetOwnerDevice()) : NULL);
+  if (relayDevice != NULL && relayDevice->GetRelayReceivedMessages())
+  {
+    relayedMessage = relayDevice->GetRelayedMessage(timestampSystem);
+  }
+
+  std::vector<int> disconnectedClientIds;
+  {
+    // Lock before we send message to the clients
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
+
+    // Clients that are subscribed to the same messages receive the same packed messages,
+    // so that the messages are packed once per distinct subscription instead of once per client
+    struct PackedMessageGroup
+    {
+      const PlusIgtlClientInfo* ClientInfo;
+      int PackingClientId;
+      std::vector<igtl::MessageBase::Pointer> IgtlMessages;
+      double PackStartTime;
+      double PackedTime;
+    };
+    std::vector<PackedMessageGroup> packedMessageGroups;
+    std::vector<std::pair<ClientData*, size_t> > clientMessageGroups;
+
+    // Pack the messages (the client infos are not modified until all the messages are packed)
+    for (std::list<ClientData>::iterator clientIterator = this->IgtlClients.begin(); clientIterator != this->IgtlClients.end(); ++clientIterator)
+    {
+      if (this->GetOutputChannelIndex(clientIterator->ClientInfo) != outputChannelIndex)
+      {
+        continue;
+      }
+      size_t groupIndex = 0;
+      for (; groupIndex < packedMessageGroups.size(); ++groupIndex)
       {
-        std::string deviceName("");
-        if (headerMsg->GetDeviceName() != NULL)
+        if (packedMessageGroups[groupIndex].ClientInfo->IsSubscriptionEquivalent(clientIterator->ClientInfo))
         {
-          deviceName = headerMsg->GetDeviceName();
+          break;
         }
-        else
+      }
+      if (groupIndex == packedMessageGroups.size())
+      {
+        // Create IGT messages
+        PackedMessageGroup group;
+        group.ClientInfo = &(clientIterator->ClientInfo);
+        group.PackingClientId = clientIterator->ClientId;
+        group.PackStartTime = (latencyTracingEnabled ? vtkIGSIOAccurateTimer::GetSystemTime() : 0);
+        if (relayedMessage.IsNotNull() && IsRelayedMessageRequested(clientIterator->ClientInfo, relayedMessage, trackedFrame.GetTimestamp()))
         {
-          LOG_ERROR("Please select the image you want to acquire");
-          return NULL;
+          // The other subscribed messages are packed from the tracked frame, the relayed message is not packed again
+          PlusIgtlClientInfo packingClientInfo = clientIterator->ClientInfo;
+          std::string relayedMessageType = relayedMessage->GetMessageType();
+          for (std::vector<std::string>::iterator messageTypeIt = packingClientInfo.IgtlMessageTypes.begin(); messageTypeIt != packingClientInfo.IgtlMessageTypes.end();)
+          {
+            messageTypeIt = (igsioCommon::IsEqualInsensitive(*messageTypeIt, relayedMessageType) ? packingClientInfo.IgtlMessageTypes.erase(messageTypeIt) : messageTypeIt + 1);
+          }
+          if (this->IgtlMessageFactory->PackMessages(clientIterator->ClientId, packingClientInfo, group.IgtlMessages, trackedFrame, this->SendValidTransformsOnly, this->TransformRepository) != PLUS_SUCCESS)
+          {
+            LOG_WARNING("Failed to pack all IGT messages");
+          }
+          group.IgtlMessages.push_back(relayedMessage);
         }
-        self->PlusCommandProcessor->QueueGetImage(clientId, deviceName);
+        else if (this->IgtlMessageFactory->PackMessages(clientIterator->ClientId, clientIterator->ClientInfo, group.IgtlMessages, trackedFrame, this->SendValidTransformsOnly, this->TransformRepository) != PLUS_SUCCESS)
+        {
+          LOG_WARNING("Failed to pack all IGT messages");
+        }
+        group.PackedTime = (latencyTracingEnabled ? vtkIGSIOAccurateTimer::GetSystemTime() : 0);
+        packedMessageGroups.push_back(group);
       }
-      else
+      clientMessageGroups.push_back(std::make_pair(&(*clientIterator), groupIndex));
+    }
+
+    for (std::vector<std::pair<ClientData*, size_t> >::iterator clientGroupIterator = clientMessageGroups.begin(); clientGroupIterator != clientMessageGroups.end(); ++clientGroupIterator)
+    {
+      ClientData* client = clientGroupIterator->first;
+      const PackedMessageGroup& group = packedMessageGroups[clientGroupIterator->second];
+
+      // Send all messages to a client at once
+      bool clientDisconnected = false;
+      if (this->SendTrackedFrameToClient(*client, group.IgtlMessages, group.PackingClientId, timestampSystem) != PLUS_SUCCESS)
       {
-        LOG_ERROR("Client " << clientId << " GET_IMAGE failed: could not retrieve message");
-        return NULL;
+        disconnectedClientIds.push_back(client->ClientId);
+        LOG_INFO("Client disconnected - could not send " << group.IgtlMessages.size() << " messages to client " << client->ClientId
+                 << " (Timestamp: " << std::fixed << trackedFrame.GetTimestamp() << ").");
+        clientDisconnected = true;
+      }
+      else if (!group.IgtlMessages.empty())
+      {
+        // Update the TDATA timestamp, even if TDATA isn't sent (cheaper than checking for existing TDATA message type)
+        client->ClientInfo.SetLastTDATASentTimeStamp(trackedFrame.GetTimestamp());
+      }
+      if (!clientDisconnected)
+      {
+        client->ClientInfo.UpdateImageFrameState(trackedFrame.GetTimestamp());
+        client->ClientInfo.UpdateCoalescedTransformsState(trackedFrame.GetTimestamp());
+        client->ClientInfo.UpdateStringFieldsState(trackedFrame);
+        this->UpdateAdaptiveStreaming(*client);
+        this->UpdateOverloadStreaming(*client);
       }
 
+      if (latencyTracingEnabled && !clientDisconnected && !group.IgtlMessages.empty())
+      {
+        LatencyTracer::GetInstance().RecordFrameSent(outputChannel->GetChannelId(), client->ClientId, timestampSystem,
+            group.PackStartTime, group.PackedTime, vtkIGSIOAccurateTimer::GetSystemTime());
+      }
     }
-    else if (typeid(*bodyMessage) == typeid(igtl::GetPointMessage))
-    {
-      igtl::GetPointMessage* getPointMsg = dynamic_cast<igtl::GetPointMessage*>(bodyMessage.GetPointer());
-      getPointMsg->SetMessageHeader(headerMsg);
-      getPointMsg->AllocateBuffer();
+  }
 
-      clientSocket->Receive(getPointMsg->GetBufferBodyPointer(), getPointMsg->GetBufferBodySize());
+  // Clean up disconnected clients
+  for (std::vector< int >::iterator it = disconnectedClientIds.begin(); it != disconnectedClientIds.end(); ++it)
+  {
+    DisconnectClient(*it);
+  }
 
-      int c = getPointMsg->Unpack(self->IgtlMessageCrcCheckEnabled);
-      if (c & igtl::MessageHeader::UNPACK_BODY || getPointMsg->GetBufferBodySize() == 0)
-      {
-        std::string fileName;
-        if (!getPointMsg->GetMetaDataElement("Filename", fileName))
-        {
-          fileName = getPointMsg->GetDeviceName();
-        }
+  // The UDP output is sent from the default channel
+  if (outputChannelIndex == 0 && this->SendTrackedFrameToUdpOutput(trackedFrame) != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
 
-        if (igsioCommon::Tail(fileName, 4) != "fcsv")
-        {
-          LOG_WARNING("Filename does not end in fcsv. GetPoint behaviour may not function correctly.");
-        }
+  // restore original timestamp
+  trackedFrame.SetTimestamp(timestampSystem);
 
-        if (!vtksys::SystemTools::FileExists(fileName) &&
-            !vtksys::SystemTools::FileExists(vtkPlusConfig::GetInstance()->GetImagePath(fileName)))
-        {
-          LOG_ERROR("File: " << fileName << " requested but does not exist. Cannot get POINT data from it.");
-          return NULL;
-        }
+  return (numberOfErrors == 0 ? PLUS_SUCCESS : PLUS_FAIL);
+}
 
-        igtl::MessageBase::Pointer msg = self->IgtlMessageFactory->CreateSendMessage("POINT", client->ClientInfo.GetClientHeaderVersion());
-        igtl::PointMessage* pointMsg = dynamic_cast<igtl::PointMessage*>(msg.GetPointer());
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkServer::SendTrackedFrameToUdpOutput(igsioTrackedFrame& trackedFrame)
+{
+  if (!this->UdpOutputSocket.IsOpen())
+  {
+    return PLUS_SUCCESS;
+  }
 
-        std::ifstream t(fileName);
-        if (!t.is_open())
-        {
-          t.open(vtkPlusConfig::GetInstance()->GetImagePath(fileName));
-          if (!t.is_open())
-          {
-            LOG_ERROR("Cannot read file: " << fileName);
-            return NULL;
-          }
-        }
-        std::stringstream buffer;
-        buffer << t.rdbuf();
-        std::vector<std::string> lines = igsioCommon::SplitStringIntoTokens(buffer.str(), '\n', false);
-        for (std::vector<std::string>::iterator it = lines.begin(); it != lines.end(); ++it)
-        {
-          std::string line = igsioCommon::Trim(*it);
-          if (line[0] == '#')
-          {
-            continue;
-          }
+  std::vector<igtl::MessageBase::Pointer> igtlMessages;
+  if (this->IgtlMessageFactory->PackMessages(UDP_OUTPUT_CLIENT_ID, this->UdpOutputClientInfo, igtlMessages, trackedFrame, this->SendValidTransformsOnly, this->TransformRepository) != PLUS_SUCCESS)
+  {
+    LOG_WARNING("Failed to pack all IGT messages for the UDP output");
+  }
+  if (igtlMessages.empty())
+  {
+    return PLUS_SUCCESS;
+  }
+  if (this->UdpOutputSocket.SendMessages(igtlMessages) != PLUS_SUCCESS)
+  {
+    // Datagrams are not retransmitted, the next frame is sent as usual
+    return PLUS_FAIL;
+  }
+  this->UdpOutputClientInfo.SetLastTDATASentTimeStamp(trackedFrame.GetTimestamp());
+  this->UdpOutputClientInfo.UpdateCoalescedTransformsState(trackedFrame.GetTimestamp());
+  this->UdpOutputClientInfo.UpdateStringFieldsState(trackedFrame);
+  return PLUS_SUCCESS;
+}
 
-          std::vector<std::string> tokens = igsioCommon::SplitStringIntoTokens(line, ',', true);
-          igtl::PointElement::Pointer elem = igtl::PointElement::New();
-          elem->SetPosition(std::stof(tokens[1]), std::stof(tokens[2]), std::stof(tokens[3]));
-          elem->SetName(tokens[0].c_str());
-          elem->SetGroupName("Point");
-          pointMsg->AddPointElement(elem);
-        }
+//----------------------------------------------------------------------------
+int vtkPlusOpenIGTLinkServer::SendBuffersWithoutBlocking(igtl::Socket* socket, const std::vector<SendBuffer>& buffers)
+{
+  if (buffers.empty())
+  {
+    return 0;
+  }
+  return SendGatheredWithoutBlocking(SocketDescriptorAccessor::GetSocketDescriptor(socket), buffers);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkServer::SendToClient(ClientData& client, const std::vector<igtl::MessageBase::Pointer>& messages)
+{
+  ClientData::SendQueueItem item;
+  for (std::vector<igtl::MessageBase::Pointer>::const_iterator messageIt = messages.begin(); messageIt != messages.end(); ++messageIt)
+  {
+    if (messageIt->IsNotNull() && (*messageIt)->GetBufferSize() > 0)
+    {
+      item.Messages.push_back(*messageIt);
+    }
+  }
+  if (!item.Messages.empty())
+  {
+    client.SendQueue.push_back(item);
+  }
+  return this->FlushClientSendData(client);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkServer::SendToClient(ClientData& client, igtl::MessageBase::Pointer message)
+{
+  return this->SendToClient(client, std::vector<igtl::MessageBase::Pointer>(1, message));
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkServer::SendTrackedFrameToClient(ClientData& client, const std::vector<igtl::MessageBase::Pointer>& messages, int packingClientId, double frameTimestampSystem)
+{
+  ClientData::SendQueueItem newItem;
+  newItem.TrackedFrame = true;
+  newItem.FrameTimestamp = frameTimestampSystem;
+  for (std::vector<igtl::MessageBase::Pointer>::const_iterator messageIt = messages.begin(); messageIt != messages.end(); ++messageIt)
+  {
+    if (messageIt->IsNotNull() && (*messageIt)->GetBufferSize() > 0)
+    {
+      newItem.Messages.push_back(*messageIt);
+    }
+  }
+  if (newItem.Messages.empty())
+  {
+    return this->FlushClientSendData(client);
+  }
 
-        self->QueueMessageResponseForClient(client->ClientId, pointMsg);
+  // Remove the queued messages of older frames that the new frame replaces
+  bool videoMessageDropped = false;
+  unsigned long numberOfDroppedFrames = 0;
+  for (std::deque<ClientData::SendQueueItem>::iterator itemIt = client.SendQueue.begin(); itemIt != client.SendQueue.end();)
+  {
+    if (!itemIt->TrackedFrame)
+    {
+      ++itemIt;
+      continue;
+    }
+    for (std::vector<igtl::MessageBase::Pointer>::iterator queuedIt = itemIt->Messages.begin(); queuedIt != itemIt->Messages.end();)
+    {
+      bool replaced = false;
+      for (std::vector<igtl::MessageBase::Pointer>::iterator newIt = newItem.Messages.begin(); newIt != newItem.Messages.end(); ++newIt)
+      {
+        if (strcmp((*queuedIt)->GetMessageType(), (*newIt)->GetMessageType()) == 0
+            && strcmp((*queuedIt)->GetDeviceName(), (*newIt)->GetDeviceName()) == 0)
+        {
+          replaced = true;
+          break;
+        }
       }
-      else
+      if (!replaced)
       {
-        LOG_ERROR("Client " << clientId << " GET_POINT failed: could not retrieve message");
-        return NULL;
+        ++queuedIt;
+        continue;
       }
+      if (strcmp((*queuedIt)->GetMessageType(), "VIDEO") == 0)
+      {
+        videoMessageDropped = true;
+      }
+      queuedIt = itemIt->Messages.erase(queuedIt);
     }
-    else
+    if (itemIt->Messages.empty())
     {
-      // if the device type is unknown, skip reading.
-      LOG_WARNING("Unknown OpenIGTLink message is received from client " << clientId << ". Device type: " << headerMsg->GetMessageType()
-                  << ". Device name: " << headerMsg->GetDeviceName() << ".");
-      clientSocket->Skip(headerMsg->GetBodySizeToRead(), 0);
+      numberOfDroppedFrames++;
+      itemIt = client.SendQueue.erase(itemIt);
       continue;
     }
-  } // ConnectionActive
+    ++itemIt;
+  }
+  client.SendQueue.push_back(newItem);
 
-  // Close thread
-  client->DataReceiverActive.second = false;
-  return NULL;
+  // Drop the oldest frames if the queue is still too long, control messages are always kept.
+  // Only the latest frame is kept while the memory usage soft limit is exceeded.
+  int maxNumberOfQueuedFrames = (MemoryAccounting::GetInstance().IsSoftLimitExceeded() ? 1 : std::max(this->MaxNumberOfQueuedFramesPerClient, 1));
+  int numberOfQueuedFrames = 0;
+  for (std::deque<ClientData::SendQueueItem>::iterator itemIt = client.SendQueue.begin(); itemIt != client.SendQueue.end(); ++itemIt)
+  {
+    if (itemIt->TrackedFrame)
+    {
+      numberOfQueuedFrames++;
+    }
+  }
+  for (std::deque<ClientData::SendQueueItem>::iterator itemIt = client.SendQueue.begin();
+       itemIt != client.SendQueue.end() && numberOfQueuedFrames > maxNumberOfQueuedFrames;)
+  {
+    if (!itemIt->TrackedFrame)
+    {
+      ++itemIt;
+      continue;
+    }
+    for (std::vector<igtl::MessageBase::Pointer>::iterator queuedIt = itemIt->Messages.begin(); queuedIt != itemIt->Messages.end(); ++queuedIt)
+    {
+      if (strcmp((*queuedIt)->GetMessageType(), "VIDEO") == 0)
+      {
+        videoMessageDropped = true;
+      }
+    }
+    numberOfDroppedFrames++;
+    numberOfQueuedFrames--;
+    itemIt = client.SendQueue.erase(itemIt);
+  }
+
+  if (numberOfDroppedFrames > 0)
+  {
+    LOG_TRACE("Dropped " << numberOfDroppedFrames << " frames from the send queue of client " << client.ClientId);
+    client.ClientInfo.SetNumberOfDroppedFrames(client.ClientInfo.GetNumberOfDroppedFrames() + numberOfDroppedFrames);
+  }
+  if (videoMessageDropped)
+  {
+    // Encoded frames depend on the previous ones, so the next frame sent to this client must be a key frame.
+    // The encoded frames are shared by the clients that receive the same messages, so all of them restart from the key frame.
+    this->IgtlMessageFactory->RequestVideoKeyFrames(packingClientId);
+  }
+
+  return this->FlushClientSendData(client);
 }
 
 //----------------------------------------------------------------------------
-PlusStatus vtkPlusOpenIGTLinkServer::SendTrackedFrame(igsioTrackedFrame& trackedFrame)
+PlusStatus vtkPlusOpenIGTLinkServer::FlushClientSendData(ClientData& client)
 {
-  int numberOfErrors = 0;
-
-  // Update transform repository with the tracked frame
-  if (this->TransformRepository != NULL)
+  // Pending data must be sent first to keep the order of the messages
+  std::vector<SendBuffer> buffers;
+  if (!client.PendingSendData.empty())
   {
-    if (this->TransformRepository->SetTransforms(trackedFrame) != PLUS_SUCCESS)
+    buffers.push_back(SendBuffer(client.PendingSendData.data(), static_cast<int>(client.PendingSendData.size())));
+  }
+  for (std::deque<ClientData::SendQueueItem>::iterator itemIt = client.SendQueue.begin(); itemIt != client.SendQueue.end(); ++itemIt)
+  {
+    for (std::vector<igtl::MessageBase::Pointer>::iterator messageIt = itemIt->Messages.begin(); messageIt != itemIt->Messages.end(); ++messageIt)
     {
-      LOG_ERROR("Failed to set current transforms to transform repository");
-      numberOfErrors++;
+      buffers.push_back(SendBuffer(static_cast<const char*>((*messageIt)->GetBufferPointer()), (*messageIt)->GetBufferSize()));
     }
   }
+  if (buffers.empty())
+  {
+    return PLUS_SUCCESS;
+  }
+
+  int bytesSent = SendBuffersWithoutBlocking(client.ClientSocket, buffers);
+  if (bytesSent < 0)
+  {
+    LOG_DEBUG("Failed to send data to client " << client.ClientId);
+    return PLUS_FAIL;
+  }
+  client.AdaptiveIntervalBytesSent += bytesSent;
+  if (client.SentBytesMetric)
+  {
+    client.SentBytesMetric->Increment(bytesSent);
+  }
+
+  int bytesToSkip = bytesSent;
+  if (!client.PendingSendData.empty())
+  {
+    int pendingSize = static_cast<int>(client.PendingSendData.size());
+    client.PendingSendData.erase(0, std::min(bytesToSkip, pendingSize));
+    bytesToSkip = std::max(bytesToSkip - pendingSize, 0);
+  }
 
-  // Convert relative timestamp to UTC
-  double timestampSystem = trackedFrame.GetTimestamp(); // save original timestamp, we'll restore it later
-  double timestampUniversal = vtkIGSIOAccurateTimer::GetUniversalTimeFromSystemTime(timestampSystem);
-  trackedFrame.SetTimestamp(timestampUniversal);
-
-  std::vector<int> disconnectedClientIds;
+  // Remove the items from the queue that the socket has accepted (partially), keep the unsent part in the pending data
+  double acceptedTime = -1;
+  while (bytesToSkip > 0 && !client.SendQueue.empty())
   {
-    // Lock before we send message to the clients
-    igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
-    if (this->NewClientConnected)
+    ClientData::SendQueueItem& item = client.SendQueue.front();
+    for (std::vector<igtl::MessageBase::Pointer>::iterator messageIt = item.Messages.begin(); messageIt != item.Messages.end(); ++messageIt)
     {
-      for (std::list<ClientData>::iterator clientIterator = this->IgtlClients.begin(); clientIterator != this->IgtlClients.end(); ++clientIterator)
+      int messageSize = (*messageIt)->GetBufferSize();
+      if (bytesToSkip >= messageSize)
       {
-        std::vector<PlusIgtlClientInfo::VideoStream> videoStreams = (*clientIterator).ClientInfo.VideoStreams;
-        for (std::vector<PlusIgtlClientInfo::VideoStream>::iterator videoStream = videoStreams.begin(); videoStream != videoStreams.end(); ++videoStream)
+        bytesToSkip -= messageSize;
+        continue;
+      }
+      client.PendingSendData.append(static_cast<const char*>((*messageIt)->GetBufferPointer()) + bytesToSkip, messageSize - bytesToSkip);
+      bytesToSkip = 0;
+    }
+    if (item.TrackedFrame)
+    {
+      client.ClientInfo.SetNumberOfSentFrames(client.ClientInfo.GetNumberOfSentFrames() + 1);
+      if (client.FrameLatencyMetric && item.FrameTimestamp >= 0)
+      {
+        if (acceptedTime < 0)
         {
-          vtkIGSIOFrameConverter* frameConverter = videoStream->FrameConverter;
-          if (frameConverter)
-          {
-            frameConverter->RequestKeyFrameOn();
-          }
+          acceptedTime = vtkIGSIOAccurateTimer::GetSystemTime();
         }
+        client.FrameLatencyMetric->AddSample(acceptedTime - item.FrameTimestamp);
       }
     }
-    this->NewClientConnected = false;
-
-    for (std::list<ClientData>::iterator clientIterator = this->IgtlClients.begin(); clientIterator != this->IgtlClients.end(); ++clientIterator)
-    {
-      igtl::ClientSocket::Pointer clientSocket = (*clientIterator).ClientSocket;
+    client.SendQueue.pop_front();
+  }
 
-      // Create IGT messages
-      std::vector<igtl::MessageBase::Pointer> igtlMessages;
-      std::vector<igtl::MessageBase::Pointer>::iterator igtlMessageIterator;
+  if (client.PendingSendData.empty() && client.SendQueue.empty())
+  {
+    client.SendStalledSinceTime = -1;
+    return PLUS_SUCCESS;
+  }
 
-      if (this->IgtlMessageFactory->PackMessages(clientIterator->ClientId, clientIterator->ClientInfo, igtlMessages, trackedFrame, this->SendValidTransformsOnly, this->TransformRepository) != PLUS_SUCCESS)
-      {
-        LOG_WARNING("Failed to pack all IGT messages");
-      }
+  // The socket buffer is full, the rest of the data will be sent later
+  double currentTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  if (bytesSent > 0 || client.SendStalledSinceTime < 0)
+  {
+    client.SendStalledSinceTime = currentTime;
+    return PLUS_SUCCESS;
+  }
+  double sendTimeoutSec = this->DefaultClientSendTimeoutSec + this->NumberOfRetryAttempts * this->DelayBetweenRetryAttemptsSec;
+  if (currentTime - client.SendStalledSinceTime > sendTimeoutSec)
+  {
+    LOG_DEBUG("Client " << client.ClientId << " has not accepted any data for " << currentTime - client.SendStalledSinceTime << " sec");
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
 
-      // Send all messages to a client
-      for (igtlMessageIterator = igtlMessages.begin(); igtlMessageIterator != igtlMessages.end(); ++igtlMessageIterator)
-      {
-        igtl::MessageBase::Pointer igtlMessage = (*igtlMessageIterator);
-        if (igtlMessage.IsNull())
-        {
-          continue;
-        }
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::UpdateAdaptiveStreaming(ClientData& client)
+{
+  if (!client.ClientInfo.ImageStreamingOptions.Adaptive)
+  {
+    return;
+  }
 
-        int retValue = 0;
-        RETRY_UNTIL_TRUE((retValue = clientSocket->Send(igtlMessage->GetBufferPointer(), igtlMessage->GetBufferSize())) != 0, this->NumberOfRetryAttempts, this->DelayBetweenRetryAttemptsSec);
-        if (retValue == 0)
-        {
-          disconnectedClientIds.push_back(clientIterator->ClientId);
-          igtl::TimeStamp::Pointer ts = igtl::TimeStamp::New();
-          igtlMessage->GetTimeStamp(ts);
-          LOG_INFO("Client disconnected - could not send " << igtlMessage->GetMessageType() << " message to client (device name: " << igtlMessage->GetDeviceName()
-                   << "  Timestamp: " << std::fixed << ts->GetTimeStamp() << ").");
-          break;
-        }
+  double currentTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  if (client.AdaptiveIntervalStartTime < 0)
+  {
+    client.AdaptiveIntervalStartTime = currentTime;
+    client.AdaptiveIntervalBytesSent = 0;
+    client.AdaptiveIntervalStartDroppedFrames = client.ClientInfo.GetNumberOfDroppedFrames();
+    return;
+  }
+  double intervalSec = currentTime - client.AdaptiveIntervalStartTime;
+  if (intervalSec < ADAPTIVE_STREAMING_INTERVAL_SEC)
+  {
+    return;
+  }
 
-        // Update the TDATA timestamp, even if TDATA isn't sent (cheaper than checking for existing TDATA message type)
-        clientIterator->ClientInfo.SetLastTDATASentTimeStamp(trackedFrame.GetTimestamp());
-      }
+  unsigned long numberOfDroppedFrames = client.ClientInfo.GetNumberOfDroppedFrames() - client.AdaptiveIntervalStartDroppedFrames;
+  double throughputKBps = client.AdaptiveIntervalBytesSent / intervalSec / 1000.0;
+  int qualityLevel = client.ClientInfo.GetAdaptiveQualityLevel();
+  if (numberOfDroppedFrames > 0)
+  {
+    client.NumberOfAdaptiveStableIntervals = 0;
+    if (qualityLevel < PlusIgtlClientInfo::MAX_ADAPTIVE_QUALITY_LEVEL)
+    {
+      client.ClientInfo.SetAdaptiveQualityLevel(qualityLevel + 1);
+      LOG_INFO("Image streaming quality of client " << client.ClientId << " is reduced to level " << qualityLevel + 1 << " ("
+               << numberOfDroppedFrames << " frames dropped at " << throughputKBps << " kB/s)");
     }
   }
-
-  // Clean up disconnected clients
-  for (std::vector< int >::iterator it = disconnectedClientIds.begin(); it != disconnectedClientIds.end(); ++it)
+  else if (qualityLevel > client.OverloadQualityLevel && ++client.NumberOfAdaptiveStableIntervals >= ADAPTIVE_STREAMING_STABLE_INTERVALS)
   {
-    DisconnectClient(*it);
+    client.NumberOfAdaptiveStableIntervals = 0;
+    client.ClientInfo.SetAdaptiveQualityLevel(qualityLevel - 1);
+    LOG_INFO("Image streaming quality of client " << client.ClientId << " is increased to level " << qualityLevel - 1 << " ("
+             << throughputKBps << " kB/s without dropped frames)");
   }
 
-  // restore original timestamp
-  trackedFrame.SetTimestamp(timestampSystem);
+  client.AdaptiveIntervalStartTime = currentTime;
+  client.AdaptiveIntervalBytesSent = 0;
+  client.AdaptiveIntervalStartDroppedFrames = client.ClientInfo.GetNumberOfDroppedFrames();
+}
 
-  return (numberOfErrors == 0 ? PLUS_SUCCESS : PLUS_FAIL);
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::UpdateOverloadStreaming(ClientData& client)
+{
+  int overloadQualityLevel = (this->ClientStreamRateReducedForOverload ? this->OverloadClientQualityLevel : 0);
+  if (overloadQualityLevel == client.OverloadQualityLevel)
+  {
+    return;
+  }
+  int qualityLevel = client.ClientInfo.GetAdaptiveQualityLevel();
+  if (overloadQualityLevel > client.OverloadQualityLevel)
+  {
+    client.ClientInfo.SetAdaptiveQualityLevel(std::max(qualityLevel, overloadQualityLevel));
+  }
+  else if (!client.ClientInfo.ImageStreamingOptions.Adaptive)
+  {
+    // Adaptive streaming increases the quality of adaptive clients when their connection allows it
+    client.ClientInfo.SetAdaptiveQualityLevel(overloadQualityLevel);
+  }
+  client.OverloadQualityLevel = overloadQualityLevel;
 }
 
 //----------------------------------------------------------------------------
-void vtkPlusOpenIGTLinkServer::DisconnectClient(int clientId)
+void vtkPlusOpenIGTLinkServer::FlushClientsSendData()
 {
-  // Stop the client's data receiver thread
+  std::vector< int > disconnectedClientIds;
   {
-    // Request thread stop
     igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
     for (std::list<ClientData>::iterator clientIterator = this->IgtlClients.begin(); clientIterator != this->IgtlClients.end(); ++clientIterator)
     {
-      if (clientIterator->ClientId != clientId)
+      if (this->FlushClientSendData(*clientIterator) != PLUS_SUCCESS)
       {
-        continue;
+        LOG_INFO("Client disconnected - could not send data to client " << clientIterator->ClientId << ".");
+        disconnectedClientIds.push_back(clientIterator->ClientId);
       }
-      clientIterator->DataReceiverActive.first = false;
-      break;
     }
   }
 
-  // Wait for the thread to stop
-  bool clientDataReceiverThreadStillActive = false;
-  do
+  // Clean up disconnected clients
+  for (std::vector< int >::iterator it = disconnectedClientIds.begin(); it != disconnectedClientIds.end(); ++it)
   {
-    clientDataReceiverThreadStillActive = false;
-    {
-      // check if any of the receiver threads are still active
-      igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
-      for (std::list<ClientData>::iterator clientIterator = this->IgtlClients.begin(); clientIterator != this->IgtlClients.end(); ++clientIterator)
-      {
-        if (clientIterator->ClientId != clientId)
-        {
-          continue;
-        }
-        if (clientIterator->DataReceiverThreadId >= 0)
-        {
-          if (clientIterator->DataReceiverActive.second)
-          {
-            // thread still running
-            clientDataReceiverThreadStillActive = true;
-          }
-          else
-          {
-            // thread stopped
-            // We still need to call vtkMultiThreader::TerminateThread, not to terminate the thread (as it is already stopped)
-            // but to indicate to the multithreader that the thread ID can be reused. Without this, vtkMultiThreader runs out
-            // of usable thread IDs after the number of connects/disconnects reaches VTK_MAX_THREADS
-            this->Threader->TerminateThread(clientIterator->DataReceiverThreadId);
-            clientIterator->DataReceiverThreadId = -1;
-          }
-          break;
-        }
-      }
-    }
-    if (clientDataReceiverThreadStillActive)
-    {
-      // give some time for the threads to finish
-      vtkIGSIOAccurateTimer::DelayWithEventProcessing(0.2);
-    }
+    DisconnectClient(*it);
   }
-  while (clientDataReceiverThreadStillActive);
+}
 
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::DisconnectClient(int clientId)
+{
   // Close socket and remove client from the list
   int port = 0;
   std::string address = "unknown";
@@ -1175,13 +2308,146 @@ void vtkPlusOpenIGTLinkServer::DisconnectClient(int clientId)
         clientIterator->ClientSocket->CloseSocket();
       }
       this->IgtlClients.erase(clientIterator);
+      this->IgtlMessageFactory->RemoveClient(clientId);
       break;
     }
   }
+  MetricsRegistry::GetInstance().RemoveMetrics("client", igsioCommon::ToString<int>(clientId));
 
   LOG_INFO("Client disconnected (" <<  address << ":" << port << "). Number of connected clients: " << GetNumberOfConnectedClients());
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::UpdateOutputChannelConsumers(const std::vector<bool>& outputChannelRequested)
+{
+  for (size_t outputChannelIndex = 0; outputChannelIndex < this->OutputChannels.size(); ++outputChannelIndex)
+  {
+    OutputChannel& outputChannel = this->OutputChannels[outputChannelIndex];
+    const bool requested = (outputChannelIndex < outputChannelRequested.size() && outputChannelRequested[outputChannelIndex]);
+    if (outputChannel.Channel == NULL || requested == outputChannel.ConsumerRegistered)
+    {
+      continue;
+    }
+    if (requested)
+    {
+      outputChannel.Channel->AddConsumer(&outputChannel);
+    }
+    else
+    {
+      outputChannel.Channel->RemoveConsumer(&outputChannel);
+    }
+    outputChannel.ConsumerRegistered = requested;
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::CollectMetrics(std::vector<MetricsRegistry::Sample>& samples)
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
+  samples.push_back(MetricsRegistry::Sample("plus_server_connected_clients", "Number of connected OpenIGTLink clients",
+                    MetricsRegistry::METRIC_GAUGE, MetricsRegistry::Labels(), static_cast<double>(this->IgtlClients.size())));
+  for (std::list<ClientData>::iterator clientIterator = this->IgtlClients.begin(); clientIterator != this->IgtlClients.end(); ++clientIterator)
+  {
+    MetricsRegistry::Labels clientLabels;
+    clientLabels["client"] = igsioCommon::ToString<int>(clientIterator->ClientId);
+
+    int numberOfQueuedFrames = 0;
+    for (std::deque<ClientData::SendQueueItem>::iterator itemIt = clientIterator->SendQueue.begin(); itemIt != clientIterator->SendQueue.end(); ++itemIt)
+    {
+      if (itemIt->TrackedFrame)
+      {
+        numberOfQueuedFrames++;
+      }
+    }
+    size_t backlogBytes = GetSendBacklogBytes(*clientIterator);
+
+    samples.push_back(MetricsRegistry::Sample("plus_server_client_sent_frames_total", "Number of tracked frames sent to the client",
+                      MetricsRegistry::METRIC_COUNTER, clientLabels, clientIterator->ClientInfo.GetNumberOfSentFrames()));
+    samples.push_back(MetricsRegistry::Sample("plus_server_client_dropped_frames_total", "Number of tracked frames dropped from the send queue of the client",
+                      MetricsRegistry::METRIC_COUNTER, clientLabels, clientIterator->ClientInfo.GetNumberOfDroppedFrames()));
+    samples.push_back(MetricsRegistry::Sample("plus_server_client_queued_frames", "Number of tracked frames waiting in the send queue of the client",
+                      MetricsRegistry::METRIC_GAUGE, clientLabels, numberOfQueuedFrames));
+    samples.push_back(MetricsRegistry::Sample("plus_server_client_send_backlog_bytes", "Number of bytes not yet accepted by the socket of the client",
+                      MetricsRegistry::METRIC_GAUGE, clientLabels, static_cast<double>(backlogBytes)));
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::GetMemoryUsage(std::vector<MemoryAccounting::Usage>& usages)
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
+  for (std::list<ClientData>::iterator clientIterator = this->IgtlClients.begin(); clientIterator != this->IgtlClients.end(); ++clientIterator)
+  {
+    MetricsRegistry::Labels clientLabels;
+    clientLabels["client"] = igsioCommon::ToString<int>(clientIterator->ClientId);
+    usages.push_back(MemoryAccounting::Usage("client_send_queue", clientLabels, GetSendBacklogBytes(*clientIterator)));
+  }
+}
+
+//----------------------------------------------------------------------------
+void* vtkPlusOpenIGTLinkServer::MetricsHttpThread(vtkMultiThreader::ThreadInfo* data)
+{
+  vtkPlusOpenIGTLinkServer* self = (vtkPlusOpenIGTLinkServer*)(data->UserData);
+
+  igtl::ServerSocket::Pointer serverSocket = igtl::ServerSocket::New();
+  if (serverSocket->CreateServer(self->MetricsHttpPort) < 0)
+  {
+    LOG_ERROR("Cannot create the metrics HTTP server socket on port " << self->MetricsHttpPort);
+    return NULL;
+  }
+  LOG_INFO("Plus OpenIGTLink server provides metrics at http://<host>:" << self->MetricsHttpPort << "/metrics");
+
+  self->MetricsHttpActive.Respond = true;
+  while (self->MetricsHttpActive.Request)
+  {
+    igtl::ClientSocket::Pointer httpSocket = serverSocket->WaitForConnection(CLIENT_SOCKET_TIMEOUT_SEC * 1000);
+    if (httpSocket.IsNull())
+    {
+      continue;
+    }
+    httpSocket->SetReceiveTimeout(METRICS_HTTP_TIMEOUT_MS);
+    httpSocket->SetSendTimeout(METRICS_HTTP_TIMEOUT_MS);
+
+    std::string requestHeader;
+    if (ReceiveHttpRequestHeader(httpSocket, requestHeader) != PLUS_SUCCESS)
+    {
+      LOG_DEBUG("Failed to receive metrics HTTP request");
+      httpSocket->CloseSocket();
+      continue;
+    }
+
+    // Request line: method, path, HTTP version
+    std::istringstream requestLine(requestHeader.substr(0, requestHeader.find("\r\n")));
+    std::string method;
+    std::string path;
+    requestLine >> method >> path;
+    path = path.substr(0, path.find('?'));
+
+    std::string response;
+    if (method != "GET")
+    {
+      response = CreateHttpResponse("405 Method Not Allowed", "text/plain", "Only GET requests are supported.\n");
+    }
+    else if (path != "/metrics")
+    {
+      response = CreateHttpResponse("404 Not Found", "text/plain", "Metrics are available at /metrics\n");
+    }
+    else
+    {
+      response = CreateHttpResponse("200 OK", "text/plain; version=0.0.4; charset=utf-8", MetricsRegistry::GetInstance().GetMetricsAsPrometheusText());
+    }
+    if (httpSocket->Send(response.data(), response.size()) == 0)
+    {
+      LOG_DEBUG("Failed to send metrics HTTP response");
+    }
+    httpSocket->CloseSocket();
+  }
+
+  serverSocket->CloseSocket();
+  self->MetricsHttpActive.Respond = false;
+  return NULL;
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusOpenIGTLinkServer::KeepAlive()
 {
@@ -1199,11 +2465,7 @@ void vtkPlusOpenIGTLinkServer::KeepAlive()
       replyMsg->SetCode(igtl::StatusMessage::STATUS_OK);
       replyMsg->Pack();
 
-      int retValue = 0;
-      RETRY_UNTIL_TRUE(
-        (retValue = clientIterator->ClientSocket->Send(replyMsg->GetPackPointer(), replyMsg->GetPackSize())) != 0,
-        this->NumberOfRetryAttempts, this->DelayBetweenRetryAttemptsSec);
-      if (retValue == 0)
+      if (this->SendToClient(*clientIterator, replyMsg.GetPointer()) != PLUS_SUCCESS)
       {
         disconnectedClientIds.push_back(clientIterator->ClientId);
         igtl::TimeStamp::Pointer ts = igtl::TimeStamp::New();
@@ -1260,9 +2522,28 @@ PlusStatus vtkPlusOpenIGTLinkServer::ReadConfiguration(vtkXMLDataElement* server
 
   XML_READ_SCALAR_ATTRIBUTE_REQUIRED(int, ListeningPort, serverElement);
   XML_READ_STRING_ATTRIBUTE_REQUIRED(OutputChannelId, serverElement);
+  this->AdditionalOutputChannelIds.clear();
+  const char* additionalOutputChannelIds = serverElement->GetAttribute("AdditionalOutputChannelIds");
+  if (additionalOutputChannelIds != NULL)
+  {
+    std::vector<std::string> channelIds = igsioCommon::SplitStringIntoTokens(additionalOutputChannelIds, ' ', false);
+    for (std::vector<std::string>::iterator channelIdIt = channelIds.begin(); channelIdIt != channelIds.end(); ++channelIdIt)
+    {
+      // Duplicates are ignored
+      if (!this->IsOutputChannelPublished(*channelIdIt))
+      {
+        this->AdditionalOutputChannelIds.push_back(*channelIdIt);
+      }
+    }
+  }
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, MissingInputGracePeriodSec, serverElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, MaxTimeSpentWithProcessingMs, serverElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, MaxNumberOfIgtlMessagesToSend, serverElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, MaxNumberOfQueuedFramesPerClient, serverElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, OverloadClientQualityLevel, serverElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfImageCompressionThreads, serverElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfCommandExecutionThreads, serverElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, MetricsHttpPort, serverElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfRetryAttempts, serverElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, DelayBetweenRetryAttemptsSec, serverElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, KeepAliveIntervalSec, serverElement);
@@ -1270,6 +2551,19 @@ PlusStatus vtkPlusOpenIGTLinkServer::ReadConfiguration(vtkXMLDataElement* server
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(IgtlMessageCrcCheckEnabled, serverElement);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(LogWarningOnNoDataAvailable, serverElement);
 
+  int maxNumberOfCachedPolydata = this->PolydataCache->GetMaximumNumberOfItems();
+  if (serverElement->GetScalarAttribute("MaxNumberOfCachedPolydata", maxNumberOfCachedPolydata))
+  {
+    this->PolydataCache->SetMaximumNumberOfItems(maxNumberOfCachedPolydata);
+  }
+
+  this->ThreadSettings = PlusThreadSettings();
+  if (this->ThreadSettings.ReadConfiguration(serverElement, "Thread") != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Invalid thread settings in PlusOpenIGTLinkServer element");
+    return PLUS_FAIL;
+  }
+
   this->DefaultClientInfo.IgtlMessageTypes.clear();
   this->DefaultClientInfo.TransformNames.clear();
   this->DefaultClientInfo.ImageStreams.clear();
@@ -1290,6 +2584,141 @@ PlusStatus vtkPlusOpenIGTLinkServer::ReadConfiguration(vtkXMLDataElement* server
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(float, DefaultClientSendTimeoutSec, serverElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(float, DefaultClientReceiveTimeoutSec, serverElement);
 
+  if (this->ReadSocketOptionsConfiguration(serverElement) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  return this->ReadUdpOutputConfiguration(serverElement);
+}
+
+//------------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkServer::ReadSocketOptionsConfiguration(vtkXMLDataElement* serverElement)
+{
+  this->DefaultSocketOptions = SocketOptions();
+  this->DefaultSocketOptions.TcpNoDelay = 1;
+  this->TrackingClientSocketOptions = SocketOptions();
+  this->ImagingClientSocketOptions = SocketOptions();
+
+  for (int nestedElementIndex = 0; nestedElementIndex < serverElement->GetNumberOfNestedElements(); ++nestedElementIndex)
+  {
+    vtkXMLDataElement* socketOptionsElement = serverElement->GetNestedElement(nestedElementIndex);
+    if (STRCASECMP(socketOptionsElement->GetName(), "SocketOptions") != 0)
+    {
+      continue;
+    }
+
+    SocketOptions options;
+    if (ReadSocketOptionFlag(socketOptionsElement, "TcpNoDelay", options.TcpNoDelay) != PLUS_SUCCESS
+        || ReadSocketOptionFlag(socketOptionsElement, "TcpQuickAck", options.TcpQuickAck) != PLUS_SUCCESS
+        || ReadSocketOptionFlag(socketOptionsElement, "KeepAlive", options.KeepAlive) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, KeepAliveIdleSec, options.KeepAliveIdleSec, socketOptionsElement);
+    XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, SendBufferSize, options.SendBufferSize, socketOptionsElement);
+    XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, ReceiveBufferSize, options.ReceiveBufferSize, socketOptionsElement);
+    XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, Dscp, options.Dscp, socketOptionsElement);
+    if (options.Dscp > 63)
+    {
+      LOG_ERROR("Invalid Dscp attribute value in SocketOptions element: " << options.Dscp << " (expected 0-63)");
+      return PLUS_FAIL;
+    }
+
+    const char* clientClass = socketOptionsElement->GetAttribute("ClientClass");
+    if (clientClass == NULL)
+    {
+      this->DefaultSocketOptions.Merge(options);
+    }
+    else if (STRCASECMP(clientClass, TRACKING_CLIENT_CLASS) == 0)
+    {
+      this->TrackingClientSocketOptions.Merge(options);
+    }
+    else if (STRCASECMP(clientClass, IMAGING_CLIENT_CLASS) == 0)
+    {
+      this->ImagingClientSocketOptions.Merge(options);
+    }
+    else
+    {
+      LOG_ERROR("Invalid ClientClass attribute value in SocketOptions element: " << clientClass << " (expected " << TRACKING_CLIENT_CLASS << " or " << IMAGING_CLIENT_CLASS << ")");
+      return PLUS_FAIL;
+    }
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//------------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::ApplySocketOptions(ClientData& client)
+{
+  std::string clientClass = GetSocketOptionsClientClass(client.ClientInfo);
+  if (clientClass == client.SocketOptionsClientClass || client.ClientSocket.IsNull())
+  {
+    return;
+  }
+
+  SocketOptions options = this->DefaultSocketOptions;
+  options.Merge(clientClass == IMAGING_CLIENT_CLASS ? this->ImagingClientSocketOptions : this->TrackingClientSocketOptions);
+  SetSocketOptions(SocketDescriptorAccessor::GetSocketDescriptor(client.ClientSocket), options, "client " + igsioCommon::ToString<int>(client.ClientId));
+  client.SocketOptionsClientClass = clientClass;
+  client.TcpQuickAck = (options.TcpQuickAck > 0);
+  LOG_DEBUG("Socket options of " << clientClass << " clients are set for client " << client.ClientId);
+}
+
+//------------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkServer::ReadUdpOutputConfiguration(vtkXMLDataElement* serverElement)
+{
+  this->UdpOutputAddress.clear();
+  this->UdpOutputPort = 0;
+  this->UdpOutputMulticastTtl = 1;
+  this->UdpOutputClientInfo = PlusIgtlClientInfo();
+
+  vtkXMLDataElement* udpOutputElement = serverElement->FindNestedElementWithName("UdpOutput");
+  if (udpOutputElement == NULL)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  XML_READ_STRING_ATTRIBUTE_NONMEMBER_REQUIRED(Address, this->UdpOutputAddress, udpOutputElement);
+  XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, Port, this->UdpOutputPort, udpOutputElement);
+  XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, MulticastTtl, this->UdpOutputMulticastTtl, udpOutputElement);
+  if (this->UdpOutputPort <= 0)
+  {
+    LOG_ERROR("Invalid or missing Port attribute in UdpOutput element");
+    return PLUS_FAIL;
+  }
+
+  PlusIgtlClientInfo clientInfo;
+  if (clientInfo.SetClientInfoFromXmlData(udpOutputElement) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  // Only small messages that are useful without the previous ones can be sent without retransmission
+  std::vector<std::string> messageTypes;
+  for (std::vector<std::string>::iterator messageTypeIt = clientInfo.IgtlMessageTypes.begin(); messageTypeIt != clientInfo.IgtlMessageTypes.end(); ++messageTypeIt)
+  {
+    if (igsioCommon::IsEqualInsensitive(*messageTypeIt, "TRANSFORM") || igsioCommon::IsEqualInsensitive(*messageTypeIt, "POSITION"))
+    {
+      messageTypes.push_back(*messageTypeIt);
+    }
+    else if (igsioCommon::IsEqualInsensitive(*messageTypeIt, "TDATA"))
+    {
+      messageTypes.push_back(*messageTypeIt);
+      clientInfo.SetTDATARequested(true);
+    }
+    else
+    {
+      LOG_WARNING("Message type " << *messageTypeIt << " is not supported in UdpOutput, only TRANSFORM, POSITION and TDATA messages are sent");
+    }
+  }
+  clientInfo.IgtlMessageTypes = messageTypes;
+  if (clientInfo.IgtlMessageTypes.empty() || clientInfo.TransformNames.empty())
+  {
+    LOG_WARNING("UdpOutput is configured without tracking message types or transform names, nothing will be sent");
+  }
+  this->UdpOutputClientInfo = clientInfo;
+
   return PLUS_SUCCESS;
 }
 
@@ -1393,6 +2822,19 @@ igtl::MessageBase::Pointer vtkPlusOpenIGTLinkServer::CreateIgtlMessageFromComman
       return NULL;
     }
 
+    // A snapshot image with the same frame UID has the same content, so its packed message is reused
+    std::string frameUid = imageResponse->GetFrameUid();
+    std::string packedMessageKey = imageName + "|" + igsioCommon::ToString<int>(replyHeaderVersion);
+    if (!frameUid.empty())
+    {
+      std::map<std::string, std::pair<std::string, igtl::MessageBase::Pointer> >::iterator packedIt = this->PackedImageMessages.find(packedMessageKey);
+      if (packedIt != this->PackedImageMessages.end() && packedIt->second.first == frameUid)
+      {
+        LOG_DEBUG("Image " << imageName << " (" << frameUid << ") is sent from the packed message cache");
+        return packedIt->second.second;
+      }
+    }
+
     igtl::ImageMessage::Pointer igtlMessage = dynamic_cast<igtl::ImageMessage*>(this->IgtlMessageFactory->CreateSendMessage("IMAGE", replyHeaderVersion).GetPointer());
     igtlMessage->SetDeviceName(imageName.c_str());
 
@@ -1401,6 +2843,12 @@ igtl::MessageBase::Pointer vtkPlusOpenIGTLinkServer::CreateIgtlMessageFromComman
       LOG_ERROR("Failed to create image mesage from command response");
       return NULL;
     }
+    if (!frameUid.empty())
+    {
+      // only the latest frame of each image is kept, as volumes may be large
+      igtlMessage->Pack();
+      this->PackedImageMessages[packedMessageKey] = std::make_pair(frameUid, igtl::MessageBase::Pointer(igtlMessage.GetPointer()));
+    }
     return igtlMessage.GetPointer();
   }
 
@@ -1420,6 +2868,18 @@ igtl::MessageBase::Pointer vtkPlusOpenIGTLinkServer::CreateIgtlMessageFromComman
       return NULL;
     }
 
+    // The packed message of a cached model is reused by all the requests of the same header version
+    std::string cacheKey = polydataResponse->GetCacheKey();
+    std::string messageVariant = igsioCommon::ToString<int>(replyHeaderVersion) + "|" + polydataName;
+    if (!cacheKey.empty())
+    {
+      igtl::MessageBase::Pointer cachedMessage = this->PolydataCache->GetPackedMessage(cacheKey, messageVariant);
+      if (cachedMessage.IsNotNull())
+      {
+        return cachedMessage;
+      }
+    }
+
     igtl::PolyDataMessage::Pointer igtlMessage = dynamic_cast<igtl::PolyDataMessage*>(this->IgtlMessageFactory->CreateSendMessage("POLYDATA", replyHeaderVersion).GetPointer());
     igtlMessage->SetDeviceName("PlusServer");
     igtlMessage->SetMetaDataElement("fileName", IANA_TYPE_US_ASCII, polydataName);
@@ -1429,6 +2889,11 @@ igtl::MessageBase::Pointer vtkPlusOpenIGTLinkServer::CreateIgtlMessageFromComman
       LOG_ERROR("Failed to create polydata mesage from command response");
       return NULL;
     }
+    if (!cacheKey.empty())
+    {
+      igtlMessage->Pack();
+      this->PolydataCache->SetPackedMessage(cacheKey, messageVariant, igtlMessage.GetPointer());
+    }
     return igtlMessage.GetPointer();
   }
 
@@ -10,8 +10,14 @@
 // Local includes
 #include "vtkPlusServerExport.h"
 #include "PlusIgtlClientInfo.h"
+#include "PlusIgtlUdpSocket.h"
+#include "PlusMemoryAccounting.h"
+#include "PlusMetricsRegistry.h"
+#include "PlusOverloadManager.h"
+#include "PlusThreadSettings.h"
 #include "vtkPlusDataCollector.h"
 #include "vtkPlusIgtlMessageFactory.h"
+#include "vtkPlusPolydataCache.h"
 #include "vtkIGSIOTransformRepository.h"
 
 // VTK includes
@@ -20,7 +26,11 @@
 #include <vtkSmartPointer.h>
 
 // STL includes
+#include <atomic>
 #include <deque>
+#include <map>
+#include <memory>
+#include <string>
 
 // OS includes
 #if (_MSC_VER == 1500)
@@ -38,6 +48,7 @@ class vtkPlusChannel;
 class vtkPlusCommandProcessor;
 class vtkPlusCommandResponse;
 class vtkIGSIORecursiveCriticalSection;
+class vtkIGSIOTrackedFrameList;
 //class vtkIGSIOTransformRepository;
 
 struct ClientData
@@ -45,8 +56,16 @@ struct ClientData
   ClientData()
     : ClientId(-1)
     , ClientSocket(NULL)
-    , DataReceiverActive(std::make_pair(false, false))
-    , DataReceiverThreadId(-1)
+    , SendStalledSinceTime(-1)
+    , AdaptiveIntervalStartTime(-1)
+    , AdaptiveIntervalBytesSent(0)
+    , AdaptiveIntervalStartDroppedFrames(0)
+    , NumberOfAdaptiveStableIntervals(0)
+    , OverloadQualityLevel(0)
+    , TcpQuickAck(false)
+    , NumberOfReceivedHeaderBytes(0)
+    , NumberOfReceivedBodyBytes(0)
+    , ReceivedBodyIgnored(false)
     , Server(NULL)
   {
   }
@@ -61,12 +80,65 @@ struct ClientData
   uint32_t ClientSocketSendTimeout;
   uint32_t ClientSocketReceiveTimeout;
 
-  /// Active flag for thread (first: request, second: respond )
-  std::pair<bool, bool> DataReceiverActive;
-  int DataReceiverThreadId;
+  /// IDs of the recent commands received from the client, to detect duplicate command IDs
+  std::deque<uint32_t> PreviousCommandIds;
+
+  /// Messages to be sent together: all the messages of a tracked frame, or a list of control messages (command responses, status, etc.)
+  struct SendQueueItem
+  {
+    SendQueueItem()
+      : TrackedFrame(false)
+      , FrameTimestamp(-1)
+    {
+    }
+    std::vector<igtl::MessageBase::Pointer> Messages;
+    /// Messages of tracked frames may be replaced by newer ones or dropped, control messages are always sent
+    bool TrackedFrame;
+    /// System timestamp of the tracked frame, for measuring the latency until the messages are accepted by the socket
+    double FrameTimestamp;
+  };
+
+  /// Messages that have not been passed to the socket yet, in the order of sending
+  std::deque<SendQueueItem> SendQueue;
+
+  /// Remaining part of the messages that were partially accepted by the socket (because the client is slow)
+  std::string PendingSendData;
+
+  /// System time since the socket has not accepted any data, negative if there is no pending data
+  double SendStalledSinceTime;
+
+  /// Adaptive streaming: system time when the current measurement interval started, negative if not started yet
+  double AdaptiveIntervalStartTime;
+  /// Adaptive streaming: number of bytes accepted by the socket in the current measurement interval
+  unsigned long AdaptiveIntervalBytesSent;
+  /// Adaptive streaming: number of dropped frames of the client at the start of the current measurement interval
+  unsigned long AdaptiveIntervalStartDroppedFrames;
+  /// Adaptive streaming: number of consecutive measurement intervals without dropped frames
+  int NumberOfAdaptiveStableIntervals;
+  /// Minimum image streaming quality level that is applied because the system is overloaded, 0 if not reduced
+  int OverloadQualityLevel;
 
   PlusIgtlClientInfo ClientInfo;
 
+  /// Client class (Tracking or Imaging) whose socket options are set on the client socket, empty if not set yet
+  std::string SocketOptionsClientClass;
+  /// TCP_QUICKACK is not permanent on Linux, it has to be set again after receiving from the socket
+  bool TcpQuickAck;
+
+  /// Message that is being received. Messages are received without blocking, in as many parts as they arrive,
+  /// and they are only processed when complete. The header is NULL if no message is being received.
+  igtl::MessageHeader::Pointer ReceivedHeader;
+  int NumberOfReceivedHeaderBytes;
+  /// Body of the message that is being received, NULL until the header is complete
+  igtl::MessageBase::Pointer ReceivedBody;
+  igtlUint64 NumberOfReceivedBodyBytes;
+  /// The message type is not supported, the body is received only to skip it
+  bool ReceivedBodyIgnored;
+
+  /// Metrics updated while sending, see MetricsRegistry
+  std::shared_ptr<MetricsRegistry::Metric> SentBytesMetric;
+  std::shared_ptr<MetricsRegistry::Metric> FrameLatencyMetric;
+
   vtkPlusOpenIGTLinkServer* Server;
 };
 
@@ -83,12 +155,121 @@ struct ClientData
   requested image and tracking information in the same format as in the DefaultClientInfo element in the device set
   configuration file.
 
+  The server can publish multiple output channels: the channel of OutputChannelId is sent by default and the channels listed
+  in the optional AdditionalOutputChannelIds attribute (separated by spaces) are sent to the clients that select them by the
+  OutputChannelId attribute of their client information. All the channels are served on the same port by the same threads,
+  so the frames of the channels share the sender thread, the image compression threads and the gathered socket writes,
+  instead of each channel requiring a separate server.
+
+  The optional StreamingOptions element of the client information limits the frame rate and the size of the images sent
+  to the client, and may request adaptive streaming, which lowers the image quality while the client cannot keep up with
+  the frames (see PlusIgtlClientInfo::StreamingOptions).
+
+  The optional CoalescedTransforms element (attribute: MaxRate) of the client information replaces the TRANSFORM and TDATA
+  messages by one TDATA message per tracked frame that contains all the requested transforms, with the status of each transform
+  in the message meta data. Transforms of multiple tracking devices are then received together, at most MaxRate times per second,
+  instead of in a separate message for each transform (see PlusIgtlClientInfo::GetCoalesceTransforms).
+
+  The optional UdpOutput element (attributes: Address, Port, MulticastTtl) streams TRANSFORM, POSITION and TDATA messages
+  in UDP datagrams to a unicast or multicast address, in addition to the TCP clients. The element lists the message types and
+  transform names in the same format as the DefaultClientInfo element. There is no retransmission, so consumers that need
+  the latest transforms at a high rate (e.g., robot controllers) are not delayed by lost or slow packets, and a multicast
+  stream can be received by any number of consumers without additional cost in the server (see IgtlUdpSocket).
+
+  The optional SocketOptions elements tune the TCP connections of the clients (attributes: TcpNoDelay, TcpQuickAck, KeepAlive,
+  KeepAliveIdleSec, SendBufferSize, ReceiveBufferSize, Dscp; see SocketOptions). The element without ClientClass attribute applies
+  to all clients. Elements with ClientClass="Tracking" or ClientClass="Imaging" override it for clients that request only tracking
+  and status messages, or any image messages (IMAGE, CIMAGE, VIDEO, USMESSAGE, TRACKEDFRAME), respectively. The class is
+  determined from the DefaultClientInfo when the client connects and from each CLIENTINFO message of the client. Attributes
+  that are not specified keep their current value (the operating system default, unless a previous class of the client set them).
+
+  For example a low-latency tracking profile and a high-throughput imaging profile:
+
+  \code
+  <PlusOpenIGTLinkServer ListeningPort="18944" OutputChannelId="TrackedVideoStream">
+    <SocketOptions TcpNoDelay="TRUE" KeepAlive="TRUE" KeepAliveIdleSec="10" />
+    <SocketOptions ClientClass="Tracking" TcpQuickAck="TRUE" SendBufferSize="16384" Dscp="46" />
+    <SocketOptions ClientClass="Imaging" SendBufferSize="4194304" ReceiveBufferSize="262144" Dscp="34" />
+    ...
+  </PlusOpenIGTLinkServer>
+  \endcode
+
+  A small send buffer keeps only a few transforms in flight, so that a slow tracking client gets the latest data instead of
+  old queued messages, while a large send buffer lets image frames be sent without waiting for each acknowledgment.
+  DSCP 46 (expedited forwarding) and 34 (assured forwarding) are honored only by networks that are configured for them.
+
+  Relay topology: if the output channel is owned by an OpenIGTLinkVideo device with RelayReceivedMessages="TRUE" (see
+  vtkPlusOpenIGTLinkDevice) then the IMAGE, CIMAGE and TRACKEDFRAME messages that the device received from the upstream server
+  are forwarded to the subscribed clients in their serialized form, with the device name and timestamp rewritten in the
+  header. The received message is not forwarded (it is packed from the tracked frame as usual) to clients that request a
+  lower header version or clipped or downscaled images. For example, on the relay node:
+
+  \code
+  <Device Id="UpstreamVideo" Type="OpenIGTLinkVideo" ServerAddress="acquisition-node" ServerPort="18944" MessageType="IMAGE"
+    ImageMessageEmbeddedTransformName="ImageToReference" RelayReceivedMessages="TRUE" RelayDeviceName="Image" >
+    ...
+  </Device>
+  \endcode
+
+  The ThreadPriority, ThreadMmcssTask, ThreadCpuAffinityMask and ThreadLockMemory attributes set the priority, CPU affinity
+  and memory locking of the data sender, connection receiver and command execution threads (see PlusThreadSettings), so that
+  streaming is not delayed by other load on the machine. For example, to run the threads at real-time priority on CPU 2 and 3:
+
+  \code
+  <PlusOpenIGTLinkServer ListeningPort="18944" OutputChannelId="TrackedVideoStream"
+    ThreadPriority="RealTime" ThreadMmcssTask="Pro Audio" ThreadCpuAffinityMask="0x0C" ThreadLockMemory="TRUE">
+  \endcode
+
+  By default the commands are executed on the main thread, by ProcessPendingCommands(). If NumberOfCommandExecutionThreads
+  is positive then the commands are executed by a pool of worker threads instead (see vtkPlusCommandProcessor): commands
+  of different devices run concurrently, so a long volume reconstruction or recording command does not delay the transform
+  updates and parameter queries of other devices, while the commands of the same device are still executed in order.
+
+  Clients that have an UsImagingParameters element in their client info (see PlusIgtlClientInfo) receive the imaging parameters
+  of an ultrasound device in a STRING message (device name: id of the ultrasound device) when they connect and whenever
+  a parameter changes, instead of polling them by GetUsParameter commands. For example:
+
+  \code
+  <ClientInfo>
+    <UsImagingParameters UsDeviceId="VideoDevice" />
+    ...
+  </ClientInfo>
+  \endcode
+
+  Models requested by GET_POLYDATA messages or GetPolydata commands are kept parsed in a cache (see vtkPlusPolydataCache),
+  together with their packed POLYDATA messages, so the model files are not read and packed again for each request and client.
+  The number of cached models is set by MaxNumberOfCachedPolydata (default: 16, 0 disables caching).
+  Similarly, the packed IMAGE message of the latest GET_IMAGE reply of each image is kept if the device provided the image
+  as a snapshot with a frame UID (see vtkPlusDevice::GetImageSnapshot), so an unchanged volume is packed only once.
+
+  The performance metrics of the server and the data collector (see MetricsRegistry) can be requested by the GetMetrics command.
+  If MetricsHttpPort is set then the metrics are also served over HTTP at /metrics in Prometheus text format,
+  so that the server can be monitored by standard tools without an OpenIGTLink connection.
+
   \ingroup PlusLibPlusServer
 */
 class vtkPlusServerExport vtkPlusOpenIGTLinkServer: public vtkObject
 {
   typedef std::map<int, std::vector<igtl::MessageBase::Pointer> > ClientIdToMessageListMap;
 
+  /*! Channel that is broadcast by the server */
+  struct OutputChannel
+  {
+    OutputChannel()
+      : Channel(NULL)
+      , LastSentTrackedFrameTimestamp(0)
+      , ConsumerRegistered(false)
+    {
+    }
+    /*! ID that the clients select the channel by */
+    std::string ChannelId;
+    vtkPlusChannel* Channel;
+    /*! Last sent tracked frame timestamp */
+    double LastSentTrackedFrameTimestamp;
+    /*! The server is registered as a consumer of the channel, because a client requested it */
+    bool ConsumerRegistered;
+  };
+
 public:
   static vtkPlusOpenIGTLinkServer* New();
   vtkTypeMacro(vtkPlusOpenIGTLinkServer, vtkObject);
@@ -111,6 +292,9 @@ public:
 
   vtkGetStdStringMacro(OutputChannelId);
 
+  /*! IDs of the channels that are published in addition to OutputChannelId */
+  const std::vector<std::string>& GetAdditionalOutputChannelIds() const;
+
   vtkSetMacro(MissingInputGracePeriodSec, double);
   vtkGetMacroConst(MissingInputGracePeriodSec, double);
 
@@ -154,11 +338,49 @@ public:
   vtkGetMacro(IGTLHeaderVersion, int);
 
   /*!
-    Execute all commands in the queue from the current thread (useful if commands should be executed from the main thread)
+    Execute all commands in the queue from the current thread (useful if commands should be executed from the main thread).
+    Does nothing if the commands are executed by command execution threads (NumberOfCommandExecutionThreads is positive).
     \return Number of executed commands
   */
   int ProcessPendingCommands();
 
+  /*! Data to be sent: pointer and size in bytes */
+  typedef std::pair<const char*, int> SendBuffer;
+
+  /*!
+    Send as much of the buffers as the socket accepts without blocking, gathered into a single system call
+    (sendmsg on Linux and macOS, WSASend on Windows), so that all the messages of a frame are sent in as few segments as possible.
+    \return Number of bytes sent (0 if the socket does not accept data now) or -1 if the connection is broken
+  */
+  static int SendBuffersWithoutBlocking(igtl::Socket* socket, const std::vector<SendBuffer>& buffers);
+
+  /*!
+    TCP options of the client sockets, read from a SocketOptions element of the server configuration.
+    Negative values are not specified: the option is not set on the socket.
+  */
+  struct SocketOptions
+  {
+    SocketOptions();
+
+    /*! Take the options that are specified in other */
+    void Merge(const SocketOptions& other);
+
+    /*! Disable Nagle's algorithm (TCP_NODELAY), enabled by default */
+    int TcpNoDelay;
+    /*! Acknowledge received segments immediately (TCP_QUICKACK), only supported on Linux */
+    int TcpQuickAck;
+    /*! Send keepalive probes on idle connections (SO_KEEPALIVE) */
+    int KeepAlive;
+    /*! Idle time in seconds before the first keepalive probe is sent (TCP_KEEPIDLE) */
+    int KeepAliveIdleSec;
+    /*! Size of the socket send buffer in bytes (SO_SNDBUF) */
+    int SendBufferSize;
+    /*! Size of the socket receive buffer in bytes (SO_RCVBUF) */
+    int ReceiveBufferSize;
+    /*! Differentiated services code point (0-63) of the sent packets (IP_TOS) */
+    int Dscp;
+  };
+
 protected:
   vtkPlusOpenIGTLinkServer();
   virtual ~vtkPlusOpenIGTLinkServer();
@@ -166,26 +388,131 @@ protected:
   /*! Add a response to the queue for sending to the client */
   PlusStatus QueueMessageResponseForClient(int clientId, igtl::MessageBase::Pointer message);
 
-  /*! Thread for client connection handling */
+  /*!
+    Thread for accepting client connections and receiving messages from all clients.
+    Waits for incoming data on all sockets at once (using the platform-specific SocketPoller),
+    so that no additional threads are needed per client.
+  */
   static void* ConnectionReceiverThread(vtkMultiThreader::ThreadInfo* data);
 
   /*! Thread for sending data to clients */
   static void* DataSenderThread(vtkMultiThreader::ThreadInfo* data);
 
+  /*! Thread for answering HTTP requests for the metrics in Prometheus text format */
+  static void* MetricsHttpThread(vtkMultiThreader::ThreadInfo* data);
+
+  /*! Append the metrics of the connected clients (sent and dropped frames, send backlog). Registered as a MetricsRegistry collector. */
+  void CollectMetrics(std::vector<MetricsRegistry::Sample>& samples);
+
+  /*! Append the size of the send queues of the connected clients. Registered as a MemoryAccounting reporter. */
+  void GetMemoryUsage(std::vector<MemoryAccounting::Usage>& usages);
+
   /*! Attempt to send any unsent frames to clients, if unsuccessful, accumulate an elapsed time */
   static PlusStatus SendLatestFramesToClients(vtkPlusOpenIGTLinkServer& self, double& elapsedTimeSinceLastPacketSentSec);
 
   /*! Process the message replies queue and send messages */
   static PlusStatus SendMessageResponses(vtkPlusOpenIGTLinkServer& self);
 
-  /*! Process the command replies queue and send messages */
+  /*!
+    Process the command replies queue and send messages. The replies of each client are sent together, in one gathered send.
+    Replies are never held back to wait for more replies: only the already queued replies are batched, and the collected
+    replies are sent as soon as the first of them has waited a few milliseconds for packing the next ones (e.g., large images).
+  */
   static PlusStatus SendCommandResponses(vtkPlusOpenIGTLinkServer& self);
 
-  /*! Thread for receiving control data from clients */
-  static void* DataReceiverThread(vtkMultiThreader::ThreadInfo* data);
+  /*!
+    Send the imaging parameters of the ultrasound devices to the subscribed clients that have not received their current version.
+    Only the version of the parameters is checked while they are unchanged, the message is created once per version and header version.
+  */
+  static PlusStatus SendUsImagingParameterUpdates(vtkPlusOpenIGTLinkServer& self);
+
+  /*! Send the messages of each client in one gathered send, the messages are removed from the map. Clients mutex is locked by the method. */
+  void SendMessagesToClients(ClientIdToMessageListMap& clientMessages);
+
+  /*! Accept a pending connection on the server socket and add the new client to the client list */
+  PlusStatus AcceptNewClient();
+
+  /*!
+    Receive the data that is available from a client without blocking and process the messages that are completed.
+    Incomplete messages are kept in the client data until the rest arrives, so a slow client does not delay the others.
+    Clients mutex is locked by the method.
+    \param clientDisconnected Set to true if the client closed the connection
+  */
+  PlusStatus ReceiveMessageFromClient(int clientId, bool& clientDisconnected);
 
-  /*! Tracked frame interface, sends the selected message type and data to all clients */
-  virtual PlusStatus SendTrackedFrame(igsioTrackedFrame& trackedFrame);
+  /*! Process a message that has been received from a client. Clients mutex must be locked. */
+  PlusStatus ProcessMessageFromClient(ClientData& client, igtl::MessageHeader::Pointer headerMsg, igtl::MessageBase::Pointer bodyMessage, bool bodyUnpacked);
+
+  /*!
+    Queue control messages (that are never dropped) for sending to the client and send as much of the queue as possible without blocking.
+    Clients mutex must be locked.
+    Returns with failure if the connection is broken or the client has not accepted any data for too long.
+  */
+  PlusStatus SendToClient(ClientData& client, const std::vector<igtl::MessageBase::Pointer>& messages);
+  PlusStatus SendToClient(ClientData& client, igtl::MessageBase::Pointer message);
+
+  /*!
+    Queue the messages of a tracked frame for sending to the client and send as much of the queue as possible without blocking.
+    Queued messages of older frames that have the same type and device name as a new message are replaced by the new message
+    (latest transform, image, etc. wins). If the queue is still longer than MaxNumberOfQueuedFramesPerClient (1 while the memory usage soft limit
+    is exceeded, see MemoryAccounting) then the oldest frames are dropped.
+    If a VIDEO message is dropped then the video streams of packingClientId (the client that the messages were packed for) restart from a key frame.
+    frameTimestampSystem is used for measuring the frame latency. Clients mutex must be locked. See SendToClient.
+  */
+  PlusStatus SendTrackedFrameToClient(ClientData& client, const std::vector<igtl::MessageBase::Pointer>& messages, int packingClientId, double frameTimestampSystem);
+
+  /*! Send as much of the pending data and the queued messages of the client as possible with a single gathering write. Clients mutex must be locked. */
+  PlusStatus FlushClientSendData(ClientData& client);
+
+  /*!
+    Measure the send throughput of a client that requested adaptive streaming and step the image quality down
+    if frames had to be dropped, or step it up if all frames were sent for a while. Clients mutex must be locked.
+  */
+  void UpdateAdaptiveStreaming(ClientData& client);
+
+  /*!
+    Apply the image streaming quality level of the ReduceClientStreamRate overload policy to a client (see OverloadManager).
+    The quality of non-adaptive clients is restored when the policy is reverted, adaptive clients recover gradually.
+    Clients mutex must be locked.
+  */
+  void UpdateOverloadStreaming(ClientData& client);
+
+  /*! Send the pending data of all clients and disconnect those clients that cannot receive data anymore */
+  void FlushClientsSendData();
+
+  /*! Tracked frame interface, sends the selected message type and data to all clients of the output channel (index in OutputChannels) */
+  virtual PlusStatus SendTrackedFrame(igsioTrackedFrame& trackedFrame, int outputChannelIndex);
+
+  /*! Get the tracked frames of the output channel that have not been sent yet, at most numberOfFramesToGet frames */
+  PlusStatus GetNewTrackedFrames(OutputChannel& outputChannel, int numberOfFramesToGet, vtkIGSIOTrackedFrameList* trackedFrameList);
+
+  /*!
+    Register the server as a consumer of the requested output channels and unregister it from the others,
+    so that devices can idle while none of the clients requests their channel. Called by the data sender thread.
+    \param outputChannelRequested For each output channel, true if a client requested it. If empty then no channel is requested.
+  */
+  void UpdateOutputChannelConsumers(const std::vector<bool>& outputChannelRequested);
+
+  /*! Index of the output channel (in OutputChannels) that the client requested, -1 if the channel is not published */
+  int GetOutputChannelIndex(const PlusIgtlClientInfo& clientInfo) const;
+
+  /*! Returns true if the channel ID is the ID of a published channel or empty (default channel) */
+  bool IsOutputChannelPublished(const std::string& channelId) const;
+
+  /*! Send the tracking messages of the tracked frame in UDP datagrams, if UDP output is enabled */
+  PlusStatus SendTrackedFrameToUdpOutput(igsioTrackedFrame& trackedFrame);
+
+  /*! Read the UdpOutput element of the server configuration */
+  PlusStatus ReadUdpOutputConfiguration(vtkXMLDataElement* serverElement);
+
+  /*! Read the SocketOptions elements of the server configuration */
+  PlusStatus ReadSocketOptionsConfiguration(vtkXMLDataElement* serverElement);
+
+  /*!
+    Set the socket options of the client class of the client (determined from the client info) on the client socket,
+    if they have not been set yet. Clients mutex must be locked.
+  */
+  void ApplySocketOptions(ClientData& client);
 
   /*! Converts a command response to an OpenIGTLink message that can be sent to the client */
   igtl::MessageBase::Pointer CreateIgtlMessageFromCommandResponse(vtkPlusCommandResponse* response);
@@ -193,7 +520,7 @@ protected:
   /*! Send status message to clients to keep alive the connection */
   virtual void KeepAlive();
 
-  /*! Stops client's data receiving thread, closes the socket, and removes the client from the client list */
+  /*! Closes the client's socket and removes the client from the client list */
   void DisconnectClient(int clientId);
 
   /*! Set IGTL CRC check flag (0: disabled, 1: enabled) */
@@ -216,6 +543,32 @@ protected:
   vtkSetMacro(KeepAliveIntervalSec, double);
   vtkGetMacroConst(KeepAliveIntervalSec, double);
 
+  vtkSetMacro(MaxNumberOfQueuedFramesPerClient, int);
+  vtkGetMacroConst(MaxNumberOfQueuedFramesPerClient, int);
+
+  /*!
+    Image streaming quality level of all clients while the ReduceClientStreamRate overload policy is applied
+    (see PlusIgtlClientInfo::GetAdaptiveQualityLevel, odd levels halve the frame rate). Tracking data is not reduced.
+  */
+  vtkSetClampMacro(OverloadClientQualityLevel, int, 1, PlusIgtlClientInfo::MAX_ADAPTIVE_QUALITY_LEVEL);
+  vtkGetMacroConst(OverloadClientQualityLevel, int);
+
+  vtkSetMacro(NumberOfImageCompressionThreads, int);
+  vtkGetMacroConst(NumberOfImageCompressionThreads, int);
+
+  vtkSetMacro(NumberOfCommandExecutionThreads, int);
+  vtkGetMacroConst(NumberOfCommandExecutionThreads, int);
+
+  vtkSetMacro(MetricsHttpPort, int);
+  vtkGetMacroConst(MetricsHttpPort, int);
+
+  /*! Cache of the models that are sent in reply to GET_POLYDATA requests. Can be accessed from any thread. */
+  vtkPlusPolydataCache* GetPolydataCache() const { return this->PolydataCache; }
+
+  /*! Priority, CPU affinity and memory locking settings of the server threads, applied when the threads are started */
+  const PlusThreadSettings& GetThreadSettings() const { return this->ThreadSettings; }
+  void SetThreadSettings(const PlusThreadSettings& settings) { this->ThreadSettings = settings; }
+
   vtkSetStdStringMacro(OutputChannelId);
   vtkSetStdStringMacro(ConfigFilename);
 
@@ -244,7 +597,10 @@ private:
   /*! Server listening port */
   int ListeningPort;
 
-  /*! Number of retry attempts for message sending to clients */
+  /*!
+    Number of retry attempts for message sending to clients. Sending is not blocking, therefore a client is disconnected
+    if it has not accepted data for DefaultClientSendTimeoutSec + NumberOfRetryAttempts * DelayBetweenRetryAttemptsSec.
+  */
   int NumberOfRetryAttempts;
 
   /*! Delay between retry attempts */
@@ -253,6 +609,33 @@ private:
   /*! Maximum number of IGTL messages to send in one period */
   int MaxNumberOfIgtlMessagesToSend;
 
+  /*! Maximum number of tracked frames waiting in the send queue of a slow client, older frames are dropped */
+  int MaxNumberOfQueuedFramesPerClient;
+
+  int OverloadClientQualityLevel;
+  /*! Set by the overload policy handler while the image streams of the clients are reduced */
+  std::atomic<bool> ClientStreamRateReducedForOverload;
+  /*! Identifier of the overload policy handler, 0 if not registered */
+  int OverloadPolicyHandlerId;
+
+  /*! Number of threads that the images of CIMAGE messages are compressed with */
+  int NumberOfImageCompressionThreads;
+
+  /*! Number of worker threads that execute the commands, the commands are executed on the main thread if 0 */
+  int NumberOfCommandExecutionThreads;
+
+  /*! Port of the HTTP server that provides the metrics in Prometheus text format, disabled if not positive */
+  int MetricsHttpPort;
+
+  /*! Priority, CPU affinity and memory locking settings of the sender, receiver and command execution threads */
+  PlusThreadSettings ThreadSettings;
+
+  /*! Identifier of the metrics collector of the clients, 0 if not registered */
+  int MetricsCollectorId;
+
+  /*! Identifier of the memory accounting reporter of the clients, 0 if not registered */
+  int MemoryReporterId;
+
   // Active flag for threads (request, respond )
   struct ThreadFlags
   {
@@ -265,10 +648,12 @@ private:
   };
   ThreadFlags ConnectionActive;
   ThreadFlags DataSenderActive;
+  ThreadFlags MetricsHttpActive;
 
   // Thread IDs
   int ConnectionReceiverThreadId;
   int DataSenderThreadId;
+  int MetricsHttpThreadId;
 
   /*! List of connected clients */
   std::list<ClientData> IgtlClients;
@@ -279,8 +664,20 @@ private:
   /*! Mutex instance for accessing client data list */
   vtkSmartPointer<vtkIGSIORecursiveCriticalSection> IgtlClientsMutex;
 
-  /*! Last sent tracked frame timestamp */
-  double LastSentTrackedFrameTimestamp;
+  /*! Parsed models and packed POLYDATA messages of the recent GET_POLYDATA requests */
+  vtkSmartPointer<vtkPlusPolydataCache> PolydataCache;
+
+  /*!
+    Packed IMAGE message of the latest image reply, by image name and header version, with the frame UID of the image.
+    Only accessed by the thread that sends the command responses.
+  */
+  std::map<std::string, std::pair<std::string, igtl::MessageBase::Pointer> > PackedImageMessages;
+
+  /*!
+    Packed STRING message of the latest imaging parameters of each ultrasound device, by device id and header version,
+    with the version of the parameters. Only accessed by the data sender thread.
+  */
+  std::map<std::string, std::pair<unsigned long, igtl::MessageBase::Pointer> > PackedUsImagingParameterMessages;
 
   /*! Maximum time spent with processing (getting tracked frames, sending messages) per second (in milliseconds) */
   int MaxTimeSpentWithProcessingMs;
@@ -300,6 +697,22 @@ private:
   float DefaultClientSendTimeoutSec;
   float DefaultClientReceiveTimeoutSec;
 
+  /*! Socket options of all clients and the options of the client classes that override them */
+  SocketOptions DefaultSocketOptions;
+  SocketOptions TrackingClientSocketOptions;
+  SocketOptions ImagingClientSocketOptions;
+
+  /*! Destination of the UDP output. UDP output is disabled if the port is not positive. */
+  std::string UdpOutputAddress;
+  int UdpOutputPort;
+  int UdpOutputMulticastTtl;
+
+  /*! Messages sent in the UDP output (only tracking message types) */
+  PlusIgtlClientInfo UdpOutputClientInfo;
+
+  /*! Socket of the UDP output, only used by the data sender thread after the server is started */
+  IgtlUdpSocket UdpOutputSocket;
+
   /*! Flag for IGTL CRC check */
   bool IgtlMessageCrcCheckEnabled;
 
@@ -315,8 +728,11 @@ private:
   /*! Channel ID to request the data from */
   std::string OutputChannelId;
 
-  /*! Channel to use for broadcasting */
-  vtkPlusChannel* BroadcastChannel;
+  /*! IDs of the channels that are published in addition to OutputChannelId */
+  std::vector<std::string> AdditionalOutputChannelIds;
+
+  /*! Channels to broadcast, the first one is the default channel. Only used by the data sender thread. */
+  std::vector<OutputChannel> OutputChannels;
 
   bool LogWarningOnNoDataAvailable;
 
@@ -333,7 +749,8 @@ private:
 
   static const float CLIENT_SOCKET_TIMEOUT_SEC;
 
-  bool NewClientConnected;
+  /*! Client ID that is used for packing the messages of the UDP output (client IDs of connected clients are positive) */
+  static const int UDP_OUTPUT_CLIENT_ID;
 };
 
 #endif
\ No newline at end of file
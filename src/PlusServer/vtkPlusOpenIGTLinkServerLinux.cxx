@@ -1,7 +1,15 @@
 #include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <errno.h>
 #include <ifaddrs.h>
+#include <limits.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
 void PrintServerInfo(vtkPlusOpenIGTLinkServer* self)
 {
@@ -35,4 +43,134 @@ void PrintServerInfo(vtkPlusOpenIGTLinkServer* self)
   }
   ss << " -- port " << self->GetListeningPort();
   LOG_INFO(ss.str());
-}
\ No newline at end of file
+}
+
+//----------------------------------------------------------------------------
+/*!
+  Waits until any of the registered sockets has data to read (or has been closed by the peer).
+  Implemented using epoll.
+*/
+class SocketPoller
+{
+public:
+  SocketPoller()
+    : EpollDescriptor(epoll_create1(0))
+  {
+  }
+
+  ~SocketPoller()
+  {
+    if (this->EpollDescriptor >= 0)
+    {
+      close(this->EpollDescriptor);
+    }
+  }
+
+  bool IsValid() const
+  {
+    return this->EpollDescriptor >= 0;
+  }
+
+  PlusStatus AddSocket(int socketDescriptor)
+  {
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = socketDescriptor;
+    if (epoll_ctl(this->EpollDescriptor, EPOLL_CTL_ADD, socketDescriptor, &event) == 0)
+    {
+      return PLUS_SUCCESS;
+    }
+    // The descriptor may be still registered if a closed socket's descriptor has been reused
+    if (errno == EEXIST && epoll_ctl(this->EpollDescriptor, EPOLL_CTL_MOD, socketDescriptor, &event) == 0)
+    {
+      return PLUS_SUCCESS;
+    }
+    return PLUS_FAIL;
+  }
+
+  void RemoveSocket(int socketDescriptor)
+  {
+    // Closed sockets are removed automatically, therefore errors are ignored
+    struct epoll_event event;
+    epoll_ctl(this->EpollDescriptor, EPOLL_CTL_DEL, socketDescriptor, &event);
+  }
+
+  /*! Get the sockets that are ready for reading. The list is empty if no socket became ready within the timeout. */
+  PlusStatus Wait(int timeoutMsec, std::vector<int>& readySocketDescriptors)
+  {
+    readySocketDescriptors.clear();
+    struct epoll_event events[MAX_NUMBER_OF_EVENTS];
+    int numberOfEvents = epoll_wait(this->EpollDescriptor, events, MAX_NUMBER_OF_EVENTS, timeoutMsec);
+    if (numberOfEvents < 0)
+    {
+      return (errno == EINTR ? PLUS_SUCCESS : PLUS_FAIL);
+    }
+    for (int i = 0; i < numberOfEvents; ++i)
+    {
+      readySocketDescriptors.push_back(events[i].data.fd);
+    }
+    return PLUS_SUCCESS;
+  }
+
+private:
+  static const int MAX_NUMBER_OF_EVENTS = 64;
+  int EpollDescriptor;
+};
+
+//----------------------------------------------------------------------------
+/*!
+  Send as much of the buffers as the socket accepts without blocking, using a single sendmsg call.
+  Returns the number of bytes sent or -1 if the connection is broken.
+*/
+int SendGatheredWithoutBlocking(int socketDescriptor, const std::vector<vtkPlusOpenIGTLinkServer::SendBuffer>& buffers)
+{
+  // Buffers above the limit will be sent in the next call
+  std::vector<struct iovec> ioVectors(std::min<size_t>(buffers.size(), IOV_MAX));
+  for (size_t i = 0; i < ioVectors.size(); ++i)
+  {
+    ioVectors[i].iov_base = const_cast<char*>(buffers[i].first);
+    ioVectors[i].iov_len = buffers[i].second;
+  }
+  struct msghdr message;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = &ioVectors[0];
+  message.msg_iovlen = ioVectors.size();
+  ssize_t bytesSent = sendmsg(socketDescriptor, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+  if (bytesSent < 0)
+  {
+    return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+  }
+  return static_cast<int>(bytesSent);
+}
+
+//----------------------------------------------------------------------------
+/*!
+  Receive as much of the requested data as available without blocking.
+  Returns the number of bytes received (0 if no data is available) or -1 if the connection is closed or broken.
+*/
+int ReceiveWithoutBlocking(int socketDescriptor, char* data, int length)
+{
+  ssize_t bytesReceived = recv(socketDescriptor, data, length, MSG_DONTWAIT);
+  if (bytesReceived == 0)
+  {
+    // Orderly shutdown by the peer
+    return -1;
+  }
+  if (bytesReceived < 0)
+  {
+    return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+  }
+  return static_cast<int>(bytesReceived);
+}
+
+//----------------------------------------------------------------------------
+/*! Set an integer socket option. If it fails then the reason is returned in errorMessage. */
+PlusStatus SetIntegerSocketOption(int socketDescriptor, int level, int optionName, int value, std::string& errorMessage)
+{
+  if (setsockopt(socketDescriptor, level, optionName, &value, sizeof(value)) != 0)
+  {
+    errorMessage = strerror(errno);
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
@@ -2,6 +2,7 @@
 #include <winsock2.h>
 #include <iphlpapi.h>
 #pragma comment(lib, "Iphlpapi.lib")
+#pragma comment(lib, "Ws2_32.lib")
 
 void PrintServerInfo(vtkPlusOpenIGTLinkServer* self)
 {
@@ -79,4 +80,163 @@ void PrintServerInfo(vtkPlusOpenIGTLinkServer* self)
   }
   ss << " -- port " << self->GetListeningPort();
   LOG_INFO(ss.str());
-}
\ No newline at end of file
+}
+
+//----------------------------------------------------------------------------
+/*!
+  Waits until any of the registered sockets has data to read (or has been closed by the peer).
+  Implemented using WSAPoll. I/O completion ports would require overlapped operations on the sockets,
+  which cannot be used together with the blocking igtl::Socket receive calls.
+*/
+class SocketPoller
+{
+public:
+  SocketPoller()
+  {
+  }
+
+  bool IsValid() const
+  {
+    return true;
+  }
+
+  PlusStatus AddSocket(int socketDescriptor)
+  {
+    for (std::vector<WSAPOLLFD>::iterator it = this->PollDescriptors.begin(); it != this->PollDescriptors.end(); ++it)
+    {
+      if (it->fd == static_cast<SOCKET>(socketDescriptor))
+      {
+        return PLUS_SUCCESS;
+      }
+    }
+    WSAPOLLFD pollDescriptor;
+    pollDescriptor.fd = static_cast<SOCKET>(socketDescriptor);
+    pollDescriptor.events = POLLRDNORM;
+    pollDescriptor.revents = 0;
+    this->PollDescriptors.push_back(pollDescriptor);
+    return PLUS_SUCCESS;
+  }
+
+  void RemoveSocket(int socketDescriptor)
+  {
+    for (std::vector<WSAPOLLFD>::iterator it = this->PollDescriptors.begin(); it != this->PollDescriptors.end(); ++it)
+    {
+      if (it->fd == static_cast<SOCKET>(socketDescriptor))
+      {
+        this->PollDescriptors.erase(it);
+        return;
+      }
+    }
+  }
+
+  /*! Get the sockets that are ready for reading. The list is empty if no socket became ready within the timeout. */
+  PlusStatus Wait(int timeoutMsec, std::vector<int>& readySocketDescriptors)
+  {
+    readySocketDescriptors.clear();
+    if (this->PollDescriptors.empty())
+    {
+      Sleep(timeoutMsec);
+      return PLUS_SUCCESS;
+    }
+    int numberOfEvents = WSAPoll(&this->PollDescriptors[0], static_cast<ULONG>(this->PollDescriptors.size()), timeoutMsec);
+    if (numberOfEvents == SOCKET_ERROR)
+    {
+      return PLUS_FAIL;
+    }
+    for (std::vector<WSAPOLLFD>::iterator it = this->PollDescriptors.begin(); it != this->PollDescriptors.end(); ++it)
+    {
+      if (it->revents & (POLLRDNORM | POLLHUP | POLLERR | POLLNVAL))
+      {
+        readySocketDescriptors.push_back(static_cast<int>(it->fd));
+      }
+    }
+    return PLUS_SUCCESS;
+  }
+
+private:
+  std::vector<WSAPOLLFD> PollDescriptors;
+};
+
+//----------------------------------------------------------------------------
+/*!
+  Send as much of the buffers as the socket accepts without blocking, using a single WSASend call.
+  Returns the number of bytes sent or -1 if the connection is broken.
+  The socket is switched to non-blocking mode only for the duration of the call, as igtl::Socket expects blocking mode.
+*/
+int SendGatheredWithoutBlocking(int socketDescriptor, const std::vector<vtkPlusOpenIGTLinkServer::SendBuffer>& buffers)
+{
+  std::vector<WSABUF> wsaBuffers(buffers.size());
+  for (size_t i = 0; i < buffers.size(); ++i)
+  {
+    wsaBuffers[i].buf = const_cast<char*>(buffers[i].first);
+    wsaBuffers[i].len = static_cast<ULONG>(buffers[i].second);
+  }
+
+  SOCKET socket = static_cast<SOCKET>(socketDescriptor);
+  u_long nonBlocking = 1;
+  if (ioctlsocket(socket, FIONBIO, &nonBlocking) == SOCKET_ERROR)
+  {
+    return -1;
+  }
+  DWORD bytesSent = 0;
+  int result = WSASend(socket, &wsaBuffers[0], static_cast<DWORD>(wsaBuffers.size()), &bytesSent, 0, NULL, NULL);
+  int error = (result == SOCKET_ERROR ? WSAGetLastError() : 0);
+  nonBlocking = 0;
+  ioctlsocket(socket, FIONBIO, &nonBlocking);
+  if (result == SOCKET_ERROR)
+  {
+    return (error == WSAEWOULDBLOCK ? 0 : -1);
+  }
+  return static_cast<int>(bytesSent);
+}
+
+//----------------------------------------------------------------------------
+/*!
+  Receive as much of the requested data as available without blocking.
+  Returns the number of bytes received (0 if no data is available) or -1 if the connection is closed or broken.
+  The socket is polled instead of switching it to non-blocking mode, as the sender thread switches the mode while sending.
+*/
+int ReceiveWithoutBlocking(int socketDescriptor, char* data, int length)
+{
+  WSAPOLLFD pollDescriptor;
+  pollDescriptor.fd = static_cast<SOCKET>(socketDescriptor);
+  pollDescriptor.events = POLLRDNORM;
+  pollDescriptor.revents = 0;
+  int numberOfEvents = WSAPoll(&pollDescriptor, 1, 0);
+  if (numberOfEvents == SOCKET_ERROR)
+  {
+    return -1;
+  }
+  if (numberOfEvents == 0)
+  {
+    return 0;
+  }
+  if (!(pollDescriptor.revents & POLLRDNORM))
+  {
+    // POLLHUP, POLLERR or POLLNVAL
+    return -1;
+  }
+  int bytesReceived = recv(static_cast<SOCKET>(socketDescriptor), data, length, 0);
+  if (bytesReceived == 0)
+  {
+    // Orderly shutdown by the peer
+    return -1;
+  }
+  if (bytesReceived == SOCKET_ERROR)
+  {
+    return (WSAGetLastError() == WSAEWOULDBLOCK ? 0 : -1);
+  }
+  return bytesReceived;
+}
+
+//----------------------------------------------------------------------------
+/*! Set an integer socket option. If it fails then the reason is returned in errorMessage. */
+PlusStatus SetIntegerSocketOption(int socketDescriptor, int level, int optionName, int value, std::string& errorMessage)
+{
+  if (setsockopt(static_cast<SOCKET>(socketDescriptor), level, optionName, reinterpret_cast<const char*>(&value), sizeof(value)) != 0)
+  {
+    errorMessage = "error code " + igsioCommon::ToString<int>(WSAGetLastError());
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
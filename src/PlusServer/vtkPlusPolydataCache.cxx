@@ -0,0 +1,221 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusPolydataCache.h"
+
+// VTK includes
+#include <vtkOBJReader.h>
+#include <vtkObjectFactory.h>
+#include <vtkPLYReader.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataAlgorithm.h>
+#include <vtkPolyDataReader.h>
+#include <vtkQuadricDecimation.h>
+#include <vtkSTLReader.h>
+#include <vtkTriangleFilter.h>
+#include <vtksys/SystemTools.hxx>
+
+// STL includes
+#include <algorithm>
+
+vtkStandardNewMacro(vtkPlusPolydataCache);
+
+//----------------------------------------------------------------------------
+vtkPlusPolydataCache::vtkPlusPolydataCache()
+  : MaximumNumberOfItems(16)
+{
+}
+
+//----------------------------------------------------------------------------
+vtkPlusPolydataCache::~vtkPlusPolydataCache()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusPolydataCache::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  os << indent << "MaximumNumberOfItems: " << this->MaximumNumberOfItems << std::endl;
+  os << indent << "NumberOfItems: " << this->Items.size() << std::endl;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusPolydataCache::GetPolyData(const std::string& filePath, double decimationTargetReduction, vtkSmartPointer<vtkPolyData>& polyData,
+    std::string& cacheKey, std::string& errorMessage)
+{
+  errorMessage.clear();
+  if (!vtksys::SystemTools::FileExists(filePath, true))
+  {
+    errorMessage = "Unable to locate file with name " + filePath;
+    return PLUS_FAIL;
+  }
+  decimationTargetReduction = std::max(0.0, std::min(decimationTargetReduction, 0.99));
+
+  std::ostringstream keyStream;
+  keyStream << filePath << "|" << vtksys::SystemTools::ModifiedTime(filePath) << "|" << decimationTargetReduction;
+  cacheKey = keyStream.str();
+
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    std::map<std::string, CacheItem>::iterator itemIt = this->Items.find(cacheKey);
+    if (itemIt != this->Items.end())
+    {
+      LOG_DEBUG("Polydata is found in the cache: " << filePath);
+      polyData = itemIt->second.PolyData;
+      this->Touch(cacheKey);
+      return PLUS_SUCCESS;
+    }
+  }
+
+  // The file is read without locking the cache, so that other models can be retrieved meanwhile
+  vtkSmartPointer<vtkPolyData> readPolyData;
+  if (ReadPolyData(filePath, readPolyData, errorMessage) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  if (decimationTargetReduction > 0)
+  {
+    vtkSmartPointer<vtkTriangleFilter> triangleFilter = vtkSmartPointer<vtkTriangleFilter>::New();
+    triangleFilter->SetInputData(readPolyData);
+    vtkSmartPointer<vtkQuadricDecimation> decimation = vtkSmartPointer<vtkQuadricDecimation>::New();
+    decimation->SetInputConnection(triangleFilter->GetOutputPort());
+    decimation->SetTargetReduction(decimationTargetReduction);
+    decimation->Update();
+    LOG_DEBUG("Polydata " << filePath << " is decimated from " << readPolyData->GetNumberOfPolys() << " to " << decimation->GetOutput()->GetNumberOfPolys() << " polygons");
+    readPolyData = decimation->GetOutput();
+  }
+
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  CacheItem& item = this->Items[cacheKey];
+  if (item.PolyData == NULL)
+  {
+    item.PolyData = readPolyData;
+  }
+  polyData = item.PolyData;
+  this->Touch(cacheKey);
+  this->RemoveExcessItems();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+igtl::MessageBase::Pointer vtkPlusPolydataCache::GetPackedMessage(const std::string& cacheKey, const std::string& messageVariant)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  std::map<std::string, CacheItem>::iterator itemIt = this->Items.find(cacheKey);
+  if (itemIt == this->Items.end())
+  {
+    return NULL;
+  }
+  std::map<std::string, igtl::MessageBase::Pointer>::iterator messageIt = itemIt->second.PackedMessages.find(messageVariant);
+  if (messageIt == itemIt->second.PackedMessages.end())
+  {
+    return NULL;
+  }
+  return messageIt->second;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusPolydataCache::SetPackedMessage(const std::string& cacheKey, const std::string& messageVariant, igtl::MessageBase::Pointer message)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  std::map<std::string, CacheItem>::iterator itemIt = this->Items.find(cacheKey);
+  if (itemIt == this->Items.end())
+  {
+    return;
+  }
+  itemIt->second.PackedMessages[messageVariant] = message;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusPolydataCache::Clear()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->Items.clear();
+  this->UsageOrder.clear();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusPolydataCache::SetMaximumNumberOfItems(int maximumNumberOfItems)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->MaximumNumberOfItems = std::max(maximumNumberOfItems, 0);
+  this->RemoveExcessItems();
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusPolydataCache::GetMaximumNumberOfItems()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return this->MaximumNumberOfItems;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusPolydataCache::Touch(const std::string& cacheKey)
+{
+  this->UsageOrder.remove(cacheKey);
+  this->UsageOrder.push_front(cacheKey);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusPolydataCache::RemoveExcessItems()
+{
+  while (this->UsageOrder.size() > static_cast<size_t>(this->MaximumNumberOfItems))
+  {
+    this->Items.erase(this->UsageOrder.back());
+    this->UsageOrder.pop_back();
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusPolydataCache::ReadPolyData(const std::string& filePath, vtkSmartPointer<vtkPolyData>& polyData, std::string& errorMessage)
+{
+  std::string extension = vtksys::SystemTools::LowerCase(vtksys::SystemTools::GetFilenameLastExtension(filePath));
+  vtkSmartPointer<vtkPolyDataAlgorithm> reader;
+  if (extension == ".stl")
+  {
+    vtkSmartPointer<vtkSTLReader> stlReader = vtkSmartPointer<vtkSTLReader>::New();
+    stlReader->SetFileName(filePath.c_str());
+    reader = stlReader;
+  }
+  else if (extension == ".obj")
+  {
+    vtkSmartPointer<vtkOBJReader> objReader = vtkSmartPointer<vtkOBJReader>::New();
+    objReader->SetFileName(filePath.c_str());
+    reader = objReader;
+  }
+  else if (extension == ".ply")
+  {
+    vtkSmartPointer<vtkPLYReader> plyReader = vtkSmartPointer<vtkPLYReader>::New();
+    plyReader->SetFileName(filePath.c_str());
+    reader = plyReader;
+  }
+  else
+  {
+    vtkSmartPointer<vtkPolyDataReader> vtkReader = vtkSmartPointer<vtkPolyDataReader>::New();
+    vtkReader->SetFileName(filePath.c_str());
+    if (!vtkReader->IsFilePolyData())
+    {
+      errorMessage = "Unrecognized polydata file type: " + filePath;
+      return PLUS_FAIL;
+    }
+    reader = vtkReader;
+  }
+
+  reader->Update();
+  if (reader->GetErrorCode() != 0 || reader->GetOutput() == NULL)
+  {
+    std::ostringstream ss;
+    ss << "Reader threw error: " << reader->GetErrorCode();
+    errorMessage = ss.str();
+    return PLUS_FAIL;
+  }
+  polyData = reader->GetOutput();
+  LOG_DEBUG("Polydata is read from file " << filePath << ": " << polyData->GetNumberOfPoints() << " points, " << polyData->GetNumberOfPolys() << " polygons");
+  return PLUS_SUCCESS;
+}
@@ -0,0 +1,101 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusPolydataCache_h
+#define __vtkPlusPolydataCache_h
+
+#include "vtkPlusServerExport.h"
+
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+#include <igtlMessageBase.h>
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+
+class vtkPolyData;
+
+/*!
+  \class vtkPlusPolydataCache
+  \brief Keeps the recently requested model files parsed, and their packed POLYDATA messages, so that repeated
+  GET_POLYDATA requests of the same model do not read and pack the file again.
+
+  Items are identified by the file path, the modification time of the file, and the decimation target reduction,
+  so a modified file is read again. At most MaximumNumberOfItems items are kept, the least recently used item is removed first.
+  Packed messages are stored for each message variant (header version and message name) of an item.
+  The cached polydata and messages must not be modified.
+
+  All methods are safe to be called from any thread.
+  \ingroup PlusLibPlusServer
+*/
+class vtkPlusServerExport vtkPlusPolydataCache : public vtkObject
+{
+public:
+  static vtkPlusPolydataCache* New();
+  vtkTypeMacro(vtkPlusPolydataCache, vtkObject);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  /*!
+    Get the polydata of a model file, read it if it is not in the cache.
+    \param filePath Full path of the VTK, STL, OBJ or PLY file
+    \param decimationTargetReduction If positive then the mesh is decimated, this fraction (between 0 and 1) of the triangles is removed
+    \param polyData The polydata, it must not be modified
+    \param cacheKey Identifies the item, used for getting and storing the packed messages
+  */
+  PlusStatus GetPolyData(const std::string& filePath, double decimationTargetReduction, vtkSmartPointer<vtkPolyData>& polyData,
+                         std::string& cacheKey, std::string& errorMessage);
+
+  /*!
+    Get a packed POLYDATA message of an item. Returns NULL if it has not been stored.
+    \param messageVariant Identifies the message among the messages of the item (e.g., header version and name)
+  */
+  igtl::MessageBase::Pointer GetPackedMessage(const std::string& cacheKey, const std::string& messageVariant);
+
+  /*! Store a packed POLYDATA message of an item. Ignored if the item has been removed from the cache since. */
+  void SetPackedMessage(const std::string& cacheKey, const std::string& messageVariant, igtl::MessageBase::Pointer message);
+
+  /*! Remove all items */
+  void Clear();
+
+  /*! Maximum number of models kept in the cache. Removes the least recently used items if there are more. */
+  void SetMaximumNumberOfItems(int maximumNumberOfItems);
+  int GetMaximumNumberOfItems();
+
+protected:
+  struct CacheItem
+  {
+    vtkSmartPointer<vtkPolyData> PolyData;
+    /*! Packed messages, by message variant */
+    std::map<std::string, igtl::MessageBase::Pointer> PackedMessages;
+  };
+
+  /*! Read a model file, try the file formats in order */
+  static PlusStatus ReadPolyData(const std::string& filePath, vtkSmartPointer<vtkPolyData>& polyData, std::string& errorMessage);
+
+  /*! Move an item to the front of the usage list. Mutex must be locked by the caller. */
+  void Touch(const std::string& cacheKey);
+
+  /*! Remove the least recently used items above MaximumNumberOfItems. Mutex must be locked by the caller. */
+  void RemoveExcessItems();
+
+  vtkPlusPolydataCache();
+  virtual ~vtkPlusPolydataCache();
+
+  std::mutex Mutex;
+  int MaximumNumberOfItems;
+  std::map<std::string, CacheItem> Items;
+  /*! Cache keys, the most recently used first */
+  std::list<std::string> UsageOrder;
+
+private:
+  vtkPlusPolydataCache(const vtkPlusPolydataCache&);
+  void operator=(const vtkPlusPolydataCache&);
+};
+
+#endif
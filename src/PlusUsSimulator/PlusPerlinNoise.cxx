@@ -0,0 +1,343 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+
+#include "PlusPerlinNoise.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  // SSE2 is available on all 64-bit x86 processors
+  #define PLUS_PERLINNOISE_SSE2
+  #include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+  // NEON is always available on 64-bit ARM
+  #define PLUS_PERLINNOISE_NEON
+  #include <arm_neon.h>
+#endif
+
+namespace
+{
+  /*! Permutation table of the improved Perlin noise, repeated twice so that hashes of neighbor lattice points can be looked up without wrapping */
+  const int PERMUTATION[512] =
+  {
+    151, 160, 137, 91, 90, 15, 131, 13, 201, 95, 96, 53, 194, 233, 7, 225,
+    140, 36, 103, 30, 69, 142, 8, 99, 37, 240, 21, 10, 23, 190, 6, 148,
+    247, 120, 234, 75, 0, 26, 197, 62, 94, 252, 219, 203, 117, 35, 11, 32,
+    57, 177, 33, 88, 237, 149, 56, 87, 174, 20, 125, 136, 171, 168, 68, 175,
+    74, 165, 71, 134, 139, 48, 27, 166, 77, 146, 158, 231, 83, 111, 229, 122,
+    60, 211, 133, 230, 220, 105, 92, 41, 55, 46, 245, 40, 244, 102, 143, 54,
+    65, 25, 63, 161, 1, 216, 80, 73, 209, 76, 132, 187, 208, 89, 18, 169,
+    200, 196, 135, 130, 116, 188, 159, 86, 164, 100, 109, 198, 173, 186, 3, 64,
+    52, 217, 226, 250, 124, 123, 5, 202, 38, 147, 118, 126, 255, 82, 85, 212,
+    207, 206, 59, 227, 47, 16, 58, 17, 182, 189, 28, 42, 223, 183, 170, 213,
+    119, 248, 152, 2, 44, 154, 163, 70, 221, 153, 101, 155, 167, 43, 172, 9,
+    129, 22, 39, 253, 19, 98, 108, 110, 79, 113, 224, 232, 178, 185, 112, 104,
+    218, 246, 97, 228, 251, 34, 242, 193, 238, 210, 144, 12, 191, 179, 162, 241,
+    81, 51, 145, 235, 249, 14, 239, 107, 49, 192, 214, 31, 181, 199, 106, 157,
+    184, 84, 204, 176, 115, 121, 50, 45, 127, 4, 150, 254, 138, 236, 205, 93,
+    222, 114, 67, 29, 24, 72, 243, 141, 128, 195, 78, 66, 215, 61, 156, 180,
+    151, 160, 137, 91, 90, 15, 131, 13, 201, 95, 96, 53, 194, 233, 7, 225,
+    140, 36, 103, 30, 69, 142, 8, 99, 37, 240, 21, 10, 23, 190, 6, 148,
+    247, 120, 234, 75, 0, 26, 197, 62, 94, 252, 219, 203, 117, 35, 11, 32,
+    57, 177, 33, 88, 237, 149, 56, 87, 174, 20, 125, 136, 171, 168, 68, 175,
+    74, 165, 71, 134, 139, 48, 27, 166, 77, 146, 158, 231, 83, 111, 229, 122,
+    60, 211, 133, 230, 220, 105, 92, 41, 55, 46, 245, 40, 244, 102, 143, 54,
+    65, 25, 63, 161, 1, 216, 80, 73, 209, 76, 132, 187, 208, 89, 18, 169,
+    200, 196, 135, 130, 116, 188, 159, 86, 164, 100, 109, 198, 173, 186, 3, 64,
+    52, 217, 226, 250, 124, 123, 5, 202, 38, 147, 118, 126, 255, 82, 85, 212,
+    207, 206, 59, 227, 47, 16, 58, 17, 182, 189, 28, 42, 223, 183, 170, 213,
+    119, 248, 152, 2, 44, 154, 163, 70, 221, 153, 101, 155, 167, 43, 172, 9,
+    129, 22, 39, 253, 19, 98, 108, 110, 79, 113, 224, 232, 178, 185, 112, 104,
+    218, 246, 97, 228, 251, 34, 242, 193, 238, 210, 144, 12, 191, 179, 162, 241,
+    81, 51, 145, 235, 249, 14, 239, 107, 49, 192, 214, 31, 181, 199, 106, 157,
+    184, 84, 204, 176, 115, 121, 50, 45, 127, 4, 150, 254, 138, 236, 205, 93,
+    222, 114, 67, 29, 24, 72, 243, 141, 128, 195, 78, 66, 215, 61, 156, 180
+  };
+
+  /*!
+    Gradient directions of the improved Perlin noise, indexed by the lowest 4 bits of the hash.
+    Same as the gradient function of the reference implementation, but as vectors, so the gradient is a dot product.
+  */
+  const float GRADIENTS[16][3] =
+  {
+    { 1, 1, 0 }, { -1, 1, 0 }, { 1, -1, 0 }, { -1, -1, 0 },
+    { 1, 0, 1 }, { -1, 0, 1 }, { 1, 0, -1 }, { -1, 0, -1 },
+    { 0, 1, 1 }, { 0, -1, 1 }, { 0, 1, -1 }, { 0, -1, -1 },
+    { 1, 1, 0 }, { 0, -1, 1 }, { -1, 1, 0 }, { 0, -1, -1 }
+  };
+
+  //-----------------------------------------------------------------------------
+  // Operations on PACKET_SIZE floats
+#if defined(PLUS_PERLINNOISE_SSE2)
+  typedef __m128 FloatPacket;
+  inline FloatPacket Load(const float* values) { return _mm_loadu_ps(values); }
+  inline void Store(float* values, FloatPacket packet) { _mm_storeu_ps(values, packet); }
+  inline FloatPacket Splat(float value) { return _mm_set1_ps(value); }
+  inline FloatPacket Add(FloatPacket a, FloatPacket b) { return _mm_add_ps(a, b); }
+  inline FloatPacket Subtract(FloatPacket a, FloatPacket b) { return _mm_sub_ps(a, b); }
+  inline FloatPacket Multiply(FloatPacket a, FloatPacket b) { return _mm_mul_ps(a, b); }
+#elif defined(PLUS_PERLINNOISE_NEON)
+  typedef float32x4_t FloatPacket;
+  inline FloatPacket Load(const float* values) { return vld1q_f32(values); }
+  inline void Store(float* values, FloatPacket packet) { vst1q_f32(values, packet); }
+  inline FloatPacket Splat(float value) { return vdupq_n_f32(value); }
+  inline FloatPacket Add(FloatPacket a, FloatPacket b) { return vaddq_f32(a, b); }
+  inline FloatPacket Subtract(FloatPacket a, FloatPacket b) { return vsubq_f32(a, b); }
+  inline FloatPacket Multiply(FloatPacket a, FloatPacket b) { return vmulq_f32(a, b); }
+#else
+  struct FloatPacket
+  {
+    float Values[PlusPerlinNoise::PACKET_SIZE];
+  };
+  inline FloatPacket Load(const float* values) { FloatPacket packet; std::copy(values, values + PlusPerlinNoise::PACKET_SIZE, packet.Values); return packet; }
+  inline void Store(float* values, const FloatPacket& packet) { std::copy(packet.Values, packet.Values + PlusPerlinNoise::PACKET_SIZE, values); }
+  inline FloatPacket Splat(float value) { FloatPacket packet; std::fill(packet.Values, packet.Values + PlusPerlinNoise::PACKET_SIZE, value); return packet; }
+  inline FloatPacket Add(FloatPacket a, const FloatPacket& b) { for (int i = 0; i < PlusPerlinNoise::PACKET_SIZE; i++) { a.Values[i] += b.Values[i]; } return a; }
+  inline FloatPacket Subtract(FloatPacket a, const FloatPacket& b) { for (int i = 0; i < PlusPerlinNoise::PACKET_SIZE; i++) { a.Values[i] -= b.Values[i]; } return a; }
+  inline FloatPacket Multiply(FloatPacket a, const FloatPacket& b) { for (int i = 0; i < PlusPerlinNoise::PACKET_SIZE; i++) { a.Values[i] *= b.Values[i]; } return a; }
+#endif
+
+  //-----------------------------------------------------------------------------
+  /*! Fade curve of the improved noise: 6t^5 - 15t^4 + 10t^3 */
+  inline FloatPacket Fade(FloatPacket t)
+  {
+    FloatPacket polynomial = Add(Multiply(t, Subtract(Multiply(t, Splat(6.0f)), Splat(15.0f))), Splat(10.0f));
+    return Multiply(Multiply(Multiply(t, t), t), polynomial);
+  }
+
+  //-----------------------------------------------------------------------------
+  inline FloatPacket Lerp(FloatPacket t, FloatPacket a, FloatPacket b)
+  {
+    return Add(a, Multiply(Subtract(b, a), t));
+  }
+
+  //-----------------------------------------------------------------------------
+  /*! Lattice cell with the gradients at its corners, corner index bits are the x, y, z offsets */
+  struct LatticeCell
+  {
+    LatticeCell() { std::fill(this->Index, this->Index + 3, -1); }
+    int Index[3];
+    const float* Gradients[8];
+  };
+
+  //-----------------------------------------------------------------------------
+  /*! Look up the gradients at the corners of a lattice cell */
+  void SetLatticeCell(const int index[3], LatticeCell& cell)
+  {
+    int a = PERMUTATION[index[0]] + index[1];
+    int b = PERMUTATION[index[0] + 1] + index[1];
+    int hashes[8] =
+    {
+      PERMUTATION[PERMUTATION[a] + index[2]],
+      PERMUTATION[PERMUTATION[b] + index[2]],
+      PERMUTATION[PERMUTATION[a + 1] + index[2]],
+      PERMUTATION[PERMUTATION[b + 1] + index[2]],
+      PERMUTATION[PERMUTATION[a] + index[2] + 1],
+      PERMUTATION[PERMUTATION[b] + index[2] + 1],
+      PERMUTATION[PERMUTATION[a + 1] + index[2] + 1],
+      PERMUTATION[PERMUTATION[b + 1] + index[2] + 1]
+    };
+    for (int corner = 0; corner < 8; corner++)
+    {
+      cell.Gradients[corner] = GRADIENTS[hashes[corner] & 15];
+    }
+    std::copy(index, index + 3, cell.Index);
+  }
+
+  //-----------------------------------------------------------------------------
+  /*! Same as std::floor for the range of noise positions, but it is inlined (std::floor is a library call without SSE4.1) */
+  inline double Floor(double value)
+  {
+    double truncated = static_cast<double>(static_cast<long long>(value));
+    return truncated > value ? truncated - 1.0 : truncated;
+  }
+
+  //-----------------------------------------------------------------------------
+  /*! Update the cell if the position is in a different lattice cell. Returns true if the cell has changed. */
+  bool UpdateLatticeCell(const double position[3], double cellPosition[3], LatticeCell& cell)
+  {
+    int index[3] = { 0, 0, 0 };
+    for (int axis = 0; axis < 3; axis++)
+    {
+      cellPosition[axis] = Floor(position[axis]);
+      // the noise repeats every 256 lattice cells
+      index[axis] = static_cast<int>(static_cast<long long>(cellPosition[axis]) & 255);
+    }
+    if (index[0] == cell.Index[0] && index[1] == cell.Index[1] && index[2] == cell.Index[2])
+    {
+      return false;
+    }
+    SetLatticeCell(index, cell);
+    return true;
+  }
+
+  //-----------------------------------------------------------------------------
+  /*! Evaluate the noise for the samples of a packet from their positions within their cells and the corner gradients */
+  void EvaluatePacket(const FloatPacket fraction[3], const FloatPacket gradients[8][3], float* noise)
+  {
+    FloatPacket fade[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+      fade[axis] = Fade(fraction[axis]);
+    }
+    // Dot products of the corner gradients and the vectors from the corners to the sample
+    FloatPacket cornerValues[8];
+    for (int corner = 0; corner < 8; corner++)
+    {
+      FloatPacket value = Splat(0.0f);
+      for (int axis = 0; axis < 3; axis++)
+      {
+        FloatPacket offset = (corner & (1 << axis)) ? Subtract(fraction[axis], Splat(1.0f)) : fraction[axis];
+        value = Add(value, Multiply(gradients[corner][axis], offset));
+      }
+      cornerValues[corner] = value;
+    }
+    FloatPacket z0 = Lerp(fade[1], Lerp(fade[0], cornerValues[0], cornerValues[1]), Lerp(fade[0], cornerValues[2], cornerValues[3]));
+    FloatPacket z1 = Lerp(fade[1], Lerp(fade[0], cornerValues[4], cornerValues[5]), Lerp(fade[0], cornerValues[6], cornerValues[7]));
+    Store(noise, Lerp(fade[2], z0, z1));
+  }
+}
+
+//-----------------------------------------------------------------------------
+PlusPerlinNoise::PlusPerlinNoise()
+  : Amplitude(1.0)
+{
+  std::fill(this->Frequency, this->Frequency + 3, 1.0);
+  std::fill(this->Phase, this->Phase + 3, 0.0);
+}
+
+//-----------------------------------------------------------------------------
+PlusPerlinNoise::~PlusPerlinNoise()
+{
+}
+
+//-----------------------------------------------------------------------------
+void PlusPerlinNoise::SetAmplitude(double amplitude)
+{
+  this->Amplitude = amplitude;
+}
+
+//-----------------------------------------------------------------------------
+double PlusPerlinNoise::GetAmplitude() const
+{
+  return this->Amplitude;
+}
+
+//-----------------------------------------------------------------------------
+void PlusPerlinNoise::SetFrequency(const double frequency[3])
+{
+  std::copy(frequency, frequency + 3, this->Frequency);
+}
+
+//-----------------------------------------------------------------------------
+void PlusPerlinNoise::SetPhase(const double phase[3])
+{
+  std::copy(phase, phase + 3, this->Phase);
+}
+
+//-----------------------------------------------------------------------------
+void PlusPerlinNoise::EvaluateLine(const double startPoint[3], const double step[3], int numberOfSamples, double* noise) const
+{
+  const float laneOffsets[PACKET_SIZE] = { 0.0f, 1.0f, 2.0f, 3.0f };
+  double scaledStep[3] = { 0, 0, 0 };
+  for (int axis = 0; axis < 3; axis++)
+  {
+    scaledStep[axis] = step[axis] * this->Frequency[axis];
+  }
+
+  LatticeCell cell;
+  // If true then gradients contain the gradients of cell for all samples
+  bool gradientsOfCell = false;
+  FloatPacket fraction[3];
+  FloatPacket gradients[8][3];
+  float packetNoise[PACKET_SIZE];
+  for (int firstSampleIndex = 0; firstSampleIndex < numberOfSamples; firstSampleIndex += PACKET_SIZE)
+  {
+    int numberOfSamplesInPacket = std::min<int>(numberOfSamples - firstSampleIndex, static_cast<int>(PACKET_SIZE));
+    double firstPosition[3] = { 0, 0, 0 };
+    double lastPosition[3] = { 0, 0, 0 };
+    for (int axis = 0; axis < 3; axis++)
+    {
+      firstPosition[axis] = (startPoint[axis] + firstSampleIndex * step[axis]) * this->Frequency[axis] - this->Phase[axis] * 2.0;
+      lastPosition[axis] = (startPoint[axis] + (firstSampleIndex + PACKET_SIZE - 1) * step[axis]) * this->Frequency[axis] - this->Phase[axis] * 2.0;
+    }
+    double firstCellPosition[3] = { 0, 0, 0 };
+    double lastCellPosition[3] = { 0, 0, 0 };
+    for (int axis = 0; axis < 3; axis++)
+    {
+      lastCellPosition[axis] = Floor(lastPosition[axis]);
+    }
+    if (UpdateLatticeCell(firstPosition, firstCellPosition, cell))
+    {
+      gradientsOfCell = false;
+    }
+
+    if (std::equal(firstCellPosition, firstCellPosition + 3, lastCellPosition))
+    {
+      // The samples are on a line, so if the first and last samples are in the same cell then all of them are in that cell.
+      // This is the usual case, as the noise features are much larger than the distance between the samples.
+      for (int axis = 0; axis < 3; axis++)
+      {
+        fraction[axis] = Add(Splat(static_cast<float>(firstPosition[axis] - firstCellPosition[axis])), Multiply(Load(laneOffsets), Splat(static_cast<float>(scaledStep[axis]))));
+      }
+      if (!gradientsOfCell)
+      {
+        for (int corner = 0; corner < 8; corner++)
+        {
+          for (int axis = 0; axis < 3; axis++)
+          {
+            gradients[corner][axis] = Splat(cell.Gradients[corner][axis]);
+          }
+        }
+        gradientsOfCell = true;
+      }
+    }
+    else
+    {
+      // The packet crosses a cell boundary, find the cell of each sample
+      float laneFractions[3][PACKET_SIZE];
+      float laneGradients[8][3][PACKET_SIZE];
+      for (int lane = 0; lane < PACKET_SIZE; lane++)
+      {
+        // unused lanes of the last packet repeat its last sample
+        int sampleIndex = firstSampleIndex + std::min(lane, numberOfSamplesInPacket - 1);
+        double position[3] = { 0, 0, 0 };
+        double cellPosition[3] = { 0, 0, 0 };
+        for (int axis = 0; axis < 3; axis++)
+        {
+          position[axis] = (startPoint[axis] + sampleIndex * step[axis]) * this->Frequency[axis] - this->Phase[axis] * 2.0;
+        }
+        UpdateLatticeCell(position, cellPosition, cell);
+        for (int axis = 0; axis < 3; axis++)
+        {
+          laneFractions[axis][lane] = static_cast<float>(position[axis] - cellPosition[axis]);
+          for (int corner = 0; corner < 8; corner++)
+          {
+            laneGradients[corner][axis][lane] = cell.Gradients[corner][axis];
+          }
+        }
+      }
+      for (int axis = 0; axis < 3; axis++)
+      {
+        fraction[axis] = Load(laneFractions[axis]);
+        for (int corner = 0; corner < 8; corner++)
+        {
+          gradients[corner][axis] = Load(laneGradients[corner][axis]);
+        }
+      }
+      gradientsOfCell = false;
+    }
+
+    EvaluatePacket(fraction, gradients, packetNoise);
+    for (int lane = 0; lane < numberOfSamplesInPacket; lane++)
+    {
+      noise[firstSampleIndex + lane] = this->Amplitude * packetNoise[lane];
+    }
+  }
+}
@@ -0,0 +1,59 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusPerlinNoise_h
+#define __PlusPerlinNoise_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusUsSimulatorExport.h"
+
+/*!
+  \class PlusPerlinNoise
+  \brief Improved Perlin noise (K. Perlin, 2002) evaluated for many equally spaced sample points at once
+
+  The noise is evaluated at position * Frequency - Phase * 2 and scaled by Amplitude, as in vtkPerlinNoise,
+  but it uses the improved noise function, which is the same as the noise of the OpenCL ultrasound simulation
+  (vtkPlusUsSimulatorAlgoOpenCL). The noise pattern differs from vtkPerlinNoise, but it is a coherent noise
+  of the same feature size; its standard deviation is about a quarter of Amplitude, so the amplitude may need to be adjusted
+  when a configuration is switched between the two generators.
+
+  EvaluateLine computes PACKET_SIZE samples together: the lattice hashes are computed per sample, the gradients,
+  fade curves and interpolation with SSE2 or NEON instructions if available. The object is not modified while
+  the noise is evaluated, so EvaluateLine can be called from multiple threads.
+
+  \ingroup PlusLibUsSimulatorAlgo
+*/
+class vtkPlusUsSimulatorExport PlusPerlinNoise
+{
+public:
+  /*! Number of samples that are evaluated together */
+  static const int PACKET_SIZE = 4;
+
+  PlusPerlinNoise();
+  virtual ~PlusPerlinNoise();
+
+  void SetAmplitude(double amplitude);
+  double GetAmplitude() const;
+
+  void SetFrequency(const double frequency[3]);
+  void SetPhase(const double phase[3]);
+
+  /*!
+    Evaluate the noise at equally spaced points of a line.
+    \param startPoint Position of the first sample
+    \param step Difference of the positions of subsequent samples
+    \param numberOfSamples Number of samples
+    \param noise Output array of numberOfSamples values
+  */
+  void EvaluateLine(const double startPoint[3], const double step[3], int numberOfSamples, double* noise) const;
+
+protected:
+  double Amplitude;
+  double Frequency[3];
+  double Phase[3];
+};
+
+#endif // __PlusPerlinNoise_h
@@ -10,15 +10,17 @@ See License.txt for details.
 
 #include "vtkMath.h"
 #include "vtkMatrix4x4.h"
-#include "vtkModifiedBSPTree.h"
 #include "vtkObjectFactory.h"
 #include "vtkSTLReader.h"
 #include "vtkXMLPolyDataReader.h"
 #include "vtkPolyDataNormals.h"
+#include "vtkDecimatePro.h"
 #include "vtkProbeFilter.h"
 #include "vtkPointData.h"
 #include "vtkIdList.h"
-#include "vtkTriangle.h"
+
+#include <algorithm>
+#include <sstream>
 
 // If fraction of the transmitted beam intensity is smaller then this value then we consider the beam to be completely absorbed
 const double MINIMUM_BEAM_INTENSITY = 1e-9;
@@ -26,6 +28,33 @@ const double MINIMUM_BEAM_INTENSITY = 1e-9;
 // Characterizes the specular reflection BRDF. If the value is smaller then reflection is limited to a smaller angle range (closer to 90deg incidence angle).
 double SPECULAR_REFLECTION_BRDF_STDEV = 30.0;
 
+// Surfaces with fewer triangles are not decimated further
+const int MINIMUM_NUMBER_OF_TRIANGLES_IN_LEVEL_OF_DETAIL = 100;
+
+namespace
+{
+  //-----------------------------------------------------------------------------
+  double GetMeanEdgeLength(const PlusTriangleBvh& triangleBvh)
+  {
+    const std::vector<PlusTriangleBvh::Triangle>& triangles = triangleBvh.GetTriangles();
+    if (triangles.empty())
+    {
+      return 0.0;
+    }
+    double sumEdgeLength = 0.0;
+    for (std::vector<PlusTriangleBvh::Triangle>::const_iterator triangleIt = triangles.begin(); triangleIt != triangles.end(); ++triangleIt)
+    {
+      double edge3[3] = {triangleIt->Edge2[0] - triangleIt->Edge1[0], triangleIt->Edge2[1] - triangleIt->Edge1[1], triangleIt->Edge2[2] - triangleIt->Edge1[2]};
+      sumEdgeLength += vtkMath::Norm(triangleIt->Edge1) + vtkMath::Norm(triangleIt->Edge2) + vtkMath::Norm(edge3);
+    }
+    return sumEdgeLength / (3 * triangles.size());
+  }
+}
+
+std::map<std::string, std::weak_ptr<const std::vector<PlusSpatialModel::LevelOfDetail> > > PlusSpatialModel::SharedLevelsOfDetail;
+std::map<std::string, std::shared_future<std::shared_ptr<const std::vector<PlusSpatialModel::LevelOfDetail> > > > PlusSpatialModel::LoadingLevelsOfDetail;
+std::mutex PlusSpatialModel::SharedLevelsOfDetailMutex;
+
 //-----------------------------------------------------------------------------
 PlusSpatialModel::PlusSpatialModel()
   : Name("")
@@ -43,7 +72,8 @@ PlusSpatialModel::PlusSpatialModel()
   , TransducerSpatialModelMaxOverlapMm(10.0)
   , SurfaceSpecularReflectionCoefficient(0.0)
   , SurfaceDiffuseReflectionCoefficient(0.1)
-  , ModelLocalizer(vtkModifiedBSPTree::New())
+  , NumberOfLevelsOfDetail(1)
+  , LevelOfDetailReduction(0.5)
   , PolyData(NULL)
 {
 }
@@ -53,7 +83,6 @@ PlusSpatialModel::~PlusSpatialModel()
 {
   SetModelToObjectTransform(static_cast<vtkMatrix4x4*>(NULL));
   SetReferenceToObjectTransform(NULL);
-  SetModelLocalizer(NULL);
   SetPolyData(NULL);
 }
 
@@ -73,15 +102,17 @@ PlusSpatialModel::PlusSpatialModel(const PlusSpatialModel& model)
   this->SurfaceSpecularReflectionCoefficient = model.SurfaceSpecularReflectionCoefficient;
   this->ModelToObjectTransform = NULL;
   this->ReferenceToObjectTransform = NULL;
-  this->ModelLocalizer = NULL;
   this->PolyData = NULL;
   SetModelToObjectTransform(model.ModelToObjectTransform);
   SetReferenceToObjectTransform(model.ReferenceToObjectTransform);
-  SetModelLocalizer(model.ModelLocalizer);
+  this->TriangleBvh = model.TriangleBvh;
   SetPolyData(model.PolyData);
   this->ModelFileNeedsUpdate = model.ModelFileNeedsUpdate;
-  this->PrecomputedAttenuations = model.PrecomputedAttenuations;
+  this->PrecomputedAttenuationProfile = model.PrecomputedAttenuationProfile;
   this->TransducerSpatialModelMaxOverlapMm = model.TransducerSpatialModelMaxOverlapMm;
+  this->NumberOfLevelsOfDetail = model.NumberOfLevelsOfDetail;
+  this->LevelOfDetailReduction = model.LevelOfDetailReduction;
+  this->LevelsOfDetail = model.LevelsOfDetail;
 }
 
 //-----------------------------------------------------------------------------
@@ -100,11 +131,14 @@ void PlusSpatialModel::operator=(const PlusSpatialModel& model)
   this->SurfaceSpecularReflectionCoefficient = model.SurfaceSpecularReflectionCoefficient;
   SetModelToObjectTransform(model.ModelToObjectTransform);
   SetReferenceToObjectTransform(model.ReferenceToObjectTransform);
-  SetModelLocalizer(model.ModelLocalizer);
+  this->TriangleBvh = model.TriangleBvh;
   SetPolyData(model.PolyData);
   this->ModelFileNeedsUpdate = model.ModelFileNeedsUpdate;
-  this->PrecomputedAttenuations = model.PrecomputedAttenuations;
+  this->PrecomputedAttenuationProfile = model.PrecomputedAttenuationProfile;
   this->TransducerSpatialModelMaxOverlapMm = model.TransducerSpatialModelMaxOverlapMm;
+  this->NumberOfLevelsOfDetail = model.NumberOfLevelsOfDetail;
+  this->LevelOfDetailReduction = model.LevelOfDetailReduction;
+  this->LevelsOfDetail = model.LevelsOfDetail;
 }
 
 //-----------------------------------------------------------------------------
@@ -161,24 +195,6 @@ void PlusSpatialModel::SetPolyData(vtkPolyData* polyData)
   }
 }
 
-//-----------------------------------------------------------------------------
-void PlusSpatialModel::SetModelLocalizer(vtkModifiedBSPTree* modelLocalizer)
-{
-  if (this->ModelLocalizer == modelLocalizer)
-  {
-    return;
-  }
-  if (this->ModelLocalizer != NULL)
-  {
-    this->ModelLocalizer->Delete();
-  }
-  this->ModelLocalizer = modelLocalizer;
-  if (this->ModelLocalizer != NULL)
-  {
-    this->ModelLocalizer->Register(NULL);
-  }
-}
-
 //-----------------------------------------------------------------------------
 PlusStatus PlusSpatialModel::ReadConfiguration(vtkXMLDataElement* spatialModelElement)
 {
@@ -196,6 +212,8 @@ PlusStatus PlusSpatialModel::ReadConfiguration(vtkXMLDataElement* spatialModelEl
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, SurfaceDiffuseReflectionCoefficient, spatialModelElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, SurfaceSpecularReflectionCoefficient, spatialModelElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, TransducerSpatialModelMaxOverlapMm, spatialModelElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfLevelsOfDetail, spatialModelElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, LevelOfDetailReduction, spatialModelElement);
 
   return PLUS_SUCCESS;
 }
@@ -252,10 +270,16 @@ void PlusSpatialModel::CalculateIntensity(std::vector<double>& reflectedIntensit
     backscatteredReflectedIntensity += reflectionDirectionFactor * this->SurfaceSpecularReflectionCoefficient * surfaceReflectedBeamIntensity;
   }
 
+  if (!IsAttenuationProfileUpToDate(numberOfFilledPixels, distanceBetweenScanlineSamplePointsMm))
+  {
+    // PrepareForSimulation has not been called for these parameters
+    UpdateAttenuationProfile(numberOfFilledPixels, distanceBetweenScanlineSamplePointsMm);
+  }
+  const AttenuationProfile& profile = this->PrecomputedAttenuationProfile;
+
   // Compute attenuation within this model
-  double intensityAttenuationCoefficientdBPerPixel = this->AttenuationCoefficientDbPerCmMhz * (distanceBetweenScanlineSamplePointsMm / 10.0) * this->ImagingFrequencyMhz;
   // intensityAttenuationCoefficientPerPixel: should be close to 1, as it's the ratio of (transmitted beam intensity / incident beam intensity) after traversing through a single pixel
-  double intensityAttenuationCoefficientPerPixel = pow(10.0, -intensityAttenuationCoefficientdBPerPixel / 10.0);
+  double intensityAttenuationCoefficientPerPixel = profile.IntensityAttenuationCoefficientPerPixel;
   // intensityAttenuatedFractionPerPixel: how big fraction of the intensity is attenuated during traversing through one voxel
   double intensityAttenuatedFractionPerPixel = (1 - intensityAttenuationCoefficientPerPixel);
   // intensityTransmittedFractionPerPixelTwoWay: how big fraction of the intensity is transmitted during traversing through one voxel; takes into account both propagation directions
@@ -263,11 +287,6 @@ void PlusSpatialModel::CalculateIntensity(std::vector<double>& reflectedIntensit
 
   transmittedIntensity = surfaceTransmittedBeamIntensity * intensityTransmittedFractionPerPixelTwoWay;
 
-  if ((numberOfFilledPixels > 0 && this->PrecomputedAttenuations.size() < numberOfFilledPixels) || intensityTransmittedFractionPerPixelTwoWay != this->PrecomputedAttenuations[0])
-  {
-    UpdatePrecomputedAttenuations(intensityTransmittedFractionPerPixelTwoWay, numberOfFilledPixels);
-  }
-
   // We iterate until transmittedIntensity * intensityTransmittedFractionPerPixelTwoWay^n > MINIMUM_BEAM_INTENSITY
   // So, n = log(MINIMUM_BEAM_INTENSITY/transmittedIntensity) / log(intensityTransmittedFractionPerPixelTwoWay)
   unsigned int numberOfIterationsToReachMinimumBeamIntensity = 0;
@@ -276,15 +295,18 @@ void PlusSpatialModel::CalculateIntensity(std::vector<double>& reflectedIntensit
     numberOfIterationsToReachMinimumBeamIntensity =
       std::min<unsigned int>(numberOfFilledPixels,  // value may be larger than number of pixels to fill -> clamp it to the number of pixels to fill
                              static_cast<unsigned int>(std::max<int>(0,   // value may be negative when AttenuationCoefficientDbPerCmMhz is close to 0 -> clamp it to zero
-                                 floor(log(MINIMUM_BEAM_INTENSITY / transmittedIntensity) / log(intensityTransmittedFractionPerPixelTwoWay)) + 1)));
+                                 floor(log(MINIMUM_BEAM_INTENSITY / transmittedIntensity) / profile.LogIntensityTransmittedFractionPerPixelTwoWay) + 1)));
     double backScatterFactor = transmittedIntensity * intensityAttenuatedFractionPerPixel * this->BackscatterDiffuseReflectionCoefficient / intensityTransmittedFractionPerPixelTwoWay;
     for (unsigned int currentPixelInFilledPixels = 0; currentPixelInFilledPixels < numberOfIterationsToReachMinimumBeamIntensity; currentPixelInFilledPixels++)
     {
       // a fraction of the attenuation is caused by backscattering, the backscattering is sensed by the transducer
-      //reflectedIntensity[currentPixelInFilledPixels] = *(attenuation++) * backScatterFactor;
-      reflectedIntensity[currentPixelInFilledPixels] = this->PrecomputedAttenuations[currentPixelInFilledPixels] * backScatterFactor;
+      reflectedIntensity[currentPixelInFilledPixels] = profile.TransmittedFractions[currentPixelInFilledPixels] * backScatterFactor;
+    }
+    if (numberOfIterationsToReachMinimumBeamIntensity > 0)
+    {
+      // TransmittedFractions[n-1] = intensityTransmittedFractionPerPixelTwoWay^n
+      transmittedIntensity *= profile.TransmittedFractions[numberOfIterationsToReachMinimumBeamIntensity - 1];
     }
-    transmittedIntensity *= pow(intensityTransmittedFractionPerPixelTwoWay, static_cast<double>(numberOfIterationsToReachMinimumBeamIntensity));
   }
   else
   {
@@ -299,22 +321,22 @@ void PlusSpatialModel::CalculateIntensity(std::vector<double>& reflectedIntensit
   // Add surface reflection
   if (backscatteredReflectedIntensity > MINIMUM_BEAM_INTENSITY)
   {
-    double surfaceReflectionIntensityDecayPerPixel = pow(10.0, -this->SurfaceReflectionIntensityDecayDbPerMm * distanceBetweenScanlineSamplePointsMm / 10.0);
     // We iterate until backscatteredReflectedIntensity * surfaceReflectionIntensityDecayPerPixel^n > MINIMUM_BEAM_INTENSITY
     // So, n = log(MINIMUM_BEAM_INTENSITY/backscatteredReflectedIntensity) / log(surfaceReflectionIntensityDecayPerPixel)
-    int numberOfIterationsToReachMinimumBackscatteredIntensity = std::min<int>(numberOfFilledPixels, floor(log(MINIMUM_BEAM_INTENSITY / backscatteredReflectedIntensity) / log(surfaceReflectionIntensityDecayPerPixel)) + 1);
+    int numberOfIterationsToReachMinimumBackscatteredIntensity = std::min<int>(numberOfFilledPixels,
+        floor(log(MINIMUM_BEAM_INTENSITY / backscatteredReflectedIntensity) / profile.LogSurfaceReflectionIntensityDecayPerPixel) + 1);
     for (int currentPixelInFilledPixels = 0; currentPixelInFilledPixels < numberOfIterationsToReachMinimumBackscatteredIntensity; currentPixelInFilledPixels++)
     {
       // a fraction of the attenuation is caused by backscattering, the backscattering is sensed by the transducer
-      reflectedIntensity[currentPixelInFilledPixels] += backscatteredReflectedIntensity;
-      backscatteredReflectedIntensity *= surfaceReflectionIntensityDecayPerPixel;
+      reflectedIntensity[currentPixelInFilledPixels] += backscatteredReflectedIntensity * profile.SurfaceReflectionDecays[currentPixelInFilledPixels];
     }
   }
   // TODO: to simulate beamwidth, take into account the incidence angle and disperse the reflection on a larger area if the angle is large
 }
 
 //-----------------------------------------------------------------------------
-void PlusSpatialModel::GetLineIntersections(std::deque<LineIntersectionInfo>& lineIntersections, double* scanLineStartPoint_Reference, double* scanLineEndPoint_Reference)
+void PlusSpatialModel::GetLineIntersections(int numberOfLines, const double* scanLineStartPoints_Reference, const double* scanLineEndPoints_Reference,
+    std::vector<LineIntersectionInfo>* lineIntersections, LineIntersectionBuffers& buffers)
 {
   UpdateModelFile();
 
@@ -326,129 +348,227 @@ void PlusSpatialModel::GetLineIntersections(std::deque<LineIntersectionInfo>& li
     intersectionInfo.Model = this;
     intersectionInfo.IntersectionIncidenceAngleRad = 0;
     intersectionInfo.IntersectionDistanceFromStartPointMm = 0;
-    lineIntersections.push_back(intersectionInfo);
+    for (int lineIndex = 0; lineIndex < numberOfLines; lineIndex++)
+    {
+      lineIntersections[lineIndex].push_back(intersectionInfo);
+    }
     return;
   }
 
-  // non-normalized direction vector of the scanline
-  double scanLineDirectionVector_Reference[4] =
-  {
-    scanLineEndPoint_Reference[0] - scanLineStartPoint_Reference[0],
-    scanLineEndPoint_Reference[1] - scanLineStartPoint_Reference[1],
-    scanLineEndPoint_Reference[2] - scanLineStartPoint_Reference[2],
-    0
-  };
-  double scanLineDirectionVectorNorm_Reference = vtkMath::Norm(scanLineDirectionVector_Reference);
-  double searchLineStartPoint_Reference[4] = {0, 0, 0, 1};
-  for (int i = 0; i < 3; i++)
+  if (this->TriangleBvh == NULL || numberOfLines < 1)
   {
-    searchLineStartPoint_Reference[i] = scanLineStartPoint_Reference[i] - this->TransducerSpatialModelMaxOverlapMm * scanLineDirectionVector_Reference[i] / scanLineDirectionVectorNorm_Reference;
+    // the model could not be loaded or there are no lines
+    return;
   }
 
-  vtkSmartPointer<vtkMatrix4x4> objectToModelMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  vtkMatrix4x4::Invert(this->ModelToObjectTransform, objectToModelMatrix);
   vtkSmartPointer<vtkMatrix4x4> referenceToModelMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  vtkMatrix4x4::Multiply4x4(objectToModelMatrix, this->ReferenceToObjectTransform, referenceToModelMatrix);
+  GetReferenceToModelTransform(referenceToModelMatrix);
+  vtkSmartPointer<vtkMatrix4x4> modelToReferenceMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  vtkMatrix4x4::Invert(referenceToModelMatrix, modelToReferenceMatrix);
 
-  double searchLineStartPoint_Model[4] = {0, 0, 0, 1};
-  double scanLineEndPoint_Model[4] = {0, 0, 0, 1};
-  referenceToModelMatrix->MultiplyPoint(searchLineStartPoint_Reference, searchLineStartPoint_Model);
-  referenceToModelMatrix->MultiplyPoint(scanLineEndPoint_Reference, scanLineEndPoint_Model);
+  // The search line starts TransducerSpatialModelMaxOverlapMm before the scanline start point
+  buffers.SearchLineStartPoints_Model.resize(numberOfLines * 3);
+  buffers.ScanLineEndPoints_Model.resize(numberOfLines * 3);
+  if (static_cast<int>(buffers.Hits.size()) < numberOfLines)
+  {
+    buffers.Hits.resize(numberOfLines);
+  }
+  for (int lineIndex = 0; lineIndex < numberOfLines; lineIndex++)
+  {
+    const double* scanLineStartPoint_Reference = scanLineStartPoints_Reference + lineIndex * 3;
+    const double* scanLineEndPoint_Reference = scanLineEndPoints_Reference + lineIndex * 3;
+    double scanLineDirectionVector_Reference[3] =
+    {
+      scanLineEndPoint_Reference[0] - scanLineStartPoint_Reference[0],
+      scanLineEndPoint_Reference[1] - scanLineStartPoint_Reference[1],
+      scanLineEndPoint_Reference[2] - scanLineStartPoint_Reference[2]
+    };
+    double scanLineDirectionVectorNorm_Reference = vtkMath::Norm(scanLineDirectionVector_Reference);
+    double searchLineStartPoint_Reference[4] = {0, 0, 0, 1};
+    double scanLineEndPoint_Reference_Homogeneous[4] = {scanLineEndPoint_Reference[0], scanLineEndPoint_Reference[1], scanLineEndPoint_Reference[2], 1};
+    for (int i = 0; i < 3; i++)
+    {
+      searchLineStartPoint_Reference[i] = scanLineStartPoint_Reference[i] - this->TransducerSpatialModelMaxOverlapMm * scanLineDirectionVector_Reference[i] / scanLineDirectionVectorNorm_Reference;
+    }
+    double searchLineStartPoint_Model[4] = {0, 0, 0, 1};
+    double scanLineEndPoint_Model[4] = {0, 0, 0, 1};
+    referenceToModelMatrix->MultiplyPoint(searchLineStartPoint_Reference, searchLineStartPoint_Model);
+    referenceToModelMatrix->MultiplyPoint(scanLineEndPoint_Reference_Homogeneous, scanLineEndPoint_Model);
+    std::copy(searchLineStartPoint_Model, searchLineStartPoint_Model + 3, buffers.SearchLineStartPoints_Model.begin() + lineIndex * 3);
+    std::copy(scanLineEndPoint_Model, scanLineEndPoint_Model + 3, buffers.ScanLineEndPoints_Model.begin() + lineIndex * 3);
+  }
 
-  vtkSmartPointer<vtkPoints> intersectionPoints_Model = vtkSmartPointer<vtkPoints>::New();
-  vtkSmartPointer<vtkIdList> intersectionCellIds = vtkSmartPointer<vtkIdList>::New();
-  this->ModelLocalizer->IntersectWithLine(searchLineStartPoint_Model, scanLineEndPoint_Model, 0.0, intersectionPoints_Model, intersectionCellIds);
+  this->TriangleBvh->IntersectSegments(numberOfLines, &buffers.SearchLineStartPoints_Model[0], &buffers.ScanLineEndPoints_Model[0], &buffers.Hits[0]);
 
-  if (intersectionPoints_Model->GetNumberOfPoints() < 1)
+  // Get surface normals at intersection points
+  vtkDataArray* normals_Model = NULL;
+  if (this->PolyData->GetPointData())
   {
-    // no intersections with this model
-    return;
+    normals_Model = this->PolyData->GetPointData()->GetNormals();
   }
 
-  vtkSmartPointer<vtkMatrix4x4> modelToReferenceMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  vtkMatrix4x4::Invert(referenceToModelMatrix, modelToReferenceMatrix);
+  for (int lineIndex = 0; lineIndex < numberOfLines; lineIndex++)
+  {
+    const std::vector<PlusTriangleBvh::Hit>& hits = buffers.Hits[lineIndex];
+    if (hits.empty())
+    {
+      // no intersections with this model
+      continue;
+    }
 
-  // Measure the distance from the starting point in the reference coordinate system
-  double intersectionPoint_Model[4] = {0, 0, 0, 1};
-  double intersectionPoint_Reference[4] = {0, 0, 0, 1};
-  int intersectionPointIndex = 0;
-  bool scanLineStartPointInsideModel = false;
-  // Search for intersection points in the search line that are not part of the scanline to detect
-  // potential model/transducer overlap
-  for (; intersectionPointIndex < intersectionPoints_Model->GetNumberOfPoints(); intersectionPointIndex++)
-  {
-    intersectionPoints_Model->GetPoint(intersectionPointIndex, intersectionPoint_Model);
-    modelToReferenceMatrix->MultiplyPoint(intersectionPoint_Model, intersectionPoint_Reference);
-    double intersectionDistanceFromSearchLineStartPointMm = sqrt(vtkMath::Distance2BetweenPoints(searchLineStartPoint_Reference, intersectionPoint_Reference));
-    if (intersectionDistanceFromSearchLineStartPointMm <= this->TransducerSpatialModelMaxOverlapMm)
+    const double* scanLineStartPoint_Reference = scanLineStartPoints_Reference + lineIndex * 3;
+    const double* scanLineEndPoint_Reference = scanLineEndPoints_Reference + lineIndex * 3;
+    const double* searchLineStartPoint_Model = &buffers.SearchLineStartPoints_Model[lineIndex * 3];
+    const double* scanLineEndPoint_Model = &buffers.ScanLineEndPoints_Model[lineIndex * 3];
+    double scanLineDirectionVector_Reference[4] =
+    {
+      scanLineEndPoint_Reference[0] - scanLineStartPoint_Reference[0],
+      scanLineEndPoint_Reference[1] - scanLineStartPoint_Reference[1],
+      scanLineEndPoint_Reference[2] - scanLineStartPoint_Reference[2],
+      0
+    };
+    double scanLineDirectionVectorNorm_Reference = vtkMath::Norm(scanLineDirectionVector_Reference);
+    double searchLineStartPoint_Reference[3] = {0, 0, 0};
+    for (int i = 0; i < 3; i++)
     {
-      // there is an intersection point in the search line that is not part of the scanline
-      scanLineStartPointInsideModel = (!scanLineStartPointInsideModel);
+      searchLineStartPoint_Reference[i] = scanLineStartPoint_Reference[i] - this->TransducerSpatialModelMaxOverlapMm * scanLineDirectionVector_Reference[i] / scanLineDirectionVectorNorm_Reference;
     }
-    else
+
+    // Measure the distance from the starting point in the reference coordinate system
+    double intersectionPoint_Model[4] = {0, 0, 0, 1};
+    double intersectionPoint_Reference[4] = {0, 0, 0, 1};
+    unsigned int hitIndex = 0;
+    bool scanLineStartPointInsideModel = false;
+    // Search for intersection points in the search line that are not part of the scanline to detect
+    // potential model/transducer overlap
+    for (; hitIndex < hits.size(); hitIndex++)
     {
-      // we reached the scanline starting point
-      break;
+      for (int i = 0; i < 3; i++)
+      {
+        intersectionPoint_Model[i] = searchLineStartPoint_Model[i] + hits[hitIndex].Distance * (scanLineEndPoint_Model[i] - searchLineStartPoint_Model[i]);
+      }
+      modelToReferenceMatrix->MultiplyPoint(intersectionPoint_Model, intersectionPoint_Reference);
+      double intersectionDistanceFromSearchLineStartPointMm = sqrt(vtkMath::Distance2BetweenPoints(searchLineStartPoint_Reference, intersectionPoint_Reference));
+      if (intersectionDistanceFromSearchLineStartPointMm <= this->TransducerSpatialModelMaxOverlapMm)
+      {
+        // there is an intersection point in the search line that is not part of the scanline
+        scanLineStartPointInsideModel = (!scanLineStartPointInsideModel);
+      }
+      else
+      {
+        // we reached the scanline starting point
+        break;
+      }
+    }
+    LineIntersectionInfo intersectionInfo;
+    intersectionInfo.Model = this;
+    if (scanLineStartPointInsideModel)
+    {
+      // the scanline starting point is inside the model, so add an intersection point at 0 distance
+      intersectionInfo.IntersectionDistanceFromStartPointMm = 0;
+      lineIntersections[lineIndex].push_back(intersectionInfo);
+    }
+
+    double scanLineDirectionVector_Model[4] = {0, 0, 0, 0};
+    referenceToModelMatrix->MultiplyPoint(scanLineDirectionVector_Reference, scanLineDirectionVector_Model);
+    vtkMath::Normalize(scanLineDirectionVector_Model);
+
+    for (; hitIndex < hits.size(); hitIndex++)
+    {
+      const PlusTriangleBvh::Hit& hit = hits[hitIndex];
+      for (int i = 0; i < 3; i++)
+      {
+        intersectionPoint_Model[i] = searchLineStartPoint_Model[i] + hit.Distance * (scanLineEndPoint_Model[i] - searchLineStartPoint_Model[i]);
+      }
+      modelToReferenceMatrix->MultiplyPoint(intersectionPoint_Model, intersectionPoint_Reference);
+      intersectionInfo.IntersectionDistanceFromStartPointMm = sqrt(vtkMath::Distance2BetweenPoints(scanLineStartPoint_Reference, intersectionPoint_Reference));
+      if (normals_Model != NULL)
+      {
+        double interpolatedNormal_Model[3] = {0, 0, 0};
+        for (int pointIndex = 0; pointIndex < 3; pointIndex++)
+        {
+          // GetTuple3 would return a pointer to a buffer that is shared between threads
+          double normalAtCellCorner[3] = {0, 0, 0};
+          normals_Model->GetTuple(hit.PointIds[pointIndex], normalAtCellCorner);
+          interpolatedNormal_Model[0] += normalAtCellCorner[0] * hit.Weights[pointIndex];
+          interpolatedNormal_Model[1] += normalAtCellCorner[1] * hit.Weights[pointIndex];
+          interpolatedNormal_Model[2] += normalAtCellCorner[2] * hit.Weights[pointIndex];
+        }
+        vtkMath::Normalize(interpolatedNormal_Model);
+        intersectionInfo.IntersectionIncidenceAngleRad = acos(vtkMath::Dot(interpolatedNormal_Model, scanLineDirectionVector_Model));
+      }
+      else
+      {
+        LOG_ERROR("SpatialModel::GetLineIntersections error: surface normal is not available");
+        intersectionInfo.IntersectionIncidenceAngleRad = 0;
+      }
+      lineIntersections[lineIndex].push_back(intersectionInfo);
     }
   }
-  LineIntersectionInfo intersectionInfo;
-  intersectionInfo.Model = this;
-  if (scanLineStartPointInsideModel)
+}
+
+//-----------------------------------------------------------------------------
+bool PlusSpatialModel::IsIntersectingLines(int numberOfLines, const double* scanLineStartPoints_Reference, const double* scanLineEndPoints_Reference)
+{
+  if (this->ModelFile.empty())
   {
-    // the scanline starting point is inside the model, so add an intersection point at 0 distance
-    intersectionInfo.IntersectionDistanceFromStartPointMm = 0;
-    lineIntersections.push_back(intersectionInfo);
+    // the model is everywhere
+    return true;
   }
-
-  // Get surface normals at intersection points
-  vtkDataArray* normals_Model = NULL;
-  if (this->PolyData->GetPointData())
+  if (this->TriangleBvh == NULL || this->TriangleBvh->GetNodes().empty() || numberOfLines < 1)
   {
-    normals_Model = this->PolyData->GetPointData()->GetNormals();
+    // the model could not be loaded or there are no lines
+    return false;
   }
 
-  double scanLineDirectionVector_Model[4] = {0, 0, 0, 0};
-  referenceToModelMatrix->MultiplyPoint(scanLineDirectionVector_Reference, scanLineDirectionVector_Model);
-  vtkMath::Normalize(scanLineDirectionVector_Model);
+  vtkSmartPointer<vtkMatrix4x4> referenceToModelMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  GetReferenceToModelTransform(referenceToModelMatrix);
 
-  for (; intersectionPointIndex < intersectionPoints_Model->GetNumberOfPoints(); intersectionPointIndex++)
+  // Bounding box of the search lines in the Model coordinate system
+  double linesBoundsMin_Model[3] = {VTK_DOUBLE_MAX, VTK_DOUBLE_MAX, VTK_DOUBLE_MAX};
+  double linesBoundsMax_Model[3] = {VTK_DOUBLE_MIN, VTK_DOUBLE_MIN, VTK_DOUBLE_MIN};
+  for (int lineIndex = 0; lineIndex < numberOfLines; lineIndex++)
   {
-    intersectionPoints_Model->GetPoint(intersectionPointIndex, intersectionPoint_Model);
-    modelToReferenceMatrix->MultiplyPoint(intersectionPoint_Model, intersectionPoint_Reference);
-    intersectionInfo.IntersectionDistanceFromStartPointMm = sqrt(vtkMath::Distance2BetweenPoints(scanLineStartPoint_Reference, intersectionPoint_Reference));
-    vtkTriangle* cell = vtkTriangle::SafeDownCast(this->PolyData->GetCell(intersectionCellIds->GetId(intersectionPointIndex)));
-    if (cell != NULL && normals_Model != NULL)
+    const double* scanLineStartPoint_Reference = scanLineStartPoints_Reference + lineIndex * 3;
+    const double* scanLineEndPoint_Reference = scanLineEndPoints_Reference + lineIndex * 3;
+    double scanLineDirectionVector_Reference[3] =
+    {
+      scanLineEndPoint_Reference[0] - scanLineStartPoint_Reference[0],
+      scanLineEndPoint_Reference[1] - scanLineStartPoint_Reference[1],
+      scanLineEndPoint_Reference[2] - scanLineStartPoint_Reference[2]
+    };
+    double scanLineDirectionVectorNorm_Reference = vtkMath::Norm(scanLineDirectionVector_Reference);
+    double searchLineStartPoint_Reference[4] = {0, 0, 0, 1};
+    double scanLineEndPoint_Reference_Homogeneous[4] = {scanLineEndPoint_Reference[0], scanLineEndPoint_Reference[1], scanLineEndPoint_Reference[2], 1};
+    for (int i = 0; i < 3; i++)
     {
-      const int NUMBER_OF_POINTS_PER_CELL = 3; // triangle cell
-      double pcoords[NUMBER_OF_POINTS_PER_CELL] = {0, 0, 0};
-      double dist2 = 0;
-      double weights[NUMBER_OF_POINTS_PER_CELL] = {0, 0, 0};
-      double closestPoint[3] = {0, 0, 0};
-      int subId = 0;
-      cell->EvaluatePosition(intersectionPoint_Model, closestPoint, subId, pcoords, dist2, weights);
-      double interpolatedNormal_Model[3] = {0, 0, 0};
-      for (int pointIndex = 0; pointIndex < NUMBER_OF_POINTS_PER_CELL; pointIndex++)
+      searchLineStartPoint_Reference[i] = scanLineStartPoint_Reference[i];
+      if (scanLineDirectionVectorNorm_Reference > 0)
       {
-        double* normalAtCellCorner = normals_Model->GetTuple3(cell->GetPointId(pointIndex));
-        if (normalAtCellCorner == NULL)
-        {
-          LOG_ERROR("SpatialModel::GetLineIntersections error: invalid normal");
-          continue;
-        }
-        interpolatedNormal_Model[0] += normalAtCellCorner[0] * weights[pointIndex];
-        interpolatedNormal_Model[1] += normalAtCellCorner[1] * weights[pointIndex];
-        interpolatedNormal_Model[2] += normalAtCellCorner[2] * weights[pointIndex];
+        searchLineStartPoint_Reference[i] -= this->TransducerSpatialModelMaxOverlapMm * scanLineDirectionVector_Reference[i] / scanLineDirectionVectorNorm_Reference;
       }
-      vtkMath::Normalize(interpolatedNormal_Model);
-      intersectionInfo.IntersectionIncidenceAngleRad = acos(vtkMath::Dot(interpolatedNormal_Model, scanLineDirectionVector_Model));
     }
-    else
+    double searchLineStartPoint_Model[4] = {0, 0, 0, 1};
+    double scanLineEndPoint_Model[4] = {0, 0, 0, 1};
+    referenceToModelMatrix->MultiplyPoint(searchLineStartPoint_Reference, searchLineStartPoint_Model);
+    referenceToModelMatrix->MultiplyPoint(scanLineEndPoint_Reference_Homogeneous, scanLineEndPoint_Model);
+    for (int i = 0; i < 3; i++)
     {
-      LOG_ERROR("SpatialModel::GetLineIntersections error: surface normal is not available");
-      intersectionInfo.IntersectionIncidenceAngleRad = 0;
+      linesBoundsMin_Model[i] = std::min(linesBoundsMin_Model[i], std::min(searchLineStartPoint_Model[i], scanLineEndPoint_Model[i]));
+      linesBoundsMax_Model[i] = std::max(linesBoundsMax_Model[i], std::max(searchLineStartPoint_Model[i], scanLineEndPoint_Model[i]));
     }
-    lineIntersections.push_back(intersectionInfo);
   }
+
+  // The root node contains all the triangles of the surface
+  const PlusTriangleBvh::Node& rootNode = this->TriangleBvh->GetNodes()[0];
+  for (int i = 0; i < 3; i++)
+  {
+    if (linesBoundsMax_Model[i] < rootNode.BoundsMin[i] || linesBoundsMin_Model[i] > rootNode.BoundsMax[i])
+    {
+      return false;
+    }
+  }
+  return true;
 }
 
 //-----------------------------------------------------------------------------
@@ -466,6 +586,8 @@ PlusStatus PlusSpatialModel::UpdateModelFile()
     this->PolyData->Delete();
     this->PolyData = NULL;
   }
+  this->TriangleBvh.reset();
+  this->LevelsOfDetail.reset();
 
   if (this->ModelFile.empty())
   {
@@ -482,44 +604,198 @@ PlusStatus PlusSpatialModel::UpdateModelFile()
     return PLUS_FAIL;
   }
 
+  // Surfaces are immutable after loading, so models of all simulators that use the same file share one copy of the meshes and hierarchies
+  std::ostringstream sharedSurfaceKey;
+  sharedSurfaceKey << foundAbsoluteImagePath << "|" << vtksys::SystemTools::ModifiedTime(foundAbsoluteImagePath)
+                   << "|" << this->NumberOfLevelsOfDetail << "|" << this->LevelOfDetailReduction;
+  std::shared_ptr<const std::vector<LevelOfDetail> > levelsOfDetail;
+  std::shared_future<std::shared_ptr<const std::vector<LevelOfDetail> > > loadingLevelsOfDetail;
+  std::promise<std::shared_ptr<const std::vector<LevelOfDetail> > > loadedLevelsOfDetailPromise;
+  bool loadingByThisModel = false;
+  {
+    std::lock_guard<std::mutex> lock(SharedLevelsOfDetailMutex);
+    levelsOfDetail = SharedLevelsOfDetail[sharedSurfaceKey.str()].lock();
+    if (levelsOfDetail == NULL)
+    {
+      std::map<std::string, std::shared_future<std::shared_ptr<const std::vector<LevelOfDetail> > > >::iterator loadingIt = LoadingLevelsOfDetail.find(sharedSurfaceKey.str());
+      if (loadingIt != LoadingLevelsOfDetail.end())
+      {
+        loadingLevelsOfDetail = loadingIt->second;
+      }
+      else
+      {
+        loadingByThisModel = true;
+        LoadingLevelsOfDetail[sharedSurfaceKey.str()] = loadedLevelsOfDetailPromise.get_future().share();
+      }
+    }
+  }
+
+  if (loadingByThisModel)
+  {
+    // The surface is loaded without holding the lock, so that models with different surfaces are loaded concurrently
+    std::shared_ptr<std::vector<LevelOfDetail> > loadedLevelsOfDetail = std::make_shared<std::vector<LevelOfDetail> >();
+    if (LoadLevelsOfDetail(foundAbsoluteImagePath, *loadedLevelsOfDetail) == PLUS_SUCCESS)
+    {
+      levelsOfDetail = loadedLevelsOfDetail;
+    }
+    std::lock_guard<std::mutex> lock(SharedLevelsOfDetailMutex);
+    LoadingLevelsOfDetail.erase(sharedSurfaceKey.str());
+    if (levelsOfDetail != NULL)
+    {
+      SharedLevelsOfDetail[sharedSurfaceKey.str()] = levelsOfDetail;
+    }
+    // Models that wait for the surface get NULL if it failed to load
+    loadedLevelsOfDetailPromise.set_value(levelsOfDetail);
+  }
+  else if (loadingLevelsOfDetail.valid())
+  {
+    levelsOfDetail = loadingLevelsOfDetail.get();
+    LOG_DEBUG("SpatialModel " << this->Name << " shares the surface of " << foundAbsoluteImagePath << " that another model has loaded");
+  }
+  else
+  {
+    LOG_DEBUG("SpatialModel " << this->Name << " shares the already loaded surface of " << foundAbsoluteImagePath);
+  }
+  if (levelsOfDetail == NULL)
+  {
+    LOG_ERROR("SpatialModel " << this->Name << " surface could not be loaded from " << foundAbsoluteImagePath);
+    return PLUS_FAIL;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(SharedLevelsOfDetailMutex);
+    // Remove the surfaces that are not used by any model anymore
+    for (std::map<std::string, std::weak_ptr<const std::vector<LevelOfDetail> > >::iterator it = SharedLevelsOfDetail.begin(); it != SharedLevelsOfDetail.end();)
+    {
+      if (it->second.expired())
+      {
+        it = SharedLevelsOfDetail.erase(it);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+  }
+
+  this->LevelsOfDetail = levelsOfDetail;
+  SetPolyData(levelsOfDetail->front().PolyData);
+  this->TriangleBvh = levelsOfDetail->front().TriangleBvh;
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus PlusSpatialModel::LoadLevelsOfDetail(const std::string& absoluteModelPath, std::vector<LevelOfDetail>& levelsOfDetail) const
+{
   vtkSmartPointer<vtkPolyData> polyData;
 
-  std::string fileExt = vtksys::SystemTools::GetFilenameLastExtension(foundAbsoluteImagePath);
+  std::string fileExt = vtksys::SystemTools::GetFilenameLastExtension(absoluteModelPath);
   if (igsioCommon::IsEqualInsensitive(fileExt, ".stl"))
   {
     vtkSmartPointer<vtkSTLReader> modelReader = vtkSmartPointer<vtkSTLReader>::New();
-    modelReader->SetFileName(foundAbsoluteImagePath.c_str());
+    modelReader->SetFileName(absoluteModelPath.c_str());
     modelReader->Update();
     polyData = modelReader->GetOutput();
   }
   else //if (igsioCommon::IsEqualInsensitive(fileExt.c_str(),".vtp"))
   {
     vtkSmartPointer<vtkXMLPolyDataReader> modelReader = vtkSmartPointer<vtkXMLPolyDataReader>::New();
-    modelReader->SetFileName(foundAbsoluteImagePath.c_str());
+    modelReader->SetFileName(absoluteModelPath.c_str());
     modelReader->Update();
     polyData = modelReader->GetOutput();
   }
 
   if (polyData.GetPointer() == NULL || polyData->GetNumberOfPoints() == 0)
   {
-    LOG_ERROR("Model specified cannot be found: " << foundAbsoluteImagePath);
+    LOG_ERROR("Model specified cannot be found: " << absoluteModelPath);
     return PLUS_FAIL;
   }
 
   vtkSmartPointer<vtkPolyDataNormals> polyDataNormalsComputer = vtkSmartPointer<vtkPolyDataNormals>::New();
   polyDataNormalsComputer->SetInputData(polyData);
   polyDataNormalsComputer->Update();
-  this->PolyData = polyDataNormalsComputer->GetOutput();
-  this->PolyData->Register(NULL);
 
-  this->ModelLocalizer->SetDataSet(this->PolyData);
-  this->ModelLocalizer->SetMaxLevel(24);
-  this->ModelLocalizer->SetNumberOfCellsPerNode(32);
-  this->ModelLocalizer->BuildLocator();
+  LevelOfDetail fullDetail;
+  fullDetail.PolyData = polyDataNormalsComputer->GetOutput();
+  fullDetail.TriangleBvh = std::make_shared<PlusTriangleBvh>();
+  if (fullDetail.TriangleBvh->Build(fullDetail.PolyData) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to build the intersection search hierarchy of model " << absoluteModelPath);
+    return PLUS_FAIL;
+  }
+  fullDetail.MeanEdgeLengthMm = GetMeanEdgeLength(*fullDetail.TriangleBvh);
+  levelsOfDetail.push_back(fullDetail);
+  CreateLevelsOfDetail(levelsOfDetail);
 
   return PLUS_SUCCESS;
 }
 
+//-----------------------------------------------------------------------------
+void PlusSpatialModel::CreateLevelsOfDetail(std::vector<LevelOfDetail>& levelsOfDetail) const
+{
+  while (!levelsOfDetail.empty() && static_cast<int>(levelsOfDetail.size()) < this->NumberOfLevelsOfDetail)
+  {
+    // Copied, as the vector may be reallocated when the new level is added
+    const LevelOfDetail previousLevel = levelsOfDetail.back();
+    if (previousLevel.TriangleBvh->GetNumberOfTriangles() < MINIMUM_NUMBER_OF_TRIANGLES_IN_LEVEL_OF_DETAIL)
+    {
+      LOG_DEBUG("Surface of SpatialModel " << this->Name << " is not decimated further, it has only " << previousLevel.TriangleBvh->GetNumberOfTriangles() << " triangles");
+      break;
+    }
+
+    // The topology is preserved, so that the decimated surface remains closed and the inside/outside segments of the scanlines are not inverted
+    vtkSmartPointer<vtkDecimatePro> decimator = vtkSmartPointer<vtkDecimatePro>::New();
+    decimator->SetInputData(previousLevel.PolyData);
+    decimator->SetTargetReduction(this->LevelOfDetailReduction);
+    decimator->PreserveTopologyOn();
+    decimator->SplittingOff();
+    decimator->BoundaryVertexDeletionOff();
+    vtkSmartPointer<vtkPolyDataNormals> polyDataNormalsComputer = vtkSmartPointer<vtkPolyDataNormals>::New();
+    polyDataNormalsComputer->SetInputConnection(decimator->GetOutputPort());
+    polyDataNormalsComputer->Update();
+
+    LevelOfDetail level;
+    level.PolyData = polyDataNormalsComputer->GetOutput();
+    level.TriangleBvh = std::make_shared<PlusTriangleBvh>();
+    if (level.TriangleBvh->Build(level.PolyData) != PLUS_SUCCESS)
+    {
+      LOG_WARNING("Failed to build the intersection search hierarchy of level of detail " << levelsOfDetail.size() << " of SpatialModel " << this->Name);
+      break;
+    }
+    if (level.TriangleBvh->GetNumberOfTriangles() >= previousLevel.TriangleBvh->GetNumberOfTriangles())
+    {
+      // The surface cannot be decimated any further
+      break;
+    }
+    level.MeanEdgeLengthMm = GetMeanEdgeLength(*level.TriangleBvh);
+    LOG_DEBUG("Level of detail " << levelsOfDetail.size() << " of SpatialModel " << this->Name << ": " << level.TriangleBvh->GetNumberOfTriangles()
+              << " triangles, mean edge length " << level.MeanEdgeLengthMm << "mm");
+    levelsOfDetail.push_back(level);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void PlusSpatialModel::SelectLevelOfDetail(double imageResolutionMm)
+{
+  if (this->LevelsOfDetail == NULL || this->LevelsOfDetail->empty())
+  {
+    return;
+  }
+  const std::vector<LevelOfDetail>& levelsOfDetail = *this->LevelsOfDetail;
+  unsigned int selectedLevel = 0;
+  while (selectedLevel + 1 < levelsOfDetail.size() && levelsOfDetail[selectedLevel + 1].MeanEdgeLengthMm <= imageResolutionMm)
+  {
+    selectedLevel++;
+  }
+  if (this->TriangleBvh != levelsOfDetail[selectedLevel].TriangleBvh)
+  {
+    LOG_DEBUG("SpatialModel " << this->Name << " uses level of detail " << selectedLevel << " at " << imageResolutionMm << "mm image resolution");
+    SetPolyData(levelsOfDetail[selectedLevel].PolyData);
+    this->TriangleBvh = levelsOfDetail[selectedLevel].TriangleBvh;
+  }
+}
+
 //-----------------------------------------------------------------------------
 void PlusSpatialModel::SetModelFile(const std::string& modelFile)
 {
@@ -531,14 +807,107 @@ void PlusSpatialModel::SetModelFile(const std::string& modelFile)
 }
 
 //-----------------------------------------------------------------------------
-void PlusSpatialModel::UpdatePrecomputedAttenuations(double intensityTransmittedFractionPerPixelTwoWay, int numberOfElements)
+void PlusSpatialModel::PrepareForSimulation(unsigned int maximumNumberOfFilledPixels, double distanceBetweenScanlineSamplePointsMm, double imageResolutionMm)
+{
+  UpdateModelFile();
+  SelectLevelOfDetail(imageResolutionMm);
+
+  if (!IsAttenuationProfileUpToDate(maximumNumberOfFilledPixels, distanceBetweenScanlineSamplePointsMm))
+  {
+    UpdateAttenuationProfile(maximumNumberOfFilledPixels, distanceBetweenScanlineSamplePointsMm);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void PlusSpatialModel::GetIntensityParameters(double distanceBetweenScanlineSamplePointsMm, IntensityParameters& parameters)
+{
+  parameters.AcousticImpedanceMegarayls = GetAcousticImpedanceMegarayls();
+  parameters.IntensityAttenuationCoefficientPerPixel = GetIntensityAttenuationCoefficientPerPixel(distanceBetweenScanlineSamplePointsMm);
+  parameters.BackscatterDiffuseReflectionCoefficient = this->BackscatterDiffuseReflectionCoefficient;
+  parameters.SurfaceDiffuseReflectionCoefficient = this->SurfaceDiffuseReflectionCoefficient;
+  parameters.SurfaceSpecularReflectionCoefficient = this->SurfaceSpecularReflectionCoefficient;
+  parameters.SurfaceReflectionIntensityDecayPerPixel = pow(10.0, -this->SurfaceReflectionIntensityDecayDbPerMm * distanceBetweenScanlineSamplePointsMm / 10.0);
+}
+
+//-----------------------------------------------------------------------------
+bool PlusSpatialModel::IsBackground() const
+{
+  return this->ModelFile.empty();
+}
+
+//-----------------------------------------------------------------------------
+std::shared_ptr<const PlusTriangleBvh> PlusSpatialModel::GetTriangleBvh() const
+{
+  return this->TriangleBvh;
+}
+
+//-----------------------------------------------------------------------------
+vtkDataArray* PlusSpatialModel::GetSurfaceNormals() const
+{
+  if (this->PolyData == NULL || this->PolyData->GetPointData() == NULL)
+  {
+    return NULL;
+  }
+  return this->PolyData->GetPointData()->GetNormals();
+}
+
+//-----------------------------------------------------------------------------
+void PlusSpatialModel::GetReferenceToModelTransform(vtkMatrix4x4* referenceToModelTransform)
+{
+  vtkSmartPointer<vtkMatrix4x4> objectToModelMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  vtkMatrix4x4::Invert(this->ModelToObjectTransform, objectToModelMatrix);
+  vtkMatrix4x4::Multiply4x4(objectToModelMatrix, this->ReferenceToObjectTransform, referenceToModelTransform);
+}
+
+//-----------------------------------------------------------------------------
+double PlusSpatialModel::GetTransducerSpatialModelMaxOverlapMm() const
+{
+  return this->TransducerSpatialModelMaxOverlapMm;
+}
+
+//-----------------------------------------------------------------------------
+double PlusSpatialModel::GetIntensityAttenuationCoefficientPerPixel(double distanceBetweenScanlineSamplePointsMm)
+{
+  double intensityAttenuationCoefficientdBPerPixel = this->AttenuationCoefficientDbPerCmMhz * (distanceBetweenScanlineSamplePointsMm / 10.0) * this->ImagingFrequencyMhz;
+  return pow(10.0, -intensityAttenuationCoefficientdBPerPixel / 10.0);
+}
+
+//-----------------------------------------------------------------------------
+bool PlusSpatialModel::IsAttenuationProfileUpToDate(unsigned int numberOfPixels, double distanceBetweenScanlineSamplePointsMm) const
+{
+  const AttenuationProfile& profile = this->PrecomputedAttenuationProfile;
+  return profile.TransmittedFractions.size() >= numberOfPixels
+         && profile.DistanceBetweenScanlineSamplePointsMm == distanceBetweenScanlineSamplePointsMm
+         && profile.ImagingFrequencyMhz == this->ImagingFrequencyMhz
+         && profile.AttenuationCoefficientDbPerCmMhz == this->AttenuationCoefficientDbPerCmMhz
+         && profile.SurfaceReflectionIntensityDecayDbPerMm == this->SurfaceReflectionIntensityDecayDbPerMm;
+}
+
+//-----------------------------------------------------------------------------
+void PlusSpatialModel::UpdateAttenuationProfile(unsigned int numberOfPixels, double distanceBetweenScanlineSamplePointsMm)
 {
-  this->PrecomputedAttenuations.resize(numberOfElements);
+  AttenuationProfile& profile = this->PrecomputedAttenuationProfile;
+  profile.DistanceBetweenScanlineSamplePointsMm = distanceBetweenScanlineSamplePointsMm;
+  profile.ImagingFrequencyMhz = this->ImagingFrequencyMhz;
+  profile.AttenuationCoefficientDbPerCmMhz = this->AttenuationCoefficientDbPerCmMhz;
+  profile.SurfaceReflectionIntensityDecayDbPerMm = this->SurfaceReflectionIntensityDecayDbPerMm;
+
+  profile.IntensityAttenuationCoefficientPerPixel = GetIntensityAttenuationCoefficientPerPixel(distanceBetweenScanlineSamplePointsMm);
+  double intensityTransmittedFractionPerPixelTwoWay = profile.IntensityAttenuationCoefficientPerPixel * profile.IntensityAttenuationCoefficientPerPixel;
+  profile.LogIntensityTransmittedFractionPerPixelTwoWay = log(intensityTransmittedFractionPerPixelTwoWay);
+  profile.SurfaceReflectionIntensityDecayPerPixel = pow(10.0, -this->SurfaceReflectionIntensityDecayDbPerMm * distanceBetweenScanlineSamplePointsMm / 10.0);
+  profile.LogSurfaceReflectionIntensityDecayPerPixel = log(profile.SurfaceReflectionIntensityDecayPerPixel);
+
+  profile.TransmittedFractions.resize(numberOfPixels);
+  profile.SurfaceReflectionDecays.resize(numberOfPixels);
   double attenuation = intensityTransmittedFractionPerPixelTwoWay;
-  for (int i = 0; i < numberOfElements; i++)
+  double surfaceReflectionDecay = 1.0;
+  for (unsigned int i = 0; i < numberOfPixels; i++)
   {
-    this->PrecomputedAttenuations[i] = attenuation;
+    profile.TransmittedFractions[i] = attenuation;
     attenuation *= intensityTransmittedFractionPerPixelTwoWay;
+    profile.SurfaceReflectionDecays[i] = surfaceReflectionDecay;
+    surfaceReflectionDecay *= profile.SurfaceReflectionIntensityDecayPerPixel;
   }
 }
 
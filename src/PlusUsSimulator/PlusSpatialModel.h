@@ -6,13 +6,21 @@
 #ifndef __SpatialModel_h
 #define __SpatialModel_h
 
-#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include "vtkPlusUsSimulatorExport.h"
 
+#include "PlusTriangleBvh.h"
+
+#include "vtkSmartPointer.h"
+
+class vtkDataArray;
 class vtkMatrix4x4;
-class vtkModifiedBSPTree;
 class vtkPolyData;
 
 /*!
@@ -38,6 +46,27 @@ public:
     double IntersectionIncidenceAngleRad;
   };
 
+  /*! Work buffers of GetLineIntersections. Each calling thread has its own, so that they are not reallocated for each call. */
+  struct LineIntersectionBuffers
+  {
+    std::vector<double> SearchLineStartPoints_Model;
+    std::vector<double> ScanLineEndPoints_Model;
+    std::vector< std::vector<PlusTriangleBvh::Hit> > Hits;
+  };
+
+  /*! Material parameters of CalculateIntensity at a given sample spacing, e.g., for computing the intensities on a GPU */
+  struct IntensityParameters
+  {
+    double AcousticImpedanceMegarayls;
+    /*! Ratio of the transmitted and incident beam intensity after traversing through a single pixel */
+    double IntensityAttenuationCoefficientPerPixel;
+    double BackscatterDiffuseReflectionCoefficient;
+    double SurfaceDiffuseReflectionCoefficient;
+    double SurfaceSpecularReflectionCoefficient;
+    /*! Decay of the surface reflection intensity in a single pixel */
+    double SurfaceReflectionIntensityDecayPerPixel;
+  };
+
   PlusSpatialModel();
   virtual ~PlusSpatialModel();
 
@@ -65,15 +94,54 @@ public:
   void SetReferenceToObjectTransform(vtkMatrix4x4* referenceToObjectTransform);
 
   /*!
-    Get all the intersection points of the model and a line. Input and output points are all in Model coordinate system.
-    The results are appended to the lineIntersections structure.
-    If the line starts inside the model then the first intersection position is 0.
+    Get all the intersection points of the model and a batch of lines. Input points are in the Reference coordinate system.
+    The results of line i are appended to lineIntersections[i].
+    If a line starts inside the model then its first intersection position is 0.
     The unit of the reference coordinate system must be in mm.
+    Neighboring scanlines should be passed in one call, as they are intersected with the surface together.
+    \param scanLineStartPoints_Reference Line start points, 3 coordinates for each line
+    \param scanLineEndPoints_Reference Line end points, 3 coordinates for each line
+    \param buffers Work buffers that are owned by the calling thread
+  */
+  void GetLineIntersections(int numberOfLines, const double* scanLineStartPoints_Reference, const double* scanLineEndPoints_Reference,
+                            std::vector<LineIntersectionInfo>* lineIntersections, LineIntersectionBuffers& buffers);
+
+  /*!
+    Returns false if none of the lines can intersect the model, because the bounding box of the lines (extended by
+    TransducerSpatialModelMaxOverlapMm before the start points, as in GetLineIntersections) does not overlap the bounding box
+    of the model in the Model coordinate system. Background models intersect all lines.
+    The model must be prepared for the simulation (PrepareForSimulation).
+  */
+  bool IsIntersectingLines(int numberOfLines, const double* scanLineStartPoints_Reference, const double* scanLineEndPoints_Reference);
+
+  /*!
+    Load the model file and precompute the attenuation profile of the material (for the current imaging frequency and the
+    sample spacing) for scanline segments of up to maximumNumberOfFilledPixels pixels. The profile is only recomputed
+    if the frequency, the spacing, or the attenuation parameters have changed.
+    The coarsest level of detail of the surface whose mean edge length is not larger than imageResolutionMm is selected.
+    After this GetLineIntersections and CalculateIntensity do not modify the model, so they can be called from multiple threads.
   */
-  void GetLineIntersections(std::deque<LineIntersectionInfo>& lineIntersections, double* scanLineStartPoint_Reference, double* scanLineEndPoint_Reference);
+  void PrepareForSimulation(unsigned int maximumNumberOfFilledPixels, double distanceBetweenScanlineSamplePointsMm, double imageResolutionMm);
 
   double GetAcousticImpedanceMegarayls();
 
+  /*! Get the parameters that CalculateIntensity uses */
+  void GetIntensityParameters(double distanceBetweenScanlineSamplePointsMm, IntensityParameters& parameters);
+
+  /*! Returns true if no model file is defined, which means that the model is everywhere (background material) */
+  bool IsBackground() const;
+
+  /*! Hierarchy of the surface triangles, in the Model coordinate system. NULL if the model is not loaded. */
+  std::shared_ptr<const PlusTriangleBvh> GetTriangleBvh() const;
+
+  /*! Surface normals at the points of the mesh, in the Model coordinate system. NULL if not available. */
+  vtkDataArray* GetSurfaceNormals() const;
+
+  /*! Compute the transform from the Reference to the Model coordinate system */
+  void GetReferenceToModelTransform(vtkMatrix4x4* referenceToModelTransform);
+
+  double GetTransducerSpatialModelMaxOverlapMm() const;
+
   /*!
     Computes relative intensities inside the model
     \param incidentIntensity Dimensionless value, if there is 100% reflection at the surface then this
@@ -91,15 +159,76 @@ public:
   SetMacro(SurfaceDiffuseReflectionCoefficient, double);
   SetMacro(SurfaceSpecularReflectionCoefficient, double);
   SetMacro(TransducerSpatialModelMaxOverlapMm, double);
+  SetMacro(NumberOfLevelsOfDetail, int);
+  SetMacro(LevelOfDetailReduction, double);
+
+  /*!
+    Load the model file if it has changed. Called before simulation, but it can be called in advance, so that the
+    file is not loaded when the first image is simulated. Different models can be loaded concurrently.
+  */
+  PlusStatus UpdateModelFile();
 
 protected:
   void SetPolyData(vtkPolyData* polyData);
-  void SetModelLocalizer(vtkModifiedBSPTree* modelLocalizer);
   void SetModelToObjectTransform(vtkMatrix4x4* modelToObjectTransform);
   void SetModelToObjectTransform(double* matrixElements);
 
-  PlusStatus UpdateModelFile();
-  void UpdatePrecomputedAttenuations(double intensityTransmittedFractionPerPixelTwoWay, int numberOfElements);
+  /*! Surface mesh at one level of detail */
+  struct LevelOfDetail
+  {
+    LevelOfDetail() : MeanEdgeLengthMm(0.0) {}
+    /*! Surface mesh with point normals, in the Model coordinate system */
+    vtkSmartPointer<vtkPolyData> PolyData;
+    std::shared_ptr<PlusTriangleBvh> TriangleBvh;
+    /*! Average length of the triangle edges */
+    double MeanEdgeLengthMm;
+  };
+
+  /*!
+    Read the surface file, compute the normals, build the triangle hierarchies and create the levels of detail.
+    The result is not modified afterwards, so it can be shared by all models that use the same file and level of detail settings.
+  */
+  PlusStatus LoadLevelsOfDetail(const std::string& absoluteModelPath, std::vector<LevelOfDetail>& levelsOfDetail) const;
+
+  /*! Decimate the surface to create the coarser levels of detail */
+  void CreateLevelsOfDetail(std::vector<LevelOfDetail>& levelsOfDetail) const;
+
+  /*! Use the coarsest level of detail whose mean edge length is not larger than imageResolutionMm */
+  void SelectLevelOfDetail(double imageResolutionMm);
+
+  /*! Returns true if the attenuation profile is computed for the current parameters and for at least numberOfPixels pixels */
+  bool IsAttenuationProfileUpToDate(unsigned int numberOfPixels, double distanceBetweenScanlineSamplePointsMm) const;
+
+  /*! Compute the attenuation profile for the current parameters */
+  void UpdateAttenuationProfile(unsigned int numberOfPixels, double distanceBetweenScanlineSamplePointsMm);
+
+  /*! Ratio of the transmitted and incident beam intensity after traversing through a single pixel */
+  double GetIntensityAttenuationCoefficientPerPixel(double distanceBetweenScanlineSamplePointsMm);
+
+  /*! Attenuation lookup tables of the material, for a given imaging frequency and sample spacing */
+  struct AttenuationProfile
+  {
+    AttenuationProfile()
+      : DistanceBetweenScanlineSamplePointsMm(-1.0), ImagingFrequencyMhz(-1.0), AttenuationCoefficientDbPerCmMhz(-1.0), SurfaceReflectionIntensityDecayDbPerMm(-1.0)
+      , IntensityAttenuationCoefficientPerPixel(1.0), LogIntensityTransmittedFractionPerPixelTwoWay(0.0)
+      , SurfaceReflectionIntensityDecayPerPixel(1.0), LogSurfaceReflectionIntensityDecayPerPixel(0.0) {}
+    /*! Parameters that the profile is computed for */
+    double DistanceBetweenScanlineSamplePointsMm;
+    double ImagingFrequencyMhz;
+    double AttenuationCoefficientDbPerCmMhz;
+    double SurfaceReflectionIntensityDecayDbPerMm;
+    /*! Ratio of the transmitted and incident beam intensity after traversing through a single pixel */
+    double IntensityAttenuationCoefficientPerPixel;
+    /*! Logarithm of intensityTransmittedFractionPerPixelTwoWay (square of IntensityAttenuationCoefficientPerPixel) */
+    double LogIntensityTransmittedFractionPerPixelTwoWay;
+    /*! Decay of the surface reflection intensity in a single pixel */
+    double SurfaceReflectionIntensityDecayPerPixel;
+    double LogSurfaceReflectionIntensityDecayPerPixel;
+    /*! List of attenuations: intensityTransmittedFractionPerPixelTwoWay, intensityTransmittedFractionPerPixelTwoWay^2, intensityTransmittedFractionPerPixelTwoWay^3, ... */
+    std::vector<double> TransmittedFractions;
+    /*! List of surface reflection decays: 1, SurfaceReflectionIntensityDecayPerPixel, SurfaceReflectionIntensityDecayPerPixel^2, ... */
+    std::vector<double> SurfaceReflectionDecays;
+  };
 
 protected:
   //PlusStatus LoadModel(const std::string& absoluteImagePath);
@@ -184,13 +313,40 @@ protected:
   */
   double SurfaceDiffuseReflectionCoefficient;
 
-  vtkModifiedBSPTree* ModelLocalizer;
+  /*!
+    Number of levels of detail of the surface, including the full resolution mesh. Each level is decimated from the previous one
+    by LevelOfDetailReduction. Coarser levels are used if the image resolution is low (e.g., large imaging depth), so that
+    fewer triangles are intersected.
+  */
+  int NumberOfLevelsOfDetail;
+
+  /*! Fraction of the triangles that are removed from a level of detail to create the next one (range: 0.0-1.0) */
+  double LevelOfDetailReduction;
+
+  /*!
+    Levels of detail of the surface, from the full resolution mesh to the coarsest mesh. NULL if the model is not loaded.
+    Shared by shallow copies and by all models (e.g., of multiple simulated probes) that load the same file with the same level of detail settings.
+  */
+  std::shared_ptr<const std::vector<LevelOfDetail> > LevelsOfDetail;
+
+  /*!
+    Surfaces that are currently used by any model, by file path, modification time and level of detail settings.
+    A surface is removed when the last model that uses it is deleted or loads another file.
+  */
+  static std::map<std::string, std::weak_ptr<const std::vector<LevelOfDetail> > > SharedLevelsOfDetail;
+  /*! Surfaces that are being loaded, so that models that use the same surface wait for it instead of loading it again */
+  static std::map<std::string, std::shared_future<std::shared_ptr<const std::vector<LevelOfDetail> > > > LoadingLevelsOfDetail;
+  /*! Protects SharedLevelsOfDetail and LoadingLevelsOfDetail, not held while a surface is loaded */
+  static std::mutex SharedLevelsOfDetailMutex;
+
+  /*! Hierarchy of the triangles of PolyData for the line intersection computation. Shared by shallow copies. */
+  std::shared_ptr<PlusTriangleBvh> TriangleBvh;
 
-  /*! Surface mesh. Points are stored in the Model coordinate system (as in the input file) */
+  /*! Surface mesh of the selected level of detail. Points are stored in the Model coordinate system (as in the input file) */
   vtkPolyData* PolyData;
 
-  /*! List of attenuations: intensityTransmittedFractionPerPixelTwoWay, intensityTransmittedFractionPerPixelTwoWay^2, intensityTransmittedFractionPerPixelTwoWay^3, ... */
-  std::vector<double> PrecomputedAttenuations;
+  /*! Attenuation profile of the material, so that no transcendental functions are evaluated for the pixels of the scanlines */
+  AttenuationProfile PrecomputedAttenuationProfile;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,382 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+
+#include "PlusTriangleBvh.h"
+
+#include "vtkCellArray.h"
+#include "vtkIdList.h"
+#include "vtkPoints.h"
+#include "vtkPolyData.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  // SSE2 is available on all 64-bit x86 processors
+  #define PLUS_TRIANGLEBVH_SSE2
+  #include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+  // NEON is always available on 64-bit ARM
+  #define PLUS_TRIANGLEBVH_NEON
+  #include <arm_neon.h>
+#endif
+
+namespace
+{
+  /*! Leaves contain at most this many triangles */
+  const int MAXIMUM_NUMBER_OF_TRIANGLES_PER_LEAF = 4;
+
+  /*! The median split halves the triangles at each level, so this depth is only reached with more than 2^60 triangles */
+  const int MAXIMUM_DEPTH = 64;
+
+  /*! Segments are extended by this fraction at both ends in the bounding box test, to compensate the single precision rounding */
+  const float BOX_TEST_SEGMENT_TOLERANCE = 1e-4f;
+
+  //-----------------------------------------------------------------------------
+  /*! Round a bounding box outwards to single precision, with a margin for the rounding of the segments in the box test */
+  void RoundBoundsOutwards(const double boundsMin[3], const double boundsMax[3], float roundedMin[3], float roundedMax[3])
+  {
+    for (int axis = 0; axis < 3; axis++)
+    {
+      double margin = 1e-5 * std::max(std::max(std::fabs(boundsMin[axis]), std::fabs(boundsMax[axis])), 1.0);
+      roundedMin[axis] = static_cast<float>(boundsMin[axis] - margin);
+      roundedMax[axis] = static_cast<float>(boundsMax[axis] + margin);
+    }
+  }
+
+  //-----------------------------------------------------------------------------
+  /*! Segments of a packet in structure of arrays layout, for testing bounding boxes in single precision */
+  struct SegmentPacket
+  {
+    float Origin[3][PlusTriangleBvh::PACKET_SIZE];
+    float InverseDirection[3][PlusTriangleBvh::PACKET_SIZE];
+  };
+
+  //-----------------------------------------------------------------------------
+  /*! Returns a bit mask of the segments of the packet that intersect the box (bit i is set if segment i intersects it) */
+  int IntersectBox(const float boundsMin[3], const float boundsMax[3], const SegmentPacket& packet)
+  {
+#if defined(PLUS_TRIANGLEBVH_SSE2)
+    __m128 nearDistance = _mm_set1_ps(-BOX_TEST_SEGMENT_TOLERANCE);
+    __m128 farDistance = _mm_set1_ps(1.0f + BOX_TEST_SEGMENT_TOLERANCE);
+    for (int axis = 0; axis < 3; axis++)
+    {
+      __m128 origin = _mm_loadu_ps(packet.Origin[axis]);
+      __m128 inverseDirection = _mm_loadu_ps(packet.InverseDirection[axis]);
+      __m128 distance1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(boundsMin[axis]), origin), inverseDirection);
+      __m128 distance2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(boundsMax[axis]), origin), inverseDirection);
+      nearDistance = _mm_max_ps(nearDistance, _mm_min_ps(distance1, distance2));
+      farDistance = _mm_min_ps(farDistance, _mm_max_ps(distance1, distance2));
+    }
+    return _mm_movemask_ps(_mm_cmple_ps(nearDistance, farDistance));
+#elif defined(PLUS_TRIANGLEBVH_NEON)
+    float32x4_t nearDistance = vdupq_n_f32(-BOX_TEST_SEGMENT_TOLERANCE);
+    float32x4_t farDistance = vdupq_n_f32(1.0f + BOX_TEST_SEGMENT_TOLERANCE);
+    for (int axis = 0; axis < 3; axis++)
+    {
+      float32x4_t origin = vld1q_f32(packet.Origin[axis]);
+      float32x4_t inverseDirection = vld1q_f32(packet.InverseDirection[axis]);
+      float32x4_t distance1 = vmulq_f32(vsubq_f32(vdupq_n_f32(boundsMin[axis]), origin), inverseDirection);
+      float32x4_t distance2 = vmulq_f32(vsubq_f32(vdupq_n_f32(boundsMax[axis]), origin), inverseDirection);
+      nearDistance = vmaxq_f32(nearDistance, vminq_f32(distance1, distance2));
+      farDistance = vminq_f32(farDistance, vmaxq_f32(distance1, distance2));
+    }
+    uint32x4_t inside = vcleq_f32(nearDistance, farDistance);
+    return (vgetq_lane_u32(inside, 0) & 1) | ((vgetq_lane_u32(inside, 1) & 1) << 1) | ((vgetq_lane_u32(inside, 2) & 1) << 2) | ((vgetq_lane_u32(inside, 3) & 1) << 3);
+#else
+    int mask = 0;
+    for (int lane = 0; lane < PlusTriangleBvh::PACKET_SIZE; lane++)
+    {
+      float nearDistance = -BOX_TEST_SEGMENT_TOLERANCE;
+      float farDistance = 1.0f + BOX_TEST_SEGMENT_TOLERANCE;
+      for (int axis = 0; axis < 3; axis++)
+      {
+        float distance1 = (boundsMin[axis] - packet.Origin[axis][lane]) * packet.InverseDirection[axis][lane];
+        float distance2 = (boundsMax[axis] - packet.Origin[axis][lane]) * packet.InverseDirection[axis][lane];
+        nearDistance = std::max(nearDistance, std::min(distance1, distance2));
+        farDistance = std::min(farDistance, std::max(distance1, distance2));
+      }
+      if (nearDistance <= farDistance)
+      {
+        mask |= (1 << lane);
+      }
+    }
+    return mask;
+#endif
+  }
+
+  //-----------------------------------------------------------------------------
+  bool HitDistanceLessThan(const PlusTriangleBvh::Hit& a, const PlusTriangleBvh::Hit& b)
+  {
+    return a.Distance < b.Distance;
+  }
+}
+
+//-----------------------------------------------------------------------------
+PlusTriangleBvh::PlusTriangleBvh()
+  : Depth(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+PlusTriangleBvh::~PlusTriangleBvh()
+{
+}
+
+//-----------------------------------------------------------------------------
+void PlusTriangleBvh::Clear()
+{
+  this->Triangles.clear();
+  this->Nodes.clear();
+  this->Depth = 0;
+}
+
+//-----------------------------------------------------------------------------
+int PlusTriangleBvh::GetNumberOfTriangles() const
+{
+  return static_cast<int>(this->Triangles.size());
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus PlusTriangleBvh::Build(vtkPolyData* polyData)
+{
+  Clear();
+  if (polyData == NULL || polyData->GetPoints() == NULL)
+  {
+    LOG_ERROR("PlusTriangleBvh::Build failed: no mesh is specified");
+    return PLUS_FAIL;
+  }
+  vtkPoints* points = polyData->GetPoints();
+
+  vtkSmartPointer<vtkIdList> cellPointIds = vtkSmartPointer<vtkIdList>::New();
+  for (int cellType = 0; cellType < 2; cellType++)
+  {
+    bool isStrip = (cellType == 1);
+    vtkCellArray* cells = isStrip ? polyData->GetStrips() : polyData->GetPolys();
+    if (cells == NULL)
+    {
+      continue;
+    }
+    cells->InitTraversal();
+    while (cells->GetNextCell(cellPointIds))
+    {
+      for (vtkIdType i = 2; i < cellPointIds->GetNumberOfIds(); i++)
+      {
+        // Polygons are split as a fan from the first point, strips to consecutive triples of points
+        vtkIdType pointIds[3] = { isStrip ? cellPointIds->GetId(i - 2) : cellPointIds->GetId(0), cellPointIds->GetId(i - 1), cellPointIds->GetId(i) };
+        Triangle triangle;
+        double vertex1[3] = {0, 0, 0};
+        double vertex2[3] = {0, 0, 0};
+        points->GetPoint(pointIds[0], triangle.Vertex0);
+        points->GetPoint(pointIds[1], vertex1);
+        points->GetPoint(pointIds[2], vertex2);
+        for (int axis = 0; axis < 3; axis++)
+        {
+          triangle.Edge1[axis] = vertex1[axis] - triangle.Vertex0[axis];
+          triangle.Edge2[axis] = vertex2[axis] - triangle.Vertex0[axis];
+          triangle.PointIds[axis] = pointIds[axis];
+        }
+        this->Triangles.push_back(triangle);
+      }
+    }
+  }
+
+  if (this->Triangles.empty())
+  {
+    LOG_ERROR("PlusTriangleBvh::Build failed: the mesh does not contain any triangles");
+    return PLUS_FAIL;
+  }
+
+  // A binary tree with leaves of at least one triangle has less than 2 * (number of triangles) nodes
+  this->Nodes.reserve(2 * this->Triangles.size());
+  this->Nodes.resize(1);
+  this->Depth = BuildNode(0, 0, static_cast<int>(this->Triangles.size()), 0);
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+int PlusTriangleBvh::BuildNode(int nodeIndex, int firstTriangle, int numberOfTriangles, int depth)
+{
+  double boundsMin[3] = { std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+  double boundsMax[3] = { -std::numeric_limits<double>::max(), -std::numeric_limits<double>::max(), -std::numeric_limits<double>::max() };
+  double centroidMin[3] = { boundsMin[0], boundsMin[1], boundsMin[2] };
+  double centroidMax[3] = { boundsMax[0], boundsMax[1], boundsMax[2] };
+  for (int triangleIndex = firstTriangle; triangleIndex < firstTriangle + numberOfTriangles; triangleIndex++)
+  {
+    const Triangle& triangle = this->Triangles[triangleIndex];
+    for (int axis = 0; axis < 3; axis++)
+    {
+      double vertices[3] = { triangle.Vertex0[axis], triangle.Vertex0[axis] + triangle.Edge1[axis], triangle.Vertex0[axis] + triangle.Edge2[axis] };
+      boundsMin[axis] = std::min(boundsMin[axis], *std::min_element(vertices, vertices + 3));
+      boundsMax[axis] = std::max(boundsMax[axis], *std::max_element(vertices, vertices + 3));
+      double centroid = (vertices[0] + vertices[1] + vertices[2]) / 3.0;
+      centroidMin[axis] = std::min(centroidMin[axis], centroid);
+      centroidMax[axis] = std::max(centroidMax[axis], centroid);
+    }
+  }
+  RoundBoundsOutwards(boundsMin, boundsMax, this->Nodes[nodeIndex].BoundsMin, this->Nodes[nodeIndex].BoundsMax);
+
+  int splitAxis = 0;
+  for (int axis = 1; axis < 3; axis++)
+  {
+    if (centroidMax[axis] - centroidMin[axis] > centroidMax[splitAxis] - centroidMin[splitAxis])
+    {
+      splitAxis = axis;
+    }
+  }
+
+  if (numberOfTriangles <= MAXIMUM_NUMBER_OF_TRIANGLES_PER_LEAF || centroidMax[splitAxis] <= centroidMin[splitAxis] || depth + 1 >= MAXIMUM_DEPTH)
+  {
+    this->Nodes[nodeIndex].FirstIndex = firstTriangle;
+    this->Nodes[nodeIndex].NumberOfTriangles = numberOfTriangles;
+    return depth;
+  }
+
+  // Median split along the longest axis of the centroid bounds
+  int numberOfLeftTriangles = numberOfTriangles / 2;
+  std::vector<Triangle>::iterator first = this->Triangles.begin() + firstTriangle;
+  std::nth_element(first, first + numberOfLeftTriangles, first + numberOfTriangles, [splitAxis](const Triangle & a, const Triangle & b)
+  {
+    // Comparing the sums is the same as comparing the centroids
+    return 3.0 * a.Vertex0[splitAxis] + a.Edge1[splitAxis] + a.Edge2[splitAxis] < 3.0 * b.Vertex0[splitAxis] + b.Edge1[splitAxis] + b.Edge2[splitAxis];
+  });
+
+  int firstChildIndex = static_cast<int>(this->Nodes.size());
+  this->Nodes.resize(this->Nodes.size() + 2);
+  this->Nodes[nodeIndex].FirstIndex = firstChildIndex;
+  this->Nodes[nodeIndex].NumberOfTriangles = 0;
+  int leftDepth = BuildNode(firstChildIndex, firstTriangle, numberOfLeftTriangles, depth + 1);
+  int rightDepth = BuildNode(firstChildIndex + 1, firstTriangle + numberOfLeftTriangles, numberOfTriangles - numberOfLeftTriangles, depth + 1);
+  return std::max(leftDepth, rightDepth);
+}
+
+//-----------------------------------------------------------------------------
+bool PlusTriangleBvh::IntersectTriangle(const Triangle& triangle, const double* startPoint, const double* direction, Hit& hit)
+{
+  // Moller-Trumbore algorithm
+  double p[3] =
+  {
+    direction[1] * triangle.Edge2[2] - direction[2] * triangle.Edge2[1],
+    direction[2] * triangle.Edge2[0] - direction[0] * triangle.Edge2[2],
+    direction[0] * triangle.Edge2[1] - direction[1] * triangle.Edge2[0]
+  };
+  double determinant = triangle.Edge1[0] * p[0] + triangle.Edge1[1] * p[1] + triangle.Edge1[2] * p[2];
+  if (determinant == 0.0)
+  {
+    // the segment is parallel to the triangle
+    return false;
+  }
+  double inverseDeterminant = 1.0 / determinant;
+  double t[3] = { startPoint[0] - triangle.Vertex0[0], startPoint[1] - triangle.Vertex0[1], startPoint[2] - triangle.Vertex0[2] };
+  double u = (t[0] * p[0] + t[1] * p[1] + t[2] * p[2]) * inverseDeterminant;
+  if (u < 0.0 || u > 1.0)
+  {
+    return false;
+  }
+  double q[3] =
+  {
+    t[1] * triangle.Edge1[2] - t[2] * triangle.Edge1[1],
+    t[2] * triangle.Edge1[0] - t[0] * triangle.Edge1[2],
+    t[0] * triangle.Edge1[1] - t[1] * triangle.Edge1[0]
+  };
+  double v = (direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2]) * inverseDeterminant;
+  if (v < 0.0 || u + v > 1.0)
+  {
+    return false;
+  }
+  double distance = (triangle.Edge2[0] * q[0] + triangle.Edge2[1] * q[1] + triangle.Edge2[2] * q[2]) * inverseDeterminant;
+  if (distance < 0.0 || distance > 1.0)
+  {
+    return false;
+  }
+  hit.Distance = distance;
+  hit.Weights[0] = 1.0 - u - v;
+  hit.Weights[1] = u;
+  hit.Weights[2] = v;
+  hit.PointIds[0] = triangle.PointIds[0];
+  hit.PointIds[1] = triangle.PointIds[1];
+  hit.PointIds[2] = triangle.PointIds[2];
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void PlusTriangleBvh::IntersectSegments(int numberOfSegments, const double* startPoints, const double* endPoints, std::vector<Hit>* hits) const
+{
+  for (int segmentIndex = 0; segmentIndex < numberOfSegments; segmentIndex++)
+  {
+    hits[segmentIndex].clear();
+  }
+  if (this->Nodes.empty())
+  {
+    return;
+  }
+
+  const int allLanesMask = (1 << PACKET_SIZE) - 1;
+  int nodeStack[MAXIMUM_DEPTH + 1];
+  Hit hit;
+  for (int firstSegment = 0; firstSegment < numberOfSegments; firstSegment += PACKET_SIZE)
+  {
+    int numberOfSegmentsInPacket = std::min(PACKET_SIZE, numberOfSegments - firstSegment);
+    int activeLanesMask = allLanesMask >> (PACKET_SIZE - numberOfSegmentsInPacket);
+
+    // Unused lanes repeat the last segment, they are masked out
+    SegmentPacket packet;
+    double directions[PACKET_SIZE][3];
+    for (int lane = 0; lane < PACKET_SIZE; lane++)
+    {
+      int segmentIndex = firstSegment + std::min(lane, numberOfSegmentsInPacket - 1);
+      for (int axis = 0; axis < 3; axis++)
+      {
+        directions[lane][axis] = endPoints[segmentIndex * 3 + axis] - startPoints[segmentIndex * 3 + axis];
+        // Avoid infinite inverse direction (0 * infinity would be NaN in the box test)
+        float direction = static_cast<float>(directions[lane][axis]);
+        if (std::fabs(direction) < 1e-20f)
+        {
+          direction = (direction < 0 ? -1e-20f : 1e-20f);
+        }
+        packet.Origin[axis][lane] = static_cast<float>(startPoints[segmentIndex * 3 + axis]);
+        packet.InverseDirection[axis][lane] = 1.0f / direction;
+      }
+    }
+
+    int stackSize = 0;
+    nodeStack[stackSize++] = 0;
+    while (stackSize > 0)
+    {
+      const Node& node = this->Nodes[nodeStack[--stackSize]];
+      int lanesMask = IntersectBox(node.BoundsMin, node.BoundsMax, packet) & activeLanesMask;
+      if (lanesMask == 0)
+      {
+        continue;
+      }
+      if (node.NumberOfTriangles == 0)
+      {
+        // All intersections are collected, so the order of visiting the children does not matter
+        nodeStack[stackSize++] = node.FirstIndex;
+        nodeStack[stackSize++] = node.FirstIndex + 1;
+        continue;
+      }
+      for (int triangleIndex = node.FirstIndex; triangleIndex < node.FirstIndex + node.NumberOfTriangles; triangleIndex++)
+      {
+        for (int lane = 0; lane < numberOfSegmentsInPacket; lane++)
+        {
+          if ((lanesMask & (1 << lane)) && IntersectTriangle(this->Triangles[triangleIndex], startPoints + (firstSegment + lane) * 3, directions[lane], hit))
+          {
+            hits[firstSegment + lane].push_back(hit);
+          }
+        }
+      }
+    }
+  }
+
+  for (int segmentIndex = 0; segmentIndex < numberOfSegments; segmentIndex++)
+  {
+    std::sort(hits[segmentIndex].begin(), hits[segmentIndex].end(), HitDistanceLessThan);
+  }
+}
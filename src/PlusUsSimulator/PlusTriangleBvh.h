@@ -0,0 +1,110 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusTriangleBvh_h
+#define __PlusTriangleBvh_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusUsSimulatorExport.h"
+
+#include <vector>
+
+class vtkPolyData;
+
+/*!
+  \class PlusTriangleBvh
+  \brief Bounding volume hierarchy of the triangles of a surface mesh, for computing all intersections of many line segments with the surface
+
+  The segments are traversed in packets of PACKET_SIZE segments: the bounding boxes of the nodes are tested for all segments
+  of the packet at once (with SSE2 or NEON instructions if available) and a node is only visited if any of the segments intersects it.
+  Scanlines of an ultrasound image are close to each other, so they mostly visit the same nodes.
+
+  The hierarchy is not modified after Build, so IntersectSegments can be called from multiple threads.
+
+  \ingroup PlusLibUsSimulatorAlgo
+*/
+class vtkPlusUsSimulatorExport PlusTriangleBvh
+{
+public:
+  /*! Intersection of a segment and a triangle */
+  struct Hit
+  {
+    /*! Position of the intersection along the segment, 0 at the start point, 1 at the end point */
+    double Distance;
+    /*! Point IDs of the triangle corners in the mesh */
+    vtkIdType PointIds[3];
+    /*! Barycentric coordinates of the intersection point, the weights of the triangle corners */
+    double Weights[3];
+  };
+
+  /*! Triangle of the mesh. The second and third corners are stored relative to the first one. */
+  struct Triangle
+  {
+    double Vertex0[3];
+    double Edge1[3];
+    double Edge2[3];
+    vtkIdType PointIds[3];
+  };
+
+  /*! Node of the hierarchy. Children of an inner node are stored next to each other. */
+  struct Node
+  {
+    /*! Bounding box, rounded outwards to single precision */
+    float BoundsMin[3];
+    float BoundsMax[3];
+    /*! Index of the first child (inner node) or first triangle (leaf) */
+    int FirstIndex;
+    /*! Number of triangles, 0 for inner nodes */
+    int NumberOfTriangles;
+  };
+
+  /*! Number of segments that are traversed together */
+  static const int PACKET_SIZE = 4;
+
+  PlusTriangleBvh();
+  virtual ~PlusTriangleBvh();
+
+  /*! Build the hierarchy from the polygons and triangle strips of the mesh. Polygons with more than 3 points are triangulated as a fan. */
+  PlusStatus Build(vtkPolyData* polyData);
+
+  /*! Remove all triangles */
+  void Clear();
+
+  int GetNumberOfTriangles() const;
+
+  /*! Triangles in the order that the leaves refer to them, e.g., for copying the hierarchy to a GPU */
+  const std::vector<Triangle>& GetTriangles() const { return this->Triangles; }
+
+  /*! Nodes of the hierarchy, the first one is the root */
+  const std::vector<Node>& GetNodes() const { return this->Nodes; }
+
+  /*! Maximum depth of the leaves, the root has depth 0 */
+  int GetDepth() const { return this->Depth; }
+
+  /*!
+    Compute all intersections of line segments with the triangles.
+    \param numberOfSegments Number of segments
+    \param startPoints Segment start points, 3 coordinates for each segment
+    \param endPoints Segment end points, 3 coordinates for each segment
+    \param hits Array of numberOfSegments vectors, hits[i] is set to the intersections of segment i, ordered by distance
+      from the start point. The vectors are reused, so if the caller keeps them then no memory is allocated in subsequent calls.
+  */
+  void IntersectSegments(int numberOfSegments, const double* startPoints, const double* endPoints, std::vector<Hit>* hits) const;
+
+protected:
+  /*! Compute the bounding box of the triangles and split them recursively. Returns the maximum depth of the subtree. */
+  int BuildNode(int nodeIndex, int firstTriangle, int numberOfTriangles, int depth);
+
+  /*! Intersect one segment with one triangle */
+  static bool IntersectTriangle(const Triangle& triangle, const double* startPoint, const double* direction, Hit& hit);
+
+  std::vector<Triangle> Triangles;
+  std::vector<Node> Nodes;
+  /*! Maximum depth of the leaves, the root has depth 0 */
+  int Depth;
+};
+
+#endif // __PlusTriangleBvh_h
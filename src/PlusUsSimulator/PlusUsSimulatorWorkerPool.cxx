@@ -0,0 +1,105 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusUsSimulatorWorkerPool.h"
+
+#include <algorithm>
+
+//-----------------------------------------------------------------------------
+PlusUsSimulatorWorkerPool& PlusUsSimulatorWorkerPool::GetInstance()
+{
+  static PlusUsSimulatorWorkerPool instance;
+  return instance;
+}
+
+//-----------------------------------------------------------------------------
+PlusUsSimulatorWorkerPool::PlusUsSimulatorWorkerPool()
+  : StopRequested(false)
+{
+  // The threads that call Run take part in the work too
+  int numberOfPoolThreads = std::max<int>(std::thread::hardware_concurrency(), 1) - 1;
+  for (int i = 0; i < numberOfPoolThreads; i++)
+  {
+    this->Threads.push_back(std::thread(&PlusUsSimulatorWorkerPool::ProcessJobs, this));
+  }
+}
+
+//-----------------------------------------------------------------------------
+PlusUsSimulatorWorkerPool::~PlusUsSimulatorWorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->StopRequested = true;
+  }
+  this->JobQueued.notify_all();
+  for (std::vector<std::thread>::iterator threadIt = this->Threads.begin(); threadIt != this->Threads.end(); ++threadIt)
+  {
+    threadIt->join();
+  }
+}
+
+//-----------------------------------------------------------------------------
+void PlusUsSimulatorWorkerPool::Run(int numberOfThreads, const std::function<void()>& work)
+{
+  int numberOfQueuedRuns = std::min(numberOfThreads - 1, this->GetNumberOfPoolThreads());
+  if (numberOfQueuedRuns <= 0)
+  {
+    work();
+    return;
+  }
+
+  Job job;
+  job.Work = &work;
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    for (int i = 0; i < numberOfQueuedRuns; i++)
+    {
+      this->QueuedJobs.push_back(&job);
+    }
+  }
+  if (numberOfQueuedRuns == 1)
+  {
+    this->JobQueued.notify_one();
+  }
+  else
+  {
+    this->JobQueued.notify_all();
+  }
+
+  work();
+
+  // All work items are taken when the own run returns, so the runs that have not started yet are not needed anymore
+  std::unique_lock<std::mutex> lock(this->Mutex);
+  this->QueuedJobs.erase(std::remove(this->QueuedJobs.begin(), this->QueuedJobs.end(), &job), this->QueuedJobs.end());
+  this->JobRunCompleted.wait(lock, [&job]() { return job.NumberOfRunningThreads == 0; });
+}
+
+//-----------------------------------------------------------------------------
+void PlusUsSimulatorWorkerPool::ProcessJobs()
+{
+  std::unique_lock<std::mutex> lock(this->Mutex);
+  while (true)
+  {
+    this->JobQueued.wait(lock, [this]() { return this->StopRequested || !this->QueuedJobs.empty(); });
+    if (this->StopRequested)
+    {
+      return;
+    }
+    Job* job = this->QueuedJobs.front();
+    this->QueuedJobs.pop_front();
+    job->NumberOfRunningThreads++;
+    lock.unlock();
+
+    (*job->Work)();
+
+    lock.lock();
+    job->NumberOfRunningThreads--;
+    if (job->NumberOfRunningThreads == 0)
+    {
+      this->JobRunCompleted.notify_all();
+    }
+  }
+}
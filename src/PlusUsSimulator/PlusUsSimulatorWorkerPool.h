@@ -0,0 +1,79 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusUsSimulatorWorkerPool_h
+#define __PlusUsSimulatorWorkerPool_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusUsSimulatorExport.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*!
+  \class PlusUsSimulatorWorkerPool
+  \brief Process-wide pool of threads that simulate the scanlines of all ultrasound simulators
+
+  If multiple probes are simulated (multiple vtkPlusUsSimulatorAlgo instances) then they share the threads of this pool
+  instead of each simulator starting as many threads as the number of processors for each frame, so the processors are
+  not oversubscribed and no threads are created per frame.
+
+  Run executes a work function on the calling thread and on idle pool threads at the same time. The work function
+  must take work items (e.g., batches of scanlines) until none are left, so the work is completed even if all pool
+  threads are busy with the frames of other simulators; the calling thread is never blocked by other simulators.
+
+  \ingroup PlusLibUsSimulatorAlgo
+*/
+class vtkPlusUsSimulatorExport PlusUsSimulatorWorkerPool
+{
+public:
+  static PlusUsSimulatorWorkerPool& GetInstance();
+
+  /*!
+    Run the work function on the calling thread and on at most numberOfThreads-1 pool threads concurrently,
+    and return when all started runs have completed. Pool threads that become idle only start a run while
+    the calling thread has not finished its own run.
+  */
+  void Run(int numberOfThreads, const std::function<void()>& work);
+
+  /*! Number of pool threads, one less than the number of processors */
+  int GetNumberOfPoolThreads() const { return static_cast<int>(this->Threads.size()); }
+
+protected:
+  PlusUsSimulatorWorkerPool();
+  virtual ~PlusUsSimulatorWorkerPool();
+
+  /*! Work function of a Run call with the number of pool threads that are running it */
+  struct Job
+  {
+    Job() : Work(NULL), NumberOfRunningThreads(0) {}
+    const std::function<void()>* Work;
+    int NumberOfRunningThreads;
+  };
+
+  /*! Run the queued jobs until the pool is destroyed */
+  void ProcessJobs();
+
+  std::vector<std::thread> Threads;
+
+  /*! Protects the queue, the jobs and the stop request */
+  std::mutex Mutex;
+  std::condition_variable JobQueued;
+  std::condition_variable JobRunCompleted;
+  /*! A job is queued once for each pool thread that may run it */
+  std::deque<Job*> QueuedJobs;
+  bool StopRequested;
+
+private:
+  PlusUsSimulatorWorkerPool(const PlusUsSimulatorWorkerPool&);
+  void operator=(const PlusUsSimulatorWorkerPool&);
+};
+
+#endif
@@ -7,8 +7,11 @@ See License.txt for details.
 #include "PlusConfigure.h"
 
 #include <algorithm>
+#include <atomic>
+#include <functional>
 #include <list>
 #include <map>
+#include <thread>
 
 #include "vtkPlusUsSimulatorAlgo.h"
 
@@ -20,6 +23,7 @@ See License.txt for details.
 #include "vtkSmartPointer.h"
 #include "vtkImageStencil.h"
 #include "vtkInformationVector.h"
+#include "vtkMath.h"
 #include "vtkImageData.h"
 #include "vtkObjectFactory.h"
 #include "vtkPointData.h"
@@ -31,8 +35,14 @@ See License.txt for details.
 #include "vtkPlusRfProcessor.h"
 #include "vtkPlusUsScanConvert.h"
 
+#include "PlusPerlinNoise.h"
+#include "PlusUsSimulatorWorkerPool.h"
+
+#ifdef PLUS_USE_OPENCL
+#include "vtkPlusUsSimulatorAlgoOpenCL.h"
+#endif
+
 // For noise generation
-#include "vtkLineSource.h"
 #include "vtkPerlinNoise.h"
 #include "vtkProbeFilter.h"
 #include "vtkSampleFunction.h"
@@ -44,6 +54,8 @@ vtkStandardNewMacro(vtkPlusUsSimulatorAlgo);
 //-----------------------------------------------------------------------------
 vtkPlusUsSimulatorAlgo::vtkPlusUsSimulatorAlgo()
   : TransformRepository(NULL)
+  , Backend(BACKEND_CPU)
+  , OpenCLSimulator(NULL)
 {
   SetNumberOfInputPorts(0);
   SetNumberOfOutputPorts(1);
@@ -53,6 +65,7 @@ vtkPlusUsSimulatorAlgo::vtkPlusUsSimulatorAlgo()
 
   this->NumberOfScanlines = 256;
   this->NumberOfSamplesPerScanline = 1000;
+  this->NumberOfThreads = 0;
   this->IncomingIntensityMwPerCm2 = 100;
   this->FrequencyMhz = 2.5;
   this->BrightnessConversionGamma = 0.333;
@@ -61,6 +74,7 @@ vtkPlusUsSimulatorAlgo::vtkPlusUsSimulatorAlgo()
 
   this->RfProcessor = vtkPlusRfProcessor::New();
 
+  this->NoiseGenerator = NOISE_GENERATOR_PERLIN;
   this->NoiseAmplitude = 0;
   this->NoiseFrequency[0] = 0;
   this->NoiseFrequency[1] = 0;
@@ -83,6 +97,13 @@ vtkPlusUsSimulatorAlgo::~vtkPlusUsSimulatorAlgo()
     this->RfProcessor->Delete();
     this->RfProcessor = NULL;
   }
+#ifdef PLUS_USE_OPENCL
+  if (this->OpenCLSimulator != NULL)
+  {
+    this->OpenCLSimulator->Delete();
+    this->OpenCLSimulator = NULL;
+  }
+#endif
   this->SetTransformRepository(NULL);
 }
 
@@ -90,6 +111,8 @@ vtkPlusUsSimulatorAlgo::~vtkPlusUsSimulatorAlgo()
 void vtkPlusUsSimulatorAlgo::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "Backend: " << (this->Backend == BACKEND_OPENCL ? "OpenCL" : "CPU") << std::endl;
+  os << indent << "NoiseGenerator: " << (this->NoiseGenerator == NOISE_GENERATOR_IMPROVED_PERLIN ? "ImprovedPerlin" : "Perlin") << std::endl;
 }
 
 //-----------------------------------------------------------------------------
@@ -153,15 +176,16 @@ int vtkPlusUsSimulatorAlgo::RequestData(vtkInformation* request, vtkInformationV
   double distanceBetweenScanlineSamplePointsMm = scanConverter->GetDistanceBetweenScanlineSamplePointsMm();
 
   // Initialize noise generator
-  vtkSmartPointer<vtkLineSource> noiseSamplerLine_Reference = vtkSmartPointer<vtkLineSource>::New();
   vtkSmartPointer<vtkPerlinNoise> noiseFunction = vtkSmartPointer<vtkPerlinNoise>::New();
-  double samplePointPosition_Reference[3] = {0, 0, 0};
+  PlusPerlinNoise improvedNoiseFunction;
   if (this->NoiseAmplitude > 0)
   {
-    noiseSamplerLine_Reference->SetResolution(this->NumberOfSamplesPerScanline - 1);
     noiseFunction->SetAmplitude(this->NoiseAmplitude);
     noiseFunction->SetFrequency(this->NoiseFrequency);
     noiseFunction->SetPhase(this->NoisePhase);
+    improvedNoiseFunction.SetAmplitude(this->NoiseAmplitude);
+    improvedNoiseFunction.SetFrequency(this->NoiseFrequency);
+    improvedNoiseFunction.SetPhase(this->NoisePhase);
   }
 
   igsioTransformName imageToReferenceTransformName(this->GetImageCoordinateFrame(), this->GetReferenceCoordinateFrame());
@@ -186,16 +210,6 @@ int vtkPlusUsSimulatorAlgo::RequestData(vtkInformation* request, vtkInformationV
   vtkSmartPointer<vtkMatrix4x4> referenceToImageMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
   vtkMatrix4x4::Invert(imageToReferenceMatrix, referenceToImageMatrix);
 
-  // Create a few variables outside the loop to avoid reallocations and to make the code easier to read
-  vtkPoints* samplePointPositions_Reference = 0;
-  // Create a buffer outside the for loop to allow reusing it
-  std::vector<double> intensities;
-  // scanline start/end positions in Image and Reference coordinate systems
-  double scanLineStartPoint_Image[4] = {0, 0, 0, 1};
-  double scanLineEndPoint_Image[4] = {0, 0, 0, 1};
-  double scanLineStartPoint_Reference[4] = {0, 0, 0, 1};
-  double scanLineEndPoint_Reference[4] = {0, 0, 0, 1};
-
   for (std::vector<PlusSpatialModel>::iterator spatialModelIt = this->SpatialModels.begin(); spatialModelIt != this->SpatialModels.end(); ++spatialModelIt)
   {
     vtkSmartPointer<vtkMatrix4x4> referenceToObjectMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
@@ -212,105 +226,107 @@ int vtkPlusUsSimulatorAlgo::RequestData(vtkInformation* request, vtkInformationV
     spatialModelIt->SetReferenceToObjectTransform(referenceToObjectMatrix);
   }
 
+  // Scanline start and end positions (3 coordinates each) in the Reference coordinate system
+  std::vector<double> scanLineStartPoints_Reference(this->NumberOfScanlines * 3, 0.0);
+  std::vector<double> scanLineEndPoints_Reference(this->NumberOfScanlines * 3, 0.0);
   for (int scanLineIndex = 0; scanLineIndex < this->NumberOfScanlines; scanLineIndex++)
   {
+    double scanLineStartPoint_Image[4] = {0, 0, 0, 1};
+    double scanLineEndPoint_Image[4] = {0, 0, 0, 1};
     scanConverter->GetScanLineEndPoints(scanLineIndex, scanLineStartPoint_Image, scanLineEndPoint_Image);
+    double scanLineStartPoint_Reference[4] = {0, 0, 0, 1};
+    double scanLineEndPoint_Reference[4] = {0, 0, 0, 1};
     imageToReferenceMatrix->MultiplyPoint(scanLineStartPoint_Image, scanLineStartPoint_Reference);
     imageToReferenceMatrix->MultiplyPoint(scanLineEndPoint_Image, scanLineEndPoint_Reference);
+    std::copy(scanLineStartPoint_Reference, scanLineStartPoint_Reference + 3, scanLineStartPoints_Reference.begin() + scanLineIndex * 3);
+    std::copy(scanLineEndPoint_Reference, scanLineEndPoint_Reference + 3, scanLineEndPoints_Reference.begin() + scanLineIndex * 3);
+  }
 
-    if (this->NoiseAmplitude > 0)
-    {
-      noiseSamplerLine_Reference->SetPoint1(scanLineStartPoint_Reference);
-      noiseSamplerLine_Reference->SetPoint2(scanLineEndPoint_Reference);
-      noiseSamplerLine_Reference->Update();
-      samplePointPositions_Reference = noiseSamplerLine_Reference->GetOutput()->GetPoints();
-    }
+  // The resolution of the image is the larger of the sample spacing and the largest distance between neighboring scanlines
+  // (at the end of the scanlines for a curvilinear transducer), it determines the level of detail of the models
+  double imageResolutionMm = distanceBetweenScanlineSamplePointsMm;
+  for (int scanLineIndex = 1; scanLineIndex < this->NumberOfScanlines; scanLineIndex++)
+  {
+    imageResolutionMm = std::max(imageResolutionMm, sqrt(vtkMath::Distance2BetweenPoints(&scanLineStartPoints_Reference[(scanLineIndex - 1) * 3], &scanLineStartPoints_Reference[scanLineIndex * 3])));
+    imageResolutionMm = std::max(imageResolutionMm, sqrt(vtkMath::Distance2BetweenPoints(&scanLineEndPoints_Reference[(scanLineIndex - 1) * 3], &scanLineEndPoints_Reference[scanLineIndex * 3])));
+  }
 
-    // Get model intersection positions along the scanline for all the models
-    std::deque<PlusSpatialModel::LineIntersectionInfo> lineIntersectionsWithModels;
-    for (std::vector<PlusSpatialModel>::iterator spatialModelIt = this->SpatialModels.begin(); spatialModelIt != this->SpatialModels.end(); ++spatialModelIt)
+  // Models that do not overlap the bounding box of the scanlines are not intersected with the scanlines at all
+  std::vector<PlusSpatialModel*> intersectedSpatialModels;
+  for (std::vector<PlusSpatialModel>::iterator spatialModelIt = this->SpatialModels.begin(); spatialModelIt != this->SpatialModels.end(); ++spatialModelIt)
+  {
+    // Load the model and precompute the attenuations now, so that the models are not modified while the scanlines are simulated
+    spatialModelIt->PrepareForSimulation(this->NumberOfSamplesPerScanline, distanceBetweenScanlineSamplePointsMm, imageResolutionMm);
+    if (spatialModelIt->IsIntersectingLines(this->NumberOfScanlines, &scanLineStartPoints_Reference[0], &scanLineEndPoints_Reference[0]))
     {
-      // Append line intersections found with this model to lineIntersectionsWithModels
-      spatialModelIt->GetLineIntersections(lineIntersectionsWithModels, scanLineStartPoint_Reference, scanLineEndPoint_Reference);
+      intersectedSpatialModels.push_back(&(*spatialModelIt));
     }
+  }
 
-    ConvertLineModelIntersectionsToSegmentDescriptor(lineIntersectionsWithModels);
+  bool scanLinesSimulated = false;
+  if (this->Backend == BACKEND_OPENCL)
+  {
+    scanLinesSimulated = (this->SimulateScanLinesOpenCL(scanLineStartPoints_Reference, scanLineEndPoints_Reference, distanceBetweenScanlineSamplePointsMm, scanLines) == PLUS_SUCCESS);
+  }
 
-    int currentPixelIndex = 0;
-    int scanLineExtent[6] = {0, this->NumberOfSamplesPerScanline - 1, scanLineIndex, scanLineIndex, 0, 0};
-    unsigned char* dstPixelAddress = (unsigned char*)scanLines->GetScalarPointerForExtent(scanLineExtent);
-    double incomingBeamIntensity = this->IncomingIntensityMwPerCm2 * 1000;
-    int numIntersectionPoints = lineIntersectionsWithModels.size();
-    if (numIntersectionPoints < 1)
-    {
-      LOG_ERROR("No intersections with any SpatialObjects. Probably no background object is specified.");
-      return 0;
-    }
-    PlusSpatialModel* previousModel = &this->TransducerSpatialModel;
-    for (vtkIdType intersectionIndex = 0; (intersectionIndex <= numIntersectionPoints) && (currentPixelIndex < this->NumberOfSamplesPerScanline); intersectionIndex++)
-    {
-      // determine end of segment position and pixel color
-      int endOfSegmentPixelIndex = currentPixelIndex;
-      double distanceOfIntersectionPointFromScanLineStartPointMm = 0; // defined here to allow for access later on in code
-      if (intersectionIndex + 1 < numIntersectionPoints)
-      {
-        distanceOfIntersectionPointFromScanLineStartPointMm = lineIntersectionsWithModels[intersectionIndex + 1].IntersectionDistanceFromStartPointMm;
-        endOfSegmentPixelIndex = distanceOfIntersectionPointFromScanLineStartPointMm / distanceBetweenScanlineSamplePointsMm;
-        if (endOfSegmentPixelIndex > this->NumberOfSamplesPerScanline)
-        {
-          // the next intersection point is out of the image
-          endOfSegmentPixelIndex = this->NumberOfSamplesPerScanline;
-        }
-      }
-      else
-      {
-        // last segment, after all the intersection points
-        endOfSegmentPixelIndex = this->NumberOfSamplesPerScanline;
-      }
+  // Neighboring scanlines are intersected with the models together, in packets of the triangle hierarchy
+  const int NUMBER_OF_SCANLINES_PER_BATCH = 4 * PlusTriangleBvh::PACKET_SIZE;
+  // No batches are left for the CPU if the scanlines are already simulated on the OpenCL device
+  int numberOfBatches = scanLinesSimulated ? 0 : (this->NumberOfScanlines + NUMBER_OF_SCANLINES_PER_BATCH - 1) / NUMBER_OF_SCANLINES_PER_BATCH;
 
-      int numberOfFilledPixels = endOfSegmentPixelIndex - currentPixelIndex;
-      if (numberOfFilledPixels < 1)
-      {
-        continue;
-      }
+  int numberOfThreads = this->NumberOfThreads;
+  if (numberOfThreads <= 0)
+  {
+    numberOfThreads = std::max<int>(std::thread::hardware_concurrency(), 1);
+  }
+  numberOfThreads = std::min(numberOfThreads, numberOfBatches);
 
-      PlusSpatialModel* currentModel = NULL;
-      if (intersectionIndex < numIntersectionPoints)
+  // Scanlines are independent, each thread takes the next batch of scanlines and simulates it with its own buffers
+  std::atomic<int> nextBatchIndex(0);
+  std::atomic<bool> simulationFailed(false);
+  std::function<void()> simulateScanLines = [&]()
+  {
+    std::vector< std::vector<PlusSpatialModel::LineIntersectionInfo> > lineIntersectionsWithModels(NUMBER_OF_SCANLINES_PER_BATCH);
+    PlusSpatialModel::LineIntersectionBuffers lineIntersectionBuffers;
+    std::vector<double> intensities;
+    std::vector<double> noise(this->NoiseAmplitude > 0 ? this->NumberOfSamplesPerScanline : 0);
+    for (int batchIndex = nextBatchIndex++; batchIndex < numberOfBatches && !simulationFailed; batchIndex = nextBatchIndex++)
+    {
+      int firstScanLineIndex = batchIndex * NUMBER_OF_SCANLINES_PER_BATCH;
+      int numberOfScanLinesInBatch = std::min(NUMBER_OF_SCANLINES_PER_BATCH, this->NumberOfScanlines - firstScanLineIndex);
+      for (int i = 0; i < numberOfScanLinesInBatch; i++)
       {
-        currentModel = lineIntersectionsWithModels[intersectionIndex].Model;
+        lineIntersectionsWithModels[i].clear();
       }
-      else
+      // Get model intersection positions along the scanlines for all the models
+      for (std::vector<PlusSpatialModel*>::iterator spatialModelIt = intersectedSpatialModels.begin(); spatialModelIt != intersectedSpatialModels.end(); ++spatialModelIt)
       {
-        // the segment after the last intersection point is assumed to belong to the model of the last intersection
-        currentModel = lineIntersectionsWithModels[numIntersectionPoints - 1].Model;
+        (*spatialModelIt)->GetLineIntersections(numberOfScanLinesInBatch, &scanLineStartPoints_Reference[firstScanLineIndex * 3], &scanLineEndPoints_Reference[firstScanLineIndex * 3],
+                                             &lineIntersectionsWithModels[0], lineIntersectionBuffers);
       }
-
-      double outgoingBeamIntensity = 0;
-      currentModel->CalculateIntensity(intensities, numberOfFilledPixels, distanceBetweenScanlineSamplePointsMm, previousModel->GetAcousticImpedanceMegarayls(), incomingBeamIntensity, outgoingBeamIntensity, lineIntersectionsWithModels[intersectionIndex].IntersectionIncidenceAngleRad);
-      previousModel = currentModel;
-
-      if (this->NoiseAmplitude > 0)
+      for (int i = 0; i < numberOfScanLinesInBatch && !simulationFailed; i++)
       {
-        for (int pixelIndex = 0; pixelIndex < numberOfFilledPixels; pixelIndex++)
+        int scanLineIndex = firstScanLineIndex + i;
+        int scanLineExtent[6] = {0, this->NumberOfSamplesPerScanline - 1, scanLineIndex, scanLineIndex, 0, 0};
+        unsigned char* dstPixelAddress = (unsigned char*)scanLines->GetScalarPointerForExtent(scanLineExtent);
+        if (!noise.empty())
         {
-          samplePointPositions_Reference->GetPoint(currentPixelIndex + pixelIndex, samplePointPosition_Reference);
-          double noise = noiseFunction->EvaluateFunction(samplePointPosition_Reference);
-          // Noise is multiplicative: NoisySignal = signal + noise * (signal-SignalMean) = signal*(1+noise) - noise*SignalMean;
-          (*dstPixelAddress++) = std::max(std::min(this->BrightnessConversionOffset + this->BrightnessConversionScale * fastPow(intensities[pixelIndex], this->BrightnessConversionGamma) + noise, 255.0), 0.0);
+          this->ComputeScanLineNoise(&scanLineStartPoints_Reference[scanLineIndex * 3], &scanLineEndPoints_Reference[scanLineIndex * 3],
+                                     noiseFunction, improvedNoiseFunction, &noise[0]);
         }
-      }
-      else
-      {
-        for (int pixelIndex = 0; pixelIndex < numberOfFilledPixels; pixelIndex++)
+        if (this->SimulateScanLine(distanceBetweenScanlineSamplePointsMm, noise.empty() ? NULL : &noise[0], dstPixelAddress,
+                                   lineIntersectionsWithModels[i], intensities) != PLUS_SUCCESS)
         {
-          (*dstPixelAddress++) = std::max(std::min(this->BrightnessConversionOffset + this->BrightnessConversionScale * fastPow(intensities[pixelIndex], this->BrightnessConversionGamma), 255.0), 0.0);
+          simulationFailed = true;
         }
       }
-
-      incomingBeamIntensity = outgoingBeamIntensity;
-
-      currentPixelIndex += numberOfFilledPixels;
     }
+  };
+  // The threads are shared with the other simulators, so simulating multiple probes does not oversubscribe the processors
+  PlusUsSimulatorWorkerPool::GetInstance().Run(numberOfThreads, simulateScanLines);
+  if (simulationFailed)
+  {
+    return 0;
   }
 
   vtkImageData* simulatedUsImage = vtkImageData::SafeDownCast(outInfo->Get(vtkDataObject::DATA_OBJECT()));
@@ -324,6 +340,155 @@ int vtkPlusUsSimulatorAlgo::RequestData(vtkInformation* request, vtkInformationV
   return 1;
 }
 
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusUsSimulatorAlgo::SimulateScanLinesOpenCL(const std::vector<double>& scanLineStartPoints_Reference, const std::vector<double>& scanLineEndPoints_Reference,
+    double distanceBetweenScanlineSamplePointsMm, vtkImageData* scanLines)
+{
+#ifdef PLUS_USE_OPENCL
+  if (this->OpenCLSimulator == NULL)
+  {
+    this->OpenCLSimulator = vtkPlusUsSimulatorAlgoOpenCL::New();
+  }
+  if (!this->OpenCLSimulator->IsInitialized() && this->OpenCLSimulator->Initialize() != PLUS_SUCCESS)
+  {
+    LOG_WARNING("OpenCL simulation is not available, ultrasound simulation is performed on the CPU");
+    this->Backend = BACKEND_CPU;
+    return PLUS_FAIL;
+  }
+  vtkPlusUsSimulatorAlgoOpenCL::SimulationParameters parameters;
+  parameters.NumberOfScanlines = this->NumberOfScanlines;
+  parameters.NumberOfSamplesPerScanline = this->NumberOfSamplesPerScanline;
+  parameters.DistanceBetweenScanlineSamplePointsMm = distanceBetweenScanlineSamplePointsMm;
+  parameters.IncomingIntensityMwPerCm2 = this->IncomingIntensityMwPerCm2;
+  parameters.BrightnessConversionGamma = this->BrightnessConversionGamma;
+  parameters.BrightnessConversionOffset = this->BrightnessConversionOffset;
+  parameters.BrightnessConversionScale = this->BrightnessConversionScale;
+  parameters.NoiseAmplitude = this->NoiseAmplitude;
+  std::copy(this->NoiseFrequency, this->NoiseFrequency + 3, parameters.NoiseFrequency);
+  std::copy(this->NoisePhase, this->NoisePhase + 3, parameters.NoisePhase);
+  if (this->OpenCLSimulator->SimulateScanLines(parameters, &scanLineStartPoints_Reference[0], &scanLineEndPoints_Reference[0],
+      this->SpatialModels, this->TransducerSpatialModel, scanLines) != PLUS_SUCCESS)
+  {
+    LOG_WARNING("OpenCL simulation failed, ultrasound simulation is performed on the CPU");
+    this->Backend = BACKEND_CPU;
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+#else
+  LOG_WARNING("Plus is built without OpenCL support (PLUS_USE_OPENCL), ultrasound simulation is performed on the CPU");
+  this->Backend = BACKEND_CPU;
+  return PLUS_FAIL;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusUsSimulatorAlgo::ComputeScanLineNoise(const double* scanLineStartPoint_Reference, const double* scanLineEndPoint_Reference,
+    vtkPerlinNoise* vtkNoiseFunction, const PlusPerlinNoise& improvedNoiseFunction, double* noise)
+{
+  // Noise is sampled at equally spaced points between the scanline start and end points
+  double samplePointStep_Reference[3] = {0, 0, 0};
+  for (int i = 0; i < 3; i++)
+  {
+    samplePointStep_Reference[i] = (scanLineEndPoint_Reference[i] - scanLineStartPoint_Reference[i]) / std::max(this->NumberOfSamplesPerScanline - 1, 1);
+  }
+  if (this->NoiseGenerator == NOISE_GENERATOR_IMPROVED_PERLIN)
+  {
+    improvedNoiseFunction.EvaluateLine(scanLineStartPoint_Reference, samplePointStep_Reference, this->NumberOfSamplesPerScanline, noise);
+    return;
+  }
+  double samplePointPosition_Reference[3] = {0, 0, 0};
+  for (int pixelIndex = 0; pixelIndex < this->NumberOfSamplesPerScanline; pixelIndex++)
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      samplePointPosition_Reference[i] = scanLineStartPoint_Reference[i] + pixelIndex * samplePointStep_Reference[i];
+    }
+    noise[pixelIndex] = vtkNoiseFunction->EvaluateFunction(samplePointPosition_Reference);
+  }
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusUsSimulatorAlgo::SimulateScanLine(double distanceBetweenScanlineSamplePointsMm, const double* noise, unsigned char* dstPixelAddress,
+    std::vector<PlusSpatialModel::LineIntersectionInfo>& lineIntersectionsWithModels, std::vector<double>& intensities)
+{
+  ConvertLineModelIntersectionsToSegmentDescriptor(lineIntersectionsWithModels);
+
+  int currentPixelIndex = 0;
+  double incomingBeamIntensity = this->IncomingIntensityMwPerCm2 * 1000;
+  int numIntersectionPoints = lineIntersectionsWithModels.size();
+  if (numIntersectionPoints < 1)
+  {
+    LOG_ERROR("No intersections with any SpatialObjects. Probably no background object is specified.");
+    return PLUS_FAIL;
+  }
+  PlusSpatialModel* previousModel = &this->TransducerSpatialModel;
+  for (vtkIdType intersectionIndex = 0; (intersectionIndex <= numIntersectionPoints) && (currentPixelIndex < this->NumberOfSamplesPerScanline); intersectionIndex++)
+  {
+    // determine end of segment position and pixel color
+    int endOfSegmentPixelIndex = currentPixelIndex;
+    double distanceOfIntersectionPointFromScanLineStartPointMm = 0; // defined here to allow for access later on in code
+    if (intersectionIndex + 1 < numIntersectionPoints)
+    {
+      distanceOfIntersectionPointFromScanLineStartPointMm = lineIntersectionsWithModels[intersectionIndex + 1].IntersectionDistanceFromStartPointMm;
+      endOfSegmentPixelIndex = distanceOfIntersectionPointFromScanLineStartPointMm / distanceBetweenScanlineSamplePointsMm;
+      if (endOfSegmentPixelIndex > this->NumberOfSamplesPerScanline)
+      {
+        // the next intersection point is out of the image
+        endOfSegmentPixelIndex = this->NumberOfSamplesPerScanline;
+      }
+    }
+    else
+    {
+      // last segment, after all the intersection points
+      endOfSegmentPixelIndex = this->NumberOfSamplesPerScanline;
+    }
+
+    int numberOfFilledPixels = endOfSegmentPixelIndex - currentPixelIndex;
+    if (numberOfFilledPixels < 1)
+    {
+      continue;
+    }
+
+    PlusSpatialModel* currentModel = NULL;
+    if (intersectionIndex < numIntersectionPoints)
+    {
+      currentModel = lineIntersectionsWithModels[intersectionIndex].Model;
+    }
+    else
+    {
+      // the segment after the last intersection point is assumed to belong to the model of the last intersection
+      currentModel = lineIntersectionsWithModels[numIntersectionPoints - 1].Model;
+    }
+
+    double outgoingBeamIntensity = 0;
+    currentModel->CalculateIntensity(intensities, numberOfFilledPixels, distanceBetweenScanlineSamplePointsMm, previousModel->GetAcousticImpedanceMegarayls(), incomingBeamIntensity, outgoingBeamIntensity, lineIntersectionsWithModels[intersectionIndex].IntersectionIncidenceAngleRad);
+    previousModel = currentModel;
+
+    if (noise != NULL)
+    {
+      const double* segmentNoise = noise + currentPixelIndex;
+      for (int pixelIndex = 0; pixelIndex < numberOfFilledPixels; pixelIndex++)
+      {
+        // Noise is multiplicative: NoisySignal = signal + noise * (signal-SignalMean) = signal*(1+noise) - noise*SignalMean;
+        (*dstPixelAddress++) = std::max(std::min(this->BrightnessConversionOffset + this->BrightnessConversionScale * fastPow(intensities[pixelIndex], this->BrightnessConversionGamma) + segmentNoise[pixelIndex], 255.0), 0.0);
+      }
+    }
+    else
+    {
+      for (int pixelIndex = 0; pixelIndex < numberOfFilledPixels; pixelIndex++)
+      {
+        (*dstPixelAddress++) = std::max(std::min(this->BrightnessConversionOffset + this->BrightnessConversionScale * fastPow(intensities[pixelIndex], this->BrightnessConversionGamma), 255.0), 0.0);
+      }
+    }
+
+    incomingBeamIntensity = outgoingBeamIntensity;
+
+    currentPixelIndex += numberOfFilledPixels;
+  }
+
+  return PLUS_SUCCESS;
+}
+
 bool lineIntersectionLessThan(PlusSpatialModel::LineIntersectionInfo a, PlusSpatialModel::LineIntersectionInfo b)
 {
   return a.IntersectionDistanceFromStartPointMm < b.IntersectionDistanceFromStartPointMm;
@@ -333,7 +498,7 @@ bool lineIntersectionLessThan(PlusSpatialModel::LineIntersectionInfo a, PlusSpat
 // at the given intersection position (e.g., background/spine/spine).
 // We overwrite the "Model" by the model that starts from that intersection position (e.g., background/spine/background).
 //-----------------------------------------------------------------------------
-void vtkPlusUsSimulatorAlgo::ConvertLineModelIntersectionsToSegmentDescriptor(std::deque<PlusSpatialModel::LineIntersectionInfo>& lineIntersectionsWithModels)
+void vtkPlusUsSimulatorAlgo::ConvertLineModelIntersectionsToSegmentDescriptor(std::vector<PlusSpatialModel::LineIntersectionInfo>& lineIntersectionsWithModels)
 {
   // sort intersections based on the intersection distance
   std::sort(lineIntersectionsWithModels.begin(), lineIntersectionsWithModels.end(), lineIntersectionLessThan);
@@ -357,7 +522,7 @@ void vtkPlusUsSimulatorAlgo::ConvertLineModelIntersectionsToSegmentDescriptor(st
   }
   // insideModel contains all the SpatialModels that the current segment is in; listed in descending order based on cohesiveness
   std::list<PlusSpatialModel*> insideModel;
-  for (std::deque<PlusSpatialModel::LineIntersectionInfo>::iterator intersectionIt = lineIntersectionsWithModels.begin();
+  for (std::vector<PlusSpatialModel::LineIntersectionInfo>::iterator intersectionIt = lineIntersectionsWithModels.begin();
        intersectionIt != lineIntersectionsWithModels.end(); ++intersectionIt)
   {
     std::list<PlusSpatialModel*>::iterator foundThisModelAt = find(insideModel.begin(), insideModel.end(), intersectionIt->Model);
@@ -397,11 +562,14 @@ PlusStatus vtkPlusUsSimulatorAlgo::ReadConfiguration(vtkXMLDataElement* config)
 
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfScanlines, usSimulatorAlgoElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfSamplesPerScanline, usSimulatorAlgoElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfThreads, usSimulatorAlgoElement);
+  XML_READ_ENUM2_ATTRIBUTE_OPTIONAL(Backend, usSimulatorAlgoElement, "CPU", BACKEND_CPU, "OpenCL", BACKEND_OPENCL);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, FrequencyMhz, usSimulatorAlgoElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, BrightnessConversionGamma, usSimulatorAlgoElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, BrightnessConversionOffset, usSimulatorAlgoElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, BrightnessConversionScale, usSimulatorAlgoElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, IncomingIntensityMwPerCm2, usSimulatorAlgoElement);
+  XML_READ_ENUM2_ATTRIBUTE_OPTIONAL(NoiseGenerator, usSimulatorAlgoElement, "Perlin", NOISE_GENERATOR_PERLIN, "ImprovedPerlin", NOISE_GENERATOR_IMPROVED_PERLIN);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, NoiseAmplitude, usSimulatorAlgoElement);
   XML_READ_VECTOR_ATTRIBUTE_OPTIONAL(double, 3, NoiseFrequency, usSimulatorAlgoElement);
   XML_READ_VECTOR_ATTRIBUTE_OPTIONAL(double, 3, NoisePhase, usSimulatorAlgoElement);
@@ -427,6 +595,36 @@ PlusStatus vtkPlusUsSimulatorAlgo::ReadConfiguration(vtkXMLDataElement* config)
     this->SpatialModels.push_back(model);
   }
 
+  // Load the model files now instead of when the first image is simulated. The models are loaded in parallel,
+  // because loading and building the hierarchies of large surfaces takes most of the startup time.
+  int numberOfThreads = this->NumberOfThreads;
+  if (numberOfThreads <= 0)
+  {
+    numberOfThreads = std::max<int>(std::thread::hardware_concurrency(), 1);
+  }
+  numberOfThreads = std::min<int>(numberOfThreads, this->SpatialModels.size());
+  std::atomic<int> nextModelIndex(0);
+  std::atomic<bool> loadingFailed(false);
+  std::function<void()> loadModelFiles = [&]()
+  {
+    for (int modelIndex = nextModelIndex++; modelIndex < static_cast<int>(this->SpatialModels.size()); modelIndex = nextModelIndex++)
+    {
+      if (this->SpatialModels[modelIndex].UpdateModelFile() != PLUS_SUCCESS)
+      {
+        loadingFailed = true;
+      }
+    }
+  };
+  if (numberOfThreads > 0)
+  {
+    PlusUsSimulatorWorkerPool::GetInstance().Run(numberOfThreads, loadModelFiles);
+  }
+  if (loadingFailed)
+  {
+    LOG_ERROR("Failed to load the model files of the spatial models");
+    return PLUS_FAIL;
+  }
+
   return PLUS_SUCCESS;
 }
 
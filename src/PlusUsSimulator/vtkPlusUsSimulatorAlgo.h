@@ -14,20 +14,41 @@
 #include "PlusSpatialModel.h"
 #include "vtkIGSIOTransformRepository.h"
 
+class PlusPerlinNoise;
+class vtkPerlinNoise;
 class vtkPolyDataNormals;
 class vtkTriangleFilter;
 class vtkStripper;
-class vtkModifiedBSPTree;
 class vtkPlusRfProcessor;
+class vtkPlusUsSimulatorAlgoOpenCL;
 
 /*!
   \class vtkPlusUsSimulatorAlgo
   \brief Class that simulates ultrasound images from multiple surface models
+
+  If Backend="OpenCL" is set and Plus is built with PLUS_USE_OPENCL then the scanlines are simulated
+  on an OpenCL device (see vtkPlusUsSimulatorAlgoOpenCL). If no OpenCL device is available then the scanlines
+  are simulated on the CPU.
+
   \ingroup PlusLibUsSimulatorAlgo
 */
 class vtkPlusUsSimulatorExport vtkPlusUsSimulatorAlgo : public vtkImageAlgorithm
 {
 public:
+  enum SimulationBackend
+  {
+    BACKEND_CPU,
+    BACKEND_OPENCL
+  };
+
+  enum NoiseGeneratorType
+  {
+    /*! vtkPerlinNoise, evaluated for each pixel */
+    NOISE_GENERATOR_PERLIN,
+    /*! Improved Perlin noise evaluated for multiple pixels at once (PlusPerlinNoise), same noise as the OpenCL backend */
+    NOISE_GENERATOR_IMPROVED_PERLIN
+  };
+
   vtkTypeMacro(vtkPlusUsSimulatorAlgo, vtkImageAlgorithm);
   void PrintSelf(ostream& os, vtkIndent indent);
   static vtkPlusUsSimulatorAlgo* New();
@@ -98,8 +119,24 @@ public:
   /*! Set the length of scanlines in pixels */
   vtkSetMacro(NumberOfSamplesPerScanline, int);
 
+  /*!
+    Set the number of threads that simulate the scanlines. If 0 then the number of processors is used.
+    The threads are shared by all simulators (see PlusUsSimulatorWorkerPool).
+  */
+  vtkSetMacro(NumberOfThreads, int);
+  /*! Get the number of threads that simulate the scanlines */
+  vtkGetMacro(NumberOfThreads, int);
+
+  /*! Set/get the device that simulates the scanlines. Falls back to CPU if OpenCL simulation is not available. */
+  vtkSetMacro(Backend, SimulationBackend);
+  vtkGetMacro(Backend, SimulationBackend);
+
   PlusStatus GetFrameSize(FrameSizeType& frameSize);
 
+  /*! Set/get the function that generates the speckle noise */
+  vtkSetMacro(NoiseGenerator, NoiseGeneratorType);
+  vtkGetMacro(NoiseGenerator, NoiseGeneratorType);
+
   vtkSetMacro(NoiseAmplitude, double);
   vtkSetVector3Macro(NoiseFrequency, double);
   vtkSetVector3Macro(NoisePhase, double);
@@ -110,7 +147,29 @@ protected:
                           vtkInformationVector** inputVector,
                           vtkInformationVector* outputVector);
 
-  void ConvertLineModelIntersectionsToSegmentDescriptor(std::deque<PlusSpatialModel::LineIntersectionInfo>& lineIntersectionsWithModels);
+  void ConvertLineModelIntersectionsToSegmentDescriptor(std::vector<PlusSpatialModel::LineIntersectionInfo>& lineIntersectionsWithModels);
+
+  /*!
+    Compute the pixels of one scanline from its intersections with the models. Scanlines are independent,
+    so this method is called from multiple threads, each with its own intensity buffer.
+    \param noise Noise of each pixel of the scanline, NULL if no noise is added
+    \param dstPixelAddress First pixel of the scanline in the output image
+    \param lineIntersectionsWithModels Intersections of the scanline with all the models, they are sorted and converted to segments
+  */
+  PlusStatus SimulateScanLine(double distanceBetweenScanlineSamplePointsMm, const double* noise, unsigned char* dstPixelAddress,
+                              std::vector<PlusSpatialModel::LineIntersectionInfo>& lineIntersectionsWithModels, std::vector<double>& intensities);
+
+  /*!
+    Compute the noise at the samples of a scanline with the selected noise generator.
+    Only one of vtkNoiseFunction and improvedNoiseFunction is used, depending on NoiseGenerator.
+    \param noise Output array of NumberOfSamplesPerScanline values
+  */
+  void ComputeScanLineNoise(const double* scanLineStartPoint_Reference, const double* scanLineEndPoint_Reference,
+                            vtkPerlinNoise* vtkNoiseFunction, const PlusPerlinNoise& improvedNoiseFunction, double* noise);
+
+  /*! Simulate all the scanlines on the OpenCL device. Returns PLUS_FAIL and switches to CPU backend if the simulation failed. */
+  PlusStatus SimulateScanLinesOpenCL(const std::vector<double>& scanLineStartPoints_Reference, const std::vector<double>& scanLineEndPoints_Reference,
+                                     double distanceBetweenScanlineSamplePointsMm, vtkImageData* scanLines);
 
 protected:
   vtkPlusUsSimulatorAlgo();
@@ -133,6 +192,12 @@ private:
   /*! Number of samples in one scanline */
   int NumberOfSamplesPerScanline;
 
+  /*! Number of threads that simulate the scanlines, 0 means the number of processors */
+  int NumberOfThreads;
+
+  SimulationBackend Backend;
+  vtkPlusUsSimulatorAlgoOpenCL* OpenCLSimulator;
+
   vtkPlusRfProcessor* RfProcessor;
 
   /*! Frequency of the ultrasound image to be generated*/
@@ -160,6 +225,7 @@ private:
   std::vector<double> InsideObjectReflection;
   std::vector<double> OutsideObjectReflection;
 
+  NoiseGeneratorType NoiseGenerator;
   double NoiseAmplitude;
   double NoiseFrequency[3];
   double NoisePhase[3];
@@ -0,0 +1,1017 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+
+#include "vtkPlusUsSimulatorAlgoOpenCL.h"
+#include "PlusTriangleBvh.h"
+
+#include "vtkDataArray.h"
+#include "vtkImageData.h"
+#include "vtkMatrix4x4.h"
+#include "vtkObjectFactory.h"
+
+#include "PlusOpenCL.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+vtkStandardNewMacro(vtkPlusUsSimulatorAlgoOpenCL);
+
+namespace
+{
+  /*! Intersections of a scanline with all the models that are stored on the device. If there are more then they are ignored. */
+  const int MAXIMUM_NUMBER_OF_INTERSECTIONS = 64;
+
+  /*! Cohesiveness of the models is resolved in a fixed size array on the device */
+  const int MAXIMUM_NUMBER_OF_MODELS = 32;
+
+  /*! Nodes that are waiting for the traversal, PlusTriangleBvh limits the depth of the hierarchy to fit */
+  const int MAXIMUM_STACK_SIZE = 65;
+
+  /*! Status flags that the kernels set, same as in the kernel source */
+  const int STATUS_NO_INTERSECTIONS = 1;
+  const int STATUS_TOO_MANY_INTERSECTIONS = 2;
+  const int STATUS_SEGMENT_WITHOUT_MODEL = 4;
+
+  /*!
+    Kernels of the simulation. MAXIMUM_NUMBER_OF_INTERSECTIONS, MAXIMUM_NUMBER_OF_MODELS and MAXIMUM_STACK_SIZE
+    are defined when the program is built.
+  */
+  const char* KERNEL_SOURCE =
+    "// Same limits as in PlusSpatialModel\n"
+    "#define MINIMUM_BEAM_INTENSITY 1e-9f\n"
+    "#define SPECULAR_REFLECTION_BRDF_STDEV_RAD (30.0f * M_PI_F / 180.0f)\n"
+    "\n"
+    "// Segments are extended by this fraction at both ends in the bounding box test, as in PlusTriangleBvh\n"
+    "#define BOX_TEST_SEGMENT_TOLERANCE 1e-4f\n"
+    "\n"
+    "#define STATUS_NO_INTERSECTIONS 1\n"
+    "#define STATUS_TOO_MANY_INTERSECTIONS 2\n"
+    "#define STATUS_SEGMENT_WITHOUT_MODEL 4\n"
+    "\n"
+    "// MAXIMUM_NUMBER_OF_INTERSECTIONS, MAXIMUM_NUMBER_OF_MODELS and MAXIMUM_STACK_SIZE are defined when the program is built\n"
+    "\n"
+    "// Same layout as PlusTriangleBvh::Node\n"
+    "typedef struct\n"
+    "{\n"
+    "  float BoundsMin[3];\n"
+    "  float BoundsMax[3];\n"
+    "  int FirstIndex;\n"
+    "  int NumberOfTriangles;\n"
+    "} Node;\n"
+    "\n"
+    "typedef struct\n"
+    "{\n"
+    "  float Vertex0[3];\n"
+    "  float Edge1[3];\n"
+    "  float Edge2[3];\n"
+    "  int PointIds[3];\n"
+    "} Triangle;\n"
+    "\n"
+    "// PlusSpatialModel::IntensityParameters\n"
+    "typedef struct\n"
+    "{\n"
+    "  float AcousticImpedanceMegarayls;\n"
+    "  float IntensityAttenuationCoefficientPerPixel;\n"
+    "  float BackscatterDiffuseReflectionCoefficient;\n"
+    "  float SurfaceDiffuseReflectionCoefficient;\n"
+    "  float SurfaceSpecularReflectionCoefficient;\n"
+    "  float SurfaceReflectionIntensityDecayPerPixel;\n"
+    "} Material;\n"
+    "\n"
+    "// Pixels of a scanline that are inside one model\n"
+    "typedef struct\n"
+    "{\n"
+    "  int StartPixel;\n"
+    "  int EndPixel;\n"
+    "  // Backscattered intensity in the first pixel, it decreases by TransmittedFractionPerPixelTwoWay in each pixel\n"
+    "  float BackscatteredIntensity;\n"
+    "  float TransmittedFractionPerPixelTwoWay;\n"
+    "  int NumberOfBackscatteringPixels;\n"
+    "  // Intensity reflected from the surface in the first pixel, it decreases by SurfaceReflectionIntensityDecayPerPixel in each pixel\n"
+    "  float SurfaceReflectedIntensity;\n"
+    "  float SurfaceReflectionIntensityDecayPerPixel;\n"
+    "  int NumberOfSurfaceReflectionPixels;\n"
+    "} Segment;\n"
+    "\n"
+    "inline void AddIntersection(int line, float distanceMm, float incidenceAngleRad, int modelIndex,\n"
+    "  __global float2* intersections, __global int* intersectionModels, __global int* intersectionCounts, volatile __global int* status)\n"
+    "{\n"
+    "  int count = intersectionCounts[line];\n"
+    "  if (count >= MAXIMUM_NUMBER_OF_INTERSECTIONS)\n"
+    "  {\n"
+    "    atomic_or(status, STATUS_TOO_MANY_INTERSECTIONS);\n"
+    "    return;\n"
+    "  }\n"
+    "  intersections[line * MAXIMUM_NUMBER_OF_INTERSECTIONS + count] = (float2)(distanceMm, incidenceAngleRad);\n"
+    "  intersectionModels[line * MAXIMUM_NUMBER_OF_INTERSECTIONS + count] = modelIndex;\n"
+    "  intersectionCounts[line] = count + 1;\n"
+    "}\n"
+    "\n"
+    "// The background model is everywhere: the whole scanline is in this model\n"
+    "__kernel void AddBackgroundModel(__global float2* intersections, __global int* intersectionModels, __global int* intersectionCounts,\n"
+    "  volatile __global int* status, int modelIndex)\n"
+    "{\n"
+    "  int line = get_global_id(0);\n"
+    "  AddIntersection(line, 0.0f, 0.0f, modelIndex, intersections, intersectionModels, intersectionCounts, status);\n"
+    "}\n"
+    "\n"
+    "// Intersections of the search lines with the surface of one model, as in PlusSpatialModel::GetLineIntersections.\n"
+    "// searchLines: start point (0-2) and end point (3-5) in the Model coordinate system, length in mm in the Reference coordinate system (6)\n"
+    "__kernel void IntersectModel(__global const Node* nodes, __global const Triangle* triangles, __global const float* normals,\n"
+    "  __global const float8* searchLines, int firstSearchLine, float transducerSpatialModelMaxOverlapMm, int modelIndex,\n"
+    "  __global float2* intersections, __global int* intersectionModels, __global int* intersectionCounts, volatile __global int* status)\n"
+    "{\n"
+    "  int line = get_global_id(0);\n"
+    "  float8 searchLine = searchLines[firstSearchLine + line];\n"
+    "  float3 startPoint = searchLine.s012;\n"
+    "  float3 direction = searchLine.s345 - startPoint;\n"
+    "  float searchLineLengthMm = searchLine.s6;\n"
+    "  // Avoid infinite inverse direction (0 * infinity would be NaN in the box test)\n"
+    "  float3 inverseDirection = 1.0f / select(direction, copysign((float3)(1e-20f), direction), isless(fabs(direction), (float3)(1e-20f)));\n"
+    "  float3 normalizedDirection = normalize(direction);\n"
+    "\n"
+    "  // Intersections of this model, ordered by distance\n"
+    "  float hitDistances[MAXIMUM_NUMBER_OF_INTERSECTIONS];\n"
+    "  float hitAngles[MAXIMUM_NUMBER_OF_INTERSECTIONS];\n"
+    "  int numberOfHits = 0;\n"
+    "\n"
+    "  int nodeStack[MAXIMUM_STACK_SIZE];\n"
+    "  int stackSize = 0;\n"
+    "  nodeStack[stackSize++] = 0;\n"
+    "  while (stackSize > 0)\n"
+    "  {\n"
+    "    __global const Node* node = nodes + nodeStack[--stackSize];\n"
+    "    float3 distance1 = ((float3)(node->BoundsMin[0], node->BoundsMin[1], node->BoundsMin[2]) - startPoint) * inverseDirection;\n"
+    "    float3 distance2 = ((float3)(node->BoundsMax[0], node->BoundsMax[1], node->BoundsMax[2]) - startPoint) * inverseDirection;\n"
+    "    float3 nearDistances = fmin(distance1, distance2);\n"
+    "    float3 farDistances = fmax(distance1, distance2);\n"
+    "    float nearDistance = fmax(fmax(nearDistances.x, nearDistances.y), fmax(nearDistances.z, -BOX_TEST_SEGMENT_TOLERANCE));\n"
+    "    float farDistance = fmin(fmin(farDistances.x, farDistances.y), fmin(farDistances.z, 1.0f + BOX_TEST_SEGMENT_TOLERANCE));\n"
+    "    if (nearDistance > farDistance)\n"
+    "    {\n"
+    "      continue;\n"
+    "    }\n"
+    "    if (node->NumberOfTriangles == 0)\n"
+    "    {\n"
+    "      nodeStack[stackSize++] = node->FirstIndex;\n"
+    "      nodeStack[stackSize++] = node->FirstIndex + 1;\n"
+    "      continue;\n"
+    "    }\n"
+    "    for (int triangleIndex = node->FirstIndex; triangleIndex < node->FirstIndex + node->NumberOfTriangles; triangleIndex++)\n"
+    "    {\n"
+    "      // Moller-Trumbore algorithm\n"
+    "      __global const Triangle* triangle = triangles + triangleIndex;\n"
+    "      float3 vertex0 = (float3)(triangle->Vertex0[0], triangle->Vertex0[1], triangle->Vertex0[2]);\n"
+    "      float3 edge1 = (float3)(triangle->Edge1[0], triangle->Edge1[1], triangle->Edge1[2]);\n"
+    "      float3 edge2 = (float3)(triangle->Edge2[0], triangle->Edge2[1], triangle->Edge2[2]);\n"
+    "      float3 p = cross(direction, edge2);\n"
+    "      float determinant = dot(edge1, p);\n"
+    "      if (determinant == 0.0f)\n"
+    "      {\n"
+    "        continue;\n"
+    "      }\n"
+    "      float inverseDeterminant = 1.0f / determinant;\n"
+    "      float3 t = startPoint - vertex0;\n"
+    "      float u = dot(t, p) * inverseDeterminant;\n"
+    "      if (u < 0.0f || u > 1.0f)\n"
+    "      {\n"
+    "        continue;\n"
+    "      }\n"
+    "      float3 q = cross(t, edge1);\n"
+    "      float v = dot(direction, q) * inverseDeterminant;\n"
+    "      if (v < 0.0f || u + v > 1.0f)\n"
+    "      {\n"
+    "        continue;\n"
+    "      }\n"
+    "      float hitDistance = dot(edge2, q) * inverseDeterminant;\n"
+    "      if (hitDistance < 0.0f || hitDistance > 1.0f)\n"
+    "      {\n"
+    "        continue;\n"
+    "      }\n"
+    "      if (numberOfHits >= MAXIMUM_NUMBER_OF_INTERSECTIONS)\n"
+    "      {\n"
+    "        atomic_or(status, STATUS_TOO_MANY_INTERSECTIONS);\n"
+    "        continue;\n"
+    "      }\n"
+    "      // Surface normal interpolated from the normals at the triangle corners\n"
+    "      float3 normal = (1.0f - u - v) * vload3(triangle->PointIds[0], normals) + u * vload3(triangle->PointIds[1], normals) + v * vload3(triangle->PointIds[2], normals);\n"
+    "      float hitAngle = acos(clamp(dot(normalize(normal), normalizedDirection), -1.0f, 1.0f));\n"
+    "      // Insert the hit in distance order\n"
+    "      int hitIndex = numberOfHits++;\n"
+    "      for (; hitIndex > 0 && hitDistances[hitIndex - 1] > hitDistance; hitIndex--)\n"
+    "      {\n"
+    "        hitDistances[hitIndex] = hitDistances[hitIndex - 1];\n"
+    "        hitAngles[hitIndex] = hitAngles[hitIndex - 1];\n"
+    "      }\n"
+    "      hitDistances[hitIndex] = hitDistance;\n"
+    "      hitAngles[hitIndex] = hitAngle;\n"
+    "    }\n"
+    "  }\n"
+    "\n"
+    "  // Intersection points in the search line that are not part of the scanline indicate model/transducer overlap\n"
+    "  int hitIndex = 0;\n"
+    "  bool scanLineStartPointInsideModel = false;\n"
+    "  for (; hitIndex < numberOfHits && hitDistances[hitIndex] * searchLineLengthMm <= transducerSpatialModelMaxOverlapMm; hitIndex++)\n"
+    "  {\n"
+    "    scanLineStartPointInsideModel = !scanLineStartPointInsideModel;\n"
+    "  }\n"
+    "  if (scanLineStartPointInsideModel)\n"
+    "  {\n"
+    "    AddIntersection(line, 0.0f, 0.0f, modelIndex, intersections, intersectionModels, intersectionCounts, status);\n"
+    "  }\n"
+    "  for (; hitIndex < numberOfHits; hitIndex++)\n"
+    "  {\n"
+    "    AddIntersection(line, hitDistances[hitIndex] * searchLineLengthMm - transducerSpatialModelMaxOverlapMm, hitAngles[hitIndex], modelIndex,\n"
+    "      intersections, intersectionModels, intersectionCounts, status);\n"
+    "  }\n"
+    "}\n"
+    "\n"
+    "// Sort the intersections of a scanline, assign the models to the segments between them (as in\n"
+    "// vtkPlusUsSimulatorAlgo::ConvertLineModelIntersectionsToSegmentDescriptor) and compute the intensities\n"
+    "// entering and reflected in each segment (as in PlusSpatialModel::CalculateIntensity)\n"
+    "__kernel void ComputeSegments(__global float2* intersections, __global int* intersectionModels, __global const int* intersectionCounts,\n"
+    "  __constant Material* materials, float transducerAcousticImpedanceMegarayls, float incomingIntensity,\n"
+    "  int numberOfSamplesPerScanLine, float distanceBetweenScanlineSamplePointsMm,\n"
+    "  __global Segment* segments, __global int* segmentCounts, volatile __global int* status)\n"
+    "{\n"
+    "  int line = get_global_id(0);\n"
+    "  int numberOfIntersections = intersectionCounts[line];\n"
+    "  __global float2* lineIntersections = intersections + line * MAXIMUM_NUMBER_OF_INTERSECTIONS;\n"
+    "  __global int* lineModels = intersectionModels + line * MAXIMUM_NUMBER_OF_INTERSECTIONS;\n"
+    "  __global Segment* lineSegments = segments + line * (MAXIMUM_NUMBER_OF_INTERSECTIONS + 1);\n"
+    "  segmentCounts[line] = 0;\n"
+    "  if (numberOfIntersections < 1)\n"
+    "  {\n"
+    "    atomic_or(status, STATUS_NO_INTERSECTIONS);\n"
+    "    return;\n"
+    "  }\n"
+    "\n"
+    "  // Sort the intersections by distance\n"
+    "  for (int i = 1; i < numberOfIntersections; i++)\n"
+    "  {\n"
+    "    float2 intersection = lineIntersections[i];\n"
+    "    int model = lineModels[i];\n"
+    "    int j = i;\n"
+    "    for (; j > 0 && lineIntersections[j - 1].x > intersection.x; j--)\n"
+    "    {\n"
+    "      lineIntersections[j] = lineIntersections[j - 1];\n"
+    "      lineModels[j] = lineModels[j - 1];\n"
+    "    }\n"
+    "    lineIntersections[j] = intersection;\n"
+    "    lineModels[j] = model;\n"
+    "  }\n"
+    "\n"
+    "  // The model index is the cohesiveness: in a segment that is inside multiple models the model with the highest index is used.\n"
+    "  // insideModels contains the models that the current segment is in, in descending order.\n"
+    "  int insideModels[MAXIMUM_NUMBER_OF_MODELS];\n"
+    "  int numberOfInsideModels = 0;\n"
+    "  for (int i = 0; i < numberOfIntersections; i++)\n"
+    "  {\n"
+    "    int model = lineModels[i];\n"
+    "    int position = 0;\n"
+    "    while (position < numberOfInsideModels && insideModels[position] > model)\n"
+    "    {\n"
+    "      position++;\n"
+    "    }\n"
+    "    if (position < numberOfInsideModels && insideModels[position] == model)\n"
+    "    {\n"
+    "      // we were already inside this model, so now we are out\n"
+    "      for (int j = position; j + 1 < numberOfInsideModels; j++)\n"
+    "      {\n"
+    "        insideModels[j] = insideModels[j + 1];\n"
+    "      }\n"
+    "      numberOfInsideModels--;\n"
+    "    }\n"
+    "    else\n"
+    "    {\n"
+    "      for (int j = numberOfInsideModels; j > position; j--)\n"
+    "      {\n"
+    "        insideModels[j] = insideModels[j - 1];\n"
+    "      }\n"
+    "      insideModels[position] = model;\n"
+    "      numberOfInsideModels++;\n"
+    "    }\n"
+    "    if (numberOfInsideModels == 0)\n"
+    "    {\n"
+    "      atomic_or(status, STATUS_SEGMENT_WITHOUT_MODEL);\n"
+    "    }\n"
+    "    else\n"
+    "    {\n"
+    "      lineModels[i] = insideModels[0];\n"
+    "    }\n"
+    "  }\n"
+    "\n"
+    "  int numberOfSegments = 0;\n"
+    "  int currentPixelIndex = 0;\n"
+    "  float incomingBeamIntensity = incomingIntensity;\n"
+    "  float previousModelAcousticImpedanceMegarayls = transducerAcousticImpedanceMegarayls;\n"
+    "  for (int intersectionIndex = 0; intersectionIndex <= numberOfIntersections && currentPixelIndex < numberOfSamplesPerScanLine; intersectionIndex++)\n"
+    "  {\n"
+    "    int endOfSegmentPixelIndex = numberOfSamplesPerScanLine;\n"
+    "    if (intersectionIndex + 1 < numberOfIntersections)\n"
+    "    {\n"
+    "      endOfSegmentPixelIndex = min((int)(lineIntersections[intersectionIndex + 1].x / distanceBetweenScanlineSamplePointsMm), numberOfSamplesPerScanLine);\n"
+    "    }\n"
+    "    int numberOfFilledPixels = endOfSegmentPixelIndex - currentPixelIndex;\n"
+    "    if (numberOfFilledPixels < 1)\n"
+    "    {\n"
+    "      continue;\n"
+    "    }\n"
+    "    int segmentIntersectionIndex = min(intersectionIndex, numberOfIntersections - 1);\n"
+    "    Material material = materials[lineModels[segmentIntersectionIndex]];\n"
+    "    float incidenceAngleRad = lineIntersections[segmentIntersectionIndex].y;\n"
+    "\n"
+    "    // Reflection from the surface of the previous and this model\n"
+    "    float impedanceDifference = previousModelAcousticImpedanceMegarayls - material.AcousticImpedanceMegarayls;\n"
+    "    float impedanceSum = previousModelAcousticImpedanceMegarayls + material.AcousticImpedanceMegarayls;\n"
+    "    float surfaceReflectedBeamIntensity = incomingBeamIntensity * impedanceDifference * impedanceDifference / (impedanceSum * impedanceSum);\n"
+    "    float surfaceTransmittedBeamIntensity = incomingBeamIntensity - surfaceReflectedBeamIntensity;\n"
+    "    float surfaceReflectedIntensity = material.SurfaceDiffuseReflectionCoefficient * surfaceReflectedBeamIntensity;\n"
+    "    if (material.SurfaceSpecularReflectionCoefficient > 0)\n"
+    "    {\n"
+    "      if (incidenceAngleRad > M_PI_F / 2)\n"
+    "      {\n"
+    "        incidenceAngleRad -= M_PI_F;\n"
+    "      }\n"
+    "      else if (incidenceAngleRad < -M_PI_F / 2)\n"
+    "      {\n"
+    "        incidenceAngleRad += M_PI_F;\n"
+    "      }\n"
+    "      float reflectionDirectionFactor = exp(-(incidenceAngleRad * incidenceAngleRad) / (SPECULAR_REFLECTION_BRDF_STDEV_RAD * SPECULAR_REFLECTION_BRDF_STDEV_RAD));\n"
+    "      surfaceReflectedIntensity += reflectionDirectionFactor * material.SurfaceSpecularReflectionCoefficient * surfaceReflectedBeamIntensity;\n"
+    "    }\n"
+    "\n"
+    "    // Attenuation within this model\n"
+    "    float intensityAttenuatedFractionPerPixel = 1.0f - material.IntensityAttenuationCoefficientPerPixel;\n"
+    "    float intensityTransmittedFractionPerPixelTwoWay = material.IntensityAttenuationCoefficientPerPixel * material.IntensityAttenuationCoefficientPerPixel;\n"
+    "    float transmittedIntensity = surfaceTransmittedBeamIntensity * intensityTransmittedFractionPerPixelTwoWay;\n"
+    "    int numberOfBackscatteringPixels = 0;\n"
+    "    float backscatteredIntensity = 0.0f;\n"
+    "    if (transmittedIntensity > MINIMUM_BEAM_INTENSITY)\n"
+    "    {\n"
+    "      numberOfBackscatteringPixels = numberOfFilledPixels;\n"
+    "      if (intensityTransmittedFractionPerPixelTwoWay < 1.0f)\n"
+    "      {\n"
+    "        float numberOfIterations = floor(log(MINIMUM_BEAM_INTENSITY / transmittedIntensity) / log(intensityTransmittedFractionPerPixelTwoWay)) + 1;\n"
+    "        numberOfBackscatteringPixels = (int)clamp(numberOfIterations, 0.0f, (float)numberOfFilledPixels);\n"
+    "      }\n"
+    "      backscatteredIntensity = transmittedIntensity * intensityAttenuatedFractionPerPixel * material.BackscatterDiffuseReflectionCoefficient;\n"
+    "      transmittedIntensity *= pown(intensityTransmittedFractionPerPixelTwoWay, numberOfBackscatteringPixels);\n"
+    "    }\n"
+    "    else\n"
+    "    {\n"
+    "      transmittedIntensity = 0.0f;\n"
+    "    }\n"
+    "\n"
+    "    int numberOfSurfaceReflectionPixels = 0;\n"
+    "    if (surfaceReflectedIntensity > MINIMUM_BEAM_INTENSITY)\n"
+    "    {\n"
+    "      numberOfSurfaceReflectionPixels = numberOfFilledPixels;\n"
+    "      if (material.SurfaceReflectionIntensityDecayPerPixel < 1.0f)\n"
+    "      {\n"
+    "        float numberOfIterations = floor(log(MINIMUM_BEAM_INTENSITY / surfaceReflectedIntensity) / log(material.SurfaceReflectionIntensityDecayPerPixel)) + 1;\n"
+    "        numberOfSurfaceReflectionPixels = (int)clamp(numberOfIterations, 0.0f, (float)numberOfFilledPixels);\n"
+    "      }\n"
+    "    }\n"
+    "\n"
+    "    Segment segment;\n"
+    "    segment.StartPixel = currentPixelIndex;\n"
+    "    segment.EndPixel = endOfSegmentPixelIndex;\n"
+    "    segment.BackscatteredIntensity = backscatteredIntensity;\n"
+    "    segment.TransmittedFractionPerPixelTwoWay = intensityTransmittedFractionPerPixelTwoWay;\n"
+    "    segment.NumberOfBackscatteringPixels = numberOfBackscatteringPixels;\n"
+    "    segment.SurfaceReflectedIntensity = surfaceReflectedIntensity;\n"
+    "    segment.SurfaceReflectionIntensityDecayPerPixel = material.SurfaceReflectionIntensityDecayPerPixel;\n"
+    "    segment.NumberOfSurfaceReflectionPixels = numberOfSurfaceReflectionPixels;\n"
+    "    lineSegments[numberOfSegments++] = segment;\n"
+    "\n"
+    "    previousModelAcousticImpedanceMegarayls = material.AcousticImpedanceMegarayls;\n"
+    "    incomingBeamIntensity = transmittedIntensity;\n"
+    "    currentPixelIndex = endOfSegmentPixelIndex;\n"
+    "  }\n"
+    "  segmentCounts[line] = numberOfSegments;\n"
+    "}\n"
+    "\n"
+    "// Same approximation of pow as fastPow in vtkPlusUsSimulatorAlgo, which computes with the exponent and upper mantissa bits of a double\n"
+    "inline float FastPow(float a, float b)\n"
+    "{\n"
+    "  if (a <= 0.0f)\n"
+    "  {\n"
+    "    return 0.0f;\n"
+    "  }\n"
+    "  int bits = as_int(a);\n"
+    "  int highWord = (((bits >> 23) + (1023 - 127)) << 20) | ((bits & 0x7FFFFF) >> 3);\n"
+    "  int resultHighWord = (int)(b * (float)(highWord - 1072632447)) + 1072632447;\n"
+    "  int exponent = (resultHighWord >> 20) - (1023 - 127);\n"
+    "  if (exponent <= 0)\n"
+    "  {\n"
+    "    return 0.0f;\n"
+    "  }\n"
+    "  if (exponent >= 255)\n"
+    "  {\n"
+    "    return INFINITY;\n"
+    "  }\n"
+    "  return as_float((exponent << 23) | ((resultHighWord & 0xFFFFF) << 3));\n"
+    "}\n"
+    "\n"
+    "// Permutation table of the improved Perlin noise\n"
+    "__constant uchar PERMUTATION[256] =\n"
+    "{\n"
+    "  151, 160, 137, 91, 90, 15, 131, 13, 201, 95, 96, 53, 194, 233, 7, 225,\n"
+    "  140, 36, 103, 30, 69, 142, 8, 99, 37, 240, 21, 10, 23, 190, 6, 148,\n"
+    "  247, 120, 234, 75, 0, 26, 197, 62, 94, 252, 219, 203, 117, 35, 11, 32,\n"
+    "  57, 177, 33, 88, 237, 149, 56, 87, 174, 20, 125, 136, 171, 168, 68, 175,\n"
+    "  74, 165, 71, 134, 139, 48, 27, 166, 77, 146, 158, 231, 83, 111, 229, 122,\n"
+    "  60, 211, 133, 230, 220, 105, 92, 41, 55, 46, 245, 40, 244, 102, 143, 54,\n"
+    "  65, 25, 63, 161, 1, 216, 80, 73, 209, 76, 132, 187, 208, 89, 18, 169,\n"
+    "  200, 196, 135, 130, 116, 188, 159, 86, 164, 100, 109, 198, 173, 186, 3, 64,\n"
+    "  52, 217, 226, 250, 124, 123, 5, 202, 38, 147, 118, 126, 255, 82, 85, 212,\n"
+    "  207, 206, 59, 227, 47, 16, 58, 17, 182, 189, 28, 42, 223, 183, 170, 213,\n"
+    "  119, 248, 152, 2, 44, 154, 163, 70, 221, 153, 101, 155, 167, 43, 172, 9,\n"
+    "  129, 22, 39, 253, 19, 98, 108, 110, 79, 113, 224, 232, 178, 185, 112, 104,\n"
+    "  218, 246, 97, 228, 251, 34, 242, 193, 238, 210, 144, 12, 191, 179, 162, 241,\n"
+    "  81, 51, 145, 235, 249, 14, 239, 107, 49, 192, 214, 31, 181, 199, 106, 157,\n"
+    "  184, 84, 204, 176, 115, 121, 50, 45, 127, 4, 150, 254, 138, 236, 205, 93,\n"
+    "  222, 114, 67, 29, 24, 72, 243, 141, 128, 195, 78, 66, 215, 61, 156, 180\n"
+    "};\n"
+    "\n"
+    "inline float Fade(float t)\n"
+    "{\n"
+    "  return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);\n"
+    "}\n"
+    "\n"
+    "inline float Gradient(int hash, float x, float y, float z)\n"
+    "{\n"
+    "  int h = hash & 15;\n"
+    "  float u = h < 8 ? x : y;\n"
+    "  float v = h < 4 ? y : (h == 12 || h == 14 ? x : z);\n"
+    "  return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);\n"
+    "}\n"
+    "\n"
+    "inline int Permute(int i)\n"
+    "{\n"
+    "  return PERMUTATION[i & 255];\n"
+    "}\n"
+    "\n"
+    "// Improved Perlin noise (K. Perlin, 2002)\n"
+    "inline float PerlinNoise(float3 position)\n"
+    "{\n"
+    "  float3 cell = floor(position);\n"
+    "  int X = (int)cell.x & 255;\n"
+    "  int Y = (int)cell.y & 255;\n"
+    "  int Z = (int)cell.z & 255;\n"
+    "  float x = position.x - cell.x;\n"
+    "  float y = position.y - cell.y;\n"
+    "  float z = position.z - cell.z;\n"
+    "  float u = Fade(x);\n"
+    "  float v = Fade(y);\n"
+    "  float w = Fade(z);\n"
+    "  int A = Permute(X) + Y;\n"
+    "  int AA = Permute(A) + Z;\n"
+    "  int AB = Permute(A + 1) + Z;\n"
+    "  int B = Permute(X + 1) + Y;\n"
+    "  int BA = Permute(B) + Z;\n"
+    "  int BB = Permute(B + 1) + Z;\n"
+    "  return mix(mix(mix(Gradient(Permute(AA), x, y, z), Gradient(Permute(BA), x - 1, y, z), u),\n"
+    "                 mix(Gradient(Permute(AB), x, y - 1, z), Gradient(Permute(BB), x - 1, y - 1, z), u), v),\n"
+    "             mix(mix(Gradient(Permute(AA + 1), x, y, z - 1), Gradient(Permute(BA + 1), x - 1, y, z - 1), u),\n"
+    "                 mix(Gradient(Permute(AB + 1), x, y - 1, z - 1), Gradient(Permute(BB + 1), x - 1, y - 1, z - 1), u), v), w);\n"
+    "}\n"
+    "\n"
+    "// Intensity of each pixel from the segment that contains it, noise and brightness conversion\n"
+    "__kernel void ComputePixels(__global const Segment* segments, __global const int* segmentCounts,\n"
+    "  __global const float* scanLineStartPoints, __global const float* scanLineEndPoints, __global uchar* scanLines,\n"
+    "  float brightnessConversionOffset, float brightnessConversionScale, float brightnessConversionGamma,\n"
+    "  float noiseAmplitude, float4 noiseFrequency, float4 noisePhase)\n"
+    "{\n"
+    "  int pixel = get_global_id(0);\n"
+    "  int line = get_global_id(1);\n"
+    "  int numberOfSamplesPerScanLine = get_global_size(0);\n"
+    "  __global const Segment* lineSegments = segments + line * (MAXIMUM_NUMBER_OF_INTERSECTIONS + 1);\n"
+    "  int numberOfSegments = segmentCounts[line];\n"
+    "  int segmentIndex = 0;\n"
+    "  while (segmentIndex < numberOfSegments && lineSegments[segmentIndex].EndPixel <= pixel)\n"
+    "  {\n"
+    "    segmentIndex++;\n"
+    "  }\n"
+    "  if (segmentIndex >= numberOfSegments || lineSegments[segmentIndex].StartPixel > pixel)\n"
+    "  {\n"
+    "    // not simulated\n"
+    "    scanLines[line * numberOfSamplesPerScanLine + pixel] = 0;\n"
+    "    return;\n"
+    "  }\n"
+    "\n"
+    "  Segment segment = lineSegments[segmentIndex];\n"
+    "  int pixelInSegment = pixel - segment.StartPixel;\n"
+    "  float intensity = 0.0f;\n"
+    "  if (pixelInSegment < segment.NumberOfBackscatteringPixels)\n"
+    "  {\n"
+    "    intensity = segment.BackscatteredIntensity * pown(segment.TransmittedFractionPerPixelTwoWay, pixelInSegment);\n"
+    "  }\n"
+    "  if (pixelInSegment < segment.NumberOfSurfaceReflectionPixels)\n"
+    "  {\n"
+    "    intensity += segment.SurfaceReflectedIntensity * pown(segment.SurfaceReflectionIntensityDecayPerPixel, pixelInSegment);\n"
+    "  }\n"
+    "  float value = brightnessConversionOffset + brightnessConversionScale * FastPow(intensity, brightnessConversionGamma);\n"
+    "  if (noiseAmplitude > 0.0f)\n"
+    "  {\n"
+    "    float3 startPoint = vload3(line, scanLineStartPoints);\n"
+    "    float3 samplePointStep = (vload3(line, scanLineEndPoints) - startPoint) / max(numberOfSamplesPerScanLine - 1, 1);\n"
+    "    float3 samplePoint = startPoint + pixel * samplePointStep;\n"
+    "    value += noiseAmplitude * PerlinNoise(samplePoint * noiseFrequency.xyz - noisePhase.xyz * 2.0f);\n"
+    "  }\n"
+    "  scanLines[line * numberOfSamplesPerScanLine + pixel] = convert_uchar_sat(clamp(value, 0.0f, 255.0f));\n"
+    "}\n";
+
+  /*! Triangle in single precision, same layout as in the kernel source */
+  struct DeviceTriangle
+  {
+    cl_float Vertex0[3];
+    cl_float Edge1[3];
+    cl_float Edge2[3];
+    cl_int PointIds[3];
+  };
+
+  /*! PlusSpatialModel::IntensityParameters in single precision, same layout as in the kernel source */
+  struct DeviceMaterial
+  {
+    cl_float AcousticImpedanceMegarayls;
+    cl_float IntensityAttenuationCoefficientPerPixel;
+    cl_float BackscatterDiffuseReflectionCoefficient;
+    cl_float SurfaceDiffuseReflectionCoefficient;
+    cl_float SurfaceSpecularReflectionCoefficient;
+    cl_float SurfaceReflectionIntensityDecayPerPixel;
+  };
+
+  /*! Size of a segment descriptor in the kernel source */
+  const size_t DEVICE_SEGMENT_SIZE = 8 * sizeof(cl_int);
+
+  /*! Kernels of the simulation program, indices of Program::Kernels */
+  enum KernelIndex
+  {
+    ADD_BACKGROUND_MODEL_KERNEL,
+    INTERSECT_MODEL_KERNEL,
+    COMPUTE_SEGMENTS_KERNEL,
+    COMPUTE_PIXELS_KERNEL,
+    NUMBER_OF_KERNELS
+  };
+  const char* const KERNEL_NAMES[NUMBER_OF_KERNELS] = { "AddBackgroundModel", "IntersectModel", "ComputeSegments", "ComputePixels" };
+
+  typedef PlusOpenCL::Buffer Buffer;
+
+  /*! Surface of a model on the device */
+  struct DeviceModel
+  {
+    /*! Hierarchy that is currently on the device (kept to detect changes, as hierarchies are never modified) */
+    std::shared_ptr<const PlusTriangleBvh> UploadedTriangleBvh;
+    Buffer Nodes;
+    Buffer Triangles;
+    Buffer Normals;
+  };
+}
+
+//----------------------------------------------------------------------------
+class vtkPlusUsSimulatorAlgoOpenCL::vtkInternal : public PlusOpenCL
+{
+public:
+  vtkInternal()
+    : PlusOpenCL("ultrasound simulation")
+  {
+  }
+
+  virtual ~vtkInternal()
+  {
+    for (std::vector<DeviceModel>::iterator modelIt = this->Models.begin(); modelIt != this->Models.end(); ++modelIt)
+    {
+      this->ReleaseModel(*modelIt);
+    }
+    Buffer* buffers[] = { &this->SearchLinesBuffer, &this->ScanLineStartPointsBuffer, &this->ScanLineEndPointsBuffer, &this->MaterialsBuffer,
+                          &this->IntersectionsBuffer, &this->IntersectionModelsBuffer, &this->IntersectionCountsBuffer,
+                          &this->SegmentsBuffer, &this->SegmentCountsBuffer, &this->StatusBuffer, &this->ScanLinesBuffer
+                        };
+    for (size_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++)
+    {
+      this->ReleaseBuffer(*buffers[i]);
+    }
+    this->ReleaseProgram(this->SimulationProgram);
+  }
+
+  void ReleaseModel(DeviceModel& model)
+  {
+    this->ReleaseBuffer(model.Nodes);
+    this->ReleaseBuffer(model.Triangles);
+    this->ReleaseBuffer(model.Normals);
+    model.UploadedTriangleBvh.reset();
+  }
+
+  /*! Compile the kernels */
+  PlusStatus BuildProgram();
+
+  /*! Upload the surface of the model if it has changed since the last upload */
+  PlusStatus UpdateDeviceModel(DeviceModel& deviceModel, PlusSpatialModel& spatialModel);
+
+  PlusOpenCL::Program SimulationProgram;
+
+  /*! Surfaces of the spatial models, in the same order as the models */
+  std::vector<DeviceModel> Models;
+
+  Buffer SearchLinesBuffer;
+  Buffer ScanLineStartPointsBuffer;
+  Buffer ScanLineEndPointsBuffer;
+  Buffer MaterialsBuffer;
+  Buffer IntersectionsBuffer;
+  Buffer IntersectionModelsBuffer;
+  Buffer IntersectionCountsBuffer;
+  Buffer SegmentsBuffer;
+  Buffer SegmentCountsBuffer;
+  Buffer StatusBuffer;
+  Buffer ScanLinesBuffer;
+
+  /*! Host copies of the per-frame inputs, kept until the uploads are finished */
+  std::vector<cl_float> SearchLines;
+  std::vector<cl_float> ScanLineStartPoints;
+  std::vector<cl_float> ScanLineEndPoints;
+  std::vector<DeviceMaterial> Materials;
+};
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusUsSimulatorAlgoOpenCL::vtkInternal::BuildProgram()
+{
+  std::ostringstream options;
+  options << "-D MAXIMUM_NUMBER_OF_INTERSECTIONS=" << MAXIMUM_NUMBER_OF_INTERSECTIONS
+          << " -D MAXIMUM_NUMBER_OF_MODELS=" << MAXIMUM_NUMBER_OF_MODELS
+          << " -D MAXIMUM_STACK_SIZE=" << MAXIMUM_STACK_SIZE;
+
+  return PlusOpenCL::BuildProgram(KERNEL_SOURCE, options.str(), KERNEL_NAMES, NUMBER_OF_KERNELS, this->SimulationProgram);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusUsSimulatorAlgoOpenCL::vtkInternal::UpdateDeviceModel(DeviceModel& deviceModel, PlusSpatialModel& spatialModel)
+{
+  std::shared_ptr<const PlusTriangleBvh> triangleBvh = spatialModel.GetTriangleBvh();
+  if (triangleBvh == deviceModel.UploadedTriangleBvh)
+  {
+    return PLUS_SUCCESS;
+  }
+  this->ReleaseModel(deviceModel);
+  if (triangleBvh == NULL)
+  {
+    // the model is not loaded, it has no intersections
+    return PLUS_SUCCESS;
+  }
+  if (triangleBvh->GetDepth() + 1 >= MAXIMUM_STACK_SIZE)
+  {
+    LOG_ERROR("OpenCL ultrasound simulation failed: the triangle hierarchy of model " << spatialModel.GetName() << " is too deep");
+    return PLUS_FAIL;
+  }
+  vtkDataArray* normals = spatialModel.GetSurfaceNormals();
+  if (normals == NULL)
+  {
+    LOG_ERROR("OpenCL ultrasound simulation failed: surface normals of model " << spatialModel.GetName() << " are not available");
+    return PLUS_FAIL;
+  }
+
+  const std::vector<PlusTriangleBvh::Triangle>& triangles = triangleBvh->GetTriangles();
+  std::vector<DeviceTriangle> deviceTriangles(triangles.size());
+  for (size_t triangleIndex = 0; triangleIndex < triangles.size(); triangleIndex++)
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      deviceTriangles[triangleIndex].Vertex0[i] = static_cast<cl_float>(triangles[triangleIndex].Vertex0[i]);
+      deviceTriangles[triangleIndex].Edge1[i] = static_cast<cl_float>(triangles[triangleIndex].Edge1[i]);
+      deviceTriangles[triangleIndex].Edge2[i] = static_cast<cl_float>(triangles[triangleIndex].Edge2[i]);
+      deviceTriangles[triangleIndex].PointIds[i] = static_cast<cl_int>(triangles[triangleIndex].PointIds[i]);
+    }
+  }
+  std::vector<cl_float> deviceNormals(normals->GetNumberOfTuples() * 3);
+  for (vtkIdType pointIndex = 0; pointIndex < normals->GetNumberOfTuples(); pointIndex++)
+  {
+    double normal[3] = { 0, 0, 0 };
+    normals->GetTuple(pointIndex, normal);
+    for (int i = 0; i < 3; i++)
+    {
+      deviceNormals[pointIndex * 3 + i] = static_cast<cl_float>(normal[i]);
+    }
+  }
+
+  // The geometry is uploaded only when the model is loaded, so a blocking upload is used to avoid keeping the host copies
+  const std::vector<PlusTriangleBvh::Node>& nodes = triangleBvh->GetNodes();
+  size_t nodesSize = nodes.size() * sizeof(PlusTriangleBvh::Node);
+  size_t trianglesSize = deviceTriangles.size() * sizeof(DeviceTriangle);
+  size_t normalsSize = deviceNormals.size() * sizeof(cl_float);
+  if (this->UploadBuffer(deviceModel.Nodes, &nodes[0], nodesSize, CL_TRUE) != PLUS_SUCCESS
+      || this->UploadBuffer(deviceModel.Triangles, &deviceTriangles[0], trianglesSize, CL_TRUE) != PLUS_SUCCESS
+      || this->UploadBuffer(deviceModel.Normals, deviceNormals.empty() ? NULL : &deviceNormals[0], normalsSize, CL_TRUE) != PLUS_SUCCESS)
+  {
+    this->ReleaseModel(deviceModel);
+    return PLUS_FAIL;
+  }
+  deviceModel.UploadedTriangleBvh = triangleBvh;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusUsSimulatorAlgoOpenCL::vtkPlusUsSimulatorAlgoOpenCL()
+  : Internal(new vtkInternal)
+{
+}
+
+//----------------------------------------------------------------------------
+vtkPlusUsSimulatorAlgoOpenCL::~vtkPlusUsSimulatorAlgoOpenCL()
+{
+  delete this->Internal;
+  this->Internal = NULL;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusUsSimulatorAlgoOpenCL::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Device: " << (this->IsInitialized() ? this->Internal->GetDeviceName() : std::string("(not initialized)")) << "\n";
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusUsSimulatorAlgoOpenCL::Initialize()
+{
+  if (this->IsInitialized())
+  {
+    return PLUS_SUCCESS;
+  }
+
+  if (this->Internal->CreateCommandQueue() != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  if (this->Internal->BuildProgram() != PLUS_SUCCESS)
+  {
+    // Release everything that is created so far, so that the simulator stays uninitialized and Initialize can be retried
+    this->Internal->ReleaseProgram(this->Internal->SimulationProgram);
+    this->Internal->ReleaseCommandQueue();
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusUsSimulatorAlgoOpenCL::IsInitialized() const
+{
+  return this->Internal->IsInitialized();
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusUsSimulatorAlgoOpenCL::GetDeviceName() const
+{
+  return this->Internal->GetDeviceName();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusUsSimulatorAlgoOpenCL::SimulateScanLines(const SimulationParameters& parameters, const double* scanLineStartPoints_Reference, const double* scanLineEndPoints_Reference,
+    std::vector<PlusSpatialModel>& spatialModels, PlusSpatialModel& transducerSpatialModel, vtkImageData* scanLines)
+{
+  if (!this->IsInitialized())
+  {
+    LOG_ERROR("OpenCL ultrasound simulation failed: the device is not initialized");
+    return PLUS_FAIL;
+  }
+  if (scanLines == NULL || scanLines->GetScalarType() != VTK_UNSIGNED_CHAR || scanLines->GetNumberOfScalarComponents() != 1
+      || scanLines->GetNumberOfPoints() != static_cast<vtkIdType>(parameters.NumberOfScanlines) * parameters.NumberOfSamplesPerScanline)
+  {
+    LOG_ERROR("OpenCL ultrasound simulation failed: invalid output image");
+    return PLUS_FAIL;
+  }
+  if (spatialModels.size() > static_cast<size_t>(MAXIMUM_NUMBER_OF_MODELS))
+  {
+    LOG_ERROR("OpenCL ultrasound simulation failed: at most " << MAXIMUM_NUMBER_OF_MODELS << " spatial models are supported");
+    return PLUS_FAIL;
+  }
+  if (parameters.NumberOfScanlines < 1 || parameters.NumberOfSamplesPerScanline < 1)
+  {
+    return PLUS_SUCCESS;
+  }
+  vtkInternal* internal = this->Internal;
+  const size_t numberOfScanLines = static_cast<size_t>(parameters.NumberOfScanlines);
+  const size_t numberOfPixels = numberOfScanLines * parameters.NumberOfSamplesPerScanline;
+
+  // Model surfaces, materials and search lines (start point, end point in the Model coordinate system, length in the Reference coordinate system)
+  internal->Models.resize(spatialModels.size());
+  internal->Materials.resize(std::max<size_t>(spatialModels.size(), 1));
+  internal->SearchLines.assign(spatialModels.size() * numberOfScanLines * 8, 0.0f);
+  vtkSmartPointer<vtkMatrix4x4> referenceToModelMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  for (size_t modelIndex = 0; modelIndex < spatialModels.size(); modelIndex++)
+  {
+    PlusSpatialModel& spatialModel = spatialModels[modelIndex];
+    PlusSpatialModel::IntensityParameters intensityParameters;
+    spatialModel.GetIntensityParameters(parameters.DistanceBetweenScanlineSamplePointsMm, intensityParameters);
+    DeviceMaterial& material = internal->Materials[modelIndex];
+    material.AcousticImpedanceMegarayls = static_cast<cl_float>(intensityParameters.AcousticImpedanceMegarayls);
+    material.IntensityAttenuationCoefficientPerPixel = static_cast<cl_float>(intensityParameters.IntensityAttenuationCoefficientPerPixel);
+    material.BackscatterDiffuseReflectionCoefficient = static_cast<cl_float>(intensityParameters.BackscatterDiffuseReflectionCoefficient);
+    material.SurfaceDiffuseReflectionCoefficient = static_cast<cl_float>(intensityParameters.SurfaceDiffuseReflectionCoefficient);
+    material.SurfaceSpecularReflectionCoefficient = static_cast<cl_float>(intensityParameters.SurfaceSpecularReflectionCoefficient);
+    material.SurfaceReflectionIntensityDecayPerPixel = static_cast<cl_float>(intensityParameters.SurfaceReflectionIntensityDecayPerPixel);
+
+    if (spatialModel.IsBackground())
+    {
+      continue;
+    }
+    if (internal->UpdateDeviceModel(internal->Models[modelIndex], spatialModel) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    // The search line starts TransducerSpatialModelMaxOverlapMm before the scanline start point
+    spatialModel.GetReferenceToModelTransform(referenceToModelMatrix);
+    double overlapMm = spatialModel.GetTransducerSpatialModelMaxOverlapMm();
+    for (size_t lineIndex = 0; lineIndex < numberOfScanLines; lineIndex++)
+    {
+      const double* startPoint_Reference = scanLineStartPoints_Reference + lineIndex * 3;
+      const double* endPoint_Reference = scanLineEndPoints_Reference + lineIndex * 3;
+      double direction_Reference[3] = { endPoint_Reference[0] - startPoint_Reference[0], endPoint_Reference[1] - startPoint_Reference[1], endPoint_Reference[2] - startPoint_Reference[2] };
+      double lengthMm = std::sqrt(direction_Reference[0] * direction_Reference[0] + direction_Reference[1] * direction_Reference[1] + direction_Reference[2] * direction_Reference[2]);
+      double searchLineStartPoint_Reference[4] = { 0, 0, 0, 1 };
+      double searchLineEndPoint_Reference[4] = { endPoint_Reference[0], endPoint_Reference[1], endPoint_Reference[2], 1 };
+      for (int i = 0; i < 3; i++)
+      {
+        searchLineStartPoint_Reference[i] = startPoint_Reference[i] - overlapMm * direction_Reference[i] / lengthMm;
+      }
+      double searchLineStartPoint_Model[4] = { 0, 0, 0, 1 };
+      double searchLineEndPoint_Model[4] = { 0, 0, 0, 1 };
+      referenceToModelMatrix->MultiplyPoint(searchLineStartPoint_Reference, searchLineStartPoint_Model);
+      referenceToModelMatrix->MultiplyPoint(searchLineEndPoint_Reference, searchLineEndPoint_Model);
+      cl_float* searchLine = &internal->SearchLines[(modelIndex * numberOfScanLines + lineIndex) * 8];
+      for (int i = 0; i < 3; i++)
+      {
+        searchLine[i] = static_cast<cl_float>(searchLineStartPoint_Model[i]);
+        searchLine[3 + i] = static_cast<cl_float>(searchLineEndPoint_Model[i]);
+      }
+      searchLine[6] = static_cast<cl_float>(lengthMm + overlapMm);
+    }
+  }
+
+  internal->ScanLineStartPoints.assign(scanLineStartPoints_Reference, scanLineStartPoints_Reference + numberOfScanLines * 3);
+  internal->ScanLineEndPoints.assign(scanLineEndPoints_Reference, scanLineEndPoints_Reference + numberOfScanLines * 3);
+
+  size_t countsSize = numberOfScanLines * sizeof(cl_int);
+  if (internal->UploadBuffer(internal->SearchLinesBuffer, internal->SearchLines.empty() ? NULL : &internal->SearchLines[0], internal->SearchLines.size() * sizeof(cl_float), CL_FALSE) != PLUS_SUCCESS
+      || internal->UploadBuffer(internal->ScanLineStartPointsBuffer, &internal->ScanLineStartPoints[0], internal->ScanLineStartPoints.size() * sizeof(cl_float), CL_FALSE) != PLUS_SUCCESS
+      || internal->UploadBuffer(internal->ScanLineEndPointsBuffer, &internal->ScanLineEndPoints[0], internal->ScanLineEndPoints.size() * sizeof(cl_float), CL_FALSE) != PLUS_SUCCESS
+      || internal->UploadBuffer(internal->MaterialsBuffer, &internal->Materials[0], internal->Materials.size() * sizeof(DeviceMaterial), CL_FALSE) != PLUS_SUCCESS
+      || internal->ReserveBuffer(internal->IntersectionsBuffer, numberOfScanLines * MAXIMUM_NUMBER_OF_INTERSECTIONS * 2 * sizeof(cl_float), CL_MEM_READ_WRITE) != PLUS_SUCCESS
+      || internal->ReserveBuffer(internal->IntersectionModelsBuffer, numberOfScanLines * MAXIMUM_NUMBER_OF_INTERSECTIONS * sizeof(cl_int), CL_MEM_READ_WRITE) != PLUS_SUCCESS
+      || internal->ReserveBuffer(internal->IntersectionCountsBuffer, countsSize, CL_MEM_READ_WRITE) != PLUS_SUCCESS
+      || internal->ReserveBuffer(internal->SegmentsBuffer, numberOfScanLines * (MAXIMUM_NUMBER_OF_INTERSECTIONS + 1) * DEVICE_SEGMENT_SIZE, CL_MEM_READ_WRITE) != PLUS_SUCCESS
+      || internal->ReserveBuffer(internal->SegmentCountsBuffer, countsSize, CL_MEM_READ_WRITE) != PLUS_SUCCESS
+      || internal->ReserveBuffer(internal->StatusBuffer, sizeof(cl_int), CL_MEM_READ_WRITE) != PLUS_SUCCESS
+      || internal->ReserveBuffer(internal->ScanLinesBuffer, numberOfPixels, CL_MEM_WRITE_ONLY) != PLUS_SUCCESS
+      || internal->ClearBuffer(internal->IntersectionCountsBuffer) != PLUS_SUCCESS
+      || internal->ClearBuffer(internal->StatusBuffer) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  // Intersections with the models, appended in the order of the models (the kernels are executed in order)
+  size_t lineWorkSize[1] = { numberOfScanLines };
+  for (size_t modelIndex = 0; modelIndex < spatialModels.size(); modelIndex++)
+  {
+    cl_int error = CL_SUCCESS;
+    cl_int deviceModelIndex = static_cast<cl_int>(modelIndex);
+    if (spatialModels[modelIndex].IsBackground())
+    {
+      cl_kernel kernel = internal->SimulationProgram.Kernels[ADD_BACKGROUND_MODEL_KERNEL];
+      error |= PlusOpenCL::SetKernelArg(kernel, 0, internal->IntersectionsBuffer.Handle);
+      error |= PlusOpenCL::SetKernelArg(kernel, 1, internal->IntersectionModelsBuffer.Handle);
+      error |= PlusOpenCL::SetKernelArg(kernel, 2, internal->IntersectionCountsBuffer.Handle);
+      error |= PlusOpenCL::SetKernelArg(kernel, 3, internal->StatusBuffer.Handle);
+      error |= PlusOpenCL::SetKernelArg(kernel, 4, deviceModelIndex);
+      if (internal->CheckError(error, "clSetKernelArg(AddBackgroundModel)") != PLUS_SUCCESS
+          || internal->RunKernel(kernel, 1, lineWorkSize, "AddBackgroundModel") != PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+      continue;
+    }
+    DeviceModel& deviceModel = internal->Models[modelIndex];
+    if (deviceModel.UploadedTriangleBvh == NULL)
+    {
+      // the model could not be loaded
+      continue;
+    }
+    cl_kernel kernel = internal->SimulationProgram.Kernels[INTERSECT_MODEL_KERNEL];
+    cl_int firstSearchLine = static_cast<cl_int>(modelIndex * numberOfScanLines);
+    cl_float overlapMm = static_cast<cl_float>(spatialModels[modelIndex].GetTransducerSpatialModelMaxOverlapMm());
+    error |= PlusOpenCL::SetKernelArg(kernel, 0, deviceModel.Nodes.Handle);
+    error |= PlusOpenCL::SetKernelArg(kernel, 1, deviceModel.Triangles.Handle);
+    error |= PlusOpenCL::SetKernelArg(kernel, 2, deviceModel.Normals.Handle);
+    error |= PlusOpenCL::SetKernelArg(kernel, 3, internal->SearchLinesBuffer.Handle);
+    error |= PlusOpenCL::SetKernelArg(kernel, 4, firstSearchLine);
+    error |= PlusOpenCL::SetKernelArg(kernel, 5, overlapMm);
+    error |= PlusOpenCL::SetKernelArg(kernel, 6, deviceModelIndex);
+    error |= PlusOpenCL::SetKernelArg(kernel, 7, internal->IntersectionsBuffer.Handle);
+    error |= PlusOpenCL::SetKernelArg(kernel, 8, internal->IntersectionModelsBuffer.Handle);
+    error |= PlusOpenCL::SetKernelArg(kernel, 9, internal->IntersectionCountsBuffer.Handle);
+    error |= PlusOpenCL::SetKernelArg(kernel, 10, internal->StatusBuffer.Handle);
+    if (internal->CheckError(error, "clSetKernelArg(IntersectModel)") != PLUS_SUCCESS
+        || internal->RunKernel(kernel, 1, lineWorkSize, "IntersectModel") != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+  }
+
+  // Segments between the intersections and their intensities
+  {
+    cl_int error = CL_SUCCESS;
+    cl_kernel kernel = internal->SimulationProgram.Kernels[COMPUTE_SEGMENTS_KERNEL];
+    PlusSpatialModel::IntensityParameters transducerParameters;
+    transducerSpatialModel.GetIntensityParameters(parameters.DistanceBetweenScanlineSamplePointsMm, transducerParameters);
+    cl_float transducerAcousticImpedanceMegarayls = static_cast<cl_float>(transducerParameters.AcousticImpedanceMegarayls);
+    cl_float incomingIntensity = static_cast<cl_float>(parameters.IncomingIntensityMwPerCm2 * 1000);
+    cl_int numberOfSamplesPerScanline = parameters.NumberOfSamplesPerScanline;
+    cl_float distanceBetweenScanlineSamplePointsMm = static_cast<cl_float>(parameters.DistanceBetweenScanlineSamplePointsMm);
+    error |= PlusOpenCL::SetKernelArg(kernel, 0, internal->IntersectionsBuffer.Handle);
+    error |= PlusOpenCL::SetKernelArg(kernel, 1, internal->IntersectionModelsBuffer.Handle);
+    error |= PlusOpenCL::SetKernelArg(kernel, 2, internal->IntersectionCountsBuffer.Handle);
+    error |= PlusOpenCL::SetKernelArg(kernel, 3, internal->MaterialsBuffer.Handle);
+    error |= PlusOpenCL::SetKernelArg(kernel, 4, transducerAcousticImpedanceMegarayls);
+    error |= PlusOpenCL::SetKernelArg(kernel, 5, incomingIntensity);
+    error |= PlusOpenCL::SetKernelArg(kernel, 6, numberOfSamplesPerScanline);
+    error |= PlusOpenCL::SetKernelArg(kernel, 7, distanceBetweenScanlineSamplePointsMm);
+    error |= PlusOpenCL::SetKernelArg(kernel, 8, internal->SegmentsBuffer.Handle);
+    error |= PlusOpenCL::SetKernelArg(kernel, 9, internal->SegmentCountsBuffer.Handle);
+    error |= PlusOpenCL::SetKernelArg(kernel, 10, internal->StatusBuffer.Handle);
+    if (internal->CheckError(error, "clSetKernelArg(ComputeSegments)") != PLUS_SUCCESS
+        || internal->RunKernel(kernel, 1, lineWorkSize, "ComputeSegments") != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+  }
+
+  // Pixels, noise and brightness conversion
+  {
+    cl_int error = CL_SUCCESS;
+    cl_kernel kernel = internal->SimulationProgram.Kernels[COMPUTE_PIXELS_KERNEL];
+    cl_float brightnessConversionOffset = static_cast<cl_float>(parameters.BrightnessConversionOffset);
+    cl_float brightnessConversionScale = static_cast<cl_float>(parameters.BrightnessConversionScale);
+    cl_float brightnessConversionGamma = static_cast<cl_float>(parameters.BrightnessConversionGamma);
+    cl_float noiseAmplitude = static_cast<cl_float>(std::max(parameters.NoiseAmplitude, 0.0));
+    cl_float4 noiseFrequency = { { 0, 0, 0, 0 } };
+    cl_float4 noisePhase = { { 0, 0, 0, 0 } };
+    for (int i = 0; i < 3; i++)
+    {
+      noiseFrequency.s[i] = static_cast<cl_float>(parameters.NoiseFrequency[i]);
+      noisePhase.s[i] = static_cast<cl_float>(parameters.NoisePhase[i]);
+    }
+    error |= PlusOpenCL::SetKernelArg(kernel, 0, internal->SegmentsBuffer.Handle);
+    error |= PlusOpenCL::SetKernelArg(kernel, 1, internal->SegmentCountsBuffer.Handle);
+    error |= PlusOpenCL::SetKernelArg(kernel, 2, internal->ScanLineStartPointsBuffer.Handle);
+    error |= PlusOpenCL::SetKernelArg(kernel, 3, internal->ScanLineEndPointsBuffer.Handle);
+    error |= PlusOpenCL::SetKernelArg(kernel, 4, internal->ScanLinesBuffer.Handle);
+    error |= PlusOpenCL::SetKernelArg(kernel, 5, brightnessConversionOffset);
+    error |= PlusOpenCL::SetKernelArg(kernel, 6, brightnessConversionScale);
+    error |= PlusOpenCL::SetKernelArg(kernel, 7, brightnessConversionGamma);
+    error |= PlusOpenCL::SetKernelArg(kernel, 8, noiseAmplitude);
+    error |= PlusOpenCL::SetKernelArg(kernel, 9, noiseFrequency);
+    error |= PlusOpenCL::SetKernelArg(kernel, 10, noisePhase);
+    size_t pixelWorkSize[2] = { static_cast<size_t>(parameters.NumberOfSamplesPerScanline), numberOfScanLines };
+    if (internal->CheckError(error, "clSetKernelArg(ComputePixels)") != PLUS_SUCCESS
+        || internal->RunKernel(kernel, 2, pixelWorkSize, "ComputePixels") != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+  }
+
+  // Download only the simulated scanlines and the status
+  cl_int status = 0;
+  if (internal->CheckError(clEnqueueReadBuffer(internal->GetQueue(), internal->ScanLinesBuffer.Handle, CL_FALSE, 0, numberOfPixels, scanLines->GetScalarPointer(), 0, NULL, NULL),
+                           "clEnqueueReadBuffer") != PLUS_SUCCESS
+      || internal->CheckError(clEnqueueReadBuffer(internal->GetQueue(), internal->StatusBuffer.Handle, CL_TRUE, 0, sizeof(status), &status, 0, NULL, NULL),
+                              "clEnqueueReadBuffer") != PLUS_SUCCESS)
+  {
+    // make sure that the queue does not use the host copies anymore
+    clFinish(internal->GetQueue());
+    return PLUS_FAIL;
+  }
+  scanLines->Modified();
+
+  if (status & STATUS_TOO_MANY_INTERSECTIONS)
+  {
+    LOG_WARNING("OpenCL ultrasound simulation: a scanline has more than " << MAXIMUM_NUMBER_OF_INTERSECTIONS << " intersections with the models, the farther intersections are ignored");
+  }
+  if (status & STATUS_SEGMENT_WITHOUT_MODEL)
+  {
+    LOG_ERROR("No model is defined in one segment of the scanline");
+  }
+  if (status & STATUS_NO_INTERSECTIONS)
+  {
+    LOG_ERROR("No intersections with any SpatialObjects. Probably no background object is specified.");
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
@@ -0,0 +1,93 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusUsSimulatorAlgoOpenCL_h
+#define __vtkPlusUsSimulatorAlgoOpenCL_h
+
+#include "vtkPlusUsSimulatorExport.h"
+#include "vtkObject.h"
+
+#include "PlusSpatialModel.h"
+
+#include <string>
+#include <vector>
+
+class vtkImageData;
+
+/*!
+  \class vtkPlusUsSimulatorAlgoOpenCL
+  \brief Simulates the scanlines of vtkPlusUsSimulatorAlgo on an OpenCL device
+
+  Computes the intersections of the scanlines with the spatial models, the attenuation and reflection along the scanlines,
+  the speckle noise and the brightness conversion on the device, so only the scanline positions and the material parameters
+  are uploaded and the simulated scanlines are downloaded for each frame. The surface meshes are uploaded only when
+  a model is (re)loaded. The triangle hierarchies of the models (PlusTriangleBvh) are traversed on the device
+  by one work item per scanline, the pixels are computed by one work item per pixel.
+
+  Computations are performed in single precision, therefore a few pixels may differ by one intensity level from the result
+  of the CPU simulation. The speckle is computed with the improved Perlin noise function, so the noise pattern is similar to
+  but not the same as the noise of vtkPerlinNoise.
+
+  Only available if Plus is built with PLUS_USE_OPENCL. Used by vtkPlusUsSimulatorAlgo if Backend="OpenCL" is specified.
+
+  \ingroup PlusLibUsSimulatorAlgo
+*/
+class vtkPlusUsSimulatorExport vtkPlusUsSimulatorAlgoOpenCL : public vtkObject
+{
+public:
+  /*! Parameters of the simulation, see vtkPlusUsSimulatorAlgo */
+  struct SimulationParameters
+  {
+    int NumberOfScanlines;
+    int NumberOfSamplesPerScanline;
+    double DistanceBetweenScanlineSamplePointsMm;
+    double IncomingIntensityMwPerCm2;
+    double BrightnessConversionGamma;
+    double BrightnessConversionOffset;
+    double BrightnessConversionScale;
+    /*! No noise is added if the amplitude is not positive */
+    double NoiseAmplitude;
+    double NoiseFrequency[3];
+    double NoisePhase[3];
+  };
+
+  static vtkPlusUsSimulatorAlgoOpenCL* New();
+  vtkTypeMacro(vtkPlusUsSimulatorAlgoOpenCL, vtkObject);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  /*! Select an OpenCL device (the first GPU, or any device if there is no GPU) and compile the kernels */
+  PlusStatus Initialize();
+
+  /*! Returns true if the device is initialized */
+  bool IsInitialized() const;
+
+  /*!
+    Simulate the scanlines.
+    \param scanLineStartPoints_Reference Scanline start points in the Reference coordinate system, 3 coordinates for each scanline
+    \param scanLineEndPoints_Reference Scanline end points in the Reference coordinate system, 3 coordinates for each scanline
+    \param spatialModels Models in increasing cohesiveness order, prepared for the simulation (PlusSpatialModel::PrepareForSimulation)
+    \param transducerSpatialModel Material of the transducer
+    \param scanLines Output image, the scanlines in rows (NumberOfSamplesPerScanline x NumberOfScanlines, unsigned char)
+  */
+  PlusStatus SimulateScanLines(const SimulationParameters& parameters, const double* scanLineStartPoints_Reference, const double* scanLineEndPoints_Reference,
+                               std::vector<PlusSpatialModel>& spatialModels, PlusSpatialModel& transducerSpatialModel, vtkImageData* scanLines);
+
+  /*! Name of the OpenCL device that is used for the simulation */
+  std::string GetDeviceName() const;
+
+protected:
+  vtkPlusUsSimulatorAlgoOpenCL();
+  virtual ~vtkPlusUsSimulatorAlgoOpenCL();
+
+  class vtkInternal;
+  vtkInternal* Internal;
+
+private:
+  vtkPlusUsSimulatorAlgoOpenCL(const vtkPlusUsSimulatorAlgoOpenCL&);  // Not implemented.
+  void operator=(const vtkPlusUsSimulatorAlgoOpenCL&);  // Not implemented.
+};
+
+#endif
@@ -0,0 +1,480 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file VolumeReconstructionBenchmark.cxx
+  \brief Measures the speed and accuracy of vtkPlusVolumeReconstructor on synthetic sweeps.
+
+  A smooth synthetic phantom is sampled by a linear sweep of slightly tilted frames. The frame spacing is larger than
+  the voxel size, so the reconstructed volume contains holes between the slices. The sweep is reconstructed with
+  each combination of interpolation, compounding mode, optimization, number of threads and volume size, and one
+  CSV line is written for each combination:
+  - FramesPerSec, VoxelsPerSec: slice pasting speed (voxel updates are counted: 1 per pixel for nearest neighbor, 8 for linear interpolation)
+  - ExtractSec: time of extracting the gray levels without hole filling
+  - HoleFillSec: additional time of extracting the gray levels with hole filling
+  - PeakMemoryMB: peak memory usage of the process so far
+  - PastedMeanAbsError: mean absolute difference from the phantom in the voxels where slices were pasted
+  - Holes, FilledHoles, FilledHoleMeanAbsError, FilledHoleRms: hole filling accuracy computed by vtkPlusCompareVolumes
+
+  The benchmark fails if the mean errors exceed the specified limits.
+*/
+
+#include "PlusConfigure.h"
+#include "igsioTrackedFrame.h"
+#include "vtkIGSIOTransformRepository.h"
+#include "vtkImageData.h"
+#include "vtkMatrix4x4.h"
+#include "vtkPlusCompareVolumes.h"
+#include "vtkPlusVolumeReconstructor.h"
+#include "vtkXMLDataElement.h"
+#include "vtkXMLUtilities.h"
+
+#include <vtksys/CommandLineArguments.hxx>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+  typedef std::chrono::high_resolution_clock Clock;
+
+  const double PI = 3.14159265358979323846;
+  const double PIXEL_SPACING_MM = 0.5;
+  const double FRAME_STEP_MM = 1.5;
+  const double FRAME_TILT_DEG = 5.0;
+
+  const char* INTERPOLATION_NAMES[] = { "NEAREST_NEIGHBOR", "LINEAR" };
+  const char* COMPOUNDING_NAMES[] = { "MEAN", "LATEST", "MAXIMUM" };
+  const char* OPTIMIZATION_NAMES[] = { "NONE", "PARTIAL", "FULL" };
+
+  //----------------------------------------------------------------------------
+  /*! Synthetic phantom intensity at a position (in mm), it is in the 28..228 range */
+  double GetPhantomValue(double x, double y, double z)
+  {
+    return 128.0 + 100.0 * sin(2 * PI * x / 80.0) * cos(2 * PI * y / 100.0) * sin(2 * PI * z / 120.0 + 0.5);
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Peak memory usage of the process, in megabytes */
+  double GetPeakMemoryUsageMB()
+  {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+      return 0;
+    }
+    return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+      return 0;
+    }
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0); // bytes
+#else
+    return usage.ru_maxrss / 1024.0; // kilobytes
+#endif
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Frames of a linear sweep through a volume of volumeSize^3 voxels with 1mm spacing */
+  class SyntheticSweep
+  {
+  public:
+    SyntheticSweep(int volumeSize)
+      : FrameWidth(2 * volumeSize)
+      , FrameHeight(2 * volumeSize)
+      , VolumeSize(volumeSize)
+    {
+      double tiltRad = FRAME_TILT_DEG * PI / 180.0;
+      this->CosTilt = cos(tiltRad);
+      this->SinTilt = sin(tiltRad);
+      // The frames are tilted around the X axis, the sweep is along the Z axis
+      double frameDepthMm = (this->FrameHeight - 1) * PIXEL_SPACING_MM * this->SinTilt;
+      this->NumberOfFrames = static_cast<int>(floor((volumeSize - 2 - frameDepthMm) / FRAME_STEP_MM)) + 1;
+      if (this->NumberOfFrames < 1)
+      {
+        this->NumberOfFrames = 1;
+      }
+
+      FrameSizeType frameSize = { static_cast<unsigned int>(this->FrameWidth), static_cast<unsigned int>(this->FrameHeight), 1 };
+      this->Frames.resize(this->NumberOfFrames);
+      for (int frameIndex = 0; frameIndex < this->NumberOfFrames; ++frameIndex)
+      {
+        vtkSmartPointer<vtkMatrix4x4> imageToReference = vtkSmartPointer<vtkMatrix4x4>::New();
+        imageToReference->SetElement(0, 0, PIXEL_SPACING_MM);
+        imageToReference->SetElement(1, 1, PIXEL_SPACING_MM * this->CosTilt);
+        imageToReference->SetElement(2, 1, PIXEL_SPACING_MM * this->SinTilt);
+        imageToReference->SetElement(1, 2, -PIXEL_SPACING_MM * this->SinTilt);
+        imageToReference->SetElement(2, 2, PIXEL_SPACING_MM * this->CosTilt);
+        imageToReference->SetElement(2, 3, this->GetFrameOffsetMm(frameIndex));
+        this->ImageToReferenceMatrices.push_back(imageToReference);
+
+        igsioTrackedFrame& frame = this->Frames[frameIndex];
+        frame.GetImageData()->AllocateFrame(frameSize, VTK_UNSIGNED_CHAR, 1);
+        frame.GetImageData()->SetImageOrientation(US_IMG_ORIENT_MF);
+        frame.GetImageData()->SetImageType(US_IMG_BRIGHTNESS);
+        frame.SetTimestamp(frameIndex);
+        unsigned char* pixel = static_cast<unsigned char*>(frame.GetImageData()->GetScalarPointer());
+        for (int j = 0; j < this->FrameHeight; ++j)
+        {
+          for (int i = 0; i < this->FrameWidth; ++i)
+          {
+            double y = j * PIXEL_SPACING_MM * this->CosTilt;
+            double z = j * PIXEL_SPACING_MM * this->SinTilt + this->GetFrameOffsetMm(frameIndex);
+            *(pixel++) = static_cast<unsigned char>(floor(GetPhantomValue(i * PIXEL_SPACING_MM, y, z) + 0.5));
+          }
+        }
+      }
+    }
+
+    /*! Returns true if the voxel is between the first and last frame of the sweep */
+    bool IsInsideSweep(int x, int y, int z) const
+    {
+      double j = y / (PIXEL_SPACING_MM * this->CosTilt);
+      double frameIndex = (z - j * PIXEL_SPACING_MM * this->SinTilt - this->GetFrameOffsetMm(0)) / FRAME_STEP_MM;
+      return x <= (this->FrameWidth - 1) * PIXEL_SPACING_MM && j <= this->FrameHeight - 1 && frameIndex >= 0 && frameIndex <= this->NumberOfFrames - 1;
+    }
+
+    double GetFrameOffsetMm(int frameIndex) const
+    {
+      return 1.0 + frameIndex * FRAME_STEP_MM;
+    }
+
+    int FrameWidth;
+    int FrameHeight;
+    int VolumeSize;
+    int NumberOfFrames;
+    double CosTilt;
+    double SinTilt;
+    std::vector<igsioTrackedFrame> Frames;
+    std::vector< vtkSmartPointer<vtkMatrix4x4> > ImageToReferenceMatrices;
+  };
+
+  //----------------------------------------------------------------------------
+  struct BenchmarkResult
+  {
+    double PasteSec;
+    double ExtractSec;
+    double HoleFillSec;
+    double PeakMemoryMB;
+    int PastedVoxels;
+    double PastedMeanAbsError;
+    int Holes;
+    int FilledHoles;
+    double FilledHoleMeanAbsError;
+    double FilledHoleRms;
+  };
+
+  //----------------------------------------------------------------------------
+  vtkSmartPointer<vtkXMLDataElement> CreateConfiguration(int volumeSize, const SyntheticSweep& sweep, int interpolation, int compounding,
+      int optimization, int numberOfThreads, bool parallelHoleFilling)
+  {
+    std::ostringstream config;
+    config << "<PlusConfiguration>"
+           << "<VolumeReconstruction ImageCoordinateFrame=\"Image\" ReferenceCoordinateFrame=\"Reference\""
+           << " OutputOrigin=\"0 0 0\" OutputSpacing=\"1 1 1\""
+           << " OutputExtent=\"0 " << volumeSize - 1 << " 0 " << volumeSize - 1 << " 0 " << volumeSize - 1 << "\""
+           << " ClipRectangleOrigin=\"0 0\" ClipRectangleSize=\"" << sweep.FrameWidth << " " << sweep.FrameHeight << "\""
+           << " Interpolation=\"" << INTERPOLATION_NAMES[interpolation] << "\""
+           << " CompoundingMode=\"" << COMPOUNDING_NAMES[compounding] << "\""
+           << " Optimization=\"" << OPTIMIZATION_NAMES[optimization] << "\""
+           << " NumberOfThreads=\"" << numberOfThreads << "\""
+           << " FillHoles=\"ON\" ParallelHoleFilling=\"" << (parallelHoleFilling ? "TRUE" : "FALSE") << "\">"
+           << "<HoleFilling>"
+           << "<HoleFillingElement Type=\"GAUSSIAN\" Size=\"5\" Stdev=\"1.0\" MinimumKnownVoxelsRatio=\"0.1\" />"
+           << "<HoleFillingElement Type=\"NEAREST_NEIGHBOR\" Size=\"7\" MinimumKnownVoxelsRatio=\"0.01\" />"
+           << "</HoleFilling>"
+           << "</VolumeReconstruction>"
+           << "</PlusConfiguration>";
+    return vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(config.str().c_str()));
+  }
+
+  //----------------------------------------------------------------------------
+  vtkSmartPointer<vtkImageData> CreateMask(vtkImageData* structure)
+  {
+    vtkSmartPointer<vtkImageData> mask = vtkSmartPointer<vtkImageData>::New();
+    mask->SetExtent(structure->GetExtent());
+    mask->SetOrigin(structure->GetOrigin());
+    mask->SetSpacing(structure->GetSpacing());
+    mask->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+    return mask;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus ComputeAccuracy(const SyntheticSweep& sweep, vtkImageData* unfilledVolume, vtkImageData* filledVolume, vtkImageData* accumulationBuffer, BenchmarkResult& result)
+  {
+    if (unfilledVolume->GetScalarType() != VTK_UNSIGNED_CHAR || filledVolume->GetScalarType() != VTK_UNSIGNED_CHAR
+        || accumulationBuffer->GetScalarType() != VTK_UNSIGNED_SHORT)
+    {
+      LOG_ERROR("Unexpected scalar type of the reconstructed volume or accumulation buffer");
+      return PLUS_FAIL;
+    }
+    int dims[3] = { 0, 0, 0 };
+    filledVolume->GetDimensions(dims);
+    if (dims[0] != sweep.VolumeSize || dims[1] != sweep.VolumeSize || dims[2] != sweep.VolumeSize)
+    {
+      LOG_ERROR("Unexpected reconstructed volume size: " << dims[0] << "x" << dims[1] << "x" << dims[2]);
+      return PLUS_FAIL;
+    }
+
+    vtkSmartPointer<vtkImageData> groundTruth = CreateMask(filledVolume);
+    vtkSmartPointer<vtkImageData> groundTruthAlpha = CreateMask(filledVolume);
+    vtkSmartPointer<vtkImageData> filledAlpha = CreateMask(filledVolume);
+    vtkSmartPointer<vtkImageData> slicesAlpha = CreateMask(filledVolume);
+
+    const unsigned char* unfilled = static_cast<unsigned char*>(unfilledVolume->GetScalarPointer());
+    const unsigned char* filled = static_cast<unsigned char*>(filledVolume->GetScalarPointer());
+    const unsigned short* accumulation = static_cast<unsigned short*>(accumulationBuffer->GetScalarPointer());
+    unsigned char* groundTruthPtr = static_cast<unsigned char*>(groundTruth->GetScalarPointer());
+    unsigned char* groundTruthAlphaPtr = static_cast<unsigned char*>(groundTruthAlpha->GetScalarPointer());
+    unsigned char* filledAlphaPtr = static_cast<unsigned char*>(filledAlpha->GetScalarPointer());
+    unsigned char* slicesAlphaPtr = static_cast<unsigned char*>(slicesAlpha->GetScalarPointer());
+
+    double pastedAbsErrorSum = 0;
+    result.PastedVoxels = 0;
+    vtkIdType index = 0;
+    for (int z = 0; z < dims[2]; ++z)
+    {
+      for (int y = 0; y < dims[1]; ++y)
+      {
+        for (int x = 0; x < dims[0]; ++x, ++index)
+        {
+          double expected = GetPhantomValue(x, y, z);
+          groundTruthPtr[index] = static_cast<unsigned char>(floor(expected + 0.5));
+          // Only the holes between the first and last slice are expected to be filled
+          groundTruthAlphaPtr[index] = sweep.IsInsideSweep(x, y, z) ? 255 : 0;
+          // The phantom is never 0, so 0 means that the hole could not be filled
+          filledAlphaPtr[index] = (filled[index] != 0 ? 255 : 0);
+          slicesAlphaPtr[index] = (accumulation[index] != 0 ? 255 : 0);
+          if (accumulation[index] != 0)
+          {
+            pastedAbsErrorSum += fabs(unfilled[index] - expected);
+            result.PastedVoxels++;
+          }
+        }
+      }
+    }
+    result.PastedMeanAbsError = (result.PastedVoxels > 0 ? pastedAbsErrorSum / result.PastedVoxels : 0);
+
+    vtkSmartPointer<vtkPlusCompareVolumes> compareVolumes = vtkSmartPointer<vtkPlusCompareVolumes>::New();
+    compareVolumes->SetInputGT(groundTruth);
+    compareVolumes->SetInputGTAlpha(groundTruthAlpha);
+    compareVolumes->SetInputTest(filledVolume);
+    compareVolumes->SetInputTestAlpha(filledAlpha);
+    compareVolumes->SetInputSliceAlpha(slicesAlpha);
+    compareVolumes->Update();
+    result.Holes = compareVolumes->GetNumberOfHoles();
+    result.FilledHoles = compareVolumes->GetNumberOfFilledHoles();
+    result.FilledHoleMeanAbsError = compareVolumes->GetAbsoluteMean();
+    result.FilledHoleRms = compareVolumes->GetRMS();
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus RunBenchmark(const SyntheticSweep& sweep, int interpolation, int compounding, int optimization, int numberOfThreads,
+                          bool parallelHoleFilling, BenchmarkResult& result)
+  {
+    vtkSmartPointer<vtkXMLDataElement> configRoot = CreateConfiguration(sweep.VolumeSize, sweep, interpolation, compounding, optimization,
+        numberOfThreads, parallelHoleFilling);
+    vtkSmartPointer<vtkPlusVolumeReconstructor> reconstructor = vtkSmartPointer<vtkPlusVolumeReconstructor>::New();
+    if (configRoot == NULL || reconstructor->ReadConfiguration(configRoot) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to configure the volume reconstructor");
+      return PLUS_FAIL;
+    }
+
+    vtkSmartPointer<vtkIGSIOTransformRepository> transformRepository = vtkSmartPointer<vtkIGSIOTransformRepository>::New();
+    igsioTransformName imageToReferenceTransformName("Image", "Reference");
+    Clock::time_point start = Clock::now();
+    for (int frameIndex = 0; frameIndex < sweep.NumberOfFrames; ++frameIndex)
+    {
+      transformRepository->SetTransform(imageToReferenceTransformName, sweep.ImageToReferenceMatrices[frameIndex]);
+      igsioTrackedFrame* frame = const_cast<igsioTrackedFrame*>(&sweep.Frames[frameIndex]);
+      if (reconstructor->AddTrackedFrame(frame, transformRepository, frameIndex == 0, frameIndex == sweep.NumberOfFrames - 1) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to add frame " << frameIndex << " to the volume");
+        return PLUS_FAIL;
+      }
+    }
+    result.PasteSec = std::chrono::duration<double>(Clock::now() - start).count();
+
+    vtkSmartPointer<vtkImageData> unfilledVolume = vtkSmartPointer<vtkImageData>::New();
+    reconstructor->SetFillHoles(false);
+    start = Clock::now();
+    if (reconstructor->ExtractGrayLevels(unfilledVolume) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to extract the gray levels");
+      return PLUS_FAIL;
+    }
+    result.ExtractSec = std::chrono::duration<double>(Clock::now() - start).count();
+
+    vtkSmartPointer<vtkImageData> filledVolume = vtkSmartPointer<vtkImageData>::New();
+    reconstructor->SetFillHoles(true);
+    start = Clock::now();
+    if (reconstructor->ExtractGrayLevels(filledVolume) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to extract the hole filled gray levels");
+      return PLUS_FAIL;
+    }
+    result.HoleFillSec = std::max(0.0, std::chrono::duration<double>(Clock::now() - start).count() - result.ExtractSec);
+
+    vtkSmartPointer<vtkImageData> accumulationBuffer = vtkSmartPointer<vtkImageData>::New();
+    if (reconstructor->ExtractAccumulation(accumulationBuffer) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to extract the accumulation buffer");
+      return PLUS_FAIL;
+    }
+    result.PeakMemoryMB = GetPeakMemoryUsageMB();
+
+    return ComputeAccuracy(sweep, unfilledVolume, filledVolume, accumulationBuffer, result);
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  std::vector<int> volumeSizes;
+  std::vector<int> threadCounts;
+  bool parallelHoleFilling(false);
+  double maxPastedError(6.0);
+  double maxFilledHoleError(10.0);
+  std::string outputFileName;
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--sizes", vtksys::CommandLineArguments::MULTI_ARGUMENT, &volumeSizes, "Size of the reconstructed cubic volumes, in voxels (Default: 64 128).");
+  args.AddArgument("--threads", vtksys::CommandLineArguments::MULTI_ARGUMENT, &threadCounts, "Number of threads used for reconstruction, 0 means the number of processors (Default: 1 0).");
+  args.AddArgument("--parallel-hole-filling", vtksys::CommandLineArguments::NO_ARGUMENT, &parallelHoleFilling, "Fill holes using vtkPlusFillHolesInVolume.");
+  args.AddArgument("--max-pasted-error", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &maxPastedError, "Maximum allowed mean absolute error in the pasted voxels (Default: 6).");
+  args.AddArgument("--max-hole-error", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &maxFilledHoleError, "Maximum allowed mean absolute error in the filled holes (Default: 10).");
+  args.AddArgument("--output-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &outputFileName, "CSV file where the results are written. If not specified then the results are written to the standard output.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (volumeSizes.empty())
+  {
+    volumeSizes.push_back(64);
+    volumeSizes.push_back(128);
+  }
+  if (threadCounts.empty())
+  {
+    threadCounts.push_back(1);
+    threadCounts.push_back(0);
+  }
+
+  std::ofstream outputFile;
+  if (!outputFileName.empty())
+  {
+    outputFile.open(outputFileName.c_str());
+    if (!outputFile.is_open())
+    {
+      LOG_ERROR("Failed to open output file: " << outputFileName);
+      exit(EXIT_FAILURE);
+    }
+  }
+  std::ostream& output = (outputFile.is_open() ? static_cast<std::ostream&>(outputFile) : std::cout);
+  output << "VolumeSize,Interpolation,CompoundingMode,Optimization,NumberOfThreads,ParallelHoleFilling,Frames,PasteSec,FramesPerSec,VoxelsPerSec,"
+         << "ExtractSec,HoleFillSec,PeakMemoryMB,PastedVoxels,PastedMeanAbsError,Holes,FilledHoles,FilledHoleMeanAbsError,FilledHoleRms" << std::endl;
+
+  int numberOfErrors = 0;
+  for (std::vector<int>::iterator sizeIt = volumeSizes.begin(); sizeIt != volumeSizes.end(); ++sizeIt)
+  {
+    if (*sizeIt < 8)
+    {
+      LOG_ERROR("Invalid volume size: " << *sizeIt);
+      numberOfErrors++;
+      continue;
+    }
+    SyntheticSweep sweep(*sizeIt);
+    LOG_INFO("Volume size: " << *sizeIt << "^3 voxels, " << sweep.NumberOfFrames << " frames of " << sweep.FrameWidth << "x" << sweep.FrameHeight << " pixels");
+    double pixelsPerSweep = static_cast<double>(sweep.FrameWidth) * sweep.FrameHeight * sweep.NumberOfFrames;
+
+    for (std::vector<int>::iterator threadIt = threadCounts.begin(); threadIt != threadCounts.end(); ++threadIt)
+    {
+      for (int interpolation = 0; interpolation < 2; ++interpolation)
+      {
+        for (int compounding = 0; compounding < 3; ++compounding)
+        {
+          for (int optimization = 0; optimization < 3; ++optimization)
+          {
+            BenchmarkResult result;
+            if (RunBenchmark(sweep, interpolation, compounding, optimization, *threadIt, parallelHoleFilling, result) != PLUS_SUCCESS)
+            {
+              numberOfErrors++;
+              continue;
+            }
+            double voxelUpdatesPerPixel = (interpolation == 0 ? 1.0 : 8.0);
+            output << *sizeIt << "," << INTERPOLATION_NAMES[interpolation] << "," << COMPOUNDING_NAMES[compounding] << "," << OPTIMIZATION_NAMES[optimization]
+                   << "," << *threadIt << "," << (parallelHoleFilling ? "TRUE" : "FALSE") << "," << sweep.NumberOfFrames
+                   << "," << result.PasteSec
+                   << "," << (result.PasteSec > 0 ? sweep.NumberOfFrames / result.PasteSec : 0)
+                   << "," << (result.PasteSec > 0 ? pixelsPerSweep * voxelUpdatesPerPixel / result.PasteSec : 0)
+                   << "," << result.ExtractSec << "," << result.HoleFillSec << "," << result.PeakMemoryMB
+                   << "," << result.PastedVoxels << "," << result.PastedMeanAbsError
+                   << "," << result.Holes << "," << result.FilledHoles << "," << result.FilledHoleMeanAbsError << "," << result.FilledHoleRms << std::endl;
+
+            std::string configName = std::string(INTERPOLATION_NAMES[interpolation]) + "/" + COMPOUNDING_NAMES[compounding] + "/" + OPTIMIZATION_NAMES[optimization]
+                                     + " with " + igsioCommon::ToString<int>(*threadIt) + " threads";
+            if (result.PastedMeanAbsError > maxPastedError)
+            {
+              LOG_ERROR("Mean absolute error in the pasted voxels is " << result.PastedMeanAbsError << " (maximum: " << maxPastedError << ") for " << configName);
+              numberOfErrors++;
+            }
+            if (result.FilledHoles == 0 || result.FilledHoleMeanAbsError > maxFilledHoleError)
+            {
+              LOG_ERROR("Mean absolute error in the " << result.FilledHoles << " filled holes is " << result.FilledHoleMeanAbsError
+                        << " (maximum: " << maxFilledHoleError << ") for " << configName);
+              numberOfErrors++;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("VolumeReconstructionBenchmark failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("VolumeReconstructionBenchmark completed successfully");
+  return EXIT_SUCCESS;
+}
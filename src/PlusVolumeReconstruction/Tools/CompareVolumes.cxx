@@ -114,6 +114,7 @@ int main( int argc, char** argv )
   std::vector<int> roiOriginV;
   std::vector<int> roiSizeV;
   double simpleCompareMaxError = -1;
+  bool comparePastedVoxelsOnly( false );
 
   int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
 
@@ -131,6 +132,7 @@ int main( int argc, char** argv )
   args.AddArgument( "--output-diff-volume-true", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &outputTrueDiffFileName, "Save the true difference volume to this file" );
   args.AddArgument( "--output-diff-volume-absolute", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &outputAbsoluteDiffFileName, "Save the absolute difference volume to this file" );
   args.AddArgument( "--simple-compare-max-error", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &simpleCompareMaxError, "If specified, a simple comparison of the volumes is performed (no detailed statistics are computed, only the ground truth and test volumes are used) and if the stdev of pixel values of the absolute difference image is larger than the specified value then the test returns with failure" );
+  args.AddArgument( "--compare-pasted-voxels-only", vtksys::CommandLineArguments::NO_ARGUMENT, &comparePastedVoxelsOnly, "Compute the statistics from the voxels where slices were pasted (slices alpha is nonzero) instead of the filled holes. The slices alpha may be the accumulation buffer of the reconstruction." );
   args.AddArgument( "--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)" );
   args.AddArgument( "--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help." );
 
@@ -321,6 +323,7 @@ int main( int argc, char** argv )
   histogramGenerator->SetInputTest( testingImageRoi );
   histogramGenerator->SetInputTestAlpha( testingAlphaRoi );
   histogramGenerator->SetInputSliceAlpha( slicesAlphaRoi );
+  histogramGenerator->SetCompareOnlyPastedVoxels( comparePastedVoxelsOnly );
   histogramGenerator->Update();
 
   // write data to a CSV
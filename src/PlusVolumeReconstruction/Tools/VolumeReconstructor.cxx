@@ -36,6 +36,10 @@ int main(int argc, char* argv[])
   int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
 
   bool disableCompression = false;
+  int numberOfThreads = 1;
+  int holeFillingMarginVoxels = 8;
+  bool streaming = false;
+  int streamingChunkSizeFrames = 16;
 
   vtksys::CommandLineArguments cmdargs;
   cmdargs.Initialize(argc, argv);
@@ -50,6 +54,10 @@ int main(int argc, char* argv[])
   cmdargs.AddArgument("--disable-compression", vtksys::CommandLineArguments::NO_ARGUMENT, &disableCompression, "Do not compress output image files.");
   cmdargs.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
   cmdargs.AddArgument("--importance-mask-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &importanceMaskFileName, "The file to use as the importance mask.");
+  cmdargs.AddArgument("--number-of-threads", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfThreads, "Number of threads that paste frames in parallel, each into a separate brick of the volume (default: 1, frames are pasted one by one; 0: number of processor cores).");
+  cmdargs.AddArgument("--hole-filling-margin", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &holeFillingMarginVoxels, "Overlap of the bricks in voxels if frames are pasted in parallel. Must not be smaller than the hole filling kernel size (default: 8).");
+  cmdargs.AddArgument("--streaming", vtksys::CommandLineArguments::NO_ARGUMENT, &streaming, "Read the input sequence in chunks while the frames are pasted, instead of loading the whole sequence into memory (.mha/.mhd only, other formats are loaded into memory).");
+  cmdargs.AddArgument("--streaming-chunk-size", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &streamingChunkSizeFrames, "Number of frames that are read at once in streaming mode (default: 16).");
 
   // Deprecated arguments (2013-07-29, #800)
   cmdargs.AddArgument("--transform", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputImageToReferenceTransformNameDeprecated, "Image to reference transform name used for the reconstruction. DEPRECATED, use --image-to-reference-transform argument instead");
@@ -147,15 +155,6 @@ int main(int argc, char* argv[])
   transformRepository->Print(osTransformRepo);
   LOG_DEBUG("Transform repository: \n" << osTransformRepo.str());
 
-  // Read image sequence
-  LOG_INFO("Reading image sequence " << inputImgSeqFileName);
-  vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
-  if (vtkIGSIOSequenceIO::Read(inputImgSeqFileName, trackedFrameList) != PLUS_SUCCESS)
-  {
-    LOG_ERROR("Unable to load input sequences file.");
-    exit(EXIT_FAILURE);
-  }
-
   // Reconstruct volume
   igsioTransformName imageToReferenceTransformName;
   if (!inputImageToReferenceTransformName.empty())
@@ -170,14 +169,95 @@ int main(int argc, char* argv[])
     reconstructor->SetReferenceCoordinateFrame(imageToReferenceTransformName.To());
   }
 
-  LOG_INFO("Set volume output extent...");
   std::string errorDetail;
+  if (streaming)
+  {
+    if (numberOfThreads != 1)
+    {
+      LOG_WARNING("Frames are pasted one by one in streaming mode, --number-of-threads is ignored");
+    }
+    if (!outputFrameFileName.empty())
+    {
+      LOG_WARNING("--output-frame-file is ignored in streaming mode");
+    }
+    reconstructor->SetStreamingChunkSizeFrames(streamingChunkSizeFrames);
+
+    LOG_INFO("Reconstruct volume while reading image sequence " << inputImgSeqFileName);
+    int numberOfFrames = 0;
+    int numberOfFramesAddedToVolume = 0;
+    PlusStatus status = reconstructor->ReconstructFromSequenceFile(inputImgSeqFileName, transformRepository, true, errorDetail, &numberOfFramesAddedToVolume, &numberOfFrames);
+    if (status != PLUS_SUCCESS && numberOfFramesAddedToVolume == 0)
+    {
+      LOG_ERROR("Failed to reconstruct volume from sequence file: " << errorDetail);
+      return EXIT_FAILURE;
+    }
+    if (status != PLUS_SUCCESS)
+    {
+      LOG_WARNING("Volume reconstruction is incomplete: " << errorDetail);
+    }
+
+    LOG_INFO("Number of frames added to the volume: " << numberOfFramesAddedToVolume << " out of " << numberOfFrames);
+
+    LOG_INFO("Saving volume to file...");
+    reconstructor->SaveReconstructedVolumeToFile(outputVolumeFileName, false, !disableCompression);
+
+    if (!outputVolumeAccumulationFileName.empty())
+    {
+      reconstructor->SaveReconstructedVolumeToFile(outputVolumeAccumulationFileName, true, !disableCompression);
+    }
+
+    return EXIT_SUCCESS;
+  }
+
+  // Read image sequence
+  LOG_INFO("Reading image sequence " << inputImgSeqFileName);
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  if (vtkIGSIOSequenceIO::Read(inputImgSeqFileName, trackedFrameList) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to load input sequences file.");
+    exit(EXIT_FAILURE);
+  }
+
+  LOG_INFO("Set volume output extent...");
   if (reconstructor->SetOutputExtentFromFrameList(trackedFrameList, transformRepository, errorDetail) != PLUS_SUCCESS)
   {
     LOG_ERROR("Failed to set output extent of volume!");
     return EXIT_FAILURE;
   }
 
+  if (numberOfThreads != 1 && !outputFrameFileName.empty())
+  {
+    LOG_WARNING("Frames are pasted one by one, because --output-frame-file is specified");
+    numberOfThreads = 1;
+  }
+  if (numberOfThreads != 1)
+  {
+    LOG_INFO("Reconstruct volume in parallel bricks...");
+    const int numberOfFrames = trackedFrameList->GetNumberOfTrackedFrames();
+    int numberOfFramesAddedToVolume = 0;
+    vtkSmartPointer<vtkImageData> grayLevels = vtkSmartPointer<vtkImageData>::New();
+    vtkSmartPointer<vtkImageData> accumulationBuffer = vtkSmartPointer<vtkImageData>::New();
+    if (reconstructor->ReconstructInParallelBricks(trackedFrameList, transformRepository, numberOfThreads, holeFillingMarginVoxels,
+        grayLevels, outputVolumeAccumulationFileName.empty() ? NULL : accumulationBuffer.GetPointer(), &numberOfFramesAddedToVolume) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to reconstruct volume in parallel bricks");
+      return EXIT_FAILURE;
+    }
+    trackedFrameList->Clear();
+
+    LOG_INFO("Number of frames added to the volume: " << numberOfFramesAddedToVolume << " out of " << numberOfFrames);
+
+    LOG_INFO("Saving volume to file...");
+    vtkPlusVolumeReconstructor::SaveReconstructedVolumeToFile(grayLevels, outputVolumeFileName, !disableCompression);
+
+    if (!outputVolumeAccumulationFileName.empty())
+    {
+      vtkPlusVolumeReconstructor::SaveReconstructedVolumeToFile(accumulationBuffer, outputVolumeAccumulationFileName, !disableCompression);
+    }
+
+    return EXIT_SUCCESS;
+  }
+
   LOG_INFO("Reconstruct volume...");
   const int numberOfFrames = trackedFrameList->GetNumberOfTrackedFrames();
   int numberOfFramesAddedToVolume = 0;
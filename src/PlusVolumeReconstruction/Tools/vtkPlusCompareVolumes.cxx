@@ -25,8 +25,13 @@
 #include "vtkInformationVector.h"
 #include "vtkObjectFactory.h"
 #include "vtkStreamingDemandDrivenPipeline.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <thread>
 #include <vector>
-#include <list>
 
 static const int INPUT_GROUND_TRUTH_VOLUME = 0;
 static const int INPUT_GROUND_TRUTH_VOLUME_ALPHA = 1;
@@ -34,6 +39,7 @@ static const int INPUT_TEST_VOLUME = 2;
 static const int INPUT_TEST_VOLUME_ALPHA = 3;
 static const int INPUT_SLICES_VOLUME_ALPHA = 4;
 
+static const int OUTPUT_TRUE_DIFF_VOLUME = 0;
 static const int OUTPUT_ABS_DIFF_VOLUME = 1;
 
 vtkStandardNewMacro( vtkPlusCompareVolumes );
@@ -101,7 +107,7 @@ int* vtkPlusCompareVolumes::GetAbsoluteHistogramWithHolesPtr()
 //----------------------------------------------------------------------------
 void vtkPlusCompareVolumes::incTrueHistogramAtIndex( int value )
 {
-  int index = value + 256;
+  int index = value + 255;
   TrueHistogram[index]++;
 }
 
@@ -150,7 +156,14 @@ vtkPlusCompareVolumes::vtkPlusCompareVolumes()
 {
   this->SetNumberOfInputPorts( 5 );
   this->SetNumberOfOutputPorts( 2 );
-  this->SetNumberOfThreads( 1 ); // TODO: Remove when vtkPlusCompareVolumesExecute is made thread-safe (e.g., simultaneous access to member variables are protected by locking)
+  this->NumberOfHoles = 0;
+  this->NumberOfFilledHoles = 0;
+  this->NumberVoxelsVisible = 0;
+  this->NumberOfComparedVoxels = 0;
+  this->CompareOnlyPastedVoxels = false;
+  this->resetTrueHistogram();
+  this->resetAbsoluteHistogram();
+  this->resetAbsoluteHistogramWithHoles();
 }
 
 int vtkPlusCompareVolumes::RequestInformation (
@@ -167,171 +180,393 @@ int vtkPlusCompareVolumes::RequestInformation (
 }
 
 
-template <class T>
-void vtkPlusCompareVolumesExecute( vtkPlusCompareVolumes* self,
-                                   vtkImageData* inData,
-                                   vtkImageData* outData,
-                                   T* gtPtr,
-                                   T* gtAlphaPtr,
-                                   T* testPtr,
-                                   T* testAlphaPtr,
-                                   T* slicesAlphaPtr,
-                                   double* outPtrTru,
-                                   double* outPtrAbs,
-                                   int outExt[6],
-                                   int id )
+namespace
 {
+  const int TRUE_HISTOGRAM_SIZE = 511;
+  const int ABSOLUTE_HISTOGRAM_SIZE = 256;
 
-  vtkIdType inOffsets[3] = {0}; //x,y,z
-  inData->GetIncrements( inOffsets[0], inOffsets[1], inOffsets[2] );
+  // Statistics of a slab of the volume. Each thread collects the statistics of its own slab, which are merged when all the threads are completed.
+  struct CompareVolumesStatistics
+  {
+    CompareVolumesStatistics()
+      : CountVisibleVoxels( 0 )
+      , CountHoles( 0 )
+      , CountFilledHoles( 0 )
+      , CountComparedVoxels( 0 )
+      , SumTrueDifferences( 0.0 )
+      , SumAbsoluteDifferences( 0.0 )
+      , SumSquaredDifferences( 0.0 )
+      , SumAbsoluteDifferencesInHoles( 0.0 )
+      , TrueMinimum( std::numeric_limits<double>::max() )
+      , TrueMaximum( -std::numeric_limits<double>::max() )
+      , AbsoluteMinimum( std::numeric_limits<double>::max() )
+      , AbsoluteMaximum( 0.0 )
+    {
+      std::fill( this->TrueHistogram, this->TrueHistogram + TRUE_HISTOGRAM_SIZE, 0 );
+      std::fill( this->AbsoluteHistogram, this->AbsoluteHistogram + ABSOLUTE_HISTOGRAM_SIZE, 0 );
+      std::fill( this->AbsoluteHistogramWithHoles, this->AbsoluteHistogramWithHoles + ABSOLUTE_HISTOGRAM_SIZE, 0 );
+    }
 
-  vtkIdType outOffsets[3] = {0}; //x,y,z
-  outData->GetIncrements( outOffsets[0], outOffsets[1], outOffsets[2] );
+    void Merge( const CompareVolumesStatistics& other )
+    {
+      this->CountVisibleVoxels += other.CountVisibleVoxels;
+      this->CountHoles += other.CountHoles;
+      this->CountFilledHoles += other.CountFilledHoles;
+      this->CountComparedVoxels += other.CountComparedVoxels;
+      this->SumTrueDifferences += other.SumTrueDifferences;
+      this->SumAbsoluteDifferences += other.SumAbsoluteDifferences;
+      this->SumSquaredDifferences += other.SumSquaredDifferences;
+      this->SumAbsoluteDifferencesInHoles += other.SumAbsoluteDifferencesInHoles;
+      this->TrueMinimum = std::min( this->TrueMinimum, other.TrueMinimum );
+      this->TrueMaximum = std::max( this->TrueMaximum, other.TrueMaximum );
+      this->AbsoluteMinimum = std::min( this->AbsoluteMinimum, other.AbsoluteMinimum );
+      this->AbsoluteMaximum = std::max( this->AbsoluteMaximum, other.AbsoluteMaximum );
+      for ( int i = 0; i < TRUE_HISTOGRAM_SIZE; i++ )
+      {
+        this->TrueHistogram[i] += other.TrueHistogram[i];
+      }
+      for ( int i = 0; i < ABSOLUTE_HISTOGRAM_SIZE; i++ )
+      {
+        this->AbsoluteHistogram[i] += other.AbsoluteHistogram[i];
+        this->AbsoluteHistogramWithHoles[i] += other.AbsoluteHistogramWithHoles[i];
+      }
+      this->TrueDifferences.insert( this->TrueDifferences.end(), other.TrueDifferences.begin(), other.TrueDifferences.end() );
+    }
 
-  int xtemp( 0 ), ytemp( 0 ), ztemp( 0 ); // indices for each of the axes
-  self->resetTrueHistogram(); // count inside the class variables
-  self->resetAbsoluteHistogramWithHoles();
-  self->resetAbsoluteHistogram();
-  std::vector<double> trueDifferences; // store all differences here
-  std::vector<double> absoluteDifferences;
+    int CountVisibleVoxels;
+    int CountHoles;
+    int CountFilledHoles;
+    int CountComparedVoxels;
+    double SumTrueDifferences;
+    double SumAbsoluteDifferences;
+    double SumSquaredDifferences;
+    double SumAbsoluteDifferencesInHoles;
+    double TrueMinimum;
+    double TrueMaximum;
+    double AbsoluteMinimum;
+    double AbsoluteMaximum;
+    int TrueHistogram[TRUE_HISTOGRAM_SIZE];
+    int AbsoluteHistogram[ABSOLUTE_HISTOGRAM_SIZE];
+    int AbsoluteHistogramWithHoles[ABSOLUTE_HISTOGRAM_SIZE];
+    // Differences of the compared voxels, only collected if the histograms are not exact
+    std::vector<double> TrueDifferences;
+  };
+
+  //----------------------------------------------------------------------------
+  int GetClampedHistogramIndex( double value, int offset, int histogramSize )
+  {
+    int index = igsioMath::Round( value ) + offset;
+    return std::min( std::max( index, 0 ), histogramSize - 1 );
+  }
 
-  // same as absolute difference, but in hole voxels -
-  // this can be added to find the absolute error when
-  // we consider holes to be part of the image (and
-  // choose to not ignore them in the error computation)
-  // note these are not put into the histogram
-  std::vector<double> absoluteDifferencesInAllHoles;
+  //----------------------------------------------------------------------------
+  // Returns the value with the specified rank (0 = smallest) from a histogram of integer values, bin i counts the value i-offset
+  double GetValueAtRankFromHistogram( const int* histogram, int histogramSize, int offset, int rank )
+  {
+    int cumulativeCount = 0;
+    for ( int i = 0; i < histogramSize; i++ )
+    {
+      cumulativeCount += histogram[i];
+      if ( cumulativeCount > rank )
+      {
+        return i - offset;
+      }
+    }
+    return histogramSize - 1 - offset;
+  }
+
+  //----------------------------------------------------------------------------
+  // Percentile with linear interpolation between the closest ranks, computed from the histogram of integer values
+  double GetPercentileFromHistogram( const int* histogram, int histogramSize, int offset, int count, double percentile )
+  {
+    double rank = ( count - 1 ) * percentile;
+    double fraction = fmod( rank, 1.0 );
+    int rankFloor = std::max( ( int )floor( rank ), 0 );
+    int rankCeil = std::min( ( int )ceil( rank ), count - 1 );
+    return GetValueAtRankFromHistogram( histogram, histogramSize, offset, rankFloor ) * ( 1 - fraction )
+           + GetValueAtRankFromHistogram( histogram, histogramSize, offset, rankCeil ) * fraction;
+  }
 
-  int countVisibleVoxels( 0 );
-  int countFilledHoles( 0 );
-  int countHoles( 0 );
+  //----------------------------------------------------------------------------
+  // Percentile with linear interpolation between the closest ranks. The values are partially reordered, without sorting all of them.
+  double GetPercentile( std::vector<double>& values, double percentile )
+  {
+    int count = static_cast<int>( values.size() );
+    double rank = ( count - 1 ) * percentile;
+    double fraction = fmod( rank, 1.0 );
+    int rankFloor = std::max( ( int )floor( rank ), 0 );
+    int rankCeil = std::min( ( int )ceil( rank ), count - 1 );
+    std::nth_element( values.begin(), values.begin() + rankFloor, values.end() );
+    double valueFloor = values[rankFloor];
+    double valueCeil = valueFloor;
+    if ( rankCeil > rankFloor )
+    {
+      // after nth_element all the values above rankFloor are not smaller than valueFloor
+      valueCeil = *std::min_element( values.begin() + rankFloor + 1, values.end() );
+    }
+    return valueFloor * ( 1 - fraction ) + valueCeil * fraction;
+  }
+}
 
-  // iterate through all voxels
-  for ( ztemp = 0; ztemp <= outExt[5] - outExt[4]; ztemp++ )
+//----------------------------------------------------------------------------
+// Compares the slices [zMin, zMax] of the volumes. All the input images have the same dimensions and a single component.
+// The first pass over a row only contains arithmetic and selections so that the compiler can vectorize it, the second pass
+// updates the histograms and is only executed for the rows that contain compared voxels or holes.
+template <class T, class TSlicesAlpha>
+void vtkPlusCompareVolumesExecute( const T* gtPtr,
+                                   const T* gtAlphaPtr,
+                                   const T* testPtr,
+                                   const T* testAlphaPtr,
+                                   const TSlicesAlpha* slicesAlphaPtr,
+                                   double* outPtrTru,
+                                   double* outPtrAbs,
+                                   const int dims[3],
+                                   int zMin, int zMax,
+                                   bool compareOnlyPastedVoxels,
+                                   bool collectDifferences,
+                                   CompareVolumesStatistics& stats )
+{
+  const int rowLength = dims[0];
+  for ( int z = zMin; z <= zMax; z++ )
   {
-    for ( ytemp = 0; ytemp <= outExt[3] - outExt[2]; ytemp++ )
+    for ( int y = 0; y < dims[1]; y++ )
     {
-      for ( xtemp = 0; xtemp <= outExt[1] - outExt[0]; xtemp++ )
+      vtkIdType rowOffset = ( static_cast<vtkIdType>( z ) * dims[1] + y ) * rowLength;
+      const T* gtRow = gtPtr + rowOffset;
+      const T* gtAlphaRow = gtAlphaPtr + rowOffset;
+      const T* testRow = testPtr + rowOffset;
+      const T* testAlphaRow = testAlphaPtr + rowOffset;
+      const TSlicesAlpha* slicesAlphaRow = slicesAlphaPtr + rowOffset;
+      double* outTruRow = outPtrTru + rowOffset;
+      double* outAbsRow = outPtrAbs + rowOffset;
+
+      int rowVisible = 0;
+      int rowHoles = 0;
+      int rowFilledHoles = 0;
+      int rowCompared = 0;
+      double rowSumTrue = 0.0;
+      double rowSumAbsolute = 0.0;
+      double rowSumSquared = 0.0;
+      double rowSumAbsoluteInHoles = 0.0;
+      for ( int x = 0; x < rowLength; x++ )
+      {
+        double difference = static_cast<double>( gtRow[x] ) - static_cast<double>( testRow[x] );
+        double absoluteDifference = fabs( difference );
+        int visible = ( gtAlphaRow[x] != 0 );
+        int pasted = ( slicesAlphaRow[x] != 0 );
+        int filled = ( testAlphaRow[x] != 0 );
+        int hole = visible & ( 1 - pasted );
+        int filledHole = hole & filled;
+        int compared = compareOnlyPastedVoxels ? ( visible & pasted & filled ) : filledHole;
+        double weight = compared;
+        outTruRow[x] = weight * difference;
+        outAbsRow[x] = weight * absoluteDifference;
+        rowVisible += visible;
+        rowHoles += hole;
+        rowFilledHoles += filledHole;
+        rowCompared += compared;
+        rowSumTrue += weight * difference;
+        rowSumAbsolute += weight * absoluteDifference;
+        rowSumSquared += weight * difference * difference;
+        rowSumAbsoluteInHoles += hole * absoluteDifference;
+      }
+      stats.CountVisibleVoxels += rowVisible;
+      stats.CountHoles += rowHoles;
+      stats.CountFilledHoles += rowFilledHoles;
+      stats.CountComparedVoxels += rowCompared;
+      stats.SumTrueDifferences += rowSumTrue;
+      stats.SumAbsoluteDifferences += rowSumAbsolute;
+      stats.SumSquaredDifferences += rowSumSquared;
+      stats.SumAbsoluteDifferencesInHoles += rowSumAbsoluteInHoles;
+
+      if ( rowCompared == 0 && rowHoles == 0 )
+      {
+        continue;
+      }
+      for ( int x = 0; x < rowLength; x++ )
       {
-        int inIndex  =  inOffsets[0] * xtemp + inOffsets[1] * ytemp + inOffsets[2] * ztemp;
-        int outIndex = outOffsets[0] * xtemp + outOffsets[1] * ytemp + outOffsets[2] * ztemp;
-        if ( gtAlphaPtr[inIndex] != 0 )
+        if ( gtAlphaRow[x] == 0 )
         {
-          countVisibleVoxels++;
-          if ( slicesAlphaPtr[inIndex] == 0 )
-          {
-            countHoles++;
-            double difference = ( double )gtPtr[inIndex] - testPtr[inIndex];
-            self->incAbsoluteHistogramWithHolesAtIndex( igsioMath::Round( fabs( difference ) ) );
-            absoluteDifferencesInAllHoles.push_back( fabs( difference ) );
-            if ( testAlphaPtr[inIndex] != 0 )
-            {
-              countFilledHoles++;
-              trueDifferences.push_back( difference );
-              self->incTrueHistogramAtIndex( igsioMath::Round( difference ) );
-              outPtrTru[outIndex] = difference; // cast to double to minimize precision loss
-              absoluteDifferences.push_back( fabs( difference ) );
-              self->incAbsoluteHistogramAtIndex( igsioMath::Round( fabs( difference ) ) );
-              outPtrAbs[outIndex] = fabs( difference );
-            }
-          }
-          else // not a hole, but these may still be different
-          {
-            //double difference = (double)gtPtr[inIndex] - testPtr[inIndex]; // cast to double to minimize precision loss
-            outPtrTru[outIndex] = 0.0; //difference;
-            outPtrAbs[outIndex] = 0.0; //abs(difference);
-          } // end slicesAlphaPtr check
+          continue;
         }
-        else
+        double difference = static_cast<double>( gtRow[x] ) - static_cast<double>( testRow[x] );
+        double absoluteDifference = fabs( difference );
+        bool pasted = ( slicesAlphaRow[x] != 0 );
+        bool filled = ( testAlphaRow[x] != 0 );
+        if ( !pasted )
         {
-          outPtrTru[outIndex] = 0.0;
-          outPtrAbs[outIndex] = 0.0;
-        } // end gtAlphaPtr check
-      } // end x loop
-    } // end y loop
-  } // end z loop
-
-  double absoluteMeanWithHoles( 0.0 ); // include holes in this computation
-  // on this iteration, add only holes
-  for ( unsigned int i = 0; i < absoluteDifferencesInAllHoles.size(); i++ )
-  {
-    absoluteMeanWithHoles += absoluteDifferencesInAllHoles[i];
+          stats.AbsoluteHistogramWithHoles[GetClampedHistogramIndex( absoluteDifference, 0, ABSOLUTE_HISTOGRAM_SIZE )]++;
+        }
+        if ( !filled || pasted != compareOnlyPastedVoxels )
+        {
+          continue;
+        }
+        stats.TrueHistogram[GetClampedHistogramIndex( difference, 255, TRUE_HISTOGRAM_SIZE )]++;
+        stats.AbsoluteHistogram[GetClampedHistogramIndex( absoluteDifference, 0, ABSOLUTE_HISTOGRAM_SIZE )]++;
+        stats.TrueMinimum = std::min( stats.TrueMinimum, difference );
+        stats.TrueMaximum = std::max( stats.TrueMaximum, difference );
+        stats.AbsoluteMinimum = std::min( stats.AbsoluteMinimum, absoluteDifference );
+        stats.AbsoluteMaximum = std::max( stats.AbsoluteMaximum, absoluteDifference );
+        if ( collectDifferences )
+        {
+          stats.TrueDifferences.push_back( difference );
+        }
+      }
+    }
   }
+}
 
-  // mean calculations
-  double trueMean( 0.0 );
-  double absoluteMean( 0.0 ); // do not include holes in this computation
-  double rms( 0.0 );
-  for ( int i = 0; i < countFilledHoles; i++ )
+//----------------------------------------------------------------------------
+template <class T>
+void vtkPlusCompareVolumesExecuteWithSlicesAlpha( const T* gtPtr,
+                                                  const T* gtAlphaPtr,
+                                                  const T* testPtr,
+                                                  const T* testAlphaPtr,
+                                                  void* slicesAlphaPtr,
+                                                  int slicesAlphaScalarType,
+                                                  double* outPtrTru,
+                                                  double* outPtrAbs,
+                                                  const int dims[3],
+                                                  int zMin, int zMax,
+                                                  bool compareOnlyPastedVoxels,
+                                                  bool collectDifferences,
+                                                  CompareVolumesStatistics& stats )
+{
+  if ( slicesAlphaScalarType == VTK_UNSIGNED_SHORT )
   {
-    trueMean += trueDifferences[i];
-    absoluteMean += absoluteDifferences[i];
-    rms += trueDifferences[i] * trueDifferences[i];
+    vtkPlusCompareVolumesExecute( gtPtr, gtAlphaPtr, testPtr, testAlphaPtr, static_cast<unsigned short*>( slicesAlphaPtr ),
+                                  outPtrTru, outPtrAbs, dims, zMin, zMax, compareOnlyPastedVoxels, collectDifferences, stats );
+    return;
   }
+  // otherwise the slices alpha has the same type as the other inputs
+  vtkPlusCompareVolumesExecute( gtPtr, gtAlphaPtr, testPtr, testAlphaPtr, static_cast<T*>( slicesAlphaPtr ),
+                                outPtrTru, outPtrAbs, dims, zMin, zMax, compareOnlyPastedVoxels, collectDifferences, stats );
+}
 
-  // divide by the number of filled holes
-  if ( countFilledHoles != 0 )
+//----------------------------------------------------------------------------
+int vtkPlusCompareVolumes::RequestData(
+  vtkInformation* vtkNotUsed( request ),
+  vtkInformationVector** inputVector,
+  vtkInformationVector* outputVector )
+{
+  vtkImageData* gtVolData = vtkImageData::GetData( inputVector[INPUT_GROUND_TRUTH_VOLUME] );
+  vtkImageData* gtAlphaVolData = vtkImageData::GetData( inputVector[INPUT_GROUND_TRUTH_VOLUME_ALPHA] );
+  vtkImageData* testVolData = vtkImageData::GetData( inputVector[INPUT_TEST_VOLUME] );
+  vtkImageData* testAlphaVolData = vtkImageData::GetData( inputVector[INPUT_TEST_VOLUME_ALPHA] );
+  vtkImageData* slicesAlphaVolData = vtkImageData::GetData( inputVector[INPUT_SLICES_VOLUME_ALPHA] );
+  if ( gtVolData == NULL || gtAlphaVolData == NULL || testVolData == NULL || testAlphaVolData == NULL || slicesAlphaVolData == NULL )
   {
-    trueMean /= countFilledHoles;
-    absoluteMean /= countFilledHoles;
-    rms = sqrt( rms / countFilledHoles );
+    vtkErrorMacro( << "Input must be specified." );
+    return 0;
   }
-  else
+
+  // this filter expects that all inputs are the same type, except the slices alpha, which may be an accumulation buffer
+  int scalarType = gtVolData->GetScalarType();
+  if ( gtAlphaVolData->GetScalarType() != scalarType
+       || testVolData->GetScalarType() != scalarType
+       || testAlphaVolData->GetScalarType() != scalarType
+       || ( slicesAlphaVolData->GetScalarType() != scalarType && slicesAlphaVolData->GetScalarType() != VTK_UNSIGNED_SHORT ) )
   {
-    trueMean = 0;
-    absoluteMean = 0;
-    rms = 0;
+    vtkErrorMacro( << "Execute: input ScalarTypes must match ScalarType " << scalarType );
+    return 0;
   }
 
-  // divide by the total number of holes
-  if ( countHoles != 0 )
+  int dims[3] = {0, 0, 0};
+  gtVolData->GetDimensions( dims );
+  vtkImageData* inputs[4] = { gtAlphaVolData, testVolData, testAlphaVolData, slicesAlphaVolData };
+  for ( int i = 0; i < 4; i++ )
   {
-    absoluteMeanWithHoles /= countHoles;
+    int inputDims[3] = {0, 0, 0};
+    inputs[i]->GetDimensions( inputDims );
+    if ( inputDims[0] != dims[0] || inputDims[1] != dims[1] || inputDims[2] != dims[2] || inputs[i]->GetNumberOfScalarComponents() != 1 )
+    {
+      vtkErrorMacro( << "Execute: input images must have the same dimensions and a single scalar component" );
+      return 0;
+    }
   }
-  else
+  if ( gtVolData->GetNumberOfScalarComponents() != 1 )
   {
-    absoluteMeanWithHoles = 0;
+    vtkErrorMacro( << "Execute: input images must have the same dimensions and a single scalar component" );
+    return 0;
   }
 
-  // stdev calculations
-  double trueStdev = 0.0;
-  double absoluteStdev = 0.0;
-  for ( int i = 0; i < countFilledHoles; i++ )
+  vtkImageData* outVolDataTru = vtkImageData::GetData( outputVector, OUTPUT_TRUE_DIFF_VOLUME );
+  vtkImageData* outVolDataAbs = vtkImageData::GetData( outputVector, OUTPUT_ABS_DIFF_VOLUME );
+  vtkImageData* outputs[2] = { outVolDataTru, outVolDataAbs };
+  for ( int i = 0; i < 2; i++ )
   {
-    trueStdev += pow( ( trueDifferences[i] - trueMean ), 2 );
-    absoluteStdev += pow( ( absoluteDifferences[i] - absoluteMean ), 2 );
+    outputs[i]->SetExtent( gtVolData->GetExtent() );
+    outputs[i]->SetOrigin( gtVolData->GetOrigin() );
+    outputs[i]->SetSpacing( gtVolData->GetSpacing() );
+    outputs[i]->AllocateScalars( VTK_DOUBLE, 1 );
   }
-  if ( countFilledHoles != 0 )
+  double* outPtrTru = static_cast< double* >( outVolDataTru->GetScalarPointer() );
+  double* outPtrAbs = static_cast< double* >( outVolDataAbs->GetScalarPointer() );
+
+  void* gtPtr = gtVolData->GetScalarPointer();
+  void* gtAlphaPtr = gtAlphaVolData->GetScalarPointer();
+  void* testPtr = testVolData->GetScalarPointer();
+  void* testAlphaPtr = testAlphaVolData->GetScalarPointer();
+  void* slicesAlphaPtr = slicesAlphaVolData->GetScalarPointer();
+  int slicesAlphaScalarType = slicesAlphaVolData->GetScalarType();
+
+  // differences of 8-bit images are integers between -255 and 255, so the histograms contain all the differences
+  // and the percentiles can be computed from them without storing the differences
+  bool exactHistograms = ( scalarType == VTK_UNSIGNED_CHAR || scalarType == VTK_CHAR || scalarType == VTK_SIGNED_CHAR );
+  bool compareOnlyPastedVoxels = this->CompareOnlyPastedVoxels;
+
+  int numberOfSlabs = std::max( std::min( this->GetNumberOfThreads(), dims[2] ), 1 );
+  std::vector<CompareVolumesStatistics> slabStatistics( numberOfSlabs );
+  std::atomic<bool> unknownScalarType( false );
+  std::function<void( int )> compareSlab = [&]( int slabIndex )
+  {
+    int zMin = static_cast<int>( static_cast<vtkIdType>( dims[2] ) * slabIndex / numberOfSlabs );
+    int zMax = static_cast<int>( static_cast<vtkIdType>( dims[2] ) * ( slabIndex + 1 ) / numberOfSlabs ) - 1;
+    switch ( scalarType )
+    {
+      vtkTemplateMacro(
+        vtkPlusCompareVolumesExecuteWithSlicesAlpha( static_cast<VTK_TT*>( gtPtr ), static_cast<VTK_TT*>( gtAlphaPtr ),
+                                                     static_cast<VTK_TT*>( testPtr ), static_cast<VTK_TT*>( testAlphaPtr ),
+                                                     slicesAlphaPtr, slicesAlphaScalarType, outPtrTru, outPtrAbs, dims, zMin, zMax,
+                                                     compareOnlyPastedVoxels, !exactHistograms, slabStatistics[slabIndex] )
+      );
+    default:
+      unknownScalarType = true;
+    }
+  };
+  std::vector<std::thread> threads;
+  for ( int slabIndex = 1; slabIndex < numberOfSlabs; slabIndex++ )
   {
-    trueStdev = sqrt( trueStdev / countFilledHoles );
-    absoluteStdev = sqrt( absoluteStdev / countFilledHoles );
+    threads.push_back( std::thread( compareSlab, slabIndex ) );
   }
-  else
+  compareSlab( 0 );
+  for ( std::vector<std::thread>::iterator threadIt = threads.begin(); threadIt != threads.end(); ++threadIt )
   {
-    trueStdev = 0;
-    absoluteStdev = 0;
+    threadIt->join();
   }
-
-  // need to sort, temporarily store in a list, sort, then assign back to vector <== THIS IS SLOW SLOW SLOW, as in about half a minute for this alone, so TODO: Make this faster
-  std::list<double> trueDifferencesList;
-  std::list<double> absoluteDifferencesList;
-  for ( int i = 0; i < countFilledHoles; i++ )
+  if ( unknownScalarType )
   {
-    trueDifferencesList.push_front( trueDifferences.back() );
-    trueDifferences.pop_back();
-    absoluteDifferencesList.push_front( absoluteDifferences.back() );
-    absoluteDifferences.pop_back();
+    vtkErrorMacro( << "Execute: Unknown ScalarType" );
+    return 0;
   }
-  trueDifferencesList.sort();
-  absoluteDifferencesList.sort();
-  for ( int i = 0; i < countFilledHoles; i++ )
+
+  // merge the statistics of the slabs in order, so that the results only depend on the number of threads
+  CompareVolumesStatistics stats;
+  for ( int slabIndex = 0; slabIndex < numberOfSlabs; slabIndex++ )
   {
-    trueDifferences.push_back( trueDifferencesList.front() );
-    trueDifferencesList.pop_front();
-    absoluteDifferences.push_back( absoluteDifferencesList.front() );
-    absoluteDifferencesList.pop_front();
+    stats.Merge( slabStatistics[slabIndex] );
+    std::vector<double>().swap( slabStatistics[slabIndex].TrueDifferences );
   }
+  std::copy( stats.TrueHistogram, stats.TrueHistogram + TRUE_HISTOGRAM_SIZE, this->TrueHistogram );
+  std::copy( stats.AbsoluteHistogram, stats.AbsoluteHistogram + ABSOLUTE_HISTOGRAM_SIZE, this->AbsoluteHistogram );
+  std::copy( stats.AbsoluteHistogramWithHoles, stats.AbsoluteHistogramWithHoles + ABSOLUTE_HISTOGRAM_SIZE, this->AbsoluteHistogramWithHoles );
 
+  int countCompared = stats.CountComparedVoxels;
+  double trueMean( 0.0 );
+  double absoluteMean( 0.0 ); // do not include holes in this computation
+  double rms( 0.0 );
+  double trueStdev( 0.0 );
+  double absoluteStdev( 0.0 );
   double true5thPercentile( 0.0 );
   double true95thPercentile( 0.0 );
   double absolute5thPercentile( 0.0 );
@@ -342,142 +577,74 @@ void vtkPlusCompareVolumesExecute( vtkPlusCompareVolumes* self,
   double trueMaximum( 0.0 );
   double absoluteMinimum( 0.0 );
   double absoluteMaximum( 0.0 );
-
-  if ( countFilledHoles != 0 )
+  if ( countCompared != 0 )
   {
-    trueMinimum = trueDifferences[0];
-    trueMaximum = trueDifferences[countFilledHoles - 1];
-    absoluteMinimum = absoluteDifferences[0];
-    absoluteMaximum = absoluteDifferences[countFilledHoles - 1];
-
-    // old median calculation
-    //double trueMedian = (countFilledHoles%2==0)?(trueDifferences[countFilledHoles/2]+trueDifferences[(countFilledHoles/2)-1])/2.0:trueDifferences[(countFilledHoles-1)/2];
-    //double absoluteMedian = (countFilledHoles%2==0)?(absoluteDifferences[countFilledHoles/2]+absoluteDifferences[(countFilledHoles/2)-1])/2.0:absoluteDifferences[(countFilledHoles-1)/2];
-
-    double medianRank = ( countFilledHoles - 1 ) * 0.5;
-    double medianFraction = fmod( medianRank, 1.0 );
-    int medianFloor = ( int )floor( medianRank );
-    if ( medianFloor < 0 )
+    trueMean = stats.SumTrueDifferences / countCompared;
+    absoluteMean = stats.SumAbsoluteDifferences / countCompared;
+    double meanSquare = stats.SumSquaredDifferences / countCompared;
+    rms = sqrt( meanSquare );
+    trueStdev = sqrt( std::max( meanSquare - trueMean * trueMean, 0.0 ) );
+    absoluteStdev = sqrt( std::max( meanSquare - absoluteMean * absoluteMean, 0.0 ) );
+
+    trueMinimum = stats.TrueMinimum;
+    trueMaximum = stats.TrueMaximum;
+    absoluteMinimum = stats.AbsoluteMinimum;
+    absoluteMaximum = stats.AbsoluteMaximum;
+
+    if ( exactHistograms )
     {
-      medianFloor = 0;
+      trueMedian = GetPercentileFromHistogram( this->TrueHistogram, TRUE_HISTOGRAM_SIZE, 255, countCompared, 0.5 );
+      true5thPercentile = GetPercentileFromHistogram( this->TrueHistogram, TRUE_HISTOGRAM_SIZE, 255, countCompared, 0.05 );
+      true95thPercentile = GetPercentileFromHistogram( this->TrueHistogram, TRUE_HISTOGRAM_SIZE, 255, countCompared, 0.95 );
+      absoluteMedian = GetPercentileFromHistogram( this->AbsoluteHistogram, ABSOLUTE_HISTOGRAM_SIZE, 0, countCompared, 0.5 );
+      absolute5thPercentile = GetPercentileFromHistogram( this->AbsoluteHistogram, ABSOLUTE_HISTOGRAM_SIZE, 0, countCompared, 0.05 );
+      absolute95thPercentile = GetPercentileFromHistogram( this->AbsoluteHistogram, ABSOLUTE_HISTOGRAM_SIZE, 0, countCompared, 0.95 );
     }
-    int medianCeil = ( int )ceil( medianRank );
-    if ( medianCeil > ( countFilledHoles - 1 ) )
+    else
     {
-      medianCeil = ( countFilledHoles - 1 );
-    }
-    trueMedian = trueDifferences[medianFloor] * ( 1 - medianFraction ) + trueDifferences[medianCeil] * medianFraction;
-    absoluteMedian = absoluteDifferences[medianFloor] * ( 1 - medianFraction ) + absoluteDifferences[medianCeil] * medianFraction;
-
-    double percentile5rank = ( countFilledHoles - 1 ) * 0.05;
-    double percentile5fraction = fmod( percentile5rank, 1.0 );
-    int percentile5floor = ( int )floor( percentile5rank );
-    if ( percentile5floor < 0 )
-    {
-      percentile5floor = 0;
-    }
-    int percentile5ceil = ( int )ceil( percentile5rank );
-    if ( percentile5ceil > ( countFilledHoles - 1 ) )
-    {
-      percentile5ceil = ( countFilledHoles - 1 );
-    }
-    true5thPercentile = trueDifferences[percentile5floor] * ( 1 - percentile5fraction ) + trueDifferences[percentile5ceil] * percentile5fraction;
-    absolute5thPercentile = absoluteDifferences[percentile5floor] * ( 1 - percentile5fraction ) + absoluteDifferences[percentile5ceil] * percentile5fraction;
-
-    double percentile95rank = ( countFilledHoles - 1 ) * 0.95;
-    double percentile95fraction = fmod( percentile95rank, 1.0 );
-    int percentile95floor = ( int )floor( percentile95rank );
-    if ( percentile95floor < 0 )
-    {
-      percentile95floor = 0;
-    }
-    int percentile95ceil = ( int )ceil( percentile95rank );
-    if ( percentile95ceil > ( countFilledHoles - 1 ) )
-    {
-      percentile95ceil = ( countFilledHoles - 1 );
+      std::vector<double>& differences = stats.TrueDifferences;
+      trueMedian = GetPercentile( differences, 0.5 );
+      true5thPercentile = GetPercentile( differences, 0.05 );
+      true95thPercentile = GetPercentile( differences, 0.95 );
+      for ( std::vector<double>::iterator it = differences.begin(); it != differences.end(); ++it )
+      {
+        *it = fabs( *it );
+      }
+      absoluteMedian = GetPercentile( differences, 0.5 );
+      absolute5thPercentile = GetPercentile( differences, 0.05 );
+      absolute95thPercentile = GetPercentile( differences, 0.95 );
     }
-    true95thPercentile = trueDifferences[percentile95floor] * ( 1 - percentile95fraction ) + trueDifferences[percentile95ceil] * percentile95fraction;
-    absolute95thPercentile = absoluteDifferences[percentile95floor] * ( 1 - percentile95fraction ) + absoluteDifferences[percentile95ceil] * percentile95fraction;
   }
 
-  self->SetNumberOfHoles( countHoles );
-  self->SetNumberVoxelsVisible( countVisibleVoxels );
-  self->SetNumberOfFilledHoles( countFilledHoles );
-
-  self->SetTrue95thPercentile( true95thPercentile );
-  self->SetTrue5thPercentile( true5thPercentile );
-  self->SetTrueMaximum( trueMaximum );
-  self->SetTrueMinimum( trueMinimum );
-  self->SetTrueMedian( trueMedian );
-  self->SetTrueStdev( trueStdev );
-  self->SetTrueMean( trueMean );
-
-  self->SetAbsolute95thPercentile( absolute95thPercentile );
-  self->SetAbsolute5thPercentile( absolute5thPercentile );
-  self->SetAbsoluteMaximum( absoluteMaximum );
-  self->SetAbsoluteMinimum( absoluteMinimum );
-  self->SetAbsoluteMedian( absoluteMedian );
-  self->SetAbsoluteStdev( absoluteStdev );
-  self->SetAbsoluteMean( absoluteMean );
-
-  self->SetAbsoluteMeanWithHoles( absoluteMeanWithHoles );
-
-  self->SetRMS( rms );
-}
+  // include holes in this computation
+  double absoluteMeanWithHoles = ( stats.CountHoles != 0 ) ? stats.SumAbsoluteDifferencesInHoles / stats.CountHoles : 0.0;
 
-void vtkPlusCompareVolumes::ThreadedRequestData (
-  vtkInformation* vtkNotUsed( request ),
-  vtkInformationVector** vtkNotUsed( inputVector ),
-  vtkInformationVector* vtkNotUsed( outputVector ),
-  vtkImageData** *inData,
-  vtkImageData** outData,
-  int outExt[6], int threadId )
-{
-  if ( inData[INPUT_GROUND_TRUTH_VOLUME][0] == NULL
-       || inData[INPUT_GROUND_TRUTH_VOLUME_ALPHA][0] == NULL
-       || inData[INPUT_TEST_VOLUME][0] == NULL
-       || inData[INPUT_TEST_VOLUME_ALPHA][0] == NULL
-       || inData[INPUT_SLICES_VOLUME_ALPHA][0] == NULL )
-  {
-    vtkErrorMacro( << "Input must be specified." );
-    return;
-  }
+  this->SetNumberOfHoles( stats.CountHoles );
+  this->SetNumberVoxelsVisible( stats.CountVisibleVoxels );
+  this->SetNumberOfFilledHoles( stats.CountFilledHoles );
+  this->SetNumberOfComparedVoxels( countCompared );
 
-  // this filter expects that all inputs are the same type as output.
-  if ( inData[INPUT_GROUND_TRUTH_VOLUME_ALPHA][0]->GetScalarType() != inData[INPUT_GROUND_TRUTH_VOLUME][0]->GetScalarType()
-       || inData[INPUT_TEST_VOLUME][0]->GetScalarType() != inData[INPUT_GROUND_TRUTH_VOLUME][0]->GetScalarType()
-       || inData[INPUT_TEST_VOLUME_ALPHA][0]->GetScalarType() != inData[INPUT_GROUND_TRUTH_VOLUME][0]->GetScalarType()
-       || inData[INPUT_SLICES_VOLUME_ALPHA][0]->GetScalarType() != inData[INPUT_GROUND_TRUTH_VOLUME][0]->GetScalarType() )
-  {
-    vtkErrorMacro( << "Execute: input ScalarTypes must match ScalarType "
-                   << inData[INPUT_GROUND_TRUTH_VOLUME][0]->GetScalarType() );
-    return;
-  }
+  this->SetTrue95thPercentile( true95thPercentile );
+  this->SetTrue5thPercentile( true5thPercentile );
+  this->SetTrueMaximum( trueMaximum );
+  this->SetTrueMinimum( trueMinimum );
+  this->SetTrueMedian( trueMedian );
+  this->SetTrueStdev( trueStdev );
+  this->SetTrueMean( trueMean );
 
-  vtkImageData* gtVolData = inData[INPUT_GROUND_TRUTH_VOLUME][0];
-  void* gtPtr = gtVolData->GetScalarPointer();
-  void* gtAlphaPtr = inData[INPUT_GROUND_TRUTH_VOLUME_ALPHA][0]->GetScalarPointer();
-  void* testPtr = inData[INPUT_TEST_VOLUME][0]->GetScalarPointer();
-  void* testAlphaPtr = inData[INPUT_TEST_VOLUME_ALPHA][0]->GetScalarPointer();
-  void* slicesAlphaPtr = inData[INPUT_SLICES_VOLUME_ALPHA][0]->GetScalarPointer();
+  this->SetAbsolute95thPercentile( absolute95thPercentile );
+  this->SetAbsolute5thPercentile( absolute5thPercentile );
+  this->SetAbsoluteMaximum( absoluteMaximum );
+  this->SetAbsoluteMinimum( absoluteMinimum );
+  this->SetAbsoluteMedian( absoluteMedian );
+  this->SetAbsoluteStdev( absoluteStdev );
+  this->SetAbsoluteMean( absoluteMean );
 
-  vtkImageData* outVolDataTru = inData[INPUT_GROUND_TRUTH_VOLUME][0];
-  double* outPtrTru = static_cast< double* >( outVolDataTru->GetScalarPointer() );
-  double* outPtrAbs = static_cast< double* >( outData[OUTPUT_ABS_DIFF_VOLUME]->GetScalarPointer() );
+  this->SetAbsoluteMeanWithHoles( absoluteMeanWithHoles );
 
-  switch ( gtVolData->GetScalarType() )
-  {
-    vtkTemplateMacro(
-      vtkPlusCompareVolumesExecute( this, gtVolData, outVolDataTru,
-                                    static_cast<VTK_TT*>( gtPtr ),   static_cast<VTK_TT*>( gtAlphaPtr ),
-                                    static_cast<VTK_TT*>( testPtr ), static_cast<VTK_TT*>( testAlphaPtr ),
-                                    static_cast<VTK_TT*>( slicesAlphaPtr ),
-                                    outPtrTru, outPtrAbs, outExt, threadId )
-    );
-  default:
-    vtkErrorMacro( << "Execute: Unknown ScalarType" );
-    return;
-  }
+  this->SetRMS( rms );
+
+  return 1;
 }
 
 int vtkPlusCompareVolumes::FillInputPortInformation( int port, vtkInformation* info )
@@ -19,6 +19,9 @@
 //   - A ground truth alpha image: This is used together with the slices alpha image to identify hole voxels
 //   - A reconstructed "test" image
 //   - A slices alpha image: The alpha channel if the slices are only pasted into the volume without hole filling
+//     (it may also be the VTK_UNSIGNED_SHORT accumulation buffer of the reconstruction)
+// The volume is processed in slabs on NumberOfThreads threads. Statistics are computed from the filled holes,
+// or from the pasted voxels (where the slices alpha is nonzero) if CompareOnlyPastedVoxels is enabled.
 
 #ifndef __vtkPlusCompareVolumes_h
 #define __vtkPlusCompareVolumes_h
@@ -50,9 +53,16 @@ public:
   virtual void SetInputTestAlpha(vtkDataObject *input);;
 
   // Description:
-  // Set the Input5 of this filter.
+  // Set the Input5 of this filter. It must have the scalar type of the other inputs or VTK_UNSIGNED_SHORT.
   virtual void SetInputSliceAlpha(vtkDataObject *input);;
 
+  // Description:
+  // If enabled then the statistics and the difference images are computed from the visible voxels where slices
+  // were pasted (slices alpha is nonzero) instead of the filled holes. Disabled by default.
+  vtkGetMacro(CompareOnlyPastedVoxels,bool);
+  vtkSetMacro(CompareOnlyPastedVoxels,bool);
+  vtkBooleanMacro(CompareOnlyPastedVoxels,bool);
+
   // Description:
   // Output the images resulting from this filter
   vtkImageData* GetOutputTrueDifferenceImage();
@@ -96,6 +106,10 @@ public:
   vtkSetMacro(NumberOfFilledHoles,int);
   vtkGetMacro(NumberVoxelsVisible,int);
   vtkSetMacro(NumberVoxelsVisible,int);
+  // Description:
+  // Number of voxels that the statistics are computed from (filled holes or pasted voxels)
+  vtkGetMacro(NumberOfComparedVoxels,int);
+  vtkSetMacro(NumberOfComparedVoxels,int);
 
   vtkGetMacro(AbsoluteMeanWithHoles,double);
   vtkSetMacro(AbsoluteMeanWithHoles,double);
@@ -124,14 +138,16 @@ protected:
   int NumberOfHoles;
   int NumberOfFilledHoles;
   int NumberVoxelsVisible;
+  int NumberOfComparedVoxels;
+  bool CompareOnlyPastedVoxels;
 
   virtual int RequestInformation (vtkInformation *, vtkInformationVector**, vtkInformationVector *);
 
-  void ThreadedRequestData (vtkInformation* request,
-                            vtkInformationVector** inputVector,
-                            vtkInformationVector* outputVector,
-                            vtkImageData ***inData, vtkImageData **outData,
-                            int ext[6], int id);
+  // Description:
+  // Compares the volumes on NumberOfThreads threads and merges the statistics of the slabs
+  virtual int RequestData(vtkInformation* request,
+                          vtkInformationVector** inputVector,
+                          vtkInformationVector* outputVector);
 
   virtual int FillInputPortInformation(int port, vtkInformation* info);
 
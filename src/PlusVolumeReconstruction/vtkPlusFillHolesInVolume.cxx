@@ -0,0 +1,418 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+
+#include "vtkPlusFillHolesInVolume.h"
+
+#include "vtkImageData.h"
+#include "vtkObjectFactory.h"
+#include "vtkXMLDataElement.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <thread>
+
+vtkStandardNewMacro(vtkPlusFillHolesInVolume);
+
+namespace
+{
+  typedef vtkPlusFillHolesInVolume::HoleFillingElement HoleFillingElement;
+
+  /*! Input voxels of the hole filling. Pointers point to the first voxel of the volume extent. */
+  template <class T>
+  struct InputVolume
+  {
+    const T* GrayLevels;
+    vtkIdType GrayLevelsIncrements[3];
+    const unsigned short* Accumulation;
+    vtkIdType AccumulationIncrements[3];
+    int Extent[6];
+
+    vtkIdType GrayLevelsOffset(int x, int y, int z) const
+    {
+      return (x - this->Extent[0]) * this->GrayLevelsIncrements[0] + (y - this->Extent[2]) * this->GrayLevelsIncrements[1]
+             + (z - this->Extent[4]) * this->GrayLevelsIncrements[2];
+    }
+
+    vtkIdType AccumulationOffset(int x, int y, int z) const
+    {
+      return (x - this->Extent[0]) * this->AccumulationIncrements[0] + (y - this->Extent[2]) * this->AccumulationIncrements[1]
+             + (z - this->Extent[4]) * this->AccumulationIncrements[2];
+    }
+  };
+
+  //----------------------------------------------------------------------------
+  /*! Run the function on the calling thread and on numberOfThreads-1 additional threads */
+  template <class Function>
+  void RunOnThreads(Function& function, int numberOfThreads)
+  {
+    std::vector<std::thread> threads;
+    for (int threadIndex = 1; threadIndex < numberOfThreads; threadIndex++)
+    {
+      threads.push_back(std::thread(std::ref(function)));
+    }
+    function();
+    for (std::vector<std::thread>::iterator threadIt = threads.begin(); threadIt != threads.end(); ++threadIt)
+    {
+      threadIt->join();
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  template <class T>
+  T ConvertToScalarType(double value)
+  {
+    if (std::numeric_limits<T>::is_integer)
+    {
+      value = std::floor(value + 0.5);
+      value = std::min(std::max(value, static_cast<double>(std::numeric_limits<T>::lowest())), static_cast<double>(std::numeric_limits<T>::max()));
+    }
+    return static_cast<T>(value);
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Weighted average of the known voxels in the cubic neighborhood of a hole, the same as AverageKnownVoxels of the OpenCL kernel */
+  template <class T>
+  bool AverageKnownVoxels(const InputVolume<T>& volume, int x, int y, int z, const HoleFillingElement& element, int halfSize, double& result)
+  {
+    const int xMin = std::max(x - halfSize, volume.Extent[0]);
+    const int xMax = std::min(x + halfSize, volume.Extent[1]);
+    const int yMin = std::max(y - halfSize, volume.Extent[2]);
+    const int yMax = std::min(y + halfSize, volume.Extent[3]);
+    const int zMin = std::max(z - halfSize, volume.Extent[4]);
+    const int zMax = std::min(z + halfSize, volume.Extent[5]);
+    const int allVoxels = (xMax - xMin + 1) * (yMax - yMin + 1) * (zMax - zMin + 1);
+    int knownVoxels = 0;
+    double sum = 0.0;
+    double sumWeights = 0.0;
+    for (int nz = zMin; nz <= zMax; nz++)
+    {
+      for (int ny = yMin; ny <= yMax; ny++)
+      {
+        for (int nx = xMin; nx <= xMax; nx++)
+        {
+          unsigned short neighborAccumulation = volume.Accumulation[volume.AccumulationOffset(nx, ny, nz)];
+          if (neighborAccumulation == 0)
+          {
+            continue;
+          }
+          knownVoxels++;
+          double squaredDistance = (nx - x) * (nx - x) + (ny - y) * (ny - y) + (nz - z) * (nz - z);
+          double weight = 1.0;
+          if (element.Type == vtkPlusFillHolesInVolume::HOLE_FILLING_GAUSSIAN || element.Type == vtkPlusFillHolesInVolume::HOLE_FILLING_GAUSSIAN_ACCUMULATION)
+          {
+            weight = std::exp(-squaredDistance / (2.0 * element.Stdev * element.Stdev));
+            if (element.Type == vtkPlusFillHolesInVolume::HOLE_FILLING_GAUSSIAN_ACCUMULATION)
+            {
+              weight *= neighborAccumulation;
+            }
+          }
+          else if (element.Type == vtkPlusFillHolesInVolume::HOLE_FILLING_DISTANCE_WEIGHT_INVERSE)
+          {
+            // the center voxel is a hole, so the distance is never 0
+            weight = 1.0 / std::sqrt(squaredDistance);
+          }
+          sum += weight * volume.GrayLevels[volume.GrayLevelsOffset(nx, ny, nz)];
+          sumWeights += weight;
+        }
+      }
+    }
+    if (knownVoxels == 0 || knownVoxels < element.MinimumKnownVoxelsRatio * allVoxels || sumWeights <= 0.0)
+    {
+      return false;
+    }
+    result = sum / sumWeights;
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Elements are tried in order until one of them fills the hole. Returns the original value if the hole is not filled. */
+  template <class T>
+  T FillHole(const InputVolume<T>& volume, const std::vector<HoleFillingElement>& elements, int x, int y, int z, T value)
+  {
+    for (std::vector<HoleFillingElement>::const_iterator elementIt = elements.begin(); elementIt != elements.end(); ++elementIt)
+    {
+      int halfSize = elementIt->Size / 2;
+      // Nearest neighbor filling tries increasing neighborhood sizes, the others use the full size
+      int firstHalfSize = (elementIt->Type == vtkPlusFillHolesInVolume::HOLE_FILLING_NEAREST_NEIGHBOR ? 1 : halfSize);
+      double result = 0.0;
+      for (int h = firstHalfSize; h <= halfSize; h++)
+      {
+        if (AverageKnownVoxels(volume, x, y, z, *elementIt, h, result))
+        {
+          return ConvertToScalarType<T>(result);
+        }
+      }
+    }
+    return value;
+  }
+
+  //----------------------------------------------------------------------------
+  template <class T>
+  void FillHolesInExtent(vtkImageData* grayLevels, vtkImageData* accumulationBuffer, const std::vector<HoleFillingElement>& elements, int kernelRadius,
+                         const int fillExtent[6], vtkImageData* output, int numberOfThreads, vtkIdType& numberOfFrontierVoxels)
+  {
+    InputVolume<T> volume;
+    grayLevels->GetExtent(volume.Extent);
+    volume.GrayLevels = static_cast<const T*>(grayLevels->GetScalarPointer(volume.Extent[0], volume.Extent[2], volume.Extent[4]));
+    volume.Accumulation = static_cast<const unsigned short*>(accumulationBuffer->GetScalarPointer(volume.Extent[0], volume.Extent[2], volume.Extent[4]));
+    grayLevels->GetIncrements(volume.GrayLevelsIncrements);
+    accumulationBuffer->GetIncrements(volume.AccumulationIncrements);
+
+    // Region whose known voxels can be used for filling the holes of the fill extent
+    int region[6] = { 0 };
+    int regionSize[3] = { 0 };
+    for (int axis = 0; axis < 3; axis++)
+    {
+      region[axis * 2] = std::max(fillExtent[axis * 2] - kernelRadius, volume.Extent[axis * 2]);
+      region[axis * 2 + 1] = std::min(fillExtent[axis * 2 + 1] + kernelRadius, volume.Extent[axis * 2 + 1]);
+      regionSize[axis] = region[axis * 2 + 1] - region[axis * 2] + 1;
+    }
+    const size_t regionSliceSize = static_cast<size_t>(regionSize[0]) * regionSize[1];
+
+    // Dilate the known voxel mask along x and y by the kernel radius, slice by slice. The dilation along z is done when the frontier is tested.
+    std::vector<unsigned char> nearKnownXY;
+    if (kernelRadius > 0 && !elements.empty())
+    {
+      nearKnownXY.resize(regionSliceSize * regionSize[2]);
+      std::atomic<int> nextSlice(0);
+      std::function<void()> dilateSlices = [&]()
+      {
+        std::vector<int> knownCount(std::max(regionSize[0], regionSize[1]) + 1, 0);
+        std::vector<unsigned char> nearKnownX(regionSliceSize);
+        for (int slice = nextSlice++; slice < regionSize[2]; slice = nextSlice++)
+        {
+          int z = region[4] + slice;
+          for (int j = 0; j < regionSize[1]; j++)
+          {
+            const unsigned short* accumulation = volume.Accumulation + volume.AccumulationOffset(region[0], region[2] + j, z);
+            for (int i = 0; i < regionSize[0]; i++)
+            {
+              knownCount[i + 1] = knownCount[i] + (accumulation[i * volume.AccumulationIncrements[0]] > 0 ? 1 : 0);
+            }
+            for (int i = 0; i < regionSize[0]; i++)
+            {
+              nearKnownX[j * regionSize[0] + i] = (knownCount[std::min(i + kernelRadius + 1, regionSize[0])] - knownCount[std::max(i - kernelRadius, 0)] > 0);
+            }
+          }
+          unsigned char* nearKnown = &nearKnownXY[slice * regionSliceSize];
+          for (int i = 0; i < regionSize[0]; i++)
+          {
+            for (int j = 0; j < regionSize[1]; j++)
+            {
+              knownCount[j + 1] = knownCount[j] + nearKnownX[j * regionSize[0] + i];
+            }
+            for (int j = 0; j < regionSize[1]; j++)
+            {
+              nearKnown[j * regionSize[0] + i] = (knownCount[std::min(j + kernelRadius + 1, regionSize[1])] - knownCount[std::max(j - kernelRadius, 0)] > 0);
+            }
+          }
+        }
+      };
+      RunOnThreads(dilateSlices, std::min(numberOfThreads, regionSize[2]));
+    }
+
+    // Copy the known voxels and fill the holes on the frontier
+    const int fillSizeZ = fillExtent[5] - fillExtent[4] + 1;
+    const vtkIdType outputIncrementX = output->GetIncrements()[0];
+    std::atomic<int> nextSlice(0);
+    std::atomic<vtkIdType> frontierVoxels(0);
+    std::function<void()> fillSlices = [&]()
+    {
+      vtkIdType threadFrontierVoxels = 0;
+      for (int slice = nextSlice++; slice < fillSizeZ; slice = nextSlice++)
+      {
+        int z = fillExtent[4] + slice;
+        int firstRegionSlice = std::max(z - kernelRadius, region[4]) - region[4];
+        int lastRegionSlice = std::min(z + kernelRadius, region[5]) - region[4];
+        for (int y = fillExtent[2]; y <= fillExtent[3]; y++)
+        {
+          T* outputVoxel = static_cast<T*>(output->GetScalarPointer(fillExtent[0], y, z));
+          for (int x = fillExtent[0]; x <= fillExtent[1]; x++, outputVoxel += outputIncrementX)
+          {
+            T value = volume.GrayLevels[volume.GrayLevelsOffset(x, y, z)];
+            if (!nearKnownXY.empty() && volume.Accumulation[volume.AccumulationOffset(x, y, z)] == 0)
+            {
+              size_t nearKnownIndex = static_cast<size_t>(y - region[2]) * regionSize[0] + (x - region[0]);
+              bool frontier = false;
+              for (int regionSlice = firstRegionSlice; regionSlice <= lastRegionSlice && !frontier; regionSlice++)
+              {
+                frontier = (nearKnownXY[regionSlice * regionSliceSize + nearKnownIndex] != 0);
+              }
+              if (frontier)
+              {
+                threadFrontierVoxels++;
+                value = FillHole(volume, elements, x, y, z, value);
+              }
+            }
+            *outputVoxel = value;
+          }
+        }
+      }
+      frontierVoxels += threadFrontierVoxels;
+    };
+    RunOnThreads(fillSlices, std::min(numberOfThreads, fillSizeZ));
+    numberOfFrontierVoxels = frontierVoxels;
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkPlusFillHolesInVolume::vtkPlusFillHolesInVolume()
+  : NumberOfThreads(0)
+  , NumberOfFrontierVoxels(0)
+{
+}
+
+//----------------------------------------------------------------------------
+vtkPlusFillHolesInVolume::~vtkPlusFillHolesInVolume()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusFillHolesInVolume::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfHoleFillingElements: " << this->HoleFillingElements.size() << "\n";
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << "\n";
+  os << indent << "NumberOfFrontierVoxels: " << this->NumberOfFrontierVoxels << "\n";
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusFillHolesInVolume::ReadConfiguration(vtkXMLDataElement* volumeReconstructionElement)
+{
+  XML_VERIFY_ELEMENT(volumeReconstructionElement, "VolumeReconstruction");
+
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfThreads, volumeReconstructionElement);
+
+  this->HoleFillingElements.clear();
+  vtkXMLDataElement* holeFillingElement = volumeReconstructionElement->FindNestedElementWithName("HoleFilling");
+  if (holeFillingElement == NULL)
+  {
+    return PLUS_SUCCESS;
+  }
+  for (int nestedElementIndex = 0; nestedElementIndex < holeFillingElement->GetNumberOfNestedElements(); ++nestedElementIndex)
+  {
+    vtkXMLDataElement* nestedElement = holeFillingElement->GetNestedElement(nestedElementIndex);
+    if (STRCASECMP(nestedElement->GetName(), "HoleFillingElement") != 0)
+    {
+      continue;
+    }
+    HoleFillingElement element;
+    element.Size = 3;
+    element.Stdev = 1.0;
+    element.MinimumKnownVoxelsRatio = 0.5;
+    const char* type = nestedElement->GetAttribute("Type");
+    if (type != NULL && STRCASECMP(type, "GAUSSIAN") == 0)
+    {
+      element.Type = HOLE_FILLING_GAUSSIAN;
+    }
+    else if (type != NULL && STRCASECMP(type, "GAUSSIAN_ACCUMULATION") == 0)
+    {
+      element.Type = HOLE_FILLING_GAUSSIAN_ACCUMULATION;
+    }
+    else if (type != NULL && STRCASECMP(type, "NEAREST_NEIGHBOR") == 0)
+    {
+      element.Type = HOLE_FILLING_NEAREST_NEIGHBOR;
+    }
+    else if (type != NULL && STRCASECMP(type, "DISTANCE_WEIGHT_INVERSE") == 0)
+    {
+      element.Type = HOLE_FILLING_DISTANCE_WEIGHT_INVERSE;
+    }
+    else
+    {
+      LOG_WARNING("Parallel hole filling does not support " << (type != NULL ? type : "(undefined)") << " hole filling element type");
+      return PLUS_FAIL;
+    }
+    nestedElement->GetScalarAttribute("Size", element.Size);
+    nestedElement->GetScalarAttribute("Stdev", element.Stdev);
+    nestedElement->GetScalarAttribute("MinimumKnownVoxelsRatio", element.MinimumKnownVoxelsRatio);
+    if (element.Size < 1)
+    {
+      LOG_ERROR("Invalid hole filling element size: " << element.Size);
+      return PLUS_FAIL;
+    }
+    this->HoleFillingElements.push_back(element);
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusFillHolesInVolume::GetKernelRadius() const
+{
+  int radius = 0;
+  for (std::vector<HoleFillingElement>::const_iterator elementIt = this->HoleFillingElements.begin(); elementIt != this->HoleFillingElements.end(); ++elementIt)
+  {
+    radius = std::max(radius, elementIt->Size / 2);
+  }
+  return radius;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusFillHolesInVolume::FillHoles(vtkImageData* grayLevels, vtkImageData* accumulationBuffer, const int extent[6], vtkImageData* output)
+{
+  this->NumberOfFrontierVoxels = 0;
+  if (grayLevels == NULL || accumulationBuffer == NULL || output == NULL || output == grayLevels)
+  {
+    LOG_ERROR("vtkPlusFillHolesInVolume::FillHoles: invalid volume");
+    return PLUS_FAIL;
+  }
+  if (accumulationBuffer->GetScalarType() != VTK_UNSIGNED_SHORT)
+  {
+    LOG_ERROR("vtkPlusFillHolesInVolume::FillHoles: accumulation buffer must be of unsigned short type");
+    return PLUS_FAIL;
+  }
+  int* volumeExtent = grayLevels->GetExtent();
+  if (!std::equal(volumeExtent, volumeExtent + 6, accumulationBuffer->GetExtent()))
+  {
+    LOG_ERROR("vtkPlusFillHolesInVolume::FillHoles: accumulation buffer extent does not match the gray level volume extent");
+    return PLUS_FAIL;
+  }
+  if (output->GetScalarType() != grayLevels->GetScalarType() || output->GetNumberOfScalarComponents() != 1)
+  {
+    LOG_ERROR("vtkPlusFillHolesInVolume::FillHoles: output must have a single component of the gray level scalar type");
+    return PLUS_FAIL;
+  }
+
+  int fillExtent[6] = { 0 };
+  int* outputExtent = output->GetExtent();
+  for (int axis = 0; axis < 3; axis++)
+  {
+    fillExtent[axis * 2] = std::max(extent[axis * 2], volumeExtent[axis * 2]);
+    fillExtent[axis * 2 + 1] = std::min(extent[axis * 2 + 1], volumeExtent[axis * 2 + 1]);
+    if (fillExtent[axis * 2] > fillExtent[axis * 2 + 1])
+    {
+      // nothing to fill
+      return PLUS_SUCCESS;
+    }
+    if (fillExtent[axis * 2] < outputExtent[axis * 2] || fillExtent[axis * 2 + 1] > outputExtent[axis * 2 + 1])
+    {
+      LOG_ERROR("vtkPlusFillHolesInVolume::FillHoles: output does not contain the filled extent");
+      return PLUS_FAIL;
+    }
+  }
+
+  int numberOfThreads = this->NumberOfThreads;
+  if (numberOfThreads <= 0)
+  {
+    numberOfThreads = std::max<int>(std::thread::hardware_concurrency(), 1);
+  }
+
+  switch (grayLevels->GetScalarType())
+  {
+    vtkTemplateMacro(FillHolesInExtent<VTK_TT>(grayLevels, accumulationBuffer, this->HoleFillingElements, this->GetKernelRadius(), fillExtent,
+                     output, numberOfThreads, this->NumberOfFrontierVoxels));
+    default:
+      LOG_ERROR("vtkPlusFillHolesInVolume::FillHoles: unsupported scalar type " << grayLevels->GetScalarTypeAsString());
+      return PLUS_FAIL;
+  }
+
+  return PLUS_SUCCESS;
+}
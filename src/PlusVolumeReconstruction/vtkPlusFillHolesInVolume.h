@@ -0,0 +1,101 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusFillHolesInVolume_h
+#define __vtkPlusFillHolesInVolume_h
+
+#include "vtkPlusVolumeReconstructionExport.h"
+#include "vtkObject.h"
+
+#include <vector>
+
+class vtkImageData;
+class vtkXMLDataElement;
+
+/*!
+  \class vtkPlusFillHolesInVolume
+  \brief Fills holes of a reconstructed volume on multiple threads, only evaluating holes near known voxels
+
+  vtkIGSIOFillHolesInVolume evaluates the hole filling kernels for every hole of the volume. Most holes of a
+  large volume are far from any pasted slice and cannot be filled, so this class first computes the frontier:
+  the holes that have a known voxel within the kernel radius. The frontier is found by a separable dilation
+  of the known voxel mask and only the frontier voxels are filled. Slices of the volume are processed in parallel.
+
+  Neighbors are read from the whole input volume, therefore filling an extent gives the same result inside the
+  extent as filling the whole volume. This allows updating only the modified regions of a volume.
+
+  The hole filling elements are evaluated as in vtkPlusVolumeReconstructorOpenCL. Supported element types are
+  GAUSSIAN, GAUSSIAN_ACCUMULATION, NEAREST_NEIGHBOR and DISTANCE_WEIGHT_INVERSE.
+
+  Used by vtkPlusVolumeReconstructor if ParallelHoleFilling="TRUE" is specified in the VolumeReconstruction element.
+
+  \ingroup PlusLibVolumeReconstruction
+*/
+class vtkPlusVolumeReconstructionExport vtkPlusFillHolesInVolume : public vtkObject
+{
+public:
+  enum HoleFillingElementType
+  {
+    HOLE_FILLING_GAUSSIAN,
+    HOLE_FILLING_GAUSSIAN_ACCUMULATION,
+    HOLE_FILLING_NEAREST_NEIGHBOR,
+    HOLE_FILLING_DISTANCE_WEIGHT_INVERSE
+  };
+
+  struct HoleFillingElement
+  {
+    HoleFillingElementType Type;
+    /*! Diameter of the largest neighborhood, in voxels */
+    int Size;
+    /*! Standard deviation of the Gaussian weight, in voxels */
+    double Stdev;
+    double MinimumKnownVoxelsRatio;
+  };
+
+  static vtkPlusFillHolesInVolume* New();
+  vtkTypeMacro(vtkPlusFillHolesInVolume, vtkObject);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  /*!
+    Read the hole filling elements and the number of threads from the VolumeReconstruction element.
+    Returns PLUS_FAIL if a hole filling element type is not supported.
+  */
+  PlusStatus ReadConfiguration(vtkXMLDataElement* volumeReconstructionElement);
+
+  /*! Number of threads that fill the holes. If 0 then the number of processors is used. */
+  vtkSetClampMacro(NumberOfThreads, int, 0, VTK_MAX_THREADS);
+  vtkGetMacro(NumberOfThreads, int);
+
+  /*! Largest distance (in voxels, along each axis) of the known voxels that are used for filling a hole */
+  int GetKernelRadius() const;
+
+  /*!
+    Write the gray levels of the voxels inside an extent into the output volume, with the holes filled.
+    Holes that are not on the frontier are copied without evaluating the hole filling elements.
+    \param grayLevels reconstructed gray levels, only the first component is used
+    \param accumulationBuffer VTK_UNSIGNED_SHORT accumulation buffer with the extent of grayLevels, voxels where it is 0 are holes
+    \param extent region of the volume that is written to the output, it is clipped to the volume extent
+    \param output single-component image of the gray level scalar type that contains the extent, must not be the same as grayLevels
+  */
+  PlusStatus FillHoles(vtkImageData* grayLevels, vtkImageData* accumulationBuffer, const int extent[6], vtkImageData* output);
+
+  /*! Number of holes that were evaluated by the last FillHoles call */
+  vtkGetMacro(NumberOfFrontierVoxels, vtkIdType);
+
+protected:
+  vtkPlusFillHolesInVolume();
+  virtual ~vtkPlusFillHolesInVolume();
+
+  std::vector<HoleFillingElement> HoleFillingElements;
+  int NumberOfThreads;
+  vtkIdType NumberOfFrontierVoxels;
+
+private:
+  vtkPlusFillHolesInVolume(const vtkPlusFillHolesInVolume&);  // Not implemented.
+  void operator=(const vtkPlusFillHolesInVolume&);  // Not implemented.
+};
+
+#endif
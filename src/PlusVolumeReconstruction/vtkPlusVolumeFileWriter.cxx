@@ -0,0 +1,362 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+
+#include "PlusParallelDeflate.h"
+#include "vtkPlusVolumeFileWriter.h"
+
+#include "vtkImageData.h"
+#include "vtkObjectFactory.h"
+#include "vtkSmartPointer.h"
+#include <vtksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+vtkStandardNewMacro(vtkPlusVolumeFileWriter);
+
+namespace
+{
+  enum FileFormat
+  {
+    FORMAT_UNKNOWN,
+    FORMAT_METAIMAGE,
+    FORMAT_METAIMAGE_HEADER,
+    FORMAT_NRRD
+  };
+
+  /*! Width of the CompressedDataSize value in MetaImage files, the value is filled in after the voxels are written */
+  const int COMPRESSED_SIZE_FIELD_WIDTH = 20;
+
+  //----------------------------------------------------------------------------
+  FileFormat GetFileFormat(const std::string& filename)
+  {
+    std::string extension = vtksys::SystemTools::LowerCase(vtksys::SystemTools::GetFilenameLastExtension(filename));
+    if (extension == ".mha")
+    {
+      return FORMAT_METAIMAGE;
+    }
+    if (extension == ".mhd")
+    {
+      return FORMAT_METAIMAGE_HEADER;
+    }
+    if (extension == ".nrrd")
+    {
+      return FORMAT_NRRD;
+    }
+    return FORMAT_UNKNOWN;
+  }
+
+  //----------------------------------------------------------------------------
+  bool GetTypeNames(int scalarType, std::string& metaImageType, std::string& nrrdType)
+  {
+    switch (scalarType)
+    {
+      case VTK_CHAR:
+      case VTK_SIGNED_CHAR:
+        metaImageType = "MET_CHAR";
+        nrrdType = "signed char";
+        return true;
+      case VTK_UNSIGNED_CHAR:
+        metaImageType = "MET_UCHAR";
+        nrrdType = "uchar";
+        return true;
+      case VTK_SHORT:
+        metaImageType = "MET_SHORT";
+        nrrdType = "short";
+        return true;
+      case VTK_UNSIGNED_SHORT:
+        metaImageType = "MET_USHORT";
+        nrrdType = "ushort";
+        return true;
+      case VTK_INT:
+        metaImageType = "MET_INT";
+        nrrdType = "int";
+        return true;
+      case VTK_UNSIGNED_INT:
+        metaImageType = "MET_UINT";
+        nrrdType = "uint";
+        return true;
+      case VTK_FLOAT:
+        metaImageType = "MET_FLOAT";
+        nrrdType = "float";
+        return true;
+      case VTK_DOUBLE:
+        metaImageType = "MET_DOUBLE";
+        nrrdType = "double";
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus WriteVoxels(std::ostream& file, vtkImageData* volume, bool useCompression, bool gzipFormat, int compressionLevel, int numberOfThreads,
+                         size_t chunkSizeBytes, unsigned long long& writtenBytes)
+  {
+    const unsigned char* voxels = static_cast<const unsigned char*>(volume->GetScalarPointer());
+    size_t numberOfBytes = static_cast<size_t>(volume->GetNumberOfPoints()) * volume->GetNumberOfScalarComponents() * volume->GetScalarSize();
+    if (useCompression)
+    {
+      PlusParallelDeflate deflate;
+      deflate.SetCompressionLevel(compressionLevel);
+      deflate.SetNumberOfThreads(numberOfThreads);
+      deflate.SetChunkSizeBytes(chunkSizeBytes);
+      if (deflate.Start(file, gzipFormat ? PlusParallelDeflate::FORMAT_GZIP : PlusParallelDeflate::FORMAT_ZLIB) != PLUS_SUCCESS
+          || deflate.Write(voxels, numberOfBytes) != PLUS_SUCCESS
+          || deflate.Finish() != PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+      writtenBytes = deflate.GetCompressedSizeBytes();
+      return PLUS_SUCCESS;
+    }
+    file.write(reinterpret_cast<const char*>(voxels), numberOfBytes);
+    writtenBytes = numberOfBytes;
+    return file.good() ? PLUS_SUCCESS : PLUS_FAIL;
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkPlusVolumeFileWriter::vtkPlusVolumeFileWriter()
+  : UseCompression(true)
+  , CompressionLevel(-1)
+  , NumberOfThreads(0)
+  , ChunkSizeBytes(4 * 1024 * 1024)
+  , BackgroundWriteStatus(PLUS_SUCCESS)
+  , BackgroundWriteInProgress(false)
+{
+}
+
+//----------------------------------------------------------------------------
+vtkPlusVolumeFileWriter::~vtkPlusVolumeFileWriter()
+{
+  this->WaitForBackgroundWrite();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusVolumeFileWriter::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "UseCompression: " << (this->UseCompression ? "TRUE" : "FALSE") << "\n";
+  os << indent << "CompressionLevel: " << this->CompressionLevel << "\n";
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << "\n";
+  os << indent << "ChunkSizeBytes: " << this->ChunkSizeBytes << "\n";
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusVolumeFileWriter::CanWriteFile(const std::string& filename)
+{
+  return GetFileFormat(filename) != FORMAT_UNKNOWN;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVolumeFileWriter::Write(vtkImageData* volume, const std::string& filename)
+{
+  this->WaitForBackgroundWrite();
+  return this->WriteVolume(volume, filename, this->UseCompression, this->CompressionLevel, this->NumberOfThreads, this->ChunkSizeBytes);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVolumeFileWriter::WriteInBackground(vtkImageData* volume, const std::string& filename)
+{
+  this->WaitForBackgroundWrite();
+  if (volume == NULL)
+  {
+    LOG_ERROR("vtkPlusVolumeFileWriter::WriteInBackground: invalid input volume");
+    return PLUS_FAIL;
+  }
+
+  std::lock_guard<std::mutex> lock(this->BackgroundWriteMutex);
+  this->BackgroundWriteInProgress = true;
+  this->BackgroundWriteStatus = PLUS_SUCCESS;
+  vtkSmartPointer<vtkImageData> volumeToWrite = volume;
+  bool useCompression = this->UseCompression;
+  int compressionLevel = this->CompressionLevel;
+  int numberOfThreads = this->NumberOfThreads;
+  int chunkSizeBytes = this->ChunkSizeBytes;
+  this->BackgroundThread = std::thread([this, volumeToWrite, filename, useCompression, compressionLevel, numberOfThreads, chunkSizeBytes]()
+  {
+    PlusStatus status = this->WriteVolume(volumeToWrite, filename, useCompression, compressionLevel, numberOfThreads, chunkSizeBytes);
+    std::lock_guard<std::mutex> statusLock(this->BackgroundWriteMutex);
+    this->BackgroundWriteStatus = status;
+    this->BackgroundWriteInProgress = false;
+  });
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVolumeFileWriter::WaitForBackgroundWrite()
+{
+  if (this->BackgroundThread.joinable())
+  {
+    this->BackgroundThread.join();
+  }
+  std::lock_guard<std::mutex> lock(this->BackgroundWriteMutex);
+  PlusStatus status = this->BackgroundWriteStatus;
+  this->BackgroundWriteStatus = PLUS_SUCCESS;
+  return status;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusVolumeFileWriter::IsWritingInBackground()
+{
+  std::lock_guard<std::mutex> lock(this->BackgroundWriteMutex);
+  return this->BackgroundWriteInProgress;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVolumeFileWriter::WriteVolume(vtkImageData* volume, const std::string& filename, bool useCompression, int compressionLevel, int numberOfThreads, int chunkSizeBytes)
+{
+  if (volume == NULL || volume->GetScalarPointer() == NULL)
+  {
+    LOG_ERROR("vtkPlusVolumeFileWriter::Write: invalid input volume");
+    return PLUS_FAIL;
+  }
+  FileFormat format = GetFileFormat(filename);
+  if (format == FORMAT_UNKNOWN)
+  {
+    LOG_ERROR("vtkPlusVolumeFileWriter::Write: unsupported file format: " << filename);
+    return PLUS_FAIL;
+  }
+  std::string metaImageType;
+  std::string nrrdType;
+  if (!GetTypeNames(volume->GetScalarType(), metaImageType, nrrdType))
+  {
+    LOG_ERROR("vtkPlusVolumeFileWriter::Write: unsupported scalar type: " << volume->GetScalarTypeAsString());
+    return PLUS_FAIL;
+  }
+  if (numberOfThreads <= 0)
+  {
+    numberOfThreads = std::max<int>(std::thread::hardware_concurrency(), 1);
+  }
+
+  int dims[3] = { 0, 0, 0 };
+  volume->GetDimensions(dims);
+  int* extent = volume->GetExtent();
+  double* spacing = volume->GetSpacing();
+  double* origin = volume->GetOrigin();
+  // Position of the first voxel, the extent of the volume may not start at 0
+  double offset[3] = { origin[0] + extent[0] * spacing[0], origin[1] + extent[2] * spacing[1], origin[2] + extent[4] * spacing[2] };
+  int numberOfComponents = volume->GetNumberOfScalarComponents();
+#ifdef VTK_WORDS_BIGENDIAN
+  const bool bigEndian = true;
+#else
+  const bool bigEndian = false;
+#endif
+
+  std::ofstream file(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file.is_open())
+  {
+    LOG_ERROR("vtkPlusVolumeFileWriter::Write: failed to open file for writing: " << filename);
+    return PLUS_FAIL;
+  }
+  file << std::setprecision(std::numeric_limits<double>::digits10 + 1);
+
+  unsigned long long writtenBytes = 0;
+  if (format == FORMAT_NRRD)
+  {
+    file << "NRRD0004\n";
+    file << "# Complete NRRD file format specification at:\n";
+    file << "# http://teem.sourceforge.net/nrrd/format.html\n";
+    file << "type: " << nrrdType << "\n";
+    file << "dimension: " << (numberOfComponents > 1 ? 4 : 3) << "\n";
+    file << "space: left-posterior-superior\n";
+    file << "sizes: ";
+    if (numberOfComponents > 1)
+    {
+      file << numberOfComponents << " ";
+    }
+    file << dims[0] << " " << dims[1] << " " << dims[2] << "\n";
+    file << "space directions: " << (numberOfComponents > 1 ? "none " : "")
+         << "(" << spacing[0] << ",0,0) (0," << spacing[1] << ",0) (0,0," << spacing[2] << ")\n";
+    file << "kinds: " << (numberOfComponents > 1 ? "vector " : "") << "domain domain domain\n";
+    file << "endian: " << (bigEndian ? "big" : "little") << "\n";
+    file << "encoding: " << (useCompression ? "gzip" : "raw") << "\n";
+    file << "space origin: (" << offset[0] << "," << offset[1] << "," << offset[2] << ")\n\n";
+    if (WriteVoxels(file, volume, useCompression, true, compressionLevel, numberOfThreads, chunkSizeBytes, writtenBytes) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("vtkPlusVolumeFileWriter::Write: failed to write voxel data to " << filename);
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  // MetaImage header
+  std::ostringstream header;
+  header << std::setprecision(std::numeric_limits<double>::digits10 + 1);
+  header << "ObjectType = Image\n";
+  header << "NDims = 3\n";
+  header << "BinaryData = True\n";
+  header << "BinaryDataByteOrderMSB = " << (bigEndian ? "True" : "False") << "\n";
+  header << "CompressedData = " << (useCompression ? "True" : "False") << "\n";
+  std::string headerStart = header.str();
+  header.str("");
+  header << "TransformMatrix = 1 0 0 0 1 0 0 0 1\n";
+  header << "Offset = " << offset[0] << " " << offset[1] << " " << offset[2] << "\n";
+  header << "CenterOfRotation = 0 0 0\n";
+  header << "AnatomicalOrientation = RAI\n";
+  header << "ElementSpacing = " << spacing[0] << " " << spacing[1] << " " << spacing[2] << "\n";
+  header << "DimSize = " << dims[0] << " " << dims[1] << " " << dims[2] << "\n";
+  if (numberOfComponents > 1)
+  {
+    header << "ElementNumberOfChannels = " << numberOfComponents << "\n";
+  }
+  header << "ElementType = " << metaImageType << "\n";
+  std::string headerEnd = header.str();
+
+  if (format == FORMAT_METAIMAGE_HEADER)
+  {
+    // Voxels are written to a separate data file, the header is written when the compressed size is known
+    std::string dataFilename = vtksys::SystemTools::GetFilenameWithoutLastExtension(filename) + (useCompression ? ".zraw" : ".raw");
+    std::string dataFilePath = vtksys::SystemTools::GetFilenamePath(filename);
+    dataFilePath = (dataFilePath.empty() ? dataFilename : dataFilePath + "/" + dataFilename);
+    std::ofstream dataFile(dataFilePath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!dataFile.is_open())
+    {
+      LOG_ERROR("vtkPlusVolumeFileWriter::Write: failed to open file for writing: " << dataFilePath);
+      return PLUS_FAIL;
+    }
+    if (WriteVoxels(dataFile, volume, useCompression, false, compressionLevel, numberOfThreads, chunkSizeBytes, writtenBytes) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("vtkPlusVolumeFileWriter::Write: failed to write voxel data to " << dataFilePath);
+      return PLUS_FAIL;
+    }
+    file << headerStart;
+    if (useCompression)
+    {
+      file << "CompressedDataSize = " << writtenBytes << "\n";
+    }
+    file << headerEnd << "ElementDataFile = " << dataFilename << "\n";
+    return file.good() ? PLUS_SUCCESS : PLUS_FAIL;
+  }
+
+  file << headerStart;
+  std::streampos compressedSizePosition = 0;
+  if (useCompression)
+  {
+    file << "CompressedDataSize = ";
+    compressedSizePosition = file.tellp();
+    file << std::setw(COMPRESSED_SIZE_FIELD_WIDTH) << 0 << "\n";
+  }
+  file << headerEnd << "ElementDataFile = LOCAL\n";
+  if (WriteVoxels(file, volume, useCompression, false, compressionLevel, numberOfThreads, chunkSizeBytes, writtenBytes) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("vtkPlusVolumeFileWriter::Write: failed to write voxel data to " << filename);
+    return PLUS_FAIL;
+  }
+  if (useCompression)
+  {
+    file.seekp(compressedSizePosition);
+    file << std::setw(COMPRESSED_SIZE_FIELD_WIDTH) << writtenBytes;
+  }
+  return file.good() ? PLUS_SUCCESS : PLUS_FAIL;
+}
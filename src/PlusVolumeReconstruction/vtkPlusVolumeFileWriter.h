@@ -0,0 +1,99 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusVolumeFileWriter_h
+#define __vtkPlusVolumeFileWriter_h
+
+#include "vtkPlusVolumeReconstructionExport.h"
+#include "vtkObject.h"
+
+#include <mutex>
+#include <string>
+#include <thread>
+
+class vtkImageData;
+
+/*!
+  \class vtkPlusVolumeFileWriter
+  \brief Writes a volume to a MetaImage or NRRD file, compressing the voxels on multiple threads
+
+  The voxel data is split into chunks that are deflate-compressed in parallel. Each chunk but the last one is terminated
+  by a sync flush, so the concatenated chunks form a single standard deflate stream, which is wrapped into a zlib stream
+  (MetaImage) or a gzip member (NRRD) with the combined checksum. Any MetaImage or NRRD reader can read the files.
+  Compressed chunks are written to the file in order as soon as they are ready and only a few chunks are kept in memory.
+
+  Supported file formats are .mha, .mhd (with a .raw or .zraw data file) and .nrrd.
+
+  A volume can also be written on a background thread. The writer keeps a reference to the volume, which must not be
+  modified until the writing is completed.
+
+  \ingroup PlusLibVolumeReconstruction
+*/
+class vtkPlusVolumeReconstructionExport vtkPlusVolumeFileWriter : public vtkObject
+{
+public:
+  static vtkPlusVolumeFileWriter* New();
+  vtkTypeMacro(vtkPlusVolumeFileWriter, vtkObject);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  /*! Returns true if the format of the file (determined from the file extension) can be written */
+  static bool CanWriteFile(const std::string& filename);
+
+  /*! Write the volume to file. Waits for the completion of the previous background write. */
+  PlusStatus Write(vtkImageData* volume, const std::string& filename);
+
+  /*!
+    Start writing the volume to file on a background thread and return immediately.
+    Waits for the completion of the previous background write. The result is reported by WaitForBackgroundWrite.
+  */
+  PlusStatus WriteInBackground(vtkImageData* volume, const std::string& filename);
+
+  /*! Wait until the background write is completed and return its result. Returns PLUS_SUCCESS if there is no background write. */
+  PlusStatus WaitForBackgroundWrite();
+
+  /*! Returns true if a background write is in progress */
+  bool IsWritingInBackground();
+
+  /*! If enabled then the voxels are compressed */
+  vtkSetMacro(UseCompression, bool);
+  vtkGetMacro(UseCompression, bool);
+  vtkBooleanMacro(UseCompression, bool);
+
+  /*! zlib compression level (1 = fastest, 9 = smallest), -1 means the zlib default */
+  vtkSetClampMacro(CompressionLevel, int, -1, 9);
+  vtkGetMacro(CompressionLevel, int);
+
+  /*! Number of threads that compress the chunks. If 0 then the number of processors is used. */
+  vtkSetClampMacro(NumberOfThreads, int, 0, VTK_MAX_THREADS);
+  vtkGetMacro(NumberOfThreads, int);
+
+  /*! Size of the uncompressed chunks, in bytes */
+  vtkSetClampMacro(ChunkSizeBytes, int, 65536, VTK_INT_MAX);
+  vtkGetMacro(ChunkSizeBytes, int);
+
+protected:
+  vtkPlusVolumeFileWriter();
+  virtual ~vtkPlusVolumeFileWriter();
+
+  /*! Write the volume with the current settings, called from Write and from the background thread */
+  PlusStatus WriteVolume(vtkImageData* volume, const std::string& filename, bool useCompression, int compressionLevel, int numberOfThreads, int chunkSizeBytes);
+
+  bool UseCompression;
+  int CompressionLevel;
+  int NumberOfThreads;
+  int ChunkSizeBytes;
+
+  std::thread BackgroundThread;
+  PlusStatus BackgroundWriteStatus;
+  bool BackgroundWriteInProgress;
+  std::mutex BackgroundWriteMutex;
+
+private:
+  vtkPlusVolumeFileWriter(const vtkPlusVolumeFileWriter&);  // Not implemented.
+  void operator=(const vtkPlusVolumeFileWriter&);  // Not implemented.
+};
+
+#endif
@@ -6,30 +6,880 @@
 
 // Local includes
 #include "PlusConfigure.h"
+#include "PlusProfiler.h"
+#include "vtkPlusFillHolesInVolume.h"
 #include "vtkPlusSequenceIO.h"
+#include "vtkPlusSequenceStreamReader.h"
+#include "vtkPlusVolumeFileWriter.h"
 #include "vtkPlusVolumeReconstructor.h"
+#ifdef PLUS_USE_OPENCL
+#include "vtkPlusVolumeReconstructorOpenCL.h"
+#endif
+
+// IGSIO includes
+#include <igsioTrackedFrame.h>
+#include <vtkIGSIOFillHolesInVolume.h>
+#include <vtkIGSIOPasteSliceIntoVolume.h>
+#include <vtkIGSIOTrackedFrameList.h>
+#include <vtkIGSIOTransformRepository.h>
 
 // VTK includes
+#include <vtkImageClip.h>
+#include <vtkImageData.h>
 #include <vtkImageFlip.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
 #include <vtkObjectFactory.h>
 #include <vtkPNGReader.h>
+#include <vtkXMLDataElement.h>
+
+// STL includes
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+vtkStandardNewMacro(vtkPlusVolumeReconstructor);
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  /*! Largest distance (in voxels) from which the hole filling elements of the configuration use voxel values */
+  int GetHoleFillingKernelRadius(vtkXMLDataElement* reconConfig)
+  {
+    int radius = 0;
+    vtkXMLDataElement* holeFillingElement = reconConfig->FindNestedElementWithName("HoleFilling");
+    if (holeFillingElement == NULL)
+    {
+      return radius;
+    }
+    for (int nestedElementIndex = 0; nestedElementIndex < holeFillingElement->GetNumberOfNestedElements(); ++nestedElementIndex)
+    {
+      vtkXMLDataElement* nestedElement = holeFillingElement->GetNestedElement(nestedElementIndex);
+      int size = 0;
+      if (nestedElement->GetScalarAttribute("Size", size))
+      {
+        radius = std::max(radius, size / 2);
+      }
+      int stickLengthLimit = 0;
+      if (nestedElement->GetScalarAttribute("StickLengthLimit", stickLengthLimit))
+      {
+        radius = std::max(radius, stickLengthLimit);
+      }
+    }
+    return radius;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Returns true if the plane through planePoint with planeNormal intersects the axis-aligned box */
+  bool PlaneIntersectsBox(const double planeNormal[3], const double planePoint[3], const double boxMin[3], const double boxMax[3])
+  {
+    double minDistance = VTK_DOUBLE_MAX;
+    double maxDistance = -VTK_DOUBLE_MAX;
+    for (int corner = 0; corner < 8; corner++)
+    {
+      double cornerPoint[3] = { (corner & 1) ? boxMax[0] : boxMin[0], (corner & 2) ? boxMax[1] : boxMin[1], (corner & 4) ? boxMax[2] : boxMin[2] };
+      double distance = 0;
+      for (int axis = 0; axis < 3; axis++)
+      {
+        distance += planeNormal[axis] * (cornerPoint[axis] - planePoint[axis]);
+      }
+      minDistance = std::min(minDistance, distance);
+      maxDistance = std::max(maxDistance, distance);
+    }
+    return minDistance <= 0 && maxDistance >= 0;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Compute the intersection of two extents. Returns false if the intersection is empty. */
+  bool IntersectExtents(const int extent1[6], const int extent2[6], int intersection[6])
+  {
+    for (int axis = 0; axis < 3; axis++)
+    {
+      intersection[axis * 2] = std::max(extent1[axis * 2], extent2[axis * 2]);
+      intersection[axis * 2 + 1] = std::min(extent1[axis * 2 + 1], extent2[axis * 2 + 1]);
+      if (intersection[axis * 2] > intersection[axis * 2 + 1])
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  template <class ScalarType>
+  void CopyFirstComponent(vtkImageData* source, vtkImageData* destination, const int extent[6])
+  {
+    int numberOfSourceComponents = source->GetNumberOfScalarComponents();
+    int rowLength = extent[1] - extent[0] + 1;
+    for (int z = extent[4]; z <= extent[5]; z++)
+    {
+      for (int y = extent[2]; y <= extent[3]; y++)
+      {
+        ScalarType* sourcePixel = static_cast<ScalarType*>(source->GetScalarPointer(extent[0], y, z));
+        ScalarType* destinationPixel = static_cast<ScalarType*>(destination->GetScalarPointer(extent[0], y, z));
+        for (int x = 0; x < rowLength; x++)
+        {
+          destinationPixel[x] = sourcePixel[x * numberOfSourceComponents];
+        }
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus CopyFirstComponentInExtent(vtkImageData* source, vtkImageData* destination, const int extent[6])
+  {
+    switch (destination->GetScalarType())
+    {
+      vtkTemplateMacro(CopyFirstComponent<VTK_TT>(source, destination, extent));
+      default:
+        LOG_ERROR("Unsupported scalar type: " << destination->GetScalarTypeAsString());
+        return PLUS_FAIL;
+    }
+    destination->Modified();
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Change the extent and origin of a volume extracted from a brick, so that its voxel indices are the same as in the whole volume */
+  void SetBrickExtentInVolume(vtkImageData* brickVolume, const double volumeOrigin[3])
+  {
+    double* brickOrigin = brickVolume->GetOrigin();
+    double* spacing = brickVolume->GetSpacing();
+    int* brickExtent = brickVolume->GetExtent();
+    int extentInVolume[6] = { 0 };
+    for (int axis = 0; axis < 3; axis++)
+    {
+      int offset = static_cast<int>(floor((brickOrigin[axis] - volumeOrigin[axis]) / spacing[axis] + 0.5));
+      extentInVolume[axis * 2] = brickExtent[axis * 2] + offset;
+      extentInVolume[axis * 2 + 1] = brickExtent[axis * 2 + 1] + offset;
+    }
+    brickVolume->SetExtent(extentInVolume);
+    brickVolume->SetOrigin(volumeOrigin[0], volumeOrigin[1], volumeOrigin[2]);
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkPlusVolumeReconstructor::vtkPlusVolumeReconstructor()
+  : Backend(BACKEND_CPU)
+  , OpenCLReconstructor(NULL)
+  , SparseBrickSizeVoxels(0)
+  , SparseBrickMarginVoxels(0)
+  , StreamingChunkSizeFrames(16)
+  , StreamingNumberOfReadAheadChunks(2)
+  , ParallelHoleFilling(false)
+  , ParallelHoleFiller(vtkSmartPointer<vtkPlusFillHolesInVolume>::New())
+{
+  int emptyExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  std::copy(emptyExtent, emptyExtent + 6, this->SparseBricksVolumeExtent);
+  std::fill(this->SparseBricksVolumeOrigin, this->SparseBricksVolumeOrigin + 3, 0.0);
+  std::fill(this->SparseBricksVolumeSpacing, this->SparseBricksVolumeSpacing + 3, 1.0);
+}
+
+//----------------------------------------------------------------------------
+vtkPlusVolumeReconstructor::~vtkPlusVolumeReconstructor()
+{
+#ifdef PLUS_USE_OPENCL
+  if (this->OpenCLReconstructor != NULL)
+  {
+    this->OpenCLReconstructor->Delete();
+    this->OpenCLReconstructor = NULL;
+  }
+#endif
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusVolumeReconstructor::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Backend: " << (this->Backend == BACKEND_OPENCL ? "OpenCL" : "CPU") << std::endl;
+  os << indent << "SparseBrickSizeVoxels: " << this->SparseBrickSizeVoxels << std::endl;
+  os << indent << "NumberOfAllocatedSparseBricks: " << this->SparseBricks.size() << std::endl;
+  os << indent << "StreamingChunkSizeFrames: " << this->StreamingChunkSizeFrames << std::endl;
+  os << indent << "StreamingNumberOfReadAheadChunks: " << this->StreamingNumberOfReadAheadChunks << std::endl;
+  os << indent << "ParallelHoleFilling: " << (this->ParallelHoleFilling ? "TRUE" : "FALSE") << std::endl;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVolumeReconstructor::ReadConfiguration(vtkXMLDataElement* config)
+{
+  if (this->Superclass::ReadConfiguration(config) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  XML_FIND_NESTED_ELEMENT_REQUIRED(reconConfig, config, "VolumeReconstruction");
+
+  this->Backend = BACKEND_CPU;
+  XML_READ_ENUM2_ATTRIBUTE_OPTIONAL(Backend, reconConfig, "CPU", BACKEND_CPU, "OpenCL", BACKEND_OPENCL);
+#ifdef PLUS_USE_OPENCL
+  if (this->Backend == BACKEND_OPENCL)
+  {
+    if (this->OpenCLReconstructor == NULL)
+    {
+      this->OpenCLReconstructor = vtkPlusVolumeReconstructorOpenCL::New();
+    }
+    if (this->OpenCLReconstructor->ReadConfiguration(reconConfig) != PLUS_SUCCESS)
+    {
+      LOG_WARNING("OpenCL processing does not support the volume reconstruction settings, volume reconstruction is performed on the CPU");
+      this->Backend = BACKEND_CPU;
+    }
+  }
+#endif
+
+  this->ClearSparseBricks();
+  this->SparseBrickSizeVoxels = 0;
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, SparseBrickSizeVoxels, reconConfig);
+  this->SparseBrickMarginVoxels = this->GetFillHoles() ? GetHoleFillingKernelRadius(reconConfig) : 0;
+  if (this->SparseBrickSizeVoxels > 0 && this->Backend == BACKEND_OPENCL)
+  {
+    LOG_WARNING("Sparse volume storage is not supported by the OpenCL backend, a dense volume is reconstructed on the device");
+  }
+
+  this->ParallelHoleFilling = false;
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(ParallelHoleFilling, reconConfig);
+  if (this->ParallelHoleFilling && this->ParallelHoleFiller->ReadConfiguration(reconConfig) != PLUS_SUCCESS)
+  {
+    LOG_WARNING("Parallel hole filling does not support the hole filling settings, holes are filled by vtkIGSIOFillHolesInVolume");
+    this->ParallelHoleFilling = false;
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVolumeReconstructor::WriteConfiguration(vtkXMLDataElement* config)
+{
+  if (this->Superclass::WriteConfiguration(config) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  XML_FIND_NESTED_ELEMENT_CREATE_IF_MISSING(reconConfig, config, "VolumeReconstruction");
+
+  if (this->Backend == BACKEND_OPENCL)
+  {
+    reconConfig->SetAttribute("Backend", "OpenCL");
+  }
+  else
+  {
+    reconConfig->RemoveAttribute("Backend");
+  }
+  if (this->SparseBrickSizeVoxels > 0)
+  {
+    reconConfig->SetIntAttribute("SparseBrickSizeVoxels", this->SparseBrickSizeVoxels);
+  }
+  else
+  {
+    reconConfig->RemoveAttribute("SparseBrickSizeVoxels");
+  }
+  if (this->ParallelHoleFilling)
+  {
+    XML_WRITE_BOOL_ATTRIBUTE(ParallelHoleFilling, reconConfig);
+  }
+  else
+  {
+    reconConfig->RemoveAttribute("ParallelHoleFilling");
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVolumeReconstructor::AddTrackedFrame(igsioTrackedFrame* frame, vtkIGSIOTransformRepository* transformRepository,
+    bool isFirst/*=true*/, bool isLast/*=true*/, bool* insertedIntoVolume/*=NULL*/)
+{
+  PLUS_PROFILE_SCOPE("vtkPlusVolumeReconstructor::AddTrackedFrame");
+  if (this->Backend == BACKEND_OPENCL && this->PrepareOpenCLVolume() == PLUS_SUCCESS)
+  {
+#ifdef PLUS_USE_OPENCL
+    vtkImageData* frameImage = frame->GetImageData()->GetImage();
+    if (frameImage->GetScalarType() == VTK_UNSIGNED_CHAR && frameImage->GetNumberOfScalarComponents() == 1)
+    {
+      if (insertedIntoVolume != NULL)
+      {
+        *insertedIntoVolume = false;
+      }
+
+      // Pixel indices of the frame to voxel indices of the volume buffer on the device
+      vtkSmartPointer<vtkMatrix4x4> imageToVolumeIndexMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+      bool isMatrixValid = false;
+      if (this->GetImageToVolumeIndexMatrix(transformRepository, imageToVolumeIndexMatrix, isMatrixValid) != PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+      if (!isMatrixValid)
+      {
+        // Frame is not inserted, as in the CPU reconstruction
+        return PLUS_SUCCESS;
+      }
+
+      vtkPlusVolumeReconstructorOpenCL::SliceClipping clipping;
+      std::copy(this->GetClipRectangleOrigin(), this->GetClipRectangleOrigin() + 2, clipping.ClipRectangleOrigin);
+      std::copy(this->GetClipRectangleSize(), this->GetClipRectangleSize() + 2, clipping.ClipRectangleSize);
+      clipping.FanClipping = this->FanClippingApplied();
+      std::copy(this->GetFanOrigin(), this->GetFanOrigin() + 2, clipping.FanOrigin);
+      std::copy(this->GetFanAnglesDeg(), this->GetFanAnglesDeg() + 2, clipping.FanAnglesDeg);
+      clipping.FanRadiusStartPixel = this->GetFanRadiusStartPixel();
+      clipping.FanRadiusStopPixel = this->GetFanRadiusStopPixel();
+
+      if (this->OpenCLReconstructor->PasteSlice(frameImage, imageToVolumeIndexMatrix, clipping) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to paste the frame into the volume on the OpenCL device");
+        return PLUS_FAIL;
+      }
+      if (insertedIntoVolume != NULL)
+      {
+        *insertedIntoVolume = true;
+      }
+      return PLUS_SUCCESS;
+    }
+    LOG_WARNING("OpenCL processing only supports single-component unsigned char frames, volume reconstruction is performed on the CPU");
+    this->Backend = BACKEND_CPU;
+#endif
+  }
+  if (this->UseSparseBricks())
+  {
+    return this->AddTrackedFrameToSparseBricks(frame, transformRepository, isFirst, isLast, insertedIntoVolume);
+  }
+  return this->Superclass::AddTrackedFrame(frame, transformRepository, isFirst, isLast, insertedIntoVolume);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVolumeReconstructor::ExtractGrayLevels(vtkImageData* reconstructedVolume)
+{
+  if (this->Backend == BACKEND_OPENCL && this->PrepareOpenCLVolume() == PLUS_SUCCESS)
+  {
+    return this->ExtractVolumeOpenCL(reconstructedVolume, NULL);
+  }
+  if (this->UseSparseBricks())
+  {
+    int outputExtent[6] = { 0, -1, 0, -1, 0, -1 };
+    this->Reconstructor->GetOutputExtent(outputExtent);
+    return this->ExtractSparseVolume(outputExtent, reconstructedVolume, NULL);
+  }
+  if (this->UseParallelHoleFilling())
+  {
+    vtkImageData* volume = this->Reconstructor->GetReconstructedVolume();
+    if (volume == NULL || reconstructedVolume == NULL)
+    {
+      LOG_ERROR("vtkPlusVolumeReconstructor::ExtractGrayLevels: invalid volume");
+      return PLUS_FAIL;
+    }
+    reconstructedVolume->SetExtent(volume->GetExtent());
+    reconstructedVolume->SetOrigin(volume->GetOrigin());
+    reconstructedVolume->SetSpacing(volume->GetSpacing());
+    reconstructedVolume->AllocateScalars(volume->GetScalarType(), 1);
+    return this->ParallelHoleFiller->FillHoles(volume, this->Reconstructor->GetAccumulationBuffer(), volume->GetExtent(), reconstructedVolume);
+  }
+  return this->Superclass::ExtractGrayLevels(reconstructedVolume);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVolumeReconstructor::ExtractAccumulation(vtkImageData* accumulationBuffer)
+{
+  if (this->Backend == BACKEND_OPENCL && this->PrepareOpenCLVolume() == PLUS_SUCCESS)
+  {
+    return this->ExtractVolumeOpenCL(NULL, accumulationBuffer);
+  }
+  if (this->UseSparseBricks())
+  {
+    int outputExtent[6] = { 0, -1, 0, -1, 0, -1 };
+    this->Reconstructor->GetOutputExtent(outputExtent);
+    return this->ExtractSparseVolume(outputExtent, NULL, accumulationBuffer);
+  }
+  return this->Superclass::ExtractAccumulation(accumulationBuffer);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVolumeReconstructor::ExtractSubVolume(const int extent[6], vtkImageData* grayLevels, vtkImageData* accumulationBuffer/*=NULL*/)
+{
+  if (this->UseSparseBricks())
+  {
+    return this->ExtractSparseVolume(extent, grayLevels, accumulationBuffer);
+  }
+
+  // Dense volume: extract the whole volume and crop it
+  int outputExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  double outputOrigin[3] = { 0 };
+  this->Reconstructor->GetOutputExtent(outputExtent);
+  this->Reconstructor->GetOutputOrigin(outputOrigin);
+  int subExtent[6] = { 0 };
+  if (!IntersectExtents(extent, outputExtent, subExtent))
+  {
+    LOG_ERROR("vtkPlusVolumeReconstructor::ExtractSubVolume: the requested extent is outside of the output extent");
+    return PLUS_FAIL;
+  }
+  vtkImageData* subVolumes[2] = { grayLevels, accumulationBuffer };
+  for (int i = 0; i < 2; i++)
+  {
+    if (subVolumes[i] == NULL)
+    {
+      continue;
+    }
+    vtkSmartPointer<vtkImageData> volume = vtkSmartPointer<vtkImageData>::New();
+    if ((i == 0 ? this->ExtractGrayLevels(volume) : this->ExtractAccumulation(volume)) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    SetBrickExtentInVolume(volume, outputOrigin);
+    subVolumes[i]->SetExtent(subExtent);
+    subVolumes[i]->SetOrigin(volume->GetOrigin());
+    subVolumes[i]->SetSpacing(volume->GetSpacing());
+    subVolumes[i]->AllocateScalars(volume->GetScalarType(), 1);
+    if (CopyFirstComponentInExtent(volume, subVolumes[i], subExtent) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusVolumeReconstructor::Reset()
+{
+  this->ClearSparseBricks();
+  if (this->UseSparseBricks())
+  {
+    // The dense volume is not allocated in sparse storage mode
+    return;
+  }
+  this->Superclass::Reset();
+#ifdef PLUS_USE_OPENCL
+  if (this->OpenCLReconstructor != NULL && this->OpenCLReconstructor->IsInitialized())
+  {
+    int* volumeExtent = this->OpenCLReconstructor->GetVolumeExtent();
+    if (volumeExtent[1] >= volumeExtent[0])
+    {
+      // Reallocation clears the volume
+      int extent[6] = { volumeExtent[0], volumeExtent[1], volumeExtent[2], volumeExtent[3], volumeExtent[4], volumeExtent[5] };
+      this->OpenCLReconstructor->AllocateVolume(extent);
+    }
+  }
+#endif
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVolumeReconstructor::PrepareOpenCLVolume()
+{
+#ifdef PLUS_USE_OPENCL
+  if (this->OpenCLReconstructor == NULL)
+  {
+    this->OpenCLReconstructor = vtkPlusVolumeReconstructorOpenCL::New();
+  }
+  if (this->GetEnableFanAnglesAutoDetect())
+  {
+    LOG_WARNING("OpenCL processing does not support fan angle auto-detection, volume reconstruction is performed on the CPU");
+    this->Backend = BACKEND_CPU;
+    return PLUS_FAIL;
+  }
+  if (!this->OpenCLReconstructor->IsInitialized() && this->OpenCLReconstructor->Initialize() != PLUS_SUCCESS)
+  {
+    LOG_WARNING("OpenCL processing is not available, volume reconstruction is performed on the CPU");
+    this->Backend = BACKEND_CPU;
+    return PLUS_FAIL;
+  }
+  int outputExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  this->Reconstructor->GetOutputExtent(outputExtent);
+  int* volumeExtent = this->OpenCLReconstructor->GetVolumeExtent();
+  if (!std::equal(outputExtent, outputExtent + 6, volumeExtent)
+      && this->OpenCLReconstructor->AllocateVolume(outputExtent) != PLUS_SUCCESS)
+  {
+    LOG_WARNING("OpenCL processing failed, volume reconstruction is performed on the CPU");
+    this->Backend = BACKEND_CPU;
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+#else
+  LOG_WARNING("Plus is built without OpenCL support (PLUS_USE_OPENCL), volume reconstruction is performed on the CPU");
+  this->Backend = BACKEND_CPU;
+  return PLUS_FAIL;
+#endif
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVolumeReconstructor::ExtractVolumeOpenCL(vtkImageData* grayLevels, vtkImageData* accumulationBuffer)
+{
+#ifdef PLUS_USE_OPENCL
+  if (this->OpenCLReconstructor->ExtractVolume(grayLevels, accumulationBuffer, this->GetFillHoles()) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to extract the volume from the OpenCL device");
+    return PLUS_FAIL;
+  }
+  double outputOrigin[3] = { 0 };
+  double outputSpacing[3] = { 0 };
+  this->Reconstructor->GetOutputOrigin(outputOrigin);
+  this->Reconstructor->GetOutputSpacing(outputSpacing);
+  vtkImageData* volumes[2] = { grayLevels, accumulationBuffer };
+  for (int i = 0; i < 2; i++)
+  {
+    if (volumes[i] != NULL)
+    {
+      volumes[i]->SetOrigin(outputOrigin);
+      volumes[i]->SetSpacing(outputSpacing);
+    }
+  }
+  return PLUS_SUCCESS;
+#else
+  LOG_ERROR("Plus is built without OpenCL support (PLUS_USE_OPENCL)");
+  return PLUS_FAIL;
+#endif
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVolumeReconstructor::GetImageToVolumeIndexMatrix(vtkIGSIOTransformRepository* transformRepository, vtkMatrix4x4* imageToVolumeIndexMatrix, bool& isValid)
+{
+  igsioTransformName imageToReferenceTransformName(this->GetImageCoordinateFrame(), this->GetReferenceCoordinateFrame());
+  vtkSmartPointer<vtkMatrix4x4> imageToReferenceMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  isValid = false;
+  if (transformRepository->GetTransform(imageToReferenceTransformName, imageToReferenceMatrix, &isValid) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to get transform '" << imageToReferenceTransformName.GetTransformName() << "' from transform repository");
+    return PLUS_FAIL;
+  }
+
+  int outputExtent[6] = { 0 };
+  double outputOrigin[3] = { 0 };
+  double outputSpacing[3] = { 0 };
+  this->Reconstructor->GetOutputExtent(outputExtent);
+  this->Reconstructor->GetOutputOrigin(outputOrigin);
+  this->Reconstructor->GetOutputSpacing(outputSpacing);
+  vtkSmartPointer<vtkMatrix4x4> referenceToVolumeIndexMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  for (int axis = 0; axis < 3; axis++)
+  {
+    referenceToVolumeIndexMatrix->SetElement(axis, axis, 1.0 / outputSpacing[axis]);
+    referenceToVolumeIndexMatrix->SetElement(axis, 3, -outputOrigin[axis] / outputSpacing[axis] - outputExtent[axis * 2]);
+  }
+  vtkMatrix4x4::Multiply4x4(referenceToVolumeIndexMatrix, imageToReferenceMatrix, imageToVolumeIndexMatrix);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusVolumeReconstructor::SetSparseBrickSizeVoxels(int brickSizeVoxels)
+{
+  brickSizeVoxels = std::max(brickSizeVoxels, 0);
+  if (brickSizeVoxels == this->SparseBrickSizeVoxels)
+  {
+    return;
+  }
+  this->ClearSparseBricks();
+  this->SparseBrickSizeVoxels = brickSizeVoxels;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusVolumeReconstructor::GetNumberOfAllocatedSparseBricks() const
+{
+  return static_cast<int>(this->SparseBricks.size());
+}
+
+//----------------------------------------------------------------------------
+size_t vtkPlusVolumeReconstructor::GetMemoryUsageBytes()
+{
+  if (this->UseSparseBricks())
+  {
+    size_t memoryUsageBytes = 0;
+    for (std::map< std::array<int, 3>, vtkSmartPointer<vtkPlusVolumeReconstructor> >::iterator brickIt = this->SparseBricks.begin(); brickIt != this->SparseBricks.end(); ++brickIt)
+    {
+      memoryUsageBytes += brickIt->second->GetMemoryUsageBytes();
+    }
+    return memoryUsageBytes;
+  }
+
+  // GetActualMemorySize returns kibibytes
+  size_t memoryUsageBytes = 0;
+  if (this->Reconstructor->GetReconstructedVolume() != NULL)
+  {
+    memoryUsageBytes += static_cast<size_t>(this->Reconstructor->GetReconstructedVolume()->GetActualMemorySize()) * 1024;
+  }
+  if (this->Reconstructor->GetAccumulationBuffer() != NULL)
+  {
+    memoryUsageBytes += static_cast<size_t>(this->Reconstructor->GetAccumulationBuffer()->GetActualMemorySize()) * 1024;
+  }
+  return memoryUsageBytes;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusVolumeReconstructor::UseSparseBricks() const
+{
+  return this->SparseBrickSizeVoxels > 0 && this->Backend == BACKEND_CPU;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusVolumeReconstructor::UseParallelHoleFilling()
+{
+  return this->ParallelHoleFilling && this->GetFillHoles() && this->Backend == BACKEND_CPU;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVolumeReconstructor::AddTrackedFrameToSparseBricks(igsioTrackedFrame* frame, vtkIGSIOTransformRepository* transformRepository,
+    bool isFirst, bool isLast, bool* insertedIntoVolume)
+{
+  if (insertedIntoVolume != NULL)
+  {
+    *insertedIntoVolume = false;
+  }
+  this->UpdateSparseBricksGeometry();
+
+  vtkSmartPointer<vtkMatrix4x4> imageToVolumeIndexMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  bool isMatrixValid = false;
+  if (this->GetImageToVolumeIndexMatrix(transformRepository, imageToVolumeIndexMatrix, isMatrixValid) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  if (!isMatrixValid)
+  {
+    // Frame is not inserted, as in the dense reconstruction
+    return PLUS_SUCCESS;
+  }
+
+  // Pasted region of the frame
+  int* frameExtent = frame->GetImageData()->GetImage()->GetExtent();
+  double pixelMin[2] = { static_cast<double>(frameExtent[0]), static_cast<double>(frameExtent[2]) };
+  double pixelMax[2] = { static_cast<double>(frameExtent[1]), static_cast<double>(frameExtent[3]) };
+  int* clipRectangleOrigin = this->GetClipRectangleOrigin();
+  int* clipRectangleSize = this->GetClipRectangleSize();
+  if (clipRectangleSize[0] > 0 && clipRectangleSize[1] > 0)
+  {
+    for (int axis = 0; axis < 2; axis++)
+    {
+      pixelMin[axis] = std::max<double>(pixelMin[axis], clipRectangleOrigin[axis]);
+      pixelMax[axis] = std::min<double>(pixelMax[axis], clipRectangleOrigin[axis] + clipRectangleSize[axis] - 1);
+    }
+  }
+
+  // Bounding box of the pasted region in voxel indices
+  double boxMin[3] = { VTK_DOUBLE_MAX, VTK_DOUBLE_MAX, VTK_DOUBLE_MAX };
+  double boxMax[3] = { -VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX };
+  for (int corner = 0; corner < 4; corner++)
+  {
+    double pixel[4] = { (corner & 1) ? pixelMax[0] : pixelMin[0], (corner & 2) ? pixelMax[1] : pixelMin[1], 0.0, 1.0 };
+    double voxel[4] = { 0 };
+    imageToVolumeIndexMatrix->MultiplyPoint(pixel, voxel);
+    for (int axis = 0; axis < 3; axis++)
+    {
+      boxMin[axis] = std::min(boxMin[axis], voxel[axis]);
+      boxMax[axis] = std::max(boxMax[axis], voxel[axis]);
+    }
+  }
+
+  // Range of bricks that may be within reach of the pasted pixels. One voxel is added for interpolation.
+  const int brickSize = this->SparseBrickSizeVoxels;
+  const double reach = this->SparseBrickMarginVoxels + 1.0;
+  int brickMin[3] = { 0 };
+  int brickMax[3] = { 0 };
+  for (int axis = 0; axis < 3; axis++)
+  {
+    int volumeSize = this->SparseBricksVolumeExtent[axis * 2 + 1] - this->SparseBricksVolumeExtent[axis * 2] + 1;
+    int numberOfBricks = (volumeSize + brickSize - 1) / brickSize;
+    brickMin[axis] = std::max(static_cast<int>(floor((boxMin[axis] - reach) / brickSize)), 0);
+    brickMax[axis] = std::min(static_cast<int>(floor((boxMax[axis] + reach) / brickSize)), numberOfBricks - 1);
+    if (brickMin[axis] > brickMax[axis])
+    {
+      // the frame is outside of the volume
+      return PLUS_SUCCESS;
+    }
+  }
+
+  // Frame plane in voxel indices
+  double planeAxis1[3] = { imageToVolumeIndexMatrix->GetElement(0, 0), imageToVolumeIndexMatrix->GetElement(1, 0), imageToVolumeIndexMatrix->GetElement(2, 0) };
+  double planeAxis2[3] = { imageToVolumeIndexMatrix->GetElement(0, 1), imageToVolumeIndexMatrix->GetElement(1, 1), imageToVolumeIndexMatrix->GetElement(2, 1) };
+  double planePoint[3] = { imageToVolumeIndexMatrix->GetElement(0, 3), imageToVolumeIndexMatrix->GetElement(1, 3), imageToVolumeIndexMatrix->GetElement(2, 3) };
+  double planeNormal[3] = { 0 };
+  vtkMath::Cross(planeAxis1, planeAxis2, planeNormal);
+
+  std::array<int, 3> brickIndex = { { 0, 0, 0 } };
+  for (brickIndex[2] = brickMin[2]; brickIndex[2] <= brickMax[2]; brickIndex[2]++)
+  {
+    for (brickIndex[1] = brickMin[1]; brickIndex[1] <= brickMax[1]; brickIndex[1]++)
+    {
+      for (brickIndex[0] = brickMin[0]; brickIndex[0] <= brickMax[0]; brickIndex[0]++)
+      {
+        double brickBoxMin[3] = { 0 };
+        double brickBoxMax[3] = { 0 };
+        for (int axis = 0; axis < 3; axis++)
+        {
+          brickBoxMin[axis] = brickIndex[axis] * brickSize - reach;
+          brickBoxMax[axis] = (brickIndex[axis] + 1) * brickSize - 1 + reach;
+        }
+        if (!PlaneIntersectsBox(planeNormal, planePoint, brickBoxMin, brickBoxMax))
+        {
+          continue;
+        }
+        vtkPlusVolumeReconstructor* brick = this->GetOrCreateSparseBrick(brickIndex);
+        if (brick == NULL)
+        {
+          return PLUS_FAIL;
+        }
+        bool insertedIntoBrick = false;
+        if (brick->AddTrackedFrame(frame, transformRepository, isFirst, isLast, &insertedIntoBrick) != PLUS_SUCCESS)
+        {
+          return PLUS_FAIL;
+        }
+        if (insertedIntoBrick && insertedIntoVolume != NULL)
+        {
+          *insertedIntoVolume = true;
+        }
+      }
+    }
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVolumeReconstructor::ExtractSparseVolume(const int extent[6], vtkImageData* grayLevels, vtkImageData* accumulationBuffer)
+{
+  this->UpdateSparseBricksGeometry();
+  int requestedExtent[6] = { 0 };
+  if (!IntersectExtents(extent, this->SparseBricksVolumeExtent, requestedExtent))
+  {
+    LOG_ERROR("vtkPlusVolumeReconstructor::ExtractSparseVolume: the requested extent is outside of the output extent");
+    return PLUS_FAIL;
+  }
+
+  vtkImageData* outputs[2] = { grayLevels, accumulationBuffer };
+  bool outputAllocated[2] = { false, false };
+  for (std::map< std::array<int, 3>, vtkSmartPointer<vtkPlusVolumeReconstructor> >::iterator brickIt = this->SparseBricks.begin(); brickIt != this->SparseBricks.end(); ++brickIt)
+  {
+    // Each voxel is taken from the brick that owns it, the margin of the bricks is only used for hole filling
+    int coreExtent[6] = { 0 };
+    this->GetSparseBrickCoreExtent(brickIt->first, coreExtent);
+    int copiedExtent[6] = { 0 };
+    if (!IntersectExtents(coreExtent, requestedExtent, copiedExtent))
+    {
+      continue;
+    }
+    for (int i = 0; i < 2; i++)
+    {
+      if (outputs[i] == NULL)
+      {
+        continue;
+      }
+      vtkSmartPointer<vtkImageData> brickVolume = vtkSmartPointer<vtkImageData>::New();
+      if ((i == 0 ? brickIt->second->ExtractGrayLevels(brickVolume) : brickIt->second->ExtractAccumulation(brickVolume)) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("vtkPlusVolumeReconstructor::ExtractSparseVolume: extracting brick (" << brickIt->first[0] << ", " << brickIt->first[1] << ", " << brickIt->first[2] << ") failed");
+        return PLUS_FAIL;
+      }
+      SetBrickExtentInVolume(brickVolume, this->SparseBricksVolumeOrigin);
+      if (!outputAllocated[i])
+      {
+        outputs[i]->SetExtent(requestedExtent);
+        outputs[i]->SetOrigin(this->SparseBricksVolumeOrigin);
+        outputs[i]->SetSpacing(this->SparseBricksVolumeSpacing);
+        outputs[i]->AllocateScalars(brickVolume->GetScalarType(), 1);
+        memset(outputs[i]->GetScalarPointer(), 0, outputs[i]->GetNumberOfPoints() * outputs[i]->GetScalarSize());
+        outputAllocated[i] = true;
+      }
+      if (CopyFirstComponentInExtent(brickVolume, outputs[i], copiedExtent) != PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+    }
+  }
 
-vtkStandardNewMacro(vtkPlusVolumeReconstructor);
+  // Empty outputs if no brick intersects the extent
+  const int emptyScalarTypes[2] = { VTK_UNSIGNED_CHAR, VTK_UNSIGNED_SHORT };
+  for (int i = 0; i < 2; i++)
+  {
+    if (outputs[i] != NULL && !outputAllocated[i])
+    {
+      outputs[i]->SetExtent(requestedExtent);
+      outputs[i]->SetOrigin(this->SparseBricksVolumeOrigin);
+      outputs[i]->SetSpacing(this->SparseBricksVolumeSpacing);
+      outputs[i]->AllocateScalars(emptyScalarTypes[i], 1);
+      memset(outputs[i]->GetScalarPointer(), 0, outputs[i]->GetNumberOfPoints() * outputs[i]->GetScalarSize());
+    }
+  }
+  return PLUS_SUCCESS;
+}
 
 //----------------------------------------------------------------------------
-vtkPlusVolumeReconstructor::vtkPlusVolumeReconstructor()
+vtkPlusVolumeReconstructor* vtkPlusVolumeReconstructor::GetOrCreateSparseBrick(const std::array<int, 3>& brickIndex)
 {
+  std::map< std::array<int, 3>, vtkSmartPointer<vtkPlusVolumeReconstructor> >::iterator existingBrick = this->SparseBricks.find(brickIndex);
+  if (existingBrick != this->SparseBricks.end())
+  {
+    return existingBrick->second;
+  }
+
+  if (this->SparseBrickConfiguration == NULL)
+  {
+    vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::New();
+    configRootElement->SetName("PlusConfiguration");
+    if (this->WriteConfiguration(configRootElement) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("vtkPlusVolumeReconstructor::GetOrCreateSparseBrick: failed to write configuration for the bricks");
+      return NULL;
+    }
+    this->SparseBrickConfiguration = configRootElement;
+  }
+
+  vtkSmartPointer<vtkPlusVolumeReconstructor> brick = vtkSmartPointer<vtkPlusVolumeReconstructor>::New();
+  if (brick->ReadConfiguration(this->SparseBrickConfiguration) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("vtkPlusVolumeReconstructor::GetOrCreateSparseBrick: failed to configure brick");
+    return NULL;
+  }
+  brick->SetBackend(BACKEND_CPU);
+  brick->SetSparseBrickSizeVoxels(0);
+
+  int brickExtent[6] = { 0 };
+  this->GetSparseBrickCoreExtent(brickIndex, brickExtent);
+  for (int axis = 0; axis < 3; axis++)
+  {
+    brickExtent[axis * 2] = std::max(brickExtent[axis * 2] - this->SparseBrickMarginVoxels, this->SparseBricksVolumeExtent[axis * 2]);
+    brickExtent[axis * 2 + 1] = std::min(brickExtent[axis * 2 + 1] + this->SparseBrickMarginVoxels, this->SparseBricksVolumeExtent[axis * 2 + 1]);
+  }
+  brick->SetOutputOrigin(this->SparseBricksVolumeOrigin);
+  brick->SetOutputSpacing(this->SparseBricksVolumeSpacing);
+  brick->SetOutputExtent(brickExtent);
+
+  this->SparseBricks[brickIndex] = brick;
+  LOG_DEBUG("Sparse volume brick (" << brickIndex[0] << ", " << brickIndex[1] << ", " << brickIndex[2] << ") allocated, number of bricks: " << this->SparseBricks.size());
+  return brick;
 }
 
 //----------------------------------------------------------------------------
-vtkPlusVolumeReconstructor::~vtkPlusVolumeReconstructor()
+void vtkPlusVolumeReconstructor::GetSparseBrickCoreExtent(const std::array<int, 3>& brickIndex, int coreExtent[6]) const
 {
+  for (int axis = 0; axis < 3; axis++)
+  {
+    coreExtent[axis * 2] = this->SparseBricksVolumeExtent[axis * 2] + brickIndex[axis] * this->SparseBrickSizeVoxels;
+    coreExtent[axis * 2 + 1] = std::min(coreExtent[axis * 2] + this->SparseBrickSizeVoxels - 1, this->SparseBricksVolumeExtent[axis * 2 + 1]);
+  }
 }
 
 //----------------------------------------------------------------------------
-void vtkPlusVolumeReconstructor::PrintSelf(ostream& os, vtkIndent indent)
+void vtkPlusVolumeReconstructor::UpdateSparseBricksGeometry()
 {
-  this->Superclass::PrintSelf(os, indent);
+  int outputExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  double outputOrigin[3] = { 0 };
+  double outputSpacing[3] = { 0 };
+  this->Reconstructor->GetOutputExtent(outputExtent);
+  this->Reconstructor->GetOutputOrigin(outputOrigin);
+  this->Reconstructor->GetOutputSpacing(outputSpacing);
+  if (std::equal(outputExtent, outputExtent + 6, this->SparseBricksVolumeExtent)
+      && std::equal(outputOrigin, outputOrigin + 3, this->SparseBricksVolumeOrigin)
+      && std::equal(outputSpacing, outputSpacing + 3, this->SparseBricksVolumeSpacing))
+  {
+    return;
+  }
+  this->ClearSparseBricks();
+  std::copy(outputExtent, outputExtent + 6, this->SparseBricksVolumeExtent);
+  std::copy(outputOrigin, outputOrigin + 3, this->SparseBricksVolumeOrigin);
+  std::copy(outputSpacing, outputSpacing + 3, this->SparseBricksVolumeSpacing);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusVolumeReconstructor::ClearSparseBricks()
+{
+  this->SparseBricks.clear();
+  // Reconstruction parameters may be changed before the next brick is created
+  this->SparseBrickConfiguration = NULL;
 }
 
 //----------------------------------------------------------------------------
@@ -55,6 +905,609 @@ igsioStatus vtkPlusVolumeReconstructor::SaveReconstructedVolumeToFile(const std:
   return vtkPlusVolumeReconstructor::SaveReconstructedVolumeToFile(volumeToSave, filename, useCompression);
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVolumeReconstructor::UpdateGrayLevels(vtkImageData* grayLevels, const int extent[6], int holeFillingMarginVoxels)
+{
+  if (this->Backend == BACKEND_OPENCL && grayLevels != NULL)
+  {
+    // The volume is on the device, where hole filling of the whole volume is fast, so only the copy is limited to the extent
+    vtkSmartPointer<vtkImageData> deviceGrayLevels = vtkSmartPointer<vtkImageData>::New();
+    if (this->ExtractGrayLevels(deviceGrayLevels) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    if (this->Backend == BACKEND_OPENCL)
+    {
+      if (!std::equal(deviceGrayLevels->GetExtent(), deviceGrayLevels->GetExtent() + 6, grayLevels->GetExtent())
+          || grayLevels->GetScalarType() != deviceGrayLevels->GetScalarType() || grayLevels->GetNumberOfScalarComponents() != 1)
+      {
+        LOG_ERROR("vtkPlusVolumeReconstructor::UpdateGrayLevels: gray level volume does not match the reconstructed volume");
+        return PLUS_FAIL;
+      }
+      int deviceUpdateExtent[6] = { 0 };
+      if (!IntersectExtents(extent, deviceGrayLevels->GetExtent(), deviceUpdateExtent))
+      {
+        // nothing to update
+        return PLUS_SUCCESS;
+      }
+      return CopyFirstComponentInExtent(deviceGrayLevels, grayLevels, deviceUpdateExtent);
+    }
+  }
+
+  if (this->UseSparseBricks() && grayLevels != NULL)
+  {
+    // Bricks fill their holes when they are extracted, so only the bricks that intersect the extent are processed
+    int sparseUpdateExtent[6] = { 0 };
+    if (!IntersectExtents(extent, grayLevels->GetExtent(), sparseUpdateExtent))
+    {
+      // nothing to update
+      return PLUS_SUCCESS;
+    }
+    vtkSmartPointer<vtkImageData> subVolume = vtkSmartPointer<vtkImageData>::New();
+    if (this->ExtractSubVolume(sparseUpdateExtent, subVolume) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    if (grayLevels->GetScalarType() != subVolume->GetScalarType() || grayLevels->GetNumberOfScalarComponents() != 1)
+    {
+      LOG_ERROR("vtkPlusVolumeReconstructor::UpdateGrayLevels: gray level volume must have a single component of the reconstructed volume scalar type");
+      return PLUS_FAIL;
+    }
+    return CopyFirstComponentInExtent(subVolume, grayLevels, subVolume->GetExtent());
+  }
+
+  vtkImageData* reconstructedVolume = this->Reconstructor->GetReconstructedVolume();
+  if (grayLevels == NULL || reconstructedVolume == NULL)
+  {
+    LOG_ERROR("vtkPlusVolumeReconstructor::UpdateGrayLevels: invalid volume");
+    return PLUS_FAIL;
+  }
+
+  int* volumeExtent = reconstructedVolume->GetExtent();
+  int* grayLevelsExtent = grayLevels->GetExtent();
+  for (int i = 0; i < 6; i++)
+  {
+    if (volumeExtent[i] != grayLevelsExtent[i])
+    {
+      LOG_ERROR("vtkPlusVolumeReconstructor::UpdateGrayLevels: gray level volume extent does not match the reconstructed volume extent");
+      return PLUS_FAIL;
+    }
+  }
+  if (grayLevels->GetScalarType() != reconstructedVolume->GetScalarType() || grayLevels->GetNumberOfScalarComponents() != 1)
+  {
+    LOG_ERROR("vtkPlusVolumeReconstructor::UpdateGrayLevels: gray level volume must have a single component of the reconstructed volume scalar type");
+    return PLUS_FAIL;
+  }
+
+  int updateExtent[6] = {0};
+  if (!IntersectExtents(extent, volumeExtent, updateExtent))
+  {
+    // nothing to update
+    return PLUS_SUCCESS;
+  }
+
+  if (this->UseParallelHoleFilling())
+  {
+    // Neighbors of the holes are read from the whole volume, so only the voxels of the extent are processed
+    return this->ParallelHoleFiller->FillHoles(reconstructedVolume, this->Reconstructor->GetAccumulationBuffer(), updateExtent, grayLevels);
+  }
+
+  vtkImageData* sourceVolume = reconstructedVolume;
+  vtkSmartPointer<vtkImageClip> volumeClip;
+  vtkSmartPointer<vtkImageClip> accumulationBufferClip;
+  if (this->GetFillHoles())
+  {
+    // Fill holes only in the region around the updated extent that the hole filling kernels can reach
+    int fillExtent[6] = {0};
+    for (int axis = 0; axis < 3; axis++)
+    {
+      fillExtent[axis * 2] = std::max(updateExtent[axis * 2] - holeFillingMarginVoxels, volumeExtent[axis * 2]);
+      fillExtent[axis * 2 + 1] = std::min(updateExtent[axis * 2 + 1] + holeFillingMarginVoxels, volumeExtent[axis * 2 + 1]);
+    }
+    volumeClip = vtkSmartPointer<vtkImageClip>::New();
+    volumeClip->SetInputData(reconstructedVolume);
+    volumeClip->SetOutputWholeExtent(fillExtent);
+    volumeClip->ClipDataOn();
+    volumeClip->Update();
+    accumulationBufferClip = vtkSmartPointer<vtkImageClip>::New();
+    accumulationBufferClip->SetInputData(this->Reconstructor->GetAccumulationBuffer());
+    accumulationBufferClip->SetOutputWholeExtent(fillExtent);
+    accumulationBufferClip->ClipDataOn();
+    accumulationBufferClip->Update();
+
+    this->HoleFiller->SetReconstructedVolume(volumeClip->GetOutput());
+    this->HoleFiller->SetAccumulationBuffer(accumulationBufferClip->GetOutput());
+    this->HoleFiller->Update();
+    sourceVolume = this->HoleFiller->GetOutput();
+  }
+
+  return CopyFirstComponentInExtent(sourceVolume, grayLevels, updateExtent);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVolumeReconstructor::ReconstructInParallelBricks(vtkIGSIOTrackedFrameList* trackedFrameList, vtkIGSIOTransformRepository* transformRepository,
+    int numberOfWorkers, int holeFillingMarginVoxels, vtkImageData* grayLevels, vtkImageData* accumulationBuffer/*=NULL*/, int* numberOfFramesAddedToVolume/*=NULL*/)
+{
+  if (trackedFrameList == NULL || transformRepository == NULL || grayLevels == NULL)
+  {
+    LOG_ERROR("vtkPlusVolumeReconstructor::ReconstructInParallelBricks: invalid input");
+    return PLUS_FAIL;
+  }
+
+  int volumeExtent[6] = { 0 };
+  double volumeOrigin[3] = { 0 };
+  double volumeSpacing[3] = { 0 };
+  this->Reconstructor->GetOutputExtent(volumeExtent);
+  this->Reconstructor->GetOutputOrigin(volumeOrigin);
+  this->Reconstructor->GetOutputSpacing(volumeSpacing);
+
+  // Split the volume along its longest axis
+  int splitAxis = 0;
+  for (int axis = 1; axis < 3; axis++)
+  {
+    if (volumeExtent[axis * 2 + 1] - volumeExtent[axis * 2] > volumeExtent[splitAxis * 2 + 1] - volumeExtent[splitAxis * 2])
+    {
+      splitAxis = axis;
+    }
+  }
+  int volumeSizeAlongSplitAxis = volumeExtent[splitAxis * 2 + 1] - volumeExtent[splitAxis * 2] + 1;
+  if (volumeSizeAlongSplitAxis < 1)
+  {
+    LOG_ERROR("vtkPlusVolumeReconstructor::ReconstructInParallelBricks: output extent is not set");
+    return PLUS_FAIL;
+  }
+  if (numberOfWorkers <= 0)
+  {
+    numberOfWorkers = std::max<int>(std::thread::hardware_concurrency(), 1);
+  }
+  numberOfWorkers = std::min(numberOfWorkers, volumeSizeAlongSplitAxis);
+  if (!this->GetFillHoles())
+  {
+    holeFillingMarginVoxels = 0;
+  }
+
+  vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::New();
+  configRootElement->SetName("PlusConfiguration");
+  if (this->WriteConfiguration(configRootElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("vtkPlusVolumeReconstructor::ReconstructInParallelBricks: failed to write configuration for the workers");
+    return PLUS_FAIL;
+  }
+
+  // Each worker owns an extent of the volume (brick core) and reconstructs it with some surrounding voxels
+  std::vector< vtkSmartPointer<vtkPlusVolumeReconstructor> > workers(numberOfWorkers);
+  std::vector< vtkSmartPointer<vtkIGSIOTransformRepository> > workerTransformRepositories(numberOfWorkers);
+  std::vector< std::array<int, 6> > brickCoreExtents(numberOfWorkers);
+  for (int workerIndex = 0; workerIndex < numberOfWorkers; workerIndex++)
+  {
+    std::array<int, 6> coreExtent = { volumeExtent[0], volumeExtent[1], volumeExtent[2], volumeExtent[3], volumeExtent[4], volumeExtent[5] };
+    coreExtent[splitAxis * 2] = volumeExtent[splitAxis * 2] + (volumeSizeAlongSplitAxis * workerIndex) / numberOfWorkers;
+    coreExtent[splitAxis * 2 + 1] = volumeExtent[splitAxis * 2] + (volumeSizeAlongSplitAxis * (workerIndex + 1)) / numberOfWorkers - 1;
+    brickCoreExtents[workerIndex] = coreExtent;
+
+    int brickExtent[6] = { coreExtent[0], coreExtent[1], coreExtent[2], coreExtent[3], coreExtent[4], coreExtent[5] };
+    brickExtent[splitAxis * 2] = std::max(coreExtent[splitAxis * 2] - holeFillingMarginVoxels, volumeExtent[splitAxis * 2]);
+    brickExtent[splitAxis * 2 + 1] = std::min(coreExtent[splitAxis * 2 + 1] + holeFillingMarginVoxels, volumeExtent[splitAxis * 2 + 1]);
+
+    workers[workerIndex] = vtkSmartPointer<vtkPlusVolumeReconstructor>::New();
+    if (workers[workerIndex]->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("vtkPlusVolumeReconstructor::ReconstructInParallelBricks: failed to configure worker " << workerIndex);
+      return PLUS_FAIL;
+    }
+    workers[workerIndex]->SetBackend(BACKEND_CPU);
+    workers[workerIndex]->SetSparseBrickSizeVoxels(0);
+    workers[workerIndex]->SetOutputOrigin(volumeOrigin);
+    workers[workerIndex]->SetOutputSpacing(volumeSpacing);
+    workers[workerIndex]->SetOutputExtent(brickExtent);
+
+    workerTransformRepositories[workerIndex] = vtkSmartPointer<vtkIGSIOTransformRepository>::New();
+    workerTransformRepositories[workerIndex]->DeepCopy(transformRepository);
+  }
+
+  // All workers paste all frames, the slice pasting skips the pixels that fall outside the brick
+  const int numberOfFrames = trackedFrameList->GetNumberOfTrackedFrames();
+  const int skipInterval = std::max(this->GetSkipInterval(), 1);
+  std::vector<PlusStatus> workerStatus(numberOfWorkers, PLUS_SUCCESS);
+  std::vector<int> workerFramesAddedToVolume(numberOfWorkers, 0);
+  std::vector<std::thread> threads;
+  for (int workerIndex = 0; workerIndex < numberOfWorkers; workerIndex++)
+  {
+    threads.push_back(std::thread([&, workerIndex]()
+    {
+      vtkPlusVolumeReconstructor* worker = workers[workerIndex];
+      vtkIGSIOTransformRepository* workerTransformRepository = workerTransformRepositories[workerIndex];
+      for (int frameIndex = 0; frameIndex < numberOfFrames; frameIndex += skipInterval)
+      {
+        igsioTrackedFrame* frame = trackedFrameList->GetTrackedFrame(frameIndex);
+        if (workerTransformRepository->SetTransforms(*frame) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to update transform repository with frame #" << frameIndex);
+          workerStatus[workerIndex] = PLUS_FAIL;
+          continue;
+        }
+        bool insertedIntoVolume = false;
+        bool isFirst = frameIndex == 0;
+        bool isLast = frameIndex + skipInterval >= numberOfFrames;
+        if (worker->AddTrackedFrame(frame, workerTransformRepository, isFirst, isLast, &insertedIntoVolume) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to add tracked frame to volume with frame #" << frameIndex);
+          workerStatus[workerIndex] = PLUS_FAIL;
+          continue;
+        }
+        if (insertedIntoVolume)
+        {
+          workerFramesAddedToVolume[workerIndex]++;
+        }
+      }
+    }));
+  }
+  for (std::vector<std::thread>::iterator threadIt = threads.begin(); threadIt != threads.end(); ++threadIt)
+  {
+    threadIt->join();
+  }
+
+  // Compose the output from the brick cores
+  PlusStatus status = PLUS_SUCCESS;
+  for (int workerIndex = 0; workerIndex < numberOfWorkers; workerIndex++)
+  {
+    if (workerStatus[workerIndex] != PLUS_SUCCESS)
+    {
+      status = PLUS_FAIL;
+    }
+
+    vtkSmartPointer<vtkImageData> brickGrayLevels = vtkSmartPointer<vtkImageData>::New();
+    if (workers[workerIndex]->ExtractGrayLevels(brickGrayLevels) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("vtkPlusVolumeReconstructor::ReconstructInParallelBricks: extracting gray levels of brick " << workerIndex << " failed");
+      return PLUS_FAIL;
+    }
+    SetBrickExtentInVolume(brickGrayLevels, volumeOrigin);
+    if (workerIndex == 0)
+    {
+      grayLevels->SetExtent(volumeExtent);
+      grayLevels->SetOrigin(volumeOrigin);
+      grayLevels->SetSpacing(volumeSpacing);
+      grayLevels->AllocateScalars(brickGrayLevels->GetScalarType(), 1);
+    }
+    if (CopyFirstComponentInExtent(brickGrayLevels, grayLevels, brickCoreExtents[workerIndex].data()) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+
+    if (accumulationBuffer != NULL)
+    {
+      vtkSmartPointer<vtkImageData> brickAccumulationBuffer = vtkSmartPointer<vtkImageData>::New();
+      if (workers[workerIndex]->ExtractAccumulation(brickAccumulationBuffer) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("vtkPlusVolumeReconstructor::ReconstructInParallelBricks: extracting accumulation buffer of brick " << workerIndex << " failed");
+        return PLUS_FAIL;
+      }
+      SetBrickExtentInVolume(brickAccumulationBuffer, volumeOrigin);
+      if (workerIndex == 0)
+      {
+        accumulationBuffer->SetExtent(volumeExtent);
+        accumulationBuffer->SetOrigin(volumeOrigin);
+        accumulationBuffer->SetSpacing(volumeSpacing);
+        accumulationBuffer->AllocateScalars(brickAccumulationBuffer->GetScalarType(), 1);
+      }
+      if (CopyFirstComponentInExtent(brickAccumulationBuffer, accumulationBuffer, brickCoreExtents[workerIndex].data()) != PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+    }
+  }
+
+  if (numberOfFramesAddedToVolume != NULL)
+  {
+    // Frames are inserted the same way into all bricks
+    *numberOfFramesAddedToVolume = workerFramesAddedToVolume[0];
+  }
+
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVolumeReconstructor::ReconstructFromSequenceFile(const std::string& inputSeqFilename, vtkIGSIOTransformRepository* transformRepository,
+    bool setOutputExtentFromFrames, std::string& errorDetail, int* numberOfFramesAddedToVolume/*=NULL*/, int* numberOfFrames/*=NULL*/,
+    const SequenceProgressCallback& progressCallback/*=SequenceProgressCallback()*/)
+{
+  errorDetail.clear();
+  if (numberOfFramesAddedToVolume != NULL)
+  {
+    *numberOfFramesAddedToVolume = 0;
+  }
+  if (numberOfFrames != NULL)
+  {
+    *numberOfFrames = 0;
+  }
+  if (transformRepository == NULL)
+  {
+    errorDetail = "invalid transform repository";
+    LOG_ERROR("vtkPlusVolumeReconstructor::ReconstructFromSequenceFile: " << errorDetail);
+    return PLUS_FAIL;
+  }
+
+  int framesAddedToVolume = 0;
+  PlusStatus status = PLUS_SUCCESS;
+  bool cancelled = false;
+
+  if (!vtkPlusSequenceStreamReader::CanReadFile(inputSeqFilename))
+  {
+    LOG_WARNING("Sequence file " << inputSeqFilename << " cannot be read frame by frame, all the frames are loaded into memory");
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    if (vtkPlusSequenceIO::Read(inputSeqFilename, trackedFrameList) != PLUS_SUCCESS)
+    {
+      errorDetail = "unable to read input sequence file " + inputSeqFilename;
+      LOG_ERROR("vtkPlusVolumeReconstructor::ReconstructFromSequenceFile: " << errorDetail);
+      return PLUS_FAIL;
+    }
+    if (setOutputExtentFromFrames && this->SetOutputExtentFromFrameList(trackedFrameList, transformRepository, errorDetail) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("vtkPlusVolumeReconstructor::ReconstructFromSequenceFile: failed to set output extent of volume - " << errorDetail);
+      return PLUS_FAIL;
+    }
+    const int numberOfFramesInFile = trackedFrameList->GetNumberOfTrackedFrames();
+    for (int frameIndex = 0; frameIndex < numberOfFramesInFile && !cancelled; frameIndex++)
+    {
+      if (this->AddTrackedFrameFromSequence(trackedFrameList->GetTrackedFrame(frameIndex), frameIndex, numberOfFramesInFile, transformRepository, framesAddedToVolume) != PLUS_SUCCESS)
+      {
+        status = PLUS_FAIL;
+      }
+      if (progressCallback && ((frameIndex + 1) % this->StreamingChunkSizeFrames == 0 || frameIndex + 1 == numberOfFramesInFile))
+      {
+        cancelled = !progressCallback(frameIndex + 1, numberOfFramesInFile);
+      }
+    }
+    if (cancelled)
+    {
+      status = PLUS_FAIL;
+      errorDetail = "cancelled";
+    }
+    else if (status != PLUS_SUCCESS)
+    {
+      errorDetail = "some frames could not be added to the volume";
+    }
+    if (numberOfFramesAddedToVolume != NULL)
+    {
+      *numberOfFramesAddedToVolume = framesAddedToVolume;
+    }
+    if (numberOfFrames != NULL)
+    {
+      *numberOfFrames = numberOfFramesInFile;
+    }
+    return status;
+  }
+
+  vtkSmartPointer<vtkPlusSequenceStreamReader> reader = vtkSmartPointer<vtkPlusSequenceStreamReader>::New();
+  if (reader->Open(inputSeqFilename) != PLUS_SUCCESS)
+  {
+    errorDetail = "unable to open input sequence file " + inputSeqFilename;
+    LOG_ERROR("vtkPlusVolumeReconstructor::ReconstructFromSequenceFile: " << errorDetail);
+    return PLUS_FAIL;
+  }
+  const int numberOfFramesInFile = reader->GetNumberOfFrames();
+  if (numberOfFrames != NULL)
+  {
+    *numberOfFrames = numberOfFramesInFile;
+  }
+
+  if (setOutputExtentFromFrames && this->SetOutputExtentFromSequenceStream(reader, transformRepository, errorDetail) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("vtkPlusVolumeReconstructor::ReconstructFromSequenceFile: failed to set output extent of volume - " << errorDetail);
+    return PLUS_FAIL;
+  }
+
+  // The reader thread fills the queue with chunks of frames, the calling thread pastes them.
+  // Slice pasting of each frame is multithreaded by the paste slice filter.
+  struct FrameChunk
+  {
+    int FirstFrameIndex;
+    std::vector<igsioTrackedFrame> Frames;
+  };
+  std::deque<FrameChunk> readChunks;
+  std::mutex chunkMutex;
+  std::condition_variable chunkCondition;
+  bool readingFinished = false;
+  PlusStatus readStatus = PLUS_SUCCESS;
+  const int chunkSizeFrames = this->StreamingChunkSizeFrames;
+  const size_t maxNumberOfReadChunks = static_cast<size_t>(this->StreamingNumberOfReadAheadChunks);
+  const int skipInterval = std::max(this->GetSkipInterval(), 1);
+
+  std::thread readerThread([&]()
+  {
+    igsioTrackedFrame skippedFrame;
+    for (int firstFrameIndex = 0; firstFrameIndex < numberOfFramesInFile; firstFrameIndex += chunkSizeFrames)
+    {
+      {
+        std::lock_guard<std::mutex> lock(chunkMutex);
+        if (cancelled)
+        {
+          break;
+        }
+      }
+      FrameChunk chunk;
+      chunk.FirstFrameIndex = firstFrameIndex;
+      chunk.Frames.resize(std::min(chunkSizeFrames, numberOfFramesInFile - firstFrameIndex));
+      for (int i = 0; i < static_cast<int>(chunk.Frames.size()); i++)
+      {
+        // Skipped frames have to be read to get to the next frame, but they are not kept
+        igsioTrackedFrame& frame = ((firstFrameIndex + i) % skipInterval == 0) ? chunk.Frames[i] : skippedFrame;
+        if (reader->ReadNextFrame(frame) != PLUS_SUCCESS)
+        {
+          std::lock_guard<std::mutex> lock(chunkMutex);
+          readStatus = PLUS_FAIL;
+          readingFinished = true;
+          chunkCondition.notify_all();
+          return;
+        }
+      }
+      std::unique_lock<std::mutex> lock(chunkMutex);
+      chunkCondition.wait(lock, [&]() { return readChunks.size() < maxNumberOfReadChunks || cancelled; });
+      if (cancelled)
+      {
+        break;
+      }
+      readChunks.push_back(std::move(chunk));
+      chunkCondition.notify_all();
+    }
+    std::lock_guard<std::mutex> lock(chunkMutex);
+    readingFinished = true;
+    chunkCondition.notify_all();
+  });
+
+  while (true)
+  {
+    FrameChunk chunk;
+    {
+      std::unique_lock<std::mutex> lock(chunkMutex);
+      chunkCondition.wait(lock, [&]() { return !readChunks.empty() || readingFinished; });
+      if (readChunks.empty())
+      {
+        break;
+      }
+      chunk = std::move(readChunks.front());
+      readChunks.pop_front();
+      chunkCondition.notify_all();
+    }
+    for (int i = 0; i < static_cast<int>(chunk.Frames.size()); i++)
+    {
+      if (this->AddTrackedFrameFromSequence(&chunk.Frames[i], chunk.FirstFrameIndex + i, numberOfFramesInFile, transformRepository, framesAddedToVolume) != PLUS_SUCCESS)
+      {
+        status = PLUS_FAIL;
+      }
+    }
+    LOG_DEBUG("Frames pasted: " << chunk.FirstFrameIndex + chunk.Frames.size() << " out of " << numberOfFramesInFile);
+    if (progressCallback && !progressCallback(chunk.FirstFrameIndex + static_cast<int>(chunk.Frames.size()), numberOfFramesInFile))
+    {
+      // stop the reader thread, it may be waiting for free space in the queue
+      std::lock_guard<std::mutex> lock(chunkMutex);
+      cancelled = true;
+      chunkCondition.notify_all();
+      break;
+    }
+  }
+  readerThread.join();
+  reader->Close();
+
+  if (numberOfFramesAddedToVolume != NULL)
+  {
+    *numberOfFramesAddedToVolume = framesAddedToVolume;
+  }
+  if (cancelled)
+  {
+    errorDetail = "cancelled";
+    LOG_INFO("Volume reconstruction from sequence file " << inputSeqFilename << " cancelled");
+    return PLUS_FAIL;
+  }
+  if (readStatus != PLUS_SUCCESS)
+  {
+    errorDetail = "failed to read frames from input sequence file " + inputSeqFilename;
+    LOG_ERROR("vtkPlusVolumeReconstructor::ReconstructFromSequenceFile: " << errorDetail);
+    return PLUS_FAIL;
+  }
+  if (status != PLUS_SUCCESS)
+  {
+    errorDetail = "some frames could not be added to the volume";
+  }
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVolumeReconstructor::SetOutputExtentFromSequenceStream(vtkPlusSequenceStreamReader* reader, vtkIGSIOTransformRepository* transformRepository, std::string& errorDetail)
+{
+  FrameSizeType frameSize = { 0, 0, 0 };
+  reader->GetFrameSize(frameSize);
+  const int numberOfFrames = reader->GetNumberOfFrames();
+
+  double boundsMin[3] = { VTK_DOUBLE_MAX, VTK_DOUBLE_MAX, VTK_DOUBLE_MAX };
+  double boundsMax[3] = { -VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX };
+  double outputSpacing[3] = { 1.0, 1.0, 1.0 };
+  bool extentFound = false;
+  std::string chunkErrorDetail;
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> chunkFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  for (int firstFrameIndex = 0; firstFrameIndex < numberOfFrames; firstFrameIndex += this->StreamingChunkSizeFrames)
+  {
+    const int lastFrameIndex = std::min(firstFrameIndex + this->StreamingChunkSizeFrames, numberOfFrames) - 1;
+    chunkFrameList->Clear();
+    for (int frameIndex = firstFrameIndex; frameIndex <= lastFrameIndex; frameIndex++)
+    {
+      // Only the size of the image is used for computing the extent, so the pixels are not read
+      igsioTrackedFrame frame;
+      if (frame.GetImageData()->AllocateFrame(frameSize, reader->GetPixelType(), reader->GetNumberOfScalarComponents()) != PLUS_SUCCESS
+          || reader->GetFrameFields(frameIndex, frame) != PLUS_SUCCESS)
+      {
+        errorDetail = "failed to get the fields of the frames";
+        return PLUS_FAIL;
+      }
+      chunkFrameList->AddTrackedFrame(&frame);
+    }
+    if (this->SetOutputExtentFromFrameList(chunkFrameList, transformRepository, chunkErrorDetail) != PLUS_SUCCESS)
+    {
+      // For example, none of the frames of the chunk has a valid transform
+      LOG_DEBUG("Frames " << firstFrameIndex << "-" << lastFrameIndex << " are not used for the output extent: " << chunkErrorDetail);
+      continue;
+    }
+    int chunkExtent[6] = { 0, -1, 0, -1, 0, -1 };
+    double chunkOrigin[3] = { 0 };
+    this->Reconstructor->GetOutputExtent(chunkExtent);
+    this->Reconstructor->GetOutputOrigin(chunkOrigin);
+    this->Reconstructor->GetOutputSpacing(outputSpacing);
+    for (int axis = 0; axis < 3; axis++)
+    {
+      boundsMin[axis] = std::min(boundsMin[axis], chunkOrigin[axis] + chunkExtent[axis * 2] * outputSpacing[axis]);
+      boundsMax[axis] = std::max(boundsMax[axis], chunkOrigin[axis] + chunkExtent[axis * 2 + 1] * outputSpacing[axis]);
+    }
+    extentFound = true;
+  }
+  chunkFrameList->Clear();
+
+  if (!extentFound)
+  {
+    errorDetail = chunkErrorDetail.empty() ? "no frames with valid transform" : chunkErrorDetail;
+    return PLUS_FAIL;
+  }
+
+  int outputExtent[6] = { 0 };
+  for (int axis = 0; axis < 3; axis++)
+  {
+    outputExtent[axis * 2 + 1] = static_cast<int>(floor((boundsMax[axis] - boundsMin[axis]) / outputSpacing[axis] + 0.5));
+  }
+  this->SetOutputOrigin(boundsMin);
+  this->SetOutputExtent(outputExtent);
+  LOG_DEBUG("Output extent of the volume is set from " << numberOfFrames << " frames: " << outputExtent[1] + 1 << "x" << outputExtent[3] + 1 << "x" << outputExtent[5] + 1 << " voxels");
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVolumeReconstructor::AddTrackedFrameFromSequence(igsioTrackedFrame* frame, int frameIndex, int numberOfFrames, vtkIGSIOTransformRepository* transformRepository,
+    int& numberOfFramesAddedToVolume)
+{
+  const int skipInterval = std::max(this->GetSkipInterval(), 1);
+  if (frameIndex % skipInterval != 0)
+  {
+    return PLUS_SUCCESS;
+  }
+  if (transformRepository->SetTransforms(*frame) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to update transform repository with frame #" << frameIndex);
+    return PLUS_FAIL;
+  }
+  bool insertedIntoVolume = false;
+  bool isFirst = frameIndex == 0;
+  bool isLast = frameIndex + skipInterval >= numberOfFrames;
+  if (this->AddTrackedFrame(frame, transformRepository, isFirst, isLast, &insertedIntoVolume) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to add tracked frame to volume with frame #" << frameIndex);
+    return PLUS_FAIL;
+  }
+  if (insertedIntoVolume)
+  {
+    numberOfFramesAddedToVolume++;
+  }
+  return PLUS_SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusVolumeReconstructor::SaveReconstructedVolumeToFile(vtkImageData* volumeToSave, const std::string& filename, bool useCompression/*=true*/)
 {
@@ -64,6 +1517,18 @@ PlusStatus vtkPlusVolumeReconstructor::SaveReconstructedVolumeToFile(vtkImageDat
     return PLUS_FAIL;
   }
 
+  if (useCompression && vtkPlusVolumeFileWriter::CanWriteFile(filename))
+  {
+    // Compress on multiple threads and write the chunks as they are ready
+    vtkSmartPointer<vtkPlusVolumeFileWriter> writer = vtkSmartPointer<vtkPlusVolumeFileWriter>::New();
+    if (writer->Write(volumeToSave, filename) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to save reconstructed volume to " << filename);
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
   int dims[3];
   volumeToSave->GetDimensions(dims);
   FrameSizeType frameSize = { static_cast<unsigned int>(dims[0]), static_cast<unsigned int>(dims[1]), static_cast<unsigned int>(dims[2]) };
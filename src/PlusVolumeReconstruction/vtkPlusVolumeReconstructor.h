@@ -14,6 +14,20 @@
 #include <igsioCommon.h>
 #include <vtkIGSIOVolumeReconstructor.h>
 
+// VTK includes
+#include <vtkSmartPointer.h>
+
+// STL includes
+#include <array>
+#include <functional>
+#include <map>
+
+class vtkMatrix4x4;
+class vtkPlusFillHolesInVolume;
+class vtkPlusSequenceStreamReader;
+class vtkPlusVolumeReconstructorOpenCL;
+class vtkXMLDataElement;
+
 /*!
   \class vtkPlusVolumeReconstructor
   \brief Reconstructs a volume from tracked frames
@@ -36,12 +50,34 @@
   If no reference DRB is used then use Identity ReferenceToTracker transforms, and so
   Reference will be the same as Tracker. So we can still refer to the output system as Reference.
 
+  If Backend="OpenCL" is set in the VolumeReconstruction element and Plus is built with PLUS_USE_OPENCL then
+  slice pasting and hole filling are performed on an OpenCL device (see vtkPlusVolumeReconstructorOpenCL).
+  If no OpenCL device is available or a setting is not supported on the device then the CPU is used.
+
+  If SparseBrickSizeVoxels is set in the VolumeReconstruction element then the volume is stored in cubic bricks
+  of this size, which are only allocated when a frame is first pasted into them (or passes close enough to them
+  that hole filling may use their voxels). This reduces memory usage when the sweep covers only a small part of
+  the output extent. A dense volume is only created when the volume is extracted (for example, when it is saved)
+  or for the sub-extent that is requested by ExtractSubVolume. Sparse storage is not used with the OpenCL backend.
+
+  If ParallelHoleFilling is enabled in the VolumeReconstruction element then holes are filled on the CPU by
+  vtkPlusFillHolesInVolume, which uses multiple threads and only evaluates holes that are close to known voxels.
+  UpdateGrayLevels then only processes the voxels of the updated extent.
+
   \sa vtkPlusPasteSliceIntoVolume
   \ingroup PlusLibVolumeReconstruction
 */
 class vtkPlusVolumeReconstructionExport vtkPlusVolumeReconstructor : public vtkIGSIOVolumeReconstructor
 {
 public:
+  enum ReconstructionBackend
+  {
+    BACKEND_CPU,
+    BACKEND_OPENCL
+  };
+
+  /*! Called by ReconstructFromSequenceFile with the number of processed frames and the number of frames, returns false to cancel */
+  typedef std::function<bool(int, int)> SequenceProgressCallback;
 
   static vtkPlusVolumeReconstructor* New();
   vtkTypeMacro(vtkPlusVolumeReconstructor, vtkIGSIOVolumeReconstructor);
@@ -49,6 +85,55 @@ public:
 
   virtual PlusStatus UpdateImportanceMask() override;
 
+  /*! Read configuration data, the Backend attribute is read from the VolumeReconstruction element */
+  virtual PlusStatus ReadConfiguration(vtkXMLDataElement* config) override;
+
+  /*! Write configuration data, the Backend attribute is written into the VolumeReconstruction element */
+  virtual PlusStatus WriteConfiguration(vtkXMLDataElement* config) override;
+
+  /*! Insert a tracked frame into the volume, on the device that is selected by Backend */
+  virtual PlusStatus AddTrackedFrame(igsioTrackedFrame* frame, vtkIGSIOTransformRepository* transformRepository, bool isFirst = true, bool isLast = true, bool* insertedIntoVolume = NULL) override;
+
+  /*! Get the reconstructed gray levels (with hole filling, if enabled) */
+  virtual PlusStatus ExtractGrayLevels(vtkImageData* reconstructedVolume) override;
+
+  /*! Get the accumulation buffer */
+  virtual PlusStatus ExtractAccumulation(vtkImageData* accumulationBuffer) override;
+
+  /*! Clear the reconstructed volume */
+  virtual void Reset() override;
+
+  /*! Set/get the device that is used for slice pasting and hole filling. Falls back to CPU if OpenCL reconstruction is not available. */
+  vtkSetMacro(Backend, ReconstructionBackend);
+  vtkGetMacro(Backend, ReconstructionBackend);
+
+  /*! Set/get the brick size of sparse volume storage (in voxels). 0 means dense storage (default). Changing it clears the volume. */
+  void SetSparseBrickSizeVoxels(int brickSizeVoxels);
+  vtkGetMacro(SparseBrickSizeVoxels, int);
+
+  /*! Number of bricks that are allocated in sparse volume storage */
+  int GetNumberOfAllocatedSparseBricks() const;
+
+  /*! Memory used by the reconstructed volume and the accumulation buffer (of all the bricks in sparse storage), in bytes */
+  size_t GetMemoryUsageBytes();
+
+  /*!
+    Set/get if holes are filled by vtkPlusFillHolesInVolume (multithreaded, only holes near known voxels are evaluated)
+    instead of vtkIGSIOFillHolesInVolume. Only used with the CPU backend.
+  */
+  vtkSetMacro(ParallelHoleFilling, bool);
+  vtkGetMacro(ParallelHoleFilling, bool);
+  vtkBooleanMacro(ParallelHoleFilling, bool);
+
+  /*!
+    Get the reconstructed gray levels (with hole filling, if enabled) and the accumulation buffer inside an extent of the output volume.
+    In sparse storage only the bricks that intersect the extent are processed.
+    \param extent Requested voxels, it is clipped to the output extent
+    \param grayLevels Gray levels of the requested voxels, may be NULL
+    \param accumulationBuffer Accumulation buffer of the requested voxels, may be NULL
+  */
+  PlusStatus ExtractSubVolume(const int extent[6], vtkImageData* grayLevels, vtkImageData* accumulationBuffer = NULL);
+
   /*!
     Save reconstructed volume to file
     \param filename Path and filename of the output file
@@ -59,7 +144,8 @@ public:
   virtual PlusStatus SaveReconstructedVolumeToMetafile(const std::string& filename, bool accumulation = false, bool useCompression = true) { return SaveReconstructedVolumeToFile(filename, accumulation, useCompression); }
 
   /*!
-    Save reconstructed volume to file
+    Save reconstructed volume to file.
+    Compressed .mha, .mhd and .nrrd files are written by vtkPlusVolumeFileWriter, which compresses the volume on multiple threads.
     \param volumeToSave Reconstructed volume to be saved
     \param filename Path and filename of the output file
     \useCompression True if compression is turned on (default), false otherwise
@@ -67,10 +153,133 @@ public:
   static PlusStatus SaveReconstructedVolumeToFile(vtkImageData* volumeToSave, const std::string& filename, bool useCompression = true);
   static PlusStatus SaveReconstructedVolumeToMetafile(vtkImageData* volumeToSave, const std::string& filename, bool useCompression = true) { return vtkPlusVolumeReconstructor::SaveReconstructedVolumeToFile(volumeToSave, filename, useCompression); }
 
+  /*!
+    Update the voxels inside the specified extent of a gray level volume that was previously extracted by ExtractGrayLevels,
+    without processing the rest of the volume. It is used for refreshing snapshots of a live reconstruction.
+    \param grayLevels Gray level volume, must have the same extent and scalar type as the reconstructed volume
+    \param extent Voxels to update. It is clipped to the volume extent.
+    \param holeFillingMarginVoxels If hole filling is enabled then holes are filled using the voxels that are at most this far from the extent.
+      It must not be smaller than the size of the hole filling kernels. Not used if ParallelHoleFilling is enabled.
+  */
+  PlusStatus UpdateGrayLevels(vtkImageData* grayLevels, const int extent[6], int holeFillingMarginVoxels);
+
+  /*!
+    Reconstruct a volume from the frames of the list using multiple threads. The output volume is split into bricks
+    (slabs along its longest axis) and each worker pastes all the frames into its own brick, so the workers write
+    separate memory and do not need to synchronize. Output geometry must be set before calling this method
+    (e.g., by SetOutputExtentFromFrameList). The volume of this reconstructor is not modified.
+    Bricks are always reconstructed on the CPU.
+    \param numberOfWorkers Number of bricks and threads, 0 means the number of processor cores
+    \param holeFillingMarginVoxels Bricks overlap by this many voxels, so that hole filling of the bricks gives
+      the same result as hole filling of the whole volume. It must not be smaller than the size of the hole filling kernels.
+    \param grayLevels Reconstructed gray levels (with hole filling, if enabled)
+    \param accumulationBuffer If not NULL then the accumulation buffer is returned in it
+    \param numberOfFramesAddedToVolume If not NULL then the number of frames that were inserted into the volume is returned in it
+  */
+  PlusStatus ReconstructInParallelBricks(vtkIGSIOTrackedFrameList* trackedFrameList, vtkIGSIOTransformRepository* transformRepository,
+    int numberOfWorkers, int holeFillingMarginVoxels, vtkImageData* grayLevels, vtkImageData* accumulationBuffer = NULL, int* numberOfFramesAddedToVolume = NULL);
+
+  /*!
+    Reconstruct a volume from a sequence file without loading the whole sequence into memory. Frames are read in chunks
+    of StreamingChunkSizeFrames frames on a separate thread, at most StreamingNumberOfReadAheadChunks chunks ahead of the
+    slice pasting, so the memory usage is the volume plus a few chunks of frames. Files that cannot be read frame by frame
+    (see vtkPlusSequenceStreamReader) are loaded into memory and reconstructed the same way.
+    \param inputSeqFilename Input sequence file
+    \param transformRepository Transforms of each frame are set in it before the frame is pasted
+    \param setOutputExtentFromFrames If true then the output extent is computed from all the frames, as by
+      SetOutputExtentFromFrameList. The frame positions are read from the header, so the pixel data is only read once.
+    \param errorDetail Description of the error if the reconstruction fails
+    \param numberOfFramesAddedToVolume If not NULL then the number of frames that were inserted into the volume is returned in it
+    \param numberOfFrames If not NULL then the number of frames in the file is returned in it
+    \param progressCallback If set then it is called after each chunk of frames is pasted, with the number of processed
+      frames and the number of frames in the file. If it returns false then the reconstruction is cancelled, the frames
+      that have been pasted so far are kept in the volume and PLUS_FAIL is returned with "cancelled" errorDetail.
+  */
+  PlusStatus ReconstructFromSequenceFile(const std::string& inputSeqFilename, vtkIGSIOTransformRepository* transformRepository,
+    bool setOutputExtentFromFrames, std::string& errorDetail, int* numberOfFramesAddedToVolume = NULL, int* numberOfFrames = NULL,
+    const SequenceProgressCallback& progressCallback = SequenceProgressCallback());
+
+  /*! Number of frames that are read at once by ReconstructFromSequenceFile */
+  vtkSetClampMacro(StreamingChunkSizeFrames, int, 1, VTK_INT_MAX);
+  vtkGetMacro(StreamingChunkSizeFrames, int);
+
+  /*! Maximum number of chunks that ReconstructFromSequenceFile reads ahead of the slice pasting */
+  vtkSetClampMacro(StreamingNumberOfReadAheadChunks, int, 1, VTK_INT_MAX);
+  vtkGetMacro(StreamingNumberOfReadAheadChunks, int);
+
 protected:
   vtkPlusVolumeReconstructor();
   virtual ~vtkPlusVolumeReconstructor();
 
+  /*!
+    Initialize the OpenCL device and allocate the volume on it if the output extent is changed.
+    Returns PLUS_FAIL and switches to CPU backend if OpenCL reconstruction is not available.
+  */
+  PlusStatus PrepareOpenCLVolume();
+
+  /*! Extract the volume from the OpenCL device and set its geometry. Any of the outputs may be NULL. */
+  PlusStatus ExtractVolumeOpenCL(vtkImageData* grayLevels, vtkImageData* accumulationBuffer);
+
+  /*!
+    Compute the transform from pixel indices of the frame to voxel indices of the output volume (relative to the first voxel of the output extent).
+    isValid is set to false if the image to reference transform is invalid.
+  */
+  PlusStatus GetImageToVolumeIndexMatrix(vtkIGSIOTransformRepository* transformRepository, vtkMatrix4x4* imageToVolumeIndexMatrix, bool& isValid);
+
+  /*! Returns true if the volume is stored in sparse bricks */
+  bool UseSparseBricks() const;
+
+  /*! Returns true if holes are filled and vtkPlusFillHolesInVolume is used for that */
+  bool UseParallelHoleFilling();
+
+  /*! Paste the frame into all the bricks that it intersects, allocate the bricks that do not exist yet */
+  PlusStatus AddTrackedFrameToSparseBricks(igsioTrackedFrame* frame, vtkIGSIOTransformRepository* transformRepository, bool isFirst, bool isLast, bool* insertedIntoVolume);
+
+  /*! Compose a dense volume in the requested extent from the bricks. Any of the outputs may be NULL. */
+  PlusStatus ExtractSparseVolume(const int extent[6], vtkImageData* grayLevels, vtkImageData* accumulationBuffer);
+
+  /*! Get the brick if it exists or allocate it. Returns NULL if the brick cannot be created. */
+  vtkPlusVolumeReconstructor* GetOrCreateSparseBrick(const std::array<int, 3>& brickIndex);
+
+  /*! Voxels of the output volume that are owned by a brick */
+  void GetSparseBrickCoreExtent(const std::array<int, 3>& brickIndex, int coreExtent[6]) const;
+
+  /*! Remove all bricks if the output geometry is changed */
+  void UpdateSparseBricksGeometry();
+
+  /*! Remove all bricks */
+  void ClearSparseBricks();
+
+  /*!
+    Compute the output extent from the frame fields of an opened sequence. Frames are processed in chunks by SetOutputExtentFromFrameList
+    and the union of the chunk extents is used. Pixel data is not read.
+  */
+  PlusStatus SetOutputExtentFromSequenceStream(vtkPlusSequenceStreamReader* reader, vtkIGSIOTransformRepository* transformRepository, std::string& errorDetail);
+
+  /*! Set the transforms of a frame of a sequence and paste it. Frames that are skipped by SkipInterval are ignored. */
+  PlusStatus AddTrackedFrameFromSequence(igsioTrackedFrame* frame, int frameIndex, int numberOfFrames, vtkIGSIOTransformRepository* transformRepository,
+    int& numberOfFramesAddedToVolume);
+
+  ReconstructionBackend Backend;
+  vtkPlusVolumeReconstructorOpenCL* OpenCLReconstructor;
+
+  int SparseBrickSizeVoxels;
+  /*! Bricks are reconstructed with this many voxels around their core, so that hole filling of the core is the same as in a dense volume */
+  int SparseBrickMarginVoxels;
+  std::map< std::array<int, 3>, vtkSmartPointer<vtkPlusVolumeReconstructor> > SparseBricks;
+  /*! Configuration of the bricks, written when the first brick is created */
+  vtkSmartPointer<vtkXMLDataElement> SparseBrickConfiguration;
+  /*! Output geometry that the bricks are created for */
+  int SparseBricksVolumeExtent[6];
+  double SparseBricksVolumeOrigin[3];
+  double SparseBricksVolumeSpacing[3];
+
+  int StreamingChunkSizeFrames;
+  int StreamingNumberOfReadAheadChunks;
+
+  bool ParallelHoleFilling;
+  vtkSmartPointer<vtkPlusFillHolesInVolume> ParallelHoleFiller;
+
 private:
   vtkPlusVolumeReconstructor(const vtkPlusVolumeReconstructor&);  // Not implemented.
   void operator=(const vtkPlusVolumeReconstructor&);  // Not implemented.
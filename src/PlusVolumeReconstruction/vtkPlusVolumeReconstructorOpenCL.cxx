@@ -0,0 +1,685 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+
+#include "vtkPlusVolumeReconstructorOpenCL.h"
+
+#include "vtkImageData.h"
+#include "vtkMath.h"
+#include "vtkMatrix4x4.h"
+#include "vtkObjectFactory.h"
+#include "vtkXMLDataElement.h"
+
+#include "PlusOpenCL.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <sstream>
+
+vtkStandardNewMacro(vtkPlusVolumeReconstructorOpenCL);
+
+namespace
+{
+  /*!
+    Fixed-point multiplier of the accumulation weights, the same as in vtkIGSIOPasteSliceIntoVolume,
+    so that the extracted accumulation buffer has the same values.
+  */
+  const int ACCUMULATION_MULTIPLIER = 256;
+
+  /*!
+    Kernels of the reconstruction. INTERPOLATION and COMPOUNDING_MODE are defined when the program is built.
+    The constants must match the enums of vtkPlusVolumeReconstructorOpenCL.
+    Volume buffers are indexed from the first voxel of the volume extent. The value buffer contains the sum of
+    the weighted pixel values for MEAN compounding and the pixel value for the other compounding modes.
+  */
+  const char* KERNEL_SOURCE =
+    "#define NEAREST_NEIGHBOR_INTERPOLATION 0\n"
+    "#define LINEAR_INTERPOLATION 1\n"
+    "#define MEAN_COMPOUNDING 0\n"
+    "#define MAXIMUM_COMPOUNDING 1\n"
+    "#define LATEST_COMPOUNDING 2\n"
+    "#define HOLE_FILLING_GAUSSIAN 0\n"
+    "#define HOLE_FILLING_GAUSSIAN_ACCUMULATION 1\n"
+    "#define HOLE_FILLING_NEAREST_NEIGHBOR 2\n"
+    "#define HOLE_FILLING_DISTANCE_WEIGHT_INVERSE 3\n"
+    "\n"
+    "inline void InsertValue(__global uint* values, __global uint* accumulation, int index, uint value, uint weight)\n"
+    "{\n"
+    "#if COMPOUNDING_MODE == MEAN_COMPOUNDING\n"
+    "  atomic_add(values + index, value * weight);\n"
+    "#elif COMPOUNDING_MODE == MAXIMUM_COMPOUNDING\n"
+    "  atomic_max(values + index, value);\n"
+    "#else\n"
+    "  atomic_xchg(values + index, value);\n"
+    "#endif\n"
+    "  atomic_add(accumulation + index, weight);\n"
+    "}\n"
+    "\n"
+    "// clipRectangle: origin x, origin y, width, height; fan: origin x, origin y, start radius, stop radius; fanAngles: in radians\n"
+    "__kernel void PasteSlice(__global const uchar* frame, __global uint* values, __global uint* accumulation, int frameWidth, int4 volumeSize,\n"
+    "  float4 frameToVolumeRow0, float4 frameToVolumeRow1, float4 frameToVolumeRow2, int4 clipRectangle, int fanClipping, float4 fan, float2 fanAngles)\n"
+    "{\n"
+    "  int x = get_global_id(0);\n"
+    "  int y = get_global_id(1);\n"
+    "  if (clipRectangle.z > 0 && clipRectangle.w > 0\n"
+    "      && (x < clipRectangle.x || x >= clipRectangle.x + clipRectangle.z || y < clipRectangle.y || y >= clipRectangle.y + clipRectangle.w))\n"
+    "  {\n"
+    "    return;\n"
+    "  }\n"
+    "  if (fanClipping)\n"
+    "  {\n"
+    "    float fanX = x - fan.x;\n"
+    "    float fanY = y - fan.y;\n"
+    "    float squaredRadius = fanX * fanX + fanY * fanY;\n"
+    "    float angle = atan2(fanX, fanY);\n"
+    "    if (squaredRadius < fan.z * fan.z || squaredRadius > fan.w * fan.w || angle < fanAngles.x || angle > fanAngles.y)\n"
+    "    {\n"
+    "      return;\n"
+    "    }\n"
+    "  }\n"
+    "  uint value = frame[y * frameWidth + x];\n"
+    "  float4 pixel = (float4)((float)x, (float)y, 0.0f, 1.0f);\n"
+    "  float vx = dot(frameToVolumeRow0, pixel);\n"
+    "  float vy = dot(frameToVolumeRow1, pixel);\n"
+    "  float vz = dot(frameToVolumeRow2, pixel);\n"
+    "#if INTERPOLATION == NEAREST_NEIGHBOR_INTERPOLATION\n"
+    "  int ix = (int)floor(vx + 0.5f);\n"
+    "  int iy = (int)floor(vy + 0.5f);\n"
+    "  int iz = (int)floor(vz + 0.5f);\n"
+    "  if (ix >= 0 && ix < volumeSize.x && iy >= 0 && iy < volumeSize.y && iz >= 0 && iz < volumeSize.z)\n"
+    "  {\n"
+    "    InsertValue(values, accumulation, (iz * volumeSize.y + iy) * volumeSize.x + ix, value, ACCUMULATION_MULTIPLIER);\n"
+    "  }\n"
+    "#else\n"
+    "  // Distribute the pixel into the 8 surrounding voxels with trilinear weights\n"
+    "  float fx = floor(vx);\n"
+    "  float fy = floor(vy);\n"
+    "  float fz = floor(vz);\n"
+    "  float tx = vx - fx;\n"
+    "  float ty = vy - fy;\n"
+    "  float tz = vz - fz;\n"
+    "  for (int corner = 0; corner < 8; corner++)\n"
+    "  {\n"
+    "    int offsetX = corner & 1;\n"
+    "    int offsetY = (corner >> 1) & 1;\n"
+    "    int offsetZ = corner >> 2;\n"
+    "    int ix = (int)fx + offsetX;\n"
+    "    int iy = (int)fy + offsetY;\n"
+    "    int iz = (int)fz + offsetZ;\n"
+    "    if (ix < 0 || ix >= volumeSize.x || iy < 0 || iy >= volumeSize.y || iz < 0 || iz >= volumeSize.z)\n"
+    "    {\n"
+    "      continue;\n"
+    "    }\n"
+    "    float weight = (offsetX ? tx : 1.0f - tx) * (offsetY ? ty : 1.0f - ty) * (offsetZ ? tz : 1.0f - tz);\n"
+    "    uint fixedPointWeight = (uint)(weight * ACCUMULATION_MULTIPLIER + 0.5f);\n"
+    "    if (fixedPointWeight > 0)\n"
+    "    {\n"
+    "      InsertValue(values, accumulation, (iz * volumeSize.y + iy) * volumeSize.x + ix, value, fixedPointWeight);\n"
+    "    }\n"
+    "  }\n"
+    "#endif\n"
+    "}\n"
+    "\n"
+    "__kernel void ExtractVolume(__global const uint* values, __global const uint* accumulation, __global uchar* grayLevels, __global ushort* accumulationLevels)\n"
+    "{\n"
+    "  int index = get_global_id(0);\n"
+    "  uint weight = accumulation[index];\n"
+    "  uint value = 0;\n"
+    "  if (weight > 0)\n"
+    "  {\n"
+    "#if COMPOUNDING_MODE == MEAN_COMPOUNDING\n"
+    "    value = (values[index] + weight / 2) / weight;\n"
+    "#else\n"
+    "    value = values[index];\n"
+    "#endif\n"
+    "  }\n"
+    "  grayLevels[index] = convert_uchar_sat(value);\n"
+    "  accumulationLevels[index] = convert_ushort_sat(weight);\n"
+    "}\n"
+    "\n"
+    "// Weighted average of the known voxels in the (2 * halfSize + 1)^3 neighborhood. Returns false if there are not enough known voxels.\n"
+    "bool AverageKnownVoxels(__global const uchar* grayLevels, __global const ushort* accumulation, int4 volumeSize, int x, int y, int z,\n"
+    "  int elementType, int halfSize, float stdev, float minimumKnownVoxelsRatio, float* result)\n"
+    "{\n"
+    "  int knownVoxels = 0;\n"
+    "  int allVoxels = 0;\n"
+    "  float sum = 0.0f;\n"
+    "  float sumWeights = 0.0f;\n"
+    "  for (int dz = -halfSize; dz <= halfSize; dz++)\n"
+    "  {\n"
+    "    int nz = z + dz;\n"
+    "    for (int dy = -halfSize; dy <= halfSize; dy++)\n"
+    "    {\n"
+    "      int ny = y + dy;\n"
+    "      for (int dx = -halfSize; dx <= halfSize; dx++)\n"
+    "      {\n"
+    "        int nx = x + dx;\n"
+    "        if (nx < 0 || nx >= volumeSize.x || ny < 0 || ny >= volumeSize.y || nz < 0 || nz >= volumeSize.z)\n"
+    "        {\n"
+    "          continue;\n"
+    "        }\n"
+    "        allVoxels++;\n"
+    "        int neighbor = (nz * volumeSize.y + ny) * volumeSize.x + nx;\n"
+    "        ushort neighborAccumulation = accumulation[neighbor];\n"
+    "        if (neighborAccumulation == 0)\n"
+    "        {\n"
+    "          continue;\n"
+    "        }\n"
+    "        knownVoxels++;\n"
+    "        float squaredDistance = (float)(dx * dx + dy * dy + dz * dz);\n"
+    "        float weight = 1.0f;\n"
+    "        if (elementType == HOLE_FILLING_GAUSSIAN || elementType == HOLE_FILLING_GAUSSIAN_ACCUMULATION)\n"
+    "        {\n"
+    "          weight = exp(-squaredDistance / (2.0f * stdev * stdev));\n"
+    "          if (elementType == HOLE_FILLING_GAUSSIAN_ACCUMULATION)\n"
+    "          {\n"
+    "            weight *= neighborAccumulation;\n"
+    "          }\n"
+    "        }\n"
+    "        else if (elementType == HOLE_FILLING_DISTANCE_WEIGHT_INVERSE)\n"
+    "        {\n"
+    "          // the center voxel is a hole, so the distance is never 0\n"
+    "          weight = rsqrt(squaredDistance);\n"
+    "        }\n"
+    "        sum += weight * grayLevels[neighbor];\n"
+    "        sumWeights += weight;\n"
+    "      }\n"
+    "    }\n"
+    "  }\n"
+    "  if (knownVoxels == 0 || knownVoxels < minimumKnownVoxelsRatio * allVoxels || sumWeights <= 0.0f)\n"
+    "  {\n"
+    "    return false;\n"
+    "  }\n"
+    "  *result = sum / sumWeights;\n"
+    "  return true;\n"
+    "}\n"
+    "\n"
+    "// elements: type, size, stdev, minimum known voxels ratio. Elements are tried in order until one of them fills the hole.\n"
+    "__kernel void FillHoles(__global const uchar* grayLevels, __global const ushort* accumulation, __global uchar* filledGrayLevels, int4 volumeSize,\n"
+    "  __constant float4* elements, int numberOfElements)\n"
+    "{\n"
+    "  int x = get_global_id(0);\n"
+    "  int y = get_global_id(1);\n"
+    "  int z = get_global_id(2);\n"
+    "  int index = (z * volumeSize.y + y) * volumeSize.x + x;\n"
+    "  uchar value = grayLevels[index];\n"
+    "  bool filled = (accumulation[index] > 0);\n"
+    "  for (int e = 0; e < numberOfElements && !filled; e++)\n"
+    "  {\n"
+    "    int elementType = (int)elements[e].x;\n"
+    "    int halfSize = (int)elements[e].y / 2;\n"
+    "    // Nearest neighbor filling tries increasing neighborhood sizes, the others use the full size\n"
+    "    int firstHalfSize = (elementType == HOLE_FILLING_NEAREST_NEIGHBOR ? 1 : halfSize);\n"
+    "    float result = 0.0f;\n"
+    "    for (int h = firstHalfSize; h <= halfSize && !filled; h++)\n"
+    "    {\n"
+    "      filled = AverageKnownVoxels(grayLevels, accumulation, volumeSize, x, y, z, elementType, h, elements[e].z, elements[e].w, &result);\n"
+    "    }\n"
+    "    if (filled)\n"
+    "    {\n"
+    "      value = convert_uchar_sat(result + 0.5f);\n"
+    "    }\n"
+    "  }\n"
+    "  filledGrayLevels[index] = value;\n"
+    "}\n";
+
+  /*! Kernels of a program that is built for an interpolation and compounding mode, indices of Program::Kernels */
+  enum KernelIndex
+  {
+    PASTE_SLICE_KERNEL,
+    EXTRACT_VOLUME_KERNEL,
+    FILL_HOLES_KERNEL,
+    NUMBER_OF_KERNELS
+  };
+  const char* const KERNEL_NAMES[NUMBER_OF_KERNELS] = { "PasteSlice", "ExtractVolume", "FillHoles" };
+
+  typedef PlusOpenCL::Buffer Buffer;
+  typedef PlusOpenCL::Program Program;
+}
+
+//----------------------------------------------------------------------------
+class vtkPlusVolumeReconstructorOpenCL::vtkInternal : public PlusOpenCL
+{
+public:
+  vtkInternal()
+    : PlusOpenCL("volume reconstruction")
+  {
+  }
+
+  virtual ~vtkInternal()
+  {
+    this->ReleaseBuffer(this->FrameBuffer);
+    this->ReleaseBuffer(this->ValueBuffer);
+    this->ReleaseBuffer(this->AccumulationBuffer);
+    this->ReleaseBuffer(this->GrayLevelsBuffer);
+    this->ReleaseBuffer(this->AccumulationLevelsBuffer);
+    this->ReleaseBuffer(this->FilledGrayLevelsBuffer);
+    this->ReleaseBuffer(this->HoleFillingElementsBuffer);
+    for (std::map<int, Program>::iterator it = this->Programs.begin(); it != this->Programs.end(); ++it)
+    {
+      this->ReleaseProgram(it->second);
+    }
+  }
+
+  /*! Get the program for the interpolation and compounding mode, build it if it has not been built yet */
+  Program* GetProgram(InterpolationType interpolation, CompoundingType compounding);
+
+  /*! Programs for each interpolation and compounding mode */
+  std::map<int, Program> Programs;
+
+  /*! Frame upload buffer, allocated in host-accessible pinned memory */
+  Buffer FrameBuffer;
+
+  /*! Volume buffers that stay on the device during the reconstruction */
+  Buffer ValueBuffer;
+  Buffer AccumulationBuffer;
+
+  /*! Extracted volume */
+  Buffer GrayLevelsBuffer;
+  Buffer AccumulationLevelsBuffer;
+  Buffer FilledGrayLevelsBuffer;
+  Buffer HoleFillingElementsBuffer;
+};
+
+//----------------------------------------------------------------------------
+Program* vtkPlusVolumeReconstructorOpenCL::vtkInternal::GetProgram(InterpolationType interpolation, CompoundingType compounding)
+{
+  int programKey = static_cast<int>(interpolation) * 16 + static_cast<int>(compounding);
+  std::map<int, Program>::iterator existingProgram = this->Programs.find(programKey);
+  if (existingProgram != this->Programs.end())
+  {
+    return &existingProgram->second;
+  }
+
+  std::ostringstream options;
+  options << "-D INTERPOLATION=" << static_cast<int>(interpolation) << " -D COMPOUNDING_MODE=" << static_cast<int>(compounding)
+          << " -D ACCUMULATION_MULTIPLIER=" << ACCUMULATION_MULTIPLIER;
+
+  Program program;
+  if (this->BuildProgram(KERNEL_SOURCE, options.str(), KERNEL_NAMES, NUMBER_OF_KERNELS, program) != PLUS_SUCCESS)
+  {
+    return NULL;
+  }
+  Program& storedProgram = this->Programs[programKey];
+  storedProgram = program;
+  return &storedProgram;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusVolumeReconstructorOpenCL::vtkPlusVolumeReconstructorOpenCL()
+  : Interpolation(NEAREST_NEIGHBOR_INTERPOLATION)
+  , CompoundingMode(MEAN_COMPOUNDING)
+  , Internal(new vtkInternal)
+{
+  int emptyExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  std::copy(emptyExtent, emptyExtent + 6, this->VolumeExtent);
+}
+
+//----------------------------------------------------------------------------
+vtkPlusVolumeReconstructorOpenCL::~vtkPlusVolumeReconstructorOpenCL()
+{
+  delete this->Internal;
+  this->Internal = NULL;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusVolumeReconstructorOpenCL::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Device: " << (this->IsInitialized() ? this->Internal->GetDeviceName() : std::string("(not initialized)")) << "\n";
+  os << indent << "Interpolation: " << (this->Interpolation == LINEAR_INTERPOLATION ? "LINEAR" : "NEAREST_NEIGHBOR") << "\n";
+  os << indent << "CompoundingMode: " << (this->CompoundingMode == MAXIMUM_COMPOUNDING ? "MAXIMUM" : (this->CompoundingMode == LATEST_COMPOUNDING ? "LATEST" : "MEAN")) << "\n";
+  os << indent << "NumberOfHoleFillingElements: " << this->HoleFillingElements.size() << "\n";
+  os << indent << "VolumeExtent: " << this->VolumeExtent[0] << " " << this->VolumeExtent[1] << " " << this->VolumeExtent[2]
+     << " " << this->VolumeExtent[3] << " " << this->VolumeExtent[4] << " " << this->VolumeExtent[5] << "\n";
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVolumeReconstructorOpenCL::ReadConfiguration(vtkXMLDataElement* volumeReconstructionElement)
+{
+  XML_VERIFY_ELEMENT(volumeReconstructionElement, "VolumeReconstruction");
+
+  // The meaning of the volume buffers depends on the settings, so the volume has to be reallocated
+  int emptyExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  std::copy(emptyExtent, emptyExtent + 6, this->VolumeExtent);
+
+  if (volumeReconstructionElement->GetAttribute("PixelRejectionThreshold") != NULL)
+  {
+    LOG_WARNING("OpenCL volume reconstruction does not support pixel rejection");
+    return PLUS_FAIL;
+  }
+  XML_READ_ENUM2_ATTRIBUTE_OPTIONAL(Interpolation, volumeReconstructionElement,
+                                    "NEAREST_NEIGHBOR", NEAREST_NEIGHBOR_INTERPOLATION, "LINEAR", LINEAR_INTERPOLATION);
+  const char* compoundingMode = volumeReconstructionElement->GetAttribute("CompoundingMode");
+  if (compoundingMode != NULL && STRCASECMP(compoundingMode, "MEAN") != 0 && STRCASECMP(compoundingMode, "MAXIMUM") != 0
+      && STRCASECMP(compoundingMode, "LATEST") != 0)
+  {
+    LOG_WARNING("OpenCL volume reconstruction does not support " << compoundingMode << " compounding mode");
+    return PLUS_FAIL;
+  }
+  XML_READ_ENUM3_ATTRIBUTE_OPTIONAL(CompoundingMode, volumeReconstructionElement,
+                                    "MEAN", MEAN_COMPOUNDING, "MAXIMUM", MAXIMUM_COMPOUNDING, "LATEST", LATEST_COMPOUNDING);
+
+  this->HoleFillingElements.clear();
+  vtkXMLDataElement* holeFillingElement = volumeReconstructionElement->FindNestedElementWithName("HoleFilling");
+  if (holeFillingElement == NULL)
+  {
+    return PLUS_SUCCESS;
+  }
+  for (int nestedElementIndex = 0; nestedElementIndex < holeFillingElement->GetNumberOfNestedElements(); ++nestedElementIndex)
+  {
+    vtkXMLDataElement* nestedElement = holeFillingElement->GetNestedElement(nestedElementIndex);
+    if (STRCASECMP(nestedElement->GetName(), "HoleFillingElement") != 0)
+    {
+      continue;
+    }
+    HoleFillingElement element;
+    element.Size = 3;
+    element.Stdev = 1.0;
+    element.MinimumKnownVoxelsRatio = 0.5;
+    const char* type = nestedElement->GetAttribute("Type");
+    if (type != NULL && STRCASECMP(type, "GAUSSIAN") == 0)
+    {
+      element.Type = HOLE_FILLING_GAUSSIAN;
+    }
+    else if (type != NULL && STRCASECMP(type, "GAUSSIAN_ACCUMULATION") == 0)
+    {
+      element.Type = HOLE_FILLING_GAUSSIAN_ACCUMULATION;
+    }
+    else if (type != NULL && STRCASECMP(type, "NEAREST_NEIGHBOR") == 0)
+    {
+      element.Type = HOLE_FILLING_NEAREST_NEIGHBOR;
+    }
+    else if (type != NULL && STRCASECMP(type, "DISTANCE_WEIGHT_INVERSE") == 0)
+    {
+      element.Type = HOLE_FILLING_DISTANCE_WEIGHT_INVERSE;
+    }
+    else
+    {
+      LOG_WARNING("OpenCL volume reconstruction does not support " << (type != NULL ? type : "(undefined)") << " hole filling element type");
+      return PLUS_FAIL;
+    }
+    nestedElement->GetScalarAttribute("Size", element.Size);
+    nestedElement->GetScalarAttribute("Stdev", element.Stdev);
+    nestedElement->GetScalarAttribute("MinimumKnownVoxelsRatio", element.MinimumKnownVoxelsRatio);
+    if (element.Size < 1)
+    {
+      LOG_ERROR("Invalid hole filling element size: " << element.Size);
+      return PLUS_FAIL;
+    }
+    this->HoleFillingElements.push_back(element);
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVolumeReconstructorOpenCL::Initialize()
+{
+  if (this->IsInitialized())
+  {
+    return PLUS_SUCCESS;
+  }
+
+  if (this->Internal->CreateCommandQueue() != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  // Build the program of the current settings now, to report errors early
+  if (this->Internal->GetProgram(this->Interpolation, this->CompoundingMode) == NULL)
+  {
+    // Leave the reconstructor uninitialized, so that Initialize can be retried
+    this->Internal->ReleaseCommandQueue();
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusVolumeReconstructorOpenCL::IsInitialized() const
+{
+  return this->Internal->IsInitialized();
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusVolumeReconstructorOpenCL::GetDeviceName() const
+{
+  return this->Internal->GetDeviceName();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVolumeReconstructorOpenCL::AllocateVolume(const int extent[6])
+{
+  if (!this->IsInitialized())
+  {
+    LOG_ERROR("OpenCL volume reconstruction failed: the device is not initialized");
+    return PLUS_FAIL;
+  }
+  int emptyExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  std::copy(emptyExtent, emptyExtent + 6, this->VolumeExtent);
+
+  size_t numberOfVoxels = 1;
+  for (int axis = 0; axis < 3; axis++)
+  {
+    if (extent[axis * 2 + 1] < extent[axis * 2])
+    {
+      LOG_ERROR("OpenCL volume reconstruction failed: invalid output extent");
+      return PLUS_FAIL;
+    }
+    numberOfVoxels *= static_cast<size_t>(extent[axis * 2 + 1] - extent[axis * 2] + 1);
+  }
+  size_t bufferSize = numberOfVoxels * sizeof(cl_uint);
+  // Buffers are cleared entirely, so release them if they are larger than needed
+  if (this->Internal->ValueBuffer.Size != bufferSize)
+  {
+    this->Internal->ReleaseBuffer(this->Internal->ValueBuffer);
+    this->Internal->ReleaseBuffer(this->Internal->AccumulationBuffer);
+  }
+  if (this->Internal->ReserveBuffer(this->Internal->ValueBuffer, bufferSize, CL_MEM_READ_WRITE) != PLUS_SUCCESS
+      || this->Internal->ReserveBuffer(this->Internal->AccumulationBuffer, bufferSize, CL_MEM_READ_WRITE) != PLUS_SUCCESS
+      || this->Internal->ClearBuffer(this->Internal->ValueBuffer) != PLUS_SUCCESS
+      || this->Internal->ClearBuffer(this->Internal->AccumulationBuffer) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  std::copy(extent, extent + 6, this->VolumeExtent);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVolumeReconstructorOpenCL::PasteSlice(vtkImageData* frame, vtkMatrix4x4* frameToVolumeIndex, const SliceClipping& clipping)
+{
+  if (!this->IsInitialized() || this->VolumeExtent[1] < this->VolumeExtent[0])
+  {
+    LOG_ERROR("OpenCL volume reconstruction failed: the volume is not allocated");
+    return PLUS_FAIL;
+  }
+  if (frame == NULL || frameToVolumeIndex == NULL)
+  {
+    LOG_ERROR("OpenCL volume reconstruction failed: invalid input");
+    return PLUS_FAIL;
+  }
+  int frameExtent[6] = { 0, -1, 0, -1, 0, -1 };
+  frame->GetExtent(frameExtent);
+  if (frame->GetScalarType() != VTK_UNSIGNED_CHAR || frame->GetNumberOfScalarComponents() != 1 || frameExtent[4] != frameExtent[5])
+  {
+    LOG_ERROR("OpenCL volume reconstruction failed: expecting a single-slice, single-component VTK_UNSIGNED_CHAR frame");
+    return PLUS_FAIL;
+  }
+  Program* program = this->Internal->GetProgram(this->Interpolation, this->CompoundingMode);
+  if (program == NULL)
+  {
+    return PLUS_FAIL;
+  }
+
+  // Copy the frame into pinned memory, the upload is then performed by DMA
+  int frameWidth = frameExtent[1] - frameExtent[0] + 1;
+  int frameHeight = frameExtent[3] - frameExtent[2] + 1;
+  size_t frameSize = static_cast<size_t>(frameWidth) * frameHeight;
+  if (this->Internal->ReserveBuffer(this->Internal->FrameBuffer, frameSize, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  cl_int error = CL_SUCCESS;
+  void* mappedFrame = clEnqueueMapBuffer(this->Internal->GetQueue(), this->Internal->FrameBuffer.Handle, CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION,
+                                         0, frameSize, 0, NULL, NULL, &error);
+  if (this->Internal->CheckError(error, "clEnqueueMapBuffer") != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  memcpy(mappedFrame, frame->GetScalarPointer(), frameSize);
+  if (this->Internal->CheckError(clEnqueueUnmapMemObject(this->Internal->GetQueue(), this->Internal->FrameBuffer.Handle, mappedFrame, 0, NULL, NULL),
+                                 "clEnqueueUnmapMemObject") != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  cl_int4 volumeSize = { { this->VolumeExtent[1] - this->VolumeExtent[0] + 1, this->VolumeExtent[3] - this->VolumeExtent[2] + 1,
+      this->VolumeExtent[5] - this->VolumeExtent[4] + 1, 1
+    }
+  };
+  cl_float4 frameToVolumeRows[3];
+  for (int row = 0; row < 3; row++)
+  {
+    for (int column = 0; column < 4; column++)
+    {
+      frameToVolumeRows[row].s[column] = static_cast<cl_float>(frameToVolumeIndex->GetElement(row, column));
+    }
+  }
+  cl_int4 clipRectangle = { { clipping.ClipRectangleOrigin[0], clipping.ClipRectangleOrigin[1], clipping.ClipRectangleSize[0], clipping.ClipRectangleSize[1] } };
+  cl_int fanClipping = clipping.FanClipping ? 1 : 0;
+  cl_float4 fan = { { static_cast<cl_float>(clipping.FanOrigin[0]), static_cast<cl_float>(clipping.FanOrigin[1]),
+      static_cast<cl_float>(clipping.FanRadiusStartPixel), static_cast<cl_float>(clipping.FanRadiusStopPixel)
+    }
+  };
+  cl_float2 fanAngles = { { static_cast<cl_float>(vtkMath::RadiansFromDegrees(clipping.FanAnglesDeg[0])),
+      static_cast<cl_float>(vtkMath::RadiansFromDegrees(clipping.FanAnglesDeg[1]))
+    }
+  };
+
+  cl_kernel kernel = program->Kernels[PASTE_SLICE_KERNEL];
+  error |= PlusOpenCL::SetKernelArg(kernel, 0, this->Internal->FrameBuffer.Handle);
+  error |= PlusOpenCL::SetKernelArg(kernel, 1, this->Internal->ValueBuffer.Handle);
+  error |= PlusOpenCL::SetKernelArg(kernel, 2, this->Internal->AccumulationBuffer.Handle);
+  error |= PlusOpenCL::SetKernelArg(kernel, 3, frameWidth);
+  error |= PlusOpenCL::SetKernelArg(kernel, 4, volumeSize);
+  error |= PlusOpenCL::SetKernelArg(kernel, 5, frameToVolumeRows[0]);
+  error |= PlusOpenCL::SetKernelArg(kernel, 6, frameToVolumeRows[1]);
+  error |= PlusOpenCL::SetKernelArg(kernel, 7, frameToVolumeRows[2]);
+  error |= PlusOpenCL::SetKernelArg(kernel, 8, clipRectangle);
+  error |= PlusOpenCL::SetKernelArg(kernel, 9, fanClipping);
+  error |= PlusOpenCL::SetKernelArg(kernel, 10, fan);
+  error |= PlusOpenCL::SetKernelArg(kernel, 11, fanAngles);
+  size_t workSize[2] = { static_cast<size_t>(frameWidth), static_cast<size_t>(frameHeight) };
+  if (this->Internal->CheckError(error, "clSetKernelArg(PasteSlice)") != PLUS_SUCCESS
+      || this->Internal->RunKernel(kernel, 2, workSize, "PasteSlice") != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  // The kernel is not waited for, the next frame can be prepared while it is running
+  return this->Internal->CheckError(clFlush(this->Internal->GetQueue()), "clFlush");
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVolumeReconstructorOpenCL::ExtractVolume(vtkImageData* grayLevels, vtkImageData* accumulationBuffer, bool fillHoles)
+{
+  if (!this->IsInitialized() || this->VolumeExtent[1] < this->VolumeExtent[0])
+  {
+    LOG_ERROR("OpenCL volume reconstruction failed: the volume is not allocated");
+    return PLUS_FAIL;
+  }
+  Program* program = this->Internal->GetProgram(this->Interpolation, this->CompoundingMode);
+  if (program == NULL)
+  {
+    return PLUS_FAIL;
+  }
+
+  cl_int4 volumeSize = { { this->VolumeExtent[1] - this->VolumeExtent[0] + 1, this->VolumeExtent[3] - this->VolumeExtent[2] + 1,
+      this->VolumeExtent[5] - this->VolumeExtent[4] + 1, 1
+    }
+  };
+  size_t numberOfVoxels = static_cast<size_t>(volumeSize.s[0]) * volumeSize.s[1] * volumeSize.s[2];
+  if (this->Internal->ReserveBuffer(this->Internal->GrayLevelsBuffer, numberOfVoxels * sizeof(cl_uchar), CL_MEM_READ_WRITE) != PLUS_SUCCESS
+      || this->Internal->ReserveBuffer(this->Internal->AccumulationLevelsBuffer, numberOfVoxels * sizeof(cl_ushort), CL_MEM_READ_WRITE) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  cl_int error = CL_SUCCESS;
+  cl_kernel extractKernel = program->Kernels[EXTRACT_VOLUME_KERNEL];
+  error |= PlusOpenCL::SetKernelArg(extractKernel, 0, this->Internal->ValueBuffer.Handle);
+  error |= PlusOpenCL::SetKernelArg(extractKernel, 1, this->Internal->AccumulationBuffer.Handle);
+  error |= PlusOpenCL::SetKernelArg(extractKernel, 2, this->Internal->GrayLevelsBuffer.Handle);
+  error |= PlusOpenCL::SetKernelArg(extractKernel, 3, this->Internal->AccumulationLevelsBuffer.Handle);
+  size_t extractWorkSize[1] = { numberOfVoxels };
+  if (this->Internal->CheckError(error, "clSetKernelArg(ExtractVolume)") != PLUS_SUCCESS
+      || this->Internal->RunKernel(extractKernel, 1, extractWorkSize, "ExtractVolume") != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  Buffer* grayLevelsResultBuffer = &this->Internal->GrayLevelsBuffer;
+  if (fillHoles && !this->HoleFillingElements.empty())
+  {
+    std::vector<cl_float4> elements(this->HoleFillingElements.size());
+    for (size_t i = 0; i < this->HoleFillingElements.size(); i++)
+    {
+      elements[i].s[0] = static_cast<cl_float>(this->HoleFillingElements[i].Type);
+      elements[i].s[1] = static_cast<cl_float>(this->HoleFillingElements[i].Size);
+      elements[i].s[2] = static_cast<cl_float>(this->HoleFillingElements[i].Stdev);
+      elements[i].s[3] = static_cast<cl_float>(this->HoleFillingElements[i].MinimumKnownVoxelsRatio);
+    }
+    size_t elementsSize = elements.size() * sizeof(cl_float4);
+    if (this->Internal->ReserveBuffer(this->Internal->FilledGrayLevelsBuffer, numberOfVoxels * sizeof(cl_uchar), CL_MEM_READ_WRITE) != PLUS_SUCCESS
+        || this->Internal->UploadBuffer(this->Internal->HoleFillingElementsBuffer, &elements[0], elementsSize, CL_TRUE) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    cl_int numberOfElements = static_cast<cl_int>(elements.size());
+    cl_kernel fillKernel = program->Kernels[FILL_HOLES_KERNEL];
+    error |= PlusOpenCL::SetKernelArg(fillKernel, 0, this->Internal->GrayLevelsBuffer.Handle);
+    error |= PlusOpenCL::SetKernelArg(fillKernel, 1, this->Internal->AccumulationLevelsBuffer.Handle);
+    error |= PlusOpenCL::SetKernelArg(fillKernel, 2, this->Internal->FilledGrayLevelsBuffer.Handle);
+    error |= PlusOpenCL::SetKernelArg(fillKernel, 3, volumeSize);
+    error |= PlusOpenCL::SetKernelArg(fillKernel, 4, this->Internal->HoleFillingElementsBuffer.Handle);
+    error |= PlusOpenCL::SetKernelArg(fillKernel, 5, numberOfElements);
+    size_t fillWorkSize[3] = { static_cast<size_t>(volumeSize.s[0]), static_cast<size_t>(volumeSize.s[1]), static_cast<size_t>(volumeSize.s[2]) };
+    if (this->Internal->CheckError(error, "clSetKernelArg(FillHoles)") != PLUS_SUCCESS
+        || this->Internal->RunKernel(fillKernel, 3, fillWorkSize, "FillHoles") != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    grayLevelsResultBuffer = &this->Internal->FilledGrayLevelsBuffer;
+  }
+
+  // Download only the requested volumes
+  if (grayLevels != NULL)
+  {
+    grayLevels->SetExtent(this->VolumeExtent);
+    grayLevels->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+    if (this->Internal->CheckError(clEnqueueReadBuffer(this->Internal->GetQueue(), grayLevelsResultBuffer->Handle, CL_TRUE, 0, numberOfVoxels * sizeof(cl_uchar),
+                                   grayLevels->GetScalarPointer(), 0, NULL, NULL), "clEnqueueReadBuffer") != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    grayLevels->Modified();
+  }
+  if (accumulationBuffer != NULL)
+  {
+    accumulationBuffer->SetExtent(this->VolumeExtent);
+    accumulationBuffer->AllocateScalars(VTK_UNSIGNED_SHORT, 1);
+    if (this->Internal->CheckError(clEnqueueReadBuffer(this->Internal->GetQueue(), this->Internal->AccumulationLevelsBuffer.Handle, CL_TRUE, 0, numberOfVoxels * sizeof(cl_ushort),
+                                   accumulationBuffer->GetScalarPointer(), 0, NULL, NULL), "clEnqueueReadBuffer") != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    accumulationBuffer->Modified();
+  }
+  return PLUS_SUCCESS;
+}
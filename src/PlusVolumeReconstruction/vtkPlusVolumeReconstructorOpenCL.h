@@ -0,0 +1,154 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusVolumeReconstructorOpenCL_h
+#define __vtkPlusVolumeReconstructorOpenCL_h
+
+#include "vtkPlusVolumeReconstructionExport.h"
+#include "vtkObject.h"
+
+#include <vector>
+
+class vtkImageData;
+class vtkMatrix4x4;
+class vtkXMLDataElement;
+
+/*!
+  \class vtkPlusVolumeReconstructorOpenCL
+  \brief Pastes frames into a volume and fills holes on an OpenCL device
+
+  The volume and the accumulation buffer are stored on the device during the whole reconstruction. Each frame is
+  copied into a pinned (page-locked) host buffer, uploaded to the device and pasted by a kernel that processes
+  one pixel per work item. The gray levels are only downloaded when the volume is extracted. Hole filling is
+  performed on the device, too, before the download.
+
+  Supported settings of the VolumeReconstruction element:
+  - Interpolation: NEAREST_NEIGHBOR and LINEAR
+  - CompoundingMode: MEAN, MAXIMUM and LATEST
+  - HoleFillingElement Type: GAUSSIAN, GAUSSIAN_ACCUMULATION, NEAREST_NEIGHBOR and DISTANCE_WEIGHT_INVERSE
+
+  Pixel rejection is not supported. Only single-component VTK_UNSIGNED_CHAR frames are supported. Overlapping pixels are accumulated with atomic
+  operations in fixed-point representation, therefore the result may differ by one intensity level from the
+  CPU reconstruction.
+
+  Only available if Plus is built with PLUS_USE_OPENCL. Used by vtkPlusVolumeReconstructor if Backend="OpenCL"
+  is specified in the VolumeReconstruction element.
+
+  \ingroup PlusLibVolumeReconstruction
+*/
+class vtkPlusVolumeReconstructionExport vtkPlusVolumeReconstructorOpenCL : public vtkObject
+{
+public:
+  enum InterpolationType
+  {
+    NEAREST_NEIGHBOR_INTERPOLATION,
+    LINEAR_INTERPOLATION
+  };
+
+  enum CompoundingType
+  {
+    MEAN_COMPOUNDING,
+    MAXIMUM_COMPOUNDING,
+    LATEST_COMPOUNDING
+  };
+
+  enum HoleFillingElementType
+  {
+    HOLE_FILLING_GAUSSIAN,
+    HOLE_FILLING_GAUSSIAN_ACCUMULATION,
+    HOLE_FILLING_NEAREST_NEIGHBOR,
+    HOLE_FILLING_DISTANCE_WEIGHT_INVERSE
+  };
+
+  struct HoleFillingElement
+  {
+    HoleFillingElementType Type;
+    /*! Diameter of the largest neighborhood, in voxels */
+    int Size;
+    /*! Standard deviation of the Gaussian weight, in voxels */
+    double Stdev;
+    double MinimumKnownVoxelsRatio;
+  };
+
+  /*! Pixels of the frame that are pasted into the volume */
+  struct SliceClipping
+  {
+    /*! Clip rectangle in pixels. Not applied if the size is 0. */
+    int ClipRectangleOrigin[2];
+    int ClipRectangleSize[2];
+    bool FanClipping;
+    double FanOrigin[2];
+    double FanAnglesDeg[2];
+    double FanRadiusStartPixel;
+    double FanRadiusStopPixel;
+  };
+
+  static vtkPlusVolumeReconstructorOpenCL* New();
+  vtkTypeMacro(vtkPlusVolumeReconstructorOpenCL, vtkObject);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  /*!
+    Read the interpolation, compounding and hole filling settings from the VolumeReconstruction element.
+    Returns PLUS_FAIL if a setting is not supported on the device.
+  */
+  PlusStatus ReadConfiguration(vtkXMLDataElement* volumeReconstructionElement);
+
+  /*! Select an OpenCL device (the first GPU, or any device if there is no GPU) and compile the kernels */
+  PlusStatus Initialize();
+
+  /*! Returns true if the device is initialized */
+  bool IsInitialized() const;
+
+  /*! Name of the OpenCL device that is used for reconstruction */
+  std::string GetDeviceName() const;
+
+  /*! Allocate an empty volume on the device */
+  PlusStatus AllocateVolume(const int extent[6]);
+
+  /*! Extent of the volume on the device. Empty if no volume is allocated. */
+  vtkGetVector6Macro(VolumeExtent, int);
+
+  /*!
+    Paste a frame into the volume
+    \param frame single-component VTK_UNSIGNED_CHAR image
+    \param frameToVolumeIndex transforms pixel indices of the frame to voxel indices of the volume extent
+    \param clipping region of the frame that is pasted
+  */
+  PlusStatus PasteSlice(vtkImageData* frame, vtkMatrix4x4* frameToVolumeIndex, const SliceClipping& clipping);
+
+  /*!
+    Download the volume. The extent of the outputs is set to the volume extent, origin and spacing are not changed.
+    \param grayLevels reconstructed gray levels, may be NULL
+    \param accumulationBuffer accumulation buffer (as in vtkIGSIOPasteSliceIntoVolume), may be NULL
+    \param fillHoles if true then holes of the gray levels are filled using the hole filling elements
+  */
+  PlusStatus ExtractVolume(vtkImageData* grayLevels, vtkImageData* accumulationBuffer, bool fillHoles);
+
+  vtkGetMacro(Interpolation, InterpolationType);
+  vtkGetMacro(CompoundingMode, CompoundingType);
+
+protected:
+  vtkPlusVolumeReconstructorOpenCL();
+  virtual ~vtkPlusVolumeReconstructorOpenCL();
+
+  vtkSetMacro(Interpolation, InterpolationType);
+  vtkSetMacro(CompoundingMode, CompoundingType);
+
+  InterpolationType Interpolation;
+  CompoundingType CompoundingMode;
+  std::vector<HoleFillingElement> HoleFillingElements;
+
+  int VolumeExtent[6];
+
+  class vtkInternal;
+  vtkInternal* Internal;
+
+private:
+  vtkPlusVolumeReconstructorOpenCL(const vtkPlusVolumeReconstructorOpenCL&);  // Not implemented.
+  void operator=(const vtkPlusVolumeReconstructorOpenCL&);  // Not implemented.
+};
+
+#endif
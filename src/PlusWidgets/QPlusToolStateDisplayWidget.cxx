@@ -9,7 +9,9 @@
 
 // PlusLib includes
 //#include <igsioTrackedFrame.h>
+#include <vtkIGSIOAccurateTimer.h>
 #include <vtkPlusChannel.h>
+#include <vtkPlusDataSource.h>
 //#include <vtkIGSIOTrackedFrameList.h>
 
 // Qt includes
@@ -22,6 +24,8 @@ QPlusToolStateDisplayWidget::QPlusToolStateDisplayWidget(QWidget* aParent, Qt::W
   : QWidget(aParent, aFlags)
   , m_SelectedChannel(NULL)
   , m_Initialized(false)
+  , m_MinimumUpdateIntervalSec(0.1)
+  , m_LastUpdateTime(0.0)
 {
   m_ToolNameLabels.clear();
   m_ToolStateLabels.clear();
@@ -66,6 +70,9 @@ PlusStatus QPlusToolStateDisplayWidget::InitializeTools(vtkPlusChannel* aChannel
     delete (*it);
   }
   m_ToolStateLabels.clear();
+  m_ToolGenerations.clear();
+  m_DisplayedToolStates.clear();
+  m_LastUpdateTime = 0.0;
 
   // If connection was unsuccessful, create default appearance
   if (!aConnectionSuccessful)
@@ -95,9 +102,10 @@ PlusStatus QPlusToolStateDisplayWidget::InitializeTools(vtkPlusChannel* aChannel
 
   // Get transforms
   std::vector<igsioTransformName> transformNames;
-  igsioTrackedFrame trackedFrame;
-  m_SelectedChannel->GetTrackedFrame(trackedFrame);
-  trackedFrame.GetFrameTransformNameList(transformNames);
+  for (DataSourceContainerConstIterator toolIt = m_SelectedChannel->GetToolsStartConstIterator(); toolIt != m_SelectedChannel->GetToolsEndConstIterator(); ++toolIt)
+  {
+    transformNames.push_back(igsioTransformName(toolIt->second->GetId()));
+  }
 
   // Set up layout
   QGridLayout* grid = new QGridLayout(this);
@@ -107,6 +115,9 @@ PlusStatus QPlusToolStateDisplayWidget::InitializeTools(vtkPlusChannel* aChannel
   grid->setContentsMargins(4, 4, 4, 4);
 
   m_ToolStateLabels.resize(transformNames.size(), NULL);
+  // No generation is known and no status is displayed yet, so the first update refreshes all labels
+  m_ToolGenerations.assign(transformNames.size(), static_cast<unsigned long long>(-1));
+  m_DisplayedToolStates.assign(transformNames.size(), -1);
 
   int i;
   std::vector<igsioTransformName>::iterator it;
@@ -165,16 +176,15 @@ PlusStatus QPlusToolStateDisplayWidget::Update()
     return PLUS_FAIL;
   }
 
-  // Re-initialize widget if enabled statuses have changed
-  int numberOfDisplayedTools = 0;
-
-  // Get transforms
-  std::vector<igsioTransformName> transformNames;
-  igsioTrackedFrame trackedFrame;
-  m_SelectedChannel->GetTrackedFrame(trackedFrame);
-  trackedFrame.GetFrameTransformNameList(transformNames);
+  // Limit the refresh rate, the display does not need to follow the acquisition rate
+  double currentTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  if (m_LastUpdateTime > 0.0 && currentTime - m_LastUpdateTime < m_MinimumUpdateIntervalSec)
+  {
+    return PLUS_SUCCESS;
+  }
+  m_LastUpdateTime = currentTime;
 
-  if (transformNames.size() != m_ToolStateLabels.size())
+  if (static_cast<size_t>(m_SelectedChannel->ToolCount()) != m_ToolStateLabels.size())
   {
     LOG_WARNING("Tool number inconsistency!");
 
@@ -185,41 +195,91 @@ PlusStatus QPlusToolStateDisplayWidget::Update()
     }
   }
 
-  std::vector<igsioTransformName>::iterator transformIt;
-  std::vector<QTextEdit*>::iterator labelIt;
-  for (transformIt = transformNames.begin(), labelIt = m_ToolStateLabels.begin(); transformIt != transformNames.end() && labelIt != m_ToolStateLabels.end(); ++transformIt, ++labelIt)
+  // Nothing to refresh if no item has been added to any of the tool buffers since the last refresh
+  bool toolsChanged = false;
+  unsigned int toolIndex = 0;
+  for (DataSourceContainerConstIterator toolIt = m_SelectedChannel->GetToolsStartConstIterator(); toolIt != m_SelectedChannel->GetToolsEndConstIterator(); ++toolIt, ++toolIndex)
   {
-    QTextEdit* label = (*labelIt);
-
-    if (label == NULL)
+    unsigned long long generation = toolIt->second->GetNumberOfItemsAdded();
+    if (generation != m_ToolGenerations[toolIndex])
     {
-      LOG_WARNING("Invalid tool state label");
-      continue;
+      m_ToolGenerations[toolIndex] = generation;
+      toolsChanged = true;
     }
+  }
+  if (!toolsChanged)
+  {
+    return PLUS_SUCCESS;
+  }
 
-    ToolStatus status(TOOL_INVALID);
-    if (trackedFrame.GetFrameTransformStatus(*transformIt, status) != PLUS_SUCCESS)
-    {
-      std::string transformNameStr;
-      transformIt->GetTransformName(transformNameStr);
-      LOG_WARNING("Unable to get transform status for transform" << transformNameStr);
-      label->setText("STATUS ERROR");
-      label->setTextColor(QColor::fromRgb(223, 0, 0));
-    }
-    else
+  // Read the statuses of all tools at the most recent common timestamp in one call
+  double mostRecentTimestamp(0);
+  if (m_SelectedChannel->GetMostRecentTimestamp(mostRecentTimestamp) != PLUS_SUCCESS)
+  {
+    LOG_WARNING("Unable to get the most recent timestamp of the tool buffers");
+    return PLUS_SUCCESS;
+  }
+  std::vector<vtkPlusChannel::ToolTransform> toolTransforms;
+  m_SelectedChannel->GetInterpolatedToolTransforms(mostRecentTimestamp, toolTransforms);
+
+  for (toolIndex = 0; toolIndex < toolTransforms.size() && toolIndex < m_ToolStateLabels.size(); ++toolIndex)
+  {
+    const vtkPlusChannel::ToolTransform& toolTransform = toolTransforms[toolIndex];
+    if (toolTransform.Result != ITEM_OK)
     {
-      label->setText(igsioCommon::ConvertToolStatusToString(status).c_str());
-      switch (status)
-      {
-      case (TOOL_OK):
-        label->setTextColor(Qt::green);
-        break;
-      default:
-        label->setTextColor(QColor::fromRgb(223, 0, 0));
-        break;
-      }
+      LOG_WARNING("Unable to get transform status for transform" << toolTransform.Tool->GetId());
     }
+    this->SetToolState(toolIndex, toolTransform.Result == ITEM_OK, toolTransform.Sample.Status);
   }
 
   return PLUS_SUCCESS;
 }
+
+//-----------------------------------------------------------------------------
+void QPlusToolStateDisplayWidget::SetToolState(unsigned int toolIndex, bool statusValid, ToolStatus status)
+{
+  QTextEdit* label = m_ToolStateLabels[toolIndex];
+  if (label == NULL)
+  {
+    LOG_WARNING("Invalid tool state label");
+    return;
+  }
+
+  // -1 means that no status is displayed, -2 that the status error is displayed
+  int state = statusValid ? static_cast<int>(status) : -2;
+  if (m_DisplayedToolStates[toolIndex] == state)
+  {
+    return;
+  }
+  m_DisplayedToolStates[toolIndex] = state;
+
+  if (!statusValid)
+  {
+    label->setText("STATUS ERROR");
+    label->setTextColor(QColor::fromRgb(223, 0, 0));
+    return;
+  }
+
+  label->setText(igsioCommon::ConvertToolStatusToString(status).c_str());
+  switch (status)
+  {
+  case (TOOL_OK):
+    label->setTextColor(Qt::green);
+    break;
+  default:
+    label->setTextColor(QColor::fromRgb(223, 0, 0));
+    break;
+  }
+}
+
+//-----------------------------------------------------------------------------
+void QPlusToolStateDisplayWidget::SetMinimumUpdateIntervalSec(double intervalSec)
+{
+  m_MinimumUpdateIntervalSec = intervalSec;
+}
+
+//-----------------------------------------------------------------------------
+double QPlusToolStateDisplayWidget::GetMinimumUpdateIntervalSec() const
+{
+  return m_MinimumUpdateIntervalSec;
+}
@@ -22,6 +22,10 @@ class vtkPlusChannel;
 
 /*! \class QPlusToolStateDisplayWidget
  * \brief Widget that shows state of all tools available to the tracker
+ *
+ * Update can be called from a timer at any rate: the statuses are refreshed at most once in MinimumUpdateIntervalSec,
+ * only if an item was added to a tool buffer since the last refresh, and only the labels whose status changed are modified.
+ * The statuses of all tools are read in one channel call, without assembling a tracked frame.
  * \ingroup PlusAppCommonWidgets
  */
 class PlusWidgetsExport QPlusToolStateDisplayWidget : public QWidget
@@ -54,6 +58,12 @@ public:
   */
   PlusStatus Update();
 
+  /*!
+  * Set the minimum time between two refreshes of the displayed statuses (default: 0.1 s). Update calls in between are ignored.
+  */
+  void SetMinimumUpdateIntervalSec(double intervalSec);
+  double GetMinimumUpdateIntervalSec() const;
+
   /*!
   * Get initialization state
   * \return Initialization state
@@ -61,10 +71,20 @@ public:
   bool IsInitialized();
 
 protected:
+  /*! Display the status of a tool, the label is only modified if the status changed. If statusValid is false then an error is shown. */
+  void SetToolState(unsigned int toolIndex, bool statusValid, ToolStatus status);
+
   vtkPlusChannel*           m_SelectedChannel;
   std::vector<QLabel*>      m_ToolNameLabels;
   std::vector<QTextEdit*>   m_ToolStateLabels;
   bool                      m_Initialized;
+
+  /*! Number of items added to the buffer of each tool at the last refresh */
+  std::vector<unsigned long long> m_ToolGenerations;
+  /*! Displayed status of each tool, -1 if no status is displayed, -2 if the status error is displayed */
+  std::vector<int>          m_DisplayedToolStates;
+  double                    m_MinimumUpdateIntervalSec;
+  double                    m_LastUpdateTime;
 };
 
 #endif
\ No newline at end of file
@@ -66,6 +66,19 @@ public:
    */
   virtual bool Agree( std::vector<S> &parameters, T &data ) = 0;
 
+  /**
+   * This method tests which of the given data objects agree with the model
+   * defined by the parameters.
+   * @param data Array of numberOfData data objects.
+   * @param votes votes[i] is set to true if data[i] agrees with the model,
+   *              otherwise false.
+   * @return The number of data objects that agree with the model.
+   * The default implementation calls Agree() for each data object. Estimators
+   * can override it with a branch free loop that the compiler can vectorize.
+   */
+  virtual unsigned int BatchAgree( std::vector<S> &parameters, T *data,
+                                   unsigned int numberOfData, bool *votes );
+
   /**
    * Set the minimal number of data objects required for computation of an exact
    * estimate.
@@ -21,6 +21,20 @@ unsigned int ParametersEstimator<T,S>::GetMinimalForEstimate()
 }
 
 
+template<class T, class S>
+unsigned int ParametersEstimator<T,S>::BatchAgree( std::vector<S> &parameters, T *data,
+                                                   unsigned int numberOfData, bool *votes )
+{
+  unsigned int numberOfAgreeing = 0;
+  for( unsigned int i=0; i<numberOfData; i++ ) {
+    votes[i] = this->Agree( parameters, data[i] );
+    if( votes[i] )
+      numberOfAgreeing++;
+  }
+  return numberOfAgreeing;
+}
+
+
 } // end namespace itk
 
 #endif //_PARAMETERS_ESTIMATOR_TXX_
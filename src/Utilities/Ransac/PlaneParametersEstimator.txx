@@ -219,6 +219,34 @@ bool PlaneParametersEstimator<dimension>::Agree( std::vector<double> &parameters
     signedDistance += parameters[i]*( data[i]-parameters[dimension+i] );
   return ( (signedDistance*signedDistance) < this->deltaSquared );
 }
+/*****************************************************************************/
+/*
+ * Compute the same signed distances as Agree(), the votes are stored instead
+ * of branching on them so that the loop over the points can be vectorized.
+ */
+template< unsigned int dimension >
+unsigned int PlaneParametersEstimator<dimension>::BatchAgree( std::vector<double> &parameters,
+                                                              Point<double, dimension> *data,
+                                                              unsigned int numberOfData, bool *votes )
+{
+  double normal[dimension], pointOnPlane[dimension];
+  for( unsigned int i=0; i<dimension; i++ ) {
+    normal[i] = parameters[i];
+    pointOnPlane[i] = parameters[dimension+i];
+  }
+  const double deltaSquared = this->deltaSquared;
+  unsigned int numberOfAgreeing = 0;
+  for( unsigned int j=0; j<numberOfData; j++ ) {
+    const double *point = data[j].GetDataPointer();
+    double signedDistance = 0;
+    for( unsigned int i=0; i<dimension; i++ )
+      signedDistance += normal[i]*( point[i]-pointOnPlane[i] );
+    const bool agree = (signedDistance*signedDistance) < deltaSquared;
+    votes[j] = agree;
+    numberOfAgreeing += agree;
+  }
+  return numberOfAgreeing;
+}
 
 } // end namespace itk
 
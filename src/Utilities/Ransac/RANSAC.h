@@ -5,9 +5,12 @@
 #include "ParametersEstimator.h"
 
 // STL includes
+#include <algorithm>
+#include <atomic>
 #include <set>
 #include <vector>
 #include <limits>
+#include <random>
 
 // OS includes
 #include <stdlib.h>
@@ -176,14 +179,21 @@ namespace itk
     //array corresponding to length of data array, data[i]== true if it
     //agrees with the best model, otherwise false
     bool* bestVotes;
-    unsigned int numVotesForBest;
+    //written while holding resultsMutex, read without it to stop counting
+    //the votes of hypotheses that cannot be better than the best one
+    std::atomic<unsigned int> numVotesForBest;
 
     std::vector<T> data;
 
     //set which holds all of the subgroups/hypotheses already selected
     std::set<int*, SubSetIndexComparator >* chosenSubSets;
-    //number of iterations, equivalent to desired number of hypotheses
-    unsigned int numTries;
+    //number of iterations, equivalent to desired number of hypotheses,
+    //updated from the inlier ratio of the best hypothesis
+    std::atomic<unsigned int> numTries;
+    //number of iterations started by all threads
+    std::atomic<unsigned int> numTriesStarted;
+    //seed of the random number generators of the threads
+    unsigned int randomSeed;
 
     double numerator;
     unsigned int allTries;
@@ -3,6 +3,10 @@
 
 namespace itk
 {
+  //data objects are tested against a hypothesis in blocks of this size, the
+  //test stops after a block if the hypothesis cannot be better than the best
+  const unsigned int RANSAC_AGREEMENT_BLOCK_SIZE = 64;
+
   template<class T, class S>
   RANSAC<T, S>::RANSAC()
   {
@@ -98,10 +102,13 @@ namespace itk
     //initialize with the number of all possible subsets
     this->allTries = Choose(numDataObjects, numForEstimate);
     this->numTries = this->allTries;
+    this->numTriesStarted = 0;
     this->numerator = log(1.0 - desiredProbabilityForNoOutliers);
 
-
-    srand((unsigned)time(NULL));   //seed random number generator
+    //seed random number generators, each thread has its own generator
+    //(rand() is not thread safe)
+    std::random_device randomDevice;
+    this->randomSeed = randomDevice();
 
     //STEP2: create the threads that generate hypotheses and test
 
@@ -162,6 +169,11 @@ namespace itk
 #endif
     ThreadInfoType* infoStruct = static_cast<ThreadInfoType*>(arg);   //dynamic_cast doesn't work with void *
     RANSAC<T, S>* caller = reinterpret_cast< RANSAC<T, S> * >(infoStruct->UserData);
+#if ITK_VERSION_MAJOR >= 5
+    unsigned int threadId = infoStruct->WorkUnitID;
+#else
+    unsigned int threadId = infoStruct->ThreadID;
+#endif
 
     if (caller != NULL)
     {
@@ -180,7 +192,11 @@ namespace itk
       //true if data[i] is NOT chosen for computing the exact fit, otherwise false
       bool* notChosen = new bool[numDataObjects];
 
-      for (unsigned int i = 0; i < caller->numTries; i++)
+      std::mt19937 randomGenerator(caller->randomSeed + threadId);
+
+      //the iterations are shared by all threads, so the search terminates as
+      //soon as numTries hypotheses have been generated by any of the threads
+      while (caller->numTriesStarted++ < caller->numTries)
       {
         //randomly select data for exact model fit ('numForEstimate' objects).
         std::fill(notChosen, notChosen + numDataObjects, true);
@@ -191,7 +207,7 @@ namespace itk
         for (unsigned int l = 0; l < numForEstimate; l++)
         {
           //selectedIndex is in [0,maxIndex]
-          int selectedIndex = (int)(((float)rand() / (float)RAND_MAX) * maxIndex + 0.5);
+          int selectedIndex = std::uniform_int_distribution<int>(0, maxIndex)(randomGenerator);
           unsigned int k(0);
           int j(-1);
           for (; k < numDataObjects && j < selectedIndex; k++)
@@ -255,13 +271,10 @@ namespace itk
 
           //continue checking data until there is no chance of getting a larger consensus set
           //or all the data has been checked
-          for (m = 0; m < numDataObjects && caller->numVotesForBest - numVotesForCur < numDataObjects - m + 1; m++)
+          for (m = 0; m < numDataObjects && numVotesForCur + (numDataObjects - m) > caller->numVotesForBest; m += RANSAC_AGREEMENT_BLOCK_SIZE)
           {
-            if (caller->paramEstimator->Agree(exactEstimateParameters, caller->data[m]))
-            {
-              curVotes[m] = true;
-              numVotesForCur++;
-            }
+            unsigned int blockSize = std::min(RANSAC_AGREEMENT_BLOCK_SIZE, numDataObjects - m);
+            numVotesForCur += caller->paramEstimator->BatchAgree(exactEstimateParameters, &(caller->data[m]), blockSize, curVotes + m);
           } //found a larger consensus set?
 
 #if ITK_VERSION_MAJOR >= 5
@@ -278,20 +291,20 @@ namespace itk
             }
             //std::copy( curVotes, curVotes+numDataObjects, caller->bestVotes );
 
-            //all data objects are inliers, terminate the search
+            //all data objects are inliers, terminate the search (in all threads)
             if (caller->numVotesForBest == numDataObjects)
             {
-              i = caller->numTries;
+              caller->numTries = 0;
             }
             else
             {
               //update the estimate of outliers and the number of iterations we need
               denominator = log(1.0 - pow((double)numVotesForCur / (double)numDataObjects,
                                           (double)(numForEstimate)));
-              caller->numTries = (int)(caller->numerator / denominator + 0.5);
+              unsigned int numTries = (int)(caller->numerator / denominator + 0.5);
 
               //there are cases when the probablistic number of tries is greater than all possible sub-sets
-              caller->numTries = caller->numTries < caller->allTries ? caller->numTries : caller->allTries;
+              caller->numTries = numTries < caller->allTries ? numTries : caller->allTries;
             }
           }
 #if ITK_VERSION_MAJOR >= 5
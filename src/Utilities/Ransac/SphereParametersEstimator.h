@@ -79,6 +79,14 @@ public:
   virtual bool Agree( std::vector<double> &parameters, 
                       Point<double, dimension> &data );
 
+  /**
+   * Same test as Agree() for an array of points, without a virtual call and a
+   * branch per point.
+   */
+  virtual unsigned int BatchAgree( std::vector<double> &parameters,
+                                   Point<double, dimension> *data,
+                                   unsigned int numberOfData, bool *votes );
+
   /**
    * Change the type of least squares solution.
    * @param lsType When the leastSquaresEstimate() method is called it computes 
@@ -265,6 +265,33 @@ bool SphereParametersEstimator<dimension>::Agree( std::vector<double> &parameter
 
   return delta < this->delta;
 }
+/*****************************************************************************/
+/*
+ * Compute the same distances as Agree(), the votes are stored instead of
+ * branching on them so that the loop over the points can be vectorized.
+ */
+template< unsigned int dimension >
+unsigned int SphereParametersEstimator<dimension>::BatchAgree( std::vector<double> &parameters,
+                                                               Point<double, dimension> *data,
+                                                               unsigned int numberOfData, bool *votes )
+{
+  double center[dimension];
+  for( unsigned int i=0; i<dimension; i++ )
+    center[i] = parameters[i];
+  const double radius = parameters[dimension];
+  const double maximumDelta = this->delta;
+  unsigned int numberOfAgreeing = 0;
+  for( unsigned int j=0; j<numberOfData; j++ ) {
+    const double *point = data[j].GetDataPointer();
+    double distanceSquared = 0;
+    for( unsigned int i=0; i<dimension; i++ )
+      distanceSquared += ( (point[i] - center[i])*(point[i] - center[i]) );
+    const bool agree = ( sqrt(distanceSquared) - radius ) < maximumDelta;
+    votes[j] = agree;
+    numberOfAgreeing += agree;
+  }
+  return numberOfAgreeing;
+}
 
 
 template< unsigned int dimension > 